@@ -175,6 +175,18 @@ public class Collectd
   native public static int registerWrite (String name,
       CollectdWriteInterface object);
 
+  /**
+   * Java representation of collectd/src/plugin.h:plugin_register_write_batch
+   *
+   * The callback receives all value lists of a write batch at once, without
+   * creating a {@link ValueList} object for each of them.
+   *
+   * @return Zero when successful, non-zero otherwise.
+   * @see CollectdWriteBatchInterface
+   */
+  native public static int registerWriteBatch (String name,
+      CollectdWriteBatchInterface object);
+
   /**
    * Java representation of collectd/src/plugin.h:plugin_register_flush
    *
@@ -236,6 +248,16 @@ public class Collectd
    */
   native public static int dispatchValues (ValueList vl);
 
+  /**
+   * Java representation of collectd/src/plugin.h:plugin_dispatch_values_batch
+   *
+   * Used by {@link ValueListBatch.Builder#dispatch}.
+   *
+   * @return Zero when successful, non-zero otherwise.
+   */
+  native static int dispatchValuesBatch (java.nio.ByteBuffer buffer,
+      int length);
+
   /**
    * Java representation of collectd/src/plugin.h:plugin_dispatch_notification
    *
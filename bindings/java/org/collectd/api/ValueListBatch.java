@@ -0,0 +1,420 @@
+/**
+ * collectd - bindings/java/org/collectd/api/ValueListBatch.java
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+package org.collectd.api;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+import java.util.HashMap;
+import java.util.List;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * A batch of collectd/src/plugin.h:value_list_t structures, passed between
+ * collectd and Java in one direct {@link ByteBuffer}.
+ *
+ * The value lists are decoded lazily: the accessors read single fields from
+ * the buffer, {@link #get} creates a {@link ValueList} only when asked to.
+ * A batch passed to {@link CollectdWriteBatchInterface#writeBatch} is only
+ * valid during that call; the {@link ValueList} objects returned by
+ * {@link #get} remain valid afterwards.
+ *
+ * The layout of the buffer is described in src/java.c.
+ *
+ * @see CollectdWriteBatchInterface
+ * @see ValueListBatch.Builder
+ */
+public class ValueListBatch {
+
+    /* Must match CJNI_BATCH_LONG and CJNI_BATCH_DOUBLE in src/java.c. */
+    static final byte KIND_LONG = 0;
+    static final byte KIND_DOUBLE = 1;
+
+    private static final Charset UTF8 = Charset.forName ("UTF-8");
+
+    /* Types cannot change while collectd is running. */
+    private static final ConcurrentHashMap<String, DataSet> _dataSets =
+        new ConcurrentHashMap<String, DataSet> ();
+
+    private static final ThreadLocal<StringCache> _strings =
+        new ThreadLocal<StringCache> () {
+            protected StringCache initialValue () {
+                return new StringCache ();
+            }
+        };
+
+    private ByteBuffer _buffer;
+    private final int _size;
+    private int[] _offsets;
+    private ValueList[] _valueLists;
+
+    /* Called from src/java.c. */
+    ValueListBatch (ByteBuffer buffer, int size) {
+        _buffer = buffer.order (ByteOrder.nativeOrder ());
+        _size = size;
+    }
+
+    /* Called from src/java.c after the write callback returned, before the
+     * memory of the buffer is freed. */
+    void release () {
+        _buffer = null;
+    }
+
+    /**
+     * Returns the {@link DataSet} of "type", like {@link Collectd#getDS} but
+     * cached.
+     */
+    public static DataSet getDataSet (String type) {
+        DataSet ds = _dataSets.get (type);
+        if (ds == null) {
+            ds = Collectd.getDS (type);
+            if (ds != null)
+                _dataSets.putIfAbsent (type, ds);
+        }
+        return ds;
+    }
+
+    /**
+     * Returns the number of value lists in the batch.
+     */
+    public int size () {
+        return _size;
+    }
+
+    public String getHost (int index) {
+        return getString (index, 0);
+    }
+
+    public String getPlugin (int index) {
+        return getString (index, 1);
+    }
+
+    public String getPluginInstance (int index) {
+        return getString (index, 2);
+    }
+
+    public String getType (int index) {
+        return getString (index, 3);
+    }
+
+    public String getTypeInstance (int index) {
+        return getString (index, 4);
+    }
+
+    /**
+     * Returns the time (in milliseconds) of the value list.
+     */
+    public long getTime (int index) {
+        return buffer ().getLong (skipStrings (index));
+    }
+
+    /**
+     * Returns the interval (in milliseconds) of the value list.
+     */
+    public long getInterval (int index) {
+        return buffer ().getLong (skipStrings (index) + 8);
+    }
+
+    public int getValuesNum (int index) {
+        return buffer ().getInt (skipStrings (index) + 16);
+    }
+
+    /**
+     * Returns the n-th value of the value list: a {@link Double} for gauges,
+     * a {@link Long} for all other data source types.
+     */
+    public Number getValue (int index, int n) {
+        ByteBuffer b = buffer ();
+        int pos = skipStrings (index) + 16;
+        if ((n < 0) || (n >= b.getInt (pos)))
+            throw new IndexOutOfBoundsException ("value " + n);
+
+        pos += 4 + 9 * n;
+        if (b.get (pos) == KIND_DOUBLE)
+            return Double.valueOf (b.getDouble (pos + 1));
+        return Long.valueOf (b.getLong (pos + 1));
+    }
+
+    /**
+     * Returns the value list as a {@link ValueList} object. The object is
+     * created on the first call and returned again by later calls.
+     */
+    public ValueList get (int index) {
+        offset (index);
+        if (_valueLists == null)
+            _valueLists = new ValueList[_size];
+        if (_valueLists[index] != null)
+            return _valueLists[index];
+
+        ValueList vl = new ValueList ();
+        vl.setHost (getHost (index));
+        vl.setPlugin (getPlugin (index));
+        vl.setPluginInstance (getPluginInstance (index));
+        vl.setType (getType (index));
+        vl.setTypeInstance (getTypeInstance (index));
+        vl.setTime (getTime (index));
+        vl.setInterval (getInterval (index));
+        vl.setDataSet (getDataSet (vl.getType ()));
+
+        int num = getValuesNum (index);
+        for (int i = 0; i < num; i++)
+            vl.addValue (getValue (index, i));
+
+        _valueLists[index] = vl;
+        return vl;
+    }
+
+    private ByteBuffer buffer () {
+        if (_buffer == null)
+            throw new IllegalStateException ("The batch is only valid during "
+                + "the writeBatch call");
+        return _buffer;
+    }
+
+    private int offset (int index) {
+        if ((index < 0) || (index >= _size))
+            throw new IndexOutOfBoundsException ("value list " + index);
+
+        if (_offsets == null) {
+            ByteBuffer b = buffer ();
+            int[] offsets = new int[_size];
+            int pos = 0;
+            for (int i = 0; i < _size; i++) {
+                offsets[i] = pos;
+                pos += b.getInt (pos);
+            }
+            _offsets = offsets;
+        }
+        return _offsets[index];
+    }
+
+    /* Returns the position of the n-th string of the record. */
+    private int stringOffset (int index, int n) {
+        ByteBuffer b = buffer ();
+        int pos = offset (index) + 4;
+        for (int i = 0; i < n; i++)
+            pos += 2 + b.getShort (pos);
+        return pos;
+    }
+
+    /* Returns the position of the time field of the record. */
+    private int skipStrings (int index) {
+        return stringOffset (index, 5);
+    }
+
+    private String getString (int index, int n) {
+        ByteBuffer b = buffer ();
+        int pos = stringOffset (index, n);
+        return _strings.get ().get (b, pos + 2, b.getShort (pos));
+    }
+
+    /*
+     * Maps the encoded bytes of identifiers to String objects, so that the
+     * same few host, plugin and type names are not decoded and allocated
+     * again for every value list. Collisions simply replace the entry.
+     */
+    private static final class StringCache {
+        private static final int SLOTS = 512;
+
+        private final byte[][] _keys = new byte[SLOTS][];
+        private final String[] _values = new String[SLOTS];
+
+        String get (ByteBuffer b, int pos, int len) {
+            if (len == 0)
+                return "";
+
+            int hash = len;
+            for (int i = 0; i < len; i++)
+                hash = 31 * hash + b.get (pos + i);
+            int slot = (hash ^ (hash >>> 16)) & (SLOTS - 1);
+
+            byte[] key = _keys[slot];
+            if ((key != null) && (key.length == len)) {
+                int i = 0;
+                while ((i < len) && (key[i] == b.get (pos + i)))
+                    i++;
+                if (i == len)
+                    return _values[slot];
+            }
+
+            key = new byte[len];
+            for (int i = 0; i < len; i++)
+                key[i] = b.get (pos + i);
+            String value = new String (key, UTF8);
+
+            _keys[slot] = key;
+            _values[slot] = value;
+            return value;
+        }
+    }
+
+    /**
+     * Collects value lists in a direct buffer and dispatches them to collectd
+     * with a single call, instead of one {@link Collectd#dispatchValues} call
+     * per value list. The value lists are copied when they are added, so the
+     * same {@link ValueList} object can be modified and added again.
+     *
+     * A builder is not thread-safe.
+     */
+    public static class Builder {
+        private static final int ENCODED_MAX = 4096;
+
+        private ByteBuffer _buffer;
+        private int _count = 0;
+        private final HashMap<String, byte[]> _encoded =
+            new HashMap<String, byte[]> ();
+
+        public Builder () {
+            this (64 * 1024);
+        }
+
+        public Builder (int capacity) {
+            _buffer = ByteBuffer.allocateDirect (capacity)
+                .order (ByteOrder.nativeOrder ());
+        }
+
+        /**
+         * Returns the number of value lists added since the last dispatch.
+         */
+        public int size () {
+            return _count;
+        }
+
+        public void add (ValueList vl) {
+            byte[][] strings = {
+                encode (vl.getHost ()),
+                encode (vl.getPlugin ()),
+                encode (vl.getPluginInstance ()),
+                encode (vl.getType ()),
+                encode (vl.getTypeInstance ())
+            };
+            List<Number> values = vl.getValues ();
+            DataSet ds = vl.getDataSet ();
+            if ((ds == null) && (vl.getType () != null))
+                ds = getDataSet (vl.getType ());
+            List<DataSource> sources =
+                (ds != null) ? ds.getDataSources () : null;
+
+            int size = 4 + 8 + 8 + 4 + 9 * values.size ();
+            for (byte[] s : strings)
+                size += 2 + s.length;
+            reserve (size);
+
+            _buffer.putInt (size);
+            for (byte[] s : strings) {
+                _buffer.putShort ((short) s.length);
+                _buffer.put (s);
+            }
+            _buffer.putLong (vl.getTime ());
+            _buffer.putLong (vl.getInterval ());
+            _buffer.putInt (values.size ());
+            for (int i = 0; i < values.size (); i++) {
+                Number n = values.get (i);
+                if (isGauge (sources, i, n)) {
+                    _buffer.put (KIND_DOUBLE);
+                    _buffer.putDouble (n.doubleValue ());
+                }
+                else {
+                    _buffer.put (KIND_LONG);
+                    _buffer.putLong (n.longValue ());
+                }
+            }
+            _count++;
+        }
+
+        /* Like the conversion in src/java.c:jtoc_values_array, gauges are
+         * passed as doubles and all other types as longs. */
+        private static boolean isGauge (List<DataSource> sources, int i,
+                Number n) {
+            if ((sources != null) && (i < sources.size ()))
+                return sources.get (i).getType () == DataSource.TYPE_GAUGE;
+            return (n instanceof Double) || (n instanceof Float)
+                || (n instanceof java.math.BigDecimal);
+        }
+
+        /**
+         * Dispatches all value lists added since the last call and empties
+         * the builder.
+         *
+         * @return Zero when successful, non-zero otherwise.
+         */
+        public int dispatch () {
+            if (_count == 0)
+                return 0;
+
+            int status = Collectd.dispatchValuesBatch (_buffer,
+                _buffer.position ());
+            clear ();
+            return status;
+        }
+
+        /**
+         * Drops all value lists added since the last dispatch.
+         */
+        public void clear () {
+            _buffer.clear ();
+            _count = 0;
+        }
+
+        private byte[] encode (String s) {
+            if (s == null)
+                return new byte[0];
+
+            byte[] b = _encoded.get (s);
+            if (b != null)
+                return b;
+
+            b = s.getBytes (UTF8);
+            if (b.length > Short.MAX_VALUE) {
+                byte[] tmp = new byte[Short.MAX_VALUE];
+                System.arraycopy (b, 0, tmp, 0, tmp.length);
+                b = tmp;
+            }
+
+            /* Bound the memory used by identifiers that change all the
+             * time. */
+            if (_encoded.size () >= ENCODED_MAX)
+                _encoded.clear ();
+            _encoded.put (s, b);
+            return b;
+        }
+
+        private void reserve (int size) {
+            if (_buffer.remaining () >= size)
+                return;
+
+            int capacity = Math.max (2 * _buffer.capacity (), 1024);
+            while (capacity - _buffer.position () < size)
+                capacity *= 2;
+
+            ByteBuffer tmp = ByteBuffer.allocateDirect (capacity)
+                .order (ByteOrder.nativeOrder ());
+            _buffer.flip ();
+            tmp.put (_buffer);
+            _buffer = tmp;
+        }
+    }
+}
+
+/* vim: set sw=4 sts=4 et : */
@@ -30,6 +30,11 @@ import java.util.List;
 import java.util.ArrayList;
 import java.util.Map;
 import java.util.TreeMap;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.atomic.AtomicInteger;
 
 import org.collectd.api.Collectd;
 import org.collectd.api.CollectdConfigInterface;
@@ -48,6 +53,10 @@ public class GenericJMX implements CollectdConfigInterface,
 
   private List<GenericJMXConfConnection> _connections = null;
 
+  /* Connections are queried concurrently by up to this many threads. */
+  private int _read_threads = 4;
+  private ExecutorService _executor = null;
+
   public GenericJMX ()
   {
     Collectd.registerConfig   ("GenericJMX", this);
@@ -85,6 +94,21 @@ public class GenericJMX implements CollectdConfigInterface,
               + "Evaluating `MBean' block failed: " + e);
         }
       }
+      else if (key.equalsIgnoreCase ("ReadThreads"))
+      {
+        List<OConfigValue> values = child.getValues ();
+        if ((values.size () != 1)
+            || (values.get (0).getType () != OConfigValue.OCONFIG_TYPE_NUMBER)
+            || (values.get (0).getNumber ().intValue () < 1))
+        {
+          Collectd.logError ("GenericJMX plugin: The ReadThreads option "
+              + "needs exactly one positive numeric argument.");
+        }
+        else
+        {
+          this._read_threads = values.get (0).getNumber ().intValue ();
+        }
+      }
       else if (key.equalsIgnoreCase ("Connection"))
       {
         try
@@ -107,19 +131,66 @@ public class GenericJMX implements CollectdConfigInterface,
     return (0);
   } /* }}} int config */
 
+  private ExecutorService getExecutor () /* {{{ */
+  {
+    if (this._executor != null)
+      return (this._executor);
+
+    final AtomicInteger count = new AtomicInteger (0);
+    this._executor = Executors.newFixedThreadPool (
+        Math.min (this._read_threads, this._connections.size ()),
+        new ThreadFactory ()
+        {
+          public Thread newThread (Runnable r)
+          {
+            Thread t = new Thread (r, "GenericJMX #" + count.incrementAndGet ());
+            t.setDaemon (true);
+            return (t);
+          }
+        });
+
+    return (this._executor);
+  } /* }}} ExecutorService getExecutor */
+
   public int read () /* {{{ */
   {
+    List<Future<?>> futures = new ArrayList<Future<?>> ();
+
+    /* Query the connections concurrently, so that slow or remote JVMs don't
+     * add up. The values are dispatched from this thread afterwards. */
+    if ((this._read_threads > 1) && (this._connections.size () > 1))
+    {
+      ExecutorService executor = getExecutor ();
+
+      for (int i = 0; i < this._connections.size (); i++)
+      {
+        final GenericJMXConfConnection conn = this._connections.get (i);
+        futures.add (executor.submit (new Runnable ()
+        {
+          public void run ()
+          {
+            conn.query ();
+          }
+        }));
+      }
+    }
+
     for (int i = 0; i < this._connections.size (); i++)
     {
       try
       {
-        this._connections.get (i).query ();
+        if (futures.size () > 0)
+          futures.get (i).get ();
+        else
+          this._connections.get (i).query ();
       }
       catch (Exception e)
       {
         Collectd.logError ("GenericJMX: Caught unexpected exception: " + e);
         e.printStackTrace ();
       }
+
+      this._connections.get (i).dispatch ();
     }
 
     return (0);
@@ -128,6 +199,11 @@ public class GenericJMX implements CollectdConfigInterface,
   public int shutdown () /* {{{ */
   {
     System.out.print ("org.collectd.java.GenericJMX.Shutdown ();\n");
+    if (this._executor != null)
+    {
+      this._executor.shutdownNow ();
+      this._executor = null;
+    }
     this._connections = null;
     return (0);
   } /* }}} int shutdown */
@@ -31,10 +31,12 @@ import java.util.Map;
 import java.util.Iterator;
 import java.util.ArrayList;
 import java.util.HashMap;
+import java.util.Set;
 import java.net.InetAddress;
 import java.net.UnknownHostException;
 
 import javax.management.MBeanServerConnection;
+import javax.management.ObjectName;
 
 import javax.management.remote.JMXServiceURL;
 import javax.management.remote.JMXConnector;
@@ -42,6 +44,7 @@ import javax.management.remote.JMXConnectorFactory;
 
 import org.collectd.api.Collectd;
 import org.collectd.api.PluginData;
+import org.collectd.api.ValueListBatch;
 import org.collectd.api.OConfigValue;
 import org.collectd.api.OConfigItem;
 
@@ -55,6 +58,14 @@ class GenericJMXConfConnection
   private JMXConnector _jmx_connector = null;
   private MBeanServerConnection _mbean_connection = null;
   private List<GenericJMXConfMBean> _mbeans = null;
+  private ValueListBatch.Builder _batch = new ValueListBatch.Builder ();
+
+  /* Names matching the ObjectName patterns of the MBeans, so queryNames
+   * doesn't have to be called on every read. */
+  private Map<GenericJMXConfMBean,Set<ObjectName>> _names
+    = new HashMap<GenericJMXConfMBean,Set<ObjectName>> ();
+  private long _names_interval = 60000; /* milliseconds */
+  private long _names_time = 0;
 
   /*
    * private methods
@@ -83,6 +94,30 @@ class GenericJMXConfConnection
     return (v.getString ());
   } /* }}} String getConfigString */
 
+  private Number getConfigNumber (OConfigItem ci) /* {{{ */
+  {
+    List<OConfigValue> values;
+    OConfigValue v;
+
+    values = ci.getValues ();
+    if (values.size () != 1)
+    {
+      Collectd.logError ("GenericJMXConfConnection: The " + ci.getKey ()
+          + " configuration option needs exactly one numeric argument.");
+      return (null);
+    }
+
+    v = values.get (0);
+    if (v.getType () != OConfigValue.OCONFIG_TYPE_NUMBER)
+    {
+      Collectd.logError ("GenericJMXConfConnection: The " + ci.getKey ()
+          + " configuration option needs exactly one numeric argument.");
+      return (null);
+    }
+
+    return (v.getNumber ());
+  } /* }}} Number getConfigNumber */
+
   private String getHost () /* {{{ */
   {
     if (this._host != null)
@@ -148,8 +183,29 @@ class GenericJMXConfConnection
 
     this._jmx_connector = null;
     this._mbean_connection = null;
+    this._names.clear ();
   } /* }}} void disconnect */
 
+  /*
+   * Returns the names matching the ObjectName of "mbean", or null if its
+   * ObjectName is not a pattern.
+   */
+  private Set<ObjectName> getNames (GenericJMXConfMBean mbean) /* {{{ */
+    throws java.io.IOException
+  {
+    if (!mbean.isPattern ())
+      return (null);
+
+    Set<ObjectName> names = this._names.get (mbean);
+    if (names == null)
+    {
+      names = mbean.queryNames (this._mbean_connection);
+      this._names.put (mbean, names);
+    }
+
+    return (names);
+  } /* }}} Set<ObjectName> getNames */
+
   /*
    * public methods
    *
@@ -158,6 +214,7 @@ class GenericJMXConfConnection
    *   ServiceURL "service:jmx:rmi:///jndi/rmi://localhost:17264/jmxrmi"
    *   Collect "java.lang:type=GarbageCollector,name=Copy"
    *   Collect "java.lang:type=Memory"
+   *   QueryNamesInterval 60
    * </Connection>
    *
    */
@@ -205,6 +262,12 @@ class GenericJMXConfConnection
         if (tmp != null)
           this._instance_prefix = tmp;
       }
+      else if (child.getKey ().equalsIgnoreCase ("QueryNamesInterval"))
+      {
+        Number tmp = getConfigNumber (child);
+        if (tmp != null)
+          this._names_interval = (long) (tmp.doubleValue () * 1000.0);
+      }
       else if (child.getKey ().equalsIgnoreCase ("Collect"))
       {
         String tmp = getConfigString (child);
@@ -233,9 +296,15 @@ class GenericJMXConfConnection
             + "present."));
   } /* }}} GenericJMXConfConnection (OConfigItem ci) */
 
+  /**
+   * Queries all MBeans of this connection. The values are collected and
+   * passed to collectd by {@link #dispatch}, so that this method can be
+   * called from any thread.
+   */
   public void query () /* {{{ */
   {
     PluginData pd;
+    long now;
 
     // try to connect
     connect ();
@@ -247,24 +316,55 @@ class GenericJMXConfConnection
         + "Reading " + this._mbeans.size () + " mbeans from "
         + ((this._host != null) ? this._host : "(null)"));
 
+    now = System.currentTimeMillis ();
+    if ((now - this._names_time) >= this._names_interval)
+    {
+      this._names.clear ();
+      this._names_time = now;
+    }
+
     pd = new PluginData ();
     pd.setHost (this.getHost ());
     pd.setPlugin ("GenericJMX");
 
     for (int i = 0; i < this._mbeans.size (); i++)
     {
+      GenericJMXConfMBean mbean = this._mbeans.get (i);
       int status;
 
-      status = this._mbeans.get (i).query (this._mbean_connection, pd,
-          this._instance_prefix);
-      if (status != 0)
+      try
+      {
+        status = mbean.query (this._mbean_connection, pd,
+            this._instance_prefix, this._batch, getNames (mbean));
+      }
+      catch (java.io.IOException e)
+      {
+        Collectd.logError ("GenericJMXConfMBean: queryNames failed: " + e);
+        status = -1;
+      }
+
+      if (status < 0)
       {
         disconnect ();
         return;
       }
+      else if (status > 0)
+      {
+        /* An MBean went away; look for matching MBeans again next time. */
+        this._names.remove (mbean);
+      }
     } /* for */
   } /* }}} void query */
 
+  /**
+   * Dispatches the values collected by {@link #query} with a single call.
+   * Must be called from the read callback's thread.
+   */
+  public void dispatch () /* {{{ */
+  {
+    this._batch.dispatch ();
+  } /* }}} void dispatch */
+
   public String toString ()
   {
     return (new String ("host = " + this._host + "; "
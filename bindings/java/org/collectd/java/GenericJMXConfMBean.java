@@ -26,17 +26,26 @@
 
 package org.collectd.java;
 
+import java.io.IOException;
 import java.util.Iterator;
 import java.util.List;
+import java.util.Map;
 import java.util.Set;
 import java.util.ArrayList;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.LinkedHashSet;
 
+import javax.management.Attribute;
+import javax.management.AttributeList;
+import javax.management.InstanceNotFoundException;
 import javax.management.MBeanServerConnection;
 import javax.management.ObjectName;
 import javax.management.MalformedObjectNameException;
 
 import org.collectd.api.Collectd;
 import org.collectd.api.PluginData;
+import org.collectd.api.ValueListBatch;
 import org.collectd.api.OConfigValue;
 import org.collectd.api.OConfigItem;
 
@@ -47,6 +56,7 @@ class GenericJMXConfMBean
   private String _instance_prefix;
   private List<String> _instance_from;
   private List<GenericJMXConfValue> _values;
+  private String[] _attribute_names; /* read with one getAttributes call */
 
   private String getConfigString (OConfigItem ci) /* {{{ */
   {
@@ -152,6 +162,10 @@ class GenericJMXConfMBean
     if (this._values.size () == 0)
       throw (new IllegalArgumentException ("No value block was defined."));
 
+    Set<String> attributeNames = new LinkedHashSet<String> ();
+    for (int i = 0; i < this._values.size (); i++)
+      this._values.get (i).addAttributeNames (attributeNames);
+    this._attribute_names = attributeNames.toArray (new String[0]);
   } /* }}} GenericJMXConfMBean (OConfigItem ci) */
 
   public String getName () /* {{{ */
@@ -159,22 +173,75 @@ class GenericJMXConfMBean
     return (this._name);
   } /* }}} */
 
-  public int query (MBeanServerConnection conn, PluginData pd, /* {{{ */
-      String instance_prefix)
+  /**
+   * Returns true if the object name is a pattern which has to be resolved with
+   * {@link #queryNames}.
+   */
+  public boolean isPattern () /* {{{ */
   {
-    Set<ObjectName> names;
-    Iterator<ObjectName> iter;
+    return (this._obj_name.isPattern ());
+  } /* }}} boolean isPattern */
+
+  /**
+   * Returns the names of all MBeans matching the object name pattern.
+   */
+  public Set<ObjectName> queryNames (MBeanServerConnection conn) /* {{{ */
+    throws IOException
+  {
+    return (conn.queryNames (this._obj_name, /* query = */ null));
+  } /* }}} Set<ObjectName> queryNames */
+
+  /**
+   * Fetches all configured attributes of one MBean with a single call.
+   * Returns null if that fails for reasons other than I/O, in which case the
+   * attributes are queried one by one.
+   */
+  private Map<String,Object> getAttributes (MBeanServerConnection conn, /* {{{ */
+      ObjectName objName)
+    throws IOException, InstanceNotFoundException
+  {
+    AttributeList list;
 
     try
     {
-      names = conn.queryNames (this._obj_name, /* query = */ null);
+      list = conn.getAttributes (objName, this._attribute_names);
     }
-    catch (Exception e)
+    catch (javax.management.ReflectionException e)
     {
-      Collectd.logError ("GenericJMXConfMBean: queryNames failed: " + e);
-      return (-1);
+      Collectd.logDebug ("GenericJMXConfMBean: getAttributes failed: " + e);
+      return (null);
     }
 
+    Map<String,Object> ret = new HashMap<String,Object> ();
+    for (Object obj : list)
+    {
+      Attribute attr = (Attribute) obj;
+      ret.put (attr.getName (), attr.getValue ());
+    }
+
+    return (ret);
+  } /* }}} Map<String,Object> getAttributes */
+
+  /**
+   * Queries all MBeans matching the object name and adds their values to
+   * <em>batch</em>.
+   *
+   * @param names Names of the matching MBeans, as returned by
+   *              {@link #queryNames}, or null if the object name is not a
+   *              pattern.
+   * @return Zero on success, a positive value if one of the <em>names</em>
+   *         no longer exists and a negative value if the connection failed.
+   */
+  public int query (MBeanServerConnection conn, PluginData pd, /* {{{ */
+      String instance_prefix, ValueListBatch.Builder batch,
+      Set<ObjectName> names)
+  {
+    Iterator<ObjectName> iter;
+    int status = 0;
+
+    if (names == null)
+      names = Collections.singleton (this._obj_name);
+
     if (names.size () == 0)
     {
       Collectd.logWarning ("GenericJMXConfMBean: No MBean matched "
@@ -188,6 +255,7 @@ class GenericJMXConfMBean
       PluginData   pd_tmp;
       List<String> instanceList;
       StringBuffer instance;
+      Map<String,Object> attrValues;
 
       objName      = iter.next ();
       pd_tmp       = new PluginData (pd);
@@ -197,6 +265,29 @@ class GenericJMXConfMBean
       Collectd.logDebug ("GenericJMXConfMBean: objName = "
           + objName.toString ());
 
+      try
+      {
+        attrValues = getAttributes (conn, objName);
+      }
+      catch (InstanceNotFoundException e)
+      {
+        if (this.isPattern ())
+        {
+          status = 1;
+        }
+        else
+        {
+          Collectd.logWarning ("GenericJMXConfMBean: No MBean matched "
+              + "the ObjectName " + this._obj_name);
+        }
+        continue;
+      }
+      catch (IOException e)
+      {
+        Collectd.logError ("GenericJMXConfMBean: getAttributes failed: " + e);
+        return (-1);
+      }
+
       for (int i = 0; i < this._instance_from.size (); i++)
       {
         String propertyName;
@@ -233,10 +324,10 @@ class GenericJMXConfMBean
       Collectd.logDebug ("GenericJMXConfMBean: instance = " + instance.toString ());
 
       for (int i = 0; i < this._values.size (); i++)
-        this._values.get (i).query (conn, objName, pd_tmp);
+        this._values.get (i).query (conn, objName, pd_tmp, batch, attrValues);
     }
 
-    return (0);
+    return (status);
   } /* }}} void query */
 }
 
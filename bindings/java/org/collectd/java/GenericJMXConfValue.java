@@ -29,6 +29,7 @@ package org.collectd.java;
 import java.util.Arrays;
 import java.util.List;
 import java.util.Collection;
+import java.util.Map;
 import java.util.Set;
 import java.util.concurrent.atomic.AtomicInteger;
 import java.util.concurrent.atomic.AtomicLong;
@@ -49,6 +50,7 @@ import org.collectd.api.Collectd;
 import org.collectd.api.DataSet;
 import org.collectd.api.DataSource;
 import org.collectd.api.ValueList;
+import org.collectd.api.ValueListBatch;
 import org.collectd.api.PluginData;
 import org.collectd.api.OConfigValue;
 import org.collectd.api.OConfigItem;
@@ -201,7 +203,7 @@ class GenericJMXConfValue
   } /* }}} List<Number> genericCompositeToNumber */
 
   private void submitTable (List<Object> objects, ValueList vl, /* {{{ */
-      String instancePrefix)
+      String instancePrefix, ValueListBatch.Builder batch)
   {
     List<CompositeData> cdlist;
     Set<String> keySet = null;
@@ -257,12 +259,12 @@ class GenericJMXConfValue
         vl.setTypeInstance (instancePrefix + key);
       vl.setValues (values);
 
-      Collectd.dispatchValues (vl);
+      batch.add (vl);
     }
   } /* }}} void submitTable */
 
   private void submitScalar (List<Object> objects, ValueList vl, /* {{{ */
-      String instancePrefix)
+      String instancePrefix, ValueListBatch.Builder batch)
   {
     List<Number> values;
 
@@ -280,7 +282,7 @@ class GenericJMXConfValue
       vl.setTypeInstance (instancePrefix);
     vl.setValues (values);
 
-    Collectd.dispatchValues (vl);
+    batch.add (vl);
   } /* }}} void submitScalar */
 
   private Object queryAttributeRecursive (CompositeData parent, /* {{{ */
@@ -353,7 +355,7 @@ class GenericJMXConfValue
   } /* }}} queryAttributeRecursive */
 
   private Object queryAttribute (MBeanServerConnection conn, /* {{{ */
-      ObjectName objName, String attrName)
+      ObjectName objName, String attrName, Map<String,Object> attrValues)
   {
     List<String> attrNameList;
     String key;
@@ -367,23 +369,33 @@ class GenericJMXConfValue
     for (int i = 1; i < attrNameArray.length; i++)
       attrNameList.add (attrNameArray[i]);
 
-    try
+    /* Attributes fetched by GenericJMXConfMBean with a single getAttributes
+     * call. Anything missing there may still be an operation, so it is
+     * queried on its own. */
+    if ((attrValues != null) && attrValues.containsKey (key))
+    {
+      value = attrValues.get (key);
+    }
+    else
     {
       try
       {
-        value = conn.getAttribute (objName, key);
+        try
+        {
+          value = conn.getAttribute (objName, key);
+        }
+        catch (javax.management.AttributeNotFoundException e)
+        {
+          value = conn.invoke (objName, key, /* args = */ null, /* types = */ null);
+        }
       }
-      catch (javax.management.AttributeNotFoundException e)
+      catch (Exception e)
       {
-        value = conn.invoke (objName, key, /* args = */ null, /* types = */ null);
+        Collectd.logError ("GenericJMXConfValue.query: getAttribute failed: "
+            + e);
+        return (null);
       }
     }
-    catch (Exception e)
-    {
-      Collectd.logError ("GenericJMXConfValue.query: getAttribute failed: "
-          + e);
-      return (null);
-    }
 
     if (attrNameList.size () == 0)
     {
@@ -557,17 +569,34 @@ class GenericJMXConfValue
       throw (new IllegalArgumentException ("No attribute was defined."));
   } /* }}} GenericJMXConfValue (OConfigItem ci) */
 
+  /**
+   * Adds the names of the MBean attributes read by this value, i.e. the part
+   * of each configured attribute path before the first dot, to
+   * <em>names</em>.
+   */
+  public void addAttributeNames (Set<String> names) /* {{{ */
+  {
+    for (int i = 0; i < this._attributes.size (); i++)
+      names.add (this._attributes.get (i).split ("\\.")[0]);
+  } /* }}} void addAttributeNames */
+
   /**
    * Query values via JMX according to the object's configuration and dispatch
    * them to collectd.
    *
-   * @param conn    Connection to the MBeanServer.
-   * @param objName Object name of the MBean to query.
-   * @param pd      Preset naming components. The members host, plugin and
-   *                plugin instance will be used.
+   * @param conn       Connection to the MBeanServer.
+   * @param objName    Object name of the MBean to query.
+   * @param pd         Preset naming components. The members host, plugin and
+   *                   plugin instance will be used.
+   * @param batch      The values are added to this batch; the caller
+   *                   dispatches it.
+   * @param attrValues Attribute values already fetched from the MBean, keyed
+   *                   by attribute name. Other attributes are queried
+   *                   individually. May be null.
    */
   public void query (MBeanServerConnection conn, ObjectName objName, /* {{{ */
-      PluginData pd)
+      PluginData pd, ValueListBatch.Builder batch,
+      Map<String,Object> attrValues)
   {
     ValueList vl;
     List<DataSource> dsrc;
@@ -643,7 +672,7 @@ class GenericJMXConfValue
     {
       Object v;
 
-      v = queryAttribute (conn, objName, this._attributes.get (i));
+      v = queryAttribute (conn, objName, this._attributes.get (i), attrValues);
       if (v == null)
       {
         Collectd.logError ("GenericJMXConfValue.query: "
@@ -655,9 +684,9 @@ class GenericJMXConfValue
     }
 
     if (this._is_table)
-      submitTable (values, vl, instancePrefix);
+      submitTable (values, vl, instancePrefix, batch);
     else
-      submitScalar (values, vl, instancePrefix);
+      submitScalar (values, vl, instancePrefix, batch);
   } /* }}} void query */
 } /* class GenericJMXConfValue */
 
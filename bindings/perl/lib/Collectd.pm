@@ -54,6 +54,7 @@ our %EXPORT_TAGS = (
 			TYPE_INIT
 			TYPE_READ
 			TYPE_WRITE
+			TYPE_WRITE_BATCH
 			TYPE_SHUTDOWN
 			TYPE_LOG
 			TYPE_NOTIF
@@ -124,7 +125,8 @@ my %types = (
 	TYPE_SHUTDOWN, "shutdown",
 	TYPE_LOG,      "log",
 	TYPE_NOTIF,    "notify",
-	TYPE_FLUSH,    "flush"
+	TYPE_FLUSH,    "flush",
+	TYPE_WRITE_BATCH, "write_batch"
 );
 
 my %fc_types = (
@@ -289,6 +291,9 @@ sub plugin_register {
 		if (TYPE_WRITE == $type) {
 			return plugin_register_write($name, $data);
 		}
+		if (TYPE_WRITE_BATCH == $type) {
+			return plugin_register_write_batch($name, $data);
+		}
 		if (TYPE_LOG == $type) {
 			return plugin_register_log($name, $data);
 		}
@@ -333,7 +338,7 @@ sub plugin_unregister {
 	elsif (TYPE_READ == $type) {
 		return plugin_unregister_read ($name);
 	}
-	elsif (TYPE_WRITE == $type) {
+	elsif ((TYPE_WRITE == $type) || (TYPE_WRITE_BATCH == $type)) {
 		return plugin_unregister_write($name);
 	}
 	elsif (TYPE_LOG == $type) {
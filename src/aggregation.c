@@ -36,6 +36,11 @@
 #define AGG_MATCHES_ALL(str) (strcmp("/.*/", str) == 0)
 #define AGG_FUNC_PLACEHOLDER "%{aggregation}"
 
+/* Number of partial aggregates per instance. Each thread always updates the
+ * same partial of an instance, so write threads feeding the same instance
+ * don't contend on one lock. agg_instance_read merges the partials. */
+#define AGG_PARTIALS_NUM 8
+
 struct aggregation_s /* {{{ */
 {
   lookup_identifier_t ident;
@@ -57,14 +62,9 @@ struct aggregation_s /* {{{ */
 }; /* }}} */
 typedef struct aggregation_s aggregation_t;
 
-struct agg_instance_s;
-typedef struct agg_instance_s agg_instance_t;
-struct agg_instance_s /* {{{ */
+struct agg_partial_s /* {{{ */
 {
   pthread_mutex_t lock;
-  lookup_identifier_t ident;
-
-  int ds_type;
 
   derive_t num;
   gauge_t sum;
@@ -72,6 +72,20 @@ struct agg_instance_s /* {{{ */
 
   gauge_t min;
   gauge_t max;
+}; /* }}} */
+typedef struct agg_partial_s agg_partial_t;
+
+struct agg_instance_s;
+typedef struct agg_instance_s agg_instance_t;
+struct agg_instance_s /* {{{ */
+{
+  /* Protects the "state_*" fields, which are only used when reading. */
+  pthread_mutex_t lock;
+  lookup_identifier_t ident;
+
+  int ds_type;
+
+  agg_partial_t partials[AGG_PARTIALS_NUM];
 
   rate_to_value_state_t *state_num;
   rate_to_value_state_t *state_sum;
@@ -88,6 +102,12 @@ static lookup_t *lookup;
 static pthread_mutex_t agg_instance_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static agg_instance_t *agg_instance_list_head;
 
+/* Maps threads to partials, see agg_partial_index(). */
+static pthread_key_t agg_partial_key;
+static pthread_once_t agg_partial_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t agg_partial_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t agg_partial_next;
+
 static bool agg_is_regex(char const *str) /* {{{ */
 {
   if (str == NULL)
@@ -103,6 +123,40 @@ static bool agg_is_regex(char const *str) /* {{{ */
     return false;
 } /* }}} bool agg_is_regex */
 
+static void agg_partial_init(void) /* {{{ */
+{
+  pthread_key_create(&agg_partial_key, /* destructor = */ NULL);
+} /* }}} void agg_partial_init */
+
+/* Returns the index of the calling thread's partial. Threads are assigned
+ * partials round-robin when they first update an instance. */
+static size_t agg_partial_index(void) /* {{{ */
+{
+  pthread_once(&agg_partial_once, agg_partial_init);
+
+  /* The index is stored plus one, so that NULL means "not yet assigned". */
+  uintptr_t index = (uintptr_t)pthread_getspecific(agg_partial_key);
+  if (index != 0)
+    return (size_t)(index - 1);
+
+  pthread_mutex_lock(&agg_partial_lock);
+  index = (uintptr_t)(agg_partial_next % AGG_PARTIALS_NUM);
+  agg_partial_next++;
+  pthread_mutex_unlock(&agg_partial_lock);
+
+  pthread_setspecific(agg_partial_key, (void *)(index + 1));
+  return (size_t)index;
+} /* }}} size_t agg_partial_index */
+
+static void agg_partial_reset(agg_partial_t *p) /* {{{ */
+{
+  p->num = 0;
+  p->sum = 0.0;
+  p->squares_sum = 0.0;
+  p->min = NAN;
+  p->max = NAN;
+} /* }}} void agg_partial_reset */
+
 static void agg_destroy(aggregation_t *agg) /* {{{ */
 {
   sfree(agg);
@@ -134,10 +188,12 @@ static void agg_instance_destroy(agg_instance_t *inst) /* {{{ */
   sfree(inst->state_max);
   sfree(inst->state_stddev);
 
+  for (size_t i = 0; i < AGG_PARTIALS_NUM; i++)
+    pthread_mutex_destroy(&inst->partials[i].lock);
+  pthread_mutex_destroy(&inst->lock);
+
   memset(inst, 0, sizeof(*inst));
   inst->ds_type = -1;
-  inst->min = NAN;
-  inst->max = NAN;
 } /* }}} void agg_instance_destroy */
 
 static int agg_instance_create_name(agg_instance_t *inst, /* {{{ */
@@ -238,8 +294,10 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
 
   agg_instance_create_name(inst, vl, agg);
 
-  inst->min = NAN;
-  inst->max = NAN;
+  for (size_t i = 0; i < AGG_PARTIALS_NUM; i++) {
+    pthread_mutex_init(&inst->partials[i].lock, /* attr = */ NULL);
+    agg_partial_reset(inst->partials + i);
+  }
 
 #define INIT_STATE(field)                                                      \
   do {                                                                         \
@@ -300,18 +358,19 @@ static int agg_instance_update(agg_instance_t *inst, /* {{{ */
     return 0;
   }
 
-  pthread_mutex_lock(&inst->lock);
+  agg_partial_t *p = inst->partials + agg_partial_index();
+  pthread_mutex_lock(&p->lock);
 
-  inst->num++;
-  inst->sum += rate[0];
-  inst->squares_sum += (rate[0] * rate[0]);
+  p->num++;
+  p->sum += rate[0];
+  p->squares_sum += (rate[0] * rate[0]);
 
-  if (isnan(inst->min) || (inst->min > rate[0]))
-    inst->min = rate[0];
-  if (isnan(inst->max) || (inst->max < rate[0]))
-    inst->max = rate[0];
+  if (isnan(p->min) || (p->min > rate[0]))
+    p->min = rate[0];
+  if (isnan(p->max) || (p->max < rate[0]))
+    p->max = rate[0];
 
-  pthread_mutex_unlock(&inst->lock);
+  pthread_mutex_unlock(&p->lock);
 
   sfree(rate);
   return 0;
@@ -353,8 +412,10 @@ static int agg_instance_read_func(agg_instance_t *inst, /* {{{ */
   return 0;
 } /* }}} int agg_instance_read_func */
 
-static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
-{
+/* "meta" is shared by all instances read in one go; it's copied when the
+ * values are dispatched. */
+static int agg_instance_read(agg_instance_t *inst, cdtime_t t, /* {{{ */
+                             meta_data_t *meta) {
   value_list_t vl = VALUE_LIST_INIT;
 
   /* Pre-set all the fields in the value list that will not change per
@@ -363,13 +424,7 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
 
   vl.time = t;
   vl.interval = 0;
-
-  vl.meta = meta_data_create();
-  if (vl.meta == NULL) {
-    ERROR("aggregation plugin: meta_data_create failed.");
-    return -1;
-  }
-  meta_data_add_boolean(vl.meta, "aggregation:created", 1);
+  vl.meta = meta;
 
   sstrncpy(vl.host, inst->ident.host, sizeof(vl.host));
   sstrncpy(vl.plugin, inst->ident.plugin, sizeof(vl.plugin));
@@ -385,35 +440,46 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
     }                                                                          \
   } while (0)
 
+  /* Merge and reset the partials. Each of them is only locked while it's
+   * being copied. */
+  agg_partial_t total;
+  agg_partial_reset(&total);
+  for (size_t i = 0; i < AGG_PARTIALS_NUM; i++) {
+    agg_partial_t *p = inst->partials + i;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->num > 0) {
+      total.num += p->num;
+      total.sum += p->sum;
+      total.squares_sum += p->squares_sum;
+      if (isnan(total.min) || (total.min > p->min))
+        total.min = p->min;
+      if (isnan(total.max) || (total.max < p->max))
+        total.max = p->max;
+      agg_partial_reset(p);
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+
   pthread_mutex_lock(&inst->lock);
 
-  READ_FUNC(num, (gauge_t)inst->num);
+  READ_FUNC(num, (gauge_t)total.num);
 
   /* All other aggregations are only defined when there have been any values
    * at all. */
-  if (inst->num > 0) {
-    READ_FUNC(sum, inst->sum);
-    READ_FUNC(average, (inst->sum / ((gauge_t)inst->num)));
-    READ_FUNC(min, inst->min);
-    READ_FUNC(max, inst->max);
+  if (total.num > 0) {
+    READ_FUNC(sum, total.sum);
+    READ_FUNC(average, (total.sum / ((gauge_t)total.num)));
+    READ_FUNC(min, total.min);
+    READ_FUNC(max, total.max);
     READ_FUNC(stddev,
-              sqrt((((gauge_t)inst->num) * inst->squares_sum) -
-                   (inst->sum * inst->sum)) /
-                  ((gauge_t)inst->num));
+              sqrt((((gauge_t)total.num) * total.squares_sum) -
+                   (total.sum * total.sum)) /
+                  ((gauge_t)total.num));
   }
 
-  /* Reset internal state. */
-  inst->num = 0;
-  inst->sum = 0.0;
-  inst->squares_sum = 0.0;
-  inst->min = NAN;
-  inst->max = NAN;
-
   pthread_mutex_unlock(&inst->lock);
 
-  meta_data_destroy(vl.meta);
-  vl.meta = NULL;
-
   return 0;
 } /* }}} int agg_instance_read */
 
@@ -681,7 +747,13 @@ static int agg_read(void) /* {{{ */
   cdtime_t t = cdtime();
   int success = 0;
 
+  /* New instances are only ever added at the head of the list, and instances
+   * are only removed when the lookup is destroyed. So the list lock is only
+   * needed to get the head; write threads creating instances are not blocked
+   * while the values are dispatched. */
   pthread_mutex_lock(&agg_instance_list_lock);
+  agg_instance_t *head = agg_instance_list_head;
+  pthread_mutex_unlock(&agg_instance_list_lock);
 
   /* agg_instance_list_head only holds data, after the "write" callback has
    * been called with a matching value list at least once. So on startup,
@@ -689,14 +761,18 @@ static int agg_read(void) /* {{{ */
    * the read() callback is called first, agg_instance_list_head is NULL and
    * "success" may be zero. This is expected and should not result in an error.
    * Therefore we need to handle this case separately. */
-  if (agg_instance_list_head == NULL) {
-    pthread_mutex_unlock(&agg_instance_list_lock);
+  if (head == NULL)
     return 0;
+
+  meta_data_t *meta = meta_data_create();
+  if (meta == NULL) {
+    ERROR("aggregation plugin: meta_data_create failed.");
+    return -1;
   }
+  meta_data_add_boolean(meta, "aggregation:created", 1);
 
-  for (agg_instance_t *this = agg_instance_list_head; this != NULL;
-       this = this->next) {
-    int status = agg_instance_read(this, t);
+  for (agg_instance_t *this = head; this != NULL; this = this->next) {
+    int status = agg_instance_read(this, t, meta);
     if (status != 0)
       WARNING("aggregation plugin: Reading an aggregation instance "
               "failed with status %i.",
@@ -705,7 +781,7 @@ static int agg_read(void) /* {{{ */
       success++;
   }
 
-  pthread_mutex_unlock(&agg_instance_list_lock);
+  meta_data_destroy(meta);
 
   return (success > 0) ? 0 : -1;
 } /* }}} int agg_read */
@@ -62,6 +62,9 @@ int amqp_socket_close(amqp_socket_t *);
 
 #define CAMQP_CHANNEL 1
 
+#define CAMQP_BATCH_ROUTING_KEY "collectd"
+#define CAMQP_BATCH_TEXT_MIN 8192
+
 /*
  * Data types
  */
@@ -90,6 +93,14 @@ struct camqp_config_s {
   char *postfix;
   char escape_char;
   unsigned int graphite_flags;
+  /* publish & batch mode only */
+  int batch_size;
+  int batch_count;
+  cdtime_t batch_init_time;
+  format_json_buffer_t batch_json;
+  char *batch_text;
+  size_t batch_text_len;
+  size_t batch_text_size;
 
   /* subscribe only */
   char *exchange_type;
@@ -142,6 +153,10 @@ static void camqp_config_free(void *ptr) /* {{{ */
   if (conf == NULL)
     return;
 
+  /* A pending batch has been published by the shutdown flush. */
+  format_json_buffer_free(&conf->batch_json);
+  sfree(conf->batch_text);
+
   camqp_close_connection(conf);
 
   sfree(conf->name);
@@ -564,9 +579,17 @@ static int camqp_read_body(camqp_config_t *conf, /* {{{ */
   } /* while (received < body_size) */
 
   if (strcasecmp("text/collectd", content_type) == 0) {
-    status = cmd_handle_putval(stderr, body);
-    if (status != 0)
-      ERROR("amqp plugin: cmd_handle_putval failed with status %i.", status);
+    /* Batches hold one command per line. */
+    char *saveptr = NULL;
+    status = 0;
+    for (char *line = strtok_r(body, "\n", &saveptr); line != NULL;
+         line = strtok_r(NULL, "\n", &saveptr)) {
+      int tmp = cmd_handle_putval(stderr, line);
+      if (tmp != 0) {
+        ERROR("amqp plugin: cmd_handle_putval failed with status %i.", tmp);
+        status = tmp;
+      }
+    }
     return status;
   } else if (strcasecmp("application/json", content_type) == 0) {
     ERROR("amqp plugin: camqp_read_body: Parsing JSON data has not "
@@ -735,6 +758,113 @@ static int camqp_write_locked(camqp_config_t *conf, /* {{{ */
   return status;
 } /* }}} int camqp_write_locked */
 
+/* Batch mode: value lists are collected into one message, which is published
+ * once it holds "BatchSize" value lists or is older than the interval, and
+ * when the plugin is flushed. With the JSON format the message is a JSON
+ * array, with the other formats it holds one value list per line. */
+
+/* XXX: You must hold "conf->lock" when calling this function! */
+static int camqp_batch_publish_locked(camqp_config_t *conf) /* {{{ */
+{
+  char const *payload = conf->batch_text;
+  int status;
+
+  if (conf->batch_count == 0)
+    return 0;
+
+  if (conf->format == CAMQP_FORMAT_JSON) {
+    status = format_json_buffer_finalize(&conf->batch_json);
+    if (status != 0) {
+      ERROR("amqp plugin: format_json_buffer_finalize failed with status %i.",
+            status);
+      format_json_buffer_reset(&conf->batch_json);
+      conf->batch_count = 0;
+      return status;
+    }
+    payload = conf->batch_json.data;
+  }
+
+  /* All value lists of a batch share one routing key. */
+  status = camqp_write_locked(conf, payload,
+                              (conf->routing_key != NULL)
+                                  ? conf->routing_key
+                                  : CAMQP_BATCH_ROUTING_KEY);
+
+  format_json_buffer_reset(&conf->batch_json);
+  conf->batch_text_len = 0;
+  conf->batch_count = 0;
+
+  return status;
+} /* }}} int camqp_batch_publish_locked */
+
+/* XXX: You must hold "conf->lock" when calling this function! */
+static int camqp_batch_append_text(camqp_config_t *conf, /* {{{ */
+                                   char const *text) {
+  /* Graphite lines end in a newline already. */
+  bool separate =
+      (conf->format == CAMQP_FORMAT_COMMAND) && (conf->batch_text_len > 0);
+  size_t len = strlen(text);
+  size_t need = conf->batch_text_len + len + (separate ? 1 : 0) + 1;
+
+  if (need > conf->batch_text_size) {
+    size_t size = (conf->batch_text_size > 0) ? conf->batch_text_size
+                                              : CAMQP_BATCH_TEXT_MIN;
+    while (size < need)
+      size *= 2;
+
+    char *tmp = realloc(conf->batch_text, size);
+    if (tmp == NULL) {
+      ERROR("amqp plugin: realloc failed.");
+      return ENOMEM;
+    }
+    conf->batch_text = tmp;
+    conf->batch_text_size = size;
+  }
+
+  if (separate) {
+    conf->batch_text[conf->batch_text_len] = '\n';
+    conf->batch_text_len++;
+  }
+  memcpy(conf->batch_text + conf->batch_text_len, text, len + 1);
+  conf->batch_text_len += len;
+
+  return 0;
+} /* }}} int camqp_batch_append_text */
+
+/* Accounts for a value list added to the batch and publishes the batch if it
+ * is full or old enough.
+ * XXX: You must hold "conf->lock" when calling this function! */
+static int camqp_batch_added_locked(camqp_config_t *conf) /* {{{ */
+{
+  cdtime_t now = cdtime();
+
+  if (conf->batch_count == 0)
+    conf->batch_init_time = now;
+  conf->batch_count++;
+
+  if ((conf->batch_count >= conf->batch_size) ||
+      ((now - conf->batch_init_time) >= plugin_get_interval()))
+    return camqp_batch_publish_locked(conf);
+
+  return 0;
+} /* }}} int camqp_batch_added_locked */
+
+static int camqp_flush(cdtime_t timeout, /* {{{ */
+                       const char *identifier __attribute__((unused)),
+                       user_data_t *user_data) {
+  camqp_config_t *conf = user_data->data;
+  int status = 0;
+
+  pthread_mutex_lock(&conf->lock);
+  /* timeout == 0  => flush unconditionally */
+  if ((conf->batch_count > 0) &&
+      ((timeout == 0) || ((conf->batch_init_time + timeout) <= cdtime())))
+    status = camqp_batch_publish_locked(conf);
+  pthread_mutex_unlock(&conf->lock);
+
+  return status;
+} /* }}} int camqp_flush */
+
 static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
                        user_data_t *user_data) {
   camqp_config_t *conf = user_data->data;
@@ -745,21 +875,18 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   if ((ds == NULL) || (vl == NULL) || (conf == NULL))
     return EINVAL;
 
-  if (conf->routing_key != NULL) {
-    sstrncpy(routing_key, conf->routing_key, sizeof(routing_key));
-  } else {
-    snprintf(routing_key, sizeof(routing_key), "collectd/%s/%s/%s/%s/%s",
-             vl->host, vl->plugin, vl->plugin_instance, vl->type,
-             vl->type_instance);
-
-    /* Switch slashes (the only character forbidden by collectd) and dots
-     * (the separation character used by AMQP). */
-    for (size_t i = 0; routing_key[i] != 0; i++) {
-      if (routing_key[i] == '.')
-        routing_key[i] = '/';
-      else if (routing_key[i] == '/')
-        routing_key[i] = '.';
-    }
+  /* JSON batches are formatted in place. */
+  if ((conf->batch_size > 1) && (conf->format == CAMQP_FORMAT_JSON)) {
+    pthread_mutex_lock(&conf->lock);
+    status =
+        format_json_buffer_add(&conf->batch_json, ds, vl, conf->store_rates);
+    if (status != 0)
+      ERROR("amqp plugin: format_json_buffer_add failed with status %i.",
+            status);
+    else
+      status = camqp_batch_added_locked(conf);
+    pthread_mutex_unlock(&conf->lock);
+    return status;
   }
 
   if (conf->format == CAMQP_FORMAT_COMMAND) {
@@ -788,6 +915,32 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     return -1;
   }
 
+  if (conf->batch_size > 1) {
+    pthread_mutex_lock(&conf->lock);
+    status = camqp_batch_append_text(conf, buffer);
+    if (status == 0)
+      status = camqp_batch_added_locked(conf);
+    pthread_mutex_unlock(&conf->lock);
+    return status;
+  }
+
+  if (conf->routing_key != NULL) {
+    sstrncpy(routing_key, conf->routing_key, sizeof(routing_key));
+  } else {
+    snprintf(routing_key, sizeof(routing_key), "collectd/%s/%s/%s/%s/%s",
+             vl->host, vl->plugin, vl->plugin_instance, vl->type,
+             vl->type_instance);
+
+    /* Switch slashes (the only character forbidden by collectd) and dots
+     * (the separation character used by AMQP). */
+    for (size_t i = 0; routing_key[i] != 0; i++) {
+      if (routing_key[i] == '.')
+        routing_key[i] = '/';
+      else if (routing_key[i] == '/')
+        routing_key[i] = '.';
+    }
+  }
+
   pthread_mutex_lock(&conf->lock);
   status = camqp_write_locked(conf, buffer, routing_key);
   pthread_mutex_unlock(&conf->lock);
@@ -856,6 +1009,9 @@ static int camqp_config_connection(oconfig_item_t *ci, /* {{{ */
   conf->prefix = NULL;
   conf->postfix = NULL;
   conf->escape_char = '_';
+  /* publish & batch mode only */
+  conf->batch_size = 1;
+  conf->batch_json = (format_json_buffer_t)FORMAT_JSON_BUFFER_INIT;
   /* subscribe only */
   conf->exchange_type = NULL;
   conf->queue = NULL;
@@ -914,6 +1070,13 @@ static int camqp_config_connection(oconfig_item_t *ci, /* {{{ */
                              GRAPHITE_STORE_RATES);
     } else if ((strcasecmp("Format", child->key) == 0) && publish)
       status = camqp_config_set_format(child, conf);
+    else if ((strcasecmp("BatchSize", child->key) == 0) && publish) {
+      status = cf_util_get_int(child, &conf->batch_size);
+      if ((status == 0) && (conf->batch_size < 1)) {
+        ERROR("amqp plugin: \"BatchSize\" must be at least 1.");
+        status = EINVAL;
+      }
+    }
     else if ((strcasecmp("GraphiteSeparateInstances", child->key) == 0) &&
              publish)
       status = cf_util_get_flag(child, &conf->graphite_flags,
@@ -981,6 +1144,12 @@ static int camqp_config_connection(oconfig_item_t *ci, /* {{{ */
       camqp_config_free(conf);
       return status;
     }
+
+    if (conf->batch_size > 1)
+      plugin_register_flush(cbname, camqp_flush,
+                            &(user_data_t){
+                                .data = conf,
+                            });
   } else {
     status = camqp_subscribe_init(conf);
     if (status != 0) {
@@ -28,6 +28,8 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_fetch/curl_fetch.h"
+#include "utils/curl_stats/curl_stats.h"
 
 #include <curl/curl.h>
 
@@ -51,10 +53,16 @@ struct apache_s {
   size_t apache_buffer_fill;
   int timeout;
   CURL *curl;
+  curl_stats_t *stats;
 }; /* apache_s */
 
 typedef struct apache_s apache_t;
 
+/* If greater than zero, all instances are fetched concurrently by one fetch
+ * engine, which opens at most this many connections. */
+static int max_connections;
+static curl_fetch_t *fetch;
+
 /* TODO: Remove this prototype */
 static int apache_read_host(user_data_t *user_data);
 
@@ -64,6 +72,11 @@ static void apache_free(void *arg) {
   if (st == NULL)
     return;
 
+  /* The engine's thread may be using any instance, so it is stopped before
+   * the first instance is freed. */
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+
   sfree(st->name);
   sfree(st->host);
   sfree(st->url);
@@ -77,6 +90,7 @@ static void apache_free(void *arg) {
     curl_easy_cleanup(st->curl);
     st->curl = NULL;
   }
+  curl_stats_destroy(st->stats);
   sfree(st);
 } /* apache_free */
 
@@ -145,6 +159,7 @@ static size_t apache_header_callback(void *buf, size_t size, size_t nmemb,
 
 /* Configuration handling functiions
  * <Plugin apache>
+ *   MaxConnections ...
  *   <Instance "instance_name">
  *     URL ...
  *   </Instance>
@@ -190,7 +205,12 @@ static int config_add(oconfig_item_t *ci) {
       status = cf_util_get_string(child, &st->server);
     else if (strcasecmp("Timeout", child->key) == 0)
       status = cf_util_get_int(child, &st->timeout);
-    else {
+    else if (strcasecmp("Statistics", child->key) == 0) {
+      curl_stats_destroy(st->stats);
+      st->stats = curl_stats_from_config(child);
+      if (st->stats == NULL)
+        status = -1;
+    } else {
       WARNING("apache plugin: Option `%s' not allowed here.", child->key);
       status = -1;
     }
@@ -234,7 +254,13 @@ static int config(oconfig_item_t *ci) {
 
     if (strcasecmp("Instance", child->key) == 0)
       config_add(child);
-    else
+    else if (strcasecmp("MaxConnections", child->key) == 0) {
+      if ((cf_util_get_int(child, &max_connections) == 0) &&
+          (max_connections < 0)) {
+        WARNING("apache plugin: `MaxConnections' must not be negative.");
+        max_connections = 0;
+      }
+    } else
       WARNING("apache plugin: The configuration option "
               "\"%s\" is not allowed here. Did you "
               "forget to add an <Instance /> block "
@@ -464,24 +490,13 @@ static void submit_scoreboard(char *buf, apache_t *st) {
   }
 }
 
-static int apache_read_host(user_data_t *user_data) /* {{{ */
+/* apache_process handles a completed transfer of "st". It is called by the
+ * read callback or, if the fetch engine is used, by the engine's thread. */
+static int apache_process(apache_t *st, CURLcode curl_status) /* {{{ */
 {
-  apache_t *st = user_data->data;
-
-  assert(st->url != NULL);
-  /* (Assured by `config_add') */
-
-  if (st->curl == NULL) {
-    if (init_host(st) != 0)
-      return -1;
-  }
-  assert(st->curl != NULL);
-
-  st->apache_buffer_fill = 0;
-
-  curl_easy_setopt(st->curl, CURLOPT_URL, st->url);
+  curl_stats_dispatch(st->stats, st->curl, st->host, "apache", st->name);
 
-  if (curl_easy_perform(st->curl) != CURLE_OK) {
+  if (curl_status != CURLE_OK) {
     ERROR("apache: curl_easy_perform failed: %s", st->apache_curl_error);
     return -1;
   }
@@ -533,9 +548,54 @@ static int apache_read_host(user_data_t *user_data) /* {{{ */
     }
   }
 
+  return 0;
+} /* }}} int apache_process */
+
+static void apache_fetch_done(CURL *curl, CURLcode status, /* {{{ */
+                              void *user_data) {
+  apache_t *st = user_data;
+
+  apache_process(st, status);
   st->apache_buffer_fill = 0;
+} /* }}} void apache_fetch_done */
 
-  return 0;
+static int apache_read_host(user_data_t *user_data) /* {{{ */
+{
+  apache_t *st = user_data->data;
+
+  assert(st->url != NULL);
+  /* (Assured by `config_add') */
+
+  if (st->curl == NULL) {
+    if (init_host(st) != 0)
+      return -1;
+    curl_easy_setopt(st->curl, CURLOPT_URL, st->url);
+  }
+  assert(st->curl != NULL);
+
+  if (fetch != NULL) {
+    /* Until the transfer is done, the instance belongs to the engine's
+     * thread, which also resets the buffer. */
+    int status = curl_fetch_submit(fetch, st->curl, apache_curl_callback,
+                                   apache_fetch_done, st);
+    if (status == EBUSY) {
+      WARNING("apache plugin: The previous transfer of instance \"%s\" has "
+              "not completed yet.",
+              st->name);
+      return -1;
+    } else if (status != 0) {
+      ERROR("apache plugin: curl_fetch_submit failed: %s", STRERROR(status));
+      return -1;
+    }
+    return 0;
+  }
+
+  st->apache_buffer_fill = 0;
+
+  int status = apache_process(st, curl_easy_perform(st->curl));
+  st->apache_buffer_fill = 0;
+
+  return status;
 } /* }}} int apache_read_host */
 
 static int apache_init(void) /* {{{ */
@@ -543,10 +603,25 @@ static int apache_init(void) /* {{{ */
   /* Call this while collectd is still single-threaded to avoid
    * initialization issues in libgcrypt. */
   curl_global_init(CURL_GLOBAL_SSL);
+
+  if ((max_connections > 0) && (fetch == NULL)) {
+    fetch = curl_fetch_create("apache", max_connections);
+    if (fetch == NULL)
+      return -1;
+  }
+
   return 0;
 } /* }}} int apache_init */
 
+static int apache_shutdown(void) /* {{{ */
+{
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+  return 0;
+} /* }}} int apache_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("apache", config);
   plugin_register_init("apache", apache_init);
+  plugin_register_shutdown("apache", apache_shutdown);
 } /* void module_register */
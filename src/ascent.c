@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
 
 #include <curl/curl.h>
 #include <libxml/parser.h>
@@ -96,6 +97,7 @@ static char *cacert;
 static char *timeout;
 
 static CURL *curl;
+static curl_stats_t *stats;
 
 static char *ascent_buffer;
 static size_t ascent_buffer_size;
@@ -103,7 +105,8 @@ static size_t ascent_buffer_fill;
 static char ascent_curl_error[CURL_ERROR_SIZE];
 
 static const char *config_keys[] = {
-    "URL", "User", "Password", "VerifyPeer", "VerifyHost", "CACert", "Timeout",
+    "URL",    "User",    "Password",          "VerifyPeer", "VerifyHost",
+    "CACert", "Timeout", "LatencyPercentile",
 };
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
@@ -465,7 +468,15 @@ static int ascent_config(const char *key, const char *value) /* {{{ */
     return config_set(&cacert, value);
   else if (strcasecmp(key, "Timeout") == 0)
     return config_set(&timeout, value);
-  else
+  else if (strcasecmp(key, "LatencyPercentile") == 0) {
+    char *endptr = NULL;
+    double percent = strtod(value, &endptr);
+    if ((endptr == value) || (*endptr != 0)) {
+      ERROR("ascent plugin: Invalid LatencyPercentile: %s", value);
+      return -1;
+    }
+    return curl_stats_add_percentile(&stats, percent);
+  } else
     return -1;
 } /* }}} int ascent_config */
 
@@ -556,7 +567,9 @@ static int ascent_read(void) /* {{{ */
 
   curl_easy_setopt(curl, CURLOPT_URL, url);
 
-  if (curl_easy_perform(curl) != CURLE_OK) {
+  CURLcode curl_status = curl_easy_perform(curl);
+  curl_stats_dispatch(stats, curl, NULL, "ascent", NULL);
+  if (curl_status != CURLE_OK) {
     ERROR("ascent plugin: curl_easy_perform failed: %s", ascent_curl_error);
     return -1;
   }
@@ -0,0 +1,168 @@
+/**
+ * collectd - src/bench/bench_latency.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Write plugin used by "make bench", see daemon_bench.sh. It is not
+ * installed. For every value list it records the time between the value's
+ * time stamp, set by collectd-tg when sending it, and the write callback.
+ * Once per interval one line is appended to "OutputFile":
+ *
+ *   <time> <values> <p50> <p90> <p99> <p99.9> <max> <queue length>
+ *   <dropped> <rss>
+ *
+ * Latencies are in seconds, "dropped" is the daemon's total of values dropped
+ * from the write queue and "rss" the resident set size in bytes. */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/latency/latency.h"
+
+static char *output_file;
+
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static latency_counter_t *bench_latency;
+static gauge_t bench_dropped = NAN;
+
+static const char *config_keys[] = {"OutputFile"};
+static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
+
+static int bench_config(const char *key, const char *value) /* {{{ */
+{
+  if (strcasecmp("OutputFile", key) == 0) {
+    sfree(output_file);
+    output_file = strdup(value);
+    return (output_file == NULL) ? -1 : 0;
+  }
+
+  return -1;
+} /* }}} int bench_config */
+
+static int bench_write(const data_set_t *ds, /* {{{ */
+                       const value_list_t *vl,
+                       user_data_t __attribute__((unused)) * ud) {
+  /* The daemon's own statistics are not part of the generated load. */
+  if (strcmp("collectd", vl->plugin) == 0) {
+    if ((strcmp("write_queue", vl->plugin_instance) == 0) &&
+        (strcmp("dropped", vl->type_instance) == 0)) {
+      pthread_mutex_lock(&bench_lock);
+      bench_dropped = vl->values[0].gauge;
+      pthread_mutex_unlock(&bench_lock);
+    }
+    return 0;
+  }
+
+  cdtime_t now = cdtime();
+  cdtime_t latency = (now > vl->time) ? (now - vl->time) : 0;
+
+  pthread_mutex_lock(&bench_lock);
+  latency_counter_add(bench_latency, latency);
+  pthread_mutex_unlock(&bench_lock);
+
+  return 0;
+} /* }}} int bench_write */
+
+static double bench_rss(void) /* {{{ */
+{
+#if KERNEL_LINUX
+  FILE *fh = fopen("/proc/self/statm", "r");
+  if (fh == NULL)
+    return NAN;
+
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  int status = fscanf(fh, "%llu %llu", &size, &resident);
+  fclose(fh);
+  if (status != 2)
+    return NAN;
+
+  return (double)resident * (double)sysconf(_SC_PAGESIZE);
+#else
+  return NAN;
+#endif
+} /* }}} double bench_rss */
+
+static int bench_read(void) /* {{{ */
+{
+  pthread_mutex_lock(&bench_lock);
+  size_t num = latency_counter_get_num(bench_latency);
+  double pct[] = {
+      CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(bench_latency, 50.0)),
+      CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(bench_latency, 90.0)),
+      CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(bench_latency, 99.0)),
+      CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(bench_latency, 99.9)),
+      CDTIME_T_TO_DOUBLE(latency_counter_get_max(bench_latency)),
+  };
+  gauge_t dropped = bench_dropped;
+  latency_counter_reset(bench_latency);
+  pthread_mutex_unlock(&bench_lock);
+
+  FILE *fh = fopen(output_file, "a");
+  if (fh == NULL) {
+    ERROR("bench_latency plugin: fopen (%s) failed: %s", output_file,
+          STRERRNO);
+    return -1;
+  }
+
+  fprintf(fh, "%.3f %zu %.6f %.6f %.6f %.6f %.6f %ld %.0f %.0f\n",
+          CDTIME_T_TO_DOUBLE(cdtime()), num, pct[0], pct[1], pct[2], pct[3],
+          pct[4], plugin_get_write_queue_length(), dropped, bench_rss());
+  fclose(fh);
+
+  return 0;
+} /* }}} int bench_read */
+
+static int bench_init(void) /* {{{ */
+{
+  if (output_file == NULL) {
+    ERROR("bench_latency plugin: The \"OutputFile\" option is required.");
+    return -1;
+  }
+
+  bench_latency = latency_counter_create_sketch(/* relative_accuracy = */ 0.01);
+  if (bench_latency == NULL) {
+    ERROR("bench_latency plugin: latency_counter_create_sketch failed.");
+    return -1;
+  }
+
+  plugin_register_write("bench_latency", bench_write, /* user_data = */ NULL);
+  plugin_register_read("bench_latency", bench_read);
+
+  return 0;
+} /* }}} int bench_init */
+
+static int bench_shutdown(void) /* {{{ */
+{
+  latency_counter_destroy(bench_latency);
+  bench_latency = NULL;
+  sfree(output_file);
+
+  return 0;
+} /* }}} int bench_shutdown */
+
+void module_register(void) {
+  plugin_register_config("bench_latency", bench_config, config_keys,
+                         config_keys_num);
+  plugin_register_init("bench_latency", bench_init);
+  plugin_register_shutdown("bench_latency", bench_shutdown);
+} /* void module_register */
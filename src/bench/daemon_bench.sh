@@ -0,0 +1,290 @@
+#!/bin/sh
+#
+# collectd - src/bench/daemon_bench.sh
+# Copyright (C) 2026       collectd contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+#
+# End-to-end throughput benchmark of the daemon, run by "make bench".
+#
+# For every scenario a collectd daemon is started from the build directory
+# and collectd-tg sends values to it at each of the rates in RATES, for
+# DURATION seconds per rate. The bench_latency plugin records the time from
+# sending a value to its write callback. One line is printed per scenario and
+# rate:
+#
+#   rate      offered values/s
+#   recv/s    values/s that reached the write callbacks
+#   lost      share of the values sent by collectd-tg that never reached the
+#             write callbacks, e.g. because the socket buffer overflowed
+#   p50 p99 p99.9 max
+#             latency from collectd-tg to the write callback, in ms
+#   queue     largest write queue length seen
+#   dropped   values dropped from the write queue during the run
+#   rss       largest resident set size of the daemon, in MiB
+#
+# Usage: daemon_bench.sh [scenario ...]
+#
+# A scenario is "<input>-<output>", where input is "network" or "unixsock"
+# and output is "csv", "write_prometheus" or "rrdtool". By default
+# "network-csv", "network-write_prometheus" and "unixsock-rrdtool" are run;
+# scenarios whose plugins have not been built are skipped. The following
+# environment variables are used:
+#
+#   BUILDDIR  build directory containing collectd and collectd-tg (".")
+#   SRCDIR    source directory containing src/types.db (".")
+#   RATES     values per second to send ("1000 10000 50000 100000")
+#   DURATION  seconds per rate (10)
+#   HOSTS     number of hosts collectd-tg emulates (100)
+#   TG_THREADS
+#             number of generator threads of collectd-tg (1)
+#   CHURN     share of the identifiers collectd-tg replaces every second (0)
+#   NET_PORT  port of the network plugin (25827)
+#   PROM_PORT port of the write_prometheus plugin (9104)
+
+BUILDDIR="${BUILDDIR:-.}"
+SRCDIR="${SRCDIR:-.}"
+RATES="${RATES:-1000 10000 50000 100000}"
+DURATION="${DURATION:-10}"
+HOSTS="${HOSTS:-100}"
+TG_THREADS="${TG_THREADS:-1}"
+CHURN="${CHURN:-0}"
+NET_PORT="${NET_PORT:-25827}"
+PROM_PORT="${PROM_PORT:-9104}"
+
+BUILDDIR="$(cd "$BUILDDIR" && pwd)"
+SRCDIR="$(cd "$SRCDIR" && pwd)"
+PLUGINDIR="$BUILDDIR/.libs"
+
+COLLECTD_PID=""
+TG_PID=""
+WORKDIR=""
+
+cleanup() {
+  if [ -n "$TG_PID" ]; then
+    kill "$TG_PID" 2>/dev/null
+    wait "$TG_PID" 2>/dev/null
+  fi
+  if [ -n "$COLLECTD_PID" ]; then
+    kill "$COLLECTD_PID" 2>/dev/null
+    wait "$COLLECTD_PID" 2>/dev/null
+  fi
+  if [ -n "$WORKDIR" ]; then
+    rm -rf "$WORKDIR"
+  fi
+  TG_PID=""
+  COLLECTD_PID=""
+  WORKDIR=""
+}
+trap 'cleanup; exit 1' INT TERM
+
+have_plugin() {
+  test -f "$PLUGINDIR/$1.so"
+}
+
+# write_config <scenario> <directory>
+write_config() {
+  input="${1%%-*}"
+  output="${1#*-}"
+  dir="$2"
+
+  cat <<EOF
+Interval 1
+CollectInternalStats true
+BaseDir "$dir"
+PIDFile "$dir/collectd.pid"
+PluginDir "$PLUGINDIR"
+TypesDB "$SRCDIR/src/types.db"
+
+LoadPlugin logfile
+<Plugin logfile>
+  File "$dir/collectd.log"
+</Plugin>
+
+LoadPlugin bench_latency
+<Plugin bench_latency>
+  OutputFile "$dir/bench.log"
+</Plugin>
+
+LoadPlugin $input
+LoadPlugin $output
+EOF
+
+  case "$input" in
+  network)
+    cat <<EOF
+<Plugin network>
+  Listen "127.0.0.1" "$NET_PORT"
+</Plugin>
+EOF
+    ;;
+  unixsock)
+    cat <<EOF
+<Plugin unixsock>
+  SocketFile "$dir/collectd.sock"
+</Plugin>
+EOF
+    ;;
+  esac
+
+  case "$output" in
+  csv)
+    cat <<EOF
+<Plugin csv>
+  DataDir "$dir/csv"
+</Plugin>
+EOF
+    ;;
+  write_prometheus)
+    cat <<EOF
+<Plugin write_prometheus>
+  Host "127.0.0.1"
+  Port "$PROM_PORT"
+</Plugin>
+EOF
+    ;;
+  rrdtool)
+    cat <<EOF
+<Plugin rrdtool>
+  DataDir "$dir/rrd"
+</Plugin>
+EOF
+    ;;
+  esac
+}
+
+# summarize <bench.log> <start> <end> <rate> <sent> <tg start> <drained>
+summarize() {
+  awk -v start="$2" -v end="$3" -v rate="$4" -v sent="$5" -v tg_start="$6" \
+    -v drained="$7" '
+    $1 >= tg_start && $1 <= drained {
+      received += $2
+    }
+    $1 >= start && $1 <= end {
+      n++
+      values += $2
+      p50 += $3
+      if ($5 > p99) p99 = $5
+      if ($6 > p999) p999 = $6
+      if ($7 > max) max = $7
+      if ($8 > queue) queue = $8
+      if (first_dropped == "") first_dropped = $9
+      last_dropped = $9
+      if ($10 > rss) rss = $10
+    }
+    END {
+      if (n == 0) {
+        printf "%10d %10s\n", rate, "no data"
+        exit
+      }
+      lost = (sent > 0) ? 100 * (sent - received) / sent : 0
+      if (lost < 0) lost = 0
+      printf "%10d %10.0f %7.1f%% %8.2f %8.2f %8.2f %8.2f %8d %8d %8.1f\n",
+        rate, values / n, lost, 1000 * p50 / n, 1000 * p99, 1000 * p999,
+        1000 * max, queue, last_dropped - first_dropped, rss / 1048576
+    }' "$1"
+}
+
+# run_scenario <scenario>
+run_scenario() {
+  input="${1%%-*}"
+  output="${1#*-}"
+
+  for plugin in bench_latency "$input" "$output"; do
+    if ! have_plugin "$plugin"; then
+      echo "$1: skipped, the $plugin plugin has not been built."
+      return 0
+    fi
+  done
+
+  WORKDIR="$(mktemp -d "${TMPDIR:-/tmp}/collectd-bench.XXXXXX")" || return 1
+  write_config "$1" "$WORKDIR" >"$WORKDIR/collectd.conf"
+
+  "$BUILDDIR/collectd" -f -C "$WORKDIR/collectd.conf" &
+  COLLECTD_PID=$!
+
+  # Give the daemon time to open its sockets.
+  sleep 2
+  if ! kill -0 "$COLLECTD_PID" 2>/dev/null; then
+    echo "$1: collectd failed to start, see below."
+    cat "$WORKDIR/collectd.log"
+    COLLECTD_PID=""
+    cleanup
+    return 1
+  fi
+
+  echo
+  echo "$1:"
+  printf "%10s %10s %8s %8s %8s %8s %8s %8s %8s %8s\n" \
+    rate recv/s lost p50 p99 p99.9 max queue dropped rss
+
+  for rate in $RATES; do
+    tg_start="$(date +%s)"
+    if [ "$input" = "unixsock" ]; then
+      "$BUILDDIR/collectd-tg" -n "$rate" -H "$HOSTS" -i 1 -t "$TG_THREADS" \
+        -c "$CHURN" -s "$WORKDIR/collectd.sock" >"$WORKDIR/tg.out" 2>&1 &
+    else
+      "$BUILDDIR/collectd-tg" -n "$rate" -H "$HOSTS" -i 1 -t "$TG_THREADS" \
+        -c "$CHURN" -d 127.0.0.1 -D "$NET_PORT" >"$WORKDIR/tg.out" 2>&1 &
+    fi
+    TG_PID=$!
+
+    # Skip the first seconds, in which collectd-tg creates its values and
+    # the daemon creates its cache entries.
+    sleep 3
+    start="$(date +%s)"
+    sleep "$DURATION"
+    end="$(date +%s)"
+
+    kill "$TG_PID" 2>/dev/null
+    wait "$TG_PID" 2>/dev/null
+    TG_PID=""
+
+    # Let the write queue drain before the next rate.
+    sleep 2
+    drained="$(date +%s)"
+
+    sent="$(awk '/values have been sent/ { n = $1 } END { print n + 0 }' \
+      "$WORKDIR/tg.out")"
+    summarize "$WORKDIR/bench.log" "$start" "$end" "$rate" "$sent" \
+      "$tg_start" "$drained"
+  done
+
+  cleanup
+}
+
+if [ $# -eq 0 ]; then
+  set -- network-csv network-write_prometheus unixsock-rrdtool
+fi
+
+status=0
+for scenario in "$@"; do
+  case "$scenario" in
+  network-csv | network-write_prometheus | network-rrdtool) ;;
+  unixsock-csv | unixsock-write_prometheus | unixsock-rrdtool) ;;
+  *)
+    echo "Unknown scenario: $scenario" >&2
+    status=1
+    continue
+    ;;
+  esac
+  run_scenario "$scenario" || status=1
+done
+
+exit $status
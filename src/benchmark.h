@@ -0,0 +1,142 @@
+/**
+ * collectd - src/benchmark.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Helpers for the microbenchmarks, the "bench_*" programs built by
+ * "make bench_<name>". They are the counterpart of testing.h:
+ *
+ *   DEF_BENCH(insert) {
+ *     ... set up ...
+ *     BENCH_START;
+ *     for (size_t i = 0; i < ops; i++)
+ *       ... the operation measured ...
+ *     BENCH_STOP;
+ *     ... clean up ...
+ *   }
+ *
+ *   int main(int argc, char **argv) {
+ *     RUN_BENCH(insert, BENCH_OPS(argc, argv, 1000000));
+ *     END_BENCH;
+ *   }
+ *
+ * For every benchmark one line with the time and, with glibc, the number of
+ * calls to malloc, calloc and realloc per operation is printed. */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H 1
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t bench_allocations__;
+
+#if defined(__GLIBC__)
+#define BENCH_COUNTS_ALLOCATIONS 1
+/* Replacing the allocator like this is supported by glibc; the library itself
+ * calls these functions, too. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+  bench_allocations__++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  bench_allocations__++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  bench_allocations__++;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) { __libc_free(ptr); }
+#endif
+
+static double bench_time__;
+static uint64_t bench_allocs__;
+static struct timespec bench_start__;
+static uint64_t bench_start_allocs__;
+
+static double bench_elapsed__(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - bench_start__.tv_sec) +
+         ((double)(now.tv_nsec - bench_start__.tv_nsec)) / 1e9;
+}
+
+#define DEF_BENCH(func) static int bench_##func(size_t ops)
+
+/* Starts or restarts the measurement, so that setup code is not measured. */
+#define BENCH_START                                                            \
+  do {                                                                         \
+    bench_start_allocs__ = bench_allocations__;                                \
+    clock_gettime(CLOCK_MONOTONIC, &bench_start__);                            \
+  } while (0)
+
+#define BENCH_STOP                                                             \
+  do {                                                                         \
+    bench_time__ = bench_elapsed__();                                          \
+    bench_allocs__ = bench_allocations__ - bench_start_allocs__;               \
+  } while (0)
+
+#define RUN_BENCH(func, ops)                                                   \
+  do {                                                                         \
+    size_t ops__ = (ops);                                                      \
+    bench_time__ = 0.0;                                                        \
+    bench_allocs__ = 0;                                                        \
+    if (bench_##func(ops__) != 0) {                                            \
+      printf("%-32s FAILED\n", #func);                                         \
+      bench_fail_count__++;                                                    \
+      break;                                                                   \
+    }                                                                          \
+    bench_report__(#func, ops__);                                              \
+  } while (0)
+
+#define END_BENCH exit((bench_fail_count__ == 0) ? 0 : 1);
+
+/* Number of operations: the first argument or "def". */
+#define BENCH_OPS(argc, argv, def)                                             \
+  (((argc) > 1) ? (size_t)strtoull((argv)[1], NULL, 0) : (size_t)(def))
+
+static int bench_fail_count__;
+
+static void bench_report__(const char *name, size_t ops) {
+  if (ops == 0)
+    ops = 1;
+
+  printf("%-32s %10zu ops %12.1f ns/op", name, ops,
+         1e9 * bench_time__ / (double)ops);
+#if BENCH_COUNTS_ALLOCATIONS
+  printf(" %10.2f allocs/op\n", (double)bench_allocs__ / (double)ops);
+#else
+  printf(" %10s allocs/op\n", "n/a");
+#endif
+}
+
+#endif /* BENCHMARK_H */
@@ -45,6 +45,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
 
 #include <time.h>
 
@@ -56,6 +57,7 @@
 
 #include <curl/curl.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 #include <libxml/xpath.h>
 
 #ifndef BIND_DEFAULT_URL
@@ -102,6 +104,13 @@ struct list_info_ptr_s {
 };
 typedef struct list_info_ptr_s list_info_ptr_t;
 
+/* XPath expression compiled by bind_xpath_eval(). */
+struct bind_xpath_s {
+  const char *expression;
+  xmlXPathCompExpr *comp;
+};
+typedef struct bind_xpath_s bind_xpath_t;
+
 /* FIXME: Enabled by default for backwards compatibility. */
 /* TODO: Remove time parsing code. */
 static bool config_parse_time = true;
@@ -114,17 +123,23 @@ static _Bool global_zone_maint_stats = 1;
 static _Bool global_resolver_stats;
 static _Bool global_memory_stats = 1;
 static int timeout = -1;
+static bool config_streaming_parser;
 
 static cb_view_t *views;
 static size_t views_num;
 
 static CURL *curl;
+static curl_stats_t *stats;
 
 static char *bind_buffer;
 static size_t bind_buffer_size;
 static size_t bind_buffer_fill;
 static char bind_curl_error[CURL_ERROR_SIZE];
 
+/* All expressions are string literals, so there are only a few dozen. */
+static bind_xpath_t *xpath_cache;
+static size_t xpath_cache_num;
+
 /* Translation table for the `nsstats' values. */
 static const translation_info_t nsstats_translation_table[] = /* {{{ */
     {
@@ -378,11 +393,77 @@ static int bind_xml_read_gauge(xmlDoc *doc, xmlNode *node, /* {{{ */
   return 0;
 } /* }}} int bind_xml_read_gauge */
 
+/* Evaluates "xpath_expression", compiling it on first use. The compiled
+ * expressions are kept until shutdown; the read callback is the only user. */
+static xmlXPathObject *bind_xpath_eval(const char *xpath_expression, /* {{{ */
+                                       xmlXPathContext *xpathCtx) {
+  xmlXPathCompExpr *comp = NULL;
+
+  for (size_t i = 0; i < xpath_cache_num; i++) {
+    if (strcmp(xpath_expression, xpath_cache[i].expression) == 0) {
+      comp = xpath_cache[i].comp;
+      break;
+    }
+  }
+
+  if (comp == NULL) {
+    bind_xpath_t *tmp =
+        realloc(xpath_cache, sizeof(*xpath_cache) * (xpath_cache_num + 1));
+    if (tmp == NULL) {
+      ERROR("bind plugin: realloc failed.");
+      return NULL;
+    }
+    xpath_cache = tmp;
+
+    comp = xmlXPathCompile(BAD_CAST xpath_expression);
+    if (comp == NULL) {
+      ERROR("bind plugin: Unable to compile XPath expression `%s'.",
+            xpath_expression);
+      return NULL;
+    }
+
+    xpath_cache[xpath_cache_num].expression = xpath_expression;
+    xpath_cache[xpath_cache_num].comp = comp;
+    xpath_cache_num++;
+  }
+
+  return xmlXPathCompiledEval(comp, xpathCtx);
+} /* }}} xmlXPathObject *bind_xpath_eval */
+
+static int bind_xml_parse_timestamp(const char *str, /* {{{ */
+                                    time_t *ret_value) {
+  struct tm tm = {0};
+  if (strptime(str, "%Y-%m-%dT%T", &tm) == NULL) {
+    ERROR("bind plugin: bind_xml_parse_timestamp: strptime failed.");
+    return -1;
+  }
+
+#if HAVE_TIMEGM
+  time_t t = timegm(&tm);
+  if (t == ((time_t)-1)) {
+    ERROR("bind plugin: timegm() failed: %s", STRERRNO);
+    return -1;
+  }
+  *ret_value = t;
+#else
+  time_t t = mktime(&tm);
+  if (t == ((time_t)-1)) {
+    ERROR("bind plugin: mktime() failed: %s", STRERRNO);
+    return -1;
+  }
+  /* mktime assumes that tm is local time. Luckily, it also sets timezone to
+   * the offset used for the conversion, and we undo the conversion to convert
+   * back to UTC. */
+  *ret_value = t - timezone;
+#endif
+
+  return 0;
+} /* }}} int bind_xml_parse_timestamp */
+
 static int bind_xml_read_timestamp(const char *xpath_expression, /* {{{ */
                                    xmlDoc *doc, xmlXPathContext *xpathCtx,
                                    time_t *ret_value) {
-  xmlXPathObject *xpathObj =
-      xmlXPathEvalExpression(BAD_CAST xpath_expression, xpathCtx);
+  xmlXPathObject *xpathObj = bind_xpath_eval(xpath_expression, xpathCtx);
   if (xpathObj == NULL) {
     ERROR("bind plugin: Unable to evaluate XPath expression `%s'.",
           xpath_expression);
@@ -416,36 +497,10 @@ static int bind_xml_read_timestamp(const char *xpath_expression, /* {{{ */
     return -1;
   }
 
-  struct tm tm = {0};
-  char *tmp = strptime(str_ptr, "%Y-%m-%dT%T", &tm);
+  int status = bind_xml_parse_timestamp(str_ptr, ret_value);
   xmlFree(str_ptr);
-  if (tmp == NULL) {
-    ERROR("bind plugin: bind_xml_read_timestamp: strptime failed.");
-    xmlXPathFreeObject(xpathObj);
-    return -1;
-  }
-
-#if HAVE_TIMEGM
-  time_t t = timegm(&tm);
-  if (t == ((time_t)-1)) {
-    ERROR("bind plugin: timegm() failed: %s", STRERRNO);
-    return -1;
-  }
-  *ret_value = t;
-#else
-  time_t t = mktime(&tm);
-  if (t == ((time_t)-1)) {
-    ERROR("bind plugin: mktime() failed: %s", STRERRNO);
-    return -1;
-  }
-  /* mktime assumes that tm is local time. Luckily, it also sets timezone to
-   * the offset used for the conversion, and we undo the conversion to convert
-   * back to UTC. */
-  *ret_value = t - timezone;
-#endif
-
   xmlXPathFreeObject(xpathObj);
-  return 0;
+  return status;
 } /* }}} int bind_xml_read_timestamp */
 
 /*
@@ -462,8 +517,7 @@ static int bind_parse_generic_name_value(const char *xpath_expression, /* {{{ */
                                          void *user_data, xmlDoc *doc,
                                          xmlXPathContext *xpathCtx,
                                          time_t current_time, int ds_type) {
-  xmlXPathObject *xpathObj =
-      xmlXPathEvalExpression(BAD_CAST xpath_expression, xpathCtx);
+  xmlXPathObject *xpathObj = bind_xpath_eval(xpath_expression, xpathCtx);
   if (xpathObj == NULL) {
     ERROR("bind plugin: Unable to evaluate XPath expression `%s'.",
           xpath_expression);
@@ -541,8 +595,7 @@ static int bind_parse_generic_value_list(const char *xpath_expression, /* {{{ */
                                          void *user_data, xmlDoc *doc,
                                          xmlXPathContext *xpathCtx,
                                          time_t current_time, int ds_type) {
-  xmlXPathObject *xpathObj =
-      xmlXPathEvalExpression(BAD_CAST xpath_expression, xpathCtx);
+  xmlXPathObject *xpathObj = bind_xpath_eval(xpath_expression, xpathCtx);
   if (xpathObj == NULL) {
     ERROR("bind plugin: Unable to evaluate XPath expression `%s'.",
           xpath_expression);
@@ -601,8 +654,7 @@ static int bind_parse_generic_name_attr_value_list(
     list_callback_t list_callback, void *user_data, xmlDoc *doc,
     xmlXPathContext *xpathCtx, time_t current_time, int ds_type) {
 
-  xmlXPathObject *xpathObj =
-      xmlXPathEvalExpression(BAD_CAST xpath_expression, xpathCtx);
+  xmlXPathObject *xpathObj = bind_xpath_eval(xpath_expression, xpathCtx);
   if (xpathObj == NULL) {
     ERROR("bind plugin: Unable to evaluate XPath expression `%s'.",
           xpath_expression);
@@ -671,10 +723,9 @@ static int bind_xml_stats_handle_zone(int version, xmlDoc *doc, /* {{{ */
     xmlFree(n);
     xmlFree(c);
   } else {
-    xmlXPathObject *path_obj =
-        xmlXPathEvalExpression(BAD_CAST "name", path_ctx);
+    xmlXPathObject *path_obj = bind_xpath_eval("name", path_ctx);
     if (path_obj == NULL) {
-      ERROR("bind plugin: xmlXPathEvalExpression failed.");
+      ERROR("bind plugin: Evaluating XPath expression failed.");
       return -1;
     }
 
@@ -750,8 +801,7 @@ static int bind_xml_stats_search_zones(int version, xmlDoc *doc, /* {{{ */
     return -1;
   }
 
-  xmlXPathObject *zone_nodes =
-      xmlXPathEvalExpression(BAD_CAST "zones/zone", path_ctx);
+  xmlXPathObject *zone_nodes = bind_xpath_eval("zones/zone", path_ctx);
   if (zone_nodes == NULL) {
     ERROR("bind plugin: Cannot find any <view> tags.");
     xmlXPathFreeContext(zone_path_context);
@@ -796,10 +846,9 @@ static int bind_xml_stats_handle_view(int version, xmlDoc *doc, /* {{{ */
     xmlFree(view_name);
     view_name = NULL;
   } else {
-    xmlXPathObject *path_obj =
-        xmlXPathEvalExpression(BAD_CAST "name", path_ctx);
+    xmlXPathObject *path_obj = bind_xpath_eval("name", path_ctx);
     if (path_obj == NULL) {
-      ERROR("bind plugin: xmlXPathEvalExpression failed.");
+      ERROR("bind plugin: Evaluating XPath expression failed.");
       return -1;
     }
 
@@ -913,8 +962,7 @@ static int bind_xml_stats_search_views(int version, xmlDoc *doc, /* {{{ */
     return -1;
   }
 
-  xmlXPathObject *view_nodes =
-      xmlXPathEvalExpression(BAD_CAST "views/view", xpathCtx);
+  xmlXPathObject *view_nodes = bind_xpath_eval("views/view", xpathCtx);
   if (view_nodes == NULL) {
     ERROR("bind plugin: Cannot find any <view> tags.");
     xmlXPathFreeContext(view_path_context);
@@ -1293,8 +1341,7 @@ static int bind_xml(const char *data) /* {{{ */
   // version 3.* of statistics XML (since BIND9.9)
   //
 
-  xmlXPathObject *xpathObj =
-      xmlXPathEvalExpression(BAD_CAST "/statistics", xpathCtx);
+  xmlXPathObject *xpathObj = bind_xpath_eval("/statistics", xpathCtx);
   if (xpathObj == NULL || xpathObj->nodesetval == NULL ||
       xpathObj->nodesetval->nodeNr == 0) {
     DEBUG("bind plugin: Statistics appears not to be v3");
@@ -1346,14 +1393,14 @@ static int bind_xml(const char *data) /* {{{ */
   // versions 1.* or 2.* of statistics XML
   //
 
-  xpathObj = xmlXPathEvalExpression(BAD_CAST "/isc/bind/statistics", xpathCtx);
+  xpathObj = bind_xpath_eval("/isc/bind/statistics", xpathCtx);
   if (xpathObj == NULL) {
     ERROR("bind plugin: Cannot find the <statistics> tag.");
     xmlXPathFreeContext(xpathCtx);
     xmlFreeDoc(doc);
     return -1;
   } else if (xpathObj->nodesetval == NULL) {
-    ERROR("bind plugin: xmlXPathEvalExpression failed.");
+    ERROR("bind plugin: Evaluating XPath expression failed.");
     xmlXPathFreeObject(xpathObj);
     xmlXPathFreeContext(xpathCtx);
     xmlFreeDoc(doc);
@@ -1408,6 +1455,390 @@ static int bind_xml(const char *data) /* {{{ */
   return ret;
 } /* }}} int bind_xml */
 
+/*
+ * Streaming parser
+ *
+ * With "StreamingParser" enabled, version 3 statistics are read with an
+ * xmlTextReader instead of being loaded into a tree. Only the elements needed
+ * for the configured statistics are looked at; everything else (tasks,
+ * sockets, unconfigured views and zones, ...) is skipped without building any
+ * nodes. Older statistics versions are handed to bind_xml().
+ */
+#define BIND_STREAM_DEPTH_MAX 8
+
+struct bind_stream_s {
+  xmlTextReader *reader;
+  const xmlChar *path[BIND_STREAM_DEPTH_MAX];
+
+  time_t current_time;
+  bool have_time;
+
+  cb_view_t *view;
+  const char *zone;
+
+  /* The <counters> or <summary> block being read. */
+  int ds_type;
+  list_callback_t callback;
+  void *user_data;
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  list_info_ptr_t list_info;
+  translation_table_ptr_t table_ptr;
+
+  /* The <rrset> element being read. */
+  char *rrset_name;
+  value_t rrset_value;
+  bool rrset_have_value;
+};
+typedef struct bind_stream_s bind_stream_t;
+
+static bool bind_stream_path_is(bind_stream_t *bs, int depth, /* {{{ */
+                                const char *name) {
+  return (depth < BIND_STREAM_DEPTH_MAX) && (bs->path[depth] != NULL) &&
+         (xmlStrcmp(bs->path[depth], BAD_CAST name) == 0);
+} /* }}} bool bind_stream_path_is */
+
+static void bind_stream_set_list(bind_stream_t *bs, /* {{{ */
+                                 const char *plugin_instance,
+                                 const char *type) {
+  sstrncpy(bs->plugin_instance, plugin_instance, sizeof(bs->plugin_instance));
+  bs->list_info = (list_info_ptr_t){bs->plugin_instance, type};
+  bs->callback = bind_xml_list_callback;
+  bs->user_data = &bs->list_info;
+  bs->ds_type = DS_TYPE_COUNTER;
+} /* }}} void bind_stream_set_list */
+
+static void bind_stream_set_table(bind_stream_t *bs, /* {{{ */
+                                  const char *plugin_instance,
+                                  const translation_info_t *table,
+                                  size_t table_length) {
+  sstrncpy(bs->plugin_instance, plugin_instance, sizeof(bs->plugin_instance));
+  bs->table_ptr =
+      (translation_table_ptr_t){table, table_length, bs->plugin_instance};
+  bs->callback = bind_xml_table_callback;
+  bs->user_data = &bs->table_ptr;
+  bs->ds_type = DS_TYPE_COUNTER;
+} /* }}} void bind_stream_set_table */
+
+/* Selects the callback for a <counters type="..."> element. Returns false if
+ * the counters have not been configured and the element is to be skipped. */
+static bool bind_stream_counters(bind_stream_t *bs, int depth) /* {{{ */
+{
+  char *type = (char *)xmlTextReaderGetAttribute(bs->reader, BAD_CAST "type");
+  if (type == NULL)
+    return false;
+
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  bool wanted = true;
+
+  if (depth == 2) { /* statistics/server/counters */
+    if (global_opcodes && (strcmp("opcode", type) == 0))
+      bind_stream_set_list(bs, "global-opcodes", "dns_opcode");
+    else if (global_qtypes && (strcmp("qtype", type) == 0))
+      bind_stream_set_list(bs, "global-qtypes", "dns_qtype");
+    else if (global_server_stats && (strcmp("nsstat", type) == 0))
+      bind_stream_set_table(bs, "global-server_stats",
+                            nsstats_translation_table,
+                            nsstats_translation_table_length);
+    else if (global_zone_maint_stats && (strcmp("zonestat", type) == 0))
+      bind_stream_set_table(bs, "global-zone_maint_stats",
+                            zonestats_translation_table,
+                            zonestats_translation_table_length);
+    else if (global_resolver_stats && (strcmp("resstat", type) == 0))
+      bind_stream_set_table(bs, "global-resolver_stats",
+                            resstats_translation_table,
+                            resstats_translation_table_length);
+    else
+      wanted = false;
+  } else if (depth == 3) { /* statistics/views/view/counters */
+    if (bs->view->qtypes && (strcmp("resqtype", type) == 0)) {
+      snprintf(plugin_instance, sizeof(plugin_instance), "%s-qtypes",
+               bs->view->name);
+      bind_stream_set_list(bs, plugin_instance, "dns_qtype");
+    } else if (bs->view->resolver_stats && (strcmp("resstats", type) == 0)) {
+      snprintf(plugin_instance, sizeof(plugin_instance), "%s-resolver_stats",
+               bs->view->name);
+      bind_stream_set_table(bs, plugin_instance, resstats_translation_table,
+                            resstats_translation_table_length);
+    } else
+      wanted = false;
+  } else { /* statistics/views/view/zones/zone/counters */
+    snprintf(plugin_instance, sizeof(plugin_instance), "%s-zone-%s",
+             bs->view->name, bs->zone);
+    if (strcmp("rcode", type) == 0)
+      bind_stream_set_table(bs, plugin_instance, nsstats_translation_table,
+                            nsstats_translation_table_length);
+    else if (strcmp("qtype", type) == 0)
+      bind_stream_set_list(bs, plugin_instance, "dns_qtype");
+    else
+      wanted = false;
+  }
+
+  xmlFree(type);
+  return wanted;
+} /* }}} bool bind_stream_counters */
+
+/* Reads the text of the current element and passes it to the callback of the
+ * enclosing block. */
+static void bind_stream_value(bind_stream_t *bs, const char *name) /* {{{ */
+{
+  /* Like the tree parser, don't dispatch anything without the server time.
+   * BIND writes it at the top of <server>, before any counters. */
+  if (!bs->have_time)
+    return;
+
+  char *str = (char *)xmlTextReaderReadString(bs->reader);
+  if (str == NULL)
+    return;
+
+  value_t value;
+  int status = parse_value(str, &value,
+                           (bs->ds_type == DS_TYPE_GAUGE) ? DS_TYPE_GAUGE
+                                                          : DS_TYPE_DERIVE);
+  xmlFree(str);
+  if (status != 0)
+    return;
+
+  (*bs->callback)(name, value, bs->current_time, bs->user_data);
+} /* }}} void bind_stream_value */
+
+static void bind_stream_counter(bind_stream_t *bs) /* {{{ */
+{
+  char *name = (char *)xmlTextReaderGetAttribute(bs->reader, BAD_CAST "name");
+  if (name == NULL) {
+    DEBUG("bind plugin: found <counter> without name.");
+    return;
+  }
+
+  bind_stream_value(bs, name);
+  xmlFree(name);
+} /* }}} void bind_stream_counter */
+
+static void bind_stream_rrset(bind_stream_t *bs, const xmlChar *name) /* {{{ */
+{
+  if (xmlStrcmp(BAD_CAST "name", name) == 0) {
+    xmlFree(bs->rrset_name);
+    bs->rrset_name = (char *)xmlTextReaderReadString(bs->reader);
+  } else if (xmlStrcmp(BAD_CAST "counter", name) == 0) {
+    char *str = (char *)xmlTextReaderReadString(bs->reader);
+    if (str == NULL)
+      return;
+    bs->rrset_have_value =
+        (parse_value(str, &bs->rrset_value, DS_TYPE_GAUGE) == 0);
+    xmlFree(str);
+  }
+} /* }}} void bind_stream_rrset */
+
+static void bind_stream_rrset_end(bind_stream_t *bs) /* {{{ */
+{
+  if (bs->have_time && (bs->rrset_name != NULL) && bs->rrset_have_value)
+    (*bs->callback)(bs->rrset_name, bs->rrset_value, bs->current_time,
+                    bs->user_data);
+
+  xmlFree(bs->rrset_name);
+  bs->rrset_name = NULL;
+  bs->rrset_have_value = false;
+} /* }}} void bind_stream_rrset_end */
+
+static cb_view_t *bind_stream_find_view(bind_stream_t *bs) /* {{{ */
+{
+  char *name = (char *)xmlTextReaderGetAttribute(bs->reader, BAD_CAST "name");
+  if (name == NULL) {
+    ERROR("bind plugin: Could not determine view name.");
+    return NULL;
+  }
+
+  cb_view_t *view = NULL;
+  for (size_t i = 0; i < views_num; i++) {
+    if (strcasecmp(name, views[i].name) == 0) {
+      view = views + i;
+      break;
+    }
+  }
+
+  xmlFree(name);
+  return view;
+} /* }}} cb_view_t *bind_stream_find_view */
+
+static const char *bind_stream_find_zone(bind_stream_t *bs) /* {{{ */
+{
+  char *n = (char *)xmlTextReaderGetAttribute(bs->reader, BAD_CAST "name");
+  char *c =
+      (char *)xmlTextReaderGetAttribute(bs->reader, BAD_CAST "rdataclass");
+  const char *zone = NULL;
+
+  if ((n != NULL) && (c != NULL)) {
+    char zone_name[DATA_MAX_NAME_LEN];
+    snprintf(zone_name, sizeof(zone_name), "%s/%s", n, c);
+
+    for (size_t i = 0; i < bs->view->zones_num; i++) {
+      if (strcasecmp(zone_name, bs->view->zones[i]) == 0) {
+        zone = bs->view->zones[i];
+        break;
+      }
+    }
+  } else {
+    ERROR("bind plugin: Could not determine zone name.");
+  }
+
+  xmlFree(n);
+  xmlFree(c);
+  return zone;
+} /* }}} const char *bind_stream_find_zone */
+
+/* Handles the start of an element. Returns true if the reader should descend
+ * into the element and false if the element's subtree is to be skipped. */
+static bool bind_stream_element(bind_stream_t *bs, int depth) /* {{{ */
+{
+  const xmlChar *name = bs->path[depth];
+
+  switch (depth) {
+  case 1:
+    return (xmlStrcmp(BAD_CAST "server", name) == 0) ||
+           (global_memory_stats && (xmlStrcmp(BAD_CAST "memory", name) == 0)) ||
+           ((views_num > 0) && (xmlStrcmp(BAD_CAST "views", name) == 0));
+
+  case 2:
+    if (bind_stream_path_is(bs, 1, "server")) {
+      if (xmlStrcmp(BAD_CAST "current-time", name) == 0) {
+        char *str = (char *)xmlTextReaderReadString(bs->reader);
+        if (str != NULL) {
+          bs->have_time =
+              (bind_xml_parse_timestamp(str, &bs->current_time) == 0);
+          xmlFree(str);
+        }
+        return false;
+      }
+      if (xmlStrcmp(BAD_CAST "counters", name) == 0)
+        return bind_stream_counters(bs, depth);
+    } else if (bind_stream_path_is(bs, 1, "memory")) {
+      if (xmlStrcmp(BAD_CAST "summary", name) == 0) {
+        bind_stream_set_table(bs, "global-memory_stats",
+                              memsummary_translation_table,
+                              memsummary_translation_table_length);
+        bs->ds_type = DS_TYPE_GAUGE;
+        return true;
+      }
+    } else if (xmlStrcmp(BAD_CAST "view", name) == 0) {
+      bs->view = bind_stream_find_view(bs);
+      return bs->view != NULL;
+    }
+    return false;
+
+  case 3:
+    if (bind_stream_path_is(bs, 1, "server")) {
+      if (xmlStrcmp(BAD_CAST "counter", name) == 0)
+        bind_stream_counter(bs);
+    } else if (bind_stream_path_is(bs, 1, "memory")) {
+      bind_stream_value(bs, (const char *)name);
+    } else if (xmlStrcmp(BAD_CAST "counters", name) == 0) {
+      return bind_stream_counters(bs, depth);
+    } else if (xmlStrcmp(BAD_CAST "cache", name) == 0) {
+      if (!bs->view->cacherrsets)
+        return false;
+      char plugin_instance[DATA_MAX_NAME_LEN];
+      snprintf(plugin_instance, sizeof(plugin_instance), "%s-cache_rr_sets",
+               bs->view->name);
+      bind_stream_set_list(bs, plugin_instance, "dns_qtype_cached");
+      bs->ds_type = DS_TYPE_GAUGE;
+      return true;
+    } else if (xmlStrcmp(BAD_CAST "zones", name) == 0) {
+      return bs->view->zones_num > 0;
+    }
+    return false;
+
+  case 4:
+    if (bind_stream_path_is(bs, 3, "counters")) {
+      if (xmlStrcmp(BAD_CAST "counter", name) == 0)
+        bind_stream_counter(bs);
+    } else if (bind_stream_path_is(bs, 3, "cache")) {
+      return xmlStrcmp(BAD_CAST "rrset", name) == 0;
+    } else if (xmlStrcmp(BAD_CAST "zone", name) == 0) {
+      bs->zone = bind_stream_find_zone(bs);
+      return bs->zone != NULL;
+    }
+    return false;
+
+  case 5:
+    if (bind_stream_path_is(bs, 3, "cache"))
+      bind_stream_rrset(bs, name);
+    else if (xmlStrcmp(BAD_CAST "counters", name) == 0)
+      return bind_stream_counters(bs, depth);
+    return false;
+
+  case 6:
+    if (xmlStrcmp(BAD_CAST "counter", name) == 0)
+      bind_stream_counter(bs);
+    return false;
+  }
+
+  return false;
+} /* }}} bool bind_stream_element */
+
+static int bind_xml_stream(const char *data) /* {{{ */
+{
+  bind_stream_t bs = {0};
+
+  bs.reader = xmlReaderForMemory(data, (int)strlen(data), /* URL = */ NULL,
+                                 /* encoding = */ NULL, XML_PARSE_NONET);
+  if (bs.reader == NULL) {
+    ERROR("bind plugin: xmlReaderForMemory failed.");
+    return -1;
+  }
+
+  int status = xmlTextReaderRead(bs.reader);
+  while (status == 1) {
+    int type = xmlTextReaderNodeType(bs.reader);
+    int depth = xmlTextReaderDepth(bs.reader);
+
+    if ((type == XML_READER_TYPE_END_ELEMENT) && (depth == 4) &&
+        bind_stream_path_is(&bs, 1, "views") &&
+        bind_stream_path_is(&bs, 3, "cache")) {
+      bind_stream_rrset_end(&bs);
+    } else if ((type == XML_READER_TYPE_ELEMENT) && (depth == 0)) {
+      char *version =
+          (char *)xmlTextReaderGetAttribute(bs.reader, BAD_CAST "version");
+      bool is_v3 = (xmlStrcmp(BAD_CAST "statistics",
+                              xmlTextReaderConstLocalName(bs.reader)) == 0) &&
+                   (version != NULL) &&
+                   (strncmp("3.", version, strlen("3.")) == 0);
+      xmlFree(version);
+
+      if (!is_v3) {
+        DEBUG("bind plugin: Statistics appears not to be v3, "
+              "falling back to the tree parser.");
+        xmlFreeTextReader(bs.reader);
+        return bind_xml(data);
+      }
+    } else if ((type == XML_READER_TYPE_ELEMENT) &&
+               (depth < BIND_STREAM_DEPTH_MAX)) {
+      bs.path[depth] = xmlTextReaderConstLocalName(bs.reader);
+
+      if (!bind_stream_element(&bs, depth) ||
+          xmlTextReaderIsEmptyElement(bs.reader)) {
+        status = xmlTextReaderNext(bs.reader);
+        continue;
+      }
+    }
+
+    status = xmlTextReaderRead(bs.reader);
+  }
+
+  xmlFree(bs.rrset_name);
+  xmlFreeTextReader(bs.reader);
+
+  if (status != 0) {
+    ERROR("bind plugin: Parsing the statistics failed.");
+    return -1;
+  }
+
+  if (!bs.have_time) {
+    ERROR("bind plugin: Reading `server/current-time' failed.");
+    return -1;
+  }
+
+  return 0;
+} /* }}} int bind_xml_stream */
+
 static int bind_config_add_view_zone(cb_view_t *view, /* {{{ */
                                      oconfig_item_t *ci) {
   if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
@@ -1509,7 +1940,12 @@ static int bind_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &config_parse_time);
     else if (strcasecmp("Timeout", child->key) == 0)
       cf_util_get_int(child, &timeout);
-    else {
+    else if (strcasecmp("StreamingParser", child->key) == 0)
+      cf_util_get_boolean(child, &config_streaming_parser);
+    else if (strcasecmp("Statistics", child->key) == 0) {
+      curl_stats_destroy(stats);
+      stats = curl_stats_from_config(child);
+    } else {
       WARNING("bind plugin: Unknown configuration option "
               "`%s' will be ignored.",
               child->key);
@@ -1556,12 +1992,15 @@ static int bind_read(void) /* {{{ */
 
   curl_easy_setopt(curl, CURLOPT_URL, (url != NULL) ? url : BIND_DEFAULT_URL);
 
-  if (curl_easy_perform(curl) != CURLE_OK) {
+  CURLcode curl_status = curl_easy_perform(curl);
+  curl_stats_dispatch(stats, curl, NULL, "bind", NULL);
+  if (curl_status != CURLE_OK) {
     ERROR("bind plugin: curl_easy_perform failed: %s", bind_curl_error);
     return -1;
   }
 
-  int status = bind_xml(bind_buffer);
+  int status = config_streaming_parser ? bind_xml_stream(bind_buffer)
+                                       : bind_xml(bind_buffer);
   if (status != 0)
     return -1;
   else
@@ -1574,6 +2013,13 @@ static int bind_shutdown(void) /* {{{ */
     curl_easy_cleanup(curl);
     curl = NULL;
   }
+  curl_stats_destroy(stats);
+  stats = NULL;
+
+  for (size_t i = 0; i < xpath_cache_num; i++)
+    xmlXPathFreeCompExpr(xpath_cache[i].comp);
+  sfree(xpath_cache);
+  xpath_cache_num = 0;
 
   return 0;
 } /* }}} int bind_shutdown */
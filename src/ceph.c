@@ -119,13 +119,20 @@ struct ceph_daemon {
   /** Track ds names to match with types */
   char **ds_names;
 
+  /**
+   * Slots of the counters by name: an open addressing hash table with linear
+   * probing, at most half full, built once the schema has been parsed. A free
+   * entry is -1.
+   */
+  int *ds_index;
+  /** Number of entries in ds_index, a power of two */
+  size_t ds_index_size;
+
   /**
    * Keep track of last data for latency values so we can calculate rate
-   * since last poll.
+   * since last poll. Parallel to ds_names.
    */
-  struct last_data **last_poll_data;
-  /** index of last poll data */
-  int last_idx;
+  struct last_data *last_poll_data;
 };
 
 /******* JSON parsing *******/
@@ -174,13 +181,6 @@ struct values_tmp {
   struct ceph_daemon *d;
   /** track avgcount across counters for avgcount/sum latency pairs */
   uint64_t avgcount;
-  /** current index of counters - used to get type of counter */
-  int index;
-  /**
-   * similar to index, but current index of latency type counters -
-   * used to get last poll data of counter
-   */
-  int latency_index;
   /**
    * values list - maintain across counters since
    * host/plugin/plugin instance are always the same
@@ -193,9 +193,10 @@ struct values_tmp {
  * between this poll data and last poll data.
  */
 struct last_data {
-  char ds_name[DATA_MAX_NAME_LEN];
   double last_sum;
   uint64_t last_count;
+  /** false until the counter has been polled once */
+  bool valid;
 };
 
 /******* network I/O *******/
@@ -381,22 +382,87 @@ static void ceph_daemons_print(void) {
   }
 }
 
-static void ceph_daemon_free(struct ceph_daemon *d) {
-  for (int i = 0; i < d->last_idx; i++) {
-    sfree(d->last_poll_data[i]);
-  }
+/** Forget the counters of the last schema */
+static void ceph_daemon_clear_ds(struct ceph_daemon *d) {
   sfree(d->last_poll_data);
-  d->last_poll_data = NULL;
-  d->last_idx = 0;
+  sfree(d->ds_index);
+  d->ds_index_size = 0;
 
   for (int i = 0; i < d->ds_num; i++) {
     sfree(d->ds_names[i]);
   }
   sfree(d->ds_types);
   sfree(d->ds_names);
+  d->ds_num = 0;
+}
+
+static void ceph_daemon_free(struct ceph_daemon *d) {
+  ceph_daemon_clear_ds(d);
   sfree(d);
 }
 
+/* FNV-1a. Counter names share long prefixes, so all of the name is hashed. */
+static uint32_t ds_name_hash(char const *name) {
+  uint32_t hash = 2166136261u;
+  for (unsigned char const *ptr = (unsigned char const *)name; *ptr != 0;
+       ptr++) {
+    hash ^= *ptr;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Index the counters of the schema by name and allocate their last poll
+ * data. If a name appears more than once, the first counter wins.
+ */
+static int ceph_daemon_build_index(struct ceph_daemon *d) {
+  size_t size = 16;
+  while (size < 2 * (size_t)d->ds_num)
+    size *= 2;
+
+  int *index = malloc(size * sizeof(*index));
+  struct last_data *last = calloc(d->ds_num + 1, sizeof(*last));
+  if ((index == NULL) || (last == NULL)) {
+    sfree(index);
+    sfree(last);
+    return -ENOMEM;
+  }
+  for (size_t i = 0; i < size; i++)
+    index[i] = -1;
+
+  for (int i = 0; i < d->ds_num; i++) {
+    size_t pos = ds_name_hash(d->ds_names[i]) & (size - 1);
+    while ((index[pos] >= 0) &&
+           (strcmp(d->ds_names[index[pos]], d->ds_names[i]) != 0))
+      pos = (pos + 1) & (size - 1);
+    if (index[pos] < 0)
+      index[pos] = i;
+  }
+
+  sfree(d->ds_index);
+  sfree(d->last_poll_data);
+  d->ds_index = index;
+  d->ds_index_size = size;
+  d->last_poll_data = last;
+  return 0;
+}
+
+/** Returns the slot of the counter called ds_name, or -1 */
+static int ceph_daemon_lookup_ds(struct ceph_daemon const *d,
+                                 char const *ds_name) {
+  if (d->ds_index_size == 0)
+    return -1;
+
+  size_t pos = ds_name_hash(ds_name) & (d->ds_index_size - 1);
+  while (d->ds_index[pos] >= 0) {
+    if (strcmp(d->ds_names[d->ds_index[pos]], ds_name) == 0)
+      return d->ds_index[pos];
+    pos = (pos + 1) & (d->ds_index_size - 1);
+  }
+  return -1;
+}
+
 /* compact_ds_name removed the special characters ":", "_", "-" and "+" from the
  * input string. Characters following these special characters are capitalized.
  * Trailing "+" and "-" characters are replaces with the strings "Plus" and
@@ -751,115 +817,27 @@ static int node_handler_define_schema(void *arg, const char *val,
   return ceph_daemon_add_ds_entry(d, key, pc_type);
 }
 
-/**
- * Latency counter does not yet have an entry in last poll data - add it.
- */
-static int add_last(struct ceph_daemon *d, const char *ds_n, double cur_sum,
-                    uint64_t cur_count) {
-  d->last_poll_data[d->last_idx] =
-      malloc(sizeof(*d->last_poll_data[d->last_idx]));
-  if (!d->last_poll_data[d->last_idx]) {
-    return -ENOMEM;
-  }
-  sstrncpy(d->last_poll_data[d->last_idx]->ds_name, ds_n,
-           sizeof(d->last_poll_data[d->last_idx]->ds_name));
-  d->last_poll_data[d->last_idx]->last_sum = cur_sum;
-  d->last_poll_data[d->last_idx]->last_count = cur_count;
-  d->last_idx = (d->last_idx + 1);
-  return 0;
-}
-
-/**
- * Update latency counter or add new entry if it doesn't exist
- */
-static int update_last(struct ceph_daemon *d, const char *ds_n, int index,
-                       double cur_sum, uint64_t cur_count) {
-  if ((d->last_idx > index) &&
-      (strcmp(d->last_poll_data[index]->ds_name, ds_n) == 0)) {
-    d->last_poll_data[index]->last_sum = cur_sum;
-    d->last_poll_data[index]->last_count = cur_count;
-    return 0;
-  }
-
-  if (!d->last_poll_data) {
-    d->last_poll_data = malloc(sizeof(*d->last_poll_data));
-    if (!d->last_poll_data) {
-      return -ENOMEM;
-    }
-  } else {
-    struct last_data **tmp_last = realloc(
-        d->last_poll_data, ((d->last_idx + 1) * sizeof(struct last_data *)));
-    if (!tmp_last) {
-      return -ENOMEM;
-    }
-    d->last_poll_data = tmp_last;
-  }
-  return add_last(d, ds_n, cur_sum, cur_count);
-}
-
-/**
- * If using index guess failed (shouldn't happen, but possible if counters
- * get rearranged), resort to searching for counter name
- */
-static int backup_search_for_last_avg(struct ceph_daemon *d, const char *ds_n) {
-  for (int i = 0; i < d->last_idx; i++) {
-    if (strcmp(d->last_poll_data[i]->ds_name, ds_n) == 0) {
-      return i;
-    }
-  }
-  return -1;
-}
-
 /**
  * Calculate average b/t current data and last poll data
  * if last poll data exists
  */
-static double get_last_avg(struct ceph_daemon *d, const char *ds_n, int index,
-                           double cur_sum, uint64_t cur_count) {
-  double result = -1.1, sum_delt = 0.0;
-  uint64_t count_delt = 0;
-  int tmp_index = 0;
-  if (d->last_idx > index) {
-    if (strcmp(d->last_poll_data[index]->ds_name, ds_n) == 0) {
-      tmp_index = index;
-    }
-    // test previous index
-    else if ((index > 0) &&
-             (strcmp(d->last_poll_data[index - 1]->ds_name, ds_n) == 0)) {
-      tmp_index = (index - 1);
-    } else {
-      tmp_index = backup_search_for_last_avg(d, ds_n);
-    }
+static double get_last_avg(struct ceph_daemon *d, int slot, double cur_sum,
+                           uint64_t cur_count) {
+  struct last_data *last = d->last_poll_data + slot;
+  double result = NAN;
 
-    if ((tmp_index > -1) &&
-        (cur_count > d->last_poll_data[tmp_index]->last_count)) {
-      sum_delt = (cur_sum - d->last_poll_data[tmp_index]->last_sum);
-      count_delt = (cur_count - d->last_poll_data[tmp_index]->last_count);
-      result = (sum_delt / count_delt);
-    }
+  if (last->valid && (cur_count > last->last_count)) {
+    double sum_delt = (cur_sum - last->last_sum);
+    uint64_t count_delt = (cur_count - last->last_count);
+    result = (sum_delt / count_delt);
   }
 
-  if (result == -1.1) {
-    result = NAN;
-  }
-  if (update_last(d, ds_n, tmp_index, cur_sum, cur_count) == -ENOMEM) {
-    return -ENOMEM;
-  }
+  last->last_sum = cur_sum;
+  last->last_count = cur_count;
+  last->valid = true;
   return result;
 }
 
-/**
- * If using index guess failed, resort to searching for counter name
- */
-static uint32_t backup_search_for_type(struct ceph_daemon *d, char *ds_name) {
-  for (int i = 0; i < d->ds_num; i++) {
-    if (strcmp(d->ds_names[i], ds_name) == 0) {
-      return d->ds_types[i];
-    }
-  }
-  return DSET_TYPE_UNFOUND;
-}
-
 /**
  * Process counter data and dispatch values
  */
@@ -870,7 +848,6 @@ static int node_handler_fetch_data(void *arg, const char *val,
   uint64_t tmp_u;
   struct values_tmp *vtmp = (struct values_tmp *)arg;
   uint32_t type = DSET_TYPE_UNFOUND;
-  int index = vtmp->index;
 
   char ds_name[DATA_MAX_NAME_LEN];
 
@@ -878,29 +855,9 @@ static int node_handler_fetch_data(void *arg, const char *val,
     return 1;
   }
 
-  if (index >= vtmp->d->ds_num) {
-    // don't overflow bounds of array
-    index = (vtmp->d->ds_num - 1);
-  }
-
-  /**
-   * counters should remain in same order we parsed schema... we maintain the
-   * index variable to keep track of current point in list of counters. first
-   * use index to guess point in array for retrieving type. if that doesn't
-   * work, use the old way to get the counter type
-   */
-  if (strcmp(ds_name, vtmp->d->ds_names[index]) == 0) {
-    // found match
-    type = vtmp->d->ds_types[index];
-  } else if ((index > 0) &&
-             (strcmp(ds_name, vtmp->d->ds_names[index - 1]) == 0)) {
-    // try previous key
-    type = vtmp->d->ds_types[index - 1];
-  }
-
-  if (type == DSET_TYPE_UNFOUND) {
-    // couldn't find right type by guessing, check the old way
-    type = backup_search_for_type(vtmp->d, ds_name);
+  int slot = ceph_daemon_lookup_ds(vtmp->d, ds_name);
+  if (slot >= 0) {
+    type = vtmp->d->ds_types[slot];
   }
 
   switch (type) {
@@ -921,13 +878,8 @@ static int node_handler_fetch_data(void *arg, const char *val,
       }
       double sum, result;
       sscanf(val, "%lf", &sum);
-      result = get_last_avg(vtmp->d, ds_name, vtmp->latency_index, sum,
-                            vtmp->avgcount);
-      if (result == -ENOMEM) {
-        return -ENOMEM;
-      }
+      result = get_last_avg(vtmp->d, slot, sum, vtmp->avgcount);
       uv.gauge = result;
-      vtmp->latency_index = (vtmp->latency_index + 1);
     } else if (has_suffix(key, ".avgtime")) {
 
       /* The "avgtime" metric reports ("sum" / "avgcount"), i.e. the average
@@ -942,7 +894,6 @@ static int node_handler_fetch_data(void *arg, const char *val,
       double result;
       sscanf(val, "%lf", &result);
       uv.gauge = result;
-      vtmp->latency_index = (vtmp->latency_index + 1);
     } else {
       WARNING("ceph plugin: ignoring unknown latency metric: %s", key);
       return 0;
@@ -968,7 +919,6 @@ static int node_handler_fetch_data(void *arg, const char *val,
   vtmp->vlist.values = &uv;
   vtmp->vlist.values_len = 1;
 
-  vtmp->index = (vtmp->index + 1);
   plugin_dispatch_values(&vtmp->vlist);
 
   return 0;
@@ -1043,8 +993,6 @@ static int cconn_process_data(struct cconn *io, yajl_struct *yajl,
            sizeof(vtmp->vlist.plugin_instance));
 
   vtmp->d = io->d;
-  vtmp->latency_index = 0;
-  vtmp->index = 0;
   yajl->handler_arg = vtmp;
   ret = traverse_json(io->json, io->json_len, hand);
   sfree(vtmp);
@@ -1086,9 +1034,7 @@ static int cconn_process_json(struct cconn *io) {
     break;
   case ASOK_REQ_SCHEMA:
     // init daemon specific variables
-    io->d->ds_num = 0;
-    io->d->last_idx = 0;
-    io->d->last_poll_data = NULL;
+    ceph_daemon_clear_ds(io->d);
     io->yajl.handler = node_handler_define_schema;
     io->yajl.handler_arg = io->d;
     result = traverse_json(io->json, io->json_len, hand);
@@ -1115,6 +1061,10 @@ static int cconn_process_json(struct cconn *io) {
     return 1;
   }
 
+  if (io->request_type == ASOK_REQ_SCHEMA) {
+    result = ceph_daemon_build_index(io->d);
+  }
+
 done:
   yajl_free(hand);
   return result;
@@ -181,9 +181,42 @@ DEF_TEST(parse_keys) {
   return 0;
 }
 
+DEF_TEST(ds_index) {
+  struct ceph_daemon *d = calloc(1, sizeof(*d));
+  char key[64];
+
+  CHECK_NOT_NULL(d);
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "osd.counter_%d.type", i);
+    CHECK_ZERO(ceph_daemon_add_ds_entry(d, key, (i % 2) ? PERFCOUNTER_LATENCY
+                                                        : PERFCOUNTER_DERIVE));
+  }
+  /* A duplicate name resolves to the first counter. */
+  CHECK_ZERO(ceph_daemon_add_ds_entry(d, "osd.counter_7.type", 0));
+  CHECK_ZERO(ceph_daemon_build_index(d));
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "Osd.counter%d", i);
+    EXPECT_EQ_INT(i, ceph_daemon_lookup_ds(d, key));
+  }
+  EXPECT_EQ_INT(-1, ceph_daemon_lookup_ds(d, "Osd.counter100"));
+  EXPECT_EQ_INT(DSET_LATENCY,
+                d->ds_types[ceph_daemon_lookup_ds(d, "Osd.counter7")]);
+
+  /* The first poll has nothing to compare with. */
+  OK(isnan(get_last_avg(d, 7, 10.0, 5)));
+  EXPECT_EQ_DOUBLE(2.0, get_last_avg(d, 7, 30.0, 15));
+  OK(isnan(get_last_avg(d, 7, 30.0, 15)));
+  OK(isnan(get_last_avg(d, 9, 30.0, 15)));
+
+  ceph_daemon_free(d);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(traverse_json);
   RUN_TEST(parse_keys);
+  RUN_TEST(ds_index);
 
   END_TEST;
 }
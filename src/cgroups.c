@@ -24,30 +24,115 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
 #include "utils/mount/mount.h"
+#include "utils/procfs/procfs.h"
 
-static char const *config_keys[] = {"CGroup", "IgnoreSelected"};
+#include <sys/inotify.h>
+
+static char const *config_keys[] = {"CGroup", "IgnoreSelected", "ReadThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static ignorelist_t *il_cgroup;
 
-__attribute__((nonnull(1))) __attribute__((nonnull(2))) static void
-cgroups_submit_one(char const *plugin_instance, char const *type_instance,
-                   value_t value) {
+/*
+ * cgroup v2: The unified hierarchy is walked once and whenever inotify reports
+ * that a cgroup has been created or removed. The stat files of each cgroup are
+ * kept open and re-read with pread(2).
+ */
+typedef struct {
+  char *path;
+  /* Name of the cgroup, i.e. the last component of "path". */
+  char const *name;
+  bool ignored;
+  int wd;
+  /* Walk in which the directory was last seen. */
+  unsigned int generation;
+
+  procfs_file_t *cpu_stat;
+  procfs_file_t *memory_stat;
+  procfs_file_t *io_stat;
+} cg2_t;
+
+/* Number of threads reading the cgroups, including the read thread of the
+ * plugin. */
+static int cg_read_threads = 1;
+static long cg_clock_ticks;
+
+/* The cgroups are handed out to the reading threads in chunks of this size. */
+#define CG2_READ_CHUNK 16
+
+static char *cg2_root;
+/* Maps the path of a cgroup to its cg2_t. */
+static c_avl_tree_t *cg2_tree;
+/* The cgroups that are read, i.e. the entries of cg2_tree not ignored. */
+static cg2_t **cg2_list;
+static size_t cg2_list_num;
+static unsigned int cg2_generation;
+
+static int cg2_inotify_fd = -1;
+/* Set if the hierarchy has changed since the last walk. */
+static bool cg2_rescan = true;
+/* Set if the changes can't be watched: the hierarchy is walked on every
+ * read. */
+static bool cg2_no_inotify;
+
+/* The values in memory.stat that are reported. Most of the others are event
+ * counters or overlap with these. */
+static char const *cg2_memory_keys[] = {
+    "anon",
+    "file",
+    "file_mapped",
+    "file_dirty",
+    "file_writeback",
+    "kernel_stack",
+    "pagetables",
+    "percpu",
+    "shmem",
+    "slab",
+    "sock",
+};
+
+typedef struct {
+  pthread_mutex_t lock;
+  size_t next;
+} cg2_read_t;
+
+__attribute__((nonnull(1))) __attribute__((nonnull(2)))
+__attribute__((nonnull(3))) static void
+cgroups_submit_one(char const *plugin_instance, char const *type,
+                   char const *type_instance, value_t value) {
   value_list_t vl = VALUE_LIST_INIT;
 
   vl.values = &value;
   vl.values_len = 1;
   sstrncpy(vl.plugin, "cgroups", sizeof(vl.plugin));
   sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
-  sstrncpy(vl.type, "cpu", sizeof(vl.type));
+  sstrncpy(vl.type, type, sizeof(vl.type));
   sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
 
   plugin_dispatch_values(&vl);
 } /* void cgroups_submit_one */
 
+static void cgroups_submit_two(char const *plugin_instance, char const *type,
+                               derive_t read, derive_t write) {
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t values[] = {
+      {.derive = read},
+      {.derive = write},
+  };
+
+  vl.values = values;
+  vl.values_len = STATIC_ARRAY_SIZE(values);
+  sstrncpy(vl.plugin, "cgroups", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, type, sizeof(vl.type));
+
+  plugin_dispatch_values(&vl);
+} /* void cgroups_submit_two */
+
 /*
  * This callback reads the user/system CPU time for each cgroup.
  */
@@ -118,7 +203,7 @@ static int read_cpuacct_procs(const char *dirname, char const *cgroup_name,
     if (status != 0)
       continue;
 
-    cgroups_submit_one(cgroup_name, key, value);
+    cgroups_submit_one(cgroup_name, "cpu", key, value);
   }
 
   fclose(fh);
@@ -154,10 +239,426 @@ static int read_cpuacct_root(const char *dirname, const char *filename,
   return 0;
 }
 
+static void cg2_open_files(cg2_t *cg) {
+  struct {
+    procfs_file_t **pf;
+    char const *file;
+  } files[] = {
+      {&cg->cpu_stat, "cpu.stat"},
+      {&cg->memory_stat, "memory.stat"},
+      {&cg->io_stat, "io.stat"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(files); i++) {
+    char path[PATH_MAX];
+
+    if (*files[i].pf != NULL)
+      continue;
+
+    /* Files of controllers that are not enabled for this cgroup don't exist.
+     * They are looked for again by the next walk. */
+    snprintf(path, sizeof(path), "%s/%s", cg->path, files[i].file);
+    *files[i].pf = procfs_open(path);
+    if ((*files[i].pf == NULL) && (errno != ENOENT))
+      WARNING("cgroups plugin: open (\"%s\") failed: %s", path, STRERRNO);
+  }
+} /* void cg2_open_files */
+
+static void cg2_free(cg2_t *cg) {
+  if (cg == NULL)
+    return;
+
+  /* The watch of a removed directory has been removed by the kernel. */
+  if ((cg->wd >= 0) && (cg2_inotify_fd >= 0))
+    inotify_rm_watch(cg2_inotify_fd, cg->wd);
+
+  procfs_close(cg->cpu_stat);
+  procfs_close(cg->memory_stat);
+  procfs_close(cg->io_stat);
+  sfree(cg->path);
+  sfree(cg);
+} /* void cg2_free */
+
+/* cg2_add marks the cgroup at "path" as seen by the current walk, adding it if
+ * it is new. "name" is NULL for the root of the hierarchy, which is watched
+ * but not read. */
+static int cg2_add(char const *path, char const *name) {
+  cg2_t *cg = NULL;
+
+  if (c_avl_get(cg2_tree, path, (void *)&cg) == 0) {
+    cg->generation = cg2_generation;
+    if (!cg->ignored)
+      cg2_open_files(cg);
+    return 0;
+  }
+
+  cg = calloc(1, sizeof(*cg));
+  if (cg == NULL)
+    return ENOMEM;
+  cg->path = strdup(path);
+  if (cg->path == NULL) {
+    sfree(cg);
+    return ENOMEM;
+  }
+  cg->name = cg->path + strlen(cg->path) - ((name != NULL) ? strlen(name) : 0);
+  cg->ignored = (name == NULL) || ignorelist_match(il_cgroup, name);
+  cg->wd = -1;
+  cg->generation = cg2_generation;
+
+  if (!cg2_no_inotify) {
+    cg->wd = inotify_add_watch(cg2_inotify_fd, path,
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_ONLYDIR);
+    if ((cg->wd < 0) && (errno == ENOENT)) {
+      /* removed while walking */
+      cg2_free(cg);
+      return ENOENT;
+    } else if (cg->wd < 0) {
+      WARNING("cgroups plugin: Watching \"%s\" failed: %s. The cgroup "
+              "hierarchy will be walked on every read. Consider increasing "
+              "fs.inotify.max_user_watches.",
+              path, STRERRNO);
+      cg2_no_inotify = true;
+    }
+  }
+
+  if (!cg->ignored)
+    cg2_open_files(cg);
+
+  if (c_avl_insert(cg2_tree, cg->path, cg) != 0) {
+    ERROR("cgroups plugin: c_avl_insert failed.");
+    cg2_free(cg);
+    return -1;
+  }
+
+  return 0;
+} /* int cg2_add */
+
+static int cg2_walk(char const *path) {
+  DIR *dh = opendir(path);
+  if (dh == NULL) {
+    if (errno == ENOENT)
+      return 0;
+    ERROR("cgroups plugin: opendir (\"%s\") failed: %s", path, STRERRNO);
+    return -1;
+  }
+
+  struct dirent *ent;
+  while ((ent = readdir(dh)) != NULL) {
+    char child[PATH_MAX];
+
+    if (ent->d_name[0] == '.')
+      continue;
+    if ((ent->d_type != DT_DIR) && (ent->d_type != DT_UNKNOWN))
+      continue;
+
+    int status = snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+    if ((status < 0) || ((size_t)status >= sizeof(child)))
+      continue;
+
+    if (ent->d_type == DT_UNKNOWN) {
+      struct stat statbuf;
+      if ((lstat(child, &statbuf) != 0) || !S_ISDIR(statbuf.st_mode))
+        continue;
+    }
+
+    if (cg2_add(child, ent->d_name) == 0)
+      cg2_walk(child);
+  }
+
+  closedir(dh);
+  return 0;
+} /* int cg2_walk */
+
+static void cg2_reset(void) {
+  if (cg2_tree != NULL) {
+    char *path;
+    cg2_t *cg;
+    while (c_avl_pick(cg2_tree, (void *)&path, (void *)&cg) == 0)
+      cg2_free(cg);
+    c_avl_destroy(cg2_tree);
+    cg2_tree = NULL;
+  }
+
+  sfree(cg2_list);
+  cg2_list_num = 0;
+  sfree(cg2_root);
+
+  if (cg2_inotify_fd >= 0) {
+    close(cg2_inotify_fd);
+    cg2_inotify_fd = -1;
+  }
+  cg2_no_inotify = false;
+  cg2_rescan = true;
+} /* void cg2_reset */
+
+/* cg2_scan walks the hierarchy, removes the cgroups that have disappeared and
+ * rebuilds cg2_list. */
+static int cg2_scan(void) {
+  cg2_generation++;
+
+  int status = cg2_add(cg2_root, /* name = */ NULL);
+  if (status != 0)
+    return status;
+  cg2_walk(cg2_root);
+
+  cg2_t **list = calloc((size_t)c_avl_size(cg2_tree), sizeof(*list));
+  cg2_t **expired = calloc((size_t)c_avl_size(cg2_tree), sizeof(*expired));
+  if ((list == NULL) || (expired == NULL)) {
+    ERROR("cgroups plugin: calloc failed.");
+    sfree(list);
+    sfree(expired);
+    return ENOMEM;
+  }
+  size_t list_num = 0;
+  size_t expired_num = 0;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(cg2_tree);
+  char *path;
+  cg2_t *cg;
+  while (c_avl_iterator_next(iter, (void *)&path, (void *)&cg) == 0) {
+    if (cg->generation != cg2_generation)
+      expired[expired_num++] = cg;
+    else if (!cg->ignored)
+      list[list_num++] = cg;
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < expired_num; i++) {
+    c_avl_remove(cg2_tree, expired[i]->path, NULL, NULL);
+    cg2_free(expired[i]);
+  }
+  sfree(expired);
+
+  sfree(cg2_list);
+  cg2_list = list;
+  cg2_list_num = list_num;
+
+  DEBUG("cgroups plugin: Found %" PRIsz " cgroups below %s.", cg2_list_num,
+        cg2_root);
+  return 0;
+} /* int cg2_scan */
+
+/* cg2_check_events drains the inotify queue. Any event means that a cgroup
+ * has been created, removed or renamed. */
+static void cg2_check_events(void) {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (42) {
+    ssize_t status = read(cg2_inotify_fd, buffer, sizeof(buffer));
+    if (status > 0) {
+      cg2_rescan = true;
+      continue;
+    }
+
+    if ((status < 0) && (errno == EINTR))
+      continue;
+    if ((status < 0) && (errno != EAGAIN)) {
+      WARNING("cgroups plugin: Reading inotify events failed: %s", STRERRNO);
+      cg2_rescan = true;
+    }
+    break;
+  }
+} /* void cg2_check_events */
+
+static void cg2_read_cpu(cg2_t *cg) {
+  if ((cg->cpu_stat == NULL) || (procfs_read(cg->cpu_stat) != 0))
+    return;
+
+  char *line;
+  while ((line = procfs_next_line(cg->cpu_stat)) != NULL) {
+    char *fields[3];
+    char const *type_instance;
+
+    if (strsplit(line, fields, STATIC_ARRAY_SIZE(fields)) != 2)
+      continue;
+
+    if (strcmp("user_usec", fields[0]) == 0)
+      type_instance = "user";
+    else if (strcmp("system_usec", fields[0]) == 0)
+      type_instance = "system";
+    else
+      continue;
+
+    value_t value;
+    if (parse_value(fields[1], &value, DS_TYPE_DERIVE) != 0)
+      continue;
+    /* Reported in USER_HZ like cpuacct.stat of cgroup v1. */
+    value.derive = value.derive * cg_clock_ticks / 1000000;
+
+    cgroups_submit_one(cg->name, "cpu", type_instance, value);
+  }
+} /* void cg2_read_cpu */
+
+static void cg2_read_memory(cg2_t *cg) {
+  if ((cg->memory_stat == NULL) || (procfs_read(cg->memory_stat) != 0))
+    return;
+
+  char *line;
+  while ((line = procfs_next_line(cg->memory_stat)) != NULL) {
+    char *fields[3];
+
+    if (strsplit(line, fields, STATIC_ARRAY_SIZE(fields)) != 2)
+      continue;
+
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(cg2_memory_keys); i++) {
+      if (strcmp(cg2_memory_keys[i], fields[0]) != 0)
+        continue;
+
+      value_t value;
+      if (parse_value(fields[1], &value, DS_TYPE_GAUGE) == 0)
+        cgroups_submit_one(cg->name, "memory", fields[0], value);
+      break;
+    }
+  }
+} /* void cg2_read_memory */
+
+/* cg2_read_io sums the counters of all devices, e.g.
+ *   8:0 rbytes=90430464 wbytes=299008000 rios=8950 wios=12252 dbytes=0 dios=0
+ */
+static void cg2_read_io(cg2_t *cg) {
+  if ((cg->io_stat == NULL) || (procfs_read(cg->io_stat) != 0))
+    return;
+
+  derive_t rbytes = 0, wbytes = 0, rios = 0, wios = 0;
+  bool have_io = false;
+  char *line;
+  while ((line = procfs_next_line(cg->io_stat)) != NULL) {
+    char *fields[16];
+    int fields_num = strsplit(line, fields, STATIC_ARRAY_SIZE(fields));
+
+    for (int i = 1; i < fields_num; i++) {
+      char *value = strchr(fields[i], '=');
+      derive_t *sum;
+
+      if (value == NULL)
+        continue;
+      *value = 0;
+      value++;
+
+      if (strcmp("rbytes", fields[i]) == 0)
+        sum = &rbytes;
+      else if (strcmp("wbytes", fields[i]) == 0)
+        sum = &wbytes;
+      else if (strcmp("rios", fields[i]) == 0)
+        sum = &rios;
+      else if (strcmp("wios", fields[i]) == 0)
+        sum = &wios;
+      else
+        continue;
+
+      *sum += (derive_t)strtoll(value, /* endptr = */ NULL, /* base = */ 10);
+      have_io = true;
+    }
+  }
+
+  if (!have_io)
+    return;
+
+  cgroups_submit_two(cg->name, "disk_octets", rbytes, wbytes);
+  cgroups_submit_two(cg->name, "disk_ops", rios, wios);
+} /* void cg2_read_io */
+
+static void *cg2_read_thread(void *arg) {
+  cg2_read_t *rd = arg;
+
+  while (42) {
+    pthread_mutex_lock(&rd->lock);
+    size_t begin = rd->next;
+    size_t end = begin + CG2_READ_CHUNK;
+    if (end > cg2_list_num)
+      end = cg2_list_num;
+    rd->next = end;
+    pthread_mutex_unlock(&rd->lock);
+
+    if (begin >= end)
+      break;
+
+    for (size_t i = begin; i < end; i++) {
+      cg2_read_cpu(cg2_list[i]);
+      cg2_read_memory(cg2_list[i]);
+      cg2_read_io(cg2_list[i]);
+    }
+  }
+
+  return NULL;
+} /* void *cg2_read_thread */
+
+static int cg2_read(char const *root) {
+  if ((cg2_root == NULL) || (strcmp(cg2_root, root) != 0)) {
+    cg2_reset();
+    cg2_root = strdup(root);
+    cg2_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if ((cg2_root == NULL) || (cg2_tree == NULL)) {
+      ERROR("cgroups plugin: Allocating memory failed.");
+      cg2_reset();
+      return ENOMEM;
+    }
+
+    cg2_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cg2_inotify_fd < 0) {
+      WARNING("cgroups plugin: inotify_init1 failed: %s. The cgroup hierarchy "
+              "will be walked on every read.",
+              STRERRNO);
+      cg2_no_inotify = true;
+    }
+  }
+
+  if (cg2_inotify_fd >= 0)
+    cg2_check_events();
+
+  /* Events caused by changes during the walk make the next read walk again. */
+  if (cg2_rescan || cg2_no_inotify) {
+    cg2_rescan = false;
+    int status = cg2_scan();
+    if (status != 0) {
+      cg2_rescan = true;
+      return status;
+    }
+  }
+
+  cg2_read_t rd = {.next = 0};
+  pthread_mutex_init(&rd.lock, /* attr = */ NULL);
+
+  size_t threads_num = (size_t)cg_read_threads - 1;
+  if (threads_num > (cg2_list_num / CG2_READ_CHUNK))
+    threads_num = cg2_list_num / CG2_READ_CHUNK;
+
+  pthread_t *threads = NULL;
+  if (threads_num > 0) {
+    threads = calloc(threads_num, sizeof(*threads));
+    if (threads == NULL)
+      threads_num = 0;
+  }
+
+  size_t started = 0;
+  for (; started < threads_num; started++) {
+    int status = plugin_thread_create(&threads[started], /* attr = */ NULL,
+                                      cg2_read_thread, &rd, "cgroups read");
+    if (status != 0) {
+      WARNING("cgroups plugin: Starting a read thread failed: %s",
+              STRERROR(status));
+      break;
+    }
+  }
+
+  cg2_read_thread(&rd);
+
+  for (size_t i = 0; i < started; i++)
+    pthread_join(threads[i], /* retval = */ NULL);
+  sfree(threads);
+  pthread_mutex_destroy(&rd.lock);
+
+  return 0;
+} /* int cg2_read */
+
 static int cgroups_init(void) {
   if (il_cgroup == NULL)
     il_cgroup = ignorelist_create(1);
 
+  cg_clock_ticks = sysconf(_SC_CLK_TCK);
+
   return 0;
 }
 
@@ -174,6 +675,14 @@ static int cgroups_config(const char *key, const char *value) {
     else
       ignorelist_set_invert(il_cgroup, 1);
     return 0;
+  } else if (strcasecmp(key, "ReadThreads") == 0) {
+    int tmp = atoi(value);
+    if (tmp < 1) {
+      ERROR("cgroups plugin: \"ReadThreads\" must be at least 1.");
+      return 1;
+    }
+    cg_read_threads = tmp;
+    return 0;
   }
 
   return -1;
@@ -182,6 +691,8 @@ static int cgroups_config(const char *key, const char *value) {
 static int cgroups_read(void) {
   cu_mount_t *mnt_list = NULL;
   bool cgroup_found = false;
+  char *cgroup2_dir = NULL;
+  int status = 0;
 
   if (cu_mount_getlist(&mnt_list) == NULL) {
     ERROR("cgroups plugin: cu_mount_getlist failed.");
@@ -190,6 +701,9 @@ static int cgroups_read(void) {
 
   for (cu_mount_t *mnt_ptr = mnt_list; mnt_ptr != NULL;
        mnt_ptr = mnt_ptr->next) {
+    if ((cgroup2_dir == NULL) && (strcmp(mnt_ptr->type, "cgroup2") == 0))
+      cgroup2_dir = mnt_ptr->dir;
+
     /* Find the cgroup mountpoint which contains the cpuacct
      * controller. */
     if ((strcmp(mnt_ptr->type, "cgroup") != 0) ||
@@ -205,20 +719,34 @@ static int cgroups_read(void) {
     break;
   }
 
+  /* The unified hierarchy is only read if there is no cgroup v1 cpuacct
+   * controller; on "hybrid" systems it has no controllers. */
+  if (!cgroup_found && (cgroup2_dir != NULL)) {
+    status = cg2_read(cgroup2_dir);
+    cgroup_found = true;
+  }
+
   cu_mount_freelist(mnt_list);
 
   if (!cgroup_found) {
     WARNING("cgroups plugin: Unable to find cgroup "
-            "mount-point with the \"cpuacct\" option.");
+            "mount-point with the \"cpuacct\" option or a cgroup2 "
+            "mount-point.");
     return -1;
   }
 
-  return 0;
+  return (status == 0) ? 0 : -1;
 } /* int cgroup_read */
 
+static int cgroups_shutdown(void) {
+  cg2_reset();
+  return 0;
+} /* int cgroups_shutdown */
+
 void module_register(void) {
   plugin_register_config("cgroups", cgroups_config, config_keys,
                          config_keys_num);
   plugin_register_init("cgroups", cgroups_init);
   plugin_register_read("cgroups", cgroups_read);
+  plugin_register_shutdown("cgroups", cgroups_shutdown);
 } /* void module_register */
@@ -0,0 +1,174 @@
+/**
+ * collectd - src/collectd-segment.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/segment/segment.h"
+
+#include <fnmatch.h>
+
+static char const *conf_pattern;
+static cdtime_t conf_start;
+static cdtime_t conf_end = UINT64_MAX;
+static bool conf_list;
+
+__attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
+{
+  fprintf((exit_status == EXIT_FAILURE) ? stderr : stdout,
+          "collectd-segment -- reads the files of the write_segment plugin\n"
+          "\n"
+          "  Usage: collectd-segment [OPTION] <file> [<file> ...]\n"
+          "\n"
+          "  Valid options:\n"
+          "    -i <pattern>   Only read the series whose identifier matches\n"
+          "                   the shell wildcard pattern.\n"
+          "    -s <time>      Only print points at or after <time>, in\n"
+          "                   seconds since the epoch.\n"
+          "    -e <time>      Only print points at or before <time>.\n"
+          "    -l             List the series rather than their points.\n"
+          "    -h             Print usage information (this output).\n"
+          "\n"
+          "Licensed under the MIT license.\n");
+  exit(exit_status);
+} /* }}} void exit_usage */
+
+static cdtime_t get_time_opt(char const *str) /* {{{ */
+{
+  char *endptr = NULL;
+
+  errno = 0;
+  double d = strtod(str, &endptr);
+  if ((endptr == str) || (*endptr != 0) || (errno != 0) || !(d >= 0.0)) {
+    fprintf(stderr, "Not a valid time: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Times are stored with millisecond precision. */
+  return MS_TO_CDTIME_T((uint64_t)(d * 1000.0 + 0.5));
+} /* }}} cdtime_t get_time_opt */
+
+static void read_options(int argc, char **argv) /* {{{ */
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:s:e:lh")) != -1) {
+    switch (opt) {
+    case 'i':
+      conf_pattern = optarg;
+      break;
+
+    case 's':
+      conf_start = get_time_opt(optarg);
+      break;
+
+    case 'e':
+      conf_end = get_time_opt(optarg);
+      break;
+
+    case 'l':
+      conf_list = true;
+      break;
+
+    case 'h':
+      exit_usage(EXIT_SUCCESS);
+
+    default:
+      exit_usage(EXIT_FAILURE);
+    } /* switch (opt) */
+  }   /* while (getopt) */
+
+  if (optind >= argc)
+    exit_usage(EXIT_FAILURE);
+} /* }}} void read_options */
+
+/* Prints one line per point: the identifier, the time and the values of the
+ * data sources. */
+static int print_series(segment_reader_t *r, size_t id) /* {{{ */
+{
+  segment_series_t const *s = segment_reader_series(r, id);
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+
+  int status = segment_reader_read(r, id, conf_start, conf_end, &times,
+                                   &values, &num);
+  if (status != 0) {
+    fprintf(stderr, "Reading %s failed: %s\n", s->name, strerror(status));
+    return status;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    printf("%s %.3f", s->name, CDTIME_T_TO_DOUBLE(times[i]));
+    for (size_t j = 0; j < s->values_num; j++) {
+      gauge_t v = values[i * s->values_num + j];
+      if (isnan(v))
+        printf(" %s=NaN", s->ds_names[j]);
+      else
+        printf(" %s=%.15g", s->ds_names[j], v);
+    }
+    printf("\n");
+  }
+
+  free(times);
+  free(values);
+  return 0;
+} /* }}} int print_series */
+
+static int read_file(char const *path) /* {{{ */
+{
+  segment_reader_t *r = segment_reader_open(path);
+  if (r == NULL) {
+    fprintf(stderr, "Opening %s failed: %s\n", path, strerror(errno));
+    return errno;
+  }
+
+  int status = 0;
+  for (size_t id = 0; id < segment_reader_series_num(r); id++) {
+    segment_series_t const *s = segment_reader_series(r, id);
+    if ((conf_pattern != NULL) && (fnmatch(conf_pattern, s->name, 0) != 0))
+      continue;
+
+    if (conf_list) {
+      printf("%s\n", s->name);
+      continue;
+    }
+
+    if (print_series(r, id) != 0)
+      status = -1;
+  }
+
+  segment_reader_close(r);
+  return status;
+} /* }}} int read_file */
+
+int main(int argc, char **argv) /* {{{ */
+{
+  read_options(argc, argv);
+
+  int status = EXIT_SUCCESS;
+  for (int i = optind; i < argc; i++)
+    if (read_file(argv[i]) != 0)
+      status = EXIT_FAILURE;
+
+  return status;
+} /* }}} int main */
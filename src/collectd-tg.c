@@ -33,9 +33,12 @@
 #endif
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -52,17 +55,75 @@
 #define DEF_NUM_PLUGINS 20
 #define DEF_NUM_VALUES 100000
 #define DEF_INTERVAL 10.0
+#define DEF_NUM_THREADS 1
+#define DEF_SEND_BATCH 32
+#define DEF_SEED 1
+#define SOCKET_BATCH_SIZE 128
+#define DESTINATIONS_MAX 64
+/* Generator threads sleep at most this long at a time, so that they notice
+ * being stopped. */
+#define SLEEP_MAX 0.1
+/* The value lists are spread over the interval in slots of this many seconds.
+ * The value lists of one slot are sent together, in as few packets as
+ * possible. */
+#define TIME_SLOT 0.01
 
 static int conf_num_hosts = DEF_NUM_HOSTS;
 static int conf_num_plugins = DEF_NUM_PLUGINS;
 static int conf_num_values = DEF_NUM_VALUES;
 static double conf_interval = DEF_INTERVAL;
-static const char *conf_destination = NET_DEFAULT_V6_ADDR;
+static int conf_num_threads = DEF_NUM_THREADS;
+static int conf_send_batch = DEF_SEND_BATCH;
+static double conf_churn;
+static int conf_seed = DEF_SEED;
+static const char *conf_destinations[DESTINATIONS_MAX];
+static size_t conf_destinations_num;
 static const char *conf_service = NET_DEFAULT_PORT;
-
-static lcc_network_t *net;
-
-static c_heap_t *values_heap;
+static bool conf_tcp;
+static const char *conf_socket;
+
+/* The time the first value lists are sent. */
+static double start_time;
+
+/* A value list and the state its values and identifier are derived from.
+ * `vl' comes first, so that the heap can compare the value lists. */
+typedef struct {
+  lcc_value_list_t vl;
+  value_t value;
+  int value_type;
+
+  int index;
+  /* Incremented whenever the value list is given a new identifier. */
+  unsigned int generation;
+  uint64_t random_state;
+} tg_value_t;
+
+/* A generator thread sends the value lists whose index modulo the number of
+ * threads is its own index, over its own sockets. */
+typedef struct {
+  int index;
+  pthread_t thread;
+
+  c_heap_t *heap;
+  tg_value_t *values;
+  size_t values_num;
+
+  /* One network per destination; a value list is sent to one of them. */
+  lcc_network_t *nets[DESTINATIONS_MAX];
+
+  /* When sending to the UNIX socket, the value lists are sent in batches of
+   * up to SOCKET_BATCH_SIZE PUTVAL commands. */
+  lcc_connection_t *conn;
+  lcc_value_list_t socket_batch[SOCKET_BATCH_SIZE];
+  size_t socket_batch_num;
+
+  /* Updated by the thread, read by the main thread. */
+  uint64_t sent;
+  uint64_t errors;
+  bool done;
+} tg_thread_t;
+
+static tg_thread_t **threads;
 
 static struct sigaction sigint_action;
 static struct sigaction sigterm_action;
@@ -82,24 +143,41 @@ __attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
       "    -H <number>    Number of hosts to emulate. (Default: %i)\n"
       "    -p <number>    Number of plugins to emulate. (Default: %i)\n"
       "    -i <seconds>   Interval of each value in seconds. (Default: %.3f)\n"
-      "    -d <dest>      Destination address of the network packets.\n"
-      "                   (Default: %s)\n"
+      "    -t <number>    Number of generator threads. (Default: %i)\n"
+      "    -c <ratio>     Share of the value lists that get a new identifier\n"
+      "                   every interval. (Default: 0)\n"
+      "    -S <number>    Seed of the identifiers and values. (Default: %i)\n"
+      "    -d <dest>      Destination address of the network packets,\n"
+      "                   optionally followed by \":<port>\". May be given up\n"
+      "                   to %i times to spread the value lists over several\n"
+      "                   destinations. (Default: %s)\n"
       "    -D <port>      Destination port of the network packets.\n"
       "                   (Default: %s)\n"
+      "    -b <number>    Number of UDP packets sent with one system call.\n"
+      "                   (Default: %i)\n"
+      "    -T             Send the packets over TCP rather than UDP.\n"
+      "    -s <path>      Send the values to the UNIX socket of the unixsock\n"
+      "                   plugin rather than over the network.\n"
       "    -h             Print usage information (this output).\n"
       "\n"
       "Copyright (C) 2010-2012  Florian Forster\n"
       "Licensed under the MIT license.\n",
       DEF_NUM_VALUES, DEF_NUM_HOSTS, DEF_NUM_PLUGINS, DEF_INTERVAL,
-      NET_DEFAULT_V6_ADDR, NET_DEFAULT_PORT);
+      DEF_NUM_THREADS, DEF_SEED, DESTINATIONS_MAX, NET_DEFAULT_V6_ADDR,
+      NET_DEFAULT_PORT, DEF_SEND_BATCH);
   exit(exit_status);
 } /* }}} void exit_usage */
 
 static void signal_handler(int __attribute__((unused)) signal) /* {{{ */
 {
-  loop = false;
+  __atomic_store_n(&loop, false, __ATOMIC_RELAXED);
 } /* }}} void signal_handler */
 
+static bool running(void) /* {{{ */
+{
+  return __atomic_load_n(&loop, __ATOMIC_RELAXED);
+} /* }}} bool running */
+
 #if HAVE_CLOCK_GETTIME
 static double dtime(void) /* {{{ */
 {
@@ -123,6 +201,16 @@ static double dtime(void) /* {{{ */
 } /* }}} double dtime */
 #endif
 
+static void sleep_double(double seconds) /* {{{ */
+{
+  struct timespec ts = {
+      .tv_sec = (time_t)seconds,
+  };
+  ts.tv_nsec = (long)((seconds - ((double)ts.tv_sec)) * 1e9);
+
+  nanosleep(&ts, /* remaining = */ NULL);
+} /* }}} void sleep_double */
+
 static int compare_time(const void *v0, const void *v1) /* {{{ */
 {
   const lcc_value_list_t *vl0 = v0;
@@ -136,101 +224,304 @@ static int compare_time(const void *v0, const void *v1) /* {{{ */
     return 0;
 } /* }}} int compare_time */
 
-static int get_boundet_random(int min, int max) /* {{{ */
+/* Returns the next number of the xorshift64* generator `state'. Every value
+ * list has its own generator, so that the identifiers and values don't depend
+ * on the number of threads. */
+static uint64_t next_random(uint64_t *state) /* {{{ */
+{
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * UINT64_C(2685821657736338717);
+} /* }}} uint64_t next_random */
+
+/* Returns a random number in [0, 1). */
+static double next_random_double(uint64_t *state) /* {{{ */
 {
-  int range;
+  return (double)(next_random(state) >> 11) / 9007199254740992.0;
+} /* }}} double next_random_double */
 
-  if (min >= max)
-    return -1;
-  if (min == (max - 1))
-    return min;
+/* Sets the identifier of `v' from its index and generation. */
+static void set_identifier(tg_value_t *v) /* {{{ */
+{
+  lcc_identifier_t *id = &v->vl.identifier;
+  int host_num = v->index % conf_num_hosts;
+  int plugin_num = (v->index / conf_num_hosts) % conf_num_plugins;
+
+  snprintf(id->host, sizeof(id->host), "host%04i", host_num);
+  snprintf(id->plugin, sizeof(id->plugin), "plugin%03i", plugin_num);
+  snprintf(id->type, sizeof(id->type), "%s",
+           (v->value_type == LCC_TYPE_GAUGE) ? "gauge" : "derive");
+  if (v->generation == 0)
+    snprintf(id->type_instance, sizeof(id->type_instance), "ti%i", v->index);
+  else
+    snprintf(id->type_instance, sizeof(id->type_instance), "ti%i-%u",
+             v->index, v->generation);
+} /* }}} void set_identifier */
+
+static void create_value_list(tg_value_t *v, int index) /* {{{ */
+{
+  memset(v, 0, sizeof(*v));
+
+  v->index = index;
+  /* Any non-zero state will do. */
+  v->random_state = (((uint64_t)(unsigned int)conf_seed) << 32) ^
+                    (uint64_t)(unsigned int)index ^ UINT64_C(0x9E3779B97F4A7C15);
+
+  v->vl.values = &v->value;
+  v->vl.values_types = &v->value_type;
+  v->vl.values_len = 1;
+
+  if ((next_random(&v->random_state) & 1) == 0)
+    v->value_type = LCC_TYPE_GAUGE;
+  else
+    v->value_type = LCC_TYPE_DERIVE;
 
-  range = max - min;
+  double slots = floor(conf_interval / TIME_SLOT);
+  if (slots < 1.0)
+    slots = 1.0;
+  v->vl.interval = conf_interval;
+  v->vl.time = start_time +
+               TIME_SLOT * floor(slots * next_random_double(&v->random_state));
 
-  return min + ((int)(((double)range) * ((double)random()) /
-                      (((double)RAND_MAX) + 1.0)));
-} /* }}} int get_boundet_random */
+  set_identifier(v);
+} /* }}} void create_value_list */
 
-static lcc_value_list_t *create_value_list(void) /* {{{ */
+static void count_error(tg_thread_t *t, char const *func, int status) /* {{{ */
+{
+  /* Only the first error is printed, they are counted in the report. */
+  if (__atomic_load_n(&t->errors, __ATOMIC_RELAXED) == 0)
+    fprintf(stderr, "Thread %i: %s failed with status %i.\n", t->index, func,
+            status);
+  __atomic_fetch_add(&t->errors, 1, __ATOMIC_RELAXED);
+} /* }}} void count_error */
+
+static void flush_values(tg_thread_t *t) /* {{{ */
 {
-  lcc_value_list_t *vl;
-  int host_num;
+  if (t->conn == NULL) {
+    for (size_t i = 0; i < conf_destinations_num; i++) {
+      int status = lcc_network_flush(t->nets[i]);
+      if (status != 0)
+        count_error(t, "lcc_network_flush", status);
+    }
+    return;
+  }
 
-  vl = calloc(1, sizeof(*vl));
-  if (vl == NULL) {
-    fprintf(stderr, "calloc failed.\n");
-    return NULL;
+  if (t->socket_batch_num == 0)
+    return;
+
+  int status = lcc_putval_batch(t->conn, t->socket_batch, t->socket_batch_num);
+  if (status != 0)
+    count_error(t, "lcc_putval_batch", status);
+  t->socket_batch_num = 0;
+} /* }}} void flush_values */
+
+static void send_value(tg_thread_t *t, tg_value_t *v) /* {{{ */
+{
+  if ((conf_churn > 0.0) &&
+      (next_random_double(&v->random_state) < conf_churn)) {
+    v->generation++;
+    v->value.derive = 0;
+    set_identifier(v);
+  }
+
+  if (v->value_type == LCC_TYPE_GAUGE)
+    v->value.gauge = 100.0 * next_random_double(&v->random_state);
+  else
+    v->value.derive += (derive_t)(next_random(&v->random_state) % 100);
+
+  if (t->conn != NULL) {
+    /* The copy shares "values" with "vl", which is not changed again before
+     * the batch is flushed at the next time stamp. */
+    t->socket_batch[t->socket_batch_num++] = v->vl;
+    if (t->socket_batch_num >= SOCKET_BATCH_SIZE)
+      flush_values(t);
+  } else {
+    lcc_network_t *net = t->nets[(size_t)v->index % conf_destinations_num];
+    int status = lcc_network_values_send(net, &v->vl);
+    if (status != 0)
+      count_error(t, "lcc_network_values_send", status);
+  }
+
+  __atomic_fetch_add(&t->sent, 1, __ATOMIC_RELAXED);
+  v->vl.time += v->vl.interval;
+} /* }}} void send_value */
+
+static void *generator_thread(void *arg) /* {{{ */
+{
+  tg_thread_t *t = arg;
+  double last_time = 0;
+
+  while (running()) {
+    tg_value_t *v = c_heap_get_root(t->heap);
+    if (v == NULL)
+      break;
+
+    if (v->vl.time != last_time) {
+      /* Send the values of this time stamp before sleeping. */
+      flush_values(t);
+
+      for (double now = dtime(); running() && (now < v->vl.time);
+           now = dtime()) {
+        double diff = v->vl.time - now;
+        sleep_double((diff < SLEEP_MAX) ? diff : SLEEP_MAX);
+      }
+      last_time = v->vl.time;
+    }
+
+    send_value(t, v);
+    c_heap_insert(t->heap, v);
+  }
+
+  flush_values(t);
+  __atomic_store_n(&t->done, true, __ATOMIC_RELEASE);
+  return NULL;
+} /* }}} void *generator_thread */
+
+/* Splits "host:port" and "[address]:port" into node and service. Other
+ * destinations, e.g. IPv6 addresses, use the port given with "-D". */
+static void split_destination(char const *dest, char *node, /* {{{ */
+                              size_t node_size, char const **service) {
+  char const *colon = strrchr(dest, ':');
+  *service = conf_service;
+
+  if ((dest[0] == '[') && (colon != NULL) && (colon > dest) &&
+      (colon[-1] == ']')) {
+    snprintf(node, node_size, "%.*s", (int)(colon - dest - 2), dest + 1);
+    *service = colon + 1;
+  } else if ((colon != NULL) && (strchr(dest, ':') == colon)) {
+    snprintf(node, node_size, "%.*s", (int)(colon - dest), dest);
+    *service = colon + 1;
+  } else {
+    snprintf(node, node_size, "%s", dest);
+  }
+} /* }}} void split_destination */
+
+static int connect_thread(tg_thread_t *t) /* {{{ */
+{
+  if (conf_socket != NULL) {
+    if (lcc_connect(conf_socket, &t->conn) != 0) {
+      fprintf(stderr, "lcc_connect (%s) failed.\n", conf_socket);
+      return -1;
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < conf_destinations_num; i++) {
+    t->nets[i] = lcc_network_create();
+    if (t->nets[i] == NULL) {
+      fprintf(stderr, "lcc_network_create failed.\n");
+      return -1;
+    }
+
+    char node[256];
+    char const *service;
+    split_destination(conf_destinations[i], node, sizeof(node), &service);
+
+    lcc_server_t *srv = lcc_server_create(t->nets[i], node, service);
+    if (srv == NULL) {
+      fprintf(stderr, "lcc_server_create failed.\n");
+      return -1;
+    }
+
+    lcc_server_set_ttl(srv, 42);
+    if (conf_tcp && (lcc_server_set_protocol(srv, LCC_PROTOCOL_TCP) != 0)) {
+      fprintf(stderr, "lcc_server_set_protocol failed.\n");
+      return -1;
+    }
+    if (!conf_tcp &&
+        (lcc_server_set_send_batch(srv, (size_t)conf_send_batch) != 0)) {
+      fprintf(stderr, "lcc_server_set_send_batch failed.\n");
+      return -1;
+    }
+#if 0
+    lcc_server_set_security_level (srv, ENCRYPT,
+        "admin", "password1");
+#endif
   }
 
-  vl->values = calloc(/* nmemb = */ 1, sizeof(*vl->values));
-  if (vl->values == NULL) {
+  return 0;
+} /* }}} int connect_thread */
+
+static tg_thread_t *create_thread(int index) /* {{{ */
+{
+  tg_thread_t *t = calloc(1, sizeof(*t));
+  if (t == NULL) {
     fprintf(stderr, "calloc failed.\n");
-    free(vl);
     return NULL;
   }
+  t->index = index;
 
-  vl->values_types = calloc(/* nmemb = */ 1, sizeof(*vl->values_types));
-  if (vl->values_types == NULL) {
-    fprintf(stderr, "calloc failed.\n");
-    free(vl->values);
-    free(vl);
+  t->heap = c_heap_create(compare_time);
+  if (t->heap == NULL) {
+    fprintf(stderr, "c_heap_create failed.\n");
+    free(t);
     return NULL;
   }
 
-  vl->values_len = 1;
+  size_t num = (size_t)(conf_num_values / conf_num_threads);
+  if (index < (conf_num_values % conf_num_threads))
+    num++;
+
+  if (num > 0) {
+    t->values = calloc(num, sizeof(*t->values));
+    if (t->values == NULL) {
+      fprintf(stderr, "calloc failed.\n");
+      c_heap_destroy(t->heap);
+      free(t);
+      return NULL;
+    }
+  }
 
-  host_num = get_boundet_random(0, conf_num_hosts);
+  for (int i = index; i < conf_num_values; i += conf_num_threads) {
+    tg_value_t *v = t->values + t->values_num;
+    create_value_list(v, i);
+    c_heap_insert(t->heap, v);
+    t->values_num++;
+  }
 
-  vl->interval = conf_interval;
-  vl->time = 1.0 + dtime() + (host_num % (1 + (int)vl->interval));
+  return t;
+} /* }}} tg_thread_t *create_thread */
 
-  if (get_boundet_random(0, 2) == 0)
-    vl->values_types[0] = LCC_TYPE_GAUGE;
-  else
-    vl->values_types[0] = LCC_TYPE_DERIVE;
-
-  snprintf(vl->identifier.host, sizeof(vl->identifier.host), "host%04i",
-           host_num);
-  snprintf(vl->identifier.plugin, sizeof(vl->identifier.plugin), "plugin%03i",
-           get_boundet_random(0, conf_num_plugins));
-  strncpy(vl->identifier.type,
-          (vl->values_types[0] == LCC_TYPE_GAUGE) ? "gauge" : "derive",
-          sizeof(vl->identifier.type));
-  vl->identifier.type[sizeof(vl->identifier.type) - 1] = '\0';
-  snprintf(vl->identifier.type_instance, sizeof(vl->identifier.type_instance),
-           "ti%li", random());
-
-  return vl;
-} /* }}} int create_value_list */
-
-static void destroy_value_list(lcc_value_list_t *vl) /* {{{ */
+static void destroy_thread(tg_thread_t *t) /* {{{ */
 {
-  if (vl == NULL)
+  if (t == NULL)
     return;
 
-  free(vl->values);
-  free(vl->values_types);
-  free(vl);
-} /* }}} void destroy_value_list */
-
-static int send_value(lcc_value_list_t *vl) /* {{{ */
-{
-  int status;
+  if (t->heap != NULL) {
+    while (c_heap_get_root(t->heap) != NULL)
+      ;
+    c_heap_destroy(t->heap);
+  }
+  free(t->values);
 
-  if (vl->values_types[0] == LCC_TYPE_GAUGE)
-    vl->values[0].gauge =
-        100.0 * ((gauge_t)random()) / (((gauge_t)RAND_MAX) + 1.0);
-  else
-    vl->values[0].derive += (derive_t)get_boundet_random(0, 100);
+  if (t->conn != NULL)
+    lcc_disconnect(t->conn);
+  for (size_t i = 0; i < conf_destinations_num; i++)
+    lcc_network_destroy(t->nets[i]);
 
-  status = lcc_network_values_send(net, vl);
-  if (status != 0)
-    fprintf(stderr, "lcc_network_values_send failed with status %i.\n", status);
+  free(t);
+} /* }}} void destroy_thread */
 
-  vl->time += vl->interval;
+/* Sums up the counters of all threads. Returns the number of threads still
+ * running. */
+static int get_counters(uint64_t *ret_sent, uint64_t *ret_errors) /* {{{ */
+{
+  int active = 0;
+
+  *ret_sent = 0;
+  *ret_errors = 0;
+  for (int i = 0; i < conf_num_threads; i++) {
+    *ret_sent += __atomic_load_n(&threads[i]->sent, __ATOMIC_RELAXED);
+    *ret_errors += __atomic_load_n(&threads[i]->errors, __ATOMIC_RELAXED);
+    if (!__atomic_load_n(&threads[i]->done, __ATOMIC_ACQUIRE))
+      active++;
+  }
 
-  return 0;
-} /* }}} int send_value */
+  return active;
+} /* }}} int get_counters */
 
 static int get_integer_opt(const char *str, int *ret_value) /* {{{ */
 {
@@ -284,7 +575,7 @@ static int read_options(int argc, char **argv) /* {{{ */
 {
   int opt;
 
-  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:h")) != -1) {
+  while ((opt = getopt(argc, argv, "n:H:p:i:t:c:S:d:D:b:Ts:h")) != -1) {
     switch (opt) {
     case 'n':
       get_integer_opt(optarg, &conf_num_values);
@@ -302,14 +593,43 @@ static int read_options(int argc, char **argv) /* {{{ */
       get_double_opt(optarg, &conf_interval);
       break;
 
+    case 't':
+      get_integer_opt(optarg, &conf_num_threads);
+      break;
+
+    case 'c':
+      get_double_opt(optarg, &conf_churn);
+      break;
+
+    case 'S':
+      get_integer_opt(optarg, &conf_seed);
+      break;
+
     case 'd':
-      conf_destination = optarg;
+      if (conf_destinations_num >= DESTINATIONS_MAX) {
+        fprintf(stderr, "At most %i destinations are supported.\n",
+                DESTINATIONS_MAX);
+        exit(EXIT_FAILURE);
+      }
+      conf_destinations[conf_destinations_num++] = optarg;
       break;
 
     case 'D':
       conf_service = optarg;
       break;
 
+    case 'b':
+      get_integer_opt(optarg, &conf_send_batch);
+      break;
+
+    case 'T':
+      conf_tcp = true;
+      break;
+
+    case 's':
+      conf_socket = optarg;
+      break;
+
     case 'h':
       exit_usage(EXIT_SUCCESS);
 
@@ -318,13 +638,23 @@ static int read_options(int argc, char **argv) /* {{{ */
     } /* switch (opt) */
   }   /* while (getopt) */
 
+  if ((conf_num_values < 0) || (conf_num_hosts < 1) || (conf_num_plugins < 1) ||
+      (conf_interval <= 0.0) || (conf_num_threads < 1) ||
+      (conf_send_batch < 0) || (conf_churn < 0.0) || (conf_churn > 1.0)) {
+    fprintf(stderr, "Invalid option value.\n");
+    exit_usage(EXIT_FAILURE);
+  }
+
+  if (conf_destinations_num == 0)
+    conf_destinations[conf_destinations_num++] = NET_DEFAULT_V6_ADDR;
+
   return 0;
 } /* }}} int read_options */
 
 int main(int argc, char **argv) /* {{{ */
 {
-  double last_time;
-  int values_sent = 0;
+  uint64_t sent = 0;
+  uint64_t errors = 0;
 
   read_options(argc, argv);
 
@@ -334,93 +664,63 @@ int main(int argc, char **argv) /* {{{ */
   sigterm_action.sa_handler = signal_handler;
   sigaction(SIGTERM, &sigterm_action, /* old = */ NULL);
 
-  values_heap = c_heap_create(compare_time);
-  if (values_heap == NULL) {
-    fprintf(stderr, "c_heap_create failed.\n");
+  threads = calloc((size_t)conf_num_threads, sizeof(*threads));
+  if (threads == NULL) {
+    fprintf(stderr, "calloc failed.\n");
     exit(EXIT_FAILURE);
   }
 
-  net = lcc_network_create();
-  if (net == NULL) {
-    fprintf(stderr, "lcc_network_create failed.\n");
-    exit(EXIT_FAILURE);
-  } else {
-    lcc_server_t *srv;
-
-    srv = lcc_server_create(net, conf_destination, conf_service);
-    if (srv == NULL) {
-      fprintf(stderr, "lcc_server_create failed.\n");
-      exit(EXIT_FAILURE);
-    }
-
-    lcc_server_set_ttl(srv, 42);
-#if 0
-    lcc_server_set_security_level (srv, ENCRYPT,
-        "admin", "password1");
-#endif
-  }
-
+  start_time = dtime() + 1.0;
   fprintf(stdout, "Creating %i values ... ", conf_num_values);
   fflush(stdout);
-  for (int i = 0; i < conf_num_values; i++) {
-    lcc_value_list_t *vl;
-
-    vl = create_value_list();
-    if (vl == NULL) {
-      fprintf(stderr, "create_value_list failed.\n");
+  for (int i = 0; i < conf_num_threads; i++) {
+    threads[i] = create_thread(i);
+    if ((threads[i] == NULL) || (connect_thread(threads[i]) != 0))
       exit(EXIT_FAILURE);
-    }
-
-    c_heap_insert(values_heap, vl);
   }
   fprintf(stdout, "done\n");
 
-  last_time = 0;
-  while (loop) {
-    lcc_value_list_t *vl = c_heap_get_root(values_heap);
-
-    if (vl == NULL)
-      break;
-
-    if (vl->time != last_time) {
-      printf("%i values have been sent.\n", values_sent);
-
-      /* Check if we need to sleep */
-      double now = dtime();
-
-      while (now < vl->time) {
-        double diff = vl->time - now;
-        struct timespec ts = {
-            .tv_sec = (time_t)diff,
-        };
-        ts.tv_nsec = (long)((diff - ((double)ts.tv_sec)) * 1e9);
-
-        nanosleep(&ts, /* remaining = */ NULL);
-        now = dtime();
-
-        if (!loop)
-          break;
-      }
-      last_time = vl->time;
+  for (int i = 0; i < conf_num_threads; i++) {
+    int status = pthread_create(&threads[i]->thread, /* attr = */ NULL,
+                                generator_thread, threads[i]);
+    if (status != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(status));
+      exit(EXIT_FAILURE);
     }
+  }
 
-    send_value(vl);
-    values_sent++;
-
-    c_heap_insert(values_heap, vl);
+  /* Reports the progress once a second. */
+  double last_time = dtime();
+  uint64_t last_sent = 0;
+  while (running() && (get_counters(&sent, &errors) > 0)) {
+    sleep_double(1.0);
+
+    get_counters(&sent, &errors);
+    double now = dtime();
+    printf("%" PRIu64 " values have been sent. (%.0f values/s, %" PRIu64
+           " send errors)\n",
+           sent, (double)(sent - last_sent) / (now - last_time), errors);
+    fflush(stdout);
+    last_time = now;
+    last_sent = sent;
   }
 
+  __atomic_store_n(&loop, false, __ATOMIC_RELAXED);
+  for (int i = 0; i < conf_num_threads; i++)
+    pthread_join(threads[i]->thread, /* retval = */ NULL);
+
+  get_counters(&sent, &errors);
+  double elapsed = dtime() - start_time;
+  printf("%" PRIu64 " values have been sent in %.3f seconds. (%.0f values/s, "
+         "%.0f values/s offered, %" PRIu64 " send errors)\n",
+         sent, elapsed, (elapsed > 0.0) ? (double)sent / elapsed : 0.0,
+         (double)conf_num_values / conf_interval, errors);
   fprintf(stdout, "Shutting down.\n");
   fflush(stdout);
 
-  while (42) {
-    lcc_value_list_t *vl = c_heap_get_root(values_heap);
-    if (vl == NULL)
-      break;
-    destroy_value_list(vl);
-  }
-  c_heap_destroy(values_heap);
+  for (int i = 0; i < conf_num_threads; i++)
+    destroy_thread(threads[i]);
+  free(threads);
 
-  lcc_network_destroy(net);
   exit(EXIT_SUCCESS);
 } /* }}} int main */
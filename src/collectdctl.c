@@ -94,9 +94,11 @@ __attribute__((noreturn)) static void exit_usage(const char *name, int status) {
       "\nAvailable commands:\n\n"
 
       " * getval <identifier>\n"
+      " * getrange <identifier> [start=<seconds>] [end=<seconds>]\n"
       " * flush [timeout=<seconds>] [plugin=<name>] [identifier=<id>]\n"
       " * listval\n"
       " * putval <identifier> [interval=<seconds>] <value-list(s)>\n"
+      " * reload\n"
 
       "\nIdentifiers:\n\n"
 
@@ -228,6 +230,82 @@ static int getval(lcc_connection_t *c, int argc, char **argv) {
 #undef BAIL_OUT
 } /* getval */
 
+static int getrange(lcc_connection_t *c, int argc, char **argv) {
+  lcc_identifier_t ident;
+  double start = 0.0;
+  double end = 0.0;
+
+  size_t ret_points_num = 0;
+  double *ret_times = NULL;
+  size_t ret_values_num = 0;
+  gauge_t *ret_values = NULL;
+  char **ret_values_names = NULL;
+
+  int status;
+
+  assert(strcasecmp(argv[0], "getrange") == 0);
+
+  if (argc < 2) {
+    fprintf(stderr, "ERROR: getrange: Missing identifier.\n");
+    return -1;
+  }
+
+  status = parse_identifier(c, argv[1], &ident);
+  if (status != 0)
+    return status;
+
+  for (int i = 2; i < argc; ++i) {
+    char *key = argv[i];
+    char *value = strchr(argv[i], (int)'=');
+    if (value == NULL) {
+      fprintf(stderr, "ERROR: getrange: Invalid option ``%s''.\n", argv[i]);
+      return -1;
+    }
+    *value = '\0';
+    ++value;
+
+    double *t;
+    if (strcasecmp(key, "start") == 0)
+      t = &start;
+    else if (strcasecmp(key, "end") == 0)
+      t = &end;
+    else {
+      fprintf(stderr, "ERROR: getrange: Unknown option `%s'.\n", key);
+      return -1;
+    }
+
+    char *endptr = NULL;
+    *t = strtod(value, &endptr);
+    if ((endptr == value) || (*endptr != '\0')) {
+      fprintf(stderr, "ERROR: getrange: Failed to parse %s as number: %s.\n",
+              key, value);
+      return -1;
+    }
+  }
+
+  status = lcc_getrange(c, &ident, start, end, &ret_points_num, &ret_times,
+                        &ret_values_num, &ret_values, &ret_values_names);
+  if (status != 0) {
+    fprintf(stderr, "ERROR: %s\n", lcc_strerror(c));
+    return -1;
+  }
+
+  for (size_t i = 0; i < ret_points_num; ++i) {
+    printf("%.3f", ret_times[i]);
+    for (size_t j = 0; j < ret_values_num; ++j)
+      printf(" %s=%e", ret_values_names[j],
+             ret_values[i * ret_values_num + j]);
+    printf("\n");
+  }
+
+  for (size_t j = 0; j < ret_values_num; ++j)
+    free(ret_values_names[j]);
+  free(ret_values_names);
+  free(ret_values);
+  free(ret_times);
+  return 0;
+} /* getrange */
+
 static int flush(lcc_connection_t *c, int argc, char **argv) {
   int timeout = -1;
 
@@ -381,6 +459,21 @@ static int listval(lcc_connection_t *c, int argc, char **argv) {
 #undef BAIL_OUT
 } /* listval */
 
+static int reload(lcc_connection_t *c, int argc, char **argv) {
+  assert(strcasecmp(argv[0], "reload") == 0);
+
+  if (argc != 1) {
+    fprintf(stderr, "ERROR: reload: Does not accept any arguments.\n");
+    return -1;
+  }
+
+  if (lcc_reload(c) != 0) {
+    fprintf(stderr, "ERROR: %s\n", lcc_strerror(c));
+    return -1;
+  }
+  return 0;
+} /* reload */
+
 static int putval(lcc_connection_t *c, int argc, char **argv) {
   lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
 
@@ -568,12 +661,16 @@ int main(int argc, char **argv) {
 
   if (strcasecmp(argv[optind], "getval") == 0)
     status = getval(c, argc - optind, argv + optind);
+  else if (strcasecmp(argv[optind], "getrange") == 0)
+    status = getrange(c, argc - optind, argv + optind);
   else if (strcasecmp(argv[optind], "flush") == 0)
     status = flush(c, argc - optind, argv + optind);
   else if (strcasecmp(argv[optind], "listval") == 0)
     status = listval(c, argc - optind, argv + optind);
   else if (strcasecmp(argv[optind], "putval") == 0)
     status = putval(c, argc - optind, argv + optind);
+  else if (strcasecmp(argv[optind], "reload") == 0)
+    status = reload(c, argc - optind, argv + optind);
   else {
     fprintf(stderr, "%s: invalid command: %s\n", argv[0], argv[optind]);
     return 1;
@@ -30,22 +30,83 @@
 #error "No applicable input method."
 #endif
 
+#if HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+#include <linux/netlink.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 #define CONNTRACK_FILE "/proc/sys/net/netfilter/nf_conntrack_count"
 #define CONNTRACK_MAX_FILE "/proc/sys/net/netfilter/nf_conntrack_max"
 #define CONNTRACK_FILE_OLD "/proc/sys/net/ipv4/netfilter/ip_conntrack_count"
 #define CONNTRACK_MAX_FILE_OLD "/proc/sys/net/ipv4/netfilter/ip_conntrack_max"
 
-static const char *config_keys[] = {"OldFiles"};
+static const char *config_keys[] = {"OldFiles", "CollectStatistics",
+                                     "StatisticsPerCPU"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 /*
     Each table/chain combo that will be queried goes into this list
 */
 
 static int old_files;
+static bool collect_statistics;
+static bool statistics_per_cpu;
+
+#if HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+#define CONNTRACK_NETLINK_BUFFER_SIZE 16384
+
+/* The per-CPU counters reported by the kernel, by attribute type. Counters
+ * the kernel no longer maintains are left out. */
+static struct {
+  int attr;
+  char const *name;
+} const conntrack_stats[] = {
+    {CTA_STATS_FOUND, "found"},
+    {CTA_STATS_INVALID, "invalid"},
+    {CTA_STATS_INSERT, "insert"},
+    {CTA_STATS_INSERT_FAILED, "insert_failed"},
+    {CTA_STATS_DROP, "drop"},
+    {CTA_STATS_EARLY_DROP, "early_drop"},
+    {CTA_STATS_ERROR, "error"},
+#if HAVE_DECL_CTA_STATS_SEARCH_RESTART
+    {CTA_STATS_SEARCH_RESTART, "search_restart"},
+#endif
+#if HAVE_DECL_CTA_STATS_CLASH_RESOLVE
+    {CTA_STATS_CLASH_RESOLVE, "clash_resolve"},
+#endif
+#if HAVE_DECL_CTA_STATS_CHAIN_TOOLONG
+    {CTA_STATS_CHAIN_TOOLONG, "chain_toolong"},
+#endif
+};
+#define CONNTRACK_STATS_NUM STATIC_ARRAY_SIZE(conntrack_stats)
+
+/* The kernel's counters are 32 bit wide and wrap around. They are
+ * accumulated into 64 bit totals, so that the sum over all CPUs does not
+ * wrap around when a single counter does. */
+typedef struct {
+  bool valid;
+  uint32_t last[CONNTRACK_STATS_NUM];
+  uint64_t total[CONNTRACK_STATS_NUM];
+} conntrack_cpu_t;
+
+static conntrack_cpu_t *cpus;
+static size_t cpus_num;
+
+/* The socket is kept open between reads. */
+static int nl_fd = -1;
+static uint32_t nl_seq;
+static char *nl_buffer;
+#endif /* HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU */
 
 static int conntrack_config(const char *key, const char *value) {
   if (strcmp(key, "OldFiles") == 0)
     old_files = 1;
+  else if (strcasecmp(key, "CollectStatistics") == 0)
+    collect_statistics = IS_TRUE(value);
+  else if (strcasecmp(key, "StatisticsPerCPU") == 0)
+    statistics_per_cpu = IS_TRUE(value);
 
   return 0;
 }
@@ -64,6 +125,181 @@ static void conntrack_submit(const char *type, const char *type_instance,
   plugin_dispatch_values(&vl);
 } /* static void conntrack_submit */
 
+#if HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+static void conntrack_cpu_submit(size_t cpu, const char *type_instance,
+                                 uint64_t total) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  vl.values = &(value_t){.derive = (derive_t)total};
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "conntrack", sizeof(vl.plugin));
+  snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%zu", cpu);
+  sstrncpy(vl.type, "operations", sizeof(vl.type));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  plugin_dispatch_values(&vl);
+} /* void conntrack_cpu_submit */
+
+static void conntrack_stats_submit(void) {
+  uint64_t sum[CONNTRACK_STATS_NUM] = {0};
+
+  for (size_t i = 0; i < cpus_num; i++) {
+    if (!cpus[i].valid)
+      continue;
+
+    for (size_t j = 0; j < CONNTRACK_STATS_NUM; j++) {
+      if (statistics_per_cpu)
+        conntrack_cpu_submit(i, conntrack_stats[j].name, cpus[i].total[j]);
+      else
+        sum[j] += cpus[i].total[j];
+    }
+  }
+
+  if (statistics_per_cpu)
+    return;
+
+  for (size_t j = 0; j < CONNTRACK_STATS_NUM; j++)
+    conntrack_submit("operations", conntrack_stats[j].name,
+                     (value_t){.derive = (derive_t)sum[j]});
+} /* void conntrack_stats_submit */
+
+/* Accumulates the counters of the CPU "cpu" from the attributes of a
+ * message. */
+static int conntrack_stats_handle(uint16_t cpu, struct nlmsghdr *h) {
+  if (cpu >= cpus_num) {
+    conntrack_cpu_t *tmp = realloc(cpus, (cpu + 1) * sizeof(*cpus));
+    if (tmp == NULL) {
+      ERROR("conntrack plugin: realloc failed.");
+      return ENOMEM;
+    }
+    memset(tmp + cpus_num, 0, (cpu + 1 - cpus_num) * sizeof(*cpus));
+    cpus = tmp;
+    cpus_num = cpu + 1;
+  }
+  conntrack_cpu_t *c = cpus + cpu;
+
+  size_t offset = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+  while (offset + NLA_HDRLEN <= h->nlmsg_len) {
+    struct nlattr *a = (struct nlattr *)((char *)h + NLMSG_ALIGN(offset));
+    if ((a->nla_len < NLA_HDRLEN) || (offset + a->nla_len > h->nlmsg_len))
+      break;
+
+    int type = a->nla_type & NLA_TYPE_MASK;
+    for (size_t i = 0; i < CONNTRACK_STATS_NUM; i++) {
+      if ((conntrack_stats[i].attr != type) ||
+          (a->nla_len < NLA_HDRLEN + sizeof(uint32_t)))
+        continue;
+
+      uint32_t v;
+      memcpy(&v, (char *)a + NLA_HDRLEN, sizeof(v));
+      v = ntohl(v);
+
+      /* The difference is correct across a wrap-around of the counter. */
+      if (c->valid)
+        c->total[i] += (uint32_t)(v - c->last[i]);
+      else
+        c->total[i] = v;
+      c->last[i] = v;
+      break;
+    }
+
+    offset = NLMSG_ALIGN(offset) + NLA_ALIGN(a->nla_len);
+  }
+
+  c->valid = true;
+  return 0;
+} /* int conntrack_stats_handle */
+
+/* Requests the per-CPU statistics from ctnetlink. Returns zero on success
+ * and an errno value otherwise. */
+static int conntrack_stats_read(void) {
+  if (nl_buffer == NULL) {
+    nl_buffer = malloc(CONNTRACK_NETLINK_BUFFER_SIZE);
+    if (nl_buffer == NULL) {
+      ERROR("conntrack plugin: malloc failed.");
+      return ENOMEM;
+    }
+  }
+
+  if (nl_fd < 0) {
+    nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+    if (nl_fd < 0) {
+      int status = errno;
+      ERROR("conntrack plugin: socket(AF_NETLINK, SOCK_RAW, "
+            "NETLINK_NETFILTER) failed: %s",
+            STRERRNO);
+      return status;
+    }
+  }
+
+  struct {
+    struct nlmsghdr nlh;
+    struct nfgenmsg nfg;
+  } req = {
+      .nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg)),
+      .nlh.nlmsg_type =
+          (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_GET_STATS_CPU,
+      .nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+      /* As with tcpconns, the sequence number tells the reply to this
+       * request apart from leftovers of an earlier one. */
+      .nlh.nlmsg_seq = ++nl_seq,
+      .nfg.nfgen_family = AF_UNSPEC,
+      .nfg.version = NFNETLINK_V0,
+  };
+  struct sockaddr_nl nladdr = {.nl_family = AF_NETLINK};
+
+  if (sendto(nl_fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr *)&nladdr,
+             sizeof(nladdr)) < 0) {
+    int status = errno;
+    ERROR("conntrack plugin: sendto(2) failed: %s", STRERRNO);
+    close(nl_fd);
+    nl_fd = -1;
+    return status;
+  }
+
+  while (1) {
+    ssize_t status =
+        recv(nl_fd, nl_buffer, CONNTRACK_NETLINK_BUFFER_SIZE, /* flags = */ 0);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      int err = errno;
+      ERROR("conntrack plugin: recv(2) failed: %s", STRERRNO);
+      close(nl_fd);
+      nl_fd = -1;
+      return err;
+    } else if (status == 0) {
+      return 0;
+    }
+
+    for (struct nlmsghdr *h = (struct nlmsghdr *)nl_buffer;
+         NLMSG_OK(h, status); h = NLMSG_NEXT(h, status)) {
+      if (h->nlmsg_seq != nl_seq)
+        continue;
+
+      if (h->nlmsg_type == NLMSG_DONE)
+        return 0;
+
+      if (h->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *err = NLMSG_DATA(h);
+        if (err->error == 0) /* acknowledgement */
+          continue;
+        return -err->error;
+      }
+
+      if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nfgenmsg)))
+        continue;
+
+      struct nfgenmsg *nfg = NLMSG_DATA(h);
+      int err = conntrack_stats_handle(ntohs(nfg->res_id), h);
+      if (err != 0)
+        return err;
+    }
+  } /* while (1) */
+} /* int conntrack_stats_read */
+#endif /* HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU */
+
 static int conntrack_read(void) {
   value_t conntrack, conntrack_max, conntrack_pct;
 
@@ -85,11 +321,52 @@ static int conntrack_read(void) {
   conntrack_submit("conntrack", "max", conntrack_max);
   conntrack_submit("percent", "used", conntrack_pct);
 
+#if HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+  if (collect_statistics) {
+    int status = conntrack_stats_read();
+    if (status != 0) {
+      /* Most likely CAP_NET_ADMIN is missing. */
+      WARNING("conntrack plugin: Reading the statistics from ctnetlink "
+              "failed: %s. Disabling CollectStatistics.",
+              STRERROR(status));
+      collect_statistics = false;
+      return 0;
+    }
+
+    conntrack_stats_submit();
+  }
+#endif
+
   return 0;
 } /* static int conntrack_read */
 
+static int conntrack_init(void) {
+#if !HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+  if (collect_statistics) {
+    WARNING("conntrack plugin: CollectStatistics is not supported by this "
+            "build, ctnetlink's headers are missing.");
+    collect_statistics = false;
+  }
+#endif
+  return 0;
+} /* static int conntrack_init */
+
+static int conntrack_shutdown(void) {
+#if HAVE_DECL_IPCTNL_MSG_CT_GET_STATS_CPU
+  if (nl_fd >= 0)
+    close(nl_fd);
+  nl_fd = -1;
+  sfree(nl_buffer);
+  sfree(cpus);
+  cpus_num = 0;
+#endif
+  return 0;
+} /* static int conntrack_shutdown */
+
 void module_register(void) {
   plugin_register_config("conntrack", conntrack_config, config_keys,
                          config_keys_num);
+  plugin_register_init("conntrack", conntrack_init);
   plugin_register_read("conntrack", conntrack_read);
+  plugin_register_shutdown("conntrack", conntrack_shutdown);
 } /* void module_register */
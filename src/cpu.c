@@ -130,7 +130,8 @@ static mach_msg_type_number_t cpu_list_len;
 /* #endif PROCESSOR_CPU_LOAD_INFO */
 
 #elif defined(KERNEL_LINUX)
-/* no variables needed */
+#include "utils/procfs/procfs.h"
+static procfs_file_t *proc_stat;
 /* #endif KERNEL_LINUX */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -634,18 +635,24 @@ static int cpu_read(void) {
 
 #elif defined(KERNEL_LINUX) /* {{{ */
   int cpu;
-  FILE *fh;
-  char buf[1024];
+  char *buf;
 
   char *fields[11];
   int numfields;
 
-  if ((fh = fopen("/proc/stat", "r")) == NULL) {
-    ERROR("cpu plugin: fopen (/proc/stat) failed: %s", STRERRNO);
+  if ((proc_stat == NULL) &&
+      ((proc_stat = procfs_open("/proc/stat")) == NULL)) {
+    ERROR("cpu plugin: open (/proc/stat) failed: %s", STRERRNO);
     return -1;
   }
 
-  while (fgets(buf, 1024, fh) != NULL) {
+  int status = procfs_read(proc_stat);
+  if (status != 0) {
+    ERROR("cpu plugin: reading /proc/stat failed: %s", STRERROR(status));
+    return -1;
+  }
+
+  while ((buf = procfs_next_line(proc_stat)) != NULL) {
     if (strncmp(buf, "cpu", 3))
       continue;
     if ((buf[3] < '0') || (buf[3] > '9'))
@@ -707,7 +714,6 @@ static int cpu_read(void) {
     cpu_stage(cpu, COLLECTD_CPU_STATE_USER, (derive_t)user_value, now);
     cpu_stage(cpu, COLLECTD_CPU_STATE_NICE, (derive_t)nice_value, now);
   }
-  fclose(fh);
 /* }}} #endif defined(KERNEL_LINUX) */
 
 #elif defined(HAVE_LIBKSTAT) /* {{{ */
@@ -881,8 +887,19 @@ static int cpu_read(void) {
   return 0;
 }
 
+#if !PROCESSOR_CPU_LOAD_INFO && KERNEL_LINUX
+static int cpu_shutdown(void) {
+  procfs_close(proc_stat);
+  proc_stat = NULL;
+  return 0;
+}
+#endif
+
 void module_register(void) {
   plugin_register_init("cpu", init);
   plugin_register_config("cpu", cpu_config, config_keys, config_keys_num);
   plugin_register_read("cpu", cpu_read);
+#if !PROCESSOR_CPU_LOAD_INFO && KERNEL_LINUX
+  plugin_register_shutdown("cpu", cpu_shutdown);
+#endif
 } /* void module_register */
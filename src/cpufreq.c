@@ -24,77 +24,144 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/sysfs/sysfs.h"
 
 #define MAX_AVAIL_FREQS 20
 
-static int num_cpu;
+#ifndef CPUFREQ_DIR
+#define CPUFREQ_DIR "/sys/devices/system/cpu"
+#endif
+#define CPUFREQ_DEVPATH "/devices/system/cpu"
 
-struct cpu_data_t {
-  value_to_rate_state_t time_state[MAX_AVAIL_FREQS];
-} * cpu_data;
-
-/* Flags denoting capability of reporting CPU frequency statistics. */
-static bool report_p_stats = false;
-
-static void cpufreq_stats_init(void) {
-  cpu_data = calloc(num_cpu, sizeof(*cpu_data));
-  if (cpu_data == NULL)
-    return;
+/* The files of a CPU in the sysfs set, -1 if the CPU doesn't have them. */
+typedef struct {
+  int cpu;
+  int cur_freq;
+  int total_trans;
+  int time_in_state;
+} cpufreq_cpu_t;
 
-  report_p_stats = true;
+static sysfs_set_t *set;
+/* Tells when CPUs have been added, removed, brought online or taken offline,
+ * so that the CPUs are looked for again. */
+static sysfs_monitor_t *monitor;
 
-  /* Check for stats module and disable if not present. */
-  for (int i = 0; i < num_cpu; i++) {
-    char filename[PATH_MAX];
+static cpufreq_cpu_t *cpus;
+static size_t cpus_num;
 
-    snprintf(filename, sizeof(filename),
-             "/sys/devices/system/cpu/cpu%d/cpufreq/stats/time_in_state", i);
-    if (access(filename, R_OK)) {
-      NOTICE("cpufreq plugin: File %s not exists or no access. P-State "
-             "statistics will not be reported. Check if `cpufreq-stats' kernel "
-             "module is loaded.",
-             filename);
-      report_p_stats = false;
-      break;
-    }
+/* Indexed by the CPU number and kept when the CPUs are looked for again. */
+struct cpu_data_t {
+  value_to_rate_state_t time_state[MAX_AVAIL_FREQS];
+} * cpu_data;
+static size_t cpu_data_num;
 
-    snprintf(filename, sizeof(filename),
-             "/sys/devices/system/cpu/cpu%d/cpufreq/stats/total_trans", i);
-    if (access(filename, R_OK)) {
-      NOTICE("cpufreq plugin: File %s not exists or no access. P-State "
-             "statistics will not be reported. Check if `cpufreq-stats' kernel "
-             "module is loaded.",
-             filename);
-      report_p_stats = false;
-      break;
-    }
-  }
-  return;
+static int cpufreq_cpu_compare(void const *a, void const *b) {
+  return ((cpufreq_cpu_t const *)a)->cpu - ((cpufreq_cpu_t const *)b)->cpu;
 }
 
-static int cpufreq_init(void) {
+static int cpufreq_scan_cpu(__attribute__((unused)) const char *dir,
+                            const char *name,
+                            __attribute__((unused)) void *user_data) {
   char filename[PATH_MAX];
+  char *endptr = NULL;
+
+  if (strncmp("cpu", name, strlen("cpu")) != 0)
+    return 0;
+  long cpu = strtol(name + strlen("cpu"), &endptr, 10);
+  if ((endptr == name + strlen("cpu")) || (*endptr != 0) || (cpu < 0) ||
+      (cpu > INT_MAX))
+    return 0;
+
+  /* Offline CPUs and CPUs without cpufreq are skipped. */
+  snprintf(filename, sizeof(filename), "cpu%ld/cpufreq/scaling_cur_freq",
+           cpu);
+  int cur_freq = sysfs_set_add(set, filename);
+  if (cur_freq < 0)
+    return 0;
+
+  cpufreq_cpu_t *tmp = realloc(cpus, (cpus_num + 1) * sizeof(*cpus));
+  if (tmp == NULL)
+    return -1;
+  cpus = tmp;
+  cpus[cpus_num] = (cpufreq_cpu_t){
+      .cpu = (int)cpu,
+      .cur_freq = cur_freq,
+      .total_trans = -1,
+      .time_in_state = -1,
+  };
+
+  if ((size_t)cpu >= cpu_data_num) {
+    struct cpu_data_t *data =
+        realloc(cpu_data, ((size_t)cpu + 1) * sizeof(*cpu_data));
+    if (data == NULL)
+      return -1;
+    memset(data + cpu_data_num, 0,
+           ((size_t)cpu + 1 - cpu_data_num) * sizeof(*cpu_data));
+    cpu_data = data;
+    cpu_data_num = (size_t)cpu + 1;
+  }
 
-  num_cpu = 0;
+  /* Report P-State statistics only if both files are available. */
+  char trans[PATH_MAX];
+  char time_in_state[PATH_MAX];
+  snprintf(trans, sizeof(trans), "cpu%ld/cpufreq/stats/total_trans", cpu);
+  snprintf(time_in_state, sizeof(time_in_state),
+           "cpu%ld/cpufreq/stats/time_in_state", cpu);
+  cpus[cpus_num].total_trans = sysfs_set_add(set, trans);
+  if (cpus[cpus_num].total_trans >= 0)
+    cpus[cpus_num].time_in_state = sysfs_set_add(set, time_in_state);
+
+  if (cpus[cpus_num].time_in_state < 0) {
+    static bool reported;
+    if (!reported)
+      NOTICE("cpufreq plugin: File " CPUFREQ_DIR "/%s not exists or no "
+             "access. P-State statistics will not be reported. Check if "
+             "`cpufreq-stats' kernel module is loaded.",
+             (cpus[cpus_num].total_trans < 0) ? trans : time_in_state);
+    reported = true;
+  }
 
-  while (1) {
-    int status = snprintf(filename, sizeof(filename),
-                          "/sys/devices/system/cpu/cpu%d/cpufreq/"
-                          "scaling_cur_freq",
-                          num_cpu);
-    if ((status < 1) || ((unsigned int)status >= sizeof(filename)))
-      break;
+  cpus_num++;
+  return 0;
+} /* int cpufreq_scan_cpu */
+
+/* Looks for the CPUs and opens their files. */
+static int cpufreq_scan(void) {
+  sysfs_set_clear(set);
+  sfree(cpus);
+  cpus_num = 0;
+
+  if (walk_directory(CPUFREQ_DIR, cpufreq_scan_cpu, /* user_data = */ NULL,
+                     /* include hidden = */ 0) != 0) {
+    ERROR("cpufreq plugin: Looking for CPUs in " CPUFREQ_DIR " failed.");
+    return -1;
+  }
 
-    if (access(filename, R_OK))
-      break;
+  if (cpus_num > 0)
+    qsort(cpus, cpus_num, sizeof(*cpus), cpufreq_cpu_compare);
+
+  INFO("cpufreq plugin: Found %" PRIsz " CPU%s", cpus_num,
+       (cpus_num == 1) ? "" : "s");
+  return 0;
+} /* int cpufreq_scan */
 
-    num_cpu++;
+static int cpufreq_init(void) {
+  set = sysfs_set_create(CPUFREQ_DIR);
+  if (set == NULL) {
+    ERROR("cpufreq plugin: Opening " CPUFREQ_DIR " failed: %s", STRERRNO);
+    plugin_unregister_read("cpufreq");
+    return 0;
   }
 
-  INFO("cpufreq plugin: Found %d CPU%s", num_cpu, (num_cpu == 1) ? "" : "s");
-  cpufreq_stats_init();
+  monitor = sysfs_monitor_open(CPUFREQ_DEVPATH);
+  if (monitor == NULL)
+    NOTICE("cpufreq plugin: Receiving uevents failed: %s. CPUs will only be "
+           "looked for again when reading one fails.",
+           STRERRNO);
 
-  if (num_cpu == 0)
+  cpufreq_scan();
+
+  if ((cpus_num == 0) && (monitor == NULL))
     plugin_unregister_read("cpufreq");
 
   return 0;
@@ -116,35 +183,34 @@ static void cpufreq_submit(int cpu_num, const char *type,
   plugin_dispatch_values(&vl);
 }
 
-static void cpufreq_read_stats(int cpu) {
-  char filename[PATH_MAX];
-  /* Read total transitions for cpu frequency */
-  snprintf(filename, sizeof(filename),
-           "/sys/devices/system/cpu/cpu%d/cpufreq/stats/total_trans", cpu);
+static void cpufreq_read_stats(cpufreq_cpu_t const *c, cdtime_t now) {
+  int cpu = c->cpu;
 
+  /* Read total transitions for cpu frequency */
   value_t v;
-  if (parse_value_file(filename, &v, DS_TYPE_DERIVE) != 0) {
-    ERROR("cpufreq plugin: Reading \"%s\" failed.", filename);
+  if (sysfs_set_value(set, c->total_trans, &v, DS_TYPE_DERIVE) != 0) {
+    ERROR("cpufreq plugin: Reading \"" CPUFREQ_DIR
+          "/cpu%d/cpufreq/stats/total_trans\" failed.",
+          cpu);
     return;
   }
   cpufreq_submit(cpu, "transitions", NULL, &v);
 
   /* Determine percentage time in each state for cpu during previous
    * interval. */
-  snprintf(filename, sizeof(filename),
-           "/sys/devices/system/cpu/cpu%d/cpufreq/stats/time_in_state", cpu);
-
-  FILE *fh = fopen(filename, "r");
-  if (fh == NULL) {
-    ERROR("cpufreq plugin: Reading \"%s\" failed.", filename);
+  char *content = sysfs_set_content(set, c->time_in_state);
+  if (content == NULL) {
+    ERROR("cpufreq plugin: Reading \"" CPUFREQ_DIR
+          "/cpu%d/cpufreq/stats/time_in_state\" failed.",
+          cpu);
     return;
   }
 
   int state_index = 0;
-  cdtime_t now = cdtime();
-  char buffer[DATA_MAX_NAME_LEN];
+  char *saveptr = NULL;
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  for (char *line = strtok_r(content, "\n", &saveptr); line != NULL;
+       line = strtok_r(NULL, "\n", &saveptr)) {
     unsigned int frequency;
     unsigned long long time;
 
@@ -153,8 +219,10 @@ static void cpufreq_read_stats(int cpu) {
      * we have to divide by 100. To get percents we have to multiply it
      * by 100 back. So, just use parsed value directly.
      */
-    if (!sscanf(buffer, "%u%llu", &frequency, &time)) {
-      ERROR("cpufreq plugin: Reading \"%s\" failed.", filename);
+    if (!sscanf(line, "%u%llu", &frequency, &time)) {
+      ERROR("cpufreq plugin: Reading \"" CPUFREQ_DIR
+            "/cpu%d/cpufreq/stats/time_in_state\" failed.",
+            cpu);
       break;
     }
 
@@ -182,34 +250,56 @@ static void cpufreq_read_stats(int cpu) {
     }
     state_index++;
   }
-  fclose(fh);
 }
 
 static int cpufreq_read(void) {
-  for (int cpu = 0; cpu < num_cpu; cpu++) {
-    char filename[PATH_MAX];
-    /* Read cpu frequency */
-    snprintf(filename, sizeof(filename),
-             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+  if (sysfs_monitor_changed(monitor))
+    cpufreq_scan();
 
+  /* Without uevents, a CPU that went away is noticed by its files failing. */
+  if ((sysfs_set_read(set) > 0) && (monitor == NULL)) {
+    cpufreq_scan();
+    sysfs_set_read(set);
+  }
+
+  cdtime_t now = cdtime();
+  for (size_t i = 0; i < cpus_num; i++) {
+    cpufreq_cpu_t const *c = cpus + i;
+
+    /* Read cpu frequency */
     value_t v;
-    if (parse_value_file(filename, &v, DS_TYPE_GAUGE) != 0) {
-      WARNING("cpufreq plugin: Reading \"%s\" failed.", filename);
+    if (sysfs_set_value(set, c->cur_freq, &v, DS_TYPE_GAUGE) != 0) {
+      WARNING("cpufreq plugin: Reading \"" CPUFREQ_DIR
+              "/cpu%d/cpufreq/scaling_cur_freq\" failed.",
+              c->cpu);
       continue;
     }
 
     /* convert kHz to Hz */
     v.gauge *= 1000.0;
 
-    cpufreq_submit(cpu, "cpufreq", NULL, &v);
+    cpufreq_submit(c->cpu, "cpufreq", NULL, &v);
 
-    if (report_p_stats)
-      cpufreq_read_stats(cpu);
+    if (c->time_in_state >= 0)
+      cpufreq_read_stats(c, now);
   }
   return 0;
 } /* int cpufreq_read */
 
+static int cpufreq_shutdown(void) {
+  sysfs_monitor_close(monitor);
+  monitor = NULL;
+  sysfs_set_destroy(set);
+  set = NULL;
+  sfree(cpus);
+  cpus_num = 0;
+  sfree(cpu_data);
+  cpu_data_num = 0;
+  return 0;
+} /* int cpufreq_shutdown */
+
 void module_register(void) {
   plugin_register_init("cpufreq", cpufreq_init);
   plugin_register_read("cpufreq", cpufreq_read);
+  plugin_register_shutdown("cpufreq", cpufreq_shutdown);
 }
@@ -141,6 +141,20 @@ static inline PyObject *cpy_string_to_unicode_or_bytes(const char *buf) {
 
 void cpy_log_exception(const char *context);
 
+/* Worker processes, see pyworker.c. */
+int cpy_workers_start(size_t num, int (*run)(void *arg));
+void cpy_workers_stop(void);
+/* Runs "arg" in one of the workers, selected by "index". Returns -1 if there
+ * is no worker to run it, so it has to be run in this process. */
+int cpy_worker_read(size_t index, void *arg);
+bool cpy_in_worker(void);
+/* Like plugin_dispatch_values_batch, plugin_dispatch_notification and
+ * plugin_log, but in a worker the data is sent to the collectd process. */
+int cpy_dispatch_values(value_list_t const *vls, size_t num);
+int cpy_dispatch_notification(notification_t const *n);
+void cpy_log(int level, char const *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
 /* Python object declarations. */
 
 typedef struct {
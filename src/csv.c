@@ -24,18 +24,27 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/file_io/file_io.h"
 #include "utils_cache.h"
+#include "utils_complain.h"
 
 /*
  * Private variables
  */
-static const char *config_keys[] = {"DataDir", "StoreRates"};
+static const char *config_keys[] = {"DataDir",    "StoreRates",
+                                    "MaxOpenFiles", "BufferSize",
+                                    "BufferTimeout", "IOUring"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static char *datadir;
 static int store_rates;
 static int use_stdio;
+static int max_open_files;
+static size_t buffer_size = 4096;
+static cdtime_t buffer_timeout = TIME_T_TO_CDTIME_T_STATIC(10);
+static bool use_uring = true;
 
 static int value_list_to_string(char *buffer, int buffer_len,
                                 const data_set_t *ds, const value_list_t *vl) {
@@ -175,6 +184,295 @@ static int csv_create_file(const char *filename, const data_set_t *ds) {
   return 0;
 } /* int csv_create_file */
 
+/* csv_check_file creates "filename", including the header line, if it does not
+ * exist yet. */
+static int csv_check_file(const char *filename, const data_set_t *ds) {
+  struct stat statbuf;
+
+  if (stat(filename, &statbuf) == -1) {
+    if (errno == ENOENT) {
+      if (csv_create_file(filename, ds))
+        return -1;
+    } else {
+      ERROR("stat(%s) failed: %s", filename, STRERRNO);
+      return -1;
+    }
+  } else if (!S_ISREG(statbuf.st_mode)) {
+    ERROR("stat(%s): Not a regular file!", filename);
+    return -1;
+  }
+
+  return 0;
+} /* int csv_check_file */
+
+/* Open files, most recently written first. Only used if "max_open_files" is
+ * greater than zero. Lines are collected in a per-file buffer which is written
+ * when it is full, when its oldest line is older than "buffer_timeout", when
+ * the plugin is flushed and when the file is closed. The files are opened and
+ * written by the file I/O service, so that the write threads don't wait for
+ * the disk. */
+struct csv_file_s {
+  char *filename;
+  file_io_file_t *fh;
+
+  char *buffer;
+  size_t buffer_fill;
+  cdtime_t buffer_time; /* time the oldest line in the buffer was added */
+  cdtime_t last_write;
+
+  struct csv_file_s *prev;
+  struct csv_file_s *next;
+};
+typedef struct csv_file_s csv_file_t;
+
+static c_avl_tree_t *files;
+static csv_file_t *files_head;
+static csv_file_t *files_tail;
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static file_io_t *io;
+static c_complain_t io_complaint = C_COMPLAIN_INIT_STATIC;
+
+static void csv_io_error(char const *path, char const *op, int status,
+                         __attribute__((unused)) void *arg) {
+  ERROR("csv plugin: %s (%s) failed: %s", op, path, STRERROR(status));
+} /* void csv_io_error */
+
+/* csv_file_append hands "len" bytes to the file I/O service. Lines that can't
+ * be written are dropped, like a failed fprintf() drops the line in the
+ * uncached code path. */
+static int csv_file_append(csv_file_t *f, void const *buf, size_t len) {
+  int status = file_io_append(f->fh, buf, len);
+  if (status == ENOBUFS) {
+    c_complain(LOG_ERR, &io_complaint,
+               "csv plugin: Too much data is waiting to be written to disk, "
+               "dropping lines.");
+    return -1;
+  } else if (status != 0) {
+    ERROR("csv plugin: file_io_append (%s) failed: %s", f->filename,
+          STRERROR(status));
+    return -1;
+  }
+
+  c_release(LOG_INFO, &io_complaint,
+            "csv plugin: Writing to disk has caught up.");
+  return 0;
+} /* int csv_file_append */
+
+/* csv_file_write_out submits the buffer of "f". */
+static int csv_file_write_out(csv_file_t *f) {
+  if (f->buffer_fill == 0)
+    return 0;
+
+  int status = csv_file_append(f, f->buffer, f->buffer_fill);
+  f->buffer_fill = 0;
+  return status;
+} /* int csv_file_write_out */
+
+static void csv_file_unlink(csv_file_t *f) {
+  if (f->prev != NULL)
+    f->prev->next = f->next;
+  else
+    files_head = f->next;
+
+  if (f->next != NULL)
+    f->next->prev = f->prev;
+  else
+    files_tail = f->prev;
+
+  f->prev = f->next = NULL;
+} /* void csv_file_unlink */
+
+static void csv_file_link_head(csv_file_t *f) {
+  f->prev = NULL;
+  f->next = files_head;
+  if (files_head != NULL)
+    files_head->prev = f;
+  files_head = f;
+  if (files_tail == NULL)
+    files_tail = f;
+} /* void csv_file_link_head */
+
+/* csv_file_close writes any buffered lines, closes the file and removes it
+ * from the cache. files_lock must be held. */
+static void csv_file_close(csv_file_t *f) {
+  csv_file_write_out(f);
+
+  c_avl_remove(files, f->filename, NULL, NULL);
+  csv_file_unlink(f);
+
+  file_io_close(f->fh);
+  sfree(f->buffer);
+  sfree(f->filename);
+  sfree(f);
+} /* void csv_file_close */
+
+/* csv_file_get returns the open file "filename", opening (and creating) it if
+ * necessary. The least recently written file is closed when more than
+ * "max_open_files" files are open. files_lock must be held. */
+static csv_file_t *csv_file_get(const char *filename, const data_set_t *ds) {
+  csv_file_t *f = NULL;
+
+  if (files == NULL) {
+    files = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (files == NULL) {
+      ERROR("csv plugin: c_avl_create failed.");
+      return NULL;
+    }
+  }
+
+  if (io == NULL) {
+    io = file_io_create(FILE_IO_MAX_PENDING, use_uring, csv_io_error, NULL);
+    if (io == NULL) {
+      ERROR("csv plugin: file_io_create failed: %s", STRERRNO);
+      return NULL;
+    }
+    INFO("csv plugin: Writing files using the %s backend.",
+         file_io_backend(io));
+  }
+
+  if (c_avl_get(files, filename, (void *)&f) == 0) {
+    csv_file_unlink(f);
+    csv_file_link_head(f);
+    return f;
+  }
+
+  f = calloc(1, sizeof(*f));
+  if (f == NULL) {
+    ERROR("csv plugin: calloc failed.");
+    return NULL;
+  }
+  f->filename = strdup(filename);
+  f->buffer = malloc(buffer_size);
+  if ((f->filename == NULL) || (f->buffer == NULL)) {
+    ERROR("csv plugin: malloc failed.");
+    sfree(f->filename);
+    sfree(f->buffer);
+    sfree(f);
+    return NULL;
+  }
+
+  /* The header line is written if the file is created. */
+  char header[4096] = "epoch";
+  size_t header_len = strlen(header);
+  for (size_t i = 0; (i < ds->ds_num) && (header_len < sizeof(header)); i++)
+    header_len += snprintf(header + header_len, sizeof(header) - header_len,
+                           ",%s", ds->ds[i].name);
+  if (header_len < sizeof(header) - 1)
+    strcpy(header + header_len, "\n");
+
+  f->fh = file_io_open(io, filename, header);
+  if (f->fh == NULL) {
+    ERROR("csv plugin: file_io_open (%s) failed.", filename);
+    sfree(f->filename);
+    sfree(f->buffer);
+    sfree(f);
+    return NULL;
+  }
+
+  if (c_avl_insert(files, f->filename, f) != 0) {
+    ERROR("csv plugin: c_avl_insert (%s) failed.", filename);
+    file_io_close(f->fh);
+    sfree(f->filename);
+    sfree(f->buffer);
+    sfree(f);
+    return NULL;
+  }
+  csv_file_link_head(f);
+
+  while ((size_t)c_avl_size(files) > (size_t)max_open_files)
+    csv_file_close(files_tail);
+
+  return f;
+} /* csv_file_t *csv_file_get */
+
+static int csv_write_cached(const char *filename, const data_set_t *ds,
+                            const char *line) {
+  cdtime_t now = cdtime();
+  size_t line_len = strlen(line);
+  int status = 0;
+
+  pthread_mutex_lock(&files_lock);
+
+  csv_file_t *f = csv_file_get(filename, ds);
+  if (f == NULL) {
+    pthread_mutex_unlock(&files_lock);
+    return -1;
+  }
+
+  if ((f->buffer_fill + line_len + 1) > buffer_size)
+    status = csv_file_write_out(f);
+
+  if ((line_len + 1) > buffer_size) {
+    /* Lines longer than the buffer are submitted directly. */
+    if ((csv_file_append(f, line, line_len) != 0) ||
+        (csv_file_append(f, "\n", 1) != 0))
+      status = -1;
+  } else {
+    if (f->buffer_fill == 0)
+      f->buffer_time = now;
+    memcpy(f->buffer + f->buffer_fill, line, line_len);
+    f->buffer[f->buffer_fill + line_len] = '\n';
+    f->buffer_fill += line_len + 1;
+
+    if ((now - f->buffer_time) >= buffer_timeout)
+      status = csv_file_write_out(f);
+  }
+  f->last_write = now;
+
+  pthread_mutex_unlock(&files_lock);
+  return status;
+} /* int csv_write_cached */
+
+/* csv_flush writes all buffers with lines older than "timeout" and closes files
+ * that have not been written to for "timeout", e.g. files of the previous day.
+ * A timeout of zero writes all buffers. */
+static int csv_flush(cdtime_t timeout,
+                     __attribute__((unused)) const char *identifier,
+                     __attribute__((unused)) user_data_t *user_data) {
+  cdtime_t now = cdtime();
+
+  pthread_mutex_lock(&files_lock);
+
+  csv_file_t *next = files_head;
+  while (next != NULL) {
+    csv_file_t *f = next;
+    next = f->next;
+
+    if ((timeout == 0) || ((now - f->buffer_time) >= timeout))
+      csv_file_write_out(f);
+
+    if ((timeout != 0) && (f->buffer_fill == 0) &&
+        ((now - f->last_write) >= timeout))
+      csv_file_close(f);
+  }
+
+  pthread_mutex_unlock(&files_lock);
+
+  /* Flushing everything, e.g. with the FLUSH command, returns once the lines
+   * are on disk. */
+  if ((timeout == 0) && (io != NULL))
+    file_io_wait(io);
+
+  return 0;
+} /* int csv_flush */
+
+static int csv_shutdown(void) {
+  pthread_mutex_lock(&files_lock);
+
+  while (files_head != NULL)
+    csv_file_close(files_head);
+  if (files != NULL) {
+    c_avl_destroy(files);
+    files = NULL;
+  }
+  file_io_destroy(io);
+  io = NULL;
+
+  pthread_mutex_unlock(&files_lock);
+  return 0;
+} /* int csv_shutdown */
+
 static int csv_config(const char *key, const char *value) {
   if (strcasecmp("DataDir", key) == 0) {
     if (datadir != NULL) {
@@ -205,6 +503,29 @@ static int csv_config(const char *key, const char *value) {
       store_rates = 1;
     else
       store_rates = 0;
+  } else if (strcasecmp("MaxOpenFiles", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("csv plugin: \"MaxOpenFiles\" must not be negative.");
+      return 1;
+    }
+    max_open_files = tmp;
+  } else if (strcasecmp("BufferSize", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 1) {
+      ERROR("csv plugin: \"BufferSize\" must be greater than zero.");
+      return 1;
+    }
+    buffer_size = (size_t)tmp;
+  } else if (strcasecmp("BufferTimeout", key) == 0) {
+    double tmp = atof(value);
+    if (tmp < 0.0) {
+      ERROR("csv plugin: \"BufferTimeout\" must not be negative.");
+      return 1;
+    }
+    buffer_timeout = DOUBLE_TO_CDTIME_T(tmp);
+  } else if (strcasecmp("IOUring", key) == 0) {
+    use_uring = IS_TRUE(value);
   } else {
     return -1;
   }
@@ -213,7 +534,6 @@ static int csv_config(const char *key, const char *value) {
 
 static int csv_write(const data_set_t *ds, const value_list_t *vl,
                      user_data_t __attribute__((unused)) * user_data) {
-  struct stat statbuf;
   char filename[512];
   char values[4096];
   FILE *csv;
@@ -251,18 +571,11 @@ static int csv_write(const data_set_t *ds, const value_list_t *vl,
     return 0;
   }
 
-  if (stat(filename, &statbuf) == -1) {
-    if (errno == ENOENT) {
-      if (csv_create_file(filename, ds))
-        return -1;
-    } else {
-      ERROR("stat(%s) failed: %s", filename, STRERRNO);
-      return -1;
-    }
-  } else if (!S_ISREG(statbuf.st_mode)) {
-    ERROR("stat(%s): Not a regular file!", filename);
+  if (max_open_files > 0)
+    return csv_write_cached(filename, ds, values);
+
+  if (csv_check_file(filename, ds) != 0)
     return -1;
-  }
 
   csv = fopen(filename, "a");
   if (csv == NULL) {
@@ -294,4 +607,6 @@ static int csv_write(const data_set_t *ds, const value_list_t *vl,
 void module_register(void) {
   plugin_register_config("csv", csv_config, config_keys, config_keys_num);
   plugin_register_write("csv", csv_write, /* user_data = */ NULL);
+  plugin_register_flush("csv", csv_flush, /* user_data = */ NULL);
+  plugin_register_shutdown("csv", csv_shutdown);
 } /* void module_register */
@@ -25,6 +25,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_fetch/curl_fetch.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils/match/match.h"
 #include "utils_time.h"
@@ -80,6 +81,14 @@ struct web_page_s /* {{{ */
   web_match_t *matches;
 }; /* }}} */
 
+/*
+ * Global variables
+ */
+/* If greater than zero, all pages are fetched concurrently by one fetch
+ * engine, which opens at most this many connections. */
+static int max_connections;
+static curl_fetch_t *fetch;
+
 /*
  * Private functions
  */
@@ -138,6 +147,11 @@ static void cc_web_page_free(void *arg) /* {{{ */
   if (wp == NULL)
     return;
 
+  /* The engine's thread may be using any page, so it is stopped before the
+   * first page is freed. */
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+
   if (wp->curl != NULL)
     curl_easy_cleanup(wp->curl);
   wp->curl = NULL;
@@ -339,6 +353,7 @@ static int cc_page_init_curl(web_page_t *wp) /* {{{ */
   }
 
   curl_easy_setopt(wp->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(wp->curl, CURLOPT_URL, wp->url);
   curl_easy_setopt(wp->curl, CURLOPT_WRITEFUNCTION, cc_curl_callback);
   curl_easy_setopt(wp->curl, CURLOPT_WRITEDATA, wp);
   curl_easy_setopt(wp->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -536,6 +551,14 @@ static int cc_config(oconfig_item_t *ci) /* {{{ */
         success++;
       else
         errors++;
+    } else if (strcasecmp("MaxConnections", child->key) == 0) {
+      status = cf_util_get_int(child, &max_connections);
+      if ((status == 0) && (max_connections < 0)) {
+        WARNING("curl plugin: `MaxConnections' must not be negative.");
+        status = -1;
+      }
+      if (status != 0)
+        errors++;
     } else {
       WARNING("curl plugin: Option `%s' not allowed here.", child->key);
       errors++;
@@ -553,9 +576,23 @@ static int cc_config(oconfig_item_t *ci) /* {{{ */
 static int cc_init(void) /* {{{ */
 {
   curl_global_init(CURL_GLOBAL_SSL);
+
+  if ((max_connections > 0) && (fetch == NULL)) {
+    fetch = curl_fetch_create("curl", max_connections);
+    if (fetch == NULL)
+      return -1;
+  }
+
   return 0;
 } /* }}} int cc_init */
 
+static int cc_shutdown(void) /* {{{ */
+{
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+  return 0;
+} /* }}} int cc_shutdown */
+
 static void cc_submit(const web_page_t *wp, const web_match_t *wm, /* {{{ */
                       value_t value) {
   value_list_t vl = VALUE_LIST_INIT;
@@ -600,27 +637,11 @@ static void cc_submit_response_time(const web_page_t *wp, /* {{{ */
   plugin_dispatch_values(&vl);
 } /* }}} void cc_submit_response_time */
 
-static int cc_read_page(user_data_t *ud) /* {{{ */
-{
-
-  if ((ud == NULL) || (ud->data == NULL)) {
-    ERROR("curl plugin: cc_read_page: Invalid user data.");
-    return -1;
-  }
-
-  web_page_t *wp = (web_page_t *)ud->data;
-
-  int status;
-  cdtime_t start = 0;
-
-  if (wp->response_time)
-    start = cdtime();
-
-  wp->buffer_fill = 0;
-
-  curl_easy_setopt(wp->curl, CURLOPT_URL, wp->url);
-
-  status = curl_easy_perform(wp->curl);
+/* cc_page_process handles a completed transfer of "wp" which took
+ * "response_time". It is called by the read callback or, if the fetch engine
+ * is used, by the engine's thread. */
+static int cc_page_process(web_page_t *wp, CURLcode status, /* {{{ */
+                           cdtime_t response_time) {
   if (status != CURLE_OK) {
     ERROR("curl plugin: curl_easy_perform failed with status %i: %s", status,
           wp->curl_errbuf);
@@ -628,7 +649,7 @@ static int cc_read_page(user_data_t *ud) /* {{{ */
   }
 
   if (wp->response_time)
-    cc_submit_response_time(wp, CDTIME_T_TO_DOUBLE(cdtime() - start));
+    cc_submit_response_time(wp, CDTIME_T_TO_DOUBLE(response_time));
   if (wp->stats != NULL)
     curl_stats_dispatch(wp->stats, wp->curl, NULL, "curl", wp->instance);
 
@@ -647,8 +668,8 @@ static int cc_read_page(user_data_t *ud) /* {{{ */
   for (web_match_t *wm = wp->matches; wm != NULL; wm = wm->next) {
     cu_match_value_t *mv;
 
-    status = match_apply(wm->match, wp->buffer);
-    if (status != 0) {
+    int match_status = match_apply(wm->match, wp->buffer);
+    if (match_status != 0) {
       WARNING("curl plugin: match_apply failed.");
       continue;
     }
@@ -664,9 +685,60 @@ static int cc_read_page(user_data_t *ud) /* {{{ */
   } /* for (wm = wp->matches; wm != NULL; wm = wm->next) */
 
   return 0;
+} /* }}} int cc_page_process */
+
+static void cc_fetch_done(CURL *curl, CURLcode status, /* {{{ */
+                          void *user_data) {
+  web_page_t *wp = user_data;
+
+  /* Transfers may wait for a free connection, so the time is taken from
+   * libcurl rather than from when the page has been submitted. */
+  double total_time = 0.0;
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+
+  cc_page_process(wp, status, DOUBLE_TO_CDTIME_T(total_time));
+  wp->buffer_fill = 0;
+} /* }}} void cc_fetch_done */
+
+static int cc_read_page(user_data_t *ud) /* {{{ */
+{
+
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("curl plugin: cc_read_page: Invalid user data.");
+    return -1;
+  }
+
+  web_page_t *wp = (web_page_t *)ud->data;
+
+  if (fetch != NULL) {
+    /* Until the transfer is done, the page belongs to the engine's thread,
+     * which also resets the buffer. */
+    int status =
+        curl_fetch_submit(fetch, wp->curl, cc_curl_callback, cc_fetch_done, wp);
+    if (status == EBUSY) {
+      WARNING("curl plugin: The previous transfer of page \"%s\" has not "
+              "completed yet.",
+              wp->instance);
+      return -1;
+    } else if (status != 0) {
+      ERROR("curl plugin: curl_fetch_submit failed: %s", STRERROR(status));
+      return -1;
+    }
+    return 0;
+  }
+
+  cdtime_t start = cdtime();
+
+  wp->buffer_fill = 0;
+
+  curl_easy_setopt(wp->curl, CURLOPT_URL, wp->url);
+
+  CURLcode status = curl_easy_perform(wp->curl);
+  return cc_page_process(wp, status, cdtime() - start);
 } /* }}} int cc_read_page */
 
 void module_register(void) {
   plugin_register_complex_config("curl", cc_config);
   plugin_register_init("curl", cc_init);
+  plugin_register_shutdown("curl", cc_shutdown);
 } /* void module_register */
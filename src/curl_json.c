@@ -24,8 +24,9 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
+#include "utils/curl_fetch/curl_fetch.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils_complain.h"
 
@@ -57,15 +58,34 @@ struct cj_key_s /* {{{ */
 };
 /* }}} */
 
-/* cj_tree_entry_t is a union of either a metric configuration ("key") or a tree
- * mapping array indexes / map keys to a descendant cj_tree_entry_t*. */
+struct cj_tree_entry_s;
+typedef struct cj_tree_entry_s cj_tree_entry_t;
+
+/* cj_tree_child_t is one element of the compiled form of a tree. */
 typedef struct {
+  uint64_t hash;
+  char const *name;
+  size_t name_len;
+  cj_tree_entry_t *entry;
+} cj_tree_child_t;
+
+/* cj_tree_entry_t is a union of either a metric configuration ("key") or a tree
+ * mapping array indexes / map keys to a descendant cj_tree_entry_t*.
+ *
+ * The tree owns the configuration. For the lookups done while parsing, each
+ * tree is compiled by cj_tree_compile into an array of its children sorted by
+ * the hash of their name, and the wildcard child, if any. */
+struct cj_tree_entry_s {
   enum { KEY, TREE } type;
   union {
-    c_avl_tree_t *tree;
+    c_btree_t *tree;
     cj_key_t *key;
   };
-} cj_tree_entry_t;
+
+  cj_tree_child_t *children;
+  size_t children_num;
+  cj_tree_entry_t *any;
+};
 
 /* cj_state_t is a stack providing the configuration relevant for the context
  * that is currently being parsed. If entry->type == KEY, the parser should
@@ -104,12 +124,21 @@ struct cj_s /* {{{ */
   char curl_errbuf[CURL_ERROR_SIZE];
 
   yajl_handle yajl;
-  c_avl_tree_t *tree;
+  c_btree_t *tree;
+  cj_tree_entry_t root;
   int depth;
   cj_state_t state[YAJL_MAX_DEPTH];
+  /* Number of maps and arrays the parser is in that no key can match. Their
+   * contents are skipped without updating the state. */
+  int skip;
 };
 typedef struct cj_s cj_t; /* }}} */
 
+/* If greater than zero, all URLs are fetched concurrently by one fetch
+ * engine, which opens at most this many connections. */
+static int max_connections;
+static curl_fetch_t *fetch;
+
 #if HAVE_YAJL_V2
 typedef size_t yajl_len_t;
 #else
@@ -183,30 +212,61 @@ static int cj_get_type(cj_key_t *key) {
   return ds->ds[0].type;
 }
 
+static uint64_t cj_hash(char const *name, size_t name_len) /* {{{ */
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < name_len; i++) {
+    hash ^= (uint8_t)name[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* }}} uint64_t cj_hash */
+
+/* cj_tree_lookup returns the child of the compiled tree "e" called "name", the
+ * wildcard child if there is no such child, or NULL. */
+static cj_tree_entry_t *cj_tree_lookup(cj_tree_entry_t const *e, /* {{{ */
+                                       char const *name, size_t name_len) {
+  uint64_t hash = cj_hash(name, name_len);
+
+  size_t lo = 0;
+  size_t hi = e->children_num;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (e->children[mid].hash < hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (size_t i = lo; (i < e->children_num) && (e->children[i].hash == hash);
+       i++) {
+    cj_tree_child_t const *c = e->children + i;
+    if ((c->name_len == name_len) && (memcmp(c->name, name, name_len) == 0))
+      return c->entry;
+  }
+
+  return e->any;
+} /* }}} cj_tree_entry_t *cj_tree_lookup */
+
 /* cj_load_key loads the configuration for "key" from the parent context and
  * sets either .key or .tree in the current context. */
-static int cj_load_key(cj_t *db, char const *key) {
+static int cj_load_key(cj_t *db, char const *key, size_t key_len) {
   if (db == NULL || key == NULL || db->depth <= 0)
     return EINVAL;
 
-  sstrncpy(db->state[db->depth].name, key, sizeof(db->state[db->depth].name));
+  cj_state_t *state = db->state + db->depth;
+  size_t name_len = COUCH_MIN(key_len, sizeof(state->name) - 1);
+  memcpy(state->name, key, name_len);
+  state->name[name_len] = 0;
 
-  if (db->state[db->depth - 1].entry == NULL ||
-      db->state[db->depth - 1].entry->type != TREE) {
+  cj_tree_entry_t const *parent = db->state[db->depth - 1].entry;
+  if (parent == NULL || parent->type != TREE) {
     return 0;
   }
 
-  c_avl_tree_t *tree = db->state[db->depth - 1].entry->tree;
-  cj_tree_entry_t *e = NULL;
-
-  if (c_avl_get(tree, key, (void *)&e) == 0) {
-    db->state[db->depth].entry = e;
-  } else if (c_avl_get(tree, CJ_ANY, (void *)&e) == 0) {
-    db->state[db->depth].entry = e;
-  } else {
-    db->state[db->depth].entry = NULL;
-  }
-
+  state->entry = cj_tree_lookup(parent, key, key_len);
   return 0;
 }
 
@@ -217,8 +277,8 @@ static void cj_advance_array(cj_t *db) {
   db->state[db->depth].index++;
 
   char name[DATA_MAX_NAME_LEN];
-  snprintf(name, sizeof(name), "%d", db->state[db->depth].index);
-  cj_load_key(db, name);
+  int len = snprintf(name, sizeof(name), "%d", db->state[db->depth].index);
+  cj_load_key(db, name, (size_t)len);
 }
 
 /* yajl callbacks */
@@ -226,6 +286,9 @@ static void cj_advance_array(cj_t *db) {
 #define CJ_CB_CONTINUE 1
 
 static int cj_cb_null(void *ctx) {
+  if (((cj_t *)ctx)->skip > 0)
+    return CJ_CB_CONTINUE;
+
   cj_advance_array(ctx);
   return CJ_CB_CONTINUE;
 }
@@ -233,6 +296,9 @@ static int cj_cb_null(void *ctx) {
 static int cj_cb_number(void *ctx, const char *number, yajl_len_t number_len) {
   cj_t *db = (cj_t *)ctx;
 
+  if (db->skip > 0)
+    return CJ_CB_CONTINUE;
+
   /* Create a null-terminated version of the string. */
   char buffer[number_len + 1];
   memcpy(buffer, number, number_len);
@@ -269,12 +335,10 @@ static int cj_cb_number(void *ctx, const char *number, yajl_len_t number_len) {
  * NULL. */
 static int cj_cb_map_key(void *ctx, unsigned char const *in_name,
                          yajl_len_t in_name_len) {
-  char name[in_name_len + 1];
-
-  memmove(name, in_name, in_name_len);
-  name[sizeof(name) - 1] = '\0';
+  if (((cj_t *)ctx)->skip > 0)
+    return CJ_CB_CONTINUE;
 
-  if (cj_load_key(ctx, name) != 0)
+  if (cj_load_key(ctx, (char const *)in_name, in_name_len) != 0)
     return CJ_CB_ABORT;
 
   return CJ_CB_CONTINUE;
@@ -294,15 +358,39 @@ static int cj_cb_boolean(void *ctx, int boolVal) {
 
 static int cj_cb_end(void *ctx) {
   cj_t *db = (cj_t *)ctx;
+
+  if (db->skip > 0) {
+    db->skip--;
+    /* The skipped map or array was an element of the current context. */
+    if (db->skip == 0)
+      cj_advance_array(db);
+    return CJ_CB_CONTINUE;
+  }
+
   memset(&db->state[db->depth], 0, sizeof(db->state[db->depth]));
   db->depth--;
   cj_advance_array(ctx);
   return CJ_CB_CONTINUE;
 }
 
+/* cj_skip_container checks whether a map or array starting in the current
+ * context can contain a configured key. If not, it is skipped as a whole. */
+static bool cj_skip_container(cj_t *db) {
+  cj_tree_entry_t const *e = db->state[db->depth].entry;
+
+  if ((db->skip == 0) && (e != NULL) && (e->type == TREE))
+    return false;
+
+  db->skip++;
+  return true;
+}
+
 static int cj_cb_start_map(void *ctx) {
   cj_t *db = (cj_t *)ctx;
 
+  if (cj_skip_container(db))
+    return CJ_CB_CONTINUE;
+
   if ((db->depth + 1) >= YAJL_MAX_DEPTH) {
     ERROR("curl_json plugin: %s depth exceeds max, aborting.",
           db->url ? db->url : db->sock);
@@ -317,6 +405,9 @@ static int cj_cb_end_map(void *ctx) { return cj_cb_end(ctx); }
 static int cj_cb_start_array(void *ctx) {
   cj_t *db = (cj_t *)ctx;
 
+  if (cj_skip_container(db))
+    return CJ_CB_CONTINUE;
+
   if ((db->depth + 1) >= YAJL_MAX_DEPTH) {
     ERROR("curl_json plugin: %s depth exceeds max, aborting.",
           db->url ? db->url : db->sock);
@@ -326,14 +417,15 @@ static int cj_cb_start_array(void *ctx) {
   db->state[db->depth].in_array = true;
   db->state[db->depth].index = 0;
 
-  cj_load_key(db, "0");
+  cj_load_key(db, "0", 1);
 
   return CJ_CB_CONTINUE;
 }
 
 static int cj_cb_end_array(void *ctx) {
   cj_t *db = (cj_t *)ctx;
-  db->state[db->depth].in_array = false;
+  if (db->skip == 0)
+    db->state[db->depth].in_array = false;
   return cj_cb_end(ctx);
 }
 
@@ -359,22 +451,23 @@ static void cj_key_free(cj_key_t *key) /* {{{ */
   sfree(key);
 } /* }}} void cj_key_free */
 
-static void cj_tree_free(c_avl_tree_t *tree) /* {{{ */
+static void cj_tree_free(c_btree_t *tree) /* {{{ */
 {
   char *name;
   cj_tree_entry_t *e;
 
-  while (c_avl_pick(tree, (void *)&name, (void *)&e) == 0) {
+  while (c_btree_pick(tree, (void *)&name, (void *)&e) == 0) {
     sfree(name);
 
     if (e->type == KEY)
       cj_key_free(e->key);
     else
       cj_tree_free(e->tree);
+    sfree(e->children);
     sfree(e);
   }
 
-  c_avl_destroy(tree);
+  c_btree_destroy(tree);
 } /* }}} void cj_tree_free */
 
 static void cj_free(void *arg) /* {{{ */
@@ -388,6 +481,11 @@ static void cj_free(void *arg) /* {{{ */
   if (db == NULL)
     return;
 
+  /* The engine's thread may be using any URL, so it is stopped before the
+   * first one is freed. */
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+
   if (db->curl != NULL)
     curl_easy_cleanup(db->curl);
   db->curl = NULL;
@@ -395,6 +493,7 @@ static void cj_free(void *arg) /* {{{ */
   if (db->tree != NULL)
     cj_tree_free(db->tree);
   db->tree = NULL;
+  sfree(db->root.children);
 
   sfree(db->instance);
   sfree(db->plugin_name);
@@ -416,8 +515,8 @@ static void cj_free(void *arg) /* {{{ */
 
 /* Configuration handling functions {{{ */
 
-static c_avl_tree_t *cj_avl_create(void) {
-  return c_avl_create((int (*)(const void *, const void *))strcmp);
+static c_btree_t *cj_tree_create(void) {
+  return c_btree_create((int (*)(const void *, const void *))strcmp);
 }
 
 static int cj_config_append_string(const char *name,
@@ -447,9 +546,9 @@ static int cj_config_append_string(const char *name,
  */
 static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
   if (db->tree == NULL)
-    db->tree = cj_avl_create();
+    db->tree = cj_tree_create();
 
-  c_avl_tree_t *tree = db->tree;
+  c_btree_t *tree = db->tree;
 
   char const *start = key->path;
   if (*start == '/')
@@ -467,14 +566,14 @@ static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
     sstrncpy(name, start, len + 1);
 
     cj_tree_entry_t *e;
-    if (c_avl_get(tree, name, (void *)&e) != 0) {
+    if (c_btree_get(tree, name, (void *)&e) != 0) {
       e = calloc(1, sizeof(*e));
       if (e == NULL)
         return ENOMEM;
       e->type = TREE;
-      e->tree = cj_avl_create();
+      e->tree = cj_tree_create();
 
-      c_avl_insert(tree, strdup(name), e);
+      c_btree_insert(tree, strdup(name), e);
     }
 
     if (e->type != TREE)
@@ -495,10 +594,85 @@ static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
   e->type = KEY;
   e->key = key;
 
-  c_avl_insert(tree, strdup(start), e);
+  c_btree_insert(tree, strdup(start), e);
   return 0;
 } /* }}} int cj_append_key */
 
+static int cj_tree_child_compare(void const *a, void const *b) /* {{{ */
+{
+  cj_tree_child_t const *ca = a;
+  cj_tree_child_t const *cb = b;
+
+  if (ca->hash != cb->hash)
+    return (ca->hash < cb->hash) ? -1 : 1;
+  return strcmp(ca->name, cb->name);
+} /* }}} int cj_tree_child_compare */
+
+/* cj_tree_compile (re-)builds the lookup arrays of "e" and its descendants. */
+static int cj_tree_compile(cj_tree_entry_t *e) /* {{{ */
+{
+  if (e->type != TREE)
+    return 0;
+
+  sfree(e->children);
+  e->children_num = 0;
+  e->any = NULL;
+
+  int size = c_btree_size(e->tree);
+  if (size <= 0)
+    return 0;
+
+  e->children = calloc(size, sizeof(*e->children));
+  if (e->children == NULL)
+    return ENOMEM;
+
+  c_btree_iterator_t *iter = c_btree_get_iterator(e->tree);
+  char *name;
+  cj_tree_entry_t *child;
+  while (c_btree_iterator_next(iter, (void *)&name, (void *)&child) == 0) {
+    int status = cj_tree_compile(child);
+    if (status != 0) {
+      c_btree_iterator_destroy(iter);
+      return status;
+    }
+
+    if (strcmp(CJ_ANY, name) == 0) {
+      e->any = child;
+      continue;
+    }
+
+    size_t name_len = strlen(name);
+    e->children[e->children_num] = (cj_tree_child_t){
+        .hash = cj_hash(name, name_len),
+        .name = name,
+        .name_len = name_len,
+        .entry = child,
+    };
+    e->children_num++;
+  }
+  c_btree_iterator_destroy(iter);
+
+  qsort(e->children, e->children_num, sizeof(*e->children),
+        cj_tree_child_compare);
+  return 0;
+} /* }}} int cj_tree_compile */
+
+/* cj_compile_keys compiles the configured keys of "db" for parsing. */
+static int cj_compile_keys(cj_t *db) /* {{{ */
+{
+  /* This is not a compound literal because EPEL6's GCC is not cool enough to
+   * handle anonymous unions within compound literals. */
+  sfree(db->root.children);
+  memset(&db->root, 0, sizeof(db->root));
+  db->root.type = TREE;
+  db->root.tree = db->tree;
+
+  int status = cj_tree_compile(&db->root);
+  if (status != 0)
+    ERROR("curl_json plugin: Compiling the keys failed: %s", STRERROR(status));
+  return status;
+} /* }}} int cj_compile_keys */
+
 static int cj_config_add_key(cj_t *db, /* {{{ */
                              oconfig_item_t *ci) {
   cj_key_t *key;
@@ -576,6 +750,7 @@ static int cj_init_curl(cj_t *db) /* {{{ */
   }
 
   curl_easy_setopt(db->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
   curl_easy_setopt(db->curl, CURLOPT_WRITEFUNCTION, cj_curl_callback);
   curl_easy_setopt(db->curl, CURLOPT_WRITEDATA, db);
   curl_easy_setopt(db->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -717,6 +892,8 @@ static int cj_config_add_url(oconfig_item_t *ci) /* {{{ */
               db->url ? "URL" : "Sock", db->url ? db->url : db->sock);
       status = -1;
     }
+    if (status == 0)
+      status = cj_compile_keys(db);
     if (status == 0 && db->url)
       status = cj_init_curl(db);
   }
@@ -766,6 +943,14 @@ static int cj_config(oconfig_item_t *ci) /* {{{ */
         success++;
       else
         errors++;
+    } else if (strcasecmp("MaxConnections", child->key) == 0) {
+      status = cf_util_get_int(child, &max_connections);
+      if ((status == 0) && (max_connections < 0)) {
+        WARNING("curl_json plugin: `MaxConnections' must not be negative.");
+        status = -1;
+      }
+      if (status != 0)
+        errors++;
     } else {
       WARNING("curl_json plugin: Option `%s' not allowed here.", child->key);
       errors++;
@@ -848,15 +1033,13 @@ static int cj_sock_perform(cj_t *db) /* {{{ */
   return 0;
 } /* }}} int cj_sock_perform */
 
-static int cj_curl_perform(cj_t *db) /* {{{ */
+/* cj_curl_check checks the outcome "status" of a completed transfer and
+ * dispatches the transfer statistics. */
+static int cj_curl_check(cj_t *db, CURLcode status) /* {{{ */
 {
-  int status;
   long rc;
   char *url;
 
-  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
-
-  status = curl_easy_perform(db->curl);
   if (status != CURLE_OK) {
     ERROR("curl_json plugin: curl_easy_perform failed with status %i: %s (%s)",
           status, db->curl_errbuf, db->url);
@@ -877,12 +1060,23 @@ static int cj_curl_perform(cj_t *db) /* {{{ */
     return -1;
   }
   return 0;
+} /* }}} int cj_curl_check */
+
+static int cj_curl_perform(cj_t *db) /* {{{ */
+{
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
+
+  return cj_curl_check(db, curl_easy_perform(db->curl));
 } /* }}} int cj_curl_perform */
 
-static int cj_perform(cj_t *db) /* {{{ */
+/* cj_parse_begin allocates a parser and resets the parser state for a new
+ * document. */
+static int cj_parse_begin(cj_t *db) /* {{{ */
 {
-  int status;
-  yajl_handle yprev = db->yajl;
+  db->depth = 0;
+  db->skip = 0;
+  memset(&db->state, 0, sizeof(db->state));
+  db->state[0].entry = &db->root;
 
   db->yajl = yajl_alloc(&ycallbacks,
 #if HAVE_YAJL_V2
@@ -893,42 +1087,79 @@ static int cj_perform(cj_t *db) /* {{{ */
                         /* context = */ (void *)db);
   if (db->yajl == NULL) {
     ERROR("curl_json plugin: yajl_alloc failed.");
-    db->yajl = yprev;
+    db->state[0].entry = NULL;
     return -1;
   }
 
-  if (db->url)
-    status = cj_curl_perform(db);
-  else
-    status = cj_sock_perform(db);
-  if (status < 0) {
-    yajl_free(db->yajl);
-    db->yajl = yprev;
-    return -1;
-  }
+  return 0;
+} /* }}} int cj_parse_begin */
 
+/* cj_parse_end completes the document if "status" is zero and frees the
+ * parser. */
+static int cj_parse_end(cj_t *db, int status) /* {{{ */
+{
+  if (status == 0) {
 #if HAVE_YAJL_V2
-  status = yajl_complete_parse(db->yajl);
+    yajl_status ystatus = yajl_complete_parse(db->yajl);
 #else
-  status = yajl_parse_complete(db->yajl);
+    yajl_status ystatus = yajl_parse_complete(db->yajl);
 #endif
-  if (status != yajl_status_ok) {
-    unsigned char *errmsg;
-
-    errmsg = yajl_get_error(db->yajl, /* verbose = */ 0,
-                            /* jsonText = */ NULL, /* jsonTextLen = */ 0);
-    ERROR("curl_json plugin: yajl_parse_complete failed: %s", (char *)errmsg);
-    yajl_free_error(db->yajl, errmsg);
-    yajl_free(db->yajl);
-    db->yajl = yprev;
-    return -1;
+    if (ystatus != yajl_status_ok) {
+      unsigned char *errmsg;
+
+      errmsg = yajl_get_error(db->yajl, /* verbose = */ 0,
+                              /* jsonText = */ NULL, /* jsonTextLen = */ 0);
+      ERROR("curl_json plugin: yajl_parse_complete failed: %s",
+            (char *)errmsg);
+      yajl_free_error(db->yajl, errmsg);
+      status = -1;
+    }
   }
 
   yajl_free(db->yajl);
-  db->yajl = yprev;
-  return 0;
+  db->yajl = NULL;
+  db->state[0].entry = NULL;
+  return status;
+} /* }}} int cj_parse_end */
+
+static int cj_perform(cj_t *db) /* {{{ */
+{
+  int status = cj_parse_begin(db);
+  if (status != 0)
+    return status;
+
+  if (db->url)
+    status = cj_curl_perform(db);
+  else
+    status = cj_sock_perform(db);
+
+  return cj_parse_end(db, (status < 0) ? -1 : 0);
 } /* }}} int cj_perform */
 
+/* With the fetch engine, the parser is allocated by the engine's thread when
+ * the first chunk arrives, so that the read callback never touches a URL
+ * whose transfer is still in progress. */
+static size_t cj_fetch_write(void *buf, size_t size, /* {{{ */
+                             size_t nmemb, void *user_data) {
+  cj_t *db = user_data;
+
+  if ((db->yajl == NULL) && (cj_parse_begin(db) != 0))
+    return 0;
+
+  return cj_curl_callback(buf, size, nmemb, db);
+} /* }}} size_t cj_fetch_write */
+
+static void cj_fetch_done(CURL *curl, CURLcode status, /* {{{ */
+                          void *user_data) {
+  cj_t *db = user_data;
+
+  /* An empty response is handed to the parser, which reports it. */
+  if ((db->yajl == NULL) && (cj_parse_begin(db) != 0))
+    return;
+
+  cj_parse_end(db, cj_curl_check(db, status));
+} /* }}} void cj_fetch_done */
+
 static int cj_read(user_data_t *ud) /* {{{ */
 {
   cj_t *db;
@@ -940,21 +1171,22 @@ static int cj_read(user_data_t *ud) /* {{{ */
 
   db = (cj_t *)ud->data;
 
-  db->depth = 0;
-  memset(&db->state, 0, sizeof(db->state));
-
-  /* This is not a compound literal because EPEL6's GCC is not cool enough to
-   * handle anonymous unions within compound literals. */
-  cj_tree_entry_t root = {0};
-  root.type = TREE;
-  root.tree = db->tree;
-  db->state[0].entry = &root;
+  if ((fetch == NULL) || (db->url == NULL))
+    return cj_perform(db);
 
-  int status = cj_perform(db);
-
-  db->state[0].entry = NULL;
+  int status =
+      curl_fetch_submit(fetch, db->curl, cj_fetch_write, cj_fetch_done, db);
+  if (status == EBUSY) {
+    WARNING("curl_json plugin: The previous transfer of \"%s\" has not "
+            "completed yet.",
+            db->url);
+    return -1;
+  } else if (status != 0) {
+    ERROR("curl_json plugin: curl_fetch_submit failed: %s", STRERROR(status));
+    return -1;
+  }
 
-  return status;
+  return 0;
 } /* }}} int cj_read */
 
 static int cj_init(void) /* {{{ */
@@ -962,10 +1194,25 @@ static int cj_init(void) /* {{{ */
   /* Call this while collectd is still single-threaded to avoid
    * initialization issues in libgcrypt. */
   curl_global_init(CURL_GLOBAL_SSL);
+
+  if ((max_connections > 0) && (fetch == NULL)) {
+    fetch = curl_fetch_create("curl_json", max_connections);
+    if (fetch == NULL)
+      return -1;
+  }
+
   return 0;
 } /* }}} int cj_init */
 
+static int cj_shutdown(void) /* {{{ */
+{
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+  return 0;
+} /* }}} int cj_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("curl_json", cj_config);
   plugin_register_init("curl_json", cj_init);
+  plugin_register_shutdown("curl_json", cj_shutdown);
 } /* void module_register */
@@ -14,19 +14,19 @@
 
 static void test_submit(cj_t *db, cj_key_t *key, value_t *value) {
   /* hack: we repurpose db->curl to store received values. */
-  c_avl_tree_t *values = (void *)db->curl;
+  c_btree_t *values = (void *)db->curl;
 
   value_t *value_copy = calloc(1, sizeof(*value_copy));
   memmove(value_copy, value, sizeof(*value_copy));
 
-  assert(c_avl_insert(values, key->path, value_copy) == 0);
+  assert(c_btree_insert(values, key->path, value_copy) == 0);
 }
 
 static derive_t test_metric(cj_t *db, char const *path) {
-  c_avl_tree_t *values = (void *)db->curl;
+  c_btree_t *values = (void *)db->curl;
 
   value_t *ret = NULL;
-  if (c_avl_get(values, path, (void *)&ret) == 0) {
+  if (c_btree_get(values, path, (void *)&ret) == 0) {
     return ret->derive;
   }
 
@@ -44,18 +44,16 @@ static cj_t *test_setup(char *json, char *key_path) {
                         /* context = */ (void *)db);
 
   /* hack; see above. */
-  db->curl = (void *)cj_avl_create();
+  db->curl = (void *)cj_tree_create();
 
   cj_key_t *key = calloc(1, sizeof(*key));
   key->path = strdup(key_path);
   key->type = strdup("MAGIC");
 
   assert(cj_append_key(db, key) == 0);
+  assert(cj_compile_keys(db) == 0);
 
-  cj_tree_entry_t root = {0};
-  root.type = TREE;
-  root.tree = db->tree;
-  db->state[0].entry = &root;
+  db->state[0].entry = &db->root;
 
   cj_curl_callback(json, strlen(json), 1, db);
 #if HAVE_YAJL_V2
@@ -70,16 +68,16 @@ static cj_t *test_setup(char *json, char *key_path) {
 }
 
 static void test_teardown(cj_t *db) {
-  c_avl_tree_t *values = (void *)db->curl;
+  c_btree_t *values = (void *)db->curl;
   db->curl = NULL;
 
   void *key;
   void *value;
-  while (c_avl_pick(values, &key, &value) == 0) {
+  while (c_btree_pick(values, &key, &value) == 0) {
     /* key will be freed by cj_free. */
     free(value);
   }
-  c_avl_destroy(values);
+  c_btree_destroy(values);
 
   yajl_free(db->yajl);
   db->yajl = NULL;
@@ -126,6 +124,11 @@ DEF_TEST(parse) {
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/2", 12},
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/3", 13},
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/4", 14},
+      /* skipped subtrees */
+      {"{\"s\":{\"foo\":[1,{\"foo\":2}]},\"foo\":3}", "foo", 3},
+      {"[{\"a\":[0,[1]]},[2,3],4]", "2", 4},
+      {"{\"x\":{\"a\":{\"q\":[1,2]},\"y\":{\"z\":789}}}", "x/*/z", 789},
+      {"{\"a\":{\"b\":5},\"a\":{\"c\":6}}", "a/c", 6},
   };
 
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
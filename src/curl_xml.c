@@ -23,6 +23,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_fetch/curl_fetch.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils_llist.h"
 
@@ -42,6 +43,7 @@ struct cx_values_s /* {{{ */
 {
   char path[DATA_MAX_NAME_LEN];
   size_t path_len;
+  xmlXPathCompExprPtr path_comp;
 };
 typedef struct cx_values_s cx_values_t;
 /* }}} */
@@ -56,6 +58,11 @@ struct cx_xpath_s /* {{{ */
   char *instance;
   char *plugin_instance_from;
   int is_table;
+
+  /* Expressions above, compiled once when the configuration is read. */
+  xmlXPathCompExprPtr path_comp;
+  xmlXPathCompExprPtr instance_comp;
+  xmlXPathCompExprPtr plugin_instance_from_comp;
   unsigned long magic;
 };
 typedef struct cx_xpath_s cx_xpath_t;
@@ -104,6 +111,11 @@ typedef struct cx_s cx_t; /* }}} */
 /*
  * Private functions
  */
+/* If greater than zero, all URLs are fetched concurrently by one fetch
+ * engine, which opens at most this many connections. */
+static int max_connections;
+static curl_fetch_t *fetch;
+
 static size_t cx_curl_callback(void *buf, /* {{{ */
                                size_t size, size_t nmemb, void *user_data) {
   size_t len = size * nmemb;
@@ -140,6 +152,16 @@ static void cx_xpath_free(cx_xpath_t *xpath) /* {{{ */
   if (xpath == NULL)
     return;
 
+  if (xpath->path_comp != NULL)
+    xmlXPathFreeCompExpr(xpath->path_comp);
+  if (xpath->instance_comp != NULL)
+    xmlXPathFreeCompExpr(xpath->instance_comp);
+  if (xpath->plugin_instance_from_comp != NULL)
+    xmlXPathFreeCompExpr(xpath->plugin_instance_from_comp);
+  for (size_t i = 0; (xpath->values != NULL) && (i < xpath->values_len); i++)
+    if (xpath->values[i].path_comp != NULL)
+      xmlXPathFreeCompExpr(xpath->values[i].path_comp);
+
   sfree(xpath->path);
   sfree(xpath->type);
   sfree(xpath->instance_prefix);
@@ -177,6 +199,11 @@ static void cx_free(void *arg) /* {{{ */
   if (db == NULL)
     return;
 
+  /* The engine's thread may be using any URL, so it is stopped before the
+   * first one is freed. */
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+
   if (db->curl != NULL)
     curl_easy_cleanup(db->curl);
   db->curl = NULL;
@@ -250,10 +277,10 @@ static int cx_check_type(const data_set_t *ds, cx_xpath_t *xpath) /* {{{ */
 } /* }}} cx_check_type */
 
 static xmlXPathObjectPtr cx_evaluate_xpath(xmlXPathContextPtr xpath_ctx,
+                                           xmlXPathCompExprPtr comp,
                                            char *expr) /* {{{ */
 {
-  xmlXPathObjectPtr xpath_obj =
-      xmlXPathEvalExpression(BAD_CAST expr, xpath_ctx);
+  xmlXPathObjectPtr xpath_obj = xmlXPathCompiledEval(comp, xpath_ctx);
   if (xpath_obj == NULL) {
     WARNING("curl_xml plugin: "
             "Error unable to evaluate xpath expression \"%s\". Skipping...",
@@ -280,8 +307,9 @@ static int cx_if_not_text_node(xmlNodePtr node) /* {{{ */
  * Returned value should be freed with xmlFree().
  */
 static char *cx_get_text_node_value(xmlXPathContextPtr xpath_ctx, /* {{{ */
-                                    char *expr, const char *from_option) {
-  xmlXPathObjectPtr values_node_obj = cx_evaluate_xpath(xpath_ctx, expr);
+                                    xmlXPathCompExprPtr comp, char *expr,
+                                    const char *from_option) {
+  xmlXPathObjectPtr values_node_obj = cx_evaluate_xpath(xpath_ctx, comp, expr);
   if (values_node_obj == NULL)
     return NULL; /* Error already logged. */
 
@@ -329,8 +357,9 @@ static int cx_handle_single_value_xpath(xmlXPathContextPtr xpath_ctx, /* {{{ */
                                         cx_xpath_t *xpath, const data_set_t *ds,
                                         value_list_t *vl, int index) {
 
-  char *node_value = cx_get_text_node_value(
-      xpath_ctx, xpath->values[index].path, "ValuesFrom");
+  char *node_value =
+      cx_get_text_node_value(xpath_ctx, xpath->values[index].path_comp,
+                             xpath->values[index].path, "ValuesFrom");
 
   if (node_value == NULL)
     return -1;
@@ -389,8 +418,8 @@ static int cx_handle_instance_xpath(xmlXPathContextPtr xpath_ctx, /* {{{ */
 
   /* Handle type instance */
   if (xpath->instance != NULL) {
-    char *node_value =
-        cx_get_text_node_value(xpath_ctx, xpath->instance, "InstanceFrom");
+    char *node_value = cx_get_text_node_value(xpath_ctx, xpath->instance_comp,
+                                              xpath->instance, "InstanceFrom");
     if (node_value == NULL)
       return -1;
 
@@ -408,7 +437,8 @@ static int cx_handle_instance_xpath(xmlXPathContextPtr xpath_ctx, /* {{{ */
   /* Handle plugin instance */
   if (xpath->plugin_instance_from != NULL) {
     char *node_value = cx_get_text_node_value(
-        xpath_ctx, xpath->plugin_instance_from, "PluginInstanceFrom");
+        xpath_ctx, xpath->plugin_instance_from_comp, xpath->plugin_instance_from,
+        "PluginInstanceFrom");
 
     if (node_value == NULL)
       return -1;
@@ -427,7 +457,8 @@ static int cx_handle_xpath(const cx_t *db, /* {{{ */
   if (cx_check_type(ds, xpath) != 0)
     return -1;
 
-  xmlXPathObjectPtr base_node_obj = cx_evaluate_xpath(xpath_ctx, xpath->path);
+  xmlXPathObjectPtr base_node_obj =
+      cx_evaluate_xpath(xpath_ctx, xpath->path_comp, xpath->path);
   if (base_node_obj == NULL)
     return -1; /* error is logged already */
 
@@ -538,22 +569,14 @@ static int cx_parse_xml(cx_t *db, char *xml) /* {{{ */
   return status;
 } /* }}} cx_parse_xml */
 
-static int cx_read(user_data_t *ud) /* {{{ */
+/* cx_process handles a completed transfer of "db". The response is buffered
+ * and parsed once the transfer is done, because XPath expressions are
+ * evaluated on the complete document. */
+static int cx_process(cx_t *db, CURLcode status) /* {{{ */
 {
-  if ((ud == NULL) || (ud->data == NULL)) {
-    ERROR("curl_xml plugin: cx_read: Invalid user data.");
-    return -1;
-  }
-
   long rc;
   char *url;
-  cx_t *db = (cx_t *)ud->data;
-
-  db->buffer_fill = 0;
-
-  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
 
-  int status = curl_easy_perform(db->curl);
   if (status != CURLE_OK) {
     ERROR("curl_xml plugin: curl_easy_perform failed with status %i: %s (%s)",
           status, db->curl_errbuf, db->url);
@@ -574,7 +597,48 @@ static int cx_read(user_data_t *ud) /* {{{ */
     return -1;
   }
 
-  status = cx_parse_xml(db, db->buffer);
+  return cx_parse_xml(db, db->buffer);
+} /* }}} int cx_process */
+
+static void cx_fetch_done(CURL *curl, CURLcode status, /* {{{ */
+                          void *user_data) {
+  cx_t *db = user_data;
+
+  cx_process(db, status);
+  db->buffer_fill = 0;
+} /* }}} void cx_fetch_done */
+
+static int cx_read(user_data_t *ud) /* {{{ */
+{
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("curl_xml plugin: cx_read: Invalid user data.");
+    return -1;
+  }
+
+  cx_t *db = (cx_t *)ud->data;
+
+  if (fetch != NULL) {
+    /* Until the transfer is done, "db" belongs to the engine's thread, which
+     * also resets the buffer. */
+    int status =
+        curl_fetch_submit(fetch, db->curl, cx_curl_callback, cx_fetch_done, db);
+    if (status == EBUSY) {
+      WARNING("curl_xml plugin: The previous transfer of \"%s\" has not "
+              "completed yet.",
+              db->url);
+      return -1;
+    } else if (status != 0) {
+      ERROR("curl_xml plugin: curl_fetch_submit failed: %s", STRERROR(status));
+      return -1;
+    }
+    return 0;
+  }
+
+  db->buffer_fill = 0;
+
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
+
+  int status = cx_process(db, curl_easy_perform(db->curl));
   db->buffer_fill = 0;
 
   return status;
@@ -582,6 +646,22 @@ static int cx_read(user_data_t *ud) /* {{{ */
 
 /* Configuration handling functions {{{ */
 
+/* Compiles "expr" so that it doesn't have to be parsed again on every read.
+ * Namespace prefixes are resolved when the expression is evaluated. */
+static int cx_config_compile(const char *option, /* {{{ */
+                             const char *expr, xmlXPathCompExprPtr *ret_comp) {
+  xmlXPathCompExprPtr comp = xmlXPathCompile(BAD_CAST expr);
+  if (comp == NULL) {
+    ERROR("curl_xml plugin: Unable to compile the xpath expression \"%s\" "
+          "of the `%s' option.",
+          expr, option);
+    return -1;
+  }
+
+  *ret_comp = comp;
+  return 0;
+} /* }}} int cx_config_compile */
+
 static int cx_config_add_values(const char *name, cx_xpath_t *xpath, /* {{{ */
                                 oconfig_item_t *ci) {
   if (ci->values_num < 1) {
@@ -595,10 +675,13 @@ static int cx_config_add_values(const char *name, cx_xpath_t *xpath, /* {{{ */
       return -1;
     }
 
+  for (size_t i = 0; (xpath->values != NULL) && (i < xpath->values_len); i++)
+    if (xpath->values[i].path_comp != NULL)
+      xmlXPathFreeCompExpr(xpath->values[i].path_comp);
   sfree(xpath->values);
 
   xpath->values_len = 0;
-  xpath->values = malloc(sizeof(cx_values_t) * ci->values_num);
+  xpath->values = calloc(ci->values_num, sizeof(cx_values_t));
   if (xpath->values == NULL)
     return -1;
   xpath->values_len = (size_t)ci->values_num;
@@ -608,6 +691,9 @@ static int cx_config_add_values(const char *name, cx_xpath_t *xpath, /* {{{ */
     xpath->values[i].path_len = sizeof(ci->values[i].value.string);
     sstrncpy(xpath->values[i].path, ci->values[i].value.string,
              sizeof(xpath->values[i].path));
+    if (cx_config_compile(name, xpath->values[i].path,
+                          &xpath->values[i].path_comp) != 0)
+      return -1;
   }
 
   return 0;
@@ -675,6 +761,19 @@ static int cx_config_add_xpath(cx_t *db, oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  status = cx_config_compile("xpath", xpath->path, &xpath->path_comp);
+  if ((status == 0) && (xpath->instance != NULL))
+    status = cx_config_compile("InstanceFrom", xpath->instance,
+                               &xpath->instance_comp);
+  if ((status == 0) && (xpath->plugin_instance_from != NULL))
+    status = cx_config_compile("PluginInstanceFrom",
+                               xpath->plugin_instance_from,
+                               &xpath->plugin_instance_from_comp);
+  if (status != 0) {
+    cx_xpath_free(xpath);
+    return status;
+  }
+
   llentry_t *le = llentry_create(xpath->path, xpath);
   if (le == NULL) {
     ERROR("curl_xml plugin: llentry_create failed.");
@@ -730,6 +829,7 @@ static int cx_init_curl(cx_t *db) /* {{{ */
   }
 
   curl_easy_setopt(db->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
   curl_easy_setopt(db->curl, CURLOPT_WRITEFUNCTION, cx_curl_callback);
   curl_easy_setopt(db->curl, CURLOPT_WRITEDATA, db);
   curl_easy_setopt(db->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -918,6 +1018,14 @@ static int cx_config(oconfig_item_t *ci) /* {{{ */
         success++;
       else
         errors++;
+    } else if (strcasecmp("MaxConnections", child->key) == 0) {
+      int status = cf_util_get_int(child, &max_connections);
+      if ((status == 0) && (max_connections < 0)) {
+        WARNING("curl_xml plugin: `MaxConnections' must not be negative.");
+        status = -1;
+      }
+      if (status != 0)
+        errors++;
     } else {
       WARNING("curl_xml plugin: Option `%s' not allowed here.", child->key);
       errors++;
@@ -937,10 +1045,25 @@ static int cx_init(void) /* {{{ */
   /* Call this while collectd is still single-threaded to avoid
    * initialization issues in libgcrypt. */
   curl_global_init(CURL_GLOBAL_SSL);
+
+  if ((max_connections > 0) && (fetch == NULL)) {
+    fetch = curl_fetch_create("curl_xml", max_connections);
+    if (fetch == NULL)
+      return -1;
+  }
+
   return 0;
 } /* }}} int cx_init */
 
+static int cx_shutdown(void) /* {{{ */
+{
+  curl_fetch_destroy(fetch);
+  fetch = NULL;
+  return 0;
+} /* }}} int cx_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("curl_xml", cx_config);
   plugin_register_init("curl_xml", cx_init);
+  plugin_register_shutdown("curl_xml", cx_shutdown);
 } /* void module_register */
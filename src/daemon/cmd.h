@@ -35,6 +35,8 @@ struct cmdline_config {
 };
 
 void stop_collectd(void);
+/* Makes the main loop reload the configuration, see cf_reload(). */
+void reload_collectd(void);
 struct cmdline_config init_config(int argc, char **argv);
 int run_loop(bool test_readall);
 
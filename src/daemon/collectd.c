@@ -60,6 +60,8 @@
 #endif
 
 static int loop;
+/* Set by reload_collectd(), e.g. upon SIGHUP. */
+static int reload;
 
 static int init_hostname(void) {
   const char *str = global_option_get("Hostname");
@@ -270,6 +272,12 @@ static int do_loop(void) {
   cdtime_t wait_until = cdtime() + interval;
 
   while (loop == 0) {
+    if (reload != 0) {
+      reload = 0;
+      if (cf_reload() != 0)
+        ERROR("Parts of the configuration could not be reloaded.");
+    }
+
 #if HAVE_LIBKSTAT
     update_kstat();
 #endif
@@ -289,7 +297,8 @@ static int do_loop(void) {
     struct timespec ts_wait = CDTIME_T_TO_TIMESPEC(wait_until - now);
     wait_until = wait_until + interval;
 
-    while ((loop == 0) && (nanosleep(&ts_wait, &ts_wait) != 0)) {
+    while ((loop == 0) && (reload == 0) &&
+           (nanosleep(&ts_wait, &ts_wait) != 0)) {
       if (errno != EINTR) {
         ERROR("nanosleep failed: %s", STRERRNO);
         return -1;
@@ -390,6 +399,8 @@ static int configure_collectd(struct cmdline_config *config) {
 
 void stop_collectd(void) { loop++; }
 
+void reload_collectd(void) { reload++; }
+
 struct cmdline_config init_config(int argc, char **argv) {
   struct cmdline_config config = {
       .daemonize = true, .create_basedir = true, .configfile = CONFIGFILE,
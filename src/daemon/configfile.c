@@ -31,9 +31,12 @@
 
 #include "configfile.h"
 #include "filter_chain.h"
+#include "notification_queue.h"
 #include "plugin.h"
 #include "types_list.h"
 #include "utils/common/common.h"
+#include "write_pool.h"
+#include "write_spool.h"
 
 #if HAVE_WORDEXP_H
 #include <wordexp.h>
@@ -64,6 +67,8 @@ typedef struct cf_callback {
 typedef struct cf_complex_callback_s {
   char *type;
   int (*callback)(oconfig_item_t *);
+  /* Applies a changed configuration to the running plugin, may be NULL. */
+  int (*reload)(oconfig_item_t *);
   plugin_ctx_t ctx;
   struct cf_complex_callback_s *next;
 } cf_complex_callback_t;
@@ -107,19 +112,39 @@ static cf_global_option_t cf_global_options[] = {
     {"FQDNLookup", NULL, 0, "true"},
     {"Interval", NULL, 0, NULL},
     {"ReadThreads", NULL, 0, "5"},
+    {"ReadThreadsMax", NULL, 0, NULL},
+    {"ReadThreadsAffinity", NULL, 0, NULL},
+    {"InitThreads", NULL, 0, "4"},
     {"WriteThreads", NULL, 0, "5"},
+    {"WriteThreadsMax", NULL, 0, NULL},
+    {"WriteThreadsAffinity", NULL, 0, NULL},
+    {"WriteQueuePerNode", NULL, 0, "false"},
+    {"EventLoopThreads", NULL, 0, "2"},
     {"WriteQueueLimitHigh", NULL, 0, NULL},
     {"WriteQueueLimitLow", NULL, 0, NULL},
+    {"WriteBatchSize", NULL, 0, "512"},
+    {"WriteBatchTimeout", NULL, 0, "0.01"},
+    {"FlushDeadline", NULL, 0, "0"},
     {"Timeout", NULL, 0, "2"},
+    {"CoarseClock", NULL, 0, "false"},
+    {"ShareReadTimestamp", NULL, 0, "false"},
     {"AutoLoadPlugin", NULL, 0, "false"},
     {"CollectInternalStats", NULL, 0, "false"},
     {"PreCacheChain", NULL, 0, "PreCache"},
     {"PostCacheChain", NULL, 0, "PostCache"},
+    {"ValueCacheFile", NULL, 0, NULL},
+    {"ValueCacheHistory", NULL, 0, "0"},
+    {"ValueCacheReorderWindow", NULL, 0, "0"},
     {"MaxReadInterval", NULL, 0, "86400"}};
 static int cf_global_options_num = STATIC_ARRAY_SIZE(cf_global_options);
 
 static int cf_default_typesdb = 1;
 
+/* The configuration read by cf_read, which cf_reload compares the file's
+ * current contents with. */
+static char *cf_running_file;
+static oconfig_item_t *cf_running_conf;
+
 /*
  * Functions to handle register/unregister, search, and other plugin related
  * stuff
@@ -250,6 +275,161 @@ static int dispatch_value_plugindir(oconfig_item_t *ci) {
   return 0;
 }
 
+static int dispatch_spool_option(oconfig_item_t *ci, /* {{{ */
+                                 write_spool_config_t *conf) {
+  double value = NAN;
+
+  if (strcasecmp("SpoolDirectory", ci->key) == 0)
+    return cf_util_get_string(ci, &conf->directory);
+  else if (strcasecmp("SpoolRetryInterval", ci->key) == 0)
+    return cf_util_get_cdtime(ci, &conf->retry_interval);
+  else if (strcasecmp("SpoolSync", ci->key) == 0) {
+    char *sync = NULL;
+    int status = cf_util_get_string(ci, &sync);
+    if (status != 0)
+      return status;
+
+    if (strcasecmp("None", sync) == 0)
+      conf->sync = SPOOL_SYNC_NONE;
+    else if (strcasecmp("Segment", sync) == 0)
+      conf->sync = SPOOL_SYNC_SEGMENT;
+    else if (strcasecmp("Always", sync) == 0)
+      conf->sync = SPOOL_SYNC_ALWAYS;
+    else {
+      ERROR("configfile: `SpoolSync' must be \"None\", \"Segment\" or "
+            "\"Always\", not \"%s\".",
+            sync);
+      status = EINVAL;
+    }
+    sfree(sync);
+    return status;
+  }
+
+  int status = cf_util_get_double(ci, &value);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("SpoolSegmentSize", ci->key) == 0) {
+    if (!(value >= 4096.0) || (value > 1073741824.0)) {
+      ERROR("configfile: `SpoolSegmentSize' must be between 4096 bytes and "
+            "1 GiB.");
+      return EINVAL;
+    }
+    conf->segment_size = (size_t)value;
+  } else if (strcasecmp("SpoolLimit", ci->key) == 0) {
+    if (!(value >= 0.0)) {
+      ERROR("configfile: `SpoolLimit' must not be negative.");
+      return EINVAL;
+    }
+    conf->limit = (uint64_t)value;
+  } else if (strcasecmp("SpoolReplayRate", ci->key) == 0) {
+    if (!(value > 0.0)) {
+      ERROR("configfile: `SpoolReplayRate' must be positive.");
+      return EINVAL;
+    }
+    conf->replay_rate = value;
+  } else {
+    WARNING("configfile: Ignoring unknown LoadPlugin option \"%s\".",
+            ci->key);
+  }
+
+  return 0;
+} /* }}} int dispatch_spool_option */
+
+static int dispatch_write_pool_option(oconfig_item_t *ci, /* {{{ */
+                                      write_pool_config_t *conf) {
+  int value = 0;
+
+  int status = cf_util_get_int(ci, &value);
+  if (status != 0)
+    return status;
+
+  if (value < 0) {
+    ERROR("configfile: `%s' must not be negative.", ci->key);
+    return EINVAL;
+  }
+
+  if (strcasecmp("WriteThreads", ci->key) == 0)
+    conf->threads = (size_t)value;
+  else if (strcasecmp("WriteQueueLimitHigh", ci->key) == 0)
+    conf->limit_high = (long)value;
+  else if (strcasecmp("WriteQueueLimitLow", ci->key) == 0)
+    conf->limit_low = (long)value;
+
+  return 0;
+} /* }}} int dispatch_write_pool_option */
+
+static int dispatch_write_priority_option(oconfig_item_t *ci, /* {{{ */
+                                         int *ret_priority) {
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
+    ERROR("configfile: `WriteQueuePriority' needs exactly one string "
+          "argument.");
+    return EINVAL;
+  }
+
+  char const *value = ci->values[0].value.string;
+  if (strcasecmp("Low", value) == 0)
+    *ret_priority = WRITE_PRIORITY_LOW;
+  else if (strcasecmp("Normal", value) == 0)
+    *ret_priority = WRITE_PRIORITY_NORMAL;
+  else if (strcasecmp("High", value) == 0)
+    *ret_priority = WRITE_PRIORITY_HIGH;
+  else {
+    ERROR("configfile: Invalid `WriteQueuePriority' \"%s\": Expected one "
+          "of \"Low\", \"Normal\" and \"High\".",
+          value);
+    return EINVAL;
+  }
+
+  return 0;
+} /* }}} int dispatch_write_priority_option */
+
+static int dispatch_notification_option(oconfig_item_t *ci, /* {{{ */
+                                        notification_queue_config_t *conf) {
+  if (strcasecmp("NotificationBatchTimeout", ci->key) == 0)
+    return cf_util_get_cdtime(ci, &conf->batch_timeout);
+
+  if (strcasecmp("NotificationRateLimit", ci->key) == 0) {
+    double value = 0.0;
+    int status = cf_util_get_double(ci, &value);
+    if (status != 0)
+      return status;
+    if (!(value >= 0.0)) {
+      ERROR("configfile: `NotificationRateLimit' must not be negative.");
+      return EINVAL;
+    }
+    conf->rate_limit = value;
+    return 0;
+  }
+
+  int value = 0;
+  int status = cf_util_get_int(ci, &value);
+  if (status != 0)
+    return status;
+
+  if (value < 0) {
+    ERROR("configfile: `%s' must not be negative.", ci->key);
+    return EINVAL;
+  }
+
+  if (strcasecmp("NotificationThreads", ci->key) == 0)
+    conf->threads = (size_t)value;
+  else if (strcasecmp("NotificationQueueLimit", ci->key) == 0)
+    conf->limit = (size_t)value;
+  else if (strcasecmp("NotificationBatchSize", ci->key) == 0) {
+    if (value < 1) {
+      ERROR("configfile: `NotificationBatchSize' must be positive.");
+      return EINVAL;
+    }
+    conf->batch_size = (size_t)value;
+  } else {
+    WARNING("configfile: Ignoring unknown LoadPlugin option \"%s\".",
+            ci->key);
+  }
+
+  return 0;
+} /* }}} int dispatch_notification_option */
+
 static int dispatch_loadplugin(oconfig_item_t *ci) {
   bool global = false;
 
@@ -272,6 +452,17 @@ static int dispatch_loadplugin(oconfig_item_t *ci) {
   if (ctx.name == NULL)
     return ENOMEM;
 
+  write_spool_config_t spool = {
+      .segment_size = WRITE_SPOOL_SEGMENT_SIZE,
+      .sync = SPOOL_SYNC_SEGMENT,
+      .replay_rate = WRITE_SPOOL_REPLAY_RATE,
+      .retry_interval = WRITE_SPOOL_RETRY_INTERVAL,
+  };
+  write_pool_config_t write_pool = {.limit_low = -1};
+  notification_queue_config_t notification_queue = {
+      .limit = NOTIFICATION_QUEUE_LIMIT, .batch_size = 1,
+  };
+
   for (int i = 0; i < ci->children_num; ++i) {
     oconfig_item_t *child = ci->children + i;
 
@@ -279,10 +470,25 @@ static int dispatch_loadplugin(oconfig_item_t *ci) {
       cf_util_get_boolean(child, &global);
     else if (strcasecmp("Interval", child->key) == 0)
       cf_util_get_cdtime(child, &ctx.interval);
+    else if (strcasecmp("MaxInterval", child->key) == 0)
+      cf_util_get_cdtime(child, &ctx.max_interval);
     else if (strcasecmp("FlushInterval", child->key) == 0)
       cf_util_get_cdtime(child, &ctx.flush_interval);
     else if (strcasecmp("FlushTimeout", child->key) == 0)
       cf_util_get_cdtime(child, &ctx.flush_timeout);
+    else if (strcasecmp("AcceptLateValues", child->key) == 0)
+      cf_util_get_boolean(child, &ctx.late_values);
+    else if (strncasecmp("Spool", child->key, strlen("Spool")) == 0)
+      dispatch_spool_option(child, &spool);
+    else if ((strcasecmp("WriteThreads", child->key) == 0) ||
+             (strcasecmp("WriteQueueLimitHigh", child->key) == 0) ||
+             (strcasecmp("WriteQueueLimitLow", child->key) == 0))
+      dispatch_write_pool_option(child, &write_pool);
+    else if (strcasecmp("WriteQueuePriority", child->key) == 0)
+      dispatch_write_priority_option(child, &ctx.write_priority);
+    else if (strncasecmp("Notification", child->key,
+                         strlen("Notification")) == 0)
+      dispatch_notification_option(child, &notification_queue);
     else {
       WARNING("Ignoring unknown LoadPlugin option \"%s\" "
               "for plugin \"%s\"",
@@ -290,6 +496,40 @@ static int dispatch_loadplugin(oconfig_item_t *ci) {
     }
   }
 
+  /* Like the name, the configuration is shared by all callbacks of the
+   * plugin and kept until the daemon exits. */
+  if (spool.directory != NULL) {
+    ctx.spool = malloc(sizeof(*ctx.spool));
+    if (ctx.spool == NULL) {
+      sfree(spool.directory);
+      return ENOMEM;
+    }
+    *ctx.spool = spool;
+  }
+
+  if (write_pool.threads > 0) {
+    if (write_pool.limit_low < 0)
+      write_pool.limit_low = write_pool.limit_high / 2;
+    else if (write_pool.limit_low > write_pool.limit_high) {
+      ERROR("configfile: `WriteQueueLimitLow' must not be larger than "
+            "`WriteQueueLimitHigh' (plugin \"%s\").",
+            name);
+      write_pool.limit_low = write_pool.limit_high;
+    }
+
+    ctx.write_pool = malloc(sizeof(*ctx.write_pool));
+    if (ctx.write_pool == NULL)
+      return ENOMEM;
+    *ctx.write_pool = write_pool;
+  }
+
+  if (notification_queue.threads > 0) {
+    ctx.notification_queue = malloc(sizeof(*ctx.notification_queue));
+    if (ctx.notification_queue == NULL)
+      return ENOMEM;
+    *ctx.notification_queue = notification_queue;
+  }
+
   plugin_ctx_t old_ctx = plugin_set_ctx(ctx);
   int ret_val = plugin_load(name, global);
   /* reset to the "global" context */
@@ -990,6 +1230,7 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *)) {
   }
 
   new->callback = callback;
+  new->reload = NULL;
   new->next = NULL;
 
   new->ctx = plugin_get_ctx();
@@ -1006,6 +1247,235 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *)) {
   return 0;
 } /* int cf_register_complex */
 
+int cf_register_reload(const char *type, int (*callback)(oconfig_item_t *)) {
+  for (cf_complex_callback_t *cb = complex_callback_head; cb != NULL;
+       cb = cb->next) {
+    if (strcasecmp(type, cb->type) == 0) {
+      cb->reload = callback;
+      return 0;
+    }
+  }
+
+  return ENOENT;
+} /* int cf_register_reload */
+
+bool cf_config_equal(const oconfig_item_t *a, /* {{{ */
+                     const oconfig_item_t *b) {
+  if ((strcasecmp(a->key, b->key) != 0) || (a->values_num != b->values_num) ||
+      (a->children_num != b->children_num))
+    return false;
+
+  for (int i = 0; i < a->values_num; i++) {
+    const oconfig_value_t *va = a->values + i;
+    const oconfig_value_t *vb = b->values + i;
+
+    if (va->type != vb->type)
+      return false;
+    if ((va->type == OCONFIG_TYPE_STRING) &&
+        (strcmp(va->value.string, vb->value.string) != 0))
+      return false;
+    if ((va->type == OCONFIG_TYPE_NUMBER) &&
+        (va->value.number != vb->value.number))
+      return false;
+    if ((va->type == OCONFIG_TYPE_BOOLEAN) &&
+        (va->value.boolean != vb->value.boolean))
+      return false;
+  }
+
+  for (int i = 0; i < a->children_num; i++)
+    if (!cf_config_equal(a->children + i, b->children + i))
+      return false;
+
+  return true;
+} /* }}} bool cf_config_equal */
+
+/*
+ * Reloading the configuration
+ *
+ * The top level items are split into three groups, which are compared
+ * separately: the <Chain> blocks, the <Plugin> blocks of each plugin and
+ * everything else, i.e. the global options and the `LoadPlugin' statements.
+ * {{{ */
+typedef bool (*cf_item_filter_t)(const oconfig_item_t *ci, const char *name);
+
+static bool cf_is_chain(const oconfig_item_t *ci,
+                        const char __attribute__((unused)) * name) {
+  return strcasecmp("Chain", ci->key) == 0;
+}
+
+static bool cf_is_plugin(const oconfig_item_t *ci, const char *name) {
+  return (strcasecmp("Plugin", ci->key) == 0) && (ci->values_num >= 1) &&
+         (ci->values[0].type == OCONFIG_TYPE_STRING) &&
+         (strcasecmp(name, ci->values[0].value.string) == 0);
+}
+
+static bool cf_is_other(const oconfig_item_t *ci,
+                        const char __attribute__((unused)) * name) {
+  return (strcasecmp("Chain", ci->key) != 0) &&
+         (strcasecmp("Plugin", ci->key) != 0);
+}
+
+/* Returns true if the items of `a' and `b' selected by `filter' are equal and
+ * in the same order. */
+static bool cf_items_equal(const oconfig_item_t *a, const oconfig_item_t *b,
+                           cf_item_filter_t filter, const char *name) {
+  int i = 0;
+  int j = 0;
+
+  while (42) {
+    while ((i < a->children_num) && !filter(a->children + i, name))
+      i++;
+    while ((j < b->children_num) && !filter(b->children + j, name))
+      j++;
+
+    if ((i == a->children_num) || (j == b->children_num))
+      return (i == a->children_num) && (j == b->children_num);
+    if (!cf_config_equal(a->children + i, b->children + j))
+      return false;
+    i++;
+    j++;
+  }
+} /* bool cf_items_equal */
+
+/* Calls the reload callback of plugin `name' with all of its <Plugin> blocks
+ * in `conf' merged into one. If there are none, the block is empty. */
+static int cf_reload_plugin(const oconfig_item_t *conf, const char *name) {
+  cf_complex_callback_t *cb;
+  for (cb = complex_callback_head; cb != NULL; cb = cb->next)
+    if (strcasecmp(name, cb->type) == 0)
+      break;
+
+  if ((cb == NULL) || (cb->reload == NULL)) {
+    WARNING("The configuration of the \"%s\" plugin has changed. Restart the "
+            "daemon to apply the change.",
+            name);
+    return 0;
+  }
+
+  oconfig_item_t block = {.key = (char *)"Plugin"};
+  int children_num = 0;
+  for (int i = 0; i < conf->children_num; i++) {
+    if (!cf_is_plugin(conf->children + i, name))
+      continue;
+    if (block.values == NULL) {
+      block.values = conf->children[i].values;
+      block.values_num = conf->children[i].values_num;
+    }
+    children_num += conf->children[i].children_num;
+  }
+
+  if (children_num > 0) {
+    block.children = calloc((size_t)children_num, sizeof(*block.children));
+    if (block.children == NULL) {
+      ERROR("cf_reload_plugin: calloc failed.");
+      return ENOMEM;
+    }
+  }
+
+  /* Shallow copies: the children still belong to `conf'. */
+  for (int i = 0; i < conf->children_num; i++) {
+    if (!cf_is_plugin(conf->children + i, name))
+      continue;
+    for (int j = 0; j < conf->children[i].children_num; j++)
+      block.children[block.children_num++] = conf->children[i].children[j];
+  }
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(cb->ctx);
+  int status = cb->reload(&block);
+  plugin_set_ctx(old_ctx);
+
+  sfree(block.children);
+
+  if (status != 0) {
+    ERROR("Reloading the configuration of the \"%s\" plugin failed with "
+          "status %i.",
+          name, status);
+    return status;
+  }
+
+  INFO("Reloaded the configuration of the \"%s\" plugin.", name);
+  return 0;
+} /* int cf_reload_plugin */
+
+/* Reloads every plugin whose <Plugin> blocks are not the same in `old' and
+ * `new'. `conf' is the configuration whose plugins are checked. */
+static int cf_reload_plugins(const oconfig_item_t *old,
+                             const oconfig_item_t *new,
+                             const oconfig_item_t *conf) {
+  int ret = 0;
+
+  for (int i = 0; i < conf->children_num; i++) {
+    const oconfig_item_t *ci = conf->children + i;
+    if ((strcasecmp("Plugin", ci->key) != 0) || (ci->values_num < 1) ||
+        (ci->values[0].type != OCONFIG_TYPE_STRING))
+      continue;
+
+    const char *name = ci->values[0].value.string;
+
+    /* Only check every plugin once: at its first block in `new', or in `old'
+     * if it has no block in `new'. */
+    bool seen = false;
+    for (int j = 0; (j < i) && !seen; j++)
+      seen = cf_is_plugin(conf->children + j, name);
+    if (seen)
+      continue;
+    if (conf == old) {
+      for (int j = 0; (j < new->children_num) && !seen; j++)
+        seen = cf_is_plugin(new->children + j, name);
+      if (seen)
+        continue;
+    }
+
+    if (cf_items_equal(old, new, cf_is_plugin, name))
+      continue;
+    if (cf_reload_plugin(new, name) != 0)
+      ret = -1;
+  }
+
+  return ret;
+} /* int cf_reload_plugins */
+/* }}} */
+
+int cf_reload(void) {
+  if (cf_running_conf == NULL)
+    return EINVAL;
+
+  INFO("Reloading the configuration from %s.", cf_running_file);
+
+  oconfig_item_t *conf =
+      cf_read_generic(cf_running_file, /* pattern = */ NULL, /* depth = */ 0);
+  if (conf == NULL) {
+    ERROR("Unable to read config file %s. Keeping the running configuration.",
+          cf_running_file);
+    return -1;
+  }
+
+  int ret = 0;
+
+  if (!cf_items_equal(cf_running_conf, conf, cf_is_other, NULL))
+    WARNING("Global options or `LoadPlugin' statements have changed. Restart "
+            "the daemon to apply these changes.");
+
+  if (!cf_items_equal(cf_running_conf, conf, cf_is_chain, NULL)) {
+    if (fc_reconfigure(conf) == 0) {
+      plugin_update_chains();
+      INFO("Reloaded the filter chains.");
+    } else {
+      ret = -1;
+    }
+  }
+
+  if (cf_reload_plugins(cf_running_conf, conf, conf) != 0)
+    ret = -1;
+  if (cf_reload_plugins(cf_running_conf, conf, cf_running_conf) != 0)
+    ret = -1;
+
+  oconfig_free(cf_running_conf);
+  cf_running_conf = conf;
+
+  return ret;
+} /* int cf_reload */
+
 int cf_read(const char *filename) {
   oconfig_item_t *conf;
   int ret = 0;
@@ -1030,7 +1500,13 @@ int cf_read(const char *filename) {
     }
   }
 
-  oconfig_free(conf);
+  sfree(cf_running_file);
+  oconfig_free(cf_running_conf);
+  /* The daemon changes to its base directory after reading the config. */
+  cf_running_file = realpath(filename, /* resolved_path = */ NULL);
+  if (cf_running_file == NULL)
+    cf_running_file = strdup(filename);
+  cf_running_conf = conf;
 
   /* Read the default types.db if no `TypesDB' option was given. */
   if (cf_default_typesdb) {
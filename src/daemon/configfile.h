@@ -89,6 +89,31 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *));
  */
 int cf_read(const char *filename);
 
+/*
+ * DESCRIPTION
+ *  `cf_reload' reads the config file passed to `cf_read' again and compares
+ *  it with the running configuration. Changed filter chains are replaced,
+ *  plugins whose <Plugin> blocks changed are reconfigured if they registered a
+ *  reload callback with `cf_register_reload'. All other changes, including
+ *  global options and loading more plugins, are only logged: they need a
+ *  restart. The value cache and the write queue are not touched.
+ *
+ * RETURN VALUE
+ *  Returns zero upon success and non-zero if a part of the configuration could
+ *  not be applied. Error messages will have been logged in this case.
+ */
+int cf_reload(void);
+
+/* Registers the reload callback of a plugin which registered a complex config
+ * callback for `type'. The callback receives all <Plugin> blocks of the plugin
+ * merged into one, or an empty block if there are none. Returns ENOENT if
+ * there is no complex config callback for `type'. */
+int cf_register_reload(const char *type, int (*callback)(oconfig_item_t *));
+
+/* Returns true if both configuration blocks are identical. Keys are compared
+ * case-insensitively. */
+bool cf_config_equal(const oconfig_item_t *a, const oconfig_item_t *b);
+
 int global_option_set(const char *option, const char *value, bool from_cli);
 const char *global_option_get(const char *option);
 long global_option_get_long(const char *option, long default_value);
@@ -0,0 +1,376 @@
+/**
+ * collectd - src/daemon/event_loop.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "event_loop.h"
+#include "plugin.h"
+#include "utils/common/common.h"
+
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+typedef struct event_handler_s {
+  int fd;
+  /* Identifies the handler in events, which may still be reported after it
+   * has been removed. Zero is the wake-up pipe. */
+  uint64_t id;
+  event_loop_cb callback;
+  void (*free_func)(void *);
+  void *arg;
+
+  bool running;
+  pthread_t thread;
+  /* Set once the handler isn't in the list anymore. If it was removed by its
+   * own callback, the thread running it frees it. */
+  bool removed;
+  bool free_after_callback;
+
+  struct event_handler_s *next;
+} event_handler_t;
+
+struct event_loop_s {
+  pthread_mutex_t lock;
+  /* Signaled whenever a callback returns. */
+  pthread_cond_t cond;
+  event_handler_t *handlers;
+  uint64_t next_id;
+  bool stop;
+
+#if HAVE_SYS_EPOLL_H
+  int epoll_fd;
+#endif
+  /* Written to in order to wake up the threads. */
+  int wake_fd[2];
+
+  pthread_t *threads;
+  size_t threads_num;
+};
+
+static void event_handler_free(event_handler_t *h) {
+  if (h->free_func != NULL)
+    h->free_func(h->arg);
+  sfree(h);
+} /* void event_handler_free */
+
+static void event_loop_wake(event_loop_t *el) {
+  ssize_t status = write(el->wake_fd[1], &(char){0}, 1);
+  (void)status; /* A full pipe wakes up the threads just as well. */
+} /* void event_loop_wake */
+
+#if HAVE_SYS_EPOLL_H
+/* File descriptors are watched with EPOLLONESHOT, so that only one thread
+ * gets the event, and are watched again once the callback has returned. */
+static int event_loop_watch(event_loop_t *el, event_handler_t *h, int op) {
+  struct epoll_event ev = {
+      .events = EPOLLIN | EPOLLPRI | EPOLLONESHOT,
+      .data.u64 = h->id,
+  };
+  if (epoll_ctl(el->epoll_fd, op, h->fd, &ev) != 0)
+    return errno;
+  return 0;
+} /* int event_loop_watch */
+
+/* Stores the ids of up to EVENT_LOOP_BATCH_SIZE readable handlers in `ids'.
+ * Returns their number or -1 on error. */
+static int event_loop_wait(event_loop_t *el, uint64_t *ids) {
+  struct epoll_event events[EVENT_LOOP_BATCH_SIZE];
+
+  int num = epoll_wait(el->epoll_fd, events, EVENT_LOOP_BATCH_SIZE,
+                       /* timeout = */ -1);
+  for (int i = 0; i < num; i++)
+    ids[i] = events[i].data.u64;
+  return num;
+} /* int event_loop_wait */
+#else
+static int event_loop_wait(event_loop_t *el, uint64_t *ids) {
+  pthread_mutex_lock(&el->lock);
+  size_t fds_num = 1;
+  for (event_handler_t *h = el->handlers; h != NULL; h = h->next)
+    fds_num++;
+
+  struct pollfd fds[fds_num];
+  uint64_t fds_ids[fds_num];
+  fds[0] = (struct pollfd){.fd = el->wake_fd[0], .events = POLLIN};
+  fds_ids[0] = 0;
+  size_t i = 1;
+  for (event_handler_t *h = el->handlers; h != NULL; h = h->next, i++) {
+    fds[i] = (struct pollfd){.fd = h->fd, .events = POLLIN | POLLPRI};
+    fds_ids[i] = h->id;
+  }
+  pthread_mutex_unlock(&el->lock);
+
+  if (poll(fds, (nfds_t)fds_num, /* timeout = */ -1) < 0)
+    return -1;
+
+  /* Drain the pipe, handlers have been added or removed. */
+  if (fds[0].revents != 0) {
+    char buffer[64];
+    while (read(el->wake_fd[0], buffer, sizeof(buffer)) > 0)
+      ;
+  }
+
+  int num = 0;
+  for (i = 0; (i < fds_num) && (num < EVENT_LOOP_BATCH_SIZE); i++)
+    if (fds[i].revents != 0)
+      ids[num++] = fds_ids[i];
+  return num;
+} /* int event_loop_wait */
+#endif
+
+static event_handler_t *event_loop_find(event_loop_t *el, uint64_t id) {
+  for (event_handler_t *h = el->handlers; h != NULL; h = h->next)
+    if (h->id == id)
+      return h;
+  return NULL;
+} /* event_handler_t *event_loop_find */
+
+static void *event_loop_thread(void *arg) {
+  event_loop_t *el = arg;
+  uint64_t ids[EVENT_LOOP_BATCH_SIZE];
+
+  while (true) {
+    int num = event_loop_wait(el, ids);
+    if (num < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("event loop: Waiting for events failed: %s", STRERRNO);
+      break;
+    }
+
+    for (int i = 0; i < num; i++) {
+      pthread_mutex_lock(&el->lock);
+      if (el->stop) {
+        pthread_mutex_unlock(&el->lock);
+        return NULL;
+      }
+
+      event_handler_t *h = (ids[i] != 0) ? event_loop_find(el, ids[i]) : NULL;
+      if (h == NULL) {
+        pthread_mutex_unlock(&el->lock);
+        continue;
+      }
+      h->running = true;
+      h->thread = pthread_self();
+      pthread_mutex_unlock(&el->lock);
+
+      h->callback(h->fd, h->arg);
+
+      pthread_mutex_lock(&el->lock);
+      h->running = false;
+      if (h->removed) {
+        bool free_handler = h->free_after_callback;
+        pthread_cond_broadcast(&el->cond);
+        pthread_mutex_unlock(&el->lock);
+        if (free_handler)
+          event_handler_free(h);
+        continue;
+      }
+#if HAVE_SYS_EPOLL_H
+      int status = event_loop_watch(el, h, EPOLL_CTL_MOD);
+      if (status != 0)
+        ERROR("event loop: Watching file descriptor %d failed: %s", h->fd,
+              STRERROR(status));
+#endif
+      pthread_cond_broadcast(&el->cond);
+      pthread_mutex_unlock(&el->lock);
+    }
+  }
+
+  return NULL;
+} /* void *event_loop_thread */
+
+event_loop_t *event_loop_create(size_t threads_num) {
+  if (threads_num == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+#if !HAVE_SYS_EPOLL_H
+  threads_num = 1;
+#endif
+
+  event_loop_t *el = calloc(1, sizeof(*el));
+  if (el == NULL)
+    return NULL;
+  el->next_id = 1;
+
+  if (pipe(el->wake_fd) != 0) {
+    sfree(el);
+    return NULL;
+  }
+  fcntl(el->wake_fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(el->wake_fd[1], F_SETFL, O_NONBLOCK);
+
+#if HAVE_SYS_EPOLL_H
+  el->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  /* The pipe is never read, so that every thread sees it when stopping. */
+  struct epoll_event ev = {.events = EPOLLIN, .data.u64 = 0};
+  if ((el->epoll_fd < 0) ||
+      (epoll_ctl(el->epoll_fd, EPOLL_CTL_ADD, el->wake_fd[0], &ev) != 0)) {
+    int status = errno;
+    if (el->epoll_fd >= 0)
+      close(el->epoll_fd);
+    close(el->wake_fd[0]);
+    close(el->wake_fd[1]);
+    sfree(el);
+    errno = status;
+    return NULL;
+  }
+#endif
+
+  pthread_mutex_init(&el->lock, /* attr = */ NULL);
+  pthread_cond_init(&el->cond, /* attr = */ NULL);
+
+  el->threads = calloc(threads_num, sizeof(*el->threads));
+  if (el->threads == NULL) {
+    event_loop_destroy(el);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < threads_num; i++) {
+    int status = pthread_create(el->threads + i, /* attr = */ NULL,
+                                event_loop_thread, el);
+    if (status != 0) {
+      ERROR("event loop: pthread_create failed: %s", STRERROR(status));
+      break;
+    }
+    el->threads_num++;
+  }
+
+  if (el->threads_num == 0) {
+    event_loop_destroy(el);
+    return NULL;
+  }
+
+  return el;
+} /* event_loop_t *event_loop_create */
+
+void event_loop_destroy(event_loop_t *el) {
+  if (el == NULL)
+    return;
+
+  pthread_mutex_lock(&el->lock);
+  el->stop = true;
+  pthread_mutex_unlock(&el->lock);
+  event_loop_wake(el);
+
+  for (size_t i = 0; i < el->threads_num; i++)
+    pthread_join(el->threads[i], /* retval = */ NULL);
+  sfree(el->threads);
+
+  while (el->handlers != NULL) {
+    event_handler_t *h = el->handlers;
+    el->handlers = h->next;
+    event_handler_free(h);
+  }
+
+#if HAVE_SYS_EPOLL_H
+  close(el->epoll_fd);
+#endif
+  close(el->wake_fd[0]);
+  close(el->wake_fd[1]);
+  pthread_cond_destroy(&el->cond);
+  pthread_mutex_destroy(&el->lock);
+  sfree(el);
+} /* void event_loop_destroy */
+
+int event_loop_add(event_loop_t *el, int fd, event_loop_cb callback,
+                   void (*free_func)(void *), void *arg) {
+  if ((el == NULL) || (fd < 0) || (callback == NULL))
+    return EINVAL;
+
+  event_handler_t *h = calloc(1, sizeof(*h));
+  if (h == NULL)
+    return ENOMEM;
+  h->fd = fd;
+  h->callback = callback;
+  h->free_func = free_func;
+  h->arg = arg;
+
+  pthread_mutex_lock(&el->lock);
+  for (event_handler_t *ptr = el->handlers; ptr != NULL; ptr = ptr->next) {
+    if (ptr->fd == fd) {
+      pthread_mutex_unlock(&el->lock);
+      sfree(h);
+      return EEXIST;
+    }
+  }
+  h->id = el->next_id++;
+
+#if HAVE_SYS_EPOLL_H
+  int status = event_loop_watch(el, h, EPOLL_CTL_ADD);
+  if (status != 0) {
+    pthread_mutex_unlock(&el->lock);
+    sfree(h);
+    return status;
+  }
+#endif
+  h->next = el->handlers;
+  el->handlers = h;
+  pthread_mutex_unlock(&el->lock);
+
+#if !HAVE_SYS_EPOLL_H
+  event_loop_wake(el);
+#endif
+  return 0;
+} /* int event_loop_add */
+
+int event_loop_remove(event_loop_t *el, int fd) {
+  if (el == NULL)
+    return ENOENT;
+
+  pthread_mutex_lock(&el->lock);
+  event_handler_t **ptr = &el->handlers;
+  while ((*ptr != NULL) && ((*ptr)->fd != fd))
+    ptr = &(*ptr)->next;
+  event_handler_t *h = *ptr;
+  if (h == NULL) {
+    pthread_mutex_unlock(&el->lock);
+    return ENOENT;
+  }
+  *ptr = h->next;
+  h->removed = true;
+
+#if HAVE_SYS_EPOLL_H
+  epoll_ctl(el->epoll_fd, EPOLL_CTL_DEL, fd, /* event = */ NULL);
+#endif
+
+  if (h->running && pthread_equal(h->thread, pthread_self())) {
+    h->free_after_callback = true;
+    pthread_mutex_unlock(&el->lock);
+    return 0;
+  }
+
+  while (h->running)
+    pthread_cond_wait(&el->cond, &el->lock);
+  pthread_mutex_unlock(&el->lock);
+
+#if !HAVE_SYS_EPOLL_H
+  event_loop_wake(el);
+#endif
+  event_handler_free(h);
+  return 0;
+} /* int event_loop_remove */
@@ -0,0 +1,91 @@
+/**
+ * collectd - src/daemon/event_loop.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H 1
+
+#include "collectd.h"
+
+/* An event loop watches file descriptors for a set of threads, so that
+ * plugins reading from sockets don't need threads of their own. A callback
+ * is called by one of the threads whenever its file descriptor is readable.
+ * It is never called for the same file descriptor by two threads at once and
+ * should read without blocking, e.g. as many packets as recvmmsg(2) returns
+ * at once. Where epoll(7) isn't available, poll(2) and a single thread are
+ * used. */
+
+/* Number of events taken from the kernel by one thread at a time. */
+#define EVENT_LOOP_BATCH_SIZE 8
+
+typedef void (*event_loop_cb)(int fd, void *arg);
+
+struct event_loop_s;
+typedef struct event_loop_s event_loop_t;
+
+/*
+ * NAME
+ *   event_loop_create
+ *
+ * DESCRIPTION
+ *   Starts `threads_num' threads waiting for events.
+ *
+ * RETURN VALUE
+ *   An event_loop_t-pointer upon success or NULL upon failure.
+ */
+event_loop_t *event_loop_create(size_t threads_num);
+
+/* Stops the threads once their callbacks have returned and frees the loop,
+ * including the arguments of the file descriptors that are still watched. */
+void event_loop_destroy(event_loop_t *el);
+
+/*
+ * NAME
+ *   event_loop_add
+ *
+ * DESCRIPTION
+ *   Calls `callback' with `fd' and `arg' whenever `fd' is readable, until the
+ *   file descriptor is removed. `free_func', if not NULL, is called with
+ *   `arg' once the file descriptor has been removed.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EEXIST if `fd' is watched already, or another errno
+ *   value upon failure.
+ */
+int event_loop_add(event_loop_t *el, int fd, event_loop_cb callback,
+                   void (*free_func)(void *), void *arg);
+
+/*
+ * NAME
+ *   event_loop_remove
+ *
+ * DESCRIPTION
+ *   Stops watching `fd'. If its callback is running, this waits for it to
+ *   return, unless it's called from the callback itself. The file descriptor
+ *   can be closed afterwards.
+ *
+ * RETURN VALUE
+ *   Zero upon success or ENOENT if `fd' isn't watched.
+ */
+int event_loop_remove(event_loop_t *el, int fd);
+
+#endif /* EVENT_LOOP_H */
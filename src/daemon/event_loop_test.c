@@ -0,0 +1,191 @@
+/**
+ * collectd - src/daemon/event_loop_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "event_loop.h"
+#include "testing.h"
+#include "utils/common/common.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int read_bytes;
+static int freed;
+/* Set while a callback is running, to catch concurrent calls. */
+static int running;
+static int concurrent;
+
+typedef struct {
+  event_loop_t *el;
+  bool remove_self;
+} test_arg_t;
+
+static void read_cb(int fd, void *arg) {
+  test_arg_t *ta = arg;
+
+  pthread_mutex_lock(&lock);
+  if (running++ > 0)
+    concurrent++;
+  pthread_mutex_unlock(&lock);
+
+  char buffer[16];
+  ssize_t status = read(fd, buffer, sizeof(buffer));
+
+  pthread_mutex_lock(&lock);
+  running--;
+  if (status > 0)
+    read_bytes += (int)status;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+
+  if ((ta != NULL) && ta->remove_self)
+    event_loop_remove(ta->el, fd);
+}
+
+static void free_cb(void *arg) {
+  pthread_mutex_lock(&lock);
+  freed++;
+  pthread_mutex_unlock(&lock);
+  sfree(arg);
+}
+
+static void reset(void) {
+  pthread_mutex_lock(&lock);
+  read_bytes = 0;
+  freed = 0;
+  running = 0;
+  concurrent = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+static void wait_for_bytes(int num) {
+  pthread_mutex_lock(&lock);
+  while (read_bytes < num)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+static void write_byte(int fd) {
+  ssize_t status = write(fd, &(char){'x'}, 1);
+  (void)status;
+}
+
+DEF_TEST(dispatch) {
+  event_loop_t *el;
+  int fds[2];
+
+  reset();
+  CHECK_NOT_NULL(el = event_loop_create(4));
+  CHECK_ZERO(pipe(fds));
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  EXPECT_EQ_INT(0, event_loop_add(el, fds[0], read_cb, free_cb,
+                                  calloc(1, sizeof(test_arg_t))));
+  EXPECT_EQ_INT(EEXIST,
+                event_loop_add(el, fds[0], read_cb, NULL, /* arg = */ NULL));
+
+  /* Each byte is written once the previous one has been read, so that every
+   * byte causes an event. */
+  for (int i = 1; i <= 100; i++) {
+    write_byte(fds[1]);
+    wait_for_bytes(i);
+  }
+  EXPECT_EQ_INT(100, read_bytes);
+  EXPECT_EQ_INT(0, concurrent);
+
+  EXPECT_EQ_INT(0, event_loop_remove(el, fds[0]));
+  EXPECT_EQ_INT(1, freed);
+  EXPECT_EQ_INT(ENOENT, event_loop_remove(el, fds[0]));
+
+  event_loop_destroy(el);
+  close(fds[0]);
+  close(fds[1]);
+  return 0;
+}
+
+DEF_TEST(remove_from_callback) {
+  event_loop_t *el;
+  int fds[2];
+
+  reset();
+  CHECK_NOT_NULL(el = event_loop_create(2));
+  CHECK_ZERO(pipe(fds));
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  test_arg_t *ta = calloc(1, sizeof(*ta));
+  ta->el = el;
+  ta->remove_self = true;
+  EXPECT_EQ_INT(0, event_loop_add(el, fds[0], read_cb, free_cb, ta));
+
+  write_byte(fds[1]);
+  wait_for_bytes(1);
+
+  /* The handler is freed by the thread once the callback has returned. */
+  pthread_mutex_lock(&lock);
+  while (freed < 1)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  EXPECT_EQ_INT(ENOENT, event_loop_remove(el, fds[0]));
+
+  event_loop_destroy(el);
+  EXPECT_EQ_INT(1, freed);
+  close(fds[0]);
+  close(fds[1]);
+  return 0;
+}
+
+DEF_TEST(destroy) {
+  event_loop_t *el;
+  int fds[4][2];
+
+  reset();
+  CHECK_NOT_NULL(el = event_loop_create(2));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fds); i++) {
+    CHECK_ZERO(pipe(fds[i]));
+    fcntl(fds[i][0], F_SETFL, O_NONBLOCK);
+    EXPECT_EQ_INT(0, event_loop_add(el, fds[i][0], read_cb, free_cb,
+                                    calloc(1, sizeof(test_arg_t))));
+  }
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fds); i++)
+    write_byte(fds[i][1]);
+  wait_for_bytes((int)STATIC_ARRAY_SIZE(fds));
+
+  /* Watched file descriptors are freed with the loop. */
+  event_loop_destroy(el);
+  EXPECT_EQ_INT(STATIC_ARRAY_SIZE(fds), freed);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fds); i++) {
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(dispatch);
+  RUN_TEST(remove_from_callback);
+  RUN_TEST(destroy);
+
+  END_TEST;
+}
@@ -43,6 +43,8 @@ struct fc_match_s {
   char name[DATA_MAX_NAME_LEN];
   match_proc_t proc;
   void *user_data;
+  /* Copy of the <Match> block, used to find identical matches. */
+  oconfig_item_t *config;
   fc_match_t *next;
 }; /* }}} */
 
@@ -67,20 +69,70 @@ struct fc_rule_s {
   fc_rule_t *next;
 }; /* }}} */
 
+/* A rule of a compiled chain. */
+struct fc_plan_rule_s;
+typedef struct fc_plan_rule_s fc_plan_rule_t; /* {{{ */
+struct fc_plan_rule_s {
+  fc_rule_t *rule;
+  /* Indices into the plan's `matches'. */
+  size_t *matches;
+  size_t matches_num;
+  fc_target_t **targets;
+  size_t targets_num;
+}; /* }}} */
+
+/* The rules and targets of a chain, compiled into arrays when the chain is
+ * configured. Matches of the same type and with the same configuration share
+ * one entry in `matches', so they are evaluated at most once per value list.
+ * Contiguous `write' targets are merged into one. */
+struct fc_plan_s;
+typedef struct fc_plan_s fc_plan_t; /* {{{ */
+struct fc_plan_s {
+  fc_match_t **matches;
+  size_t matches_num;
+  fc_plan_rule_t *rules;
+  size_t rules_num;
+  fc_target_t **targets;
+  size_t targets_num;
+  /* Targets created by merging `write' targets. Owned by the plan. */
+  fc_target_t *merged;
+}; /* }}} */
+
+/* Results of the matches of a plan while one value list is processed. Only the
+ * first FC_MEMO_MAX matches are remembered. */
+#define FC_MEMO_MAX 64
+typedef struct {
+  uint64_t done;
+  uint64_t matches;
+} fc_memo_t;
+
 /* List of chains, used for `chain_list_head' */
 struct fc_chain_s /* {{{ */
 {
   char name[DATA_MAX_NAME_LEN];
   fc_rule_t *rules;
   fc_target_t *targets;
+  fc_plan_t *plan;
   fc_chain_t *next;
 }; /* }}} */
 
+/* User data of the built-in `jump' target. `chain' is resolved whenever a
+ * chain has been configured. */
+struct fc_jump_s;
+typedef struct fc_jump_s fc_jump_t; /* {{{ */
+struct fc_jump_s {
+  char *chain_name;
+  fc_chain_t *chain;
+}; /* }}} */
+
 /* Writer configuration. */
 struct fc_writer_s;
 typedef struct fc_writer_s fc_writer_t; /* {{{ */
 struct fc_writer_s {
   char *plugin;
+  /* Resolves `plugin' to its write callback once per change of the write
+   * callbacks rather than once per value list. */
+  plugin_write_ref_t *ref;
   c_complain_t complaint;
 }; /* }}} */
 
@@ -90,10 +142,17 @@ struct fc_writer_s {
 static fc_match_t *match_list_head;
 static fc_target_t *target_list_head;
 static fc_chain_t *chain_list_head;
+/* Chains replaced by fc_reconfigure, linked by their `next' pointers. */
+static fc_chain_t *chain_list_retired;
 
 /*
  * Private functions
  */
+static int fc_bit_jump_invoke(const data_set_t *ds, value_list_t *vl,
+                              notification_meta_t **meta, void **user_data);
+static int fc_bit_write_invoke(const data_set_t *ds, value_list_t *vl,
+                               notification_meta_t **meta, void **user_data);
+
 static void fc_free_matches(fc_match_t *m) /* {{{ */
 {
   if (m == NULL)
@@ -107,6 +166,9 @@ static void fc_free_matches(fc_match_t *m) /* {{{ */
           "Memory will probably be lost!");
   }
 
+  if (m->config != NULL)
+    oconfig_free(m->config);
+
   if (m->next != NULL)
     fc_free_matches(m->next);
 
@@ -146,11 +208,28 @@ static void fc_free_rules(fc_rule_t *r) /* {{{ */
   free(r);
 } /* }}} void fc_free_rules */
 
+static void fc_free_plan(fc_plan_t *plan) /* {{{ */
+{
+  if (plan == NULL)
+    return;
+
+  for (size_t i = 0; i < plan->rules_num; i++) {
+    free(plan->rules[i].matches);
+    free(plan->rules[i].targets);
+  }
+  free(plan->rules);
+  free(plan->matches);
+  free(plan->targets);
+  fc_free_targets(plan->merged);
+  free(plan);
+} /* }}} void fc_free_plan */
+
 static void fc_free_chains(fc_chain_t *c) /* {{{ */
 {
   if (c == NULL)
     return;
 
+  fc_free_plan(c->plan);
   fc_free_rules(c->rules);
   fc_free_targets(c->targets);
 
@@ -178,6 +257,245 @@ static char *fc_strdup(const char *orig) /* {{{ */
   return dest;
 } /* }}} char *fc_strdup */
 
+/*
+ * Compilation
+ *
+ * When a chain has been configured, its rules and targets are compiled into a
+ * `fc_plan_t', which is what fc_process_chain() executes.
+ */
+/* Stores the index of `m' in the plan's matches in `ret_index'. Adds `m' if
+ * there is no identical match yet. */
+static int fc_plan_add_match(fc_plan_t *plan, fc_match_t *m, /* {{{ */
+                             size_t *ret_index) {
+  for (size_t i = 0; i < plan->matches_num; i++) {
+    fc_match_t *other = plan->matches[i];
+
+    if ((m->config == NULL) || (other->config == NULL) ||
+        (strcasecmp(m->name, other->name) != 0) ||
+        !cf_config_equal(m->config, other->config))
+      continue;
+
+    *ret_index = i;
+    return 0;
+  }
+
+  fc_match_t **tmp = realloc(plan->matches,
+                             (plan->matches_num + 1) * sizeof(*plan->matches));
+  if (tmp == NULL)
+    return ENOMEM;
+  plan->matches = tmp;
+
+  plan->matches[plan->matches_num] = m;
+  *ret_index = plan->matches_num;
+  plan->matches_num++;
+
+  return 0;
+} /* }}} int fc_plan_add_match */
+
+/* Returns true for `write' targets with an explicit list of plugins. */
+static bool fc_target_is_plugin_write(const fc_target_t *t) /* {{{ */
+{
+  const fc_writer_t *plugin_list = t->user_data;
+
+  return (t->proc.invoke == fc_bit_write_invoke) && (plugin_list != NULL) &&
+         (plugin_list[0].plugin != NULL);
+} /* }}} bool fc_target_is_plugin_write */
+
+/* Appends copies of the plugins of `src' to the `write' target `dst'. */
+static int fc_writer_append(fc_target_t *dst, /* {{{ */
+                            const fc_target_t *src) {
+  fc_writer_t *dst_list = dst->user_data;
+  const fc_writer_t *src_list = src->user_data;
+  size_t dst_num = 0;
+  size_t src_num = 0;
+
+  while ((dst_list != NULL) && (dst_list[dst_num].plugin != NULL))
+    dst_num++;
+  while (src_list[src_num].plugin != NULL)
+    src_num++;
+
+  fc_writer_t *tmp =
+      realloc(dst_list, (dst_num + src_num + 1) * sizeof(*dst_list));
+  if (tmp == NULL)
+    return ENOMEM;
+  dst_list = tmp;
+  dst->user_data = dst_list;
+
+  for (size_t i = 0; i < src_num; i++) {
+    dst_list[dst_num].plugin = fc_strdup(src_list[i].plugin);
+    if (dst_list[dst_num].plugin == NULL)
+      break;
+    dst_list[dst_num].ref = plugin_write_ref_create(src_list[i].plugin);
+    if (dst_list[dst_num].ref == NULL) {
+      free(dst_list[dst_num].plugin);
+      break;
+    }
+    C_COMPLAIN_INIT(&dst_list[dst_num].complaint);
+    dst_num++;
+  }
+  dst_list[dst_num].plugin = NULL;
+
+  return (dst_num == 0) ? ENOMEM : 0;
+} /* }}} int fc_writer_append */
+
+/* Returns a `write' target writing to the plugins of `a' and then of `b'. If
+ * `a' has been created by merging before, it is extended. */
+static fc_target_t *fc_plan_merge_writes(fc_plan_t *plan, /* {{{ */
+                                         fc_target_t *a, const fc_target_t *b) {
+  for (fc_target_t *t = plan->merged; t != NULL; t = t->next)
+    if (t == a)
+      return (fc_writer_append(a, b) == 0) ? a : NULL;
+
+  fc_target_t *t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    return NULL;
+  sstrncpy(t->name, a->name, sizeof(t->name));
+  memcpy(&t->proc, &a->proc, sizeof(t->proc));
+
+  /* Link the target first, so it is freed with the plan on failure. */
+  t->next = plan->merged;
+  plan->merged = t;
+
+  if ((fc_writer_append(t, a) != 0) || (fc_writer_append(t, b) != 0))
+    return NULL;
+
+  return t;
+} /* }}} fc_target_t *fc_plan_merge_writes */
+
+static int fc_plan_add_targets(fc_plan_t *plan, /* {{{ */
+                               fc_target_t *head, fc_target_t ***ret_targets,
+                               size_t *ret_targets_num) {
+  fc_target_t **targets;
+  size_t targets_num = 0;
+
+  for (fc_target_t *t = head; t != NULL; t = t->next)
+    targets_num++;
+
+  *ret_targets = NULL;
+  *ret_targets_num = 0;
+  if (targets_num == 0)
+    return 0;
+
+  targets = calloc(targets_num, sizeof(*targets));
+  if (targets == NULL)
+    return ENOMEM;
+
+  targets_num = 0;
+  for (fc_target_t *t = head; t != NULL; t = t->next) {
+    fc_target_t *prev = (targets_num > 0) ? targets[targets_num - 1] : NULL;
+
+    if ((prev != NULL) && fc_target_is_plugin_write(prev) &&
+        fc_target_is_plugin_write(t)) {
+      fc_target_t *merged = fc_plan_merge_writes(plan, prev, t);
+      if (merged == NULL) {
+        free(targets);
+        return ENOMEM;
+      }
+      targets[targets_num - 1] = merged;
+      continue;
+    }
+
+    targets[targets_num] = t;
+    targets_num++;
+  }
+
+  *ret_targets = targets;
+  *ret_targets_num = targets_num;
+  return 0;
+} /* }}} int fc_plan_add_targets */
+
+static int fc_plan_add_rule(fc_plan_t *plan, fc_rule_t *rule) /* {{{ */
+{
+  fc_plan_rule_t *pr = plan->rules + plan->rules_num;
+  size_t matches_num = 0;
+
+  for (fc_match_t *m = rule->matches; m != NULL; m = m->next)
+    matches_num++;
+
+  *pr = (fc_plan_rule_t){.rule = rule};
+  /* Count the rule right away, so it is freed with the plan on failure. */
+  plan->rules_num++;
+
+  if (matches_num > 0) {
+    pr->matches = calloc(matches_num, sizeof(*pr->matches));
+    if (pr->matches == NULL)
+      return ENOMEM;
+  }
+
+  for (fc_match_t *m = rule->matches; m != NULL; m = m->next) {
+    int status = fc_plan_add_match(plan, m, pr->matches + pr->matches_num);
+    if (status != 0)
+      return status;
+    pr->matches_num++;
+  }
+
+  return fc_plan_add_targets(plan, rule->targets, &pr->targets,
+                             &pr->targets_num);
+} /* }}} int fc_plan_add_rule */
+
+/* Replaces the plan of `chain'. The old plan is kept if compiling fails. */
+static int fc_chain_compile(fc_chain_t *chain) /* {{{ */
+{
+  fc_plan_t *plan;
+  size_t rules_num = 0;
+  int status = 0;
+
+  for (fc_rule_t *r = chain->rules; r != NULL; r = r->next)
+    rules_num++;
+
+  plan = calloc(1, sizeof(*plan));
+  if (plan == NULL)
+    return ENOMEM;
+
+  if (rules_num > 0) {
+    plan->rules = calloc(rules_num, sizeof(*plan->rules));
+    if (plan->rules == NULL)
+      status = ENOMEM;
+  }
+
+  for (fc_rule_t *r = chain->rules; (r != NULL) && (status == 0); r = r->next)
+    status = fc_plan_add_rule(plan, r);
+
+  if (status == 0)
+    status = fc_plan_add_targets(plan, chain->targets, &plan->targets,
+                                 &plan->targets_num);
+
+  if (status != 0) {
+    fc_free_plan(plan);
+    return status;
+  }
+
+  DEBUG("Filter subsystem: Chain %s: Compiled %" PRIsz " rules using %" PRIsz
+        " distinct matches.",
+        chain->name, plan->rules_num, plan->matches_num);
+
+  fc_free_plan(chain->plan);
+  chain->plan = plan;
+  return 0;
+} /* }}} int fc_chain_compile */
+
+static void fc_resolve_jumps_list(fc_target_t *t) /* {{{ */
+{
+  for (; t != NULL; t = t->next) {
+    fc_jump_t *jump = t->user_data;
+
+    if ((t->proc.invoke != fc_bit_jump_invoke) || (jump == NULL))
+      continue;
+    jump->chain = fc_chain_get_by_name(jump->chain_name);
+  }
+} /* }}} void fc_resolve_jumps_list */
+
+/* Points all `jump' targets to their chains, which may have been configured
+ * after the jump. */
+static void fc_resolve_jumps(void) /* {{{ */
+{
+  for (fc_chain_t *c = chain_list_head; c != NULL; c = c->next) {
+    for (fc_rule_t *r = c->rules; r != NULL; r = r->next)
+      fc_resolve_jumps_list(r->targets);
+    fc_resolve_jumps_list(c->targets);
+  }
+} /* }}} void fc_resolve_jumps */
+
 /*
  * Configuration.
  *
@@ -245,6 +563,9 @@ static int fc_config_add_match(fc_match_t **matches_head, /* {{{ */
     }
   }
 
+  /* Without a copy, the match is simply not shared with identical ones. */
+  m->config = oconfig_clone(ci);
+
   if (*matches_head != NULL) {
     ptr = *matches_head;
     while (ptr->next != NULL)
@@ -441,14 +762,12 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
   } /* for (ci->children) */
 
   if (status != 0) {
-    fc_free_chains(chain);
-    return -1;
-  }
-
-  if (chain_list_head != NULL) {
-    if (!new_chain)
-      return 0;
-
+    /* Rules added to an existing chain before the error are kept. */
+    if (new_chain) {
+      fc_free_chains(chain);
+      return -1;
+    }
+  } else if (new_chain && (chain_list_head != NULL)) {
     fc_chain_t *ptr;
 
     ptr = chain_list_head;
@@ -456,11 +775,18 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
       ptr = ptr->next;
 
     ptr->next = chain;
-  } else {
+  } else if (new_chain) {
     chain_list_head = chain;
   }
 
-  return 0;
+  if (fc_chain_compile(chain) != 0) {
+    ERROR("Filter subsystem: Chain %s: Compiling the chain failed.",
+          chain->name);
+    status = -1;
+  }
+  fc_resolve_jumps();
+
+  return (status != 0) ? -1 : 0;
 } /* }}} int fc_config_add_chain */
 
 /*
@@ -493,19 +819,30 @@ static int fc_bit_jump_create(const oconfig_item_t *ci, /* {{{ */
     return -1;
   }
 
-  *user_data = fc_strdup(ci_chain->values[0].value.string);
-  if (*user_data == NULL) {
+  fc_jump_t *jump = calloc(1, sizeof(*jump));
+  if (jump == NULL) {
+    ERROR("fc_bit_jump_create: calloc failed.");
+    return -1;
+  }
+
+  jump->chain_name = fc_strdup(ci_chain->values[0].value.string);
+  if (jump->chain_name == NULL) {
     ERROR("fc_bit_jump_create: fc_strdup failed.");
+    free(jump);
     return -1;
   }
 
+  *user_data = jump;
   return 0;
 } /* }}} int fc_bit_jump_create */
 
 static int fc_bit_jump_destroy(void **user_data) /* {{{ */
 {
-  if (user_data != NULL) {
-    free(*user_data);
+  if ((user_data != NULL) && (*user_data != NULL)) {
+    fc_jump_t *jump = *user_data;
+
+    free(jump->chain_name);
+    free(jump);
     *user_data = NULL;
   }
 
@@ -517,20 +854,14 @@ static int fc_bit_jump_invoke(const data_set_t *ds, /* {{{ */
                               notification_meta_t __attribute__((unused)) *
                                   *meta,
                               void **user_data) {
-  char *chain_name;
-  fc_chain_t *chain;
+  fc_jump_t *jump = *user_data;
+  fc_chain_t *chain = jump->chain;
   int status;
 
-  chain_name = *user_data;
-
-  for (chain = chain_list_head; chain != NULL; chain = chain->next)
-    if (strcasecmp(chain_name, chain->name) == 0)
-      break;
-
   if (chain == NULL) {
     ERROR("Filter subsystem: Built-in target `jump': There is no chain "
           "named `%s'.",
-          chain_name);
+          jump->chain_name);
     return -1;
   }
 
@@ -598,6 +929,12 @@ static int fc_bit_write_create(const oconfig_item_t *ci, /* {{{ */
         ERROR("fc_bit_write_create: fc_strdup failed.");
         continue;
       }
+      plugin_list[plugin_list_len].ref = plugin_write_ref_create(plugin);
+      if (plugin_list[plugin_list_len].ref == NULL) {
+        ERROR("fc_bit_write_create: plugin_write_ref_create failed.");
+        free(plugin_list[plugin_list_len].plugin);
+        continue;
+      }
       C_COMPLAIN_INIT(&plugin_list[plugin_list_len].complaint);
       plugin_list_len++;
       plugin_list[plugin_list_len].plugin = NULL;
@@ -618,8 +955,10 @@ static int fc_bit_write_destroy(void **user_data) /* {{{ */
 
   plugin_list = *user_data;
 
-  for (size_t i = 0; plugin_list[i].plugin != NULL; i++)
+  for (size_t i = 0; plugin_list[i].plugin != NULL; i++) {
     free(plugin_list[i].plugin);
+    plugin_write_ref_destroy(plugin_list[i].ref);
+  }
   free(plugin_list);
 
   return 0;
@@ -669,7 +1008,7 @@ static int fc_bit_write_invoke(const data_set_t *ds, /* {{{ */
     }
   } else {
     for (size_t i = 0; plugin_list[i].plugin != NULL; i++) {
-      status = plugin_write(plugin_list[i].plugin, ds, vl);
+      status = plugin_write_ref(plugin_list[i].ref, ds, vl);
       if (status != 0) {
         c_complain(
             LOG_INFO, &plugin_list[i].complaint,
@@ -799,18 +1138,59 @@ fc_chain_t *fc_chain_get_by_name(const char *chain_name) /* {{{ */
   return NULL;
 } /* }}} int fc_chain_get_by_name */
 
+/* Evaluates the match at `index' of `plan', unless its result is known. */
+static int fc_plan_match(const fc_plan_t *plan, size_t index, /* {{{ */
+                         fc_memo_t *memo, const data_set_t *ds,
+                         value_list_t *vl) {
+  uint64_t bit = (index < FC_MEMO_MAX) ? (((uint64_t)1) << index) : 0;
+
+  if (memo->done & bit)
+    return (memo->matches & bit) ? FC_MATCH_MATCHES : FC_MATCH_NO_MATCH;
+
+  fc_match_t *match = plan->matches[index];
+  /* FIXME: Pass the meta-data to match targets here (when implemented). */
+  int status =
+      (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
+  if (status < 0)
+    return status;
+
+  memo->done |= bit;
+  if (status == FC_MATCH_MATCHES)
+    memo->matches |= bit;
+  else
+    memo->matches &= ~bit;
+
+  return status;
+} /* }}} int fc_plan_match */
+
+/* Invokes a target. Match results are forgotten unless the target is known
+ * not to modify `vl'. */
+static int fc_plan_invoke(fc_target_t *target, fc_memo_t *memo, /* {{{ */
+                          const data_set_t *ds, value_list_t *vl) {
+  if (target->proc.invoke != fc_bit_write_invoke)
+    memo->done = 0;
+
+  /* FIXME: Pass the meta-data to match targets here (when implemented). */
+  return (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+} /* }}} int fc_plan_invoke */
+
 int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
                      fc_chain_t *chain) {
-  fc_target_t *target;
+  fc_target_t *target = NULL;
+  fc_memo_t memo = {0};
   int status = FC_TARGET_CONTINUE;
 
-  if (chain == NULL)
+  if ((chain == NULL) || (chain->plan == NULL))
     return -1;
 
+  fc_plan_t *plan = chain->plan;
+
   DEBUG("fc_process_chain (chain = %s);", chain->name);
 
-  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
-    fc_match_t *match;
+  for (size_t i = 0; i < plan->rules_num; i++) {
+    fc_plan_rule_t *pr = plan->rules + i;
+    fc_rule_t *rule = pr->rule;
+    size_t j;
     status = FC_TARGET_CONTINUE;
 
     if (rule->name[0] != 0) {
@@ -818,11 +1198,9 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
             rule->name);
     }
 
-    /* N. B.: rule->matches may be NULL. */
-    for (match = rule->matches; match != NULL; match = match->next) {
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
+    /* N. B.: pr->matches_num may be zero. */
+    for (j = 0; j < pr->matches_num; j++) {
+      status = fc_plan_match(plan, pr->matches[j], &memo, ds, vl);
       if (status < 0) {
         WARNING("fc_process_chain (%s): A match failed.", chain->name);
         break;
@@ -831,7 +1209,7 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
     }
 
     /* for-loop has been aborted: Either error or no match. */
-    if (match != NULL) {
+    if (j < pr->matches_num) {
       status = FC_TARGET_CONTINUE;
       continue;
     }
@@ -841,12 +1219,12 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
             rule->name);
     }
 
-    for (target = rule->targets; target != NULL; target = target->next) {
+    for (j = 0; j < pr->targets_num; j++) {
+      target = pr->targets[j];
+
       /* If we get here, all matches have matched the value. Execute the
        * target. */
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+      status = fc_plan_invoke(target, &memo, ds, vl);
       if (status < 0) {
         WARNING("fc_process_chain (%s): A target failed.", chain->name);
         continue;
@@ -880,12 +1258,12 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
   DEBUG("fc_process_chain (%s): Executing the default targets.", chain->name);
 
   status = FC_TARGET_CONTINUE;
-  for (target = chain->targets; target != NULL; target = target->next) {
+  for (size_t j = 0; j < plan->targets_num; j++) {
+    target = plan->targets[j];
+
     /* If we get here, all matches have matched the value. Execute the
      * target. */
-    /* FIXME: Pass the meta-data to match targets here (when implemented). */
-    status =
-        (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+    status = fc_plan_invoke(target, &memo, ds, vl);
     if (status < 0) {
       WARNING("fc_process_chain (%s): The default target failed.", chain->name);
     } else if (status == FC_TARGET_CONTINUE)
@@ -941,3 +1319,44 @@ int fc_configure(const oconfig_item_t *ci) /* {{{ */
 
   return -1;
 } /* }}} int fc_configure */
+
+int fc_reconfigure(const oconfig_item_t *ci) /* {{{ */
+{
+  fc_init_once();
+
+  if (ci == NULL)
+    return -EINVAL;
+
+  /* The chains are only looked up by name while configuring, so the new ones
+   * can be built in place of the old list. */
+  fc_chain_t *old = chain_list_head;
+  chain_list_head = NULL;
+
+  int status = 0;
+  for (int i = 0; i < ci->children_num; i++) {
+    if (strcasecmp("Chain", ci->children[i].key) != 0)
+      continue;
+
+    status = fc_config_add_chain(ci->children + i);
+    if (status != 0)
+      break;
+  }
+
+  if (status != 0) {
+    ERROR("Filter subsystem: Configuring the chains failed. "
+          "Keeping the old chains.");
+    fc_free_chains(chain_list_head);
+    chain_list_head = old;
+    return -1;
+  }
+
+  if (old != NULL) {
+    fc_chain_t *last = old;
+    while (last->next != NULL)
+      last = last->next;
+    last->next = chain_list_retired;
+    chain_list_retired = old;
+  }
+
+  return 0;
+} /* }}} int fc_reconfigure */
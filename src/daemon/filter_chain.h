@@ -100,4 +100,10 @@ int fc_default_action(const data_set_t *ds, value_list_t *vl);
  */
 int fc_configure(const oconfig_item_t *ci);
 
+/* Replaces all chains with the <Chain> blocks among the children of `ci'. If
+ * any of them fails, the old chains are kept. The old chains are not freed,
+ * since values may still be processed by them; fc_chain_get_by_name() returns
+ * the new ones. */
+int fc_reconfigure(const oconfig_item_t *ci);
+
 #endif /* FILTER_CHAIN_H */
@@ -0,0 +1,347 @@
+/**
+ * collectd - src/daemon/notification_queue.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "notification_queue.h"
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils_time.h"
+
+/* How often dropping notifications is complained about. */
+#define NOTIFICATION_QUEUE_COMPLAIN_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+typedef struct {
+  notification_t *n;
+  /* When the notification has been queued. */
+  cdtime_t time;
+} notification_queue_entry_t;
+
+/* The batch of one thread, handed to the callback. */
+typedef struct {
+  notification_queue_t *nq;
+  pthread_t thread;
+  notification_t const **n;
+} notification_queue_thread_t;
+
+struct notification_queue_s {
+  char *name;
+  notification_queue_config_t conf;
+  size_t batch_size;
+  notification_queue_cb callback;
+  void *arg;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* A ring buffer of `size' entries; `length' of them, starting at `head',
+   * are used. */
+  notification_queue_entry_t *queue;
+  size_t size;
+  size_t head;
+  size_t length;
+  bool shutdown;
+
+  /* Token bucket of the rate limit, holding up to one second worth of
+   * calls. */
+  double tokens;
+  cdtime_t last_refill;
+  cdtime_t next_token;
+
+  uint64_t dropped;
+  cdtime_t last_complaint;
+
+  notification_queue_thread_t *threads;
+  size_t threads_num;
+};
+
+static notification_t *notification_copy(notification_t const *n) {
+  notification_t *copy = malloc(sizeof(*copy));
+  if (copy == NULL)
+    return NULL;
+
+  *copy = *n;
+  /* Otherwise plugin_notification_meta_copy() appends to the original. */
+  copy->meta = NULL;
+  plugin_notification_meta_copy(copy, n);
+  return copy;
+} /* notification_t *notification_copy */
+
+static void notification_free(notification_t *n) {
+  if (n == NULL)
+    return;
+  if (n->meta != NULL)
+    plugin_notification_meta_free(n->meta);
+  sfree(n);
+} /* void notification_free */
+
+/* Takes a token from the bucket if one is available. Otherwise, sets
+ * `next_token' to when the next one is. Must be called with `nq->lock'
+ * held. */
+static bool notification_queue_take_token(notification_queue_t *nq) {
+  double rate = nq->conf.rate_limit;
+  if (!(rate > 0.0))
+    return true;
+
+  double burst = (rate > 1.0) ? rate : 1.0;
+  cdtime_t now = cdtime();
+  if (nq->last_refill == 0)
+    nq->tokens = burst;
+  else if (now > nq->last_refill)
+    nq->tokens += rate * CDTIME_T_TO_DOUBLE(now - nq->last_refill);
+  if (nq->tokens > burst)
+    nq->tokens = burst;
+  nq->last_refill = now;
+
+  if (nq->tokens >= 1.0) {
+    nq->tokens -= 1.0;
+    return true;
+  }
+
+  nq->next_token = now + DOUBLE_TO_CDTIME_T((1.0 - nq->tokens) / rate);
+  return false;
+} /* bool notification_queue_take_token */
+
+/* Waits for `cond' until `deadline'. Must be called with `nq->lock' held. */
+static void notification_queue_wait(notification_queue_t *nq,
+                                    cdtime_t deadline) {
+  struct timespec ts = CDTIME_T_TO_TIMESPEC(deadline);
+  pthread_cond_timedwait(&nq->cond, &nq->lock, &ts);
+} /* void notification_queue_wait */
+
+static void *notification_queue_thread(void *arg) {
+  notification_queue_thread_t *t = arg;
+  notification_queue_t *nq = t->nq;
+
+  pthread_mutex_lock(&nq->lock);
+  while (true) {
+    while (!nq->shutdown && (nq->length == 0))
+      pthread_cond_wait(&nq->cond, &nq->lock);
+    /* Notifications queued before the shutdown are still delivered. */
+    if (nq->length == 0)
+      break;
+
+    /* Give the batch time to fill, counting from the oldest notification. */
+    while (!nq->shutdown && (nq->length > 0) &&
+           (nq->length < nq->batch_size)) {
+      cdtime_t deadline = nq->queue[nq->head].time + nq->conf.batch_timeout;
+      if (cdtime() >= deadline)
+        break;
+      notification_queue_wait(nq, deadline);
+    }
+
+    while (!nq->shutdown && (nq->length > 0) &&
+           !notification_queue_take_token(nq))
+      notification_queue_wait(nq, nq->next_token);
+
+    /* Another thread may have taken the notifications meanwhile. */
+    if (nq->length == 0)
+      continue;
+
+    size_t num = nq->length;
+    if (num > nq->batch_size)
+      num = nq->batch_size;
+    for (size_t i = 0; i < num; i++)
+      t->n[i] = nq->queue[(nq->head + i) % nq->size].n;
+    nq->head = (nq->head + num) % nq->size;
+    nq->length -= num;
+    pthread_mutex_unlock(&nq->lock);
+
+    (*nq->callback)(t->n, num, nq->arg);
+    for (size_t i = 0; i < num; i++) {
+      notification_free((notification_t *)t->n[i]);
+      t->n[i] = NULL;
+    }
+
+    pthread_mutex_lock(&nq->lock);
+  }
+  pthread_mutex_unlock(&nq->lock);
+
+  return NULL;
+} /* void *notification_queue_thread */
+
+notification_queue_t *
+notification_queue_create(char const *name,
+                          notification_queue_config_t const *conf,
+                          size_t batch_size, notification_queue_cb callback,
+                          void *arg) {
+  if ((name == NULL) || (conf == NULL) || (conf->threads < 1) ||
+      (batch_size < 1) || (callback == NULL))
+    return NULL;
+
+  notification_queue_t *nq = calloc(1, sizeof(*nq));
+  if (nq == NULL) {
+    ERROR("notification_queue: calloc failed.");
+    return NULL;
+  }
+  nq->conf = *conf;
+  nq->batch_size = batch_size;
+  nq->callback = callback;
+  nq->arg = arg;
+  pthread_mutex_init(&nq->lock, NULL);
+  pthread_cond_init(&nq->cond, NULL);
+
+  nq->name = strdup(name);
+  nq->threads = calloc(conf->threads, sizeof(*nq->threads));
+  if ((nq->name == NULL) || (nq->threads == NULL)) {
+    ERROR("notification_queue: Allocating the queue of \"%s\" failed.", name);
+    notification_queue_destroy(nq);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < conf->threads; i++) {
+    notification_queue_thread_t *t = nq->threads + nq->threads_num;
+    t->nq = nq;
+    t->n = calloc(batch_size, sizeof(*t->n));
+    if (t->n == NULL) {
+      ERROR("notification_queue: calloc failed.");
+      break;
+    }
+
+    int status = plugin_thread_create(&t->thread, /* attr = */ NULL,
+                                      notification_queue_thread, t, "notifyq");
+    if (status != 0) {
+      ERROR("notification_queue: plugin_thread_create failed: %s",
+            STRERROR(status));
+      break;
+    }
+    nq->threads_num++;
+  }
+
+  if (nq->threads_num == 0) {
+    notification_queue_destroy(nq);
+    return NULL;
+  }
+
+  return nq;
+} /* notification_queue_t *notification_queue_create */
+
+void notification_queue_destroy(notification_queue_t *nq) {
+  if (nq == NULL)
+    return;
+
+  pthread_mutex_lock(&nq->lock);
+  nq->shutdown = true;
+  pthread_cond_broadcast(&nq->cond);
+  if (nq->length > 0)
+    INFO("notification_queue: Delivering the %" PRIsz
+         " queued notifications of \"%s\".",
+         nq->length, nq->name);
+  pthread_mutex_unlock(&nq->lock);
+
+  for (size_t i = 0; i < nq->threads_num; i++)
+    pthread_join(nq->threads[i].thread, NULL);
+
+  /* Only left if no thread could be started. */
+  for (size_t i = 0; i < nq->length; i++)
+    notification_free(nq->queue[(nq->head + i) % nq->size].n);
+
+  if (nq->threads != NULL) {
+    for (size_t i = 0; i < nq->conf.threads; i++)
+      sfree(nq->threads[i].n);
+  }
+  sfree(nq->threads);
+  sfree(nq->queue);
+  sfree(nq->name);
+  pthread_cond_destroy(&nq->cond);
+  pthread_mutex_destroy(&nq->lock);
+  sfree(nq);
+} /* void notification_queue_destroy */
+
+/* Doubles the ring buffer. Must be called with `nq->lock' held. */
+static int notification_queue_grow(notification_queue_t *nq) {
+  size_t size = (nq->size == 0) ? 64 : 2 * nq->size;
+  notification_queue_entry_t *queue = calloc(size, sizeof(*queue));
+  if (queue == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < nq->length; i++)
+    queue[i] = nq->queue[(nq->head + i) % nq->size];
+
+  sfree(nq->queue);
+  nq->queue = queue;
+  nq->size = size;
+  nq->head = 0;
+  return 0;
+} /* int notification_queue_grow */
+
+int notification_queue_enqueue(notification_queue_t *nq,
+                               notification_t const *n) {
+  if ((nq == NULL) || (n == NULL))
+    return EINVAL;
+
+  /* Copied outside of the lock, and in vain if the queue is full. */
+  notification_t *copy = notification_copy(n);
+  if (copy == NULL) {
+    ERROR("notification_queue: malloc failed.");
+    return ENOMEM;
+  }
+
+  pthread_mutex_lock(&nq->lock);
+  if (nq->shutdown) {
+    pthread_mutex_unlock(&nq->lock);
+    notification_free(copy);
+    return ESHUTDOWN;
+  }
+
+  if ((nq->conf.limit > 0) && (nq->length >= nq->conf.limit)) {
+    nq->dropped++;
+    cdtime_t now = cdtime();
+    bool complain =
+        (now - nq->last_complaint) >= NOTIFICATION_QUEUE_COMPLAIN_INTERVAL;
+    if (complain)
+      nq->last_complaint = now;
+    uint64_t dropped = nq->dropped;
+    pthread_mutex_unlock(&nq->lock);
+    notification_free(copy);
+
+    if (complain)
+      WARNING("notification_queue: The queue of \"%s\" is full. %" PRIu64
+              " notifications have been dropped so far.",
+              nq->name, dropped);
+    return EAGAIN;
+  }
+
+  if ((nq->length == nq->size) && (notification_queue_grow(nq) != 0)) {
+    pthread_mutex_unlock(&nq->lock);
+    notification_free(copy);
+    ERROR("notification_queue: Growing the queue of \"%s\" failed.",
+          nq->name);
+    return ENOMEM;
+  }
+
+  nq->queue[(nq->head + nq->length) % nq->size] =
+      (notification_queue_entry_t){.n = copy, .time = cdtime()};
+  nq->length++;
+  pthread_cond_signal(&nq->cond);
+  pthread_mutex_unlock(&nq->lock);
+
+  return 0;
+} /* int notification_queue_enqueue */
+
+void notification_queue_stats(notification_queue_t *nq, long *ret_length,
+                              uint64_t *ret_dropped) {
+  pthread_mutex_lock(&nq->lock);
+  *ret_length = (long)nq->length;
+  *ret_dropped = nq->dropped;
+  pthread_mutex_unlock(&nq->lock);
+} /* void notification_queue_stats */
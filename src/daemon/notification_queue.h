@@ -0,0 +1,100 @@
+/**
+ * collectd - src/daemon/notification_queue.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef NOTIFICATION_QUEUE_H
+#define NOTIFICATION_QUEUE_H 1
+
+#include "plugin.h"
+
+/* A notification queue gives one notification callback its own queue and
+ * threads, so that a slow callback, e.g. one sending email, doesn't block the
+ * threads dispatching notifications. The threads pass up to `batch_size'
+ * notifications at a time to the callback, waiting up to `batch_timeout' for
+ * a batch to fill. With a rate limit, the callback is called at most
+ * `rate_limit' times per second; meanwhile, notifications keep piling up and
+ * are passed on in larger batches. If the queue holds `limit' notifications,
+ * further ones are dropped. */
+
+#define NOTIFICATION_QUEUE_LIMIT 1000
+
+struct notification_queue_config_s {
+  size_t threads;
+  /* Zero for an unbounded queue. */
+  size_t limit;
+  size_t batch_size;
+  cdtime_t batch_timeout;
+  /* Calls per second, zero for no limit. */
+  double rate_limit;
+};
+typedef struct notification_queue_config_s notification_queue_config_t;
+
+struct notification_queue_s;
+typedef struct notification_queue_s notification_queue_t;
+
+/* Delivers `num' notifications, taken from the queue in order. Returns zero
+ * upon success. */
+typedef int (*notification_queue_cb)(notification_t const *const *n,
+                                     size_t num, void *arg);
+
+/*
+ * NAME
+ *   notification_queue_create
+ *
+ * DESCRIPTION
+ *   Starts the threads of the notification callback `name'. Each call of
+ *   `callback' gets at most `batch_size' notifications; callbacks that handle
+ *   one notification at a time pass 1 to override the configured size.
+ *
+ * RETURN VALUE
+ *   A notification_queue_t-pointer upon success or NULL upon failure.
+ */
+notification_queue_t *
+notification_queue_create(char const *name,
+                          notification_queue_config_t const *conf,
+                          size_t batch_size, notification_queue_cb callback,
+                          void *arg);
+
+/* Delivers the notifications that are still queued, ignoring the rate limit,
+ * then stops the threads. */
+void notification_queue_destroy(notification_queue_t *nq);
+
+/*
+ * NAME
+ *   notification_queue_enqueue
+ *
+ * DESCRIPTION
+ *   Queues a copy of `n', including its meta data.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EAGAIN if the notification has been dropped because
+ *   the queue is full and ESHUTDOWN if the queue is shutting down.
+ */
+int notification_queue_enqueue(notification_queue_t *nq,
+                               notification_t const *n);
+
+/* Returns the number of queued notifications and the number of notifications
+ * dropped so far. */
+void notification_queue_stats(notification_queue_t *nq, long *ret_length,
+                              uint64_t *ret_dropped);
+
+#endif /* NOTIFICATION_QUEUE_H */
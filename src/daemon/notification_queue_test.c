@@ -0,0 +1,313 @@
+/**
+ * collectd - src/daemon/notification_queue_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* testing.h comes first so that utils_time.h declares cdtime_mock. */
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/common/common.h"
+
+/* The queue's clock and timed waits are replaced: the mock time is read under
+ * the test's lock, and the test can tell when the queue thread has looked at
+ * the queue again and decided to wait. */
+static cdtime_t mock_cdtime(void);
+static int mock_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m,
+                               struct timespec const *ts);
+#define cdtime mock_cdtime
+#define pthread_cond_timedwait mock_cond_timedwait
+#include "notification_queue.c" /* sic */
+#undef cdtime
+#undef pthread_cond_timedwait
+
+/* How long to wait for the queue thread before giving up. */
+#define TEST_TIMEOUT TIME_T_TO_CDTIME_T(10)
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static uint64_t timed_waits;
+/* Set while the callback is called and waits for `blocked' to be cleared. */
+static bool blocked;
+static bool waiting;
+static int delivered;
+static int calls;
+static size_t largest_batch;
+static int out_of_order;
+
+static cdtime_t mock_cdtime(void) {
+  pthread_mutex_lock(&lock);
+  cdtime_t t = cdtime_mock;
+  pthread_mutex_unlock(&lock);
+  return t;
+}
+
+static void set_time(cdtime_t t) {
+  pthread_mutex_lock(&lock);
+  cdtime_mock = t;
+  pthread_mutex_unlock(&lock);
+}
+
+/* Called by the queue thread with the queue's lock held, so every wait counted
+ * after a change to the queue follows a look at the changed queue. With the
+ * mock time, the deadline has passed on the real clock and the thread keeps
+ * coming back here until there is something to deliver. */
+static int mock_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m,
+                               struct timespec const *ts) {
+  pthread_mutex_lock(&lock);
+  timed_waits++;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  return pthread_cond_timedwait(c, m, ts);
+}
+
+/* Waits until the queue thread has looked at the queue since the last change
+ * and found nothing it may deliver yet. */
+static int wait_for_timed_wait(void) {
+  struct timespec deadline = CDTIME_T_TO_TIMESPEC(cdtime_precise() +
+                                                  TEST_TIMEOUT);
+  int status = 0;
+
+  pthread_mutex_lock(&lock);
+  uint64_t want = timed_waits + 1;
+  while ((timed_waits < want) && (status == 0))
+    status = pthread_cond_timedwait(&cond, &lock, &deadline);
+  pthread_mutex_unlock(&lock);
+  return status;
+}
+
+static int notify_cb(notification_t const *const *n, size_t num, void *arg) {
+  pthread_mutex_lock(&lock);
+  waiting = true;
+  pthread_cond_broadcast(&cond);
+  while (blocked)
+    pthread_cond_wait(&cond, &lock);
+  waiting = false;
+
+  for (size_t i = 0; i < num; i++) {
+    if (atoi(n[i]->message) != delivered)
+      out_of_order++;
+    delivered++;
+  }
+  calls++;
+  if (num > largest_batch)
+    largest_batch = num;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+static int enqueue(notification_queue_t *nq, int i) {
+  notification_t n = {.severity = NOTIF_FAILURE};
+  snprintf(n.message, sizeof(n.message), "%d", i);
+  return notification_queue_enqueue(nq, &n);
+}
+
+static void reset(bool block) {
+  pthread_mutex_lock(&lock);
+  blocked = block;
+  waiting = false;
+  delivered = 0;
+  calls = 0;
+  largest_batch = 0;
+  out_of_order = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+static void unblock(void) {
+  pthread_mutex_lock(&lock);
+  blocked = false;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+/* Waits until the callback is stuck in a call. */
+static void wait_for_call(void) {
+  pthread_mutex_lock(&lock);
+  while (!waiting)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+/* Waits until `num' notifications have been delivered. */
+static void wait_for_delivered(int num) {
+  pthread_mutex_lock(&lock);
+  while (delivered < num)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+static int get_delivered(void) {
+  pthread_mutex_lock(&lock);
+  int num = delivered;
+  pthread_mutex_unlock(&lock);
+  return num;
+}
+
+DEF_TEST(drain) {
+  notification_queue_config_t conf = {.threads = 1};
+  notification_queue_t *nq;
+
+  reset(/* block = */ false);
+  CHECK_NOT_NULL(nq = notification_queue_create("drain", &conf, 1, notify_cb,
+                                                NULL));
+  for (int i = 0; i < 1000; i++)
+    EXPECT_EQ_INT(0, enqueue(nq, i));
+
+  /* The queued notifications are delivered before the queue is gone. */
+  notification_queue_destroy(nq);
+  EXPECT_EQ_INT(1000, delivered);
+  EXPECT_EQ_INT(1000, calls);
+  EXPECT_EQ_INT(0, out_of_order);
+
+  return 0;
+}
+
+DEF_TEST(batch) {
+  notification_queue_config_t conf = {.threads = 1};
+  notification_queue_t *nq;
+
+  reset(/* block = */ true);
+  CHECK_NOT_NULL(nq = notification_queue_create("batch", &conf, 4, notify_cb,
+                                                NULL));
+
+  /* Notifications queued while the callback is busy are delivered
+   * together. */
+  EXPECT_EQ_INT(0, enqueue(nq, 0));
+  wait_for_call();
+  for (int i = 1; i < 10; i++)
+    EXPECT_EQ_INT(0, enqueue(nq, i));
+  unblock();
+
+  notification_queue_destroy(nq);
+  EXPECT_EQ_INT(10, delivered);
+  EXPECT_EQ_INT(4, calls);
+  EXPECT_EQ_UINT64(4, (uint64_t)largest_batch);
+  EXPECT_EQ_INT(0, out_of_order);
+
+  return 0;
+}
+
+DEF_TEST(batch_timeout) {
+  notification_queue_config_t conf = {
+      .threads = 1, .batch_timeout = TIME_T_TO_CDTIME_T(10),
+  };
+  notification_queue_t *nq;
+
+  reset(/* block = */ false);
+  set_time(TIME_T_TO_CDTIME_T(1000));
+  CHECK_NOT_NULL(nq = notification_queue_create("batch_timeout", &conf, 4,
+                                                notify_cb, NULL));
+
+  /* The thread waits for the batch to fill ... */
+  for (int i = 0; i < 3; i++)
+    EXPECT_EQ_INT(0, enqueue(nq, i));
+  CHECK_ZERO(wait_for_timed_wait());
+  EXPECT_EQ_INT(0, get_delivered());
+  EXPECT_EQ_INT(0, enqueue(nq, 3));
+  wait_for_delivered(4);
+
+  /* ... or for the timeout. */
+  EXPECT_EQ_INT(0, enqueue(nq, 4));
+  CHECK_ZERO(wait_for_timed_wait());
+  EXPECT_EQ_INT(4, get_delivered());
+  set_time(TIME_T_TO_CDTIME_T(1010));
+  wait_for_delivered(5);
+
+  notification_queue_destroy(nq);
+  EXPECT_EQ_INT(2, calls);
+  EXPECT_EQ_INT(0, out_of_order);
+
+  return 0;
+}
+
+DEF_TEST(rate_limit) {
+  notification_queue_config_t conf = {.threads = 1, .rate_limit = 2.0};
+  notification_queue_t *nq;
+
+  reset(/* block = */ false);
+  set_time(TIME_T_TO_CDTIME_T(1000));
+  CHECK_NOT_NULL(nq = notification_queue_create("rate_limit", &conf, 1,
+                                                notify_cb, NULL));
+
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ_INT(0, enqueue(nq, i));
+  wait_for_delivered(2);
+  CHECK_ZERO(wait_for_timed_wait());
+  EXPECT_EQ_INT(2, get_delivered());
+
+  set_time(TIME_T_TO_CDTIME_T(1001));
+  wait_for_delivered(4);
+  CHECK_ZERO(wait_for_timed_wait());
+  EXPECT_EQ_INT(4, get_delivered());
+
+  /* The rest is delivered right away when shutting down. */
+  notification_queue_destroy(nq);
+  EXPECT_EQ_INT(10, delivered);
+  EXPECT_EQ_INT(0, out_of_order);
+
+  return 0;
+}
+
+DEF_TEST(limit) {
+  notification_queue_config_t conf = {.threads = 1, .limit = 5};
+  notification_queue_t *nq;
+
+  reset(/* block = */ true);
+  CHECK_NOT_NULL(nq = notification_queue_create("limit", &conf, 1, notify_cb,
+                                                NULL));
+
+  EXPECT_EQ_INT(0, enqueue(nq, 0));
+  wait_for_call();
+
+  int dropped = 0;
+  for (int i = 1; i < 9; i++) {
+    int status = enqueue(nq, i);
+    if (status == EAGAIN)
+      dropped++;
+    else
+      EXPECT_EQ_INT(0, status);
+  }
+  EXPECT_EQ_INT(3, dropped);
+
+  long length = 0;
+  uint64_t stats_dropped = 0;
+  notification_queue_stats(nq, &length, &stats_dropped);
+  EXPECT_EQ_INT(5, (int)length);
+  EXPECT_EQ_UINT64(3, stats_dropped);
+
+  unblock();
+  notification_queue_destroy(nq);
+  EXPECT_EQ_INT(6, delivered);
+  EXPECT_EQ_INT(0, out_of_order);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(drain);
+  RUN_TEST(batch);
+  RUN_TEST(batch_timeout);
+  RUN_TEST(rate_limit);
+  RUN_TEST(limit);
+
+  END_TEST;
+}
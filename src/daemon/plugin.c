@@ -31,16 +31,26 @@
 #include "collectd.h"
 
 #include "configfile.h"
+#include "event_loop.h"
 #include "filter_chain.h"
+#include "notification_queue.h"
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils/heap/heap.h"
+#include "utils/latency/latency.h"
+#include "utils/pool/pool.h"
+#include "utils_affinity.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
+#include "utils_counter.h"
+#include "utils_ident.h"
 #include "utils_llist.h"
 #include "utils_random.h"
 #include "utils_time.h"
+#include "write_pending.h"
+#include "write_pool.h"
+#include "write_spool.h"
 
 #ifdef WIN32
 #define EXPORT __declspec(dllexport)
@@ -59,13 +69,85 @@
 /*
  * Private structures
  */
+/* How long a callback took, collected with `CollectInternalStats'. Calls
+ * are recorded without locking, so that threads calling the same write
+ * callback don't contend; `lock' only serializes reading. */
+struct callback_stats_s {
+  pthread_mutex_t lock;
+  /* Reset whenever the statistics are reported. */
+  latency_counter_t *duration;
+  /* Number of calls that took longer than the callback's interval. */
+  derive_t overruns;
+};
+typedef struct callback_stats_s callback_stats_t;
+
+/* Relative accuracy of the callback durations' sketches. */
+#define CALLBACK_STATS_ACCURACY 0.01
+
 struct callback_func_s {
   void *cf_callback;
   user_data_t cf_udata;
   plugin_ctx_t cf_ctx;
+  /* NULL unless statistics are recorded. */
+  callback_stats_t *cf_stats;
+  /* Write callbacks only: NULL unless failed writes are spooled. */
+  write_spool_t *cf_spool;
+  /* Write callbacks only: NULL unless the callback has its own queue and
+   * threads. */
+  write_pool_t *cf_pool;
+  /* Write callbacks only: the identifiers written since the last flush. NULL
+   * unless the plugin has a flush callback of the same name. Accessed
+   * atomically. */
+  write_pending_t *cf_pending;
+  /* Notification callbacks only: NULL unless the callback has its own queue
+   * and threads. */
+  notification_queue_t *cf_nqueue;
 };
 typedef struct callback_func_s callback_func_t;
 
+/* Stages of the dispatch path timed with `CollectInternalStats'. */
+enum {
+  STAGE_PRE_CACHE = 0,
+  STAGE_CACHE_UPDATE,
+  STAGE_POST_CACHE,
+  STAGE_FLUSH,
+  STAGE_NUM
+};
+static char const *const stage_names[STAGE_NUM] = {
+    "pre_cache", "cache_update", "post_cache", "flush"};
+
+struct stage_counter_s {
+  uint64_t calls;
+  cdtime_t time;
+};
+typedef struct stage_counter_s stage_counter_t;
+
+/* Values dispatched by the plugin `name'. */
+struct plugin_counter_s {
+  char name[DATA_MAX_NAME_LEN];
+  uint64_t values;
+  /* Allocations made to copy the values into the write queue. */
+  uint64_t allocations;
+};
+typedef struct plugin_counter_s plugin_counter_t;
+
+/* Per plugin counters of one thread. Every thread only updates its own
+ * counters, so their lock is uncontended except while they are read. When a
+ * thread exits, its counters are adopted by the next thread, like the caches
+ * of the allocator pools; all counters are cumulative. */
+struct hot_stats_s {
+  pthread_mutex_t lock;
+  plugin_counter_t *plugins;
+  size_t plugins_num;
+  /* Index of the last plugin counted, checked first. */
+  size_t plugins_last;
+
+  /* Set when the owning thread exits. Protected by `hot_stats_lock'. */
+  bool orphaned;
+  struct hot_stats_s *next;
+};
+typedef struct hot_stats_s hot_stats_t;
+
 #define RF_SIMPLE 0
 #define RF_COMPLEX 1
 #define RF_REMOVE 65535
@@ -82,73 +164,341 @@ struct read_func_s {
   cdtime_t rf_interval;
   cdtime_t rf_effective_interval;
   cdtime_t rf_next_read;
+  /* Time between `rf_next_read' and the start of the last call. Protected by
+   * `read_lock'. */
+  cdtime_t rf_lag;
+  /* Non-zero if the interval adapts to the values: it is doubled, up to
+   * `rf_max_interval', after each call whose values did not change. */
+  cdtime_t rf_max_interval;
+  /* Set by `plugin_dispatch_values' if a value of the running call changed. */
+  bool rf_changed;
 };
 typedef struct read_func_s read_func_t;
 
+/* Values whose rate changed by at most this fraction are considered stable. */
+#define ADAPTIVE_INTERVAL_TOLERANCE 0.01
+
+/* Once the read threads are running, each of them owns a shard of the read
+ * functions, kept in a heap ordered by the time they are due next. A thread
+ * only sleeps on its own shard. A thread that has nothing due steals overdue
+ * functions from shards whose owner is busy running a callback, so a slow
+ * callback doesn't delay the ones that happen to share its thread. Stolen
+ * functions stay with the thief. */
+struct read_shard_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  c_heap_t *heap;
+  /* Set while the owning thread runs a callback. */
+  bool busy;
+  /* Set to make the owning thread re-evaluate what is due without sleeping. */
+  bool kicked;
+};
+typedef struct read_shard_s read_shard_t;
+
 struct write_queue_s;
 typedef struct write_queue_s write_queue_t;
 struct write_queue_s {
   value_list_t *vl;
   plugin_ctx_t ctx;
+  /* When the value list was queued. Only set if `write_scaling' is set. */
+  cdtime_t time;
   write_queue_t *next;
 };
 
+/* The write queue is split into one shard per write thread. Producers pick a
+ * shard by hashing the identifier, so that values of one series usually end up
+ * in the same shard, and only contend with producers hashing to the same
+ * shard. A write thread whose shard runs empty steals from the other shards
+ * before going to sleep. */
+struct write_shard_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  write_queue_t *head;
+  write_queue_t *tail;
+  long length;
+  /* Set while the owning thread is waiting for `cond'. */
+  bool idle;
+  /* Set by producers that want the idle owner to steal from another shard. */
+  bool kicked;
+  /* The longest time a value list taken from this shard has been queued since
+   * the thread scaler last looked. Only set if `write_scaling' is set. */
+  cdtime_t latency_max;
+};
+typedef struct write_shard_s write_shard_t;
+
+/* Value lists a write thread has collected for one batch write callback. The
+ * callback is looked up by name when the batch is written, so that it may be
+ * unregistered while values are pending. */
+struct write_batch_s {
+  char *name;
+  data_set_t const **ds;
+  value_list_t **vl;
+  size_t num;
+  size_t size;
+};
+typedef struct write_batch_s write_batch_t;
+
+/* Per write thread state of all batch write callbacks. */
+struct write_batch_list_s {
+  write_batch_t *batches;
+  size_t batches_num;
+  /* Number of value lists pending in all batches and the time the first of
+   * them was added. */
+  size_t pending;
+  cdtime_t first_time;
+};
+typedef struct write_batch_list_s write_batch_list_t;
+
 struct flush_callback_s {
   char *name;
   cdtime_t timeout;
 };
 typedef struct flush_callback_s flush_callback_t;
 
+/* A write callback in a snapshot, see `write_snapshot'. */
+struct write_entry_s {
+  char const *name;
+  callback_func_t *cf;
+  bool batch;
+};
+typedef struct write_entry_s write_entry_t;
+
+/* The write and batch write callbacks, in this order. A snapshot is never
+ * modified: registering or unregistering a write callback publishes a new
+ * one. */
+struct write_snapshot_s {
+  uint64_t generation;
+  size_t num;
+  write_entry_t entries[];
+};
+typedef struct write_snapshot_s write_snapshot_t;
+
+/* Snapshots and callbacks replaced while readers may still use them. */
+struct write_retired_s {
+  write_snapshot_t *snapshot;
+  llentry_t *le;
+  callback_func_t *cf;
+  struct write_retired_s *next;
+};
+typedef struct write_retired_s write_retired_t;
+
+/* A write callback looked up by name once, see plugin_write_ref_create(). */
+struct plugin_write_ref_s {
+  char *name;
+  /* The generation of the snapshot the callback has been looked up in, in the
+   * upper 48 bits, and its index plus one, or zero if there was none. */
+  uint64_t cache;
+};
+
 /*
  * Private variables
  */
-static c_avl_tree_t *plugins_loaded;
+static c_btree_t *plugins_loaded;
 
 static llist_t *list_init;
+/* Init callbacks which may run concurrently with all others. */
+static llist_t *list_init_parallel;
 static llist_t *list_write;
+static llist_t *list_write_batch;
 static llist_t *list_flush;
 static llist_t *list_missing;
 static llist_t *list_shutdown;
 static llist_t *list_log;
 static llist_t *list_notification;
+static llist_t *list_notification_batch;
+
+/* Writing values only reads `write_snapshot', in a read section entered with
+ * write_snapshot_enter(). Replaced snapshots and removed callbacks are
+ * retired and freed once all read sections that may use them have been left,
+ * like RCU: a reader counts itself in `write_readers' of the parity of
+ * `write_epoch', and write_snapshot_synchronize() flips the epoch and waits
+ * for the readers of the previous parity, twice. Writers hold
+ * `register_lock'. */
+static write_snapshot_t *write_snapshot;
+static uint64_t write_snapshot_generation;
+static write_retired_t *write_retired;
+static shard_counter_t write_readers[2];
+static uint64_t write_epoch;
+/* Per thread, the nesting depth of read sections times two plus the parity
+ * counted in. */
+static pthread_key_t write_reader_key;
+static pthread_once_t write_reader_once = PTHREAD_ONCE_INIT;
+
+#define WRITE_REF_INDEX_BITS 16
+#define WRITE_REF_INDEX_MASK ((((uint64_t)1) << WRITE_REF_INDEX_BITS) - 1)
+
+/* The number of identifiers remembered per write callback for flushing. */
+#define WRITE_PENDING_LIMIT 65536
+
+/* The flush threads started by plugin_flush() which haven't exited yet. They
+ * may outlive the call if it has a deadline. */
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static size_t flush_threads_num;
+#define FLUSH_THREADS_MAX 16
+/* How long plugin_flush() waits for the flush callbacks, "FlushDeadline".
+ * Zero waits until all of them have returned. */
+static cdtime_t flush_deadline;
 
 static fc_chain_t *pre_cache_chain;
 static fc_chain_t *post_cache_chain;
 
-static c_avl_tree_t *data_sets;
+/* Data sets by type: an open addressing hash table with linear probing, at
+ * most half full, so that a lookup usually costs one hash and one strcmp. */
+struct data_set_entry_s {
+  uint64_t hash;
+  data_set_t *ds; /* NULL if the slot is free */
+};
+typedef struct data_set_entry_s data_set_entry_t;
+static data_set_entry_t *data_sets;
+static size_t data_sets_size; /* a power of two */
+static size_t data_sets_num;
+
+/* Replaced and unregistered data sets are only freed on shutdown: both the
+ * write queue and plugins may still hold pointers to them. */
+static data_set_t **data_sets_retired;
+static size_t data_sets_retired_num;
 
 static char *plugindir;
 
 #ifndef DEFAULT_MAX_READ_INTERVAL
 #define DEFAULT_MAX_READ_INTERVAL TIME_T_TO_CDTIME_T_STATIC(86400)
 #endif
+/* Read functions registered before the read threads are started (or when
+ * running with `-T') are kept in `read_heap'. */
 static c_heap_t *read_heap;
 static llist_t *read_list;
 static int read_loop = 1;
 static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t read_cond = PTHREAD_COND_INITIALIZER;
+/* Serializes registering callbacks and data sets, which parallel init
+ * callbacks may do at the same time. */
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t *read_threads;
 static size_t read_threads_num;
+/* `read_shards' has `read_shards_num' entries, one for each thread the pool
+ * may grow to; only the first `read_threads_num' have a thread. Threads at or
+ * above `read_threads_active' are parked: their shards are empty and they
+ * sleep until the pool grows again. All three are set with `read_lock' held;
+ * `read_threads_active' is also read without it. */
+static read_shard_t *read_shards;
+static size_t read_shards_num;
+static size_t read_threads_active;
+static size_t read_shard_next;
 static cdtime_t max_read_interval = DEFAULT_MAX_READ_INTERVAL;
 
-static write_queue_t *write_queue_head;
-static write_queue_t *write_queue_tail;
-static long write_queue_length;
+/* The same for the write threads: value lists are only hashed to the shards
+ * of the first `write_threads_active' threads. A parked write thread serves
+ * what is left in its shard and then sleeps. */
+static write_shard_t *write_shards;
+static size_t write_shards_num;
+static size_t write_threads_active;
 static bool write_loop = true;
-static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t write_cond = PTHREAD_COND_INITIALIZER;
 static pthread_t *write_threads;
 static size_t write_threads_num;
 
+/* The thread scaler periodically adds a read thread if read callbacks start
+ * late, and a write thread if value lists wait in the write queue, up to
+ * `ReadThreadsMax' and `WriteThreadsMax'. Threads that have been idle for a
+ * while are parked again, down to `ReadThreads' and `WriteThreads'. */
+#define SCALE_LATE_RATIO 0.1
+#define SCALE_WRITE_LATENCY TIME_T_TO_CDTIME_T_STATIC(1)
+#define SCALE_IDLE_CHECKS 6
+
+static bool read_scaling;
+static bool write_scaling;
+static size_t read_threads_min;
+static size_t write_threads_min;
+/* The largest delay of a read callback, relative to its interval, and the time
+ * spent in read callbacks since the thread scaler last looked. Protected by
+ * `read_lock'. */
+static double read_late_max;
+static cdtime_t read_busy_time;
+
+static pthread_t scaler_thread;
+static bool scaler_running;
+static bool scaler_loop;
+static pthread_mutex_t scaler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scaler_cond = PTHREAD_COND_INITIALIZER;
+/* Number of times the read (0) and write (1) pools have grown and shrunk. */
+static uint64_t scaler_grown[2];
+static uint64_t scaler_shrunk[2];
+
+/* The CPUs read and write threads are bound to, see `ReadThreadsAffinity'
+ * and `WriteThreadsAffinity'. */
+static affinity_set_t read_affinity;
+static bool read_affinity_set;
+static affinity_set_t write_affinity;
+static bool write_affinity_set;
+/* With `WriteQueuePerNode', write thread `i' runs on NUMA node
+ * `i % write_nodes_num' and producers only hash to the shards of their own
+ * node, so that value lists are usually freed on the node that allocated
+ * them. Otherwise, this is one. */
+static size_t write_nodes_num = 1;
+
+/* Created by the first plugin_register_fd() call. */
+static pthread_mutex_t event_loop_lock = PTHREAD_MUTEX_INITIALIZER;
+static event_loop_t *event_loop;
+
 static pthread_key_t plugin_ctx_key;
 static bool plugin_ctx_key_initialized;
 
+/* Set while a late value list, see uc_update(), is passed to the writers:
+ * points to the value list. */
+static pthread_key_t late_value_key;
+
+/* Only set in read threads, while an adaptive read function is running:
+ * points to its `read_func_t'. */
+static pthread_key_t read_func_key;
+static bool read_func_key_initialized;
+
+/* Only set in read threads with `ShareReadTimestamp', while a read function is
+ * running: points to the time the function was started at, which is used for
+ * all value lists it dispatches without a time. */
+static pthread_key_t read_time_key;
+static bool read_time_key_initialized;
+static bool read_time_shared;
+
+/* Only set in write threads: points to the thread's `write_batch_list_t'. */
+static pthread_key_t write_batch_key;
+static bool write_batch_key_initialized;
+static size_t write_batch_size;
+static cdtime_t write_batch_timeout;
+
 static long write_limit_high;
 static long write_limit_low;
 
-static pthread_mutex_t statistics_lock = PTHREAD_MUTEX_INITIALIZER;
-static derive_t stats_values_dropped;
+/* Values dropped because of the write queue limits, by write priority. */
+static shard_counter_t stats_values_dropped[] = {
+    SHARD_COUNTER_INIT, SHARD_COUNTER_INIT, SHARD_COUNTER_INIT};
+static char const *const write_priority_names[] = {"low", "normal", "high"};
 static bool record_statistics;
+/* Set once the spools of the write callbacks replay their values. */
+static bool write_spools_started;
+static bool write_pools_started;
+static bool notification_queues_started;
+/* Held for reading while a notification is queued and for writing while a
+ * callback's queue is replaced, so that a queue isn't destroyed while
+ * notifications are added to it. */
+static pthread_rwlock_t notification_queue_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static pthread_key_t hot_stats_key;
+static pthread_once_t hot_stats_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t hot_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static hot_stats_t *hot_stats_list;
+
+/* Calls and time spent per stage of the dispatch path. */
+static shard_counter_t stage_calls[STAGE_NUM];
+static shard_counter_t stage_time[STAGE_NUM];
+
+/* Number of free objects each thread keeps in the pools below. */
+#define PLUGIN_POOL_CACHE_MAX 1024
+
+/* Queue nodes and value list clones are allocated by the dispatching thread
+ * and freed by a write thread. The pools hand them back to the dispatching
+ * thread, sparing malloc's arena locks. */
+static c_pool_t *write_queue_pool;
+static c_pool_t *value_list_pool;
+static pthread_once_t plugin_pools_once = PTHREAD_ONCE_INIT;
 
 /*
  * Static functions
@@ -162,8 +512,338 @@ static const char *plugin_get_dir(void) {
     return plugindir;
 }
 
+/* Returns the number of value lists queued in all write shards. */
+static long plugin_write_queue_length(void) /* {{{ */
+{
+  long length = 0;
+
+  for (size_t i = 0; i < write_shards_num; i++) {
+    write_shard_t *shard = write_shards + i;
+
+    pthread_mutex_lock(&shard->lock);
+    length += shard->length;
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return length;
+} /* }}} long plugin_write_queue_length */
+
+/* A copy of the statistics of one callback, taken so that they can be
+ * dispatched without holding any locks. */
+struct callback_snapshot_s {
+  char name[DATA_MAX_NAME_LEN];
+  size_t num;
+  cdtime_t average;
+  cdtime_t p99;
+  cdtime_t max;
+  derive_t overruns;
+  /* Read functions only. */
+  cdtime_t lag;
+};
+typedef struct callback_snapshot_s callback_snapshot_t;
+
+/* Copies and resets the durations of all callbacks in `list'. If `is_read' is
+ * set, `list' is `read_list' and `read_lock' must be held. */
+static callback_snapshot_t *callback_stats_collect(llist_t *list, /* {{{ */
+                                                   bool is_read,
+                                                   size_t *ret_num) {
+  *ret_num = 0;
+  if ((list == NULL) || (llist_size(list) <= 0))
+    return NULL;
+
+  callback_snapshot_t *snapshots =
+      calloc((size_t)llist_size(list), sizeof(*snapshots));
+  if (snapshots == NULL) {
+    ERROR("plugin: callback_stats_collect: calloc failed.");
+    return NULL;
+  }
+
+  size_t num = 0;
+  for (llentry_t *le = llist_head(list); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    callback_stats_t *cs = cf->cf_stats;
+    callback_snapshot_t *snap = snapshots + num;
+
+    if (cs == NULL)
+      continue;
+
+    sstrncpy(snap->name, le->key, sizeof(snap->name));
+    if (is_read)
+      snap->lag = ((read_func_t *)cf)->rf_lag;
+
+    pthread_mutex_lock(&cs->lock);
+    snap->num = latency_counter_get_num(cs->duration);
+    snap->average = latency_counter_get_average(cs->duration);
+    snap->p99 = latency_counter_get_percentile(cs->duration, 99.0);
+    snap->max = latency_counter_get_max(cs->duration);
+    snap->overruns = __atomic_load_n(&cs->overruns, __ATOMIC_RELAXED);
+    latency_counter_reset(cs->duration);
+    pthread_mutex_unlock(&cs->lock);
+
+    num++;
+  }
+
+  *ret_num = num;
+  return snapshots;
+} /* }}} callback_snapshot_t *callback_stats_collect */
+
+static void plugin_dispatch_callback_stats(value_list_t *vl, /* {{{ */
+                                           char const *kind,
+                                           callback_snapshot_t const *snapshots,
+                                           size_t num, bool is_read) {
+  vl->values_len = 1;
+
+  for (size_t i = 0; i < num; i++) {
+    callback_snapshot_t const *snap = snapshots + i;
+
+    if (is_read) {
+      /* How late the read function was started last time */
+      sstrncpy(vl->plugin_instance, "read_scheduler",
+               sizeof(vl->plugin_instance));
+      sstrncpy(vl->type, "delay", sizeof(vl->type));
+      sstrncpy(vl->type_instance, snap->name, sizeof(vl->type_instance));
+      vl->values = &(value_t){.gauge = CDTIME_T_TO_DOUBLE(snap->lag)};
+      plugin_dispatch_values(vl);
+    }
+
+    snprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "%s_callback",
+             kind);
+
+    if (is_read) {
+      sstrncpy(vl->type, "derive", sizeof(vl->type));
+      snprintf(vl->type_instance, sizeof(vl->type_instance), "%s-overruns",
+               snap->name);
+      vl->values = &(value_t){.derive = snap->overruns};
+      plugin_dispatch_values(vl);
+    }
+
+    /* Nothing to report if the callback hasn't been called since the last
+     * time. */
+    if (snap->num == 0)
+      continue;
+
+    struct {
+      char const *name;
+      cdtime_t value;
+    } durations[] = {
+        {"average", snap->average}, {"p99", snap->p99}, {"max", snap->max},
+    };
+    sstrncpy(vl->type, "duration", sizeof(vl->type));
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(durations); j++) {
+      snprintf(vl->type_instance, sizeof(vl->type_instance), "%s-%s",
+               snap->name, durations[j].name);
+      vl->values =
+          &(value_t){.gauge = CDTIME_T_TO_DOUBLE(durations[j].value)};
+      plugin_dispatch_values(vl);
+    }
+  }
+} /* }}} void plugin_dispatch_callback_stats */
+
+/* pthread_key destructor. The counters are kept, they are still needed for
+ * the totals. */
+static void hot_stats_orphan(void *arg) /* {{{ */
+{
+  hot_stats_t *hs = arg;
+
+  pthread_mutex_lock(&hot_stats_lock);
+  hs->orphaned = true;
+  pthread_mutex_unlock(&hot_stats_lock);
+} /* }}} void hot_stats_orphan */
+
+static void hot_stats_key_create(void) /* {{{ */
+{
+  if (pthread_key_create(&hot_stats_key, hot_stats_orphan) != 0)
+    ERROR("plugin: pthread_key_create failed.");
+} /* }}} void hot_stats_key_create */
+
+/* Returns the counters of the calling thread, or NULL on failure. */
+static hot_stats_t *hot_stats_get(void) /* {{{ */
+{
+  pthread_once(&hot_stats_once, hot_stats_key_create);
+
+  hot_stats_t *hs = pthread_getspecific(hot_stats_key);
+  if (hs != NULL)
+    return hs;
+
+  pthread_mutex_lock(&hot_stats_lock);
+  for (hot_stats_t *o = hot_stats_list; o != NULL; o = o->next) {
+    if (o->orphaned) {
+      o->orphaned = false;
+      hs = o;
+      break;
+    }
+  }
+
+  if (hs == NULL) {
+    hs = calloc(1, sizeof(*hs));
+    if (hs == NULL) {
+      pthread_mutex_unlock(&hot_stats_lock);
+      ERROR("plugin: hot_stats_get: calloc failed.");
+      return NULL;
+    }
+    pthread_mutex_init(&hs->lock, /* attr = */ NULL);
+    hs->next = hot_stats_list;
+    hot_stats_list = hs;
+  }
+  pthread_mutex_unlock(&hot_stats_lock);
+
+  pthread_setspecific(hot_stats_key, hs);
+  return hs;
+} /* }}} hot_stats_t *hot_stats_get */
+
+/* Adds the calls and times in `add' to the stage counters. */
+static void stage_counters_add(stage_counter_t const *add) /* {{{ */
+{
+  for (size_t i = 0; i < STAGE_NUM; i++) {
+    shard_counter_add(stage_calls + i, add[i].calls);
+    shard_counter_add(stage_time + i, add[i].time);
+  }
+} /* }}} void stage_counters_add */
+
+/* Returns the counter of `name' in `hs', adding it if necessary. Must be
+ * called with `hs->lock' held. */
+static plugin_counter_t *hot_stats_plugin(hot_stats_t *hs, /* {{{ */
+                                          char const *name) {
+  if ((hs->plugins_last < hs->plugins_num) &&
+      (strcmp(name, hs->plugins[hs->plugins_last].name) == 0))
+    return hs->plugins + hs->plugins_last;
+
+  for (size_t i = 0; i < hs->plugins_num; i++) {
+    if (strcmp(name, hs->plugins[i].name) == 0) {
+      hs->plugins_last = i;
+      return hs->plugins + i;
+    }
+  }
+
+  plugin_counter_t *tmp =
+      realloc(hs->plugins, (hs->plugins_num + 1) * sizeof(*hs->plugins));
+  if (tmp == NULL)
+    return NULL;
+  hs->plugins = tmp;
+
+  plugin_counter_t *pc = hs->plugins + hs->plugins_num;
+  memset(pc, 0, sizeof(*pc));
+  sstrncpy(pc->name, name, sizeof(pc->name));
+  hs->plugins_last = hs->plugins_num;
+  hs->plugins_num++;
+  return pc;
+} /* }}} plugin_counter_t *hot_stats_plugin */
+
+/* Counts values dispatched by the plugin of the calling thread's context. */
+static void hot_stats_add_values(uint64_t values, /* {{{ */
+                                 uint64_t allocations) {
+  hot_stats_t *hs = hot_stats_get();
+  if (hs == NULL)
+    return;
+
+  char const *name = plugin_get_ctx().name;
+  if (name == NULL)
+    name = "unknown";
+
+  pthread_mutex_lock(&hs->lock);
+  plugin_counter_t *pc = hot_stats_plugin(hs, name);
+  if (pc != NULL) {
+    pc->values += values;
+    pc->allocations += allocations;
+  }
+  pthread_mutex_unlock(&hs->lock);
+} /* }}} void hot_stats_add_values */
+
+/* Sums up the per plugin counters of all threads. The totals are returned in
+ * `*ret_plugins', which the caller must free. */
+static int hot_stats_collect(plugin_counter_t **ret_plugins, /* {{{ */
+                             size_t *ret_plugins_num) {
+  plugin_counter_t *plugins = NULL;
+  size_t plugins_num = 0;
+  int status = 0;
+
+  pthread_mutex_lock(&hot_stats_lock);
+  for (hot_stats_t *hs = hot_stats_list; hs != NULL; hs = hs->next) {
+    pthread_mutex_lock(&hs->lock);
+    for (size_t i = 0; (i < hs->plugins_num) && (status == 0); i++) {
+      plugin_counter_t const *src = hs->plugins + i;
+      size_t j;
+
+      for (j = 0; j < plugins_num; j++)
+        if (strcmp(src->name, plugins[j].name) == 0)
+          break;
+
+      if (j == plugins_num) {
+        plugin_counter_t *tmp =
+            realloc(plugins, (plugins_num + 1) * sizeof(*plugins));
+        if (tmp == NULL) {
+          status = ENOMEM;
+          break;
+        }
+        plugins = tmp;
+        memset(plugins + j, 0, sizeof(*plugins));
+        sstrncpy(plugins[j].name, src->name, sizeof(plugins[j].name));
+        plugins_num++;
+      }
+
+      plugins[j].values += src->values;
+      plugins[j].allocations += src->allocations;
+    }
+    pthread_mutex_unlock(&hs->lock);
+  }
+  pthread_mutex_unlock(&hot_stats_lock);
+
+  if (status != 0) {
+    ERROR("plugin: hot_stats_collect: realloc failed.");
+    sfree(plugins);
+    return status;
+  }
+
+  *ret_plugins = plugins;
+  *ret_plugins_num = plugins_num;
+  return 0;
+} /* }}} int hot_stats_collect */
+
+static void plugin_dispatch_hot_stats(value_list_t *vl) /* {{{ */
+{
+  plugin_counter_t *plugins = NULL;
+  size_t plugins_num = 0;
+
+  if (hot_stats_collect(&plugins, &plugins_num) != 0)
+    return;
+
+  vl->values_len = 1;
+
+  sstrncpy(vl->plugin_instance, "stage", sizeof(vl->plugin_instance));
+  for (size_t i = 0; i < STAGE_NUM; i++) {
+    sstrncpy(vl->type, "total_time_in_ms", sizeof(vl->type));
+    sstrncpy(vl->type_instance, stage_names[i], sizeof(vl->type_instance));
+    cdtime_t time = (cdtime_t)shard_counter_get(stage_time + i);
+    vl->values = &(value_t){.derive = (derive_t)CDTIME_T_TO_MS(time)};
+    plugin_dispatch_values(vl);
+
+    sstrncpy(vl->type, "derive", sizeof(vl->type));
+    snprintf(vl->type_instance, sizeof(vl->type_instance), "%s-calls",
+             stage_names[i]);
+    vl->values =
+        &(value_t){.derive = (derive_t)shard_counter_get(stage_calls + i)};
+    plugin_dispatch_values(vl);
+  }
+
+  sstrncpy(vl->plugin_instance, "dispatch", sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, "derive", sizeof(vl->type));
+  for (size_t i = 0; i < plugins_num; i++) {
+    snprintf(vl->type_instance, sizeof(vl->type_instance), "%s-values",
+             plugins[i].name);
+    vl->values = &(value_t){.derive = (derive_t)plugins[i].values};
+    plugin_dispatch_values(vl);
+
+    snprintf(vl->type_instance, sizeof(vl->type_instance), "%s-allocations",
+             plugins[i].name);
+    vl->values = &(value_t){.derive = (derive_t)plugins[i].allocations};
+    plugin_dispatch_values(vl);
+  }
+
+  sfree(plugins);
+} /* }}} void plugin_dispatch_hot_stats */
+
 static int plugin_update_internal_statistics(void) { /* {{{ */
-  gauge_t copy_write_queue_length = (gauge_t)write_queue_length;
+  gauge_t copy_write_queue_length = (gauge_t)plugin_write_queue_length();
 
   /* Initialize `vl' */
   value_list_t vl = VALUE_LIST_INIT;
@@ -180,13 +860,114 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
-  /* Write queue : Values dropped (queue length > low limit) */
-  vl.values = &(value_t){.gauge = (gauge_t)stats_values_dropped};
-  vl.values_len = 1;
+  /* Write queue : Values dropped (queue length > low limit), in total and
+   * by write priority */
+  derive_t dropped_total = 0;
   sstrncpy(vl.type, "derive", sizeof(vl.type));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(stats_values_dropped); i++) {
+    derive_t dropped = (derive_t)shard_counter_get(stats_values_dropped + i);
+    dropped_total += dropped;
+
+    vl.values = &(value_t){.derive = dropped};
+    vl.values_len = 1;
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "dropped-%s",
+             write_priority_names[i]);
+    plugin_dispatch_values(&vl);
+  }
+
+  vl.values = &(value_t){.derive = dropped_total};
+  vl.values_len = 1;
   sstrncpy(vl.type_instance, "dropped", sizeof(vl.type_instance));
   plugin_dispatch_values(&vl);
 
+  /* Write queue : Length and values dropped per write callback with its own
+   * queue */
+  llist_t *write_lists[] = {list_write, list_write_batch};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(write_lists); i++) {
+    for (llentry_t *le = llist_head(write_lists[i]); le != NULL;
+         le = le->next) {
+      callback_func_t *cf = le->value;
+      long length = 0;
+      uint64_t dropped = 0;
+
+      if (cf->cf_pool == NULL)
+        continue;
+      write_pool_stats(cf->cf_pool, &length, &dropped);
+
+      vl.values = &(value_t){.gauge = (gauge_t)length};
+      sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+      sstrncpy(vl.type_instance, le->key, sizeof(vl.type_instance));
+      plugin_dispatch_values(&vl);
+
+      vl.values = &(value_t){.derive = (derive_t)dropped};
+      sstrncpy(vl.type, "derive", sizeof(vl.type));
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-dropped",
+               le->key);
+      plugin_dispatch_values(&vl);
+    }
+  }
+
+  /* Notification queues : Length and notifications dropped per notification
+   * callback with its own queue */
+  sstrncpy(vl.plugin_instance, "notification_queue",
+           sizeof(vl.plugin_instance));
+  llist_t *notification_lists[] = {list_notification, list_notification_batch};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(notification_lists); i++) {
+    for (llentry_t *le = llist_head(notification_lists[i]); le != NULL;
+         le = le->next) {
+      callback_func_t *cf = le->value;
+      long length = 0;
+      uint64_t dropped = 0;
+
+      /* Not dispatching values under the lock: they may cause
+       * notifications. */
+      pthread_rwlock_rdlock(&notification_queue_lock);
+      bool queued = (cf->cf_nqueue != NULL);
+      if (queued)
+        notification_queue_stats(cf->cf_nqueue, &length, &dropped);
+      pthread_rwlock_unlock(&notification_queue_lock);
+      if (!queued)
+        continue;
+
+      vl.values = &(value_t){.gauge = (gauge_t)length};
+      sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+      sstrncpy(vl.type_instance, le->key, sizeof(vl.type_instance));
+      plugin_dispatch_values(&vl);
+
+      vl.values = &(value_t){.derive = (derive_t)dropped};
+      sstrncpy(vl.type, "derive", sizeof(vl.type));
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-dropped",
+               le->key);
+      plugin_dispatch_values(&vl);
+    }
+  }
+
+  /* Threads : Read and write threads in use, and how often the thread scaler
+   * changed their number */
+  sstrncpy(vl.plugin_instance, "threads", sizeof(vl.plugin_instance));
+  char const *pool_names[] = {"read", "write"};
+  size_t *pool_sizes[] = {&read_threads_active, &write_threads_active};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(pool_names); i++) {
+    vl.values = &(value_t){
+        .gauge = (gauge_t)__atomic_load_n(pool_sizes[i], __ATOMIC_RELAXED)};
+    sstrncpy(vl.type, "threads", sizeof(vl.type));
+    sstrncpy(vl.type_instance, pool_names[i], sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    sstrncpy(vl.type, "derive", sizeof(vl.type));
+    vl.values = &(value_t){
+        .derive = (derive_t)__atomic_load_n(scaler_grown + i, __ATOMIC_RELAXED)};
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-grown",
+             pool_names[i]);
+    plugin_dispatch_values(&vl);
+
+    vl.values = &(value_t){.derive = (derive_t)__atomic_load_n(
+                               scaler_shrunk + i, __ATOMIC_RELAXED)};
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-shrunk",
+             pool_names[i]);
+    plugin_dispatch_values(&vl);
+  }
+
   /* Cache */
   sstrncpy(vl.plugin_instance, "cache", sizeof(vl.plugin_instance));
 
@@ -197,6 +978,79 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
+  /* Cache : Nb of interned identifiers */
+  vl.values = &(value_t){.gauge = (gauge_t)ident_count()};
+  vl.values_len = 1;
+  sstrncpy(vl.type_instance, "identifiers", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Cache : Values not newer than their entry */
+  uint64_t late = 0;
+  uint64_t too_old = 0;
+  uc_get_late_stats(&late, &too_old);
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  vl.values = &(value_t){.derive = (derive_t)late};
+  sstrncpy(vl.type_instance, "late", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+  vl.values = &(value_t){.derive = (derive_t)too_old};
+  sstrncpy(vl.type_instance, "too_old", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Allocator pools */
+  struct {
+    char const *name;
+    uint64_t hits;
+    uint64_t misses;
+  } pools[] = {{"write_queue"}, {"value_list"}, {"meta_data"}};
+  c_pool_stats(write_queue_pool, &pools[0].hits, &pools[0].misses);
+  c_pool_stats(value_list_pool, &pools[1].hits, &pools[1].misses);
+  meta_data_pool_stats(&pools[2].hits, &pools[2].misses);
+
+  sstrncpy(vl.plugin_instance, "pool", sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, "cache_result", sizeof(vl.type));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(pools); i++) {
+    vl.values = &(value_t){.derive = (derive_t)pools[i].hits};
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-hit",
+             pools[i].name);
+    plugin_dispatch_values(&vl);
+
+    vl.values = &(value_t){.derive = (derive_t)pools[i].misses};
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-miss",
+             pools[i].name);
+    plugin_dispatch_values(&vl);
+  }
+
+  /* Dispatch path : Time per stage, values and allocations per plugin */
+  plugin_dispatch_hot_stats(&vl);
+
+  /* Callbacks : Durations, overruns and scheduling delays */
+  size_t snapshots_num = 0;
+  callback_snapshot_t *snapshots;
+
+  pthread_mutex_lock(&read_lock);
+  snapshots = callback_stats_collect(read_list, /* is_read = */ true,
+                                     &snapshots_num);
+  pthread_mutex_unlock(&read_lock);
+  plugin_dispatch_callback_stats(&vl, "read", snapshots, snapshots_num,
+                                 /* is_read = */ true);
+  sfree(snapshots);
+
+  struct {
+    char const *kind;
+    llist_t *list;
+  } lists[] = {
+      {"write", list_write},
+      {"write", list_write_batch},
+      {"flush", list_flush},
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    snapshots = callback_stats_collect(lists[i].list, /* is_read = */ false,
+                                       &snapshots_num);
+    plugin_dispatch_callback_stats(&vl, lists[i].kind, snapshots,
+                                   snapshots_num, /* is_read = */ false);
+    sfree(snapshots);
+  }
+
   return 0;
 } /* }}} int plugin_update_internal_statistics */
 
@@ -210,11 +1064,83 @@ static void free_userdata(user_data_t const *ud) /* {{{ */
   }
 } /* }}} void free_userdata */
 
+/* Allocates the statistics of `cf' if `CollectInternalStats' is enabled. Must
+ * be called before the callback can be called by other threads. */
+static void callback_stats_init(callback_func_t *cf) /* {{{ */
+{
+  if (!record_statistics || (cf == NULL) || (cf->cf_stats != NULL))
+    return;
+
+  callback_stats_t *cs = calloc(1, sizeof(*cs));
+  if (cs == NULL) {
+    ERROR("plugin: callback_stats_init: calloc failed.");
+    return;
+  }
+
+  cs->duration = latency_counter_create_concurrent(CALLBACK_STATS_ACCURACY);
+  if (cs->duration == NULL) {
+    ERROR("plugin: callback_stats_init: latency_counter_create_concurrent "
+          "failed.");
+    sfree(cs);
+    return;
+  }
+  pthread_mutex_init(&cs->lock, /* attr = */ NULL);
+
+  cf->cf_stats = cs;
+} /* }}} void callback_stats_init */
+
+static void callback_stats_init_all(llist_t *list) /* {{{ */
+{
+  for (llentry_t *le = llist_head(list); le != NULL; le = le->next)
+    callback_stats_init(le->value);
+} /* }}} void callback_stats_init_all */
+
+static void callback_stats_destroy(callback_stats_t *cs) /* {{{ */
+{
+  if (cs == NULL)
+    return;
+
+  latency_counter_destroy(cs->duration);
+  pthread_mutex_destroy(&cs->lock);
+  sfree(cs);
+} /* }}} void callback_stats_destroy */
+
+static void callback_stats_add(callback_func_t *cf, /* {{{ */
+                               cdtime_t duration, bool overrun) {
+  callback_stats_t *cs = cf->cf_stats;
+
+  if (cs == NULL)
+    return;
+
+  latency_counter_add(cs->duration, duration);
+  if (overrun)
+    __atomic_fetch_add(&cs->overruns, 1, __ATOMIC_RELAXED);
+} /* }}} void callback_stats_add */
+
+/* Returns the start time of a call to `cf', or zero if it isn't timed. */
+static cdtime_t callback_stats_start(callback_func_t const *cf) /* {{{ */
+{
+  return (cf->cf_stats != NULL) ? cdtime() : 0;
+} /* }}} cdtime_t callback_stats_start */
+
+static void callback_stats_end(callback_func_t *cf, cdtime_t start) /* {{{ */
+{
+  if (cf->cf_stats != NULL)
+    callback_stats_add(cf, cdtime() - start, /* overrun = */ false);
+} /* }}} void callback_stats_end */
+
 static void destroy_callback(callback_func_t *cf) /* {{{ */
 {
   if (cf == NULL)
     return;
+  /* Stops writing and replaying values before the user data is freed. The
+   * pool's threads may still spool values. */
+  write_pool_destroy(cf->cf_pool);
+  write_spool_destroy(cf->cf_spool);
+  write_pending_destroy(cf->cf_pending);
+  notification_queue_destroy(cf->cf_nqueue);
   free_userdata(&cf->cf_udata);
+  callback_stats_destroy(cf->cf_stats);
   sfree(cf);
 } /* }}} void destroy_callback */
 
@@ -242,6 +1168,181 @@ static void destroy_all_callbacks(llist_t **list) /* {{{ */
   *list = NULL;
 } /* }}} void destroy_all_callbacks */
 
+static void write_reader_key_create(void) /* {{{ */
+{
+  if (pthread_key_create(&write_reader_key, /* destructor = */ NULL) != 0)
+    ERROR("plugin: pthread_key_create failed.");
+} /* }}} void write_reader_key_create */
+
+/* Enters a read section and returns the current snapshot, which may be NULL.
+ * Read sections may be nested. */
+static write_snapshot_t *write_snapshot_enter(void) /* {{{ */
+{
+  pthread_once(&write_reader_once, write_reader_key_create);
+
+  uintptr_t state = (uintptr_t)pthread_getspecific(write_reader_key);
+  if (state < 2) {
+    uintptr_t parity = __atomic_load_n(&write_epoch, __ATOMIC_RELAXED) & 1;
+    shard_counter_add(write_readers + parity, 1);
+    /* Pairs with the fence in write_snapshot_synchronize(): either the
+     * writer sees this reader or this reader sees the new snapshot. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    state = parity;
+  }
+  pthread_setspecific(write_reader_key, (void *)(state + 2));
+
+  return __atomic_load_n(&write_snapshot, __ATOMIC_ACQUIRE);
+} /* }}} write_snapshot_t *write_snapshot_enter */
+
+static void write_snapshot_leave(void) /* {{{ */
+{
+  uintptr_t state = (uintptr_t)pthread_getspecific(write_reader_key) - 2;
+  pthread_setspecific(write_reader_key, (void *)state);
+  if (state >= 2)
+    return;
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  shard_counter_sub(write_readers + state, 1);
+} /* }}} void write_snapshot_leave */
+
+/* Returns true if the calling thread is in a read section. */
+static bool write_snapshot_reading(void) /* {{{ */
+{
+  pthread_once(&write_reader_once, write_reader_key_create);
+  return (uintptr_t)pthread_getspecific(write_reader_key) >= 2;
+} /* }}} bool write_snapshot_reading */
+
+/* Waits until all read sections entered before have been left. */
+static void write_snapshot_synchronize(void) /* {{{ */
+{
+  for (int i = 0; i < 2; i++) {
+    uint64_t epoch = __atomic_fetch_add(&write_epoch, 1, __ATOMIC_SEQ_CST);
+    shard_counter_t *readers = write_readers + (epoch & 1);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (shard_counter_get(readers) != 0) {
+      struct timespec ts = {.tv_nsec = 100000};
+      nanosleep(&ts, NULL);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  }
+} /* }}} void write_snapshot_synchronize */
+
+static void write_retired_free(write_retired_t *r) /* {{{ */
+{
+  while (r != NULL) {
+    write_retired_t *next = r->next;
+
+    free(r->snapshot);
+    if (r->le != NULL) {
+      sfree(r->le->key);
+      destroy_callback(r->le->value);
+      llentry_destroy(r->le);
+    }
+    destroy_callback(r->cf);
+    free(r);
+
+    r = next;
+  }
+} /* }}} void write_retired_free */
+
+/* Frees what has been retired unless the calling thread is reading, e.g. a
+ * write callback unregistered a callback. Then it's freed with the next
+ * change. Must be called without `register_lock', which readers may need. */
+static void write_retired_reclaim(void) /* {{{ */
+{
+  if (write_snapshot_reading())
+    return;
+
+  pthread_mutex_lock(&register_lock);
+  write_retired_t *r = write_retired;
+  write_retired = NULL;
+  pthread_mutex_unlock(&register_lock);
+
+  if (r == NULL)
+    return;
+
+  write_snapshot_synchronize();
+  write_retired_free(r);
+} /* }}} void write_retired_reclaim */
+
+/* Retires the llist entry `le' or the callback `cf' together with the current
+ * snapshot. Must be called with `register_lock' held. */
+static void write_retire(write_snapshot_t *snapshot, llentry_t *le, /* {{{ */
+                         callback_func_t *cf) {
+  if ((snapshot == NULL) && (le == NULL) && (cf == NULL))
+    return;
+
+  write_retired_t *r = calloc(1, sizeof(*r));
+  if (r == NULL) {
+    /* Leaking is better than freeing memory still in use. */
+    ERROR("plugin: write_retire: calloc failed.");
+    return;
+  }
+  r->snapshot = snapshot;
+  r->le = le;
+  r->cf = cf;
+  r->next = write_retired;
+  write_retired = r;
+} /* }}} void write_retire */
+
+/* Publishes a snapshot of the write callbacks' lists and retires the old one
+ * as well as `le' or `cf', which have been removed from the lists. Must be
+ * called with `register_lock' held, followed by write_retired_reclaim(). */
+static void write_snapshot_update(llentry_t *le, callback_func_t *cf) /* {{{ */
+{
+  size_t num = (size_t)(llist_size(list_write) + llist_size(list_write_batch));
+
+  write_snapshot_t *snapshot =
+      calloc(1, sizeof(*snapshot) + num * sizeof(snapshot->entries[0]));
+  if (snapshot == NULL) {
+    /* Keep the old snapshot and what it refers to. */
+    ERROR("plugin: write_snapshot_update: calloc failed.");
+    write_retire(NULL, le, cf);
+    return;
+  }
+
+  snapshot->generation = ++write_snapshot_generation;
+  llist_t *lists[] = {list_write, list_write_batch};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    for (llentry_t *e = llist_head(lists[i]); e != NULL; e = e->next) {
+      snapshot->entries[snapshot->num++] = (write_entry_t){
+          .name = e->key, .cf = e->value, .batch = (i == 1),
+      };
+    }
+  }
+
+  write_snapshot_t *old =
+      __atomic_exchange_n(&write_snapshot, snapshot, __ATOMIC_SEQ_CST);
+  write_retire(old, le, cf);
+} /* }}} void write_snapshot_update */
+
+/* Frees the snapshot and everything retired. Only called on shutdown, when
+ * nothing writes anymore. */
+static void write_snapshot_destroy(void) /* {{{ */
+{
+  pthread_mutex_lock(&register_lock);
+  free(write_snapshot);
+  write_snapshot = NULL;
+  write_retired_t *r = write_retired;
+  write_retired = NULL;
+  pthread_mutex_unlock(&register_lock);
+
+  write_retired_free(r);
+} /* }}} void write_snapshot_destroy */
+
+static write_entry_t const * /* {{{ */
+write_snapshot_find(write_snapshot_t const *snapshot, char const *name) {
+  if (snapshot == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < snapshot->num; i++)
+    if (strcasecmp(name, snapshot->entries[i].name) == 0)
+      return snapshot->entries + i;
+
+  return NULL;
+} /* }}} write_entry_t const *write_snapshot_find */
+
 static void destroy_read_heap(void) /* {{{ */
 {
   if (read_heap == NULL)
@@ -283,6 +1384,10 @@ static int register_callback(llist_t **list, /* {{{ */
     return -1;
   }
 
+  if ((list == &list_write) || (list == &list_write_batch) ||
+      (list == &list_flush))
+    callback_stats_init(cf);
+
   le = llist_search(*list, name);
   if (le == NULL) {
     le = llentry_create(key, cf);
@@ -295,6 +1400,8 @@ static int register_callback(llist_t **list, /* {{{ */
     }
 
     llist_append(*list, le);
+    if ((list == &list_write) || (list == &list_write_batch))
+      write_snapshot_update(/* le = */ NULL, /* cf = */ NULL);
   } else {
     callback_func_t *old_cf;
 
@@ -306,7 +1413,10 @@ static int register_callback(llist_t **list, /* {{{ */
               "overwriting the old entry!",
               name);
 
-    destroy_callback(old_cf);
+    if ((list == &list_write) || (list == &list_write_batch))
+      write_snapshot_update(/* le = */ NULL, old_cf);
+    else
+      destroy_callback(old_cf);
     sfree(key);
   }
 
@@ -374,7 +1484,10 @@ static int create_register_callback(llist_t **list, /* {{{ */
 
   cf->cf_ctx = plugin_get_ctx();
 
-  return register_callback(list, name, cf);
+  pthread_mutex_lock(&register_lock);
+  int status = register_callback(list, name, cf);
+  pthread_mutex_unlock(&register_lock);
+  return status;
 } /* }}} int create_register_callback */
 
 static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
@@ -384,12 +1497,24 @@ static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
   if (list == NULL)
     return -1;
 
+  pthread_mutex_lock(&register_lock);
   e = llist_search(list, name);
-  if (e == NULL)
+  if (e == NULL) {
+    pthread_mutex_unlock(&register_lock);
     return -1;
+  }
 
   llist_remove(list, e);
 
+  if ((list == list_write) || (list == list_write_batch)) {
+    /* Write callbacks are freed once no thread is writing with them. */
+    write_snapshot_update(e, /* cf = */ NULL);
+    pthread_mutex_unlock(&register_lock);
+    write_retired_reclaim();
+    return 0;
+  }
+  pthread_mutex_unlock(&register_lock);
+
   sfree(e->key);
   destroy_callback(e->value);
 
@@ -439,155 +1564,328 @@ static int plugin_load_file(char const *file, bool global) {
   return 0;
 }
 
-static void *plugin_read_thread(void __attribute__((unused)) * args) {
-  while (read_loop != 0) {
-    read_func_t *rf;
-    plugin_ctx_t old_ctx;
-    cdtime_t start;
-    cdtime_t now;
-    cdtime_t elapsed;
-    int status;
-    int rf_type;
-    int rc;
-
-    /* Get the read function that needs to be read next.
-     * We don't need to hold "read_lock" for the heap, but we need
-     * to call c_heap_get_root() and pthread_cond_wait() in the
-     * same protected block. */
-    pthread_mutex_lock(&read_lock);
-    rf = c_heap_get_root(read_heap);
-    if (rf == NULL) {
-      pthread_cond_wait(&read_cond, &read_lock);
-      pthread_mutex_unlock(&read_lock);
-      continue;
-    }
-    pthread_mutex_unlock(&read_lock);
+static int plugin_compare_read_func(const void *arg0, const void *arg1) {
+  const read_func_t *rf0;
+  const read_func_t *rf1;
 
-    if (rf->rf_interval == 0) {
-      /* this should not happen, because the interval is set
-       * for each plugin when loading it
-       * XXX: issue a warning? */
-      rf->rf_interval = plugin_get_interval();
-      rf->rf_effective_interval = rf->rf_interval;
+  rf0 = arg0;
+  rf1 = arg1;
 
-      rf->rf_next_read = cdtime();
-    }
+  if (rf0->rf_next_read < rf1->rf_next_read)
+    return -1;
+  else if (rf0->rf_next_read > rf1->rf_next_read)
+    return 1;
+  else
+    return 0;
+} /* int plugin_compare_read_func */
 
-    /* sleep until this entry is due,
-     * using pthread_cond_timedwait */
-    pthread_mutex_lock(&read_lock);
-    /* In pthread_cond_timedwait, spurious wakeups are possible
-     * (and really happen, at least on NetBSD with > 1 CPU), thus
-     * we need to re-evaluate the condition every time
-     * pthread_cond_timedwait returns. */
-    rc = 0;
-    while ((read_loop != 0) && (cdtime() < rf->rf_next_read) && rc == 0) {
-      rc = pthread_cond_timedwait(&read_cond, &read_lock,
-                                  &CDTIME_T_TO_TIMESPEC(rf->rf_next_read));
-    }
-
-    /* Must hold `read_lock' when accessing `rf->rf_type'. */
-    rf_type = rf->rf_type;
-    pthread_mutex_unlock(&read_lock);
+/* Pops the root of `shard' if it is due at `now'. If `busy' is set, the shard
+ * must be marked as busy. */
+static read_func_t *read_shard_pop_due(read_shard_t *shard, /* {{{ */
+                                       cdtime_t now, bool busy) {
+  read_func_t *rf = c_heap_peek_root(shard->heap);
 
-    /* Check if we're supposed to stop.. This may have interrupted
-     * the sleep, too. */
-    if (read_loop == 0) {
-      /* Insert `rf' again, so it can be free'd correctly */
-      c_heap_insert(read_heap, rf);
-      break;
-    }
+  if ((rf == NULL) || (rf->rf_next_read > now))
+    return NULL;
+  if (busy && !shard->busy)
+    return NULL;
 
-    /* The entry has been marked for deletion. The linked list
-     * entry has already been removed by `plugin_unregister_read'.
-     * All we have to do here is free the `read_func_t' and
-     * continue. */
-    if (rf_type == RF_REMOVE) {
-      DEBUG("plugin_read_thread: Destroying the `%s' "
-            "callback.",
-            rf->rf_name);
-      sfree(rf->rf_name);
-      destroy_callback((callback_func_t *)rf);
-      rf = NULL;
-      continue;
-    }
+  return c_heap_get_root(shard->heap);
+} /* }}} read_func_t *read_shard_pop_due */
 
-    DEBUG("plugin_read_thread: Handling `%s'.", rf->rf_name);
+/* Steals a function that is due from a shard whose owner is busy. Shards that
+ * are locked by someone else are skipped. */
+static read_func_t *plugin_read_steal(size_t self, cdtime_t now) /* {{{ */
+{
+  for (size_t i = 1; i < read_shards_num; i++) {
+    read_shard_t *shard = read_shards + ((self + i) % read_shards_num);
 
-    start = cdtime();
+    if (pthread_mutex_trylock(&shard->lock) != 0)
+      continue;
+    read_func_t *rf = read_shard_pop_due(shard, now, /* busy = */ true);
+    pthread_mutex_unlock(&shard->lock);
 
-    old_ctx = plugin_set_ctx(rf->rf_ctx);
+    if (rf != NULL)
+      return rf;
+  }
 
-    if (rf_type == RF_SIMPLE) {
-      int (*callback)(void);
+  return NULL;
+} /* }}} read_func_t *plugin_read_steal */
 
-      callback = rf->rf_callback;
-      status = (*callback)();
-    } else {
-      plugin_read_cb callback;
+/* Sleeps until the next function of this thread's shard, or of a busy shard,
+ * is due, or until kicked. */
+static void plugin_read_wait(size_t self) /* {{{ */
+{
+  read_shard_t *own = read_shards + self;
+  cdtime_t deadline = 0;
 
-      assert(rf_type == RF_COMPLEX);
+  for (size_t i = 0; i < read_shards_num; i++) {
+    read_shard_t *shard = read_shards + i;
 
-      callback = rf->rf_callback;
-      status = (*callback)(&rf->rf_udata);
+    pthread_mutex_lock(&shard->lock);
+    if ((shard == own) || shard->busy) {
+      read_func_t *rf = c_heap_peek_root(shard->heap);
+      if ((rf != NULL) && ((deadline == 0) || (rf->rf_next_read < deadline)))
+        deadline = rf->rf_next_read;
     }
+    pthread_mutex_unlock(&shard->lock);
+  }
 
-    plugin_set_ctx(old_ctx);
+  pthread_mutex_lock(&own->lock);
+  /* In pthread_cond_timedwait, spurious wakeups are possible (and really
+   * happen, at least on NetBSD with > 1 CPU). Returning early only makes the
+   * caller look around once more. */
+  if ((read_loop != 0) && !own->kicked) {
+    if (deadline == 0)
+      pthread_cond_wait(&own->cond, &own->lock);
+    else if (deadline > cdtime())
+      pthread_cond_timedwait(&own->cond, &own->lock,
+                             &CDTIME_T_TO_TIMESPEC(deadline));
+  }
+  own->kicked = false;
+  pthread_mutex_unlock(&own->lock);
+} /* }}} void plugin_read_wait */
 
-    /* If the function signals failure, we will increase the
-     * intervals in which it will be called. */
-    if (status != 0) {
-      rf->rf_effective_interval *= 2;
-      if (rf->rf_effective_interval > max_read_interval)
-        rf->rf_effective_interval = max_read_interval;
+static void read_shard_kick(read_shard_t *shard) /* {{{ */
+{
+  pthread_mutex_lock(&shard->lock);
+  shard->kicked = true;
+  pthread_cond_signal(&shard->cond);
+  pthread_mutex_unlock(&shard->lock);
+} /* }}} void read_shard_kick */
+
+/* Runs `rf' and inserts it into the shard of thread `self' afterwards. */
+static void plugin_read_run(size_t self, read_func_t *rf) /* {{{ */
+{
+  read_shard_t *own = read_shards + self;
+  plugin_ctx_t old_ctx;
+  cdtime_t start;
+  cdtime_t now;
+  cdtime_t elapsed;
+  int status;
+  int rf_type;
 
-      NOTICE("read-function of plugin `%s' failed. "
-             "Will suspend it for %.3f seconds.",
-             rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
-    } else {
-      /* Success: Restore the interval, if it was changed. */
+  /* Let the next thread keep an eye on the functions waiting in this shard
+   * while this one is busy. */
+  pthread_mutex_lock(&own->lock);
+  own->busy = true;
+  bool waiting = (c_heap_peek_root(own->heap) != NULL);
+  pthread_mutex_unlock(&own->lock);
+  size_t active = __atomic_load_n(&read_threads_active, __ATOMIC_RELAXED);
+  if (waiting && (active > 1))
+    read_shard_kick(read_shards + ((self + 1) % active));
+
+  if (rf->rf_interval == 0) {
+    /* this should not happen, because the interval is set
+     * for each plugin when loading it
+     * XXX: issue a warning? */
+    rf->rf_interval = plugin_get_interval();
+    rf->rf_effective_interval = rf->rf_interval;
+
+    rf->rf_next_read = cdtime();
+  }
+
+  /* Must hold `read_lock' when accessing `rf->rf_type'. */
+  pthread_mutex_lock(&read_lock);
+  rf_type = rf->rf_type;
+  rf->rf_lag = cdtime() - rf->rf_next_read;
+  if (read_scaling && (rf->rf_effective_interval > 0)) {
+    double late = CDTIME_T_TO_DOUBLE(rf->rf_lag) /
+                  CDTIME_T_TO_DOUBLE(rf->rf_effective_interval);
+    if (late > read_late_max)
+      read_late_max = late;
+  }
+  pthread_mutex_unlock(&read_lock);
+
+  /* The entry has been marked for deletion. The linked list
+   * entry has already been removed by `plugin_unregister_read'.
+   * All we have to do here is free the `read_func_t' and
+   * continue. */
+  if (rf_type == RF_REMOVE) {
+    DEBUG("plugin_read_thread: Destroying the `%s' "
+          "callback.",
+          rf->rf_name);
+    sfree(rf->rf_name);
+    destroy_callback((callback_func_t *)rf);
+
+    pthread_mutex_lock(&own->lock);
+    own->busy = false;
+    pthread_mutex_unlock(&own->lock);
+    return;
+  }
+
+  DEBUG("plugin_read_thread: Handling `%s'.", rf->rf_name);
+
+  start = cdtime();
+
+  old_ctx = plugin_set_ctx(rf->rf_ctx);
+  if ((rf->rf_max_interval != 0) && read_func_key_initialized) {
+    rf->rf_changed = false;
+    pthread_setspecific(read_func_key, rf);
+  }
+  if (read_time_shared)
+    pthread_setspecific(read_time_key, &start);
+
+  if (rf_type == RF_SIMPLE) {
+    int (*callback)(void);
+
+    callback = rf->rf_callback;
+    status = (*callback)();
+  } else {
+    plugin_read_cb callback;
+
+    assert(rf_type == RF_COMPLEX);
+
+    callback = rf->rf_callback;
+    status = (*callback)(&rf->rf_udata);
+  }
+
+  if ((rf->rf_max_interval != 0) && read_func_key_initialized)
+    pthread_setspecific(read_func_key, NULL);
+  if (read_time_shared)
+    pthread_setspecific(read_time_key, NULL);
+  plugin_set_ctx(old_ctx);
+
+  /* If the function signals failure, we will increase the
+   * intervals in which it will be called. */
+  if (status != 0) {
+    rf->rf_effective_interval *= 2;
+    if (rf->rf_effective_interval > max_read_interval)
+      rf->rf_effective_interval = max_read_interval;
+
+    NOTICE("read-function of plugin `%s' failed. "
+           "Will suspend it for %.3f seconds.",
+           rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
+  } else if (rf->rf_max_interval != 0) {
+    /* Widen the interval while the values are stable and go back to the
+     * configured interval as soon as they change. The values are dispatched
+     * with the effective interval, so that they don't time out. */
+    if (rf->rf_changed || (rf->rf_effective_interval < rf->rf_interval))
       rf->rf_effective_interval = rf->rf_interval;
-    }
+    else if (rf->rf_effective_interval < rf->rf_max_interval)
+      rf->rf_effective_interval =
+          (2 * rf->rf_effective_interval < rf->rf_max_interval)
+              ? 2 * rf->rf_effective_interval
+              : rf->rf_max_interval;
+    rf->rf_ctx.interval = rf->rf_effective_interval;
+  } else {
+    /* Success: Restore the interval, if it was changed. */
+    rf->rf_effective_interval = rf->rf_interval;
+  }
 
-    /* update the ``next read due'' field */
-    now = cdtime();
+  /* update the ``next read due'' field */
+  now = cdtime();
 
-    /* calculate the time spent in the read function */
-    elapsed = (now - start);
+  /* calculate the time spent in the read function */
+  elapsed = (now - start);
 
-    if (elapsed > rf->rf_effective_interval)
-      WARNING(
-          "plugin_read_thread: read-function of the `%s' plugin took %.3f "
-          "seconds, which is above its read interval (%.3f seconds). You might "
-          "want to adjust the `Interval' or `ReadThreads' settings.",
-          rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed),
-          CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
+  callback_stats_add(&rf->rf_super, elapsed,
+                     /* overrun = */ elapsed > rf->rf_effective_interval);
 
-    DEBUG("plugin_read_thread: read-function of the `%s' plugin took "
-          "%.6f seconds.",
-          rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed));
+  if (read_scaling) {
+    pthread_mutex_lock(&read_lock);
+    read_busy_time += elapsed;
+    pthread_mutex_unlock(&read_lock);
+  }
 
-    DEBUG("plugin_read_thread: Effective interval of the "
-          "`%s' plugin is %.3f seconds.",
-          rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
+  if (elapsed > rf->rf_effective_interval)
+    WARNING(
+        "plugin_read_thread: read-function of the `%s' plugin took %.3f "
+        "seconds, which is above its read interval (%.3f seconds). You might "
+        "want to adjust the `Interval' or `ReadThreads' settings.",
+        rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed),
+        CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
+
+  DEBUG("plugin_read_thread: read-function of the `%s' plugin took "
+        "%.6f seconds.",
+        rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed));
+
+  DEBUG("plugin_read_thread: Effective interval of the "
+        "`%s' plugin is %.3f seconds.",
+        rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
+
+  /* Calculate the next (absolute) time at which this function
+   * should be called. */
+  rf->rf_next_read += rf->rf_effective_interval;
+
+  /* Check, if `rf_next_read' is in the past. */
+  if (rf->rf_next_read < now) {
+    /* `rf_next_read' is in the past. Insert `now'
+     * so this value doesn't trail off into the
+     * past too much. */
+    rf->rf_next_read = now;
+  }
 
-    /* Calculate the next (absolute) time at which this function
-     * should be called. */
-    rf->rf_next_read += rf->rf_effective_interval;
+  DEBUG("plugin_read_thread: Next read of the `%s' plugin at %.3f.",
+        rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_next_read));
 
-    /* Check, if `rf_next_read' is in the past. */
-    if (rf->rf_next_read < now) {
-      /* `rf_next_read' is in the past. Insert `now'
-       * so this value doesn't trail off into the
-       * past too much. */
-      rf->rf_next_read = now;
+  /* Re-insert this read function into the heap again. */
+  pthread_mutex_lock(&own->lock);
+  c_heap_insert(own->heap, rf);
+  own->busy = false;
+  pthread_mutex_unlock(&own->lock);
+} /* }}} void plugin_read_run */
+
+/* Hands the functions in the shard of the parked thread `self' to the active
+ * threads and sleeps until the pool grows again or the threads are stopped. */
+static void plugin_read_park(size_t self) /* {{{ */
+{
+  read_shard_t *own = read_shards + self;
+
+  pthread_mutex_lock(&read_lock);
+  size_t active = read_threads_active;
+  if (self < active) {
+    pthread_mutex_unlock(&read_lock);
+    return;
+  }
+
+  pthread_mutex_lock(&own->lock);
+  read_func_t *rf;
+  while ((rf = c_heap_get_root(own->heap)) != NULL) {
+    read_shard_t *shard = read_shards + (read_shard_next % active);
+    read_shard_next++;
+
+    pthread_mutex_lock(&shard->lock);
+    c_heap_insert(shard->heap, rf);
+    shard->kicked = true;
+    pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+  }
+  pthread_mutex_unlock(&read_lock);
+
+  /* The scaler changes `read_threads_active' before signalling `cond'. */
+  while ((read_loop != 0) &&
+         (self >= __atomic_load_n(&read_threads_active, __ATOMIC_RELAXED)))
+    pthread_cond_wait(&own->cond, &own->lock);
+  own->kicked = false;
+  pthread_mutex_unlock(&own->lock);
+} /* }}} void plugin_read_park */
+
+static void *plugin_read_thread(void *args) {
+  size_t self = (size_t)(uintptr_t)args;
+  read_shard_t *own = read_shards + self;
+
+  while (read_loop != 0) {
+    if (self >= __atomic_load_n(&read_threads_active, __ATOMIC_RELAXED)) {
+      plugin_read_park(self);
+      continue;
     }
 
-    DEBUG("plugin_read_thread: Next read of the `%s' plugin at %.3f.",
-          rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_next_read));
+    cdtime_t now = cdtime();
 
-    /* Re-insert this read function into the heap again. */
-    c_heap_insert(read_heap, rf);
+    pthread_mutex_lock(&own->lock);
+    read_func_t *rf = read_shard_pop_due(own, now, /* busy = */ false);
+    pthread_mutex_unlock(&own->lock);
+
+    if (rf == NULL)
+      rf = plugin_read_steal(self, now);
+
+    if (rf == NULL) {
+      plugin_read_wait(self);
+      continue;
+    }
+
+    plugin_read_run(self, rf);
   } /* while (read_loop) */
 
   pthread_exit(NULL);
@@ -622,35 +1920,113 @@ static void set_thread_name(pthread_t tid, char const *name) {
 #endif
 }
 
-static void start_read_threads(size_t num) /* {{{ */
+static void plugin_thread_bind(pthread_t thread, /* {{{ */
+                               affinity_set_t const *set, char const *name) {
+  int status = affinity_apply(thread, set);
+  if (status != 0)
+    WARNING("plugin: Binding %s to its CPUs failed: %s", name,
+            STRERROR(status));
+} /* }}} void plugin_thread_bind */
+
+/* Starts the thread owning read shard `read_threads_num'. Must be called
+ * with `read_lock' held. */
+static int start_read_thread(void) /* {{{ */
+{
+  size_t i = read_threads_num;
+
+  if (i >= read_shards_num)
+    return ENOSPC;
+
+  int status = pthread_create(read_threads + i, /* attr = */ NULL,
+                              plugin_read_thread,
+                              /* arg = */ (void *)(uintptr_t)i);
+  if (status != 0) {
+    ERROR("plugin: start_read_thread: pthread_create failed with status %i "
+          "(%s).",
+          status, STRERROR(status));
+    return status;
+  }
+
+  /* Only an absurd number of threads doesn't fit into the name. */
+  char name[THREAD_NAME_MAX];
+  int len = snprintf(name, sizeof(name), "reader#%" PRIu64, (uint64_t)i);
+  if ((len < 0) || ((size_t)len >= sizeof(name)))
+    sstrncpy(name, "reader", sizeof(name));
+  set_thread_name(read_threads[i], name);
+  if (read_affinity_set)
+    plugin_thread_bind(read_threads[i], &read_affinity, name);
+
+  read_threads_num++;
+  return 0;
+} /* }}} int start_read_thread */
+
+/* Starts `num' read threads. Shards are created for `max' threads, the number
+ * the thread scaler may grow the pool to. */
+static void start_read_threads(size_t num, size_t max) /* {{{ */
 {
   if (read_threads != NULL)
     return;
 
-  read_threads = calloc(num, sizeof(*read_threads));
-  if (read_threads == NULL) {
+  if (!read_func_key_initialized) {
+    pthread_key_create(&read_func_key, /* destructor = */ NULL);
+    read_func_key_initialized = true;
+  }
+  if (!read_time_key_initialized) {
+    pthread_key_create(&read_time_key, /* destructor = */ NULL);
+    read_time_key_initialized = true;
+  }
+  read_time_shared = IS_TRUE(global_option_get("ShareReadTimestamp"));
+
+  if (max < num)
+    max = num;
+
+  read_threads = calloc(max, sizeof(*read_threads));
+  read_shards = calloc(max, sizeof(*read_shards));
+  if ((read_threads == NULL) || (read_shards == NULL)) {
     ERROR("plugin: start_read_threads: calloc failed.");
+    sfree(read_threads);
+    sfree(read_shards);
     return;
   }
 
-  read_threads_num = 0;
-  for (size_t i = 0; i < num; i++) {
-    int status = pthread_create(read_threads + read_threads_num,
-                                /* attr = */ NULL, plugin_read_thread,
-                                /* arg = */ NULL);
-    if (status != 0) {
-      ERROR("plugin: start_read_threads: pthread_create failed with status %i "
-            "(%s).",
-            status, STRERROR(status));
-      return;
-    }
+  for (size_t i = 0; i < max; i++) {
+    read_shard_t *shard = read_shards + i;
 
-    char name[THREAD_NAME_MAX];
-    snprintf(name, sizeof(name), "reader#%" PRIu64, (uint64_t)read_threads_num);
-    set_thread_name(read_threads[read_threads_num], name);
+    pthread_mutex_init(&shard->lock, /* attr = */ NULL);
+    pthread_cond_init(&shard->cond, /* attr = */ NULL);
+    shard->heap = c_heap_create(plugin_compare_read_func);
+    if (shard->heap == NULL) {
+      ERROR("plugin: start_read_threads: c_heap_create failed.");
+      max = i;
+      break;
+    }
+  }
 
-    read_threads_num++;
-  } /* for (i) */
+  /* Set `read_threads_active' first, so the new threads don't park. */
+  pthread_mutex_lock(&read_lock);
+  read_shards_num = max;
+  read_threads_active = (num < max) ? num : max;
+  while ((read_threads_num < read_threads_active) &&
+         (start_read_thread() == 0))
+    ;
+  read_threads_active = read_threads_num;
+  read_threads_min = read_threads_num;
+  read_scaling = (read_threads_num > 0) && (read_shards_num > read_threads_num);
+
+  /* Hand the functions registered so far to the threads. From now on,
+   * plugin_insert_read adds new functions to the shards directly. */
+  read_func_t *rf;
+  while ((read_threads_active > 0) && (read_heap != NULL) &&
+         ((rf = c_heap_get_root(read_heap)) != NULL)) {
+    read_shard_t *shard = read_shards + (read_shard_next % read_threads_active);
+    read_shard_next++;
+
+    pthread_mutex_lock(&shard->lock);
+    c_heap_insert(shard->heap, rf);
+    pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+  }
+  pthread_mutex_unlock(&read_lock);
 } /* }}} void start_read_threads */
 
 static void stop_read_threads(void) {
@@ -661,8 +2037,12 @@ static void stop_read_threads(void) {
 
   pthread_mutex_lock(&read_lock);
   read_loop = 0;
-  DEBUG("plugin: stop_read_threads: Signalling `read_cond'");
-  pthread_cond_broadcast(&read_cond);
+  DEBUG("plugin: stop_read_threads: Signalling the read threads");
+  for (size_t i = 0; i < read_shards_num; i++) {
+    pthread_mutex_lock(&read_shards[i].lock);
+    pthread_cond_broadcast(&read_shards[i].cond);
+    pthread_mutex_unlock(&read_shards[i].lock);
+  }
   pthread_mutex_unlock(&read_lock);
 
   for (size_t i = 0; i < read_threads_num; i++) {
@@ -672,180 +2052,822 @@ static void stop_read_threads(void) {
     read_threads[i] = (pthread_t)0;
   }
   sfree(read_threads);
+
+  /* Move the functions back to `read_heap', so destroy_read_heap can free
+   * them. */
+  pthread_mutex_lock(&read_lock);
   read_threads_num = 0;
+  read_threads_active = 0;
+  read_scaling = false;
+  if (read_heap == NULL)
+    read_heap = c_heap_create(plugin_compare_read_func);
+  for (size_t i = 0; i < read_shards_num; i++) {
+    read_shard_t *shard = read_shards + i;
+    read_func_t *rf;
+
+    while ((rf = c_heap_get_root(shard->heap)) != NULL) {
+      if ((read_heap == NULL) || (c_heap_insert(read_heap, rf) != 0)) {
+        sfree(rf->rf_name);
+        destroy_callback((callback_func_t *)rf);
+      }
+    }
+    c_heap_destroy(shard->heap);
+    pthread_cond_destroy(&shard->cond);
+    pthread_mutex_destroy(&shard->lock);
+  }
+  sfree(read_shards);
+  read_shards_num = 0;
+  pthread_mutex_unlock(&read_lock);
 } /* void stop_read_threads */
 
-static void plugin_value_list_free(value_list_t *vl) /* {{{ */
-{
-  if (vl == NULL)
-    return;
+static void plugin_value_list_free(value_list_t *vl) /* {{{ */
+{
+  if (vl == NULL)
+    return;
+
+  meta_data_destroy(vl->meta);
+  ident_unref(vl->ident);
+  sfree(vl->values);
+  c_pool_free(value_list_pool, vl);
+} /* }}} void plugin_value_list_free */
+
+static void plugin_pools_init(void) /* {{{ */
+{
+  write_queue_pool =
+      c_pool_create(sizeof(write_queue_t), PLUGIN_POOL_CACHE_MAX);
+  value_list_pool = c_pool_create(sizeof(value_list_t), PLUGIN_POOL_CACHE_MAX);
+  if ((write_queue_pool == NULL) || (value_list_pool == NULL))
+    ERROR("plugin: c_pool_create failed.");
+} /* }}} void plugin_pools_init */
+
+/* Returns the time to use for a value list dispatched without one: the start
+ * time of the running read function with `ShareReadTimestamp', the current
+ * time otherwise. */
+static cdtime_t plugin_value_time(void) /* {{{ */
+{
+  if (read_time_shared) {
+    cdtime_t const *t = pthread_getspecific(read_time_key);
+    if (t != NULL)
+      return *t;
+  }
+  return cdtime();
+} /* }}} cdtime_t plugin_value_time */
+
+static value_list_t *
+plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
+{
+  value_list_t *vl;
+
+  if (vl_orig == NULL)
+    return NULL;
+
+  pthread_once(&plugin_pools_once, plugin_pools_init);
+  vl = c_pool_alloc(value_list_pool);
+  if (vl == NULL)
+    return NULL;
+  memcpy(vl, vl_orig, sizeof(*vl));
+  ident_ref(vl->ident);
+
+  if (vl->host[0] == 0)
+    sstrncpy(vl->host, hostname_g, sizeof(vl->host));
+
+  vl->values = calloc(vl_orig->values_len, sizeof(*vl->values));
+  if (vl->values == NULL) {
+    plugin_value_list_free(vl);
+    return NULL;
+  }
+  memcpy(vl->values, vl_orig->values,
+         vl_orig->values_len * sizeof(*vl->values));
+
+  vl->meta = meta_data_clone(vl->meta);
+  if ((vl_orig->meta != NULL) && (vl->meta == NULL)) {
+    plugin_value_list_free(vl);
+    return NULL;
+  }
+
+  if (vl->time == 0)
+    vl->time = plugin_value_time();
+
+  /* Fill in the interval from the thread context, if it is zero. */
+  if (vl->interval == 0)
+    vl->interval = plugin_get_interval();
+
+  return vl;
+} /* }}} value_list_t *plugin_value_list_clone */
+
+/* Creates `num' shards, of which the first `active' are used. */
+static int create_write_shards(size_t num, size_t active) /* {{{ */
+{
+  if (write_shards != NULL)
+    return 0;
+
+  write_shards = calloc(num, sizeof(*write_shards));
+  if (write_shards == NULL) {
+    ERROR("plugin: create_write_shards: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    pthread_mutex_init(&write_shards[i].lock, /* attr = */ NULL);
+    pthread_cond_init(&write_shards[i].cond, /* attr = */ NULL);
+  }
+  write_shards_num = num;
+  write_threads_active = active;
+
+  return 0;
+} /* }}} int create_write_shards */
+
+/* Frees all value lists still queued in the write shards and returns their
+ * number. */
+static size_t drain_write_shards(void) /* {{{ */
+{
+  size_t num = 0;
+
+  for (size_t i = 0; i < write_shards_num; i++) {
+    write_shard_t *shard = write_shards + i;
+
+    pthread_mutex_lock(&shard->lock);
+    for (write_queue_t *q = shard->head; q != NULL;) {
+      write_queue_t *q1 = q;
+      plugin_value_list_free(q->vl);
+      q = q->next;
+      c_pool_free(write_queue_pool, q1);
+      num++;
+    }
+    shard->head = NULL;
+    shard->tail = NULL;
+    shard->length = 0;
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return num;
+} /* }}} size_t drain_write_shards */
+
+static void destroy_write_shards(void) /* {{{ */
+{
+  if (write_shards == NULL)
+    return;
+
+  drain_write_shards();
+
+  for (size_t i = 0; i < write_shards_num; i++) {
+    pthread_mutex_destroy(&write_shards[i].lock);
+    pthread_cond_destroy(&write_shards[i].cond);
+  }
+  sfree(write_shards);
+  write_shards_num = 0;
+  write_threads_active = 0;
+} /* }}} void destroy_write_shards */
+
+/* FNV-1a over the identifier fields. This only needs to spread identifiers
+ * over a handful of shards, so the fields are hashed without separators. If
+ * the value list has an interned identifier, its hash is used instead. */
+static size_t write_shard_index(value_list_t const *vl) /* {{{ */
+{
+  char const *fields[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                          vl->type_instance};
+  uint64_t hash = 2166136261u;
+  size_t num = __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED);
+
+  if (num <= 1)
+    return 0;
+
+  if (vl->ident != NULL) {
+    hash = vl->ident->hash;
+  } else {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+      for (char const *c = fields[i]; *c != 0; c++) {
+        h ^= (uint8_t)*c;
+        h *= 16777619u;
+      }
+    }
+    hash = h;
+  }
+
+  /* The shards of node `n' are n, n + write_nodes_num, ... */
+  if (write_nodes_num > 1) {
+    size_t node = affinity_current_node() % write_nodes_num;
+    if (node < num) {
+      size_t node_shards = (num - node + write_nodes_num - 1) / write_nodes_num;
+      return node + (size_t)(hash % node_shards) * write_nodes_num;
+    }
+  }
+
+  return (size_t)(hash % num);
+} /* }}} size_t write_shard_index */
+
+static bool write_shard_same_node(size_t a, size_t b) /* {{{ */
+{
+  return (a % write_nodes_num) == (b % write_nodes_num);
+} /* }}} bool write_shard_same_node */
+
+/* Must be called with `shard->lock' held. */
+static write_queue_t *write_shard_pop(write_shard_t *shard) /* {{{ */
+{
+  write_queue_t *q = shard->head;
+
+  if (q == NULL)
+    return NULL;
+
+  shard->head = q->next;
+  shard->length -= 1;
+  if (shard->head == NULL) {
+    shard->tail = NULL;
+    assert(0 == shard->length);
+  }
+
+  if (write_scaling) {
+    cdtime_t latency = cdtime() - q->time;
+    if (latency > shard->latency_max)
+      shard->latency_max = latency;
+  }
+
+  return q;
+} /* }}} write_queue_t *write_shard_pop */
+
+/* Wakes up a write thread that is waiting for work so it can steal from a
+ * shard whose owner is busy. The `idle' flags are only a hint, they are read
+ * without holding the respective lock. With `WriteQueuePerNode', threads on
+ * the same node are preferred. */
+static void write_shard_kick_idle(size_t busy) /* {{{ */
+{
+  for (size_t i = 1; i < 2 * write_shards_num; i++) {
+    size_t index = (busy + i) % write_shards_num;
+    write_shard_t *shard = write_shards + index;
+
+    /* First the shards of the same node, then the others. */
+    bool first_pass = (i < write_shards_num);
+    if ((write_nodes_num == 1)
+            ? !first_pass
+            : (first_pass != write_shard_same_node(index, busy)))
+      continue;
+    if (!shard->idle)
+      continue;
+
+    pthread_mutex_lock(&shard->lock);
+    if (!shard->idle) {
+      pthread_mutex_unlock(&shard->lock);
+      continue;
+    }
+    shard->kicked = true;
+    pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+    return;
+  }
+} /* }}} void write_shard_kick_idle */
+
+/* Returns the number of allocations the pools of the write queue could not
+ * serve from the calling thread's caches. */
+static uint64_t write_queue_pool_misses(void) /* {{{ */
+{
+  return c_pool_thread_misses(write_queue_pool) +
+         c_pool_thread_misses(value_list_pool);
+} /* }}} uint64_t write_queue_pool_misses */
+
+/* If `allocations' is not NULL, the number of calls to malloc made to copy
+ * `vl' is added to it. */
+static write_queue_t *write_queue_new(value_list_t const *vl, /* {{{ */
+                                      uint64_t *allocations) {
+  pthread_once(&plugin_pools_once, plugin_pools_init);
+  uint64_t misses = (allocations != NULL) ? write_queue_pool_misses() : 0;
+
+  write_queue_t *q = c_pool_alloc(write_queue_pool);
+  if (q == NULL)
+    return NULL;
+  q->next = NULL;
+
+  q->vl = plugin_value_list_clone(vl);
+  if (q->vl == NULL) {
+    c_pool_free(write_queue_pool, q);
+    return NULL;
+  }
+
+  /* Store context of caller (read plugin); otherwise, it would not be
+   * available to the write plugins when actually dispatching the
+   * value-list later on. */
+  q->ctx = plugin_get_ctx();
+
+  /* The values are always copied with calloc. */
+  if (allocations != NULL)
+    *allocations += 1 + (write_queue_pool_misses() - misses);
+
+  return q;
+} /* }}} write_queue_t *write_queue_new */
+
+/* Appends the chain `head' ... `tail' of `num' entries to a shard, taking the
+ * shard's lock once. */
+static void write_shard_append(size_t index, write_queue_t *head, /* {{{ */
+                               write_queue_t *tail, long num) {
+  write_shard_t *shard = write_shards + index;
+  bool owner_busy;
+
+  pthread_mutex_lock(&shard->lock);
+
+  if (shard->tail == NULL) {
+    shard->head = head;
+    shard->tail = tail;
+    shard->length = num;
+  } else {
+    shard->tail->next = head;
+    shard->tail = tail;
+    shard->length += num;
+  }
+
+  owner_busy = !shard->idle;
+  pthread_cond_signal(&shard->cond);
+  pthread_mutex_unlock(&shard->lock);
+
+  if (owner_busy)
+    write_shard_kick_idle(index);
+} /* }}} void write_shard_append */
+
+static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
+{
+  if (write_shards == NULL)
+    return ENOENT;
+
+  uint64_t allocations = 0;
+  write_queue_t *q =
+      write_queue_new(vl, record_statistics ? &allocations : NULL);
+  if (q == NULL)
+    return ENOMEM;
+
+  if (record_statistics)
+    hot_stats_add_values(1, allocations);
+  if (write_scaling)
+    q->time = cdtime();
+
+  /* Hash the clone: plugin_value_list_clone() may have filled in the host. */
+  write_shard_append(write_shard_index(q->vl), q, q, 1);
+  return 0;
+} /* }}} int plugin_write_enqueue */
+
+/* Enqueues several value lists. The value lists are first chained per shard,
+ * keeping their order within each shard, so that every shard's lock is taken
+ * and its write thread is signalled at most once per batch. */
+static int plugin_write_enqueue_batch(value_list_t const *vls, /* {{{ */
+                                      size_t vls_num) {
+  struct {
+    write_queue_t *head;
+    write_queue_t *tail;
+    long num;
+  } *chains;
+  uint64_t enqueued = 0;
+  uint64_t allocations = 0;
+  int status = 0;
+
+  if (write_shards == NULL)
+    return ENOENT;
+
+  chains = calloc(write_shards_num, sizeof(*chains));
+  if (chains == NULL)
+    return ENOMEM;
+
+  cdtime_t now = write_scaling ? cdtime() : 0;
+  for (size_t i = 0; i < vls_num; i++) {
+    write_queue_t *q =
+        write_queue_new(vls + i, record_statistics ? &allocations : NULL);
+    if (q == NULL) {
+      status = ENOMEM;
+      continue;
+    }
+    q->time = now;
+    enqueued++;
+
+    /* Hash the clone: plugin_value_list_clone() may have filled in the host. */
+    size_t index = write_shard_index(q->vl);
+    if (chains[index].head == NULL)
+      chains[index].head = q;
+    else
+      chains[index].tail->next = q;
+    chains[index].tail = q;
+    chains[index].num++;
+  }
+
+  for (size_t i = 0; i < write_shards_num; i++) {
+    if (chains[i].head != NULL)
+      write_shard_append(i, chains[i].head, chains[i].tail, chains[i].num);
+  }
+  sfree(chains);
+
+  if (record_statistics && (enqueued > 0))
+    hot_stats_add_values(enqueued, allocations);
+
+  return status;
+} /* }}} int plugin_write_enqueue_batch */
+
+/* Takes a value list from any shard but `own'. Uses trylock so that a
+ * thread looking for work never blocks a producer or the shard's owner. With
+ * `WriteQueuePerNode', the shards of the own node are tried first. */
+static write_queue_t *plugin_write_steal(size_t own) /* {{{ */
+{
+  for (size_t i = 1; i < 2 * write_shards_num; i++) {
+    size_t index = (own + i) % write_shards_num;
+    write_shard_t *shard = write_shards + index;
+
+    /* First the shards of the same node, then the others. */
+    bool first_pass = (i < write_shards_num);
+    if ((write_nodes_num == 1)
+            ? !first_pass
+            : (first_pass != write_shard_same_node(index, own)))
+      continue;
+
+    if (pthread_mutex_trylock(&shard->lock) != 0)
+      continue;
+
+    write_queue_t *q = write_shard_pop(shard);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (q != NULL)
+      return q;
+  }
+
+  return NULL;
+} /* }}} write_queue_t *plugin_write_steal */
+
+/* If `wait' is false, NULL is returned right away if no value list is
+ * queued in any shard. */
+static value_list_t *plugin_write_dequeue(size_t own, bool wait) /* {{{ */
+{
+  write_shard_t *shard = write_shards + own;
+  write_queue_t *q = NULL;
+  value_list_t *vl;
+
+  while (write_loop) {
+    pthread_mutex_lock(&shard->lock);
+    q = write_shard_pop(shard);
+    pthread_mutex_unlock(&shard->lock);
+    if (q != NULL)
+      break;
+
+    q = plugin_write_steal(own);
+    if ((q != NULL) || !wait)
+      break;
+    /* Parked by the thread scaler. */
+    if (own >= __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED))
+      break;
+
+    pthread_mutex_lock(&shard->lock);
+    shard->idle = true;
+    while (write_loop && (shard->head == NULL) && !shard->kicked)
+      pthread_cond_wait(&shard->cond, &shard->lock);
+    shard->idle = false;
+    shard->kicked = false;
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  if (q == NULL)
+    return NULL;
+
+  (void)plugin_set_ctx(q->ctx);
 
-  meta_data_destroy(vl->meta);
-  sfree(vl->values);
-  sfree(vl);
-} /* }}} void plugin_value_list_free */
+  vl = q->vl;
+  c_pool_free(write_queue_pool, q);
+  return vl;
+} /* }}} value_list_t *plugin_write_dequeue */
 
-static value_list_t *
-plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
-{
-  value_list_t *vl;
+/* Used by a parked write thread instead of plugin_write_dequeue(): returns the
+ * value lists that producers still hashed to its shard. If `wait' is set,
+ * sleeps until there are more, the pool grows again or the threads are
+ * stopped. Parked threads don't steal and aren't kicked. */
+static value_list_t *plugin_write_dequeue_parked(size_t own, /* {{{ */
+                                                 bool wait) {
+  write_shard_t *shard = write_shards + own;
+
+  pthread_mutex_lock(&shard->lock);
+  /* The scaler changes `write_threads_active' before signalling `cond'. */
+  while (wait && write_loop && (shard->head == NULL) &&
+         (own >= __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED)))
+    pthread_cond_wait(&shard->cond, &shard->lock);
+  write_queue_t *q = write_shard_pop(shard);
+  pthread_mutex_unlock(&shard->lock);
 
-  if (vl_orig == NULL)
+  if (q == NULL)
     return NULL;
 
-  vl = malloc(sizeof(*vl));
-  if (vl == NULL)
+  (void)plugin_set_ctx(q->ctx);
+
+  value_list_t *vl = q->vl;
+  c_pool_free(write_queue_pool, q);
+  return vl;
+} /* }}} value_list_t *plugin_write_dequeue_parked */
+
+/* Queues a copy of `vl' for the write callback `cf', which has its own queue
+ * and threads. */
+static int plugin_write_pool_enqueue(callback_func_t *cf, /* {{{ */
+                                     data_set_t const *ds,
+                                     value_list_t const *vl) {
+  value_list_t *copy = plugin_value_list_clone(vl);
+  if (copy == NULL)
+    return ENOMEM;
+
+  int status = write_pool_enqueue(cf->cf_pool, ds, copy);
+  if (status != 0)
+    plugin_value_list_free(copy);
+  return status;
+} /* }}} int plugin_write_pool_enqueue */
+
+static write_batch_t *write_batch_get(write_batch_list_t *wbl, /* {{{ */
+                                      char const *name) {
+  for (size_t i = 0; i < wbl->batches_num; i++)
+    if (strcmp(name, wbl->batches[i].name) == 0)
+      return wbl->batches + i;
+
+  write_batch_t *tmp =
+      realloc(wbl->batches, (wbl->batches_num + 1) * sizeof(*wbl->batches));
+  if (tmp == NULL)
     return NULL;
-  memcpy(vl, vl_orig, sizeof(*vl));
+  wbl->batches = tmp;
 
-  if (vl->host[0] == 0)
-    sstrncpy(vl->host, hostname_g, sizeof(vl->host));
+  write_batch_t *wb = wbl->batches + wbl->batches_num;
+  *wb = (write_batch_t){.name = strdup(name)};
+  if (wb->name == NULL)
+    return NULL;
 
-  vl->values = calloc(vl_orig->values_len, sizeof(*vl->values));
-  if (vl->values == NULL) {
-    plugin_value_list_free(vl);
+  wb->size = write_batch_size;
+  wb->ds = calloc(wb->size, sizeof(*wb->ds));
+  wb->vl = calloc(wb->size, sizeof(*wb->vl));
+  if ((wb->ds == NULL) || (wb->vl == NULL)) {
+    sfree(wb->ds);
+    sfree(wb->vl);
+    sfree(wb->name);
     return NULL;
   }
-  memcpy(vl->values, vl_orig->values,
-         vl_orig->values_len * sizeof(*vl->values));
 
-  vl->meta = meta_data_clone(vl->meta);
-  if ((vl_orig->meta != NULL) && (vl->meta == NULL)) {
-    plugin_value_list_free(vl);
-    return NULL;
+  wbl->batches_num++;
+  return wb;
+} /* }}} write_batch_t *write_batch_get */
+
+/* Remembers that the write callback `cf' holds data of `vl' until it is
+ * flushed, if it has a flush callback. */
+static void plugin_write_pending_add(callback_func_t *cf, /* {{{ */
+                                     value_list_t const *vl) {
+  write_pending_t *wp = __atomic_load_n(&cf->cf_pending, __ATOMIC_ACQUIRE);
+  if (wp == NULL)
+    return;
+
+  if (vl->ident != NULL) {
+    write_pending_add(wp, vl->ident->hash);
+    return;
   }
 
-  if (vl->time == 0)
-    vl->time = cdtime();
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) == 0)
+    write_pending_add(wp, ident_hash(name));
+} /* }}} void plugin_write_pending_add */
+
+/* Passes `num' value lists to the batch write callback `cf'. If the callback
+ * has a spool, the value lists are spooled instead if the callback fails or
+ * older values are waiting. */
+static int plugin_write_batch_call(callback_func_t *cf, /* {{{ */
+                                   data_set_t const **ds,
+                                   value_list_t const **vl, size_t num) {
+  int status = 0;
+
+  if (!write_spool_pending(cf->cf_spool)) {
+    plugin_write_batch_cb callback = cf->cf_callback;
+    cdtime_t start = callback_stats_start(cf);
+    status = (*callback)(ds, vl, num, &cf->cf_udata);
+    callback_stats_end(cf, start);
+
+    if (status == 0)
+      for (size_t i = 0; i < num; i++)
+        plugin_write_pending_add(cf, vl[i]);
+    if ((status == 0) || (cf->cf_spool == NULL))
+      return status;
+  }
 
-  /* Fill in the interval from the thread context, if it is zero. */
-  if (vl->interval == 0)
-    vl->interval = plugin_get_interval();
+  status = 0;
+  for (size_t i = 0; i < num; i++)
+    if (write_spool_append(cf->cf_spool, vl[i]) != 0)
+      status = -1;
+  return status;
+} /* }}} int plugin_write_batch_call */
 
-  return vl;
-} /* }}} value_list_t *plugin_value_list_clone */
+/* Passes all value lists in `wb' to the batch write callback and frees them
+ * afterwards. */
+static int write_batch_flush(write_batch_list_t *wbl, /* {{{ */
+                             write_batch_t *wb) {
+  int status = 0;
 
-static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
-{
-  write_queue_t *q;
+  if (wb->num == 0)
+    return 0;
 
-  q = malloc(sizeof(*q));
-  if (q == NULL)
-    return ENOMEM;
-  q->next = NULL;
+  write_entry_t const *we =
+      write_snapshot_find(write_snapshot_enter(), wb->name);
+  if ((we != NULL) && we->batch) {
+    callback_func_t *cf = we->cf;
 
-  q->vl = plugin_value_list_clone(vl);
-  if (q->vl == NULL) {
-    sfree(q);
-    return ENOMEM;
-  }
+    /* Keep the interval and flush information but update the plugin name,
+     * like plugin_write() does. */
+    plugin_ctx_t old_ctx = plugin_get_ctx();
+    plugin_ctx_t ctx = old_ctx;
+    ctx.name = cf->cf_ctx.name;
+    plugin_set_ctx(ctx);
 
-  /* Store context of caller (read plugin); otherwise, it would not be
-   * available to the write plugins when actually dispatching the
-   * value-list later on. */
-  q->ctx = plugin_get_ctx();
+    DEBUG("plugin: write_batch_flush: Writing %" PRIsz " values via %s.",
+          wb->num, wb->name);
+    status = plugin_write_batch_call(cf, wb->ds,
+                                     (value_list_t const **)wb->vl, wb->num);
 
-  pthread_mutex_lock(&write_lock);
+    plugin_set_ctx(old_ctx);
+  }
+  write_snapshot_leave();
 
-  if (write_queue_tail == NULL) {
-    write_queue_head = q;
-    write_queue_tail = q;
-    write_queue_length = 1;
-  } else {
-    write_queue_tail->next = q;
-    write_queue_tail = q;
-    write_queue_length += 1;
+  for (size_t i = 0; i < wb->num; i++) {
+    plugin_value_list_free(wb->vl[i]);
+    wb->vl[i] = NULL;
   }
+  wbl->pending -= wb->num;
+  wb->num = 0;
 
-  pthread_cond_signal(&write_cond);
-  pthread_mutex_unlock(&write_lock);
+  return status;
+} /* }}} int write_batch_flush */
 
-  return 0;
-} /* }}} int plugin_write_enqueue */
+static void write_batch_flush_all(write_batch_list_t *wbl) /* {{{ */
+{
+  for (size_t i = 0; i < wbl->batches_num; i++)
+    write_batch_flush(wbl, wbl->batches + i);
+  assert(wbl->pending == 0);
+} /* }}} void write_batch_flush_all */
 
-static value_list_t *plugin_write_dequeue(void) /* {{{ */
+static void write_batch_list_free(write_batch_list_t *wbl) /* {{{ */
 {
-  write_queue_t *q;
-  value_list_t *vl;
+  write_batch_flush_all(wbl);
 
-  pthread_mutex_lock(&write_lock);
+  for (size_t i = 0; i < wbl->batches_num; i++) {
+    sfree(wbl->batches[i].name);
+    sfree(wbl->batches[i].ds);
+    sfree(wbl->batches[i].vl);
+  }
+  sfree(wbl->batches);
+  wbl->batches_num = 0;
+} /* }}} void write_batch_list_free */
 
-  while (write_loop && (write_queue_head == NULL))
-    pthread_cond_wait(&write_cond, &write_lock);
+/* Queues `vl' for the batch callback `cf'. Outside of the write threads the
+ * callback is called right away with a batch of one. */
+static int write_batch_append(char const *name, /* {{{ */
+                              callback_func_t *cf, data_set_t const *ds,
+                              value_list_t const *vl) {
+  write_batch_list_t *wbl = NULL;
 
-  if (write_queue_head == NULL) {
-    pthread_mutex_unlock(&write_lock);
-    return NULL;
-  }
+  if (cf->cf_pool != NULL)
+    return plugin_write_pool_enqueue(cf, ds, vl);
 
-  q = write_queue_head;
-  write_queue_head = q->next;
-  write_queue_length -= 1;
-  if (write_queue_head == NULL) {
-    write_queue_tail = NULL;
-    assert(0 == write_queue_length);
-  }
+  /* Values have to wait behind the ones already spooled. */
+  if (write_spool_pending(cf->cf_spool))
+    return write_spool_append(cf->cf_spool, vl);
 
-  pthread_mutex_unlock(&write_lock);
+  if (write_batch_key_initialized)
+    wbl = pthread_getspecific(write_batch_key);
 
-  (void)plugin_set_ctx(q->ctx);
+  write_batch_t *wb = NULL;
+  value_list_t *copy = NULL;
+  if (wbl != NULL)
+    wb = write_batch_get(wbl, name);
+  if (wb != NULL)
+    copy = plugin_value_list_clone(vl);
 
-  vl = q->vl;
-  sfree(q);
-  return vl;
-} /* }}} value_list_t *plugin_write_dequeue */
+  if (copy == NULL)
+    return plugin_write_batch_call(cf, &ds, &vl, 1);
+
+  assert(wb->num < wb->size);
+  wb->ds[wb->num] = ds;
+  wb->vl[wb->num] = copy;
+  wb->num++;
+
+  if (wbl->pending == 0)
+    wbl->first_time = cdtime();
+  wbl->pending++;
+
+  if (wb->num >= wb->size)
+    return write_batch_flush(wbl, wb);
+
+  return 0;
+} /* }}} int write_batch_append */
 
-static void *plugin_write_thread(void __attribute__((unused)) * args) /* {{{ */
+static void *plugin_write_thread(void *args) /* {{{ */
 {
+  size_t own = (size_t)(uintptr_t)args;
+  write_batch_list_t wbl = {0};
+
+  pthread_setspecific(write_batch_key, &wbl);
+
   while (write_loop) {
-    value_list_t *vl = plugin_write_dequeue();
-    if (vl == NULL)
+    value_list_t *vl;
+
+    /* Don't go to sleep while values are waiting in a batch. */
+    if (own >= __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED))
+      vl = plugin_write_dequeue_parked(own, /* wait = */ wbl.pending == 0);
+    else
+      vl = plugin_write_dequeue(own, /* wait = */ wbl.pending == 0);
+    if (vl == NULL) {
+      write_batch_flush_all(&wbl);
       continue;
+    }
 
     plugin_dispatch_values_internal(vl);
 
     plugin_value_list_free(vl);
+
+    if ((wbl.pending > 0) &&
+        ((cdtime() - wbl.first_time) >= write_batch_timeout))
+      write_batch_flush_all(&wbl);
   }
 
+  pthread_setspecific(write_batch_key, NULL);
+  write_batch_list_free(&wbl);
+
   pthread_exit(NULL);
   return (void *)0;
 } /* }}} void *plugin_write_thread */
 
-static void start_write_threads(size_t num) /* {{{ */
+/* Stores the CPUs write thread `i' is bound to in `set'. Returns false if it
+ * isn't bound. */
+static bool write_thread_cpus(size_t i, affinity_set_t *set) /* {{{ */
+{
+  if (write_nodes_num > 1) {
+    if (affinity_node_cpus(i % write_nodes_num, set) != 0)
+      return false;
+    if (write_affinity_set) {
+      affinity_set_t both = *set;
+      affinity_and(&both, &write_affinity);
+      /* WriteThreadsAffinity excludes the node altogether. */
+      if (affinity_count(&both) > 0)
+        *set = both;
+    }
+    return true;
+  }
+
+  if (!write_affinity_set)
+    return false;
+  *set = write_affinity;
+  return true;
+} /* }}} bool write_thread_cpus */
+
+/* Starts the thread owning write shard `write_threads_num'. */
+static int start_write_thread(void) /* {{{ */
+{
+  size_t i = write_threads_num;
+
+  if (i >= write_shards_num)
+    return ENOSPC;
+
+  int status = pthread_create(write_threads + i, /* attr = */ NULL,
+                              plugin_write_thread,
+                              /* arg = */ (void *)(uintptr_t)i);
+  if (status != 0) {
+    ERROR("plugin: start_write_thread: pthread_create failed with status %i "
+          "(%s).",
+          status, STRERROR(status));
+    return status;
+  }
+
+  /* Only an absurd number of threads doesn't fit into the name. */
+  char name[THREAD_NAME_MAX];
+  int len = snprintf(name, sizeof(name), "writer#%" PRIu64, (uint64_t)i);
+  if ((len < 0) || ((size_t)len >= sizeof(name)))
+    sstrncpy(name, "writer", sizeof(name));
+  set_thread_name(write_threads[i], name);
+
+  affinity_set_t cpus;
+  if (write_thread_cpus(i, &cpus))
+    plugin_thread_bind(write_threads[i], &cpus, name);
+
+  write_threads_num++;
+  return 0;
+} /* }}} int start_write_thread */
+
+/* Starts a thread for each of the active write shards. */
+static void start_write_threads(void) /* {{{ */
 {
   if (write_threads != NULL)
     return;
 
-  write_threads = calloc(num, sizeof(*write_threads));
+  if (!write_batch_key_initialized) {
+    pthread_key_create(&write_batch_key, /* destructor = */ NULL);
+    write_batch_key_initialized = true;
+  }
+
+  /* Each write thread owns one shard. */
+  write_threads = calloc(write_shards_num, sizeof(*write_threads));
   if (write_threads == NULL) {
     ERROR("plugin: start_write_threads: calloc failed.");
     return;
   }
 
   write_threads_num = 0;
-  for (size_t i = 0; i < num; i++) {
-    int status = pthread_create(write_threads + write_threads_num,
-                                /* attr = */ NULL, plugin_write_thread,
-                                /* arg = */ NULL);
-    if (status != 0) {
-      ERROR("plugin: start_write_threads: pthread_create failed with status %i "
-            "(%s).",
-            status, STRERROR(status));
-      return;
-    }
-
-    char name[THREAD_NAME_MAX];
-    snprintf(name, sizeof(name), "writer#%" PRIu64,
-             (uint64_t)write_threads_num);
-    set_thread_name(write_threads[write_threads_num], name);
-
-    write_threads_num++;
-  } /* for (i) */
+  while ((write_threads_num < write_threads_active) &&
+         (start_write_thread() == 0))
+    ;
+  if ((write_threads_num > 0) && (write_threads_num < write_threads_active))
+    __atomic_store_n(&write_threads_active, write_threads_num,
+                     __ATOMIC_RELAXED);
 } /* }}} void start_write_threads */
 
 static void stop_write_threads(void) /* {{{ */
 {
-  write_queue_t *q;
   size_t i;
 
   if (write_threads == NULL)
@@ -853,11 +2875,13 @@ static void stop_write_threads(void) /* {{{ */
 
   INFO("collectd: Stopping %" PRIsz " write threads.", write_threads_num);
 
-  pthread_mutex_lock(&write_lock);
   write_loop = false;
-  DEBUG("plugin: stop_write_threads: Signalling `write_cond'");
-  pthread_cond_broadcast(&write_cond);
-  pthread_mutex_unlock(&write_lock);
+  DEBUG("plugin: stop_write_threads: Signalling the write shards");
+  for (i = 0; i < write_shards_num; i++) {
+    pthread_mutex_lock(&write_shards[i].lock);
+    pthread_cond_broadcast(&write_shards[i].cond);
+    pthread_mutex_unlock(&write_shards[i].lock);
+  }
 
   for (i = 0; i < write_threads_num; i++) {
     if (pthread_join(write_threads[i], NULL) != 0) {
@@ -868,20 +2892,7 @@ static void stop_write_threads(void) /* {{{ */
   sfree(write_threads);
   write_threads_num = 0;
 
-  pthread_mutex_lock(&write_lock);
-  i = 0;
-  for (q = write_queue_head; q != NULL;) {
-    write_queue_t *q1 = q;
-    plugin_value_list_free(q->vl);
-    q = q->next;
-    sfree(q1);
-    i++;
-  }
-  write_queue_head = NULL;
-  write_queue_tail = NULL;
-  write_queue_length = 0;
-  pthread_mutex_unlock(&write_lock);
-
+  i = drain_write_shards();
   if (i > 0) {
     WARNING("plugin: %" PRIsz " value list%s left after shutting down "
             "the write threads.",
@@ -889,6 +2900,222 @@ static void stop_write_threads(void) /* {{{ */
   }
 } /* }}} void stop_write_threads */
 
+/* Unparks, or starts, the next read thread. */
+static void read_threads_grow(void) /* {{{ */
+{
+  pthread_mutex_lock(&read_lock);
+  size_t active = read_threads_active;
+  if ((active >= read_shards_num) ||
+      ((active >= read_threads_num) && (start_read_thread() != 0))) {
+    pthread_mutex_unlock(&read_lock);
+    return;
+  }
+  __atomic_store_n(&read_threads_active, active + 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&read_lock);
+
+  read_shard_kick(read_shards + active);
+  __atomic_fetch_add(scaler_grown + 0, 1, __ATOMIC_RELAXED);
+  INFO("plugin: Read callbacks start late, increased the number of read "
+       "threads to %" PRIsz ".",
+       active + 1);
+} /* }}} void read_threads_grow */
+
+/* Parks the last active read thread. Its functions are handed to the others
+ * by the thread itself, once it has finished the callback it may be running. */
+static void read_threads_shrink(void) /* {{{ */
+{
+  pthread_mutex_lock(&read_lock);
+  size_t active = read_threads_active;
+  if (active <= read_threads_min) {
+    pthread_mutex_unlock(&read_lock);
+    return;
+  }
+  __atomic_store_n(&read_threads_active, active - 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&read_lock);
+
+  read_shard_kick(read_shards + active - 1);
+  __atomic_fetch_add(scaler_shrunk + 0, 1, __ATOMIC_RELAXED);
+  INFO("plugin: Read threads are idle, decreased their number to %" PRIsz ".",
+       active - 1);
+} /* }}} void read_threads_shrink */
+
+/* Grows the read pool if a callback started more than `SCALE_LATE_RATIO' of
+ * its interval late since the last call, which was `period' ago. Shrinks it
+ * after `SCALE_IDLE_CHECKS' calls in a row in which nothing was late and the
+ * remaining threads would have been busy less than half of the time. */
+static void read_threads_scale(cdtime_t period, size_t *idle_checks) /* {{{ */
+{
+  pthread_mutex_lock(&read_lock);
+  double late = read_late_max;
+  cdtime_t busy = read_busy_time;
+  size_t active = read_threads_active;
+  read_late_max = 0.0;
+  read_busy_time = 0;
+  pthread_mutex_unlock(&read_lock);
+
+  if (late > SCALE_LATE_RATIO) {
+    *idle_checks = 0;
+    read_threads_grow();
+    return;
+  }
+
+  if ((active > read_threads_min) && (busy < period * (active - 1) / 2))
+    (*idle_checks)++;
+  else
+    *idle_checks = 0;
+
+  if (*idle_checks >= SCALE_IDLE_CHECKS) {
+    *idle_checks = 0;
+    read_threads_shrink();
+  }
+} /* }}} void read_threads_scale */
+
+/* Unparks, or starts, the next write thread. */
+static void write_threads_grow(void) /* {{{ */
+{
+  size_t active = __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED);
+  if ((active >= write_shards_num) ||
+      ((active >= write_threads_num) && (start_write_thread() != 0)))
+    return;
+
+  write_shard_t *shard = write_shards + active;
+  pthread_mutex_lock(&shard->lock);
+  __atomic_store_n(&write_threads_active, active + 1, __ATOMIC_RELAXED);
+  pthread_cond_signal(&shard->cond);
+  pthread_mutex_unlock(&shard->lock);
+
+  __atomic_fetch_add(scaler_grown + 1, 1, __ATOMIC_RELAXED);
+  INFO("plugin: Values wait in the write queue, increased the number of write "
+       "threads to %" PRIsz ".",
+       active + 1);
+} /* }}} void write_threads_grow */
+
+/* Parks the last active write thread. Producers stop hashing value lists to
+ * its shard; the thread serves what is left there before it sleeps. */
+static void write_threads_shrink(void) /* {{{ */
+{
+  size_t active = __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED);
+  if (active <= write_threads_min)
+    return;
+
+  write_shard_t *shard = write_shards + active - 1;
+  pthread_mutex_lock(&shard->lock);
+  __atomic_store_n(&write_threads_active, active - 1, __ATOMIC_RELAXED);
+  shard->kicked = true;
+  pthread_cond_signal(&shard->cond);
+  pthread_mutex_unlock(&shard->lock);
+
+  __atomic_fetch_add(scaler_shrunk + 1, 1, __ATOMIC_RELAXED);
+  INFO("plugin: Write threads are idle, decreased their number to %" PRIsz ".",
+       active - 1);
+} /* }}} void write_threads_shrink */
+
+/* Grows the write pool if a value list has been queued for longer than
+ * `SCALE_WRITE_LATENCY', or if more than a batch per thread is queued. Shrinks
+ * it after `SCALE_IDLE_CHECKS' calls in a row in which no value list waited
+ * for more than a tenth of that and less than a batch was queued. */
+static void write_threads_scale(size_t *idle_checks) /* {{{ */
+{
+  cdtime_t now = cdtime();
+  cdtime_t latency = 0;
+  long length = 0;
+
+  for (size_t i = 0; i < write_shards_num; i++) {
+    write_shard_t *shard = write_shards + i;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->latency_max > latency)
+      latency = shard->latency_max;
+    shard->latency_max = 0;
+    if ((shard->head != NULL) && (now - shard->head->time > latency))
+      latency = now - shard->head->time;
+    length += shard->length;
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  size_t active = __atomic_load_n(&write_threads_active, __ATOMIC_RELAXED);
+  if ((latency > SCALE_WRITE_LATENCY) ||
+      (length > (long)(active * write_batch_size))) {
+    *idle_checks = 0;
+    write_threads_grow();
+    return;
+  }
+
+  if ((active > write_threads_min) && (latency < SCALE_WRITE_LATENCY / 10) &&
+      (length < (long)write_batch_size))
+    (*idle_checks)++;
+  else
+    *idle_checks = 0;
+
+  if (*idle_checks >= SCALE_IDLE_CHECKS) {
+    *idle_checks = 0;
+    write_threads_shrink();
+  }
+} /* }}} void write_threads_scale */
+
+static void *scaler_thread_main(void *args) /* {{{ */
+{
+  cdtime_t interval = plugin_get_interval();
+  cdtime_t last = cdtime();
+  size_t read_idle_checks = 0;
+  size_t write_idle_checks = 0;
+
+  pthread_mutex_lock(&scaler_lock);
+  while (scaler_loop) {
+    cdtime_t deadline = cdtime() + interval;
+    while (scaler_loop && (cdtime() < deadline))
+      pthread_cond_timedwait(&scaler_cond, &scaler_lock,
+                             &CDTIME_T_TO_TIMESPEC(deadline));
+    if (!scaler_loop)
+      break;
+    pthread_mutex_unlock(&scaler_lock);
+
+    cdtime_t now = cdtime();
+    if (read_scaling)
+      read_threads_scale(now - last, &read_idle_checks);
+    if (write_scaling)
+      write_threads_scale(&write_idle_checks);
+    last = now;
+
+    pthread_mutex_lock(&scaler_lock);
+  }
+  pthread_mutex_unlock(&scaler_lock);
+
+  return NULL;
+} /* }}} void *scaler_thread_main */
+
+static void start_scaler_thread(void) /* {{{ */
+{
+  if (scaler_running || (!read_scaling && !write_scaling))
+    return;
+
+  scaler_loop = true;
+  int status = plugin_thread_create(&scaler_thread, /* attr = */ NULL,
+                                    scaler_thread_main, /* arg = */ NULL,
+                                    "scaler");
+  if (status != 0) {
+    ERROR("plugin: start_scaler_thread: plugin_thread_create failed with "
+          "status %i (%s).",
+          status, STRERROR(status));
+    return;
+  }
+  scaler_running = true;
+} /* }}} void start_scaler_thread */
+
+static void stop_scaler_thread(void) /* {{{ */
+{
+  if (!scaler_running)
+    return;
+
+  pthread_mutex_lock(&scaler_lock);
+  scaler_loop = false;
+  pthread_cond_broadcast(&scaler_cond);
+  pthread_mutex_unlock(&scaler_lock);
+
+  pthread_join(scaler_thread, NULL);
+  scaler_running = false;
+} /* }}} void stop_scaler_thread */
+
 /*
  * Public functions
  */
@@ -910,10 +3137,10 @@ static bool plugin_is_loaded(char const *name) {
 
   if (plugins_loaded == NULL)
     plugins_loaded =
-        c_avl_create((int (*)(const void *, const void *))strcasecmp);
+        c_btree_create((int (*)(const void *, const void *))strcasecmp);
   assert(plugins_loaded != NULL);
 
-  status = c_avl_get(plugins_loaded, name, /* ret_value = */ NULL);
+  status = c_btree_get(plugins_loaded, name, /* ret_value = */ NULL);
   return status == 0;
 }
 
@@ -925,8 +3152,8 @@ static int plugin_mark_loaded(char const *name) {
   if (name_copy == NULL)
     return ENOMEM;
 
-  status = c_avl_insert(plugins_loaded,
-                        /* key = */ name_copy, /* value = */ NULL);
+  status = c_btree_insert(plugins_loaded,
+                          /* key = */ name_copy, /* value = */ NULL);
   return status;
 }
 
@@ -937,12 +3164,12 @@ static void plugin_free_loaded(void) {
   if (plugins_loaded == NULL)
     return;
 
-  while (c_avl_pick(plugins_loaded, &key, &value) == 0) {
+  while (c_btree_pick(plugins_loaded, &key, &value) == 0) {
     sfree(key);
     assert(value == NULL);
   }
 
-  c_avl_destroy(plugins_loaded);
+  c_btree_destroy(plugins_loaded);
   plugins_loaded = NULL;
 }
 
@@ -1059,24 +3286,20 @@ EXPORT int plugin_register_complex_config(const char *type,
   return cf_register_complex(type, callback);
 } /* int plugin_register_complex_config */
 
+EXPORT int plugin_register_reload(const char *type,
+                                  int (*callback)(oconfig_item_t *)) {
+  return cf_register_reload(type, callback);
+} /* int plugin_register_reload */
+
 EXPORT int plugin_register_init(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_init, name, (void *)callback, NULL);
 } /* plugin_register_init */
 
-static int plugin_compare_read_func(const void *arg0, const void *arg1) {
-  const read_func_t *rf0;
-  const read_func_t *rf1;
-
-  rf0 = arg0;
-  rf1 = arg1;
-
-  if (rf0->rf_next_read < rf1->rf_next_read)
-    return -1;
-  else if (rf0->rf_next_read > rf1->rf_next_read)
-    return 1;
-  else
-    return 0;
-} /* int plugin_compare_read_func */
+EXPORT int plugin_register_parallel_init(const char *name,
+                                         plugin_init_cb callback) {
+  return create_register_callback(&list_init_parallel, name, (void *)callback,
+                                  NULL);
+} /* plugin_register_parallel_init */
 
 /* Add a read function to both, the heap and a linked list. The linked list if
  * used to look-up read functions, especially for the remove function. The heap
@@ -1087,6 +3310,8 @@ static int plugin_insert_read(read_func_t *rf) {
 
   rf->rf_next_read = cdtime();
   rf->rf_effective_interval = rf->rf_interval;
+  if (rf->rf_ctx.max_interval > rf->rf_interval)
+    rf->rf_max_interval = rf->rf_ctx.max_interval;
 
   pthread_mutex_lock(&read_lock);
 
@@ -1099,7 +3324,7 @@ static int plugin_insert_read(read_func_t *rf) {
     }
   }
 
-  if (read_heap == NULL) {
+  if ((read_threads_num == 0) && (read_heap == NULL)) {
     read_heap = c_heap_create(plugin_compare_read_func);
     if (read_heap == NULL) {
       pthread_mutex_unlock(&read_lock);
@@ -1124,7 +3349,20 @@ static int plugin_insert_read(read_func_t *rf) {
     return -1;
   }
 
-  status = c_heap_insert(read_heap, rf);
+  callback_stats_init(&rf->rf_super);
+
+  if (read_threads_active > 0) {
+    read_shard_t *shard = read_shards + (read_shard_next % read_threads_active);
+    read_shard_next++;
+
+    pthread_mutex_lock(&shard->lock);
+    status = c_heap_insert(shard->heap, rf);
+    /* Wake up the shard's thread. */
+    pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+  } else {
+    status = c_heap_insert(read_heap, rf);
+  }
   if (status != 0) {
     pthread_mutex_unlock(&read_lock);
     ERROR("plugin_insert_read: c_heap_insert failed.");
@@ -1134,9 +3372,6 @@ static int plugin_insert_read(read_func_t *rf) {
 
   /* This does not fail. */
   llist_append(read_list, le);
-
-  /* Wake up all the read threads. */
-  pthread_cond_broadcast(&read_cond);
   pthread_mutex_unlock(&read_lock);
   return 0;
 } /* int plugin_insert_read */
@@ -1211,13 +3446,261 @@ EXPORT int plugin_register_complex_read(const char *group, const char *name,
     sfree(rf);
   }
 
-  return status;
-} /* int plugin_register_complex_read */
+  return status;
+} /* int plugin_register_complex_read */
+
+/* Passes `vl' to the write callback `cf'. If the callback has a spool, `vl' is
+ * spooled instead if the callback fails or older values are waiting. */
+static int plugin_write_direct(callback_func_t *cf, /* {{{ */
+                               data_set_t const *ds, value_list_t const *vl) {
+  if (write_spool_pending(cf->cf_spool))
+    return write_spool_append(cf->cf_spool, vl);
+
+  plugin_write_cb callback = cf->cf_callback;
+  cdtime_t start = callback_stats_start(cf);
+  int status = (*callback)(ds, vl, &cf->cf_udata);
+  callback_stats_end(cf, start);
+
+  if (status == 0)
+    plugin_write_pending_add(cf, vl);
+  else if (cf->cf_spool != NULL)
+    status = write_spool_append(cf->cf_spool, vl);
+  return status;
+} /* }}} int plugin_write_direct */
+
+/* Like plugin_write_direct(), but only queues `vl' if the callback has its own
+ * queue. */
+static int plugin_write_one(callback_func_t *cf, /* {{{ */
+                            data_set_t const *ds, value_list_t const *vl) {
+  if (cf->cf_pool != NULL)
+    return plugin_write_pool_enqueue(cf, ds, vl);
+
+  return plugin_write_direct(cf, ds, vl);
+} /* }}} int plugin_write_one */
+
+/* Writes the values taken from the queue of the write callback `arg'. */
+static int plugin_write_pooled(data_set_t const **ds, /* {{{ */
+                               value_list_t const **vl,
+                               plugin_ctx_t const *ctx, size_t num,
+                               void *arg) {
+  callback_func_t *cf = arg;
+  int status = 0;
+
+  for (size_t i = 0; i < num; i++) {
+    plugin_ctx_t c = ctx[i];
+    c.name = cf->cf_ctx.name;
+    plugin_ctx_t old_ctx = plugin_set_ctx(c);
+
+    if (plugin_write_direct(cf, ds[i], vl[i]) != 0)
+      status = -1;
+
+    plugin_set_ctx(old_ctx);
+  }
+
+  return status;
+} /* }}} int plugin_write_pooled */
+
+/* Writes the values taken from the queue of the batch write callback `arg'
+ * with one call, in the context of the first of them. */
+static int plugin_write_batch_pooled(data_set_t const **ds, /* {{{ */
+                                     value_list_t const **vl,
+                                     plugin_ctx_t const *ctx, size_t num,
+                                     void *arg) {
+  callback_func_t *cf = arg;
+
+  plugin_ctx_t c = ctx[0];
+  c.name = cf->cf_ctx.name;
+  plugin_ctx_t old_ctx = plugin_set_ctx(c);
+
+  int status = plugin_write_batch_call(cf, ds, vl, num);
+
+  plugin_set_ctx(old_ctx);
+  return status;
+} /* }}} int plugin_write_batch_pooled */
+
+/* Replays spooled values through the write callback `arg'. */
+static int plugin_write_spooled(data_set_t const *ds, /* {{{ */
+                                value_list_t const *vl, void *arg) {
+  callback_func_t *cf = arg;
+  plugin_write_cb callback = cf->cf_callback;
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  cdtime_t start = callback_stats_start(cf);
+  int status = (*callback)(ds, vl, &cf->cf_udata);
+  callback_stats_end(cf, start);
+  plugin_set_ctx(old_ctx);
+
+  if (status == 0)
+    plugin_write_pending_add(cf, vl);
+  return status;
+} /* }}} int plugin_write_spooled */
+
+static int plugin_write_batch_spooled(data_set_t const *ds, /* {{{ */
+                                      value_list_t const *vl, void *arg) {
+  callback_func_t *cf = arg;
+  plugin_write_batch_cb callback = cf->cf_callback;
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  cdtime_t start = callback_stats_start(cf);
+  int status = (*callback)(&ds, &vl, 1, &cf->cf_udata);
+  callback_stats_end(cf, start);
+  plugin_set_ctx(old_ctx);
+
+  if (status == 0)
+    plugin_write_pending_add(cf, vl);
+  return status;
+} /* }}} int plugin_write_batch_spooled */
+
+/* Gives the write callback `cf' its own queue and threads if its plugin has
+ * been configured with "WriteThreads". Must be called with `register_lock'
+ * held. */
+static void plugin_write_pool_create(callback_func_t *cf, /* {{{ */
+                                     char const *name, write_pool_cb write) {
+  if ((cf->cf_ctx.write_pool == NULL) || (cf->cf_pool != NULL))
+    return;
+
+  /* The threads inherit the callback's context. */
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  cf->cf_pool = write_pool_create(name, cf->cf_ctx.write_pool,
+                                  write_batch_size, write, plugin_value_list_free,
+                                  cf);
+  plugin_set_ctx(old_ctx);
+
+  if (cf->cf_pool != NULL)
+    INFO("plugin: Started %" PRIsz " write thread%s for \"%s\".",
+         cf->cf_ctx.write_pool->threads,
+         (cf->cf_ctx.write_pool->threads == 1) ? "" : "s", name);
+} /* }}} void plugin_write_pool_create */
+
+/* Gives the write callback `cf' a set of pending identifiers. Must be called
+ * with `register_lock' held. */
+static void plugin_write_pending_create(callback_func_t *cf) /* {{{ */
+{
+  if (cf->cf_pending != NULL)
+    return;
+
+  write_pending_t *wp = write_pending_create(WRITE_PENDING_LIMIT);
+  if (wp == NULL) {
+    /* Identifiers are then flushed by all of the plugin's callbacks. */
+    ERROR("plugin: write_pending_create failed.");
+    return;
+  }
+  __atomic_store_n(&cf->cf_pending, wp, __ATOMIC_RELEASE);
+} /* }}} void plugin_write_pending_create */
+
+/* Gives the write callback `name' a spool if its plugin has been configured
+ * with a "SpoolDirectory", and its own queue if it is registered after the
+ * queues have been started. */
+static void plugin_write_callback_setup(llist_t *list, /* {{{ */
+                                        char const *name, write_spool_cb replay,
+                                        write_pool_cb write) {
+  plugin_ctx_t ctx = plugin_get_ctx();
+
+  pthread_mutex_lock(&register_lock);
+  llentry_t *le = llist_search(list, name);
+  if (le != NULL) {
+    callback_func_t *cf = le->value;
+    if (ctx.spool != NULL) {
+      cf->cf_spool = write_spool_create(name, ctx.spool, replay, cf);
+      if ((cf->cf_spool != NULL) && write_spools_started)
+        write_spool_start(cf->cf_spool);
+    }
+    if (write_pools_started)
+      plugin_write_pool_create(cf, name, write);
+    if (llist_search(list_flush, name) != NULL)
+      plugin_write_pending_create(cf);
+  }
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void plugin_write_callback_setup */
+
+EXPORT int plugin_register_write(const char *name, plugin_write_cb callback,
+                                 user_data_t const *ud) {
+  int status =
+      create_register_callback(&list_write, name, (void *)callback, ud);
+  if (status == 0)
+    plugin_write_callback_setup(list_write, name, plugin_write_spooled,
+                                plugin_write_pooled);
+  write_retired_reclaim();
+  return status;
+} /* int plugin_register_write */
+
+EXPORT int plugin_register_write_batch(const char *name,
+                                       plugin_write_batch_cb callback,
+                                       user_data_t const *ud) {
+  int status = create_register_callback(&list_write_batch, name,
+                                        (void *)callback, ud);
+  if (status == 0)
+    plugin_write_callback_setup(list_write_batch, name,
+                                plugin_write_batch_spooled,
+                                plugin_write_batch_pooled);
+  write_retired_reclaim();
+  return status;
+} /* int plugin_register_write_batch */
+
+/* Gives the write callbacks configured with "WriteThreads" their own queues.
+ * Called before the write threads are started, once "WriteBatchSize" is
+ * known. */
+static void start_write_pools(void) /* {{{ */
+{
+  pthread_mutex_lock(&register_lock);
+  for (llentry_t *le = llist_head(list_write); le != NULL; le = le->next)
+    plugin_write_pool_create(le->value, le->key, plugin_write_pooled);
+  for (llentry_t *le = llist_head(list_write_batch); le != NULL; le = le->next)
+    plugin_write_pool_create(le->value, le->key, plugin_write_batch_pooled);
+  write_pools_started = true;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void start_write_pools */
+
+/* Writes the values still queued for the write callbacks with their own
+ * queues. Called once the write threads have stopped. */
+static void stop_write_pools(void) /* {{{ */
+{
+  llist_t *lists[] = {list_write, list_write_batch};
+
+  pthread_mutex_lock(&register_lock);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++)
+    for (llentry_t *le = llist_head(lists[i]); le != NULL; le = le->next) {
+      callback_func_t *cf = le->value;
+      write_pool_destroy(cf->cf_pool);
+      cf->cf_pool = NULL;
+    }
+  write_pools_started = false;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void stop_write_pools */
+
+/* Starts replaying the spooled values. Called once the plugins have been
+ * initialized, so that no values are written before. */
+static void start_write_spools(void) /* {{{ */
+{
+  llist_t *lists[] = {list_write, list_write_batch};
 
-EXPORT int plugin_register_write(const char *name, plugin_write_cb callback,
-                                 user_data_t const *ud) {
-  return create_register_callback(&list_write, name, (void *)callback, ud);
-} /* int plugin_register_write */
+  pthread_mutex_lock(&register_lock);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++)
+    for (llentry_t *le = llist_head(lists[i]); le != NULL; le = le->next) {
+      callback_func_t *cf = le->value;
+      if (cf->cf_spool != NULL)
+        write_spool_start(cf->cf_spool);
+    }
+  write_spools_started = true;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void start_write_spools */
+
+/* Closes the spools before the plugins are shut down. Values that haven't
+ * been replayed stay on disk for the next start. */
+static void stop_write_spools(void) /* {{{ */
+{
+  llist_t *lists[] = {list_write, list_write_batch};
+
+  pthread_mutex_lock(&register_lock);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++)
+    for (llentry_t *le = llist_head(lists[i]); le != NULL; le = le->next) {
+      callback_func_t *cf = le->value;
+      write_spool_destroy(cf->cf_spool);
+      cf->cf_spool = NULL;
+    }
+  write_spools_started = false;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void stop_write_spools */
 
 static int plugin_flush_timeout_callback(user_data_t *ud) {
   flush_callback_t *cb = ud->data;
@@ -1265,6 +3748,17 @@ EXPORT int plugin_register_flush(const char *name, plugin_flush_cb callback,
   if (status != 0)
     return status;
 
+  /* Identifiers are only flushed by the plugin if it has been written
+   * them. */
+  pthread_mutex_lock(&register_lock);
+  llist_t *lists[] = {list_write, list_write_batch};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    llentry_t *le = llist_search(lists[i], name);
+    if (le != NULL)
+      plugin_write_pending_create(le->value);
+  }
+  pthread_mutex_unlock(&register_lock);
+
   if (ctx.flush_interval != 0) {
     char *flush_name;
     flush_callback_t *cb;
@@ -1314,37 +3808,131 @@ EXPORT int plugin_register_shutdown(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_shutdown, name, (void *)callback, NULL);
 } /* int plugin_register_shutdown */
 
+static void data_set_free(data_set_t *ds) /* {{{ */
+{
+  if (ds == NULL)
+    return;
+
+  sfree(ds->ds);
+  sfree(ds);
+} /* }}} void data_set_free */
+
 static void plugin_free_data_sets(void) {
-  void *key;
-  void *value;
+  for (size_t i = 0; i < data_sets_size; i++)
+    data_set_free(data_sets[i].ds);
+  sfree(data_sets);
+  data_sets_size = 0;
+  data_sets_num = 0;
+
+  for (size_t i = 0; i < data_sets_retired_num; i++)
+    data_set_free(data_sets_retired[i]);
+  sfree(data_sets_retired);
+  data_sets_retired_num = 0;
+} /* void plugin_free_data_sets */
+
+/* Returns the slot of the data set `name', or of the free slot ending its
+ * probe sequence if there is none. `data_sets' must not be NULL. */
+static size_t data_set_slot(char const *name, uint64_t hash) /* {{{ */
+{
+  size_t mask = data_sets_size - 1;
 
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    data_set_entry_t const *e = data_sets + i;
+    if ((e->ds == NULL) ||
+        ((e->hash == hash) && (strcmp(e->ds->type, name) == 0)))
+      return i;
+  }
+} /* }}} size_t data_set_slot */
+
+static data_set_t *data_set_lookup(char const *name) /* {{{ */
+{
   if (data_sets == NULL)
-    return;
+    return NULL;
+
+  return data_sets[data_set_slot(name, ident_hash(name))].ds;
+} /* }}} data_set_t *data_set_lookup */
+
+/* Doubles the size of the table. */
+static int data_sets_grow(void) /* {{{ */
+{
+  size_t new_size = (data_sets_size == 0) ? 512 : 2 * data_sets_size;
+  data_set_entry_t *old = data_sets;
+  size_t old_size = data_sets_size;
 
-  while (c_avl_pick(data_sets, &key, &value) == 0) {
-    data_set_t *ds = value;
-    /* key is a pointer to ds->type */
+  data_set_entry_t *tmp = calloc(new_size, sizeof(*tmp));
+  if (tmp == NULL)
+    return ENOMEM;
 
-    sfree(ds->ds);
-    sfree(ds);
+  data_sets = tmp;
+  data_sets_size = new_size;
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].ds == NULL)
+      continue;
+    data_sets[data_set_slot(old[i].ds->type, old[i].hash)] = old[i];
   }
 
-  c_avl_destroy(data_sets);
-  data_sets = NULL;
-} /* void plugin_free_data_sets */
+  sfree(old);
+  return 0;
+} /* }}} int data_sets_grow */
 
-EXPORT int plugin_register_data_set(const data_set_t *ds) {
+/* Removes the data set in `slot' from the table and retires it. */
+static void data_set_remove_slot(size_t slot) /* {{{ */
+{
+  size_t mask = data_sets_size - 1;
+
+  data_set_t **tmp = realloc(data_sets_retired, (data_sets_retired_num + 1) *
+                                                    sizeof(*tmp));
+  if (tmp == NULL) {
+    /* Leaking is better than freeing something that may still be used. */
+    ERROR("plugin: realloc failed.");
+  } else {
+    data_sets_retired = tmp;
+    data_sets_retired[data_sets_retired_num++] = data_sets[slot].ds;
+  }
+
+  data_sets[slot].ds = NULL;
+  data_sets_num--;
+
+  /* Move entries that were displaced past the removed one back, so that no
+   * probe sequence is interrupted by the free slot. */
+  size_t hole = slot;
+  for (size_t i = (slot + 1) & mask; data_sets[i].ds != NULL;
+       i = (i + 1) & mask) {
+    size_t home = (size_t)data_sets[i].hash & mask;
+    /* Skip entries whose home slot lies cyclically in (hole, i]. */
+    if (((i - home) & mask) < ((i - hole) & mask))
+      continue;
+    data_sets[hole] = data_sets[i];
+    data_sets[i].ds = NULL;
+    hole = i;
+  }
+} /* }}} void data_set_remove_slot */
+
+static int data_set_unregister(const char *name) /* {{{ */
+{
+  if (data_sets == NULL)
+    return -1;
+
+  size_t slot = data_set_slot(name, ident_hash(name));
+  if (data_sets[slot].ds == NULL)
+    return -1;
+
+  data_set_remove_slot(slot);
+  return 0;
+} /* }}} int data_set_unregister */
+
+static int data_set_register(const data_set_t *ds) /* {{{ */
+{
   data_set_t *ds_copy;
 
-  if ((data_sets != NULL) && (c_avl_get(data_sets, ds->type, NULL) == 0)) {
+  if (data_set_lookup(ds->type) != NULL) {
     NOTICE("Replacing DS `%s' with another version.", ds->type);
-    plugin_unregister_data_set(ds->type);
-  } else if (data_sets == NULL) {
-    data_sets = c_avl_create((int (*)(const void *, const void *))strcmp);
-    if (data_sets == NULL)
-      return -1;
+    data_set_unregister(ds->type);
   }
 
+  if ((2 * (data_sets_num + 1) > data_sets_size) && (data_sets_grow() != 0))
+    return -1;
+
   ds_copy = malloc(sizeof(*ds_copy));
   if (ds_copy == NULL)
     return -1;
@@ -1359,7 +3947,19 @@ EXPORT int plugin_register_data_set(const data_set_t *ds) {
   for (size_t i = 0; i < ds->ds_num; i++)
     memcpy(ds_copy->ds + i, ds->ds + i, sizeof(data_source_t));
 
-  return c_avl_insert(data_sets, (void *)ds_copy->type, (void *)ds_copy);
+  uint64_t hash = ident_hash(ds_copy->type);
+  data_sets[data_set_slot(ds_copy->type, hash)] =
+      (data_set_entry_t){.hash = hash, .ds = ds_copy};
+  data_sets_num++;
+
+  return 0;
+} /* }}} int data_set_register */
+
+EXPORT int plugin_register_data_set(const data_set_t *ds) {
+  pthread_mutex_lock(&register_lock);
+  int status = data_set_register(ds);
+  pthread_mutex_unlock(&register_lock);
+  return status;
 } /* int plugin_register_data_set */
 
 EXPORT int plugin_register_log(const char *name, plugin_log_cb callback,
@@ -1367,12 +3967,130 @@ EXPORT int plugin_register_log(const char *name, plugin_log_cb callback,
   return create_register_callback(&list_log, name, (void *)callback, ud);
 } /* int plugin_register_log */
 
+/* Delivers notifications taken from the queue of the notification callback
+ * `arg', one at a time. */
+static int plugin_notification_pooled(notification_t const *const *n, /* {{{ */
+                                      size_t num, void *arg) {
+  callback_func_t *cf = arg;
+  plugin_notification_cb callback = cf->cf_callback;
+  int status = 0;
+
+  for (size_t i = 0; i < num; i++)
+    if ((*callback)(n[i], &cf->cf_udata) != 0)
+      status = -1;
+
+  return status;
+} /* }}} int plugin_notification_pooled */
+
+static int plugin_notification_batch_pooled( /* {{{ */
+    notification_t const *const *n, size_t num, void *arg) {
+  callback_func_t *cf = arg;
+  plugin_notification_batch_cb callback = cf->cf_callback;
+
+  return (*callback)(n, num, &cf->cf_udata);
+} /* }}} int plugin_notification_batch_pooled */
+
+/* Gives the notification callback `cf' its own queue and threads if its
+ * plugin has been configured with "NotificationThreads". Must be called with
+ * `register_lock' held. */
+static void plugin_notification_queue_create(callback_func_t *cf, /* {{{ */
+                                             char const *name, bool batch) {
+  notification_queue_config_t const *conf = cf->cf_ctx.notification_queue;
+  if ((conf == NULL) || (cf->cf_nqueue != NULL))
+    return;
+
+  /* The threads inherit the callback's context. */
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  notification_queue_t *nq = notification_queue_create(
+      name, conf, batch ? conf->batch_size : 1,
+      batch ? plugin_notification_batch_pooled : plugin_notification_pooled,
+      cf);
+  plugin_set_ctx(old_ctx);
+  if (nq == NULL)
+    return;
+
+  pthread_rwlock_wrlock(&notification_queue_lock);
+  cf->cf_nqueue = nq;
+  pthread_rwlock_unlock(&notification_queue_lock);
+
+  INFO("plugin: Started %" PRIsz " notification thread%s for \"%s\".",
+       conf->threads, (conf->threads == 1) ? "" : "s", name);
+} /* }}} void plugin_notification_queue_create */
+
+/* Gives the notification callback `name' its own queue if it is registered
+ * after the queues have been started. */
+static void plugin_notification_callback_setup(llist_t *list, /* {{{ */
+                                               char const *name, bool batch) {
+  pthread_mutex_lock(&register_lock);
+  if (notification_queues_started) {
+    llentry_t *le = llist_search(list, name);
+    if (le != NULL)
+      plugin_notification_queue_create(le->value, name, batch);
+  }
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void plugin_notification_callback_setup */
+
 EXPORT int plugin_register_notification(const char *name,
                                         plugin_notification_cb callback,
                                         user_data_t const *ud) {
-  return create_register_callback(&list_notification, name, (void *)callback,
-                                  ud);
-} /* int plugin_register_log */
+  int status = create_register_callback(&list_notification, name,
+                                        (void *)callback, ud);
+  if (status == 0)
+    plugin_notification_callback_setup(list_notification, name,
+                                       /* batch = */ false);
+  return status;
+} /* int plugin_register_notification */
+
+EXPORT int
+plugin_register_notification_batch(const char *name,
+                                   plugin_notification_batch_cb callback,
+                                   user_data_t const *ud) {
+  int status = create_register_callback(&list_notification_batch, name,
+                                        (void *)callback, ud);
+  if (status == 0)
+    plugin_notification_callback_setup(list_notification_batch, name,
+                                       /* batch = */ true);
+  return status;
+} /* int plugin_register_notification_batch */
+
+/* Gives the notification callbacks configured with "NotificationThreads"
+ * their own queues. Called once the daemon has forked, so that the threads
+ * survive. */
+static void start_notification_queues(void) /* {{{ */
+{
+  pthread_mutex_lock(&register_lock);
+  for (llentry_t *le = llist_head(list_notification); le != NULL;
+       le = le->next)
+    plugin_notification_queue_create(le->value, le->key, /* batch = */ false);
+  for (llentry_t *le = llist_head(list_notification_batch); le != NULL;
+       le = le->next)
+    plugin_notification_queue_create(le->value, le->key, /* batch = */ true);
+  notification_queues_started = true;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void start_notification_queues */
+
+/* Delivers the notifications still queued and calls the notification
+ * callbacks directly from then on. Called before the shutdown callbacks, so
+ * that the plugins can still deliver them. */
+static void stop_notification_queues(void) /* {{{ */
+{
+  llist_t *lists[] = {list_notification, list_notification_batch};
+
+  pthread_mutex_lock(&register_lock);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++)
+    for (llentry_t *le = llist_head(lists[i]); le != NULL; le = le->next) {
+      callback_func_t *cf = le->value;
+
+      pthread_rwlock_wrlock(&notification_queue_lock);
+      notification_queue_t *nq = cf->cf_nqueue;
+      cf->cf_nqueue = NULL;
+      pthread_rwlock_unlock(&notification_queue_lock);
+
+      notification_queue_destroy(nq);
+    }
+  notification_queues_started = false;
+  pthread_mutex_unlock(&register_lock);
+} /* }}} void stop_notification_queues */
 
 EXPORT int plugin_unregister_config(const char *name) {
   cf_unregister(name);
@@ -1385,7 +4103,9 @@ EXPORT int plugin_unregister_complex_config(const char *name) {
 } /* int plugin_unregister_complex_config */
 
 EXPORT int plugin_unregister_init(const char *name) {
-  return plugin_unregister(list_init, name);
+  if (plugin_unregister(list_init, name) == 0)
+    return 0;
+  return plugin_unregister(list_init_parallel, name);
 }
 
 EXPORT int plugin_unregister_read(const char *name) /* {{{ */
@@ -1427,6 +4147,7 @@ EXPORT int plugin_unregister_read(const char *name) /* {{{ */
 
 EXPORT void plugin_log_available_writers(void) {
   log_list_callbacks(&list_write, "Available write targets:");
+  log_list_callbacks(&list_write_batch, "Available batch write targets:");
 }
 
 static int compare_read_func_group(llentry_t *e, void *ud) /* {{{ */
@@ -1488,7 +4209,9 @@ EXPORT int plugin_unregister_read_group(const char *group) /* {{{ */
 } /* }}} int plugin_unregister_read_group */
 
 EXPORT int plugin_unregister_write(const char *name) {
-  return plugin_unregister(list_write, name);
+  if (plugin_unregister(list_write, name) == 0)
+    return 0;
+  return plugin_unregister(list_write_batch, name);
 }
 
 EXPORT int plugin_unregister_flush(const char *name) {
@@ -1516,18 +4239,10 @@ EXPORT int plugin_unregister_shutdown(const char *name) {
 }
 
 EXPORT int plugin_unregister_data_set(const char *name) {
-  data_set_t *ds;
-
-  if (data_sets == NULL)
-    return -1;
-
-  if (c_avl_remove(data_sets, name, NULL, (void *)&ds) != 0)
-    return -1;
-
-  sfree(ds->ds);
-  sfree(ds);
-
-  return 0;
+  pthread_mutex_lock(&register_lock);
+  int status = data_set_unregister(name);
+  pthread_mutex_unlock(&register_lock);
+  return status;
 } /* int plugin_unregister_data_set */
 
 EXPORT int plugin_unregister_log(const char *name) {
@@ -1535,28 +4250,226 @@ EXPORT int plugin_unregister_log(const char *name) {
 }
 
 EXPORT int plugin_unregister_notification(const char *name) {
-  return plugin_unregister(list_notification, name);
+  if (plugin_unregister(list_notification, name) == 0)
+    return 0;
+  return plugin_unregister(list_notification_batch, name);
 }
 
+/* Init callbacks taking longer than this are logged at level "info". */
+#define SLOW_INIT_TIME TIME_T_TO_CDTIME_T(1)
+
+static int plugin_init_one(char const *name, callback_func_t *cf) /* {{{ */
+{
+  plugin_init_cb callback = cf->cf_callback;
+
+  cdtime_t start = cdtime();
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  int status = (*callback)();
+  plugin_set_ctx(old_ctx);
+  cdtime_t elapsed = cdtime() - start;
+
+  if (elapsed >= SLOW_INIT_TIME) {
+    INFO("Initialization of plugin `%s' took %.3f seconds.", name,
+         CDTIME_T_TO_DOUBLE(elapsed));
+  } else {
+    DEBUG("Initialization of plugin `%s' took %.3f seconds.", name,
+          CDTIME_T_TO_DOUBLE(elapsed));
+  }
+
+  if (status != 0) {
+    ERROR("Initialization of plugin `%s' "
+          "failed with status %i. "
+          "Plugin will be unloaded.",
+          name, status);
+    /* Plugins that register read callbacks from the init
+     * callback should take care of appropriate error
+     * handling themselves. */
+    /* FIXME: Unload _all_ functions */
+    plugin_unregister_read(name);
+  }
+
+  return status;
+} /* }}} int plugin_init_one */
+
+/* The independent init callbacks, taken from a snapshot of
+ * "list_init_parallel" by the init threads. */
+typedef struct {
+  pthread_mutex_t lock;
+  char **names;
+  callback_func_t **callbacks;
+  size_t num;
+  size_t next;
+  int status;
+
+  pthread_t *threads;
+  size_t threads_num;
+} init_parallel_t;
+
+static void *plugin_init_thread(void *arg) /* {{{ */
+{
+  init_parallel_t *ip = arg;
+
+  pthread_mutex_lock(&ip->lock);
+  while (ip->next < ip->num) {
+    size_t i = ip->next++;
+    pthread_mutex_unlock(&ip->lock);
+
+    int status = plugin_init_one(ip->names[i], ip->callbacks[i]);
+
+    pthread_mutex_lock(&ip->lock);
+    if (status != 0)
+      ip->status = -1;
+  }
+  pthread_mutex_unlock(&ip->lock);
+
+  return NULL;
+} /* }}} void *plugin_init_thread */
+
+static void plugin_init_parallel_free(init_parallel_t *ip) /* {{{ */
+{
+  sfree(ip->names);
+  sfree(ip->callbacks);
+  sfree(ip->threads);
+  ip->num = 0;
+  ip->threads_num = 0;
+} /* }}} void plugin_init_parallel_free */
+
+/* Starts "InitThreads" threads calling the independent init callbacks. With
+ * no threads, they are called by plugin_init_parallel_wait. */
+static int plugin_init_parallel_start(init_parallel_t *ip) /* {{{ */
+{
+  int num = llist_size(list_init_parallel);
+  if (num <= 0)
+    return 0;
+
+  ip->names = calloc((size_t)num, sizeof(*ip->names));
+  ip->callbacks = calloc((size_t)num, sizeof(*ip->callbacks));
+  if ((ip->names == NULL) || (ip->callbacks == NULL)) {
+    ERROR("plugin_init_all: calloc failed.");
+    plugin_init_parallel_free(ip);
+    return ENOMEM;
+  }
+
+  /* Independent init callbacks registered by an init callback are not part
+   * of the snapshot and are not called. */
+  for (llentry_t *le = llist_head(list_init_parallel); le != NULL;
+       le = le->next) {
+    ip->names[ip->num] = le->key;
+    ip->callbacks[ip->num] = le->value;
+    ip->num++;
+  }
+
+  long threads_num = global_option_get_long("InitThreads", /* default = */ 4);
+  if (threads_num < 0) {
+    ERROR("InitThreads must be positive or zero.");
+    threads_num = 4;
+  }
+  if ((size_t)threads_num > ip->num)
+    threads_num = (long)ip->num;
+  if (threads_num == 0)
+    return 0;
+
+  ip->threads = calloc((size_t)threads_num, sizeof(*ip->threads));
+  if (ip->threads == NULL) {
+    ERROR("plugin_init_all: calloc failed.");
+    return 0;
+  }
+
+  for (long i = 0; i < threads_num; i++) {
+    int status = plugin_thread_create(&ip->threads[ip->threads_num],
+                                      /* attr = */ NULL, plugin_init_thread,
+                                      ip, "init");
+    if (status != 0) {
+      ERROR("plugin_init_all: Starting an init thread failed: %s",
+            STRERROR(status));
+      break;
+    }
+    ip->threads_num++;
+  }
+
+  return 0;
+} /* }}} int plugin_init_parallel_start */
+
+/* Waits for the independent init callbacks to return. Calls those no thread
+ * has taken yet, e.g. because no thread could be started. */
+static int plugin_init_parallel_wait(init_parallel_t *ip) /* {{{ */
+{
+  if (ip->num == 0)
+    return 0;
+
+  plugin_init_thread(ip);
+
+  for (size_t i = 0; i < ip->threads_num; i++)
+    pthread_join(ip->threads[i], /* retval = */ NULL);
+
+  int status = ip->status;
+  plugin_init_parallel_free(ip);
+  return status;
+} /* }}} int plugin_init_parallel_wait */
+
+/* The chains are replaced while values are dispatched when the configuration
+ * is reloaded. */
+EXPORT void plugin_update_chains(void) {
+  __atomic_store_n(&pre_cache_chain,
+                   fc_chain_get_by_name(global_option_get("PreCacheChain")),
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&post_cache_chain,
+                   fc_chain_get_by_name(global_option_get("PostCacheChain")),
+                   __ATOMIC_RELEASE);
+} /* void plugin_update_chains */
+
+/* Parses the CPU list of the global option `name', if set. */
+static void plugin_affinity_option(char const *name, /* {{{ */
+                                   affinity_set_t *set, bool *is_set) {
+  char const *str = global_option_get(name);
+
+  *is_set = false;
+  if (str == NULL)
+    return;
+
+  if ((affinity_parse(set, str) != 0) || (affinity_count(set) == 0)) {
+    ERROR("%s: \"%s\" is not a valid CPU list, such as \"0-3,8\".", name,
+          str);
+    return;
+  }
+  *is_set = true;
+} /* }}} void plugin_affinity_option */
+
 EXPORT int plugin_init_all(void) {
-  char const *chain_name;
   llentry_t *le;
   int status;
   int ret = 0;
 
+  if (IS_TRUE(global_option_get("CoarseClock"))) {
+    if (cdtime_set_coarse(true) != 0)
+      WARNING("CoarseClock: No coarse clock is available on this system.");
+    else
+      INFO("CoarseClock: Timestamps have a resolution of %.3f ms.",
+           1e3 * CDTIME_T_TO_DOUBLE(cdtime_coarse_resolution()));
+  }
+
   /* Init the value cache */
   uc_init();
+  uc_set_series_span(global_option_get_time("ValueCacheHistory",
+                                            /* default = */ 0));
+  uc_set_reorder_window(global_option_get_time("ValueCacheReorderWindow",
+                                               /* default = */ 0));
+  char const *cache_file = global_option_get("ValueCacheFile");
+  if (cache_file != NULL)
+    uc_load(cache_file);
 
   if (IS_TRUE(global_option_get("CollectInternalStats"))) {
     record_statistics = true;
     plugin_register_read("collectd", plugin_update_internal_statistics);
-  }
 
-  chain_name = global_option_get("PreCacheChain");
-  pre_cache_chain = fc_chain_get_by_name(chain_name);
+    /* Callbacks registered from now on get their statistics right away. */
+    callback_stats_init_all(list_write);
+    callback_stats_init_all(list_write_batch);
+    callback_stats_init_all(list_flush);
+    callback_stats_init_all(read_list);
+  }
 
-  chain_name = global_option_get("PostCacheChain");
-  post_cache_chain = fc_chain_get_by_name(chain_name);
+  plugin_update_chains();
 
   write_limit_high = global_option_get_long("WriteQueueLimitHigh",
                                             /* default = */ 0);
@@ -1577,48 +4490,88 @@ EXPORT int plugin_init_all(void) {
     write_limit_low = write_limit_high;
   }
 
-  write_threads_num = global_option_get_long("WriteThreads",
-                                             /* default = */ 5);
-  if (write_threads_num < 1) {
+  long write_threads = global_option_get_long("WriteThreads",
+                                              /* default = */ 5);
+  if (write_threads < 1) {
     ERROR("WriteThreads must be positive.");
-    write_threads_num = 5;
+    write_threads = 5;
+  }
+
+  long write_threads_max =
+      global_option_get_long("WriteThreadsMax",
+                             /* default = */ write_threads);
+  if (write_threads_max < write_threads) {
+    ERROR("WriteThreadsMax must not be smaller than WriteThreads.");
+    write_threads_max = write_threads;
+  }
+  write_threads_min = (size_t)write_threads;
+  write_scaling = (write_threads_max > write_threads);
+
+  plugin_affinity_option("ReadThreadsAffinity", &read_affinity,
+                         &read_affinity_set);
+  plugin_affinity_option("WriteThreadsAffinity", &write_affinity,
+                         &write_affinity_set);
+
+  write_nodes_num = 1;
+  if (IS_TRUE(global_option_get("WriteQueuePerNode"))) {
+    write_nodes_num = affinity_nodes_num();
+    if (write_nodes_num == 1)
+      NOTICE("WriteQueuePerNode: Only one NUMA node found.");
+    else if (write_threads < (long)write_nodes_num)
+      WARNING("WriteQueuePerNode: With fewer WriteThreads than NUMA nodes "
+              "(%" PRIsz "), values of some nodes are written by threads "
+              "of other nodes.",
+              write_nodes_num);
   }
 
-  if ((list_init == NULL) && (read_heap == NULL))
+  write_batch_size = (size_t)global_option_get_long("WriteBatchSize",
+                                                    /* default = */ 512);
+  if (write_batch_size < 1) {
+    ERROR("WriteBatchSize must be positive.");
+    write_batch_size = 512;
+  }
+
+  write_batch_timeout = global_option_get_time("WriteBatchTimeout",
+                                               /* default = */ MS_TO_CDTIME_T(10));
+  flush_deadline = global_option_get_time("FlushDeadline", /* default = */ 0);
+
+  status = create_write_shards((size_t)write_threads_max,
+                               (size_t)write_threads);
+  if (status != 0)
+    return status;
+
+  if ((list_init == NULL) && (list_init_parallel == NULL) &&
+      (read_heap == NULL))
     return ret;
 
+  cdtime_t init_start = cdtime();
+
+  /* The independent init callbacks run in the background while the others are
+   * called one after the other, in the order they have been registered. */
+  init_parallel_t ip = {
+      .lock = PTHREAD_MUTEX_INITIALIZER,
+  };
+  if (plugin_init_parallel_start(&ip) != 0)
+    ret = -1;
+
   /* Calling all init callbacks before checking if read callbacks
    * are available allows the init callbacks to register the read
    * callback. */
-  le = llist_head(list_init);
-  while (le != NULL) {
-    callback_func_t *cf;
-    plugin_init_cb callback;
-    plugin_ctx_t old_ctx;
-
-    cf = le->value;
-    old_ctx = plugin_set_ctx(cf->cf_ctx);
-    callback = cf->cf_callback;
-    status = (*callback)();
-    plugin_set_ctx(old_ctx);
-
-    if (status != 0) {
-      ERROR("Initialization of plugin `%s' "
-            "failed with status %i. "
-            "Plugin will be unloaded.",
-            le->key, status);
-      /* Plugins that register read callbacks from the init
-       * callback should take care of appropriate error
-       * handling themselves. */
-      /* FIXME: Unload _all_ functions */
-      plugin_unregister_read(le->key);
+  for (le = llist_head(list_init); le != NULL; le = le->next)
+    if (plugin_init_one(le->key, le->value) != 0)
       ret = -1;
-    }
 
-    le = le->next;
-  }
+  if (plugin_init_parallel_wait(&ip) != 0)
+    ret = -1;
 
-  start_write_threads((size_t)write_threads_num);
+  INFO("Initialization of %d plugins took %.3f seconds.",
+       llist_size(list_init) + llist_size(list_init_parallel),
+       CDTIME_T_TO_DOUBLE(cdtime() - init_start));
+
+  start_write_pools();
+  start_write_threads();
+  start_write_spools();
+  start_notification_queues();
 
   max_read_interval =
       global_option_get_time("MaxReadInterval", DEFAULT_MAX_READ_INTERVAL);
@@ -1630,15 +4583,26 @@ EXPORT int plugin_init_all(void) {
 
     rt = global_option_get("ReadThreads");
     num = atoi(rt);
-    if (num != -1)
-      start_read_threads((num > 0) ? ((size_t)num) : 5);
+    if (num != -1) {
+      size_t read_threads = (num > 0) ? ((size_t)num) : 5;
+      long read_threads_max = global_option_get_long(
+          "ReadThreadsMax", /* default = */ (long)read_threads);
+      if (read_threads_max < (long)read_threads) {
+        ERROR("ReadThreadsMax must not be smaller than ReadThreads.");
+        read_threads_max = (long)read_threads;
+      }
+      start_read_threads(read_threads, (size_t)read_threads_max);
+    }
   }
+
+  start_scaler_thread();
   return ret;
 } /* void plugin_init_all */
 
 /* TODO: Rename this function. */
 EXPORT void plugin_read_all(void) {
   uc_check_timeout();
+  ident_gc();
 
   return;
 } /* void plugin_read_all */
@@ -1689,123 +4653,381 @@ EXPORT int plugin_read_all_once(void) {
   return return_status;
 } /* int plugin_read_all_once */
 
+/* Writes `vl' via one entry of a snapshot. Late values are only passed to the
+ * callbacks of plugins configured with `AcceptLateValues'. */
+static int plugin_write_entry(write_entry_t const *we, /* {{{ */
+                              const data_set_t *ds, const value_list_t *vl) {
+  if (!we->cf->cf_ctx.late_values &&
+      (pthread_getspecific(late_value_key) != NULL)) {
+    DEBUG("plugin: plugin_write: Not passing a late value to %s.", we->name);
+    return 0;
+  }
+
+  if (we->batch) {
+    DEBUG("plugin: plugin_write: Queueing values for %s.", we->name);
+    return write_batch_append(we->name, we->cf, ds, vl);
+  }
+
+  DEBUG("plugin: plugin_write: Writing values via %s.", we->name);
+  return plugin_write_one(we->cf, ds, vl);
+} /* }}} int plugin_write_entry */
+
+/* Writes `vl' via all entries of a snapshot. */
+static int plugin_write_all(write_snapshot_t const *snapshot, /* {{{ */
+                            const data_set_t *ds, const value_list_t *vl) {
+  int success = 0;
+  int failure = 0;
+
+  for (size_t i = 0; i < snapshot->num; i++) {
+    write_entry_t const *we = snapshot->entries + i;
+
+    /* Keep the read plugin's interval and flush information but update the
+     * plugin name. */
+    plugin_ctx_t old_ctx = plugin_get_ctx();
+    if (!we->batch) {
+      plugin_ctx_t ctx = old_ctx;
+      ctx.name = we->cf->cf_ctx.name;
+      plugin_set_ctx(ctx);
+    }
+
+    if (plugin_write_entry(we, ds, vl) != 0)
+      failure++;
+    else
+      success++;
+
+    if (!we->batch)
+      plugin_set_ctx(old_ctx);
+  }
+
+  if ((success == 0) && (failure != 0))
+    return -1;
+  return 0;
+} /* }}} int plugin_write_all */
+
+static const data_set_t *plugin_write_get_ds(const data_set_t *ds, /* {{{ */
+                                             const value_list_t *vl) {
+  if (ds != NULL)
+    return ds;
+
+  ds = plugin_get_ds(vl->type);
+  if (ds == NULL)
+    ERROR("plugin_write: Unable to lookup type `%s'.", vl->type);
+  return ds;
+} /* }}} const data_set_t *plugin_write_get_ds */
+
 EXPORT int plugin_write(const char *plugin, /* {{{ */
                         const data_set_t *ds, const value_list_t *vl) {
-  llentry_t *le;
   int status;
 
   if (vl == NULL)
     return EINVAL;
 
-  if (list_write == NULL)
+  write_snapshot_t *snapshot = write_snapshot_enter();
+  if ((snapshot == NULL) || (snapshot->num == 0)) {
+    write_snapshot_leave();
     return ENOENT;
+  }
 
+  ds = plugin_write_get_ds(ds, vl);
   if (ds == NULL) {
-    ds = plugin_get_ds(vl->type);
-    if (ds == NULL) {
-      ERROR("plugin_write: Unable to lookup type `%s'.", vl->type);
-      return ENOENT;
-    }
+    write_snapshot_leave();
+    return ENOENT;
   }
 
   if (plugin == NULL) {
-    int success = 0;
-    int failure = 0;
+    status = plugin_write_all(snapshot, ds, vl);
+  } else {
+    /* do not switch plugin context; rather keep the context (interval)
+     * information of the calling read plugin */
+    write_entry_t const *we = write_snapshot_find(snapshot, plugin);
+    status = (we != NULL) ? plugin_write_entry(we, ds, vl) : ENOENT;
+  }
 
-    le = llist_head(list_write);
-    while (le != NULL) {
-      callback_func_t *cf = le->value;
-      plugin_write_cb callback;
+  write_snapshot_leave();
+  return status;
+} /* }}} int plugin_write */
 
-      /* Keep the read plugin's interval and flush information but update the
-       * plugin name. */
-      plugin_ctx_t old_ctx = plugin_get_ctx();
-      plugin_ctx_t ctx = old_ctx;
-      ctx.name = cf->cf_ctx.name;
-      plugin_set_ctx(ctx);
+EXPORT plugin_write_ref_t *plugin_write_ref_create(const char *name) /* {{{ */
+{
+  if (name == NULL)
+    return NULL;
 
-      DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-      callback = cf->cf_callback;
-      status = (*callback)(ds, vl, &cf->cf_udata);
-      if (status != 0)
-        failure++;
-      else
-        success++;
+  plugin_write_ref_t *ref = calloc(1, sizeof(*ref));
+  if (ref == NULL)
+    return NULL;
 
-      plugin_set_ctx(old_ctx);
-      le = le->next;
-    }
+  ref->name = strdup(name);
+  if (ref->name == NULL) {
+    free(ref);
+    return NULL;
+  }
+
+  return ref;
+} /* }}} plugin_write_ref_t *plugin_write_ref_create */
+
+EXPORT void plugin_write_ref_destroy(plugin_write_ref_t *ref) /* {{{ */
+{
+  if (ref == NULL)
+    return;
+
+  free(ref->name);
+  free(ref);
+} /* }}} void plugin_write_ref_destroy */
+
+EXPORT int plugin_write_ref(plugin_write_ref_t *ref, /* {{{ */
+                            const data_set_t *ds, const value_list_t *vl) {
+  if ((ref == NULL) || (vl == NULL))
+    return EINVAL;
+
+  write_snapshot_t *snapshot = write_snapshot_enter();
+  if (snapshot == NULL) {
+    write_snapshot_leave();
+    return ENOENT;
+  }
+
+  /* The callback is looked up again only after the snapshot has been
+   * replaced. Threads racing to update the cache store the same value. */
+  uint64_t generation = snapshot->generation << WRITE_REF_INDEX_BITS;
+  uint64_t cache = __atomic_load_n(&ref->cache, __ATOMIC_RELAXED);
+  if ((cache & ~WRITE_REF_INDEX_MASK) != generation) {
+    write_entry_t const *we = write_snapshot_find(snapshot, ref->name);
+    size_t index = (we != NULL) ? (size_t)(we - snapshot->entries) + 1 : 0;
+    if (index > WRITE_REF_INDEX_MASK)
+      index = 0;
+    cache = generation | (uint64_t)index;
+    __atomic_store_n(&ref->cache, cache, __ATOMIC_RELAXED);
+  }
+
+  size_t index = (size_t)(cache & WRITE_REF_INDEX_MASK);
+  int status = ENOENT;
+  if (index != 0) {
+    ds = plugin_write_get_ds(ds, vl);
+    if (ds != NULL)
+      status = plugin_write_entry(snapshot->entries + index - 1, ds, vl);
+  }
+
+  write_snapshot_leave();
+  return status;
+} /* }}} int plugin_write_ref */
+
+/* The flush callbacks of one plugin_flush() call, taken by the flush threads
+ * and the caller. The caller and every thread hold a reference, the last one
+ * frees it. Protected by `flush_lock'. */
+typedef struct {
+  size_t refs;
+  callback_func_t **callbacks;
+  size_t num;
+  size_t next;
+  /* The number of callbacks that have returned. */
+  size_t done;
+  cdtime_t timeout;
+  char *identifier;
+} flush_job_t;
 
-    if ((success == 0) && (failure != 0))
-      status = -1;
-    else
-      status = 0;
-  } else /* plugin != NULL */
-  {
-    callback_func_t *cf;
-    plugin_write_cb callback;
+/* Must be called with `flush_lock' held. */
+static void flush_job_unref(flush_job_t *job) /* {{{ */
+{
+  if (--job->refs > 0)
+    return;
 
-    le = llist_head(list_write);
-    while (le != NULL) {
-      if (strcasecmp(plugin, le->key) == 0)
-        break;
+  sfree(job->callbacks);
+  sfree(job->identifier);
+  sfree(job);
+} /* }}} void flush_job_unref */
 
-      le = le->next;
-    }
+/* Calls the callbacks of `job' nobody has taken yet. Must be called with
+ * `flush_lock' held. */
+static void plugin_flush_run(flush_job_t *job) /* {{{ */
+{
+  while (job->next < job->num) {
+    callback_func_t *cf = job->callbacks[job->next++];
+    pthread_mutex_unlock(&flush_lock);
 
-    if (le == NULL)
-      return ENOENT;
+    plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+    plugin_flush_cb callback = cf->cf_callback;
 
-    cf = le->value;
+    cdtime_t start = callback_stats_start(cf);
+    (*callback)(job->timeout, job->identifier, &cf->cf_udata);
+    callback_stats_end(cf, start);
 
-    /* do not switch plugin context; rather keep the context (interval)
-     * information of the calling read plugin */
+    plugin_set_ctx(old_ctx);
 
-    DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-    callback = cf->cf_callback;
-    status = (*callback)(ds, vl, &cf->cf_udata);
+    pthread_mutex_lock(&flush_lock);
+    job->done++;
+    pthread_cond_broadcast(&flush_cond);
   }
+} /* }}} void plugin_flush_run */
 
-  return status;
-} /* }}} int plugin_write */
+static void *plugin_flush_thread(void *arg) /* {{{ */
+{
+  flush_job_t *job = arg;
+
+  pthread_mutex_lock(&flush_lock);
+  plugin_flush_run(job);
+  flush_job_unref(job);
+  flush_threads_num--;
+  pthread_cond_broadcast(&flush_cond);
+  pthread_mutex_unlock(&flush_lock);
+
+  return NULL;
+} /* }}} void *plugin_flush_thread */
+
+/* Returns false if the flush callback `name' can be skipped because its write
+ * callback hasn't been written `identifier' since it was last flushed
+ * completely. A flush with a timeout of zero flushes everything, so the
+ * identifier, or all of them, are no longer pending afterwards. */
+static bool plugin_flush_pending(char const *name, /* {{{ */
+                                 cdtime_t timeout, char const *identifier) {
+  bool pending = true;
+
+  write_entry_t const *we = write_snapshot_find(write_snapshot_enter(), name);
+  write_pending_t *wp =
+      (we != NULL) ? __atomic_load_n(&we->cf->cf_pending, __ATOMIC_ACQUIRE)
+                   : NULL;
+
+  if ((wp != NULL) && (identifier != NULL)) {
+    uint64_t hash = ident_hash(identifier);
+    pending = write_pending_check(wp, hash);
+    /* Values written from now on are pending again. */
+    if (pending && (timeout == 0))
+      write_pending_remove(wp, hash);
+  } else if ((wp != NULL) && (timeout == 0)) {
+    write_pending_clear(wp);
+  }
 
-EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
-                        const char *identifier) {
-  llentry_t *le;
+  write_snapshot_leave();
+  return pending;
+} /* }}} bool plugin_flush_pending */
 
+/* Calls the flush callbacks concurrently. Waits until all of them have
+ * returned or, with a non-zero `deadline', until it has passed. Callbacks
+ * still running then are left to finish in the background. */
+static int plugin_flush_wait(char const *plugin, cdtime_t timeout, /* {{{ */
+                             char const *identifier, cdtime_t deadline) {
   if (list_flush == NULL)
     return 0;
 
-  le = llist_head(list_flush);
-  while (le != NULL) {
-    callback_func_t *cf;
-    plugin_flush_cb callback;
-    plugin_ctx_t old_ctx;
+  cdtime_t flush_start = record_statistics ? cdtime() : 0;
+
+  flush_job_t *job = calloc(1, sizeof(*job));
+  if (job != NULL)
+    job->callbacks =
+        calloc((size_t)llist_size(list_flush), sizeof(*job->callbacks));
+  if ((job == NULL) || (job->callbacks == NULL) ||
+      ((identifier != NULL) &&
+       ((job->identifier = strdup(identifier)) == NULL))) {
+    ERROR("plugin_flush: Allocating the flush job failed.");
+    if (job != NULL) {
+      sfree(job->callbacks);
+      sfree(job);
+    }
+    return ENOMEM;
+  }
+  job->refs = 1;
+  job->timeout = timeout;
 
-    if ((plugin != NULL) && (strcmp(plugin, le->key) != 0)) {
-      le = le->next;
+  for (llentry_t *le = llist_head(list_flush); le != NULL; le = le->next) {
+    if ((plugin != NULL) && (strcmp(plugin, le->key) != 0))
+      continue;
+    if (!plugin_flush_pending(le->key, timeout, identifier))
       continue;
+    job->callbacks[job->num++] = le->value;
+  }
+
+  /* Without a deadline, the caller calls one of the callbacks itself, so a
+   * single callback is called without starting a thread. */
+  size_t threads_num = job->num;
+  if ((deadline == 0) && (threads_num > 0))
+    threads_num--;
+  if (threads_num > FLUSH_THREADS_MAX)
+    threads_num = FLUSH_THREADS_MAX;
+
+  pthread_mutex_lock(&flush_lock);
+  size_t started = 0;
+  for (; started < threads_num; started++) {
+    pthread_t thread;
+
+    job->refs++;
+    flush_threads_num++;
+    int status = plugin_thread_create(&thread, /* attr = */ NULL,
+                                      plugin_flush_thread, job, "flush");
+    if (status != 0) {
+      job->refs--;
+      flush_threads_num--;
+      ERROR("plugin_flush: Starting a flush thread failed: %s",
+            STRERROR(status));
+      break;
     }
+    pthread_detach(thread);
+  }
 
-    cf = le->value;
-    old_ctx = plugin_set_ctx(cf->cf_ctx);
-    callback = cf->cf_callback;
+  if ((deadline == 0) || (started == 0)) {
+    plugin_flush_run(job);
+    deadline = 0;
+  }
 
-    (*callback)(timeout, identifier, &cf->cf_udata);
+  cdtime_t end = cdtime() + deadline;
+  while (job->done < job->num) {
+    if (deadline == 0)
+      pthread_cond_wait(&flush_cond, &flush_lock);
+    else if (cdtime() < end)
+      pthread_cond_timedwait(&flush_cond, &flush_lock,
+                             &CDTIME_T_TO_TIMESPEC(end));
+    else
+      break;
+  }
 
-    plugin_set_ctx(old_ctx);
+  int status = 0;
+  if (job->done < job->num) {
+    WARNING("plugin_flush: %" PRIsz " of %" PRIsz " flush callbacks haven't "
+            "returned within the deadline of %.3f seconds.",
+            job->num - job->done, job->num, CDTIME_T_TO_DOUBLE(deadline));
+    status = ETIMEDOUT;
+  }
+  flush_job_unref(job);
+  pthread_mutex_unlock(&flush_lock);
 
-    le = le->next;
+  if (record_statistics) {
+    stage_counter_t stages[STAGE_NUM] = {{0}};
+    stages[STAGE_FLUSH] = (stage_counter_t){1, cdtime() - flush_start};
+    stage_counters_add(stages);
   }
-  return 0;
+
+  return status;
+} /* }}} int plugin_flush_wait */
+
+EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
+                        const char *identifier) {
+  return plugin_flush_wait(plugin, timeout, identifier, flush_deadline);
 } /* int plugin_flush */
 
+/* Waits for the flush callbacks that have outlived their deadline. */
+static void wait_flush_threads(void) /* {{{ */
+{
+  pthread_mutex_lock(&flush_lock);
+  while (flush_threads_num > 0)
+    pthread_cond_wait(&flush_cond, &flush_lock);
+  pthread_mutex_unlock(&flush_lock);
+} /* }}} void wait_flush_threads */
+
+static void stop_event_loop(void) {
+  pthread_mutex_lock(&event_loop_lock);
+  event_loop_t *el = event_loop;
+  event_loop = NULL;
+  pthread_mutex_unlock(&event_loop_lock);
+
+  event_loop_destroy(el);
+} /* void stop_event_loop */
+
 EXPORT int plugin_shutdown_all(void) {
   llentry_t *le;
   int ret = 0; // Assume success.
 
   destroy_all_callbacks(&list_init);
+  destroy_all_callbacks(&list_init_parallel);
 
+  /* Before stopping the threads it may start. */
+  stop_scaler_thread();
   stop_read_threads();
 
   pthread_mutex_lock(&read_lock);
@@ -1817,11 +5039,21 @@ EXPORT int plugin_shutdown_all(void) {
 
   /* blocks until all write threads have shut down. */
   stop_write_threads();
+  stop_write_pools();
+  stop_write_spools();
+  stop_notification_queues();
+
+  /* Nothing updates the cache anymore. */
+  char const *cache_file = global_option_get("ValueCacheFile");
+  if (cache_file != NULL)
+    uc_save(cache_file);
 
   /* ask all plugins to write out the state they kept. */
-  plugin_flush(/* plugin = */ NULL,
-               /* timeout = */ 0,
-               /* identifier = */ NULL);
+  plugin_flush_wait(/* plugin = */ NULL,
+                    /* timeout = */ 0,
+                    /* identifier = */ NULL,
+                    /* deadline = */ 0);
+  wait_flush_threads();
 
   le = NULL;
   if (list_shutdown != NULL)
@@ -1853,14 +5085,23 @@ EXPORT int plugin_shutdown_all(void) {
    * the free_function to NULL when registering the flush callback and to
    * the real free function when registering the write callback. This way
    * the data isn't freed twice. */
+  /* File descriptors which the shutdown callbacks didn't unregister. */
+  stop_event_loop();
+
   destroy_all_callbacks(&list_flush);
   destroy_all_callbacks(&list_missing);
+  write_snapshot_destroy();
   destroy_all_callbacks(&list_write);
+  destroy_all_callbacks(&list_write_batch);
 
   destroy_all_callbacks(&list_notification);
+  destroy_all_callbacks(&list_notification_batch);
   destroy_all_callbacks(&list_shutdown);
   destroy_all_callbacks(&list_log);
 
+  /* Value lists dispatched by shutdown callbacks are never written. */
+  destroy_write_shards();
+
   plugin_free_loaded();
   plugin_free_data_sets();
   return ret;
@@ -1921,7 +5162,7 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   if (vl->meta == NULL)
     free_meta_data = true;
 
-  if (list_write == NULL)
+  if ((list_write == NULL) && (list_write_batch == NULL))
     c_complain_once(LOG_WARNING, &no_write_complaint,
                     "plugin_dispatch_values: No write callback has been "
                     "registered. Please load at least one output plugin, "
@@ -1934,8 +5175,8 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
     return -1;
   }
 
-  data_set_t *ds = NULL;
-  if (c_avl_get(data_sets, vl->type, (void *)&ds) != 0) {
+  data_set_t *ds = data_set_lookup(vl->type);
+  if (ds == NULL) {
     char ident[6 * DATA_MAX_NAME_LEN];
 
     FORMAT_VL(ident, sizeof(ident), vl);
@@ -1953,11 +5194,8 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
         vl->host, vl->plugin, vl->plugin_instance, vl->type, vl->type_instance);
 
 #if COLLECT_DEBUG
+  /* data_set_lookup() has compared the names already. */
   assert(0 == strcmp(ds->type, vl->type));
-#else
-  if (0 != strcmp(ds->type, vl->type))
-    WARNING("plugin_dispatch_values: (ds->type = %s) != (vl->type = %s)",
-            ds->type, vl->type);
 #endif
 
 #if COLLECT_DEBUG
@@ -1978,22 +5216,65 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   escape_slashes(vl->type, sizeof(vl->type));
   escape_slashes(vl->type_instance, sizeof(vl->type_instance));
 
-  if (pre_cache_chain != NULL) {
-    status = fc_process_chain(ds, vl, pre_cache_chain);
+#if COLLECT_DEBUG
+  if (vl->ident != NULL) {
+    char name[6 * DATA_MAX_NAME_LEN];
+    format_name(name, sizeof(name), vl->host, vl->plugin, vl->plugin_instance,
+                vl->type, vl->type_instance);
+    assert(strcmp(name, vl->ident->name) == 0);
+  }
+#endif
+
+  stage_counter_t stages[STAGE_NUM] = {{0}};
+  cdtime_t t = record_statistics ? cdtime() : 0;
+
+  fc_chain_t *chain = __atomic_load_n(&pre_cache_chain, __ATOMIC_ACQUIRE);
+  if (chain != NULL) {
+    status = fc_process_chain(ds, vl, chain);
+    if (record_statistics) {
+      cdtime_t now = cdtime();
+      stages[STAGE_PRE_CACHE] = (stage_counter_t){1, now - t};
+      t = now;
+    }
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "pre-cache chain failed with "
               "status %i (%#x).",
               status, status);
-    } else if (status == FC_TARGET_STOP)
+    } else if (status == FC_TARGET_STOP) {
+      if (record_statistics)
+        stage_counters_add(stages);
       return 0;
+    }
+  }
+
+  /* Update the value cache. Values that are older than the cache entry are
+   * only written if they are within the reorder window, and then only by the
+   * plugins accepting late values. */
+  status = uc_update(ds, vl);
+  if (record_statistics) {
+    cdtime_t now = cdtime();
+    stages[STAGE_CACHE_UPDATE] = (stage_counter_t){1, now - t};
+    t = now;
+  }
+
+  if (status == UC_UPDATE_TOO_OLD) {
+    if (record_statistics)
+      stage_counters_add(stages);
+    if (free_meta_data && (vl->meta != NULL)) {
+      meta_data_destroy(vl->meta);
+      vl->meta = NULL;
+    }
+    return 0;
   }
 
-  /* Update the value cache */
-  uc_update(ds, vl);
+  bool late = (status == UC_UPDATE_LATE);
+  if (late)
+    pthread_setspecific(late_value_key, vl);
 
-  if (post_cache_chain != NULL) {
-    status = fc_process_chain(ds, vl, post_cache_chain);
+  chain = __atomic_load_n(&post_cache_chain, __ATOMIC_ACQUIRE);
+  if (chain != NULL) {
+    status = fc_process_chain(ds, vl, chain);
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "post-cache chain failed with "
@@ -2003,6 +5284,15 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   } else
     fc_default_action(ds, vl);
 
+  if (late)
+    pthread_setspecific(late_value_key, NULL);
+  uc_clear_rates();
+
+  if (record_statistics) {
+    stages[STAGE_POST_CACHE] = (stage_counter_t){1, cdtime() - t};
+    stage_counters_add(stages);
+  }
+
   if ((free_meta_data == true) && (vl->meta != NULL)) {
     meta_data_destroy(vl->meta);
     vl->meta = NULL;
@@ -2011,15 +5301,19 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   return 0;
 } /* int plugin_dispatch_values_internal */
 
-static double get_drop_probability(void) /* {{{ */
+/* Returns the probability with which values of the given write priority are
+ * dropped. Between the low and the high limit, the probability of values with
+ * normal priority grows linearly. Values with low priority are dropped twice
+ * as fast, i.e. all of them halfway between the limits, and values with high
+ * priority are only dropped from halfway on. So the lowest priority is shed
+ * first and the capacity that is left goes to the important values. */
+static double get_drop_probability(int priority) /* {{{ */
 {
   long pos;
   long size;
   long wql;
 
-  pthread_mutex_lock(&write_lock);
-  wql = write_queue_length;
-  pthread_mutex_unlock(&write_lock);
+  wql = plugin_write_queue_length();
 
   if (wql < write_limit_low)
     return 0.0;
@@ -2029,10 +5323,22 @@ static double get_drop_probability(void) /* {{{ */
   pos = 1 + wql - write_limit_low;
   size = 1 + write_limit_high - write_limit_low;
 
-  return (double)pos / (double)size;
+  double p = (double)pos / (double)size;
+  if (priority < WRITE_PRIORITY_NORMAL)
+    p = 2.0 * p;
+  else if (priority > WRITE_PRIORITY_NORMAL)
+    p = 2.0 * p - 1.0;
+
+  if (p <= 0.0)
+    return 0.0;
+  if (p >= 1.0)
+    return 1.0;
+  return p;
 } /* }}} double get_drop_probability */
 
-static bool check_drop_value(void) /* {{{ */
+/* Decides whether the "num" values the calling plugin is dispatching are to be
+ * dropped because the write queue is over its limit, and counts them if so. */
+static bool check_drop_value(size_t num) /* {{{ */
 {
   static cdtime_t last_message_time;
   static pthread_mutex_t last_message_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -2044,7 +5350,13 @@ static bool check_drop_value(void) /* {{{ */
   if (write_limit_high == 0)
     return false;
 
-  p = get_drop_probability();
+  int priority = plugin_get_ctx().write_priority;
+  if (priority < WRITE_PRIORITY_LOW)
+    priority = WRITE_PRIORITY_LOW;
+  else if (priority > WRITE_PRIORITY_HIGH)
+    priority = WRITE_PRIORITY_HIGH;
+
+  p = get_drop_probability(priority);
   if (p == 0.0)
     return false;
 
@@ -2056,33 +5368,56 @@ static bool check_drop_value(void) /* {{{ */
     if ((now - last_message_time) > TIME_T_TO_CDTIME_T(1)) {
       last_message_time = now;
       ERROR("plugin_dispatch_values: Low water mark "
-            "reached. Dropping %.0f%% of metrics.",
-            100.0 * p);
+            "reached. Dropping %.0f%% of metrics with %s priority.",
+            100.0 * p, write_priority_names[priority - WRITE_PRIORITY_LOW]);
     }
     pthread_mutex_unlock(&last_message_lock);
   }
 
-  if (p == 1.0)
-    return true;
+  if (p < 1.0) {
+    q = cdrand_d();
+    if (q >= p)
+      return false;
+  }
 
-  q = cdrand_d();
-  if (q > p)
-    return true;
-  else
-    return false;
+  if (record_statistics)
+    shard_counter_add(stats_values_dropped + (priority - WRITE_PRIORITY_LOW),
+                      num);
+  return true;
 } /* }}} bool check_drop_value */
 
+/* Marks the adaptive read function running in this thread, if any, as changed
+ * if the rates of "vl" differ from the cached ones. */
+static void plugin_read_check_change(value_list_t const *vl) /* {{{ */
+{
+  if (!read_func_key_initialized)
+    return;
+
+  read_func_t *rf = pthread_getspecific(read_func_key);
+  if ((rf == NULL) || rf->rf_changed)
+    return;
+
+  /* The defaults that are filled in when the values are queued. */
+  value_list_t copy = *vl;
+  if (copy.host[0] == 0)
+    sstrncpy(copy.host, hostname_g, sizeof(copy.host));
+  if (copy.time == 0)
+    copy.time = plugin_value_time();
+
+  data_set_t const *ds = plugin_get_ds(copy.type);
+  gauge_t change = NAN;
+  if ((ds == NULL) || (uc_get_rate_change(ds, &copy, &change) != 0) ||
+      !(change <= ADAPTIVE_INTERVAL_TOLERANCE))
+    rf->rf_changed = true;
+} /* }}} void plugin_read_check_change */
+
 EXPORT int plugin_dispatch_values(value_list_t const *vl) {
   int status;
 
-  if (check_drop_value()) {
-    if (record_statistics) {
-      pthread_mutex_lock(&statistics_lock);
-      stats_values_dropped++;
-      pthread_mutex_unlock(&statistics_lock);
-    }
+  if (check_drop_value(1))
     return 0;
-  }
+
+  plugin_read_check_change(vl);
 
   status = plugin_write_enqueue(vl);
   if (status != 0) {
@@ -2095,92 +5430,162 @@ EXPORT int plugin_dispatch_values(value_list_t const *vl) {
   return 0;
 }
 
+EXPORT int plugin_dispatch_values_batch(value_list_t const *vls, /* {{{ */
+                                        size_t vls_num) {
+  if (check_drop_value(vls_num))
+    return 0;
+
+  for (size_t i = 0; i < vls_num; i++)
+    plugin_read_check_change(vls + i);
+
+  int status = plugin_write_enqueue_batch(vls, vls_num);
+  if (status != 0) {
+    ERROR("plugin_dispatch_values_batch: plugin_write_enqueue_batch failed "
+          "with status %i (%s).",
+          status, STRERROR(status));
+    return status;
+  }
+
+  return 0;
+} /* }}} int plugin_dispatch_values_batch */
+
 __attribute__((sentinel)) int
 plugin_dispatch_multivalue(value_list_t const *template, /* {{{ */
                            bool store_percentage, int store_type, ...) {
   value_list_t *vl;
+  value_list_t *vls;
+  value_t *values;
+  size_t vls_num = 0;
   int failed = 0;
   gauge_t sum = 0.0;
   va_list ap;
 
-  if (check_drop_value()) {
-    if (record_statistics) {
-      pthread_mutex_lock(&statistics_lock);
-      stats_values_dropped++;
-      pthread_mutex_unlock(&statistics_lock);
-    }
-    return 0;
-  }
-
   assert(template->values_len == 1);
 
-  /* Calculate sum for Gauge to calculate percent if needed */
-  if (DS_TYPE_GAUGE == store_type) {
-    va_start(ap, store_type);
-    while (42) {
-      char const *name;
-      gauge_t value;
+  /* Count the values and calculate the sum for Gauge to calculate percent if
+   * needed. Every variadic value has the size of a double or a 64 bit
+   * integer, so they are all skipped as uint64_t when only counting. */
+  va_start(ap, store_type);
+  while (42) {
+    char const *name;
 
-      name = va_arg(ap, char const *);
-      if (name == NULL)
-        break;
+    name = va_arg(ap, char const *);
+    if (name == NULL)
+      break;
+    vls_num++;
 
-      value = va_arg(ap, gauge_t);
+    if (DS_TYPE_GAUGE == store_type) {
+      gauge_t value = va_arg(ap, gauge_t);
       if (!isnan(value))
         sum += value;
+    } else {
+      (void)va_arg(ap, uint64_t);
     }
-    va_end(ap);
   }
+  va_end(ap);
+
+  if (vls_num == 0)
+    return 0;
+
+  if (check_drop_value(vls_num))
+    return 0;
 
   vl = plugin_value_list_clone(template);
+  vls = calloc(vls_num, sizeof(*vls));
+  values = calloc(vls_num, sizeof(*values));
+  if ((vl == NULL) || (vls == NULL) || (values == NULL)) {
+    plugin_value_list_free(vl);
+    sfree(vls);
+    sfree(values);
+    return (int)vls_num;
+  }
   /* plugin_value_list_clone makes sure vl->time is set to non-zero. */
+  /* The type instance is overwritten below. */
+  ident_reset(vl);
   if (store_percentage)
     sstrncpy(vl->type, "percent", sizeof(vl->type));
 
+  size_t n = 0;
   va_start(ap, store_type);
   while (42) {
     char const *name;
-    int status;
+    value_t *v = values + n;
 
     /* Set the type instance. */
     name = va_arg(ap, char const *);
     if (name == NULL)
       break;
-    sstrncpy(vl->type_instance, name, sizeof(vl->type_instance));
 
     /* Set the value. */
     switch (store_type) {
     case DS_TYPE_GAUGE:
-      vl->values[0].gauge = va_arg(ap, gauge_t);
+      v->gauge = va_arg(ap, gauge_t);
       if (store_percentage)
-        vl->values[0].gauge *= sum ? (100.0 / sum) : NAN;
+        v->gauge *= sum ? (100.0 / sum) : NAN;
       break;
     case DS_TYPE_ABSOLUTE:
-      vl->values[0].absolute = va_arg(ap, absolute_t);
+      v->absolute = va_arg(ap, absolute_t);
       break;
     case DS_TYPE_COUNTER:
-      vl->values[0].counter = va_arg(ap, counter_t);
+      v->counter = va_arg(ap, counter_t);
       break;
     case DS_TYPE_DERIVE:
-      vl->values[0].derive = va_arg(ap, derive_t);
+      v->derive = va_arg(ap, derive_t);
       break;
     default:
       ERROR("plugin_dispatch_multivalue: given store_type is incorrect.");
+      (void)va_arg(ap, uint64_t);
       failed++;
+      continue;
     }
 
-    status = plugin_write_enqueue(vl);
-    if (status != 0)
-      failed++;
+    /* The value lists share the template's meta data; it is copied when
+     * they are enqueued. */
+    vls[n] = *vl;
+    vls[n].values = v;
+    vls[n].values_len = 1;
+    sstrncpy(vls[n].type_instance, name, sizeof(vls[n].type_instance));
+    n++;
   }
   va_end(ap);
 
+  /* All value lists of one call usually differ only in the type instance;
+   * they are enqueued together so each write shard is locked only once. */
+  if ((n > 0) && (plugin_write_enqueue_batch(vls, n) != 0))
+    failed++;
+
+  sfree(vls);
+  sfree(values);
   plugin_value_list_free(vl);
   return failed;
 } /* }}} int plugin_dispatch_multivalue */
 
+/* Queues the notification if the callback has its own queue, and calls the
+ * callback otherwise. */
+static int plugin_notification_call(callback_func_t *cf, /* {{{ */
+                                    notification_t const *notif, bool batch) {
+  pthread_rwlock_rdlock(&notification_queue_lock);
+  if (cf->cf_nqueue != NULL) {
+    int status = notification_queue_enqueue(cf->cf_nqueue, notif);
+    pthread_rwlock_unlock(&notification_queue_lock);
+    /* Dropped notifications are counted and complained about by the
+     * queue. */
+    return (status == EAGAIN) ? 0 : status;
+  }
+  pthread_rwlock_unlock(&notification_queue_lock);
+
+  /* do not switch plugin context; rather keep the context
+   * (interval) information of the calling plugin */
+  if (batch) {
+    plugin_notification_batch_cb callback = cf->cf_callback;
+    return (*callback)(&notif, 1, &cf->cf_udata);
+  }
+
+  plugin_notification_cb callback = cf->cf_callback;
+  return (*callback)(notif, &cf->cf_udata);
+} /* }}} int plugin_notification_call */
+
 EXPORT int plugin_dispatch_notification(const notification_t *notif) {
-  llentry_t *le;
   /* Possible TODO: Add flap detection here */
 
   DEBUG("plugin_dispatch_notification: severity = %i; message = %s; "
@@ -2189,28 +5594,20 @@ EXPORT int plugin_dispatch_notification(const notification_t *notif) {
         notif->host);
 
   /* Nobody cares for notifications */
-  if (list_notification == NULL)
+  if ((list_notification == NULL) && (list_notification_batch == NULL))
     return -1;
 
-  le = llist_head(list_notification);
-  while (le != NULL) {
-    callback_func_t *cf;
-    plugin_notification_cb callback;
-    int status;
-
-    /* do not switch plugin context; rather keep the context
-     * (interval) information of the calling plugin */
-
-    cf = le->value;
-    callback = cf->cf_callback;
-    status = (*callback)(notif, &cf->cf_udata);
-    if (status != 0) {
-      WARNING("plugin_dispatch_notification: Notification "
-              "callback %s returned %i.",
-              le->key, status);
+  llist_t *lists[] = {list_notification, list_notification_batch};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    for (llentry_t *le = llist_head(lists[i]); le != NULL; le = le->next) {
+      int status = plugin_notification_call(le->value, notif,
+                                            lists[i] == list_notification_batch);
+      if (status != 0) {
+        WARNING("plugin_dispatch_notification: Notification "
+                "callback %s returned %i.",
+                le->key, status);
+      }
     }
-
-    le = le->next;
   }
 
   return 0;
@@ -2304,14 +5701,13 @@ EXPORT int parse_notif_severity(const char *severity) {
 } /* int parse_notif_severity */
 
 EXPORT const data_set_t *plugin_get_ds(const char *name) {
-  data_set_t *ds;
-
   if (data_sets == NULL) {
     P_ERROR("plugin_get_ds: No data sets are defined yet.");
     return NULL;
   }
 
-  if (c_avl_get(data_sets, name, (void *)&ds) != 0) {
+  data_set_t *ds = data_set_lookup(name);
+  if (ds == NULL) {
     DEBUG("No such dataset registered: %s", name);
     return NULL;
   }
@@ -2492,6 +5888,7 @@ static plugin_ctx_t *plugin_ctx_create(void) {
 
 EXPORT void plugin_init_ctx(void) {
   pthread_key_create(&plugin_ctx_key, plugin_ctx_destructor);
+  pthread_key_create(&late_value_key, /* destructor = */ NULL);
   plugin_ctx_key_initialized = true;
 } /* void plugin_init_ctx */
 
@@ -2543,6 +5940,10 @@ EXPORT cdtime_t plugin_get_interval(void) {
   return cf_get_default_interval();
 } /* cdtime_t plugin_get_interval */
 
+EXPORT long plugin_get_write_queue_length(void) {
+  return plugin_write_queue_length();
+} /* long plugin_get_write_queue_length */
+
 typedef struct {
   plugin_ctx_t ctx;
   void *(*start_routine)(void *);
@@ -2586,3 +5987,388 @@ int plugin_thread_create(pthread_t *thread, const pthread_attr_t *attr,
 
   return 0;
 } /* int plugin_thread_create */
+
+int plugin_thread_set_affinity(pthread_t thread, char const *cpus) /* {{{ */
+{
+  affinity_set_t set;
+
+  if ((affinity_parse(&set, cpus) != 0) || (affinity_count(&set) == 0))
+    return EINVAL;
+
+  return affinity_apply(thread, &set);
+} /* }}} int plugin_thread_set_affinity */
+
+typedef struct {
+  plugin_ctx_t ctx;
+  plugin_fd_cb callback;
+  user_data_t ud;
+} plugin_fd_t;
+
+static void plugin_fd_callback(int fd, void *arg) {
+  plugin_fd_t *pfd = arg;
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(pfd->ctx);
+  pfd->callback(fd, &pfd->ud);
+  plugin_set_ctx(old_ctx);
+} /* void plugin_fd_callback */
+
+static void plugin_fd_free(void *arg) {
+  plugin_fd_t *pfd = arg;
+
+  if (pfd->ud.free_func != NULL)
+    pfd->ud.free_func(pfd->ud.data);
+  sfree(pfd);
+} /* void plugin_fd_free */
+
+int plugin_register_fd(int fd, plugin_fd_cb callback, user_data_t const *ud) {
+  if ((fd < 0) || (callback == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&event_loop_lock);
+  if (event_loop == NULL) {
+    long threads_num = global_option_get_long("EventLoopThreads",
+                                              /* default = */ 2);
+    if (threads_num < 1) {
+      ERROR("EventLoopThreads must be positive.");
+      threads_num = 2;
+    }
+
+    event_loop = event_loop_create((size_t)threads_num);
+    if (event_loop == NULL) {
+      int status = errno;
+      pthread_mutex_unlock(&event_loop_lock);
+      P_ERROR("plugin_register_fd: Starting the event loop failed: %s",
+              STRERROR(status));
+      return status;
+    }
+    INFO("collectd: Started the event loop with %ld threads.", threads_num);
+  }
+  event_loop_t *el = event_loop;
+  pthread_mutex_unlock(&event_loop_lock);
+
+  plugin_fd_t *pfd = calloc(1, sizeof(*pfd));
+  if (pfd == NULL)
+    return ENOMEM;
+  pfd->ctx = plugin_get_ctx();
+  pfd->callback = callback;
+  if (ud != NULL)
+    pfd->ud = *ud;
+
+  int status =
+      event_loop_add(el, fd, plugin_fd_callback, plugin_fd_free, pfd);
+  if (status != 0) {
+    P_ERROR("plugin_register_fd: Watching file descriptor %d failed: %s", fd,
+            STRERROR(status));
+    sfree(pfd);
+  }
+  return status;
+} /* int plugin_register_fd */
+
+int plugin_unregister_fd(int fd) {
+  pthread_mutex_lock(&event_loop_lock);
+  event_loop_t *el = event_loop;
+  pthread_mutex_unlock(&event_loop_lock);
+
+  return event_loop_remove(el, fd);
+} /* int plugin_unregister_fd */
+
+/* A task of a fan-out pool. A task that is abandoned by plugin_fanout_wait is
+ * owned, and freed, by its thread from then on. */
+typedef struct plugin_fanout_task_s {
+  char *key;
+  plugin_fanout_cb read;
+  plugin_fanout_cb free_func;
+  void *task;
+  plugin_ctx_t ctx;
+  cdtime_t started;
+  bool abandoned;
+  struct plugin_fanout_task_s *next;
+} plugin_fanout_task_t;
+
+struct plugin_fanout_s {
+  char *name;
+  size_t threads_max;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  plugin_fanout_task_t *queue;
+  plugin_fanout_task_t *queue_tail;
+  /* Tasks being run, including the abandoned ones. */
+  plugin_fanout_task_t *running;
+  size_t running_num;
+  size_t abandoned_num;
+  size_t threads_num;
+  bool stop;
+  /* Set by plugin_fanout_destroy if abandoned tasks are still running. */
+  bool orphaned;
+};
+
+static void plugin_fanout_task_free(plugin_fanout_task_t *t) {
+  if (t == NULL)
+    return;
+  if (t->free_func != NULL)
+    t->free_func(t->task);
+  sfree(t->key);
+  sfree(t);
+} /* void plugin_fanout_task_free */
+
+static void plugin_fanout_free(plugin_fanout_t *f) {
+  pthread_mutex_destroy(&f->lock);
+  pthread_cond_destroy(&f->work_cond);
+  pthread_cond_destroy(&f->done_cond);
+  sfree(f->name);
+  sfree(f);
+} /* void plugin_fanout_free */
+
+static void *plugin_fanout_worker(void *arg) {
+  plugin_fanout_t *f = arg;
+
+  pthread_mutex_lock(&f->lock);
+  while (!f->stop) {
+    if (f->queue == NULL) {
+      pthread_cond_wait(&f->work_cond, &f->lock);
+      continue;
+    }
+
+    plugin_fanout_task_t *t = f->queue;
+    f->queue = t->next;
+    if (f->queue == NULL)
+      f->queue_tail = NULL;
+    t->started = cdtime();
+    t->next = f->running;
+    f->running = t;
+    f->running_num++;
+    pthread_mutex_unlock(&f->lock);
+
+    plugin_set_ctx(t->ctx);
+    t->read(t->task);
+
+    pthread_mutex_lock(&f->lock);
+    for (plugin_fanout_task_t **ptr = &f->running; *ptr != NULL;
+         ptr = &(*ptr)->next) {
+      if (*ptr == t) {
+        *ptr = t->next;
+        break;
+      }
+    }
+
+    bool abandoned = t->abandoned;
+    if (abandoned) {
+      f->abandoned_num--;
+      INFO("%s plugin: Reading \"%s\" has returned.", f->name, t->key);
+    } else {
+      f->running_num--;
+    }
+    pthread_cond_broadcast(&f->done_cond);
+
+    pthread_mutex_unlock(&f->lock);
+    plugin_fanout_task_free(t);
+    pthread_mutex_lock(&f->lock);
+
+    /* A replacement has been started in the meantime. */
+    if (abandoned && (f->threads_num > f->threads_max + f->abandoned_num))
+      break;
+  }
+
+  f->threads_num--;
+  pthread_cond_broadcast(&f->done_cond);
+  bool last = f->orphaned && (f->threads_num == 0);
+  pthread_mutex_unlock(&f->lock);
+
+  if (last)
+    plugin_fanout_free(f);
+  return NULL;
+} /* void *plugin_fanout_worker */
+
+/* plugin_fanout_start_threads makes sure that "threads_max" threads are not
+ * blocked by an abandoned task. Must hold f->lock when calling. */
+static void plugin_fanout_start_threads(plugin_fanout_t *f) {
+  while (f->threads_num < f->threads_max + f->abandoned_num) {
+    pthread_t thread;
+    int status = plugin_thread_create(&thread, /* attr = */ NULL,
+                                      plugin_fanout_worker, f, f->name);
+    if (status != 0) {
+      ERROR("%s plugin: Starting a read thread failed: %s", f->name,
+            STRERROR(status));
+      break;
+    }
+    pthread_detach(thread);
+    f->threads_num++;
+  }
+} /* void plugin_fanout_start_threads */
+
+plugin_fanout_t *plugin_fanout_create(char const *name, size_t threads_num) {
+  if ((name == NULL) || (threads_num == 0))
+    return NULL;
+
+  plugin_fanout_t *f = calloc(1, sizeof(*f));
+  if (f == NULL)
+    return NULL;
+
+  f->name = strdup(name);
+  if (f->name == NULL) {
+    sfree(f);
+    return NULL;
+  }
+  f->threads_max = threads_num;
+
+  pthread_mutex_init(&f->lock, /* attr = */ NULL);
+  pthread_cond_init(&f->work_cond, /* attr = */ NULL);
+  pthread_cond_init(&f->done_cond, /* attr = */ NULL);
+
+  return f;
+} /* plugin_fanout_t *plugin_fanout_create */
+
+int plugin_fanout_destroy(plugin_fanout_t *f) {
+  if (f == NULL)
+    return 0;
+
+  pthread_mutex_lock(&f->lock);
+  f->stop = true;
+  pthread_cond_broadcast(&f->work_cond);
+
+  plugin_fanout_task_t *queue = f->queue;
+  f->queue = NULL;
+  f->queue_tail = NULL;
+
+  while (f->threads_num > f->abandoned_num)
+    pthread_cond_wait(&f->done_cond, &f->lock);
+
+  bool busy = (f->threads_num > 0);
+  f->orphaned = busy;
+  pthread_mutex_unlock(&f->lock);
+
+  /* The last abandoned task frees the pool when it returns. */
+  if (!busy)
+    plugin_fanout_free(f);
+
+  while (queue != NULL) {
+    plugin_fanout_task_t *t = queue;
+    queue = t->next;
+    plugin_fanout_task_free(t);
+  }
+  return busy ? EBUSY : 0;
+} /* int plugin_fanout_destroy */
+
+int plugin_fanout_submit(plugin_fanout_t *f, char const *key,
+                         plugin_fanout_cb read, plugin_fanout_cb free_func,
+                         void *task) {
+  if ((f == NULL) || (key == NULL) || (read == NULL)) {
+    if (free_func != NULL)
+      free_func(task);
+    return EINVAL;
+  }
+
+  plugin_fanout_task_t *t = calloc(1, sizeof(*t));
+  if (t == NULL) {
+    if (free_func != NULL)
+      free_func(task);
+    return ENOMEM;
+  }
+  t->read = read;
+  t->free_func = free_func;
+  t->task = task;
+  t->ctx = plugin_get_ctx();
+
+  t->key = strdup(key);
+  if (t->key == NULL) {
+    plugin_fanout_task_free(t);
+    return ENOMEM;
+  }
+
+  pthread_mutex_lock(&f->lock);
+  /* Don't block another thread on a device that is still hanging. */
+  for (plugin_fanout_task_t *r = f->running; r != NULL; r = r->next) {
+    if (r->abandoned && (strcmp(r->key, key) == 0)) {
+      pthread_mutex_unlock(&f->lock);
+      DEBUG("%s plugin: Skipping \"%s\", the previous read has not returned "
+            "yet.",
+            f->name, key);
+      plugin_fanout_task_free(t);
+      return EBUSY;
+    }
+  }
+
+  plugin_fanout_start_threads(f);
+  if (f->queue_tail == NULL)
+    f->queue = t;
+  else
+    f->queue_tail->next = t;
+  f->queue_tail = t;
+  pthread_cond_signal(&f->work_cond);
+  pthread_mutex_unlock(&f->lock);
+
+  return 0;
+} /* int plugin_fanout_submit */
+
+size_t plugin_fanout_wait(plugin_fanout_t *f, cdtime_t timeout) {
+  if (f == NULL)
+    return 0;
+  if (timeout == 0)
+    timeout = plugin_get_interval() / 2;
+
+  size_t failed = 0;
+  plugin_fanout_task_t *dropped = NULL;
+  /* Deadline for queued tasks while no thread runs a task. */
+  cdtime_t idle_deadline = cdtime() + timeout;
+
+  pthread_mutex_lock(&f->lock);
+  while ((f->queue != NULL) || (f->running_num > 0)) {
+    cdtime_t now = cdtime();
+    cdtime_t deadline = now + timeout;
+
+    for (plugin_fanout_task_t *t = f->running; t != NULL; t = t->next) {
+      if (t->abandoned)
+        continue;
+
+      if (t->started + timeout > now) {
+        if (t->started + timeout < deadline)
+          deadline = t->started + timeout;
+        continue;
+      }
+
+      WARNING("%s plugin: Reading \"%s\" did not return within %.3f "
+              "seconds. Skipping it until it does.",
+              f->name, t->key, CDTIME_T_TO_DOUBLE(timeout));
+      t->abandoned = true;
+      f->running_num--;
+      f->abandoned_num++;
+      failed++;
+    }
+
+    if (f->running_num > 0) {
+      idle_deadline = now + timeout;
+    } else if (f->queue == NULL) {
+      break;
+    } else if (now >= idle_deadline) {
+      /* Not a single thread is available, e.g. because starting them failed.
+       */
+      dropped = f->queue;
+      f->queue = NULL;
+      f->queue_tail = NULL;
+      break;
+    } else {
+      deadline = idle_deadline;
+    }
+
+    /* Replace the threads that are blocked now. */
+    plugin_fanout_start_threads(f);
+
+    struct timespec ts = CDTIME_T_TO_TIMESPEC(deadline);
+    pthread_cond_timedwait(&f->done_cond, &f->lock, &ts);
+  }
+  pthread_mutex_unlock(&f->lock);
+
+  while (dropped != NULL) {
+    plugin_fanout_task_t *t = dropped;
+    dropped = t->next;
+    WARNING("%s plugin: No thread has been available for reading \"%s\" "
+            "within %.3f seconds.",
+            f->name, t->key, CDTIME_T_TO_DOUBLE(timeout));
+    plugin_fanout_task_free(t);
+    failed++;
+  }
+
+  return failed;
+} /* size_t plugin_fanout_wait */
@@ -100,6 +100,20 @@ union value_u {
 };
 typedef union value_u value_t;
 
+/* Interned, immutable identifier. See utils_ident.h. */
+struct value_ident_s {
+  char *name;    /* formatted as by FORMAT_VL */
+  uint64_t hash; /* ident_hash (name) */
+
+  /* private */
+  pthread_mutex_t lock;
+  size_t refs;
+  struct value_ident_s *next;
+};
+typedef struct value_ident_s value_ident_t;
+
+/* If `ident' is not NULL, it must describe the identifier fields of the value
+ * list. Code modifying these fields must call `ident_reset' first. */
 struct value_list_s {
   value_t *values;
   size_t values_len;
@@ -111,11 +125,12 @@ struct value_list_s {
   char type[DATA_MAX_NAME_LEN];
   char type_instance[DATA_MAX_NAME_LEN];
   meta_data_t *meta;
+  value_ident_t *ident;
 };
 typedef struct value_list_s value_list_t;
 
 #define VALUE_LIST_INIT                                                        \
-  { .values = NULL, .meta = NULL }
+  { .values = NULL, .meta = NULL, .ident = NULL }
 
 struct data_source_s {
   char name[DATA_MAX_NAME_LEN];
@@ -171,11 +186,35 @@ struct user_data_s {
 };
 typedef struct user_data_s user_data_t;
 
+/* Priorities of the values dispatched by a plugin while the write queue is
+ * over its limit: values with a lower priority are dropped first, see
+ * "WriteQueuePriority". */
+#define WRITE_PRIORITY_LOW (-1)
+#define WRITE_PRIORITY_NORMAL 0
+#define WRITE_PRIORITY_HIGH 1
+
 struct plugin_ctx_s {
   char *name;
   cdtime_t interval;
+  /* If greater than "interval", read callbacks adapt their interval to the
+   * volatility of their values, up to this maximum. */
+  cdtime_t max_interval;
   cdtime_t flush_interval;
   cdtime_t flush_timeout;
+  /* Set if the values write callbacks fail to write are spooled, see
+   * write_spool.h. */
+  struct write_spool_config_s *spool;
+  /* Set if write callbacks get their own queue and threads, see
+   * write_pool.h. */
+  struct write_pool_config_s *write_pool;
+  /* Set if notification callbacks get their own queue and threads, see
+   * notification_queue.h. */
+  struct notification_queue_config_s *notification_queue;
+  /* Set if write callbacks are passed values that arrive late, see
+   * uc_set_reorder_window(). */
+  bool late_values;
+  /* One of the WRITE_PRIORITY_* constants. */
+  int write_priority;
 };
 typedef struct plugin_ctx_s plugin_ctx_t;
 
@@ -186,6 +225,11 @@ typedef int (*plugin_init_cb)(void);
 typedef int (*plugin_read_cb)(user_data_t *);
 typedef int (*plugin_write_cb)(const data_set_t *, const value_list_t *,
                                user_data_t *);
+/* Called with `num' value lists and their data sets. The value lists are only
+ * valid until the callback returns. */
+typedef int (*plugin_write_batch_cb)(data_set_t const *const *ds,
+                                     value_list_t const *const *vl, size_t num,
+                                     user_data_t *);
 typedef int (*plugin_flush_cb)(cdtime_t timeout, const char *identifier,
                                user_data_t *);
 /* "missing" callback. Returns less than zero on failure, zero if other
@@ -195,6 +239,10 @@ typedef int (*plugin_missing_cb)(const value_list_t *, user_data_t *);
 typedef void (*plugin_log_cb)(int severity, const char *message, user_data_t *);
 typedef int (*plugin_shutdown_cb)(void);
 typedef int (*plugin_notification_cb)(const notification_t *, user_data_t *);
+/* Called with `num' notifications, which are only valid until the callback
+ * returns. */
+typedef int (*plugin_notification_batch_cb)(notification_t const *const *n,
+                                            size_t num, user_data_t *);
 /*
  * NAME
  *  plugin_set_dir
@@ -235,6 +283,9 @@ void plugin_set_dir(const char *dir);
 int plugin_load(const char *name, bool global);
 
 int plugin_init_all(void);
+/* Looks up the `PreCacheChain' and `PostCacheChain' again, after the filter
+ * chains have been replaced. */
+void plugin_update_chains(void);
 void plugin_read_all(void);
 int plugin_read_all_once(void);
 int plugin_shutdown_all(void);
@@ -269,6 +320,31 @@ int plugin_shutdown_all(void);
 int plugin_write(const char *plugin, const data_set_t *ds,
                  const value_list_t *vl);
 
+struct plugin_write_ref_s;
+typedef struct plugin_write_ref_s plugin_write_ref_t;
+
+/*
+ * NAME
+ *  plugin_write_ref_create
+ *
+ * DESCRIPTION
+ *  Creates a reference to the write callback registered as `name', which
+ *  doesn't have to be registered yet. `plugin_write_ref' looks the callback up
+ *  again only after write callbacks have been registered or unregistered, so
+ *  that writing to a known plugin doesn't compare plugin names per value list.
+ *
+ * RETURN VALUE
+ *  A plugin_write_ref_t-pointer upon success or NULL upon failure. Free it
+ *  with `plugin_write_ref_destroy'.
+ */
+plugin_write_ref_t *plugin_write_ref_create(const char *name);
+void plugin_write_ref_destroy(plugin_write_ref_t *ref);
+
+/* Like `plugin_write' with the plugin of `ref'. Returns ENOENT if no such
+ * write callback is registered. */
+int plugin_write_ref(plugin_write_ref_t *ref, const data_set_t *ds,
+                     const value_list_t *vl);
+
 int plugin_flush(const char *plugin, cdtime_t timeout, const char *identifier);
 
 /*
@@ -281,7 +357,18 @@ int plugin_register_config(const char *name,
                            const char **keys, int keys_num);
 int plugin_register_complex_config(const char *type,
                                    int (*callback)(oconfig_item_t *));
+/* Plugins which can apply a changed configuration while running register
+ * this in addition to their complex config callback. When the configuration
+ * is reloaded and the plugin's <Plugin> blocks have changed, it is called
+ * with all of them merged into one block. */
+int plugin_register_reload(const char *type,
+                           int (*callback)(oconfig_item_t *));
 int plugin_register_init(const char *name, plugin_init_cb callback);
+/* Like plugin_register_init, for init callbacks which neither depend on other
+ * plugins having been initialized nor are needed by them, such as starting a
+ * virtual machine or loading MIBs. They are called concurrently with the other
+ * init callbacks, see the `InitThreads' option. */
+int plugin_register_parallel_init(const char *name, plugin_init_cb callback);
 int plugin_register_read(const char *name, int (*callback)(void));
 /* "user_data" will be freed automatically, unless
  * "plugin_register_complex_read" returns an error (non-zero). */
@@ -290,6 +377,12 @@ int plugin_register_complex_read(const char *group, const char *name,
                                  user_data_t const *user_data);
 int plugin_register_write(const char *name, plugin_write_cb callback,
                           user_data_t const *user_data);
+/* Like "plugin_register_write", but the write threads collect up to
+ * "WriteBatchSize" value lists (or as many as they get within
+ * "WriteBatchTimeout") per call of "callback". */
+int plugin_register_write_batch(const char *name,
+                                plugin_write_batch_cb callback,
+                                user_data_t const *user_data);
 int plugin_register_flush(const char *name, plugin_flush_cb callback,
                           user_data_t const *user_data);
 int plugin_register_missing(const char *name, plugin_missing_cb callback,
@@ -301,6 +394,12 @@ int plugin_register_log(const char *name, plugin_log_cb callback,
 int plugin_register_notification(const char *name,
                                  plugin_notification_cb callback,
                                  user_data_t const *user_data);
+/* Like "plugin_register_notification", but if the plugin has been configured
+ * with "NotificationThreads", "callback" gets up to "NotificationBatchSize"
+ * queued notifications at a time, e.g. to send them in one message. */
+int plugin_register_notification_batch(const char *name,
+                                       plugin_notification_batch_cb callback,
+                                       user_data_t const *user_data);
 
 int plugin_unregister_config(const char *name);
 int plugin_unregister_complex_config(const char *name);
@@ -343,6 +442,24 @@ void plugin_log_available_writers(void);
  */
 int plugin_dispatch_values(value_list_t const *vl);
 
+/*
+ * NAME
+ *  plugin_dispatch_values_batch
+ *
+ * DESCRIPTION
+ *  Dispatches `vls_num' value lists like `plugin_dispatch_values', but
+ *  enqueues them into the write queue together: each shard of the queue is
+ *  locked and its write thread woken up at most once per call. The order of
+ *  value lists with the same identifier is preserved. Read plugins that
+ *  submit many value lists per read should collect them and use this
+ *  function.
+ *
+ * RETURNS
+ *  Zero on success, an errno value if some value lists could not be
+ *  enqueued.
+ */
+int plugin_dispatch_values_batch(value_list_t const *vls, size_t vls_num);
+
 /*
  * NAME
  *  plugin_dispatch_multivalue
@@ -409,6 +526,10 @@ void daemon_log(int level, const char *format, ...)
 #define P_NOTICE(...) daemon_log(LOG_NOTICE, __VA_ARGS__)
 #define P_INFO(...) daemon_log(LOG_INFO, __VA_ARGS__)
 
+/* Returns the data set of the type `name' in constant time, or NULL. The
+ * pointer stays valid until shutdown, even if the type is replaced or
+ * unregistered, so plugins may look their types up once, when they are
+ * configured. */
 const data_set_t *plugin_get_ds(const char *name);
 
 int plugin_notification_meta_add_string(notification_t *n, const char *name,
@@ -447,6 +568,17 @@ plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx);
  */
 cdtime_t plugin_get_interval(void);
 
+/*
+ * NAME
+ *  plugin_get_write_queue_length
+ *
+ * DESCRIPTION
+ *  Returns the number of value lists waiting to be handed to the write
+ *  callbacks. Plugins receiving values from other hosts can use this to shed
+ *  load before `WriteQueueLimitHigh' starts dropping values at random.
+ */
+long plugin_get_write_queue_length(void);
+
 /*
  * Context-aware thread management.
  */
@@ -455,6 +587,130 @@ int plugin_thread_create(pthread_t *thread, const pthread_attr_t *attr,
                          void *(*start_routine)(void *), void *arg,
                          char const *name);
 
+/*
+ * NAME
+ *  plugin_thread_set_affinity
+ *
+ * DESCRIPTION
+ *  Restricts `thread' to the CPUs in the list `cpus', such as "0-3,8".
+ *
+ * RETURN VALUE
+ *  Zero on success, EINVAL if the list is malformed and ENOTSUP where
+ *  threads can't be bound to CPUs.
+ */
+int plugin_thread_set_affinity(pthread_t thread, char const *cpus);
+
+/*
+ * Shared event loop.
+ */
+
+typedef void (*plugin_fd_cb)(int fd, user_data_t *ud);
+
+/*
+ * NAME
+ *  plugin_register_fd
+ *
+ * DESCRIPTION
+ *  Calls `callback' whenever `fd' is readable, from one of the daemon's
+ *  `EventLoopThreads' threads and with the plugin context of the caller, so
+ *  that plugins receiving from sockets don't need threads of their own. The
+ *  callback is never called for `fd' by two threads at once and should read
+ *  whatever is available without blocking, e.g. with recvmmsg(2). The
+ *  `free_func' of `ud' is called once the file descriptor has been
+ *  unregistered or, at the latest, after the shutdown callbacks.
+ *
+ * RETURN VALUE
+ *  Zero upon success, EEXIST if `fd' is registered already, or another errno
+ *  value upon failure. `ud' is not freed upon failure.
+ */
+int plugin_register_fd(int fd, plugin_fd_cb callback, user_data_t const *ud);
+
+/*
+ * NAME
+ *  plugin_unregister_fd
+ *
+ * DESCRIPTION
+ *  Stops watching `fd', waiting for a running callback to return unless
+ *  called from that callback. Afterwards the file descriptor can be closed.
+ *
+ * RETURN VALUE
+ *  Zero upon success or ENOENT if `fd' isn't registered.
+ */
+int plugin_unregister_fd(int fd);
+
+/*
+ * Parallel read fan-out.
+ */
+
+struct plugin_fanout_s;
+typedef struct plugin_fanout_s plugin_fanout_t;
+
+typedef void (*plugin_fanout_cb)(void *task);
+
+/*
+ * NAME
+ *  plugin_fanout_create
+ *
+ * DESCRIPTION
+ *  Creates a pool of up to `threads_num' threads which run the tasks a read
+ *  callback submits, e.g. one per device, so that a slow device only delays
+ *  its own values. `name' is used for the threads' names and log messages.
+ *
+ * RETURN VALUE
+ *  A plugin_fanout_t-pointer upon success or NULL upon failure.
+ */
+plugin_fanout_t *plugin_fanout_create(char const *name, size_t threads_num);
+
+/*
+ * NAME
+ *  plugin_fanout_destroy
+ *
+ * DESCRIPTION
+ *  Frees the pool once its threads are idle. Tasks that have been abandoned
+ *  by plugin_fanout_wait() keep running; the pool is freed when the last of
+ *  them has returned. Passing NULL is a no-op.
+ *
+ * RETURN VALUE
+ *  Zero if all threads have exited, EBUSY if abandoned tasks are still
+ *  running. In the latter case, their `free_func' is called later, so they
+ *  must not use data the plugin frees after this call.
+ */
+int plugin_fanout_destroy(plugin_fanout_t *f);
+
+/*
+ * NAME
+ *  plugin_fanout_submit
+ *
+ * DESCRIPTION
+ *  Queues `task'. A thread of the pool calls `read' with the plugin context
+ *  of the caller, so values dispatched from `read' get the caller's interval,
+ *  and then `free_func', if not NULL. `key' identifies the device: while a
+ *  task with the same key is still running after being abandoned, `task' is
+ *  not run, only freed.
+ *
+ * RETURN VALUE
+ *  Zero upon success, EBUSY if a task with the same key is still running, or
+ *  another errno value upon failure. `task' is freed unless zero is returned.
+ */
+int plugin_fanout_submit(plugin_fanout_t *f, char const *key,
+                         plugin_fanout_cb read, plugin_fanout_cb free_func,
+                         void *task);
+
+/*
+ * NAME
+ *  plugin_fanout_wait
+ *
+ * DESCRIPTION
+ *  Waits until all submitted tasks have returned. A task that runs for longer
+ *  than `timeout' is abandoned: its thread is replaced, so the remaining
+ *  tasks are not held up, and its values are dispatched whenever it returns.
+ *  If `timeout' is zero, half the plugin's interval is used.
+ *
+ * RETURN VALUE
+ *  The number of tasks that have been abandoned or not run.
+ */
+size_t plugin_fanout_wait(plugin_fanout_t *f, cdtime_t timeout);
+
 /*
  * Plugins need to implement this
  */
@@ -35,6 +35,7 @@ kstat_ctl_t *kc = NULL;
 #endif /* HAVE_LIBKSTAT */
 
 char *hostname_g = "example.com";
+int timeout_g = 2;
 
 void plugin_set_dir(const char *dir) { /* nop */
 }
@@ -67,6 +68,13 @@ int plugin_register_write(__attribute__((unused)) const char *name,
   return ENOTSUP;
 }
 
+int plugin_register_write_batch(__attribute__((unused)) const char *name,
+                                __attribute__((unused))
+                                plugin_write_batch_cb callback,
+                                __attribute__((unused)) user_data_t const *ud) {
+  return ENOTSUP;
+}
+
 int plugin_register_missing(const char *name, plugin_missing_cb callback,
                             user_data_t const *ud) {
   return ENOTSUP;
@@ -87,6 +95,12 @@ int plugin_register_data_set(const data_set_t *ds) { return ENOTSUP; }
 
 int plugin_dispatch_values(value_list_t const *vl) { return ENOTSUP; }
 
+int plugin_dispatch_values_batch(value_list_t const *vls, size_t vls_num) {
+  return ENOTSUP;
+}
+
+int plugin_dispatch_missing(const value_list_t *vl) { return ENOTSUP; }
+
 int plugin_dispatch_notification(__attribute__((unused))
                                  const notification_t *notif) {
   return ENOTSUP;
@@ -198,8 +212,30 @@ plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx) {
 
 cdtime_t plugin_get_interval(void) { return mock_context.interval; }
 
+long plugin_get_write_queue_length(void) { return 0; }
+
+int plugin_thread_create(pthread_t *thread, const pthread_attr_t *attr,
+                         void *(*start_routine)(void *), void *arg,
+                         char const *name) {
+  return pthread_create(thread, attr, start_routine, arg);
+}
+
+int plugin_thread_set_affinity(pthread_t thread, char const *cpus) {
+  return ENOTSUP;
+}
+
+int plugin_register_fd(int fd, plugin_fd_cb callback, user_data_t const *ud) {
+  return ENOTSUP;
+}
+
+int plugin_unregister_fd(int fd) { return ENOENT; }
+
 /* TODO(octo): this function is actually from filter_chain.h, but in order not
  * to tumble down that rabbit hole, we're declaring it here. A better solution
  * would be to hard-code the top-level config keys in daemon/collectd.c to avoid
  * having these references in daemon/configfile.c. */
 int fc_configure(const oconfig_item_t *ci) { return ENOTSUP; }
+int fc_reconfigure(const oconfig_item_t *ci) { return ENOTSUP; }
+
+void plugin_update_chains(void) { /* nop */
+}
@@ -172,6 +172,10 @@ int read_types_list(const char *file) {
   if (file == NULL)
     return -1;
 
+#if COLLECT_DEBUG
+  cdtime_t start = cdtime();
+#endif
+
   fh = fopen(file, "r");
   if (fh == NULL) {
     fprintf(stderr, "Failed to open types database `%s': %s.\n", file,
@@ -185,7 +189,8 @@ int read_types_list(const char *file) {
   fclose(fh);
   fh = NULL;
 
-  DEBUG("Done parsing `%s'", file);
+  DEBUG("Done parsing `%s' in %.3f seconds.", file,
+        CDTIME_T_TO_DOUBLE(cdtime() - start));
 
   return 0;
 } /* int read_types_list */
@@ -0,0 +1,245 @@
+/**
+ * collectd - src/daemon/utils_affinity.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* _GNU_SOURCE is needed in Linux to use pthread_setaffinity_np and
+ * sched_getcpu */
+#define _GNU_SOURCE
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils_affinity.h"
+
+#if HAVE_SCHED_GETCPU || HAVE_PTHREAD_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
+#define AFFINITY_SYSFS_DIR "/sys/devices/system/node"
+
+/* The topology is loaded once and not changed afterwards, so it is read
+ * without locking. */
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static bool topology_loaded;
+static size_t nodes_num = 1;
+static affinity_set_t node_cpus[AFFINITY_NODES_MAX];
+/* The dense node index of every CPU. */
+static uint8_t cpu_node[AFFINITY_CPUS_MAX];
+
+static void affinity_set(affinity_set_t *set, size_t cpu) /* {{{ */
+{
+  set->bits[cpu / 64] |= ((uint64_t)1) << (cpu % 64);
+} /* }}} void affinity_set */
+
+bool affinity_isset(affinity_set_t const *set, size_t cpu) /* {{{ */
+{
+  if (cpu >= AFFINITY_CPUS_MAX)
+    return false;
+  return (set->bits[cpu / 64] & (((uint64_t)1) << (cpu % 64))) != 0;
+} /* }}} bool affinity_isset */
+
+size_t affinity_count(affinity_set_t const *set) /* {{{ */
+{
+  size_t num = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(set->bits); i++)
+    num += (size_t)__builtin_popcountll(set->bits[i]);
+  return num;
+} /* }}} size_t affinity_count */
+
+void affinity_and(affinity_set_t *set, affinity_set_t const *other) /* {{{ */
+{
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(set->bits); i++)
+    set->bits[i] &= other->bits[i];
+} /* }}} void affinity_and */
+
+static int parse_cpu(char const **str, size_t *ret) /* {{{ */
+{
+  char *end = NULL;
+
+  if (!isdigit((unsigned char)**str))
+    return EINVAL;
+
+  errno = 0;
+  unsigned long cpu = strtoul(*str, &end, 10);
+  if ((errno != 0) || (cpu >= AFFINITY_CPUS_MAX))
+    return EINVAL;
+
+  *str = end;
+  *ret = (size_t)cpu;
+  return 0;
+} /* }}} int parse_cpu */
+
+int affinity_parse(affinity_set_t *set, char const *str) /* {{{ */
+{
+  if ((set == NULL) || (str == NULL))
+    return EINVAL;
+
+  memset(set, 0, sizeof(*set));
+
+  while (isspace((unsigned char)*str))
+    str++;
+
+  while ((*str != 0) && !isspace((unsigned char)*str)) {
+    size_t first;
+    size_t last;
+
+    if (parse_cpu(&str, &first) != 0)
+      return EINVAL;
+    last = first;
+
+    if (*str == '-') {
+      str++;
+      if ((parse_cpu(&str, &last) != 0) || (last < first))
+        return EINVAL;
+    }
+
+    for (size_t cpu = first; cpu <= last; cpu++)
+      affinity_set(set, cpu);
+
+    if (*str == ',') {
+      str++;
+      if ((*str == 0) || isspace((unsigned char)*str))
+        return EINVAL;
+    } else if ((*str != 0) && !isspace((unsigned char)*str)) {
+      return EINVAL;
+    }
+  }
+
+  while (isspace((unsigned char)*str))
+    str++;
+
+  return (*str == 0) ? 0 : EINVAL;
+} /* }}} int affinity_parse */
+
+static int read_cpu_list(char const *path, affinity_set_t *set) /* {{{ */
+{
+  char buffer[4096] = {0};
+
+  ssize_t status = read_file_contents(path, buffer, sizeof(buffer) - 1);
+  if (status < 0)
+    return errno ? errno : EIO;
+  buffer[status] = 0;
+
+  return affinity_parse(set, buffer);
+} /* }}} int read_cpu_list */
+
+int affinity_topology_load(char const *dir) /* {{{ */
+{
+  char path[PATH_MAX];
+  affinity_set_t online;
+
+  topology_loaded = true;
+  nodes_num = 1;
+  memset(node_cpus, 0, sizeof(node_cpus));
+  memset(cpu_node, 0, sizeof(cpu_node));
+
+  snprintf(path, sizeof(path), "%s/online", dir);
+  int status = read_cpu_list(path, &online);
+  if (status != 0)
+    return status;
+
+  size_t num = 0;
+  for (size_t id = 0; (id < AFFINITY_CPUS_MAX) && (num < AFFINITY_NODES_MAX);
+       id++) {
+    if (!affinity_isset(&online, id))
+      continue;
+
+    snprintf(path, sizeof(path), "%s/node%" PRIsz "/cpulist", dir, id);
+    status = read_cpu_list(path, node_cpus + num);
+    if (status != 0) {
+      nodes_num = 1;
+      memset(cpu_node, 0, sizeof(cpu_node));
+      return status;
+    }
+
+    for (size_t cpu = 0; cpu < AFFINITY_CPUS_MAX; cpu++)
+      if (affinity_isset(node_cpus + num, cpu))
+        cpu_node[cpu] = (uint8_t)num;
+    num++;
+  }
+
+  if (num > 0)
+    nodes_num = num;
+  return 0;
+} /* }}} int affinity_topology_load */
+
+static void affinity_topology_default(void) /* {{{ */
+{
+  if (!topology_loaded)
+    (void)affinity_topology_load(AFFINITY_SYSFS_DIR);
+} /* }}} void affinity_topology_default */
+
+size_t affinity_nodes_num(void) /* {{{ */
+{
+  pthread_once(&topology_once, affinity_topology_default);
+  return nodes_num;
+} /* }}} size_t affinity_nodes_num */
+
+int affinity_node_cpus(size_t node, affinity_set_t *set) /* {{{ */
+{
+  pthread_once(&topology_once, affinity_topology_default);
+  if ((node >= nodes_num) || (set == NULL))
+    return EINVAL;
+
+  /* Without topology, node 0 is every CPU. */
+  if ((nodes_num == 1) && (affinity_count(node_cpus) == 0)) {
+    memset(set, 0xff, sizeof(*set));
+    return 0;
+  }
+
+  *set = node_cpus[node];
+  return 0;
+} /* }}} int affinity_node_cpus */
+
+size_t affinity_current_node(void) /* {{{ */
+{
+  pthread_once(&topology_once, affinity_topology_default);
+  if (nodes_num == 1)
+    return 0;
+
+#if HAVE_SCHED_GETCPU
+  int cpu = sched_getcpu();
+  if ((cpu < 0) || (cpu >= AFFINITY_CPUS_MAX))
+    return 0;
+  return (size_t)cpu_node[cpu];
+#else
+  return 0;
+#endif
+} /* }}} size_t affinity_current_node */
+
+int affinity_apply(pthread_t thread, affinity_set_t const *set) /* {{{ */
+{
+#if HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t cpus;
+
+  CPU_ZERO(&cpus);
+  for (size_t cpu = 0; (cpu < AFFINITY_CPUS_MAX) && (cpu < CPU_SETSIZE); cpu++)
+    if (affinity_isset(set, cpu))
+      CPU_SET(cpu, &cpus);
+
+  return pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+#else
+  (void)thread;
+  (void)set;
+  return ENOTSUP;
+#endif
+} /* }}} int affinity_apply */
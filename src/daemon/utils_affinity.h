@@ -0,0 +1,71 @@
+/**
+ * collectd - src/daemon/utils_affinity.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_AFFINITY_H
+#define UTILS_AFFINITY_H 1
+
+#include "collectd.h"
+
+#include <pthread.h>
+
+#define AFFINITY_CPUS_MAX 1024
+#define AFFINITY_NODES_MAX 64
+
+/* A set of CPUs. Kept apart from cpu_set_t, so that CPU lists can be parsed
+ * on every platform; only binding threads is Linux specific. */
+typedef struct {
+  uint64_t bits[AFFINITY_CPUS_MAX / 64];
+} affinity_set_t;
+
+/* Parses a CPU list as used by the kernel, e.g. "0-3,8,10-11", into `set'.
+ * Returns EINVAL if the list is malformed or names a CPU beyond
+ * AFFINITY_CPUS_MAX. */
+int affinity_parse(affinity_set_t *set, char const *str);
+
+bool affinity_isset(affinity_set_t const *set, size_t cpu);
+size_t affinity_count(affinity_set_t const *set);
+
+/* Removes the CPUs not in `other' from `set'. */
+void affinity_and(affinity_set_t *set, affinity_set_t const *other);
+
+/* Reads the NUMA topology from `dir', normally "/sys/devices/system/node".
+ * Without it, the system is treated as a single node. Called with the default
+ * directory by the functions below if it hasn't been called before. */
+int affinity_topology_load(char const *dir);
+
+/* Returns the number of NUMA nodes, at least one. Nodes are numbered densely,
+ * in the order of the kernel's node numbers. */
+size_t affinity_nodes_num(void);
+
+/* Stores the CPUs of `node' in `set'. */
+int affinity_node_cpus(size_t node, affinity_set_t *set);
+
+/* Returns the node of the CPU the calling thread runs on, or zero if unknown.
+ * Cheap enough to be called for every value list. */
+size_t affinity_current_node(void);
+
+/* Restricts `thread' to the CPUs in `set'. Returns ENOTSUP where threads can't
+ * be bound. */
+int affinity_apply(pthread_t thread, affinity_set_t const *set);
+
+#endif /* UTILS_AFFINITY_H */
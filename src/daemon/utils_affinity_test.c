@@ -0,0 +1,153 @@
+/**
+ * collectd - src/daemon/utils_affinity_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils_affinity.h"
+
+static int write_file(char const *dir, char const *name, /* {{{ */
+                      char const *content) {
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *fh = fopen(path, "w");
+  if (fh == NULL)
+    return errno;
+  fputs(content, fh);
+  fclose(fh);
+  return 0;
+} /* }}} int write_file */
+
+DEF_TEST(parse) {
+  struct {
+    char const *str;
+    int want_status;
+    size_t want_count;
+    size_t want_cpus[4];
+  } cases[] = {
+      {"0", 0, 1, {0}},
+      {"0-3", 0, 4, {0, 1, 2, 3}},
+      {"0-1,8,10-11", 0, 5, {0, 1, 8, 10}},
+      {" 2,3\n", 0, 2, {2, 3}},
+      /* Memoryless nodes have an empty CPU list. */
+      {"\n", 0, 0},
+      {"3-1", EINVAL},
+      {"1,", EINVAL},
+      {",1", EINVAL},
+      {"1-", EINVAL},
+      {"a", EINVAL},
+      {"1 2", EINVAL},
+      {"1024", EINVAL},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    affinity_set_t set;
+
+    printf("## Case %" PRIsz ": \"%s\"\n", i, cases[i].str);
+    EXPECT_EQ_INT(cases[i].want_status, affinity_parse(&set, cases[i].str));
+    if (cases[i].want_status != 0)
+      continue;
+
+    EXPECT_EQ_UINT64(cases[i].want_count, affinity_count(&set));
+    for (size_t j = 0; (j < cases[i].want_count) && (j < 4); j++)
+      OK(affinity_isset(&set, cases[i].want_cpus[j]));
+  }
+
+  return 0;
+}
+
+DEF_TEST(and) {
+  affinity_set_t a;
+  affinity_set_t b;
+
+  CHECK_ZERO(affinity_parse(&a, "0-7,64-71"));
+  CHECK_ZERO(affinity_parse(&b, "4-67"));
+  affinity_and(&a, &b);
+
+  EXPECT_EQ_UINT64(8, affinity_count(&a));
+  OK(!affinity_isset(&a, 3));
+  OK(affinity_isset(&a, 4));
+  OK(affinity_isset(&a, 67));
+  OK(!affinity_isset(&a, 68));
+
+  return 0;
+}
+
+DEF_TEST(topology) {
+  char dir[] = "/tmp/collectd-affinity-XXXXXX";
+  char path[PATH_MAX];
+
+  CHECK_NOT_NULL(mkdtemp(dir));
+
+  /* Node numbers need not be dense. */
+  CHECK_ZERO(write_file(dir, "online", "0,2\n"));
+  snprintf(path, sizeof(path), "%s/node0", dir);
+  CHECK_ZERO(mkdir(path, 0700));
+  snprintf(path, sizeof(path), "%s/node2", dir);
+  CHECK_ZERO(mkdir(path, 0700));
+  CHECK_ZERO(write_file(dir, "node0/cpulist", "0-3,8-11\n"));
+  CHECK_ZERO(write_file(dir, "node2/cpulist", "4-7,12-15\n"));
+
+  CHECK_ZERO(affinity_topology_load(dir));
+  EXPECT_EQ_UINT64(2, affinity_nodes_num());
+
+  affinity_set_t set;
+  CHECK_ZERO(affinity_node_cpus(1, &set));
+  EXPECT_EQ_UINT64(8, affinity_count(&set));
+  OK(affinity_isset(&set, 4));
+  OK(affinity_isset(&set, 15));
+  OK(!affinity_isset(&set, 8));
+  EXPECT_EQ_INT(EINVAL, affinity_node_cpus(2, &set));
+
+  /* Without topology, there is one node with all CPUs. */
+  snprintf(path, sizeof(path), "%s/missing", dir);
+  OK(affinity_topology_load(path) != 0);
+  EXPECT_EQ_UINT64(1, affinity_nodes_num());
+  EXPECT_EQ_UINT64(0, affinity_current_node());
+  CHECK_ZERO(affinity_node_cpus(0, &set));
+  EXPECT_EQ_UINT64(AFFINITY_CPUS_MAX, affinity_count(&set));
+
+  snprintf(path, sizeof(path), "%s/node0/cpulist", dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/node2/cpulist", dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/node0", dir);
+  rmdir(path);
+  snprintf(path, sizeof(path), "%s/node2", dir);
+  rmdir(path);
+  snprintf(path, sizeof(path), "%s/online", dir);
+  unlink(path);
+  rmdir(dir);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(parse);
+  RUN_TEST(and);
+  RUN_TEST(topology);
+
+  END_TEST;
+}
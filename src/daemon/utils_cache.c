@@ -29,15 +29,46 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/deq/deq.h"
+#include "utils/heap/heap.h"
 #include "utils/metadata/meta_data.h"
+#include "utils/tsz/tsz.h"
 #include "utils_cache.h"
+#include "utils_ident.h"
 
 #include <assert.h>
-
+#include <fnmatch.h>
+#include <sys/mman.h>
+
+/* The history of one data source: a ring of "history_length" values, and the
+ * aggregates over all of them. "min" and "max" are monotonic deques of the
+ * ring's non-NaN values: each value is linked into "min" until a smaller value
+ * is added after it, so the head of "min" is the smallest value in the ring
+ * (and the head of "max" the largest). "nodes[i]" links "values[i]". */
+typedef struct uc_history_node_s uc_history_node_t;
+struct uc_history_node_s {
+  DEQ_LINKS_N(MIN, uc_history_node_t);
+  DEQ_LINKS_N(MAX, uc_history_node_t);
+};
+DEQ_DECLARE(uc_history_node_t, uc_history_deq_t);
+
+typedef struct {
+  gauge_t *values;
+  uc_history_node_t *nodes;
+  uc_history_deq_t min;
+  uc_history_deq_t max;
+  gauge_t sum;
+  size_t num; /* number of non-NaN values */
+} uc_history_t;
+
+/* An entry is a single allocation, see cache_alloc(): the fields below are
+ * followed by the "values_num" rates, the "values_num" raw values and the
+ * name, which the pointers point to. The fields used by lookups and by
+ * uc_check_timeout() come first, so that they share a cache line. */
 typedef struct cache_entry_s {
-  char name[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  char *name;
   size_t values_num;
   gauge_t *values_gauge;
   value_t *values_raw;
@@ -50,65 +81,455 @@ typedef struct cache_entry_s {
   /* Interval in which the data is collected
    * (for purging old entries) */
   cdtime_t interval;
+  /* Position in the shard's expiry heap. Only used by uc_check_timeout. */
+  cdtime_t expires;
   int state;
   int hits;
 
-  /*
-   * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * !  0  !  1  !  2  !  3  !  4  !  5  !  6  !  7  !  8  ! ...
-   * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * ! ds0 ! ds1 ! ds2 ! ds0 ! ds1 ! ds2 ! ds0 ! ds1 ! ds2 ! ...
-   * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * !      t = 0      !      t = 1      !      t = 2      ! ...
-   * +-----------------+-----------------+-----------------+----
+  /* Resolved by the threshold checks, see uc_threshold_update(). */
+  void const *threshold;
+  uint64_t threshold_generation;
+
+  /* One history per data source, all sharing "history_index":
+   *
+   *           +-----+-----+-----+-----+----
+   * ds0       ! t=0 ! t=1 ! t=2 ! t=3 ! ...
+   *           +-----+-----+-----+-----+----
+   * ds1       ! t=0 ! t=1 ! t=2 ! t=3 ! ...
+   *           +-----+-----+-----+-----+----
    */
-  gauge_t *history;
+  uc_history_t *history;
   size_t history_index; /* points to the next position to write to. */
   size_t history_length;
 
+  /* The rates of the last "series_span", see uc_set_series_span(). */
+  c_tsz_t *series;
+
   meta_data_t *meta;
 } cache_entry_t;
 
-struct uc_iter_s {
-  c_avl_iterator_t *iter;
+/* The cache is split into UC_SHARDS_NUM shards, each of which is an open
+ * addressing hash table with linear probing and its own lock. The upper bits
+ * of an identifier's hash select the shard, the lower bits the slot. Removed
+ * entries leave a tombstone behind so that probe sequences stay intact.
+ *
+ * "expiry" holds all entries of the shard, ordered by "expires". Updates do
+ * not touch the heap: an entry's deadline is only re-evaluated when it reaches
+ * the root, and the entry is put back if it has been updated in the meantime.
+ * This way a timeout sweep only looks at entries that may have timed out. */
+#define UC_SHARDS_NUM 64
+#define UC_SHARD_BITS 6
+#define UC_MIN_SLOTS 16
+
+typedef struct {
+  pthread_rwlock_t lock;
+  cache_entry_t **slots;
+  size_t slots_num; /* zero or a power of two */
+  size_t entries_num;
+  size_t tombstones_num;
+  c_heap_t *expiry;
+} uc_shard_t;
+
+static uc_shard_t cache_shards[UC_SHARDS_NUM];
+static bool cache_initialized;
+
+/* Zero unless the entries keep their recent rates. */
+static cdtime_t series_span;
+
+/* How much older than the newest value of its entry a value may be to be
+ * passed to the writers accepting late values, see uc_set_reorder_window().
+ * The counters are only ever added to. */
+static cdtime_t reorder_window;
+static uint64_t stats_late;
+static uint64_t stats_too_old;
+
+/* Marks a slot whose entry has been removed. */
+static cache_entry_t cache_tombstone;
+#define UC_TOMBSTONE (&cache_tombstone)
+
+/* The rates computed by the calling thread's last uc_update(). The writers of
+ * a value list are called by the thread that dispatched it, so uc_get_rate()
+ * usually finds the rates here without looking up the entry again. */
+typedef struct {
+  value_list_t const *vl;
+  value_t const *values;
+  cdtime_t time;
+  size_t values_num;
+  size_t size;
+  gauge_t rates[];
+} uc_last_rates_t;
+
+static pthread_key_t last_rates_key;
+static pthread_once_t last_rates_once = PTHREAD_ONCE_INIT;
 
+/* A copy of a cache entry, taken by the iterator. */
+typedef struct {
   char *name;
-  cache_entry_t *entry;
+  uint64_t hash;
+  cdtime_t time;
+  cdtime_t interval;
+  size_t values_num;
+  value_t *values;
+} uc_iter_entry_t;
+
+/* The iterator copies one shard at a time while holding its read lock, and
+ * walks the copies without holding any lock. */
+struct uc_iter_s {
+  /* The next shard to copy. */
+  size_t shard;
+
+  /* The current shard's entries, their values and names, in one block. */
+  uc_iter_entry_t *entries;
+  size_t entries_num;
+  size_t index;
+
+  uc_iter_entry_t *entry;
 };
 
-static c_avl_tree_t *cache_tree;
-static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Returns the identifier of `vl' and its hash. The name of the interned
+ * identifier is used if there is one, otherwise the identifier is formatted
+ * into `buffer'. */
+static char const *uc_vl_name(value_list_t const *vl, char *buffer,
+                              size_t buffer_size, uint64_t *ret_hash) {
+  if (vl->ident != NULL) {
+    *ret_hash = vl->ident->hash;
+    return vl->ident->name;
+  }
 
-static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
-#if COLLECT_DEBUG
-  assert((a != NULL) && (b != NULL));
-#endif
-  return strcmp(a->name, b->name);
-} /* int cache_compare */
+  if (FORMAT_VL(buffer, buffer_size, vl) != 0)
+    return NULL;
 
-static cache_entry_t *cache_alloc(size_t values_num) {
-  cache_entry_t *ce;
+  *ret_hash = ident_hash(buffer);
+  return buffer;
+} /* char const *uc_vl_name */
+
+static uc_shard_t *uc_shard(uint64_t hash) {
+  return cache_shards + (hash >> (64 - UC_SHARD_BITS));
+} /* uc_shard_t *uc_shard */
+
+/* Must hold the shard's lock (read or write). */
+static cache_entry_t *shard_get(uc_shard_t *shard, char const *name,
+                                uint64_t hash) {
+  if (shard->slots_num == 0)
+    return NULL;
+
+  size_t mask = shard->slots_num - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    cache_entry_t *ce = shard->slots[i];
+
+    if (ce == NULL)
+      return NULL;
+    if (ce == UC_TOMBSTONE)
+      continue;
+    if ((ce->hash == hash) && (strcmp(ce->name, name) == 0))
+      return ce;
+  }
+} /* cache_entry_t *shard_get */
+
+/* Puts `ce' into the first free slot. Does not check for duplicates. */
+static void shard_place(cache_entry_t **slots, size_t slots_num,
+                        cache_entry_t *ce) {
+  size_t mask = slots_num - 1;
+  size_t i = ce->hash & mask;
+
+  while ((slots[i] != NULL) && (slots[i] != UC_TOMBSTONE))
+    i = (i + 1) & mask;
+
+  slots[i] = ce;
+} /* void shard_place */
 
-  ce = calloc(1, sizeof(*ce));
+/* Rehashes the shard into a table with `slots_num' slots, dropping all
+ * tombstones. Must hold the shard's write lock. */
+static int shard_resize(uc_shard_t *shard, size_t slots_num) {
+  cache_entry_t **slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    cache_entry_t *ce = shard->slots[i];
+    if ((ce != NULL) && (ce != UC_TOMBSTONE))
+      shard_place(slots, slots_num, ce);
+  }
+
+  sfree(shard->slots);
+  shard->slots = slots;
+  shard->slots_num = slots_num;
+  shard->tombstones_num = 0;
+
+  return 0;
+} /* int shard_resize */
+
+/* Must hold the shard's write lock. */
+static int shard_insert(uc_shard_t *shard, cache_entry_t *ce) {
+  /* Keep the load factor, including tombstones, below 3/4. */
+  if (4 * (shard->entries_num + shard->tombstones_num + 1) >
+      3 * shard->slots_num) {
+    size_t slots_num =
+        (shard->slots_num == 0) ? UC_MIN_SLOTS : shard->slots_num;
+    /* Only grow if more than half of the slots are live; otherwise rehashing
+     * to the same size gets rid of the tombstones. */
+    while (2 * (shard->entries_num + 1) > slots_num)
+      slots_num *= 2;
+
+    int status = shard_resize(shard, slots_num);
+    if (status != 0)
+      return status;
+  }
+
+  size_t mask = shard->slots_num - 1;
+  size_t i = ce->hash & mask;
+  while ((shard->slots[i] != NULL) && (shard->slots[i] != UC_TOMBSTONE))
+    i = (i + 1) & mask;
+
+  if (shard->slots[i] == UC_TOMBSTONE)
+    shard->tombstones_num--;
+  shard->slots[i] = ce;
+  shard->entries_num++;
+
+  return 0;
+} /* int shard_insert */
+
+/* Removes the entry `name' from the shard and returns it. Must hold the
+ * shard's write lock. */
+static cache_entry_t *shard_remove(uc_shard_t *shard, char const *name,
+                                   uint64_t hash) {
+  if (shard->slots_num == 0)
+    return NULL;
+
+  size_t mask = shard->slots_num - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    cache_entry_t *ce = shard->slots[i];
+
+    if (ce == NULL)
+      return NULL;
+    if (ce == UC_TOMBSTONE)
+      continue;
+    if ((ce->hash != hash) || (strcmp(ce->name, name) != 0))
+      continue;
+
+    /* If the next slot is empty, no probe sequence continues past this one,
+     * and we don't need a tombstone. */
+    if (shard->slots[(i + 1) & mask] == NULL) {
+      shard->slots[i] = NULL;
+    } else {
+      shard->slots[i] = UC_TOMBSTONE;
+      shard->tombstones_num++;
+    }
+    shard->entries_num--;
+    return ce;
+  }
+} /* cache_entry_t *shard_remove */
+
+/* Looks up `name' and locks its shard for reading or writing. On success, the
+ * caller must unlock `*ret_shard'. */
+static cache_entry_t *uc_lock_entry(char const *name, uint64_t hash,
+                                    bool write, uc_shard_t **ret_shard) {
+  uc_shard_t *shard = uc_shard(hash);
+
+  if (write)
+    pthread_rwlock_wrlock(&shard->lock);
+  else
+    pthread_rwlock_rdlock(&shard->lock);
+
+  cache_entry_t *ce = shard_get(shard, name, hash);
   if (ce == NULL) {
-    ERROR("utils_cache: cache_alloc: calloc failed.");
+    pthread_rwlock_unlock(&shard->lock);
     return NULL;
   }
-  ce->values_num = values_num;
 
-  ce->values_gauge = calloc(values_num, sizeof(*ce->values_gauge));
-  ce->values_raw = calloc(values_num, sizeof(*ce->values_raw));
-  if ((ce->values_gauge == NULL) || (ce->values_raw == NULL)) {
-    sfree(ce->values_gauge);
-    sfree(ce->values_raw);
-    sfree(ce);
+  *ret_shard = shard;
+  return ce;
+} /* cache_entry_t *uc_lock_entry */
+
+static void uc_last_rates_key_create(void) {
+  if (pthread_key_create(&last_rates_key, free) != 0)
+    ERROR("utils_cache: pthread_key_create failed.");
+} /* void uc_last_rates_key_create */
+
+static uc_last_rates_t *uc_last_rates(void) {
+  pthread_once(&last_rates_once, uc_last_rates_key_create);
+  return pthread_getspecific(last_rates_key);
+} /* uc_last_rates_t *uc_last_rates */
+
+/* Returns the buffer for the `values_num' rates of `vl', which the caller
+ * fills in, or NULL if it can't be allocated. */
+static gauge_t *uc_last_rates_reserve(value_list_t const *vl,
+                                      size_t values_num) {
+  uc_last_rates_t *last = uc_last_rates();
+
+  if ((last == NULL) || (last->size < values_num)) {
+    size_t size = (values_num > 4) ? values_num : 4;
+    uc_last_rates_t *tmp =
+        realloc(last, sizeof(*last) + size * sizeof(gauge_t));
+    if (tmp == NULL) {
+      if (last != NULL)
+        last->vl = NULL;
+      return NULL;
+    }
+    last = tmp;
+    last->size = size;
+    pthread_setspecific(last_rates_key, last);
+  }
+
+  last->vl = vl;
+  last->values = vl->values;
+  last->time = vl->time;
+  last->values_num = values_num;
+  return last->rates;
+} /* gauge_t *uc_last_rates_reserve */
+
+/* Remembers the rates of `ce', which has just been updated with `vl'. Must
+ * hold the shard's lock. */
+static void uc_last_rates_set(value_list_t const *vl, cache_entry_t const *ce) {
+  gauge_t *rates = uc_last_rates_reserve(vl, ce->values_num);
+  if (rates != NULL)
+    memcpy(rates, ce->values_gauge, ce->values_num * sizeof(gauge_t));
+} /* void uc_last_rates_set */
+
+/* Remembers the rates of a late `vl', which hasn't been added to the cache:
+ * gauges are passed on, the other data sources have no rate. */
+static void uc_last_rates_set_late(data_set_t const *ds,
+                                   value_list_t const *vl) {
+  gauge_t *rates = uc_last_rates_reserve(vl, ds->ds_num);
+  if (rates == NULL)
+    return;
+
+  for (size_t i = 0; i < ds->ds_num; i++)
+    rates[i] = (ds->ds[i].type == DS_TYPE_GAUGE) ? vl->values[i].gauge : NAN;
+} /* void uc_last_rates_set_late */
+
+void uc_clear_rates(void) {
+  uc_last_rates_t *last = uc_last_rates();
+  if (last != NULL)
+    last->vl = NULL;
+} /* void uc_clear_rates */
+
+static gauge_t uc_history_value(uc_history_t const *h,
+                                uc_history_node_t const *node) {
+  return h->values[node - h->nodes];
+} /* gauge_t uc_history_value */
+
+/* Recomputes the sum from scratch, so that rounding errors from adding and
+ * subtracting values don't accumulate. */
+static void uc_history_resum(uc_history_t *h, size_t length) {
+  h->sum = 0.0;
+  for (size_t i = 0; i < length; i++)
+    if (!isnan(h->values[i]))
+      h->sum += h->values[i];
+} /* void uc_history_resum */
+
+/* Replaces the (oldest) value at "index" of a history with "value". */
+static void uc_history_push(uc_history_t *h, size_t index, gauge_t value) {
+  uc_history_node_t *node = h->nodes + index;
+  gauge_t old = h->values[index];
+
+  if (!isnan(old)) {
+    /* The oldest value can only be linked at the head of the deques. */
+    if (DEQ_HEAD(h->min) == node)
+      DEQ_REMOVE_HEAD_N(MIN, h->min);
+    if (DEQ_HEAD(h->max) == node)
+      DEQ_REMOVE_HEAD_N(MAX, h->max);
+    h->sum -= old;
+    h->num--;
+  }
+
+  h->values[index] = value;
+  if (isnan(value))
+    return;
+
+  while (!DEQ_IS_EMPTY(h->min) &&
+         (uc_history_value(h, DEQ_TAIL(h->min)) >= value))
+    DEQ_REMOVE_TAIL_N(MIN, h->min);
+  DEQ_INSERT_TAIL_N(MIN, h->min, node);
+
+  while (!DEQ_IS_EMPTY(h->max) &&
+         (uc_history_value(h, DEQ_TAIL(h->max)) <= value))
+    DEQ_REMOVE_TAIL_N(MAX, h->max);
+  DEQ_INSERT_TAIL_N(MAX, h->max, node);
+
+  h->sum += value;
+  h->num++;
+} /* void uc_history_push */
+
+static void uc_history_free(cache_entry_t *ce) {
+  if (ce->history == NULL)
+    return;
+
+  for (size_t i = 0; i < ce->values_num; i++) {
+    sfree(ce->history[i].values);
+    sfree(ce->history[i].nodes);
+  }
+  sfree(ce->history);
+  ce->history_length = 0;
+  ce->history_index = 0;
+} /* void uc_history_free */
+
+/* Resizes the history of an entry to "length" steps, keeping the most recent
+ * values. Must hold the shard's write lock. */
+static int uc_history_resize(cache_entry_t *ce, size_t length) {
+  uc_history_t *history = calloc(ce->values_num, sizeof(*history));
+  if (history == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < ce->values_num; i++) {
+    uc_history_t *h = history + i;
+
+    h->values = malloc(length * sizeof(*h->values));
+    h->nodes = calloc(length, sizeof(*h->nodes));
+    if ((h->values == NULL) || (h->nodes == NULL)) {
+      for (size_t j = 0; j <= i; j++) {
+        sfree(history[j].values);
+        sfree(history[j].nodes);
+      }
+      sfree(history);
+      return ENOMEM;
+    }
+
+    for (size_t j = 0; j < length; j++)
+      h->values[j] = NAN;
+    DEQ_INIT(h->min);
+    DEQ_INIT(h->max);
+  }
+
+  /* Replay the old values, oldest first. */
+  size_t num = (ce->history_length < length) ? ce->history_length : length;
+  for (size_t i = 0; i < ce->values_num; i++) {
+    for (size_t j = 0; j < num; j++) {
+      size_t src = (ce->history_index + ce->history_length - num + j) %
+                   ce->history_length;
+      uc_history_push(history + i, j, ce->history[i].values[src]);
+    }
+  }
+
+  uc_history_free(ce);
+  ce->history = history;
+  ce->history_length = length;
+  ce->history_index = num % length;
+
+  return 0;
+} /* int uc_history_resize */
+
+/* Allocates the entry `name' with its values and name in one block. gauge_t
+ * and value_t are both eight bytes, so the arrays following the header stay
+ * aligned. */
+static cache_entry_t *cache_alloc(char const *name, uint64_t hash,
+                                  size_t values_num) {
+  size_t name_size = strlen(name) + 1;
+  cache_entry_t *ce = calloc(1, sizeof(*ce) +
+                                    values_num * (sizeof(*ce->values_gauge) +
+                                                  sizeof(*ce->values_raw)) +
+                                    name_size);
+  if (ce == NULL) {
     ERROR("utils_cache: cache_alloc: calloc failed.");
     return NULL;
   }
 
-  ce->history = NULL;
-  ce->history_length = 0;
-  ce->meta = NULL;
+  ce->hash = hash;
+  ce->values_num = values_num;
+  ce->values_gauge = (gauge_t *)(ce + 1);
+  ce->values_raw = (value_t *)(ce->values_gauge + values_num);
+  ce->name = (char *)(ce->values_raw + values_num);
+  memcpy(ce->name, name, name_size);
 
   return ce;
 } /* cache_entry_t *cache_alloc */
@@ -117,9 +538,8 @@ static void cache_free(cache_entry_t *ce) {
   if (ce == NULL)
     return;
 
-  sfree(ce->values_gauge);
-  sfree(ce->values_raw);
-  sfree(ce->history);
+  uc_history_free(ce);
+  c_tsz_destroy(ce->series);
   if (ce->meta != NULL) {
     meta_data_destroy(ce->meta);
     ce->meta = NULL;
@@ -138,28 +558,54 @@ static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
   }
 } /* void uc_check_range */
 
-static int uc_insert(const data_set_t *ds, const value_list_t *vl,
-                     const char *key) {
-  char *key_copy;
-  cache_entry_t *ce;
-
-  /* `cache_lock' has been locked by `uc_update' */
+static int uc_expiry_compare(void const *a, void const *b) {
+  cache_entry_t const *ce_a = a;
+  cache_entry_t const *ce_b = b;
 
-  key_copy = strdup(key);
-  if (key_copy == NULL) {
-    ERROR("uc_insert: strdup failed.");
+  if (ce_a->expires < ce_b->expires)
     return -1;
+  else if (ce_a->expires > ce_b->expires)
+    return 1;
+  return 0;
+} /* int uc_expiry_compare */
+
+/* Appends the current rates to the entry's recent series. Must hold the
+ * shard's write lock. */
+static void uc_series_append(cache_entry_t *ce) {
+  if (series_span == 0)
+    return;
+
+  if (ce->series == NULL) {
+    ce->series = c_tsz_create(ce->values_num, series_span);
+    if (ce->series == NULL) {
+      ERROR("utils_cache: c_tsz_create failed.");
+      return;
+    }
   }
 
-  ce = cache_alloc(ds->ds_num);
+  /* Fails with EINVAL if the time has not advanced by a millisecond, which
+   * the series can't represent. */
+  int status = c_tsz_append(ce->series, ce->last_time, ce->values_gauge);
+  if (status == ENOMEM)
+    ERROR("utils_cache: c_tsz_append failed.");
+} /* void uc_series_append */
+
+static cdtime_t uc_deadline(cache_entry_t const *ce) {
+  return ce->last_update + ce->interval * (cdtime_t)timeout_g;
+} /* cdtime_t uc_deadline */
+
+static int uc_insert(uc_shard_t *shard, const data_set_t *ds,
+                     const value_list_t *vl, const char *key, uint64_t hash) {
+  cache_entry_t *ce;
+
+  /* The shard's write lock has been acquired by `uc_update' */
+
+  ce = cache_alloc(key, hash, ds->ds_num);
   if (ce == NULL) {
-    sfree(key_copy);
     ERROR("uc_insert: cache_alloc (%" PRIsz ") failed.", ds->ds_num);
     return -1;
   }
 
-  sstrncpy(ce->name, key, sizeof(ce->name));
-
   for (size_t i = 0; i < ds->ds_num; i++) {
     switch (ds->ds[i].type) {
     case DS_TYPE_COUNTER:
@@ -189,7 +635,6 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
       /* This shouldn't happen. */
       ERROR("uc_insert: Don't know how to handle data source type %i.",
             ds->ds[i].type);
-      sfree(key_copy);
       cache_free(ce);
       return -1;
     } /* switch (ds->ds[i].type) */
@@ -202,21 +647,46 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
   ce->last_update = cdtime();
   ce->interval = vl->interval;
   ce->state = STATE_UNKNOWN;
+  uc_series_append(ce);
+
+  if (shard_insert(shard, ce) != 0) {
+    cache_free(ce);
+    ERROR("uc_insert: shard_insert failed.");
+    return -1;
+  }
 
-  if (c_avl_insert(cache_tree, key_copy, ce) != 0) {
-    sfree(key_copy);
-    ERROR("uc_insert: c_avl_insert failed.");
+  ce->expires = uc_deadline(ce);
+  if (c_heap_insert(shard->expiry, ce) != 0) {
+    shard_remove(shard, ce->name, ce->hash);
+    cache_free(ce);
+    ERROR("uc_insert: c_heap_insert failed.");
     return -1;
   }
 
+  uc_last_rates_set(vl, ce);
   DEBUG("uc_insert: Added %s to the cache.", key);
   return 0;
 } /* int uc_insert */
 
 int uc_init(void) {
-  if (cache_tree == NULL)
-    cache_tree =
-        c_avl_create((int (*)(const void *, const void *))cache_compare);
+  if (cache_initialized)
+    return 0;
+
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    cache_shards[i].expiry = c_heap_create(uc_expiry_compare);
+    if (cache_shards[i].expiry == NULL) {
+      ERROR("uc_init: c_heap_create failed.");
+      for (size_t j = 0; j < i; j++) {
+        c_heap_destroy(cache_shards[j].expiry);
+        cache_shards[j].expiry = NULL;
+      }
+      return ENOMEM;
+    }
+  }
+
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    pthread_rwlock_init(&cache_shards[i].lock, /* attr = */ NULL);
+  cache_initialized = true;
 
   return 0;
 } /* int uc_init */
@@ -229,39 +699,57 @@ int uc_check_timeout(void) {
   } *expired = NULL;
   size_t expired_num = 0;
 
-  pthread_mutex_lock(&cache_lock);
   cdtime_t now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  c_avl_iterator_t *iter = c_avl_get_iterator(cache_tree);
-  char *key = NULL;
-  cache_entry_t *ce = NULL;
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
-    /* If the entry is fresh enough, continue. */
-    if ((now - ce->last_update) < (ce->interval * timeout_g))
-      continue;
-
-    void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
-    if (tmp == NULL) {
-      ERROR("uc_check_timeout: realloc failed.");
+  /* Build a list of entries to be flushed. Only entries whose deadline in the
+   * expiry heap has passed are looked at. Entries that have been updated since
+   * they were put into the heap are put back with their new deadline. */
+  for (size_t s = 0; s < UC_SHARDS_NUM; s++) {
+    uc_shard_t *shard = cache_shards + s;
+
+    /* Most shards have nothing due; check that without blocking writers. */
+    pthread_rwlock_rdlock(&shard->lock);
+    cache_entry_t *root = c_heap_peek_root(shard->expiry);
+    bool due = (root != NULL) && (root->expires <= now);
+    pthread_rwlock_unlock(&shard->lock);
+    if (!due)
       continue;
-    }
-    expired = tmp;
 
-    expired[expired_num].key = strdup(key);
-    expired[expired_num].time = ce->last_time;
-    expired[expired_num].interval = ce->interval;
-
-    if (expired[expired_num].key == NULL) {
-      ERROR("uc_check_timeout: strdup failed.");
-      continue;
-    }
+    pthread_rwlock_wrlock(&shard->lock);
+    cache_entry_t *ce;
+    while (((ce = c_heap_peek_root(shard->expiry)) != NULL) &&
+           (ce->expires <= now)) {
+      c_heap_get_root(shard->expiry);
+
+      /* If the entry is fresh enough, put it back. */
+      cdtime_t deadline = uc_deadline(ce);
+      if (deadline > now) {
+        ce->expires = deadline;
+        c_heap_insert(shard->expiry, ce);
+        continue;
+      }
 
-    expired_num++;
-  } /* while (c_avl_iterator_next) */
+      char *key = NULL;
+      void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+      if (tmp != NULL) {
+        expired = tmp;
+        key = strdup(ce->name);
+      }
+      if (key == NULL) {
+        ERROR("uc_check_timeout: Out of memory.");
+        /* Retry with the next sweep. */
+        ce->expires = now + 1;
+        c_heap_insert(shard->expiry, ce);
+        continue;
+      }
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+      expired[expired_num].key = key;
+      expired[expired_num].time = ce->last_time;
+      expired[expired_num].interval = ce->interval;
+      expired_num++;
+    } /* while (ce) */
+    pthread_rwlock_unlock(&shard->lock);
+  } /* for (s) */
 
   if (expired_num == 0) {
     sfree(expired);
@@ -289,59 +777,73 @@ int uc_check_timeout(void) {
 
   /* Now actually remove all the values from the cache. We don't re-evaluate
    * the timestamp again, so in theory it is possible we remove a value after
-   * it is updated here. */
-  pthread_mutex_lock(&cache_lock);
+   * it is updated here. The entries have already been taken out of the expiry
+   * heap above. */
   for (size_t i = 0; i < expired_num; i++) {
-    char *key = NULL;
-    cache_entry_t *value = NULL;
+    uint64_t hash = ident_hash(expired[i].key);
+    uc_shard_t *shard = uc_shard(hash);
 
-    if (c_avl_remove(cache_tree, expired[i].key, (void *)&key,
-                     (void *)&value) != 0) {
-      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", expired[i].key);
-      sfree(expired[i].key);
-      continue;
-    }
-    sfree(key);
+    pthread_rwlock_wrlock(&shard->lock);
+    cache_entry_t *value = shard_remove(shard, expired[i].key, hash);
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (value == NULL)
+      ERROR("uc_check_timeout: shard_remove (\"%s\") failed.", expired[i].key);
     cache_free(value);
 
     sfree(expired[i].key);
   } /* for (i = 0; i < expired_num; i++) */
-  pthread_mutex_unlock(&cache_lock);
 
   sfree(expired);
   return 0;
 } /* int uc_check_timeout */
 
 int uc_update(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
   cache_entry_t *ce = NULL;
   int status;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+  uc_clear_rates();
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_update: FORMAT_VL failed.");
     return -1;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uc_shard_t *shard = uc_shard(hash);
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) /* entry does not yet exist */
+  pthread_rwlock_wrlock(&shard->lock);
+
+  ce = shard_get(shard, name, hash);
+  if (ce == NULL) /* entry does not yet exist */
   {
-    status = uc_insert(ds, vl, name);
-    pthread_mutex_unlock(&cache_lock);
+    status = uc_insert(shard, ds, vl, name, hash);
+    pthread_rwlock_unlock(&shard->lock);
     return status;
   }
 
   assert(ce != NULL);
   assert(ce->values_num == ds->ds_num);
 
+  /* The entry keeps the newest values. Late values are only counted, so that
+   * a burst of reordered packets doesn't flood the log. */
   if (ce->last_time >= vl->time) {
-    pthread_mutex_unlock(&cache_lock);
-    NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
-           "last cache update = %.3f;",
-           name, CDTIME_T_TO_DOUBLE(vl->time),
-           CDTIME_T_TO_DOUBLE(ce->last_time));
-    return -1;
+    /* A value with the same time is a duplicate, not a late one. */
+    bool late = (vl->time < ce->last_time) &&
+                ((ce->last_time - vl->time) <= reorder_window);
+    if (late)
+      uc_last_rates_set_late(ds, vl);
+    pthread_rwlock_unlock(&shard->lock);
+
+    __atomic_fetch_add(late ? &stats_late : &stats_too_old, 1,
+                       __ATOMIC_RELAXED);
+    DEBUG("uc_update: Value %s: name = %s; value time = %.3f; "
+          "last cache update = %.3f;",
+          late ? "late" : "too old", name, CDTIME_T_TO_DOUBLE(vl->time),
+          CDTIME_T_TO_DOUBLE(ce->last_time));
+    return late ? UC_UPDATE_LATE : UC_UPDATE_TOO_OLD;
   }
 
   for (size_t i = 0; i < ds->ds_num; i++) {
@@ -375,7 +877,7 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
 
     default:
       /* This shouldn't happen. */
-      pthread_mutex_unlock(&cache_lock);
+      pthread_rwlock_unlock(&shard->lock);
       ERROR("uc_update: Don't know how to handle data source type %i.",
             ds->ds[i].type);
       return -1;
@@ -387,13 +889,14 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   /* Update the history if it exists. */
   if (ce->history != NULL) {
     assert(ce->history_index < ce->history_length);
-    for (size_t i = 0; i < ce->values_num; i++) {
-      size_t hist_idx = (ce->values_num * ce->history_index) + i;
-      ce->history[hist_idx] = ce->values_gauge[i];
-    }
+    for (size_t i = 0; i < ce->values_num; i++)
+      uc_history_push(ce->history + i, ce->history_index, ce->values_gauge[i]);
 
     assert(ce->history_length > 0);
     ce->history_index = (ce->history_index + 1) % ce->history_length;
+    if (ce->history_index == 0)
+      for (size_t i = 0; i < ce->values_num; i++)
+        uc_history_resum(ce->history + i, ce->history_length);
   }
 
   /* Prune invalid gauge data */
@@ -402,8 +905,10 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   ce->last_time = vl->time;
   ce->last_update = cdtime();
   ce->interval = vl->interval;
+  uc_series_append(ce);
 
-  pthread_mutex_unlock(&cache_lock);
+  uc_last_rates_set(vl, ce);
+  pthread_rwlock_unlock(&shard->lock);
 
   return 0;
 } /* int uc_update */
@@ -412,14 +917,12 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num) {
   gauge_t *ret = NULL;
   size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
+  uc_shard_t *shard = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
-
+  cache_entry_t *ce =
+      uc_lock_entry(name, ident_hash(name), /* write = */ false, &shard);
+  if (ce != NULL) {
     /* remove missing values from getval */
     if (ce->state == STATE_MISSING) {
       DEBUG("utils_cache: uc_get_rate_by_name: requested metric \"%s\" is in "
@@ -436,13 +939,12 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
         memcpy(ret, ce->values_gauge, ret_num * sizeof(gauge_t));
       }
     }
+    pthread_rwlock_unlock(&shard->lock);
   } else {
     DEBUG("utils_cache: uc_get_rate_by_name: No such value: %s", name);
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   if (status == 0) {
     *ret_values = ret;
     *ret_values_num = ret_num;
@@ -451,12 +953,95 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
   return status;
 } /* gauge_t *uc_get_rate_by_name */
 
+int uc_get_rate_change(const data_set_t *ds, const value_list_t *vl,
+                       gauge_t *ret_change) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
+  int status = 0;
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL)
+    return -EINVAL;
+
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ false, &shard);
+  if (ce == NULL)
+    return -ENOENT;
+
+  if ((ce->values_num != ds->ds_num) || (vl->values_len != ds->ds_num) ||
+      (ce->last_time >= vl->time)) {
+    pthread_rwlock_unlock(&shard->lock);
+    return -EINVAL;
+  }
+
+  double interval = CDTIME_T_TO_DOUBLE(vl->time - ce->last_time);
+  gauge_t change = 0.0;
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    gauge_t rate;
+
+    switch (ds->ds[i].type) {
+    case DS_TYPE_COUNTER:
+      rate = ((double)counter_diff(ce->values_raw[i].counter,
+                                   vl->values[i].counter)) /
+             interval;
+      break;
+    case DS_TYPE_GAUGE:
+      rate = vl->values[i].gauge;
+      break;
+    case DS_TYPE_DERIVE:
+      rate = ((double)(vl->values[i].derive - ce->values_raw[i].derive)) /
+             interval;
+      break;
+    case DS_TYPE_ABSOLUTE:
+      rate = ((double)vl->values[i].absolute) / interval;
+      break;
+    default:
+      status = -EINVAL;
+      rate = NAN;
+    }
+    if (status != 0)
+      break;
+
+    gauge_t old = ce->values_gauge[i];
+    gauge_t c;
+    if (isnan(old) || isnan(rate))
+      c = (isnan(old) && isnan(rate)) ? 0.0 : INFINITY;
+    else if (old == rate)
+      c = 0.0;
+    else if (old == 0.0)
+      c = INFINITY;
+    else
+      c = fabs(rate - old) / fabs(old);
+
+    if (c > change)
+      change = c;
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+
+  if (status == 0)
+    *ret_change = change;
+  return status;
+} /* int uc_get_rate_change */
+
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
   char name[6 * DATA_MAX_NAME_LEN];
   gauge_t *ret = NULL;
   size_t ret_num = 0;
   int status;
 
+  /* Writers called while `vl' is being dispatched get the rates computed by
+   * uc_update() without a lookup. */
+  uc_last_rates_t const *last = uc_last_rates();
+  if ((last != NULL) && (last->vl == vl) && (last->values == vl->values) &&
+      (last->time == vl->time) && (last->values_num == ds->ds_num)) {
+    ret = malloc(ds->ds_num * sizeof(*ret));
+    if (ret == NULL)
+      return NULL;
+    memcpy(ret, last->rates, ds->ds_num * sizeof(*ret));
+    return ret;
+  }
+
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
     ERROR("utils_cache: uc_get_rate: FORMAT_VL failed.");
     return NULL;
@@ -483,14 +1068,12 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
   value_t *ret = NULL;
   size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
+  uc_shard_t *shard = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
-
+  cache_entry_t *ce =
+      uc_lock_entry(name, ident_hash(name), /* write = */ false, &shard);
+  if (ce != NULL) {
     /* remove missing values from getval */
     if (ce->state == STATE_MISSING) {
       status = -1;
@@ -504,13 +1087,12 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
         memcpy(ret, ce->values_raw, ret_num * sizeof(value_t));
       }
     }
+    pthread_rwlock_unlock(&shard->lock);
   } else {
     DEBUG("utils_cache: uc_get_value_by_name: No such value: %s", name);
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   if (status == 0) {
     *ret_values = ret;
     *ret_values_num = ret_num;
@@ -550,20 +1132,32 @@ value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
 size_t uc_get_size(void) {
   size_t size_arrays = 0;
 
-  pthread_mutex_lock(&cache_lock);
-  size_arrays = (size_t)c_avl_size(cache_tree);
-  pthread_mutex_unlock(&cache_lock);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    pthread_rwlock_rdlock(&cache_shards[i].lock);
+    size_arrays += cache_shards[i].entries_num;
+    pthread_rwlock_unlock(&cache_shards[i].lock);
+  }
 
   return size_arrays;
 }
 
+typedef struct {
+  char *name;
+  cdtime_t time;
+} uc_name_t;
+
+static int uc_name_compare(void const *a, void const *b) {
+  return strcmp(((uc_name_t const *)a)->name, ((uc_name_t const *)b)->name);
+} /* int uc_name_compare */
+
 int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
-  c_avl_iterator_t *iter;
-  char *key;
-  cache_entry_t *value;
+  return uc_get_names_matching(/* pattern = */ NULL, ret_names, ret_times,
+                               ret_number);
+} /* int uc_get_names */
 
-  char **names = NULL;
-  cdtime_t *times = NULL;
+int uc_get_names_matching(char const *pattern, char ***ret_names,
+                          cdtime_t **ret_times, size_t *ret_number) {
+  uc_name_t *entries = NULL;
   size_t number = 0;
   size_t size_arrays = 0;
 
@@ -572,60 +1166,106 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   if ((ret_names == NULL) || (ret_number == NULL))
     return -1;
 
-  pthread_mutex_lock(&cache_lock);
+  /* Names not starting with the literal part of the pattern are skipped
+   * without calling fnmatch(3). */
+  size_t prefix_len = (pattern != NULL) ? strcspn(pattern, "*?[\\") : 0;
 
-  size_arrays = (size_t)c_avl_size(cache_tree);
-  if (size_arrays < 1) {
-    /* Handle the "no values" case here, to avoid the error message when
-     * calloc() returns NULL. */
-    pthread_mutex_unlock(&cache_lock);
-    return 0;
-  }
+  for (size_t s = 0; (s < UC_SHARDS_NUM) && (status == 0); s++) {
+    uc_shard_t *shard = cache_shards + s;
 
-  names = calloc(size_arrays, sizeof(*names));
-  times = calloc(size_arrays, sizeof(*times));
-  if ((names == NULL) || (times == NULL)) {
-    ERROR("uc_get_names: calloc failed.");
-    sfree(names);
-    sfree(times);
-    pthread_mutex_unlock(&cache_lock);
-    return ENOMEM;
-  }
+    pthread_rwlock_rdlock(&shard->lock);
 
-  iter = c_avl_get_iterator(cache_tree);
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
-    /* remove missing values when list values */
-    if (value->state == STATE_MISSING)
-      continue;
-
-    /* c_avl_size does not return a number smaller than the number of elements
-     * returned by c_avl_iterator_next. */
-    assert(number < size_arrays);
+    /* Without a pattern, make room for the whole shard at once. */
+    if ((pattern == NULL) && (shard->entries_num > (size_arrays - number))) {
+      size_t new_size = number + shard->entries_num;
+      uc_name_t *tmp = realloc(entries, new_size * sizeof(*entries));
+      if (tmp == NULL) {
+        ERROR("uc_get_names: realloc failed.");
+        pthread_rwlock_unlock(&shard->lock);
+        status = ENOMEM;
+        break;
+      }
+      entries = tmp;
+      size_arrays = new_size;
+    }
 
-    if (ret_times != NULL)
-      times[number] = value->last_time;
+    for (size_t i = 0; i < shard->slots_num; i++) {
+      cache_entry_t *ce = shard->slots[i];
+      if ((ce == NULL) || (ce == UC_TOMBSTONE))
+        continue;
+
+      /* remove missing values when list values */
+      if (ce->state == STATE_MISSING)
+        continue;
+
+      if ((pattern != NULL) &&
+          ((strncmp(ce->name, pattern, prefix_len) != 0) ||
+           (fnmatch(pattern, ce->name, /* flags = */ 0) != 0)))
+        continue;
+
+      if (number >= size_arrays) {
+        size_t new_size = (size_arrays > 0) ? (2 * size_arrays) : 64;
+        uc_name_t *tmp = realloc(entries, new_size * sizeof(*entries));
+        if (tmp == NULL) {
+          ERROR("uc_get_names: realloc failed.");
+          status = ENOMEM;
+          break;
+        }
+        entries = tmp;
+        size_arrays = new_size;
+      }
 
-    names[number] = strdup(key);
-    if (names[number] == NULL) {
-      status = -1;
-      break;
-    }
+      entries[number].time = ce->last_time;
+      entries[number].name = strdup(ce->name);
+      if (entries[number].name == NULL) {
+        status = -1;
+        break;
+      }
 
-    number++;
-  } /* while (c_avl_iterator_next) */
+      number++;
+    } /* for (i) */
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&shard->lock);
+  } /* for (s) */
 
   if (status != 0) {
     for (size_t i = 0; i < number; i++) {
-      sfree(names[i]);
+      sfree(entries[i].name);
     }
+    sfree(entries);
+
+    return -1;
+  }
+
+  if (number == 0) {
+    sfree(entries);
+    *ret_names = NULL;
+    if (ret_times != NULL)
+      *ret_times = NULL;
+    *ret_number = 0;
+    return 0;
+  }
+
+  /* The hash table has no order; keep returning the names sorted. */
+  qsort(entries, number, sizeof(*entries), uc_name_compare);
+
+  char **names = calloc(number, sizeof(*names));
+  cdtime_t *times = calloc(number, sizeof(*times));
+  if ((names == NULL) || (times == NULL)) {
+    ERROR("uc_get_names: calloc failed.");
+    for (size_t i = 0; i < number; i++)
+      sfree(entries[i].name);
+    sfree(entries);
     sfree(names);
     sfree(times);
+    return ENOMEM;
+  }
 
-    return -1;
+  for (size_t i = 0; i < number; i++) {
+    names[i] = entries[i].name;
+    times[i] = entries[i].time;
   }
+  sfree(entries);
 
   *ret_names = names;
   if (ret_times != NULL)
@@ -635,109 +1275,124 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   *ret_number = number;
 
   return 0;
-} /* int uc_get_names */
+} /* int uc_get_names_matching */
 
 int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
   int ret = STATE_ERROR;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_get_state: FORMAT_VL failed.");
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ false, &shard);
+  if (ce != NULL) {
     ret = ce->state;
+    pthread_rwlock_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_get_state */
 
 int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_set_state: FORMAT_VL failed.");
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, &shard);
+  if (ce != NULL) {
     ret = ce->state;
     ce->state = state;
+    pthread_rwlock_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_set_state */
 
+int uc_threshold_update(const data_set_t *ds, const value_list_t *vl,
+                        uc_threshold_callback_t callback, void *user_data) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
+    ERROR("uc_threshold_update: FORMAT_VL failed.");
+    return EINVAL;
+  }
+
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, &shard);
+  if (ce == NULL)
+    return ENOENT;
+
+  uc_threshold_state_t state = {
+      .threshold = ce->threshold,
+      .generation = ce->threshold_generation,
+      .state = ce->state,
+      .hits = ce->hits,
+  };
+
+  callback(ce->values_gauge, ce->values_num, &state, user_data);
+
+  ce->threshold = state.threshold;
+  ce->threshold_generation = state.generation;
+  ce->state = state.state;
+  ce->hits = state.hits;
+
+  pthread_rwlock_unlock(&shard->lock);
+  return 0;
+} /* int uc_threshold_update */
+
 int uc_get_history_by_name(const char *name, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds) {
-  cache_entry_t *ce = NULL;
-  int status = 0;
+  uc_shard_t *shard = NULL;
 
-  pthread_mutex_lock(&cache_lock);
-
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  /* The history buffer may be resized, which requires the write lock. */
+  cache_entry_t *ce =
+      uc_lock_entry(name, ident_hash(name), /* write = */ true, &shard);
+  if (ce == NULL)
     return -ENOENT;
-  }
 
   if (((size_t)ce->values_num) != num_ds) {
-    pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&shard->lock);
     return -EINVAL;
   }
 
   /* Check if there are enough values available. If not, increase the buffer
    * size. */
   if (ce->history_length < num_steps) {
-    gauge_t *tmp;
-
-    tmp =
-        realloc(ce->history, sizeof(*ce->history) * num_steps * ce->values_num);
-    if (tmp == NULL) {
-      pthread_mutex_unlock(&cache_lock);
-      return -ENOMEM;
+    int status = uc_history_resize(ce, num_steps);
+    if (status != 0) {
+      pthread_rwlock_unlock(&shard->lock);
+      return -status;
     }
+  }
 
-    for (size_t i = ce->history_length * ce->values_num;
-         i < (num_steps * ce->values_num); i++)
-      tmp[i] = NAN;
-
-    ce->history = tmp;
-    ce->history_length = num_steps;
-  } /* if (ce->history_length < num_steps) */
-
-  /* Copy the values to the output buffer. */
+  /* Copy the values to the output buffer, most recent first. */
   for (size_t i = 0; i < num_steps; i++) {
     size_t src_index;
-    size_t dst_index;
 
     if (i < ce->history_index)
       src_index = ce->history_index - (i + 1);
     else
       src_index = ce->history_length + ce->history_index - (i + 1);
-    src_index = src_index * num_ds;
-
-    dst_index = i * num_ds;
 
-    memcpy(ret_history + dst_index, ce->history + src_index,
-           sizeof(*ret_history) * num_ds);
+    for (size_t j = 0; j < num_ds; j++)
+      ret_history[i * num_ds + j] = ce->history[j].values[src_index];
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&shard->lock);
 
   return 0;
 } /* int uc_get_history_by_name */
@@ -754,115 +1409,621 @@ int uc_get_history(const data_set_t *ds, const value_list_t *vl,
   return uc_get_history_by_name(name, ret_history, num_steps, num_ds);
 } /* int uc_get_history */
 
-int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
+void uc_set_reorder_window(cdtime_t window) {
+  reorder_window = window;
+} /* void uc_set_reorder_window */
+
+void uc_get_late_stats(uint64_t *ret_late, uint64_t *ret_too_old) {
+  *ret_late = __atomic_load_n(&stats_late, __ATOMIC_RELAXED);
+  *ret_too_old = __atomic_load_n(&stats_too_old, __ATOMIC_RELAXED);
+} /* void uc_get_late_stats */
+
+void uc_set_series_span(cdtime_t span) {
+  series_span = span;
+} /* void uc_set_series_span */
+
+int uc_get_series_by_name(const char *name, cdtime_t start, cdtime_t end,
+                          cdtime_t **ret_times, gauge_t **ret_values,
+                          size_t *ret_num, size_t *ret_values_num) {
+  uc_shard_t *shard = NULL;
+
+  if ((ret_times == NULL) || (ret_values == NULL) || (ret_num == NULL) ||
+      (ret_values_num == NULL))
+    return -EINVAL;
+
+  cache_entry_t *ce =
+      uc_lock_entry(name, ident_hash(name), /* write = */ false, &shard);
+  if (ce == NULL)
+    return -ENOENT;
+
+  int status = 0;
+  *ret_values_num = ce->values_num;
+  if (ce->series != NULL) {
+    status = c_tsz_read(ce->series, start, end, ret_times, ret_values, ret_num);
+  } else {
+    *ret_times = NULL;
+    *ret_values = NULL;
+    *ret_num = 0;
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+
+  return -status;
+} /* int uc_get_series_by_name */
+
+int uc_get_window_by_name(const char *name, uc_window_t *ret_window,
+                          size_t num_steps, size_t num_ds) {
+  uc_shard_t *shard = NULL;
+
+  if (num_steps == 0)
+    return -EINVAL;
+
+  /* The history buffer may be resized, which requires the write lock. */
+  cache_entry_t *ce =
+      uc_lock_entry(name, ident_hash(name), /* write = */ true, &shard);
+  if (ce == NULL)
+    return -ENOENT;
+
+  if (((size_t)ce->values_num) != num_ds) {
+    pthread_rwlock_unlock(&shard->lock);
+    return -EINVAL;
+  }
+
+  if (ce->history_length < num_steps) {
+    int status = uc_history_resize(ce, num_steps);
+    if (status != 0) {
+      pthread_rwlock_unlock(&shard->lock);
+      return -status;
+    }
+  }
+
+  for (size_t i = 0; i < num_ds; i++) {
+    uc_history_t *h = ce->history + i;
+    uc_window_t *w = ret_window + i;
+
+    *w = (uc_window_t){.min = NAN, .max = NAN, .sum = 0.0, .average = NAN};
+
+    if (num_steps == ce->history_length) {
+      /* The aggregates are maintained for the whole history. */
+      w->num = h->num;
+      w->sum = h->sum;
+      if (h->num > 0) {
+        w->min = uc_history_value(h, DEQ_HEAD(h->min));
+        w->max = uc_history_value(h, DEQ_HEAD(h->max));
+      }
+    } else {
+      /* A shorter window than another consumer of this entry needs. */
+      for (size_t j = 0; j < num_steps; j++) {
+        size_t index =
+            (ce->history_index + ce->history_length - (j + 1)) %
+            ce->history_length;
+        gauge_t v = h->values[index];
+        if (isnan(v))
+          continue;
+        if ((w->num == 0) || (v < w->min))
+          w->min = v;
+        if ((w->num == 0) || (v > w->max))
+          w->max = v;
+        w->sum += v;
+        w->num++;
+      }
+    }
+
+    if (w->num > 0)
+      w->average = w->sum / (gauge_t)w->num;
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+  return 0;
+} /* int uc_get_window_by_name */
+
+int uc_get_window(const data_set_t *ds, const value_list_t *vl,
+                  uc_window_t *ret_window, size_t num_steps, size_t num_ds) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
-  int ret = STATE_ERROR;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+    ERROR("utils_cache: uc_get_window: FORMAT_VL failed.");
+    return -1;
+  }
+
+  return uc_get_window_by_name(name, ret_window, num_steps, num_ds);
+} /* int uc_get_window */
+
+int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
+  int ret = STATE_ERROR;
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_get_hits: FORMAT_VL failed.");
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ false, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
+    pthread_rwlock_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_get_hits */
 
 int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_set_hits: FORMAT_VL failed.");
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = hits;
+    pthread_rwlock_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_set_hits */
 
 int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("uc_inc_hits: FORMAT_VL failed.");
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = ret + step;
+    pthread_rwlock_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_inc_hits */
 
 /*
- * Iterator interface
+ * Snapshots
+ *
+ * A snapshot is a header followed by one record per entry, all in the host's
+ * byte order. Every record is followed by the raw values, the rates and the
+ * name (without the terminating null byte), and is padded to a multiple of
+ * eight bytes. Meta data and history are not part of the snapshot.
  */
-uc_iter_t *uc_get_iterator(void) {
-  uc_iter_t *iter = calloc(1, sizeof(*iter));
-  if (iter == NULL)
+#define UC_SNAPSHOT_MAGIC "collectd"
+#define UC_SNAPSHOT_VERSION 1
+/* Written as is, so that a snapshot from a host with a different byte order
+ * is recognized. */
+#define UC_SNAPSHOT_BYTE_ORDER UINT64_C(0x0102030405060708)
+
+typedef struct {
+  char magic[8];
+  uint64_t byte_order;
+  uint64_t version;
+  uint64_t time; /* when the snapshot was written */
+  uint64_t entries_num;
+} uc_snapshot_header_t;
+
+typedef struct {
+  uint64_t last_time;
+  uint64_t last_update;
+  uint64_t interval;
+  int32_t state;
+  uint16_t values_num;
+  uint16_t name_len;
+} uc_snapshot_record_t;
+
+/* The size of a record without the padding. */
+static size_t uc_snapshot_record_len(size_t values_num, size_t name_len) {
+  return sizeof(uc_snapshot_record_t) +
+         values_num * (sizeof(value_t) + sizeof(gauge_t)) + name_len;
+} /* size_t uc_snapshot_record_len */
+
+static size_t uc_snapshot_record_size(size_t values_num, size_t name_len) {
+  return (uc_snapshot_record_len(values_num, name_len) + 7) & ~((size_t)7);
+} /* size_t uc_snapshot_record_size */
+
+static int uc_snapshot_write(FILE *fh, uint64_t *ret_entries_num) {
+  static char const padding[8];
+  int status = 0;
+
+  for (size_t s = 0; (s < UC_SHARDS_NUM) && (status == 0); s++) {
+    uc_shard_t *shard = cache_shards + s;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    for (size_t i = 0; i < shard->slots_num; i++) {
+      cache_entry_t *ce = shard->slots[i];
+      if ((ce == NULL) || (ce == UC_TOMBSTONE))
+        continue;
+
+      uc_snapshot_record_t r = {
+          .last_time = (uint64_t)ce->last_time,
+          .last_update = (uint64_t)ce->last_update,
+          .interval = (uint64_t)ce->interval,
+          .state = (int32_t)ce->state,
+          .values_num = (uint16_t)ce->values_num,
+          .name_len = (uint16_t)strlen(ce->name),
+      };
+      size_t padding_len = uc_snapshot_record_size(r.values_num, r.name_len) -
+                           uc_snapshot_record_len(r.values_num, r.name_len);
+
+      if ((fwrite(&r, sizeof(r), 1, fh) != 1) ||
+          (fwrite(ce->values_raw, sizeof(value_t), ce->values_num, fh) !=
+           ce->values_num) ||
+          (fwrite(ce->values_gauge, sizeof(gauge_t), ce->values_num, fh) !=
+           ce->values_num) ||
+          (fwrite(ce->name, 1, r.name_len, fh) != r.name_len) ||
+          (fwrite(padding, 1, padding_len, fh) != padding_len)) {
+        status = errno ? errno : EIO;
+        break;
+      }
+      (*ret_entries_num)++;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+
+  return status;
+} /* int uc_snapshot_write */
+
+int uc_save(const char *file) {
+  if ((file == NULL) || !cache_initialized)
+    return EINVAL;
+
+  char tmp[PATH_MAX];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", file) >= (int)sizeof(tmp)) {
+    ERROR("uc_save: File name too long: %s", file);
+    return ENAMETOOLONG;
+  }
+
+  FILE *fh = fopen(tmp, "w");
+  if (fh == NULL) {
+    int status = errno;
+    ERROR("uc_save: Opening \"%s\" failed: %s", tmp, STRERROR(status));
+    return status;
+  }
+
+  uc_snapshot_header_t h = {
+      .byte_order = UC_SNAPSHOT_BYTE_ORDER,
+      .version = UC_SNAPSHOT_VERSION,
+      .time = (uint64_t)cdtime(),
+  };
+  memcpy(h.magic, UC_SNAPSHOT_MAGIC, sizeof(h.magic));
+
+  int status = 0;
+  if (fwrite(&h, sizeof(h), 1, fh) != 1)
+    status = errno ? errno : EIO;
+  if (status == 0)
+    status = uc_snapshot_write(fh, &h.entries_num);
+  /* Fill in the number of entries. */
+  if ((status == 0) &&
+      ((fseek(fh, 0, SEEK_SET) != 0) || (fwrite(&h, sizeof(h), 1, fh) != 1)))
+    status = errno ? errno : EIO;
+  if (fclose(fh) != 0 && status == 0)
+    status = errno ? errno : EIO;
+
+  if (status == 0 && rename(tmp, file) != 0)
+    status = errno;
+  if (status != 0) {
+    ERROR("uc_save: Writing \"%s\" failed: %s", file, STRERROR(status));
+    unlink(tmp);
+    return status;
+  }
+
+  DEBUG("uc_save: Saved %" PRIu64 " entries to \"%s\".", h.entries_num, file);
+  return 0;
+} /* int uc_save */
+
+/* Makes room for `num' more entries, so that inserting them doesn't rehash
+ * the shard over and over. Must hold the shard's write lock. */
+static int shard_reserve(uc_shard_t *shard, size_t num) {
+  size_t slots_num = (shard->slots_num == 0) ? UC_MIN_SLOTS : shard->slots_num;
+  while (4 * (shard->entries_num + shard->tombstones_num + num) >
+         3 * slots_num)
+    slots_num *= 2;
+
+  if (slots_num == shard->slots_num)
+    return 0;
+  return shard_resize(shard, slots_num);
+} /* int shard_reserve */
+
+/* Creates the cache entry for the snapshot record `r'. Returns NULL if the
+ * record is invalid or the entry had timed out when the snapshot was written.
+ * The time the daemon was down doesn't count towards the timeout: the entry
+ * is as old now as it was back then. */
+static cache_entry_t *uc_snapshot_entry(uc_snapshot_record_t const *r,
+                                        char const *data, cdtime_t saved,
+                                        cdtime_t now) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  if ((r->name_len == 0) || (r->name_len >= sizeof(name)))
     return NULL;
+  memcpy(name, data + r->values_num * (sizeof(value_t) + sizeof(gauge_t)),
+         r->name_len);
+  name[r->name_len] = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  /* The types may have changed since the snapshot was taken. */
+  value_list_t vl = VALUE_LIST_INIT;
+  if (parse_identifier_vl(name, &vl) != 0)
+    return NULL;
+  data_set_t const *ds = plugin_get_ds(vl.type);
+  if ((ds == NULL) || (ds->ds_num != r->values_num))
+    return NULL;
+
+  cdtime_t last_update = (cdtime_t)r->last_update;
+  if ((last_update > saved) ||
+      (last_update + (cdtime_t)r->interval * (cdtime_t)timeout_g < saved))
+    return NULL;
 
-  iter->iter = c_avl_get_iterator(cache_tree);
-  if (iter->iter == NULL) {
-    free(iter);
+  cache_entry_t *ce = cache_alloc(name, ident_hash(name), r->values_num);
+  if (ce == NULL)
     return NULL;
+
+  memcpy(ce->values_raw, data, r->values_num * sizeof(value_t));
+  memcpy(ce->values_gauge, data + r->values_num * sizeof(value_t),
+         r->values_num * sizeof(gauge_t));
+  ce->last_time = (cdtime_t)r->last_time;
+  ce->last_update = now - (saved - last_update);
+  ce->interval = (cdtime_t)r->interval;
+  ce->state = (int)r->state;
+
+  return ce;
+} /* cache_entry_t *uc_snapshot_entry */
+
+/* Reads the entries from the mapped snapshot into `entries', which has room
+ * for all of them. */
+static int uc_snapshot_read(char const *map, size_t size,
+                            cache_entry_t **entries, size_t *ret_num) {
+  uc_snapshot_header_t h;
+  memcpy(&h, map, sizeof(h));
+
+  cdtime_t now = cdtime();
+  size_t offset = sizeof(h);
+  *ret_num = 0;
+  for (uint64_t i = 0; i < h.entries_num; i++) {
+    uc_snapshot_record_t r;
+    if (size - offset < sizeof(r))
+      return EINVAL;
+    memcpy(&r, map + offset, sizeof(r));
+
+    size_t record_size = uc_snapshot_record_size(r.values_num, r.name_len);
+    if (size - offset < record_size)
+      return EINVAL;
+
+    cache_entry_t *ce =
+        uc_snapshot_entry(&r, map + offset + sizeof(r), h.time, now);
+    if (ce != NULL)
+      entries[(*ret_num)++] = ce;
+    offset += record_size;
+  }
+
+  return 0;
+} /* int uc_snapshot_read */
+
+int uc_load(const char *file) {
+  if ((file == NULL) || !cache_initialized)
+    return EINVAL;
+
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    int status = errno;
+    if (status == ENOENT)
+      return 0;
+    ERROR("uc_load: Opening \"%s\" failed: %s", file, STRERROR(status));
+    return status;
+  }
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    int status = errno;
+    ERROR("uc_load: Stat'ing \"%s\" failed: %s", file, STRERROR(status));
+    close(fd);
+    return status;
   }
 
-  return iter;
+  size_t size = (size_t)statbuf.st_size;
+  uc_snapshot_header_t h;
+  if (size < sizeof(h)) {
+    ERROR("uc_load: \"%s\" is not a snapshot of the value cache.", file);
+    close(fd);
+    return EINVAL;
+  }
+
+  char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    int status = errno;
+    ERROR("uc_load: mmap \"%s\" failed: %s", file, STRERROR(status));
+    return status;
+  }
+
+  memcpy(&h, map, sizeof(h));
+  if ((memcmp(h.magic, UC_SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) ||
+      (h.byte_order != UC_SNAPSHOT_BYTE_ORDER) ||
+      (h.version != UC_SNAPSHOT_VERSION) ||
+      /* Every record takes at least 32 bytes. */
+      (h.entries_num > (size - sizeof(h)) / sizeof(uc_snapshot_record_t))) {
+    ERROR("uc_load: \"%s\" is not a snapshot of the value cache.", file);
+    munmap(map, size);
+    return EINVAL;
+  }
+
+  cache_entry_t **entries = calloc(h.entries_num + 1, sizeof(*entries));
+  if (entries == NULL) {
+    ERROR("uc_load: calloc failed.");
+    munmap(map, size);
+    return ENOMEM;
+  }
+
+  size_t entries_num = 0;
+  int status = uc_snapshot_read(map, size, entries, &entries_num);
+  munmap(map, size);
+  if (status != 0) {
+    ERROR("uc_load: \"%s\" is truncated.", file);
+    for (size_t i = 0; i < entries_num; i++)
+      cache_free(entries[i]);
+    sfree(entries);
+    return status;
+  }
+
+  /* Sort the entries by shard, so that every shard is locked and grown
+   * once. */
+  size_t offsets[UC_SHARDS_NUM + 1] = {0};
+  for (size_t i = 0; i < entries_num; i++)
+    offsets[uc_shard(entries[i]->hash) - cache_shards + 1]++;
+  for (size_t s = 0; s < UC_SHARDS_NUM; s++)
+    offsets[s + 1] += offsets[s];
+
+  cache_entry_t **sorted = calloc(entries_num + 1, sizeof(*sorted));
+  if (sorted == NULL) {
+    ERROR("uc_load: calloc failed.");
+    for (size_t i = 0; i < entries_num; i++)
+      cache_free(entries[i]);
+    sfree(entries);
+    return ENOMEM;
+  }
+  size_t next[UC_SHARDS_NUM];
+  memcpy(next, offsets, sizeof(next));
+  for (size_t i = 0; i < entries_num; i++)
+    sorted[next[uc_shard(entries[i]->hash) - cache_shards]++] = entries[i];
+  sfree(entries);
+
+  size_t loaded = 0;
+  for (size_t s = 0; s < UC_SHARDS_NUM; s++) {
+    uc_shard_t *shard = cache_shards + s;
+    if (offsets[s] == offsets[s + 1])
+      continue;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    if (shard_reserve(shard, offsets[s + 1] - offsets[s]) != 0)
+      ERROR("uc_load: shard_reserve failed.");
+
+    for (size_t i = offsets[s]; i < offsets[s + 1]; i++) {
+      cache_entry_t *ce = sorted[i];
+      sorted[i] = NULL;
+
+      /* Values dispatched since the start are newer than the snapshot. */
+      if ((shard_get(shard, ce->name, ce->hash) != NULL) ||
+          (shard_insert(shard, ce) != 0)) {
+        cache_free(ce);
+        continue;
+      }
+
+      ce->expires = uc_deadline(ce);
+      if (c_heap_insert(shard->expiry, ce) != 0) {
+        shard_remove(shard, ce->name, ce->hash);
+        cache_free(ce);
+        continue;
+      }
+      loaded++;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+  sfree(sorted);
+
+  INFO("uc_load: Restored %" PRIsz " of %" PRIu64 " entries from \"%s\".",
+       loaded, h.entries_num, file);
+  return 0;
+} /* int uc_load */
+
+/*
+ * Iterator interface
+ */
+uc_iter_t *uc_get_iterator(void) {
+  return calloc(1, sizeof(uc_iter_t));
 } /* uc_iter_t *uc_get_iterator */
 
-int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
-  int status;
+/* Replaces the iterator's entries with copies of the entries of `shard'. The
+ * shard is only locked while copying. */
+static int uc_iterator_copy(uc_iter_t *iter, uc_shard_t *shard) {
+  pthread_rwlock_rdlock(&shard->lock);
+
+  size_t entries_num = 0;
+  size_t values_num = 0;
+  size_t names_size = 0;
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    cache_entry_t *ce = shard->slots[i];
+    if ((ce == NULL) || (ce == UC_TOMBSTONE) || (ce->state == STATE_MISSING))
+      continue;
 
-  if (iter == NULL)
-    return -1;
+    entries_num++;
+    values_num += ce->values_num;
+    names_size += strlen(ce->name) + 1;
+  }
+
+  /* The values come right after the entries, since value_t has the stricter
+   * alignment, and the names last. */
+  uc_iter_entry_t *entries = NULL;
+  if (entries_num > 0) {
+    entries = malloc(entries_num * sizeof(*entries) +
+                     values_num * sizeof(value_t) + names_size);
+    if (entries == NULL) {
+      pthread_rwlock_unlock(&shard->lock);
+      ERROR("uc_iterator_next: malloc failed.");
+      return ENOMEM;
+    }
+  }
 
-  while ((status = c_avl_iterator_next(iter->iter, (void *)&iter->name,
-                                       (void *)&iter->entry)) == 0) {
-    if (iter->entry->state == STATE_MISSING)
+  value_t *values = (value_t *)(entries + entries_num);
+  char *names = (char *)(values + values_num);
+  size_t n = 0;
+  for (size_t i = 0; (i < shard->slots_num) && (n < entries_num); i++) {
+    cache_entry_t *ce = shard->slots[i];
+    if ((ce == NULL) || (ce == UC_TOMBSTONE) || (ce->state == STATE_MISSING))
       continue;
 
-    break;
+    size_t name_size = strlen(ce->name) + 1;
+    memcpy(names, ce->name, name_size);
+    memcpy(values, ce->values_raw, ce->values_num * sizeof(*values));
+
+    entries[n++] = (uc_iter_entry_t){
+        .name = names,
+        .hash = ce->hash,
+        .time = ce->last_time,
+        .interval = ce->interval,
+        .values_num = ce->values_num,
+        .values = values,
+    };
+    names += name_size;
+    values += ce->values_num;
   }
-  if (status != 0) {
-    iter->name = NULL;
-    iter->entry = NULL;
+
+  pthread_rwlock_unlock(&shard->lock);
+
+  free(iter->entries);
+  iter->entries = entries;
+  iter->entries_num = entries_num;
+  iter->index = 0;
+  return 0;
+} /* int uc_iterator_copy */
+
+int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
+  if (iter == NULL)
     return -1;
+
+  iter->entry = NULL;
+  while (iter->index >= iter->entries_num) {
+    if (iter->shard >= UC_SHARDS_NUM)
+      return -1;
+    if (uc_iterator_copy(iter, cache_shards + iter->shard) != 0)
+      return -1;
+    iter->shard++;
   }
 
+  iter->entry = iter->entries + iter->index;
+  iter->index++;
   if (ret_name != NULL)
-    *ret_name = iter->name;
-
+    *ret_name = iter->entry->name;
   return 0;
 } /* int uc_iterator_next */
 
@@ -870,9 +2031,7 @@ void uc_iterator_destroy(uc_iter_t *iter) {
   if (iter == NULL)
     return;
 
-  c_avl_iterator_destroy(iter->iter);
-  pthread_mutex_unlock(&cache_lock);
-
+  free(iter->entries);
   free(iter);
 } /* void uc_iterator_destroy */
 
@@ -880,7 +2039,7 @@ int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_time == NULL))
     return -1;
 
-  *ret_time = iter->entry->last_time;
+  *ret_time = iter->entry->time;
   return 0;
 } /* int uc_iterator_get_name */
 
@@ -890,12 +2049,11 @@ int uc_iterator_get_values(uc_iter_t *iter, value_t **ret_values,
       (ret_num == NULL))
     return -1;
 
-  *ret_values =
-      calloc(iter->entry->values_num, sizeof(*iter->entry->values_raw));
+  *ret_values = calloc(iter->entry->values_num, sizeof(**ret_values));
   if (*ret_values == NULL)
     return -1;
-  for (size_t i = 0; i < iter->entry->values_num; ++i)
-    *ret_values[i] = iter->entry->values_raw[i];
+  memcpy(*ret_values, iter->entry->values,
+         iter->entry->values_num * sizeof(**ret_values));
 
   *ret_num = iter->entry->values_num;
 
@@ -914,7 +2072,18 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_meta == NULL))
     return -1;
 
-  *ret_meta = meta_data_clone(iter->entry->meta);
+  /* Meta data isn't copied along with the entries: it's looked up only when
+   * asked for, and may be newer than the rest of the copy. */
+  uc_shard_t *shard = NULL;
+  cache_entry_t *ce =
+      uc_lock_entry(iter->entry->name, iter->entry->hash, false, &shard);
+  if (ce == NULL) {
+    *ret_meta = NULL;
+    return 0;
+  }
+
+  *ret_meta = meta_data_clone(ce->meta);
+  pthread_rwlock_unlock(&shard->lock);
 
   return 0;
 } /* int uc_iterator_get_meta */
@@ -922,48 +2091,73 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
 /*
  * Meta data interface
  */
-/* XXX: This function will acquire `cache_lock' but will not free it! */
-static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
-{
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
-  int status;
-
-  status = FORMAT_VL(name, sizeof(name), vl);
-  if (status != 0) {
+/* XXX: This function will acquire the lock of `*ret_shard' but will not free
+ * it! */
+static meta_data_t *uc_get_meta(const value_list_t *vl, /* {{{ */
+                                uc_shard_t **ret_shard) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
     ERROR("utils_cache: uc_get_meta: FORMAT_VL failed.");
     return NULL;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, ret_shard);
+  if (ce == NULL)
     return NULL;
-  }
-  assert(ce != NULL);
 
   if (ce->meta == NULL)
     ce->meta = meta_data_create();
 
   if (ce->meta == NULL)
-    pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&(*ret_shard)->lock);
 
   return ce->meta;
 } /* }}} meta_data_t *uc_get_meta */
 
+int uc_meta_data_update(const value_list_t *vl, /* {{{ */
+                        uc_meta_data_callback_t callback, void *user_data) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  uint64_t hash;
+  uc_shard_t *shard = NULL;
+
+  char const *name = uc_vl_name(vl, buffer, sizeof(buffer), &hash);
+  if (name == NULL) {
+    ERROR("uc_meta_data_update: FORMAT_VL failed.");
+    return EINVAL;
+  }
+
+  cache_entry_t *ce = uc_lock_entry(name, hash, /* write = */ true, &shard);
+  if (ce == NULL)
+    return ENOENT;
+
+  if (ce->meta == NULL)
+    ce->meta = meta_data_create();
+  if (ce->meta == NULL) {
+    pthread_rwlock_unlock(&shard->lock);
+    return ENOMEM;
+  }
+
+  int status = callback(ce->meta, user_data);
+
+  pthread_rwlock_unlock(&shard->lock);
+  return status;
+} /* }}} int uc_meta_data_update */
+
 /* Sorry about this preprocessor magic, but it really makes this file much
  * shorter.. */
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
     meta_data_t *meta;                                                         \
+    uc_shard_t *shard;                                                         \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key);                                         \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_rwlock_unlock(&shard->lock);                                       \
     return status;                                                             \
   }
 int uc_meta_data_exists(const value_list_t *vl,
@@ -978,12 +2172,13 @@ int uc_meta_data_exists(const value_list_t *vl,
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
     meta_data_t *meta;                                                         \
+    uc_shard_t *shard;                                                         \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key, value);                                  \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_rwlock_unlock(&shard->lock);                                       \
     return status;                                                             \
   }
         int uc_meta_data_add_string(const value_list_t *vl, const char *key,
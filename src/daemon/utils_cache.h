@@ -39,16 +39,81 @@
 
 int uc_init(void);
 int uc_check_timeout(void);
+
+/*
+ * NAME
+ *   uc_save
+ *
+ * DESCRIPTION
+ *   Writes a snapshot of the cache to `file': the identifier, raw values,
+ *   rates, times, interval and state of every entry. The snapshot is written
+ *   to "<file>.tmp" first and renamed when it is complete.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise.
+ */
+int uc_save(const char *file);
+
+/*
+ * NAME
+ *   uc_load
+ *
+ * DESCRIPTION
+ *   Adds the entries of a snapshot written by `uc_save' to the cache, so that
+ *   the first values after a restart get a rate. Entries that had timed out
+ *   when the snapshot was written, whose type no longer matches and that are
+ *   already in the cache are skipped. The time between writing and loading
+ *   the snapshot doesn't count towards the timeout.
+ *
+ * RETURN VALUE
+ *   Zero upon success or if `file' doesn't exist, an errno value otherwise.
+ */
+int uc_load(const char *file);
+/* Returned by "uc_update" if "vl" isn't newer than its entry, which keeps the
+ * newer values. A late value is within the reorder window, see
+ * "uc_set_reorder_window"; its rates are remembered like the rates of an
+ * update, with NaN for all but gauges. */
+#define UC_UPDATE_LATE 1
+#define UC_UPDATE_TOO_OLD 2
+
+/* Updates the entry of "vl". The calling thread remembers the rates until
+ * its next call or "uc_clear_rates", so that "uc_get_rate" returns them for
+ * this very value list without looking the entry up again, even if the
+ * identifier of "vl" is changed in the meantime. Returns zero, one of the
+ * values above or -1 on error. */
 int uc_update(const data_set_t *ds, const value_list_t *vl);
+/* Forgets the rates remembered by "uc_update". Called once the value list has
+ * been dispatched. */
+void uc_clear_rates(void);
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num);
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl);
+/*
+ * NAME
+ *   uc_get_rate_change
+ *
+ * DESCRIPTION
+ *   Computes the rates the values of "vl" would get if they were added to the
+ *   cache, without adding them, and returns the largest relative difference
+ *   to the current rates of the entry in "ret_change". A change from or to
+ *   zero or NaN is infinite.
+ *
+ * RETURN VALUE
+ *   Zero upon success, a negative errno value otherwise. -ENOENT if there is
+ *   no entry for "vl", -EINVAL if "vl" is not newer than the entry.
+ */
+int uc_get_rate_change(const data_set_t *ds, const value_list_t *vl,
+                       gauge_t *ret_change);
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num);
 value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl);
 
 size_t uc_get_size(void);
 int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number);
+/* Like uc_get_names, but only returns the names matching the shell wildcard
+ * "pattern" (see fnmatch(3)). All names are returned if "pattern" is NULL. */
+int uc_get_names_matching(char const *pattern, char ***ret_names,
+                          cdtime_t **ret_times, size_t *ret_number);
 
 int uc_get_state(const data_set_t *ds, const value_list_t *vl);
 int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state);
@@ -61,6 +126,111 @@ int uc_get_history(const data_set_t *ds, const value_list_t *vl,
 int uc_get_history_by_name(const char *name, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds);
 
+/* Aggregates over the last values of one data source. NaN values are
+ * ignored; "min", "max" and "average" are NaN if there are no other values. */
+typedef struct {
+  gauge_t min;
+  gauge_t max;
+  gauge_t sum;
+  gauge_t average;
+  size_t num;
+} uc_window_t;
+
+/*
+ * NAME
+ *   uc_get_window_by_name
+ *
+ * DESCRIPTION
+ *   Returns the aggregates over the last "num_steps" values of each of the
+ *   "num_ds" data sources of an entry in "ret_window". Like
+ *   uc_get_history_by_name, this makes the cache keep (at least) that many
+ *   values of the entry. The aggregates over the entire history are
+ *   maintained as values are added, so if "num_steps" is the longest window
+ *   requested for the entry, this takes constant time.
+ *
+ * RETURN VALUE
+ *   Zero upon success, a negative errno value otherwise.
+ */
+int uc_get_window(const data_set_t *ds, const value_list_t *vl,
+                  uc_window_t *ret_window, size_t num_steps, size_t num_ds);
+int uc_get_window_by_name(const char *name, uc_window_t *ret_window,
+                          size_t num_steps, size_t num_ds);
+
+/*
+ * NAME
+ *   uc_set_reorder_window
+ *
+ * DESCRIPTION
+ *   Values up to "window" older than the newest value of their entry are
+ *   late rather than too old, see "uc_update". Zero, the default, makes all
+ *   such values too old. Must be called before values are dispatched.
+ */
+void uc_set_reorder_window(cdtime_t window);
+
+/* Returns the number of late and too old values "uc_update" has seen. */
+void uc_get_late_stats(uint64_t *ret_late, uint64_t *ret_too_old);
+
+/*
+ * NAME
+ *   uc_set_series_span
+ *
+ * DESCRIPTION
+ *   Makes every entry keep the rates of the last "span" in a compressed
+ *   series, see utils/tsz/tsz.h. Zero, the default, disables the series.
+ *   Must be called before values are dispatched.
+ */
+void uc_set_series_span(cdtime_t span);
+
+/*
+ * NAME
+ *   uc_get_series_by_name
+ *
+ * DESCRIPTION
+ *   Returns the rates of an entry with a time within [start, end], oldest
+ *   first. "ret_times" receives one time per point and "ret_values"
+ *   "ret_values_num" rates per point. Both have to be freed by the caller;
+ *   they are NULL if there are no such points. Times have millisecond
+ *   precision.
+ *
+ * RETURN VALUE
+ *   Zero upon success, a negative errno value otherwise.
+ */
+int uc_get_series_by_name(const char *name, cdtime_t start, cdtime_t end,
+                          cdtime_t **ret_times, gauge_t **ret_values,
+                          size_t *ret_num, size_t *ret_values_num);
+
+/* The threshold state of an entry. "threshold" is opaque to the cache; it's
+ * set by the threshold checks and is only valid for "generation". "state" and
+ * "hits" are the values returned by uc_get_state and uc_get_hits. */
+typedef struct {
+  void const *threshold;
+  uint64_t generation;
+  int state;
+  int hits;
+} uc_threshold_state_t;
+
+typedef void (*uc_threshold_callback_t)(gauge_t const *rates,
+                                        size_t rates_num,
+                                        uc_threshold_state_t *state,
+                                        void *user_data);
+
+/*
+ * NAME
+ *   uc_threshold_update
+ *
+ * DESCRIPTION
+ *   Calls "callback" with the current rates and the threshold state of the
+ *   entry of "vl", with the entry locked. Changes the callback makes to
+ *   "state" are stored in the entry. This lets a threshold check read the
+ *   rates and update the state with a single cache access. The callback must
+ *   not call into the cache.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOENT if the entry doesn't exist.
+ */
+int uc_threshold_update(const data_set_t *ds, const value_list_t *vl,
+                        uc_threshold_callback_t callback, void *user_data);
+
 /*
  * Iterator interface
  */
@@ -72,8 +242,12 @@ typedef struct uc_iter_s uc_iter_t;
  *   uc_get_iterator
  *
  * DESCRIPTION
- *   Create an iterator for the cache. It will hold the cache lock until it's
- *   destroyed.
+ *   Create an iterator for the cache. The cache is split into shards; the
+ *   iterator copies the entries of one shard at a time, holding the shard's
+ *   (read) lock only while copying, so that walking the entries doesn't block
+ *   updates. Each entry is a consistent copy of one point in time, except for
+ *   the meta data, which is looked up when asked for. The order of the
+ *   entries is unspecified.
  *
  * RETURN VALUE
  *   An iterator object on success or NULL else.
@@ -90,9 +264,9 @@ uc_iter_t *uc_get_iterator(void);
  *
  * PARAMETERS
  *   `iter'     The iterator object to advance.
- *   `ret_name' Optional pointer to a string where to store the name. If not
- *              NULL, the returned value is a copy of the value and has to be
- *              freed by the caller.
+ *   `ret_name' Optional pointer to a string where to store the name. The
+ *              name belongs to the iterator and is valid until the next call
+ *              of `uc_iterator_next' or `uc_iterator_destroy'.
  *
  * RETURN VALUE
  *   Zero upon success or non-zero if the iterator ie NULL or no further
@@ -139,4 +313,22 @@ int uc_meta_data_get_double(const value_list_t *vl, const char *key,
 int uc_meta_data_get_boolean(const value_list_t *vl, const char *key,
                              bool *value);
 
+typedef int (*uc_meta_data_callback_t)(meta_data_t *meta, void *user_data);
+
+/*
+ * NAME
+ *   uc_meta_data_update
+ *
+ * DESCRIPTION
+ *   Calls "callback" with the meta data of the entry of "vl", with the entry
+ *   locked. This lets a caller read and update several keys with a single
+ *   cache access. The callback must not call into the cache.
+ *
+ * RETURN VALUE
+ *   The return value of the callback, ENOENT if the entry doesn't exist or
+ *   ENOMEM if the meta data couldn't be allocated.
+ */
+int uc_meta_data_update(const value_list_t *vl,
+                        uc_meta_data_callback_t callback, void *user_data);
+
 #endif /* !UTILS_CACHE_H */
@@ -40,10 +40,21 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
   return ENOTSUP;
 }
 
+int uc_get_series_by_name(const char *name, cdtime_t start, cdtime_t end,
+                          cdtime_t **ret_times, gauge_t **ret_values,
+                          size_t *ret_num, size_t *ret_values_num) {
+  return -ENOTSUP;
+}
+
 int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   return ENOTSUP;
 }
 
+int uc_get_names_matching(char const *pattern, char ***ret_names,
+                          cdtime_t **ret_times, size_t *ret_number) {
+  return ENOTSUP;
+}
+
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
   return ENOTSUP;
@@ -0,0 +1,549 @@
+/**
+ * collectd - src/daemon/utils_cache_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* testing.h comes first so that utils_time.h declares cdtime_mock. */
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+static data_source_t dsrc[] = {
+    {"a", DS_TYPE_GAUGE, NAN, NAN},
+    {"b", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t ds = {"test", STATIC_ARRAY_SIZE(dsrc), dsrc};
+
+static int update(value_list_t *vl, gauge_t a, gauge_t b) {
+  value_t values[] = {{.gauge = a}, {.gauge = b}};
+
+  vl->values = values;
+  vl->values_len = STATIC_ARRAY_SIZE(values);
+  vl->time += TIME_T_TO_CDTIME_T(1);
+  return uc_update(&ds, vl);
+}
+
+DEF_TEST(window) {
+  value_list_t vl = VALUE_LIST_INIT;
+  uc_window_t w[2];
+  gauge_t history[4 * 2];
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "plugin", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+
+  CHECK_ZERO(uc_init());
+  CHECK_ZERO(update(&vl, 1.0, 10.0));
+
+  /* The history is created by the first request; it's still empty. */
+  CHECK_ZERO(uc_get_window(&ds, &vl, w, 4, 2));
+  EXPECT_EQ_UINT64(0, w[0].num);
+  OK(isnan(w[0].min));
+  OK(isnan(w[0].average));
+
+  gauge_t a[] = {3.0, 1.0, 4.0, 1.0, 5.0, 9.0, 2.0, 6.0, NAN, 5.0};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(a); i++) {
+    CHECK_ZERO(update(&vl, a[i], -a[i]));
+
+    /* compare to the last four values */
+    gauge_t min = NAN, max = NAN, sum = 0.0;
+    size_t num = 0;
+    for (size_t j = (i >= 3) ? (i - 3) : 0; j <= i; j++) {
+      if (isnan(a[j]))
+        continue;
+      if ((num == 0) || (a[j] < min))
+        min = a[j];
+      if ((num == 0) || (a[j] > max))
+        max = a[j];
+      sum += a[j];
+      num++;
+    }
+
+    CHECK_ZERO(uc_get_window(&ds, &vl, w, 4, 2));
+    EXPECT_EQ_UINT64(num, w[0].num);
+    EXPECT_EQ_DOUBLE(min, w[0].min);
+    EXPECT_EQ_DOUBLE(max, w[0].max);
+    EXPECT_EQ_DOUBLE(sum, w[0].sum);
+    EXPECT_EQ_DOUBLE(sum / (gauge_t)num, w[0].average);
+    EXPECT_EQ_DOUBLE(-max, w[1].min);
+    EXPECT_EQ_DOUBLE(-min, w[1].max);
+  }
+
+  /* Shorter windows are computed from the history. */
+  CHECK_ZERO(uc_get_window(&ds, &vl, w, 2, 2));
+  EXPECT_EQ_UINT64(1, w[0].num);
+  EXPECT_EQ_DOUBLE(5.0, w[0].max);
+
+  /* The history is returned most recent first, interleaved. */
+  CHECK_ZERO(uc_get_history(&ds, &vl, history, 4, 2));
+  EXPECT_EQ_DOUBLE(5.0, history[0]);
+  EXPECT_EQ_DOUBLE(-5.0, history[1]);
+  OK(isnan(history[2]));
+  EXPECT_EQ_DOUBLE(6.0, history[4]);
+  EXPECT_EQ_DOUBLE(-2.0, history[7]);
+
+  /* Growing the history keeps the values and aggregates: {2, 6, NaN, 5}. */
+  CHECK_ZERO(uc_get_window(&ds, &vl, w, 6, 2));
+  EXPECT_EQ_UINT64(3, w[0].num);
+  EXPECT_EQ_DOUBLE(2.0, w[0].min);
+  EXPECT_EQ_DOUBLE(6.0, w[0].max);
+  EXPECT_EQ_DOUBLE(13.0, w[0].sum);
+
+  CHECK_ZERO(update(&vl, 7.0, -7.0));
+  CHECK_ZERO(update(&vl, 1.0, -1.0));
+  CHECK_ZERO(update(&vl, 8.0, -8.0));
+  CHECK_ZERO(uc_get_window(&ds, &vl, w, 6, 2));
+  EXPECT_EQ_UINT64(5, w[0].num);
+  EXPECT_EQ_DOUBLE(1.0, w[0].min);
+  EXPECT_EQ_DOUBLE(8.0, w[0].max);
+  EXPECT_EQ_DOUBLE(27.0, w[0].sum); /* 6 + 5 + 7 + 1 + 8 */
+
+  EXPECT_EQ_INT(-EINVAL, uc_get_window(&ds, &vl, w, 6, 1));
+  sstrncpy(vl.host, "unknown", sizeof(vl.host));
+  EXPECT_EQ_INT(-ENOENT, uc_get_window(&ds, &vl, w, 6, 2));
+
+  return 0;
+}
+
+DEF_TEST(timeout) {
+  value_list_t stale = VALUE_LIST_INIT;
+  value_list_t fresh = VALUE_LIST_INIT;
+  gauge_t *rates;
+
+  sstrncpy(stale.host, "host", sizeof(stale.host));
+  sstrncpy(stale.plugin, "stale", sizeof(stale.plugin));
+  sstrncpy(stale.type, "test", sizeof(stale.type));
+  stale.time = TIME_T_TO_CDTIME_T(1000);
+  stale.interval = TIME_T_TO_CDTIME_T(10);
+
+  fresh = stale;
+  sstrncpy(fresh.plugin, "fresh", sizeof(fresh.plugin));
+  fresh.interval = TIME_T_TO_CDTIME_T(3600);
+
+  CHECK_ZERO(uc_init());
+  CHECK_ZERO(update(&stale, 1.0, 2.0));
+  CHECK_ZERO(update(&fresh, 1.0, 2.0));
+
+  /* "stale" times out after timeout_g intervals. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(30);
+  CHECK_ZERO(uc_check_timeout());
+  OK(uc_get_rate(&ds, &stale) == NULL);
+  CHECK_NOT_NULL(rates = uc_get_rate(&ds, &fresh));
+  EXPECT_EQ_DOUBLE(2.0, rates[1]);
+  sfree(rates);
+
+  /* An entry whose deadline has passed in the heap, but that has been updated
+   * since, is kept. */
+  CHECK_ZERO(update(&stale, 3.0, 4.0));
+  stale.interval = TIME_T_TO_CDTIME_T(3600);
+  cdtime_mock += TIME_T_TO_CDTIME_T(30);
+  CHECK_ZERO(update(&stale, 5.0, 6.0));
+  CHECK_ZERO(uc_check_timeout());
+  CHECK_NOT_NULL(rates = uc_get_rate(&ds, &stale));
+  EXPECT_EQ_DOUBLE(5.0, rates[0]);
+  sfree(rates);
+
+  /* The entry is put back with its new deadline. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(3600);
+  CHECK_ZERO(uc_check_timeout());
+  CHECK_NOT_NULL(rates = uc_get_rate(&ds, &stale));
+  sfree(rates);
+
+  return 0;
+}
+
+DEF_TEST(rate_change) {
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t values[] = {{.gauge = 100.0}, {.gauge = 0.0}};
+  gauge_t change = NAN;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "change", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+
+  CHECK_ZERO(uc_init());
+  EXPECT_EQ_INT(-ENOENT, uc_get_rate_change(&ds, &vl, &change));
+  CHECK_ZERO(update(&vl, 100.0, 0.0));
+
+  vl.values = values;
+  vl.values_len = STATIC_ARRAY_SIZE(values);
+  vl.time += TIME_T_TO_CDTIME_T(1);
+  CHECK_ZERO(uc_get_rate_change(&ds, &vl, &change));
+  EXPECT_EQ_DOUBLE(0.0, change);
+
+  /* The largest relative change of all data sources is returned. */
+  values[0].gauge = 105.0;
+  CHECK_ZERO(uc_get_rate_change(&ds, &vl, &change));
+  EXPECT_EQ_DOUBLE(0.05, change);
+
+  values[0].gauge = 100.0;
+  values[1].gauge = 1.0;
+  CHECK_ZERO(uc_get_rate_change(&ds, &vl, &change));
+  OK(isinf(change));
+
+  /* Values that are not newer than the cached ones are rejected. */
+  vl.time -= TIME_T_TO_CDTIME_T(1);
+  EXPECT_EQ_INT(-EINVAL, uc_get_rate_change(&ds, &vl, &change));
+
+  return 0;
+}
+
+DEF_TEST(last_rates) {
+  value_list_t vl = VALUE_LIST_INIT;
+  gauge_t *rates;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "last_rates", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+
+  CHECK_ZERO(uc_init());
+  CHECK_ZERO(update(&vl, 1.0, 2.0));
+
+  /* The rates stay with the value list while it's being dispatched, even if
+   * a target renames it. */
+  sstrncpy(vl.host, "renamed", sizeof(vl.host));
+  CHECK_NOT_NULL(rates = uc_get_rate(&ds, &vl));
+  EXPECT_EQ_DOUBLE(1.0, rates[0]);
+  EXPECT_EQ_DOUBLE(2.0, rates[1]);
+  sfree(rates);
+
+  /* Afterwards, they're looked up by name. */
+  uc_clear_rates();
+  OK(uc_get_rate(&ds, &vl) == NULL);
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  CHECK_NOT_NULL(rates = uc_get_rate(&ds, &vl));
+  EXPECT_EQ_DOUBLE(2.0, rates[1]);
+  sfree(rates);
+
+  return 0;
+}
+
+DEF_TEST(names_matching) {
+  char const *plugins[] = {"cpu", "cpufreq", "load"};
+  char **names = NULL;
+  cdtime_t *times = NULL;
+  size_t names_num = 0;
+
+  CHECK_ZERO(uc_init());
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(plugins); i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    sstrncpy(vl.host, "host", sizeof(vl.host));
+    sstrncpy(vl.plugin, plugins[i], sizeof(vl.plugin));
+    sstrncpy(vl.type, "test", sizeof(vl.type));
+    vl.time = TIME_T_TO_CDTIME_T(1000);
+    vl.interval = TIME_T_TO_CDTIME_T(10);
+    CHECK_ZERO(update(&vl, 1.0, 2.0));
+  }
+
+  CHECK_ZERO(uc_get_names_matching("host/cpu*", &names, &times, &names_num));
+  EXPECT_EQ_UINT64(2, names_num);
+  EXPECT_EQ_STR("host/cpu/test", names[0]);
+  EXPECT_EQ_STR("host/cpufreq/test", names[1]);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(1001), times[0]);
+  for (size_t i = 0; i < names_num; i++)
+    sfree(names[i]);
+  sfree(names);
+  sfree(times);
+
+  CHECK_ZERO(uc_get_names_matching("*/load/*", &names, NULL, &names_num));
+  EXPECT_EQ_UINT64(1, names_num);
+  EXPECT_EQ_STR("host/load/test", names[0]);
+  sfree(names[0]);
+  sfree(names);
+
+  CHECK_ZERO(uc_get_names_matching("other/*", &names, NULL, &names_num));
+  EXPECT_EQ_UINT64(0, names_num);
+
+  return 0;
+}
+
+DEF_TEST(iterator) {
+  char const *plugins[] = {"iter0", "iter1", "iter2"};
+
+  CHECK_ZERO(uc_init());
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(plugins); i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    sstrncpy(vl.host, "host", sizeof(vl.host));
+    sstrncpy(vl.plugin, plugins[i], sizeof(vl.plugin));
+    sstrncpy(vl.type, "test", sizeof(vl.type));
+    vl.time = TIME_T_TO_CDTIME_T(1000);
+    vl.interval = TIME_T_TO_CDTIME_T(10);
+    CHECK_ZERO(update(&vl, (gauge_t)i, 2.0));
+  }
+
+  uc_iter_t *iter;
+  CHECK_NOT_NULL(iter = uc_get_iterator());
+
+  int seen = 0;
+  char *name = NULL;
+  while (uc_iterator_next(iter, &name) == 0) {
+    if (strncmp(name, "host/iter", strlen("host/iter")) != 0)
+      continue;
+
+    value_list_t vl = VALUE_LIST_INIT;
+    CHECK_ZERO(parse_identifier_vl(name, &vl));
+    int i = vl.plugin[strlen(vl.plugin) - 1] - '0';
+    seen |= 1 << i;
+
+    /* The iterator holds no lock, so the cache can be updated meanwhile.
+     * The iterator still returns the values it has copied. */
+    vl.time = TIME_T_TO_CDTIME_T(1001);
+    vl.interval = TIME_T_TO_CDTIME_T(10);
+    CHECK_ZERO(update(&vl, 42.0, 43.0));
+
+    value_t *values = NULL;
+    size_t values_num = 0;
+    cdtime_t t = 0;
+    CHECK_ZERO(uc_iterator_get_values(iter, &values, &values_num));
+    EXPECT_EQ_UINT64(2, values_num);
+    EXPECT_EQ_DOUBLE((gauge_t)i, values[0].gauge);
+    EXPECT_EQ_DOUBLE(2.0, values[1].gauge);
+    sfree(values);
+    CHECK_ZERO(uc_iterator_get_time(iter, &t));
+    EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(1001), t);
+  }
+  uc_iterator_destroy(iter);
+  EXPECT_EQ_INT(7, seen);
+
+  return 0;
+}
+
+DEF_TEST(snapshot) {
+  char file[] = "/tmp/utils_cache_test.XXXXXX";
+  int fd = mkstemp(file);
+  CHECK_NOT_NULL(fd >= 0 ? file : NULL);
+  close(fd);
+
+  /* The types are resolved through plugin_get_ds(), which knows "MAGIC". */
+  data_source_t magic_ds = {"value", DS_TYPE_DERIVE, 0.0, NAN};
+  data_set_t magic = {"MAGIC", 1, &magic_ds};
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t value = {.derive = 100};
+  gauge_t *rates;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "snapshot", sizeof(vl.plugin));
+  sstrncpy(vl.type, "MAGIC", sizeof(vl.type));
+  vl.values = &value;
+  vl.values_len = 1;
+  vl.time = TIME_T_TO_CDTIME_T(5000);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+
+  CHECK_ZERO(uc_init());
+  CHECK_ZERO(uc_update(&magic, &vl));
+  /* Like the end of the dispatch, so that rates are looked up by name. */
+  uc_clear_rates();
+  CHECK_ZERO(uc_save(file));
+
+  /* Let the entry time out, as if the daemon had been restarted. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(30);
+  CHECK_ZERO(uc_check_timeout());
+  OK(uc_get_rate(&magic, &vl) == NULL);
+
+  /* The first value after loading the snapshot has a rate, no matter how long
+   * the daemon was down. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(3600);
+  CHECK_ZERO(uc_load(file));
+  value.derive = 200;
+  vl.time += TIME_T_TO_CDTIME_T(10);
+  CHECK_ZERO(uc_update(&magic, &vl));
+  uc_clear_rates();
+  CHECK_NOT_NULL(rates = uc_get_rate(&magic, &vl));
+  EXPECT_EQ_DOUBLE(10.0, rates[0]);
+  sfree(rates);
+
+  /* Entries that are already in the cache are newer than the snapshot. */
+  CHECK_ZERO(uc_load(file));
+  CHECK_NOT_NULL(rates = uc_get_rate(&magic, &vl));
+  EXPECT_EQ_DOUBLE(10.0, rates[0]);
+  sfree(rates);
+
+  /* Entries that had timed out when the snapshot was written are skipped. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(30);
+  CHECK_ZERO(uc_save(file));
+  CHECK_ZERO(uc_check_timeout());
+  OK(uc_get_rate(&magic, &vl) == NULL);
+  CHECK_ZERO(uc_load(file));
+  OK(uc_get_rate(&magic, &vl) == NULL);
+
+  /* A truncated snapshot is an error, a missing one is not. */
+  struct stat statbuf;
+  CHECK_ZERO(stat(file, &statbuf));
+  CHECK_ZERO(truncate(file, statbuf.st_size - 8));
+  EXPECT_EQ_INT(EINVAL, uc_load(file));
+  unlink(file);
+  EXPECT_EQ_INT(0, uc_load(file));
+
+  return 0;
+}
+
+static int count_updates(meta_data_t *meta, void *user_data) {
+  int64_t count = 0;
+  meta_data_get_signed_int(meta, "count", &count);
+  count++;
+  *(int64_t *)user_data = count;
+  return meta_data_add_signed_int(meta, "count", count);
+}
+
+DEF_TEST(meta_data_update) {
+  value_list_t vl = VALUE_LIST_INIT;
+  int64_t count = 0;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "meta", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+
+  CHECK_ZERO(uc_init());
+  EXPECT_EQ_INT(ENOENT, uc_meta_data_update(&vl, count_updates, &count));
+
+  CHECK_ZERO(update(&vl, 1.0, 2.0));
+  CHECK_ZERO(uc_meta_data_update(&vl, count_updates, &count));
+  CHECK_ZERO(uc_meta_data_update(&vl, count_updates, &count));
+  EXPECT_EQ_INT(2, (int)count);
+
+  /* The keys are the same as those of the other meta data functions. */
+  CHECK_ZERO(uc_meta_data_get_signed_int(&vl, "count", &count));
+  EXPECT_EQ_INT(2, (int)count);
+
+  return 0;
+}
+
+DEF_TEST(series) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "series", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(1);
+
+  CHECK_ZERO(uc_init());
+  uc_set_series_span(TIME_T_TO_CDTIME_T(60));
+  for (int i = 0; i < 100; i++)
+    CHECK_ZERO(update(&vl, (gauge_t)i, -1.0));
+  uc_clear_rates();
+  uc_set_series_span(0);
+
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  size_t values_num = 0;
+  EXPECT_EQ_INT(-ENOENT,
+                uc_get_series_by_name("host/series/unknown", 0, UINT64_MAX,
+                                      &times, &values, &num, &values_num));
+
+  /* The last ten seconds: 1091 to 1100. */
+  CHECK_ZERO(uc_get_series_by_name(
+      "host/series/test", TIME_T_TO_CDTIME_T(1091), TIME_T_TO_CDTIME_T(1100),
+      &times, &values, &num, &values_num));
+  EXPECT_EQ_UINT64(10, num);
+  EXPECT_EQ_UINT64(2, values_num);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(1091), times[0]);
+  EXPECT_EQ_DOUBLE(90.0, values[0]);
+  EXPECT_EQ_DOUBLE(-1.0, values[1]);
+  EXPECT_EQ_DOUBLE(99.0, values[2 * 9]);
+  free(times);
+  free(values);
+
+  /* Older values have been dropped. */
+  CHECK_ZERO(uc_get_series_by_name("host/series/test", 0, UINT64_MAX, &times,
+                                   &values, &num, &values_num));
+  OK(num >= 60);
+  OK(num < 100);
+  free(times);
+  free(values);
+
+  return 0;
+}
+
+DEF_TEST(late) {
+  value_list_t vl = VALUE_LIST_INIT;
+  uint64_t late = 0;
+  uint64_t too_old = 0;
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "late", sizeof(vl.plugin));
+  sstrncpy(vl.type, "test", sizeof(vl.type));
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  vl.interval = TIME_T_TO_CDTIME_T(1);
+
+  CHECK_ZERO(uc_init());
+  uc_set_reorder_window(TIME_T_TO_CDTIME_T(5));
+  CHECK_ZERO(update(&vl, 1.0, 2.0)); /* 1001 */
+  CHECK_ZERO(update(&vl, 3.0, 4.0)); /* 1002 */
+
+  /* Within the window: late, and the writers may get its gauges. */
+  vl.time = TIME_T_TO_CDTIME_T(997);
+  EXPECT_EQ_INT(UC_UPDATE_LATE, update(&vl, 5.0, 6.0)); /* 998 */
+  gauge_t *rates = uc_get_rate(&ds, &vl);
+  OK(rates != NULL);
+  EXPECT_EQ_DOUBLE(5.0, rates[0]);
+  free(rates);
+  uc_clear_rates();
+
+  /* Outside of the window, or the same time: too old. */
+  vl.time = TIME_T_TO_CDTIME_T(995);
+  EXPECT_EQ_INT(UC_UPDATE_TOO_OLD, update(&vl, 7.0, 8.0)); /* 996 */
+  vl.time = TIME_T_TO_CDTIME_T(1001);
+  EXPECT_EQ_INT(UC_UPDATE_TOO_OLD, update(&vl, 7.0, 8.0)); /* 1002 */
+
+  uc_get_late_stats(&late, &too_old);
+  EXPECT_EQ_UINT64(1, late);
+  EXPECT_EQ_UINT64(2, too_old);
+
+  /* The cache keeps the newest values. */
+  gauge_t *values = uc_get_rate(&ds, &vl);
+  OK(values != NULL);
+  EXPECT_EQ_DOUBLE(3.0, values[0]);
+  EXPECT_EQ_DOUBLE(4.0, values[1]);
+  free(values);
+
+  uc_set_reorder_window(0);
+  vl.time = TIME_T_TO_CDTIME_T(1000);
+  EXPECT_EQ_INT(UC_UPDATE_TOO_OLD, update(&vl, 7.0, 8.0)); /* 1001 */
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(window);
+  RUN_TEST(timeout);
+  RUN_TEST(rate_change);
+  RUN_TEST(last_rates);
+  RUN_TEST(names_matching);
+  RUN_TEST(iterator);
+  RUN_TEST(snapshot);
+  RUN_TEST(meta_data_update);
+  RUN_TEST(series);
+  RUN_TEST(late);
+
+  END_TEST;
+}
@@ -0,0 +1,89 @@
+/**
+ * collectd - src/daemon/utils_counter.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils_counter.h"
+
+#include <pthread.h>
+
+/* The shard of a thread is assigned on its first increment, round robin. The
+ * key holds the shard's index plus one. */
+static pthread_key_t shard_key;
+static pthread_once_t shard_once = PTHREAD_ONCE_INIT;
+static bool shard_key_created;
+static uint64_t shard_next;
+
+static void shard_key_create(void) /* {{{ */
+{
+  shard_key_created = (pthread_key_create(&shard_key, NULL) == 0);
+} /* }}} void shard_key_create */
+
+size_t shard_counter_index(void) /* {{{ */
+{
+  pthread_once(&shard_once, shard_key_create);
+  if (!shard_key_created)
+    return 0;
+
+  uintptr_t index = (uintptr_t)pthread_getspecific(shard_key);
+  if (index != 0)
+    return (size_t)(index - 1);
+
+  index = (uintptr_t)(__atomic_fetch_add(&shard_next, 1, __ATOMIC_RELAXED) %
+                      SHARD_COUNTER_SHARDS);
+  pthread_setspecific(shard_key, (void *)(index + 1));
+  return (size_t)index;
+} /* }}} size_t shard_counter_index */
+
+void shard_counter_add(shard_counter_t *c, uint64_t n) /* {{{ */
+{
+  if ((c == NULL) || (n == 0))
+    return;
+
+  /* Threads may share a shard, hence the atomic add. Without another writer
+   * the cache line stays with the calling CPU. */
+  __atomic_fetch_add(&c->shards[shard_counter_index()].value, n,
+                     __ATOMIC_RELAXED);
+} /* }}} void shard_counter_add */
+
+void shard_counter_sub(shard_counter_t *c, uint64_t n) /* {{{ */
+{
+  if ((c == NULL) || (n == 0))
+    return;
+
+  __atomic_fetch_sub(&c->shards[shard_counter_index()].value, n,
+                     __ATOMIC_RELAXED);
+} /* }}} void shard_counter_sub */
+
+uint64_t shard_counter_get(shard_counter_t const *c) /* {{{ */
+{
+  uint64_t sum = 0;
+
+  if (c == NULL)
+    return 0;
+
+  for (size_t i = 0; i < SHARD_COUNTER_SHARDS; i++)
+    sum += __atomic_load_n(&c->shards[i].value, __ATOMIC_RELAXED);
+
+  return sum;
+} /* }}} uint64_t shard_counter_get */
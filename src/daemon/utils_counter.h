@@ -0,0 +1,67 @@
+/**
+ * collectd - src/daemon/utils_counter.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_COUNTER_H
+#define UTILS_COUNTER_H 1
+
+#include "collectd.h"
+
+/* Number of shards per counter. Threads beyond this share shards, which is
+ * still correct, only slower. */
+#define SHARD_COUNTER_SHARDS 16
+#define SHARD_COUNTER_LINE 64
+
+/* A counter incremented by many threads, e.g. for `CollectInternalStats'.
+ * Every thread adds to its own shard, which lives on a cache line of its own,
+ * so increments neither take a lock nor move the cache line between CPUs.
+ * Reading the counter sums up all shards and may miss increments happening
+ * at the same time. Counters are cumulative and can be statically
+ * initialized with SHARD_COUNTER_INIT. */
+typedef struct {
+  struct {
+    uint64_t value;
+  } __attribute__((aligned(SHARD_COUNTER_LINE))) shards[SHARD_COUNTER_SHARDS];
+} shard_counter_t;
+
+#define SHARD_COUNTER_INIT                                                     \
+  {                                                                            \
+    .shards = {                                                                \
+      { 0 }                                                                    \
+    }                                                                          \
+  }
+
+/* Adds `n' to the calling thread's shard of `c'. */
+void shard_counter_add(shard_counter_t *c, uint64_t n);
+
+/* Subtracts `n' from the calling thread's shard of `c'. The sum stays
+ * correct as long as it doesn't drop below zero: shards wrap around. */
+void shard_counter_sub(shard_counter_t *c, uint64_t n);
+
+/* Returns the sum of all shards of `c'. */
+uint64_t shard_counter_get(shard_counter_t const *c);
+
+/* Returns the index of the calling thread's shard, less than
+ * SHARD_COUNTER_SHARDS. For other per-thread sharded structures. */
+size_t shard_counter_index(void);
+
+#endif /* !UTILS_COUNTER_H */
@@ -0,0 +1,82 @@
+/**
+ * collectd - src/daemon/utils_counter_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils_counter.h"
+
+#include <pthread.h>
+
+#define THREADS_NUM (2 * SHARD_COUNTER_SHARDS + 3)
+#define INCREMENTS 10000
+
+static shard_counter_t counter = SHARD_COUNTER_INIT;
+
+static void *add_thread(void *arg) {
+  for (int i = 0; i < INCREMENTS; i++)
+    shard_counter_add(&counter, 1);
+  shard_counter_add(&counter, (uint64_t)(uintptr_t)arg);
+  return NULL;
+}
+
+DEF_TEST(single_thread) {
+  shard_counter_t c = SHARD_COUNTER_INIT;
+
+  EXPECT_EQ_UINT64(0, shard_counter_get(&c));
+  shard_counter_add(&c, 1);
+  shard_counter_add(&c, 41);
+  shard_counter_add(&c, 0);
+  EXPECT_EQ_UINT64(42, shard_counter_get(&c));
+  shard_counter_sub(&c, 40);
+  EXPECT_EQ_UINT64(2, shard_counter_get(&c));
+
+  /* Every shard is on a cache line of its own. */
+  EXPECT_EQ_UINT64(SHARD_COUNTER_SHARDS * SHARD_COUNTER_LINE, sizeof(c));
+
+  return 0;
+}
+
+DEF_TEST(many_threads) {
+  pthread_t threads[THREADS_NUM];
+  uint64_t want = 0;
+
+  /* More threads than shards, so that some share one. */
+  for (size_t i = 0; i < THREADS_NUM; i++) {
+    CHECK_ZERO(
+        pthread_create(threads + i, NULL, add_thread, (void *)(uintptr_t)i));
+    want += INCREMENTS + i;
+  }
+  for (size_t i = 0; i < THREADS_NUM; i++)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ_UINT64(want, shard_counter_get(&counter));
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(single_thread);
+  RUN_TEST(many_threads);
+
+  END_TEST;
+}
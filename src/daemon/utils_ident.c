@@ -0,0 +1,255 @@
+/**
+ * collectd - src/daemon/utils_ident.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils_ident.h"
+
+#include <assert.h>
+
+#define IDENT_MIN_BUCKETS 256
+
+/* The intern table holds one reference to each identifier. Lookups and the
+ * garbage collection hold `ident_lock'; references held elsewhere are only
+ * counted under the identifier's own lock. Since a handle with a single
+ * reference is only known to the table, it can not be ref'ed concurrently
+ * while `ident_lock' is held. */
+static pthread_mutex_t ident_lock = PTHREAD_MUTEX_INITIALIZER;
+static value_ident_t **ident_buckets;
+static size_t ident_buckets_num;
+static size_t ident_num;
+
+/* FNV-1a */
+uint64_t ident_hash(char const *name) /* {{{ */
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (char const *c = name; *c != 0; c++) {
+    hash ^= (uint8_t)*c;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* }}} uint64_t ident_hash */
+
+/* Must hold `ident_lock'. */
+static int ident_resize(size_t buckets_num) /* {{{ */
+{
+  value_ident_t **buckets = calloc(buckets_num, sizeof(*buckets));
+  if (buckets == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < ident_buckets_num; i++) {
+    value_ident_t *next;
+    for (value_ident_t *id = ident_buckets[i]; id != NULL; id = next) {
+      next = id->next;
+      size_t idx = (size_t)(id->hash % buckets_num);
+      id->next = buckets[idx];
+      buckets[idx] = id;
+    }
+  }
+
+  sfree(ident_buckets);
+  ident_buckets = buckets;
+  ident_buckets_num = buckets_num;
+  return 0;
+} /* }}} int ident_resize */
+
+static void ident_free(value_ident_t *id) /* {{{ */
+{
+  if (id == NULL)
+    return;
+
+  pthread_mutex_destroy(&id->lock);
+  sfree(id->name);
+  sfree(id);
+} /* }}} void ident_free */
+
+value_ident_t *ident_get(value_list_t const *vl) /* {{{ */
+{
+  char host[DATA_MAX_NAME_LEN];
+  char plugin[DATA_MAX_NAME_LEN];
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
+  char name[6 * DATA_MAX_NAME_LEN];
+
+  if (vl == NULL)
+    return NULL;
+
+  sstrncpy(host, (vl->host[0] != 0) ? vl->host : hostname_g, sizeof(host));
+  sstrncpy(plugin, vl->plugin, sizeof(plugin));
+  sstrncpy(plugin_instance, vl->plugin_instance, sizeof(plugin_instance));
+  sstrncpy(type, vl->type, sizeof(type));
+  sstrncpy(type_instance, vl->type_instance, sizeof(type_instance));
+
+  /* Escape the same way plugin_dispatch_values does, so that the name matches
+   * what the cache and the write plugins see. */
+  escape_slashes(host, sizeof(host));
+  escape_slashes(plugin, sizeof(plugin));
+  escape_slashes(plugin_instance, sizeof(plugin_instance));
+  escape_slashes(type, sizeof(type));
+  escape_slashes(type_instance, sizeof(type_instance));
+
+  if (format_name(name, sizeof(name), host, plugin, plugin_instance, type,
+                  type_instance) != 0) {
+    ERROR("ident_get: format_name failed.");
+    return NULL;
+  }
+
+  uint64_t hash = ident_hash(name);
+
+  pthread_mutex_lock(&ident_lock);
+
+  if (ident_buckets == NULL) {
+    if (ident_resize(IDENT_MIN_BUCKETS) != 0) {
+      pthread_mutex_unlock(&ident_lock);
+      ERROR("ident_get: calloc failed.");
+      return NULL;
+    }
+  }
+
+  size_t idx = (size_t)(hash % ident_buckets_num);
+  for (value_ident_t *id = ident_buckets[idx]; id != NULL; id = id->next) {
+    if ((id->hash != hash) || (strcmp(id->name, name) != 0))
+      continue;
+
+    ident_ref(id);
+    pthread_mutex_unlock(&ident_lock);
+    return id;
+  }
+
+  value_ident_t *id = calloc(1, sizeof(*id));
+  if (id == NULL) {
+    pthread_mutex_unlock(&ident_lock);
+    ERROR("ident_get: calloc failed.");
+    return NULL;
+  }
+  id->name = strdup(name);
+  if (id->name == NULL) {
+    pthread_mutex_unlock(&ident_lock);
+    ERROR("ident_get: strdup failed.");
+    sfree(id);
+    return NULL;
+  }
+  id->hash = hash;
+  pthread_mutex_init(&id->lock, /* attr = */ NULL);
+  /* One reference for the table, one for the caller. */
+  id->refs = 2;
+
+  id->next = ident_buckets[idx];
+  ident_buckets[idx] = id;
+  ident_num++;
+
+  /* A failed resize only makes the chains longer. */
+  if (ident_num > ident_buckets_num)
+    ident_resize(2 * ident_buckets_num);
+
+  pthread_mutex_unlock(&ident_lock);
+  return id;
+} /* }}} value_ident_t *ident_get */
+
+value_ident_t *ident_ref(value_ident_t *id) /* {{{ */
+{
+  if (id == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&id->lock);
+  id->refs++;
+  pthread_mutex_unlock(&id->lock);
+
+  return id;
+} /* }}} value_ident_t *ident_ref */
+
+void ident_unref(value_ident_t *id) /* {{{ */
+{
+  if (id == NULL)
+    return;
+
+  /* The last reference belongs to the table and is dropped in ident_gc. */
+  pthread_mutex_lock(&id->lock);
+  assert(id->refs > 1);
+  id->refs--;
+  pthread_mutex_unlock(&id->lock);
+} /* }}} void ident_unref */
+
+void ident_reset(value_list_t *vl) /* {{{ */
+{
+  if (vl == NULL)
+    return;
+
+  ident_unref(vl->ident);
+  vl->ident = NULL;
+} /* }}} void ident_reset */
+
+size_t ident_gc(void) /* {{{ */
+{
+  size_t num = 0;
+
+  pthread_mutex_lock(&ident_lock);
+
+  for (size_t i = 0; i < ident_buckets_num; i++) {
+    value_ident_t **prev = ident_buckets + i;
+
+    while (*prev != NULL) {
+      value_ident_t *id = *prev;
+
+      pthread_mutex_lock(&id->lock);
+      bool unused = (id->refs == 1);
+      pthread_mutex_unlock(&id->lock);
+
+      if (!unused) {
+        prev = &id->next;
+        continue;
+      }
+
+      *prev = id->next;
+      ident_free(id);
+      num++;
+    }
+  }
+  ident_num -= num;
+
+  if ((ident_num < ident_buckets_num / 4) &&
+      (ident_buckets_num > IDENT_MIN_BUCKETS))
+    ident_resize(ident_buckets_num / 2);
+
+  pthread_mutex_unlock(&ident_lock);
+
+  if (num > 0) {
+    DEBUG("ident_gc: Freed %" PRIsz " unused identifiers.", num);
+  }
+
+  return num;
+} /* }}} size_t ident_gc */
+
+size_t ident_count(void) /* {{{ */
+{
+  pthread_mutex_lock(&ident_lock);
+  size_t num = ident_num;
+  pthread_mutex_unlock(&ident_lock);
+
+  return num;
+} /* }}} size_t ident_count */
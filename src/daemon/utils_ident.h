@@ -0,0 +1,74 @@
+/**
+ * collectd - src/daemon/utils_ident.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_IDENT_H
+#define UTILS_IDENT_H 1
+
+#include "plugin.h"
+
+/*
+ * NAME
+ *   ident_get
+ *
+ * DESCRIPTION
+ *   Returns the interned identifier of `vl', creating it if necessary. The
+ *   identifier is built the same way the daemon builds it when dispatching:
+ *   an empty host is replaced by the global hostname and slashes are escaped.
+ *   The returned handle holds a reference that must be released with
+ *   `ident_unref'.
+ *
+ *   A plugin can attach the handle to its value list once per series:
+ *
+ *     vl.ident = ident_get (&vl);
+ *     ...
+ *     plugin_dispatch_values (&vl);
+ *     ...
+ *     ident_unref (vl.ident);
+ *
+ * RETURN VALUE
+ *   The identifier handle or NULL on error.
+ */
+value_ident_t *ident_get(value_list_t const *vl);
+
+/* Acquires another reference to `id' and returns it. */
+value_ident_t *ident_ref(value_ident_t *id);
+
+/* Releases a reference acquired with `ident_get' or `ident_ref'. */
+void ident_unref(value_ident_t *id);
+
+/* Releases and clears `vl->ident'. Must be called whenever the identifier
+ * fields of a value list with an attached handle are modified. */
+void ident_reset(value_list_t *vl);
+
+/* Frees all identifiers that are no longer referenced by anyone but the
+ * intern table. Returns the number of freed identifiers. */
+size_t ident_gc(void);
+
+/* Returns the number of interned identifiers. */
+size_t ident_count(void);
+
+/* Hashes a formatted identifier. This is the hash stored in
+ * `value_ident_t.hash' and used by the value cache. */
+uint64_t ident_hash(char const *name);
+
+#endif /* !UTILS_IDENT_H */
@@ -0,0 +1,114 @@
+/**
+ * collectd - src/daemon/utils_ident_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+#include "utils/common/common.h"
+
+#include "testing.h"
+#include "utils_ident.h"
+
+DEF_TEST(ident_get) {
+  struct {
+    char const *host;
+    char const *plugin;
+    char const *plugin_instance;
+    char const *type;
+    char const *type_instance;
+    char const *want;
+  } cases[] = {
+      {"host", "plugin", "", "type", "", "host/plugin/type"},
+      {"host", "plugin", "pi", "type", "ti", "host/plugin-pi/type-ti"},
+      /* empty host is replaced by hostname_g */
+      {"", "plugin", "", "type", "", "example.com/plugin/type"},
+      /* slashes are escaped */
+      {"host", "df", "/var/log", "df_complex", "used",
+       "host/df-var_log/df_complex-used"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    char buffer[6 * DATA_MAX_NAME_LEN];
+
+    sstrncpy(vl.host, cases[i].host, sizeof(vl.host));
+    sstrncpy(vl.plugin, cases[i].plugin, sizeof(vl.plugin));
+    sstrncpy(vl.plugin_instance, cases[i].plugin_instance,
+             sizeof(vl.plugin_instance));
+    sstrncpy(vl.type, cases[i].type, sizeof(vl.type));
+    sstrncpy(vl.type_instance, cases[i].type_instance,
+             sizeof(vl.type_instance));
+
+    value_ident_t *id;
+    CHECK_NOT_NULL(id = ident_get(&vl));
+    EXPECT_EQ_STR(cases[i].want, id->name);
+    EXPECT_EQ_UINT64(ident_hash(cases[i].want), id->hash);
+
+    /* The same identifier is interned only once. */
+    EXPECT_EQ_PTR(id, ident_get(&vl));
+    ident_unref(id);
+
+    vl.ident = id;
+    EXPECT_EQ_INT(0, FORMAT_VL(buffer, sizeof(buffer), &vl));
+    EXPECT_EQ_STR(cases[i].want, buffer);
+    /* Too small buffers are reported, not truncated. */
+    EXPECT_EQ_INT(ENOBUFS, FORMAT_VL(buffer, strlen(cases[i].want), &vl));
+
+    ident_reset(&vl);
+    EXPECT_EQ_PTR(NULL, vl.ident);
+  }
+
+  return 0;
+}
+
+DEF_TEST(ident_gc) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  ident_gc();
+  EXPECT_EQ_INT(0, (int)ident_count());
+
+  sstrncpy(vl.host, "host", sizeof(vl.host));
+  sstrncpy(vl.plugin, "plugin", sizeof(vl.plugin));
+  sstrncpy(vl.type, "type", sizeof(vl.type));
+
+  value_ident_t *id;
+  CHECK_NOT_NULL(id = ident_get(&vl));
+  EXPECT_EQ_PTR(id, ident_ref(id));
+  EXPECT_EQ_INT(1, (int)ident_count());
+
+  /* Referenced identifiers are kept. */
+  EXPECT_EQ_INT(0, (int)ident_gc());
+  ident_unref(id);
+  EXPECT_EQ_INT(0, (int)ident_gc());
+  ident_unref(id);
+
+  EXPECT_EQ_INT(1, (int)ident_gc());
+  EXPECT_EQ_INT(0, (int)ident_count());
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(ident_get);
+  RUN_TEST(ident_gc);
+
+  END_TEST;
+}
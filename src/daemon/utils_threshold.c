@@ -26,7 +26,7 @@
 
 #include "collectd.h"
 
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils_threshold.h"
 
@@ -35,8 +35,10 @@
 /*
  * Exported symbols
  * {{{ */
-c_avl_tree_t *threshold_tree = NULL;
+c_btree_t *threshold_tree = NULL;
 pthread_mutex_t threshold_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Starts at one so that zero never matches the current generation. */
+uint64_t threshold_generation = 1;
 /* }}} */
 
 /*
@@ -57,7 +59,7 @@ threshold_t *threshold_get(const char *hostname, const char *plugin,
               (type == NULL) ? "" : type, type_instance);
   name[sizeof(name) - 1] = '\0';
 
-  if (c_avl_get(threshold_tree, name, (void *)&th) == 0)
+  if (c_btree_get(threshold_tree, name, (void *)&th) == 0)
     return th;
   else
     return NULL;
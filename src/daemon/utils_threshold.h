@@ -49,8 +49,11 @@ typedef struct threshold_s {
   struct threshold_s *next;
 } threshold_t;
 
-extern c_avl_tree_t *threshold_tree;
+extern c_btree_t *threshold_tree;
 extern pthread_mutex_t threshold_lock;
+/* Incremented whenever "threshold_tree" changes, so that thresholds resolved
+ * for a value list can be cached. Protected by "threshold_lock". */
+extern uint64_t threshold_generation;
 
 threshold_t *threshold_get(const char *hostname, const char *plugin,
                            const char *plugin_instance, const char *type,
@@ -34,13 +34,8 @@
 #define DEFAULT_MOCK_TIME 1542455354518929408ULL
 #endif
 
-#ifdef MOCK_TIME
-cdtime_t cdtime_mock = (cdtime_t)MOCK_TIME;
-
-cdtime_t cdtime(void) { return cdtime_mock; }
-#else /* !MOCK_TIME */
 #if HAVE_CLOCK_GETTIME
-cdtime_t cdtime(void) /* {{{ */
+cdtime_t cdtime_precise(void) /* {{{ */
 {
   int status;
   struct timespec ts = {0, 0};
@@ -52,10 +47,10 @@ cdtime_t cdtime(void) /* {{{ */
   }
 
   return TIMESPEC_TO_CDTIME_T(&ts);
-} /* }}} cdtime_t cdtime */
+} /* }}} cdtime_t cdtime_precise */
 #else /* !HAVE_CLOCK_GETTIME */
 /* Work around for Mac OS X which doesn't have clock_gettime(2). *sigh* */
-cdtime_t cdtime(void) /* {{{ */
+cdtime_t cdtime_precise(void) /* {{{ */
 {
   int status;
   struct timeval tv = {0, 0};
@@ -67,8 +62,61 @@ cdtime_t cdtime(void) /* {{{ */
   }
 
   return TIMEVAL_TO_CDTIME_T(&tv);
-} /* }}} cdtime_t cdtime */
+} /* }}} cdtime_t cdtime_precise */
 #endif
+
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_REALTIME_COARSE)
+cdtime_t cdtime_coarse(void) /* {{{ */
+{
+  struct timespec ts = {0, 0};
+
+  /* Served from the vDSO without reading the hardware clock. */
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) != 0)
+    return cdtime_precise();
+
+  return TIMESPEC_TO_CDTIME_T(&ts);
+} /* }}} cdtime_t cdtime_coarse */
+
+cdtime_t cdtime_coarse_resolution(void) /* {{{ */
+{
+  struct timespec ts = {0, 0};
+
+  if (clock_getres(CLOCK_REALTIME_COARSE, &ts) != 0)
+    return 0;
+
+  return TIMESPEC_TO_CDTIME_T(&ts);
+} /* }}} cdtime_t cdtime_coarse_resolution */
+#else
+cdtime_t cdtime_coarse(void) { return cdtime_precise(); }
+
+cdtime_t cdtime_coarse_resolution(void) { return 0; }
+#endif
+
+#ifdef MOCK_TIME
+cdtime_t cdtime_mock = (cdtime_t)MOCK_TIME;
+
+cdtime_t cdtime(void) { return cdtime_mock; }
+
+int cdtime_set_coarse(bool coarse) { return coarse ? ENOTSUP : 0; }
+#else /* !MOCK_TIME */
+/* Set once while the configuration is read, before any threads start. */
+static bool cdtime_use_coarse;
+
+cdtime_t cdtime(void) /* {{{ */
+{
+  if (cdtime_use_coarse)
+    return cdtime_coarse();
+  return cdtime_precise();
+} /* }}} cdtime_t cdtime */
+
+int cdtime_set_coarse(bool coarse) /* {{{ */
+{
+  if (coarse && (cdtime_coarse_resolution() == 0))
+    return ENOTSUP;
+
+  cdtime_use_coarse = coarse;
+  return 0;
+} /* }}} int cdtime_set_coarse */
 #endif
 
 /**********************************************************************
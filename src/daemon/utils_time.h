@@ -108,8 +108,26 @@ extern cdtime_t cdtime_mock;
 #define TIMESPEC_TO_CDTIME_T(ts)                                               \
   NS_TO_CDTIME_T(1000000000ULL * (ts)->tv_sec + (ts)->tv_nsec)
 
+/* Returns the current time, read from the clock selected with
+ * cdtime_set_coarse(). */
 cdtime_t cdtime(void);
 
+/* Read the real time clock, bypassing the clock selection and MOCK_TIME.
+ * cdtime_precise() uses CLOCK_REALTIME. cdtime_coarse() uses
+ * CLOCK_REALTIME_COARSE where available, which is considerably cheaper to read
+ * but only advances with the kernel's timer tick, see
+ * cdtime_coarse_resolution(). Without it, it is the same as cdtime_precise(). */
+cdtime_t cdtime_precise(void);
+cdtime_t cdtime_coarse(void);
+
+/* Returns the resolution of cdtime_coarse(), or zero if there is no coarse
+ * clock. */
+cdtime_t cdtime_coarse_resolution(void);
+
+/* Makes cdtime() read the coarse clock. Returns ENOTSUP if there is none. Must
+ * be called before other threads are started. */
+int cdtime_set_coarse(bool coarse);
+
 #define RFC3339_SIZE 26     /* 2006-01-02T15:04:05+00:00 */
 #define RFC3339NANO_SIZE 36 /* 2006-01-02T15:04:05.999999999+00:00 */
 
@@ -0,0 +1,72 @@
+/**
+ * collectd - src/daemon/utils_time_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the clocks. Build with "make bench_utils_time"; the
+ * optional argument is the number of calls, 1000000 by default. */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils_time.h"
+
+DEF_BENCH(cdtime_precise) {
+  cdtime_t last = 0;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    cdtime_t t = cdtime_precise();
+    if (t < last)
+      return -1;
+    last = t;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(cdtime_coarse) {
+  cdtime_t last = 0;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    cdtime_t t = cdtime_coarse();
+    if (t < last)
+      return -1;
+    last = t;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t ops = BENCH_OPS(argc, argv, 1000000);
+
+  RUN_BENCH(cdtime_precise, ops);
+  RUN_BENCH(cdtime_coarse, ops);
+
+  printf("cdtime_coarse resolution: %.3f ms\n",
+         1e3 * CDTIME_T_TO_DOUBLE(cdtime_coarse_resolution()));
+
+  END_BENCH;
+}
@@ -161,9 +161,42 @@ DEF_TEST(ns_to_cdtime) {
   return 0;
 }
 
+/* Compares the cost of reading the precise and the coarse clock. Only the
+ * agreement of the two clocks is checked; the timings are informational. */
+DEF_TEST(clocks) {
+  struct {
+    char const *name;
+    cdtime_t (*read)(void);
+  } cases[] = {
+      {"cdtime_precise", cdtime_precise},
+      {"cdtime_coarse", cdtime_coarse},
+  };
+
+  for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++) {
+    cdtime_t last = 0;
+    bool monotonic = true;
+    for (size_t j = 0; j < 1000; j++) {
+      cdtime_t t = cases[i].read();
+      if (t < last)
+        monotonic = false;
+      last = t;
+    }
+    /* Neither clock may go backwards. */
+    OK1(monotonic, cases[i].name);
+  }
+
+  cdtime_t precise = cdtime_precise();
+  cdtime_t coarse = cdtime_coarse();
+  cdtime_t diff = (precise > coarse) ? precise - coarse : coarse - precise;
+  OK(diff < MS_TO_CDTIME_T(100));
+
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(conversion);
   RUN_TEST(ns_to_cdtime);
+  RUN_TEST(clocks);
 
   END_TEST;
 }
@@ -0,0 +1,245 @@
+/**
+ * collectd - src/daemon/write_pending.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "write_pending.h"
+
+/* Writes from different threads mostly go to different shards. The upper bits
+ * of a hash select the shard, the lower bits the slot. */
+#define WRITE_PENDING_SHARDS 16
+#define WRITE_PENDING_SIZE_MIN 64
+
+/* An open addressing hash table with linear probing. Zero marks an empty
+ * slot, so a hash of zero is stored as one. */
+typedef struct {
+  pthread_mutex_t lock;
+  uint64_t *slots;
+  size_t size;
+  size_t num;
+} write_pending_shard_t;
+
+struct write_pending_s {
+  size_t limit;
+  /* The number of identifiers in all shards, so that the limit holds however
+   * the hashes are spread. Accessed atomically. */
+  size_t num;
+  /* Set when an identifier couldn't be added. Accessed atomically. */
+  bool overflow;
+  write_pending_shard_t shards[WRITE_PENDING_SHARDS];
+};
+
+static uint64_t write_pending_key(uint64_t hash) /* {{{ */
+{
+  return (hash == 0) ? 1 : hash;
+} /* }}} uint64_t write_pending_key */
+
+static write_pending_shard_t *write_pending_shard(write_pending_t *wp, /* {{{ */
+                                                  uint64_t key) {
+  return wp->shards + (key >> 60) % WRITE_PENDING_SHARDS;
+} /* }}} write_pending_shard_t *write_pending_shard */
+
+/* Returns the slot holding `key' or the empty slot it would be stored in. */
+static size_t write_pending_find(write_pending_shard_t const *s, /* {{{ */
+                                 uint64_t key) {
+  size_t mask = s->size - 1;
+  size_t i = (size_t)key & mask;
+
+  while ((s->slots[i] != 0) && (s->slots[i] != key))
+    i = (i + 1) & mask;
+  return i;
+} /* }}} size_t write_pending_find */
+
+static int write_pending_resize(write_pending_shard_t *s, size_t size) /* {{{ */
+{
+  uint64_t *slots = calloc(size, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  write_pending_shard_t tmp = {.slots = slots, .size = size};
+  for (size_t i = 0; i < s->size; i++) {
+    if (s->slots[i] != 0)
+      slots[write_pending_find(&tmp, s->slots[i])] = s->slots[i];
+  }
+
+  free(s->slots);
+  s->slots = slots;
+  s->size = size;
+  return 0;
+} /* }}} int write_pending_resize */
+
+write_pending_t *write_pending_create(size_t limit) /* {{{ */
+{
+  write_pending_t *wp = calloc(1, sizeof(*wp));
+  if (wp == NULL)
+    return NULL;
+
+  wp->limit = (limit == 0) ? 1 : limit;
+
+  for (size_t i = 0; i < WRITE_PENDING_SHARDS; i++)
+    pthread_mutex_init(&wp->shards[i].lock, /* attr = */ NULL);
+
+  return wp;
+} /* }}} write_pending_t *write_pending_create */
+
+void write_pending_destroy(write_pending_t *wp) /* {{{ */
+{
+  if (wp == NULL)
+    return;
+
+  for (size_t i = 0; i < WRITE_PENDING_SHARDS; i++) {
+    pthread_mutex_destroy(&wp->shards[i].lock);
+    free(wp->shards[i].slots);
+  }
+  free(wp);
+} /* }}} void write_pending_destroy */
+
+void write_pending_add(write_pending_t *wp, uint64_t hash) /* {{{ */
+{
+  if ((wp == NULL) || __atomic_load_n(&wp->overflow, __ATOMIC_RELAXED))
+    return;
+
+  uint64_t key = write_pending_key(hash);
+  write_pending_shard_t *s = write_pending_shard(wp, key);
+
+  pthread_mutex_lock(&s->lock);
+  if (s->size != 0) {
+    size_t i = write_pending_find(s, key);
+    if (s->slots[i] == key) {
+      pthread_mutex_unlock(&s->lock);
+      return;
+    }
+  }
+
+  if (__atomic_add_fetch(&wp->num, 1, __ATOMIC_RELAXED) > wp->limit) {
+    __atomic_sub_fetch(&wp->num, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s->lock);
+    __atomic_store_n(&wp->overflow, true, __ATOMIC_RELAXED);
+    return;
+  }
+
+  /* Keeps the load factor below 3/4. */
+  if (4 * (s->num + 1) > 3 * s->size) {
+    size_t size = (s->size == 0) ? WRITE_PENDING_SIZE_MIN : 2 * s->size;
+    if (write_pending_resize(s, size) != 0) {
+      __atomic_sub_fetch(&wp->num, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&s->lock);
+      __atomic_store_n(&wp->overflow, true, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+
+  s->slots[write_pending_find(s, key)] = key;
+  s->num++;
+  pthread_mutex_unlock(&s->lock);
+} /* }}} void write_pending_add */
+
+void write_pending_remove(write_pending_t *wp, uint64_t hash) /* {{{ */
+{
+  if (wp == NULL)
+    return;
+
+  uint64_t key = write_pending_key(hash);
+  write_pending_shard_t *s = write_pending_shard(wp, key);
+
+  pthread_mutex_lock(&s->lock);
+  if (s->num == 0) {
+    pthread_mutex_unlock(&s->lock);
+    return;
+  }
+
+  size_t mask = s->size - 1;
+  size_t i = write_pending_find(s, key);
+  if (s->slots[i] != key) {
+    pthread_mutex_unlock(&s->lock);
+    return;
+  }
+
+  /* Moves entries of the probe sequence back into the freed slot, so lookups
+   * never stop early and no tombstones are needed. */
+  for (size_t j = (i + 1) & mask; s->slots[j] != 0; j = (j + 1) & mask) {
+    size_t home = (size_t)s->slots[j] & mask;
+    bool stays = (i <= j) ? ((i < home) && (home <= j))
+                          : ((i < home) || (home <= j));
+    if (stays)
+      continue;
+
+    s->slots[i] = s->slots[j];
+    i = j;
+  }
+  s->slots[i] = 0;
+  s->num--;
+  __atomic_sub_fetch(&wp->num, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&s->lock);
+} /* }}} void write_pending_remove */
+
+bool write_pending_check(write_pending_t *wp, uint64_t hash) /* {{{ */
+{
+  if ((wp == NULL) || __atomic_load_n(&wp->overflow, __ATOMIC_RELAXED))
+    return true;
+
+  uint64_t key = write_pending_key(hash);
+  write_pending_shard_t *s = write_pending_shard(wp, key);
+
+  pthread_mutex_lock(&s->lock);
+  bool found = (s->num != 0) && (s->slots[write_pending_find(s, key)] == key);
+  pthread_mutex_unlock(&s->lock);
+
+  return found;
+} /* }}} bool write_pending_check */
+
+void write_pending_clear(write_pending_t *wp) /* {{{ */
+{
+  if (wp == NULL)
+    return;
+
+  for (size_t i = 0; i < WRITE_PENDING_SHARDS; i++) {
+    write_pending_shard_t *s = wp->shards + i;
+
+    pthread_mutex_lock(&s->lock);
+    /* Gives back the memory of a burst of identifiers. */
+    sfree(s->slots);
+    __atomic_sub_fetch(&wp->num, s->num, __ATOMIC_RELAXED);
+    s->size = 0;
+    s->num = 0;
+    pthread_mutex_unlock(&s->lock);
+  }
+
+  __atomic_store_n(&wp->overflow, false, __ATOMIC_RELAXED);
+} /* }}} void write_pending_clear */
+
+size_t write_pending_size(write_pending_t *wp) /* {{{ */
+{
+  size_t num = 0;
+
+  if (wp == NULL)
+    return 0;
+
+  for (size_t i = 0; i < WRITE_PENDING_SHARDS; i++) {
+    pthread_mutex_lock(&wp->shards[i].lock);
+    num += wp->shards[i].num;
+    pthread_mutex_unlock(&wp->shards[i].lock);
+  }
+  return num;
+} /* }}} size_t write_pending_size */
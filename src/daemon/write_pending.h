@@ -0,0 +1,59 @@
+/**
+ * collectd - src/daemon/write_pending.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef WRITE_PENDING_H
+#define WRITE_PENDING_H 1
+
+#include "collectd.h"
+
+/* The set of identifiers a write callback has been passed values for since it
+ * was last flushed, kept as the identifiers' hashes. plugin_flush() uses it to
+ * skip writers that hold no data for the identifier being flushed. Hash
+ * collisions and a full set only cause unneeded flushes: once the set has
+ * more than its limit of entries, every identifier is considered pending until
+ * the set is cleared. */
+
+struct write_pending_s;
+typedef struct write_pending_s write_pending_t;
+
+/* Creates a set holding up to `limit' identifiers in total, however their
+ * hashes are spread across the shards. Returns NULL upon failure. */
+write_pending_t *write_pending_create(size_t limit);
+void write_pending_destroy(write_pending_t *wp);
+
+/* Adds the identifier with the hash `hash'. Cheap if it is already pending. */
+void write_pending_add(write_pending_t *wp, uint64_t hash);
+
+/* Removes the identifier with the hash `hash'. */
+void write_pending_remove(write_pending_t *wp, uint64_t hash);
+
+/* Returns true if the identifier with the hash `hash' may be pending. */
+bool write_pending_check(write_pending_t *wp, uint64_t hash);
+
+/* Removes all identifiers and resets the overflow. */
+void write_pending_clear(write_pending_t *wp);
+
+/* Returns the number of identifiers in the set. */
+size_t write_pending_size(write_pending_t *wp);
+
+#endif /* WRITE_PENDING_H */
@@ -0,0 +1,100 @@
+/**
+ * collectd - src/daemon/write_pending_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "write_pending.h"
+
+DEF_TEST(add_remove) {
+  write_pending_t *wp = write_pending_create(1024);
+  CHECK_NOT_NULL(wp);
+
+  /* All in one shard, and the first eight in one slot: removing from the
+   * middle of a probe sequence must keep the rest reachable. */
+  for (uint64_t i = 0; i < 8; i++)
+    write_pending_add(wp, 5 + (i << 20));
+  for (uint64_t i = 0; i < 100; i++)
+    write_pending_add(wp, 6 + i);
+  write_pending_add(wp, 5);
+  EXPECT_EQ_UINT64(108, write_pending_size(wp));
+
+  write_pending_remove(wp, 5 + (3 << 20));
+  write_pending_remove(wp, 6);
+  write_pending_remove(wp, 12345);
+  EXPECT_EQ_UINT64(106, write_pending_size(wp));
+
+  OK(!write_pending_check(wp, 5 + (3 << 20)));
+  OK(!write_pending_check(wp, 6));
+  for (uint64_t i = 0; i < 8; i++)
+    if (i != 3)
+      OK(write_pending_check(wp, 5 + (i << 20)));
+  for (uint64_t i = 1; i < 100; i++)
+    OK(write_pending_check(wp, 6 + i));
+
+  /* Zero is a valid hash. */
+  OK(!write_pending_check(wp, 0));
+  write_pending_add(wp, 0);
+  OK(write_pending_check(wp, 0));
+
+  write_pending_clear(wp);
+  EXPECT_EQ_UINT64(0, write_pending_size(wp));
+  OK(!write_pending_check(wp, 7));
+
+  write_pending_destroy(wp);
+  return 0;
+}
+
+DEF_TEST(overflow) {
+  /* The limit applies to all shards together. */
+  write_pending_t *wp = write_pending_create(2);
+  CHECK_NOT_NULL(wp);
+
+  write_pending_add(wp, 1);
+  write_pending_add(wp, 1);
+  write_pending_add(wp, 2);
+  EXPECT_EQ_UINT64(2, write_pending_size(wp));
+  OK(!write_pending_check(wp, 3));
+
+  /* Once an identifier is lost, all of them may be pending. */
+  write_pending_add(wp, (uint64_t)1 << 62);
+  OK(write_pending_check(wp, (uint64_t)1 << 62));
+  OK(write_pending_check(wp, 3));
+
+  write_pending_clear(wp);
+  OK(!write_pending_check(wp, 3));
+  write_pending_add(wp, 2);
+  write_pending_add(wp, 3);
+  OK(write_pending_check(wp, 2));
+  OK(!write_pending_check(wp, 1));
+
+  write_pending_destroy(wp);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(add_remove);
+  RUN_TEST(overflow);
+
+  END_TEST;
+}
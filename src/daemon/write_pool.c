@@ -0,0 +1,286 @@
+/**
+ * collectd - src/daemon/write_pool.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils_random.h"
+#include "utils_time.h"
+#include "write_pool.h"
+
+/* How often dropping values is complained about. */
+#define WRITE_POOL_COMPLAIN_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+typedef struct {
+  data_set_t const *ds;
+  value_list_t *vl;
+  plugin_ctx_t ctx;
+} write_pool_entry_t;
+
+/* The batch of one thread, handed to the callback. */
+typedef struct {
+  write_pool_t *wp;
+  pthread_t thread;
+  data_set_t const **ds;
+  value_list_t const **vl;
+  plugin_ctx_t *ctx;
+} write_pool_thread_t;
+
+struct write_pool_s {
+  char *name;
+  write_pool_config_t conf;
+  size_t batch_size;
+  write_pool_cb callback;
+  void (*free_func)(value_list_t *);
+  void *arg;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* A ring buffer of `size' entries; `length' of them, starting at `head',
+   * are used. */
+  write_pool_entry_t *queue;
+  size_t size;
+  size_t head;
+  long length;
+  bool shutdown;
+
+  uint64_t dropped;
+  cdtime_t last_complaint;
+
+  write_pool_thread_t *threads;
+  size_t threads_num;
+};
+
+static void *write_pool_thread(void *arg) {
+  write_pool_thread_t *t = arg;
+  write_pool_t *wp = t->wp;
+
+  pthread_mutex_lock(&wp->lock);
+  while (true) {
+    while (!wp->shutdown && (wp->length == 0))
+      pthread_cond_wait(&wp->cond, &wp->lock);
+    /* Values queued before the shutdown are still written. */
+    if (wp->length == 0)
+      break;
+
+    size_t num = (size_t)wp->length;
+    if (num > wp->batch_size)
+      num = wp->batch_size;
+    for (size_t i = 0; i < num; i++) {
+      write_pool_entry_t *e = wp->queue + ((wp->head + i) % wp->size);
+      t->ds[i] = e->ds;
+      t->vl[i] = e->vl;
+      t->ctx[i] = e->ctx;
+    }
+    wp->head = (wp->head + num) % wp->size;
+    wp->length -= (long)num;
+    pthread_mutex_unlock(&wp->lock);
+
+    (*wp->callback)(t->ds, t->vl, t->ctx, num, wp->arg);
+    for (size_t i = 0; i < num; i++) {
+      (*wp->free_func)((value_list_t *)t->vl[i]);
+      t->vl[i] = NULL;
+    }
+
+    pthread_mutex_lock(&wp->lock);
+  }
+  pthread_mutex_unlock(&wp->lock);
+
+  return NULL;
+} /* void *write_pool_thread */
+
+write_pool_t *write_pool_create(char const *name,
+                                write_pool_config_t const *conf,
+                                size_t batch_size, write_pool_cb callback,
+                                void (*free_func)(value_list_t *), void *arg) {
+  if ((name == NULL) || (conf == NULL) || (conf->threads < 1) ||
+      (batch_size < 1) || (callback == NULL) || (free_func == NULL))
+    return NULL;
+
+  write_pool_t *wp = calloc(1, sizeof(*wp));
+  if (wp == NULL) {
+    ERROR("write_pool: calloc failed.");
+    return NULL;
+  }
+  wp->conf = *conf;
+  wp->batch_size = batch_size;
+  wp->callback = callback;
+  wp->free_func = free_func;
+  wp->arg = arg;
+  pthread_mutex_init(&wp->lock, NULL);
+  pthread_cond_init(&wp->cond, NULL);
+
+  wp->name = strdup(name);
+  wp->threads = calloc(conf->threads, sizeof(*wp->threads));
+  if ((wp->name == NULL) || (wp->threads == NULL)) {
+    ERROR("write_pool: Allocating the pool of \"%s\" failed.", name);
+    write_pool_destroy(wp);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < conf->threads; i++) {
+    write_pool_thread_t *t = wp->threads + wp->threads_num;
+    t->wp = wp;
+    t->ds = calloc(batch_size, sizeof(*t->ds));
+    t->vl = calloc(batch_size, sizeof(*t->vl));
+    t->ctx = calloc(batch_size, sizeof(*t->ctx));
+    if ((t->ds == NULL) || (t->vl == NULL) || (t->ctx == NULL)) {
+      ERROR("write_pool: calloc failed.");
+      break;
+    }
+
+    int status = plugin_thread_create(&t->thread, /* attr = */ NULL,
+                                      write_pool_thread, t, "writeq");
+    if (status != 0) {
+      ERROR("write_pool: plugin_thread_create failed: %s", STRERROR(status));
+      break;
+    }
+    wp->threads_num++;
+  }
+
+  if (wp->threads_num == 0) {
+    write_pool_destroy(wp);
+    return NULL;
+  }
+
+  return wp;
+} /* write_pool_t *write_pool_create */
+
+void write_pool_destroy(write_pool_t *wp) {
+  if (wp == NULL)
+    return;
+
+  pthread_mutex_lock(&wp->lock);
+  wp->shutdown = true;
+  pthread_cond_broadcast(&wp->cond);
+  if (wp->length > 0)
+    INFO("write_pool: Writing the %ld queued values of \"%s\".", wp->length,
+         wp->name);
+  pthread_mutex_unlock(&wp->lock);
+
+  for (size_t i = 0; i < wp->threads_num; i++)
+    pthread_join(wp->threads[i].thread, NULL);
+
+  /* Only left if no thread could be started. */
+  for (long i = 0; i < wp->length; i++)
+    (*wp->free_func)(wp->queue[(wp->head + (size_t)i) % wp->size].vl);
+
+  if (wp->threads != NULL) {
+    for (size_t i = 0; i < wp->conf.threads; i++) {
+      sfree(wp->threads[i].ds);
+      sfree(wp->threads[i].vl);
+      sfree(wp->threads[i].ctx);
+    }
+  }
+  sfree(wp->threads);
+  sfree(wp->queue);
+  sfree(wp->name);
+  pthread_cond_destroy(&wp->cond);
+  pthread_mutex_destroy(&wp->lock);
+  sfree(wp);
+} /* void write_pool_destroy */
+
+/* Must be called with `wp->lock' held. */
+static bool write_pool_drop(write_pool_t *wp) {
+  long high = wp->conf.limit_high;
+  long low = wp->conf.limit_low;
+
+  if ((high == 0) || (wp->length < low))
+    return false;
+  if (wp->length >= high)
+    return true;
+
+  double p = (double)(1 + wp->length - low) / (double)(1 + high - low);
+  return cdrand_d() < p;
+} /* bool write_pool_drop */
+
+/* Doubles the ring buffer. Must be called with `wp->lock' held. */
+static int write_pool_grow(write_pool_t *wp) {
+  size_t size = (wp->size == 0) ? 64 : 2 * wp->size;
+  write_pool_entry_t *queue = calloc(size, sizeof(*queue));
+  if (queue == NULL)
+    return ENOMEM;
+
+  for (long i = 0; i < wp->length; i++)
+    queue[i] = wp->queue[(wp->head + (size_t)i) % wp->size];
+
+  sfree(wp->queue);
+  wp->queue = queue;
+  wp->size = size;
+  wp->head = 0;
+  return 0;
+} /* int write_pool_grow */
+
+int write_pool_enqueue(write_pool_t *wp, data_set_t const *ds,
+                       value_list_t *vl) {
+  if ((wp == NULL) || (ds == NULL) || (vl == NULL))
+    return EINVAL;
+
+  plugin_ctx_t ctx = plugin_get_ctx();
+
+  pthread_mutex_lock(&wp->lock);
+  if (wp->shutdown) {
+    pthread_mutex_unlock(&wp->lock);
+    return ESHUTDOWN;
+  }
+
+  if (write_pool_drop(wp)) {
+    wp->dropped++;
+    cdtime_t now = cdtime();
+    bool complain = (now - wp->last_complaint) >= WRITE_POOL_COMPLAIN_INTERVAL;
+    if (complain)
+      wp->last_complaint = now;
+    long length = wp->length;
+    uint64_t dropped = wp->dropped;
+    pthread_mutex_unlock(&wp->lock);
+
+    if (complain)
+      WARNING("write_pool: The queue of \"%s\" holds %ld values. %" PRIu64
+              " values have been dropped so far.",
+              wp->name, length, dropped);
+    return EAGAIN;
+  }
+
+  if (((size_t)wp->length == wp->size) && (write_pool_grow(wp) != 0)) {
+    pthread_mutex_unlock(&wp->lock);
+    ERROR("write_pool: Growing the queue of \"%s\" failed.", wp->name);
+    return ENOMEM;
+  }
+
+  wp->queue[(wp->head + (size_t)wp->length) % wp->size] =
+      (write_pool_entry_t){.ds = ds, .vl = vl, .ctx = ctx};
+  wp->length++;
+  pthread_cond_signal(&wp->cond);
+  pthread_mutex_unlock(&wp->lock);
+
+  return 0;
+} /* int write_pool_enqueue */
+
+void write_pool_stats(write_pool_t *wp, long *ret_length,
+                      uint64_t *ret_dropped) {
+  pthread_mutex_lock(&wp->lock);
+  *ret_length = wp->length;
+  *ret_dropped = wp->dropped;
+  pthread_mutex_unlock(&wp->lock);
+} /* void write_pool_stats */
@@ -0,0 +1,92 @@
+/**
+ * collectd - src/daemon/write_pool.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef WRITE_POOL_H
+#define WRITE_POOL_H 1
+
+#include "plugin.h"
+
+/* A write pool gives one write callback its own queue and threads, so that a
+ * slow callback doesn't hold up the write threads and, with them, all other
+ * write callbacks. The queue is bounded by watermarks like the global write
+ * queue: above the low watermark, incoming values are dropped with a growing
+ * probability, at the high watermark all of them are. */
+
+struct write_pool_config_s {
+  size_t threads;
+  /* Zero for an unbounded queue. */
+  long limit_high;
+  long limit_low;
+};
+typedef struct write_pool_config_s write_pool_config_t;
+
+struct write_pool_s;
+typedef struct write_pool_s write_pool_t;
+
+/* Writes `num' value lists, taken from the queue in order. `ctx[i]' is the
+ * context `vl[i]' was queued with. Returns zero upon success. */
+typedef int (*write_pool_cb)(data_set_t const **ds, value_list_t const **vl,
+                             plugin_ctx_t const *ctx, size_t num, void *arg);
+
+/*
+ * NAME
+ *   write_pool_create
+ *
+ * DESCRIPTION
+ *   Starts the threads of the write callback `name'. Each of them passes up to
+ *   `batch_size' queued value lists to `callback' at a time. Queued value
+ *   lists are freed with `free_func' once they have been written.
+ *
+ * RETURN VALUE
+ *   A write_pool_t-pointer upon success or NULL upon failure.
+ */
+write_pool_t *write_pool_create(char const *name,
+                                write_pool_config_t const *conf,
+                                size_t batch_size, write_pool_cb callback,
+                                void (*free_func)(value_list_t *), void *arg);
+
+/* Writes the values that are still queued, then stops the threads. */
+void write_pool_destroy(write_pool_t *wp);
+
+/*
+ * NAME
+ *   write_pool_enqueue
+ *
+ * DESCRIPTION
+ *   Queues `vl', which is owned by the pool from then on, and the current
+ *   thread context.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EAGAIN if the value has been dropped because the queue
+ *   is full and ESHUTDOWN if the pool is shutting down. The caller keeps `vl'
+ *   in case of an error.
+ */
+int write_pool_enqueue(write_pool_t *wp, data_set_t const *ds,
+                       value_list_t *vl);
+
+/* Returns the number of queued value lists and the number of value lists
+ * dropped so far. */
+void write_pool_stats(write_pool_t *wp, long *ret_length,
+                      uint64_t *ret_dropped);
+
+#endif /* WRITE_POOL_H */
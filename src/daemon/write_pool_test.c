@@ -0,0 +1,155 @@
+/**
+ * collectd - src/daemon/write_pool_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "write_pool.h"
+
+static data_set_t ds = {"test", 0, NULL};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+/* Set while the callback is called and waits for `blocked' to be cleared. */
+static bool blocked;
+static bool waiting;
+static int written;
+static int out_of_order;
+static int freed;
+
+static int write_cb(data_set_t const **ds, value_list_t const **vl,
+                    plugin_ctx_t const *ctx, size_t num, void *arg) {
+  pthread_mutex_lock(&lock);
+  waiting = true;
+  pthread_cond_broadcast(&cond);
+  while (blocked)
+    pthread_cond_wait(&cond, &lock);
+  waiting = false;
+
+  for (size_t i = 0; i < num; i++) {
+    if (vl[i]->values[0].gauge != (gauge_t)written)
+      out_of_order++;
+    written++;
+  }
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+static void free_cb(value_list_t *vl) {
+  pthread_mutex_lock(&lock);
+  freed++;
+  pthread_mutex_unlock(&lock);
+  sfree(vl->values);
+  sfree(vl);
+}
+
+static value_list_t *new_vl(int i) {
+  value_list_t *vl = calloc(1, sizeof(*vl));
+  vl->values = calloc(1, sizeof(*vl->values));
+  vl->values[0].gauge = (gauge_t)i;
+  vl->values_len = 1;
+  return vl;
+}
+
+static void reset(bool block) {
+  pthread_mutex_lock(&lock);
+  blocked = block;
+  waiting = false;
+  written = 0;
+  out_of_order = 0;
+  freed = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+DEF_TEST(drain) {
+  write_pool_config_t conf = {.threads = 1};
+  write_pool_t *wp;
+
+  reset(/* block = */ false);
+  CHECK_NOT_NULL(wp = write_pool_create("drain", &conf, 4, write_cb, free_cb,
+                                        NULL));
+  for (int i = 0; i < 1000; i++)
+    EXPECT_EQ_INT(0, write_pool_enqueue(wp, &ds, new_vl(i)));
+
+  /* The queued values are written before the pool is gone. */
+  write_pool_destroy(wp);
+  EXPECT_EQ_INT(1000, written);
+  EXPECT_EQ_INT(0, out_of_order);
+  EXPECT_EQ_INT(1000, freed);
+
+  return 0;
+}
+
+DEF_TEST(limits) {
+  write_pool_config_t conf = {.threads = 1, .limit_high = 10, .limit_low = 10};
+  write_pool_t *wp;
+
+  reset(/* block = */ true);
+  CHECK_NOT_NULL(wp = write_pool_create("limits", &conf, 1, write_cb, free_cb,
+                                        NULL));
+
+  /* Wait until the thread is stuck with the first value. */
+  EXPECT_EQ_INT(0, write_pool_enqueue(wp, &ds, new_vl(0)));
+  pthread_mutex_lock(&lock);
+  while (!waiting)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+
+  int dropped = 0;
+  for (int i = 1; i < 16; i++) {
+    value_list_t *vl = new_vl(i);
+    int status = write_pool_enqueue(wp, &ds, vl);
+    if (status == EAGAIN) {
+      free_cb(vl);
+      dropped++;
+    } else {
+      EXPECT_EQ_INT(0, status);
+    }
+  }
+  EXPECT_EQ_INT(5, dropped);
+
+  long length = 0;
+  uint64_t stats_dropped = 0;
+  write_pool_stats(wp, &length, &stats_dropped);
+  EXPECT_EQ_INT(10, (int)length);
+  EXPECT_EQ_UINT64(5, stats_dropped);
+
+  pthread_mutex_lock(&lock);
+  blocked = false;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+
+  write_pool_destroy(wp);
+  EXPECT_EQ_INT(11, written);
+  EXPECT_EQ_INT(16, freed);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(drain);
+  RUN_TEST(limits);
+
+  END_TEST;
+}
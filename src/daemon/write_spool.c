@@ -0,0 +1,376 @@
+/**
+ * collectd - src/daemon/write_spool.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "write_spool.h"
+
+/* A spooled value list: this header, followed by the values and the five
+ * parts of the identifier, without null bytes. The values are copied
+ * verbatim; their types are looked up again when they are replayed. */
+typedef struct {
+  uint64_t time;
+  uint64_t interval;
+  uint16_t values_len;
+  uint8_t lengths[5];
+} write_spool_record_t;
+
+struct write_spool_s {
+  char *name;
+  char *directory;
+  spool_t *spool;
+  write_spool_config_t conf;
+  write_spool_cb callback;
+  void *arg;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool thread_running;
+  bool shutdown;
+
+  /* Set while values are waiting, to log the start and end of an outage
+   * once. */
+  bool spooling;
+  uint64_t dropped;
+};
+
+static size_t write_spool_encode(value_list_t const *vl, char *buffer,
+                                 size_t buffer_size) {
+  char const *parts[5] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                          vl->type_instance};
+  write_spool_record_t r = {
+      .time = (uint64_t)vl->time,
+      .interval = (uint64_t)vl->interval,
+      .values_len = (uint16_t)vl->values_len,
+  };
+
+  size_t size = sizeof(r) + vl->values_len * sizeof(value_t);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    size_t len = strlen(parts[i]);
+    if (len >= DATA_MAX_NAME_LEN)
+      return 0;
+    r.lengths[i] = (uint8_t)len;
+    size += len;
+  }
+  if ((vl->values_len > UINT16_MAX) || (size > buffer_size))
+    return 0;
+
+  char *ptr = buffer;
+  memcpy(ptr, &r, sizeof(r));
+  ptr += sizeof(r);
+  memcpy(ptr, vl->values, vl->values_len * sizeof(value_t));
+  ptr += vl->values_len * sizeof(value_t);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    memcpy(ptr, parts[i], r.lengths[i]);
+    ptr += r.lengths[i];
+  }
+
+  return size;
+} /* size_t write_spool_encode */
+
+/* Fills in `vl' from a record, pointing `vl->values' to `values', which has
+ * room for `values_size' values. */
+static int write_spool_decode(void const *data, size_t size,
+                              value_list_t *vl, value_t *values,
+                              size_t values_size) {
+  char *parts[5] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                    vl->type_instance};
+  write_spool_record_t r;
+
+  if (size < sizeof(r))
+    return EINVAL;
+  memcpy(&r, data, sizeof(r));
+
+  size_t want = sizeof(r) + r.values_len * sizeof(value_t);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    if (r.lengths[i] >= DATA_MAX_NAME_LEN)
+      return EINVAL;
+    want += r.lengths[i];
+  }
+  if ((want != size) || (r.values_len == 0) || (r.values_len > values_size))
+    return EINVAL;
+
+  char const *ptr = (char const *)data + sizeof(r);
+  memcpy(values, ptr, r.values_len * sizeof(value_t));
+  ptr += r.values_len * sizeof(value_t);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    memcpy(parts[i], ptr, r.lengths[i]);
+    parts[i][r.lengths[i]] = 0;
+    ptr += r.lengths[i];
+  }
+
+  vl->values = values;
+  vl->values_len = r.values_len;
+  vl->time = (cdtime_t)r.time;
+  vl->interval = (cdtime_t)r.interval;
+  return 0;
+} /* int write_spool_decode */
+
+/* Passes the oldest spooled value list to the callback. Returns ENOENT if
+ * the spool is empty and EAGAIN if the callback failed. */
+static int write_spool_replay(write_spool_t *ws) {
+  void const *data;
+  size_t size;
+
+  int status = spool_peek(ws->spool, &data, &size);
+  if (status != 0) {
+    if (status != ENOENT)
+      ERROR("write_spool: Reading the spool of \"%s\" failed: %s", ws->name,
+            STRERROR(status));
+    return status;
+  }
+
+  value_t values[64];
+  value_list_t vl = VALUE_LIST_INIT;
+  data_set_t const *ds = NULL;
+  if (write_spool_decode(data, size, &vl, values,
+                         STATIC_ARRAY_SIZE(values)) == 0)
+    ds = plugin_get_ds(vl.type);
+
+  if ((ds == NULL) || (ds->ds_num != vl.values_len)) {
+    WARNING("write_spool: Dropping a value list from the spool of \"%s\" "
+            "whose type is unknown or has changed.",
+            ws->name);
+    spool_consume(ws->spool);
+    return 0;
+  }
+
+  if ((*ws->callback)(ds, &vl, ws->arg) != 0)
+    return EAGAIN;
+
+  spool_consume(ws->spool);
+  return 0;
+} /* int write_spool_replay */
+
+static void *write_spool_thread(void *arg) {
+  write_spool_t *ws = arg;
+  cdtime_t step = DOUBLE_TO_CDTIME_T(1.0 / ws->conf.replay_rate);
+  cdtime_t next = cdtime();
+
+  pthread_mutex_lock(&ws->lock);
+  while (!ws->shutdown) {
+    if (spool_records(ws->spool) == 0) {
+      if (ws->spooling)
+        INFO("write_spool: All spooled values of \"%s\" have been written.",
+             ws->name);
+      ws->spooling = false;
+      pthread_cond_wait(&ws->cond, &ws->lock);
+      next = cdtime();
+      continue;
+    }
+    pthread_mutex_unlock(&ws->lock);
+
+    int status = write_spool_replay(ws);
+
+    pthread_mutex_lock(&ws->lock);
+    cdtime_t now = cdtime();
+    cdtime_t deadline = now;
+    if (status == ENOENT) {
+      continue;
+    } else if (status != 0) {
+      deadline = now + ws->conf.retry_interval;
+      next = deadline;
+    } else {
+      /* Don't catch up after a slow write, so that the rate is never
+       * exceeded for long. */
+      next = ((next + step) < now) ? now : next + step;
+      deadline = next;
+    }
+
+    /* New values wake the thread up, too; they must not shorten the wait. */
+    while (!ws->shutdown && (deadline > cdtime()))
+      pthread_cond_timedwait(&ws->cond, &ws->lock,
+                             &CDTIME_T_TO_TIMESPEC(deadline));
+  }
+  pthread_mutex_unlock(&ws->lock);
+
+  return NULL;
+} /* void *write_spool_thread */
+
+write_spool_t *write_spool_create(char const *name,
+                                  write_spool_config_t const *conf,
+                                  write_spool_cb callback, void *arg) {
+  if ((name == NULL) || (conf == NULL) || (conf->directory == NULL) ||
+      (callback == NULL))
+    return NULL;
+
+  write_spool_t *ws = calloc(1, sizeof(*ws));
+  if (ws == NULL) {
+    ERROR("write_spool: calloc failed.");
+    return NULL;
+  }
+  ws->conf = *conf;
+  ws->callback = callback;
+  ws->arg = arg;
+
+  /* Callbacks are often named "<plugin>/<instance>". The position file is
+   * created by spool_open(), but check_create_dir() needs a file name to
+   * create its parents. */
+  char directory[PATH_MAX];
+  char file[PATH_MAX + 16];
+  int len = snprintf(directory, sizeof(directory), "%s/%s", conf->directory,
+                     name);
+  if ((len < 0) || ((size_t)len >= sizeof(directory))) {
+    ERROR("write_spool: The spool directory of \"%s\" is too long.", name);
+    sfree(ws);
+    return NULL;
+  }
+  for (char *ptr = directory + strlen(conf->directory) + 1; *ptr != 0; ptr++)
+    if (*ptr == '/')
+      *ptr = '_';
+  snprintf(file, sizeof(file), "%s/position", directory);
+
+  ws->name = strdup(name);
+  ws->directory = strdup(directory);
+  if ((ws->name == NULL) || (ws->directory == NULL)) {
+    ERROR("write_spool: strdup failed.");
+    write_spool_destroy(ws);
+    return NULL;
+  }
+
+  if (check_create_dir(file) != 0) {
+    write_spool_destroy(ws);
+    return NULL;
+  }
+
+  spool_options_t opts = {
+      .segment_size = conf->segment_size,
+      .max_size = conf->limit,
+      .sync = conf->sync,
+  };
+  ws->spool = spool_open(directory, &opts);
+  if (ws->spool == NULL) {
+    ERROR("write_spool: Opening the spool \"%s\" failed: %s", directory,
+          STRERRNO);
+    write_spool_destroy(ws);
+    return NULL;
+  }
+
+  uint64_t records = spool_records(ws->spool);
+  if (records > 0) {
+    INFO("write_spool: %" PRIu64 " values of \"%s\" are waiting in \"%s\".",
+         records, name, directory);
+    ws->spooling = true;
+  }
+
+  pthread_mutex_init(&ws->lock, NULL);
+  pthread_cond_init(&ws->cond, NULL);
+  return ws;
+} /* write_spool_t *write_spool_create */
+
+int write_spool_start(write_spool_t *ws) {
+  if (ws == NULL)
+    return EINVAL;
+
+  pthread_mutex_lock(&ws->lock);
+  if (ws->thread_running) {
+    pthread_mutex_unlock(&ws->lock);
+    return 0;
+  }
+
+  int status = plugin_thread_create(&ws->thread, /* attr = */ NULL,
+                                    write_spool_thread, ws, "spool");
+  if (status != 0) {
+    pthread_mutex_unlock(&ws->lock);
+    ERROR("write_spool: plugin_thread_create failed: %s", STRERROR(status));
+    return status;
+  }
+  ws->thread_running = true;
+  pthread_mutex_unlock(&ws->lock);
+
+  return 0;
+} /* int write_spool_start */
+
+void write_spool_destroy(write_spool_t *ws) {
+  if (ws == NULL)
+    return;
+
+  if (ws->spool != NULL) {
+    pthread_mutex_lock(&ws->lock);
+    ws->shutdown = true;
+    pthread_cond_signal(&ws->cond);
+    bool running = ws->thread_running;
+    pthread_mutex_unlock(&ws->lock);
+
+    if (running)
+      pthread_join(ws->thread, NULL);
+
+    uint64_t records = spool_records(ws->spool);
+    if (records > 0)
+      WARNING("write_spool: %" PRIu64 " values of \"%s\" are left in \"%s\".",
+              records, ws->name, ws->directory);
+
+    spool_close(ws->spool);
+    pthread_cond_destroy(&ws->cond);
+    pthread_mutex_destroy(&ws->lock);
+  }
+
+  sfree(ws->name);
+  sfree(ws->directory);
+  sfree(ws);
+} /* void write_spool_destroy */
+
+bool write_spool_pending(write_spool_t *ws) {
+  return (ws != NULL) && (spool_records(ws->spool) > 0);
+} /* bool write_spool_pending */
+
+int write_spool_append(write_spool_t *ws, value_list_t const *vl) {
+  char buffer[sizeof(write_spool_record_t) + 64 * sizeof(value_t) +
+              5 * DATA_MAX_NAME_LEN];
+
+  if ((ws == NULL) || (vl == NULL))
+    return EINVAL;
+
+  size_t size = write_spool_encode(vl, buffer, sizeof(buffer));
+  if (size == 0) {
+    ERROR("write_spool: A value list with %" PRIsz " values can't be "
+          "spooled.",
+          vl->values_len);
+    return EINVAL;
+  }
+
+  int status = spool_append(ws->spool, buffer, size);
+
+  pthread_mutex_lock(&ws->lock);
+  if (status != 0) {
+    /* Complain about the first value that is lost, and then only about every
+     * 10000th. */
+    if ((ws->dropped % 10000) == 0)
+      ERROR("write_spool: Spooling values of \"%s\" failed, %" PRIu64
+            " values have been dropped so far: %s",
+            ws->name, ws->dropped + 1, STRERROR(status));
+    ws->dropped++;
+  } else if (!ws->spooling) {
+    WARNING("write_spool: Writing via \"%s\" failed, spooling values to "
+            "\"%s\".",
+            ws->name, ws->directory);
+    ws->spooling = true;
+  }
+  pthread_cond_signal(&ws->cond);
+  pthread_mutex_unlock(&ws->lock);
+
+  return status;
+} /* int write_spool_append */
@@ -0,0 +1,98 @@
+/**
+ * collectd - src/daemon/write_spool.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef WRITE_SPOOL_H
+#define WRITE_SPOOL_H 1
+
+#include "plugin.h"
+#include "utils/spool/spool.h"
+
+/* A write spool keeps the values a write callback failed to write on disk
+ * and passes them to the callback again, at a limited rate, once it works
+ * again. While values are waiting, new values are spooled, too, so that the
+ * callback gets all values in order. Meta data is not spooled. */
+
+struct write_spool_config_s {
+  /* The spool of a callback is a directory named after it in here. */
+  char *directory;
+  size_t segment_size;
+  /* The maximum size of the spool in bytes, zero for no limit. */
+  uint64_t limit;
+  spool_sync_t sync;
+  /* Values per second passed to the callback while replaying. */
+  double replay_rate;
+  /* Time to wait before retrying after the callback failed. */
+  cdtime_t retry_interval;
+};
+typedef struct write_spool_config_s write_spool_config_t;
+
+#define WRITE_SPOOL_SEGMENT_SIZE (8 * 1024 * 1024)
+#define WRITE_SPOOL_REPLAY_RATE 1000.0
+#define WRITE_SPOOL_RETRY_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+struct write_spool_s;
+typedef struct write_spool_s write_spool_t;
+
+/* Writes one value list, returns zero upon success. */
+typedef int (*write_spool_cb)(data_set_t const *ds, value_list_t const *vl,
+                              void *arg);
+
+/*
+ * NAME
+ *   write_spool_create
+ *
+ * DESCRIPTION
+ *   Opens the spool of the write callback `name'. Values left in it by the
+ *   last run are replayed once `write_spool_start' has been called.
+ *
+ * RETURN VALUE
+ *   A write_spool_t-pointer upon success or NULL upon failure.
+ */
+write_spool_t *write_spool_create(char const *name,
+                                  write_spool_config_t const *conf,
+                                  write_spool_cb callback, void *arg);
+
+/* Starts the thread replaying the spooled values. */
+int write_spool_start(write_spool_t *ws);
+
+/* Stops the replay thread and closes the spool. The values that haven't been
+ * replayed stay on disk. */
+void write_spool_destroy(write_spool_t *ws);
+
+/* Returns true if values are waiting to be replayed. New values have to be
+ * spooled then, too. */
+bool write_spool_pending(write_spool_t *ws);
+
+/*
+ * NAME
+ *   write_spool_append
+ *
+ * DESCRIPTION
+ *   Adds `vl' to the spool.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise.
+ */
+int write_spool_append(write_spool_t *ws, value_list_t const *vl);
+
+#endif /* WRITE_SPOOL_H */
@@ -69,13 +69,24 @@ struct cdbi_database_s /* {{{ */
   cdbi_driver_option_t *driver_options;
   size_t driver_options_num;
 
+  udb_query_t **queries;
+  size_t queries_num;
+};
+typedef struct cdbi_database_s cdbi_database_t; /* }}} */
+
+/* A group of queries of one database which are run over one connection by
+ * one read callback. */
+struct cdbi_group_s /* {{{ */
+{
+  cdbi_database_t *db;
+
   udb_query_preparation_area_t **q_prep_areas;
   udb_query_t **queries;
   size_t queries_num;
 
   dbi_conn connection;
 };
-typedef struct cdbi_database_s cdbi_database_t; /* }}} */
+typedef struct cdbi_group_s cdbi_group_t; /* }}} */
 
 /*
  * Global variables
@@ -87,6 +98,8 @@ static udb_query_t **queries;
 static size_t queries_num;
 static cdbi_database_t **databases;
 static size_t databases_num;
+static cdbi_group_t **groups;
+static size_t groups_num;
 
 static int cdbi_read_database(user_data_t *ud);
 
@@ -183,10 +196,6 @@ static void cdbi_database_free(cdbi_database_t *db) /* {{{ */
   }
   sfree(db->driver_options);
 
-  if (db->q_prep_areas)
-    for (size_t i = 0; i < db->queries_num; ++i)
-      udb_query_delete_preparation_area(db->q_prep_areas[i]);
-  sfree(db->q_prep_areas);
   /* N.B.: db->queries references objects "owned" by the global queries
    * variable. Free the array here, but not the content. */
   sfree(db->queries);
@@ -194,6 +203,23 @@ static void cdbi_database_free(cdbi_database_t *db) /* {{{ */
   sfree(db);
 } /* }}} void cdbi_database_free */
 
+static void cdbi_group_free(cdbi_group_t *g) /* {{{ */
+{
+  if (g == NULL)
+    return;
+
+  if (g->connection != NULL)
+    dbi_conn_close(g->connection);
+
+  if (g->q_prep_areas)
+    for (size_t i = 0; i < g->queries_num; ++i)
+      udb_query_delete_preparation_area(g->q_prep_areas[i]);
+  sfree(g->q_prep_areas);
+  sfree(g->queries);
+
+  sfree(g);
+} /* }}} void cdbi_group_free */
+
 /* Configuration handling functions {{{
  *
  * <Plugin dbi>
@@ -263,9 +289,88 @@ static int cdbi_config_add_database_driver_option(cdbi_database_t *db, /* {{{ */
   return 0;
 } /* }}} int cdbi_config_add_database_driver_option */
 
+/* Distributes the queries of "db" over up to "connections" groups per query
+ * interval. Each group gets a connection and a read callback of its own, so
+ * that the groups are queried in parallel. */
+static int cdbi_register_groups(cdbi_database_t *db, /* {{{ */
+                                size_t connections, cdtime_t interval) {
+  if (db->queries_num == 0) {
+    WARNING("dbi plugin: No `Query' given for database `%s'.", db->name);
+    return 0;
+  }
+
+  size_t group_ids[db->queries_num];
+  size_t num =
+      udb_query_group(db->queries, db->queries_num, connections, group_ids);
+
+  for (size_t i = 0; i < num; i++) {
+    cdbi_group_t *g = calloc(1, sizeof(*g));
+    if (g == NULL) {
+      ERROR("dbi plugin: calloc failed.");
+      return -1;
+    }
+    g->db = db;
+
+    cdbi_group_t **temp = realloc(groups, sizeof(*groups) * (groups_num + 1));
+    if (temp == NULL) {
+      ERROR("dbi plugin: realloc failed");
+      sfree(g);
+      return -1;
+    }
+    groups = temp;
+    groups[groups_num] = g;
+    groups_num++;
+
+    for (size_t j = 0; j < db->queries_num; j++)
+      if (group_ids[j] == i)
+        g->queries_num++;
+
+    g->queries = calloc(g->queries_num, sizeof(*g->queries));
+    g->q_prep_areas = calloc(g->queries_num, sizeof(*g->q_prep_areas));
+    if ((g->queries == NULL) || (g->q_prep_areas == NULL)) {
+      ERROR("dbi plugin: calloc failed.");
+      return -1;
+    }
+
+    size_t k = 0;
+    for (size_t j = 0; j < db->queries_num; j++) {
+      if (group_ids[j] != i)
+        continue;
+
+      g->queries[k] = db->queries[j];
+      g->q_prep_areas[k] = udb_query_allocate_preparation_area(db->queries[j]);
+      if (g->q_prep_areas[k] == NULL) {
+        WARNING("dbi plugin: udb_query_allocate_preparation_area failed");
+        return -1;
+      }
+      k++;
+    }
+
+    cdtime_t group_interval = udb_query_get_interval(g->queries[0]);
+    if (group_interval == 0)
+      group_interval = interval;
+
+    char *name = (i == 0)
+                     ? ssnprintf_alloc("dbi:%s", db->name)
+                     : ssnprintf_alloc("dbi:%s-%" PRIsz, db->name, i);
+    plugin_register_complex_read(
+        /* group = */ NULL,
+        /* name = */ name ? name : db->name,
+        /* callback = */ cdbi_read_database,
+        /* interval = */ group_interval,
+        &(user_data_t){
+            .data = g,
+        });
+    sfree(name);
+  }
+
+  return 0;
+} /* }}} int cdbi_register_groups */
+
 static int cdbi_config_add_database(oconfig_item_t *ci) /* {{{ */
 {
   cdtime_t interval = 0;
+  int connections = 1;
   cdbi_database_t *db;
   int status;
 
@@ -304,6 +409,8 @@ static int cdbi_config_add_database(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_string(child, &db->host);
     else if (strcasecmp("Interval", child->key) == 0)
       status = cf_util_get_cdtime(child, &interval);
+    else if (strcasecmp("Connections", child->key) == 0)
+      status = cf_util_get_int(child, &connections);
     else if (strcasecmp("Plugin", child->key) == 0)
       status = cf_util_get_string(child, &db->plugin_name);
     else {
@@ -326,30 +433,15 @@ static int cdbi_config_add_database(oconfig_item_t *ci) /* {{{ */
               "This will likely not work.",
               db->name);
     }
-
-    break;
-  } /* while (status == 0) */
-
-  while ((status == 0) && (db->queries_num > 0)) {
-    db->q_prep_areas = calloc(db->queries_num, sizeof(*db->q_prep_areas));
-    if (db->q_prep_areas == NULL) {
-      WARNING("dbi plugin: calloc failed");
+    if (connections < 1) {
+      WARNING("dbi plugin: `Connections' must be at least 1 for database "
+              "`%s'.",
+              db->name);
       status = -1;
-      break;
-    }
-
-    for (size_t i = 0; i < db->queries_num; ++i) {
-      db->q_prep_areas[i] = udb_query_allocate_preparation_area(db->queries[i]);
-
-      if (db->q_prep_areas[i] == NULL) {
-        WARNING("dbi plugin: udb_query_allocate_preparation_area failed");
-        status = -1;
-        break;
-      }
     }
 
     break;
-  }
+  } /* while (status == 0) */
 
   /* If all went well, add this database to the global list of databases. */
   if (status == 0) {
@@ -364,16 +456,9 @@ static int cdbi_config_add_database(oconfig_item_t *ci) /* {{{ */
       databases[databases_num] = db;
       databases_num++;
 
-      char *name = ssnprintf_alloc("dbi:%s", db->name);
-      plugin_register_complex_read(
-          /* group = */ NULL,
-          /* name = */ name ? name : db->name,
-          /* callback = */ cdbi_read_database,
-          /* interval = */ interval,
-          &(user_data_t){
-              .data = db,
-          });
-      sfree(name);
+      /* The database is freed on shutdown from now on. */
+      if (cdbi_register_groups(db, (size_t)connections, interval) != 0)
+        return -1;
     }
   }
 
@@ -440,9 +525,10 @@ static int cdbi_init(void) /* {{{ */
   return 0;
 } /* }}} int cdbi_init */
 
-static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
+static int cdbi_read_database_query(cdbi_group_t *g, /* {{{ */
                                     udb_query_t *q,
                                     udb_query_preparation_area_t *prep_area) {
+  cdbi_database_t *db = g->db;
   const char *statement;
   dbi_result res;
   size_t column_num;
@@ -473,13 +559,13 @@ static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
   statement = udb_query_get_statement(q);
   assert(statement != NULL);
 
-  res = dbi_conn_query(db->connection, statement);
+  res = dbi_conn_query(g->connection, statement);
   if (res == NULL) {
     char errbuf[1024];
     ERROR("dbi plugin: cdbi_read_database_query (%s, %s): "
           "dbi_conn_query failed: %s",
           db->name, udb_query_get_name(q),
-          cdbi_strerror(db->connection, errbuf, sizeof(errbuf)));
+          cdbi_strerror(g->connection, errbuf, sizeof(errbuf)));
     BAIL_OUT(-1);
   } else /* Get the number of columns */
   {
@@ -491,7 +577,7 @@ static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
       ERROR("dbi plugin: cdbi_read_database_query (%s, %s): "
             "dbi_result_get_numfields failed: %s",
             db->name, udb_query_get_name(q),
-            cdbi_strerror(db->connection, errbuf, sizeof(errbuf)));
+            cdbi_strerror(g->connection, errbuf, sizeof(errbuf)));
       BAIL_OUT(-1);
     }
 
@@ -565,7 +651,7 @@ static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
           "dbi_result_first_row failed: %s. Maybe the statement didn't "
           "return any rows?",
           db->name, udb_query_get_name(q),
-          cdbi_strerror(db->connection, errbuf, sizeof(errbuf)));
+          cdbi_strerror(g->connection, errbuf, sizeof(errbuf)));
     udb_query_finish_result(q, prep_area);
     BAIL_OUT(-1);
   } /* }}} */
@@ -612,7 +698,7 @@ static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
       WARNING("dbi plugin: cdbi_read_database_query (%s, %s): "
               "dbi_result_next_row failed: %s.",
               db->name, udb_query_get_name(q),
-              cdbi_strerror(db->connection, errbuf, sizeof(errbuf)));
+              cdbi_strerror(g->connection, errbuf, sizeof(errbuf)));
       break;
     } /* }}} */
   }   /* }}} while (42) */
@@ -625,19 +711,20 @@ static int cdbi_read_database_query(cdbi_database_t *db, /* {{{ */
 #undef BAIL_OUT
 } /* }}} int cdbi_read_database_query */
 
-static int cdbi_connect_database(cdbi_database_t *db) /* {{{ */
+static int cdbi_connect_database(cdbi_group_t *g) /* {{{ */
 {
+  cdbi_database_t *db = g->db;
   dbi_driver driver;
   dbi_conn connection;
   int status;
 
-  if (db->connection != NULL) {
-    status = dbi_conn_ping(db->connection);
+  if (g->connection != NULL) {
+    status = dbi_conn_ping(g->connection);
     if (status != 0) /* connection is alive */
       return 0;
 
-    dbi_conn_close(db->connection);
-    db->connection = NULL;
+    dbi_conn_close(g->connection);
+    g->connection = NULL;
   }
 
   driver = dbi_driver_open_r(db->driver, dbi_instance);
@@ -729,35 +816,36 @@ static int cdbi_connect_database(cdbi_database_t *db) /* {{{ */
     }
   }
 
-  db->connection = connection;
+  g->connection = connection;
   return 0;
 } /* }}} int cdbi_connect_database */
 
 static int cdbi_read_database(user_data_t *ud) /* {{{ */
 {
-  cdbi_database_t *db = (cdbi_database_t *)ud->data;
+  cdbi_group_t *g = (cdbi_group_t *)ud->data;
+  cdbi_database_t *db = g->db;
   int success;
   int status;
 
   unsigned int db_version;
 
-  status = cdbi_connect_database(db);
+  status = cdbi_connect_database(g);
   if (status != 0)
     return status;
-  assert(db->connection != NULL);
+  assert(g->connection != NULL);
 
-  db_version = dbi_conn_get_engine_version(db->connection);
+  db_version = dbi_conn_get_engine_version(g->connection);
   /* TODO: Complain if `db_version == 0' */
 
   success = 0;
-  for (size_t i = 0; i < db->queries_num; i++) {
+  for (size_t i = 0; i < g->queries_num; i++) {
     /* Check if we know the database's version and if so, if this query applies
      * to that version. */
     if ((db_version != 0) &&
-        (udb_query_check_version(db->queries[i], db_version) == 0))
+        (udb_query_check_version(g->queries[i], db_version) == 0))
       continue;
 
-    status = cdbi_read_database_query(db, db->queries[i], db->q_prep_areas[i]);
+    status = cdbi_read_database_query(g, g->queries[i], g->q_prep_areas[i]);
     if (status == 0)
       success++;
   }
@@ -772,13 +860,13 @@ static int cdbi_read_database(user_data_t *ud) /* {{{ */
 
 static int cdbi_shutdown(void) /* {{{ */
 {
-  for (size_t i = 0; i < databases_num; i++) {
-    if (databases[i]->connection != NULL) {
-      dbi_conn_close(databases[i]->connection);
-      databases[i]->connection = NULL;
-    }
+  for (size_t i = 0; i < groups_num; i++)
+    cdbi_group_free(groups[i]);
+  sfree(groups);
+  groups_num = 0;
+
+  for (size_t i = 0; i < databases_num; i++)
     cdbi_database_free(databases[i]);
-  }
   sfree(databases);
   databases_num = 0;
 
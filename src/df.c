@@ -46,9 +46,14 @@
 #error "No applicable input method."
 #endif
 
+#if KERNEL_LINUX
+#include <poll.h>
+#endif
+
 static const char *config_keys[] = {
-    "Device",         "MountPoint",   "FSType",         "IgnoreSelected",
-    "ReportByDevice", "ReportInodes", "ValuesAbsolute", "ValuesPercentage"};
+    "Device",         "MountPoint",     "FSType",      "IgnoreSelected",
+    "ReportByDevice", "ReportInodes",   "ValuesAbsolute", "ValuesPercentage",
+    "ReadThreads",    "Timeout"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static ignorelist_t *il_device;
@@ -60,6 +65,54 @@ static bool report_inodes;
 static bool values_absolute = true;
 static bool values_percentage;
 
+/* A selected mount point. Duplicates and ignored mount points are removed
+ * when the list of mount points is read. */
+typedef struct {
+  cu_mount_t *mnt;
+  char disk_name[256];
+} df_mount_t;
+
+/* A call of statvfs(3), done by one of the worker threads. A job that does
+ * not finish before the read's deadline is "abandoned": it is owned, and
+ * freed, by its worker from then on. */
+typedef struct df_job_s {
+  char *dir;
+  int status;
+#if HAVE_STATVFS
+  struct statvfs statbuf;
+#elif HAVE_STATFS
+  struct statfs statbuf;
+#endif
+  bool started;
+  bool done;
+  bool abandoned;
+  struct df_job_s *next;
+} df_job_t;
+
+static cu_mount_t *df_mount_list;
+static df_mount_t *df_mounts;
+static size_t df_mounts_num;
+
+#if KERNEL_LINUX
+/* poll(2) reports POLLPRI once for every change of the mount table. */
+static int df_mountinfo_fd = -1;
+#endif
+
+static int df_read_threads = 4;
+static cdtime_t df_timeout;
+
+static pthread_mutex_t df_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t df_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t df_done_cond = PTHREAD_COND_INITIALIZER;
+static df_job_t *df_queue;
+static df_job_t *df_queue_tail;
+static size_t df_pending;
+/* Jobs whose statvfs(3) has not returned in time. */
+static df_job_t *df_abandoned;
+static size_t df_abandoned_num;
+static size_t df_threads_num;
+static bool df_stop;
+
 static int df_init(void) {
   if (il_device == NULL)
     il_device = ignorelist_create(1);
@@ -122,6 +175,24 @@ static int df_config(const char *key, const char *value) {
     else
       values_percentage = false;
 
+    return 0;
+  } else if (strcasecmp(key, "ReadThreads") == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("df plugin: The \"ReadThreads\" option must not be negative.");
+      return 1;
+    }
+    df_read_threads = tmp;
+
+    return 0;
+  } else if (strcasecmp(key, "Timeout") == 0) {
+    double tmp = atof(value);
+    if (tmp <= 0.0) {
+      ERROR("df plugin: The \"Timeout\" option must be positive.");
+      return 1;
+    }
+    df_timeout = DOUBLE_TO_CDTIME_T(tmp);
+
     return 0;
   }
 
@@ -146,95 +217,151 @@ __attribute__((nonnull(2))) static void df_submit_one(char *plugin_instance,
   plugin_dispatch_values(&vl);
 } /* void df_submit_one */
 
-static int df_read(void) {
-#if HAVE_STATVFS
-  struct statvfs statbuf;
-#elif HAVE_STATFS
-  struct statfs statbuf;
+/* df_mounts_changed returns true if the mount table may have changed since
+ * the last call. */
+static bool df_mounts_changed(void) {
+#if KERNEL_LINUX
+  if (df_mountinfo_fd < 0) {
+    df_mountinfo_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    if (df_mountinfo_fd < 0) {
+      DEBUG("df plugin: open(/proc/self/mountinfo) failed: %s", STRERRNO);
+    }
+    return true;
+  }
+
+  struct pollfd pfd = {.fd = df_mountinfo_fd, .events = POLLPRI};
+  int status = poll(&pfd, 1, /* timeout = */ 0);
+  if (status < 0) {
+    WARNING("df plugin: poll(/proc/self/mountinfo) failed: %s", STRERRNO);
+    return true;
+  }
+  return status > 0;
+#else
+  return true;
 #endif
-  int retval = 0;
-  /* struct STATANYFS statbuf; */
-  cu_mount_t *mnt_list;
+} /* bool df_mounts_changed */
+
+static void df_mounts_free(void) {
+  cu_mount_freelist(df_mount_list);
+  df_mount_list = NULL;
+  sfree(df_mounts);
+  df_mounts_num = 0;
+} /* void df_mounts_free */
+
+/* df_mounts_add appends "mnt_ptr" to df_mounts unless it is ignored or a
+ * duplicate of a mount point in front of it. */
+static void df_mounts_add(cu_mount_t *mnt_ptr) {
+  cu_mount_t *dup_ptr;
+  char disk_name[256];
+
+  char const *dev =
+      (mnt_ptr->spec_device != NULL) ? mnt_ptr->spec_device : mnt_ptr->device;
+
+  if (ignorelist_match(il_device, dev))
+    return;
+  if (ignorelist_match(il_mountpoint, mnt_ptr->dir))
+    return;
+  if (ignorelist_match(il_fstype, mnt_ptr->type))
+    return;
+
+  /* search for duplicates *in front of* the current mnt_ptr. */
+  for (dup_ptr = df_mount_list; dup_ptr != NULL; dup_ptr = dup_ptr->next) {
+    /* No duplicate found: mnt_ptr is the first of its kind. */
+    if (dup_ptr == mnt_ptr) {
+      dup_ptr = NULL;
+      break;
+    }
 
-  mnt_list = NULL;
-  if (cu_mount_getlist(&mnt_list) == NULL) {
-    ERROR("df plugin: cu_mount_getlist failed.");
-    return -1;
+    /* Duplicate found: leave non-NULL dup_ptr. */
+    if (by_device && (mnt_ptr->spec_device != NULL) &&
+        (dup_ptr->spec_device != NULL) &&
+        (strcmp(mnt_ptr->spec_device, dup_ptr->spec_device) == 0))
+      break;
+    else if (!by_device && (strcmp(mnt_ptr->dir, dup_ptr->dir) == 0))
+      break;
   }
 
-  for (cu_mount_t *mnt_ptr = mnt_list; mnt_ptr != NULL;
-       mnt_ptr = mnt_ptr->next) {
-    unsigned long long blocksize;
-    char disk_name[256];
-    cu_mount_t *dup_ptr;
-    uint64_t blk_free;
-    uint64_t blk_reserved;
-    uint64_t blk_used;
+  /* ignore duplicates */
+  if (dup_ptr != NULL)
+    return;
+
+  if (by_device) {
+    /* eg, /dev/hda1  -- strip off the "/dev/" */
+    if (strncmp(dev, "/dev/", strlen("/dev/")) == 0)
+      sstrncpy(disk_name, dev + strlen("/dev/"), sizeof(disk_name));
+    else
+      sstrncpy(disk_name, dev, sizeof(disk_name));
 
-    char const *dev =
-        (mnt_ptr->spec_device != NULL) ? mnt_ptr->spec_device : mnt_ptr->device;
+    if (strlen(disk_name) < 1) {
+      DEBUG("df: no device name for mountpoint %s, skipping", mnt_ptr->dir);
+      return;
+    }
+  } else {
+    if (strcmp(mnt_ptr->dir, "/") == 0)
+      sstrncpy(disk_name, "root", sizeof(disk_name));
+    else {
+      sstrncpy(disk_name, mnt_ptr->dir + 1, sizeof(disk_name));
+      size_t len = strlen(disk_name);
+
+      for (size_t i = 0; i < len; i++)
+        if (disk_name[i] == '/')
+          disk_name[i] = '-';
+    }
+  }
 
-    if (ignorelist_match(il_device, dev))
-      continue;
-    if (ignorelist_match(il_mountpoint, mnt_ptr->dir))
-      continue;
-    if (ignorelist_match(il_fstype, mnt_ptr->type))
-      continue;
+  df_mount_t *tmp =
+      realloc(df_mounts, (df_mounts_num + 1) * sizeof(*df_mounts));
+  if (tmp == NULL) {
+    ERROR("df plugin: realloc failed.");
+    return;
+  }
+  df_mounts = tmp;
 
-    /* search for duplicates *in front of* the current mnt_ptr. */
-    for (dup_ptr = mnt_list; dup_ptr != NULL; dup_ptr = dup_ptr->next) {
-      /* No duplicate found: mnt_ptr is the first of its kind. */
-      if (dup_ptr == mnt_ptr) {
-        dup_ptr = NULL;
-        break;
-      }
+  df_mounts[df_mounts_num].mnt = mnt_ptr;
+  sstrncpy(df_mounts[df_mounts_num].disk_name, disk_name,
+           sizeof(df_mounts[df_mounts_num].disk_name));
+  df_mounts_num++;
+} /* void df_mounts_add */
 
-      /* Duplicate found: leave non-NULL dup_ptr. */
-      if (by_device && (mnt_ptr->spec_device != NULL) &&
-          (dup_ptr->spec_device != NULL) &&
-          (strcmp(mnt_ptr->spec_device, dup_ptr->spec_device) == 0))
-        break;
-      else if (!by_device && (strcmp(mnt_ptr->dir, dup_ptr->dir) == 0))
-        break;
-    }
+/* df_mounts_update re-reads the mount table if it has changed. */
+static int df_mounts_update(void) {
+  if ((df_mount_list != NULL) && !df_mounts_changed())
+    return 0;
 
-    /* ignore duplicates */
-    if (dup_ptr != NULL)
-      continue;
+  /* The change notification is armed before the table is read, so that a
+   * change in between is not missed. */
+  if (df_mount_list == NULL)
+    df_mounts_changed();
 
-    if (STATANYFS(mnt_ptr->dir, &statbuf) < 0) {
-      ERROR(STATANYFS_STR "(%s) failed: %s", mnt_ptr->dir, STRERRNO);
-      continue;
-    }
+  df_mounts_free();
+  if (cu_mount_getlist(&df_mount_list) == NULL) {
+    ERROR("df plugin: cu_mount_getlist failed.");
+    return -1;
+  }
 
-    if (!statbuf.f_blocks)
-      continue;
+  for (cu_mount_t *mnt_ptr = df_mount_list; mnt_ptr != NULL;
+       mnt_ptr = mnt_ptr->next)
+    df_mounts_add(mnt_ptr);
 
-    if (by_device) {
-      /* eg, /dev/hda1  -- strip off the "/dev/" */
-      if (strncmp(dev, "/dev/", strlen("/dev/")) == 0)
-        sstrncpy(disk_name, dev + strlen("/dev/"), sizeof(disk_name));
-      else
-        sstrncpy(disk_name, dev, sizeof(disk_name));
+  return 0;
+} /* int df_mounts_update */
 
-      if (strlen(disk_name) < 1) {
-        DEBUG("df: no device name for mountpoint %s, skipping", mnt_ptr->dir);
-        continue;
-      }
-    } else {
-      if (strcmp(mnt_ptr->dir, "/") == 0)
-        sstrncpy(disk_name, "root", sizeof(disk_name));
-      else {
-        sstrncpy(disk_name, mnt_ptr->dir + 1, sizeof(disk_name));
-        size_t len = strlen(disk_name);
-
-        for (size_t i = 0; i < len; i++)
-          if (disk_name[i] == '/')
-            disk_name[i] = '-';
-      }
-    }
+static int df_submit_statbuf(char *disk_name,
+#if HAVE_STATVFS
+                             struct statvfs *statbuf
+#elif HAVE_STATFS
+                             struct statfs *statbuf
+#endif
+) {
+  unsigned long long blocksize;
+  uint64_t blk_free;
+  uint64_t blk_reserved;
+  uint64_t blk_used;
 
-    blocksize = BLOCKSIZE(statbuf);
+  if (!statbuf->f_blocks)
+    return 0;
+
+  blocksize = BLOCKSIZE(*statbuf);
 
 /*
  * Sanity-check for the values in the struct
@@ -243,98 +370,320 @@ static int df_read(void) {
  * report negative free space for user. Notice. blk_reserved
  * will start to diminish after this. */
 #if HAVE_STATVFS
-    /* Cast and temporary variable are needed to avoid
-     * compiler warnings.
-     * ((struct statvfs).f_bavail is unsigned (POSIX)) */
-    int64_t signed_bavail = (int64_t)statbuf.f_bavail;
-    if (signed_bavail < 0)
-      statbuf.f_bavail = 0;
+  /* Cast and temporary variable are needed to avoid
+   * compiler warnings.
+   * ((struct statvfs).f_bavail is unsigned (POSIX)) */
+  int64_t signed_bavail = (int64_t)statbuf->f_bavail;
+  if (signed_bavail < 0)
+    statbuf->f_bavail = 0;
 #elif HAVE_STATFS
-    if (statbuf.f_bavail < 0)
-      statbuf.f_bavail = 0;
+  if (statbuf->f_bavail < 0)
+    statbuf->f_bavail = 0;
 #endif
-    /* Make sure that f_blocks >= f_bfree >= f_bavail */
-    if (statbuf.f_bfree < statbuf.f_bavail)
-      statbuf.f_bfree = statbuf.f_bavail;
-    if (statbuf.f_blocks < statbuf.f_bfree)
-      statbuf.f_blocks = statbuf.f_bfree;
-
-    blk_free = (uint64_t)statbuf.f_bavail;
-    blk_reserved = (uint64_t)(statbuf.f_bfree - statbuf.f_bavail);
-    blk_used = (uint64_t)(statbuf.f_blocks - statbuf.f_bfree);
+  /* Make sure that f_blocks >= f_bfree >= f_bavail */
+  if (statbuf->f_bfree < statbuf->f_bavail)
+    statbuf->f_bfree = statbuf->f_bavail;
+  if (statbuf->f_blocks < statbuf->f_bfree)
+    statbuf->f_blocks = statbuf->f_bfree;
+
+  blk_free = (uint64_t)statbuf->f_bavail;
+  blk_reserved = (uint64_t)(statbuf->f_bfree - statbuf->f_bavail);
+  blk_used = (uint64_t)(statbuf->f_blocks - statbuf->f_bfree);
+
+  if (values_absolute) {
+    df_submit_one(disk_name, "df_complex", "free",
+                  (gauge_t)(blk_free * blocksize));
+    df_submit_one(disk_name, "df_complex", "reserved",
+                  (gauge_t)(blk_reserved * blocksize));
+    df_submit_one(disk_name, "df_complex", "used",
+                  (gauge_t)(blk_used * blocksize));
+  }
 
-    if (values_absolute) {
-      df_submit_one(disk_name, "df_complex", "free",
-                    (gauge_t)(blk_free * blocksize));
-      df_submit_one(disk_name, "df_complex", "reserved",
-                    (gauge_t)(blk_reserved * blocksize));
-      df_submit_one(disk_name, "df_complex", "used",
-                    (gauge_t)(blk_used * blocksize));
+  if (values_percentage) {
+    if (statbuf->f_blocks > 0) {
+      df_submit_one(disk_name, "percent_bytes", "free",
+                    (gauge_t)((float_t)(blk_free) / statbuf->f_blocks * 100));
+      df_submit_one(
+          disk_name, "percent_bytes", "reserved",
+          (gauge_t)((float_t)(blk_reserved) / statbuf->f_blocks * 100));
+      df_submit_one(disk_name, "percent_bytes", "used",
+                    (gauge_t)((float_t)(blk_used) / statbuf->f_blocks * 100));
+    } else {
+      return -1;
     }
+  }
+
+  /* inode handling */
+  if (report_inodes && statbuf->f_files != 0 && statbuf->f_ffree != 0) {
+    uint64_t inode_free;
+    uint64_t inode_reserved;
+    uint64_t inode_used;
+
+    /* Sanity-check for the values in the struct */
+    if (statbuf->f_ffree < statbuf->f_favail)
+      statbuf->f_ffree = statbuf->f_favail;
+    if (statbuf->f_files < statbuf->f_ffree)
+      statbuf->f_files = statbuf->f_ffree;
+
+    inode_free = (uint64_t)statbuf->f_favail;
+    inode_reserved = (uint64_t)(statbuf->f_ffree - statbuf->f_favail);
+    inode_used = (uint64_t)(statbuf->f_files - statbuf->f_ffree);
 
     if (values_percentage) {
-      if (statbuf.f_blocks > 0) {
-        df_submit_one(disk_name, "percent_bytes", "free",
-                      (gauge_t)((float_t)(blk_free) / statbuf.f_blocks * 100));
+      if (statbuf->f_files > 0) {
+        df_submit_one(
+            disk_name, "percent_inodes", "free",
+            (gauge_t)((float_t)(inode_free) / statbuf->f_files * 100));
         df_submit_one(
-            disk_name, "percent_bytes", "reserved",
-            (gauge_t)((float_t)(blk_reserved) / statbuf.f_blocks * 100));
-        df_submit_one(disk_name, "percent_bytes", "used",
-                      (gauge_t)((float_t)(blk_used) / statbuf.f_blocks * 100));
+            disk_name, "percent_inodes", "reserved",
+            (gauge_t)((float_t)(inode_reserved) / statbuf->f_files * 100));
+        df_submit_one(
+            disk_name, "percent_inodes", "used",
+            (gauge_t)((float_t)(inode_used) / statbuf->f_files * 100));
       } else {
-        retval = -1;
-        break;
+        return -1;
       }
     }
+    if (values_absolute) {
+      df_submit_one(disk_name, "df_inodes", "free", (gauge_t)inode_free);
+      df_submit_one(disk_name, "df_inodes", "reserved",
+                    (gauge_t)inode_reserved);
+      df_submit_one(disk_name, "df_inodes", "used", (gauge_t)inode_used);
+    }
+  }
 
-    /* inode handling */
-    if (report_inodes && statbuf.f_files != 0 && statbuf.f_ffree != 0) {
-      uint64_t inode_free;
-      uint64_t inode_reserved;
-      uint64_t inode_used;
-
-      /* Sanity-check for the values in the struct */
-      if (statbuf.f_ffree < statbuf.f_favail)
-        statbuf.f_ffree = statbuf.f_favail;
-      if (statbuf.f_files < statbuf.f_ffree)
-        statbuf.f_files = statbuf.f_ffree;
-
-      inode_free = (uint64_t)statbuf.f_favail;
-      inode_reserved = (uint64_t)(statbuf.f_ffree - statbuf.f_favail);
-      inode_used = (uint64_t)(statbuf.f_files - statbuf.f_ffree);
-
-      if (values_percentage) {
-        if (statbuf.f_files > 0) {
-          df_submit_one(
-              disk_name, "percent_inodes", "free",
-              (gauge_t)((float_t)(inode_free) / statbuf.f_files * 100));
-          df_submit_one(
-              disk_name, "percent_inodes", "reserved",
-              (gauge_t)((float_t)(inode_reserved) / statbuf.f_files * 100));
-          df_submit_one(
-              disk_name, "percent_inodes", "used",
-              (gauge_t)((float_t)(inode_used) / statbuf.f_files * 100));
-        } else {
-          retval = -1;
-          break;
-        }
-      }
-      if (values_absolute) {
-        df_submit_one(disk_name, "df_inodes", "free", (gauge_t)inode_free);
-        df_submit_one(disk_name, "df_inodes", "reserved",
-                      (gauge_t)inode_reserved);
-        df_submit_one(disk_name, "df_inodes", "used", (gauge_t)inode_used);
+  return 0;
+} /* int df_submit_statbuf */
+
+static void df_job_free(df_job_t *job) {
+  if (job == NULL)
+    return;
+  sfree(job->dir);
+  sfree(job);
+} /* void df_job_free */
+
+static void df_job_run(df_job_t *job) {
+  job->status = 0;
+  if (STATANYFS(job->dir, &job->statbuf) < 0)
+    job->status = errno;
+} /* void df_job_run */
+
+static void *df_worker(void __attribute__((unused)) * arg) {
+  pthread_mutex_lock(&df_lock);
+  while (!df_stop) {
+    if (df_queue == NULL) {
+      pthread_cond_wait(&df_work_cond, &df_lock);
+      continue;
+    }
+
+    df_job_t *job = df_queue;
+    df_queue = job->next;
+    if (df_queue == NULL)
+      df_queue_tail = NULL;
+    job->next = NULL;
+    job->started = true;
+
+    pthread_mutex_unlock(&df_lock);
+    df_job_run(job);
+    pthread_mutex_lock(&df_lock);
+
+    job->done = true;
+    if (!job->abandoned) {
+      df_pending--;
+      if (df_pending == 0)
+        pthread_cond_signal(&df_done_cond);
+      continue;
+    }
+
+    /* A replacement has been started in the meantime. */
+    for (df_job_t **ptr = &df_abandoned; *ptr != NULL; ptr = &(*ptr)->next) {
+      if (*ptr == job) {
+        *ptr = job->next;
+        break;
       }
     }
+    df_abandoned_num--;
+    INFO("df plugin: " STATANYFS_STR "(%s) has returned.", job->dir);
+    df_job_free(job);
+
+    if (df_threads_num > (size_t)df_read_threads + df_abandoned_num)
+      break;
+  }
+
+  df_threads_num--;
+  pthread_cond_broadcast(&df_done_cond);
+  pthread_mutex_unlock(&df_lock);
+  return NULL;
+} /* void *df_worker */
+
+/* df_start_threads makes sure that "ReadThreads" workers are not blocked by an
+ * abandoned job. Must hold df_lock when calling. */
+static void df_start_threads(void) {
+  while (df_threads_num < (size_t)df_read_threads + df_abandoned_num) {
+    pthread_t thread;
+    int status = plugin_thread_create(&thread, NULL, df_worker,
+                                      /* arg = */ NULL, "df statvfs");
+    if (status != 0) {
+      ERROR("df plugin: plugin_thread_create failed: %s", STRERROR(status));
+      break;
+    }
+    pthread_detach(thread);
+    df_threads_num++;
   }
+} /* void df_start_threads */
+
+static bool df_is_abandoned(char const *dir) {
+  for (df_job_t *job = df_abandoned; job != NULL; job = job->next)
+    if (strcmp(job->dir, dir) == 0)
+      return true;
+  return false;
+} /* bool df_is_abandoned */
+
+/* df_run_jobs hands "jobs" to the workers and waits until either all of them
+ * are done or the timeout has passed. Jobs that are not done by then are set
+ * to NULL. */
+static void df_run_jobs(df_job_t **jobs, size_t jobs_num) {
+  cdtime_t timeout = df_timeout;
+  if (timeout == 0)
+    timeout = plugin_get_interval() / 2;
+
+  pthread_mutex_lock(&df_lock);
+  df_start_threads();
+
+  for (size_t i = 0; i < jobs_num; i++) {
+    if (jobs[i] == NULL)
+      continue;
+
+    /* Don't block another worker on a file system that is still hanging. */
+    if (df_is_abandoned(jobs[i]->dir)) {
+      DEBUG("df plugin: Skipping %s, " STATANYFS_STR " has not returned yet.",
+            jobs[i]->dir);
+      df_job_free(jobs[i]);
+      jobs[i] = NULL;
+      continue;
+    }
 
-  cu_mount_freelist(mnt_list);
+    if (df_queue_tail == NULL)
+      df_queue = jobs[i];
+    else
+      df_queue_tail->next = jobs[i];
+    df_queue_tail = jobs[i];
+    df_pending++;
+  }
+  pthread_cond_broadcast(&df_work_cond);
+
+  struct timespec deadline = CDTIME_T_TO_TIMESPEC(cdtime() + timeout);
+  while (df_pending > 0) {
+    if (pthread_cond_timedwait(&df_done_cond, &df_lock, &deadline) ==
+        ETIMEDOUT)
+      break;
+  }
+
+  for (size_t i = 0; i < jobs_num; i++) {
+    if ((jobs[i] == NULL) || jobs[i]->done)
+      continue;
+
+    if (!jobs[i]->started) {
+      WARNING("df plugin: No thread has been available for " STATANYFS_STR
+              "(%s) within %.3f seconds.",
+              jobs[i]->dir, CDTIME_T_TO_DOUBLE(timeout));
+      df_job_free(jobs[i]);
+    } else {
+      WARNING("df plugin: " STATANYFS_STR "(%s) did not return within %.3f "
+              "seconds. Skipping it until it does.",
+              jobs[i]->dir, CDTIME_T_TO_DOUBLE(timeout));
+      jobs[i]->abandoned = true;
+      jobs[i]->next = df_abandoned;
+      df_abandoned = jobs[i];
+      df_abandoned_num++;
+    }
+    jobs[i] = NULL;
+  }
+
+  /* Only jobs of this read can be queued. */
+  df_queue = NULL;
+  df_queue_tail = NULL;
+  df_pending = 0;
+
+  /* Replace the workers that are blocked now. */
+  df_start_threads();
+  pthread_mutex_unlock(&df_lock);
+} /* void df_run_jobs */
+
+static int df_read(void) {
+  int retval = 0;
+
+  if (df_mounts_update() != 0)
+    return -1;
+
+  if (df_mounts_num == 0)
+    return 0;
+
+  df_job_t **jobs = calloc(df_mounts_num, sizeof(*jobs));
+  if (jobs == NULL) {
+    ERROR("df plugin: calloc failed.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < df_mounts_num; i++) {
+    jobs[i] = calloc(1, sizeof(*jobs[i]));
+    if (jobs[i] != NULL)
+      jobs[i]->dir = strdup(df_mounts[i].mnt->dir);
+    if ((jobs[i] == NULL) || (jobs[i]->dir == NULL)) {
+      ERROR("df plugin: Allocating a job failed.");
+      df_job_free(jobs[i]);
+      jobs[i] = NULL;
+    }
+  }
+
+  if (df_read_threads > 0) {
+    df_run_jobs(jobs, df_mounts_num);
+  } else {
+    for (size_t i = 0; i < df_mounts_num; i++)
+      if (jobs[i] != NULL)
+        df_job_run(jobs[i]);
+  }
+
+  for (size_t i = 0; i < df_mounts_num; i++) {
+    if (jobs[i] == NULL)
+      continue;
+
+    if (jobs[i]->status != 0)
+      ERROR(STATANYFS_STR "(%s) failed: %s", jobs[i]->dir,
+            STRERROR(jobs[i]->status));
+    else if (df_submit_statbuf(df_mounts[i].disk_name, &jobs[i]->statbuf) != 0)
+      retval = -1;
+
+    df_job_free(jobs[i]);
+  }
+  sfree(jobs);
 
   return retval;
 } /* int df_read */
 
+static int df_shutdown(void) {
+  pthread_mutex_lock(&df_lock);
+  df_stop = true;
+  pthread_cond_broadcast(&df_work_cond);
+  /* Workers blocked in statvfs(3) cannot be waited for. They only access the
+   * job they own and the static synchronization primitives. */
+  while (df_threads_num > df_abandoned_num)
+    pthread_cond_wait(&df_done_cond, &df_lock);
+  pthread_mutex_unlock(&df_lock);
+
+  df_mounts_free();
+#if KERNEL_LINUX
+  if (df_mountinfo_fd >= 0)
+    close(df_mountinfo_fd);
+  df_mountinfo_fd = -1;
+#endif
+
+  return 0;
+} /* int df_shutdown */
+
 void module_register(void) {
   plugin_register_config("df", df_config, config_keys, config_keys_num);
   plugin_register_init("df", df_init);
   plugin_register_read("df", df_read);
+  plugin_register_shutdown("df", df_shutdown);
 } /* void module_register */
@@ -86,8 +86,18 @@ static bool use_bsd_name;
 /* #endif HAVE_IOKIT_IOKITLIB_H */
 
 #elif KERNEL_LINUX
+#include "utils/avltree/avltree.h"
+#include "utils/procfs/procfs.h"
+
 typedef struct diskstats {
   char *name;
+  /* The device number, major << 32 | minor. Key of `disk_index'. */
+  uint64_t dev;
+
+  /* The name from `UdevNameAttr', valid if `alt_name_resolved' is set. NULL if
+   * the device has no such property. */
+  char *alt_name;
+  bool alt_name_resolved;
 
   /* This overflows in roughly 1361 years */
   unsigned int poll_count;
@@ -114,6 +124,9 @@ typedef struct diskstats {
 } diskstats_t;
 
 static diskstats_t *disklist;
+/* Maps the device number to the disk's entry in `disklist'. */
+static c_avl_tree_t *disk_index;
+static procfs_file_t *proc_diskstats;
 /* #endif KERNEL_LINUX */
 #elif KERNEL_FREEBSD
 static struct gmesh geom_tree;
@@ -144,9 +157,18 @@ static int pnumdisk;
 
 #if HAVE_LIBUDEV_H
 #include <libudev.h>
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
 
 static char *conf_udev_name_attr;
 static struct udev *handle_udev;
+#if KERNEL_LINUX
+/* Reports added, changed and removed block devices, so that resolved names are
+ * only looked up again when they may have changed. Without it, names are
+ * resolved on every read. */
+static struct udev_monitor *udev_monitor;
+#endif
 #endif
 
 static const char *config_keys[] = {"Disk", "UseBSDName", "IgnoreSelected",
@@ -194,6 +216,28 @@ static int disk_config(const char *key, const char *value) {
   return 0;
 } /* int disk_config */
 
+#if KERNEL_LINUX
+static int disk_dev_compare(void const *a, void const *b) {
+  uint64_t dev_a = *((uint64_t const *)a);
+  uint64_t dev_b = *((uint64_t const *)b);
+
+  if (dev_a < dev_b)
+    return -1;
+  else if (dev_a > dev_b)
+    return 1;
+  return 0;
+} /* int disk_dev_compare */
+
+static void disk_free(diskstats_t *ds) {
+  if (ds == NULL)
+    return;
+
+  free(ds->name);
+  free(ds->alt_name);
+  free(ds);
+} /* void disk_free */
+#endif /* KERNEL_LINUX */
+
 static int disk_init(void) {
 #if HAVE_IOKIT_IOKITLIB_H
   kern_return_t status;
@@ -219,8 +263,28 @@ static int disk_init(void) {
       ERROR("disk plugin: udev_new() failed!");
       return -1;
     }
+
+    udev_monitor = udev_monitor_new_from_netlink(handle_udev, "udev");
+    if ((udev_monitor == NULL) ||
+        (udev_monitor_filter_add_match_subsystem_devtype(udev_monitor, "block",
+                                                         NULL) < 0) ||
+        (udev_monitor_enable_receiving(udev_monitor) < 0)) {
+      NOTICE("disk plugin: Monitoring udev events failed. The names of "
+             "\"UdevNameAttr\" will be looked up on every read.");
+      if (udev_monitor != NULL)
+        udev_monitor_unref(udev_monitor);
+      udev_monitor = NULL;
+    }
   }
 #endif /* HAVE_LIBUDEV_H */
+
+  if (disk_index == NULL) {
+    disk_index = c_avl_create(disk_dev_compare);
+    if (disk_index == NULL) {
+      ERROR("disk plugin: c_avl_create failed.");
+      return -1;
+    }
+  }
 /* #endif KERNEL_LINUX */
 
 #elif KERNEL_FREEBSD
@@ -263,9 +327,24 @@ static int disk_init(void) {
 
 static int disk_shutdown(void) {
 #if KERNEL_LINUX
+  procfs_close(proc_diskstats);
+  proc_diskstats = NULL;
+
+  while (disklist != NULL) {
+    diskstats_t *next = disklist->next;
+    disk_free(disklist);
+    disklist = next;
+  }
+  c_avl_destroy(disk_index);
+  disk_index = NULL;
+
 #if HAVE_LIBUDEV_H
+  if (udev_monitor != NULL)
+    udev_monitor_unref(udev_monitor);
+  udev_monitor = NULL;
   if (handle_udev != NULL)
     udev_unref(handle_udev);
+  handle_udev = NULL;
 #endif /* HAVE_LIBUDEV_H */
 #endif /* KERNEL_LINUX */
   return 0;
@@ -353,6 +432,29 @@ static char *disk_udev_attr_name(struct udev *udev, char *disk_name,
   }
   return output;
 }
+
+#if KERNEL_LINUX
+/* Forgets the resolved names of the devices udev has reported events for since
+ * the last read. */
+static void disk_udev_invalidate(void) {
+  struct udev_device *dev;
+
+  /* The monitor's socket is non-blocking. */
+  while ((dev = udev_monitor_receive_device(udev_monitor)) != NULL) {
+    dev_t devnum = udev_device_get_devnum(dev);
+    uint64_t key =
+        (((uint64_t)major(devnum)) << 32) | ((uint64_t)minor(devnum));
+    diskstats_t *ds = NULL;
+
+    if (c_avl_get(disk_index, &key, (void *)&ds) == 0) {
+      DEBUG("disk plugin: udev event \"%s\" for %s.",
+            udev_device_get_action(dev), ds->name);
+      ds->alt_name_resolved = false;
+    }
+    udev_device_unref(dev);
+  }
+} /* void disk_udev_invalidate */
+#endif /* KERNEL_LINUX */
 #endif
 
 #if HAVE_IOKIT_IOKITLIB_H
@@ -658,8 +760,7 @@ static int disk_read(void) {
   geom_stats_snapshot_free(snap);
 
 #elif KERNEL_LINUX
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
 
   char *fields[32];
   static unsigned int poll_count = 0;
@@ -680,13 +781,26 @@ static int disk_read(void) {
 
   diskstats_t *ds, *pre_ds;
 
-  if ((fh = fopen("/proc/diskstats", "r")) == NULL) {
-    ERROR("disk plugin: fopen(\"/proc/diskstats\"): %s", STRERRNO);
+  if ((proc_diskstats == NULL) &&
+      ((proc_diskstats = procfs_open("/proc/diskstats")) == NULL)) {
+    ERROR("disk plugin: open(\"/proc/diskstats\"): %s", STRERRNO);
     return -1;
   }
 
+  int status = procfs_read(proc_diskstats);
+  if (status != 0) {
+    ERROR("disk plugin: reading \"/proc/diskstats\" failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+
+#if HAVE_LIBUDEV_H
+  if (udev_monitor != NULL)
+    disk_udev_invalidate();
+#endif
+
   poll_count++;
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while ((buffer = procfs_next_line(proc_diskstats)) != NULL) {
     int numfields = strsplit(buffer, fields, 32);
 
     /* need either 7 fields (partition) or at least 14 fields */
@@ -694,11 +808,18 @@ static int disk_read(void) {
       continue;
 
     char *disk_name = fields[2];
+    uint64_t dev = (((uint64_t)strtoul(fields[0], NULL, 10)) << 32) |
+                   ((uint64_t)strtoul(fields[1], NULL, 10));
 
-    for (ds = disklist, pre_ds = disklist; ds != NULL;
-         pre_ds = ds, ds = ds->next)
-      if (strcmp(disk_name, ds->name) == 0)
-        break;
+    ds = NULL;
+    c_avl_get(disk_index, &dev, (void *)&ds);
+
+    /* The device number has been reused for another device. Its entry is
+     * removed below, once it has not been seen in this read. */
+    if ((ds != NULL) && (strcmp(disk_name, ds->name) != 0)) {
+      c_avl_remove(disk_index, &dev, NULL, NULL);
+      ds = NULL;
+    }
 
     if (ds == NULL) {
       if ((ds = calloc(1, sizeof(*ds))) == NULL)
@@ -708,11 +829,16 @@ static int disk_read(void) {
         free(ds);
         continue;
       }
+      ds->dev = dev;
 
-      if (pre_ds == NULL)
-        disklist = ds;
-      else
-        pre_ds->next = ds;
+      if (c_avl_insert(disk_index, &ds->dev, ds) != 0) {
+        ERROR("disk plugin: c_avl_insert failed.");
+        disk_free(ds);
+        continue;
+      }
+
+      ds->next = disklist;
+      disklist = ds;
     }
 
     is_disk = 0;
@@ -831,22 +957,21 @@ static int disk_read(void) {
     char *output_name = disk_name;
 
 #if HAVE_LIBUDEV_H
-    char *alt_name = NULL;
     if (conf_udev_name_attr != NULL) {
-      alt_name =
-          disk_udev_attr_name(handle_udev, disk_name, conf_udev_name_attr);
-      if (alt_name != NULL)
-        output_name = alt_name;
+      if (!ds->alt_name_resolved) {
+        sfree(ds->alt_name);
+        ds->alt_name =
+            disk_udev_attr_name(handle_udev, disk_name, conf_udev_name_attr);
+        /* Without the monitor, the name is looked up again next time. */
+        ds->alt_name_resolved = (udev_monitor != NULL);
+      }
+      if (ds->alt_name != NULL)
+        output_name = ds->alt_name;
     }
 #endif
 
-    if (ignorelist_match(ignorelist, output_name) != 0) {
-#if HAVE_LIBUDEV_H
-      /* release udev-based alternate name, if allocated */
-      sfree(alt_name);
-#endif
+    if (ignorelist_match(ignorelist, output_name) != 0)
       continue;
-    }
 
     if ((ds->read_bytes != 0) || (ds->write_bytes != 0))
       disk_submit(output_name, "disk_octets", ds->read_bytes, ds->write_bytes);
@@ -866,12 +991,7 @@ static int disk_read(void) {
       if (ds->has_io_time)
         submit_io_time(output_name, io_time, weighted_time);
     } /* if (is_disk) */
-
-#if HAVE_LIBUDEV_H
-    /* release udev-based alternate name, if allocated */
-    sfree(alt_name);
-#endif
-  } /* while (fgets (buffer, sizeof (buffer), fh) != NULL) */
+  } /* while ((buffer = procfs_next_line(proc_diskstats)) != NULL) */
 
   /* Remove disks that have disappeared from diskstats */
   for (ds = disklist, pre_ds = disklist; ds != NULL;) {
@@ -892,10 +1012,14 @@ static int disk_read(void) {
     ds = ds->next;
 
     DEBUG("disk plugin: Disk %s disappeared.", missing_ds->name);
-    free(missing_ds->name);
-    free(missing_ds);
+    /* Only remove the index entry if it still points to this disk, see
+     * above. */
+    diskstats_t *indexed = NULL;
+    if ((c_avl_get(disk_index, &missing_ds->dev, (void *)&indexed) == 0) &&
+        (indexed == missing_ds))
+      c_avl_remove(disk_index, &missing_ds->dev, NULL, NULL);
+    disk_free(missing_ds);
   }
-  fclose(fh);
 /* #endif defined(KERNEL_LINUX) */
 
 #elif HAVE_LIBKSTAT
@@ -38,93 +38,78 @@
 #include <sys/capability.h>
 #endif
 
-/*
- * Private data types
- */
-struct counter_list_s {
-  unsigned int key;
-  unsigned int value;
-  struct counter_list_s *next;
+#if KERNEL_LINUX
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#ifdef TPACKET3_HDRLEN
+#define DNS_HAVE_PACKET_RING 1
+#endif
+#endif
+
+#if DNS_HAVE_PACKET_RING
+/* The ring of one capture thread: `DNS_RING_BLOCK_NUM' blocks that the kernel
+ * fills with packets and hands over to the thread one at a time. */
+struct dns_ring_s {
+  int fd;
+  uint8_t *map;
+  size_t map_size;
+  pthread_t thread;
 };
-typedef struct counter_list_s counter_list_t;
+typedef struct dns_ring_s dns_ring_t;
+
+#define DNS_RING_BLOCK_SIZE (1 << 20)
+#define DNS_RING_BLOCK_NUM 8
+#define DNS_RING_FRAME_SIZE 2048
+/* A block is handed over after this many milliseconds even if it isn't full,
+ * so that quiet interfaces are counted, too. */
+#define DNS_RING_BLOCK_TIMEOUT 100
+#endif /* DNS_HAVE_PACKET_RING */
 
 /*
  * Private variables
  */
 static const char *config_keys[] = {"Interface", "IgnoreSource",
-                                    "SelectNumericQueryTypes"};
+                                    "SelectNumericQueryTypes",
+                                    "CaptureThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 static int select_numeric_qtype = 1;
 
 #define PCAP_SNAPLEN 1460
 static char *pcap_device;
 
+/* The counters are updated by the capture threads with atomic operations and
+ * indexed by the field of the DNS header they count; opcode and rcode are
+ * four bits wide. */
 static derive_t tr_queries;
 static derive_t tr_responses;
-static counter_list_t *qtype_list;
-static counter_list_t *opcode_list;
-static counter_list_t *rcode_list;
+static derive_t qtype_counts[T_MAX];
+static derive_t opcode_counts[16];
+static derive_t rcode_counts[16];
 
 static pthread_t listen_thread;
 static int listen_thread_init;
-/* The `traffic' mutex if for `tr_queries' and `tr_responses' */
-static pthread_mutex_t traffic_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t qtype_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t opcode_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t rcode_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#if DNS_HAVE_PACKET_RING
+static int capture_threads;
+static dns_ring_t *rings;
+static size_t rings_num;
+static bool capture_loop;
+#endif
 
 /*
  * Private functions
  */
-static counter_list_t *counter_list_search(counter_list_t **list,
-                                           unsigned int key) {
-  counter_list_t *entry;
-
-  for (entry = *list; entry != NULL; entry = entry->next)
-    if (entry->key == key)
-      break;
-
-  return entry;
+static void counter_add(derive_t *counter, derive_t increment) {
+  __atomic_fetch_add(counter, increment, __ATOMIC_RELAXED);
 }
 
-static counter_list_t *counter_list_create(counter_list_t **list,
-                                           unsigned int key,
-                                           unsigned int value) {
-  counter_list_t *entry;
-
-  entry = calloc(1, sizeof(*entry));
-  if (entry == NULL)
-    return NULL;
-
-  entry->key = key;
-  entry->value = value;
-
-  if (*list == NULL) {
-    *list = entry;
-  } else {
-    counter_list_t *last;
-
-    last = *list;
-    while (last->next != NULL)
-      last = last->next;
-
-    last->next = entry;
-  }
-
-  return entry;
-}
-
-static void counter_list_add(counter_list_t **list, unsigned int key,
-                             unsigned int increment) {
-  counter_list_t *entry;
-
-  entry = counter_list_search(list, key);
-
-  if (entry != NULL) {
-    entry->value += increment;
-  } else {
-    counter_list_create(list, key, increment);
-  }
+static derive_t counter_get(derive_t const *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
 }
 
 static int dns_config(const char *key, const char *value) {
@@ -141,6 +126,18 @@ static int dns_config(const char *key, const char *value) {
       select_numeric_qtype = 0;
     else
       select_numeric_qtype = 1;
+  } else if (strcasecmp(key, "CaptureThreads") == 0) {
+#if DNS_HAVE_PACKET_RING
+    capture_threads = atoi(value);
+    if (capture_threads < 0) {
+      ERROR("dns plugin: CaptureThreads must not be negative.");
+      capture_threads = 0;
+      return 1;
+    }
+#else
+    WARNING("dns plugin: CaptureThreads is only supported on Linux. Packets "
+            "are captured with libpcap.");
+#endif
   } else {
     return -1;
   }
@@ -148,40 +145,21 @@ static int dns_config(const char *key, const char *value) {
   return 0;
 }
 
+/* Called by the capture threads. Numeric query types are filtered when the
+ * counters are read, as qtype_str() is not thread-safe. */
 static void dns_child_callback(const rfc1035_header_t *dns) {
   if (dns->qr == 0) {
     /* This is a query */
-    int skip = 0;
-    if (!select_numeric_qtype) {
-      const char *str = qtype_str(dns->qtype);
-      if ((str == NULL) || (str[0] == '#'))
-        skip = 1;
-    }
-
-    pthread_mutex_lock(&traffic_mutex);
-    tr_queries += dns->length;
-    pthread_mutex_unlock(&traffic_mutex);
-
-    if (skip == 0) {
-      pthread_mutex_lock(&qtype_mutex);
-      counter_list_add(&qtype_list, dns->qtype, 1);
-      pthread_mutex_unlock(&qtype_mutex);
-    }
+    counter_add(&tr_queries, dns->length);
+    counter_add(&qtype_counts[dns->qtype], 1);
   } else {
     /* This is a reply */
-    pthread_mutex_lock(&traffic_mutex);
-    tr_responses += dns->length;
-    pthread_mutex_unlock(&traffic_mutex);
-
-    pthread_mutex_lock(&rcode_mutex);
-    counter_list_add(&rcode_list, dns->rcode, 1);
-    pthread_mutex_unlock(&rcode_mutex);
+    counter_add(&tr_responses, dns->length);
+    counter_add(&rcode_counts[dns->rcode], 1);
   }
 
   /* FIXME: Are queries, replies or both interesting? */
-  pthread_mutex_lock(&opcode_mutex);
-  counter_list_add(&opcode_list, dns->opcode, 1);
-  pthread_mutex_unlock(&opcode_mutex);
+  counter_add(&opcode_counts[dns->opcode], 1);
 }
 
 static int dns_run_pcap_loop(void) {
@@ -226,7 +204,6 @@ static int dns_run_pcap_loop(void) {
   DEBUG("dns plugin: PCAP object created.");
 
   dnstop_set_pcap_obj(pcap_obj);
-  dnstop_set_callback(dns_child_callback);
 
   status = pcap_loop(pcap_obj, -1 /* loop forever */,
                      handle_pcap /* callback */, NULL /* user data */);
@@ -272,18 +249,241 @@ static void *dns_child_loop(__attribute__((unused)) void *dummy) /* {{{ */
   return NULL;
 } /* }}} void *dns_child_loop */
 
+#if DNS_HAVE_PACKET_RING
+/* Compiles the capture filter for packets that start with the IP header, as
+ * the packet sockets see them. The filter also cuts the packets to
+ * PCAP_SNAPLEN bytes. */
+static int dns_ring_filter(struct bpf_program *fp) /* {{{ */
+{
+  pcap_t *pcap_obj = pcap_open_dead(DLT_RAW, PCAP_SNAPLEN);
+  if (pcap_obj == NULL)
+    return -1;
+
+  int status = pcap_compile(pcap_obj, fp, "udp port 53", 1,
+                            PCAP_NETMASK_UNKNOWN);
+  if (status < 0)
+    ERROR("dns plugin: pcap_compile failed: %s", pcap_geterr(pcap_obj));
+
+  pcap_close(pcap_obj);
+  return status;
+} /* }}} int dns_ring_filter */
+
+static void dns_ring_close(dns_ring_t *r) /* {{{ */
+{
+  if ((r->map != NULL) && (r->map != MAP_FAILED))
+    munmap(r->map, r->map_size);
+  r->map = NULL;
+  if (r->fd >= 0)
+    close(r->fd);
+  r->fd = -1;
+} /* }}} void dns_ring_close */
+
+/* Opens a packet socket with a TPACKET_V3 ring. With several threads, the
+ * sockets join the fanout group `fanout_id', which spreads the packets over
+ * them by flow. */
+static int dns_ring_open(dns_ring_t *r, int ifindex, /* {{{ */
+                         struct sock_fprog *filter, int fanout_id) {
+  r->fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_ALL));
+  if (r->fd < 0) {
+    ERROR("dns plugin: socket(AF_PACKET) failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* Filter before binding, so no other packets are queued. */
+  if (setsockopt(r->fd, SOL_SOCKET, SO_ATTACH_FILTER, filter,
+                 sizeof(*filter)) != 0) {
+    ERROR("dns plugin: Attaching the capture filter failed: %s", STRERRNO);
+    dns_ring_close(r);
+    return -1;
+  }
+
+  int version = TPACKET_V3;
+  if (setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &version,
+                 sizeof(version)) != 0) {
+    ERROR("dns plugin: Setting TPACKET_V3 failed: %s", STRERRNO);
+    dns_ring_close(r);
+    return -1;
+  }
+
+  struct tpacket_req3 req = {
+      .tp_block_size = DNS_RING_BLOCK_SIZE,
+      .tp_block_nr = DNS_RING_BLOCK_NUM,
+      .tp_frame_size = DNS_RING_FRAME_SIZE,
+      .tp_frame_nr =
+          (DNS_RING_BLOCK_SIZE / DNS_RING_FRAME_SIZE) * DNS_RING_BLOCK_NUM,
+      .tp_retire_blk_tov = DNS_RING_BLOCK_TIMEOUT,
+  };
+  if (setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+    ERROR("dns plugin: Setting up the packet ring failed: %s", STRERRNO);
+    dns_ring_close(r);
+    return -1;
+  }
+
+  r->map_size = (size_t)req.tp_block_size * req.tp_block_nr;
+  r->map = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd,
+                0);
+  if (r->map == MAP_FAILED) {
+    ERROR("dns plugin: Mapping the packet ring failed: %s", STRERRNO);
+    dns_ring_close(r);
+    return -1;
+  }
+
+  struct sockaddr_ll sll = {
+      .sll_family = AF_PACKET,
+      .sll_protocol = htons(ETH_P_ALL),
+      .sll_ifindex = ifindex,
+  };
+  if (bind(r->fd, (struct sockaddr *)&sll, sizeof(sll)) != 0) {
+    ERROR("dns plugin: Binding the packet socket failed: %s", STRERRNO);
+    dns_ring_close(r);
+    return -1;
+  }
+
+  if (fanout_id >= 0) {
+    int fanout = fanout_id | (PACKET_FANOUT_HASH << 16);
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_FANOUT, &fanout,
+                   sizeof(fanout)) != 0) {
+      ERROR("dns plugin: Joining the fanout group failed: %s", STRERRNO);
+      dns_ring_close(r);
+      return -1;
+    }
+  }
+
+  return 0;
+} /* }}} int dns_ring_open */
+
+static void *dns_ring_loop(void *arg) /* {{{ */
+{
+  dns_ring_t *r = arg;
+  size_t block = 0;
+
+  while (__atomic_load_n(&capture_loop, __ATOMIC_RELAXED)) {
+    struct tpacket_block_desc *bd =
+        (void *)(r->map + block * DNS_RING_BLOCK_SIZE);
+
+    if ((__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+         TP_STATUS_USER) == 0) {
+      struct pollfd pfd = {.fd = r->fd, .events = POLLIN | POLLERR};
+      /* The timeout bounds the time it takes to notice the shutdown. */
+      poll(&pfd, 1, /* timeout = */ 1000);
+      continue;
+    }
+
+    uint8_t *ptr = (uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+    for (uint32_t i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+      struct tpacket3_hdr *h = (void *)ptr;
+      handle_ip_packet(ptr + h->tp_net, (int)h->tp_snaplen);
+      ptr += h->tp_next_offset;
+    }
+
+    /* Hand the block back to the kernel. */
+    __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                     __ATOMIC_RELEASE);
+    block = (block + 1) % DNS_RING_BLOCK_NUM;
+  }
+
+  return NULL;
+} /* }}} void *dns_ring_loop */
+
+static void dns_ring_stop(void) /* {{{ */
+{
+  __atomic_store_n(&capture_loop, false, __ATOMIC_RELAXED);
+  for (size_t i = 0; i < rings_num; i++)
+    pthread_join(rings[i].thread, NULL);
+
+  for (size_t i = 0; i < (size_t)capture_threads; i++)
+    dns_ring_close(rings + i);
+  sfree(rings);
+  rings_num = 0;
+} /* }}} void dns_ring_stop */
+
+/* Starts `capture_threads' threads, each reading its own packet ring. */
+static int dns_ring_start(void) /* {{{ */
+{
+  int ifindex = 0;
+  if ((pcap_device != NULL) && (strcmp("any", pcap_device) != 0)) {
+    ifindex = (int)if_nametoindex(pcap_device);
+    if (ifindex == 0) {
+      ERROR("dns plugin: Unknown interface `%s'.", pcap_device);
+      return -1;
+    }
+  }
+
+  struct bpf_program fp = {0};
+  if (dns_ring_filter(&fp) != 0)
+    return -1;
+  struct sock_fprog filter = {
+      .len = (unsigned short)fp.bf_len,
+      .filter = (struct sock_filter *)fp.bf_insns,
+  };
+
+  rings = calloc((size_t)capture_threads, sizeof(*rings));
+  if (rings == NULL) {
+    pcap_freecode(&fp);
+    return -1;
+  }
+  for (int i = 0; i < capture_threads; i++)
+    rings[i].fd = -1;
+
+  int fanout_id = (capture_threads > 1) ? (int)(getpid() & 0xffff) : -1;
+  int status = 0;
+  for (int i = 0; i < capture_threads; i++) {
+    status = dns_ring_open(rings + i, ifindex, &filter, fanout_id);
+    if (status != 0)
+      break;
+  }
+  pcap_freecode(&fp);
+
+  __atomic_store_n(&capture_loop, true, __ATOMIC_RELAXED);
+  for (int i = 0; (status == 0) && (i < capture_threads); i++) {
+    status = plugin_thread_create(&rings[i].thread, NULL, dns_ring_loop,
+                                  rings + i, "dns capture");
+    if (status != 0)
+      ERROR("dns plugin: pthread_create failed: %s", STRERROR(status));
+    else
+      rings_num++;
+  }
+
+  if (status != 0) {
+    dns_ring_stop();
+    return -1;
+  }
+
+  INFO("dns plugin: Capturing on `%s' with %i thread%s.",
+       (pcap_device != NULL) ? pcap_device : "any", capture_threads,
+       (capture_threads == 1) ? "" : "s");
+  return 0;
+} /* }}} int dns_ring_start */
+
+static int dns_shutdown(void) {
+  if (rings != NULL)
+    dns_ring_stop();
+  return 0;
+} /* int dns_shutdown */
+#endif /* DNS_HAVE_PACKET_RING */
+
 static int dns_init(void) {
   /* clean up an old thread */
   int status;
 
-  pthread_mutex_lock(&traffic_mutex);
-  tr_queries = 0;
-  tr_responses = 0;
-  pthread_mutex_unlock(&traffic_mutex);
+  __atomic_store_n(&tr_queries, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&tr_responses, 0, __ATOMIC_RELAXED);
 
   if (listen_thread_init != 0)
     return -1;
 
+  dnstop_set_callback(dns_child_callback);
+
+#if DNS_HAVE_PACKET_RING
+  if (rings != NULL)
+    return -1;
+  if ((capture_threads > 0) && (dns_ring_start() == 0))
+    return 0;
+  if (capture_threads > 0)
+    WARNING("dns plugin: Capturing with packet rings failed, using libpcap "
+            "instead.");
+#endif
+
   status = plugin_thread_create(&listen_thread, NULL, dns_child_loop, (void *)0,
                                 "dns listen");
   if (status != 0) {
@@ -337,57 +537,41 @@ static void submit_octets(derive_t queries, derive_t responses) {
 } /* void submit_octets */
 
 static int dns_read(void) {
-  unsigned int keys[T_MAX];
-  unsigned int values[T_MAX];
-  int len;
-
-  counter_list_t *ptr;
+  derive_t queries = counter_get(&tr_queries);
+  derive_t responses = counter_get(&tr_responses);
 
-  pthread_mutex_lock(&traffic_mutex);
-  values[0] = tr_queries;
-  values[1] = tr_responses;
-  pthread_mutex_unlock(&traffic_mutex);
+  if ((queries != 0) || (responses != 0))
+    submit_octets(queries, responses);
 
-  if ((values[0] != 0) || (values[1] != 0))
-    submit_octets(values[0], values[1]);
+  for (int i = 0; i < T_MAX; i++) {
+    derive_t value = counter_get(&qtype_counts[i]);
+    if (value == 0)
+      continue;
 
-  pthread_mutex_lock(&qtype_mutex);
-  for (ptr = qtype_list, len = 0; (ptr != NULL) && (len < T_MAX);
-       ptr = ptr->next, len++) {
-    keys[len] = ptr->key;
-    values[len] = ptr->value;
-  }
-  pthread_mutex_unlock(&qtype_mutex);
+    const char *str = qtype_str(i);
+    if (!select_numeric_qtype && ((str == NULL) || (str[0] == '#')))
+      continue;
 
-  for (int i = 0; i < len; i++) {
-    DEBUG("dns plugin: qtype = %u; counter = %u;", keys[i], values[i]);
-    submit_derive("dns_qtype", qtype_str(keys[i]), values[i]);
+    DEBUG("dns plugin: qtype = %i; counter = %" PRIi64 ";", i, value);
+    submit_derive("dns_qtype", str, value);
   }
 
-  pthread_mutex_lock(&opcode_mutex);
-  for (ptr = opcode_list, len = 0; (ptr != NULL) && (len < T_MAX);
-       ptr = ptr->next, len++) {
-    keys[len] = ptr->key;
-    values[len] = ptr->value;
-  }
-  pthread_mutex_unlock(&opcode_mutex);
+  for (int i = 0; i < (int)STATIC_ARRAY_SIZE(opcode_counts); i++) {
+    derive_t value = counter_get(&opcode_counts[i]);
+    if (value == 0)
+      continue;
 
-  for (int i = 0; i < len; i++) {
-    DEBUG("dns plugin: opcode = %u; counter = %u;", keys[i], values[i]);
-    submit_derive("dns_opcode", opcode_str(keys[i]), values[i]);
+    DEBUG("dns plugin: opcode = %i; counter = %" PRIi64 ";", i, value);
+    submit_derive("dns_opcode", opcode_str(i), value);
   }
 
-  pthread_mutex_lock(&rcode_mutex);
-  for (ptr = rcode_list, len = 0; (ptr != NULL) && (len < T_MAX);
-       ptr = ptr->next, len++) {
-    keys[len] = ptr->key;
-    values[len] = ptr->value;
-  }
-  pthread_mutex_unlock(&rcode_mutex);
+  for (int i = 0; i < (int)STATIC_ARRAY_SIZE(rcode_counts); i++) {
+    derive_t value = counter_get(&rcode_counts[i]);
+    if (value == 0)
+      continue;
 
-  for (int i = 0; i < len; i++) {
-    DEBUG("dns plugin: rcode = %u; counter = %u;", keys[i], values[i]);
-    submit_derive("dns_rcode", rcode_str(keys[i]), values[i]);
+    DEBUG("dns plugin: rcode = %i; counter = %" PRIi64 ";", i, value);
+    submit_derive("dns_rcode", rcode_str(i), value);
   }
 
   return 0;
@@ -397,4 +581,7 @@ void module_register(void) {
   plugin_register_config("dns", dns_config, config_keys, config_keys_num);
   plugin_register_init("dns", dns_init);
   plugin_register_read("dns", dns_read);
+#if DNS_HAVE_PACKET_RING
+  plugin_register_shutdown("dns", dns_shutdown);
+#endif
 } /* void module_register */
@@ -46,6 +46,7 @@
 
 struct dpdk_stats_config_s {
   cdtime_t interval;
+  cdtime_t stream_interval;
   uint32_t enabled_port_mask;
   char port_name[RTE_MAX_ETHPORTS][DATA_MAX_NAME_LEN];
 };
@@ -60,7 +61,11 @@ typedef struct dpdk_stats_config_s dpdk_stats_config_t;
 #define DPDK_STATS_CTX_INIT(ctx)                                               \
   do {                                                                         \
     ctx->xstats = (struct rte_eth_xstats *)&ctx->raw_data[0];                  \
+    ctx->ring_data = (uint64_t *)&ctx                                          \
+                         ->raw_data[ctx->stats_count *                         \
+                                    DPDK_STATS_CTX_GET_XSTAT_SIZE];            \
   } while (0)
+typedef struct rte_eth_xstats dpdk_stats_xstat_t;
 #else
 #define DPDK_STATS_XSTAT_GET_VALUE(ctx, index) ctx->xstats[index].value
 #define DPDK_STATS_XSTAT_GET_NAME(ctx, index) ctx->xnames[index].name
@@ -72,9 +77,19 @@ typedef struct dpdk_stats_config_s dpdk_stats_config_t;
     ctx->xnames =                                                              \
         (struct rte_eth_xstat_name *)&ctx                                      \
             ->raw_data[ctx->stats_count * sizeof(struct rte_eth_xstat)];       \
+    ctx->ring_data = (uint64_t *)&ctx                                          \
+                         ->raw_data[ctx->stats_count *                         \
+                                    DPDK_STATS_CTX_GET_XSTAT_SIZE];            \
   } while (0)
+typedef struct rte_eth_xstat dpdk_stats_xstat_t;
 #endif
 
+/* A ring slot holds the time of the sample followed by the values of all
+ * xstats, in the order of the names. */
+#define DPDK_STATS_CTX_GET_RING_SIZE(ctx)                                      \
+  ((size_t)(ctx)->ring_slots * ((ctx)->stats_count + 1) * sizeof(uint64_t))
+#define DPDK_STATS_RING_SLOTS_MAX 4096
+
 struct dpdk_stats_ctx_s {
   dpdk_stats_config_t config;
   uint32_t stats_count;
@@ -87,6 +102,17 @@ struct dpdk_stats_ctx_s {
   struct rte_eth_xstat *xstats;
   struct rte_eth_xstat_name *xnames;
 #endif
+
+  /* StreamInterval: the helper pushes samples into a single-producer,
+   * single-consumer ring, so that reads do not wait for it. The names are
+   * only read by DPDK_CMD_GET_STATS. */
+  uint32_t ring_slots;
+  uint32_t ring_head; /* written by the helper */
+  uint32_t ring_tail; /* written by collectd */
+  int ring_stale;     /* set by the helper if the xstats changed */
+  int ring_armed;     /* collectd only */
+  uint64_t *ring_data;
+
   char raw_data[];
 };
 typedef struct dpdk_stats_ctx_s dpdk_stats_ctx_t;
@@ -102,6 +128,12 @@ dpdk_helper_ctx_t *g_hc = NULL;
 static char g_shm_name[DATA_MAX_NAME_LEN] = DPDK_STATS_NAME;
 static dpdk_stat_cfg_status g_state = DPDK_STAT_STATE_OKAY;
 
+/* Counters are dispatched in batches of this many value lists. */
+#define DPDK_STATS_BATCH_SIZE 128
+static value_list_t g_batch_vls[DPDK_STATS_BATCH_SIZE];
+static value_t g_batch_values[DPDK_STATS_BATCH_SIZE];
+static size_t g_batch_num;
+
 static int dpdk_stats_reinit_helper();
 static void dpdk_stats_default_config(void) {
   dpdk_stats_ctx_t *ec = DPDK_STATS_CTX_GET(g_hc);
@@ -154,7 +186,9 @@ static int dpdk_stats_config(oconfig_item_t *ci) {
       ret = cf_util_get_string_buffer(child, g_shm_name, sizeof(g_shm_name));
       if (ret == 0)
         ret = dpdk_stats_reinit_helper();
-    } else if (strcasecmp("EAL", child->key) == 0)
+    } else if (strcasecmp("StreamInterval", child->key) == 0)
+      ret = cf_util_get_cdtime(child, &ctx->config.stream_interval);
+    else if (strcasecmp("EAL", child->key) == 0)
       ret = dpdk_helper_eal_config_parse(g_hc, child);
     else if (strcasecmp("PortName", child->key) != 0) {
       ERROR(DPDK_STATS_PLUGIN ": unrecognized configuration option %s",
@@ -172,6 +206,17 @@ static int dpdk_stats_config(oconfig_item_t *ci) {
         ctx->config.enabled_port_mask);
   DEBUG(DPDK_STATS_PLUGIN ": Shared memory object %s", g_shm_name);
 
+  /* Room for the samples of two read intervals. */
+  if (ctx->config.stream_interval > 0) {
+    uint64_t slots =
+        2 * (ctx->config.interval / ctx->config.stream_interval + 1);
+    ctx->ring_slots = (uint32_t)((slots < DPDK_STATS_RING_SLOTS_MAX)
+                                     ? slots
+                                     : DPDK_STATS_RING_SLOTS_MAX);
+    DEBUG(DPDK_STATS_PLUGIN ": Streaming every %.3f s, %" PRIu32 " slots",
+          CDTIME_T_TO_DOUBLE(ctx->config.stream_interval), ctx->ring_slots);
+  }
+
   int port_num = 0;
 
   /* parse port names after EnabledPortMask was parsed */
@@ -272,6 +317,64 @@ static int dpdk_helper_stats_count_get(dpdk_helper_ctx_t *phc) {
   return stats_count;
 }
 
+/* Pushes the values of all xstats into the ring. Called from the helper every
+ * StreamInterval. A sample is dropped if collectd did not keep up. */
+static int dpdk_helper_stats_stream(dpdk_helper_ctx_t *phc) {
+  /* Private to the helper process, unlike the shared ctx->xstats. */
+  static dpdk_stats_xstat_t *xstats;
+  static int xstats_num;
+
+  dpdk_stats_ctx_t *ctx = DPDK_STATS_CTX_GET(phc);
+
+  if ((ctx->ring_data == NULL) || (ctx->ring_slots == 0) ||
+      __atomic_load_n(&ctx->ring_stale, __ATOMIC_ACQUIRE))
+    return 0;
+
+  uint32_t head = ctx->ring_head;
+  uint32_t tail = __atomic_load_n(&ctx->ring_tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= ctx->ring_slots)
+    return 0;
+
+  uint64_t *slot = ctx->ring_data + (size_t)(head % ctx->ring_slots) *
+                                        (ctx->stats_count + 1);
+  slot[0] = (uint64_t)cdtime();
+
+  uint32_t stats = 0;
+  for (uint8_t i = 0; i < ctx->ports_count; i++) {
+    if (!(ctx->config.enabled_port_mask & (1 << i)))
+      continue;
+
+    int len = ctx->port_stats_count[i];
+    if (len == 0)
+      continue;
+
+    if (len > xstats_num) {
+      dpdk_stats_xstat_t *tmp = realloc(xstats, len * sizeof(*xstats));
+      if (tmp == NULL)
+        return -ENOMEM;
+      xstats = tmp;
+      xstats_num = len;
+    }
+
+    int ret = rte_eth_xstats_get(i, xstats, len);
+    if ((ret != len) || (stats + len > ctx->stats_count)) {
+      /* collectd has to read the names again. */
+      DPDK_CHILD_LOG(DPDK_STATS_PLUGIN
+                     ": Number of stats changed (port=%d; len=%d, ret=%d)\n",
+                     i, len, ret);
+      __atomic_store_n(&ctx->ring_stale, 1, __ATOMIC_RELEASE);
+      return -1;
+    }
+
+    for (int j = 0; j < len; j++)
+      slot[1 + stats + j] = xstats[j].value;
+    stats += len;
+  }
+
+  __atomic_store_n(&ctx->ring_head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
 static int dpdk_stats_get_size(dpdk_helper_ctx_t *phc) {
   return dpdk_helper_data_size_get(phc) - sizeof(dpdk_stats_ctx_t);
 }
@@ -284,6 +387,9 @@ int dpdk_helper_command_handler(dpdk_helper_ctx_t *phc, enum DPDK_CMD cmd) {
     return -EINVAL;
   }
 
+  if (cmd == DPDK_CMD_STREAM)
+    return dpdk_helper_stats_stream(phc);
+
   if (cmd != DPDK_CMD_GET_STATS) {
     DPDK_CHILD_LOG("%s: Unknown command (cmd=%d)\n", DPDK_STATS_PLUGIN, cmd);
     return -EINVAL;
@@ -295,7 +401,8 @@ int dpdk_helper_command_handler(dpdk_helper_ctx_t *phc, enum DPDK_CMD cmd) {
   }
 
   DPDK_STATS_CTX_GET(phc)->stats_count = stats_count;
-  int stats_size = stats_count * DPDK_STATS_CTX_GET_XSTAT_SIZE;
+  int stats_size = stats_count * DPDK_STATS_CTX_GET_XSTAT_SIZE +
+                   DPDK_STATS_CTX_GET_RING_SIZE(DPDK_STATS_CTX_GET(phc));
 
   if (dpdk_stats_get_size(phc) < stats_size) {
     DPDK_CHILD_LOG(
@@ -365,18 +472,37 @@ static void dpdk_stats_resolve_cnt_type(char *cnt_type, size_t cnt_type_len,
   }
 }
 
+static void dpdk_stats_flush(void) {
+  if (g_batch_num > 0)
+    plugin_dispatch_values_batch(g_batch_vls, g_batch_num);
+  g_batch_num = 0;
+}
+
 static void dpdk_stats_counter_submit(const char *plugin_instance,
                                       const char *cnt_name, derive_t value,
                                       cdtime_t port_read_time) {
-  value_list_t vl = VALUE_LIST_INIT;
-  vl.values = &(value_t){.derive = value};
-  vl.values_len = 1;
-  vl.time = port_read_time;
-  sstrncpy(vl.plugin, DPDK_STATS_PLUGIN, sizeof(vl.plugin));
-  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
-  dpdk_stats_resolve_cnt_type(vl.type, sizeof(vl.type), cnt_name);
-  sstrncpy(vl.type_instance, cnt_name, sizeof(vl.type_instance));
-  plugin_dispatch_values(&vl);
+  if (g_batch_num == DPDK_STATS_BATCH_SIZE)
+    dpdk_stats_flush();
+
+  value_list_t *vl = g_batch_vls + g_batch_num;
+  *vl = (value_list_t)VALUE_LIST_INIT;
+  g_batch_values[g_batch_num].derive = value;
+  vl->values = g_batch_values + g_batch_num;
+  vl->values_len = 1;
+  vl->time = port_read_time;
+  sstrncpy(vl->plugin, DPDK_STATS_PLUGIN, sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, plugin_instance, sizeof(vl->plugin_instance));
+  dpdk_stats_resolve_cnt_type(vl->type, sizeof(vl->type), cnt_name);
+  sstrncpy(vl->type_instance, cnt_name, sizeof(vl->type_instance));
+  g_batch_num++;
+}
+
+static void dpdk_stats_dev_name(dpdk_stats_ctx_t *ctx, int port, char *buffer,
+                                size_t buffer_size) {
+  if (ctx->config.port_name[port][0] != 0)
+    snprintf(buffer, buffer_size, "%s", ctx->config.port_name[port]);
+  else
+    snprintf(buffer, buffer_size, "port.%d", port);
 }
 
 static int dpdk_stats_counters_dispatch(dpdk_helper_ctx_t *phc) {
@@ -394,11 +520,7 @@ static int dpdk_stats_counters_dispatch(dpdk_helper_ctx_t *phc) {
       continue;
 
     char dev_name[64];
-    if (ctx->config.port_name[i][0] != 0) {
-      snprintf(dev_name, sizeof(dev_name), "%s", ctx->config.port_name[i]);
-    } else {
-      snprintf(dev_name, sizeof(dev_name), "port.%d", i);
-    }
+    dpdk_stats_dev_name(ctx, i, dev_name, sizeof(dev_name));
 
     DEBUG(" === Dispatch stats for port %d (name=%s; stats_count=%d)", i,
           dev_name, ctx->port_stats_count[i]);
@@ -417,17 +539,66 @@ static int dpdk_stats_counters_dispatch(dpdk_helper_ctx_t *phc) {
       assert(stats_count <= ctx->stats_count);
     }
   }
+  dpdk_stats_flush();
 
   return 0;
 }
 
+/* Dispatches the samples pushed by the helper since the last read. */
+static void dpdk_stats_ring_dispatch(dpdk_stats_ctx_t *ctx) {
+  uint32_t tail = ctx->ring_tail;
+  uint32_t head = __atomic_load_n(&ctx->ring_head, __ATOMIC_ACQUIRE);
+
+  for (; tail != head; tail++) {
+    const uint64_t *slot = ctx->ring_data + (size_t)(tail % ctx->ring_slots) *
+                                                (ctx->stats_count + 1);
+    cdtime_t time = (cdtime_t)slot[0];
+    uint32_t stats = 0;
+
+    for (int i = 0; i < ctx->ports_count; i++) {
+      if (!(ctx->config.enabled_port_mask & (1 << i)))
+        continue;
+
+      char dev_name[64];
+      dpdk_stats_dev_name(ctx, i, dev_name, sizeof(dev_name));
+
+      for (int j = 0; j < ctx->port_stats_count[i]; j++) {
+        const char *cnt_name = DPDK_STATS_XSTAT_GET_NAME(ctx, stats);
+        if (cnt_name != NULL)
+          dpdk_stats_counter_submit(dev_name, cnt_name,
+                                    (derive_t)slot[1 + stats], time);
+        stats++;
+      }
+    }
+  }
+  dpdk_stats_flush();
+
+  __atomic_store_n(&ctx->ring_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* Starts dispatching from the ring after the names have been read. */
+static void dpdk_stats_ring_arm(dpdk_stats_ctx_t *ctx) {
+  if ((ctx->ring_slots == 0) || (ctx->ring_data == NULL))
+    return;
+
+  /* Samples pushed before the names were read are skipped. */
+  __atomic_store_n(&ctx->ring_tail,
+                   __atomic_load_n(&ctx->ring_head, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&ctx->ring_stale, 0, __ATOMIC_RELEASE);
+  ctx->ring_armed = 1;
+
+  dpdk_helper_stream_start(g_hc, ctx->config.stream_interval);
+}
+
 static int dpdk_stats_reinit_helper() {
   DPDK_STATS_TRACE();
 
   dpdk_stats_ctx_t *ctx = DPDK_STATS_CTX_GET(g_hc);
 
   size_t data_size = sizeof(dpdk_stats_ctx_t) +
-                     (ctx->stats_count * DPDK_STATS_CTX_GET_XSTAT_SIZE);
+                     (ctx->stats_count * DPDK_STATS_CTX_GET_XSTAT_SIZE) +
+                     DPDK_STATS_CTX_GET_RING_SIZE(ctx);
 
   DEBUG("%s:%d helper reinit (new_size=%" PRIsz ")", __FUNCTION__, __LINE__,
         data_size);
@@ -453,6 +624,10 @@ static int dpdk_stats_reinit_helper() {
   ctx = DPDK_STATS_CTX_GET(g_hc);
   memcpy(ctx, &tmp_ctx, sizeof(dpdk_stats_ctx_t));
   DPDK_STATS_CTX_INIT(ctx);
+  ctx->ring_head = 0;
+  ctx->ring_tail = 0;
+  ctx->ring_stale = 0;
+  ctx->ring_armed = 0;
   dpdk_helper_eal_config_set(g_hc, &tmp_eal);
 
   return ret;
@@ -470,6 +645,18 @@ static int dpdk_stats_read(user_data_t *ud) {
 
   dpdk_stats_ctx_t *ctx = DPDK_STATS_CTX_GET(g_hc);
 
+  /* While streaming, only the samples pushed by the helper are dispatched.
+   * If the helper restarted or the xstats changed, the names are read
+   * again below. */
+  if (ctx->ring_armed) {
+    if ((dpdk_helper_stream_check(g_hc) == 0) &&
+        !__atomic_load_n(&ctx->ring_stale, __ATOMIC_ACQUIRE)) {
+      dpdk_stats_ring_dispatch(ctx);
+      return 0;
+    }
+    ctx->ring_armed = 0;
+  }
+
   int result = 0;
   ret = dpdk_helper_command(g_hc, DPDK_CMD_GET_STATS, &result,
                             ctx->config.interval);
@@ -483,6 +670,8 @@ static int dpdk_stats_read(user_data_t *ud) {
     dpdk_helper_shutdown(g_hc);
   } else if (result == 0) {
     dpdk_stats_counters_dispatch(g_hc);
+    if (ctx->config.stream_interval > 0)
+      dpdk_stats_ring_arm(ctx);
   }
 
   return 0;
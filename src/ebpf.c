@@ -0,0 +1,844 @@
+/**
+ * collectd - src/ebpf.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils/latency/latency.h"
+#include "utils/latency/latency_config.h"
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+/*
+ *  <Plugin ebpf>
+ *    <Object "biolatency">
+ *      File "/usr/share/collectd/bpf/biolatency.bpf.o"
+ *      <Map "hists">
+ *        Type "latency"
+ *        Instance "disk"
+ *        KeyFormat "Integer"
+ *        Unit "us"
+ *        <Histogram>
+ *          Percentile 50
+ *          Percentile 99
+ *        </Histogram>
+ *      </Map>
+ *    </Object>
+ *  </Plugin>
+ */
+
+/* The sketch keeps the percentiles of the log2 slots within 1%. */
+#define EBPF_SKETCH_ACCURACY 0.01
+
+typedef enum {
+  KEY_INTEGER,
+  KEY_STRING,
+  KEY_HEX,
+  /* All entries of the map are added up. */
+  KEY_NONE,
+} ebpf_key_format_t;
+
+/* The state of one histogram between reads. */
+typedef struct {
+  uint64_t *prev;
+  latency_counter_t *latency;
+  uint64_t generation;
+} ebpf_hist_t;
+
+typedef struct {
+  char *name;
+  char *type;
+  char *instance;
+  ebpf_key_format_t key_format;
+
+  /* Histograms are arrays of log2 slots, like "struct hist" of the
+   * libbpf-tools: slot i counts the values in [2^i, 2^(i+1)) units. */
+  bool histogram;
+  latency_config_t latency;
+  double unit;
+  size_t slot_size;
+  size_t slots_num;
+
+  int fd;
+  bool percpu;
+  size_t key_size;
+  size_t value_size;
+  /* Per-CPU values are padded to eight bytes each. */
+  size_t stride;
+  size_t cpus;
+  const data_set_t *ds;
+  /* Number of fields of a value: data sources or slots. */
+  size_t fields_num;
+
+  void *key;
+  void *next_key;
+  void *value;
+  uint64_t *fields;
+  uint64_t *total;
+  bool have_total;
+
+  c_avl_tree_t *hists;
+  uint64_t generation;
+} ebpf_map_t;
+
+typedef struct {
+  char *name;
+  char *file;
+
+  ebpf_map_t *maps;
+  size_t maps_num;
+
+  struct bpf_object *obj;
+  struct bpf_link **links;
+  size_t links_num;
+} ebpf_object_t;
+
+/* Objects configured but not loaded yet. Once loaded they are owned by their
+ * read callback. */
+static ebpf_object_t **objects;
+static size_t objects_num;
+
+static int ebpf_libbpf_print(enum libbpf_print_level level, const char *format,
+                             va_list ap) /* {{{ */
+{
+  char msg[1024];
+  vsnprintf(msg, sizeof(msg), format, ap);
+
+  size_t len = strlen(msg);
+  while ((len > 0) && (msg[len - 1] == '\n'))
+    msg[--len] = 0;
+
+  switch (level) {
+  case LIBBPF_WARN:
+    WARNING("ebpf plugin: libbpf: %s", msg);
+    break;
+  case LIBBPF_INFO:
+    INFO("ebpf plugin: libbpf: %s", msg);
+    break;
+  default:
+    DEBUG("ebpf plugin: libbpf: %s", msg);
+  }
+
+  return 0;
+} /* }}} int ebpf_libbpf_print */
+
+static void ebpf_hist_free(ebpf_hist_t *h) /* {{{ */
+{
+  if (h == NULL)
+    return;
+
+  free(h->prev);
+  latency_counter_destroy(h->latency);
+  free(h);
+} /* }}} void ebpf_hist_free */
+
+static void ebpf_map_free(ebpf_map_t *m) /* {{{ */
+{
+  if (m->hists != NULL) {
+    char *key;
+    ebpf_hist_t *h;
+    while (c_avl_pick(m->hists, (void *)&key, (void *)&h) == 0) {
+      free(key);
+      ebpf_hist_free(h);
+    }
+    c_avl_destroy(m->hists);
+  }
+
+  sfree(m->name);
+  sfree(m->type);
+  sfree(m->instance);
+  latency_config_free(m->latency);
+
+  sfree(m->key);
+  sfree(m->next_key);
+  sfree(m->value);
+  sfree(m->fields);
+  sfree(m->total);
+} /* }}} void ebpf_map_free */
+
+static void ebpf_object_free(void *arg) /* {{{ */
+{
+  ebpf_object_t *o = arg;
+
+  if (o == NULL)
+    return;
+
+  for (size_t i = 0; i < o->links_num; i++)
+    bpf_link__destroy(o->links[i]);
+  sfree(o->links);
+  if (o->obj != NULL)
+    bpf_object__close(o->obj);
+
+  for (size_t i = 0; i < o->maps_num; i++)
+    ebpf_map_free(o->maps + i);
+  sfree(o->maps);
+
+  sfree(o->name);
+  sfree(o->file);
+  sfree(o);
+} /* }}} void ebpf_object_free */
+
+/* Returns a value field of one CPU in host byte order. */
+static uint64_t ebpf_field(ebpf_map_t const *m, uint8_t const *value,
+                           size_t index) /* {{{ */
+{
+  size_t size = m->histogram ? m->slot_size : sizeof(uint64_t);
+
+  if (size == sizeof(uint32_t)) {
+    uint32_t v;
+    memcpy(&v, value + index * size, sizeof(v));
+    return (uint64_t)v;
+  }
+
+  uint64_t v;
+  memcpy(&v, value + index * size, sizeof(v));
+  return v;
+} /* }}} uint64_t ebpf_field */
+
+static void ebpf_format_key(ebpf_map_t const *m, uint8_t const *key,
+                            char *buffer, size_t buffer_size) /* {{{ */
+{
+  char str[DATA_MAX_NAME_LEN] = "";
+  ebpf_key_format_t format = m->key_format;
+
+  if ((format == KEY_INTEGER) && (m->key_size != 1) && (m->key_size != 2) &&
+      (m->key_size != 4) && (m->key_size != 8))
+    format = KEY_HEX;
+
+  if (format == KEY_INTEGER) {
+    uint64_t v = 0;
+    if (m->key_size == 1)
+      v = key[0];
+    else if (m->key_size == 2) {
+      uint16_t tmp;
+      memcpy(&tmp, key, sizeof(tmp));
+      v = tmp;
+    } else if (m->key_size == 4) {
+      uint32_t tmp;
+      memcpy(&tmp, key, sizeof(tmp));
+      v = tmp;
+    } else {
+      memcpy(&v, key, sizeof(v));
+    }
+    snprintf(str, sizeof(str), "%" PRIu64, v);
+  } else if (format == KEY_STRING) {
+    size_t i;
+    for (i = 0; (i < m->key_size) && (i < sizeof(str) - 1); i++) {
+      if (key[i] == 0)
+        break;
+      str[i] = isalnum(key[i]) || (key[i] == '_') || (key[i] == '.')
+                   ? (char)key[i]
+                   : '_';
+    }
+    str[i] = 0;
+  } else if (format == KEY_HEX) {
+    for (size_t i = 0; (i < m->key_size) && (2 * i + 2 < sizeof(str)); i++)
+      snprintf(str + 2 * i, 3, "%02x", key[i]);
+  }
+
+  if ((m->instance == NULL) || (m->instance[0] == 0))
+    sstrncpy(buffer, str, buffer_size);
+  else if (str[0] == 0)
+    sstrncpy(buffer, m->instance, buffer_size);
+  else
+    snprintf(buffer, buffer_size, "%s-%s", m->instance, str);
+} /* }}} void ebpf_format_key */
+
+static void ebpf_submit_values(ebpf_object_t const *o, ebpf_map_t const *m,
+                               char const *type_instance,
+                               uint64_t const *fields) /* {{{ */
+{
+  value_t values[m->ds->ds_num];
+
+  for (size_t i = 0; i < m->ds->ds_num; i++) {
+    switch (m->ds->ds[i].type) {
+    case DS_TYPE_GAUGE:
+      values[i].gauge = (gauge_t)fields[i];
+      break;
+    case DS_TYPE_COUNTER:
+      values[i].counter = (counter_t)fields[i];
+      break;
+    case DS_TYPE_DERIVE:
+      values[i].derive = (derive_t)fields[i];
+      break;
+    case DS_TYPE_ABSOLUTE:
+      values[i].absolute = (absolute_t)fields[i];
+      break;
+    }
+  }
+
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = values;
+  vl.values_len = m->ds->ds_num;
+  sstrncpy(vl.plugin, "ebpf", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, o->name, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, m->type, sizeof(vl.type));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  plugin_dispatch_values(&vl);
+} /* }}} void ebpf_submit_values */
+
+/* Dispatches the percentiles and buckets like the "latency" matches of the
+ * tail plugin. */
+static void ebpf_submit_hist(ebpf_object_t const *o, ebpf_map_t const *m,
+                             char const *instance,
+                             latency_counter_t *lc) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  sstrncpy(vl.plugin, "ebpf", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, o->name, sizeof(vl.plugin_instance));
+  vl.time = cdtime();
+
+  sstrncpy(vl.type, m->type, sizeof(vl.type));
+  for (size_t i = 0; i < m->latency.percentile_num; i++) {
+    if (strlen(instance) != 0)
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%.50s-%.5g",
+               instance, m->latency.percentile[i]);
+    else
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%.5g",
+               m->latency.percentile[i]);
+
+    vl.values = &(value_t){
+        .gauge = (latency_counter_get_num(lc) != 0)
+                     ? CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(
+                           lc, m->latency.percentile[i]))
+                     : NAN,
+    };
+    vl.values_len = 1;
+
+    plugin_dispatch_values(&vl);
+  }
+
+  if (m->latency.bucket_type != NULL)
+    sstrncpy(vl.type, m->latency.bucket_type, sizeof(vl.type));
+  else
+    sstrncpy(vl.type, "bucket", sizeof(vl.type));
+
+  for (size_t i = 0; i < m->latency.buckets_num; i++) {
+    latency_bucket_t bucket = m->latency.buckets[i];
+
+    double lower_bound = CDTIME_T_TO_DOUBLE(bucket.lower_bound);
+    double upper_bound =
+        bucket.upper_bound ? CDTIME_T_TO_DOUBLE(bucket.upper_bound) : INFINITY;
+
+    if (strlen(instance) != 0)
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%.50s-%.50s-%g_%g",
+               m->type, instance, lower_bound, upper_bound);
+    else
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "%.50s-%g_%g",
+               m->type, lower_bound, upper_bound);
+
+    vl.values = &(value_t){
+        .gauge = latency_counter_get_rate(lc, bucket.lower_bound,
+                                          bucket.upper_bound, vl.time),
+    };
+    vl.values_len = 1;
+
+    plugin_dispatch_values(&vl);
+  }
+} /* }}} void ebpf_submit_hist */
+
+/* Adds the slots counted since the last read to the latency counter of the
+ * histogram. The first read only records the counts. */
+static int ebpf_update_hist(ebpf_object_t const *o, ebpf_map_t *m,
+                            char const *instance,
+                            uint64_t const *slots) /* {{{ */
+{
+  ebpf_hist_t *h = NULL;
+
+  if (c_avl_get(m->hists, instance, (void *)&h) != 0) {
+    h = calloc(1, sizeof(*h));
+    char *key = strdup(instance);
+    if ((h == NULL) || (key == NULL)) {
+      free(h);
+      free(key);
+      return ENOMEM;
+    }
+    h->prev = calloc(m->slots_num, sizeof(*h->prev));
+    h->latency = latency_counter_create_sketch(EBPF_SKETCH_ACCURACY);
+    if ((h->prev == NULL) || (h->latency == NULL) ||
+        (c_avl_insert(m->hists, key, h) != 0)) {
+      ebpf_hist_free(h);
+      free(key);
+      return ENOMEM;
+    }
+    memcpy(h->prev, slots, m->slots_num * sizeof(*h->prev));
+  } else {
+    for (size_t i = 0; i < m->slots_num; i++) {
+      /* The program may have cleared the map. */
+      uint64_t delta =
+          (slots[i] >= h->prev[i]) ? slots[i] - h->prev[i] : slots[i];
+      h->prev[i] = slots[i];
+      if (delta == 0)
+        continue;
+
+      double units = (i == 0) ? 1.0 : 1.5 * ldexp(1.0, (int)i);
+      latency_counter_add_n(h->latency, DOUBLE_TO_CDTIME_T(units * m->unit),
+                            delta);
+    }
+  }
+  h->generation = m->generation;
+
+  ebpf_submit_hist(o, m, instance, h->latency);
+  latency_counter_reset(h->latency);
+  return 0;
+} /* }}} int ebpf_update_hist */
+
+/* Forgets the histograms of keys that have been removed from the map. */
+static void ebpf_prune_hists(ebpf_map_t *m) /* {{{ */
+{
+  char **stale = NULL;
+  size_t stale_num = 0;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(m->hists);
+  char *key;
+  ebpf_hist_t *h;
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&h) == 0) {
+    if (h->generation == m->generation)
+      continue;
+    char **tmp = realloc(stale, (stale_num + 1) * sizeof(*stale));
+    if (tmp == NULL)
+      break;
+    stale = tmp;
+    stale[stale_num++] = key;
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < stale_num; i++) {
+    if (c_avl_remove(m->hists, stale[i], (void *)&key, (void *)&h) == 0) {
+      free(key);
+      ebpf_hist_free(h);
+    }
+  }
+  free(stale);
+} /* }}} void ebpf_prune_hists */
+
+static int ebpf_handle_entry(ebpf_object_t const *o, ebpf_map_t *m,
+                             uint8_t const *key) /* {{{ */
+{
+  /* Add up the values of all CPUs. */
+  memset(m->fields, 0, m->fields_num * sizeof(*m->fields));
+  for (size_t cpu = 0; cpu < m->cpus; cpu++) {
+    uint8_t const *value = (uint8_t const *)m->value + cpu * m->stride;
+    for (size_t i = 0; i < m->fields_num; i++)
+      m->fields[i] += ebpf_field(m, value, i);
+  }
+
+  if (m->key_format == KEY_NONE) {
+    for (size_t i = 0; i < m->fields_num; i++)
+      m->total[i] += m->fields[i];
+    m->have_total = true;
+    return 0;
+  }
+
+  char instance[DATA_MAX_NAME_LEN];
+  ebpf_format_key(m, key, instance, sizeof(instance));
+
+  if (m->histogram)
+    return ebpf_update_hist(o, m, instance, m->fields);
+
+  ebpf_submit_values(o, m, instance, m->fields);
+  return 0;
+} /* }}} int ebpf_handle_entry */
+
+static int ebpf_read_map(ebpf_object_t const *o, ebpf_map_t *m) /* {{{ */
+{
+  void *prev = NULL;
+  int status;
+
+  m->generation++;
+  if (m->key_format == KEY_NONE) {
+    memset(m->total, 0, m->fields_num * sizeof(*m->total));
+    m->have_total = false;
+  }
+
+  while ((status = bpf_map_get_next_key(m->fd, prev, m->next_key)) == 0) {
+    memcpy(m->key, m->next_key, m->key_size);
+    prev = m->key;
+
+    if (bpf_map_lookup_elem(m->fd, m->key, m->value) != 0) {
+      /* The entry was deleted in the meantime. */
+      if (errno == ENOENT)
+        continue;
+      status = errno;
+      ERROR("ebpf plugin: Looking up an entry of map \"%s\" of object \"%s\" "
+            "failed: %s",
+            m->name, o->name, STRERRNO);
+      return status;
+    }
+
+    status = ebpf_handle_entry(o, m, m->key);
+    if (status != 0)
+      return status;
+  }
+
+  if (errno != ENOENT) {
+    status = errno;
+    ERROR("ebpf plugin: Iterating over map \"%s\" of object \"%s\" failed: %s",
+          m->name, o->name, STRERRNO);
+    return status;
+  }
+
+  if (m->key_format == KEY_NONE) {
+    if (!m->have_total)
+      return 0;
+    char instance[DATA_MAX_NAME_LEN];
+    sstrncpy(instance, (m->instance != NULL) ? m->instance : "",
+             sizeof(instance));
+    if (m->histogram)
+      return ebpf_update_hist(o, m, instance, m->total);
+    ebpf_submit_values(o, m, instance, m->total);
+    return 0;
+  }
+
+  if (m->histogram)
+    ebpf_prune_hists(m);
+  return 0;
+} /* }}} int ebpf_read_map */
+
+static int ebpf_read(user_data_t *ud) /* {{{ */
+{
+  ebpf_object_t *o = ud->data;
+  int success = 0;
+
+  for (size_t i = 0; i < o->maps_num; i++)
+    if (ebpf_read_map(o, o->maps + i) == 0)
+      success++;
+
+  return (success > 0) ? 0 : -1;
+} /* }}} int ebpf_read */
+
+static int ebpf_map_init(ebpf_object_t *o, ebpf_map_t *m) /* {{{ */
+{
+  struct bpf_map *map = bpf_object__find_map_by_name(o->obj, m->name);
+  if (map == NULL) {
+    ERROR("ebpf plugin: Object \"%s\" has no map named \"%s\".", o->name,
+          m->name);
+    return ENOENT;
+  }
+
+  m->fd = bpf_map__fd(map);
+  m->key_size = bpf_map__key_size(map);
+  m->value_size = bpf_map__value_size(map);
+
+  enum bpf_map_type type = bpf_map__type(map);
+  m->percpu = (type == BPF_MAP_TYPE_PERCPU_ARRAY) ||
+              (type == BPF_MAP_TYPE_PERCPU_HASH) ||
+              (type == BPF_MAP_TYPE_LRU_PERCPU_HASH);
+  m->cpus = 1;
+  m->stride = m->value_size;
+  if (m->percpu) {
+    int cpus = libbpf_num_possible_cpus();
+    if (cpus <= 0) {
+      ERROR("ebpf plugin: Determining the number of CPUs failed: %s",
+            STRERROR(-cpus));
+      return -cpus;
+    }
+    m->cpus = (size_t)cpus;
+    m->stride = (m->value_size + 7) & ~((size_t)7);
+  }
+
+  m->ds = plugin_get_ds(m->type);
+  if (m->ds == NULL) {
+    ERROR("ebpf plugin: Map \"%s\" of object \"%s\": unknown type \"%s\".",
+          m->name, o->name, m->type);
+    return ENOENT;
+  }
+
+  if (m->histogram) {
+    size_t max_slots = m->value_size / m->slot_size;
+    if (m->slots_num == 0)
+      m->slots_num = max_slots;
+    if ((m->slots_num == 0) || (m->slots_num > max_slots)) {
+      ERROR("ebpf plugin: Map \"%s\" of object \"%s\": the values (%" PRIsz
+            " bytes) can't hold %" PRIsz " slots of %" PRIsz " bytes.",
+            m->name, o->name, m->value_size, m->slots_num, m->slot_size);
+      return EINVAL;
+    }
+    m->fields_num = m->slots_num;
+
+    m->hists = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (m->hists == NULL)
+      return ENOMEM;
+  } else {
+    m->fields_num = m->ds->ds_num;
+    if (m->value_size < m->fields_num * sizeof(uint64_t)) {
+      ERROR("ebpf plugin: Map \"%s\" of object \"%s\": type \"%s\" needs "
+            "%" PRIsz " 64 bit values, but the values have %" PRIsz " bytes.",
+            m->name, o->name, m->type, m->fields_num, m->value_size);
+      return EINVAL;
+    }
+  }
+
+  m->key = calloc(1, m->key_size);
+  m->next_key = calloc(1, m->key_size);
+  m->value = calloc(m->cpus, m->stride);
+  m->fields = calloc(m->fields_num, sizeof(*m->fields));
+  m->total = calloc(m->fields_num, sizeof(*m->total));
+  if ((m->key == NULL) || (m->next_key == NULL) || (m->value == NULL) ||
+      (m->fields == NULL) || (m->total == NULL))
+    return ENOMEM;
+
+  return 0;
+} /* }}} int ebpf_map_init */
+
+static int ebpf_object_load(ebpf_object_t *o) /* {{{ */
+{
+  o->obj = bpf_object__open_file(o->file, NULL);
+  if (o->obj == NULL) {
+    int status = errno;
+    ERROR("ebpf plugin: Opening \"%s\" failed: %s", o->file, STRERRNO);
+    return status;
+  }
+
+  int status = bpf_object__load(o->obj);
+  if (status != 0) {
+    ERROR("ebpf plugin: Loading object \"%s\" failed: %s", o->name,
+          STRERROR(-status));
+    return -status;
+  }
+
+  struct bpf_program *prog;
+  bpf_object__for_each_program(prog, o->obj) {
+    struct bpf_link **tmp =
+        realloc(o->links, (o->links_num + 1) * sizeof(*o->links));
+    if (tmp == NULL)
+      return ENOMEM;
+    o->links = tmp;
+
+    struct bpf_link *link = bpf_program__attach(prog);
+    if (link == NULL) {
+      status = errno;
+      ERROR("ebpf plugin: Attaching program \"%s\" of object \"%s\" failed: "
+            "%s",
+            bpf_program__name(prog), o->name, STRERRNO);
+      return status;
+    }
+    o->links[o->links_num++] = link;
+  }
+
+  for (size_t i = 0; i < o->maps_num; i++) {
+    status = ebpf_map_init(o, o->maps + i);
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int ebpf_object_load */
+
+static int ebpf_init(void) /* {{{ */
+{
+  int loaded = 0;
+
+  libbpf_set_print(ebpf_libbpf_print);
+
+  for (size_t i = 0; i < objects_num; i++) {
+    ebpf_object_t *o = objects[i];
+
+    if (ebpf_object_load(o) != 0) {
+      ebpf_object_free(o);
+      continue;
+    }
+
+    char cb_name[DATA_MAX_NAME_LEN];
+    snprintf(cb_name, sizeof(cb_name), "ebpf-%s", o->name);
+    plugin_register_complex_read(
+        /* group = */ NULL, cb_name, ebpf_read, /* interval = */ 0,
+        &(user_data_t){.data = o, .free_func = ebpf_object_free});
+    loaded++;
+  }
+  sfree(objects);
+  objects_num = 0;
+
+  if (loaded == 0) {
+    ERROR("ebpf plugin: No object could be loaded.");
+    return -1;
+  }
+
+  return 0;
+} /* }}} int ebpf_init */
+
+static int ebpf_config_map(ebpf_object_t *o, oconfig_item_t *ci) /* {{{ */
+{
+  ebpf_map_t *tmp = realloc(o->maps, (o->maps_num + 1) * sizeof(*o->maps));
+  if (tmp == NULL)
+    return ENOMEM;
+  o->maps = tmp;
+
+  ebpf_map_t *m = o->maps + o->maps_num;
+  *m = (ebpf_map_t){
+      .key_format = KEY_INTEGER, .unit = 1e-9, .slot_size = sizeof(uint32_t),
+  };
+  o->maps_num++;
+
+  int status = cf_util_get_string(ci, &m->name);
+  if (status != 0)
+    return status;
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Type", child->key) == 0)
+      status = cf_util_get_string(child, &m->type);
+    else if (strcasecmp("Instance", child->key) == 0)
+      status = cf_util_get_string(child, &m->instance);
+    else if (strcasecmp("KeyFormat", child->key) == 0) {
+      char *format = NULL;
+      status = cf_util_get_string(child, &format);
+      if (status != 0)
+        break;
+      if (strcasecmp("Integer", format) == 0)
+        m->key_format = KEY_INTEGER;
+      else if (strcasecmp("String", format) == 0)
+        m->key_format = KEY_STRING;
+      else if (strcasecmp("Hex", format) == 0)
+        m->key_format = KEY_HEX;
+      else if (strcasecmp("None", format) == 0)
+        m->key_format = KEY_NONE;
+      else {
+        ERROR("ebpf plugin: Invalid KeyFormat \"%s\".", format);
+        status = EINVAL;
+      }
+      free(format);
+    } else if (strcasecmp("Unit", child->key) == 0) {
+      char *unit = NULL;
+      status = cf_util_get_string(child, &unit);
+      if (status != 0)
+        break;
+      if (strcasecmp("ns", unit) == 0)
+        m->unit = 1e-9;
+      else if (strcasecmp("us", unit) == 0)
+        m->unit = 1e-6;
+      else if (strcasecmp("ms", unit) == 0)
+        m->unit = 1e-3;
+      else if (strcasecmp("s", unit) == 0)
+        m->unit = 1.0;
+      else {
+        ERROR("ebpf plugin: Invalid Unit \"%s\".", unit);
+        status = EINVAL;
+      }
+      free(unit);
+    } else if (strcasecmp("SlotSize", child->key) == 0) {
+      int size = 0;
+      status = cf_util_get_int(child, &size);
+      if ((status == 0) && (size != 4) && (size != 8)) {
+        ERROR("ebpf plugin: SlotSize must be 4 or 8.");
+        status = EINVAL;
+      }
+      m->slot_size = (size_t)size;
+    } else if (strcasecmp("Slots", child->key) == 0) {
+      int slots = 0;
+      status = cf_util_get_int(child, &slots);
+      if ((status == 0) && (slots <= 0)) {
+        ERROR("ebpf plugin: Slots must be positive.");
+        status = EINVAL;
+      }
+      m->slots_num = (size_t)slots;
+    } else if (strcasecmp("Histogram", child->key) == 0) {
+      status = latency_config(&m->latency, child);
+      m->histogram = (status == 0);
+    } else {
+      WARNING("ebpf plugin: Ignoring unknown option \"%s\" in map \"%s\".",
+              child->key, m->name);
+    }
+
+    if (status != 0)
+      return status;
+  }
+
+  if (m->type == NULL) {
+    m->type = strdup(m->histogram ? "latency" : "derive");
+    if (m->type == NULL)
+      return ENOMEM;
+  }
+
+  return 0;
+} /* }}} int ebpf_config_map */
+
+static int ebpf_config_object(oconfig_item_t *ci) /* {{{ */
+{
+  ebpf_object_t *o = calloc(1, sizeof(*o));
+  if (o == NULL)
+    return ENOMEM;
+
+  int status = cf_util_get_string(ci, &o->name);
+
+  for (int i = 0; (status == 0) && (i < ci->children_num); i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("File", child->key) == 0)
+      status = cf_util_get_string(child, &o->file);
+    else if (strcasecmp("Map", child->key) == 0)
+      status = ebpf_config_map(o, child);
+    else
+      WARNING("ebpf plugin: Ignoring unknown option \"%s\" in object \"%s\".",
+              child->key, o->name);
+  }
+
+  if ((status == 0) && (o->file == NULL)) {
+    ERROR("ebpf plugin: Object \"%s\" has no File option.", o->name);
+    status = EINVAL;
+  }
+  if ((status == 0) && (o->maps_num == 0)) {
+    ERROR("ebpf plugin: Object \"%s\" has no Map blocks.", o->name);
+    status = EINVAL;
+  }
+
+  ebpf_object_t **tmp = NULL;
+  if (status == 0) {
+    tmp = realloc(objects, (objects_num + 1) * sizeof(*objects));
+    if (tmp == NULL)
+      status = ENOMEM;
+  }
+
+  if (status != 0) {
+    ebpf_object_free(o);
+    return status;
+  }
+
+  objects = tmp;
+  objects[objects_num++] = o;
+  return 0;
+} /* }}} int ebpf_config_object */
+
+static int ebpf_config(oconfig_item_t *ci) /* {{{ */
+{
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Object", child->key) == 0)
+      ebpf_config_object(child);
+    else
+      WARNING("ebpf plugin: Ignoring unknown option \"%s\".", child->key);
+  }
+
+  return 0;
+} /* }}} int ebpf_config */
+
+void module_register(void) {
+  plugin_register_complex_config("ebpf", ebpf_config);
+  plugin_register_init("ebpf", ebpf_init);
+} /* void module_register */
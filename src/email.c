@@ -45,8 +45,11 @@
 
 #include <stddef.h>
 
-#include <sys/select.h>
+#include <poll.h>
 #include <sys/un.h>
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 /* some systems (e.g. Darwin) seem to not define UNIX_PATH_MAX at all */
 #ifndef UNIX_PATH_MAX
@@ -60,6 +63,16 @@
 #define SOCK_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-email"
 #define MAX_CONNS 5
 #define MAX_CONNS_LIMIT 16384
+#define WORKER_THREADS 4
+
+/* 256 bytes ought to be enough for anybody ;-) */
+#define LINE_SIZE 256
+/* Room for many lines, so that a burst of updates is handled per read. */
+#define BUFFER_SIZE 4096
+#define TABLE_SIZE_MIN 16
+#define EVENTS_MAX 64
+/* How often the listener checks whether the plugin is shutting down. */
+#define POLL_TIMEOUT_MS 1000
 
 #define log_debug(...) DEBUG("email: "__VA_ARGS__)
 #define log_err(...) ERROR("email: "__VA_ARGS__)
@@ -68,46 +81,53 @@
 /*
  * Private data structures
  */
-/* linked list of email and check types */
+/* email and check types */
 typedef struct type {
   char *name;
+  uint64_t hash;
   int value;
-  struct type *next;
 } type_t;
 
+/* Hash table of types, using open addressing with linear probing. Types are
+ * never removed, so their names stay valid until the plugin shuts down. */
 typedef struct {
-  type_t *head;
-  type_t *tail;
-} type_list_t;
-
-/* collector thread control information */
-typedef struct collector {
-  pthread_t thread;
-
-  /* socket descriptor of the current/last connection */
-  FILE *socket;
-} collector_t;
-
-/* linked list of pending connections */
+  type_t *slots;
+  size_t size; /* zero or a power of two */
+  size_t num;
+} type_table_t;
+
+/* A client connection. The updates read from it are accumulated here and
+ * published once per read, so that the global locks are taken once for a
+ * whole batch of lines instead of once per line. */
 typedef struct conn {
-  /* socket to read data from */
-  FILE *socket;
-
-  /* linked list of connections */
+  int fd;
+
+  char buffer[BUFFER_SIZE];
+  size_t fill;
+  /* set while skipping the rest of a line that is too long */
+  bool discard;
+
+  bool pending;
+  type_table_t count;
+  type_table_t size;
+  type_table_t check;
+  double score_sum;
+  int score_count;
+
+  /* linked list of open connections */
+  struct conn *prev;
   struct conn *next;
-} conn_t;
 
-typedef struct {
-  conn_t *head;
-  conn_t *tail;
-} conn_list_t;
+  /* linked list of connections waiting for a worker */
+  struct conn *queue_next;
+} conn_t;
 
 /*
  * Private variables
  */
 /* valid configuration file keys */
 static const char *config_keys[] = {"SocketFile", "SocketGroup", "SocketPerms",
-                                    "MaxConns"};
+                                    "MaxConns", "WorkerThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /* socket configuration */
@@ -115,45 +135,55 @@ static char *sock_file;
 static char *sock_group;
 static int sock_perms = S_IRWXU | S_IRWXG;
 static int max_conns = MAX_CONNS;
+static int worker_threads = WORKER_THREADS;
 
 /* state of the plugin */
 static int disabled;
+static bool loop;
 
 /* thread managing "client" connections */
 static pthread_t connector = (pthread_t)0;
 static int connector_socket = -1;
 
-/* tell the collector threads that a new connection is available */
-static pthread_cond_t conn_available = PTHREAD_COND_INITIALIZER;
+#if HAVE_SYS_EPOLL_H
+static int epoll_fd = -1;
+#endif
 
-/* connections that are waiting to be processed */
+/* open connections */
 static pthread_mutex_t conns_mutex = PTHREAD_MUTEX_INITIALIZER;
-static conn_list_t conns;
+static conn_t *conns;
+static int conns_num;
 
-/* tell the connector thread that a collector is available */
-static pthread_cond_t collector_available = PTHREAD_COND_INITIALIZER;
+/* tell the connector thread that fewer than MaxConns connections are open */
+static pthread_cond_t conn_closed = PTHREAD_COND_INITIALIZER;
 
-/* collector threads */
-static collector_t **collectors;
+/* connections that are waiting to be processed */
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t conn_available = PTHREAD_COND_INITIALIZER;
+static conn_t *queue_head;
+static conn_t *queue_tail;
 
-static pthread_mutex_t available_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int available_collectors;
+/* worker threads */
+static pthread_t *workers;
+static size_t workers_num;
+static bool workers_stop;
 
 static pthread_mutex_t count_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_count;
-static type_list_t list_count_copy;
+static type_table_t table_count;
 
 static pthread_mutex_t size_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_size;
-static type_list_t list_size_copy;
+static type_table_t table_size;
 
 static pthread_mutex_t score_mutex = PTHREAD_MUTEX_INITIALIZER;
-static double score;
+static double score_sum;
 static int score_count;
 
 static pthread_mutex_t check_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_check;
-static type_list_t list_check_copy;
+static type_table_t table_check;
+
+/* the values of one table as of the last read */
+static type_t *types_copy;
+static size_t types_copy_size;
 
 /*
  * Private functions
@@ -192,170 +222,564 @@ static int email_config(const char *key, const char *value) {
     } else {
       max_conns = (int)tmp;
     }
+  } else if (strcasecmp(key, "WorkerThreads") == 0) {
+    long int tmp = strtol(value, NULL, 0);
+
+    if (tmp < 1) {
+      ERROR("email plugin: `WorkerThreads' was set to invalid "
+            "value %li, will use default %i.",
+            tmp, WORKER_THREADS);
+      worker_threads = WORKER_THREADS;
+    } else {
+      worker_threads = (int)((tmp > MAX_CONNS_LIMIT) ? MAX_CONNS_LIMIT : tmp);
+    }
   } else {
     return -1;
   }
   return 0;
 } /* static int email_config (char *, char *) */
 
-/* Increment the value of the given name in the given list by incr. */
-static void type_list_incr(type_list_t *list, char *name, int incr) {
-  if (list->head == NULL) {
-    list->head = smalloc(sizeof(*list->head));
+static uint64_t type_hash(char const *name) {
+  /* FNV-1a */
+  uint64_t hash = 14695981039346656037ULL;
 
-    list->head->name = sstrdup(name);
-    list->head->value = incr;
-    list->head->next = NULL;
+  for (char const *c = name; *c != 0; c++)
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
 
-    list->tail = list->head;
-  } else {
-    type_t *ptr;
+  return hash;
+} /* static uint64_t type_hash (char const *) */
 
-    for (ptr = list->head; NULL != ptr; ptr = ptr->next) {
-      if (strcmp(name, ptr->name) == 0)
-        break;
-    }
+static int type_table_grow(type_table_t *t) {
+  size_t size = (t->size > 0) ? (2 * t->size) : TABLE_SIZE_MIN;
+
+  type_t *slots = calloc(size, sizeof(*slots));
+  if (slots == NULL) {
+    log_err("calloc failed.");
+    return ENOMEM;
+  }
 
-    if (ptr == NULL) {
-      list->tail->next = smalloc(sizeof(*list->tail->next));
-      list->tail = list->tail->next;
+  for (size_t i = 0; i < t->size; i++) {
+    if (t->slots[i].name == NULL)
+      continue;
 
-      list->tail->name = sstrdup(name);
-      list->tail->value = incr;
-      list->tail->next = NULL;
-    } else {
-      ptr->value += incr;
+    size_t j = (size_t)t->slots[i].hash & (size - 1);
+    while (slots[j].name != NULL)
+      j = (j + 1) & (size - 1);
+    slots[j] = t->slots[i];
+  }
+
+  sfree(t->slots);
+  t->slots = slots;
+  t->size = size;
+  return 0;
+} /* static int type_table_grow (type_table_t *) */
+
+/* Returns the type called "name", adding it if necessary, or NULL if it
+ * cannot be added. "hash" is the type_hash() of the name. */
+static type_t *type_table_get(type_table_t *t, char const *name,
+                              uint64_t hash) {
+  size_t i;
+
+  if (t->size > 0) {
+    for (i = (size_t)hash & (t->size - 1); t->slots[i].name != NULL;
+         i = (i + 1) & (t->size - 1)) {
+      if ((t->slots[i].hash == hash) && (strcmp(name, t->slots[i].name) == 0))
+        return t->slots + i;
     }
   }
-  return;
-} /* static void type_list_incr (type_list_t *, char *) */
 
-static void *collect(void *arg) {
-  collector_t *this = (collector_t *)arg;
+  /* keep the table at most three quarters full */
+  if ((4 * (t->num + 1) > 3 * t->size) && (type_table_grow(t) != 0))
+    return NULL;
 
-  while (1) {
-    conn_t *connection;
+  char *copy = strdup(name);
+  if (copy == NULL) {
+    log_err("strdup failed.");
+    return NULL;
+  }
 
-    pthread_mutex_lock(&conns_mutex);
+  i = (size_t)hash & (t->size - 1);
+  while (t->slots[i].name != NULL)
+    i = (i + 1) & (t->size - 1);
+
+  t->slots[i] = (type_t){.name = copy, .hash = hash, .value = 0};
+  t->num++;
+  return t->slots + i;
+} /* static type_t *type_table_get (type_table_t *, char const *, uint64_t) */
+
+/* Increment the value of the given name in the given table by incr. */
+static void type_table_incr(type_table_t *t, char const *name, int incr) {
+  type_t *type = type_table_get(t, name, type_hash(name));
+  if (type != NULL)
+    type->value += incr;
+} /* static void type_table_incr (type_table_t *, char const *, int) */
+
+/* Add the values of src to dst and reset them to zero. */
+static void type_table_merge(type_table_t *dst, type_table_t *src) {
+  for (size_t i = 0; i < src->size; i++) {
+    type_t *s = src->slots + i;
+    if ((s->name == NULL) || (s->value == 0))
+      continue;
 
-    while (conns.head == NULL) {
-      pthread_cond_wait(&conn_available, &conns_mutex);
+    type_t *d = type_table_get(dst, s->name, s->hash);
+    if (d != NULL)
+      d->value += s->value;
+    s->value = 0;
+  }
+} /* static void type_table_merge (type_table_t *, type_table_t *) */
+
+/* Copy the types of t to types_copy and reset their values to zero. The
+ * names are shared with t. Returns the number of types copied. */
+static size_t type_table_copy(type_table_t *t) {
+  if (types_copy_size < t->num) {
+    type_t *tmp = realloc(types_copy, t->num * sizeof(*tmp));
+    if (tmp == NULL) {
+      log_err("realloc failed.");
+      return 0;
     }
+    types_copy = tmp;
+    types_copy_size = t->num;
+  }
+
+  size_t num = 0;
+  for (size_t i = 0; i < t->size; i++) {
+    if (t->slots[i].name == NULL)
+      continue;
+
+    types_copy[num] = t->slots[i];
+    t->slots[i].value = 0;
+    num++;
+  }
+  return num;
+} /* static size_t type_table_copy (type_table_t *) */
+
+static void type_table_free(type_table_t *t) {
+  for (size_t i = 0; i < t->size; i++)
+    sfree(t->slots[i].name);
+  sfree(t->slots);
+
+  t->size = 0;
+  t->num = 0;
+} /* static void type_table_free (type_table_t *) */
+
+/* Account a line received from the connection. */
+static void handle_line(conn_t *c, char *line) {
+  if (strlen(line) < 2) /* [a-z] ':' */
+    return;
 
-    connection = conns.head;
-    conns.head = conns.head->next;
+  log_debug("collect: line = '%s'", line);
 
-    if (conns.head == NULL) {
-      conns.tail = NULL;
+  if (line[1] != ':') {
+    log_err("collect: syntax error in line '%s'", line);
+    return;
+  }
+
+  if (line[0] == 'e') { /* e:<type>:<bytes> */
+    char *type = line + 2;
+    char *bytes_str = strchr(type, ':');
+    if (bytes_str == NULL) {
+      log_err("collect: syntax error in line '%s'", line);
+      return;
     }
 
-    pthread_mutex_unlock(&conns_mutex);
+    *bytes_str = 0;
+    bytes_str++;
+
+    type_table_incr(&c->count, type, /* increment = */ 1);
+
+    int bytes = atoi(bytes_str);
+    if (bytes > 0)
+      type_table_incr(&c->size, type, /* increment = */ bytes);
+  } else if (line[0] == 's') { /* s:<value> */
+    c->score_sum += atof(line + 2);
+    c->score_count++;
+  } else if (line[0] == 'c') { /* c:<type1>[,<type2>,...] */
+    char *dummy = line + 2;
+    char *endptr = NULL;
+    char *type;
+
+    while ((type = strtok_r(dummy, ",", &endptr)) != NULL) {
+      dummy = NULL;
+      type_table_incr(&c->check, type, /* increment = */ 1);
+    }
+  } else {
+    log_err("collect: unknown type '%c'", line[0]);
+    return;
+  }
 
-    /* make the socket available to the global
-     * thread and connection management */
-    this->socket = connection->socket;
+  c->pending = true;
+} /* static void handle_line (conn_t *, char *) */
 
-    log_debug("collect: handling connection on fd #%i", fileno(this->socket));
+/* Publish the updates accumulated by the connection. */
+static void conn_publish(conn_t *c) {
+  if (!c->pending)
+    return;
 
-    while (42) {
-      /* 256 bytes ought to be enough for anybody ;-) */
-      char line[256 + 1]; /* line + '\0' */
+  pthread_mutex_lock(&count_mutex);
+  type_table_merge(&table_count, &c->count);
+  pthread_mutex_unlock(&count_mutex);
 
-      errno = 0;
-      if (fgets(line, sizeof(line), this->socket) == NULL) {
-        if (errno != 0) {
-          log_err("collect: reading from socket (fd #%i) "
-                  "failed: %s",
-                  fileno(this->socket), STRERRNO);
-        }
-        break;
-      }
+  pthread_mutex_lock(&size_mutex);
+  type_table_merge(&table_size, &c->size);
+  pthread_mutex_unlock(&size_mutex);
 
-      size_t len = strlen(line);
-      if ((line[len - 1] != '\n') && (line[len - 1] != '\r')) {
-        log_warn("collect: line too long (> %" PRIsz " characters): "
-                 "'%s' (truncated)",
-                 sizeof(line) - 1, line);
+  if (c->score_count > 0) {
+    pthread_mutex_lock(&score_mutex);
+    score_sum += c->score_sum;
+    score_count += c->score_count;
+    pthread_mutex_unlock(&score_mutex);
 
-        while (fgets(line, sizeof(line), this->socket) != NULL)
-          if ((line[len - 1] == '\n') || (line[len - 1] == '\r'))
-            break;
-        continue;
-      }
-      if (len < 3) { /* [a-z] ':' '\n' */
-        continue;
-      }
+    c->score_sum = 0.0;
+    c->score_count = 0;
+  }
+
+  pthread_mutex_lock(&check_mutex);
+  type_table_merge(&table_check, &c->check);
+  pthread_mutex_unlock(&check_mutex);
 
-      line[len - 1] = '\0';
+  c->pending = false;
+} /* static void conn_publish (conn_t *) */
+
+/* Read from a connection and handle all complete lines. Returns non-zero if
+ * the connection is to be closed. */
+static int conn_read(conn_t *c, int flags) {
+  /* leave room for a terminating null byte */
+  ssize_t len =
+      recv(c->fd, c->buffer + c->fill, sizeof(c->buffer) - 1 - c->fill, flags);
+  if (len < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+      return 0;
+
+    log_err("collect: reading from socket (fd #%i) failed: %s", c->fd,
+            STRERRNO);
+    return -1;
+  } else if (len == 0) {
+    return -1;
+  }
+  c->fill += (size_t)len;
 
-      log_debug("collect: line = '%s'", line);
+  size_t offset = 0;
+  char *end;
+  while ((end = memchr(c->buffer + offset, '\n', c->fill - offset)) != NULL) {
+    char *line = c->buffer + offset;
 
-      if (line[1] != ':') {
-        log_err("collect: syntax error in line '%s'", line);
-        continue;
-      }
+    *end = '\0';
+    offset = (size_t)(end - c->buffer) + 1;
 
-      if (line[0] == 'e') { /* e:<type>:<bytes> */
-        char *type = line + 2;
-        char *bytes_str = strchr(type, ':');
-        if (bytes_str == NULL) {
-          log_err("collect: syntax error in line '%s'", line);
-          continue;
-        }
-
-        *bytes_str = 0;
-        bytes_str++;
-
-        pthread_mutex_lock(&count_mutex);
-        type_list_incr(&list_count, type, /* increment = */ 1);
-        pthread_mutex_unlock(&count_mutex);
-
-        int bytes = atoi(bytes_str);
-        if (bytes > 0) {
-          pthread_mutex_lock(&size_mutex);
-          type_list_incr(&list_size, type, /* increment = */ bytes);
-          pthread_mutex_unlock(&size_mutex);
-        }
-      } else if (line[0] == 's') { /* s:<value> */
-        pthread_mutex_lock(&score_mutex);
-        score = (score * (double)score_count + atof(line + 2)) /
-                (double)(score_count + 1);
-        ++score_count;
-        pthread_mutex_unlock(&score_mutex);
-      } else if (line[0] == 'c') { /* c:<type1>[,<type2>,...] */
-        char *dummy = line + 2;
-        char *endptr = NULL;
-        char *type;
-
-        pthread_mutex_lock(&check_mutex);
-        while ((type = strtok_r(dummy, ",", &endptr)) != NULL) {
-          dummy = NULL;
-          type_list_incr(&list_check, type, /* increment = */ 1);
-        }
-        pthread_mutex_unlock(&check_mutex);
-      } else {
-        log_err("collect: unknown type '%c'", line[0]);
-      }
-    } /* while (42) */
+    if (c->discard) {
+      c->discard = false;
+      continue;
+    }
+
+    if ((size_t)(end - line) > LINE_SIZE) {
+      log_warn("collect: line too long (> %i characters): '%.*s' (truncated)",
+               LINE_SIZE, LINE_SIZE, line);
+      continue;
+    }
+
+    handle_line(c, line);
+  }
 
-    log_debug("Shutting down connection on fd #%i", fileno(this->socket));
+  if (offset > 0) {
+    memmove(c->buffer, c->buffer + offset, c->fill - offset);
+    c->fill -= offset;
+  }
 
-    fclose(connection->socket);
-    free(connection);
+  if (c->fill >= sizeof(c->buffer) - 1) {
+    c->buffer[LINE_SIZE] = '\0';
+    log_warn("collect: line too long (> %i characters): '%s' (truncated)",
+             LINE_SIZE, c->buffer);
+    c->discard = true;
+    c->fill = 0;
+  }
 
-    this->socket = NULL;
+  conn_publish(c);
+  return 0;
+} /* static int conn_read (conn_t *, int) */
+
+#if HAVE_SYS_EPOLL_H
+/* Re-enable the events of a connection after a worker has handled it.
+ * EPOLLONESHOT makes sure that only one worker handles a connection at a
+ * time. */
+static int conn_arm(conn_t *c, int op) {
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = c};
+  if (epoll_ctl(epoll_fd, op, c->fd, &ev) != 0) {
+    log_err("epoll_ctl() failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* static int conn_arm (conn_t *, int) */
+
+/* The listening socket is the event without a connection. It is only armed
+ * while fewer than MaxConns connections are open; further clients wait in the
+ * listen backlog. Must hold conns_mutex when calling this function. */
+static int listener_arm(int op) {
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = NULL};
+  if (epoll_ctl(epoll_fd, op, connector_socket, &ev) != 0) {
+    log_err("epoll_ctl() failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* static int listener_arm (int) */
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* Takes ownership of "fd": it is closed if the connection cannot be added. */
+static conn_t *conn_add(int fd) {
+  conn_t *c = calloc(1, sizeof(*c));
+  if (c == NULL) {
+    log_err("calloc failed.");
+    close(fd);
+    return NULL;
+  }
+  c->fd = fd;
 
-    pthread_mutex_lock(&available_mutex);
-    ++available_collectors;
-    pthread_mutex_unlock(&available_mutex);
+  pthread_mutex_lock(&conns_mutex);
+  c->next = conns;
+  if (conns != NULL)
+    conns->prev = c;
+  conns = c;
+  conns_num++;
+  pthread_mutex_unlock(&conns_mutex);
 
-    pthread_cond_signal(&collector_available);
-  } /* while (1) */
+  return c;
+} /* static conn_t *conn_add (int) */
+
+static void conn_close(conn_t *c) {
+  log_debug("Shutting down connection on fd #%i", c->fd);
+
+#if HAVE_SYS_EPOLL_H
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, /* event = */ NULL);
+#endif
+  close(c->fd);
+
+  pthread_mutex_lock(&conns_mutex);
+  if (c->prev != NULL)
+    c->prev->next = c->next;
+  else
+    conns = c->next;
+  if (c->next != NULL)
+    c->next->prev = c->prev;
+
+#if HAVE_SYS_EPOLL_H
+  if ((conns_num == max_conns) && loop)
+    listener_arm(EPOLL_CTL_MOD);
+#endif
+  conns_num--;
+  pthread_cond_signal(&conn_closed);
+  pthread_mutex_unlock(&conns_mutex);
+
+  type_table_free(&c->count);
+  type_table_free(&c->size);
+  type_table_free(&c->check);
+  sfree(c);
+} /* static void conn_close (conn_t *) */
+
+static void conn_enqueue(conn_t *c) {
+  pthread_mutex_lock(&queue_mutex);
+  if (queue_tail == NULL)
+    queue_head = c;
+  else
+    queue_tail->queue_next = c;
+  queue_tail = c;
+  pthread_cond_signal(&conn_available);
+  pthread_mutex_unlock(&queue_mutex);
+} /* static void conn_enqueue (conn_t *) */
+
+static void *collect(void __attribute__((unused)) * arg) {
+  pthread_mutex_lock(&queue_mutex);
+  while (!workers_stop) {
+    if (queue_head == NULL) {
+      pthread_cond_wait(&conn_available, &queue_mutex);
+      continue;
+    }
+
+    conn_t *c = queue_head;
+    queue_head = c->queue_next;
+    if (queue_head == NULL)
+      queue_tail = NULL;
+    c->queue_next = NULL;
+    pthread_mutex_unlock(&queue_mutex);
+
+#if HAVE_SYS_EPOLL_H
+    if ((conn_read(c, MSG_DONTWAIT) != 0) || (conn_arm(c, EPOLL_CTL_MOD) != 0))
+      conn_close(c);
+#else
+    /* without epoll, every connection occupies a worker until it is closed */
+    log_debug("collect: handling connection on fd #%i", c->fd);
+    while (conn_read(c, /* flags = */ 0) == 0)
+      /* nothing */;
+    conn_close(c);
+#endif
+
+    pthread_mutex_lock(&queue_mutex);
+  }
+  pthread_mutex_unlock(&queue_mutex);
 
-  pthread_exit((void *)0);
   return (void *)0;
 } /* static void *collect (void *) */
 
+static int workers_start(void) {
+#if HAVE_SYS_EPOLL_H
+  int num = (worker_threads < max_conns) ? worker_threads : max_conns;
+#else
+  int num = max_conns;
+#endif
+
+  workers = calloc((size_t)num, sizeof(*workers));
+  if (workers == NULL) {
+    log_err("calloc failed.");
+    return -1;
+  }
+
+  workers_stop = false;
+  for (int i = 0; i < num; i++) {
+    if (plugin_thread_create(&workers[workers_num], /* attr = */ NULL, collect,
+                             /* arg = */ NULL, "email collector") != 0) {
+      log_err("plugin_thread_create() failed: %s", STRERRNO);
+      continue;
+    }
+    workers_num++;
+  }
+
+  return (workers_num > 0) ? 0 : -1;
+} /* static int workers_start (void) */
+
+static void workers_stop_all(void) {
+  pthread_mutex_lock(&queue_mutex);
+  workers_stop = true;
+  pthread_cond_broadcast(&conn_available);
+  pthread_mutex_unlock(&queue_mutex);
+
+#if !HAVE_SYS_EPOLL_H
+  /* wake up the workers blocked in recv() */
+  pthread_mutex_lock(&conns_mutex);
+  for (conn_t *c = conns; c != NULL; c = c->next)
+    shutdown(c->fd, SHUT_RDWR);
+  pthread_mutex_unlock(&conns_mutex);
+#endif
+
+  for (size_t i = 0; i < workers_num; i++)
+    pthread_join(workers[i], /* retval = */ NULL);
+  sfree(workers);
+  workers_num = 0;
+
+  /* connections still waiting for a worker are closed by the caller */
+  queue_head = queue_tail = NULL;
+} /* static void workers_stop_all (void) */
+
+#if HAVE_SYS_EPOLL_H
+static void email_accept(void) {
+  int remote = accept(connector_socket, NULL, NULL);
+  if (remote == -1) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      log_err("accept() failed: %s", STRERRNO);
+  } else {
+    conn_t *c = conn_add(remote);
+    if ((c != NULL) && (conn_arm(c, EPOLL_CTL_ADD) != 0))
+      conn_close(c);
+  }
+
+  pthread_mutex_lock(&conns_mutex);
+  if (conns_num < max_conns)
+    listener_arm(EPOLL_CTL_MOD);
+  pthread_mutex_unlock(&conns_mutex);
+} /* static void email_accept (void) */
+
+/* Wait for new connections and for data on the open ones; the data is read by
+ * a fixed pool of worker threads. */
+static void serve(void) {
+  struct epoll_event events[EVENTS_MAX];
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    disabled = 1;
+    log_err("epoll_create1() failed: %s", STRERRNO);
+    return;
+  }
+
+  pthread_mutex_lock(&conns_mutex);
+  int status = listener_arm(EPOLL_CTL_ADD);
+  pthread_mutex_unlock(&conns_mutex);
+  if ((status != 0) || (workers_start() != 0)) {
+    disabled = 1;
+    log_err("Starting the server failed.");
+    loop = false;
+  }
+
+  while (loop) {
+    int num = epoll_wait(epoll_fd, events, EVENTS_MAX, POLL_TIMEOUT_MS);
+    if (num < 0) {
+      if (errno == EINTR)
+        continue;
+
+      disabled = 1;
+      log_err("epoll_wait() failed: %s", STRERRNO);
+      break;
+    }
+
+    for (int i = 0; i < num; i++) {
+      if (events[i].data.ptr == NULL)
+        email_accept();
+      else
+        conn_enqueue(events[i].data.ptr);
+    }
+  }
+
+  workers_stop_all();
+  while (conns != NULL)
+    conn_close(conns);
+
+  close(epoll_fd);
+  epoll_fd = -1;
+} /* static void serve (void) */
+#else  /* !HAVE_SYS_EPOLL_H */
+/* Accept connections and hand them to the worker threads, each of which
+ * handles one connection at a time. */
+static void serve(void) {
+  if (workers_start() != 0) {
+    disabled = 1;
+    log_err("Starting the server failed.");
+    loop = false;
+  }
+
+  while (loop) {
+    pthread_mutex_lock(&conns_mutex);
+    while ((conns_num >= max_conns) && loop)
+      pthread_cond_wait(&conn_closed, &conns_mutex);
+    pthread_mutex_unlock(&conns_mutex);
+
+    struct pollfd pfd = {.fd = connector_socket, .events = POLLIN};
+    int status = poll(&pfd, 1, POLL_TIMEOUT_MS);
+    if (status <= 0) {
+      if ((status == 0) || (errno == EINTR))
+        continue;
+
+      disabled = 1;
+      log_err("poll() failed: %s", STRERRNO);
+      break;
+    }
+
+    int remote = accept(connector_socket, NULL, NULL);
+    if (remote == -1) {
+      if (errno == EINTR)
+        continue;
+
+      disabled = 1;
+      log_err("accept() failed: %s", STRERRNO);
+      break;
+    }
+
+    conn_t *c = conn_add(remote);
+    if (c != NULL)
+      conn_enqueue(c);
+  }
+
+  workers_stop_all();
+  while (conns != NULL)
+    conn_close(conns);
+} /* static void serve (void) */
+#endif /* HAVE_SYS_EPOLL_H */
+
 static void *open_connection(void __attribute__((unused)) * arg) {
   const char *path = (NULL == sock_file) ? SOCK_PATH : sock_file;
   const char *group = (NULL == sock_group) ? COLLECTD_GRP_NAME : sock_group;
@@ -425,105 +849,22 @@ static void *open_connection(void __attribute__((unused)) * arg) {
     log_warn("chmod() failed: %s", STRERRNO);
   }
 
-  { /* initialize collector threads */
-    pthread_attr_t ptattr;
-
-    conns.head = NULL;
-    conns.tail = NULL;
-
-    pthread_attr_init(&ptattr);
-    pthread_attr_setdetachstate(&ptattr, PTHREAD_CREATE_DETACHED);
-
-    available_collectors = max_conns;
-
-    collectors = smalloc(max_conns * sizeof(*collectors));
-
-    for (int i = 0; i < max_conns; ++i) {
-      collectors[i] = smalloc(sizeof(*collectors[i]));
-      collectors[i]->socket = NULL;
-
-      if (plugin_thread_create(&collectors[i]->thread, &ptattr, collect,
-                               collectors[i], "email collector") != 0) {
-        log_err("plugin_thread_create() failed: %s", STRERRNO);
-        collectors[i]->thread = (pthread_t)0;
-      }
-    }
-
-    pthread_attr_destroy(&ptattr);
-  }
-
-  while (1) {
-    int remote = 0;
-
-    conn_t *connection;
-
-    pthread_mutex_lock(&available_mutex);
-
-    while (available_collectors == 0) {
-      pthread_cond_wait(&collector_available, &available_mutex);
-    }
-
-    --available_collectors;
-
-    pthread_mutex_unlock(&available_mutex);
-
-    while (42) {
-      errno = 0;
-
-      remote = accept(connector_socket, NULL, NULL);
-      if (remote == -1) {
-        if (errno == EINTR)
-          continue;
-
-        disabled = 1;
-        close(connector_socket);
-        connector_socket = -1;
-        log_err("accept() failed: %s", STRERRNO);
-        pthread_exit((void *)1);
-      }
-
-      /* access() succeeded. */
-      break;
-    }
-
-    connection = calloc(1, sizeof(*connection));
-    if (connection == NULL) {
-      close(remote);
-      continue;
-    }
-
-    connection->socket = fdopen(remote, "r");
-    connection->next = NULL;
-
-    if (connection->socket == NULL) {
-      close(remote);
-      sfree(connection);
-      continue;
-    }
-
-    pthread_mutex_lock(&conns_mutex);
-
-    if (conns.head == NULL) {
-      conns.head = connection;
-      conns.tail = connection;
-    } else {
-      conns.tail->next = connection;
-      conns.tail = conns.tail->next;
-    }
+  serve();
 
-    pthread_mutex_unlock(&conns_mutex);
-
-    pthread_cond_signal(&conn_available);
-  }
+  close(connector_socket);
+  connector_socket = -1;
 
   pthread_exit((void *)0);
   return (void *)0;
 } /* static void *open_connection (void *) */
 
 static int email_init(void) {
+  loop = true;
+
   if (plugin_thread_create(&connector, NULL, open_connection, NULL,
                            "email listener") != 0) {
     disabled = 1;
+    connector = (pthread_t)0;
     log_err("plugin_thread_create() failed: %s", STRERRNO);
     return -1;
   }
@@ -531,67 +872,24 @@ static int email_init(void) {
   return 0;
 } /* int email_init */
 
-static void type_list_free(type_list_t *t) {
-  type_t *this;
-
-  this = t->head;
-  while (this != NULL) {
-    type_t *next = this->next;
-
-    sfree(this->name);
-    sfree(this);
-
-    this = next;
-  }
-
-  t->head = NULL;
-  t->tail = NULL;
-}
-
 static int email_shutdown(void) {
+  loop = false;
+
   if (connector != ((pthread_t)0)) {
+    pthread_mutex_lock(&conns_mutex);
+    pthread_cond_broadcast(&conn_closed);
+    pthread_mutex_unlock(&conns_mutex);
+
     pthread_kill(connector, SIGTERM);
+    pthread_join(connector, /* retval = */ NULL);
     connector = (pthread_t)0;
   }
 
-  if (connector_socket >= 0) {
-    close(connector_socket);
-    connector_socket = -1;
-  }
-
-  /* don't allow any more connections to be processed */
-  pthread_mutex_lock(&conns_mutex);
-
-  available_collectors = 0;
-
-  if (collectors != NULL) {
-    for (int i = 0; i < max_conns; ++i) {
-      if (collectors[i] == NULL)
-        continue;
-
-      if (collectors[i]->thread != ((pthread_t)0)) {
-        pthread_kill(collectors[i]->thread, SIGTERM);
-        collectors[i]->thread = (pthread_t)0;
-      }
-
-      if (collectors[i]->socket != NULL) {
-        fclose(collectors[i]->socket);
-        collectors[i]->socket = NULL;
-      }
-
-      sfree(collectors[i]);
-    }
-    sfree(collectors);
-  } /* if (collectors != NULL) */
-
-  pthread_mutex_unlock(&conns_mutex);
-
-  type_list_free(&list_count);
-  type_list_free(&list_count_copy);
-  type_list_free(&list_size);
-  type_list_free(&list_size_copy);
-  type_list_free(&list_check);
-  type_list_free(&list_check_copy);
+  type_table_free(&table_count);
+  type_table_free(&table_size);
+  type_table_free(&table_check);
+  sfree(types_copy);
+  types_copy_size = 0;
 
   unlink((sock_file == NULL) ? SOCK_PATH : sock_file);
 
@@ -613,42 +911,10 @@ static void email_submit(const char *type, const char *type_instance,
   plugin_dispatch_values(&vl);
 } /* void email_submit */
 
-/* Copy list l1 to list l2. l2 may partly exist already, but it is assumed
- * that neither the order nor the name of any element of either list is
- * changed and no elements are deleted. The values of l1 are reset to zero
- * after they have been copied to l2. */
-static void copy_type_list(type_list_t *l1, type_list_t *l2) {
-  type_t *last = NULL;
-
-  for (type_t *ptr1 = l1->head, *ptr2 = l2->head; ptr1 != NULL;
-       ptr1 = ptr1->next, last = ptr2, ptr2 = ptr2->next) {
-    if (ptr2 == NULL) {
-      ptr2 = smalloc(sizeof(*ptr2));
-      ptr2->name = NULL;
-      ptr2->next = NULL;
-
-      if (last == NULL) {
-        l2->head = ptr2;
-      } else {
-        last->next = ptr2;
-      }
-
-      l2->tail = ptr2;
-    }
-
-    if (ptr2->name == NULL) {
-      ptr2->name = sstrdup(ptr1->name);
-    }
-
-    ptr2->value = ptr1->value;
-    ptr1->value = 0;
-  }
-  return;
-}
-
 static int email_read(void) {
-  double score_old;
+  double score_sum_old;
   int score_count_old;
+  size_t num;
 
   if (disabled)
     return -1;
@@ -656,47 +922,47 @@ static int email_read(void) {
   /* email count */
   pthread_mutex_lock(&count_mutex);
 
-  copy_type_list(&list_count, &list_count_copy);
+  num = type_table_copy(&table_count);
 
   pthread_mutex_unlock(&count_mutex);
 
-  for (type_t *ptr = list_count_copy.head; ptr != NULL; ptr = ptr->next) {
-    email_submit("email_count", ptr->name, ptr->value);
+  for (size_t i = 0; i < num; i++) {
+    email_submit("email_count", types_copy[i].name, types_copy[i].value);
   }
 
   /* email size */
   pthread_mutex_lock(&size_mutex);
 
-  copy_type_list(&list_size, &list_size_copy);
+  num = type_table_copy(&table_size);
 
   pthread_mutex_unlock(&size_mutex);
 
-  for (type_t *ptr = list_size_copy.head; ptr != NULL; ptr = ptr->next) {
-    email_submit("email_size", ptr->name, ptr->value);
+  for (size_t i = 0; i < num; i++) {
+    email_submit("email_size", types_copy[i].name, types_copy[i].value);
   }
 
   /* spam score */
   pthread_mutex_lock(&score_mutex);
 
-  score_old = score;
+  score_sum_old = score_sum;
   score_count_old = score_count;
-  score = 0.0;
+  score_sum = 0.0;
   score_count = 0;
 
   pthread_mutex_unlock(&score_mutex);
 
   if (score_count_old > 0)
-    email_submit("spam_score", "", score_old);
+    email_submit("spam_score", "", score_sum_old / (double)score_count_old);
 
   /* spam checks */
   pthread_mutex_lock(&check_mutex);
 
-  copy_type_list(&list_check, &list_check_copy);
+  num = type_table_copy(&table_check);
 
   pthread_mutex_unlock(&check_mutex);
 
-  for (type_t *ptr = list_check_copy.head; ptr != NULL; ptr = ptr->next)
-    email_submit("spam_check", ptr->name, ptr->value);
+  for (size_t i = 0; i < num; i++)
+    email_submit("spam_check", types_copy[i].name, types_copy[i].value);
 
   return 0;
 } /* int email_read */
@@ -48,31 +48,50 @@ struct value_map_s {
 };
 typedef struct value_map_s value_map_t;
 
-static char **interfaces;
+/* The statistics' names and what they map to are looked up once and again
+ * when the number of statistics of the interface changes, e.g. when the
+ * driver has been reloaded. */
+struct ethstat_interface_s {
+  char *name;
+
+  size_t n_stats;
+  struct ethtool_gstrings *strings;
+  struct ethtool_stats *stats;
+  /* Per statistic, the name without leading spaces and its mapping, which is
+   * NULL for unmapped statistics. */
+  char const **stat_names;
+  value_map_t const **maps;
+};
+typedef struct ethstat_interface_s ethstat_interface_t;
+
+static ethstat_interface_t *interfaces;
 static size_t interfaces_num;
 
 static c_avl_tree_t *value_map;
 
 static bool collect_mapped_only;
 
+/* The control socket, kept open between reads. */
+static int ethstat_fd = -1;
+
 static int ethstat_add_interface(const oconfig_item_t *ci) /* {{{ */
 {
-  char **tmp;
+  ethstat_interface_t *tmp;
   int status;
 
   tmp = realloc(interfaces, sizeof(*interfaces) * (interfaces_num + 1));
   if (tmp == NULL)
     return -1;
   interfaces = tmp;
-  interfaces[interfaces_num] = NULL;
+  interfaces[interfaces_num] = (ethstat_interface_t){0};
 
-  status = cf_util_get_string(ci, interfaces + interfaces_num);
+  status = cf_util_get_string(ci, &interfaces[interfaces_num].name);
   if (status != 0)
     return status;
 
   interfaces_num++;
   INFO("ethstat plugin: Registered interface %s",
-       interfaces[interfaces_num - 1]);
+       interfaces[interfaces_num - 1].name);
 
   return 0;
 } /* }}} int ethstat_add_interface */
@@ -157,141 +176,157 @@ static int ethstat_config(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} */
 
-static void ethstat_submit_value(const char *device, const char *type_instance,
-                                 derive_t value) {
+static void ethstat_interface_reset(ethstat_interface_t *iface) {
+  iface->n_stats = 0;
+  sfree(iface->strings);
+  sfree(iface->stats);
+  sfree(iface->stat_names);
+  sfree(iface->maps);
+} /* void ethstat_interface_reset */
+
+/* Fetches the names of the "n_stats" statistics of "iface" and resolves their
+ * mappings. */
+static int ethstat_interface_load(ethstat_interface_t *iface, struct ifreq *req,
+                                  size_t n_stats) /* {{{ */
+{
   static c_complain_t complain_no_map = C_COMPLAIN_INIT_STATIC;
 
-  value_list_t vl = VALUE_LIST_INIT;
-  value_map_t *map = NULL;
-
-  if (value_map != NULL)
-    c_avl_get(value_map, type_instance, (void *)&map);
-
-  /* If the "MappedOnly" option is specified, ignore unmapped values. */
-  if (collect_mapped_only && (map == NULL)) {
-    if (value_map == NULL)
-      c_complain(
-          LOG_WARNING, &complain_no_map,
-          "ethstat plugin: The \"MappedOnly\" option has been set to true, "
-          "but no mapping has been configured. All values will be ignored!");
-    return;
+  ethstat_interface_reset(iface);
+
+  iface->strings =
+      malloc(sizeof(struct ethtool_gstrings) + (n_stats * ETH_GSTRING_LEN));
+  iface->stats =
+      malloc(sizeof(struct ethtool_stats) + (n_stats * sizeof(uint64_t)));
+  iface->stat_names = calloc(n_stats, sizeof(*iface->stat_names));
+  iface->maps = calloc(n_stats, sizeof(*iface->maps));
+  if ((iface->strings == NULL) || (iface->stats == NULL) ||
+      (iface->stat_names == NULL) || (iface->maps == NULL)) {
+    ethstat_interface_reset(iface);
+    ERROR("ethstat plugin: malloc failed.");
+    return -1;
   }
 
-  vl.values = &(value_t){.derive = value};
-  vl.values_len = 1;
-
-  sstrncpy(vl.plugin, "ethstat", sizeof(vl.plugin));
-  sstrncpy(vl.plugin_instance, device, sizeof(vl.plugin_instance));
-  if (map != NULL) {
-    sstrncpy(vl.type, map->type, sizeof(vl.type));
-    sstrncpy(vl.type_instance, map->type_instance, sizeof(vl.type_instance));
-  } else {
-    sstrncpy(vl.type, "derive", sizeof(vl.type));
-    sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+  iface->strings->cmd = ETHTOOL_GSTRINGS;
+  iface->strings->string_set = ETH_SS_STATS;
+  iface->strings->len = n_stats;
+  req->ifr_data = (void *)iface->strings;
+  if (ioctl(ethstat_fd, SIOCETHTOOL, req) < 0) {
+    ERROR("ethstat plugin: Cannot get strings from %s: %s", iface->name,
+          STRERRNO);
+    ethstat_interface_reset(iface);
+    return -1;
   }
 
-  plugin_dispatch_values(&vl);
-}
+  /* If the "MappedOnly" option is specified, unmapped values are ignored. */
+  if (collect_mapped_only && (value_map == NULL))
+    c_complain(
+        LOG_WARNING, &complain_no_map,
+        "ethstat plugin: The \"MappedOnly\" option has been set to true, "
+        "but no mapping has been configured. All values will be ignored!");
 
-static int ethstat_read_interface(char *device) {
-  int fd;
-  struct ethtool_gstrings *strings;
-  struct ethtool_stats *stats;
-  size_t n_stats;
-  size_t strings_size;
-  size_t stats_size;
-  int status;
+  for (size_t i = 0; i < n_stats; i++) {
+    char *stat_name = (void *)&iface->strings->data[i * ETH_GSTRING_LEN];
+    /* The names are not necessarily null-terminated. */
+    stat_name[ETH_GSTRING_LEN - 1] = 0;
+    /* Remove leading spaces in key name */
+    while (isspace((int)*stat_name))
+      stat_name++;
+    iface->stat_names[i] = stat_name;
 
-  fd = socket(AF_INET, SOCK_DGRAM, /* protocol = */ 0);
-  if (fd < 0) {
-    ERROR("ethstat plugin: Failed to open control socket: %s", STRERRNO);
-    return 1;
+    value_map_t *map = NULL;
+    if (value_map != NULL)
+      c_avl_get(value_map, stat_name, (void *)&map);
+    iface->maps[i] = map;
+  }
+
+  iface->n_stats = n_stats;
+  return 0;
+} /* }}} int ethstat_interface_load */
+
+static int ethstat_read_interface(ethstat_interface_t *iface) /* {{{ */
+{
+  if (ethstat_fd < 0) {
+    ethstat_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, /* protocol = */ 0);
+    if (ethstat_fd < 0) {
+      ERROR("ethstat plugin: Failed to open control socket: %s", STRERRNO);
+      return 1;
+    }
   }
 
   struct ethtool_drvinfo drvinfo = {.cmd = ETHTOOL_GDRVINFO};
 
   struct ifreq req = {.ifr_data = (void *)&drvinfo};
 
-  sstrncpy(req.ifr_name, device, sizeof(req.ifr_name));
+  sstrncpy(req.ifr_name, iface->name, sizeof(req.ifr_name));
 
-  status = ioctl(fd, SIOCETHTOOL, &req);
-  if (status < 0) {
-    close(fd);
+  if (ioctl(ethstat_fd, SIOCETHTOOL, &req) < 0) {
     ERROR("ethstat plugin: Failed to get driver information "
           "from %s: %s",
-          device, STRERRNO);
+          iface->name, STRERRNO);
+    ethstat_interface_reset(iface);
     return -1;
   }
 
-  n_stats = (size_t)drvinfo.n_stats;
+  size_t n_stats = (size_t)drvinfo.n_stats;
   if (n_stats < 1) {
-    close(fd);
-    ERROR("ethstat plugin: No stats available for %s", device);
+    ERROR("ethstat plugin: No stats available for %s", iface->name);
+    ethstat_interface_reset(iface);
     return -1;
   }
 
-  strings_size = sizeof(struct ethtool_gstrings) + (n_stats * ETH_GSTRING_LEN);
-  stats_size = sizeof(struct ethtool_stats) + (n_stats * sizeof(uint64_t));
-
-  strings = malloc(strings_size);
-  stats = malloc(stats_size);
-  if ((strings == NULL) || (stats == NULL)) {
-    close(fd);
-    sfree(strings);
-    sfree(stats);
-    ERROR("ethstat plugin: malloc failed.");
+  if ((n_stats != iface->n_stats) &&
+      (ethstat_interface_load(iface, &req, n_stats) != 0))
     return -1;
-  }
 
-  strings->cmd = ETHTOOL_GSTRINGS;
-  strings->string_set = ETH_SS_STATS;
-  strings->len = n_stats;
-  req.ifr_data = (void *)strings;
-  status = ioctl(fd, SIOCETHTOOL, &req);
-  if (status < 0) {
-    close(fd);
-    free(strings);
-    free(stats);
-    ERROR("ethstat plugin: Cannot get strings from %s: %s", device, STRERRNO);
+  iface->stats->cmd = ETHTOOL_GSTATS;
+  iface->stats->n_stats = n_stats;
+  req.ifr_data = (void *)iface->stats;
+  if (ioctl(ethstat_fd, SIOCETHTOOL, &req) < 0) {
+    ERROR("ethstat plugin: Reading statistics from %s failed: %s",
+          iface->name, STRERRNO);
     return -1;
   }
 
-  stats->cmd = ETHTOOL_GSTATS;
-  stats->n_stats = n_stats;
-  req.ifr_data = (void *)stats;
-  status = ioctl(fd, SIOCETHTOOL, &req);
-  if (status < 0) {
-    close(fd);
-    free(strings);
-    free(stats);
-    ERROR("ethstat plugin: Reading statistics from %s failed: %s", device,
-          STRERRNO);
+  /* The driver may have changed the number of statistics since their names
+   * were fetched, so they are fetched again with the next read. */
+  if (iface->stats->n_stats != n_stats) {
+    ethstat_interface_reset(iface);
     return -1;
   }
 
-  for (size_t i = 0; i < n_stats; i++) {
-    char *stat_name;
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "ethstat", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, iface->name, sizeof(vl.plugin_instance));
 
-    stat_name = (void *)&strings->data[i * ETH_GSTRING_LEN];
-    /* Remove leading spaces in key name */
-    while (isspace((int)*stat_name))
-      stat_name++;
+  for (size_t i = 0; i < n_stats; i++) {
+    value_map_t const *map = iface->maps[i];
+
+    if (collect_mapped_only && (map == NULL))
+      continue;
+
+    DEBUG("ethstat plugin: device = \"%s\": %s = %" PRIu64, iface->name,
+          iface->stat_names[i], (uint64_t)iface->stats->data[i]);
+
+    vl.values = &(value_t){.derive = (derive_t)iface->stats->data[i]};
+    if (map != NULL) {
+      sstrncpy(vl.type, map->type, sizeof(vl.type));
+      sstrncpy(vl.type_instance, map->type_instance, sizeof(vl.type_instance));
+    } else {
+      sstrncpy(vl.type, "derive", sizeof(vl.type));
+      sstrncpy(vl.type_instance, iface->stat_names[i],
+               sizeof(vl.type_instance));
+    }
 
-    DEBUG("ethstat plugin: device = \"%s\": %s = %" PRIu64, device, stat_name,
-          (uint64_t)stats->data[i]);
-    ethstat_submit_value(device, stat_name, (derive_t)stats->data[i]);
+    plugin_dispatch_values(&vl);
   }
 
-  close(fd);
-  sfree(strings);
-  sfree(stats);
-
   return 0;
 } /* }}} ethstat_read_interface */
 
 static int ethstat_read(void) {
   for (size_t i = 0; i < interfaces_num; i++)
-    ethstat_read_interface(interfaces[i]);
+    ethstat_read_interface(interfaces + i);
 
   return 0;
 }
@@ -300,6 +335,18 @@ static int ethstat_shutdown(void) {
   void *key = NULL;
   void *value = NULL;
 
+  for (size_t i = 0; i < interfaces_num; i++) {
+    ethstat_interface_reset(interfaces + i);
+    sfree(interfaces[i].name);
+  }
+  sfree(interfaces);
+  interfaces_num = 0;
+
+  if (ethstat_fd >= 0) {
+    close(ethstat_fd);
+    ethstat_fd = -1;
+  }
+
   if (value_map == NULL)
     return 0;
 
@@ -28,26 +28,50 @@
 
 #include "collectd.h"
 
+#include "network.h"
 #include "plugin.h"
 #include "utils/common/common.h"
 
+#include "notification_queue.h"
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
 
+#include <fcntl.h>
 #include <grp.h>
+#include <limits.h>
 #include <pwd.h>
 #include <signal.h>
 #include <sys/types.h>
 
+#if KERNEL_LINUX
+#include <sys/syscall.h>
+#endif
+
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
 #ifdef HAVE_SYS_CAPABILITY_H
 #include <sys/capability.h>
 #endif
 
 #define PL_NORMAL 0x01
 #define PL_NOTIF_ACTION 0x02
+#define PL_BINARY 0x04
+#define PL_PERSISTENT 0x08
 
 #define PL_RUNNING 0x10
 
+/* Programs configured with "BinaryExec" write packets of the network
+ * protocol, each preceded by its length as a 32 bit integer in network byte
+ * order, like the TCP transport of the network plugin. */
+#define FRAME_HEADER_SIZE 4
+#define FRAME_MAX 65535
+
+/* The number of queued notifications a worker passes to the programs
+ * configured with "NotificationHandler" at once. */
+#define NOTIFICATION_BATCH_SIZE 64
+
 /*
  * Private data types
  */
@@ -56,7 +80,8 @@
  * `PL_RUNNING' flag. The execution of notifications is *not* serialized, so
  * all functions used to handle notifications MUST NOT write to this structure.
  * The `pid' and `status' fields are thus unused if the `PL_NOTIF_ACTION' flag
- * is set.
+ * is set, unless `PL_PERSISTENT' is set too: the `pid' and `handler' fields
+ * of notification handlers are protected by `handler_lock'.
  * The `PL_RUNNING' flag is set in `exec_read' and unset in `exec_read_one'.
  */
 struct program_list_s;
@@ -65,18 +90,17 @@ struct program_list_s {
   char *user;
   char *group;
   char *exec;
+  /* `exec', looked up in $PATH. */
+  char *path;
   char **argv;
   int pid;
+  /* STDIN of a running notification handler. */
+  FILE *handler;
   int status;
   int flags;
   program_list_t *next;
 };
 
-typedef struct program_list_and_notification_s {
-  program_list_t *pl;
-  notification_t n;
-} program_list_and_notification_t;
-
 /*
  * constants
  */
@@ -87,6 +111,25 @@ const long int MAX_GRBUF_SIZE = 65536;
  */
 static program_list_t *pl_head;
 static pthread_mutex_t pl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t handler_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char **exec_envp;
+
+/* Runs the notification programs unless the plugin has been loaded with
+ * "NotificationThreads". Created when the first notification arrives. */
+static notification_queue_t *notif_queue;
+static pthread_mutex_t notif_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool notif_queue_closed;
+static int conf_notification_workers = 4;
+
+/* Programs started, failed starts and the time spent starting them. Only ever
+ * added to. */
+static uint64_t spawn_num;
+static uint64_t spawn_failed;
+static uint64_t spawn_time;
+/* The values at the last read, to report the average of the interval. */
+static uint64_t spawn_num_last;
+static uint64_t spawn_time_last;
 
 /*
  * Functions
@@ -135,8 +178,14 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  pl->handler = NULL;
+
   if (strcasecmp("NotificationExec", ci->key) == 0)
     pl->flags |= PL_NOTIF_ACTION;
+  else if (strcasecmp("NotificationHandler", ci->key) == 0)
+    pl->flags |= PL_NOTIF_ACTION | PL_PERSISTENT;
+  else if (strcasecmp("BinaryExec", ci->key) == 0)
+    pl->flags |= PL_NORMAL | PL_BINARY;
   else
     pl->flags |= PL_NORMAL;
 
@@ -235,9 +284,17 @@ static int exec_config(oconfig_item_t *ci) /* {{{ */
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
     if ((strcasecmp("Exec", child->key) == 0) ||
-        (strcasecmp("NotificationExec", child->key) == 0))
+        (strcasecmp("BinaryExec", child->key) == 0) ||
+        (strcasecmp("NotificationExec", child->key) == 0) ||
+        (strcasecmp("NotificationHandler", child->key) == 0))
       exec_config_exec(child);
-    else {
+    else if (strcasecmp("NotificationWorkers", child->key) == 0) {
+      cf_util_get_int(child, &conf_notification_workers);
+      if (conf_notification_workers < 1) {
+        WARNING("exec plugin: `NotificationWorkers' must be at least 1.");
+        conf_notification_workers = 1;
+      }
+    } else {
       WARNING("exec plugin: Unknown config option `%s'.", child->key);
     }
   } /* for (i) */
@@ -245,102 +302,238 @@ static int exec_config(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* int exec_config }}} */
 
-#if !defined(HAVE_SETENV)
-static char env_interval[64];
-// max hostname len is 255, so this should be enough
-static char env_hostname[300];
-#endif
+static void exec_spawn_account(cdtime_t duration, bool failed) /* {{{ */
+{
+  __atomic_fetch_add(&spawn_num, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&spawn_time, (uint64_t)duration, __ATOMIC_RELAXED);
+  if (failed)
+    __atomic_fetch_add(&spawn_failed, 1, __ATOMIC_RELAXED);
+} /* }}} void exec_spawn_account */
 
-static void set_environment(void) /* {{{ */
+extern char **environ;
+
+/* Builds the environment of the programs once, so that the environment of the
+ * daemon, which other threads may read at any time, is never modified. */
+static char **exec_environment(void) /* {{{ */
 {
-#ifdef HAVE_SETENV
-  char buffer[1024];
+  size_t num = 0;
+  for (char **e = environ; *e != NULL; e++)
+    num++;
+
+  char **envp = calloc(num + 3, sizeof(*envp));
+  if (envp == NULL)
+    return NULL;
+
+  size_t i = 0;
+  for (char **e = environ; *e != NULL; e++) {
+    if ((strncmp(*e, "COLLECTD_INTERVAL=", strlen("COLLECTD_INTERVAL=")) ==
+         0) ||
+        (strncmp(*e, "COLLECTD_HOSTNAME=", strlen("COLLECTD_HOSTNAME=")) == 0))
+      continue;
+    envp[i++] = *e;
+  }
 
-  snprintf(buffer, sizeof(buffer), "%.3f",
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer), "COLLECTD_INTERVAL=%.3f",
            CDTIME_T_TO_DOUBLE(plugin_get_interval()));
-  setenv("COLLECTD_INTERVAL", buffer, /* overwrite = */ 1);
+  envp[i++] = strdup(buffer);
+  snprintf(buffer, sizeof(buffer), "COLLECTD_HOSTNAME=%s", hostname_g);
+  envp[i++] = strdup(buffer);
+
+  if ((envp[i - 1] == NULL) || (envp[i - 2] == NULL)) {
+    free(envp[i - 1]);
+    free(envp[i - 2]);
+    free(envp);
+    return NULL;
+  }
 
-  sstrncpy(buffer, hostname_g, sizeof(buffer));
-  setenv("COLLECTD_HOSTNAME", buffer, /* overwrite = */ 1);
-#else
-  snprintf(env_interval, sizeof(env_interval), "COLLECTD_INTERVAL=%.3f",
-           CDTIME_T_TO_DOUBLE(plugin_get_interval()));
-  putenv(env_interval);
+  return envp;
+} /* }}} char **exec_environment */
+
+static void exec_environment_free(char **envp) /* {{{ */
+{
+  if (envp == NULL)
+    return;
+
+  /* The last two entries are our own. */
+  size_t num = 0;
+  while (envp[num] != NULL)
+    num++;
+  free(envp[num - 1]);
+  free(envp[num - 2]);
+  free(envp);
+} /* }}} void exec_environment_free */
+
+/* Looks up `file' in $PATH like execvp(3) does. The child can't do this after
+ * vfork(), because it must not allocate memory. */
+static char *exec_find_path(char const *file) /* {{{ */
+{
+  if (strchr(file, '/') != NULL)
+    return strdup(file);
+
+  char const *path = getenv("PATH");
+  if (path == NULL)
+    path = "/bin:/usr/bin";
+
+  while (true) {
+    char const *end = strchr(path, ':');
+    size_t len = (end == NULL) ? strlen(path) : (size_t)(end - path);
+
+    char buffer[PATH_MAX];
+    if (len == 0)
+      snprintf(buffer, sizeof(buffer), "%s", file);
+    else
+      snprintf(buffer, sizeof(buffer), "%.*s/%s", (int)len, path, file);
+    if (access(buffer, X_OK) == 0)
+      return strdup(buffer);
 
-  snprintf(env_hostname, sizeof(env_hostname), "COLLECTD_HOSTNAME=%s",
-           hostname_g);
-  putenv(env_hostname);
+    if (end == NULL)
+      break;
+    path = end + 1;
+  }
+
+  /* execve() will fail with ENOENT, which is reported by fork_child(). */
+  return strdup(file);
+} /* }}} char *exec_find_path */
+
+/* The steps of exec_child() that may fail. */
+enum {
+  CHILD_SETGID = 1,
+  CHILD_SETEGID,
+  CHILD_SETUID,
+  CHILD_EXEC,
+};
+
+typedef struct {
+  int step;
+  int error;
+} child_status_t;
+
+/* The IDs exec_child() switches to. */
+typedef struct {
+  int uid;
+  int gid;
+  int egid;
+} child_ids_t;
+
+#if KERNEL_LINUX
+/* The set*id() functions of the C library change the IDs of all threads of
+ * the process by signalling them. A vfork()ed child shares the memory of the
+ * daemon and must not do that; the system calls only change the calling
+ * process. */
+#ifdef SYS_setgid32
+#define CHILD_SYS_SETGROUPS SYS_setgroups32
+#define CHILD_SYS_SETGID SYS_setgid32
+#define CHILD_SYS_SETRESGID SYS_setresgid32
+#define CHILD_SYS_SETUID SYS_setuid32
+#else
+#define CHILD_SYS_SETGROUPS SYS_setgroups
+#define CHILD_SYS_SETGID SYS_setgid
+#define CHILD_SYS_SETRESGID SYS_setresgid
+#define CHILD_SYS_SETUID SYS_setuid
 #endif
-} /* }}} void set_environment */
 
-static void unset_environment(void) /* {{{ */
-{
-#ifdef HAVE_SETENV
-  unsetenv("COLLECTD_INTERVAL");
-  unsetenv("COLLECTD_HOSTNAME");
+#define child_setgroups(num, list) syscall(CHILD_SYS_SETGROUPS, (num), (list))
+#define child_setgid(gid) syscall(CHILD_SYS_SETGID, (gid))
+#define child_setegid(gid) syscall(CHILD_SYS_SETRESGID, -1, (gid), -1)
+#define child_setuid(uid) syscall(CHILD_SYS_SETUID, (uid))
 #else
-  snprintf(env_interval, sizeof(env_interval), "COLLECTD_INTERVAL");
-  putenv(env_interval);
-  snprintf(env_hostname, sizeof(env_hostname), "COLLECTD_HOSTNAME");
-  putenv(env_hostname);
+#define child_setgroups(num, list) setgroups((num), (list))
+#define child_setgid(gid) setgid(gid)
+#define child_setegid(gid) setegid(gid)
+#define child_setuid(uid) setuid(uid)
 #endif
-} /* }}} void unset_environment */
 
-__attribute__((noreturn)) static void exec_child(program_list_t *pl, int uid,
-                                                 int gid, int egid) /* {{{ */
-{
-  int status;
+/* Tells the parent which step failed and exits. */
+__attribute__((noreturn)) static void child_fail(int fd_status, /* {{{ */
+                                                 int step) {
+  child_status_t cs = {.step = step, .error = errno};
+  if (write(fd_status, &cs, sizeof(cs)) != sizeof(cs)) {
+    /* The parent logs a generic error. */
+  }
+  _exit(127);
+} /* }}} void child_fail */
+
+/* Runs in the child created by fork_child(), which shares the memory of the
+ * daemon until it calls execve(). Only async-signal-safe functions may be
+ * used; errors are reported through `fd_status', which is closed by a
+ * successful execve(). */
+__attribute__((noreturn)) static void
+exec_child(program_list_t const *pl, char *const *envp, /* {{{ */
+           child_ids_t const *ids, int fd_in, int fd_out, int fd_err,
+           int fd_status) {
+
+  /* Close all file descriptors but the pipe ends we need. */
+  int fd_num = getdtablesize();
+  for (int fd = 0; fd < fd_num; fd++) {
+    if ((fd == fd_in) || (fd == fd_out) || (fd == fd_err) ||
+        (fd == fd_status))
+      continue;
+    close(fd);
+  }
+
+  /* Connect the `in' pipe to STDIN */
+  if (fd_in != STDIN_FILENO) {
+    dup2(fd_in, STDIN_FILENO);
+    close(fd_in);
+  }
+
+  /* Now connect the `out' pipe to STDOUT */
+  if (fd_out != STDOUT_FILENO) {
+    dup2(fd_out, STDOUT_FILENO);
+    close(fd_out);
+  }
+
+  /* Now connect the `err' pipe to STDERR */
+  if (fd_err != STDERR_FILENO) {
+    dup2(fd_err, STDERR_FILENO);
+    close(fd_err);
+  }
+
+  /* The daemon's signal handlers must not run in the child, so they are reset
+   * before all signals are unblocked. */
+  for (int sig = 1; sig < NSIG; sig++) {
+    struct sigaction sa;
+    if ((sigaction(sig, NULL, &sa) != 0) || (sa.sa_handler == SIG_IGN) ||
+        (sa.sa_handler == SIG_DFL))
+      continue;
+    struct sigaction sa_default = {.sa_handler = SIG_DFL};
+    sigaction(sig, &sa_default, NULL);
+  }
+
+  sigset_t ss;
+  sigemptyset(&ss);
+  sigprocmask(SIG_SETMASK, &ss, /* old mask = */ NULL);
 
 #if HAVE_SETGROUPS
   if (getuid() == 0) {
     gid_t glist[2];
     size_t glist_len;
 
-    glist[0] = gid;
+    glist[0] = ids->gid;
     glist_len = 1;
 
-    if ((gid != egid) && (egid != -1)) {
-      glist[1] = egid;
+    if ((ids->gid != ids->egid) && (ids->egid != -1)) {
+      glist[1] = ids->egid;
       glist_len = 2;
     }
 
-    setgroups(glist_len, glist);
+    child_setgroups(glist_len, glist);
   }
 #endif /* HAVE_SETGROUPS */
 
-  status = setgid(gid);
-  if (status != 0) {
-    ERROR("exec plugin: setgid (%i) failed: %s", gid, STRERRNO);
-    exit(-1);
-  }
-
-  if (egid != -1) {
-    status = setegid(egid);
-    if (status != 0) {
-      ERROR("exec plugin: setegid (%i) failed: %s", egid, STRERRNO);
-      exit(-1);
-    }
-  }
-
-  status = setuid(uid);
-  if (status != 0) {
-    ERROR("exec plugin: setuid (%i) failed: %s", uid, STRERRNO);
-    exit(-1);
-  }
+  if (child_setgid(ids->gid) != 0)
+    child_fail(fd_status, CHILD_SETGID);
 
-  execvp(pl->exec, pl->argv);
+  if ((ids->egid != -1) && (child_setegid(ids->egid) != 0))
+    child_fail(fd_status, CHILD_SETEGID);
 
-  ERROR("exec plugin: Failed to execute ``%s'': %s", pl->exec, STRERRNO);
-  exit(-1);
-} /* void exec_child }}} */
+  if (child_setuid(ids->uid) != 0)
+    child_fail(fd_status, CHILD_SETUID);
 
-static void reset_signal_mask(void) /* {{{ */
-{
-  sigset_t ss;
-
-  sigemptyset(&ss);
-  sigprocmask(SIG_SETMASK, &ss, /* old mask = */ NULL);
-} /* }}} void reset_signal_mask */
+  execve(pl->path, pl->argv, envp);
+  child_fail(fd_status, CHILD_EXEC);
+} /* }}} void exec_child */
 
 static int create_pipe(int fd_pipe[2]) /* {{{ */
 {
@@ -423,31 +616,12 @@ static int getegr_id(program_list_t *pl, int gid) /* {{{ */
   return -2;
 }
 
-/*
- * Creates three pipes (one for reading, one for writing and one for errors),
- * forks a child, sets up the pipes so that fd_in is connected to STDIN of
- * the child and fd_out is connected to STDOUT and fd_err is connected to STDERR
- * of the child. Then is calls `exec_child'.
- */
-static int fork_child(program_list_t *pl, int *fd_in, int *fd_out,
-                      int *fd_err) /* {{{ */
+/* Looks up the IDs the program is run with. */
+static int child_ids_get(program_list_t *pl, child_ids_t *ids) /* {{{ */
 {
-  int fd_pipe_in[2] = {-1, -1};
-  int fd_pipe_out[2] = {-1, -1};
-  int fd_pipe_err[2] = {-1, -1};
-  int status;
-  int pid;
-
-  int uid;
-  int gid;
-  int egid;
-
-  struct passwd *sp_ptr;
+  struct passwd *sp_ptr = NULL;
   struct passwd sp;
 
-  if (pl->pid != 0)
-    return -1;
-
   long int nambuf_size = sysconf(_SC_GETPW_R_SIZE_MAX);
   if (nambuf_size <= 0)
     nambuf_size = sysconf(_SC_PAGESIZE);
@@ -455,81 +629,122 @@ static int fork_child(program_list_t *pl, int *fd_in, int *fd_out,
     nambuf_size = 4096;
   char nambuf[nambuf_size];
 
-  if ((create_pipe(fd_pipe_in) == -1) || (create_pipe(fd_pipe_out) == -1) ||
-      (create_pipe(fd_pipe_err) == -1))
-    goto failed;
-
-  sp_ptr = NULL;
-  status = getpwnam_r(pl->user, &sp, nambuf, sizeof(nambuf), &sp_ptr);
+  int status = getpwnam_r(pl->user, &sp, nambuf, sizeof(nambuf), &sp_ptr);
   if (status != 0) {
     ERROR("exec plugin: Failed to get user information for user ``%s'': %s",
           pl->user, STRERROR(status));
-    goto failed;
+    return -1;
   }
 
   if (sp_ptr == NULL) {
     ERROR("exec plugin: No such user: `%s'", pl->user);
-    goto failed;
+    return -1;
   }
 
-  uid = sp.pw_uid;
-  gid = sp.pw_gid;
-  if (uid == 0) {
+  ids->uid = sp.pw_uid;
+  ids->gid = sp.pw_gid;
+  if (ids->uid == 0) {
     ERROR("exec plugin: Cowardly refusing to exec program as root.");
-    goto failed;
+    return -1;
   }
 
   /* The group configured in the configfile is set as effective group, because
    * this way the forked process can (re-)gain the user's primary group. */
-  egid = getegr_id(pl, gid);
-  if (egid == -2) {
-    goto failed;
-  }
+  ids->egid = getegr_id(pl, ids->gid);
+  if (ids->egid == -2)
+    return -1;
 
-  set_environment();
+  return 0;
+} /* }}} int child_ids_get */
 
-  pid = fork();
-  if (pid < 0) {
-    ERROR("exec plugin: fork failed: %s", STRERRNO);
+/*
+ * Creates three pipes (one for reading, one for writing and one for errors),
+ * starts a child, sets up the pipes so that fd_in is connected to STDIN of
+ * the child and fd_out is connected to STDOUT and fd_err is connected to STDERR
+ * of the child. Then is calls `exec_child'. The child is created with vfork(),
+ * so that the page tables of a large daemon aren't copied for every program.
+ */
+static int fork_child(program_list_t *pl, int *fd_in, int *fd_out,
+                      int *fd_err) /* {{{ */
+{
+  int fd_pipe_in[2] = {-1, -1};
+  int fd_pipe_out[2] = {-1, -1};
+  int fd_pipe_err[2] = {-1, -1};
+  int fd_pipe_status[2] = {-1, -1};
+  int pid;
+  /* Handed to the child in memory: locals held in registers across vfork()
+   * may be clobbered. */
+  child_ids_t ids;
+
+  if (pl->pid != 0)
+    return -1;
+
+  if ((create_pipe(fd_pipe_in) == -1) || (create_pipe(fd_pipe_out) == -1) ||
+      (create_pipe(fd_pipe_err) == -1) || (create_pipe(fd_pipe_status) == -1))
     goto failed;
-  } else if (pid == 0) {
-    int fd_num;
-
-    /* Close all file descriptors but the pipe end we need. */
-    fd_num = getdtablesize();
-    for (int fd = 0; fd < fd_num; fd++) {
-      if ((fd == fd_pipe_in[0]) || (fd == fd_pipe_out[1]) ||
-          (fd == fd_pipe_err[1]))
-        continue;
-      close(fd);
-    }
 
-    /* Connect the `in' pipe to STDIN */
-    if (fd_pipe_in[0] != STDIN_FILENO) {
-      dup2(fd_pipe_in[0], STDIN_FILENO);
-      close(fd_pipe_in[0]);
-    }
+  /* A successful execve() closes the write end, so that the parent sees EOF. */
+  fcntl(fd_pipe_status[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fd_pipe_status[1], F_SETFD, FD_CLOEXEC);
 
-    /* Now connect the `out' pipe to STDOUT */
-    if (fd_pipe_out[1] != STDOUT_FILENO) {
-      dup2(fd_pipe_out[1], STDOUT_FILENO);
-      close(fd_pipe_out[1]);
-    }
+  if (child_ids_get(pl, &ids) != 0)
+    goto failed;
 
-    /* Now connect the `err' pipe to STDERR */
-    if (fd_pipe_err[1] != STDERR_FILENO) {
-      dup2(fd_pipe_err[1], STDERR_FILENO);
-      close(fd_pipe_err[1]);
-    }
+  /* Signals stay blocked until the child has reset the handlers. */
+  sigset_t ss_all;
+  sigset_t ss_old;
+  sigfillset(&ss_all);
+  pthread_sigmask(SIG_SETMASK, &ss_all, &ss_old);
 
-    /* Unblock all signals */
-    reset_signal_mask();
+  cdtime_t start = cdtime();
+#if HAVE_VFORK
+  pid = vfork();
+#else
+  pid = fork();
+#endif
+  if (pid == 0)
+    exec_child(pl, exec_envp, &ids, fd_pipe_in[0], fd_pipe_out[1],
+               fd_pipe_err[1], fd_pipe_status[1]);
+  /* does not return */
 
-    exec_child(pl, uid, gid, egid);
-    /* does not return */
+  int fork_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &ss_old, /* old mask = */ NULL);
+  if (pid < 0) {
+    ERROR("exec plugin: fork failed: %s", STRERROR(fork_errno));
+    exec_spawn_account(cdtime() - start, /* failed = */ true);
+    goto failed;
   }
 
-  unset_environment();
+  close(fd_pipe_status[1]);
+  fd_pipe_status[1] = -1;
+
+  child_status_t cs = {0};
+  ssize_t len;
+  do {
+    len = read(fd_pipe_status[0], &cs, sizeof(cs));
+  } while ((len < 0) && (errno == EINTR));
+  exec_spawn_account(cdtime() - start, /* failed = */ len != 0);
+
+  if (len != 0) {
+    if (len != sizeof(cs))
+      ERROR("exec plugin: Starting ``%s'' failed.", pl->exec);
+    else if (cs.step == CHILD_EXEC)
+      ERROR("exec plugin: Failed to execute ``%s'': %s", pl->exec,
+            STRERROR(cs.error));
+    else if (cs.step == CHILD_SETGID)
+      ERROR("exec plugin: setgid (%i) failed: %s", ids.gid,
+            STRERROR(cs.error));
+    else if (cs.step == CHILD_SETEGID)
+      ERROR("exec plugin: setegid (%i) failed: %s", ids.egid,
+            STRERROR(cs.error));
+    else
+      ERROR("exec plugin: setuid (%i) failed: %s", ids.uid,
+            STRERROR(cs.error));
+    /* The child may have been reaped by sigchld_handler already. */
+    waitpid(pid, NULL, 0);
+    goto failed;
+  }
+  close(fd_pipe_status[0]);
 
   close(fd_pipe_in[0]);
   close(fd_pipe_out[1]);
@@ -553,11 +768,10 @@ static int fork_child(program_list_t *pl, int *fd_in, int *fd_out,
   return pid;
 
 failed:
-  unset_environment();
-
   close_pipe(fd_pipe_in);
   close_pipe(fd_pipe_out);
   close_pipe(fd_pipe_err);
+  close_pipe(fd_pipe_status);
 
   return -1;
 } /* int fork_child }}} */
@@ -575,6 +789,201 @@ static int parse_line(char *buffer) /* {{{ */
   }
 } /* int parse_line }}} */
 
+/* Parses the parts of one packet into `vl' and appends a copy of `vl' to
+ * `vls' for each values part. Signed, encrypted and compressed packets are
+ * not supported: the program runs locally and is trusted. */
+static int parse_packet(program_list_t *pl, char *data, /* {{{ */
+                        size_t data_size, value_list_t **vls, size_t *vls_num,
+                        size_t *vls_size) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  while (data_size > 0) {
+    uint16_t part_type;
+    uint16_t part_size;
+
+    if (data_size < 4)
+      return EINVAL;
+    memcpy(&part_type, data, sizeof(part_type));
+    memcpy(&part_size, data + 2, sizeof(part_size));
+    part_type = ntohs(part_type);
+    part_size = ntohs(part_size);
+    if ((part_size < 4) || (part_size > data_size))
+      return EINVAL;
+
+    char *payload = data + 4;
+    size_t payload_size = part_size - 4;
+    data += part_size;
+    data_size -= part_size;
+
+    switch (part_type) {
+    case TYPE_HOST:
+    case TYPE_PLUGIN:
+    case TYPE_PLUGIN_INSTANCE:
+    case TYPE_TYPE:
+    case TYPE_TYPE_INSTANCE: {
+      char *dst = (part_type == TYPE_HOST)              ? vl.host
+                  : (part_type == TYPE_PLUGIN)          ? vl.plugin
+                  : (part_type == TYPE_PLUGIN_INSTANCE) ? vl.plugin_instance
+                  : (part_type == TYPE_TYPE)            ? vl.type
+                                                        : vl.type_instance;
+      if ((payload_size == 0) || (payload_size > DATA_MAX_NAME_LEN) ||
+          (payload[payload_size - 1] != 0))
+        return EINVAL;
+      memcpy(dst, payload, payload_size);
+      break;
+    }
+
+    case TYPE_TIME:
+    case TYPE_TIME_HR:
+    case TYPE_INTERVAL:
+    case TYPE_INTERVAL_HR: {
+      uint64_t tmp;
+      if (payload_size != sizeof(tmp))
+        return EINVAL;
+      memcpy(&tmp, payload, sizeof(tmp));
+      tmp = ntohll(tmp);
+      if ((part_type == TYPE_TIME) || (part_type == TYPE_INTERVAL))
+        tmp = TIME_T_TO_CDTIME_T(tmp);
+      if ((part_type == TYPE_TIME) || (part_type == TYPE_TIME_HR))
+        vl.time = (cdtime_t)tmp;
+      else
+        vl.interval = (cdtime_t)tmp;
+      break;
+    }
+
+    case TYPE_VALUES: {
+      uint16_t num;
+      if (payload_size < sizeof(num))
+        return EINVAL;
+      memcpy(&num, payload, sizeof(num));
+      num = ntohs(num);
+      if (payload_size != sizeof(num) + num * (1 + sizeof(value_t)))
+        return EINVAL;
+
+      const data_set_t *ds = plugin_get_ds(vl.type);
+      if (ds == NULL) {
+        WARNING("exec plugin: %s: Type `%s' isn't defined.", pl->exec,
+                vl.type);
+        break;
+      }
+      if (ds->ds_num != num) {
+        WARNING("exec plugin: %s: Type `%s' has %" PRIsz " data sources, "
+                "but %" PRIu16 " values have been received.",
+                pl->exec, vl.type, ds->ds_num, num);
+        break;
+      }
+
+      if (*vls_num >= *vls_size) {
+        size_t size = (*vls_size == 0) ? 16 : 2 * *vls_size;
+        value_list_t *tmp = realloc(*vls, size * sizeof(*tmp));
+        if (tmp == NULL)
+          return ENOMEM;
+        *vls = tmp;
+        *vls_size = size;
+      }
+
+      value_list_t *v = *vls + *vls_num;
+      *v = vl;
+      v->values_len = num;
+      v->values = calloc(num, sizeof(*v->values));
+      if (v->values == NULL)
+        return ENOMEM;
+      (*vls_num)++;
+
+      uint8_t const *types = (uint8_t *)payload + sizeof(num);
+      char const *values = payload + sizeof(num) + num;
+      for (size_t i = 0; i < num; i++) {
+        uint64_t tmp;
+        memcpy(&tmp, values + i * sizeof(tmp), sizeof(tmp));
+        switch (types[i]) {
+        case DS_TYPE_GAUGE:
+          /* Gauges are sent in x86 byte order. */
+          memcpy(&v->values[i].gauge, &tmp, sizeof(tmp));
+          v->values[i].gauge = ntohd(v->values[i].gauge);
+          break;
+        case DS_TYPE_COUNTER:
+          v->values[i].counter = (counter_t)ntohll(tmp);
+          break;
+        case DS_TYPE_DERIVE:
+          v->values[i].derive = (derive_t)ntohll(tmp);
+          break;
+        case DS_TYPE_ABSOLUTE:
+          v->values[i].absolute = (absolute_t)ntohll(tmp);
+          break;
+        default:
+          return EINVAL;
+        }
+      }
+      break;
+    }
+
+    default:
+      DEBUG("exec plugin: %s: Ignoring part of unknown type %#" PRIx16 ".",
+            pl->exec, part_type);
+    }
+  }
+
+  return 0;
+} /* }}} int parse_packet */
+
+/* Reads from the stdout of a "BinaryExec" program and dispatches the values of
+ * all complete packets in one batch. Returns non-zero on end-of-file and on
+ * errors. */
+static int read_binary(program_list_t *pl, int fd, char *buffer, /* {{{ */
+                       size_t *fill) {
+  ssize_t len =
+      read(fd, buffer + *fill, FRAME_HEADER_SIZE + FRAME_MAX - *fill);
+  if (len < 0) {
+    if ((errno == EAGAIN) || (errno == EINTR))
+      return 0;
+    return -1;
+  } else if (len == 0) {
+    return -1;
+  }
+  *fill += (size_t)len;
+
+  value_list_t *vls = NULL;
+  size_t vls_num = 0;
+  size_t vls_size = 0;
+  size_t offset = 0;
+  int status = 0;
+
+  while ((*fill - offset) >= FRAME_HEADER_SIZE) {
+    uint32_t frame_len;
+    memcpy(&frame_len, buffer + offset, sizeof(frame_len));
+    frame_len = ntohl(frame_len);
+    if ((frame_len == 0) || (frame_len > FRAME_MAX)) {
+      ERROR("exec plugin: %s: Invalid frame length %" PRIu32 ".", pl->exec,
+            frame_len);
+      status = -1;
+      break;
+    }
+
+    if ((*fill - offset - FRAME_HEADER_SIZE) < frame_len)
+      break;
+
+    int err = parse_packet(pl, buffer + offset + FRAME_HEADER_SIZE,
+                           frame_len, &vls, &vls_num, &vls_size);
+    if (err != 0)
+      ERROR("exec plugin: %s: Parsing a packet failed: %s", pl->exec,
+            STRERROR(err));
+    offset += FRAME_HEADER_SIZE + frame_len;
+  }
+
+  if (vls_num > 0)
+    plugin_dispatch_values_batch(vls, vls_num);
+  for (size_t i = 0; i < vls_num; i++)
+    sfree(vls[i].values);
+  sfree(vls);
+
+  if (offset > 0) {
+    memmove(buffer, buffer + offset, *fill - offset);
+    *fill -= offset;
+  }
+
+  return status;
+} /* }}} int read_binary */
+
 static void *exec_read_one(void *arg) /* {{{ */
 {
   program_list_t *pl = (program_list_t *)arg;
@@ -585,9 +994,23 @@ static void *exec_read_one(void *arg) /* {{{ */
   char buffer_err[1024];
   char *pbuffer = buffer;
   char *pbuffer_err = buffer_err;
+  char *binary = NULL;
+  size_t binary_fill = 0;
+
+  if (pl->flags & PL_BINARY) {
+    binary = malloc(FRAME_HEADER_SIZE + FRAME_MAX);
+    if (binary == NULL) {
+      ERROR("exec plugin: malloc failed.");
+      pthread_mutex_lock(&pl_lock);
+      pl->flags &= ~PL_RUNNING;
+      pthread_mutex_unlock(&pl_lock);
+      pthread_exit((void *)1);
+    }
+  }
 
   status = fork_child(pl, NULL, &fd, &fd_err);
   if (status < 0) {
+    sfree(binary);
     /* Reset the "running" flag */
     pthread_mutex_lock(&pl_lock);
     pl->flags &= ~PL_RUNNING;
@@ -618,7 +1041,10 @@ static void *exec_read_one(void *arg) /* {{{ */
       break;
     }
 
-    if (FD_ISSET(fd, &copy)) {
+    if (FD_ISSET(fd, &copy) && (binary != NULL)) {
+      if (read_binary(pl, fd, binary, &binary_fill) != 0)
+        break;
+    } else if (FD_ISSET(fd, &copy)) {
       char *pnl;
 
       len = read(fd, pbuffer, sizeof(buffer) - 1 - (pbuffer - buffer));
@@ -702,6 +1128,11 @@ static void *exec_read_one(void *arg) /* {{{ */
     copy = fdset;
   }
 
+  /* Close the pipe first, so that a program we stopped reading from, e.g.
+   * after an invalid frame, does not block forever. */
+  close(fd);
+  sfree(binary);
+
   DEBUG("exec plugin: exec_read_one: Waiting for `%s' to exit.", pl->exec);
   if (waitpid(pl->pid, &status, 0) > 0)
     pl->status = status;
@@ -715,7 +1146,6 @@ static void *exec_read_one(void *arg) /* {{{ */
   pl->flags &= ~PL_RUNNING;
   pthread_mutex_unlock(&pl_lock);
 
-  close(fd);
   if (fd_err >= 0)
     close(fd_err);
 
@@ -723,31 +1153,13 @@ static void *exec_read_one(void *arg) /* {{{ */
   return NULL;
 } /* void *exec_read_one }}} */
 
-static void *exec_notification_one(void *arg) /* {{{ */
-{
-  program_list_t *pl = ((program_list_and_notification_t *)arg)->pl;
-  notification_t *n = &((program_list_and_notification_t *)arg)->n;
-  int fd;
-  FILE *fh;
-  int pid;
-  int status;
+/* Writes `n' in the notification data format, see collectd-exec(5). Handlers
+ * read one notification after the other, so their messages are kept on one
+ * line. */
+static void exec_notification_write(FILE *fh, /* {{{ */
+                                    notification_t const *n, bool stream) {
   const char *severity;
 
-  pid = fork_child(pl, &fd, NULL, NULL);
-  if (pid < 0) {
-    sfree(arg);
-    pthread_exit((void *)1);
-  }
-
-  fh = fdopen(fd, "w");
-  if (fh == NULL) {
-    ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
-    kill(pid, SIGTERM);
-    close(fd);
-    sfree(arg);
-    pthread_exit((void *)1);
-  }
-
   severity = "FAILURE";
   if (n->severity == NOTIF_WARNING)
     severity = "WARNING";
@@ -786,7 +1198,38 @@ static void *exec_notification_one(void *arg) /* {{{ */
               meta->nm_value.nm_boolean ? "true" : "false");
   }
 
-  fprintf(fh, "\n%s\n", n->message);
+  if (!stream) {
+    fprintf(fh, "\n%s\n", n->message);
+    return;
+  }
+
+  fputc('\n', fh);
+  for (char const *c = n->message; *c != 0; c++)
+    fputc(((*c == '\n') || (*c == '\r')) ? ' ' : *c, fh);
+  fputc('\n', fh);
+} /* }}} void exec_notification_write */
+
+/* Passes `n' to the program `pl' and waits for it to exit. */
+static int exec_notification_run(program_list_t *pl, /* {{{ */
+                                 notification_t const *n) {
+  int fd;
+  FILE *fh;
+  int pid;
+  int status;
+
+  pid = fork_child(pl, &fd, NULL, NULL);
+  if (pid < 0)
+    return -1;
+
+  fh = fdopen(fd, "w");
+  if (fh == NULL) {
+    ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
+    kill(pid, SIGTERM);
+    close(fd);
+    return -1;
+  }
+
+  exec_notification_write(fh, n, /* stream = */ false);
 
   fflush(fh);
   fclose(fh);
@@ -795,13 +1238,112 @@ static void *exec_notification_one(void *arg) /* {{{ */
 
   DEBUG("exec plugin: Child %i exited with status %i.", pid, status);
 
-  if (n->meta != NULL)
-    plugin_notification_meta_free(n->meta);
-  n->meta = NULL;
-  sfree(arg);
-  pthread_exit((void *)0);
-  return NULL;
-} /* void *exec_notification_one }}} */
+  return 0;
+} /* }}} int exec_notification_run */
+
+/* Must hold `handler_lock'. */
+static void exec_handler_stop(program_list_t *pl) /* {{{ */
+{
+  if (pl->handler == NULL)
+    return;
+
+  /* The handler exits once it has read everything. */
+  fclose(pl->handler);
+  pl->handler = NULL;
+  /* The child may have been reaped by sigchld_handler already. */
+  waitpid(pl->pid, NULL, WNOHANG);
+  pl->pid = 0;
+} /* }}} void exec_handler_stop */
+
+/* Writes the notifications to the long running program `pl', starting it if
+ * it isn't running. If it has exited, it is started again with the next
+ * batch. */
+static int exec_handler_run(program_list_t *pl, /* {{{ */
+                            notification_t const *const *n, size_t num) {
+  pthread_mutex_lock(&handler_lock);
+
+  if (pl->handler == NULL) {
+    int fd;
+    int pid = fork_child(pl, &fd, NULL, NULL);
+    if (pid < 0) {
+      pthread_mutex_unlock(&handler_lock);
+      return -1;
+    }
+
+    pl->handler = fdopen(fd, "w");
+    if (pl->handler == NULL) {
+      ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
+      kill(pid, SIGTERM);
+      close(fd);
+      pthread_mutex_unlock(&handler_lock);
+      return -1;
+    }
+    pl->pid = pid;
+  }
+
+  for (size_t i = 0; i < num; i++)
+    exec_notification_write(pl->handler, n[i], /* stream = */ true);
+
+  int status = 0;
+  if ((fflush(pl->handler) != 0) || ferror(pl->handler)) {
+    ERROR("exec plugin: Writing to ``%s'' failed: %s", pl->exec, STRERRNO);
+    kill(pl->pid, SIGTERM);
+    exec_handler_stop(pl);
+    status = -1;
+  }
+
+  pthread_mutex_unlock(&handler_lock);
+  return status;
+} /* }}} int exec_handler_run */
+
+/* Handlers get all notifications at once, the other programs are started
+ * once per notification. */
+static int exec_notification_deliver(notification_t const *const *n, /* {{{ */
+                                     size_t num) {
+  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
+    /* Only execute `notification' style executables here. */
+    if ((pl->flags & PL_NOTIF_ACTION) == 0)
+      continue;
+
+    if (pl->flags & PL_PERSISTENT) {
+      exec_handler_run(pl, n, num);
+      continue;
+    }
+
+    for (size_t i = 0; i < num; i++)
+      exec_notification_run(pl, n[i]);
+  } /* for (pl) */
+
+  return 0;
+} /* }}} int exec_notification_deliver */
+
+static int exec_notification_pooled(notification_t const *const *n, /* {{{ */
+                                    size_t num,
+                                    void __attribute__((unused)) * arg) {
+  return exec_notification_deliver(n, num);
+} /* }}} int exec_notification_pooled */
+
+/* Returns the queue of the plugin's own workers, creating it if necessary. */
+static notification_queue_t *exec_notification_queue(void) /* {{{ */
+{
+  pthread_mutex_lock(&notif_queue_lock);
+  if ((notif_queue == NULL) && !notif_queue_closed) {
+    notification_queue_config_t conf = {
+        .threads = (size_t)conf_notification_workers,
+        .limit = NOTIFICATION_QUEUE_LIMIT,
+        .batch_size = NOTIFICATION_BATCH_SIZE,
+    };
+    notif_queue =
+        notification_queue_create("exec", &conf, conf.batch_size,
+                                  exec_notification_pooled, /* arg = */ NULL);
+    if (notif_queue == NULL)
+      ERROR("exec plugin: notification_queue_create failed.");
+  }
+  notification_queue_t *nq = notif_queue;
+  pthread_mutex_unlock(&notif_queue_lock);
+
+  return nq;
+} /* }}} notification_queue_t *exec_notification_queue */
 
 static int exec_init(void) /* {{{ */
 {
@@ -826,9 +1368,59 @@ static int exec_init(void) /* {{{ */
   }
 #endif
 
+  if (exec_envp == NULL)
+    exec_envp = exec_environment();
+  if (exec_envp == NULL) {
+    ERROR("exec plugin: Allocating the environment failed.");
+    return -1;
+  }
+
+  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
+    if (pl->path != NULL)
+      continue;
+    pl->path = exec_find_path(pl->exec);
+    if (pl->path == NULL) {
+      ERROR("exec plugin: strdup failed.");
+      return -1;
+    }
+  }
+
   return 0;
 } /* int exec_init }}} */
 
+/* Reports how many programs have been started and how long that took. */
+static void exec_submit_spawn_stats(void) /* {{{ */
+{
+  uint64_t num = __atomic_load_n(&spawn_num, __ATOMIC_RELAXED);
+  uint64_t failed = __atomic_load_n(&spawn_failed, __ATOMIC_RELAXED);
+  uint64_t time = __atomic_load_n(&spawn_time, __ATOMIC_RELAXED);
+
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "exec", sizeof(vl.plugin));
+
+  sstrncpy(vl.type, "latency", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "spawn", sizeof(vl.type_instance));
+  vl.values = &(value_t){
+      .gauge = (num > spawn_num_last)
+                   ? CDTIME_T_TO_DOUBLE((cdtime_t)(time - spawn_time_last)) /
+                         (double)(num - spawn_num_last)
+                   : NAN};
+  plugin_dispatch_values(&vl);
+
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "spawns", sizeof(vl.type_instance));
+  vl.values = &(value_t){.derive = (derive_t)num};
+  plugin_dispatch_values(&vl);
+
+  sstrncpy(vl.type_instance, "spawn_failures", sizeof(vl.type_instance));
+  vl.values = &(value_t){.derive = (derive_t)failed};
+  plugin_dispatch_values(&vl);
+
+  spawn_num_last = num;
+  spawn_time_last = time;
+} /* }}} void exec_submit_spawn_stats */
+
 static int exec_read(void) /* {{{ */
 {
   for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
@@ -858,48 +1450,35 @@ static int exec_read(void) /* {{{ */
     pthread_attr_destroy(&attr);
   } /* for (pl) */
 
+  exec_submit_spawn_stats();
+
   return 0;
 } /* int exec_read }}} */
 
-static int exec_notification(const notification_t *n, /* {{{ */
+static int exec_notification(notification_t const *const *n, /* {{{ */
+                             size_t num,
                              user_data_t __attribute__((unused)) * user_data) {
-  program_list_and_notification_t *pln;
-
-  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
-    pthread_t t;
-    pthread_attr_t attr;
-
-    /* Only execute `notification' style executables here. */
-    if ((pl->flags & PL_NOTIF_ACTION) == 0)
-      continue;
-
-    /* Skip if a child is already running. */
-    if (pl->pid != 0)
-      continue;
-
-    pln = malloc(sizeof(*pln));
-    if (pln == NULL) {
-      ERROR("exec plugin: malloc failed.");
-      continue;
-    }
-
-    pln->pl = pl;
-    memcpy(&pln->n, n, sizeof(notification_t));
-
-    /* Set the `meta' member to NULL, otherwise `plugin_notification_meta_copy'
-     * will run into an endless loop. */
-    pln->n.meta = NULL;
-    plugin_notification_meta_copy(&pln->n, n);
+  /* With "NotificationThreads", this is called by the threads of the
+   * notification queue, which then limit the number of programs running at
+   * once. Otherwise, the notifications are queued for the plugin's own
+   * workers, so that the dispatching thread doesn't wait for the programs. */
+  if (plugin_get_ctx().notification_queue != NULL)
+    return exec_notification_deliver(n, num);
+
+  bool have_programs = false;
+  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next)
+    if (pl->flags & PL_NOTIF_ACTION)
+      have_programs = true;
+  if (!have_programs)
+    return 0;
+
+  notification_queue_t *nq = exec_notification_queue();
+  if (nq == NULL)
+    return -1;
 
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    int status = plugin_thread_create(&t, &attr, exec_notification_one,
-                                      (void *)pln, "exec notify");
-    if (status != 0) {
-      ERROR("exec plugin: plugin_thread_create failed.");
-    }
-    pthread_attr_destroy(&attr);
-  } /* for (pl) */
+  /* Notifications are dropped while the queue is full. */
+  for (size_t i = 0; i < num; i++)
+    notification_queue_enqueue(nq, n[i]);
 
   return 0;
 } /* }}} int exec_notification */
@@ -909,15 +1488,28 @@ static int exec_shutdown(void) /* {{{ */
   program_list_t *pl;
   program_list_t *next;
 
+  /* Runs the programs for the notifications that are still queued. */
+  pthread_mutex_lock(&notif_queue_lock);
+  notification_queue_t *nq = notif_queue;
+  notif_queue = NULL;
+  notif_queue_closed = true;
+  pthread_mutex_unlock(&notif_queue_lock);
+  notification_queue_destroy(nq);
+
   pl = pl_head;
   while (pl != NULL) {
     next = pl->next;
 
-    if (pl->pid > 0) {
+    if (pl->flags & PL_PERSISTENT) {
+      pthread_mutex_lock(&handler_lock);
+      exec_handler_stop(pl);
+      pthread_mutex_unlock(&handler_lock);
+    } else if (pl->pid > 0) {
       kill(pl->pid, SIGTERM);
       INFO("exec plugin: Sent SIGTERM to %hu", (unsigned short int)pl->pid);
     }
 
+    sfree(pl->path);
     sfree(pl->user);
     sfree(pl);
 
@@ -925,6 +1517,9 @@ static int exec_shutdown(void) /* {{{ */
   } /* while (pl) */
   pl_head = NULL;
 
+  exec_environment_free(exec_envp);
+  exec_envp = NULL;
+
   return 0;
 } /* int exec_shutdown }}} */
 
@@ -932,7 +1527,7 @@ void module_register(void) {
   plugin_register_complex_config("exec", exec_config);
   plugin_register_init("exec", exec_init);
   plugin_register_read("exec", exec_read);
-  plugin_register_notification("exec", exec_notification,
-                               /* user_data = */ NULL);
+  plugin_register_notification_batch("exec", exec_notification,
+                                     /* user_data = */ NULL);
   plugin_register_shutdown("exec", exec_shutdown);
 } /* void module_register */
@@ -24,10 +24,11 @@
  *   Florian octo Forster <octo at collectd.org>
  **/
 
+#define _GNU_SOURCE /* For recvmmsg(2) */
+
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
 #if HAVE_NETDB_H
@@ -39,12 +40,14 @@
 #if HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif
-#if HAVE_POLL_H
-#include <poll.h>
-#endif
 
 #include <gm_protocol.h>
 
+/* AIX doesn't have MSG_DONTWAIT */
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT MSG_NONBLOCK
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #ifdef IPV6_JOIN_GROUP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
@@ -59,6 +62,11 @@
 #define BUFF_SIZE 1400
 #endif
 
+/* Number of packets read with one recvmmsg(2) call. */
+#ifndef GMOND_BATCH_SIZE
+#define GMOND_BATCH_SIZE 32
+#endif
+
 struct socket_entry_s {
   int fd;
   struct sockaddr_storage addr;
@@ -66,8 +74,17 @@ struct socket_entry_s {
 };
 typedef struct socket_entry_s socket_entry_t;
 
+/* A listening socket, read by the daemon's event loop. Its buffer has room
+ * for GMOND_BATCH_SIZE * BUFF_SIZE bytes. */
+struct gmond_socket_s {
+  int fd;
+  char *buffer;
+};
+typedef struct gmond_socket_s gmond_socket_t;
+
 struct staging_entry_s {
-  char key[2 * DATA_MAX_NAME_LEN];
+  /* Hash of the host, type and type instance in `vl'. */
+  uint64_t hash;
   value_list_t vl;
   int flags;
 };
@@ -75,6 +92,8 @@ typedef struct staging_entry_s staging_entry_t;
 
 struct metric_map_s {
   char *ganglia_name;
+  /* Hash of `ganglia_name', set when the map's index is built. */
+  uint64_t hash;
   char *type;
   char *type_instance;
   char *ds_name;
@@ -88,112 +107,166 @@ static char *mc_receive_group;
 #define MC_RECEIVE_PORT_DEFAULT "8649"
 static char *mc_receive_port;
 
-static struct pollfd *mc_receive_sockets;
-static size_t mc_receive_sockets_num;
+/* The sockets registered with plugin_register_fd(). */
+static int *mc_receive_fds;
+static size_t mc_receive_fds_num;
 
 static socket_entry_t *mc_send_sockets;
 static size_t mc_send_sockets_num;
 static pthread_mutex_t mc_send_sockets_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static int mc_receive_thread_loop;
-static int mc_receive_thread_running;
-static pthread_t mc_receive_thread_id;
-
 static metric_map_t metric_map_default[] =
     {/*---------------+-------------+-----------+-------------+------+-----*
       * ganglia_name  ! type        ! type_inst ! data_source ! type ! idx *
       *---------------+-------------+-----------+-------------+------+-----*/
-     {"load_one", "load", "", "shortterm", -1, -1},
-     {"load_five", "load", "", "midterm", -1, -1},
-     {"load_fifteen", "load", "", "longterm", -1, -1},
-     {"cpu_user", "cpu", "user", "value", -1, -1},
-     {"cpu_system", "cpu", "system", "value", -1, -1},
-     {"cpu_idle", "cpu", "idle", "value", -1, -1},
-     {"cpu_nice", "cpu", "nice", "value", -1, -1},
-     {"cpu_wio", "cpu", "wait", "value", -1, -1},
-     {"mem_free", "memory", "free", "value", -1, -1},
-     {"mem_shared", "memory", "shared", "value", -1, -1},
-     {"mem_buffers", "memory", "buffered", "value", -1, -1},
-     {"mem_cached", "memory", "cached", "value", -1, -1},
-     {"mem_total", "memory", "total", "value", -1, -1},
-     {"bytes_in", "if_octets", "", "rx", -1, -1},
-     {"bytes_out", "if_octets", "", "tx", -1, -1},
-     {"pkts_in", "if_packets", "", "rx", -1, -1},
-     {"pkts_out", "if_packets", "", "tx", -1, -1}};
+     {"load_one", 0, "load", "", "shortterm", -1, -1},
+     {"load_five", 0, "load", "", "midterm", -1, -1},
+     {"load_fifteen", 0, "load", "", "longterm", -1, -1},
+     {"cpu_user", 0, "cpu", "user", "value", -1, -1},
+     {"cpu_system", 0, "cpu", "system", "value", -1, -1},
+     {"cpu_idle", 0, "cpu", "idle", "value", -1, -1},
+     {"cpu_nice", 0, "cpu", "nice", "value", -1, -1},
+     {"cpu_wio", 0, "cpu", "wait", "value", -1, -1},
+     {"mem_free", 0, "memory", "free", "value", -1, -1},
+     {"mem_shared", 0, "memory", "shared", "value", -1, -1},
+     {"mem_buffers", 0, "memory", "buffered", "value", -1, -1},
+     {"mem_cached", 0, "memory", "cached", "value", -1, -1},
+     {"mem_total", 0, "memory", "total", "value", -1, -1},
+     {"bytes_in", 0, "if_octets", "", "rx", -1, -1},
+     {"bytes_out", 0, "if_octets", "", "tx", -1, -1},
+     {"pkts_in", 0, "if_packets", "", "rx", -1, -1},
+     {"pkts_out", 0, "if_packets", "", "tx", -1, -1}};
 static size_t metric_map_len_default = STATIC_ARRAY_SIZE(metric_map_default);
 
 static metric_map_t *metric_map;
 static size_t metric_map_len;
 
-static c_avl_tree_t *staging_tree;
+/* The metric maps by Ganglia name, user-supplied ones taking precedence over
+ * the built-in ones: an open addressing hash table with linear probing, at
+ * most half full. Built by gmond_init() and only read afterwards. */
+static metric_map_t **metric_index;
+static size_t metric_index_size; /* a power of two */
+
+/* The staging entries by host, type and type instance, organized like
+ * `metric_index'. */
+static staging_entry_t **staging_table;
+static size_t staging_table_size; /* a power of two */
+static size_t staging_table_num;
 static pthread_mutex_t staging_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static metric_map_t *metric_lookup(const char *key) /* {{{ */
+#define GMOND_HASH_INIT 14695981039346656037ULL
+
+/* FNV-1a, like ident_hash(), over at most `max_len' bytes of `str'. */
+static uint64_t gmond_hash(uint64_t hash, char const *str, /* {{{ */
+                           size_t max_len) {
+  for (size_t i = 0; (i < max_len) && (str[i] != 0); i++) {
+    hash ^= (uint8_t)str[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+} /* }}} uint64_t gmond_hash */
+
+static int metric_index_add(metric_map_t *map) /* {{{ */
 {
-  metric_map_t *map;
-  size_t map_len;
+  map->hash = gmond_hash(GMOND_HASH_INIT, map->ganglia_name, SIZE_MAX);
+
+  size_t mask = metric_index_size - 1;
   size_t i;
+  for (i = (size_t)map->hash & mask; metric_index[i] != NULL;
+       i = (i + 1) & mask)
+    if ((metric_index[i]->hash == map->hash) &&
+        (strcmp(metric_index[i]->ganglia_name, map->ganglia_name) == 0))
+      return EEXIST;
 
-  /* Search the user-supplied table first.. */
-  map = metric_map;
-  map_len = metric_map_len;
-  for (i = 0; i < map_len; i++)
-    if (strcmp(map[i].ganglia_name, key) == 0)
-      break;
+  metric_index[i] = map;
+  return 0;
+} /* }}} int metric_index_add */
 
-  /* .. and fall back to the built-in table if nothing is found. */
-  if (i >= map_len) {
-    map = metric_map_default;
-    map_len = metric_map_len_default;
+static int metric_index_create(void) /* {{{ */
+{
+  size_t num = metric_map_len + metric_map_len_default;
+
+  metric_index_size = 16;
+  while (metric_index_size < 2 * num)
+    metric_index_size *= 2;
 
-    for (i = 0; i < map_len; i++)
-      if (strcmp(map[i].ganglia_name, key) == 0)
-        break;
+  metric_index = calloc(metric_index_size, sizeof(*metric_index));
+  if (metric_index == NULL) {
+    metric_index_size = 0;
+    return ENOMEM;
   }
 
-  if (i >= map_len)
+  /* The user-supplied maps are added first, so that they hide built-in ones
+   * of the same name. */
+  for (size_t i = 0; i < metric_map_len; i++)
+    metric_index_add(metric_map + i);
+  for (size_t i = 0; i < metric_map_len_default; i++)
+    metric_index_add(metric_map_default + i);
+
+  return 0;
+} /* }}} int metric_index_create */
+
+static metric_map_t *metric_lookup(const char *key) /* {{{ */
+{
+  metric_map_t *map = NULL;
+
+  if (metric_index == NULL)
+    return NULL;
+
+  uint64_t hash = gmond_hash(GMOND_HASH_INIT, key, SIZE_MAX);
+  size_t mask = metric_index_size - 1;
+  for (size_t j = (size_t)hash & mask; metric_index[j] != NULL;
+       j = (j + 1) & mask) {
+    if ((metric_index[j]->hash == hash) &&
+        (strcmp(metric_index[j]->ganglia_name, key) == 0)) {
+      map = metric_index[j];
+      break;
+    }
+  }
+
+  if (map == NULL)
     return NULL;
 
   /* Look up the DS type and ds_index. */
-  if (map[i].ds_type < 0) /* {{{ */
+  if (map->ds_type < 0) /* {{{ */
   {
     const data_set_t *ds;
 
-    ds = plugin_get_ds(map[i].type);
+    ds = plugin_get_ds(map->type);
     if (ds == NULL) {
-      WARNING("gmond plugin: Type not defined: %s", map[i].type);
+      WARNING("gmond plugin: Type not defined: %s", map->type);
       return NULL;
     }
 
-    if ((map[i].ds_name == NULL) && (ds->ds_num != 1)) {
+    if ((map->ds_name == NULL) && (ds->ds_num != 1)) {
       WARNING("gmond plugin: No data source name defined for metric %s, "
               "but type %s has more than one data source.",
-              map[i].ganglia_name, map[i].type);
+              map->ganglia_name, map->type);
       return NULL;
     }
 
-    if (map[i].ds_name == NULL) {
-      map[i].ds_index = 0;
+    if (map->ds_name == NULL) {
+      map->ds_index = 0;
     } else {
       size_t j;
 
       for (j = 0; j < ds->ds_num; j++)
-        if (strcasecmp(ds->ds[j].name, map[i].ds_name) == 0)
+        if (strcasecmp(ds->ds[j].name, map->ds_name) == 0)
           break;
 
       if (j >= ds->ds_num) {
         WARNING("gmond plugin: There is no data source "
                 "named `%s' in type `%s'.",
-                map[i].ds_name, ds->type);
+                map->ds_name, ds->type);
         return NULL;
       }
-      map[i].ds_index = j;
+      map->ds_index = j;
     }
 
-    map[i].ds_type = ds->ds[map[i].ds_index].type;
-  } /* }}} if ((map[i].ds_type < 0) || (map[i].ds_index < 0)) */
+    map->ds_type = ds->ds[map->ds_index].type;
+  } /* }}} if ((map->ds_type < 0) || (map->ds_index < 0)) */
 
-  return map + i;
+  return map;
 } /* }}} metric_map_t *metric_lookup */
 
 static int create_sockets(socket_entry_t **ret_sockets, /* {{{ */
@@ -386,31 +459,91 @@ static int request_meta_data(const char *host, const char *name) /* {{{ */
   return 0;
 } /* }}} int request_meta_data */
 
+/* The names are compared as far as they fit into a value list, since that's
+ * as far as they are kept. */
+static uint64_t staging_hash(char const *host, char const *type, /* {{{ */
+                             char const *type_instance) {
+  value_list_t *vl = NULL;
+
+  uint64_t hash = gmond_hash(GMOND_HASH_INIT, host, sizeof(vl->host) - 1);
+  /* The separators keep e.g. "ab" "c" and "a" "bc" apart. */
+  hash = gmond_hash(hash, "/", 1);
+  hash = gmond_hash(hash, type, sizeof(vl->type) - 1);
+  hash = gmond_hash(hash, "/", 1);
+  return gmond_hash(hash, type_instance, sizeof(vl->type_instance) - 1);
+} /* }}} uint64_t staging_hash */
+
+static bool staging_entry_matches(staging_entry_t const *se, /* {{{ */
+                                  uint64_t hash, char const *host,
+                                  char const *type,
+                                  char const *type_instance) {
+  return (se->hash == hash) &&
+         (strncmp(se->vl.host, host, sizeof(se->vl.host) - 1) == 0) &&
+         (strncmp(se->vl.type, type, sizeof(se->vl.type) - 1) == 0) &&
+         (strncmp(se->vl.type_instance, type_instance,
+                  sizeof(se->vl.type_instance) - 1) == 0);
+} /* }}} bool staging_entry_matches */
+
+/* Doubles the staging table. Must be called with `staging_lock' held. */
+static int staging_table_grow(void) /* {{{ */
+{
+  size_t size = (staging_table_size == 0) ? 64 : 2 * staging_table_size;
+  staging_entry_t **table = calloc(size, sizeof(*table));
+  if (table == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < staging_table_size; i++) {
+    staging_entry_t *se = staging_table[i];
+    if (se == NULL)
+      continue;
+
+    size_t j = (size_t)se->hash & (size - 1);
+    while (table[j] != NULL)
+      j = (j + 1) & (size - 1);
+    table[j] = se;
+  }
+
+  sfree(staging_table);
+  staging_table = table;
+  staging_table_size = size;
+  return 0;
+} /* }}} int staging_table_grow */
+
 static staging_entry_t *staging_entry_get(const char *host, /* {{{ */
                                           const char *name, const char *type,
                                           const char *type_instance,
                                           int values_len) {
-  char key[2 * DATA_MAX_NAME_LEN];
   staging_entry_t *se;
-  int status;
 
-  if (staging_tree == NULL)
-    return NULL;
-
-  snprintf(key, sizeof(key), "%s/%s/%s", host, type,
-           (type_instance != NULL) ? type_instance : "");
-
-  se = NULL;
-  status = c_avl_get(staging_tree, key, (void *)&se);
-  if (status == 0)
-    return se;
+  if (type_instance == NULL)
+    type_instance = "";
+
+  uint64_t hash = staging_hash(host, type, type_instance);
+  size_t mask = staging_table_size - 1;
+  size_t i = 0;
+  if (staging_table_size > 0) {
+    for (i = (size_t)hash & mask; staging_table[i] != NULL; i = (i + 1) & mask)
+      if (staging_entry_matches(staging_table[i], hash, host, type,
+                                type_instance))
+        return staging_table[i];
+  }
 
   /* insert new entry */
+  if (2 * (staging_table_num + 1) > staging_table_size) {
+    if (staging_table_grow() != 0) {
+      ERROR("gmond plugin: Growing the staging table failed.");
+      return NULL;
+    }
+    mask = staging_table_size - 1;
+    for (i = (size_t)hash & mask; staging_table[i] != NULL; i = (i + 1) & mask)
+      ;
+  }
+
   se = calloc(1, sizeof(*se));
   if (se == NULL)
     return NULL;
 
-  sstrncpy(se->key, key, sizeof(se->key));
+  se->hash = hash;
   se->flags = 0;
 
   se->vl.values = calloc(values_len, sizeof(*se->vl.values));
@@ -425,16 +558,10 @@ static staging_entry_t *staging_entry_get(const char *host, /* {{{ */
   sstrncpy(se->vl.host, host, sizeof(se->vl.host));
   sstrncpy(se->vl.plugin, "gmond", sizeof(se->vl.plugin));
   sstrncpy(se->vl.type, type, sizeof(se->vl.type));
-  if (type_instance != NULL)
-    sstrncpy(se->vl.type_instance, type_instance, sizeof(se->vl.type_instance));
+  sstrncpy(se->vl.type_instance, type_instance, sizeof(se->vl.type_instance));
 
-  status = c_avl_insert(staging_tree, se->key, se);
-  if (status != 0) {
-    ERROR("gmond plugin: c_avl_insert failed.");
-    sfree(se->vl.values);
-    sfree(se);
-    return NULL;
-  }
+  staging_table[i] = se;
+  staging_table_num++;
 
   return se;
 } /* }}} staging_entry_t *staging_entry_get */
@@ -665,6 +792,8 @@ static int mc_handle_metadata_msg(Ganglia_metadata_msg *msg) /* {{{ */
   return 0;
 } /* }}} int mc_handle_metadata_msg */
 
+/* Decodes and handles one packet. The strings the XDR functions allocate
+ * while decoding are freed afterwards. */
 static int mc_handle_metric(void *buffer, size_t buffer_size) /* {{{ */
 {
   XDR xdr;
@@ -687,6 +816,7 @@ static int mc_handle_metric(void *buffer, size_t buffer_size) /* {{{ */
 
     if (xdr_Ganglia_value_msg(&xdr, &msg))
       mc_handle_value_msg(&msg);
+    xdr_free((xdrproc_t)xdr_Ganglia_value_msg, (char *)&msg);
     break;
   }
 
@@ -695,6 +825,7 @@ static int mc_handle_metric(void *buffer, size_t buffer_size) /* {{{ */
     Ganglia_metadata_msg msg = {0};
     if (xdr_Ganglia_metadata_msg(&xdr, &msg))
       mc_handle_metadata_msg(&msg);
+    xdr_free((xdrproc_t)xdr_Ganglia_metadata_msg, (char *)&msg);
     break;
   }
 
@@ -703,121 +834,146 @@ static int mc_handle_metric(void *buffer, size_t buffer_size) /* {{{ */
     return -1;
   } /* switch (format) */
 
+  xdr_destroy(&xdr);
   return 0;
 } /* }}} int mc_handle_metric */
 
-static int mc_handle_socket(struct pollfd *p) /* {{{ */
+/* Called by the daemon's event loop. Reads up to GMOND_BATCH_SIZE packets
+ * without blocking. */
+static void mc_handle_socket(int fd, user_data_t *ud) /* {{{ */
 {
-  char buffer[BUFF_SIZE];
-  ssize_t buffer_size;
+  gmond_socket_t *sock = ud->data;
+  char *buffer = sock->buffer;
+
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[GMOND_BATCH_SIZE];
+  struct iovec iov[GMOND_BATCH_SIZE];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < GMOND_BATCH_SIZE; i++) {
+    iov[i].iov_base = buffer + i * BUFF_SIZE;
+    iov[i].iov_len = BUFF_SIZE;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
 
-  if ((p->revents & (POLLIN | POLLPRI)) == 0) {
-    p->revents = 0;
-    return -1;
+  int status;
+  do {
+    status = recvmmsg(fd, msgs, GMOND_BATCH_SIZE, MSG_DONTWAIT,
+                      /* timeout = */ NULL);
+  } while ((status < 0) && (errno == EINTR));
+
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return;
+    ERROR("gmond plugin: recvmmsg failed: %s", STRERRNO);
+    return;
   }
 
-  buffer_size = recv(p->fd, buffer, sizeof(buffer), /* flags = */ 0);
+  for (int i = 0; i < status; i++)
+    mc_handle_metric(buffer + i * BUFF_SIZE, (size_t)msgs[i].msg_len);
+#else
+  ssize_t buffer_size = recv(fd, buffer, BUFF_SIZE, MSG_DONTWAIT);
   if (buffer_size <= 0) {
+    if ((buffer_size < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+      return;
     ERROR("gmond plugin: recv failed: %s", STRERRNO);
-    p->revents = 0;
-    return -1;
+    return;
   }
 
   mc_handle_metric(buffer, (size_t)buffer_size);
-  return 0;
-} /* }}} int mc_handle_socket */
+#endif
+} /* }}} void mc_handle_socket */
 
-static void *mc_receive_thread(void *arg) /* {{{ */
+static void mc_socket_free(void *arg) /* {{{ */
 {
-  socket_entry_t *mc_receive_socket_entries;
-  int status;
+  gmond_socket_t *sock = arg;
+
+  close(sock->fd);
+  sfree(sock->buffer);
+  sfree(sock);
+} /* }}} void mc_socket_free */
 
-  mc_receive_socket_entries = NULL;
-  status = create_sockets(
-      &mc_receive_socket_entries, &mc_receive_sockets_num,
+/* Opens the listening sockets and hands them to the daemon's event loop,
+ * which closes them once they have been unregistered. */
+static int mc_receive_start(void) /* {{{ */
+{
+  socket_entry_t *entries = NULL;
+  size_t entries_num = 0;
+
+  if (mc_receive_fds != NULL)
+    return -1;
+
+  int status = create_sockets(
+      &entries, &entries_num,
       (mc_receive_group != NULL) ? mc_receive_group : MC_RECEIVE_GROUP_DEFAULT,
       (mc_receive_port != NULL) ? mc_receive_port : MC_RECEIVE_PORT_DEFAULT,
       /* listen = */ 1);
   if (status != 0) {
     ERROR("gmond plugin: create_sockets failed.");
-    return (void *)-1;
+    return -1;
   }
 
-  mc_receive_sockets =
-      calloc(mc_receive_sockets_num, sizeof(*mc_receive_sockets));
-  if (mc_receive_sockets == NULL) {
+  mc_receive_fds = calloc(entries_num, sizeof(*mc_receive_fds));
+  if (mc_receive_fds == NULL) {
     ERROR("gmond plugin: calloc failed.");
-    for (size_t i = 0; i < mc_receive_sockets_num; i++)
-      close(mc_receive_socket_entries[i].fd);
-    free(mc_receive_socket_entries);
-    mc_receive_socket_entries = NULL;
-    mc_receive_sockets_num = 0;
-    return (void *)-1;
-  }
-
-  for (size_t i = 0; i < mc_receive_sockets_num; i++) {
-    mc_receive_sockets[i].fd = mc_receive_socket_entries[i].fd;
-    mc_receive_sockets[i].events = POLLIN | POLLPRI;
-    mc_receive_sockets[i].revents = 0;
+    for (size_t i = 0; i < entries_num; i++)
+      close(entries[i].fd);
+    free(entries);
+    return -1;
   }
 
-  while (mc_receive_thread_loop != 0) {
-    status = poll(mc_receive_sockets, mc_receive_sockets_num, -1);
-    if (status <= 0) {
-      if (errno == EINTR)
-        continue;
-      ERROR("gmond plugin: poll failed: %s", STRERRNO);
-      break;
+  for (size_t i = 0; i < entries_num; i++) {
+    gmond_socket_t *sock = calloc(1, sizeof(*sock));
+    if (sock == NULL) {
+      ERROR("gmond plugin: calloc failed.");
+      close(entries[i].fd);
+      continue;
     }
-
-    for (size_t i = 0; i < mc_receive_sockets_num; i++) {
-      if (mc_receive_sockets[i].revents != 0)
-        mc_handle_socket(mc_receive_sockets + i);
+    sock->fd = entries[i].fd;
+    sock->buffer = malloc(GMOND_BATCH_SIZE * BUFF_SIZE);
+    if (sock->buffer == NULL) {
+      ERROR("gmond plugin: malloc failed.");
+      mc_socket_free(sock);
+      continue;
     }
-  } /* while (mc_receive_thread_loop != 0) */
-
-  free(mc_receive_socket_entries);
-  return (void *)0;
-} /* }}} void *mc_receive_thread */
 
-static int mc_receive_thread_start(void) /* {{{ */
-{
-  int status;
-
-  if (mc_receive_thread_running != 0)
-    return -1;
+    status = plugin_register_fd(sock->fd, mc_handle_socket,
+                                &(user_data_t){
+                                    .data = sock,
+                                    .free_func = mc_socket_free,
+                                });
+    if (status != 0) {
+      mc_socket_free(sock);
+      continue;
+    }
 
-  mc_receive_thread_loop = 1;
+    mc_receive_fds[mc_receive_fds_num] = entries[i].fd;
+    mc_receive_fds_num++;
+  }
+  free(entries);
 
-  status =
-      plugin_thread_create(&mc_receive_thread_id, /* attr = */ NULL,
-                           mc_receive_thread, /* args = */ NULL, "gmond recv");
-  if (status != 0) {
-    ERROR("gmond plugin: Starting receive thread failed.");
-    mc_receive_thread_loop = 0;
+  if (mc_receive_fds_num == 0) {
+    sfree(mc_receive_fds);
     return -1;
   }
 
-  mc_receive_thread_running = 1;
   return 0;
-} /* }}} int start_receive_thread */
+} /* }}} int mc_receive_start */
 
-static int mc_receive_thread_stop(void) /* {{{ */
+static int mc_receive_stop(void) /* {{{ */
 {
-  if (mc_receive_thread_running == 0)
+  if (mc_receive_fds == NULL)
     return -1;
 
-  mc_receive_thread_loop = 0;
-
-  INFO("gmond plugin: Stopping receive thread.");
-  pthread_kill(mc_receive_thread_id, SIGTERM);
-  pthread_join(mc_receive_thread_id, /* return value = */ NULL);
-  memset(&mc_receive_thread_id, 0, sizeof(mc_receive_thread_id));
-
-  mc_receive_thread_running = 0;
+  INFO("gmond plugin: Closing the receive sockets.");
+  for (size_t i = 0; i < mc_receive_fds_num; i++)
+    plugin_unregister_fd(mc_receive_fds[i]);
+  sfree(mc_receive_fds);
+  mc_receive_fds_num = 0;
 
   return 0;
-} /* }}} int mc_receive_thread_stop */
+} /* }}} int mc_receive_stop */
 
 /*
  * Config:
@@ -953,20 +1109,19 @@ static int gmond_init(void) /* {{{ */
       (mc_receive_port != NULL) ? mc_receive_port : MC_RECEIVE_PORT_DEFAULT,
       /* listen = */ 0);
 
-  staging_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
-  if (staging_tree == NULL) {
-    ERROR("gmond plugin: c_avl_create failed.");
+  if (metric_index_create() != 0) {
+    ERROR("gmond plugin: Creating the metric index failed.");
     return -1;
   }
 
-  mc_receive_thread_start();
+  mc_receive_start();
 
   return 0;
 } /* }}} int gmond_init */
 
 static int gmond_shutdown(void) /* {{{ */
 {
-  mc_receive_thread_stop();
+  mc_receive_stop();
 
   pthread_mutex_lock(&mc_send_sockets_lock);
   for (size_t i = 0; i < mc_send_sockets_num; i++) {
@@ -977,6 +1132,21 @@ static int gmond_shutdown(void) /* {{{ */
   mc_send_sockets_num = 0;
   pthread_mutex_unlock(&mc_send_sockets_lock);
 
+  pthread_mutex_lock(&staging_lock);
+  for (size_t i = 0; i < staging_table_size; i++) {
+    if (staging_table[i] == NULL)
+      continue;
+    sfree(staging_table[i]->vl.values);
+    sfree(staging_table[i]);
+  }
+  sfree(staging_table);
+  staging_table_size = 0;
+  staging_table_num = 0;
+  pthread_mutex_unlock(&staging_lock);
+
+  sfree(metric_index);
+  metric_index_size = 0;
+
   return 0;
 } /* }}} int gmond_shutdown */
 
@@ -31,9 +31,8 @@ SOFTWARE.
 #define MAX_DEVNAME_LEN 256
 #define PLUGIN_NAME "gpu_nvidia"
 
-static nvmlReturn_t nv_status = NVML_SUCCESS;
-static char *nv_errline = "";
-
+// The macros below expect "nv_status" and "nv_errline" variables in the
+// calling function. They are local, since devices are read concurrently.
 #define TRY_CATCH(f, catch)                                                    \
   if ((nv_status = f) != NVML_SUCCESS) {                                       \
     nv_errline = #f;                                                           \
@@ -63,6 +62,42 @@ static const unsigned int n_config_keys = STATIC_ARRAY_SIZE(config_keys);
 static uint64_t conf_match_mask = 0;
 static bool conf_mask_is_exclude = 0;
 
+// Each selected GPU has a read callback of its own, so that the read threads
+// sample the GPUs in parallel. The handle and name are looked up again after
+// a call on the device failed.
+typedef struct {
+  unsigned int index;
+  bool have_handle;
+  nvmlDevice_t dev;
+  char name[MAX_DEVNAME_LEN + 1];
+  // Cleared if the driver or device doesn't support field queries.
+  bool use_fields;
+} nvml_device_t;
+
+// Metrics fetched with one nvmlDeviceGetFieldValues() call per read. The field
+// IDs are macros of nvml.h, so fields the headers don't know are left out and
+// the metrics are read with the calls for them below.
+#if defined(NVML_FI_DEV_POWER_INSTANT) || defined(NVML_FI_DEV_MEMORY_TEMP)
+#define HAVE_NVML_FIELDS 1
+typedef struct {
+  unsigned int field_id;
+  const char *type;
+  const char *type_instance;
+  double scale;
+} nvml_field_t;
+
+static const nvml_field_t nvml_fields[] = {
+#ifdef NVML_FI_DEV_POWER_INSTANT
+    {NVML_FI_DEV_POWER_INSTANT, "power", NULL, 1e-3},
+#endif
+#ifdef NVML_FI_DEV_MEMORY_TEMP
+    {NVML_FI_DEV_MEMORY_TEMP, "temperature", "memory", 1.0},
+#endif
+};
+#else
+#define HAVE_NVML_FIELDS 0
+#endif
+
 static int nvml_config(const char *key, const char *value) {
 
   if (strcasecmp(key, KEY_GPUINDEX) == 0) {
@@ -88,19 +123,62 @@ static int nvml_config(const char *key, const char *value) {
   return 0;
 }
 
+static int nvml_read_device(user_data_t *ud);
+
 static int nvml_init(void) {
+  nvmlReturn_t nv_status = NVML_SUCCESS;
+  const char *nv_errline = "";
+
   TRY(nvmlInit());
+
+  unsigned int device_count;
+  TRY(nvmlDeviceGetCount(&device_count));
+
+  if (device_count > 64) {
+    device_count = 64;
+  }
+
+  for (unsigned int ix = 0; ix < device_count; ix++) {
+
+    unsigned int is_match =
+        ((1 << ix) & conf_match_mask) || (conf_match_mask == 0);
+    if (conf_mask_is_exclude == !!is_match) {
+      continue;
+    }
+
+    nvml_device_t *d = calloc(1, sizeof(*d));
+    if (d == NULL) {
+      ERROR(PLUGIN_NAME ": calloc failed.");
+      continue;
+    }
+    d->index = ix;
+    d->use_fields = HAVE_NVML_FIELDS;
+
+    char cb_name[DATA_MAX_NAME_LEN];
+    snprintf(cb_name, sizeof(cb_name), PLUGIN_NAME "-%u", ix);
+    plugin_register_complex_read(/* group = */ PLUGIN_NAME, cb_name,
+                                 nvml_read_device, /* interval = */ 0,
+                                 &(user_data_t){
+                                     .data = d, .free_func = free,
+                                 });
+  }
+
   return 0;
 
-  catch : ERROR(PLUGIN_NAME ": NVML init failed with %d", nv_status);
+  catch : ERROR(PLUGIN_NAME ": NVML init failed (\"%s\" returned %d)",
+                nv_errline, nv_status);
   return -1;
 }
 
 static int nvml_shutdown(void) {
+  nvmlReturn_t nv_status = NVML_SUCCESS;
+  const char *nv_errline = "";
+
   TRY(nvmlShutdown())
   return 0;
 
-  catch : ERROR(PLUGIN_NAME ": NVML shutdown failed with %d", nv_status);
+  catch : ERROR(PLUGIN_NAME ": NVML shutdown failed (\"%s\" returned %d)",
+                nv_errline, nv_status);
   return -1;
 }
 
@@ -124,92 +202,144 @@ static void nvml_submit_gauge(const char *plugin_instance, const char *type,
   plugin_dispatch_values(&vl);
 }
 
-static int nvml_read(void) {
-
-  unsigned int device_count;
-  TRY_CATCH(nvmlDeviceGetCount(&device_count), catch_nocount);
-
-  if (device_count > 64) {
-    device_count = 64;
+#if HAVE_NVML_FIELDS
+static gauge_t nvml_field_gauge(nvmlFieldValue_t const *v) {
+  switch (v->valueType) {
+  case NVML_VALUE_TYPE_DOUBLE:
+    return (gauge_t)v->value.dVal;
+  case NVML_VALUE_TYPE_UNSIGNED_INT:
+    return (gauge_t)v->value.uiVal;
+  case NVML_VALUE_TYPE_UNSIGNED_LONG:
+    return (gauge_t)v->value.ulVal;
+  case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+    return (gauge_t)v->value.ullVal;
+  case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+    return (gauge_t)v->value.sllVal;
+  default:
+    return NAN;
   }
+}
 
-  for (unsigned int ix = 0; ix < device_count; ix++) {
+// Reads and submits all fields with one call. Sets "ret_power" if the power
+// usage has been submitted.
+static nvmlReturn_t nvml_read_fields(nvml_device_t *d, bool *ret_power) {
+  nvmlFieldValue_t values[STATIC_ARRAY_SIZE(nvml_fields)];
+  memset(values, 0, sizeof(values));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(nvml_fields); i++)
+    values[i].fieldId = nvml_fields[i].field_id;
+
+  nvmlReturn_t status = nvmlDeviceGetFieldValues(
+      d->dev, (int)STATIC_ARRAY_SIZE(values), values);
+  if (status != NVML_SUCCESS)
+    return status;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(nvml_fields); i++) {
+    if (values[i].nvmlReturn != NVML_SUCCESS)
+      continue;
 
-    unsigned int is_match =
-        ((1 << ix) & conf_match_mask) || (conf_match_mask == 0);
-    if (conf_mask_is_exclude == !!is_match) {
+    gauge_t value = nvml_field_gauge(values + i);
+    if (isnan(value))
       continue;
-    }
 
-    nvmlDevice_t dev;
-    TRY(nvmlDeviceGetHandleByIndex(ix, &dev));
+    nvml_submit_gauge(d->name, nvml_fields[i].type,
+                      nvml_fields[i].type_instance,
+                      nvml_fields[i].scale * value);
+    if (strcmp("power", nvml_fields[i].type) == 0)
+      *ret_power = true;
+  }
 
-    char dev_name[MAX_DEVNAME_LEN + 1] = {0};
-    TRY(nvmlDeviceGetName(dev, dev_name, sizeof(dev_name) - 1));
+  return NVML_SUCCESS;
+}
+#endif
+
+static int nvml_read_device(user_data_t *ud) {
+  nvml_device_t *d = ud->data;
+  nvmlReturn_t nv_status = NVML_SUCCESS;
+  const char *nv_errline = "";
+
+  if (!d->have_handle) {
+    TRY(nvmlDeviceGetHandleByIndex(d->index, &d->dev));
+    memset(d->name, 0, sizeof(d->name));
+    TRY(nvmlDeviceGetName(d->dev, d->name, sizeof(d->name) - 1));
+    d->have_handle = true;
+  }
 
-    // Try to be as lenient as possible with the variety of devices that are
-    // out there, ignoring any NOT_SUPPORTED errors gently.
-    nvmlMemory_t meminfo;
-    TRYOPT(nvmlDeviceGetMemoryInfo(dev, &meminfo))
-    if (nv_status == NVML_SUCCESS) {
-      nvml_submit_gauge(dev_name, "memory", "used", meminfo.used);
-      nvml_submit_gauge(dev_name, "memory", "free", meminfo.free);
+  nvmlDevice_t dev = d->dev;
+  const char *dev_name = d->name;
+  bool have_power = false;
+
+#if HAVE_NVML_FIELDS
+  if (d->use_fields) {
+    nv_status = nvml_read_fields(d, &have_power);
+    if ((nv_status == NVML_ERROR_NOT_SUPPORTED) ||
+        (nv_status == NVML_ERROR_FUNCTION_NOT_FOUND)) {
+      INFO(PLUGIN_NAME ": Field queries are not supported on dev at index %u, "
+                       "falling back to one call per metric.",
+           d->index);
+      d->use_fields = false;
+    } else if (nv_status != NVML_SUCCESS) {
+      nv_errline = "nvmlDeviceGetFieldValues(dev, ...)";
+      goto catch;
     }
+  }
+#endif
+
+  // Try to be as lenient as possible with the variety of devices that are
+  // out there, ignoring any NOT_SUPPORTED errors gently.
+  nvmlMemory_t meminfo;
+  TRYOPT(nvmlDeviceGetMemoryInfo(dev, &meminfo))
+  if (nv_status == NVML_SUCCESS) {
+    nvml_submit_gauge(dev_name, "memory", "used", meminfo.used);
+    nvml_submit_gauge(dev_name, "memory", "free", meminfo.free);
+  }
 
-    nvmlUtilization_t utilization;
-    TRYOPT(nvmlDeviceGetUtilizationRates(dev, &utilization))
-    if (nv_status == NVML_SUCCESS)
-      nvml_submit_gauge(dev_name, "percent", "gpu_used", utilization.gpu);
-
-    unsigned int fan_speed;
-    TRYOPT(nvmlDeviceGetFanSpeed(dev, &fan_speed))
-    if (nv_status == NVML_SUCCESS)
-      nvml_submit_gauge(dev_name, "fanspeed", NULL, fan_speed);
-
-    unsigned int core_temp;
-    TRYOPT(nvmlDeviceGetTemperature(dev, NVML_TEMPERATURE_GPU, &core_temp))
-    if (nv_status == NVML_SUCCESS)
-      nvml_submit_gauge(dev_name, "temperature", "core", core_temp);
-
-    unsigned int sm_clk_mhz;
-    TRYOPT(nvmlDeviceGetClockInfo(dev, NVML_CLOCK_SM, &sm_clk_mhz))
-    if (nv_status == NVML_SUCCESS)
-      nvml_submit_gauge(dev_name, "frequency", "multiprocessor",
-                        1e6 * sm_clk_mhz);
-
-    unsigned int mem_clk_mhz;
-    TRYOPT(nvmlDeviceGetClockInfo(dev, NVML_CLOCK_MEM, &mem_clk_mhz))
-    if (nv_status == NVML_SUCCESS)
-      nvml_submit_gauge(dev_name, "frequency", "memory", 1e6 * mem_clk_mhz);
-
+  nvmlUtilization_t utilization;
+  TRYOPT(nvmlDeviceGetUtilizationRates(dev, &utilization))
+  if (nv_status == NVML_SUCCESS)
+    nvml_submit_gauge(dev_name, "percent", "gpu_used", utilization.gpu);
+
+  unsigned int fan_speed;
+  TRYOPT(nvmlDeviceGetFanSpeed(dev, &fan_speed))
+  if (nv_status == NVML_SUCCESS)
+    nvml_submit_gauge(dev_name, "fanspeed", NULL, fan_speed);
+
+  unsigned int core_temp;
+  TRYOPT(nvmlDeviceGetTemperature(dev, NVML_TEMPERATURE_GPU, &core_temp))
+  if (nv_status == NVML_SUCCESS)
+    nvml_submit_gauge(dev_name, "temperature", "core", core_temp);
+
+  unsigned int sm_clk_mhz;
+  TRYOPT(nvmlDeviceGetClockInfo(dev, NVML_CLOCK_SM, &sm_clk_mhz))
+  if (nv_status == NVML_SUCCESS)
+    nvml_submit_gauge(dev_name, "frequency", "multiprocessor",
+                      1e6 * sm_clk_mhz);
+
+  unsigned int mem_clk_mhz;
+  TRYOPT(nvmlDeviceGetClockInfo(dev, NVML_CLOCK_MEM, &mem_clk_mhz))
+  if (nv_status == NVML_SUCCESS)
+    nvml_submit_gauge(dev_name, "frequency", "memory", 1e6 * mem_clk_mhz);
+
+  if (!have_power) {
     unsigned int power_mW;
     TRYOPT(nvmlDeviceGetPowerUsage(dev, &power_mW))
     if (nv_status == NVML_SUCCESS)
       nvml_submit_gauge(dev_name, "power", NULL, 1e-3 * power_mW);
-
-    continue;
-
-    // Failures here indicate transient errors or removal of GPU. In either
-    // case it will either be resolved or the GPU will no longer be enumerated
-    // the next time round.
-    catch : WARNING(PLUGIN_NAME
-                    ": NVML call \"%s\" failed (%d) on dev at index %d!",
-                    nv_errline, nv_status, ix);
-    continue;
   }
 
   return 0;
 
-// Failures here indicate serious misconfiguration; we bail out totally.
-catch_nocount:
-  ERROR(PLUGIN_NAME ": Failed to enumerate NVIDIA GPUs (\"%s\" returned %d)",
-        nv_errline, nv_status);
-  return -1;
+  // Failures here indicate transient errors or removal of GPU. In either
+  // case it will either be resolved or the GPU won't be found the next time
+  // round, since the handle is looked up again.
+  catch : WARNING(PLUGIN_NAME
+                  ": NVML call \"%s\" failed (%d) on dev at index %u!",
+                  nv_errline, nv_status, d->index);
+  d->have_handle = false;
+  return 0;
 }
 
 void module_register(void) {
   plugin_register_init(PLUGIN_NAME, nvml_init);
   plugin_register_config(PLUGIN_NAME, nvml_config, config_keys, n_config_keys);
-  plugin_register_read(PLUGIN_NAME, nvml_read);
   plugin_register_shutdown(PLUGIN_NAME, nvml_shutdown);
 }
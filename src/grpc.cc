@@ -31,6 +31,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <queue>
 #include <vector>
 
@@ -71,27 +72,91 @@ struct Listener {
 };
 static std::vector<Listener> listeners;
 static grpc::string default_addr("0.0.0.0:50051");
+static int worker_threads = 0;
 
 /*
  * helper functions
  */
 
-static bool ident_matches(const value_list_t *vl, const value_list_t *matcher) {
-  if (fnmatch(matcher->host, vl->host, 0))
-    return false;
+/* IdentMatcher matches identifiers against the shell wildcard patterns of a
+ * QueryValues request. Fields without wildcards are compared literally and
+ * the literal prefix of the patterns, for example "host/cpu" for the host
+ * "host" and the plugin "cpu*", rules out most cache entries by their name
+ * alone, i.e. without parsing the identifier. */
+class IdentMatcher final {
+public:
+  IdentMatcher(value_list_t const *match) : match_(*match), exact_(true) {
+    char const *fields[] = {match_.host, match_.plugin, match_.plugin_instance,
+                            match_.type, match_.type_instance};
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++)
+      literal_[i] = (strpbrk(fields[i], "*?[\\") == NULL);
+
+    /* The name of a cache entry is "host/plugin[-pi]/type[-ti]". */
+    if (!AppendPrefix(match_.host, literal_[0]))
+      return;
+    prefix_.push_back('/');
+    if (!AppendPrefix(match_.plugin, literal_[1]))
+      return;
+    if (!literal_[2]) {
+      exact_ = false;
+      return;
+    }
+    if (match_.plugin_instance[0] != '\0')
+      prefix_ += grpc::string("-") + match_.plugin_instance;
+    prefix_.push_back('/');
+    if (!AppendPrefix(match_.type, literal_[3]))
+      return;
+    if (!literal_[4]) {
+      exact_ = false;
+      return;
+    }
+    if (match_.type_instance[0] != '\0')
+      prefix_ += grpc::string("-") + match_.type_instance;
+  }
 
-  if (fnmatch(matcher->plugin, vl->plugin, 0))
-    return false;
-  if (fnmatch(matcher->plugin_instance, vl->plugin_instance, 0))
-    return false;
+  /* NameMayMatch returns false if the identifier "name" cannot match. */
+  bool NameMayMatch(char const *name) const {
+    if (exact_)
+      return prefix_.compare(name) == 0;
+    return strncmp(name, prefix_.c_str(), prefix_.size()) == 0;
+  }
 
-  if (fnmatch(matcher->type, vl->type, 0))
-    return false;
-  if (fnmatch(matcher->type_instance, vl->type_instance, 0))
+  bool Matches(value_list_t const *vl) const {
+    return FieldMatches(0, match_.host, vl->host) &&
+           FieldMatches(1, match_.plugin, vl->plugin) &&
+           FieldMatches(2, match_.plugin_instance, vl->plugin_instance) &&
+           FieldMatches(3, match_.type, vl->type) &&
+           FieldMatches(4, match_.type_instance, vl->type_instance);
+  }
+
+  /* Exact returns true if at most one identifier matches. */
+  bool Exact() const { return exact_; }
+
+private:
+  /* AppendPrefix appends the literal part of "pattern" to the prefix and
+   * returns true if the pattern is literal, i.e. the prefix can be extended
+   * by the following fields. */
+  bool AppendPrefix(char const *pattern, bool literal) {
+    if (literal) {
+      prefix_ += pattern;
+      return true;
+    }
+    prefix_.append(pattern, strcspn(pattern, "*?[\\"));
+    exact_ = false;
     return false;
+  }
+
+  bool FieldMatches(size_t i, char const *pattern, char const *s) const {
+    if (literal_[i])
+      return strcmp(pattern, s) == 0;
+    return fnmatch(pattern, s, 0) == 0;
+  }
 
-  return true;
-} /* ident_matches */
+  value_list_t match_;
+  bool literal_[5];
+  grpc::string prefix_;
+  bool exact_;
+}; /* class IdentMatcher */
 
 static grpc::string read_file(const char *filename) {
   std::ifstream f;
@@ -276,8 +341,11 @@ static grpc::Status unmarshal_meta_data(const grpcMetadata &rpc_metadata,
   return grpc::Status::OK;
 }
 
+/* If "rates" is true, the values are gauges holding the rates of the data
+ * sources, as returned by the value cache. */
 static grpc::Status marshal_value_list(const value_list_t *vl,
-                                       collectd::types::ValueList *msg) {
+                                       collectd::types::ValueList *msg,
+                                       bool rates = false) {
   auto id = msg->mutable_identifier();
   marshal_ident(vl, id);
 
@@ -302,7 +370,7 @@ static grpc::Status marshal_value_list(const value_list_t *vl,
 
   for (size_t i = 0; i < vl->values_len; ++i) {
     auto v = msg->add_values();
-    int value_type = ds->ds[i].type;
+    int value_type = rates ? DS_TYPE_GAUGE : ds->ds[i].type;
     switch (value_type) {
     case DS_TYPE_COUNTER:
       v->set_counter(vl->values[i].counter);
@@ -401,16 +469,24 @@ public:
   grpc::Status
   QueryValues(grpc::ServerContext *ctx, QueryValuesRequest const *req,
               grpc::ServerWriter<QueryValuesResponse> *writer) override {
-    value_list_t match;
+    value_list_t match = {0};
     auto status = unmarshal_ident(req->identifier(), &match, false);
     if (!status.ok()) {
       return status;
     }
 
+    bool history = req->has_start() || req->has_end();
+    cdtime_t start = 0;
+    cdtime_t end = UINT64_MAX;
+    if (req->has_start())
+      start = NS_TO_CDTIME_T(TimeUtil::TimestampToNanoseconds(req->start()));
+    if (req->has_end())
+      end = NS_TO_CDTIME_T(TimeUtil::TimestampToNanoseconds(req->end()));
+
     std::queue<value_list_t> value_lists;
-    status = this->queryValuesRead(&match, &value_lists);
+    status = this->queryValuesRead(&match, history, start, end, &value_lists);
     if (status.ok()) {
-      status = this->queryValuesWrite(ctx, writer, &value_lists);
+      status = this->queryValuesWrite(ctx, writer, &value_lists, history);
     }
 
     while (!value_lists.empty()) {
@@ -429,15 +505,17 @@ public:
     PutValuesRequest req;
 
     while (reader->Read(&req)) {
-      value_list_t vl = {0};
-      auto status = unmarshal_value_list(req.value_list(), &vl);
-      if (!status.ok())
-        return status;
+      if (req.has_value_list()) {
+        auto status = this->dispatchValueList(req.value_list());
+        if (!status.ok())
+          return status;
+      }
 
-      if (plugin_dispatch_values(&vl))
-        return grpc::Status(
-            grpc::StatusCode::INTERNAL,
-            grpc::string("failed to enqueue values for writing"));
+      for (auto const &msg : req.value_lists()) {
+        auto status = this->dispatchValueList(msg);
+        if (!status.ok())
+          return status;
+      }
     }
 
     res->Clear();
@@ -445,7 +523,64 @@ public:
   }
 
 private:
-  grpc::Status queryValuesRead(value_list_t const *match,
+  grpc::Status dispatchValueList(collectd::types::ValueList const &msg) {
+    value_list_t vl = {0};
+    auto status = unmarshal_value_list(msg, &vl);
+    if (!status.ok())
+      return status;
+
+    int err = plugin_dispatch_values(&vl);
+    sfree(vl.values);
+    meta_data_destroy(vl.meta);
+    if (err)
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to enqueue values for writing"));
+
+    return grpc::Status::OK;
+  }
+
+  /* Adds one value list per point of the history of "name". */
+  grpc::Status queryHistoryRead(char const *name, value_list_t const *vl,
+                                cdtime_t start, cdtime_t end,
+                                std::queue<value_list_t> *value_lists) {
+    cdtime_t *times = NULL;
+    gauge_t *values = NULL;
+    size_t num = 0;
+    size_t values_num = 0;
+    int err = uc_get_series_by_name(name, start, end, &times, &values, &num,
+                                    &values_num);
+    if (err == -ENOENT) {
+      /* The entry has expired since the iterator was created. */
+      return grpc::Status::OK;
+    } else if (err != 0) {
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to retrieve value history"));
+    }
+
+    grpc::Status status = grpc::Status::OK;
+    for (size_t i = 0; i < num; i++) {
+      value_list_t point = *vl;
+      point.time = times[i];
+      point.values_len = values_num;
+      point.values = (value_t *)calloc(values_num, sizeof(*point.values));
+      if (point.values == NULL) {
+        status = grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                              grpc::string("failed to allocate values"));
+        break;
+      }
+      for (size_t j = 0; j < values_num; j++)
+        point.values[j].gauge = values[i * values_num + j];
+
+      value_lists->push(point);
+    }
+
+    sfree(times);
+    sfree(values);
+    return status;
+  }
+
+  grpc::Status queryValuesRead(value_list_t const *match, bool history,
+                               cdtime_t start, cdtime_t end,
                                std::queue<value_list_t> *value_lists) {
     uc_iter_t *iter;
     if ((iter = uc_get_iterator()) == NULL) {
@@ -454,17 +589,21 @@ private:
           grpc::string("failed to query values: cannot create iterator"));
     }
 
+    IdentMatcher matcher(match);
     grpc::Status status = grpc::Status::OK;
     char *name = NULL;
     while (uc_iterator_next(iter, &name) == 0) {
-      value_list_t vl;
+      if (!matcher.NameMayMatch(name))
+        continue;
+
+      value_list_t vl = {0};
       if (parse_identifier_vl(name, &vl) != 0) {
         status = grpc::Status(grpc::StatusCode::INTERNAL,
                               grpc::string("failed to parse identifier"));
         break;
       }
 
-      if (!ident_matches(&vl, match))
+      if (!matcher.Matches(&vl))
         continue;
       if (uc_iterator_get_time(iter, &vl.time) < 0) {
         status =
@@ -478,6 +617,12 @@ private:
                          grpc::string("failed to retrieve value interval"));
         break;
       }
+      if (history) {
+        status = this->queryHistoryRead(name, &vl, start, end, value_lists);
+        if (!status.ok() || matcher.Exact())
+          break;
+        continue;
+      }
       if (uc_iterator_get_values(iter, &vl.values, &vl.values_len) < 0) {
         status = grpc::Status(grpc::StatusCode::INTERNAL,
                               grpc::string("failed to retrieve values"));
@@ -487,9 +632,13 @@ private:
         status =
             grpc::Status(grpc::StatusCode::INTERNAL,
                          grpc::string("failed to retrieve value metadata"));
+        sfree(vl.values);
+        break;
       }
 
       value_lists->push(vl);
+      if (matcher.Exact())
+        break;
     } // while (uc_iterator_next(iter, &name) == 0)
 
     uc_iterator_destroy(iter);
@@ -498,13 +647,14 @@ private:
 
   grpc::Status queryValuesWrite(grpc::ServerContext *ctx,
                                 grpc::ServerWriter<QueryValuesResponse> *writer,
-                                std::queue<value_list_t> *value_lists) {
+                                std::queue<value_list_t> *value_lists,
+                                bool rates) {
     while (!value_lists->empty()) {
       auto vl = value_lists->front();
       QueryValuesResponse res;
       res.Clear();
 
-      auto status = marshal_value_list(&vl, res.mutable_value_list());
+      auto status = marshal_value_list(&vl, res.mutable_value_list(), rates);
       if (!status.ok()) {
         return status;
       }
@@ -515,6 +665,7 @@ private:
 
       value_lists->pop();
       sfree(vl.values);
+      meta_data_destroy(vl.meta);
     }
 
     return grpc::Status::OK;
@@ -550,6 +701,16 @@ public:
       }
     }
 
+    /* The synchronous server handles calls on a pool of threads polling its
+     * completion queues; size the pool so that several streams are served
+     * concurrently. */
+    if (worker_threads > 0) {
+      builder.SetSyncServerOption(
+          grpc::ServerBuilder::SyncServerOption::MIN_POLLERS, worker_threads);
+      builder.SetSyncServerOption(
+          grpc::ServerBuilder::SyncServerOption::MAX_POLLERS, worker_threads);
+    }
+
     builder.RegisterService(&collectd_service_);
 
     server_ = builder.BuildAndStart();
@@ -565,19 +726,67 @@ private:
 
 class CollectdClient final {
 public:
-  CollectdClient(std::shared_ptr<grpc::ChannelInterface> channel)
-      : stub_(Collectd::NewStub(channel)) {}
+  CollectdClient(std::shared_ptr<grpc::ChannelInterface> channel,
+                 int batch_size)
+      : stub_(Collectd::NewStub(channel)), batch_size_(batch_size),
+        batch_init_(0) {}
 
   int PutValues(value_list_t const *vl) {
-    grpc::ClientContext ctx;
+    if (batch_size_ <= 1) {
+      PutValuesRequest req;
+      auto status = marshal_value_list(vl, req.mutable_value_list());
+      if (!status.ok()) {
+        ERROR("grpc: Marshalling value_list_t failed.");
+        return -1;
+      }
+      return Send(req);
+    }
 
     PutValuesRequest req;
-    auto status = marshal_value_list(vl, req.mutable_value_list());
-    if (!status.ok()) {
-      ERROR("grpc: Marshalling value_list_t failed.");
-      return -1;
+    {
+      std::lock_guard<std::mutex> lock(batch_lock_);
+      auto status = marshal_value_list(vl, batch_.add_value_lists());
+      if (!status.ok()) {
+        batch_.mutable_value_lists()->RemoveLast();
+        ERROR("grpc: Marshalling value_list_t failed.");
+        return -1;
+      }
+
+      cdtime_t now = cdtime();
+      if (batch_.value_lists_size() == 1)
+        batch_init_ = now;
+
+      /* A batch is sent when it is full or older than the interval. */
+      if ((batch_.value_lists_size() < batch_size_) &&
+          ((now - batch_init_) < plugin_get_interval()))
+        return 0;
+
+      req.Swap(&batch_);
+    }
+
+    return Send(req);
+  } /* int PutValues */
+
+  int Flush(cdtime_t timeout) {
+    PutValuesRequest req;
+    {
+      std::lock_guard<std::mutex> lock(batch_lock_);
+      if (batch_.value_lists_size() == 0)
+        return 0;
+      /* timeout == 0  => flush unconditionally */
+      if ((timeout != 0) && ((batch_init_ + timeout) > cdtime()))
+        return 0;
+
+      req.Swap(&batch_);
     }
 
+    return Send(req);
+  } /* int Flush */
+
+private:
+  int Send(PutValuesRequest const &req) {
+    grpc::ClientContext ctx;
+
     PutValuesResponse res;
     auto stream = stub_->PutValues(&ctx, &res);
     if (!stream->Write(req)) {
@@ -586,17 +795,23 @@ public:
     }
 
     stream->WritesDone();
-    status = stream->Finish();
+    auto status = stream->Finish();
     if (!status.ok()) {
       ERROR("grpc: Error while closing stream.");
       return -1;
     }
 
     return 0;
-  } /* int PutValues */
+  } /* int Send */
 
-private:
   std::unique_ptr<Collectd::Stub> stub_;
+
+  /* The batch is sent in a single message using
+   * PutValuesRequest.value_lists. */
+  int batch_size_;
+  std::mutex batch_lock_;
+  PutValuesRequest batch_;
+  cdtime_t batch_init_;
 };
 
 static CollectdServer *server = nullptr;
@@ -615,6 +830,13 @@ static int c_grpc_write(__attribute__((unused)) data_set_t const *ds,
   return c->PutValues(vl);
 }
 
+static int c_grpc_flush(cdtime_t timeout,
+                        __attribute__((unused)) char const *identifier,
+                        user_data_t *ud) {
+  CollectdClient *c = (CollectdClient *)ud->data;
+  return c->Flush(timeout);
+}
+
 static int c_grpc_config_listen(oconfig_item_t *ci) {
   if ((ci->values_num != 2) || (ci->values[0].type != OCONFIG_TYPE_STRING) ||
       (ci->values[1].type != OCONFIG_TYPE_STRING)) {
@@ -698,6 +920,7 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
 
   grpc::SslCredentialsOptions ssl_opts;
   bool use_ssl = false;
+  int batch_size = 1;
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -724,6 +947,11 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
         return -1;
       }
       ssl_opts.pem_cert_chain = read_file(cert);
+    } else if (!strcasecmp("BatchSize", child->key)) {
+      if (cf_util_get_int(child, &batch_size) || (batch_size < 1)) {
+        ERROR("grpc: Option `%s` expects a positive integer", child->key);
+        return -1;
+      }
     } else {
       WARNING("grpc: Option `%s` not allowed in <%s> block.", child->key,
               ci->key);
@@ -738,11 +966,11 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
   if (use_ssl) {
     auto channel_creds = grpc::SslCredentials(ssl_opts);
     auto channel = grpc::CreateChannel(addr, channel_creds);
-    client = new CollectdClient(channel);
+    client = new CollectdClient(channel, batch_size);
   } else {
     auto channel =
         grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
-    client = new CollectdClient(channel);
+    client = new CollectdClient(channel, batch_size);
   }
 
   auto callback_name = grpc::string("grpc/") + addr;
@@ -750,7 +978,13 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
       .data = client, .free_func = c_grpc_destroy_write_callback,
   };
 
-  plugin_register_write(callback_name.c_str(), c_grpc_write, &ud);
+  if (plugin_register_write(callback_name.c_str(), c_grpc_write, &ud) == 0 &&
+      batch_size > 1) {
+    user_data_t flush_ud = {
+        .data = client,
+    };
+    plugin_register_flush(callback_name.c_str(), c_grpc_flush, &flush_ud);
+  }
   return 0;
 } /* c_grpc_config_server() */
 
@@ -766,6 +1000,11 @@ static int c_grpc_config(oconfig_item_t *ci) {
     } else if (!strcasecmp("Server", child->key)) {
       if (c_grpc_config_server(child))
         return -1;
+    } else if (!strcasecmp("WorkerThreads", child->key)) {
+      if (cf_util_get_int(child, &worker_threads) || (worker_threads < 1)) {
+        ERROR("grpc: Option `%s` expects a positive integer", child->key);
+        return -1;
+      }
     }
 
     else {
@@ -74,7 +74,12 @@ struct intel_pmu_ctx_s {
   char **hw_events;
   size_t hw_events_count;
   core_groups_list_t cores;
+  size_t group_size;
   struct eventlist *event_list;
+  /* Buffer for reading a whole group of events with PERF_FORMAT_GROUP:
+   * {nr, time_enabled, time_running, values[nr]}. */
+  uint64_t *group_buffer;
+  size_t group_buffer_num;
 };
 typedef struct intel_pmu_ctx_s intel_pmu_ctx_t;
 
@@ -312,6 +317,14 @@ static int pmu_config(oconfig_item_t *ci) {
       ret = cf_util_get_boolean(child, &g_ctx.sw_events);
     } else if (strcasecmp("Cores", child->key) == 0) {
       ret = config_cores_parse(child, &g_ctx.cores);
+    } else if (strcasecmp("GroupSize", child->key) == 0) {
+      int tmp = 0;
+      ret = cf_util_get_int(child, &tmp);
+      if ((ret == 0) && (tmp < 0)) {
+        ERROR(PMU_PLUGIN ": GroupSize must not be negative.");
+        ret = -1;
+      }
+      g_ctx.group_size = (size_t)tmp;
     } else {
       ERROR(PMU_PLUGIN ": Unknown configuration parameter \"%s\".", child->key);
       ret = -1;
@@ -409,27 +422,68 @@ static void pmu_dispatch_data(void) {
   }
 }
 
+/* Reads the group led by "leader" on "core" with a single read(2) and
+ * stores the values in the efd structs of the leader and its members, in the
+ * layout read_event() uses. */
+static int pmu_read_group(struct event *leader, int core) {
+  size_t size = g_ctx.group_buffer_num * sizeof(*g_ctx.group_buffer);
+  ssize_t n = read(leader->efd[core].fd, g_ctx.group_buffer, size);
+  if (n < (ssize_t)(3 * sizeof(*g_ctx.group_buffer)))
+    return -1;
+
+  uint64_t nr = g_ctx.group_buffer[0];
+  if ((nr > g_ctx.group_buffer_num - 3) ||
+      ((size_t)n < (3 + nr) * sizeof(*g_ctx.group_buffer)))
+    return -1;
+
+  /* Members that could not be opened are not part of the group. */
+  uint64_t k = 0;
+  for (struct event *e = leader; e && (k < nr); e = e->next) {
+    if (e->efd[core].fd >= 0) {
+      e->efd[core].val[0] = g_ctx.group_buffer[3 + k];
+      e->efd[core].val[1] = g_ctx.group_buffer[1];
+      e->efd[core].val[2] = g_ctx.group_buffer[2];
+      k++;
+    }
+    if (e->end_group)
+      break;
+  }
+
+  return 0;
+}
+
 static int pmu_read(__attribute__((unused)) user_data_t *ud) {
   int ret;
-  struct event *e;
 
   DEBUG(PMU_PLUGIN ": %s:%d", __FUNCTION__, __LINE__);
 
-  /* read all events only for configured cores */
-  for (e = g_ctx.event_list->eventlist; e; e = e->next) {
-    for (size_t i = 0; i < g_ctx.cores.num_cgroups; i++) {
-      core_group_t *cgroup = g_ctx.cores.cgroups + i;
-      for (size_t j = 0; j < cgroup->num_cores; j++) {
-        int core = (int)cgroup->cores[j];
-        if (e->efd[core].fd < 0)
-          continue;
+  /* read all events only for configured cores, one core after the other, and
+   * each group of events with a single read */
+  for (size_t i = 0; i < g_ctx.cores.num_cgroups; i++) {
+    core_group_t *cgroup = g_ctx.cores.cgroups + i;
+    for (size_t j = 0; j < cgroup->num_cores; j++) {
+      int core = (int)cgroup->cores[j];
+      struct event *leader = NULL;
+
+      for (struct event *e = g_ctx.event_list->eventlist; e; e = e->next) {
+        if (e->group_leader && (e->efd[core].fd >= 0) &&
+            (e->attr.read_format & PERF_FORMAT_GROUP)) {
+          leader = e;
+          ret = pmu_read_group(e, core);
+        } else if ((leader != NULL) || (e->efd[core].fd < 0)) {
+          ret = 0; /* read with the group leader or not available */
+        } else {
+          ret = read_event(e, core);
+        }
 
-        ret = read_event(e, core);
         if (ret != 0) {
           ERROR(PMU_PLUGIN ": Failed to read value of %s/%d event.", e->event,
                 core);
           return ret;
         }
+
+        if (e->end_group)
+          leader = NULL;
       }
     }
   }
@@ -441,6 +495,11 @@ static int pmu_read(__attribute__((unused)) user_data_t *ud) {
 
 static int pmu_add_events(struct eventlist *el, uint32_t type,
                           event_info_t *events, size_t count) {
+  /* Software events are not multiplexed, and some of them do not count as
+   * members of a group. */
+  size_t group_size = ((type != PERF_TYPE_SOFTWARE) && (g_ctx.group_size > 1))
+                          ? g_ctx.group_size
+                          : 1;
 
   for (size_t i = 0; i < count; i++) {
     /* Allocate memory for event struct that contains array of efd structs
@@ -461,6 +520,16 @@ static int pmu_add_events(struct eventlist *el, uint32_t type,
       el->eventlist_last->next = e;
     el->eventlist_last = e;
     e->event = strdup(events[i].name);
+
+    /* Put every "GroupSize" consecutive events in a group, so that they are
+     * scheduled, and read, together. */
+    size_t pos = i % group_size;
+    if (group_size < 2)
+      continue;
+    if ((pos == 0) && (i + 1 < count))
+      e->group_leader = 1;
+    else if ((pos > 0) && ((pos == group_size - 1) || (i + 1 == count)))
+      e->end_group = 1;
   }
 
   return 0;
@@ -543,9 +612,13 @@ static void pmu_free_events(struct eventlist *el) {
 static int pmu_setup_events(struct eventlist *el, bool measure_all,
                             int measure_pid) {
   struct event *e, *leader = NULL;
+  size_t group_num = 0, max_group_num = 0;
   int ret = -1;
 
   for (e = el->eventlist; e; e = e->next) {
+    /* The leader reads the values of all members of the group at once. */
+    if (e->group_leader)
+      e->attr.read_format |= PERF_FORMAT_GROUP;
 
     for (size_t i = 0; i < g_ctx.cores.num_cgroups; i++) {
       core_group_t *cgroup = g_ctx.cores.cgroups + i;
@@ -562,10 +635,25 @@ static int pmu_setup_events(struct eventlist *el, bool measure_all,
       }
     }
 
-    if (e->group_leader)
+    if (e->group_leader) {
       leader = e;
-    if (e->end_group)
+      group_num = 0;
+    }
+    group_num++;
+    if (group_num > max_group_num)
+      max_group_num = group_num;
+    if (e->end_group) {
       leader = NULL;
+      group_num = 0;
+    }
+  }
+
+  g_ctx.group_buffer_num = 3 + max_group_num;
+  g_ctx.group_buffer =
+      calloc(g_ctx.group_buffer_num, sizeof(*g_ctx.group_buffer));
+  if (g_ctx.group_buffer == NULL) {
+    ERROR(PMU_PLUGIN ": Failed to allocate group read buffer.");
+    return -ENOMEM;
   }
 
   return ret;
@@ -669,6 +757,7 @@ init_error:
 
   pmu_free_events(g_ctx.event_list);
   sfree(g_ctx.event_list);
+  sfree(g_ctx.group_buffer);
   for (size_t i = 0; i < g_ctx.hw_events_count; i++) {
     sfree(g_ctx.hw_events[i]);
   }
@@ -686,6 +775,7 @@ static int pmu_shutdown(void) {
 
   pmu_free_events(g_ctx.event_list);
   sfree(g_ctx.event_list);
+  sfree(g_ctx.group_buffer);
   for (size_t i = 0; i < g_ctx.hw_events_count; i++) {
     sfree(g_ctx.hw_events[i]);
   }
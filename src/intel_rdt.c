@@ -28,7 +28,12 @@
 #include "collectd.h"
 #include "utils/common/common.h"
 #include "utils/config_cores/config_cores.h"
+#include "utils/resctrl/resctrl.h"
 
+#include <dirent.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
 #include <pqos.h>
 
 #define RDT_PLUGIN "intel_rdt"
@@ -37,11 +42,38 @@
 #define RDT_MAX_SOCKET_CORES 64
 #define RDT_MAX_CORES (RDT_MAX_SOCKET_CORES * RDT_MAX_SOCKETS)
 
+#define RDT_RESCTRL_PATH "/sys/fs/resctrl"
+/* Monitoring groups of the "Processes" option are called "collectd-<n>". */
+#define RDT_RESCTRL_GROUP_PREFIX "collectd-"
+/* Process events arrive in bursts, e.g. when a build starts many compilers. */
+#define RDT_PROC_RCVBUF (4 * 1024 * 1024)
+
 typedef enum {
   UNKNOWN = 0,
   CONFIGURATION_ERROR,
 } rdt_config_status;
 
+/* A group of processes, identified by their names, that is monitored through
+ * a monitoring group of the resctrl file system. */
+struct rdt_proc_group_s {
+  char *desc;
+  /* The names point into buffer, a copy of desc split at the commas. */
+  char *buffer;
+  char **names;
+  size_t names_num;
+  resctrl_group_t *group;
+};
+typedef struct rdt_proc_group_s rdt_proc_group_t;
+
+/* Where a task is, as far as the "Processes" groups are concerned. */
+typedef enum {
+  RDT_TASK_DEFAULT = 0,
+  RDT_TASK_OWN_GROUP,
+  /* The task is in a resource control group other than the default one; it
+   * is never moved, so its allocation does not change. */
+  RDT_TASK_OTHER_GROUP,
+} rdt_task_state_t;
+
 struct rdt_ctx_s {
   core_groups_list_t cores;
   enum pqos_mon_event events[RDT_MAX_CORES];
@@ -50,6 +82,16 @@ struct rdt_ctx_s {
   const struct pqos_cpuinfo *pqos_cpu;
   const struct pqos_cap *pqos_cap;
   const struct pqos_capability *cap_mon;
+
+  char resctrl_path[PATH_MAX];
+  resctrl_group_t *resctrl_default;
+  rdt_proc_group_t *proc_groups;
+  size_t num_proc_groups;
+  /* Proc connector socket, read by proc_thread, that keeps the groups in
+   * sync with processes that are started or renamed. */
+  int proc_fd;
+  pthread_t proc_thread;
+  bool proc_thread_running;
 };
 typedef struct rdt_ctx_s rdt_ctx_t;
 
@@ -244,8 +286,6 @@ static void rdt_pqos_log(void *context, const size_t size, const char *msg) {
 }
 
 static int rdt_preinit(void) {
-  int ret;
-
   if (g_rdt != NULL) {
     /* already initialized if config callback was called before init callback */
     return 0;
@@ -257,6 +297,21 @@ static int rdt_preinit(void) {
     return -ENOMEM;
   }
 
+  sstrncpy(g_rdt->resctrl_path, RDT_RESCTRL_PATH, sizeof(g_rdt->resctrl_path));
+  g_rdt->proc_fd = -1;
+
+  return 0;
+}
+
+/* The PQoS library is only initialized if core groups are monitored: with
+ * its MSR interface, it cannot be used while the resctrl file system is in
+ * use for process groups. */
+static int rdt_pqos_init(void) {
+  int ret;
+
+  if (g_rdt->pqos_cpu != NULL)
+    return 0;
+
   struct pqos_config pqos = {.fd_log = -1,
                              .callback_log = rdt_pqos_log,
                              .context_log = NULL,
@@ -296,12 +351,97 @@ rdt_preinit_error2:
   pqos_fini();
 
 rdt_preinit_error1:
+  g_rdt->pqos_cap = NULL;
+  g_rdt->pqos_cpu = NULL;
+  g_rdt->cap_mon = NULL;
 
-  sfree(g_rdt);
+  return -1;
+}
 
+/* Returns the index of the process group "comm" belongs to, or -1. */
+static int rdt_proc_match(char const *comm) {
+  for (size_t i = 0; i < g_rdt->num_proc_groups; i++) {
+    rdt_proc_group_t *pg = g_rdt->proc_groups + i;
+    for (size_t j = 0; j < pg->names_num; j++)
+      if (strcmp(comm, pg->names[j]) == 0)
+        return (int)i;
+  }
   return -1;
 }
 
+static int rdt_config_processes(oconfig_item_t *ci) {
+  if (ci->values_num < 1) {
+    ERROR(RDT_PLUGIN ": The \"%s\" option requires at least one argument.",
+          ci->key);
+    return -EINVAL;
+  }
+
+  for (int i = 0; i < ci->values_num; i++) {
+    if (ci->values[i].type != OCONFIG_TYPE_STRING) {
+      ERROR(RDT_PLUGIN ": The \"%s\" option requires string arguments.",
+            ci->key);
+      return -EINVAL;
+    }
+  }
+
+  rdt_proc_group_t *tmp =
+      realloc(g_rdt->proc_groups, (g_rdt->num_proc_groups + ci->values_num) *
+                                      sizeof(*g_rdt->proc_groups));
+  if (tmp == NULL) {
+    ERROR(RDT_PLUGIN ": Failed to allocate process groups.");
+    return -ENOMEM;
+  }
+  g_rdt->proc_groups = tmp;
+
+  for (int i = 0; i < ci->values_num; i++) {
+    rdt_proc_group_t *pg = g_rdt->proc_groups + g_rdt->num_proc_groups;
+    char *desc = ci->values[i].value.string;
+
+    memset(pg, 0, sizeof(*pg));
+    pg->desc = strdup(desc);
+    pg->names = calloc(strlen(desc) / 2 + 1, sizeof(*pg->names));
+    if ((pg->desc == NULL) || (pg->names == NULL)) {
+      sfree(pg->desc);
+      sfree(pg->names);
+      ERROR(RDT_PLUGIN ": Failed to allocate process group.");
+      return -ENOMEM;
+    }
+    g_rdt->num_proc_groups++;
+
+    pg->buffer = strdup(desc);
+    if (pg->buffer == NULL) {
+      ERROR(RDT_PLUGIN ": Failed to allocate process group.");
+      return -ENOMEM;
+    }
+
+    char *saveptr = NULL;
+    for (char *name = strtok_r(pg->buffer, ",", &saveptr); name != NULL;
+         name = strtok_r(NULL, ",", &saveptr)) {
+      /* The kernel truncates process names to 15 characters. */
+      if (strlen(name) > 15) {
+        WARNING(RDT_PLUGIN ": Process name \"%s\" is longer than 15 "
+                           "characters and will be truncated.",
+                name);
+        name[15] = 0;
+      }
+      if (rdt_proc_match(name) >= 0) {
+        ERROR(RDT_PLUGIN ": Process \"%s\" is in more than one group.", name);
+        return -EINVAL;
+      }
+      pg->names[pg->names_num] = name;
+      pg->names_num++;
+    }
+
+    if (pg->names_num == 0) {
+      ERROR(RDT_PLUGIN ": Process group \"%s\" has no process names.",
+            pg->desc);
+      return -EINVAL;
+    }
+  }
+
+  return 0;
+}
+
 static int rdt_config(oconfig_item_t *ci) {
   if (rdt_preinit() != 0) {
     g_state = CONFIGURATION_ERROR;
@@ -316,7 +456,7 @@ static int rdt_config(oconfig_item_t *ci) {
     oconfig_item_t *child = ci->children + i;
 
     if (strcasecmp("Cores", child->key) == 0) {
-      if (rdt_config_cgroups(child) != 0) {
+      if ((rdt_pqos_init() != 0) || (rdt_config_cgroups(child) != 0)) {
         g_state = CONFIGURATION_ERROR;
         /* if we return -1 at this point collectd
            reports a failure in configuration and
@@ -328,6 +468,17 @@ static int rdt_config(oconfig_item_t *ci) {
 #if COLLECT_DEBUG
       rdt_dump_cgroups();
 #endif /* COLLECT_DEBUG */
+    } else if (strcasecmp("Processes", child->key) == 0) {
+      if (rdt_config_processes(child) != 0) {
+        g_state = CONFIGURATION_ERROR;
+        return (0);
+      }
+    } else if (strcasecmp("ResctrlPath", child->key) == 0) {
+      if (cf_util_get_string_buffer(child, g_rdt->resctrl_path,
+                                    sizeof(g_rdt->resctrl_path)) != 0) {
+        g_state = CONFIGURATION_ERROR;
+        return (0);
+      }
     } else {
       ERROR(RDT_PLUGIN ": Unknown configuration parameter \"%s\".", child->key);
     }
@@ -368,6 +519,303 @@ static void rdt_submit_gauge(const char *cgroup, const char *type,
   plugin_dispatch_values(&vl);
 }
 
+/* Reads a small file below /proc into buffer, without the trailing newline. */
+static int rdt_proc_read_file(char const *path, char *buffer, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  ssize_t len = read(fd, buffer, size - 1);
+  close(fd);
+  if (len < 0)
+    return -1;
+
+  buffer[len] = 0;
+  if ((len > 0) && (buffer[len - 1] == '\n'))
+    buffer[len - 1] = 0;
+  return 0;
+}
+
+/* Uses /proc/<pid>/task/<tid>/cpu_resctrl_groups, which contains e.g.
+ * "res:/\nmon:/mon_groups/collectd-0", to find out which groups a task is in.
+ * Without that file, i.e. before Linux 5.10, tasks are assumed to be in the
+ * default groups. */
+static rdt_task_state_t rdt_proc_task_state(pid_t pid, pid_t tid) {
+  char path[64];
+  char buffer[512];
+
+  if (tid == 0)
+    snprintf(path, sizeof(path), "/proc/%d/cpu_resctrl_groups", (int)pid);
+  else
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/cpu_resctrl_groups",
+             (int)pid, (int)tid);
+  if (rdt_proc_read_file(path, buffer, sizeof(buffer)) != 0)
+    return RDT_TASK_DEFAULT;
+
+  if (strncmp("res:/\n", buffer, strlen("res:/\n")) != 0)
+    return RDT_TASK_OTHER_GROUP;
+  if (strstr(buffer, "mon:/mon_groups/" RDT_RESCTRL_GROUP_PREFIX) != NULL)
+    return RDT_TASK_OWN_GROUP;
+  return RDT_TASK_DEFAULT;
+}
+
+/* Moves all threads of process "pid" to the group its name belongs to, or
+ * back to the default group if it has been in one of the process groups and
+ * its name does not match any more. */
+static void rdt_proc_assign(pid_t pid) {
+  char path[64];
+  char comm[32];
+
+  snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+  if (rdt_proc_read_file(path, comm, sizeof(comm)) != 0)
+    return; /* exited already */
+
+  int idx = rdt_proc_match(comm);
+  if ((idx < 0) && (rdt_proc_task_state(pid, 0) != RDT_TASK_OWN_GROUP))
+    return;
+
+  resctrl_group_t *group = (idx < 0) ? g_rdt->resctrl_default
+                                     : g_rdt->proc_groups[idx].group;
+
+  snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+  DIR *dh = opendir(path);
+  if (dh == NULL)
+    return;
+
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    if (!isdigit((unsigned char)de->d_name[0]))
+      continue;
+
+    pid_t tid = (pid_t)atoi(de->d_name);
+    rdt_task_state_t state = rdt_proc_task_state(pid, tid);
+    if ((state == RDT_TASK_OTHER_GROUP) ||
+        ((idx < 0) && (state != RDT_TASK_OWN_GROUP)))
+      continue;
+
+    int status = resctrl_group_add_task(group, tid);
+    if ((status != 0) && (status != ESRCH))
+      WARNING(RDT_PLUGIN ": Moving task %d of process \"%s\" failed: %s",
+              (int)tid, comm, STRERROR(status));
+  }
+  closedir(dh);
+}
+
+/* Assigns all running processes to the groups. Only done at start-up and if
+ * process events have been lost. */
+static void rdt_proc_scan(void) {
+  DIR *dh = opendir("/proc");
+  if (dh == NULL) {
+    ERROR(RDT_PLUGIN ": Cannot open /proc: %s", STRERRNO);
+    return;
+  }
+
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    if (!isdigit((unsigned char)de->d_name[0]))
+      continue;
+
+    pid_t pid = (pid_t)atoi(de->d_name);
+    char path[64];
+    char comm[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+    if ((rdt_proc_read_file(path, comm, sizeof(comm)) == 0) &&
+        (rdt_proc_match(comm) >= 0))
+      rdt_proc_assign(pid);
+  }
+  closedir(dh);
+}
+
+/* Subscribes to the process events of the proc connector. Requires
+ * CAP_NET_ADMIN. */
+static int rdt_proc_connect(void) {
+  int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+  if (fd < 0) {
+    ERROR(RDT_PLUGIN ": Creating the proc connector socket failed: %s",
+          STRERRNO);
+    return -1;
+  }
+
+  int rcvbuf = RDT_PROC_RCVBUF;
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0)
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_nl sa = {
+      .nl_family = AF_NETLINK,
+      .nl_groups = CN_IDX_PROC,
+  };
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    ERROR(RDT_PLUGIN ": Binding the proc connector socket failed: %s",
+          STRERRNO);
+    close(fd);
+    return -1;
+  }
+
+  union {
+    struct nlmsghdr nlh;
+    char buffer[NLMSG_SPACE(sizeof(struct cn_msg) +
+                            sizeof(enum proc_cn_mcast_op))];
+  } req;
+  memset(&req, 0, sizeof(req));
+
+  struct cn_msg *cn = NLMSG_DATA(&req.nlh);
+  enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+
+  req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(*cn) + sizeof(op));
+  req.nlh.nlmsg_type = NLMSG_DONE;
+  cn->id.idx = CN_IDX_PROC;
+  cn->id.val = CN_VAL_PROC;
+  cn->len = sizeof(op);
+  memcpy(cn->data, &op, sizeof(op));
+
+  if (send(fd, &req, req.nlh.nlmsg_len, 0) < 0) {
+    ERROR(RDT_PLUGIN ": Subscribing to process events failed: %s", STRERRNO);
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static void *rdt_proc_thread(__attribute__((unused)) void *arg) {
+  union {
+    struct nlmsghdr nlh;
+    char buffer[8192];
+  } msg;
+
+  /* The thread is cancelled on shutdown, but only while it is waiting for
+   * events, so that it never holds a lock, e.g. in the logging code. */
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+  while (42) {
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    int len = (int)recv(g_rdt->proc_fd, &msg, sizeof(msg), 0);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == ENOBUFS) {
+        /* Events have been lost: assign all processes again. */
+        WARNING(RDT_PLUGIN ": Process events have been lost, rescanning.");
+        rdt_proc_scan();
+        continue;
+      }
+      ERROR(RDT_PLUGIN ": Receiving process events failed: %s", STRERRNO);
+      break;
+    }
+
+    for (struct nlmsghdr *nlh = &msg.nlh; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+      if ((nlh->nlmsg_type == NLMSG_NOOP) || (nlh->nlmsg_type == NLMSG_ERROR))
+        continue;
+
+      struct cn_msg *cn = NLMSG_DATA(nlh);
+      if ((cn->id.idx != CN_IDX_PROC) || (cn->id.val != CN_VAL_PROC))
+        continue;
+
+      /* New threads and processes inherit the group of their creator, so
+       * only new programs and new names have to be looked at. */
+      struct proc_event *ev = (struct proc_event *)cn->data;
+      if (ev->what == PROC_EVENT_EXEC)
+        rdt_proc_assign(ev->event_data.exec.process_tgid);
+      else if ((ev->what == PROC_EVENT_COMM) &&
+               (ev->event_data.comm.process_pid ==
+                ev->event_data.comm.process_tgid))
+        rdt_proc_assign(ev->event_data.comm.process_tgid);
+    }
+  }
+
+  return NULL;
+}
+
+static int rdt_proc_init(void) {
+  g_rdt->resctrl_default = resctrl_group_open(g_rdt->resctrl_path, NULL);
+  if (g_rdt->resctrl_default == NULL) {
+    ERROR(RDT_PLUGIN ": Opening the resctrl file system at \"%s\" failed: %s",
+          g_rdt->resctrl_path, STRERRNO);
+    return -1;
+  }
+
+  for (size_t i = 0; i < g_rdt->num_proc_groups; i++) {
+    rdt_proc_group_t *pg = g_rdt->proc_groups + i;
+    char name[DATA_MAX_NAME_LEN];
+
+    snprintf(name, sizeof(name), RDT_RESCTRL_GROUP_PREFIX "%" PRIsz, i);
+    pg->group = resctrl_group_open(g_rdt->resctrl_path, name);
+    if (pg->group == NULL) {
+      ERROR(RDT_PLUGIN ": Creating the monitoring group for \"%s\" failed: %s",
+            pg->desc, STRERRNO);
+      return -1;
+    }
+  }
+
+  /* Subscribe before scanning, so that no process is missed. */
+  g_rdt->proc_fd = rdt_proc_connect();
+  if (g_rdt->proc_fd < 0)
+    return -1;
+
+  rdt_proc_scan();
+
+  int status = plugin_thread_create(&g_rdt->proc_thread, NULL,
+                                    rdt_proc_thread, NULL, "intel_rdt proc");
+  if (status != 0) {
+    ERROR(RDT_PLUGIN ": Starting the process events thread failed.");
+    return -1;
+  }
+  g_rdt->proc_thread_running = true;
+
+  return 0;
+}
+
+static void rdt_proc_shutdown(void) {
+  if (g_rdt->proc_thread_running) {
+    pthread_cancel(g_rdt->proc_thread);
+    pthread_join(g_rdt->proc_thread, NULL);
+    g_rdt->proc_thread_running = false;
+  }
+  if (g_rdt->proc_fd >= 0) {
+    close(g_rdt->proc_fd);
+    g_rdt->proc_fd = -1;
+  }
+
+  /* The kernel moves the tasks of a removed group back to the default one. */
+  for (size_t i = 0; i < g_rdt->num_proc_groups; i++) {
+    rdt_proc_group_t *pg = g_rdt->proc_groups + i;
+    resctrl_group_close(pg->group, /* remove = */ 1);
+    sfree(pg->desc);
+    sfree(pg->buffer);
+    sfree(pg->names);
+  }
+  sfree(g_rdt->proc_groups);
+  g_rdt->num_proc_groups = 0;
+
+  resctrl_group_close(g_rdt->resctrl_default, /* remove = */ 0);
+  g_rdt->resctrl_default = NULL;
+}
+
+static void rdt_proc_read(void) {
+  for (size_t i = 0; i < g_rdt->num_proc_groups; i++) {
+    rdt_proc_group_t *pg = g_rdt->proc_groups + i;
+    resctrl_values_t v;
+
+    if ((pg->group == NULL) || (resctrl_group_read(pg->group, &v) != 0))
+      continue;
+
+    if (v.valid & RESCTRL_LLC_OCCUPANCY)
+      rdt_submit_gauge(pg->desc, "bytes", "llc", (gauge_t)v.llc_occupancy);
+
+    /* The counters are cumulative, so the rates are in bytes per second. */
+    if (v.valid & RESCTRL_MBM_LOCAL_BYTES)
+      rdt_submit_derive(pg->desc, "memory_bandwidth", "local",
+                        (derive_t)v.mbm_local_bytes);
+    if ((v.valid & RESCTRL_MBM_LOCAL_BYTES) &&
+        (v.valid & RESCTRL_MBM_TOTAL_BYTES) &&
+        (v.mbm_total_bytes >= v.mbm_local_bytes))
+      rdt_submit_derive(pg->desc, "memory_bandwidth", "remote",
+                        (derive_t)(v.mbm_total_bytes - v.mbm_local_bytes));
+  }
+}
+
 static int rdt_read(__attribute__((unused)) user_data_t *ud) {
   int ret;
 
@@ -376,6 +824,10 @@ static int rdt_read(__attribute__((unused)) user_data_t *ud) {
     return -EINVAL;
   }
 
+  rdt_proc_read();
+  if (g_rdt->num_groups == 0)
+    return 0;
+
   ret = pqos_mon_poll(&g_rdt->pgroups[0], (unsigned)g_rdt->num_groups);
   if (ret != PQOS_RETVAL_OK) {
     ERROR(RDT_PLUGIN ": Failed to poll monitoring data.");
@@ -424,6 +876,19 @@ static int rdt_init(void) {
   if (ret != 0)
     return ret;
 
+  if (g_rdt->num_proc_groups > 0) {
+    ret = rdt_proc_init();
+    if (ret != 0) {
+      rdt_proc_shutdown();
+      if (g_rdt->num_groups == 0)
+        return ret;
+    }
+  } else {
+    ret = rdt_pqos_init();
+    if (ret != 0)
+      return ret;
+  }
+
   /* Start monitoring */
   for (size_t i = 0; i < g_rdt->num_groups; i++) {
     core_group_t *cg = g_rdt->cores.cgroups + i;
@@ -447,14 +912,18 @@ static int rdt_shutdown(void) {
   if (g_rdt == NULL)
     return 0;
 
+  rdt_proc_shutdown();
+
   /* Stop monitoring */
   for (size_t i = 0; i < g_rdt->num_groups; i++) {
     pqos_mon_stop(g_rdt->pgroups[i]);
   }
 
-  ret = pqos_fini();
-  if (ret != PQOS_RETVAL_OK)
-    ERROR(RDT_PLUGIN ": Error shutting down PQoS library.");
+  if (g_rdt->pqos_cpu != NULL) {
+    ret = pqos_fini();
+    if (ret != PQOS_RETVAL_OK)
+      ERROR(RDT_PLUGIN ": Error shutting down PQoS library.");
+  }
 
   rdt_free_cgroups();
   sfree(g_rdt);
@@ -73,6 +73,43 @@ static int nif;
 static int pnif;
 #endif /* HAVE_PERFSTAT */
 
+#if !HAVE_GETIFADDRS && KERNEL_LINUX
+#include "utils/avltree/avltree.h"
+#include "utils/procfs/procfs.h"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+/* Large enough for one message of a dump: the kernel fills at most
+ * max(NLMSG_GOODSIZE, 32k) bytes per recv. */
+#define IF_NETLINK_BUFFER_SIZE 32768
+
+typedef struct {
+  int ifindex;
+  char name[DATA_MAX_NAME_LEN];
+  bool ignored;
+  unsigned int generation;
+} if_link_t;
+
+static procfs_file_t *proc_net_dev;
+
+/* The rtnetlink sockets for requests and link notifications, the receive
+ * buffer and the name and ignorelist decision of each interface, indexed by
+ * ifindex. If the socket cannot be created, /proc/net/dev is read instead. */
+static int rtnl_fd = -1;
+static int rtnl_events_fd = -1;
+static char *rtnl_buffer;
+static uint32_t rtnl_seq;
+static bool rtnl_unavailable;
+#ifdef RTM_GETSTATS
+static bool rtnl_have_getstats = true;
+#endif
+static c_avl_tree_t *if_links;
+static unsigned int if_links_generation;
+static bool if_links_changed = true;
+#endif /* !HAVE_GETIFADDRS && KERNEL_LINUX */
+
 #if !HAVE_GETIFADDRS && !KERNEL_LINUX && !HAVE_LIBKSTAT &&                     \
     !HAVE_LIBSTATGRAB && !HAVE_PERFSTAT
 #error "No applicable input method."
@@ -156,16 +193,13 @@ static int interface_init(void) {
 } /* int interface_init */
 #endif /* HAVE_LIBKSTAT */
 
-static void if_submit(const char *dev, const char *type, derive_t rx,
-                      derive_t tx) {
+static void if_dispatch(const char *dev, const char *type, derive_t rx,
+                        derive_t tx) {
   value_list_t vl = VALUE_LIST_INIT;
   value_t values[] = {
       {.derive = rx}, {.derive = tx},
   };
 
-  if (ignorelist_match(ignorelist, dev) != 0)
-    return;
-
   vl.values = values;
   vl.values_len = STATIC_ARRAY_SIZE(values);
   sstrncpy(vl.plugin, "interface", sizeof(vl.plugin));
@@ -173,8 +207,389 @@ static void if_submit(const char *dev, const char *type, derive_t rx,
   sstrncpy(vl.type, type, sizeof(vl.type));
 
   plugin_dispatch_values(&vl);
+} /* void if_dispatch */
+
+static void if_submit(const char *dev, const char *type, derive_t rx,
+                      derive_t tx) {
+  if (ignorelist_match(ignorelist, dev) != 0)
+    return;
+
+  if_dispatch(dev, type, rx, tx);
 } /* void if_submit */
 
+#if !HAVE_GETIFADDRS && KERNEL_LINUX
+static int if_link_compare(void const *a, void const *b) {
+  int ifindex_a = *((int const *)a);
+  int ifindex_b = *((int const *)b);
+
+  if (ifindex_a < ifindex_b)
+    return -1;
+  else if (ifindex_a > ifindex_b)
+    return 1;
+  return 0;
+} /* int if_link_compare */
+
+/* if_link_get returns the cache entry of an interface. The ignorelist is only
+ * consulted for new interfaces and when an interface has been renamed. */
+static if_link_t *if_link_get(int ifindex, char const *name) {
+  if_link_t *link = NULL;
+
+  if (c_avl_get(if_links, &ifindex, (void *)&link) != 0) {
+    link = calloc(1, sizeof(*link));
+    if (link == NULL)
+      return NULL;
+    link->ifindex = ifindex;
+    if (c_avl_insert(if_links, &link->ifindex, link) != 0) {
+      sfree(link);
+      return NULL;
+    }
+  } else if (strcmp(link->name, name) == 0) {
+    link->generation = if_links_generation;
+    return link;
+  }
+
+  sstrncpy(link->name, name, sizeof(link->name));
+  link->ignored = (ignorelist_match(ignorelist, name) != 0);
+  link->generation = if_links_generation;
+  return link;
+} /* if_link_t *if_link_get */
+
+/* if_link_expire removes the interfaces that were not part of the last dump
+ * from the cache. */
+static void if_link_expire(void) {
+  if_link_t **expired = NULL;
+  size_t expired_num = 0;
+  int *ifindex;
+  if_link_t *link;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(if_links);
+  if (iter == NULL)
+    return;
+  while (c_avl_iterator_next(iter, (void *)&ifindex, (void *)&link) == 0) {
+    if (link->generation == if_links_generation)
+      continue;
+
+    if_link_t **tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+    if (tmp == NULL)
+      break;
+    expired = tmp;
+    expired[expired_num] = link;
+    expired_num++;
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < expired_num; i++) {
+    c_avl_remove(if_links, &expired[i]->ifindex, NULL, NULL);
+    sfree(expired[i]);
+  }
+  sfree(expired);
+} /* void if_link_expire */
+
+static void if_netlink_close(void) {
+  if (rtnl_fd >= 0)
+    close(rtnl_fd);
+  rtnl_fd = -1;
+
+  if (rtnl_events_fd >= 0)
+    close(rtnl_events_fd);
+  rtnl_events_fd = -1;
+} /* void if_netlink_close */
+
+static int if_netlink_socket(unsigned int groups, int flags) {
+  struct sockaddr_nl sa = {.nl_family = AF_NETLINK, .nl_groups = groups};
+
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | flags, NETLINK_ROUTE);
+  if (fd < 0)
+    return -1;
+
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    int status = errno;
+    close(fd);
+    errno = status;
+    return -1;
+  }
+
+  return fd;
+} /* int if_netlink_socket */
+
+static int if_netlink_open(void) {
+  if (rtnl_buffer == NULL) {
+    rtnl_buffer = malloc(IF_NETLINK_BUFFER_SIZE);
+    if (rtnl_buffer == NULL)
+      return ENOMEM;
+  }
+
+  if (if_links == NULL) {
+    if_links = c_avl_create(if_link_compare);
+    if (if_links == NULL)
+      return ENOMEM;
+  }
+
+  rtnl_fd = if_netlink_socket(/* groups = */ 0, /* flags = */ 0);
+  if (rtnl_fd < 0)
+    return errno;
+
+  /* Without the notifications, the names are dumped by every read. */
+  rtnl_events_fd = if_netlink_socket(RTMGRP_LINK, SOCK_NONBLOCK);
+  if (rtnl_events_fd < 0)
+    WARNING("interface plugin: Subscribing to link notifications failed: %s",
+            STRERRNO);
+
+  if_links_changed = true;
+  return 0;
+} /* int if_netlink_open */
+
+/* if_netlink_events drains the link notifications. Any notification, and the
+ * loss of notifications, causes the interface names to be dumped again. */
+static void if_netlink_events(void) {
+  if (rtnl_events_fd < 0) {
+    if_links_changed = true;
+    return;
+  }
+
+  while (42) {
+    ssize_t status = recv(rtnl_events_fd, rtnl_buffer, IF_NETLINK_BUFFER_SIZE,
+                          MSG_TRUNC);
+    if (status >= 0) {
+      if_links_changed = true;
+    } else if (errno == ENOBUFS) {
+      if_links_changed = true;
+    } else if (errno != EINTR) {
+      break;
+    }
+  }
+} /* void if_netlink_events */
+
+static void if_netlink_submit(char const *name,
+                              struct rtnl_link_stats64 const *stats) {
+  if (!report_inactive && stats->rx_packets == 0 && stats->tx_packets == 0)
+    return;
+
+  if_dispatch(name, "if_packets", (derive_t)stats->rx_packets,
+              (derive_t)stats->tx_packets);
+  if_dispatch(name, "if_octets", (derive_t)stats->rx_bytes,
+              (derive_t)stats->tx_bytes);
+  if_dispatch(name, "if_errors", (derive_t)stats->rx_errors,
+              (derive_t)stats->tx_errors);
+  /* Same as the "drop" columns of /proc/net/dev. */
+  if_dispatch(name, "if_dropped",
+              (derive_t)(stats->rx_dropped + stats->rx_missed_errors),
+              (derive_t)stats->tx_dropped);
+} /* void if_netlink_submit */
+
+/* if_netlink_parse_link returns the cache entry of the interface described by
+ * an RTM_NEWLINK message and copies its counters to "stats", if the message
+ * has any. */
+static if_link_t *if_netlink_parse_link(struct nlmsghdr *nlh,
+                                        struct rtnl_link_stats64 *stats,
+                                        bool *have_stats) {
+  struct ifinfomsg *ifm = NLMSG_DATA(nlh);
+  char const *name = NULL;
+
+  *have_stats = false;
+
+  if ((nlh->nlmsg_type != RTM_NEWLINK) ||
+      (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifm))))
+    return NULL;
+
+  int len = (int)IFLA_PAYLOAD(nlh);
+  for (struct rtattr *rta = IFLA_RTA(ifm); RTA_OK(rta, len);
+       rta = RTA_NEXT(rta, len)) {
+    if ((rta->rta_type == IFLA_IFNAME) && (RTA_PAYLOAD(rta) > 0)) {
+      name = RTA_DATA(rta);
+      if (name[RTA_PAYLOAD(rta) - 1] != '\0')
+        name = NULL;
+    } else if ((rta->rta_type == IFLA_STATS64) &&
+               (RTA_PAYLOAD(rta) >= sizeof(*stats))) {
+      /* The attribute is only guaranteed to be 4 byte aligned. */
+      memcpy(stats, RTA_DATA(rta), sizeof(*stats));
+      *have_stats = true;
+    }
+  }
+
+  if (name == NULL)
+    return NULL;
+
+  return if_link_get(ifm->ifi_index, name);
+} /* if_link_t *if_netlink_parse_link */
+
+/* if_netlink_name updates the cache from an RTM_NEWLINK message. */
+static void if_netlink_name(struct nlmsghdr *nlh) {
+  struct rtnl_link_stats64 stats;
+  bool have_stats;
+
+  if_netlink_parse_link(nlh, &stats, &have_stats);
+} /* void if_netlink_name */
+
+/* if_netlink_link updates the cache from an RTM_NEWLINK message and submits
+ * the counters of the interface. */
+static void if_netlink_link(struct nlmsghdr *nlh) {
+  struct rtnl_link_stats64 stats;
+  bool have_stats;
+
+  if_link_t *link = if_netlink_parse_link(nlh, &stats, &have_stats);
+  if ((link == NULL) || link->ignored || !have_stats)
+    return;
+
+  if_netlink_submit(link->name, &stats);
+} /* void if_netlink_link */
+
+#ifdef RTM_GETSTATS
+/* if_netlink_stats submits the counters of an RTM_NEWSTATS message, using the
+ * name and ignorelist decision cached by the last RTM_GETLINK dump. */
+static void if_netlink_stats(struct nlmsghdr *nlh) {
+  struct if_stats_msg *ifsm = NLMSG_DATA(nlh);
+  struct rtnl_link_stats64 stats;
+  if_link_t *link = NULL;
+
+  if ((nlh->nlmsg_type != RTM_NEWSTATS) ||
+      (nlh->nlmsg_len < NLMSG_SPACE(sizeof(*ifsm))))
+    return;
+
+  int ifindex = (int)ifsm->ifindex;
+  if (c_avl_get(if_links, &ifindex, (void *)&link) != 0) {
+    /* The interface has been created after the last RTM_GETLINK dump. */
+    if_links_changed = true;
+    return;
+  }
+  if (link->ignored)
+    return;
+
+  int len = (int)(nlh->nlmsg_len - NLMSG_SPACE(sizeof(*ifsm)));
+  for (struct rtattr *rta =
+           (struct rtattr *)((char *)ifsm + NLMSG_ALIGN(sizeof(*ifsm)));
+       RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if ((rta->rta_type == IFLA_STATS_LINK_64) &&
+        (RTA_PAYLOAD(rta) >= sizeof(stats))) {
+      memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+      if_netlink_submit(link->name, &stats);
+      return;
+    }
+  }
+} /* void if_netlink_stats */
+#endif /* RTM_GETSTATS */
+
+/* if_netlink_dump sends the dump request "req" and calls "callback" for each
+ * message of the reply. Returns zero or an errno value. */
+static int if_netlink_dump(struct nlmsghdr *req,
+                           void (*callback)(struct nlmsghdr *)) {
+  req->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req->nlmsg_seq = ++rtnl_seq;
+
+  if (send(rtnl_fd, req, req->nlmsg_len, 0) < 0)
+    return errno;
+
+  while (42) {
+    struct iovec iov = {.iov_base = rtnl_buffer,
+                        .iov_len = IF_NETLINK_BUFFER_SIZE};
+    struct sockaddr_nl sa;
+    struct msghdr msg = {
+        .msg_name = &sa,
+        .msg_namelen = sizeof(sa),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+
+    ssize_t status = recvmsg(rtnl_fd, &msg, 0);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    if (msg.msg_flags & MSG_TRUNC)
+      return EMSGSIZE;
+
+    int len = (int)status;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)rtnl_buffer;
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      /* Skip the left-overs of an earlier, aborted dump. */
+      if ((nlh->nlmsg_seq != rtnl_seq) || (sa.nl_pid != 0))
+        continue;
+
+      if (nlh->nlmsg_type == NLMSG_DONE)
+        return 0;
+
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *err = NLMSG_DATA(nlh);
+        if ((nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*err))) || (err->error == 0))
+          return EBADMSG;
+        return -err->error;
+      }
+
+      callback(nlh);
+    }
+  }
+} /* int if_netlink_dump */
+
+/* if_read_netlink reads the counters of all interfaces with a single
+ * RTM_GETSTATS dump. Its replies only hold the counters, so the names are
+ * taken from an RTM_GETLINK dump, which is only repeated when the kernel has
+ * announced a change of the interfaces. If RTM_GETSTATS is not supported, the
+ * counters are taken from the RTM_GETLINK dump of every read. */
+static int if_read_netlink(void) {
+  struct {
+    struct nlmsghdr nlh;
+    struct ifinfomsg ifm;
+  } link_req = {
+      .nlh =
+          {
+              .nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)),
+              .nlmsg_type = RTM_GETLINK,
+          },
+      .ifm = {.ifi_family = AF_UNSPEC},
+  };
+  int status;
+
+#ifdef RTM_GETSTATS
+  if (rtnl_have_getstats) {
+    if_netlink_events();
+
+    if (if_links_changed) {
+      if_links_changed = false;
+      if_links_generation++;
+      status = if_netlink_dump(&link_req.nlh, if_netlink_name);
+      if (status != 0) {
+        if_links_changed = true;
+        return status;
+      }
+      if_link_expire();
+    }
+
+    struct {
+      struct nlmsghdr nlh;
+      struct if_stats_msg ifsm;
+    } stats_req = {
+        .nlh =
+            {
+                .nlmsg_len = NLMSG_LENGTH(sizeof(struct if_stats_msg)),
+                .nlmsg_type = RTM_GETSTATS,
+            },
+        .ifsm =
+            {
+                .family = AF_UNSPEC,
+                .filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64),
+            },
+    };
+    status = if_netlink_dump(&stats_req.nlh, if_netlink_stats);
+    if (status != EOPNOTSUPP)
+      return status;
+
+    INFO("interface plugin: The kernel does not support RTM_GETSTATS. "
+         "Reading the counters with RTM_GETLINK instead.");
+    rtnl_have_getstats = false;
+  }
+#endif /* RTM_GETSTATS */
+
+  if_links_generation++;
+  status = if_netlink_dump(&link_req.nlh, if_netlink_link);
+  if (status != 0)
+    return status;
+  if_link_expire();
+
+  return 0;
+} /* int if_read_netlink */
+#endif /* !HAVE_GETIFADDRS && KERNEL_LINUX */
+
 static int interface_read(void) {
 #if HAVE_GETIFADDRS
   struct ifaddrs *if_list;
@@ -229,8 +644,7 @@ static int interface_read(void) {
 /* #endif HAVE_GETIFADDRS */
 
 #elif KERNEL_LINUX
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
   derive_t incoming, outgoing;
   char *device;
 
@@ -238,12 +652,40 @@ static int interface_read(void) {
   char *fields[16];
   int numfields;
 
-  if ((fh = fopen("/proc/net/dev", "r")) == NULL) {
-    WARNING("interface plugin: fopen: %s", STRERRNO);
+  if (!rtnl_unavailable) {
+    int status = 0;
+    if (rtnl_fd < 0)
+      status = if_netlink_open();
+    if (status == 0) {
+      status = if_read_netlink();
+      if (status == 0)
+        return 0;
+      /* The socket may hold the rest of the failed dump. */
+      if_netlink_close();
+      ERROR("interface plugin: Reading the interfaces via netlink failed: %s",
+            STRERROR(status));
+      return -1;
+    }
+    WARNING("interface plugin: Opening a netlink socket failed: %s. "
+            "Falling back to /proc/net/dev.",
+            STRERROR(status));
+    rtnl_unavailable = true;
+  }
+
+  if ((proc_net_dev == NULL) &&
+      ((proc_net_dev = procfs_open("/proc/net/dev")) == NULL)) {
+    WARNING("interface plugin: open: %s", STRERRNO);
+    return -1;
+  }
+
+  int status = procfs_read(proc_net_dev);
+  if (status != 0) {
+    WARNING("interface plugin: reading /proc/net/dev failed: %s",
+            STRERROR(status));
     return -1;
   }
 
-  while (fgets(buffer, 1024, fh) != NULL) {
+  while ((buffer = procfs_next_line(proc_net_dev)) != NULL) {
     if (!(dummy = strchr(buffer, ':')))
       continue;
     dummy[0] = '\0';
@@ -280,8 +722,6 @@ static int interface_read(void) {
     outgoing = atoll(fields[11]);
     if_submit(device, "if_dropped", incoming, outgoing);
   }
-
-  fclose(fh);
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -386,6 +826,26 @@ static int interface_read(void) {
   return 0;
 } /* int interface_read */
 
+#if !HAVE_GETIFADDRS && KERNEL_LINUX
+static int interface_shutdown(void) {
+  procfs_close(proc_net_dev);
+  proc_net_dev = NULL;
+
+  if_netlink_close();
+  sfree(rtnl_buffer);
+
+  if (if_links != NULL) {
+    int *ifindex;
+    if_link_t *link;
+    while (c_avl_pick(if_links, (void *)&ifindex, (void *)&link) == 0)
+      sfree(link);
+    c_avl_destroy(if_links);
+    if_links = NULL;
+  }
+  return 0;
+} /* int interface_shutdown */
+#endif
+
 void module_register(void) {
   plugin_register_config("interface", interface_config, config_keys,
                          config_keys_num);
@@ -393,4 +853,7 @@ void module_register(void) {
   plugin_register_init("interface", interface_init);
 #endif
   plugin_register_read("interface", interface_read);
+#if !HAVE_GETIFADDRS && KERNEL_LINUX
+  plugin_register_shutdown("interface", interface_shutdown);
+#endif
 } /* void module_register */
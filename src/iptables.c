@@ -27,6 +27,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
 #include <libiptc/libip6tc.h>
@@ -74,7 +75,7 @@ typedef enum protocol_version_e protocol_version_t;
 #ifndef XT_TABLE_MAXNAMELEN
 #define XT_TABLE_MAXNAMELEN 32
 #endif
-typedef struct {
+typedef struct ip_chain_s {
   protocol_version_t ip_version;
   char table[XT_TABLE_MAXNAMELEN];
   char chain[XT_TABLE_MAXNAMELEN];
@@ -84,11 +85,37 @@ typedef struct {
   } rule;
   enum { RTYPE_NUM, RTYPE_COMMENT, RTYPE_COMMENT_ALL } rule_type;
   char name[64];
+  /* The next entry of the same chain with the same comment. */
+  struct ip_chain_s *next;
 } ip_chain_t;
 
 static ip_chain_t **chain_list;
 static int chain_num;
 
+/*
+ * The entries are grouped by table and chain when the plugin is initialized,
+ * so that a read fetches each table from the kernel once and walks each chain
+ * once, no matter how many entries refer to it. The groups are sorted by
+ * protocol and table.
+ */
+typedef struct {
+  protocol_version_t ip_version;
+  char table[XT_TABLE_MAXNAMELEN];
+  char chain[XT_TABLE_MAXNAMELEN];
+
+  /* Entries selecting rules by number, sorted by the number. */
+  ip_chain_t **by_num;
+  size_t by_num_num;
+  /* Entries collecting all rules with a comment. */
+  ip_chain_t **all;
+  size_t all_num;
+  /* Comment -> entries selecting rules with that comment. */
+  c_avl_tree_t *by_comment;
+} ip_chain_group_t;
+
+static ip_chain_group_t *groups;
+static size_t groups_num;
+
 static int iptables_config(const char *key, const char *value) {
   /* int ip_value; */
   protocol_version_t ip_version = 0;
@@ -201,30 +228,18 @@ static int iptables_config(const char *key, const char *value) {
   return 0;
 } /* int iptables_config */
 
-static int submit6_match(const struct ip6t_entry_match *match,
-                         const struct ip6t_entry *entry,
-                         const ip_chain_t *chain, int rule_num) {
+static void submit_counters(const ip_chain_t *chain, const char *plugin,
+                            const char *comment, uint64_t bcnt,
+                            uint64_t pcnt) {
   int status;
   value_list_t vl = VALUE_LIST_INIT;
 
-  /* Select the rules to collect */
-  if (chain->rule_type == RTYPE_NUM) {
-    if (chain->rule.num != rule_num)
-      return 0;
-  } else {
-    if (strcmp(match->u.user.name, "comment") != 0)
-      return 0;
-    if ((chain->rule_type == RTYPE_COMMENT) &&
-        (strcmp(chain->rule.comment, (char *)match->data) != 0))
-      return 0;
-  }
-
-  sstrncpy(vl.plugin, "ip6tables", sizeof(vl.plugin));
+  sstrncpy(vl.plugin, plugin, sizeof(vl.plugin));
 
   status = snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%s-%s",
                     chain->table, chain->chain);
   if ((status < 1) || ((unsigned int)status >= sizeof(vl.plugin_instance)))
-    return 0;
+    return;
 
   if (chain->name[0] != '\0') {
     sstrncpy(vl.type_instance, chain->name, sizeof(vl.type_instance));
@@ -233,76 +248,87 @@ static int submit6_match(const struct ip6t_entry_match *match,
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%i",
                chain->rule.num);
     else
-      sstrncpy(vl.type_instance, (char *)match->data, sizeof(vl.type_instance));
+      sstrncpy(vl.type_instance, comment, sizeof(vl.type_instance));
   }
 
   sstrncpy(vl.type, "ipt_bytes", sizeof(vl.type));
-  vl.values = &(value_t){.derive = (derive_t)entry->counters.bcnt};
+  vl.values = &(value_t){.derive = (derive_t)bcnt};
   vl.values_len = 1;
   plugin_dispatch_values(&vl);
 
   sstrncpy(vl.type, "ipt_packets", sizeof(vl.type));
-  vl.values = &(value_t){.derive = (derive_t)entry->counters.pcnt};
+  vl.values = &(value_t){.derive = (derive_t)pcnt};
   plugin_dispatch_values(&vl);
+} /* void submit_counters */
+
+/* Submits the counters of a rule with a comment for the entries selecting
+ * it. */
+static void submit_comment(const ip_chain_group_t *group, const char *plugin,
+                           const char *comment, uint64_t bcnt,
+                           uint64_t pcnt) {
+  for (size_t i = 0; i < group->all_num; i++)
+    submit_counters(group->all[i], plugin, comment, bcnt, pcnt);
+
+  ip_chain_t *chain = NULL;
+  if ((group->by_comment != NULL) &&
+      (c_avl_get(group->by_comment, comment, (void *)&chain) == 0)) {
+    for (; chain != NULL; chain = chain->next)
+      submit_counters(chain, plugin, comment, bcnt, pcnt);
+  }
+} /* void submit_comment */
 
+/* This needs to return `int' for IP6T_MATCH_ITERATE to work. */
+static int submit6_match(const struct ip6t_entry_match *match,
+                         const struct ip6t_entry *entry,
+                         const ip_chain_group_t *group) {
+  if (strcmp(match->u.user.name, "comment") != 0)
+    return 0;
+
+  submit_comment(group, "ip6tables", (char *)match->data,
+                 (uint64_t)entry->counters.bcnt,
+                 (uint64_t)entry->counters.pcnt);
   return 0;
 } /* int submit6_match */
 
 /* This needs to return `int' for IPT_MATCH_ITERATE to work. */
 static int submit_match(const struct ipt_entry_match *match,
-                        const struct ipt_entry *entry, const ip_chain_t *chain,
-                        int rule_num) {
-  int status;
-  value_list_t vl = VALUE_LIST_INIT;
-
-  /* Select the rules to collect */
-  if (chain->rule_type == RTYPE_NUM) {
-    if (chain->rule.num != rule_num)
-      return 0;
-  } else {
-    if (strcmp(match->u.user.name, "comment") != 0)
-      return 0;
-    if ((chain->rule_type == RTYPE_COMMENT) &&
-        (strcmp(chain->rule.comment, (char *)match->data) != 0))
-      return 0;
-  }
-
-  sstrncpy(vl.plugin, "iptables", sizeof(vl.plugin));
-
-  status = snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%s-%s",
-                    chain->table, chain->chain);
-  if ((status < 1) || ((unsigned int)status >= sizeof(vl.plugin_instance)))
+                        const struct ipt_entry *entry,
+                        const ip_chain_group_t *group) {
+  if (strcmp(match->u.user.name, "comment") != 0)
     return 0;
 
-  if (chain->name[0] != '\0') {
-    sstrncpy(vl.type_instance, chain->name, sizeof(vl.type_instance));
-  } else {
-    if (chain->rule_type == RTYPE_NUM)
-      snprintf(vl.type_instance, sizeof(vl.type_instance), "%i",
-               chain->rule.num);
-    else
-      sstrncpy(vl.type_instance, (char *)match->data, sizeof(vl.type_instance));
-  }
-
-  sstrncpy(vl.type, "ipt_bytes", sizeof(vl.type));
-  vl.values = &(value_t){.derive = (derive_t)entry->counters.bcnt};
-  vl.values_len = 1;
-  plugin_dispatch_values(&vl);
-
-  sstrncpy(vl.type, "ipt_packets", sizeof(vl.type));
-  vl.values = &(value_t){.derive = (derive_t)entry->counters.pcnt};
-  plugin_dispatch_values(&vl);
-
+  submit_comment(group, "iptables", (char *)match->data,
+                 (uint64_t)entry->counters.bcnt,
+                 (uint64_t)entry->counters.pcnt);
   return 0;
 } /* int submit_match */
 
+/* Submits the entries selecting rule "rule_num" by number. "next" is the
+ * first entry of "by_num" that has not been passed yet. Returns false once
+ * there are no more such entries. */
+static bool submit_num(const ip_chain_group_t *group, const char *plugin,
+                       int rule_num, size_t *next, uint64_t bcnt,
+                       uint64_t pcnt) {
+  while ((*next < group->by_num_num) &&
+         (group->by_num[*next]->rule.num <= rule_num)) {
+    if (group->by_num[*next]->rule.num == rule_num)
+      submit_counters(group->by_num[*next], plugin, NULL, bcnt, pcnt);
+    (*next)++;
+  }
+
+  return *next < group->by_num_num;
+} /* bool submit_num */
+
 /* ipv6 submit_chain */
-static void submit6_chain(ip6tc_handle_t *handle, ip_chain_t *chain) {
+static void submit6_chain(ip6tc_handle_t *handle,
+                          const ip_chain_group_t *group) {
   const struct ip6t_entry *entry;
   int rule_num;
+  size_t next_num = 0;
+  bool by_comment = (group->all_num > 0) || (group->by_comment != NULL);
 
   /* Find first rule for chain and use the iterate macro */
-  entry = ip6tc_first_rule(chain->chain, handle);
+  entry = ip6tc_first_rule(group->chain, handle);
   if (entry == NULL) {
     DEBUG("ip6tc_first_rule failed: %s", ip6tc_strerror(errno));
     return;
@@ -310,11 +336,14 @@ static void submit6_chain(ip6tc_handle_t *handle, ip_chain_t *chain) {
 
   rule_num = 1;
   while (entry) {
-    if (chain->rule_type == RTYPE_NUM) {
-      submit6_match(NULL, entry, chain, rule_num);
-    } else {
-      IP6T_MATCH_ITERATE(entry, submit6_match, entry, chain, rule_num);
-    }
+    bool more_num =
+        submit_num(group, "ip6tables", rule_num, &next_num,
+                   (uint64_t)entry->counters.bcnt,
+                   (uint64_t)entry->counters.pcnt);
+    if (by_comment)
+      IP6T_MATCH_ITERATE(entry, submit6_match, entry, group);
+    else if (!more_num)
+      break;
 
     entry = ip6tc_next_rule(entry, handle);
     rule_num++;
@@ -322,12 +351,15 @@ static void submit6_chain(ip6tc_handle_t *handle, ip_chain_t *chain) {
 }
 
 /* ipv4 submit_chain */
-static void submit_chain(iptc_handle_t *handle, ip_chain_t *chain) {
+static void submit_chain(iptc_handle_t *handle,
+                         const ip_chain_group_t *group) {
   const struct ipt_entry *entry;
   int rule_num;
+  size_t next_num = 0;
+  bool by_comment = (group->all_num > 0) || (group->by_comment != NULL);
 
   /* Find first rule for chain and use the iterate macro */
-  entry = iptc_first_rule(chain->chain, handle);
+  entry = iptc_first_rule(group->chain, handle);
   if (entry == NULL) {
     DEBUG("iptc_first_rule failed: %s", iptc_strerror(errno));
     return;
@@ -335,11 +367,14 @@ static void submit_chain(iptc_handle_t *handle, ip_chain_t *chain) {
 
   rule_num = 1;
   while (entry) {
-    if (chain->rule_type == RTYPE_NUM) {
-      submit_match(NULL, entry, chain, rule_num);
-    } else {
-      IPT_MATCH_ITERATE(entry, submit_match, entry, chain, rule_num);
-    }
+    bool more_num =
+        submit_num(group, "iptables", rule_num, &next_num,
+                   (uint64_t)entry->counters.bcnt,
+                   (uint64_t)entry->counters.pcnt);
+    if (by_comment)
+      IPT_MATCH_ITERATE(entry, submit_match, entry, group);
+    else if (!more_num)
+      break;
 
     entry = iptc_next_rule(entry, handle);
     rule_num++;
@@ -348,64 +383,192 @@ static void submit_chain(iptc_handle_t *handle, ip_chain_t *chain) {
 
 static int iptables_read(void) {
   int num_failures = 0;
-  ip_chain_t *chain;
-
-  /* Init the iptc handle structure and query the correct table */
-  for (int i = 0; i < chain_num; i++) {
-    chain = chain_list[i];
-
-    if (!chain) {
-      DEBUG("iptables plugin: chain == NULL");
-      continue;
-    }
-
-    if (chain->ip_version == IPV4) {
+  int num_tables = 0;
+
+  /* Consecutive groups of the same table share one snapshot of it. */
+  size_t i = 0;
+  while (i < groups_num) {
+    ip_chain_group_t *first = groups + i;
+    size_t end = i + 1;
+    while ((end < groups_num) &&
+           (groups[end].ip_version == first->ip_version) &&
+           (strcmp(groups[end].table, first->table) == 0))
+      end++;
+    num_tables++;
+
+    if (first->ip_version == IPV4) {
 #ifdef HAVE_IPTC_HANDLE_T
       iptc_handle_t _handle;
       iptc_handle_t *handle = &_handle;
 
-      *handle = iptc_init(chain->table);
+      *handle = iptc_init(first->table);
 #else
       iptc_handle_t *handle;
-      handle = iptc_init(chain->table);
+      handle = iptc_init(first->table);
 #endif
 
       if (!handle) {
-        ERROR("iptables plugin: iptc_init (%s) failed: %s", chain->table,
+        ERROR("iptables plugin: iptc_init (%s) failed: %s", first->table,
               iptc_strerror(errno));
         num_failures++;
-        continue;
+      } else {
+        for (size_t j = i; j < end; j++)
+          submit_chain(handle, groups + j);
+        iptc_free(handle);
       }
-
-      submit_chain(handle, chain);
-      iptc_free(handle);
-    } else if (chain->ip_version == IPV6) {
+    } else if (first->ip_version == IPV6) {
 #ifdef HAVE_IP6TC_HANDLE_T
       ip6tc_handle_t _handle;
       ip6tc_handle_t *handle = &_handle;
 
-      *handle = ip6tc_init(chain->table);
+      *handle = ip6tc_init(first->table);
 #else
       ip6tc_handle_t *handle;
-      handle = ip6tc_init(chain->table);
+      handle = ip6tc_init(first->table);
 #endif
       if (!handle) {
-        ERROR("iptables plugin: ip6tc_init (%s) failed: %s", chain->table,
+        ERROR("iptables plugin: ip6tc_init (%s) failed: %s", first->table,
               ip6tc_strerror(errno));
         num_failures++;
-        continue;
+      } else {
+        for (size_t j = i; j < end; j++)
+          submit6_chain(handle, groups + j);
+        ip6tc_free(handle);
       }
-
-      submit6_chain(handle, chain);
-      ip6tc_free(handle);
     } else
       num_failures++;
-  } /* for (i = 0 .. chain_num) */
 
-  return (num_failures < chain_num) ? 0 : -1;
+    i = end;
+  } /* while (i < groups_num) */
+
+  return (num_failures < num_tables) ? 0 : -1;
 } /* int iptables_read */
 
+static int group_compare(const void *a, const void *b) {
+  const ip_chain_group_t *ga = a;
+  const ip_chain_group_t *gb = b;
+
+  if (ga->ip_version != gb->ip_version)
+    return (ga->ip_version < gb->ip_version) ? -1 : 1;
+
+  int status = strcmp(ga->table, gb->table);
+  if (status != 0)
+    return status;
+
+  return strcmp(ga->chain, gb->chain);
+} /* int group_compare */
+
+static int chain_num_compare(const void *a, const void *b) {
+  const ip_chain_t *ca = *(ip_chain_t *const *)a;
+  const ip_chain_t *cb = *(ip_chain_t *const *)b;
+
+  return (ca->rule.num > cb->rule.num) - (ca->rule.num < cb->rule.num);
+} /* int chain_num_compare */
+
+static int group_add(ip_chain_group_t *group, ip_chain_t *chain) {
+  if (chain->rule_type == RTYPE_NUM) {
+    ip_chain_t **tmp = realloc(group->by_num, (group->by_num_num + 1) *
+                                                  sizeof(*group->by_num));
+    if (tmp == NULL)
+      return ENOMEM;
+    group->by_num = tmp;
+    group->by_num[group->by_num_num++] = chain;
+  } else if (chain->rule_type == RTYPE_COMMENT_ALL) {
+    ip_chain_t **tmp =
+        realloc(group->all, (group->all_num + 1) * sizeof(*group->all));
+    if (tmp == NULL)
+      return ENOMEM;
+    group->all = tmp;
+    group->all[group->all_num++] = chain;
+  } else {
+    if (group->by_comment == NULL) {
+      group->by_comment =
+          c_avl_create((int (*)(const void *, const void *))strcmp);
+      if (group->by_comment == NULL)
+        return ENOMEM;
+    }
+
+    ip_chain_t *head = NULL;
+    if (c_avl_get(group->by_comment, chain->rule.comment, (void *)&head) ==
+        0) {
+      /* Keep the configured order. */
+      while (head->next != NULL)
+        head = head->next;
+      head->next = chain;
+    } else if (c_avl_insert(group->by_comment, chain->rule.comment, chain) !=
+               0) {
+      return ENOMEM;
+    }
+  }
+
+  return 0;
+} /* int group_add */
+
+static void groups_free(void) {
+  for (size_t i = 0; i < groups_num; i++) {
+    sfree(groups[i].by_num);
+    sfree(groups[i].all);
+    if (groups[i].by_comment != NULL)
+      c_avl_destroy(groups[i].by_comment);
+  }
+  sfree(groups);
+  groups_num = 0;
+} /* void groups_free */
+
+static int groups_create(void) {
+  groups_free();
+
+  for (int i = 0; i < chain_num; i++) {
+    ip_chain_t *chain = chain_list[i];
+    if (chain == NULL)
+      continue;
+    chain->next = NULL;
+
+    ip_chain_group_t *group = NULL;
+    for (size_t j = 0; j < groups_num; j++) {
+      if ((groups[j].ip_version == chain->ip_version) &&
+          (strcmp(groups[j].table, chain->table) == 0) &&
+          (strcmp(groups[j].chain, chain->chain) == 0)) {
+        group = groups + j;
+        break;
+      }
+    }
+
+    if (group == NULL) {
+      ip_chain_group_t *tmp =
+          realloc(groups, (groups_num + 1) * sizeof(*groups));
+      if (tmp == NULL) {
+        groups_free();
+        return ENOMEM;
+      }
+      groups = tmp;
+      group = groups + groups_num;
+      groups_num++;
+
+      *group = (ip_chain_group_t){.ip_version = chain->ip_version};
+      sstrncpy(group->table, chain->table, sizeof(group->table));
+      sstrncpy(group->chain, chain->chain, sizeof(group->chain));
+    }
+
+    if (group_add(group, chain) != 0) {
+      groups_free();
+      return ENOMEM;
+    }
+  }
+
+  if (groups_num > 0)
+    qsort(groups, groups_num, sizeof(*groups), group_compare);
+  for (size_t i = 0; i < groups_num; i++)
+    if (groups[i].by_num_num > 0)
+      qsort(groups[i].by_num, groups[i].by_num_num, sizeof(*groups[i].by_num),
+            chain_num_compare);
+
+  return 0;
+} /* int groups_create */
+
 static int iptables_shutdown(void) {
+  groups_free();
+
   for (int i = 0; i < chain_num; i++) {
     if ((chain_list[i] != NULL) && (chain_list[i]->rule_type == RTYPE_COMMENT))
       sfree(chain_list[i]->rule.comment);
@@ -430,6 +593,12 @@ static int iptables_init(void) {
               "running \"setcap cap_net_admin=ep\" on the collectd binary.");
   }
 #endif
+
+  if (groups_create() != 0) {
+    ERROR("iptables plugin: Grouping the chains failed.");
+    return -1;
+  }
+
   return 0;
 } /* int iptables_init */
 
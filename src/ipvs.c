@@ -42,16 +42,66 @@
 #include <netinet/in.h>
 #endif /* HAVE_NETINET_IN_H */
 
+#include <linux/genetlink.h>
 #include <linux/ip_vs.h>
+#include <linux/netlink.h>
 
 #define log_err(...) ERROR("ipvs: " __VA_ARGS__)
 #define log_info(...) INFO("ipvs: " __VA_ARGS__)
 
+/* Value lists are dispatched in batches of this many. */
+#define CIPVS_BATCH_SIZE 64
+
+/* The kernel fills dump messages up to the size of the receive buffer, but
+ * not beyond 32 kByte. */
+#define CIPVS_NL_BUFSIZE 32768
+
+typedef union {
+  struct in_addr in;
+  struct in6_addr in6;
+  uint8_t raw[16];
+} cipvs_addr_t;
+
+typedef struct {
+  uint64_t conns;
+  uint64_t inpkts;
+  uint64_t outpkts;
+  uint64_t inbytes;
+  uint64_t outbytes;
+} cipvs_stats_t;
+
+typedef struct {
+  uint16_t af;
+  uint16_t protocol;
+  cipvs_addr_t addr;
+  uint16_t port; /* network byte order */
+  uint32_t fwmark;
+  cipvs_stats_t stats;
+} cipvs_service_t;
+
+typedef struct {
+  uint16_t af;
+  cipvs_addr_t addr;
+  uint16_t port; /* network byte order */
+  cipvs_stats_t stats;
+} cipvs_dest_t;
+
 /*
  * private variables
  */
 static int sockfd = -1;
 
+/* Generic netlink socket and the ID of the IPVS family, if the kernel has
+ * one. Otherwise, the statistics are read with getsockopt(2). */
+static int nl_fd = -1;
+static uint16_t nl_family;
+static uint32_t nl_seq;
+static char *nl_buf;
+
+static value_list_t batch_vls[CIPVS_BATCH_SIZE];
+static value_t batch_values[CIPVS_BATCH_SIZE][2];
+static size_t batch_num;
+
 /*
  * libipvs API
  */
@@ -114,6 +164,262 @@ static struct ip_vs_get_dests *ipvs_get_dests(struct ip_vs_service_entry *se) {
   return dests;
 } /* ip_vs_get_dests */
 
+/*
+ * generic netlink API
+ */
+static void nl_parse(struct nlattr **tb, int max, void const *data,
+                     size_t len) {
+  memset(tb, 0, sizeof(*tb) * (max + 1));
+
+  struct nlattr const *nla = data;
+  while ((len >= sizeof(*nla)) && (nla->nla_len >= sizeof(*nla)) &&
+         (nla->nla_len <= len)) {
+    int type = nla->nla_type & NLA_TYPE_MASK;
+    if (type <= max)
+      tb[type] = (struct nlattr *)nla;
+
+    size_t step = NLA_ALIGN(nla->nla_len);
+    if (step >= len)
+      break;
+    len -= step;
+    nla = (struct nlattr const *)((char const *)nla + step);
+  }
+} /* nl_parse */
+
+static void *nl_data(struct nlattr const *nla) {
+  return (char *)nla + NLA_HDRLEN;
+}
+
+static size_t nl_len(struct nlattr const *nla) {
+  return nla->nla_len - NLA_HDRLEN;
+}
+
+/* Reads an attribute of 8, 4 or 2 bytes. The statistics have 32-bit and
+ * 64-bit variants. */
+static uint64_t nl_get_uint(struct nlattr const *nla) {
+  if (nla == NULL)
+    return 0;
+
+  switch (nl_len(nla)) {
+  case sizeof(uint64_t): {
+    uint64_t v;
+    memcpy(&v, nl_data(nla), sizeof(v));
+    return v;
+  }
+  case sizeof(uint32_t): {
+    uint32_t v;
+    memcpy(&v, nl_data(nla), sizeof(v));
+    return v;
+  }
+  case sizeof(uint16_t): {
+    uint16_t v;
+    memcpy(&v, nl_data(nla), sizeof(v));
+    return v;
+  }
+  }
+  return 0;
+} /* nl_get_uint */
+
+static struct nlattr *nl_put(struct nlmsghdr *nlh, size_t size, uint16_t type,
+                             void const *data, size_t len) {
+  size_t offset = NLMSG_ALIGN(nlh->nlmsg_len);
+  if (offset + NLA_HDRLEN + NLA_ALIGN(len) > size)
+    return NULL;
+
+  struct nlattr *nla = (struct nlattr *)((char *)nlh + offset);
+  nla->nla_type = type;
+  nla->nla_len = NLA_HDRLEN + len;
+  if (len > 0)
+    memcpy(nl_data(nla), data, len);
+  nlh->nlmsg_len = offset + NLA_ALIGN(nla->nla_len);
+  return nla;
+} /* nl_put */
+
+static void nl_nest_end(struct nlmsghdr *nlh, struct nlattr *nest) {
+  nest->nla_len = (uint16_t)((char *)nlh + nlh->nlmsg_len - (char *)nest);
+}
+
+static void nl_init_request(struct nlmsghdr *nlh, uint16_t type, uint16_t flags,
+                            uint8_t cmd) {
+  nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+  nlh->nlmsg_type = type;
+  nlh->nlmsg_flags = NLM_F_REQUEST | flags;
+  nlh->nlmsg_seq = ++nl_seq;
+  nlh->nlmsg_pid = 0;
+
+  struct genlmsghdr *genl = NLMSG_DATA(nlh);
+  genl->cmd = cmd;
+  genl->version = 1;
+  genl->reserved = 0;
+}
+
+typedef int (*nl_cb_t)(struct nlattr **tb, void *arg);
+
+/* Sends a request and calls "cb" with the top-level attributes of each
+ * message of the answer, until the end of a dump or the acknowledgement. */
+static int nl_talk(struct nlmsghdr *req, int max, nl_cb_t cb, void *arg) {
+  struct sockaddr_nl sa = {.nl_family = AF_NETLINK};
+
+  if (sendto(nl_fd, req, req->nlmsg_len, 0, (struct sockaddr *)&sa,
+             sizeof(sa)) < 0)
+    return -1;
+
+  uint32_t seq = req->nlmsg_seq;
+  bool done = false;
+  int status = 0;
+  struct nlattr *tb[max + 1];
+
+  while (!done) {
+    ssize_t len = recv(nl_fd, nl_buf, CIPVS_NL_BUFSIZE, 0);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)nl_buf;
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      /* Left over from a request that failed half way. */
+      if (nlh->nlmsg_seq != seq)
+        continue;
+
+      if (nlh->nlmsg_type == NLMSG_DONE) {
+        done = true;
+        break;
+      }
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr const *err = NLMSG_DATA(nlh);
+        if (err->error != 0) {
+          errno = -err->error;
+          return -1;
+        }
+        done = true;
+        break;
+      }
+      if (nlh->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN))
+        continue;
+
+      /* Keep reading until the end of the dump, so the socket can be used
+       * for the next request, but stop calling back. */
+      if (status != 0)
+        continue;
+
+      nl_parse(tb, max, (char *)NLMSG_DATA(nlh) + GENL_HDRLEN,
+               nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+      status = cb(tb, arg);
+
+      if (!(nlh->nlmsg_flags & NLM_F_MULTI))
+        done = true;
+    }
+  }
+
+  if (status != 0)
+    errno = status;
+  return (status != 0) ? -1 : 0;
+} /* nl_talk */
+
+static int nl_family_cb(struct nlattr **tb, void *arg) {
+  if (tb[CTRL_ATTR_FAMILY_ID] == NULL)
+    return ENOENT;
+
+  *(uint16_t *)arg = (uint16_t)nl_get_uint(tb[CTRL_ATTR_FAMILY_ID]);
+  return 0;
+}
+
+static int nl_open(void) {
+  union {
+    struct nlmsghdr nlh;
+    char buf[256];
+  } req;
+
+  nl_buf = malloc(CIPVS_NL_BUFSIZE);
+  if (nl_buf == NULL)
+    return -1;
+
+  nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (nl_fd < 0) {
+    sfree(nl_buf);
+    return -1;
+  }
+
+  nl_init_request(&req.nlh, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY);
+  nl_put(&req.nlh, sizeof(req), CTRL_ATTR_FAMILY_NAME, IPVS_GENL_NAME,
+         sizeof(IPVS_GENL_NAME));
+
+  nl_family = 0;
+  if ((nl_talk(&req.nlh, CTRL_ATTR_MAX, nl_family_cb, &nl_family) != 0) ||
+      (nl_family == 0)) {
+    close(nl_fd);
+    nl_fd = -1;
+    sfree(nl_buf);
+    return -1;
+  }
+  return 0;
+} /* nl_open */
+
+static void nl_get_stats(cipvs_stats_t *stats, struct nlattr *stats64,
+                         struct nlattr *stats32) {
+  struct nlattr *nla = (stats64 != NULL) ? stats64 : stats32;
+  struct nlattr *tb[IPVS_STATS_ATTR_MAX + 1];
+
+  memset(stats, 0, sizeof(*stats));
+  if (nla == NULL)
+    return;
+
+  nl_parse(tb, IPVS_STATS_ATTR_MAX, nl_data(nla), nl_len(nla));
+  stats->conns = nl_get_uint(tb[IPVS_STATS_ATTR_CONNS]);
+  stats->inpkts = nl_get_uint(tb[IPVS_STATS_ATTR_INPKTS]);
+  stats->outpkts = nl_get_uint(tb[IPVS_STATS_ATTR_OUTPKTS]);
+  stats->inbytes = nl_get_uint(tb[IPVS_STATS_ATTR_INBYTES]);
+  stats->outbytes = nl_get_uint(tb[IPVS_STATS_ATTR_OUTBYTES]);
+} /* nl_get_stats */
+
+static void nl_get_addr(cipvs_addr_t *addr, struct nlattr const *nla) {
+  memset(addr, 0, sizeof(*addr));
+  if (nla != NULL)
+    memcpy(addr, nl_data(nla), MIN(nl_len(nla), sizeof(*addr)));
+}
+
+typedef struct {
+  cipvs_service_t *services;
+  size_t num;
+  size_t size;
+} nl_services_t;
+
+static int nl_service_cb(struct nlattr **tb, void *arg) {
+  nl_services_t *s = arg;
+  struct nlattr *svc[IPVS_SVC_ATTR_MAX + 1];
+
+  if (tb[IPVS_CMD_ATTR_SERVICE] == NULL)
+    return 0;
+  nl_parse(svc, IPVS_SVC_ATTR_MAX, nl_data(tb[IPVS_CMD_ATTR_SERVICE]),
+           nl_len(tb[IPVS_CMD_ATTR_SERVICE]));
+  if (svc[IPVS_SVC_ATTR_AF] == NULL)
+    return 0;
+
+  if (s->num == s->size) {
+    size_t size = (s->size > 0) ? 2 * s->size : 64;
+    cipvs_service_t *tmp = realloc(s->services, size * sizeof(*tmp));
+    if (tmp == NULL)
+      return ENOMEM;
+    s->services = tmp;
+    s->size = size;
+  }
+
+  cipvs_service_t *se = s->services + s->num;
+  memset(se, 0, sizeof(*se));
+  se->af = (uint16_t)nl_get_uint(svc[IPVS_SVC_ATTR_AF]);
+  se->protocol = (uint16_t)nl_get_uint(svc[IPVS_SVC_ATTR_PROTOCOL]);
+  nl_get_addr(&se->addr, svc[IPVS_SVC_ATTR_ADDR]);
+  se->port = (uint16_t)nl_get_uint(svc[IPVS_SVC_ATTR_PORT]);
+  se->fwmark = (uint32_t)nl_get_uint(svc[IPVS_SVC_ATTR_FWMARK]);
+  nl_get_stats(&se->stats, svc[IPVS_SVC_ATTR_STATS64],
+               svc[IPVS_SVC_ATTR_STATS]);
+  s->num++;
+
+  return 0;
+} /* nl_service_cb */
+
 /*
  * collectd plugin API and helper functions
  */
@@ -146,6 +452,13 @@ static int cipvs_init(void) {
     log_info("Successfully connected to IPVS %d.%d.%d",
              NVERSION(ipvs_info.version));
   }
+
+  if (nl_open() == 0)
+    log_info("Reading statistics with generic netlink.");
+  else
+    log_info("Generic netlink is not available (%s), reading statistics "
+             "with getsockopt().",
+             STRERRNO);
   return 0;
 } /* cipvs_init */
 
@@ -155,15 +468,15 @@ static int cipvs_init(void) {
  */
 
 /* plugin instance */
-static int get_pi(struct ip_vs_service_entry *se, char *pi, size_t size) {
-  if ((se == NULL) || (pi == NULL))
-    return 0;
+static int get_pi(cipvs_service_t const *se, char *pi, size_t size) {
+  char addr[INET6_ADDRSTRLEN];
 
-  struct in_addr addr = {.s_addr = se->addr};
+  if (inet_ntop(se->af, &se->addr, addr, sizeof(addr)) == NULL)
+    sstrncpy(addr, "unknown", sizeof(addr));
 
-  int len =
-      snprintf(pi, size, "%s_%s%u", inet_ntoa(addr),
-               (se->protocol == IPPROTO_TCP) ? "TCP" : "UDP", ntohs(se->port));
+  int len = snprintf(pi, size, "%s_%s%u", addr,
+                     (se->protocol == IPPROTO_TCP) ? "TCP" : "UDP",
+                     ntohs(se->port));
 
   if ((len < 0) || (size <= ((size_t)len))) {
     log_err("plugin instance truncated: %s", pi);
@@ -173,13 +486,13 @@ static int get_pi(struct ip_vs_service_entry *se, char *pi, size_t size) {
 } /* get_pi */
 
 /* type instance */
-static int get_ti(struct ip_vs_dest_entry *de, char *ti, size_t size) {
-  if ((de == NULL) || (ti == NULL))
-    return 0;
+static int get_ti(cipvs_dest_t const *de, char *ti, size_t size) {
+  char addr[INET6_ADDRSTRLEN];
 
-  struct in_addr addr = {.s_addr = de->addr};
+  if (inet_ntop(de->af, &de->addr, addr, sizeof(addr)) == NULL)
+    sstrncpy(addr, "unknown", sizeof(addr));
 
-  int len = snprintf(ti, size, "%s_%u", inet_ntoa(addr), ntohs(de->port));
+  int len = snprintf(ti, size, "%s_%u", addr, ntohs(de->port));
 
   if ((len < 0) || (size <= ((size_t)len))) {
     log_err("type instance truncated: %s", ti);
@@ -188,89 +501,211 @@ static int get_ti(struct ip_vs_dest_entry *de, char *ti, size_t size) {
   return 0;
 } /* get_ti */
 
-static void cipvs_submit_connections(const char *pi, const char *ti,
-                                     derive_t value) {
-  value_list_t vl = VALUE_LIST_INIT;
-
-  vl.values = &(value_t){.derive = value};
-  vl.values_len = 1;
-
-  sstrncpy(vl.plugin, "ipvs", sizeof(vl.plugin));
-  sstrncpy(vl.plugin_instance, pi, sizeof(vl.plugin_instance));
-  sstrncpy(vl.type, "connections", sizeof(vl.type));
-  sstrncpy(vl.type_instance, (ti != NULL) ? ti : "total",
-           sizeof(vl.type_instance));
-
-  plugin_dispatch_values(&vl);
-} /* cipvs_submit_connections */
-
-static void cipvs_submit_if(const char *pi, const char *t, const char *ti,
-                            derive_t rx, derive_t tx) {
-  value_t values[] = {
-      {.derive = rx}, {.derive = tx},
-  };
-  value_list_t vl = VALUE_LIST_INIT;
-
-  vl.values = values;
-  vl.values_len = STATIC_ARRAY_SIZE(values);
-
-  sstrncpy(vl.plugin, "ipvs", sizeof(vl.plugin));
-  sstrncpy(vl.plugin_instance, pi, sizeof(vl.plugin_instance));
-  sstrncpy(vl.type, t, sizeof(vl.type));
-  sstrncpy(vl.type_instance, (ti != NULL) ? ti : "total",
-           sizeof(vl.type_instance));
-
-  plugin_dispatch_values(&vl);
-} /* cipvs_submit_if */
-
-static void cipvs_submit_dest(const char *pi, struct ip_vs_dest_entry *de) {
-  struct ip_vs_stats_user stats = de->stats;
-
+static void cipvs_flush(void) {
+  if (batch_num > 0)
+    plugin_dispatch_values_batch(batch_vls, batch_num);
+  batch_num = 0;
+} /* cipvs_flush */
+
+static void cipvs_submit(const char *pi, const char *t, const char *ti,
+                         value_t const *values, size_t values_len) {
+  if (batch_num == CIPVS_BATCH_SIZE)
+    cipvs_flush();
+
+  value_list_t *vl = batch_vls + batch_num;
+  *vl = (value_list_t)VALUE_LIST_INIT;
+
+  memcpy(batch_values[batch_num], values, values_len * sizeof(*values));
+  vl->values = batch_values[batch_num];
+  vl->values_len = values_len;
+
+  sstrncpy(vl->plugin, "ipvs", sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, pi, sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, t, sizeof(vl->type));
+  sstrncpy(vl->type_instance, (ti != NULL) ? ti : "total",
+           sizeof(vl->type_instance));
+
+  batch_num++;
+} /* cipvs_submit */
+
+static void cipvs_submit_stats(const char *pi, const char *ti,
+                               cipvs_stats_t const *stats) {
+  cipvs_submit(pi, "connections", ti,
+               &(value_t){.derive = (derive_t)stats->conns}, 1);
+  cipvs_submit(pi, "if_packets", ti,
+               (value_t[]){{.derive = (derive_t)stats->inpkts},
+                           {.derive = (derive_t)stats->outpkts}},
+               2);
+  cipvs_submit(pi, "if_octets", ti,
+               (value_t[]){{.derive = (derive_t)stats->inbytes},
+                           {.derive = (derive_t)stats->outbytes}},
+               2);
+} /* cipvs_submit_stats */
+
+static void cipvs_submit_dest(const char *pi, cipvs_dest_t const *de) {
   char ti[DATA_MAX_NAME_LEN];
 
   if (get_ti(de, ti, sizeof(ti)) != 0)
     return;
 
-  cipvs_submit_connections(pi, ti, stats.conns);
-  cipvs_submit_if(pi, "if_packets", ti, stats.inpkts, stats.outpkts);
-  cipvs_submit_if(pi, "if_octets", ti, stats.inbytes, stats.outbytes);
+  cipvs_submit_stats(pi, ti, &de->stats);
 } /* cipvs_submit_dest */
 
-static void cipvs_submit_service(struct ip_vs_service_entry *se) {
-  struct ip_vs_stats_user stats = se->stats;
-  struct ip_vs_get_dests *dests = ipvs_get_dests(se);
+static void cipvs_copy_stats(cipvs_stats_t *dst,
+                             struct ip_vs_stats_user const *src) {
+  dst->conns = src->conns;
+  dst->inpkts = src->inpkts;
+  dst->outpkts = src->outpkts;
+  dst->inbytes = src->inbytes;
+  dst->outbytes = src->outbytes;
+} /* cipvs_copy_stats */
+
+static void cipvs_submit_service(struct ip_vs_service_entry *entry) {
+  cipvs_service_t se = {
+      .af = AF_INET,
+      .protocol = entry->protocol,
+      .addr.in.s_addr = entry->addr,
+      .port = entry->port,
+      .fwmark = entry->fwmark,
+  };
+  cipvs_copy_stats(&se.stats, &entry->stats);
 
   char pi[DATA_MAX_NAME_LEN];
 
-  if (get_pi(se, pi, sizeof(pi)) != 0) {
-    free(dests);
+  if (get_pi(&se, pi, sizeof(pi)) != 0)
     return;
-  }
 
-  cipvs_submit_connections(pi, NULL, stats.conns);
-  cipvs_submit_if(pi, "if_packets", NULL, stats.inpkts, stats.outpkts);
-  cipvs_submit_if(pi, "if_octets", NULL, stats.inbytes, stats.outbytes);
+  cipvs_submit_stats(pi, NULL, &se.stats);
 
-  for (size_t i = 0; i < dests->num_dests; ++i)
-    cipvs_submit_dest(pi, &dests->entrytable[i]);
+  struct ip_vs_get_dests *dests = ipvs_get_dests(entry);
+  if (dests == NULL)
+    return;
+
+  for (size_t i = 0; i < dests->num_dests; ++i) {
+    struct ip_vs_dest_entry *d = dests->entrytable + i;
+    cipvs_dest_t de = {
+        .af = AF_INET, .addr.in.s_addr = d->addr, .port = d->port,
+    };
+    cipvs_copy_stats(&de.stats, &d->stats);
+    cipvs_submit_dest(pi, &de);
+  }
 
   free(dests);
   return;
 } /* cipvs_submit_service */
 
-static int cipvs_read(void) {
-  if (sockfd < 0)
-    return -1;
-
+static int cipvs_read_getsockopt(void) {
   struct ip_vs_get_services *services = ipvs_get_services();
   if (services == NULL)
     return -1;
 
   for (size_t i = 0; i < services->num_services; ++i)
     cipvs_submit_service(&services->entrytable[i]);
+  cipvs_flush();
 
   free(services);
   return 0;
+} /* cipvs_read_getsockopt */
+
+typedef struct {
+  cipvs_service_t const *se;
+  char const *pi;
+} nl_dest_arg_t;
+
+static int nl_dest_cb(struct nlattr **tb, void *arg) {
+  nl_dest_arg_t *a = arg;
+  struct nlattr *dest[IPVS_DEST_ATTR_MAX + 1];
+
+  if (tb[IPVS_CMD_ATTR_DEST] == NULL)
+    return 0;
+  nl_parse(dest, IPVS_DEST_ATTR_MAX, nl_data(tb[IPVS_CMD_ATTR_DEST]),
+           nl_len(tb[IPVS_CMD_ATTR_DEST]));
+
+  /* Destinations may have another address family than their service. */
+  cipvs_dest_t de = {.af = a->se->af};
+  if (dest[IPVS_DEST_ATTR_ADDR_FAMILY] != NULL)
+    de.af = (uint16_t)nl_get_uint(dest[IPVS_DEST_ATTR_ADDR_FAMILY]);
+  nl_get_addr(&de.addr, dest[IPVS_DEST_ATTR_ADDR]);
+  de.port = (uint16_t)nl_get_uint(dest[IPVS_DEST_ATTR_PORT]);
+  nl_get_stats(&de.stats, dest[IPVS_DEST_ATTR_STATS64],
+               dest[IPVS_DEST_ATTR_STATS]);
+
+  cipvs_submit_dest(a->pi, &de);
+  return 0;
+} /* nl_dest_cb */
+
+static int nl_read_dests(cipvs_service_t const *se, char const *pi) {
+  union {
+    struct nlmsghdr nlh;
+    char buf[256];
+  } req;
+  struct nlmsghdr *nlh = &req.nlh;
+
+  nl_init_request(nlh, nl_family, NLM_F_DUMP, IPVS_CMD_GET_DEST);
+
+  /* The service is identified by its firewall mark or by its protocol,
+   * address and port. */
+  struct nlattr *nest =
+      nl_put(nlh, sizeof(req), IPVS_CMD_ATTR_SERVICE | NLA_F_NESTED, NULL, 0);
+  nl_put(nlh, sizeof(req), IPVS_SVC_ATTR_AF, &se->af, sizeof(se->af));
+  if (se->fwmark != 0) {
+    nl_put(nlh, sizeof(req), IPVS_SVC_ATTR_FWMARK, &se->fwmark,
+           sizeof(se->fwmark));
+  } else {
+    nl_put(nlh, sizeof(req), IPVS_SVC_ATTR_PROTOCOL, &se->protocol,
+           sizeof(se->protocol));
+    nl_put(nlh, sizeof(req), IPVS_SVC_ATTR_ADDR, &se->addr, sizeof(se->addr));
+    nl_put(nlh, sizeof(req), IPVS_SVC_ATTR_PORT, &se->port, sizeof(se->port));
+  }
+  nl_nest_end(nlh, nest);
+
+  nl_dest_arg_t arg = {.se = se, .pi = pi};
+  return nl_talk(nlh, IPVS_CMD_ATTR_MAX, nl_dest_cb, &arg);
+} /* nl_read_dests */
+
+/* Dumps all services in one request, then the destinations of each service.
+ * The kernel has no request for the destinations of all services. */
+static int cipvs_read_netlink(void) {
+  union {
+    struct nlmsghdr nlh;
+    char buf[64];
+  } req;
+  nl_services_t s = {0};
+
+  nl_init_request(&req.nlh, nl_family, NLM_F_DUMP, IPVS_CMD_GET_SERVICE);
+  if (nl_talk(&req.nlh, IPVS_CMD_ATTR_MAX, nl_service_cb, &s) != 0) {
+    log_err("cipvs_read: Dumping the services failed: %s", STRERRNO);
+    free(s.services);
+    return -1;
+  }
+
+  for (size_t i = 0; i < s.num; i++) {
+    cipvs_service_t const *se = s.services + i;
+    char pi[DATA_MAX_NAME_LEN];
+
+    if (get_pi(se, pi, sizeof(pi)) != 0)
+      continue;
+
+    cipvs_submit_stats(pi, NULL, &se->stats);
+
+    /* The service may have been removed since the dump. */
+    if ((nl_read_dests(se, pi) != 0) && (errno != ESRCH))
+      log_err("cipvs_read: Dumping the destinations of %s failed: %s", pi,
+              STRERRNO);
+  }
+  cipvs_flush();
+
+  free(s.services);
+  return 0;
+} /* cipvs_read_netlink */
+
+static int cipvs_read(void) {
+  if (sockfd < 0)
+    return -1;
+
+  if (nl_fd >= 0)
+    return cipvs_read_netlink();
+  return cipvs_read_getsockopt();
 } /* cipvs_read */
 
 static int cipvs_shutdown(void) {
@@ -278,6 +713,11 @@ static int cipvs_shutdown(void) {
     close(sockfd);
   sockfd = -1;
 
+  if (nl_fd >= 0)
+    close(nl_fd);
+  nl_fd = -1;
+  sfree(nl_buf);
+
   return 0;
 } /* cipvs_shutdown */
 
@@ -26,6 +26,7 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
+#include "utils/procfs/procfs.h"
 
 #if !KERNEL_LINUX
 #error "No applicable input method."
@@ -39,6 +40,8 @@ static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static ignorelist_t *ignorelist;
 
+static procfs_file_t *proc_interrupts;
+
 /*
  * Private functions
  */
@@ -76,8 +79,7 @@ static void irq_submit(const char *irq_name, derive_t value) {
 } /* void irq_submit */
 
 static int irq_read(void) {
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
   int cpu_count;
   char *fields[256];
 
@@ -88,23 +90,30 @@ static int irq_read(void) {
    * 1:     102553     158669     218062      70587   IO-APIC-edge      i8042
    * 8:          0          0          0          1   IO-APIC-edge      rtc0
    */
-  fh = fopen("/proc/interrupts", "r");
-  if (fh == NULL) {
-    ERROR("irq plugin: fopen (/proc/interrupts): %s", STRERRNO);
+  if (proc_interrupts == NULL) {
+    proc_interrupts = procfs_open("/proc/interrupts");
+    if (proc_interrupts == NULL) {
+      ERROR("irq plugin: open (/proc/interrupts): %s", STRERRNO);
+      return -1;
+    }
+  }
+
+  int status = procfs_read(proc_interrupts);
+  if (status != 0) {
+    ERROR("irq plugin: reading /proc/interrupts failed: %s", STRERROR(status));
     return -1;
   }
 
   /* Get CPU count from the first line */
-  if (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  if ((buffer = procfs_next_line(proc_interrupts)) != NULL) {
     cpu_count = strsplit(buffer, fields, STATIC_ARRAY_SIZE(fields));
   } else {
     ERROR("irq plugin: unable to get CPU count from first line "
           "of /proc/interrupts");
-    fclose(fh);
     return -1;
   }
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while ((buffer = procfs_next_line(proc_interrupts)) != NULL) {
     char *irq_name;
     size_t irq_name_len;
     derive_t irq_value;
@@ -161,12 +170,17 @@ static int irq_read(void) {
     irq_submit(irq_name, irq_value);
   }
 
-  fclose(fh);
-
   return 0;
 } /* int irq_read */
 
+static int irq_shutdown(void) {
+  procfs_close(proc_interrupts);
+  proc_interrupts = NULL;
+  return 0;
+} /* int irq_shutdown */
+
 void module_register(void) {
   plugin_register_config("irq", irq_config, config_keys, config_keys_num);
   plugin_register_read("irq", irq_read);
+  plugin_register_shutdown("irq", irq_shutdown);
 } /* void module_register */
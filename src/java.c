@@ -26,6 +26,7 @@
 #include "filter_chain.h"
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils_ident.h"
 
 #include <jni.h>
 
@@ -63,6 +64,7 @@ typedef struct java_plugin_class_s java_plugin_class_t;
 #define CB_TYPE_NOTIFICATION 8
 #define CB_TYPE_MATCH 9
 #define CB_TYPE_TARGET 10
+#define CB_TYPE_WRITE_BATCH 11
 struct cjni_callback_info_s /* {{{ */
 {
   char *name;
@@ -95,6 +97,11 @@ static pthread_mutex_t java_callbacks_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static oconfig_item_t *config_block;
 
+/* org/collectd/api/ValueListBatch, looked up once in cjni_init_native. */
+static jclass c_value_list_batch;
+static jmethodID m_value_list_batch_constructor;
+static jmethodID m_value_list_batch_release;
+
 /*
  * Prototypes
  *
@@ -111,6 +118,9 @@ static int cjni_callback_register(JNIEnv *jvm_env, jobject o_name,
 static int cjni_read(user_data_t *user_data);
 static int cjni_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *ud);
+static int cjni_write_batch(const data_set_t *const *ds,
+                            const value_list_t *const *vl, size_t num,
+                            user_data_t *ud);
 static int cjni_flush(cdtime_t timeout, const char *identifier,
                       user_data_t *ud);
 static void cjni_log(int severity, const char *message, user_data_t *ud);
@@ -781,6 +791,112 @@ static jobject ctoj_value_list(JNIEnv *jvm_env, /* {{{ */
   return o_valuelist;
 } /* }}} jobject ctoj_value_list */
 
+/*
+ * Batch transfer
+ *
+ * Many value lists can be passed between C and Java in one direct
+ * java.nio.ByteBuffer, which avoids the object creation and method calls of
+ * ctoj_value_list and jtoc_value_list. The buffer holds one record per value
+ * list, in the byte order of the platform:
+ *
+ *   int32   size of the record in bytes, including this field
+ *   5 x     int16 length and UTF-8 bytes (without terminating null byte) of
+ *           host, plugin, plugin instance, type and type instance
+ *   int64   time in milliseconds
+ *   int64   interval in milliseconds
+ *   int32   number of values
+ *   n x     int8 kind (CJNI_BATCH_LONG or CJNI_BATCH_DOUBLE), followed by
+ *           an int64 or a double
+ *
+ * The Java side of this is org/collectd/api/ValueListBatch.
+ */
+#define CJNI_BATCH_LONG 0
+#define CJNI_BATCH_DOUBLE 1
+
+struct cjni_batch_s /* {{{ */
+{
+  char *data;
+  size_t len;
+  size_t size;
+};
+typedef struct cjni_batch_s cjni_batch_t;
+/* }}} */
+
+static void cjni_batch_put(cjni_batch_t *b, /* {{{ */
+                           const void *data, size_t len) {
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+} /* }}} void cjni_batch_put */
+
+static int cjni_batch_add_value_list(cjni_batch_t *b, /* {{{ */
+                                     const data_set_t *ds,
+                                     const value_list_t *vl) {
+  const char *strings[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                           vl->type_instance};
+
+  if (ds->ds_num != vl->values_len) {
+    ERROR("java plugin: cjni_batch_add_value_list: ds->ds_num = %" PRIsz
+          " != vl->values_len = %" PRIsz ";",
+          ds->ds_num, vl->values_len);
+    return -1;
+  }
+
+  size_t size = sizeof(int32_t) + 2 * sizeof(int64_t) + sizeof(int32_t) +
+                vl->values_len * (sizeof(int8_t) + sizeof(int64_t));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(strings); i++)
+    size += sizeof(int16_t) + strlen(strings[i]);
+
+  if (b->size - b->len < size) {
+    size_t new_size = (b->size == 0) ? 4096 : b->size;
+    while (new_size - b->len < size)
+      new_size *= 2;
+
+    char *tmp = realloc(b->data, new_size);
+    if (tmp == NULL) {
+      ERROR("java plugin: cjni_batch_add_value_list: realloc failed.");
+      return -1;
+    }
+    b->data = tmp;
+    b->size = new_size;
+  }
+
+  cjni_batch_put(b, &(int32_t){(int32_t)size}, sizeof(int32_t));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(strings); i++) {
+    int16_t len = (int16_t)strlen(strings[i]);
+    cjni_batch_put(b, &len, sizeof(len));
+    cjni_batch_put(b, strings[i], (size_t)len);
+  }
+  /* Java measures time in milliseconds. */
+  cjni_batch_put(b, &(int64_t){(int64_t)CDTIME_T_TO_MS(vl->time)},
+                 sizeof(int64_t));
+  cjni_batch_put(b, &(int64_t){(int64_t)CDTIME_T_TO_MS(vl->interval)},
+                 sizeof(int64_t));
+  cjni_batch_put(b, &(int32_t){(int32_t)vl->values_len}, sizeof(int32_t));
+
+  for (size_t i = 0; i < vl->values_len; i++) {
+    int ds_type = ds->ds[i].type;
+
+    if (ds_type == DS_TYPE_GAUGE) {
+      cjni_batch_put(b, &(int8_t){CJNI_BATCH_DOUBLE}, sizeof(int8_t));
+      cjni_batch_put(b, &(double){(double)vl->values[i].gauge},
+                     sizeof(double));
+      continue;
+    }
+
+    int64_t v;
+    if (ds_type == DS_TYPE_COUNTER)
+      v = (int64_t)vl->values[i].counter;
+    else if (ds_type == DS_TYPE_DERIVE)
+      v = (int64_t)vl->values[i].derive;
+    else
+      v = (int64_t)vl->values[i].absolute;
+    cjni_batch_put(b, &(int8_t){CJNI_BATCH_LONG}, sizeof(int8_t));
+    cjni_batch_put(b, &v, sizeof(v));
+  }
+
+  return 0;
+} /* }}} int cjni_batch_add_value_list */
+
 /* Convert a notification_t to a org/collectd/api/Notification */
 static jobject ctoj_notification(JNIEnv *jvm_env, /* {{{ */
                                  const notification_t *n) {
@@ -1160,6 +1276,124 @@ static int jtoc_value_list(JNIEnv *jvm_env, value_list_t *vl, /* {{{ */
   return 0;
 } /* }}} int jtoc_value_list */
 
+/* Reads "len" bytes from the batch record at "*ptr" and advances the
+ * pointer. Returns non-zero if the record is too short. */
+static int cjni_batch_get(const char **ptr, const char *end, /* {{{ */
+                          void *buffer, size_t len) {
+  if ((size_t)(end - *ptr) < len)
+    return -1;
+
+  memcpy(buffer, *ptr, len);
+  *ptr += len;
+  return 0;
+} /* }}} int cjni_batch_get */
+
+/* Like jtoc_string, strings that are too long are truncated. */
+static int cjni_batch_get_string(const char **ptr, const char *end, /* {{{ */
+                                 char *buffer, size_t buffer_size, int empty) {
+  int16_t len;
+
+  if ((cjni_batch_get(ptr, end, &len, sizeof(len)) != 0) || (len < 0) ||
+      (end - *ptr < len))
+    return -1;
+  if ((len == 0) && !empty)
+    return -1;
+
+  size_t copy = ((size_t)len < buffer_size) ? (size_t)len : buffer_size - 1;
+  memcpy(buffer, *ptr, copy);
+  buffer[copy] = 0;
+  *ptr += len;
+  return 0;
+} /* }}} int cjni_batch_get_string */
+
+/* Decodes one record of a batch, see cjni_batch_add_value_list for the
+ * layout. On success, vl->values must be freed by the caller. */
+static int cjni_batch_get_value_list(const char *ptr, /* {{{ */
+                                     const char *end, value_list_t *vl) {
+  const data_set_t *ds;
+  int64_t tmp64;
+  int32_t values_num;
+
+  /* Skip the size of the record. */
+  ptr += sizeof(int32_t);
+
+  if ((cjni_batch_get_string(&ptr, end, vl->host, sizeof(vl->host), 0) != 0) ||
+      (cjni_batch_get_string(&ptr, end, vl->plugin, sizeof(vl->plugin), 0) !=
+       0) ||
+      (cjni_batch_get_string(&ptr, end, vl->plugin_instance,
+                             sizeof(vl->plugin_instance), 1) != 0) ||
+      (cjni_batch_get_string(&ptr, end, vl->type, sizeof(vl->type), 0) != 0) ||
+      (cjni_batch_get_string(&ptr, end, vl->type_instance,
+                             sizeof(vl->type_instance), 1) != 0)) {
+    ERROR("java plugin: cjni_batch_get_value_list: Invalid identifier.");
+    return -1;
+  }
+
+  if (cjni_batch_get(&ptr, end, &tmp64, sizeof(tmp64)) != 0)
+    return -1;
+  /* Java measures time in milliseconds. */
+  vl->time = MS_TO_CDTIME_T(tmp64);
+  if (cjni_batch_get(&ptr, end, &tmp64, sizeof(tmp64)) != 0)
+    return -1;
+  vl->interval = MS_TO_CDTIME_T(tmp64);
+
+  if (cjni_batch_get(&ptr, end, &values_num, sizeof(values_num)) != 0)
+    return -1;
+
+  ds = plugin_get_ds(vl->type);
+  if (ds == NULL) {
+    ERROR("java plugin: cjni_batch_get_value_list: Data-set `%s' is not "
+          "defined. Please consult the types.db(5) manpage for more "
+          "information.",
+          vl->type);
+    return -1;
+  }
+  if ((values_num < 0) || ((size_t)values_num != ds->ds_num)) {
+    ERROR("java plugin: cjni_batch_get_value_list: Data-set `%s' has %" PRIsz
+          " data-sources, but the value list has %i values.",
+          vl->type, ds->ds_num, (int)values_num);
+    return -1;
+  }
+
+  vl->values = calloc(ds->ds_num, sizeof(*vl->values));
+  if (vl->values == NULL) {
+    ERROR("java plugin: cjni_batch_get_value_list: calloc failed.");
+    return -1;
+  }
+  vl->values_len = ds->ds_num;
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    int8_t kind;
+    union {
+      int64_t l;
+      double d;
+    } v;
+
+    if ((cjni_batch_get(&ptr, end, &kind, sizeof(kind)) != 0) ||
+        (cjni_batch_get(&ptr, end, &v, sizeof(v)) != 0) ||
+        ((kind != CJNI_BATCH_LONG) && (kind != CJNI_BATCH_DOUBLE))) {
+      sfree(vl->values);
+      return -1;
+    }
+
+    int ds_type = ds->ds[i].type;
+    if (ds_type == DS_TYPE_GAUGE)
+      vl->values[i].gauge =
+          (kind == CJNI_BATCH_DOUBLE) ? (gauge_t)v.d : (gauge_t)v.l;
+    else if (ds_type == DS_TYPE_COUNTER)
+      vl->values[i].counter =
+          (kind == CJNI_BATCH_DOUBLE) ? (counter_t)v.d : (counter_t)v.l;
+    else if (ds_type == DS_TYPE_DERIVE)
+      vl->values[i].derive =
+          (kind == CJNI_BATCH_DOUBLE) ? (derive_t)v.d : (derive_t)v.l;
+    else
+      vl->values[i].absolute =
+          (kind == CJNI_BATCH_DOUBLE) ? (absolute_t)v.d : (absolute_t)v.l;
+  }
+
+  return 0;
+} /* }}} int cjni_batch_get_value_list */
+
 /* Convert a org/collectd/api/Notification to a notification_t. */
 static int jtoc_notification(JNIEnv *jvm_env, notification_t *n, /* {{{ */
                              jobject object_ptr) {
@@ -1235,6 +1469,74 @@ static jint JNICALL cjni_api_dispatch_values(JNIEnv *jvm_env, /* {{{ */
   return status;
 } /* }}} jint cjni_api_dispatch_values */
 
+static jint JNICALL cjni_api_dispatch_values_batch(JNIEnv *jvm_env, /* {{{ */
+                                                   jobject this,
+                                                   jobject o_buffer,
+                                                   jint length) {
+  const char *data;
+  jlong capacity;
+  value_list_t *vls = NULL;
+  size_t vls_num = 0;
+  size_t vls_size = 0;
+  int status = 0;
+
+  data = (*jvm_env)->GetDirectBufferAddress(jvm_env, o_buffer);
+  capacity = (*jvm_env)->GetDirectBufferCapacity(jvm_env, o_buffer);
+  if ((data == NULL) || (length < 0) || ((jlong)length > capacity)) {
+    ERROR("java plugin: cjni_api_dispatch_values_batch: The buffer is not a "
+          "direct buffer or too small.");
+    return -1;
+  }
+
+  for (const char *ptr = data; ptr < data + length;) {
+    int32_t size;
+
+    if ((cjni_batch_get(&(const char *){ptr}, data + length, &size,
+                        sizeof(size)) != 0) ||
+        (size < (int32_t)sizeof(size)) || (size > data + length - ptr)) {
+      ERROR("java plugin: cjni_api_dispatch_values_batch: Invalid record "
+            "at offset %td.",
+            ptr - data);
+      status = -1;
+      break;
+    }
+
+    if (vls_num == vls_size) {
+      size_t new_size = (vls_size == 0) ? 16 : 2 * vls_size;
+      value_list_t *tmp = realloc(vls, new_size * sizeof(*vls));
+      if (tmp == NULL) {
+        ERROR("java plugin: cjni_api_dispatch_values_batch: realloc failed.");
+        status = -1;
+        break;
+      }
+      vls = tmp;
+      vls_size = new_size;
+    }
+
+    /* Records that cannot be decoded are skipped, the others are still
+     * dispatched. */
+    vls[vls_num] = (value_list_t)VALUE_LIST_INIT;
+    if (cjni_batch_get_value_list(ptr, ptr + size, vls + vls_num) == 0)
+      vls_num++;
+    else
+      status = -1;
+
+    ptr += size;
+  }
+
+  if (vls_num > 0) {
+    int dispatch_status = plugin_dispatch_values_batch(vls, vls_num);
+    if (status == 0)
+      status = dispatch_status;
+  }
+
+  for (size_t i = 0; i < vls_num; i++)
+    sfree(vls[i].values);
+  sfree(vls);
+
+  return status;
+} /* }}} jint cjni_api_dispatch_values_batch */
+
 static jint JNICALL cjni_api_dispatch_notification(JNIEnv *jvm_env, /* {{{ */
                                                    jobject this,
                                                    jobject o_notification) {
@@ -1336,6 +1638,35 @@ static jint JNICALL cjni_api_register_write(JNIEnv *jvm_env, /* {{{ */
   return 0;
 } /* }}} jint cjni_api_register_write */
 
+static jint JNICALL cjni_api_register_write_batch(JNIEnv *jvm_env, /* {{{ */
+                                                  jobject this, jobject o_name,
+                                                  jobject o_write) {
+  cjni_callback_info_t *cbi;
+
+  if (c_value_list_batch == NULL) {
+    ERROR("java plugin: cjni_api_register_write_batch: The class "
+          "\"org.collectd.api.ValueListBatch\" is not available.");
+    return -1;
+  }
+
+  cbi =
+      cjni_callback_info_create(jvm_env, o_name, o_write, CB_TYPE_WRITE_BATCH);
+  if (cbi == NULL)
+    return -1;
+
+  DEBUG("java plugin: Registering new batch write callback: %s", cbi->name);
+
+  plugin_register_write_batch(
+      cbi->name, cjni_write_batch,
+      &(user_data_t){
+          .data = cbi, .free_func = cjni_callback_info_destroy,
+      });
+
+  (*jvm_env)->DeleteLocalRef(jvm_env, o_write);
+
+  return 0;
+} /* }}} jint cjni_api_register_write_batch */
+
 static jint JNICALL cjni_api_register_flush(JNIEnv *jvm_env, /* {{{ */
                                             jobject this, jobject o_name,
                                             jobject o_flush) {
@@ -1509,6 +1840,9 @@ static JNINativeMethod jni_api_functions[] = /* {{{ */
         {"dispatchValues", "(Lorg/collectd/api/ValueList;)I",
          cjni_api_dispatch_values},
 
+        {"dispatchValuesBatch", "(Ljava/nio/ByteBuffer;I)I",
+         cjni_api_dispatch_values_batch},
+
         {"dispatchNotification", "(Lorg/collectd/api/Notification;)I",
          cjni_api_dispatch_notification},
 
@@ -1531,6 +1865,10 @@ static JNINativeMethod jni_api_functions[] = /* {{{ */
          "(Ljava/lang/String;Lorg/collectd/api/CollectdWriteInterface;)I",
          cjni_api_register_write},
 
+        {"registerWriteBatch",
+         "(Ljava/lang/String;Lorg/collectd/api/CollectdWriteBatchInterface;)I",
+         cjni_api_register_write_batch},
+
         {"registerFlush",
          "(Ljava/lang/String;Lorg/collectd/api/CollectdFlushInterface;)I",
          cjni_api_register_flush},
@@ -1598,6 +1936,11 @@ cjni_callback_info_create(JNIEnv *jvm_env, /* {{{ */
     method_signature = "(Lorg/collectd/api/ValueList;)I";
     break;
 
+  case CB_TYPE_WRITE_BATCH:
+    method_name = "writeBatch";
+    method_signature = "(Lorg/collectd/api/ValueListBatch;)I";
+    break;
+
   case CB_TYPE_FLUSH:
     method_name = "flush";
     method_signature = "(Ljava/lang/Number;Ljava/lang/String;)I";
@@ -1808,6 +2151,25 @@ static int cjni_init_native(JNIEnv *jvm_env) /* {{{ */
     return -1;
   }
 
+  /* Without this class, batch write callbacks cannot be registered. The rest
+   * of the API works regardless. */
+  jclass c_batch =
+      (*jvm_env)->FindClass(jvm_env, "org/collectd/api/ValueListBatch");
+  if (c_batch != NULL) {
+    m_value_list_batch_constructor = (*jvm_env)->GetMethodID(
+        jvm_env, c_batch, "<init>", "(Ljava/nio/ByteBuffer;I)V");
+    m_value_list_batch_release =
+        (*jvm_env)->GetMethodID(jvm_env, c_batch, "release", "()V");
+    if ((m_value_list_batch_constructor != NULL) &&
+        (m_value_list_batch_release != NULL))
+      c_value_list_batch = (*jvm_env)->NewGlobalRef(jvm_env, c_batch);
+  }
+  if (c_value_list_batch == NULL) {
+    (*jvm_env)->ExceptionClear(jvm_env);
+    WARNING("cjni_init_native: Cannot find the class \"org.collectd.api"
+            ".ValueListBatch\". Batch write callbacks are not available.");
+  }
+
   return 0;
 } /* }}} int cjni_init_native */
 
@@ -2348,6 +2710,93 @@ static int cjni_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   return ret_status;
 } /* }}} int cjni_write */
 
+/* Call the CB_TYPE_WRITE_BATCH callback pointed to by the `user_data_t'
+ * pointer. */
+static int cjni_write_batch(const data_set_t *const *ds, /* {{{ */
+                            const value_list_t *const *vl, size_t num,
+                            user_data_t *ud) {
+  JNIEnv *jvm_env;
+  cjni_callback_info_t *cbi;
+  cjni_batch_t batch = {0};
+  jobject o_buffer;
+  jobject o_batch;
+  int ret_status;
+
+  if (jvm == NULL) {
+    ERROR("java plugin: cjni_write_batch: jvm == NULL");
+    return -1;
+  }
+
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("java plugin: cjni_write_batch: Invalid user data.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    if (cjni_batch_add_value_list(&batch, ds[i], vl[i]) != 0) {
+      ERROR("java plugin: cjni_write_batch: cjni_batch_add_value_list "
+            "failed.");
+      sfree(batch.data);
+      return -1;
+    }
+  }
+  if (batch.len == 0)
+    return 0;
+
+  jvm_env = cjni_thread_attach();
+  if (jvm_env == NULL) {
+    sfree(batch.data);
+    return -1;
+  }
+
+  cbi = (cjni_callback_info_t *)ud->data;
+
+  o_buffer =
+      (*jvm_env)->NewDirectByteBuffer(jvm_env, batch.data, (jlong)batch.len);
+  if (o_buffer == NULL) {
+    ERROR("java plugin: cjni_write_batch: NewDirectByteBuffer failed.");
+    cjni_thread_detach();
+    sfree(batch.data);
+    return -1;
+  }
+
+  o_batch = (*jvm_env)->NewObject(jvm_env, c_value_list_batch,
+                                  m_value_list_batch_constructor, o_buffer,
+                                  (jint)num);
+  if (o_batch == NULL) {
+    ERROR("java plugin: cjni_write_batch: Creating a ValueListBatch object "
+          "failed.");
+    (*jvm_env)->DeleteLocalRef(jvm_env, o_buffer);
+    cjni_thread_detach();
+    sfree(batch.data);
+    return -1;
+  }
+
+  ret_status =
+      (*jvm_env)->CallIntMethod(jvm_env, cbi->object, cbi->method, o_batch);
+
+  /* No other JNI function may be called while an exception is pending. */
+  if ((*jvm_env)->ExceptionCheck(jvm_env)) {
+    ERROR("java plugin: cjni_write_batch: The write callback \"%s\" threw an "
+          "exception.",
+          cbi->name);
+    (*jvm_env)->ExceptionDescribe(jvm_env);
+    (*jvm_env)->ExceptionClear(jvm_env);
+    ret_status = -1;
+  }
+
+  /* The memory behind the buffer is freed below, so Java code that kept a
+   * reference to the batch must not be able to access it any longer. */
+  (*jvm_env)->CallVoidMethod(jvm_env, o_batch, m_value_list_batch_release);
+
+  (*jvm_env)->DeleteLocalRef(jvm_env, o_batch);
+  (*jvm_env)->DeleteLocalRef(jvm_env, o_buffer);
+
+  cjni_thread_detach();
+  sfree(batch.data);
+  return ret_status;
+} /* }}} int cjni_write_batch */
+
 /* Call the CB_TYPE_FLUSH callback pointed to by the `user_data_t' pointer. */
 static int cjni_flush(cdtime_t timeout, const char *identifier, /* {{{ */
                       user_data_t *ud) {
@@ -2684,6 +3133,7 @@ static int cjni_match_target_invoke(const data_set_t *ds, /* {{{ */
       /* plugin_dispatch_values assures that this is dynamically allocated
        * memory. */
       sfree(vl->values);
+      ident_reset(vl);
 
       /* This will replace the vl->values pointer to a new, dynamically
        * allocated piece of memory. */
@@ -2837,6 +3287,6 @@ static int cjni_init(void) /* {{{ */
 
 void module_register(void) {
   plugin_register_complex_config("java", cjni_config_callback);
-  plugin_register_init("java", cjni_init);
+  plugin_register_parallel_init("java", cjni_init);
   plugin_register_shutdown("java", cjni_shutdown);
 } /* void module_register (void) */
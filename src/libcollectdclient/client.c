@@ -54,6 +54,7 @@
 #endif
 
 #include "collectd/client.h"
+#include "globals.h"
 
 /* NI_MAXHOST has been obsoleted by RFC 3493 which is a reason for SunOS 5.11
  * to no longer define it. We'll use the old, RFC 2553 value here. */
@@ -110,6 +111,9 @@
 struct lcc_connection_s {
   FILE *fh;
   char errbuf[2048];
+  /* Maximum number of commands lcc_putval_batch() sends before reading the
+   * responses. */
+  size_t max_in_flight;
 };
 
 struct lcc_response_s {
@@ -703,6 +707,8 @@ int lcc_getval(lcc_connection_t *c, lcc_identifier_t *ident, /* {{{ */
     }
   } /* for (i = 0; i < res.lines_num; i++) */
 
+#undef BAIL_OUT
+
   if (ret_values_num != NULL)
     *ret_values_num = values_num;
   if (ret_values != NULL)
@@ -715,16 +721,155 @@ int lcc_getval(lcc_connection_t *c, lcc_identifier_t *ident, /* {{{ */
   return 0;
 } /* }}} int lcc_getval */
 
-int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
-{
+int lcc_getrange(lcc_connection_t *c, lcc_identifier_t *ident, /* {{{ */
+                 double start, double end, size_t *ret_points_num,
+                 double **ret_times, size_t *ret_values_num,
+                 gauge_t **ret_values, char ***ret_values_names) {
   char ident_str[6 * LCC_NAME_LEN];
   char ident_esc[12 * LCC_NAME_LEN];
-  char command[1024] = "";
+  char command[14 * LCC_NAME_LEN];
+  char range[64] = "";
+
   lcc_response_t res;
+  size_t points_num;
+  size_t values_num = 0;
+  double *times = NULL;
+  gauge_t *values = NULL;
+  char **values_names = NULL;
+
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  if ((ident == NULL) || (ret_points_num == NULL) || (ret_times == NULL) ||
+      (ret_values_num == NULL) || (ret_values == NULL)) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  status = lcc_identifier_to_string(c, ident_str, sizeof(ident_str), ident);
+  if (status != 0)
+    return status;
+
+  if (start != 0.0)
+    snprintf(range, sizeof(range), " start=%.3f", start);
+  if (end != 0.0)
+    snprintf(range + strlen(range), sizeof(range) - strlen(range),
+             " end=%.3f", end);
+
+  snprintf(command, sizeof(command), "GETRANGE %s%s",
+           lcc_strescape(ident_esc, ident_str, sizeof(ident_esc)), range);
+  command[sizeof(command) - 1] = '\0';
+
+  status = lcc_sendreceive(c, command, &res);
+  if (status != 0)
+    return status;
+
+  if (res.status != 0) {
+    LCC_SET_ERRSTR(c, "Server error: %s", res.message);
+    lcc_response_free(&res);
+    return -1;
+  }
+
+  points_num = res.lines_num;
+
+#define BAIL_OUT(e)                                                            \
+  do {                                                                         \
+    lcc_set_errno(c, (e));                                                     \
+    free(times);                                                               \
+    free(values);                                                              \
+    if (values_names != NULL) {                                                \
+      for (size_t j = 0; j < values_num; j++) {                                \
+        free(values_names[j]);                                                 \
+      }                                                                        \
+    }                                                                          \
+    free(values_names);                                                        \
+    lcc_response_free(&res);                                                   \
+    return -1;                                                                 \
+  } while (0)
+
+  /* Each line is the time followed by one "name=value" field per data
+   * source. */
+  if (points_num > 0) {
+    for (char *ptr = strchr(res.lines[0], '='); ptr != NULL;
+         ptr = strchr(ptr + 1, '='))
+      values_num++;
+    if (values_num == 0)
+      BAIL_OUT(EILSEQ);
+  }
+
+  times = calloc(points_num + 1, sizeof(*times));
+  values = calloc(points_num * values_num + 1, sizeof(*values));
+  if ((times == NULL) || (values == NULL))
+    BAIL_OUT(ENOMEM);
+
+  if (ret_values_names != NULL) {
+    values_names = calloc(values_num + 1, sizeof(*values_names));
+    if (values_names == NULL)
+      BAIL_OUT(ENOMEM);
+  }
+
+  for (size_t i = 0; i < points_num; i++) {
+    char *ptr = res.lines[i];
+    char *endptr = NULL;
+
+    errno = 0;
+    times[i] = strtod(ptr, &endptr);
+    if ((endptr == ptr) || (errno != 0))
+      BAIL_OUT(EILSEQ);
+    ptr = endptr;
+
+    for (size_t j = 0; j < values_num; j++) {
+      while (*ptr == ' ')
+        ptr++;
+
+      char *key = ptr;
+      char *value = strchr(key, '=');
+      if (value == NULL)
+        BAIL_OUT(EILSEQ);
+      *value = 0;
+      value++;
+
+      endptr = NULL;
+      errno = 0;
+      values[i * values_num + j] = strtod(value, &endptr);
+      if ((endptr == value) || (errno != 0))
+        BAIL_OUT(EILSEQ);
+      ptr = endptr;
+
+      if ((values_names != NULL) && (i == 0)) {
+        values_names[j] = strdup(key);
+        if (values_names[j] == NULL)
+          BAIL_OUT(ENOMEM);
+      }
+    }
+  } /* for (i = 0; i < points_num; i++) */
+
+#undef BAIL_OUT
+
+  *ret_points_num = points_num;
+  *ret_times = times;
+  *ret_values_num = values_num;
+  *ret_values = values;
+  if (ret_values_names != NULL)
+    *ret_values_names = values_names;
+
+  lcc_response_free(&res);
+
+  return 0;
+} /* }}} int lcc_getrange */
+
+static int lcc_format_putval(lcc_connection_t *c, /* {{{ */
+                             char *ret_command, size_t ret_command_size,
+                             const lcc_value_list_t *vl) {
+  char ident_str[6 * LCC_NAME_LEN];
+  char ident_esc[12 * LCC_NAME_LEN];
+  char command[1024] = "";
   int status;
 
-  if ((c == NULL) || (vl == NULL) || (vl->values_len < 1) ||
-      (vl->values == NULL) || (vl->values_types == NULL)) {
+  if ((vl == NULL) || (vl->values_len < 1) || (vl->values == NULL) ||
+      (vl->values_types == NULL)) {
     lcc_set_errno(c, EINVAL);
     return -1;
   }
@@ -760,6 +905,25 @@ int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
 
   } /* for (i = 0; i < vl->values_len; i++) */
 
+  snprintf(ret_command, ret_command_size, "%s", command);
+  return 0;
+} /* }}} int lcc_format_putval */
+
+int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
+{
+  char command[1024] = "";
+  lcc_response_t res;
+  int status;
+
+  if (c == NULL) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  status = lcc_format_putval(c, command, sizeof(command), vl);
+  if (status != 0)
+    return status;
+
   status = lcc_sendreceive(c, command, &res);
   if (status != 0)
     return status;
@@ -774,6 +938,87 @@ int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
   return 0;
 } /* }}} int lcc_putval */
 
+int lcc_putval_batch(lcc_connection_t *c, /* {{{ */
+                     const lcc_value_list_t *vls, size_t vls_num) {
+  /* "Server error: " and a response message */
+  char first_error[1040] = "";
+  size_t failed = 0;
+
+  if ((c == NULL) || ((vls == NULL) && (vls_num > 0))) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+  if (c->fh == NULL) {
+    lcc_set_errno(c, EBADF);
+    return -1;
+  }
+
+  size_t max_in_flight =
+      (c->max_in_flight > 0) ? c->max_in_flight : LCC_MAX_IN_FLIGHT_DEFAULT;
+
+  /* Send up to "max_in_flight" commands with one write, then read their
+   * responses. Limiting the number of outstanding responses makes sure that
+   * the server never blocks writing responses we do not read. */
+  for (size_t offset = 0; offset < vls_num; offset += max_in_flight) {
+    size_t num = vls_num - offset;
+    if (num > max_in_flight)
+      num = max_in_flight;
+
+    size_t in_flight = 0;
+    for (size_t i = 0; i < num; i++) {
+      char command[1024];
+
+      if (lcc_format_putval(c, command, sizeof(command), vls + offset + i) !=
+          0) {
+        if (failed == 0)
+          SSTRCPY(first_error, c->errbuf);
+        failed++;
+        continue;
+      }
+
+      lcc_tracef("send:    --> %s\n", command);
+      if (fprintf(c->fh, "%s\r\n", command) < 0) {
+        lcc_set_errno(c, errno);
+        return -1;
+      }
+      in_flight++;
+    }
+    if (fflush(c->fh) != 0) {
+      lcc_set_errno(c, errno);
+      return -1;
+    }
+
+    for (size_t i = 0; i < in_flight; i++) {
+      lcc_response_t res = {0};
+
+      if (lcc_receive(c, &res) != 0)
+        return -1;
+      if ((res.status != 0) && (failed++ == 0))
+        snprintf(first_error, sizeof(first_error), "Server error: %s",
+                 res.message);
+      lcc_response_free(&res);
+    }
+  }
+
+  if (failed > 0) {
+    LCC_SET_ERRSTR(c,
+                   "%" PRIsz " of %" PRIsz " values failed. First error: %s",
+                   failed, vls_num, first_error);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int lcc_putval_batch */
+
+int lcc_set_max_in_flight(lcc_connection_t *c, size_t num) /* {{{ */
+{
+  if (c == NULL)
+    return -1;
+
+  c->max_in_flight = num;
+  return 0;
+} /* }}} int lcc_set_max_in_flight */
+
 int lcc_flush(lcc_connection_t *c, const char *plugin, /* {{{ */
               lcc_identifier_t *ident, int timeout) {
   char command[1024] = "";
@@ -822,6 +1067,30 @@ int lcc_flush(lcc_connection_t *c, const char *plugin, /* {{{ */
   return 0;
 } /* }}} int lcc_flush */
 
+int lcc_reload(lcc_connection_t *c) /* {{{ */
+{
+  lcc_response_t res;
+  int status;
+
+  if (c == NULL) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  status = lcc_sendreceive(c, "RELOAD", &res);
+  if (status != 0)
+    return status;
+
+  if (res.status != 0) {
+    LCC_SET_ERRSTR(c, "Server error: %s", res.message);
+    lcc_response_free(&res);
+    return -1;
+  }
+
+  lcc_response_free(&res);
+  return 0;
+} /* }}} int lcc_reload */
+
 /* TODO: Implement lcc_putnotif */
 
 int lcc_listval(lcc_connection_t *c, /* {{{ */
@@ -64,11 +64,34 @@ int lcc_getval(lcc_connection_t *c, lcc_identifier_t *ident,
                size_t *ret_values_num, gauge_t **ret_values,
                char ***ret_values_names);
 
+/* lcc_getrange returns the rates the daemon keeps for "ident" between "start"
+ * and "end", in seconds since the epoch. Negative times are relative to the
+ * current time and zero leaves the respective end of the range open. The
+ * values are returned row by row, "ret_values_num" per point. */
+int lcc_getrange(lcc_connection_t *c, lcc_identifier_t *ident, double start,
+                 double end, size_t *ret_points_num, double **ret_times,
+                 size_t *ret_values_num, gauge_t **ret_values,
+                 char ***ret_values_names);
+
 int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl);
 
+/* lcc_putval_batch sends the value lists like lcc_putval, but writes up to
+ * "max in flight" commands before reading their responses. Returns zero if
+ * all values have been accepted. */
+int lcc_putval_batch(lcc_connection_t *c, const lcc_value_list_t *vls,
+                     size_t vls_num);
+
+/* Default number of commands lcc_putval_batch sends before reading the
+ * responses. */
+#define LCC_MAX_IN_FLIGHT_DEFAULT 128
+int lcc_set_max_in_flight(lcc_connection_t *c, size_t num);
+
 int lcc_flush(lcc_connection_t *c, const char *plugin, lcc_identifier_t *ident,
               int timeout);
 
+/* Asks the daemon to reload its configuration file. */
+int lcc_reload(lcc_connection_t *c);
+
 int lcc_listval(lcc_connection_t *c, lcc_identifier_t **ret_ident,
                 size_t *ret_ident_num);
 
@@ -49,6 +49,18 @@ typedef struct lcc_server_s lcc_server_t;
 enum lcc_security_level_e { NONE, SIGN, ENCRYPT };
 typedef enum lcc_security_level_e lcc_security_level_t;
 
+/* LCC_PROTOCOL_TCP sends each packet preceded by its length as a 32 bit
+ * integer in network byte order, as expected by the network plugin's TCP
+ * transport. */
+enum lcc_protocol_e { LCC_PROTOCOL_UDP, LCC_PROTOCOL_TCP };
+typedef enum lcc_protocol_e lcc_protocol_t;
+
+/* Size of the packets sent over TCP. */
+#define LCC_NETWORK_TCP_BUFFER_SIZE 65535
+
+/* Largest number of packets sent together, see lcc_server_set_send_batch(). */
+#define LCC_NETWORK_SEND_BATCH_MAX 1024
+
 /*
  * Create / destroy object
  */
@@ -67,11 +79,23 @@ int lcc_server_set_ttl(lcc_server_t *srv, uint8_t ttl);
 int lcc_server_set_interface(lcc_server_t *srv, char const *iface);
 int lcc_server_set_security_level(lcc_server_t *srv, lcc_security_level_t level,
                                   const char *username, const char *password);
+/* Values that have not been sent yet are discarded when changing the
+ * protocol. */
+int lcc_server_set_protocol(lcc_server_t *srv, lcc_protocol_t protocol);
+/* UDP only: keeps up to `num' full packets and sends them with a single
+ * sendmmsg(2) call where available. They are also sent by
+ * lcc_network_flush(). Zero or one sends every packet right away, which is
+ * the default. */
+int lcc_server_set_send_batch(lcc_server_t *srv, size_t num);
 
 /*
  * Send data
  */
+/* Returns non-zero if adding the values or sending a full packet to one of the
+ * servers failed. */
 int lcc_network_values_send(lcc_network_t *net, const lcc_value_list_t *vl);
+/* Sends the values that have been buffered by lcc_network_values_send(). */
+int lcc_network_flush(lcc_network_t *net);
 #if 0
 int lcc_network_notification_send (lcc_network_t *net,
     const lcc_notification_t *notif);
@@ -0,0 +1,71 @@
+/**
+ * collectd - src/libcollectdclient/collectd/shm.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef LIBCOLLECTD_SHM_H
+#define LIBCOLLECTD_SHM_H 1
+
+#include "collectd/lcc_features.h"
+#include "collectd/types.h"
+
+/* Submits values to the "shm" plugin through a ring in shared memory, which
+ * costs no system call per value while the daemon keeps up. Identifiers are
+ * interned once with lcc_shm_intern(); the values are then written as binary
+ * records referring to the identifier's number.
+ *
+ * A connection has a single producer: threads submitting values concurrently
+ * have to use a connection each, or serialize their calls. */
+
+LCC_BEGIN_DECLS
+
+struct lcc_shm_s;
+typedef struct lcc_shm_s lcc_shm_t;
+
+/* Connects to the UNIX socket of the "shm" plugin at "path". Returns NULL and
+ * sets errno upon failure. */
+lcc_shm_t *lcc_shm_connect(const char *path);
+
+/* Closes the connection. Values written before are still read by the daemon.
+ */
+void lcc_shm_disconnect(lcc_shm_t *s);
+
+/* Defines "ident" and stores its number in "ret_id". The type has to be
+ * known to the daemon. Interning the same identifier again returns the
+ * same number. */
+int lcc_shm_intern(lcc_shm_t *s, const lcc_identifier_t *ident,
+                   uint32_t *ret_id);
+
+/* Writes the values of the identifier "id". "time" and "interval" are in
+ * seconds; zero means "now" and the default interval. "values_len" has to
+ * match the data sources of the identifier's type.
+ *
+ * Returns zero upon success, EAGAIN if the ring is full, or another error
+ * number. */
+int lcc_shm_put(lcc_shm_t *s, uint32_t id, double time, double interval,
+                const value_t *values, size_t values_len);
+
+/* Like lcc_shm_put(), interning the identifier of "vl" as necessary. */
+int lcc_shm_putval(lcc_shm_t *s, const lcc_value_list_t *vl);
+
+LCC_END_DECLS
+
+#endif /* LIBCOLLECTD_SHM_H */
@@ -0,0 +1,103 @@
+/**
+ * collectd - src/libcollectdclient/collectd/shm_ring.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef LIBCOLLECTD_SHM_RING_H
+#define LIBCOLLECTD_SHM_RING_H 1
+
+#include <stdint.h>
+
+/* Layout of the rings shared by the "shm" plugin and the lcc_shm_*()
+ * functions. This header doesn't depend on any other so that the daemon can
+ * include it, too.
+ *
+ * The plugin creates one ring per connection to its UNIX socket and sends the
+ * memfd holding it and an eventfd "doorbell" to the client. The ring has a
+ * single producer, which only writes "head", and a single consumer, which
+ * only writes "tail". Both count bytes and never wrap; offsets into the data
+ * area are taken modulo its size. Records are aligned to eight bytes and
+ * never cross the end of the data area: the producer fills the space left at
+ * the end with a padding record instead.
+ *
+ * Before sleeping, the consumer sets "waiting" and checks "head" once more.
+ * After publishing a record, the producer rings the doorbell only if it
+ * resets "waiting", so a consumer that keeps up is never woken by a system
+ * call. */
+
+#define LCC_SHM_MAGIC 0x31636f6c6c736d68ULL
+#define LCC_SHM_VERSION 1
+
+/* Padding up to the end of the data area. */
+#define LCC_SHM_RECORD_PAD 0
+/* Defines identifier "id". The record header is followed by the identifier as
+ * a null-terminated string, "host/plugin[-instance]/type[-instance]". */
+#define LCC_SHM_RECORD_IDENT 1
+/* Values of identifier "id". The record header is followed by a
+ * lcc_shm_values_t and "values_num" 64 bit values. */
+#define LCC_SHM_RECORD_VALUES 2
+
+#define LCC_SHM_ALIGN(n) (((n) + 7) & ~((uint64_t)7))
+
+/* The header of the shared memory. The data area starts at "data_offset". */
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t data_offset;
+  /* Size of the data area, a power of two. */
+  uint64_t size;
+  uint8_t pad0[40];
+
+  /* Written by the producer. */
+  uint64_t head;
+  uint8_t pad1[56];
+
+  /* Written by the consumer. */
+  uint64_t tail;
+  uint32_t waiting;
+  uint8_t pad2[52];
+} lcc_shm_ring_t;
+
+typedef struct {
+  /* Length of the whole record, including this header and padding. */
+  uint32_t len;
+  uint16_t type;
+  uint16_t values_num;
+  uint32_t id;
+  uint32_t reserved;
+} lcc_shm_record_t;
+
+typedef struct {
+  /* In the daemon's cdtime_t format. Zero means "now" and the default
+   * interval, respectively. */
+  uint64_t time;
+  uint64_t interval;
+} lcc_shm_values_t;
+
+/* Sent along with the file descriptors of the ring and the doorbell. */
+typedef struct {
+  uint32_t version;
+  uint32_t reserved;
+  /* Size of the shared memory, including the header. */
+  uint64_t map_size;
+} lcc_shm_hello_t;
+
+#endif /* LIBCOLLECTD_SHM_RING_H */
@@ -26,6 +26,8 @@
  *   Max Henkel <henkel at gmx.at>
  **/
 
+#define _GNU_SOURCE /* For sendmmsg(2) */
+
 #include "collectd.h"
 
 #include <assert.h>
@@ -38,6 +40,11 @@
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
 
 #if HAVE_NETINET_IN_H
 #include <netinet/in.h>
@@ -51,6 +58,10 @@
 #define AI_ADDRCONFIG 0
 #endif
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 #include "collectd/network.h"
 #include "collectd/network_buffer.h"
 
@@ -69,12 +80,28 @@ struct lcc_server_s {
   lcc_security_level_t security_level;
   char *username;
   char *password;
+  lcc_protocol_t protocol;
 
   int fd;
   struct sockaddr *sa;
   socklen_t sa_len;
 
   lcc_network_buffer_t *buffer;
+  /* Number of value lists in `buffer'. */
+  size_t buffer_values;
+  /* TCP only: the length of a packet followed by the packet. */
+  char *frame;
+
+  /* UDP only: packets waiting to be sent together, see
+   * lcc_server_set_send_batch(). `batch_iov[i]' points to the i-th packet in
+   * `batch'. */
+  char *batch;
+  struct iovec *batch_iov;
+#if HAVE_SENDMMSG
+  struct mmsghdr *batch_msgs;
+#endif
+  size_t batch_size;
+  size_t batch_num;
 
   lcc_server_t *next;
 };
@@ -110,6 +137,13 @@ static void int_server_destroy(lcc_server_t *srv) /* {{{ */
 
   next = srv->next;
 
+  lcc_network_buffer_destroy(srv->buffer);
+  free(srv->frame);
+  free(srv->batch);
+  free(srv->batch_iov);
+#if HAVE_SENDMMSG
+  free(srv->batch_msgs);
+#endif
   free(srv->node);
   free(srv->service);
   free(srv->username);
@@ -130,9 +164,10 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
   if (srv->fd >= 0)
     server_close_socket(srv);
 
+  bool stream = (srv->protocol == LCC_PROTOCOL_TCP);
   struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
                               .ai_flags = AI_ADDRCONFIG,
-                              .ai_socktype = SOCK_DGRAM};
+                              .ai_socktype = stream ? SOCK_STREAM : SOCK_DGRAM};
 
   status = getaddrinfo(srv->node, srv->service, &ai_hints, &ai_list);
   if (status != 0)
@@ -146,7 +181,16 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
     if (srv->fd < 0)
       continue;
 
-    if (ai_ptr->ai_family == AF_INET) {
+    status = 0;
+    if (stream) {
+      /* The TTL of TCP connections is only changed when it has been set. */
+      if ((srv->ttl > 0) && (ai_ptr->ai_family == AF_INET))
+        setsockopt(srv->fd, IPPROTO_IP, IP_TTL, &srv->ttl, sizeof(srv->ttl));
+      else if ((srv->ttl > 0) && (ai_ptr->ai_family == AF_INET6))
+        setsockopt(srv->fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &srv->ttl,
+                   sizeof(srv->ttl));
+      status = connect(srv->fd, ai_ptr->ai_addr, ai_ptr->ai_addrlen);
+    } else if (ai_ptr->ai_family == AF_INET) {
       struct sockaddr_in *addr = (struct sockaddr_in *)ai_ptr->ai_addr;
       int optname;
 
@@ -172,7 +216,7 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
                           sizeof(srv->ttl));
     }
     if (status != 0) {
-      /* setsockopt failed. */
+      /* setsockopt or connect failed. */
       close(srv->fd);
       srv->fd = -1;
       continue;
@@ -197,19 +241,107 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
   return 0;
 } /* }}} int server_open_socket */
 
+/* Writes the packet in `srv->frame', preceded by its length, to the TCP
+ * connection. The connection is closed on failure and opened again by the
+ * next send. */
+static int server_send_frame(lcc_server_t *srv, size_t packet_size) /* {{{ */
+{
+  uint32_t len = htonl((uint32_t)packet_size);
+  memcpy(srv->frame, &len, sizeof(len));
+
+  char const *ptr = srv->frame;
+  size_t left = sizeof(len) + packet_size;
+  while (left > 0) {
+    ssize_t status = send(srv->fd, ptr, left, MSG_NOSIGNAL);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+      int err = errno;
+      server_close_socket(srv);
+      return err;
+    }
+    ptr += status;
+    left -= (size_t)status;
+  }
+
+  return 0;
+} /* }}} int server_send_frame */
+
+/* Sends the packets collected in `srv->batch', with one system call where
+ * sendmmsg(2) is available. The packets are dropped if sending fails. */
+static int server_send_batch(lcc_server_t *srv) /* {{{ */
+{
+  size_t num = srv->batch_num;
+  srv->batch_num = 0;
+
+  if (num == 0)
+    return 0;
+  if (srv->fd < 0)
+    return -1;
+
+#if HAVE_SENDMMSG
+  size_t sent = 0;
+  while (sent < num) {
+    memset(srv->batch_msgs, 0, (num - sent) * sizeof(*srv->batch_msgs));
+    for (size_t i = sent; i < num; i++) {
+      struct mmsghdr *msg = srv->batch_msgs + (i - sent);
+      msg->msg_hdr.msg_name = srv->sa;
+      msg->msg_hdr.msg_namelen = srv->sa_len;
+      msg->msg_hdr.msg_iov = srv->batch_iov + i;
+      msg->msg_hdr.msg_iovlen = 1;
+    }
+
+    int status = sendmmsg(srv->fd, srv->batch_msgs, (unsigned int)(num - sent),
+                          /* flags = */ 0);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+      return -1;
+    }
+    sent += (size_t)status;
+  }
+  return 0;
+#else
+  int ret = 0;
+  for (size_t i = 0; i < num; i++) {
+    while (sendto(srv->fd, srv->batch_iov[i].iov_base, srv->batch_iov[i].iov_len,
+                  /* flags = */ 0, srv->sa, srv->sa_len) < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+      ret = -1;
+      break;
+    }
+  }
+  return ret;
+#endif
+} /* }}} int server_send_batch */
+
 static int server_send_buffer(lcc_server_t *srv) /* {{{ */
 {
   char buffer[LCC_NETWORK_BUFFER_SIZE_DEFAULT] = {0};
+  char *data = buffer;
+  size_t data_size = sizeof(buffer);
   size_t buffer_size;
   int status;
 
+  if (srv->protocol == LCC_PROTOCOL_TCP) {
+    data = srv->frame + sizeof(uint32_t);
+    data_size = LCC_NETWORK_TCP_BUFFER_SIZE;
+  } else if (srv->batch_size > 0) {
+    data = srv->batch_iov[srv->batch_num].iov_base;
+  }
+
+  srv->buffer_values = 0;
+
   if (srv->fd < 0) {
     status = server_open_socket(srv);
-    if (status != 0)
+    if (status != 0) {
+      lcc_network_buffer_initialize(srv->buffer);
       return status;
+    }
   }
 
-  buffer_size = sizeof(buffer);
+  buffer_size = data_size;
 
   status = lcc_network_buffer_finalize(srv->buffer);
   if (status != 0) {
@@ -217,14 +349,24 @@ static int server_send_buffer(lcc_server_t *srv) /* {{{ */
     return status;
   }
 
-  status = lcc_network_buffer_get(srv->buffer, buffer, &buffer_size);
+  status = lcc_network_buffer_get(srv->buffer, data, &buffer_size);
   lcc_network_buffer_initialize(srv->buffer);
 
   if (status != 0)
     return status;
 
-  if (buffer_size > sizeof(buffer))
-    buffer_size = sizeof(buffer);
+  if (buffer_size > data_size)
+    buffer_size = data_size;
+
+  if (srv->protocol == LCC_PROTOCOL_TCP)
+    return server_send_frame(srv, buffer_size);
+
+  if (srv->batch_size > 0) {
+    srv->batch_iov[srv->batch_num++].iov_len = buffer_size;
+    if (srv->batch_num < srv->batch_size)
+      return 0;
+    return server_send_batch(srv);
+  }
 
   while (42) {
     assert(srv->fd >= 0);
@@ -247,11 +389,18 @@ static int server_value_add(lcc_server_t *srv, /* {{{ */
   int status;
 
   status = lcc_network_buffer_add_value(srv->buffer, vl);
-  if (status == 0)
+  if (status == 0) {
+    srv->buffer_values++;
     return 0;
+  }
 
-  server_send_buffer(srv);
-  return lcc_network_buffer_add_value(srv->buffer, vl);
+  /* The values of the full buffer are lost if sending it fails, `vl' is
+   * not. */
+  int send_status = server_send_buffer(srv);
+  status = lcc_network_buffer_add_value(srv->buffer, vl);
+  if (status == 0)
+    srv->buffer_values++;
+  return (status != 0) ? status : send_status;
 } /* }}} int server_value_add */
 
 /*
@@ -436,17 +585,151 @@ int lcc_server_set_interface(lcc_server_t *srv, char const *iface) /* {{{ */
 int lcc_server_set_security_level(lcc_server_t *srv, /* {{{ */
                                   lcc_security_level_t level,
                                   const char *username, const char *password) {
-  return lcc_network_buffer_set_security_level(srv->buffer, level, username,
-                                               password);
+  int status = lcc_network_buffer_set_security_level(srv->buffer, level,
+                                                     username, password);
+  if (status != 0)
+    return status;
+
+  /* Remember the settings for lcc_server_set_protocol(). */
+  free(srv->username);
+  free(srv->password);
+  srv->username = (level != NONE) ? strdup(username) : NULL;
+  srv->password = (level != NONE) ? strdup(password) : NULL;
+  srv->security_level = level;
+  srv->buffer_values = 0;
+  return 0;
 } /* }}} int lcc_server_set_security_level */
 
+int lcc_server_set_protocol(lcc_server_t *srv, /* {{{ */
+                            lcc_protocol_t protocol) {
+  if (srv == NULL)
+    return EINVAL;
+  if ((protocol != LCC_PROTOCOL_UDP) && (protocol != LCC_PROTOCOL_TCP))
+    return EINVAL;
+  if (protocol == srv->protocol)
+    return 0;
+
+  size_t size = (protocol == LCC_PROTOCOL_TCP) ? LCC_NETWORK_TCP_BUFFER_SIZE
+                                               : LCC_NETWORK_BUFFER_SIZE_DEFAULT;
+  lcc_network_buffer_t *buffer = lcc_network_buffer_create(size);
+  if (buffer == NULL)
+    return ENOMEM;
+
+  if (srv->security_level != NONE) {
+    int status = lcc_network_buffer_set_security_level(
+        buffer, srv->security_level, srv->username, srv->password);
+    if (status != 0) {
+      lcc_network_buffer_destroy(buffer);
+      return status;
+    }
+  }
+
+  char *frame = NULL;
+  if (protocol == LCC_PROTOCOL_TCP) {
+    frame = malloc(sizeof(uint32_t) + LCC_NETWORK_TCP_BUFFER_SIZE);
+    if (frame == NULL) {
+      lcc_network_buffer_destroy(buffer);
+      return ENOMEM;
+    }
+  }
+
+  server_close_socket(srv);
+  lcc_network_buffer_destroy(srv->buffer);
+  free(srv->frame);
+  srv->batch_num = 0;
+  srv->buffer = buffer;
+  srv->buffer_values = 0;
+  srv->frame = frame;
+  srv->protocol = protocol;
+
+  return 0;
+} /* }}} int lcc_server_set_protocol */
+
+int lcc_server_set_send_batch(lcc_server_t *srv, size_t num) /* {{{ */
+{
+  if (srv == NULL)
+    return EINVAL;
+  if (num > LCC_NETWORK_SEND_BATCH_MAX)
+    num = LCC_NETWORK_SEND_BATCH_MAX;
+  if (num == 1)
+    num = 0;
+  if (num == srv->batch_size)
+    return 0;
+
+  int status = server_send_batch(srv);
+
+  free(srv->batch);
+  free(srv->batch_iov);
+  srv->batch = NULL;
+  srv->batch_iov = NULL;
+#if HAVE_SENDMMSG
+  free(srv->batch_msgs);
+  srv->batch_msgs = NULL;
+#endif
+  srv->batch_size = 0;
+
+  if (num == 0)
+    return status;
+
+  srv->batch = malloc(num * LCC_NETWORK_BUFFER_SIZE_DEFAULT);
+  srv->batch_iov = calloc(num, sizeof(*srv->batch_iov));
+#if HAVE_SENDMMSG
+  srv->batch_msgs = calloc(num, sizeof(*srv->batch_msgs));
+  if (srv->batch_msgs == NULL) {
+    free(srv->batch);
+    srv->batch = NULL;
+  }
+#endif
+  if ((srv->batch == NULL) || (srv->batch_iov == NULL)) {
+    free(srv->batch);
+    free(srv->batch_iov);
+    srv->batch = NULL;
+    srv->batch_iov = NULL;
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < num; i++)
+    srv->batch_iov[i].iov_base =
+        srv->batch + i * LCC_NETWORK_BUFFER_SIZE_DEFAULT;
+  srv->batch_size = num;
+
+  return status;
+} /* }}} int lcc_server_set_send_batch */
+
 int lcc_network_values_send(lcc_network_t *net, /* {{{ */
                             const lcc_value_list_t *vl) {
+  int status = 0;
+
   if ((net == NULL) || (vl == NULL))
     return EINVAL;
 
-  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next)
-    server_value_add(srv, vl);
+  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next) {
+    int tmp = server_value_add(srv, vl);
+    if (tmp != 0)
+      status = tmp;
+  }
 
-  return 0;
+  return status;
 } /* }}} int lcc_network_values_send */
+
+int lcc_network_flush(lcc_network_t *net) /* {{{ */
+{
+  int status = 0;
+
+  if (net == NULL)
+    return EINVAL;
+
+  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next) {
+    if (srv->buffer_values != 0) {
+      int tmp = server_send_buffer(srv);
+      if (tmp != 0)
+        status = tmp;
+    }
+
+    int tmp = server_send_batch(srv);
+    if (tmp != 0)
+      status = tmp;
+  }
+
+  return status;
+} /* }}} int lcc_network_flush */
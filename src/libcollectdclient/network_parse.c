@@ -220,23 +220,12 @@ static int parse_time(uint16_t type, void *payload, size_t payload_size,
   return 0;
 }
 
-static double ntohd(double val) /* {{{ */
+/* Returns how doubles are laid out in memory compared to the network:
+ * 1 = same layout, 2 = endian flip, 3 = int swap, 4 = unknown. */
+static int fp_layout(void) /* {{{ */
 {
   static int config;
 
-  union {
-    uint8_t byte[8];
-    double floating;
-  } in = {
-      .floating = val,
-  };
-  union {
-    uint8_t byte[8];
-    double floating;
-  } out = {
-      .byte = {0},
-  };
-
   if (config == 0) {
     double d = 8.642135e130;
     uint8_t b[8];
@@ -258,6 +247,26 @@ static double ntohd(double val) /* {{{ */
       config = 4;
   }
 
+  return config;
+} /* }}} int fp_layout */
+
+static double ntohd(double val) /* {{{ */
+{
+  int config = fp_layout();
+
+  union {
+    uint8_t byte[8];
+    double floating;
+  } in = {
+      .floating = val,
+  };
+  union {
+    uint8_t byte[8];
+    double floating;
+  } out = {
+      .byte = {0},
+  };
+
   if (memcmp((char[]){0, 0, 0, 0, 0, 0, 0xf8, 0x7f}, in.byte, 8) == 0) {
     return NAN;
   } else if (config == 1) {
@@ -310,11 +319,40 @@ static int parse_values(void *payload, size_t payload_size,
     return ENOMEM;
   }
 
+  size_t gauges = 0;
   for (uint16_t i = 0; i < n; i++) {
     uint8_t tmp;
     if (buffer_next(b, &tmp, sizeof(tmp)))
       return EINVAL;
     state->values_types[i] = (int)tmp;
+    if (tmp == LCC_TYPE_GAUGE)
+      gauges++;
+  }
+
+  /* Parts with values of a single kind are converted in one go. Integer
+   * types only need a byte swap, gauges nothing at all on most hosts. */
+  if ((gauges == 0) || ((gauges == n) && (fp_layout() == 1))) {
+    for (uint16_t i = 0; i < n; i++) {
+      if ((state->values_types[i] != LCC_TYPE_GAUGE) &&
+          (state->values_types[i] != LCC_TYPE_COUNTER) &&
+          (state->values_types[i] != LCC_TYPE_DERIVE) &&
+          (state->values_types[i] != LCC_TYPE_ABSOLUTE))
+        return EINVAL;
+    }
+
+    if (buffer_next(b, state->values, (size_t)n * sizeof(*state->values)))
+      return EINVAL;
+
+    if (gauges == 0) {
+      for (uint16_t i = 0; i < n; i++) {
+        uint64_t tmp;
+        memcpy(&tmp, &state->values[i], sizeof(tmp));
+        tmp = be64toh(tmp);
+        memcpy(&state->values[i], &tmp, sizeof(tmp));
+      }
+    }
+
+    return 0;
   }
 
   for (uint16_t i = 0; i < n; i++) {
@@ -0,0 +1,141 @@
+/**
+ * collectd - src/libcollectdclient/network_parse_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the network protocol encoder and parser. Build with
+ * "make bench_libcollectd_network_parse"; the optional argument is the number
+ * of packets, 100000 by default. Every packet is a full 1452 byte buffer of
+ * value lists, as sent by the network plugin. */
+
+#include "collectd/lcc_features.h"
+
+#include "collectd/network_buffer.h"
+#include "collectd/network_parse.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "benchmark.h"
+
+static char packet[LCC_NETWORK_BUFFER_SIZE_DEFAULT];
+static size_t packet_size;
+static size_t packet_values;
+static size_t values_parsed;
+
+static void init_value_list(lcc_value_list_t *vl, size_t i) {
+  static value_t values[2];
+  static int types[2] = {LCC_TYPE_DERIVE, LCC_TYPE_DERIVE};
+
+  values[0].derive = (derive_t)(1000 * i);
+  values[1].derive = (derive_t)(2000 * i);
+
+  *vl = (lcc_value_list_t){
+      .values = values,
+      .values_types = types,
+      .values_len = 2,
+      .time = 1480063672.0 + (double)i,
+      .interval = 10.0,
+  };
+  /* A few value lists share host and plugin, so that the encoder can omit
+   * the unchanged parts. */
+  snprintf(vl->identifier.host, sizeof(vl->identifier.host),
+           "host%zu.example.com", i / 16);
+  strncpy(vl->identifier.plugin, "interface", sizeof(vl->identifier.plugin));
+  snprintf(vl->identifier.plugin_instance,
+           sizeof(vl->identifier.plugin_instance), "eth%zu", i % 16);
+  strncpy(vl->identifier.type, "if_octets", sizeof(vl->identifier.type));
+}
+
+/* Fills "nb" with value lists until it is full and returns their number. */
+static size_t fill_buffer(lcc_network_buffer_t *nb) {
+  size_t num = 0;
+
+  lcc_network_buffer_initialize(nb);
+  while (42) {
+    lcc_value_list_t vl;
+    init_value_list(&vl, num);
+    if (lcc_network_buffer_add_value(nb, &vl) != 0)
+      break;
+    num++;
+  }
+  lcc_network_buffer_finalize(nb);
+
+  return num;
+}
+
+static int count_values(lcc_value_list_t const *vl) {
+  values_parsed++;
+  return 0;
+}
+
+DEF_BENCH(lcc_network_buffer_add_value) {
+  lcc_network_buffer_t *nb =
+      lcc_network_buffer_create(LCC_NETWORK_BUFFER_SIZE_DEFAULT);
+  if (nb == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (fill_buffer(nb) == 0)
+      return -1;
+  BENCH_STOP;
+
+  lcc_network_buffer_destroy(nb);
+  return 0;
+}
+
+DEF_BENCH(lcc_network_parse) {
+  lcc_network_parse_options_t opts = {
+      .writer = count_values,
+  };
+
+  values_parsed = 0;
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (lcc_network_parse(packet, packet_size, opts) != 0)
+      return -1;
+  BENCH_STOP;
+
+  return (values_parsed == ops * packet_values) ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+  size_t ops = BENCH_OPS(argc, argv, 100000);
+
+  lcc_network_buffer_t *nb =
+      lcc_network_buffer_create(LCC_NETWORK_BUFFER_SIZE_DEFAULT);
+  if (nb == NULL)
+    return 1;
+  packet_values = fill_buffer(nb);
+  packet_size = sizeof(packet);
+  if (lcc_network_buffer_get(nb, packet, &packet_size) != 0)
+    return 1;
+  lcc_network_buffer_destroy(nb);
+
+  printf("%zu value lists in %zu bytes per packet\n", packet_values,
+         packet_size);
+
+  RUN_BENCH(lcc_network_buffer_add_value, ops);
+  RUN_BENCH(lcc_network_parse, ops);
+
+  END_BENCH;
+}
@@ -28,6 +28,7 @@
 #include "collectd/network_buffer.h" /* for LCC_NETWORK_BUFFER_SIZE_DEFAULT */
 
 #include <assert.h>
+#include <time.h>
 
 #include "network_parse.c" /* sic */
 
@@ -413,6 +414,161 @@ static int test_parse_values() {
   return ret;
 }
 
+static int test_parse_values_bulk() {
+  int ret = 0;
+
+  uint8_t derives[] = {
+      0, 2,                               // num values
+      2, 3,                               // derive, absolute
+      0, 0, 0, 0, 0, 0, 0x7a, 0x69,       // 31337
+      0x01, 0x02, 0x03, 0x04, 0, 0, 0, 0, // 0x0102030400000000
+  };
+  uint8_t gauges[] = {
+      0, 2,                         // num values
+      1, 1,                         // gauge, gauge
+      0, 0, 0, 0, 0, 0, 0x45, 0x40, // 42.0
+      0, 0, 0, 0, 0, 0, 0xf8, 0x7f, // NaN
+  };
+  uint8_t unknown[] = {
+      0, 2,                         // num values
+      2, 7,                         // derive, unknown
+      0, 0, 0, 0, 0, 0, 0x7a, 0x69, // 31337
+      0, 0, 0, 0, 0, 0, 0x7a, 0x69, // 31337
+  };
+
+  lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
+  int status = parse_values(derives, sizeof(derives), &vl);
+  if (status != 0) {
+    fprintf(stderr, "parse_values(derives) = %d, want 0\n", status);
+    return -1;
+  }
+  if ((vl.values[0].derive != 31337) ||
+      (vl.values[1].absolute != 0x0102030400000000ULL)) {
+    fprintf(stderr,
+            "parse_values(derives) = {%" PRIu64 ", %" PRIu64 "}, "
+            "want {31337, %" PRIu64 "}\n",
+            vl.values[0].derive, vl.values[1].absolute,
+            (uint64_t)0x0102030400000000ULL);
+    ret = -1;
+  }
+  free(vl.values);
+  free(vl.values_types);
+
+  vl = (lcc_value_list_t)LCC_VALUE_LIST_INIT;
+  status = parse_values(gauges, sizeof(gauges), &vl);
+  if (status != 0) {
+    fprintf(stderr, "parse_values(gauges) = %d, want 0\n", status);
+    return -1;
+  }
+  if ((vl.values[0].gauge != 42.0) || !isnan(vl.values[1].gauge)) {
+    fprintf(stderr, "parse_values(gauges) = {%g, %g}, want {42, NaN}\n",
+            vl.values[0].gauge, vl.values[1].gauge);
+    ret = -1;
+  }
+  free(vl.values);
+  free(vl.values_types);
+
+  vl = (lcc_value_list_t)LCC_VALUE_LIST_INIT;
+  status = parse_values(unknown, sizeof(unknown), &vl);
+  if (status != EINVAL) {
+    fprintf(stderr, "parse_values(unknown) = %d, want EINVAL\n", status);
+    ret = -1;
+  }
+  free(vl.values);
+  free(vl.values_types);
+
+  return ret;
+}
+
+static size_t bench_append(uint8_t *buffer, size_t offset, uint16_t type,
+                           void const *payload, size_t payload_size) {
+  uint16_t tmp = htobe16(type);
+  memcpy(buffer + offset, &tmp, sizeof(tmp));
+  tmp = htobe16((uint16_t)(payload_size + 4));
+  memcpy(buffer + offset + 2, &tmp, sizeof(tmp));
+  memcpy(buffer + offset + 4, payload, payload_size);
+  return offset + 4 + payload_size;
+}
+
+static uint64_t bench_values_num;
+
+static int bench_writer(lcc_value_list_t const *vl) {
+  bench_values_num += vl->values_len;
+  return 0;
+}
+
+/* Parses packets of wide, single-typed value parts in a loop and reports
+ * the throughput. Only fails if parsing does. */
+static int benchmark_network_parse() {
+  uint8_t buffer[LCC_NETWORK_BUFFER_SIZE_DEFAULT];
+  size_t buffer_size = 0;
+  size_t parts_num = 0;
+
+  buffer_size = bench_append(buffer, buffer_size, TYPE_HOST, "localhost", 10);
+  buffer_size = bench_append(buffer, buffer_size, TYPE_PLUGIN, "bench", 6);
+  buffer_size = bench_append(buffer, buffer_size, TYPE_TYPE, "bench", 6);
+
+  uint8_t part[2 + 16 * 9];
+  uint16_t num = htobe16(16);
+  memcpy(part, &num, sizeof(num));
+
+  while (buffer_size + 2 * (4 + sizeof(part)) <= sizeof(buffer)) {
+    /* all derive */
+    memset(part + 2, 2, 16);
+    for (uint64_t i = 0; i < 16; i++) {
+      uint64_t v = htobe64(i);
+      memcpy(part + 2 + 16 + i * 8, &v, sizeof(v));
+    }
+    buffer_size =
+        bench_append(buffer, buffer_size, TYPE_VALUES, part, sizeof(part));
+
+    /* all gauge */
+    memset(part + 2, 1, 16);
+    for (uint64_t i = 0; i < 16; i++) {
+      double d = (double)i;
+      memcpy(part + 2 + 16 + i * 8, &d, sizeof(d));
+    }
+    buffer_size =
+        bench_append(buffer, buffer_size, TYPE_VALUES, part, sizeof(part));
+    parts_num += 2;
+  }
+
+  size_t const packets_num = 2000;
+  struct timespec begin;
+  struct timespec end;
+
+  bench_values_num = 0;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for (size_t i = 0; i < packets_num; i++) {
+    int status = lcc_network_parse(buffer, buffer_size,
+                                   (lcc_network_parse_options_t){
+                                       .writer = bench_writer,
+                                   });
+    if (status != 0) {
+      fprintf(stderr, "benchmark: lcc_network_parse() = %d, want 0\n", status);
+      return -1;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (bench_values_num != packets_num * parts_num * 16) {
+    fprintf(stderr, "benchmark: got %" PRIu64 " values, want %" PRIsz "\n",
+            bench_values_num, packets_num * parts_num * 16);
+    return -1;
+  }
+
+  double elapsed = (double)(end.tv_sec - begin.tv_sec) +
+                   (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+  if (elapsed <= 0)
+    elapsed = 1e-9;
+  printf("ok - benchmark: %" PRIsz " packets of %" PRIsz " bytes, "
+         "%.0f packets/s, %.0f values/s\n",
+         packets_num, buffer_size, (double)packets_num / elapsed,
+         (double)bench_values_num / elapsed);
+
+  return 0;
+}
+
 #if HAVE_GCRYPT_H
 static int test_verify_sha256() {
   int ret = 0;
@@ -502,6 +658,12 @@ int main(void) {
   if ((status = test_parse_values())) {
     ret = status;
   }
+  if ((status = test_parse_values_bulk())) {
+    ret = status;
+  }
+  if ((status = benchmark_network_parse())) {
+    ret = status;
+  }
 
 #if HAVE_GCRYPT_H
   if ((status = test_verify_sha256())) {
@@ -0,0 +1,418 @@
+/**
+ * collectd - src/libcollectdclient/shm.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "config.h"
+
+#include "collectd/lcc_features.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "collectd/shm.h"
+#include "collectd/shm_ring.h"
+
+/* Not available everywhere; the descriptors are then inherited by children. */
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+#define IDENT_SIZE (5 * LCC_NAME_LEN)
+#define SLOTS_MIN 64
+
+/* The daemon's cdtime_t has 30 bits for fractions of a second. */
+#define DOUBLE_TO_CDTIME(d) ((uint64_t)((d) * 1073741824.0))
+
+/*
+ * Private data types
+ */
+typedef struct {
+  char *name;
+  uint64_t hash;
+  uint32_t id;
+} shm_ident_t;
+
+struct lcc_shm_s {
+  int fd;
+  int doorbell;
+
+  lcc_shm_ring_t *ring;
+  uint8_t *data;
+  size_t map_size;
+  uint64_t size;
+
+  /* Local copy of the ring's head and the last tail seen. */
+  uint64_t head;
+  uint64_t tail;
+
+  /* Interned identifiers, hashed by name with open addressing. */
+  shm_ident_t *idents;
+  size_t idents_size;
+  uint32_t idents_num;
+};
+
+/*
+ * Private functions
+ */
+static uint64_t shm_hash(char const *name) /* {{{ */
+{
+  /* FNV-1a */
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (char const *c = name; *c != 0; c++)
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+
+  return hash;
+} /* }}} uint64_t shm_hash */
+
+static int shm_receive_ring(lcc_shm_t *s) /* {{{ */
+{
+  lcc_shm_hello_t hello = {0};
+  struct iovec iov = {.iov_base = &hello, .iov_len = sizeof(hello)};
+  union {
+    char buf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+
+  ssize_t len;
+  do {
+    len = recvmsg(s->fd, &msg, MSG_CMSG_CLOEXEC);
+  } while ((len < 0) && (errno == EINTR));
+  if (len < 0)
+    return errno;
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) ||
+      (cmsg->cmsg_type != SCM_RIGHTS) ||
+      (cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))))
+    return EPROTO;
+
+  int fds[2];
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  s->doorbell = fds[1];
+
+  if (((size_t)len != sizeof(hello)) || (hello.version != LCC_SHM_VERSION) ||
+      (hello.map_size < sizeof(lcc_shm_ring_t))) {
+    close(fds[0]);
+    return EPROTO;
+  }
+
+  void *map = mmap(NULL, (size_t)hello.map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fds[0], /* offset = */ 0);
+  int status = errno;
+  close(fds[0]);
+  if (map == MAP_FAILED)
+    return status;
+
+  s->ring = map;
+  s->map_size = (size_t)hello.map_size;
+
+  uint64_t size = s->ring->size;
+  if ((s->ring->magic != LCC_SHM_MAGIC) ||
+      (s->ring->version != LCC_SHM_VERSION) || (size == 0) ||
+      ((size & (size - 1)) != 0) ||
+      (s->ring->data_offset < sizeof(lcc_shm_ring_t)) ||
+      (s->ring->data_offset + size > s->map_size))
+    return EPROTO;
+
+  s->data = (uint8_t *)map + s->ring->data_offset;
+  s->size = size;
+  s->head = __atomic_load_n(&s->ring->head, __ATOMIC_RELAXED);
+  s->tail = __atomic_load_n(&s->ring->tail, __ATOMIC_ACQUIRE);
+  return 0;
+} /* }}} int shm_receive_ring */
+
+/* Returns true if the daemon has closed the connection. */
+static bool shm_closed(lcc_shm_t *s) /* {{{ */
+{
+  char c;
+  ssize_t len = recv(s->fd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+  return (len == 0) || ((len < 0) && (errno != EAGAIN) &&
+                        (errno != EWOULDBLOCK) && (errno != EINTR));
+} /* }}} bool shm_closed */
+
+/* Returns the space for a record of "len" bytes, or NULL and sets
+ * "ret_status" if the ring is full. */
+static lcc_shm_record_t *shm_reserve(lcc_shm_t *s, size_t len, /* {{{ */
+                                     int *ret_status) {
+  len = LCC_SHM_ALIGN(len);
+  if ((len > UINT32_MAX) || (len > s->size / 2)) {
+    *ret_status = EMSGSIZE;
+    return NULL;
+  }
+
+  uint64_t offset = s->head & (s->size - 1);
+  uint64_t pad = (offset + len > s->size) ? (s->size - offset) : 0;
+
+  if (s->head + pad + len - s->tail > s->size) {
+    s->tail = __atomic_load_n(&s->ring->tail, __ATOMIC_ACQUIRE);
+    if (s->head + pad + len - s->tail > s->size) {
+      *ret_status = shm_closed(s) ? ENOTCONN : EAGAIN;
+      return NULL;
+    }
+  }
+
+  if (pad > 0) {
+    /* The consumer skips less than a record header without one. */
+    if (pad >= sizeof(lcc_shm_record_t)) {
+      lcc_shm_record_t *r = (lcc_shm_record_t *)(s->data + offset);
+      *r = (lcc_shm_record_t){.len = (uint32_t)pad,
+                              .type = LCC_SHM_RECORD_PAD};
+    }
+    s->head += pad;
+  }
+
+  lcc_shm_record_t *r =
+      (lcc_shm_record_t *)(s->data + (s->head & (s->size - 1)));
+  r->len = (uint32_t)len;
+  return r;
+} /* }}} lcc_shm_record_t *shm_reserve */
+
+/* Publishes the record reserved last and wakes the daemon up if it's
+ * sleeping. */
+static void shm_commit(lcc_shm_t *s, lcc_shm_record_t *r) /* {{{ */
+{
+  s->head += r->len;
+  __atomic_store_n(&s->ring->head, s->head, __ATOMIC_RELEASE);
+
+  /* Pairs with the consumer setting "waiting" before checking "head". */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if ((__atomic_load_n(&s->ring->waiting, __ATOMIC_RELAXED) != 0) &&
+      (__atomic_exchange_n(&s->ring->waiting, 0, __ATOMIC_ACQ_REL) != 0)) {
+    uint64_t one = 1;
+    ssize_t status = write(s->doorbell, &one, sizeof(one));
+    (void)status;
+  }
+} /* }}} void shm_commit */
+
+static int shm_idents_grow(lcc_shm_t *s) /* {{{ */
+{
+  size_t size = (s->idents_size > 0) ? (2 * s->idents_size) : SLOTS_MIN;
+  shm_ident_t *idents = calloc(size, sizeof(*idents));
+  if (idents == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < s->idents_size; i++) {
+    if (s->idents[i].name == NULL)
+      continue;
+
+    size_t j = (size_t)s->idents[i].hash & (size - 1);
+    while (idents[j].name != NULL)
+      j = (j + 1) & (size - 1);
+    idents[j] = s->idents[i];
+  }
+
+  free(s->idents);
+  s->idents = idents;
+  s->idents_size = size;
+  return 0;
+} /* }}} int shm_idents_grow */
+
+/*
+ * Public functions
+ */
+lcc_shm_t *lcc_shm_connect(const char *path) /* {{{ */
+{
+  if (path == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  lcc_shm_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+  s->doorbell = -1;
+
+  /* Don't use PF_UNIX here, because it's broken on Mac OS X (10.4, possibly
+   * others). */
+  s->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, /* protocol = */ 0);
+  if (s->fd < 0) {
+    free(s);
+    return NULL;
+  }
+
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+
+  int status = 0;
+  if (connect(s->fd, (struct sockaddr *)&sa, sizeof(sa)) != 0)
+    status = errno;
+  else
+    status = shm_receive_ring(s);
+
+  if (status != 0) {
+    lcc_shm_disconnect(s);
+    errno = status;
+    return NULL;
+  }
+
+  return s;
+} /* }}} lcc_shm_t *lcc_shm_connect */
+
+void lcc_shm_disconnect(lcc_shm_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  if (s->ring != NULL)
+    munmap(s->ring, s->map_size);
+  if (s->doorbell >= 0)
+    close(s->doorbell);
+  if (s->fd >= 0)
+    close(s->fd);
+
+  for (size_t i = 0; i < s->idents_size; i++)
+    free(s->idents[i].name);
+  free(s->idents);
+  free(s);
+} /* }}} void lcc_shm_disconnect */
+
+int lcc_shm_intern(lcc_shm_t *s, const lcc_identifier_t *ident, /* {{{ */
+                   uint32_t *ret_id) {
+  char name[IDENT_SIZE];
+
+  if ((s == NULL) || (ident == NULL) || (ret_id == NULL))
+    return EINVAL;
+
+  if (ident->plugin_instance[0] == 0) {
+    if (ident->type_instance[0] == 0)
+      snprintf(name, sizeof(name), "%s/%s/%s", ident->host, ident->plugin,
+               ident->type);
+    else
+      snprintf(name, sizeof(name), "%s/%s/%s-%s", ident->host, ident->plugin,
+               ident->type, ident->type_instance);
+  } else {
+    if (ident->type_instance[0] == 0)
+      snprintf(name, sizeof(name), "%s/%s-%s/%s", ident->host, ident->plugin,
+               ident->plugin_instance, ident->type);
+    else
+      snprintf(name, sizeof(name), "%s/%s-%s/%s-%s", ident->host,
+               ident->plugin, ident->plugin_instance, ident->type,
+               ident->type_instance);
+  }
+
+  uint64_t hash = shm_hash(name);
+  size_t i = 0;
+  if (s->idents_size > 0) {
+    for (i = (size_t)hash & (s->idents_size - 1); s->idents[i].name != NULL;
+         i = (i + 1) & (s->idents_size - 1)) {
+      if ((s->idents[i].hash == hash) &&
+          (strcmp(s->idents[i].name, name) == 0)) {
+        *ret_id = s->idents[i].id;
+        return 0;
+      }
+    }
+  }
+
+  /* Keep the table at most half full. */
+  if (2 * (s->idents_num + 1) > s->idents_size) {
+    int status = shm_idents_grow(s);
+    if (status != 0)
+      return status;
+    i = (size_t)hash & (s->idents_size - 1);
+    while (s->idents[i].name != NULL)
+      i = (i + 1) & (s->idents_size - 1);
+  }
+
+  size_t name_len = strlen(name) + 1;
+  int status = 0;
+  lcc_shm_record_t *r = shm_reserve(s, sizeof(*r) + name_len, &status);
+  if (r == NULL)
+    return status;
+
+  char *copy = strdup(name);
+  if (copy == NULL)
+    return ENOMEM;
+
+  r->type = LCC_SHM_RECORD_IDENT;
+  r->values_num = 0;
+  r->id = s->idents_num;
+  r->reserved = 0;
+  memcpy(r + 1, name, name_len);
+  shm_commit(s, r);
+
+  s->idents[i] = (shm_ident_t){.name = copy, .hash = hash, .id = r->id};
+  s->idents_num++;
+
+  *ret_id = s->idents[i].id;
+  return 0;
+} /* }}} int lcc_shm_intern */
+
+int lcc_shm_put(lcc_shm_t *s, uint32_t id, double time, /* {{{ */
+                double interval, const value_t *values, size_t values_len) {
+  if ((s == NULL) || (id >= s->idents_num) || (values == NULL) ||
+      (values_len == 0) || (values_len > UINT16_MAX))
+    return EINVAL;
+
+  size_t len = sizeof(lcc_shm_record_t) + sizeof(lcc_shm_values_t) +
+               values_len * sizeof(uint64_t);
+  int status = 0;
+  lcc_shm_record_t *r = shm_reserve(s, len, &status);
+  if (r == NULL)
+    return status;
+
+  r->type = LCC_SHM_RECORD_VALUES;
+  r->values_num = (uint16_t)values_len;
+  r->id = id;
+  r->reserved = 0;
+
+  lcc_shm_values_t *v = (lcc_shm_values_t *)(r + 1);
+  v->time = (time > 0) ? DOUBLE_TO_CDTIME(time) : 0;
+  v->interval = (interval > 0) ? DOUBLE_TO_CDTIME(interval) : 0;
+  memcpy(v + 1, values, values_len * sizeof(*values));
+
+  shm_commit(s, r);
+  return 0;
+} /* }}} int lcc_shm_put */
+
+int lcc_shm_putval(lcc_shm_t *s, const lcc_value_list_t *vl) /* {{{ */
+{
+  uint32_t id;
+
+  if ((s == NULL) || (vl == NULL))
+    return EINVAL;
+
+  int status = lcc_shm_intern(s, &vl->identifier, &id);
+  if (status != 0)
+    return status;
+
+  return lcc_shm_put(s, id, vl->time, vl->interval, vl->values,
+                     vl->values_len);
+} /* }}} int lcc_shm_putval */
@@ -30,6 +30,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/log_queue/log_queue.h"
 
 #include <sys/types.h>
 #include <yajl/yajl_common.h>
@@ -50,8 +51,18 @@ static int log_level = LOG_INFO;
 static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static char *log_file;
-
-static const char *config_keys[] = {"LogLevel", "File"};
+static size_t queue_length = LOG_QUEUE_LENGTH;
+static cdtime_t coalesce_interval = LOG_QUEUE_COALESCE_INTERVAL;
+
+/* Created by the init callback. Before that, messages are written by the
+ * caller. */
+static log_queue_t *queue;
+static log_file_t log_fh = LOG_FILE_INIT;
+/* The stream written last, flushed after each batch. */
+static FILE *log_out;
+
+static const char *config_keys[] = {"LogLevel", "File", "QueueLength",
+                                    "CoalesceInterval"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int log_logstash_config(const char *key, const char *value) {
@@ -66,24 +77,55 @@ static int log_logstash_config(const char *key, const char *value) {
   } else if (0 == strcasecmp(key, "File")) {
     sfree(log_file);
     log_file = strdup(value);
+  } else if (0 == strcasecmp(key, "QueueLength")) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("log_logstash: invalid QueueLength [%s]", value);
+      return 1;
+    }
+    queue_length = (size_t)tmp;
+  } else if (0 == strcasecmp(key, "CoalesceInterval")) {
+    double tmp = atof(value);
+    if (tmp < 0.0) {
+      ERROR("log_logstash: invalid CoalesceInterval [%s]", value);
+      return 1;
+    }
+    coalesce_interval = DOUBLE_TO_CDTIME_T(tmp);
   } else {
     return -1;
   }
   return 0;
 } /* int log_logstash_config (const char *, const char *) */
 
-static void log_logstash_print(yajl_gen g, int severity,
+static void log_logstash_output(const char *buf) {
+  pthread_mutex_lock(&file_lock);
+
+  /* The file is kept open and opened again once it has been rotated. */
+  FILE *fh = log_file_get(&log_fh, log_file);
+
+  if (fh == NULL) {
+    fprintf(stderr, "log_logstash plugin: fopen (%s) failed: %s\n", log_file,
+            STRERRNO);
+  } else {
+    fprintf(fh, "%s\n", buf);
+    log_out = fh;
+  }
+  pthread_mutex_unlock(&file_lock);
+} /* void log_logstash_output */
+
+static void log_logstash_flush(void __attribute__((unused)) * arg) {
+  pthread_mutex_lock(&file_lock);
+  if (log_out != NULL)
+    fflush(log_out);
+  pthread_mutex_unlock(&file_lock);
+} /* void log_logstash_flush */
+
+/* Adds the level and the timestamp to the object opened in `g' and closes
+ * it. */
+static int log_logstash_finish(yajl_gen g, int severity,
                                cdtime_t timestamp_time) {
-  FILE *fh;
-  bool do_close = false;
   struct tm timestamp_tm;
   char timestamp_str[64];
-  const unsigned char *buf;
-#if HAVE_YAJL_V2
-  size_t len;
-#else
-  unsigned int len;
-#endif
 
   if (yajl_gen_string(g, (u_char *)"level", strlen("level")) !=
       yajl_gen_status_ok)
@@ -142,48 +184,21 @@ static void log_logstash_print(yajl_gen g, int severity,
   if (yajl_gen_map_close(g) != yajl_gen_status_ok)
     goto err;
 
-  if (yajl_gen_get_buf(g, &buf, &len) != yajl_gen_status_ok)
-    goto err;
-  pthread_mutex_lock(&file_lock);
-
-  if (log_file == NULL) {
-    fh = stderr;
-  } else if (strcasecmp(log_file, "stdout") == 0) {
-    fh = stdout;
-    do_close = false;
-  } else if (strcasecmp(log_file, "stderr") == 0) {
-    fh = stderr;
-    do_close = false;
-  } else {
-    fh = fopen(log_file, "a");
-    do_close = true;
-  }
-
-  if (fh == NULL) {
-    fprintf(stderr, "log_logstash plugin: fopen (%s) failed: %s\n", log_file,
-            STRERRNO);
-  } else {
-    fprintf(fh, "%s\n", buf);
-    if (do_close) {
-      fclose(fh);
-    } else {
-      fflush(fh);
-    }
-  }
-  pthread_mutex_unlock(&file_lock);
-  yajl_gen_free(g);
-  return;
+  return 0;
 
 err:
-  yajl_gen_free(g);
-  fprintf(stderr, "Could not correctly generate JSON message\n");
-  return;
-} /* void log_logstash_print */
+  return -1;
+} /* int log_logstash_finish */
 
-static void log_logstash_log(int severity, const char *msg,
-                             user_data_t __attribute__((unused)) * user_data) {
-  if (severity > log_level)
-    return;
+/* Renders and writes a log message, usually in the thread of the queue. */
+static void log_logstash_print(const char *msg, int severity,
+                               cdtime_t timestamp_time) {
+  const unsigned char *buf;
+#if HAVE_YAJL_V2
+  size_t len;
+#else
+  unsigned int len;
+#endif
 
 #if HAVE_YAJL_V2
   yajl_gen g = yajl_gen_alloc(NULL);
@@ -203,13 +218,42 @@ static void log_logstash_log(int severity, const char *msg,
   if (yajl_gen_string(g, (u_char *)msg, strlen(msg)) != yajl_gen_status_ok)
     goto err;
 
-  log_logstash_print(g, severity, cdtime());
+  if (log_logstash_finish(g, severity, timestamp_time) != 0)
+    goto err;
+  if (yajl_gen_get_buf(g, &buf, &len) != yajl_gen_status_ok)
+    goto err;
+
+  log_logstash_output((const char *)buf);
+  yajl_gen_free(g);
   return;
 err:
   yajl_gen_free(g);
-  fprintf(stderr, "Could not generate JSON message preamble\n");
+  fprintf(stderr, "Could not correctly generate JSON message\n");
   return;
 
+} /* void log_logstash_print */
+
+static void log_logstash_write(log_queue_entry_t const *e,
+                               void __attribute__((unused)) * arg) {
+  /* Notifications are rendered by the caller. */
+  if (e->notification)
+    log_logstash_output(e->msg);
+  else
+    log_logstash_print(e->msg, e->severity, e->time);
+} /* void log_logstash_write */
+
+static void log_logstash_log(int severity, const char *msg,
+                             user_data_t __attribute__((unused)) * user_data) {
+  if (severity > log_level)
+    return;
+
+  if (queue == NULL) {
+    log_logstash_print(msg, severity, cdtime());
+    log_logstash_flush(NULL);
+    return;
+  }
+
+  log_queue_push(queue, severity, cdtime(), msg);
 } /* void log_logstash_log (int, const char *) */
 
 static int log_logstash_notification(const notification_t *n,
@@ -313,7 +357,27 @@ static int log_logstash_notification(const notification_t *n,
     break;
   }
 
-  log_logstash_print(g, LOG_INFO, (n->time != 0) ? n->time : cdtime());
+  const unsigned char *buf;
+#if HAVE_YAJL_V2
+  size_t len;
+#else
+  unsigned int len;
+#endif
+  cdtime_t timestamp_time = (n->time != 0) ? n->time : cdtime();
+  if (log_logstash_finish(g, LOG_INFO, timestamp_time) != 0)
+    goto err;
+  if (yajl_gen_get_buf(g, &buf, &len) != yajl_gen_status_ok)
+    goto err;
+
+  /* Notifications too long for the queue are written right away. */
+  if ((queue != NULL) && (len < LOG_QUEUE_MSG_SIZE)) {
+    log_queue_push_notification(queue, LOG_INFO, timestamp_time,
+                                (const char *)buf);
+  } else {
+    log_logstash_output((const char *)buf);
+    log_logstash_flush(NULL);
+  }
+  yajl_gen_free(g);
   return 0;
 
 err:
@@ -322,6 +386,40 @@ err:
   return 0;
 } /* int log_logstash_notification */
 
+static int log_logstash_init(void) {
+  if (queue != NULL)
+    return 0;
+
+  /* Without a queue length, the queue only coalesces the messages and the
+   * callers write them. */
+  queue = log_queue_create((queue_length > 0) ? queue_length : 1,
+                           coalesce_interval, log_logstash_write,
+                           log_logstash_flush, /* arg = */ NULL);
+  if (queue == NULL) {
+    ERROR("log_logstash: log_queue_create failed.");
+    return -1;
+  }
+
+  if (queue_length > 0) {
+    int status = log_queue_start(queue);
+    if (status != 0)
+      WARNING("log_logstash: starting the log queue failed, writing messages "
+              "synchronously: %s",
+              STRERROR(status));
+  }
+
+  return 0;
+} /* int log_logstash_init */
+
+static int log_logstash_shutdown(void) {
+  /* The queue stays around, so that messages logged after this are still
+   * written. */
+  if (queue != NULL)
+    log_queue_stop(queue);
+
+  return 0;
+} /* int log_logstash_shutdown */
+
 void module_register(void) {
   plugin_register_config("log_logstash", log_logstash_config, config_keys,
                          config_keys_num);
@@ -329,4 +427,6 @@ void module_register(void) {
                       /* user_data = */ NULL);
   plugin_register_notification("log_logstash", log_logstash_notification,
                                /* user_data = */ NULL);
+  plugin_register_init("log_logstash", log_logstash_init);
+  plugin_register_shutdown("log_logstash", log_logstash_shutdown);
 } /* void module_register (void) */
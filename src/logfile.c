@@ -30,6 +30,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/log_queue/log_queue.h"
 
 #if COLLECT_DEBUG
 static int log_level = LOG_DEBUG;
@@ -42,9 +43,19 @@ static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
 static char *log_file;
 static int print_timestamp = 1;
 static int print_severity;
+static size_t queue_length = LOG_QUEUE_LENGTH;
+static cdtime_t coalesce_interval = LOG_QUEUE_COALESCE_INTERVAL;
 
-static const char *config_keys[] = {"LogLevel", "File", "Timestamp",
-                                    "PrintSeverity"};
+/* Created by the init callback. Before that, messages are written by the
+ * caller. */
+static log_queue_t *queue;
+static log_file_t log_fh = LOG_FILE_INIT;
+/* The stream written last, flushed after each batch. */
+static FILE *log_out;
+
+static const char *config_keys[] = {"LogLevel",      "File",
+                                    "Timestamp",     "PrintSeverity",
+                                    "QueueLength",   "CoalesceInterval"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int logfile_config(const char *key, const char *value) {
@@ -68,6 +79,20 @@ static int logfile_config(const char *key, const char *value) {
       print_severity = 0;
     else
       print_severity = 1;
+  } else if (0 == strcasecmp(key, "QueueLength")) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("logfile: invalid QueueLength [%s]", value);
+      return 1;
+    }
+    queue_length = (size_t)tmp;
+  } else if (0 == strcasecmp(key, "CoalesceInterval")) {
+    double tmp = atof(value);
+    if (tmp < 0.0) {
+      ERROR("logfile: invalid CoalesceInterval [%s]", value);
+      return 1;
+    }
+    coalesce_interval = DOUBLE_TO_CDTIME_T(tmp);
   } else {
     return -1;
   }
@@ -77,7 +102,6 @@ static int logfile_config(const char *key, const char *value) {
 static void logfile_print(const char *msg, int severity,
                           cdtime_t timestamp_time) {
   FILE *fh;
-  bool do_close = false;
   char timestamp_str[64];
   char level_str[16] = "";
 
@@ -114,16 +138,8 @@ static void logfile_print(const char *msg, int severity,
 
   pthread_mutex_lock(&file_lock);
 
-  if (log_file == NULL) {
-    fh = stderr;
-  } else if (strcasecmp(log_file, "stderr") == 0)
-    fh = stderr;
-  else if (strcasecmp(log_file, "stdout") == 0)
-    fh = stdout;
-  else {
-    fh = fopen(log_file, "a");
-    do_close = true;
-  }
+  /* The file is kept open and opened again once it has been rotated. */
+  fh = log_file_get(&log_fh, log_file);
 
   if (fh == NULL) {
     fprintf(stderr, "logfile plugin: fopen (%s) failed: %s\n", log_file,
@@ -134,11 +150,7 @@ static void logfile_print(const char *msg, int severity,
     else
       fprintf(fh, "%s%s\n", level_str, msg);
 
-    if (do_close) {
-      fclose(fh);
-    } else {
-      fflush(fh);
-    }
+    log_out = fh;
   }
 
   pthread_mutex_unlock(&file_lock);
@@ -146,12 +158,36 @@ static void logfile_print(const char *msg, int severity,
   return;
 } /* void logfile_print */
 
+static void logfile_flush(void __attribute__((unused)) * arg) {
+  pthread_mutex_lock(&file_lock);
+  if (log_out != NULL)
+    fflush(log_out);
+  pthread_mutex_unlock(&file_lock);
+} /* void logfile_flush */
+
+static void logfile_write(log_queue_entry_t const *e,
+                          void __attribute__((unused)) * arg) {
+  logfile_print(e->msg, e->severity, e->time);
+} /* void logfile_write */
+
+static void logfile_submit(const char *msg, int severity,
+                           cdtime_t timestamp_time, bool notification) {
+  if (queue == NULL) {
+    logfile_print(msg, severity, timestamp_time);
+    logfile_flush(NULL);
+  } else if (notification) {
+    log_queue_push_notification(queue, severity, timestamp_time, msg);
+  } else {
+    log_queue_push(queue, severity, timestamp_time, msg);
+  }
+} /* void logfile_submit */
+
 static void logfile_log(int severity, const char *msg,
                         user_data_t __attribute__((unused)) * user_data) {
   if (severity > log_level)
     return;
 
-  logfile_print(msg, severity, cdtime());
+  logfile_submit(msg, severity, cdtime(), /* notification = */ false);
 } /* void logfile_log (int, const char *) */
 
 static int logfile_notification(const notification_t *n,
@@ -191,15 +227,52 @@ static int logfile_notification(const notification_t *n,
 
   buf[sizeof(buf) - 1] = '\0';
 
-  logfile_print(buf, LOG_INFO, (n->time != 0) ? n->time : cdtime());
+  logfile_submit(buf, LOG_INFO, (n->time != 0) ? n->time : cdtime(),
+                 /* notification = */ true);
 
   return 0;
 } /* int logfile_notification */
 
+static int logfile_init(void) {
+  if (queue != NULL)
+    return 0;
+
+  /* Without a queue length, the queue only coalesces the messages and the
+   * callers write them. */
+  queue = log_queue_create((queue_length > 0) ? queue_length : 1,
+                           coalesce_interval, logfile_write, logfile_flush,
+                           /* arg = */ NULL);
+  if (queue == NULL) {
+    ERROR("logfile: log_queue_create failed.");
+    return -1;
+  }
+
+  if (queue_length > 0) {
+    int status = log_queue_start(queue);
+    if (status != 0)
+      WARNING("logfile: starting the log queue failed, writing messages "
+              "synchronously: %s",
+              STRERROR(status));
+  }
+
+  return 0;
+} /* int logfile_init */
+
+static int logfile_shutdown(void) {
+  /* The queue stays around, so that messages logged after this are still
+   * written. */
+  if (queue != NULL)
+    log_queue_stop(queue);
+
+  return 0;
+} /* int logfile_shutdown */
+
 void module_register(void) {
   plugin_register_config("logfile", logfile_config, config_keys,
                          config_keys_num);
   plugin_register_log("logfile", logfile_log, /* user_data = */ NULL);
   plugin_register_notification("logfile", logfile_notification,
                                /* user_data = */ NULL);
+  plugin_register_init("logfile", logfile_init);
+  plugin_register_shutdown("logfile", logfile_shutdown);
 } /* void module_register (void) */
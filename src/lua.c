@@ -40,22 +40,51 @@
 
 #include <pthread.h>
 
-typedef struct lua_script_s {
-  char *script_path;
-  lua_State *lua_state;
-  struct lua_script_s *next;
-} lua_script_t;
+struct lua_script_s;
+typedef struct lua_script_s lua_script_t;
 
 typedef struct {
-  lua_State *lua_state;
-  const char *lua_function_name;
-  pthread_mutex_t lock;
-  int callback_id;
+  lua_script_t *script;
+  char *lua_function_name;
+  bool is_write;
+  /* The callback's registry reference in each of the script's states. */
+  int *callback_ids;
 } clua_callback_data_t;
 
+struct lua_script_s {
+  char *script_path;
+
+  /* The script is loaded into each of these states. Every state runs at most
+   * one callback at a time, so up to "states_num" callbacks of the script run
+   * in parallel. */
+  lua_State **states;
+  size_t states_num;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* Indexes of the states which are not running a callback. */
+  size_t *idle;
+  size_t idle_num;
+
+  /* Callbacks registered by the script while it is loaded. They are
+   * registered with the daemon once all states have been loaded. */
+  clua_callback_data_t **callbacks;
+  size_t callbacks_num;
+  /* Number of callbacks registered by the state currently being loaded. */
+  size_t callbacks_loaded;
+  bool loaded;
+
+  struct lua_script_s *next;
+};
+
 static char base_path[PATH_MAX];
+static size_t states_num = 1;
 static lua_script_t *scripts;
 
+/* Registry keys of the script a state belongs to and of the state's index. */
+static char script_key;
+static char state_index_key;
+
 static int clua_store_callback(lua_State *L, int idx) /* {{{ */
 {
   /* Copy the function pointer */
@@ -76,38 +105,67 @@ static int clua_load_callback(lua_State *L, int callback_ref) /* {{{ */
   return 0;
 } /* }}} int clua_load_callback */
 
-/* Store the threads in a global variable so they are not cleaned up by the
- * garbage collector. */
-static int clua_store_thread(lua_State *L, int idx) /* {{{ */
+static lua_script_t *clua_get_script(lua_State *L, /* {{{ */
+                                     size_t *ret_index) {
+  lua_pushlightuserdata(L, &script_key);
+  lua_rawget(L, LUA_REGISTRYINDEX);
+  lua_script_t *script = lua_touserdata(L, -1);
+  lua_pop(L, 1);
+
+  lua_pushlightuserdata(L, &state_index_key);
+  lua_rawget(L, LUA_REGISTRYINDEX);
+  *ret_index = (size_t)lua_tointeger(L, -1);
+  lua_pop(L, 1);
+
+  return script;
+} /* }}} lua_script_t *clua_get_script */
+
+/* Waits until one of the script's states is idle and returns its index. */
+static size_t lua_script_acquire(lua_script_t *script) /* {{{ */
 {
-  if (idx < 0)
-    idx += lua_gettop(L) + 1;
+  pthread_mutex_lock(&script->lock);
+  while (script->idle_num == 0)
+    pthread_cond_wait(&script->cond, &script->lock);
+  size_t index = script->idle[--script->idle_num];
+  pthread_mutex_unlock(&script->lock);
 
-  /* Copy the thread pointer */
-  lua_pushvalue(L, idx); /* +1 = 3 */
-  if (!lua_isthread(L, -1)) {
-    lua_pop(L, 3); /* -3 = 0 */
-    return -1;
-  }
+  return index;
+} /* }}} size_t lua_script_acquire */
 
-  luaL_ref(L, LUA_REGISTRYINDEX);
-  lua_pop(L, 1); /* -1 = 0 */
-  return 0;
-} /* }}} int clua_store_thread */
+static void lua_script_release(lua_script_t *script, size_t index) /* {{{ */
+{
+  pthread_mutex_lock(&script->lock);
+  script->idle[script->idle_num++] = index;
+  pthread_cond_signal(&script->cond);
+  pthread_mutex_unlock(&script->lock);
+} /* }}} void lua_script_release */
+
+static void clua_callback_free(void *arg) /* {{{ */
+{
+  clua_callback_data_t *cb = arg;
+
+  if (cb == NULL)
+    return;
+
+  sfree(cb->lua_function_name);
+  sfree(cb->callback_ids);
+  sfree(cb);
+} /* }}} void clua_callback_free */
 
 static int clua_read(user_data_t *ud) /* {{{ */
 {
   clua_callback_data_t *cb = ud->data;
+  lua_script_t *script = cb->script;
 
-  pthread_mutex_lock(&cb->lock);
-
-  lua_State *L = cb->lua_state;
+  size_t index = lua_script_acquire(script);
+  lua_State *L = script->states[index];
+  int callback_id = cb->callback_ids[index];
 
-  int status = clua_load_callback(L, cb->callback_id);
+  int status = clua_load_callback(L, callback_id);
   if (status != 0) {
     ERROR("Lua plugin: Unable to load callback \"%s\" (id %i).",
-          cb->lua_function_name, cb->callback_id);
-    pthread_mutex_unlock(&cb->lock);
+          cb->lua_function_name, callback_id);
+    lua_script_release(script, index);
     return -1;
   }
   /* +1 = 1 */
@@ -121,14 +179,14 @@ static int clua_read(user_data_t *ud) /* {{{ */
     else
       ERROR("Lua plugin: Calling a read callback failed: %s", errmsg);
     lua_pop(L, 1);
-    pthread_mutex_unlock(&cb->lock);
+    lua_script_release(script, index);
     return -1;
   }
 
   if (!lua_isnumber(L, -1)) {
     ERROR("Lua plugin: Read function \"%s\" (id %i) did not return a numeric "
           "status.",
-          cb->lua_function_name, cb->callback_id);
+          cb->lua_function_name, callback_id);
     status = -1;
   } else {
     status = (int)lua_tointeger(L, -1);
@@ -137,23 +195,24 @@ static int clua_read(user_data_t *ud) /* {{{ */
   /* pop return value and function */
   lua_pop(L, 1); /* -1 = 0 */
 
-  pthread_mutex_unlock(&cb->lock);
+  lua_script_release(script, index);
   return status;
 } /* }}} int clua_read */
 
 static int clua_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
                       user_data_t *ud) {
   clua_callback_data_t *cb = ud->data;
+  lua_script_t *script = cb->script;
 
-  pthread_mutex_lock(&cb->lock);
+  size_t index = lua_script_acquire(script);
+  lua_State *L = script->states[index];
+  int callback_id = cb->callback_ids[index];
 
-  lua_State *L = cb->lua_state;
-
-  int status = clua_load_callback(L, cb->callback_id);
+  int status = clua_load_callback(L, callback_id);
   if (status != 0) {
     ERROR("Lua plugin: Unable to load callback \"%s\" (id %i).",
-          cb->lua_function_name, cb->callback_id);
-    pthread_mutex_unlock(&cb->lock);
+          cb->lua_function_name, callback_id);
+    lua_script_release(script, index);
     return -1;
   }
   /* +1 = 1 */
@@ -161,7 +220,7 @@ static int clua_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   status = luaC_pushvaluelist(L, ds, vl);
   if (status != 0) {
     lua_pop(L, 1); /* -1 = 0 */
-    pthread_mutex_unlock(&cb->lock);
+    lua_script_release(script, index);
     ERROR("Lua plugin: luaC_pushvaluelist failed.");
     return -1;
   }
@@ -176,21 +235,21 @@ static int clua_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     else
       ERROR("Lua plugin: Calling the write callback failed:\n%s", errmsg);
     lua_pop(L, 1); /* -1 = 0 */
-    pthread_mutex_unlock(&cb->lock);
+    lua_script_release(script, index);
     return -1;
   }
 
   if (!lua_isnumber(L, -1)) {
     ERROR("Lua plugin: Write function \"%s\" (id %i) did not return a numeric "
           "value.",
-          cb->lua_function_name, cb->callback_id);
+          cb->lua_function_name, callback_id);
     status = -1;
   } else {
     status = (int)lua_tointeger(L, -1);
   }
 
   lua_pop(L, 1); /* -1 = 0 */
-  pthread_mutex_unlock(&cb->lock);
+  lua_script_release(script, index);
   return status;
 } /* }}} int clua_write */
 
@@ -233,6 +292,53 @@ static int lua_cb_log_warning(lua_State *L) /* {{{ */
   return 0;
 } /* }}} int lua_cb_log_warning */
 
+/* Dispatches an array of value lists with one call to the daemon, so that
+ * they are queued for the write threads at once. */
+static int clua_dispatch_values_batch(lua_State *L) /* {{{ */
+{
+  size_t vls_num = 0;
+  while (42) {
+    lua_rawgeti(L, 1, (int)vls_num + 1);
+    int type = lua_type(L, -1);
+    lua_pop(L, 1);
+
+    if (type == LUA_TNIL)
+      break;
+    if (type != LUA_TTABLE)
+      return luaL_error(L, "Element %d is a %s value, not a table",
+                        (int)vls_num + 1, lua_typename(L, type));
+    vls_num++;
+  }
+
+  value_list_t *vls = calloc(vls_num, sizeof(*vls));
+  if (vls == NULL)
+    return luaL_error(L, "%s", "calloc failed");
+
+  for (size_t i = 0; i < vls_num; i++) {
+    lua_rawgeti(L, 1, (int)i + 1);
+    value_list_t *vl = luaC_tovaluelist(L, -1);
+    lua_pop(L, 1);
+
+    if (vl == NULL) {
+      for (size_t j = 0; j < i; j++)
+        sfree(vls[j].values);
+      sfree(vls);
+      return luaL_error(L, "luaC_tovaluelist failed for element %d",
+                        (int)i + 1);
+    }
+
+    vls[i] = *vl;
+    sfree(vl);
+  }
+
+  plugin_dispatch_values_batch(vls, vls_num);
+
+  for (size_t i = 0; i < vls_num; i++)
+    sfree(vls[i].values);
+  sfree(vls);
+  return 0;
+} /* }}} int clua_dispatch_values_batch */
+
 static int lua_cb_dispatch_values(lua_State *L) /* {{{ */
 {
   int nargs = lua_gettop(L);
@@ -242,6 +348,14 @@ static int lua_cb_dispatch_values(lua_State *L) /* {{{ */
 
   luaL_checktype(L, 1, LUA_TTABLE);
 
+  /* A value list has string keys only, an array of value lists starts with a
+   * table at index 1. */
+  lua_rawgeti(L, 1, 1);
+  bool is_array = lua_istable(L, -1);
+  lua_pop(L, 1);
+  if (is_array)
+    return clua_dispatch_values_batch(L);
+
   value_list_t *vl = luaC_tovaluelist(L, -1);
   if (vl == NULL)
     return luaL_error(L, "%s", "luaC_tovaluelist failed");
@@ -263,51 +377,23 @@ static int lua_cb_dispatch_values(lua_State *L) /* {{{ */
   return 0;
 } /* }}} lua_cb_dispatch_values */
 
-static int lua_cb_register_read(lua_State *L) /* {{{ */
+static int clua_callback_register(clua_callback_data_t *cb) /* {{{ */
 {
-  int nargs = lua_gettop(L);
-
-  if (nargs != 1)
-    return luaL_error(L, "Invalid number of arguments (%d != 1)", nargs);
-
-  luaL_checktype(L, 1, LUA_TFUNCTION);
-
-  char function_name[DATA_MAX_NAME_LEN];
-  snprintf(function_name, sizeof(function_name), "lua/%s", lua_tostring(L, 1));
-
-  int callback_id = clua_store_callback(L, 1);
-  if (callback_id < 0)
-    return luaL_error(L, "%s", "Storing callback function failed");
-
-  lua_State *thread = lua_newthread(L);
-  if (thread == NULL)
-    return luaL_error(L, "%s", "lua_newthread failed");
-  clua_store_thread(L, -1);
-  lua_pop(L, 1);
+  user_data_t ud = {
+      .data = cb, .free_func = clua_callback_free,
+  };
 
-  clua_callback_data_t *cb = calloc(1, sizeof(*cb));
-  if (cb == NULL)
-    return luaL_error(L, "%s", "calloc failed");
-
-  cb->lua_state = thread;
-  cb->callback_id = callback_id;
-  cb->lua_function_name = strdup(function_name);
-  pthread_mutex_init(&cb->lock, NULL);
+  if (cb->is_write)
+    return plugin_register_write(/* name = */ cb->lua_function_name,
+                                 /* callback  = */ clua_write, &ud);
 
-  int status = plugin_register_complex_read(/* group = */ "lua",
-                                            /* name      = */ function_name,
-                                            /* callback  = */ clua_read,
-                                            /* interval  = */ 0,
-                                            &(user_data_t){
-                                                .data = cb,
-                                            });
+  return plugin_register_complex_read(/* group = */ "lua",
+                                      /* name      = */ cb->lua_function_name,
+                                      /* callback  = */ clua_read,
+                                      /* interval  = */ 0, &ud);
+} /* }}} int clua_callback_register */
 
-  if (status != 0)
-    return luaL_error(L, "%s", "plugin_register_complex_read failed");
-  return 0;
-} /* }}} int lua_cb_register_read */
-
-static int lua_cb_register_write(lua_State *L) /* {{{ */
+static int clua_register_callback(lua_State *L, bool is_write) /* {{{ */
 {
   int nargs = lua_gettop(L);
 
@@ -316,37 +402,82 @@ static int lua_cb_register_write(lua_State *L) /* {{{ */
 
   luaL_checktype(L, 1, LUA_TFUNCTION);
 
-  char function_name[DATA_MAX_NAME_LEN] = "";
-  snprintf(function_name, sizeof(function_name), "lua/%s", lua_tostring(L, 1));
+  size_t index = 0;
+  lua_script_t *script = clua_get_script(L, &index);
+  if (script == NULL)
+    return luaL_error(L, "%s", "Unable to determine the calling script");
+
+  /* Each state would register its own copy of the callback. */
+  if (script->loaded && (script->states_num > 1))
+    return luaL_error(L, "%s",
+                      "Callbacks must be registered while the script is "
+                      "loaded if it runs in more than one state");
 
   int callback_id = clua_store_callback(L, 1);
   if (callback_id < 0)
     return luaL_error(L, "%s", "Storing callback function failed");
 
-  lua_State *thread = lua_newthread(L);
-  if (thread == NULL)
-    return luaL_error(L, "%s", "lua_newthread failed");
-  clua_store_thread(L, -1);
-  lua_pop(L, 1);
+  /* The other states load the same script and register the same callbacks
+   * in the same order as the first one. */
+  if (index > 0) {
+    size_t n = script->callbacks_loaded++;
+    if ((n >= script->callbacks_num) ||
+        (script->callbacks[n]->is_write != is_write))
+      return luaL_error(L, "%s", "The script registered different callbacks "
+                                 "in its states");
+
+    script->callbacks[n]->callback_ids[index] = callback_id;
+    return 0;
+  }
+
+  char function_name[DATA_MAX_NAME_LEN];
+  snprintf(function_name, sizeof(function_name), "lua/%s", lua_tostring(L, 1));
 
   clua_callback_data_t *cb = calloc(1, sizeof(*cb));
   if (cb == NULL)
     return luaL_error(L, "%s", "calloc failed");
 
-  cb->lua_state = thread;
-  cb->callback_id = callback_id;
+  cb->script = script;
+  cb->is_write = is_write;
   cb->lua_function_name = strdup(function_name);
-  pthread_mutex_init(&cb->lock, NULL);
+  cb->callback_ids = calloc(script->states_num, sizeof(*cb->callback_ids));
+  if ((cb->lua_function_name == NULL) || (cb->callback_ids == NULL)) {
+    clua_callback_free(cb);
+    return luaL_error(L, "%s", "calloc failed");
+  }
+  cb->callback_ids[0] = callback_id;
+
+  if (script->loaded) {
+    int status = clua_callback_register(cb);
+    if (status != 0)
+      return luaL_error(L, "%s", is_write
+                                     ? "plugin_register_write failed"
+                                     : "plugin_register_complex_read failed");
+    return 0;
+  }
 
-  int status = plugin_register_write(/* name = */ function_name,
-                                     /* callback  = */ clua_write,
-                                     &(user_data_t){
-                                         .data = cb,
-                                     });
+  clua_callback_data_t **tmp =
+      realloc(script->callbacks,
+              (script->callbacks_num + 1) * sizeof(*script->callbacks));
+  if (tmp == NULL) {
+    clua_callback_free(cb);
+    return luaL_error(L, "%s", "realloc failed");
+  }
+  script->callbacks = tmp;
+  script->callbacks[script->callbacks_num++] = cb;
+  script->callbacks_loaded = script->callbacks_num;
 
-  if (status != 0)
-    return luaL_error(L, "%s", "plugin_register_write failed");
   return 0;
+} /* }}} int clua_register_callback */
+
+static int lua_cb_register_read(lua_State *L) /* {{{ */
+{
+  return clua_register_callback(L, /* is_write = */ false);
+} /* }}} int lua_cb_register_read */
+
+static int lua_cb_register_write(lua_State *L) /* {{{ */
+{
+  return clua_register_callback(L, /* is_write = */ true);
 } /* }}} int lua_cb_register_write */
 
 static const luaL_Reg collectdlib[] = {
@@ -377,10 +508,22 @@ static void lua_script_free(lua_script_t *script) /* {{{ */
 
   lua_script_t *next = script->next;
 
-  if (script->lua_state != NULL) {
-    lua_close(script->lua_state);
-    script->lua_state = NULL;
+  for (size_t i = 0; i < script->states_num; i++) {
+    if (script->states[i] != NULL) {
+      lua_close(script->states[i]);
+      script->states[i] = NULL;
+    }
   }
+  sfree(script->states);
+  sfree(script->idle);
+
+  /* Callbacks which have been registered with the daemon are freed by it. */
+  for (size_t i = 0; i < script->callbacks_num; i++)
+    clua_callback_free(script->callbacks[i]);
+  sfree(script->callbacks);
+
+  pthread_mutex_destroy(&script->lock);
+  pthread_cond_destroy(&script->cond);
 
   sfree(script->script_path);
   sfree(script);
@@ -388,86 +531,78 @@ static void lua_script_free(lua_script_t *script) /* {{{ */
   lua_script_free(next);
 } /* }}} void lua_script_free */
 
-static int lua_script_init(lua_script_t *script) /* {{{ */
-{
-  memset(script, 0, sizeof(*script));
-
+static lua_State *lua_script_new_state(lua_script_t *script, /* {{{ */
+                                       size_t index) {
   /* initialize the lua context */
-  script->lua_state = luaL_newstate();
-  if (script->lua_state == NULL) {
+  lua_State *L = luaL_newstate();
+  if (L == NULL) {
     ERROR("Lua plugin: luaL_newstate() failed.");
-    return -1;
+    return NULL;
   }
 
   /* Open up all the standard Lua libraries. */
-  luaL_openlibs(script->lua_state);
+  luaL_openlibs(L);
 
 /* Load the 'collectd' library */
 #if LUA_VERSION_NUM < 502
-  lua_pushcfunction(script->lua_state, open_collectd);
-  lua_pushstring(script->lua_state, "collectd");
-  lua_call(script->lua_state, 1, 0);
+  lua_pushcfunction(L, open_collectd);
+  lua_pushstring(L, "collectd");
+  lua_call(L, 1, 0);
 #else
-  luaL_requiref(script->lua_state, "collectd", open_collectd, 1);
-  lua_pop(script->lua_state, 1);
+  luaL_requiref(L, "collectd", open_collectd, 1);
+  lua_pop(L, 1);
 #endif
 
   /* Prepend BasePath to package.path */
   if (base_path[0] != '\0') {
-    lua_getglobal(script->lua_state, "package");
-    lua_getfield(script->lua_state, -1, "path");
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "path");
 
-    const char *cur_path = lua_tostring(script->lua_state, -1);
+    const char *cur_path = lua_tostring(L, -1);
     char *new_path = ssnprintf_alloc("%s/?.lua;%s", base_path, cur_path);
 
-    lua_pop(script->lua_state, 1);
-    lua_pushstring(script->lua_state, new_path);
+    lua_pop(L, 1);
+    lua_pushstring(L, new_path);
 
     free(new_path);
 
-    lua_setfield(script->lua_state, -2, "path");
-    lua_pop(script->lua_state, 1);
+    lua_setfield(L, -2, "path");
+    lua_pop(L, 1);
   }
 
-  return 0;
-} /* }}} int lua_script_init */
+  /* Remember the script and index, see clua_get_script(). */
+  lua_pushlightuserdata(L, &script_key);
+  lua_pushlightuserdata(L, script);
+  lua_rawset(L, LUA_REGISTRYINDEX);
 
-static int lua_script_load(const char *script_path) /* {{{ */
-{
-  lua_script_t *script = malloc(sizeof(*script));
-  if (script == NULL) {
-    ERROR("Lua plugin: malloc failed.");
-    return -1;
-  }
+  lua_pushlightuserdata(L, &state_index_key);
+  lua_pushinteger(L, (lua_Integer)index);
+  lua_rawset(L, LUA_REGISTRYINDEX);
 
-  int status = lua_script_init(script);
-  if (status != 0) {
-    lua_script_free(script);
-    return status;
-  }
+  return L;
+} /* }}} lua_State *lua_script_new_state */
 
-  script->script_path = strdup(script_path);
-  if (script->script_path == NULL) {
-    ERROR("Lua plugin: strdup failed.");
-    lua_script_free(script);
+static int lua_script_run(lua_script_t *script, size_t index) /* {{{ */
+{
+  lua_State *L = lua_script_new_state(script, index);
+  if (L == NULL)
     return -1;
-  }
+  script->states[index] = L;
+  script->callbacks_loaded = 0;
 
-  status = luaL_loadfile(script->lua_state, script->script_path);
+  int status = luaL_loadfile(L, script->script_path);
   if (status != 0) {
-    ERROR("Lua plugin: luaL_loadfile failed: %s",
-          lua_tostring(script->lua_state, -1));
-    lua_pop(script->lua_state, 1);
-    lua_script_free(script);
+    ERROR("Lua plugin: luaL_loadfile failed: %s", lua_tostring(L, -1));
+    lua_pop(L, 1);
     return -1;
   }
 
-  status = lua_pcall(script->lua_state,
+  status = lua_pcall(L,
                      /* nargs = */ 0,
                      /* nresults = */ LUA_MULTRET,
                      /* errfunc = */ 0);
   if (status != 0) {
-    const char *errmsg = lua_tostring(script->lua_state, -1);
+    const char *errmsg = lua_tostring(L, -1);
 
     if (errmsg == NULL)
       ERROR("Lua plugin: lua_pcall failed with status %i. "
@@ -477,9 +612,50 @@ static int lua_script_load(const char *script_path) /* {{{ */
       ERROR("Lua plugin: Executing script \"%s\" failed:\n%s",
             script->script_path, errmsg);
 
+    return -1;
+  }
+
+  if (script->callbacks_loaded != script->callbacks_num) {
+    ERROR("Lua plugin: Script \"%s\" registered %" PRIsz " callbacks in "
+          "state %" PRIsz ", but %" PRIsz " in the first state.",
+          script->script_path, script->callbacks_loaded, index,
+          script->callbacks_num);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int lua_script_run */
+
+static int lua_script_load(const char *script_path) /* {{{ */
+{
+  lua_script_t *script = calloc(1, sizeof(*script));
+  if (script == NULL) {
+    ERROR("Lua plugin: calloc failed.");
+    return -1;
+  }
+  pthread_mutex_init(&script->lock, NULL);
+  pthread_cond_init(&script->cond, NULL);
+
+  script->script_path = strdup(script_path);
+  script->states = calloc(states_num, sizeof(*script->states));
+  script->idle = calloc(states_num, sizeof(*script->idle));
+  if ((script->script_path == NULL) || (script->states == NULL) ||
+      (script->idle == NULL)) {
+    ERROR("Lua plugin: calloc failed.");
     lua_script_free(script);
     return -1;
   }
+  script->states_num = states_num;
+
+  for (size_t i = 0; i < script->states_num; i++) {
+    int status = lua_script_run(script, i);
+    if (status != 0) {
+      lua_script_free(script);
+      return status;
+    }
+    script->idle[script->idle_num++] = i;
+  }
+  script->loaded = true;
 
   /* Append this script to the global list of scripts. */
   if (scripts) {
@@ -492,7 +668,22 @@ static int lua_script_load(const char *script_path) /* {{{ */
     scripts = script;
   }
 
-  return 0;
+  /* The daemon owns the callbacks from now on. */
+  int status = 0;
+  for (size_t i = 0; i < script->callbacks_num; i++) {
+    clua_callback_data_t *cb = script->callbacks[i];
+
+    if (clua_callback_register(cb) != 0) {
+      ERROR("Lua plugin: Registering callback \"%s\" of script \"%s\" "
+            "failed.",
+            cb->lua_function_name, script->script_path);
+      status = -1;
+    }
+  }
+  sfree(script->callbacks);
+  script->callbacks_num = 0;
+
+  return status;
 } /* }}} int lua_script_load */
 
 static int lua_config_base_path(const oconfig_item_t *ci) /* {{{ */
@@ -512,6 +703,23 @@ static int lua_config_base_path(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int lua_config_base_path */
 
+static int lua_config_states(const oconfig_item_t *ci) /* {{{ */
+{
+  int value = 0;
+
+  int status = cf_util_get_int(ci, &value);
+  if (status != 0)
+    return status;
+
+  if (value < 1) {
+    ERROR("Lua plugin: The `States' option requires a positive integer.");
+    return -1;
+  }
+
+  states_num = (size_t)value;
+  return 0;
+} /* }}} int lua_config_states */
+
 static int lua_config_script(const oconfig_item_t *ci) /* {{{ */
 {
   char rel_path[PATH_MAX];
@@ -541,6 +749,7 @@ static int lua_config_script(const oconfig_item_t *ci) /* {{{ */
 /*
  * <Plugin lua>
  *   BasePath "/"
+ *   States 4
  *   Script "script1.lua"
  *   Script "script2.lua"
  * </Plugin>
@@ -553,6 +762,8 @@ static int lua_config(oconfig_item_t *ci) /* {{{ */
 
     if (strcasecmp("BasePath", child->key) == 0) {
       status = lua_config_base_path(child);
+    } else if (strcasecmp("States", child->key) == 0) {
+      status = lua_config_states(child);
     } else if (strcasecmp("Script", child->key) == 0) {
       status = lua_config_script(child);
     } else {
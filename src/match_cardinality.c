@@ -0,0 +1,386 @@
+/**
+ * collectd - src/match_cardinality.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "filter_chain.h"
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils/sketch/sketch.h"
+#include "utils_ident.h"
+
+#define MC_DEFAULT_BUDGET 10000
+#define MC_DEFAULT_TIMEOUT TIME_T_TO_CDTIME_T(3600)
+#define MC_DEFAULT_NOTIFICATION_INTERVAL TIME_T_TO_CDTIME_T(300)
+#define MC_DEFAULT_TOP_K 5
+/* The standard error of the estimate is about 3%. */
+#define MC_HLL_PRECISION 10
+/* Stale identifiers are removed at most this often. */
+#define MC_SWEEP_INTERVAL TIME_T_TO_CDTIME_T(1)
+
+/*
+ * private data types
+ */
+
+/* The identifiers a plugin has been granted, stored by hash in an open
+ * addressing table. A hash of zero marks an empty slot. */
+typedef struct {
+  uint64_t hash;
+  cdtime_t last_seen;
+} mc_slot_t;
+
+typedef struct {
+  char plugin[DATA_MAX_NAME_LEN];
+
+  mc_slot_t *slots;
+  size_t slots_num;
+  size_t used;
+
+  /* Distinct identifiers and rejected identifiers grouped by plugin instance
+   * and type, since the last notification. */
+  c_hll_t *seen;
+  c_topk_t *offenders;
+  uint64_t rejected;
+
+  cdtime_t last_sweep;
+  cdtime_t last_notification;
+  /* Start of the period the counts above refer to. */
+  cdtime_t window_start;
+} mc_plugin_t;
+
+typedef struct {
+  size_t budget;
+  cdtime_t timeout;
+  cdtime_t notification_interval;
+  size_t top_k;
+
+  pthread_mutex_t lock;
+  c_avl_tree_t *plugins;
+} mc_match_t;
+
+/*
+ * internal helper functions
+ */
+static void mc_plugin_destroy(mc_plugin_t *p) /* {{{ */
+{
+  if (p == NULL)
+    return;
+
+  sfree(p->slots);
+  c_hll_destroy(p->seen);
+  c_topk_destroy(p->offenders);
+  sfree(p);
+} /* }}} void mc_plugin_destroy */
+
+static mc_plugin_t *mc_plugin_create(mc_match_t *m, char const *plugin) /* {{{ */
+{
+  mc_plugin_t *p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    return NULL;
+
+  sstrncpy(p->plugin, plugin, sizeof(p->plugin));
+  p->seen = c_hll_create(MC_HLL_PRECISION);
+  p->offenders = c_topk_create(m->top_k);
+  if ((p->seen == NULL) || (p->offenders == NULL)) {
+    mc_plugin_destroy(p);
+    return NULL;
+  }
+  p->last_sweep = cdtime();
+
+  return p;
+} /* }}} mc_plugin_t *mc_plugin_create */
+
+static mc_slot_t *mc_find_slot(mc_slot_t *slots, size_t slots_num, /* {{{ */
+                               uint64_t hash) {
+  size_t mask = slots_num - 1;
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask)
+    if ((slots[i].hash == hash) || (slots[i].hash == 0))
+      return slots + i;
+} /* }}} mc_slot_t *mc_find_slot */
+
+/* Moves the identifiers seen within `timeout' into a table of `slots_num'
+ * slots. The table is only rebuilt, never shrunk in place, since removing
+ * entries from an open addressing table would break the probe sequences. */
+static int mc_rehash(mc_plugin_t *p, size_t slots_num, /* {{{ */
+                     cdtime_t expire) {
+  mc_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  size_t used = 0;
+  for (size_t i = 0; i < p->slots_num; i++) {
+    if ((p->slots[i].hash == 0) || (p->slots[i].last_seen < expire))
+      continue;
+    *mc_find_slot(slots, slots_num, p->slots[i].hash) = p->slots[i];
+    used++;
+  }
+
+  sfree(p->slots);
+  p->slots = slots;
+  p->slots_num = slots_num;
+  p->used = used;
+  return 0;
+} /* }}} int mc_rehash */
+
+/* Grants `hash' a slot unless the plugin has exhausted its budget. Returns
+ * true if the identifier may pass. */
+static bool mc_admit(mc_match_t *m, mc_plugin_t *p, uint64_t hash, /* {{{ */
+                     cdtime_t now) {
+  if (p->slots != NULL) {
+    mc_slot_t *s = mc_find_slot(p->slots, p->slots_num, hash);
+    if (s->hash == hash) {
+      s->last_seen = now;
+      return true;
+    }
+  }
+
+  if ((p->used >= m->budget) && (m->timeout > 0) &&
+      (now - p->last_sweep >= MC_SWEEP_INTERVAL)) {
+    mc_rehash(p, p->slots_num, now - m->timeout);
+    p->last_sweep = now;
+  }
+
+  if (p->used >= m->budget)
+    return false;
+
+  /* The table starts small and grows to twice the budget, which keeps the
+   * load factor at or below one half. */
+  if (2 * (p->used + 1) > p->slots_num) {
+    size_t slots_num = (p->slots_num > 0) ? 2 * p->slots_num : 64;
+    if (mc_rehash(p, slots_num, 0) != 0) {
+      ERROR("cardinality match: calloc failed.");
+      return true;
+    }
+  }
+
+  mc_slot_t *s = mc_find_slot(p->slots, p->slots_num, hash);
+  s->hash = hash;
+  s->last_seen = now;
+  p->used++;
+  return true;
+} /* }}} bool mc_admit */
+
+/* Describes the rejected identifiers since the last notification and resets
+ * their counts. */
+static void mc_format_notification(mc_match_t *m, mc_plugin_t *p, /* {{{ */
+                                   cdtime_t now, notification_t *n) {
+  size_t offenders_num = 0;
+  c_topk_entry_t const *offenders = c_topk_get(p->offenders, &offenders_num);
+
+  n->severity = NOTIF_WARNING;
+  n->time = now;
+  sstrncpy(n->host, hostname_g, sizeof(n->host));
+  sstrncpy(n->plugin, p->plugin, sizeof(n->plugin));
+
+  int len = snprintf(n->message, sizeof(n->message),
+                     "Plugin \"%s\" exceeded its budget of %" PRIsz
+                     " identifiers: %" PRIu64
+                     " new identifiers were dropped and about %.0f distinct "
+                     "identifiers were seen in the last %.0f seconds. "
+                     "Top offenders:",
+                     p->plugin, m->budget, p->rejected,
+                     c_hll_estimate(p->seen),
+                     CDTIME_T_TO_DOUBLE(now - p->window_start));
+  for (size_t i = 0; i < offenders_num; i++) {
+    if ((len < 0) || ((size_t)len >= sizeof(n->message)))
+      break;
+    len += snprintf(n->message + len, sizeof(n->message) - len,
+                    "%s %s (%" PRIu64 ")", (i == 0) ? "" : ",",
+                    offenders[i].key, offenders[i].count);
+  }
+
+  p->rejected = 0;
+  c_hll_clear(p->seen);
+  c_topk_clear(p->offenders);
+  p->last_notification = now;
+  p->window_start = now;
+} /* }}} void mc_format_notification */
+
+static int mc_compare(void const *a, void const *b) {
+  return strcmp(a, b);
+}
+
+static int mc_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
+{
+  mc_match_t *m = calloc(1, sizeof(*m));
+  if (m == NULL) {
+    ERROR("mc_create: calloc failed.");
+    return -ENOMEM;
+  }
+
+  int budget = MC_DEFAULT_BUDGET;
+  int top_k = MC_DEFAULT_TOP_K;
+  m->timeout = MC_DEFAULT_TIMEOUT;
+  m->notification_interval = MC_DEFAULT_NOTIFICATION_INTERVAL;
+
+  int status = 0;
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Budget", child->key) == 0)
+      status = cf_util_get_int(child, &budget);
+    else if (strcasecmp("Timeout", child->key) == 0)
+      status = cf_util_get_cdtime(child, &m->timeout);
+    else if (strcasecmp("NotificationInterval", child->key) == 0)
+      status = cf_util_get_cdtime(child, &m->notification_interval);
+    else if (strcasecmp("TopOffenders", child->key) == 0)
+      status = cf_util_get_int(child, &top_k);
+    else {
+      ERROR("cardinality match: The `%s' configuration option is not "
+            "understood and will be ignored.",
+            child->key);
+      status = 0;
+    }
+
+    if (status != 0)
+      break;
+  }
+
+  if ((status == 0) && (budget <= 0)) {
+    ERROR("cardinality match: `Budget' must be positive.");
+    status = -1;
+  }
+  if ((status == 0) && (top_k <= 0)) {
+    ERROR("cardinality match: `TopOffenders' must be positive.");
+    status = -1;
+  }
+  if (status == 0) {
+    m->plugins = c_avl_create(mc_compare);
+    if (m->plugins == NULL) {
+      ERROR("mc_create: c_avl_create failed.");
+      status = -ENOMEM;
+    }
+  }
+
+  if (status != 0) {
+    free(m);
+    return status;
+  }
+
+  m->budget = (size_t)budget;
+  m->top_k = (size_t)top_k;
+  pthread_mutex_init(&m->lock, NULL);
+
+  *user_data = m;
+  return 0;
+} /* }}} int mc_create */
+
+static int mc_destroy(void **user_data) /* {{{ */
+{
+  if ((user_data == NULL) || (*user_data == NULL))
+    return 0;
+
+  mc_match_t *m = *user_data;
+
+  char *name;
+  mc_plugin_t *p;
+  while (c_avl_pick(m->plugins, (void *)&name, (void *)&p) == 0)
+    mc_plugin_destroy(p);
+  c_avl_destroy(m->plugins);
+
+  pthread_mutex_destroy(&m->lock);
+  sfree(m);
+  *user_data = NULL;
+
+  return 0;
+} /* }}} int mc_destroy */
+
+static int mc_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
+                    const value_list_t *vl,
+                    notification_meta_t __attribute__((unused)) * *meta,
+                    void **user_data) {
+  if ((user_data == NULL) || (*user_data == NULL))
+    return -1;
+
+  mc_match_t *m = *user_data;
+
+  uint64_t hash;
+  if (vl->ident != NULL) {
+    hash = vl->ident->hash;
+  } else {
+    char name[6 * DATA_MAX_NAME_LEN];
+    if (FORMAT_VL(name, sizeof(name), vl) != 0)
+      return -1;
+    hash = ident_hash(name);
+  }
+  /* Zero marks an empty slot. */
+  if (hash == 0)
+    hash = 1;
+
+  cdtime_t now = cdtime();
+  bool admitted;
+  bool notify = false;
+  notification_t n = {0};
+
+  pthread_mutex_lock(&m->lock);
+
+  mc_plugin_t *p = NULL;
+  if (c_avl_get(m->plugins, vl->plugin, (void *)&p) != 0) {
+    p = mc_plugin_create(m, vl->plugin);
+    if ((p == NULL) || (c_avl_insert(m->plugins, p->plugin, p) != 0)) {
+      mc_plugin_destroy(p);
+      pthread_mutex_unlock(&m->lock);
+      ERROR("cardinality match: Adding plugin \"%s\" failed.", vl->plugin);
+      return -1;
+    }
+    /* The first rejection is reported at once. */
+    p->last_notification = now - m->notification_interval;
+    p->window_start = now;
+  }
+
+  c_hll_add(p->seen, hash);
+  admitted = mc_admit(m, p, hash, now);
+
+  if (!admitted) {
+    char key[2 * DATA_MAX_NAME_LEN];
+    if (vl->plugin_instance[0] != 0)
+      snprintf(key, sizeof(key), "%s/%s", vl->plugin_instance, vl->type);
+    else
+      sstrncpy(key, vl->type, sizeof(key));
+    c_topk_add(p->offenders, key);
+    p->rejected++;
+  }
+
+  if ((p->rejected > 0) &&
+      (now - p->last_notification >= m->notification_interval)) {
+    mc_format_notification(m, p, now, &n);
+    notify = true;
+  }
+
+  pthread_mutex_unlock(&m->lock);
+
+  /* Notification plugins may end up here again. */
+  if (notify)
+    plugin_dispatch_notification(&n);
+
+  return admitted ? FC_MATCH_NO_MATCH : FC_MATCH_MATCHES;
+} /* }}} int mc_match */
+
+void module_register(void) {
+  match_proc_t mproc = {0};
+
+  mproc.create = mc_create;
+  mproc.destroy = mc_destroy;
+  mproc.match = mc_match;
+  fc_register_match("cardinality", mproc);
+} /* module_register */
@@ -0,0 +1,262 @@
+/**
+ * collectd - src/match_deadband.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * This module matches value lists that haven't changed enough since the last
+ * value list of the same series that didn't match, so that a rule can stop
+ * them from being written.
+ */
+
+#include "collectd.h"
+
+#include "filter_chain.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+#define MD_DEFAULT_HEARTBEAT 10
+
+/* Returned by md_update() if the value list is within the deadband. */
+#define MD_SUPPRESS 1
+
+/*
+ * private data types
+ */
+typedef struct {
+  /* Deadbands of gauges; NAN if not set. "relative" is a fraction of the
+   * last value. */
+  gauge_t absolute;
+  gauge_t relative;
+  /* Every this many intervals, a value list doesn't match regardless of
+   * its values. Zero disables the heartbeat. */
+  unsigned heartbeat;
+} md_match_t;
+
+/* Argument of md_update(). */
+typedef struct {
+  const data_set_t *ds;
+  const value_list_t *vl;
+  md_match_t const *m;
+} md_state_update_t;
+
+/*
+ * internal helper functions
+ */
+static bool md_gauge_within(md_match_t const *m, gauge_t last, /* {{{ */
+                            gauge_t curr) {
+  if (isnan(last) || isnan(curr))
+    return isnan(last) && isnan(curr);
+
+  gauge_t diff = fabs(curr - last);
+  if (!isnan(m->absolute) && (diff > m->absolute))
+    return false;
+  if (!isnan(m->relative) && (diff > m->relative * fabs(last)))
+    return false;
+  /* Without any deadband, only unchanged values match. */
+  if (isnan(m->absolute) && isnan(m->relative) && (diff != 0.0))
+    return false;
+
+  return true;
+} /* }}} bool md_gauge_within */
+
+/* Compares the value of a data source with the one last stored. Counters
+ * only match if they haven't changed at all. */
+static bool md_value_within(md_match_t const *m, meta_data_t *meta, /* {{{ */
+                            char const *key, int ds_type, value_t v) {
+  if (ds_type == DS_TYPE_GAUGE) {
+    double last;
+    return (meta_data_get_double(meta, key, &last) == 0) &&
+           md_gauge_within(m, (gauge_t)last, v.gauge);
+  } else if (ds_type == DS_TYPE_DERIVE) {
+    int64_t last;
+    return (meta_data_get_signed_int(meta, key, &last) == 0) &&
+           (last == v.derive);
+  }
+
+  uint64_t last;
+  uint64_t curr = (ds_type == DS_TYPE_COUNTER) ? (uint64_t)v.counter
+                                               : (uint64_t)v.absolute;
+  return (meta_data_get_unsigned_int(meta, key, &last) == 0) &&
+         (last == curr);
+} /* }}} bool md_value_within */
+
+static void md_value_store(meta_data_t *meta, char const *key, /* {{{ */
+                           int ds_type, value_t v) {
+  if (ds_type == DS_TYPE_GAUGE)
+    meta_data_add_double(meta, key, (double)v.gauge);
+  else if (ds_type == DS_TYPE_DERIVE)
+    meta_data_add_signed_int(meta, key, (int64_t)v.derive);
+  else if (ds_type == DS_TYPE_COUNTER)
+    meta_data_add_unsigned_int(meta, key, (uint64_t)v.counter);
+  else
+    meta_data_add_unsigned_int(meta, key, (uint64_t)v.absolute);
+} /* }}} void md_value_store */
+
+/* Called with the cache entry locked. Stores the values unless they are
+ * within the deadband of the stored ones. */
+static int md_update(meta_data_t *meta, void *arg) /* {{{ */
+{
+  md_state_update_t *u = arg;
+  md_match_t const *m = u->m;
+  value_list_t const *vl = u->vl;
+
+  char key_time[64];
+  snprintf(key_time, sizeof(key_time), "match_deadband[%p]:time",
+           (void const *)m);
+
+  bool suppress = true;
+  uint64_t last_time;
+  if (meta_data_get_unsigned_int(meta, key_time, &last_time) != 0)
+    suppress = false;
+  else if ((m->heartbeat > 0) && (vl->interval > 0)) {
+    /* Rounded to whole intervals, since the times jitter a little. */
+    cdtime_t age = vl->time - (cdtime_t)last_time + vl->interval / 2;
+    if (age / vl->interval >= m->heartbeat)
+      suppress = false;
+  }
+
+  char key[64];
+  for (size_t i = 0; suppress && (i < u->ds->ds_num); i++) {
+    snprintf(key, sizeof(key), "match_deadband[%p,%" PRIsz "]:value",
+             (void const *)m, i);
+    suppress = md_value_within(m, meta, key, u->ds->ds[i].type, vl->values[i]);
+  }
+
+  if (suppress)
+    return MD_SUPPRESS;
+
+  for (size_t i = 0; i < u->ds->ds_num; i++) {
+    snprintf(key, sizeof(key), "match_deadband[%p,%" PRIsz "]:value",
+             (void const *)m, i);
+    md_value_store(meta, key, u->ds->ds[i].type, vl->values[i]);
+  }
+  meta_data_add_unsigned_int(meta, key_time, (uint64_t)vl->time);
+
+  return 0;
+} /* }}} int md_update */
+
+static int md_config_get_gauge(oconfig_item_t const *ci, /* {{{ */
+                               gauge_t *ret) {
+  double d;
+  int status = cf_util_get_double(ci, &d);
+  if (status != 0)
+    return status;
+
+  if (!(d >= 0.0)) {
+    ERROR("`deadband' match: The `%s' option must not be negative.", ci->key);
+    return -1;
+  }
+
+  *ret = (gauge_t)d;
+  return 0;
+} /* }}} int md_config_get_gauge */
+
+static int md_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
+{
+  md_match_t *m = calloc(1, sizeof(*m));
+  if (m == NULL) {
+    ERROR("md_create: calloc failed.");
+    return -ENOMEM;
+  }
+
+  m->absolute = NAN;
+  m->relative = NAN;
+  int heartbeat = MD_DEFAULT_HEARTBEAT;
+
+  int status = 0;
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Absolute", child->key) == 0)
+      status = md_config_get_gauge(child, &m->absolute);
+    else if (strcasecmp("Relative", child->key) == 0) {
+      status = md_config_get_gauge(child, &m->relative);
+      /* Configured in percent. */
+      m->relative /= 100.0;
+    } else if (strcasecmp("Heartbeat", child->key) == 0)
+      status = cf_util_get_int(child, &heartbeat);
+    else {
+      ERROR("`deadband' match: The `%s' configuration option is not "
+            "understood and will be ignored.",
+            child->key);
+      status = 0;
+    }
+
+    if (status != 0)
+      break;
+  }
+
+  if ((status == 0) && (heartbeat < 0)) {
+    ERROR("`deadband' match: `Heartbeat' must not be negative.");
+    status = -1;
+  }
+
+  if (status != 0) {
+    free(m);
+    return status;
+  }
+
+  m->heartbeat = (unsigned)heartbeat;
+
+  *user_data = m;
+  return 0;
+} /* }}} int md_create */
+
+static int md_destroy(void **user_data) /* {{{ */
+{
+  if (user_data != NULL) {
+    sfree(*user_data);
+  }
+  return 0;
+} /* }}} int md_destroy */
+
+static int md_match(const data_set_t *ds, const value_list_t *vl, /* {{{ */
+                    notification_meta_t __attribute__((unused)) * *meta,
+                    void **user_data) {
+  if ((ds == NULL) || (vl == NULL) || (user_data == NULL) ||
+      (*user_data == NULL))
+    return -EINVAL;
+
+  md_state_update_t u = {
+      .ds = ds, .vl = vl, .m = *user_data,
+  };
+
+  /* The state is kept in the value cache, so value lists that aren't in the
+   * cache (yet) never match. */
+  int status = uc_meta_data_update(vl, md_update, &u);
+  if (status == MD_SUPPRESS)
+    return FC_MATCH_MATCHES;
+  else if ((status != 0) && (status != ENOENT))
+    ERROR("`deadband' match: uc_meta_data_update failed with status %i.",
+          status);
+
+  return FC_MATCH_NO_MATCH;
+} /* }}} int md_match */
+
+void module_register(void) {
+  match_proc_t mproc = {0};
+
+  mproc.create = md_create;
+  mproc.destroy = md_destroy;
+  mproc.match = md_match;
+  fc_register_match("deadband", mproc);
+} /* module_register */
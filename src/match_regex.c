@@ -35,6 +35,7 @@
 
 #include "filter_chain.h"
 #include "utils/common/common.h"
+#include "utils/match_cache/match_cache.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_llist.h"
 
@@ -44,6 +45,9 @@
 #define log_err(...) ERROR("`regex' match: " __VA_ARGS__)
 #define log_warn(...) WARNING("`regex' match: " __VA_ARGS__)
 
+/* Number of identifiers whose result is remembered per match. */
+#define MR_CACHE_SIZE 1024
+
 /*
  * private data types
  */
@@ -67,6 +71,8 @@ struct mr_match_s {
   mr_regex_t *type_instance;
   llist_t *meta; /* Maps each meta key into mr_regex_t* */
   bool invert;
+  /* Results by identifier. NULL if meta data regexen are configured. */
+  c_match_cache_t *cache;
 };
 
 /*
@@ -100,6 +106,7 @@ static void mr_free_match(mr_match_t *m) /* {{{ */
     mr_free_regex((mr_regex_t *)e->value);
   }
   llist_destroy(m->meta);
+  c_match_cache_destroy(m->cache);
 
   sfree(m);
 } /* }}} void mr_free_match */
@@ -295,6 +302,10 @@ static int mr_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     return status;
   }
 
+  /* Meta data is not part of the cache key. */
+  if (m->meta == NULL)
+    m->cache = c_match_cache_create(MR_CACHE_SIZE);
+
   *user_data = m;
   return 0;
 } /* }}} int mr_create */
@@ -306,18 +317,41 @@ static int mr_destroy(void **user_data) /* {{{ */
   return 0;
 } /* }}} int mr_destroy */
 
-static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
-                    const value_list_t *vl,
-                    notification_meta_t __attribute__((unused)) * *meta,
-                    void **user_data) {
-  mr_match_t *m;
-  int match_value = FC_MATCH_MATCHES;
-  int nomatch_value = FC_MATCH_NO_MATCH;
+/* Appends the fields of `vl' that have regexen to `buffer'. Each field is
+ * terminated by a null byte. Returns the length of the key. */
+static size_t mr_cache_key(mr_match_t const *m, /* {{{ */
+                           value_list_t const *vl, char *buffer,
+                           size_t buffer_size) {
+  struct {
+    mr_regex_t const *re;
+    char const *field;
+  } fields[] = {
+      {m->host, vl->host},
+      {m->plugin, vl->plugin},
+      {m->plugin_instance, vl->plugin_instance},
+      {m->type, vl->type},
+      {m->type_instance, vl->type_instance},
+  };
+  size_t len = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    size_t field_len = (fields[i].re != NULL) ? strlen(fields[i].field) : 0;
+
+    if (len + field_len + 1 > buffer_size)
+      break;
+    memcpy(buffer + len, fields[i].field, field_len);
+    len += field_len;
+    buffer[len] = 0;
+    len++;
+  }
 
-  if ((user_data == NULL) || (*user_data == NULL))
-    return -1;
+  return len;
+} /* }}} size_t mr_cache_key */
 
-  m = *user_data;
+static int mr_match_uncached(mr_match_t *m, /* {{{ */
+                             const value_list_t *vl) {
+  int match_value = FC_MATCH_MATCHES;
+  int nomatch_value = FC_MATCH_NO_MATCH;
 
   if (m->invert) {
     match_value = FC_MATCH_NO_MATCH;
@@ -354,6 +388,34 @@ static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
   }
 
   return match_value;
+} /* }}} int mr_match_uncached */
+
+static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
+                    const value_list_t *vl,
+                    notification_meta_t __attribute__((unused)) * *meta,
+                    void **user_data) {
+  mr_match_t *m;
+  char key[5 * DATA_MAX_NAME_LEN];
+  size_t key_len = 0;
+  int status;
+
+  if ((user_data == NULL) || (*user_data == NULL))
+    return -1;
+
+  m = *user_data;
+
+  if (m->cache != NULL) {
+    key_len = mr_cache_key(m, vl, key, sizeof(key));
+    if (c_match_cache_get(m->cache, key, key_len, &status) == 0)
+      return status;
+  }
+
+  status = mr_match_uncached(m, vl);
+
+  if (m->cache != NULL)
+    c_match_cache_put(m->cache, key, key_len, status);
+
+  return status;
 } /* }}} int mr_match */
 
 void module_register(void) {
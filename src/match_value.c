@@ -33,6 +33,7 @@
 
 #include "filter_chain.h"
 #include "utils/common/common.h"
+#include "utils/ds_filter/ds_filter.h"
 #include "utils_cache.h"
 
 #define SATISFY_ALL 0
@@ -51,6 +52,7 @@ struct mv_match_s {
 
   char **data_sources;
   size_t data_sources_num;
+  c_ds_filter_t *filter;
 };
 
 /*
@@ -66,6 +68,7 @@ static void mv_free_match(mv_match_t *m) /* {{{ */
       free(m->data_sources[i]);
     free(m->data_sources);
   }
+  c_ds_filter_destroy(m->filter);
 
   free(m);
 } /* }}} void mv_free_match */
@@ -224,6 +227,14 @@ static int mv_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     break;
   }
 
+  if (status == 0) {
+    m->filter = c_ds_filter_create(m->data_sources, m->data_sources_num);
+    if (m->filter == NULL) {
+      ERROR("`value' match: c_ds_filter_create failed.");
+      status = -ENOMEM;
+    }
+  }
+
   if (status != 0) {
     mv_free_match(m);
     return status;
@@ -259,50 +270,44 @@ static int mv_match(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     return -1;
   }
 
-  status = FC_MATCH_NO_MATCH;
-
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    int value_matches = 0;
-
-    /* Check if this data source is relevant. */
-    if (m->data_sources != NULL) {
-      size_t j;
-
-      for (j = 0; j < m->data_sources_num; j++)
-        if (strcasecmp(ds->ds[i].name, m->data_sources[j]) == 0)
-          break;
+  c_ds_selection_t const *sel = c_ds_filter_get(m->filter, ds);
+  if (sel == NULL) {
+    ERROR("`value' match: c_ds_filter_get failed.");
+    free(values);
+    return -1;
+  }
 
-      /* No match, ignore this data source. */
-      if (j >= m->data_sources_num)
-        continue;
+  /* An unset bound never excludes a value. NaN is within any range, since it
+   * compares false to both bounds. */
+  gauge_t min = isnan(m->min) ? -INFINITY : m->min;
+  gauge_t max = isnan(m->max) ? INFINITY : m->max;
+
+  /* Count the values within the range without branching on each of them,
+   * which lets the compiler vectorize the loops. */
+  size_t in_range = 0;
+  if (sel->all) {
+    for (size_t i = 0; i < sel->indices_num; i++)
+      in_range += !((values[i] < min) || (values[i] > max));
+  } else {
+    for (size_t i = 0; i < sel->indices_num; i++) {
+      gauge_t v = values[sel->indices[i]];
+      in_range += !((v < min) || (v > max));
     }
+  }
 
-    DEBUG("`value' match: current = %g; min = %g; max = %g; invert = %s;",
-          values[i], m->min, m->max, m->invert ? "true" : "false");
-
-    if ((!isnan(m->min) && (values[i] < m->min)) ||
-        (!isnan(m->max) && (values[i] > m->max)))
-      value_matches = 0;
-    else
-      value_matches = 1;
+  size_t matching = m->invert ? sel->indices_num - in_range : in_range;
 
-    if (m->invert) {
-      if (value_matches)
-        value_matches = 0;
-      else
-        value_matches = 1;
-    }
+  if (m->satisfy == SATISFY_ANY)
+    status = (matching > 0) ? FC_MATCH_MATCHES : FC_MATCH_NO_MATCH;
+  else /* SATISFY_ALL */
+    status = ((sel->indices_num > 0) && (matching == sel->indices_num))
+                 ? FC_MATCH_MATCHES
+                 : FC_MATCH_NO_MATCH;
 
-    if (value_matches != 0) {
-      status = FC_MATCH_MATCHES;
-      if (m->satisfy == SATISFY_ANY)
-        break;
-    } else {
-      status = FC_MATCH_NO_MATCH;
-      if (m->satisfy == SATISFY_ALL)
-        break;
-    }
-  } /* for (i = 0; i < ds->ds_num; i++) */
+  DEBUG("`value' match: %" PRIsz " of %" PRIsz " values match; min = %g; "
+        "max = %g; invert = %s;",
+        matching, sel->indices_num, m->min, m->max,
+        m->invert ? "true" : "false");
 
   free(values);
   return status;
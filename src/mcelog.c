@@ -31,8 +31,8 @@
 
 #include "collectd.h"
 
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
-#include "utils_llist.h"
 
 #include <poll.h>
 #include <sys/socket.h>
@@ -50,13 +50,18 @@
 #define MCELOG_UNCORRECTED_ERR_TIMED "uncorrected memory timed errors"
 #define MCELOG_CORRECTED_ERR_TYPE_INS "corrected_memory_errors"
 #define MCELOG_UNCORRECTED_ERR_TYPE_INS "uncorrected_memory_errors"
+#define MCELOG_CORRECTED_ERR_SINCE                                             \
+  "corrected memory errors since last notification"
+#define MCELOG_UNCORRECTED_ERR_SINCE                                           \
+  "uncorrected memory errors since last notification"
 
 typedef struct mcelog_config_s {
-  char logfile[PATH_MAX];     /* mcelog logfile */
-  pthread_t tid;              /* poll thread id */
-  llist_t *dimms_list;        /* DIMMs list */
-  pthread_mutex_t dimms_lock; /* lock for dimms cache */
+  char logfile[PATH_MAX];          /* mcelog logfile */
+  pthread_t tid;                   /* poll thread id */
+  c_avl_tree_t *dimms;             /* DIMMs by location and name */
+  pthread_mutex_t dimms_lock;      /* lock for dimms cache */
   bool persist;
+  cdtime_t notification_interval; /* min. time between notifications */
 } mcelog_config_t;
 
 typedef struct socket_adapter_s socket_adapter_t;
@@ -83,6 +88,21 @@ typedef struct mcelog_memory_rec_s {
   char dimm_name[DATA_MAX_NAME_LEN / 2]; /* DMI_NAME "DIMM_F1" */
 } mcelog_memory_rec_t;
 
+/* The state of one kind of error of a DIMM: changes are coalesced until
+ * NotificationInterval has passed since the last notification. */
+typedef struct mcelog_notif_state_s {
+  bool pending;
+  cdtime_t last;
+  int last_total;
+} mcelog_notif_state_t;
+
+typedef struct mcelog_dimm_s {
+  char *name;
+  mcelog_memory_rec_t rec; /* as of the last record */
+  mcelog_notif_state_t corrected;
+  mcelog_notif_state_t uncorrected;
+} mcelog_dimm_t;
+
 static int socket_close(socket_adapter_t *self);
 static int socket_write(socket_adapter_t *self, const char *msg,
                         const size_t len);
@@ -109,17 +129,22 @@ static socket_adapter_t socket_adapter = {
 static bool mcelog_thread_running;
 static bool mcelog_apply_defaults;
 
-static void mcelog_free_dimms_list_records(llist_t *dimms_list) {
+static void mcelog_free_dimms(c_avl_tree_t *dimms) {
+  char *name;
+  mcelog_dimm_t *dimm;
+
+  if (dimms == NULL)
+    return;
 
-  for (llentry_t *e = llist_head(dimms_list); e != NULL; e = e->next) {
-    sfree(e->key);
-    sfree(e->value);
+  while (c_avl_pick(dimms, (void *)&name, (void *)&dimm) == 0) {
+    sfree(dimm->name);
+    sfree(dimm);
   }
+  c_avl_destroy(dimms);
 }
 
 /* Create or get dimm by dimm name/location */
-static llentry_t *mcelog_dimm(const mcelog_memory_rec_t *rec,
-                              llist_t *dimms_list) {
+static mcelog_dimm_t *mcelog_dimm(const mcelog_memory_rec_t *rec) {
 
   char dimm_name[DATA_MAX_NAME_LEN];
 
@@ -129,43 +154,44 @@ static llentry_t *mcelog_dimm(const mcelog_memory_rec_t *rec,
   } else
     sstrncpy(dimm_name, rec->location, sizeof(dimm_name));
 
-  llentry_t *dimm_le = llist_search(g_mcelog_config.dimms_list, dimm_name);
-
-  if (dimm_le != NULL)
-    return dimm_le;
+  mcelog_dimm_t *dimm = NULL;
+  pthread_mutex_lock(&g_mcelog_config.dimms_lock);
+  if (c_avl_get(g_mcelog_config.dimms, dimm_name, (void *)&dimm) == 0) {
+    pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
+    return dimm;
+  }
 
-  /* allocate new linked list entry */
-  mcelog_memory_rec_t *dimm_mr = calloc(1, sizeof(*dimm_mr));
-  if (dimm_mr == NULL) {
+  /* allocate new dimm */
+  dimm = calloc(1, sizeof(*dimm));
+  if (dimm == NULL) {
     ERROR(MCELOG_PLUGIN ": Error allocating dimm memory item");
+    pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
     return NULL;
   }
-  char *p_name = strdup(dimm_name);
-  if (p_name == NULL) {
+  dimm->name = strdup(dimm_name);
+  if (dimm->name == NULL) {
     ERROR(MCELOG_PLUGIN ": strdup: error");
-    free(dimm_mr);
+    free(dimm);
+    pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
     return NULL;
   }
 
   /* add new dimm */
-  dimm_le = llentry_create(p_name, dimm_mr);
-  if (dimm_le == NULL) {
-    ERROR(MCELOG_PLUGIN ": llentry_create(): error");
-    free(dimm_mr);
-    free(p_name);
-    return NULL;
+  if (c_avl_insert(g_mcelog_config.dimms, dimm->name, dimm) != 0) {
+    ERROR(MCELOG_PLUGIN ": c_avl_insert(): error");
+    free(dimm->name);
+    free(dimm);
+    dimm = NULL;
   }
-  pthread_mutex_lock(&g_mcelog_config.dimms_lock);
-  llist_append(g_mcelog_config.dimms_list, dimm_le);
   pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
 
-  return dimm_le;
+  return dimm;
 }
 
-static void mcelog_update_dimm_stats(llentry_t *dimm,
+static void mcelog_update_dimm_stats(mcelog_dimm_t *dimm,
                                      const mcelog_memory_rec_t *rec) {
   pthread_mutex_lock(&g_mcelog_config.dimms_lock);
-  memcpy(dimm->value, rec, sizeof(mcelog_memory_rec_t));
+  memcpy(&dimm->rec, rec, sizeof(dimm->rec));
   pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
 }
 
@@ -213,6 +239,13 @@ static int mcelog_config(oconfig_item_t *ci) {
                   mem_child->key);
             return -1;
           }
+        } else if (strcasecmp("NotificationInterval", mem_child->key) == 0) {
+          if (cf_util_get_cdtime(mem_child,
+                                 &g_mcelog_config.notification_interval) < 0) {
+            ERROR(MCELOG_PLUGIN ": Invalid configuration option: \"%s\".",
+                  mem_child->key);
+            return -1;
+          }
         } else {
           ERROR(MCELOG_PLUGIN ": Invalid Memory configuration option: \"%s\".",
                 mem_child->key);
@@ -315,41 +348,59 @@ static int socket_reinit(socket_adapter_t *self) {
   return ret;
 }
 
-static int mcelog_dispatch_mem_notifications(const mcelog_memory_rec_t *mr) {
-  notification_t n = {.severity = NOTIF_WARNING,
-                      .time = cdtime(),
-                      .plugin = MCELOG_PLUGIN,
-                      .type = "errors"};
+/* Returns true if a notification about one kind of error is due: the counts
+ * changed, now or since the last notification, and NotificationInterval has
+ * passed since the last notification. */
+static bool mcelog_notification_due(mcelog_notif_state_t *state, bool changed,
+                                    cdtime_t now) {
+  if (changed)
+    state->pending = true;
 
-  int dispatch_corrected_notifs = 0, dispatch_uncorrected_notifs = 0;
+  if (!state->pending)
+    return false;
 
-  if (mr == NULL)
-    return -1;
+  if ((state->last != 0) &&
+      (now - state->last < g_mcelog_config.notification_interval))
+    return false;
 
-  llentry_t *dimm = mcelog_dimm(mr, g_mcelog_config.dimms_list);
-  if (dimm == NULL) {
-    ERROR(MCELOG_PLUGIN
-          ": Error adding/getting dimm memory item to/from cache");
-    return -1;
-  }
-  mcelog_memory_rec_t *mr_old = dimm->value;
-  if (!g_mcelog_config.persist) {
+  return true;
+}
+
+static void mcelog_notification_sent(mcelog_notif_state_t *state, int total,
+                                     cdtime_t now) {
+  state->pending = false;
+  state->last = now;
+  state->last_total = total;
+}
 
-    if (mr_old->corrected_err_total != mr->corrected_err_total ||
-        mr_old->corrected_err_timed != mr->corrected_err_timed)
-      dispatch_corrected_notifs = 1;
+static int mcelog_dispatch_mem_notifications(mcelog_dimm_t *dimm,
+                                             const mcelog_memory_rec_t *mr) {
+  cdtime_t now = cdtime();
+  notification_t n = {.severity = NOTIF_WARNING,
+                      .time = now,
+                      .plugin = MCELOG_PLUGIN,
+                      .type = "errors"};
 
-    if (mr_old->uncorrected_err_total != mr->uncorrected_err_total ||
-        mr_old->uncorrected_err_timed != mr->uncorrected_err_timed)
-      dispatch_uncorrected_notifs = 1;
+  if ((dimm == NULL) || (mr == NULL))
+    return -1;
 
-    if (!dispatch_corrected_notifs && !dispatch_uncorrected_notifs) {
-      DEBUG("%s: No new notifications to dispatch", MCELOG_PLUGIN);
-      return 0;
-    }
-  } else {
-    dispatch_corrected_notifs = 1;
-    dispatch_uncorrected_notifs = 1;
+  mcelog_memory_rec_t *mr_old = &dimm->rec;
+  bool persist = g_mcelog_config.persist;
+  bool corrected_changed =
+      persist || (mr_old->corrected_err_total != mr->corrected_err_total) ||
+      (mr_old->corrected_err_timed != mr->corrected_err_timed);
+  bool uncorrected_changed =
+      persist || (mr_old->uncorrected_err_total != mr->uncorrected_err_total) ||
+      (mr_old->uncorrected_err_timed != mr->uncorrected_err_timed);
+
+  bool dispatch_corrected_notifs =
+      mcelog_notification_due(&dimm->corrected, corrected_changed, now);
+  bool dispatch_uncorrected_notifs =
+      mcelog_notification_due(&dimm->uncorrected, uncorrected_changed, now);
+
+  if (!dispatch_corrected_notifs && !dispatch_uncorrected_notifs) {
+    DEBUG("%s: No new notifications to dispatch", MCELOG_PLUGIN);
+    return 0;
   }
 
   sstrncpy(n.host, hostname_g, sizeof(n.host));
@@ -367,6 +418,9 @@ static int mcelog_dispatch_mem_notifications(const mcelog_memory_rec_t *mr) {
                                             mr->corrected_err_total);
     plugin_notification_meta_add_signed_int(&n, MCELOG_CORRECTED_ERR_TIMED,
                                             mr->corrected_err_timed);
+    plugin_notification_meta_add_signed_int(
+        &n, MCELOG_CORRECTED_ERR_SINCE,
+        mr->corrected_err_total - dimm->corrected.last_total);
     snprintf(n.message, sizeof(n.message), MCELOG_CORRECTED_ERR);
     sstrncpy(n.type_instance, MCELOG_CORRECTED_ERR_TYPE_INS,
              sizeof(n.type_instance));
@@ -375,6 +429,8 @@ static int mcelog_dispatch_mem_notifications(const mcelog_memory_rec_t *mr) {
       plugin_notification_meta_free(n.meta);
     n.meta = NULL;
   }
+  if (dispatch_corrected_notifs)
+    mcelog_notification_sent(&dimm->corrected, mr->corrected_err_total, now);
 
   if (dispatch_uncorrected_notifs &&
       (mr->uncorrected_err_total > 0 || mr->uncorrected_err_timed > 0)) {
@@ -383,6 +439,9 @@ static int mcelog_dispatch_mem_notifications(const mcelog_memory_rec_t *mr) {
                                             mr->uncorrected_err_total);
     plugin_notification_meta_add_signed_int(&n, MCELOG_UNCORRECTED_ERR_TIMED,
                                             mr->uncorrected_err_timed);
+    plugin_notification_meta_add_signed_int(
+        &n, MCELOG_UNCORRECTED_ERR_SINCE,
+        mr->uncorrected_err_total - dimm->uncorrected.last_total);
     snprintf(n.message, sizeof(n.message), MCELOG_UNCORRECTED_ERR);
     sstrncpy(n.type_instance, MCELOG_UNCORRECTED_ERR_TYPE_INS,
              sizeof(n.type_instance));
@@ -392,24 +451,20 @@ static int mcelog_dispatch_mem_notifications(const mcelog_memory_rec_t *mr) {
       plugin_notification_meta_free(n.meta);
     n.meta = NULL;
   }
+  if (dispatch_uncorrected_notifs)
+    mcelog_notification_sent(&dimm->uncorrected, mr->uncorrected_err_total,
+                             now);
 
   return 0;
 }
 
-static int mcelog_submit(const mcelog_memory_rec_t *mr) {
+static int mcelog_submit(mcelog_dimm_t *dimm, const mcelog_memory_rec_t *mr) {
 
-  if (!mr) {
+  if (!dimm || !mr) {
     ERROR(MCELOG_PLUGIN ": %s: NULL pointer", __FUNCTION__);
     return -1;
   }
 
-  llentry_t *dimm = mcelog_dimm(mr, g_mcelog_config.dimms_list);
-  if (dimm == NULL) {
-    ERROR(MCELOG_PLUGIN
-          ": Error adding/getting dimm memory item to/from cache");
-    return -1;
-  }
-
   value_list_t vl = {
       .values_len = 1,
       .values = &(value_t){.derive = (derive_t)mr->corrected_err_total},
@@ -598,9 +653,18 @@ static void *poll_worker(__attribute__((unused)) void *arg) {
         continue;
       }
 
-      if (mcelog_dispatch_mem_notifications(&memory_record) != 0)
+      /* Looked up once for the notifications and the values. */
+      mcelog_dimm_t *dimm = mcelog_dimm(&memory_record);
+      if (dimm == NULL) {
+        ERROR(MCELOG_PLUGIN
+              ": Error adding/getting dimm memory item to/from cache");
+        memset(&memory_record, 0, sizeof(memory_record));
+        continue;
+      }
+
+      if (mcelog_dispatch_mem_notifications(dimm, &memory_record) != 0)
         ERROR(MCELOG_PLUGIN ": Failed to submit memory errors notification");
-      if (mcelog_submit(&memory_record) != 0)
+      if (mcelog_submit(dimm, &memory_record) != 0)
         ERROR(MCELOG_PLUGIN ": Failed to submit memory errors");
       memset(&memory_record, 0, sizeof(memory_record));
     }
@@ -620,7 +684,12 @@ static int mcelog_init(void) {
          ": No configuration selected defaulting to memory errors.");
     memset(g_mcelog_config.logfile, 0, sizeof(g_mcelog_config.logfile));
   }
-  g_mcelog_config.dimms_list = llist_create();
+  g_mcelog_config.dimms =
+      c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (g_mcelog_config.dimms == NULL) {
+    ERROR(MCELOG_PLUGIN ": plugin: failed to create the dimms cache");
+    return -1;
+  }
   int err = pthread_mutex_init(&g_mcelog_config.dimms_lock, NULL);
   if (err < 0) {
     ERROR(MCELOG_PLUGIN ": plugin: failed to initialize cache lock");
@@ -671,9 +740,8 @@ static int mcelog_shutdown(void) {
     }
   }
   pthread_mutex_lock(&g_mcelog_config.dimms_lock);
-  mcelog_free_dimms_list_records(g_mcelog_config.dimms_list);
-  llist_destroy(g_mcelog_config.dimms_list);
-  g_mcelog_config.dimms_list = NULL;
+  mcelog_free_dimms(g_mcelog_config.dimms);
+  g_mcelog_config.dimms = NULL;
   pthread_mutex_unlock(&g_mcelog_config.dimms_lock);
   pthread_mutex_destroy(&g_mcelog_config.dimms_lock);
   ret = socket_adapter.close(&socket_adapter) || ret;
@@ -46,6 +46,9 @@
 #define MEMCACHED_DEF_PORT "11211"
 #define MEMCACHED_CONNECT_TIMEOUT 10000
 #define MEMCACHED_IO_TIMEOUT 5000
+#define MEMCACHED_BUFFER_SIZE 4096
+#define MEMCACHED_BUFFER_MAX (1024 * 1024)
+#define MEMCACHED_SLABS_MAX 64
 
 struct prev_s {
   derive_t hits;
@@ -64,11 +67,64 @@ struct memcached_s {
   char *socket;
   char *connhost;
   char *connport;
+  bool report_slabs;
   int fd;
   prev_t prev;
+
+  /* Receives the replies; grows up to MEMCACHED_BUFFER_MAX. */
+  char *buffer;
+  size_t buffer_size;
 };
 typedef struct memcached_s memcached_t;
 
+struct memcached_slab_s {
+  derive_t chunk_size;
+  derive_t used_chunks;
+  derive_t free_chunks;
+};
+typedef struct memcached_slab_s memcached_slab_t;
+
+/* Values of one read which are combined with others before dispatching. */
+struct memcached_stats_s {
+  memcached_t *st;
+
+  derive_t bytes_used;
+  derive_t bytes_total;
+  derive_t get_hits;
+  derive_t cmd_get;
+  derive_t incr_hits;
+  derive_t incr_misses;
+  derive_t decr_hits;
+  derive_t decr_misses;
+  derive_t rusage_user;
+  derive_t rusage_syst;
+  derive_t octets_rx;
+  derive_t octets_tx;
+
+  memcached_slab_t slabs[MEMCACHED_SLABS_MAX];
+};
+typedef struct memcached_stats_s memcached_stats_t;
+
+struct memcached_field_s;
+typedef struct memcached_field_s memcached_field_t;
+
+/* "slab" is the slab class for the fields of "stats slabs" and "stats items"
+ * and -1 otherwise. */
+typedef void (*memcached_handler_t)(memcached_stats_t *s,
+                                    memcached_field_t const *f, int slab,
+                                    char const *value);
+
+/* Maps the name of a statistic to the function handling it. "offset" is the
+ * position of the member in memcached_stats_t or memcached_slab_t the value
+ * is stored in, if any. */
+struct memcached_field_s {
+  char const *name;
+  memcached_handler_t handler;
+  char const *type;
+  char const *type_instance;
+  size_t offset;
+};
+
 static bool memcached_have_instances;
 
 static void memcached_free(void *arg) {
@@ -87,6 +143,7 @@ static void memcached_free(void *arg) {
   sfree(st->socket);
   sfree(st->connhost);
   sfree(st->connport);
+  sfree(st->buffer);
   sfree(st);
 }
 
@@ -213,10 +270,25 @@ static void memcached_connect(memcached_t *st) {
          st->name);
 }
 
-static int memcached_query_daemon(char *buffer, size_t buffer_size,
-                                  memcached_t *st) {
+static void memcached_close(memcached_t *st) {
+  shutdown(st->fd, SHUT_RDWR);
+  close(st->fd);
+  st->fd = -1;
+}
+
+/* Lines which terminate the reply to one command. */
+static bool memcached_is_reply_end(char const *line, size_t len) {
+  return ((len >= 3) && (memcmp(line, "END", 3) == 0)) ||
+         ((len >= 5) && (memcmp(line, "ERROR", 5) == 0)) ||
+         ((len >= 12) && (memcmp(line, "SERVER_ERROR", 12) == 0)) ||
+         ((len >= 12) && (memcmp(line, "CLIENT_ERROR", 12) == 0));
+}
+
+/* memcached_query_daemon sends all commands at once and receives the replies
+ * into st->buffer, which is null-terminated. Returns the number of bytes
+ * received or -1 on error. */
+static ssize_t memcached_query_daemon(memcached_t *st) {
   int status;
-  size_t buffer_fill;
 
   memcached_connect(st);
   if (st->fd < 0) {
@@ -225,6 +297,15 @@ static int memcached_query_daemon(char *buffer, size_t buffer_size,
     return -1;
   }
 
+  if (st->buffer == NULL) {
+    st->buffer = malloc(MEMCACHED_BUFFER_SIZE);
+    if (st->buffer == NULL) {
+      ERROR("memcached plugin: malloc failed.");
+      return -1;
+    }
+    st->buffer_size = MEMCACHED_BUFFER_SIZE;
+  }
+
   struct pollfd pollfd = {
       .fd = st->fd, .events = POLLOUT,
   };
@@ -240,22 +321,42 @@ static int memcached_query_daemon(char *buffer, size_t buffer_size,
     return -1;
   }
 
-  status = (int)swrite(st->fd, "stats\r\n", strlen("stats\r\n"));
+  char const *command = "stats\r\n";
+  size_t replies_expected = 1;
+  if (st->report_slabs) {
+    command = "stats\r\nstats slabs\r\nstats items\r\n";
+    replies_expected = 3;
+  }
+
+  status = (int)swrite(st->fd, command, strlen(command));
   if (status != 0) {
     ERROR("memcached plugin: Instance \"%s\": write(2) failed: %s", st->name,
           STRERRNO);
-    shutdown(st->fd, SHUT_RDWR);
-    close(st->fd);
-    st->fd = -1;
+    memcached_close(st);
     return -1;
   }
 
   /* receive data from the memcached daemon */
-  memset(buffer, 0, buffer_size);
-
-  buffer_fill = 0;
+  size_t buffer_fill = 0;
+  size_t scan_pos = 0;
+  size_t replies = 0;
   pollfd.events = POLLIN;
-  while (1) {
+  while (replies < replies_expected) {
+    /* Keep one byte for the terminating null byte. */
+    if (buffer_fill + 1 >= st->buffer_size) {
+      char *tmp = NULL;
+      if (st->buffer_size < MEMCACHED_BUFFER_MAX)
+        tmp = realloc(st->buffer, 2 * st->buffer_size);
+      if (tmp == NULL) {
+        WARNING("memcached plugin: Instance \"%s\": Message was truncated.",
+                st->name);
+        memcached_close(st);
+        break;
+      }
+      st->buffer = tmp;
+      st->buffer_size *= 2;
+    }
+
     do
       status = poll(&pollfd, 1, MEMCACHED_IO_TIMEOUT);
     while (status < 0 && errno == EINTR);
@@ -269,11 +370,10 @@ static int memcached_query_daemon(char *buffer, size_t buffer_size,
     }
 
     do
-      status = (int)recv(st->fd, buffer + buffer_fill,
-                         buffer_size - buffer_fill, /* flags = */ 0);
+      status = (int)recv(st->fd, st->buffer + buffer_fill,
+                         st->buffer_size - buffer_fill - 1, /* flags = */ 0);
     while (status < 0 && errno == EINTR);
 
-    char const end_token[5] = {'E', 'N', 'D', '\r', '\n'};
     if (status < 0) {
 
       if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
@@ -281,9 +381,7 @@ static int memcached_query_daemon(char *buffer, size_t buffer_size,
 
       ERROR("memcached plugin: Instance \"%s\": Error reading from socket: %s",
             st->name, STRERRNO);
-      shutdown(st->fd, SHUT_RDWR);
-      close(st->fd);
-      st->fd = -1;
+      memcached_close(st);
       return -1;
     } else if (status == 0) {
       ERROR("memcached plugin: Instance \"%s\": Connection closed by peer",
@@ -294,31 +392,28 @@ static int memcached_query_daemon(char *buffer, size_t buffer_size,
     }
 
     buffer_fill += (size_t)status;
-    if (buffer_fill > buffer_size) {
-      buffer_fill = buffer_size;
-      WARNING("memcached plugin: Instance \"%s\": Message was truncated.",
-              st->name);
-      shutdown(st->fd, SHUT_RDWR);
-      close(st->fd);
-      st->fd = -1;
-      break;
-    }
 
-    /* If buffer ends in end_token, we have all the data. */
-    if (memcmp(buffer + buffer_fill - sizeof(end_token), end_token,
-               sizeof(end_token)) == 0)
-      break;
+    /* Count the replies which are complete. */
+    char *eol;
+    while ((eol = memchr(st->buffer + scan_pos, '\n',
+                         buffer_fill - scan_pos)) != NULL) {
+      size_t line_len = (size_t)(eol - (st->buffer + scan_pos)) + 1;
+      if (memcached_is_reply_end(st->buffer + scan_pos, line_len))
+        replies++;
+      scan_pos += line_len;
+    }
   } /* while (recv) */
 
-  status = 0;
+  st->buffer[buffer_fill] = '\0';
+
   if (buffer_fill == 0) {
     WARNING("memcached plugin: Instance \"%s\": No data returned by memcached.",
             st->name);
-    status = -1;
+    return -1;
   }
 
-  return status;
-} /* int memcached_query_daemon */
+  return (ssize_t)buffer_fill;
+} /* ssize_t memcached_query_daemon */
 
 static void memcached_init_vl(value_list_t *vl, memcached_t const *st) {
   sstrncpy(vl->plugin, "memcached", sizeof(vl->plugin));
@@ -438,184 +533,270 @@ static gauge_t calculate_ratio_percent2(derive_t part1, derive_t part2,
   return 100.0 * (gauge_t)num / (gauge_t)denom;
 }
 
-static int memcached_read(user_data_t *user_data) {
-  char buf[4096];
-  char *fields[3];
-  char *line;
+/*
+ * Field handlers
+ */
+#define STATS_OFFSET(member) offsetof(memcached_stats_t, member)
+#define SLAB_OFFSET(member) offsetof(memcached_slab_t, member)
 
-  derive_t bytes_used = 0;
-  derive_t bytes_total = 0;
-  derive_t get_hits = 0;
-  derive_t cmd_get = 0;
-  derive_t incr_hits = 0;
-  derive_t incr_misses = 0;
-  derive_t decr_hits = 0;
-  derive_t decr_misses = 0;
-  derive_t rusage_user = 0;
-  derive_t rusage_syst = 0;
-  derive_t octets_rx = 0;
-  derive_t octets_tx = 0;
+static void memcached_gauge(memcached_stats_t *s, memcached_field_t const *f,
+                            int slab, char const *value) {
+  submit_gauge(f->type, f->type_instance, atof(value), s->st);
+}
 
-  memcached_t *st = user_data->data;
-  prev_t *prev = &st->prev;
+static void memcached_derive(memcached_stats_t *s, memcached_field_t const *f,
+                             int slab, char const *value) {
+  submit_derive(f->type, f->type_instance, atoll(value), s->st);
+}
 
-  /* get data from daemon */
-  if (memcached_query_daemon(buf, sizeof(buf), st) < 0) {
-    return -1;
-  }
+/* Stores the value for later and dispatches it if the field has a type. */
+static void memcached_store(memcached_stats_t *s, memcached_field_t const *f,
+                            int slab, char const *value) {
+  derive_t *ptr = (derive_t *)((char *)s + f->offset);
+  *ptr = atoll(value);
+  if (f->type != NULL)
+    submit_derive(f->type, f->type_instance, *ptr, s->st);
+}
 
-#define FIELD_IS(cnst)                                                         \
-  (((sizeof(cnst) - 1) == name_len) && (strcmp(cnst, fields[1]) == 0))
+/* Converts seconds to microseconds. */
+static void memcached_rusage(memcached_stats_t *s, memcached_field_t const *f,
+                             int slab, char const *value) {
+  derive_t *ptr = (derive_t *)((char *)s + f->offset);
+  *ptr = atof(value) * 1000000;
+}
 
-  char *ptr = buf;
-  char *saveptr = NULL;
-  while ((line = strtok_r(ptr, "\n\r", &saveptr)) != NULL) {
-    ptr = NULL;
+static void memcached_threads(memcached_stats_t *s, memcached_field_t const *f,
+                              int slab, char const *value) {
+  submit_gauge2("ps_count", NULL, NAN, atof(value), s->st);
+}
 
-    if (strsplit(line, fields, 3) != 3)
-      continue;
+static void memcached_slab_type_instance(char *buffer, size_t buffer_size,
+                                         memcached_field_t const *f, int slab) {
+  if (f->type_instance != NULL)
+    snprintf(buffer, buffer_size, "slab-%i-%s", slab, f->type_instance);
+  else
+    snprintf(buffer, buffer_size, "slab-%i", slab);
+}
 
-    size_t name_len = strlen(fields[1]);
-    if (name_len == 0)
-      continue;
+static void memcached_slab_gauge(memcached_stats_t *s,
+                                 memcached_field_t const *f, int slab,
+                                 char const *value) {
+  char type_instance[DATA_MAX_NAME_LEN];
+  memcached_slab_type_instance(type_instance, sizeof(type_instance), f, slab);
+  submit_gauge(f->type, type_instance, atof(value), s->st);
+}
 
-    /*
-     * For an explanation on these fields please refer to
-     * <https://github.com/memcached/memcached/blob/master/doc/protocol.txt>
-     */
-
-    /*
-     * CPU time consumed by the memcached process
-     */
-    if (FIELD_IS("rusage_user")) {
-      /* Convert to useconds */
-      rusage_user = atof(fields[2]) * 1000000;
-    } else if (FIELD_IS("rusage_system")) {
-      rusage_syst = atof(fields[2]) * 1000000;
-    }
+static void memcached_slab_derive(memcached_stats_t *s,
+                                  memcached_field_t const *f, int slab,
+                                  char const *value) {
+  char type_instance[DATA_MAX_NAME_LEN];
+  memcached_slab_type_instance(type_instance, sizeof(type_instance), f, slab);
+  submit_derive(f->type, type_instance, atoll(value), s->st);
+}
 
-    /*
-     * Number of threads of this instance
-     */
-    else if (FIELD_IS("threads")) {
-      submit_gauge2("ps_count", NULL, NAN, atof(fields[2]), st);
-    }
+static void memcached_slab_store(memcached_stats_t *s,
+                                 memcached_field_t const *f, int slab,
+                                 char const *value) {
+  derive_t *ptr = (derive_t *)((char *)(s->slabs + slab) + f->offset);
+  *ptr = atoll(value);
+}
 
-    /*
-     * Number of items stored
-     */
-    else if (FIELD_IS("curr_items")) {
-      submit_gauge("memcached_items", "current", atof(fields[2]), st);
-    }
+/*
+ * For an explanation on these fields please refer to
+ * <https://github.com/memcached/memcached/blob/master/doc/protocol.txt>
+ *
+ * The tables are sorted by name in memcached_init.
+ */
+static memcached_field_t memcached_stats_fields[] = {
+    /* CPU time consumed by the memcached process */
+    {"rusage_user", memcached_rusage, NULL, NULL, STATS_OFFSET(rusage_user)},
+    {"rusage_system", memcached_rusage, NULL, NULL, STATS_OFFSET(rusage_syst)},
+    /* Number of threads of this instance */
+    {"threads", memcached_threads, NULL, NULL, 0},
+    /* Number of items stored */
+    {"curr_items", memcached_gauge, "memcached_items", "current", 0},
+    /* Number of bytes used and available (total - used) */
+    {"bytes", memcached_store, NULL, NULL, STATS_OFFSET(bytes_used)},
+    {"limit_maxbytes", memcached_store, NULL, NULL, STATS_OFFSET(bytes_total)},
+    /* Connections */
+    {"curr_connections", memcached_gauge, "memcached_connections", "current",
+     0},
+    {"listen_disabled_num", memcached_derive, "total_events", "listen_disabled",
+     0},
+    /* Total number of connections opened since the server started running.
+     * Report this as connection rate. */
+    {"total_connections", memcached_derive, "connections", "opened", 0},
+    /* Increment/Decrement */
+    {"incr_misses", memcached_store, "memcached_ops", "incr_misses",
+     STATS_OFFSET(incr_misses)},
+    {"incr_hits", memcached_store, "memcached_ops", "incr_hits",
+     STATS_OFFSET(incr_hits)},
+    {"decr_misses", memcached_store, "memcached_ops", "decr_misses",
+     STATS_OFFSET(decr_misses)},
+    {"decr_hits", memcached_store, "memcached_ops", "decr_hits",
+     STATS_OFFSET(decr_hits)},
+    /* Operations on the cache: get hits/misses, delete hits/misses and
+     * evictions */
+    {"get_hits", memcached_store, "memcached_ops", "hits",
+     STATS_OFFSET(get_hits)},
+    {"get_misses", memcached_derive, "memcached_ops", "misses", 0},
+    {"evictions", memcached_derive, "memcached_ops", "evictions", 0},
+    {"delete_hits", memcached_derive, "memcached_ops", "delete_hits", 0},
+    {"delete_misses", memcached_derive, "memcached_ops", "delete_misses", 0},
+    /* Network traffic */
+    {"bytes_read", memcached_store, NULL, NULL, STATS_OFFSET(octets_rx)},
+    {"bytes_written", memcached_store, NULL, NULL, STATS_OFFSET(octets_tx)},
+};
 
-    /*
-     * Number of bytes used and available (total - used)
-     */
-    else if (FIELD_IS("bytes")) {
-      bytes_used = atoll(fields[2]);
-    } else if (FIELD_IS("limit_maxbytes")) {
-      bytes_total = atoll(fields[2]);
-    }
+/* "stats slabs" lines: STAT <slab>:<name> <value> */
+static memcached_field_t memcached_slabs_fields[] = {
+    {"chunk_size", memcached_slab_store, NULL, NULL, SLAB_OFFSET(chunk_size)},
+    {"used_chunks", memcached_slab_store, NULL, NULL, SLAB_OFFSET(used_chunks)},
+    {"free_chunks", memcached_slab_store, NULL, NULL, SLAB_OFFSET(free_chunks)},
+    {"mem_requested", memcached_slab_gauge, "bytes", "requested", 0},
+    {"get_hits", memcached_slab_derive, "memcached_ops", "hits", 0},
+    {"cmd_set", memcached_slab_derive, "memcached_command", "set", 0},
+};
 
-    /*
-     * Connections
-     */
-    else if (FIELD_IS("curr_connections")) {
-      submit_gauge("memcached_connections", "current", atof(fields[2]), st);
-    } else if (FIELD_IS("listen_disabled_num")) {
-      submit_derive("total_events", "listen_disabled", atoll(fields[2]), st);
-    }
-    /*
-     * Total number of connections opened since the server started running
-     * Report this as connection rate.
-     */
-    else if (FIELD_IS("total_connections")) {
-      submit_derive("connections", "opened", atoll(fields[2]), st);
-    }
+/* "stats items" lines: STAT items:<slab>:<name> <value> */
+static memcached_field_t memcached_items_fields[] = {
+    {"number", memcached_slab_gauge, "memcached_items", NULL, 0},
+    {"evicted", memcached_slab_derive, "memcached_ops", "evictions", 0},
+};
 
-    /*
-     * Commands
-     */
-    else if ((name_len > 4) && (strncmp(fields[1], "cmd_", 4) == 0)) {
-      const char *name = fields[1] + 4;
-      submit_derive("memcached_command", name, atoll(fields[2]), st);
-      if (strcmp(name, "get") == 0)
-        cmd_get = atoll(fields[2]);
-    }
+static int memcached_field_compare(void const *a, void const *b) {
+  memcached_field_t const *fa = a;
+  memcached_field_t const *fb = b;
+  return strcmp(fa->name, fb->name);
+}
 
-    /*
-     * Increment/Decrement
-     */
-    else if (FIELD_IS("incr_misses")) {
-      incr_misses = atoll(fields[2]);
-      submit_derive("memcached_ops", "incr_misses", incr_misses, st);
-    } else if (FIELD_IS("incr_hits")) {
-      incr_hits = atoll(fields[2]);
-      submit_derive("memcached_ops", "incr_hits", incr_hits, st);
-    } else if (FIELD_IS("decr_misses")) {
-      decr_misses = atoll(fields[2]);
-      submit_derive("memcached_ops", "decr_misses", decr_misses, st);
-    } else if (FIELD_IS("decr_hits")) {
-      decr_hits = atoll(fields[2]);
-      submit_derive("memcached_ops", "decr_hits", decr_hits, st);
-    }
+static memcached_field_t const *
+memcached_field_lookup(memcached_field_t const *fields, size_t fields_num,
+                       char const *name) {
+  memcached_field_t key = {.name = name};
+  return bsearch(&key, fields, fields_num, sizeof(*fields),
+                 memcached_field_compare);
+}
 
-    /*
-     * Operations on the cache:
-     * - get hits/misses
-     * - delete hits/misses
-     * - evictions
-     */
-    else if (FIELD_IS("get_hits")) {
-      get_hits = atoll(fields[2]);
-      submit_derive("memcached_ops", "hits", get_hits, st);
-    } else if (FIELD_IS("get_misses")) {
-      submit_derive("memcached_ops", "misses", atoll(fields[2]), st);
-    } else if (FIELD_IS("evictions")) {
-      submit_derive("memcached_ops", "evictions", atoll(fields[2]), st);
-    } else if (FIELD_IS("delete_hits")) {
-      submit_derive("memcached_ops", "delete_hits", atoll(fields[2]), st);
-    } else if (FIELD_IS("delete_misses")) {
-      submit_derive("memcached_ops", "delete_misses", atoll(fields[2]), st);
+/* Handles the per slab class lines. "name" has the form "<slab>:<field>". */
+static void memcached_handle_slab(memcached_stats_t *s,
+                                  memcached_field_t const *fields,
+                                  size_t fields_num, char const *name,
+                                  char const *value) {
+  char *endptr = NULL;
+  long slab = strtol(name, &endptr, 10);
+  if ((endptr == name) || (*endptr != ':') || (slab < 0) ||
+      (slab >= MEMCACHED_SLABS_MAX))
+    return;
+
+  memcached_field_t const *f =
+      memcached_field_lookup(fields, fields_num, endptr + 1);
+  if (f != NULL)
+    f->handler(s, f, (int)slab, value);
+}
+
+static int memcached_read(user_data_t *user_data) {
+  memcached_t *st = user_data->data;
+  prev_t *prev = &st->prev;
+  memcached_stats_t s = {.st = st};
+
+  /* get data from daemon */
+  if (memcached_query_daemon(st) < 0) {
+    return -1;
+  }
+
+  /* The replies to "stats", "stats slabs" and "stats items", in this order. */
+  int section = 0;
+  char *line;
+  char *ptr = st->buffer;
+  char *saveptr = NULL;
+  while ((line = strtok_r(ptr, "\n\r", &saveptr)) != NULL) {
+    ptr = NULL;
+
+    if (memcached_is_reply_end(line, strlen(line))) {
+      section++;
+      continue;
     }
 
-    /*
-     * Network traffic
-     */
-    else if (FIELD_IS("bytes_read")) {
-      octets_rx = atoll(fields[2]);
-    } else if (FIELD_IS("bytes_written")) {
-      octets_tx = atoll(fields[2]);
+    /* STAT <name> <value> */
+    if (strncmp(line, "STAT ", strlen("STAT ")) != 0)
+      continue;
+    char *name = line + strlen("STAT ");
+    char *value = strchr(name, ' ');
+    if ((value == NULL) || (value == name))
+      continue;
+    *value = '\0';
+    value++;
+
+    if (section == 0) {
+      /* Commands */
+      if (strncmp(name, "cmd_", strlen("cmd_")) == 0) {
+        name += strlen("cmd_");
+        if (*name == '\0')
+          continue;
+        submit_derive("memcached_command", name, atoll(value), st);
+        if (strcmp(name, "get") == 0)
+          s.cmd_get = atoll(value);
+        continue;
+      }
+
+      memcached_field_t const *f = memcached_field_lookup(
+          memcached_stats_fields, STATIC_ARRAY_SIZE(memcached_stats_fields),
+          name);
+      if (f != NULL)
+        f->handler(&s, f, /* slab = */ -1, value);
+    } else if (section == 1) {
+      memcached_handle_slab(&s, memcached_slabs_fields,
+                            STATIC_ARRAY_SIZE(memcached_slabs_fields), name,
+                            value);
+    } else if ((section == 2) &&
+               (strncmp(name, "items:", strlen("items:")) == 0)) {
+      memcached_handle_slab(&s, memcached_items_fields,
+                            STATIC_ARRAY_SIZE(memcached_items_fields),
+                            name + strlen("items:"), value);
     }
   } /* while ((line = strtok_r (ptr, "\n\r", &saveptr)) != NULL) */
 
-  if ((bytes_total > 0) && (bytes_used <= bytes_total))
-    submit_gauge2("df", "cache", bytes_used, bytes_total - bytes_used, st);
+  for (int i = 0; i < MEMCACHED_SLABS_MAX; i++) {
+    memcached_slab_t *slab = s.slabs + i;
+    if (slab->chunk_size == 0)
+      continue;
+
+    char type_instance[DATA_MAX_NAME_LEN];
+    snprintf(type_instance, sizeof(type_instance), "slab-%i", i);
+    submit_gauge2("df", type_instance,
+                  (gauge_t)(slab->used_chunks * slab->chunk_size),
+                  (gauge_t)(slab->free_chunks * slab->chunk_size), st);
+  }
+
+  if ((s.bytes_total > 0) && (s.bytes_used <= s.bytes_total))
+    submit_gauge2("df", "cache", s.bytes_used, s.bytes_total - s.bytes_used,
+                  st);
 
-  if ((rusage_user != 0) || (rusage_syst != 0))
-    submit_derive2("ps_cputime", NULL, rusage_user, rusage_syst, st);
+  if ((s.rusage_user != 0) || (s.rusage_syst != 0))
+    submit_derive2("ps_cputime", NULL, s.rusage_user, s.rusage_syst, st);
 
-  if ((octets_rx != 0) || (octets_tx != 0))
-    submit_derive2("memcached_octets", NULL, octets_rx, octets_tx, st);
+  if ((s.octets_rx != 0) || (s.octets_tx != 0))
+    submit_derive2("memcached_octets", NULL, s.octets_rx, s.octets_tx, st);
 
-  if ((cmd_get != 0) && (get_hits != 0)) {
-    gauge_t ratio =
-        calculate_ratio_percent(get_hits, cmd_get, &prev->hits, &prev->gets);
+  if ((s.cmd_get != 0) && (s.get_hits != 0)) {
+    gauge_t ratio = calculate_ratio_percent(s.get_hits, s.cmd_get, &prev->hits,
+                                            &prev->gets);
     submit_gauge("percent", "hitratio", ratio, st);
   }
 
-  if ((incr_hits != 0) && (incr_misses != 0)) {
+  if ((s.incr_hits != 0) && (s.incr_misses != 0)) {
     gauge_t ratio = calculate_ratio_percent2(
-        incr_hits, incr_misses, &prev->incr_hits, &prev->incr_misses);
+        s.incr_hits, s.incr_misses, &prev->incr_hits, &prev->incr_misses);
     submit_gauge("percent", "incr_hitratio", ratio, st);
-    submit_derive("memcached_ops", "incr", incr_hits + incr_misses, st);
+    submit_derive("memcached_ops", "incr", s.incr_hits + s.incr_misses, st);
   }
 
-  if ((decr_hits != 0) && (decr_misses != 0)) {
+  if ((s.decr_hits != 0) && (s.decr_misses != 0)) {
     gauge_t ratio = calculate_ratio_percent2(
-        decr_hits, decr_misses, &prev->decr_hits, &prev->decr_misses);
+        s.decr_hits, s.decr_misses, &prev->decr_hits, &prev->decr_misses);
     submit_gauge("percent", "decr_hitratio", ratio, st);
-    submit_derive("memcached_ops", "decr", decr_hits + decr_misses, st);
+    submit_derive("memcached_ops", "decr", s.decr_hits + s.decr_misses, st);
   }
 
   return 0;
@@ -737,6 +918,8 @@ static int config_add_instance(oconfig_item_t *ci) {
       status = cf_util_get_string(child, &st->connhost);
     else if (strcasecmp("Port", child->key) == 0)
       status = cf_util_get_service(child, &st->connport);
+    else if (strcasecmp("ReportSlabs", child->key) == 0)
+      status = cf_util_get_boolean(child, &st->report_slabs);
     else {
       WARNING("memcached plugin: Option `%s' not allowed here.", child->key);
       status = -1;
@@ -779,6 +962,12 @@ static int memcached_config(oconfig_item_t *ci) {
 } /* int memcached_config */
 
 static int memcached_init(void) {
+  qsort(memcached_stats_fields, STATIC_ARRAY_SIZE(memcached_stats_fields),
+        sizeof(*memcached_stats_fields), memcached_field_compare);
+  qsort(memcached_slabs_fields, STATIC_ARRAY_SIZE(memcached_slabs_fields),
+        sizeof(*memcached_slabs_fields), memcached_field_compare);
+  qsort(memcached_items_fields, STATIC_ARRAY_SIZE(memcached_items_fields),
+        sizeof(*memcached_items_fields), memcached_field_compare);
 
   if (memcached_have_instances)
     return 0;
@@ -71,7 +71,9 @@ static vm_size_t pagesize;
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-/* no global variables */
+#include "utils/procfs/procfs.h"
+
+static procfs_file_t *proc_meminfo;
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -262,8 +264,7 @@ static int memory_read_internal(value_list_t *vl) {
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
 
   char *fields[8];
   int numfields;
@@ -279,12 +280,19 @@ static int memory_read_internal(value_list_t *vl) {
   gauge_t mem_slab_reclaimable = 0;
   gauge_t mem_slab_unreclaimable = 0;
 
-  if ((fh = fopen("/proc/meminfo", "r")) == NULL) {
-    WARNING("memory: fopen: %s", STRERRNO);
+  if ((proc_meminfo == NULL) &&
+      ((proc_meminfo = procfs_open("/proc/meminfo")) == NULL)) {
+    WARNING("memory: open: %s", STRERRNO);
+    return -1;
+  }
+
+  int status = procfs_read(proc_meminfo);
+  if (status != 0) {
+    WARNING("memory: reading /proc/meminfo failed: %s", STRERROR(status));
     return -1;
   }
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while ((buffer = procfs_next_line(proc_meminfo)) != NULL) {
     gauge_t *val = NULL;
 
     if (strncasecmp(buffer, "MemTotal:", 9) == 0)
@@ -313,10 +321,6 @@ static int memory_read_internal(value_list_t *vl) {
     *val = 1024.0 * atof(fields[1]);
   }
 
-  if (fclose(fh)) {
-    WARNING("memory: fclose: %s", STRERRNO);
-  }
-
   if (mem_total < (mem_free + mem_buffered + mem_cached + mem_slab_total))
     return -1;
 
@@ -484,8 +488,20 @@ static int memory_read(void) /* {{{ */
   return memory_read_internal(&vl);
 } /* }}} int memory_read */
 
+#if !HAVE_HOST_STATISTICS && !HAVE_SYSCTLBYNAME && KERNEL_LINUX
+static int memory_shutdown(void) /* {{{ */
+{
+  procfs_close(proc_meminfo);
+  proc_meminfo = NULL;
+  return 0;
+} /* }}} int memory_shutdown */
+#endif
+
 void module_register(void) {
   plugin_register_complex_config("memory", memory_config);
   plugin_register_init("memory", memory_init);
   plugin_register_read("memory", memory_read);
+#if !HAVE_HOST_STATISTICS && !HAVE_SYSCTLBYNAME && KERNEL_LINUX
+  plugin_register_shutdown("memory", memory_shutdown);
+#endif
 } /* void module_register */
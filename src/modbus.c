@@ -37,6 +37,9 @@
 /* Assume version 2.9.2 */
 #endif
 
+/* The most registers one request may read according to the protocol. */
+#define MB_MAX_READ_REGISTERS 125
+
 #ifndef MODBUS_TCP_DEFAULT_PORT
 #ifdef MODBUS_TCP_PORT
 #define MODBUS_TCP_DEFAULT_PORT MODBUS_TCP_PORT
@@ -62,6 +65,7 @@
  *   # Baudrate 38400
  *   # (Assumes 8N1)
  *   Interval 60
+ *   MaxReadRegisters 125
  *
  *   <Slave 1>
  *     Instance "foobar" # optional
@@ -113,11 +117,30 @@ struct mb_data_s /* {{{ */
   mb_data_t *next;
 }; /* }}} */
 
+/* Adjacent or overlapping registers of a slave, read with one request. */
+struct mb_block_s /* {{{ */
+{
+  mb_mreg_type_t modbus_register_type;
+  int register_base;
+  int registers_num;
+
+  /* The data decoded from the registers of the block, a slice of the
+   * slave's `sorted_data'. */
+  mb_data_t **data;
+  size_t data_num;
+}; /* }}} */
+typedef struct mb_block_s mb_block_t;
+
 struct mb_slave_s /* {{{ */
 {
   int id;
   char instance[DATA_MAX_NAME_LEN];
   mb_data_t *collect;
+
+  /* The data of `collect', sorted by register. */
+  mb_data_t **sorted_data;
+  mb_block_t *blocks;
+  size_t blocks_num;
 }; /* }}} */
 typedef struct mb_slave_s mb_slave_t;
 
@@ -129,6 +152,8 @@ struct mb_host_s /* {{{ */
   int port;     /* for Modbus/TCP */
   int baudrate; /* for Modbus/RTU */
   mb_conntype_t conntype;
+  /* Upper limit of the size of a block. */
+  int max_read_registers;
 
   mb_slave_t *slaves;
   size_t slaves_num;
@@ -403,15 +428,27 @@ static int mb_init_connection(mb_host_t *host) /* {{{ */
       (vt).absolute = (((absolute_t)(raw)*scale) + shift);                     \
   } while (0)
 
-static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
-                        mb_data_t *data) {
-  uint16_t values[4] = {0};
-  int values_num;
-  const data_set_t *ds;
-  int status = 0;
+static int mb_data_registers_num(mb_data_t const *data) /* {{{ */
+{
+  if ((data->register_type == REG_TYPE_INT32) ||
+      (data->register_type == REG_TYPE_INT32_CDAB) ||
+      (data->register_type == REG_TYPE_UINT32) ||
+      (data->register_type == REG_TYPE_UINT32_CDAB) ||
+      (data->register_type == REG_TYPE_FLOAT) ||
+      (data->register_type == REG_TYPE_FLOAT_CDAB))
+    return 2;
+  else if ((data->register_type == REG_TYPE_INT64) ||
+           (data->register_type == REG_TYPE_UINT64))
+    return 4;
+  else
+    return 1;
+} /* }}} int mb_data_registers_num */
 
-  if ((host == NULL) || (slave == NULL) || (data == NULL))
-    return EINVAL;
+/* Decodes the registers of `data', starting at `values', and submits the
+ * value. */
+static int mb_decode_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
+                          mb_data_t *data, uint16_t const *values) {
+  const data_set_t *ds;
 
   ds = plugin_get_ds(data->type);
   if (ds == NULL) {
@@ -440,97 +477,12 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
         data->type, DS_TYPE_TO_STRING(ds->ds[0].type));
   }
 
-  if ((data->register_type == REG_TYPE_INT32) ||
-      (data->register_type == REG_TYPE_INT32_CDAB) ||
-      (data->register_type == REG_TYPE_UINT32) ||
-      (data->register_type == REG_TYPE_UINT32_CDAB) ||
-      (data->register_type == REG_TYPE_FLOAT) ||
-      (data->register_type == REG_TYPE_FLOAT_CDAB))
-    values_num = 2;
-  else if ((data->register_type == REG_TYPE_INT64) ||
-           (data->register_type == REG_TYPE_UINT64))
-    values_num = 4;
-  else
-    values_num = 1;
-
-  if (host->connection == NULL) {
-    status = EBADF;
-  } else if (host->conntype == MBCONN_TCP) {
-    /* getpeername() is used only to determine if the socket is connected, not
-     * because we're really interested in the peer's IP address. */
-    if (getpeername(modbus_get_socket(host->connection),
-                    (void *)&(struct sockaddr_storage){0},
-                    &(socklen_t){sizeof(struct sockaddr_storage)}) != 0)
-      status = errno;
-  }
-
-  if ((status == EBADF) || (status == ENOTSOCK) || (status == ENOTCONN)) {
-    status = mb_init_connection(host);
-    if (status != 0) {
-      ERROR("Modbus plugin: mb_init_connection (%s/%s) failed. ", host->host,
-            host->node);
-      host->is_connected = false;
-      host->connection = NULL;
-      return -1;
-    }
-  } else if (status != 0) {
-#if LEGACY_LIBMODBUS
-    modbus_close(&host->connection);
-#else
-    modbus_close(host->connection);
-    modbus_free(host->connection);
-#endif
-  }
-
-#if LEGACY_LIBMODBUS
-/* Version 2.0.3: Pass the connection struct as a pointer and pass the slave
- * id to each call of "read_holding_registers". */
-#define modbus_read_registers(ctx, addr, nb, dest)                             \
-  read_holding_registers(&(ctx), slave->id, (addr), (nb), (dest))
-#else /* if !LEGACY_LIBMODBUS */
-  /* Version 2.9.2: Set the slave id once before querying the registers. */
-  status = modbus_set_slave(host->connection, slave->id);
-  if (status != 0) {
-    ERROR("Modbus plugin: modbus_set_slave (%i) failed with status %i.",
-          slave->id, status);
-    return -1;
-  }
-#endif
-  if (data->modbus_register_type == MREG_INPUT) {
-    status = modbus_read_input_registers(host->connection,
-                                         /* start_addr = */ data->register_base,
-                                         /* num_registers = */ values_num,
-                                         /* buffer = */ values);
-  } else {
-    status = modbus_read_registers(host->connection,
-                                   /* start_addr = */ data->register_base,
-                                   /* num_registers = */ values_num,
-                                   /* buffer = */ values);
-  }
-  if (status != values_num) {
-    ERROR("Modbus plugin: modbus read function (%s/%s) failed. "
-          " status = %i, start_addr = %i, values_num = %i. Giving up.",
-          host->host, host->node, status, data->register_base, values_num);
-#if LEGACY_LIBMODBUS
-    modbus_close(&host->connection);
-#else
-    modbus_close(host->connection);
-    modbus_free(host->connection);
-#endif
-    host->connection = NULL;
-    return -1;
-  }
-
-  DEBUG("Modbus plugin: mb_read_data: Success! "
-        "modbus_read_registers returned with status %i.",
-        status);
-
   if (data->register_type == REG_TYPE_FLOAT) {
     float float_value;
     value_t vt;
 
     float_value = mb_register_to_float(values[0], values[1]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned float value is %g",
           (double)float_value);
 
@@ -541,7 +493,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
     value_t vt;
 
     float_value = mb_register_to_float(values[1], values[0]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned float value is %g",
           (double)float_value);
 
@@ -555,7 +507,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
     value_t vt;
 
     v.u32 = (((uint32_t)values[0]) << 16) | ((uint32_t)values[1]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned int32 value is %" PRIi32,
           v.i32);
 
@@ -569,7 +521,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
     value_t vt;
 
     v.u32 = (((uint32_t)values[1]) << 16) | ((uint32_t)values[0]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned int32 value is %" PRIi32,
           v.i32);
 
@@ -584,7 +536,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
 
     v.u16 = values[0];
 
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned int16 value is %" PRIi16,
           v.i16);
 
@@ -595,7 +547,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
     value_t vt;
 
     v32 = (((uint32_t)values[0]) << 16) | ((uint32_t)values[1]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned uint32 value is %" PRIu32,
           v32);
 
@@ -606,7 +558,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
     value_t vt;
 
     v32 = (((uint32_t)values[1]) << 16) | ((uint32_t)values[0]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned uint32 value is %" PRIu32,
           v32);
 
@@ -618,7 +570,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
 
     v64 = (((uint64_t)values[0]) << 48) | (((uint64_t)values[1]) << 32) |
           (((uint64_t)values[2]) << 16) | (((uint64_t)values[3]));
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned uint64 value is %" PRIu64,
           v64);
 
@@ -633,7 +585,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
 
     v.u64 = (((uint64_t)values[0]) << 48) | (((uint64_t)values[1]) << 32) |
             (((uint64_t)values[2]) << 16) | ((uint64_t)values[3]);
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned uint64 value is %" PRIi64,
           v.i64);
 
@@ -643,7 +595,7 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
   {
     value_t vt;
 
-    DEBUG("Modbus plugin: mb_read_data: "
+    DEBUG("Modbus plugin: mb_decode_data: "
           "Returned uint16 value is %" PRIu16,
           values[0]);
 
@@ -652,7 +604,113 @@ static int mb_read_data(mb_host_t *host, mb_slave_t *slave, /* {{{ */
   }
 
   return 0;
-} /* }}} int mb_read_data */
+} /* }}} int mb_decode_data */
+
+/* Makes sure the host is connected and addresses the slave. */
+static int mb_connect_slave(mb_host_t *host, mb_slave_t *slave) /* {{{ */
+{
+  int status = 0;
+
+  if (host->connection == NULL) {
+    status = EBADF;
+  } else if (host->conntype == MBCONN_TCP) {
+    /* getpeername() is used only to determine if the socket is connected, not
+     * because we're really interested in the peer's IP address. */
+    if (getpeername(modbus_get_socket(host->connection),
+                    (void *)&(struct sockaddr_storage){0},
+                    &(socklen_t){sizeof(struct sockaddr_storage)}) != 0)
+      status = errno;
+  }
+
+  if ((status == EBADF) || (status == ENOTSOCK) || (status == ENOTCONN)) {
+    status = mb_init_connection(host);
+    if (status != 0) {
+      ERROR("Modbus plugin: mb_init_connection (%s/%s) failed. ", host->host,
+            host->node);
+      host->is_connected = false;
+      host->connection = NULL;
+      return -1;
+    }
+  } else if (status != 0) {
+#if LEGACY_LIBMODBUS
+    modbus_close(&host->connection);
+#else
+    modbus_close(host->connection);
+    modbus_free(host->connection);
+#endif
+  }
+
+#if !LEGACY_LIBMODBUS
+  /* Version 2.9.2: Set the slave id once before querying the registers. */
+  status = modbus_set_slave(host->connection, slave->id);
+  if (status != 0) {
+    ERROR("Modbus plugin: modbus_set_slave (%i) failed with status %i.",
+          slave->id, status);
+    return -1;
+  }
+#endif
+
+  return 0;
+} /* }}} int mb_connect_slave */
+
+/* Reads the registers of `block' with one request and decodes the data in
+ * it. Returns the number of data decoded, or -1 if the request failed. */
+static int mb_read_block(mb_host_t *host, mb_slave_t *slave, /* {{{ */
+                         mb_block_t *block) {
+  uint16_t values[MB_MAX_READ_REGISTERS] = {0};
+  int status;
+
+  if (mb_connect_slave(host, slave) != 0)
+    return -1;
+
+#if LEGACY_LIBMODBUS
+/* Version 2.0.3: Pass the connection struct as a pointer and pass the slave
+ * id to each call of "read_holding_registers". */
+#define modbus_read_registers(ctx, addr, nb, dest)                             \
+  read_holding_registers(&(ctx), slave->id, (addr), (nb), (dest))
+#endif
+  if (block->modbus_register_type == MREG_INPUT) {
+    status = modbus_read_input_registers(
+        host->connection,
+        /* start_addr = */ block->register_base,
+        /* num_registers = */ block->registers_num,
+        /* buffer = */ values);
+  } else {
+    status = modbus_read_registers(host->connection,
+                                   /* start_addr = */ block->register_base,
+                                   /* num_registers = */ block->registers_num,
+                                   /* buffer = */ values);
+  }
+  if (status != block->registers_num) {
+    ERROR("Modbus plugin: modbus read function (%s/%s) failed. "
+          " status = %i, start_addr = %i, values_num = %i. Giving up.",
+          host->host, host->node, status, block->register_base,
+          block->registers_num);
+#if LEGACY_LIBMODBUS
+    modbus_close(&host->connection);
+#else
+    modbus_close(host->connection);
+    modbus_free(host->connection);
+#endif
+    host->connection = NULL;
+    return -1;
+  }
+
+  DEBUG("Modbus plugin: mb_read_block: Success! "
+        "modbus_read_registers returned with status %i.",
+        status);
+
+  int success = 0;
+  for (size_t i = 0; i < block->data_num; i++) {
+    mb_data_t *data = block->data[i];
+    if (mb_decode_data(host, slave, data,
+                       values + (data->register_base - block->register_base)) ==
+        0)
+      success++;
+  }
+
+  return success;
+} /* }}} int mb_read_block */
 
 static int mb_read_slave(mb_host_t *host, mb_slave_t *slave) /* {{{ */
 {
@@ -663,10 +721,10 @@ static int mb_read_slave(mb_host_t *host, mb_slave_t *slave) /* {{{ */
     return EINVAL;
 
   success = 0;
-  for (mb_data_t *data = slave->collect; data != NULL; data = data->next) {
-    status = mb_read_data(host, slave, data);
-    if (status == 0)
-      success++;
+  for (size_t i = 0; i < slave->blocks_num; i++) {
+    status = mb_read_block(host, slave, slave->blocks + i);
+    if (status > 0)
+      success += status;
   }
 
   if (success == 0)
@@ -728,8 +786,11 @@ static void slaves_free_all(mb_slave_t *slaves, size_t slaves_num) /* {{{ */
   if (slaves == NULL)
     return;
 
-  for (size_t i = 0; i < slaves_num; i++)
+  for (size_t i = 0; i < slaves_num; i++) {
+    sfree(slaves[i].sorted_data);
+    sfree(slaves[i].blocks);
     data_free_all(slaves[i].collect);
+  }
   sfree(slaves);
 } /* }}} void slaves_free_all */
 
@@ -746,6 +807,78 @@ static void host_free(void *void_host) /* {{{ */
 
 /* Config functions */
 
+static int mb_data_compare(void const *a, void const *b) /* {{{ */
+{
+  mb_data_t const *d0 = *(mb_data_t *const *)a;
+  mb_data_t const *d1 = *(mb_data_t *const *)b;
+
+  if (d0->modbus_register_type != d1->modbus_register_type)
+    return (d0->modbus_register_type < d1->modbus_register_type) ? -1 : 1;
+  if (d0->register_base != d1->register_base)
+    return (d0->register_base < d1->register_base) ? -1 : 1;
+  return 0;
+} /* }}} int mb_data_compare */
+
+/* Merges the registers the slave's data are read from into blocks of up to
+ * `max_registers' adjacent or overlapping registers, so that they are read
+ * with one request each. */
+static int mb_plan_blocks(mb_slave_t *slave, int max_registers) /* {{{ */
+{
+  size_t data_num = 0;
+  for (mb_data_t *data = slave->collect; data != NULL; data = data->next)
+    data_num++;
+
+  mb_data_t **sorted = calloc(data_num, sizeof(*sorted));
+  /* At most one block per data. */
+  slave->blocks = calloc(data_num, sizeof(*slave->blocks));
+  if ((sorted == NULL) || (slave->blocks == NULL)) {
+    sfree(sorted);
+    sfree(slave->blocks);
+    return ENOMEM;
+  }
+  slave->sorted_data = sorted;
+
+  size_t i = 0;
+  for (mb_data_t *data = slave->collect; data != NULL; data = data->next)
+    sorted[i++] = data;
+  qsort(sorted, data_num, sizeof(*sorted), mb_data_compare);
+
+  mb_block_t *block = NULL;
+  for (i = 0; i < data_num; i++) {
+    mb_data_t *data = sorted[i];
+    int end = data->register_base + mb_data_registers_num(data);
+
+    if ((block != NULL) &&
+        (block->modbus_register_type == data->modbus_register_type) &&
+        (data->register_base <= block->register_base + block->registers_num)) {
+      int block_end = block->register_base + block->registers_num;
+      if (end > block_end)
+        block_end = end;
+      if (block_end - block->register_base <= max_registers) {
+        block->registers_num = block_end - block->register_base;
+        block->data_num++;
+        continue;
+      }
+    }
+
+    block = slave->blocks + slave->blocks_num;
+    slave->blocks_num++;
+    *block = (mb_block_t){
+        .modbus_register_type = data->modbus_register_type,
+        .register_base = data->register_base,
+        .registers_num = end - data->register_base,
+        .data = sorted + i,
+        .data_num = 1,
+    };
+  }
+
+  DEBUG("Modbus plugin: Reading the %" PRIsz " data of slave %i with %" PRIsz
+        " requests.",
+        data_num, slave->id, slave->blocks_num);
+
+  return 0;
+} /* }}} int mb_plan_blocks */
+
 static int mb_config_add_data(oconfig_item_t *ci) /* {{{ */
 {
   mb_data_t data = {0};
@@ -955,6 +1088,7 @@ static int mb_config_add_host(oconfig_item_t *ci) /* {{{ */
   if (host == NULL)
     return ENOMEM;
   host->slaves = NULL;
+  host->max_read_registers = MB_MAX_READ_REGISTERS;
 
   status = cf_util_get_string_buffer(ci, host->host, sizeof(host->host));
   if (status != 0) {
@@ -989,7 +1123,15 @@ static int mb_config_add_host(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &host->baudrate);
     else if (strcasecmp("Interval", child->key) == 0)
       status = cf_util_get_cdtime(child, &interval);
-    else if (strcasecmp("Slave", child->key) == 0)
+    else if (strcasecmp("MaxReadRegisters", child->key) == 0) {
+      status = cf_util_get_int(child, &host->max_read_registers);
+      if ((status == 0) && ((host->max_read_registers < 1) ||
+                            (host->max_read_registers > MB_MAX_READ_REGISTERS))) {
+        ERROR("Modbus plugin: MaxReadRegisters must be between 1 and %d.",
+              MB_MAX_READ_REGISTERS);
+        status = -1;
+      }
+    } else if (strcasecmp("Slave", child->key) == 0)
       /* Don't set status: Gracefully continue if a slave fails. */
       mb_config_add_slave(host, child);
     else {
@@ -1022,6 +1164,15 @@ static int mb_config_add_host(oconfig_item_t *ci) /* {{{ */
     status = -1;
   }
 
+  /* The order of the options doesn't matter: the blocks are planned once the
+   * slaves and the size limit are known. */
+  for (size_t i = 0; (status == 0) && (i < host->slaves_num); i++) {
+    status = mb_plan_blocks(host->slaves + i, host->max_read_registers);
+    if (status != 0)
+      ERROR("Modbus plugin: Planning the requests of host \"%s\" failed.",
+            host->host);
+  }
+
   if (status == 0) {
     char name[1024];
 
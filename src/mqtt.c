@@ -33,6 +33,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/format_json/format_json.h"
 #include "utils_complain.h"
 
 #include <mosquitto.h>
@@ -43,6 +44,7 @@
 #define MQTT_DEFAULT_PORT 1883
 #define MQTT_DEFAULT_TOPIC_PREFIX "collectd"
 #define MQTT_DEFAULT_TOPIC "collectd/#"
+#define MQTT_BATCH_TOPIC "batch"
 #ifndef MQTT_KEEPALIVE
 #define MQTT_KEEPALIVE 60
 #endif
@@ -76,6 +78,10 @@ struct mqtt_client_conf {
   char *topic_prefix;
   bool store_rates;
   bool retain;
+  int batch_size;
+  int batch_count;
+  cdtime_t batch_init_time;
+  format_json_buffer_t batch;
 
   /* For subscribing */
   pthread_t thread;
@@ -149,6 +155,7 @@ static void mqtt_free(mqtt_client_conf_t *conf) {
   sfree(conf->password);
   sfree(conf->client_id);
   sfree(conf->topic_prefix);
+  format_json_buffer_free(&conf->batch);
   sfree(conf);
 }
 
@@ -192,9 +199,13 @@ static void on_message(
   }
 
   topic = strdup(msg->topic);
+  if (topic == NULL) {
+    ERROR("mqtt plugin: strdup failed.");
+    return;
+  }
   name = strip_prefix(topic);
 
-  status = parse_identifier_vl(name, &vl);
+  status = (name != NULL) ? parse_identifier_vl(name, &vl) : EINVAL;
   if (status != 0) {
     ERROR("mqtt plugin: Unable to parse topic \"%s\".", topic);
     sfree(topic);
@@ -410,15 +421,13 @@ static void *subscribers_thread(void *arg) {
   pthread_exit(0);
 } /* void *subscribers_thread */
 
-static int publish(mqtt_client_conf_t *conf, char const *topic,
-                   void const *payload, size_t payload_len) {
+/* XXX: You must hold "conf->lock" when calling this function! */
+static int publish_locked(mqtt_client_conf_t *conf, char const *topic,
+                          void const *payload, size_t payload_len) {
   int status;
 
-  pthread_mutex_lock(&conf->lock);
-
   status = mqtt_connect(conf);
   if (status != 0) {
-    pthread_mutex_unlock(&conf->lock);
     ERROR("mqtt plugin: unable to reconnect to broker");
     return status;
   }
@@ -441,12 +450,18 @@ static int publish(mqtt_client_conf_t *conf, char const *topic,
     conf->connected = false;
     mosquitto_disconnect(conf->mosq);
 
-    pthread_mutex_unlock(&conf->lock);
     return -1;
   }
 
-  pthread_mutex_unlock(&conf->lock);
   return 0;
+} /* int publish_locked */
+
+static int publish(mqtt_client_conf_t *conf, char const *topic,
+                   void const *payload, size_t payload_len) {
+  pthread_mutex_lock(&conf->lock);
+  int status = publish_locked(conf, topic, payload, payload_len);
+  pthread_mutex_unlock(&conf->lock);
+  return status;
 } /* int publish */
 
 static int format_topic(char *buf, size_t buf_len, data_set_t const *ds,
@@ -473,6 +488,76 @@ static int format_topic(char *buf, size_t buf_len, data_set_t const *ds,
   return 0;
 } /* int format_topic */
 
+/* Publishes the batch, a JSON array of value lists, to "<Prefix>/batch".
+ * XXX: You must hold "conf->lock" when calling this function! */
+static int publish_batch_locked(mqtt_client_conf_t *conf) {
+  char topic[MQTT_MAX_TOPIC_SIZE];
+  int status;
+
+  if (conf->batch_count == 0)
+    return 0;
+
+  if ((conf->topic_prefix == NULL) || (conf->topic_prefix[0] == 0))
+    sstrncpy(topic, MQTT_BATCH_TOPIC, sizeof(topic));
+  else
+    snprintf(topic, sizeof(topic), "%s/" MQTT_BATCH_TOPIC, conf->topic_prefix);
+
+  status = format_json_buffer_finalize(&conf->batch);
+  if (status == 0)
+    status = publish_locked(conf, topic, conf->batch.data, conf->batch.len);
+  else
+    ERROR("mqtt plugin: format_json_buffer_finalize failed with status %d.",
+          status);
+
+  format_json_buffer_reset(&conf->batch);
+  conf->batch_count = 0;
+  return status;
+} /* int publish_batch_locked */
+
+static int mqtt_write_batch(const data_set_t *ds, const value_list_t *vl,
+                            mqtt_client_conf_t *conf) {
+  cdtime_t now = cdtime();
+  int status;
+
+  pthread_mutex_lock(&conf->lock);
+
+  status = format_json_buffer_add(&conf->batch, ds, vl, conf->store_rates);
+  if (status != 0) {
+    pthread_mutex_unlock(&conf->lock);
+    ERROR("mqtt plugin: format_json_buffer_add failed with status %d.",
+          status);
+    return status;
+  }
+
+  if (conf->batch_count == 0)
+    conf->batch_init_time = now;
+  conf->batch_count++;
+
+  /* A batch is published when it is full or older than the interval. */
+  if ((conf->batch_count >= conf->batch_size) ||
+      ((now - conf->batch_init_time) >= plugin_get_interval()))
+    status = publish_batch_locked(conf);
+
+  pthread_mutex_unlock(&conf->lock);
+  return status;
+} /* int mqtt_write_batch */
+
+static int mqtt_flush(cdtime_t timeout,
+                      __attribute__((unused)) const char *identifier,
+                      user_data_t *user_data) {
+  mqtt_client_conf_t *conf = user_data->data;
+  int status = 0;
+
+  pthread_mutex_lock(&conf->lock);
+  /* timeout == 0  => flush unconditionally */
+  if ((conf->batch_count > 0) &&
+      ((timeout == 0) || ((conf->batch_init_time + timeout) <= cdtime())))
+    status = publish_batch_locked(conf);
+  pthread_mutex_unlock(&conf->lock);
+
+  return status;
+} /* int mqtt_flush */
+
 static int mqtt_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *user_data) {
   mqtt_client_conf_t *conf;
@@ -484,6 +569,9 @@ static int mqtt_write(const data_set_t *ds, const value_list_t *vl,
     return EINVAL;
   conf = user_data->data;
 
+  if (conf->batch_size > 1)
+    return mqtt_write_batch(ds, vl, conf);
+
   status = format_topic(topic, sizeof(topic), ds, vl, conf);
   if (status != 0) {
     ERROR("mqtt plugin: format_topic failed with status %d.", status);
@@ -516,6 +604,7 @@ static int mqtt_write(const data_set_t *ds, const value_list_t *vl,
  *   StoreRates true
  *   Retain false
  *   QoS 0
+ *   BatchSize 1
  *   CACert "ca.pem"                      Enables TLS if set
  *   CertificateFile "client-cert.pem"	  optional
  *   CertificateKeyFile "client-key.pem"  optional
@@ -547,6 +636,8 @@ static int mqtt_config_publisher(oconfig_item_t *ci) {
   conf->qos = 0;
   conf->topic_prefix = strdup(MQTT_DEFAULT_TOPIC_PREFIX);
   conf->store_rates = true;
+  conf->batch_size = 1;
+  conf->batch = (format_json_buffer_t)FORMAT_JSON_BUFFER_INIT;
 
   status = pthread_mutex_init(&conf->lock, NULL);
   if (status != 0) {
@@ -585,7 +676,14 @@ static int mqtt_config_publisher(oconfig_item_t *ci) {
       cf_util_get_boolean(child, &conf->store_rates);
     else if (strcasecmp("Retain", child->key) == 0)
       cf_util_get_boolean(child, &conf->retain);
-    else if (strcasecmp("CACert", child->key) == 0)
+    else if (strcasecmp("BatchSize", child->key) == 0) {
+      int tmp = -1;
+      status = cf_util_get_int(child, &tmp);
+      if ((status != 0) || (tmp < 1))
+        ERROR("mqtt plugin: \"BatchSize\" must be at least 1.");
+      else
+        conf->batch_size = tmp;
+    } else if (strcasecmp("CACert", child->key) == 0)
       cf_util_get_string(child, &conf->cacertificatefile);
     else if (strcasecmp("CertificateFile", child->key) == 0)
       cf_util_get_string(child, &conf->certificatefile);
@@ -600,10 +698,15 @@ static int mqtt_config_publisher(oconfig_item_t *ci) {
   }
 
   snprintf(cb_name, sizeof(cb_name), "mqtt/%s", conf->name);
-  plugin_register_write(cb_name, mqtt_write,
-                        &(user_data_t){
-                            .data = conf,
-                        });
+  status = plugin_register_write(cb_name, mqtt_write,
+                                 &(user_data_t){
+                                     .data = conf,
+                                 });
+  if ((status == 0) && (conf->batch_size > 1))
+    plugin_register_flush(cb_name, mqtt_flush,
+                          &(user_data_t){
+                              .data = conf,
+                          });
   return 0;
 } /* mqtt_config_publisher */
 
@@ -24,6 +24,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE /* For struct ip_mreq */
+#define _GNU_SOURCE /* For recvmmsg(2) */
 
 #include "collectd.h"
 
@@ -31,7 +32,12 @@
 #include "utils/common/common.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
+#include "utils_counter.h"
 #include "utils_fbhash.h"
+#include "utils_ident.h"
+#include "utils_random.h"
+#include "utils/avltree/avltree.h"
+#include "utils/server_pool/server_pool.h"
 
 #include "network.h"
 
@@ -50,6 +56,15 @@
 #if HAVE_NET_IF_H
 #include <net/if.h>
 #endif
+#if HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
 
 #if HAVE_GCRYPT_H
 #if defined __APPLE__
@@ -71,6 +86,9 @@
 #endif
 #if GCRYPT_VERSION_NUMBER < 0x010600
 GCRY_THREAD_OPTION_PTHREAD_IMPL;
+#else
+/* AES-GCM is available since Libgcrypt 1.6. */
+#define NETWORK_HAVE_GCM 1
 #endif
 #endif
 
@@ -99,13 +117,36 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 #if HAVE_GCRYPT_H
 #define SECURITY_LEVEL_SIGN 1
 #define SECURITY_LEVEL_ENCRYPT 2
+
+#define CIPHER_MODE_OFB 0
+#define CIPHER_MODE_GCM 1
+
+/* Key derived from a user's password, with cipher handles that have the key
+ * already set. Entries are looked up by username and kept until the socket is
+ * destroyed; if the password changes, the key is derived again. */
+struct network_key_s {
+  char *username;
+  char *secret;
+  unsigned char hash[32];
+
+  /* Protects the cipher handles while a packet is decrypted. */
+  pthread_mutex_t lock;
+  gcry_cipher_hd_t ofb;
+  gcry_cipher_hd_t gcm;
+
+  struct network_key_s *next;
+};
+typedef struct network_key_s network_key_t;
 #endif
+struct send_queue_s;
+
 struct sockent_client {
   int fd;
   struct sockaddr_storage *addr;
   socklen_t addrlen;
 #if HAVE_GCRYPT_H
   int security_level;
+  int cipher_mode;
   char *username;
   char *password;
   gcry_cipher_hd_t cypher;
@@ -113,7 +154,18 @@ struct sockent_client {
 #endif
   cdtime_t next_resolve_reconnect;
   cdtime_t resolve_interval;
+  /* TCP only: time of the next connection attempt, and the current delay
+   * between failed attempts. */
+  cdtime_t next_connect;
+  cdtime_t connect_backoff;
   struct sockaddr_storage *bind_addr;
+  /* Packets to be sent by this server's send thread, if `SendThreads' is
+   * enabled. */
+  struct send_queue_s *queue;
+  /* The `ServerPool' this server is a member of, if any, and its index in
+   * the pool. */
+  struct network_pool_s *pool;
+  size_t pool_index;
 };
 
 struct sockent_server {
@@ -123,8 +175,12 @@ struct sockent_server {
   int security_level;
   char *auth_file;
   fbhash_t *userdb;
-  gcry_cipher_hd_t cypher;
+  /* Protects the list of keys, which is shared by all receive threads. */
+  pthread_mutex_t keys_lock;
+  network_key_t *keys;
 #endif
+  /* Received packets are sent to the servers as they are, see `Relay'. */
+  bool relay;
 };
 
 typedef struct sockent {
@@ -135,6 +191,9 @@ typedef struct sockent {
   char *node;
   char *service;
   int interface;
+#define SOCKENT_PROTOCOL_UDP 0
+#define SOCKENT_PROTOCOL_TCP 1
+  int protocol;
 
   union {
     struct sockent_client client;
@@ -251,14 +310,122 @@ struct part_encryption_aes256_s {
 };
 typedef struct part_encryption_aes256_s part_encryption_aes256_t;
 
+/*                      1 1 1 1 1 1 1 1 1 1 2 2 2 2 2 2 2 2 2 2 3 3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-------------------------------+-------------------------------+
+ * ! Type                          ! Length                        !
+ * +-------------------------------+-------------------------------+
+ * ! Username length in bytes      ! Username                      !
+ * +-----------------------------------------------------------------+
+ * ! Initialization Vector (IV) (96 bits)                          !
+ * +---------------------------------------------------------------+
+ * ! Authentication tag (128 bits)                                 !
+ * +---------------------------------------------------------------+
+ * ! Encrypted payload                                             !
+ * +---------------------------------------------------------------+
+ *
+ * The header up to and including the username is authenticated, but not
+ * encrypted.
+ */
+/* Minimum size */
+#define PART_ENCRYPTION_AES256_GCM_SIZE 34
+#define PART_ENCRYPTION_AES256_GCM_IV_SIZE 12
+#define PART_ENCRYPTION_AES256_GCM_TAG_SIZE 16
+
+/*                      1 1 1 1 1 1 1 1 1 1 2 2 2 2 2 2 2 2 2 2 3 3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-------------------------------+-------------------------------+
+ * ! Type                          ! Length                        !
+ * +-------------------------------+-------------------------------+
+ * ! Dictionary                    ! Original length               :
+ * +-------------------------------+-------------------------------+
+ * : (cont.)                       ! Raw deflate stream            :
+ * +-------------------------------+-------------------------------+
+ *
+ * The deflate stream holds regular parts. `Dictionary' selects the preset
+ * dictionary the stream was compressed with, see `compress_dictionary'.
+ */
+#define PART_COMPRESSED_SIZE 10
+#define COMPRESS_DICTIONARY_NONE 0
+#define COMPRESS_DICTIONARY_V1 1
+/* Upper bound for the original length accepted by the receiver. */
+#define COMPRESS_ORIGINAL_MAX (1024 * 1024)
+
+/* The payload buffer of `network_config_packet_size' bytes is allocated
+ * together with the entry; `data' points right behind it. */
 struct receive_list_entry_s {
   char *data;
   int data_len;
   int fd;
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
   struct receive_list_entry_s *next;
 };
 typedef struct receive_list_entry_s receive_list_entry_t;
 
+/* Number of free entries kept in the receive pool if `ReceiveQueueLimit' is
+ * not set. */
+#define RECEIVE_POOL_FREE_MAX 1024
+
+/* Number of packets a send thread hands to the kernel with one system call. */
+#define SEND_BATCH_SIZE 32
+/* Number of packets queued for one server. Packets beyond that are dropped. */
+#define SEND_QUEUE_MAX 1024
+
+struct send_packet_s {
+  struct send_packet_s *next;
+  size_t size;
+  char data[];
+};
+typedef struct send_packet_s send_packet_t;
+
+/* Queue between the write threads, which fill the shared send buffer, and the
+ * send thread of one server, which signs or encrypts and sends the packets. */
+struct send_queue_s {
+  sockent_t *se;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  send_packet_t *head;
+  send_packet_t *tail;
+  size_t length;
+  bool stop;
+
+  /* Sent packets are kept for reuse; all of them have room for
+   * `network_config_packet_size' bytes. */
+  send_packet_t *free;
+
+  pthread_t thread;
+  bool running;
+};
+typedef struct send_queue_s send_queue_t;
+
+/* Number of packets read from a socket with one system call by the receive
+ * threads started with the `ReceiveThreads' option. */
+#define RECEIVE_BATCH_SIZE 32
+
+/* State of one receive thread. Each thread polls its own set of sockets and
+ * parses the packets it reads itself, so neither the receive list nor the
+ * dispatch thread are used in this mode. */
+struct receive_thread_s {
+  pthread_t id;
+  bool running;
+
+  /* `sockent[i]' is the socket entry `pollfd[i].fd' belongs to. */
+  struct pollfd *pollfd;
+  sockent_t **sockent;
+  size_t fds_num;
+
+  /* Preallocated packet buffers, `RECEIVE_BATCH_SIZE' times
+   * `network_config_packet_size' bytes. */
+  char *buffer;
+
+  /* Values dispatched by this thread, for network_peer_account(). Only used
+   * by the thread itself, the totals are in the stats_* counters. */
+  derive_t values_dispatched;
+};
+typedef struct receive_thread_s receive_thread_t;
+
 /*
  * Private variables
  */
@@ -266,7 +433,17 @@ static int network_config_ttl;
 /* Ethernet - (IPv6 + UDP) = 1500 - (40 + 8) = 1452 */
 static size_t network_config_packet_size = 1452;
 static bool network_config_forward;
+static bool network_config_relay;
 static bool network_config_stats;
+static int network_config_receive_threads;
+/* CPU list the receiving threads are bound to, see `ReceiveThreadsAffinity'. */
+static char *network_config_receive_affinity;
+static uint64_t network_config_receive_queue_limit;
+static bool network_config_send_threads;
+static bool network_config_compress;
+static bool network_config_ident_dict;
+static long network_config_shed_high;
+static long network_config_shed_low = -1;
 
 static sockent_t *sending_sockets;
 
@@ -276,6 +453,15 @@ static pthread_mutex_t receive_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t receive_list_cond = PTHREAD_COND_INITIALIZER;
 static uint64_t receive_list_length;
 
+/* Entries that have been dispatched are returned to `receive_pool_free' and
+ * reused by the receive thread. `receive_pool_size' is the number of entries
+ * allocated in total. No more than `ReceiveQueueLimit' entries are allocated;
+ * packets arriving while all of them are in use are dropped. */
+static receive_list_entry_t *receive_pool_free;
+static uint64_t receive_pool_free_num;
+static uint64_t receive_pool_size;
+static pthread_mutex_t receive_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static sockent_t *listen_sockets;
 static struct pollfd *listen_sockets_pollfd;
 static size_t listen_sockets_num;
@@ -288,33 +474,224 @@ static pthread_t receive_thread_id;
 static int dispatch_thread_running;
 static pthread_t dispatch_thread_id;
 
-/* Buffer in which to-be-sent network packets are constructed. */
-static char *send_buffer;
-static char *send_buffer_ptr;
-static int send_buffer_fill;
-static cdtime_t send_buffer_last_update;
-static value_list_t send_buffer_vl = VALUE_LIST_INIT;
+/* Used instead of the receive and dispatch threads if `ReceiveThreads' is
+ * greater than zero. */
+static receive_thread_t *receive_threads;
+static size_t receive_threads_num;
+static pthread_key_t receive_thread_key;
+static bool receive_thread_key_valid;
+
+/* TCP transport: every packet is preceded by its length as a 32 bit integer
+ * in network byte order. */
+#define STREAM_FRAME_HEADER_SIZE 4
+#define STREAM_FRAME_MAX 65535
+#define STREAM_CONNECT_TIMEOUT_MS 1000
+#define STREAM_SEND_TIMEOUT_MS 5000
+#define STREAM_BACKOFF_MIN TIME_T_TO_CDTIME_T(1)
+#define STREAM_BACKOFF_MAX TIME_T_TO_CDTIME_T(60)
+#define STREAM_CONNECTIONS_MAX 1024
+#define STREAM_EVENTS_MAX 64
+
+/* Listening TCP sockets. They are served by the stream thread, not by the
+ * receive threads. */
+static sockent_t *listen_streams;
+
+#if HAVE_SYS_EPOLL_H
+/* A listening socket (`buffer' is NULL) or an accepted connection of the
+ * stream thread. */
+struct stream_conn_s {
+  int fd;
+  sockent_t *se;
+  char *buffer;
+  size_t fill;
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  struct stream_conn_s *prev;
+  struct stream_conn_s *next;
+};
+typedef struct stream_conn_s stream_conn_t;
+
+static int stream_epoll_fd = -1;
+static stream_conn_t *stream_conns;
+static size_t stream_conns_num;
+static receive_thread_t stream_thread;
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* Received packets are accounted per source address (without the port) in a
+ * hash table. The table is split into partitions with their own lock, so that
+ * receive threads rarely contend. Slots are never freed; the slot of a peer
+ * that has not been seen for `PEER_TIMEOUT' is taken over by a new peer. */
+#define PEER_PARTITIONS 16
+#define PEER_PARTITION_SIZE 64
+#define PEER_TIMEOUT TIME_T_TO_CDTIME_T(60)
+/* Rates are updated once per window. */
+#define PEER_RATE_WINDOW TIME_T_TO_CDTIME_T(1)
+/* Number of peers reported by `ReportStats', noisiest first. */
+#define PEER_STATS_MAX 10
+
+struct network_peer_s {
+  bool used;
+  sa_family_t family;
+  uint8_t addr[16];
+  uint8_t partition;
+  cdtime_t last_seen;
+
+  /* Values received since `window_start' and the smoothed rate of the
+   * previous windows, in values per second. Shed packets are counted with
+   * the peer's average number of values per packet. */
+  cdtime_t window_start;
+  double window_values;
+  gauge_t rate;
+
+  derive_t packets_rx;
+  derive_t packets_shed;
+  derive_t values_rx;
+};
+typedef struct network_peer_s network_peer_t;
+
+struct peer_partition_s {
+  pthread_mutex_t lock;
+  network_peer_t peers[PEER_PARTITION_SIZE];
+
+  /* Average rate of all active peers, copied here by peer_share_update() so
+   * that admission only needs this partition's lock. */
+  gauge_t fair_rate;
+  derive_t packets_shed;
+};
+typedef struct peer_partition_s peer_partition_t;
+
+static bool peer_accounting;
+static peer_partition_t peer_partitions[PEER_PARTITIONS];
+static cdtime_t peer_share_last;
+static pthread_mutex_t peer_share_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Buffer in which to-be-sent network packets are constructed. `send_buffer'
+ * is sent to all servers outside of a `ServerPool'; every pool member has a
+ * buffer of its own. All of them are protected by `send_buffer_lock'. */
+struct send_buffer_s {
+  char *buffer;
+  char *ptr;
+  int fill;
+  cdtime_t last_update;
+  value_list_t vl;
+
+  /* See the identifier dictionary below. */
+  bool session;
+  uint64_t ident;
+
+#if HAVE_LIBZ
+  /* If `Compress' is enabled, the parts of each value are written to
+   * `compress_scratch' first and then deflated into `buffer', behind room for
+   * the compressed part's header. `compress_raw_len' is the number of bytes
+   * deflated into the current packet. */
+  z_stream compress_stream;
+  bool compress_stream_initialized;
+  size_t compress_raw_len;
+#endif
+
+  /* The pool member the packets are sent to, or NULL for `send_buffer'. */
+  sockent_t *se;
+};
+typedef struct send_buffer_s send_buffer_t;
+
+static send_buffer_t send_buffer = {.vl = VALUE_LIST_INIT};
 static pthread_mutex_t send_buffer_lock = PTHREAD_MUTEX_INITIALIZER;
 
-/* XXX: These counters are incremented from one place only. The spot in which
- * the values are incremented is either only reachable by one thread (the
- * dispatch thread, for example) or locked by some lock (send_buffer_lock for
- * example). Only if neither is true, the stats_lock is acquired. The counters
- * are always read without holding a lock in the hope that writing 8 bytes to
- * memory is an atomic operation. */
-static derive_t stats_octets_rx;
-static derive_t stats_octets_tx;
-static derive_t stats_packets_rx;
-static derive_t stats_packets_tx;
-static derive_t stats_values_dispatched;
-static derive_t stats_values_not_dispatched;
-static derive_t stats_values_sent;
-static derive_t stats_values_not_sent;
-static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+/* A `ServerPool': every value is sent to only one of the members, chosen by
+ * the hash of its identifier. */
+struct network_pool_s {
+  char *name;
+  cdtime_t retry_interval;
+  server_pool_t *members;
+  /* By member index. */
+  sockent_t **sockents;
+  send_buffer_t *buffers;
+  size_t num;
+  struct network_pool_s *next;
+};
+typedef struct network_pool_s network_pool_t;
+
+static network_pool_t *server_pools;
+
+#if HAVE_LIBZ
+static char *compress_scratch;
+
+/* Preset dictionary with common plugin, type and type instance names, in the
+ * form they take in string parts. Its contents are part of the protocol:
+ * never change it, add a new COMPRESS_DICTIONARY_* version instead. More
+ * frequent strings are at the end, where they are cheapest to refer to. */
+static const char compress_dictionary[] =
+    "contextswitch\0entropy\0uptime\0users\0irq\0tcpconns\0vmem\0"
+    "swap\0swap_io\0ps_state\0processes\0running\0sleeping\0zombies\0"
+    "counter\0gauge\0derive\0percent\0reserved\0df\0df_complex\0"
+    "disk\0disk_merged\0disk_io_time\0disk_time\0disk_ops\0"
+    "disk_octets\0memory\0buffered\0cached\0free\0used\0load\0"
+    "if_dropped\0if_errors\0if_packets\0if_octets\0interface\0lo\0eth0\0"
+    "steal\0softirq\0interrupt\0nice\0wait\0system\0user\0idle\0cpu\0";
+
+/* Worst case size of `n' deflated bytes including a sync flush, plus room for
+ * finishing the stream. */
+#define COMPRESS_BOUND(n) ((n) + 5 * (((n) >> 14) + 1) + 16)
+#endif /* HAVE_LIBZ */
+
+/* Identifier dictionary. Numbers are assigned from 1 to IDENT_DICT_SIZE and
+ * valid for one session, i.e. until the sender restarts. Since packets may be
+ * lost and receivers may restart, every identifier is defined again after
+ * IDENT_DICT_REFRESH. Receivers drop sessions that have not been refreshed
+ * for IDENT_SESSION_TIMEOUT. */
+#define IDENT_DICT_SIZE 16384
+#define IDENT_DICT_REFRESH TIME_T_TO_CDTIME_T(30)
+#define IDENT_SESSIONS_MAX 256
+#define IDENT_SESSION_TIMEOUT TIME_T_TO_CDTIME_T(600)
+
+struct ident_dict_entry_s {
+  char *name;
+  uint64_t id;
+  cdtime_t defined;
+};
+typedef struct ident_dict_entry_s ident_dict_entry_t;
+
+/* Sender side, protected by `send_buffer_lock'. Only `send_buffer' uses the
+ * dictionary, since the members of a pool may change. `send_buffer.session'
+ * is set once the session part has been written to the current packet.
+ * `send_buffer.ident' is the number of the identifier last referred to with
+ * TYPE_IDENT_REF, or zero if `send_buffer.vl' has been written out in
+ * strings since. As a receiver may not know the referred identifier, the
+ * next identifier written in strings is written in full. */
+static c_avl_tree_t *ident_dict;
+static uint64_t ident_dict_session;
+static uint64_t ident_dict_next;
+
+/* Incremented by the receive, send and write threads without a lock. */
+static shard_counter_t stats_octets_rx = SHARD_COUNTER_INIT;
+static shard_counter_t stats_octets_tx = SHARD_COUNTER_INIT;
+static shard_counter_t stats_packets_rx = SHARD_COUNTER_INIT;
+static shard_counter_t stats_packets_tx = SHARD_COUNTER_INIT;
+static shard_counter_t stats_values_dispatched = SHARD_COUNTER_INIT;
+static shard_counter_t stats_values_not_dispatched = SHARD_COUNTER_INIT;
+static shard_counter_t stats_values_sent = SHARD_COUNTER_INIT;
+static shard_counter_t stats_values_not_sent = SHARD_COUNTER_INIT;
+static shard_counter_t stats_packets_dropped = SHARD_COUNTER_INIT;
+static shard_counter_t stats_packets_send_dropped = SHARD_COUNTER_INIT;
+static shard_counter_t stats_packets_relayed = SHARD_COUNTER_INIT;
+
+/* Values dispatched by threads without a receive_thread_t, i.e. the dispatch
+ * thread, for network_peer_account(). */
+static derive_t values_dispatched_other;
 
 /*
  * Private functions
  */
+/* Returns the state of the calling receive thread, or NULL if the calling
+ * thread is not one of the threads started for `ReceiveThreads' or the
+ * stream thread. */
+static receive_thread_t *receive_thread_self(void) /* {{{ */
+{
+  if (!receive_thread_key_valid)
+    return NULL;
+  return pthread_getspecific(receive_thread_key);
+} /* }}} receive_thread_t *receive_thread_self */
+
 static bool check_receive_okay(const value_list_t *vl) /* {{{ */
 {
   uint64_t time_sent = 0;
@@ -408,7 +785,7 @@ static int network_dispatch_values(value_list_t *vl, /* {{{ */
           "NOT dispatching %s.",
           name);
 #endif
-    stats_values_not_dispatched++;
+    shard_counter_add(&stats_values_not_dispatched, 1);
     return 0;
   }
 
@@ -438,8 +815,19 @@ static int network_dispatch_values(value_list_t *vl, /* {{{ */
     }
   }
 
+  /* The identifier is interned once and kept by parse_packet until one of the
+   * identifier fields changes. */
+  if (vl->ident == NULL)
+    vl->ident = ident_get(vl);
+
   plugin_dispatch_values(vl);
-  stats_values_dispatched++;
+
+  shard_counter_add(&stats_values_dispatched, 1);
+  receive_thread_t *rt = receive_thread_self();
+  if (rt != NULL)
+    rt->values_dispatched++;
+  else
+    values_dispatched_other++;
 
   meta_data_destroy(vl->meta);
   vl->meta = NULL;
@@ -509,36 +897,18 @@ static int network_init_gcrypt(void) /* {{{ */
   return 0;
 } /* }}} int network_init_gcrypt */
 
-static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
-                                                  const void *iv,
-                                                  size_t iv_size,
-                                                  const char *username) {
+/* Prepares a cipher handle for a packet with the initialization vector `iv'.
+ * The handle is opened and the (expensive) key schedule is set up only once;
+ * afterwards, the handle is merely reset. */
+static gcry_cipher_hd_t network_cypher_prepare(gcry_cipher_hd_t *cyper_ptr,
+                                               int mode, /* {{{ */
+                                               const unsigned char *key,
+                                               size_t key_size, const void *iv,
+                                               size_t iv_size) {
   gcry_error_t err;
-  gcry_cipher_hd_t *cyper_ptr;
-  unsigned char password_hash[32];
-
-  if (se->type == SOCKENT_TYPE_CLIENT) {
-    cyper_ptr = &se->data.client.cypher;
-    memcpy(password_hash, se->data.client.password_hash, sizeof(password_hash));
-  } else {
-    char *secret;
-
-    cyper_ptr = &se->data.server.cypher;
-
-    if (username == NULL)
-      return NULL;
-
-    secret = fbh_get(se->data.server.userdb, username);
-    if (secret == NULL)
-      return NULL;
-
-    gcry_md_hash_buffer(GCRY_MD_SHA256, password_hash, secret, strlen(secret));
-
-    sfree(secret);
-  }
 
   if (*cyper_ptr == NULL) {
-    err = gcry_cipher_open(cyper_ptr, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_OFB,
+    err = gcry_cipher_open(cyper_ptr, GCRY_CIPHER_AES256, mode,
                            /* flags = */ 0);
     if (err != 0) {
       ERROR("network plugin: gcry_cipher_open returned: %s",
@@ -546,23 +916,23 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
       *cyper_ptr = NULL;
       return NULL;
     }
+
+    err = gcry_cipher_setkey(*cyper_ptr, key, key_size);
+    if (err != 0) {
+      ERROR("network plugin: gcry_cipher_setkey returned: %s",
+            gcry_strerror(err));
+      gcry_cipher_close(*cyper_ptr);
+      *cyper_ptr = NULL;
+      return NULL;
+    }
   } else {
     gcry_cipher_reset(*cyper_ptr);
   }
   assert(*cyper_ptr != NULL);
 
-  err = gcry_cipher_setkey(*cyper_ptr, password_hash, sizeof(password_hash));
-  if (err != 0) {
-    ERROR("network plugin: gcry_cipher_setkey returned: %s",
-          gcry_strerror(err));
-    gcry_cipher_close(*cyper_ptr);
-    *cyper_ptr = NULL;
-    return NULL;
-  }
-
   err = gcry_cipher_setiv(*cyper_ptr, iv, iv_size);
   if (err != 0) {
-    ERROR("network plugin: gcry_cipher_setkey returned: %s",
+    ERROR("network plugin: gcry_cipher_setiv returned: %s",
           gcry_strerror(err));
     gcry_cipher_close(*cyper_ptr);
     *cyper_ptr = NULL;
@@ -570,21 +940,193 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
   }
 
   return *cyper_ptr;
+} /* }}} gcry_cipher_hd_t network_cypher_prepare */
+
+/* Returns the cipher handle of a client socket. */
+static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
+                                                  const void *iv,
+                                                  size_t iv_size) {
+  int mode = GCRY_CIPHER_MODE_OFB;
+#if NETWORK_HAVE_GCM
+  if (se->data.client.cipher_mode == CIPHER_MODE_GCM)
+    mode = GCRY_CIPHER_MODE_GCM;
+#endif
+
+  return network_cypher_prepare(&se->data.client.cypher, mode,
+                                se->data.client.password_hash,
+                                sizeof(se->data.client.password_hash), iv,
+                                iv_size);
 } /* }}} int network_get_aes256_cypher */
+
+static void network_key_free(network_key_t *k) /* {{{ */
+{
+  if (k == NULL)
+    return;
+
+  if (k->ofb != NULL)
+    gcry_cipher_close(k->ofb);
+  if (k->gcm != NULL)
+    gcry_cipher_close(k->gcm);
+  pthread_mutex_destroy(&k->lock);
+  sfree(k->username);
+  sfree(k->secret);
+  sfree(k);
+} /* }}} void network_key_free */
+
+/* Looks up the key of `username' on a server socket, deriving it if the user
+ * is new or the password has changed. On success, the key is returned with
+ * its lock held. */
+static network_key_t *network_key_get(sockent_t *se, /* {{{ */
+                                      const char *username) {
+  network_key_t *k;
+  char *secret;
+
+  if (username == NULL)
+    return NULL;
+
+  /* Checks whether the auth file has been modified, too. */
+  secret = fbh_get(se->data.server.userdb, username);
+  if (secret == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&se->data.server.keys_lock);
+
+  for (k = se->data.server.keys; k != NULL; k = k->next)
+    if (strcmp(k->username, username) == 0)
+      break;
+
+  if (k == NULL) {
+    k = calloc(1, sizeof(*k));
+    if ((k == NULL) || ((k->username = strdup(username)) == NULL)) {
+      pthread_mutex_unlock(&se->data.server.keys_lock);
+      ERROR("network plugin: network_key_get: calloc failed.");
+      sfree(k);
+      sfree(secret);
+      return NULL;
+    }
+    pthread_mutex_init(&k->lock, /* attr = */ NULL);
+    k->next = se->data.server.keys;
+    se->data.server.keys = k;
+  }
+
+  pthread_mutex_lock(&k->lock);
+  pthread_mutex_unlock(&se->data.server.keys_lock);
+
+  if ((k->secret == NULL) || (strcmp(k->secret, secret) != 0)) {
+    gcry_md_hash_buffer(GCRY_MD_SHA256, k->hash, secret, strlen(secret));
+    if (k->ofb != NULL)
+      gcry_cipher_close(k->ofb);
+    if (k->gcm != NULL)
+      gcry_cipher_close(k->gcm);
+    k->ofb = NULL;
+    k->gcm = NULL;
+
+    sfree(k->secret);
+    k->secret = secret;
+  } else {
+    sfree(secret);
+  }
+
+  return k;
+} /* }}} network_key_t *network_key_get */
 #endif /* HAVE_GCRYPT_H */
 
+/* Data source types of a value part, as far as the conversion of the values
+ * is concerned. Integer types only need a byte swap, so parts containing only
+ * those, or only gauges, are converted in one go. */
+#define VALUES_KIND_INTEGER 1
+#define VALUES_KIND_GAUGE 2
+#define VALUES_KIND_MIXED 3
+
+static int network_values_kind(const uint8_t *types, size_t num) /* {{{ */
+{
+  size_t gauges = 0;
+
+  for (size_t i = 0; i < num; i++) {
+    if (types[i] == DS_TYPE_GAUGE)
+      gauges++;
+    else if ((types[i] != DS_TYPE_COUNTER) && (types[i] != DS_TYPE_DERIVE) &&
+             (types[i] != DS_TYPE_ABSOLUTE))
+      return -1;
+  }
+
+  if (gauges == 0)
+    return VALUES_KIND_INTEGER;
+  if (gauges == num)
+    return VALUES_KIND_GAUGE;
+  return VALUES_KIND_MIXED;
+} /* }}} int network_values_kind */
+
+/* Converts `num' 64 bit integers at `buffer' between host and network byte
+ * order in place. The buffer may be unaligned. Written as a simple loop so
+ * the compiler can vectorize it. */
+static void network_swap64(void *buffer, size_t num) /* {{{ */
+{
+#if BYTE_ORDER == BIG_ENDIAN
+  (void)buffer;
+  (void)num;
+#else
+  char *ptr = buffer;
+
+  for (size_t i = 0; i < num; i++) {
+    uint64_t tmp;
+
+    memcpy(&tmp, ptr + i * sizeof(tmp), sizeof(tmp));
+#if defined(__GNUC__)
+    tmp = __builtin_bswap64(tmp);
+#else
+    tmp = htonll(tmp);
+#endif
+    memcpy(ptr + i * sizeof(tmp), &tmp, sizeof(tmp));
+  }
+#endif
+} /* }}} void network_swap64 */
+
+/* Converts gauges at `buffer' between host and network representation in
+ * place. A no-op on hosts using the network representation natively. */
+static void network_swapd(void *buffer, size_t num, bool to_network) /* {{{ */
+{
+#if FP_LAYOUT_NEED_NOTHING
+  (void)buffer;
+  (void)num;
+  (void)to_network;
+#else
+  char *ptr = buffer;
+
+  for (size_t i = 0; i < num; i++) {
+    double tmp;
+
+    memcpy(&tmp, ptr + i * sizeof(tmp), sizeof(tmp));
+    tmp = to_network ? htond(tmp) : ntohd(tmp);
+    memcpy(ptr + i * sizeof(tmp), &tmp, sizeof(tmp));
+  }
+#endif
+} /* }}} void network_swapd */
+
+/* Converts values of different types one by one. */
+static void network_swap_mixed(void *buffer, const uint8_t *types, /* {{{ */
+                               size_t num, bool to_network) {
+  char *ptr = buffer;
+
+  for (size_t i = 0; i < num; i++) {
+    if (types[i] == DS_TYPE_GAUGE)
+      network_swapd(ptr + i * sizeof(value_t), 1, to_network);
+    else
+      network_swap64(ptr + i * sizeof(value_t), 1);
+  }
+} /* }}} void network_swap_mixed */
+
 static int write_part_values(char **ret_buffer, size_t *ret_buffer_len,
-                             const data_set_t *ds, const value_list_t *vl) {
+                             int type, const data_set_t *ds,
+                             const value_list_t *vl) {
   char *packet_ptr;
   size_t packet_len;
-  int num_values;
+  size_t num_values;
 
   part_header_t pkg_ph;
   uint16_t pkg_num_values;
   uint8_t *pkg_values_types;
-  value_t *pkg_values;
-
-  size_t offset;
+  char *pkg_values;
 
   num_values = vl->values_len;
   packet_len = sizeof(part_header_t) + sizeof(uint16_t) +
@@ -593,77 +1135,46 @@ static int write_part_values(char **ret_buffer, size_t *ret_buffer_len,
   if (*ret_buffer_len < packet_len)
     return -1;
 
-  pkg_values_types = malloc(num_values * sizeof(*pkg_values_types));
-  if (pkg_values_types == NULL) {
-    ERROR("network plugin: write_part_values: malloc failed.");
-    return -1;
-  }
+  packet_ptr = *ret_buffer;
+  pkg_values_types =
+      (uint8_t *)packet_ptr + sizeof(pkg_ph) + sizeof(pkg_num_values);
+  pkg_values = (char *)pkg_values_types + num_values * sizeof(uint8_t);
 
-  pkg_values = malloc(num_values * sizeof(*pkg_values));
-  if (pkg_values == NULL) {
-    free(pkg_values_types);
-    ERROR("network plugin: write_part_values: malloc failed.");
+  for (size_t i = 0; i < num_values; i++)
+    pkg_values_types[i] = (uint8_t)ds->ds[i].type;
+
+  int kind = network_values_kind(pkg_values_types, num_values);
+  if (kind < 0) {
+    ERROR("network plugin: write_part_values: "
+          "Unknown data source type in data set \"%s\".",
+          ds->type);
     return -1;
   }
 
-  pkg_ph.type = htons(TYPE_VALUES);
+  pkg_ph.type = htons(type);
   pkg_ph.length = htons(packet_len);
-
   pkg_num_values = htons((uint16_t)vl->values_len);
 
-  for (int i = 0; i < num_values; i++) {
-    pkg_values_types[i] = (uint8_t)ds->ds[i].type;
-    switch (ds->ds[i].type) {
-    case DS_TYPE_COUNTER:
-      pkg_values[i].counter = htonll(vl->values[i].counter);
-      break;
-
-    case DS_TYPE_GAUGE:
-      pkg_values[i].gauge = htond(vl->values[i].gauge);
-      break;
-
-    case DS_TYPE_DERIVE:
-      pkg_values[i].derive = htonll(vl->values[i].derive);
-      break;
-
-    case DS_TYPE_ABSOLUTE:
-      pkg_values[i].absolute = htonll(vl->values[i].absolute);
-      break;
-
-    default:
-      free(pkg_values_types);
-      free(pkg_values);
-      ERROR("network plugin: write_part_values: "
-            "Unknown data source type: %i",
-            ds->ds[i].type);
-      return -1;
-    } /* switch (ds->ds[i].type) */
-  }   /* for (num_values) */
-
   /*
    * Use `memcpy' to write everything to the buffer, because the pointer
    * may be unaligned and some architectures, such as SPARC, can't handle
-   * that.
+   * that. The values are converted in place afterwards.
    */
-  packet_ptr = *ret_buffer;
-  offset = 0;
-  memcpy(packet_ptr + offset, &pkg_ph, sizeof(pkg_ph));
-  offset += sizeof(pkg_ph);
-  memcpy(packet_ptr + offset, &pkg_num_values, sizeof(pkg_num_values));
-  offset += sizeof(pkg_num_values);
-  memcpy(packet_ptr + offset, pkg_values_types, num_values * sizeof(uint8_t));
-  offset += num_values * sizeof(uint8_t);
-  memcpy(packet_ptr + offset, pkg_values, num_values * sizeof(value_t));
-  offset += num_values * sizeof(value_t);
-
-  assert(offset == packet_len);
+  memcpy(packet_ptr, &pkg_ph, sizeof(pkg_ph));
+  memcpy(packet_ptr + sizeof(pkg_ph), &pkg_num_values, sizeof(pkg_num_values));
+  memcpy(pkg_values, vl->values, num_values * sizeof(value_t));
+
+  if (kind == VALUES_KIND_INTEGER)
+    network_swap64(pkg_values, num_values);
+  else if (kind == VALUES_KIND_GAUGE)
+    network_swapd(pkg_values, num_values, /* to_network = */ true);
+  else
+    network_swap_mixed(pkg_values, pkg_values_types, num_values,
+                       /* to_network = */ true);
 
   *ret_buffer = packet_ptr + packet_len;
   *ret_buffer_len -= packet_len;
 
-  free(pkg_values_types);
-  free(pkg_values);
-
   return 0;
 } /* int write_part_values */
 
@@ -771,7 +1282,7 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
   buffer += sizeof(tmp16);
   pkg_numval = (size_t)ntohs(tmp16);
 
-  assert(pkg_type == TYPE_VALUES);
+  assert((pkg_type == TYPE_VALUES) || (pkg_type == TYPE_IDENT_VALUES));
 
   exp_size =
       3 * sizeof(uint16_t) + pkg_numval * (sizeof(uint8_t) + sizeof(value_t));
@@ -792,55 +1303,44 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
     return -1;
   }
 
-  pkg_types = calloc(pkg_numval, sizeof(*pkg_types));
-  pkg_values = calloc(pkg_numval, sizeof(*pkg_values));
-  if ((pkg_types == NULL) || (pkg_values == NULL)) {
-    sfree(pkg_types);
-    sfree(pkg_values);
-    ERROR("network plugin: parse_part_values: calloc failed.");
+  pkg_types = (uint8_t *)buffer;
+  buffer += pkg_numval * sizeof(*pkg_types);
+
+  int kind = network_values_kind(pkg_types, pkg_numval);
+  if (kind < 0) {
+    for (size_t i = 0; i < pkg_numval; i++) {
+      if (pkg_types[i] > DS_TYPE_ABSOLUTE) {
+        NOTICE("network plugin: parse_part_values: "
+               "Don't know how to handle data source type %" PRIu8,
+               pkg_types[i]);
+        break;
+      }
+    }
+    return -1;
+  }
+
+  pkg_values = malloc(pkg_numval * sizeof(*pkg_values));
+  if (pkg_values == NULL) {
+    ERROR("network plugin: parse_part_values: malloc failed.");
     return -1;
   }
 
-  memcpy(pkg_types, buffer, pkg_numval * sizeof(*pkg_types));
-  buffer += pkg_numval * sizeof(*pkg_types);
   memcpy(pkg_values, buffer, pkg_numval * sizeof(*pkg_values));
   buffer += pkg_numval * sizeof(*pkg_values);
 
-  for (size_t i = 0; i < pkg_numval; i++) {
-    switch (pkg_types[i]) {
-    case DS_TYPE_COUNTER:
-      pkg_values[i].counter = (counter_t)ntohll(pkg_values[i].counter);
-      break;
-
-    case DS_TYPE_GAUGE:
-      pkg_values[i].gauge = (gauge_t)ntohd(pkg_values[i].gauge);
-      break;
-
-    case DS_TYPE_DERIVE:
-      pkg_values[i].derive = (derive_t)ntohll(pkg_values[i].derive);
-      break;
-
-    case DS_TYPE_ABSOLUTE:
-      pkg_values[i].absolute = (absolute_t)ntohll(pkg_values[i].absolute);
-      break;
-
-    default:
-      NOTICE("network plugin: parse_part_values: "
-             "Don't know how to handle data source type %" PRIu8,
-             pkg_types[i]);
-      sfree(pkg_types);
-      sfree(pkg_values);
-      return -1;
-    } /* switch (pkg_types[i]) */
-  }
+  if (kind == VALUES_KIND_INTEGER)
+    network_swap64(pkg_values, pkg_numval);
+  else if (kind == VALUES_KIND_GAUGE)
+    network_swapd(pkg_values, pkg_numval, /* to_network = */ false);
+  else
+    network_swap_mixed(pkg_values, pkg_types, pkg_numval,
+                       /* to_network = */ false);
 
   *ret_buffer = buffer;
   *ret_buffer_len = buffer_len - pkg_length;
   *ret_num_values = pkg_numval;
   *ret_values = pkg_values;
 
-  sfree(pkg_types);
-
   return 0;
 } /* int parse_part_values */
 
@@ -882,8 +1382,12 @@ static int parse_part_number(void **ret_buffer, size_t *ret_buffer_len,
   return 0;
 } /* int parse_part_number */
 
-static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
-                             char *output, size_t const output_len) {
+/* Checks a string part and returns a pointer to the string inside the packet
+ * instead of copying it. `ret_size' is set to the size of the string including
+ * the terminating null byte. */
+static int parse_part_string_view(void **ret_buffer, /* {{{ */
+                                  size_t *ret_buffer_len,
+                                  char const **ret_string, size_t *ret_size) {
   char *buffer = *ret_buffer;
   size_t buffer_len = *ret_buffer_len;
 
@@ -893,9 +1397,6 @@ static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
   uint16_t pkg_length;
   size_t payload_size;
 
-  if (output_len == 0)
-    return EINVAL;
-
   if (buffer_len < header_size) {
     WARNING("network plugin: parse_part_string: "
             "Packet too short: "
@@ -934,42 +1435,90 @@ static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
     return -1;
   }
 
-  /* Check that the package data fits into the output buffer.
-   * The previous if-statement ensures that:
-   * `pkg_length > header_size' */
-  if (output_len < payload_size) {
-    WARNING("network plugin: parse_part_string: "
-            "Buffer too small: "
-            "Output buffer holds %" PRIsz " bytes, "
-            "which is too small to hold the received "
-            "%" PRIsz " byte string.",
-            output_len, payload_size);
-    return -1;
-  }
-
-  /* All sanity checks successfull, let's copy the data over */
-  memcpy((void *)output, (void *)buffer, payload_size);
   buffer += payload_size;
 
   /* For some very weird reason '\0' doesn't do the trick on SPARC in
    * this statement. */
-  if (output[payload_size - 1] != 0) {
+  if (buffer[-1] != 0) {
     WARNING("network plugin: parse_part_string: "
             "Received string does not end "
             "with a NULL-byte.");
     return -1;
   }
 
+  *ret_string = buffer - payload_size;
+  *ret_size = payload_size;
   *ret_buffer = buffer;
   *ret_buffer_len = buffer_len - pkg_length;
 
+  return 0;
+} /* }}} int parse_part_string_view */
+
+static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
+                             char *output, size_t const output_len) {
+  char const *string;
+  size_t size;
+  int status;
+
+  if (output_len == 0)
+    return EINVAL;
+
+  status = parse_part_string_view(ret_buffer, ret_buffer_len, &string, &size);
+  if (status != 0)
+    return status;
+
+  if (output_len < size) {
+    WARNING("network plugin: parse_part_string: "
+            "Buffer too small: "
+            "Output buffer holds %" PRIsz " bytes, "
+            "which is too small to hold the received "
+            "%" PRIsz " byte string.",
+            output_len, size);
+    return -1;
+  }
+
+  memcpy(output, string, size);
   return 0;
 } /* int parse_part_string */
 
+/* Parses a string part into one of the identifier fields of `vl' and its
+ * counterpart `n_field' in the notification. Packets usually repeat the same
+ * host, plugin, ... for many values, so the fields are only written if the
+ * string differs; only then is the interned identifier of `vl' dropped. */
+static int parse_part_ident(void **ret_buffer, size_t *ret_buffer_len, /* {{{ */
+                            value_list_t *vl, char *field, char *n_field) {
+  char const *string;
+  size_t size;
+  int status;
+
+  status = parse_part_string_view(ret_buffer, ret_buffer_len, &string, &size);
+  if (status != 0)
+    return status;
+
+  if (size > DATA_MAX_NAME_LEN) {
+    WARNING("network plugin: parse_part_string: "
+            "Buffer too small: "
+            "Output buffer holds %d bytes, "
+            "which is too small to hold the received "
+            "%" PRIsz " byte string.",
+            DATA_MAX_NAME_LEN, size);
+    return -1;
+  }
+
+  if (memcmp(field, string, size) == 0)
+    return 0;
+
+  memcpy(field, string, size);
+  memcpy(n_field, string, size);
+  ident_reset(vl);
+  return 0;
+} /* }}} int parse_part_ident */
+
 /* Forward declaration: parse_part_sign_sha256 and parse_part_encr_aes256 call
  * parse_packet and vice versa. */
 #define PP_SIGNED 0x01
 #define PP_ENCRYPTED 0x02
+#define PP_COMPRESSED 0x04
 static int parse_packet(sockent_t *se, void *buffer, size_t buffer_size,
                         int flags, const char *username);
 
@@ -979,12 +1528,168 @@ static int parse_packet(sockent_t *se, void *buffer, size_t buffer_size,
     buffer_offset += (s);                                                      \
   } while (0)
 
-#if HAVE_GCRYPT_H
-static int parse_part_sign_sha256(sockent_t *se, /* {{{ */
-                                  void **ret_buffer, size_t *ret_buffer_len,
-                                  int flags) {
-  static c_complain_t complain_no_users = C_COMPLAIN_INIT_STATIC;
-
+#if HAVE_LIBZ
+/* Per thread inflate state and buffer, reused for every compressed part. */
+struct decompress_state_s {
+  z_stream stream;
+  char *buffer;
+  size_t buffer_size;
+};
+typedef struct decompress_state_s decompress_state_t;
+
+static pthread_key_t decompress_key;
+static pthread_once_t decompress_once = PTHREAD_ONCE_INIT;
+
+static void decompress_state_free(void *arg) /* {{{ */
+{
+  decompress_state_t *state = arg;
+
+  if (state == NULL)
+    return;
+
+  inflateEnd(&state->stream);
+  sfree(state->buffer);
+  sfree(state);
+} /* }}} void decompress_state_free */
+
+static void decompress_key_create(void) /* {{{ */
+{
+  pthread_key_create(&decompress_key, decompress_state_free);
+} /* }}} void decompress_key_create */
+
+static decompress_state_t *decompress_state_get(void) /* {{{ */
+{
+  decompress_state_t *state;
+
+  pthread_once(&decompress_once, decompress_key_create);
+
+  state = pthread_getspecific(decompress_key);
+  if (state != NULL)
+    return state;
+
+  state = calloc(1, sizeof(*state));
+  if (state == NULL)
+    return NULL;
+
+  if (inflateInit2(&state->stream, /* raw deflate = */ -MAX_WBITS) != Z_OK) {
+    ERROR("network plugin: inflateInit2 failed.");
+    sfree(state);
+    return NULL;
+  }
+
+  pthread_setspecific(decompress_key, state);
+  return state;
+} /* }}} decompress_state_t *decompress_state_get */
+
+static int parse_part_compressed(sockent_t *se, /* {{{ */
+                                 void **ret_buffer, size_t *ret_buffer_len,
+                                 int flags, const char *username) {
+  char *buffer = *ret_buffer;
+  size_t buffer_len = *ret_buffer_len;
+  size_t buffer_offset = 0;
+  uint16_t tmp16;
+  uint32_t tmp32;
+  size_t part_size;
+  uint16_t dictionary;
+  size_t original_len;
+  int status;
+
+  if (buffer_len <= PART_COMPRESSED_SIZE) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding short packet.");
+    return -1;
+  }
+
+  /* Type */
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  part_size = ntohs(tmp16);
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  dictionary = ntohs(tmp16);
+  BUFFER_READ(&tmp32, sizeof(tmp32));
+  original_len = ntohl(tmp32);
+
+  if ((part_size <= PART_COMPRESSED_SIZE) || (part_size > buffer_len)) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding part with invalid size.");
+    return -1;
+  }
+
+  if ((original_len == 0) || (original_len > COMPRESS_ORIGINAL_MAX)) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding part with invalid original length %" PRIsz ".",
+           original_len);
+    return -1;
+  }
+
+  if ((dictionary != COMPRESS_DICTIONARY_NONE) &&
+      (dictionary != COMPRESS_DICTIONARY_V1)) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding part with unknown dictionary %" PRIu16 ".",
+           dictionary);
+    return -1;
+  }
+
+  /* The decompressed data is parsed from the thread's buffer, which must not
+   * be overwritten while parsing it. */
+  if (flags & PP_COMPRESSED) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding nested compressed part.");
+    return -1;
+  }
+
+  decompress_state_t *state = decompress_state_get();
+  if (state == NULL)
+    return -ENOMEM;
+
+  if (state->buffer_size < original_len) {
+    char *tmp = realloc(state->buffer, original_len);
+    if (tmp == NULL) {
+      ERROR("network plugin: realloc failed.");
+      return -ENOMEM;
+    }
+    state->buffer = tmp;
+    state->buffer_size = original_len;
+  }
+
+  z_stream *strm = &state->stream;
+  inflateReset(strm);
+  if ((dictionary == COMPRESS_DICTIONARY_V1) &&
+      (inflateSetDictionary(strm, (const Bytef *)compress_dictionary,
+                            sizeof(compress_dictionary)) != Z_OK)) {
+    ERROR("network plugin: inflateSetDictionary failed.");
+    return -1;
+  }
+
+  strm->next_in = (Bytef *)(buffer + buffer_offset);
+  strm->avail_in = (uInt)(part_size - buffer_offset);
+  strm->next_out = (Bytef *)state->buffer;
+  strm->avail_out = (uInt)original_len;
+
+  status = inflate(strm, Z_FINISH);
+  if ((status != Z_STREAM_END) || (strm->total_out != original_len)) {
+    NOTICE("network plugin: parse_part_compressed: "
+           "Discarding corrupt compressed part (%s).",
+           (strm->msg != NULL) ? strm->msg : "length mismatch");
+    return -1;
+  }
+
+  parse_packet(se, state->buffer, original_len, flags | PP_COMPRESSED,
+               username);
+
+  *ret_buffer = buffer + part_size;
+  *ret_buffer_len = buffer_len - part_size;
+
+  return 0;
+} /* }}} int parse_part_compressed */
+#endif /* HAVE_LIBZ */
+
+#if HAVE_GCRYPT_H
+static int parse_part_sign_sha256(sockent_t *se, /* {{{ */
+                                  void **ret_buffer, size_t *ret_buffer_len,
+                                  int flags) {
+  static c_complain_t complain_no_users = C_COMPLAIN_INIT_STATIC;
+
   char *buffer;
   size_t buffer_len;
   size_t buffer_offset;
@@ -1216,8 +1921,17 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
   assert(buffer_offset ==
          (username_len + PART_ENCRYPTION_AES256_SIZE - sizeof(pea.hash)));
 
-  cypher = network_get_aes256_cypher(se, pea.iv, sizeof(pea.iv), pea.username);
+  network_key_t *key = network_key_get(se, pea.username);
+  if (key == NULL) {
+    ERROR("network plugin: Failed to get cypher. Username: %s", pea.username);
+    sfree(pea.username);
+    return -1;
+  }
+
+  cypher = network_cypher_prepare(&key->ofb, GCRY_CIPHER_MODE_OFB, key->hash,
+                                  sizeof(key->hash), pea.iv, sizeof(pea.iv));
   if (cypher == NULL) {
+    pthread_mutex_unlock(&key->lock);
     ERROR("network plugin: Failed to get cypher. Username: %s", pea.username);
     sfree(pea.username);
     return -1;
@@ -1230,6 +1944,7 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
   err = gcry_cipher_decrypt(cypher, buffer + buffer_offset,
                             part_size - buffer_offset,
                             /* in = */ NULL, /* in len = */ 0);
+  pthread_mutex_unlock(&key->lock);
   if (err != 0) {
     ERROR("network plugin: gcry_cipher_decrypt returned: %s. Username: %s",
           gcry_strerror(err), pea.username);
@@ -1263,6 +1978,108 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
 
   return 0;
 } /* }}} int parse_part_encr_aes256 */
+
+#if NETWORK_HAVE_GCM
+static int parse_part_encr_aes256_gcm(sockent_t *se, /* {{{ */
+                                      void **ret_buffer,
+                                      size_t *ret_buffer_len, int flags) {
+  char *buffer = *ret_buffer;
+  size_t buffer_len = *ret_buffer_len;
+  size_t buffer_offset = 0;
+  size_t header_size;
+  size_t part_size;
+  size_t payload_len;
+  uint16_t tmp16;
+  uint16_t username_len;
+  char *username;
+  unsigned char iv[PART_ENCRYPTION_AES256_GCM_IV_SIZE];
+  unsigned char tag[PART_ENCRYPTION_AES256_GCM_TAG_SIZE];
+
+  gcry_cipher_hd_t cypher;
+  gcry_error_t err;
+
+  if (buffer_len <= PART_ENCRYPTION_AES256_GCM_SIZE) {
+    NOTICE("network plugin: parse_part_encr_aes256_gcm: "
+           "Discarding short packet.");
+    return -1;
+  }
+
+  /* Type */
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  /* Length */
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  part_size = ntohs(tmp16);
+  if ((part_size <= PART_ENCRYPTION_AES256_GCM_SIZE) ||
+      (part_size > buffer_len)) {
+    NOTICE("network plugin: parse_part_encr_aes256_gcm: "
+           "Discarding part with invalid size.");
+    return -1;
+  }
+
+  BUFFER_READ(&tmp16, sizeof(tmp16));
+  username_len = ntohs(tmp16);
+  if ((username_len == 0) ||
+      (username_len > (part_size - (PART_ENCRYPTION_AES256_GCM_SIZE + 1)))) {
+    NOTICE("network plugin: parse_part_encr_aes256_gcm: "
+           "Discarding part with invalid username length.");
+    return -1;
+  }
+
+  username = malloc(username_len + 1);
+  if (username == NULL)
+    return -ENOMEM;
+  BUFFER_READ(username, username_len);
+  username[username_len] = 0;
+  header_size = buffer_offset;
+
+  BUFFER_READ(iv, sizeof(iv));
+  BUFFER_READ(tag, sizeof(tag));
+  assert(buffer_offset == (username_len + PART_ENCRYPTION_AES256_GCM_SIZE));
+  payload_len = part_size - buffer_offset;
+
+  network_key_t *key = network_key_get(se, username);
+  if (key == NULL) {
+    ERROR("network plugin: Failed to get cypher. Username: %s", username);
+    sfree(username);
+    return -1;
+  }
+
+  cypher = network_cypher_prepare(&key->gcm, GCRY_CIPHER_MODE_GCM, key->hash,
+                                  sizeof(key->hash), iv, sizeof(iv));
+  if (cypher == NULL) {
+    pthread_mutex_unlock(&key->lock);
+    ERROR("network plugin: Failed to get cypher. Username: %s", username);
+    sfree(username);
+    return -1;
+  }
+
+  /* Decrypt the packet in-place and verify the header and payload in the same
+   * pass. */
+  err = gcry_cipher_authenticate(cypher, buffer, header_size);
+  if (err == 0)
+    err = gcry_cipher_decrypt(cypher, buffer + buffer_offset, payload_len,
+                              /* in = */ NULL, /* in len = */ 0);
+  if (err == 0)
+    err = gcry_cipher_checktag(cypher, tag, sizeof(tag));
+  pthread_mutex_unlock(&key->lock);
+  if (err != 0) {
+    ERROR("network plugin: Decrypting AES-256-GCM part failed: %s. "
+          "Username: %s",
+          gcry_strerror(err), username);
+    sfree(username);
+    return -1;
+  }
+
+  parse_packet(se, buffer + buffer_offset, payload_len, flags | PP_ENCRYPTED,
+               username);
+
+  *ret_buffer = buffer + part_size;
+  *ret_buffer_len = buffer_len - part_size;
+
+  sfree(username);
+  return 0;
+} /* }}} int parse_part_encr_aes256_gcm */
+#endif /* NETWORK_HAVE_GCM */
 /* #endif HAVE_GCRYPT_H */
 
 #else  /* if !HAVE_GCRYPT_H */
@@ -1311,6 +2128,262 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
 
 #undef BUFFER_READ
 
+/* Receiver side of the identifier dictionary: one session per sender and
+ * listening socket, holding the identifiers by number. */
+struct ident_ref_s {
+  value_ident_t *ident;
+  char *host;
+  char *plugin;
+  char *plugin_instance;
+  char *type;
+  char *type_instance;
+  char data[];
+};
+typedef struct ident_ref_s ident_ref_t;
+
+struct ident_session_s {
+  sockent_t *se;
+  uint64_t id;
+  cdtime_t last_seen;
+
+  ident_ref_t **refs;
+  size_t refs_num;
+};
+typedef struct ident_session_s ident_session_t;
+
+static c_avl_tree_t *ident_sessions;
+static pthread_mutex_t ident_sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int ident_session_compare(const void *a, const void *b) /* {{{ */
+{
+  const ident_session_t *s0 = a;
+  const ident_session_t *s1 = b;
+
+  if (s0->se != s1->se)
+    return (s0->se < s1->se) ? -1 : 1;
+  if (s0->id != s1->id)
+    return (s0->id < s1->id) ? -1 : 1;
+  return 0;
+} /* }}} int ident_session_compare */
+
+static void ident_session_free(ident_session_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  for (size_t i = 0; i < s->refs_num; i++) {
+    if (s->refs[i] == NULL)
+      continue;
+    ident_unref(s->refs[i]->ident);
+    sfree(s->refs[i]);
+  }
+  sfree(s->refs);
+  sfree(s);
+} /* }}} void ident_session_free */
+
+static void ident_sessions_destroy(void) /* {{{ */
+{
+  ident_session_t *key;
+  ident_session_t *s;
+
+  pthread_mutex_lock(&ident_sessions_lock);
+  if (ident_sessions != NULL) {
+    while (c_avl_pick(ident_sessions, (void *)&key, (void *)&s) == 0)
+      ident_session_free(s);
+    c_avl_destroy(ident_sessions);
+    ident_sessions = NULL;
+  }
+  pthread_mutex_unlock(&ident_sessions_lock);
+} /* }}} void ident_sessions_destroy */
+
+/* Drops expired sessions and, if there are too many, the least recently seen
+ * one. Called with `ident_sessions_lock' held. */
+static void ident_sessions_expire(cdtime_t now) /* {{{ */
+{
+  while (42) {
+    c_avl_iterator_t *iter = c_avl_get_iterator(ident_sessions);
+    ident_session_t *key;
+    ident_session_t *s;
+    ident_session_t *oldest = NULL;
+
+    while (c_avl_iterator_next(iter, (void *)&key, (void *)&s) == 0) {
+      if ((oldest == NULL) || (s->last_seen < oldest->last_seen))
+        oldest = s;
+    }
+    c_avl_iterator_destroy(iter);
+
+    if ((oldest == NULL) ||
+        (((now - oldest->last_seen) < IDENT_SESSION_TIMEOUT) &&
+         (c_avl_size(ident_sessions) < IDENT_SESSIONS_MAX)))
+      return;
+
+    c_avl_remove(ident_sessions, oldest, NULL, NULL);
+    ident_session_free(oldest);
+  }
+} /* }}} void ident_sessions_expire */
+
+/* Called with `ident_sessions_lock' held. */
+static ident_session_t *ident_session_get(sockent_t *se, /* {{{ */
+                                          uint64_t id, bool create) {
+  ident_session_t key = {.se = se, .id = id};
+  ident_session_t *s = NULL;
+
+  if (ident_sessions == NULL) {
+    if (!create)
+      return NULL;
+    ident_sessions = c_avl_create(ident_session_compare);
+    if (ident_sessions == NULL)
+      return NULL;
+  }
+
+  if ((c_avl_get(ident_sessions, &key, (void *)&s) == 0) || !create)
+    return s;
+
+  ident_sessions_expire(cdtime());
+
+  s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+  s->se = se;
+  s->id = id;
+
+  if (c_avl_insert(ident_sessions, s, s) != 0) {
+    sfree(s);
+    return NULL;
+  }
+
+  return s;
+} /* }}} ident_session_t *ident_session_get */
+
+/* Handles a TYPE_IDENT_DEFINE part: `id' is assigned the identifier
+ * currently held by `vl'. */
+static int ident_session_define(sockent_t *se, uint64_t session, /* {{{ */
+                                uint64_t id, value_list_t *vl) {
+  if ((session == 0) || (id == 0) || (id > IDENT_DICT_SIZE))
+    return -EINVAL;
+  if ((strlen(vl->host) == 0) || (strlen(vl->plugin) == 0) ||
+      (strlen(vl->type) == 0))
+    return -EINVAL;
+
+  if (vl->ident == NULL) {
+    vl->ident = ident_get(vl);
+    if (vl->ident == NULL)
+      return -ENOMEM;
+  }
+
+  size_t len[5] = {strlen(vl->host) + 1, strlen(vl->plugin) + 1,
+                   strlen(vl->plugin_instance) + 1, strlen(vl->type) + 1,
+                   strlen(vl->type_instance) + 1};
+  ident_ref_t *ref = malloc(sizeof(*ref) + len[0] + len[1] + len[2] +
+                            len[3] + len[4]);
+  if (ref == NULL)
+    return -ENOMEM;
+
+  ref->host = ref->data;
+  ref->plugin = ref->host + len[0];
+  ref->plugin_instance = ref->plugin + len[1];
+  ref->type = ref->plugin_instance + len[2];
+  ref->type_instance = ref->type + len[3];
+  memcpy(ref->host, vl->host, len[0]);
+  memcpy(ref->plugin, vl->plugin, len[1]);
+  memcpy(ref->plugin_instance, vl->plugin_instance, len[2]);
+  memcpy(ref->type, vl->type, len[3]);
+  memcpy(ref->type_instance, vl->type_instance, len[4]);
+
+  pthread_mutex_lock(&ident_sessions_lock);
+
+  ident_session_t *s = ident_session_get(se, session, /* create = */ true);
+  if (s == NULL) {
+    pthread_mutex_unlock(&ident_sessions_lock);
+    sfree(ref);
+    return -ENOMEM;
+  }
+  s->last_seen = cdtime();
+
+  if (s->refs_num < id) {
+    size_t refs_num = (s->refs_num == 0) ? 64 : s->refs_num;
+    while (refs_num < id)
+      refs_num *= 2;
+
+    ident_ref_t **tmp = realloc(s->refs, refs_num * sizeof(*tmp));
+    if (tmp == NULL) {
+      pthread_mutex_unlock(&ident_sessions_lock);
+      sfree(ref);
+      return -ENOMEM;
+    }
+    memset(tmp + s->refs_num, 0, (refs_num - s->refs_num) * sizeof(*tmp));
+    s->refs = tmp;
+    s->refs_num = refs_num;
+  }
+
+  ident_ref_t *old = s->refs[id - 1];
+  if ((old != NULL) && (old->ident == vl->ident)) {
+    /* Refreshed definition, nothing changed. */
+    pthread_mutex_unlock(&ident_sessions_lock);
+    sfree(ref);
+    return 0;
+  }
+
+  ref->ident = ident_ref(vl->ident);
+  s->refs[id - 1] = ref;
+
+  pthread_mutex_unlock(&ident_sessions_lock);
+
+  if (old != NULL) {
+    ident_unref(old->ident);
+    sfree(old);
+  }
+  return 0;
+} /* }}} int ident_session_define */
+
+/* Handles a TYPE_IDENT_REF part: sets the identifier of `vl' and `n' to the
+ * one numbered `id'. If `id' is unknown, e.g. because the definition has been
+ * lost, the identifier is cleared so that the following values are not
+ * dispatched until the next definition. */
+static int ident_session_resolve(sockent_t *se, uint64_t session, /* {{{ */
+                                 uint64_t id, value_list_t *vl,
+                                 notification_t *n) {
+  ident_ref_t *ref = NULL;
+
+  pthread_mutex_lock(&ident_sessions_lock);
+
+  ident_session_t *s = NULL;
+  if (session != 0)
+    s = ident_session_get(se, session, /* create = */ false);
+  if ((s != NULL) && (id != 0) && (id <= s->refs_num))
+    ref = s->refs[id - 1];
+
+  if (ref == NULL) {
+    pthread_mutex_unlock(&ident_sessions_lock);
+    ident_reset(vl);
+    vl->host[0] = vl->plugin[0] = vl->plugin_instance[0] = 0;
+    vl->type[0] = vl->type_instance[0] = 0;
+    return -ENOENT;
+  }
+
+  if (vl->ident != ref->ident) {
+    ident_reset(vl);
+    vl->ident = ident_ref(ref->ident);
+
+    sstrncpy(vl->host, ref->host, sizeof(vl->host));
+    sstrncpy(vl->plugin, ref->plugin, sizeof(vl->plugin));
+    sstrncpy(vl->plugin_instance, ref->plugin_instance,
+             sizeof(vl->plugin_instance));
+    sstrncpy(vl->type, ref->type, sizeof(vl->type));
+    sstrncpy(vl->type_instance, ref->type_instance, sizeof(vl->type_instance));
+
+    sstrncpy(n->host, ref->host, sizeof(n->host));
+    sstrncpy(n->plugin, ref->plugin, sizeof(n->plugin));
+    sstrncpy(n->plugin_instance, ref->plugin_instance,
+             sizeof(n->plugin_instance));
+    sstrncpy(n->type, ref->type, sizeof(n->type));
+    sstrncpy(n->type_instance, ref->type_instance, sizeof(n->type_instance));
+  }
+
+  pthread_mutex_unlock(&ident_sessions_lock);
+  return 0;
+} /* }}} int ident_session_resolve */
+
 static int parse_packet(sockent_t *se, /* {{{ */
                         void *buffer, size_t buffer_size, int flags,
                         const char *username) {
@@ -1318,6 +2391,7 @@ static int parse_packet(sockent_t *se, /* {{{ */
 
   value_list_t vl = VALUE_LIST_INIT;
   notification_t n = {0};
+  uint64_t session = 0;
 
 #if HAVE_GCRYPT_H
   int packet_was_signed = (flags & PP_SIGNED);
@@ -1356,6 +2430,18 @@ static int parse_packet(sockent_t *se, /* {{{ */
         break;
       }
     }
+#if NETWORK_HAVE_GCM
+    else if (pkg_type == TYPE_ENCR_AES256_GCM) {
+      status = parse_part_encr_aes256_gcm(se, &buffer, &buffer_size, flags);
+      if (status != 0) {
+        ERROR("network plugin: Decrypting AES256-GCM "
+              "part failed "
+              "with status %i.",
+              status);
+        break;
+      }
+    }
+#endif /* NETWORK_HAVE_GCM */
 #if HAVE_GCRYPT_H
     else if ((se->data.server.security_level == SECURITY_LEVEL_ENCRYPT) &&
              (packet_was_encrypted == 0)) {
@@ -1392,7 +2478,19 @@ static int parse_packet(sockent_t *se, /* {{{ */
       continue;
     }
 #endif /* HAVE_GCRYPT_H */
-    else if (pkg_type == TYPE_VALUES) {
+#if HAVE_LIBZ
+    else if (pkg_type == TYPE_COMPRESSED_DEFLATE) {
+      status = parse_part_compressed(se, &buffer, &buffer_size, flags,
+                                     username);
+      if (status != 0) {
+        ERROR("network plugin: Decompressing part failed "
+              "with status %i.",
+              status);
+        break;
+      }
+    }
+#endif /* HAVE_LIBZ */
+    else if ((pkg_type == TYPE_VALUES) || (pkg_type == TYPE_IDENT_VALUES)) {
       status =
           parse_part_values(&buffer, &buffer_size, &vl.values, &vl.values_len);
       if (status != 0)
@@ -1426,31 +2524,30 @@ static int parse_packet(sockent_t *se, /* {{{ */
       if (status == 0)
         vl.interval = (cdtime_t)tmp;
     } else if (pkg_type == TYPE_HOST) {
-      status =
-          parse_part_string(&buffer, &buffer_size, vl.host, sizeof(vl.host));
-      if (status == 0)
-        sstrncpy(n.host, vl.host, sizeof(n.host));
+      status = parse_part_ident(&buffer, &buffer_size, &vl, vl.host, n.host);
     } else if (pkg_type == TYPE_PLUGIN) {
-      status = parse_part_string(&buffer, &buffer_size, vl.plugin,
-                                 sizeof(vl.plugin));
-      if (status == 0)
-        sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
+      status =
+          parse_part_ident(&buffer, &buffer_size, &vl, vl.plugin, n.plugin);
     } else if (pkg_type == TYPE_PLUGIN_INSTANCE) {
-      status = parse_part_string(&buffer, &buffer_size, vl.plugin_instance,
-                                 sizeof(vl.plugin_instance));
-      if (status == 0)
-        sstrncpy(n.plugin_instance, vl.plugin_instance,
-                 sizeof(n.plugin_instance));
+      status = parse_part_ident(&buffer, &buffer_size, &vl, vl.plugin_instance,
+                                n.plugin_instance);
     } else if (pkg_type == TYPE_TYPE) {
-      status =
-          parse_part_string(&buffer, &buffer_size, vl.type, sizeof(vl.type));
-      if (status == 0)
-        sstrncpy(n.type, vl.type, sizeof(n.type));
+      status = parse_part_ident(&buffer, &buffer_size, &vl, vl.type, n.type);
     } else if (pkg_type == TYPE_TYPE_INSTANCE) {
-      status = parse_part_string(&buffer, &buffer_size, vl.type_instance,
-                                 sizeof(vl.type_instance));
+      status = parse_part_ident(&buffer, &buffer_size, &vl, vl.type_instance,
+                                n.type_instance);
+    } else if (pkg_type == TYPE_IDENT_SESSION) {
+      status = parse_part_number(&buffer, &buffer_size, &session);
+    } else if (pkg_type == TYPE_IDENT_DEFINE) {
+      uint64_t tmp = 0;
+      status = parse_part_number(&buffer, &buffer_size, &tmp);
+      if (status == 0)
+        ident_session_define(se, session, tmp, &vl);
+    } else if (pkg_type == TYPE_IDENT_REF) {
+      uint64_t tmp = 0;
+      status = parse_part_number(&buffer, &buffer_size, &tmp);
       if (status == 0)
-        sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
+        ident_session_resolve(se, session, tmp, &vl, &n);
     } else if (pkg_type == TYPE_MESSAGE) {
       status = parse_part_string(&buffer, &buffer_size, n.message,
                                  sizeof(n.message));
@@ -1492,6 +2589,7 @@ static int parse_packet(sockent_t *se, /* {{{ */
     WARNING("network plugin: parse_packet: Received truncated "
             "packet, try increasing `MaxPacketSize'");
 
+  ident_reset(&vl);
   return status;
 } /* }}} int parse_packet */
 
@@ -1524,8 +2622,12 @@ static void free_sockent_server(struct sockent_server *ses) /* {{{ */
 #if HAVE_GCRYPT_H
   sfree(ses->auth_file);
   fbh_destroy(ses->userdb);
-  if (ses->cypher != NULL)
-    gcry_cipher_close(ses->cypher);
+  while (ses->keys != NULL) {
+    network_key_t *k = ses->keys;
+    ses->keys = k->next;
+    network_key_free(k);
+  }
+  pthread_mutex_destroy(&ses->keys_lock);
 #endif
 } /* }}} void free_sockent_server */
 
@@ -1721,6 +2823,19 @@ static int network_bind_socket_to_addr(sockent_t *se,
   return 0;
 } /* int network_bind_socket_to_addr */
 
+static bool network_is_multicast(const struct addrinfo *ai) /* {{{ */
+{
+  if (ai->ai_family == AF_INET) {
+    struct sockaddr_in *addr = (struct sockaddr_in *)ai->ai_addr;
+    return IN_MULTICAST(ntohl(addr->sin_addr.s_addr));
+  } else if (ai->ai_family == AF_INET6) {
+    struct sockaddr_in6 *addr = (struct sockaddr_in6 *)ai->ai_addr;
+    return IN6_IS_ADDR_MULTICAST(&addr->sin6_addr);
+  }
+
+  return false;
+} /* }}} bool network_is_multicast */
+
 static int network_bind_socket(int fd, const struct addrinfo *ai,
                                const int interface_idx) {
 #if KERNEL_SOLARIS
@@ -1866,7 +2981,8 @@ static sockent_t *sockent_create(int type) /* {{{ */
     se->data.server.security_level = SECURITY_LEVEL_NONE;
     se->data.server.auth_file = NULL;
     se->data.server.userdb = NULL;
-    se->data.server.cypher = NULL;
+    se->data.server.keys = NULL;
+    pthread_mutex_init(&se->data.server.keys_lock, /* attr = */ NULL);
 #endif
   } else {
     se->data.client.fd = -1;
@@ -1874,8 +2990,10 @@ static sockent_t *sockent_create(int type) /* {{{ */
     se->data.client.bind_addr = NULL;
     se->data.client.resolve_interval = 0;
     se->data.client.next_resolve_reconnect = 0;
+    se->data.client.queue = NULL;
 #if HAVE_GCRYPT_H
     se->data.client.security_level = SECURITY_LEVEL_NONE;
+    se->data.client.cipher_mode = CIPHER_MODE_OFB;
     se->data.client.username = NULL;
     se->data.client.password = NULL;
     se->data.client.cypher = NULL;
@@ -1955,9 +3073,65 @@ static int sockent_client_disconnect(sockent_t *se) /* {{{ */
   return 0;
 } /* }}} int sockent_client_disconnect */
 
+/* Connects a TCP socket, waiting at most STREAM_CONNECT_TIMEOUT_MS, and
+ * prepares it for sending. */
+static int network_stream_connect(int fd, /* {{{ */
+                                  const struct addrinfo *ai) {
+  int flags = fcntl(fd, F_GETFL);
+  int status;
+
+  if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+    ERROR("network plugin: fcntl failed: %s", STRERRNO);
+    return -1;
+  }
+
+  status = connect(fd, ai->ai_addr, ai->ai_addrlen);
+  if ((status != 0) && (errno == EINPROGRESS)) {
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+
+    do {
+      status = poll(&pfd, 1, STREAM_CONNECT_TIMEOUT_MS);
+    } while ((status < 0) && (errno == EINTR));
+
+    if (status == 0) {
+      errno = ETIMEDOUT;
+      status = -1;
+    } else if (status > 0) {
+      status = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+      if ((status == 0) && (error != 0)) {
+        errno = error;
+        status = -1;
+      }
+    }
+  }
+  if (status != 0) {
+    DEBUG("network plugin: connect failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* Sending blocks, but not for longer than STREAM_SEND_TIMEOUT_MS. */
+  struct timeval tv = {.tv_sec = STREAM_SEND_TIMEOUT_MS / 1000,
+                       .tv_usec = (STREAM_SEND_TIMEOUT_MS % 1000) * 1000};
+  if ((fcntl(fd, F_SETFL, flags) != 0) ||
+      (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0)) {
+    ERROR("network plugin: Configuring the TCP socket failed: %s", STRERRNO);
+    return -1;
+  }
+
+#ifdef TCP_NODELAY
+  /* Packets are batched already; don't delay the last one. */
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+#endif
+
+  return 0;
+} /* }}} int network_stream_connect */
+
 static int sockent_client_connect(sockent_t *se) /* {{{ */
 {
   static c_complain_t complaint = C_COMPLAIN_INIT_STATIC;
+  static c_complain_t connect_complaint = C_COMPLAIN_INIT_STATIC;
 
   struct sockent_client *client;
   struct addrinfo *ai_list;
@@ -1982,10 +3156,14 @@ static int sockent_client_connect(sockent_t *se) /* {{{ */
   if (client->fd >= 0 && !reconnect) /* already connected and not stale*/
     return 0;
 
+  bool stream = (se->protocol == SOCKENT_PROTOCOL_TCP);
+  if (stream && (client->fd < 0) && (now < client->next_connect))
+    return -1;
+
   struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
                               .ai_flags = AI_ADDRCONFIG,
-                              .ai_protocol = IPPROTO_UDP,
-                              .ai_socktype = SOCK_DGRAM};
+                              .ai_protocol = stream ? IPPROTO_TCP : IPPROTO_UDP,
+                              .ai_socktype = stream ? SOCK_STREAM : SOCK_DGRAM};
 
   status = getaddrinfo(se->node,
                        (se->service != NULL) ? se->service : NET_DEFAULT_PORT,
@@ -2029,14 +3207,41 @@ static int sockent_client_connect(sockent_t *se) /* {{{ */
     network_set_interface(se, ai_ptr);
     network_bind_socket_to_addr(se, ai_ptr);
 
+    if (stream && (network_stream_connect(client->fd, ai_ptr) != 0)) {
+      sockent_client_disconnect(se);
+      continue;
+    }
+
     /* We don't open more than one write-socket per
      * node/service pair.. */
     break;
   }
 
   freeaddrinfo(ai_list);
-  if (client->fd < 0)
+  if (client->fd < 0) {
+    if (stream) {
+      client->connect_backoff =
+          (client->connect_backoff == 0) ? STREAM_BACKOFF_MIN
+                                         : 2 * client->connect_backoff;
+      if (client->connect_backoff > STREAM_BACKOFF_MAX)
+        client->connect_backoff = STREAM_BACKOFF_MAX;
+      client->next_connect = now + client->connect_backoff;
+      c_complain(LOG_WARNING, &connect_complaint,
+                 "network plugin: Connecting to %s:%s failed. Retrying in "
+                 "%.0f seconds.",
+                 se->node,
+                 (se->service != NULL) ? se->service : NET_DEFAULT_PORT,
+                 CDTIME_T_TO_DOUBLE(client->connect_backoff));
+    }
     return -1;
+  }
+
+  if (stream) {
+    client->connect_backoff = 0;
+    c_release(LOG_INFO, &connect_complaint,
+              "network plugin: Connected to %s:%s.", se->node,
+              (se->service != NULL) ? se->service : NET_DEFAULT_PORT);
+  }
 
   if (client->resolve_interval > 0)
     client->next_resolve_reconnect = now + client->resolve_interval;
@@ -2067,10 +3272,11 @@ static int sockent_server_listen(sockent_t *se) /* {{{ */
   DEBUG("network plugin: sockent_server_listen: node = %s; service = %s;", node,
         service);
 
+  bool stream = (se->protocol == SOCKENT_PROTOCOL_TCP);
   struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
                               .ai_flags = AI_ADDRCONFIG | AI_PASSIVE,
-                              .ai_protocol = IPPROTO_UDP,
-                              .ai_socktype = SOCK_DGRAM};
+                              .ai_protocol = stream ? IPPROTO_TCP : IPPROTO_UDP,
+                              .ai_socktype = stream ? SOCK_STREAM : SOCK_DGRAM};
 
   status = getaddrinfo(node, service, &ai_hints, &ai_list);
   if (status != 0) {
@@ -2082,32 +3288,67 @@ static int sockent_server_listen(sockent_t *se) /* {{{ */
 
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
-    int *tmp;
-
-    tmp = realloc(se->data.server.fd,
-                  sizeof(*tmp) * (se->data.server.fd_num + 1));
-    if (tmp == NULL) {
-      ERROR("network plugin: realloc failed.");
-      continue;
+    /* With multiple receive threads, open one socket per thread and let the
+     * kernel distribute the packets among them. Multicast groups are joined
+     * only once, because every socket in the group would receive a copy of
+     * each packet. */
+    int sockets_num = 1;
+    bool reuse_port = false;
+#ifdef SO_REUSEPORT
+    if ((network_config_receive_threads > 1) && !stream &&
+        !network_is_multicast(ai_ptr)) {
+      sockets_num = network_config_receive_threads;
+      reuse_port = true;
     }
-    se->data.server.fd = tmp;
-    tmp = se->data.server.fd + se->data.server.fd_num;
+#endif
 
-    *tmp = socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
-    if (*tmp < 0) {
-      ERROR("network plugin: socket(2) failed: %s", STRERRNO);
-      continue;
-    }
+    for (int i = 0; i < sockets_num; i++) {
+      int *tmp;
 
-    status = network_bind_socket(*tmp, ai_ptr, se->interface);
-    if (status != 0) {
-      close(*tmp);
-      *tmp = -1;
-      continue;
-    }
+      tmp = realloc(se->data.server.fd,
+                    sizeof(*tmp) * (se->data.server.fd_num + 1));
+      if (tmp == NULL) {
+        ERROR("network plugin: realloc failed.");
+        break;
+      }
+      se->data.server.fd = tmp;
+      tmp = se->data.server.fd + se->data.server.fd_num;
+
+      *tmp =
+          socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
+      if (*tmp < 0) {
+        ERROR("network plugin: socket(2) failed: %s", STRERRNO);
+        break;
+      }
+
+#ifdef SO_REUSEPORT
+      if (reuse_port && (setsockopt(*tmp, SOL_SOCKET, SO_REUSEPORT, &(int){1},
+                                    sizeof(int)) == -1)) {
+        ERROR("network plugin: setsockopt (reuseport): %s", STRERRNO);
+        close(*tmp);
+        *tmp = -1;
+        break;
+      }
+#endif
+
+      status = network_bind_socket(*tmp, ai_ptr, se->interface);
+      if (status != 0) {
+        close(*tmp);
+        *tmp = -1;
+        break;
+      }
+
+      if (stream && ((listen(*tmp, SOMAXCONN) != 0) ||
+                     (fcntl(*tmp, F_SETFL,
+                            fcntl(*tmp, F_GETFL) | O_NONBLOCK) != 0))) {
+        ERROR("network plugin: listen(2) failed: %s", STRERRNO);
+        close(*tmp);
+        *tmp = -1;
+        break;
+      }
 
-    se->data.server.fd_num++;
-    continue;
+      se->data.server.fd_num++;
+    }
   } /* for (ai_list) */
 
   freeaddrinfo(ai_list);
@@ -2125,7 +3366,14 @@ static int sockent_add(sockent_t *se) /* {{{ */
   if (se == NULL)
     return -1;
 
-  if (se->type == SOCKENT_TYPE_SERVER) {
+  if ((se->type == SOCKENT_TYPE_SERVER) &&
+      (se->protocol == SOCKENT_PROTOCOL_TCP)) {
+    if (listen_streams == NULL) {
+      listen_streams = se;
+      return 0;
+    }
+    last_ptr = listen_streams;
+  } else if (se->type == SOCKENT_TYPE_SERVER) {
     struct pollfd *tmp;
 
     tmp = realloc(listen_sockets_pollfd,
@@ -2167,6 +3415,333 @@ static int sockent_add(sockent_t *se) /* {{{ */
   return 0;
 } /* }}} int sockent_add */
 
+/* Returns an unused entry from the receive pool, or NULL if the pool is
+ * exhausted. */
+static receive_list_entry_t *receive_pool_get(void) /* {{{ */
+{
+  receive_list_entry_t *ent = NULL;
+  bool allocate = false;
+
+  pthread_mutex_lock(&receive_pool_lock);
+  if (receive_pool_free != NULL) {
+    ent = receive_pool_free;
+    receive_pool_free = ent->next;
+    receive_pool_free_num--;
+  } else if ((network_config_receive_queue_limit == 0) ||
+             (receive_pool_size < network_config_receive_queue_limit)) {
+    receive_pool_size++;
+    allocate = true;
+  }
+  pthread_mutex_unlock(&receive_pool_lock);
+
+  if (allocate) {
+    ent = malloc(sizeof(*ent) + network_config_packet_size);
+    if (ent == NULL) {
+      ERROR("network plugin: malloc failed.");
+      pthread_mutex_lock(&receive_pool_lock);
+      receive_pool_size--;
+      pthread_mutex_unlock(&receive_pool_lock);
+      return NULL;
+    }
+    ent->data = (char *)(ent + 1);
+  }
+
+  if (ent != NULL) {
+    ent->data_len = 0;
+    ent->fd = -1;
+    ent->addr_len = 0;
+    ent->next = NULL;
+  }
+  return ent;
+} /* }}} receive_list_entry_t *receive_pool_get */
+
+static void receive_pool_put(receive_list_entry_t *ent) /* {{{ */
+{
+  pthread_mutex_lock(&receive_pool_lock);
+  if ((network_config_receive_queue_limit != 0) ||
+      (receive_pool_free_num < RECEIVE_POOL_FREE_MAX)) {
+    ent->next = receive_pool_free;
+    receive_pool_free = ent;
+    receive_pool_free_num++;
+    ent = NULL;
+  } else {
+    receive_pool_size--;
+  }
+  pthread_mutex_unlock(&receive_pool_lock);
+
+  free(ent);
+} /* }}} void receive_pool_put */
+
+static void receive_pool_destroy(void) /* {{{ */
+{
+  pthread_mutex_lock(&receive_pool_lock);
+  while (receive_pool_free != NULL) {
+    receive_list_entry_t *ent = receive_pool_free;
+    receive_pool_free = ent->next;
+    free(ent);
+  }
+  receive_pool_free_num = 0;
+  receive_pool_size = 0;
+  pthread_mutex_unlock(&receive_pool_lock);
+} /* }}} void receive_pool_destroy */
+
+static void peer_table_init(void) /* {{{ */
+{
+  for (size_t i = 0; i < PEER_PARTITIONS; i++) {
+    memset(peer_partitions + i, 0, sizeof(peer_partitions[i]));
+    pthread_mutex_init(&peer_partitions[i].lock, /* attr = */ NULL);
+  }
+} /* }}} void peer_table_init */
+
+static void peer_table_destroy(void) /* {{{ */
+{
+  for (size_t i = 0; i < PEER_PARTITIONS; i++)
+    pthread_mutex_destroy(&peer_partitions[i].lock);
+} /* }}} void peer_table_destroy */
+
+/* Extracts the address of a peer, mapping IPv4-mapped IPv6 addresses to IPv4.
+ * Returns non-zero if the address family is not supported. */
+static int peer_key(const struct sockaddr_storage *ss, /* {{{ */
+                    socklen_t ss_len, sa_family_t *ret_family,
+                    uint8_t ret_addr[16]) {
+  memset(ret_addr, 0, 16);
+
+  if ((ss == NULL) || (ss_len == 0))
+    return -1;
+
+  if (ss->ss_family == AF_INET) {
+    const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
+    memcpy(ret_addr, &sin->sin_addr, sizeof(sin->sin_addr));
+    *ret_family = AF_INET;
+    return 0;
+  } else if (ss->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
+    if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+      memcpy(ret_addr, sin6->sin6_addr.s6_addr + 12, 4);
+      *ret_family = AF_INET;
+    } else {
+      memcpy(ret_addr, sin6->sin6_addr.s6_addr, 16);
+      *ret_family = AF_INET6;
+    }
+    return 0;
+  }
+
+  return -1;
+} /* }}} int peer_key */
+
+static uint32_t peer_hash(sa_family_t family, const uint8_t addr[16]) /* {{{ */
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+
+  hash = (hash ^ (uint8_t)family) * 16777619u;
+  for (size_t i = 0; i < 16; i++)
+    hash = (hash ^ addr[i]) * 16777619u;
+
+  return hash;
+} /* }}} uint32_t peer_hash */
+
+/* Closes the peer's rate window if it is older than `PEER_RATE_WINDOW'. The
+ * partition's lock must be held. */
+static void peer_rate_update(network_peer_t *p, cdtime_t now) /* {{{ */
+{
+  if ((now - p->window_start) < PEER_RATE_WINDOW)
+    return;
+
+  cdtime_t elapsed = now - p->window_start;
+  gauge_t current = p->window_values / CDTIME_T_TO_DOUBLE(elapsed);
+
+  if ((p->rate == 0) || (elapsed >= PEER_TIMEOUT))
+    p->rate = current;
+  else
+    p->rate = (p->rate + current) / 2.0;
+
+  p->window_start = now;
+  p->window_values = 0;
+} /* }}} void peer_rate_update */
+
+/* Recomputes the fair share, i.e. the average rate of all active peers, once
+ * per `PEER_RATE_WINDOW' and copies it to the partitions. */
+static void peer_share_update(cdtime_t now) /* {{{ */
+{
+  static derive_t shed_last;
+
+  if (pthread_mutex_trylock(&peer_share_lock) != 0)
+    return;
+
+  if ((now - peer_share_last) < PEER_RATE_WINDOW) {
+    pthread_mutex_unlock(&peer_share_lock);
+    return;
+  }
+  peer_share_last = now;
+
+  gauge_t total = 0;
+  size_t active = 0;
+  derive_t shed = 0;
+
+  for (size_t i = 0; i < PEER_PARTITIONS; i++) {
+    peer_partition_t *part = peer_partitions + i;
+
+    pthread_mutex_lock(&part->lock);
+    for (size_t j = 0; j < PEER_PARTITION_SIZE; j++) {
+      network_peer_t *p = part->peers + j;
+      if (!p->used || ((now - p->last_seen) >= PEER_TIMEOUT))
+        continue;
+
+      peer_rate_update(p, now);
+      total += p->rate;
+      active++;
+    }
+    shed += part->packets_shed;
+    pthread_mutex_unlock(&part->lock);
+  }
+
+  gauge_t fair_rate = (active > 0) ? (total / (gauge_t)active) : 0;
+  for (size_t i = 0; i < PEER_PARTITIONS; i++) {
+    pthread_mutex_lock(&peer_partitions[i].lock);
+    peer_partitions[i].fair_rate = fair_rate;
+    pthread_mutex_unlock(&peer_partitions[i].lock);
+  }
+
+  if (shed > shed_last)
+    NOTICE("network plugin: The write queue is above `PeerShedLimitLow'. "
+           "Shed %" PRIi64 " packets from peers sending more than their "
+           "share of %.0f values/s.",
+           shed - shed_last, fair_rate);
+  shed_last = shed;
+
+  pthread_mutex_unlock(&peer_share_lock);
+} /* }}} void peer_share_update */
+
+/* Returns the slot of a peer, taking over the slot of an expired or, if
+ * there is none, the least recently seen peer. The partition's lock must be
+ * held. */
+static network_peer_t *peer_lookup(peer_partition_t *part, /* {{{ */
+                                   uint32_t hash, sa_family_t family,
+                                   const uint8_t addr[16], cdtime_t now) {
+  size_t start = (hash / PEER_PARTITIONS) % PEER_PARTITION_SIZE;
+  network_peer_t *oldest = NULL;
+  network_peer_t *p = NULL;
+
+  for (size_t i = 0; i < PEER_PARTITION_SIZE; i++) {
+    p = part->peers + ((start + i) % PEER_PARTITION_SIZE);
+    if (!p->used)
+      break;
+    if ((p->family == family) && (memcmp(p->addr, addr, 16) == 0))
+      return p;
+    if ((oldest == NULL) || (p->last_seen < oldest->last_seen))
+      oldest = p;
+    p = NULL;
+  }
+
+  if (p == NULL)
+    p = oldest;
+
+  memset(p, 0, sizeof(*p));
+  p->used = true;
+  p->family = family;
+  memcpy(p->addr, addr, 16);
+  p->partition = (uint8_t)(part - peer_partitions);
+  p->window_start = now;
+  return p;
+} /* }}} network_peer_t *peer_lookup */
+
+/* Accounts a packet received from `ss' and decides whether to parse it. While
+ * the write queue is longer than `PeerShedLimitLow', packets of peers sending
+ * more than their fair share are shed: the closer the queue gets to
+ * `PeerShedLimitHigh', the closer to the fair share the limit gets. Returns
+ * true if the packet is admitted. `ret_peer' is set to the peer's slot, or
+ * NULL if the peer is not accounted. */
+static bool network_peer_admit(const struct sockaddr_storage *ss, /* {{{ */
+                               socklen_t ss_len, network_peer_t **ret_peer) {
+  sa_family_t family = AF_UNSPEC;
+  uint8_t addr[16];
+
+  *ret_peer = NULL;
+  if (!peer_accounting || (peer_key(ss, ss_len, &family, addr) != 0))
+    return true;
+
+  cdtime_t now = cdtime();
+  peer_share_update(now);
+
+  gauge_t pressure = 0;
+  if (network_config_shed_high > 0) {
+    long backlog = plugin_get_write_queue_length();
+    if (backlog >= network_config_shed_high)
+      pressure = 1.0;
+    else if (backlog >= network_config_shed_low)
+      pressure = (gauge_t)(backlog - network_config_shed_low) /
+                 (gauge_t)(network_config_shed_high - network_config_shed_low);
+  }
+
+  uint32_t hash = peer_hash(family, addr);
+  peer_partition_t *part = peer_partitions + (hash % PEER_PARTITIONS);
+  bool admit = true;
+
+  pthread_mutex_lock(&part->lock);
+  network_peer_t *p = peer_lookup(part, hash, family, addr, now);
+  p->last_seen = now;
+  p->packets_rx++;
+  peer_rate_update(p, now);
+
+  if ((pressure > 0) && (part->fair_rate > 0) &&
+      (p->rate >= part->fair_rate * (2.0 - pressure))) {
+    derive_t admitted = p->packets_rx - 1 - p->packets_shed;
+    admit = false;
+    p->packets_shed++;
+    part->packets_shed++;
+    p->window_values +=
+        (admitted > 0) ? ((double)p->values_rx / (double)admitted) : 1.0;
+  }
+  pthread_mutex_unlock(&part->lock);
+
+  *ret_peer = p;
+  return admit;
+} /* }}} bool network_peer_admit */
+
+static void network_peer_account(network_peer_t *p, /* {{{ */
+                                 derive_t values) {
+  if (p == NULL)
+    return;
+
+  peer_partition_t *part = peer_partitions + p->partition;
+
+  pthread_mutex_lock(&part->lock);
+  p->values_rx += values;
+  p->window_values += (double)values;
+  pthread_mutex_unlock(&part->lock);
+} /* }}} void network_peer_account */
+
+/* Returns the number of values dispatched by the calling thread so far. */
+static derive_t network_values_dispatched_self(void) /* {{{ */
+{
+  receive_thread_t *rt = receive_thread_self();
+  return (rt != NULL) ? rt->values_dispatched : values_dispatched_other;
+} /* }}} derive_t network_values_dispatched_self */
+
+static void network_relay(struct iovec *iov, size_t num);
+
+/* Parses a packet received from `ss' unless it is shed, see
+ * network_peer_admit(). Packets of relaying sockets are sent on instead. */
+static void network_receive_packet(sockent_t *se, char *data, /* {{{ */
+                                   size_t data_len,
+                                   const struct sockaddr_storage *ss,
+                                   socklen_t ss_len) {
+  network_peer_t *p = NULL;
+
+  if (!network_peer_admit(ss, ss_len, &p))
+    return;
+
+  if (se->data.server.relay) {
+    network_relay(&(struct iovec){.iov_base = data, .iov_len = data_len}, 1);
+    return;
+  }
+
+  derive_t before = network_values_dispatched_self();
+  parse_packet(se, data, data_len, /* flags = */ 0, /* username = */ NULL);
+  network_peer_account(p, network_values_dispatched_self() - before);
+} /* }}} void network_receive_packet */
+
 static void *dispatch_thread(void __attribute__((unused)) * arg) /* {{{ */
 {
   while (42) {
@@ -2209,15 +3784,13 @@ static void *dispatch_thread(void __attribute__((unused)) * arg) /* {{{ */
       ERROR("network plugin: Got packet from FD %i, but can't "
             "find an appropriate socket entry.",
             ent->fd);
-      sfree(ent->data);
-      sfree(ent);
+      receive_pool_put(ent);
       continue;
     }
 
-    parse_packet(se, ent->data, ent->data_len, /* flags = */ 0,
-                 /* username = */ NULL);
-    sfree(ent->data);
-    sfree(ent);
+    network_receive_packet(se, ent->data, (size_t)ent->data_len, &ent->addr,
+                           ent->addr_len);
+    receive_pool_put(ent);
   } /* while (42) */
 
   return NULL;
@@ -2256,40 +3829,38 @@ static int network_receive(void) /* {{{ */
         continue;
       status--;
 
-      buffer_len = recv(listen_sockets_pollfd[i].fd, buffer, sizeof(buffer),
-                        0 /* no flags */);
+      /* Entries are recycled by the dispatch thread. If all of them are in
+       * use, the packet is still read (into `buffer') so that it does not
+       * block the socket, but dropped. */
+      ent = receive_pool_get();
+
+      struct sockaddr_storage addr;
+      socklen_t addr_len = sizeof(addr);
+      buffer_len = recvfrom(listen_sockets_pollfd[i].fd,
+                            (ent != NULL) ? ent->data : buffer, sizeof(buffer),
+                            0 /* no flags */, (struct sockaddr *)&addr,
+                            &addr_len);
       if (buffer_len < 0) {
         status = (errno != 0) ? errno : -1;
         ERROR("network plugin: recv(2) failed: %s", STRERRNO);
+        if (ent != NULL)
+          receive_pool_put(ent);
         break;
       }
 
-      stats_octets_rx += ((uint64_t)buffer_len);
-      stats_packets_rx++;
+      shard_counter_add(&stats_octets_rx, (uint64_t)buffer_len);
+      shard_counter_add(&stats_packets_rx, 1);
 
-      /* TODO: Possible performance enhancement: Do not free
-       * these entries in the dispatch thread but put them in
-       * another list, so we don't have to allocate more and
-       * more of these structures. */
-      ent = calloc(1, sizeof(*ent));
       if (ent == NULL) {
-        ERROR("network plugin: calloc failed.");
-        status = ENOMEM;
-        break;
+        shard_counter_add(&stats_packets_dropped, 1);
+        status = 0;
+        continue;
       }
 
-      ent->data = malloc(network_config_packet_size);
-      if (ent->data == NULL) {
-        sfree(ent);
-        ERROR("network plugin: malloc failed.");
-        status = ENOMEM;
-        break;
-      }
       ent->fd = listen_sockets_pollfd[i].fd;
-      ent->next = NULL;
-
-      memcpy(ent->data, buffer, buffer_len);
       ent->data_len = buffer_len;
+      ent->addr = addr;
+      ent->addr_len = addr_len;
 
       if (private_list_head == NULL)
         private_list_head = ent;
@@ -2348,150 +3919,658 @@ static void *receive_thread(void __attribute__((unused)) * arg) {
   return network_receive() ? (void *)1 : (void *)0;
 } /* void *receive_thread */
 
-static void network_init_buffer(void) {
-  memset(send_buffer, 0, network_config_packet_size);
-  send_buffer_ptr = send_buffer;
-  send_buffer_fill = 0;
-  send_buffer_last_update = 0;
+/* Reads up to `RECEIVE_BATCH_SIZE' packets from `fd' into the buffers of `rt'
+ * without blocking. Returns the number of packets read, storing their sizes in
+ * `lengths' and their source addresses in `addrs', or -1 on error. */
+static int receive_thread_recv(receive_thread_t *rt, int fd, /* {{{ */
+                               size_t *lengths, struct sockaddr_storage *addrs,
+                               socklen_t *addr_lens) {
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[RECEIVE_BATCH_SIZE];
+  struct iovec iov[RECEIVE_BATCH_SIZE];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < RECEIVE_BATCH_SIZE; i++) {
+    iov[i].iov_base = rt->buffer + i * network_config_packet_size;
+    iov[i].iov_len = network_config_packet_size;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = addrs + i;
+    msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+  }
 
-  memset(&send_buffer_vl, 0, sizeof(send_buffer_vl));
-} /* int network_init_buffer */
+  int status = recvmmsg(fd, msgs, RECEIVE_BATCH_SIZE, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return 0;
+    ERROR("network plugin: recvmmsg(2) failed: %s", STRERRNO);
+    return -1;
+  }
 
-static void network_send_buffer_plain(sockent_t *se, /* {{{ */
-                                      const char *buffer, size_t buffer_size) {
-  int status;
+  for (int i = 0; i < status; i++) {
+    lengths[i] = (size_t)msgs[i].msg_len;
+    addr_lens[i] = msgs[i].msg_hdr.msg_namelen;
+  }
+  return status;
+#else
+  int num = 0;
+
+  while (num < RECEIVE_BATCH_SIZE) {
+    addr_lens[num] = sizeof(addrs[num]);
+    ssize_t len = recvfrom(fd, rt->buffer + num * network_config_packet_size,
+                           network_config_packet_size, MSG_DONTWAIT,
+                           (struct sockaddr *)(addrs + num), addr_lens + num);
+    if (len < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        break;
+      ERROR("network plugin: recv(2) failed: %s", STRERRNO);
+      return (num > 0) ? num : -1;
+    }
+    lengths[num] = (size_t)len;
+    num++;
+  }
 
-  while (42) {
-    status = sockent_client_connect(se);
-    if (status != 0)
-      return;
+  return num;
+#endif
+} /* }}} int receive_thread_recv */
 
-    status = sendto(se->data.client.fd, buffer, buffer_size,
-                    /* flags = */ 0, (struct sockaddr *)se->data.client.addr,
-                    se->data.client.addrlen);
-    if (status < 0) {
-      if ((errno == EINTR) || (errno == EAGAIN))
-        continue;
+static void *receive_thread_main(void *arg) /* {{{ */
+{
+  receive_thread_t *rt = arg;
+  size_t lengths[RECEIVE_BATCH_SIZE];
+  struct sockaddr_storage addrs[RECEIVE_BATCH_SIZE];
+  socklen_t addr_lens[RECEIVE_BATCH_SIZE];
 
-      ERROR("network plugin: sendto failed: %s. Closing sending socket.",
-            STRERRNO);
-      sockent_client_disconnect(se);
-      return;
+  pthread_setspecific(receive_thread_key, rt);
+
+  while (listen_loop == 0) {
+    int status = poll(rt->pollfd, rt->fds_num, -1);
+    if (status <= 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("network plugin: poll(2) failed: %s", STRERRNO);
+      return (void *)1;
     }
 
-    break;
-  } /* while (42) */
-} /* }}} void network_send_buffer_plain */
+    for (size_t i = 0; (i < rt->fds_num) && (status > 0); i++) {
+      if ((rt->pollfd[i].revents & (POLLIN | POLLPRI)) == 0)
+        continue;
+      status--;
 
-#if HAVE_GCRYPT_H
-#define BUFFER_ADD(p, s)                                                       \
-  do {                                                                         \
-    memcpy(buffer + buffer_offset, (p), (s));                                  \
-    buffer_offset += (s);                                                      \
-  } while (0)
+      int num =
+          receive_thread_recv(rt, rt->pollfd[i].fd, lengths, addrs, addr_lens);
+      if (num < 0)
+        return (void *)1;
 
-static void network_send_buffer_signed(sockent_t *se, /* {{{ */
-                                       const char *in_buffer,
-                                       size_t in_buffer_size) {
-  char buffer[BUFF_SIG_SIZE + in_buffer_size];
-  size_t buffer_offset;
-  size_t username_len;
+      /* Packets to relay are sent on in one batch. */
+      struct iovec relay[RECEIVE_BATCH_SIZE];
+      size_t relay_num = 0;
 
-  gcry_md_hd_t hd;
-  gcry_error_t err;
-  unsigned char *hash;
+      for (int j = 0; j < num; j++) {
+        char *data = rt->buffer + ((size_t)j) * network_config_packet_size;
 
-  hd = NULL;
-  err = gcry_md_open(&hd, GCRY_MD_SHA256, GCRY_MD_FLAG_HMAC);
-  if (err != 0) {
-    ERROR("network plugin: Creating HMAC object failed: %s",
-          gcry_strerror(err));
-    return;
-  }
+        shard_counter_add(&stats_octets_rx, (uint64_t)lengths[j]);
+        shard_counter_add(&stats_packets_rx, 1);
 
-  err = gcry_md_setkey(hd, se->data.client.password,
-                       strlen(se->data.client.password));
-  if (err != 0) {
-    ERROR("network plugin: gcry_md_setkey failed: %s", gcry_strerror(err));
-    gcry_md_close(hd);
-    return;
-  }
+        if (!rt->sockent[i]->data.server.relay) {
+          network_receive_packet(rt->sockent[i], data, lengths[j], addrs + j,
+                                 addr_lens[j]);
+          continue;
+        }
 
-  username_len = strlen(se->data.client.username);
-  if (username_len > (BUFF_SIG_SIZE - PART_SIGNATURE_SHA256_SIZE)) {
-    ERROR("network plugin: Username too long: %s", se->data.client.username);
-    return;
-  }
+        network_peer_t *p = NULL;
+        if (network_peer_admit(addrs + j, addr_lens[j], &p))
+          relay[relay_num++] =
+              (struct iovec){.iov_base = data, .iov_len = lengths[j]};
+      }
 
-  memcpy(buffer + PART_SIGNATURE_SHA256_SIZE, se->data.client.username,
-         username_len);
-  memcpy(buffer + PART_SIGNATURE_SHA256_SIZE + username_len, in_buffer,
-         in_buffer_size);
+      if (relay_num > 0)
+        network_relay(relay, relay_num);
+    }
+  } /* while (listen_loop == 0) */
 
-  /* Initialize the `ps' structure. */
-  part_signature_sha256_t ps = {
-      .head.type = htons(TYPE_SIGN_SHA256),
-      .head.length = htons(PART_SIGNATURE_SHA256_SIZE + username_len)};
+  return (void *)0;
+} /* }}} void *receive_thread_main */
 
-  /* Calculate the hash value. */
-  gcry_md_write(hd, buffer + PART_SIGNATURE_SHA256_SIZE,
-                username_len + in_buffer_size);
-  hash = gcry_md_read(hd, GCRY_MD_SHA256);
-  if (hash == NULL) {
-    ERROR("network plugin: gcry_md_read failed.");
-    gcry_md_close(hd);
-    return;
+static int receive_thread_key_init(void) /* {{{ */
+{
+  if (receive_thread_key_valid)
+    return 0;
+
+  int status = pthread_key_create(&receive_thread_key, /* destructor = */ NULL);
+  if (status != 0) {
+    ERROR("network plugin: pthread_key_create failed: %s", STRERROR(status));
+    return status;
   }
-  memcpy(ps.hash, hash, sizeof(ps.hash));
+  receive_thread_key_valid = true;
 
-  /* Add the header */
-  buffer_offset = 0;
+  return 0;
+} /* }}} int receive_thread_key_init */
 
-  BUFFER_ADD(&ps.head.type, sizeof(ps.head.type));
-  BUFFER_ADD(&ps.head.length, sizeof(ps.head.length));
-  BUFFER_ADD(ps.hash, sizeof(ps.hash));
+/* Binds a thread receiving or parsing packets to `ReceiveThreadsAffinity'. */
+static void network_bind_receive_thread(pthread_t thread) /* {{{ */
+{
+  if (network_config_receive_affinity == NULL)
+    return;
 
-  assert(buffer_offset == PART_SIGNATURE_SHA256_SIZE);
+  int status =
+      plugin_thread_set_affinity(thread, network_config_receive_affinity);
+  if (status != 0)
+    WARNING("network plugin: Binding a receive thread to the CPUs \"%s\" "
+            "failed: %s",
+            network_config_receive_affinity, STRERROR(status));
+} /* }}} void network_bind_receive_thread */
+
+/* Distributes the listening sockets among `network_config_receive_threads'
+ * threads and starts them. The sockets opened for one address with
+ * SO_REUSEPORT are adjacent in `fd', so assigning sockets round-robin gives
+ * each thread one socket of every such group. */
+static int receive_threads_start(void) /* {{{ */
+{
+  size_t threads_num = (size_t)network_config_receive_threads;
+  size_t next = 0;
+  int status;
 
-  gcry_md_close(hd);
-  hd = NULL;
+  receive_threads = calloc(threads_num, sizeof(*receive_threads));
+  if (receive_threads == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return ENOMEM;
+  }
+  receive_threads_num = threads_num;
 
-  buffer_offset = PART_SIGNATURE_SHA256_SIZE + username_len + in_buffer_size;
-  network_send_buffer_plain(se, buffer, buffer_offset);
-} /* }}} void network_send_buffer_signed */
+  status = receive_thread_key_init();
+  if (status != 0) {
+    sfree(receive_threads);
+    receive_threads_num = 0;
+    return status;
+  }
 
-static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
-                                          const char *in_buffer,
-                                          size_t in_buffer_size) {
-  char buffer[BUFF_SIG_SIZE + in_buffer_size];
-  size_t buffer_size;
-  size_t buffer_offset;
-  size_t header_size;
-  size_t username_len;
-  gcry_error_t err;
-  gcry_cipher_hd_t cypher;
+  for (size_t i = 0; i < threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
 
-  /* Initialize the header fields */
-  part_encryption_aes256_t pea = {.head.type = htons(TYPE_ENCR_AES256),
-                                  .username = se->data.client.username};
+    rt->pollfd = calloc(listen_sockets_num, sizeof(*rt->pollfd));
+    rt->sockent = calloc(listen_sockets_num, sizeof(*rt->sockent));
+    rt->buffer = malloc(RECEIVE_BATCH_SIZE * network_config_packet_size);
+    if ((rt->pollfd == NULL) || (rt->sockent == NULL) || (rt->buffer == NULL)) {
+      ERROR("network plugin: malloc failed.");
+      return ENOMEM;
+    }
+  }
 
-  username_len = strlen(pea.username);
-  if ((PART_ENCRYPTION_AES256_SIZE + username_len) > BUFF_SIG_SIZE) {
-    ERROR("network plugin: Username too long: %s", pea.username);
-    return;
+  for (sockent_t *se = listen_sockets; se != NULL; se = se->next) {
+    for (size_t i = 0; i < se->data.server.fd_num; i++) {
+      receive_thread_t *rt = receive_threads + (next % threads_num);
+      next++;
+
+      rt->pollfd[rt->fds_num] = (struct pollfd){
+          .fd = se->data.server.fd[i],
+          .events = POLLIN | POLLPRI,
+      };
+      rt->sockent[rt->fds_num] = se;
+      rt->fds_num++;
+    }
   }
 
-  buffer_size = PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size;
-  header_size = PART_ENCRYPTION_AES256_SIZE + username_len - sizeof(pea.hash);
+  for (size_t i = 0; i < threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
 
-  assert(buffer_size <= sizeof(buffer));
-  DEBUG("network plugin: network_send_buffer_encrypted: "
-        "buffer_size = %" PRIsz ";",
-        buffer_size);
+    /* More threads than sockets. */
+    if (rt->fds_num == 0)
+      continue;
 
-  pea.head.length = htons(
-      (uint16_t)(PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size));
-  pea.username_length = htons((uint16_t)username_len);
+    status = plugin_thread_create(&rt->id, /* attr = */ NULL,
+                                  receive_thread_main, rt, "network recv");
+    if (status != 0) {
+      ERROR("network: pthread_create failed: %s", STRERRNO);
+      continue;
+    }
+    rt->running = true;
+    network_bind_receive_thread(rt->id);
+  }
+
+  return 0;
+} /* }}} int receive_threads_start */
+
+static void receive_threads_stop(void) /* {{{ */
+{
+  if (receive_threads == NULL)
+    return;
+
+  INFO("network plugin: Stopping receive threads.");
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
+
+    if (rt->running) {
+      pthread_kill(rt->id, SIGTERM);
+      pthread_join(rt->id, /* retval = */ NULL);
+      rt->running = false;
+    }
+  }
+
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    sfree(receive_threads[i].pollfd);
+    sfree(receive_threads[i].sockent);
+    sfree(receive_threads[i].buffer);
+  }
+  sfree(receive_threads);
+  receive_threads_num = 0;
+} /* }}} void receive_threads_stop */
+
+#if HAVE_SYS_EPOLL_H
+/* Listening sockets are only removed from the loop; they are closed by
+ * sockent_destroy(). */
+static void stream_conn_close(stream_conn_t *c) /* {{{ */
+{
+  epoll_ctl(stream_epoll_fd, EPOLL_CTL_DEL, c->fd, /* event = */ NULL);
+  if (c->buffer != NULL)
+    close(c->fd);
+
+  if (c->prev != NULL)
+    c->prev->next = c->next;
+  else
+    stream_conns = c->next;
+  if (c->next != NULL)
+    c->next->prev = c->prev;
+  stream_conns_num--;
+
+  sfree(c->buffer);
+  sfree(c);
+} /* }}} void stream_conn_close */
+
+static stream_conn_t *stream_conn_add(sockent_t *se, int fd, /* {{{ */
+                                      bool listening) {
+  stream_conn_t *c = calloc(1, sizeof(*c));
+  if (c == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return NULL;
+  }
+  c->fd = fd;
+  c->se = se;
+
+  if (!listening) {
+    c->buffer = malloc(STREAM_FRAME_HEADER_SIZE + STREAM_FRAME_MAX);
+    if (c->buffer == NULL) {
+      ERROR("network plugin: malloc failed.");
+      sfree(c);
+      return NULL;
+    }
+  }
+
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+  if (epoll_ctl(stream_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    ERROR("network plugin: epoll_ctl failed: %s", STRERRNO);
+    sfree(c->buffer);
+    sfree(c);
+    return NULL;
+  }
+
+  c->next = stream_conns;
+  if (stream_conns != NULL)
+    stream_conns->prev = c;
+  stream_conns = c;
+  stream_conns_num++;
+
+  return c;
+} /* }}} stream_conn_t *stream_conn_add */
+
+static void stream_accept(stream_conn_t *l) /* {{{ */
+{
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  int fd = accept(l->fd, (struct sockaddr *)&addr, &addr_len);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      ERROR("network plugin: accept(2) failed: %s", STRERRNO);
+    return;
+  }
+
+  if (stream_conns_num >= STREAM_CONNECTIONS_MAX) {
+    WARNING("network plugin: Too many TCP connections, closing a new one.");
+    close(fd);
+    return;
+  }
+
+  stream_conn_t *c = stream_conn_add(l->se, fd, /* listening = */ false);
+  if (c == NULL) {
+    close(fd);
+    return;
+  }
+  c->addr = addr;
+  c->addr_len = addr_len;
+} /* }}} void stream_accept */
+
+/* Reads from a connection and parses all complete packets. Returns non-zero
+ * if the connection is to be closed. */
+static int stream_read(stream_conn_t *c) /* {{{ */
+{
+  size_t size = STREAM_FRAME_HEADER_SIZE + STREAM_FRAME_MAX;
+  ssize_t len = recv(c->fd, c->buffer + c->fill, size - c->fill, MSG_DONTWAIT);
+  if (len < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+      return 0;
+    NOTICE("network plugin: recv(2) failed: %s. Closing TCP connection.",
+           STRERRNO);
+    return -1;
+  } else if (len == 0) {
+    return -1;
+  }
+  c->fill += (size_t)len;
+
+  size_t offset = 0;
+  while ((c->fill - offset) >= STREAM_FRAME_HEADER_SIZE) {
+    uint32_t frame_len;
+
+    memcpy(&frame_len, c->buffer + offset, sizeof(frame_len));
+    frame_len = ntohl(frame_len);
+    if ((frame_len == 0) || (frame_len > STREAM_FRAME_MAX)) {
+      NOTICE("network plugin: Invalid frame length %" PRIu32
+             ". Closing TCP connection.",
+             frame_len);
+      return -1;
+    }
+
+    if ((c->fill - offset - STREAM_FRAME_HEADER_SIZE) < frame_len)
+      break;
+
+    shard_counter_add(&stats_octets_rx, (uint64_t)frame_len);
+    shard_counter_add(&stats_packets_rx, 1);
+
+    network_receive_packet(c->se, c->buffer + offset + STREAM_FRAME_HEADER_SIZE,
+                           frame_len, &c->addr, c->addr_len);
+    offset += STREAM_FRAME_HEADER_SIZE + frame_len;
+  }
+
+  if (offset > 0) {
+    memmove(c->buffer, c->buffer + offset, c->fill - offset);
+    c->fill -= offset;
+  }
+
+  return 0;
+} /* }}} int stream_read */
+
+static void *stream_thread_main(void __attribute__((unused)) * arg) /* {{{ */
+{
+  struct epoll_event events[STREAM_EVENTS_MAX];
+
+  pthread_setspecific(receive_thread_key, &stream_thread);
+
+  while (listen_loop == 0) {
+    int num = epoll_wait(stream_epoll_fd, events, STREAM_EVENTS_MAX, -1);
+    if (num < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("network plugin: epoll_wait(2) failed: %s", STRERRNO);
+      return (void *)1;
+    }
+
+    for (int i = 0; i < num; i++) {
+      stream_conn_t *c = events[i].data.ptr;
+
+      if (c->buffer == NULL)
+        stream_accept(c);
+      else if (stream_read(c) != 0)
+        stream_conn_close(c);
+    }
+  } /* while (listen_loop == 0) */
+
+  return (void *)0;
+} /* }}} void *stream_thread_main */
+
+static int stream_thread_start(void) /* {{{ */
+{
+  int status = receive_thread_key_init();
+  if (status != 0)
+    return status;
+
+  stream_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (stream_epoll_fd < 0) {
+    ERROR("network plugin: epoll_create1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  for (sockent_t *se = listen_streams; se != NULL; se = se->next)
+    for (size_t i = 0; i < se->data.server.fd_num; i++)
+      stream_conn_add(se, se->data.server.fd[i], /* listening = */ true);
+
+  status = plugin_thread_create(&stream_thread.id, /* attr = */ NULL,
+                                stream_thread_main, /* arg = */ NULL,
+                                "network tcp");
+  if (status != 0) {
+    ERROR("network: pthread_create failed: %s", STRERRNO);
+    return status;
+  }
+  stream_thread.running = true;
+
+  return 0;
+} /* }}} int stream_thread_start */
+
+static void stream_thread_stop(void) /* {{{ */
+{
+  if (stream_thread.running) {
+    INFO("network plugin: Stopping TCP receive thread.");
+    pthread_kill(stream_thread.id, SIGTERM);
+    pthread_join(stream_thread.id, /* retval = */ NULL);
+    stream_thread.running = false;
+  }
+
+  while (stream_conns != NULL)
+    stream_conn_close(stream_conns);
+
+  if (stream_epoll_fd >= 0) {
+    close(stream_epoll_fd);
+    stream_epoll_fd = -1;
+  }
+} /* }}} void stream_thread_stop */
+#endif /* HAVE_SYS_EPOLL_H */
+
+static void network_init_buffer(send_buffer_t *sb) {
+  memset(sb->buffer, 0, network_config_packet_size);
+  sb->ptr = sb->buffer;
+  sb->fill = 0;
+  sb->last_update = 0;
+
+  memset(&sb->vl, 0, sizeof(sb->vl));
+  sb->session = false;
+  sb->ident = 0;
+
+#if HAVE_LIBZ
+  if (sb->compress_stream_initialized) {
+    deflateReset(&sb->compress_stream);
+    deflateSetDictionary(&sb->compress_stream,
+                         (const Bytef *)compress_dictionary,
+                         sizeof(compress_dictionary));
+    sb->compress_raw_len = 0;
+  }
+#endif
+} /* int network_init_buffer */
+
+/* Writes all of `iov' to the TCP connection of `se'. A connection that fails
+ * or times out part way through a packet cannot be resumed and is closed. */
+static int network_send_stream(sockent_t *se, struct iovec *iov, /* {{{ */
+                               size_t iov_num, int flags) {
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+
+  while (iov_num > 0) {
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iov_num};
+
+    ssize_t status = sendmsg(se->data.client.fd, &msg, flags);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+
+      ERROR("network plugin: sendmsg failed: %s. Closing TCP connection.",
+            STRERRNO);
+      sockent_client_disconnect(se);
+      return -1;
+    }
+
+    size_t sent = (size_t)status;
+    while ((iov_num > 0) && (sent >= iov->iov_len)) {
+      sent -= iov->iov_len;
+      iov++;
+      iov_num--;
+    }
+    if (iov_num > 0) {
+      iov->iov_base = ((char *)iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+
+  return 0;
+} /* }}} int network_send_stream */
+
+static void network_send_buffer_plain(sockent_t *se, /* {{{ */
+                                      const char *buffer, size_t buffer_size) {
+  int status;
+
+  while (42) {
+    status = sockent_client_connect(se);
+    if (status != 0)
+      return;
+
+    if (se->protocol == SOCKENT_PROTOCOL_TCP) {
+      uint32_t frame_len = htonl((uint32_t)buffer_size);
+      struct iovec iov[2] = {
+          {.iov_base = &frame_len, .iov_len = sizeof(frame_len)},
+          {.iov_base = (void *)buffer, .iov_len = buffer_size},
+      };
+      network_send_stream(se, iov, STATIC_ARRAY_SIZE(iov), /* flags = */ 0);
+      return;
+    }
+
+    status = sendto(se->data.client.fd, buffer, buffer_size,
+                    /* flags = */ 0, (struct sockaddr *)se->data.client.addr,
+                    se->data.client.addrlen);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      ERROR("network plugin: sendto failed: %s. Closing sending socket.",
+            STRERRNO);
+      sockent_client_disconnect(se);
+      return;
+    }
+
+    break;
+  } /* while (42) */
+} /* }}} void network_send_buffer_plain */
+
+#if HAVE_GCRYPT_H
+#define BUFFER_ADD(p, s)                                                       \
+  do {                                                                         \
+    memcpy(buffer + buffer_offset, (p), (s));                                  \
+    buffer_offset += (s);                                                      \
+  } while (0)
+
+/* Writes the signed packet to `buffer', which must hold at least
+ * `BUFF_SIG_SIZE + in_buffer_size' bytes. Returns the size of the packet or
+ * -1 on error. */
+static int network_sign_buffer(sockent_t *se, /* {{{ */
+                               const char *in_buffer, size_t in_buffer_size,
+                               char *buffer) {
+  size_t buffer_offset;
+  size_t username_len;
+
+  gcry_md_hd_t hd;
+  gcry_error_t err;
+  unsigned char *hash;
+
+  hd = NULL;
+  err = gcry_md_open(&hd, GCRY_MD_SHA256, GCRY_MD_FLAG_HMAC);
+  if (err != 0) {
+    ERROR("network plugin: Creating HMAC object failed: %s",
+          gcry_strerror(err));
+    return -1;
+  }
+
+  err = gcry_md_setkey(hd, se->data.client.password,
+                       strlen(se->data.client.password));
+  if (err != 0) {
+    ERROR("network plugin: gcry_md_setkey failed: %s", gcry_strerror(err));
+    gcry_md_close(hd);
+    return -1;
+  }
+
+  username_len = strlen(se->data.client.username);
+  if (username_len > (BUFF_SIG_SIZE - PART_SIGNATURE_SHA256_SIZE)) {
+    ERROR("network plugin: Username too long: %s", se->data.client.username);
+    gcry_md_close(hd);
+    return -1;
+  }
+
+  memcpy(buffer + PART_SIGNATURE_SHA256_SIZE, se->data.client.username,
+         username_len);
+  memcpy(buffer + PART_SIGNATURE_SHA256_SIZE + username_len, in_buffer,
+         in_buffer_size);
+
+  /* Initialize the `ps' structure. */
+  part_signature_sha256_t ps = {
+      .head.type = htons(TYPE_SIGN_SHA256),
+      .head.length = htons(PART_SIGNATURE_SHA256_SIZE + username_len)};
+
+  /* Calculate the hash value. */
+  gcry_md_write(hd, buffer + PART_SIGNATURE_SHA256_SIZE,
+                username_len + in_buffer_size);
+  hash = gcry_md_read(hd, GCRY_MD_SHA256);
+  if (hash == NULL) {
+    ERROR("network plugin: gcry_md_read failed.");
+    gcry_md_close(hd);
+    return -1;
+  }
+  memcpy(ps.hash, hash, sizeof(ps.hash));
+
+  /* Add the header */
+  buffer_offset = 0;
+
+  BUFFER_ADD(&ps.head.type, sizeof(ps.head.type));
+  BUFFER_ADD(&ps.head.length, sizeof(ps.head.length));
+  BUFFER_ADD(ps.hash, sizeof(ps.hash));
+
+  assert(buffer_offset == PART_SIGNATURE_SHA256_SIZE);
+
+  gcry_md_close(hd);
+  hd = NULL;
+
+  return (int)(PART_SIGNATURE_SHA256_SIZE + username_len + in_buffer_size);
+} /* }}} int network_sign_buffer */
+
+/* Writes the encrypted packet to `buffer', which must hold at least
+ * `BUFF_SIG_SIZE + in_buffer_size' bytes. Returns the size of the packet or
+ * -1 on error. */
+static int network_encrypt_buffer(sockent_t *se, /* {{{ */
+                                  const char *in_buffer, size_t in_buffer_size,
+                                  char *buffer) {
+  size_t buffer_size;
+  size_t buffer_offset;
+  size_t header_size;
+  size_t username_len;
+  gcry_error_t err;
+  gcry_cipher_hd_t cypher;
+
+  /* Initialize the header fields */
+  part_encryption_aes256_t pea = {.head.type = htons(TYPE_ENCR_AES256),
+                                  .username = se->data.client.username};
+
+  username_len = strlen(pea.username);
+  if ((PART_ENCRYPTION_AES256_SIZE + username_len) > BUFF_SIG_SIZE) {
+    ERROR("network plugin: Username too long: %s", pea.username);
+    return -1;
+  }
+
+  buffer_size = PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size;
+  header_size = PART_ENCRYPTION_AES256_SIZE + username_len - sizeof(pea.hash);
+
+  assert(buffer_size <= BUFF_SIG_SIZE + in_buffer_size);
+  DEBUG("network plugin: network_send_buffer_encrypted: "
+        "buffer_size = %" PRIsz ";",
+        buffer_size);
+
+  pea.head.length = htons(
+      (uint16_t)(PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size));
+  pea.username_length = htons((uint16_t)username_len);
 
   /* Chose a random initialization vector. */
   gcry_randomize((void *)&pea.iv, sizeof(pea.iv), GCRY_STRONG_RANDOM);
@@ -2501,7 +4580,7 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
 
   /* Initialize the buffer */
   buffer_offset = 0;
-  memset(buffer, 0, sizeof(buffer));
+  memset(buffer, 0, buffer_size);
 
   BUFFER_ADD(&pea.head.type, sizeof(pea.head.type));
   BUFFER_ADD(&pea.head.length, sizeof(pea.head.length));
@@ -2514,10 +4593,9 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
 
   assert(buffer_offset == buffer_size);
 
-  cypher = network_get_aes256_cypher(se, pea.iv, sizeof(pea.iv),
-                                     se->data.client.password);
+  cypher = network_get_aes256_cypher(se, pea.iv, sizeof(pea.iv));
   if (cypher == NULL)
-    return;
+    return -1;
 
   /* Encrypt the buffer in-place */
   err = gcry_cipher_encrypt(cypher, buffer + header_size,
@@ -2526,106 +4604,939 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
   if (err != 0) {
     ERROR("network plugin: gcry_cipher_encrypt returned: %s",
           gcry_strerror(err));
-    return;
+    return -1;
   }
 
-  /* Send it out without further modifications */
-  network_send_buffer_plain(se, buffer, buffer_size);
-} /* }}} void network_send_buffer_encrypted */
-#undef BUFFER_ADD
-#endif /* HAVE_GCRYPT_H */
+  return (int)buffer_size;
+} /* }}} int network_encrypt_buffer */
+
+#if NETWORK_HAVE_GCM
+/* Like network_encrypt_buffer, but creates an AES-256-GCM part, which is
+ * encrypted and authenticated in a single pass. */
+static int network_encrypt_buffer_gcm(sockent_t *se, /* {{{ */
+                                      const char *in_buffer,
+                                      size_t in_buffer_size, char *buffer) {
+  size_t buffer_size;
+  size_t buffer_offset;
+  size_t header_size;
+  size_t tag_offset;
+  size_t username_len;
+  uint16_t tmp16;
+  unsigned char iv[PART_ENCRYPTION_AES256_GCM_IV_SIZE];
+  gcry_cipher_hd_t cypher;
+  gcry_error_t err;
+
+  username_len = strlen(se->data.client.username);
+  if ((PART_ENCRYPTION_AES256_GCM_SIZE + username_len) > BUFF_SIG_SIZE) {
+    ERROR("network plugin: Username too long: %s", se->data.client.username);
+    return -1;
+  }
+
+  buffer_size =
+      PART_ENCRYPTION_AES256_GCM_SIZE + username_len + in_buffer_size;
+  buffer_offset = 0;
+
+  tmp16 = htons(TYPE_ENCR_AES256_GCM);
+  BUFFER_ADD(&tmp16, sizeof(tmp16));
+  tmp16 = htons((uint16_t)buffer_size);
+  BUFFER_ADD(&tmp16, sizeof(tmp16));
+  tmp16 = htons((uint16_t)username_len);
+  BUFFER_ADD(&tmp16, sizeof(tmp16));
+  BUFFER_ADD(se->data.client.username, username_len);
+  header_size = buffer_offset;
+
+  /* GCM needs unique, but not unpredictable, initialization vectors. */
+  gcry_create_nonce(iv, sizeof(iv));
+  BUFFER_ADD(iv, sizeof(iv));
+  tag_offset = buffer_offset;
+  buffer_offset += PART_ENCRYPTION_AES256_GCM_TAG_SIZE;
+  BUFFER_ADD(in_buffer, in_buffer_size);
+
+  assert(buffer_offset == buffer_size);
+
+  cypher = network_get_aes256_cypher(se, iv, sizeof(iv));
+  if (cypher == NULL)
+    return -1;
+
+  err = gcry_cipher_authenticate(cypher, buffer, header_size);
+  if (err == 0)
+    err = gcry_cipher_encrypt(cypher, buffer + buffer_size - in_buffer_size,
+                              in_buffer_size,
+                              /* in = */ NULL, /* in len = */ 0);
+  if (err == 0)
+    err = gcry_cipher_gettag(cypher, buffer + tag_offset,
+                             PART_ENCRYPTION_AES256_GCM_TAG_SIZE);
+  if (err != 0) {
+    ERROR("network plugin: AES-256-GCM encryption failed: %s",
+          gcry_strerror(err));
+    return -1;
+  }
+
+  return (int)buffer_size;
+} /* }}} int network_encrypt_buffer_gcm */
+#endif /* NETWORK_HAVE_GCM */
+#undef BUFFER_ADD
+#endif /* HAVE_GCRYPT_H */
+
+/* Applies the security level of `se' to a packet. If the packet is sent as
+ * is, returns `in_buffer'; otherwise the signed or encrypted packet is written
+ * to `buffer', which must hold at least `BUFF_SIG_SIZE + in_buffer_size'
+ * bytes, and `buffer' is returned. Returns NULL on error. */
+static const char *network_seal_buffer(sockent_t *se, /* {{{ */
+                                       const char *in_buffer,
+                                       size_t in_buffer_size, char *buffer,
+                                       size_t *ret_size) {
+#if HAVE_GCRYPT_H
+  int size;
+
+#if NETWORK_HAVE_GCM
+  if ((se->data.client.security_level == SECURITY_LEVEL_ENCRYPT) &&
+      (se->data.client.cipher_mode == CIPHER_MODE_GCM))
+    size = network_encrypt_buffer_gcm(se, in_buffer, in_buffer_size, buffer);
+  else
+#endif
+      if (se->data.client.security_level == SECURITY_LEVEL_ENCRYPT)
+    size = network_encrypt_buffer(se, in_buffer, in_buffer_size, buffer);
+  else if (se->data.client.security_level == SECURITY_LEVEL_SIGN)
+    size = network_sign_buffer(se, in_buffer, in_buffer_size, buffer);
+  else /* if (se->data.client.security_level == SECURITY_LEVEL_NONE) */
+#endif /* HAVE_GCRYPT_H */
+  {
+    *ret_size = in_buffer_size;
+    return in_buffer;
+  }
+
+#if HAVE_GCRYPT_H
+  if (size < 0)
+    return NULL;
+  *ret_size = (size_t)size;
+  return buffer;
+#endif
+} /* }}} const char *network_seal_buffer */
+
+/* Copies a packet to the queue of a server. Called with `send_buffer_lock'
+ * held. */
+static void send_queue_push(send_queue_t *q, const char *buffer, /* {{{ */
+                            size_t buffer_len) {
+  send_packet_t *p = NULL;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->length >= SEND_QUEUE_MAX) {
+    pthread_mutex_unlock(&q->lock);
+    shard_counter_add(&stats_packets_send_dropped, 1);
+    return;
+  }
+  if (q->free != NULL) {
+    p = q->free;
+    q->free = p->next;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  if (p == NULL) {
+    p = malloc(sizeof(*p) + network_config_packet_size);
+    if (p == NULL) {
+      ERROR("network plugin: malloc failed.");
+      shard_counter_add(&stats_packets_send_dropped, 1);
+      return;
+    }
+  }
+
+  assert(buffer_len <= network_config_packet_size);
+  memcpy(p->data, buffer, buffer_len);
+  p->size = buffer_len;
+  p->next = NULL;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->tail == NULL)
+    q->head = p;
+  else
+    q->tail->next = p;
+  q->tail = p;
+  q->length++;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->lock);
+} /* }}} void send_queue_push */
+
+/* Sends `num' sealed packets to the server of `se', using as few system calls
+ * as possible. Over TCP, `more' signals that another batch follows. */
+static void network_send_batch(sockent_t *se, struct iovec *iov, /* {{{ */
+                               size_t num, bool more) {
+  assert(num <= SEND_BATCH_SIZE);
+
+  if (se->protocol == SOCKENT_PROTOCOL_TCP) {
+    uint32_t frame_len[SEND_BATCH_SIZE];
+    struct iovec frames[2 * SEND_BATCH_SIZE];
+    int flags = 0;
+
+    if (sockent_client_connect(se) != 0)
+      return;
+
+    for (size_t i = 0; i < num; i++) {
+      frame_len[i] = htonl((uint32_t)iov[i].iov_len);
+      frames[2 * i].iov_base = frame_len + i;
+      frames[2 * i].iov_len = sizeof(frame_len[i]);
+      frames[2 * i + 1] = iov[i];
+    }
+#ifdef MSG_MORE
+    if (more)
+      flags |= MSG_MORE;
+#endif
+    network_send_stream(se, frames, 2 * num, flags);
+    return;
+  }
+
+#if HAVE_SENDMMSG
+  struct mmsghdr msgs[SEND_BATCH_SIZE];
+  size_t sent = 0;
+
+  while (sent < num) {
+    if (sockent_client_connect(se) != 0)
+      return;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = sent; i < num; i++) {
+      msgs[i - sent].msg_hdr.msg_name = se->data.client.addr;
+      msgs[i - sent].msg_hdr.msg_namelen = se->data.client.addrlen;
+      msgs[i - sent].msg_hdr.msg_iov = iov + i;
+      msgs[i - sent].msg_hdr.msg_iovlen = 1;
+    }
+
+    int status = sendmmsg(se->data.client.fd, msgs, (unsigned int)(num - sent),
+                          /* flags = */ 0);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      ERROR("network plugin: sendmmsg failed: %s. Closing sending socket.",
+            STRERRNO);
+      sockent_client_disconnect(se);
+      return;
+    }
+    sent += (size_t)status;
+  }
+#else
+  for (size_t i = 0; i < num; i++)
+    network_send_buffer_plain(se, iov[i].iov_base, iov[i].iov_len);
+#endif
+} /* }}} void network_send_batch */
+
+/* Tells the pool of `se', if any, whether the last packet could be sent. The
+ * socket is closed if sending failed and isn't open while a TCP server is
+ * backing off. */
+static void network_pool_report(sockent_t *se) /* {{{ */
+{
+  network_pool_t *pool = se->data.client.pool;
+  if (pool == NULL)
+    return;
+
+  server_pool_report(pool->members, se->data.client.pool_index,
+                     se->data.client.fd >= 0, cdtime());
+} /* }}} void network_pool_report */
+
+static void *send_thread(void *arg) /* {{{ */
+{
+  send_queue_t *q = arg;
+  sockent_t *se = q->se;
+  size_t sealed_size = BUFF_SIG_SIZE + network_config_packet_size;
+
+  char *sealed = malloc(SEND_BATCH_SIZE * sealed_size);
+  if (sealed == NULL) {
+    ERROR("network plugin: malloc failed.");
+    return (void *)1;
+  }
+
+  while (42) {
+    send_packet_t *batch;
+    struct iovec iov[SEND_BATCH_SIZE];
+    size_t num = 0;
+
+    pthread_mutex_lock(&q->lock);
+    while ((q->head == NULL) && !q->stop)
+      pthread_cond_wait(&q->cond, &q->lock);
+
+    /* Packets still queued are sent before exiting. */
+    if (q->head == NULL) {
+      pthread_mutex_unlock(&q->lock);
+      break;
+    }
+
+    batch = q->head;
+    send_packet_t *last = batch;
+    for (num = 1; (num < SEND_BATCH_SIZE) && (last->next != NULL); num++)
+      last = last->next;
+    q->head = last->next;
+    if (q->head == NULL)
+      q->tail = NULL;
+    last->next = NULL;
+    q->length -= num;
+    bool more = (q->head != NULL);
+    pthread_mutex_unlock(&q->lock);
+
+    size_t sealed_num = 0;
+    for (send_packet_t *p = batch; p != NULL; p = p->next) {
+      size_t size = 0;
+      const char *packet = network_seal_buffer(
+          se, p->data, p->size, sealed + sealed_num * sealed_size, &size);
+      if (packet == NULL)
+        continue;
+
+      iov[sealed_num].iov_base = (void *)packet;
+      iov[sealed_num].iov_len = size;
+      sealed_num++;
+    }
+
+    if (sealed_num > 0) {
+      network_send_batch(se, iov, sealed_num, more);
+      network_pool_report(se);
+    }
+
+    pthread_mutex_lock(&q->lock);
+    last->next = q->free;
+    q->free = batch;
+    pthread_mutex_unlock(&q->lock);
+  } /* while (42) */
+
+  sfree(sealed);
+  return (void *)0;
+} /* }}} void *send_thread */
+
+static int send_threads_start(void) /* {{{ */
+{
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    send_queue_t *q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+      ERROR("network plugin: calloc failed.");
+      return ENOMEM;
+    }
+    q->se = se;
+    pthread_mutex_init(&q->lock, /* attr = */ NULL);
+    pthread_cond_init(&q->cond, /* attr = */ NULL);
+
+    int status = plugin_thread_create(&q->thread, /* attr = */ NULL,
+                                      send_thread, q, "network send");
+    if (status != 0) {
+      /* This server is served by the write threads instead. */
+      ERROR("network: pthread_create failed: %s", STRERRNO);
+      pthread_cond_destroy(&q->cond);
+      pthread_mutex_destroy(&q->lock);
+      sfree(q);
+      continue;
+    }
+    q->running = true;
+
+    se->data.client.queue = q;
+  }
+
+  return 0;
+} /* }}} int send_threads_start */
+
+/* Waits for the send threads to send all queued packets and exit. */
+static void send_threads_stop(void) /* {{{ */
+{
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    send_queue_t *q = se->data.client.queue;
+    if (q == NULL)
+      continue;
+
+    pthread_mutex_lock(&q->lock);
+    q->stop = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    if (q->running) {
+      pthread_join(q->thread, /* retval = */ NULL);
+      q->running = false;
+    }
+
+    while (q->head != NULL) {
+      send_packet_t *p = q->head;
+      q->head = p->next;
+      free(p);
+    }
+    while (q->free != NULL) {
+      send_packet_t *p = q->free;
+      q->free = p->next;
+      free(p);
+    }
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    sfree(q);
+    se->data.client.queue = NULL;
+  }
+} /* }}} void send_threads_stop */
+
+static void network_send_sockent(sockent_t *se, const char *buffer, /* {{{ */
+                                 size_t buffer_len) {
+  /* Signing, encrypting and sending is done by the server's send thread. */
+  if (se->data.client.queue != NULL) {
+    send_queue_push(se->data.client.queue, buffer, buffer_len);
+    return;
+  }
+
+  char sealed[BUFF_SIG_SIZE + buffer_len];
+  size_t sealed_size = 0;
+  const char *packet =
+      network_seal_buffer(se, buffer, buffer_len, sealed, &sealed_size);
+  if (packet != NULL)
+    network_send_buffer_plain(se, packet, sealed_size);
+  network_pool_report(se);
+} /* }}} void network_send_sockent */
+
+/* Sends a packet to all servers outside of a pool. */
+static void network_send_buffer(char *buffer, size_t buffer_len) /* {{{ */
+{
+  DEBUG("network plugin: network_send_buffer: buffer_len = %" PRIsz,
+        buffer_len);
+
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next)
+    if (se->data.client.pool == NULL)
+      network_send_sockent(se, buffer, buffer_len);
+} /* }}} void network_send_buffer */
+
+static bool network_have_unpooled_servers(void) /* {{{ */
+{
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next)
+    if (se->data.client.pool == NULL)
+      return true;
+  return false;
+} /* }}} bool network_have_unpooled_servers */
+
+/* Returns the buffer of the pool member that values with the identifier hash
+ * `hash' are sent to, or NULL if all members are down. */
+static send_buffer_t *network_pool_buffer(network_pool_t *pool, /* {{{ */
+                                          uint64_t hash) {
+  int index = server_pool_select(pool->members, hash, cdtime());
+  return (index >= 0) ? pool->buffers + index : NULL;
+} /* }}} send_buffer_t *network_pool_buffer */
+
+static bool sockent_client_seals(const sockent_t *se) /* {{{ */
+{
+#if HAVE_GCRYPT_H
+  return se->data.client.security_level != SECURITY_LEVEL_NONE;
+#else
+  return false;
+#endif
+} /* }}} bool sockent_client_seals */
+
+/* Sends received packets to all servers without parsing them. Servers with a
+ * security level get each packet signed or encrypted as a whole, so the
+ * receiver unwraps it and then parses the original packet. Packets larger than
+ * `MaxPacketSize', which can only be received over TCP, are dropped. */
+static void network_relay(struct iovec *iov, size_t num) /* {{{ */
+{
+  struct iovec packets[num];
+  size_t packets_num = 0;
+
+  for (size_t i = 0; i < num; i++) {
+    if (iov[i].iov_len > network_config_packet_size) {
+      shard_counter_add(&stats_packets_send_dropped, 1);
+      continue;
+    }
+    packets[packets_num++] = iov[i];
+  }
+  if (packets_num == 0)
+    return;
+
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    /* Packets can't be sharded by identifier without parsing them. */
+    if (se->data.client.pool != NULL)
+      continue;
+
+    /* The send thread signs or encrypts the packets, if needed. */
+    if (se->data.client.queue != NULL) {
+      for (size_t i = 0; i < packets_num; i++)
+        send_queue_push(se->data.client.queue, packets[i].iov_base,
+                        packets[i].iov_len);
+      continue;
+    }
+
+    /* The socket and cipher of the server are shared with the write
+     * threads. */
+    pthread_mutex_lock(&send_buffer_lock);
+    if (!sockent_client_seals(se)) {
+      for (size_t i = 0; i < packets_num; i += SEND_BATCH_SIZE)
+        network_send_batch(se, packets + i,
+                           MIN(packets_num - i, SEND_BATCH_SIZE),
+                           /* more = */ i + SEND_BATCH_SIZE < packets_num);
+    } else {
+      char sealed[BUFF_SIG_SIZE + network_config_packet_size];
+      for (size_t i = 0; i < packets_num; i++) {
+        size_t sealed_size = 0;
+        const char *packet =
+            network_seal_buffer(se, packets[i].iov_base, packets[i].iov_len,
+                                sealed, &sealed_size);
+        if (packet != NULL)
+          network_send_buffer_plain(se, packet, sealed_size);
+      }
+    }
+    pthread_mutex_unlock(&send_buffer_lock);
+  }
+
+  shard_counter_add(&stats_packets_relayed, packets_num);
+} /* }}} void network_relay */
+
+/* Enables `Relay' for the listen sockets. Signatures and encryption are only
+ * checked when parsing, so packets of sockets with a security level are
+ * parsed and dispatched as usual. */
+static void network_relay_init(void) /* {{{ */
+{
+  if (!network_have_unpooled_servers()) {
+    WARNING("network plugin: `Relay' is enabled, but no `Server' outside of "
+            "a `ServerPool' is configured. Received packets are parsed as "
+            "usual.");
+    return;
+  }
+
+  sockent_t *lists[] = {listen_sockets, listen_streams};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    for (sockent_t *se = lists[i]; se != NULL; se = se->next) {
+#if HAVE_GCRYPT_H
+      if (se->data.server.security_level != SECURITY_LEVEL_NONE) {
+        WARNING("network plugin: Packets received on [%s]:%s are not "
+                "relayed, because `Relay' cannot check signed or encrypted "
+                "packets.",
+                (se->node != NULL) ? se->node : "::",
+                (se->service != NULL) ? se->service : NET_DEFAULT_PORT);
+        continue;
+      }
+#endif
+      se->data.server.relay = true;
+    }
+  }
+} /* }}} void network_relay_init */
+
+static int ident_dict_init(void) /* {{{ */
+{
+  ident_dict = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (ident_dict == NULL) {
+    ERROR("network plugin: c_avl_create failed.");
+    return -1;
+  }
+
+  /* Zero is reserved for "no session". */
+  do {
+    ident_dict_session = (((uint64_t)cdrand_u()) << 32) | cdrand_u();
+    ident_dict_session ^= ident_hash(hostname_g) ^ (uint64_t)cdtime();
+  } while (ident_dict_session == 0);
+  ident_dict_next = 1;
+
+  return 0;
+} /* }}} int ident_dict_init */
+
+static void ident_dict_destroy(void) /* {{{ */
+{
+  char *name;
+  ident_dict_entry_t *entry;
+
+  if (ident_dict == NULL)
+    return;
+
+  while (c_avl_pick(ident_dict, (void *)&name, (void *)&entry) == 0) {
+    sfree(entry->name);
+    sfree(entry);
+  }
+  c_avl_destroy(ident_dict);
+  ident_dict = NULL;
+} /* }}} void ident_dict_destroy */
+
+/* Returns the dictionary entry of `vl', assigning a number if necessary, or
+ * NULL if the dictionary is disabled or full. */
+static ident_dict_entry_t *ident_dict_entry(const value_list_t *vl) /* {{{ */
+{
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  char const *name;
+  ident_dict_entry_t *entry = NULL;
+
+  if (ident_dict == NULL)
+    return NULL;
+
+  if (vl->ident != NULL) {
+    name = vl->ident->name;
+  } else {
+    if (FORMAT_VL(buffer, sizeof(buffer), vl) != 0)
+      return NULL;
+    name = buffer;
+  }
+
+  if (c_avl_get(ident_dict, name, (void *)&entry) == 0)
+    return entry;
+
+  if (ident_dict_next > IDENT_DICT_SIZE)
+    return NULL;
+
+  entry = calloc(1, sizeof(*entry));
+  if (entry == NULL)
+    return NULL;
+  entry->name = strdup(name);
+  if (entry->name == NULL) {
+    sfree(entry);
+    return NULL;
+  }
+  entry->id = ident_dict_next;
+
+  if (c_avl_insert(ident_dict, entry->name, entry) != 0) {
+    sfree(entry->name);
+    sfree(entry);
+    return NULL;
+  }
+  ident_dict_next++;
+
+  return entry;
+} /* }}} ident_dict_entry_t *ident_dict_entry */
+
+/* Writes the parts of `vl' to `buffer', which belongs to the packet of `sb'.
+ * If `entry' is not NULL, the identifier is written as a reference to
+ * `entry', or, if `define' is true, followed by its definition. */
+static int add_to_buffer(send_buffer_t *sb, char *buffer, /* {{{ */
+                         size_t buffer_size, const data_set_t *ds,
+                         const value_list_t *vl,
+                         const ident_dict_entry_t *entry, bool define) {
+  char *buffer_orig = buffer;
+  value_list_t *vl_def = &sb->vl;
+
+  if ((entry != NULL) && !sb->session) {
+    if (write_part_number(&buffer, &buffer_size, TYPE_IDENT_SESSION,
+                          ident_dict_session) != 0)
+      return -1;
+    sb->session = true;
+  }
+
+  if ((entry != NULL) && !define) {
+    if (sb->ident != entry->id) {
+      if (write_part_number(&buffer, &buffer_size, TYPE_IDENT_REF,
+                            entry->id) != 0)
+        return -1;
+      sstrncpy(vl_def->host, vl->host, sizeof(vl_def->host));
+      sstrncpy(vl_def->plugin, vl->plugin, sizeof(vl_def->plugin));
+      sstrncpy(vl_def->plugin_instance, vl->plugin_instance,
+               sizeof(vl_def->plugin_instance));
+      sstrncpy(vl_def->type, vl->type, sizeof(vl_def->type));
+      sstrncpy(vl_def->type_instance, vl->type_instance,
+               sizeof(vl_def->type_instance));
+      sb->ident = entry->id;
+    }
+
+    if (vl_def->time != vl->time) {
+      if (write_part_number(&buffer, &buffer_size, TYPE_TIME_HR,
+                            (uint64_t)vl->time))
+        return -1;
+      vl_def->time = vl->time;
+    }
+
+    if (vl_def->interval != vl->interval) {
+      if (write_part_number(&buffer, &buffer_size, TYPE_INTERVAL_HR,
+                            (uint64_t)vl->interval))
+        return -1;
+      vl_def->interval = vl->interval;
+    }
+
+    if (write_part_values(&buffer, &buffer_size, TYPE_IDENT_VALUES, ds, vl) !=
+        0)
+      return -1;
+
+    return buffer - buffer_orig;
+  }
+
+  bool full = (sb->ident != 0);
+
+  if (full || (strcmp(vl_def->host, vl->host) != 0)) {
+    if (write_part_string(&buffer, &buffer_size, TYPE_HOST, vl->host,
+                          strlen(vl->host)) != 0)
+      return -1;
+    sstrncpy(vl_def->host, vl->host, sizeof(vl_def->host));
+  }
+
+  if (vl_def->time != vl->time) {
+    if (write_part_number(&buffer, &buffer_size, TYPE_TIME_HR,
+                          (uint64_t)vl->time))
+      return -1;
+    vl_def->time = vl->time;
+  }
+
+  if (vl_def->interval != vl->interval) {
+    if (write_part_number(&buffer, &buffer_size, TYPE_INTERVAL_HR,
+                          (uint64_t)vl->interval))
+      return -1;
+    vl_def->interval = vl->interval;
+  }
+
+  if (full || (strcmp(vl_def->plugin, vl->plugin) != 0)) {
+    if (write_part_string(&buffer, &buffer_size, TYPE_PLUGIN, vl->plugin,
+                          strlen(vl->plugin)) != 0)
+      return -1;
+    sstrncpy(vl_def->plugin, vl->plugin, sizeof(vl_def->plugin));
+  }
+
+  if (full ||
+      (strcmp(vl_def->plugin_instance, vl->plugin_instance) != 0)) {
+    if (write_part_string(&buffer, &buffer_size, TYPE_PLUGIN_INSTANCE,
+                          vl->plugin_instance,
+                          strlen(vl->plugin_instance)) != 0)
+      return -1;
+    sstrncpy(vl_def->plugin_instance, vl->plugin_instance,
+             sizeof(vl_def->plugin_instance));
+  }
+
+  if (full || (strcmp(vl_def->type, vl->type) != 0)) {
+    if (write_part_string(&buffer, &buffer_size, TYPE_TYPE, vl->type,
+                          strlen(vl->type)) != 0)
+      return -1;
+    sstrncpy(vl_def->type, ds->type, sizeof(vl_def->type));
+  }
+
+  if (full || (strcmp(vl_def->type_instance, vl->type_instance) != 0)) {
+    if (write_part_string(&buffer, &buffer_size, TYPE_TYPE_INSTANCE,
+                          vl->type_instance, strlen(vl->type_instance)) != 0)
+      return -1;
+    sstrncpy(vl_def->type_instance, vl->type_instance,
+             sizeof(vl_def->type_instance));
+  }
+
+  if (define) {
+    if (write_part_number(&buffer, &buffer_size, TYPE_IDENT_DEFINE,
+                          entry->id) != 0)
+      return -1;
+  }
+  sb->ident = 0;
+
+  if (write_part_values(&buffer, &buffer_size, TYPE_VALUES, ds, vl) != 0)
+    return -1;
+
+  return buffer - buffer_orig;
+} /* }}} int add_to_buffer */
+
+#if HAVE_LIBZ
+static int compress_init(send_buffer_t *sb) /* {{{ */
+{
+  if (compress_scratch == NULL) {
+    compress_scratch = malloc(network_config_packet_size);
+    if (compress_scratch == NULL) {
+      ERROR("network plugin: malloc failed.");
+      return -1;
+    }
+  }
+
+  if (deflateInit2(&sb->compress_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   /* raw deflate = */ -MAX_WBITS, /* memLevel = */ 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    ERROR("network plugin: deflateInit2 failed.");
+    return -1;
+  }
+  sb->compress_stream_initialized = true;
+
+  return 0;
+} /* }}} int compress_init */
+
+static void compress_destroy(send_buffer_t *sb) /* {{{ */
+{
+  if (sb->compress_stream_initialized)
+    deflateEnd(&sb->compress_stream);
+  sb->compress_stream_initialized = false;
+} /* }}} void compress_destroy */
+
+/* Finishes the deflate stream and writes the header of the compressed part to
+ * the beginning of the buffer of `sb'. */
+static int compress_finish(send_buffer_t *sb) /* {{{ */
+{
+  z_stream *zs = &sb->compress_stream;
+  size_t avail = network_config_packet_size - BUFF_SIG_SIZE;
+
+  zs->next_in = NULL;
+  zs->avail_in = 0;
+  zs->next_out = (Bytef *)(sb->buffer + PART_COMPRESSED_SIZE + zs->total_out);
+  zs->avail_out = (uInt)(avail - PART_COMPRESSED_SIZE - zs->total_out);
+
+  if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+    ERROR("network plugin: deflate failed to finish the stream.");
+    return -1;
+  }
+
+  uint16_t type = htons(TYPE_COMPRESSED_DEFLATE);
+  uint16_t length = htons((uint16_t)(PART_COMPRESSED_SIZE + zs->total_out));
+  uint16_t dictionary = htons(COMPRESS_DICTIONARY_V1);
+  uint32_t original_len = htonl((uint32_t)sb->compress_raw_len);
+
+  memcpy(sb->buffer, &type, sizeof(type));
+  memcpy(sb->buffer + 2, &length, sizeof(length));
+  memcpy(sb->buffer + 4, &dictionary, sizeof(dictionary));
+  memcpy(sb->buffer + 6, &original_len, sizeof(original_len));
+
+  sb->fill = (int)(PART_COMPRESSED_SIZE + zs->total_out);
+  return 0;
+} /* }}} int compress_finish */
+
+static void flush_buffer(send_buffer_t *sb);
+
+/* Compressing counterpart of the add_to_buffer() calls in
+ * network_write_buffer(). Returns the number of uncompressed bytes added or
+ * -1 on error. */
+static int compress_add(send_buffer_t *sb, const data_set_t *ds, /* {{{ */
+                        const value_list_t *vl,
+                        const ident_dict_entry_t *entry, bool define) {
+  z_stream *zs = &sb->compress_stream;
+  size_t avail =
+      network_config_packet_size - (BUFF_SIG_SIZE + PART_COMPRESSED_SIZE);
+  int status;
+
+  status = add_to_buffer(sb, compress_scratch, network_config_packet_size, ds,
+                         vl, entry, define);
+  if ((status >= 0) && (sb->compress_raw_len > 0) &&
+      ((zs->total_out + COMPRESS_BOUND((size_t)status)) > avail)) {
+    /* Start a new packet; the value has to be encoded again because it relied
+     * on the fields of previous values in this packet. */
+    flush_buffer(sb);
+    status = add_to_buffer(sb, compress_scratch, network_config_packet_size,
+                           ds, vl, entry, define);
+  }
+  if (status < 0)
+    return -1;
+  if ((zs->total_out + COMPRESS_BOUND((size_t)status)) > avail)
+    return -1;
+
+  zs->next_in = (Bytef *)compress_scratch;
+  zs->avail_in = (uInt)status;
+  zs->next_out = (Bytef *)(sb->buffer + PART_COMPRESSED_SIZE + zs->total_out);
+  zs->avail_out = (uInt)(avail - zs->total_out);
+
+  if ((deflate(zs, Z_SYNC_FLUSH) != Z_OK) || (zs->avail_in != 0)) {
+    ERROR("network plugin: deflate failed.");
+    network_init_buffer(sb);
+    return -1;
+  }
+
+  sb->compress_raw_len += (size_t)status;
+  sb->fill = (int)(PART_COMPRESSED_SIZE + zs->total_out);
+  sb->last_update = cdtime();
+
+  return status;
+} /* }}} int compress_add */
+#endif /* HAVE_LIBZ */
+
+static int send_buffer_create(send_buffer_t *sb, sockent_t *se) /* {{{ */
+{
+  sb->buffer = malloc(network_config_packet_size);
+  if (sb->buffer == NULL) {
+    ERROR("network plugin: malloc failed.");
+    return -1;
+  }
+  sb->se = se;
+
+#if HAVE_LIBZ
+  if (network_config_compress && (compress_init(sb) != 0))
+    return -1;
+#endif
+  network_init_buffer(sb);
+
+  return 0;
+} /* }}} int send_buffer_create */
+
+static void send_buffer_destroy(send_buffer_t *sb) /* {{{ */
+{
+#if HAVE_LIBZ
+  compress_destroy(sb);
+#endif
+  sfree(sb->buffer);
+} /* }}} void send_buffer_destroy */
+
+static void flush_buffer(send_buffer_t *sb) {
+  DEBUG("network plugin: flush_buffer: fill = %i", sb->fill);
+
+#if HAVE_LIBZ
+  if (sb->compress_stream_initialized && (compress_finish(sb) != 0)) {
+    network_init_buffer(sb);
+    return;
+  }
+#endif
 
-static void network_send_buffer(char *buffer, size_t buffer_len) /* {{{ */
-{
-  DEBUG("network plugin: network_send_buffer: buffer_len = %" PRIsz,
-        buffer_len);
+  if (sb->se != NULL)
+    network_send_sockent(sb->se, sb->buffer, (size_t)sb->fill);
+  else
+    network_send_buffer(sb->buffer, (size_t)sb->fill);
 
-  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
-#if HAVE_GCRYPT_H
-    if (se->data.client.security_level == SECURITY_LEVEL_ENCRYPT)
-      network_send_buffer_encrypted(se, buffer, buffer_len);
-    else if (se->data.client.security_level == SECURITY_LEVEL_SIGN)
-      network_send_buffer_signed(se, buffer, buffer_len);
-    else /* if (se->data.client.security_level == SECURITY_LEVEL_NONE) */
-#endif   /* HAVE_GCRYPT_H */
-      network_send_buffer_plain(se, buffer, buffer_len);
-  } /* for (sending_sockets) */
-} /* }}} void network_send_buffer */
+  shard_counter_add(&stats_octets_tx, (uint64_t)sb->fill);
+  shard_counter_add(&stats_packets_tx, 1);
 
-static int add_to_buffer(char *buffer, size_t buffer_size, /* {{{ */
-                         value_list_t *vl_def, const data_set_t *ds,
-                         const value_list_t *vl) {
-  char *buffer_orig = buffer;
+  network_init_buffer(sb);
+}
 
-  if (strcmp(vl_def->host, vl->host) != 0) {
-    if (write_part_string(&buffer, &buffer_size, TYPE_HOST, vl->host,
-                          strlen(vl->host)) != 0)
-      return -1;
-    sstrncpy(vl_def->host, vl->host, sizeof(vl_def->host));
-  }
+/* Adds `vl' to the packet of `sb', sending the packet first if `vl' doesn't
+ * fit anymore. Called with `send_buffer_lock' held. */
+static int network_write_buffer(send_buffer_t *sb, /* {{{ */
+                                const data_set_t *ds, const value_list_t *vl,
+                                ident_dict_entry_t *entry) {
+  int status;
 
-  if (vl_def->time != vl->time) {
-    if (write_part_number(&buffer, &buffer_size, TYPE_TIME_HR,
-                          (uint64_t)vl->time))
-      return -1;
-    vl_def->time = vl->time;
+  cdtime_t now = 0;
+  bool define = false;
+  if (entry != NULL) {
+    now = cdtime();
+    define = (entry->defined == 0) ||
+             ((now - entry->defined) >= IDENT_DICT_REFRESH);
   }
 
-  if (vl_def->interval != vl->interval) {
-    if (write_part_number(&buffer, &buffer_size, TYPE_INTERVAL_HR,
-                          (uint64_t)vl->interval))
+#if HAVE_LIBZ
+  if (sb->compress_stream_initialized) {
+    status = compress_add(sb, ds, vl, entry, define);
+    if (status < 0) {
+      ERROR("network plugin: Unable to append to the "
+            "compressed buffer.");
       return -1;
-    vl_def->interval = vl->interval;
-  }
+    }
 
-  if (strcmp(vl_def->plugin, vl->plugin) != 0) {
-    if (write_part_string(&buffer, &buffer_size, TYPE_PLUGIN, vl->plugin,
-                          strlen(vl->plugin)) != 0)
-      return -1;
-    sstrncpy(vl_def->plugin, vl->plugin, sizeof(vl_def->plugin));
+    if (define)
+      entry->defined = now;
+    return 0;
   }
+#endif
 
-  if (strcmp(vl_def->plugin_instance, vl->plugin_instance) != 0) {
-    if (write_part_string(&buffer, &buffer_size, TYPE_PLUGIN_INSTANCE,
-                          vl->plugin_instance,
-                          strlen(vl->plugin_instance)) != 0)
-      return -1;
-    sstrncpy(vl_def->plugin_instance, vl->plugin_instance,
-             sizeof(vl_def->plugin_instance));
-  }
+  status = add_to_buffer(
+      sb, sb->ptr, network_config_packet_size - (sb->fill + BUFF_SIG_SIZE), ds,
+      vl, entry, define);
+  if (status >= 0) {
+    /* status == bytes added to the buffer */
+    sb->fill += status;
+    sb->ptr += status;
+    sb->last_update = cdtime();
+  } else {
+    flush_buffer(sb);
 
-  if (strcmp(vl_def->type, vl->type) != 0) {
-    if (write_part_string(&buffer, &buffer_size, TYPE_TYPE, vl->type,
-                          strlen(vl->type)) != 0)
-      return -1;
-    sstrncpy(vl_def->type, ds->type, sizeof(vl_def->type));
-  }
+    status = add_to_buffer(
+        sb, sb->ptr, network_config_packet_size - (sb->fill + BUFF_SIG_SIZE),
+        ds, vl, entry, define);
 
-  if (strcmp(vl_def->type_instance, vl->type_instance) != 0) {
-    if (write_part_string(&buffer, &buffer_size, TYPE_TYPE_INSTANCE,
-                          vl->type_instance, strlen(vl->type_instance)) != 0)
-      return -1;
-    sstrncpy(vl_def->type_instance, vl->type_instance,
-             sizeof(vl_def->type_instance));
+    if (status >= 0) {
+      sb->fill += status;
+      sb->ptr += status;
+    }
   }
 
-  if (write_part_values(&buffer, &buffer_size, ds, vl) != 0)
+  if (status < 0) {
+    ERROR("network plugin: Unable to append to the "
+          "buffer for some weird reason");
     return -1;
+  }
 
-  return buffer - buffer_orig;
-} /* }}} int add_to_buffer */
-
-static void flush_buffer(void) {
-  DEBUG("network plugin: flush_buffer: send_buffer_fill = %i",
-        send_buffer_fill);
+  if (define)
+    entry->defined = now;
+  if ((network_config_packet_size - sb->fill) < 15)
+    flush_buffer(sb);
 
-  network_send_buffer(send_buffer, (size_t)send_buffer_fill);
+  return 0;
+} /* }}} int network_write_buffer */
 
-  stats_octets_tx += ((uint64_t)send_buffer_fill);
-  stats_packets_tx++;
+/* Returns the hash values are sharded by: the hash of the interned
+ * identifier, so that all senders agree on it. */
+static uint64_t network_vl_hash(const value_list_t *vl) /* {{{ */
+{
+  if (vl->ident != NULL)
+    return vl->ident->hash;
 
-  network_init_buffer();
-}
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return 0;
+  return ident_hash(name);
+} /* }}} uint64_t network_vl_hash */
 
 static int network_write(const data_set_t *ds, const value_list_t *vl,
                          user_data_t __attribute__((unused)) * user_data) {
@@ -2645,55 +5556,43 @@ static int network_write(const data_set_t *ds, const value_list_t *vl,
           "NOT sending %s.",
           name);
 #endif
-    /* Counter is not protected by another lock and may be reached by
-     * multiple threads */
-    pthread_mutex_lock(&stats_lock);
-    stats_values_not_sent++;
-    pthread_mutex_unlock(&stats_lock);
+    shard_counter_add(&stats_values_not_sent, 1);
     return 0;
   }
 
   uc_meta_data_add_unsigned_int(vl, "network:time_sent", (uint64_t)vl->time);
 
+  status = 0;
   pthread_mutex_lock(&send_buffer_lock);
 
-  status = add_to_buffer(send_buffer_ptr,
-                         network_config_packet_size -
-                             (send_buffer_fill + BUFF_SIG_SIZE),
-                         &send_buffer_vl, ds, vl);
-  if (status >= 0) {
-    /* status == bytes added to the buffer */
-    send_buffer_fill += status;
-    send_buffer_ptr += status;
-    send_buffer_last_update = cdtime();
-
-    stats_values_sent++;
-  } else {
-    flush_buffer();
-
-    status = add_to_buffer(send_buffer_ptr,
-                           network_config_packet_size -
-                               (send_buffer_fill + BUFF_SIG_SIZE),
-                           &send_buffer_vl, ds, vl);
-
-    if (status >= 0) {
-      send_buffer_fill += status;
-      send_buffer_ptr += status;
-
-      stats_values_sent++;
+  if (send_buffer.buffer != NULL)
+    status = network_write_buffer(&send_buffer, ds, vl, ident_dict_entry(vl));
+
+  if (server_pools != NULL) {
+    static c_complain_t pool_complaint = C_COMPLAIN_INIT_STATIC;
+    uint64_t hash = network_vl_hash(vl);
+
+    for (network_pool_t *pool = server_pools; pool != NULL;
+         pool = pool->next) {
+      send_buffer_t *sb = network_pool_buffer(pool, hash);
+      if (sb == NULL) {
+        c_complain(LOG_WARNING, &pool_complaint,
+                   "network plugin: All members of the server pool \"%s\" "
+                   "are down. Dropping values.",
+                   pool->name);
+        status = -1;
+        continue;
+      }
+      if (network_write_buffer(sb, ds, vl, /* entry = */ NULL) != 0)
+        status = -1;
     }
   }
 
-  if (status < 0) {
-    ERROR("network plugin: Unable to append to the "
-          "buffer for some weird reason");
-  } else if ((network_config_packet_size - send_buffer_fill) < 15) {
-    flush_buffer();
-  }
-
   pthread_mutex_unlock(&send_buffer_lock);
 
-  return (status < 0) ? -1 : 0;
+  if (status == 0)
+    shard_counter_add(&stats_values_sent, 1);
+  return status;
 } /* int network_write */
 
 static int network_config_set_ttl(const oconfig_item_t *ci) /* {{{ */
@@ -2723,6 +5622,25 @@ static int network_config_set_interface(const oconfig_item_t *ci, /* {{{ */
   return 0;
 } /* }}} int network_config_set_interface */
 
+static int network_config_set_protocol(const oconfig_item_t *ci, /* {{{ */
+                                       int *protocol) {
+  char str[16];
+
+  if (cf_util_get_string_buffer(ci, str, sizeof(str)) != 0)
+    return -1;
+
+  if (strcasecmp("UDP", str) == 0)
+    *protocol = SOCKENT_PROTOCOL_UDP;
+  else if (strcasecmp("TCP", str) == 0)
+    *protocol = SOCKENT_PROTOCOL_TCP;
+  else {
+    WARNING("network plugin: Unknown protocol: %s.", str);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int network_config_set_protocol */
+
 static int
 network_config_set_bind_address(const oconfig_item_t *ci,
                                 struct sockaddr_storage **bind_address) {
@@ -2791,6 +5709,56 @@ static int network_config_set_buffer_size(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int network_config_set_buffer_size */
 
+static int network_config_set_receive_threads( /* {{{ */
+    const oconfig_item_t *ci) {
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+
+  if (tmp < 0) {
+    WARNING("network plugin: The `ReceiveThreads' option must not be "
+            "negative.");
+    return -1;
+  }
+
+  network_config_receive_threads = tmp;
+  return 0;
+} /* }}} int network_config_set_receive_threads */
+
+static int network_config_set_receive_queue_limit( /* {{{ */
+    const oconfig_item_t *ci) {
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+
+  if (tmp < 0) {
+    WARNING("network plugin: The `ReceiveQueueLimit' option must not be "
+            "negative.");
+    return -1;
+  }
+
+  network_config_receive_queue_limit = (uint64_t)tmp;
+  return 0;
+} /* }}} int network_config_set_receive_queue_limit */
+
+static int network_config_set_shed_limit(const oconfig_item_t *ci, /* {{{ */
+                                         long *ret_limit) {
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+
+  if (tmp < 0) {
+    WARNING("network plugin: The `%s' option must not be negative.", ci->key);
+    return -1;
+  }
+
+  *ret_limit = (long)tmp;
+  return 0;
+} /* }}} int network_config_set_shed_limit */
+
 #if HAVE_GCRYPT_H
 static int network_config_set_security_level(oconfig_item_t *ci, /* {{{ */
                                              int *retval) {
@@ -2815,6 +5783,30 @@ static int network_config_set_security_level(oconfig_item_t *ci, /* {{{ */
 
   return 0;
 } /* }}} int network_config_set_security_level */
+
+static int network_config_set_cipher_mode(oconfig_item_t *ci, /* {{{ */
+                                          int *retval) {
+  char *str;
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
+    WARNING("network plugin: The `CipherMode' config option needs exactly "
+            "one string argument.");
+    return -1;
+  }
+
+  str = ci->values[0].value.string;
+  if (strcasecmp("OFB", str) == 0)
+    *retval = CIPHER_MODE_OFB;
+#if NETWORK_HAVE_GCM
+  else if (strcasecmp("GCM", str) == 0)
+    *retval = CIPHER_MODE_GCM;
+#endif
+  else {
+    WARNING("network plugin: Unknown or unsupported cipher mode: %s.", str);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int network_config_set_cipher_mode */
 #endif /* HAVE_GCRYPT_H */
 
 static int network_config_add_listen(const oconfig_item_t *ci) /* {{{ */
@@ -2853,11 +5845,22 @@ static int network_config_add_listen(const oconfig_item_t *ci) /* {{{ */
 #endif /* HAVE_GCRYPT_H */
         if (strcasecmp("Interface", child->key) == 0)
       network_config_set_interface(child, &se->interface);
+    else if (strcasecmp("Protocol", child->key) == 0)
+      network_config_set_protocol(child, &se->protocol);
     else {
       WARNING("network plugin: Option `%s' is not allowed here.", child->key);
     }
   }
 
+#if !HAVE_SYS_EPOLL_H
+  if (se->protocol == SOCKENT_PROTOCOL_TCP) {
+    ERROR("network plugin: Listening on TCP sockets is not supported on this "
+          "platform.");
+    sockent_destroy(se);
+    return -1;
+  }
+#endif
+
 #if HAVE_GCRYPT_H
   if ((se->data.server.security_level > SECURITY_LEVEL_NONE) &&
       (se->data.server.auth_file == NULL)) {
@@ -2895,8 +5898,8 @@ static int network_config_add_listen(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int network_config_add_listen */
 
-static int network_config_add_server(const oconfig_item_t *ci) /* {{{ */
-{
+static int network_config_add_server(const oconfig_item_t *ci, /* {{{ */
+                                     network_pool_t *pool) {
   sockent_t *se;
   int status;
 
@@ -2929,6 +5932,8 @@ static int network_config_add_server(const oconfig_item_t *ci) /* {{{ */
       cf_util_get_string(child, &se->data.client.password);
     else if (strcasecmp("SecurityLevel", child->key) == 0)
       network_config_set_security_level(child, &se->data.client.security_level);
+    else if (strcasecmp("CipherMode", child->key) == 0)
+      network_config_set_cipher_mode(child, &se->data.client.cipher_mode);
     else
 #endif /* HAVE_GCRYPT_H */
         if (strcasecmp("Interface", child->key) == 0)
@@ -2937,6 +5942,8 @@ static int network_config_add_server(const oconfig_item_t *ci) /* {{{ */
       network_config_set_bind_address(child, &se->data.client.bind_addr);
     else if (strcasecmp("ResolveInterval", child->key) == 0)
       cf_util_get_cdtime(child, &se->data.client.resolve_interval);
+    else if (strcasecmp("Protocol", child->key) == 0)
+      network_config_set_protocol(child, &se->protocol);
     else {
       WARNING("network plugin: Option `%s' is not allowed here.", child->key);
     }
@@ -2965,6 +5972,36 @@ static int network_config_add_server(const oconfig_item_t *ci) /* {{{ */
   /* No call to sockent_client_connect() here -- it is called from
    * network_send_buffer_plain(). */
 
+  if (pool != NULL) {
+    /* The member's name determines which values it gets, so it has to be the
+     * same on all hosts sending to the pool. */
+    char name[1024];
+    snprintf(name, sizeof(name), "%s:%s", se->node,
+             (se->service != NULL) ? se->service : NET_DEFAULT_PORT);
+
+    sockent_t **tmp =
+        realloc(pool->sockents, (pool->num + 1) * sizeof(*pool->sockents));
+    if (tmp == NULL) {
+      ERROR("network plugin: realloc failed.");
+      sockent_destroy(se);
+      return -1;
+    }
+    pool->sockents = tmp;
+
+    int index = server_pool_add(pool->members, name);
+    if (index < 0) {
+      ERROR("network plugin: Adding server \"%s\" to the server pool \"%s\" "
+            "failed: %s",
+            name, pool->name, STRERRNO);
+      sockent_destroy(se);
+      return -1;
+    }
+    pool->sockents[index] = se;
+    pool->num = (size_t)index + 1;
+    se->data.client.pool = pool;
+    se->data.client.pool_index = (size_t)index;
+  }
+
   status = sockent_add(se);
   if (status != 0) {
     ERROR("network plugin: network_config_add_server: sockent_add failed.");
@@ -2975,6 +6012,59 @@ static int network_config_add_server(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int network_config_add_server */
 
+static int network_config_add_pool(const oconfig_item_t *ci) /* {{{ */
+{
+  network_pool_t *pool = calloc(1, sizeof(*pool));
+  if (pool == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return -1;
+  }
+
+  if (cf_util_get_string(ci, &pool->name) != 0) {
+    sfree(pool);
+    return -1;
+  }
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+    if (strcasecmp("RetryInterval", child->key) == 0)
+      cf_util_get_cdtime(child, &pool->retry_interval);
+  }
+
+  pool->members = server_pool_create(pool->retry_interval);
+  if (pool->members == NULL) {
+    ERROR("network plugin: server_pool_create failed.");
+    sfree(pool->name);
+    sfree(pool);
+    return -1;
+  }
+
+  /* Append the pool before adding servers, so it's freed on shutdown even if
+   * they fail. */
+  network_pool_t **last = &server_pools;
+  while (*last != NULL)
+    last = &(*last)->next;
+  *last = pool;
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Server", child->key) == 0)
+      network_config_add_server(child, pool);
+    else if (strcasecmp("RetryInterval", child->key) == 0) {
+      /* Handled earlier */
+    } else {
+      WARNING("network plugin: Option `%s' is not allowed here.", child->key);
+    }
+  }
+
+  if (pool->num == 0)
+    WARNING("network plugin: The server pool \"%s\" has no servers.",
+            pool->name);
+
+  return 0;
+} /* }}} int network_config_add_pool */
+
 static int network_config(oconfig_item_t *ci) /* {{{ */
 {
   /* The options need to be applied first */
@@ -2982,6 +6072,8 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
     oconfig_item_t *child = ci->children + i;
     if (strcasecmp("TimeToLive", child->key) == 0)
       network_config_set_ttl(child);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      network_config_set_receive_threads(child);
   }
 
   for (int i = 0; i < ci->children_num; i++) {
@@ -2990,15 +6082,40 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
     if (strcasecmp("Listen", child->key) == 0)
       network_config_add_listen(child);
     else if (strcasecmp("Server", child->key) == 0)
-      network_config_add_server(child);
-    else if (strcasecmp("TimeToLive", child->key) == 0) {
+      network_config_add_server(child, /* pool = */ NULL);
+    else if (strcasecmp("ServerPool", child->key) == 0)
+      network_config_add_pool(child);
+    else if ((strcasecmp("TimeToLive", child->key) == 0) ||
+             (strcasecmp("ReceiveThreads", child->key) == 0)) {
       /* Handled earlier */
     } else if (strcasecmp("MaxPacketSize", child->key) == 0)
       network_config_set_buffer_size(child);
     else if (strcasecmp("Forward", child->key) == 0)
       cf_util_get_boolean(child, &network_config_forward);
+    else if (strcasecmp("Relay", child->key) == 0)
+      cf_util_get_boolean(child, &network_config_relay);
     else if (strcasecmp("ReportStats", child->key) == 0)
       cf_util_get_boolean(child, &network_config_stats);
+    else if (strcasecmp("ReceiveQueueLimit", child->key) == 0)
+      network_config_set_receive_queue_limit(child);
+    else if (strcasecmp("PeerShedLimitHigh", child->key) == 0)
+      network_config_set_shed_limit(child, &network_config_shed_high);
+    else if (strcasecmp("PeerShedLimitLow", child->key) == 0)
+      network_config_set_shed_limit(child, &network_config_shed_low);
+    else if (strcasecmp("ReceiveThreadsAffinity", child->key) == 0)
+      cf_util_get_string(child, &network_config_receive_affinity);
+    else if (strcasecmp("SendThreads", child->key) == 0)
+      cf_util_get_boolean(child, &network_config_send_threads);
+    else if (strcasecmp("IdentifierDictionary", child->key) == 0)
+      cf_util_get_boolean(child, &network_config_ident_dict);
+    else if (strcasecmp("Compress", child->key) == 0) {
+#if HAVE_LIBZ
+      cf_util_get_boolean(child, &network_config_compress);
+#else
+      WARNING("network plugin: The `Compress' option requires zlib, which was "
+              "not available at compile time.");
+#endif
+    }
     else {
       WARNING("network plugin: Option `%s' is not allowed here.", child->key);
     }
@@ -3070,14 +6187,49 @@ static int network_notification(const notification_t *n,
   if (status != 0)
     return -1;
 
-  network_send_buffer(buffer, sizeof(buffer) - buffer_free);
+  size_t buffer_len = sizeof(buffer) - buffer_free;
+  network_send_buffer(buffer, buffer_len);
+
+  /* Notifications go to the pool member the host's values are sent to most
+   * of the time, so that one receiver sees all of a host's notifications. */
+  if (server_pools != NULL) {
+    uint64_t hash = ident_hash(n->host);
+    for (network_pool_t *pool = server_pools; pool != NULL;
+         pool = pool->next) {
+      int index = server_pool_select(pool->members, hash, cdtime());
+      if (index >= 0)
+        network_send_sockent(pool->sockents[index], buffer, buffer_len);
+    }
+  }
 
   return 0;
 } /* int network_notification */
 
+/* The members' sockets are destroyed with the other sending sockets. */
+static void network_pools_destroy(void) /* {{{ */
+{
+  while (server_pools != NULL) {
+    network_pool_t *pool = server_pools;
+    server_pools = pool->next;
+
+    for (size_t i = 0; (pool->buffers != NULL) && (i < pool->num); i++)
+      send_buffer_destroy(pool->buffers + i);
+    sfree(pool->buffers);
+    sfree(pool->sockents);
+    server_pool_destroy(pool->members);
+    sfree(pool->name);
+    sfree(pool);
+  }
+} /* }}} void network_pools_destroy */
+
 static int network_shutdown(void) {
   listen_loop++;
 
+  receive_threads_stop();
+#if HAVE_SYS_EPOLL_H
+  stream_thread_stop();
+#endif
+
   /* Kill the listening thread */
   if (receive_thread_running != 0) {
     INFO("network plugin: Stopping receive thread.");
@@ -3097,12 +6249,38 @@ static int network_shutdown(void) {
     dispatch_thread_running = 0;
   }
 
-  sockent_destroy(listen_sockets);
+  receive_pool_destroy();
+
+  if (peer_accounting) {
+    peer_table_destroy();
+    peer_accounting = false;
+  }
 
-  if (send_buffer_fill > 0)
-    flush_buffer();
+  if (receive_thread_key_valid) {
+    pthread_key_delete(receive_thread_key);
+    receive_thread_key_valid = false;
+  }
 
-  sfree(send_buffer);
+  sockent_destroy(listen_sockets);
+  sockent_destroy(listen_streams);
+
+  if (send_buffer.fill > 0)
+    flush_buffer(&send_buffer);
+  for (network_pool_t *pool = server_pools; pool != NULL; pool = pool->next)
+    for (size_t i = 0; (pool->buffers != NULL) && (i < pool->num); i++)
+      if (pool->buffers[i].fill > 0)
+        flush_buffer(pool->buffers + i);
+
+  send_threads_stop();
+
+  ident_dict_destroy();
+  ident_sessions_destroy();
+  send_buffer_destroy(&send_buffer);
+  network_pools_destroy();
+#if HAVE_LIBZ
+  sfree(compress_scratch);
+  sfree(network_config_receive_affinity);
+#endif
 
   for (sockent_t *se = sending_sockets; se != NULL; se = se->next)
     sockent_client_disconnect(se);
@@ -3116,6 +6294,65 @@ static int network_shutdown(void) {
   return 0;
 } /* int network_shutdown */
 
+/* Dispatches the counters of the `PEER_STATS_MAX' peers with the highest
+ * rates, using the peer's address as plugin instance. */
+static void network_stats_read_peers(void) /* {{{ */
+{
+  network_peer_t top[PEER_STATS_MAX];
+  size_t top_num = 0;
+  cdtime_t now = cdtime();
+
+  for (size_t i = 0; i < PEER_PARTITIONS; i++) {
+    peer_partition_t *part = peer_partitions + i;
+
+    pthread_mutex_lock(&part->lock);
+    for (size_t j = 0; j < PEER_PARTITION_SIZE; j++) {
+      network_peer_t *p = part->peers + j;
+      if (!p->used || ((now - p->last_seen) >= PEER_TIMEOUT))
+        continue;
+
+      /* Insertion into `top', which is sorted by descending rate. */
+      size_t pos = top_num;
+      while ((pos > 0) && (top[pos - 1].rate < p->rate))
+        pos--;
+      if (pos >= PEER_STATS_MAX)
+        continue;
+      if (top_num < PEER_STATS_MAX)
+        top_num++;
+      memmove(top + pos + 1, top + pos, (top_num - pos - 1) * sizeof(*top));
+      top[pos] = *p;
+    }
+    pthread_mutex_unlock(&part->lock);
+  }
+
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t values[1];
+
+  vl.values = values;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "network", sizeof(vl.plugin));
+
+  for (size_t i = 0; i < top_num; i++) {
+    if (inet_ntop(top[i].family, top[i].addr, vl.plugin_instance,
+                  sizeof(vl.plugin_instance)) == NULL)
+      continue;
+
+    vl.values[0].derive = top[i].packets_rx;
+    sstrncpy(vl.type, "packets", sizeof(vl.type));
+    sstrncpy(vl.type_instance, "peer-received", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    vl.values[0].derive = top[i].packets_shed;
+    sstrncpy(vl.type_instance, "peer-shed", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    vl.values[0].derive = top[i].values_rx;
+    sstrncpy(vl.type, "total_values", sizeof(vl.type));
+    sstrncpy(vl.type_instance, "peer-received", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+  }
+} /* }}} void network_stats_read_peers */
+
 static int network_stats_read(void) /* {{{ */
 {
   derive_t copy_octets_rx;
@@ -3127,18 +6364,32 @@ static int network_stats_read(void) /* {{{ */
   derive_t copy_values_sent;
   derive_t copy_values_not_sent;
   derive_t copy_receive_list_length;
+  derive_t copy_packets_dropped;
+  derive_t copy_packets_send_dropped;
+  derive_t copy_packets_relayed;
+  gauge_t copy_receive_pool_size;
   value_list_t vl = VALUE_LIST_INIT;
   value_t values[2];
 
-  copy_octets_rx = stats_octets_rx;
-  copy_octets_tx = stats_octets_tx;
-  copy_packets_rx = stats_packets_rx;
-  copy_packets_tx = stats_packets_tx;
-  copy_values_dispatched = stats_values_dispatched;
-  copy_values_not_dispatched = stats_values_not_dispatched;
-  copy_values_sent = stats_values_sent;
-  copy_values_not_sent = stats_values_not_sent;
+  copy_octets_rx = (derive_t)shard_counter_get(&stats_octets_rx);
+  copy_octets_tx = (derive_t)shard_counter_get(&stats_octets_tx);
+  copy_packets_rx = (derive_t)shard_counter_get(&stats_packets_rx);
+  copy_packets_tx = (derive_t)shard_counter_get(&stats_packets_tx);
+  copy_values_dispatched =
+      (derive_t)shard_counter_get(&stats_values_dispatched);
+  copy_values_not_dispatched =
+      (derive_t)shard_counter_get(&stats_values_not_dispatched);
+  copy_values_sent = (derive_t)shard_counter_get(&stats_values_sent);
+  copy_values_not_sent = (derive_t)shard_counter_get(&stats_values_not_sent);
   copy_receive_list_length = receive_list_length;
+  copy_packets_dropped = (derive_t)shard_counter_get(&stats_packets_dropped);
+  copy_packets_send_dropped =
+      (derive_t)shard_counter_get(&stats_packets_send_dropped);
+  copy_packets_relayed = (derive_t)shard_counter_get(&stats_packets_relayed);
+
+  pthread_mutex_lock(&receive_pool_lock);
+  copy_receive_pool_size = (gauge_t)receive_pool_size;
+  pthread_mutex_unlock(&receive_pool_lock);
 
   /* Initialize `vl' */
   vl.values = values;
@@ -3184,6 +6435,46 @@ static int network_stats_read(void) /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
+  /* Packets dropped because the receive pool was exhausted */
+  vl.values[0].derive = copy_packets_dropped;
+  sstrncpy(vl.type, "packets", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "receive-dropped", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Packets dropped because a server's send queue was full */
+  vl.values[0].derive = copy_packets_send_dropped;
+  sstrncpy(vl.type_instance, "send-dropped", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Packets sent on by `Relay' */
+  vl.values[0].derive = copy_packets_relayed;
+  sstrncpy(vl.type_instance, "relayed", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Entries allocated by the receive pool */
+  vl.values[0].gauge = copy_receive_pool_size;
+  sstrncpy(vl.type, "objects", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "receive_pool", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  if (peer_accounting) {
+    derive_t copy_packets_shed = 0;
+
+    for (size_t i = 0; i < PEER_PARTITIONS; i++) {
+      pthread_mutex_lock(&peer_partitions[i].lock);
+      copy_packets_shed += peer_partitions[i].packets_shed;
+      pthread_mutex_unlock(&peer_partitions[i].lock);
+    }
+
+    /* Packets shed because of `PeerShedLimitHigh' */
+    vl.values[0].derive = copy_packets_shed;
+    sstrncpy(vl.type, "packets", sizeof(vl.type));
+    sstrncpy(vl.type_instance, "receive-shed", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    network_stats_read_peers();
+  }
+
   return 0;
 } /* }}} int network_stats_read */
 
@@ -3201,21 +6492,65 @@ static int network_init(void) {
 
   plugin_register_shutdown("network", network_shutdown);
 
-  send_buffer = malloc(network_config_packet_size);
-  if (send_buffer == NULL) {
-    ERROR("network plugin: malloc failed.");
+  /* Values are only added to the buffers of servers that exist. */
+  if (network_have_unpooled_servers() &&
+      (send_buffer_create(&send_buffer, /* se = */ NULL) != 0))
+    return -1;
+  for (network_pool_t *pool = server_pools; pool != NULL; pool = pool->next) {
+    if (pool->num == 0)
+      continue;
+    pool->buffers = calloc(pool->num, sizeof(*pool->buffers));
+    if (pool->buffers == NULL) {
+      ERROR("network plugin: calloc failed.");
+      return -1;
+    }
+    for (size_t i = 0; i < pool->num; i++)
+      if (send_buffer_create(pool->buffers + i, pool->sockents[i]) != 0)
+        return -1;
+  }
+  if (network_config_ident_dict && (send_buffer.buffer != NULL) &&
+      (ident_dict_init() != 0))
     return -1;
+
+  if (network_config_shed_low < 0)
+    network_config_shed_low = network_config_shed_high / 2;
+  if (network_config_shed_low > network_config_shed_high) {
+    WARNING("network plugin: `PeerShedLimitLow' is larger than "
+            "`PeerShedLimitHigh'. Using %ld for both.",
+            network_config_shed_high);
+    network_config_shed_low = network_config_shed_high;
+  }
+  if (((listen_sockets != NULL) || (listen_streams != NULL)) &&
+      (network_config_stats || (network_config_shed_high > 0))) {
+    peer_table_init();
+    peer_accounting = true;
   }
-  network_init_buffer();
 
   /* setup socket(s) and so on */
   if (sending_sockets != NULL) {
+    if (network_config_send_threads)
+      send_threads_start();
+
     plugin_register_write("network", network_write,
                           /* user_data = */ NULL);
     plugin_register_notification("network", network_notification,
                                  /* user_data = */ NULL);
   }
 
+  if (network_config_relay)
+    network_relay_init();
+
+#if HAVE_SYS_EPOLL_H
+  if ((listen_streams != NULL) && (stream_thread_start() != 0))
+    return -1;
+#endif
+
+  if ((listen_sockets_num != 0) && (network_config_receive_threads > 0)) {
+    if (receive_threads != NULL)
+      return 0;
+    return receive_threads_start();
+  }
+
   /* If no threads need to be started, return here. */
   if ((listen_sockets_num == 0) ||
       ((dispatch_thread_running != 0) && (receive_thread_running != 0)))
@@ -3230,6 +6565,7 @@ static int network_init(void) {
       ERROR("network: pthread_create failed: %s", STRERRNO);
     } else {
       dispatch_thread_running = 1;
+      network_bind_receive_thread(dispatch_thread_id);
     }
   }
 
@@ -3242,12 +6578,24 @@ static int network_init(void) {
       ERROR("network: pthread_create failed: %s", STRERRNO);
     } else {
       receive_thread_running = 1;
+      network_bind_receive_thread(receive_thread_id);
     }
   }
 
   return 0;
 } /* int network_init */
 
+/* Sends the packet of `sb' unless nothing has been added to it for `timeout'.
+ * Called with `send_buffer_lock' held. */
+static void network_flush_buffer(send_buffer_t *sb, cdtime_t timeout, /* {{{ */
+                                 cdtime_t now) {
+  if (sb->fill <= 0)
+    return;
+  if ((timeout > 0) && ((sb->last_update + timeout) > now))
+    return;
+  flush_buffer(sb);
+} /* }}} void network_flush_buffer */
+
 /*
  * The flush option of the network plugin cannot flush individual identifiers.
  * All the values are added to a buffer and sent when the buffer is full, the
@@ -3258,18 +6606,13 @@ static int network_init(void) {
 static int network_flush(cdtime_t timeout,
                          __attribute__((unused)) const char *identifier,
                          __attribute__((unused)) user_data_t *user_data) {
-  pthread_mutex_lock(&send_buffer_lock);
+  cdtime_t now = cdtime();
 
-  if (send_buffer_fill > 0) {
-    if (timeout > 0) {
-      cdtime_t now = cdtime();
-      if ((send_buffer_last_update + timeout) > now) {
-        pthread_mutex_unlock(&send_buffer_lock);
-        return 0;
-      }
-    }
-    flush_buffer();
-  }
+  pthread_mutex_lock(&send_buffer_lock);
+  network_flush_buffer(&send_buffer, timeout, now);
+  for (network_pool_t *pool = server_pools; pool != NULL; pool = pool->next)
+    for (size_t i = 0; (pool->buffers != NULL) && (i < pool->num); i++)
+      network_flush_buffer(pool->buffers + i, timeout, now);
   pthread_mutex_unlock(&send_buffer_lock);
 
   return 0;
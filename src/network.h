@@ -70,11 +70,23 @@
 #define TYPE_INTERVAL 0x0007
 #define TYPE_INTERVAL_HR 0x0009
 
+/* Types of the identifier dictionary. A sender assigns numbers to the
+ * identifiers it sends within a session (TYPE_IDENT_DEFINE) and refers to
+ * them by number afterwards (TYPE_IDENT_REF). Values following a reference
+ * are sent as TYPE_IDENT_VALUES, which is encoded like TYPE_VALUES, so that
+ * receivers not supporting the dictionary ignore them. */
+#define TYPE_IDENT_SESSION 0x0010
+#define TYPE_IDENT_DEFINE 0x0011
+#define TYPE_IDENT_REF 0x0012
+#define TYPE_IDENT_VALUES 0x0013
+
 /* Types to transmit notifications */
 #define TYPE_MESSAGE 0x0100
 #define TYPE_SEVERITY 0x0101
 
 #define TYPE_SIGN_SHA256 0x0200
 #define TYPE_ENCR_AES256 0x0210
+#define TYPE_ENCR_AES256_GCM 0x0211
+#define TYPE_COMPRESSED_DEFLATE 0x0220
 
 #endif /* NETWORK_H */
@@ -30,6 +30,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
 
 #include <curl/curl.h>
 
@@ -42,13 +43,15 @@ static char *cacert;
 static char *timeout;
 
 static CURL *curl;
+static curl_stats_t *stats;
 
 static char nginx_buffer[16384];
 static size_t nginx_buffer_len;
 static char nginx_curl_error[CURL_ERROR_SIZE];
 
 static const char *config_keys[] = {
-    "URL", "User", "Password", "VerifyPeer", "VerifyHost", "CACert", "Timeout"};
+    "URL",        "User",   "Password", "VerifyPeer",
+    "VerifyHost", "CACert", "Timeout",  "LatencyPercentile"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static size_t nginx_curl_callback(void *buf, size_t size, size_t nmemb,
@@ -98,7 +101,15 @@ static int config(const char *key, const char *value) {
     return config_set(&cacert, value);
   else if (strcasecmp(key, "timeout") == 0)
     return config_set(&timeout, value);
-  else
+  else if (strcasecmp(key, "latencypercentile") == 0) {
+    char *endptr = NULL;
+    double percent = strtod(value, &endptr);
+    if ((endptr == value) || (*endptr != 0)) {
+      ERROR("nginx plugin: Invalid LatencyPercentile: %s", value);
+      return -1;
+    }
+    return curl_stats_add_percentile(&stats, percent);
+  } else
     return -1;
 } /* int config */
 
@@ -206,7 +217,9 @@ static int nginx_read(void) {
 
   curl_easy_setopt(curl, CURLOPT_URL, url);
 
-  if (curl_easy_perform(curl) != CURLE_OK) {
+  CURLcode status = curl_easy_perform(curl);
+  curl_stats_dispatch(stats, curl, NULL, "nginx", NULL);
+  if (status != CURLE_OK) {
     WARNING("nginx plugin: curl_easy_perform failed: %s", nginx_curl_error);
     return -1;
   }
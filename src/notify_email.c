@@ -31,6 +31,8 @@
 #include <libesmtp.h>
 
 #define MAXSTRING 256
+/* Space for the description of one notification in a message. */
+#define NOTIFY_EMAIL_PART_SIZE 4096
 
 static const char *config_keys[] = {"SMTPServer",   "SMTPPort", "SMTPUser",
                                     "SMTPPassword", "From",     "Recipient",
@@ -200,47 +202,31 @@ static int notify_email_config(const char *key, const char *value) {
   return 0;
 } /* int notify_email_config (const char *, const char *) */
 
-static int notify_email_notification(const notification_t *n,
-                                     user_data_t __attribute__((unused)) *
-                                         user_data) {
-
+static char const *notify_email_severity(int severity) {
+  if (severity == NOTIF_FAILURE)
+    return "FAILURE";
+  if (severity == NOTIF_WARNING)
+    return "WARNING";
+  if (severity == NOTIF_OKAY)
+    return "OKAY";
+  return "UNKNOWN";
+} /* char const *notify_email_severity */
+
+/* Writes the description of `n' to `buf' and returns its length. */
+static size_t notify_email_format(char *buf, size_t buf_size,
+                                  notification_t const *n) {
   struct tm timestamp_tm;
   char timestamp_str[64];
 
-  char severity[32];
-  char subject[MAXSTRING];
-
-  char buf[4096] = "";
-  char *buf_ptr = buf;
-  int buf_len = sizeof(buf);
-
-  snprintf(severity, sizeof(severity), "%s",
-           (n->severity == NOTIF_FAILURE)
-               ? "FAILURE"
-               : ((n->severity == NOTIF_WARNING)
-                      ? "WARNING"
-                      : ((n->severity == NOTIF_OKAY) ? "OKAY" : "UNKNOWN")));
-
-  snprintf(subject, sizeof(subject),
-           (email_subject == NULL) ? DEFAULT_SMTP_SUBJECT : email_subject,
-           severity, n->host);
-
   localtime_r(&CDTIME_T_TO_TIME_T(n->time), &timestamp_tm);
   strftime(timestamp_str, sizeof(timestamp_str), "%Y-%m-%d %H:%M:%S",
            &timestamp_tm);
   timestamp_str[sizeof(timestamp_str) - 1] = '\0';
 
-  /* Let's make RFC822 message text with \r\n EOLs */
-  int status = snprintf(buf, buf_len,
-                        "MIME-Version: 1.0\r\n"
-                        "Content-Type: text/plain; charset=\"US-ASCII\"\r\n"
-                        "Content-Transfer-Encoding: 8bit\r\n"
-                        "Subject: %s\r\n"
-                        "\r\n"
-                        "%s - %s@%s\r\n"
-                        "\r\n",
-                        subject, timestamp_str, severity, n->host);
-
+  char *buf_ptr = buf;
+  int buf_len = (int)buf_size;
+  int status = snprintf(buf_ptr, buf_len, "%s - %s@%s\r\n\r\n", timestamp_str,
+                        notify_email_severity(n->severity), n->host);
   if (status > 0) {
     buf_ptr += status;
     buf_len -= status;
@@ -261,18 +247,77 @@ static int notify_email_notification(const notification_t *n,
   APPEND("Type: %s", n->type);
   APPEND("Type instance: %s", n->type_instance);
   APPEND("\r\nMessage: %s", n->message);
+#undef APPEND
+
+  if (buf_len <= 0)
+    return buf_size - 1;
+  return (size_t)(buf_ptr - buf);
+} /* size_t notify_email_format */
+
+/* Sends one message for all notifications of the batch. The subject names the
+ * most severe of them. */
+static int notify_email_notification(notification_t const *const *n,
+                                     size_t num,
+                                     user_data_t __attribute__((unused)) *
+                                         user_data) {
+  int severity = n[0]->severity;
+  char const *host = n[0]->host;
+  for (size_t i = 1; i < num; i++) {
+    if (n[i]->severity < severity)
+      severity = n[i]->severity;
+    if (strcmp(n[i]->host, host) != 0)
+      host = "several hosts";
+  }
+
+  char subject[MAXSTRING];
+  snprintf(subject, sizeof(subject),
+           (email_subject == NULL) ? DEFAULT_SMTP_SUBJECT : email_subject,
+           notify_email_severity(severity), host);
+  if (num > 1) {
+    size_t len = strlen(subject);
+    snprintf(subject + len, sizeof(subject) - len, " (%" PRIsz
+             " notifications)",
+             num);
+  }
+
+  /* The headers, and every part with the blank lines separating it. */
+  size_t buf_size = 1024 + num * (NOTIFY_EMAIL_PART_SIZE + 4);
+  char *buf = malloc(buf_size);
+  if (buf == NULL) {
+    ERROR("notify_email plugin: malloc failed.");
+    return -1;
+  }
+
+  /* Let's make RFC822 message text with \r\n EOLs */
+  int status = snprintf(buf, buf_size,
+                        "MIME-Version: 1.0\r\n"
+                        "Content-Type: text/plain; charset=\"US-ASCII\"\r\n"
+                        "Content-Transfer-Encoding: 8bit\r\n"
+                        "Subject: %s\r\n"
+                        "\r\n",
+                        subject);
+  size_t buf_len = (status > 0) ? (size_t)status : 0;
+  for (size_t i = 0; i < num; i++) {
+    if (i > 0) {
+      memcpy(buf + buf_len, "\r\n\r\n", 4);
+      buf_len += 4;
+    }
+    buf_len += notify_email_format(buf + buf_len, NOTIFY_EMAIL_PART_SIZE, n[i]);
+  }
 
   pthread_mutex_lock(&session_lock);
 
   if (session == NULL) {
     /* Initialization failed or we're in the process of shutting down. */
     pthread_mutex_unlock(&session_lock);
+    sfree(buf);
     return -1;
   }
 
   if (!(message = smtp_add_message(session))) {
     pthread_mutex_unlock(&session_lock);
     ERROR("notify_email plugin: cannot set SMTP message");
+    sfree(buf);
     return -1;
   }
   smtp_set_reverse_path(message, email_from);
@@ -284,9 +329,11 @@ static int notify_email_notification(const notification_t *n,
 
   /* Initiate a connection to the SMTP server and transfer the message. */
   if (!smtp_start_session(session)) {
+    char errbuf[MAXSTRING];
     ERROR("notify_email plugin: SMTP server problem: %s",
-          smtp_strerror(smtp_errno(), buf, sizeof buf));
+          smtp_strerror(smtp_errno(), errbuf, sizeof(errbuf)));
     pthread_mutex_unlock(&session_lock);
+    sfree(buf);
     return -1;
   } else {
 #if COLLECT_DEBUG
@@ -300,6 +347,7 @@ static int notify_email_notification(const notification_t *n,
   }
 
   pthread_mutex_unlock(&session_lock);
+  sfree(buf);
   return 0;
 } /* int notify_email_notification */
 
@@ -308,6 +356,6 @@ void module_register(void) {
   plugin_register_shutdown("notify_email", notify_email_shutdown);
   plugin_register_config("notify_email", notify_email_config, config_keys,
                          config_keys_num);
-  plugin_register_notification("notify_email", notify_email_notification,
-                               /* user_data = */ NULL);
+  plugin_register_notification_batch("notify_email", notify_email_notification,
+                                     /* user_data = */ NULL);
 } /* void module_register (void) */
@@ -34,6 +34,9 @@
 #define NAGIOS_CRITICAL 2
 #define NAGIOS_UNKNOWN 3
 
+/* Space for the external command of one notification. */
+#define NAGIOS_COMMAND_SIZE 4096
+
 #ifndef NAGIOS_COMMAND_FILE
 #define NAGIOS_COMMAND_FILE "/usr/local/nagios/var/rw/nagios.cmd"
 #endif
@@ -105,10 +108,10 @@ static int nagios_print(char const *buffer) /* {{{ */
   return status;
 } /* }}} int nagios_print */
 
-static int nagios_notify(const notification_t *n, /* {{{ */
-                         __attribute__((unused)) user_data_t *user_data) {
+/* Writes the external command for `n' to `buffer'. */
+static int nagios_format(char *buffer, size_t buffer_size, /* {{{ */
+                         notification_t const *n) {
   char svc_description[4 * DATA_MAX_NAME_LEN];
-  char buffer[4096];
   int code;
   int status;
 
@@ -135,15 +138,41 @@ static int nagios_notify(const notification_t *n, /* {{{ */
     break;
   }
 
-  snprintf(buffer, sizeof(buffer),
+  snprintf(buffer, buffer_size,
            "[%.0f] PROCESS_SERVICE_CHECK_RESULT;%s;%s;%d;%s\n",
            CDTIME_T_TO_DOUBLE(n->time), n->host, &svc_description[1], code,
            n->message);
 
-  return nagios_print(buffer);
+  return 0;
+} /* }}} int nagios_format */
+
+/* Writes the commands for all notifications of the batch at once, so that the
+ * command file is opened only once. */
+static int nagios_notify(notification_t const *const *n, size_t num, /* {{{ */
+                         __attribute__((unused)) user_data_t *user_data) {
+  char *buffer = malloc(num * NAGIOS_COMMAND_SIZE);
+  if (buffer == NULL) {
+    ERROR("notify_nagios plugin: malloc failed.");
+    return ENOMEM;
+  }
+
+  size_t len = 0;
+  int status = 0;
+  buffer[0] = 0;
+  for (size_t i = 0; i < num; i++) {
+    status = nagios_format(buffer + len, NAGIOS_COMMAND_SIZE, n[i]);
+    if (status == 0)
+      len += strlen(buffer + len);
+  }
+
+  if (len > 0)
+    status = nagios_print(buffer);
+
+  sfree(buffer);
+  return status;
 } /* }}} int nagios_notify */
 
 void module_register(void) {
   plugin_register_complex_config("notify_nagios", nagios_config);
-  plugin_register_notification("notify_nagios", nagios_notify, NULL);
+  plugin_register_notification_batch("notify_nagios", nagios_notify, NULL);
 } /* void module_register (void) */
@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/sysfs/sysfs.h"
 
 #if !KERNEL_LINUX
 #error "No applicable input method."
@@ -37,8 +38,15 @@
 #define NUMA_ROOT_DIR "/sys/devices/system/node"
 #endif
 
+#define NUMA_DEVPATH "/devices/system/node"
+
 static int max_node = -1;
 
+/* The "numastat" files of the nodes; the file of node "i" is at index "i". */
+static sysfs_set_t *set;
+/* Tells when nodes have been added or removed. */
+static sysfs_monitor_t *monitor;
+
 static void numa_dispatch_value(int node, /* {{{ */
                                 const char *type_instance, value_t v) {
   value_list_t vl = VALUE_LIST_INIT;
@@ -56,27 +64,25 @@ static void numa_dispatch_value(int node, /* {{{ */
 
 static int numa_read_node(int node) /* {{{ */
 {
-  char path[PATH_MAX];
-  FILE *fh;
-  char buffer[128];
   int status;
   int success;
 
-  snprintf(path, sizeof(path), NUMA_ROOT_DIR "/node%i/numastat", node);
-
-  fh = fopen(path, "r");
-  if (fh == NULL) {
-    ERROR("numa plugin: Reading node %i failed: open(%s): %s", node, path,
-          STRERRNO);
+  char *content = sysfs_set_content(set, node);
+  if (content == NULL) {
+    ERROR("numa plugin: Reading node %i failed: read(" NUMA_ROOT_DIR
+          "/node%i/numastat) failed.",
+          node, node);
     return -1;
   }
 
   success = 0;
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  char *saveptr = NULL;
+  for (char *line = strtok_r(content, "\n", &saveptr); line != NULL;
+       line = strtok_r(NULL, "\n", &saveptr)) {
     char *fields[4];
     value_t v;
 
-    status = strsplit(buffer, fields, STATIC_ARRAY_SIZE(fields));
+    status = strsplit(line, fields, STATIC_ARRAY_SIZE(fields));
     if (status != 2) {
       WARNING("numa plugin: Ignoring line with unexpected "
               "number of fields (node %i).",
@@ -93,21 +99,56 @@ static int numa_read_node(int node) /* {{{ */
     success++;
   }
 
-  fclose(fh);
   return success ? 0 : -1;
 } /* }}} int numa_read_node */
 
+/* Determines the number of nodes on this machine and opens their files. */
+static int numa_scan(void) /* {{{ */
+{
+  sysfs_set_clear(set);
+  max_node = -1;
+
+  while (42) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "node%i/numastat", max_node + 1);
+
+    if (sysfs_set_add(set, path) >= 0) {
+      max_node++;
+      continue;
+    } else if (errno == ENOENT) {
+      break;
+    } else {
+      ERROR("numa plugin: open(" NUMA_ROOT_DIR "/%s) failed: %s", path,
+            STRERRNO);
+      return -1;
+    }
+  }
+
+  DEBUG("numa plugin: Found %i nodes.", max_node + 1);
+  return 0;
+} /* }}} int numa_scan */
+
 static int numa_read(void) /* {{{ */
 {
   int i;
   int status;
   int success;
 
+  if (sysfs_monitor_changed(monitor))
+    numa_scan();
+
   if (max_node < 0) {
     WARNING("numa plugin: No NUMA nodes were detected.");
     return -1;
   }
 
+  /* Without uevents, a node that went away is noticed by its file failing. */
+  if ((sysfs_set_read(set) > 0) && (monitor == NULL)) {
+    numa_scan();
+    sysfs_set_read(set);
+  }
+
   success = 0;
   for (i = 0; i <= max_node; i++) {
     status = numa_read_node(i);
@@ -120,32 +161,33 @@ static int numa_read(void) /* {{{ */
 
 static int numa_init(void) /* {{{ */
 {
-  /* Determine the number of nodes on this machine. */
-  while (42) {
-    char path[PATH_MAX];
-    struct stat statbuf = {0};
-    int status;
+  set = sysfs_set_create(NUMA_ROOT_DIR);
+  if (set == NULL) {
+    ERROR("numa plugin: open(" NUMA_ROOT_DIR ") failed: %s", STRERRNO);
+    return -1;
+  }
 
-    snprintf(path, sizeof(path), NUMA_ROOT_DIR "/node%i", max_node + 1);
+  monitor = sysfs_monitor_open(NUMA_DEVPATH);
+  if (monitor == NULL)
+    NOTICE("numa plugin: Receiving uevents failed: %s. Nodes will only be "
+           "looked for again when reading one fails.",
+           STRERRNO);
 
-    status = stat(path, &statbuf);
-    if (status == 0) {
-      max_node++;
-      continue;
-    } else if (errno == ENOENT) {
-      break;
-    } else /* ((status != 0) && (errno != ENOENT)) */
-    {
-      ERROR("numa plugin: stat(%s) failed: %s", path, STRERRNO);
-      return -1;
-    }
-  }
+  return numa_scan();
+} /* }}} int numa_init */
 
-  DEBUG("numa plugin: Found %i nodes.", max_node + 1);
+static int numa_shutdown(void) /* {{{ */
+{
+  sysfs_monitor_close(monitor);
+  monitor = NULL;
+  sysfs_set_destroy(set);
+  set = NULL;
+  max_node = -1;
   return 0;
-} /* }}} int numa_init */
+} /* }}} int numa_shutdown */
 
 void module_register(void) {
   plugin_register_init("numa", numa_init);
   plugin_register_read("numa", numa_read);
+  plugin_register_shutdown("numa", numa_shutdown);
 } /* void module_register */
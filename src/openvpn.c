@@ -29,8 +29,13 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 /**
  * There is two main kinds of OpenVPN status file:
  * - for 'single' mode (point-to-point or client mode)
@@ -65,6 +70,11 @@
  *
  * Current Collectd code tries to handle changes in this field set,
  * if they are backward-compatible.
+ *
+ * The management interface answers "status 3" with a version 3 status (or
+ * the 'single' format in client mode), terminated by an "END" line. Lines are
+ * terminated by CRLF and may be interleaved with real-time notifications,
+ * which start with '>'.
  **/
 
 #define TITLE_SINGLE "OpenVPN STATISTICS\n"
@@ -74,9 +84,33 @@
 #define V1HEADER                                                               \
   "Common Name,Real Address,Bytes Received,Bytes Sent,Connected Since\n"
 
+/* Traffic of a client as of the last read, by common name. */
+struct vpn_client_s {
+  char *name;
+  derive_t rx;
+  derive_t tx;
+};
+typedef struct vpn_client_s vpn_client_t;
+
 struct vpn_status_s {
+  /* The status file or, if "mgmt_node" is set, the management socket as
+   * configured. */
   char *file;
   char *name;
+
+  /* The management interface: a UNIX socket if "mgmt_service" is NULL. The
+   * connection is kept open between reads. */
+  char *mgmt_node;
+  char *mgmt_service;
+  int mgmt_fd;
+  FILE *mgmt_fh;
+  /* Set once the "END" line of a response has been read. */
+  bool mgmt_end;
+
+  /* Used by SkipUnchanged: the clients as of the last read and the ones seen
+   * by the current read. */
+  c_avl_tree_t *clients;
+  c_avl_tree_t *seen;
 };
 typedef struct vpn_status_s vpn_status_t;
 
@@ -84,11 +118,13 @@ static bool new_naming_schema;
 static bool collect_compression = true;
 static bool collect_user_count;
 static bool collect_individual_users = true;
+static bool skip_unchanged;
 
 static const char *config_keys[] = {
     "StatusFile",           "Compression", /* old, deprecated name */
     "ImprovedNamingSchema", "CollectCompression",
-    "CollectUserCount",     "CollectIndividualUsers"};
+    "CollectUserCount",     "CollectIndividualUsers",
+    "ManagementSocket",     "SkipUnchanged"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /* Helper function
@@ -109,13 +145,69 @@ static int openvpn_strsplit(char *string, char **fields, size_t size) {
   return i;
 } /* int openvpn_strsplit */
 
+static void openvpn_clients_destroy(c_avl_tree_t *clients) {
+  void *key;
+  vpn_client_t *c;
+
+  if (clients == NULL)
+    return;
+
+  while (c_avl_pick(clients, &key, (void *)&c) == 0) {
+    sfree(c->name);
+    sfree(c);
+  }
+  c_avl_destroy(clients);
+} /* void openvpn_clients_destroy */
+
+static void mgmt_disconnect(vpn_status_t *st) {
+  if (st->mgmt_fh != NULL)
+    fclose(st->mgmt_fh); /* closes mgmt_fd, too */
+  else if (st->mgmt_fd >= 0)
+    close(st->mgmt_fd);
+  st->mgmt_fh = NULL;
+  st->mgmt_fd = -1;
+} /* void mgmt_disconnect */
+
 static void openvpn_free(void *arg) {
   vpn_status_t *st = arg;
 
+  mgmt_disconnect(st);
+  openvpn_clients_destroy(st->clients);
+  openvpn_clients_destroy(st->seen);
+  sfree(st->mgmt_node);
+  sfree(st->mgmt_service);
   sfree(st->file);
   sfree(st);
 } /* void openvpn_free */
 
+/* Reads a line of the status. From the management interface, CRLF is turned
+ * into LF, notifications are skipped and the "END" line ends the status. */
+static char *openvpn_gets(vpn_status_t *st, char *buffer, int size,
+                          FILE *fh) {
+  if (st->mgmt_node == NULL)
+    return fgets(buffer, size, fh);
+
+  while (!st->mgmt_end && (fgets(buffer, size, fh) != NULL)) {
+    size_t len = strlen(buffer);
+    if ((len >= 2) && (buffer[len - 2] == '\r') && (buffer[len - 1] == '\n')) {
+      buffer[len - 2] = '\n';
+      buffer[len - 1] = 0;
+    }
+
+    if (buffer[0] == '>')
+      continue;
+
+    if (strcmp(buffer, "END\n") == 0) {
+      st->mgmt_end = true;
+      break;
+    }
+
+    return buffer;
+  }
+
+  return NULL;
+} /* char *openvpn_gets */
+
 /* dispatches number of users */
 static void numusers_submit(const char *pinst, const char *tinst,
                             gauge_t value) {
@@ -160,6 +252,47 @@ static void iostats_submit(const char *pinst, const char *tinst, derive_t rx,
   plugin_dispatch_values(&vl);
 } /* void traffic_submit */
 
+/* dispatches the traffic of a client in multimode, unless SkipUnchanged is
+ * enabled and it did not change since the last read */
+static void client_submit(vpn_status_t *st, const char *cname, derive_t rx,
+                          derive_t tx) {
+  if (skip_unchanged && (st->seen != NULL)) {
+    vpn_client_t *c = NULL;
+    char *key = NULL;
+    bool changed = true;
+
+    if (c_avl_remove(st->clients, cname, (void *)&key, (void *)&c) == 0) {
+      changed = (c->rx != rx) || (c->tx != tx);
+    } else if (c_avl_get(st->seen, cname, (void *)&c) == 0) {
+      /* Seen before in this read, e.g. with "duplicate-cn". */
+      c->rx = rx;
+      c->tx = tx;
+      c = NULL;
+    } else {
+      c = calloc(1, sizeof(*c));
+      if ((c != NULL) && ((c->name = strdup(cname)) == NULL))
+        sfree(c);
+    }
+
+    if (c != NULL) {
+      c->rx = rx;
+      c->tx = tx;
+      if (c_avl_insert(st->seen, c->name, c) != 0) {
+        sfree(c->name);
+        sfree(c);
+      }
+    }
+
+    if (!changed)
+      return;
+  }
+
+  if (new_naming_schema)
+    iostats_submit(st->name, cname, rx, tx);
+  else
+    iostats_submit(cname, NULL, rx, tx);
+} /* void client_submit */
+
 /* dispatches stats about data compression shown when in single mode */
 static void compression_submit(const char *pinst, const char *tinst,
                                derive_t uncompressed, derive_t compressed) {
@@ -180,7 +313,8 @@ static void compression_submit(const char *pinst, const char *tinst,
   plugin_dispatch_values(&vl);
 } /* void compression_submit */
 
-static int single_read(const char *name, FILE *fh) {
+static int single_read(vpn_status_t *st, FILE *fh) {
+  const char *name = st->name;
   char buffer[1024];
   char *fields[4];
   const int max_fields = STATIC_ARRAY_SIZE(fields);
@@ -190,7 +324,7 @@ static int single_read(const char *name, FILE *fh) {
   derive_t pre_compress = 0, post_compress = 0;
   derive_t pre_decompress = 0, post_decompress = 0;
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while (openvpn_gets(st, buffer, sizeof(buffer), fh) != NULL) {
     int fields_num = openvpn_strsplit(buffer, fields, max_fields);
 
     /* status file is generated by openvpn/sig.c:print_status()
@@ -242,7 +376,8 @@ static int single_read(const char *name, FILE *fh) {
 } /* int single_read */
 
 /* for reading status version 1 */
-static int multi1_read(const char *name, FILE *fh) {
+static int multi1_read(vpn_status_t *st, FILE *fh) {
+  const char *name = st->name;
   char buffer[1024];
   char *fields[10];
   const int max_fields = STATIC_ARRAY_SIZE(fields);
@@ -251,7 +386,7 @@ static int multi1_read(const char *name, FILE *fh) {
 
   /* read the file until the "ROUTING TABLE" line is found (no more info after)
    */
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while (openvpn_gets(st, buffer, sizeof(buffer), fh) != NULL) {
     if (strcmp(buffer, "ROUTING TABLE\n") == 0)
       break;
 
@@ -274,19 +409,10 @@ static int multi1_read(const char *name, FILE *fh) {
     {
       sum_users += 1;
     }
-    if (collect_individual_users) {
-      if (new_naming_schema) {
-        iostats_submit(name,              /* vpn instance */
-                       fields[0],         /* "Common Name" */
-                       atoll(fields[2]),  /* "Bytes Received" */
-                       atoll(fields[3])); /* "Bytes Sent" */
-      } else {
-        iostats_submit(fields[0],         /* "Common Name" */
-                       NULL,              /* unused when in multimode */
-                       atoll(fields[2]),  /* "Bytes Received" */
-                       atoll(fields[3])); /* "Bytes Sent" */
-      }
-    }
+    if (collect_individual_users)
+      client_submit(st, fields[0],      /* "Common Name" */
+                    atoll(fields[2]),   /* "Bytes Received" */
+                    atoll(fields[3]));  /* "Bytes Sent" */
   }
 
   if (ferror(fh))
@@ -311,7 +437,8 @@ static int multi1_read(const char *name, FILE *fh) {
  * status file is generated by openvpn/multi.c:multi_print_status()
  * http://svn.openvpn.net/projects/openvpn/trunk/openvpn/multi.c
  */
-static int multi2_read(const char *name, FILE *fh) {
+static int multi2_read(vpn_status_t *st, FILE *fh) {
+  const char *name = st->name;
   char buffer[1024];
   /* OpenVPN-2.4 has 11 fields of data + 2 fields for "HEADER" and "CLIENT_LIST"
    * So, set array size to 20 elements, to support future extensions.
@@ -326,7 +453,7 @@ static int multi2_read(const char *name, FILE *fh) {
   int idx_bytes_sent = 0;
   int columns = 0;
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while (openvpn_gets(st, buffer, sizeof(buffer), fh) != NULL) {
     int fields_num = openvpn_strsplit(buffer, fields, max_fields);
 
     /* Try to find section header */
@@ -384,21 +511,10 @@ static int multi2_read(const char *name, FILE *fh) {
     if (collect_user_count)
       sum_users += 1;
 
-    if (collect_individual_users) {
-      if (new_naming_schema) {
-        /* plugin inst = file name, type inst = fields[1] */
-        iostats_submit(name,                           /* vpn instance     */
-                       fields[idx_cname],              /* "Common Name"    */
-                       atoll(fields[idx_bytes_recv]),  /* "Bytes Received" */
-                       atoll(fields[idx_bytes_sent])); /* "Bytes Sent"     */
-      } else {
-        /* plugin inst = fields[idx_cname], type inst = "" */
-        iostats_submit(fields[idx_cname], /*              "Common Name"    */
-                       NULL,              /* unused when in multimode      */
-                       atoll(fields[idx_bytes_recv]),  /* "Bytes Received" */
-                       atoll(fields[idx_bytes_sent])); /* "Bytes Sent"     */
-      }
-    }
+    if (collect_individual_users)
+      client_submit(st, fields[idx_cname],           /* "Common Name"    */
+                    atoll(fields[idx_bytes_recv]),   /* "Bytes Received" */
+                    atoll(fields[idx_bytes_sent]));  /* "Bytes Sent"     */
   }
 
   if (ferror(fh))
@@ -420,36 +536,38 @@ static int multi2_read(const char *name, FILE *fh) {
   return 0;
 } /* int multi2_read */
 
-/* read callback */
-static int openvpn_read(user_data_t *user_data) {
+/* detects the format by the first line and reads the rest of the status */
+static int openvpn_read_status(vpn_status_t *st, FILE *fh) {
   char buffer[1024];
   int read = 0;
 
-  vpn_status_t *st = user_data->data;
-
-  FILE *fh = fopen(st->file, "r");
-  if (fh == NULL) {
-    WARNING("openvpn plugin: fopen(%s) failed: %s", st->file, STRERRNO);
-
-    return -1;
-  }
-
   // Try to detect file format by its first line
-  if ((fgets(buffer, sizeof(buffer), fh)) == NULL) {
+  if (openvpn_gets(st, buffer, sizeof(buffer), fh) == NULL) {
     WARNING("openvpn plugin: failed to get data from: %s", st->file);
-    fclose(fh);
     return -1;
   }
 
+  if (skip_unchanged && collect_individual_users) {
+    if (st->clients == NULL)
+      st->clients = c_avl_create((int (*)(const void *, const void *))strcmp);
+    st->seen = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if ((st->clients == NULL) || (st->seen == NULL)) {
+      ERROR("openvpn plugin: c_avl_create failed.");
+      /* Without the state, all clients are dispatched. */
+      c_avl_destroy(st->seen);
+      st->seen = NULL;
+    }
+  }
+
   if (strcmp(buffer, TITLE_SINGLE) == 0) { // OpenVPN STATISTICS
     DEBUG("openvpn plugin: found status file SINGLE");
-    read = single_read(st->name, fh);
+    read = single_read(st, fh);
   } else if (strcmp(buffer, TITLE_V1) == 0) { // OpenVPN CLIENT LIST
     DEBUG("openvpn plugin: found status file MULTI version 1");
-    read = multi1_read(st->name, fh);
+    read = multi1_read(st, fh);
   } else if (strncmp(buffer, TITLE_V2, strlen(TITLE_V2)) == 0) { // TITLE
     DEBUG("openvpn plugin: found status file MULTI version 2/3");
-    read = multi2_read(st->name, fh);
+    read = multi2_read(st, fh);
   } else {
     NOTICE("openvpn plugin: %s: Unknown file format, please "
            "report this as bug. Make sure to include "
@@ -458,12 +576,129 @@ static int openvpn_read(user_data_t *user_data) {
            st->file);
     read = -1;
   }
+
+  /* Clients left over have disconnected. If the read failed, the clients
+   * not read are dispatched next time as if they were new. */
+  if (st->seen != NULL) {
+    openvpn_clients_destroy(st->clients);
+    st->clients = st->seen;
+    st->seen = NULL;
+  }
+
+  return read;
+} /* int openvpn_read_status */
+
+static int mgmt_connect(vpn_status_t *st) {
+  if (st->mgmt_service == NULL) {
+    struct sockaddr_un sa = {.sun_family = AF_UNIX};
+    sstrncpy(sa.sun_path, st->mgmt_node, sizeof(sa.sun_path));
+
+    st->mgmt_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (st->mgmt_fd < 0) {
+      ERROR("openvpn plugin: socket failed: %s", STRERRNO);
+      return -1;
+    }
+    if (connect(st->mgmt_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+      WARNING("openvpn plugin: connect(%s) failed: %s", st->file, STRERRNO);
+      mgmt_disconnect(st);
+      return -1;
+    }
+  } else {
+    struct addrinfo *ai_list;
+    struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
+                                .ai_socktype = SOCK_STREAM};
+
+    int status =
+        getaddrinfo(st->mgmt_node, st->mgmt_service, &ai_hints, &ai_list);
+    if (status != 0) {
+      WARNING("openvpn plugin: getaddrinfo(%s) failed: %s", st->file,
+              gai_strerror(status));
+      return -1;
+    }
+
+    for (struct addrinfo *ai = ai_list; ai != NULL; ai = ai->ai_next) {
+      st->mgmt_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (st->mgmt_fd < 0)
+        continue;
+      if (connect(st->mgmt_fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        break;
+      mgmt_disconnect(st);
+    }
+    freeaddrinfo(ai_list);
+
+    if (st->mgmt_fd < 0) {
+      WARNING("openvpn plugin: Connecting to %s failed.", st->file);
+      return -1;
+    }
+  }
+
+  /* A stalled OpenVPN must not block the read thread for long. */
+  struct timeval tv = CDTIME_T_TO_TIMEVAL(plugin_get_interval());
+  setsockopt(st->mgmt_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  st->mgmt_fh = fdopen(st->mgmt_fd, "r");
+  if (st->mgmt_fh == NULL) {
+    ERROR("openvpn plugin: fdopen failed: %s", STRERRNO);
+    mgmt_disconnect(st);
+    return -1;
+  }
+
+  return 0;
+} /* int mgmt_connect */
+
+static int mgmt_read(vpn_status_t *st) {
+  static const char command[] = "status 3\n";
+
+  if ((st->mgmt_fh == NULL) && (mgmt_connect(st) != 0))
+    return -1;
+
+  if (send(st->mgmt_fd, command, strlen(command), MSG_NOSIGNAL) < 0) {
+    WARNING("openvpn plugin: Sending to %s failed: %s", st->file, STRERRNO);
+    mgmt_disconnect(st);
+    return -1;
+  }
+
+  st->mgmt_end = false;
+  int status = openvpn_read_status(st, st->mgmt_fh);
+
+  /* The parsers stop after the client list; the rest of the response is
+   * skipped so that the next one starts at its first line. */
+  char buffer[1024];
+  while (openvpn_gets(st, buffer, sizeof(buffer), st->mgmt_fh) != NULL)
+    /* do nothing */;
+
+  if (!st->mgmt_end) {
+    WARNING("openvpn plugin: Reading from %s failed.", st->file);
+    mgmt_disconnect(st);
+    return -1;
+  }
+
+  return status;
+} /* int mgmt_read */
+
+/* read callback */
+static int openvpn_read(user_data_t *user_data) {
+  vpn_status_t *st = user_data->data;
+
+  if (st->mgmt_node != NULL)
+    return mgmt_read(st);
+
+  FILE *fh = fopen(st->file, "r");
+  if (fh == NULL) {
+    WARNING("openvpn plugin: fopen(%s) failed: %s", st->file, STRERRNO);
+
+    return -1;
+  }
+
+  int read = openvpn_read_status(st, fh);
   fclose(fh);
   return read;
 } /* int openvpn_read */
 
 static int openvpn_config(const char *key, const char *value) {
-  if (strcasecmp("StatusFile", key) == 0) {
+  if ((strcasecmp("StatusFile", key) == 0) ||
+      (strcasecmp("ManagementSocket", key) == 0)) {
+    bool management = (strcasecmp("ManagementSocket", key) == 0);
     char callback_name[3 * DATA_MAX_NAME_LEN];
     char *status_name;
 
@@ -493,6 +728,41 @@ static int openvpn_config(const char *key, const char *value) {
     }
     instance->file = status_file;
     instance->name = status_name;
+    instance->mgmt_fd = -1;
+
+    if (management) {
+      /* Either a UNIX socket or "host:port", the host possibly in brackets.
+       */
+      char *port = (value[0] == '/') ? NULL : strrchr(value, ':');
+      if ((value[0] != '/') && ((port == NULL) || (port[1] == 0))) {
+        ERROR("openvpn plugin: ManagementSocket \"%s\": Expected a path or "
+              "\"host:port\".",
+              value);
+        openvpn_free(instance);
+        return 1;
+      }
+
+      if (port == NULL) {
+        instance->mgmt_node = strdup(value);
+      } else {
+        char const *host = value;
+        size_t host_len = port - value;
+        if ((host_len >= 2) && (host[0] == '[') &&
+            (host[host_len - 1] == ']')) {
+          host++;
+          host_len -= 2;
+        }
+        instance->mgmt_node = strndup(host, host_len);
+        instance->mgmt_service = strdup(port + 1);
+      }
+
+      if ((instance->mgmt_node == NULL) ||
+          ((port != NULL) && (instance->mgmt_service == NULL))) {
+        ERROR("openvpn plugin: strdup failed.");
+        openvpn_free(instance);
+        return 1;
+      }
+    }
 
     snprintf(callback_name, sizeof(callback_name), "openvpn/%s", status_name);
 
@@ -537,6 +807,9 @@ static int openvpn_config(const char *key, const char *value) {
     else
       collect_user_count = false;
   } /* if (strcasecmp("CollectUserCount", key) == 0) */
+  else if (strcasecmp("SkipUnchanged", key) == 0) {
+    skip_unchanged = IS_TRUE(value);
+  } /* if (strcasecmp("SkipUnchanged", key) == 0) */
   else if (strcasecmp("CollectIndividualUsers", key) == 0) {
     if (IS_FALSE(value))
       collect_individual_users = false;
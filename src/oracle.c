@@ -63,6 +63,10 @@ struct o_database_s {
   char *username;
   char *password;
   char *plugin_name;
+  /* Number of rows fetched with one OCIStmtFetch2 call and number of rows
+   * prefetched by OCI with each round trip. */
+  int fetch_rows;
+  int prefetch_rows;
 
   udb_query_preparation_area_t **q_prep_areas;
   udb_query_t **queries;
@@ -72,6 +76,8 @@ struct o_database_s {
 };
 typedef struct o_database_s o_database_t;
 
+#define O_FETCH_ROWS_DEFAULT 128
+
 /*
  * Global variables
  */
@@ -195,6 +201,8 @@ static int o_config_add_database(oconfig_item_t *ci) /* {{{ */
   db->username = NULL;
   db->password = NULL;
   db->plugin_name = NULL;
+  db->fetch_rows = O_FETCH_ROWS_DEFAULT;
+  db->prefetch_rows = -1;
 
   status = cf_util_get_string(ci, &db->name);
   if (status != 0) {
@@ -216,6 +224,10 @@ static int o_config_add_database(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_string(child, &db->password);
     else if (strcasecmp("Plugin", child->key) == 0)
       status = cf_util_get_string(child, &db->plugin_name);
+    else if (strcasecmp("FetchRows", child->key) == 0)
+      status = cf_util_get_int(child, &db->fetch_rows);
+    else if (strcasecmp("PrefetchRows", child->key) == 0)
+      status = cf_util_get_int(child, &db->prefetch_rows);
     else if (strcasecmp("Query", child->key) == 0)
       status = udb_query_pick_from_list(child, queries, queries_num,
                                         &db->queries, &db->queries_num);
@@ -242,6 +254,13 @@ static int o_config_add_database(oconfig_item_t *ci) /* {{{ */
       WARNING("oracle plugin: `Password' not given for query `%s'", db->name);
       status = -1;
     }
+    if (db->fetch_rows < 1) {
+      WARNING("oracle plugin: `FetchRows' must be positive for database `%s'",
+              db->name);
+      status = -1;
+    }
+    if (db->prefetch_rows < 0)
+      db->prefetch_rows = db->fetch_rows;
 
     break;
   } /* while (status == 0) */
@@ -356,6 +375,10 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
   char **column_names;
   char **column_values;
   size_t column_num;
+  size_t fetch_rows = (size_t)db->fetch_rows;
+
+  /* Indicators of the fetched values, to recognize NULL values. */
+  sb2 *indicators;
 
   OCIStmt *oci_statement;
 
@@ -404,6 +427,14 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
 
   assert(oci_statement != NULL);
 
+  /* The statement handle is shared by all databases using the query. */
+  ub4 prefetch_rows = (ub4)db->prefetch_rows;
+  status = OCIAttrSet(oci_statement, OCI_HTYPE_STMT, &prefetch_rows,
+                      /* size = */ 0, OCI_ATTR_PREFETCH_ROWS, oci_error);
+  if (status != OCI_SUCCESS)
+    o_report_error("o_read_database_query", db->name, udb_query_get_name(q),
+                   "OCIAttrSet (OCI_ATTR_PREFETCH_ROWS)", oci_error);
+
   /* Execute the statement */
   status = OCIStmtExecute(db->oci_service_context, /* {{{ */
                           oci_statement, oci_error,
@@ -435,13 +466,18 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
 
 /* Allocate the following buffers:
  *
- *  +---------------+-----------------------------------+
- *  ! Name          ! Size                              !
- *  +---------------+-----------------------------------+
- *  ! column_names  ! column_num x DATA_MAX_NAME_LEN    !
- *  ! column_values ! column_num x DATA_MAX_NAME_LEN    !
- *  ! oci_defines   ! column_num x sizeof (OCIDefine *) !
- *  +---------------+-----------------------------------+
+ *  +---------------+------------------------------------------------+
+ *  ! Name          ! Size                                           !
+ *  +---------------+------------------------------------------------+
+ *  ! column_names  ! column_num x DATA_MAX_NAME_LEN                 !
+ *  ! column_values ! column_num x fetch_rows x DATA_MAX_NAME_LEN    !
+ *  ! indicators    ! column_num x fetch_rows x sizeof (sb2)         !
+ *  ! oci_defines   ! column_num x sizeof (OCIDefine *)              !
+ *  +---------------+------------------------------------------------+
+ *
+ * OCI fetches the values of each column into an array of `fetch_rows'
+ * buffers. `column_values' points to them row by row, as expected by
+ * `udb_query_handle_results'.
  *
  * {{{ */
 #define NUMBER_BUFFER_SIZE 64
@@ -455,6 +491,7 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
     sfree(column_values[0]);                                                   \
     sfree(column_values);                                                      \
   }                                                                            \
+  sfree(indicators);                                                           \
   sfree(oci_defines)
 
 #define ALLOC_OR_FAIL(ptr, ptr_size)                                           \
@@ -471,6 +508,7 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
   /* Initialize everything to NULL so the above works. */
   column_names = NULL;
   column_values = NULL;
+  indicators = NULL;
   oci_defines = NULL;
 
   ALLOC_OR_FAIL(column_names, column_num * sizeof(char *));
@@ -478,10 +516,15 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
   for (size_t i = 1; i < column_num; i++)
     column_names[i] = column_names[i - 1] + DATA_MAX_NAME_LEN;
 
-  ALLOC_OR_FAIL(column_values, column_num * sizeof(char *));
-  ALLOC_OR_FAIL(column_values[0], column_num * DATA_MAX_NAME_LEN);
-  for (size_t i = 1; i < column_num; i++)
-    column_values[i] = column_values[i - 1] + DATA_MAX_NAME_LEN;
+  ALLOC_OR_FAIL(column_values, fetch_rows * column_num * sizeof(char *));
+  ALLOC_OR_FAIL(column_values[0],
+                column_num * fetch_rows * DATA_MAX_NAME_LEN);
+  for (size_t row = 0; row < fetch_rows; row++)
+    for (size_t i = 0; i < column_num; i++)
+      column_values[row * column_num + i] =
+          column_values[0] + (i * fetch_rows + row) * DATA_MAX_NAME_LEN;
+
+  ALLOC_OR_FAIL(indicators, column_num * fetch_rows * sizeof(sb2));
 
   ALLOC_OR_FAIL(oci_defines, column_num * sizeof(OCIDefine *));
   /* }}} End of buffer allocations. */
@@ -536,7 +579,8 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
 
     status = OCIDefineByPos(oci_statement, &oci_defines[i], oci_error,
                             (ub4)(i + 1), column_values[i], DATA_MAX_NAME_LEN,
-                            SQLT_STR, NULL, NULL, NULL, OCI_DEFAULT);
+                            SQLT_STR, indicators + i * fetch_rows, NULL, NULL,
+                            OCI_DEFAULT);
     if (status != OCI_SUCCESS) {
       o_report_error("o_read_database_query", db->name, udb_query_get_name(q),
                      "OCIDefineByPos", oci_error);
@@ -557,27 +601,53 @@ static int o_read_database_query(o_database_t *db, /* {{{ */
     return -1;
   }
 
-  /* Fetch and handle all the rows that matched the query. */
+  /* Fetch and handle all the rows that matched the query, `fetch_rows' rows
+   * at a time. */
   while (42) /* {{{ */
   {
+    bool done = false;
+    ub4 rows_fetched = 0;
+
     status = OCIStmtFetch2(oci_statement, oci_error,
-                           /* nrows = */ 1, /* orientation = */ OCI_FETCH_NEXT,
+                           /* nrows = */ (ub4)fetch_rows,
+                           /* orientation = */ OCI_FETCH_NEXT,
                            /* fetch offset = */ 0, /* mode = */ OCI_DEFAULT);
     if (status == OCI_NO_DATA) {
+      /* The last, partial array of rows may come with OCI_NO_DATA. */
       status = OCI_SUCCESS;
-      break;
+      done = true;
     } else if ((status != OCI_SUCCESS) && (status != OCI_SUCCESS_WITH_INFO)) {
       o_report_error("o_read_database_query", db->name, udb_query_get_name(q),
                      "OCIStmtFetch2", oci_error);
       break;
     }
 
-    status = udb_query_handle_result(q, prep_area, column_values);
-    if (status != 0) {
-      WARNING("oracle plugin: o_read_database_query (%s, %s): "
-              "udb_query_handle_result failed.",
-              db->name, udb_query_get_name(q));
+    status = OCIAttrGet(oci_statement, OCI_HTYPE_STMT, &rows_fetched,
+                        /* size pointer = */ NULL, OCI_ATTR_ROWS_FETCHED,
+                        oci_error);
+    if (status != OCI_SUCCESS) {
+      o_report_error("o_read_database_query", db->name, udb_query_get_name(q),
+                     "OCIAttrGet (OCI_ATTR_ROWS_FETCHED)", oci_error);
+      break;
     }
+
+    /* NULL values are handed over as empty strings. */
+    for (size_t i = 0; i < column_num * fetch_rows; i++)
+      if (indicators[i] == -1)
+        column_values[0][i * DATA_MAX_NAME_LEN] = 0;
+
+    if (rows_fetched > 0) {
+      status = udb_query_handle_results(q, prep_area, column_values,
+                                        (size_t)rows_fetched);
+      if (status != 0) {
+        WARNING("oracle plugin: o_read_database_query (%s, %s): "
+                "udb_query_handle_results failed.",
+                db->name, udb_query_get_name(q));
+      }
+    }
+
+    if (done)
+      break;
   } /* }}} while (42) */
 
   udb_query_finish_result(q, prep_area);
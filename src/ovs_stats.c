@@ -100,7 +100,11 @@ typedef struct interface_s {
   char ex_iface_id[UUID_SIZE];        /* External iface id */
   char ex_vm_id[UUID_SIZE];           /* External vm id */
   int64_t stats[IFACE_COUNTER_COUNT]; /* Statistics for interface */
-  struct interface_s *next;           /* Next interface for associated port */
+  bool changed;  /* Statistics changed since last read */
+  bool deleted;  /* Row deleted, but still listed by the port */
+  bool listed;   /* Listed by the port, while updating it */
+  struct port_s *port;      /* Pointer to port */
+  struct interface_s *next; /* Next interface for associated port */
 } interface_list_t;
 
 typedef struct port_s {
@@ -108,14 +112,38 @@ typedef struct port_s {
   char port_uuid[UUID_SIZE];     /* Port table _uuid */
   struct bridge_list_s *br;      /* Pointer to bridge */
   struct interface_s *iface;     /* Pointer to first interface */
+  bool deleted;                  /* Row deleted, but still listed by bridge */
+  struct port_s *prev;           /* Previous port */
   struct port_s *next;           /* Next port */
 } port_list_t;
 
 typedef struct bridge_list_s {
   char *name;                 /* Bridge name */
+  char uuid[UUID_SIZE];       /* Bridge table _uuid */
   struct bridge_list_s *next; /* Next bridge*/
 } bridge_list_t;
 
+/* Hash table of ports or interfaces by uuid */
+typedef struct ovs_stats_index_entry_s {
+  const char *uuid; /* Points into the indexed object */
+  uint32_t hash;
+  void *ptr;
+  struct ovs_stats_index_entry_s *next;
+} ovs_stats_index_entry_t;
+
+typedef struct ovs_stats_index_s {
+  ovs_stats_index_entry_t **buckets;
+  size_t size; /* Power of two */
+  size_t num;
+} ovs_stats_index_t;
+
+typedef enum ovs_stats_row_update_e {
+  ROW_UPDATE_NONE,   /* Malformed */
+  ROW_UPDATE_FULL,   /* All monitored columns */
+  ROW_UPDATE_DIFF,   /* Changed columns, as difference to the old values */
+  ROW_UPDATE_DELETE, /* Row deleted */
+} ovs_stats_row_update_t;
+
 #define cnt_str(x) [x] = #x
 
 static const char *const iface_counter_table[IFACE_COUNTER_COUNT] = {
@@ -181,6 +209,13 @@ static bridge_list_t *g_monitored_bridge_list_head;
 /* entry into the list of network bridges */
 static port_list_t *g_port_list_head;
 
+/* ports and interfaces by uuid */
+static ovs_stats_index_t g_port_index;
+static ovs_stats_index_t g_iface_index;
+
+/* set by the result callback of a table monitor request */
+static bool g_monitor_error;
+
 /* lock for statistics cache */
 static pthread_mutex_t g_stats_lock;
 
@@ -203,6 +238,10 @@ static ovs_stats_config_t ovs_stats_cfg = {
 /* flag indicating whether or not to publish individual interface statistics */
 static bool interface_stats = false;
 
+/* flag indicating whether or not to skip interfaces with unchanged statistics
+ */
+static bool skip_unchanged = false;
+
 static iface_counter ovs_stats_counter_name_to_type(const char *counter) {
   iface_counter index = not_supported;
 
@@ -270,6 +309,9 @@ static void ovs_stats_submit_interfaces(port_list_t *port) {
   bridge_list_t *bridge = port->br;
   for (interface_list_t *iface = port->iface; iface != NULL;
        iface = iface->next) {
+    if (iface->deleted || (skip_unchanged && !iface->changed))
+      continue;
+
     meta_data_t *meta = meta_data_create();
     if (meta != NULL) {
       meta_data_add_string(meta, "uuid", iface->iface_uuid);
@@ -378,6 +420,8 @@ static int ovs_stats_get_port_stat_value(port_list_t *port,
 
   for (interface_list_t *iface = port->iface; iface != NULL;
        iface = iface->next) {
+    if (iface->deleted)
+      continue;
     value = value + iface->stats[index];
   }
 
@@ -394,6 +438,9 @@ static void ovs_stats_submit_port(port_list_t *port) {
 
     for (interface_list_t *iface = port->iface; iface != NULL;
          iface = iface->next) {
+      if (iface->deleted)
+        continue;
+
       snprintf(key_str, sizeof(key_str), "uuid%d", i);
       meta_data_add_string(meta, key_str, iface->iface_uuid);
 
@@ -522,64 +569,140 @@ static void ovs_stats_submit_port(port_list_t *port) {
   meta_data_destroy(meta);
 }
 
-static port_list_t *ovs_stats_get_port(const char *uuid) {
-  if (uuid == NULL)
+/* FNV-1a */
+static uint32_t ovs_stats_uuid_hash(const char *uuid) {
+  uint32_t hash = 2166136261u;
+  for (const unsigned char *ptr = (const unsigned char *)uuid; *ptr != 0;
+       ptr++) {
+    hash ^= *ptr;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void *ovs_stats_index_get(const ovs_stats_index_t *idx,
+                                 const char *uuid) {
+  if (uuid == NULL || idx->size == 0)
     return NULL;
 
-  for (port_list_t *port = g_port_list_head; port != NULL; port = port->next) {
-    if (strncmp(port->port_uuid, uuid, strlen(port->port_uuid)) == 0)
-      return port;
+  uint32_t hash = ovs_stats_uuid_hash(uuid);
+  for (ovs_stats_index_entry_t *e = idx->buckets[hash & (idx->size - 1)];
+       e != NULL; e = e->next) {
+    if (e->hash == hash && strcmp(e->uuid, uuid) == 0)
+      return e->ptr;
   }
   return NULL;
 }
 
-static port_list_t *ovs_stats_get_port_by_interface_uuid(const char *uuid) {
-  if (uuid == NULL)
-    return NULL;
+static int ovs_stats_index_grow(ovs_stats_index_t *idx) {
+  size_t size = (idx->size == 0) ? 64 : 2 * idx->size;
+  ovs_stats_index_entry_t **buckets = calloc(size, sizeof(*buckets));
+  if (buckets == NULL)
+    return -1;
 
-  for (port_list_t *port = g_port_list_head; port != NULL; port = port->next) {
-    for (interface_list_t *iface = port->iface; iface != NULL;
-         iface = iface->next) {
-      if (strncmp(iface->iface_uuid, uuid, strlen(uuid)) == 0)
-        return port;
+  for (size_t i = 0; i < idx->size; i++) {
+    ovs_stats_index_entry_t *next;
+    for (ovs_stats_index_entry_t *e = idx->buckets[i]; e != NULL; e = next) {
+      next = e->next;
+      e->next = buckets[e->hash & (size - 1)];
+      buckets[e->hash & (size - 1)] = e;
     }
   }
-  return NULL;
+
+  sfree(idx->buckets);
+  idx->buckets = buckets;
+  idx->size = size;
+  return 0;
 }
 
-static interface_list_t *ovs_stats_get_port_interface(port_list_t *port,
-                                                      const char *uuid) {
-  if (port == NULL || uuid == NULL)
-    return NULL;
+static int ovs_stats_index_put(ovs_stats_index_t *idx, const char *uuid,
+                               void *ptr) {
+  if (idx->num >= idx->size && ovs_stats_index_grow(idx) != 0)
+    return -1;
 
-  for (interface_list_t *iface = port->iface; iface != NULL;
-       iface = iface->next) {
-    if (strncmp(iface->iface_uuid, uuid, strlen(uuid)) == 0)
-      return iface;
+  ovs_stats_index_entry_t *e = calloc(1, sizeof(*e));
+  if (e == NULL)
+    return -1;
+
+  e->uuid = uuid;
+  e->hash = ovs_stats_uuid_hash(uuid);
+  e->ptr = ptr;
+  e->next = idx->buckets[e->hash & (idx->size - 1)];
+  idx->buckets[e->hash & (idx->size - 1)] = e;
+  idx->num++;
+  return 0;
+}
+
+static void ovs_stats_index_remove(ovs_stats_index_t *idx, const char *uuid) {
+  if (idx->size == 0)
+    return;
+
+  uint32_t hash = ovs_stats_uuid_hash(uuid);
+  for (ovs_stats_index_entry_t **e = &idx->buckets[hash & (idx->size - 1)];
+       *e != NULL; e = &(*e)->next) {
+    if ((*e)->hash == hash && strcmp((*e)->uuid, uuid) == 0) {
+      ovs_stats_index_entry_t *del = *e;
+      *e = del->next;
+      sfree(del);
+      idx->num--;
+      return;
+    }
   }
-  return NULL;
+}
+
+/* Remove all entries. If `free_ptr' is set, the indexed objects are freed,
+ * too. */
+static void ovs_stats_index_clear(ovs_stats_index_t *idx, bool free_ptr) {
+  for (size_t i = 0; i < idx->size; i++) {
+    ovs_stats_index_entry_t *next;
+    for (ovs_stats_index_entry_t *e = idx->buckets[i]; e != NULL; e = next) {
+      next = e->next;
+      if (free_ptr)
+        sfree(e->ptr);
+      sfree(e);
+    }
+  }
+  sfree(idx->buckets);
+  idx->size = 0;
+  idx->num = 0;
+}
+
+static port_list_t *ovs_stats_get_port(const char *uuid) {
+  return ovs_stats_index_get(&g_port_index, uuid);
 }
 
 static interface_list_t *ovs_stats_get_interface(const char *uuid) {
-  if (uuid == NULL)
-    return NULL;
+  return ovs_stats_index_get(&g_iface_index, uuid);
+}
 
-  for (port_list_t *port = g_port_list_head; port != NULL; port = port->next) {
-    for (interface_list_t *iface = port->iface; iface != NULL;
-         iface = iface->next) {
-      if (strncmp(iface->iface_uuid, uuid, strlen(uuid)) == 0)
-        return iface;
+/* Remove interface from the list of its port */
+static void ovs_stats_detach_interface(interface_list_t *iface) {
+  if (iface->port == NULL)
+    return;
+
+  for (interface_list_t **i = &iface->port->iface; *i != NULL;
+       i = &(*i)->next) {
+    if (*i == iface) {
+      *i = iface->next;
+      break;
     }
   }
-  return NULL;
+  iface->port = NULL;
+  iface->next = NULL;
 }
 
-static interface_list_t *ovs_stats_new_port_interface(port_list_t *port,
-                                                      const char *uuid) {
+static void ovs_stats_free_interface(interface_list_t *iface) {
+  ovs_stats_detach_interface(iface);
+  ovs_stats_index_remove(&g_iface_index, iface->iface_uuid);
+  sfree(iface);
+}
+
+/* Create or get interface by interface uuid */
+static interface_list_t *ovs_stats_new_interface(const char *uuid) {
   if (uuid == NULL)
     return NULL;
 
-  interface_list_t *iface = ovs_stats_get_port_interface(port, uuid);
+  interface_list_t *iface = ovs_stats_get_interface(uuid);
 
   if (iface == NULL) {
     iface = calloc(1, sizeof(*iface));
@@ -589,13 +712,44 @@ static interface_list_t *ovs_stats_new_port_interface(port_list_t *port,
     }
     memset(iface->stats, -1, sizeof(int64_t[IFACE_COUNTER_COUNT]));
     sstrncpy(iface->iface_uuid, uuid, sizeof(iface->iface_uuid));
-    interface_list_t *iface_head = port->iface;
-    iface->next = iface_head;
+    if (ovs_stats_index_put(&g_iface_index, iface->iface_uuid, iface) != 0) {
+      ERROR("%s: Error indexing interface", plugin_name);
+      sfree(iface);
+      return NULL;
+    }
+  }
+  return iface;
+}
+
+/* Create or get interface by uuid and move it to the port */
+static interface_list_t *ovs_stats_new_port_interface(port_list_t *port,
+                                                      const char *uuid) {
+  interface_list_t *iface = ovs_stats_new_interface(uuid);
+
+  if (iface != NULL && iface->port != port) {
+    ovs_stats_detach_interface(iface);
+    iface->port = port;
+    iface->next = port->iface;
     port->iface = iface;
   }
   return iface;
 }
 
+static void ovs_stats_free_port(port_list_t *port) {
+  while (port->iface != NULL)
+    ovs_stats_free_interface(port->iface);
+
+  if (port->prev != NULL)
+    port->prev->next = port->next;
+  else
+    g_port_list_head = port->next;
+  if (port->next != NULL)
+    port->next->prev = port->prev;
+
+  ovs_stats_index_remove(&g_port_index, port->port_uuid);
+  sfree(port);
+}
+
 /* Create or get port by port uuid */
 static port_list_t *ovs_stats_new_port(bridge_list_t *bridge,
                                        const char *uuid) {
@@ -611,7 +765,14 @@ static port_list_t *ovs_stats_new_port(bridge_list_t *bridge,
       return NULL;
     }
     sstrncpy(port->port_uuid, uuid, sizeof(port->port_uuid));
+    if (ovs_stats_index_put(&g_port_index, port->port_uuid, port) != 0) {
+      ERROR("%s: Error indexing port", plugin_name);
+      sfree(port);
+      return NULL;
+    }
     port->next = g_port_list_head;
+    if (g_port_list_head != NULL)
+      g_port_list_head->prev = port;
     g_port_list_head = port;
   }
   if (bridge != NULL) {
@@ -620,6 +781,13 @@ static port_list_t *ovs_stats_new_port(bridge_list_t *bridge,
   return port;
 }
 
+/* Remove port from its bridge; a deleted port is freed then. */
+static void ovs_stats_unassign_port(port_list_t *port) {
+  port->br = NULL;
+  if (port->deleted)
+    ovs_stats_free_port(port);
+}
+
 /* Get bridge by name*/
 static bridge_list_t *ovs_stats_get_bridge(bridge_list_t *head,
                                            const char *name) {
@@ -634,6 +802,16 @@ static bridge_list_t *ovs_stats_get_bridge(bridge_list_t *head,
   return NULL;
 }
 
+/* Get bridge by uuid */
+static bridge_list_t *ovs_stats_get_bridge_by_uuid(const char *uuid) {
+  for (bridge_list_t *bridge = g_bridge_list_head; bridge != NULL;
+       bridge = bridge->next) {
+    if (strcmp(bridge->uuid, uuid) == 0)
+      return bridge;
+  }
+  return NULL;
+}
+
 /* Check if bridge is configured to be monitored in config file */
 static int ovs_stats_is_monitored_bridge(const char *br_name) {
   /* if no bridges are configured, return true */
@@ -647,331 +825,298 @@ static int ovs_stats_is_monitored_bridge(const char *br_name) {
   return 0;
 }
 
+/* Remove all ports from bridge */
+static void ovs_stats_clear_bridge(bridge_list_t *br) {
+  port_list_t *next;
+  for (port_list_t *port = g_port_list_head; port != NULL; port = next) {
+    next = port->next;
+    if (port->br == br)
+      ovs_stats_unassign_port(port);
+  }
+}
+
 /* Delete bridge */
-static int ovs_stats_del_bridge(yajl_val bridge) {
-  const char *old[] = {"old", NULL};
-  const char *name[] = {"name", NULL};
+static void ovs_stats_del_bridge(bridge_list_t *br) {
+  ovs_stats_clear_bridge(br);
 
-  if (!bridge || !YAJL_IS_OBJECT(bridge)) {
-    WARNING("%s: Incorrect data for deleting bridge", plugin_name);
-    return 0;
+  for (bridge_list_t **b = &g_bridge_list_head; *b != NULL; b = &(*b)->next) {
+    if (*b == br) {
+      *b = br->next;
+      break;
+    }
   }
+  sfree(br->name);
+  sfree(br);
+}
 
-  yajl_val row = yajl_tree_get(bridge, old, yajl_t_object);
-  if (!row || !YAJL_IS_OBJECT(row))
-    return 0;
+/* Get the kind of a <row-update> or <row-update2> and the row in it */
+static ovs_stats_row_update_t ovs_stats_get_row_update(yajl_val update,
+                                                       yajl_val *ret_row) {
+  /* "initial" and "insert" come with "monitor_cond", "new" with "monitor" */
+  const char *full_keys[] = {"initial", "insert", "new"};
+  yajl_val row;
+
+  if (!update || !YAJL_IS_OBJECT(update))
+    return ROW_UPDATE_NONE;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(full_keys); i++) {
+    row = ovs_utils_get_value_by_key(update, full_keys[i]);
+    if (row != NULL) {
+      *ret_row = row;
+      return YAJL_IS_OBJECT(row) ? ROW_UPDATE_FULL : ROW_UPDATE_NONE;
+    }
+  }
 
-  yajl_val br_name = yajl_tree_get(row, name, yajl_t_string);
-  if (!br_name || !YAJL_IS_STRING(br_name))
+  row = ovs_utils_get_value_by_key(update, "modify");
+  if (row != NULL) {
+    *ret_row = row;
+    return YAJL_IS_OBJECT(row) ? ROW_UPDATE_DIFF : ROW_UPDATE_NONE;
+  }
+
+  /* "delete" with "monitor_cond", only "old" with "monitor" */
+  if (ovs_utils_get_value_by_key(update, "delete") != NULL ||
+      ovs_utils_get_value_by_key(update, "old") != NULL)
+    return ROW_UPDATE_DELETE;
+
+  return ROW_UPDATE_NONE;
+}
+
+/* Call `cb' for each uuid of a set of references, which is either
+ * [ "uuid", "<uuid>" ] or [ "set", [ [ "uuid", "<uuid>" ], ... ] ] */
+static int ovs_stats_foreach_uuid(yajl_val jset,
+                                  void (*cb)(const char *uuid, void *arg),
+                                  void *arg) {
+  if (!jset || !YAJL_IS_ARRAY(jset) || YAJL_GET_ARRAY(jset)->len != 2)
+    return -1;
+
+  const char *tag = YAJL_GET_STRING(YAJL_GET_ARRAY(jset)->values[0]);
+  yajl_val jvalue = YAJL_GET_ARRAY(jset)->values[1];
+  if (tag == NULL)
+    return -1;
+
+  if (strcmp("uuid", tag) == 0) {
+    const char *uuid = YAJL_GET_STRING(jvalue);
+    if (uuid == NULL)
+      return -1;
+    cb(uuid, arg);
     return 0;
+  }
 
-  bridge_list_t *prev_br = g_bridge_list_head;
-  for (bridge_list_t *br = g_bridge_list_head; br != NULL;
-       prev_br = br, br = br->next) {
-    if ((strncmp(br->name, br_name->u.string, strlen(br->name)) == 0) &&
-        strlen(br->name) == strlen(br_name->u.string)) {
-      if (br == g_bridge_list_head)
-        g_bridge_list_head = br->next;
-      else
-        prev_br->next = br->next;
-      sfree(br->name);
-      sfree(br);
-      break;
-    }
+  if (strcmp("set", tag) != 0 || !YAJL_IS_ARRAY(jvalue))
+    return -1;
+
+  for (size_t i = 0; i < YAJL_GET_ARRAY(jvalue)->len; i++) {
+    yajl_val jref = YAJL_GET_ARRAY(jvalue)->values[i];
+    if (!YAJL_IS_ARRAY(jref) || YAJL_GET_ARRAY(jref)->len != 2)
+      return -1;
+
+    const char *uuid = YAJL_GET_STRING(YAJL_GET_ARRAY(jref)->values[1]);
+    if (uuid == NULL)
+      return -1;
+    cb(uuid, arg);
   }
   return 0;
 }
 
-/* Update Bridge. Create bridge ports*/
-static int ovs_stats_update_bridge(yajl_val bridge) {
-  const char *new[] = {"new", NULL};
-  const char *name[] = {"name", NULL};
-  const char *ports[] = {"ports", NULL};
+/* Get the pairs of a map, [ "map", [ [ <key>, <value> ], ... ] ] */
+static yajl_val ovs_stats_get_map_pairs(yajl_val jmap) {
+  if (!jmap || !YAJL_IS_ARRAY(jmap) || YAJL_GET_ARRAY(jmap)->len != 2)
+    return NULL;
 
-  if (!bridge || !YAJL_IS_OBJECT(bridge))
-    goto failure;
+  const char *tag = YAJL_GET_STRING(YAJL_GET_ARRAY(jmap)->values[0]);
+  yajl_val jpairs = YAJL_GET_ARRAY(jmap)->values[1];
+  if (tag == NULL || strcmp("map", tag) != 0 || !YAJL_IS_ARRAY(jpairs))
+    return NULL;
 
-  yajl_val row = yajl_tree_get(bridge, new, yajl_t_object);
-  if (!row || !YAJL_IS_OBJECT(row))
-    return 0;
+  return jpairs;
+}
 
-  yajl_val br_name = yajl_tree_get(row, name, yajl_t_string);
-  if (!br_name || !YAJL_IS_STRING(br_name))
+static void ovs_stats_bridge_add_port(const char *uuid, void *arg) {
+  ovs_stats_new_port(arg, uuid);
+}
+
+/* A set difference lists the elements that were added or removed */
+static void ovs_stats_bridge_toggle_port(const char *uuid, void *arg) {
+  bridge_list_t *br = arg;
+  port_list_t *port = ovs_stats_get_port(uuid);
+
+  if (port != NULL && port->br == br)
+    ovs_stats_unassign_port(port);
+  else
+    ovs_stats_new_port(br, uuid);
+}
+
+/* Update Bridge. Create bridge ports*/
+static int ovs_stats_update_bridge(const char *uuid, yajl_val update) {
+  yajl_val row = NULL;
+  ovs_stats_row_update_t kind = ovs_stats_get_row_update(update, &row);
+  bridge_list_t *br = ovs_stats_get_bridge_by_uuid(uuid);
+
+  if (kind == ROW_UPDATE_NONE) {
+    ERROR("%s: Incorrect JSON Bridge data", plugin_name);
+    return -1;
+  } else if (kind == ROW_UPDATE_DELETE) {
+    if (br != NULL)
+      ovs_stats_del_bridge(br);
     return 0;
+  }
 
-  if (!ovs_stats_is_monitored_bridge(YAJL_GET_STRING(br_name)))
+  const char *name = YAJL_GET_STRING(ovs_utils_get_value_by_key(row, "name"));
+  if (name != NULL && !ovs_stats_is_monitored_bridge(name)) {
+    if (br != NULL)
+      ovs_stats_del_bridge(br);
     return 0;
+  }
 
-  bridge_list_t *br =
-      ovs_stats_get_bridge(g_bridge_list_head, YAJL_GET_STRING(br_name));
   if (br == NULL) {
+    /* Without the full row, this is a bridge which isn't monitored */
+    if (kind != ROW_UPDATE_FULL || name == NULL)
+      return 0;
+
     br = calloc(1, sizeof(*br));
     if (br == NULL) {
       ERROR("%s: calloc(%zu) failed.", plugin_name, sizeof(*br));
       return -1;
     }
+    sstrncpy(br->uuid, uuid, sizeof(br->uuid));
+    br->next = g_bridge_list_head;
+    g_bridge_list_head = br;
+  }
 
-    char *tmp = YAJL_GET_STRING(br_name);
-    if (tmp != NULL)
-      br->name = strdup(tmp);
-
-    if (br->name == NULL) {
-      sfree(br);
+  if (name != NULL && (br->name == NULL || strcmp(br->name, name) != 0)) {
+    char *tmp = strdup(name);
+    if (tmp == NULL) {
       ERROR("%s: strdup failed.", plugin_name);
+      if (br->name == NULL)
+        ovs_stats_del_bridge(br);
       return -1;
     }
-
-    br->next = g_bridge_list_head;
-    g_bridge_list_head = br;
+    sfree(br->name);
+    br->name = tmp;
   }
 
-  yajl_val br_ports = yajl_tree_get(row, ports, yajl_t_array);
-  if (!br_ports || !YAJL_IS_ARRAY(br_ports))
+  yajl_val br_ports = ovs_utils_get_value_by_key(row, "ports");
+  if (br_ports == NULL)
     return 0;
 
-  char *tmp = YAJL_GET_STRING(br_ports->u.array.values[0]);
-  if (tmp != NULL && strcmp("set", tmp) == 0) {
-    yajl_val *array = YAJL_GET_ARRAY(br_ports)->values;
-    size_t array_len = YAJL_GET_ARRAY(br_ports)->len;
-    if (array != NULL && array_len > 0 && YAJL_IS_ARRAY(array[1])) {
-      if (YAJL_GET_ARRAY(array[1]) == NULL)
-        goto failure;
-
-      yajl_val *ports_arr = YAJL_GET_ARRAY(array[1])->values;
-      size_t ports_num = YAJL_GET_ARRAY(array[1])->len;
-      for (size_t i = 0; i < ports_num && ports_arr != NULL; i++) {
-        tmp = YAJL_GET_STRING(ports_arr[i]->u.array.values[1]);
-        if (tmp != NULL)
-          ovs_stats_new_port(br, tmp);
-        else
-          goto failure;
-      }
-    }
+  int status;
+  if (kind == ROW_UPDATE_FULL) {
+    ovs_stats_clear_bridge(br);
+    status = ovs_stats_foreach_uuid(br_ports, ovs_stats_bridge_add_port, br);
   } else {
-    ovs_stats_new_port(br, YAJL_GET_STRING(br_ports->u.array.values[1]));
+    status = ovs_stats_foreach_uuid(br_ports, ovs_stats_bridge_toggle_port, br);
   }
 
+  if (status != 0) {
+    ERROR("%s: Incorrect JSON Bridge data", plugin_name);
+    return -1;
+  }
   return 0;
-
-failure:
-  ERROR("Incorrect JSON Bridge data");
-  return -1;
 }
 
-/* Handle JSON with Bridge Table change event */
-static void ovs_stats_bridge_table_change_cb(yajl_val jupdates) {
-  /* Bridge Table update example JSON data
-    {
-      "Bridge": {
-        "bb1f8965-5775-46d9-b820-236ca8edbedc": {
-          "new": {
-            "name": "br0",
-            "ports": [
-              "set",
-              [
-                [
-                  "uuid",
-                  "117f1a07-7ef0-458a-865c-ec7fbb85bc01"
-                ],
-                [
-                  "uuid",
-                  "12fd8bdc-e950-4281-aaa9-46e185658f79"
-                ]
-              ]
-            ]
-          }
-        }
-      }
-    }
-   */
-  const char *path[] = {"Bridge", NULL};
-  yajl_val bridges = yajl_tree_get(jupdates, path, yajl_t_object);
-
-  if (!bridges || !YAJL_IS_OBJECT(bridges))
+/* Delete port. If a bridge still lists it, keep it until the bridge's ports
+ * change, so that the set difference isn't taken for a new port. */
+static void ovs_stats_del_port(const char *uuid) {
+  port_list_t *port = ovs_stats_get_port(uuid);
+  if (port == NULL)
     return;
 
-  pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(bridges)->len; i++) {
-    yajl_val bridge = YAJL_GET_OBJECT(bridges)->values[i];
-    ovs_stats_update_bridge(bridge);
+  if (port->br == NULL) {
+    ovs_stats_free_port(port);
+    return;
   }
-  pthread_mutex_unlock(&g_stats_lock);
-}
 
-/* Handle Bridge Table delete event */
-static void ovs_stats_bridge_table_delete_cb(yajl_val jupdates) {
-  const char *path[] = {"Bridge", NULL};
-  yajl_val bridges = yajl_tree_get(jupdates, path, yajl_t_object);
-  if (!bridges || !YAJL_IS_OBJECT(bridges))
-    return;
+  while (port->iface != NULL)
+    ovs_stats_free_interface(port->iface);
+  port->deleted = true;
+}
 
-  pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(bridges)->len; i++) {
-    yajl_val bridge = YAJL_GET_OBJECT(bridges)->values[i];
-    ovs_stats_del_bridge(bridge);
-  }
-  pthread_mutex_unlock(&g_stats_lock);
+static void ovs_stats_port_add_interface(const char *uuid, void *arg) {
+  interface_list_t *iface = ovs_stats_new_port_interface(arg, uuid);
+  if (iface != NULL)
+    iface->listed = true;
 }
 
-/* Handle JSON with Bridge table initial values */
-static void ovs_stats_bridge_table_result_cb(yajl_val jresult,
-                                             yajl_val jerror) {
-  if (YAJL_IS_NULL(jerror))
-    ovs_stats_bridge_table_change_cb(jresult);
+static void ovs_stats_port_toggle_interface(const char *uuid, void *arg) {
+  port_list_t *port = arg;
+  interface_list_t *iface = ovs_stats_get_interface(uuid);
+
+  if (iface != NULL && iface->port == port)
+    ovs_stats_free_interface(iface);
   else
-    ERROR("%s: Error received from OvSDB. Table: Bridge", plugin_name);
-  return;
+    ovs_stats_new_port_interface(port, uuid);
 }
 
 /* Update port name and interface UUID(s)*/
-static int ovs_stats_update_port(const char *uuid, yajl_val port) {
-  const char *new[] = {"new", NULL};
-  const char *name[] = {"name", NULL};
+static int ovs_stats_update_port(const char *uuid, yajl_val update) {
+  yajl_val row = NULL;
+  ovs_stats_row_update_t kind = ovs_stats_get_row_update(update, &row);
 
-  if (!port || !YAJL_IS_OBJECT(port)) {
-    ERROR("Incorrect JSON Port data");
+  if (kind == ROW_UPDATE_NONE) {
+    ERROR("%s: Incorrect JSON Port data", plugin_name);
     return -1;
-  }
-
-  yajl_val row = yajl_tree_get(port, new, yajl_t_object);
-  if (!row || !YAJL_IS_OBJECT(row))
-    return 0;
-
-  yajl_val port_name = yajl_tree_get(row, name, yajl_t_string);
-  if (!port_name || !YAJL_IS_STRING(port_name))
+  } else if (kind == ROW_UPDATE_DELETE) {
+    ovs_stats_del_port(uuid);
     return 0;
+  }
 
   /* Create or get port by port uuid */
-  port_list_t *portentry = ovs_stats_new_port(NULL, uuid);
-  if (!portentry)
+  port_list_t *port = (kind == ROW_UPDATE_FULL) ? ovs_stats_new_port(NULL, uuid)
+                                                : ovs_stats_get_port(uuid);
+  if (port == NULL)
     return 0;
 
-  sstrncpy(portentry->name, YAJL_GET_STRING(port_name),
-           sizeof(portentry->name));
+  const char *name = YAJL_GET_STRING(ovs_utils_get_value_by_key(row, "name"));
+  if (name != NULL)
+    sstrncpy(port->name, name, sizeof(port->name));
 
-  yajl_val ifaces_root = ovs_utils_get_value_by_key(row, "interfaces");
-  char *ifaces_root_key =
-      YAJL_GET_STRING(YAJL_GET_ARRAY(ifaces_root)->values[0]);
-
-  if (strcmp("set", ifaces_root_key) == 0) {
-    // ifaces_root is ["set", [[ "uuid", "<some_uuid>" ], [ "uuid",
-    // "<another_uuid>" ], ... ]]
-    yajl_val ifaces_list = YAJL_GET_ARRAY(ifaces_root)->values[1];
+  yajl_val ifaces = ovs_utils_get_value_by_key(row, "interfaces");
+  if (ifaces == NULL)
+    return 0;
 
-    // ifaces_list is [[ "uuid", "<some_uuid>" ], [ "uuid",
-    // "<another_uuid>" ], ... ]]
-    for (int i = 0; i < YAJL_GET_ARRAY(ifaces_list)->len; i++) {
-      yajl_val iface_tuple = YAJL_GET_ARRAY(ifaces_list)->values[i];
+  int status;
+  if (kind == ROW_UPDATE_FULL) {
+    for (interface_list_t *iface = port->iface; iface != NULL;
+         iface = iface->next)
+      iface->listed = false;
 
-      // iface_tuple is [ "uuid", "<some_uuid>" ]
-      char *iface_uuid_str =
-          YAJL_GET_STRING(YAJL_GET_ARRAY(iface_tuple)->values[1]);
+    status = ovs_stats_foreach_uuid(ifaces, ovs_stats_port_add_interface, port);
 
-      // Also checks if interface already registered
-      ovs_stats_new_port_interface(portentry, iface_uuid_str);
+    interface_list_t *next;
+    for (interface_list_t *iface = port->iface; iface != NULL; iface = next) {
+      next = iface->next;
+      if (!iface->listed && status == 0)
+        ovs_stats_free_interface(iface);
     }
   } else {
-    // ifaces_root is [ "uuid", "<some_uuid>" ]
-    char *iface_uuid_str =
-        YAJL_GET_STRING(YAJL_GET_ARRAY(ifaces_root)->values[1]);
-
-    // Also checks if interface already registered
-    ovs_stats_new_port_interface(portentry, iface_uuid_str);
+    status =
+        ovs_stats_foreach_uuid(ifaces, ovs_stats_port_toggle_interface, port);
   }
 
-  return 0;
-}
-
-/* Delete port from global port list */
-static int ovs_stats_del_port(const char *uuid) {
-  port_list_t *prev_port = g_port_list_head;
-  for (port_list_t *port = g_port_list_head; port != NULL;
-       prev_port = port, port = port->next) {
-    if (strncmp(port->port_uuid, uuid, strlen(port->port_uuid)) == 0) {
-      if (port == g_port_list_head)
-        g_port_list_head = port->next;
-      else
-        prev_port->next = port->next;
-
-      for (interface_list_t *iface = port->iface; iface != NULL;
-           iface = port->iface) {
-        interface_list_t *del = iface;
-        port->iface = iface->next;
-        sfree(del);
-      }
-
-      sfree(port);
-      break;
-    }
+  if (status != 0) {
+    ERROR("%s: Incorrect JSON Port data", plugin_name);
+    return -1;
   }
   return 0;
 }
 
-/* Handle JSON with Port Table change event */
-static void ovs_stats_port_table_change_cb(yajl_val jupdates) {
-  /* Port Table update example JSON data
-    {
-      "Port": {
-        "ab107d6f-28a1-4257-b1cc-5b742821db8a": {
-          "new": {
-            "name": "br1",
-            "interfaces": [
-              "uuid",
-              "33a289a0-1d34-4e46-a3c2-3e4066fbecc6"
-            ]
-          }
-        }
-      }
-    }
-   */
-  const char *path[] = {"Port", NULL};
-  yajl_val ports = yajl_tree_get(jupdates, path, yajl_t_object);
-  if (!ports || !YAJL_IS_OBJECT(ports))
-    return;
-
-  pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(ports)->len; i++) {
-    yajl_val port = YAJL_GET_OBJECT(ports)->values[i];
-    ovs_stats_update_port(YAJL_GET_OBJECT(ports)->keys[i], port);
-  }
-  pthread_mutex_unlock(&g_stats_lock);
-  return;
-}
-
-/* Handle JSON with Port table initial values */
-static void ovs_stats_port_table_result_cb(yajl_val jresult, yajl_val jerror) {
-  if (YAJL_IS_NULL(jerror))
-    ovs_stats_port_table_change_cb(jresult);
-  else
-    ERROR("%s: Error received from OvSDB. Table: Port", plugin_name);
-  return;
-}
-
-/* Handle Port Table delete event */
-static void ovs_stats_port_table_delete_cb(yajl_val jupdates) {
-  const char *path[] = {"Port", NULL};
-  yajl_val ports = yajl_tree_get(jupdates, path, yajl_t_object);
-  if (!ports || !YAJL_IS_OBJECT(ports))
-    return;
-
-  pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(ports)->len; i++) {
-    ovs_stats_del_port(YAJL_GET_OBJECT(ports)->keys[i]);
-  }
-  pthread_mutex_unlock(&g_stats_lock);
-  return;
-}
-
-/* Update interface statistics */
+/* Update interface statistics. A difference lists new counters and counters
+ * with a new value; counters with an unchanged value were removed. */
 static int ovs_stats_update_iface_stats(interface_list_t *iface,
-                                        yajl_val stats) {
-
-  if (!stats || !YAJL_IS_ARRAY(stats))
+                                        yajl_val stats, bool diff) {
+  yajl_val pairs = ovs_stats_get_map_pairs(stats);
+  if (pairs == NULL)
     return 0;
 
-  for (size_t i = 0; i < YAJL_GET_ARRAY(stats)->len; i++) {
-    yajl_val stat = YAJL_GET_ARRAY(stats)->values[i];
-    if (!YAJL_IS_ARRAY(stat))
+  int64_t old_stats[IFACE_COUNTER_COUNT];
+  if (!diff) {
+    memcpy(old_stats, iface->stats, sizeof(old_stats));
+    memset(iface->stats, -1, sizeof(iface->stats));
+  }
+
+  for (size_t i = 0; i < YAJL_GET_ARRAY(pairs)->len; i++) {
+    yajl_val stat = YAJL_GET_ARRAY(pairs)->values[i];
+    if (!YAJL_IS_ARRAY(stat) || YAJL_GET_ARRAY(stat)->len != 2)
       return -1;
 
     char *counter_name = YAJL_GET_STRING(YAJL_GET_ARRAY(stat)->values[0]);
@@ -980,279 +1125,220 @@ static int ovs_stats_update_iface_stats(interface_list_t *iface,
     if (counter_index == not_supported)
       continue;
 
-    iface->stats[counter_index] = counter_value;
+    if (diff && iface->stats[counter_index] == counter_value)
+      iface->stats[counter_index] = -1;
+    else
+      iface->stats[counter_index] = counter_value;
+    if (diff)
+      iface->changed = true;
   }
 
+  if (!diff && memcmp(old_stats, iface->stats, sizeof(old_stats)) != 0)
+    iface->changed = true;
+
   return 0;
 }
 
-/* Update interface external_ids */
+/* Update interface external_ids, the same way as the statistics */
 static int ovs_stats_update_iface_ext_ids(interface_list_t *iface,
-                                          yajl_val ext_ids) {
-
-  if (!ext_ids || !YAJL_IS_ARRAY(ext_ids))
+                                          yajl_val ext_ids, bool diff) {
+  yajl_val pairs = ovs_stats_get_map_pairs(ext_ids);
+  if (pairs == NULL)
     return 0;
 
-  for (size_t i = 0; i < YAJL_GET_ARRAY(ext_ids)->len; i++) {
-    yajl_val ext_id = YAJL_GET_ARRAY(ext_ids)->values[i];
-    if (!YAJL_IS_ARRAY(ext_id))
+  if (!diff) {
+    iface->ex_iface_id[0] = '\0';
+    iface->ex_vm_id[0] = '\0';
+  }
+
+  for (size_t i = 0; i < YAJL_GET_ARRAY(pairs)->len; i++) {
+    yajl_val ext_id = YAJL_GET_ARRAY(pairs)->values[i];
+    if (!YAJL_IS_ARRAY(ext_id) || YAJL_GET_ARRAY(ext_id)->len != 2)
       return -1;
 
     char *key = YAJL_GET_STRING(YAJL_GET_ARRAY(ext_id)->values[0]);
     char *value = YAJL_GET_STRING(YAJL_GET_ARRAY(ext_id)->values[1]);
-    if (key && value) {
-      if (strncmp(key, "iface-id", strlen(key)) == 0) {
-        sstrncpy(iface->ex_iface_id, value, sizeof(iface->ex_iface_id));
-      } else if (strncmp(key, "vm-uuid", strlen(key)) == 0) {
-        sstrncpy(iface->ex_vm_id, value, sizeof(iface->ex_vm_id));
-      }
-    }
+    if (key == NULL || value == NULL)
+      continue;
+
+    char *dst;
+    if (strcmp(key, "iface-id") == 0)
+      dst = iface->ex_iface_id;
+    else if (strcmp(key, "vm-uuid") == 0)
+      dst = iface->ex_vm_id;
+    else
+      continue;
+
+    if (diff && strcmp(dst, value) == 0)
+      dst[0] = '\0';
+    else
+      sstrncpy(dst, value, UUID_SIZE);
   }
 
   return 0;
 }
 
-/* Get interface statistic and external_ids */
-static int ovs_stats_update_iface(yajl_val iface_obj) {
-  if (!iface_obj || !YAJL_IS_OBJECT(iface_obj)) {
-    ERROR("ovs_stats plugin: incorrect JSON interface data");
-    return -1;
-  }
-
-  yajl_val row = ovs_utils_get_value_by_key(iface_obj, "new");
-  if (!row || !YAJL_IS_OBJECT(row))
-    return 0;
+/* Delete interface. If a port still lists it, keep it until the port's
+ * interfaces change. */
+static void ovs_stats_del_interface(const char *uuid) {
+  interface_list_t *iface = ovs_stats_get_interface(uuid);
+  if (iface == NULL)
+    return;
 
-  yajl_val iface_name = ovs_utils_get_value_by_key(row, "name");
-  if (!iface_name || !YAJL_IS_STRING(iface_name))
-    return 0;
+  if (iface->port == NULL)
+    ovs_stats_free_interface(iface);
+  else
+    iface->deleted = true;
+}
 
-  yajl_val iface_uuid = ovs_utils_get_value_by_key(row, "_uuid");
-  if (!iface_uuid || !YAJL_IS_ARRAY(iface_uuid) ||
-      YAJL_GET_ARRAY(iface_uuid)->len != 2)
-    return 0;
+/* Get interface statistic and external_ids */
+static int ovs_stats_update_iface(const char *uuid, yajl_val update) {
+  yajl_val row = NULL;
+  ovs_stats_row_update_t kind = ovs_stats_get_row_update(update, &row);
 
-  char *iface_uuid_str = YAJL_GET_STRING(YAJL_GET_ARRAY(iface_uuid)->values[1]);
-  if (iface_uuid_str == NULL) {
+  if (kind == ROW_UPDATE_NONE) {
     ERROR("ovs_stats plugin: incorrect JSON interface data");
     return -1;
+  } else if (kind == ROW_UPDATE_DELETE) {
+    ovs_stats_del_interface(uuid);
+    return 0;
   }
 
-  interface_list_t *iface = ovs_stats_get_interface(iface_uuid_str);
+  /* The port listing the interface may come later; the differences which
+   * follow need the full row. */
+  interface_list_t *iface = (kind == ROW_UPDATE_FULL)
+                                ? ovs_stats_new_interface(uuid)
+                                : ovs_stats_get_interface(uuid);
   if (iface == NULL)
     return 0;
 
-  sstrncpy(iface->name, YAJL_GET_STRING(iface_name), sizeof(iface->name));
-
-  yajl_val iface_stats = ovs_utils_get_value_by_key(row, "statistics");
-  yajl_val iface_ext_ids = ovs_utils_get_value_by_key(row, "external_ids");
-
-  /*
-   * {
-        "statistics": [
-          "map",
-          [
-            [
-              "collisions",
-              0
-            ],
-            . . .
-            [
-              "tx_packets",
-              0
-            ]
-          ]
-        ]
-      }
-   Check that statistics is an array with 2 elements
-   */
-
-  if (iface_stats && YAJL_IS_ARRAY(iface_stats) &&
-      YAJL_GET_ARRAY(iface_stats)->len == 2)
-    ovs_stats_update_iface_stats(iface, YAJL_GET_ARRAY(iface_stats)->values[1]);
-
-  if (iface_ext_ids && YAJL_IS_ARRAY(iface_ext_ids))
-    ovs_stats_update_iface_ext_ids(iface,
-                                   YAJL_GET_ARRAY(iface_ext_ids)->values[1]);
-
-  return 0;
-}
-
-/* Delete interface */
-static int ovs_stats_del_interface(const char *uuid) {
-  port_list_t *port = ovs_stats_get_port_by_interface_uuid(uuid);
-
-  if (port == NULL)
-    return 0;
-
-  interface_list_t *prev_iface = NULL;
-
-  for (interface_list_t *iface = port->iface; iface != NULL;
-       iface = port->iface) {
-    if (strncmp(iface->iface_uuid, uuid, strlen(iface->iface_uuid))) {
-
-      interface_list_t *del = iface;
+  const char *name = YAJL_GET_STRING(ovs_utils_get_value_by_key(row, "name"));
+  if (name != NULL)
+    sstrncpy(iface->name, name, sizeof(iface->name));
 
-      if (prev_iface == NULL)
-        port->iface = iface->next;
-      else
-        prev_iface->next = iface->next;
-
-      sfree(del);
-      break;
-    } else {
-      prev_iface = iface;
-    }
+  bool diff = (kind == ROW_UPDATE_DIFF);
+  if (ovs_stats_update_iface_stats(
+          iface, ovs_utils_get_value_by_key(row, "statistics"), diff) != 0 ||
+      ovs_stats_update_iface_ext_ids(
+          iface, ovs_utils_get_value_by_key(row, "external_ids"), diff) != 0) {
+    ERROR("ovs_stats plugin: incorrect JSON interface data");
+    return -1;
   }
 
   return 0;
 }
 
-/* Handle JSON with Interface Table change event */
-static void ovs_stats_interface_table_change_cb(yajl_val jupdates) {
-  /* Interface Table update example JSON data
+/* Handle JSON with Bridge, Port or Interface Table changes */
+static void ovs_stats_table_change_cb(yajl_val jupdates) {
+  /* Interface Table update example JSON data with "monitor_cond"; the
+   * statistics map only has the changed counters:
     {
       "Interface": {
         "33a289a0-1d34-4e46-a3c2-3e4066fbecc6": {
-          "new": {
-            "name": "br1",
+          "modify": {
             "statistics": [
               "map",
               [
-                [
-                  "collisions",
-                  0
-                ],
                 [
                   "rx_bytes",
-                  0
+                  6228
                 ],
-               . . .
                 [
-                  "tx_packets",
-                  12617
+                  "rx_packets",
+                  85
                 ]
               ]
-            ],
-            "_uuid": [
-              "uuid",
-              "33a289a0-1d34-4e46-a3c2-3e4066fbecc6"
             ]
-            "external_ids": [
-                "map",
-                [
-                  [
-                    "attached-mac",
-                    "fa:16:3e:7c:1c:4b"
-                  ],
-                  [
-                    "iface-id",
-                    "a61b7e2b-6951-488a-b4c6-6e91343960b2"
-                  ],
-                  [
-                    "iface-status",
-                    "active"
-                  ]
-                ]
-              ]
           }
         }
       }
     }
+   * With "monitor", rows come as { "new": <row> } with all monitored
+   * columns, and deleted rows as { "old": <row> }.
    */
-  const char *path[] = {"Interface", NULL};
-  yajl_val interfaces = yajl_tree_get(jupdates, path, yajl_t_object);
-  if (!interfaces || !YAJL_IS_OBJECT(interfaces))
-    return;
+  const struct {
+    const char *name;
+    int (*update)(const char *uuid, yajl_val update);
+  } tables[] = {
+      {"Bridge", ovs_stats_update_bridge},
+      {"Port", ovs_stats_update_port},
+      {"Interface", ovs_stats_update_iface},
+  };
 
   pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(interfaces)->len; i++) {
-    ovs_stats_update_iface(YAJL_GET_OBJECT(interfaces)->values[i]);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(tables); i++) {
+    yajl_val rows = ovs_utils_get_value_by_key(jupdates, tables[i].name);
+    if (!rows || !YAJL_IS_OBJECT(rows))
+      continue;
+
+    for (size_t j = 0; j < YAJL_GET_OBJECT(rows)->len; j++)
+      tables[i].update(YAJL_GET_OBJECT(rows)->keys[j],
+                       YAJL_GET_OBJECT(rows)->values[j]);
   }
   pthread_mutex_unlock(&g_stats_lock);
-
-  return;
 }
 
-/* Handle JSON with Interface table initial values */
-static void ovs_stats_interface_table_result_cb(yajl_val jresult,
-                                                yajl_val jerror) {
+/* Handle JSON with table initial values */
+static void ovs_stats_table_result_cb(yajl_val jresult, yajl_val jerror) {
   if (YAJL_IS_NULL(jerror))
-    ovs_stats_interface_table_change_cb(jresult);
+    ovs_stats_table_change_cb(jresult);
   else
-    ERROR("%s: Error received from OvSDB. Table: Interface", plugin_name);
-  return;
-}
-
-/* Handle Interface Table delete event */
-static void ovs_stats_interface_table_delete_cb(yajl_val jupdates) {
-  const char *path[] = {"Interface", NULL};
-  yajl_val interfaces = yajl_tree_get(jupdates, path, yajl_t_object);
-  if (!interfaces || !YAJL_IS_OBJECT(interfaces))
-    return;
-
-  pthread_mutex_lock(&g_stats_lock);
-  for (size_t i = 0; i < YAJL_GET_OBJECT(interfaces)->len; i++) {
-    ovs_stats_del_interface(YAJL_GET_OBJECT(interfaces)->keys[i]);
-  }
-  pthread_mutex_unlock(&g_stats_lock);
-
-  return;
+    g_monitor_error = true;
 }
 
 /* Setup OVS DB table callbacks  */
 static void ovs_stats_initialize(ovs_db_t *pdb) {
   const char *bridge_columns[] = {"name", "ports", NULL};
   const char *port_columns[] = {"name", "interfaces", NULL};
-  const char *interface_columns[] = {"name", "statistics", "_uuid",
-                                     "external_ids", NULL};
-
-  /* subscribe to a tables */
-  ovs_db_table_cb_register(
-      pdb, "Bridge", bridge_columns, ovs_stats_bridge_table_change_cb,
-      ovs_stats_bridge_table_result_cb,
-      OVS_DB_TABLE_CB_FLAG_INITIAL | OVS_DB_TABLE_CB_FLAG_INSERT |
-          OVS_DB_TABLE_CB_FLAG_MODIFY);
-
-  ovs_db_table_cb_register(pdb, "Bridge", bridge_columns,
-                           ovs_stats_bridge_table_delete_cb, NULL,
-                           OVS_DB_TABLE_CB_FLAG_DELETE);
-
-  ovs_db_table_cb_register(
-      pdb, "Port", port_columns, ovs_stats_port_table_change_cb,
-      ovs_stats_port_table_result_cb,
-      OVS_DB_TABLE_CB_FLAG_INITIAL | OVS_DB_TABLE_CB_FLAG_INSERT |
-          OVS_DB_TABLE_CB_FLAG_MODIFY);
-
-  ovs_db_table_cb_register(pdb, "Port", port_columns,
-                           ovs_stats_port_table_delete_cb, NULL,
-                           OVS_DB_TABLE_CB_FLAG_DELETE);
-
-  ovs_db_table_cb_register(
-      pdb, "Interface", interface_columns, ovs_stats_interface_table_change_cb,
-      ovs_stats_interface_table_result_cb,
-      OVS_DB_TABLE_CB_FLAG_INITIAL | OVS_DB_TABLE_CB_FLAG_INSERT |
-          OVS_DB_TABLE_CB_FLAG_MODIFY);
-
-  ovs_db_table_cb_register(pdb, "Interface", interface_columns,
-                           ovs_stats_interface_table_delete_cb, NULL,
-                           OVS_DB_TABLE_CB_FLAG_DELETE);
-}
+  const char *interface_columns[] = {"name", "statistics", "external_ids",
+                                     NULL};
+  const struct {
+    const char *name;
+    const char **columns;
+  } tables[] = {
+      {"Bridge", bridge_columns},
+      {"Port", port_columns},
+      {"Interface", interface_columns},
+  };
+  unsigned int flags = OVS_DB_TABLE_CB_FLAG_ALL | OVS_DB_TABLE_CB_FLAG_UPDATE2;
+
+  /* subscribe to a tables, receiving only the changes of modified rows if
+   * the server supports it */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(tables); i++) {
+    g_monitor_error = false;
+    ovs_db_table_cb_register(pdb, tables[i].name, tables[i].columns,
+                             ovs_stats_table_change_cb,
+                             ovs_stats_table_result_cb, flags);
+
+    if (g_monitor_error && (flags & OVS_DB_TABLE_CB_FLAG_UPDATE2)) {
+      INFO("%s: OvSDB doesn't support \"monitor_cond\", receiving full rows "
+           "instead",
+           plugin_name);
+      flags &= ~OVS_DB_TABLE_CB_FLAG_UPDATE2;
+      g_monitor_error = false;
+      ovs_db_table_cb_register(pdb, tables[i].name, tables[i].columns,
+                               ovs_stats_table_change_cb,
+                               ovs_stats_table_result_cb, flags);
+    }
 
-/* Delete all ports from port list */
-static void ovs_stats_free_port_list(port_list_t *head) {
-  for (port_list_t *i = head; i != NULL;) {
-    port_list_t *del = i;
+    if (g_monitor_error)
+      ERROR("%s: Error received from OvSDB. Table: %s", plugin_name,
+            tables[i].name);
+  }
+}
 
-    for (interface_list_t *iface = i->iface; iface != NULL; iface = i->iface) {
-      interface_list_t *del2 = iface;
-      i->iface = iface->next;
-      sfree(del2);
-    }
+/* Delete all ports, interfaces and bridges */
+static void ovs_stats_free_all(void) {
+  /* Interfaces not listed by any port yet are only in the index */
+  ovs_stats_index_clear(&g_iface_index, /* free_ptr = */ true);
+  ovs_stats_index_clear(&g_port_index, /* free_ptr = */ false);
 
+  for (port_list_t *i = g_port_list_head; i != NULL;) {
+    port_list_t *del = i;
     i = i->next;
     sfree(del);
   }
+  g_port_list_head = NULL;
 }
 
 /* Delete all bridges from bridge list */
@@ -1271,8 +1357,7 @@ static void ovs_stats_conn_terminate() {
   pthread_mutex_lock(&g_stats_lock);
   ovs_stats_free_bridge_list(g_bridge_list_head);
   g_bridge_list_head = NULL;
-  ovs_stats_free_port_list(g_port_list_head);
-  g_port_list_head = NULL;
+  ovs_stats_free_all();
   pthread_mutex_unlock(&g_stats_lock);
 }
 
@@ -1341,6 +1426,11 @@ static int ovs_stats_plugin_config(oconfig_item_t *ci) {
         ERROR("%s: parse '%s' option failed", plugin_name, child->key);
         return -1;
       }
+    } else if (strcasecmp("SkipUnchanged", child->key) == 0) {
+      if (cf_util_get_boolean(child, &skip_unchanged) != 0) {
+        ERROR("%s: parse '%s' option failed", plugin_name, child->key);
+        return -1;
+      }
     } else {
       WARNING("%s: option '%s' not allowed here", plugin_name, child->key);
       goto cleanup_fail;
@@ -1388,13 +1478,24 @@ static int ovs_stats_plugin_read(__attribute__((unused)) user_data_t *ud) {
       continue;
 
     /* Skip port if it has no bridge */
-    if (!port->br)
+    if (!port->br || port->deleted)
       continue;
 
-    ovs_stats_submit_port(port);
+    bool changed = false;
+    for (interface_list_t *iface = port->iface; iface != NULL;
+         iface = iface->next)
+      changed = changed || (iface->changed && !iface->deleted);
 
-    if (interface_stats)
-      ovs_stats_submit_interfaces(port);
+    if (!skip_unchanged || changed) {
+      ovs_stats_submit_port(port);
+
+      if (interface_stats)
+        ovs_stats_submit_interfaces(port);
+    }
+
+    for (interface_list_t *iface = port->iface; iface != NULL;
+         iface = iface->next)
+      iface->changed = false;
   }
   pthread_mutex_unlock(&g_stats_lock);
   return 0;
@@ -1407,7 +1508,7 @@ static int ovs_stats_plugin_shutdown(void) {
   pthread_mutex_lock(&g_stats_lock);
   ovs_stats_free_bridge_list(g_bridge_list_head);
   ovs_stats_free_bridge_list(g_monitored_bridge_list_head);
-  ovs_stats_free_port_list(g_port_list_head);
+  ovs_stats_free_all();
   pthread_mutex_unlock(&g_stats_lock);
   pthread_mutex_destroy(&g_stats_lock);
   return 0;
@@ -68,8 +68,9 @@
 #define PLUGIN_NOTIF 5
 #define PLUGIN_FLUSH 6
 #define PLUGIN_FLUSH_ALL 7 /* For collectd-5.6 only */
+#define PLUGIN_WRITE_BATCH 8
 
-#define PLUGIN_TYPES 8
+#define PLUGIN_TYPES 9
 
 #define PLUGIN_CONFIG 254
 #define PLUGIN_DATASET 255
@@ -95,6 +96,7 @@ void boot_DynaLoader(PerlInterpreter *, CV *);
 
 static XS(Collectd_plugin_register_read);
 static XS(Collectd_plugin_register_write);
+static XS(Collectd_plugin_register_write_batch);
 static XS(Collectd_plugin_register_log);
 static XS(Collectd_plugin_register_notification);
 static XS(Collectd_plugin_register_flush);
@@ -117,6 +119,9 @@ static XS(Collectd_call_by_name);
 static int perl_read(user_data_t *ud);
 static int perl_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *user_data);
+static int perl_write_batch(const data_set_t *const *ds,
+                            const value_list_t *const *vl, size_t num,
+                            user_data_t *user_data);
 static void perl_log(int level, const char *msg, user_data_t *user_data);
 static int perl_notify(const notification_t *notif, user_data_t *user_data);
 static int perl_flush(cdtime_t timeout, const char *identifier,
@@ -132,10 +137,19 @@ typedef struct c_ithread_s {
   bool running; /* thread is inside Perl interpreter */
   bool shutdown;
   pthread_t pthread;
+  /* number of (nested) callbacks currently using the interpreter */
+  int depth;
+
+  /* cached data sets, see data_set2rv() */
+  HV *data_sets;
+  unsigned long data_sets_generation;
 
   /* double linked list of threads */
   struct c_ithread_s *prev;
   struct c_ithread_s *next;
+
+  /* single linked list of idle interpreters, see c_ithread_get() */
+  struct c_ithread_s *idle_next;
 } c_ithread_t;
 
 typedef struct {
@@ -149,6 +163,13 @@ typedef struct {
 
   pthread_mutex_t mutex;
   pthread_mutexattr_t mutexattr;
+
+  /* pool of interpreters cloned from the base interpreter */
+  c_ithread_t *idle;
+  int pool_size;
+  bool pool_shutdown;
+  pthread_mutex_t pool_lock;
+  pthread_cond_t pool_cond;
 } c_ithread_list_t;
 
 /* name / user_data for Perl matches / targets */
@@ -176,6 +197,14 @@ extern char **environ;
 
 static bool register_legacy_flush = true;
 
+/* maximum number of cloned interpreters; zero means no limit */
+static int max_interpreters;
+
+/* Incremented whenever a data set is (un)registered from Perl, so that the
+ * cached data sets get rebuilt. */
+static unsigned long data_sets_generation;
+static pthread_mutex_t data_sets_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* if perl_threads != NULL perl_threads->head must
  * point to the "base" thread */
 static c_ithread_list_t *perl_threads;
@@ -194,6 +223,8 @@ static struct {
 } api[] = {
     {"Collectd::plugin_register_read", Collectd_plugin_register_read},
     {"Collectd::plugin_register_write", Collectd_plugin_register_write},
+    {"Collectd::plugin_register_write_batch",
+     Collectd_plugin_register_write_batch},
     {"Collectd::plugin_register_log", Collectd_plugin_register_log},
     {"Collectd::plugin_register_notification",
      Collectd_plugin_register_notification},
@@ -223,6 +254,7 @@ struct {
 } constants[] = {{"Collectd::TYPE_INIT", PLUGIN_INIT},
                  {"Collectd::TYPE_READ", PLUGIN_READ},
                  {"Collectd::TYPE_WRITE", PLUGIN_WRITE},
+                 {"Collectd::TYPE_WRITE_BATCH", PLUGIN_WRITE_BATCH},
                  {"Collectd::TYPE_SHUTDOWN", PLUGIN_SHUTDOWN},
                  {"Collectd::TYPE_LOG", PLUGIN_LOG},
                  {"Collectd::TYPE_NOTIF", PLUGIN_NOTIF},
@@ -626,6 +658,53 @@ static int data_set2av(pTHX_ data_set_t *ds, AV *array) {
   return 0;
 } /* static int data_set2av (data_set_t *, AV *) */
 
+/*
+ * Returns a new reference to the data_set2av() representation of "ds". The
+ * arrays are cached per interpreter and shared by all callbacks, so they must
+ * not be modified.
+ */
+static SV *data_set2rv(pTHX_ const data_set_t *ds) {
+  c_ithread_t *t = (c_ithread_t *)pthread_getspecific(perl_thr_key);
+  unsigned long generation;
+  AV *array;
+  SV *ref;
+  SV **entry;
+
+  if (NULL == ds)
+    return NULL;
+
+  pthread_mutex_lock(&data_sets_lock);
+  generation = data_sets_generation;
+  pthread_mutex_unlock(&data_sets_lock);
+
+  if ((NULL != t) && (NULL != t->data_sets) &&
+      (t->data_sets_generation != generation)) {
+    SvREFCNT_dec((SV *)t->data_sets);
+    t->data_sets = NULL;
+  }
+
+  if ((NULL != t) && (NULL == t->data_sets)) {
+    t->data_sets = newHV();
+    t->data_sets_generation = generation;
+  }
+
+  if ((NULL != t) && (NULL != (entry = hv_fetch(t->data_sets, ds->type,
+                                                strlen(ds->type), 0))))
+    return newSVsv(*entry);
+
+  array = newAV();
+  if (0 != data_set2av(aTHX_(data_set_t *) ds, array)) {
+    SvREFCNT_dec((SV *)array);
+    return NULL;
+  }
+  ref = newRV_noinc((SV *)array);
+
+  if ((NULL == t) ||
+      (NULL == hv_store(t->data_sets, ds->type, strlen(ds->type), ref, 0)))
+    return ref;
+  return newSVsv(ref);
+} /* static SV *data_set2rv (const data_set_t *) */
+
 static int value_list2hv(pTHX_ value_list_t *vl, data_set_t *ds, HV *hash) {
   AV *values = NULL;
   size_t i;
@@ -887,6 +966,10 @@ static int pplugin_register_data_set(pTHX_ char *name, AV *dataset) {
 
   ret = plugin_register_data_set(&ds);
 
+  pthread_mutex_lock(&data_sets_lock);
+  ++data_sets_generation;
+  pthread_mutex_unlock(&data_sets_lock);
+
   free(ds.ds);
   return ret;
 } /* static int pplugin_register_data_set (char *, SV *) */
@@ -897,6 +980,11 @@ static int pplugin_register_data_set(pTHX_ char *name, AV *dataset) {
 static int pplugin_unregister_data_set(char *name) {
   if (NULL == name)
     return 0;
+
+  pthread_mutex_lock(&data_sets_lock);
+  ++data_sets_generation;
+  pthread_mutex_unlock(&data_sets_lock);
+
   return plugin_unregister_data_set(name);
 } /* static int pplugin_unregister_data_set (char *) */
 
@@ -1021,7 +1109,7 @@ static int pplugin_call(pTHX_ int type, ...) {
     data_set_t *ds;
     value_list_t *vl;
 
-    AV *pds = newAV();
+    SV *pds;
     HV *pvl = newHV();
 
     subname = va_arg(ap, char *);
@@ -1053,10 +1141,8 @@ static int pplugin_call(pTHX_ int type, ...) {
     ds = va_arg(ap, data_set_t *);
     vl = va_arg(ap, value_list_t *);
 
-    if (-1 == data_set2av(aTHX_ ds, pds)) {
-      av_clear(pds);
-      av_undef(pds);
-      pds = (AV *)&PL_sv_undef;
+    if (NULL == (pds = data_set2rv(aTHX_ ds))) {
+      pds = &PL_sv_undef;
       ret = -1;
     }
 
@@ -1068,8 +1154,54 @@ static int pplugin_call(pTHX_ int type, ...) {
     }
 
     XPUSHs(sv_2mortal(newSVpv(ds->type, 0)));
-    XPUSHs(sv_2mortal(newRV_noinc((SV *)pds)));
+    XPUSHs(sv_2mortal(pds));
     XPUSHs(sv_2mortal(newRV_noinc((SV *)pvl)));
+  } else if (PLUGIN_WRITE_BATCH == type) {
+    const data_set_t *const *ds;
+    const value_list_t *const *vl;
+    size_t num;
+
+    AV *pvls = newAV();
+    AV *pdss = newAV();
+
+    subname = va_arg(ap, char *);
+    /*
+     * $_[0] = [ $value_list, ... ];
+     *
+     * $_[1] = [ $data_set, ... ];
+     *
+     * The layout of the value lists and data sets is the same as above. The
+     * n-th data set belongs to the n-th value list.
+     */
+    ds = va_arg(ap, const data_set_t *const *);
+    vl = va_arg(ap, const value_list_t *const *);
+    num = va_arg(ap, size_t);
+
+    if (0 < num) {
+      av_extend(pvls, num - 1);
+      av_extend(pdss, num - 1);
+    }
+
+    for (size_t i = 0; i < num; ++i) {
+      HV *pvl = newHV();
+      SV *pds = data_set2rv(aTHX_ ds[i]);
+
+      if ((NULL == pds) ||
+          (-1 == value_list2hv(aTHX_(value_list_t *) vl[i],
+                               (data_set_t *)ds[i], pvl))) {
+        if (NULL != pds)
+          SvREFCNT_dec(pds);
+        SvREFCNT_dec((SV *)pvl);
+        ret = -1;
+        continue;
+      }
+
+      av_push(pvls, newRV_noinc((SV *)pvl));
+      av_push(pdss, pds);
+    }
+
+    XPUSHs(sv_2mortal(newRV_noinc((SV *)pvls)));
+    XPUSHs(sv_2mortal(newRV_noinc((SV *)pdss)));
   } else if (PLUGIN_LOG == type) {
     subname = va_arg(ap, char *);
     /*
@@ -1228,6 +1360,12 @@ static void c_ithread_destructor(void *arg) {
   c_ithread_destroy(ithread);
 
   pthread_mutex_unlock(&perl_threads->mutex);
+
+  /* The thread exited while using a pooled interpreter. */
+  pthread_mutex_lock(&perl_threads->pool_lock);
+  --perl_threads->pool_size;
+  pthread_cond_signal(&perl_threads->pool_cond);
+  pthread_mutex_unlock(&perl_threads->pool_lock);
   return;
 } /* static void c_ithread_destructor (void *) */
 
@@ -1274,6 +1412,74 @@ static c_ithread_t *c_ithread_create(PerlInterpreter *base) {
   return t;
 } /* static c_ithread_t *c_ithread_create (PerlInterpreter *) */
 
+/*
+ * Returns the interpreter to run a callback in. Nested callbacks and the main
+ * thread keep using their interpreter. Other threads take an idle interpreter
+ * from the pool, or clone a new one if the pool has less than
+ * "MaxInterpreters" interpreters, and wait for one to become idle otherwise.
+ * Each call has to be matched by a call to c_ithread_put().
+ */
+static c_ithread_t *c_ithread_get(void) {
+  c_ithread_t *t = (c_ithread_t *)pthread_getspecific(perl_thr_key);
+
+  if (NULL != t) {
+    ++t->depth;
+    return t;
+  }
+
+  pthread_mutex_lock(&perl_threads->pool_lock);
+  while ((NULL == perl_threads->idle) && !perl_threads->pool_shutdown &&
+         (0 < max_interpreters) &&
+         (perl_threads->pool_size >= max_interpreters))
+    pthread_cond_wait(&perl_threads->pool_cond, &perl_threads->pool_lock);
+
+  if (perl_threads->pool_shutdown) {
+    pthread_mutex_unlock(&perl_threads->pool_lock);
+    return NULL;
+  }
+
+  t = perl_threads->idle;
+  if (NULL != t) {
+    perl_threads->idle = t->idle_next;
+    t->idle_next = NULL;
+    pthread_mutex_unlock(&perl_threads->pool_lock);
+
+    PERL_SET_CONTEXT(t->interp);
+    pthread_setspecific(perl_thr_key, (const void *)t);
+  } else {
+    ++perl_threads->pool_size;
+    pthread_mutex_unlock(&perl_threads->pool_lock);
+
+    /* Cloning must not run concurrently to the base interpreter, see
+     * perl_init(). */
+    pthread_mutex_lock(&perl_threads->mutex);
+    t = c_ithread_create(perl_threads->head->interp);
+    pthread_mutex_unlock(&perl_threads->mutex);
+  }
+
+  t->pthread = pthread_self();
+  t->depth = 1;
+  return t;
+} /* static c_ithread_t *c_ithread_get (void) */
+
+static void c_ithread_put(c_ithread_t *t) {
+  if (0 < --t->depth)
+    return;
+
+  /* The base interpreter belongs to the main thread. */
+  if (t == perl_threads->head)
+    return;
+
+  pthread_setspecific(perl_thr_key, NULL);
+  PERL_SET_CONTEXT(NULL);
+
+  pthread_mutex_lock(&perl_threads->pool_lock);
+  t->idle_next = perl_threads->idle;
+  perl_threads->idle = t;
+  pthread_cond_signal(&perl_threads->pool_cond);
+  pthread_mutex_unlock(&perl_threads->pool_lock);
+} /* static void c_ithread_put (c_ithread_t *) */
+
 /*
  * Filter chains implementation.
  */
@@ -1418,33 +1624,27 @@ static int fc_call(pTHX_ int type, int cb_type, pfc_user_data_t *data, ...) {
 
 static int fc_create(int type, const oconfig_item_t *ci, void **user_data) {
   pfc_user_data_t *data;
+  c_ithread_t *t;
 
   int ret = 0;
 
-  dTHX;
-
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
-
-  log_debug("fc_create: c_ithread: interp = %p (active threads: %i)", aTHX,
-            perl_threads->number_of_threads);
-
   if ((1 != ci->values_num) || (OCONFIG_TYPE_STRING != ci->values[0].type)) {
     log_warn("A \"%s\" block expects a single string argument.",
              (FC_MATCH == type) ? "Match" : "Target");
     return -1;
   }
 
+  if (NULL == (t = c_ithread_get()))
+    return 0;
+
+  dTHXa(t->interp);
+
+  log_debug("fc_create: c_ithread: interp = %p (active threads: %i)", aTHX,
+            perl_threads->number_of_threads);
+
   data = smalloc(sizeof(*data));
   data->name = sstrdup(ci->values[0].value.string);
   data->user_data = newSV(0);
@@ -1455,28 +1655,25 @@ static int fc_create(int type, const oconfig_item_t *ci, void **user_data) {
     PFC_USER_DATA_FREE(data);
   else
     *user_data = data;
+
+  c_ithread_put(t);
   return ret;
 } /* static int fc_create (int, const oconfig_item_t *, void **) */
 
 static int fc_destroy(int type, void **user_data) {
   pfc_user_data_t *data = *(pfc_user_data_t **)user_data;
 
-  int ret = 0;
+  c_ithread_t *t;
 
-  dTHX;
+  int ret = 0;
 
   if ((NULL == perl_threads) || (NULL == data))
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    aTHX = t->interp;
-  }
+  dTHXa(t->interp);
 
   log_debug("fc_destroy: c_ithread: interp = %p (active threads: %i)", aTHX,
             perl_threads->number_of_threads);
@@ -1485,34 +1682,34 @@ static int fc_destroy(int type, void **user_data) {
 
   PFC_USER_DATA_FREE(data);
   *user_data = NULL;
+
+  c_ithread_put(t);
   return ret;
 } /* static int fc_destroy (int, void **) */
 
 static int fc_exec(int type, const data_set_t *ds, const value_list_t *vl,
                    notification_meta_t **meta, void **user_data) {
   pfc_user_data_t *data = *(pfc_user_data_t **)user_data;
-
-  dTHX;
+  c_ithread_t *t;
+  int ret;
 
   if (NULL == perl_threads)
     return 0;
 
   assert(NULL != data);
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    aTHX = t->interp;
-  }
+  dTHXa(t->interp);
 
   log_debug("fc_exec: c_ithread: interp = %p (active threads: %i)", aTHX,
             perl_threads->number_of_threads);
 
-  return fc_call(aTHX_ type, FC_CB_EXEC, data, ds, vl, meta);
+  ret = fc_call(aTHX_ type, FC_CB_EXEC, data, ds, vl, meta);
+
+  c_ithread_put(t);
+  return ret;
 } /* static int fc_exec (int, const data_set_t *, const value_list_t *,
                 notification_meta_t **, void **) */
 
@@ -1597,6 +1794,8 @@ static void _plugin_register_generic_userdata(pTHX, int type,
         &userdata);
   } else if (PLUGIN_WRITE == type) {
     ret = plugin_register_write(pluginname, perl_write, &userdata);
+  } else if (PLUGIN_WRITE_BATCH == type) {
+    ret = plugin_register_write_batch(pluginname, perl_write_batch, &userdata);
   } else if (PLUGIN_LOG == type) {
     ret = plugin_register_log(pluginname, perl_log, &userdata);
   } else if (PLUGIN_NOTIF == type) {
@@ -1640,6 +1839,10 @@ static XS(Collectd_plugin_register_write) {
   _plugin_register_generic_userdata(aTHX, PLUGIN_WRITE, "write");
 }
 
+static XS(Collectd_plugin_register_write_batch) {
+  _plugin_register_generic_userdata(aTHX, PLUGIN_WRITE_BATCH, "write_batch");
+}
+
 static XS(Collectd_plugin_register_log) {
   _plugin_register_generic_userdata(aTHX, PLUGIN_LOG, "log");
 }
@@ -2092,20 +2295,16 @@ static int perl_init(void) {
 } /* static int perl_init (void) */
 
 static int perl_read(user_data_t *user_data) {
-  dTHX;
+  c_ithread_t *t;
+  int ret;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
+  dTHXa(t->interp);
 
   /* Assert that we're not running as the base thread. Otherwise, we might
    * run into concurrency issues with c_ithread_create(). See
@@ -2115,26 +2314,24 @@ static int perl_read(user_data_t *user_data) {
   log_debug("perl_read: c_ithread: interp = %p (active threads: %i)", aTHX,
             perl_threads->number_of_threads);
 
-  return pplugin_call(aTHX_ PLUGIN_READ, user_data->data);
+  ret = pplugin_call(aTHX_ PLUGIN_READ, user_data->data);
+
+  c_ithread_put(t);
+  return ret;
 } /* static int perl_read (user_data_t *user_data) */
 
 static int perl_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *user_data) {
+  c_ithread_t *t;
   int status;
-  dTHX;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    aTHX = t->interp;
-  }
+  dTHXa(t->interp);
 
   /* Lock the base thread if this is not called from one of the read threads
    * to avoid race conditions with c_ithread_create(). See
@@ -2149,24 +2346,50 @@ static int perl_write(const data_set_t *ds, const value_list_t *vl,
   if (aTHX == perl_threads->head->interp)
     pthread_mutex_unlock(&perl_threads->mutex);
 
+  c_ithread_put(t);
   return status;
 } /* static int perl_write (const data_set_t *, const value_list_t *) */
 
-static void perl_log(int level, const char *msg, user_data_t *user_data) {
-  dTHX;
+static int perl_write_batch(const data_set_t *const *ds,
+                            const value_list_t *const *vl, size_t num,
+                            user_data_t *user_data) {
+  c_ithread_t *t;
+  int status;
 
   if (NULL == perl_threads)
-    return;
+    return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
+  if (NULL == (t = c_ithread_get()))
+    return 0;
+
+  dTHXa(t->interp);
 
+  /* See perl_write(). */
+  if (aTHX == perl_threads->head->interp)
     pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
+
+  log_debug("perl_write_batch: c_ithread: interp = %p (active threads: %i)",
+            aTHX, perl_threads->number_of_threads);
+  status =
+      pplugin_call(aTHX_ PLUGIN_WRITE_BATCH, user_data->data, ds, vl, num);
+
+  if (aTHX == perl_threads->head->interp)
     pthread_mutex_unlock(&perl_threads->mutex);
 
-    aTHX = t->interp;
-  }
+  c_ithread_put(t);
+  return status;
+} /* static int perl_write_batch (const data_set_t *const *, ...) */
+
+static void perl_log(int level, const char *msg, user_data_t *user_data) {
+  c_ithread_t *t;
+
+  if (NULL == perl_threads)
+    return;
+
+  if (NULL == (t = c_ithread_get()))
+    return;
+
+  dTHXa(t->interp);
 
   /* Lock the base thread if this is not called from one of the read threads
    * to avoid race conditions with c_ithread_create(). See
@@ -2181,49 +2404,50 @@ static void perl_log(int level, const char *msg, user_data_t *user_data) {
   if (aTHX == perl_threads->head->interp)
     pthread_mutex_unlock(&perl_threads->mutex);
 
+  c_ithread_put(t);
   return;
 } /* static void perl_log (int, const char *) */
 
 static int perl_notify(const notification_t *notif, user_data_t *user_data) {
-  dTHX;
+  c_ithread_t *t;
+  int ret;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  dTHXa(t->interp);
 
-    aTHX = t->interp;
-  }
-  return pplugin_call(aTHX_ PLUGIN_NOTIF, user_data->data, notif);
+  ret = pplugin_call(aTHX_ PLUGIN_NOTIF, user_data->data, notif);
+
+  c_ithread_put(t);
+  return ret;
 } /* static int perl_notify (const notification_t *) */
 
 static int perl_flush(cdtime_t timeout, const char *identifier,
                       user_data_t *user_data) {
-  dTHX;
+  c_ithread_t *t;
+  int ret;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  if (NULL == (t = c_ithread_get()))
+    return 0;
 
-    aTHX = t->interp;
-  }
+  dTHXa(t->interp);
 
   /* For collectd-5.6 only, #1731 */
   if (user_data == NULL || user_data->data == NULL)
-    return pplugin_call(aTHX_ PLUGIN_FLUSH_ALL, timeout, identifier);
+    ret = pplugin_call(aTHX_ PLUGIN_FLUSH_ALL, timeout, identifier);
+  else
+    ret = pplugin_call(aTHX_ PLUGIN_FLUSH, user_data->data, timeout,
+                       identifier);
 
-  return pplugin_call(aTHX_ PLUGIN_FLUSH, user_data->data, timeout, identifier);
+  c_ithread_put(t);
+  return ret;
 } /* static int perl_flush (const int) */
 
 static int perl_shutdown(void) {
@@ -2254,6 +2478,12 @@ static int perl_shutdown(void) {
 
   ret = pplugin_call(aTHX_ PLUGIN_SHUTDOWN);
 
+  /* Threads waiting for an idle interpreter give up. */
+  pthread_mutex_lock(&perl_threads->pool_lock);
+  perl_threads->pool_shutdown = true;
+  pthread_cond_broadcast(&perl_threads->pool_cond);
+  pthread_mutex_unlock(&perl_threads->pool_lock);
+
   pthread_mutex_lock(&perl_threads->mutex);
   t = perl_threads->tail;
 
@@ -2283,6 +2513,8 @@ static int perl_shutdown(void) {
   pthread_mutex_unlock(&perl_threads->mutex);
   pthread_mutex_destroy(&perl_threads->mutex);
   pthread_mutexattr_destroy(&perl_threads->mutexattr);
+  pthread_mutex_destroy(&perl_threads->pool_lock);
+  pthread_cond_destroy(&perl_threads->pool_cond);
 
   sfree(perl_threads);
 
@@ -2435,6 +2667,8 @@ static int init_pi(int argc, char **argv) {
   pthread_mutexattr_init(&perl_threads->mutexattr);
   pthread_mutexattr_settype(&perl_threads->mutexattr, PTHREAD_MUTEX_RECURSIVE);
   pthread_mutex_init(&perl_threads->mutex, &perl_threads->mutexattr);
+  pthread_mutex_init(&perl_threads->pool_lock, NULL);
+  pthread_cond_init(&perl_threads->pool_cond, NULL);
   /* locking the mutex should not be necessary at this point
    * but let's just do it for the sake of completeness */
   pthread_mutex_lock(&perl_threads->mutex);
@@ -2603,6 +2837,28 @@ static int perl_config_includedir(pTHX_ oconfig_item_t *ci) {
   return 0;
 } /* static int perl_config_includedir (oconfig_item_it *) */
 
+/*
+ * MaxInterpreters <Number>
+ */
+static int perl_config_maxinterpreters(oconfig_item_t *ci) {
+  int value = 0;
+
+  if (0 != cf_util_get_int(ci, &value))
+    return 1;
+
+  if (0 > value) {
+    log_err("MaxInterpreters must not be negative.");
+    return 1;
+  }
+
+  if (NULL != perl_threads)
+    log_warn("MaxInterpreters has no effect on interpreters that have been "
+             "cloned already.");
+
+  max_interpreters = value;
+  return 0;
+} /* static int perl_config_maxinterpreters (oconfig_item_it *) */
+
 /*
  * <Plugin> block
  */
@@ -2689,6 +2945,8 @@ static int perl_config(oconfig_item_t *ci) {
       current_status = perl_config_plugin(aTHX_ c);
     else if (0 == strcasecmp(c->key, "RegisterLegacyFlush"))
       cf_util_get_boolean(c, &register_legacy_flush);
+    else if (0 == strcasecmp(c->key, "MaxInterpreters"))
+      current_status = perl_config_maxinterpreters(c);
     else {
       log_warn("Ignoring unknown config key \"%s\".", c->key);
       current_status = 0;
@@ -23,13 +23,14 @@
  *   Florian Forster <octo at collectd.org>
  **/
 
+#define _GNU_SOURCE /* For recvmmsg(2) */
+
 #include "collectd.h"
 
 #include "plugin.h"
 #include "utils/common/common.h"
 
 #include <netdb.h>
-#include <poll.h>
 
 #include "pinba.pb-c.h"
 
@@ -57,16 +58,18 @@
 #define PINBA_MAX_SOCKETS 16
 #endif
 
+/* Number of packets read with one recvmmsg(2) call. */
+#ifndef PINBA_BATCH_SIZE
+#define PINBA_BATCH_SIZE 16
+#endif
+
+/* Initial size of the memory packets are unpacked into. */
+#define PINBA_ARENA_SIZE 65536
+
 /*
  * Private data structures
  */
 /* {{{ */
-struct pinba_socket_s {
-  struct pollfd fd[PINBA_MAX_SOCKETS];
-  nfds_t fd_num;
-};
-typedef struct pinba_socket_s pinba_socket_t;
-
 /* Fixed point counter value. n is the decimal part multiplied by 10^9. */
 struct float_counter_s {
   uint64_t i;
@@ -93,6 +96,44 @@ struct pinba_statnode_s {
   gauge_t mem_peak;
 };
 typedef struct pinba_statnode_s pinba_statnode_t;
+
+/* Memory requests are unpacked into. Unpacking takes memory from one block
+ * and only falls back to malloc when the block is full; everything is given
+ * back at once by pinba_arena_reset, which also grows the block if it was
+ * too small. */
+struct pinba_arena_s {
+  char *base;
+  size_t size;
+  size_t used;
+
+  void **overflow;
+  size_t overflow_num;
+  size_t overflow_size;
+};
+typedef struct pinba_arena_s pinba_arena_t;
+
+/* A set of listening sockets, one per address, which are read by the
+ * daemon's event loop. It adds the requests it receives to its own copy of
+ * the counters of all views, which only plugin_read ever contends for, and
+ * which it merges into "stat_nodes". */
+struct pinba_receiver_s {
+  int fds[PINBA_MAX_SOCKETS];
+  size_t fds_num;
+
+  pthread_mutex_t lock;
+  pinba_statnode_t *nodes; /* stat_nodes_num entries, no strings */
+};
+typedef struct pinba_receiver_s pinba_receiver_t;
+
+/* A socket of a receiver. Each socket has its own buffer and arena, so that
+ * the sockets of one receiver can be read in parallel. */
+struct pinba_socket_s {
+  int fd;
+  pinba_receiver_t *receiver;
+  uint8_t *buffer; /* PINBA_BATCH_SIZE * PINBA_UDP_BUFFER_SIZE bytes */
+  pinba_arena_t arena;
+};
+typedef struct pinba_socket_s pinba_socket_t;
 /* }}} */
 
 /*
@@ -106,9 +147,10 @@ static pthread_mutex_t stat_nodes_lock;
 static char *conf_node;
 static char *conf_service;
 
-static bool collector_thread_running;
-static bool collector_thread_do_shutdown;
-static pthread_t collector_thread_id;
+static int conf_receive_threads = 1;
+
+static pinba_receiver_t *receivers;
+static size_t receivers_num;
 /* }}} */
 
 /*
@@ -134,6 +176,18 @@ static void float_counter_add(float_counter_t *fc, float val) /* {{{ */
   }
 } /* }}} void float_counter_add */
 
+static void float_counter_merge(float_counter_t *fc, /* {{{ */
+                                const float_counter_t *other) {
+  fc->i += other->i;
+  fc->n += other->n;
+
+  if (fc->n >= 1000000000) {
+    fc->i += 1;
+    fc->n -= 1000000000;
+    assert(fc->n < 1000000000);
+  }
+} /* }}} void float_counter_merge */
+
 static derive_t float_counter_get(const float_counter_t *fc, /* {{{ */
                                   uint64_t factor) {
   derive_t ret;
@@ -192,6 +246,39 @@ static void service_statnode_add(const char *name, /* {{{ */
   stat_nodes_num++;
 } /* }}} void service_statnode_add */
 
+static void service_statnode_reset(pinba_statnode_t *node) /* {{{ */
+{
+  memset(node, 0, sizeof(*node));
+  node->mem_peak = NAN;
+} /* }}} void service_statnode_reset */
+
+/* Adds the counters of all receivers to "stat_nodes" and resets them.
+ * Must hold "stat_nodes_lock" when calling this function. */
+static void service_statnode_merge(void) /* {{{ */
+{
+  for (size_t i = 0; i < receivers_num; i++) {
+    pinba_receiver_t *r = receivers + i;
+
+    pthread_mutex_lock(&r->lock);
+    for (unsigned int j = 0; j < stat_nodes_num; j++) {
+      pinba_statnode_t *node = stat_nodes + j;
+      pinba_statnode_t *delta = r->nodes + j;
+
+      node->req_count += delta->req_count;
+      float_counter_merge(&node->req_time, &delta->req_time);
+      float_counter_merge(&node->ru_utime, &delta->ru_utime);
+      float_counter_merge(&node->ru_stime, &delta->ru_stime);
+      node->doc_size += delta->doc_size;
+
+      if (isnan(node->mem_peak) || (node->mem_peak < delta->mem_peak))
+        node->mem_peak = delta->mem_peak;
+
+      service_statnode_reset(delta);
+    }
+    pthread_mutex_unlock(&r->lock);
+  }
+} /* }}} void service_statnode_merge */
+
 /* Copy the data from the global "stat_nodes" list into the buffer pointed to
  * by "res", doing the derivation in the process. Returns the next index or
  * zero if the end of the list has been reached. */
@@ -203,8 +290,10 @@ static unsigned int service_statnode_collect(pinba_statnode_t *res, /* {{{ */
     return 0;
 
   /* begin collecting */
-  if (index == 0)
+  if (index == 0) {
     pthread_mutex_lock(&stat_nodes_lock);
+    service_statnode_merge();
+  }
 
   /* end collecting */
   if (index >= stat_nodes_num) {
@@ -237,10 +326,12 @@ static void service_statnode_process(pinba_statnode_t *node, /* {{{ */
 
 } /* }}} void service_statnode_process */
 
-static void service_process_request(Pinba__Request *request) /* {{{ */
-{
-  pthread_mutex_lock(&stat_nodes_lock);
-
+/* Adds "request" to the counters of the receiver "r". Must hold the
+ * lock of "r" when calling this function. The views in "stat_nodes" don't
+ * change while receivers are listening, so they are read without taking
+ * "stat_nodes_lock". */
+static void service_process_request(pinba_receiver_t *r, /* {{{ */
+                                    Pinba__Request *request) {
   for (unsigned int i = 0; i < stat_nodes_num; i++) {
     if ((stat_nodes[i].host != NULL) &&
         (strcmp(request->hostname, stat_nodes[i].host) != 0))
@@ -254,34 +345,189 @@ static void service_process_request(Pinba__Request *request) /* {{{ */
         (strcmp(request->script_name, stat_nodes[i].script) != 0))
       continue;
 
-    service_statnode_process(&stat_nodes[i], request);
+    service_statnode_process(&r->nodes[i], request);
   }
-
-  pthread_mutex_unlock(&stat_nodes_lock);
 } /* }}} void service_process_request */
 
-static int pb_del_socket(pinba_socket_t *s, /* {{{ */
-                         nfds_t index) {
-  if (index >= s->fd_num)
-    return EINVAL;
+static void *pinba_arena_alloc(void *arg, size_t size) /* {{{ */
+{
+  pinba_arena_t *a = arg;
 
-  close(s->fd[index].fd);
-  s->fd[index].fd = -1;
+  /* Keep everything aligned for doubles and pointers. */
+  size = (size + 15) & ~((size_t)15);
 
-  /* When deleting the last element in the list, no memmove is necessary. */
-  if (index < (s->fd_num - 1)) {
-    memmove(&s->fd[index], &s->fd[index + 1],
-            sizeof(s->fd[0]) * (s->fd_num - (index + 1)));
+  if ((a->size - a->used) >= size) {
+    void *ptr = a->base + a->used;
+    a->used += size;
+    return ptr;
   }
 
-  s->fd_num--;
-  return 0;
-} /* }}} int pb_del_socket */
+  void **tmp =
+      realloc(a->overflow, sizeof(*a->overflow) * (a->overflow_num + 1));
+  if (tmp == NULL)
+    return NULL;
+  a->overflow = tmp;
+
+  void *ptr = malloc(size);
+  if (ptr == NULL)
+    return NULL;
+
+  a->overflow[a->overflow_num] = ptr;
+  a->overflow_num++;
+  a->overflow_size += size;
+  return ptr;
+} /* }}} void *pinba_arena_alloc */
+
+/* Memory is only given back by pinba_arena_reset. */
+static void pinba_arena_free(void *arg, void *ptr) /* {{{ */
+{
+} /* }}} void pinba_arena_free */
+
+static void pinba_arena_reset(pinba_arena_t *a) /* {{{ */
+{
+  for (size_t i = 0; i < a->overflow_num; i++)
+    sfree(a->overflow[i]);
+  a->overflow_num = 0;
+
+  /* If the block was too small, replace it with one large enough for the
+   * request that didn't fit. */
+  if (a->overflow_size > 0) {
+    size_t size = a->size;
+    while (size < (a->used + a->overflow_size))
+      size *= 2;
+
+    char *base = malloc(size);
+    if (base != NULL) {
+      sfree(a->base);
+      a->base = base;
+      a->size = size;
+    }
+    a->overflow_size = 0;
+  }
+
+  a->used = 0;
+} /* }}} void pinba_arena_reset */
+
+static void pinba_arena_destroy(pinba_arena_t *a) /* {{{ */
+{
+  pinba_arena_reset(a);
+  sfree(a->overflow);
+  sfree(a->base);
+  a->size = 0;
+} /* }}} void pinba_arena_destroy */
+
+/* Must hold the lock of "r" when calling this function. */
+static int pinba_process_stats_packet(pinba_receiver_t *r, /* {{{ */
+                                      pinba_arena_t *arena,
+                                      const uint8_t *buffer,
+                                      size_t buffer_size) {
+  ProtobufCAllocator allocator = {
+      .alloc = pinba_arena_alloc,
+      .free = pinba_arena_free,
+      .allocator_data = arena,
+  };
+  Pinba__Request *request;
+
+  request = pinba__request__unpack(&allocator, buffer_size, buffer);
+
+  if (request != NULL)
+    service_process_request(r, request);
+
+  /* The request lives in the arena, so there is no need to call
+   * pinba__request__free_unpacked. */
+  pinba_arena_reset(arena);
+
+  return (request != NULL) ? 0 : -1;
+} /* }}} int pinba_process_stats_packet */
+
+/* Called by the daemon's event loop. Reads up to PINBA_BATCH_SIZE packets
+ * from "sock" without blocking and adds them to the counters of the socket's
+ * receiver. */
+static void pinba_udp_read_callback_fn(int sock, user_data_t *ud) /* {{{ */
+{
+  pinba_socket_t *s = ud->data;
+  pinba_receiver_t *r = s->receiver;
+  uint8_t *buffer = s->buffer;
+
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[PINBA_BATCH_SIZE];
+  struct iovec iov[PINBA_BATCH_SIZE];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < PINBA_BATCH_SIZE; i++) {
+    iov[i].iov_base = buffer + i * PINBA_UDP_BUFFER_SIZE;
+    iov[i].iov_len = PINBA_UDP_BUFFER_SIZE;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int status;
+  do {
+    status = recvmmsg(sock, msgs, PINBA_BATCH_SIZE, MSG_DONTWAIT,
+                      /* timeout = */ NULL);
+  } while ((status < 0) && (errno == EINTR));
 
-static int pb_add_socket(pinba_socket_t *s, /* {{{ */
-                         const struct addrinfo *ai) {
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return;
 
-  if (s->fd_num == PINBA_MAX_SOCKETS) {
+    WARNING("pinba plugin: recvmmsg(2) failed: %s", STRERRNO);
+    return;
+  }
+
+  int failed = 0;
+  pthread_mutex_lock(&r->lock);
+  for (int i = 0; i < status; i++) {
+    if (pinba_process_stats_packet(r, &s->arena,
+                                   buffer + i * PINBA_UDP_BUFFER_SIZE,
+                                   msgs[i].msg_len) != 0)
+      failed++;
+  }
+  pthread_mutex_unlock(&r->lock);
+
+  if (failed > 0)
+    DEBUG("pinba plugin: Parsing %d packet(s) failed.", failed);
+#else
+  ssize_t status;
+
+  do {
+    status = recv(sock, buffer, PINBA_UDP_BUFFER_SIZE, MSG_DONTWAIT);
+  } while ((status < 0) && (errno == EINTR));
+
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return;
+
+    WARNING("pinba plugin: recv(2) failed: %s", STRERRNO);
+    return;
+  } else if (status == 0) {
+    DEBUG("pinba plugin: recv(2) returned unexpected status zero.");
+    return;
+  }
+
+  pthread_mutex_lock(&r->lock);
+  int ret = pinba_process_stats_packet(r, &s->arena, buffer, (size_t)status);
+  pthread_mutex_unlock(&r->lock);
+
+  if (ret != 0)
+    DEBUG("pinba plugin: Parsing packet failed.");
+#endif
+} /* }}} void pinba_udp_read_callback_fn */
+
+static void pinba_socket_free(void *arg) /* {{{ */
+{
+  pinba_socket_t *s = arg;
+
+  close(s->fd);
+  sfree(s->buffer);
+  pinba_arena_destroy(&s->arena);
+  sfree(s);
+} /* }}} void pinba_socket_free */
+
+static int pb_add_socket(pinba_receiver_t *r, /* {{{ */
+                         const struct addrinfo *ai, bool reuse_port) {
+
+  if (r->fds_num == PINBA_MAX_SOCKETS) {
     WARNING("pinba plugin: Sorry, you have hit the built-in limit of "
             "%i sockets. Please complain to the collectd developers so we can "
             "raise the limit.",
@@ -300,6 +546,15 @@ static int pb_add_socket(pinba_socket_t *s, /* {{{ */
     WARNING("pinba plugin: setsockopt(SO_REUSEADDR) failed: %s", STRERRNO);
   }
 
+#ifdef SO_REUSEPORT
+  if (reuse_port &&
+      (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) != 0)) {
+    ERROR("pinba plugin: setsockopt(SO_REUSEPORT) failed: %s", STRERRNO);
+    close(fd);
+    return 0;
+  }
+#endif
+
   status = bind(fd, ai->ai_addr, ai->ai_addrlen);
   if (status != 0) {
     ERROR("pinba plugin: bind(2) failed: %s", STRERRNO);
@@ -307,17 +562,46 @@ static int pb_add_socket(pinba_socket_t *s, /* {{{ */
     return 0;
   }
 
-  s->fd[s->fd_num].fd = fd;
-  s->fd[s->fd_num].events = POLLIN | POLLPRI;
-  s->fd[s->fd_num].revents = 0;
-  s->fd_num++;
+  pinba_socket_t *s = calloc(1, sizeof(*s));
+  if (s == NULL) {
+    ERROR("pinba plugin: calloc failed.");
+    close(fd);
+    return 0;
+  }
+  s->fd = fd;
+  s->receiver = r;
+  s->buffer = malloc(PINBA_BATCH_SIZE * PINBA_UDP_BUFFER_SIZE);
+  s->arena.base = malloc(PINBA_ARENA_SIZE);
+  if ((s->buffer == NULL) || (s->arena.base == NULL)) {
+    ERROR("pinba plugin: malloc failed.");
+    pinba_socket_free(s);
+    return 0;
+  }
+  s->arena.size = PINBA_ARENA_SIZE;
+
+  /* The socket is closed by pinba_socket_free once it is unregistered. */
+  status = plugin_register_fd(fd, pinba_udp_read_callback_fn,
+                              &(user_data_t){
+                                  .data = s,
+                                  .free_func = pinba_socket_free,
+                              });
+  if (status != 0) {
+    pinba_socket_free(s);
+    return 0;
+  }
+
+  r->fds[r->fds_num] = fd;
+  r->fds_num++;
 
   return 0;
 } /* }}} int pb_add_socket */
 
-static pinba_socket_t *pinba_socket_open(const char *node, /* {{{ */
-                                         const char *service) {
-  pinba_socket_t *s;
+/* Opens the sockets of "r". With "reuse_port", the sockets are opened with
+ * SO_REUSEPORT so that every receiver can open its own set of sockets and the
+ * kernel distributes packets among them. */
+static int pinba_socket_open(pinba_receiver_t *r, /* {{{ */
+                             const char *node, const char *service,
+                             bool reuse_port) {
   struct addrinfo *ai_list;
   int status;
 
@@ -334,162 +618,42 @@ static pinba_socket_t *pinba_socket_open(const char *node, /* {{{ */
   status = getaddrinfo(node, service, &ai_hints, &ai_list);
   if (status != 0) {
     ERROR("pinba plugin: getaddrinfo(3) failed: %s", gai_strerror(status));
-    return NULL;
+    return -1;
   }
   assert(ai_list != NULL);
 
-  s = calloc(1, sizeof(*s));
-  if (s == NULL) {
-    freeaddrinfo(ai_list);
-    ERROR("pinba plugin: calloc failed.");
-    return NULL;
-  }
-
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
-    status = pb_add_socket(s, ai_ptr);
+    status = pb_add_socket(r, ai_ptr, reuse_port);
     if (status != 0)
       break;
   } /* for (ai_list) */
 
   freeaddrinfo(ai_list);
 
-  if (s->fd_num < 1) {
+  if (r->fds_num < 1) {
     WARNING("pinba plugin: Unable to open socket for address %s.", node);
-    sfree(s);
-    s = NULL;
-  }
-
-  return s;
-} /* }}} pinba_socket_open */
-
-static void pinba_socket_free(pinba_socket_t *socket) /* {{{ */
-{
-  if (!socket)
-    return;
-
-  for (nfds_t i = 0; i < socket->fd_num; i++) {
-    if (socket->fd[i].fd < 0)
-      continue;
-    close(socket->fd[i].fd);
-    socket->fd[i].fd = -1;
-  }
-
-  sfree(socket);
-} /* }}} void pinba_socket_free */
-
-static int pinba_process_stats_packet(const uint8_t *buffer, /* {{{ */
-                                      size_t buffer_size) {
-  Pinba__Request *request;
-
-  request = pinba__request__unpack(NULL, buffer_size, buffer);
-
-  if (!request)
-    return -1;
-
-  service_process_request(request);
-  pinba__request__free_unpacked(request, NULL);
-
-  return 0;
-} /* }}} int pinba_process_stats_packet */
-
-static int pinba_udp_read_callback_fn(int sock) /* {{{ */
-{
-  uint8_t buffer[PINBA_UDP_BUFFER_SIZE];
-  size_t buffer_size;
-  int status;
-
-  while (42) {
-    buffer_size = sizeof(buffer);
-    status = recvfrom(sock, buffer, buffer_size - 1, MSG_DONTWAIT,
-                      /* from = */ NULL, /* from len = */ 0);
-    if (status < 0) {
-
-      if ((errno == EINTR)
-#ifdef EWOULDBLOCK
-          || (errno == EWOULDBLOCK)
-#endif
-          || (errno == EAGAIN)) {
-        continue;
-      }
-
-      WARNING("pinba plugin: recvfrom(2) failed: %s", STRERRNO);
-      return -1;
-    } else if (status == 0) {
-      DEBUG("pinba plugin: recvfrom(2) returned unexpected status zero.");
-      return -1;
-    } else /* if (status > 0) */
-    {
-      assert(((size_t)status) < buffer_size);
-      buffer_size = (size_t)status;
-      buffer[buffer_size] = 0;
-
-      status = pinba_process_stats_packet(buffer, buffer_size);
-      if (status != 0)
-        DEBUG("pinba plugin: Parsing packet failed.");
-      return status;
-    }
-  } /* while (42) */
-
-  /* not reached */
-  assert(23 == 42);
-  return -1;
-} /* }}} void pinba_udp_read_callback_fn */
-
-static int receive_loop(void) /* {{{ */
-{
-  pinba_socket_t *s;
-
-  s = pinba_socket_open(conf_node, conf_service);
-  if (s == NULL) {
-    ERROR("pinba plugin: Collector thread is exiting prematurely.");
     return -1;
   }
 
-  while (!collector_thread_do_shutdown) {
-    int status;
-
-    if (s->fd_num < 1)
-      break;
-
-    status = poll(s->fd, s->fd_num, /* timeout = */ 1000);
-    if (status == 0) /* timeout */
-    {
-      continue;
-    } else if (status < 0) {
-      if ((errno == EINTR) || (errno == EAGAIN))
-        continue;
-
-      ERROR("pinba plugin: poll(2) failed: %s", STRERRNO);
-      pinba_socket_free(s);
-      return -1;
-    }
-
-    for (nfds_t i = 0; i < s->fd_num; i++) {
-      if (s->fd[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-        pb_del_socket(s, i);
-        i--;
-      } else if (s->fd[i].revents & (POLLIN | POLLPRI)) {
-        pinba_udp_read_callback_fn(s->fd[i].fd);
-      }
-    } /* for (s->fd) */
-  }   /* while (!collector_thread_do_shutdown) */
-
-  pinba_socket_free(s);
-  s = NULL;
-
   return 0;
-} /* }}} int receive_loop */
+} /* }}} int pinba_socket_open */
 
-static void *collector_thread(void *arg) /* {{{ */
+/* Must hold "stat_nodes_lock" when calling this function. */
+static void receivers_free(void) /* {{{ */
 {
-  receive_loop();
-
-  memset(&collector_thread_id, 0, sizeof(collector_thread_id));
-  collector_thread_running = false;
-  pthread_exit(NULL);
-  return NULL;
-} /* }}} void *collector_thread */
+  for (size_t i = 0; i < receivers_num; i++) {
+    /* Waits for running callbacks, which only take the receiver's lock. */
+    for (size_t j = 0; j < receivers[i].fds_num; j++)
+      plugin_unregister_fd(receivers[i].fds[j]);
+    receivers[i].fds_num = 0;
+
+    pthread_mutex_destroy(&receivers[i].lock);
+    sfree(receivers[i].nodes);
+  }
+  sfree(receivers);
+  receivers_num = 0;
+} /* }}} void receivers_free */
 
 /*
  * Plugin declaration section
@@ -550,12 +714,27 @@ static int plugin_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_service(child, &conf_service);
     else if (strcasecmp("View", child->key) == 0)
       pinba_config_view(child);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      cf_util_get_int(child, &conf_receive_threads);
     else
       WARNING("pinba plugin: Unknown config option: %s", child->key);
   }
 
   pthread_mutex_unlock(&stat_nodes_lock);
 
+  if (conf_receive_threads < 1) {
+    WARNING("pinba plugin: \"ReceiveThreads\" must be at least 1.");
+    conf_receive_threads = 1;
+  }
+#ifndef SO_REUSEPORT
+  if (conf_receive_threads > 1) {
+    WARNING("pinba plugin: \"ReceiveThreads\" requires SO_REUSEPORT, which "
+            "is not supported on this system. Using one socket per "
+            "address.");
+    conf_receive_threads = 1;
+  }
+#endif
+
   return 0;
 } /* }}} int pinba_config */
 
@@ -571,37 +750,60 @@ static int plugin_init(void) /* {{{ */
                          /* script = */ NULL);
   }
 
-  if (collector_thread_running)
+  if (receivers != NULL)
     return 0;
 
-  status = plugin_thread_create(&collector_thread_id,
-                                /* attrs = */ NULL, collector_thread,
-                                /* args = */ NULL, "pinba collector");
-  if (status != 0) {
-    ERROR("pinba plugin: pthread_create(3) failed: %s", STRERRNO);
+  pthread_mutex_lock(&stat_nodes_lock);
+
+  receivers = calloc((size_t)conf_receive_threads, sizeof(*receivers));
+  if (receivers == NULL) {
+    pthread_mutex_unlock(&stat_nodes_lock);
+    ERROR("pinba plugin: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (int i = 0; i < conf_receive_threads; i++) {
+    pinba_receiver_t *r = receivers + receivers_num;
+
+    r->nodes = calloc(stat_nodes_num, sizeof(*r->nodes));
+    if (r->nodes == NULL) {
+      ERROR("pinba plugin: calloc failed.");
+      break;
+    }
+    for (unsigned int j = 0; j < stat_nodes_num; j++)
+      service_statnode_reset(r->nodes + j);
+    pthread_mutex_init(&r->lock, /* attr = */ NULL);
+    receivers_num++;
+  }
+
+  size_t listening = 0;
+  for (size_t i = 0; i < receivers_num; i++) {
+    status = pinba_socket_open(receivers + i, conf_node, conf_service,
+                               /* reuse_port = */ conf_receive_threads > 1);
+    if (status == 0)
+      listening++;
+  }
+
+  if (listening == 0) {
+    receivers_free();
+    pthread_mutex_unlock(&stat_nodes_lock);
     return -1;
   }
-  collector_thread_running = true;
+
+  pthread_mutex_unlock(&stat_nodes_lock);
 
   return 0;
 } /* }}} */
 
 static int plugin_shutdown(void) /* {{{ */
 {
-  if (collector_thread_running) {
-    int status;
+  if (receivers != NULL) {
+    DEBUG("pinba plugin: Closing the listening sockets.");
 
-    DEBUG("pinba plugin: Shutting down collector thread.");
-    collector_thread_do_shutdown = true;
-
-    status = pthread_join(collector_thread_id, /* retval = */ NULL);
-    if (status != 0) {
-      ERROR("pinba plugin: pthread_join(3) failed: %s", STRERROR(status));
-    }
-
-    collector_thread_running = false;
-    collector_thread_do_shutdown = false;
-  } /* if (collector_thread_running) */
+    pthread_mutex_lock(&stat_nodes_lock);
+    receivers_free();
+    pthread_mutex_unlock(&stat_nodes_lock);
+  } /* if (receivers != NULL) */
 
   return 0;
 } /* }}} int plugin_shutdown */
@@ -27,7 +27,9 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/latency/latency.h"
 #include "utils_complain.h"
 
 #include <netinet/in.h>
@@ -49,27 +51,49 @@
 #define HAVE_OPING_1_3
 #endif
 
+/* Relative accuracy of the latency percentiles. */
+#define PING_PERCENTILE_ACCURACY 0.01
+
 /*
  * Private data types
  */
+struct ping_shard_s;
+typedef struct ping_shard_s ping_shard_t;
+
 struct hostlist_s {
   char *host;
 
+  /* The shard pinging this host. Its lock protects the fields below. */
+  ping_shard_t *shard;
+
   uint32_t pkg_sent;
   uint32_t pkg_recv;
   uint32_t pkg_missed;
 
   double latency_total;
   double latency_squared;
+  /* Only allocated if percentiles have been configured. */
+  latency_counter_t *latency;
 
   struct hostlist_s *next;
 };
 typedef struct hostlist_s hostlist_t;
 
+/* Each shard is a thread with its own ping object, which pings a part of the
+ * configured hosts. */
+struct ping_shard_s {
+  size_t index;
+  pthread_t thread;
+  bool thread_running;
+  pthread_mutex_t lock;
+};
+
 /*
  * Private variables
  */
 static hostlist_t *hostlist_head;
+/* Maps host names to hostlist_t. Built by ping_init and read-only after. */
+static c_avl_tree_t *hostlist_tree;
 
 static int ping_af = PING_DEF_AF;
 static char *ping_source;
@@ -81,19 +105,24 @@ static int ping_ttl = PING_DEF_TTL;
 static double ping_interval = 1.0;
 static double ping_timeout = 0.9;
 static int ping_max_missed = -1;
+static int ping_threads_num = 1;
+static double *ping_percentiles;
+static size_t ping_percentiles_num;
 
 static pthread_mutex_t ping_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t ping_cond = PTHREAD_COND_INITIALIZER;
 static int ping_thread_loop;
 static int ping_thread_error;
-static pthread_t ping_thread_id;
+static ping_shard_t *ping_shards;
+static size_t ping_shards_num;
 
 static const char *config_keys[] = {"Host",    "SourceAddress", "AddressFamily",
 #ifdef HAVE_OPING_1_3
                                     "Device",
 #endif
                                     "Size",    "TTL",           "Interval",
-                                    "Timeout", "MaxMissed"};
+                                    "Timeout", "MaxMissed",     "Threads",
+                                    "Percentile"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /*
@@ -141,6 +170,39 @@ static void time_calc(struct timespec *ts_dest, /* {{{ */
   time_normalize(ts_dest);
 } /* }}} void time_calc */
 
+/* ping_iterator_host returns the host an iterator refers to. The host is
+ * looked up by name once and then stored as the iterator's context. */
+static hostlist_t *ping_iterator_host(pingobj_t *pingobj, /* {{{ */
+                                      pingobj_iter_t *iter) {
+  hostlist_t *hl = ping_iterator_get_context(iter);
+  if (hl != NULL)
+    return hl;
+
+  char userhost[NI_MAXHOST];
+  size_t param_size = sizeof(userhost);
+  int status = ping_iterator_get_info(iter,
+#ifdef PING_INFO_USERNAME
+                                      PING_INFO_USERNAME,
+#else
+                                      PING_INFO_HOSTNAME,
+#endif
+                                      userhost, &param_size);
+  if (status != 0) {
+    WARNING("ping plugin: ping_iterator_get_info failed: %s",
+            ping_get_error(pingobj));
+    return NULL;
+  }
+
+  if (c_avl_get(hostlist_tree, userhost, (void *)&hl) != 0) {
+    WARNING("ping plugin: Cannot find host %s.", userhost);
+    return NULL;
+  }
+
+  ping_iterator_set_context(iter, hl);
+  return hl;
+} /* }}} hostlist_t *ping_iterator_host */
+
+/* Must hold shard->lock when calling. */
 static int ping_dispatch_all(pingobj_t *pingobj) /* {{{ */
 {
   hostlist_t *hl;
@@ -148,32 +210,12 @@ static int ping_dispatch_all(pingobj_t *pingobj) /* {{{ */
 
   for (pingobj_iter_t *iter = ping_iterator_get(pingobj); iter != NULL;
        iter = ping_iterator_next(iter)) { /* {{{ */
-    char userhost[NI_MAXHOST];
     double latency;
     size_t param_size;
 
-    param_size = sizeof(userhost);
-    status = ping_iterator_get_info(iter,
-#ifdef PING_INFO_USERNAME
-                                    PING_INFO_USERNAME,
-#else
-                                    PING_INFO_HOSTNAME,
-#endif
-                                    userhost, &param_size);
-    if (status != 0) {
-      WARNING("ping plugin: ping_iterator_get_info failed: %s",
-              ping_get_error(pingobj));
+    hl = ping_iterator_host(pingobj, iter);
+    if (hl == NULL)
       continue;
-    }
-
-    for (hl = hostlist_head; hl != NULL; hl = hl->next)
-      if (strcmp(userhost, hl->host) == 0)
-        break;
-
-    if (hl == NULL) {
-      WARNING("ping plugin: Cannot find host %s.", userhost);
-      continue;
-    }
 
     param_size = sizeof(latency);
     status = ping_iterator_get_info(iter, PING_INFO_LATENCY, (void *)&latency,
@@ -189,6 +231,9 @@ static int ping_dispatch_all(pingobj_t *pingobj) /* {{{ */
       hl->pkg_recv++;
       hl->latency_total += latency;
       hl->latency_squared += (latency * latency);
+      /* liboping reports the latency in milliseconds. */
+      if (hl->latency != NULL)
+        latency_counter_add(hl->latency, DOUBLE_TO_CDTIME_T(latency / 1000.0));
 
       /* reset missed packages counter */
       hl->pkg_missed = 0;
@@ -223,24 +268,14 @@ static int ping_dispatch_all(pingobj_t *pingobj) /* {{{ */
   return 0;
 } /* }}} int ping_dispatch_all */
 
-static void *ping_thread(void *arg) /* {{{ */
+/* ping_shard_construct creates the ping object of a shard and adds the
+ * shard's hosts to it. */
+static pingobj_t *ping_shard_construct(ping_shard_t *shard) /* {{{ */
 {
-  struct timeval tv_begin;
-  struct timeval tv_end;
-  struct timespec ts_wait;
-  struct timespec ts_int;
-
-  int count;
-
-  c_complain_t complaint = C_COMPLAIN_INIT_STATIC;
-
   pingobj_t *pingobj = ping_construct();
   if (pingobj == NULL) {
     ERROR("ping plugin: ping_construct failed.");
-    pthread_mutex_lock(&ping_lock);
-    ping_thread_error = 1;
-    pthread_mutex_unlock(&ping_lock);
-    return (void *)-1;
+    return NULL;
   }
 
   if (ping_af != PING_DEF_AF) {
@@ -266,9 +301,12 @@ static void *ping_thread(void *arg) /* {{{ */
   if (ping_data != NULL)
     ping_setopt(pingobj, PING_OPT_DATA, (void *)ping_data);
 
-  /* Add all the hosts to the ping object. */
-  count = 0;
+  /* Add the shard's hosts to the ping object. */
+  int count = 0;
   for (hostlist_t *hl = hostlist_head; hl != NULL; hl = hl->next) {
+    if (hl->shard != shard)
+      continue;
+
     int tmp_status;
     tmp_status = ping_host_add(pingobj, hl->host);
     if (tmp_status != 0)
@@ -279,7 +317,29 @@ static void *ping_thread(void *arg) /* {{{ */
   }
 
   if (count == 0) {
-    ERROR("ping plugin: No host could be added to ping object. Giving up.");
+    ERROR("ping plugin: No host could be added to ping object %" PRIsz
+          ". Giving up.",
+          shard->index);
+    ping_destroy(pingobj);
+    return NULL;
+  }
+
+  return pingobj;
+} /* }}} pingobj_t *ping_shard_construct */
+
+static void *ping_thread(void *arg) /* {{{ */
+{
+  ping_shard_t *shard = arg;
+
+  struct timeval tv_begin;
+  struct timeval tv_end;
+  struct timespec ts_wait;
+  struct timespec ts_int;
+
+  c_complain_t complaint = C_COMPLAIN_INIT_STATIC;
+
+  pingobj_t *pingobj = ping_shard_construct(shard);
+  if (pingobj == NULL) {
     pthread_mutex_lock(&ping_lock);
     ping_thread_error = 1;
     pthread_mutex_unlock(&ping_lock);
@@ -317,14 +377,17 @@ static void *ping_thread(void *arg) /* {{{ */
       send_successful = true;
     }
 
+    if (send_successful) {
+      pthread_mutex_lock(&shard->lock);
+      (void)ping_dispatch_all(pingobj);
+      pthread_mutex_unlock(&shard->lock);
+    }
+
     pthread_mutex_lock(&ping_lock);
 
     if (ping_thread_loop <= 0)
       break;
 
-    if (send_successful)
-      (void)ping_dispatch_all(pingobj);
-
     if (gettimeofday(&tv_end, NULL) < 0) {
       ERROR("ping plugin: gettimeofday failed: %s", STRERRNO);
       ping_thread_error = 1;
@@ -346,9 +409,40 @@ static void *ping_thread(void *arg) /* {{{ */
   return (void *)0;
 } /* }}} void *ping_thread */
 
+/* Must hold ping_lock when calling. Joins and frees all shards. */
+static int stop_shards(void) /* {{{ */
+{
+  int status = 0;
+
+  ping_thread_loop = 0;
+  pthread_cond_broadcast(&ping_cond);
+  pthread_mutex_unlock(&ping_lock);
+
+  for (size_t i = 0; i < ping_shards_num; i++) {
+    if (!ping_shards[i].thread_running)
+      continue;
+    if (pthread_join(ping_shards[i].thread, /* return = */ NULL) != 0) {
+      ERROR("ping plugin: Stopping thread failed.");
+      status = -1;
+    }
+  }
+
+  pthread_mutex_lock(&ping_lock);
+  for (hostlist_t *hl = hostlist_head; hl != NULL; hl = hl->next)
+    hl->shard = NULL;
+  for (size_t i = 0; i < ping_shards_num; i++)
+    pthread_mutex_destroy(&ping_shards[i].lock);
+  sfree(ping_shards);
+  ping_shards_num = 0;
+
+  return status;
+} /* }}} int stop_shards */
+
 static int start_thread(void) /* {{{ */
 {
-  int status;
+  size_t hosts_num = 0;
+  for (hostlist_t *hl = hostlist_head; hl != NULL; hl = hl->next)
+    hosts_num++;
 
   pthread_mutex_lock(&ping_lock);
 
@@ -357,16 +451,47 @@ static int start_thread(void) /* {{{ */
     return 0;
   }
 
-  ping_thread_loop = 1;
-  ping_thread_error = 0;
-  status = plugin_thread_create(&ping_thread_id, /* attr = */ NULL, ping_thread,
-                                /* arg = */ (void *)0, "ping");
-  if (status != 0) {
-    ping_thread_loop = 0;
-    ERROR("ping plugin: Starting thread failed.");
+  size_t shards_num = (size_t)ping_threads_num;
+  if (shards_num > hosts_num)
+    shards_num = hosts_num;
+
+  ping_shards = calloc(shards_num, sizeof(*ping_shards));
+  if (ping_shards == NULL) {
+    ERROR("ping plugin: calloc failed.");
     pthread_mutex_unlock(&ping_lock);
     return -1;
   }
+  ping_shards_num = shards_num;
+  for (size_t i = 0; i < ping_shards_num; i++) {
+    ping_shards[i].index = i;
+    pthread_mutex_init(&ping_shards[i].lock, /* attr = */ NULL);
+  }
+
+  /* Distribute the hosts round-robin. */
+  size_t i = 0;
+  for (hostlist_t *hl = hostlist_head; hl != NULL; hl = hl->next) {
+    hl->shard = ping_shards + i;
+    i = (i + 1) % ping_shards_num;
+  }
+
+  ping_thread_loop = 1;
+  ping_thread_error = 0;
+  for (i = 0; i < ping_shards_num; i++) {
+    ping_shard_t *shard = ping_shards + i;
+
+    char name[16];
+    snprintf(name, sizeof(name), "ping#%" PRIsz, i);
+
+    int status = plugin_thread_create(&shard->thread, /* attr = */ NULL,
+                                      ping_thread, shard, name);
+    if (status != 0) {
+      ERROR("ping plugin: Starting thread failed.");
+      stop_shards();
+      pthread_mutex_unlock(&ping_lock);
+      return -1;
+    }
+    shard->thread_running = true;
+  }
 
   pthread_mutex_unlock(&ping_lock);
   return 0;
@@ -383,18 +508,8 @@ static int stop_thread(void) /* {{{ */
     return -1;
   }
 
-  ping_thread_loop = 0;
-  pthread_cond_broadcast(&ping_cond);
-  pthread_mutex_unlock(&ping_lock);
-
-  status = pthread_join(ping_thread_id, /* return = */ NULL);
-  if (status != 0) {
-    ERROR("ping plugin: Stopping thread failed.");
-    status = -1;
-  }
+  status = stop_shards();
 
-  pthread_mutex_lock(&ping_lock);
-  memset(&ping_thread_id, 0, sizeof(ping_thread_id));
   ping_thread_error = 0;
   pthread_mutex_unlock(&ping_lock);
 
@@ -415,6 +530,27 @@ static int ping_init(void) /* {{{ */
             ping_timeout);
   }
 
+  if (hostlist_tree == NULL) {
+    hostlist_tree =
+        c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (hostlist_tree == NULL) {
+      ERROR("ping plugin: c_avl_create failed.");
+      return -1;
+    }
+    for (hostlist_t *hl = hostlist_head; hl != NULL; hl = hl->next) {
+      /* If a host is configured twice, the last occurrence is used. */
+      c_avl_insert(hostlist_tree, hl->host, hl);
+
+      if ((ping_percentiles_num > 0) && (hl->latency == NULL)) {
+        hl->latency = latency_counter_create_sketch(PING_PERCENTILE_ACCURACY);
+        if (hl->latency == NULL) {
+          ERROR("ping plugin: latency_counter_create_sketch failed.");
+          return -1;
+        }
+      }
+    }
+  }
+
 #if defined(HAVE_SYS_CAPABILITY_H) && defined(CAP_NET_RAW)
   if (check_capability(CAP_NET_RAW) != 0) {
     if (getuid() == 0)
@@ -454,9 +590,9 @@ static int ping_config(const char *key, const char *value) /* {{{ */
     hostlist_t *hl;
     char *host;
 
-    hl = malloc(sizeof(*hl));
+    hl = calloc(1, sizeof(*hl));
     if (hl == NULL) {
-      ERROR("ping plugin: malloc failed: %s", STRERRNO);
+      ERROR("ping plugin: calloc failed: %s", STRERRNO);
       return 1;
     }
 
@@ -558,6 +694,28 @@ static int ping_config(const char *key, const char *value) /* {{{ */
     ping_max_missed = atoi(value);
     if (ping_max_missed < 0)
       INFO("ping plugin: MaxMissed < 0, disabled re-resolving of hosts");
+  } else if (strcasecmp(key, "Threads") == 0) {
+    int tmp = atoi(value);
+    if (tmp > 0)
+      ping_threads_num = tmp;
+    else
+      WARNING("ping plugin: Ignoring invalid number of threads %i.", tmp);
+  } else if (strcasecmp(key, "Percentile") == 0) {
+    double tmp = atof(value);
+    if ((tmp <= 0.0) || (tmp >= 100.0)) {
+      WARNING("ping plugin: Ignoring invalid percentile %g (%s)", tmp, value);
+      return 0;
+    }
+
+    double *temp = realloc(ping_percentiles, sizeof(*ping_percentiles) *
+                                                 (ping_percentiles_num + 1));
+    if (temp == NULL) {
+      ERROR("ping plugin: realloc failed.");
+      return 1;
+    }
+    ping_percentiles = temp;
+    ping_percentiles[ping_percentiles_num] = tmp;
+    ping_percentiles_num++;
   } else {
     return -1;
   }
@@ -565,13 +723,15 @@ static int ping_config(const char *key, const char *value) /* {{{ */
   return 0;
 } /* }}} int ping_config */
 
-static void submit(const char *host, const char *type, /* {{{ */
-                   gauge_t value) {
+static void submit(const char *host, const char *plugin_instance, /* {{{ */
+                   const char *type, gauge_t value) {
   value_list_t vl = VALUE_LIST_INIT;
 
   vl.values = &(value_t){.gauge = value};
   vl.values_len = 1;
   sstrncpy(vl.plugin, "ping", sizeof(vl.plugin));
+  if (plugin_instance != NULL)
+    sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
   sstrncpy(vl.type_instance, host, sizeof(vl.type_instance));
   sstrncpy(vl.type, type, sizeof(vl.type));
 
@@ -590,6 +750,7 @@ static int ping_read(void) /* {{{ */
       hl->pkg_recv = 0;
       hl->latency_total = 0.0;
       hl->latency_squared = 0.0;
+      latency_counter_reset(hl->latency);
     }
 
     start_thread();
@@ -608,22 +769,36 @@ static int ping_read(void) /* {{{ */
     double latency_stddev;
 
     double droprate;
+    gauge_t percentiles[ping_percentiles_num + 1];
+
+    /* The shard is NULL if the threads could not be restarted. */
+    ping_shard_t *shard = hl->shard;
+    if (shard == NULL)
+      continue;
 
     /* Locking here works, because the structure of the linked list is only
      * changed during configure and shutdown. */
-    pthread_mutex_lock(&ping_lock);
+    pthread_mutex_lock(&shard->lock);
 
     pkg_sent = hl->pkg_sent;
     pkg_recv = hl->pkg_recv;
     latency_total = hl->latency_total;
     latency_squared = hl->latency_squared;
 
+    for (size_t i = 0; i < ping_percentiles_num; i++)
+      percentiles[i] =
+          (pkg_recv == 0)
+              ? NAN
+              : 1000.0 * CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(
+                             hl->latency, ping_percentiles[i]));
+
     hl->pkg_sent = 0;
     hl->pkg_recv = 0;
     hl->latency_total = 0.0;
     hl->latency_squared = 0.0;
+    latency_counter_reset(hl->latency);
 
-    pthread_mutex_unlock(&ping_lock);
+    pthread_mutex_unlock(&shard->lock);
 
     /* This e. g. happens when starting up. */
     if (pkg_sent == 0) {
@@ -650,9 +825,16 @@ static int ping_read(void) /* {{{ */
     /* Calculate drop rate. */
     droprate = ((double)(pkg_sent - pkg_recv)) / ((double)pkg_sent);
 
-    submit(hl->host, "ping", latency_average);
-    submit(hl->host, "ping_stddev", latency_stddev);
-    submit(hl->host, "ping_droprate", droprate);
+    submit(hl->host, NULL, "ping", latency_average);
+    submit(hl->host, NULL, "ping_stddev", latency_stddev);
+    submit(hl->host, NULL, "ping_droprate", droprate);
+
+    for (size_t i = 0; i < ping_percentiles_num; i++) {
+      char plugin_instance[DATA_MAX_NAME_LEN];
+      snprintf(plugin_instance, sizeof(plugin_instance), "percentile-%.0f",
+               ping_percentiles[i]);
+      submit(hl->host, plugin_instance, "ping", percentiles[i]);
+    }
   } /* }}} for (hl = hostlist_head; hl != NULL; hl = hl->next) */
 
   return 0;
@@ -673,15 +855,24 @@ static int ping_shutdown(void) /* {{{ */
     hl_next = hl->next;
 
     sfree(hl->host);
+    latency_counter_destroy(hl->latency);
     sfree(hl);
 
     hl = hl_next;
   }
 
+  hostlist_head = NULL;
+  if (hostlist_tree != NULL) {
+    c_avl_destroy(hostlist_tree);
+    hostlist_tree = NULL;
+  }
+
   if (ping_data != NULL) {
     free(ping_data);
     ping_data = NULL;
   }
+  sfree(ping_percentiles);
+  ping_percentiles_num = 0;
 
   return 0;
 } /* }}} int ping_shutdown */
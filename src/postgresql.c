@@ -43,6 +43,8 @@
 #include <libpq-fe.h>
 #include <pg_config_manual.h>
 
+#include <arpa/inet.h>
+
 #define log_err(...) ERROR("postgresql: " __VA_ARGS__)
 #define log_warn(...) WARNING("postgresql: " __VA_ARGS__)
 #define log_info(...) INFO("postgresql: " __VA_ARGS__)
@@ -103,9 +105,57 @@ typedef struct {
   char *name;
   char *statement;
   bool store_rates;
+
+  /* If set, rows are streamed into this table with COPY instead of executing
+   * `statement'. */
+  char *table;
+  size_t batch_size;
+  size_t queue_limit;
 } c_psql_writer_t;
 
+#define C_PSQL_COPY_BATCH_SIZE 10000
+#define C_PSQL_COPY_QUEUE_LIMIT 100000
+
+/* Number of columns of a row sent with COPY, matching the nine parameters of
+ * a writer statement. */
+#define C_PSQL_COPY_COLUMNS 9
+
+/* Type OIDs of array elements in the binary format. */
+#define C_PSQL_TEXTOID 25
+#define C_PSQL_FLOAT8OID 701
+
+/* Microseconds between the Unix and the PostgreSQL epoch (2000-01-01). */
+#define C_PSQL_EPOCH_US INT64_C(946684800000000)
+
+struct c_psql_database_s;
+
+/* State of a writer with a `Table'. The write callback only encodes rows in
+ * the binary COPY format into `rows'; a thread of its own sends them over a
+ * connection of its own, so that write threads never wait for the
+ * server. */
 typedef struct {
+  c_psql_writer_t *writer;
+  struct c_psql_database_s *db;
+  char *copy_statement;
+  cdtime_t max_delay;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool thread_running;
+  bool shutdown;
+  bool flush;
+
+  /* Encoded rows waiting to be sent, `rows_num' of them. */
+  char *rows;
+  size_t rows_len;
+  size_t rows_size;
+  size_t rows_num;
+  cdtime_t first_row;
+  uint64_t dropped;
+} c_psql_copy_t;
+
+typedef struct c_psql_database_s {
   PGconn *conn;
   c_complain_t conn_complaint;
 
@@ -121,6 +171,12 @@ typedef struct {
 
   c_psql_writer_t **writers;
   size_t writers_num;
+  /* One entry per writer; NULL unless the writer uses COPY. */
+  c_psql_copy_t **copies;
+
+  /* whether the queries and writers have been prepared on this connection */
+  bool *q_prepared;
+  bool *w_prepared;
 
   /* make sure we don't access the database object in parallel */
   pthread_mutex_t db_lock;
@@ -162,6 +218,9 @@ static size_t queries_num;
 static c_psql_writer_t *writers;
 static size_t writers_num;
 
+static void c_psql_copy_destroy(c_psql_copy_t *copy);
+static void c_psql_database_delete(void *data);
+
 static int c_psql_begin(c_psql_database_t *db) {
   PGresult *r = PQexec(db->conn, "BEGIN");
 
@@ -232,6 +291,10 @@ static c_psql_database_t *c_psql_database_new(const char *name) {
 
   db->writers = NULL;
   db->writers_num = 0;
+  db->copies = NULL;
+
+  db->q_prepared = NULL;
+  db->w_prepared = NULL;
 
   pthread_mutex_init(&db->db_lock, /* attrs = */ NULL);
 
@@ -267,6 +330,11 @@ static void c_psql_database_delete(void *data) {
   if (db->ref_cnt > 0)
     return;
 
+  if (db->copies != NULL)
+    for (size_t i = 0; i < db->writers_num; ++i)
+      c_psql_copy_destroy(db->copies[i]);
+  sfree(db->copies);
+
   /* wait for the lock to be released by the last writer */
   pthread_mutex_lock(&db->db_lock);
 
@@ -287,6 +355,9 @@ static void c_psql_database_delete(void *data) {
   sfree(db->writers);
   db->writers_num = 0;
 
+  sfree(db->q_prepared);
+  sfree(db->w_prepared);
+
   pthread_mutex_unlock(&db->db_lock);
 
   pthread_mutex_destroy(&db->db_lock);
@@ -314,6 +385,37 @@ static void c_psql_database_delete(void *data) {
   return;
 } /* c_psql_database_delete */
 
+/* Creates another database object using the same connection settings as
+ * `src', but without any queries or writers. */
+static c_psql_database_t *c_psql_database_clone(const c_psql_database_t *src) {
+  c_psql_database_t *db = c_psql_database_new(src->database);
+  if (db == NULL)
+    return NULL;
+
+  db->host = src->host ? sstrdup(src->host) : NULL;
+  db->port = src->port ? sstrdup(src->port) : NULL;
+  db->user = src->user ? sstrdup(src->user) : NULL;
+  db->password = src->password ? sstrdup(src->password) : NULL;
+
+  sfree(db->instance);
+  db->instance = sstrdup(src->instance);
+
+  db->plugin_name = src->plugin_name ? sstrdup(src->plugin_name) : NULL;
+  db->sslmode = src->sslmode ? sstrdup(src->sslmode) : NULL;
+  db->krbsrvname = src->krbsrvname ? sstrdup(src->krbsrvname) : NULL;
+  db->service = src->service ? sstrdup(src->service) : NULL;
+
+  return db;
+} /* c_psql_database_clone */
+
+/* Prepared statements do not survive a new connection. */
+static void c_psql_forget_prepared(c_psql_database_t *db) {
+  if (db->q_prepared != NULL)
+    memset(db->q_prepared, 0, db->queries_num * sizeof(*db->q_prepared));
+  if (db->w_prepared != NULL)
+    memset(db->w_prepared, 0, db->writers_num * sizeof(*db->w_prepared));
+} /* c_psql_forget_prepared */
+
 static int c_psql_connect(c_psql_database_t *db) {
   char conninfo[4096];
   char *buf = conninfo;
@@ -354,10 +456,12 @@ static int c_psql_check_connection(c_psql_database_t *db) {
       db->conn_complaint.interval = 1;
 
     c_psql_connect(db);
+    c_psql_forget_prepared(db);
   }
 
   if (CONNECTION_OK != PQstatus(db->conn)) {
     PQreset(db->conn);
+    c_psql_forget_prepared(db);
 
     /* trigger c_release() */
     if (0 == db->conn_complaint.interval)
@@ -398,15 +502,37 @@ static int c_psql_check_connection(c_psql_database_t *db) {
   return 0;
 } /* c_psql_check_connection */
 
+/* Executes `statement' as the prepared statement `name', so that the server
+ * parses and plans it only once per connection. `prepared' records whether
+ * the statement has been prepared on the current connection. */
+static PGresult *c_psql_exec_prepared(c_psql_database_t *db, const char *name,
+                                      const char *statement, bool *prepared,
+                                      int params_num,
+                                      const char *const *params) {
+  if (!*prepared) {
+    PGresult *res = PQprepare(db->conn, name, statement, params_num, NULL);
+    if (PGRES_COMMAND_OK != PQresultStatus(res))
+      return res;
+
+    PQclear(res);
+    *prepared = true;
+  }
+
+  return PQexecPrepared(db->conn, name, params_num, params, NULL, NULL,
+                        /* return text data */ 0);
+} /* c_psql_exec_prepared */
+
 static PGresult *c_psql_exec_query_noparams(c_psql_database_t *db,
                                             udb_query_t *q) {
   return PQexec(db->conn, udb_query_get_statement(q));
 } /* c_psql_exec_query_noparams */
 
-static PGresult *c_psql_exec_query_params(c_psql_database_t *db, udb_query_t *q,
+static PGresult *c_psql_exec_query_params(c_psql_database_t *db, size_t q_idx,
                                           c_psql_user_data_t *data) {
+  udb_query_t *q = db->queries[q_idx];
   const char *params[db->max_params_num];
   char interval[64];
+  char name[64];
 
   if ((data == NULL) || (data->params_num == 0))
     return c_psql_exec_query_noparams(db, q);
@@ -438,13 +564,16 @@ static PGresult *c_psql_exec_query_params(c_psql_database_t *db, udb_query_t *q,
     }
   }
 
-  return PQexecParams(db->conn, udb_query_get_statement(q), data->params_num,
-                      NULL, (const char *const *)params, NULL, NULL, 0);
+  snprintf(name, sizeof(name), "collectd_query_%" PRIsz, q_idx);
+  return c_psql_exec_prepared(db, name, udb_query_get_statement(q),
+                              &db->q_prepared[q_idx], data->params_num,
+                              (const char *const *)params);
 } /* c_psql_exec_query_params */
 
 /* db->db_lock must be locked when calling this function */
-static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
-                             udb_query_preparation_area_t *prep_area) {
+static int c_psql_exec_query(c_psql_database_t *db, size_t q_idx) {
+  udb_query_t *q = db->queries[q_idx];
+  udb_query_preparation_area_t *prep_area = db->q_prep_areas[q_idx];
   PGresult *res;
 
   c_psql_user_data_t *data;
@@ -463,7 +592,7 @@ static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
 
   /* Versions up to `3' don't know how to handle parameters. */
   if (3 <= db->proto_version)
-    res = c_psql_exec_query_params(db, q, data);
+    res = c_psql_exec_query_params(db, q_idx, data);
   else if ((NULL == data) || (0 == data->params_num))
     res = c_psql_exec_query_noparams(db, q);
   else {
@@ -489,7 +618,7 @@ static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
     if ((CONNECTION_OK != PQstatus(db->conn)) &&
         (0 == c_psql_check_connection(db))) {
       PQclear(res);
-      return c_psql_exec_query(db, q, prep_area);
+      return c_psql_exec_query(db, q_idx);
     }
 
     log_err("Failed to execute SQL query: %s", PQerrorMessage(db->conn));
@@ -517,7 +646,8 @@ static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
     BAIL_OUT(-1);
   }
 
-  column_values = calloc(column_num, sizeof(*column_values));
+  column_values =
+      calloc((size_t)rows_num * (size_t)column_num, sizeof(*column_values));
   if (column_values == NULL) {
     log_err("calloc failed.");
     BAIL_OUT(-1);
@@ -550,13 +680,17 @@ static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
     BAIL_OUT(-1);
   }
 
+  /* Rows with missing values are skipped; the others are handed over to
+   * `udb_query_handle_results' in one go. */
+  size_t rows_valid = 0;
   for (int row = 0; row < rows_num; ++row) {
+    char **row_values = column_values + rows_valid * (size_t)column_num;
     int col;
     for (col = 0; col < column_num; ++col) {
       /* Pointers returned by `PQgetvalue' are freed by `PQclear' via
        * `BAIL_OUT'. */
-      column_values[col] = PQgetvalue(res, row, col);
-      if (NULL == column_values[col]) {
+      row_values[col] = PQgetvalue(res, row, col);
+      if (NULL == row_values[col]) {
         log_err("Failed to get value at (row = %i, col = %i).", row, col);
         break;
       }
@@ -566,12 +700,14 @@ static int c_psql_exec_query(c_psql_database_t *db, udb_query_t *q,
     if (col < column_num)
       continue;
 
-    status = udb_query_handle_result(q, prep_area, column_values);
-    if (status != 0) {
-      log_err("udb_query_handle_result failed with status %i.", status);
-    }
+    rows_valid++;
   } /* for (row = 0; row < rows_num; ++row) */
 
+  status = udb_query_handle_results(q, prep_area, column_values, rows_valid);
+  if (status != 0) {
+    log_err("udb_query_handle_results failed with status %i.", status);
+  }
+
   udb_query_finish_result(q, prep_area);
 
   BAIL_OUT(0);
@@ -602,17 +738,13 @@ static int c_psql_read(user_data_t *ud) {
   }
 
   for (size_t i = 0; i < db->queries_num; ++i) {
-    udb_query_preparation_area_t *prep_area;
-    udb_query_t *q;
-
-    prep_area = db->q_prep_areas[i];
-    q = db->queries[i];
+    udb_query_t *q = db->queries[i];
 
     if ((0 != db->server_version) &&
         (udb_query_check_version(q, db->server_version) <= 0))
       continue;
 
-    if (0 == c_psql_exec_query(db, q, prep_area))
+    if (0 == c_psql_exec_query(db, i))
       success = 1;
   }
 
@@ -771,6 +903,358 @@ static char *values_to_sqlarray(const data_set_t *ds, const value_list_t *vl,
   return string;
 } /* values_to_sqlarray */
 
+/* Binary COPY {{{
+ *
+ * Rows are encoded in the binary format of COPY, see the "COPY" chapter of
+ * the PostgreSQL manual. Integers are sent in network byte order, the time as
+ * microseconds since 2000-01-01 and the values as an array of float8. */
+static int c_psql_copy_append(c_psql_copy_t *copy, void const *data,
+                              size_t len) {
+  if (copy->rows_len + len > copy->rows_size) {
+    size_t size = (copy->rows_size > 0) ? copy->rows_size : 4096;
+    while (size < copy->rows_len + len)
+      size *= 2;
+
+    char *tmp = realloc(copy->rows, size);
+    if (tmp == NULL)
+      return ENOMEM;
+    copy->rows = tmp;
+    copy->rows_size = size;
+  }
+
+  memcpy(copy->rows + copy->rows_len, data, len);
+  copy->rows_len += len;
+  return 0;
+} /* c_psql_copy_append */
+
+static int c_psql_copy_append_u16(c_psql_copy_t *copy, uint16_t v) {
+  v = htons(v);
+  return c_psql_copy_append(copy, &v, sizeof(v));
+} /* c_psql_copy_append_u16 */
+
+static int c_psql_copy_append_u32(c_psql_copy_t *copy, uint32_t v) {
+  v = htonl(v);
+  return c_psql_copy_append(copy, &v, sizeof(v));
+} /* c_psql_copy_append_u32 */
+
+static int c_psql_copy_append_u64(c_psql_copy_t *copy, uint64_t v) {
+  v = (uint64_t)htonll(v);
+  return c_psql_copy_append(copy, &v, sizeof(v));
+} /* c_psql_copy_append_u64 */
+
+/* Appends a text field, or NULL if `str' is NULL or empty. */
+static int c_psql_copy_append_text(c_psql_copy_t *copy, char const *str) {
+  if ((str == NULL) || (str[0] == 0))
+    return c_psql_copy_append_u32(copy, UINT32_MAX);
+
+  size_t len = strlen(str);
+  return c_psql_copy_append_u32(copy, (uint32_t)len) ||
+         c_psql_copy_append(copy, str, len);
+} /* c_psql_copy_append_text */
+
+/* Appends the header of a one-dimensional array field with `num' elements,
+ * whose lengths add up to `data_len' bytes. */
+static int c_psql_copy_append_array(c_psql_copy_t *copy, uint32_t oid,
+                                    size_t num, size_t data_len) {
+  return c_psql_copy_append_u32(copy,
+                                (uint32_t)(20 + 4 * num + data_len)) ||
+         c_psql_copy_append_u32(copy, 1) ||   /* dimensions */
+         c_psql_copy_append_u32(copy, 0) ||   /* flags */
+         c_psql_copy_append_u32(copy, oid) || /* element type */
+         c_psql_copy_append_u32(copy, (uint32_t)num) ||
+         c_psql_copy_append_u32(copy, 1); /* lower bound */
+} /* c_psql_copy_append_array */
+
+/* Must be called with `copy->lock' held. `rates' may only be NULL if
+ * StoreRates is disabled or all data sources are gauges. */
+static int c_psql_copy_encode(c_psql_copy_t *copy, const data_set_t *ds,
+                              const value_list_t *vl, gauge_t const *rates) {
+  bool store_rates = copy->writer->store_rates;
+  size_t start = copy->rows_len;
+  size_t names_len = 0;
+  size_t types_len = 0;
+  int status = 0;
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    names_len += strlen(ds->ds[i].name);
+    types_len += store_rates ? strlen("gauge")
+                             : strlen(DS_TYPE_TO_STRING(ds->ds[i].type));
+  }
+
+  status |= c_psql_copy_append_u16(copy, C_PSQL_COPY_COLUMNS);
+
+  status |= c_psql_copy_append_u32(copy, sizeof(uint64_t));
+  status |= c_psql_copy_append_u64(
+      copy, (uint64_t)((int64_t)CDTIME_T_TO_US(vl->time) - C_PSQL_EPOCH_US));
+
+  status |= c_psql_copy_append_text(copy, vl->host);
+  status |= c_psql_copy_append_text(copy, vl->plugin);
+  status |= c_psql_copy_append_text(copy, vl->plugin_instance);
+  status |= c_psql_copy_append_text(copy, vl->type);
+  status |= c_psql_copy_append_text(copy, vl->type_instance);
+
+  status |= c_psql_copy_append_array(copy, C_PSQL_TEXTOID, ds->ds_num,
+                                     names_len);
+  for (size_t i = 0; i < ds->ds_num; i++)
+    status |= c_psql_copy_append_text(copy, ds->ds[i].name);
+
+  status |= c_psql_copy_append_array(copy, C_PSQL_TEXTOID, ds->ds_num,
+                                     types_len);
+  for (size_t i = 0; i < ds->ds_num; i++)
+    status |= c_psql_copy_append_text(
+        copy, store_rates ? "gauge" : DS_TYPE_TO_STRING(ds->ds[i].type));
+
+  status |= c_psql_copy_append_array(copy, C_PSQL_FLOAT8OID, ds->ds_num,
+                                     ds->ds_num * sizeof(double));
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    double d;
+    uint64_t bits;
+
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      d = vl->values[i].gauge;
+    else if (store_rates)
+      d = rates[i];
+    else if (ds->ds[i].type == DS_TYPE_COUNTER)
+      d = (double)vl->values[i].counter;
+    else if (ds->ds[i].type == DS_TYPE_DERIVE)
+      d = (double)vl->values[i].derive;
+    else
+      d = (double)vl->values[i].absolute;
+
+    memcpy(&bits, &d, sizeof(bits));
+    status |= c_psql_copy_append_u32(copy, sizeof(bits));
+    status |= c_psql_copy_append_u64(copy, bits);
+  }
+
+  if (status != 0) {
+    copy->rows_len = start;
+    return -1;
+  }
+
+  copy->rows_num++;
+  return 0;
+} /* c_psql_copy_encode */
+
+/* Sends `rows_num' encoded rows with one COPY statement. */
+static int c_psql_copy_send(c_psql_copy_t *copy, char const *data,
+                            size_t data_len, size_t rows_num) {
+  static char const header[19] = {'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377',
+                                  '\r', '\n', '\0'};
+  static char const trailer[2] = {'\377', '\377'};
+  c_psql_database_t *db = copy->db;
+  PGresult *res;
+  int status = 1;
+
+  if (c_psql_check_connection(db) != 0)
+    return -1;
+
+  res = PQexec(db->conn, copy->copy_statement);
+  if (PGRES_COPY_IN != PQresultStatus(res)) {
+    log_err("Failed to start COPY into %s: %s", copy->writer->table,
+            PQerrorMessage(db->conn));
+    PQclear(res);
+    return -1;
+  }
+  PQclear(res);
+
+  status = PQputCopyData(db->conn, header, sizeof(header));
+  for (size_t offset = 0; (status == 1) && (offset < data_len);) {
+    size_t len = data_len - offset;
+    if (len > 1048576)
+      len = 1048576;
+    status = PQputCopyData(db->conn, data + offset, (int)len);
+    offset += len;
+  }
+  if (status == 1)
+    status = PQputCopyData(db->conn, trailer, sizeof(trailer));
+
+  if (PQputCopyEnd(db->conn, (status == 1) ? NULL : "sending rows failed") !=
+      1)
+    status = -1;
+
+  while ((res = PQgetResult(db->conn)) != NULL) {
+    if (PGRES_COMMAND_OK != PQresultStatus(res)) {
+      log_err("COPY of %" PRIsz " rows into %s failed: %s", rows_num,
+              copy->writer->table, PQerrorMessage(db->conn));
+      status = -1;
+    }
+    PQclear(res);
+  }
+
+  return (status == 1) ? 0 : -1;
+} /* c_psql_copy_send */
+
+static void *c_psql_copy_thread(void *arg) {
+  c_psql_copy_t *copy = arg;
+  /* The buffer that was sent last, reused for the next rows. */
+  char *spare = NULL;
+  size_t spare_size = 0;
+
+  pthread_mutex_lock(&copy->lock);
+  while (42) {
+    while (!copy->shutdown && !copy->flush &&
+           (copy->rows_num < copy->writer->batch_size)) {
+      if (copy->rows_num == 0) {
+        pthread_cond_wait(&copy->cond, &copy->lock);
+        continue;
+      }
+
+      cdtime_t deadline = copy->first_row + copy->max_delay;
+      if (cdtime() >= deadline)
+        break;
+
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(deadline);
+      pthread_cond_timedwait(&copy->cond, &copy->lock, &ts);
+    }
+    copy->flush = false;
+
+    if (copy->rows_num == 0) {
+      if (copy->shutdown)
+        break;
+      continue;
+    }
+
+    /* Swap the buffers so that the write callbacks can go on while the rows
+     * are sent. */
+    char *data = copy->rows;
+    size_t data_size = copy->rows_size;
+    size_t data_len = copy->rows_len;
+    size_t rows_num = copy->rows_num;
+    uint64_t dropped = copy->dropped;
+
+    copy->rows = spare;
+    copy->rows_size = spare_size;
+    copy->rows_len = 0;
+    copy->rows_num = 0;
+    copy->dropped = 0;
+    pthread_mutex_unlock(&copy->lock);
+
+    if (dropped > 0)
+      log_warn("Writer \"%s\": Dropped %" PRIu64 " rows because the queue "
+               "was full.",
+               copy->writer->name, dropped);
+
+    c_psql_copy_send(copy, data, data_len, rows_num);
+    spare = data;
+    spare_size = data_size;
+
+    pthread_mutex_lock(&copy->lock);
+  }
+  pthread_mutex_unlock(&copy->lock);
+
+  free(spare);
+  return NULL;
+} /* c_psql_copy_thread */
+
+static int c_psql_copy_enqueue(c_psql_copy_t *copy, const data_set_t *ds,
+                               const value_list_t *vl) {
+  gauge_t *rates = NULL;
+
+  if (copy->writer->store_rates) {
+    for (size_t i = 0; i < ds->ds_num; i++) {
+      if (ds->ds[i].type == DS_TYPE_GAUGE)
+        continue;
+
+      rates = uc_get_rate(ds, vl);
+      if (rates == NULL) {
+        log_err("c_psql_write: Failed to determine rate");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&copy->lock);
+
+  /* The thread is started by the first write, i.e. after the daemon has
+   * forked. */
+  if (!copy->thread_running && !copy->shutdown) {
+    int status = plugin_thread_create(&copy->thread, /* attr = */ NULL,
+                                      c_psql_copy_thread, copy,
+                                      "postgresql copy");
+    if (status != 0) {
+      log_err("Writer \"%s\": Starting the COPY thread failed: %s",
+              copy->writer->name, STRERROR(status));
+      copy->shutdown = true;
+    } else {
+      copy->thread_running = true;
+    }
+  }
+
+  int status = -1;
+  if (copy->shutdown) {
+    /* The thread could not be started. */
+  } else if (copy->rows_num >= copy->writer->queue_limit) {
+    copy->dropped++;
+  } else {
+    status = c_psql_copy_encode(copy, ds, vl, rates);
+    if ((status == 0) && (copy->rows_num == 1))
+      copy->first_row = cdtime();
+    if ((copy->rows_num == 1) ||
+        (copy->rows_num >= copy->writer->batch_size))
+      pthread_cond_signal(&copy->cond);
+  }
+
+  pthread_mutex_unlock(&copy->lock);
+  sfree(rates);
+  return status;
+} /* c_psql_copy_enqueue */
+
+static c_psql_copy_t *c_psql_copy_create(const c_psql_database_t *db,
+                                         c_psql_writer_t *writer) {
+  c_psql_copy_t *copy = calloc(1, sizeof(*copy));
+  if (copy == NULL)
+    return NULL;
+
+  copy->writer = writer;
+  copy->max_delay =
+      (db->commit_interval > 0) ? db->commit_interval : plugin_get_interval();
+  pthread_mutex_init(&copy->lock, /* attrs = */ NULL);
+  pthread_cond_init(&copy->cond, /* attrs = */ NULL);
+
+  size_t len = strlen("COPY  FROM STDIN (FORMAT binary)") +
+               strlen(writer->table) + 1;
+  copy->copy_statement = malloc(len);
+  if (copy->copy_statement != NULL)
+    snprintf(copy->copy_statement, len, "COPY %s FROM STDIN (FORMAT binary)",
+             writer->table);
+
+  /* The rows are sent over a connection of their own. */
+  copy->db = c_psql_database_clone(db);
+
+  if ((copy->copy_statement == NULL) || (copy->db == NULL)) {
+    c_psql_copy_destroy(copy);
+    return NULL;
+  }
+
+  return copy;
+} /* c_psql_copy_create */
+
+static void c_psql_copy_destroy(c_psql_copy_t *copy) {
+  if (copy == NULL)
+    return;
+
+  /* The thread sends the remaining rows before it exits. */
+  pthread_mutex_lock(&copy->lock);
+  copy->shutdown = true;
+  pthread_cond_signal(&copy->cond);
+  pthread_mutex_unlock(&copy->lock);
+
+  if (copy->thread_running)
+    pthread_join(copy->thread, NULL);
+
+  if (copy->db != NULL)
+    c_psql_database_delete(copy->db);
+
+  pthread_cond_destroy(&copy->cond);
+  pthread_mutex_destroy(&copy->lock);
+  sfree(copy->copy_statement);
+  sfree(copy->rows);
+  sfree(copy);
+} /* c_psql_copy_destroy */
+
+/* }}} Binary COPY */
+
 static int c_psql_write(const data_set_t *ds, const value_list_t *vl,
                         user_data_t *ud) {
   c_psql_database_t *db;
@@ -822,6 +1306,18 @@ static int c_psql_write(const data_set_t *ds, const value_list_t *vl,
     return 0;
   }
 
+  /* Writers using COPY only queue the row. */
+  size_t statement_writers = 0;
+  for (size_t i = 0; i < db->writers_num; ++i) {
+    if (db->copies[i] == NULL)
+      statement_writers++;
+    else if (c_psql_copy_enqueue(db->copies[i], ds, vl) == 0)
+      success = 1;
+  }
+
+  if (statement_writers == 0)
+    return success ? 0 : -1;
+
   pthread_mutex_lock(&db->db_lock);
 
   if (0 != c_psql_check_connection(db)) {
@@ -835,8 +1331,13 @@ static int c_psql_write(const data_set_t *ds, const value_list_t *vl,
   for (size_t i = 0; i < db->writers_num; ++i) {
     c_psql_writer_t *writer;
     PGresult *res;
+    char name[64];
+
+    if (db->copies[i] != NULL)
+      continue;
 
     writer = db->writers[i];
+    snprintf(name, sizeof(name), "collectd_writer_%" PRIsz, i);
 
     if (values_type_to_sqlarray(ds, values_type_str, sizeof(values_type_str),
                                 writer->store_rates) == NULL) {
@@ -853,9 +1354,9 @@ static int c_psql_write(const data_set_t *ds, const value_list_t *vl,
     params[7] = values_type_str;
     params[8] = values_str;
 
-    res = PQexecParams(db->conn, writer->statement, STATIC_ARRAY_SIZE(params),
-                       NULL, (const char *const *)params, NULL, NULL,
-                       /* return text data */ 0);
+    res = c_psql_exec_prepared(db, name, writer->statement,
+                               &db->w_prepared[i], STATIC_ARRAY_SIZE(params),
+                               (const char *const *)params);
 
     if ((PGRES_COMMAND_OK != PQresultStatus(res)) &&
         (PGRES_TUPLES_OK != PQresultStatus(res))) {
@@ -864,9 +1365,9 @@ static int c_psql_write(const data_set_t *ds, const value_list_t *vl,
       if ((CONNECTION_OK != PQstatus(db->conn)) &&
           (0 == c_psql_check_connection(db))) {
         /* try again */
-        res = PQexecParams(
-            db->conn, writer->statement, STATIC_ARRAY_SIZE(params), NULL,
-            (const char *const *)params, NULL, NULL, /* return text data */ 0);
+        res = c_psql_exec_prepared(
+            db, name, writer->statement, &db->w_prepared[i],
+            STATIC_ARRAY_SIZE(params), (const char *const *)params);
 
         if ((PGRES_COMMAND_OK == PQresultStatus(res)) ||
             (PGRES_TUPLES_OK == PQresultStatus(res))) {
@@ -921,6 +1422,18 @@ static int c_psql_flush(cdtime_t timeout,
   for (size_t i = 0; i < dbs_num; ++i) {
     c_psql_database_t *db = dbs[i];
 
+    /* rows queued for COPY are sent by their thread */
+    for (size_t j = 0; (db->copies != NULL) && (j < db->writers_num); ++j) {
+      c_psql_copy_t *copy = db->copies[j];
+      if (copy == NULL)
+        continue;
+
+      pthread_mutex_lock(&copy->lock);
+      copy->flush = true;
+      pthread_cond_signal(&copy->cond);
+      pthread_mutex_unlock(&copy->lock);
+    }
+
     /* don't commit if the timeout is larger than the regular commit
      * interval as in that case all requested data has already been
      * committed */
@@ -1093,6 +1606,10 @@ static int c_psql_config_writer(oconfig_item_t *ci) {
   writer->name = sstrdup(ci->values[0].value.string);
   writer->statement = NULL;
   writer->store_rates = true;
+  writer->table = NULL;
+
+  int batch_size = C_PSQL_COPY_BATCH_SIZE;
+  int queue_limit = C_PSQL_COPY_QUEUE_LIMIT;
 
   for (int i = 0; i < ci->children_num; ++i) {
     oconfig_item_t *c = ci->children + i;
@@ -1101,24 +1618,146 @@ static int c_psql_config_writer(oconfig_item_t *ci) {
       status = cf_util_get_string(c, &writer->statement);
     else if (strcasecmp("StoreRates", c->key) == 0)
       status = cf_util_get_boolean(c, &writer->store_rates);
+    else if (strcasecmp("Table", c->key) == 0)
+      status = cf_util_get_string(c, &writer->table);
+    else if (strcasecmp("BatchSize", c->key) == 0)
+      status = cf_util_get_int(c, &batch_size);
+    else if (strcasecmp("QueueLimit", c->key) == 0)
+      status = cf_util_get_int(c, &queue_limit);
     else
       log_warn("Ignoring unknown config key \"%s\".", c->key);
   }
 
+  if ((status == 0) && ((writer->statement == NULL) == (writer->table == NULL))) {
+    log_err("Writer \"%s\": Exactly one of \"Statement\" and \"Table\" "
+            "is required.",
+            writer->name);
+    status = -1;
+  }
+
+  if ((status == 0) && ((batch_size < 1) || (queue_limit < batch_size))) {
+    log_err("Writer \"%s\": \"BatchSize\" must be positive and not larger "
+            "than \"QueueLimit\".",
+            writer->name);
+    status = -1;
+  }
+
   if (status != 0) {
     sfree(writer->statement);
+    sfree(writer->table);
     sfree(writer->name);
     return status;
   }
 
+  writer->batch_size = (size_t)batch_size;
+  writer->queue_limit = (size_t)queue_limit;
+
   ++writers_num;
   return 0;
 } /* c_psql_config_writer */
 
+/* Allocates the per-query state of `db'. */
+static int c_psql_database_prepare(c_psql_database_t *db) {
+  if (db->queries_num == 0)
+    return 0;
+
+  db->q_prep_areas = calloc(db->queries_num, sizeof(*db->q_prep_areas));
+  db->q_prepared = calloc(db->queries_num, sizeof(*db->q_prepared));
+  if ((db->q_prep_areas == NULL) || (db->q_prepared == NULL)) {
+    log_err("Out of memory.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < db->queries_num; ++i) {
+    c_psql_user_data_t *data;
+    data = udb_query_get_user_data(db->queries[i]);
+    if ((data != NULL) && (data->params_num > db->max_params_num))
+      db->max_params_num = data->params_num;
+
+    db->q_prep_areas[i] = udb_query_allocate_preparation_area(db->queries[i]);
+
+    if (db->q_prep_areas[i] == NULL) {
+      log_err("Out of memory.");
+      return -1;
+    }
+  }
+  return 0;
+} /* c_psql_database_prepare */
+
+/* Distributes the queries of `db' over up to `connections' connections per
+ * query interval. Each connection gets a read callback of its own, so that
+ * the queries run in parallel. `db' keeps the first group of queries and
+ * any writers. */
+static int c_psql_register_queries(c_psql_database_t *db, size_t connections,
+                                   cdtime_t interval) {
+  size_t group_ids[db->queries_num];
+  size_t groups_num = udb_query_group(db->queries, db->queries_num,
+                                      connections, group_ids);
+
+  udb_query_t **all_queries = db->queries;
+  size_t all_queries_num = db->queries_num;
+
+  db->queries = NULL;
+  db->queries_num = 0;
+
+  int status = 0;
+  for (size_t g = 0; g < groups_num; ++g) {
+    c_psql_database_t *group_db = (g == 0) ? db : c_psql_database_clone(db);
+    if (group_db == NULL) {
+      status = -1;
+      break;
+    }
+
+    for (size_t i = 0; i < all_queries_num; ++i) {
+      if (group_ids[i] != g)
+        continue;
+
+      udb_query_t **tmp = realloc(
+          group_db->queries, (group_db->queries_num + 1) * sizeof(*tmp));
+      if (tmp == NULL) {
+        log_err("Out of memory.");
+        status = -1;
+        break;
+      }
+      group_db->queries = tmp;
+      group_db->queries[group_db->queries_num++] = all_queries[i];
+    }
+
+    if ((status != 0) || (c_psql_database_prepare(group_db) != 0)) {
+      /* The caller releases `db' itself. */
+      if (group_db != db)
+        c_psql_database_delete(group_db);
+      status = -1;
+      break;
+    }
+
+    char cb_name[DATA_MAX_NAME_LEN];
+    if (g == 0)
+      snprintf(cb_name, sizeof(cb_name), "postgresql-%s", db->instance);
+    else
+      snprintf(cb_name, sizeof(cb_name), "postgresql-%s-%" PRIsz,
+               db->instance, g);
+
+    cdtime_t group_interval = udb_query_get_interval(group_db->queries[0]);
+    if (group_interval == 0)
+      group_interval = interval;
+
+    user_data_t ud = {.data = group_db, .free_func = c_psql_database_delete};
+
+    ++group_db->ref_cnt;
+    plugin_register_complex_read("postgresql", cb_name, c_psql_read,
+                                 group_interval, &ud);
+  }
+
+  sfree(all_queries);
+  return status;
+} /* c_psql_register_queries */
+
 static int c_psql_config_database(oconfig_item_t *ci) {
   c_psql_database_t *db;
 
   cdtime_t interval = 0;
+  int connections = 1;
   char cb_name[DATA_MAX_NAME_LEN];
   static bool have_flush;
 
@@ -1160,6 +1799,8 @@ static int c_psql_config_database(oconfig_item_t *ci) {
                         &db->writers_num);
     else if (0 == strcasecmp(c->key, "Interval"))
       cf_util_get_cdtime(c, &interval);
+    else if (0 == strcasecmp(c->key, "Connections"))
+      cf_util_get_int(c, &connections);
     else if (strcasecmp("CommitInterval", c->key) == 0)
       cf_util_get_cdtime(c, &db->commit_interval);
     else if (strcasecmp("ExpireDelay", c->key) == 0)
@@ -1175,39 +1816,47 @@ static int c_psql_config_database(oconfig_item_t *ci) {
                                        &db->queries, &db->queries_num);
   }
 
-  if (db->queries_num > 0) {
-    db->q_prep_areas = calloc(db->queries_num, sizeof(*db->q_prep_areas));
-    if (db->q_prep_areas == NULL) {
+  if (connections < 1) {
+    log_warn("Database '%s': 'Connections' must be at least 1.",
+             db->database);
+    connections = 1;
+  }
+
+  if (db->writers_num > 0) {
+    db->w_prepared = calloc(db->writers_num, sizeof(*db->w_prepared));
+    db->copies = calloc(db->writers_num, sizeof(*db->copies));
+    if ((db->w_prepared == NULL) || (db->copies == NULL)) {
       log_err("Out of memory.");
       c_psql_database_delete(db);
       return -1;
     }
-  }
 
-  for (int i = 0; (size_t)i < db->queries_num; ++i) {
-    c_psql_user_data_t *data;
-    data = udb_query_get_user_data(db->queries[i]);
-    if ((data != NULL) && (data->params_num > db->max_params_num))
-      db->max_params_num = data->params_num;
-
-    db->q_prep_areas[i] = udb_query_allocate_preparation_area(db->queries[i]);
+    for (size_t i = 0; i < db->writers_num; ++i) {
+      if (db->writers[i]->table == NULL)
+        continue;
 
-    if (db->q_prep_areas[i] == NULL) {
-      log_err("Out of memory.");
-      c_psql_database_delete(db);
-      return -1;
+      db->copies[i] = c_psql_copy_create(db, db->writers[i]);
+      if (db->copies[i] == NULL) {
+        log_err("Out of memory.");
+        c_psql_database_delete(db);
+        return -1;
+      }
     }
   }
 
+  /* Keep the database object alive while registering its read callbacks. */
+  ++db->ref_cnt;
+
+  if ((db->queries_num > 0) &&
+      (0 != c_psql_register_queries(db, (size_t)connections, interval))) {
+    c_psql_database_delete(db);
+    return -1;
+  }
+
   snprintf(cb_name, sizeof(cb_name), "postgresql-%s", db->instance);
 
   user_data_t ud = {.data = db, .free_func = c_psql_database_delete};
 
-  if (db->queries_num > 0) {
-    ++db->ref_cnt;
-    plugin_register_complex_read("postgresql", cb_name, c_psql_read, interval,
-                                 &ud);
-  }
   if (db->writers_num > 0) {
     ++db->ref_cnt;
     plugin_register_write(cb_name, c_psql_write, &ud);
@@ -1227,6 +1876,8 @@ static int c_psql_config_database(oconfig_item_t *ci) {
              "not have any effect.",
              db->database);
   }
+
+  c_psql_database_delete(db);
   return 0;
 } /* c_psql_config_database */
 
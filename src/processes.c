@@ -39,6 +39,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
 #if HAVE_LIBTASKSTATS
@@ -174,6 +175,8 @@
 typedef struct process_entry_s {
   unsigned long id;
   char name[PROCSTAT_NAME_LEN];
+  /* Start time of the process, to tell a reused PID apart (Linux only). */
+  unsigned long long start_time;
 
   unsigned long num_proc;
   unsigned long num_lwp;
@@ -209,6 +212,8 @@ typedef struct process_entry_s {
 #endif
   bool has_delay;
 
+  bool has_status;
+
   bool has_fd;
 
   bool has_maps;
@@ -311,7 +316,58 @@ static mach_msg_type_number_t pset_list_len;
 
 #elif KERNEL_LINUX
 static long pagesize_g;
-static void ps_fill_details(const procstat_t *ps, process_entry_t *entry);
+
+/* Number of threads reading the files below /proc/<pid>, including the read
+ * thread of the plugin. */
+static int ps_read_threads = 1;
+/* The command line is only needed to match "ProcessMatch" regexes. */
+static bool ps_need_cmdline;
+
+/* The PIDs of a read are handed out to the scanning threads in chunks of this
+ * size. */
+#define PS_SCAN_CHUNK 64
+
+typedef struct {
+  int running;
+  int sleeping;
+  int zombies;
+  int stopped;
+  int paging;
+  int blocked;
+} ps_state_count_t;
+
+typedef struct {
+  long *pids;
+  size_t pids_num;
+
+  /* lock protects next, count and the procstat_t list while scanning. */
+  pthread_mutex_t lock;
+  size_t next;
+  ps_state_count_t count;
+} ps_scan_t;
+
+static long *ps_pids;
+static size_t ps_pids_size;
+
+/* ps_match_t caches the procstat_t groups a process is matched by, so that
+ * its command line is read and matched against the "ProcessMatch" regexes
+ * once per process rather than on every read. */
+typedef struct {
+  unsigned long pid;
+  unsigned long long start_time;
+  char *name;
+  /* Scan in which the process was last seen. */
+  unsigned int generation;
+
+  procstat_t **matches;
+  size_t matches_num;
+} ps_match_t;
+
+/* Maps a PID to its ps_match_t. The lock is only held to look up and insert
+ * entries: an entry is only used by the thread scanning its PID. */
+static c_avl_tree_t *ps_match_cache;
+static pthread_mutex_t ps_match_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int ps_generation;
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -506,92 +562,94 @@ static void ps_update_delay(procstat_t *out, procstat_entry_t *prev,
 }
 #endif
 
-/* add process entry to 'instances' of process 'name' (or refresh it) */
-static void ps_list_add(const char *name, const char *cmdline,
-                        process_entry_t *entry) {
+/* add process entry to 'instances' of the procstat "ps" (or refresh it) */
+static void ps_list_add_entry(procstat_t *ps, process_entry_t *entry) {
   procstat_entry_t *pse;
 
-  if (entry->id == 0)
-    return;
+  for (pse = ps->instances; pse != NULL; pse = pse->next)
+    if ((pse->id == entry->id) || (pse->next == NULL))
+      break;
 
-  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
-    if ((ps_list_match(name, cmdline, ps)) == 0)
-      continue;
+  if ((pse == NULL) || (pse->id != entry->id)) {
+    procstat_entry_t *new;
 
-#if KERNEL_LINUX
-    ps_fill_details(ps, entry);
-#endif
+    new = calloc(1, sizeof(*new));
+    if (new == NULL)
+      return;
+    new->id = entry->id;
 
-    for (pse = ps->instances; pse != NULL; pse = pse->next)
-      if ((pse->id == entry->id) || (pse->next == NULL))
-        break;
+    if (pse == NULL)
+      ps->instances = new;
+    else
+      pse->next = new;
 
-    if ((pse == NULL) || (pse->id != entry->id)) {
-      procstat_entry_t *new;
+    pse = new;
+  }
 
-      new = calloc(1, sizeof(*new));
-      if (new == NULL)
-        return;
-      new->id = entry->id;
+  pse->age = 0;
+
+  ps->num_proc += entry->num_proc;
+  ps->num_lwp += entry->num_lwp;
+  ps->num_fd += entry->num_fd;
+  ps->num_maps += entry->num_maps;
+  ps->vmem_size += entry->vmem_size;
+  ps->vmem_rss += entry->vmem_rss;
+  ps->vmem_data += entry->vmem_data;
+  ps->vmem_code += entry->vmem_code;
+  ps->stack_size += entry->stack_size;
+
+  if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
+    ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
+    ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
+  }
 
-      if (pse == NULL)
-        ps->instances = new;
-      else
-        pse->next = new;
+  if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
+    ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
+    ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
+  }
 
-      pse = new;
-    }
+  if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
+    ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
+    ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
+  }
 
-    pse->age = 0;
-
-    ps->num_proc += entry->num_proc;
-    ps->num_lwp += entry->num_lwp;
-    ps->num_fd += entry->num_fd;
-    ps->num_maps += entry->num_maps;
-    ps->vmem_size += entry->vmem_size;
-    ps->vmem_rss += entry->vmem_rss;
-    ps->vmem_data += entry->vmem_data;
-    ps->vmem_code += entry->vmem_code;
-    ps->stack_size += entry->stack_size;
-
-    if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
-      ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
-      ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
-    }
+  if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
+    ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol, entry->cswitch_vol);
+    ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
+                      entry->cswitch_invol);
+  }
 
-    if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
-      ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
-      ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
-    }
+  ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
+                    entry->vmem_minflt_counter);
+  ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
+                    entry->vmem_majflt_counter);
 
-    if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
-      ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
-      ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
-    }
+  ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
+                    entry->cpu_user_counter);
+  ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
+                    entry->cpu_system_counter);
 
-    if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
-      ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol,
-                        entry->cswitch_vol);
-      ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
-                        entry->cswitch_invol);
-    }
+#if HAVE_LIBTASKSTATS
+  if (entry->has_delay)
+    ps_update_delay(ps, pse, entry);
+#endif
+} /* void ps_list_add_entry */
 
-    ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
-                      entry->vmem_minflt_counter);
-    ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
-                      entry->vmem_majflt_counter);
+#if !KERNEL_LINUX
+/* add process entry to 'instances' of process 'name' (or refresh it) */
+static void ps_list_add(const char *name, const char *cmdline,
+                        process_entry_t *entry) {
+  if (entry->id == 0)
+    return;
 
-    ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
-                      entry->cpu_user_counter);
-    ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
-                      entry->cpu_system_counter);
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
+    if ((ps_list_match(name, cmdline, ps)) == 0)
+      continue;
 
-#if HAVE_LIBTASKSTATS
-    if (entry->has_delay)
-      ps_update_delay(ps, pse, entry);
-#endif
+    ps_list_add_entry(ps, entry);
   }
 }
+#endif /* !KERNEL_LINUX */
 
 /* remove old entries from instances of processes in list_head_g */
 static void ps_list_reset(void) {
@@ -724,6 +782,20 @@ static int ps_config(oconfig_item_t *ci) {
 #else
       WARNING("processes plugin: The plugin has been compiled without support "
               "for the \"CollectDelayAccounting\" option.");
+#endif
+    } else if (strcasecmp(c->key, "ReadThreads") == 0) {
+#if KERNEL_LINUX
+      int tmp = 0;
+      if (cf_util_get_int(c, &tmp) != 0)
+        continue;
+      if (tmp < 1) {
+        WARNING("processes plugin: \"ReadThreads\" must be at least 1.");
+        continue;
+      }
+      ps_read_threads = tmp;
+#else
+      WARNING("processes plugin: The \"ReadThreads\" option is only "
+              "available on Linux.");
 #endif
     } else {
       ERROR("processes plugin: The `%s' configuration option is not "
@@ -763,6 +835,13 @@ static int ps_init(void) {
   pagesize_g = sysconf(_SC_PAGESIZE);
   DEBUG("pagesize_g = %li; CONFIG_HZ = %i;", pagesize_g, CONFIG_HZ);
 
+  ps_need_cmdline = false;
+#if HAVE_REGEX_H
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next)
+    if (ps->re != NULL)
+      ps_need_cmdline = true;
+#endif
+
 #if HAVE_LIBTASKSTATS
   if (taskstats_handle == NULL) {
     taskstats_handle = ts_create();
@@ -1254,6 +1333,17 @@ static int ps_delay(process_entry_t *ps) {
 #endif
 
 static void ps_fill_details(const procstat_t *ps, process_entry_t *entry) {
+  /* Zombies have no memory. */
+  if ((entry->has_status == false) && (entry->num_proc > 0)) {
+    if (ps_read_status(entry->id, entry) != 0) {
+      /* No VMem data */
+      entry->vmem_data = -1;
+      entry->vmem_code = -1;
+      DEBUG("ps_fill_details: did not get vmem data for pid %lu", entry->id);
+    }
+    entry->has_status = true;
+  }
+
   if (entry->has_io == false) {
     ps_read_io(entry);
     entry->has_io = true;
@@ -1363,18 +1453,15 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
   }
 
   *state = fields[0][0];
+  ps->start_time = strtoull(fields[19], /* endptr = */ NULL, /* base = */ 10);
 
   if (*state == 'Z') {
     ps->num_lwp = 0;
     ps->num_proc = 0;
   } else {
+    /* VmData etc. are read from /proc/<pid>/status by ps_fill_details(), only
+     * for processes that are matched. */
     ps->num_lwp = strtoul(fields[17], /* endptr = */ NULL, /* base = */ 10);
-    if ((ps_read_status(pid, ps)) != 0) {
-      /* No VMem data */
-      ps->vmem_data = -1;
-      ps->vmem_code = -1;
-      DEBUG("ps_read_process: did not get vmem data for pid %li", pid);
-    }
     if (ps->num_lwp == 0)
       ps->num_lwp = 1;
     ps->num_proc = 1;
@@ -1557,6 +1644,328 @@ static int read_fork_rate(void) {
   ps_submit_fork_rate(value.derive);
   return 0;
 }
+
+static void ps_count_state(ps_state_count_t *count, char state) {
+  switch (state) {
+  case 'R':
+    count->running++;
+    break;
+  case 'S':
+    count->sleeping++;
+    break;
+  case 'D':
+    count->blocked++;
+    break;
+  case 'Z':
+    count->zombies++;
+    break;
+  case 'T':
+    count->stopped++;
+    break;
+  case 'W':
+    count->paging++;
+    break;
+  }
+} /* void ps_count_state */
+
+static int ps_match_compare(void const *a, void const *b) {
+  unsigned long pid_a = *((unsigned long const *)a);
+  unsigned long pid_b = *((unsigned long const *)b);
+
+  if (pid_a < pid_b)
+    return -1;
+  else if (pid_a > pid_b)
+    return 1;
+  return 0;
+} /* int ps_match_compare */
+
+static void ps_match_free(ps_match_t *m) {
+  if (m == NULL)
+    return;
+
+  sfree(m->name);
+  sfree(m->matches);
+  sfree(m);
+} /* void ps_match_free */
+
+/* ps_match_update matches a process against all procstat_t groups. */
+static int ps_match_update(ps_match_t *m, process_entry_t const *pse,
+                           char *cmdline, size_t cmdline_size) {
+  char const *cmd = NULL;
+  if (ps_need_cmdline)
+    cmd = ps_get_cmdline((long)pse->id, (char *)pse->name, cmdline,
+                         cmdline_size);
+
+  char *name = strdup(pse->name);
+  if (name == NULL)
+    return ENOMEM;
+  sfree(m->name);
+  m->name = name;
+  m->start_time = pse->start_time;
+  m->matches_num = 0;
+
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
+    if (ps_list_match(pse->name, cmd, ps) == 0)
+      continue;
+
+    procstat_t **tmp =
+        realloc(m->matches, (m->matches_num + 1) * sizeof(*m->matches));
+    if (tmp == NULL)
+      return ENOMEM;
+    m->matches = tmp;
+    m->matches[m->matches_num] = ps;
+    m->matches_num++;
+  }
+
+  return 0;
+} /* int ps_match_update */
+
+/* ps_match_get returns the cached matches of a process. The process is
+ * matched again if its PID has been reused or it has exec()ed since, i.e. if
+ * its start time or name changed. */
+static ps_match_t *ps_match_get(process_entry_t const *pse, char *cmdline,
+                                size_t cmdline_size) {
+  ps_match_t *m = NULL;
+
+  pthread_mutex_lock(&ps_match_lock);
+  c_avl_get(ps_match_cache, &pse->id, (void *)&m);
+  pthread_mutex_unlock(&ps_match_lock);
+
+  if ((m != NULL) && (m->start_time == pse->start_time) &&
+      (strcmp(m->name, pse->name) == 0)) {
+    m->generation = ps_generation;
+    return m;
+  }
+
+  bool is_new = (m == NULL);
+  if (is_new) {
+    m = calloc(1, sizeof(*m));
+    if (m == NULL)
+      return NULL;
+    m->pid = pse->id;
+  }
+
+  if (ps_match_update(m, pse, cmdline, cmdline_size) != 0) {
+    ERROR("processes plugin: Matching process %lu failed.", pse->id);
+    if (!is_new) {
+      pthread_mutex_lock(&ps_match_lock);
+      c_avl_remove(ps_match_cache, &m->pid, NULL, NULL);
+      pthread_mutex_unlock(&ps_match_lock);
+    }
+    ps_match_free(m);
+    return NULL;
+  }
+  m->generation = ps_generation;
+
+  if (is_new) {
+    pthread_mutex_lock(&ps_match_lock);
+    int status = c_avl_insert(ps_match_cache, &m->pid, m);
+    pthread_mutex_unlock(&ps_match_lock);
+    if (status != 0) {
+      ERROR("processes plugin: c_avl_insert failed.");
+      ps_match_free(m);
+      return NULL;
+    }
+  }
+
+  return m;
+} /* ps_match_t *ps_match_get */
+
+/* ps_match_expire removes the processes that have not been seen by the last
+ * scan from the cache. */
+static void ps_match_expire(void) {
+  ps_match_t **expired = NULL;
+  size_t expired_num = 0;
+  unsigned long *pid;
+  ps_match_t *m;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(ps_match_cache);
+  if (iter == NULL)
+    return;
+  while (c_avl_iterator_next(iter, (void *)&pid, (void *)&m) == 0) {
+    if (m->generation == ps_generation)
+      continue;
+
+    ps_match_t **tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+    if (tmp == NULL)
+      break;
+    expired = tmp;
+    expired[expired_num] = m;
+    expired_num++;
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < expired_num; i++) {
+    c_avl_remove(ps_match_cache, &expired[i]->pid, NULL, NULL);
+    ps_match_free(expired[i]);
+  }
+  sfree(expired);
+} /* void ps_match_expire */
+
+/* ps_scan_pid reads /proc/<pid>/stat. The other files of the process are only
+ * read if it is matched by a "Process" or "ProcessMatch" option, and only the
+ * update of the matching procstat_t is done with scan->lock held. */
+static void ps_scan_pid(ps_scan_t *scan, long pid, ps_state_count_t *count,
+                        char *cmdline, size_t cmdline_size) {
+  process_entry_t pse = {.id = pid};
+  char state;
+
+  int status = ps_read_process(pid, &pse, &state);
+  if (status != 0) {
+    DEBUG("ps_read_process failed: %i", status);
+    return;
+  }
+
+  ps_count_state(count, state);
+
+  if (list_head_g == NULL)
+    return;
+
+  ps_match_t *m = ps_match_get(&pse, cmdline, cmdline_size);
+  if ((m == NULL) || (m->matches_num == 0))
+    return;
+
+  for (size_t i = 0; i < m->matches_num; i++)
+    ps_fill_details(m->matches[i], &pse);
+
+  pthread_mutex_lock(&scan->lock);
+  for (size_t i = 0; i < m->matches_num; i++)
+    ps_list_add_entry(m->matches[i], &pse);
+  pthread_mutex_unlock(&scan->lock);
+} /* void ps_scan_pid */
+
+static void *ps_scan_thread(void *arg) {
+  ps_scan_t *scan = arg;
+  ps_state_count_t count = {0};
+  char cmdline[CMDLINE_BUFFER_SIZE];
+
+  while (42) {
+    pthread_mutex_lock(&scan->lock);
+    size_t begin = scan->next;
+    size_t end = begin + PS_SCAN_CHUNK;
+    if (end > scan->pids_num)
+      end = scan->pids_num;
+    scan->next = end;
+    pthread_mutex_unlock(&scan->lock);
+
+    if (begin >= end)
+      break;
+
+    for (size_t i = begin; i < end; i++)
+      ps_scan_pid(scan, scan->pids[i], &count, cmdline, sizeof(cmdline));
+  }
+
+  pthread_mutex_lock(&scan->lock);
+  scan->count.running += count.running;
+  scan->count.sleeping += count.sleeping;
+  scan->count.zombies += count.zombies;
+  scan->count.stopped += count.stopped;
+  scan->count.paging += count.paging;
+  scan->count.blocked += count.blocked;
+  pthread_mutex_unlock(&scan->lock);
+
+  return NULL;
+} /* void *ps_scan_thread */
+
+/* ps_list_pids reads the PIDs below /proc into ps_pids. */
+static int ps_list_pids(size_t *ret_pids_num) {
+  DIR *proc;
+  struct dirent *ent;
+  size_t pids_num = 0;
+
+  if ((proc = opendir("/proc")) == NULL) {
+    ERROR("Cannot open `/proc': %s", STRERRNO);
+    return -1;
+  }
+
+  while ((ent = readdir(proc)) != NULL) {
+    long pid;
+
+    if (!isdigit(ent->d_name[0]))
+      continue;
+
+    if ((pid = atol(ent->d_name)) < 1)
+      continue;
+
+    if (pids_num >= ps_pids_size) {
+      size_t new_size = (ps_pids_size == 0) ? 1024 : 2 * ps_pids_size;
+      long *tmp = realloc(ps_pids, new_size * sizeof(*ps_pids));
+      if (tmp == NULL) {
+        ERROR("processes plugin: realloc failed.");
+        closedir(proc);
+        return -1;
+      }
+      ps_pids = tmp;
+      ps_pids_size = new_size;
+    }
+
+    ps_pids[pids_num] = pid;
+    pids_num++;
+  }
+
+  closedir(proc);
+
+  *ret_pids_num = pids_num;
+  return 0;
+} /* int ps_list_pids */
+
+/* ps_scan reads all processes, using up to ps_read_threads threads. */
+static int ps_scan(ps_state_count_t *ret_count) {
+  ps_scan_t scan = {.pids = NULL};
+
+  if ((list_head_g != NULL) && (ps_match_cache == NULL)) {
+    ps_match_cache = c_avl_create(ps_match_compare);
+    if (ps_match_cache == NULL) {
+      ERROR("processes plugin: c_avl_create failed.");
+      return -1;
+    }
+  }
+  ps_generation++;
+
+  int status = ps_list_pids(&scan.pids_num);
+  if (status != 0)
+    return status;
+  scan.pids = ps_pids;
+
+  size_t threads_num = (size_t)ps_read_threads - 1;
+  if (threads_num > (scan.pids_num / PS_SCAN_CHUNK))
+    threads_num = scan.pids_num / PS_SCAN_CHUNK;
+
+  pthread_t *threads = NULL;
+  if (threads_num > 0) {
+    threads = calloc(threads_num, sizeof(*threads));
+    if (threads == NULL)
+      threads_num = 0;
+  }
+
+  pthread_mutex_init(&scan.lock, /* attr = */ NULL);
+
+  size_t started = 0;
+  for (; started < threads_num; started++) {
+    status = plugin_thread_create(&threads[started], /* attr = */ NULL,
+                                  ps_scan_thread, &scan, "processes scan");
+    if (status != 0) {
+      /* The remaining PIDs are read by the calling thread. */
+      WARNING("processes plugin: Starting a scan thread failed: %s",
+              STRERROR(status));
+      break;
+    }
+  }
+
+  ps_scan_thread(&scan);
+
+  for (size_t i = 0; i < started; i++)
+    pthread_join(threads[i], /* retval = */ NULL);
+  sfree(threads);
+
+  pthread_mutex_destroy(&scan.lock);
+
+  if (ps_match_cache != NULL)
+    ps_match_expire();
+
+  *ret_count = scan.count;
+  return 0;
+} /* int ps_scan */
 #endif /*KERNEL_LINUX */
 
 #if KERNEL_SOLARIS
@@ -2016,80 +2425,19 @@ static int ps_read(void) {
 /* #endif HAVE_THREAD_INFO */
 
 #elif KERNEL_LINUX
-  int running = 0;
-  int sleeping = 0;
-  int zombies = 0;
-  int stopped = 0;
-  int paging = 0;
-  int blocked = 0;
-
-  struct dirent *ent;
-  DIR *proc;
-  long pid;
-
-  char cmdline[CMDLINE_BUFFER_SIZE];
-
-  int status;
-  process_entry_t pse;
-  char state;
+  ps_state_count_t count = {0};
 
-  running = sleeping = zombies = stopped = paging = blocked = 0;
   ps_list_reset();
 
-  if ((proc = opendir("/proc")) == NULL) {
-    ERROR("Cannot open `/proc': %s", STRERRNO);
+  if (ps_scan(&count) != 0)
     return -1;
-  }
-
-  while ((ent = readdir(proc)) != NULL) {
-    if (!isdigit(ent->d_name[0]))
-      continue;
-
-    if ((pid = atol(ent->d_name)) < 1)
-      continue;
-
-    memset(&pse, 0, sizeof(pse));
-    pse.id = pid;
-
-    status = ps_read_process(pid, &pse, &state);
-    if (status != 0) {
-      DEBUG("ps_read_process failed: %i", status);
-      continue;
-    }
-
-    switch (state) {
-    case 'R':
-      running++;
-      break;
-    case 'S':
-      sleeping++;
-      break;
-    case 'D':
-      blocked++;
-      break;
-    case 'Z':
-      zombies++;
-      break;
-    case 'T':
-      stopped++;
-      break;
-    case 'W':
-      paging++;
-      break;
-    }
 
-    ps_list_add(pse.name,
-                ps_get_cmdline(pid, pse.name, cmdline, sizeof(cmdline)), &pse);
-  }
-
-  closedir(proc);
-
-  ps_submit_state("running", running);
-  ps_submit_state("sleeping", sleeping);
-  ps_submit_state("zombies", zombies);
-  ps_submit_state("stopped", stopped);
-  ps_submit_state("paging", paging);
-  ps_submit_state("blocked", blocked);
+  ps_submit_state("running", count.running);
+  ps_submit_state("sleeping", count.sleeping);
+  ps_submit_state("zombies", count.zombies);
+  ps_submit_state("stopped", count.stopped);
+  ps_submit_state("paging", count.paging);
+  ps_submit_state("blocked", count.blocked);
 
   for (procstat_t *ps_ptr = list_head_g; ps_ptr != NULL; ps_ptr = ps_ptr->next)
     ps_submit_proc_list(ps_ptr);
@@ -2638,8 +2986,34 @@ static int ps_read(void) {
   return 0;
 } /* int ps_read */
 
+#if KERNEL_LINUX
+static int ps_shutdown(void) {
+  sfree(ps_pids);
+  ps_pids_size = 0;
+
+  if (ps_match_cache != NULL) {
+    unsigned long *pid;
+    ps_match_t *m;
+    while (c_avl_pick(ps_match_cache, (void *)&pid, (void *)&m) == 0)
+      ps_match_free(m);
+    c_avl_destroy(ps_match_cache);
+    ps_match_cache = NULL;
+  }
+
+#if HAVE_LIBTASKSTATS
+  ts_destroy(taskstats_handle);
+  taskstats_handle = NULL;
+#endif
+
+  return 0;
+} /* int ps_shutdown */
+#endif
+
 void module_register(void) {
   plugin_register_complex_config("processes", ps_config);
   plugin_register_init("processes", ps_init);
   plugin_register_read("processes", ps_read);
+#if KERNEL_LINUX
+  plugin_register_shutdown("processes", ps_shutdown);
+#endif
 } /* void module_register */
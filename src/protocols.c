@@ -29,6 +29,7 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
+#include "utils/procfs/procfs.h"
 
 #if !KERNEL_LINUX
 #error "No applicable input method."
@@ -47,70 +48,213 @@ static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static ignorelist_t *values_list;
 
+/* The column selection of one keys/values line pair, e.g. "Tcp". It is
+ * computed from the keys line when it is first read and only recomputed when
+ * the keys line changes, so that reading the values line does not match or
+ * format any strings. */
+typedef struct {
+  char *name;
+  char *keys;
+
+  /* For every column, the index into `vls' or -1 if the column is ignored. */
+  int *columns;
+  size_t columns_num;
+
+  /* One value list per selected column, with the identifier filled in. */
+  value_list_t *vls;
+  value_t *values;
+  size_t vls_num;
+} proto_section_t;
+
+typedef struct {
+  char const *path;
+  procfs_file_t *pf;
+  proto_section_t *sections;
+  size_t sections_num;
+} proto_file_t;
+
+static proto_file_t snmp_file = {.path = SNMP_FILE};
+static proto_file_t netstat_file = {.path = NETSTAT_FILE};
+
 /*
  * Functions
  */
-static void submit(const char *protocol_name, const char *str_key,
-                   const char *str_value) {
-  value_t value;
-  value_list_t vl = VALUE_LIST_INIT;
-  int status;
+static void section_clear(proto_section_t *s) /* {{{ */
+{
+  sfree(s->name);
+  sfree(s->keys);
+  sfree(s->columns);
+  sfree(s->vls);
+  sfree(s->values);
+  s->columns_num = 0;
+  s->vls_num = 0;
+} /* }}} void section_clear */
+
+/* Builds the column selection of the section `name' from the keys line
+ * `keys', i.e. everything after the colon. */
+static int section_init(proto_section_t *s, char const *name, /* {{{ */
+                        char const *keys) {
+  section_clear(s);
+
+  s->name = strdup(name);
+  s->keys = strdup(keys);
+  char *fields = strdup(keys);
+  if ((s->name == NULL) || (s->keys == NULL) || (fields == NULL)) {
+    sfree(fields);
+    section_clear(s);
+    return ENOMEM;
+  }
 
-  status = parse_value(str_value, &value, DS_TYPE_DERIVE);
-  if (status != 0) {
-    return;
+  size_t num = 0;
+  for (char const *ptr = keys; *ptr != 0;) {
+    while (isspace((unsigned char)*ptr))
+      ptr++;
+    if (*ptr == 0)
+      break;
+    num++;
+    while ((*ptr != 0) && !isspace((unsigned char)*ptr))
+      ptr++;
+  }
+
+  if (num > 0) {
+    s->columns = calloc(num, sizeof(*s->columns));
+    s->vls = calloc(num, sizeof(*s->vls));
+    s->values = calloc(num, sizeof(*s->values));
+    if ((s->columns == NULL) || (s->vls == NULL) || (s->values == NULL)) {
+      sfree(fields);
+      section_clear(s);
+      return ENOMEM;
+    }
   }
 
-  vl.values = &value;
-  vl.values_len = 1;
-  sstrncpy(vl.plugin, "protocols", sizeof(vl.plugin));
-  sstrncpy(vl.plugin_instance, protocol_name, sizeof(vl.plugin_instance));
-  sstrncpy(vl.type, "protocol_counter", sizeof(vl.type));
-  sstrncpy(vl.type_instance, str_key, sizeof(vl.type_instance));
+  char *saveptr = NULL;
+  char *key;
+  for (char *ptr = fields; (key = strtok_r(ptr, " \t", &saveptr)) != NULL;
+       ptr = NULL) {
+    if (values_list != NULL) {
+      char match_name[2 * DATA_MAX_NAME_LEN];
+
+      snprintf(match_name, sizeof(match_name), "%s:%s", name, key);
+
+      if (ignorelist_match(values_list, match_name)) {
+        s->columns[s->columns_num++] = -1;
+        continue;
+      }
+    } /* if (values_list != NULL) */
+
+    value_list_t *vl = s->vls + s->vls_num;
+    *vl = (value_list_t)VALUE_LIST_INIT;
+    vl->values = s->values + s->vls_num;
+    vl->values_len = 1;
+    sstrncpy(vl->plugin, "protocols", sizeof(vl->plugin));
+    sstrncpy(vl->plugin_instance, name, sizeof(vl->plugin_instance));
+    sstrncpy(vl->type, "protocol_counter", sizeof(vl->type));
+    sstrncpy(vl->type_instance, key, sizeof(vl->type_instance));
+
+    s->columns[s->columns_num++] = (int)s->vls_num;
+    s->vls_num++;
+  }
+
+  sfree(fields);
+  return 0;
+} /* }}} int section_init */
 
-  plugin_dispatch_values(&vl);
-} /* void submit */
+/* Parses the values line against the column selection in a single pass and
+ * dispatches the selected values as one batch. */
+static int section_submit(proto_section_t *s, char *values) /* {{{ */
+{
+  size_t column = 0;
+  /* Start of the value lists not dispatched yet. */
+  size_t first = 0;
 
-static int read_file(const char *path) {
-  FILE *fh;
-  char key_buffer[4096];
-  char value_buffer[4096];
+  char *ptr = values;
+  while (42) {
+    while (isspace((unsigned char)*ptr))
+      ptr++;
+    if (*ptr == 0)
+      break;
+
+    if (column >= s->columns_num) {
+      /* Count the excess fields for the error message below. */
+      while ((*ptr != 0) && !isspace((unsigned char)*ptr))
+        ptr++;
+      column++;
+      continue;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    long long value = strtoll(ptr, &end, 0);
+    bool valid = (errno == 0) && (end != ptr) &&
+                 ((*end == 0) || isspace((unsigned char)*end));
+    /* Skip the remainder of an invalid field. */
+    while ((*end != 0) && !isspace((unsigned char)*end))
+      end++;
+    ptr = end;
+
+    int idx = s->columns[column];
+    column++;
+    if (idx < 0)
+      continue;
+
+    if (valid) {
+      s->values[idx].derive = (derive_t)value;
+    } else {
+      /* Leave out the value list of the invalid field. */
+      if ((size_t)idx > first)
+        plugin_dispatch_values_batch(s->vls + first, (size_t)idx - first);
+      first = (size_t)idx + 1;
+    }
+  }
+
+  if (column != s->columns_num) {
+    ERROR("protocols plugin: Number of fields in keys and values lines "
+          "don't match: %" PRIsz " vs %" PRIsz ".",
+          s->columns_num, column);
+    return -1;
+  }
+
+  if (s->vls_num > first)
+    plugin_dispatch_values_batch(s->vls + first, s->vls_num - first);
+
+  return 0;
+} /* }}} int section_submit */
+
+static int read_file(proto_file_t *f) {
+  char *key_buffer;
+  char *value_buffer;
   char *key_ptr;
   char *value_ptr;
-  char *key_fields[256];
-  char *value_fields[256];
-  int key_fields_num;
-  int value_fields_num;
+  size_t section_num = 0;
   int status;
-  int i;
 
-  fh = fopen(path, "r");
-  if (fh == NULL) {
-    ERROR("protocols plugin: fopen (%s) failed: %s.", path, STRERRNO);
+  if (f->pf == NULL) {
+    f->pf = procfs_open(f->path);
+    if (f->pf == NULL) {
+      ERROR("protocols plugin: open (%s) failed: %s.", f->path, STRERRNO);
+      return -1;
+    }
+  }
+
+  status = procfs_read(f->pf);
+  if (status != 0) {
+    ERROR("protocols plugin: Reading from %s failed: %s.", f->path,
+          STRERROR(status));
     return -1;
   }
 
   status = -1;
   while (42) {
-    clearerr(fh);
-    key_ptr = fgets(key_buffer, sizeof(key_buffer), fh);
-    if (key_ptr == NULL) {
-      if (feof(fh) != 0) {
-        status = 0;
-        break;
-      } else if (ferror(fh) != 0) {
-        ERROR("protocols plugin: Reading from %s failed.", path);
-        break;
-      } else {
-        ERROR("protocols plugin: fgets failed for an unknown reason.");
-        break;
-      }
-    } /* if (key_ptr == NULL) */
+    key_buffer = procfs_next_line(f->pf);
+    if (key_buffer == NULL) {
+      status = 0;
+      break;
+    }
 
-    value_ptr = fgets(value_buffer, sizeof(value_buffer), fh);
-    if (value_ptr == NULL) {
+    value_buffer = procfs_next_line(f->pf);
+    if (value_buffer == NULL) {
       ERROR("protocols plugin: read_file (%s): Could not read values line.",
-            path);
+            f->path);
       break;
     }
 
@@ -138,34 +282,35 @@ static int read_file(const char *path) {
       break;
     }
 
-    key_fields_num =
-        strsplit(key_ptr, key_fields, STATIC_ARRAY_SIZE(key_fields));
-    value_fields_num =
-        strsplit(value_ptr, value_fields, STATIC_ARRAY_SIZE(value_fields));
-
-    if (key_fields_num != value_fields_num) {
-      ERROR("protocols plugin: Number of fields in keys and values lines "
-            "don't match: %i vs %i.",
-            key_fields_num, value_fields_num);
-      break;
+    if (section_num >= f->sections_num) {
+      proto_section_t *tmp =
+          realloc(f->sections, (section_num + 1) * sizeof(*f->sections));
+      if (tmp == NULL) {
+        ERROR("protocols plugin: realloc failed.");
+        break;
+      }
+      f->sections = tmp;
+      memset(f->sections + section_num, 0, sizeof(*f->sections));
+      f->sections_num = section_num + 1;
     }
 
-    for (i = 0; i < key_fields_num; i++) {
-      if (values_list != NULL) {
-        char match_name[2 * DATA_MAX_NAME_LEN];
-
-        snprintf(match_name, sizeof(match_name), "%s:%s", key_buffer,
-                 key_fields[i]);
-
-        if (ignorelist_match(values_list, match_name))
-          continue;
-      } /* if (values_list != NULL) */
-
-      submit(key_buffer, key_fields[i], value_fields[i]);
-    } /* for (i = 0; i < key_fields_num; i++) */
-  }   /* while (42) */
+    /* The sections appear in the same order on every read, so comparing
+     * the keys line is all it takes to reuse the column selection. */
+    proto_section_t *s = f->sections + section_num;
+    section_num++;
+    if ((s->name == NULL) || (strcmp(s->name, key_buffer) != 0) ||
+        (strcmp(s->keys, key_ptr) != 0)) {
+      if (section_init(s, key_buffer, key_ptr) != 0) {
+        ERROR("protocols plugin: Building the column selection of \"%s\" "
+              "failed.",
+              key_buffer);
+        break;
+      }
+    }
 
-  fclose(fh);
+    if (section_submit(s, value_ptr) != 0)
+      break;
+  } /* while (42) */
 
   return status;
 } /* int read_file */
@@ -174,11 +319,11 @@ static int protocols_read(void) {
   int status;
   int success = 0;
 
-  status = read_file(SNMP_FILE);
+  status = read_file(&snmp_file);
   if (status == 0)
     success++;
 
-  status = read_file(NETSTAT_FILE);
+  status = read_file(&netstat_file);
   if (status == 0)
     success++;
 
@@ -206,8 +351,24 @@ static int protocols_config(const char *key, const char *value) {
   return 0;
 } /* int protocols_config */
 
+static void file_close(proto_file_t *f) {
+  procfs_close(f->pf);
+  f->pf = NULL;
+  for (size_t i = 0; i < f->sections_num; i++)
+    section_clear(f->sections + i);
+  sfree(f->sections);
+  f->sections_num = 0;
+} /* void file_close */
+
+static int protocols_shutdown(void) {
+  file_close(&snmp_file);
+  file_close(&netstat_file);
+  return 0;
+} /* int protocols_shutdown */
+
 void module_register(void) {
   plugin_register_config("protocols", protocols_config, config_keys,
                          config_keys_num);
   plugin_register_read("protocols", protocols_read);
+  plugin_register_shutdown("protocols", protocols_shutdown);
 } /* void module_register */
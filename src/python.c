@@ -39,6 +39,9 @@ typedef struct cpy_callback_s {
   char *name;
   PyObject *callback;
   PyObject *data;
+  /* Selects the worker process running a read callback; negative if the
+   * callback was registered after the workers had been started. */
+  long worker;
   struct cpy_callback_s *next;
 } cpy_callback_t;
 
@@ -152,7 +155,7 @@ static char reg_read_doc[] =
     "data if it was supplied.";
 
 static char reg_write_doc[] =
-    "register_write(callback[, data][, name]) -> identifier\n"
+    "register_write(callback[, data][, name][, batch]) -> identifier\n"
     "\n"
     "Register a callback function to receive values dispatched by other "
     "plugins.\n"
@@ -167,8 +170,13 @@ static char reg_write_doc[] =
     "    to specify a name here.\n"
     "'identifier' is the full identifier assigned to this callback.\n"
     "\n"
+    "'batch' is an optional bool. If true, the callback receives a list of\n"
+    "    Values objects, collected by the write threads according to the\n"
+    "    WriteBatchSize and WriteBatchTimeout options.\n"
+    "\n"
     "The callback function will be called with one or two parameters:\n"
-    "values: A Values object which is a copy of the dispatched values.\n"
+    "values: A Values object which is a copy of the dispatched values, or a\n"
+    "    list of them if 'batch' is true.\n"
     "data: The optional data parameter passed to the register function.\n"
     "    If the parameter was omitted it will be omitted here, too.";
 
@@ -243,6 +251,10 @@ static pthread_t main_thread;
 static PyOS_sighandler_t python_sigint_handler;
 static bool do_interactive;
 
+static int cpy_workers_num;
+static bool cpy_workers_started;
+static long cpy_read_callbacks_num;
+
 /* This is our global thread state. Python saves some stuff in thread-local
  * storage. So if we allow the interpreter to run in the background
  * (the scriptwriters might have created some threads from python), we have
@@ -327,10 +339,10 @@ void cpy_log_exception(const char *context) {
     message = "N/A";
   Py_BEGIN_ALLOW_THREADS;
   if (collectd_error) {
-    WARNING("%s in %s: %s", typename, context, message);
+    cpy_log(LOG_WARNING, "%s in %s: %s", typename, context, message);
   } else {
-    ERROR("Unhandled python exception in %s: %s: %s", context, typename,
-          message);
+    cpy_log(LOG_ERR, "Unhandled python exception in %s: %s: %s", context,
+            typename, message);
   }
   Py_END_ALLOW_THREADS;
   Py_XDECREF(tn);
@@ -370,7 +382,7 @@ void cpy_log_exception(const char *context) {
       cpy[strlen(cpy) - 1] = '\0';
 
     Py_BEGIN_ALLOW_THREADS;
-    ERROR("%s", cpy);
+    cpy_log(LOG_ERR, "%s", cpy);
     Py_END_ALLOW_THREADS;
 
     free(cpy);
@@ -384,6 +396,12 @@ static int cpy_read_callback(user_data_t *data) {
   cpy_callback_t *c = data->data;
   PyObject *ret;
 
+  if (c->worker >= 0) {
+    int status = cpy_worker_read((size_t)c->worker, c);
+    if (status >= 0)
+      return status;
+  }
+
   CPY_LOCK_THREADS
   ret = PyObject_CallFunctionObjArgs(c->callback, c->data,
                                      (void *)0); /* New reference. */
@@ -398,18 +416,22 @@ static int cpy_read_callback(user_data_t *data) {
   return 0;
 }
 
-static int cpy_write_callback(const data_set_t *ds,
-                              const value_list_t *value_list,
-                              user_data_t *data) {
-  cpy_callback_t *c = data->data;
-  PyObject *ret, *list, *temp, *dict = NULL;
+/* Runs a read callback in a worker process. */
+static int cpy_worker_run(void *arg) {
+  return cpy_read_callback(&(user_data_t){.data = arg});
+}
+
+/* Builds a Values object from a value list. You must hold the GIL to call
+ * this function! Errors are logged and NULL is returned. */
+static Values *cpy_build_values(const data_set_t *ds,
+                                const value_list_t *value_list) {
+  PyObject *list, *temp, *dict = NULL;
   Values *v;
 
-  CPY_LOCK_THREADS
   list = PyList_New(value_list->values_len); /* New reference. */
   if (list == NULL) {
     cpy_log_exception("write callback");
-    CPY_RETURN_FROM_THREADS 0;
+    return NULL;
   }
   for (size_t i = 0; i < value_list->values_len; ++i) {
     if (ds->ds[i].type == DS_TYPE_COUNTER) {
@@ -425,15 +447,15 @@ static int cpy_write_callback(const data_set_t *ds,
           list, i, PyLong_FromUnsignedLongLong(value_list->values[i].absolute));
     } else {
       Py_BEGIN_ALLOW_THREADS;
-      ERROR("cpy_write_callback: Unknown value type %d.", ds->ds[i].type);
+      ERROR("cpy_build_values: Unknown value type %d.", ds->ds[i].type);
       Py_END_ALLOW_THREADS;
       Py_DECREF(list);
-      CPY_RETURN_FROM_THREADS 0;
+      return NULL;
     }
     if (PyErr_Occurred() != NULL) {
       cpy_log_exception("value building for write callback");
       Py_DECREF(list);
-      CPY_RETURN_FROM_THREADS 0;
+      return NULL;
     }
   }
   dict = PyDict_New(); /* New reference. */
@@ -494,7 +516,15 @@ static int cpy_write_callback(const data_set_t *ds,
     }
     free(table);
   }
-  v = (Values *)Values_New(); /* New reference. */
+  /* Calling the type's tp_new directly skips parsing the (empty) arguments
+   * in Values_init; all members are set below anyway. */
+  v = (Values *)ValuesType.tp_new(&ValuesType, NULL, NULL); /* New reference. */
+  if (v == NULL) {
+    cpy_log_exception("write callback");
+    Py_DECREF(list);
+    Py_XDECREF(dict);
+    return NULL;
+  }
   sstrncpy(v->data.host, value_list->host, sizeof(v->data.host));
   sstrncpy(v->data.type, value_list->type, sizeof(v->data.type));
   sstrncpy(v->data.type_instance, value_list->type_instance,
@@ -508,6 +538,21 @@ static int cpy_write_callback(const data_set_t *ds,
   v->values = list;
   Py_CLEAR(v->meta);
   v->meta = dict; /* Steals a reference. */
+  return v;
+}
+
+static int cpy_write_callback(const data_set_t *ds,
+                              const value_list_t *value_list,
+                              user_data_t *data) {
+  cpy_callback_t *c = data->data;
+  PyObject *ret;
+  Values *v;
+
+  CPY_LOCK_THREADS
+  v = cpy_build_values(ds, value_list); /* New reference. */
+  if (v == NULL) {
+    CPY_RETURN_FROM_THREADS 0;
+  }
   ret = PyObject_CallFunctionObjArgs(c->callback, v, c->data,
                                      (void *)0); /* New reference. */
   Py_XDECREF(v);
@@ -520,6 +565,41 @@ static int cpy_write_callback(const data_set_t *ds,
   return 0;
 }
 
+/* Like cpy_write_callback, but the callback receives a list of Values objects,
+ * so the GIL is taken once per batch instead of once per value list. */
+static int cpy_write_batch_callback(const data_set_t *const *ds,
+                                    const value_list_t *const *value_list,
+                                    size_t num, user_data_t *data) {
+  cpy_callback_t *c = data->data;
+  PyObject *ret, *list;
+
+  CPY_LOCK_THREADS
+  list = PyList_New(0); /* New reference. */
+  if (list == NULL) {
+    cpy_log_exception("write callback");
+    CPY_RETURN_FROM_THREADS 0;
+  }
+  for (size_t i = 0; i < num; ++i) {
+    /* Value lists which cannot be converted are logged and skipped. */
+    Values *v = cpy_build_values(ds[i], value_list[i]); /* New reference. */
+    if (v == NULL)
+      continue;
+    if (PyList_Append(list, (PyObject *)v) != 0)
+      cpy_log_exception("write callback");
+    Py_DECREF(v);
+  }
+  ret = PyObject_CallFunctionObjArgs(c->callback, list, c->data,
+                                     (void *)0); /* New reference. */
+  Py_DECREF(list);
+  if (ret == NULL) {
+    cpy_log_exception("write callback");
+  } else {
+    Py_DECREF(ret);
+  }
+  CPY_RELEASE_THREADS
+  return 0;
+}
+
 static int cpy_notification_callback(const notification_t *notification,
                                      user_data_t *data) {
   cpy_callback_t *c = data->data;
@@ -811,6 +891,7 @@ static PyObject *cpy_register_read(PyObject *self, PyObject *args,
   c->name = strdup(buf);
   c->callback = callback;
   c->data = data;
+  c->worker = cpy_workers_started ? -1 : cpy_read_callbacks_num++;
   c->next = NULL;
 
   plugin_register_complex_read(
@@ -831,8 +912,34 @@ static PyObject *cpy_register_log(PyObject *self, PyObject *args,
 
 static PyObject *cpy_register_write(PyObject *self, PyObject *args,
                                     PyObject *kwds) {
-  return cpy_register_generic_userdata((void *)plugin_register_write,
-                                       (void *)cpy_write_callback, args, kwds);
+  PyObject *batch = NULL, *ret;
+  int is_batch = 0;
+
+  /* "batch" is handled here, so that cpy_register_generic_userdata can parse
+   * the remaining arguments like for all other callbacks. */
+  if (kwds != NULL)
+    batch = PyDict_GetItemString(kwds, "batch"); /* Borrowed reference. */
+  if (batch != NULL) {
+    is_batch = PyObject_IsTrue(batch);
+    if (is_batch < 0)
+      return NULL;
+    kwds = PyDict_Copy(kwds); /* New reference. */
+    if (kwds == NULL)
+      return NULL;
+    PyDict_DelItemString(kwds, "batch");
+  } else {
+    Py_XINCREF(kwds);
+  }
+
+  if (is_batch)
+    ret = cpy_register_generic_userdata((void *)plugin_register_write_batch,
+                                        (void *)cpy_write_batch_callback, args,
+                                        kwds);
+  else
+    ret = cpy_register_generic_userdata((void *)plugin_register_write,
+                                        (void *)cpy_write_callback, args, kwds);
+  Py_XDECREF(kwds);
+  return ret;
 }
 
 static PyObject *cpy_register_notification(PyObject *self, PyObject *args,
@@ -858,7 +965,7 @@ static PyObject *cpy_error(PyObject *self, PyObject *args) {
   if (PyArg_ParseTuple(args, "et", NULL, &text) == 0)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
-  plugin_log(LOG_ERR, "%s", text);
+  cpy_log(LOG_ERR, "%s", text);
   Py_END_ALLOW_THREADS;
   PyMem_Free(text);
   Py_RETURN_NONE;
@@ -869,7 +976,7 @@ static PyObject *cpy_warning(PyObject *self, PyObject *args) {
   if (PyArg_ParseTuple(args, "et", NULL, &text) == 0)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
-  plugin_log(LOG_WARNING, "%s", text);
+  cpy_log(LOG_WARNING, "%s", text);
   Py_END_ALLOW_THREADS;
   PyMem_Free(text);
   Py_RETURN_NONE;
@@ -880,7 +987,7 @@ static PyObject *cpy_notice(PyObject *self, PyObject *args) {
   if (PyArg_ParseTuple(args, "et", NULL, &text) == 0)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
-  plugin_log(LOG_NOTICE, "%s", text);
+  cpy_log(LOG_NOTICE, "%s", text);
   Py_END_ALLOW_THREADS;
   PyMem_Free(text);
   Py_RETURN_NONE;
@@ -891,7 +998,7 @@ static PyObject *cpy_info(PyObject *self, PyObject *args) {
   if (PyArg_ParseTuple(args, "et", NULL, &text) == 0)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
-  plugin_log(LOG_INFO, "%s", text);
+  cpy_log(LOG_INFO, "%s", text);
   Py_END_ALLOW_THREADS;
   PyMem_Free(text);
   Py_RETURN_NONE;
@@ -903,7 +1010,7 @@ static PyObject *cpy_debug(PyObject *self, PyObject *args) {
   if (PyArg_ParseTuple(args, "et", NULL, &text) == 0)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
-  plugin_log(LOG_DEBUG, "%s", text);
+  cpy_log(LOG_DEBUG, "%s", text);
   Py_END_ALLOW_THREADS;
   PyMem_Free(text);
 #endif
@@ -1075,6 +1182,10 @@ static int cpy_shutdown(void) {
         "================================================================\n");
   }
 
+  /* The read threads have been stopped, so no callback is running in the
+   * workers anymore. */
+  cpy_workers_stop();
+
   CPY_LOCK_THREADS
 
   for (cpy_callback_t *c = cpy_shutdown_callbacks; c; c = c->next) {
@@ -1187,6 +1298,15 @@ static int cpy_init(void) {
     else
       Py_DECREF(ret);
   }
+  /* The workers are forked after the init callbacks, so that they start with
+   * the state the modules have set up. */
+  if (cpy_workers_num > 0) {
+    if (do_interactive)
+      WARNING("python plugin: \"Workers\" is ignored in interactive mode.");
+    else if (cpy_workers_start((size_t)cpy_workers_num, cpy_worker_run) != 0)
+      WARNING("python plugin: Not all worker processes could be started.");
+    cpy_workers_started = true;
+  }
   CPY_RELEASE_THREADS
 
   return 0;
@@ -1340,7 +1460,15 @@ static int cpy_config(oconfig_item_t *ci) {
   for (int i = 0; i < ci->children_num; ++i) {
     oconfig_item_t *item = ci->children + i;
 
-    if (strcasecmp(item->key, "Interactive") == 0) {
+    if (strcasecmp(item->key, "Workers") == 0) {
+      if ((cf_util_get_int(item, &cpy_workers_num) != 0) ||
+          (cpy_workers_num < 0)) {
+        ERROR("python plugin: \"Workers\" must be a non-negative number.");
+        cpy_workers_num = 0;
+        status = 1;
+        continue;
+      }
+    } else if (strcasecmp(item->key, "Interactive") == 0) {
       if (cf_util_get_boolean(item, &do_interactive) != 0) {
         status = 1;
         continue;
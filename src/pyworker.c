@@ -0,0 +1,702 @@
+/**
+ * collectd - src/pyworker.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Worker processes for python read callbacks. The workers are forked from
+ * the collectd process after the init callbacks have run, so they share the
+ * interpreter state as it was at that point, but each has its own GIL. The
+ * collectd process sends the address of a callback, which is valid in the
+ * worker because it is a copy of the same address space, and receives the
+ * values, notifications and log messages the callback produced, followed by
+ * its status. */
+
+#include <Python.h>
+#include <structmember.h>
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+
+#include "cpython.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define CPY_FRAME_VALUES 1
+#define CPY_FRAME_NOTIFICATION 2
+#define CPY_FRAME_LOG 3
+#define CPY_FRAME_DONE 4
+
+typedef struct {
+  uint32_t type;
+  uint32_t len;
+} cpy_frame_t;
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t size;
+  size_t pos;
+  bool failed;
+} cpy_buffer_t;
+
+typedef struct {
+  pid_t pid;
+  int fd;
+  pthread_mutex_t lock;
+  /* Receives the frames of a response. */
+  cpy_buffer_t buffer;
+} cpy_worker_t;
+
+static cpy_worker_t *cpy_workers;
+static size_t cpy_workers_num;
+
+/* Only set in worker processes: the socket to the collectd process and the
+ * response which is sent when the current callback has returned. */
+static int cpy_worker_fd = -1;
+static cpy_buffer_t cpy_worker_response;
+
+static int cpy_read_full(int fd, void *buf, size_t len) { /* {{{ */
+  char *ptr = buf;
+
+  while (len > 0) {
+    ssize_t status = read(fd, ptr, len);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    if (status == 0)
+      return EPIPE;
+    ptr += status;
+    len -= (size_t)status;
+  }
+  return 0;
+} /* }}} int cpy_read_full */
+
+static int cpy_write_full(int fd, void const *buf, size_t len) { /* {{{ */
+  char const *ptr = buf;
+
+  while (len > 0) {
+    ssize_t status = send(fd, ptr, len, MSG_NOSIGNAL);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    ptr += status;
+    len -= (size_t)status;
+  }
+  return 0;
+} /* }}} int cpy_write_full */
+
+static int cpy_buffer_reserve(cpy_buffer_t *b, size_t len) { /* {{{ */
+  if (b->failed)
+    return ENOMEM;
+  if (b->size - b->len >= len)
+    return 0;
+
+  size_t size = (b->size > 0) ? b->size : 4096;
+  while (size - b->len < len)
+    size *= 2;
+  char *tmp = realloc(b->data, size);
+  if (tmp == NULL) {
+    b->failed = true;
+    return ENOMEM;
+  }
+  b->data = tmp;
+  b->size = size;
+  return 0;
+} /* }}} int cpy_buffer_reserve */
+
+static void cpy_put(cpy_buffer_t *b, void const *data, size_t len) {
+  if (cpy_buffer_reserve(b, len) != 0)
+    return;
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+}
+
+/* Strings are sent with their terminating null byte. */
+static void cpy_put_string(cpy_buffer_t *b, char const *str) {
+  uint32_t len = (uint32_t)strlen(str) + 1;
+  cpy_put(b, &len, sizeof(len));
+  cpy_put(b, str, len);
+}
+
+static int cpy_get(cpy_buffer_t *b, void *data, size_t len) {
+  if (b->len - b->pos < len)
+    return EPROTO;
+  memcpy(data, b->data + b->pos, len);
+  b->pos += len;
+  return 0;
+}
+
+static char const *cpy_get_string(cpy_buffer_t *b) {
+  uint32_t len;
+  if ((cpy_get(b, &len, sizeof(len)) != 0) || (len == 0) ||
+      (b->len - b->pos < len) || (b->data[b->pos + len - 1] != 0))
+    return NULL;
+  char const *str = b->data + b->pos;
+  b->pos += len;
+  return str;
+}
+
+static size_t cpy_frame_begin(cpy_buffer_t *b, uint32_t type) {
+  size_t offset = b->len;
+  cpy_put(b, &(cpy_frame_t){.type = type}, sizeof(cpy_frame_t));
+  return offset;
+}
+
+static void cpy_frame_end(cpy_buffer_t *b, size_t offset) {
+  if (b->failed)
+    return;
+  uint32_t len = (uint32_t)(b->len - offset - sizeof(cpy_frame_t));
+  memcpy(b->data + offset + offsetof(cpy_frame_t, len), &len, sizeof(len));
+}
+
+/*
+ * Serialization, used in the workers.
+ */
+typedef struct {
+  cpy_buffer_t *b;
+  uint32_t num;
+} cpy_meta_writer_t;
+
+static void cpy_put_typed(cpy_buffer_t *b, uint8_t type, /* {{{ */
+                          void const *value) {
+  cpy_put(b, &type, sizeof(type));
+  switch (type) {
+  case MD_TYPE_STRING:
+    cpy_put_string(b, *(char *const *)value);
+    break;
+  case MD_TYPE_SIGNED_INT:
+    cpy_put(b, value, sizeof(int64_t));
+    break;
+  case MD_TYPE_UNSIGNED_INT:
+    cpy_put(b, value, sizeof(uint64_t));
+    break;
+  case MD_TYPE_DOUBLE:
+    cpy_put(b, value, sizeof(double));
+    break;
+  case MD_TYPE_BOOLEAN:
+    cpy_put(b, &(uint8_t){*(bool const *)value}, sizeof(uint8_t));
+    break;
+  }
+} /* }}} void cpy_put_typed */
+
+static int cpy_put_meta(char const *key, int type, void const *value,
+                        void *user_data) {
+  cpy_meta_writer_t *w = user_data;
+
+  cpy_put_string(w->b, key);
+  cpy_put_typed(w->b, (uint8_t)type, value);
+  w->num++;
+  return 0;
+}
+
+static void cpy_put_value_list(cpy_buffer_t *b, /* {{{ */
+                               value_list_t const *vl) {
+  size_t offset = cpy_frame_begin(b, CPY_FRAME_VALUES);
+  uint32_t values_len = (uint32_t)vl->values_len;
+
+  cpy_put_string(b, vl->host);
+  cpy_put_string(b, vl->plugin);
+  cpy_put_string(b, vl->plugin_instance);
+  cpy_put_string(b, vl->type);
+  cpy_put_string(b, vl->type_instance);
+  cpy_put(b, &vl->time, sizeof(vl->time));
+  cpy_put(b, &vl->interval, sizeof(vl->interval));
+  cpy_put(b, &values_len, sizeof(values_len));
+  cpy_put(b, vl->values, vl->values_len * sizeof(*vl->values));
+
+  /* The number of entries is patched in after iterating. */
+  size_t num_offset = b->len;
+  cpy_meta_writer_t w = {.b = b};
+  cpy_put(b, &w.num, sizeof(w.num));
+  if (vl->meta != NULL)
+    meta_data_foreach(vl->meta, cpy_put_meta, &w);
+  if (!b->failed)
+    memcpy(b->data + num_offset, &w.num, sizeof(w.num));
+
+  cpy_frame_end(b, offset);
+} /* }}} void cpy_put_value_list */
+
+static void cpy_put_notification(cpy_buffer_t *b, /* {{{ */
+                                 notification_t const *n) {
+  size_t offset = cpy_frame_begin(b, CPY_FRAME_NOTIFICATION);
+  int32_t severity = n->severity;
+  uint32_t num = 0;
+
+  cpy_put(b, &severity, sizeof(severity));
+  cpy_put(b, &n->time, sizeof(n->time));
+  cpy_put_string(b, n->message);
+  cpy_put_string(b, n->host);
+  cpy_put_string(b, n->plugin);
+  cpy_put_string(b, n->plugin_instance);
+  cpy_put_string(b, n->type);
+  cpy_put_string(b, n->type_instance);
+
+  for (notification_meta_t *m = n->meta; m != NULL; m = m->next)
+    num++;
+  cpy_put(b, &num, sizeof(num));
+  for (notification_meta_t *m = n->meta; m != NULL; m = m->next) {
+    cpy_put_string(b, m->name);
+    switch (m->type) {
+    case NM_TYPE_STRING:
+      cpy_put_typed(b, MD_TYPE_STRING, &m->nm_value.nm_string);
+      break;
+    case NM_TYPE_SIGNED_INT:
+      cpy_put_typed(b, MD_TYPE_SIGNED_INT, &m->nm_value.nm_signed_int);
+      break;
+    case NM_TYPE_UNSIGNED_INT:
+      cpy_put_typed(b, MD_TYPE_UNSIGNED_INT, &m->nm_value.nm_unsigned_int);
+      break;
+    case NM_TYPE_DOUBLE:
+      cpy_put_typed(b, MD_TYPE_DOUBLE, &m->nm_value.nm_double);
+      break;
+    case NM_TYPE_BOOLEAN:
+      cpy_put_typed(b, MD_TYPE_BOOLEAN, &m->nm_value.nm_boolean);
+      break;
+    }
+  }
+
+  cpy_frame_end(b, offset);
+} /* }}} void cpy_put_notification */
+
+/*
+ * Deserialization, used in the collectd process.
+ */
+typedef struct {
+  uint8_t type;
+  char const *string;
+  int64_t signed_int;
+  uint64_t unsigned_int;
+  double dbl;
+  bool boolean;
+} cpy_typed_t;
+
+static int cpy_get_typed(cpy_buffer_t *b, cpy_typed_t *v) { /* {{{ */
+  uint8_t boolean;
+
+  if (cpy_get(b, &v->type, sizeof(v->type)) != 0)
+    return EPROTO;
+  switch (v->type) {
+  case MD_TYPE_STRING:
+    v->string = cpy_get_string(b);
+    return (v->string != NULL) ? 0 : EPROTO;
+  case MD_TYPE_SIGNED_INT:
+    return cpy_get(b, &v->signed_int, sizeof(v->signed_int));
+  case MD_TYPE_UNSIGNED_INT:
+    return cpy_get(b, &v->unsigned_int, sizeof(v->unsigned_int));
+  case MD_TYPE_DOUBLE:
+    return cpy_get(b, &v->dbl, sizeof(v->dbl));
+  case MD_TYPE_BOOLEAN:
+    if (cpy_get(b, &boolean, sizeof(boolean)) != 0)
+      return EPROTO;
+    v->boolean = (boolean != 0);
+    return 0;
+  }
+  return EPROTO;
+} /* }}} int cpy_get_typed */
+
+#define CPY_GET_NAME(b, field)                                                 \
+  do {                                                                         \
+    char const *str = cpy_get_string(b);                                       \
+    if (str == NULL)                                                           \
+      return EPROTO;                                                           \
+    sstrncpy((field), str, sizeof(field));                                     \
+  } while (0)
+
+/* On success, the caller has to free vl->values and vl->meta. */
+static int cpy_get_value_list(cpy_buffer_t *b, value_list_t *vl) { /* {{{ */
+  uint32_t values_len, num;
+
+  *vl = (value_list_t)VALUE_LIST_INIT;
+  CPY_GET_NAME(b, vl->host);
+  CPY_GET_NAME(b, vl->plugin);
+  CPY_GET_NAME(b, vl->plugin_instance);
+  CPY_GET_NAME(b, vl->type);
+  CPY_GET_NAME(b, vl->type_instance);
+  if ((cpy_get(b, &vl->time, sizeof(vl->time)) != 0) ||
+      (cpy_get(b, &vl->interval, sizeof(vl->interval)) != 0) ||
+      (cpy_get(b, &values_len, sizeof(values_len)) != 0) || (values_len == 0) ||
+      ((b->len - b->pos) / sizeof(*vl->values) < values_len))
+    return EPROTO;
+
+  vl->values = calloc(values_len, sizeof(*vl->values));
+  if (vl->values == NULL)
+    return ENOMEM;
+  vl->values_len = values_len;
+  cpy_get(b, vl->values, values_len * sizeof(*vl->values));
+
+  if (cpy_get(b, &num, sizeof(num)) != 0)
+    goto error;
+  if (num > 0) {
+    vl->meta = meta_data_create();
+    if (vl->meta == NULL)
+      goto error;
+  }
+  for (uint32_t i = 0; i < num; i++) {
+    char const *key = cpy_get_string(b);
+    cpy_typed_t v;
+    if ((key == NULL) || (cpy_get_typed(b, &v) != 0))
+      goto error;
+    switch (v.type) {
+    case MD_TYPE_STRING:
+      meta_data_add_string(vl->meta, key, v.string);
+      break;
+    case MD_TYPE_SIGNED_INT:
+      meta_data_add_signed_int(vl->meta, key, v.signed_int);
+      break;
+    case MD_TYPE_UNSIGNED_INT:
+      meta_data_add_unsigned_int(vl->meta, key, v.unsigned_int);
+      break;
+    case MD_TYPE_DOUBLE:
+      meta_data_add_double(vl->meta, key, v.dbl);
+      break;
+    case MD_TYPE_BOOLEAN:
+      meta_data_add_boolean(vl->meta, key, v.boolean);
+      break;
+    }
+  }
+  return 0;
+
+error:
+  sfree(vl->values);
+  meta_data_destroy(vl->meta);
+  vl->meta = NULL;
+  return EPROTO;
+} /* }}} int cpy_get_value_list */
+
+static int cpy_get_notification(cpy_buffer_t *b, /* {{{ */
+                                notification_t *n) {
+  int32_t severity;
+  uint32_t num;
+
+  *n = (notification_t){0};
+  if ((cpy_get(b, &severity, sizeof(severity)) != 0) ||
+      (cpy_get(b, &n->time, sizeof(n->time)) != 0))
+    return EPROTO;
+  n->severity = severity;
+  CPY_GET_NAME(b, n->message);
+  CPY_GET_NAME(b, n->host);
+  CPY_GET_NAME(b, n->plugin);
+  CPY_GET_NAME(b, n->plugin_instance);
+  CPY_GET_NAME(b, n->type);
+  CPY_GET_NAME(b, n->type_instance);
+
+  if (cpy_get(b, &num, sizeof(num)) != 0)
+    return EPROTO;
+  for (uint32_t i = 0; i < num; i++) {
+    char const *name = cpy_get_string(b);
+    cpy_typed_t v;
+    if ((name == NULL) || (cpy_get_typed(b, &v) != 0)) {
+      if (n->meta != NULL)
+        plugin_notification_meta_free(n->meta);
+      n->meta = NULL;
+      return EPROTO;
+    }
+    switch (v.type) {
+    case MD_TYPE_STRING:
+      plugin_notification_meta_add_string(n, name, v.string);
+      break;
+    case MD_TYPE_SIGNED_INT:
+      plugin_notification_meta_add_signed_int(n, name, v.signed_int);
+      break;
+    case MD_TYPE_UNSIGNED_INT:
+      plugin_notification_meta_add_unsigned_int(n, name, v.unsigned_int);
+      break;
+    case MD_TYPE_DOUBLE:
+      plugin_notification_meta_add_double(n, name, v.dbl);
+      break;
+    case MD_TYPE_BOOLEAN:
+      plugin_notification_meta_add_boolean(n, name, v.boolean);
+      break;
+    }
+  }
+  return 0;
+} /* }}} int cpy_get_notification */
+
+/*
+ * Worker side.
+ */
+bool cpy_in_worker(void) { return cpy_worker_fd >= 0; }
+
+int cpy_dispatch_values(value_list_t const *vls, size_t num) { /* {{{ */
+  if (cpy_worker_fd < 0)
+    return (num == 1) ? plugin_dispatch_values(vls)
+                      : plugin_dispatch_values_batch(vls, num);
+
+  for (size_t i = 0; i < num; i++)
+    cpy_put_value_list(&cpy_worker_response, vls + i);
+  return cpy_worker_response.failed ? ENOMEM : 0;
+} /* }}} int cpy_dispatch_values */
+
+int cpy_dispatch_notification(notification_t const *n) { /* {{{ */
+  if (cpy_worker_fd < 0)
+    return plugin_dispatch_notification(n);
+
+  cpy_put_notification(&cpy_worker_response, n);
+  return cpy_worker_response.failed ? ENOMEM : 0;
+} /* }}} int cpy_dispatch_notification */
+
+void cpy_log(int level, char const *format, ...) { /* {{{ */
+  char msg[1024];
+  va_list ap;
+
+  va_start(ap, format);
+  vsnprintf(msg, sizeof(msg), format, ap);
+  va_end(ap);
+
+  if (cpy_worker_fd < 0) {
+    plugin_log(level, "%s", msg);
+    return;
+  }
+
+  int32_t l = level;
+  size_t offset = cpy_frame_begin(&cpy_worker_response, CPY_FRAME_LOG);
+  cpy_put(&cpy_worker_response, &l, sizeof(l));
+  cpy_put_string(&cpy_worker_response, msg);
+  cpy_frame_end(&cpy_worker_response, offset);
+} /* }}} void cpy_log */
+
+/* Runs the requested callbacks until the collectd process closes the socket.
+ * Must hold the GIL when calling; it is released while waiting. */
+static void cpy_worker_loop(int (*run)(void *)) /* {{{ */
+{
+  while (42) {
+    uintptr_t arg;
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS;
+    status = cpy_read_full(cpy_worker_fd, &arg, sizeof(arg));
+    Py_END_ALLOW_THREADS;
+    if (status != 0)
+      _exit(0);
+
+    cpy_worker_response.len = 0;
+    cpy_worker_response.failed = false;
+    int32_t ret = run((void *)arg);
+
+    size_t offset = cpy_frame_begin(&cpy_worker_response, CPY_FRAME_DONE);
+    cpy_put(&cpy_worker_response, &ret, sizeof(ret));
+    cpy_frame_end(&cpy_worker_response, offset);
+
+    if (cpy_worker_response.failed)
+      _exit(1);
+    if (cpy_write_full(cpy_worker_fd, cpy_worker_response.data,
+                       cpy_worker_response.len) != 0)
+      _exit(1);
+  }
+} /* }}} void cpy_worker_loop */
+
+/*
+ * collectd process side.
+ */
+static void cpy_worker_stop(cpy_worker_t *w) /* {{{ */
+{
+  if (w->fd < 0)
+    return;
+
+  close(w->fd);
+  w->fd = -1;
+  /* The worker exits when it notices the closed socket, but it may be stuck
+   * in a callback. */
+  kill(w->pid, SIGKILL);
+  waitpid(w->pid, NULL, 0);
+  sfree(w->buffer.data);
+  w->buffer = (cpy_buffer_t){0};
+} /* }}} void cpy_worker_stop */
+
+int cpy_workers_start(size_t num, int (*run)(void *)) /* {{{ */
+{
+  cpy_workers = calloc(num, sizeof(*cpy_workers));
+  if (cpy_workers == NULL) {
+    ERROR("python plugin: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+      ERROR("python plugin: socketpair failed: %s", STRERRNO);
+      break;
+    }
+
+#if PY_VERSION_HEX >= 0x03070000
+    PyOS_BeforeFork();
+#endif
+    pid_t pid = fork();
+    if (pid == 0) {
+#if PY_VERSION_HEX < 0x03070000
+      PyOS_AfterFork();
+#else
+      PyOS_AfterFork_Child();
+#endif
+      /* collectd's handlers would only set a flag nobody checks here. The
+       * signals are ignored rather than fatal, so that a signal sent to the
+       * whole process group does not kill the workers before collectd has
+       * stopped its read threads; cpy_workers_stop ends the workers. */
+      signal(SIGINT, SIG_IGN);
+      signal(SIGTERM, SIG_IGN);
+      /* Otherwise earlier workers would not notice when collectd closes their
+       * sockets. */
+      for (size_t j = 0; j < i; j++)
+        close(cpy_workers[j].fd);
+      close(sv[0]);
+
+      cpy_worker_fd = sv[1];
+      cpy_worker_loop(run);
+      _exit(0);
+    }
+#if PY_VERSION_HEX >= 0x03070000
+    PyOS_AfterFork_Parent();
+#endif
+    close(sv[1]);
+    if (pid < 0) {
+      ERROR("python plugin: fork failed: %s", STRERRNO);
+      close(sv[0]);
+      break;
+    }
+
+    cpy_workers[i] = (cpy_worker_t){.pid = pid, .fd = sv[0]};
+    pthread_mutex_init(&cpy_workers[i].lock, NULL);
+    cpy_workers_num = i + 1;
+  }
+
+  INFO("python plugin: Started %" PRIsz " worker processes.", cpy_workers_num);
+  return (cpy_workers_num == num) ? 0 : -1;
+} /* }}} int cpy_workers_start */
+
+void cpy_workers_stop(void) /* {{{ */
+{
+  for (size_t i = 0; i < cpy_workers_num; i++) {
+    pthread_mutex_lock(&cpy_workers[i].lock);
+    cpy_worker_stop(cpy_workers + i);
+    pthread_mutex_unlock(&cpy_workers[i].lock);
+    pthread_mutex_destroy(&cpy_workers[i].lock);
+  }
+  sfree(cpy_workers);
+  cpy_workers_num = 0;
+} /* }}} void cpy_workers_stop */
+
+/* Reads the frames of one response and dispatches them. Must hold w->lock. */
+static int cpy_worker_receive(cpy_worker_t *w, int32_t *ret) /* {{{ */
+{
+  cpy_buffer_t *b = &w->buffer;
+  value_list_t *vls = NULL;
+  size_t vls_num = 0, vls_size = 0;
+  int status = 0;
+
+  while (status == 0) {
+    cpy_frame_t frame;
+
+    status = cpy_read_full(w->fd, &frame, sizeof(frame));
+    if (status != 0)
+      break;
+    b->len = b->pos = 0;
+    b->failed = false;
+    if ((status = cpy_buffer_reserve(b, frame.len)) != 0)
+      break;
+    if ((status = cpy_read_full(w->fd, b->data, frame.len)) != 0)
+      break;
+    b->len = frame.len;
+
+    if (frame.type == CPY_FRAME_DONE) {
+      status = cpy_get(b, ret, sizeof(*ret));
+      break;
+    } else if (frame.type == CPY_FRAME_VALUES) {
+      if (vls_num == vls_size) {
+        size_t size = (vls_size > 0) ? 2 * vls_size : 64;
+        value_list_t *tmp = realloc(vls, size * sizeof(*vls));
+        if (tmp == NULL) {
+          status = ENOMEM;
+          break;
+        }
+        vls = tmp;
+        vls_size = size;
+      }
+      status = cpy_get_value_list(b, vls + vls_num);
+      if (status == 0)
+        vls_num++;
+    } else if (frame.type == CPY_FRAME_NOTIFICATION) {
+      notification_t n;
+      status = cpy_get_notification(b, &n);
+      if (status == 0) {
+        plugin_dispatch_notification(&n);
+        if (n.meta != NULL)
+          plugin_notification_meta_free(n.meta);
+      }
+    } else if (frame.type == CPY_FRAME_LOG) {
+      int32_t level;
+      char const *msg;
+      if ((cpy_get(b, &level, sizeof(level)) != 0) ||
+          ((msg = cpy_get_string(b)) == NULL))
+        status = EPROTO;
+      else
+        plugin_log(level, "%s", msg);
+    } else {
+      status = EPROTO;
+    }
+  }
+
+  /* Values of a response that was cut short are dropped. */
+  if ((status == 0) && (vls_num > 0))
+    plugin_dispatch_values_batch(vls, vls_num);
+  for (size_t i = 0; i < vls_num; i++) {
+    sfree(vls[i].values);
+    meta_data_destroy(vls[i].meta);
+  }
+  sfree(vls);
+  return status;
+} /* }}} int cpy_worker_receive */
+
+int cpy_worker_read(size_t index, void *arg) /* {{{ */
+{
+  if ((cpy_worker_fd >= 0) || (cpy_workers_num == 0))
+    return -1;
+
+  cpy_worker_t *w = cpy_workers + (index % cpy_workers_num);
+  int32_t ret = 0;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->fd < 0) {
+    pthread_mutex_unlock(&w->lock);
+    return -1;
+  }
+
+  uintptr_t request = (uintptr_t)arg;
+  int status = cpy_write_full(w->fd, &request, sizeof(request));
+  if (status == 0)
+    status = cpy_worker_receive(w, &ret);
+  if (status != 0) {
+    ERROR("python plugin: Worker process %d failed: %s. Its callbacks are run "
+          "in the collectd process from now on.",
+          (int)w->pid, STRERROR(status));
+    cpy_worker_stop(w);
+    pthread_mutex_unlock(&w->lock);
+    return -1;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return (ret != 0) ? 1 : 0;
+} /* }}} int cpy_worker_read */
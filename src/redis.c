@@ -26,15 +26,15 @@
 #include "utils/common/common.h"
 
 #include <hiredis/hiredis.h>
+#include <poll.h>
 #include <sys/time.h>
 
 #define REDIS_DEF_HOST "localhost"
 #define REDIS_DEF_PASSWD ""
 #define REDIS_DEF_PORT 6379
 #define REDIS_DEF_TIMEOUT_SEC 2
-#define REDIS_DEF_DB_COUNT 256
-#define MAX_REDIS_VAL_SIZE 256
 #define MAX_REDIS_QUERY 2048
+#define REDIS_INFO_HASH_SIZE 64
 
 /* Redis plugin configuration example:
  *
@@ -55,6 +55,8 @@ struct redis_query_s {
   char type[DATA_MAX_NAME_LEN];
   char instance[DATA_MAX_NAME_LEN];
   int database;
+  /* Whether a SELECT has been sent before this query in the current read. */
+  bool select;
 
   redis_query_t *next;
 };
@@ -77,13 +79,85 @@ struct redis_node_s {
   bool report_command_stats;
   bool report_cpu_usage;
   redisContext *redisContext;
+  /* Logical database currently selected on the connection. */
+  int database;
+  /* Set when connecting, cleared once the AUTH command has succeeded. */
+  bool auth_pending;
   redis_query_t *queries;
+  size_t queries_num;
   prev_t prev;
 
+  /* State of the current read: all commands are sent in one pipeline and
+   * the replies are collected in order until all of them have been received
+   * or "deadline" has passed. */
+  redisReply **replies;
+  size_t replies_num;
+  size_t replies_expected;
+  bool write_done;
+  cdtime_t deadline;
+
   redis_node_t *next;
 };
 
-static bool redis_have_instances;
+/* Fields of the INFO reply which are dispatched or used to compute other
+ * metrics. Fields before REDIS_INFO_SIMPLE are not dispatched as they are. */
+typedef struct {
+  char const *name;
+  char const *type;
+  char const *type_instance;
+  int ds_type;
+} redis_info_field_t;
+
+enum {
+  REDIS_INFO_KEYSPACE_HITS,
+  REDIS_INFO_KEYSPACE_MISSES,
+  REDIS_INFO_CPU_USER,
+  REDIS_INFO_CPU_SYS,
+  REDIS_INFO_CPU_USER_CHILDREN,
+  REDIS_INFO_CPU_SYS_CHILDREN,
+  REDIS_INFO_SIMPLE,
+};
+
+static redis_info_field_t const redis_info_fields[] = {
+    [REDIS_INFO_KEYSPACE_HITS] = {"keyspace_hits", NULL, NULL, DS_TYPE_DERIVE},
+    [REDIS_INFO_KEYSPACE_MISSES] = {"keyspace_misses", NULL, NULL,
+                                    DS_TYPE_DERIVE},
+    [REDIS_INFO_CPU_USER] = {"used_cpu_user", NULL, NULL, DS_TYPE_GAUGE},
+    [REDIS_INFO_CPU_SYS] = {"used_cpu_sys", NULL, NULL, DS_TYPE_GAUGE},
+    [REDIS_INFO_CPU_USER_CHILDREN] = {"used_cpu_user_children", NULL, NULL,
+                                      DS_TYPE_GAUGE},
+    [REDIS_INFO_CPU_SYS_CHILDREN] = {"used_cpu_sys_children", NULL, NULL,
+                                     DS_TYPE_GAUGE},
+    {"uptime_in_seconds", "uptime", NULL, DS_TYPE_GAUGE},
+    {"connected_clients", "current_connections", "clients", DS_TYPE_GAUGE},
+    {"blocked_clients", "blocked_clients", NULL, DS_TYPE_GAUGE},
+    {"used_memory", "memory", NULL, DS_TYPE_GAUGE},
+    {"used_memory_lua", "memory_lua", NULL, DS_TYPE_GAUGE},
+    /* changes_since_last_save: Deprecated in redis version 2.6 and above */
+    {"changes_since_last_save", "volatile_changes", NULL, DS_TYPE_GAUGE},
+    {"total_connections_received", "total_connections", NULL, DS_TYPE_DERIVE},
+    {"total_commands_processed", "total_operations", NULL, DS_TYPE_DERIVE},
+    {"expired_keys", "expired_keys", NULL, DS_TYPE_DERIVE},
+    {"evicted_keys", "evicted_keys", NULL, DS_TYPE_DERIVE},
+    {"pubsub_channels", "pubsub", "channels", DS_TYPE_GAUGE},
+    {"pubsub_patterns", "pubsub", "patterns", DS_TYPE_GAUGE},
+    {"connected_slaves", "current_connections", "slaves", DS_TYPE_GAUGE},
+    {"total_net_input_bytes", "total_bytes", "input", DS_TYPE_DERIVE},
+    {"total_net_output_bytes", "total_bytes", "output", DS_TYPE_DERIVE},
+};
+#define REDIS_INFO_FIELDS_NUM STATIC_ARRAY_SIZE(redis_info_fields)
+
+/* Open addressing hash table of the field names. Holds the index into
+ * redis_info_fields plus one, or zero for empty slots. */
+static size_t redis_info_hash[REDIS_INFO_HASH_SIZE];
+
+/* All nodes are handled by one read callback, which talks to them
+ * concurrently. */
+static redis_node_t *redis_nodes;
+static size_t redis_nodes_num;
+static struct pollfd *redis_pollfds;
+static redis_node_t **redis_pollnodes;
+
 static int redis_read(user_data_t *user_data);
 
 static void redis_node_free(void *arg) {
@@ -100,6 +174,7 @@ static void redis_node_free(void *arg) {
 
   if (rn->redisContext)
     redisFree(rn->redisContext);
+  sfree(rn->replies);
   sfree(rn->name);
   sfree(rn->host);
   sfree(rn->socket);
@@ -111,20 +186,21 @@ static int redis_node_add(redis_node_t *rn) /* {{{ */
 {
   DEBUG("redis plugin: Adding node \"%s\".", rn->name);
 
-  /* Disable automatic generation of default instance in the init callback. */
-  redis_have_instances = true;
+  /* AUTH, INFO, INFO commandstats and a SELECT for every query. */
+  rn->replies = calloc(3 + 2 * rn->queries_num, sizeof(*rn->replies));
+  if (rn->replies == NULL) {
+    ERROR("redis plugin: calloc failed adding node.");
+    redis_node_free(rn);
+    return ENOMEM;
+  }
 
-  char cb_name[sizeof("redis/") + DATA_MAX_NAME_LEN];
-  snprintf(cb_name, sizeof(cb_name), "redis/%s", rn->name);
+  redis_node_t **ptr = &redis_nodes;
+  while (*ptr != NULL)
+    ptr = &(*ptr)->next;
+  *ptr = rn;
+  redis_nodes_num++;
 
-  return plugin_register_complex_read(
-      /* group = */ "redis",
-      /* name      = */ cb_name,
-      /* callback  = */ redis_read,
-      /* interval  = */ 0,
-      &(user_data_t){
-          .data = rn, .free_func = redis_node_free,
-      });
+  return 0;
 } /* }}} */
 
 static redis_query_t *redis_config_query(oconfig_item_t *ci) /* {{{ */
@@ -224,6 +300,7 @@ static int redis_config_node(oconfig_item_t *ci) /* {{{ */
       } else {
         rq->next = rn->queries;
         rn->queries = rq;
+        rn->queries_num++;
       }
     } else if (strcasecmp("Timeout", option->key) == 0) {
       int timeout;
@@ -313,89 +390,120 @@ redis_submit2(const char *plugin_instance, const char *type,
   plugin_dispatch_values(&vl);
 } /* }}} */
 
+static size_t redis_info_hash_name(char const *name) /* {{{ */
+{
+  size_t hash = 5381;
+  for (; *name != 0; name++)
+    hash = 33 * hash + (unsigned char)*name;
+  return hash % REDIS_INFO_HASH_SIZE;
+} /* }}} size_t redis_info_hash_name */
+
+static int redis_info_lookup(char const *name) /* {{{ */
+{
+  for (size_t h = redis_info_hash_name(name); redis_info_hash[h] != 0;
+       h = (h + 1) % REDIS_INFO_HASH_SIZE) {
+    size_t idx = redis_info_hash[h] - 1;
+    if (strcmp(redis_info_fields[idx].name, name) == 0)
+      return (int)idx;
+  }
+  return -1;
+} /* }}} int redis_info_lookup */
+
 static int redis_init(void) /* {{{ */
 {
-  if (redis_have_instances)
-    return 0;
+  for (size_t i = 0; i < REDIS_INFO_FIELDS_NUM; i++) {
+    size_t h = redis_info_hash_name(redis_info_fields[i].name);
+    while (redis_info_hash[h] != 0)
+      h = (h + 1) % REDIS_INFO_HASH_SIZE;
+    redis_info_hash[h] = i + 1;
+  }
 
-  redis_node_t *rn = calloc(1, sizeof(*rn));
-  if (rn == NULL)
-    return ENOMEM;
+  /* Generate the default instance if no node has been configured. */
+  if (redis_nodes == NULL) {
+    redis_node_t *rn = calloc(1, sizeof(*rn));
+    if (rn == NULL)
+      return ENOMEM;
 
-  rn->port = REDIS_DEF_PORT;
-  rn->timeout.tv_sec = REDIS_DEF_TIMEOUT_SEC;
+    rn->port = REDIS_DEF_PORT;
+    rn->timeout.tv_sec = REDIS_DEF_TIMEOUT_SEC;
 
-  rn->name = strdup("default");
-  rn->host = strdup(REDIS_DEF_HOST);
+    rn->name = strdup("default");
+    rn->host = strdup(REDIS_DEF_HOST);
 
-  if (rn->name == NULL || rn->host == NULL) {
-    sfree(rn->name);
-    sfree(rn->host);
-    sfree(rn);
+    if (rn->name == NULL || rn->host == NULL) {
+      sfree(rn->name);
+      sfree(rn->host);
+      sfree(rn);
+      return ENOMEM;
+    }
+
+    int status = redis_node_add(rn);
+    if (status != 0)
+      return status;
+  }
+
+  redis_pollfds = calloc(redis_nodes_num, sizeof(*redis_pollfds));
+  redis_pollnodes = calloc(redis_nodes_num, sizeof(*redis_pollnodes));
+  if ((redis_pollfds == NULL) || (redis_pollnodes == NULL)) {
+    ERROR("redis plugin: calloc failed.");
     return ENOMEM;
   }
 
-  return redis_node_add(rn);
+  return plugin_register_complex_read(/* group = */ NULL,
+                                      /* name      = */ "redis",
+                                      /* callback  = */ redis_read,
+                                      /* interval  = */ 0,
+                                      /* user_data = */ NULL);
 } /* }}} int redis_init */
 
-static void *c_redisCommand(redis_node_t *rn, const char *format, ...) {
-  redisContext *c = rn->redisContext;
-
-  if (c == NULL)
-    return NULL;
-
-  va_list ap;
-  va_start(ap, format);
-  void *reply = redisvCommand(c, format, ap);
-  va_end(ap);
-
-  if (reply == NULL) {
-    ERROR("redis plugin: Connection error: %s", c->errstr);
-    redisFree(rn->redisContext);
-    rn->redisContext = NULL;
+static int redis_shutdown(void) /* {{{ */
+{
+  while (redis_nodes != NULL) {
+    redis_node_t *next = redis_nodes->next;
+    redis_node_free(redis_nodes);
+    redis_nodes = next;
   }
+  redis_nodes_num = 0;
 
-  return reply;
-} /* void c_redisCommand */
+  sfree(redis_pollfds);
+  sfree(redis_pollnodes);
+  return 0;
+} /* }}} int redis_shutdown */
 
-static int redis_get_info_value(char const *info_line, char const *field_name,
-                                int ds_type, value_t *val) {
-  char *str = strstr(info_line, field_name);
-  static char buf[MAX_REDIS_VAL_SIZE];
-  if (str) {
-    int i;
+static void redis_node_disconnect(redis_node_t *rn) /* {{{ */
+{
+  if (rn->redisContext == NULL)
+    return;
 
-    str += strlen(field_name) + 1; /* also skip the ':' */
-    for (i = 0; (*str && (isdigit((unsigned char)*str) || *str == '.'));
-         i++, str++)
-      buf[i] = *str;
-    buf[i] = '\0';
+  redisFree(rn->redisContext);
+  rn->redisContext = NULL;
+} /* }}} void redis_node_disconnect */
 
-    if (parse_value(buf, val, ds_type) == -1) {
-      WARNING("redis plugin: Unable to parse field `%s'.", field_name);
-      return -1;
-    }
+static int redis_info_get(char const *const *values, int idx, /* {{{ */
+                          value_t *val) {
+  char const *str = values[idx];
+  char *endptr = NULL;
 
-    return 0;
-  }
-  return -1;
-} /* int redis_get_info_value */
+  if (str == NULL)
+    return -1;
 
-static int redis_handle_info(char *node, char const *info_line,
-                             char const *type, char const *type_instance,
-                             char const *field_name, int ds_type) /* {{{ */
-{
-  value_t val;
-  if (redis_get_info_value(info_line, field_name, ds_type, &val) != 0)
+  errno = 0;
+  if (redis_info_fields[idx].ds_type == DS_TYPE_GAUGE)
+    val->gauge = (gauge_t)strtod(str, &endptr);
+  else
+    val->derive = (derive_t)strtoll(str, &endptr, 10);
+
+  if ((endptr == str) || (errno != 0)) {
+    WARNING("redis plugin: Unable to parse field `%s'.",
+            redis_info_fields[idx].name);
     return -1;
+  }
 
-  redis_submit(node, type, type_instance, val);
   return 0;
-} /* }}} int redis_handle_info */
+} /* }}} int redis_info_get */
 
-static int redis_handle_query(redis_node_t *rn, redis_query_t *rq) /* {{{ */
-{
-  redisReply *rr;
+static int redis_handle_query(redis_node_t *rn, redis_query_t *rq, /* {{{ */
+                              redisReply *rr) {
   const data_set_t *ds;
   value_t val;
 
@@ -412,17 +520,6 @@ static int redis_handle_query(redis_node_t *rn, redis_query_t *rq) /* {{{ */
     return -1;
   }
 
-  if ((rr = c_redisCommand(rn, "SELECT %d", rq->database)) == NULL) {
-    WARNING("redis plugin: unable to switch to database `%d' on node `%s'.",
-            rq->database, rn->name);
-    return -1;
-  }
-
-  if ((rr = c_redisCommand(rn, rq->query)) == NULL) {
-    WARNING("redis plugin: unable to carry out query `%s'.", rq->query);
-    return -1;
-  }
-
   switch (rr->type) {
   case REDIS_REPLY_INTEGER:
     switch (ds->ds[0].type) {
@@ -433,118 +530,75 @@ static int redis_handle_query(redis_node_t *rn, redis_query_t *rq) /* {{{ */
       val.gauge = (gauge_t)rr->integer;
       break;
     case DS_TYPE_DERIVE:
-      val.gauge = (derive_t)rr->integer;
+      val.derive = (derive_t)rr->integer;
       break;
     case DS_TYPE_ABSOLUTE:
-      val.gauge = (absolute_t)rr->integer;
+      val.absolute = (absolute_t)rr->integer;
       break;
     }
     break;
   case REDIS_REPLY_STRING:
     if (parse_value(rr->str, &val, ds->ds[0].type) == -1) {
       WARNING("redis plugin: Query `%s': Unable to parse value.", rq->query);
-      freeReplyObject(rr);
       return -1;
     }
     break;
   case REDIS_REPLY_ERROR:
     WARNING("redis plugin: Query `%s' failed: %s.", rq->query, rr->str);
-    freeReplyObject(rr);
     return -1;
   case REDIS_REPLY_ARRAY:
     WARNING("redis plugin: Query `%s' should return string or integer. Arrays "
             "are not supported.",
             rq->query);
-    freeReplyObject(rr);
     return -1;
   default:
     WARNING("redis plugin: Query `%s': Cannot coerce redis type (%i).",
             rq->query, rr->type);
-    freeReplyObject(rr);
     return -1;
   }
 
   redis_submit(rn->name, rq->type,
                (strlen(rq->instance) > 0) ? rq->instance : NULL, val);
-  freeReplyObject(rr);
   return 0;
 } /* }}} int redis_handle_query */
 
-static int redis_db_stats(const char *node, char const *info_line) /* {{{ */
-{
-  /* redis_db_stats parses and dispatches Redis database statistics,
-   * currently the number of keys for each database.
-   * info_line needs to have the following format:
-   *   db0:keys=4,expires=0,avg_ttl=0
-   */
-
-  for (int db = 0; db < REDIS_DEF_DB_COUNT; db++) {
-    static char buf[MAX_REDIS_VAL_SIZE];
-    static char field_name[12];
-    static char db_id[4];
-    value_t val;
-    char *str;
-    int i;
-
-    snprintf(field_name, sizeof(field_name), "db%d:keys=", db);
-
-    str = strstr(info_line, field_name);
-    if (!str)
-      continue;
-
-    str += strlen(field_name);
-    for (i = 0; (*str && isdigit((int)*str)); i++, str++)
-      buf[i] = *str;
-    buf[i] = '\0';
-
-    if (parse_value(buf, &val, DS_TYPE_GAUGE) != 0) {
-      WARNING("redis plugin: Unable to parse field `%s'.", field_name);
-      return -1;
-    }
+/* redis_db_stats dispatches the number of keys of one database. "db" is the
+ * index of the database and "value" needs to have the following format:
+ *   keys=4,expires=0,avg_ttl=0
+ */
+static void redis_db_stats(const char *node, char const *db, /* {{{ */
+                           char const *value) {
+  if (strncmp(value, "keys=", strlen("keys=")) != 0)
+    return;
+  value += strlen("keys=");
 
-    snprintf(db_id, sizeof(db_id), "%d", db);
-    redis_submit(node, "records", db_id, val);
+  char *endptr = NULL;
+  errno = 0;
+  long long keys = strtoll(value, &endptr, 10);
+  if ((endptr == value) || (errno != 0)) {
+    WARNING("redis plugin: Unable to parse field `db%s:keys'.", db);
+    return;
   }
-  return 0;
 
-} /* }}} int redis_db_stats */
+  redis_submit(node, "records", db, (value_t){.gauge = (gauge_t)keys});
+} /* }}} void redis_db_stats */
 
-static void redis_cpu_usage(const char *node, char const *info_line) {
-  while (42) {
-    value_t rusage_user;
-    value_t rusage_syst;
-
-    if (redis_get_info_value(info_line, "used_cpu_user", DS_TYPE_GAUGE,
-                             &rusage_user) != 0)
-      break;
-
-    if (redis_get_info_value(info_line, "used_cpu_sys", DS_TYPE_GAUGE,
-                             &rusage_syst) != 0)
-      break;
+static void redis_cpu_usage(const char *node, char const *const *values) {
+  value_t rusage_user;
+  value_t rusage_syst;
 
+  if ((redis_info_get(values, REDIS_INFO_CPU_USER, &rusage_user) == 0) &&
+      (redis_info_get(values, REDIS_INFO_CPU_SYS, &rusage_syst) == 0))
     redis_submit2(node, "ps_cputime", "daemon",
                   (value_t){.derive = rusage_user.gauge * 1000000},
                   (value_t){.derive = rusage_syst.gauge * 1000000});
-    break;
-  }
-
-  while (42) {
-    value_t rusage_user;
-    value_t rusage_syst;
-
-    if (redis_get_info_value(info_line, "used_cpu_user_children", DS_TYPE_GAUGE,
-                             &rusage_user) != 0)
-      break;
-
-    if (redis_get_info_value(info_line, "used_cpu_sys_children", DS_TYPE_GAUGE,
-                             &rusage_syst) != 0)
-      break;
 
+  if ((redis_info_get(values, REDIS_INFO_CPU_USER_CHILDREN, &rusage_user) ==
+       0) &&
+      (redis_info_get(values, REDIS_INFO_CPU_SYS_CHILDREN, &rusage_syst) == 0))
     redis_submit2(node, "ps_cputime", "children",
                   (value_t){.derive = rusage_user.gauge * 1000000},
                   (value_t){.derive = rusage_syst.gauge * 1000000});
-    break;
-  }
 } /* void redis_cpu_usage */
 
 static gauge_t calculate_ratio_percent(derive_t part1, derive_t part2,
@@ -570,15 +624,14 @@ static gauge_t calculate_ratio_percent(derive_t part1, derive_t part2,
   return 100.0 * (gauge_t)num / (gauge_t)denom;
 } /* gauge_t calculate_ratio_percent */
 
-static void redis_keyspace_usage(redis_node_t *rn, char const *info_line) {
+static void redis_keyspace_usage(redis_node_t *rn,
+                                 char const *const *values) {
   value_t hits, misses;
 
-  if (redis_get_info_value(info_line, "keyspace_hits", DS_TYPE_DERIVE, &hits) !=
-      0)
+  if (redis_info_get(values, REDIS_INFO_KEYSPACE_HITS, &hits) != 0)
     return;
 
-  if (redis_get_info_value(info_line, "keyspace_misses", DS_TYPE_DERIVE,
-                           &misses) != 0)
+  if (redis_info_get(values, REDIS_INFO_KEYSPACE_MISSES, &misses) != 0)
     return;
 
   redis_submit(rn->name, "cache_result", "hits", hits);
@@ -591,121 +644,63 @@ static void redis_keyspace_usage(redis_node_t *rn, char const *info_line) {
 
 } /* void redis_keyspace_usage */
 
-static void redis_check_connection(redis_node_t *rn) {
-  if (rn->redisContext)
-    return;
-
-  redisContext *rh;
-  if (rn->socket != NULL)
-    rh = redisConnectUnixWithTimeout(rn->socket, rn->timeout);
-  else
-    rh = redisConnectWithTimeout(rn->host, rn->port, rn->timeout);
-
-  if (rh == NULL) {
-    ERROR("redis plugin: can't allocate redis context");
-    return;
-  }
-  if (rh->err) {
-    if (rn->socket)
-      ERROR("redis plugin: unable to connect to node `%s' (%s): %s.", rn->name,
-            rn->socket, rh->errstr);
-    else
-      ERROR("redis plugin: unable to connect to node `%s' (%s:%d): %s.",
-            rn->name, rn->host, rn->port, rh->errstr);
-    redisFree(rh);
+static void redis_read_server_info(redis_node_t *rn, redisReply *rr) {
+  if (rr->type != REDIS_REPLY_STRING) {
+    WARNING("redis plugin: node `%s' `INFO' returned unsupported "
+            "redis type %i.",
+            rn->name, rr->type);
     return;
   }
 
-  rn->redisContext = rh;
-
-  if (rn->passwd) {
-    redisReply *rr;
+  /* Split the reply into "name:value" lines once and remember the values of
+   * the wanted fields. */
+  char const *values[REDIS_INFO_FIELDS_NUM] = {NULL};
+  char *line;
+  char *ptr = rr->str;
+  char *saveptr = NULL;
+  while ((line = strtok_r(ptr, "\n\r", &saveptr)) != NULL) {
+    ptr = NULL;
 
-    DEBUG("redis plugin: authenticating node `%s' passwd(%s).", rn->name,
-          rn->passwd);
+    if (line[0] == '#')
+      continue;
 
-    if ((rr = c_redisCommand(rn, "AUTH %s", rn->passwd)) == NULL) {
-      WARNING("redis plugin: unable to authenticate on node `%s'.", rn->name);
-      return;
-    }
+    char *value = strchr(line, ':');
+    if (value == NULL)
+      continue;
+    *value = '\0';
+    value++;
 
-    if (rr->type != REDIS_REPLY_STATUS) {
-      WARNING("redis plugin: invalid authentication on node `%s'.", rn->name);
-      freeReplyObject(rr);
-      redisFree(rn->redisContext);
-      rn->redisContext = NULL;
-      return;
+    int idx = redis_info_lookup(line);
+    if (idx >= 0) {
+      values[idx] = value;
+      continue;
     }
 
-    freeReplyObject(rr);
+    if ((strncmp(line, "db", strlen("db")) == 0) &&
+        isdigit((unsigned char)line[strlen("db")]))
+      redis_db_stats(rn->name, line + strlen("db"), value);
   }
-  return;
-} /* void redis_check_connection */
 
-static void redis_read_server_info(redis_node_t *rn) {
-  redisReply *rr;
+  for (size_t i = REDIS_INFO_SIMPLE; i < REDIS_INFO_FIELDS_NUM; i++) {
+    value_t val;
+    if (redis_info_get(values, (int)i, &val) != 0)
+      continue;
 
-  if ((rr = c_redisCommand(rn, "INFO")) == NULL) {
-    WARNING("redis plugin: unable to get INFO from node `%s'.", rn->name);
-    return;
+    redis_submit(rn->name, redis_info_fields[i].type,
+                 redis_info_fields[i].type_instance, val);
   }
 
-  redis_handle_info(rn->name, rr->str, "uptime", NULL, "uptime_in_seconds",
-                    DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "current_connections", "clients",
-                    "connected_clients", DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "blocked_clients", NULL,
-                    "blocked_clients", DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "memory", NULL, "used_memory",
-                    DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "memory_lua", NULL, "used_memory_lua",
-                    DS_TYPE_GAUGE);
-  /* changes_since_last_save: Deprecated in redis version 2.6 and above */
-  redis_handle_info(rn->name, rr->str, "volatile_changes", NULL,
-                    "changes_since_last_save", DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "total_connections", NULL,
-                    "total_connections_received", DS_TYPE_DERIVE);
-  redis_handle_info(rn->name, rr->str, "total_operations", NULL,
-                    "total_commands_processed", DS_TYPE_DERIVE);
-  redis_handle_info(rn->name, rr->str, "expired_keys", NULL, "expired_keys",
-                    DS_TYPE_DERIVE);
-  redis_handle_info(rn->name, rr->str, "evicted_keys", NULL, "evicted_keys",
-                    DS_TYPE_DERIVE);
-  redis_handle_info(rn->name, rr->str, "pubsub", "channels", "pubsub_channels",
-                    DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "pubsub", "patterns", "pubsub_patterns",
-                    DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "current_connections", "slaves",
-                    "connected_slaves", DS_TYPE_GAUGE);
-  redis_handle_info(rn->name, rr->str, "total_bytes", "input",
-                    "total_net_input_bytes", DS_TYPE_DERIVE);
-  redis_handle_info(rn->name, rr->str, "total_bytes", "output",
-                    "total_net_output_bytes", DS_TYPE_DERIVE);
-
-  redis_keyspace_usage(rn, rr->str);
-
-  redis_db_stats(rn->name, rr->str);
+  redis_keyspace_usage(rn, values);
 
   if (rn->report_cpu_usage)
-    redis_cpu_usage(rn->name, rr->str);
-
-  freeReplyObject(rr);
+    redis_cpu_usage(rn->name, values);
 } /* void redis_read_server_info */
 
-static void redis_read_command_stats(redis_node_t *rn) {
-  redisReply *rr;
-
-  if ((rr = c_redisCommand(rn, "INFO commandstats")) == NULL) {
-    WARNING("redis plugin: node `%s': unable to get `INFO commandstats'.",
-            rn->name);
-    return;
-  }
-
+static void redis_read_command_stats(redis_node_t *rn, redisReply *rr) {
   if (rr->type != REDIS_REPLY_STRING) {
     WARNING("redis plugin: node `%s' `INFO commandstats' returned unsupported "
             "redis type %i.",
             rn->name, rr->type);
-    freeReplyObject(rr);
     return;
   }
 
@@ -765,12 +760,49 @@ static void redis_read_command_stats(redis_node_t *rn) {
       redis_submit(rn->name, type, command, (value_t){.derive = value});
     }
   }
-  freeReplyObject(rr);
 } /* void redis_read_command_stats */
 
-static int redis_read(user_data_t *user_data) /* {{{ */
+static int redis_node_connect(redis_node_t *rn) /* {{{ */
+{
+  if (rn->redisContext)
+    return 0;
+
+  redisContext *rh;
+  if (rn->socket != NULL)
+    rh = redisConnectUnixNonBlock(rn->socket);
+  else
+    rh = redisConnectNonBlock(rn->host, rn->port);
+
+  if (rh == NULL) {
+    ERROR("redis plugin: can't allocate redis context");
+    return -1;
+  }
+  if (rh->err) {
+    if (rn->socket)
+      ERROR("redis plugin: unable to connect to node `%s' (%s): %s.", rn->name,
+            rn->socket, rh->errstr);
+    else
+      ERROR("redis plugin: unable to connect to node `%s' (%s:%d): %s.",
+            rn->name, rn->host, rn->port, rh->errstr);
+    redisFree(rh);
+    return -1;
+  }
+
+  rn->redisContext = rh;
+  rn->database = 0;
+  rn->auth_pending = (rn->passwd != NULL);
+  return 0;
+} /* }}} int redis_node_connect */
+
+/* redis_node_start queues all commands of one read on the connection of the
+ * node. Connections are established in the background, so that connection
+ * errors are reported by redis_node_io. */
+static int redis_node_start(redis_node_t *rn, cdtime_t now) /* {{{ */
 {
-  redis_node_t *rn = user_data->data;
+  rn->replies_num = 0;
+  rn->replies_expected = 0;
+  rn->write_done = false;
+  rn->deadline = now + TIMEVAL_TO_CDTIME_T(&rn->timeout);
 
 #if COLLECT_DEBUG
   if (rn->socket)
@@ -781,30 +813,213 @@ static int redis_read(user_data_t *user_data) /* {{{ */
           rn->host, rn->port);
 #endif
 
-  redis_check_connection(rn);
-
-  if (!rn->redisContext) /* no connection */
+  if (redis_node_connect(rn) != 0)
     return -1;
 
-  redis_read_server_info(rn);
+  redisContext *c = rn->redisContext;
+  size_t expected = 0;
+  int status = REDIS_OK;
 
-  if (!rn->redisContext) /* connection lost */
-    return -1;
+  if (rn->auth_pending) {
+    DEBUG("redis plugin: authenticating node `%s' passwd(%s).", rn->name,
+          rn->passwd);
+    status |= redisAppendCommand(c, "AUTH %s", rn->passwd);
+    expected++;
+  }
 
-  if (rn->report_command_stats) {
-    redis_read_command_stats(rn);
+  status |= redisAppendCommand(c, "INFO");
+  expected++;
 
-    if (!rn->redisContext) /* connection lost */
-      return -1;
+  if (rn->report_command_stats) {
+    status |= redisAppendCommand(c, "INFO commandstats");
+    expected++;
   }
 
+  /* Only switch the database when it changes between queries. */
   for (redis_query_t *rq = rn->queries; rq != NULL; rq = rq->next) {
-    redis_handle_query(rn, rq);
-    if (!rn->redisContext) /* connection lost */
-      return -1;
+    rq->select = (rq->database != rn->database);
+    if (rq->select) {
+      status |= redisAppendCommand(c, "SELECT %d", rq->database);
+      rn->database = rq->database;
+      expected++;
+    }
+
+    status |= redisAppendCommand(c, rq->query);
+    expected++;
   }
 
+  if (status != REDIS_OK) {
+    ERROR("redis plugin: node `%s': queueing commands failed: %s", rn->name,
+          c->errstr);
+    redis_node_disconnect(rn);
+    return -1;
+  }
+
+  rn->replies_expected = expected;
   return 0;
+} /* }}} int redis_node_start */
+
+static void redis_node_io(redis_node_t *rn, short revents) /* {{{ */
+{
+  redisContext *c = rn->redisContext;
+
+  if (!rn->write_done) {
+    int done = 0;
+    if (redisBufferWrite(c, &done) != REDIS_OK)
+      goto error;
+    rn->write_done = (done != 0);
+  }
+
+  if ((revents & (POLLIN | POLLERR | POLLHUP)) &&
+      (redisBufferRead(c) != REDIS_OK))
+    goto error;
+
+  while (rn->replies_num < rn->replies_expected) {
+    void *reply = NULL;
+    if (redisGetReply(c, &reply) != REDIS_OK)
+      goto error;
+    if (reply == NULL)
+      break;
+    rn->replies[rn->replies_num] = reply;
+    rn->replies_num++;
+  }
+  return;
+
+error:
+  ERROR("redis plugin: Connection error on node `%s': %s", rn->name,
+        c->errstr);
+  redis_node_disconnect(rn);
+} /* }}} void redis_node_io */
+
+/* redis_node_handle_replies handles the replies in the order in which
+ * redis_node_start has queued the commands. If a reply is missing, the error
+ * has been reported already and the remaining replies are skipped. */
+static void redis_node_handle_replies(redis_node_t *rn) /* {{{ */
+{
+  size_t i = 0;
+#define NEXT_REPLY() ((i < rn->replies_num) ? rn->replies[i++] : NULL)
+  redisReply *rr;
+
+  if (rn->auth_pending) {
+    if ((rr = NEXT_REPLY()) == NULL)
+      return;
+
+    if (rr->type != REDIS_REPLY_STATUS) {
+      WARNING("redis plugin: invalid authentication on node `%s'.", rn->name);
+      redis_node_disconnect(rn);
+      return;
+    }
+    rn->auth_pending = false;
+  }
+
+  if ((rr = NEXT_REPLY()) == NULL)
+    return;
+  redis_read_server_info(rn, rr);
+
+  if (rn->report_command_stats) {
+    if ((rr = NEXT_REPLY()) == NULL)
+      return;
+    redis_read_command_stats(rn, rr);
+  }
+
+  bool select_failed = false;
+  for (redis_query_t *rq = rn->queries; rq != NULL; rq = rq->next) {
+    if (rq->select) {
+      if ((rr = NEXT_REPLY()) == NULL)
+        return;
+
+      select_failed = (rr->type == REDIS_REPLY_ERROR);
+      if (select_failed)
+        WARNING("redis plugin: unable to switch to database `%d' on node "
+                "`%s'.",
+                rq->database, rn->name);
+    }
+
+    if ((rr = NEXT_REPLY()) == NULL)
+      return;
+    if (!select_failed)
+      redis_handle_query(rn, rq, rr);
+  }
+#undef NEXT_REPLY
+
+  /* The selected database is unknown after a failed SELECT. */
+  if (select_failed)
+    redis_node_disconnect(rn);
+} /* }}} void redis_node_handle_replies */
+
+static bool redis_node_busy(redis_node_t const *rn) /* {{{ */
+{
+  return (rn->redisContext != NULL) && (rn->replies_num < rn->replies_expected);
+} /* }}} bool redis_node_busy */
+
+static int redis_read(__attribute__((unused)) user_data_t *user_data) /* {{{ */
+{
+  for (redis_node_t *rn = redis_nodes; rn != NULL; rn = rn->next)
+    redis_node_start(rn, cdtime());
+
+  /* Send the commands to and read the replies from all nodes at once. */
+  while (42) {
+    cdtime_t now = cdtime();
+    cdtime_t deadline = 0;
+    nfds_t fds_num = 0;
+
+    for (redis_node_t *rn = redis_nodes; rn != NULL; rn = rn->next) {
+      if (!redis_node_busy(rn))
+        continue;
+
+      if (now >= rn->deadline) {
+        ERROR("redis plugin: Timeout while waiting for node `%s'.", rn->name);
+        redis_node_disconnect(rn);
+        continue;
+      }
+
+      if ((deadline == 0) || (rn->deadline < deadline))
+        deadline = rn->deadline;
+
+      redis_pollfds[fds_num] = (struct pollfd){
+          .fd = rn->redisContext->fd,
+          .events = POLLIN | (rn->write_done ? 0 : POLLOUT),
+      };
+      redis_pollnodes[fds_num] = rn;
+      fds_num++;
+    }
+
+    if (fds_num == 0)
+      break;
+
+    int status = poll(redis_pollfds, fds_num,
+                      (int)CDTIME_T_TO_MS(deadline - now) + 1);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("redis plugin: poll failed: %s", STRERRNO);
+      break;
+    }
+
+    for (nfds_t i = 0; i < fds_num; i++)
+      if (redis_pollfds[i].revents != 0)
+        redis_node_io(redis_pollnodes[i], redis_pollfds[i].revents);
+  }
+
+  int success = 0;
+  for (redis_node_t *rn = redis_nodes; rn != NULL; rn = rn->next) {
+    /* Replies that arrive later would be taken for the next read's. */
+    if (redis_node_busy(rn))
+      redis_node_disconnect(rn);
+
+    if ((rn->replies_expected > 0) &&
+        (rn->replies_num == rn->replies_expected))
+      success++;
+
+    redis_node_handle_replies(rn);
+
+    for (size_t i = 0; i < rn->replies_num; i++)
+      freeReplyObject(rn->replies[i]);
+    rn->replies_num = 0;
+    rn->replies_expected = 0;
+  }
+
+  return (success > 0) ? 0 : -1;
 }
 /* }}} */
 
@@ -812,5 +1027,6 @@ void module_register(void) /* {{{ */
 {
   plugin_register_complex_config("redis", redis_config);
   plugin_register_init("redis", redis_init);
+  plugin_register_shutdown("redis", redis_shutdown);
 }
 /* }}} */
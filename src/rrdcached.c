@@ -27,6 +27,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/rrdcreate/rrdcreate.h"
 
@@ -34,6 +35,25 @@
 #include <rrd.h>
 #include <rrd_client.h>
 
+/* Size of the command buffer of librrd's client. A single "UPDATE" command,
+ * i.e. the file name and all values, has to fit. */
+#define RC_UPDATE_SIZE_MAX 4096
+
+/* Number of values, as multiple of "BatchSize", that are queued at most while
+ * the daemon is not reachable. Newer values are dropped. */
+#define RC_QUEUE_LIMIT_FACTOR 100
+
+/*
+ * Private types
+ */
+
+/* Values of one file that have not been sent to the daemon yet. */
+typedef struct {
+  char *filename;
+  char **values;
+  size_t values_num;
+} rc_queue_entry_t;
+
 /*
  * Private variables
  */
@@ -55,6 +75,23 @@ static rrdcreate_config_t rrdcreate_config = {
 
     /* async = */ 0};
 
+/* If "batch_size" is greater than zero, values are sent by a separate thread,
+ * "queue_thread". It sends all queued values once "batch_size" values have
+ * been queued or the oldest value has been queued for "batch_timeout", with
+ * one "UPDATE" command per file. Values that could not be sent are put back
+ * into the queue and retried with the next batch. */
+static int batch_size;
+static cdtime_t batch_timeout = TIME_T_TO_CDTIME_T_STATIC(1);
+
+static c_avl_tree_t *queue;
+static size_t queue_values_num;
+static cdtime_t queue_oldest;
+static bool queue_shutdown;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t queue_thread;
+static bool queue_thread_running;
+
 /*
  * Prototypes.
  */
@@ -245,6 +282,10 @@ static int rc_config(oconfig_item_t *ci) {
         status = rc_config_add_timespan(tmp);
     } else if (strcasecmp("XFF", key) == 0)
       status = rc_config_get_xff(child, &rrdcreate_config.xff);
+    else if (strcasecmp("BatchSize", key) == 0)
+      status = rc_config_get_int_positive(child, &batch_size);
+    else if (strcasecmp("BatchTimeout", key) == 0)
+      status = cf_util_get_cdtime(child, &batch_timeout);
     else {
       WARNING("rrdcached plugin: Ignoring invalid option %s.", key);
       continue;
@@ -281,6 +322,283 @@ static int try_reconnect(void) {
   return 0;
 } /* int try_reconnect */
 
+static void rc_queue_entry_destroy(rc_queue_entry_t *e) {
+  if (e == NULL)
+    return;
+
+  for (size_t i = 0; i < e->values_num; i++)
+    sfree(e->values[i]);
+  sfree(e->values);
+  sfree(e->filename);
+  sfree(e);
+} /* void rc_queue_entry_destroy */
+
+/* rc_queue_destroy frees all entries of "tree" and the tree itself. Returns the
+ * number of values that have been discarded. */
+static size_t rc_queue_destroy(c_avl_tree_t *tree) {
+  size_t values_num = 0;
+  char *filename;
+  rc_queue_entry_t *e;
+
+  if (tree == NULL)
+    return 0;
+
+  while (c_avl_pick(tree, (void *)&filename, (void *)&e) == 0) {
+    values_num += e->values_num;
+    rc_queue_entry_destroy(e);
+  }
+  c_avl_destroy(tree);
+
+  return values_num;
+} /* size_t rc_queue_destroy */
+
+/* rc_queue_merge moves the values of "src" in front of the values queued for
+ * the same file, so that they are sent in order. "src" is freed. queue_lock
+ * must be held. */
+static void rc_queue_merge(rc_queue_entry_t *src) {
+  rc_queue_entry_t *dst = NULL;
+
+  if (c_avl_get(queue, src->filename, (void *)&dst) != 0) {
+    if (c_avl_insert(queue, src->filename, src) != 0) {
+      ERROR("rrdcached plugin: Dropping %" PRIsz " values of %s.",
+            src->values_num, src->filename);
+      rc_queue_entry_destroy(src);
+      return;
+    }
+    queue_values_num += src->values_num;
+    return;
+  }
+
+  char **tmp = realloc(dst->values, (src->values_num + dst->values_num) *
+                                        sizeof(*dst->values));
+  if (tmp == NULL) {
+    ERROR("rrdcached plugin: Dropping %" PRIsz " values of %s.",
+          src->values_num, src->filename);
+    rc_queue_entry_destroy(src);
+    return;
+  }
+  dst->values = tmp;
+
+  memmove(dst->values + src->values_num, dst->values,
+          dst->values_num * sizeof(*dst->values));
+  memcpy(dst->values, src->values, src->values_num * sizeof(*dst->values));
+  dst->values_num += src->values_num;
+  queue_values_num += src->values_num;
+
+  src->values_num = 0;
+  rc_queue_entry_destroy(src);
+} /* void rc_queue_merge */
+
+static int rc_queue_enqueue(char const *filename, char const *value) {
+  pthread_mutex_lock(&queue_lock);
+
+  if (queue_values_num >= ((size_t)batch_size) * RC_QUEUE_LIMIT_FACTOR) {
+    pthread_mutex_unlock(&queue_lock);
+    return ENOSPC;
+  }
+
+  rc_queue_entry_t *e = NULL;
+  bool new_entry = false;
+  if (c_avl_get(queue, filename, (void *)&e) != 0) {
+    e = calloc(1, sizeof(*e));
+    if (e == NULL) {
+      pthread_mutex_unlock(&queue_lock);
+      return ENOMEM;
+    }
+    new_entry = true;
+  }
+
+  char *v = strdup(value);
+  char **tmp = realloc(e->values, (e->values_num + 1) * sizeof(*e->values));
+  if (tmp != NULL)
+    e->values = tmp;
+  if (new_entry && (tmp != NULL))
+    e->filename = strdup(filename);
+
+  if ((v == NULL) || (tmp == NULL) || (new_entry && (e->filename == NULL)) ||
+      (new_entry && (c_avl_insert(queue, e->filename, e) != 0))) {
+    pthread_mutex_unlock(&queue_lock);
+    sfree(v);
+    if (new_entry)
+      rc_queue_entry_destroy(e);
+    return ENOMEM;
+  }
+  e->values[e->values_num] = v;
+  e->values_num++;
+
+  if (queue_values_num == 0)
+    queue_oldest = cdtime();
+  queue_values_num++;
+
+  /* The thread starts waiting for "batch_timeout" with the first value. */
+  if ((queue_values_num == 1) || (queue_values_num >= (size_t)batch_size))
+    pthread_cond_signal(&queue_cond);
+
+  pthread_mutex_unlock(&queue_lock);
+  return 0;
+} /* int rc_queue_enqueue */
+
+/* rc_queue_send_entry sends the values of "e" to the daemon, using as few
+ * "UPDATE" commands as possible. Values that have been sent are removed from
+ * "e". */
+static int rc_queue_send_entry(rc_queue_entry_t *e) {
+  size_t sent = 0;
+  int status = 0;
+
+  while (sent < e->values_num) {
+    /* "update <filename>", a space and the value per value, and a newline. */
+    size_t size = strlen("update \n") + strlen(e->filename);
+    size_t num = 0;
+    while ((sent + num) < e->values_num) {
+      size_t len = 1 + strlen(e->values[sent + num]);
+      if ((num > 0) && ((size + len) >= RC_UPDATE_SIZE_MAX))
+        break;
+      size += len;
+      num++;
+    }
+
+    rrd_clear_error();
+    status = rrdc_update(e->filename, (int)num, (void *)(e->values + sent));
+    if (status != 0)
+      break;
+    sent += num;
+  }
+
+  for (size_t i = 0; i < sent; i++)
+    sfree(e->values[i]);
+  memmove(e->values, e->values + sent,
+          (e->values_num - sent) * sizeof(*e->values));
+  e->values_num -= sent;
+
+  return status;
+} /* int rc_queue_send_entry */
+
+/* rc_queue_send sends all values in "batch" to the daemon. Entries that have
+ * been sent are removed from the tree. After the first failure, the connection
+ * is re-established once; if that fails, too, no further entries are tried. */
+static void rc_queue_send(c_avl_tree_t *batch) {
+  c_avl_tree_t *failed =
+      c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (failed == NULL)
+    return;
+
+  rrd_clear_error();
+  int status = rrdc_connect(daemon_address);
+  bool connected = (status == 0);
+  bool retried = false;
+  if (!connected)
+    ERROR("rrdcached plugin: Failed to connect to RRDCacheD "
+          "at %s: %s (status=%d)",
+          daemon_address, rrd_get_error(), status);
+
+  char *filename;
+  rc_queue_entry_t *e;
+  while (c_avl_pick(batch, (void *)&filename, (void *)&e) == 0) {
+    if (connected) {
+      /* The RRD client lib does not provide any means for checking a
+       * connection, hence we'll have to retry upon failed operations. */
+      status = rc_queue_send_entry(e);
+      if ((status != 0) && !retried) {
+        retried = true;
+        connected = (try_reconnect() == 0);
+        if (connected)
+          status = rc_queue_send_entry(e);
+      }
+      if ((status != 0) && connected)
+        ERROR("rrdcached plugin: rrdc_update (%s, [%s], %" PRIsz
+              ") failed: %s (status=%i)",
+              e->filename, e->values[0], e->values_num, rrd_get_error(),
+              status);
+    }
+
+    if (e->values_num == 0) {
+      rc_queue_entry_destroy(e);
+    } else if (c_avl_insert(failed, e->filename, e) != 0) {
+      ERROR("rrdcached plugin: Dropping %" PRIsz " values of %s.",
+            e->values_num, e->filename);
+      rc_queue_entry_destroy(e);
+    }
+  }
+
+  /* Hand the failed entries back to the caller. */
+  while (c_avl_pick(failed, (void *)&filename, (void *)&e) == 0)
+    c_avl_insert(batch, e->filename, e);
+  c_avl_destroy(failed);
+} /* void rc_queue_send */
+
+static void *rc_queue_thread(void __attribute__((unused)) * arg) {
+  cdtime_t retry_after = 0;
+
+  pthread_mutex_lock(&queue_lock);
+  while (42) {
+    if ((queue_values_num == 0) && !queue_shutdown) {
+      pthread_cond_wait(&queue_cond, &queue_lock);
+      continue;
+    }
+
+    if (!queue_shutdown) {
+      cdtime_t deadline = retry_after;
+      if ((queue_values_num < (size_t)batch_size) &&
+          (deadline < (queue_oldest + batch_timeout)))
+        deadline = queue_oldest + batch_timeout;
+
+      if (cdtime() < deadline) {
+        struct timespec ts = CDTIME_T_TO_TIMESPEC(deadline);
+        pthread_cond_timedwait(&queue_cond, &queue_lock, &ts);
+        continue;
+      }
+    }
+
+    c_avl_tree_t *batch = queue;
+    queue = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (queue == NULL) {
+      ERROR("rrdcached plugin: c_avl_create failed.");
+      queue = batch;
+      if (queue_shutdown)
+        break;
+      retry_after = cdtime() + TIME_T_TO_CDTIME_T(1);
+      continue;
+    }
+    queue_values_num = 0;
+    bool shutdown = queue_shutdown;
+    pthread_mutex_unlock(&queue_lock);
+
+    rc_queue_send(batch);
+
+    pthread_mutex_lock(&queue_lock);
+    if (shutdown) {
+      size_t lost = rc_queue_destroy(batch);
+      if (lost > 0)
+        WARNING("rrdcached plugin: %" PRIsz " values have not been sent "
+                "when shutting down.",
+                lost);
+      break;
+    }
+
+    if (c_avl_size(batch) > 0) {
+      /* Don't retry more often than once per second. */
+      retry_after = cdtime() + ((batch_timeout > TIME_T_TO_CDTIME_T(1))
+                                    ? batch_timeout
+                                    : TIME_T_TO_CDTIME_T(1));
+      if (queue_values_num == 0)
+        queue_oldest = cdtime();
+
+      char *filename;
+      rc_queue_entry_t *e;
+      while (c_avl_pick(batch, (void *)&filename, (void *)&e) == 0)
+        rc_queue_merge(e);
+    }
+    c_avl_destroy(batch);
+  } /* while (42) */
+
+  rc_queue_destroy(queue);
+  queue = NULL;
+  queue_values_num = 0;
+  pthread_mutex_unlock(&queue_lock);
+
+  return NULL;
+} /* void *rc_queue_thread */
+
 static int rc_read(void) {
   int status;
   rrdc_stats_t *head;
@@ -383,6 +701,27 @@ static int rc_init(void) {
   if (config_collect_stats)
     plugin_register_read("rrdcached", rc_read);
 
+  if ((daemon_address == NULL) || (batch_size == 0) || queue_thread_running)
+    return 0;
+
+  queue = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (queue == NULL) {
+    ERROR("rrdcached plugin: c_avl_create failed.");
+    return -1;
+  }
+
+  int status = plugin_thread_create(&queue_thread, /* attr = */ NULL,
+                                    rc_queue_thread, /* arg = */ NULL,
+                                    "rrdcached queue");
+  if (status != 0) {
+    ERROR("rrdcached plugin: Cannot create the queue thread: %s",
+          STRERROR(status));
+    c_avl_destroy(queue);
+    queue = NULL;
+    return -1;
+  }
+  queue_thread_running = true;
+
   return 0;
 } /* int rc_init */
 
@@ -437,6 +776,20 @@ static int rc_write(const data_set_t *ds, const value_list_t *vl,
     }
   }
 
+  if (queue_thread_running) {
+    status = rc_queue_enqueue(filename, values);
+    if (status == ENOSPC) {
+      ERROR("rrdcached plugin: The queue is full, dropping value of %s.",
+            filename);
+      return -1;
+    } else if (status != 0) {
+      ERROR("rrdcached plugin: rc_queue_enqueue (%s) failed: %s", filename,
+            STRERROR(status));
+      return -1;
+    }
+    return 0;
+  }
+
   rrd_clear_error();
   status = rrdc_connect(daemon_address);
   if (status != 0) {
@@ -469,6 +822,23 @@ static int rc_write(const data_set_t *ds, const value_list_t *vl,
   return 0;
 } /* int rc_write */
 
+/* rc_flush_requeue puts values taken from the queue by rc_flush back. */
+static void rc_flush_requeue(rc_queue_entry_t *e) {
+  if (e == NULL)
+    return;
+
+  if (e->values_num == 0) {
+    rc_queue_entry_destroy(e);
+    return;
+  }
+
+  pthread_mutex_lock(&queue_lock);
+  if (queue_values_num == 0)
+    queue_oldest = cdtime();
+  rc_queue_merge(e);
+  pthread_mutex_unlock(&queue_lock);
+} /* void rc_flush_requeue */
+
 static int rc_flush(__attribute__((unused)) cdtime_t timeout, /* {{{ */
                     const char *identifier,
                     __attribute__((unused)) user_data_t *ud) {
@@ -484,20 +854,36 @@ static int rc_flush(__attribute__((unused)) cdtime_t timeout, /* {{{ */
   else
     snprintf(filename, sizeof(filename), "%s.rrd", identifier);
 
+  /* Values of this file that are still queued are sent first. */
+  rc_queue_entry_t *pending = NULL;
+  if (queue_thread_running) {
+    pthread_mutex_lock(&queue_lock);
+    if (c_avl_remove(queue, filename, NULL, (void *)&pending) == 0)
+      queue_values_num -= pending->values_num;
+    pthread_mutex_unlock(&queue_lock);
+  }
+
   rrd_clear_error();
   status = rrdc_connect(daemon_address);
   if (status != 0) {
     ERROR("rrdcached plugin: Failed to connect to RRDCacheD "
           "at %s: %s (status=%d)",
           daemon_address, rrd_get_error(), status);
+    rc_flush_requeue(pending);
     return -1;
   }
 
   while (42) {
     /* The RRD client lib does not provide any means for checking a
      * connection, hence we'll have to retry upon failed operations. */
-    rrd_clear_error();
-    status = rrdc_flush(filename);
+    status = 0;
+    if (pending != NULL)
+      status = rc_queue_send_entry(pending);
+
+    if (status == 0) {
+      rrd_clear_error();
+      status = rrdc_flush(filename);
+    }
     if (status == 0)
       break;
 
@@ -510,14 +896,26 @@ static int rc_flush(__attribute__((unused)) cdtime_t timeout, /* {{{ */
 
     ERROR("rrdcached plugin: rrdc_flush (%s) failed: %s (status=%i).", filename,
           rrd_get_error(), status);
+    rc_flush_requeue(pending);
     return -1;
   }
   DEBUG("rrdcached plugin: rrdc_flush (%s): Success.", filename);
+  rc_queue_entry_destroy(pending);
 
   return 0;
 } /* }}} int rc_flush */
 
 static int rc_shutdown(void) {
+  if (queue_thread_running) {
+    pthread_mutex_lock(&queue_lock);
+    queue_shutdown = true;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(queue_thread, NULL);
+    queue_thread_running = false;
+  }
+
   rrdc_disconnect();
   return 0;
 } /* int rc_shutdown */
@@ -26,8 +26,9 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
+#include "utils/heap/heap.h"
 #include "utils/rrdcreate/rrdcreate.h"
 #include "utils_random.h"
 
@@ -36,13 +37,32 @@
 /*
  * Private types
  */
+
+/* Pending updates of one file are kept as packed binary records: the time in
+ * seconds followed by "ds_num" values. They are only formatted to rrdtool's
+ * "time:value[:value...]" syntax when the file is written. The types of the
+ * data sources are stored in front of the records, so that a buffer taken
+ * from the cache can be formatted without looking at the cache entry again. */
+typedef struct {
+  size_t ds_num;
+  size_t records_max;
+  uint8_t data[]; /* ds_num types, followed by records_max records */
+} rrd_values_t;
+
+#define RRD_RECORD_SIZE(ds_num) (sizeof(uint32_t) + (ds_num) * sizeof(value_t))
+/* Enough for the time and any value in text form. */
+#define RRD_RECORD_STRLEN(ds_num) (32 * ((ds_num) + 1))
+
 typedef struct rrd_cache_s {
+  char *filename; /* points to the key in "cache" */
   int values_num;
-  char **values;
+  rrd_values_t *values;
   cdtime_t first_value;
   cdtime_t last_value;
   int64_t random_variation;
   enum { FLAG_NONE = 0x00, FLAG_QUEUED = 0x01, FLAG_FLUSHQ = 0x02 } flags;
+  /* Position in "flush_index". Never later than the time the entry is due. */
+  cdtime_t flush_check;
 } rrd_cache_t;
 
 enum rrd_queue_dir_e { QUEUE_INSERT_FRONT, QUEUE_INSERT_BACK };
@@ -54,13 +74,26 @@ struct rrd_queue_s {
 };
 typedef struct rrd_queue_s rrd_queue_t;
 
+/* Each file is always written by the same updater thread, selected by a hash
+ * of its name, so that updates to one file are never reordered. */
+typedef struct {
+  rrd_queue_t *queue_head;
+  rrd_queue_t *queue_tail;
+  rrd_queue_t *flushq_head;
+  rrd_queue_t *flushq_tail;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool thread_running;
+} rrd_queue_shard_t;
+
 /*
  * Private variables
  */
 static const char *config_keys[] = {
     "CacheTimeout", "CacheFlush",      "CreateFilesAsync", "DataDir",
     "StepSize",     "HeartBeat",       "RRARows",          "RRATimespan",
-    "XFF",          "WritesPerSecond", "RandomTimeout"};
+    "XFF",          "WritesPerSecond", "RandomTimeout",    "UpdateThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /* If datadir is zero, the daemon's basedir is used. If stepsize or heartbeat
@@ -82,23 +115,22 @@ static rrdcreate_config_t rrdcreate_config = {
 
     /* async = */ 0};
 
-/* XXX: If you need to lock both, cache_lock and queue_lock, at the same time,
- * ALWAYS lock `cache_lock' first! */
+/* XXX: If you need to lock both, cache_lock and a shard's queue lock, at the
+ * same time, ALWAYS lock `cache_lock' first!
+ *
+ * "flush_index" holds all entries of "cache", ordered by "flush_check", so
+ * that rrd_cache_flush() only has to look at entries that may be due. */
 static cdtime_t cache_timeout;
 static cdtime_t cache_flush_timeout;
 static cdtime_t random_timeout;
 static cdtime_t cache_flush_last;
-static c_avl_tree_t *cache;
+static c_btree_t *cache;
+static c_heap_t *flush_index;
 static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static rrd_queue_t *queue_head;
-static rrd_queue_t *queue_tail;
-static rrd_queue_t *flushq_head;
-static rrd_queue_t *flushq_tail;
-static pthread_t queue_thread;
-static int queue_thread_running = 1;
-static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static int update_threads = 1;
+static rrd_queue_shard_t *queue_shards;
+static size_t queue_shards_num;
 
 #if !HAVE_THREADSAFE_LIBRRD
 static pthread_mutex_t librrd_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -163,85 +195,125 @@ static int srrd_update(char *filename, char *template, int argc,
 } /* int srrd_update */
 #endif /* !HAVE_THREADSAFE_LIBRRD */
 
-static int value_list_to_string_multiple(char *buffer, int buffer_len,
-                                         const data_set_t *ds,
-                                         const value_list_t *vl) {
-  int offset;
-  int status;
-  time_t tt;
-
-  memset(buffer, '\0', buffer_len);
-
-  tt = CDTIME_T_TO_TIME_T(vl->time);
-  status = snprintf(buffer, buffer_len, "%u", (unsigned int)tt);
-  if ((status < 1) || (status >= buffer_len))
-    return -1;
-  offset = status;
-
+static int rrd_values_check(const data_set_t *ds) {
   for (size_t i = 0; i < ds->ds_num; i++) {
     if ((ds->ds[i].type != DS_TYPE_COUNTER) &&
         (ds->ds[i].type != DS_TYPE_GAUGE) &&
         (ds->ds[i].type != DS_TYPE_DERIVE) &&
         (ds->ds[i].type != DS_TYPE_ABSOLUTE))
-      return -1;
+      return EINVAL;
+  }
+
+  return 0;
+} /* int rrd_values_check */
+
+static uint8_t *rrd_values_record(rrd_values_t *v, size_t index) {
+  return v->data + v->ds_num + index * RRD_RECORD_SIZE(v->ds_num);
+} /* uint8_t *rrd_values_record */
+
+/* rrd_values_append appends the values of "vl" to "*v", growing the buffer as
+ * necessary. "*v" may be NULL. */
+static int rrd_values_append(rrd_values_t **v, size_t records_num,
+                             const data_set_t *ds, const value_list_t *vl) {
+  if ((*v != NULL) && ((*v)->ds_num != ds->ds_num))
+    return EINVAL;
+
+  if ((*v == NULL) || (records_num >= (*v)->records_max)) {
+    size_t records_max = (*v == NULL) ? 4 : 2 * (*v)->records_max;
+    rrd_values_t *tmp =
+        realloc(*v, sizeof(*tmp) + ds->ds_num +
+                        records_max * RRD_RECORD_SIZE(ds->ds_num));
+    if (tmp == NULL)
+      return ENOMEM;
+
+    if (*v == NULL) {
+      tmp->ds_num = ds->ds_num;
+      for (size_t i = 0; i < ds->ds_num; i++)
+        tmp->data[i] = (uint8_t)ds->ds[i].type;
+    }
+    tmp->records_max = records_max;
+    *v = tmp;
+  }
+
+  uint8_t *record = rrd_values_record(*v, records_num);
+  uint32_t tt = (uint32_t)CDTIME_T_TO_TIME_T(vl->time);
+  memcpy(record, &tt, sizeof(tt));
+  memcpy(record + sizeof(tt), vl->values, ds->ds_num * sizeof(value_t));
+
+  return 0;
+} /* int rrd_values_append */
+
+static int rrd_values_format_record(char *buffer, size_t buffer_len,
+                                    rrd_values_t *v, size_t index) {
+  uint8_t const *record = rrd_values_record(v, index);
+
+  uint32_t tt;
+  memcpy(&tt, record, sizeof(tt));
+
+  int status = snprintf(buffer, buffer_len, "%u", (unsigned int)tt);
+  if ((status < 1) || ((size_t)status >= buffer_len))
+    return ENOMEM;
+  size_t offset = (size_t)status;
 
-    if (ds->ds[i].type == DS_TYPE_COUNTER)
+  for (size_t i = 0; i < v->ds_num; i++) {
+    value_t value;
+    memcpy(&value, record + sizeof(tt) + i * sizeof(value), sizeof(value));
+
+    switch (v->data[i]) {
+    case DS_TYPE_COUNTER:
       status = snprintf(buffer + offset, buffer_len - offset, ":%" PRIu64,
-                        (uint64_t)vl->values[i].counter);
-    else if (ds->ds[i].type == DS_TYPE_GAUGE)
+                        (uint64_t)value.counter);
+      break;
+    case DS_TYPE_GAUGE:
       status = snprintf(buffer + offset, buffer_len - offset, ":" GAUGE_FORMAT,
-                        vl->values[i].gauge);
-    else if (ds->ds[i].type == DS_TYPE_DERIVE)
+                        value.gauge);
+      break;
+    case DS_TYPE_DERIVE:
       status = snprintf(buffer + offset, buffer_len - offset, ":%" PRIi64,
-                        vl->values[i].derive);
-    else /*if (ds->ds[i].type == DS_TYPE_ABSOLUTE) */
+                        value.derive);
+      break;
+    case DS_TYPE_ABSOLUTE:
       status = snprintf(buffer + offset, buffer_len - offset, ":%" PRIu64,
-                        vl->values[i].absolute);
+                        value.absolute);
+      break;
+    default:
+      return EINVAL;
+    }
 
-    if ((status < 1) || (status >= (buffer_len - offset)))
-      return -1;
+    if ((status < 1) || ((size_t)status >= (buffer_len - offset)))
+      return ENOMEM;
 
-    offset += status;
-  } /* for ds->ds_num */
+    offset += (size_t)status;
+  } /* for ds_num */
 
   return 0;
-} /* int value_list_to_string_multiple */
+} /* int rrd_values_format_record */
 
-static int value_list_to_string(char *buffer, int buffer_len,
-                                const data_set_t *ds, const value_list_t *vl) {
-  int status;
-  time_t tt;
-
-  if (ds->ds_num != 1)
-    return value_list_to_string_multiple(buffer, buffer_len, ds, vl);
-
-  tt = CDTIME_T_TO_TIME_T(vl->time);
-  switch (ds->ds[0].type) {
-  case DS_TYPE_DERIVE:
-    status = snprintf(buffer, buffer_len, "%u:%" PRIi64, (unsigned)tt,
-                      vl->values[0].derive);
-    break;
-  case DS_TYPE_GAUGE:
-    status = snprintf(buffer, buffer_len, "%u:" GAUGE_FORMAT, (unsigned)tt,
-                      vl->values[0].gauge);
-    break;
-  case DS_TYPE_COUNTER:
-    status = snprintf(buffer, buffer_len, "%u:%" PRIu64, (unsigned)tt,
-                      (uint64_t)vl->values[0].counter);
-    break;
-  case DS_TYPE_ABSOLUTE:
-    status = snprintf(buffer, buffer_len, "%u:%" PRIu64, (unsigned)tt,
-                      vl->values[0].absolute);
-    break;
-  default:
-    return EINVAL;
-  }
+/* rrd_values_format returns the records in "v" as an argument vector for
+ * rrd_update(3). The vector and the strings are allocated as one block of
+ * memory which has to be freed by the caller. */
+static char **rrd_values_format(rrd_values_t *v, int records_num) {
+  size_t strlen_max = RRD_RECORD_STRLEN(v->ds_num);
 
-  if ((status < 1) || (status >= buffer_len))
-    return ENOMEM;
+  char **argv = malloc((size_t)records_num * (sizeof(*argv) + strlen_max));
+  if (argv == NULL)
+    return NULL;
 
-  return 0;
-} /* int value_list_to_string */
+  char *buffer = (char *)(argv + records_num);
+  for (int i = 0; i < records_num; i++) {
+    argv[i] = buffer + (size_t)i * strlen_max;
+
+    int status = rrd_values_format_record(argv[i], strlen_max, v, (size_t)i);
+    if (status != 0) {
+      ERROR("rrdtool plugin: Formatting values failed with status %i.",
+            status);
+      sfree(argv);
+      return NULL;
+    }
+  }
+
+  return argv;
+} /* char **rrd_values_format */
 
 static int value_list_to_filename(char *buffer, size_t buffer_size,
                                   value_list_t const *vl) {
@@ -279,36 +351,41 @@ static int value_list_to_filename(char *buffer, size_t buffer_size,
   return 0;
 } /* int value_list_to_filename */
 
-static void *rrd_queue_thread(void __attribute__((unused)) * data) {
+static void *rrd_queue_thread(void *data) {
+  rrd_queue_shard_t *shard = data;
   struct timeval tv_next_update;
   struct timeval tv_now;
 
+  /* Every thread writes its share of the files, so the delay between two
+   * updates is stretched to keep the total rate at "WritesPerSecond". */
+  double delay = write_rate * (double)queue_shards_num;
+
   gettimeofday(&tv_next_update, /* timezone = */ NULL);
 
   while (42) {
     rrd_queue_t *queue_entry;
     rrd_cache_t *cache_entry;
-    char **values;
+    rrd_values_t *values;
     int values_num;
     int status;
 
     values = NULL;
     values_num = 0;
 
-    pthread_mutex_lock(&queue_lock);
+    pthread_mutex_lock(&shard->lock);
     /* Wait for values to arrive */
     while (42) {
       struct timespec ts_wait;
 
-      while ((flushq_head == NULL) && (queue_head == NULL) &&
+      while ((shard->flushq_head == NULL) && (shard->queue_head == NULL) &&
              (do_shutdown == 0))
-        pthread_cond_wait(&queue_cond, &queue_lock);
+        pthread_cond_wait(&shard->cond, &shard->lock);
 
-      if ((flushq_head == NULL) && (queue_head == NULL))
+      if ((shard->flushq_head == NULL) && (shard->queue_head == NULL))
         break;
 
       /* Don't delay if there's something to flush */
-      if (flushq_head != NULL)
+      if (shard->flushq_head != NULL)
         break;
 
       /* Don't delay if we're shutting down */
@@ -316,7 +393,7 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
         break;
 
       /* Don't delay if no delay was configured. */
-      if (write_rate <= 0.0)
+      if (delay <= 0.0)
         break;
 
       gettimeofday(&tv_now, /* timezone = */ NULL);
@@ -331,45 +408,45 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
       ts_wait.tv_sec = tv_next_update.tv_sec;
       ts_wait.tv_nsec = 1000 * tv_next_update.tv_usec;
 
-      status = pthread_cond_timedwait(&queue_cond, &queue_lock, &ts_wait);
+      status = pthread_cond_timedwait(&shard->cond, &shard->lock, &ts_wait);
       if (status == ETIMEDOUT)
         break;
     } /* while (42) */
 
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
+    /* XXX: If you need to lock both, cache_lock and a shard's queue lock, at
      * the same time, ALWAYS lock `cache_lock' first! */
 
     /* We're in the shutdown phase */
-    if ((flushq_head == NULL) && (queue_head == NULL)) {
-      pthread_mutex_unlock(&queue_lock);
+    if ((shard->flushq_head == NULL) && (shard->queue_head == NULL)) {
+      pthread_mutex_unlock(&shard->lock);
       break;
     }
 
-    if (flushq_head != NULL) {
+    if (shard->flushq_head != NULL) {
       /* Dequeue the first flush entry */
-      queue_entry = flushq_head;
-      if (flushq_head == flushq_tail)
-        flushq_head = flushq_tail = NULL;
+      queue_entry = shard->flushq_head;
+      if (shard->flushq_head == shard->flushq_tail)
+        shard->flushq_head = shard->flushq_tail = NULL;
       else
-        flushq_head = flushq_head->next;
-    } else /* if (queue_head != NULL) */
+        shard->flushq_head = shard->flushq_head->next;
+    } else /* if (shard->queue_head != NULL) */
     {
       /* Dequeue the first regular entry */
-      queue_entry = queue_head;
-      if (queue_head == queue_tail)
-        queue_head = queue_tail = NULL;
+      queue_entry = shard->queue_head;
+      if (shard->queue_head == shard->queue_tail)
+        shard->queue_head = shard->queue_tail = NULL;
       else
-        queue_head = queue_head->next;
+        shard->queue_head = shard->queue_head->next;
     }
 
     /* Unlock the queue again */
-    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_unlock(&shard->lock);
 
     /* We now need the cache lock so the entry isn't updated while
      * we make a copy of its values */
     pthread_mutex_lock(&cache_lock);
 
-    status = c_avl_get(cache, queue_entry->filename, (void *)&cache_entry);
+    status = c_btree_get(cache, queue_entry->filename, (void *)&cache_entry);
 
     if (status == 0) {
       values = cache_entry->values;
@@ -389,11 +466,11 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
     }
 
     /* Update `tv_next_update' */
-    if (write_rate > 0.0) {
+    if (delay > 0.0) {
       gettimeofday(&tv_now, /* timezone = */ NULL);
       tv_next_update.tv_sec = tv_now.tv_sec;
       tv_next_update.tv_usec =
-          tv_now.tv_usec + ((suseconds_t)(1000000 * write_rate));
+          tv_now.tv_usec + ((suseconds_t)(1000000 * delay));
       while (tv_next_update.tv_usec > 1000000) {
         tv_next_update.tv_sec++;
         tv_next_update.tv_usec -= 1000000;
@@ -401,13 +478,19 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
     }
 
     /* Write the values to the RRD-file */
-    srrd_update(queue_entry->filename, NULL, values_num, (const char **)values);
-    DEBUG("rrdtool plugin: queue thread: Wrote %i value%s to %s", values_num,
-          (values_num == 1) ? "" : "s", queue_entry->filename);
-
-    for (int i = 0; i < values_num; i++) {
-      sfree(values[i]);
+    char **argv = (values_num > 0) ? rrd_values_format(values, values_num)
+                                   : NULL;
+    if (argv != NULL) {
+      srrd_update(queue_entry->filename, NULL, values_num,
+                  (const char **)argv);
+      DEBUG("rrdtool plugin: queue thread: Wrote %i value%s to %s",
+            values_num, (values_num == 1) ? "" : "s", queue_entry->filename);
+    } else if (values_num > 0) {
+      ERROR("rrdtool plugin: queue thread: Dropping %i value%s of %s.",
+            values_num, (values_num == 1) ? "" : "s", queue_entry->filename);
     }
+
+    sfree(argv);
     sfree(values);
     sfree(queue_entry->filename);
     sfree(queue_entry);
@@ -417,8 +500,24 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
   return (void *)0;
 } /* void *rrd_queue_thread */
 
-static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+static rrd_queue_shard_t *rrd_queue_shard(const char *filename) {
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (const char *ptr = filename; *ptr != 0; ptr++) {
+    hash ^= (uint32_t)(unsigned char)*ptr;
+    hash *= 16777619u;
+  }
+
+  return queue_shards + (hash % queue_shards_num);
+} /* rrd_queue_shard_t *rrd_queue_shard */
+
+/* rrd_queue_enqueue appends "filename" to the regular queue or, if "flush" is
+ * true, to the flush queue of the file's shard. */
+static int rrd_queue_enqueue(const char *filename, bool flush) {
+  if (queue_shards_num == 0)
+    return -1;
+
+  rrd_queue_shard_t *shard = rrd_queue_shard(filename);
   rrd_queue_t *queue_entry;
 
   queue_entry = malloc(sizeof(*queue_entry));
@@ -433,7 +532,10 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
 
   queue_entry->next = NULL;
 
-  pthread_mutex_lock(&queue_lock);
+  pthread_mutex_lock(&shard->lock);
+
+  rrd_queue_t **head = flush ? &shard->flushq_head : &shard->queue_head;
+  rrd_queue_t **tail = flush ? &shard->flushq_tail : &shard->queue_tail;
 
   if (*tail == NULL)
     *head = queue_entry;
@@ -441,21 +543,25 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
     (*tail)->next = queue_entry;
   *tail = queue_entry;
 
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
+  pthread_cond_signal(&shard->cond);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* int rrd_queue_enqueue */
 
-static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+/* rrd_queue_dequeue removes "filename" from the regular queue of its shard. */
+static int rrd_queue_dequeue(const char *filename) {
+  if (queue_shards_num == 0)
+    return -1;
+
+  rrd_queue_shard_t *shard = rrd_queue_shard(filename);
   rrd_queue_t *this;
   rrd_queue_t *prev;
 
-  pthread_mutex_lock(&queue_lock);
+  pthread_mutex_lock(&shard->lock);
 
   prev = NULL;
-  this = *head;
+  this = shard->queue_head;
 
   while (this != NULL) {
     if (strcmp(this->filename, filename) == 0)
@@ -466,19 +572,19 @@ static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
   }
 
   if (this == NULL) {
-    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -1;
   }
 
   if (prev == NULL)
-    *head = this->next;
+    shard->queue_head = this->next;
   else
     prev->next = this->next;
 
   if (this->next == NULL)
-    *tail = prev;
+    shard->queue_tail = prev;
 
-  pthread_mutex_unlock(&queue_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   sfree(this->filename);
   sfree(this);
@@ -486,67 +592,95 @@ static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
   return 0;
 } /* int rrd_queue_dequeue */
 
+static int rrd_flush_index_compare(const void *a, const void *b) {
+  cdtime_t ta = ((rrd_cache_t const *)a)->flush_check;
+  cdtime_t tb = ((rrd_cache_t const *)b)->flush_check;
+
+  if (ta < tb)
+    return -1;
+  else if (ta > tb)
+    return 1;
+  return 0;
+} /* int rrd_flush_index_compare */
+
 /* XXX: You must hold "cache_lock" when calling this function! */
 static void rrd_cache_flush(cdtime_t timeout) {
   rrd_cache_t *rc;
   cdtime_t now;
 
-  char **keys = NULL;
-  int keys_num = 0;
-
-  char *key;
-  c_avl_iterator_t *iter;
+  /* Entries that have been looked at when flushing everything. They are put
+   * back into the index when done, so that each entry is only seen once. */
+  rrd_cache_t **checked = NULL;
+  size_t checked_num = 0;
+  size_t checked_size = 0;
 
   DEBUG("rrdtool plugin: Flushing cache, timeout = %.3f",
         CDTIME_T_TO_DOUBLE(timeout));
 
   now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  iter = c_avl_get_iterator(cache);
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&rc) == 0) {
-    if (rc->flags != FLAG_NONE)
-      continue;
+  if (flush_index == NULL)
+    return;
+
+  /* Entries are looked at in the order of "flush_check". Entries that are not
+   * due yet, or that are queued already, are put back with a later
+   * "flush_check". */
+  while ((rc = c_heap_peek_root(flush_index)) != NULL) {
     /* timeout == 0  =>  flush everything */
-    else if ((timeout != 0) && ((now - rc->first_value) < timeout))
-      continue;
-    else if (rc->values_num > 0) {
-      int status;
+    if ((timeout != 0) && ((now - rc->flush_check) < timeout))
+      break;
 
-      status = rrd_queue_enqueue(key, &queue_head, &queue_tail);
-      if (status == 0)
-        rc->flags = FLAG_QUEUED;
-    } else /* ancient and no values -> waste of memory */
-    {
-      char **tmp = realloc(keys, (keys_num + 1) * sizeof(char *));
+    if ((timeout == 0) && (checked_num == checked_size)) {
+      size_t new_size = (checked_size == 0) ? 64 : 2 * checked_size;
+      rrd_cache_t **tmp = realloc(checked, new_size * sizeof(*checked));
       if (tmp == NULL) {
         ERROR("rrdtool plugin: realloc failed: %s", STRERRNO);
-        c_avl_iterator_destroy(iter);
-        sfree(keys);
-        return;
+        break;
       }
-      keys = tmp;
-      keys[keys_num] = key;
-      keys_num++;
+      checked = tmp;
+      checked_size = new_size;
     }
-  } /* while (c_avl_iterator_next) */
-  c_avl_iterator_destroy(iter);
 
-  for (int i = 0; i < keys_num; i++) {
-    if (c_avl_remove(cache, keys[i], (void *)&key, (void *)&rc) != 0) {
-      DEBUG("rrdtool plugin: c_avl_remove (%s) failed.", keys[i]);
-      continue;
+    c_heap_get_root(flush_index);
+
+    bool due = (timeout == 0) || ((now - rc->first_value) >= timeout);
+    if ((rc->flags == FLAG_NONE) && due) {
+      if (rc->values_num > 0) {
+        if (rrd_queue_enqueue(rc->filename, /* flush = */ false) == 0)
+          rc->flags = FLAG_QUEUED;
+      } else /* ancient and no values -> waste of memory */
+      {
+        char *key = NULL;
+        if (c_btree_remove(cache, rc->filename, (void *)&key, NULL) != 0) {
+          DEBUG("rrdtool plugin: c_btree_remove (%s) failed.", rc->filename);
+          continue;
+        }
+
+        assert(rc->values == NULL);
+        sfree(rc);
+        sfree(key);
+        continue;
+      }
     }
 
-    assert(rc->values == NULL);
-    assert(rc->values_num == 0);
+    if ((rc->flags == FLAG_NONE) && !due)
+      rc->flush_check = rc->first_value;
+    else
+      rc->flush_check = now;
 
-    sfree(rc);
-    sfree(key);
-    keys[i] = NULL;
-  } /* for (i = 0..keys_num) */
+    if (timeout == 0) {
+      checked[checked_num] = rc;
+      checked_num++;
+    } else if (c_heap_insert(flush_index, rc) != 0) {
+      ERROR("rrdtool plugin: c_heap_insert (%s) failed.", rc->filename);
+    }
+  } /* while (c_heap_peek_root) */
 
-  sfree(keys);
+  for (size_t i = 0; i < checked_num; i++) {
+    if (c_heap_insert(flush_index, checked[i]) != 0)
+      ERROR("rrdtool plugin: c_heap_insert (%s) failed.", checked[i]->filename);
+  }
+  sfree(checked);
 
   cache_flush_last = now;
 } /* void rrd_cache_flush */
@@ -571,10 +705,10 @@ static int rrd_cache_flush_identifier(cdtime_t timeout,
     snprintf(key, sizeof(key), "%s/%s.rrd", datadir, identifier);
   key[sizeof(key) - 1] = '\0';
 
-  status = c_avl_get(cache, key, (void *)&rc);
+  status = c_btree_get(cache, key, (void *)&rc);
   if (status != 0) {
     INFO("rrdtool plugin: rrd_cache_flush_identifier: "
-         "c_avl_get (%s) failed. Does that file really exist?",
+         "c_btree_get (%s) failed. Does that file really exist?",
          key);
     return status;
   }
@@ -582,14 +716,14 @@ static int rrd_cache_flush_identifier(cdtime_t timeout,
   if (rc->flags == FLAG_FLUSHQ) {
     status = 0;
   } else if (rc->flags == FLAG_QUEUED) {
-    rrd_queue_dequeue(key, &queue_head, &queue_tail);
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    rrd_queue_dequeue(key);
+    status = rrd_queue_enqueue(key, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   } else if ((now - rc->first_value) < timeout) {
     status = 0;
   } else if (rc->values_num > 0) {
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    status = rrd_queue_enqueue(key, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   }
@@ -604,11 +738,11 @@ static int64_t rrd_get_random_variation(void) {
   return (int64_t)cdrand_range(-random_timeout, random_timeout);
 } /* int64_t rrd_get_random_variation */
 
-static int rrd_cache_insert(const char *filename, const char *value,
-                            cdtime_t value_time) {
+static int rrd_cache_insert(const char *filename, const data_set_t *ds,
+                            const value_list_t *vl) {
+  cdtime_t value_time = vl->time;
   rrd_cache_t *rc = NULL;
   int new_rc = 0;
-  char **values_new;
 
   pthread_mutex_lock(&cache_lock);
 
@@ -620,7 +754,7 @@ static int rrd_cache_insert(const char *filename, const char *value,
     return -1;
   }
 
-  int status = c_avl_get(cache, filename, (void *)&rc);
+  int status = c_btree_get(cache, filename, (void *)&rc);
   if ((status != 0) || (rc == NULL)) {
     rc = malloc(sizeof(*rc));
     if (rc == NULL) {
@@ -628,12 +762,14 @@ static int rrd_cache_insert(const char *filename, const char *value,
       pthread_mutex_unlock(&cache_lock);
       return -1;
     }
+    rc->filename = NULL;
     rc->values_num = 0;
     rc->values = NULL;
     rc->first_value = 0;
     rc->last_value = 0;
     rc->random_variation = rrd_get_random_variation();
     rc->flags = FLAG_NONE;
+    rc->flush_check = 0;
     new_rc = 1;
   }
 
@@ -646,26 +782,23 @@ static int rrd_cache_insert(const char *filename, const char *value,
     return -1;
   }
 
-  values_new =
-      realloc((void *)rc->values, (rc->values_num + 1) * sizeof(char *));
-  if (values_new == NULL) {
-    void *cache_key = NULL;
-
-    c_avl_remove(cache, filename, &cache_key, NULL);
+  status = rrd_values_append(&rc->values, (size_t)rc->values_num, ds, vl);
+  if (status != 0) {
     pthread_mutex_unlock(&cache_lock);
 
-    ERROR("rrdtool plugin: realloc failed: %s", STRERRNO);
+    ERROR("rrdtool plugin: Appending values to the cache entry of %s failed "
+          "with status %i.",
+          filename, status);
 
-    sfree(cache_key);
-    sfree(rc->values);
-    sfree(rc);
+    /* Existing entries are kept in the cache and the flush index; only the
+     * new value is lost. */
+    if (new_rc) {
+      sfree(rc->values);
+      sfree(rc);
+    }
     return -1;
   }
-  rc->values = values_new;
-
-  rc->values[rc->values_num] = strdup(value);
-  if (rc->values[rc->values_num] != NULL)
-    rc->values_num++;
+  rc->values_num++;
 
   if (rc->values_num == 1)
     rc->first_value = value_time;
@@ -673,20 +806,26 @@ static int rrd_cache_insert(const char *filename, const char *value,
 
   /* Insert if this is the first value */
   if (new_rc == 1) {
-    void *cache_key = strdup(filename);
+    char *cache_key = strdup(filename);
 
     if (cache_key == NULL) {
       pthread_mutex_unlock(&cache_lock);
 
       ERROR("rrdtool plugin: strdup failed: %s", STRERRNO);
 
-      sfree(rc->values[0]);
       sfree(rc->values);
       sfree(rc);
       return -1;
     }
 
-    c_avl_insert(cache, cache_key, rc);
+    rc->filename = cache_key;
+    rc->flush_check = rc->first_value;
+    c_btree_insert(cache, cache_key, rc);
+
+    /* Entries missing from the index are still written when new values
+     * arrive, they are just never removed from the cache. */
+    if (c_heap_insert(flush_index, rc) != 0)
+      ERROR("rrdtool plugin: c_heap_insert (%s) failed.", filename);
   }
 
   DEBUG("rrdtool plugin: rrd_cache_insert: file = %s; "
@@ -696,12 +835,12 @@ static int rrd_cache_insert(const char *filename, const char *value,
 
   if ((rc->last_value - rc->first_value) >=
       (cache_timeout + rc->random_variation)) {
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
+    /* XXX: If you need to lock both, cache_lock and a shard's queue lock, at
      * the same time, ALWAYS lock `cache_lock' first! */
     if (rc->flags == FLAG_NONE) {
       int status;
 
-      status = rrd_queue_enqueue(filename, &queue_head, &queue_tail);
+      status = rrd_queue_enqueue(filename, /* flush = */ false);
       if (status == 0)
         rc->flags = FLAG_QUEUED;
 
@@ -734,7 +873,7 @@ static int rrd_cache_destroy(void) /* {{{ */
     return 0;
   }
 
-  while (c_avl_pick(cache, &key, &value) == 0) {
+  while (c_btree_pick(cache, &key, &value) == 0) {
     rrd_cache_t *rc;
 
     sfree(key);
@@ -746,14 +885,14 @@ static int rrd_cache_destroy(void) /* {{{ */
     if (rc->values_num > 0)
       non_empty++;
 
-    for (int i = 0; i < rc->values_num; i++)
-      sfree(rc->values[i]);
     sfree(rc->values);
     sfree(rc);
   }
 
-  c_avl_destroy(cache);
+  c_btree_destroy(cache);
   cache = NULL;
+  c_heap_destroy(flush_index);
+  flush_index = NULL;
 
   if (non_empty > 0) {
     INFO("rrdtool plugin: %i cache %s had values when destroying the cache.",
@@ -796,9 +935,8 @@ static int rrd_write(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  char values[32 * (ds->ds_num + 1)];
-  if (value_list_to_string(values, sizeof(values), ds, vl) != 0) {
-    ERROR("rrdtool plugin: failed to build values string");
+  if (rrd_values_check(ds) != 0) {
+    ERROR("rrdtool plugin: unknown data source type in data set %s", ds->type);
     return -1;
   }
 
@@ -820,7 +958,7 @@ static int rrd_write(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  return rrd_cache_insert(filename, values, vl->time);
+  return rrd_cache_insert(filename, ds, vl);
 } /* int rrd_write */
 
 static int rrd_flush(cdtime_t timeout, const char *identifier,
@@ -978,6 +1116,24 @@ static int rrd_config(const char *key, const char *value) {
     } else {
       random_timeout = DOUBLE_TO_CDTIME_T(tmp);
     }
+  } else if (strcasecmp("UpdateThreads", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 1) {
+      fprintf(stderr, "rrdtool: `UpdateThreads' must "
+                      "be greater than 0.\n");
+      ERROR("rrdtool: `UpdateThreads' must "
+            "be greater than 0.");
+      return 1;
+    }
+#if !HAVE_THREADSAFE_LIBRRD
+    if (tmp > 1) {
+      WARNING("rrdtool plugin: librrd is not thread-safe. Ignoring "
+              "\"UpdateThreads %i\" and using one thread.",
+              tmp);
+      tmp = 1;
+    }
+#endif
+    update_threads = tmp;
   } else {
     return -1;
   }
@@ -989,26 +1145,39 @@ static int rrd_shutdown(void) {
   rrd_cache_flush(0);
   pthread_mutex_unlock(&cache_lock);
 
-  pthread_mutex_lock(&queue_lock);
-  do_shutdown = 1;
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
+  bool busy = false;
+  for (size_t i = 0; i < queue_shards_num; i++) {
+    rrd_queue_shard_t *shard = queue_shards + i;
 
-  if ((queue_thread_running != 0) &&
-      ((queue_head != NULL) || (flushq_head != NULL))) {
-    INFO("rrdtool plugin: Shutting down the queue thread. "
+    pthread_mutex_lock(&shard->lock);
+    do_shutdown = 1;
+    if ((shard->queue_head != NULL) || (shard->flushq_head != NULL))
+      busy = true;
+    pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  if (busy) {
+    INFO("rrdtool plugin: Shutting down the queue threads. "
          "This may take a while.");
-  } else if (queue_thread_running != 0) {
-    INFO("rrdtool plugin: Shutting down the queue thread.");
+  } else if (queue_shards_num > 0) {
+    INFO("rrdtool plugin: Shutting down the queue threads.");
   }
 
   /* Wait for all the values to be written to disk before returning. */
-  if (queue_thread_running != 0) {
-    pthread_join(queue_thread, NULL);
-    memset(&queue_thread, 0, sizeof(queue_thread));
-    queue_thread_running = 0;
-    DEBUG("rrdtool plugin: queue_thread exited.");
+  for (size_t i = 0; i < queue_shards_num; i++) {
+    rrd_queue_shard_t *shard = queue_shards + i;
+
+    if (shard->thread_running) {
+      pthread_join(shard->thread, NULL);
+      shard->thread_running = false;
+    }
+    pthread_mutex_destroy(&shard->lock);
+    pthread_cond_destroy(&shard->cond);
   }
+  DEBUG("rrdtool plugin: queue threads exited.");
+  sfree(queue_shards);
+  queue_shards_num = 0;
 
   rrd_cache_destroy();
 
@@ -1028,10 +1197,19 @@ static int rrd_init(void) {
   /* Set the cache up */
   pthread_mutex_lock(&cache_lock);
 
-  cache = c_avl_create((int (*)(const void *, const void *))strcmp);
+  cache = c_btree_create((int (*)(const void *, const void *))strcmp);
   if (cache == NULL) {
     pthread_mutex_unlock(&cache_lock);
-    ERROR("rrdtool plugin: c_avl_create failed.");
+    ERROR("rrdtool plugin: c_btree_create failed.");
+    return -1;
+  }
+
+  flush_index = c_heap_create(rrd_flush_index_compare);
+  if (flush_index == NULL) {
+    c_btree_destroy(cache);
+    cache = NULL;
+    pthread_mutex_unlock(&cache_lock);
+    ERROR("rrdtool plugin: c_heap_create failed.");
     return -1;
   }
 
@@ -1057,14 +1235,33 @@ static int rrd_init(void) {
 
   pthread_mutex_unlock(&cache_lock);
 
-  int status =
-      plugin_thread_create(&queue_thread, /* attr = */ NULL, rrd_queue_thread,
-                           /* args = */ NULL, "rrdtool queue");
-  if (status != 0) {
-    ERROR("rrdtool plugin: Cannot create queue-thread.");
+  queue_shards = calloc((size_t)update_threads, sizeof(*queue_shards));
+  if (queue_shards == NULL) {
+    ERROR("rrdtool plugin: calloc failed.");
     return -1;
   }
-  queue_thread_running = 1;
+  queue_shards_num = (size_t)update_threads;
+  for (size_t i = 0; i < queue_shards_num; i++) {
+    pthread_mutex_init(&queue_shards[i].lock, /* attr = */ NULL);
+    pthread_cond_init(&queue_shards[i].cond, /* attr = */ NULL);
+  }
+
+  /* The number of shards is fixed before any thread is started, so that a
+   * file's shard never changes. */
+  for (size_t i = 0; i < queue_shards_num; i++) {
+    rrd_queue_shard_t *shard = queue_shards + i;
+
+    char name[16];
+    snprintf(name, sizeof(name), "rrdtool#%" PRIsz, i);
+
+    int status = plugin_thread_create(&shard->thread, /* attr = */ NULL,
+                                      rrd_queue_thread, shard, name);
+    if (status != 0) {
+      ERROR("rrdtool plugin: Cannot create queue-thread.");
+      return -1;
+    }
+    shard->thread_running = true;
+  }
 
   DEBUG("rrdtool plugin: rrd_init: datadir = %s; stepsize = %lu;"
         " heartbeat = %i; rrarows = %i; xff = %lf;",
@@ -47,8 +47,9 @@
 #define SENSORS_API_VERSION 0x000
 #endif
 
-static const char *config_keys[] = {"Sensor", "IgnoreSelected",
-                                    "SensorConfigFile", "UseLabels"};
+static const char *config_keys[] = {"Sensor",      "IgnoreSelected",
+                                    "SensorConfigFile", "UseLabels",
+                                    "ReadThreads", "Timeout"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 #if SENSORS_API_VERSION < 0x400
@@ -80,6 +81,17 @@ static bool use_labels;
 static featurelist_t *first_feature;
 static ignorelist_t *sensor_list;
 
+static int read_threads = 4;
+static cdtime_t read_timeout;
+static plugin_fanout_t *fanout;
+
+/* The features of one chip, read by one of the fan-out threads. The features
+ * of a chip are adjacent in the list. */
+typedef struct {
+  const featurelist_t *first;
+  const featurelist_t *end;
+} sensors_chip_t;
+
 static int sensors_config(const char *key, const char *value) {
   if (sensor_list == NULL)
     sensor_list = ignorelist_create(1);
@@ -104,6 +116,22 @@ static int sensors_config(const char *key, const char *value) {
     if (IS_TRUE(value))
       ignorelist_set_invert(sensor_list, 0);
   }
+  else if (strcasecmp(key, "ReadThreads") == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("sensors plugin: The \"ReadThreads\" option must not be "
+            "negative.");
+      return 1;
+    }
+    read_threads = tmp;
+  } else if (strcasecmp(key, "Timeout") == 0) {
+    double tmp = atof(value);
+    if (tmp <= 0.0) {
+      ERROR("sensors plugin: The \"Timeout\" option must be positive.");
+      return 1;
+    }
+    read_timeout = DOUBLE_TO_CDTIME_T(tmp);
+  }
 #if (SENSORS_API_VERSION >= 0x400)
   else if (strcasecmp(key, "UseLabels") == 0) {
     use_labels = IS_TRUE(value);
@@ -307,8 +335,28 @@ static int sensors_load_conf(void) {
   return 0;
 } /* int sensors_load_conf */
 
+static int c_sensors_init(void) {
+  if ((read_threads > 0) && (fanout == NULL)) {
+    fanout = plugin_fanout_create("sensors", (size_t)read_threads);
+    if (fanout == NULL) {
+      ERROR("sensors plugin: plugin_fanout_create failed.");
+      return -1;
+    }
+  }
+
+  return 0;
+} /* int c_sensors_init */
+
 static int sensors_shutdown(void) {
-  sensors_free_features();
+  int status = plugin_fanout_destroy(fanout);
+  fanout = NULL;
+
+  /* A chip that still hangs uses the features and libsensors' chip list. */
+  if (status == EBUSY)
+    WARNING("sensors plugin: Some chips have not returned yet, not freeing "
+            "the list of features.");
+  else
+    sensors_free_features();
   ignorelist_free(sensor_list);
 
   return 0;
@@ -343,81 +391,118 @@ static void sensors_submit(const char *plugin_instance, const char *type,
   plugin_dispatch_values(&vl);
 } /* void sensors_submit */
 
-static int sensors_read(void) {
-  if (sensors_load_conf() != 0)
-    return -1;
-
+static void sensors_read_feature(const featurelist_t *fl) {
 #if SENSORS_API_VERSION < 0x400
-  for (featurelist_t *fl = first_feature; fl != NULL; fl = fl->next) {
-    double value;
-    int status;
-    char plugin_instance[DATA_MAX_NAME_LEN];
-    char type_instance[DATA_MAX_NAME_LEN];
-
-    status = sensors_get_feature(*fl->chip, fl->data->number, &value);
-    if (status < 0)
-      continue;
+  double value;
+  int status;
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
 
-    status = sensors_snprintf_chip_name(plugin_instance,
-                                        sizeof(plugin_instance), fl->chip);
-    if (status < 0)
-      continue;
+  status = sensors_get_feature(*fl->chip, fl->data->number, &value);
+  if (status < 0)
+    return;
 
-    sstrncpy(type_instance, fl->data->name, sizeof(type_instance));
+  status = sensors_snprintf_chip_name(plugin_instance, sizeof(plugin_instance),
+                                      fl->chip);
+  if (status < 0)
+    return;
+
+  sstrncpy(type_instance, fl->data->name, sizeof(type_instance));
 
-    sensors_submit(plugin_instance, sensor_type_name_map[fl->type],
-                   type_instance, value);
-  } /* for fl = first_feature .. NULL */
+  sensors_submit(plugin_instance, sensor_type_name_map[fl->type],
+                 type_instance, value);
 /* #endif SENSORS_API_VERSION < 0x400 */
 
 #elif (SENSORS_API_VERSION >= 0x400)
-  for (featurelist_t *fl = first_feature; fl != NULL; fl = fl->next) {
-    double value;
-    int status;
-    char plugin_instance[DATA_MAX_NAME_LEN];
-    char type_instance[DATA_MAX_NAME_LEN];
-    char *sensor_label;
-    const char *type;
-
-    status = sensors_get_value(fl->chip, fl->subfeature->number, &value);
-    if (status < 0)
-      continue;
+  double value;
+  int status;
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
+  char *sensor_label;
+  const char *type;
 
-    status = sensors_snprintf_chip_name(plugin_instance,
-                                        sizeof(plugin_instance), fl->chip);
-    if (status < 0)
-      continue;
+  status = sensors_get_value(fl->chip, fl->subfeature->number, &value);
+  if (status < 0)
+    return;
 
-    if (use_labels) {
-      sensor_label = sensors_get_label(fl->chip, fl->feature);
-      sstrncpy(type_instance, sensor_label, sizeof(type_instance));
-      free(sensor_label);
-    } else {
-      sstrncpy(type_instance, fl->feature->name, sizeof(type_instance));
-    }
+  status = sensors_snprintf_chip_name(plugin_instance, sizeof(plugin_instance),
+                                      fl->chip);
+  if (status < 0)
+    return;
+
+  if (use_labels) {
+    sensor_label = sensors_get_label(fl->chip, fl->feature);
+    sstrncpy(type_instance, sensor_label, sizeof(type_instance));
+    free(sensor_label);
+  } else {
+    sstrncpy(type_instance, fl->feature->name, sizeof(type_instance));
+  }
 
-    if (fl->feature->type == SENSORS_FEATURE_IN)
-      type = "voltage";
-    else if (fl->feature->type == SENSORS_FEATURE_FAN)
-      type = "fanspeed";
-    else if (fl->feature->type == SENSORS_FEATURE_TEMP)
-      type = "temperature";
-    else if (fl->feature->type == SENSORS_FEATURE_POWER)
-      type = "power";
+  if (fl->feature->type == SENSORS_FEATURE_IN)
+    type = "voltage";
+  else if (fl->feature->type == SENSORS_FEATURE_FAN)
+    type = "fanspeed";
+  else if (fl->feature->type == SENSORS_FEATURE_TEMP)
+    type = "temperature";
+  else if (fl->feature->type == SENSORS_FEATURE_POWER)
+    type = "power";
 #if SENSORS_API_VERSION >= 0x402
-    else if (fl->feature->type == SENSORS_FEATURE_CURR)
-      type = "current";
+  else if (fl->feature->type == SENSORS_FEATURE_CURR)
+    type = "current";
 #endif
 #if SENSORS_API_VERSION >= 0x431
-    else if (fl->feature->type == SENSORS_FEATURE_HUMIDITY)
-      type = "humidity";
+  else if (fl->feature->type == SENSORS_FEATURE_HUMIDITY)
+    type = "humidity";
 #endif
-    else
-      continue;
+  else
+    return;
 
-    sensors_submit(plugin_instance, type, type_instance, value);
-  } /* for fl = first_feature .. NULL */
+  sensors_submit(plugin_instance, type, type_instance, value);
 #endif /* (SENSORS_API_VERSION >= 0x400) */
+} /* void sensors_read_feature */
+
+static void sensors_read_chip(void *arg) {
+  sensors_chip_t *c = arg;
+
+  for (const featurelist_t *fl = c->first; fl != c->end; fl = fl->next)
+    sensors_read_feature(fl);
+} /* void sensors_read_chip */
+
+static int sensors_read(void) {
+  if (sensors_load_conf() != 0)
+    return -1;
+
+  if (fanout == NULL) {
+    for (featurelist_t *fl = first_feature; fl != NULL; fl = fl->next)
+      sensors_read_feature(fl);
+    return 0;
+  }
+
+  /* Each chip is read by its own task, so that a chip that does not respond
+   * only delays its own values. */
+  const featurelist_t *fl = first_feature;
+  while (fl != NULL) {
+    const featurelist_t *end = fl->next;
+    while ((end != NULL) && (end->chip == fl->chip))
+      end = end->next;
+
+    char chip_name[DATA_MAX_NAME_LEN];
+    int status =
+        sensors_snprintf_chip_name(chip_name, sizeof(chip_name), fl->chip);
+    sensors_chip_t *c = malloc(sizeof(*c));
+    if ((status < 0) || (c == NULL)) {
+      sfree(c);
+      fl = end;
+      continue;
+    }
+    c->first = fl;
+    c->end = end;
+
+    plugin_fanout_submit(fanout, chip_name, sensors_read_chip, free, c);
+    fl = end;
+  }
+
+  plugin_fanout_wait(fanout, read_timeout);
 
   return 0;
 } /* int sensors_read */
@@ -425,6 +510,7 @@ static int sensors_read(void) {
 void module_register(void) {
   plugin_register_config("sensors", sensors_config, config_keys,
                          config_keys_num);
+  plugin_register_init("sensors", c_sensors_init);
   plugin_register_read("sensors", sensors_read);
   plugin_register_shutdown("sensors", sensors_shutdown);
 } /* void module_register */
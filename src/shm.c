@@ -0,0 +1,704 @@
+/**
+ * collectd - src/shm.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#define _GNU_SOURCE /* For memfd_create(2) and file sealing */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+
+#include "collectd/shm_ring.h"
+
+#include <grp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * Local processes submit values through rings in shared memory. A client
+ * connects to the plugin's UNIX socket and receives a ring of its own, see
+ * "collectd/shm_ring.h". The ingest thread waits for the doorbells of all
+ * rings and dispatches the records of a ring in batches.
+ */
+
+#define SHM_DEFAULT_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-shm"
+#define SHM_RING_SIZE_DEFAULT (1024 * 1024)
+#define SHM_RING_SIZE_MIN 4096
+#define SHM_RING_SIZE_MAX (1024 * 1024 * 1024)
+#define SHM_PRODUCERS_DEFAULT 64
+#define SHM_IDENTS_MAX 65536
+/* Records dispatched at once. */
+#define SHM_BATCH_SIZE 256
+/* Records read from a ring before the other rings get their turn. */
+#define SHM_DRAIN_BUDGET 4096
+#define SHM_EVENTS_MAX 64
+
+/* epoll data of the listening socket and the stop event; producers use
+ * their slot number shifted by one, with the lowest bit set for the
+ * doorbell. */
+#define SHM_EV_LISTEN UINT64_MAX
+#define SHM_EV_STOP (UINT64_MAX - 1)
+
+/*
+ * Private data types
+ */
+typedef struct {
+  value_list_t vl;
+  /* Zero while the identifier isn't defined. */
+  size_t ds_num;
+} shm_ident_t;
+
+typedef struct {
+  int fd;
+  int doorbell;
+
+  lcc_shm_ring_t *ring;
+  uint8_t *data;
+  size_t map_size;
+  uint64_t size;
+  uint64_t tail;
+
+  /* Identifiers by number. */
+  shm_ident_t *idents;
+  size_t idents_num;
+
+  /* Set if the producer used up its budget, i.e. there is more to read but
+   * the doorbell won't be rung. */
+  bool pending;
+} shm_producer_t;
+
+/*
+ * Private variables
+ */
+static char *sock_file;
+static char *sock_group;
+static int sock_perms = S_IRWXU | S_IRWXG;
+static uint64_t ring_size = SHM_RING_SIZE_DEFAULT;
+static int max_producers = SHM_PRODUCERS_DEFAULT;
+
+static int sock_fd = -1;
+static int epoll_fd = -1;
+static int stop_fd = -1;
+static pthread_t ingest_thread;
+static bool ingest_thread_running;
+
+/* Slots for max_producers producers; NULL if free. */
+static shm_producer_t **producers;
+
+/* The batch of records being dispatched. */
+static value_list_t *vls;
+
+/*
+ * Private functions
+ */
+static int shm_epoll_add(int fd, uint32_t events, uint64_t data) /* {{{ */
+{
+  struct epoll_event ev = {.events = events, .data.u64 = data};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    int status = errno;
+    ERROR("shm plugin: epoll_ctl failed: %s", STRERRNO);
+    return status;
+  }
+  return 0;
+} /* }}} int shm_epoll_add */
+
+static void shm_producer_free(shm_producer_t *p) /* {{{ */
+{
+  if (p == NULL)
+    return;
+
+  if (p->fd >= 0) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p->fd, /* event = */ NULL);
+    close(p->fd);
+  }
+  if (p->doorbell >= 0) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p->doorbell, /* event = */ NULL);
+    close(p->doorbell);
+  }
+  if (p->ring != NULL)
+    munmap(p->ring, p->map_size);
+
+  sfree(p->idents);
+  sfree(p);
+} /* }}} void shm_producer_free */
+
+/* Creates the shared memory of a producer and sends it, along with the
+ * doorbell, to the client connected on "fd". */
+static int shm_producer_setup(shm_producer_t *p) /* {{{ */
+{
+  int mem_fd =
+      memfd_create(PACKAGE_NAME "-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (mem_fd < 0) {
+    ERROR("shm plugin: memfd_create failed: %s", STRERRNO);
+    return -1;
+  }
+
+  size_t data_offset = sizeof(lcc_shm_ring_t);
+  p->map_size = data_offset + (size_t)ring_size;
+
+  /* Sealing the size keeps the client from truncating the memory, which
+   * would make the daemon crash when reading it. */
+  if ((ftruncate(mem_fd, (off_t)p->map_size) != 0) ||
+      (fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) !=
+       0)) {
+    ERROR("shm plugin: Setting up the shared memory failed: %s", STRERRNO);
+    close(mem_fd);
+    return -1;
+  }
+
+  void *map = mmap(NULL, p->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   mem_fd, /* offset = */ 0);
+  if (map == MAP_FAILED) {
+    ERROR("shm plugin: mmap failed: %s", STRERRNO);
+    close(mem_fd);
+    return -1;
+  }
+  p->ring = map;
+  p->data = (uint8_t *)map + data_offset;
+  p->size = ring_size;
+
+  p->ring->magic = LCC_SHM_MAGIC;
+  p->ring->version = LCC_SHM_VERSION;
+  p->ring->data_offset = (uint32_t)data_offset;
+  p->ring->size = ring_size;
+  /* The first record rings the doorbell. */
+  p->ring->waiting = 1;
+
+  p->doorbell = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (p->doorbell < 0) {
+    ERROR("shm plugin: eventfd failed: %s", STRERRNO);
+    close(mem_fd);
+    return -1;
+  }
+
+  lcc_shm_hello_t hello = {
+      .version = LCC_SHM_VERSION, .map_size = (uint64_t)p->map_size,
+  };
+  struct iovec iov = {.iov_base = &hello, .iov_len = sizeof(hello)};
+  union {
+    char buf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control = {{0}};
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), (int[]){mem_fd, p->doorbell}, 2 * sizeof(int));
+
+  ssize_t status = sendmsg(p->fd, &msg, MSG_NOSIGNAL);
+  close(mem_fd);
+  if (status != (ssize_t)sizeof(hello)) {
+    ERROR("shm plugin: Sending the ring to the client failed: %s", STRERRNO);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int shm_producer_setup */
+
+static void shm_accept(void) /* {{{ */
+{
+  int fd = accept4(sock_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      ERROR("shm plugin: accept failed: %s", STRERRNO);
+    return;
+  }
+
+  int slot = 0;
+  while ((slot < max_producers) && (producers[slot] != NULL))
+    slot++;
+  if (slot >= max_producers) {
+    WARNING("shm plugin: Too many producers, closing a new connection.");
+    close(fd);
+    return;
+  }
+
+  shm_producer_t *p = calloc(1, sizeof(*p));
+  if (p == NULL) {
+    ERROR("shm plugin: calloc failed.");
+    close(fd);
+    return;
+  }
+  p->fd = fd;
+  p->doorbell = -1;
+
+  uint64_t data = ((uint64_t)slot) << 1;
+  if ((shm_producer_setup(p) != 0) ||
+      (shm_epoll_add(p->fd, EPOLLIN | EPOLLRDHUP, data) != 0) ||
+      (shm_epoll_add(p->doorbell, EPOLLIN, data | 1) != 0)) {
+    shm_producer_free(p);
+    return;
+  }
+
+  DEBUG("shm plugin: Producer #%i connected on fd #%i.", slot, fd);
+  producers[slot] = p;
+} /* }}} void shm_accept */
+
+static void shm_define(shm_producer_t *p, lcc_shm_record_t const *r, /* {{{ */
+                       uint8_t const *payload, size_t payload_len) {
+  if (r->id >= SHM_IDENTS_MAX) {
+    ERROR("shm plugin: Identifier #%" PRIu32 " exceeds the limit of %d.",
+          r->id, SHM_IDENTS_MAX);
+    return;
+  }
+
+  if (memchr(payload, 0, payload_len) == NULL) {
+    ERROR("shm plugin: Identifier #%" PRIu32 " is not terminated.", r->id);
+    return;
+  }
+
+  if (r->id >= p->idents_num) {
+    size_t num = (size_t)r->id + 1;
+    if (num < 2 * p->idents_num)
+      num = 2 * p->idents_num;
+    if (num > SHM_IDENTS_MAX)
+      num = SHM_IDENTS_MAX;
+
+    shm_ident_t *tmp = realloc(p->idents, num * sizeof(*tmp));
+    if (tmp == NULL) {
+      ERROR("shm plugin: realloc failed.");
+      return;
+    }
+    memset(tmp + p->idents_num, 0, (num - p->idents_num) * sizeof(*tmp));
+    p->idents = tmp;
+    p->idents_num = num;
+  }
+
+  shm_ident_t *ident = p->idents + r->id;
+  ident->ds_num = 0;
+  memset(&ident->vl, 0, sizeof(ident->vl));
+
+  char const *name = (char const *)payload;
+  if (parse_identifier_vl(name, &ident->vl) != 0) {
+    ERROR("shm plugin: Cannot parse identifier \"%s\".", name);
+    return;
+  }
+
+  data_set_t const *ds = plugin_get_ds(ident->vl.type);
+  if (ds == NULL) {
+    ERROR("shm plugin: Unknown type \"%s\" in identifier \"%s\".",
+          ident->vl.type, name);
+    return;
+  }
+  ident->ds_num = ds->ds_num;
+} /* }}} void shm_define */
+
+/* Reads up to "budget" records, or all of them if "budget" is zero. Returns
+ * non-zero if the ring is corrupt. */
+static int shm_drain(shm_producer_t *p, size_t budget) /* {{{ */
+{
+  uint64_t head = __atomic_load_n(&p->ring->head, __ATOMIC_ACQUIRE);
+  if (head - p->tail > p->size) {
+    ERROR("shm plugin: Invalid head position %" PRIu64 ".", head);
+    return -1;
+  }
+
+  size_t num = 0;
+  size_t read = 0;
+  cdtime_t now = 0;
+  int status = 0;
+
+  while (p->tail != head) {
+    if ((budget > 0) && (read >= budget))
+      break;
+
+    uint64_t offset = p->tail & (p->size - 1);
+    uint64_t left = p->size - offset;
+
+    if (left < sizeof(lcc_shm_record_t)) {
+      if (head - p->tail < left) {
+        status = -1;
+        break;
+      }
+      p->tail += left;
+      continue;
+    }
+
+    /* The producer could change the record while it's read, so its header
+     * is copied and checked once. */
+    lcc_shm_record_t r;
+    memcpy(&r, p->data + offset, sizeof(r));
+    if ((r.len < sizeof(r)) || ((r.len % 8) != 0) || (r.len > left) ||
+        (r.len > head - p->tail)) {
+      status = -1;
+      break;
+    }
+
+    uint8_t const *payload = p->data + offset + sizeof(r);
+    size_t payload_len = r.len - sizeof(r);
+
+    if (r.type == LCC_SHM_RECORD_IDENT) {
+      /* Values read so far refer to the previous definition. */
+      if (num > 0) {
+        plugin_dispatch_values_batch(vls, num);
+        num = 0;
+      }
+      shm_define(p, &r, payload, payload_len);
+    } else if (r.type == LCC_SHM_RECORD_VALUES) {
+      shm_ident_t *ident =
+          (r.id < p->idents_num) ? (p->idents + r.id) : NULL;
+      lcc_shm_values_t v;
+
+      if ((ident == NULL) || (ident->ds_num == 0)) {
+        DEBUG("shm plugin: Ignoring values of undefined identifier #%" PRIu32
+              ".",
+              r.id);
+      } else if ((r.values_num != ident->ds_num) ||
+                 (payload_len < sizeof(v) + r.values_num * sizeof(value_t))) {
+        ERROR("shm plugin: %s: Got %" PRIu16 " values, but the type has %" PRIsz
+              " data sources.",
+              ident->vl.type, r.values_num, ident->ds_num);
+      } else {
+        memcpy(&v, payload, sizeof(v));
+        if ((v.time == 0) && (now == 0))
+          now = cdtime();
+
+        value_list_t *vl = vls + num;
+        *vl = ident->vl;
+        /* Dispatching copies the values, so they are read from the ring. */
+        vl->values = (value_t *)(payload + sizeof(v));
+        vl->values_len = r.values_num;
+        vl->time = (v.time != 0) ? (cdtime_t)v.time : now;
+        vl->interval = (cdtime_t)v.interval;
+        num++;
+      }
+    }
+
+    p->tail += r.len;
+    read++;
+
+    if (num == SHM_BATCH_SIZE) {
+      plugin_dispatch_values_batch(vls, num);
+      num = 0;
+      /* The producer can use the space of the records dispatched. */
+      __atomic_store_n(&p->ring->tail, p->tail, __ATOMIC_RELEASE);
+    }
+  }
+
+  if (num > 0)
+    plugin_dispatch_values_batch(vls, num);
+  __atomic_store_n(&p->ring->tail, p->tail, __ATOMIC_RELEASE);
+
+  if (status != 0)
+    ERROR("shm plugin: Invalid record at position %" PRIu64 ".", p->tail);
+
+  return status;
+} /* }}} int shm_drain */
+
+/* Reads from a ring until it is empty or the budget is used up. In the
+ * former case, the producer is asked to ring the doorbell for the next
+ * record. */
+static int shm_service(shm_producer_t *p) /* {{{ */
+{
+  while (true) {
+    if (shm_drain(p, SHM_DRAIN_BUDGET) != 0)
+      return -1;
+
+    uint64_t head = __atomic_load_n(&p->ring->head, __ATOMIC_ACQUIRE);
+    if (head != p->tail) {
+      p->pending = true;
+      return 0;
+    }
+
+    /* Pairs with the producer publishing "head" before checking "waiting". */
+    __atomic_store_n(&p->ring->waiting, 1, __ATOMIC_SEQ_CST);
+    head = __atomic_load_n(&p->ring->head, __ATOMIC_SEQ_CST);
+    if (head == p->tail) {
+      p->pending = false;
+      return 0;
+    }
+    __atomic_store_n(&p->ring->waiting, 0, __ATOMIC_RELAXED);
+  }
+} /* }}} int shm_service */
+
+static void shm_close(int slot) /* {{{ */
+{
+  shm_producer_t *p = producers[slot];
+
+  /* Read what the producer wrote before disconnecting. */
+  shm_drain(p, /* budget = */ 0);
+
+  DEBUG("shm plugin: Producer #%i disconnected.", slot);
+  shm_producer_free(p);
+  producers[slot] = NULL;
+} /* }}} void shm_close */
+
+static void shm_handle_event(uint64_t data) /* {{{ */
+{
+  int slot = (int)(data >> 1);
+  shm_producer_t *p = producers[slot];
+  if (p == NULL)
+    return;
+
+  if (data & 1) {
+    uint64_t count;
+    if (read(p->doorbell, &count, sizeof(count)) < 0) {
+      if ((errno != EAGAIN) && (errno != EINTR))
+        ERROR("shm plugin: Reading the doorbell failed: %s", STRERRNO);
+    }
+    if (shm_service(p) != 0) {
+      shm_producer_free(p);
+      producers[slot] = NULL;
+    }
+    return;
+  }
+
+  /* Clients don't send anything; the connection is only watched for being
+   * closed. */
+  char buffer[256];
+  ssize_t len = recv(p->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+  if ((len == 0) ||
+      ((len < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+       (errno != EINTR)))
+    shm_close(slot);
+} /* }}} void shm_handle_event */
+
+static void *shm_ingest(void __attribute__((unused)) * arg) /* {{{ */
+{
+  struct epoll_event events[SHM_EVENTS_MAX];
+  bool stop = false;
+
+  while (!stop) {
+    bool pending = false;
+    for (int i = 0; i < max_producers; i++)
+      if ((producers[i] != NULL) && producers[i]->pending)
+        pending = true;
+
+    int num = epoll_wait(epoll_fd, events, SHM_EVENTS_MAX, pending ? 0 : -1);
+    if (num < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("shm plugin: epoll_wait failed: %s", STRERRNO);
+      break;
+    }
+
+    for (int i = 0; i < num; i++) {
+      if (events[i].data.u64 == SHM_EV_STOP)
+        stop = true;
+      else if (events[i].data.u64 == SHM_EV_LISTEN)
+        shm_accept();
+      else
+        shm_handle_event(events[i].data.u64);
+    }
+
+    for (int i = 0; i < max_producers; i++) {
+      shm_producer_t *p = producers[i];
+      if ((p != NULL) && p->pending && (shm_service(p) != 0)) {
+        shm_producer_free(p);
+        producers[i] = NULL;
+      }
+    }
+  }
+
+  for (int i = 0; i < max_producers; i++)
+    if (producers[i] != NULL)
+      shm_close(i);
+
+  return (void *)0;
+} /* }}} void *shm_ingest */
+
+static int shm_open_socket(void) /* {{{ */
+{
+  char const *path = (sock_file != NULL) ? sock_file : SHM_DEFAULT_PATH;
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  sstrncpy(sa.sun_path, path, sizeof(sa.sun_path));
+
+  sock_fd = socket(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (sock_fd < 0) {
+    ERROR("shm plugin: socket failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* A stale socket of a previous run would make bind() fail. */
+  if ((unlink(sa.sun_path) != 0) && (errno != ENOENT))
+    WARNING("shm plugin: Deleting socket file \"%s\" failed: %s", sa.sun_path,
+            STRERRNO);
+
+  if ((bind(sock_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (chmod(sa.sun_path, sock_perms) != 0) || (listen(sock_fd, 8) != 0)) {
+    ERROR("shm plugin: Setting up socket \"%s\" failed: %s", sa.sun_path,
+          STRERRNO);
+    close(sock_fd);
+    sock_fd = -1;
+    return -1;
+  }
+
+  char const *grpname = (sock_group != NULL) ? sock_group : COLLECTD_GRP_NAME;
+  long int grbuf_size = sysconf(_SC_GETGR_R_SIZE_MAX);
+  if (grbuf_size <= 0)
+    grbuf_size = sysconf(_SC_PAGESIZE);
+  if (grbuf_size <= 0)
+    grbuf_size = 4096;
+  char grbuf[grbuf_size];
+  struct group sg;
+  struct group *g = NULL;
+
+  int status = getgrnam_r(grpname, &sg, grbuf, sizeof(grbuf), &g);
+  if (status != 0) {
+    WARNING("shm plugin: getgrnam_r (%s) failed: %s", grpname,
+            STRERROR(status));
+  } else if (g == NULL) {
+    WARNING("shm plugin: No such group: `%s'", grpname);
+  } else if (chown(sa.sun_path, (uid_t)-1, g->gr_gid) != 0) {
+    WARNING("shm plugin: chown (%s, -1, %i) failed: %s", sa.sun_path,
+            (int)g->gr_gid, STRERRNO);
+  }
+
+  return 0;
+} /* }}} int shm_open_socket */
+
+static int shm_config(oconfig_item_t *ci) /* {{{ */
+{
+  int status = 0;
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("SocketFile", child->key) == 0)
+      status = cf_util_get_string(child, &sock_file);
+    else if (strcasecmp("SocketGroup", child->key) == 0)
+      status = cf_util_get_string(child, &sock_group);
+    else if (strcasecmp("SocketPerms", child->key) == 0) {
+      char *perms = NULL;
+      status = cf_util_get_string(child, &perms);
+      if (status == 0)
+        sock_perms = (int)strtol(perms, NULL, 8);
+      sfree(perms);
+    } else if (strcasecmp("RingSize", child->key) == 0) {
+      int size = 0;
+      status = cf_util_get_int(child, &size);
+      if ((status == 0) &&
+          ((size < SHM_RING_SIZE_MIN) || (size > SHM_RING_SIZE_MAX))) {
+        ERROR("shm plugin: RingSize must be between %d and %d.",
+              SHM_RING_SIZE_MIN, SHM_RING_SIZE_MAX);
+        status = -1;
+      } else if (status == 0) {
+        /* Round up to a power of two. */
+        ring_size = SHM_RING_SIZE_MIN;
+        while (ring_size < (uint64_t)size)
+          ring_size *= 2;
+      }
+    } else if (strcasecmp("MaxProducers", child->key) == 0) {
+      status = cf_util_get_int(child, &max_producers);
+      if ((status == 0) && (max_producers < 1)) {
+        ERROR("shm plugin: MaxProducers must be at least 1.");
+        status = -1;
+      }
+    } else {
+      WARNING("shm plugin: Ignoring unknown config option \"%s\".",
+              child->key);
+    }
+
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int shm_config */
+
+static int shm_shutdown(void) /* {{{ */
+{
+  if (ingest_thread_running) {
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0)
+      ERROR("shm plugin: Stopping the ingest thread failed: %s", STRERRNO);
+    pthread_join(ingest_thread, /* retval = */ NULL);
+    ingest_thread_running = false;
+  }
+
+  if (sock_fd >= 0) {
+    close(sock_fd);
+    sock_fd = -1;
+    unlink((sock_file != NULL) ? sock_file : SHM_DEFAULT_PATH);
+  }
+  if (stop_fd >= 0) {
+    close(stop_fd);
+    stop_fd = -1;
+  }
+  if (epoll_fd >= 0) {
+    close(epoll_fd);
+    epoll_fd = -1;
+  }
+
+  sfree(producers);
+  sfree(vls);
+  sfree(sock_file);
+  sfree(sock_group);
+  return 0;
+} /* }}} int shm_shutdown */
+
+static int shm_init(void) /* {{{ */
+{
+  if (ingest_thread_running)
+    return 0;
+
+  producers = calloc((size_t)max_producers, sizeof(*producers));
+  vls = calloc(SHM_BATCH_SIZE, sizeof(*vls));
+  if ((producers == NULL) || (vls == NULL)) {
+    ERROR("shm plugin: calloc failed.");
+    return -1;
+  }
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    ERROR("shm plugin: epoll_create1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (stop_fd < 0) {
+    ERROR("shm plugin: eventfd failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if ((shm_open_socket() != 0) ||
+      (shm_epoll_add(sock_fd, EPOLLIN, SHM_EV_LISTEN) != 0) ||
+      (shm_epoll_add(stop_fd, EPOLLIN, SHM_EV_STOP) != 0))
+    return -1;
+
+  int status = plugin_thread_create(&ingest_thread, /* attr = */ NULL,
+                                    shm_ingest, /* arg = */ NULL, "shm ingest");
+  if (status != 0) {
+    ERROR("shm plugin: pthread_create failed: %s", STRERROR(status));
+    return -1;
+  }
+  ingest_thread_running = true;
+
+  return 0;
+} /* }}} int shm_init */
+
+void module_register(void) {
+  plugin_register_complex_config("shm", shm_config);
+  plugin_register_init("shm", shm_init);
+  plugin_register_shutdown("shm", shm_shutdown);
+} /* void module_register */
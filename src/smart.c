@@ -37,8 +37,9 @@
 #include <sys/capability.h>
 #endif
 
-static const char *config_keys[] = {"Disk", "IgnoreSelected", "IgnoreSleepMode",
-                                    "UseSerial"};
+static const char *config_keys[] = {"Disk",      "IgnoreSelected",
+                                    "IgnoreSleepMode", "UseSerial",
+                                    "ReadThreads",     "Timeout"};
 
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
@@ -46,6 +47,16 @@ static ignorelist_t *ignorelist;
 static int ignore_sleep_mode;
 static int use_serial;
 
+static int read_threads = 4;
+static cdtime_t read_timeout;
+static plugin_fanout_t *fanout;
+
+/* A disk to be read by one of the fan-out threads. */
+typedef struct {
+  char *dev;
+  char *name;
+} smart_disk_t;
+
 static int smart_config(const char *key, const char *value) {
   if (ignorelist == NULL)
     ignorelist = ignorelist_create(/* invert = */ 1);
@@ -65,6 +76,20 @@ static int smart_config(const char *key, const char *value) {
   } else if (strcasecmp("UseSerial", key) == 0) {
     if (IS_TRUE(value))
       use_serial = 1;
+  } else if (strcasecmp("ReadThreads", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("smart plugin: The \"ReadThreads\" option must not be negative.");
+      return 1;
+    }
+    read_threads = tmp;
+  } else if (strcasecmp("Timeout", key) == 0) {
+    double tmp = atof(value);
+    if (tmp <= 0.0) {
+      ERROR("smart plugin: The \"Timeout\" option must be positive.");
+      return 1;
+    }
+    read_timeout = DOUBLE_TO_CDTIME_T(tmp);
   } else {
     return -1;
   }
@@ -180,10 +205,39 @@ static void smart_read_disk(SkDisk *d, char const *name) {
   }
 }
 
-static void smart_handle_disk(const char *dev, const char *serial) {
+static void smart_open_disk(const char *dev, const char *name) {
   SkDisk *d = NULL;
+
+  DEBUG("smart plugin: checking SMART status of %s.", dev);
+  if (sk_disk_open(dev, &d) < 0) {
+    ERROR("smart plugin: unable to open %s.", dev);
+    return;
+  }
+
+  smart_read_disk(d, name);
+  sk_disk_free(d);
+}
+
+static void smart_disk_read(void *arg) {
+  smart_disk_t *disk = arg;
+  smart_open_disk(disk->dev, disk->name);
+}
+
+static void smart_disk_free(void *arg) {
+  smart_disk_t *disk = arg;
+  if (disk == NULL)
+    return;
+  sfree(disk->dev);
+  sfree(disk->name);
+  sfree(disk);
+}
+
+static void smart_handle_disk(const char *dev, const char *serial) {
   const char *name;
 
+  if (dev == NULL)
+    return;
+
   if (use_serial && serial) {
     name = serial;
   } else {
@@ -197,14 +251,27 @@ static void smart_handle_disk(const char *dev, const char *serial) {
     return;
   }
 
-  DEBUG("smart plugin: checking SMART status of %s.", dev);
-  if (sk_disk_open(dev, &d) < 0) {
-    ERROR("smart plugin: unable to open %s.", dev);
+  if (fanout == NULL) {
+    smart_open_disk(dev, name);
     return;
   }
 
-  smart_read_disk(d, name);
-  sk_disk_free(d);
+  /* Each disk is read by its own task, so that a disk that does not respond
+   * only delays its own values. */
+  smart_disk_t *disk = calloc(1, sizeof(*disk));
+  if (disk == NULL) {
+    ERROR("smart plugin: calloc failed.");
+    return;
+  }
+  disk->dev = strdup(dev);
+  disk->name = strdup(name);
+  if ((disk->dev == NULL) || (disk->name == NULL)) {
+    ERROR("smart plugin: strdup failed.");
+    smart_disk_free(disk);
+    return;
+  }
+
+  plugin_fanout_submit(fanout, dev, smart_disk_read, smart_disk_free, disk);
 }
 
 static int smart_read(void) {
@@ -236,6 +303,9 @@ static int smart_read(void) {
     udev_device_unref(dev);
   }
 
+  if (fanout != NULL)
+    plugin_fanout_wait(fanout, read_timeout);
+
   udev_enumerate_unref(enumerate);
   udev_unref(handle_udev);
 
@@ -256,11 +326,28 @@ static int smart_init(void) {
               "running \"setcap cap_sys_rawio=ep\" on the collectd binary.");
   }
 #endif
+
+  if ((read_threads > 0) && (fanout == NULL)) {
+    fanout = plugin_fanout_create("smart", (size_t)read_threads);
+    if (fanout == NULL) {
+      ERROR("smart plugin: plugin_fanout_create failed.");
+      return -1;
+    }
+  }
+
   return 0;
 } /* int smart_init */
 
+static int smart_shutdown(void) {
+  plugin_fanout_destroy(fanout);
+  fanout = NULL;
+
+  return 0;
+} /* int smart_shutdown */
+
 void module_register(void) {
   plugin_register_config("smart", smart_config, config_keys, config_keys_num);
   plugin_register_init("smart", smart_init);
   plugin_register_read("smart", smart_read);
+  plugin_register_shutdown("smart", smart_shutdown);
 } /* void module_register */
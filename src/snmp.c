@@ -74,6 +74,28 @@ struct data_definition_s {
 };
 typedef struct data_definition_s data_definition_t;
 
+/* Cells of table walks are allocated from large blocks, which are reused by
+ * the next walk instead of freeing every cell on its own. */
+struct csnmp_arena_block_s {
+  struct csnmp_arena_block_s *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+typedef struct csnmp_arena_block_s csnmp_arena_block_t;
+
+struct csnmp_arena_s {
+  csnmp_arena_block_t *head;
+  csnmp_arena_block_t *current;
+};
+typedef struct csnmp_arena_s csnmp_arena_t;
+
+#define CSNMP_ARENA_BLOCK_SIZE (256 * 1024)
+
+/* Maximum number of table rows passed to plugin_dispatch_values_batch at
+ * once. */
+#define CSNMP_DISPATCH_BATCH 32
+
 struct host_definition_s {
   char *name;
   char *address;
@@ -95,10 +117,31 @@ struct host_definition_s {
   int security_level;
   char *context;
 
+  /* If greater than zero, tables are read with GETBULK requests. */
+  int max_repetitions;
+  /* If greater than zero, instance columns are only read this often. */
+  cdtime_t instance_interval;
+  /* One cache per entry of "data_list", allocated on first use. */
+  struct csnmp_instance_cache_s *instance_cache;
+  /* Cells of the current table walk. Reset after each walk. */
+  csnmp_arena_t arena;
+
   void *sess_handle;
   c_complain_t complaint;
   data_definition_t **data_list;
   int data_list_len;
+
+  /* State of the asynchronous poll. While "poll_busy" is set, the poll and
+   * the session belong to the engine thread. */
+  size_t engine_idx;
+  struct csnmp_engine_s *engine;
+  bool poll_busy;
+  plugin_ctx_t poll_ctx;
+  int poll_data_idx;
+  int poll_pending;
+  bool poll_failed;
+  struct csnmp_walk_s *poll_walk;
+  struct host_definition_s *poll_next;
 };
 typedef struct host_definition_s host_definition_t;
 
@@ -127,15 +170,90 @@ typedef enum {
   OID_TYPE_FILTER,
 } csnmp_oid_type_t;
 
+/* Instance cells of a table, kept for `InstanceInterval'. */
+struct csnmp_instance_cache_s {
+  csnmp_arena_t arena;
+  cdtime_t last_refresh;
+  csnmp_cell_char_t *type_instance_cells;
+  csnmp_cell_char_t *plugin_instance_cells;
+  csnmp_cell_char_t *hostname_cells;
+};
+typedef struct csnmp_instance_cache_s csnmp_instance_cache_t;
+
+/* State of a table walk. `csnmp_walk_request' creates the next request and
+ * `csnmp_walk_response' processes its response, so that tables can be read
+ * with both synchronous and asynchronous requests. */
+struct csnmp_walk_s {
+  host_definition_t *host;
+  data_definition_t *data;
+  const data_set_t *ds;
+  size_t values_len;
+
+  size_t oid_list_len;
+  /* Holds the last OID returned by the device. We use this in the GETNEXT
+   * request to proceed. */
+  oid_t *oid_list;
+  /* Set to false when an OID has left its subtree so we don't re-request it
+   * again. */
+  csnmp_oid_type_t *oid_list_todo;
+  /* Index in "oid_list" of each variable of the last request. */
+  size_t *var_idx;
+  size_t var_num;
+
+  /* Instance cells are taken from, or refreshed into, "cache" if the host
+   * has an `InstanceInterval'. */
+  csnmp_instance_cache_t *cache;
+  bool cache_refresh;
+  csnmp_arena_t *instance_arena;
+
+  /* `value_list_head' and `value_cells_tail' implement a linked list for each
+   * value. `instance_cells_head' and `instance_cells_tail' implement a linked
+   * list of instance names. This is used to jump gaps in the table. */
+  csnmp_cell_char_t *type_instance_cells_head;
+  csnmp_cell_char_t *type_instance_cells_tail;
+  csnmp_cell_char_t *plugin_instance_cells_head;
+  csnmp_cell_char_t *plugin_instance_cells_tail;
+  csnmp_cell_char_t *hostname_cells_head;
+  csnmp_cell_char_t *hostname_cells_tail;
+  csnmp_cell_char_t *filter_cells_head;
+  csnmp_cell_char_t *filter_cells_tail;
+  csnmp_cell_value_t **value_cells_head;
+  csnmp_cell_value_t **value_cells_tail;
+};
+typedef struct csnmp_walk_s csnmp_walk_t;
+
+struct csnmp_engine_s {
+  pthread_t thread;
+  bool thread_running;
+  /* Written to by `csnmp_engine_submit' to interrupt select(2). */
+  int wakeup[2];
+
+  pthread_mutex_t lock;
+  bool shutdown;
+  /* Hosts submitted by the read callbacks. */
+  host_definition_t *pending;
+
+  /* Owned by the engine thread. */
+  host_definition_t *active;
+  host_definition_t *pending_aborted;
+};
+typedef struct csnmp_engine_s csnmp_engine_t;
+
 /*
  * Private variables
  */
 static data_definition_t *data_head;
 
+static int poll_threads;
+static size_t hosts_num;
+static csnmp_engine_t *engines;
+static size_t engines_num;
+
 /*
  * Prototypes
  */
 static int csnmp_read_host(user_data_t *ud);
+static void csnmp_engine_stop(void);
 
 /*
  * Private functions
@@ -178,6 +296,53 @@ static int csnmp_oid_to_string(char *buffer, size_t buffer_size,
   return strjoin(buffer, buffer_size, oid_str_ptr, o->oid_len, ".");
 }
 
+/* Returns zeroed memory which remains valid until the arena is reset. */
+static void *csnmp_arena_alloc(csnmp_arena_t *a, size_t size) /* {{{ */
+{
+  /* Keep the cells aligned for their oid and value_t members. */
+  size = (size + 15) & ~((size_t)15);
+
+  while ((a->current != NULL) &&
+         ((a->current->size - a->current->used) < size))
+    a->current = a->current->next;
+
+  if (a->current == NULL) {
+    size_t block_size =
+        (size > CSNMP_ARENA_BLOCK_SIZE) ? size : CSNMP_ARENA_BLOCK_SIZE;
+    csnmp_arena_block_t *b = malloc(sizeof(*b) + block_size);
+    if (b == NULL)
+      return NULL;
+    b->size = block_size;
+    b->used = 0;
+    b->next = a->head;
+    a->head = b;
+    a->current = b;
+  }
+
+  void *ptr = a->current->data + a->current->used;
+  a->current->used += size;
+  memset(ptr, 0, size);
+  return ptr;
+} /* }}} void *csnmp_arena_alloc */
+
+/* Releases all allocations but keeps the blocks for reuse. */
+static void csnmp_arena_reset(csnmp_arena_t *a) /* {{{ */
+{
+  for (csnmp_arena_block_t *b = a->head; b != NULL; b = b->next)
+    b->used = 0;
+  a->current = a->head;
+} /* }}} void csnmp_arena_reset */
+
+static void csnmp_arena_destroy(csnmp_arena_t *a) /* {{{ */
+{
+  while (a->head != NULL) {
+    csnmp_arena_block_t *next = a->head->next;
+    sfree(a->head);
+    a->head = next;
+  }
+  a->current = NULL;
+} /* }}} void csnmp_arena_destroy */
+
 static void csnmp_host_close_session(host_definition_t *host) /* {{{ */
 {
   if (host->sess_handle == NULL)
@@ -200,8 +365,18 @@ static void csnmp_host_definition_destroy(void *arg) /* {{{ */
     DEBUG("snmp plugin: Destroying host definition for host `%s'.", hd->name);
   }
 
+  /* The read callbacks have been stopped, but the engine threads may still
+   * use this host. */
+  if (engines_num > 0)
+    csnmp_engine_stop();
+
   csnmp_host_close_session(hd);
 
+  csnmp_arena_destroy(&hd->arena);
+  for (int i = 0; (hd->instance_cache != NULL) && (i < hd->data_list_len); i++)
+    csnmp_arena_destroy(&hd->instance_cache[i].arena);
+  sfree(hd->instance_cache);
+
   sfree(hd->name);
   sfree(hd->address);
   sfree(hd->community);
@@ -794,6 +969,10 @@ static int csnmp_config_add_host(oconfig_item_t *ci) {
       status = csnmp_config_add_host_security_level(hd, option);
     else if (strcasecmp("Context", option->key) == 0)
       status = cf_util_get_string(option, &hd->context);
+    else if (strcasecmp("MaxRepetitions", option->key) == 0)
+      status = cf_util_get_int(option, &hd->max_repetitions);
+    else if (strcasecmp("InstanceInterval", option->key) == 0)
+      status = cf_util_get_cdtime(option, &hd->instance_interval);
     else {
       WARNING(
           "snmp plugin: csnmp_config_add_host: Option `%s' not allowed here.",
@@ -806,6 +985,19 @@ static int csnmp_config_add_host(oconfig_item_t *ci) {
   } /* for (ci->children) */
 
   while (status == 0) {
+    if (hd->max_repetitions < 0) {
+      WARNING("snmp plugin: `MaxRepetitions' must not be negative for host "
+              "`%s'",
+              hd->name);
+      status = -1;
+      break;
+    }
+    if ((hd->max_repetitions > 0) && (hd->version == 1)) {
+      WARNING("snmp plugin: host `%s': GETBULK requires SNMPv2c or SNMPv3, "
+              "ignoring `MaxRepetitions'.",
+              hd->name);
+      hd->max_repetitions = 0;
+    }
     if (hd->address == NULL) {
       WARNING("snmp plugin: `Address' not given for host `%s'", hd->name);
       status = -1;
@@ -871,6 +1063,8 @@ static int csnmp_config_add_host(oconfig_item_t *ci) {
         "= %i }",
         hd->name, hd->address, hd->community, hd->version);
 
+  hd->engine_idx = hosts_num++;
+
   snprintf(cb_name, sizeof(cb_name), "snmp-%s", hd->name);
 
   status = plugin_register_complex_read(
@@ -895,7 +1089,12 @@ static int csnmp_config(oconfig_item_t *ci) {
       csnmp_config_add_data(child);
     else if (strcasecmp("Host", child->key) == 0)
       csnmp_config_add_host(child);
-    else {
+    else if (strcasecmp("PollThreads", child->key) == 0) {
+      if ((cf_util_get_int(child, &poll_threads) != 0) || (poll_threads < 0)) {
+        WARNING("snmp plugin: `PollThreads' must be a non-negative number.");
+        poll_threads = 0;
+      }
+    } else {
       WARNING("snmp plugin: Ignoring unknown config option `%s'.", child->key);
     }
   } /* for (ci->children) */
@@ -1201,17 +1400,19 @@ static int csnmp_strvbcopy(char *dst, /* {{{ */
   return 0;
 } /* }}} int csnmp_strvbcopy */
 
+/* The cell is allocated from "arena" and released when it is reset. */
 static csnmp_cell_char_t *csnmp_get_char_cell(const struct variable_list *vb,
                                               const oid_t *root_oid,
                                               const host_definition_t *hd,
-                                              const data_definition_t *dd) {
+                                              const data_definition_t *dd,
+                                              csnmp_arena_t *arena) {
 
   if (vb == NULL)
     return NULL;
 
-  csnmp_cell_char_t *il = calloc(1, sizeof(*il));
+  csnmp_cell_char_t *il = csnmp_arena_alloc(arena, sizeof(*il));
   if (il == NULL) {
-    ERROR("snmp plugin: calloc failed.");
+    ERROR("snmp plugin: csnmp_arena_alloc failed.");
     return NULL;
   }
   il->next = NULL;
@@ -1219,10 +1420,8 @@ static csnmp_cell_char_t *csnmp_get_char_cell(const struct variable_list *vb,
   oid_t vb_name;
   csnmp_oid_init(&vb_name, vb->name, vb->name_length);
 
-  if (csnmp_oid_suffix(&il->suffix, &vb_name, root_oid) != 0) {
-    sfree(il);
+  if (csnmp_oid_suffix(&il->suffix, &vb_name, root_oid) != 0)
     return NULL;
-  }
 
   /* Get value */
   if ((vb->type == ASN_OCTET_STR) || (vb->type == ASN_BIT_STR) ||
@@ -1295,6 +1494,11 @@ static int csnmp_dispatch_table(host_definition_t *host,
   csnmp_cell_char_t *filter_cell_ptr = filter_cells;
   csnmp_cell_value_t *value_cell_ptr[data->values_len];
 
+  /* Rows are dispatched in batches of CSNMP_DISPATCH_BATCH value lists. */
+  value_list_t batch[CSNMP_DISPATCH_BATCH];
+  value_t batch_values[CSNMP_DISPATCH_BATCH][data->values_len];
+  size_t batch_num = 0;
+
   size_t i;
   bool have_more;
   oid_t current_suffix;
@@ -1520,18 +1724,17 @@ static int csnmp_dispatch_table(host_definition_t *host,
                sizeof(vl.plugin_instance));
     }
 
-    vl.values_len = data->values_len;
-    value_t values[vl.values_len];
-    vl.values = values;
+    if (batch_num == CSNMP_DISPATCH_BATCH) {
+      plugin_dispatch_values_batch(batch, batch_num);
+      batch_num = 0;
+    }
 
+    batch[batch_num] = vl;
+    batch[batch_num].values = batch_values[batch_num];
+    batch[batch_num].values_len = data->values_len;
     for (i = 0; i < data->values_len; i++)
-      vl.values[i] = value_cell_ptr[i]->value;
-
-    plugin_dispatch_values(&vl);
-
-    /* prevent leakage of pointer to local variable. */
-    vl.values_len = 0;
-    vl.values = NULL;
+      batch_values[batch_num][i] = value_cell_ptr[i]->value;
+    batch_num++;
 
     if (type_instance_cells != NULL)
       type_instance_cell_ptr = type_instance_cell_ptr->next;
@@ -1539,491 +1742,541 @@ static int csnmp_dispatch_table(host_definition_t *host,
       value_cell_ptr[0] = value_cell_ptr[0]->next;
   } /* while (have_more) */
 
+  if (batch_num > 0)
+    plugin_dispatch_values_batch(batch, batch_num);
+
   return 0;
 } /* int csnmp_dispatch_table */
 
-static int csnmp_read_table(host_definition_t *host, data_definition_t *data) {
-  struct snmp_pdu *req;
-  struct snmp_pdu *res = NULL;
-  struct variable_list *vb;
+static const data_set_t *csnmp_data_get_ds(data_definition_t *data) {
+  const data_set_t *ds = plugin_get_ds(data->type);
+  if (!ds) {
+    ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
+    return NULL;
+  }
 
-  const data_set_t *ds;
+  if (ds->ds_num != data->values_len) {
+    ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
+          " values, but config talks "
+          "about %" PRIsz,
+          data->type, ds->ds_num, data->values_len);
+    return NULL;
+  }
 
-  size_t oid_list_len = data->values_len;
+  return ds;
+} /* const data_set_t *csnmp_data_get_ds */
+
+static void csnmp_instance_cache_reset(csnmp_instance_cache_t *cache) {
+  csnmp_arena_reset(&cache->arena);
+  cache->last_refresh = 0;
+  cache->type_instance_cells = NULL;
+  cache->plugin_instance_cells = NULL;
+  cache->hostname_cells = NULL;
+} /* void csnmp_instance_cache_reset */
+
+/* Returns the instance cache of "data", or NULL if instance columns are read
+ * with every walk. */
+static csnmp_instance_cache_t *
+csnmp_host_instance_cache(host_definition_t *host, data_definition_t *data) {
+  if (host->instance_interval == 0)
+    return NULL;
 
-  if (data->type_instance.oid.oid_len > 0)
-    oid_list_len++;
+  if (host->instance_cache == NULL) {
+    host->instance_cache =
+        calloc(host->data_list_len, sizeof(*host->instance_cache));
+    if (host->instance_cache == NULL)
+      return NULL;
+  }
 
-  if (data->plugin_instance.oid.oid_len > 0)
-    oid_list_len++;
+  for (int i = 0; i < host->data_list_len; i++)
+    if (host->data_list[i] == data)
+      return host->instance_cache + i;
+
+  return NULL;
+} /* csnmp_instance_cache_t *csnmp_host_instance_cache */
+
+static void csnmp_walk_free(csnmp_walk_t *w) {
+  /* The cells are released all at once. A cache that has not been refreshed
+   * completely is dropped, so that the next walk reads the instances again. */
+  csnmp_arena_reset(&w->host->arena);
+  if (w->cache_refresh)
+    csnmp_instance_cache_reset(w->cache);
+  w->cache_refresh = false;
+
+  sfree(w->value_cells_head);
+  sfree(w->value_cells_tail);
+  sfree(w->oid_list);
+  sfree(w->oid_list_todo);
+  sfree(w->var_idx);
+} /* void csnmp_walk_free */
+
+static int csnmp_walk_init(csnmp_walk_t *w, host_definition_t *host,
+                           data_definition_t *data) {
+  size_t i;
 
-  if (data->host.oid.oid_len > 0)
-    oid_list_len++;
+  memset(w, 0, sizeof(*w));
+  w->host = host;
+  w->data = data;
+  w->instance_arena = &host->arena;
 
-  if (data->filter_oid.oid_len > 0)
-    oid_list_len++;
+  w->ds = csnmp_data_get_ds(data);
+  if (w->ds == NULL)
+    return -1;
+  assert(data->values_len > 0);
+  w->values_len = data->values_len;
 
-  /* Holds the last OID returned by the device. We use this in the GETNEXT
-   * request to proceed. */
-  oid_t oid_list[oid_list_len];
-  /* Set to false when an OID has left its subtree so we don't re-request it
-   * again. */
-  csnmp_oid_type_t oid_list_todo[oid_list_len];
+  w->oid_list_len = data->values_len;
 
-  int status;
-  size_t i;
+  if (data->type_instance.oid.oid_len > 0)
+    w->oid_list_len++;
 
-  /* `value_list_head' and `value_cells_tail' implement a linked list for each
-   * value. `instance_cells_head' and `instance_cells_tail' implement a linked
-   * list of instance names. This is used to jump gaps in the table. */
-  csnmp_cell_char_t *type_instance_cells_head = NULL;
-  csnmp_cell_char_t *type_instance_cells_tail = NULL;
-  csnmp_cell_char_t *plugin_instance_cells_head = NULL;
-  csnmp_cell_char_t *plugin_instance_cells_tail = NULL;
-  csnmp_cell_char_t *hostname_cells_head = NULL;
-  csnmp_cell_char_t *hostname_cells_tail = NULL;
-  csnmp_cell_char_t *filter_cells_head = NULL;
-  csnmp_cell_char_t *filter_cells_tail = NULL;
-  csnmp_cell_value_t **value_cells_head;
-  csnmp_cell_value_t **value_cells_tail;
+  if (data->plugin_instance.oid.oid_len > 0)
+    w->oid_list_len++;
 
-  DEBUG("snmp plugin: csnmp_read_table (host = %s, data = %s)", host->name,
-        data->name);
+  if (data->host.oid.oid_len > 0)
+    w->oid_list_len++;
 
-  if (host->sess_handle == NULL) {
-    DEBUG("snmp plugin: csnmp_read_table: host->sess_handle == NULL");
-    return -1;
-  }
+  if (data->filter_oid.oid_len > 0)
+    w->oid_list_len++;
 
-  ds = plugin_get_ds(data->type);
-  if (!ds) {
-    ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
+  w->oid_list = calloc(w->oid_list_len, sizeof(*w->oid_list));
+  w->oid_list_todo = calloc(w->oid_list_len, sizeof(*w->oid_list_todo));
+  w->var_idx = calloc(w->oid_list_len, sizeof(*w->var_idx));
+
+  /* We're going to construct n linked lists, one for each "value".
+   * value_cells_head will contain pointers to the heads of these linked lists,
+   * value_cells_tail will contain pointers to the tail of the lists. */
+  w->value_cells_head = calloc(data->values_len, sizeof(*w->value_cells_head));
+  w->value_cells_tail = calloc(data->values_len, sizeof(*w->value_cells_tail));
+  if ((w->oid_list == NULL) || (w->oid_list_todo == NULL) ||
+      (w->var_idx == NULL) || (w->value_cells_head == NULL) ||
+      (w->value_cells_tail == NULL)) {
+    ERROR("snmp plugin: csnmp_walk_init: calloc failed.");
+    csnmp_walk_free(w);
     return -1;
   }
 
-  if (ds->ds_num != data->values_len) {
-    ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
-          " values, but config talks "
-          "about %" PRIsz,
-          data->type, ds->ds_num, data->values_len);
-    return -1;
+  bool cached = false;
+  w->cache = csnmp_host_instance_cache(host, data);
+  if (w->cache != NULL) {
+    cdtime_t now = cdtime();
+    if ((w->cache->last_refresh != 0) &&
+        ((now - w->cache->last_refresh) < host->instance_interval)) {
+      cached = true;
+      w->type_instance_cells_head = w->cache->type_instance_cells;
+      w->plugin_instance_cells_head = w->cache->plugin_instance_cells;
+      w->hostname_cells_head = w->cache->hostname_cells;
+    } else {
+      csnmp_instance_cache_reset(w->cache);
+      w->cache_refresh = true;
+      w->instance_arena = &w->cache->arena;
+    }
   }
-  assert(data->values_len > 0);
 
   for (i = 0; i < data->values_len; i++)
-    oid_list_todo[i] = OID_TYPE_VARIABLE;
+    w->oid_list_todo[i] = OID_TYPE_VARIABLE;
 
   /* We need a copy of all the OIDs, because GETNEXT will destroy them. */
-  memcpy(oid_list, data->values, data->values_len * sizeof(oid_t));
+  memcpy(w->oid_list, data->values, data->values_len * sizeof(oid_t));
 
   if (data->type_instance.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->type_instance.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_TYPEINSTANCE;
+    memcpy(w->oid_list + i, &data->type_instance.oid, sizeof(oid_t));
+    /* Cached instance columns are not requested. */
+    w->oid_list_todo[i] = cached ? OID_TYPE_SKIP : OID_TYPE_TYPEINSTANCE;
     i++;
   }
 
   if (data->plugin_instance.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->plugin_instance.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_PLUGININSTANCE;
+    memcpy(w->oid_list + i, &data->plugin_instance.oid, sizeof(oid_t));
+    /* Cached instance columns are not requested. */
+    w->oid_list_todo[i] = cached ? OID_TYPE_SKIP : OID_TYPE_PLUGININSTANCE;
     i++;
   }
 
   if (data->host.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->host.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_HOST;
+    memcpy(w->oid_list + i, &data->host.oid, sizeof(oid_t));
+    /* Cached instance columns are not requested. */
+    w->oid_list_todo[i] = cached ? OID_TYPE_SKIP : OID_TYPE_HOST;
     i++;
   }
 
   if (data->filter_oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->filter_oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_FILTER;
+    memcpy(w->oid_list + i, &data->filter_oid, sizeof(oid_t));
+    w->oid_list_todo[i] = OID_TYPE_FILTER;
     i++;
   }
 
-  /* We're going to construct n linked lists, one for each "value".
-   * value_cells_head will contain pointers to the heads of these linked lists,
-   * value_cells_tail will contain pointers to the tail of the lists. */
-  value_cells_head = calloc(data->values_len, sizeof(*value_cells_head));
-  value_cells_tail = calloc(data->values_len, sizeof(*value_cells_tail));
-  if ((value_cells_head == NULL) || (value_cells_tail == NULL)) {
-    ERROR("snmp plugin: csnmp_read_table: calloc failed.");
-    sfree(value_cells_head);
-    sfree(value_cells_tail);
+  return 0;
+} /* int csnmp_walk_init */
+
+/* csnmp_walk_request creates the next request of the walk. If all OIDs have
+ * left their subtree, zero is returned and "ret" is set to NULL. */
+static int csnmp_walk_request(csnmp_walk_t *w, struct snmp_pdu **ret) {
+  struct snmp_pdu *req;
+  bool bulk = (w->host->max_repetitions > 0);
+
+  *ret = NULL;
+
+  req = snmp_pdu_create(bulk ? SNMP_MSG_GETBULK : SNMP_MSG_GETNEXT);
+  if (req == NULL) {
+    ERROR("snmp plugin: snmp_pdu_create failed.");
     return -1;
   }
 
-  status = 0;
-  while (status == 0) {
-    req = snmp_pdu_create(SNMP_MSG_GETNEXT);
-    if (req == NULL) {
-      ERROR("snmp plugin: snmp_pdu_create failed.");
-      status = -1;
-      break;
-    }
+  if (bulk) {
+    req->non_repeaters = 0;
+    req->max_repetitions = w->host->max_repetitions;
+  }
 
-    size_t oid_list_todo_num = 0;
-    size_t var_idx[oid_list_len];
-    memset(var_idx, 0, sizeof(var_idx));
+  w->var_num = 0;
+  for (size_t i = 0; i < w->oid_list_len; i++) {
+    /* Do not rerequest already finished OIDs */
+    if (!w->oid_list_todo[i])
+      continue;
+    snmp_add_null_var(req, w->oid_list[i].oid, w->oid_list[i].oid_len);
+    w->var_idx[w->var_num] = i;
+    w->var_num++;
+  }
 
-    for (i = 0; i < oid_list_len; i++) {
-      /* Do not rerequest already finished OIDs */
-      if (!oid_list_todo[i])
-        continue;
-      snmp_add_null_var(req, oid_list[i].oid, oid_list[i].oid_len);
-      var_idx[oid_list_todo_num] = i;
-      oid_list_todo_num++;
-    }
+  if (w->var_num == 0) {
+    /* The request is still empty - so we are finished */
+    DEBUG("snmp plugin: all variables have left their subtree");
+    snmp_free_pdu(req);
+    return 0;
+  }
 
-    if (oid_list_todo_num == 0) {
-      /* The request is still empty - so we are finished */
-      DEBUG("snmp plugin: all variables have left their subtree");
-      snmp_free_pdu(req);
-      status = 0;
-      break;
+  *ret = req;
+  return 0;
+} /* int csnmp_walk_request */
+
+/* csnmp_walk_response adds the variables of a response to the cells of the
+ * walk. A GETBULK response contains up to "max-repetitions" rows of the
+ * requested variables, so the n-th variable belongs to the OID requested at
+ * position (n mod var_num). */
+static int csnmp_walk_response(csnmp_walk_t *w, struct snmp_pdu *res) {
+  host_definition_t *host = w->host;
+  data_definition_t *data = w->data;
+  struct variable_list *vb;
+  size_t i;
+  size_t n;
+
+  vb = res->variables;
+  if (vb == NULL)
+    return -1;
+
+  if (res->errstat != SNMP_ERR_NOERROR) {
+    if (res->errindex != 0) {
+      /* Find the OID which caused error */
+      for (i = 1, vb = res->variables; vb != NULL && i != res->errindex;
+           vb = vb->next_variable, i++)
+        /* do nothing */;
     }
 
-    res = NULL;
-    status = snmp_sess_synch_response(host->sess_handle, req, &res);
+    if ((res->errindex == 0) || (vb == NULL)) {
+      ERROR("snmp plugin: host %s; data %s: response error: %s (%li) ",
+            host->name, data->name, snmp_errstring(res->errstat),
+            res->errstat);
+      return -1;
+    }
 
-    /* snmp_sess_synch_response always frees our req PDU */
-    req = NULL;
+    char oid_buffer[1024] = {0};
+    snprint_objid(oid_buffer, sizeof(oid_buffer) - 1, vb->name,
+                  vb->name_length);
+    NOTICE("snmp plugin: host %s; data %s: OID `%s` failed: %s", host->name,
+           data->name, oid_buffer, snmp_errstring(res->errstat));
+
+    /* Get value index from todo list and skip OID found */
+    assert(res->errindex <= w->var_num);
+    i = w->var_idx[res->errindex - 1];
+    assert(i < w->oid_list_len);
+    w->oid_list_todo[i] = 0;
+    return 0;
+  }
 
-    if ((status != STAT_SUCCESS) || (res == NULL)) {
-      char *errstr = NULL;
+  for (vb = res->variables, n = 0; (vb != NULL); vb = vb->next_variable, n++) {
+    /* Calculate value index from todo list */
+    i = w->var_idx[n % w->var_num];
 
-      snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
+    /* This OID left its subtree in an earlier row of this response. */
+    if (!w->oid_list_todo[i])
+      continue;
 
-      c_complain(LOG_ERR, &host->complaint,
-                 "snmp plugin: host %s: snmp_sess_synch_response failed: %s",
-                 host->name, (errstr == NULL) ? "Unknown problem" : errstr);
+    /* An instance is configured and the res variable we process is the
+     * instance value */
+    if (w->oid_list_todo[i] == OID_TYPE_TYPEINSTANCE) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->type_instance.oid.oid,
+                             data->type_instance.oid.oid_len, vb->name,
+                             vb->name_length,
+                             data->type_instance.oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
+              "subtree.",
+              host->name, data->name);
+        w->oid_list_todo[i] = 0;
+        continue;
+      }
 
-      if (res != NULL)
-        snmp_free_pdu(res);
-      res = NULL;
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->type_instance.oid, host, data,
+                              w->instance_arena);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
-      sfree(errstr);
-      csnmp_host_close_session(host);
+      /* Ignored cells are released with the arena. */
+      if (!csnmp_ignore_instance(cell, data)) {
+        csnmp_cell_replace_reserved_chars(cell);
 
-      status = -1;
-      break;
-    }
+        DEBUG("snmp plugin: il->type_instance = `%s';", cell->value);
+        csnmp_cells_append(&w->type_instance_cells_head,
+                           &w->type_instance_cells_tail, cell);
+      }
+    } else if (w->oid_list_todo[i] == OID_TYPE_PLUGININSTANCE) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->plugin_instance.oid.oid,
+                             data->plugin_instance.oid.oid_len, vb->name,
+                             vb->name_length,
+                             data->plugin_instance.oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
+              "subtree.",
+              host->name, data->name);
+        w->oid_list_todo[i] = 0;
+        continue;
+      }
 
-    status = 0;
-    assert(res != NULL);
-    c_release(LOG_INFO, &host->complaint,
-              "snmp plugin: host %s: snmp_sess_synch_response successful.",
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->plugin_instance.oid, host, data,
+                              w->instance_arena);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
               host->name);
+        return -1;
+      }
 
-    vb = res->variables;
-    if (vb == NULL) {
-      status = -1;
-      break;
-    }
+      csnmp_cell_replace_reserved_chars(cell);
+
+      DEBUG("snmp plugin: il->plugin_instance = `%s';", cell->value);
+      csnmp_cells_append(&w->plugin_instance_cells_head,
+                         &w->plugin_instance_cells_tail, cell);
+    } else if (w->oid_list_todo[i] == OID_TYPE_HOST) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->host.oid.oid, data->host.oid.oid_len,
+                             vb->name, vb->name_length,
+                             data->host.oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
+              host->name, data->name);
+        w->oid_list_todo[i] = 0;
+        continue;
+      }
 
-    if (res->errstat != SNMP_ERR_NOERROR) {
-      if (res->errindex != 0) {
-        /* Find the OID which caused error */
-        for (i = 1, vb = res->variables; vb != NULL && i != res->errindex;
-             vb = vb->next_variable, i++)
-          /* do nothing */;
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->host.oid, host, data,
+                              w->instance_arena);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
       }
 
-      if ((res->errindex == 0) || (vb == NULL)) {
-        ERROR("snmp plugin: host %s; data %s: response error: %s (%li) ",
-              host->name, data->name, snmp_errstring(res->errstat),
-              res->errstat);
-        status = -1;
-        break;
+      csnmp_cell_replace_reserved_chars(cell);
+
+      DEBUG("snmp plugin: il->hostname = `%s';", cell->value);
+      csnmp_cells_append(&w->hostname_cells_head, &w->hostname_cells_tail,
+                         cell);
+    } else if (w->oid_list_todo[i] == OID_TYPE_FILTER) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->filter_oid.oid, data->filter_oid.oid_len,
+                             vb->name, vb->name_length,
+                             data->filter_oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
+              host->name, data->name);
+        w->oid_list_todo[i] = 0;
+        continue;
       }
 
-      char oid_buffer[1024] = {0};
-      snprint_objid(oid_buffer, sizeof(oid_buffer) - 1, vb->name,
-                    vb->name_length);
-      NOTICE("snmp plugin: host %s; data %s: OID `%s` failed: %s", host->name,
-             data->name, oid_buffer, snmp_errstring(res->errstat));
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->filter_oid, host, data,
+                              &host->arena);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
-      /* Get value index from todo list and skip OID found */
-      assert(res->errindex <= oid_list_todo_num);
-      i = var_idx[res->errindex - 1];
-      assert(i < oid_list_len);
-      oid_list_todo[i] = 0;
+      csnmp_cell_replace_reserved_chars(cell);
 
-      snmp_free_pdu(res);
-      res = NULL;
-      continue;
-    }
+      DEBUG("snmp plugin: il->filter = `%s';", cell->value);
+      csnmp_cells_append(&w->filter_cells_head, &w->filter_cells_tail, cell);
+    } else /* The variable we are processing is a normal value */
+    {
+      assert(w->oid_list_todo[i] == OID_TYPE_VARIABLE);
+
+      csnmp_cell_value_t *vt;
+      oid_t vb_name;
+      oid_t suffix;
+      int ret;
+
+      csnmp_oid_init(&vb_name, vb->name, vb->name_length);
+
+      /* Calculate the current suffix. This is later used to check that the
+       * suffix is increasing. This also checks if we left the subtree */
+      ret = csnmp_oid_suffix(&suffix, &vb_name, data->values + i);
+      if (ret != 0) {
+        DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
+              "Value probably left its subtree.",
+              host->name, data->name, i);
+        w->oid_list_todo[i] = 0;
+        continue;
+      }
 
-    for (vb = res->variables, i = 0; (vb != NULL);
-         vb = vb->next_variable, i++) {
-      /* Calculate value index from todo list */
-      while ((i < oid_list_len) && !oid_list_todo[i]) {
-        i++;
+      /* Make sure the OIDs returned by the agent are increasing. Otherwise
+       * our table matching algorithm will get confused. */
+      if ((w->value_cells_tail[i] != NULL) &&
+          (csnmp_oid_compare(&suffix, &w->value_cells_tail[i]->suffix) <= 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
+              "Suffix is not increasing.",
+              host->name, data->name, i);
+        w->oid_list_todo[i] = 0;
+        continue;
       }
-      if (i >= oid_list_len) {
-        break;
+
+      vt = csnmp_arena_alloc(&host->arena, sizeof(*vt));
+      if (vt == NULL) {
+        ERROR("snmp plugin: csnmp_arena_alloc failed.");
+        return -1;
       }
 
-      /* An instance is configured and the res variable we process is the
-       * instance value */
-      if (oid_list_todo[i] == OID_TYPE_TYPEINSTANCE) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->type_instance.oid.oid,
-                               data->type_instance.oid.oid_len, vb->name,
-                               vb->name_length,
-                               data->type_instance.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
-                "subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+      vt->value =
+          csnmp_value_list_to_value(vb, w->ds->ds[i].type, data->scale,
+                                    data->shift, host->name, data->name);
+      memcpy(&vt->suffix, &suffix, sizeof(vt->suffix));
+      vt->next = NULL;
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->type_instance.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+      if (w->value_cells_tail[i] == NULL)
+        w->value_cells_head[i] = vt;
+      else
+        w->value_cells_tail[i]->next = vt;
+      w->value_cells_tail[i] = vt;
+    }
 
-        if (csnmp_ignore_instance(cell, data)) {
-          sfree(cell);
-        } else {
-          csnmp_cell_replace_reserved_chars(cell);
+    /* Copy OID to oid_list[i] */
+    memcpy(w->oid_list[i].oid, vb->name, sizeof(oid) * vb->name_length);
+    w->oid_list[i].oid_len = vb->name_length;
+  } /* for (vb = res->variables ...) */
 
-          DEBUG("snmp plugin: il->type_instance = `%s';", cell->value);
-          csnmp_cells_append(&type_instance_cells_head,
-                             &type_instance_cells_tail, cell);
-        }
-      } else if (oid_list_todo[i] == OID_TYPE_PLUGININSTANCE) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->plugin_instance.oid.oid,
-                               data->plugin_instance.oid.oid_len, vb->name,
-                               vb->name_length,
-                               data->plugin_instance.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
-                "subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+  return 0;
+} /* int csnmp_walk_response */
+
+static int csnmp_walk_dispatch(csnmp_walk_t *w) {
+  if (w->cache_refresh) {
+    w->cache->type_instance_cells = w->type_instance_cells_head;
+    w->cache->plugin_instance_cells = w->plugin_instance_cells_head;
+    w->cache->hostname_cells = w->hostname_cells_head;
+    w->cache->last_refresh = cdtime();
+    w->cache_refresh = false;
+  }
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->plugin_instance.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+  return csnmp_dispatch_table(w->host, w->data, w->type_instance_cells_head,
+                              w->plugin_instance_cells_head,
+                              w->hostname_cells_head, w->filter_cells_head,
+                              w->value_cells_head);
+} /* int csnmp_walk_dispatch */
 
-        csnmp_cell_replace_reserved_chars(cell);
+static int csnmp_read_table(host_definition_t *host, data_definition_t *data) {
+  csnmp_walk_t w;
+  int status;
 
-        DEBUG("snmp plugin: il->plugin_instance = `%s';", cell->value);
-        csnmp_cells_append(&plugin_instance_cells_head,
-                           &plugin_instance_cells_tail, cell);
-      } else if (oid_list_todo[i] == OID_TYPE_HOST) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->host.oid.oid, data->host.oid.oid_len,
-                               vb->name, vb->name_length,
-                               data->host.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+  DEBUG("snmp plugin: csnmp_read_table (host = %s, data = %s)", host->name,
+        data->name);
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->host.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+  if (host->sess_handle == NULL) {
+    DEBUG("snmp plugin: csnmp_read_table: host->sess_handle == NULL");
+    return -1;
+  }
 
-        csnmp_cell_replace_reserved_chars(cell);
+  if (csnmp_walk_init(&w, host, data) != 0)
+    return -1;
 
-        DEBUG("snmp plugin: il->hostname = `%s';", cell->value);
-        csnmp_cells_append(&hostname_cells_head, &hostname_cells_tail, cell);
-      } else if (oid_list_todo[i] == OID_TYPE_FILTER) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->filter_oid.oid, data->filter_oid.oid_len,
-                               vb->name, vb->name_length,
-                               data->filter_oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+  status = 0;
+  while (status == 0) {
+    struct snmp_pdu *req = NULL;
+    struct snmp_pdu *res = NULL;
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->filter_oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+    status = csnmp_walk_request(&w, &req);
+    if ((status != 0) || (req == NULL))
+      break;
 
-        csnmp_cell_replace_reserved_chars(cell);
+    status = snmp_sess_synch_response(host->sess_handle, req, &res);
 
-        DEBUG("snmp plugin: il->filter = `%s';", cell->value);
-        csnmp_cells_append(&filter_cells_head, &filter_cells_tail, cell);
-      } else /* The variable we are processing is a normal value */
-      {
-        assert(oid_list_todo[i] == OID_TYPE_VARIABLE);
-
-        csnmp_cell_value_t *vt;
-        oid_t vb_name;
-        oid_t suffix;
-        int ret;
-
-        csnmp_oid_init(&vb_name, vb->name, vb->name_length);
-
-        /* Calculate the current suffix. This is later used to check that the
-         * suffix is increasing. This also checks if we left the subtree */
-        ret = csnmp_oid_suffix(&suffix, &vb_name, data->values + i);
-        if (ret != 0) {
-          DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
-                "Value probably left its subtree.",
-                host->name, data->name, i);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+    /* snmp_sess_synch_response always frees our req PDU */
+    req = NULL;
 
-        /* Make sure the OIDs returned by the agent are increasing. Otherwise
-         * our table matching algorithm will get confused. */
-        if ((value_cells_tail[i] != NULL) &&
-            (csnmp_oid_compare(&suffix, &value_cells_tail[i]->suffix) <= 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
-                "Suffix is not increasing.",
-                host->name, data->name, i);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+    if ((status != STAT_SUCCESS) || (res == NULL)) {
+      char *errstr = NULL;
 
-        vt = calloc(1, sizeof(*vt));
-        if (vt == NULL) {
-          ERROR("snmp plugin: calloc failed.");
-          status = -1;
-          break;
-        }
+      snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
 
-        vt->value =
-            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
-                                      data->shift, host->name, data->name);
-        memcpy(&vt->suffix, &suffix, sizeof(vt->suffix));
-        vt->next = NULL;
-
-        if (value_cells_tail[i] == NULL)
-          value_cells_head[i] = vt;
-        else
-          value_cells_tail[i]->next = vt;
-        value_cells_tail[i] = vt;
-      }
+      c_complain(LOG_ERR, &host->complaint,
+                 "snmp plugin: host %s: snmp_sess_synch_response failed: %s",
+                 host->name, (errstr == NULL) ? "Unknown problem" : errstr);
 
-      /* Copy OID to oid_list[i] */
-      memcpy(oid_list[i].oid, vb->name, sizeof(oid) * vb->name_length);
-      oid_list[i].oid_len = vb->name_length;
+      if (res != NULL)
+        snmp_free_pdu(res);
+      res = NULL;
 
-    } /* for (vb = res->variables ...) */
+      sfree(errstr);
+      csnmp_host_close_session(host);
 
-    if (res != NULL)
-      snmp_free_pdu(res);
-    res = NULL;
-  } /* while (status == 0) */
+      status = -1;
+      break;
+    }
+
+    c_release(LOG_INFO, &host->complaint,
+              "snmp plugin: host %s: snmp_sess_synch_response successful.",
+              host->name);
 
-  if (res != NULL)
+    status = csnmp_walk_response(&w, res);
     snmp_free_pdu(res);
-  res = NULL;
+  } /* while (status == 0) */
 
   if (status == 0)
-    csnmp_dispatch_table(host, data, type_instance_cells_head,
-                         plugin_instance_cells_head, hostname_cells_head,
-                         filter_cells_head, value_cells_head);
-
-  /* Free all allocated variables here */
-  while (type_instance_cells_head != NULL) {
-    csnmp_cell_char_t *next = type_instance_cells_head->next;
-    sfree(type_instance_cells_head);
-    type_instance_cells_head = next;
-  }
-
-  while (plugin_instance_cells_head != NULL) {
-    csnmp_cell_char_t *next = plugin_instance_cells_head->next;
-    sfree(plugin_instance_cells_head);
-    plugin_instance_cells_head = next;
-  }
+    csnmp_walk_dispatch(&w);
 
-  while (hostname_cells_head != NULL) {
-    csnmp_cell_char_t *next = hostname_cells_head->next;
-    sfree(hostname_cells_head);
-    hostname_cells_head = next;
-  }
+  csnmp_walk_free(&w);
 
-  while (filter_cells_head != NULL) {
-    csnmp_cell_char_t *next = filter_cells_head->next;
-    sfree(filter_cells_head);
-    filter_cells_head = next;
-  }
+  return 0;
+} /* int csnmp_read_table */
 
-  for (i = 0; i < data->values_len; i++) {
-    while (value_cells_head[i] != NULL) {
-      csnmp_cell_value_t *next = value_cells_head[i]->next;
-      sfree(value_cells_head[i]);
-      value_cells_head[i] = next;
-    }
+static struct snmp_pdu *csnmp_value_request(data_definition_t *data) {
+  struct snmp_pdu *req = snmp_pdu_create(SNMP_MSG_GET);
+  if (req == NULL) {
+    ERROR("snmp plugin: snmp_pdu_create failed.");
+    return NULL;
   }
 
-  sfree(value_cells_head);
-  sfree(value_cells_tail);
-
-  return 0;
-} /* int csnmp_read_table */
+  for (size_t i = 0; i < data->values_len; i++)
+    snmp_add_null_var(req, data->values[i].oid, data->values[i].oid_len);
 
-static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
-  struct snmp_pdu *req;
-  struct snmp_pdu *res = NULL;
-  struct variable_list *vb;
+  return req;
+} /* struct snmp_pdu *csnmp_value_request */
 
-  const data_set_t *ds;
+static int csnmp_dispatch_value(host_definition_t *host,
+                                data_definition_t *data,
+                                const data_set_t *ds, struct snmp_pdu *res) {
   value_list_t vl = VALUE_LIST_INIT;
-
-  int status;
+  struct variable_list *vb;
   size_t i;
 
-  DEBUG("snmp plugin: csnmp_read_value (host = %s, data = %s)", host->name,
-        data->name);
-
-  if (host->sess_handle == NULL) {
-    DEBUG("snmp plugin: csnmp_read_value: host->sess_handle == NULL");
-    return -1;
-  }
-
-  ds = plugin_get_ds(data->type);
-  if (!ds) {
-    ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
-    return -1;
-  }
-
-  if (ds->ds_num != data->values_len) {
-    ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
-          " values, but config talks "
-          "about %" PRIsz,
-          data->type, ds->ds_num, data->values_len);
-    return -1;
-  }
-
   vl.values_len = ds->ds_num;
   vl.values = malloc(sizeof(*vl.values) * vl.values_len);
   if (vl.values == NULL)
@@ -2045,15 +2298,51 @@ static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
     sstrncpy(vl.plugin_instance, data->plugin_instance.value,
              sizeof(vl.plugin_instance));
 
-  req = snmp_pdu_create(SNMP_MSG_GET);
-  if (req == NULL) {
-    ERROR("snmp plugin: snmp_pdu_create failed.");
-    sfree(vl.values);
+  for (vb = res->variables; vb != NULL; vb = vb->next_variable) {
+#if COLLECT_DEBUG
+    char buffer[1024];
+    snprint_variable(buffer, sizeof(buffer), vb->name, vb->name_length, vb);
+    DEBUG("snmp plugin: Got this variable: %s", buffer);
+#endif /* COLLECT_DEBUG */
+
+    for (i = 0; i < data->values_len; i++)
+      if (snmp_oid_compare(data->values[i].oid, data->values[i].oid_len,
+                           vb->name, vb->name_length) == 0)
+        vl.values[i] =
+            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
+                                      data->shift, host->name, data->name);
+  } /* for (res->variables) */
+
+  DEBUG("snmp plugin: -> plugin_dispatch_values (&vl);");
+  plugin_dispatch_values(&vl);
+  sfree(vl.values);
+
+  return 0;
+} /* int csnmp_dispatch_value */
+
+static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
+  struct snmp_pdu *req;
+  struct snmp_pdu *res = NULL;
+
+  const data_set_t *ds;
+
+  int status;
+
+  DEBUG("snmp plugin: csnmp_read_value (host = %s, data = %s)", host->name,
+        data->name);
+
+  if (host->sess_handle == NULL) {
+    DEBUG("snmp plugin: csnmp_read_value: host->sess_handle == NULL");
     return -1;
   }
 
-  for (i = 0; i < data->values_len; i++)
-    snmp_add_null_var(req, data->values[i].oid, data->values[i].oid_len);
+  ds = csnmp_data_get_ds(data);
+  if (ds == NULL)
+    return -1;
+
+  req = csnmp_value_request(data);
+  if (req == NULL)
+    return -1;
 
   status = snmp_sess_synch_response(host->sess_handle, req, &res);
 
@@ -2068,35 +2357,343 @@ static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
       snmp_free_pdu(res);
 
     sfree(errstr);
-    sfree(vl.values);
     csnmp_host_close_session(host);
 
     return -1;
   }
 
-  for (vb = res->variables; vb != NULL; vb = vb->next_variable) {
-#if COLLECT_DEBUG
-    char buffer[1024];
-    snprint_variable(buffer, sizeof(buffer), vb->name, vb->name_length, vb);
-    DEBUG("snmp plugin: Got this variable: %s", buffer);
-#endif /* COLLECT_DEBUG */
+  status = csnmp_dispatch_value(host, data, ds, res);
+  snmp_free_pdu(res);
 
-    for (i = 0; i < data->values_len; i++)
-      if (snmp_oid_compare(data->values[i].oid, data->values[i].oid_len,
-                           vb->name, vb->name_length) == 0)
-        vl.values[i] =
-            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
-                                      data->shift, host->name, data->name);
-  } /* for (res->variables) */
+  return status;
+} /* int csnmp_read_value */
 
-  snmp_free_pdu(res);
+/* Asynchronous polling engine, used if `PollThreads' is greater than zero.
+ * The read callbacks hand their host over to one of the engine threads, which
+ * multiplex the sessions of all their hosts with select(2). A host has at most
+ * one request in flight, and net-snmp handles its timeout and retries, so an
+ * unresponsive host only delays its own values. {{{ */
 
-  DEBUG("snmp plugin: -> plugin_dispatch_values (&vl);");
-  plugin_dispatch_values(&vl);
-  sfree(vl.values);
+/* Finishes the poll of a host. Must only be called by the host's engine
+ * thread or after it has been joined. */
+static void csnmp_poll_finish(host_definition_t *host) {
+  csnmp_engine_t *e = host->engine;
+
+  if (host->poll_walk != NULL) {
+    csnmp_walk_free(host->poll_walk);
+    sfree(host->poll_walk);
+  }
+
+  if (host->poll_failed)
+    csnmp_host_close_session(host);
+
+  pthread_mutex_lock(&e->lock);
+  host->poll_busy = false;
+  pthread_mutex_unlock(&e->lock);
+} /* void csnmp_poll_finish */
+
+static int csnmp_poll_callback(int operation, netsnmp_session *sess, int reqid,
+                               netsnmp_pdu *pdu, void *magic);
+
+static int csnmp_poll_send(host_definition_t *host, struct snmp_pdu *req) {
+  if (snmp_sess_async_send(host->sess_handle, req, csnmp_poll_callback,
+                           host) == 0) {
+    char *errstr = NULL;
+
+    snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
+    c_complain(LOG_ERR, &host->complaint,
+               "snmp plugin: host %s: snmp_sess_async_send failed: %s",
+               host->name, (errstr == NULL) ? "Unknown problem" : errstr);
+    sfree(errstr);
+
+    snmp_free_pdu(req);
+    return -1;
+  }
 
+  host->poll_pending = 1;
   return 0;
-} /* int csnmp_read_value */
+} /* int csnmp_poll_send */
+
+/* csnmp_poll_advance sends the next request of the host's poll, moving on to
+ * the next data definition when the current one is done. */
+static void csnmp_poll_advance(host_definition_t *host) {
+  while (!host->poll_failed && (host->poll_data_idx < host->data_list_len)) {
+    data_definition_t *data = host->data_list[host->poll_data_idx];
+    struct snmp_pdu *req = NULL;
+
+    if (!data->is_table) {
+      if (csnmp_data_get_ds(data) != NULL)
+        req = csnmp_value_request(data);
+    } else {
+      if (host->poll_walk == NULL) {
+        host->poll_walk = malloc(sizeof(*host->poll_walk));
+        if ((host->poll_walk != NULL) &&
+            (csnmp_walk_init(host->poll_walk, host, data) != 0))
+          sfree(host->poll_walk);
+      }
+
+      if ((host->poll_walk != NULL) &&
+          (csnmp_walk_request(host->poll_walk, &req) == 0) && (req == NULL)) {
+        csnmp_walk_dispatch(host->poll_walk);
+      }
+
+      if ((req == NULL) && (host->poll_walk != NULL)) {
+        csnmp_walk_free(host->poll_walk);
+        sfree(host->poll_walk);
+      }
+    }
+
+    if (req == NULL) {
+      host->poll_data_idx++;
+      continue;
+    }
+
+    if (csnmp_poll_send(host, req) != 0)
+      host->poll_failed = true;
+    return;
+  }
+} /* void csnmp_poll_advance */
+
+static int csnmp_poll_callback(int operation,
+                               netsnmp_session *sess __attribute__((unused)),
+                               int reqid __attribute__((unused)),
+                               netsnmp_pdu *pdu, void *magic) {
+  host_definition_t *host = magic;
+
+  /* Closing the session of an aborted poll times out its request. */
+  if (host->poll_pending == 0)
+    return 1;
+  host->poll_pending = 0;
+
+  if ((operation != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) || (pdu == NULL)) {
+    c_complain(LOG_ERR, &host->complaint, "snmp plugin: host %s: %s",
+               host->name,
+               (operation == NETSNMP_CALLBACK_OP_TIMED_OUT)
+                   ? "Request timed out."
+                   : "Receiving the response failed.");
+    host->poll_failed = true;
+    return 1;
+  }
+
+  c_release(LOG_INFO, &host->complaint,
+            "snmp plugin: host %s: Asynchronous request successful.",
+            host->name);
+
+  data_definition_t *data = host->data_list[host->poll_data_idx];
+  if (data->is_table) {
+    if (csnmp_walk_response(host->poll_walk, pdu) != 0) {
+      csnmp_walk_free(host->poll_walk);
+      sfree(host->poll_walk);
+      host->poll_data_idx++;
+    }
+  } else {
+    const data_set_t *ds = csnmp_data_get_ds(data);
+    if (ds != NULL)
+      csnmp_dispatch_value(host, data, ds, pdu);
+    host->poll_data_idx++;
+  }
+
+  csnmp_poll_advance(host);
+
+  /* The library frees "pdu". */
+  return 1;
+} /* int csnmp_poll_callback */
+
+static void csnmp_poll_start(host_definition_t *host) {
+  host->poll_data_idx = 0;
+  host->poll_failed = false;
+  host->poll_pending = 0;
+
+  if (host->sess_handle == NULL)
+    csnmp_host_open_session(host);
+
+  if (host->sess_handle == NULL)
+    host->poll_failed = true;
+  else
+    csnmp_poll_advance(host);
+} /* void csnmp_poll_start */
+
+static void *csnmp_engine_thread(void *arg) {
+  csnmp_engine_t *e = arg;
+
+  while (42) {
+    pthread_mutex_lock(&e->lock);
+    bool shutdown = e->shutdown;
+    host_definition_t *pending = e->pending;
+    e->pending = NULL;
+    pthread_mutex_unlock(&e->lock);
+
+    if (shutdown) {
+      /* Polls submitted since the last iteration are aborted with the active
+       * ones by csnmp_engine_stop. */
+      e->pending_aborted = pending;
+      break;
+    }
+
+    while (pending != NULL) {
+      host_definition_t *host = pending;
+      pending = host->poll_next;
+
+      plugin_set_ctx(host->poll_ctx);
+      csnmp_poll_start(host);
+      if (host->poll_pending == 0) {
+        csnmp_poll_finish(host);
+        continue;
+      }
+
+      host->poll_next = e->active;
+      e->active = host;
+    }
+
+    fd_set fds;
+    int numfds = e->wakeup[0] + 1;
+    struct timeval tv = {0};
+    int block = 1;
+
+    FD_ZERO(&fds);
+    FD_SET(e->wakeup[0], &fds);
+    for (host_definition_t *host = e->active; host != NULL;
+         host = host->poll_next)
+      snmp_sess_select_info(host->sess_handle, &numfds, &fds, &tv, &block);
+
+    int status = select(numfds, &fds, NULL, NULL, block ? NULL : &tv);
+    if (status < 0) {
+      if (errno != EINTR)
+        ERROR("snmp plugin: select failed: %s", STRERRNO);
+      FD_ZERO(&fds);
+      status = 0;
+    }
+
+    if (FD_ISSET(e->wakeup[0], &fds)) {
+      char buffer[64];
+      while (read(e->wakeup[0], buffer, sizeof(buffer)) > 0)
+        /* do nothing */;
+    }
+
+    host_definition_t **prev = &e->active;
+    while (*prev != NULL) {
+      host_definition_t *host = *prev;
+
+      plugin_set_ctx(host->poll_ctx);
+      if (status > 0)
+        snmp_sess_read(host->sess_handle, &fds);
+      snmp_sess_timeout(host->sess_handle);
+
+      if (host->poll_pending != 0) {
+        prev = &host->poll_next;
+        continue;
+      }
+
+      *prev = host->poll_next;
+      csnmp_poll_finish(host);
+    }
+  } /* while (42) */
+
+  return NULL;
+} /* void *csnmp_engine_thread */
+
+/* Stops the engine threads and aborts the polls in progress. Called when the
+ * first host is destroyed, i.e. after the read callbacks have been stopped. */
+static void csnmp_engine_stop(void) {
+  for (size_t i = 0; i < engines_num; i++) {
+    csnmp_engine_t *e = engines + i;
+
+    pthread_mutex_lock(&e->lock);
+    e->shutdown = true;
+    pthread_mutex_unlock(&e->lock);
+    if (write(e->wakeup[1], "", 1) < 0 && errno != EAGAIN)
+      WARNING("snmp plugin: Waking up the engine thread failed: %s",
+              STRERRNO);
+
+    if (e->thread_running)
+      pthread_join(e->thread, NULL);
+    e->thread_running = false;
+
+    host_definition_t *lists[] = {e->active, e->pending_aborted, e->pending};
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(lists); j++) {
+      while (lists[j] != NULL) {
+        host_definition_t *host = lists[j];
+        lists[j] = host->poll_next;
+
+        host->poll_pending = 0;
+        csnmp_poll_finish(host);
+      }
+    }
+    e->active = e->pending_aborted = e->pending = NULL;
+
+    close(e->wakeup[0]);
+    close(e->wakeup[1]);
+    pthread_mutex_destroy(&e->lock);
+  }
+
+  sfree(engines);
+  engines_num = 0;
+} /* void csnmp_engine_stop */
+
+static int csnmp_engine_start(void) {
+  if ((poll_threads == 0) || (engines != NULL))
+    return 0;
+
+  engines = calloc((size_t)poll_threads, sizeof(*engines));
+  if (engines == NULL) {
+    ERROR("snmp plugin: calloc failed.");
+    return -1;
+  }
+
+  for (int i = 0; i < poll_threads; i++) {
+    csnmp_engine_t *e = engines + engines_num;
+    int status;
+
+    if (pipe(e->wakeup) != 0) {
+      ERROR("snmp plugin: pipe failed: %s", STRERRNO);
+      csnmp_engine_stop();
+      return -1;
+    }
+    fcntl(e->wakeup[0], F_SETFL, fcntl(e->wakeup[0], F_GETFL) | O_NONBLOCK);
+    fcntl(e->wakeup[1], F_SETFL, fcntl(e->wakeup[1], F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&e->lock, NULL);
+    engines_num++;
+
+    status = plugin_thread_create(&e->thread, /* attr = */ NULL,
+                                  csnmp_engine_thread, e, "snmp engine");
+    if (status != 0) {
+      ERROR("snmp plugin: Starting an engine thread failed: %s",
+            STRERROR(status));
+      csnmp_engine_stop();
+      return -1;
+    }
+    e->thread_running = true;
+  }
+
+  return 0;
+} /* int csnmp_engine_start */
+
+static int csnmp_engine_submit(host_definition_t *host) {
+  csnmp_engine_t *e = engines + (host->engine_idx % engines_num);
+
+  pthread_mutex_lock(&e->lock);
+  if (host->poll_busy) {
+    pthread_mutex_unlock(&e->lock);
+    WARNING("snmp plugin: host %s: The previous poll is still in progress. "
+            "Skipping this interval.",
+            host->name);
+    return -1;
+  }
+
+  host->engine = e;
+  host->poll_busy = true;
+  host->poll_ctx = plugin_get_ctx();
+  host->poll_next = e->pending;
+  e->pending = host;
+  pthread_mutex_unlock(&e->lock);
+
+  if (write(e->wakeup[1], "", 1) < 0 && errno != EAGAIN)
+    WARNING("snmp plugin: Waking up the engine thread failed: %s",
+            STRERRNO);
+
+  return 0;
+} /* int csnmp_engine_submit */
+/* }}} End of the asynchronous polling engine */
 
 static int csnmp_read_host(user_data_t *ud) {
   host_definition_t *host;
@@ -2106,6 +2703,9 @@ static int csnmp_read_host(user_data_t *ud) {
 
   host = ud->data;
 
+  if (engines_num > 0)
+    return csnmp_engine_submit(host);
+
   if (host->sess_handle == NULL)
     csnmp_host_open_session(host);
 
@@ -2134,13 +2734,16 @@ static int csnmp_read_host(user_data_t *ud) {
 static int csnmp_init(void) {
   call_snmp_init_once();
 
-  return 0;
+  return csnmp_engine_start();
 } /* int csnmp_init */
 
 static int csnmp_shutdown(void) {
   data_definition_t *data_this;
   data_definition_t *data_next;
 
+  /* Only left running if no host has been configured. */
+  csnmp_engine_stop();
+
   /* When we get here, the read threads have been stopped and all the
    * `host_definition_t' will be freed. */
   DEBUG("snmp plugin: Destroying all data definitions.");
@@ -82,6 +82,16 @@ struct token_s {
 };
 typedef struct token_s token_t;
 
+/* A row of a table. The OIDs of a row are not registered with the agent one
+ * by one: every column is registered as a whole and rows are looked up in the
+ * table's `rows' snapshot, see snmp_agent_table_rows_update(). */
+struct table_row_s {
+  oid_t *instance; /* Key of instance_index */
+  int index;       /* Generated index, if the table has an IndexOID */
+  int columns;     /* Number of columns having values for this row */
+};
+typedef struct table_row_s table_row_t;
+
 struct table_definition_s {
   char *name;
   oid_t index_oid;
@@ -89,8 +99,12 @@ struct table_definition_s {
   llist_t *columns;
   c_avl_tree_t *instance_index;
   c_avl_tree_t *index_instance;
-  c_avl_tree_t *instance_oids; /* Tells us how many OIDs registered for every
-                                  instance; */
+  c_avl_tree_t *instance_oids; /* Maps every instance to its table_row_t */
+  table_row_t **rows; /* All rows, in the order of their OIDs. Rebuilt when
+                         `rows_dirty' is set, so that walks take a binary
+                         search per request. */
+  size_t rows_num;
+  bool rows_dirty;
   index_key_t index_keys[MAX_INDEX_KEYS]; /* Stores information about what each
                                              index key represents */
   int index_keys_len;
@@ -118,6 +132,9 @@ struct data_definition_s {
   size_t oids_len;
   double scale;
   double shift;
+  c_avl_tree_t *names; /* Table columns only: maps the instances this column
+                          has values for to their identifiers, formatted
+                          once when the first value arrives */
 };
 typedef struct data_definition_s data_definition_t;
 
@@ -146,13 +163,14 @@ static const char *index_opts[MAX_KEY_SOURCES] = {
 static int snmp_agent_shutdown(void);
 static void *snmp_agent_thread_run(void *arg);
 static int snmp_agent_register_oid(oid_t *oid, Netsnmp_Node_Handler *handler);
+static int snmp_agent_register_subtree(oid_t *oid,
+                                       Netsnmp_Node_Handler *handler,
+                                       void *arg);
 static int snmp_agent_set_vardata(void *dst_buf, size_t *dst_buf_len,
                                   u_char asn_type, double scale, double shift,
                                   const void *value, size_t len, int type);
-static int snmp_agent_unregister_oid_index(oid_t *oid, int index);
-static int snmp_agent_update_instance_oids(c_avl_tree_t *tree, oid_t *index_oid,
-                                           int value);
 static int num_compare(const int *a, const int *b);
+static int oid_compare(const oid_t *a, const oid_t *b);
 
 static u_char snmp_agent_get_asn_type(oid *oid, size_t oid_len) {
   struct tree *node = get_tree(oid, oid_len, g_agent->tp);
@@ -635,108 +653,53 @@ static int snmp_agent_append_oid(oid_t *out, const oid_t *in) {
   return 0;
 }
 
-static int snmp_agent_register_oid_string(const oid_t *oid,
-                                          const oid_t *index_oid,
-                                          Netsnmp_Node_Handler *handler) {
-  oid_t new_oid;
-
-  memcpy(&new_oid, oid, sizeof(*oid));
-  /* Concatenating two string oids */
-  int ret = snmp_agent_append_oid(&new_oid, index_oid);
-  if (ret != 0)
-    return ret;
-
-  return snmp_agent_register_oid(&new_oid, handler);
-}
-
-static int snmp_agent_unregister_oid(oid_t *oid) {
-  int ret = c_avl_remove(g_agent->registered_oids, (void *)oid, NULL, NULL);
-
-  if (ret != 0)
-    ERROR(PLUGIN_NAME ": Could not delete registration info");
+/* Removes a row that no column has values for anymore. */
+static void snmp_agent_table_row_remove(table_definition_t *td,
+                                        table_row_t *row) {
+  oid_t *instance = row->instance;
 
-  return unregister_mib(oid->oid, oid->oid_len);
-}
+  c_avl_remove(td->instance_oids, instance, NULL, NULL);
 
-static int snmp_agent_unregister_oid_string(oid_t *oid,
-                                            const oid_t *index_oid) {
-  oid_t new_oid;
-  char oid_str[DATA_MAX_NAME_LEN];
-
-  memcpy(&new_oid, oid, sizeof(*oid));
-  /* Concatenating two string oids */
-  int ret = snmp_agent_append_oid(&new_oid, index_oid);
-  if (ret != 0)
-    return ret;
+  if (td->index_oid.oid_len) {
+    int *index = NULL;
 
-  snmp_agent_oid_to_string(oid_str, sizeof(oid_str), &new_oid);
-  DEBUG(PLUGIN_NAME ": Unregistered handler for OID (%s)", oid_str);
+    c_avl_remove(td->index_instance, &row->index, NULL, NULL);
+    c_avl_remove(td->instance_index, instance, NULL, (void **)&index);
+    sfree(index);
+  } else {
+    c_avl_remove(td->instance_index, instance, NULL, NULL);
+  }
 
-  return snmp_agent_unregister_oid(&new_oid);
+  sfree(instance);
+  sfree(row);
+  td->rows_dirty = true;
 }
 
 static void snmp_agent_table_data_remove(data_definition_t *dd,
                                          table_definition_t *td,
                                          oid_t *index_oid) {
-  int *index = NULL;
-  oid_t *ind_oid = NULL;
-
-  if (td->index_oid.oid_len) {
-    if ((c_avl_get(td->instance_index, index_oid, (void **)&index) != 0) ||
-        (c_avl_get(td->index_instance, index, NULL) != 0))
-      return;
-  } else {
-    if (c_avl_get(td->instance_index, index_oid, NULL) != 0)
-      return;
-  }
-
-  pthread_mutex_lock(&g_agent->agentx_lock);
-
-  int reg_oids = -1; /* Number of registered oids for given instance */
+  table_row_t *row = NULL;
+  char *name = NULL;
 
-  for (size_t i = 0; i < dd->oids_len; i++) {
-    if (td->index_oid.oid_len)
-      snmp_agent_unregister_oid_index(&dd->oids[i], *index);
-    else
-      snmp_agent_unregister_oid_string(&dd->oids[i], index_oid);
-
-    reg_oids =
-        snmp_agent_update_instance_oids(td->instance_oids, index_oid, -1);
-  }
-
-  /* Checking if any metrics are left registered */
-  if (reg_oids != 0) {
-    pthread_mutex_unlock(&g_agent->agentx_lock);
+  if (c_avl_get(td->instance_oids, index_oid, (void **)&row) != 0)
     return;
-  }
-
-  /* All metrics have been unregistered. Unregistering index key OIDs */
-  int keys_processed = 0;
-  for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
-    data_definition_t *idd = de->value;
 
-    if (!idd->is_index_key)
-      continue;
-
-    for (size_t i = 0; i < idd->oids_len; i++)
-      if (td->index_oid.oid_len)
-        snmp_agent_unregister_oid_index(&idd->oids[i], *index);
-      else
-        snmp_agent_unregister_oid_string(&idd->oids[i], index_oid);
+  /* The column has no values for this row. */
+  if ((dd->names == NULL) ||
+      (c_avl_remove(dd->names, index_oid, NULL, (void **)&name) != 0))
+    return;
+  sfree(name);
 
-    if (++keys_processed >= td->index_keys_len)
-      break;
-  }
-  pthread_mutex_unlock(&g_agent->agentx_lock);
+  /* Checking if any columns are left */
+  if (--row->columns > 0)
+    return;
 
-  /* All OIDs have been unregistered so we dont need this instance registered
-   * as well */
   char index_str[DATA_MAX_NAME_LEN];
 
-  if (index == NULL)
-    snmp_agent_oid_to_string(index_str, sizeof(index_str), index_oid);
+  if (td->index_oid.oid_len)
+    snprintf(index_str, sizeof(index_str), "%d", row->index);
   else
-    snprintf(index_str, sizeof(index_str), "%d", *index);
+    snmp_agent_oid_to_string(index_str, sizeof(index_str), index_oid);
 
   notification_t n = {
       .severity = NOTIF_WARNING, .time = cdtime(), .plugin = PLUGIN_NAME};
@@ -746,23 +709,7 @@ static void snmp_agent_table_data_remove(data_definition_t *dd,
   DEBUG(PLUGIN_NAME ": %s", n.message);
   plugin_dispatch_notification(&n);
 
-  int *val = NULL;
-
-  c_avl_remove(td->instance_oids, index_oid, NULL, (void **)&val);
-  sfree(val);
-
-  if (index != NULL) {
-    pthread_mutex_lock(&g_agent->agentx_lock);
-    snmp_agent_unregister_oid_index(&td->index_oid, *index);
-    pthread_mutex_unlock(&g_agent->agentx_lock);
-
-    c_avl_remove(td->index_instance, index, NULL, (void **)&ind_oid);
-    c_avl_remove(td->instance_index, index_oid, NULL, (void **)&index);
-    sfree(index);
-    sfree(ind_oid);
-  } else {
-    c_avl_remove(td->instance_index, index_oid, NULL, NULL);
-  }
+  snmp_agent_table_row_remove(td, row);
 }
 
 static int snmp_agent_clear_missing(const value_list_t *vl,
@@ -806,10 +753,18 @@ static void snmp_agent_free_data(data_definition_t **dd) {
   if (dd == NULL || *dd == NULL)
     return;
 
-  /* unregister scalar type OID */
-  if ((*dd)->table == NULL) {
-    for (size_t i = 0; i < (*dd)->oids_len; i++)
-      unregister_mib((*dd)->oids[i].oid, (*dd)->oids[i].oid_len);
+  /* unregister scalar OIDs and table columns */
+  for (size_t i = 0; i < (*dd)->oids_len; i++)
+    unregister_mib((*dd)->oids[i].oid, (*dd)->oids[i].oid_len);
+
+  if ((*dd)->names != NULL) {
+    void *key = NULL;
+    char *name = NULL;
+
+    /* The keys are owned by the table */
+    while (c_avl_pick((*dd)->names, &key, (void **)&name) == 0)
+      sfree(name);
+    c_avl_destroy((*dd)->names);
   }
 
   sfree((*dd)->name);
@@ -830,29 +785,6 @@ static void snmp_agent_free_table_columns(table_definition_t *td) {
 
   for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
     data_definition_t *dd = de->value;
-
-    if (td->index_oid.oid_len) {
-      int *index;
-      oid_t *index_oid;
-
-      c_avl_iterator_t *iter = c_avl_get_iterator(td->index_instance);
-      while (c_avl_iterator_next(iter, (void *)&index, (void *)&index_oid) ==
-             0) {
-        for (size_t i = 0; i < dd->oids_len; i++)
-          snmp_agent_unregister_oid_index(&dd->oids[i], *index);
-      }
-      c_avl_iterator_destroy(iter);
-    } else {
-      oid_t *index_oid;
-
-      c_avl_iterator_t *iter = c_avl_get_iterator(dd->table->instance_index);
-      while (c_avl_iterator_next(iter, (void *)&index_oid, NULL) == 0) {
-        for (size_t i = 0; i < dd->oids_len; i++)
-          snmp_agent_unregister_oid_string(&dd->oids[i], index_oid);
-      }
-      c_avl_iterator_destroy(iter);
-    }
-
     snmp_agent_free_data(&dd);
   }
 
@@ -868,33 +800,24 @@ static void snmp_agent_free_table(table_definition_t **td) {
   if ((*td)->size_oid.oid_len)
     unregister_mib((*td)->size_oid.oid, (*td)->size_oid.oid_len);
 
-  oid_t *index_oid;
+  /* Unregister the index OID column */
+  if ((*td)->index_oid.oid_len)
+    unregister_mib((*td)->index_oid.oid, (*td)->index_oid.oid_len);
 
-  /* Unregister Index OIDs */
-  if ((*td)->index_oid.oid_len) {
-    int *index;
-
-    c_avl_iterator_t *iter = c_avl_get_iterator((*td)->index_instance);
-    while (c_avl_iterator_next(iter, (void **)&index, (void **)&index_oid) == 0)
-      snmp_agent_unregister_oid_index(&(*td)->index_oid, *index);
-
-    c_avl_iterator_destroy(iter);
-  }
-
-  /* Unregister all table columns and their registered OIDs */
+  /* Unregister all table columns */
   snmp_agent_free_table_columns(*td);
 
   void *key = NULL;
   void *value = NULL;
-  int *num = NULL;
 
-  /* Removing data from instance_oids, leaving key pointers since they are still
-   * used in other AVL trees */
-  c_avl_iterator_t *iter = c_avl_get_iterator((*td)->instance_oids);
-  while (c_avl_iterator_next(iter, (void **)&index_oid, (void **)&num) == 0)
-    sfree(num);
-  c_avl_iterator_destroy(iter);
-  c_avl_destroy((*td)->instance_oids);
+  /* Removing rows from instance_oids, leaving key pointers since they are
+   * still used in other AVL trees */
+  if ((*td)->instance_oids != NULL) {
+    while (c_avl_pick((*td)->instance_oids, &key, &value) == 0)
+      sfree(value);
+    c_avl_destroy((*td)->instance_oids);
+  }
+  sfree((*td)->rows);
 
   /* index_instance and instance_index contain the same pointers */
   c_avl_destroy((*td)->index_instance);
@@ -1081,16 +1004,20 @@ static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
                                strlen((const char *)key->val.string));
 #endif
 
-    pthread_mutex_unlock(&g_agent->lock);
-
     return SNMP_ERR_NOERROR;
   }
 
-  char name[DATA_MAX_NAME_LEN];
+  char buffer[DATA_MAX_NAME_LEN];
+  char *name = NULL;
 
-  ret = snmp_agent_format_name(name, sizeof(name), dd, index_oid);
-  if (ret != 0)
-    return ret;
+  /* Table columns have the identifiers of their rows formatted already */
+  if ((dd->names == NULL) ||
+      (c_avl_get(dd->names, index_oid, (void **)&name) != 0)) {
+    ret = snmp_agent_format_name(buffer, sizeof(buffer), dd, index_oid);
+    if (ret != 0)
+      return ret;
+    name = buffer;
+  }
 
   DEBUG(PLUGIN_NAME ": Identifier '%s'", name);
 
@@ -1132,133 +1059,241 @@ static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
   return SNMP_ERR_NOERROR;
 }
 
-static int
-snmp_agent_table_oid_handler(struct netsnmp_mib_handler_s *handler,
-                             struct netsnmp_handler_registration_s *reginfo,
-                             struct netsnmp_agent_request_info_s *reqinfo,
-                             struct netsnmp_request_info_s *requests) {
+/* Rebuilds the ordered list of rows if rows have been added or removed. Must
+ * hold g_agent->lock. */
+static int snmp_agent_table_rows_update(table_definition_t *td) {
+  if (!td->rows_dirty)
+    return 0;
 
-  if (reqinfo->mode != MODE_GET) {
-    DEBUG(PLUGIN_NAME ": Not supported request mode (%d)", reqinfo->mode);
-    return SNMP_ERR_NOERROR;
+  size_t rows_num = (size_t)c_avl_size(td->instance_oids);
+  table_row_t **rows = realloc(td->rows, (rows_num + 1) * sizeof(*rows));
+  if (rows == NULL) {
+    ERROR(PLUGIN_NAME ": Failed to allocate memory");
+    return -ENOMEM;
   }
+  td->rows = rows;
+  td->rows_num = 0;
 
-  pthread_mutex_lock(&g_agent->lock);
+  /* The generated indexes are ordered like their OIDs, and so are the
+   * instance OIDs in instance_oids. */
+  if (td->index_oid.oid_len) {
+    int *index;
+    oid_t *instance;
+
+    c_avl_iterator_t *iter = c_avl_get_iterator(td->index_instance);
+    while (c_avl_iterator_next(iter, (void **)&index, (void **)&instance) ==
+           0) {
+      table_row_t *row = NULL;
+      if ((c_avl_get(td->instance_oids, instance, (void **)&row) == 0) &&
+          (td->rows_num < rows_num))
+        td->rows[td->rows_num++] = row;
+    }
+    c_avl_iterator_destroy(iter);
+  } else {
+    oid_t *instance;
+    table_row_t *row;
+
+    c_avl_iterator_t *iter = c_avl_get_iterator(td->instance_oids);
+    while ((c_avl_iterator_next(iter, (void **)&instance, (void **)&row) ==
+            0) &&
+           (td->rows_num < rows_num))
+      td->rows[td->rows_num++] = row;
+    c_avl_iterator_destroy(iter);
+  }
+
+  td->rows_dirty = false;
+  return 0;
+}
 
+/* Appends the part of the row's OIDs that follows the column's OID to `out'. */
+static int snmp_agent_table_row_oid(table_definition_t const *td,
+                                    table_row_t const *row, oid_t *out) {
+  if (td->index_oid.oid_len) {
+    if (out->oid_len >= MAX_OID_LEN)
+      return -EINVAL;
+    out->oid[out->oid_len++] = (oid)row->index;
+    return 0;
+  }
+
+  return snmp_agent_append_oid(out, row->instance);
+}
+
+static int snmp_agent_table_row_compare(table_definition_t const *td,
+                                        table_row_t const *row,
+                                        oid const *suffix, size_t suffix_len) {
+  if (td->index_oid.oid_len) {
+    oid index = (oid)row->index;
+    return snmp_oid_compare(&index, 1, suffix, suffix_len);
+  }
+
+  return snmp_oid_compare(row->instance->oid, row->instance->oid_len, suffix,
+                          suffix_len);
+}
+
+/* Looks up the row that the OID `req' in the column `column' refers to, or,
+ * with `next', the first row following it. Returns the position of the row in
+ * td->rows, or td->rows_num if there is none. */
+static size_t snmp_agent_table_row_find(table_definition_t const *td,
+                                        oid_t const *column, oid_t const *req,
+                                        bool next) {
+  int cmp = snmp_oid_ncompare(req->oid, req->oid_len, column->oid,
+                              column->oid_len, column->oid_len);
+  if (cmp < 0)
+    return next ? 0 : td->rows_num;
+  if ((cmp > 0) || (req->oid_len < column->oid_len))
+    return td->rows_num;
+
+  oid const *suffix = req->oid + column->oid_len;
+  size_t suffix_len = req->oid_len - column->oid_len;
+
+  /* The first row that is not smaller than (or, with `next', greater than) the
+   * requested one */
+  size_t lo = 0;
+  size_t hi = td->rows_num;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    cmp = snmp_agent_table_row_compare(td, td->rows[mid], suffix, suffix_len);
+    if ((cmp < 0) || (next && (cmp == 0)))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (!next && (lo < td->rows_num) &&
+      (snmp_agent_table_row_compare(td, td->rows[lo], suffix, suffix_len) !=
+       0))
+    return td->rows_num;
+
+  return lo;
+}
+
+/* Answers one GET or GETNEXT request for the column `column' of `td'. With
+ * `dd' set, the column is a data column with the OIDs dd->oids, and
+ * `oid_index' selects one of them. Without, it's the IndexOID column. */
+static int snmp_agent_table_request(struct netsnmp_request_info_s *request,
+                                    table_definition_t *td,
+                                    data_definition_t *dd, size_t oid_index,
+                                    oid_t const *column, bool next) {
   oid_t oid; /* Requested OID */
-  memcpy(oid.oid, requests->requestvb->name,
-         sizeof(oid.oid[0]) * requests->requestvb->name_length);
-  oid.oid_len = requests->requestvb->name_length;
+
+  if (request->requestvb->name_length > MAX_OID_LEN)
+    return SNMP_NOSUCHINSTANCE;
+  memcpy(oid.oid, request->requestvb->name,
+         sizeof(oid.oid[0]) * request->requestvb->name_length);
+  oid.oid_len = request->requestvb->name_length;
 
 #if COLLECT_DEBUG
   char oid_str[DATA_MAX_NAME_LEN];
   snmp_agent_oid_to_string(oid_str, sizeof(oid_str), &oid);
-  DEBUG(PLUGIN_NAME ": Get request received for table OID '%s'", oid_str);
+  DEBUG(PLUGIN_NAME ": Get%s request received for table OID '%s'",
+        next ? "Next" : "", oid_str);
 #endif
-  oid_t index_oid; /* Index part of requested OID */
 
-  for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next) {
-    table_definition_t *td = te->value;
+  for (size_t pos = snmp_agent_table_row_find(td, column, &oid, next);
+       pos < td->rows_num; pos++) {
+    table_row_t *row = td->rows[pos];
+    int ret;
 
-    for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
-      data_definition_t *dd = de->value;
+    if (dd == NULL) {
+      long index = row->index;
 
-      for (size_t i = 0; i < dd->oids_len; i++) {
-        int ret = snmp_oid_ncompare(oid.oid, oid.oid_len, dd->oids[i].oid,
-                                    dd->oids[i].oid_len,
-                                    SNMP_MIN(oid.oid_len, dd->oids[i].oid_len));
-        if (ret != 0)
-          continue;
-
-        /* Calculating OID length for index part */
-        index_oid.oid_len = oid.oid_len - dd->oids[i].oid_len;
-        /* Fetching index part of the OID */
-        memcpy(index_oid.oid, &oid.oid[dd->oids[i].oid_len],
-               index_oid.oid_len * sizeof(*oid.oid));
-
-        char index_str[DATA_MAX_NAME_LEN];
-        snmp_agent_oid_to_string(index_str, sizeof(index_str), &index_oid);
-
-        if (!td->index_oid.oid_len) {
-          ret = c_avl_get(td->instance_index, &index_oid, NULL);
-        } else {
-          oid_t *temp_oid;
-
-          assert(index_oid.oid_len == 1);
-          ret = c_avl_get(td->index_instance, (int *)&index_oid.oid[0],
-                          (void **)&temp_oid);
-          memcpy(&index_oid, temp_oid, sizeof(index_oid));
-        }
+      request->requestvb->type = ASN_INTEGER;
+      snmp_set_var_typed_value(request->requestvb, request->requestvb->type,
+                               (const u_char *)&index, sizeof(index));
+      ret = SNMP_ERR_NOERROR;
+    } else if (!dd->is_index_key &&
+               (c_avl_get(dd->names, row->instance, NULL) != 0)) {
+      /* This column has no values for the row */
+      ret = SNMP_NOSUCHINSTANCE;
+    } else {
+      ret = snmp_agent_form_reply(request, dd, row->instance, (int)oid_index);
+    }
 
-        if (ret != 0) {
-          INFO(PLUGIN_NAME ": Non-existing index (%s) requested", index_str);
-          pthread_mutex_unlock(&g_agent->lock);
+    if (ret == SNMP_ERR_NOERROR) {
+      if (next) {
+        oid_t next_oid = *column;
+        if (snmp_agent_table_row_oid(td, row, &next_oid) != 0)
           return SNMP_NOSUCHINSTANCE;
-        }
-
-        ret = snmp_agent_form_reply(requests, dd, &index_oid, i);
-        pthread_mutex_unlock(&g_agent->lock);
-
-        return ret;
+        snmp_set_var_objid(request->requestvb, next_oid.oid,
+                           next_oid.oid_len);
       }
+      return SNMP_ERR_NOERROR;
     }
-  }
 
-  pthread_mutex_unlock(&g_agent->lock);
+    if (!next)
+      return ret;
+  }
 
   return SNMP_NOSUCHINSTANCE;
 }
 
-static int snmp_agent_table_index_oid_handler(
-    struct netsnmp_mib_handler_s *handler,
-    struct netsnmp_handler_registration_s *reginfo,
+/* Handles the requests for a table's column, registered as a whole. A GETNEXT
+ * request without a following row is left unanswered, so that the agent
+ * continues with the next registered subtree. */
+static int snmp_agent_table_column_requests(
     struct netsnmp_agent_request_info_s *reqinfo,
-    struct netsnmp_request_info_s *requests) {
-
-  if (reqinfo->mode != MODE_GET) {
+    struct netsnmp_request_info_s *requests, table_definition_t *td,
+    data_definition_t *dd, size_t oid_index, oid_t const *column) {
+  if ((reqinfo->mode != MODE_GET) && (reqinfo->mode != MODE_GETNEXT)) {
     DEBUG(PLUGIN_NAME ": Not supported request mode (%d)", reqinfo->mode);
     return SNMP_ERR_NOERROR;
   }
 
+  bool next = (reqinfo->mode == MODE_GETNEXT);
+
   pthread_mutex_lock(&g_agent->lock);
 
-  oid_t oid;
-  memcpy(oid.oid, requests->requestvb->name,
-         sizeof(oid.oid[0]) * requests->requestvb->name_length);
-  oid.oid_len = requests->requestvb->name_length;
+  if (snmp_agent_table_rows_update(td) != 0) {
+    pthread_mutex_unlock(&g_agent->lock);
+    return SNMP_ERR_GENERR;
+  }
 
-  for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next) {
-    table_definition_t *td = te->value;
+  for (struct netsnmp_request_info_s *request = requests; request != NULL;
+       request = request->next) {
+    if (request->processed)
+      continue;
 
-    if (td->index_oid.oid_len &&
-        (snmp_oid_ncompare(
-             oid.oid, oid.oid_len, td->index_oid.oid, td->index_oid.oid_len,
-             SNMP_MIN(oid.oid_len, td->index_oid.oid_len)) == 0)) {
+    int ret =
+        snmp_agent_table_request(request, td, dd, oid_index, column, next);
+    if ((ret != SNMP_ERR_NOERROR) && !next)
+      netsnmp_set_request_error(reqinfo, request, ret);
+  }
 
-      DEBUG(PLUGIN_NAME ": Handle '%s' table index OID", td->name);
+  pthread_mutex_unlock(&g_agent->lock);
 
-      int index = oid.oid[oid.oid_len - 1];
+  return SNMP_ERR_NOERROR;
+}
 
-      int ret = c_avl_get(td->index_instance, &index, NULL);
-      if (ret != 0) {
-        /* nonexisting index requested */
-        pthread_mutex_unlock(&g_agent->lock);
-        return SNMP_NOSUCHINSTANCE;
-      }
+static int
+snmp_agent_table_oid_handler(struct netsnmp_mib_handler_s *handler,
+                             struct netsnmp_handler_registration_s *reginfo,
+                             struct netsnmp_agent_request_info_s *reqinfo,
+                             struct netsnmp_request_info_s *requests) {
+  data_definition_t *dd = reginfo->my_reg_void;
 
-      requests->requestvb->type = ASN_INTEGER;
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               (const u_char *)&index, sizeof(index));
+  for (size_t i = 0; i < dd->oids_len; i++) {
+    if (snmp_oid_compare(reginfo->rootoid, reginfo->rootoid_len,
+                         dd->oids[i].oid, dd->oids[i].oid_len) == 0)
+      /* The table is only modified with g_agent->lock held */
+      return snmp_agent_table_column_requests(
+          reqinfo, requests, (table_definition_t *)dd->table, dd, i,
+          &dd->oids[i]);
+  }
 
-      pthread_mutex_unlock(&g_agent->lock);
+  return SNMP_ERR_NOERROR;
+}
 
-      return SNMP_ERR_NOERROR;
-    }
-  }
+static int snmp_agent_table_index_oid_handler(
+    struct netsnmp_mib_handler_s *handler,
+    struct netsnmp_handler_registration_s *reginfo,
+    struct netsnmp_agent_request_info_s *reqinfo,
+    struct netsnmp_request_info_s *requests) {
+  table_definition_t *td = reginfo->my_reg_void;
 
-  pthread_mutex_unlock(&g_agent->lock);
+  DEBUG(PLUGIN_NAME ": Handle '%s' table index OID", td->name);
 
-  return SNMP_NOSUCHINSTANCE;
+  return snmp_agent_table_column_requests(reqinfo, requests, td, NULL, 0,
+                                          &td->index_oid);
 }
 
 static int snmp_agent_table_size_oid_handler(
@@ -1374,12 +1409,24 @@ static int snmp_agent_register_table_oids(void) {
         return ret;
     }
 
+    if (td->index_oid.oid_len != 0) {
+      int ret = snmp_agent_register_subtree(
+          &td->index_oid, snmp_agent_table_index_oid_handler, td);
+      if (ret != 0)
+        return ret;
+    }
+
     for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
       data_definition_t *dd = de->value;
 
       for (size_t i = 0; i < dd->oids_len; i++) {
         dd->oids[i].type =
             snmp_agent_get_asn_type(dd->oids[i].oid, dd->oids[i].oid_len);
+
+        int ret = snmp_agent_register_subtree(
+            &dd->oids[i], snmp_agent_table_oid_handler, dd);
+        if (ret != 0)
+          return ret;
       }
     }
   }
@@ -1651,6 +1698,12 @@ static int snmp_agent_config_table_column(table_definition_t *td,
       snmp_agent_free_data(&dd);
       return -1;
     }
+  } else if (td != NULL) {
+    dd->names = c_avl_create((int (*)(const void *, const void *))oid_compare);
+    if (dd->names == NULL) {
+      snmp_agent_free_data(&dd);
+      return -ENOMEM;
+    }
   }
 
   llentry_t *entry = llentry_create(dd->name, dd);
@@ -1856,54 +1909,35 @@ static int snmp_agent_set_vardata(void *data, size_t *data_len, u_char asn_type,
   return 0;
 }
 
-static int snmp_agent_register_oid_index(oid_t *oid, int index,
-                                         Netsnmp_Node_Handler *handler) {
-  oid_t new_oid;
-  memcpy(&new_oid, oid, sizeof(*oid));
-  new_oid.oid[new_oid.oid_len++] = index;
-  return snmp_agent_register_oid(&new_oid, handler);
-}
-
-static int snmp_agent_unregister_oid_index(oid_t *oid, int index) {
-  oid_t new_oid;
-  memcpy(&new_oid, oid, sizeof(*oid));
-  new_oid.oid[new_oid.oid_len++] = index;
-  return snmp_agent_unregister_oid(&new_oid);
-}
-
-static int snmp_agent_update_instance_oids(c_avl_tree_t *tree, oid_t *index_oid,
-                                           int value) {
-  int *oids_num; /* number of oids registered for instance */
-
-  if (c_avl_get(tree, index_oid, (void **)&oids_num) == 0) {
-    *oids_num += value;
-    return *oids_num;
-  } else {
-    ERROR(PLUGIN_NAME ": Error updating index data");
-    return -1;
-  }
-}
-
 static int snmp_agent_update_index(data_definition_t *dd,
                                    table_definition_t *td, oid_t *index_oid,
                                    bool *free_index_oid) {
   int ret;
   int *index = NULL;
-  int *value = NULL;
+  table_row_t *row = NULL;
 
-  if (c_avl_get(td->instance_index, (void *)index_oid, (void **)&index) != 0) {
+  if (c_avl_get(td->instance_oids, (void *)index_oid, (void **)&row) != 0) {
     /* We'll keep index_oid stored in AVL tree */
     *free_index_oid = false;
 
+    row = calloc(1, sizeof(*row));
+    if (row == NULL) {
+      ERROR(PLUGIN_NAME ": Failed to allocate memory");
+      ret = -ENOMEM;
+      goto error;
+    }
+    row->instance = index_oid;
+
     /* need to generate index for the table */
     if (td->index_oid.oid_len) {
       index = calloc(1, sizeof(*index));
       if (index == NULL) {
         ret = -ENOMEM;
-        goto error;
+        goto free_row;
       }
 
       *index = c_avl_size(td->instance_index) + 1;
+      row->index = *index;
 
       ret = c_avl_insert(td->instance_index, index_oid, index);
       if (ret != 0)
@@ -1915,113 +1949,80 @@ static int snmp_agent_update_index(data_definition_t *dd,
               td->name);
         goto remove_avl_index_oid;
       }
-
-      ret = snmp_agent_register_oid_index(&td->index_oid, *index,
-                                          snmp_agent_table_index_oid_handler);
-      if (ret != 0)
-        goto remove_avl_index;
     } else {
       /* instance as a key is required for any table */
       ret = c_avl_insert(td->instance_index, index_oid, NULL);
       if (ret != 0)
-        goto error;
-    }
-
-    value = calloc(1, sizeof(*value));
-
-    if (value == NULL) {
-      ERROR(PLUGIN_NAME ": Failed to allocate memory");
-      ret = -ENOMEM;
-      goto unregister_index;
+        goto free_row;
     }
 
-    ret = c_avl_insert(td->instance_oids, index_oid, value);
-
+    ret = c_avl_insert(td->instance_oids, index_oid, row);
     if (ret < 0) {
       DEBUG(PLUGIN_NAME ": Failed to update instance_oids for '%s' table",
             td->name);
-      goto free_value;
+      goto remove_avl_index;
     }
 
-    int keys_processed = 0;
+    td->rows_dirty = true;
+  }
 
-    /* Registering index keys OIDs */
-    for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
-      data_definition_t *idd = de->value;
-      if (!idd->is_index_key)
-        continue;
+  /* The column already has values for this row */
+  if (c_avl_get(dd->names, index_oid, NULL) == 0)
+    return 0;
 
-      for (size_t i = 0; i < idd->oids_len; i++) {
-        if (td->index_oid.oid_len)
-          ret = snmp_agent_register_oid_index(&idd->oids[i], *index,
-                                              snmp_agent_table_oid_handler);
-        else
-          ret = snmp_agent_register_oid_string(&idd->oids[i], index_oid,
-                                               snmp_agent_table_oid_handler);
-
-        if (ret != 0) {
-          ERROR(PLUGIN_NAME ": Could not register OID");
-          goto free_index;
-        }
-      }
+  /* The identifier is needed for every request of this row and column, so it
+   * is only formatted once. */
+  char name[DATA_MAX_NAME_LEN];
+  char *name_copy = NULL;
 
-      if (++keys_processed >= td->index_keys_len)
-        break;
-    }
+  ret = snmp_agent_format_name(name, sizeof(name), dd, row->instance);
+  if (ret == 0) {
+    name_copy = strdup(name);
+    if ((name_copy == NULL) ||
+        (c_avl_insert(dd->names, row->instance, name_copy) != 0))
+      ret = -ENOMEM;
   }
 
-  ret = 0;
-
-  for (size_t i = 0; i < dd->oids_len; i++) {
-    if (td->index_oid.oid_len)
-      ret = snmp_agent_register_oid_index(&dd->oids[i], *index,
-                                          snmp_agent_table_oid_handler);
-    else
-      ret = snmp_agent_register_oid_string(&dd->oids[i], index_oid,
-                                           snmp_agent_table_oid_handler);
-
-    if (ret < 0)
-      goto free_index;
-    else if (ret == OID_EXISTS)
-      break;
-    else if (snmp_agent_update_instance_oids(td->instance_oids, index_oid, 1) <
-             0)
-      goto free_index;
+  if (ret != 0) {
+    ERROR(PLUGIN_NAME ": Failed to add data to table %s", td->name);
+    sfree(name_copy);
+    if (row->columns == 0) {
+      /* Frees index_oid if the row has just been created */
+      *free_index_oid = (row->instance != index_oid);
+      snmp_agent_table_row_remove(td, row);
+    }
+    return ret;
   }
 
-  if (ret != OID_EXISTS) {
-    char index_str[DATA_MAX_NAME_LEN];
+  row->columns++;
 
-    if (index == NULL)
-      snmp_agent_oid_to_string(index_str, sizeof(index_str), index_oid);
-    else
-      snprintf(index_str, sizeof(index_str), "%d", *index);
+  char index_str[DATA_MAX_NAME_LEN];
 
-    notification_t n = {
-        .severity = NOTIF_OKAY, .time = cdtime(), .plugin = PLUGIN_NAME};
-    sstrncpy(n.host, hostname_g, sizeof(n.host));
-    snprintf(n.message, sizeof(n.message),
-             "Data added to table %s with index %s", td->name, index_str);
-    DEBUG(PLUGIN_NAME ": %s", n.message);
+  if (td->index_oid.oid_len)
+    snprintf(index_str, sizeof(index_str), "%d", row->index);
+  else
+    snmp_agent_oid_to_string(index_str, sizeof(index_str), index_oid);
 
-    plugin_dispatch_notification(&n);
-  }
+  notification_t n = {
+      .severity = NOTIF_OKAY, .time = cdtime(), .plugin = PLUGIN_NAME};
+  sstrncpy(n.host, hostname_g, sizeof(n.host));
+  snprintf(n.message, sizeof(n.message),
+           "Data added to table %s with index %s", td->name, index_str);
+  DEBUG(PLUGIN_NAME ": %s", n.message);
+
+  plugin_dispatch_notification(&n);
 
   return 0;
 
-free_value:
-  sfree(value);
-unregister_index:
-  if (td->index_oid.oid_len)
-    snmp_agent_unregister_oid_index(index_oid, *index);
 remove_avl_index:
   if (td->index_oid.oid_len)
     c_avl_remove(td->index_instance, index, NULL, NULL);
 remove_avl_index_oid:
   c_avl_remove(td->instance_index, index_oid, NULL, NULL);
 free_index:
-  if (index != NULL)
-    sfree(index);
+  sfree(index);
+free_row:
+  sfree(row);
 error:
   *free_index_oid = true;
 
@@ -2253,6 +2254,47 @@ static int snmp_agent_register_oid(oid_t *oid, Netsnmp_Node_Handler *handler) {
   return 0;
 }
 
+/* Registers `handler' for all OIDs below `oid', passing it `arg'. Used for
+ * table columns, whose rows are looked up by the handlers. */
+static int snmp_agent_register_subtree(oid_t *oid,
+                                       Netsnmp_Node_Handler *handler,
+                                       void *arg) {
+  char *oid_name = snmp_agent_get_oid_name(oid->oid, oid->oid_len);
+  char oid_str[DATA_MAX_NAME_LEN];
+
+  snmp_agent_oid_to_string(oid_str, sizeof(oid_str), oid);
+
+  if (oid_name == NULL) {
+    WARNING(PLUGIN_NAME
+            ": Skipped registration: OID (%s) is not found in main tree",
+            oid_str);
+    return 0;
+  }
+
+  netsnmp_handler_registration *reg = netsnmp_create_handler_registration(
+      oid_name, handler, oid->oid, oid->oid_len, HANDLER_CAN_RONLY);
+  if (reg == NULL) {
+    ERROR(PLUGIN_NAME ": Failed to create handler registration for OID (%s)",
+          oid_str);
+    return -1;
+  }
+  reg->my_reg_void = arg;
+
+  pthread_mutex_lock(&g_agent->agentx_lock);
+
+  if (netsnmp_register_handler(reg) != MIB_REGISTERED_OK) {
+    ERROR(PLUGIN_NAME ": Failed to register handler for OID (%s)", oid_str);
+    pthread_mutex_unlock(&g_agent->agentx_lock);
+    return -1;
+  }
+
+  pthread_mutex_unlock(&g_agent->agentx_lock);
+
+  DEBUG(PLUGIN_NAME ": Registered handler for OID subtree (%s)", oid_str);
+
+  return 0;
+}
+
 static int snmp_agent_free_config(void) {
 
   if (g_agent == NULL)
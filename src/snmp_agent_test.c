@@ -784,6 +784,60 @@ DEF_TEST(build_name) {
   return 0;
 }
 
+DEF_TEST(table_rows) {
+  table_definition_t *td = calloc(1, sizeof(*td));
+  oid_t instances[] = {
+      {.oid = {2}, .oid_len = 1},
+      {.oid = {1, 5}, .oid_len = 2},
+      {.oid = {1, 3}, .oid_len = 2},
+  };
+  table_row_t rows[STATIC_ARRAY_SIZE(instances)] = {{0}};
+  oid_t column = {.oid = {1, 3, 6, 1, 4}, .oid_len = 5};
+
+  td->instance_oids =
+      c_avl_create((int (*)(const void *, const void *))oid_compare);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(instances); i++) {
+    rows[i].instance = &instances[i];
+    CHECK_ZERO(c_avl_insert(td->instance_oids, &instances[i], &rows[i]));
+  }
+  td->rows_dirty = true;
+
+  EXPECT_EQ_INT(0, snmp_agent_table_rows_update(td));
+  EXPECT_EQ_UINT64(3, td->rows_num);
+  OK(td->rows[0] == &rows[2]);
+  OK(td->rows[1] == &rows[1]);
+  OK(td->rows[2] == &rows[0]);
+
+  struct {
+    oid_t req;
+    bool next;
+    size_t want;
+  } cases[] = {
+      /* Exact matches */
+      {{.oid = {1, 3, 6, 1, 4, 1, 5}, .oid_len = 7}, false, 1},
+      {{.oid = {1, 3, 6, 1, 4, 1, 4}, .oid_len = 7}, false, 3},
+      {{.oid = {1, 3, 6, 1, 4}, .oid_len = 5}, false, 3},
+      /* Walking the column */
+      {{.oid = {1, 3, 6}, .oid_len = 3}, true, 0},
+      {{.oid = {1, 3, 6, 1, 4}, .oid_len = 5}, true, 0},
+      {{.oid = {1, 3, 6, 1, 4, 1}, .oid_len = 6}, true, 0},
+      {{.oid = {1, 3, 6, 1, 4, 1, 3}, .oid_len = 7}, true, 1},
+      {{.oid = {1, 3, 6, 1, 4, 1, 4}, .oid_len = 7}, true, 1},
+      {{.oid = {1, 3, 6, 1, 4, 2}, .oid_len = 6}, true, 3},
+      {{.oid = {1, 3, 6, 1, 5}, .oid_len = 5}, true, 3},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    EXPECT_EQ_UINT64(cases[i].want,
+                     snmp_agent_table_row_find(td, &column, &cases[i].req,
+                                               cases[i].next));
+
+  c_avl_destroy(td->instance_oids);
+  sfree(td->rows);
+  sfree(td);
+  return 0;
+}
+
 int main(void) {
   /* snmp_agent_oid_to_string */
   RUN_TEST(oid_to_string);
@@ -827,5 +881,8 @@ int main(void) {
   /* snmp_agent_build_name */
   RUN_TEST(build_name);
 
+  /* snmp_agent_table_rows_update, snmp_agent_table_row_find */
+  RUN_TEST(table_rows);
+
   END_TEST;
 }
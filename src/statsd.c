@@ -24,15 +24,17 @@
  *   Florian octo Forster <octo at collectd.org>
  */
 
+#define _GNU_SOURCE /* For recvmmsg(2) */
+
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils/latency/latency.h"
+#include "utils/sketch/sketch.h"
 
 #include <netdb.h>
-#include <poll.h>
 #include <sys/types.h>
 
 /* AIX doesn't have MSG_DONTWAIT */
@@ -48,25 +50,54 @@
 #define STATSD_DEFAULT_SERVICE "8125"
 #endif
 
+/* Number of packets read with one recvmmsg(2) call, and their maximum size. */
+#define STATSD_BATCH_SIZE 32
+#define STATSD_PACKET_SIZE 4096
+
+/* Number of independently locked partitions of the metrics table. */
+#define STATSD_SHARDS 16
+#define STATSD_SHARD_BUCKETS_MIN 64
+
 enum metric_type_e { STATSD_COUNTER, STATSD_TIMER, STATSD_GAUGE, STATSD_SET };
 typedef enum metric_type_e metric_type_t;
 
+struct statsd_metric_s;
+typedef struct statsd_metric_s statsd_metric_t;
 struct statsd_metric_s {
+  char *name;
+  uint64_t hash;
   metric_type_t type;
   double value;
   derive_t counter;
   latency_counter_t *latency;
-  c_avl_tree_t *set;
+  c_btree_t *set;
+  c_hll_t *hll;
   unsigned long updates_num;
+
+  statsd_metric_t *next;
 };
-typedef struct statsd_metric_s statsd_metric_t;
 
-static c_avl_tree_t *metrics_tree;
+/* Metrics are spread over STATSD_SHARDS hash tables by the hash of their name
+ * and type. Each shard has its own lock, so that receive threads only contend
+ * when they update metrics in the same shard. */
+typedef struct {
+  pthread_mutex_t lock;
+  statsd_metric_t **buckets;
+  size_t buckets_num; /* power of two */
+  size_t metrics_num;
+} statsd_shard_t;
+
+static statsd_shard_t metrics_shards[STATSD_SHARDS];
+
+/* Protects the state below, i.e. the listening sockets. */
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool metrics_shards_initialized;
 
-static pthread_t network_thread;
-static bool network_thread_running;
-static bool network_thread_shutdown;
+/* The sockets registered with plugin_register_fd(). */
+static int *network_fds;
+static size_t network_fds_num;
+
+static int conf_receive_threads = 1;
 
 static char *conf_node;
 static char *conf_service;
@@ -78,6 +109,10 @@ static bool conf_delete_sets;
 
 static double *conf_timer_percentile;
 static size_t conf_timer_percentile_num;
+/* If non-zero, timers use a sketch with this relative accuracy. */
+static double conf_timer_accuracy;
+/* If non-zero, sets are counted by a HyperLogLog with this precision. */
+static unsigned int conf_set_precision;
 
 static bool conf_counter_sum;
 static bool conf_timer_lower;
@@ -85,102 +120,154 @@ static bool conf_timer_upper;
 static bool conf_timer_sum;
 static bool conf_timer_count;
 
-/* Must hold metrics_lock when calling this function. */
-static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
-                                                    metric_type_t type) {
-  char key[DATA_MAX_NAME_LEN + 2];
-  char *key_copy;
+static uint64_t statsd_metric_hash(char const *name, /* {{{ */
+                                   metric_type_t type) {
+  /* FNV-1a */
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (char const *c = name; *c != 0; c++)
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+
+  return (hash ^ (uint64_t)type) * 1099511628211ULL;
+} /* }}} uint64_t statsd_metric_hash */
+
+static statsd_shard_t *statsd_shard_get(uint64_t hash) /* {{{ */
+{
+  /* The low bits select the bucket within the shard. */
+  return &metrics_shards[(hash >> 56) % STATSD_SHARDS];
+} /* }}} statsd_shard_t *statsd_shard_get */
+
+/* Must hold the shard's lock when calling this function. */
+static int statsd_shard_grow_unsafe(statsd_shard_t *shard) /* {{{ */
+{
+  size_t buckets_num = (shard->buckets_num > 0) ? (2 * shard->buckets_num)
+                                                : STATSD_SHARD_BUCKETS_MIN;
+
+  statsd_metric_t **buckets = calloc(buckets_num, sizeof(*buckets));
+  if (buckets == NULL) {
+    ERROR("statsd plugin: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < shard->buckets_num; i++) {
+    while (shard->buckets[i] != NULL) {
+      statsd_metric_t *metric = shard->buckets[i];
+      shard->buckets[i] = metric->next;
+
+      size_t b = (size_t)metric->hash & (buckets_num - 1);
+      metric->next = buckets[b];
+      buckets[b] = metric;
+    }
+  }
+
+  sfree(shard->buckets);
+  shard->buckets = buckets;
+  shard->buckets_num = buckets_num;
+  return 0;
+} /* }}} int statsd_shard_grow_unsafe */
+
+/* Looks up the metric, creating it if necessary. Upon success, the metric's
+ * shard is returned in "ret_shard" and its lock is held; the caller has to
+ * release it. Upon failure, NULL is returned and no lock is held. */
+static statsd_metric_t *statsd_metric_lookup(char const *name_orig, /* {{{ */
+                                             metric_type_t type,
+                                             statsd_shard_t **ret_shard) {
+  char name[DATA_MAX_NAME_LEN];
   statsd_metric_t *metric;
-  int status;
 
   switch (type) {
   case STATSD_COUNTER:
-    key[0] = 'c';
-    break;
   case STATSD_TIMER:
-    key[0] = 't';
-    break;
   case STATSD_GAUGE:
-    key[0] = 'g';
-    break;
   case STATSD_SET:
-    key[0] = 's';
     break;
   default:
     return NULL;
   }
 
-  key[1] = ':';
-  sstrncpy(&key[2], name, sizeof(key) - 2);
+  sstrncpy(name, name_orig, sizeof(name));
+  uint64_t hash = statsd_metric_hash(name, type);
+  statsd_shard_t *shard = statsd_shard_get(hash);
 
-  status = c_avl_get(metrics_tree, key, (void *)&metric);
-  if (status == 0)
-    return metric;
+  pthread_mutex_lock(&shard->lock);
 
-  key_copy = strdup(key);
-  if (key_copy == NULL) {
-    ERROR("statsd plugin: strdup failed.");
+  if (shard->buckets != NULL) {
+    metric = shard->buckets[(size_t)hash & (shard->buckets_num - 1)];
+    for (; metric != NULL; metric = metric->next) {
+      if ((metric->hash == hash) && (metric->type == type) &&
+          (strcmp(metric->name, name) == 0)) {
+        *ret_shard = shard;
+        return metric;
+      }
+    }
+  }
+
+  if ((shard->metrics_num >= 2 * shard->buckets_num) &&
+      (statsd_shard_grow_unsafe(shard) != 0)) {
+    pthread_mutex_unlock(&shard->lock);
     return NULL;
   }
 
   metric = calloc(1, sizeof(*metric));
   if (metric == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: calloc failed.");
-    sfree(key_copy);
     return NULL;
   }
 
+  metric->name = strdup(name);
+  if (metric->name == NULL) {
+    pthread_mutex_unlock(&shard->lock);
+    ERROR("statsd plugin: strdup failed.");
+    sfree(metric);
+    return NULL;
+  }
+
+  metric->hash = hash;
   metric->type = type;
   metric->latency = NULL;
   metric->set = NULL;
+  metric->hll = NULL;
 
-  status = c_avl_insert(metrics_tree, key_copy, metric);
-  if (status != 0) {
-    ERROR("statsd plugin: c_avl_insert failed.");
-    sfree(key_copy);
-    sfree(metric);
-    return NULL;
-  }
+  size_t b = (size_t)hash & (shard->buckets_num - 1);
+  metric->next = shard->buckets[b];
+  shard->buckets[b] = metric;
+  shard->metrics_num++;
 
+  *ret_shard = shard;
   return metric;
-} /* }}} statsd_metric_lookup_unsafe */
+} /* }}} statsd_metric_lookup */
 
 static int statsd_metric_set(char const *name, double value, /* {{{ */
                              metric_type_t type) {
+  statsd_shard_t *shard;
   statsd_metric_t *metric;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, type, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value = value;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* }}} int statsd_metric_set */
 
 static int statsd_metric_add(char const *name, double delta, /* {{{ */
                              metric_type_t type) {
+  statsd_shard_t *shard;
   statsd_metric_t *metric;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, type, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value += delta;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* }}} int statsd_metric_add */
@@ -199,15 +286,19 @@ static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
     void *key;
     void *value;
 
-    while (c_avl_pick(metric->set, &key, &value) == 0) {
+    while (c_btree_pick(metric->set, &key, &value) == 0) {
       sfree(key);
       assert(value == NULL);
     }
 
-    c_avl_destroy(metric->set);
+    c_btree_destroy(metric->set);
     metric->set = NULL;
   }
 
+  c_hll_destroy(metric->hll);
+  metric->hll = NULL;
+
+  sfree(metric->name);
   sfree(metric);
 } /* }}} void statsd_metric_free */
 
@@ -270,6 +361,7 @@ static int statsd_handle_gauge(char const *name, /* {{{ */
 
 static int statsd_handle_timer(char const *name, /* {{{ */
                                char const *value_str, char const *extra) {
+  statsd_shard_t *shard;
   statsd_metric_t *metric;
   value_t value_ms;
   value_t scale;
@@ -296,63 +388,75 @@ static int statsd_handle_timer(char const *name, /* {{{ */
 
   value = MS_TO_CDTIME_T(value_ms.gauge / scale.gauge);
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_TIMER);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, STATSD_TIMER, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
-  if (metric->latency == NULL)
+  if ((metric->latency == NULL) && (conf_timer_accuracy > 0.0))
+    metric->latency = latency_counter_create_sketch(conf_timer_accuracy);
+  else if (metric->latency == NULL)
     metric->latency = latency_counter_create();
   if (metric->latency == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -1;
   }
 
   latency_counter_add(metric->latency, value);
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 } /* }}} int statsd_handle_timer */
 
 static int statsd_handle_set(char const *name, /* {{{ */
                              char const *set_key_orig) {
+  statsd_shard_t *shard;
   statsd_metric_t *metric = NULL;
   char *set_key;
   int status;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_SET);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, STATSD_SET, &shard);
+  if (metric == NULL)
     return -1;
+
+  /* The HyperLogLog only keeps the hash of the member. */
+  if (conf_set_precision != 0) {
+    if (metric->hll == NULL)
+      metric->hll = c_hll_create(conf_set_precision);
+    if (metric->hll == NULL) {
+      pthread_mutex_unlock(&shard->lock);
+      ERROR("statsd plugin: c_hll_create failed.");
+      return -1;
+    }
+
+    c_hll_add(metric->hll, statsd_metric_hash(set_key_orig, STATSD_SET));
+    metric->updates_num++;
+
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
   }
 
   /* Make sure metric->set exists. */
   if (metric->set == NULL)
-    metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
+    metric->set = c_btree_create((int (*)(const void *, const void *))strcmp);
 
   if (metric->set == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    ERROR("statsd plugin: c_avl_create failed.");
+    pthread_mutex_unlock(&shard->lock);
+    ERROR("statsd plugin: c_btree_create failed.");
     return -1;
   }
 
   set_key = strdup(set_key_orig);
   if (set_key == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: strdup failed.");
     return -1;
   }
 
-  status = c_avl_insert(metric->set, set_key, /* value = */ NULL);
+  status = c_btree_insert(metric->set, set_key, /* value = */ NULL);
   if (status < 0) {
-    pthread_mutex_unlock(&metrics_lock);
-    ERROR("statsd plugin: c_avl_insert (\"%s\") failed with status %i.",
+    pthread_mutex_unlock(&shard->lock);
+    ERROR("statsd plugin: c_btree_insert (\"%s\") failed with status %i.",
           set_key, status);
     sfree(set_key);
     return -1;
@@ -363,7 +467,7 @@ static int statsd_handle_set(char const *name, /* {{{ */
 
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 } /* }}} int statsd_handle_set */
 
@@ -437,13 +541,61 @@ static void statsd_parse_buffer(char *buffer) /* {{{ */
   }
 } /* }}} void statsd_parse_buffer */
 
-static void statsd_network_read(int fd) /* {{{ */
+/* A listening socket. Its buffer has room for STATSD_BATCH_SIZE *
+ * STATSD_PACKET_SIZE bytes. */
+typedef struct {
+  int fd;
+  char *buffer;
+} statsd_socket_t;
+
+static void statsd_socket_free(void *arg) /* {{{ */
+{
+  statsd_socket_t *sock = arg;
+
+  close(sock->fd);
+  sfree(sock->buffer);
+  sfree(sock);
+} /* }}} void statsd_socket_free */
+
+/* Called by the daemon's event loop. Reads up to STATSD_BATCH_SIZE packets
+ * from "fd" without blocking and parses them. */
+static void statsd_network_read(int fd, user_data_t *ud) /* {{{ */
 {
-  char buffer[4096];
+  statsd_socket_t *sock = ud->data;
+  char *buffer = sock->buffer;
+
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[STATSD_BATCH_SIZE];
+  struct iovec iov[STATSD_BATCH_SIZE];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < STATSD_BATCH_SIZE; i++) {
+    iov[i].iov_base = buffer + i * STATSD_PACKET_SIZE;
+    iov[i].iov_len = STATSD_PACKET_SIZE - 1;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int status = recvmmsg(fd, msgs, STATSD_BATCH_SIZE, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return;
+
+    ERROR("statsd plugin: recvmmsg(2) failed: %s", STRERRNO);
+    return;
+  }
+
+  for (int i = 0; i < status; i++) {
+    char *packet = buffer + i * STATSD_PACKET_SIZE;
+    packet[msgs[i].msg_len] = 0;
+    statsd_parse_buffer(packet);
+  }
+#else
   size_t buffer_size;
   ssize_t status;
 
-  status = recv(fd, buffer, sizeof(buffer), /* flags = */ MSG_DONTWAIT);
+  status = recv(fd, buffer, STATSD_PACKET_SIZE, /* flags = */ MSG_DONTWAIT);
   if (status < 0) {
 
     if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
@@ -454,16 +606,62 @@ static void statsd_network_read(int fd) /* {{{ */
   }
 
   buffer_size = (size_t)status;
-  if (buffer_size >= sizeof(buffer))
-    buffer_size = sizeof(buffer) - 1;
+  if (buffer_size >= STATSD_PACKET_SIZE)
+    buffer_size = STATSD_PACKET_SIZE - 1;
   buffer[buffer_size] = 0;
 
   statsd_parse_buffer(buffer);
+#endif
 } /* }}} void statsd_network_read */
 
-static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
-                               size_t *ret_fds_num) {
-  struct pollfd *fds = NULL;
+/* Hands "fd" to the daemon's event loop, which closes it once it has been
+ * unregistered. Must hold metrics_lock when calling this function. */
+static int statsd_network_register(int fd) /* {{{ */
+{
+  int *tmp =
+      realloc(network_fds, sizeof(*network_fds) * (network_fds_num + 1));
+  if (tmp == NULL) {
+    ERROR("statsd plugin: realloc failed.");
+    close(fd);
+    return ENOMEM;
+  }
+  network_fds = tmp;
+
+  statsd_socket_t *sock = calloc(1, sizeof(*sock));
+  if (sock == NULL) {
+    ERROR("statsd plugin: calloc failed.");
+    close(fd);
+    return ENOMEM;
+  }
+  sock->fd = fd;
+  sock->buffer = malloc(STATSD_BATCH_SIZE * STATSD_PACKET_SIZE);
+  if (sock->buffer == NULL) {
+    ERROR("statsd plugin: malloc failed.");
+    statsd_socket_free(sock);
+    return ENOMEM;
+  }
+
+  int status = plugin_register_fd(fd, statsd_network_read,
+                                  &(user_data_t){
+                                      .data = sock,
+                                      .free_func = statsd_socket_free,
+                                  });
+  if (status != 0) {
+    statsd_socket_free(sock);
+    return status;
+  }
+
+  network_fds[network_fds_num] = fd;
+  network_fds_num++;
+  return 0;
+} /* }}} int statsd_network_register */
+
+/* Opens one listening socket per address. With "reuse_port", the sockets are
+ * opened with SO_REUSEPORT so that further sockets can be opened for the same
+ * addresses and the kernel distributes packets among them. Must hold
+ * metrics_lock when calling this function. */
+static int statsd_network_init(bool reuse_port) /* {{{ */
+{
   size_t fds_num = 0;
 
   struct addrinfo *ai_list;
@@ -487,7 +685,6 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
     int fd;
-    struct pollfd *tmp;
 
     char str_node[NI_MAXHOST];
     char str_service[NI_MAXSERV];
@@ -506,6 +703,15 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
+#ifdef SO_REUSEPORT
+    if (reuse_port &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)) {
+      ERROR("statsd plugin: setsockopt (reuseport): %s", STRERRNO);
+      close(fd);
+      continue;
+    }
+#endif
+
     getnameinfo(ai_ptr->ai_addr, ai_ptr->ai_addrlen, str_node, sizeof(str_node),
                 str_service, sizeof(str_service),
                 NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
@@ -520,19 +726,10 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
-    tmp = realloc(fds, sizeof(*fds) * (fds_num + 1));
-    if (tmp == NULL) {
-      ERROR("statsd plugin: realloc failed.");
-      close(fd);
+    if (statsd_network_register(fd) != 0)
       continue;
-    }
-    fds = tmp;
-    tmp = fds + fds_num;
     fds_num++;
 
-    memset(tmp, 0, sizeof(*tmp));
-    tmp->fd = fd;
-    tmp->events = POLLIN | POLLPRI;
     INFO("statsd plugin: Listening on [%s]:%s.", str_node, str_service);
   }
 
@@ -544,51 +741,9 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
     return ENOENT;
   }
 
-  *ret_fds = fds;
-  *ret_fds_num = fds_num;
   return 0;
 } /* }}} int statsd_network_init */
 
-static void *statsd_network_thread(void *args) /* {{{ */
-{
-  struct pollfd *fds = NULL;
-  size_t fds_num = 0;
-  int status;
-
-  status = statsd_network_init(&fds, &fds_num);
-  if (status != 0) {
-    ERROR("statsd plugin: Unable to open listening sockets.");
-    pthread_exit((void *)0);
-  }
-
-  while (!network_thread_shutdown) {
-    status = poll(fds, (nfds_t)fds_num, /* timeout = */ -1);
-    if (status < 0) {
-
-      if ((errno == EINTR) || (errno == EAGAIN))
-        continue;
-
-      ERROR("statsd plugin: poll(2) failed: %s", STRERRNO);
-      break;
-    }
-
-    for (size_t i = 0; i < fds_num; i++) {
-      if ((fds[i].revents & (POLLIN | POLLPRI)) == 0)
-        continue;
-
-      statsd_network_read(fds[i].fd);
-      fds[i].revents = 0;
-    }
-  } /* while (!network_thread_shutdown) */
-
-  /* Clean up */
-  for (size_t i = 0; i < fds_num; i++)
-    close(fds[i].fd);
-  sfree(fds);
-
-  return (void *)0;
-} /* }}} void *statsd_network_thread */
-
 static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
 {
   double percent = NAN;
@@ -620,6 +775,56 @@ static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int statsd_config_timer_percentile */
 
+static int statsd_config_timer_accuracy(oconfig_item_t *ci) /* {{{ */
+{
+  double accuracy = NAN;
+
+  int status = cf_util_get_double(ci, &accuracy);
+  if (status != 0)
+    return status;
+
+  if (!(accuracy > 0.0) || !(accuracy < 1.0)) {
+    ERROR("statsd plugin: The value for \"%s\" must be between 0 and 1, "
+          "exclusively.",
+          ci->key);
+    return ERANGE;
+  }
+
+  conf_timer_accuracy = accuracy;
+  return 0;
+} /* }}} int statsd_config_timer_accuracy */
+
+static int statsd_config_set_accuracy(oconfig_item_t *ci) /* {{{ */
+{
+  double accuracy = NAN;
+
+  int status = cf_util_get_double(ci, &accuracy);
+  if (status != 0)
+    return status;
+
+  if (!(accuracy > 0.0) || !(accuracy < 1.0)) {
+    ERROR("statsd plugin: The value for \"%s\" must be between 0 and 1, "
+          "exclusively.",
+          ci->key);
+    return ERANGE;
+  }
+
+  /* The standard error of a HyperLogLog is 1.04 / sqrt(2^precision). */
+  unsigned int precision = C_HLL_PRECISION_MIN;
+  while ((precision < C_HLL_PRECISION_MAX) &&
+         (1.04 / sqrt(ldexp(1.0, (int)precision)) > accuracy))
+    precision++;
+
+  double error = 1.04 / sqrt(ldexp(1.0, (int)precision));
+  if (error > accuracy)
+    WARNING("statsd plugin: The smallest possible value for \"%s\" is %.3g, "
+            "which is used instead of %g.",
+            ci->key, error, accuracy);
+
+  conf_set_precision = precision;
+  return 0;
+} /* }}} int statsd_config_set_accuracy */
+
 static int statsd_config(oconfig_item_t *ci) /* {{{ */
 {
   for (int i = 0; i < ci->children_num; i++) {
@@ -649,40 +854,63 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &conf_timer_count);
     else if (strcasecmp("TimerPercentile", child->key) == 0)
       statsd_config_timer_percentile(child);
+    else if (strcasecmp("TimerRelativeAccuracy", child->key) == 0)
+      statsd_config_timer_accuracy(child);
+    else if (strcasecmp("SetRelativeAccuracy", child->key) == 0)
+      statsd_config_set_accuracy(child);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      cf_util_get_int(child, &conf_receive_threads);
     else
       ERROR("statsd plugin: The \"%s\" config option is not valid.",
             child->key);
   }
 
+  if (conf_receive_threads < 1) {
+    WARNING("statsd plugin: \"ReceiveThreads\" must be at least 1.");
+    conf_receive_threads = 1;
+  }
+#ifndef SO_REUSEPORT
+  if (conf_receive_threads > 1) {
+    WARNING("statsd plugin: \"ReceiveThreads\" requires SO_REUSEPORT, which "
+            "is not supported on this system. Using one thread.");
+    conf_receive_threads = 1;
+  }
+#endif
+
   return 0;
 } /* }}} int statsd_config */
 
 static int statsd_init(void) /* {{{ */
 {
   pthread_mutex_lock(&metrics_lock);
-  if (metrics_tree == NULL)
-    metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (!metrics_shards_initialized) {
+    for (size_t i = 0; i < STATSD_SHARDS; i++)
+      pthread_mutex_init(&metrics_shards[i].lock, /* attr = */ NULL);
+    metrics_shards_initialized = true;
+  }
 
-  if (!network_thread_running) {
-    int status;
+  /* With more than one socket per address, the event loop threads can read
+   * them in parallel. */
+  if (network_fds_num == 0) {
+    bool reuse_port = conf_receive_threads > 1;
+    for (int i = 0; i < conf_receive_threads; i++) {
+      if (statsd_network_init(reuse_port) != 0)
+        break;
+    }
 
-    status = pthread_create(&network_thread,
-                            /* attr = */ NULL, statsd_network_thread,
-                            /* args = */ NULL);
-    if (status != 0) {
+    if (network_fds_num == 0) {
       pthread_mutex_unlock(&metrics_lock);
-      ERROR("statsd plugin: pthread_create failed: %s", STRERRNO);
-      return status;
+      ERROR("statsd plugin: Unable to open listening sockets.");
+      return -1;
     }
   }
-  network_thread_running = true;
 
   pthread_mutex_unlock(&metrics_lock);
 
   return 0;
 } /* }}} int statsd_init */
 
-/* Must hold metrics_lock when calling this function. */
+/* Must hold the shard's lock when calling this function. */
 static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
 {
   void *key;
@@ -691,10 +919,13 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   if ((metric == NULL) || (metric->type != STATSD_SET))
     return EINVAL;
 
+  if (metric->hll != NULL)
+    c_hll_clear(metric->hll);
+
   if (metric->set == NULL)
     return 0;
 
-  while (c_avl_pick(metric->set, &key, &value) == 0) {
+  while (c_btree_pick(metric->set, &key, &value) == 0) {
     sfree(key);
     sfree(value);
   }
@@ -702,14 +933,17 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   return 0;
 } /* }}} int statsd_metric_clear_set_unsafe */
 
-/* Must hold metrics_lock when calling this function. */
+/* Must hold the shard's lock when calling this function. All metrics of one
+ * read share the timestamp "now". */
 static int statsd_metric_submit_unsafe(char const *name,
-                                       statsd_metric_t *metric) /* {{{ */
+                                       statsd_metric_t *metric,
+                                       cdtime_t now) /* {{{ */
 {
   value_list_t vl = VALUE_LIST_INIT;
 
   vl.values = &(value_t){.gauge = NAN};
   vl.values_len = 1;
+  vl.time = now;
   sstrncpy(vl.plugin, "statsd", sizeof(vl.plugin));
 
   if (metric->type == STATSD_GAUGE)
@@ -728,9 +962,6 @@ static int statsd_metric_submit_unsafe(char const *name,
   else if (metric->type == STATSD_TIMER) {
     bool have_events = (metric->updates_num > 0);
 
-    /* Make sure all timer metrics share the *same* timestamp. */
-    vl.time = cdtime();
-
     snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-average", name);
     vl.values[0].gauge =
         have_events
@@ -787,10 +1018,12 @@ static int statsd_metric_submit_unsafe(char const *name,
     latency_counter_reset(metric->latency);
     return 0;
   } else if (metric->type == STATSD_SET) {
-    if (metric->set == NULL)
+    if (metric->hll != NULL)
+      vl.values[0].gauge = nearbyint(c_hll_estimate(metric->hll));
+    else if (metric->set == NULL)
       vl.values[0].gauge = 0.0;
     else
-      vl.values[0].gauge = (gauge_t)c_avl_size(metric->set);
+      vl.values[0].gauge = (gauge_t)c_btree_size(metric->set);
   } else { /* STATSD_COUNTER */
     gauge_t delta = nearbyint(metric->value);
 
@@ -820,85 +1053,74 @@ static int statsd_metric_submit_unsafe(char const *name,
 
 static int statsd_read(void) /* {{{ */
 {
-  c_avl_iterator_t *iter;
-  char *name;
-  statsd_metric_t *metric;
+  cdtime_t now = cdtime();
 
-  char **to_be_deleted = NULL;
-  size_t to_be_deleted_num = 0;
+  for (size_t i = 0; i < STATSD_SHARDS; i++) {
+    statsd_shard_t *shard = &metrics_shards[i];
 
-  pthread_mutex_lock(&metrics_lock);
+    pthread_mutex_lock(&shard->lock);
 
-  if (metrics_tree == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    return 0;
-  }
+    for (size_t j = 0; j < shard->buckets_num; j++) {
+      statsd_metric_t **prev = &shard->buckets[j];
 
-  iter = c_avl_get_iterator(metrics_tree);
-  while (c_avl_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
-    if ((metric->updates_num == 0) &&
-        ((conf_delete_counters && (metric->type == STATSD_COUNTER)) ||
-         (conf_delete_timers && (metric->type == STATSD_TIMER)) ||
-         (conf_delete_gauges && (metric->type == STATSD_GAUGE)) ||
-         (conf_delete_sets && (metric->type == STATSD_SET)))) {
-      DEBUG("statsd plugin: Deleting metric \"%s\".", name);
-      strarray_add(&to_be_deleted, &to_be_deleted_num, name);
-      continue;
-    }
+      while (*prev != NULL) {
+        statsd_metric_t *metric = *prev;
 
-    /* Names have a prefix, e.g. "c:", which determines the (statsd) type.
-     * Remove this here. */
-    statsd_metric_submit_unsafe(name + 2, metric);
+        if ((metric->updates_num == 0) &&
+            ((conf_delete_counters && (metric->type == STATSD_COUNTER)) ||
+             (conf_delete_timers && (metric->type == STATSD_TIMER)) ||
+             (conf_delete_gauges && (metric->type == STATSD_GAUGE)) ||
+             (conf_delete_sets && (metric->type == STATSD_SET)))) {
+          DEBUG("statsd plugin: Deleting metric \"%s\".", metric->name);
+          *prev = metric->next;
+          shard->metrics_num--;
+          statsd_metric_free(metric);
+          continue;
+        }
 
-    /* Reset the metric. */
-    metric->updates_num = 0;
-    if (metric->type == STATSD_SET)
-      statsd_metric_clear_set_unsafe(metric);
-  }
-  c_avl_iterator_destroy(iter);
+        statsd_metric_submit_unsafe(metric->name, metric, now);
 
-  for (size_t i = 0; i < to_be_deleted_num; i++) {
-    int status;
+        /* Reset the metric. */
+        metric->updates_num = 0;
+        if (metric->type == STATSD_SET)
+          statsd_metric_clear_set_unsafe(metric);
 
-    status = c_avl_remove(metrics_tree, to_be_deleted[i], (void *)&name,
-                          (void *)&metric);
-    if (status != 0) {
-      ERROR("stats plugin: c_avl_remove (\"%s\") failed with status %i.",
-            to_be_deleted[i], status);
-      continue;
+        prev = &metric->next;
+      }
     }
 
-    sfree(name);
-    statsd_metric_free(metric);
+    pthread_mutex_unlock(&shard->lock);
   }
 
-  pthread_mutex_unlock(&metrics_lock);
-
-  strarray_free(to_be_deleted, to_be_deleted_num);
-
   return 0;
 } /* }}} int statsd_read */
 
 static int statsd_shutdown(void) /* {{{ */
 {
-  void *key;
-  void *value;
-
-  if (network_thread_running) {
-    network_thread_shutdown = true;
-    pthread_kill(network_thread, SIGTERM);
-    pthread_join(network_thread, /* retval = */ NULL);
-  }
-  network_thread_running = false;
-
   pthread_mutex_lock(&metrics_lock);
 
-  while (c_avl_pick(metrics_tree, &key, &value) == 0) {
-    sfree(key);
-    statsd_metric_free(value);
+  /* The sockets are closed by statsd_socket_free(). */
+  for (size_t i = 0; i < network_fds_num; i++)
+    plugin_unregister_fd(network_fds[i]);
+  sfree(network_fds);
+  network_fds_num = 0;
+
+  for (size_t i = 0; metrics_shards_initialized && (i < STATSD_SHARDS); i++) {
+    statsd_shard_t *shard = &metrics_shards[i];
+
+    pthread_mutex_lock(&shard->lock);
+    for (size_t j = 0; j < shard->buckets_num; j++) {
+      while (shard->buckets[j] != NULL) {
+        statsd_metric_t *metric = shard->buckets[j];
+        shard->buckets[j] = metric->next;
+        statsd_metric_free(metric);
+      }
+    }
+    sfree(shard->buckets);
+    shard->buckets_num = 0;
+    shard->metrics_num = 0;
+    pthread_mutex_unlock(&shard->lock);
   }
-  c_avl_destroy(metrics_tree);
-  metrics_tree = NULL;
 
   sfree(conf_node);
   sfree(conf_service);
@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/log_queue/log_queue.h"
 
 #if HAVE_SYSLOG_H
 #include <syslog.h>
@@ -39,9 +40,15 @@ static int log_level = LOG_DEBUG;
 static int log_level = LOG_INFO;
 #endif /* COLLECT_DEBUG */
 static int notif_severity;
+static size_t queue_length = LOG_QUEUE_LENGTH;
+static cdtime_t coalesce_interval = LOG_QUEUE_COALESCE_INTERVAL;
+
+/* Created by the init callback. Before that, messages are written by the
+ * caller. */
+static log_queue_t *queue;
 
 static const char *config_keys[] = {
-    "LogLevel", "NotifyLevel",
+    "LogLevel", "NotifyLevel", "QueueLength", "CoalesceInterval",
 };
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
@@ -57,20 +64,72 @@ static int sl_config(const char *key, const char *value) {
     notif_severity = parse_notif_severity(value);
     if (notif_severity < 0)
       return 1;
+  } else if (strcasecmp(key, "QueueLength") == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("syslog: invalid QueueLength [%s]", value);
+      return 1;
+    }
+    queue_length = (size_t)tmp;
+  } else if (strcasecmp(key, "CoalesceInterval") == 0) {
+    double tmp = atof(value);
+    if (tmp < 0.0) {
+      ERROR("syslog: invalid CoalesceInterval [%s]", value);
+      return 1;
+    }
+    coalesce_interval = DOUBLE_TO_CDTIME_T(tmp);
   }
 
   return 0;
 } /* int sl_config */
 
+static void sl_write(log_queue_entry_t const *e,
+                     void __attribute__((unused)) * arg) {
+  syslog(e->severity, "%s", e->msg);
+} /* void sl_write */
+
 static void sl_log(int severity, const char *msg,
                    user_data_t __attribute__((unused)) * user_data) {
   if (severity > log_level)
     return;
 
-  syslog(severity, "%s", msg);
+  if (queue == NULL)
+    syslog(severity, "%s", msg);
+  else
+    log_queue_push(queue, severity, cdtime(), msg);
 } /* void sl_log */
 
+static int sl_init(void) {
+  if (queue != NULL)
+    return 0;
+
+  /* Without a queue length, the queue only coalesces the messages and the
+   * callers write them. */
+  queue = log_queue_create((queue_length > 0) ? queue_length : 1,
+                           coalesce_interval, sl_write, /* flush = */ NULL,
+                           /* arg = */ NULL);
+  if (queue == NULL) {
+    ERROR("syslog: log_queue_create failed.");
+    return -1;
+  }
+
+  if (queue_length > 0) {
+    int status = log_queue_start(queue);
+    if (status != 0)
+      WARNING("syslog: starting the log queue failed, writing messages "
+              "synchronously: %s",
+              STRERROR(status));
+  }
+
+  return 0;
+} /* int sl_init */
+
 static int sl_shutdown(void) {
+  /* The queue stays around, so that messages logged after this are still
+   * written. */
+  if (queue != NULL)
+    log_queue_stop(queue);
+
   closelog();
 
   return 0;
@@ -135,7 +194,13 @@ static int sl_notification(const notification_t *n,
 
   buf[sizeof(buf) - 1] = '\0';
 
-  sl_log(log_severity, buf, NULL);
+  if (log_severity > log_level)
+    return 0;
+
+  if (queue == NULL)
+    syslog(log_severity, "%s", buf);
+  else
+    log_queue_push_notification(queue, log_severity, cdtime(), buf);
 
   return 0;
 } /* int sl_notification */
@@ -146,5 +211,6 @@ void module_register(void) {
   plugin_register_config("syslog", sl_config, config_keys, config_keys_num);
   plugin_register_log("syslog", sl_log, /* user_data = */ NULL);
   plugin_register_notification("syslog", sl_notification, NULL);
+  plugin_register_init("syslog", sl_init);
   plugin_register_shutdown("syslog", sl_shutdown);
 } /* void module_register(void) */
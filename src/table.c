@@ -34,6 +34,9 @@
 
 #include "plugin.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #define log_err(...) ERROR("table plugin: " __VA_ARGS__)
 #define log_warn(...) WARNING("table plugin: " __VA_ARGS__)
 
@@ -62,6 +65,19 @@ typedef struct {
   size_t results_num;
 
   size_t max_colnum;
+
+  /* The contents of the file as read last, and a copy of them which is split
+   * into lines and fields. */
+  char *buffer;
+  char *work;
+  size_t buffer_size;
+  size_t buffer_len;
+  /* The file the contents were read from. */
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  time_t read_time;
 } tbl_t;
 
 static void tbl_result_setup(tbl_result_t *res) {
@@ -104,6 +120,11 @@ static void tbl_setup(tbl_t *tbl, char *file) {
   tbl->results_num = 0;
 
   tbl->max_colnum = 0;
+
+  tbl->buffer = NULL;
+  tbl->work = NULL;
+  tbl->buffer_size = 0;
+  tbl->buffer_len = 0;
 } /* tbl_setup */
 
 static void tbl_clear(tbl_t *tbl) {
@@ -124,6 +145,11 @@ static void tbl_clear(tbl_t *tbl) {
   tbl->results_num = 0;
 
   tbl->max_colnum = 0;
+
+  sfree(tbl->buffer);
+  sfree(tbl->work);
+  tbl->buffer_size = 0;
+  tbl->buffer_len = 0;
 } /* tbl_clear */
 
 static tbl_t *tables;
@@ -422,35 +448,113 @@ static int tbl_parse_line(tbl_t *tbl, char *line, size_t len) {
   return 0;
 } /* tbl_parse_line */
 
-static int tbl_read_table(tbl_t *tbl) {
-  char buf[4096];
+/* Reads the file into tbl->buffer, unless it is a regular file which hasn't
+ * changed since it was read last. Files in /proc and the like are always
+ * read, with as few read calls as the buffer allows. */
+static int tbl_read_file(tbl_t *tbl) {
+  time_t now = time(NULL);
 
-  FILE *fh = fopen(tbl->file, "r");
-  if (fh == NULL) {
+  int fd = open(tbl->file, O_RDONLY);
+  if (fd < 0) {
     log_err("Failed to open file \"%s\": %s.", tbl->file, STRERRNO);
     return -1;
   }
 
-  buf[sizeof(buf) - 1] = '\0';
-  while (fgets(buf, sizeof(buf), fh) != NULL) {
-    if (buf[sizeof(buf) - 1] != '\0') {
-      buf[sizeof(buf) - 1] = '\0';
-      log_warn("Table %s: Truncated line: %s", tbl->file, buf);
+  struct stat st = {0};
+  if (fstat(fd, &st) != 0) {
+    log_err("fstat (%s) failed: %s.", tbl->file, STRERRNO);
+    close(fd);
+    return -1;
+  }
+
+  /* A change within the second of the last read could go unnoticed, so the
+   * contents are only reused if the file is older than that. */
+  if (S_ISREG(st.st_mode) && (tbl->buffer != NULL) &&
+      (st.st_dev == tbl->dev) && (st.st_ino == tbl->ino) &&
+      (st.st_size == tbl->size) && (st.st_mtime == tbl->mtime) &&
+      (st.st_mtime < tbl->read_time)) {
+    close(fd);
+    return 0;
+  }
+
+  size_t len = 0;
+  while (42) {
+    if (len + 1 >= tbl->buffer_size) {
+      size_t size = (tbl->buffer_size > 0) ? 2 * tbl->buffer_size : 4096;
+      while (S_ISREG(st.st_mode) && (size <= (size_t)st.st_size))
+        size *= 2;
+
+      char *buffer = realloc(tbl->buffer, size);
+      if (buffer == NULL) {
+        log_err("realloc failed.");
+        close(fd);
+        return -1;
+      }
+      tbl->buffer = buffer;
+
+      char *work = realloc(tbl->work, size);
+      if (work == NULL) {
+        log_err("realloc failed.");
+        close(fd);
+        return -1;
+      }
+      tbl->work = work;
+      tbl->buffer_size = size;
     }
 
-    if (tbl_parse_line(tbl, buf, sizeof(buf)) != 0) {
-      log_warn("Table %s: Failed to parse line: %s", tbl->file, buf);
-      continue;
+    ssize_t n = read(fd, tbl->buffer + len, tbl->buffer_size - len - 1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      log_err("Failed to read from file \"%s\": %s.", tbl->file, STRERRNO);
+      close(fd);
+      /* Don't reuse partial contents. */
+      tbl->buffer_len = 0;
+      tbl->size = -1;
+      return -1;
+    } else if (n == 0) {
+      break;
     }
+    len += (size_t)n;
   }
+  close(fd);
+
+  tbl->buffer[len] = '\0';
+  tbl->buffer_len = len;
+  tbl->dev = st.st_dev;
+  tbl->ino = st.st_ino;
+  tbl->size = st.st_size;
+  tbl->mtime = st.st_mtime;
+  tbl->read_time = now;
 
-  if (ferror(fh) != 0) {
-    log_err("Failed to read from file \"%s\": %s.", tbl->file, STRERRNO);
-    fclose(fh);
+  return 0;
+} /* tbl_read_file */
+
+static int tbl_read_table(tbl_t *tbl) {
+  if (tbl_read_file(tbl) != 0)
     return -1;
+
+  /* The fields are split in place, which leaves the contents for the next
+   * read. */
+  memcpy(tbl->work, tbl->buffer, tbl->buffer_len + 1);
+
+  char *end = tbl->work + tbl->buffer_len;
+  char *next;
+  for (char *line = tbl->work; line < end; line = next) {
+    char *newline = memchr(line, '\n', (size_t)(end - line));
+    if (newline != NULL) {
+      *newline = '\0';
+      next = newline + 1;
+    } else {
+      next = end;
+    }
+
+    if (tbl_parse_line(tbl, line, (size_t)(next - line)) != 0) {
+      log_warn("Table %s: Failed to parse line: %s", tbl->file, line);
+      continue;
+    }
   }
 
-  fclose(fh);
   return 0;
 } /* tbl_read_table */
 
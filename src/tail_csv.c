@@ -48,6 +48,9 @@ struct instance_definition_s {
   char *instance;
   char *path;
   cu_tail_t *tail;
+  /* Points to the fields of the line being read. */
+  char **fields;
+  size_t fields_size;
   metric_definition_t **metric_list;
   size_t metric_list_len;
   ssize_t time_from;
@@ -168,12 +171,17 @@ static int tcsv_read_buffer(instance_definition_t *id, char *buffer,
     return -1;
   }
 
-  /* Create a list of all values */
-  metrics = calloc(metrics_num, sizeof(*metrics));
-  if (metrics == NULL) {
-    ERROR("tail_csv plugin: calloc failed.");
-    return ENOMEM;
+  /* The list of all values is kept for the next line. */
+  if (id->fields_size < metrics_num) {
+    metrics = realloc(id->fields, metrics_num * sizeof(*metrics));
+    if (metrics == NULL) {
+      ERROR("tail_csv plugin: realloc failed.");
+      return ENOMEM;
+    }
+    id->fields = metrics;
+    id->fields_size = metrics_num;
   }
+  metrics = id->fields;
 
   ptr = buffer;
   metrics[0] = ptr;
@@ -199,8 +207,12 @@ static int tcsv_read_buffer(instance_definition_t *id, char *buffer,
     tcsv_read_metric(id, md, metrics, metrics_num);
   }
 
-  /* Free up resources */
-  sfree(metrics);
+  return 0;
+}
+
+static int tcsv_read_line(void *data, char *buf, int buflen) {
+  /* The line is passed without copying it; its length is buflen - 1. */
+  tcsv_read_buffer(data, buf, (size_t)buflen - 1);
   return 0;
 }
 
@@ -216,24 +228,15 @@ static int tcsv_read(user_data_t *ud) {
     }
   }
 
-  while (42) {
-    char buffer[1024];
-    size_t buffer_len;
-    int status;
-
-    status = cu_tail_readline(id->tail, buffer, (int)sizeof(buffer));
-    if (status != 0) {
-      ERROR("tail_csv plugin: File \"%s\": cu_tail_readline failed "
-            "with status %i.",
-            id->path, status);
-      return -1;
-    }
-
-    buffer_len = strlen(buffer);
-    if (buffer_len == 0)
-      break;
-
-    tcsv_read_buffer(id, buffer, buffer_len);
+  /* Only the data appended since the last read is read, in large blocks. */
+  char buffer[1024];
+  int status =
+      cu_tail_read(id->tail, buffer, (int)sizeof(buffer), tcsv_read_line, id);
+  if (status != 0) {
+    ERROR("tail_csv plugin: File \"%s\": cu_tail_read failed "
+          "with status %i.",
+          id->path, status);
+    return -1;
   }
 
   return 0;
@@ -361,6 +364,7 @@ static void tcsv_instance_definition_destroy(void *arg) {
   sfree(id->plugin_name);
   sfree(id->instance);
   sfree(id->path);
+  sfree(id->fields);
   sfree(id->metric_list);
   sfree(id);
 }
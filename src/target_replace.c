@@ -28,10 +28,15 @@
 
 #include "filter_chain.h"
 #include "utils/common/common.h"
+#include "utils/match_cache/match_cache.h"
+#include "utils_ident.h"
 #include "utils_subst.h"
 
 #include <regex.h>
 
+/* Number of identifiers whose rewritten fields are remembered. */
+#define TR_CACHE_SIZE 16384
+
 struct tr_action_s;
 typedef struct tr_action_s tr_action_t;
 struct tr_action_s {
@@ -59,6 +64,11 @@ struct tr_data_s {
   /* tr_action_t *type; */
   tr_action_t *type_instance;
   tr_meta_data_action_t *meta;
+
+  /* The fields with actions -> the fields after the actions. Identifiers
+   * repeat every interval, so the regular expressions run once per
+   * identifier. */
+  c_match_cache_t *cache;
 };
 typedef struct tr_data_s tr_data_t;
 
@@ -440,6 +450,7 @@ static int tr_destroy(void **user_data) /* {{{ */
   /* tr_action_destroy (data->type); */
   tr_action_destroy(data->type_instance);
   tr_meta_data_action_destroy(data->meta);
+  c_match_cache_destroy(data->cache);
   sfree(data);
 
   return 0;
@@ -521,10 +532,71 @@ static int tr_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     return status;
   }
 
+  /* Without a cache, the fields are simply rewritten every time. */
+  data->cache = c_match_cache_create(TR_CACHE_SIZE);
+
   *user_data = data;
   return 0;
 } /* }}} int tr_create */
 
+/* Appends the fields of `vl' that have actions to `buffer'. Each field is
+ * terminated by a null byte. Returns the length of the key. */
+static size_t tr_cache_key(tr_data_t const *data, /* {{{ */
+                           value_list_t const *vl, char *buffer,
+                           size_t buffer_size) {
+  struct {
+    tr_action_t const *act;
+    char const *field;
+  } fields[] = {
+      {data->host, vl->host},
+      {data->plugin, vl->plugin},
+      {data->plugin_instance, vl->plugin_instance},
+      {data->type_instance, vl->type_instance},
+  };
+  size_t len = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    if (fields[i].act == NULL)
+      continue;
+
+    size_t field_len = strlen(fields[i].field);
+    if (len + field_len + 1 > buffer_size)
+      break;
+    memcpy(buffer + len, fields[i].field, field_len);
+    len += field_len;
+    buffer[len] = 0;
+    len++;
+  }
+
+  return len;
+} /* }}} size_t tr_cache_key */
+
+/* Copies the fields stored by `tr_cache_key' back into `vl'. */
+static void tr_cache_apply(tr_data_t const *data, /* {{{ */
+                           value_list_t *vl, char const *buffer,
+                           size_t buffer_len) {
+  struct {
+    tr_action_t const *act;
+    char *field;
+  } fields[] = {
+      {data->host, vl->host},
+      {data->plugin, vl->plugin},
+      {data->plugin_instance, vl->plugin_instance},
+      {data->type_instance, vl->type_instance},
+  };
+  char const *end = buffer + buffer_len;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    if (fields[i].act == NULL)
+      continue;
+    if (buffer >= end)
+      break;
+
+    sstrncpy(fields[i].field, buffer, DATA_MAX_NAME_LEN);
+    buffer += strlen(buffer) + 1;
+  }
+} /* }}} void tr_cache_apply */
+
 static int tr_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
                      notification_meta_t __attribute__((unused)) * *meta,
                      void **user_data) {
@@ -543,6 +615,26 @@ static int tr_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
     tr_meta_data_action_invoke(data->meta, &(vl->meta));
   }
 
+  if ((data->host == NULL) && (data->plugin == NULL) &&
+      (data->plugin_instance == NULL) && (data->type_instance == NULL))
+    return FC_TARGET_CONTINUE;
+
+  ident_reset(vl);
+
+  char key[4 * DATA_MAX_NAME_LEN];
+  size_t key_len = 0;
+  if (data->cache != NULL) {
+    char value[4 * DATA_MAX_NAME_LEN];
+    size_t value_len = sizeof(value);
+
+    key_len = tr_cache_key(data, vl, key, sizeof(key));
+    if (c_match_cache_get_value(data->cache, key, key_len, value,
+                                &value_len) == 0) {
+      tr_cache_apply(data, vl, value, value_len);
+      return FC_TARGET_CONTINUE;
+    }
+  }
+
 #define HANDLE_FIELD(f, e)                                                     \
   if (data->f != NULL)                                                         \
   tr_action_invoke(data->f, vl->f, sizeof(vl->f), e)
@@ -552,6 +644,12 @@ static int tr_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
   /* HANDLE_FIELD (type, false); */
   HANDLE_FIELD(type_instance, true);
 
+  if (data->cache != NULL) {
+    char value[4 * DATA_MAX_NAME_LEN];
+    size_t value_len = tr_cache_key(data, vl, value, sizeof(value));
+    c_match_cache_put_value(data->cache, key, key_len, value, value_len);
+  }
+
   return FC_TARGET_CONTINUE;
 } /* }}} int tr_invoke */
 
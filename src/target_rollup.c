@@ -0,0 +1,539 @@
+/**
+ * collectd - src/target_rollup.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "filter_chain.h"
+#include "utils/common/common.h"
+#include "utils_ident.h"
+
+/* Like the value cache, the series are spread over shards with a lock each,
+ * so that dispatch threads rarely wait for each other. */
+#define TR_SHARDS 16
+
+typedef enum {
+  TR_MIN,
+  TR_MAX,
+  TR_AVERAGE,
+  TR_LAST,
+  TR_FUNCTIONS_NUM,
+} tr_function_t;
+
+static char const *const tr_function_names[TR_FUNCTIONS_NUM] = {
+    [TR_MIN] = "min",
+    [TR_MAX] = "max",
+    [TR_AVERAGE] = "average",
+    [TR_LAST] = "last",
+};
+
+/*
+ * private data types
+ */
+
+/* The values of one data source in the current window. NaN gauges are only
+ * counted by "last". */
+typedef struct {
+  gauge_t min;
+  gauge_t max;
+  gauge_t sum;
+  size_t num;
+  value_t last;
+} tr_acc_t;
+
+/* A series with values in the window `window', i.e. the values with
+ * time / interval == window. A series only exists while it has values that
+ * haven't been written yet. */
+typedef struct tr_series_s {
+  value_ident_t *ident;
+  uint64_t window;
+  cdtime_t last_time;
+  struct tr_series_s *next;
+
+  size_t values_num;
+  tr_acc_t acc[];
+} tr_series_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  tr_series_t **buckets;
+  size_t buckets_num;
+  size_t series_num;
+} tr_shard_t;
+
+typedef struct {
+  cdtime_t interval;
+  bool functions[TR_FUNCTIONS_NUM];
+  size_t functions_num;
+
+  /* The write plugins to write to; all of them if there are none. */
+  plugin_write_ref_t **plugins;
+  size_t plugins_num;
+
+  tr_shard_t shards[TR_SHARDS];
+  /* Series that stopped receiving values are written by the sweep, which
+   * runs at most once per interval. */
+  cdtime_t last_sweep;
+} tr_data_t;
+
+/*
+ * internal helper functions
+ */
+static void tr_series_destroy(tr_series_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  ident_unref(s->ident);
+  free(s);
+} /* }}} void tr_series_destroy */
+
+static tr_series_t *tr_series_create(value_ident_t *ident, /* {{{ */
+                                     value_list_t const *vl,
+                                     uint64_t window) {
+  tr_series_t *s = calloc(1, sizeof(*s) + vl->values_len * sizeof(s->acc[0]));
+  if (s == NULL)
+    return NULL;
+
+  s->ident = ident_ref(ident);
+  s->window = window;
+  s->values_num = vl->values_len;
+  for (size_t i = 0; i < s->values_num; i++) {
+    s->acc[i].min = NAN;
+    s->acc[i].max = NAN;
+  }
+
+  return s;
+} /* }}} tr_series_t *tr_series_create */
+
+static void tr_series_add(tr_series_t *s, const data_set_t *ds, /* {{{ */
+                          value_list_t const *vl) {
+  for (size_t i = 0; i < s->values_num; i++) {
+    tr_acc_t *acc = s->acc + i;
+    acc->last = vl->values[i];
+
+    if (ds->ds[i].type != DS_TYPE_GAUGE)
+      continue;
+
+    gauge_t g = vl->values[i].gauge;
+    if (isnan(g))
+      continue;
+    if ((acc->num == 0) || (g < acc->min))
+      acc->min = g;
+    if ((acc->num == 0) || (g > acc->max))
+      acc->max = g;
+    acc->sum += g;
+    acc->num++;
+  }
+  s->last_time = vl->time;
+} /* }}} void tr_series_add */
+
+static value_t tr_acc_get(tr_acc_t const *acc, int ds_type, /* {{{ */
+                          tr_function_t f) {
+  /* The last value of a counter is all the writers need to compute the rate
+   * over the window. */
+  if ((ds_type != DS_TYPE_GAUGE) || (f == TR_LAST))
+    return acc->last;
+
+  value_t v = {.gauge = NAN};
+  if (acc->num == 0)
+    return v;
+
+  if (f == TR_MIN)
+    v.gauge = acc->min;
+  else if (f == TR_MAX)
+    v.gauge = acc->max;
+  else
+    v.gauge = acc->sum / (gauge_t)acc->num;
+  return v;
+} /* }}} value_t tr_acc_get */
+
+static void tr_write(tr_data_t *data, const data_set_t *ds, /* {{{ */
+                     value_list_t const *vl) {
+  if (data->plugins_num == 0) {
+    plugin_write(NULL, ds, vl);
+    return;
+  }
+
+  /* The write plugins report their own errors. Plugins that aren't loaded
+   * are skipped. */
+  for (size_t i = 0; i < data->plugins_num; i++)
+    plugin_write_ref(data->plugins[i], ds, vl);
+} /* }}} void tr_write */
+
+/* Writes the values of a window, one value list per consolidation function.
+ * With more than one function, the name of the function is appended to the
+ * type instance. */
+static void tr_series_write(tr_data_t *data, tr_series_t *s) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  if (parse_identifier_vl(s->ident->name, &vl) != 0) {
+    ERROR("Target `rollup': Parsing identifier \"%s\" failed.",
+          s->ident->name);
+    return;
+  }
+
+  /* The data set is looked up again, since it may have been replaced by a
+   * reload in the meantime. */
+  const data_set_t *ds = plugin_get_ds(vl.type);
+  if ((ds == NULL) || (ds->ds_num != s->values_num))
+    return;
+
+  value_t values[s->values_num];
+  vl.values = values;
+  vl.values_len = s->values_num;
+  vl.time = s->last_time;
+  vl.interval = data->interval;
+
+  char type_instance[DATA_MAX_NAME_LEN];
+  sstrncpy(type_instance, vl.type_instance, sizeof(type_instance));
+  if (data->functions_num == 1)
+    vl.ident = s->ident;
+
+  for (tr_function_t f = 0; f < TR_FUNCTIONS_NUM; f++) {
+    if (!data->functions[f])
+      continue;
+
+    for (size_t i = 0; i < s->values_num; i++)
+      values[i] = tr_acc_get(s->acc + i, ds->ds[i].type, f);
+
+    if (data->functions_num > 1) {
+      char *fields[] = {type_instance, (char *)tr_function_names[f]};
+      if (type_instance[0] != 0)
+        strjoin(vl.type_instance, sizeof(vl.type_instance), fields,
+                STATIC_ARRAY_SIZE(fields), "-");
+      else
+        sstrncpy(vl.type_instance, tr_function_names[f],
+                 sizeof(vl.type_instance));
+    }
+
+    tr_write(data, ds, &vl);
+  }
+} /* }}} void tr_series_write */
+
+static int tr_shard_grow(tr_shard_t *sh) /* {{{ */
+{
+  size_t buckets_num = (sh->buckets_num > 0) ? 2 * sh->buckets_num : 64;
+  tr_series_t **buckets = calloc(buckets_num, sizeof(*buckets));
+  if (buckets == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < sh->buckets_num; i++) {
+    while (sh->buckets[i] != NULL) {
+      tr_series_t *s = sh->buckets[i];
+      sh->buckets[i] = s->next;
+
+      size_t b = (size_t)(s->ident->hash / TR_SHARDS) & (buckets_num - 1);
+      s->next = buckets[b];
+      buckets[b] = s;
+    }
+  }
+
+  free(sh->buckets);
+  sh->buckets = buckets;
+  sh->buckets_num = buckets_num;
+  return 0;
+} /* }}} int tr_shard_grow */
+
+/* Removes the series of windows that ended at least one interval before
+ * `now' and writes them. */
+static void tr_sweep(tr_data_t *data, cdtime_t now) /* {{{ */
+{
+  uint64_t window = now / data->interval;
+  if (window < 2)
+    return;
+
+  for (size_t i = 0; i < TR_SHARDS; i++) {
+    tr_shard_t *sh = data->shards + i;
+    tr_series_t *stale = NULL;
+
+    pthread_mutex_lock(&sh->lock);
+    for (size_t b = 0; b < sh->buckets_num; b++) {
+      tr_series_t **prev = sh->buckets + b;
+      while (*prev != NULL) {
+        tr_series_t *s = *prev;
+        if (s->window >= window - 1) {
+          prev = &s->next;
+          continue;
+        }
+        *prev = s->next;
+        s->next = stale;
+        stale = s;
+        sh->series_num--;
+      }
+    }
+    pthread_mutex_unlock(&sh->lock);
+
+    while (stale != NULL) {
+      tr_series_t *s = stale;
+      stale = s->next;
+      tr_series_write(data, s);
+      tr_series_destroy(s);
+    }
+  }
+} /* }}} void tr_sweep */
+
+static int tr_config_add_function(tr_data_t *data, /* {{{ */
+                                  oconfig_item_t const *ci) {
+  if (ci->values_num < 1) {
+    ERROR("Target `rollup': The `%s' option requires at least one string "
+          "argument.",
+          ci->key);
+    return -1;
+  }
+
+  for (int i = 0; i < ci->values_num; i++) {
+    if (ci->values[i].type != OCONFIG_TYPE_STRING) {
+      ERROR("Target `rollup': The `%s' option accepts only string "
+            "arguments.",
+            ci->key);
+      return -1;
+    }
+
+    char const *name = ci->values[i].value.string;
+    tr_function_t f;
+    for (f = 0; f < TR_FUNCTIONS_NUM; f++)
+      if (strcasecmp(name, tr_function_names[f]) == 0)
+        break;
+    if ((f == TR_FUNCTIONS_NUM) && (strcasecmp(name, "avg") == 0))
+      f = TR_AVERAGE;
+    if (f == TR_FUNCTIONS_NUM) {
+      ERROR("Target `rollup': Unknown consolidation function `%s'.", name);
+      return -1;
+    }
+
+    if (!data->functions[f])
+      data->functions_num++;
+    data->functions[f] = true;
+  }
+
+  return 0;
+} /* }}} int tr_config_add_function */
+
+static int tr_config_add_plugin(tr_data_t *data, /* {{{ */
+                                oconfig_item_t const *ci) {
+  char *name = NULL;
+  int status = cf_util_get_string(ci, &name);
+  if (status != 0)
+    return status;
+
+  plugin_write_ref_t **tmp =
+      realloc(data->plugins, (data->plugins_num + 1) * sizeof(*tmp));
+  if (tmp == NULL) {
+    ERROR("Target `rollup': realloc failed.");
+    free(name);
+    return -ENOMEM;
+  }
+  data->plugins = tmp;
+
+  data->plugins[data->plugins_num] = plugin_write_ref_create(name);
+  free(name);
+  if (data->plugins[data->plugins_num] == NULL) {
+    ERROR("Target `rollup': plugin_write_ref_create failed.");
+    return -ENOMEM;
+  }
+  data->plugins_num++;
+
+  return 0;
+} /* }}} int tr_config_add_plugin */
+
+static int tr_destroy(void **user_data) /* {{{ */
+{
+  if ((user_data == NULL) || (*user_data == NULL))
+    return 0;
+
+  tr_data_t *data = *user_data;
+
+  /* The values of the current windows are dropped: the write plugins may
+   * already be shut down. */
+  for (size_t i = 0; i < TR_SHARDS; i++) {
+    tr_shard_t *sh = data->shards + i;
+    for (size_t b = 0; b < sh->buckets_num; b++) {
+      while (sh->buckets[b] != NULL) {
+        tr_series_t *s = sh->buckets[b];
+        sh->buckets[b] = s->next;
+        tr_series_destroy(s);
+      }
+    }
+    free(sh->buckets);
+    pthread_mutex_destroy(&sh->lock);
+  }
+
+  for (size_t i = 0; i < data->plugins_num; i++)
+    plugin_write_ref_destroy(data->plugins[i]);
+  free(data->plugins);
+
+  free(data);
+  *user_data = NULL;
+
+  return 0;
+} /* }}} int tr_destroy */
+
+static int tr_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
+{
+  tr_data_t *data = calloc(1, sizeof(*data));
+  if (data == NULL) {
+    ERROR("tr_create: calloc failed.");
+    return -ENOMEM;
+  }
+  for (size_t i = 0; i < TR_SHARDS; i++)
+    pthread_mutex_init(&data->shards[i].lock, NULL);
+
+  int status = 0;
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Interval", child->key) == 0)
+      status = cf_util_get_cdtime(child, &data->interval);
+    else if (strcasecmp("Consolidation", child->key) == 0)
+      status = tr_config_add_function(data, child);
+    else if (strcasecmp("Plugin", child->key) == 0)
+      status = tr_config_add_plugin(data, child);
+    else {
+      ERROR("Target `rollup': The `%s' configuration option is not "
+            "understood and will be ignored.",
+            child->key);
+      status = 0;
+    }
+
+    if (status != 0)
+      break;
+  }
+
+  if ((status == 0) && (data->interval == 0)) {
+    ERROR("Target `rollup': The `Interval' option is required.");
+    status = -1;
+  }
+
+  if (status != 0) {
+    tr_destroy((void *)&data);
+    return status;
+  }
+
+  if (data->functions_num == 0) {
+    data->functions[TR_AVERAGE] = true;
+    data->functions_num = 1;
+  }
+  data->last_sweep = cdtime();
+
+  *user_data = data;
+  return 0;
+} /* }}} int tr_create */
+
+static int tr_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
+                     notification_meta_t __attribute__((unused)) * *meta,
+                     void **user_data) {
+  if ((ds == NULL) || (vl == NULL) || (user_data == NULL) ||
+      (*user_data == NULL))
+    return -EINVAL;
+
+  tr_data_t *data = *user_data;
+
+  /* Values that aren't more frequent than the windows pass as they are: a
+   * window would only ever hold one of them. */
+  if ((vl->interval >= data->interval) && (data->functions_num == 1)) {
+    tr_write(data, ds, vl);
+    return FC_TARGET_CONTINUE;
+  }
+
+  value_ident_t *ident =
+      (vl->ident != NULL) ? ident_ref(vl->ident) : ident_get(vl);
+  if (ident == NULL) {
+    ERROR("Target `rollup': ident_get failed.");
+    return -1;
+  }
+
+  uint64_t window = vl->time / data->interval;
+  tr_shard_t *sh = data->shards + (ident->hash % TR_SHARDS);
+  tr_series_t *done = NULL;
+
+  pthread_mutex_lock(&sh->lock);
+
+  tr_series_t *s = NULL;
+  tr_series_t **prev = NULL;
+  if (sh->buckets_num > 0) {
+    size_t b = (size_t)(ident->hash / TR_SHARDS) & (sh->buckets_num - 1);
+    for (prev = sh->buckets + b; *prev != NULL; prev = &(*prev)->next) {
+      tr_series_t *p = *prev;
+      if ((p->ident == ident) || ((p->ident->hash == ident->hash) &&
+                                  (strcmp(p->ident->name, ident->name) == 0))) {
+        s = p;
+        break;
+      }
+    }
+  }
+
+  /* A value of a later window completes the current one. Values of an
+   * earlier window are late and added to the current one. */
+  if ((s != NULL) &&
+      ((window > s->window) || (s->values_num != vl->values_len))) {
+    *prev = s->next;
+    sh->series_num--;
+    done = s;
+    s = NULL;
+  }
+
+  int status = 0;
+  if ((s == NULL) && (sh->series_num >= sh->buckets_num))
+    status = tr_shard_grow(sh);
+  if ((s == NULL) && (status == 0)) {
+    s = tr_series_create(ident, vl, window);
+    if (s != NULL) {
+      size_t b = (size_t)(ident->hash / TR_SHARDS) & (sh->buckets_num - 1);
+      s->next = sh->buckets[b];
+      sh->buckets[b] = s;
+      sh->series_num++;
+    }
+  }
+
+  if (s != NULL)
+    tr_series_add(s, ds, vl);
+  pthread_mutex_unlock(&sh->lock);
+  ident_unref(ident);
+
+  if (s == NULL)
+    ERROR("Target `rollup': calloc failed.");
+
+  /* Write outside of the lock: write callbacks may take a while. */
+  if (done != NULL) {
+    tr_series_write(data, done);
+    tr_series_destroy(done);
+  }
+
+  cdtime_t now = cdtime();
+  cdtime_t last_sweep = __atomic_load_n(&data->last_sweep, __ATOMIC_RELAXED);
+  if ((now - last_sweep >= data->interval) &&
+      __atomic_compare_exchange_n(&data->last_sweep, &last_sweep, now, false,
+                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    tr_sweep(data, now);
+
+  return FC_TARGET_CONTINUE;
+} /* }}} int tr_invoke */
+
+void module_register(void) {
+  target_proc_t tproc = {0};
+
+  tproc.create = tr_create;
+  tproc.destroy = tr_destroy;
+  tproc.invoke = tr_invoke;
+  fc_register_target("rollup", tproc);
+} /* module_register */
@@ -28,6 +28,7 @@
 
 #include "filter_chain.h"
 #include "utils/common/common.h"
+#include "utils/ds_filter/ds_filter.h"
 
 #include "utils_cache.h"
 
@@ -37,10 +38,19 @@ struct ts_data_s {
 
   char **data_sources;
   size_t data_sources_num;
+  c_ds_filter_t *filter;
 };
 typedef struct ts_data_s ts_data_t;
 
-static int ts_invoke_counter(const data_set_t *ds, value_list_t *vl, /* {{{ */
+/* Argument of ts_update_state(). */
+typedef struct {
+  const data_set_t *ds;
+  value_list_t *vl;
+  ts_data_t *data;
+  c_ds_selection_t const *selection;
+} ts_state_update_t;
+
+static int ts_invoke_counter(meta_data_t *meta, value_list_t *vl, /* {{{ */
                              ts_data_t *data, int dsrc_index) {
   uint64_t curr_counter;
   int status;
@@ -70,15 +80,15 @@ static int ts_invoke_counter(const data_set_t *ds, value_list_t *vl, /* {{{ */
   /* Query the meta data */
   failure = 0;
 
-  status = uc_meta_data_get_unsigned_int(vl, key_prev_counter, &prev_counter);
+  status = meta_data_get_unsigned_int(meta, key_prev_counter, &prev_counter);
   if (status != 0)
     failure++;
 
-  status = uc_meta_data_get_unsigned_int(vl, key_int_counter, &int_counter);
+  status = meta_data_get_unsigned_int(meta, key_int_counter, &int_counter);
   if (status != 0)
     failure++;
 
-  status = uc_meta_data_get_double(vl, key_int_fraction, &int_fraction);
+  status = meta_data_get_double(meta, key_int_fraction, &int_fraction);
   if (status != 0)
     failure++;
 
@@ -116,15 +126,15 @@ static int ts_invoke_counter(const data_set_t *ds, value_list_t *vl, /* {{{ */
   vl->values[dsrc_index].counter = (counter_t)int_counter;
 
   /* Update to the new counter value */
-  uc_meta_data_add_unsigned_int(vl, key_prev_counter, curr_counter);
-  uc_meta_data_add_unsigned_int(vl, key_int_counter, int_counter);
-  uc_meta_data_add_double(vl, key_int_fraction, int_fraction);
+  meta_data_add_unsigned_int(meta, key_prev_counter, curr_counter);
+  meta_data_add_unsigned_int(meta, key_int_counter, int_counter);
+  meta_data_add_double(meta, key_int_fraction, int_fraction);
 
   return 0;
 } /* }}} int ts_invoke_counter */
 
-static int ts_invoke_gauge(const data_set_t *ds, value_list_t *vl, /* {{{ */
-                           ts_data_t *data, int dsrc_index) {
+static int ts_invoke_gauge(value_list_t *vl, ts_data_t *data, /* {{{ */
+                           int dsrc_index) {
   if (!isnan(data->factor))
     vl->values[dsrc_index].gauge *= data->factor;
   if (!isnan(data->offset))
@@ -133,7 +143,43 @@ static int ts_invoke_gauge(const data_set_t *ds, value_list_t *vl, /* {{{ */
   return 0;
 } /* }}} int ts_invoke_gauge */
 
-static int ts_invoke_derive(const data_set_t *ds, value_list_t *vl, /* {{{ */
+/* Scales the gauges of a data set consisting of gauges only. The loops have
+ * no branches, so the compiler can vectorize them. */
+static void ts_invoke_gauges(value_list_t *vl, ts_data_t *data, /* {{{ */
+                             c_ds_selection_t const *sel) {
+  value_t *values = vl->values;
+  size_t const *indices = sel->indices;
+  size_t num = sel->indices_num;
+  gauge_t factor = data->factor;
+  gauge_t offset = data->offset;
+
+  if (sel->all) {
+    if (!isnan(factor) && !isnan(offset)) {
+      for (size_t i = 0; i < num; i++)
+        values[i].gauge = values[i].gauge * factor + offset;
+    } else if (!isnan(factor)) {
+      for (size_t i = 0; i < num; i++)
+        values[i].gauge *= factor;
+    } else {
+      for (size_t i = 0; i < num; i++)
+        values[i].gauge += offset;
+    }
+    return;
+  }
+
+  if (!isnan(factor) && !isnan(offset)) {
+    for (size_t i = 0; i < num; i++)
+      values[indices[i]].gauge = values[indices[i]].gauge * factor + offset;
+  } else if (!isnan(factor)) {
+    for (size_t i = 0; i < num; i++)
+      values[indices[i]].gauge *= factor;
+  } else {
+    for (size_t i = 0; i < num; i++)
+      values[indices[i]].gauge += offset;
+  }
+} /* }}} void ts_invoke_gauges */
+
+static int ts_invoke_derive(meta_data_t *meta, value_list_t *vl, /* {{{ */
                             ts_data_t *data, int dsrc_index) {
   int64_t curr_derive;
   int status;
@@ -163,15 +209,15 @@ static int ts_invoke_derive(const data_set_t *ds, value_list_t *vl, /* {{{ */
   /* Query the meta data */
   failure = 0;
 
-  status = uc_meta_data_get_signed_int(vl, key_prev_derive, &prev_derive);
+  status = meta_data_get_signed_int(meta, key_prev_derive, &prev_derive);
   if (status != 0)
     failure++;
 
-  status = uc_meta_data_get_signed_int(vl, key_int_derive, &int_derive);
+  status = meta_data_get_signed_int(meta, key_int_derive, &int_derive);
   if (status != 0)
     failure++;
 
-  status = uc_meta_data_get_double(vl, key_int_fraction, &int_fraction);
+  status = meta_data_get_double(meta, key_int_fraction, &int_fraction);
   if (status != 0)
     failure++;
 
@@ -213,14 +259,14 @@ static int ts_invoke_derive(const data_set_t *ds, value_list_t *vl, /* {{{ */
   vl->values[dsrc_index].derive = (derive_t)int_derive;
 
   /* Update to the new derive value */
-  uc_meta_data_add_signed_int(vl, key_prev_derive, curr_derive);
-  uc_meta_data_add_signed_int(vl, key_int_derive, int_derive);
-  uc_meta_data_add_double(vl, key_int_fraction, int_fraction);
+  meta_data_add_signed_int(meta, key_prev_derive, curr_derive);
+  meta_data_add_signed_int(meta, key_int_derive, int_derive);
+  meta_data_add_double(meta, key_int_fraction, int_fraction);
 
   return 0;
 } /* }}} int ts_invoke_derive */
 
-static int ts_invoke_absolute(const data_set_t *ds, value_list_t *vl, /* {{{ */
+static int ts_invoke_absolute(meta_data_t *meta, value_list_t *vl, /* {{{ */
                               ts_data_t *data, int dsrc_index) {
   uint64_t curr_absolute;
   double rate;
@@ -238,7 +284,7 @@ static int ts_invoke_absolute(const data_set_t *ds, value_list_t *vl, /* {{{ */
   int_fraction = 0.0;
 
   /* Query the meta data */
-  status = uc_meta_data_get_double(vl, key_int_fraction, &int_fraction);
+  status = meta_data_get_double(meta, key_int_fraction, &int_fraction);
   if (status != 0)
     int_fraction = 0.0;
 
@@ -258,11 +304,38 @@ static int ts_invoke_absolute(const data_set_t *ds, value_list_t *vl, /* {{{ */
   vl->values[dsrc_index].absolute = (absolute_t)curr_absolute;
 
   /* Update to the new absolute value */
-  uc_meta_data_add_double(vl, key_int_fraction, int_fraction);
+  meta_data_add_double(meta, key_int_fraction, int_fraction);
 
   return 0;
 } /* }}} int ts_invoke_absolute */
 
+/* Scales the selected data sources. The state of counters, derives and
+ * absolutes is kept in the meta data of the cache entry, which is locked
+ * while all of them are updated. */
+static int ts_update_state(meta_data_t *meta, void *arg) /* {{{ */
+{
+  ts_state_update_t *u = arg;
+  c_ds_selection_t const *sel = u->selection;
+
+  for (size_t i = 0; i < sel->indices_num; i++) {
+    size_t idx = sel->indices[i];
+    int type = u->ds->ds[idx].type;
+
+    if (type == DS_TYPE_COUNTER)
+      ts_invoke_counter(meta, u->vl, u->data, (int)idx);
+    else if (type == DS_TYPE_GAUGE)
+      ts_invoke_gauge(u->vl, u->data, (int)idx);
+    else if (type == DS_TYPE_DERIVE)
+      ts_invoke_derive(meta, u->vl, u->data, (int)idx);
+    else if (type == DS_TYPE_ABSOLUTE)
+      ts_invoke_absolute(meta, u->vl, u->data, (int)idx);
+    else
+      ERROR("Target `scale': Ignoring unknown data source type %i", type);
+  }
+
+  return 0;
+} /* }}} int ts_update_state */
+
 static int ts_config_set_double(double *ret, oconfig_item_t *ci) /* {{{ */
 {
   if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_NUMBER)) {
@@ -344,6 +417,8 @@ static int ts_destroy(void **user_data) /* {{{ */
       sfree(data->data_sources[i]);
     sfree(data->data_sources);
   }
+  if (data != NULL)
+    c_ds_filter_destroy(data->filter);
 
   sfree(data);
   *user_data = NULL;
@@ -397,6 +472,15 @@ static int ts_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     break;
   }
 
+  if (status == 0) {
+    data->filter =
+        c_ds_filter_create(data->data_sources, data->data_sources_num);
+    if (data->filter == NULL) {
+      ERROR("Target `scale': c_ds_filter_create failed.");
+      status = -ENOMEM;
+    }
+  }
+
   if (status != 0) {
     ts_destroy((void *)&data);
     return status;
@@ -420,30 +504,33 @@ static int ts_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
     return -EINVAL;
   }
 
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    /* If we've got a list of data sources, is it in the list? */
-    if (data->data_sources) {
-      size_t j;
-      for (j = 0; j < data->data_sources_num; j++)
-        if (strcasecmp(ds->ds[i].name, data->data_sources[j]) == 0)
-          break;
-
-      /* No match, ignore */
-      if (j >= data->data_sources_num)
-        continue;
-    }
+  c_ds_selection_t const *sel = c_ds_filter_get(data->filter, ds);
+  if (sel == NULL) {
+    ERROR("Target `scale': c_ds_filter_get failed.");
+    return -1;
+  }
 
-    if (ds->ds[i].type == DS_TYPE_COUNTER)
-      ts_invoke_counter(ds, vl, data, i);
-    else if (ds->ds[i].type == DS_TYPE_GAUGE)
-      ts_invoke_gauge(ds, vl, data, i);
-    else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      ts_invoke_derive(ds, vl, data, i);
-    else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      ts_invoke_absolute(ds, vl, data, i);
-    else
-      ERROR("Target `scale': Ignoring unknown data source type %i",
-            ds->ds[i].type);
+  if (sel->type == DS_TYPE_GAUGE) {
+    ts_invoke_gauges(vl, data, sel);
+    return FC_TARGET_CONTINUE;
+  }
+
+  ts_state_update_t u = {
+      .ds = ds, .vl = vl, .data = data, .selection = sel,
+  };
+  int status = uc_meta_data_update(vl, ts_update_state, &u);
+  if (status == ENOENT) {
+    /* Not in the cache (yet): there's no previous value. */
+    meta_data_t *meta = meta_data_create();
+    if (meta == NULL) {
+      ERROR("Target `scale': meta_data_create failed.");
+      return -1;
+    }
+    ts_update_state(meta, &u);
+    meta_data_destroy(meta);
+  } else if (status != 0) {
+    ERROR("Target `scale': uc_meta_data_update failed with status %i.",
+          status);
   }
 
   return FC_TARGET_CONTINUE;
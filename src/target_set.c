@@ -29,6 +29,7 @@
 #include "filter_chain.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
+#include "utils_ident.h"
 #include "utils_subst.h"
 
 struct ts_key_list_s {
@@ -50,17 +51,170 @@ static void ts_key_list_free(ts_key_list_t *l) /* {{{ */
   sfree(l);
 } /* }}} void ts_name_list_free */
 
+/* A template is split into its placeholders and the literal text between
+ * them when the configuration is read, so that expanding it is a matter of
+ * concatenating strings. */
+typedef enum {
+  TS_SEGMENT_LITERAL,
+  TS_SEGMENT_FIELD,
+  TS_SEGMENT_META,
+} ts_segment_type_t;
+
+struct ts_segment_s {
+  ts_segment_type_t type;
+  /* Literal text, or the placeholder itself for meta data, which is kept if
+   * the value list has no such meta data. Points into the template. */
+  char const *text;
+  size_t text_len;
+  /* TS_SEGMENT_FIELD: offset of the field in value_list_t. */
+  size_t offset;
+  /* TS_SEGMENT_META: the meta data key. */
+  char *key;
+};
+typedef struct ts_segment_s ts_segment_t;
+
+struct ts_template_s {
+  char *string;
+  ts_segment_t *segments;
+  size_t segments_num;
+};
+typedef struct ts_template_s ts_template_t;
+
+struct ts_meta_template_s {
+  char *key;
+  ts_template_t *tmpl;
+};
+typedef struct ts_meta_template_s ts_meta_template_t;
+
 struct ts_data_s {
-  char *host;
-  char *plugin;
-  char *plugin_instance;
-  /* char *type; */
-  char *type_instance;
+  ts_template_t *host;
+  ts_template_t *plugin;
+  ts_template_t *plugin_instance;
+  /* ts_template_t *type; */
+  ts_template_t *type_instance;
   meta_data_t *meta;
+  ts_meta_template_t *meta_templates;
+  size_t meta_templates_num;
   ts_key_list_t *meta_delete;
 };
 typedef struct ts_data_s ts_data_t;
 
+static void ts_template_free(ts_template_t *t) /* {{{ */
+{
+  if (t == NULL)
+    return;
+
+  for (size_t i = 0; i < t->segments_num; i++)
+    sfree(t->segments[i].key);
+  sfree(t->segments);
+  sfree(t->string);
+  sfree(t);
+} /* }}} void ts_template_free */
+
+static int ts_template_add(ts_template_t *t, /* {{{ */
+                           ts_segment_t const *seg) {
+  if ((seg->type == TS_SEGMENT_LITERAL) && (seg->text_len == 0))
+    return 0;
+
+  ts_segment_t *tmp =
+      realloc(t->segments, (t->segments_num + 1) * sizeof(*t->segments));
+  if (tmp == NULL)
+    return ENOMEM;
+  t->segments = tmp;
+  t->segments[t->segments_num] = *seg;
+  t->segments_num++;
+
+  return 0;
+} /* }}} int ts_template_add */
+
+/* Splits `string' at the placeholders `%{host}', `%{plugin}',
+ * `%{plugin_instance}', `%{type}', `%{type_instance}' and `%{meta:<key>}'.
+ * Anything else is literal text. */
+static ts_template_t *ts_template_create(char const *string) /* {{{ */
+{
+  static struct {
+    char const *name;
+    size_t offset;
+  } const fields[] = {
+      {"host", offsetof(value_list_t, host)},
+      {"plugin", offsetof(value_list_t, plugin)},
+      {"plugin_instance", offsetof(value_list_t, plugin_instance)},
+      {"type", offsetof(value_list_t, type)},
+      {"type_instance", offsetof(value_list_t, type_instance)},
+  };
+
+  ts_template_t *t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    return NULL;
+  t->string = strdup(string);
+  if (t->string == NULL) {
+    ts_template_free(t);
+    return NULL;
+  }
+
+  char const *literal = t->string;
+  char const *ptr = t->string;
+  while ((ptr = strstr(ptr, "%{")) != NULL) {
+    char const *name = ptr + 2;
+    char const *end = strchr(name, '}');
+    if (end == NULL)
+      break;
+    size_t name_len = (size_t)(end - name);
+
+    ts_segment_t seg = {.type = TS_SEGMENT_LITERAL};
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+      if ((strlen(fields[i].name) == name_len) &&
+          (strncmp(fields[i].name, name, name_len) == 0)) {
+        seg.type = TS_SEGMENT_FIELD;
+        seg.offset = fields[i].offset;
+        break;
+      }
+    }
+    if ((seg.type == TS_SEGMENT_LITERAL) && (name_len > strlen("meta:")) &&
+        (strncmp("meta:", name, strlen("meta:")) == 0)) {
+      size_t key_len = name_len - strlen("meta:");
+      seg.type = TS_SEGMENT_META;
+      seg.text = ptr;
+      seg.text_len = (size_t)(end + 1 - ptr);
+      seg.key = malloc(key_len + 1);
+      if (seg.key == NULL) {
+        ts_template_free(t);
+        return NULL;
+      }
+      memcpy(seg.key, name + strlen("meta:"), key_len);
+      seg.key[key_len] = 0;
+    }
+
+    if (seg.type == TS_SEGMENT_LITERAL) {
+      /* Not a placeholder. */
+      ptr = name;
+      continue;
+    }
+
+    ts_segment_t lit = {
+        .type = TS_SEGMENT_LITERAL,
+        .text = literal,
+        .text_len = (size_t)(ptr - literal),
+    };
+    if ((ts_template_add(t, &lit) != 0) || (ts_template_add(t, &seg) != 0)) {
+      sfree(seg.key);
+      ts_template_free(t);
+      return NULL;
+    }
+    literal = ptr = end + 1;
+  }
+
+  ts_segment_t lit = {
+      .type = TS_SEGMENT_LITERAL, .text = literal, .text_len = strlen(literal),
+  };
+  if (ts_template_add(t, &lit) != 0) {
+    ts_template_free(t);
+    return NULL;
+  }
+
+  return t;
+} /* }}} ts_template_t *ts_template_create */
+
 static int ts_util_get_key_and_string_wo_strdup(const oconfig_item_t *ci,
                                                 char **ret_key,
                                                 char **ret_string) /* {{{ */
@@ -79,7 +233,7 @@ static int ts_util_get_key_and_string_wo_strdup(const oconfig_item_t *ci,
   return 0;
 } /* }}} int ts_util_get_key_and_string_wo_strdup */
 
-static int ts_config_add_string(char **dest, /* {{{ */
+static int ts_config_add_string(ts_template_t **dest, /* {{{ */
                                 const oconfig_item_t *ci, int may_be_empty) {
   char *tmp = NULL;
   int status;
@@ -95,7 +249,15 @@ static int ts_config_add_string(char **dest, /* {{{ */
     return -1;
   }
 
-  *dest = tmp;
+  ts_template_t *t = ts_template_create(tmp);
+  sfree(tmp);
+  if (t == NULL) {
+    ERROR("Target `set': ts_template_create failed.");
+    return -ENOMEM;
+  }
+
+  ts_template_free(*dest);
+  *dest = t;
   return 0;
 } /* }}} int ts_config_add_string */
 
@@ -163,47 +325,33 @@ static int ts_config_add_meta_delete(ts_key_list_t **dest, /* {{{ */
   return 0;
 } /* }}} int ts_config_add_meta_delete */
 
-static void ts_subst(char *dest, size_t size, const char *string, /* {{{ */
-                     const value_list_t *vl) {
-  char temp[DATA_MAX_NAME_LEN];
-
-  /* Initialize the field with the template. */
-  sstrncpy(dest, string, size);
-
-  if (strchr(dest, '%') == NULL)
-    return;
-
-#define REPLACE_FIELD(t, v)                                                    \
-  if (subst_string(temp, sizeof(temp), dest, t, v) != NULL)                    \
-    sstrncpy(dest, temp, size);
-  REPLACE_FIELD("%{host}", vl->host);
-  REPLACE_FIELD("%{plugin}", vl->plugin);
-  REPLACE_FIELD("%{plugin_instance}", vl->plugin_instance);
-  REPLACE_FIELD("%{type}", vl->type);
-  REPLACE_FIELD("%{type_instance}", vl->type_instance);
-
-  if (vl->meta != NULL) {
-    char **meta_toc = NULL;
-    int status = meta_data_toc(vl->meta, &meta_toc);
-    if (status <= 0)
-      return;
-    size_t meta_entries = (size_t)status;
-
-    for (size_t i = 0; i < meta_entries; i++) {
-      char meta_name[DATA_MAX_NAME_LEN];
-      char *value_str;
-      const char *key = meta_toc[i];
-
-      snprintf(meta_name, sizeof(meta_name), "%%{meta:%s}", key);
-      if (meta_data_as_string(vl->meta, key, &value_str) != 0)
-        continue;
-
-      REPLACE_FIELD(meta_name, value_str);
-      sfree(value_str);
+static void ts_subst(char *dest, size_t size, /* {{{ */
+                     ts_template_t const *t, const value_list_t *vl) {
+  size_t len = 0;
+
+  for (size_t i = 0; (i < t->segments_num) && (len + 1 < size); i++) {
+    ts_segment_t const *seg = t->segments + i;
+    char const *value = seg->text;
+    size_t value_len = seg->text_len;
+    char *meta_value = NULL;
+
+    if (seg->type == TS_SEGMENT_FIELD) {
+      value = ((char const *)vl) + seg->offset;
+      value_len = strlen(value);
+    } else if ((seg->type == TS_SEGMENT_META) && (vl->meta != NULL) &&
+               (meta_data_as_string(vl->meta, seg->key, &meta_value) == 0)) {
+      value = meta_value;
+      value_len = strlen(value);
     }
 
-    strarray_free(meta_toc, (size_t)meta_entries);
+    if (value_len > size - 1 - len)
+      value_len = size - 1 - len;
+    memcpy(dest + len, value, value_len);
+    len += value_len;
+    sfree(meta_value);
   }
+
+  dest[len] = 0;
 } /* }}} int ts_subst */
 
 static int ts_destroy(void **user_data) /* {{{ */
@@ -217,18 +365,68 @@ static int ts_destroy(void **user_data) /* {{{ */
   if (data == NULL)
     return 0;
 
-  free(data->host);
-  free(data->plugin);
-  free(data->plugin_instance);
-  /* free (data->type); */
-  free(data->type_instance);
+  ts_template_free(data->host);
+  ts_template_free(data->plugin);
+  ts_template_free(data->plugin_instance);
+  /* ts_template_free (data->type); */
+  ts_template_free(data->type_instance);
   meta_data_destroy(data->meta);
+  for (size_t i = 0; i < data->meta_templates_num; i++) {
+    free(data->meta_templates[i].key);
+    ts_template_free(data->meta_templates[i].tmpl);
+  }
+  free(data->meta_templates);
   ts_key_list_free(data->meta_delete);
   free(data);
 
   return 0;
 } /* }}} int ts_destroy */
 
+/* Builds the templates of the meta data to set. */
+static int ts_compile_meta(ts_data_t *data) /* {{{ */
+{
+  char **meta_toc = NULL;
+  int status = meta_data_toc(data->meta, &meta_toc);
+  if (status < 0) {
+    ERROR("Target `set': meta_data_toc failed with status %d.", status);
+    return status;
+  }
+  size_t meta_entries = (size_t)status;
+
+  data->meta_templates = calloc(meta_entries, sizeof(*data->meta_templates));
+  if ((data->meta_templates == NULL) && (meta_entries > 0)) {
+    ERROR("ts_compile_meta: calloc failed.");
+    strarray_free(meta_toc, meta_entries);
+    return -ENOMEM;
+  }
+
+  status = 0;
+  for (size_t i = 0; i < meta_entries; i++) {
+    ts_meta_template_t *mt = data->meta_templates + i;
+    char *string = NULL;
+
+    status = meta_data_get_string(data->meta, meta_toc[i], &string);
+    if (status != 0) {
+      ERROR("Target `set': Unable to get replacement metadata value `%s'.",
+            meta_toc[i]);
+      break;
+    }
+
+    mt->key = strdup(meta_toc[i]);
+    mt->tmpl = ts_template_create(string);
+    sfree(string);
+    data->meta_templates_num++;
+    if ((mt->key == NULL) || (mt->tmpl == NULL)) {
+      ERROR("Target `set': ts_template_create failed.");
+      status = -ENOMEM;
+      break;
+    }
+  }
+
+  strarray_free(meta_toc, meta_entries);
+  return status;
+} /* }}} int ts_compile_meta */
+
 static int ts_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
 {
   ts_data_t *data;
@@ -314,6 +512,9 @@ static int ts_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     break;
   }
 
+  if ((status == 0) && (data->meta != NULL))
+    status = ts_compile_meta(data);
+
   if (status != 0) {
     ts_destroy((void *)&data);
     return status;
@@ -341,57 +542,36 @@ static int ts_invoke(const data_set_t *ds, value_list_t *vl, /* {{{ */
 
   orig = *vl;
 
-  if (data->meta != NULL) {
+  if (data->meta_templates_num > 0) {
     char temp[DATA_MAX_NAME_LEN * 2];
-    char **meta_toc;
 
     if ((new_meta = meta_data_create()) == NULL) {
       ERROR("Target `set': failed to create replacement metadata.");
       return -ENOMEM;
     }
 
-    int status = meta_data_toc(data->meta, &meta_toc);
-    if (status < 0) {
-      ERROR("Target `set': meta_data_toc failed with status %d.", status);
-      meta_data_destroy(new_meta);
-      return status;
-    }
-    size_t meta_entries = (size_t)status;
-
-    for (size_t i = 0; i < meta_entries; i++) {
-      const char *key = meta_toc[i];
-      char *string;
-      int status;
+    for (size_t i = 0; i < data->meta_templates_num; i++) {
+      ts_meta_template_t const *mt = data->meta_templates + i;
 
-      status = meta_data_get_string(data->meta, key, &string);
-      if (status) {
-        ERROR("Target `set': Unable to get replacement metadata value `%s'.",
-              key);
-        strarray_free(meta_toc, meta_entries);
-        meta_data_destroy(new_meta);
-        return status;
-      }
-
-      ts_subst(temp, sizeof(temp), string, &orig);
+      ts_subst(temp, sizeof(temp), mt->tmpl, &orig);
 
       DEBUG("target_set: ts_invoke: setting metadata value for key `%s': "
             "`%s'.",
-            key, temp);
+            mt->key, temp);
 
-      sfree(string);
-
-      status = meta_data_add_string(new_meta, key, temp);
+      int status = meta_data_add_string(new_meta, mt->key, temp);
       if (status) {
-        ERROR("Target `set': Unable to set metadata value `%s'.", key);
-        strarray_free(meta_toc, meta_entries);
+        ERROR("Target `set': Unable to set metadata value `%s'.", mt->key);
         meta_data_destroy(new_meta);
         return status;
       }
     }
-
-    strarray_free(meta_toc, meta_entries);
   }
 
+  if ((data->host != NULL) || (data->plugin != NULL) ||
+      (data->plugin_instance != NULL) || (data->type_instance != NULL))
+    ident_reset(vl);
+
 #define SUBST_FIELD(f)                                                         \
   if (data->f != NULL) {                                                       \
     ts_subst(vl->f, sizeof(vl->f), data->f, &orig);                            \
@@ -65,6 +65,7 @@ static int v5_df(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Move the mount point name to the plugin instance */
   if (new_vl.plugin_instance[0] == 0)
@@ -122,6 +123,7 @@ static int v5_mysql_qcache(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Change the type to "cache_result" */
   sstrncpy(new_vl.type, "cache_result", sizeof(new_vl.type));
@@ -176,6 +178,7 @@ static int v5_mysql_threads(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Change the type to "threads" */
   sstrncpy(new_vl.type, "threads", sizeof(new_vl.type));
@@ -232,6 +235,7 @@ static int v5_zfs_arc_counts(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Change the type to "cache_result" */
   sstrncpy(new_vl.type, "cache_result", sizeof(new_vl.type));
@@ -278,6 +282,7 @@ static int v5_zfs_arc_l2_bytes(const data_set_t *ds, value_list_t *vl) /* {{{ */
 
   /* Reset data we can't simply copy */
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Change the type/-instance to "io_octets-L2" */
   sstrncpy(new_vl.type, "io_octets", sizeof(new_vl.type));
@@ -318,6 +323,7 @@ static int v5_zfs_arc_l2_size(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   new_vl.values[0].gauge = (gauge_t)vl->values[0].gauge;
 
@@ -354,6 +360,7 @@ static int v5_zfs_arc_ratio(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   new_vl.values[0].gauge = (gauge_t)vl->values[0].gauge;
 
@@ -391,6 +398,7 @@ static int v5_zfs_arc_size(const data_set_t *ds, value_list_t *vl) /* {{{ */
   new_vl.values = &(value_t){.gauge = NAN};
   new_vl.values_len = 1;
   new_vl.meta = NULL;
+  new_vl.ident = NULL;
 
   /* Change the type to "cache_size" */
   sstrncpy(new_vl.type, "cache_size", sizeof(new_vl.type));
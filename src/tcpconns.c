@@ -80,6 +80,9 @@
 #if HAVE_LINUX_INET_DIAG_H
 #include <linux/inet_diag.h>
 #endif
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
+#include <linux/sock_diag.h>
+#endif
 #include <arpa/inet.h>
 /* #endif KERNEL_LINUX */
 
@@ -149,11 +152,18 @@
 #endif /* KERNEL_AIX */
 
 #if KERNEL_LINUX
-#if HAVE_STRUCT_LINUX_INET_DIAG_REQ
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
 struct nlreq {
   struct nlmsghdr nlh;
-  struct inet_diag_req r;
+  struct inet_diag_req_v2 r;
 };
+
+/* The kernel fills at most 32 KiB per recvmsg(2) of a dump. */
+#define CONN_NETLINK_BUFFER_SIZE 32768
+
+/* Every port of the filter is compared with an S_GE and an S_LE (or D_GE and
+ * D_LE) operation, each followed by its port, and a jump to the end. */
+#define CONN_BC_PORT_OPS 5
 #endif
 
 static const char *tcp_state[] = {"", /* 0 */
@@ -267,11 +277,16 @@ static port_entry_t *port_list_head;
 static uint32_t count_total[TCP_STATE_MAX + 1];
 
 #if KERNEL_LINUX
-#if HAVE_STRUCT_LINUX_INET_DIAG_REQ
-/* This depends on linux inet_diag_req because if this structure is missing,
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
+/* This depends on linux inet_diag_req_v2 because if this structure is missing,
  * sequence_number is useless and we get a compilation warning.
  */
 static uint32_t sequence_number;
+
+/* The sock_diag socket and its receive buffer are kept between reads. */
+static int diag_fd = -1;
+static char *diag_buffer;
+static bool diag_no_inet6;
 #endif
 
 static enum { SRC_DUNNO, SRC_NETLINK, SRC_PROC } linux_source = SRC_DUNNO;
@@ -444,85 +459,159 @@ static int conn_handle_ports(uint16_t port_local, uint16_t port_remote,
 } /* int conn_handle_ports */
 
 #if KERNEL_LINUX
-/* Returns zero on success, less than zero on socket error and greater than
- * zero on other errors. */
-static int conn_read_netlink(void) {
-#if HAVE_STRUCT_LINUX_INET_DIAG_REQ
-  int fd;
-  struct inet_diag_msg *r;
-  char buf[8192];
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
+static void conn_netlink_close(void) {
+  if (diag_fd >= 0)
+    close(diag_fd);
+  diag_fd = -1;
+} /* void conn_netlink_close */
+
+/* conn_bc_ports_num returns the number of port comparisons of the filter. */
+static size_t conn_bc_ports_num(void) {
+  size_t ports_num = 0;
+
+  for (port_entry_t *pe = port_list_head; pe != NULL; pe = pe->next) {
+    if (pe->flags & (PORT_COLLECT_LOCAL | PORT_IS_LISTENING))
+      ports_num++;
+    if (pe->flags & PORT_COLLECT_REMOTE)
+      ports_num++;
+  }
 
-  /* If this fails, it's likely a permission problem. We'll fall back to
-   * reading this information from files below. */
-  fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_INET_DIAG);
-  if (fd < 0) {
-    ERROR("tcpconns plugin: conn_read_netlink: socket(AF_NETLINK, SOCK_RAW, "
-          "NETLINK_INET_DIAG) failed: %s",
-          STRERRNO);
-    return -1;
+  return ports_num;
+} /* size_t conn_bc_ports_num */
+
+/* conn_bc_build returns a filter that matches the sockets whose local port is
+ * collected or listening, or whose remote port is collected. Returns NULL if
+ * there are too many ports for a filter. */
+static struct inet_diag_bc_op *conn_bc_build(size_t ports_num,
+                                             size_t *ret_len) {
+  size_t len = ports_num * CONN_BC_PORT_OPS * sizeof(struct inet_diag_bc_op);
+  /* Jumps are limited to 16 bits. */
+  if (len + 4 > UINT16_MAX)
+    return NULL;
+
+  struct inet_diag_bc_op *bc = calloc(ports_num * CONN_BC_PORT_OPS, sizeof(*bc));
+  if (bc == NULL)
+    return NULL;
+
+  /* The filter accepts a socket by reaching the end of the program and
+   * rejects it by jumping four bytes past it. */
+  struct inet_diag_bc_op *op = bc;
+  size_t remaining = len;
+  for (port_entry_t *pe = port_list_head; pe != NULL; pe = pe->next) {
+    for (int remote = 0; remote < 2; remote++) {
+      if (!remote && !(pe->flags & (PORT_COLLECT_LOCAL | PORT_IS_LISTENING)))
+        continue;
+      if (remote && !(pe->flags & PORT_COLLECT_REMOTE))
+        continue;
+
+      bool last = (remaining == CONN_BC_PORT_OPS * sizeof(*op));
+      /* Jump to the next port, or reject the socket for the last one. */
+      unsigned short no_ge = last ? (unsigned short)(remaining + 4) : 20;
+      unsigned short no_le = last ? (unsigned short)(remaining - 8 + 4) : 12;
+
+      op[0] = (struct inet_diag_bc_op){
+          .code = remote ? INET_DIAG_BC_D_GE : INET_DIAG_BC_S_GE,
+          .yes = 8,
+          .no = no_ge,
+      };
+      op[1] = (struct inet_diag_bc_op){.no = pe->port};
+      op[2] = (struct inet_diag_bc_op){
+          .code = remote ? INET_DIAG_BC_D_LE : INET_DIAG_BC_S_LE,
+          .yes = 8,
+          .no = no_le,
+      };
+      op[3] = (struct inet_diag_bc_op){.no = pe->port};
+      /* Both comparisons are true: accept the socket. */
+      op[4] = (struct inet_diag_bc_op){
+          .code = INET_DIAG_BC_JMP,
+          .yes = 4,
+          .no = (unsigned short)(remaining - 16),
+      };
+
+      op += CONN_BC_PORT_OPS;
+      remaining -= CONN_BC_PORT_OPS * sizeof(*op);
+    }
   }
 
+  *ret_len = len;
+  return bc;
+} /* struct inet_diag_bc_op *conn_bc_build */
+
+/* conn_netlink_dump requests the TCP sockets of "family" in one of "states"
+ * and, if "bc" is not NULL, accepted by the filter "bc". Returns zero on
+ * success, less than zero on socket error and greater than zero on other
+ * errors. */
+static int conn_netlink_dump(uint8_t family, uint32_t states,
+                             struct inet_diag_bc_op *bc, size_t bc_len) {
   struct sockaddr_nl nladdr = {.nl_family = AF_NETLINK};
+  struct nlattr nla = {
+      .nla_len = (uint16_t)(NLA_HDRLEN + bc_len),
+      .nla_type = INET_DIAG_REQ_BYTECODE,
+  };
 
   struct nlreq req = {
       .nlh.nlmsg_len = sizeof(req),
-      .nlh.nlmsg_type = TCPDIAG_GETSOCK,
-      /* NLM_F_ROOT: return the complete table instead of a single entry.
-       * NLM_F_MATCH: return all entries matching criteria (not implemented)
-       * NLM_F_REQUEST: must be set on all request messages */
-      .nlh.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST,
+      .nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY,
+      .nlh.nlmsg_flags = NLM_F_DUMP | NLM_F_REQUEST,
       .nlh.nlmsg_pid = 0,
       /* The sequence_number is used to track our messages. Since netlink is not
        * reliable, we don't want to end up with a corrupt or incomplete old
        * message in case the system is/was out of memory. */
       .nlh.nlmsg_seq = ++sequence_number,
-      .r.idiag_family = AF_INET,
-      .r.idiag_states = 0xfff,
+      .r.sdiag_family = family,
+      .r.sdiag_protocol = IPPROTO_TCP,
+      .r.idiag_states = states,
       .r.idiag_ext = 0};
 
-  struct iovec iov = {.iov_base = &req, .iov_len = sizeof(req)};
+  struct iovec iov[3] = {
+      {.iov_base = &req, .iov_len = sizeof(req)},
+      {.iov_base = &nla, .iov_len = NLA_HDRLEN},
+      {.iov_base = bc, .iov_len = bc_len},
+  };
+  size_t iov_num = 1;
+  if (bc != NULL) {
+    req.nlh.nlmsg_len += NLA_HDRLEN + bc_len;
+    iov_num = 3;
+  }
 
   struct msghdr msg = {.msg_name = (void *)&nladdr,
                        .msg_namelen = sizeof(nladdr),
-                       .msg_iov = &iov,
-                       .msg_iovlen = 1};
+                       .msg_iov = iov,
+                       .msg_iovlen = iov_num};
 
-  if (sendmsg(fd, &msg, 0) < 0) {
+  if (sendmsg(diag_fd, &msg, 0) < 0) {
     ERROR("tcpconns plugin: conn_read_netlink: sendmsg(2) failed: %s",
           STRERRNO);
-    close(fd);
     return -1;
   }
 
-  iov.iov_base = buf;
-  iov.iov_len = sizeof(buf);
-
   while (1) {
+    struct iovec riov = {.iov_base = diag_buffer,
+                         .iov_len = CONN_NETLINK_BUFFER_SIZE};
     struct nlmsghdr *h;
 
     memset(&msg, 0, sizeof(msg));
     msg.msg_name = (void *)&nladdr;
     msg.msg_namelen = sizeof(nladdr);
-    msg.msg_iov = &iov;
+    msg.msg_iov = &riov;
     msg.msg_iovlen = 1;
 
-    ssize_t status = recvmsg(fd, (void *)&msg, /* flags = */ 0);
+    ssize_t status = recvmsg(diag_fd, (void *)&msg, /* flags = */ 0);
     if (status < 0) {
       if ((errno == EINTR) || (errno == EAGAIN))
         continue;
 
       ERROR("tcpconns plugin: conn_read_netlink: recvmsg(2) failed: %s",
             STRERRNO);
-      close(fd);
       return -1;
     } else if (status == 0) {
-      close(fd);
       DEBUG("tcpconns plugin: conn_read_netlink: Unexpected zero-sized "
             "reply from netlink socket.");
       return 0;
     }
 
-    h = (struct nlmsghdr *)buf;
+    h = (struct nlmsghdr *)diag_buffer;
     while (NLMSG_OK(h, status)) {
       if (h->nlmsg_seq != sequence_number) {
         h = NLMSG_NEXT(h, status);
@@ -530,20 +619,24 @@ static int conn_read_netlink(void) {
       }
 
       if (h->nlmsg_type == NLMSG_DONE) {
-        close(fd);
         return 0;
       } else if (h->nlmsg_type == NLMSG_ERROR) {
         struct nlmsgerr *msg_error;
 
         msg_error = NLMSG_DATA(h);
+        /* Without IPv6 support, the kernel has no handler for AF_INET6. */
+        if ((family == AF_INET6) && (msg_error->error == -ENOENT)) {
+          INFO("tcpconns plugin: The kernel does not report IPv6 sockets.");
+          diag_no_inet6 = true;
+          return 0;
+        }
+
         WARNING("tcpconns plugin: conn_read_netlink: Received error %i.",
                 msg_error->error);
-
-        close(fd);
         return 1;
       }
 
-      r = NLMSG_DATA(h);
+      struct inet_diag_msg *r = NLMSG_DATA(h);
 
       /* This code does not (need to) distinguish between IPv4 and IPv6. */
       conn_handle_ports(ntohs(r->id.idiag_sport), ntohs(r->id.idiag_dport),
@@ -555,9 +648,75 @@ static int conn_read_netlink(void) {
 
   /* Not reached because the while() loop above handles the exit condition. */
   return 0;
+} /* int conn_netlink_dump */
+#endif /* HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2 */
+
+/* Returns zero on success, less than zero on socket error and greater than
+ * zero on other errors. */
+static int conn_read_netlink(void) {
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
+  uint32_t states = 0xfff;
+  int status = 0;
+
+  if (diag_buffer == NULL) {
+    diag_buffer = malloc(CONN_NETLINK_BUFFER_SIZE);
+    if (diag_buffer == NULL) {
+      ERROR("tcpconns plugin: conn_read_netlink: malloc failed.");
+      return -1;
+    }
+  }
+
+  /* If this fails, it's likely a permission problem. We'll fall back to
+   * reading this information from files below. */
+  if (diag_fd < 0) {
+    diag_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (diag_fd < 0) {
+      ERROR("tcpconns plugin: conn_read_netlink: socket(AF_NETLINK, SOCK_RAW, "
+            "NETLINK_SOCK_DIAG) failed: %s",
+            STRERRNO);
+      return -1;
+    }
+  }
+
+  uint8_t families[] = {AF_INET, AF_INET6};
+
+  /* The summary needs all sockets. Otherwise the kernel only returns the
+   * listening sockets and the sockets of the selected ports. The listening
+   * sockets are dumped first, so that their ports are part of the filter. */
+  if (!port_collect_total && port_collect_listening) {
+    for (size_t i = 0; (i < STATIC_ARRAY_SIZE(families)) && (status == 0); i++)
+      if ((families[i] != AF_INET6) || !diag_no_inet6)
+        status = conn_netlink_dump(families[i], 1 << TCP_STATE_LISTEN,
+                                   /* bc = */ NULL, /* bc_len = */ 0);
+    states &= ~(1 << TCP_STATE_LISTEN);
+  }
+
+  struct inet_diag_bc_op *bc = NULL;
+  size_t bc_len = 0;
+  if (!port_collect_total) {
+    size_t ports_num = conn_bc_ports_num();
+    /* Only listening ports are collected and there are none. */
+    if (ports_num == 0)
+      states = 0;
+    else
+      bc = conn_bc_build(ports_num, &bc_len);
+  }
+
+  for (size_t i = 0;
+       (i < STATIC_ARRAY_SIZE(families)) && (status == 0) && (states != 0);
+       i++)
+    if ((families[i] != AF_INET6) || !diag_no_inet6)
+      status = conn_netlink_dump(families[i], states, bc, bc_len);
+  sfree(bc);
+
+  /* The socket may hold the rest of a failed dump. */
+  if (status != 0)
+    conn_netlink_close();
+
+  return status;
 #else
   return 1;
-#endif /* HAVE_STRUCT_LINUX_INET_DIAG_REQ */
+#endif /* HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2 */
 } /* int conn_read_netlink */
 
 static int conn_handle_line(char *buffer) {
@@ -729,6 +888,14 @@ static int conn_read(void) {
 
   return 0;
 } /* int conn_read */
+
+static int conn_shutdown(void) {
+#if HAVE_STRUCT_LINUX_INET_DIAG_REQ_V2
+  conn_netlink_close();
+  sfree(diag_buffer);
+#endif
+  return 0;
+} /* int conn_shutdown */
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_SYSCTLBYNAME
@@ -1033,4 +1200,7 @@ void module_register(void) {
 /* no initialization */
 #endif
   plugin_register_read("tcpconns", conn_read);
+#if KERNEL_LINUX
+  plugin_register_shutdown("tcpconns", conn_shutdown);
+#endif
 } /* void module_register */
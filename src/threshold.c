@@ -26,7 +26,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils_cache.h"
 #include "utils_threshold.h"
@@ -38,6 +38,10 @@
  * the underlying AVL trees.
  */
 
+/* The tree ut_threshold_add adds to: "threshold_tree" while the configuration
+ * is read, a new tree while it is reloaded. */
+static c_btree_t *ut_tree;
+
 /*
  * int ut_threshold_add
  *
@@ -76,15 +80,15 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
 
   pthread_mutex_lock(&threshold_lock);
 
-  th_ptr = threshold_get(th->host, th->plugin, th->plugin_instance, th->type,
-                         th->type_instance);
+  if (c_btree_get(ut_tree, name, (void *)&th_ptr) != 0)
+    th_ptr = NULL;
 
   while ((th_ptr != NULL) && (th_ptr->next != NULL))
     th_ptr = th_ptr->next;
 
   if (th_ptr == NULL) /* no such threshold yet */
   {
-    status = c_avl_insert(threshold_tree, name_copy, th_copy);
+    status = c_btree_insert(ut_tree, name_copy, th_copy);
   } else /* th_ptr points to the last threshold in the list */
   {
     th_ptr->next = th_copy;
@@ -92,10 +96,13 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
     sfree(name_copy);
   }
 
+  if (status == 0)
+    threshold_generation++;
+
   pthread_mutex_unlock(&threshold_lock);
 
   if (status != 0) {
-    ERROR("ut_threshold_add: c_avl_insert (%s) failed.", name);
+    ERROR("ut_threshold_add: c_btree_insert (%s) failed.", name);
     sfree(name_copy);
     sfree(th_copy);
   }
@@ -270,56 +277,65 @@ static int ut_config_host(const threshold_t *th_orig, oconfig_item_t *ci) {
 /* }}} */
 
 /*
- * int ut_report_state
+ * bool ut_update_state
  *
- * Checks if the `state' differs from the old state and creates a notification
- * if appropriate.
- * Does not fail.
+ * Updates the hit counter and state of a cache entry. Returns true if the
+ * `state' differs from the old state, which is stored in `ret_state_old', or
+ * a notification should be sent anyway.
  */
-static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
-                           const threshold_t *th, const gauge_t *values,
-                           int ds_index, int state) { /* {{{ */
-  int state_old;
-  notification_t n;
-
-  char *buf;
-  size_t bufsize;
-
-  int status;
-
+static bool ut_update_state(const threshold_t *th, int state, /* {{{ */
+                            uc_threshold_state_t *entry, int *ret_state_old) {
   /* Check if hits matched */
   if ((th->hits != 0)) {
-    int hits = uc_get_hits(ds, vl);
     /* STATE_OKAY resets hits unless PERSIST_OK flag is set. Hits resets if
      * threshold is hit. */
     if (((state == STATE_OKAY) && ((th->flags & UT_FLAG_PERSIST_OK) == 0)) ||
-        (hits > th->hits)) {
-      DEBUG("ut_report_state: reset uc_get_hits = 0");
-      uc_set_hits(ds, vl, 0); /* reset hit counter and notify */
+        (entry->hits > th->hits)) {
+      DEBUG("ut_update_state: reset hits = 0");
+      entry->hits = 0; /* reset hit counter and notify */
     } else {
-      DEBUG("ut_report_state: th->hits = %d, uc_get_hits = %d", th->hits,
-            uc_get_hits(ds, vl));
-      (void)uc_inc_hits(ds, vl, 1); /* increase hit counter */
-      return 0;
+      DEBUG("ut_update_state: th->hits = %d, hits = %d", th->hits,
+            entry->hits);
+      entry->hits++; /* increase hit counter */
+      return false;
     }
   } /* end check hits */
 
-  state_old = uc_get_state(ds, vl);
+  int state_old = entry->state;
+  *ret_state_old = state_old;
 
   /* If the state didn't change, report if `persistent' is specified. If the
    * state is `okay', then only report if `persist_ok` flag is set. */
   if (state == state_old) {
     if (state == STATE_UNKNOWN) {
       /* From UNKNOWN to UNKNOWN. Persist doesn't apply here. */
-      return 0;
+      return false;
     } else if ((th->flags & UT_FLAG_PERSIST) == 0)
-      return 0;
+      return false;
     else if ((state == STATE_OKAY) && ((th->flags & UT_FLAG_PERSIST_OK) == 0))
-      return 0;
+      return false;
   }
 
-  if (state != state_old)
-    uc_set_state(ds, vl, state);
+  entry->state = state;
+  return true;
+} /* }}} bool ut_update_state */
+
+/*
+ * int ut_report_state
+ *
+ * Creates a notification for a state change determined by ut_update_state.
+ * Does not fail.
+ */
+static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
+                           const threshold_t *th, const gauge_t *values,
+                           int ds_index, int state,
+                           int state_old) { /* {{{ */
+  notification_t n;
+
+  char *buf;
+  size_t bufsize;
+
+  int status;
 
   NOTIFICATION_INIT_VL(&n, vl);
 
@@ -450,13 +466,13 @@ static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
  * appropriate.
  * Does not fail.
  */
-static int ut_check_one_data_source(
-    const data_set_t *ds, const value_list_t __attribute__((unused)) * vl,
-    const threshold_t *th, const gauge_t *values, int ds_index) { /* {{{ */
+static int ut_check_one_data_source(const data_set_t *ds,
+                                    const threshold_t *th,
+                                    const gauge_t *values, int ds_index,
+                                    int prev_state) { /* {{{ */
   const char *ds_name;
   int is_warning = 0;
   int is_failure = 0;
-  int prev_state = STATE_OKAY;
 
   /* check if this threshold applies to this data source */
   if (ds != NULL) {
@@ -473,7 +489,6 @@ static int ut_check_one_data_source(
   /* XXX: This is an experimental code, not optimized, not fast, not reliable,
    * and probably, do not work as you expect. Enjoy! :D */
   if (th->hysteresis > 0) {
-    prev_state = uc_get_state(ds, vl);
     /* The purpose of hysteresis is elliminating flapping state when the value
      * oscilates around the thresholds. In other words, what is important is
      * the previous state; if the new value would trigger a transition, make
@@ -535,10 +550,11 @@ static int ut_check_one_data_source(
  * the ut_check_one_data_source function above. Returns the worst status,
  * which is `okay' if nothing has failed or `unknown' if no valid datasource was
  * defined.
+ * `prev_state' is the state of the value list before this check.
  * Returns less than zero if the data set doesn't have any data sources.
  */
-static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
-                                  const threshold_t *th, const gauge_t *values,
+static int ut_check_one_threshold(const data_set_t *ds, const threshold_t *th,
+                                  const gauge_t *values, int prev_state,
                                   int *ret_ds_index) { /* {{{ */
   int ret = -1;
   int ds_index = -1;
@@ -581,7 +597,7 @@ static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
   for (size_t i = 0; i < ds->ds_num; i++) {
     int status;
 
-    status = ut_check_one_data_source(ds, vl, th, values_copy, i);
+    status = ut_check_one_data_source(ds, th, values_copy, i, prev_state);
     if (ret < status) {
       ret = status;
       ds_index = i;
@@ -594,51 +610,67 @@ static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
   return ret;
 } /* }}} int ut_check_one_threshold */
 
-/*
- * int ut_check_threshold
- *
- * Gets a list of matching thresholds and searches for the worst status by one
- * of the thresholds. Then reports that status using the ut_report_state
- * function above.
- * Returns zero on success and if no threshold has been configured. Returns
- * less than zero on failure.
- */
-static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
-                              __attribute__((unused))
-                              user_data_t *ud) { /* {{{ */
-  threshold_t *th;
+/* The result of ut_check_entry. "values" has room for "ds->ds_num" rates.
+ * The notification, if any, is sent after the cache entry has been unlocked. */
+typedef struct {
+  const data_set_t *ds;
+  const value_list_t *vl;
   gauge_t *values;
-  int status;
 
-  int worst_state = -1;
-  threshold_t *worst_th = NULL;
-  int worst_ds_index = -1;
+  int status;
+  bool report;
+  const threshold_t *th;
+  int ds_index;
+  int state;
+  int state_old;
+} ut_check_t;
 
-  if (threshold_tree == NULL)
-    return 0;
+/*
+ * void ut_check_entry
+ *
+ * uc_threshold_callback_t that checks the current rates of a cache entry
+ * against the matching thresholds. The thresholds are only looked up if the
+ * configuration has changed since they were last resolved for the entry.
+ */
+static void ut_check_entry(gauge_t const *rates, size_t rates_num, /* {{{ */
+                           uc_threshold_state_t *entry, void *user_data) {
+  ut_check_t *c = user_data;
 
-  /* Is this lock really necessary? So far, thresholds are only inserted at
-   * startup. -octo */
   pthread_mutex_lock(&threshold_lock);
-  th = threshold_search(vl);
+  if (entry->generation != threshold_generation) {
+    entry->threshold = threshold_search(c->vl);
+    entry->generation = threshold_generation;
+  }
   pthread_mutex_unlock(&threshold_lock);
+
+  const threshold_t *th = entry->threshold;
   if (th == NULL)
-    return 0;
+    return;
 
-  DEBUG("ut_check_threshold: Found matching threshold(s)");
+  DEBUG("ut_check_entry: Found matching threshold(s)");
 
-  values = uc_get_rate(ds, vl);
-  if (values == NULL)
-    return 0;
+  if (rates_num != c->ds->ds_num) {
+    ERROR("ut_check_entry: The cache entry has %" PRIsz " values, but the "
+          "\"%s\" type has %" PRIsz " data sources.",
+          rates_num, c->ds->type, c->ds->ds_num);
+    c->status = -1;
+    return;
+  }
+  memcpy(c->values, rates, rates_num * sizeof(*c->values));
+
+  int worst_state = -1;
+  const threshold_t *worst_th = NULL;
+  int worst_ds_index = -1;
 
   while (th != NULL) {
     int ds_index = -1;
 
-    status = ut_check_one_threshold(ds, vl, th, values, &ds_index);
+    int status =
+        ut_check_one_threshold(c->ds, th, c->values, entry->state, &ds_index);
     if (status < 0) {
-      ERROR("ut_check_threshold: ut_check_one_threshold failed.");
-      sfree(values);
-      return -1;
+      ERROR("ut_check_entry: ut_check_one_threshold failed.");
+      c->status = -1;
+      return;
     }
 
     if (worst_state < status) {
@@ -650,16 +682,50 @@ static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
     th = th->next;
   } /* while (th) */
 
-  status =
-      ut_report_state(ds, vl, worst_th, values, worst_ds_index, worst_state);
+  c->th = worst_th;
+  c->ds_index = worst_ds_index;
+  c->state = worst_state;
+  c->report = ut_update_state(worst_th, worst_state, entry, &c->state_old);
+} /* }}} void ut_check_entry */
+
+/*
+ * int ut_check_threshold
+ *
+ * Gets a list of matching thresholds and searches for the worst status by one
+ * of the thresholds. Then reports that status using the ut_report_state
+ * function above.
+ * Returns zero on success and if no threshold has been configured. Returns
+ * less than zero on failure.
+ */
+static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
+                              __attribute__((unused))
+                              user_data_t *ud) { /* {{{ */
+  gauge_t values[ds->ds_num];
+
+  if (threshold_tree == NULL)
+    return 0;
+
+  ut_check_t c = {
+      .ds = ds, .vl = vl, .values = values,
+  };
+
+  /* One cache access: the rates are read and the state is updated with the
+   * entry locked. */
+  if (uc_threshold_update(ds, vl, ut_check_entry, &c) != 0)
+    return 0;
+
+  if (c.status != 0)
+    return c.status;
+  if (!c.report)
+    return 0;
+
+  int status = ut_report_state(ds, vl, c.th, c.values, c.ds_index, c.state,
+                               c.state_old);
   if (status != 0) {
     ERROR("ut_check_threshold: ut_report_state failed.");
-    sfree(values);
     return -1;
   }
 
-  sfree(values);
-
   return 0;
 } /* }}} int ut_check_threshold */
 
@@ -699,17 +765,37 @@ static int ut_missing(const value_list_t *vl,
   return 0;
 } /* }}} int ut_missing */
 
-static int ut_config(oconfig_item_t *ci) { /* {{{ */
-  int status = 0;
-  int old_size = c_avl_size(threshold_tree);
+static void ut_tree_free(c_btree_t *tree) { /* {{{ */
+  char *name;
+  threshold_t *th;
 
-  if (threshold_tree == NULL) {
-    threshold_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
-    if (threshold_tree == NULL) {
-      ERROR("ut_config: c_avl_create failed.");
-      return -1;
+  while (c_btree_pick(tree, (void *)&name, (void *)&th) == 0) {
+    sfree(name);
+    while (th != NULL) {
+      threshold_t *next = th->next;
+      sfree(th);
+      th = next;
     }
   }
+  c_btree_destroy(tree);
+} /* }}} void ut_tree_free */
+
+static void ut_register_callbacks(void) { /* {{{ */
+  static bool registered;
+
+  if (registered || (c_btree_size(threshold_tree) == 0))
+    return;
+
+  plugin_register_missing("threshold", ut_missing,
+                          /* user data = */ NULL);
+  plugin_register_write("threshold", ut_check_threshold,
+                        /* user data = */ NULL);
+  registered = true;
+} /* }}} void ut_register_callbacks */
+
+/* Adds the thresholds configured in "ci" to "ut_tree". */
+static int ut_config_block(oconfig_item_t *ci) { /* {{{ */
+  int status = 0;
 
   threshold_t th = {
       .warning_min = NAN,
@@ -737,17 +823,73 @@ static int ut_config(oconfig_item_t *ci) { /* {{{ */
       break;
   }
 
-  /* register callbacks if this is the first time we see a valid config */
-  if ((old_size == 0) && (c_avl_size(threshold_tree) > 0)) {
-    plugin_register_missing("threshold", ut_missing,
-                            /* user data = */ NULL);
-    plugin_register_write("threshold", ut_check_threshold,
-                          /* user data = */ NULL);
+  return status;
+} /* }}} int ut_config_block */
+
+static int ut_config(oconfig_item_t *ci) { /* {{{ */
+  if (threshold_tree == NULL) {
+    threshold_tree =
+        c_btree_create((int (*)(const void *, const void *))strcmp);
+    if (threshold_tree == NULL) {
+      ERROR("ut_config: c_btree_create failed.");
+      return -1;
+    }
   }
 
+  ut_tree = threshold_tree;
+  int status = ut_config_block(ci);
+
+  /* register callbacks if this is the first time we see a valid config */
+  ut_register_callbacks();
+
   return status;
-} /* }}} int um_config */
+} /* }}} int ut_config */
+
+/* Builds a new tree from the changed configuration and swaps it in, so that
+ * checks never see a partial configuration. */
+static int ut_reload(oconfig_item_t *ci) { /* {{{ */
+  /* Replaced trees, which are not freed: checks running while the tree is
+   * swapped may still use their thresholds. */
+  static c_btree_t **retired;
+  static size_t retired_num;
+
+  c_btree_t **tmp = realloc(retired, (retired_num + 1) * sizeof(*retired));
+  if (tmp == NULL) {
+    ERROR("ut_reload: realloc failed.");
+    return ENOMEM;
+  }
+  retired = tmp;
+
+  c_btree_t *tree = c_btree_create((int (*)(const void *, const void *))strcmp);
+  if (tree == NULL) {
+    ERROR("ut_reload: c_btree_create failed.");
+    return ENOMEM;
+  }
+
+  ut_tree = tree;
+  int status = ut_config_block(ci);
+  ut_tree = threshold_tree;
+  if (status != 0) {
+    ERROR("threshold values: Keeping the old thresholds.");
+    ut_tree_free(tree);
+    return status;
+  }
+
+  pthread_mutex_lock(&threshold_lock);
+  c_btree_t *old = threshold_tree;
+  threshold_tree = tree;
+  ut_tree = tree;
+  threshold_generation++;
+  pthread_mutex_unlock(&threshold_lock);
+
+  if (old != NULL)
+    retired[retired_num++] = old;
+
+  ut_register_callbacks();
+  return 0;
+} /* }}} int ut_reload */
 
 void module_register(void) {
   plugin_register_complex_config("threshold", ut_config);
+  plugin_register_reload("threshold", ut_reload);
 }
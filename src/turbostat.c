@@ -243,6 +243,43 @@ static struct topology {
 
 static cdtime_t time_even, time_odd, time_delta;
 
+/* MSR device of each present CPU, indexed by CPU id. Opened once by
+ * setup_all_buffers and kept open between reads. */
+static int *msr_fds;
+static unsigned int msr_fds_num;
+
+/* Position of a CPU's counters in the thread, core and package buffers. */
+typedef struct {
+  size_t thread_offset;
+  size_t core_offset;
+  size_t pkg_offset;
+} cpu_slot_t;
+
+/* Read workers read the counters of their CPUs in parallel. Each worker
+ * migrates itself to the CPU it reads, so that the MSRs are read locally. */
+typedef struct {
+  pthread_t thread;
+  cpu_set_t *affinity_set;
+  size_t affinity_setsize;
+  cpu_slot_t *slots;
+  size_t slots_num;
+} read_worker_t;
+
+static unsigned int config_read_threads;
+static read_worker_t *read_workers;
+static unsigned int read_workers_num;
+
+static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t read_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t read_done_cond = PTHREAD_COND_INITIALIZER;
+static bool read_shutdown;
+static uint64_t read_generation;
+static unsigned int read_pending;
+static int read_status;
+static struct thread_data *read_thread_base;
+static struct core_data *read_core_base;
+static struct pkg_data *read_pkg_base;
+
 static const char *config_keys[] = {
     "CoreCstates",
     "PackageCstates",
@@ -253,6 +290,7 @@ static const char *config_keys[] = {
     "RunningAveragePowerLimit",
     "LogicalCoreNames",
     "RestoreAffinityPolicy",
+    "ReadThreads",
 };
 static const int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
@@ -341,7 +379,8 @@ get_msr(unsigned int cpu, off_t offset, unsigned long long *msr) {
  * Package data is shared for all core in one package: extracted only for the
  * first thread of the first core
  *
- * Side effect: migrates to the targeted CPU
+ * Uses the MSR device opened by setup_all_buffers. The caller should run on
+ * the targeted CPU, otherwise every read interrupts that CPU.
  */
 static int __attribute__((warn_unused_result))
 get_counters(struct thread_data *t, struct core_data *c, struct pkg_data *p) {
@@ -350,9 +389,11 @@ get_counters(struct thread_data *t, struct core_data *c, struct pkg_data *p) {
   int msr_fd;
   int retval = 0;
 
-  msr_fd = open_msr(cpu, 1);
-  if (msr_fd < 0)
-    return msr_fd;
+  if ((cpu >= msr_fds_num) || (msr_fds[cpu] < 0)) {
+    ERROR("turbostat plugin: MSR device of CPU %u is not open", cpu);
+    return -1;
+  }
+  msr_fd = msr_fds[cpu];
 
 #define READ_MSR(msr, dst)                                                     \
   do {                                                                         \
@@ -448,10 +489,27 @@ get_counters(struct thread_data *t, struct core_data *c, struct pkg_data *p) {
   }
 
 out:
-  close(msr_fd);
   return retval;
 }
 
+/*
+ * Migrate to the targeted CPU and read its data
+ *
+ * Side effect: migrates to the targeted CPU
+ */
+static int __attribute__((warn_unused_result))
+get_counters_migrate(struct thread_data *t, struct core_data *c,
+                     struct pkg_data *p) {
+  CPU_ZERO_S(cpu_affinity_setsize, cpu_affinity_set);
+  CPU_SET_S(t->cpu_id, cpu_affinity_setsize, cpu_affinity_set);
+  if (sched_setaffinity(0, cpu_affinity_setsize, cpu_affinity_set) == -1) {
+    ERROR("turbostat plugin: Could not migrate to CPU %d", t->cpu_id);
+    return -1;
+  }
+
+  return get_counters(t, c, p);
+}
+
 /**********************************
  * Evaluating the changes (1 CPU) *
  **********************************/
@@ -818,6 +876,187 @@ for_all_cpus_delta(const struct thread_data *thread_new_base,
   return 0;
 }
 
+/*
+ * Read worker: waits for a new generation, reads the counters of its CPUs
+ * into the buffers set by for_all_cpus_get_counters and reports back.
+ */
+static void *read_worker_thread(void *arg) {
+  read_worker_t *w = arg;
+  uint64_t generation = 0;
+
+  pthread_mutex_lock(&read_lock);
+  while (true) {
+    while (!read_shutdown && (read_generation == generation))
+      pthread_cond_wait(&read_cond, &read_lock);
+    if (read_shutdown)
+      break;
+
+    generation = read_generation;
+    struct thread_data *thread_base = read_thread_base;
+    struct core_data *core_base = read_core_base;
+    struct pkg_data *pkg_base = read_pkg_base;
+    pthread_mutex_unlock(&read_lock);
+
+    int status = 0;
+    for (size_t i = 0; i < w->slots_num; i++) {
+      struct thread_data *t = thread_base + w->slots[i].thread_offset;
+
+      CPU_ZERO_S(w->affinity_setsize, w->affinity_set);
+      CPU_SET_S(t->cpu_id, w->affinity_setsize, w->affinity_set);
+      if (pthread_setaffinity_np(pthread_self(), w->affinity_setsize,
+                                 w->affinity_set) != 0) {
+        ERROR("turbostat plugin: Could not migrate to CPU %d", t->cpu_id);
+        status = -1;
+        break;
+      }
+
+      status = get_counters(t, core_base + w->slots[i].core_offset,
+                            pkg_base + w->slots[i].pkg_offset);
+      if (status != 0)
+        break;
+    }
+
+    pthread_mutex_lock(&read_lock);
+    if (status != 0)
+      read_status = status;
+    read_pending--;
+    if (read_pending == 0)
+      pthread_cond_signal(&read_done_cond);
+  }
+  pthread_mutex_unlock(&read_lock);
+
+  return NULL;
+}
+
+/*
+ * Read the counters of all CPUs, in parallel if read workers are running
+ *
+ * Return the error code of the first failing CPU or 0
+ */
+static int __attribute__((warn_unused_result))
+for_all_cpus_get_counters(struct thread_data *thread_base,
+                          struct core_data *core_base,
+                          struct pkg_data *pkg_base) {
+  if (read_workers_num == 0)
+    return for_all_cpus(get_counters_migrate, thread_base, core_base,
+                        pkg_base);
+
+  pthread_mutex_lock(&read_lock);
+  read_thread_base = thread_base;
+  read_core_base = core_base;
+  read_pkg_base = pkg_base;
+  read_status = 0;
+  read_pending = read_workers_num;
+  read_generation++;
+  pthread_cond_broadcast(&read_cond);
+
+  while (read_pending > 0)
+    pthread_cond_wait(&read_done_cond, &read_lock);
+  int status = read_status;
+  pthread_mutex_unlock(&read_lock);
+
+  return status;
+}
+
+static void stop_read_workers(void) {
+  pthread_mutex_lock(&read_lock);
+  read_shutdown = true;
+  pthread_cond_broadcast(&read_cond);
+  pthread_mutex_unlock(&read_lock);
+
+  for (unsigned int i = 0; i < read_workers_num; i++)
+    pthread_join(read_workers[i].thread, NULL);
+
+  for (unsigned int i = 0; i < read_workers_num; i++) {
+    CPU_FREE(read_workers[i].affinity_set);
+    free(read_workers[i].slots);
+  }
+  free(read_workers);
+  read_workers = NULL;
+  read_workers_num = 0;
+
+  pthread_mutex_lock(&read_lock);
+  read_shutdown = false;
+  pthread_mutex_unlock(&read_lock);
+}
+
+/*
+ * Distribute the present CPUs among "config_read_threads" workers and start
+ * them
+ */
+static int __attribute__((warn_unused_result)) start_read_workers(void) {
+  unsigned int cpus_num = 0;
+  for (unsigned int cpu_id = 0; cpu_id <= topology.max_cpu_id; ++cpu_id)
+    if (!cpu_is_not_present(cpu_id))
+      cpus_num++;
+
+  unsigned int workers_num = config_read_threads;
+  if (workers_num > cpus_num)
+    workers_num = cpus_num;
+  if (workers_num == 0)
+    return 0;
+
+  read_workers = calloc(workers_num, sizeof(*read_workers));
+  if (read_workers == NULL) {
+    ERROR("turbostat plugin: calloc failed");
+    return -1;
+  }
+
+  unsigned int n = 0;
+  for (unsigned int cpu_id = 0; cpu_id <= topology.max_cpu_id; ++cpu_id) {
+    if (cpu_is_not_present(cpu_id))
+      continue;
+
+    read_worker_t *w = read_workers + (n % workers_num);
+    n++;
+
+    cpu_slot_t *tmp = realloc(w->slots, (w->slots_num + 1) * sizeof(*tmp));
+    if (tmp == NULL) {
+      ERROR("turbostat plugin: realloc failed");
+      read_workers_num = workers_num;
+      stop_read_workers();
+      return -1;
+    }
+    w->slots = tmp;
+
+    struct cpu_topology *cpu = &topology.cpus[cpu_id];
+    w->slots[w->slots_num] = (cpu_slot_t){
+        .thread_offset = GET_THREAD((size_t)0, !(cpu->first_thread_in_core),
+                                    cpu->core_id, cpu->package_id),
+        .core_offset = GET_CORE((size_t)0, cpu->core_id, cpu->package_id),
+        .pkg_offset = GET_PKG((size_t)0, cpu->package_id),
+    };
+    w->slots_num++;
+  }
+
+  for (unsigned int i = 0; i < workers_num; i++) {
+    read_worker_t *w = read_workers + i;
+
+    w->affinity_set = CPU_ALLOC(topology.max_cpu_id + 1);
+    if (w->affinity_set == NULL) {
+      ERROR("turbostat plugin: Unable to allocate CPU state");
+      stop_read_workers();
+      return -1;
+    }
+    w->affinity_setsize = CPU_ALLOC_SIZE(topology.max_cpu_id + 1);
+
+    char name[16];
+    snprintf(name, sizeof(name), "turbostat#%hu", (unsigned short)i);
+    int status = plugin_thread_create(&w->thread, /* attr = */ NULL,
+                                      read_worker_thread, w, name);
+    if (status != 0) {
+      ERROR("turbostat plugin: Starting read thread failed: %s",
+            STRERROR(status));
+      CPU_FREE(w->affinity_set);
+      stop_read_workers();
+      return -1;
+    }
+    read_workers_num++;
+  }
+
+  return 0;
+}
+
 /***************
  * CPU Probing *
  ***************/
@@ -1397,6 +1636,15 @@ static void free_all_buffers(void) {
   allocated = false;
   initialized = false;
 
+  stop_read_workers();
+
+  for (unsigned int i = 0; i < msr_fds_num; i++)
+    if (msr_fds[i] >= 0)
+      close(msr_fds[i]);
+  free(msr_fds);
+  msr_fds = NULL;
+  msr_fds_num = 0;
+
   CPU_FREE(cpu_present_set);
   cpu_present_set = NULL;
   cpu_present_setsize = 0;
@@ -1445,6 +1693,28 @@ static void free_all_buffers(void) {
       goto err;                                                                \
   } while (0)
 
+static int __attribute__((warn_unused_result)) open_all_msr(void) {
+  msr_fds = calloc(topology.max_cpu_id + 1, sizeof(*msr_fds));
+  if (msr_fds == NULL) {
+    ERROR("turbostat plugin: calloc failed");
+    return -1;
+  }
+  msr_fds_num = topology.max_cpu_id + 1;
+
+  for (unsigned int cpu_id = 0; cpu_id < msr_fds_num; ++cpu_id)
+    msr_fds[cpu_id] = -1;
+
+  for (unsigned int cpu_id = 0; cpu_id < msr_fds_num; ++cpu_id) {
+    if (cpu_is_not_present(cpu_id))
+      continue;
+    msr_fds[cpu_id] = open_msr(cpu_id, false);
+    if (msr_fds[cpu_id] < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
 static int setup_all_buffers(void) {
   int ret;
 
@@ -1455,6 +1725,8 @@ static int setup_all_buffers(void) {
   initialize_counters();
   DO_OR_GOTO_ERR(for_all_cpus(set_temperature_target, EVEN_COUNTERS));
   DO_OR_GOTO_ERR(for_all_cpus(set_temperature_target, ODD_COUNTERS));
+  DO_OR_GOTO_ERR(open_all_msr());
+  DO_OR_GOTO_ERR(start_read_workers());
 
   allocated = true;
   return 0;
@@ -1513,7 +1785,7 @@ static int turbostat_read(void) {
   }
 
   if (!initialized) {
-    if ((ret = for_all_cpus(get_counters, EVEN_COUNTERS)) < 0)
+    if ((ret = for_all_cpus_get_counters(EVEN_COUNTERS)) < 0)
       goto out;
     time_even = cdtime();
     is_even = true;
@@ -1523,7 +1795,7 @@ static int turbostat_read(void) {
   }
 
   if (is_even) {
-    if ((ret = for_all_cpus(get_counters, ODD_COUNTERS)) < 0)
+    if ((ret = for_all_cpus_get_counters(ODD_COUNTERS)) < 0)
       goto out;
     time_odd = cdtime();
     is_even = false;
@@ -1533,7 +1805,7 @@ static int turbostat_read(void) {
     if ((ret = for_all_cpus(submit_counters, DELTA_COUNTERS)) < 0)
       goto out;
   } else {
-    if ((ret = for_all_cpus(get_counters, EVEN_COUNTERS)) < 0)
+    if ((ret = for_all_cpus_get_counters(EVEN_COUNTERS)) < 0)
       goto out;
     time_even = cdtime();
     is_even = true;
@@ -1663,6 +1935,13 @@ static int turbostat_config(const char *key, const char *value) {
       return -1;
     }
     tcc_activation_temp = (unsigned int)tmp_val;
+  } else if (strcasecmp("ReadThreads", key) == 0) {
+    tmp_val = strtoul(value, &end, 0);
+    if (*end != '\0' || tmp_val > UINT_MAX) {
+      ERROR("turbostat plugin: Invalid ReadThreads '%s'", value);
+      return -1;
+    }
+    config_read_threads = (unsigned int)tmp_val;
   } else if (strcasecmp("RestoreAffinityPolicy", key) == 0) {
     if (strcasecmp("Restore", value) == 0)
       affinity_policy = policy_restore_affinity;
@@ -1679,8 +1958,14 @@ static int turbostat_config(const char *key, const char *value) {
   return 0;
 }
 
+static int turbostat_shutdown(void) {
+  free_all_buffers();
+  return 0;
+}
+
 void module_register(void) {
   plugin_register_init(PLUGIN_NAME, turbostat_init);
+  plugin_register_shutdown(PLUGIN_NAME, turbostat_shutdown);
   plugin_register_config(PLUGIN_NAME, turbostat_config, config_keys,
                          config_keys_num);
 }
@@ -31,6 +31,7 @@
 
 #include "utils/cmds/flush.h"
 #include "utils/cmds/getthreshold.h"
+#include "utils/cmds/getrange.h"
 #include "utils/cmds/getval.h"
 #include "utils/cmds/listval.h"
 #include "utils/cmds/putnotif.h"
@@ -38,6 +39,9 @@
 
 #include <sys/stat.h>
 #include <sys/un.h>
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #include <grp.h>
 
@@ -46,13 +50,20 @@
 #endif
 
 #define US_DEFAULT_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-unixsock"
+/* Maximum length of a command line; long enough for a GETVAL command with
+ * many identifiers. */
+#define US_LINE_SIZE 65536
+#define US_DEFAULT_WORKER_THREADS 4
+#define US_CONNECTIONS_MAX 1024
+#define US_SPARE_CONNS_MAX 16
+#define US_EVENTS_MAX 64
 
 /*
  * Private variables
  */
 /* valid configuration file keys */
 static const char *config_keys[] = {"SocketFile", "SocketGroup", "SocketPerms",
-                                    "DeleteSocket"};
+                                    "DeleteSocket", "WorkerThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int loop;
@@ -63,9 +74,44 @@ static char *sock_file;
 static char *sock_group;
 static int sock_perms = S_IRWXU | S_IRWXG;
 static bool delete_socket;
+static int worker_threads_num = US_DEFAULT_WORKER_THREADS;
 
 static pthread_t listen_thread = (pthread_t)0;
 
+#if HAVE_SYS_EPOLL_H
+/* A client connection. Input is read into "buffer" and split into lines, so
+ * that several pipelined commands are handled per read; the command handlers
+ * write their responses to "fhout". */
+struct us_conn_s {
+  int fd;
+  FILE *fhout;
+  char *buffer;
+  size_t fill;
+  struct us_conn_s *prev;
+  struct us_conn_s *next;
+  struct us_conn_s *queue_next;
+};
+typedef struct us_conn_s us_conn_t;
+
+static int epoll_fd = -1;
+
+/* Open connections and closed ones kept for reuse. */
+static pthread_mutex_t conns_lock = PTHREAD_MUTEX_INITIALIZER;
+static us_conn_t *conns;
+static size_t conns_num;
+static us_conn_t *spare_conns;
+static size_t spare_conns_num;
+
+/* Readable connections waiting for a worker. */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static us_conn_t *queue_head;
+static us_conn_t *queue_tail;
+static bool workers_stop;
+static pthread_t *workers;
+static size_t workers_num;
+#endif /* HAVE_SYS_EPOLL_H */
+
 /*
  * Functions
  */
@@ -158,6 +204,373 @@ static int us_open_socket(void) {
   return 0;
 } /* int us_open_socket */
 
+/* Handles one command line. Returns non-zero if the connection has to be
+ * closed. */
+static int us_handle_line(FILE *fhout, char *buffer) {
+  char buffer_copy[US_LINE_SIZE];
+  char *fields[128];
+  int fields_num;
+
+  size_t len = strlen(buffer);
+  while ((len > 0) && ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
+    buffer[--len] = '\0';
+
+  if (len == 0)
+    return 0;
+
+  sstrncpy(buffer_copy, buffer, sizeof(buffer_copy));
+
+  fields_num =
+      strsplit(buffer_copy, fields, sizeof(fields) / sizeof(fields[0]));
+  if (fields_num < 1) {
+    fprintf(fhout, "-1 Internal error\n");
+    return -1;
+  }
+
+  if (strcasecmp(fields[0], "getval") == 0) {
+    cmd_handle_getval(fhout, buffer);
+  } else if (strcasecmp(fields[0], "getrange") == 0) {
+    cmd_handle_getrange(fhout, buffer);
+  } else if (strcasecmp(fields[0], "getthreshold") == 0) {
+    handle_getthreshold(fhout, buffer);
+  } else if (strcasecmp(fields[0], "putval") == 0) {
+    cmd_handle_putval(fhout, buffer);
+  } else if (strcasecmp(fields[0], "listval") == 0) {
+    cmd_handle_listval(fhout, buffer);
+  } else if (strcasecmp(fields[0], "putnotif") == 0) {
+    handle_putnotif(fhout, buffer);
+  } else if (strcasecmp(fields[0], "flush") == 0) {
+    cmd_handle_flush(fhout, buffer);
+  } else if (strcasecmp(fields[0], "reload") == 0) {
+    /* The main loop reloads the configuration, as upon SIGHUP. */
+    if (kill(getpid(), SIGHUP) != 0)
+      fprintf(fhout, "-1 Sending SIGHUP failed: %s\n", STRERRNO);
+    else
+      fprintf(fhout, "0 Reloading the configuration\n");
+  } else {
+    if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
+      WARNING("unixsock plugin: failed to write to socket #%i: %s",
+              fileno(fhout), STRERRNO);
+      return -1;
+    }
+  }
+
+  return 0;
+} /* int us_handle_line */
+
+#if HAVE_SYS_EPOLL_H
+/* Takes ownership of "fd": it is closed if the connection cannot be added.
+ * Must not hold conns_lock when calling. */
+static us_conn_t *us_conn_add(int fd) {
+  us_conn_t *c = NULL;
+
+  pthread_mutex_lock(&conns_lock);
+  if (conns_num >= US_CONNECTIONS_MAX) {
+    pthread_mutex_unlock(&conns_lock);
+    WARNING("unixsock plugin: Too many connections, closing a new one.");
+    close(fd);
+    return NULL;
+  }
+  if (spare_conns != NULL) {
+    c = spare_conns;
+    spare_conns = c->next;
+    spare_conns_num--;
+  }
+  pthread_mutex_unlock(&conns_lock);
+
+  if (c == NULL) {
+    c = calloc(1, sizeof(*c));
+    if (c != NULL)
+      c->buffer = malloc(US_LINE_SIZE);
+    if ((c == NULL) || (c->buffer == NULL)) {
+      ERROR("unixsock plugin: malloc failed.");
+      if (c != NULL)
+        sfree(c);
+      close(fd);
+      return NULL;
+    }
+  }
+  c->fd = fd;
+  c->fill = 0;
+  c->prev = NULL;
+  c->queue_next = NULL;
+
+  int fdout = dup(fd);
+  if (fdout < 0) {
+    ERROR("unixsock plugin: dup failed: %s", STRERRNO);
+    close(fd);
+    sfree(c->buffer);
+    sfree(c);
+    return NULL;
+  }
+  c->fhout = fdopen(fdout, "w");
+  if (c->fhout == NULL) {
+    ERROR("unixsock plugin: fdopen failed: %s", STRERRNO);
+    close(fdout);
+    close(fd);
+    sfree(c->buffer);
+    sfree(c);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&conns_lock);
+  c->next = conns;
+  if (conns != NULL)
+    conns->prev = c;
+  conns = c;
+  conns_num++;
+  pthread_mutex_unlock(&conns_lock);
+
+  return c;
+} /* us_conn_t *us_conn_add */
+
+/* Closes a connection and keeps it, including its read buffer, for reuse. */
+static void us_conn_close(us_conn_t *c) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, /* event = */ NULL);
+  fclose(c->fhout);
+  close(c->fd);
+  c->fhout = NULL;
+  c->fd = -1;
+
+  pthread_mutex_lock(&conns_lock);
+  if (c->prev != NULL)
+    c->prev->next = c->next;
+  else
+    conns = c->next;
+  if (c->next != NULL)
+    c->next->prev = c->prev;
+  conns_num--;
+
+  if (spare_conns_num < US_SPARE_CONNS_MAX) {
+    c->next = spare_conns;
+    spare_conns = c;
+    spare_conns_num++;
+    c = NULL;
+  }
+  pthread_mutex_unlock(&conns_lock);
+
+  if (c != NULL) {
+    sfree(c->buffer);
+    sfree(c);
+  }
+} /* void us_conn_close */
+
+/* Re-enables the events of a connection after a worker has handled it.
+ * EPOLLONESHOT makes sure that only one worker handles a connection at a
+ * time, so commands are answered in order. */
+static int us_conn_arm(us_conn_t *c, int op) {
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = c};
+  if (epoll_ctl(epoll_fd, op, c->fd, &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* int us_conn_arm */
+
+/* Reads from a connection and handles all complete lines, so that pipelined
+ * commands are answered with one write. Returns non-zero if the connection is
+ * to be closed. */
+static int us_conn_read(us_conn_t *c) {
+  /* Leave room for a terminating null byte. */
+  ssize_t len = recv(c->fd, c->buffer + c->fill, US_LINE_SIZE - 1 - c->fill,
+                     MSG_DONTWAIT);
+  if (len < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+      return 0;
+    WARNING("unixsock plugin: failed to read from socket #%i: %s", c->fd,
+            STRERRNO);
+    return -1;
+  } else if (len == 0) {
+    return -1;
+  }
+  c->fill += (size_t)len;
+
+  size_t offset = 0;
+  int status = 0;
+  while (status == 0) {
+    char *line = c->buffer + offset;
+    char *end = memchr(line, '\n', c->fill - offset);
+    if (end == NULL)
+      break;
+
+    *end = '\0';
+    offset = (size_t)(end - c->buffer) + 1;
+    status = us_handle_line(c->fhout, line);
+  }
+  fflush(c->fhout);
+  if (status != 0)
+    return status;
+
+  if (offset > 0) {
+    memmove(c->buffer, c->buffer + offset, c->fill - offset);
+    c->fill -= offset;
+  }
+
+  if (c->fill >= (US_LINE_SIZE - 1)) {
+    fprintf(c->fhout, "-1 Command too long\n");
+    fflush(c->fhout);
+    return -1;
+  }
+
+  return 0;
+} /* int us_conn_read */
+
+static void *us_worker_thread(void __attribute__((unused)) * arg) {
+  pthread_mutex_lock(&queue_lock);
+  while (!workers_stop) {
+    if (queue_head == NULL) {
+      pthread_cond_wait(&queue_cond, &queue_lock);
+      continue;
+    }
+
+    us_conn_t *c = queue_head;
+    queue_head = c->queue_next;
+    if (queue_head == NULL)
+      queue_tail = NULL;
+    c->queue_next = NULL;
+    pthread_mutex_unlock(&queue_lock);
+
+    if ((us_conn_read(c) != 0) || (us_conn_arm(c, EPOLL_CTL_MOD) != 0))
+      us_conn_close(c);
+
+    pthread_mutex_lock(&queue_lock);
+  }
+  pthread_mutex_unlock(&queue_lock);
+
+  return (void *)0;
+} /* void *us_worker_thread */
+
+static void us_enqueue(us_conn_t *c) {
+  pthread_mutex_lock(&queue_lock);
+  if (queue_tail == NULL)
+    queue_head = c;
+  else
+    queue_tail->queue_next = c;
+  queue_tail = c;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+} /* void us_enqueue */
+
+static int us_workers_start(void) {
+  workers = calloc((size_t)worker_threads_num, sizeof(*workers));
+  if (workers == NULL) {
+    ERROR("unixsock plugin: calloc failed.");
+    return -1;
+  }
+
+  workers_stop = false;
+  for (int i = 0; i < worker_threads_num; i++) {
+    int status = plugin_thread_create(&workers[workers_num], /* attr = */ NULL,
+                                      us_worker_thread, /* arg = */ NULL,
+                                      "unixsock conn");
+    if (status != 0) {
+      ERROR("unixsock plugin: pthread_create failed: %s", STRERRNO);
+      continue;
+    }
+    workers_num++;
+  }
+
+  return (workers_num > 0) ? 0 : -1;
+} /* int us_workers_start */
+
+static void us_workers_stop(void) {
+  pthread_mutex_lock(&queue_lock);
+  workers_stop = true;
+  pthread_cond_broadcast(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+
+  for (size_t i = 0; i < workers_num; i++)
+    pthread_join(workers[i], /* retval = */ NULL);
+  sfree(workers);
+  workers_num = 0;
+
+  /* Connections still waiting for a worker are closed below. */
+  queue_head = queue_tail = NULL;
+} /* void us_workers_stop */
+
+static void us_accept(void) {
+  int fd = accept(sock_fd, NULL, NULL);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      ERROR("unixsock plugin: accept failed: %s", STRERRNO);
+    return;
+  }
+
+  DEBUG("unixsock plugin: Accepted connection on fd #%i", fd);
+
+  us_conn_t *c = us_conn_add(fd);
+  if ((c != NULL) && (us_conn_arm(c, EPOLL_CTL_ADD) != 0))
+    us_conn_close(c);
+} /* void us_accept */
+
+/* The server thread accepts connections and waits for them to become
+ * readable; the commands are handled by a fixed pool of worker threads. */
+static void *us_server_thread(void __attribute__((unused)) * arg) {
+  struct epoll_event events[US_EVENTS_MAX];
+  int status;
+
+  if (us_open_socket() != 0)
+    pthread_exit((void *)1);
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    ERROR("unixsock plugin: epoll_create1 failed: %s", STRERRNO);
+    close(sock_fd);
+    sock_fd = -1;
+    pthread_exit((void *)1);
+  }
+
+  /* The listening socket is the event without a connection. */
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if ((epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock_fd, &ev) != 0) ||
+      (us_workers_start() != 0)) {
+    ERROR("unixsock plugin: Starting the server failed.");
+    loop = 0;
+  }
+
+  while (loop != 0) {
+    int num = epoll_wait(epoll_fd, events, US_EVENTS_MAX, -1);
+    if (num < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("unixsock plugin: epoll_wait failed: %s", STRERRNO);
+      break;
+    }
+
+    for (int i = 0; i < num; i++) {
+      if (events[i].data.ptr == NULL)
+        us_accept();
+      else
+        us_enqueue(events[i].data.ptr);
+    }
+  } /* while (loop) */
+
+  us_workers_stop();
+  while (conns != NULL)
+    us_conn_close(conns);
+  while (spare_conns != NULL) {
+    us_conn_t *c = spare_conns;
+    spare_conns = c->next;
+    sfree(c->buffer);
+    sfree(c);
+  }
+  spare_conns_num = 0;
+
+  close(epoll_fd);
+  epoll_fd = -1;
+  close(sock_fd);
+  sock_fd = -1;
+
+  status = unlink((sock_file != NULL) ? sock_file : US_DEFAULT_PATH);
+  if (status != 0) {
+    NOTICE("unixsock plugin: unlink (%s) failed: %s",
+           (sock_file != NULL) ? sock_file : US_DEFAULT_PATH, STRERRNO);
+  }
+
+  return (void *)0;
+} /* void *us_server_thread */
+#else  /* !HAVE_SYS_EPOLL_H */
+
 static void *us_handle_client(void *arg) {
   int fdin;
   int fdout;
@@ -204,10 +617,7 @@ static void *us_handle_client(void *arg) {
   }
 
   while (42) {
-    char buffer[1024];
-    char buffer_copy[1024];
-    char *fields[128];
-    int fields_num;
+    char buffer[US_LINE_SIZE];
 
     errno = 0;
     if (fgets(buffer, sizeof(buffer), fhin) == NULL) {
@@ -221,45 +631,8 @@ static void *us_handle_client(void *arg) {
       break;
     }
 
-    size_t len = strlen(buffer);
-    while ((len > 0) &&
-           ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
-      buffer[--len] = '\0';
-
-    if (len == 0)
-      continue;
-
-    sstrncpy(buffer_copy, buffer, sizeof(buffer_copy));
-
-    fields_num =
-        strsplit(buffer_copy, fields, sizeof(fields) / sizeof(fields[0]));
-    if (fields_num < 1) {
-      fprintf(fhout, "-1 Internal error\n");
-      fclose(fhin);
-      fclose(fhout);
-      pthread_exit((void *)1);
-      return (void *)1;
-    }
-
-    if (strcasecmp(fields[0], "getval") == 0) {
-      cmd_handle_getval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "getthreshold") == 0) {
-      handle_getthreshold(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putval") == 0) {
-      cmd_handle_putval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "listval") == 0) {
-      cmd_handle_listval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putnotif") == 0) {
-      handle_putnotif(fhout, buffer);
-    } else if (strcasecmp(fields[0], "flush") == 0) {
-      cmd_handle_flush(fhout, buffer);
-    } else {
-      if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
-        WARNING("unixsock plugin: failed to write to socket #%i: %s",
-                fileno(fhout), STRERRNO);
-        break;
-      }
-    }
+    if (us_handle_line(fhout, buffer) != 0)
+      break;
   } /* while (fgets) */
 
   DEBUG("unixsock plugin: us_handle_client: Exiting..");
@@ -329,6 +702,7 @@ static void *us_server_thread(void __attribute__((unused)) * arg) {
 
   return (void *)0;
 } /* void *us_server_thread */
+#endif /* HAVE_SYS_EPOLL_H */
 
 static int us_config(const char *key, const char *val) {
   if (strcasecmp(key, "SocketFile") == 0) {
@@ -352,6 +726,13 @@ static int us_config(const char *key, const char *val) {
       delete_socket = true;
     else
       delete_socket = false;
+  } else if (strcasecmp(key, "WorkerThreads") == 0) {
+    int tmp = atoi(val);
+    if (tmp < 1) {
+      WARNING("unixsock plugin: WorkerThreads must be at least 1.");
+      return 1;
+    }
+    worker_threads_num = tmp;
   } else {
     return -1;
   }
@@ -0,0 +1,179 @@
+/**
+ * collectd - src/utils/avltree/avltree_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the AVL tree. Build with "make bench_avltree"; the
+ * optional argument is the number of keys, 1000000 by default. */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils/avltree/avltree.h"
+
+static char **keys;
+static size_t keys_num;
+
+static int compare_keys(void const *a, void const *b) { return strcmp(a, b); }
+
+/* The keys are inserted in random order, as the identifiers inserted into
+ * the value cache are. */
+static int create_keys(size_t num) {
+  keys = calloc(num, sizeof(*keys));
+  if (keys == NULL)
+    return -1;
+
+  for (size_t i = 0; i < num; i++) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "host%04zu/plugin-%zu/type-%zu", i % 1000,
+             i / 1000, i);
+    if ((keys[i] = strdup(buffer)) == NULL)
+      return -1;
+    keys_num++;
+  }
+
+  srand(42);
+  for (size_t i = num - 1; i > 0; i--) {
+    size_t j = (size_t)rand() % (i + 1);
+    char *tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+  return 0;
+}
+
+static c_avl_tree_t *create_tree(size_t num) {
+  c_avl_tree_t *t = c_avl_create(compare_keys);
+  if (t == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < num; i++) {
+    if (c_avl_insert(t, keys[i], keys[i]) != 0) {
+      c_avl_destroy(t);
+      return NULL;
+    }
+  }
+  return t;
+}
+
+DEF_BENCH(c_avl_insert) {
+  c_avl_tree_t *t = c_avl_create(compare_keys);
+  if (t == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (c_avl_insert(t, keys[i], keys[i]) != 0)
+      return -1;
+  BENCH_STOP;
+
+  c_avl_destroy(t);
+  return 0;
+}
+
+DEF_BENCH(c_avl_get) {
+  c_avl_tree_t *t = create_tree(ops);
+  if (t == NULL)
+    return -1;
+
+  /* Look the keys up in a different order than they were inserted in. */
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    void *value = NULL;
+    if (c_avl_get(t, keys[ops - 1 - i], &value) != 0)
+      return -1;
+  }
+  BENCH_STOP;
+
+  c_avl_destroy(t);
+  return 0;
+}
+
+DEF_BENCH(c_avl_get_missing) {
+  c_avl_tree_t *t = create_tree(ops / 2);
+  if (t == NULL)
+    return -1;
+
+  /* Only the first half of the keys has been inserted. */
+  size_t missing = ops - ops / 2;
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (c_avl_get(t, keys[ops / 2 + i % missing], NULL) == 0)
+      return -1;
+  BENCH_STOP;
+
+  c_avl_destroy(t);
+  return 0;
+}
+
+DEF_BENCH(c_avl_iterator) {
+  c_avl_tree_t *t = create_tree(ops);
+  if (t == NULL)
+    return -1;
+
+  BENCH_START;
+  c_avl_iterator_t *iter = c_avl_get_iterator(t);
+  void *key;
+  void *value;
+  while (c_avl_iterator_next(iter, &key, &value) == 0)
+    /* do nothing */;
+  c_avl_iterator_destroy(iter);
+  BENCH_STOP;
+
+  c_avl_destroy(t);
+  return 0;
+}
+
+DEF_BENCH(c_avl_remove) {
+  c_avl_tree_t *t = create_tree(ops);
+  if (t == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (c_avl_remove(t, keys[i], NULL, NULL) != 0)
+      return -1;
+  BENCH_STOP;
+
+  c_avl_destroy(t);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t num = BENCH_OPS(argc, argv, 1000000);
+
+  if ((num == 0) || (create_keys(num) != 0)) {
+    fprintf(stderr, "Creating the keys failed.\n");
+    return 1;
+  }
+
+  RUN_BENCH(c_avl_insert, num);
+  RUN_BENCH(c_avl_get, num);
+  RUN_BENCH(c_avl_get_missing, num);
+  RUN_BENCH(c_avl_iterator, num);
+  RUN_BENCH(c_avl_remove, num);
+
+  for (size_t i = 0; i < keys_num; i++)
+    free(keys[i]);
+  free(keys);
+
+  END_BENCH;
+}
@@ -0,0 +1,688 @@
+/**
+ * collectd - src/utils/btree/btree.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/btree/btree.h"
+
+/* Maximum number of keys per node. All nodes but the root hold at least
+ * BTREE_MIN keys. */
+#define BTREE_MAX 32
+#define BTREE_MIN (BTREE_MAX / 2)
+
+/*
+ * private data types
+ */
+/* Common part of leaves and inner nodes; the first member of both. */
+struct c_btree_node_s {
+  bool leaf;
+  int num;
+  void *keys[BTREE_MAX];
+};
+typedef struct c_btree_node_s c_btree_node_t;
+
+struct c_btree_leaf_s {
+  c_btree_node_t node;
+  void *values[BTREE_MAX];
+  struct c_btree_leaf_s *prev;
+  struct c_btree_leaf_s *next;
+};
+typedef struct c_btree_leaf_s c_btree_leaf_t;
+
+/* children[i] holds the keys less than keys[i], children[i + 1] the keys
+ * greater than or equal to it. keys[i] is always the smallest key in
+ * children[i + 1], so it points to a key stored in a leaf and is updated
+ * whenever that key is removed. */
+struct c_btree_inner_s {
+  c_btree_node_t node;
+  c_btree_node_t *children[BTREE_MAX + 1];
+};
+typedef struct c_btree_inner_s c_btree_inner_t;
+
+#define LEAF(n) ((c_btree_leaf_t *)(n))
+#define INNER(n) ((c_btree_inner_t *)(n))
+
+struct c_btree_s {
+  c_btree_node_t *root;
+  int (*compare)(const void *, const void *);
+  int size;
+};
+
+struct c_btree_iterator_s {
+  c_btree_t *tree;
+  /* Position of the element returned last; `leaf' is NULL before the first
+   * element has been returned. */
+  c_btree_leaf_t *leaf;
+  int index;
+};
+
+/*
+ * private functions
+ */
+static c_btree_leaf_t *leaf_create(void) /* {{{ */
+{
+  c_btree_leaf_t *l = calloc(1, sizeof(*l));
+  if (l != NULL)
+    l->node.leaf = true;
+  return l;
+} /* }}} c_btree_leaf_t *leaf_create */
+
+static c_btree_inner_t *inner_create(void) /* {{{ */
+{
+  return calloc(1, sizeof(c_btree_inner_t));
+} /* }}} c_btree_inner_t *inner_create */
+
+static void node_free(c_btree_node_t *n) /* {{{ */
+{
+  if (n == NULL)
+    return;
+
+  if (!n->leaf)
+    for (int i = 0; i <= n->num; i++)
+      node_free(INNER(n)->children[i]);
+
+  free(n);
+} /* }}} void node_free */
+
+/* Returns the index of the first key in `n' that is not less than `key' and
+ * sets `*found' if it is equal. */
+static int node_search(c_btree_t const *t, c_btree_node_t const *n, /* {{{ */
+                       const void *key, bool *found) {
+  int lo = 0;
+  int hi = n->num;
+
+  *found = false;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    int cmp = t->compare(key, n->keys[mid]);
+    if (cmp == 0) {
+      *found = true;
+      return mid;
+    } else if (cmp > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+} /* }}} int node_search */
+
+/* Returns the index of the child of the inner node `n' that `key' belongs
+ * to. */
+static int inner_child(c_btree_t const *t, c_btree_node_t const *n, /* {{{ */
+                       const void *key, bool *found) {
+  int index = node_search(t, n, key, found);
+  return *found ? index + 1 : index;
+} /* }}} int inner_child */
+
+static c_btree_leaf_t *leftmost_leaf(c_btree_t const *t) /* {{{ */
+{
+  c_btree_node_t *n = t->root;
+  if (n == NULL)
+    return NULL;
+
+  while (!n->leaf)
+    n = INNER(n)->children[0];
+  return LEAF(n);
+} /* }}} c_btree_leaf_t *leftmost_leaf */
+
+static c_btree_leaf_t *rightmost_leaf(c_btree_t const *t) /* {{{ */
+{
+  c_btree_node_t *n = t->root;
+  if (n == NULL)
+    return NULL;
+
+  while (!n->leaf)
+    n = INNER(n)->children[n->num];
+  return LEAF(n);
+} /* }}} c_btree_leaf_t *rightmost_leaf */
+
+static void *node_min_key(c_btree_node_t const *n) /* {{{ */
+{
+  while (!n->leaf)
+    n = INNER(n)->children[0];
+  assert(n->num > 0);
+  return n->keys[0];
+} /* }}} void *node_min_key */
+
+static void leaf_insert_at(c_btree_leaf_t *l, int index, /* {{{ */
+                           void *key, void *value) {
+  c_btree_node_t *n = &l->node;
+
+  assert(n->num < BTREE_MAX);
+  memmove(n->keys + index + 1, n->keys + index,
+          (size_t)(n->num - index) * sizeof(*n->keys));
+  memmove(l->values + index + 1, l->values + index,
+          (size_t)(n->num - index) * sizeof(*l->values));
+  n->keys[index] = key;
+  l->values[index] = value;
+  n->num++;
+} /* }}} void leaf_insert_at */
+
+/* Inserts the separator `key' at `index' and `child' to its right. */
+static void inner_insert_at(c_btree_inner_t *in, int index, /* {{{ */
+                            void *key, c_btree_node_t *child) {
+  c_btree_node_t *n = &in->node;
+
+  assert(n->num < BTREE_MAX);
+  memmove(n->keys + index + 1, n->keys + index,
+          (size_t)(n->num - index) * sizeof(*n->keys));
+  memmove(in->children + index + 2, in->children + index + 1,
+          (size_t)(n->num - index) * sizeof(*in->children));
+  n->keys[index] = key;
+  in->children[index + 1] = child;
+  n->num++;
+} /* }}} void inner_insert_at */
+
+static int leaf_insert(c_btree_t *t, c_btree_leaf_t *l, /* {{{ */
+                       void *key, void *value, void **ret_sep,
+                       c_btree_node_t **ret_right) {
+  c_btree_node_t *n = &l->node;
+  bool found;
+  int index = node_search(t, n, key, &found);
+  if (found)
+    return 1;
+
+  if (n->num < BTREE_MAX) {
+    leaf_insert_at(l, index, key, value);
+    return 0;
+  }
+
+  /* Move the upper half of the keys to a new leaf. */
+  c_btree_leaf_t *r = leaf_create();
+  if (r == NULL)
+    return -1;
+
+  int half = BTREE_MAX / 2;
+  r->node.num = BTREE_MAX - half;
+  memcpy(r->node.keys, n->keys + half, (size_t)r->node.num * sizeof(*n->keys));
+  memcpy(r->values, l->values + half,
+         (size_t)r->node.num * sizeof(*l->values));
+  n->num = half;
+
+  r->prev = l;
+  r->next = l->next;
+  if (l->next != NULL)
+    l->next->prev = r;
+  l->next = r;
+
+  if (index <= half)
+    leaf_insert_at(l, index, key, value);
+  else
+    leaf_insert_at(r, index - half, key, value);
+
+  *ret_sep = r->node.keys[0];
+  *ret_right = &r->node;
+  return 0;
+} /* }}} int leaf_insert */
+
+/* Inserts into the subtree `n'. If `n' is split, the new right half is
+ * returned in `*ret_right' and its smallest key in `*ret_sep'. */
+static int node_insert(c_btree_t *t, c_btree_node_t *n, /* {{{ */
+                       void *key, void *value, void **ret_sep,
+                       c_btree_node_t **ret_right) {
+  if (n->leaf)
+    return leaf_insert(t, LEAF(n), key, value, ret_sep, ret_right);
+
+  c_btree_inner_t *in = INNER(n);
+  bool found;
+  int child = inner_child(t, n, key, &found);
+
+  /* Allocate the new node before anything is modified: once the child has
+   * been split, the split can not be undone. */
+  c_btree_inner_t *r = NULL;
+  if (n->num == BTREE_MAX) {
+    r = inner_create();
+    if (r == NULL)
+      return -1;
+  }
+
+  void *sep = NULL;
+  c_btree_node_t *right = NULL;
+  int status = node_insert(t, in->children[child], key, value, &sep, &right);
+  if ((status != 0) || (right == NULL)) {
+    free(r);
+    return status;
+  }
+
+  if (r == NULL) {
+    inner_insert_at(in, child, sep, right);
+    return 0;
+  }
+
+  /* Split this node: collect all BTREE_MAX + 1 keys ... */
+  void *keys[BTREE_MAX + 1];
+  c_btree_node_t *children[BTREE_MAX + 2];
+
+  memcpy(keys, n->keys, (size_t)child * sizeof(*keys));
+  keys[child] = sep;
+  memcpy(keys + child + 1, n->keys + child,
+         (size_t)(BTREE_MAX - child) * sizeof(*keys));
+
+  memcpy(children, in->children, (size_t)(child + 1) * sizeof(*children));
+  children[child + 1] = right;
+  memcpy(children + child + 2, in->children + child + 1,
+         (size_t)(BTREE_MAX - child) * sizeof(*children));
+
+  /* ... and move the middle one up. */
+  int mid = (BTREE_MAX + 1) / 2;
+  n->num = mid;
+  memcpy(n->keys, keys, (size_t)mid * sizeof(*keys));
+  memcpy(in->children, children, (size_t)(mid + 1) * sizeof(*children));
+
+  r->node.num = BTREE_MAX - mid;
+  memcpy(r->node.keys, keys + mid + 1, (size_t)r->node.num * sizeof(*keys));
+  memcpy(r->children, children + mid + 1,
+         (size_t)(r->node.num + 1) * sizeof(*children));
+
+  *ret_sep = keys[mid];
+  *ret_right = &r->node;
+  return 0;
+} /* }}} int node_insert */
+
+static void borrow_from_left(c_btree_inner_t *parent, int index) /* {{{ */
+{
+  c_btree_node_t *l = parent->children[index - 1];
+  c_btree_node_t *c = parent->children[index];
+
+  memmove(c->keys + 1, c->keys, (size_t)c->num * sizeof(*c->keys));
+
+  if (c->leaf) {
+    memmove(LEAF(c)->values + 1, LEAF(c)->values,
+            (size_t)c->num * sizeof(*LEAF(c)->values));
+    c->keys[0] = l->keys[l->num - 1];
+    LEAF(c)->values[0] = LEAF(l)->values[l->num - 1];
+    parent->node.keys[index - 1] = c->keys[0];
+  } else {
+    memmove(INNER(c)->children + 1, INNER(c)->children,
+            (size_t)(c->num + 1) * sizeof(*INNER(c)->children));
+    c->keys[0] = parent->node.keys[index - 1];
+    INNER(c)->children[0] = INNER(l)->children[l->num];
+    parent->node.keys[index - 1] = l->keys[l->num - 1];
+  }
+
+  l->num--;
+  c->num++;
+} /* }}} void borrow_from_left */
+
+static void borrow_from_right(c_btree_inner_t *parent, int index) /* {{{ */
+{
+  c_btree_node_t *c = parent->children[index];
+  c_btree_node_t *r = parent->children[index + 1];
+
+  if (c->leaf) {
+    c->keys[c->num] = r->keys[0];
+    LEAF(c)->values[c->num] = LEAF(r)->values[0];
+    memmove(LEAF(r)->values, LEAF(r)->values + 1,
+            (size_t)(r->num - 1) * sizeof(*LEAF(r)->values));
+    memmove(r->keys, r->keys + 1, (size_t)(r->num - 1) * sizeof(*r->keys));
+    parent->node.keys[index] = r->keys[0];
+  } else {
+    c->keys[c->num] = parent->node.keys[index];
+    INNER(c)->children[c->num + 1] = INNER(r)->children[0];
+    parent->node.keys[index] = r->keys[0];
+    memmove(r->keys, r->keys + 1, (size_t)(r->num - 1) * sizeof(*r->keys));
+    memmove(INNER(r)->children, INNER(r)->children + 1,
+            (size_t)r->num * sizeof(*INNER(r)->children));
+  }
+
+  c->num++;
+  r->num--;
+} /* }}} void borrow_from_right */
+
+/* Merges the children `index' and `index + 1' of `parent'. */
+static void merge_children(c_btree_inner_t *parent, int index) /* {{{ */
+{
+  c_btree_node_t *l = parent->children[index];
+  c_btree_node_t *r = parent->children[index + 1];
+
+  if (l->leaf) {
+    memcpy(l->keys + l->num, r->keys, (size_t)r->num * sizeof(*r->keys));
+    memcpy(LEAF(l)->values + l->num, LEAF(r)->values,
+           (size_t)r->num * sizeof(*LEAF(r)->values));
+    l->num += r->num;
+
+    LEAF(l)->next = LEAF(r)->next;
+    if (LEAF(r)->next != NULL)
+      LEAF(r)->next->prev = LEAF(l);
+  } else {
+    l->keys[l->num] = parent->node.keys[index];
+    memcpy(l->keys + l->num + 1, r->keys, (size_t)r->num * sizeof(*r->keys));
+    memcpy(INNER(l)->children + l->num + 1, INNER(r)->children,
+           (size_t)(r->num + 1) * sizeof(*INNER(r)->children));
+    l->num += r->num + 1;
+  }
+  assert(l->num <= BTREE_MAX);
+  free(r);
+
+  c_btree_node_t *p = &parent->node;
+  memmove(p->keys + index, p->keys + index + 1,
+          (size_t)(p->num - index - 1) * sizeof(*p->keys));
+  memmove(parent->children + index + 1, parent->children + index + 2,
+          (size_t)(p->num - index - 1) * sizeof(*parent->children));
+  p->num--;
+} /* }}} void merge_children */
+
+/* Refills the child `index' of `parent', which has less than BTREE_MIN keys,
+ * from one of its siblings. */
+static void rebalance_child(c_btree_inner_t *parent, int index) /* {{{ */
+{
+  c_btree_node_t *p = &parent->node;
+
+  if ((index > 0) && (parent->children[index - 1]->num > BTREE_MIN))
+    borrow_from_left(parent, index);
+  else if ((index < p->num) && (parent->children[index + 1]->num > BTREE_MIN))
+    borrow_from_right(parent, index);
+  else if (index > 0)
+    merge_children(parent, index - 1);
+  else
+    merge_children(parent, index);
+} /* }}} void rebalance_child */
+
+static int node_remove(c_btree_t *t, c_btree_node_t *n, /* {{{ */
+                       const void *key, void **rkey, void **rvalue) {
+  bool found;
+
+  if (n->leaf) {
+    c_btree_leaf_t *l = LEAF(n);
+    int index = node_search(t, n, key, &found);
+    if (!found)
+      return -1;
+
+    if (rkey != NULL)
+      *rkey = n->keys[index];
+    if (rvalue != NULL)
+      *rvalue = l->values[index];
+
+    memmove(n->keys + index, n->keys + index + 1,
+            (size_t)(n->num - index - 1) * sizeof(*n->keys));
+    memmove(l->values + index, l->values + index + 1,
+            (size_t)(n->num - index - 1) * sizeof(*l->values));
+    n->num--;
+    return 0;
+  }
+
+  c_btree_inner_t *in = INNER(n);
+  int child = inner_child(t, n, key, &found);
+
+  int status = node_remove(t, in->children[child], key, rkey, rvalue);
+  if (status != 0)
+    return status;
+
+  /* The separator pointed to the removed key. */
+  if (found)
+    n->keys[child - 1] = node_min_key(in->children[child]);
+
+  if (in->children[child]->num < BTREE_MIN)
+    rebalance_child(in, child);
+
+  return 0;
+} /* }}} int node_remove */
+
+/*
+ * public functions
+ */
+c_btree_t *c_btree_create(int (*compare)(const void *, const void *)) /* {{{ */
+{
+  c_btree_t *t;
+
+  if (compare == NULL)
+    return NULL;
+
+  if ((t = calloc(1, sizeof(*t))) == NULL)
+    return NULL;
+
+  t->compare = compare;
+  return t;
+} /* }}} c_btree_t *c_btree_create */
+
+void c_btree_destroy(c_btree_t *t) /* {{{ */
+{
+  if (t == NULL)
+    return;
+
+  node_free(t->root);
+  free(t);
+} /* }}} void c_btree_destroy */
+
+int c_btree_insert(c_btree_t *t, void *key, void *value) /* {{{ */
+{
+  assert(t != NULL);
+
+  if (t->root == NULL) {
+    c_btree_leaf_t *l = leaf_create();
+    if (l == NULL)
+      return -1;
+    t->root = &l->node;
+  }
+
+  /* If the root is full, it may be split; allocate its successor first. */
+  c_btree_inner_t *root = NULL;
+  if (t->root->num == BTREE_MAX) {
+    root = inner_create();
+    if (root == NULL)
+      return -1;
+  }
+
+  void *sep = NULL;
+  c_btree_node_t *right = NULL;
+  int status = node_insert(t, t->root, key, value, &sep, &right);
+  if (status != 0) {
+    free(root);
+    return status;
+  }
+
+  if (right != NULL) {
+    assert(root != NULL);
+    root->node.num = 1;
+    root->node.keys[0] = sep;
+    root->children[0] = t->root;
+    root->children[1] = right;
+    t->root = &root->node;
+  } else {
+    free(root);
+  }
+
+  t->size++;
+  return 0;
+} /* }}} int c_btree_insert */
+
+int c_btree_remove(c_btree_t *t, const void *key, /* {{{ */
+                   void **rkey, void **rvalue) {
+  assert(t != NULL);
+
+  if (t->root == NULL)
+    return -1;
+
+  int status = node_remove(t, t->root, key, rkey, rvalue);
+  if (status != 0)
+    return status;
+  t->size--;
+
+  c_btree_node_t *root = t->root;
+  if (root->leaf && (root->num == 0)) {
+    free(root);
+    t->root = NULL;
+  } else if (!root->leaf && (root->num == 0)) {
+    t->root = INNER(root)->children[0];
+    free(root);
+  }
+
+  return 0;
+} /* }}} int c_btree_remove */
+
+int c_btree_get(c_btree_t *t, const void *key, void **value) /* {{{ */
+{
+  bool found;
+
+  assert(t != NULL);
+
+  c_btree_node_t *n = t->root;
+  if (n == NULL)
+    return -1;
+
+  while (!n->leaf)
+    n = INNER(n)->children[inner_child(t, n, key, &found)];
+
+  int index = node_search(t, n, key, &found);
+  if (!found)
+    return -1;
+
+  if (value != NULL)
+    *value = LEAF(n)->values[index];
+  return 0;
+} /* }}} int c_btree_get */
+
+int c_btree_pick(c_btree_t *t, void **key, void **value) /* {{{ */
+{
+  assert(t != NULL);
+
+  if ((key == NULL) || (value == NULL))
+    return -1;
+
+  /* Removing the largest key never needs to update a separator. */
+  c_btree_leaf_t *l = rightmost_leaf(t);
+  if ((l == NULL) || (l->node.num == 0))
+    return -1;
+
+  return c_btree_remove(t, l->node.keys[l->node.num - 1], key, value);
+} /* }}} int c_btree_pick */
+
+c_btree_iterator_t *c_btree_get_iterator(c_btree_t *t) /* {{{ */
+{
+  c_btree_iterator_t *iter;
+
+  if (t == NULL)
+    return NULL;
+
+  iter = calloc(1, sizeof(*iter));
+  if (iter == NULL)
+    return NULL;
+  iter->tree = t;
+
+  return iter;
+} /* }}} c_btree_iterator_t *c_btree_get_iterator */
+
+int c_btree_iterator_next(c_btree_iterator_t *iter, /* {{{ */
+                          void **key, void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  return (c_btree_iterator_next_batch(iter, key, value, 1) == 1) ? 0 : -1;
+} /* }}} int c_btree_iterator_next */
+
+int c_btree_iterator_prev(c_btree_iterator_t *iter, /* {{{ */
+                          void **key, void **value) {
+  c_btree_leaf_t *l;
+  int index;
+
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  if (iter->leaf == NULL) {
+    l = rightmost_leaf(iter->tree);
+    if (l == NULL)
+      return -1;
+    index = l->node.num - 1;
+  } else {
+    l = iter->leaf;
+    index = iter->index - 1;
+    if (index < 0) {
+      if (l->prev == NULL)
+        return -1;
+      l = l->prev;
+      index = l->node.num - 1;
+    }
+  }
+
+  if (index < 0)
+    return -1;
+
+  iter->leaf = l;
+  iter->index = index;
+  *key = l->node.keys[index];
+  *value = l->values[index];
+
+  return 0;
+} /* }}} int c_btree_iterator_prev */
+
+int c_btree_iterator_next_batch(c_btree_iterator_t *iter, /* {{{ */
+                                void **keys, void **values, int num) {
+  int ret = 0;
+
+  if (iter == NULL)
+    return 0;
+
+  while (ret < num) {
+    c_btree_leaf_t *l;
+    int start;
+
+    if (iter->leaf == NULL) {
+      l = leftmost_leaf(iter->tree);
+      if (l == NULL)
+        break;
+      start = 0;
+    } else {
+      l = iter->leaf;
+      start = iter->index + 1;
+      if (start >= l->node.num) {
+        if (l->next == NULL)
+          break;
+        l = l->next;
+        start = 0;
+      }
+    }
+
+    int n = l->node.num - start;
+    if (n > num - ret)
+      n = num - ret;
+    if (n <= 0)
+      break;
+
+    if (keys != NULL)
+      memcpy(keys + ret, l->node.keys + start, (size_t)n * sizeof(*keys));
+    if (values != NULL)
+      memcpy(values + ret, l->values + start, (size_t)n * sizeof(*values));
+
+    iter->leaf = l;
+    iter->index = start + n - 1;
+    ret += n;
+  }
+
+  return ret;
+} /* }}} int c_btree_iterator_next_batch */
+
+void c_btree_iterator_destroy(c_btree_iterator_t *iter) /* {{{ */
+{
+  free(iter);
+} /* }}} void c_btree_iterator_destroy */
+
+int c_btree_size(c_btree_t *t) /* {{{ */
+{
+  if (t == NULL)
+    return 0;
+  return t->size;
+} /* }}} int c_btree_size */
@@ -0,0 +1,160 @@
+/**
+ * collectd - src/utils/btree/btree.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_BTREE_H
+#define UTILS_BTREE_H 1
+
+/* An ordered map with the same interface as the AVL tree in
+ * "utils/avltree/avltree.h". It is a B+tree: every node holds dozens of keys
+ * in one array, so a lookup touches a handful of nodes instead of one node
+ * per comparison, and the leaves are linked so iterating doesn't chase
+ * pointers up and down the tree. */
+
+struct c_btree_s;
+typedef struct c_btree_s c_btree_t;
+
+struct c_btree_iterator_s;
+typedef struct c_btree_iterator_s c_btree_iterator_t;
+
+/*
+ * NAME
+ *   c_btree_create
+ *
+ * DESCRIPTION
+ *   Allocates a new B+tree.
+ *
+ * PARAMETERS
+ *   `compare'  Compares two keys, see `c_avl_create'. If your keys are
+ *              char-pointers, you can use the `strcmp' function from the libc
+ *              here.
+ *
+ * RETURN VALUE
+ *   A c_btree_t-pointer upon success or NULL upon failure.
+ */
+c_btree_t *c_btree_create(int (*compare)(const void *, const void *));
+
+/*
+ * NAME
+ *   c_btree_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a B+tree. Stored value- and key-pointer are lost, but of
+ *   course not freed.
+ */
+void c_btree_destroy(c_btree_t *t);
+
+/*
+ * NAME
+ *   c_btree_insert
+ *
+ * DESCRIPTION
+ *   Stores the key-value-pair in the tree pointed to by `t'. The key pointer
+ *   is stored, not copied, so the memory pointed to may not be freed before
+ *   the entry is removed.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero otherwise. It's less than zero if an error
+ *   occurred or greater than zero if the key is already stored in the tree.
+ */
+int c_btree_insert(c_btree_t *t, void *key, void *value);
+
+/*
+ * NAME
+ *   c_btree_remove
+ *
+ * DESCRIPTION
+ *   Removes a key-value-pair from the tree `t'. The stored key and value may
+ *   be returned in `rkey' and `rvalue', either may be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the tree.
+ */
+int c_btree_remove(c_btree_t *t, const void *key, void **rkey, void **rvalue);
+
+/*
+ * NAME
+ *   c_btree_get
+ *
+ * DESCRIPTION
+ *   Retrieve the `value' belonging to `key'. `value' may be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the tree.
+ */
+int c_btree_get(c_btree_t *t, const void *key, void **value);
+
+/*
+ * NAME
+ *   c_btree_pick
+ *
+ * DESCRIPTION
+ *   Removes an element from the tree and returns its `key' and `value'. Like
+ *   `c_avl_pick', this is intended for removing all elements, one at a time.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the tree is empty or key or value is
+ *   NULL.
+ */
+int c_btree_pick(c_btree_t *t, void **key, void **value);
+
+/*
+ * NAME
+ *   c_btree_get_iterator
+ *
+ * DESCRIPTION
+ *   Returns an iterator over the tree `t'. `c_btree_iterator_next' returns
+ *   the elements in ascending, `c_btree_iterator_prev' in descending order,
+ *   both starting at the respective end. Inserting or removing elements
+ *   invalidates all iterators of the tree.
+ */
+c_btree_iterator_t *c_btree_get_iterator(c_btree_t *t);
+int c_btree_iterator_next(c_btree_iterator_t *iter, void **key, void **value);
+int c_btree_iterator_prev(c_btree_iterator_t *iter, void **key, void **value);
+void c_btree_iterator_destroy(c_btree_iterator_t *iter);
+
+/*
+ * NAME
+ *   c_btree_iterator_next_batch
+ *
+ * DESCRIPTION
+ *   Like `c_btree_iterator_next', but returns up to `num' elements at once in
+ *   ascending order. The keys are stored in `keys' and the values in
+ *   `values'; either may be NULL.
+ *
+ * RETURN VALUE
+ *   The number of elements returned, zero once all elements have been
+ *   returned.
+ */
+int c_btree_iterator_next_batch(c_btree_iterator_t *iter, void **keys,
+                                void **values, int num);
+
+/*
+ * NAME
+ *   c_btree_size
+ *
+ * DESCRIPTION
+ *   Return the number of elements in the tree `t', 0 if `t' is NULL.
+ */
+int c_btree_size(c_btree_t *t);
+
+#endif /* UTILS_BTREE_H */
@@ -0,0 +1,285 @@
+/**
+ * collectd - src/utils/btree/btree_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/btree/btree.h"
+
+/* Enough keys for a tree three levels deep. */
+#define KEYS_NUM 5000
+
+static int compare_keys(void const *a, void const *b) {
+  assert(a != NULL);
+  assert(b != NULL);
+  return strcmp(a, b);
+}
+
+static char *keys[KEYS_NUM];
+
+static void shuffle(char **array, size_t num) {
+  for (size_t i = num - 1; i > 0; i--) {
+    size_t j = (size_t)rand() % (i + 1);
+    char *tmp = array[i];
+    array[i] = array[j];
+    array[j] = tmp;
+  }
+}
+
+/* The keys "key-00000" to "key-04999", in random order. */
+static int create_keys(void) {
+  for (size_t i = 0; i < KEYS_NUM; i++) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "key-%05zu", i);
+    if ((keys[i] = strdup(buffer)) == NULL)
+      return -1;
+  }
+  shuffle(keys, KEYS_NUM);
+  return 0;
+}
+
+/* The value of every key is its number. */
+static size_t key_number(char const *key) {
+  return (size_t)strtoul(key + strlen("key-"), NULL, 10);
+}
+
+static c_btree_t *create_tree(void) {
+  c_btree_t *t = c_btree_create(compare_keys);
+  if (t == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < KEYS_NUM; i++) {
+    if (c_btree_insert(t, keys[i], (void *)(uintptr_t)key_number(keys[i]))) {
+      c_btree_destroy(t);
+      return NULL;
+    }
+  }
+  return t;
+}
+
+DEF_TEST(insert_get) {
+  c_btree_t *t;
+
+  CHECK_NOT_NULL(t = c_btree_create(compare_keys));
+  EXPECT_EQ_INT(-1, c_btree_get(t, "key-00000", NULL));
+
+  for (size_t i = 0; i < KEYS_NUM; i++)
+    CHECK_ZERO(
+        c_btree_insert(t, keys[i], (void *)(uintptr_t)key_number(keys[i])));
+  EXPECT_EQ_INT(KEYS_NUM, c_btree_size(t));
+
+  /* Key already exists. */
+  int errors = 0;
+  for (size_t i = 0; i < KEYS_NUM; i++)
+    if (c_btree_insert(t, keys[i], NULL) != 1)
+      errors++;
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(KEYS_NUM, c_btree_size(t));
+
+  for (size_t i = 0; i < KEYS_NUM; i++) {
+    void *value = NULL;
+    if ((c_btree_get(t, keys[i], &value) != 0) ||
+        ((uintptr_t)value != key_number(keys[i])))
+      errors++;
+  }
+  EXPECT_EQ_INT(0, errors);
+
+  EXPECT_EQ_INT(-1, c_btree_get(t, "key-", NULL));
+  EXPECT_EQ_INT(-1, c_btree_get(t, "key-99999", NULL));
+  EXPECT_EQ_INT(-1, c_btree_get(t, "key-00001x", NULL));
+
+  c_btree_destroy(t);
+  return 0;
+}
+
+DEF_TEST(iterator) {
+  c_btree_t *t;
+  c_btree_iterator_t *iter;
+  void *key;
+  void *value;
+  size_t i;
+
+  CHECK_NOT_NULL(t = create_tree());
+
+  int errors = 0;
+
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  for (i = 0; c_btree_iterator_next(iter, &key, &value) == 0; i++)
+    if ((key_number(key) != i) || ((uintptr_t)value != i))
+      errors++;
+  EXPECT_EQ_UINT64(KEYS_NUM, i);
+
+  /* Going back from the end. */
+  for (i = KEYS_NUM - 1; c_btree_iterator_prev(iter, &key, &value) == 0; i--)
+    if (key_number(key) != i - 1)
+      errors++;
+  EXPECT_EQ_UINT64(0, i);
+  c_btree_iterator_destroy(iter);
+
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  for (i = KEYS_NUM; c_btree_iterator_prev(iter, &key, &value) == 0; i--)
+    if (key_number(key) != i - 1)
+      errors++;
+  EXPECT_EQ_UINT64(0, i);
+  c_btree_iterator_destroy(iter);
+  EXPECT_EQ_INT(0, errors);
+
+  /* Batches don't have to line up with the leaves. */
+  void *batch_keys[77];
+  void *batch_values[77];
+  int num;
+
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  i = 0;
+  while ((num = c_btree_iterator_next_batch(iter, batch_keys, batch_values,
+                                            STATIC_ARRAY_SIZE(batch_keys))) >
+         0) {
+    for (int j = 0; j < num; j++) {
+      if ((key_number(batch_keys[j]) != i) ||
+          ((uintptr_t)batch_values[j] != i))
+        errors++;
+      i++;
+    }
+  }
+  EXPECT_EQ_UINT64(KEYS_NUM, i);
+  EXPECT_EQ_INT(0, errors);
+  c_btree_iterator_destroy(iter);
+
+  c_btree_destroy(t);
+
+  /* An empty tree. */
+  CHECK_NOT_NULL(t = c_btree_create(compare_keys));
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  EXPECT_EQ_INT(-1, c_btree_iterator_next(iter, &key, &value));
+  EXPECT_EQ_INT(-1, c_btree_iterator_prev(iter, &key, &value));
+  EXPECT_EQ_INT(0, c_btree_iterator_next_batch(iter, batch_keys, NULL, 1));
+  c_btree_iterator_destroy(iter);
+  c_btree_destroy(t);
+
+  return 0;
+}
+
+DEF_TEST(remove) {
+  c_btree_t *t;
+  char *copies[KEYS_NUM];
+
+  /* The tree holds copies, which are wiped when they are removed: a
+   * separator still pointing to a removed key would break the lookups. */
+  CHECK_NOT_NULL(t = c_btree_create(compare_keys));
+  for (size_t i = 0; i < KEYS_NUM; i++) {
+    CHECK_NOT_NULL(copies[i] = strdup(keys[i]));
+    CHECK_ZERO(c_btree_insert(t, copies[i], copies[i]));
+  }
+
+  shuffle(keys, KEYS_NUM);
+
+  int errors = 0;
+  for (size_t i = 0; i < KEYS_NUM; i++) {
+    void *rkey = NULL;
+    void *rvalue = NULL;
+
+    CHECK_ZERO(c_btree_remove(t, keys[i], &rkey, &rvalue));
+    if ((strcmp(keys[i], rkey) != 0) || (rkey != rvalue) ||
+        (c_btree_size(t) != KEYS_NUM - (int)i - 1) ||
+        (c_btree_remove(t, keys[i], NULL, NULL) != -1))
+      errors++;
+
+    memset(rkey, 0, strlen(rkey));
+    free(rkey);
+
+    /* Check all remaining keys now and then. */
+    if ((i % 500) == 0) {
+      for (size_t j = i + 1; j < KEYS_NUM; j++)
+        if (c_btree_get(t, keys[j], NULL) != 0)
+          errors++;
+
+      c_btree_iterator_t *iter = c_btree_get_iterator(t);
+      void *key;
+      void *value;
+      char const *last = "";
+      int num = 0;
+      while (c_btree_iterator_next(iter, &key, &value) == 0) {
+        if (strcmp(last, key) >= 0)
+          errors++;
+        last = key;
+        num++;
+      }
+      c_btree_iterator_destroy(iter);
+      EXPECT_EQ_INT(c_btree_size(t), num);
+    }
+  }
+  EXPECT_EQ_INT(0, errors);
+
+  void *key = NULL;
+  void *value = NULL;
+  EXPECT_EQ_INT(-1, c_btree_pick(t, &key, &value));
+
+  c_btree_destroy(t);
+  return 0;
+}
+
+DEF_TEST(pick) {
+  c_btree_t *t;
+  void *key;
+  void *value;
+
+  CHECK_NOT_NULL(t = create_tree());
+
+  int errors = 0;
+  for (int i = KEYS_NUM; i > 0; i--) {
+    CHECK_ZERO(c_btree_pick(t, &key, &value));
+    if ((key_number(key) != (uintptr_t)value) ||
+        (c_btree_get(t, key, NULL) != -1) || (c_btree_size(t) != i - 1))
+      errors++;
+  }
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(0, c_btree_size(t));
+  EXPECT_EQ_INT(-1, c_btree_pick(t, &key, &value));
+
+  /* The tree can be reused once it is empty. */
+  CHECK_ZERO(c_btree_insert(t, "key", "value"));
+  CHECK_ZERO(c_btree_get(t, "key", &value));
+  EXPECT_EQ_STR("value", value);
+
+  c_btree_destroy(t);
+  return 0;
+}
+
+int main(void) {
+  srand(42);
+  if (create_keys() != 0) {
+    fprintf(stderr, "Creating the keys failed.\n");
+    return 1;
+  }
+
+  RUN_TEST(insert_get);
+  RUN_TEST(iterator);
+  RUN_TEST(remove);
+  RUN_TEST(pick);
+
+  for (size_t i = 0; i < KEYS_NUM; i++)
+    free(keys[i]);
+
+  END_TEST;
+}
@@ -28,6 +28,7 @@
 
 #include "utils/cmds/cmds.h"
 #include "utils/cmds/flush.h"
+#include "utils/cmds/getrange.h"
 #include "utils/cmds/getval.h"
 #include "utils/cmds/listval.h"
 #include "utils/cmds/parse_option.h"
@@ -204,9 +205,14 @@ cmd_status_t cmd_parsev(size_t argc, char **argv, cmd_t *ret_cmd,
     ret_cmd->type = CMD_GETVAL;
     status =
         cmd_parse_getval(argc - 1, argv + 1, &ret_cmd->cmd.getval, opts, err);
+  } else if (strcasecmp("GETRANGE", command) == 0) {
+    ret_cmd->type = CMD_GETRANGE;
+    status = cmd_parse_getrange(argc - 1, argv + 1, &ret_cmd->cmd.getrange,
+                                opts, err);
   } else if (strcasecmp("LISTVAL", command) == 0) {
     ret_cmd->type = CMD_LISTVAL;
-    status = cmd_parse_listval(argc - 1, argv + 1, opts, err);
+    status = cmd_parse_listval(argc - 1, argv + 1, &ret_cmd->cmd.listval, opts,
+                               err);
   } else if (strcasecmp("PUTVAL", command) == 0) {
     ret_cmd->type = CMD_PUTVAL;
     status =
@@ -250,7 +256,11 @@ void cmd_destroy(cmd_t *cmd) {
   case CMD_GETVAL:
     cmd_destroy_getval(&cmd->cmd.getval);
     break;
+  case CMD_GETRANGE:
+    cmd_destroy_getrange(&cmd->cmd.getrange);
+    break;
   case CMD_LISTVAL:
+    cmd_destroy_listval(&cmd->cmd.listval);
     break;
   case CMD_PUTVAL:
     cmd_destroy_putval(&cmd->cmd.putval);
@@ -37,6 +37,7 @@ typedef enum {
   CMD_GETVAL = 2,
   CMD_LISTVAL = 3,
   CMD_PUTVAL = 4,
+  CMD_GETRANGE = 5,
 } cmd_type_t;
 #define CMD_TO_STRING(type)                                                    \
   ((type) == CMD_FLUSH)                                                        \
@@ -45,7 +46,9 @@ typedef enum {
             ? "GETVAL"                                                         \
             : ((type) == CMD_LISTVAL)                                          \
                   ? "LISTVAL"                                                  \
-                  : ((type) == CMD_PUTVAL) ? "PUTVAL" : "UNKNOWN"
+                  : ((type) == CMD_PUTVAL)                                     \
+                        ? "PUTVAL"                                             \
+                        : ((type) == CMD_GETRANGE) ? "GETRANGE" : "UNKNOWN"
 
 typedef struct {
   double timeout;
@@ -57,9 +60,25 @@ typedef struct {
 } cmd_flush_t;
 
 typedef struct {
+  /* The raw identifiers as provided by the user and their parsed form. */
+  char **raw_identifiers;
+  identifier_t *identifiers;
+  size_t identifiers_num;
+} cmd_getval_t;
+
+typedef struct {
+  /* The raw identifier as provided by the user and its parsed form. */
   char *raw_identifier;
   identifier_t identifier;
-} cmd_getval_t;
+  /* The range of times to return, including both ends. */
+  cdtime_t start;
+  cdtime_t end;
+} cmd_getrange_t;
+
+typedef struct {
+  /* Optional shell wildcard pattern the identifiers have to match. */
+  char *pattern;
+} cmd_listval_t;
 
 typedef struct {
   /* The raw identifier as provided by the user. */
@@ -83,6 +102,8 @@ typedef struct {
   union {
     cmd_flush_t flush;
     cmd_getval_t getval;
+    cmd_getrange_t getrange;
+    cmd_listval_t listval;
     cmd_putval_t putval;
   } cmd;
 } cmd_t;
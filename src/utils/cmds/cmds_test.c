@@ -91,6 +91,10 @@ static struct {
     {
         "GETVAL magic/MAGIC", &default_host_opts, CMD_OK, CMD_GETVAL,
     },
+    {
+        "GETVAL myhost/magic/MAGIC myhost/magic-0/MAGIC-1", NULL, CMD_OK,
+        CMD_GETVAL,
+    },
 
     /* Invalid GETVAL commands. */
     {
@@ -102,15 +106,53 @@ static struct {
     {
         "GETVAL invalid", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
     },
+    {
+        "GETVAL myhost/magic/MAGIC invalid", NULL, CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+
+    /* Valid GETRANGE commands. */
+    {
+        "GETRANGE myhost/magic/MAGIC", NULL, CMD_OK, CMD_GETRANGE,
+    },
+    {
+        "GETRANGE magic/MAGIC start=-300", &default_host_opts, CMD_OK,
+        CMD_GETRANGE,
+    },
+    {
+        "GETRANGE myhost/magic/MAGIC start=1234.5 end=2345", NULL, CMD_OK,
+        CMD_GETRANGE,
+    },
+    /* Invalid GETRANGE commands. */
+    {
+        "GETRANGE", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
+    },
+    {
+        "GETRANGE invalid", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
+    },
+    {
+        "GETRANGE myhost/magic/MAGIC start=A", NULL, CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+    {
+        "GETRANGE myhost/magic/MAGIC invalid=1", NULL, CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+    {
+        "GETRANGE myhost/magic/MAGIC 1234", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
+    },
 
     /* Valid LISTVAL commands. */
     {
         "LISTVAL", NULL, CMD_OK, CMD_LISTVAL,
     },
+    {
+        "LISTVAL myhost/cpu-*", NULL, CMD_OK, CMD_LISTVAL,
+    },
 
     /* Invalid LISTVAL commands. */
     {
-        "LISTVAL invalid", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
+        "LISTVAL myhost/cpu-* invalid", NULL, CMD_PARSE_ERROR, CMD_UNKNOWN,
     },
 
     /* Valid PUTVAL commands. */
@@ -218,7 +260,50 @@ DEF_TEST(parse) {
   return test_result;
 }
 
+DEF_TEST(putval_identifier_cache) {
+  cmd_error_handler_t err = {error_cb, NULL};
+  struct {
+    char *input;
+    cmd_options_t *opts;
+    cmd_status_t status;
+    char *host;
+    char *plugin_instance;
+  } cases[] = {
+      {"PUTVAL myhost/magic-a/MAGIC N:1", NULL, CMD_OK, "myhost", "a"},
+      /* Same identifier: served from the cache. */
+      {"PUTVAL myhost/magic-a/MAGIC N:2 N:3", NULL, CMD_OK, "myhost", "a"},
+      {"PUTVAL myhost/magic/MAGIC N:4", NULL, CMD_OK, "myhost", ""},
+      {"PUTVAL magic/MAGIC N:5", &default_host_opts, CMD_OK, "dummy-host", ""},
+      /* The default host is part of the cache key. */
+      {"PUTVAL magic/MAGIC N:6", NULL, CMD_PARSE_ERROR, NULL, NULL},
+      {"PUTVAL magic/MAGIC N:7", &default_host_opts, CMD_OK, "dummy-host", ""},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *input = strdup(cases[i].input);
+    cmd_t cmd;
+
+    printf("## Case %" PRIsz ": %s\n", i, cases[i].input);
+    EXPECT_EQ_INT(cases[i].status, cmd_parse(input, &cmd, cases[i].opts, &err));
+    if (cases[i].status == CMD_OK) {
+      OK(cmd.cmd.putval.vl_num > 0);
+      for (size_t j = 0; j < cmd.cmd.putval.vl_num; j++) {
+        EXPECT_EQ_STR(cases[i].host, cmd.cmd.putval.vl[j].host);
+        EXPECT_EQ_STR("magic", cmd.cmd.putval.vl[j].plugin);
+        EXPECT_EQ_STR(cases[i].plugin_instance,
+                      cmd.cmd.putval.vl[j].plugin_instance);
+        EXPECT_EQ_STR("MAGIC", cmd.cmd.putval.vl[j].type);
+      }
+      cmd_destroy(&cmd);
+    }
+    free(input);
+  }
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
   RUN_TEST(parse);
+  RUN_TEST(putval_identifier_cache);
   END_TEST;
 }
@@ -0,0 +1,214 @@
+/**
+ * collectd - src/utils/cmds/getrange.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+
+#include "utils/cmds/getrange.h"
+#include "utils_cache.h"
+
+/* Parses a time: seconds since the epoch, or, if negative, seconds before
+ * now. */
+static int getrange_parse_time(char const *str, cdtime_t *ret) {
+  char *endptr = NULL;
+
+  errno = 0;
+  double d = strtod(str, &endptr);
+  if ((endptr == str) || (*endptr != 0) || (errno != 0) || !isfinite(d))
+    return EINVAL;
+
+  if (d >= 0.0) {
+    *ret = DOUBLE_TO_CDTIME_T(d);
+  } else {
+    cdtime_t now = cdtime();
+    cdtime_t ago = DOUBLE_TO_CDTIME_T(-d);
+    *ret = (ago < now) ? now - ago : 0;
+  }
+
+  return 0;
+} /* int getrange_parse_time */
+
+cmd_status_t cmd_parse_getrange(size_t argc, char **argv,
+                                cmd_getrange_t *ret_getrange,
+                                const cmd_options_t *opts,
+                                cmd_error_handler_t *err) {
+  if ((ret_getrange == NULL) || (opts == NULL)) {
+    errno = EINVAL;
+    cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_getrange.");
+    return CMD_ERROR;
+  }
+
+  if (argc == 0) {
+    cmd_error(CMD_PARSE_ERROR, err, "Missing identifier.");
+    return CMD_PARSE_ERROR;
+  }
+
+  ret_getrange->start = 0;
+  ret_getrange->end = UINT64_MAX;
+
+  /* parse_identifier() modifies its first argument, returning pointers into
+   * it */
+  ret_getrange->raw_identifier = sstrdup(argv[0]);
+  if (ret_getrange->raw_identifier == NULL) {
+    cmd_error(CMD_ERROR, err, "sstrdup failed.");
+    return CMD_ERROR;
+  }
+
+  identifier_t *id = &ret_getrange->identifier;
+  if (parse_identifier(argv[0], &id->host, &id->plugin, &id->plugin_instance,
+                       &id->type, &id->type_instance,
+                       opts->identifier_default_host) != 0) {
+    cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.",
+              ret_getrange->raw_identifier);
+    cmd_destroy_getrange(ret_getrange);
+    return CMD_PARSE_ERROR;
+  }
+
+  for (size_t i = 1; i < argc; i++) {
+    char *opt_key = NULL;
+    char *opt_value = NULL;
+    int status = cmd_parse_option(argv[i], &opt_key, &opt_value, err);
+    if (status != 0) {
+      if (status == CMD_NO_OPTION)
+        cmd_error(CMD_PARSE_ERROR, err, "Invalid option string `%s'.", argv[i]);
+      cmd_destroy_getrange(ret_getrange);
+      return CMD_PARSE_ERROR;
+    }
+
+    cdtime_t *t;
+    if (strcasecmp("start", opt_key) == 0) {
+      t = &ret_getrange->start;
+    } else if (strcasecmp("end", opt_key) == 0) {
+      t = &ret_getrange->end;
+    } else {
+      cmd_error(CMD_PARSE_ERROR, err, "Cannot parse option `%s'.", opt_key);
+      cmd_destroy_getrange(ret_getrange);
+      return CMD_PARSE_ERROR;
+    }
+
+    if (getrange_parse_time(opt_value, t) != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Invalid value for option `%s': %s",
+                opt_key, opt_value);
+      cmd_destroy_getrange(ret_getrange);
+      return CMD_PARSE_ERROR;
+    }
+  }
+
+  return CMD_OK;
+} /* cmd_status_t cmd_parse_getrange */
+
+#define print_to_socket(fh, ...)                                               \
+  do {                                                                         \
+    if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
+      WARNING("cmd_handle_getrange: failed to write to socket #%i: %s",        \
+              fileno(fh), STRERRNO);                                           \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+/* Prints one line per point: the time followed by the rates of the data
+ * sources. */
+static int getrange_print(FILE *fh, data_set_t const *ds,
+                          cdtime_t const *times, gauge_t const *values,
+                          size_t num) {
+  print_to_socket(fh, "%" PRIsz " Point%s found\n", num,
+                  (num == 1) ? "" : "s");
+  for (size_t i = 0; i < num; i++) {
+    print_to_socket(fh, "%.3f", CDTIME_T_TO_DOUBLE(times[i]));
+    for (size_t j = 0; j < ds->ds_num; j++) {
+      gauge_t v = values[i * ds->ds_num + j];
+      if (isnan(v))
+        print_to_socket(fh, " %s=NaN", ds->ds[j].name);
+      else
+        print_to_socket(fh, " %s=%e", ds->ds[j].name, v);
+    }
+    print_to_socket(fh, "\n");
+  }
+
+  fflush(fh);
+  return 0;
+} /* int getrange_print */
+
+cmd_status_t cmd_handle_getrange(FILE *fh, char *buffer) {
+  cmd_error_handler_t err = {cmd_error_fh, fh};
+  cmd_status_t status;
+  cmd_t cmd;
+
+  if ((fh == NULL) || (buffer == NULL))
+    return -1;
+
+  DEBUG("utils_cmd_getrange: cmd_handle_getrange (fh = %p, buffer = %s);",
+        (void *)fh, buffer);
+
+  if ((status = cmd_parse(buffer, &cmd, NULL, &err)) != CMD_OK)
+    return status;
+  if (cmd.type != CMD_GETRANGE) {
+    cmd_error(CMD_UNKNOWN_COMMAND, &err, "Unexpected command: `%s'.",
+              CMD_TO_STRING(cmd.type));
+    cmd_destroy(&cmd);
+    return CMD_UNKNOWN_COMMAND;
+  }
+
+  cmd_getrange_t *getrange = &cmd.cmd.getrange;
+  data_set_t const *ds = plugin_get_ds(getrange->identifier.type);
+  if (ds == NULL) {
+    cmd_error(CMD_ERROR, &err, "Type `%s' is unknown.\n",
+              getrange->identifier.type);
+    cmd_destroy(&cmd);
+    return CMD_ERROR;
+  }
+
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  size_t values_num = 0;
+  int uc_status = uc_get_series_by_name(getrange->raw_identifier,
+                                        getrange->start, getrange->end,
+                                        &times, &values, &num, &values_num);
+  if (uc_status != 0) {
+    cmd_error(CMD_ERROR, &err, "No such value.");
+    status = CMD_ERROR;
+  } else if (values_num != ds->ds_num) {
+    cmd_error(CMD_ERROR, &err, "Error reading value from cache.");
+    status = CMD_ERROR;
+  } else if (getrange_print(fh, ds, times, values, num) != 0) {
+    status = -1;
+  } else {
+    status = CMD_OK;
+  }
+
+  sfree(times);
+  sfree(values);
+  cmd_destroy(&cmd);
+
+  return status;
+} /* cmd_status_t cmd_handle_getrange */
+
+void cmd_destroy_getrange(cmd_getrange_t *getrange) {
+  if (getrange == NULL)
+    return;
+
+  sfree(getrange->raw_identifier);
+} /* void cmd_destroy_getrange */
@@ -29,7 +29,7 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/cmds/getthreshold.h"
 #include "utils/cmds/parse_option.h" /* for `parse_string' */
 #include "utils_threshold.h"
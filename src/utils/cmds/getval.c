@@ -37,41 +37,52 @@ cmd_status_t cmd_parse_getval(size_t argc, char **argv,
                               cmd_getval_t *ret_getval,
                               const cmd_options_t *opts,
                               cmd_error_handler_t *err) {
-  char *identifier_copy;
-  int status;
-
   if ((ret_getval == NULL) || (opts == NULL)) {
     errno = EINVAL;
     cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_getval.");
     return CMD_ERROR;
   }
 
-  if (argc != 1) {
-    if (argc == 0)
-      cmd_error(CMD_PARSE_ERROR, err, "Missing identifier.");
-    else
-      cmd_error(CMD_PARSE_ERROR, err, "Garbage after identifier: `%s'.",
-                argv[1]);
+  if (argc == 0) {
+    cmd_error(CMD_PARSE_ERROR, err, "Missing identifier.");
     return CMD_PARSE_ERROR;
   }
 
-  /* parse_identifier() modifies its first argument,
-   * returning pointers into it */
-  identifier_copy = sstrdup(argv[0]);
-
-  status = parse_identifier(
-      argv[0], &ret_getval->identifier.host, &ret_getval->identifier.plugin,
-      &ret_getval->identifier.plugin_instance, &ret_getval->identifier.type,
-      &ret_getval->identifier.type_instance, opts->identifier_default_host);
-  if (status != 0) {
-    DEBUG("cmd_parse_getval: Cannot parse identifier `%s'.", identifier_copy);
-    cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.",
-              identifier_copy);
-    sfree(identifier_copy);
-    return CMD_PARSE_ERROR;
+  ret_getval->raw_identifiers =
+      calloc(argc, sizeof(*ret_getval->raw_identifiers));
+  ret_getval->identifiers = calloc(argc, sizeof(*ret_getval->identifiers));
+  if ((ret_getval->raw_identifiers == NULL) ||
+      (ret_getval->identifiers == NULL)) {
+    cmd_error(CMD_ERROR, err, "calloc failed.");
+    cmd_destroy_getval(ret_getval);
+    return CMD_ERROR;
+  }
+
+  for (size_t i = 0; i < argc; i++) {
+    identifier_t *id = ret_getval->identifiers + i;
+
+    /* parse_identifier() modifies its first argument,
+     * returning pointers into it */
+    char *identifier_copy = sstrdup(argv[i]);
+
+    int status = parse_identifier(argv[i], &id->host, &id->plugin,
+                                  &id->plugin_instance, &id->type,
+                                  &id->type_instance,
+                                  opts->identifier_default_host);
+    if (status != 0) {
+      DEBUG("cmd_parse_getval: Cannot parse identifier `%s'.",
+            identifier_copy);
+      cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.",
+                identifier_copy);
+      sfree(identifier_copy);
+      cmd_destroy_getval(ret_getval);
+      return CMD_PARSE_ERROR;
+    }
+
+    ret_getval->raw_identifiers[i] = identifier_copy;
+    ret_getval->identifiers_num++;
   }
 
-  ret_getval->raw_identifier = identifier_copy;
   return CMD_OK;
 } /* cmd_status_t cmd_parse_getval */
 
@@ -82,19 +93,84 @@ cmd_status_t cmd_parse_getval(size_t argc, char **argv,
               fileno(fh), STRERRNO);                                           \
       return -1;                                                               \
     }                                                                          \
-    fflush(fh);                                                                \
   } while (0)
 
+/* The current rates of one identifier of a GETVAL command. "values" is NULL
+ * if the identifier has not been found. */
+typedef struct {
+  char const *name;
+  data_set_t const *ds;
+  gauge_t *values;
+} getval_rates_t;
+
+/* Looks up the rates of one identifier. Errors are reported via "err", which
+ * may be NULL. */
+static cmd_status_t getval_lookup(char const *raw_identifier,
+                                  identifier_t const *identifier,
+                                  getval_rates_t *ret,
+                                  cmd_error_handler_t *err) {
+  ret->name = raw_identifier;
+  ret->ds = plugin_get_ds(identifier->type);
+  if (ret->ds == NULL) {
+    DEBUG("cmd_handle_getval: plugin_get_ds (%s) == NULL;", identifier->type);
+    cmd_error(CMD_ERROR, err, "Type `%s' is unknown.\n", identifier->type);
+    return CMD_ERROR;
+  }
+
+  size_t values_num = 0;
+  if (uc_get_rate_by_name(raw_identifier, &ret->values, &values_num) != 0) {
+    cmd_error(CMD_ERROR, err, "No such value.");
+    return CMD_ERROR;
+  }
+
+  if (ret->ds->ds_num != values_num) {
+    ERROR("ds[%s]->ds_num = %" PRIsz ", "
+          "but uc_get_rate_by_name returned %" PRIsz " values.",
+          ret->ds->type, ret->ds->ds_num, values_num);
+    cmd_error(CMD_ERROR, err, "Error reading value from cache.");
+    sfree(ret->values);
+    return CMD_ERROR;
+  }
+
+  return CMD_OK;
+} /* cmd_status_t getval_lookup */
+
+/* Prints the rates that have been found. With more than one identifier, each
+ * line is prefixed with the identifier it belongs to. */
+static int getval_print(FILE *fh, getval_rates_t const *rates,
+                        size_t rates_num) {
+  size_t lines = 0;
+  for (size_t i = 0; i < rates_num; i++)
+    if (rates[i].values != NULL)
+      lines += rates[i].ds->ds_num;
+
+  print_to_socket(fh, "%" PRIsz " Value%s found\n", lines,
+                  (lines == 1) ? "" : "s");
+  for (size_t i = 0; i < rates_num; i++) {
+    if (rates[i].values == NULL)
+      continue;
+
+    for (size_t j = 0; j < rates[i].ds->ds_num; j++) {
+      if (rates_num > 1)
+        print_to_socket(fh, "%s ", rates[i].name);
+      print_to_socket(fh, "%s=", rates[i].ds->ds[j].name);
+      if (isnan(rates[i].values[j])) {
+        print_to_socket(fh, "NaN\n");
+      } else {
+        print_to_socket(fh, "%12e\n", rates[i].values[j]);
+      }
+    }
+  }
+
+  fflush(fh);
+  return 0;
+} /* int getval_print */
+
 cmd_status_t cmd_handle_getval(FILE *fh, char *buffer) {
   cmd_error_handler_t err = {cmd_error_fh, fh};
   cmd_status_t status;
   cmd_t cmd;
 
-  gauge_t *values;
-  size_t values_num;
-
-  const data_set_t *ds;
-
   if ((fh == NULL) || (buffer == NULL))
     return -1;
 
@@ -110,56 +186,50 @@ cmd_status_t cmd_handle_getval(FILE *fh, char *buffer) {
     return CMD_UNKNOWN_COMMAND;
   }
 
-  ds = plugin_get_ds(cmd.cmd.getval.identifier.type);
-  if (ds == NULL) {
-    DEBUG("cmd_handle_getval: plugin_get_ds (%s) == NULL;",
-          cmd.cmd.getval.identifier.type);
-    cmd_error(CMD_ERROR, &err, "Type `%s' is unknown.\n",
-              cmd.cmd.getval.identifier.type);
-    cmd_destroy(&cmd);
-    return -1;
-  }
-
-  values = NULL;
-  values_num = 0;
-  status =
-      uc_get_rate_by_name(cmd.cmd.getval.raw_identifier, &values, &values_num);
-  if (status != 0) {
-    cmd_error(CMD_ERROR, &err, "No such value.");
+  cmd_getval_t *getval = &cmd.cmd.getval;
+  getval_rates_t *rates = calloc(getval->identifiers_num, sizeof(*rates));
+  if (rates == NULL) {
+    cmd_error(CMD_ERROR, &err, "calloc failed.");
     cmd_destroy(&cmd);
     return CMD_ERROR;
   }
 
-  if (ds->ds_num != values_num) {
-    ERROR("ds[%s]->ds_num = %" PRIsz ", "
-          "but uc_get_rate_by_name returned %" PRIsz " values.",
-          ds->type, ds->ds_num, values_num);
-    cmd_error(CMD_ERROR, &err, "Error reading value from cache.");
-    sfree(values);
-    cmd_destroy(&cmd);
-    return CMD_ERROR;
+  /* A single identifier has to be found. Of several identifiers, those that
+   * cannot be found are left out of the response. */
+  size_t found = 0;
+  for (size_t i = 0; i < getval->identifiers_num; i++) {
+    status = getval_lookup(getval->raw_identifiers[i],
+                           getval->identifiers + i, rates + i,
+                           (getval->identifiers_num == 1) ? &err : NULL);
+    if (status == CMD_OK)
+      found++;
   }
 
-  print_to_socket(fh, "%" PRIsz " Value%s found\n", values_num,
-                  (values_num == 1) ? "" : "s");
-  for (size_t i = 0; i < values_num; i++) {
-    print_to_socket(fh, "%s=", ds->ds[i].name);
-    if (isnan(values[i])) {
-      print_to_socket(fh, "NaN\n");
-    } else {
-      print_to_socket(fh, "%12e\n", values[i]);
-    }
+  if (found == 0) {
+    if (getval->identifiers_num > 1)
+      cmd_error(CMD_ERROR, &err, "No such value.");
+    status = CMD_ERROR;
+  } else if (getval_print(fh, rates, getval->identifiers_num) != 0) {
+    status = -1;
+  } else {
+    status = CMD_OK;
   }
 
-  sfree(values);
+  for (size_t i = 0; i < getval->identifiers_num; i++)
+    sfree(rates[i].values);
+  sfree(rates);
   cmd_destroy(&cmd);
 
-  return CMD_OK;
+  return status;
 } /* cmd_status_t cmd_handle_getval */
 
 void cmd_destroy_getval(cmd_getval_t *getval) {
   if (getval == NULL)
     return;
 
-  sfree(getval->raw_identifier);
+  for (size_t i = 0; i < getval->identifiers_num; i++)
+    sfree(getval->raw_identifiers[i]);
+  sfree(getval->raw_identifiers);
+  sfree(getval->identifiers);
+  getval->identifiers_num = 0;
 } /* void cmd_destroy_getval */
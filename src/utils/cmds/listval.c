@@ -34,15 +34,24 @@
 #include "utils_cache.h"
 
 cmd_status_t cmd_parse_listval(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
                                const cmd_options_t *opts
                                __attribute__((unused)),
                                cmd_error_handler_t *err) {
-  if (argc != 0) {
+  if (argc > 1) {
     cmd_error(CMD_PARSE_ERROR, err, "Garbage after end of command: `%s'.",
-              argv[0]);
+              argv[1]);
     return CMD_PARSE_ERROR;
   }
 
+  if (argc == 1) {
+    ret_listval->pattern = strdup(argv[0]);
+    if (ret_listval->pattern == NULL) {
+      cmd_error(CMD_ERROR, err, "strdup failed.");
+      return CMD_ERROR;
+    }
+  }
+
   return CMD_OK;
 } /* cmd_status_t cmd_parse_listval */
 
@@ -54,6 +63,7 @@ cmd_status_t cmd_parse_listval(size_t argc, char **argv,
     }                                                                          \
     sfree(names);                                                              \
     sfree(times);                                                              \
+    cmd_destroy(&cmd);                                                         \
     return status;                                                             \
   } while (0)
 
@@ -64,7 +74,6 @@ cmd_status_t cmd_parse_listval(size_t argc, char **argv,
               STRERRNO);                                                       \
       free_everything_and_return(CMD_ERROR);                                   \
     }                                                                          \
-    fflush(fh);                                                                \
   } while (0)
 
 cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
@@ -87,17 +96,28 @@ cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
     free_everything_and_return(CMD_UNKNOWN_COMMAND);
   }
 
-  status = uc_get_names(&names, &times, &number);
+  /* Only the matching names are copied out of the cache. */
+  status = uc_get_names_matching(cmd.cmd.listval.pattern, &names, &times,
+                                 &number);
   if (status != 0) {
     DEBUG("command listval: uc_get_names failed with status %i", status);
     cmd_error(CMD_ERROR, &err, "uc_get_names failed.");
     free_everything_and_return(CMD_ERROR);
   }
 
+  /* The output is flushed once, not after every line. */
   print_to_socket(fh, "%i Value%s found\n", (int)number,
                   (number == 1) ? "" : "s");
   for (size_t i = 0; i < number; i++)
     print_to_socket(fh, "%.3f %s\n", CDTIME_T_TO_DOUBLE(times[i]), names[i]);
+  fflush(fh);
 
   free_everything_and_return(CMD_OK);
 } /* cmd_status_t cmd_handle_listval */
+
+void cmd_destroy_listval(cmd_listval_t *listval) {
+  if (listval == NULL)
+    return;
+
+  sfree(listval->pattern);
+} /* void cmd_destroy_listval */
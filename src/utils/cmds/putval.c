@@ -55,6 +55,136 @@ static int set_option(value_list_t *vl, const char *key, const char *value) {
   return 0;
 } /* int set_option */
 
+/* The parsed identifier of the last PUTVAL command handled by a thread.
+ * Clients usually send many lines with the same identifier in a row, e.g.
+ * when replaying a file, so the identifier is parsed only once for those.
+ * The data set is not cached: it may be unregistered at any time. */
+typedef struct {
+  char raw[6 * DATA_MAX_NAME_LEN];
+  bool has_default_host;
+  char default_host[DATA_MAX_NAME_LEN];
+
+  char host[DATA_MAX_NAME_LEN];
+  char plugin[DATA_MAX_NAME_LEN];
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
+} putval_ident_cache_t;
+
+static pthread_key_t ident_cache_key;
+static bool ident_cache_key_valid;
+static pthread_once_t ident_cache_once = PTHREAD_ONCE_INIT;
+
+static void ident_cache_key_init(void) {
+  if (pthread_key_create(&ident_cache_key, free) == 0)
+    ident_cache_key_valid = true;
+}
+
+static putval_ident_cache_t *ident_cache_get(void) {
+  pthread_once(&ident_cache_once, ident_cache_key_init);
+  if (!ident_cache_key_valid)
+    return NULL;
+
+  putval_ident_cache_t *cache = pthread_getspecific(ident_cache_key);
+  if (cache == NULL) {
+    cache = calloc(1, sizeof(*cache));
+    if ((cache == NULL) || (pthread_setspecific(ident_cache_key, cache) != 0)) {
+      sfree(cache);
+      return NULL;
+    }
+  }
+  return cache;
+}
+
+static bool ident_cache_match(putval_ident_cache_t const *cache,
+                              char const *identifier,
+                              char const *default_host) {
+  if ((cache == NULL) || (cache->raw[0] == 0) ||
+      (strcmp(cache->raw, identifier) != 0))
+    return false;
+  if (default_host == NULL)
+    return !cache->has_default_host;
+  return cache->has_default_host &&
+         (strcmp(cache->default_host, default_host) == 0);
+}
+
+/* Fills in the identifier fields of `vl' from `identifier', using the cache
+ * of the calling thread if possible. `identifier' is modified. */
+static cmd_status_t putval_parse_identifier(char *identifier,
+                                            value_list_t *vl,
+                                            const cmd_options_t *opts,
+                                            cmd_error_handler_t *err) {
+  char *default_host = opts->identifier_default_host;
+  putval_ident_cache_t *cache = ident_cache_get();
+
+  if (ident_cache_match(cache, identifier, default_host)) {
+    memcpy(vl->host, cache->host, sizeof(vl->host));
+    memcpy(vl->plugin, cache->plugin, sizeof(vl->plugin));
+    memcpy(vl->plugin_instance, cache->plugin_instance,
+           sizeof(vl->plugin_instance));
+    memcpy(vl->type, cache->type, sizeof(vl->type));
+    memcpy(vl->type_instance, cache->type_instance, sizeof(vl->type_instance));
+    return CMD_OK;
+  }
+
+  /* parse_identifier() modifies its first argument, returning pointers into
+   * it; retain the old value for the cache and error messages. */
+  char raw[sizeof(cache->raw)];
+  bool cacheable = (strlen(identifier) < sizeof(raw));
+  sstrncpy(raw, identifier, sizeof(raw));
+
+  char *hostname;
+  char *plugin;
+  char *plugin_instance;
+  char *type;
+  char *type_instance;
+  int status =
+      parse_identifier(identifier, &hostname, &plugin, &plugin_instance, &type,
+                       &type_instance, default_host);
+  if (status != 0) {
+    DEBUG("cmd_handle_putval: Cannot parse identifier `%s'.", raw);
+    cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.", raw);
+    return CMD_PARSE_ERROR;
+  }
+
+  if ((strlen(hostname) >= sizeof(vl->host)) ||
+      (strlen(plugin) >= sizeof(vl->plugin)) ||
+      ((plugin_instance != NULL) &&
+       (strlen(plugin_instance) >= sizeof(vl->plugin_instance))) ||
+      (strlen(type) >= sizeof(vl->type)) ||
+      ((type_instance != NULL) &&
+       (strlen(type_instance) >= sizeof(vl->type_instance)))) {
+    cmd_error(CMD_PARSE_ERROR, err, "Identifier too long.");
+    return CMD_PARSE_ERROR;
+  }
+
+  sstrncpy(vl->host, hostname, sizeof(vl->host));
+  sstrncpy(vl->plugin, plugin, sizeof(vl->plugin));
+  sstrncpy(vl->type, type, sizeof(vl->type));
+  if (plugin_instance != NULL)
+    sstrncpy(vl->plugin_instance, plugin_instance, sizeof(vl->plugin_instance));
+  if (type_instance != NULL)
+    sstrncpy(vl->type_instance, type_instance, sizeof(vl->type_instance));
+
+  if ((cache != NULL) && cacheable &&
+      ((default_host == NULL) ||
+       (strlen(default_host) < sizeof(cache->default_host)))) {
+    sstrncpy(cache->raw, raw, sizeof(cache->raw));
+    cache->has_default_host = (default_host != NULL);
+    sstrncpy(cache->default_host, (default_host != NULL) ? default_host : "",
+             sizeof(cache->default_host));
+    memcpy(cache->host, vl->host, sizeof(cache->host));
+    memcpy(cache->plugin, vl->plugin, sizeof(cache->plugin));
+    memcpy(cache->plugin_instance, vl->plugin_instance,
+           sizeof(cache->plugin_instance));
+    memcpy(cache->type, vl->type, sizeof(cache->type));
+    memcpy(cache->type_instance, vl->type_instance,
+           sizeof(cache->type_instance));
+  }
+
+  return CMD_OK;
+}
+
 /*
  * public API
  */
@@ -64,17 +194,8 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
                               const cmd_options_t *opts,
                               cmd_error_handler_t *err) {
   cmd_status_t result;
-
-  char *identifier;
-  char *hostname;
-  char *plugin;
-  char *plugin_instance;
-  char *type;
-  char *type_instance;
   int status;
 
-  char *identifier_copy;
-
   const data_set_t *ds;
   value_list_t vl = VALUE_LIST_INIT;
 
@@ -89,68 +210,36 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
     return CMD_PARSE_ERROR;
   }
 
-  identifier = argv[0];
-
-  /* parse_identifier() modifies its first argument, returning pointers into
-   * it; retain the old value for later. */
-  identifier_copy = sstrdup(identifier);
-
-  status =
-      parse_identifier(identifier, &hostname, &plugin, &plugin_instance, &type,
-                       &type_instance, opts->identifier_default_host);
-  if (status != 0) {
-    DEBUG("cmd_handle_putval: Cannot parse identifier `%s'.", identifier_copy);
-    cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.",
-              identifier_copy);
-    sfree(identifier_copy);
-    return CMD_PARSE_ERROR;
+  ret_putval->raw_identifier = strdup(argv[0]);
+  if (ret_putval->raw_identifier == NULL) {
+    cmd_error(CMD_ERROR, err, "malloc failed.");
+    return CMD_ERROR;
   }
 
-  if ((strlen(hostname) >= sizeof(vl.host)) ||
-      (strlen(plugin) >= sizeof(vl.plugin)) ||
-      ((plugin_instance != NULL) &&
-       (strlen(plugin_instance) >= sizeof(vl.plugin_instance))) ||
-      ((type_instance != NULL) &&
-       (strlen(type_instance) >= sizeof(vl.type_instance)))) {
-    cmd_error(CMD_PARSE_ERROR, err, "Identifier too long.");
-    sfree(identifier_copy);
-    return CMD_PARSE_ERROR;
+  result = putval_parse_identifier(argv[0], &vl, opts, err);
+  if (result != CMD_OK) {
+    cmd_destroy_putval(ret_putval);
+    return result;
   }
 
-  sstrncpy(vl.host, hostname, sizeof(vl.host));
-  sstrncpy(vl.plugin, plugin, sizeof(vl.plugin));
-  sstrncpy(vl.type, type, sizeof(vl.type));
-  if (plugin_instance != NULL)
-    sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
-  if (type_instance != NULL)
-    sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
-
-  ds = plugin_get_ds(type);
+  ds = plugin_get_ds(vl.type);
   if (ds == NULL) {
-    cmd_error(CMD_PARSE_ERROR, err, "1 Type `%s' isn't defined.", type);
-    sfree(identifier_copy);
+    cmd_error(CMD_PARSE_ERROR, err, "1 Type `%s' isn't defined.", vl.type);
+    cmd_destroy_putval(ret_putval);
     return CMD_PARSE_ERROR;
   }
 
-  hostname = NULL;
-  plugin = NULL;
-  plugin_instance = NULL;
-  type = NULL;
-  type_instance = NULL;
-
-  ret_putval->raw_identifier = identifier_copy;
-  if (ret_putval->raw_identifier == NULL) {
+  /* At most argc - 1 value lists; allocate them at once. */
+  ret_putval->vl = calloc(argc - 1, sizeof(*ret_putval->vl));
+  if (ret_putval->vl == NULL) {
     cmd_error(CMD_ERROR, err, "malloc failed.");
     cmd_destroy_putval(ret_putval);
-    sfree(vl.values);
     return CMD_ERROR;
   }
 
   /* All the remaining fields are part of the option list. */
   result = CMD_OK;
   for (size_t i = 1; i < argc; ++i) {
-    value_list_t *tmp;
-
     char *key = NULL;
     char *value = NULL;
 
@@ -186,18 +275,6 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
       break;
     }
 
-    tmp = realloc(ret_putval->vl,
-                  (ret_putval->vl_num + 1) * sizeof(*ret_putval->vl));
-    if (tmp == NULL) {
-      cmd_error(CMD_ERROR, err, "realloc failed.");
-      cmd_destroy_putval(ret_putval);
-      result = CMD_ERROR;
-      vl.values_len = 0;
-      sfree(vl.values);
-      break;
-    }
-
-    ret_putval->vl = tmp;
     ret_putval->vl_num++;
     memcpy(&ret_putval->vl[ret_putval->vl_num - 1], &vl, sizeof(vl));
 
@@ -247,8 +324,7 @@ cmd_status_t cmd_handle_putval(FILE *fh, char *buffer) {
     return CMD_UNKNOWN_COMMAND;
   }
 
-  for (size_t i = 0; i < cmd.cmd.putval.vl_num; ++i)
-    plugin_dispatch_values(&cmd.cmd.putval.vl[i]);
+  plugin_dispatch_values_batch(cmd.cmd.putval.vl, cmd.cmd.putval.vl_num);
 
   if (fh != stdout)
     cmd_error(CMD_OK, &err, "Success: %i %s been dispatched.",
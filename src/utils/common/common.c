@@ -370,6 +370,51 @@ int strjoin(char *buffer, size_t buffer_size, char **fields, size_t fields_num,
   return (int)buffer_req;
 }
 
+#define STRSPAN_ONES UINT64_C(0x0101010101010101)
+#define STRSPAN_HIGHS UINT64_C(0x8080808080808080)
+
+/* Non-zero if a byte of "x" is below "n", which must be at most 0x80. Only
+ * words in which a byte is below "n" are flagged. */
+static inline uint64_t strspan_has_less(uint64_t x, unsigned char n) {
+  return (x - STRSPAN_ONES * n) & ~x & STRSPAN_HIGHS;
+} /* uint64_t strspan_has_less */
+
+size_t strspan_plain(char const *s, size_t len, char const *specials,
+                     bool control) {
+  uint64_t patterns[4];
+  size_t patterns_num = 0;
+  while ((patterns_num < STATIC_ARRAY_SIZE(patterns)) &&
+         (specials[patterns_num] != 0)) {
+    patterns[patterns_num] =
+        STRSPAN_ONES * (unsigned char)specials[patterns_num];
+    patterns_num++;
+  }
+
+  /* Skip the words without special bytes, then find the byte in the word. */
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, s + i, sizeof(w));
+
+    uint64_t hit = control ? strspan_has_less(w, 0x20) : 0;
+    for (size_t j = 0; j < patterns_num; j++)
+      hit |= strspan_has_less(w ^ patterns[j], 1);
+    if (hit != 0)
+      break;
+  }
+
+  for (; i < len; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (control && (c < 0x20))
+      return i;
+    for (size_t j = 0; j < patterns_num; j++)
+      if (c == (unsigned char)specials[j])
+        return i;
+  }
+
+  return len;
+} /* size_t strspan_plain */
+
 int escape_string(char *buffer, size_t buffer_size) {
   char *temp;
   size_t j;
@@ -483,10 +528,12 @@ int escape_slashes(char *buffer, size_t buffer_size) {
     buffer_len--;
   }
 
-  for (size_t i = 0; i < buffer_len; i++) {
-    if (buffer[i] == '/')
-      buffer[i] = '_';
-  }
+  /* This runs for every part of every identifier dispatched. Most have no
+   * slashes at all, which memchr(3) finds out fastest. */
+  char *end = buffer + buffer_len;
+  for (char *p = memchr(buffer, '/', buffer_len); p != NULL;
+       p = memchr(p, '/', (size_t)(end - p)))
+    *(p++) = '_';
 
   return 0;
 } /* int escape_slashes */
@@ -861,6 +908,19 @@ int format_name(char *ret, int ret_len, const char *hostname,
   return 0;
 } /* int format_name */
 
+int format_vl(char *ret, size_t ret_len, value_list_t const *vl) {
+  if (vl->ident != NULL) {
+    size_t len = strlen(vl->ident->name);
+    if (len >= ret_len)
+      return ENOBUFS;
+    memcpy(ret, vl->ident->name, len + 1);
+    return 0;
+  }
+
+  return format_name(ret, (int)ret_len, vl->host, vl->plugin,
+                     vl->plugin_instance, vl->type, vl->type_instance);
+} /* int format_vl */
+
 int format_values(char *ret, size_t ret_len, /* {{{ */
                   const data_set_t *ds, const value_list_t *vl,
                   bool store_rates) {
@@ -1057,34 +1117,141 @@ int parse_value(const char *value_orig, value_t *ret_value, int ds_type) {
   return 0;
 } /* int parse_value */
 
+/* parse_uint_fast parses a plain decimal number. It returns false for
+ * anything else, including hexadecimal and octal numbers and numbers that may
+ * overflow, which are left to strtoull(3) and friends. */
+static bool parse_uint_fast(char const *str, uint64_t *ret) /* {{{ */
+{
+  uint64_t v = 0;
+
+  if ((str[0] == 0) || ((str[0] == '0') && (str[1] != 0)))
+    return false;
+
+  for (char const *c = str; *c != 0; c++) {
+    if ((*c < '0') || (*c > '9') || (v > (UINT64_MAX - 9) / 10))
+      return false;
+    v = 10 * v + (uint64_t)(*c - '0');
+  }
+
+  *ret = v;
+  return true;
+} /* }}} bool parse_uint_fast */
+
+/* parse_double_fast parses a plain decimal number such as "-12.375". The
+ * digits are accumulated into an integer that is exactly representable as a
+ * double and divided by an exact power of ten, so that the result is
+ * correctly rounded, i.e. identical to what strtod(3) returns. Anything else
+ * returns false. */
+static bool parse_double_fast(char const *str, double *ret) /* {{{ */
+{
+  static double const pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  uint64_t mantissa = 0;
+  size_t digits = 0;
+  size_t frac = 0;
+  bool dot = false;
+  bool negative = false;
+  char const *c = str;
+
+  if ((*c == '-') || (*c == '+')) {
+    negative = (*c == '-');
+    c++;
+  }
+
+  for (; *c != 0; c++) {
+    if ((*c == '.') && !dot) {
+      dot = true;
+      continue;
+    }
+    if ((*c < '0') || (*c > '9') ||
+        (mantissa > ((UINT64_C(1) << 53) - 10) / 10))
+      return false;
+    mantissa = 10 * mantissa + (uint64_t)(*c - '0');
+    digits++;
+    if (dot)
+      frac++;
+  }
+
+  if ((digits == 0) || (frac >= STATIC_ARRAY_SIZE(pow10)))
+    return false;
+
+  double v = (double)mantissa / pow10[frac];
+  *ret = negative ? -v : v;
+  return true;
+} /* }}} bool parse_double_fast */
+
+static bool parse_value_fast(char const *str, value_t *ret_value, /* {{{ */
+                             int ds_type) {
+  uint64_t u;
+
+  switch (ds_type) {
+  case DS_TYPE_GAUGE:
+    return parse_double_fast(str, &ret_value->gauge);
+
+  case DS_TYPE_DERIVE:
+    if (str[0] == '-') {
+      if (!parse_uint_fast(str + 1, &u) || (u > (uint64_t)INT64_MAX))
+        return false;
+      ret_value->derive = -(derive_t)u;
+      return true;
+    }
+    if (!parse_uint_fast(str, &u) || (u > (uint64_t)INT64_MAX))
+      return false;
+    ret_value->derive = (derive_t)u;
+    return true;
+
+  case DS_TYPE_COUNTER:
+    if (!parse_uint_fast(str, &u))
+      return false;
+    ret_value->counter = (counter_t)u;
+    return true;
+
+  case DS_TYPE_ABSOLUTE:
+    if (!parse_uint_fast(str, &u))
+      return false;
+    ret_value->absolute = (absolute_t)u;
+    return true;
+  }
+
+  return false;
+} /* }}} bool parse_value_fast */
+
+/* parse_values splits `buffer' at colons in a single pass. Plain decimal
+ * numbers are parsed by the fast path above; everything else goes through
+ * strtod(3) and parse_value(), so both paths accept the same input. Like
+ * strtok_r(3), which was used before, empty fields are skipped. */
 int parse_values(char *buffer, value_list_t *vl, const data_set_t *ds) {
-  size_t i;
-  char *dummy;
+  size_t i = 0;
   char *ptr;
-  char *saveptr;
 
   if ((buffer == NULL) || (vl == NULL) || (ds == NULL))
     return EINVAL;
 
-  i = 0;
-  dummy = buffer;
-  saveptr = NULL;
   vl->time = 0;
-  while ((ptr = strtok_r(dummy, ":", &saveptr)) != NULL) {
-    dummy = NULL;
-
-    if (i >= vl->values_len) {
-      /* Make sure i is invalid. */
-      i = 0;
-      break;
+  ptr = buffer;
+  while (*ptr != 0) {
+    char *end = ptr;
+    while ((*end != 0) && (*end != ':'))
+      end++;
+
+    char *next = (*end == 0) ? end : end + 1;
+    *end = 0;
+    if (end == ptr) {
+      ptr = next;
+      continue;
     }
 
     if (vl->time == 0) {
-      if (strcmp("N", ptr) == 0)
+      double tmp;
+
+      if ((ptr[0] == 'N') && (ptr[1] == 0))
         vl->time = cdtime();
+      else if (parse_double_fast(ptr, &tmp))
+        vl->time = DOUBLE_TO_CDTIME_T(tmp);
       else {
         char *endptr = NULL;
-        double tmp;
 
         errno = 0;
         tmp = strtod(ptr, &endptr);
@@ -1097,18 +1264,25 @@ int parse_values(char *buffer, value_list_t *vl, const data_set_t *ds) {
         vl->time = DOUBLE_TO_CDTIME_T(tmp);
       }
 
+      ptr = next;
       continue;
     }
 
-    if ((strcmp("U", ptr) == 0) && (ds->ds[i].type == DS_TYPE_GAUGE))
+    if (i >= vl->values_len)
+      return -1;
+
+    if ((ptr[0] == 'U') && (ptr[1] == 0) &&
+        (ds->ds[i].type == DS_TYPE_GAUGE))
       vl->values[i].gauge = NAN;
-    else if (0 != parse_value(ptr, &vl->values[i], ds->ds[i].type))
+    else if (!parse_value_fast(ptr, &vl->values[i], ds->ds[i].type) &&
+             (parse_value(ptr, &vl->values[i], ds->ds[i].type) != 0))
       return -1;
 
     i++;
-  } /* while (strtok_r) */
+    ptr = next;
+  }
 
-  if ((ptr != NULL) || (i == 0))
+  if (i == 0)
     return -1;
   return 0;
 } /* int parse_values */
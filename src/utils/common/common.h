@@ -190,6 +190,20 @@ int strjoin(char *dst, size_t dst_len, char **fields, size_t fields_num,
  */
 int escape_slashes(char *buffer, size_t buffer_size);
 
+/*
+ * NAME
+ *   strspan_plain
+ *
+ * DESCRIPTION
+ *   Returns the number of bytes at the start of the "len" bytes at "s" which
+ *   need no escaping: which are none of the up to four bytes in the string
+ *   "specials" and, if "control" is true, no control characters (below 0x20).
+ *   Returns "len" if no byte needs escaping. Eight bytes are checked at a time,
+ *   so that escaping functions can copy the plain parts of a string in bulk.
+ */
+size_t strspan_plain(char const *s, size_t len, char const *specials,
+                     bool control);
+
 /**
  * NAME
  *   escape_string
@@ -315,9 +329,9 @@ double htond(double d);
 int format_name(char *ret, int ret_len, const char *hostname,
                 const char *plugin, const char *plugin_instance,
                 const char *type, const char *type_instance);
-#define FORMAT_VL(ret, ret_len, vl)                                            \
-  format_name(ret, ret_len, (vl)->host, (vl)->plugin, (vl)->plugin_instance,   \
-              (vl)->type, (vl)->type_instance)
+/* Like format_name, but uses the interned identifier of `vl' if it has one. */
+int format_vl(char *ret, size_t ret_len, value_list_t const *vl);
+#define FORMAT_VL(ret, ret_len, vl) format_vl(ret, ret_len, vl)
 int format_values(char *ret, size_t ret_len, const data_set_t *ds,
                   const value_list_t *vl, bool store_rates);
 
@@ -0,0 +1,171 @@
+/**
+ * collectd - src/utils/common/common_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the identifier and value formatting and parsing
+ * functions. Build with "make bench_common"; the optional argument is the
+ * number of operations, 1000000 by default. */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils/common/common.h"
+
+static data_source_t dsrc[] = {
+    {"rx", DS_TYPE_DERIVE, 0, NAN},
+    {"tx", DS_TYPE_DERIVE, 0, NAN},
+};
+static data_set_t ds = {"if_octets", STATIC_ARRAY_SIZE(dsrc), dsrc};
+
+static void init_value_list(value_list_t *vl, value_t *values) {
+  *vl = (value_list_t){
+      .values = values,
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T(1480063672),
+      .interval = TIME_T_TO_CDTIME_T(10),
+  };
+  sstrncpy(vl->host, "host.example.com", sizeof(vl->host));
+  sstrncpy(vl->plugin, "interface", sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, "eth0", sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, "if_octets", sizeof(vl->type));
+}
+
+DEF_BENCH(format_name) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (format_name(buffer, sizeof(buffer), "host.example.com", "interface",
+                    "eth0", "if_octets", "") != 0)
+      return -1;
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(FORMAT_VL) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  value_t values[2] = {{.derive = 1}, {.derive = 2}};
+  value_list_t vl;
+  init_value_list(&vl, values);
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (FORMAT_VL(buffer, sizeof(buffer), &vl) != 0)
+      return -1;
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(format_values) {
+  char buffer[512];
+  value_t values[2] = {{.derive = 1}, {.derive = 2}};
+  value_list_t vl;
+  init_value_list(&vl, values);
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    values[0].derive = (derive_t)i;
+    values[1].derive = (derive_t)(2 * i);
+    if (format_values(buffer, sizeof(buffer), &ds, &vl,
+                      /* store_rates = */ false) != 0)
+      return -1;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+/* The identifier parts are escaped by plugin_dispatch_values(). */
+DEF_BENCH(escape_slashes) {
+  char buffer[DATA_MAX_NAME_LEN];
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    sstrncpy(buffer, "kubernetes-pod-frontend-7d9f8b6c5-x2x9q", sizeof(buffer));
+    if (escape_slashes(buffer, sizeof(buffer)) != 0)
+      return -1;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(strspan_plain) {
+  char const str[] = "host.example.com/interface-eth0/if_octets-rx-tx";
+  size_t len = strlen(str);
+  size_t sum = 0;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    sum += strspan_plain(str, len, "\"\\", /* control = */ true);
+  BENCH_STOP;
+
+  return (sum == ops * len) ? 0 : -1;
+}
+
+DEF_BENCH(parse_values) {
+  char input[] = "1480063672.123:12345678:987654321";
+  char buffer[sizeof(input)];
+  value_t values[2];
+  value_list_t vl;
+  init_value_list(&vl, values);
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    /* parse_values modifies its input. */
+    memcpy(buffer, input, sizeof(input));
+    if (parse_values(buffer, &vl, &ds) != 0)
+      return -1;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(parse_identifier_vl) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++)
+    if (parse_identifier_vl("host.example.com/interface-eth0/if_octets", &vl) !=
+        0)
+      return -1;
+  BENCH_STOP;
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t ops = BENCH_OPS(argc, argv, 1000000);
+
+  RUN_BENCH(format_name, ops);
+  RUN_BENCH(FORMAT_VL, ops);
+  RUN_BENCH(format_values, ops);
+  RUN_BENCH(escape_slashes, ops);
+  RUN_BENCH(strspan_plain, ops);
+  RUN_BENCH(parse_values, ops);
+  RUN_BENCH(parse_identifier_vl, ops);
+
+  END_BENCH;
+}
@@ -187,6 +187,7 @@ DEF_TEST(escape_slashes) {
       {"/like/a/path", "like_a_path"},
       {"trailing/slash/", "trailing_slash_"},
       {"foo//bar", "foo__bar"},
+      {"no slashes in here at all", "no slashes in here at all"},
   };
 
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
@@ -200,6 +201,41 @@ DEF_TEST(escape_slashes) {
   return 0;
 }
 
+DEF_TEST(strspan_plain) {
+  char buffer[40];
+
+  /* Every special byte at every position, to cover both the words and the
+   * remaining bytes. */
+  char const specials[] = {'"', '\\', '\n', 0x01, 0x1f};
+  for (size_t len = 0; len < sizeof(buffer); len++) {
+    memset(buffer, 'a', len);
+    EXPECT_EQ_UINT64(len, strspan_plain(buffer, len, "\"\\", true));
+
+    for (size_t pos = 0; pos < len; pos++) {
+      for (size_t i = 0; i < STATIC_ARRAY_SIZE(specials); i++) {
+        memset(buffer, 'a', len);
+        buffer[pos] = specials[i];
+
+        bool control = ((unsigned char)specials[i] < 0x20);
+        size_t want = control ? pos : len;
+        if ((specials[i] == '"') || (specials[i] == '\\'))
+          want = pos;
+        EXPECT_EQ_UINT64(want, strspan_plain(buffer, len, "\"\\", true));
+        want = (strchr("\"\\\n", specials[i]) != NULL) ? pos : len;
+        EXPECT_EQ_UINT64(want, strspan_plain(buffer, len, "\"\\\n", false));
+      }
+    }
+  }
+
+  /* Bytes with the high bit set are neither special nor control characters. */
+  memset(buffer, 0xe4, 16);
+  EXPECT_EQ_UINT64(16, strspan_plain(buffer, 16, " .", true));
+  buffer[9] = '.';
+  EXPECT_EQ_UINT64(9, strspan_plain(buffer, 16, " .", true));
+
+  return 0;
+}
+
 DEF_TEST(escape_string) {
   struct {
     char *str;
@@ -311,6 +347,60 @@ DEF_TEST(parse_values) {
   return 0;
 }
 
+DEF_TEST(parse_values_types) {
+  data_source_t dsrc[] = {
+      {"g", DS_TYPE_GAUGE, NAN, NAN},
+      {"d", DS_TYPE_DERIVE, NAN, NAN},
+      {"c", DS_TYPE_COUNTER, NAN, NAN},
+      {"a", DS_TYPE_ABSOLUTE, NAN, NAN},
+  };
+  data_set_t ds = {"example", STATIC_ARRAY_SIZE(dsrc), dsrc};
+  struct {
+    char buffer[128];
+    int status;
+    gauge_t gauge;
+    derive_t derive;
+    counter_t counter;
+    absolute_t absolute;
+  } cases[] = {
+      /* plain decimal numbers take the fast path */
+      {"1435044576.5:0.1:-42:18446744073709551615:7", 0, 0.1, -42,
+       18446744073709551615ULL, 7},
+      {"N:-12.375:+5:0:0", 0, -12.375, 5, 0, 0},
+      /* everything else falls back to strtod(3) and friends */
+      {"N:1.5e3:0x10:010:9223372036854775807", 0, 1500.0, 16, 8,
+       9223372036854775807ULL},
+      {"N:0.00000000000000000000000001:-9223372036854775808:1:1", 0, 1e-26,
+       INT64_MIN, 1, 1},
+      {"N:12345678901234567890.5:1:1:1", 0, 12345678901234567890.5, 1, 1, 1},
+      /* empty fields are skipped */
+      {"N::1:2::3:4", 0, 1.0, 2, 3, 4},
+      {"N:1:2:3:4:5", -1, NAN, 0, 0, 0},
+      {"N:1:x:3:4", -1, NAN, 0, 0, 0},
+      {"", -1, NAN, 0, 0, 0},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    value_t v[4] = {{0}};
+    value_list_t vl = {
+        .values = v, .values_len = STATIC_ARRAY_SIZE(v),
+    };
+
+    printf("## Case %" PRIsz ": \"%s\"\n", i, cases[i].buffer);
+    int status = parse_values(cases[i].buffer, &vl, &ds);
+    EXPECT_EQ_INT(cases[i].status, status);
+    if (status != 0)
+      continue;
+
+    EXPECT_EQ_DOUBLE(cases[i].gauge, v[0].gauge);
+    EXPECT_EQ_UINT64((uint64_t)cases[i].derive, (uint64_t)v[1].derive);
+    EXPECT_EQ_UINT64(cases[i].counter, v[2].counter);
+    EXPECT_EQ_UINT64(cases[i].absolute, v[3].absolute);
+  }
+
+  return 0;
+}
+
 DEF_TEST(value_to_rate) {
   struct {
     time_t t0;
@@ -369,9 +459,11 @@ int main(void) {
   RUN_TEST(strsplit);
   RUN_TEST(strjoin);
   RUN_TEST(escape_slashes);
+  RUN_TEST(strspan_plain);
   RUN_TEST(escape_string);
   RUN_TEST(strunescape);
   RUN_TEST(parse_values);
+  RUN_TEST(parse_values_types);
   RUN_TEST(value_to_rate);
 
   END_TEST;
@@ -0,0 +1,319 @@
+/**
+ * collectd - src/utils/curl_fetch/curl_fetch.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/curl_fetch/curl_fetch.h"
+
+struct curl_fetch_req_s;
+typedef struct curl_fetch_req_s curl_fetch_req_t;
+struct curl_fetch_req_s {
+  CURL *curl;
+  curl_fetch_write_cb write;
+  curl_fetch_done_cb done;
+  void *user_data;
+  plugin_ctx_t ctx;
+
+  curl_fetch_req_t *next;
+};
+
+struct curl_fetch_s {
+  char *name;
+  CURLM *multi;
+
+  pthread_t thread;
+  bool thread_running;
+  /* Written to by curl_fetch_submit to interrupt curl_multi_wait. */
+  int wakeup[2];
+
+  pthread_mutex_t lock;
+  bool shutdown;
+  /* Submitted, but not added to "multi" yet. */
+  curl_fetch_req_t *pending;
+  /* Added to "multi", or done and waiting for their callback to return. */
+  curl_fetch_req_t *active;
+};
+
+static size_t curl_fetch_write(void *buf, size_t size, /* {{{ */
+                               size_t nmemb, void *arg) {
+  curl_fetch_req_t *req = arg;
+
+  plugin_set_ctx(req->ctx);
+  return req->write(buf, size, nmemb, req->user_data);
+} /* }}} size_t curl_fetch_write */
+
+static void curl_fetch_req_unlink(curl_fetch_req_t **list, /* {{{ */
+                                  curl_fetch_req_t *req) {
+  for (curl_fetch_req_t **ptr = list; *ptr != NULL; ptr = &(*ptr)->next) {
+    if (*ptr == req) {
+      *ptr = req->next;
+      req->next = NULL;
+      return;
+    }
+  }
+} /* }}} void curl_fetch_req_unlink */
+
+/* curl_fetch_req_done calls the callback of a transfer that is no longer
+ * added to the multi handle. The request is kept in "list" until the callback
+ * returns, so that the handle cannot be submitted again while the callback
+ * still uses it. */
+static void curl_fetch_req_done(curl_fetch_t *f, /* {{{ */
+                                curl_fetch_req_t **list, curl_fetch_req_t *req,
+                                CURLcode status) {
+  plugin_set_ctx(req->ctx);
+  req->done(req->curl, status, req->user_data);
+
+  if (list != NULL) {
+    pthread_mutex_lock(&f->lock);
+    curl_fetch_req_unlink(list, req);
+    pthread_mutex_unlock(&f->lock);
+  }
+  sfree(req);
+} /* }}} void curl_fetch_req_done */
+
+/* curl_fetch_add_pending moves the submitted transfers to the multi handle.
+ * Transfers that cannot be added are returned, so that their callbacks can
+ * be called without holding the lock. Must hold f->lock when calling. */
+static curl_fetch_req_t *curl_fetch_add_pending(curl_fetch_t *f) /* {{{ */
+{
+  curl_fetch_req_t *failed = NULL;
+
+  while (f->pending != NULL) {
+    curl_fetch_req_t *req = f->pending;
+    f->pending = req->next;
+
+    CURLMcode status = curl_multi_add_handle(f->multi, req->curl);
+    if (status != CURLM_OK) {
+      ERROR("%s plugin: curl_multi_add_handle failed: %s", f->name,
+            curl_multi_strerror(status));
+      req->next = failed;
+      failed = req;
+      continue;
+    }
+
+    req->next = f->active;
+    f->active = req;
+  }
+
+  return failed;
+} /* }}} curl_fetch_req_t *curl_fetch_add_pending */
+
+static void *curl_fetch_thread(void *arg) /* {{{ */
+{
+  curl_fetch_t *f = arg;
+
+  while (42) {
+    pthread_mutex_lock(&f->lock);
+    if (f->shutdown) {
+      pthread_mutex_unlock(&f->lock);
+      break;
+    }
+    curl_fetch_req_t *failed = curl_fetch_add_pending(f);
+    pthread_mutex_unlock(&f->lock);
+
+    /* Failed requests are in neither list, so the handle may be submitted
+     * again as soon as the callback has been called. */
+    while (failed != NULL) {
+      curl_fetch_req_t *req = failed;
+      failed = req->next;
+      curl_fetch_req_done(f, /* list = */ NULL, req, CURLE_FAILED_INIT);
+    }
+
+    int running = 0;
+    curl_multi_perform(f->multi, &running);
+
+    CURLMsg *msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(f->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      /* "msg" is invalid after removing the handle. */
+      CURL *curl = msg->easy_handle;
+      CURLcode status = msg->data.result;
+
+      char *priv = NULL;
+      curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+      curl_fetch_req_t *req = (void *)priv;
+      curl_multi_remove_handle(f->multi, curl);
+
+      curl_fetch_req_done(f, &f->active, req, status);
+    }
+
+    struct curl_waitfd wakeup = {
+        .fd = f->wakeup[0], .events = CURL_WAIT_POLLIN,
+    };
+    curl_multi_wait(f->multi, &wakeup, /* extra_nfds = */ 1,
+                    /* timeout_ms = */ 1000, /* numfds = */ NULL);
+    if (wakeup.revents != 0) {
+      char buffer[64];
+      while (read(f->wakeup[0], buffer, sizeof(buffer)) > 0)
+        /* do nothing */;
+    }
+  } /* while (42) */
+
+  return NULL;
+} /* }}} void *curl_fetch_thread */
+
+static void curl_fetch_wakeup(curl_fetch_t *f) /* {{{ */
+{
+  /* The pipe is non-blocking; if it is full, the thread wakes up anyway. */
+  if ((write(f->wakeup[1], "", 1) < 0) && (errno != EAGAIN))
+    WARNING("%s plugin: Waking up the fetch thread failed: %s", f->name,
+            STRERRNO);
+} /* }}} void curl_fetch_wakeup */
+
+curl_fetch_t *curl_fetch_create(char const *name, /* {{{ */
+                                long max_connections) {
+  curl_fetch_t *f = calloc(1, sizeof(*f));
+  if (f == NULL) {
+    ERROR("%s plugin: calloc failed.", name);
+    return NULL;
+  }
+  f->wakeup[0] = f->wakeup[1] = -1;
+  pthread_mutex_init(&f->lock, NULL);
+
+  f->name = strdup(name);
+  if (f->name == NULL) {
+    ERROR("%s plugin: strdup failed.", name);
+    curl_fetch_destroy(f);
+    return NULL;
+  }
+
+  if (pipe(f->wakeup) != 0) {
+    ERROR("%s plugin: pipe failed: %s", name, STRERRNO);
+    f->wakeup[0] = f->wakeup[1] = -1;
+    curl_fetch_destroy(f);
+    return NULL;
+  }
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(f->wakeup); i++)
+    fcntl(f->wakeup[i], F_SETFL, fcntl(f->wakeup[i], F_GETFL) | O_NONBLOCK);
+
+  f->multi = curl_multi_init();
+  if (f->multi == NULL) {
+    ERROR("%s plugin: curl_multi_init failed.", name);
+    curl_fetch_destroy(f);
+    return NULL;
+  }
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt(f->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071e00
+  if (max_connections > 0)
+    curl_multi_setopt(f->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                      max_connections);
+#endif
+  if (max_connections > 0)
+    curl_multi_setopt(f->multi, CURLMOPT_MAXCONNECTS, max_connections);
+
+  int status = plugin_thread_create(&f->thread, /* attr = */ NULL,
+                                    curl_fetch_thread, f, name);
+  if (status != 0) {
+    ERROR("%s plugin: Starting the fetch thread failed: %s", name,
+          STRERROR(status));
+    curl_fetch_destroy(f);
+    return NULL;
+  }
+  f->thread_running = true;
+
+  return f;
+} /* }}} curl_fetch_t *curl_fetch_create */
+
+void curl_fetch_destroy(curl_fetch_t *f) /* {{{ */
+{
+  if (f == NULL)
+    return;
+
+  if (f->thread_running) {
+    pthread_mutex_lock(&f->lock);
+    f->shutdown = true;
+    pthread_mutex_unlock(&f->lock);
+    curl_fetch_wakeup(f);
+
+    pthread_join(f->thread, NULL);
+    f->thread_running = false;
+  }
+
+  while (f->active != NULL) {
+    curl_fetch_req_t *req = f->active;
+    f->active = req->next;
+    curl_multi_remove_handle(f->multi, req->curl);
+    sfree(req);
+  }
+  while (f->pending != NULL) {
+    curl_fetch_req_t *req = f->pending;
+    f->pending = req->next;
+    sfree(req);
+  }
+
+  if (f->multi != NULL)
+    curl_multi_cleanup(f->multi);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(f->wakeup); i++)
+    if (f->wakeup[i] >= 0)
+      close(f->wakeup[i]);
+  pthread_mutex_destroy(&f->lock);
+
+  sfree(f->name);
+  sfree(f);
+} /* }}} void curl_fetch_destroy */
+
+int curl_fetch_submit(curl_fetch_t *f, CURL *curl, /* {{{ */
+                      curl_fetch_write_cb write, curl_fetch_done_cb done,
+                      void *user_data) {
+  if ((f == NULL) || (curl == NULL) || (write == NULL) || (done == NULL))
+    return EINVAL;
+
+  curl_fetch_req_t *req = calloc(1, sizeof(*req));
+  if (req == NULL)
+    return ENOMEM;
+  req->curl = curl;
+  req->write = write;
+  req->done = done;
+  req->user_data = user_data;
+  req->ctx = plugin_get_ctx();
+
+  pthread_mutex_lock(&f->lock);
+  curl_fetch_req_t *lists[] = {f->pending, f->active};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+    for (curl_fetch_req_t *ptr = lists[i]; ptr != NULL; ptr = ptr->next) {
+      if (ptr->curl == curl) {
+        pthread_mutex_unlock(&f->lock);
+        sfree(req);
+        return EBUSY;
+      }
+    }
+  }
+
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_fetch_write);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (char *)req);
+
+  req->next = f->pending;
+  f->pending = req;
+  pthread_mutex_unlock(&f->lock);
+
+  curl_fetch_wakeup(f);
+  return 0;
+} /* }}} int curl_fetch_submit */
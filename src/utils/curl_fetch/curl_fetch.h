@@ -0,0 +1,87 @@
+/**
+ * collectd - src/utils/curl_fetch/curl_fetch.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_CURL_FETCH_H
+#define UTILS_CURL_FETCH_H 1
+
+#include <curl/curl.h>
+
+struct curl_fetch_s;
+typedef struct curl_fetch_s curl_fetch_t;
+
+/* Called for each chunk of the response body, like CURLOPT_WRITEFUNCTION. */
+typedef size_t (*curl_fetch_write_cb)(void *buf, size_t size, size_t nmemb,
+                                      void *user_data);
+
+/* Called when the transfer of "curl" has completed with "status". The easy
+ * handle can be submitted again once the callback has returned. */
+typedef void (*curl_fetch_done_cb)(CURL *curl, CURLcode status,
+                                   void *user_data);
+
+/*
+ * NAME
+ *   curl_fetch_create
+ *
+ * DESCRIPTION
+ *   Creates a fetch engine: a thread which performs all submitted transfers
+ *   concurrently using one multi handle, so that connections are reused and
+ *   HTTP/2 requests to the same host are multiplexed over one connection.
+ *   "name" is used for the thread's name and log messages. If
+ *   "max_connections" is greater than zero, at most that many connections
+ *   are opened at the same time; further transfers are queued by libcurl.
+ *
+ * RETURN VALUE
+ *   A curl_fetch_t-pointer upon success or NULL upon failure.
+ */
+curl_fetch_t *curl_fetch_create(char const *name, long max_connections);
+
+/*
+ * NAME
+ *   curl_fetch_destroy
+ *
+ * DESCRIPTION
+ *   Stops the thread and frees the engine. Transfers that have not completed
+ *   yet are aborted without calling their callbacks. Passing NULL is a no-op.
+ */
+void curl_fetch_destroy(curl_fetch_t *f);
+
+/*
+ * NAME
+ *   curl_fetch_submit
+ *
+ * DESCRIPTION
+ *   Hands the configured easy handle "curl" over to the engine. Until
+ *   "done" has been called, the handle belongs to the engine thread, which
+ *   calls "write" and "done" with the plugin context of the caller, so that
+ *   values dispatched from the callbacks get the caller's interval. The
+ *   handle's CURLOPT_WRITEFUNCTION, CURLOPT_WRITEDATA and CURLOPT_PRIVATE are
+ *   overwritten.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EBUSY if "curl" has been submitted before and is not
+ *   done yet, or another errno value upon failure.
+ */
+int curl_fetch_submit(curl_fetch_t *f, CURL *curl, curl_fetch_write_cb write,
+                      curl_fetch_done_cb done, void *user_data);
+
+#endif /* UTILS_CURL_FETCH_H */
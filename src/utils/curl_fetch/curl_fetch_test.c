@@ -0,0 +1,188 @@
+/**
+ * collectd - src/utils/curl_fetch/curl_fetch_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "testing.h"
+#include "utils/curl_fetch/curl_fetch.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define TRANSFERS_NUM 8
+
+typedef struct {
+  CURL *curl;
+  char buffer[64];
+  size_t fill;
+  cdtime_t interval;
+  int done;
+  CURLcode status;
+} transfer_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static size_t test_write(void *buf, size_t size, size_t nmemb, void *ud) {
+  transfer_t *t = ud;
+  size_t len = size * nmemb;
+
+  if (len > sizeof(t->buffer) - 1 - t->fill)
+    return 0;
+  memcpy(t->buffer + t->fill, buf, len);
+  t->fill += len;
+  t->buffer[t->fill] = 0;
+  return len;
+}
+
+static void test_done(CURL *curl, CURLcode status, void *ud) {
+  transfer_t *t = ud;
+
+  pthread_mutex_lock(&lock);
+  t->status = status;
+  /* The callbacks are called with the plugin context of the submitter. */
+  t->interval = plugin_get_interval();
+  t->done++;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+static void wait_done(transfer_t *t, int num) {
+  pthread_mutex_lock(&lock);
+  while (t->done < num)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+/* The handle stays busy until test_done has returned, which may be shortly
+ * after wait_done returned. */
+static int submit_again(curl_fetch_t *f, transfer_t *t) {
+  int status;
+  while ((status = curl_fetch_submit(f, t->curl, test_write, test_done, t)) ==
+         EBUSY)
+    nanosleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+  return status;
+}
+
+DEF_TEST(fetch) {
+  char path[] = "/tmp/collectd_curl_fetch_test.XXXXXX";
+  char url[PATH_MAX];
+  transfer_t t[TRANSFERS_NUM] = {{0}};
+
+  int fd = mkstemp(path);
+  CHECK_NOT_NULL(fd >= 0 ? path : NULL);
+  EXPECT_EQ_INT(5, (int)write(fd, "hello", 5));
+  close(fd);
+  snprintf(url, sizeof(url), "file://%s", path);
+
+  curl_fetch_t *f;
+  CHECK_NOT_NULL(f = curl_fetch_create("test", /* max_connections = */ 2));
+
+  plugin_ctx_t ctx = plugin_get_ctx();
+  ctx.interval = TIME_T_TO_CDTIME_T(42);
+  plugin_ctx_t old_ctx = plugin_set_ctx(ctx);
+
+  for (size_t i = 0; i < TRANSFERS_NUM; i++) {
+    CHECK_NOT_NULL(t[i].curl = curl_easy_init());
+    curl_easy_setopt(t[i].curl, CURLOPT_URL, url);
+    CHECK_ZERO(curl_fetch_submit(f, t[i].curl, test_write, test_done, t + i));
+  }
+
+  plugin_set_ctx(old_ctx);
+
+  for (size_t i = 0; i < TRANSFERS_NUM; i++) {
+    wait_done(t + i, 1);
+    EXPECT_EQ_INT(CURLE_OK, t[i].status);
+    EXPECT_EQ_STR("hello", t[i].buffer);
+    EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(42), t[i].interval);
+  }
+
+  /* A handle can be submitted again once it is done. */
+  t[0].fill = 0;
+  CHECK_ZERO(submit_again(f, t));
+  wait_done(t, 2);
+  EXPECT_EQ_STR("hello", t[0].buffer);
+
+  /* A transfer that fails still calls the callback. */
+  snprintf(url, sizeof(url), "file://%s.missing", path);
+  curl_easy_setopt(t[1].curl, CURLOPT_URL, url);
+  CHECK_ZERO(submit_again(f, t + 1));
+  wait_done(t + 1, 2);
+  OK(t[1].status != CURLE_OK);
+
+  curl_fetch_destroy(f);
+
+  for (size_t i = 0; i < TRANSFERS_NUM; i++)
+    curl_easy_cleanup(t[i].curl);
+  unlink(path);
+  return 0;
+}
+
+DEF_TEST(busy) {
+  curl_fetch_t *f;
+  CHECK_NOT_NULL(f = curl_fetch_create("test", /* max_connections = */ 0));
+
+  /* The kernel accepts the connection, but the server never responds. */
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_NOT_NULL(fd >= 0 ? &fd : NULL);
+  CHECK_ZERO(bind(fd, (struct sockaddr *)&sa, sizeof(sa)));
+  CHECK_ZERO(listen(fd, 1));
+  CHECK_ZERO(getsockname(fd, (struct sockaddr *)&sa, &sa_len));
+
+  char url[64];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/", (int)ntohs(sa.sin_port));
+
+  transfer_t t = {0};
+  CHECK_NOT_NULL(t.curl = curl_easy_init());
+  curl_easy_setopt(t.curl, CURLOPT_URL, url);
+
+  CHECK_ZERO(curl_fetch_submit(f, t.curl, test_write, test_done, &t));
+  EXPECT_EQ_INT(EBUSY,
+                curl_fetch_submit(f, t.curl, test_write, test_done, &t));
+  EXPECT_EQ_INT(EINVAL, curl_fetch_submit(f, t.curl, NULL, test_done, &t));
+
+  /* Transfers in progress are aborted without calling the callback. */
+  curl_fetch_destroy(f);
+  EXPECT_EQ_INT(0, t.done);
+
+  curl_easy_cleanup(t.curl);
+  close(fd);
+  return 0;
+}
+
+int main(void) {
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  RUN_TEST(fetch);
+  RUN_TEST(busy);
+
+  curl_global_cleanup();
+  END_TEST;
+}
@@ -28,10 +28,42 @@
 
 #include "utils/common/common.h"
 #include "utils/curl_stats/curl_stats.h"
+#include "utils/latency/latency.h"
+#include "utils/latency/latency_config.h"
 
 #include <stdbool.h>
 #include <stddef.h>
 
+/* Relative accuracy of the per-endpoint latency sketches. */
+#define CURL_STATS_ACCURACY 0.01
+
+/* The phases of a transfer, see cs_phases_get(). The first three only happen
+ * on a new connection. */
+enum {
+  CS_PHASE_DNS,
+  CS_PHASE_CONNECT,
+  CS_PHASE_TLS,
+  CS_PHASE_TTFB,
+  CS_PHASE_TOTAL,
+  CS_PHASE_NUM,
+};
+
+static char const *const cs_phase_names[CS_PHASE_NUM] = {
+    [CS_PHASE_DNS] = "dns",   [CS_PHASE_CONNECT] = "connect",
+    [CS_PHASE_TLS] = "tls",   [CS_PHASE_TTFB] = "ttfb",
+    [CS_PHASE_TOTAL] = "total",
+};
+
+typedef struct cs_endpoint_s {
+  char name[DATA_MAX_NAME_LEN];
+  latency_counter_t *phases[CS_PHASE_NUM];
+  uint64_t transfers;
+  uint64_t reused;
+  /* Set once the names that are too long have been warned about. */
+  bool truncated;
+  struct cs_endpoint_s *next;
+} cs_endpoint_t;
+
 struct curl_stats_s {
   bool total_time;
   bool namelookup_time;
@@ -50,6 +82,14 @@ struct curl_stats_s {
   bool redirect_count;
   bool num_connects;
   bool appconnect_time;
+
+  /* Latency aggregation, enabled by a "Latency" block. The aggregates of an
+   * interval are dispatched with the first transfer after it ended. */
+  latency_config_t latency;
+  cdtime_t interval;
+  pthread_mutex_t lock;
+  cdtime_t window_start;
+  cs_endpoint_t *endpoints;
 };
 
 /*
@@ -165,6 +205,231 @@ static bool field_enabled(curl_stats_t *s, size_t offset) {
   return *(bool *)((char *)s + offset);
 } /* field_enabled */
 
+static bool latency_enabled(curl_stats_t *s) {
+  return (s->latency.percentile_num > 0) || (s->latency.buckets_num > 0);
+} /* latency_enabled */
+
+static curl_stats_t *curl_stats_alloc(void) {
+  curl_stats_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->interval = plugin_get_interval();
+  pthread_mutex_init(&s->lock, /* attr = */ NULL);
+  return s;
+} /* curl_stats_alloc */
+
+/* Stores "host[:port]" of the effective URL as the endpoint name, with
+ * characters that are special in identifiers replaced. URLs without a host,
+ * e.g. "file:///", are named "localhost". */
+static void endpoint_name(CURL *curl, char *buffer, size_t buffer_size) {
+  char *url = NULL;
+
+  sstrncpy(buffer, "unknown", buffer_size);
+  if ((curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url) != CURLE_OK) ||
+      (url == NULL))
+    return;
+
+  char const *host = strstr(url, "://");
+  host = (host == NULL) ? url : host + strlen("://");
+
+  size_t len = strcspn(host, "/?#");
+  char const *at = memchr(host, '@', len);
+  if (at != NULL) {
+    len -= (size_t)(at + 1 - host);
+    host = at + 1;
+  }
+  if (len == 0) {
+    sstrncpy(buffer, "localhost", buffer_size);
+    return;
+  }
+
+  if (len >= buffer_size)
+    len = buffer_size - 1;
+  memcpy(buffer, host, len);
+  buffer[len] = 0;
+
+  for (char *c = buffer; *c != 0; c++)
+    if ((*c == ':') || (*c == '/') || (*c == '-') || (*c == '[') ||
+        (*c == ']'))
+      *c = '_';
+} /* endpoint_name */
+
+static double info_double(CURL *curl, CURLINFO info) {
+  double v = 0.0;
+  if (curl_easy_getinfo(curl, info, &v) != CURLE_OK)
+    return 0.0;
+  return v;
+} /* info_double */
+
+/* Splits the cumulative cURL timers into the duration of each phase. Phases
+ * that did not happen are set to a negative value. */
+static void cs_phases_get(CURL *curl, double phases[CS_PHASE_NUM],
+                          bool *reused) {
+  long connects = 0;
+  if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects) != CURLE_OK)
+    connects = 0;
+  *reused = (connects == 0);
+
+  double namelookup = info_double(curl, CURLINFO_NAMELOOKUP_TIME);
+  double connect = info_double(curl, CURLINFO_CONNECT_TIME);
+  double appconnect = 0.0;
+#ifdef HAVE_CURLINFO_APPCONNECT_TIME
+  appconnect = info_double(curl, CURLINFO_APPCONNECT_TIME);
+#endif
+  double pretransfer = info_double(curl, CURLINFO_PRETRANSFER_TIME);
+  double starttransfer = info_double(curl, CURLINFO_STARTTRANSFER_TIME);
+
+  for (size_t i = 0; i < CS_PHASE_NUM; i++)
+    phases[i] = -1.0;
+
+  if (!*reused) {
+    phases[CS_PHASE_DNS] = namelookup;
+    if (connect > 0.0)
+      phases[CS_PHASE_CONNECT] = connect - namelookup;
+    if (appconnect > 0.0)
+      phases[CS_PHASE_TLS] = appconnect - connect;
+  }
+  if (starttransfer > 0.0)
+    phases[CS_PHASE_TTFB] = starttransfer - pretransfer;
+  phases[CS_PHASE_TOTAL] = info_double(curl, CURLINFO_TOTAL_TIME);
+} /* cs_phases_get */
+
+static cs_endpoint_t *endpoint_get(curl_stats_t *s, char const *name) {
+  for (cs_endpoint_t *ep = s->endpoints; ep != NULL; ep = ep->next)
+    if (strcmp(ep->name, name) == 0)
+      return ep;
+
+  cs_endpoint_t *ep = calloc(1, sizeof(*ep));
+  if (ep == NULL)
+    return NULL;
+  sstrncpy(ep->name, name, sizeof(ep->name));
+
+  for (size_t i = 0; i < CS_PHASE_NUM; i++) {
+    ep->phases[i] = latency_counter_create_sketch(CURL_STATS_ACCURACY);
+    if (ep->phases[i] == NULL) {
+      for (size_t j = 0; j < i; j++)
+        latency_counter_destroy(ep->phases[j]);
+      free(ep);
+      return NULL;
+    }
+  }
+
+  ep->next = s->endpoints;
+  s->endpoints = ep;
+  return ep;
+} /* endpoint_get */
+
+/* Checks the snprintf result `len' of a type instance of `ep'. Type instances
+ * that don't fit are not dispatched, with one warning per endpoint. */
+static bool endpoint_name_fits(cs_endpoint_t *ep, value_list_t const *vl,
+                               int len) {
+  if ((len >= 0) && ((size_t)len < sizeof(vl->type_instance)))
+    return true;
+
+  if (!ep->truncated) {
+    WARNING("curl stats: The names of the latency metrics of \"%s\" are too "
+            "long. Some of them are not dispatched.",
+            ep->name);
+    ep->truncated = true;
+  }
+  return false;
+} /* endpoint_name_fits */
+
+static void endpoint_dispatch(curl_stats_t *s, cs_endpoint_t *ep,
+                              value_list_t *vl, cdtime_t now) {
+  value_t v;
+
+  vl->values = &v;
+  vl->values_len = 1;
+
+  for (size_t i = 0; i < CS_PHASE_NUM; i++) {
+    latency_counter_t *lc = ep->phases[i];
+    if (latency_counter_get_num(lc) == 0)
+      continue;
+
+    sstrncpy(vl->type, "latency", sizeof(vl->type));
+    for (size_t j = 0; j < s->latency.percentile_num; j++) {
+      double percent = s->latency.percentile[j];
+      v.gauge =
+          CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(lc, percent));
+      int len = snprintf(vl->type_instance, sizeof(vl->type_instance),
+                         "%s-%s-%.5g", ep->name, cs_phase_names[i], percent);
+      if (endpoint_name_fits(ep, vl, len))
+        plugin_dispatch_values(vl);
+    }
+
+    sstrncpy(vl->type,
+             (s->latency.bucket_type != NULL) ? s->latency.bucket_type
+                                              : "bucket",
+             sizeof(vl->type));
+    for (size_t j = 0; j < s->latency.buckets_num; j++) {
+      latency_bucket_t bucket = s->latency.buckets[j];
+      v.gauge = latency_counter_get_rate(lc, bucket.lower_bound,
+                                         bucket.upper_bound, now);
+      int len = snprintf(vl->type_instance, sizeof(vl->type_instance),
+                         "%s-%s-%g_%g", ep->name, cs_phase_names[i],
+                         CDTIME_T_TO_DOUBLE(bucket.lower_bound),
+                         CDTIME_T_TO_DOUBLE(bucket.upper_bound));
+      if (endpoint_name_fits(ep, vl, len))
+        plugin_dispatch_values(vl);
+    }
+  }
+
+  v.gauge = 100.0 * (double)ep->reused / (double)ep->transfers;
+  sstrncpy(vl->type, "percent", sizeof(vl->type));
+  int len = snprintf(vl->type_instance, sizeof(vl->type_instance),
+                     "%s-connection_reuse", ep->name);
+  if (endpoint_name_fits(ep, vl, len))
+    plugin_dispatch_values(vl);
+} /* endpoint_dispatch */
+
+/* Adds the transfer to the aggregates and, once per interval, dispatches and
+ * resets them. plugin_dispatch_values() only enqueues, so this is done while
+ * holding the lock. */
+static void latency_record(curl_stats_t *s, CURL *curl, value_list_t *vl) {
+  char name[DATA_MAX_NAME_LEN];
+  double phases[CS_PHASE_NUM];
+  bool reused;
+
+  endpoint_name(curl, name, sizeof(name));
+  cs_phases_get(curl, phases, &reused);
+
+  cdtime_t now = cdtime();
+
+  pthread_mutex_lock(&s->lock);
+
+  if (s->window_start == 0)
+    s->window_start = now;
+
+  cs_endpoint_t *ep = endpoint_get(s, name);
+  if (ep != NULL) {
+    for (size_t i = 0; i < CS_PHASE_NUM; i++)
+      if (phases[i] >= 0.0)
+        latency_counter_add(ep->phases[i], DOUBLE_TO_CDTIME_T(phases[i]));
+    ep->transfers++;
+    if (reused)
+      ep->reused++;
+  }
+
+  if ((now - s->window_start) >= s->interval) {
+    for (ep = s->endpoints; ep != NULL; ep = ep->next) {
+      if (ep->transfers == 0)
+        continue;
+
+      endpoint_dispatch(s, ep, vl, now);
+
+      for (size_t i = 0; i < CS_PHASE_NUM; i++)
+        latency_counter_reset(ep->phases[i]);
+      ep->transfers = 0;
+      ep->reused = 0;
+    }
+    s->window_start = now;
+  }
+
+  pthread_mutex_unlock(&s->lock);
+} /* latency_record */
+
 /*
  * Public API
  */
@@ -174,7 +439,7 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
   if (ci == NULL)
     return NULL;
 
-  s = calloc(1, sizeof(*s));
+  s = curl_stats_alloc();
   if (s == NULL)
     return NULL;
 
@@ -184,6 +449,14 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
 
     bool enabled = 0;
 
+    if (strcasecmp("Latency", c->key) == 0) {
+      if (latency_config(&s->latency, c) != 0) {
+        curl_stats_destroy(s);
+        return NULL;
+      }
+      continue;
+    }
+
     for (field = 0; field < STATIC_ARRAY_SIZE(field_specs); ++field) {
       if (!strcasecmp(c->key, field_specs[field].config_key))
         break;
@@ -192,12 +465,12 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
     }
     if (field >= STATIC_ARRAY_SIZE(field_specs)) {
       ERROR("curl stats: Unknown field name %s", c->key);
-      free(s);
+      curl_stats_destroy(s);
       return NULL;
     }
 
     if (cf_util_get_boolean(c, &enabled) != 0) {
-      free(s);
+      curl_stats_destroy(s);
       return NULL;
     }
     if (enabled)
@@ -207,9 +480,46 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
   return s;
 } /* curl_stats_from_config */
 
+int curl_stats_add_percentile(curl_stats_t **s, double percent) {
+  if (s == NULL)
+    return EINVAL;
+  if ((percent <= 0.0) || (percent >= 100.0)) {
+    ERROR("curl stats: Percentile must be between 0 and 100, exclusively.");
+    return ERANGE;
+  }
+
+  if (*s == NULL) {
+    *s = curl_stats_alloc();
+    if (*s == NULL)
+      return ENOMEM;
+  }
+
+  double *tmp = realloc((*s)->latency.percentile,
+                        sizeof(*tmp) * ((*s)->latency.percentile_num + 1));
+  if (tmp == NULL)
+    return ENOMEM;
+  (*s)->latency.percentile = tmp;
+  (*s)->latency.percentile[(*s)->latency.percentile_num] = percent;
+  (*s)->latency.percentile_num++;
+
+  return 0;
+} /* curl_stats_add_percentile */
+
 void curl_stats_destroy(curl_stats_t *s) {
-  if (s != NULL)
-    free(s);
+  if (s == NULL)
+    return;
+
+  while (s->endpoints != NULL) {
+    cs_endpoint_t *next = s->endpoints->next;
+    for (size_t i = 0; i < CS_PHASE_NUM; i++)
+      latency_counter_destroy(s->endpoints->phases[i]);
+    free(s->endpoints);
+    s->endpoints = next;
+  }
+
+  latency_config_free(s->latency);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
 } /* curl_stats_destroy */
 
 int curl_stats_dispatch(curl_stats_t *s, CURL *curl, const char *hostname,
@@ -248,5 +558,8 @@ int curl_stats_dispatch(curl_stats_t *s, CURL *curl, const char *hostname,
       return status;
   }
 
+  if (latency_enabled(s))
+    latency_record(s, curl, &vl);
+
   return 0;
 } /* curl_stats_dispatch */
@@ -40,15 +40,27 @@ typedef struct curl_stats_s curl_stats_t;
  * boolean options named after cURL information fields. The boolean value
  * indicates whether to collect the respective information.
  *
+ * A nested "Latency" block takes the "Percentile", "Bucket" and "BucketType"
+ * options of latency_config() and enables the aggregation of the DNS, connect,
+ * TLS, time-to-first-byte and total time of all transfers per endpoint, along
+ * with the ratio of transfers that reused a connection.
+ *
  * See http://curl.haxx.se/libcurl/c/curl_easy_getinfo.html
  */
 curl_stats_t *curl_stats_from_config(oconfig_item_t *ci);
 
+/*
+ * curl_stats_add_percentile enables latency aggregation for plugins without a
+ * "Statistics" block. "*s" is allocated if it is NULL.
+ */
+int curl_stats_add_percentile(curl_stats_t **s, double percent);
+
 void curl_stats_destroy(curl_stats_t *s);
 
 /*
  * curl_stats_dispatch dispatches performance values from the the specified
- * cURL session to the daemon.
+ * cURL session to the daemon. It is to be called after every finished
+ * transfer, including failed ones, and is thread-safe.
  */
 int curl_stats_dispatch(curl_stats_t *s, CURL *curl, const char *hostname,
                         const char *plugin, const char *plugin_instance);
@@ -0,0 +1,134 @@
+/**
+ * collectd - src/utils/curl_stats/curl_stats_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#define plugin_dispatch_values plugin_dispatch_values_curl_stats_test
+
+#include "testing.h"
+#include "utils/curl_stats/curl_stats.c" /* sic */
+
+static char dispatched[64][DATA_MAX_NAME_LEN];
+static size_t dispatched_num;
+
+/* mock functions */
+int plugin_dispatch_values_curl_stats_test(value_list_t const *vl) {
+  if (dispatched_num < STATIC_ARRAY_SIZE(dispatched))
+    sstrncpy(dispatched[dispatched_num++], vl->type_instance,
+             sizeof(dispatched[0]));
+  return 0;
+}
+/* end mock functions */
+
+static bool was_dispatched(char const *type_instance) {
+  for (size_t i = 0; i < dispatched_num; i++)
+    if (strcmp(dispatched[i], type_instance) == 0)
+      return true;
+  return false;
+}
+
+/* Failed transfers are accounted for, too. */
+static int transfer(CURL *curl, curl_stats_t *s, char const *url) {
+  curl_easy_setopt(curl, CURLOPT_URL, url);
+  (void)curl_easy_perform(curl);
+  return curl_stats_dispatch(s, curl, NULL, "test", NULL);
+}
+
+static size_t discard(void *buf, size_t size, size_t nmemb, void *ud) {
+  return size * nmemb;
+}
+
+DEF_TEST(config) {
+  oconfig_value_t pct = {{.number = 99}, OCONFIG_TYPE_NUMBER};
+  oconfig_item_t latency_children[] = {{"Percentile", &pct, 1, NULL, NULL, 0}};
+  oconfig_value_t yes = {{.boolean = 1}, OCONFIG_TYPE_BOOLEAN};
+  oconfig_item_t children[] = {
+      {"TotalTime", &yes, 1, NULL, NULL, 0},
+      {"Latency", NULL, 0, NULL, latency_children, 1},
+  };
+  oconfig_item_t ci = {"Statistics", NULL, 0, NULL, children, 2};
+
+  curl_stats_t *s = curl_stats_from_config(&ci);
+  CHECK_NOT_NULL(s);
+  OK(s->total_time);
+  OK(latency_enabled(s));
+  EXPECT_EQ_DOUBLE(99, s->latency.percentile[0]);
+  curl_stats_destroy(s);
+
+  /* A Latency block needs a percentile or a bucket. */
+  children[1].children_num = 0;
+  OK(curl_stats_from_config(&ci) == NULL);
+
+  s = NULL;
+  EXPECT_EQ_INT(ERANGE, curl_stats_add_percentile(&s, 100));
+  OK(s == NULL);
+  CHECK_ZERO(curl_stats_add_percentile(&s, 50));
+  CHECK_NOT_NULL(s);
+  OK(!s->total_time);
+  OK(latency_enabled(s));
+  curl_stats_destroy(s);
+
+  return 0;
+}
+
+DEF_TEST(aggregate) {
+  curl_stats_t *s = NULL;
+  CHECK_ZERO(curl_stats_add_percentile(&s, 50));
+  CHECK_ZERO(curl_stats_add_percentile(&s, 99));
+
+  CURL *curl = curl_easy_init();
+  CHECK_NOT_NULL(curl);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+
+  /* Nothing is dispatched within the interval. Port 1 is not expected to
+   * accept connections. */
+  CHECK_ZERO(transfer(curl, s, "file:///dev/null"));
+  CHECK_ZERO(transfer(curl, s, "http://user@127.0.0.1:1/path"));
+  EXPECT_EQ_UINT64(0, dispatched_num);
+
+  s->window_start -= s->interval;
+  CHECK_ZERO(transfer(curl, s, "file:///dev/null"));
+  OK(was_dispatched("localhost-total-50"));
+  OK(was_dispatched("localhost-total-99"));
+  OK(was_dispatched("localhost-connection_reuse"));
+  OK(was_dispatched("127.0.0.1_1-total-50"));
+  OK(was_dispatched("127.0.0.1_1-connection_reuse"));
+
+  /* Endpoints without transfers in the last interval are skipped. */
+  dispatched_num = 0;
+  s->window_start -= s->interval;
+  CHECK_ZERO(transfer(curl, s, "file:///dev/null"));
+  OK(was_dispatched("localhost-total-50"));
+  OK(!was_dispatched("127.0.0.1_1-total-50"));
+
+  curl_easy_cleanup(curl);
+  curl_stats_destroy(s);
+  return 0;
+}
+
+int main(void) {
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  RUN_TEST(config);
+  RUN_TEST(aggregate);
+
+  END_TEST;
+}
@@ -30,6 +30,10 @@
 #include "utils/common/common.h"
 #include "utils/db_query/db_query.h"
 
+/* Number of value lists collected per result before they are dispatched with
+ * one call to plugin_dispatch_values_batch. */
+#define UDB_BATCH_SIZE 128
+
 /*
  * Data types
  */
@@ -58,6 +62,9 @@ struct udb_query_s /* {{{ */
   unsigned int min_version;
   unsigned int max_version;
 
+  /* Zero means the interval of the database. */
+  cdtime_t interval;
+
   udb_result_t *results;
 }; /* }}} */
 
@@ -72,6 +79,18 @@ struct udb_result_preparation_area_s /* {{{ */
   char **metadata_buffer;
   char *plugin_instance;
 
+  /* Fields which are the same for all rows of a result set. The type instance
+   * holds the instance prefix, which is `type_instance_prefix_len' bytes
+   * long, and the instances of each row are appended in place. */
+  value_list_t vl_template;
+  size_t type_instance_prefix_len;
+
+  /* Value lists waiting to be dispatched. Kept until the preparation area is
+   * deleted, because the query is run again with the same layout. */
+  value_list_t *batch;
+  value_t *batch_values;
+  size_t batch_num;
+
   struct udb_result_preparation_area_s *next;
 }; /* }}} */
 typedef struct udb_result_preparation_area_s udb_result_preparation_area_t;
@@ -156,115 +175,145 @@ static int udb_config_set_uint(unsigned int *ret_value, /* {{{ */
 /*
  * Result private functions
  */
+/* udb_parse_value handles plain decimal integers, which is what most database
+ * counters look like, without copying the string. Everything else, including
+ * octal and hexadecimal notation, is left to parse_value. */
+static int udb_parse_value(const char *str, value_t *ret_value, /* {{{ */
+                           int ds_type) {
+  const char *ptr = str;
+  bool negative = false;
+  uint64_t value = 0;
+  size_t digits = 0;
+
+  if (*ptr == '-') {
+    negative = true;
+    ptr++;
+  }
+
+  /* 18 digits always fit into an int64_t. */
+  while ((*ptr >= '0') && (*ptr <= '9') && (digits < 18)) {
+    value = 10 * value + (uint64_t)(*ptr - '0');
+    digits++;
+    ptr++;
+  }
+
+  if ((*ptr != 0) || (digits == 0) || ((digits > 1) && (str[negative] == '0')))
+    return parse_value(str, ret_value, ds_type);
+
+  switch (ds_type) {
+  case DS_TYPE_GAUGE:
+    if (negative && (value == 0))
+      return parse_value(str, ret_value, ds_type);
+    ret_value->gauge = negative ? -(gauge_t)value : (gauge_t)value;
+    return 0;
+  case DS_TYPE_DERIVE:
+    ret_value->derive = negative ? -(derive_t)value : (derive_t)value;
+    return 0;
+  case DS_TYPE_COUNTER:
+    if (negative)
+      break;
+    ret_value->counter = (counter_t)value;
+    return 0;
+  case DS_TYPE_ABSOLUTE:
+    if (negative)
+      break;
+    ret_value->absolute = (absolute_t)value;
+    return 0;
+  }
+
+  return parse_value(str, ret_value, ds_type);
+} /* }}} int udb_parse_value */
+
+static void udb_result_flush(udb_result_preparation_area_t *r_area) /* {{{ */
+{
+  if (r_area->batch_num == 0)
+    return;
+
+  plugin_dispatch_values_batch(r_area->batch, r_area->batch_num);
+
+  for (size_t i = 0; i < r_area->batch_num; i++) {
+    meta_data_destroy(r_area->batch[i].meta);
+    r_area->batch[i].meta = NULL;
+  }
+  r_area->batch_num = 0;
+} /* }}} void udb_result_flush */
+
 static int udb_result_submit(udb_result_t *r, /* {{{ */
                              udb_result_preparation_area_t *r_area,
-                             udb_query_t const *q,
-                             udb_query_preparation_area_t *q_area) {
-  value_list_t vl = VALUE_LIST_INIT;
-
+                             udb_query_t const *q) {
   assert(r != NULL);
   assert(r_area->ds != NULL);
   assert(((size_t)r_area->ds->ds_num) == r->values_num);
   assert(r->values_num > 0);
+  assert(r_area->batch_num < UDB_BATCH_SIZE);
 
-  vl.values = calloc(r->values_num, sizeof(*vl.values));
-  if (vl.values == NULL) {
-    P_ERROR("udb_result_submit: calloc failed.");
-    return -1;
-  }
-  vl.values_len = r_area->ds->ds_num;
+  value_list_t *vl = r_area->batch + r_area->batch_num;
+  value_t *values = r_area->batch_values + r_area->batch_num * r->values_num;
 
   for (size_t i = 0; i < r->values_num; i++) {
     char *value_str = r_area->values_buffer[i];
 
-    if (0 != parse_value(value_str, &vl.values[i], r_area->ds->ds[i].type)) {
+    if (0 != udb_parse_value(value_str, &values[i], r_area->ds->ds[i].type)) {
       P_ERROR("udb_result_submit: Parsing `%s' as %s failed.", value_str,
               DS_TYPE_TO_STRING(r_area->ds->ds[i].type));
       errno = EINVAL;
-      free(vl.values);
       return -1;
     }
   }
 
-  sstrncpy(vl.host, q_area->host, sizeof(vl.host));
-  sstrncpy(vl.plugin, q_area->plugin, sizeof(vl.plugin));
-  sstrncpy(vl.type, r->type, sizeof(vl.type));
-
-  /* Set vl.plugin_instance */
-  if (q->plugin_instance_from != NULL) {
-    sstrncpy(vl.plugin_instance, r_area->plugin_instance,
-             sizeof(vl.plugin_instance));
-  } else {
-    sstrncpy(vl.plugin_instance, q_area->db_name, sizeof(vl.plugin_instance));
-  }
-
-  /* Set vl.type_instance {{{ */
-  if (r->instances_num == 0) {
-    if (r->instance_prefix == NULL)
-      vl.type_instance[0] = 0;
-    else
-      sstrncpy(vl.type_instance, r->instance_prefix, sizeof(vl.type_instance));
-  } else /* if ((r->instances_num > 0) */
-  {
-    if (r->instance_prefix == NULL) {
-      int status = strjoin(vl.type_instance, sizeof(vl.type_instance),
-                           r_area->instances_buffer, r->instances_num, "-");
-      if (status < 0) {
-        P_ERROR(
-            "udb_result_submit: creating type_instance failed with status %d.",
-            status);
-        return status;
-      }
-    } else {
-      char tmp[DATA_MAX_NAME_LEN];
-
-      int status = strjoin(tmp, sizeof(tmp), r_area->instances_buffer,
-                           r->instances_num, "-");
-      if (status < 0) {
-        P_ERROR(
-            "udb_result_submit: creating type_instance failed with status %d.",
-            status);
-        return status;
-      }
-      tmp[sizeof(tmp) - 1] = '\0';
-
-      snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-%s",
-               r->instance_prefix, tmp);
+  *vl = r_area->vl_template;
+  vl->values = values;
+
+  /* Set vl->plugin_instance */
+  if (q->plugin_instance_from != NULL)
+    sstrncpy(vl->plugin_instance, r_area->plugin_instance,
+             sizeof(vl->plugin_instance));
+
+  /* Append the instances to the prefix in vl->type_instance {{{ */
+  char *ptr = vl->type_instance + r_area->type_instance_prefix_len;
+  size_t avail =
+      sizeof(vl->type_instance) - 1 - r_area->type_instance_prefix_len;
+  for (size_t i = 0; (i < r->instances_num) && (avail > 0); i++) {
+    if (i != 0) {
+      *ptr++ = '-';
+      avail--;
     }
+
+    size_t len = strlen(r_area->instances_buffer[i]);
+    if (len > avail)
+      len = avail;
+    memcpy(ptr, r_area->instances_buffer[i], len);
+    ptr += len;
+    avail -= len;
   }
-  vl.type_instance[sizeof(vl.type_instance) - 1] = '\0';
+  *ptr = 0;
   /* }}} */
 
   /* Annotate meta data. {{{ */
   if (r->metadata_num > 0) {
-    vl.meta = meta_data_create();
-    if (vl.meta == NULL) {
+    vl->meta = meta_data_create();
+    if (vl->meta == NULL) {
       P_ERROR("udb_result_submit: meta_data_create failed.");
-      free(vl.values);
       return -ENOMEM;
     }
 
     for (size_t i = 0; i < r->metadata_num; i++) {
-      int status = meta_data_add_string(vl.meta, r->metadata[i],
+      int status = meta_data_add_string(vl->meta, r->metadata[i],
                                         r_area->metadata_buffer[i]);
       if (status != 0) {
         P_ERROR("udb_result_submit: meta_data_add_string failed.");
-        meta_data_destroy(vl.meta);
-        vl.meta = NULL;
-        free(vl.values);
+        meta_data_destroy(vl->meta);
+        vl->meta = NULL;
         return status;
       }
     }
   }
   /* }}} */
 
-  plugin_dispatch_values(&vl);
+  r_area->batch_num++;
+  if (r_area->batch_num >= UDB_BATCH_SIZE)
+    udb_result_flush(r_area);
 
-  if (r->metadata_num > 0) {
-    meta_data_destroy(vl.meta);
-    vl.meta = NULL;
-  }
-  sfree(vl.values);
   return 0;
 } /* }}} void udb_result_submit */
 
@@ -273,6 +322,8 @@ static void udb_result_finish_result(udb_result_t const *r, /* {{{ */
   if ((r == NULL) || (prep_area == NULL))
     return;
 
+  udb_result_flush(prep_area);
+
   prep_area->ds = NULL;
   sfree(prep_area->instances_pos);
   sfree(prep_area->values_pos);
@@ -301,7 +352,7 @@ static int udb_result_handle_result(udb_result_t *r, /* {{{ */
   if (q->plugin_instance_from)
     r_area->plugin_instance = column_values[q_area->plugin_instance_pos];
 
-  return udb_result_submit(r, r_area, q, q_area);
+  return udb_result_submit(r, r_area, q);
 } /* }}} int udb_result_handle_result */
 
 static int udb_result_prepare_result(udb_result_t const *r, /* {{{ */
@@ -451,6 +502,41 @@ static int udb_result_prepare_result(udb_result_t const *r, /* {{{ */
   return 0;
 } /* }}} int udb_result_prepare_result */
 
+static int udb_result_prepare_batch(udb_result_t const *r, /* {{{ */
+                                    udb_result_preparation_area_t *r_area,
+                                    udb_query_t const *q,
+                                    udb_query_preparation_area_t *q_area) {
+  value_list_t *vl = &r_area->vl_template;
+
+  *vl = (value_list_t)VALUE_LIST_INIT;
+  vl->values_len = r->values_num;
+  sstrncpy(vl->host, q_area->host, sizeof(vl->host));
+  sstrncpy(vl->plugin, q_area->plugin, sizeof(vl->plugin));
+  sstrncpy(vl->type, r->type, sizeof(vl->type));
+  if (q->plugin_instance_from == NULL)
+    sstrncpy(vl->plugin_instance, q_area->db_name, sizeof(vl->plugin_instance));
+
+  if (r->instance_prefix != NULL)
+    snprintf(vl->type_instance, sizeof(vl->type_instance),
+             (r->instances_num > 0) ? "%s-" : "%s", r->instance_prefix);
+  r_area->type_instance_prefix_len = strlen(vl->type_instance);
+
+  if (r_area->batch == NULL) {
+    r_area->batch = calloc(UDB_BATCH_SIZE, sizeof(*r_area->batch));
+    r_area->batch_values = calloc(UDB_BATCH_SIZE * r->values_num,
+                                  sizeof(*r_area->batch_values));
+    if ((r_area->batch == NULL) || (r_area->batch_values == NULL)) {
+      P_ERROR("udb_result_prepare_batch: calloc failed.");
+      sfree(r_area->batch);
+      sfree(r_area->batch_values);
+      return -ENOMEM;
+    }
+  }
+  r_area->batch_num = 0;
+
+  return 0;
+} /* }}} int udb_result_prepare_batch */
+
 static void udb_result_free(udb_result_t *r) /* {{{ */
 {
   if (r == NULL)
@@ -634,6 +720,8 @@ int udb_query_create(udb_query_t ***ret_query_list, /* {{{ */
       status = udb_config_set_uint(&q->max_version, child);
     else if (strcasecmp("PluginInstanceFrom", child->key) == 0)
       status = cf_util_get_string(child, &q->plugin_instance_from);
+    else if (strcasecmp("Interval", child->key) == 0)
+      status = cf_util_get_cdtime(child, &q->interval);
 
     /* Call custom callbacks */
     else if (cb != NULL) {
@@ -793,6 +881,64 @@ const char *udb_query_get_statement(udb_query_t *q) /* {{{ */
   return q->statement;
 } /* }}} const char *udb_query_get_statement */
 
+cdtime_t udb_query_get_interval(udb_query_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return 0;
+
+  return q->interval;
+} /* }}} cdtime_t udb_query_get_interval */
+
+size_t udb_query_group(udb_query_t **query_list, /* {{{ */
+                       size_t query_list_len, size_t max_groups,
+                       size_t *group_ids) {
+  if (query_list_len == 0)
+    return 0;
+
+  cdtime_t intervals[query_list_len];
+  size_t counts[query_list_len];
+  size_t bases[query_list_len];
+  size_t seen[query_list_len];
+  size_t intervals_num = 0;
+  size_t groups_num = 0;
+
+  if (max_groups < 1)
+    max_groups = 1;
+
+  /* First pass: count the queries of each interval. */
+  for (size_t i = 0; i < query_list_len; i++) {
+    cdtime_t interval = udb_query_get_interval(query_list[i]);
+    size_t j;
+
+    for (j = 0; j < intervals_num; j++)
+      if (intervals[j] == interval)
+        break;
+
+    if (j == intervals_num) {
+      intervals[j] = interval;
+      counts[j] = 0;
+      seen[j] = 0;
+      intervals_num++;
+    }
+    counts[j]++;
+    group_ids[i] = j;
+  }
+
+  for (size_t j = 0; j < intervals_num; j++) {
+    bases[j] = groups_num;
+    groups_num += (counts[j] < max_groups) ? counts[j] : max_groups;
+  }
+
+  /* Second pass: distribute the queries of each interval round-robin. */
+  for (size_t i = 0; i < query_list_len; i++) {
+    size_t j = group_ids[i];
+    group_ids[i] = bases[j] + (seen[j] % max_groups);
+    seen[j]++;
+  }
+
+  return groups_num;
+} /* }}} size_t udb_query_group */
+
 void udb_query_set_user_data(udb_query_t *q, void *user_data) /* {{{ */
 {
   if (q == NULL)
@@ -889,6 +1035,49 @@ int udb_query_handle_result(udb_query_t const *q, /* {{{ */
   return 0;
 } /* }}} int udb_query_handle_result */
 
+int udb_query_handle_results(udb_query_t const *q, /* {{{ */
+                             udb_query_preparation_area_t *prep_area,
+                             char **column_values, size_t rows_num) {
+  udb_result_preparation_area_t *r_area;
+  udb_result_t *r;
+  size_t success;
+
+  if ((q == NULL) || (prep_area == NULL))
+    return -EINVAL;
+
+  if ((prep_area->column_num < 1) || (prep_area->host == NULL) ||
+      (prep_area->plugin == NULL) || (prep_area->db_name == NULL)) {
+    P_ERROR("Query `%s': Query is not prepared; "
+            "can't handle results.",
+            q->name);
+    return -EINVAL;
+  }
+
+  if (rows_num == 0)
+    return 0;
+
+  /* Handle one result for all rows before moving on to the next, so that
+   * the positions and buffers of the result stay in the cache. */
+  success = 0;
+  for (r = q->results, r_area = prep_area->result_prep_areas; r != NULL;
+       r = r->next, r_area = r_area->next) {
+    for (size_t row = 0; row < rows_num; row++) {
+      char **row_values = column_values + row * prep_area->column_num;
+      if (udb_result_handle_result(r, prep_area, r_area, q, row_values) == 0)
+        success++;
+    }
+  }
+
+  if (success == 0) {
+    P_ERROR("udb_query_handle_results (%s, %s): "
+            "All results failed for all %" PRIsz " rows.",
+            prep_area->db_name, q->name, rows_num);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int udb_query_handle_results */
+
 int udb_query_prepare_result(udb_query_t const *q, /* {{{ */
                              udb_query_preparation_area_t *prep_area,
                              const char *host, const char *plugin,
@@ -962,6 +1151,8 @@ int udb_query_prepare_result(udb_query_t const *q, /* {{{ */
     }
 
     status = udb_result_prepare_result(r, r_area, column_names, column_num);
+    if (status == 0)
+      status = udb_result_prepare_batch(r, r_area, q, prep_area);
     if (status != 0) {
       udb_query_finish_result(q, prep_area);
       return status;
@@ -1023,8 +1214,12 @@ void udb_query_delete_preparation_area(
 
     sfree(area->instances_pos);
     sfree(area->values_pos);
+    sfree(area->metadata_pos);
     sfree(area->instances_buffer);
     sfree(area->values_buffer);
+    sfree(area->metadata_buffer);
+    sfree(area->batch);
+    sfree(area->batch_values);
     free(area);
   }
 
@@ -55,6 +55,20 @@ int udb_query_pick_from_list(oconfig_item_t *ci, udb_query_t **src_list,
 
 const char *udb_query_get_name(udb_query_t *q);
 const char *udb_query_get_statement(udb_query_t *q);
+cdtime_t udb_query_get_interval(udb_query_t *q);
+
+/*
+ * udb_query_group
+ *
+ * Distributes the queries over groups which are meant to be run in parallel,
+ * e.g. by separate read callbacks with a connection each. Queries with
+ * different intervals are put into different groups, and the queries of one
+ * interval are distributed round-robin over at most `max_groups' groups. The
+ * group of the i-th query is stored in `group_ids[i]'; groups are numbered
+ * from zero. Returns the number of groups.
+ */
+size_t udb_query_group(udb_query_t **query_list, size_t query_list_len,
+                       size_t max_groups, size_t *group_ids);
 
 void udb_query_set_user_data(udb_query_t *q, void *user_data);
 void *udb_query_get_user_data(udb_query_t *q);
@@ -75,6 +89,19 @@ int udb_query_prepare_result(udb_query_t const *q,
 int udb_query_handle_result(udb_query_t const *q,
                             udb_query_preparation_area_t *prep_area,
                             char **column_values);
+
+/*
+ * udb_query_handle_results
+ *
+ * Handles a whole result set at once. `column_values' holds `rows_num' rows
+ * of `column_num' values each, as passed to `udb_query_prepare_result', one
+ * row after the other. The value lists of both functions are dispatched in
+ * batches; the last batch is dispatched by `udb_query_finish_result'.
+ * Returns zero if at least one row could be handled.
+ */
+int udb_query_handle_results(udb_query_t const *q,
+                             udb_query_preparation_area_t *prep_area,
+                             char **column_values, size_t rows_num);
 void udb_query_finish_result(udb_query_t const *q,
                              udb_query_preparation_area_t *prep_area);
 
@@ -262,12 +262,14 @@ void dnstop_set_callback(void (*cb)(const rfc1035_header_t *)) {
 }
 
 #define RFC1035_MAXLABELSZ 63
+/* `loop_detect' counts the compression pointers followed so far. It is passed
+ * along rather than kept in a static variable, so that several capture
+ * threads can parse packets at once. */
 static int rfc1035NameUnpack(const char *buf, size_t sz, off_t *off, char *name,
-                             size_t ns) {
+                             size_t ns, int loop_detect) {
   off_t no = 0;
   unsigned char c;
   size_t len;
-  static int loop_detect;
   if (loop_detect > 2)
     return 4; /* compression loop */
   if (ns == 0)
@@ -293,9 +295,8 @@ static int rfc1035NameUnpack(const char *buf, size_t sz, off_t *off, char *name,
         return 2; /* bad compression ptr */
       if (ptr < DNS_MSG_HDR_SZ)
         return 2; /* bad compression ptr */
-      loop_detect++;
-      rc = rfc1035NameUnpack(buf, sz, &ptr, name + no, ns - no);
-      loop_detect--;
+      rc = rfc1035NameUnpack(buf, sz, &ptr, name + no, ns - no,
+                             loop_detect + 1);
       return rc;
     } else if (c > RFC1035_MAXLABELSZ) {
       /*
@@ -367,7 +368,8 @@ static int handle_dns(const char *buf, int len) {
 
   offset = DNS_MSG_HDR_SZ;
   memset(qh.qname, '\0', MAX_QNAME_SZ);
-  status = rfc1035NameUnpack(buf, len, &offset, qh.qname, MAX_QNAME_SZ);
+  status = rfc1035NameUnpack(buf, len, &offset, qh.qname, MAX_QNAME_SZ,
+                             /* loop_detect = */ 0);
   if (status != 0) {
     INFO("utils_dns: handle_dns: rfc1035NameUnpack failed "
          "with status %i.",
@@ -662,6 +664,18 @@ void handle_pcap(u_char *udata, const struct pcap_pkthdr *hdr,
   query_count_total++;
   last_ts = hdr->ts;
 }
+
+/* public function */
+int handle_ip_packet(const u_char *pkt, int len) {
+  /* The smallest IPv4 header. */
+  if (len < 20)
+    return 0;
+  /* The handlers copy the packet to buffers of this size. */
+  if (len > PCAP_SNAPLEN)
+    len = PCAP_SNAPLEN;
+
+  return handle_ip((const struct ip *)pkt, len);
+}
 #endif /* HAVE_PCAP_H */
 
 const char *qtype_str(int t) {
@@ -82,6 +82,10 @@ void ignore_list_add_name(const char *name);
 #if HAVE_PCAP_H
 void handle_pcap(u_char *udata, const struct pcap_pkthdr *hdr,
                  const u_char *pkt);
+/* Parses a packet that starts with its IPv4 or IPv6 header, as received
+ * from a packet socket of type SOCK_DGRAM. Unlike `handle_pcap', this may be
+ * called by several threads at once. Returns 1 if it was a DNS message. */
+int handle_ip_packet(const u_char *pkt, int len);
 #endif
 
 const char *qtype_str(int t);
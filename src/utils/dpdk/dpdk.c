@@ -86,6 +86,10 @@ struct dpdk_helper_ctx_s {
   int cmd;
   int cmd_result;
 
+  /* Set by collectd; the helper wakes up at stream_next (helper only). */
+  cdtime_t stream_interval;
+  cdtime_t stream_next;
+
   char priv_data[];
 };
 
@@ -535,24 +539,42 @@ static int dpdk_helper_eal_init(dpdk_helper_ctx_t *phc) {
   return 0;
 }
 
+/* Returns zero if a command has been received, one if it is time to push a
+ * sample in streaming mode and -1 otherwise. */
 static int dpdk_helper_cmd_wait(dpdk_helper_ctx_t *phc, pid_t ppid) {
-  DPDK_CHILD_TRACE(phc->shm_name);
-
   struct timespec ts;
   cdtime_t now = cdtime();
-  cdtime_t cmd_wait_time = MS_TO_CDTIME_T(1500) + phc->cmd_wait_time * 2;
-  ts = CDTIME_T_TO_TIMESPEC(now + cmd_wait_time);
+  int streaming = (phc->stream_interval > 0) &&
+                  (phc->status == DPDK_HELPER_ALIVE_SENDING_EVENTS);
+
+  if (streaming) {
+    if (phc->stream_next == 0)
+      phc->stream_next = now + phc->stream_interval;
+    ts = CDTIME_T_TO_TIMESPEC(phc->stream_next);
+  } else {
+    DPDK_CHILD_TRACE(phc->shm_name);
+    cdtime_t cmd_wait_time = MS_TO_CDTIME_T(1500) + phc->cmd_wait_time * 2;
+    ts = CDTIME_T_TO_TIMESPEC(now + cmd_wait_time);
+  }
 
   int ret = sem_timedwait(&phc->sema_cmd_start, &ts);
-  DPDK_CHILD_LOG("%s:%s:%d pid=%lu got sema_cmd_start (ret=%d, errno=%d)\n",
-                 phc->shm_name, __FUNCTION__, __LINE__, (long)getpid(), ret,
-                 errno);
+  int tick = streaming && (ret == -1) && (errno == ETIMEDOUT);
+  if (tick) {
+    /* Keep the cadence, unless the helper fell behind. */
+    phc->stream_next += phc->stream_interval;
+    if (phc->stream_next <= cdtime())
+      phc->stream_next = cdtime() + phc->stream_interval;
+  } else {
+    DPDK_CHILD_LOG("%s:%s:%d pid=%lu got sema_cmd_start (ret=%d, errno=%d)\n",
+                   phc->shm_name, __FUNCTION__, __LINE__, (long)getpid(), ret,
+                   errno);
+  }
 
   if (phc->cmd == DPDK_CMD_QUIT) {
     DPDK_CHILD_LOG("%s:%s:%d pid=%lu exiting\n", phc->shm_name, __FUNCTION__,
                    __LINE__, (long)getpid());
     exit(0);
-  } else if (ret == -1 && errno == ETIMEDOUT) {
+  } else if (!tick && ret == -1 && errno == ETIMEDOUT) {
     if (phc->status == DPDK_HELPER_ALIVE_SENDING_EVENTS) {
       DPDK_CHILD_LOG("%s:dpdk_helper_cmd_wait: sem timedwait()"
                      " timeout, did collectd terminate?\n",
@@ -602,7 +624,7 @@ static int dpdk_helper_cmd_wait(dpdk_helper_ctx_t *phc, pid_t ppid) {
     return -1;
   }
 
-  return 0;
+  return tick ? 1 : 0;
 }
 
 static int dpdk_helper_worker(dpdk_helper_ctx_t *phc) {
@@ -611,7 +633,12 @@ static int dpdk_helper_worker(dpdk_helper_ctx_t *phc) {
   pid_t ppid = getppid();
 
   while (1) {
-    if (dpdk_helper_cmd_wait(phc, ppid) == 0) {
+    int status = dpdk_helper_cmd_wait(phc, ppid);
+    if (status == 1) {
+      /* Nobody waits for the result of a streaming sample. */
+      dpdk_helper_command_handler(phc, DPDK_CMD_STREAM);
+      continue;
+    } else if (status == 0) {
       DPDK_CHILD_LOG("%s:%s:%d DPDK command handle (cmd=%d, pid=%lu)\n",
                      phc->shm_name, __FUNCTION__, __LINE__, phc->cmd,
                      (long)getpid());
@@ -804,6 +831,31 @@ int dpdk_helper_command(dpdk_helper_ctx_t *phc, enum DPDK_CMD cmd, int *result,
   return 0;
 }
 
+int dpdk_helper_stream_start(dpdk_helper_ctx_t *phc, cdtime_t interval) {
+  if (phc == NULL) {
+    ERROR("Invalid argument(phc)");
+    return -EINVAL;
+  }
+
+  /* Picked up by the helper when it waits for the next command. */
+  phc->stream_interval = interval;
+  return 0;
+}
+
+int dpdk_helper_stream_check(dpdk_helper_ctx_t *phc) {
+  if (phc == NULL) {
+    ERROR("Invalid argument(phc)");
+    return -EINVAL;
+  }
+
+  int ret = dpdk_helper_status_check(phc);
+  dpdk_helper_check_pipe(phc);
+  if (ret != 0)
+    return ret;
+
+  return (phc->stream_interval > 0) ? 0 : -1;
+}
+
 uint64_t strtoull_safe(const char *str, int *err) {
   uint64_t val = 0;
   char *endptr;
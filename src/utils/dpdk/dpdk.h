@@ -43,6 +43,7 @@ enum DPDK_CMD {
   DPDK_CMD_INIT,
   DPDK_CMD_GET_STATS,
   DPDK_CMD_GET_EVENTS,
+  DPDK_CMD_STREAM,
   __DPDK_CMD_LAST,
 };
 
@@ -72,6 +73,12 @@ int dpdk_helper_eal_config_set(dpdk_helper_ctx_t *phc, dpdk_eal_config_t *ec);
 int dpdk_helper_eal_config_get(dpdk_helper_ctx_t *phc, dpdk_eal_config_t *ec);
 int dpdk_helper_command(dpdk_helper_ctx_t *phc, enum DPDK_CMD cmd, int *result,
                         cdtime_t cmd_wait_time);
+/* In streaming mode, the helper additionally calls the command handler with
+ * DPDK_CMD_STREAM every "interval", without waiting for a command. */
+int dpdk_helper_stream_start(dpdk_helper_ctx_t *phc, cdtime_t interval);
+/* Non-blocking check that the helper is alive, restarting it if it is not.
+ * Returns zero if the helper is alive and streaming. */
+int dpdk_helper_stream_check(dpdk_helper_ctx_t *phc);
 void *dpdk_helper_priv_get(dpdk_helper_ctx_t *phc);
 int dpdk_helper_data_size_get(dpdk_helper_ctx_t *phc);
 uint8_t dpdk_helper_eth_dev_count(void);
@@ -0,0 +1,197 @@
+/**
+ * collectd - src/utils/ds_filter/ds_filter.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils/ds_filter/ds_filter.h"
+
+typedef struct ds_filter_entry_s {
+  char type[DATA_MAX_NAME_LEN];
+  /* The data set the selection has been computed for. */
+  data_set_t const *ds;
+  data_source_t const *sources;
+  size_t ds_num;
+
+  c_ds_selection_t selection;
+
+  /* Entries replaced because the data set changed are kept until the filter
+   * is destroyed, since callers may still use their selection. */
+  struct ds_filter_entry_s *next_retired;
+} ds_filter_entry_t;
+
+struct c_ds_filter_s {
+  char **names;
+  size_t names_num;
+
+  pthread_mutex_t lock;
+  c_avl_tree_t *entries;
+  ds_filter_entry_t *retired;
+};
+
+static void ds_filter_entry_free(ds_filter_entry_t *e) /* {{{ */
+{
+  if (e == NULL)
+    return;
+
+  free(e->selection.indices);
+  free(e);
+} /* }}} void ds_filter_entry_free */
+
+static bool ds_filter_selects(c_ds_filter_t const *f, /* {{{ */
+                              char const *name) {
+  if (f->names_num == 0)
+    return true;
+
+  for (size_t i = 0; i < f->names_num; i++)
+    if (strcasecmp(name, f->names[i]) == 0)
+      return true;
+
+  return false;
+} /* }}} bool ds_filter_selects */
+
+static ds_filter_entry_t *ds_filter_entry_create(c_ds_filter_t const *f,
+                                                 data_set_t const *ds) /* {{{ */
+{
+  ds_filter_entry_t *e = calloc(1, sizeof(*e));
+  if (e == NULL)
+    return NULL;
+
+  sstrncpy(e->type, ds->type, sizeof(e->type));
+  e->ds = ds;
+  e->sources = ds->ds;
+  e->ds_num = ds->ds_num;
+
+  if (ds->ds_num > 0) {
+    e->selection.indices = calloc(ds->ds_num, sizeof(*e->selection.indices));
+    if (e->selection.indices == NULL) {
+      free(e);
+      return NULL;
+    }
+  }
+
+  e->selection.type = -1;
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    if (!ds_filter_selects(f, ds->ds[i].name))
+      continue;
+
+    if (e->selection.indices_num == 0)
+      e->selection.type = ds->ds[i].type;
+    else if (e->selection.type != ds->ds[i].type)
+      e->selection.type = -1;
+
+    e->selection.indices[e->selection.indices_num] = i;
+    e->selection.indices_num++;
+  }
+  e->selection.all = (e->selection.indices_num == ds->ds_num);
+
+  return e;
+} /* }}} ds_filter_entry_t *ds_filter_entry_create */
+
+c_ds_filter_t *c_ds_filter_create(char *const *names, /* {{{ */
+                                  size_t names_num) {
+  c_ds_filter_t *f = calloc(1, sizeof(*f));
+  if (f == NULL)
+    return NULL;
+
+  if (names_num > 0) {
+    f->names = calloc(names_num, sizeof(*f->names));
+    if (f->names == NULL) {
+      free(f);
+      return NULL;
+    }
+  }
+  for (size_t i = 0; i < names_num; i++) {
+    f->names[i] = strdup(names[i]);
+    if (f->names[i] == NULL) {
+      c_ds_filter_destroy(f);
+      return NULL;
+    }
+    f->names_num++;
+  }
+
+  f->entries = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (f->entries == NULL) {
+    c_ds_filter_destroy(f);
+    return NULL;
+  }
+  pthread_mutex_init(&f->lock, /* attr = */ NULL);
+
+  return f;
+} /* }}} c_ds_filter_t *c_ds_filter_create */
+
+void c_ds_filter_destroy(c_ds_filter_t *f) /* {{{ */
+{
+  if (f == NULL)
+    return;
+
+  if (f->entries != NULL) {
+    char *type;
+    ds_filter_entry_t *e;
+    while (c_avl_pick(f->entries, (void *)&type, (void *)&e) == 0)
+      ds_filter_entry_free(e);
+    c_avl_destroy(f->entries);
+    pthread_mutex_destroy(&f->lock);
+  }
+
+  while (f->retired != NULL) {
+    ds_filter_entry_t *next = f->retired->next_retired;
+    ds_filter_entry_free(f->retired);
+    f->retired = next;
+  }
+
+  strarray_free(f->names, f->names_num);
+  free(f);
+} /* }}} void c_ds_filter_destroy */
+
+c_ds_selection_t const *c_ds_filter_get(c_ds_filter_t *f, /* {{{ */
+                                        data_set_t const *ds) {
+  if ((f == NULL) || (ds == NULL))
+    return NULL;
+
+  pthread_mutex_lock(&f->lock);
+
+  ds_filter_entry_t *e = NULL;
+  if (c_avl_get(f->entries, ds->type, (void *)&e) == 0) {
+    if ((e->ds == ds) && (e->sources == ds->ds) && (e->ds_num == ds->ds_num)) {
+      pthread_mutex_unlock(&f->lock);
+      return &e->selection;
+    }
+
+    /* The data set has been registered again. */
+    c_avl_remove(f->entries, ds->type, NULL, NULL);
+    e->next_retired = f->retired;
+    f->retired = e;
+  }
+
+  e = ds_filter_entry_create(f, ds);
+  if ((e == NULL) || (c_avl_insert(f->entries, e->type, e) != 0)) {
+    pthread_mutex_unlock(&f->lock);
+    ds_filter_entry_free(e);
+    return NULL;
+  }
+
+  pthread_mutex_unlock(&f->lock);
+  return &e->selection;
+} /* }}} c_ds_selection_t const *c_ds_filter_get */
@@ -0,0 +1,75 @@
+/**
+ * collectd - src/utils/ds_filter/ds_filter.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_DS_FILTER_H
+#define UTILS_DS_FILTER_H 1
+
+#include "plugin.h"
+
+/* A data source filter selects the data sources of a data set by name, as the
+ * `DataSource' option of matches and targets does. The indices of the
+ * selected data sources are computed once per data set and remembered. */
+struct c_ds_filter_s;
+typedef struct c_ds_filter_s c_ds_filter_t;
+
+typedef struct {
+  /* Indices of the selected data sources, in ascending order. */
+  size_t *indices;
+  size_t indices_num;
+  /* True if every data source of the data set is selected. */
+  bool all;
+  /* The type of all selected data sources, or -1 if they differ. */
+  int type;
+} c_ds_selection_t;
+
+/*
+ * NAME
+ *   c_ds_filter_create
+ *
+ * DESCRIPTION
+ *   Creates a filter selecting the data sources named in `names', compared
+ *   case-insensitively. If `names_num' is zero, all data sources are
+ *   selected. The names are copied.
+ *
+ * RETURN VALUE
+ *   A c_ds_filter_t-pointer upon success or NULL upon failure.
+ */
+c_ds_filter_t *c_ds_filter_create(char *const *names, size_t names_num);
+
+void c_ds_filter_destroy(c_ds_filter_t *f);
+
+/*
+ * NAME
+ *   c_ds_filter_get
+ *
+ * DESCRIPTION
+ *   Returns the data sources of `ds' selected by `f'. The selection stays
+ *   valid until the filter is destroyed. Thread-safe.
+ *
+ * RETURN VALUE
+ *   The selection or NULL upon failure.
+ */
+c_ds_selection_t const *c_ds_filter_get(c_ds_filter_t *f,
+                                        data_set_t const *ds);
+
+#endif /* UTILS_DS_FILTER_H */
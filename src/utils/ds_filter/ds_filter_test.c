@@ -0,0 +1,94 @@
+/**
+ * collectd - src/utils/ds_filter/ds_filter_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/ds_filter/ds_filter.h"
+
+static data_source_t sources[] = {
+    {"rx", DS_TYPE_DERIVE, 0, NAN},
+    {"tx", DS_TYPE_DERIVE, 0, NAN},
+    {"errors", DS_TYPE_GAUGE, 0, NAN},
+};
+static data_set_t ds = {"if_test", STATIC_ARRAY_SIZE(sources), sources};
+
+DEF_TEST(all) {
+  c_ds_filter_t *f;
+  c_ds_selection_t const *sel;
+
+  CHECK_NOT_NULL(f = c_ds_filter_create(NULL, 0));
+  CHECK_NOT_NULL((void *)(sel = c_ds_filter_get(f, &ds)));
+  EXPECT_EQ_INT(3, (int)sel->indices_num);
+  OK(sel->all);
+  EXPECT_EQ_INT(-1, sel->type);
+  for (size_t i = 0; i < sel->indices_num; i++)
+    EXPECT_EQ_INT((int)i, (int)sel->indices[i]);
+
+  /* The selection is remembered. */
+  EXPECT_EQ_PTR((void *)sel, (void *)c_ds_filter_get(f, &ds));
+
+  c_ds_filter_destroy(f);
+  return 0;
+}
+
+DEF_TEST(names) {
+  char *names[] = {"TX", "rx", "unknown"};
+  c_ds_filter_t *f;
+  c_ds_selection_t const *sel;
+
+  CHECK_NOT_NULL(f = c_ds_filter_create(names, STATIC_ARRAY_SIZE(names)));
+  CHECK_NOT_NULL((void *)(sel = c_ds_filter_get(f, &ds)));
+  EXPECT_EQ_INT(2, (int)sel->indices_num);
+  OK(!sel->all);
+  EXPECT_EQ_INT(DS_TYPE_DERIVE, sel->type);
+  EXPECT_EQ_INT(0, (int)sel->indices[0]);
+  EXPECT_EQ_INT(1, (int)sel->indices[1]);
+
+  /* A data set registered again gets a new selection, the old one stays
+   * valid. */
+  data_set_t copy = ds;
+  c_ds_selection_t const *sel_copy;
+  CHECK_NOT_NULL((void *)(sel_copy = c_ds_filter_get(f, &copy)));
+  OK(sel != sel_copy);
+  EXPECT_EQ_INT(2, (int)sel->indices_num);
+  EXPECT_EQ_INT(2, (int)sel_copy->indices_num);
+
+  char *none[] = {"foo"};
+  c_ds_filter_destroy(f);
+  CHECK_NOT_NULL(f = c_ds_filter_create(none, STATIC_ARRAY_SIZE(none)));
+  CHECK_NOT_NULL((void *)(sel = c_ds_filter_get(f, &ds)));
+  EXPECT_EQ_INT(0, (int)sel->indices_num);
+  EXPECT_EQ_INT(-1, sel->type);
+
+  c_ds_filter_destroy(f);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(all);
+  RUN_TEST(names);
+
+  END_TEST;
+}
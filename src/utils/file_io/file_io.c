@@ -0,0 +1,793 @@
+/**
+ * collectd - src/utils/file_io/file_io.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/file_io/file_io.h"
+
+#include <sys/uio.h>
+
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if HAVE_LINUX_IO_URING_H && defined(__NR_io_uring_setup) &&                   \
+    defined(__NR_io_uring_enter)
+#define FILE_IO_URING 1
+#else
+#define FILE_IO_URING 0
+#endif
+
+/* Files that have a step in flight at the same time. */
+#define FILE_IO_BATCH 64
+/* Appends that are written with one writev(2). */
+#define FILE_IO_IOV_MAX 16
+
+typedef enum {
+  OP_APPEND,
+  OP_FSYNC,
+  OP_CLOSE,
+} file_io_op_type_t;
+
+struct file_io_op_s;
+typedef struct file_io_op_s file_io_op_t;
+struct file_io_op_s {
+  file_io_op_type_t type;
+  char *buf;
+  size_t len;
+  size_t done;
+  /* Counted as pending, i.e. submitted by a caller. */
+  bool pending;
+  file_io_op_t *next;
+};
+
+typedef enum {
+  STEP_OPEN,
+  STEP_WRITE,
+  STEP_FSYNC,
+  STEP_CLOSE,
+} file_io_step_t;
+
+struct file_io_file_s {
+  file_io_t *io;
+  char *path;
+  char *header;
+  int fd;
+  bool closed;
+  /* Allocated up front, so that closing can't fail. */
+  file_io_op_t *close_op;
+
+  /* Set while opening, so that an existing file is opened without O_EXCL and
+   * a missing directory is created only once. */
+  bool exists;
+  bool dir_created;
+
+  /* Operations submitted by the callers, protected by io->lock. */
+  file_io_op_t *queued_head;
+  file_io_op_t *queued_tail;
+  bool queued;
+  file_io_file_t *queue_next;
+
+  /* Operations taken by the thread of the service. */
+  file_io_op_t *ops_head;
+  file_io_op_t *ops_tail;
+  file_io_file_t *work_next;
+
+  /* The step in flight and its result, a byte count, file descriptor or
+   * negative errno value. */
+  file_io_step_t step;
+  int flags;
+  struct iovec iov[FILE_IO_IOV_MAX];
+  int iovcnt;
+  int res;
+};
+
+#if FILE_IO_URING
+typedef struct {
+  int fd;
+
+  void *sq_ptr;
+  size_t sq_len;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  size_t sqes_len;
+
+  void *cq_ptr;
+  size_t cq_len;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+} file_io_uring_t;
+#endif
+
+struct file_io_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_cond_t done_cond;
+  pthread_t thread;
+  bool stopping;
+  bool busy;
+
+  /* Files with queued operations. */
+  file_io_file_t *queue_head;
+  file_io_file_t *queue_tail;
+
+  /* Files that have not been closed yet. */
+  file_io_file_t **files;
+  size_t files_num;
+
+  size_t pending;
+  size_t max_pending;
+
+  file_io_error_cb error;
+  void *arg;
+
+#if FILE_IO_URING
+  file_io_uring_t *uring;
+#endif
+};
+
+#if FILE_IO_URING
+static void uring_destroy(file_io_uring_t *u) {
+  if (u == NULL)
+    return;
+
+  if ((u->cq_ptr != NULL) && (u->cq_ptr != u->sq_ptr))
+    munmap(u->cq_ptr, u->cq_len);
+  if (u->sq_ptr != NULL)
+    munmap(u->sq_ptr, u->sq_len);
+  if (u->sqes != NULL)
+    munmap(u->sqes, u->sqes_len);
+  if (u->fd >= 0)
+    close(u->fd);
+  free(u);
+} /* void uring_destroy */
+
+/* Sets up a ring, or returns NULL if the kernel doesn't support one that can
+ * do what the service needs. Writing at the current position, which appends
+ * to files opened with O_APPEND, came with the opcodes for opening and
+ * closing files in Linux 5.6. */
+static file_io_uring_t *uring_create(void) {
+  file_io_uring_t *u = calloc(1, sizeof(*u));
+  if (u == NULL)
+    return NULL;
+  u->fd = -1;
+
+  struct io_uring_params p = {0};
+  u->fd = (int)syscall(__NR_io_uring_setup, FILE_IO_BATCH, &p);
+  if ((u->fd < 0) || !(p.features & IORING_FEAT_RW_CUR_POS)) {
+    uring_destroy(u);
+    return NULL;
+  }
+
+  u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (u->cq_len > u->sq_len)
+      u->sq_len = u->cq_len;
+    u->cq_len = u->sq_len;
+  }
+
+  u->sq_ptr = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (u->sq_ptr == MAP_FAILED) {
+    u->sq_ptr = NULL;
+    uring_destroy(u);
+    return NULL;
+  }
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    u->cq_ptr = u->sq_ptr;
+  } else {
+    u->cq_ptr = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if (u->cq_ptr == MAP_FAILED) {
+      u->cq_ptr = NULL;
+      uring_destroy(u);
+      return NULL;
+    }
+  }
+
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) {
+    u->sqes = NULL;
+    uring_destroy(u);
+    return NULL;
+  }
+
+  char *sq = u->sq_ptr;
+  u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+  char *cq = u->cq_ptr;
+  u->cq_head = (unsigned *)(cq + p.cq_off.head);
+  u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  return u;
+} /* file_io_uring_t *uring_create */
+
+/* Submits the steps and waits for them to complete. Returns an errno value if
+ * the ring failed, in which case the steps that completed have their result
+ * and "ret_submitted" is the number of steps that were submitted. */
+static int uring_run(file_io_uring_t *u, file_io_file_t **active, size_t num,
+                     bool *completed, size_t *ret_submitted) {
+  unsigned tail = *u->sq_tail;
+  for (size_t i = 0; i < num; i++) {
+    file_io_file_t *f = active[i];
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = u->sqes + idx;
+
+    memset(sqe, 0, sizeof(*sqe));
+    switch (f->step) {
+    case STEP_OPEN:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (uintptr_t)f->path;
+      sqe->len = 0666;
+      sqe->open_flags = (uint32_t)f->flags;
+      break;
+    case STEP_WRITE:
+      sqe->opcode = IORING_OP_WRITEV;
+      sqe->fd = f->fd;
+      sqe->addr = (uintptr_t)f->iov;
+      sqe->len = (uint32_t)f->iovcnt;
+      /* Writes at the current position. */
+      sqe->off = (uint64_t)-1;
+      break;
+    case STEP_FSYNC:
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->fd = f->fd;
+      break;
+    case STEP_CLOSE:
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = f->fd;
+      break;
+    }
+    sqe->user_data = (uint64_t)i;
+    u->sq_array[idx] = idx;
+    completed[i] = false;
+    tail++;
+  }
+  __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+
+  size_t submit = num;
+  size_t reaped = 0;
+  while (reaped < num) {
+    int status = (int)syscall(__NR_io_uring_enter, u->fd, (unsigned)submit, 1,
+                              IORING_ENTER_GETEVENTS, NULL, 0);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+        continue;
+      *ret_submitted = num - submit;
+      return errno;
+    }
+    submit -= (size_t)status;
+
+    unsigned head = *u->cq_head;
+    while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = u->cqes + (head & *u->cq_mask);
+      if (cqe->user_data < num) {
+        active[cqe->user_data]->res = cqe->res;
+        completed[cqe->user_data] = true;
+        reaped++;
+      }
+      head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  return 0;
+} /* int uring_run */
+#endif /* FILE_IO_URING */
+
+static void step_run(file_io_file_t *f) {
+  int status;
+
+  switch (f->step) {
+  case STEP_OPEN:
+    status = open(f->path, f->flags, 0666);
+    break;
+  case STEP_WRITE:
+    do {
+      status = (int)writev(f->fd, f->iov, f->iovcnt);
+    } while ((status < 0) && (errno == EINTR));
+    break;
+  case STEP_FSYNC:
+    status = fsync(f->fd);
+    break;
+  case STEP_CLOSE:
+    status = close(f->fd);
+    break;
+  default:
+    errno = EINVAL;
+    status = -1;
+  }
+
+  f->res = (status < 0) ? -errno : status;
+} /* void step_run */
+
+static void op_free(file_io_op_t *op, size_t *freed) {
+  if (op->pending)
+    *freed += op->len;
+  free(op->buf);
+  free(op);
+} /* void op_free */
+
+static void ops_pop(file_io_file_t *f, size_t *freed) {
+  file_io_op_t *op = f->ops_head;
+  f->ops_head = op->next;
+  if (f->ops_head == NULL)
+    f->ops_tail = NULL;
+  op_free(op, freed);
+} /* void ops_pop */
+
+/* Drops the operations up to a close, e.g. after opening the file failed. */
+static void ops_drop(file_io_file_t *f, size_t *freed) {
+  while ((f->ops_head != NULL) && (f->ops_head->type != OP_CLOSE))
+    ops_pop(f, freed);
+} /* void ops_drop */
+
+/* Prepares the next step of "f". Returns false if there is none, i.e. all
+ * operations of the file are done. */
+static bool step_prepare(file_io_file_t *f, size_t *freed) {
+  while (f->ops_head != NULL) {
+    file_io_op_t *op = f->ops_head;
+
+    if (f->fd < 0) {
+      if (op->type == OP_APPEND) {
+        f->step = STEP_OPEN;
+        f->flags = O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC;
+        if ((f->header != NULL) && !f->exists)
+          f->flags |= O_EXCL;
+        return true;
+      }
+
+      /* Nothing to sync or close. */
+      if (op->type == OP_CLOSE)
+        f->closed = true;
+      ops_pop(f, freed);
+      continue;
+    }
+
+    switch (op->type) {
+    case OP_APPEND:
+      f->step = STEP_WRITE;
+      f->iovcnt = 0;
+      for (file_io_op_t *o = op; (o != NULL) && (o->type == OP_APPEND) &&
+                                 (f->iovcnt < FILE_IO_IOV_MAX);
+           o = o->next) {
+        f->iov[f->iovcnt].iov_base = o->buf + o->done;
+        f->iov[f->iovcnt].iov_len = o->len - o->done;
+        f->iovcnt++;
+      }
+      return true;
+    case OP_FSYNC:
+      f->step = STEP_FSYNC;
+      return true;
+    case OP_CLOSE:
+      f->step = STEP_CLOSE;
+      return true;
+    }
+  }
+
+  return false;
+} /* bool step_prepare */
+
+static void step_complete(file_io_t *io, file_io_file_t *f, size_t *freed) {
+  if (f->step == STEP_OPEN) {
+    if (f->res >= 0) {
+      f->fd = f->res;
+      /* The file has been created, write the header first. */
+      if (f->flags & O_EXCL) {
+        file_io_op_t *op = calloc(1, sizeof(*op));
+        if (op != NULL) {
+          op->type = OP_APPEND;
+          op->buf = f->header;
+          op->len = strlen(f->header);
+          op->next = f->ops_head;
+          f->ops_head = op;
+          f->header = NULL;
+        }
+      }
+    } else if ((f->res == -EEXIST) && !f->exists) {
+      f->exists = true;
+    } else if ((f->res == -ENOENT) && !f->dir_created) {
+      f->dir_created = true;
+      check_create_dir(f->path);
+    } else {
+      if (io->error != NULL)
+        io->error(f->path, "open", -f->res, io->arg);
+      ops_drop(f, freed);
+      f->exists = false;
+      f->dir_created = false;
+    }
+    return;
+  }
+
+  if (f->step == STEP_WRITE) {
+    if (f->res <= 0) {
+      if (io->error != NULL)
+        io->error(f->path, "write", (f->res < 0) ? -f->res : EIO, io->arg);
+      for (int i = 0; i < f->iovcnt; i++)
+        ops_pop(f, freed);
+      return;
+    }
+
+    /* Continues with the rest after a short write. */
+    size_t written = (size_t)f->res;
+    while ((written > 0) && (f->ops_head != NULL)) {
+      file_io_op_t *op = f->ops_head;
+      size_t n = op->len - op->done;
+      if (n > written)
+        n = written;
+      op->done += n;
+      written -= n;
+      if (op->done == op->len)
+        ops_pop(f, freed);
+    }
+    return;
+  }
+
+  if (f->res < 0) {
+    if (io->error != NULL)
+      io->error(f->path, (f->step == STEP_FSYNC) ? "fsync" : "close", -f->res,
+                io->arg);
+  }
+  if (f->step == STEP_CLOSE) {
+    f->fd = -1;
+    f->closed = true;
+  }
+  ops_pop(f, freed);
+} /* void step_complete */
+
+static void file_free(file_io_file_t *f) {
+  free(f->close_op);
+  free(f->header);
+  free(f->path);
+  free(f);
+} /* void file_free */
+
+/* Does the operations of the files on the "work" list. Returns the number of
+ * bytes of appends that are done. */
+static size_t file_io_run(file_io_t *io, file_io_file_t *work) {
+  size_t freed = 0;
+
+  while (work != NULL) {
+    file_io_file_t *active[FILE_IO_BATCH];
+    size_t active_num = 0;
+
+    file_io_file_t **pp = &work;
+    while (*pp != NULL) {
+      file_io_file_t *f = *pp;
+      if (!step_prepare(f, &freed)) {
+        *pp = f->work_next;
+        if (f->closed)
+          file_free(f);
+        continue;
+      }
+      pp = &f->work_next;
+
+      if (active_num < FILE_IO_BATCH)
+        active[active_num++] = f;
+    }
+
+    if (active_num == 0)
+      break;
+
+#if FILE_IO_URING
+    if (io->uring != NULL) {
+      bool completed[FILE_IO_BATCH];
+      size_t submitted = 0;
+      int status =
+          uring_run(io->uring, active, active_num, completed, &submitted);
+      if (status != 0) {
+        /* The ring isn't used again. Steps that have been submitted but not
+         * completed may or may not have been done, so they count as failed.
+         * The others are done by this thread. */
+        if (io->error != NULL)
+          io->error("io_uring", "io_uring_enter", status, io->arg);
+        uring_destroy(io->uring);
+        io->uring = NULL;
+        for (size_t i = 0; i < active_num; i++) {
+          if (completed[i])
+            continue;
+          if (i < submitted)
+            active[i]->res = -ECANCELED;
+          else
+            step_run(active[i]);
+        }
+      }
+    } else
+#endif
+      for (size_t i = 0; i < active_num; i++)
+        step_run(active[i]);
+
+    for (size_t i = 0; i < active_num; i++)
+      step_complete(io, active[i], &freed);
+  }
+
+  return freed;
+} /* size_t file_io_run */
+
+static void *file_io_thread(void *arg) {
+  file_io_t *io = arg;
+
+  pthread_mutex_lock(&io->lock);
+  while (true) {
+    while ((io->queue_head == NULL) && !io->stopping)
+      pthread_cond_wait(&io->cond, &io->lock);
+
+    if (io->queue_head == NULL)
+      break;
+
+    file_io_file_t *work = NULL;
+    while (io->queue_head != NULL) {
+      file_io_file_t *f = io->queue_head;
+      io->queue_head = f->queue_next;
+
+      if (f->ops_tail != NULL)
+        f->ops_tail->next = f->queued_head;
+      else
+        f->ops_head = f->queued_head;
+      f->ops_tail = f->queued_tail;
+      f->queued_head = f->queued_tail = NULL;
+      f->queued = false;
+      f->queue_next = NULL;
+
+      f->work_next = work;
+      work = f;
+    }
+    io->queue_tail = NULL;
+    io->busy = true;
+    pthread_mutex_unlock(&io->lock);
+
+    size_t freed = file_io_run(io, work);
+
+    pthread_mutex_lock(&io->lock);
+    io->pending -= freed;
+    io->busy = false;
+    pthread_cond_broadcast(&io->done_cond);
+  }
+  pthread_mutex_unlock(&io->lock);
+
+  return NULL;
+} /* void *file_io_thread */
+
+file_io_t *file_io_create(size_t max_pending, bool use_uring,
+                          file_io_error_cb error, void *arg) {
+  file_io_t *io = calloc(1, sizeof(*io));
+  if (io == NULL)
+    return NULL;
+
+  io->max_pending = max_pending;
+  io->error = error;
+  io->arg = arg;
+#if FILE_IO_URING
+  if (use_uring)
+    io->uring = uring_create();
+#endif
+
+  pthread_mutex_init(&io->lock, NULL);
+  pthread_cond_init(&io->cond, NULL);
+  pthread_cond_init(&io->done_cond, NULL);
+
+  int status = pthread_create(&io->thread, NULL, file_io_thread, io);
+  if (status != 0) {
+#if FILE_IO_URING
+    uring_destroy(io->uring);
+#endif
+    pthread_cond_destroy(&io->done_cond);
+    pthread_cond_destroy(&io->cond);
+    pthread_mutex_destroy(&io->lock);
+    free(io);
+    errno = status;
+    return NULL;
+  }
+
+  return io;
+} /* file_io_t *file_io_create */
+
+/* Adds an operation to the queue of "f". Requires the lock. */
+static void file_io_enqueue(file_io_file_t *f, file_io_op_t *op) {
+  file_io_t *io = f->io;
+
+  if (f->queued_tail != NULL)
+    f->queued_tail->next = op;
+  else
+    f->queued_head = op;
+  f->queued_tail = op;
+
+  if (!f->queued) {
+    f->queued = true;
+    f->queue_next = NULL;
+    if (io->queue_tail != NULL)
+      io->queue_tail->queue_next = f;
+    else
+      io->queue_head = f;
+    io->queue_tail = f;
+  }
+
+  pthread_cond_signal(&io->cond);
+} /* void file_io_enqueue */
+
+static int file_io_submit(file_io_file_t *f, file_io_op_type_t type,
+                          void const *buf, size_t len) {
+  file_io_op_t *op = calloc(1, sizeof(*op));
+  if (op == NULL)
+    return ENOMEM;
+  op->type = type;
+
+  if (type == OP_APPEND) {
+    op->buf = malloc(len);
+    if (op->buf == NULL) {
+      free(op);
+      return ENOMEM;
+    }
+    memcpy(op->buf, buf, len);
+    op->len = len;
+    op->pending = true;
+  }
+
+  file_io_t *io = f->io;
+  pthread_mutex_lock(&io->lock);
+  if ((type == OP_APPEND) && (io->pending + len > io->max_pending)) {
+    pthread_mutex_unlock(&io->lock);
+    free(op->buf);
+    free(op);
+    return ENOBUFS;
+  }
+  io->pending += op->len;
+  file_io_enqueue(f, op);
+  pthread_mutex_unlock(&io->lock);
+
+  return 0;
+} /* int file_io_submit */
+
+file_io_file_t *file_io_open(file_io_t *io, char const *path,
+                             char const *header) {
+  file_io_file_t *f = calloc(1, sizeof(*f));
+  if (f == NULL)
+    return NULL;
+
+  f->io = io;
+  f->fd = -1;
+  f->path = strdup(path);
+  f->close_op = calloc(1, sizeof(*f->close_op));
+  if ((f->path == NULL) || (f->close_op == NULL)) {
+    file_free(f);
+    return NULL;
+  }
+  if ((header != NULL) && (header[0] != 0)) {
+    f->header = strdup(header);
+    if (f->header == NULL) {
+      file_free(f);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_lock(&io->lock);
+  file_io_file_t **tmp =
+      realloc(io->files, (io->files_num + 1) * sizeof(*io->files));
+  if (tmp == NULL) {
+    pthread_mutex_unlock(&io->lock);
+    file_free(f);
+    return NULL;
+  }
+  io->files = tmp;
+  io->files[io->files_num] = f;
+  io->files_num++;
+  pthread_mutex_unlock(&io->lock);
+
+  return f;
+} /* file_io_file_t *file_io_open */
+
+int file_io_append(file_io_file_t *f, void const *buf, size_t len) {
+  if (len == 0)
+    return 0;
+  return file_io_submit(f, OP_APPEND, buf, len);
+} /* int file_io_append */
+
+int file_io_fsync(file_io_file_t *f) {
+  return file_io_submit(f, OP_FSYNC, NULL, 0);
+} /* int file_io_fsync */
+
+void file_io_close(file_io_file_t *f) {
+  if (f == NULL)
+    return;
+
+  file_io_t *io = f->io;
+  pthread_mutex_lock(&io->lock);
+
+  for (size_t i = 0; i < io->files_num; i++) {
+    if (io->files[i] != f)
+      continue;
+    io->files[i] = io->files[io->files_num - 1];
+    io->files_num--;
+    break;
+  }
+
+  /* The thread frees the file after closing it. */
+  file_io_op_t *op = f->close_op;
+  f->close_op = NULL;
+  op->type = OP_CLOSE;
+  file_io_enqueue(f, op);
+  pthread_mutex_unlock(&io->lock);
+} /* void file_io_close */
+
+void file_io_wait(file_io_t *io) {
+  pthread_mutex_lock(&io->lock);
+  while ((io->queue_head != NULL) || io->busy)
+    pthread_cond_wait(&io->done_cond, &io->lock);
+  pthread_mutex_unlock(&io->lock);
+} /* void file_io_wait */
+
+char const *file_io_backend(file_io_t *io) {
+#if FILE_IO_URING
+  if (io->uring != NULL)
+    return "io_uring";
+#endif
+  return "thread";
+} /* char const *file_io_backend */
+
+void file_io_destroy(file_io_t *io) {
+  if (io == NULL)
+    return;
+
+  while (true) {
+    pthread_mutex_lock(&io->lock);
+    if (io->files_num == 0) {
+      pthread_mutex_unlock(&io->lock);
+      break;
+    }
+    file_io_file_t *f = io->files[io->files_num - 1];
+    pthread_mutex_unlock(&io->lock);
+    file_io_close(f);
+  }
+
+  pthread_mutex_lock(&io->lock);
+  io->stopping = true;
+  pthread_cond_signal(&io->cond);
+  pthread_mutex_unlock(&io->lock);
+
+  pthread_join(io->thread, NULL);
+
+#if FILE_IO_URING
+  uring_destroy(io->uring);
+#endif
+  free(io->files);
+  pthread_cond_destroy(&io->done_cond);
+  pthread_cond_destroy(&io->cond);
+  pthread_mutex_destroy(&io->lock);
+  free(io);
+} /* void file_io_destroy */
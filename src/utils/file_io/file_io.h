@@ -0,0 +1,106 @@
+/**
+ * collectd - src/utils/file_io/file_io.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_FILE_IO_H
+#define UTILS_FILE_IO_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The file I/O service takes blocking file operations off the threads of the
+ * callers. Files are opened, appended to, synced and closed by a thread of the
+ * service, so a stalling disk doesn't hold up e.g. the write threads. The
+ * operations on a file are done in the order they were submitted, operations
+ * on different files concurrently. On Linux, the operations are submitted to
+ * an io_uring; where that isn't available, the thread does them one by one.
+ *
+ * Since the operations complete later, failures are reported to the error
+ * callback, on the thread of the service. */
+
+#define FILE_IO_MAX_PENDING (16 * 1024 * 1024)
+
+/* Called when an operation fails. "op" is the name of the operation, e.g.
+ * "open" or "write", "status" an errno value. */
+typedef void (*file_io_error_cb)(char const *path, char const *op, int status,
+                                 void *arg);
+
+struct file_io_s;
+typedef struct file_io_s file_io_t;
+
+struct file_io_file_s;
+typedef struct file_io_file_s file_io_file_t;
+
+/*
+ * NAME
+ *   file_io_create
+ *
+ * DESCRIPTION
+ *   Creates a service and starts its thread. At most "max_pending" bytes are
+ *   buffered for appending at any time. If "use_uring" is false, the
+ *   operations are never submitted to an io_uring.
+ *
+ * RETURN VALUE
+ *   A file_io_t-pointer upon success or NULL upon failure.
+ */
+file_io_t *file_io_create(size_t max_pending, bool use_uring,
+                          file_io_error_cb error, void *arg);
+
+/* Waits for all operations to complete, stops the thread and frees the
+ * service. Files that are still open are closed. */
+void file_io_destroy(file_io_t *io);
+
+/* Returns the name of the backend in use, "io_uring" or "thread". */
+char const *file_io_backend(file_io_t *io);
+
+/* Waits until all operations submitted so far have completed. */
+void file_io_wait(file_io_t *io);
+
+/*
+ * NAME
+ *   file_io_open
+ *
+ * DESCRIPTION
+ *   Returns a handle for appending to "path". The file is opened by the
+ *   service before the first operation on it, creating it and the directories
+ *   leading up to it if necessary. When the file is created, "header" (if not
+ *   NULL) is written first. If opening fails, the operations are dropped and
+ *   opening is tried again with the next operations.
+ *
+ * RETURN VALUE
+ *   A file_io_file_t-pointer upon success or NULL upon failure.
+ */
+file_io_file_t *file_io_open(file_io_t *io, char const *path,
+                             char const *header);
+
+/* Appends a copy of "buf" to the file. Returns ENOBUFS if that would exceed
+ * the bytes that may be pending, zero upon success. */
+int file_io_append(file_io_file_t *f, void const *buf, size_t len);
+
+/* Flushes what has been appended so far to the disk. */
+int file_io_fsync(file_io_file_t *f);
+
+/* Closes the file once the operations before have completed. The handle must
+ * not be used afterwards. */
+void file_io_close(file_io_file_t *f);
+
+#endif /* UTILS_FILE_IO_H */
@@ -0,0 +1,130 @@
+/**
+ * collectd - src/utils/file_io/file_io_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/file_io/file_io.h"
+
+#include <sys/stat.h>
+
+static char errors[1024];
+
+static void error_cb(char const *path, char const *op, int status,
+                     void *arg) {
+  size_t len = strlen(errors);
+  snprintf(errors + len, sizeof(errors) - len, "%s %d\n", op, status);
+}
+
+static int read_file(char const *path, char *buf, size_t size) {
+  FILE *fh = fopen(path, "r");
+  if (fh == NULL)
+    return -1;
+  size_t n = fread(buf, 1, size - 1, fh);
+  buf[n] = 0;
+  fclose(fh);
+  return 0;
+}
+
+static int test_backend(bool use_uring) {
+  char dir[] = "/tmp/collectd_file_io_test.XXXXXX";
+  CHECK_NOT_NULL(mkdtemp(dir));
+
+  char path[PATH_MAX];
+  char other[PATH_MAX];
+  char subdir[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/sub/a.csv", dir);
+  snprintf(other, sizeof(other), "%s/b.csv", dir);
+  snprintf(subdir, sizeof(subdir), "%s/sub", dir);
+
+  file_io_t *io;
+  errors[0] = 0;
+  CHECK_NOT_NULL(io = file_io_create(64, use_uring, error_cb, NULL));
+  printf("backend: %s\n", file_io_backend(io));
+  if (!use_uring)
+    EXPECT_EQ_STR("thread", file_io_backend(io));
+
+  /* The file and its directory are created, and the header is written
+   * first. */
+  file_io_file_t *f;
+  CHECK_NOT_NULL(f = file_io_open(io, path, "epoch,value\n"));
+  char line[32];
+  for (int i = 0; i < 3; i++) {
+    snprintf(line, sizeof(line), "%d,%d\n", i, i * 10);
+    EXPECT_EQ_INT(0, file_io_append(f, line, strlen(line)));
+  }
+  EXPECT_EQ_INT(0, file_io_fsync(f));
+  file_io_wait(io);
+
+  char buf[256];
+  CHECK_ZERO(read_file(path, buf, sizeof(buf)));
+  EXPECT_EQ_STR("epoch,value\n0,0\n1,10\n2,20\n", buf);
+
+  /* More than "max_pending" bytes can't be buffered. */
+  char big[66] = {0};
+  memset(big, 'x', sizeof(big) - 1);
+  EXPECT_EQ_INT(ENOBUFS, file_io_append(f, big, sizeof(big) - 1));
+  file_io_close(f);
+
+  /* An existing file is appended to without the header. */
+  CHECK_NOT_NULL(f = file_io_open(io, path, "epoch,value\n"));
+  EXPECT_EQ_INT(0, file_io_append(f, "3,30\n", 5));
+  file_io_close(f);
+
+  /* Operations on a file that can't be opened are dropped. */
+  mkdir(other, 0755);
+  CHECK_NOT_NULL(f = file_io_open(io, other, NULL));
+  EXPECT_EQ_INT(0, file_io_append(f, "dropped\n", 8));
+  file_io_wait(io);
+  char expect[64];
+  snprintf(expect, sizeof(expect), "open %d\n", EISDIR);
+  EXPECT_EQ_STR(expect, errors);
+  rmdir(other);
+
+  /* Once it can be opened, the file is written to. Open files are closed
+   * when the service is destroyed. */
+  EXPECT_EQ_INT(0, file_io_append(f, "kept\n", 5));
+  file_io_destroy(io);
+
+  CHECK_ZERO(read_file(path, buf, sizeof(buf)));
+  EXPECT_EQ_STR("epoch,value\n0,0\n1,10\n2,20\n3,30\n", buf);
+  CHECK_ZERO(read_file(other, buf, sizeof(buf)));
+  EXPECT_EQ_STR("kept\n", buf);
+
+  unlink(path);
+  unlink(other);
+  rmdir(subdir);
+  rmdir(dir);
+  return 0;
+}
+
+DEF_TEST(thread) { return test_backend(false); }
+
+DEF_TEST(uring) { return test_backend(true); }
+
+int main(void) {
+  RUN_TEST(thread);
+  RUN_TEST(uring);
+
+  END_TEST;
+}
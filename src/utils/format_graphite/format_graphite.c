@@ -34,46 +34,94 @@
 /* Utils functions to format data sets in graphite format.
  * Largely taken from write_graphite.c as it remains the same formatting */
 
+/* Number of sets and ways of the per-thread cache of metric paths. */
+#define GR_PATH_CACHE_SETS 4096
+#define GR_PATH_CACHE_WAYS 2
+
+/* Longest output of gr_format_uint(), i.e. UINT64_MAX. */
+#define GR_UINT_MAX_LEN 20
+
+/* gr_format_uint writes the decimal representation of "n" to "ret", which
+ * must have room for GR_UINT_MAX_LEN bytes. Returns the number of bytes
+ * written. No null byte is written. */
+static size_t gr_format_uint(char *ret, uint64_t n) {
+  char tmp[GR_UINT_MAX_LEN];
+  size_t len = 0;
+
+  do {
+    tmp[sizeof(tmp) - 1 - len] = (char)('0' + (n % 10));
+    n /= 10;
+    len++;
+  } while (n != 0);
+
+  memcpy(ret, tmp + sizeof(tmp) - len, len);
+  return len;
+}
+
+static size_t gr_format_int(char *ret, int64_t n) {
+  if (n >= 0)
+    return gr_format_uint(ret, (uint64_t)n);
+
+  ret[0] = '-';
+  return 1 + gr_format_uint(ret + 1, -(uint64_t)n);
+}
+
+/* gr_format_integral handles the common case of a floating point value
+ * without fractional part, which "%.15g" and "%f" print as an integer (with
+ * six zero decimals in the latter case). Returns zero if "v" needs to be
+ * formatted with snprintf(). */
+static size_t gr_format_integral(char *ret, double v, bool decimals) {
+  /* Beyond 1e15, "%.15g" switches to the exponential notation. */
+  if (!isfinite(v) || (fabs(v) >= 1e15) || (v != floor(v)) ||
+      ((v == 0.0) && signbit(v)))
+    return 0;
+
+  size_t len = gr_format_int(ret, (int64_t)v);
+  if (decimals) {
+    memcpy(ret + len, ".000000", strlen(".000000"));
+    len += strlen(".000000");
+  }
+  return len;
+}
+
+/* gr_format_values formats the value of data source "ds_num" into "ret".
+ * Returns the length of the string or less than zero on error. */
 static int gr_format_values(char *ret, size_t ret_len, int ds_num,
                             const data_set_t *ds, const value_list_t *vl,
                             gauge_t const *rates) {
-  size_t offset = 0;
   int status;
 
   assert(0 == strcmp(ds->type, vl->type));
-
-  memset(ret, 0, ret_len);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(ret + offset, ret_len - offset, __VA_ARGS__);            \
-    if (status < 1) {                                                          \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (ret_len - offset)) {                       \
-      return -1;                                                               \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  if (ds->ds[ds_num].type == DS_TYPE_GAUGE)
-    BUFFER_ADD(GAUGE_FORMAT, vl->values[ds_num].gauge);
-  else if (rates != NULL)
-    BUFFER_ADD("%f", rates[ds_num]);
-  else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
-    BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[ds_num].counter);
+  assert(ret_len > GR_UINT_MAX_LEN + strlen(".000000"));
+
+  if (ds->ds[ds_num].type == DS_TYPE_GAUGE) {
+    /* The shortcut is only valid for the default format. */
+    status = 0;
+    if (strcmp(GAUGE_FORMAT, "%.15g") == 0)
+      status = (int)gr_format_integral(ret, vl->values[ds_num].gauge, false);
+    if (status == 0)
+      status = snprintf(ret, ret_len, GAUGE_FORMAT, vl->values[ds_num].gauge);
+  } else if (rates != NULL) {
+    status = (int)gr_format_integral(ret, rates[ds_num], true);
+    if (status == 0)
+      status = snprintf(ret, ret_len, "%f", rates[ds_num]);
+  } else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
+    status = (int)gr_format_uint(ret, (uint64_t)vl->values[ds_num].counter);
   else if (ds->ds[ds_num].type == DS_TYPE_DERIVE)
-    BUFFER_ADD("%" PRIi64, vl->values[ds_num].derive);
+    status = (int)gr_format_int(ret, vl->values[ds_num].derive);
   else if (ds->ds[ds_num].type == DS_TYPE_ABSOLUTE)
-    BUFFER_ADD("%" PRIu64, vl->values[ds_num].absolute);
+    status = (int)gr_format_uint(ret, vl->values[ds_num].absolute);
   else {
     P_ERROR("gr_format_values: Unknown data source type: %i",
             ds->ds[ds_num].type);
     return -1;
   }
 
-#undef BUFFER_ADD
+  if ((status < 1) || ((size_t)status >= ret_len))
+    return -1;
 
-  return 0;
+  ret[status] = 0;
+  return status;
 }
 
 static void gr_copy_escape_part(char *dst, const char *src, size_t dst_len,
@@ -83,17 +131,18 @@ static void gr_copy_escape_part(char *dst, const char *src, size_t dst_len,
   if (src == NULL)
     return;
 
-  for (size_t i = 0; i < dst_len; i++) {
-    if (src[i] == 0) {
-      dst[i] = 0;
-      break;
-    }
-
-    if ((!preserve_separator && (src[i] == '.')) || isspace((int)src[i]) ||
-        iscntrl((int)src[i]))
-      dst[i] = escape_char;
-    else
-      dst[i] = src[i];
+  /* Spaces and control characters, as isspace(3) and iscntrl(3) in the C
+   * locale, and the separator are replaced. */
+  char const *specials = preserve_separator ? " \x7f" : ". \x7f";
+  size_t len = strnlen(src, dst_len);
+  size_t i = 0;
+  while (i < len) {
+    size_t plain = strspan_plain(src + i, len - i, specials,
+                                 /* control = */ true);
+    memcpy(dst + i, src + i, plain);
+    i += plain;
+    if (i < len)
+      dst[i++] = escape_char;
   }
 }
 
@@ -252,12 +301,227 @@ static void escape_graphite_string(char *buffer, char escape_char) {
     *head = escape_char;
 }
 
+/* gr_format_key writes the escaped metric path of data source "ds_num" to
+ * "key". */
+static int gr_format_key(char *key, size_t key_size, data_set_t const *ds,
+                         value_list_t const *vl, size_t ds_num,
+                         char const *prefix, char const *postfix,
+                         char const escape_char, unsigned int flags) {
+  char const *ds_name = NULL;
+  int status;
+
+  if ((flags & GRAPHITE_ALWAYS_APPEND_DS) || (ds->ds_num > 1))
+    ds_name = ds->ds[ds_num].name;
+
+  /* Copy the identifier to `key' and escape it. */
+  if (flags & GRAPHITE_USE_TAGS) {
+    status = gr_format_name_tagged(key, (int)key_size, vl, ds_name, prefix,
+                                   postfix, escape_char, flags);
+    if (status != 0) {
+      P_ERROR("format_graphite: error with gr_format_name_tagged");
+      return status;
+    }
+  } else {
+    status = gr_format_name(key, (int)key_size, vl, ds_name, prefix, postfix,
+                            escape_char, flags);
+    if (status != 0) {
+      P_ERROR("format_graphite: error with gr_format_name");
+      return status;
+    }
+  }
+
+  escape_graphite_string(key, escape_char);
+  return 0;
+}
+
+/* The metric paths of a value list rarely change, so the escaped paths of all
+ * data sources are cached per thread. An entry matches if the identifier
+ * fields, the data set and all formatting options are equal. "strings" holds
+ * the identifier fields, prefix and postfix, each followed by a null byte,
+ * and then the keys. Key "i" starts at "keys_off[i]" and ends before
+ * "keys_off[i + 1]" with a null byte. */
+typedef struct {
+  uint64_t hash;
+  data_set_t const *ds;
+  unsigned int flags;
+  char escape_char;
+  size_t id_len;
+  size_t keys_off[];
+} gr_path_t;
+
+#define GR_PATH_STRINGS(path)                                                  \
+  ((char *)((path)->keys_off + (path)->ds->ds_num + 1))
+#define GR_PATH_KEY(path, i) (GR_PATH_STRINGS(path) + (path)->keys_off[i])
+#define GR_PATH_KEY_LEN(path, i)                                               \
+  ((path)->keys_off[(i) + 1] - (path)->keys_off[i] - 1)
+
+/* Each set is ordered by the time of the last use, most recent first. */
+typedef struct {
+  gr_path_t *paths[GR_PATH_CACHE_SETS][GR_PATH_CACHE_WAYS];
+} gr_path_cache_t;
+
+static pthread_key_t gr_path_cache_key;
+static pthread_once_t gr_path_cache_once = PTHREAD_ONCE_INIT;
+static bool gr_path_cache_ok;
+
+static void gr_path_cache_free(void *arg) {
+  gr_path_cache_t *cache = arg;
+  if (cache == NULL)
+    return;
+
+  for (size_t i = 0; i < GR_PATH_CACHE_SETS; i++)
+    for (size_t j = 0; j < GR_PATH_CACHE_WAYS; j++)
+      sfree(cache->paths[i][j]);
+  sfree(cache);
+}
+
+static void gr_path_cache_init(void) {
+  gr_path_cache_ok =
+      (pthread_key_create(&gr_path_cache_key, gr_path_cache_free) == 0);
+}
+
+/* gr_path_id writes the identifier fields, prefix and postfix to "id" and
+ * returns the number of bytes used. */
+static size_t gr_path_id(char *id, value_list_t const *vl, char const *prefix,
+                         char const *postfix) {
+  char const *parts[] = {vl->host,   vl->plugin,        vl->plugin_instance,
+                         vl->type,   vl->type_instance, prefix,
+                         postfix};
+  size_t len = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    size_t part_len = strlen(parts[i]);
+    memcpy(id + len, parts[i], part_len + 1);
+    len += part_len + 1;
+  }
+
+  return len;
+}
+
+/* FNV-1a */
+static uint64_t gr_path_hash(char const *id, size_t id_len,
+                             data_set_t const *ds, unsigned int flags,
+                             char escape_char) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < id_len; i++) {
+    hash ^= (uint8_t)id[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= ((uint64_t)(uintptr_t)ds) ^ ((uint64_t)flags << 8) ^
+          (uint8_t)escape_char;
+  hash *= 1099511628211ULL;
+
+  return hash;
+}
+
+static gr_path_t *gr_path_create(char const *id, size_t id_len, uint64_t hash,
+                                 data_set_t const *ds, value_list_t const *vl,
+                                 char const *prefix, char const *postfix,
+                                 char const escape_char, unsigned int flags) {
+  /* The keys are formatted into the entry directly. It is allocated for the
+   * longest possible keys first and shrunk afterwards. */
+  size_t key_size = 10 * DATA_MAX_NAME_LEN;
+  size_t head_size = sizeof(gr_path_t) + (ds->ds_num + 1) * sizeof(size_t);
+  gr_path_t *path = malloc(head_size + id_len + ds->ds_num * key_size);
+  if (path == NULL)
+    return NULL;
+
+  *path = (gr_path_t){
+      .hash = hash,
+      .ds = ds,
+      .flags = flags,
+      .escape_char = escape_char,
+      .id_len = id_len,
+  };
+  char *strings = GR_PATH_STRINGS(path);
+  memcpy(strings, id, id_len);
+
+  size_t offset = id_len;
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    if (gr_format_key(strings + offset, key_size, ds, vl, i, prefix, postfix,
+                      escape_char, flags) != 0) {
+      sfree(path);
+      return NULL;
+    }
+    path->keys_off[i] = offset;
+    offset += strlen(strings + offset) + 1;
+  }
+  path->keys_off[ds->ds_num] = offset;
+
+  gr_path_t *tmp = realloc(path, head_size + offset);
+  return (tmp != NULL) ? tmp : path;
+}
+
+/* gr_path_get returns the cached metric paths of "vl", creating them if
+ * necessary. The returned entry belongs to the calling thread's cache and is
+ * valid until the next call. Returns NULL if the cache is not available. */
+static gr_path_t *gr_path_get(data_set_t const *ds, value_list_t const *vl,
+                              char const *prefix, char const *postfix,
+                              char const escape_char, unsigned int flags) {
+  pthread_once(&gr_path_cache_once, gr_path_cache_init);
+  if (!gr_path_cache_ok)
+    return NULL;
+
+  gr_path_cache_t *cache = pthread_getspecific(gr_path_cache_key);
+  if (cache == NULL) {
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+      return NULL;
+    if (pthread_setspecific(gr_path_cache_key, cache) != 0) {
+      sfree(cache);
+      return NULL;
+    }
+  }
+
+  if (prefix == NULL)
+    prefix = "";
+  if (postfix == NULL)
+    postfix = "";
+
+  /* Unusually long prefixes are not cached. */
+  char id[9 * DATA_MAX_NAME_LEN];
+  if ((strlen(prefix) + strlen(postfix) + 2) > 4 * DATA_MAX_NAME_LEN)
+    return NULL;
+  size_t id_len = gr_path_id(id, vl, prefix, postfix);
+  uint64_t hash = gr_path_hash(id, id_len, ds, flags, escape_char);
+
+  gr_path_t **set = cache->paths[hash % GR_PATH_CACHE_SETS];
+  size_t way;
+  for (way = 0; way < GR_PATH_CACHE_WAYS; way++) {
+    gr_path_t *path = set[way];
+    if ((path != NULL) && (path->hash == hash) && (path->ds == ds) &&
+        (path->flags == flags) && (path->escape_char == escape_char) &&
+        (path->id_len == id_len) &&
+        (memcmp(GR_PATH_STRINGS(path), id, id_len) == 0))
+      break;
+  }
+
+  gr_path_t *path;
+  if (way < GR_PATH_CACHE_WAYS) {
+    path = set[way];
+  } else {
+    path = gr_path_create(id, id_len, hash, ds, vl, prefix, postfix,
+                          escape_char, flags);
+    if (path == NULL)
+      return NULL;
+
+    /* Replace the least recently used entry. */
+    way = GR_PATH_CACHE_WAYS - 1;
+    sfree(set[way]);
+  }
+
+  memmove(set + 1, set, way * sizeof(*set));
+  set[0] = path;
+  return path;
+}
+
 int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
                     value_list_t const *vl, char const *prefix,
                     char const *postfix, char const escape_char,
                     unsigned int flags) {
   int status = 0;
-  int buffer_pos = 0;
+  size_t buffer_pos = 0;
 
   gauge_t *rates = NULL;
   if (flags & GRAPHITE_STORE_RATES) {
@@ -268,51 +532,46 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
     }
   }
 
+  gr_path_t *path = gr_path_get(ds, vl, prefix, postfix, escape_char, flags);
+
+  char time_str[GR_UINT_MAX_LEN];
+  size_t time_len = gr_format_uint(
+      time_str, (uint64_t)(unsigned int)CDTIME_T_TO_TIME_T(vl->time));
+
   for (size_t i = 0; i < ds->ds_num; i++) {
-    char const *ds_name = NULL;
-    char key[10 * DATA_MAX_NAME_LEN];
+    char key_buffer[10 * DATA_MAX_NAME_LEN];
+    char const *key;
+    size_t key_len;
     char values[512];
-    size_t message_len;
-    char message[1024];
 
-    if ((flags & GRAPHITE_ALWAYS_APPEND_DS) || (ds->ds_num > 1))
-      ds_name = ds->ds[i].name;
-
-    /* Copy the identifier to `key' and escape it. */
-    if (flags & GRAPHITE_USE_TAGS) {
-      status = gr_format_name_tagged(key, sizeof(key), vl, ds_name, prefix,
-                                     postfix, escape_char, flags);
-      if (status != 0) {
-        P_ERROR("format_graphite: error with gr_format_name_tagged");
-        sfree(rates);
-        return status;
-      }
+    if (path != NULL) {
+      key = GR_PATH_KEY(path, i);
+      key_len = GR_PATH_KEY_LEN(path, i);
     } else {
-      status = gr_format_name(key, sizeof(key), vl, ds_name, prefix, postfix,
-                              escape_char, flags);
+      status = gr_format_key(key_buffer, sizeof(key_buffer), ds, vl, i, prefix,
+                             postfix, escape_char, flags);
       if (status != 0) {
-        P_ERROR("format_graphite: error with gr_format_name");
         sfree(rates);
         return status;
       }
+      key = key_buffer;
+      key_len = strlen(key_buffer);
     }
 
-    escape_graphite_string(key, escape_char);
-
     /* Convert the values to an ASCII representation and put that into
      * `values'. */
     status = gr_format_values(values, sizeof(values), i, ds, vl, rates);
-    if (status != 0) {
+    if (status < 0) {
       P_ERROR("format_graphite: error with gr_format_values");
       sfree(rates);
       return status;
     }
+    size_t values_len = (size_t)status;
+    status = 0;
 
-    /* Compute the graphite command */
-    message_len =
-        (size_t)snprintf(message, sizeof(message), "%s %s %u\r\n", key, values,
-                         (unsigned int)CDTIME_T_TO_TIME_T(vl->time));
-    if (message_len >= sizeof(message)) {
+    /* Compute the graphite command: "<key> <value> <time>\r\n" */
+    size_t message_len = key_len + 1 + values_len + 1 + time_len + 2;
+    if (message_len >= 1024) {
       P_ERROR("format_graphite: message buffer too small: "
               "Need %" PRIsz " bytes.",
               message_len + 1);
@@ -326,7 +585,19 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
       sfree(rates);
       return -ENOMEM;
     }
-    memcpy((void *)(buffer + buffer_pos), message, message_len);
+
+    char *ptr = buffer + buffer_pos;
+    memcpy(ptr, key, key_len);
+    ptr += key_len;
+    *(ptr++) = ' ';
+    memcpy(ptr, values, values_len);
+    ptr += values_len;
+    *(ptr++) = ' ';
+    memcpy(ptr, time_str, time_len);
+    ptr += time_len;
+    *(ptr++) = '\r';
+    *(ptr++) = '\n';
+
     buffer_pos += message_len;
     buffer[buffer_pos] = '\0';
   }
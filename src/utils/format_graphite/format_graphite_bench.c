@@ -0,0 +1,115 @@
+/**
+ * collectd - src/utils/format_graphite/format_graphite_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Measures the throughput of format_graphite(). Build with
+ * "make bench_format_graphite"; call with the number of series and the number
+ * of rounds, e.g. "./bench_format_graphite 1000 1000". */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils/common/common.h"
+#include "utils/format_graphite/format_graphite.h"
+
+static size_t series_num = 1000;
+static value_list_t *vls;
+static value_t *values;
+static size_t bytes;
+
+static data_source_t dsrc[] = {
+    {"rx", DS_TYPE_DERIVE, 0, NAN},
+    {"tx", DS_TYPE_DERIVE, 0, NAN},
+};
+static data_set_t ds_gauge = {
+    "gauge", 1, &(data_source_t){"value", DS_TYPE_GAUGE, NAN, NAN}};
+static data_set_t ds_derive = {"if_octets", STATIC_ARRAY_SIZE(dsrc), dsrc};
+
+static int create_value_lists(void) {
+  vls = calloc(series_num, sizeof(*vls));
+  values = calloc(2 * series_num, sizeof(*values));
+  if ((vls == NULL) || (values == NULL))
+    return -1;
+
+  for (size_t i = 0; i < series_num; i++) {
+    value_list_t *vl = vls + i;
+    bool gauge = (i % 2) == 0;
+
+    vl->values = values + 2 * i;
+    vl->values_len = gauge ? 1 : 2;
+    vl->time = TIME_T_TO_CDTIME_T(1480063672);
+    vl->interval = TIME_T_TO_CDTIME_T(10);
+    sstrncpy(vl->host, "host.example.com", sizeof(vl->host));
+    sstrncpy(vl->plugin, gauge ? "memory" : "interface", sizeof(vl->plugin));
+    snprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "%zu", i / 100);
+    sstrncpy(vl->type, gauge ? "gauge" : "if_octets", sizeof(vl->type));
+    snprintf(vl->type_instance, sizeof(vl->type_instance), "instance-%zu", i);
+  }
+  return 0;
+}
+
+/* "ops" is the number of calls; each round formats every series once. */
+DEF_BENCH(format_graphite) {
+  char buffer[1428];
+  size_t rounds = ops / series_num;
+
+  BENCH_START;
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < series_num; i++) {
+      value_list_t *vl = vls + i;
+      data_set_t *ds = (vl->values_len == 1) ? &ds_gauge : &ds_derive;
+
+      if (vl->values_len == 1) {
+        vl->values[0].gauge = (r % 3 == 0) ? (gauge_t)r : (gauge_t)r / 7.0;
+      } else {
+        vl->values[0].derive = (derive_t)(r * i);
+        vl->values[1].derive = (derive_t)(r + i);
+      }
+
+      if (format_graphite(buffer, sizeof(buffer), ds, vl, "collectd.", NULL,
+                          '_', 0) != 0)
+        return -1;
+      bytes += strlen(buffer);
+    }
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  series_num = (argc > 1) ? (size_t)atoi(argv[1]) : 1000;
+  size_t rounds = (argc > 2) ? (size_t)atoi(argv[2]) : 1000;
+
+  if ((series_num == 0) || (create_value_lists() != 0)) {
+    fprintf(stderr, "Creating the value lists failed.\n");
+    return 1;
+  }
+
+  RUN_BENCH(format_graphite, series_num * rounds);
+  printf("%zu series, %zu rounds: %.1f MB/s\n", series_num, rounds,
+         ((double)bytes) / (1e6 * bench_time__));
+
+  free(vls);
+  free(values);
+  END_BENCH;
+}
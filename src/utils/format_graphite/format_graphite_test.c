@@ -199,9 +199,109 @@ DEF_TEST(null_termination) {
   return 0;
 }
 
+DEF_TEST(values) {
+  struct {
+    int ds_type;
+    value_t value;
+    char const *want; /* NULL: compare to GAUGE_FORMAT */
+  } cases[] = {
+      {DS_TYPE_GAUGE, {.gauge = 42}},
+      {DS_TYPE_GAUGE, {.gauge = -3}},
+      {DS_TYPE_GAUGE, {.gauge = 0.5}},
+      {DS_TYPE_GAUGE, {.gauge = 0.0}},
+      {DS_TYPE_GAUGE, {.gauge = -0.0}},
+      {DS_TYPE_GAUGE, {.gauge = 123456789012345.0}},
+      {DS_TYPE_GAUGE, {.gauge = 1e15}},
+      {DS_TYPE_GAUGE, {.gauge = -1e300}},
+      {DS_TYPE_GAUGE, {.gauge = NAN}},
+      {DS_TYPE_DERIVE, {.derive = -5}, "-5"},
+      {DS_TYPE_DERIVE, {.derive = INT64_MIN}, "-9223372036854775808"},
+      {DS_TYPE_COUNTER, {.counter = 0}, "0"},
+      {DS_TYPE_COUNTER, {.counter = UINT64_MAX}, "18446744073709551615"},
+      {DS_TYPE_ABSOLUTE, {.absolute = 1337}, "1337"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    data_set_t ds = {
+        .type = "single",
+        .ds_num = 1,
+        .ds = &(data_source_t){"value", cases[i].ds_type, NAN, NAN},
+    };
+    value_list_t vl = {
+        .values = &cases[i].value,
+        .values_len = 1,
+        .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+        .host = "example.com",
+        .plugin = "test",
+        .type = "single",
+    };
+
+    char value[64];
+    if (cases[i].want == NULL)
+      snprintf(value, sizeof(value), GAUGE_FORMAT, cases[i].value.gauge);
+    else
+      sstrncpy(value, cases[i].want, sizeof(value));
+
+    char want[128];
+    snprintf(want, sizeof(want), "example_com.test.single %s 1480063672\r\n",
+             value);
+
+    char got[128];
+    EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds, &vl, NULL, NULL,
+                                     '_', 0));
+    EXPECT_EQ_STR(want, got);
+  }
+
+  return 0;
+}
+
+/* The metric paths are cached; changing any part of the identifier or the
+ * options must not return a stale path. */
+DEF_TEST(cached_path) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 1},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "single",
+  };
+  char got[128];
+
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, NULL,
+                                   NULL, '_', 0));
+  EXPECT_EQ_STR("example_com.test.single 1 1480063672\r\n", got);
+
+  vl.values[0].gauge = 2;
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, NULL,
+                                   NULL, '_', 0));
+  EXPECT_EQ_STR("example_com.test.single 2 1480063672\r\n", got);
+
+  sstrncpy(vl.type_instance, "foo", sizeof(vl.type_instance));
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, NULL,
+                                   NULL, '_', 0));
+  EXPECT_EQ_STR("example_com.test.single-foo 2 1480063672\r\n", got);
+
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, "pre.",
+                                   NULL, '_', 0));
+  EXPECT_EQ_STR("pre.example_com.test.single-foo 2 1480063672\r\n", got);
+
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, "pre.",
+                                   NULL, '@', 0));
+  EXPECT_EQ_STR("pre.example@com.test.single-foo 2 1480063672\r\n", got);
+
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, "pre.",
+                                   NULL, '@', GRAPHITE_SEPARATE_INSTANCES));
+  EXPECT_EQ_STR("pre.example@com.test.single.foo 2 1480063672\r\n", got);
+
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(metric_name);
   RUN_TEST(null_termination);
+  RUN_TEST(values);
+  RUN_TEST(cached_path);
 
   END_TEST;
 }
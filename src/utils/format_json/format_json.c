@@ -43,359 +43,361 @@
 #endif
 #endif
 
-static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
-                              const char *string) {
-  size_t dst_pos;
+/* The value list formatter appends to a format_json_buffer_t. A buffer with
+ * "fixed" set wraps memory provided by the caller and is never grown. */
+static int json_reserve(format_json_buffer_t *b, size_t len) /* {{{ */
+{
+  /* One more byte for the terminating null byte. */
+  if ((b->size - b->len) > len)
+    return 0;
 
-  if ((buffer == NULL) || (string == NULL))
-    return -EINVAL;
+  if (b->fixed)
+    return -ENOMEM;
+
+  size_t size = (b->size > 0) ? b->size : FORMAT_JSON_BUFFER_MIN;
+  while ((size - b->len) <= len)
+    size *= 2;
 
-  if (buffer_size < 3)
+  char *tmp = realloc(b->data, size);
+  if (tmp == NULL)
     return -ENOMEM;
 
-  dst_pos = 0;
+  b->data = tmp;
+  b->size = size;
+  return 0;
+} /* }}} int json_reserve */
 
-#define BUFFER_ADD(c)                                                          \
-  do {                                                                         \
-    if (dst_pos >= (buffer_size - 1)) {                                        \
-      buffer[buffer_size - 1] = '\0';                                          \
-      return -ENOMEM;                                                          \
-    }                                                                          \
-    buffer[dst_pos] = (c);                                                     \
-    dst_pos++;                                                                 \
-  } while (0)
+static int json_add_mem(format_json_buffer_t *b, /* {{{ */
+                        char const *data, size_t len) {
+  int status = json_reserve(b, len);
+  if (status != 0)
+    return status;
 
-  /* Escape special characters */
-  BUFFER_ADD('"');
-  for (size_t src_pos = 0; string[src_pos] != 0; src_pos++) {
-    if ((string[src_pos] == '"') || (string[src_pos] == '\\')) {
-      BUFFER_ADD('\\');
-      BUFFER_ADD(string[src_pos]);
-    } else if (string[src_pos] <= 0x001F)
-      BUFFER_ADD('?');
-    else
-      BUFFER_ADD(string[src_pos]);
-  } /* for */
-  BUFFER_ADD('"');
-  buffer[dst_pos] = 0;
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  b->data[b->len] = 0;
+  return 0;
+} /* }}} int json_add_mem */
+
+#define json_add_str(b, str) json_add_mem((b), (str), strlen(str))
+
+static int json_add_uint(format_json_buffer_t *b, uint64_t n) /* {{{ */
+{
+  char tmp[20];
+  size_t pos = sizeof(tmp);
+
+  do {
+    tmp[--pos] = (char)('0' + (n % 10));
+    n /= 10;
+  } while (n != 0);
+
+  return json_add_mem(b, tmp + pos, sizeof(tmp) - pos);
+} /* }}} int json_add_uint */
+
+static int json_add_int(format_json_buffer_t *b, int64_t n) /* {{{ */
+{
+  if (n >= 0)
+    return json_add_uint(b, (uint64_t)n);
+
+  int status = json_add_mem(b, "-", 1);
+  if (status != 0)
+    return status;
+  return json_add_uint(b, -(uint64_t)n);
+} /* }}} int json_add_int */
+
+static int json_add_gauge(format_json_buffer_t *b, gauge_t v) /* {{{ */
+{
+  if (!isfinite(v))
+    return json_add_str(b, "null");
+
+  /* "%.15g" prints numbers without fractional part below 1e15 as integers. */
+  if ((strcmp(JSON_GAUGE_FORMAT, "%.15g") == 0) && (fabs(v) < 1e15) &&
+      (v == floor(v)) && ((v != 0.0) || !signbit(v)))
+    return json_add_int(b, (int64_t)v);
+
+  char tmp[64];
+  int len = snprintf(tmp, sizeof(tmp), JSON_GAUGE_FORMAT, v);
+  if ((len < 1) || ((size_t)len >= sizeof(tmp)))
+    return -1;
+  return json_add_mem(b, tmp, (size_t)len);
+} /* }}} int json_add_gauge */
+
+/* json_add_time adds "t" in seconds with three decimals, rounded to the
+ * nearest millisecond. */
+static int json_add_time(format_json_buffer_t *b, cdtime_t t) /* {{{ */
+{
+  uint64_t sec = CDTIME_T_TO_TIME_T(t);
+  uint64_t ms = ((t & 0x3fffffff) * 1000 + 0x20000000) >> 30;
+  if (ms == 1000) {
+    sec++;
+    ms = 0;
+  }
+
+  char frac[] = {'.', (char)('0' + ms / 100), (char)('0' + (ms / 10) % 10),
+                 (char)('0' + ms % 10)};
+
+  int status = json_add_uint(b, sec);
+  if (status != 0)
+    return status;
+  return json_add_mem(b, frac, sizeof(frac));
+} /* }}} int json_add_time */
+
+/* json_add_escaped adds "str" as a quoted string. Quotes and backslashes are
+ * escaped, control characters are replaced with question marks. */
+static int json_add_escaped(format_json_buffer_t *b, /* {{{ */
+                            char const *str) {
+  size_t len = strlen(str);
+
+  /* Worst case: every character needs escaping. */
+  int status = json_reserve(b, 2 * len + 2);
+  if (status != 0)
+    return status;
 
-#undef BUFFER_ADD
+  char *dst = b->data + b->len;
+  *(dst++) = '"';
+  char const *src = str;
+  char const *end = str + len;
+  while (src < end) {
+    /* Most strings need no escaping and are copied at once. */
+    size_t plain = strspan_plain(src, (size_t)(end - src), "\"\\",
+                                 /* control = */ true);
+    memcpy(dst, src, plain);
+    dst += plain;
+    src += plain;
+    if (src == end)
+      break;
+
+    unsigned char c = (unsigned char)*(src++);
+    if ((c == '"') || (c == '\\')) {
+      *(dst++) = '\\';
+      *(dst++) = (char)c;
+    } else
+      *(dst++) = '?';
+  }
+  *(dst++) = '"';
+  *dst = 0;
 
+  b->len = (size_t)(dst - b->data);
   return 0;
-} /* }}} int json_escape_string */
+} /* }}} int json_add_escaped */
+
+static int json_add_key(format_json_buffer_t *b, char const *key) /* {{{ */
+{
+  int status = json_add_escaped(b, key);
+  if (status != 0)
+    return status;
+  return json_add_mem(b, ":", 1);
+} /* }}} int json_add_key */
 
-static int values_to_json(char *buffer, size_t buffer_size, /* {{{ */
+static int values_to_json(format_json_buffer_t *b, /* {{{ */
                           const data_set_t *ds, const value_list_t *vl,
                           int store_rates) {
-  size_t offset = 0;
   gauge_t *rates = NULL;
+  int status = json_add_mem(b, "[", 1);
 
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1) {                                                          \
-      sfree(rates);                                                            \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (buffer_size - offset)) {                   \
-      sfree(rates);                                                            \
-      return -ENOMEM;                                                          \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
-  } while (0)
+  for (size_t i = 0; (i < ds->ds_num) && (status == 0); i++) {
+    if (i > 0) {
+      status = json_add_mem(b, ",", 1);
+      if (status != 0)
+        break;
+    }
 
-  BUFFER_ADD("[");
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    if (i > 0)
-      BUFFER_ADD(",");
-
-    if (ds->ds[i].type == DS_TYPE_GAUGE) {
-      if (isfinite(vl->values[i].gauge))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, vl->values[i].gauge);
-      else
-        BUFFER_ADD("null");
-    } else if (store_rates) {
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      status = json_add_gauge(b, vl->values[i].gauge);
+    else if (store_rates) {
       if (rates == NULL)
         rates = uc_get_rate(ds, vl);
       if (rates == NULL) {
         WARNING("utils_format_json: uc_get_rate failed.");
-        sfree(rates);
         return -1;
       }
-
-      if (isfinite(rates[i]))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, rates[i]);
-      else
-        BUFFER_ADD("null");
+      status = json_add_gauge(b, rates[i]);
     } else if (ds->ds[i].type == DS_TYPE_COUNTER)
-      BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[i].counter);
+      status = json_add_uint(b, (uint64_t)vl->values[i].counter);
     else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      BUFFER_ADD("%" PRIi64, vl->values[i].derive);
+      status = json_add_int(b, vl->values[i].derive);
     else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      BUFFER_ADD("%" PRIu64, vl->values[i].absolute);
+      status = json_add_uint(b, vl->values[i].absolute);
     else {
       ERROR("format_json: Unknown data source type: %i", ds->ds[i].type);
-      sfree(rates);
-      return -1;
+      status = -1;
     }
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
 
   sfree(rates);
-  return 0;
+  if (status != 0)
+    return status;
+  return json_add_mem(b, "]", 1);
 } /* }}} int values_to_json */
 
-static int dstypes_to_json(char *buffer, size_t buffer_size, /* {{{ */
+static int dstypes_to_json(format_json_buffer_t *b, /* {{{ */
                            const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
+  int status = json_add_mem(b, "[", 1);
 
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
-  for (size_t i = 0; i < ds->ds_num; i++) {
+  for (size_t i = 0; (i < ds->ds_num) && (status == 0); i++) {
     if (i > 0)
-      BUFFER_ADD(",");
-
-    BUFFER_ADD("\"%s\"", DS_TYPE_TO_STRING(ds->ds[i].type));
+      status = json_add_mem(b, ",", 1);
+    if (status == 0)
+      status = json_add_escaped(b, DS_TYPE_TO_STRING(ds->ds[i].type));
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
 
-#undef BUFFER_ADD
-
-  return 0;
+  if (status != 0)
+    return status;
+  return json_add_mem(b, "]", 1);
 } /* }}} int dstypes_to_json */
 
-static int dsnames_to_json(char *buffer, size_t buffer_size, /* {{{ */
+static int dsnames_to_json(format_json_buffer_t *b, /* {{{ */
                            const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
+  int status = json_add_mem(b, "[", 1);
 
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
-  for (size_t i = 0; i < ds->ds_num; i++) {
+  for (size_t i = 0; (i < ds->ds_num) && (status == 0); i++) {
     if (i > 0)
-      BUFFER_ADD(",");
-
-    BUFFER_ADD("\"%s\"", ds->ds[i].name);
+      status = json_add_mem(b, ",", 1);
+    if (status == 0)
+      status = json_add_escaped(b, ds->ds[i].name);
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
 
-#undef BUFFER_ADD
-
-  return 0;
+  if (status != 0)
+    return status;
+  return json_add_mem(b, "]", 1);
 } /* }}} int dsnames_to_json */
 
-static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                                  meta_data_t *meta, char **keys,
-                                  size_t keys_num) {
-  size_t offset = 0;
-  int status;
-
-  buffer[0] = 0;
+typedef struct {
+  format_json_buffer_t *b;
+  size_t entries_num;
+} meta_data_json_t;
 
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  for (size_t i = 0; i < keys_num; ++i) {
-    int type;
-    char *key = keys[i];
-
-    type = meta_data_type(meta, key);
-    if (type == MD_TYPE_STRING) {
-      char *value = NULL;
-      if (meta_data_get_string(meta, key, &value) == 0) {
-        char temp[512] = "";
-
-        status = json_escape_string(temp, sizeof(temp), value);
-        sfree(value);
-        if (status != 0)
-          return status;
-
-        BUFFER_ADD(",\"%s\":%s", key, temp);
-      }
-    } else if (type == MD_TYPE_SIGNED_INT) {
-      int64_t value = 0;
-      if (meta_data_get_signed_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIi64, key, value);
-    } else if (type == MD_TYPE_UNSIGNED_INT) {
-      uint64_t value = 0;
-      if (meta_data_get_unsigned_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIu64, key, value);
-    } else if (type == MD_TYPE_DOUBLE) {
-      double value = 0.0;
-      if (meta_data_get_double(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%f", key, value);
-    } else if (type == MD_TYPE_BOOLEAN) {
-      bool value = false;
-      if (meta_data_get_boolean(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%s", key, value ? "true" : "false");
-    }
-  } /* for (keys) */
-
-  if (offset == 0)
-    return ENOENT;
-
-  buffer[0] = '{'; /* replace leading ',' */
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD
-
-  return 0;
-} /* }}} int meta_data_keys_to_json */
-
-static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                             meta_data_t *meta) {
-  char **keys = NULL;
-  size_t keys_num;
+static int meta_data_entry_to_json(char const *key, int type, /* {{{ */
+                                   void const *value, void *user_data) {
+  meta_data_json_t *m = user_data;
+  format_json_buffer_t *b = m->b;
+  char tmp[64];
   int status;
 
-  if ((buffer == NULL) || (buffer_size == 0) || (meta == NULL))
-    return EINVAL;
+  if ((type < MD_TYPE_STRING) || (type > MD_TYPE_BOOLEAN))
+    return 0;
 
-  status = meta_data_toc(meta, &keys);
-  if (status <= 0)
+  status = json_add_str(b, (m->entries_num == 0) ? ",\"meta\":{" : ",");
+  if (status == 0)
+    status = json_add_key(b, key);
+  if (status != 0)
     return status;
-  keys_num = (size_t)status;
+  m->entries_num++;
+
+  switch (type) {
+  case MD_TYPE_STRING:
+    return json_add_escaped(b, *((char *const *)value));
+  case MD_TYPE_SIGNED_INT:
+    return json_add_int(b, *((int64_t const *)value));
+  case MD_TYPE_UNSIGNED_INT:
+    return json_add_uint(b, *((uint64_t const *)value));
+  case MD_TYPE_DOUBLE:
+    status = snprintf(tmp, sizeof(tmp), "%f", *((double const *)value));
+    if ((status < 1) || ((size_t)status >= sizeof(tmp)))
+      return -1;
+    return json_add_mem(b, tmp, (size_t)status);
+  default: /* MD_TYPE_BOOLEAN */
+    return json_add_str(b, *((bool const *)value) ? "true" : "false");
+  }
+} /* }}} int meta_data_entry_to_json */
 
-  status = meta_data_keys_to_json(buffer, buffer_size, meta, keys, keys_num);
+/* meta_data_to_json adds the "meta" member, unless "meta" is empty. */
+static int meta_data_to_json(format_json_buffer_t *b, /* {{{ */
+                             meta_data_t *meta) {
+  meta_data_json_t m = {.b = b};
 
-  for (size_t i = 0; i < keys_num; ++i)
-    sfree(keys[i]);
-  sfree(keys);
+  int status = meta_data_foreach(meta, meta_data_entry_to_json, &m);
+  if ((status != 0) || (m.entries_num == 0))
+    return status;
 
-  return status;
+  return json_add_mem(b, "}", 1);
 } /* }}} int meta_data_to_json */
 
-static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                              const data_set_t *ds, const value_list_t *vl,
-                              int store_rates) {
-  char temp[512];
-  size_t offset = 0;
+/* value_list_to_json adds "vl" as an object, preceded by "separator". On
+ * failure, the buffer is left unchanged. */
+static int value_list_to_json(format_json_buffer_t *b, /* {{{ */
+                              char const *separator, const data_set_t *ds,
+                              const value_list_t *vl, int store_rates) {
+  size_t orig_len = b->len;
   int status;
 
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
+#define JSON_CHECK(cmd)                                                        \
   do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  /* All value lists have a leading comma. The first one will be replaced with
-   * a square bracket in `format_json_finalize'. */
-  BUFFER_ADD(",{");
-
-  status = values_to_json(temp, sizeof(temp), ds, vl, store_rates);
-  if (status != 0)
-    return status;
-  BUFFER_ADD("\"values\":%s", temp);
-
-  status = dstypes_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
-    return status;
-  BUFFER_ADD(",\"dstypes\":%s", temp);
-
-  status = dsnames_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
-    return status;
-  BUFFER_ADD(",\"dsnames\":%s", temp);
-
-  BUFFER_ADD(",\"time\":%.3f", CDTIME_T_TO_DOUBLE(vl->time));
-  BUFFER_ADD(",\"interval\":%.3f", CDTIME_T_TO_DOUBLE(vl->interval));
-
-#define BUFFER_ADD_KEYVAL(key, value)                                          \
-  do {                                                                         \
-    status = json_escape_string(temp, sizeof(temp), (value));                  \
+    status = (cmd);                                                            \
     if (status != 0)                                                           \
-      return status;                                                           \
-    BUFFER_ADD(",\"%s\":%s", (key), temp);                                     \
+      goto failure;                                                            \
   } while (0)
 
-  BUFFER_ADD_KEYVAL("host", vl->host);
-  BUFFER_ADD_KEYVAL("plugin", vl->plugin);
-  BUFFER_ADD_KEYVAL("plugin_instance", vl->plugin_instance);
-  BUFFER_ADD_KEYVAL("type", vl->type);
-  BUFFER_ADD_KEYVAL("type_instance", vl->type_instance);
-
-  if (vl->meta != NULL) {
-    char meta_buffer[buffer_size];
-    memset(meta_buffer, 0, sizeof(meta_buffer));
-    status = meta_data_to_json(meta_buffer, sizeof(meta_buffer), vl->meta);
-    if (status != 0)
-      return status;
-
-    BUFFER_ADD(",\"meta\":%s", meta_buffer);
-  } /* if (vl->meta != NULL) */
-
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD_KEYVAL
-#undef BUFFER_ADD
+  JSON_CHECK(json_add_str(b, separator));
+  JSON_CHECK(json_add_str(b, "{\"values\":"));
+  JSON_CHECK(values_to_json(b, ds, vl, store_rates));
+  JSON_CHECK(json_add_str(b, ",\"dstypes\":"));
+  JSON_CHECK(dstypes_to_json(b, ds));
+  JSON_CHECK(json_add_str(b, ",\"dsnames\":"));
+  JSON_CHECK(dsnames_to_json(b, ds));
+
+  JSON_CHECK(json_add_str(b, ",\"time\":"));
+  JSON_CHECK(json_add_time(b, vl->time));
+  JSON_CHECK(json_add_str(b, ",\"interval\":"));
+  JSON_CHECK(json_add_time(b, vl->interval));
+
+  JSON_CHECK(json_add_str(b, ",\"host\":"));
+  JSON_CHECK(json_add_escaped(b, vl->host));
+  JSON_CHECK(json_add_str(b, ",\"plugin\":"));
+  JSON_CHECK(json_add_escaped(b, vl->plugin));
+  JSON_CHECK(json_add_str(b, ",\"plugin_instance\":"));
+  JSON_CHECK(json_add_escaped(b, vl->plugin_instance));
+  JSON_CHECK(json_add_str(b, ",\"type\":"));
+  JSON_CHECK(json_add_escaped(b, vl->type));
+  JSON_CHECK(json_add_str(b, ",\"type_instance\":"));
+  JSON_CHECK(json_add_escaped(b, vl->type_instance));
+
+  if (vl->meta != NULL)
+    JSON_CHECK(meta_data_to_json(b, vl->meta));
+
+  JSON_CHECK(json_add_mem(b, "}", 1));
+
+#undef JSON_CHECK
 
   return 0;
+
+failure:
+  b->len = orig_len;
+  if (b->data != NULL)
+    b->data[orig_len] = 0;
+  return status;
 } /* }}} int value_list_to_json */
 
-static int format_json_value_list_nocheck(char *buffer, /* {{{ */
-                                          size_t *ret_buffer_fill,
-                                          size_t *ret_buffer_free,
-                                          const data_set_t *ds,
-                                          const value_list_t *vl,
-                                          int store_rates, size_t temp_size) {
-  char temp[temp_size];
-  int status;
+/* value_list_to_json_memo is value_list_to_json, copying the value list from
+ * the buffer's memo if another write callback has rendered it already. Value
+ * lists with meta data aren't memoized, since the memo doesn't compare it. */
+static int value_list_to_json_memo(format_json_buffer_t *b, /* {{{ */
+                                   char const *separator,
+                                   const data_set_t *ds,
+                                   const value_list_t *vl, int store_rates) {
+  if ((b->memo == NULL) || (vl->meta != NULL))
+    return value_list_to_json(b, separator, ds, vl, store_rates);
+
+  size_t separator_len = strlen(separator);
+  size_t len = 0;
+  char const *data = format_memo_get(b->memo, vl, &len);
+  if (data != NULL) {
+    int status = json_reserve(b, separator_len + len);
+    if (status != 0)
+      return status;
+    json_add_mem(b, separator, separator_len);
+    json_add_mem(b, data, len);
+    return 0;
+  }
 
-  status = value_list_to_json(temp, sizeof(temp), ds, vl, store_rates);
+  size_t start = b->len + separator_len;
+  int status = value_list_to_json(b, separator, ds, vl, store_rates);
   if (status != 0)
     return status;
-  temp_size = strlen(temp);
-
-  memcpy(buffer + (*ret_buffer_fill), temp, temp_size + 1);
-  (*ret_buffer_fill) += temp_size;
-  (*ret_buffer_free) -= temp_size;
 
+  format_memo_put(b->memo, vl, b->data + start, b->len - start);
   return 0;
-} /* }}} int format_json_value_list_nocheck */
+} /* }}} int value_list_to_json_memo */
 
 int format_json_initialize(char *buffer, /* {{{ */
                            size_t *ret_buffer_fill, size_t *ret_buffer_free) {
@@ -460,11 +462,67 @@ int format_json_value_list(char *buffer, /* {{{ */
   if (*ret_buffer_free < 3)
     return -ENOMEM;
 
-  return format_json_value_list_nocheck(buffer, ret_buffer_fill,
-                                        ret_buffer_free, ds, vl, store_rates,
-                                        (*ret_buffer_free) - 2);
+  /* Two bytes are left for the closing bracket added by
+   * `format_json_finalize'. All value lists have a leading comma; the first
+   * one is replaced with a square bracket in `format_json_finalize'. */
+  format_json_buffer_t b = {
+      .data = buffer,
+      .len = *ret_buffer_fill,
+      .size = *ret_buffer_fill + *ret_buffer_free - 1,
+      .fixed = true,
+  };
+  int status = value_list_to_json(&b, ",", ds, vl, store_rates);
+  if (status != 0)
+    return status;
+
+  (*ret_buffer_free) -= b.len - (*ret_buffer_fill);
+  (*ret_buffer_fill) = b.len;
+  return 0;
 } /* }}} int format_json_value_list */
 
+int format_json_buffer_add(format_json_buffer_t *b, /* {{{ */
+                           const data_set_t *ds, const value_list_t *vl,
+                           int store_rates) {
+  if ((b == NULL) || (ds == NULL) || (vl == NULL) || b->fixed)
+    return -EINVAL;
+
+  int status = value_list_to_json_memo(b, (b->values_num == 0) ? "[" : ",",
+                                       ds, vl, store_rates);
+  if (status != 0)
+    return status;
+
+  b->values_num++;
+  return 0;
+} /* }}} int format_json_buffer_add */
+
+int format_json_buffer_finalize(format_json_buffer_t *b) /* {{{ */
+{
+  if ((b == NULL) || b->fixed)
+    return -EINVAL;
+
+  return json_add_str(b, (b->values_num == 0) ? "[]" : "]");
+} /* }}} int format_json_buffer_finalize */
+
+void format_json_buffer_reset(format_json_buffer_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return;
+
+  b->len = 0;
+  b->values_num = 0;
+  if (b->data != NULL)
+    b->data[0] = 0;
+} /* }}} void format_json_buffer_reset */
+
+void format_json_buffer_free(format_json_buffer_t *b) /* {{{ */
+{
+  if ((b == NULL) || b->fixed)
+    return;
+
+  sfree(b->data);
+  *b = (format_json_buffer_t)FORMAT_JSON_BUFFER_INIT;
+} /* }}} void format_json_buffer_free */
+
 #if HAVE_LIBYAJL
 static int json_add_string(yajl_gen g, char const *str) /* {{{ */
 {
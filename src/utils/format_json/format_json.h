@@ -30,11 +30,52 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/format_memo/format_memo.h"
 
 #ifndef JSON_GAUGE_FORMAT
 #define JSON_GAUGE_FORMAT GAUGE_FORMAT
 #endif
 
+/* A growable buffer for formatting value lists into one JSON array. Initialize
+ * with FORMAT_JSON_BUFFER_INIT; "data" is null terminated once anything has
+ * been added. */
+typedef struct {
+  char *data;
+  size_t len;
+  size_t size;
+  size_t values_num;
+
+  /* Optional. Shares the rendered value lists with the buffers of other write
+   * callbacks, see format_memo.h. Acquired by the owner of the buffer with
+   * the "store_rates" passed to format_json_buffer_add(), not freed by
+   * format_json_buffer_free(). */
+  format_memo_t *memo;
+
+  /* private */
+  bool fixed;
+} format_json_buffer_t;
+
+#define FORMAT_JSON_BUFFER_INIT                                                \
+  {                                                                            \
+    .data = NULL, .len = 0, .size = 0, .values_num = 0, .memo = NULL,          \
+    .fixed = false                                                             \
+  }
+
+/* Initial size of a format_json_buffer_t. The buffer doubles in size when
+ * needed. */
+#ifndef FORMAT_JSON_BUFFER_MIN
+#define FORMAT_JSON_BUFFER_MIN 4096
+#endif
+
+/* Appends "vl" to the array in "b". On failure, "b" is left unchanged. */
+int format_json_buffer_add(format_json_buffer_t *b, const data_set_t *ds,
+                           const value_list_t *vl, int store_rates);
+/* Closes the array. An empty buffer becomes "[]". */
+int format_json_buffer_finalize(format_json_buffer_t *b);
+/* Empties "b", keeping the allocated memory for reuse. */
+void format_json_buffer_reset(format_json_buffer_t *b);
+void format_json_buffer_free(format_json_buffer_t *b);
+
 int format_json_initialize(char *buffer, size_t *ret_buffer_fill,
                            size_t *ret_buffer_free);
 int format_json_value_list(char *buffer, size_t *ret_buffer_fill,
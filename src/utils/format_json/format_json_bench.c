@@ -0,0 +1,128 @@
+/**
+ * collectd - src/utils/format_json/format_json_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the JSON formatter. Build with "make bench_format_json";
+ * the optional argument is the number of value lists, 1000000 by default. */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils/common/common.h"
+#include "utils/format_json/format_json.h"
+#include "utils/metadata/meta_data.h"
+
+static data_source_t dsrc[] = {
+    {"rx", DS_TYPE_DERIVE, 0, NAN},
+    {"tx", DS_TYPE_DERIVE, 0, NAN},
+};
+static data_set_t ds = {"if_octets", STATIC_ARRAY_SIZE(dsrc), dsrc};
+
+static value_t values[2];
+static value_list_t vl;
+
+static void init_value_list(bool with_meta) {
+  vl = (value_list_t){
+      .values = values,
+      .values_len = STATIC_ARRAY_SIZE(values),
+      .time = TIME_T_TO_CDTIME_T(1480063672),
+      .interval = TIME_T_TO_CDTIME_T(10),
+  };
+  sstrncpy(vl.host, "host.example.com", sizeof(vl.host));
+  sstrncpy(vl.plugin, "interface", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, "eth0", sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, "if_octets", sizeof(vl.type));
+
+  if (with_meta) {
+    vl.meta = meta_data_create();
+    meta_data_add_string(vl.meta, "network:received", "192.0.2.1");
+    meta_data_add_signed_int(vl.meta, "offset", -42);
+  }
+}
+
+/* One value list per JSON document, as write_http does with small buffers. */
+static int bench_value_list(size_t ops) {
+  char buffer[4096];
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    size_t fill = 0;
+    size_t avail = sizeof(buffer);
+
+    values[0].derive = (derive_t)i;
+    values[1].derive = (derive_t)(2 * i);
+    if ((format_json_initialize(buffer, &fill, &avail) != 0) ||
+        (format_json_value_list(buffer, &fill, &avail, &ds, &vl,
+                                /* store_rates = */ 0) != 0) ||
+        (format_json_finalize(buffer, &fill, &avail) != 0))
+      return -1;
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(format_json_value_list) {
+  init_value_list(/* with_meta = */ false);
+  return bench_value_list(ops);
+}
+
+DEF_BENCH(format_json_value_list_meta) {
+  init_value_list(/* with_meta = */ true);
+  int status = bench_value_list(ops);
+  meta_data_destroy(vl.meta);
+  vl.meta = NULL;
+  return status;
+}
+
+/* Many value lists in one growing buffer, as write_kafka and amqp do. */
+DEF_BENCH(format_json_buffer_add) {
+  format_json_buffer_t b = FORMAT_JSON_BUFFER_INIT;
+  init_value_list(/* with_meta = */ false);
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    values[0].derive = (derive_t)i;
+    values[1].derive = (derive_t)(2 * i);
+    if (format_json_buffer_add(&b, &ds, &vl, /* store_rates = */ 0) != 0)
+      return -1;
+    /* Start a new document every 1000 value lists. */
+    if ((i % 1000) == 999) {
+      format_json_buffer_finalize(&b);
+      format_json_buffer_reset(&b);
+    }
+  }
+  BENCH_STOP;
+
+  format_json_buffer_free(&b);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t ops = BENCH_OPS(argc, argv, 1000000);
+
+  RUN_BENCH(format_json_value_list, ops);
+  RUN_BENCH(format_json_value_list_meta, ops);
+  RUN_BENCH(format_json_buffer_add, ops);
+
+  END_BENCH;
+}
@@ -176,8 +176,101 @@ DEF_TEST(notification) {
   return expect_json_labels(got, labels, STATIC_ARRAY_SIZE(labels));
 }
 
+static data_source_t dsrc[] = {
+    {"rx", DS_TYPE_DERIVE, 0, NAN},
+    {"tx", DS_TYPE_GAUGE, 0, NAN},
+};
+static data_set_t ds = {"if_octets", STATIC_ARRAY_SIZE(dsrc), dsrc};
+
+DEF_TEST(value_list) {
+  value_list_t vl = {
+      .values = (value_t[]){{.derive = -42}, {.gauge = 0.5}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672) + MS_TO_CDTIME_T(125),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "if_octets",
+      .type_instance = "say \"hi\"",
+  };
+  char const *want =
+      "[{\"values\":[-42,0.5],\"dstypes\":[\"derive\",\"gauge\"],"
+      "\"dsnames\":[\"rx\",\"tx\"],\"time\":1480063672.125,"
+      "\"interval\":10.000,\"host\":\"example.com\",\"plugin\":\"test\","
+      "\"plugin_instance\":\"\",\"type\":\"if_octets\","
+      "\"type_instance\":\"say \\\"hi\\\"\"}]";
+
+  char buffer[1024];
+  size_t bfill = 0;
+  size_t bfree = sizeof(buffer);
+  CHECK_ZERO(format_json_initialize(buffer, &bfill, &bfree));
+  CHECK_ZERO(format_json_value_list(buffer, &bfill, &bfree, &ds, &vl, 0));
+  CHECK_ZERO(format_json_finalize(buffer, &bfill, &bfree));
+  EXPECT_EQ_STR(want, buffer);
+  EXPECT_EQ_UINT64(strlen(want), bfill);
+  EXPECT_EQ_UINT64(sizeof(buffer), bfill + bfree);
+
+  /* A value list that does not fit leaves the buffer unchanged. */
+  char small[64];
+  bfill = 0;
+  bfree = sizeof(small);
+  CHECK_ZERO(format_json_initialize(small, &bfill, &bfree));
+  EXPECT_EQ_INT(-ENOMEM,
+                format_json_value_list(small, &bfill, &bfree, &ds, &vl, 0));
+  EXPECT_EQ_UINT64(0, bfill);
+  EXPECT_EQ_STR("", small);
+
+  return 0;
+}
+
+DEF_TEST(buffer) {
+  value_list_t vl = {
+      .values = (value_t[]){{.derive = 1}, {.gauge = NAN}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "if_octets",
+  };
+  format_json_buffer_t b = FORMAT_JSON_BUFFER_INIT;
+
+  CHECK_ZERO(format_json_buffer_finalize(&b));
+  EXPECT_EQ_STR("[]", b.data);
+  format_json_buffer_reset(&b);
+
+  CHECK_NOT_NULL(vl.meta = meta_data_create());
+  CHECK_ZERO(meta_data_add_string(vl.meta, "key", "va\"lue"));
+  CHECK_ZERO(meta_data_add_boolean(vl.meta, "flag", true));
+
+  /* The buffer grows beyond its initial size. */
+  size_t num = 2 * FORMAT_JSON_BUFFER_MIN / 100;
+  for (size_t i = 0; i < num; i++)
+    CHECK_ZERO(format_json_buffer_add(&b, &ds, &vl, 0));
+  CHECK_ZERO(format_json_buffer_finalize(&b));
+  EXPECT_EQ_UINT64(num, b.values_num);
+  OK(b.size > FORMAT_JSON_BUFFER_MIN);
+  EXPECT_EQ_UINT64(strlen(b.data), b.len);
+
+  char const *want_first =
+      "[{\"values\":[1,null],\"dstypes\":[\"derive\",\"gauge\"],"
+      "\"dsnames\":[\"rx\",\"tx\"],\"time\":1480063672.000,"
+      "\"interval\":10.000,\"host\":\"example.com\",\"plugin\":\"test\","
+      "\"plugin_instance\":\"\",\"type\":\"if_octets\",\"type_instance\":\"\","
+      "\"meta\":{\"key\":\"va\\\"lue\",\"flag\":true}},{";
+  OK(strncmp(want_first, b.data, strlen(want_first)) == 0);
+  EXPECT_EQ_INT(']', b.data[b.len - 1]);
+
+  meta_data_destroy(vl.meta);
+  format_json_buffer_free(&b);
+  OK(b.data == NULL);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(notification);
+  RUN_TEST(value_list);
+  RUN_TEST(buffer);
 
   END_TEST;
 }
@@ -0,0 +1,268 @@
+/**
+ * collectd - src/utils/format_memo/format_memo.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/format_memo/format_memo.h"
+
+/* Value lists with larger keys, i.e. very many values, aren't memoized. */
+#define FORMAT_MEMO_KEY_MAX 1024
+
+struct format_memo_s {
+  char *format;
+  void *options;
+  size_t options_size;
+
+  /* Unique among all memos ever created, so that the renderings of a memo
+   * aren't found by another one allocated at the same address. */
+  uint64_t id;
+  size_t refs;
+
+  format_memo_t *next;
+};
+
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+static format_memo_t *memo_list;
+static uint64_t memo_next_id = 1;
+
+/* A rendering: the key describing the value list, followed by the data. */
+typedef struct {
+  uint64_t id;
+  uint64_t hash;
+  size_t key_len;
+  size_t data_len;
+  size_t size;
+  char *buffer;
+} memo_slot_t;
+
+/* The renderings of one thread, by the hash of the memo and the key. The key
+ * built by `format_memo_get' is kept for the `format_memo_put' after a miss. */
+typedef struct {
+  memo_slot_t slots[FORMAT_MEMO_SLOTS];
+
+  uint64_t key_id;
+  value_list_t const *key_vl;
+  uint64_t key_hash;
+  size_t key_len;
+  char key[FORMAT_MEMO_KEY_MAX];
+} memo_table_t;
+
+static pthread_key_t memo_table_key;
+static pthread_once_t memo_table_once = PTHREAD_ONCE_INIT;
+
+static void memo_table_free(void *arg) {
+  memo_table_t *t = arg;
+
+  for (size_t i = 0; i < FORMAT_MEMO_SLOTS; i++)
+    free(t->slots[i].buffer);
+  free(t);
+} /* void memo_table_free */
+
+static void memo_table_key_create(void) {
+  if (pthread_key_create(&memo_table_key, memo_table_free) != 0)
+    ERROR("format_memo: pthread_key_create failed.");
+} /* void memo_table_key_create */
+
+static memo_table_t *memo_table(bool create) {
+  pthread_once(&memo_table_once, memo_table_key_create);
+
+  memo_table_t *t = pthread_getspecific(memo_table_key);
+  if ((t != NULL) || !create)
+    return t;
+
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    return NULL;
+  if (pthread_setspecific(memo_table_key, t) != 0) {
+    free(t);
+    return NULL;
+  }
+  return t;
+} /* memo_table_t *memo_table */
+
+static bool memo_shared(format_memo_t const *m) {
+  return (m != NULL) && (__atomic_load_n(&m->refs, __ATOMIC_RELAXED) > 1);
+} /* bool memo_shared */
+
+static bool key_add(memo_table_t *t, void const *data, size_t size) {
+  if (size > sizeof(t->key) - t->key_len)
+    return false;
+
+  memcpy(t->key + t->key_len, data, size);
+  t->key_len += size;
+  return true;
+} /* bool key_add */
+
+#define KEY_ADD_STR(t, str) key_add((t), (str), strlen(str) + 1)
+
+/* Builds the key of `vl' in `t'. If `reuse' is true, the key built by the
+ * preceding `format_memo_get' for the same value list is kept. Returns false
+ * if the key is too large. */
+static bool memo_key(memo_table_t *t, format_memo_t const *m,
+                     value_list_t const *vl, bool reuse) {
+  if (reuse && (t->key_vl == vl) && (t->key_id == m->id))
+    return true;
+
+  t->key_vl = NULL;
+  t->key_len = 0;
+  if (!KEY_ADD_STR(t, vl->host) || !KEY_ADD_STR(t, vl->plugin) ||
+      !KEY_ADD_STR(t, vl->plugin_instance) || !KEY_ADD_STR(t, vl->type) ||
+      !KEY_ADD_STR(t, vl->type_instance) ||
+      !key_add(t, &vl->time, sizeof(vl->time)) ||
+      !key_add(t, &vl->interval, sizeof(vl->interval)) ||
+      !key_add(t, vl->values, vl->values_len * sizeof(*vl->values)))
+    return false;
+
+  /* FNV-1a over the memo's ID and the key. */
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < sizeof(m->id); i++)
+    hash = (hash ^ ((m->id >> (8 * i)) & 0xff)) * 1099511628211ULL;
+  for (size_t i = 0; i < t->key_len; i++)
+    hash = (hash ^ (unsigned char)t->key[i]) * 1099511628211ULL;
+
+  t->key_id = m->id;
+  t->key_vl = vl;
+  t->key_hash = hash;
+  return true;
+} /* bool memo_key */
+
+format_memo_t *format_memo_acquire(char const *format, void const *options,
+                                   size_t options_size) {
+  if (format == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&memo_lock);
+  for (format_memo_t *m = memo_list; m != NULL; m = m->next) {
+    if ((strcmp(format, m->format) != 0) || (options_size != m->options_size))
+      continue;
+    if ((options_size > 0) && (memcmp(options, m->options, options_size) != 0))
+      continue;
+
+    __atomic_add_fetch(&m->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&memo_lock);
+    return m;
+  }
+
+  format_memo_t *m = calloc(1, sizeof(*m));
+  if (m == NULL) {
+    pthread_mutex_unlock(&memo_lock);
+    return NULL;
+  }
+  m->format = strdup(format);
+  m->options = malloc((options_size > 0) ? options_size : 1);
+  if ((m->format == NULL) || (m->options == NULL)) {
+    pthread_mutex_unlock(&memo_lock);
+    free(m->format);
+    free(m->options);
+    free(m);
+    return NULL;
+  }
+  if (options_size > 0)
+    memcpy(m->options, options, options_size);
+  m->options_size = options_size;
+  m->id = memo_next_id++;
+  m->refs = 1;
+
+  m->next = memo_list;
+  memo_list = m;
+  pthread_mutex_unlock(&memo_lock);
+
+  return m;
+} /* format_memo_t *format_memo_acquire */
+
+void format_memo_release(format_memo_t *m) {
+  if (m == NULL)
+    return;
+
+  pthread_mutex_lock(&memo_lock);
+  if (__atomic_sub_fetch(&m->refs, 1, __ATOMIC_RELAXED) > 0) {
+    pthread_mutex_unlock(&memo_lock);
+    return;
+  }
+
+  for (format_memo_t **p = &memo_list; *p != NULL; p = &(*p)->next) {
+    if (*p == m) {
+      *p = m->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&memo_lock);
+
+  /* Renderings left in the threads' tables are never found again, since no
+   * other memo gets this ID. */
+  free(m->format);
+  free(m->options);
+  free(m);
+} /* void format_memo_release */
+
+char const *format_memo_get(format_memo_t *m, value_list_t const *vl,
+                            size_t *ret_len) {
+  if (!memo_shared(m) || (vl == NULL) || (ret_len == NULL))
+    return NULL;
+
+  memo_table_t *t = memo_table(/* create = */ false);
+  if ((t == NULL) || !memo_key(t, m, vl, /* reuse = */ false))
+    return NULL;
+
+  memo_slot_t const *s = t->slots + (t->key_hash % FORMAT_MEMO_SLOTS);
+  if ((s->id != m->id) || (s->hash != t->key_hash) ||
+      (s->key_len != t->key_len) ||
+      (memcmp(s->buffer, t->key, t->key_len) != 0))
+    return NULL;
+
+  *ret_len = s->data_len;
+  return s->buffer + s->key_len;
+} /* char const *format_memo_get */
+
+void format_memo_put(format_memo_t *m, value_list_t const *vl,
+                     char const *data, size_t len) {
+  if (!memo_shared(m) || (vl == NULL) || (data == NULL))
+    return;
+
+  memo_table_t *t = memo_table(/* create = */ true);
+  if ((t == NULL) || !memo_key(t, m, vl, /* reuse = */ true))
+    return;
+
+  memo_slot_t *s = t->slots + (t->key_hash % FORMAT_MEMO_SLOTS);
+  size_t size = t->key_len + len;
+  if (s->size < size) {
+    char *tmp = realloc(s->buffer, size);
+    if (tmp == NULL) {
+      s->id = 0;
+      return;
+    }
+    s->buffer = tmp;
+    s->size = size;
+  }
+
+  memcpy(s->buffer, t->key, t->key_len);
+  memcpy(s->buffer + t->key_len, data, len);
+  s->id = m->id;
+  s->hash = t->key_hash;
+  s->key_len = t->key_len;
+  s->data_len = len;
+
+  /* The next value list may be at the same address, with other values. */
+  t->key_vl = NULL;
+} /* void format_memo_put */
@@ -0,0 +1,76 @@
+/**
+ * collectd - src/utils/format_memo/format_memo.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_FORMAT_MEMO_H
+#define UTILS_FORMAT_MEMO_H 1
+
+#include "plugin.h"
+
+/* A format memo lets write callbacks with the same output format share the
+ * rendered value lists: when several <Node> blocks format a value list the
+ * same way, only the first one renders it and the others copy the bytes.
+ *
+ * Each callback acquires a memo with the name of its format and its
+ * formatting options, once while configuring. Callbacks with equal options
+ * get the same memo. A memo only does something if it has been acquired more
+ * than once, so a single callback doesn't pay for the lookups.
+ *
+ * The rendered value lists are kept per thread, so hits require the callbacks
+ * to be called by the same write threads. Value lists are compared by their
+ * identifier, time, interval and values, not by their meta data: formats
+ * rendering meta data must not use the memo for value lists having some. */
+
+#ifndef FORMAT_MEMO_SLOTS
+#define FORMAT_MEMO_SLOTS 512
+#endif
+
+struct format_memo_s;
+typedef struct format_memo_s format_memo_t;
+
+/*
+ * NAME
+ *   format_memo_acquire
+ *
+ * DESCRIPTION
+ *   Returns the memo of `format' with the `options_size' bytes at `options',
+ *   creating it if necessary.
+ *
+ * RETURN VALUE
+ *   The memo, to be released with `format_memo_release', or NULL on failure.
+ */
+format_memo_t *format_memo_acquire(char const *format, void const *options,
+                                   size_t options_size);
+void format_memo_release(format_memo_t *m);
+
+/* Returns the rendering of `vl' stored with `format_memo_put', and its length
+ * in `ret_len', or NULL. The returned data is valid until the calling thread
+ * calls `format_memo_put' again. */
+char const *format_memo_get(format_memo_t *m, value_list_t const *vl,
+                            size_t *ret_len);
+
+/* Stores the `len' bytes at `data' as the rendering of `vl'. Called after
+ * `format_memo_get' didn't find one. */
+void format_memo_put(format_memo_t *m, value_list_t const *vl,
+                     char const *data, size_t len);
+
+#endif /* UTILS_FORMAT_MEMO_H */
@@ -0,0 +1,116 @@
+/**
+ * collectd - src/utils/format_memo/format_memo_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/format_memo/format_memo.h"
+
+static value_list_t make_vl(value_t *values, char const *host) {
+  value_list_t vl = {
+      .values = values,
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T(1000),
+      .interval = TIME_T_TO_CDTIME_T(10),
+  };
+  sstrncpy(vl.host, host, sizeof(vl.host));
+  sstrncpy(vl.plugin, "plugin", sizeof(vl.plugin));
+  sstrncpy(vl.type, "type", sizeof(vl.type));
+  return vl;
+}
+
+DEF_TEST(acquire) {
+  int a = 1;
+  int b = 2;
+  format_memo_t *m1, *m2, *m3;
+
+  CHECK_NOT_NULL(m1 = format_memo_acquire("test", &a, sizeof(a)));
+  CHECK_NOT_NULL(m2 = format_memo_acquire("test", &a, sizeof(a)));
+  CHECK_NOT_NULL(m3 = format_memo_acquire("test", &b, sizeof(b)));
+  EXPECT_EQ_PTR(m1, m2);
+  OK(m1 != m3);
+
+  format_memo_release(m1);
+  format_memo_release(m2);
+  format_memo_release(m3);
+  return 0;
+}
+
+DEF_TEST(get_put) {
+  int options = 0;
+  value_t values[] = {{.gauge = 1.0}, {.gauge = 2.0}};
+  value_list_t vl = make_vl(values, "host");
+  char const *data;
+  size_t len = 0;
+
+  /* A memo used by a single callback stores nothing. */
+  format_memo_t *m;
+  CHECK_NOT_NULL(m = format_memo_acquire("test", &options, sizeof(options)));
+  OK(format_memo_get(m, &vl, &len) == NULL);
+  format_memo_put(m, &vl, "rendered", strlen("rendered"));
+  OK(format_memo_get(m, &vl, &len) == NULL);
+
+  CHECK_NOT_NULL(format_memo_acquire("test", &options, sizeof(options)));
+  OK(format_memo_get(m, &vl, &len) == NULL);
+  format_memo_put(m, &vl, "rendered", strlen("rendered"));
+  data = format_memo_get(m, &vl, &len);
+  OK(data != NULL);
+  EXPECT_EQ_UINT64(strlen("rendered"), len);
+  OK(memcmp("rendered", data, len) == 0);
+
+  /* A copy of the value list is the same value list. */
+  value_t copy_values[] = {{.gauge = 1.0}, {.gauge = 2.0}};
+  value_list_t copy = make_vl(copy_values, "host");
+  OK(format_memo_get(m, &copy, &len) != NULL);
+
+  /* Other values, times and identifiers are not. */
+  values[1].gauge = 3.0;
+  OK(format_memo_get(m, &vl, &len) == NULL);
+  values[1].gauge = 2.0;
+  vl.time++;
+  OK(format_memo_get(m, &vl, &len) == NULL);
+  vl.time--;
+  value_list_t other = make_vl(values, "other");
+  OK(format_memo_get(m, &other, &len) == NULL);
+
+  /* Neither are other options. */
+  int other_options = 1;
+  format_memo_t *o1, *o2;
+  CHECK_NOT_NULL(o1 = format_memo_acquire("test", &other_options,
+                                          sizeof(other_options)));
+  CHECK_NOT_NULL(o2 = format_memo_acquire("test", &other_options,
+                                          sizeof(other_options)));
+  OK(format_memo_get(o1, &vl, &len) == NULL);
+
+  format_memo_release(o1);
+  format_memo_release(o2);
+  format_memo_release(m);
+  format_memo_release(m);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(acquire);
+  RUN_TEST(get_put);
+
+  END_TEST;
+}
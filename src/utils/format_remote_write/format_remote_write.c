@@ -0,0 +1,187 @@
+/**
+ * collectd - src/utils/format_remote_write/format_remote_write.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/format_remote_write/format_remote_write.h"
+
+#include "remote_write.pb-c.h"
+
+/* The key of WriteRequest's "timeseries" field: number 1, length delimited. */
+#define RW_TIMESERIES_KEY 0x0a
+#define RW_LABELS_MAX 4
+
+/* rw_sanitize replaces the characters not allowed in Prometheus' metric and
+ * label names by underscores. */
+static void rw_sanitize(char *name) /* {{{ */
+{
+  for (char *c = name; *c != 0; c++) {
+    if (!isalnum((unsigned char)*c) && (*c != '_') && (*c != ':'))
+      *c = '_';
+  }
+  if (isdigit((unsigned char)name[0]))
+    name[0] = '_';
+} /* }}} void rw_sanitize */
+
+int format_remote_write_name(char *buffer, size_t buffer_size, /* {{{ */
+                             data_set_t const *ds, value_list_t const *vl,
+                             size_t ds_index, bool rate) {
+  char const *fields[5] = {"collectd"};
+  size_t fields_num = 1;
+
+  if ((buffer == NULL) || (ds == NULL) || (vl == NULL) ||
+      (ds_index >= ds->ds_num))
+    return EINVAL;
+
+  if (strcmp(vl->plugin, vl->type) != 0) {
+    fields[fields_num] = vl->plugin;
+    fields_num++;
+  }
+  fields[fields_num] = vl->type;
+  fields_num++;
+
+  if (strcmp("value", ds->ds[ds_index].name) != 0) {
+    fields[fields_num] = ds->ds[ds_index].name;
+    fields_num++;
+  }
+
+  if (!rate && ((ds->ds[ds_index].type == DS_TYPE_COUNTER) ||
+                (ds->ds[ds_index].type == DS_TYPE_DERIVE))) {
+    fields[fields_num] = "total";
+    fields_num++;
+  }
+
+  if (strjoin(buffer, buffer_size, (char **)fields, fields_num, "_") < 0)
+    return ENOBUFS;
+  rw_sanitize(buffer);
+  return 0;
+} /* }}} int format_remote_write_name */
+
+static size_t rw_varint(uint8_t *buffer, size_t v) /* {{{ */
+{
+  size_t len = 0;
+  while (v >= 0x80) {
+    buffer[len++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  buffer[len++] = (uint8_t)v;
+  return len;
+} /* }}} size_t rw_varint */
+
+int format_remote_write_series(uint8_t *buffer, /* {{{ */
+                               size_t buffer_size, size_t *ret_len,
+                               data_set_t const *ds, value_list_t const *vl,
+                               size_t ds_index, gauge_t const *rates) {
+  char name[5 * DATA_MAX_NAME_LEN];
+  char plugin[DATA_MAX_NAME_LEN];
+
+  int status = format_remote_write_name(name, sizeof(name), ds, vl, ds_index,
+                                        rates != NULL);
+  if (status != 0)
+    return status;
+
+  sstrncpy(plugin, vl->plugin, sizeof(plugin));
+  rw_sanitize(plugin);
+
+  Prometheus__Label labels[RW_LABELS_MAX];
+  Prometheus__Label *labels_ptr[RW_LABELS_MAX];
+  size_t labels_num = 0;
+
+#define RW_ADD_LABEL(n, v)                                                     \
+  do {                                                                         \
+    prometheus__label__init(labels + labels_num);                              \
+    labels[labels_num].name = (char *)(n);                                     \
+    labels[labels_num].value = (char *)(v);                                    \
+    labels_num++;                                                              \
+  } while (0)
+
+  /* The same labels as write_prometheus uses. The fixed names come first, so
+   * that they are kept if a plugin has the same name, see below. */
+  RW_ADD_LABEL("__name__", name);
+  if (strlen(vl->host) != 0)
+    RW_ADD_LABEL("instance", vl->host);
+  if (strlen(vl->plugin_instance) != 0) {
+    if (strlen(vl->type_instance) != 0)
+      RW_ADD_LABEL("type", vl->type_instance);
+    RW_ADD_LABEL(plugin, vl->plugin_instance);
+  } else if (strlen(vl->type_instance) != 0) {
+    RW_ADD_LABEL(plugin, vl->type_instance);
+  }
+#undef RW_ADD_LABEL
+
+  /* Labels have to be sorted by name. Prometheus rejects the whole request if
+   * a name repeats, which happens for a plugin named like a fixed label, so
+   * only the first label of a name is kept. */
+  size_t n = 0;
+  for (size_t i = 0; i < labels_num; i++) {
+    Prometheus__Label *l = labels + i;
+    size_t j = n;
+    while ((j > 0) && (strcmp(labels_ptr[j - 1]->name, l->name) > 0))
+      j--;
+    if ((j > 0) && (strcmp(labels_ptr[j - 1]->name, l->name) == 0))
+      continue;
+    memmove(labels_ptr + j + 1, labels_ptr + j, (n - j) * sizeof(*labels_ptr));
+    labels_ptr[j] = l;
+    n++;
+  }
+
+  Prometheus__Sample sample = PROMETHEUS__SAMPLE__INIT;
+  sample.has_value = 1;
+  sample.has_timestamp = 1;
+  sample.timestamp = (int64_t)CDTIME_T_TO_MS(vl->time);
+
+  if (rates != NULL)
+    sample.value = rates[ds_index];
+  else if (ds->ds[ds_index].type == DS_TYPE_GAUGE)
+    sample.value = vl->values[ds_index].gauge;
+  else if (ds->ds[ds_index].type == DS_TYPE_COUNTER)
+    sample.value = (double)vl->values[ds_index].counter;
+  else if (ds->ds[ds_index].type == DS_TYPE_DERIVE)
+    sample.value = (double)vl->values[ds_index].derive;
+  else if (ds->ds[ds_index].type == DS_TYPE_ABSOLUTE)
+    sample.value = (double)vl->values[ds_index].absolute;
+  else
+    return EINVAL;
+
+  Prometheus__Sample *samples[] = {&sample};
+  Prometheus__TimeSeries series = PROMETHEUS__TIME_SERIES__INIT;
+  series.n_labels = n;
+  series.labels = labels_ptr;
+  series.n_samples = 1;
+  series.samples = samples;
+
+  size_t len = prometheus__time_series__get_packed_size(&series);
+  /* The key and a length of up to five bytes. */
+  if (buffer_size < len + 6)
+    return ENOBUFS;
+
+  size_t offset = 0;
+  buffer[offset++] = RW_TIMESERIES_KEY;
+  offset += rw_varint(buffer + offset, len);
+  offset += prometheus__time_series__pack(&series, buffer + offset);
+
+  *ret_len = offset;
+  return 0;
+} /* }}} int format_remote_write_series */
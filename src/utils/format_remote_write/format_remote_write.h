@@ -0,0 +1,62 @@
+/**
+ * collectd - src/utils/format_remote_write/format_remote_write.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_FORMAT_REMOTE_WRITE_H
+#define UTILS_FORMAT_REMOTE_WRITE_H 1
+
+#include "collectd.h"
+
+#include "plugin.h"
+
+/*
+ * Prometheus remote write
+ *
+ * A remote write request is a snappy compressed "WriteRequest" message, see
+ * proto/remote_write.proto, which holds nothing but a repeated "timeseries"
+ * field. Such a message is the concatenation of its fields, so every series
+ * is packed on its own, prefixed with the field's key and length, and a
+ * request is built by concatenating the packed series.
+ *
+ * Series are named like the write_prometheus plugin names metric families,
+ * e.g. "collectd_cpu_total", and labeled with the plugin and type instances
+ * and the host as "instance".
+ */
+
+/* Large enough for any series. */
+#define FORMAT_REMOTE_WRITE_SERIES_SIZE 4096
+
+/* Writes the name of data source `ds_index' into `buffer'. Cumulative values
+ * get a "_total" suffix, unless they are converted to rates. */
+int format_remote_write_name(char *buffer, size_t buffer_size,
+                             data_set_t const *ds, value_list_t const *vl,
+                             size_t ds_index, bool rate);
+
+/* Packs data source `ds_index' of `vl' as a series with a single sample into
+ * `buffer' and stores its size in `ret_len'. If `rates' is not NULL, its rate
+ * is used instead of the value. Returns ENOBUFS if `buffer' is too small. */
+int format_remote_write_series(uint8_t *buffer, size_t buffer_size,
+                               size_t *ret_len, data_set_t const *ds,
+                               value_list_t const *vl, size_t ds_index,
+                               gauge_t const *rates);
+
+#endif /* UTILS_FORMAT_REMOTE_WRITE_H */
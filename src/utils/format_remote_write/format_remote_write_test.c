@@ -0,0 +1,157 @@
+/**
+ * collectd - src/utils/format_remote_write/format_remote_write_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/format_remote_write/format_remote_write.h"
+
+#include "remote_write.pb-c.h"
+
+static data_set_t ds_double = {
+    .type = "if_octets",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"rx", DS_TYPE_DERIVE, 0, NAN},
+            {"tx", DS_TYPE_DERIVE, 0, NAN},
+        },
+};
+
+DEF_TEST(name) {
+  struct {
+    char const *plugin;
+    char const *type;
+    char const *ds_name;
+    int ds_type;
+    bool rate;
+    char const *want;
+  } cases[] = {
+      {"cpu", "cpu", "value", DS_TYPE_DERIVE, false, "collectd_cpu_total"},
+      {"cpu", "cpu", "value", DS_TYPE_DERIVE, true, "collectd_cpu"},
+      {"memory", "memory", "value", DS_TYPE_GAUGE, false, "collectd_memory"},
+      {"interface", "if_octets", "rx", DS_TYPE_DERIVE, false,
+       "collectd_interface_if_octets_rx_total"},
+      {"curl-json", "gauge", "value", DS_TYPE_GAUGE, false,
+       "collectd_curl_json_gauge"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    data_set_t ds = {
+        .ds_num = 1,
+        .ds = &(data_source_t){"", cases[i].ds_type, 0, NAN},
+    };
+    sstrncpy(ds.type, cases[i].type, sizeof(ds.type));
+    sstrncpy(ds.ds[0].name, cases[i].ds_name, sizeof(ds.ds[0].name));
+
+    value_list_t vl = VALUE_LIST_INIT;
+    sstrncpy(vl.plugin, cases[i].plugin, sizeof(vl.plugin));
+    sstrncpy(vl.type, cases[i].type, sizeof(vl.type));
+
+    char got[5 * DATA_MAX_NAME_LEN];
+    CHECK_ZERO(
+        format_remote_write_name(got, sizeof(got), &ds, &vl, 0, cases[i].rate));
+    EXPECT_EQ_STR(cases[i].want, got);
+  }
+
+  return 0;
+}
+
+DEF_TEST(series) {
+  value_list_t vl = {
+      .values = (value_t[]){{.derive = 42}, {.derive = 23}},
+      .values_len = 2,
+      .time = MS_TO_CDTIME_T(1792000000123),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "interface",
+      .plugin_instance = "eth0",
+      .type = "if_octets",
+  };
+
+  /* Two series make a request. */
+  uint8_t buffer[2 * FORMAT_REMOTE_WRITE_SERIES_SIZE];
+  size_t len = 0;
+  size_t tx_len = 0;
+  CHECK_ZERO(format_remote_write_series(buffer, sizeof(buffer), &len,
+                                        &ds_double, &vl, 0, NULL));
+  gauge_t rates[] = {1.5, 2.5};
+  CHECK_ZERO(format_remote_write_series(buffer + len, sizeof(buffer) - len,
+                                        &tx_len, &ds_double, &vl, 1, rates));
+
+  EXPECT_EQ_INT(ENOBUFS, format_remote_write_series(buffer, len - 1, &tx_len,
+                                                    &ds_double, &vl, 0, NULL));
+
+  Prometheus__WriteRequest *req =
+      prometheus__write_request__unpack(NULL, len + tx_len, buffer);
+  CHECK_NOT_NULL(req);
+  EXPECT_EQ_UINT64(2, req->n_timeseries);
+
+  struct {
+    char const *name;
+    char const *value;
+  } want_labels[] = {
+      {"__name__", "collectd_interface_if_octets_rx_total"},
+      {"instance", "example.com"},
+      {"interface", "eth0"},
+  };
+  Prometheus__TimeSeries *rx = req->timeseries[0];
+  EXPECT_EQ_UINT64(STATIC_ARRAY_SIZE(want_labels), rx->n_labels);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(want_labels); i++) {
+    EXPECT_EQ_STR(want_labels[i].name, rx->labels[i]->name);
+    EXPECT_EQ_STR(want_labels[i].value, rx->labels[i]->value);
+  }
+  EXPECT_EQ_UINT64(1, rx->n_samples);
+  EXPECT_EQ_DOUBLE(42, rx->samples[0]->value);
+  EXPECT_EQ_UINT64(1792000000123, (uint64_t)rx->samples[0]->timestamp);
+
+  Prometheus__TimeSeries *tx = req->timeseries[1];
+  EXPECT_EQ_STR("collectd_interface_if_octets_tx", tx->labels[0]->value);
+  EXPECT_EQ_DOUBLE(2.5, tx->samples[0]->value);
+
+  prometheus__write_request__free_unpacked(req, NULL);
+
+  /* A type instance is labeled with the plugin's name if there is no plugin
+   * instance. A plugin named like a fixed label doesn't repeat it. */
+  sstrncpy(vl.plugin_instance, "", sizeof(vl.plugin_instance));
+  sstrncpy(vl.type_instance, "foo", sizeof(vl.type_instance));
+  sstrncpy(vl.plugin, "instance", sizeof(vl.plugin));
+  CHECK_ZERO(format_remote_write_series(buffer, sizeof(buffer), &len,
+                                        &ds_double, &vl, 0, NULL));
+  req = prometheus__write_request__unpack(NULL, len, buffer);
+  CHECK_NOT_NULL(req);
+  EXPECT_EQ_UINT64(2, req->timeseries[0]->n_labels);
+  EXPECT_EQ_STR("instance", req->timeseries[0]->labels[1]->name);
+  EXPECT_EQ_STR("example.com", req->timeseries[0]->labels[1]->value);
+  prometheus__write_request__free_unpacked(req, NULL);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(name);
+  RUN_TEST(series);
+
+  END_TEST;
+}
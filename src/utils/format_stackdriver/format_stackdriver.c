@@ -36,13 +36,24 @@
 #include <yajl/yajl_version.h>
 #endif
 
+/* The API accepts at most this many time series per timeSeries.create call. */
+#ifndef SD_MAX_TIME_SERIES
+#define SD_MAX_TIME_SERIES 200
+#endif
+
 struct sd_output_s {
   sd_resource_t *res;
   yajl_gen gen;
+  size_t time_series_num;
   c_avl_tree_t *staged;
   c_avl_tree_t *metric_descriptors;
 };
 
+struct sd_payload_s {
+  yajl_gen gen;
+  size_t time_series_num;
+};
+
 struct sd_label_s {
   char *key;
   char *value;
@@ -560,6 +571,11 @@ int sd_output_add(sd_output_t *out, data_set_t const *ds,
     return EEXIST;
   }
 
+  if ((out->time_series_num > 0) &&
+      ((out->time_series_num + ds->ds_num) > SD_MAX_TIME_SERIES)) {
+    return ENOSPC;
+  }
+
   _Bool staged = 0;
   for (size_t i = 0; i < ds->ds_num; i++) {
     int status = format_time_series(out->gen, ds, vl, i, out->res);
@@ -571,6 +587,7 @@ int sd_output_add(sd_output_t *out, data_set_t const *ds,
       ERROR("sd_output_add: format_time_series failed with status %d.", status);
       return status;
     }
+    out->time_series_num++;
     staged = 1;
   }
 
@@ -580,7 +597,8 @@ int sd_output_add(sd_output_t *out, data_set_t const *ds,
 
   size_t json_buffer_size = 0;
   yajl_gen_get_buf(out->gen, &(unsigned char const *){NULL}, &json_buffer_size);
-  if (json_buffer_size > 65535)
+  if ((json_buffer_size > 65535) ||
+      (out->time_series_num >= SD_MAX_TIME_SERIES))
     return ENOBUFS;
 
   return 0;
@@ -604,24 +622,62 @@ int sd_output_register_metric(sd_output_t *out, data_set_t const *ds,
   return 0;
 } /* }}} int sd_output_register_metric */
 
-char *sd_output_reset(sd_output_t *out) /* {{{ */
+sd_payload_t *sd_output_take(sd_output_t *out) /* {{{ */
 {
-  sd_output_finalize(out);
+  sd_payload_t *p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    return NULL;
 
-  unsigned char const *json_buffer = NULL;
-  yajl_gen_get_buf(out->gen, &json_buffer, &(size_t){0});
-  char *ret = strdup((void const *)json_buffer);
+  yajl_gen gen = yajl_gen_alloc(/* funcs = */ NULL);
+  if (gen == NULL) {
+    sfree(p);
+    return NULL;
+  }
+
+  sd_output_finalize(out);
+  p->gen = out->gen;
+  p->time_series_num = out->time_series_num;
 
   sd_output_reset_staged(out);
+  out->gen = gen;
+  out->time_series_num = 0;
+  sd_output_initialize(out);
 
-  yajl_gen_free(out->gen);
-  out->gen = yajl_gen_alloc(/* funcs = */ NULL);
+  return p;
+} /* }}} sd_payload_t *sd_output_take */
 
-  sd_output_initialize(out);
+char *sd_output_reset(sd_output_t *out) /* {{{ */
+{
+  sd_payload_t *p = sd_output_take(out);
+  if (p == NULL)
+    return NULL;
 
+  char *ret = strdup(sd_payload_data(p, &(size_t){0}));
+  sd_payload_destroy(p);
   return ret;
 } /* }}} char *sd_output_reset */
 
+char const *sd_payload_data(sd_payload_t const *p, size_t *len) /* {{{ */
+{
+  unsigned char const *json_buffer = NULL;
+  yajl_gen_get_buf(p->gen, &json_buffer, len);
+  return (char const *)json_buffer;
+} /* }}} char const *sd_payload_data */
+
+size_t sd_payload_time_series(sd_payload_t const *p) /* {{{ */
+{
+  return p->time_series_num;
+} /* }}} size_t sd_payload_time_series */
+
+void sd_payload_destroy(sd_payload_t *p) /* {{{ */
+{
+  if (p == NULL)
+    return;
+
+  yajl_gen_free(p->gen);
+  sfree(p);
+} /* }}} void sd_payload_destroy */
+
 sd_resource_t *sd_resource_create(char const *type) /* {{{ */
 {
   sd_resource_t *res = malloc(sizeof(*res));
@@ -641,6 +697,23 @@ sd_resource_t *sd_resource_create(char const *type) /* {{{ */
   return res;
 } /* }}} sd_resource_t *sd_resource_create */
 
+sd_resource_t *sd_resource_clone(sd_resource_t const *res) /* {{{ */
+{
+  sd_resource_t *clone = sd_resource_create(res->type);
+  if (clone == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < res->labels_num; i++) {
+    if (sd_resource_add_label(clone, res->labels[i].key,
+                              res->labels[i].value) != 0) {
+      sd_resource_destroy(clone);
+      return NULL;
+    }
+  }
+
+  return clone;
+} /* }}} sd_resource_t *sd_resource_clone */
+
 void sd_resource_destroy(sd_resource_t *res) /* {{{ */
 {
   if (res == NULL)
@@ -35,6 +35,10 @@ typedef struct sd_output_s sd_output_t;
 struct sd_resource_s;
 typedef struct sd_resource_s sd_resource_t;
 
+/* sd_payload_t is the finished request body taken from an sd_output_t. */
+struct sd_payload_s;
+typedef struct sd_payload_s sd_payload_t;
+
 sd_output_t *sd_output_create(sd_resource_t *res);
 
 /* sd_output_destroy frees all memory used by out, including the
@@ -48,6 +52,8 @@ void sd_output_destroy(sd_output_t *out);
  *   - ENOBUFS  Success, but the buffer should be flushed soon.
  *   - EEXIST   The value list is already encoded in the buffer.
  *              Flush the buffer, then call sd_output_add again.
+ *   - ENOSPC   The buffer holds the maximum number of time series for one
+ *              request. Flush the buffer, then call sd_output_add again.
  *   - ENOENT   First time we encounter this metric. Create a metric descriptor
  *              using the Stackdriver API and then call
  *              sd_output_register_metric.
@@ -65,7 +71,24 @@ int sd_output_register_metric(sd_output_t *out, data_set_t const *ds,
  * pointer. */
 char *sd_output_reset(sd_output_t *out);
 
+/* sd_output_take resets the output like sd_output_reset, but hands over the
+ * previous content without copying it. The request body can then be read with
+ * sd_payload_data, e.g. after releasing a lock that protects "out". The
+ * returned payload must be freed with sd_payload_destroy. */
+sd_payload_t *sd_output_take(sd_output_t *out);
+
+/* sd_payload_data returns the request body and stores its length in "len".
+ * The pointer is valid until sd_payload_destroy is called. */
+char const *sd_payload_data(sd_payload_t const *p, size_t *len);
+
+/* sd_payload_time_series returns the number of time series in "p". */
+size_t sd_payload_time_series(sd_payload_t const *p);
+
+void sd_payload_destroy(sd_payload_t *p);
+
 sd_resource_t *sd_resource_create(char const *type);
+/* sd_resource_clone returns a copy of "res", e.g. for another sd_output_t. */
+sd_resource_t *sd_resource_clone(sd_resource_t const *res);
 void sd_resource_destroy(sd_resource_t *res);
 int sd_resource_add_label(sd_resource_t *res, char const *key,
                           char const *value);
@@ -23,6 +23,7 @@
 #include "collectd.h"
 
 #include "testing.h"
+#include "utils/common/common.h"
 #include "utils/format_stackdriver/format_stackdriver.h"
 
 DEF_TEST(sd_format_metric_descriptor) {
@@ -70,8 +71,71 @@ DEF_TEST(sd_format_metric_descriptor) {
   return 0;
 }
 
+DEF_TEST(sd_output_add) {
+  data_set_t ds = {
+      .type = "example",
+      .ds_num = 1,
+      .ds =
+          &(data_source_t){
+              .name = "value", .type = DS_TYPE_GAUGE, .min = NAN, .max = NAN,
+          },
+  };
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1500000000),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "unit-test",
+      .type = "example",
+  };
+
+  sd_resource_t *res;
+  CHECK_NOT_NULL(res = sd_resource_create("global"));
+  sd_output_t *out;
+  CHECK_NOT_NULL(out = sd_output_create(res));
+
+  EXPECT_EQ_INT(ENOENT, sd_output_add(out, &ds, &vl));
+  CHECK_ZERO(sd_output_register_metric(out, &ds, &vl));
+
+  /* The buffer is full after 200 time series, the API limit. */
+  size_t added = 0;
+  for (int i = 0; i < 199; i++) {
+    snprintf(vl.type_instance, sizeof(vl.type_instance), "%d", i);
+    if (sd_output_add(out, &ds, &vl) == 0)
+      added++;
+  }
+  EXPECT_EQ_UINT64(199, added);
+  sstrncpy(vl.type_instance, "last", sizeof(vl.type_instance));
+  EXPECT_EQ_INT(ENOBUFS, sd_output_add(out, &ds, &vl));
+  EXPECT_EQ_INT(EEXIST, sd_output_add(out, &ds, &vl));
+  sstrncpy(vl.type_instance, "full", sizeof(vl.type_instance));
+  EXPECT_EQ_INT(ENOSPC, sd_output_add(out, &ds, &vl));
+
+  sd_payload_t *p;
+  CHECK_NOT_NULL(p = sd_output_take(out));
+  EXPECT_EQ_UINT64(200, sd_payload_time_series(p));
+  size_t len = 0;
+  char const *data = sd_payload_data(p, &len);
+  EXPECT_EQ_UINT64(strlen(data), len);
+  OK(strncmp(data, "{\"timeSeries\":[{", strlen("{\"timeSeries\":[{")) == 0);
+  OK(strcmp(data + len - 3, "}]}") == 0);
+  sd_payload_destroy(p);
+
+  /* Taking the payload resets the buffer. */
+  EXPECT_EQ_INT(0, sd_output_add(out, &ds, &vl));
+  char *got;
+  CHECK_NOT_NULL(got = sd_output_reset(out));
+  OK(strstr(got, "\"type_instance\":\"full\"") != NULL);
+  sfree(got);
+
+  sd_output_destroy(out);
+  return 0;
+}
+
 int main(int argc, char **argv) {
   RUN_TEST(sd_format_metric_descriptor);
+  RUN_TEST(sd_output_add);
 
   END_TEST;
 }
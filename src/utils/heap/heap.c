@@ -205,3 +205,17 @@ void *c_heap_get_root(c_heap_t *h) {
 
   return ret;
 } /* void *c_heap_get_root */
+
+void *c_heap_peek_root(c_heap_t *h) {
+  void *ret = NULL;
+
+  if (h == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&h->lock);
+  if (h->list_len > 0)
+    ret = h->list[0];
+  pthread_mutex_unlock(&h->lock);
+
+  return ret;
+} /* void *c_heap_peek_root */
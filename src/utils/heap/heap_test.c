@@ -63,9 +63,11 @@ DEF_TEST(simple) {
 
   for (int i = 0; i < 10; i++) {
     int *ret = NULL;
-    CHECK_NOT_NULL(ret = c_heap_get_root(h));
+    CHECK_NOT_NULL(ret = c_heap_peek_root(h));
     OK(*ret == i);
+    OK(c_heap_get_root(h) == ret);
   }
+  OK(c_heap_peek_root(h) == NULL);
 
   c_heap_destroy(h);
   return 0;
@@ -55,6 +55,10 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
+#include "utils/match_cache/match_cache.h"
+
+/* Number of entries whose result is remembered per list. */
+#define IGNORELIST_CACHE_SIZE 256
 
 /*
  * private prototypes
@@ -71,6 +75,7 @@ typedef struct ignorelist_item_s ignorelist_item_t;
 struct ignorelist_s {
   int ignore;              /* ignore entries */
   ignorelist_item_t *head; /* pointer to the first entry */
+  c_match_cache_t *cache;  /* entry -> whether any item matches it */
 };
 
 /* *** *** *** ********************************************* *** *** *** */
@@ -191,6 +196,9 @@ ignorelist_t *ignorelist_create(int invert) {
    */
   il->ignore = invert ? 0 : 1;
 
+  /* Without a cache, every lookup goes through the list. */
+  il->cache = c_match_cache_create(IGNORELIST_CACHE_SIZE);
+
   return il;
 } /* ignorelist_t *ignorelist_create (int ignore) */
 
@@ -220,6 +228,7 @@ void ignorelist_free(ignorelist_t *il) {
     sfree(this);
   }
 
+  c_match_cache_destroy(il->cache);
   sfree(il);
 } /* void ignorelist_destroy (ignorelist_t *il) */
 
@@ -255,6 +264,8 @@ int ignorelist_add(ignorelist_t *il, const char *entry) {
     return 1;
   }
 
+  c_match_cache_clear(il->cache);
+
 #if HAVE_REGEX_H
   /* regex string is enclosed in "/.../" */
   if ((len > 2) && (entry[0] == '/') && entry[len - 1] == '/') {
@@ -290,20 +301,28 @@ int ignorelist_match(ignorelist_t *il, const char *entry) {
   if ((entry == NULL) || (strlen(entry) == 0))
     return 0;
 
+  size_t entry_len = strlen(entry);
+  int found;
+  if (c_match_cache_get(il->cache, entry, entry_len, &found) == 0)
+    return found ? il->ignore : 1 - il->ignore;
+
   /* traverse list and check entries */
+  found = 0;
   for (ignorelist_item_t *traverse = il->head; traverse != NULL;
        traverse = traverse->next) {
 #if HAVE_REGEX_H
     if (traverse->rmatch != NULL) {
-      if (ignorelist_match_regex(traverse, entry))
-        return il->ignore;
+      found = ignorelist_match_regex(traverse, entry);
     } else
 #endif
     {
-      if (ignorelist_match_string(traverse, entry))
-        return il->ignore;
+      found = ignorelist_match_string(traverse, entry);
     }
+    if (found)
+      break;
   } /* for traverse */
 
-  return 1 - il->ignore;
+  c_match_cache_put(il->cache, entry, entry_len, found);
+
+  return found ? il->ignore : 1 - il->ignore;
 } /* int ignorelist_match (ignorelist_t *il, const char *entry) */
@@ -29,6 +29,7 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/latency/latency.h"
+#include "utils_counter.h"
 
 #include <limits.h>
 #include <math.h>
@@ -42,6 +43,25 @@
 #define HISTOGRAM_DEFAULT_BIN_WIDTH 1048576
 #endif
 
+/* Number of extra bins allocated when a sketch has to grow, so that values
+ * slightly beyond the current range don't cause another allocation. */
+#define SKETCH_BINS_SLACK 32
+
+/* Concurrent counters allocate the bins of their shards in chunks of this
+ * many bins. */
+#define SHARD_CHUNK_BINS 64
+
+/* One thread's share of a concurrent counter. The bins are in chunks that are
+ * allocated when first used and never freed before the counter, so that
+ * adding needs no lock. Readers move the counts into the counter's own bins
+ * with atomic exchanges. "min" and "max" are zero if unset. */
+typedef struct {
+  cdtime_t sum;
+  cdtime_t min;
+  cdtime_t max;
+  uint64_t **chunks;
+} latency_shard_t;
+
 struct latency_counter_s {
   cdtime_t start_time;
 
@@ -53,8 +73,31 @@ struct latency_counter_s {
 
   cdtime_t bin_width;
   int histogram[HISTOGRAM_NUM_BINS];
+
+  /* If "sketch_gamma" is non-zero, the counter uses a DDSketch instead of the
+   * histogram: "sketch_bins[i]" counts the values v with
+   *   gamma^(j-1) < v <= gamma^j, j = sketch_offset + i. */
+  double sketch_gamma;
+  double sketch_log_gamma;
+  int sketch_offset;
+  size_t sketch_bins_num;
+  uint64_t *sketch_bins;
+
+  /* Concurrent counters only, see latency_counter_create_concurrent(). Each
+   * shard is on a cache line of its own. */
+  latency_shard_t *shards;
+  size_t shard_chunks_num;
 };
 
+#define LATENCY_SHARD_SIZE                                                     \
+  (((sizeof(latency_shard_t) + SHARD_COUNTER_LINE - 1) / SHARD_COUNTER_LINE) * \
+   SHARD_COUNTER_LINE)
+
+static latency_shard_t *latency_shard(latency_counter_t const *lc, /* {{{ */
+                                      size_t index) {
+  return (latency_shard_t *)((char *)lc->shards + index * LATENCY_SHARD_SIZE);
+} /* }}} latency_shard_t *latency_shard */
+
 /*
 * Histogram represents the distribution of data, it has a list of "bins".
 * Each bin represents an interval and has a count (frequency) of
@@ -113,6 +156,70 @@ static void change_bin_width(latency_counter_t *lc, cdtime_t latency) /* {{{ */
         CDTIME_T_TO_DOUBLE(new_bin_width));
 } /* }}} void change_bin_width */
 
+/*
+* The sketch (DDSketch) uses bins of exponentially increasing width instead:
+* bin j holds the values in (gamma^(j-1), gamma^j], with
+*   gamma = (1 + alpha) / (1 - alpha)
+* Reporting 2 * gamma^j / (gamma + 1) for a value in bin j is off by at most
+* a factor of alpha, the relative accuracy, regardless of the magnitude of the
+* value. Since cdtime_t values are at most 2^63, only a few thousand bins are
+* needed even for alpha = 0.1%; bins are allocated for the range of values
+* actually seen.
+*/
+static int sketch_index(latency_counter_t const *lc, cdtime_t latency) /* {{{ */
+{
+  return (int)ceil(log((double)latency) / lc->sketch_log_gamma);
+} /* }}} int sketch_index */
+
+static cdtime_t sketch_value(latency_counter_t const *lc, int index) /* {{{ */
+{
+  double value =
+      2.0 * pow(lc->sketch_gamma, (double)index) / (lc->sketch_gamma + 1.0);
+  return (cdtime_t)(value + .5);
+} /* }}} cdtime_t sketch_value */
+
+/* sketch_reserve makes sure that the bins "lower" to "upper", inclusively,
+ * exist. */
+static int sketch_reserve(latency_counter_t *lc, int lower, /* {{{ */
+                          int upper) {
+  int offset = lc->sketch_offset;
+  int end = offset + (int)lc->sketch_bins_num; /* exclusive */
+
+  if ((lc->sketch_bins_num > 0) && (lower >= offset) && (upper < end))
+    return 0;
+
+  if (lc->sketch_bins_num > 0) {
+    if (lower < offset)
+      lower -= SKETCH_BINS_SLACK;
+    else
+      lower = offset;
+    if (upper >= end)
+      upper += SKETCH_BINS_SLACK;
+    else
+      upper = end - 1;
+  } else {
+    lower -= SKETCH_BINS_SLACK;
+    upper += SKETCH_BINS_SLACK;
+  }
+  if (lower < 0)
+    lower = 0;
+
+  size_t bins_num = (size_t)(upper - lower + 1);
+  uint64_t *bins = calloc(bins_num, sizeof(*bins));
+  if (bins == NULL)
+    return ENOMEM;
+
+  if (lc->sketch_bins_num > 0)
+    memcpy(bins + (offset - lower), lc->sketch_bins,
+           lc->sketch_bins_num * sizeof(*bins));
+
+  sfree(lc->sketch_bins);
+  lc->sketch_bins = bins;
+  lc->sketch_bins_num = bins_num;
+  lc->sketch_offset = lower;
+  return 0;
+} /* }}} int sketch_reserve */
+
 latency_counter_t *latency_counter_create(void) /* {{{ */
 {
   latency_counter_t *lc;
@@ -126,20 +233,190 @@ latency_counter_t *latency_counter_create(void) /* {{{ */
   return lc;
 } /* }}} latency_counter_t *latency_counter_create */
 
+latency_counter_t *latency_counter_create_sketch(/* {{{ */
+                                                 double relative_accuracy) {
+  if (!(relative_accuracy > 0.0) || !(relative_accuracy < 1.0))
+    return NULL;
+
+  latency_counter_t *lc = latency_counter_create();
+  if (lc == NULL)
+    return NULL;
+
+  lc->sketch_gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+  lc->sketch_log_gamma = log(lc->sketch_gamma);
+  return lc;
+} /* }}} latency_counter_t *latency_counter_create_sketch */
+
+latency_counter_t *latency_counter_create_concurrent(/* {{{ */
+                                                     double relative_accuracy) {
+  latency_counter_t *lc = latency_counter_create_sketch(relative_accuracy);
+  if (lc == NULL)
+    return NULL;
+
+  /* Enough chunks for every index of a positive cdtime_t. */
+  size_t bins_num = (size_t)sketch_index(lc, (cdtime_t)LLONG_MAX) + 1;
+  lc->shard_chunks_num = (bins_num + SHARD_CHUNK_BINS - 1) / SHARD_CHUNK_BINS;
+
+  void *shards = NULL;
+  if (posix_memalign(&shards, SHARD_COUNTER_LINE,
+                     SHARD_COUNTER_SHARDS * LATENCY_SHARD_SIZE) != 0) {
+    latency_counter_destroy(lc);
+    return NULL;
+  }
+  memset(shards, 0, SHARD_COUNTER_SHARDS * LATENCY_SHARD_SIZE);
+  lc->shards = shards;
+
+  for (size_t i = 0; i < SHARD_COUNTER_SHARDS; i++) {
+    latency_shard_t *shard = latency_shard(lc, i);
+    shard->chunks = calloc(lc->shard_chunks_num, sizeof(*shard->chunks));
+    if (shard->chunks == NULL) {
+      latency_counter_destroy(lc);
+      return NULL;
+    }
+  }
+
+  return lc;
+} /* }}} latency_counter_t *latency_counter_create_concurrent */
+
 void latency_counter_destroy(latency_counter_t *lc) /* {{{ */
 {
+  if (lc == NULL)
+    return;
+
+  if (lc->shards != NULL) {
+    for (size_t i = 0; i < SHARD_COUNTER_SHARDS; i++) {
+      latency_shard_t *shard = latency_shard(lc, i);
+      for (size_t j = 0; (shard->chunks != NULL) && (j < lc->shard_chunks_num);
+           j++)
+        free(shard->chunks[j]);
+      free(shard->chunks);
+    }
+    free(lc->shards);
+  }
+
+  sfree(lc->sketch_bins);
   sfree(lc);
 } /* }}} void latency_counter_destroy */
 
-void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
+/* Adds to the calling thread's shard. Min and max are updated before the bin,
+ * so that a reader that sees the bin's count also sees them. */
+static void concurrent_add(latency_counter_t *lc, cdtime_t latency, /* {{{ */
+                           uint64_t count) {
+  latency_shard_t *shard = latency_shard(lc, shard_counter_index());
+  int index = sketch_index(lc, latency);
+  if ((index < 0) ||
+      ((size_t)index >= lc->shard_chunks_num * SHARD_CHUNK_BINS))
+    return;
+
+  uint64_t **chunk_ptr = shard->chunks + (index / SHARD_CHUNK_BINS);
+  uint64_t *chunk = __atomic_load_n(chunk_ptr, __ATOMIC_ACQUIRE);
+  if (chunk == NULL) {
+    uint64_t *new_chunk = calloc(SHARD_CHUNK_BINS, sizeof(*new_chunk));
+    if (new_chunk == NULL) {
+      P_ERROR("latency_counter_add: Allocating sketch bins failed.");
+      return;
+    }
+    /* Threads sharing the shard may race to allocate the chunk. */
+    if (__atomic_compare_exchange_n(chunk_ptr, &chunk, new_chunk,
+                                    /* weak = */ false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE))
+      chunk = new_chunk;
+    else
+      free(new_chunk);
+  }
+
+  cdtime_t cur = __atomic_load_n(&shard->min, __ATOMIC_RELAXED);
+  while (((cur == 0) || (cur > latency)) &&
+         !__atomic_compare_exchange_n(&shard->min, &cur, latency,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+    ;
+  cur = __atomic_load_n(&shard->max, __ATOMIC_RELAXED);
+  while ((cur < latency) &&
+         !__atomic_compare_exchange_n(&shard->max, &cur, latency,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+    ;
+  __atomic_fetch_add(&shard->sum, latency * count, __ATOMIC_RELAXED);
+  __atomic_fetch_add(chunk + (index % SHARD_CHUNK_BINS), count,
+                     __ATOMIC_RELEASE);
+} /* }}} void concurrent_add */
+
+/* Moves the counts of all shards into the counter's own bins. Readers of a
+ * concurrent counter call this first. Values being added at the same time end
+ * up in this or the next read. */
+static void concurrent_fold(latency_counter_t *lc) /* {{{ */
+{
+  if (lc->shards == NULL)
+    return;
+
+  for (size_t i = 0; i < SHARD_COUNTER_SHARDS; i++) {
+    latency_shard_t *shard = latency_shard(lc, i);
+    uint64_t num = 0;
+
+    for (size_t j = 0; j < lc->shard_chunks_num; j++) {
+      uint64_t *chunk = __atomic_load_n(shard->chunks + j, __ATOMIC_ACQUIRE);
+      if (chunk == NULL)
+        continue;
+
+      for (size_t k = 0; k < SHARD_CHUNK_BINS; k++) {
+        if (__atomic_load_n(chunk + k, __ATOMIC_RELAXED) == 0)
+          continue;
+
+        uint64_t n = __atomic_exchange_n(chunk + k, 0, __ATOMIC_ACQ_REL);
+        int index = (int)(j * SHARD_CHUNK_BINS + k);
+        if (sketch_reserve(lc, index, index) != 0) {
+          P_ERROR("latency_counter: Allocating sketch bins failed.");
+          continue;
+        }
+        lc->sketch_bins[index - lc->sketch_offset] += n;
+        num += n;
+      }
+    }
+
+    cdtime_t sum = __atomic_exchange_n(&shard->sum, 0, __ATOMIC_RELAXED);
+    cdtime_t min = __atomic_exchange_n(&shard->min, 0, __ATOMIC_RELAXED);
+    cdtime_t max = __atomic_exchange_n(&shard->max, 0, __ATOMIC_RELAXED);
+
+    if ((min != 0) && ((lc->min == 0) || (lc->min > min)))
+      lc->min = min;
+    if (lc->max < max)
+      lc->max = max;
+    lc->sum += sum;
+    lc->num += num;
+  }
+
+  /* An add racing with the previous read may have left its min and max
+   * there; fall back to the sketch's range. */
+  if ((lc->num > 0) && ((lc->min == 0) || (lc->max == 0))) {
+    for (size_t i = 0; i < lc->sketch_bins_num; i++) {
+      if (lc->sketch_bins[i] == 0)
+        continue;
+      cdtime_t value = sketch_value(lc, lc->sketch_offset + (int)i);
+      if ((lc->min == 0) || (lc->min > value))
+        lc->min = value;
+      if (lc->max < value)
+        lc->max = value;
+    }
+  }
+} /* }}} void concurrent_fold */
+
+void latency_counter_add_n(latency_counter_t *lc, cdtime_t latency,
+                           uint64_t count) /* {{{ */
 {
   cdtime_t bin;
 
-  if ((lc == NULL) || (latency == 0) || (latency > ((cdtime_t)LLONG_MAX)))
+  if ((lc == NULL) || (latency == 0) || (latency > ((cdtime_t)LLONG_MAX)) ||
+      (count == 0))
     return;
 
-  lc->sum += latency;
-  lc->num++;
+  if (lc->shards != NULL) {
+    concurrent_add(lc, latency, count);
+    return;
+  }
+
+  lc->sum += latency * count;
+  lc->num += count;
 
   if ((lc->min == 0) && (lc->max == 0))
     lc->min = lc->max = latency;
@@ -148,6 +425,16 @@ void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
   if (lc->max < latency)
     lc->max = latency;
 
+  if (lc->sketch_gamma > 0.0) {
+    int index = sketch_index(lc, latency);
+    if (sketch_reserve(lc, index, index) != 0) {
+      P_ERROR("latency_counter_add: Allocating sketch bins failed.");
+      return;
+    }
+    lc->sketch_bins[index - lc->sketch_offset] += count;
+    return;
+  }
+
   /* A latency of _exactly_ 1.0 ms is stored in the buffer 0, so
    * subtract one from the cdtime_t value so that exactly 1.0 ms get sorted
    * accordingly. */
@@ -160,7 +447,12 @@ void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
       return;
     }
   }
-  lc->histogram[bin]++;
+  lc->histogram[bin] += (int)count;
+} /* }}} void latency_counter_add_n */
+
+void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
+{
+  latency_counter_add_n(lc, latency, 1);
 } /* }}} void latency_counter_add */
 
 void latency_counter_reset(latency_counter_t *lc) /* {{{ */
@@ -168,6 +460,9 @@ void latency_counter_reset(latency_counter_t *lc) /* {{{ */
   if (lc == NULL)
     return;
 
+  /* Values added concurrently so far belong to the interval being reset. */
+  concurrent_fold(lc);
+
   cdtime_t bin_width = lc->bin_width;
   cdtime_t max_bin = (lc->max - 1) / lc->bin_width;
 
@@ -188,17 +483,37 @@ void latency_counter_reset(latency_counter_t *lc) /* {{{ */
           CDTIME_T_TO_DOUBLE(lc->bin_width), CDTIME_T_TO_DOUBLE(bin_width));
   }
 
+  /* preserve the sketch's bins */
+  double sketch_gamma = lc->sketch_gamma;
+  double sketch_log_gamma = lc->sketch_log_gamma;
+  int sketch_offset = lc->sketch_offset;
+  size_t sketch_bins_num = lc->sketch_bins_num;
+  uint64_t *sketch_bins = lc->sketch_bins;
+  latency_shard_t *shards = lc->shards;
+  size_t shard_chunks_num = lc->shard_chunks_num;
+
   memset(lc, 0, sizeof(*lc));
 
   /* preserve bin width */
   lc->bin_width = bin_width;
   lc->start_time = cdtime();
+
+  lc->sketch_gamma = sketch_gamma;
+  lc->sketch_log_gamma = sketch_log_gamma;
+  lc->sketch_offset = sketch_offset;
+  lc->sketch_bins_num = sketch_bins_num;
+  lc->sketch_bins = sketch_bins;
+  if (sketch_bins != NULL)
+    memset(sketch_bins, 0, sketch_bins_num * sizeof(*sketch_bins));
+  lc->shards = shards;
+  lc->shard_chunks_num = shard_chunks_num;
 } /* }}} void latency_counter_reset */
 
 cdtime_t latency_counter_get_min(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
     return 0;
+  concurrent_fold(lc);
   return lc->min;
 } /* }}} cdtime_t latency_counter_get_min */
 
@@ -206,6 +521,7 @@ cdtime_t latency_counter_get_max(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
     return 0;
+  concurrent_fold(lc);
   return lc->max;
 } /* }}} cdtime_t latency_counter_get_max */
 
@@ -213,6 +529,7 @@ cdtime_t latency_counter_get_sum(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
     return 0;
+  concurrent_fold(lc);
   return lc->sum;
 } /* }}} cdtime_t latency_counter_get_sum */
 
@@ -220,6 +537,7 @@ size_t latency_counter_get_num(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
     return 0;
+  concurrent_fold(lc);
   return lc->num;
 } /* }}} size_t latency_counter_get_num */
 
@@ -227,13 +545,37 @@ cdtime_t latency_counter_get_average(latency_counter_t *lc) /* {{{ */
 {
   double average;
 
-  if ((lc == NULL) || (lc->num == 0))
+  if (lc == NULL)
+    return 0;
+  concurrent_fold(lc);
+  if (lc->num == 0)
     return 0;
 
   average = CDTIME_T_TO_DOUBLE(lc->sum) / ((double)lc->num);
   return DOUBLE_TO_CDTIME_T(average);
 } /* }}} cdtime_t latency_counter_get_average */
 
+static cdtime_t sketch_get_percentile(latency_counter_t *lc, /* {{{ */
+                                      double percent) {
+  double rank = ((double)lc->num) * percent / 100.0;
+  uint64_t sum = 0;
+
+  for (size_t i = 0; i < lc->sketch_bins_num; i++) {
+    sum += lc->sketch_bins[i];
+    if ((sum == 0) || (((double)sum) < rank))
+      continue;
+
+    cdtime_t value = sketch_value(lc, lc->sketch_offset + (int)i);
+    if (value < lc->min)
+      return lc->min;
+    if (value > lc->max)
+      return lc->max;
+    return value;
+  }
+
+  return lc->max;
+} /* }}} cdtime_t sketch_get_percentile */
+
 cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
                                         double percent) {
   double percent_upper;
@@ -244,9 +586,15 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
   int sum;
   size_t i;
 
-  if ((lc == NULL) || (lc->num == 0) || !((percent > 0.0) && (percent < 100.0)))
+  if (lc == NULL)
+    return 0;
+  concurrent_fold(lc);
+  if ((lc->num == 0) || !((percent > 0.0) && (percent < 100.0)))
     return 0;
 
+  if (lc->sketch_gamma > 0.0)
+    return sketch_get_percentile(lc, percent);
+
   /* Find index i so that at least "percent" events are within i+1 ms. */
   percent_upper = 0.0;
   percent_lower = 0.0;
@@ -283,10 +631,13 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
   return latency_interpolated;
 } /* }}} cdtime_t latency_counter_get_percentile */
 
-double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
+double latency_counter_get_rate(latency_counter_t *lc, /* {{{ */
                                 cdtime_t lower, cdtime_t upper,
                                 const cdtime_t now) {
-  if ((lc == NULL) || (lc->num == 0))
+  if (lc == NULL)
+    return NAN;
+  concurrent_fold(lc);
+  if (lc->num == 0)
     return NAN;
 
   if (upper && (upper < lower))
@@ -294,6 +645,18 @@ double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
   if (lower == upper)
     return 0;
 
+  if (lc->sketch_gamma > 0.0) {
+    /* Bins are counted if their representative value is within the
+     * interval. */
+    double sum = 0;
+    for (size_t i = 0; i < lc->sketch_bins_num; i++) {
+      cdtime_t value = sketch_value(lc, lc->sketch_offset + (int)i);
+      if ((value > lower) && ((upper == 0) || (value <= upper)))
+        sum += (double)lc->sketch_bins[i];
+    }
+    return sum / (CDTIME_T_TO_DOUBLE(now - lc->start_time));
+  }
+
   /* Buckets have an exclusive lower bound and an inclusive upper bound. That
    * means that the first bucket, index 0, represents (0-bin_width]. That means
    * that latency==bin_width needs to result in bin=0, that's why we need to
@@ -342,3 +705,44 @@ double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
 
   return sum / (CDTIME_T_TO_DOUBLE(now - lc->start_time));
 } /* }}} double latency_counter_get_rate */
+
+int latency_counter_merge(latency_counter_t *dst, /* {{{ */
+                          latency_counter_t *src) {
+  if ((dst == NULL) || (src == NULL) || (dst->sketch_gamma == 0.0) ||
+      (dst->sketch_gamma != src->sketch_gamma))
+    return EINVAL;
+
+  concurrent_fold(dst);
+  concurrent_fold(src);
+
+  if (src->num == 0)
+    return 0;
+
+  /* Find the range of bins used by src. */
+  size_t first = 0;
+  while ((first < src->sketch_bins_num) && (src->sketch_bins[first] == 0))
+    first++;
+  size_t last = src->sketch_bins_num;
+  while ((last > first) && (src->sketch_bins[last - 1] == 0))
+    last--;
+
+  if (first < last) {
+    int status = sketch_reserve(dst, src->sketch_offset + (int)first,
+                                src->sketch_offset + (int)last - 1);
+    if (status != 0)
+      return status;
+
+    for (size_t i = first; i < last; i++)
+      dst->sketch_bins[src->sketch_offset + (int)i - dst->sketch_offset] +=
+          src->sketch_bins[i];
+  }
+
+  if ((dst->num == 0) || (dst->min > src->min))
+    dst->min = src->min;
+  if ((dst->num == 0) || (dst->max < src->max))
+    dst->max = src->max;
+  dst->sum += src->sum;
+  dst->num += src->num;
+
+  return 0;
+} /* }}} int latency_counter_merge */
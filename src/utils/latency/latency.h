@@ -36,9 +36,49 @@ struct latency_counter_s;
 typedef struct latency_counter_s latency_counter_t;
 
 latency_counter_t *latency_counter_create(void);
+
+/*
+ * NAME
+ *  latency_counter_create_sketch(relative_accuracy)
+ *
+ * DESCRIPTION
+ *   Creates a latency counter that keeps a logarithmic sketch (DDSketch)
+ *   instead of a fixed width histogram. Percentiles reported by the sketch are
+ *   within "relative_accuracy" (e.g. 0.01 for 1%) of the true value over the
+ *   whole range of cdtime_t, and the sketch never needs to be rebinned.
+ *   Memory used is proportional to log(max/min) of the values added.
+ *
+ * RETURN VALUE
+ *   The new counter or NULL if "relative_accuracy" is not within (0, 1) or
+ *   memory could not be allocated.
+ */
+latency_counter_t *latency_counter_create_sketch(double relative_accuracy);
+
+/*
+ * NAME
+ *  latency_counter_create_concurrent(relative_accuracy)
+ *
+ * DESCRIPTION
+ *   Creates a sketch, see above, that any number of threads can add to
+ *   without locking. Every thread adds to a shard of its own; the shards are
+ *   merged into the counter by the functions reading or resetting it, which
+ *   still have to be serialized among themselves, but not with adding.
+ *   Values added while the counter is read are counted in this or the next
+ *   read.
+ *
+ * RETURN VALUE
+ *   The new counter or NULL if "relative_accuracy" is not within (0, 1) or
+ *   memory could not be allocated.
+ */
+latency_counter_t *latency_counter_create_concurrent(double relative_accuracy);
 void latency_counter_destroy(latency_counter_t *lc);
 
 void latency_counter_add(latency_counter_t *lc, cdtime_t latency);
+
+/* Adds "latency" "count" times, e.g. for the buckets of a histogram kept
+ * elsewhere. */
+void latency_counter_add_n(latency_counter_t *lc, cdtime_t latency,
+                           uint64_t count);
 void latency_counter_reset(latency_counter_t *lc);
 
 cdtime_t latency_counter_get_min(latency_counter_t *lc);
@@ -48,6 +88,20 @@ size_t latency_counter_get_num(latency_counter_t *lc);
 cdtime_t latency_counter_get_average(latency_counter_t *lc);
 cdtime_t latency_counter_get_percentile(latency_counter_t *lc, double percent);
 
+/*
+ * NAME
+ *  latency_counter_merge(dst,src)
+ *
+ * DESCRIPTION
+ *   Adds all values of "src" to "dst", as if they had been added to "dst"
+ *   directly. Both counters must be sketches with the same relative accuracy.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EINVAL if the counters can not be merged and ENOMEM if
+ *   memory could not be allocated.
+ */
+int latency_counter_merge(latency_counter_t *dst, latency_counter_t *src);
+
 /*
  * NAME
  *  latency_counter_get_rate(counter,lower,upper,now)
@@ -59,5 +113,5 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, double percent);
  *   When lower is zero, then the interval is (0, upper].
  *   When upper is zero, then the interval is (lower, infinity).
  */
-double latency_counter_get_rate(const latency_counter_t *lc, cdtime_t lower,
+double latency_counter_get_rate(latency_counter_t *lc, cdtime_t lower,
                                 cdtime_t upper, const cdtime_t now);
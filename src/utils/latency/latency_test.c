@@ -225,10 +225,196 @@ DEF_TEST(get_rate) {
   return 0;
 }
 
+/* Values from 1 microsecond to 100 seconds, equally spaced on a log scale. */
+#define SKETCH_VALUES_NUM 8000
+static double sketch_value_at(size_t i) {
+  return 1e-6 * pow(1e8, ((double)i) / ((double)(SKETCH_VALUES_NUM - 1)));
+}
+
+DEF_TEST(sketch_percentile) {
+  double percentiles[] = {1.0, 10.0, 50.0, 90.0, 99.0, 99.9};
+  double accuracy = 0.01;
+  latency_counter_t *l;
+
+  CHECK_NOT_NULL(l = latency_counter_create_sketch(accuracy));
+
+  /* add values in a random-ish order */
+  for (size_t i = 0; i < SKETCH_VALUES_NUM; i++)
+    latency_counter_add(
+        l, DOUBLE_TO_CDTIME_T(sketch_value_at((i * 7919) % SKETCH_VALUES_NUM)));
+  EXPECT_EQ_UINT64(SKETCH_VALUES_NUM, latency_counter_get_num(l));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percentiles); i++) {
+    size_t rank =
+        (size_t)ceil(percentiles[i] * SKETCH_VALUES_NUM / 100.0) - 1;
+    /* compare to the value actually added, i.e. after conversion to
+     * cdtime_t, allowing for rounding of the result. */
+    double want = (double)DOUBLE_TO_CDTIME_T(sketch_value_at(rank));
+    double got = (double)latency_counter_get_percentile(l, percentiles[i]);
+
+    printf("# percentile %g: want %g, got %g\n", percentiles[i], want, got);
+    OK(fabs(got - want) <= accuracy * want + 1.0);
+  }
+
+  /* Resetting keeps the counter a sketch. */
+  latency_counter_reset(l);
+  EXPECT_EQ_UINT64(0, latency_counter_get_num(l));
+  latency_counter_add(l, DOUBLE_TO_CDTIME_T(0.5));
+  EXPECT_EQ_DOUBLE(
+      0.5, CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(l, 50.0)));
+
+  latency_counter_destroy(l);
+  return 0;
+}
+
+DEF_TEST(sketch_merge) {
+  latency_counter_t *all;
+  latency_counter_t *even;
+  latency_counter_t *odd;
+
+  CHECK_NOT_NULL(all = latency_counter_create_sketch(0.02));
+  CHECK_NOT_NULL(even = latency_counter_create_sketch(0.02));
+  CHECK_NOT_NULL(odd = latency_counter_create_sketch(0.02));
+
+  for (size_t i = 0; i < SKETCH_VALUES_NUM; i++) {
+    cdtime_t value = DOUBLE_TO_CDTIME_T(sketch_value_at(i));
+    latency_counter_add(all, value);
+    latency_counter_add((i % 2) ? odd : even, value);
+  }
+
+  EXPECT_EQ_INT(0, latency_counter_merge(even, odd));
+  EXPECT_EQ_UINT64(latency_counter_get_num(all), latency_counter_get_num(even));
+  EXPECT_EQ_UINT64(latency_counter_get_min(all), latency_counter_get_min(even));
+  EXPECT_EQ_UINT64(latency_counter_get_max(all), latency_counter_get_max(even));
+  EXPECT_EQ_UINT64(latency_counter_get_sum(all), latency_counter_get_sum(even));
+  for (double p = 5.0; p < 100.0; p += 5.0)
+    EXPECT_EQ_UINT64(latency_counter_get_percentile(all, p),
+                     latency_counter_get_percentile(even, p));
+
+  /* Only sketches with the same accuracy can be merged. */
+  latency_counter_t *other;
+  CHECK_NOT_NULL(other = latency_counter_create_sketch(0.01));
+  EXPECT_EQ_INT(EINVAL, latency_counter_merge(other, all));
+  latency_counter_destroy(other);
+
+  CHECK_NOT_NULL(other = latency_counter_create());
+  EXPECT_EQ_INT(EINVAL, latency_counter_merge(other, all));
+  latency_counter_destroy(other);
+
+  EXPECT_EQ_PTR(NULL, latency_counter_create_sketch(0.0));
+  EXPECT_EQ_PTR(NULL, latency_counter_create_sketch(1.0));
+
+  latency_counter_destroy(all);
+  latency_counter_destroy(even);
+  latency_counter_destroy(odd);
+  return 0;
+}
+
+DEF_TEST(add_n) {
+  /* Adding a value n times is the same as adding it once n times. */
+  for (int sketch = 0; sketch < 2; sketch++) {
+    latency_counter_t *once;
+    latency_counter_t *many;
+
+    if (sketch) {
+      CHECK_NOT_NULL(once = latency_counter_create_sketch(0.01));
+      CHECK_NOT_NULL(many = latency_counter_create_sketch(0.01));
+    } else {
+      CHECK_NOT_NULL(once = latency_counter_create());
+      CHECK_NOT_NULL(many = latency_counter_create());
+    }
+
+    /* 10 values of 1ms, 30 of 4ms and 60 of 900ms. */
+    uint64_t counts[] = {10, 30, 60};
+    cdtime_t values[] = {MS_TO_CDTIME_T(1), MS_TO_CDTIME_T(4),
+                         MS_TO_CDTIME_T(900)};
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(counts); i++) {
+      latency_counter_add_n(many, values[i], counts[i]);
+      for (uint64_t j = 0; j < counts[i]; j++)
+        latency_counter_add(once, values[i]);
+    }
+    latency_counter_add_n(many, MS_TO_CDTIME_T(5000), 0);
+
+    EXPECT_EQ_UINT64(100, latency_counter_get_num(many));
+    EXPECT_EQ_UINT64(latency_counter_get_sum(once),
+                     latency_counter_get_sum(many));
+    EXPECT_EQ_UINT64(MS_TO_CDTIME_T(1), latency_counter_get_min(many));
+    EXPECT_EQ_UINT64(MS_TO_CDTIME_T(900), latency_counter_get_max(many));
+    for (double p = 5.0; p < 100.0; p += 5.0)
+      EXPECT_EQ_UINT64(latency_counter_get_percentile(once, p),
+                       latency_counter_get_percentile(many, p));
+
+    latency_counter_destroy(once);
+    latency_counter_destroy(many);
+  }
+  return 0;
+}
+
+#define CONCURRENT_THREADS 8
+
+static void *concurrent_thread(void *arg) {
+  latency_counter_t *lc = arg;
+
+  for (size_t i = 0; i < SKETCH_VALUES_NUM; i++)
+    latency_counter_add(lc, DOUBLE_TO_CDTIME_T(sketch_value_at(i)));
+  return NULL;
+}
+
+DEF_TEST(concurrent) {
+  latency_counter_t *want;
+  latency_counter_t *lc;
+  pthread_t threads[CONCURRENT_THREADS];
+
+  CHECK_NOT_NULL(want = latency_counter_create_sketch(0.01));
+  CHECK_NOT_NULL(lc = latency_counter_create_concurrent(0.01));
+
+  for (size_t i = 0; i < CONCURRENT_THREADS; i++)
+    concurrent_thread(want);
+  for (size_t i = 0; i < CONCURRENT_THREADS; i++)
+    CHECK_ZERO(pthread_create(threads + i, NULL, concurrent_thread, lc));
+
+  /* Reading while other threads add must not lose values. */
+  size_t num = 0;
+  while (num < CONCURRENT_THREADS * SKETCH_VALUES_NUM / 2)
+    num = latency_counter_get_num(lc);
+
+  for (size_t i = 0; i < CONCURRENT_THREADS; i++)
+    CHECK_ZERO(pthread_join(threads[i], NULL));
+
+  EXPECT_EQ_UINT64(latency_counter_get_num(want), latency_counter_get_num(lc));
+  EXPECT_EQ_UINT64(latency_counter_get_min(want), latency_counter_get_min(lc));
+  EXPECT_EQ_UINT64(latency_counter_get_max(want), latency_counter_get_max(lc));
+  EXPECT_EQ_UINT64(latency_counter_get_sum(want), latency_counter_get_sum(lc));
+  for (double p = 5.0; p < 100.0; p += 5.0)
+    EXPECT_EQ_UINT64(latency_counter_get_percentile(want, p),
+                     latency_counter_get_percentile(lc, p));
+
+  /* Concurrent counters can be merged like other sketches. */
+  EXPECT_EQ_INT(0, latency_counter_merge(want, lc));
+  EXPECT_EQ_UINT64(2 * CONCURRENT_THREADS * SKETCH_VALUES_NUM,
+                   latency_counter_get_num(want));
+
+  latency_counter_reset(lc);
+  EXPECT_EQ_UINT64(0, latency_counter_get_num(lc));
+  latency_counter_add(lc, MS_TO_CDTIME_T(3));
+  EXPECT_EQ_UINT64(1, latency_counter_get_num(lc));
+  EXPECT_EQ_UINT64(MS_TO_CDTIME_T(3), latency_counter_get_max(lc));
+
+  EXPECT_EQ_PTR(NULL, latency_counter_create_concurrent(0.0));
+
+  latency_counter_destroy(want);
+  latency_counter_destroy(lc);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(simple);
   RUN_TEST(percentile);
   RUN_TEST(get_rate);
+  RUN_TEST(sketch_percentile);
+  RUN_TEST(sketch_merge);
+  RUN_TEST(add_n);
+  RUN_TEST(concurrent);
 
   END_TEST;
 }
@@ -0,0 +1,316 @@
+/**
+ * collectd - src/utils/log_queue/log_queue.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/log_queue/log_queue.h"
+
+#include <sys/stat.h>
+
+/* Like c_complain(), repeats are reported at most once a day. */
+#define LOG_QUEUE_COALESCE_MAX TIME_T_TO_CDTIME_T(86400)
+
+#define LOG_FILE_CHECK_INTERVAL TIME_T_TO_CDTIME_T(1)
+
+struct log_queue_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+  bool stopping;
+
+  /* Entries [tail, head) are waiting to be written. The writer leaves the
+   * lock while writing them, so they are only released afterwards. */
+  log_queue_entry_t *ring;
+  size_t length;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t dropped;
+
+  log_queue_write_cb write;
+  log_queue_flush_cb flush;
+  void *arg;
+
+  /* The last message and how often it has been repeated in the current
+   * interval. */
+  cdtime_t coalesce_interval;
+  bool have_last;
+  int last_severity;
+  char last_msg[LOG_QUEUE_MSG_SIZE];
+  uint64_t repeats;
+  cdtime_t window_start;
+  cdtime_t window;
+};
+
+static void enqueue(log_queue_t *q, int severity, cdtime_t time,
+                    bool notification, char const *msg);
+
+static void report_repeats(log_queue_t *q, cdtime_t now) {
+  char msg[64];
+  snprintf(msg, sizeof(msg), "last message repeated %" PRIu64 " times",
+           q->repeats);
+  q->repeats = 0;
+  enqueue(q, q->last_severity, now, /* notification = */ false, msg);
+}
+
+/* Writes a message or adds it to the ring. Requires the lock. */
+static void enqueue(log_queue_t *q, int severity, cdtime_t time,
+                    bool notification, char const *msg) {
+  if (!q->running) {
+    log_queue_entry_t e = {
+        .severity = severity, .time = time, .notification = notification,
+    };
+    sstrncpy(e.msg, msg, sizeof(e.msg));
+    q->write(&e, q->arg);
+    if (q->flush != NULL)
+      q->flush(q->arg);
+    return;
+  }
+
+  if ((q->dropped > 0) && (q->head - q->tail + 2 <= q->length)) {
+    char report[64];
+    snprintf(report, sizeof(report),
+             "log queue full, dropped %" PRIu64 " messages", q->dropped);
+    q->dropped = 0;
+    enqueue(q, LOG_WARNING, time, /* notification = */ false, report);
+  }
+
+  if (q->head - q->tail >= q->length) {
+    q->dropped++;
+    return;
+  }
+
+  log_queue_entry_t *e = q->ring + (q->head % q->length);
+  e->severity = severity;
+  e->time = time;
+  e->notification = notification;
+  sstrncpy(e->msg, msg, sizeof(e->msg));
+  q->head++;
+
+  pthread_cond_signal(&q->cond);
+}
+
+static void *log_queue_thread(void *arg) {
+  log_queue_t *q = arg;
+
+  pthread_mutex_lock(&q->lock);
+  while (true) {
+    while ((q->head == q->tail) && !q->stopping) {
+      if (q->repeats == 0) {
+        pthread_cond_wait(&q->cond, &q->lock);
+        continue;
+      }
+
+      /* Report the repeats of a message that isn't followed by another one
+       * at the end of the interval. */
+      cdtime_t deadline = q->window_start + q->window;
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(deadline);
+      pthread_cond_timedwait(&q->cond, &q->lock, &ts);
+
+      cdtime_t now = cdtime();
+      if ((q->repeats > 0) && (now >= q->window_start + q->window)) {
+        report_repeats(q, now);
+        q->window_start = now;
+        q->window *= 2;
+        if (q->window > LOG_QUEUE_COALESCE_MAX)
+          q->window = LOG_QUEUE_COALESCE_MAX;
+      }
+    }
+
+    if (q->head == q->tail)
+      break;
+
+    uint64_t tail = q->tail;
+    uint64_t num = q->head - tail;
+    pthread_mutex_unlock(&q->lock);
+
+    for (uint64_t i = 0; i < num; i++)
+      q->write(q->ring + ((tail + i) % q->length), q->arg);
+    if (q->flush != NULL)
+      q->flush(q->arg);
+
+    pthread_mutex_lock(&q->lock);
+    q->tail += num;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  return NULL;
+} /* void *log_queue_thread */
+
+log_queue_t *log_queue_create(size_t length, cdtime_t coalesce_interval,
+                              log_queue_write_cb write,
+                              log_queue_flush_cb flush, void *arg) {
+  if ((length == 0) || (write == NULL)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  log_queue_t *q = calloc(1, sizeof(*q));
+  if (q == NULL)
+    return NULL;
+
+  q->ring = calloc(length, sizeof(*q->ring));
+  if (q->ring == NULL) {
+    free(q);
+    return NULL;
+  }
+  q->length = length;
+  q->write = write;
+  q->flush = flush;
+  q->arg = arg;
+  q->coalesce_interval = coalesce_interval;
+
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->cond, NULL);
+
+  return q;
+} /* log_queue_t *log_queue_create */
+
+int log_queue_start(log_queue_t *q) {
+  pthread_mutex_lock(&q->lock);
+  if (q->running) {
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+  }
+
+  q->running = true;
+  int status = pthread_create(&q->thread, NULL, log_queue_thread, q);
+  if (status != 0)
+    q->running = false;
+  pthread_mutex_unlock(&q->lock);
+
+  return status;
+} /* int log_queue_start */
+
+void log_queue_stop(log_queue_t *q) {
+  pthread_mutex_lock(&q->lock);
+  if (q->running) {
+    q->stopping = true;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->thread, NULL);
+
+    pthread_mutex_lock(&q->lock);
+    q->running = false;
+    q->stopping = false;
+  }
+
+  if (q->repeats > 0)
+    report_repeats(q, cdtime());
+  pthread_mutex_unlock(&q->lock);
+} /* void log_queue_stop */
+
+void log_queue_destroy(log_queue_t *q) {
+  if (q == NULL)
+    return;
+
+  log_queue_stop(q);
+
+  pthread_cond_destroy(&q->cond);
+  pthread_mutex_destroy(&q->lock);
+  free(q->ring);
+  free(q);
+} /* void log_queue_destroy */
+
+void log_queue_push(log_queue_t *q, int severity, cdtime_t time,
+                    char const *msg) {
+  pthread_mutex_lock(&q->lock);
+
+  if ((q->coalesce_interval > 0) && q->have_last &&
+      (severity == q->last_severity) &&
+      (strncmp(msg, q->last_msg, sizeof(q->last_msg) - 1) == 0)) {
+    q->repeats++;
+    if (time >= q->window_start + q->window) {
+      report_repeats(q, time);
+      q->window_start = time;
+      q->window *= 2;
+      if (q->window > LOG_QUEUE_COALESCE_MAX)
+        q->window = LOG_QUEUE_COALESCE_MAX;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return;
+  }
+
+  if (q->repeats > 0)
+    report_repeats(q, time);
+
+  if (q->coalesce_interval > 0) {
+    q->have_last = true;
+    q->last_severity = severity;
+    sstrncpy(q->last_msg, msg, sizeof(q->last_msg));
+    q->window_start = time;
+    q->window = q->coalesce_interval;
+  }
+
+  enqueue(q, severity, time, /* notification = */ false, msg);
+  pthread_mutex_unlock(&q->lock);
+} /* void log_queue_push */
+
+void log_queue_push_notification(log_queue_t *q, int severity, cdtime_t time,
+                                 char const *msg) {
+  pthread_mutex_lock(&q->lock);
+  enqueue(q, severity, time, /* notification = */ true, msg);
+  pthread_mutex_unlock(&q->lock);
+} /* void log_queue_push_notification */
+
+FILE *log_file_get(log_file_t *lf, char const *path) {
+  if ((path == NULL) || (strcasecmp(path, "stderr") == 0))
+    return stderr;
+  if (strcasecmp(path, "stdout") == 0)
+    return stdout;
+
+  cdtime_t now = cdtime();
+  if (lf->fh != NULL) {
+    if (now - lf->last_check < LOG_FILE_CHECK_INTERVAL)
+      return lf->fh;
+
+    struct stat st;
+    if ((stat(path, &st) == 0) && (st.st_dev == lf->dev) &&
+        (st.st_ino == lf->ino)) {
+      lf->last_check = now;
+      return lf->fh;
+    }
+    log_file_close(lf);
+  }
+
+  lf->fh = fopen(path, "a");
+  if (lf->fh == NULL)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fileno(lf->fh), &st) == 0) {
+    lf->dev = st.st_dev;
+    lf->ino = st.st_ino;
+  }
+  lf->last_check = now;
+
+  return lf->fh;
+} /* FILE *log_file_get */
+
+void log_file_close(log_file_t *lf) {
+  if (lf->fh != NULL)
+    fclose(lf->fh);
+  lf->fh = NULL;
+} /* void log_file_close */
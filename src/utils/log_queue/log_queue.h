@@ -0,0 +1,120 @@
+/**
+ * collectd - src/utils/log_queue/log_queue.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_LOG_QUEUE_H
+#define UTILS_LOG_QUEUE_H 1
+
+#include "plugin.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* A log queue decouples the callers of a log plugin from its output. The
+ * messages are copied into a ring and written by a thread of the queue, which
+ * flushes the output once per batch. While the thread isn't running, i.e.
+ * before `log_queue_start' and after `log_queue_stop', messages are written
+ * right away. A message that is the same as the one before it is counted
+ * instead of written, and the count is reported once per interval. The
+ * interval doubles while the message keeps repeating. If the ring is full,
+ * messages are dropped and the number of dropped messages is reported.
+ *
+ * The callbacks must not log through the daemon, i.e. use ERROR() and
+ * friends, since that may end up in the queue. */
+
+/* Size of a message including the terminating null byte. Longer ones are
+ * truncated. Large enough for the messages of plugin_log() and for
+ * notifications rendered by the log plugins. */
+#define LOG_QUEUE_MSG_SIZE 2048
+
+#define LOG_QUEUE_LENGTH 256
+#define LOG_QUEUE_COALESCE_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+typedef struct {
+  int severity;
+  cdtime_t time;
+  /* Notifications are never coalesced. */
+  bool notification;
+  char msg[LOG_QUEUE_MSG_SIZE];
+} log_queue_entry_t;
+
+/* Writes one message. */
+typedef void (*log_queue_write_cb)(log_queue_entry_t const *e, void *arg);
+/* Called after a batch of messages has been written, may be NULL. */
+typedef void (*log_queue_flush_cb)(void *arg);
+
+struct log_queue_s;
+typedef struct log_queue_s log_queue_t;
+
+/*
+ * NAME
+ *   log_queue_create
+ *
+ * DESCRIPTION
+ *   Creates a queue with room for `length' messages. If `coalesce_interval'
+ *   is zero, repeated messages are written like any other.
+ *
+ * RETURN VALUE
+ *   A log_queue_t-pointer upon success or NULL upon failure.
+ */
+log_queue_t *log_queue_create(size_t length, cdtime_t coalesce_interval,
+                              log_queue_write_cb write,
+                              log_queue_flush_cb flush, void *arg);
+
+/* Stops the queue, writing the messages in it, and frees it. */
+void log_queue_destroy(log_queue_t *q);
+
+/* Starts the thread writing the messages. Returns zero upon success. */
+int log_queue_start(log_queue_t *q);
+
+/* Writes the messages in the queue and stops the thread. */
+void log_queue_stop(log_queue_t *q);
+
+/* Adds a message. Doesn't block on the output, but may drop the message. */
+void log_queue_push(log_queue_t *q, int severity, cdtime_t time,
+                    char const *msg);
+
+/* Adds a notification, which is never coalesced with other messages. */
+void log_queue_push_notification(log_queue_t *q, int severity, cdtime_t time,
+                                 char const *msg);
+
+/* A file kept open between messages. It's opened again when the file at
+ * `path' is not the one open anymore, e.g. after it has been rotated. The
+ * names "stdout" and "stderr" and a NULL path refer to the standard streams.
+ */
+typedef struct {
+  FILE *fh;
+  dev_t dev;
+  ino_t ino;
+  cdtime_t last_check;
+} log_file_t;
+
+#define LOG_FILE_INIT                                                          \
+  { .fh = NULL }
+
+/* Returns the stream to write to, or NULL if the file can't be opened. */
+FILE *log_file_get(log_file_t *lf, char const *path);
+
+void log_file_close(log_file_t *lf);
+
+#endif /* UTILS_LOG_QUEUE_H */
@@ -0,0 +1,179 @@
+/**
+ * collectd - src/utils/log_queue/log_queue_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* testing.h comes first so that utils_time.h declares cdtime_mock. */
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/log_queue/log_queue.h"
+
+#include <sys/stat.h>
+
+#define T(s) TIME_T_TO_CDTIME_T(1000 + (s))
+
+/* The messages written, one per line. */
+static char written[16384];
+static int flushes;
+
+/* Held by the tests to keep the writer thread from writing. */
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void write_cb(log_queue_entry_t const *e, void *arg) {
+  pthread_mutex_lock(&write_lock);
+  size_t len = strlen(written);
+  snprintf(written + len, sizeof(written) - len, "%d %s%s\n", e->severity,
+           e->notification ? "N " : "", e->msg);
+  pthread_mutex_unlock(&write_lock);
+}
+
+static void flush_cb(void *arg) { flushes++; }
+
+static void reset(void) {
+  written[0] = 0;
+  flushes = 0;
+}
+
+DEF_TEST(synchronous) {
+  log_queue_t *q;
+  reset();
+
+  CHECK_NOT_NULL(q = log_queue_create(4, 0, write_cb, flush_cb, NULL));
+  log_queue_push(q, LOG_INFO, T(0), "one");
+  log_queue_push(q, LOG_INFO, T(0), "one");
+  log_queue_push_notification(q, LOG_WARNING, T(0), "two");
+  EXPECT_EQ_STR("6 one\n6 one\n4 N two\n", written);
+  EXPECT_EQ_INT(3, flushes);
+  log_queue_destroy(q);
+
+  return 0;
+}
+
+DEF_TEST(coalesce) {
+  log_queue_t *q;
+  reset();
+
+  CHECK_NOT_NULL(q = log_queue_create(4, TIME_T_TO_CDTIME_T(10), write_cb,
+                                      NULL, NULL));
+  log_queue_push(q, LOG_INFO, T(0), "one");
+  log_queue_push(q, LOG_INFO, T(1), "one");
+  log_queue_push(q, LOG_INFO, T(2), "one");
+  /* Another severity is another message. */
+  log_queue_push(q, LOG_ERR, T(3), "one");
+  EXPECT_EQ_STR("6 one\n6 last message repeated 2 times\n3 one\n", written);
+  reset();
+
+  /* Repeats are reported at the end of the interval, which doubles. */
+  for (int i = 1; i <= 40; i++)
+    log_queue_push(q, LOG_ERR, T(3 + i), "one");
+  EXPECT_EQ_STR("3 last message repeated 10 times\n"
+                "3 last message repeated 20 times\n",
+                written);
+  reset();
+
+  /* The final count is reported when the queue is stopped. */
+  log_queue_destroy(q);
+  EXPECT_EQ_STR("3 last message repeated 10 times\n", written);
+
+  return 0;
+}
+
+DEF_TEST(asynchronous) {
+  log_queue_t *q;
+  reset();
+
+  CHECK_NOT_NULL(q = log_queue_create(4, 0, write_cb, flush_cb, NULL));
+  CHECK_ZERO(log_queue_start(q));
+
+  /* While the writer is blocked, the queue fills up and messages are
+   * dropped. */
+  pthread_mutex_lock(&write_lock);
+  char msg[16];
+  for (int i = 0; i < 10; i++) {
+    snprintf(msg, sizeof(msg), "msg%d", i);
+    log_queue_push(q, LOG_INFO, T(0), msg);
+  }
+  pthread_mutex_unlock(&write_lock);
+
+  log_queue_stop(q);
+  /* Entries are only released once they have been written. */
+  EXPECT_EQ_STR("6 msg0\n6 msg1\n6 msg2\n6 msg3\n", written);
+
+  /* Messages after stopping are written right away, and the dropped ones are
+   * reported once the queue is running again. */
+  reset();
+  log_queue_push(q, LOG_INFO, T(0), "sync");
+  EXPECT_EQ_STR("6 sync\n", written);
+
+  reset();
+  CHECK_ZERO(log_queue_start(q));
+  log_queue_push(q, LOG_INFO, T(0), "async");
+  log_queue_stop(q);
+  EXPECT_EQ_STR("4 log queue full, dropped 6 messages\n6 async\n", written);
+
+  log_queue_destroy(q);
+  return 0;
+}
+
+DEF_TEST(file) {
+  char dir[] = "/tmp/collectd_log_queue_test.XXXXXX";
+  CHECK_NOT_NULL(mkdtemp(dir));
+
+  char path[PATH_MAX];
+  char rotated[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/log", dir);
+  snprintf(rotated, sizeof(rotated), "%s/log.1", dir);
+
+  log_file_t lf = LOG_FILE_INIT;
+  EXPECT_EQ_PTR(stderr, log_file_get(&lf, NULL));
+  EXPECT_EQ_PTR(stdout, log_file_get(&lf, "stdout"));
+
+  FILE *fh;
+  CHECK_NOT_NULL(fh = log_file_get(&lf, path));
+  EXPECT_EQ_PTR(fh, log_file_get(&lf, path));
+
+  /* After rotation, the new file is opened. This is checked at most once a
+   * second. */
+  CHECK_ZERO(rename(path, rotated));
+  EXPECT_EQ_PTR(fh, log_file_get(&lf, path));
+  cdtime_mock += TIME_T_TO_CDTIME_T(1);
+  CHECK_NOT_NULL(log_file_get(&lf, path));
+  struct stat st;
+  CHECK_ZERO(stat(path, &st));
+  EXPECT_EQ_UINT64((uint64_t)st.st_ino, (uint64_t)lf.ino);
+
+  log_file_close(&lf);
+  unlink(path);
+  unlink(rotated);
+  rmdir(dir);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(synchronous);
+  RUN_TEST(coalesce);
+  RUN_TEST(asynchronous);
+  RUN_TEST(file);
+
+  END_TEST;
+}
@@ -51,6 +51,13 @@ kstat_ctl_t *kc;
   } while (0)
 #endif
 
+/* Upper bound for the number of identifiers cached per type. When it is
+ * reached, the cache is cleared and filled again. */
+#define LU_CACHE_MAX 65536
+#define LU_CACHE_MIN_SLOTS 64
+/* Number of matches lookup_search() can handle without allocating memory. */
+#define LU_MATCHES_STATIC 16
+
 /*
  * Types
  */
@@ -105,9 +112,37 @@ struct user_class_list_s {
   user_class_list_t *next;
 };
 
+/* A class an identifier matches, and the identifier's user object within that
+ * class. */
+struct lu_match_s {
+  user_class_t *user_class;
+  user_obj_t *user_obj;
+};
+typedef struct lu_match_s lu_match_t;
+
+struct lu_cache_entry_s {
+  uint64_t hash;
+  char *key; /* see lu_cache_key() */
+  size_t key_len;
+
+  lu_match_t *matches;
+  size_t matches_num;
+};
+typedef struct lu_cache_entry_s lu_cache_entry_t;
+
 struct by_type_entry_s {
   c_avl_tree_t *by_plugin_tree; /* plugin -> user_class_list_t */
   user_class_list_t *wildcard_plugin_list;
+
+  /* Maps identifiers to the classes they match, including identifiers that
+   * don't match any class. The regular expressions and user object lists are
+   * only consulted the first time an identifier is seen, so the cost per value
+   * doesn't grow with the number of classes. Open addressing with linear
+   * probing; entries are never removed individually. */
+  pthread_rwlock_t cache_lock;
+  lu_cache_entry_t **cache;
+  size_t cache_size; /* zero or a power of two */
+  size_t cache_num;
 };
 typedef struct by_type_entry_s by_type_entry_t;
 
@@ -269,11 +304,14 @@ static user_obj_t *lu_find_user_obj(user_class_t *user_class, /* {{{ */
   return NULL;
 } /* }}} user_obj_t *lu_find_user_obj */
 
-static int lu_handle_user_class(lookup_t *obj, /* {{{ */
-                                data_set_t const *ds, value_list_t const *vl,
-                                user_class_t *user_class) {
+/* Checks whether "vl" belongs to "user_class" and looks up, or creates, its
+ * user object. Returns zero and sets "ret_user_obj" if it does, greater than
+ * zero if it doesn't, and less than zero on error. */
+static int lu_match_user_class(lookup_t *obj, /* {{{ */
+                               data_set_t const *ds, value_list_t const *vl,
+                               user_class_t *user_class,
+                               user_obj_t **ret_user_obj) {
   user_obj_t *user_obj;
-  int status;
 
   assert(strcmp(vl->type, user_class->match.type.str) == 0);
   assert(user_class->match.plugin.is_regex ||
@@ -299,39 +337,218 @@ static int lu_handle_user_class(lookup_t *obj, /* {{{ */
   }
   pthread_mutex_unlock(&user_class->lock);
 
-  status = obj->cb_user_obj(ds, vl, user_class->user_class, user_obj->user_obj);
-  if (status != 0) {
-    ERROR("utils_vl_lookup: The user object callback failed with status %i.",
-          status);
-    /* Returning a negative value means: abort! */
+  *ret_user_obj = user_obj;
+  return 0;
+} /* }}} int lu_match_user_class */
+
+/* Appends the classes of "user_class_list" that "vl" belongs to to
+ * "entry->matches". */
+static int lu_match_user_class_list(lookup_t *obj, /* {{{ */
+                                    data_set_t const *ds,
+                                    value_list_t const *vl,
+                                    user_class_list_t *user_class_list,
+                                    lu_cache_entry_t *entry) {
+  for (user_class_list_t *ptr = user_class_list; ptr != NULL; ptr = ptr->next) {
+    user_obj_t *user_obj = NULL;
+
+    int status = lu_match_user_class(obj, ds, vl, &ptr->entry, &user_obj);
     if (status < 0)
       return status;
-    else
-      return 1;
+    else if (status > 0)
+      continue;
+
+    lu_match_t *tmp = realloc(entry->matches, (entry->matches_num + 1) *
+                                                  sizeof(*entry->matches));
+    if (tmp == NULL) {
+      ERROR("utils_vl_lookup: realloc failed.");
+      return -1;
+    }
+    entry->matches = tmp;
+    entry->matches[entry->matches_num] = (lu_match_t){
+        .user_class = &ptr->entry, .user_obj = user_obj,
+    };
+    entry->matches_num++;
   }
 
   return 0;
-} /* }}} int lu_handle_user_class */
+} /* }}} int lu_match_user_class_list */
+
+/* The cache key is the identifier without the type, which is implied by the
+ * by_type_entry_t. The fields are separated by null bytes. */
+static size_t lu_cache_key(value_list_t const *vl, /* {{{ */
+                           char buffer[static 4 * DATA_MAX_NAME_LEN]) {
+  char const *fields[] = {vl->host, vl->plugin, vl->plugin_instance,
+                          vl->type_instance};
+  size_t len = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    size_t field_len = strnlen(fields[i], DATA_MAX_NAME_LEN - 1);
+    memcpy(buffer + len, fields[i], field_len);
+    len += field_len;
+    buffer[len] = 0;
+    len++;
+  }
 
-static int lu_handle_user_class_list(lookup_t *obj, /* {{{ */
-                                     data_set_t const *ds,
-                                     value_list_t const *vl,
-                                     user_class_list_t *user_class_list) {
-  user_class_list_t *ptr;
-  int retval = 0;
+  return len;
+} /* }}} size_t lu_cache_key */
 
-  for (ptr = user_class_list; ptr != NULL; ptr = ptr->next) {
-    int status;
+/* FNV-1a */
+static uint64_t lu_cache_hash(char const *key, size_t key_len) /* {{{ */
+{
+  uint64_t hash = 14695981039346656037ULL;
 
-    status = lu_handle_user_class(obj, ds, vl, &ptr->entry);
-    if (status < 0)
-      return status;
-    else if (status == 0)
-      retval++;
+  for (size_t i = 0; i < key_len; i++) {
+    hash ^= (uint8_t)key[i];
+    hash *= 1099511628211ULL;
   }
 
-  return retval;
-} /* }}} int lu_handle_user_class_list */
+  return hash;
+} /* }}} uint64_t lu_cache_hash */
+
+static void lu_cache_entry_free(lu_cache_entry_t *entry) /* {{{ */
+{
+  if (entry == NULL)
+    return;
+
+  sfree(entry->key);
+  sfree(entry->matches);
+  sfree(entry);
+} /* }}} void lu_cache_entry_free */
+
+/* by_type->cache_lock must be held for writing. */
+static void lu_cache_clear(by_type_entry_t *by_type) /* {{{ */
+{
+  for (size_t i = 0; i < by_type->cache_size; i++) {
+    lu_cache_entry_free(by_type->cache[i]);
+    by_type->cache[i] = NULL;
+  }
+  by_type->cache_num = 0;
+} /* }}} void lu_cache_clear */
+
+/* by_type->cache_lock must be held. */
+static lu_cache_entry_t *lu_cache_get(by_type_entry_t *by_type, /* {{{ */
+                                      char const *key, size_t key_len,
+                                      uint64_t hash) {
+  if (by_type->cache_size == 0)
+    return NULL;
+
+  size_t mask = by_type->cache_size - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    lu_cache_entry_t *entry = by_type->cache[i];
+
+    if (entry == NULL)
+      return NULL;
+    if ((entry->hash == hash) && (entry->key_len == key_len) &&
+        (memcmp(entry->key, key, key_len) == 0))
+      return entry;
+  }
+} /* }}} lu_cache_entry_t *lu_cache_get */
+
+static void lu_cache_place(lu_cache_entry_t **cache, /* {{{ */
+                           size_t cache_size, lu_cache_entry_t *entry) {
+  size_t mask = cache_size - 1;
+  size_t i = entry->hash & mask;
+
+  while (cache[i] != NULL)
+    i = (i + 1) & mask;
+
+  cache[i] = entry;
+} /* }}} void lu_cache_place */
+
+/* Adds "entry" to the cache, which takes ownership. If the key is already
+ * cached, e.g. because another thread added it first, "entry" is freed.
+ * by_type->cache_lock must be held for writing. */
+static void lu_cache_insert(by_type_entry_t *by_type, /* {{{ */
+                            lu_cache_entry_t *entry) {
+  if (lu_cache_get(by_type, entry->key, entry->key_len, entry->hash) != NULL) {
+    lu_cache_entry_free(entry);
+    return;
+  }
+
+  if (by_type->cache_num >= LU_CACHE_MAX)
+    lu_cache_clear(by_type);
+
+  /* Keep the load factor at or below 1/2. */
+  if (2 * (by_type->cache_num + 1) > by_type->cache_size) {
+    size_t cache_size = (by_type->cache_size == 0) ? LU_CACHE_MIN_SLOTS
+                                                   : 2 * by_type->cache_size;
+    lu_cache_entry_t **cache = calloc(cache_size, sizeof(*cache));
+    if (cache == NULL) {
+      ERROR("utils_vl_lookup: calloc failed.");
+      lu_cache_entry_free(entry);
+      return;
+    }
+
+    for (size_t i = 0; i < by_type->cache_size; i++)
+      if (by_type->cache[i] != NULL)
+        lu_cache_place(cache, cache_size, by_type->cache[i]);
+
+    sfree(by_type->cache);
+    by_type->cache = cache;
+    by_type->cache_size = cache_size;
+  }
+
+  lu_cache_place(by_type->cache, by_type->cache_size, entry);
+  by_type->cache_num++;
+} /* }}} void lu_cache_insert */
+
+/* Copies the matches of "entry" to "buffer", which must have room for
+ * LU_MATCHES_STATIC matches, or to newly allocated memory if there are more.
+ * Returns NULL if allocating memory fails. */
+static lu_match_t *lu_matches_copy(lu_cache_entry_t const *entry, /* {{{ */
+                                   lu_match_t *buffer, size_t *ret_num) {
+  lu_match_t *matches = buffer;
+
+  *ret_num = entry->matches_num;
+  if (entry->matches_num > LU_MATCHES_STATIC)
+    matches = calloc(entry->matches_num, sizeof(*matches));
+  if ((matches != NULL) && (entry->matches_num > 0))
+    memcpy(matches, entry->matches, entry->matches_num * sizeof(*matches));
+
+  return matches;
+} /* }}} lu_match_t *lu_matches_copy */
+
+/* Evaluates all classes of "by_type" for "vl" and returns the result as a new
+ * cache entry. */
+static lu_cache_entry_t *lu_cache_entry_create(/* {{{ */
+                                               lookup_t *obj,
+                                               data_set_t const *ds,
+                                               value_list_t const *vl,
+                                               by_type_entry_t *by_type,
+                                               char const *key, size_t key_len,
+                                               uint64_t hash) {
+  lu_cache_entry_t *entry = calloc(1, sizeof(*entry));
+  if (entry == NULL) {
+    ERROR("utils_vl_lookup: calloc failed.");
+    return NULL;
+  }
+  entry->hash = hash;
+  entry->key_len = key_len;
+  entry->key = malloc(key_len);
+  if (entry->key == NULL) {
+    ERROR("utils_vl_lookup: malloc failed.");
+    lu_cache_entry_free(entry);
+    return NULL;
+  }
+  memcpy(entry->key, key, key_len);
+
+  user_class_list_t *user_class_list = NULL;
+  if (c_avl_get(by_type->by_plugin_tree, vl->plugin,
+                (void *)&user_class_list) == 0) {
+    if (lu_match_user_class_list(obj, ds, vl, user_class_list, entry) != 0) {
+      lu_cache_entry_free(entry);
+      return NULL;
+    }
+  }
+
+  if (lu_match_user_class_list(obj, ds, vl, by_type->wildcard_plugin_list,
+                               entry) != 0) {
+    lu_cache_entry_free(entry);
+    return NULL;
+  }
+
+  return entry;
+} /* }}} lu_cache_entry_t *lu_cache_entry_create */
 
 static by_type_entry_t *lu_search_by_type(lookup_t *obj, /* {{{ */
                                           char const *type,
@@ -360,11 +577,13 @@ static by_type_entry_t *lu_search_by_type(lookup_t *obj, /* {{{ */
     return NULL;
   }
   by_type->wildcard_plugin_list = NULL;
+  pthread_rwlock_init(&by_type->cache_lock, /* attr = */ NULL);
 
   by_type->by_plugin_tree =
       c_avl_create((int (*)(const void *, const void *))strcmp);
   if (by_type->by_plugin_tree == NULL) {
     ERROR("utils_vl_lookup: c_avl_create failed.");
+    pthread_rwlock_destroy(&by_type->cache_lock);
     sfree(by_type);
     sfree(type_copy);
     return NULL;
@@ -376,6 +595,7 @@ static by_type_entry_t *lu_search_by_type(lookup_t *obj, /* {{{ */
   if (status != 0) {
     ERROR("utils_vl_lookup: c_avl_insert failed.");
     c_avl_destroy(by_type->by_plugin_tree);
+    pthread_rwlock_destroy(&by_type->cache_lock);
     sfree(by_type);
     sfree(type_copy);
     return NULL;
@@ -513,6 +733,10 @@ static void lu_destroy_by_type(lookup_t *obj, /* {{{ */
   lu_destroy_user_class_list(obj, by_type->wildcard_plugin_list);
   by_type->wildcard_plugin_list = NULL;
 
+  lu_cache_clear(by_type);
+  sfree(by_type->cache);
+  pthread_rwlock_destroy(&by_type->cache_lock);
+
   sfree(by_type);
 } /* }}} int lu_destroy_by_type */
 
@@ -591,16 +815,23 @@ int lookup_add(lookup_t *obj, /* {{{ */
   user_class_obj->entry.user_obj_list = NULL;
   user_class_obj->next = NULL;
 
-  return lu_add_by_plugin(by_type, user_class_obj);
+  int status = lu_add_by_plugin(by_type, user_class_obj);
+  if (status != 0)
+    return status;
+
+  /* Cached results don't know about the new class. */
+  pthread_rwlock_wrlock(&by_type->cache_lock);
+  lu_cache_clear(by_type);
+  pthread_rwlock_unlock(&by_type->cache_lock);
+
+  return 0;
 } /* }}} int lookup_add */
 
 /* returns the number of successful calls to the callback function */
 int lookup_search(lookup_t *obj, /* {{{ */
                   data_set_t const *ds, value_list_t const *vl) {
   by_type_entry_t *by_type = NULL;
-  user_class_list_t *user_class_list = NULL;
   int retval = 0;
-  int status;
 
   if ((obj == NULL) || (ds == NULL) || (vl == NULL))
     return -EINVAL;
@@ -609,22 +840,59 @@ int lookup_search(lookup_t *obj, /* {{{ */
   if (by_type == NULL)
     return 0;
 
-  status =
-      c_avl_get(by_type->by_plugin_tree, vl->plugin, (void *)&user_class_list);
-  if (status == 0) {
-    status = lu_handle_user_class_list(obj, ds, vl, user_class_list);
-    if (status < 0)
-      return status;
-    retval += status;
+  char key[4 * DATA_MAX_NAME_LEN];
+  size_t key_len = lu_cache_key(vl, key);
+  uint64_t hash = lu_cache_hash(key, key_len);
+
+  /* The matches are copied so that the callbacks are called without holding
+   * the cache lock. They stay valid until the lookup is destroyed. */
+  lu_match_t matches_static[LU_MATCHES_STATIC];
+  lu_match_t *matches = matches_static;
+  size_t matches_num = 0;
+
+  pthread_rwlock_rdlock(&by_type->cache_lock);
+  lu_cache_entry_t *entry = lu_cache_get(by_type, key, key_len, hash);
+  bool cached = (entry != NULL);
+  if (cached)
+    matches = lu_matches_copy(entry, matches_static, &matches_num);
+  pthread_rwlock_unlock(&by_type->cache_lock);
+
+  if (!cached) {
+    entry = lu_cache_entry_create(obj, ds, vl, by_type, key, key_len, hash);
+    if (entry == NULL)
+      return -1;
+
+    matches = lu_matches_copy(entry, matches_static, &matches_num);
+
+    pthread_rwlock_wrlock(&by_type->cache_lock);
+    lu_cache_insert(by_type, entry);
+    pthread_rwlock_unlock(&by_type->cache_lock);
   }
 
-  if (by_type->wildcard_plugin_list != NULL) {
-    status =
-        lu_handle_user_class_list(obj, ds, vl, by_type->wildcard_plugin_list);
-    if (status < 0)
-      return status;
-    retval += status;
+  if (matches == NULL) {
+    ERROR("utils_vl_lookup: calloc failed.");
+    return -ENOMEM;
   }
 
+  for (size_t i = 0; i < matches_num; i++) {
+    int status = obj->cb_user_obj(ds, vl, matches[i].user_class->user_class,
+                                  matches[i].user_obj->user_obj);
+    if (status != 0) {
+      ERROR("utils_vl_lookup: The user object callback failed with status %i.",
+            status);
+      /* Returning a negative value means: abort! */
+      if (status < 0) {
+        retval = status;
+        break;
+      }
+      continue;
+    }
+
+    retval++;
+  }
+
+  if (matches != matches_static)
+    sfree(matches);
+
   return retval;
 } /* }}} lookup_search */
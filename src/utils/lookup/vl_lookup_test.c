@@ -231,12 +231,49 @@ DEF_TEST(regex) {
   return 0;
 }
 
+DEF_TEST(many_classes) {
+  lookup_t *obj;
+  char ti[DATA_MAX_NAME_LEN];
+  CHECK_NOT_NULL(obj = lookup_create(lookup_class_callback, lookup_obj_callback,
+                                     (void *)free, (void *)free));
+
+  /* More classes than lookup_search() handles without allocating. */
+  for (int i = 0; i < 20; i++)
+    checked_lookup_add(obj, "/.*/", "/.*/", "", "test", "/.*/",
+                       LU_GROUP_BY_HOST);
+  checked_lookup_add(obj, "/.*/", "/^other$/", "", "test", "/.*/",
+                     LU_GROUP_BY_HOST);
+
+  for (int i = 0; i < 100; i++) {
+    bool expect_new = (i == 0);
+    snprintf(ti, sizeof(ti), "%d", i);
+    EXPECT_EQ_INT(20, checked_lookup_search(obj, "host0", "plugin0", "",
+                                            "test", ti, expect_new));
+  }
+
+  /* Cached results are repeated ... */
+  EXPECT_EQ_INT(20, checked_lookup_search(obj, "host0", "plugin0", "", "test",
+                                          "0", /* expect new = */ 0));
+  EXPECT_EQ_INT(21, checked_lookup_search(obj, "host0", "other", "", "test",
+                                          "0", /* expect new = */ 1));
+
+  /* ... until another class is added. */
+  checked_lookup_add(obj, "/.*/", "plugin0", "", "test", "/.*/",
+                     LU_GROUP_BY_HOST);
+  EXPECT_EQ_INT(21, checked_lookup_search(obj, "host0", "plugin0", "", "test",
+                                          "0", /* expect new = */ 1));
+
+  lookup_destroy(obj);
+  return 0;
+}
+
 int main(int argc, char **argv) /* {{{ */
 {
   RUN_TEST(group_by_specific_host);
   RUN_TEST(group_by_any_host);
   RUN_TEST(multiple_lookups);
   RUN_TEST(regex);
+  RUN_TEST(many_classes);
 
   END_TEST;
 } /* }}} int main */
@@ -36,10 +36,17 @@
 #define UTILS_MATCH_FLAGS_EXCLUDE_REGEX 0x02
 #define UTILS_MATCH_FLAGS_REGEX 0x04
 
+/* Longer required literals are cut, which keeps the prefilter small. */
+#define UTILS_MATCH_LITERAL_MAX 32
+
 struct cu_match_s {
   regex_t regex;
   regex_t excluderegex;
   int flags;
+  /* Number of (sub-)matches to ask regexec(3) for. */
+  size_t nmatch;
+  /* A string every line matched by "regex" contains, or NULL. */
+  char *literal;
 
   int (*callback)(const char *str, char *const *matches, size_t matches_num,
                   void *user_data);
@@ -47,30 +54,172 @@ struct cu_match_s {
   void (*free)(void *user_data);
 };
 
+/* Aho-Corasick automaton over the literals of a set of matches. */
+struct cu_match_prefilter_s {
+  /* Transitions, 256 per state. State zero is the root. */
+  uint32_t *next;
+  /* For each state, the matches whose literal ends there, directly or via
+   * the failure links. */
+  size_t **outputs;
+  size_t *outputs_num;
+  size_t states_num;
+
+  /* Matches without a literal, which are candidates for every string. */
+  size_t *always;
+  size_t always_num;
+  size_t matches_num;
+};
+
 /*
  * Private functions
  */
-static char *match_substr(const char *str, int begin, int end) {
-  char *ret;
-  size_t ret_len;
 
-  if ((begin < 0) || (end < 0) || (begin >= end))
-    return NULL;
-  if ((size_t)end > (strlen(str) + 1)) {
-    ERROR("utils_match: match_substr: `end' points after end of string.");
-    return NULL;
+/* match_skip_bracket returns the index after the bracket expression starting
+ * at regex[i]. */
+static size_t match_skip_bracket(const char *regex, size_t i) {
+  i++;
+  if (regex[i] == '^')
+    i++;
+  /* A leading ']' is part of the list. */
+  if (regex[i] == ']')
+    i++;
+
+  while ((regex[i] != 0) && (regex[i] != ']')) {
+    if ((regex[i] == '[') &&
+        ((regex[i + 1] == ':') || (regex[i + 1] == '.') ||
+         (regex[i + 1] == '='))) {
+      char delim = regex[i + 1];
+      i += 2;
+      while ((regex[i] != 0) && !((regex[i] == delim) && (regex[i + 1] == ']')))
+        i++;
+      if (regex[i] == 0)
+        return i;
+      i += 2;
+      continue;
+    }
+    i++;
+  }
+
+  return (regex[i] == 0) ? i : i + 1;
+} /* size_t match_skip_bracket */
+
+/* match_skip_group returns the index after the group starting at regex[i]. */
+static size_t match_skip_group(const char *regex, size_t i) {
+  int depth = 0;
+
+  while (regex[i] != 0) {
+    if (regex[i] == '\\') {
+      i++;
+      if (regex[i] != 0)
+        i++;
+      continue;
+    } else if (regex[i] == '[') {
+      i = match_skip_bracket(regex, i);
+      continue;
+    } else if (regex[i] == '(') {
+      depth++;
+    } else if (regex[i] == ')') {
+      depth--;
+      if (depth == 0)
+        return i + 1;
+    }
+    i++;
   }
 
-  ret_len = end - begin;
-  ret = malloc(ret_len + 1);
-  if (ret == NULL) {
-    ERROR("utils_match: match_substr: malloc failed.");
+  return i;
+} /* size_t match_skip_group */
+
+/* match_end_run ends a run of literal characters and keeps it in "best" if
+ * it is the longest one so far. */
+static void match_end_run(char const *run, size_t *run_len, char *best,
+                          size_t *best_len) {
+  if (*run_len > *best_len) {
+    *best_len = (*run_len < UTILS_MATCH_LITERAL_MAX) ? *run_len
+                                                     : UTILS_MATCH_LITERAL_MAX;
+    memcpy(best, run, *best_len);
+  }
+  *run_len = 0;
+} /* void match_end_run */
+
+/* match_literal returns the longest string that every string matched by the
+ * extended regular expression "regex" contains, or NULL if none is known. The
+ * analysis is conservative: it only looks at literal characters outside of
+ * groups and bracket expressions, and gives up on alternations. */
+static char *match_literal(const char *regex) {
+  size_t regex_len = strlen(regex);
+  char *run = malloc(regex_len + 1);
+  if (run == NULL)
     return NULL;
+
+  size_t run_len = 0;
+  size_t best_len = 0;
+  char best[UTILS_MATCH_LITERAL_MAX + 1];
+
+
+  size_t i = 0;
+  while (i < regex_len) {
+    char c = regex[i];
+
+    switch (c) {
+    case '|':
+      sfree(run);
+      return NULL;
+    case '(':
+      match_end_run(run, &run_len, best, &best_len);
+      i = match_skip_group(regex, i);
+      break;
+    case '[':
+      match_end_run(run, &run_len, best, &best_len);
+      i = match_skip_bracket(regex, i);
+      break;
+    case '*':
+    case '?':
+    case '{':
+      /* The preceding character is optional. */
+      if (run_len > 0)
+        run_len--;
+      match_end_run(run, &run_len, best, &best_len);
+      if (c == '{') {
+        while ((i < regex_len) && (regex[i] != '}'))
+          i++;
+      }
+      i++;
+      break;
+    case '+':
+      match_end_run(run, &run_len, best, &best_len);
+      i++;
+      break;
+    case '\\':
+      if ((regex[i + 1] != 0) &&
+          (strchr(".[]()*+?{}|^$\\/", regex[i + 1]) != NULL)) {
+        run[run_len++] = regex[i + 1];
+      } else {
+        /* Back-references and GNU extensions such as \w. */
+        match_end_run(run, &run_len, best, &best_len);
+      }
+      i += (regex[i + 1] != 0) ? 2 : 1;
+      break;
+    case '.':
+    case '^':
+    case '$':
+    case ')':
+      match_end_run(run, &run_len, best, &best_len);
+      i++;
+      break;
+    default:
+      run[run_len++] = c;
+      i++;
+    }
   }
+  match_end_run(run, &run_len, best, &best_len);
 
-  sstrncpy(ret, str + begin, ret_len + 1);
-  return ret;
-} /* char *match_substr */
+  sfree(run);
+  if (best_len == 0)
+    return NULL;
+
+  best[best_len] = 0;
+  return strdup(best);
+} /* char *match_literal */
 
 static int default_callback(const char __attribute__((unused)) * str,
                             char *const *matches, size_t matches_num,
@@ -237,11 +386,19 @@ match_create_callback(const char *regex, const char *excluderegex,
   }
   obj->flags |= UTILS_MATCH_FLAGS_REGEX;
 
+  /* Asking for fewer sub-matches lets regexec(3) do less work. */
+  obj->nmatch = obj->regex.re_nsub + 1;
+  if (obj->nmatch > 32)
+    obj->nmatch = 32;
+  obj->literal = match_literal(regex);
+
   if (excluderegex && strcmp(excluderegex, "") != 0) {
     status = regcomp(&obj->excluderegex, excluderegex, REG_EXTENDED);
     if (status != 0) {
       ERROR("Compiling the excluding regular expression \"%s\" failed.",
             excluderegex);
+      regfree(&obj->regex);
+      sfree(obj->literal);
       sfree(obj);
       return NULL;
     }
@@ -310,6 +467,7 @@ void match_destroy(cu_match_t *obj) {
   if ((obj->user_data != NULL) && (obj->free != NULL))
     (*obj->free)(obj->user_data);
 
+  sfree(obj->literal);
   sfree(obj);
 } /* void match_destroy */
 
@@ -322,10 +480,13 @@ int match_apply(cu_match_t *obj, const char *str) {
   if ((obj == NULL) || (str == NULL))
     return -1;
 
+  /* Without the literal, the regex cannot match. */
+  if ((obj->literal != NULL) && (strstr(str, obj->literal) == NULL))
+    return 0;
+
   if (obj->flags & UTILS_MATCH_FLAGS_EXCLUDE_REGEX) {
-    status =
-        regexec(&obj->excluderegex, str, STATIC_ARRAY_SIZE(re_match), re_match,
-                /* eflags = */ 0);
+    status = regexec(&obj->excluderegex, str, /* nmatch = */ 0,
+                     /* pmatch = */ NULL, /* eflags = */ 0);
     /* Regex did match, so exclude this line */
     if (status == 0) {
       DEBUG("ExludeRegex matched, don't count that line\n");
@@ -333,39 +494,51 @@ int match_apply(cu_match_t *obj, const char *str) {
     }
   }
 
-  status = regexec(&obj->regex, str, STATIC_ARRAY_SIZE(re_match), re_match,
+  status = regexec(&obj->regex, str, obj->nmatch, re_match,
                    /* eflags = */ 0);
 
   /* Regex did not match */
   if (status != 0)
     return 0;
 
-  for (matches_num = 0; matches_num < STATIC_ARRAY_SIZE(matches);
-       matches_num++) {
-    if ((re_match[matches_num].rm_so < 0) || (re_match[matches_num].rm_eo < 0))
+  /* Copy all (sub-)matches into one buffer, which is only allocated if the
+   * matches are unusually long. */
+  size_t size = 0;
+  for (matches_num = 0; matches_num < obj->nmatch; matches_num++) {
+    if ((re_match[matches_num].rm_so < 0) ||
+        (re_match[matches_num].rm_eo < re_match[matches_num].rm_so))
       break;
-
-    matches[matches_num] = match_substr(str, re_match[matches_num].rm_so,
-                                        re_match[matches_num].rm_eo);
-    if (matches[matches_num] == NULL) {
-      status = -1;
-      break;
-    }
+    size += (size_t)(re_match[matches_num].rm_eo - re_match[matches_num].rm_so);
+    size++;
   }
 
-  if (status != 0) {
-    ERROR("utils_match: match_apply: match_substr failed.");
-  } else {
-    status = obj->callback(str, matches, matches_num, obj->user_data);
-    if (status != 0) {
-      ERROR("utils_match: match_apply: callback failed.");
+  char scratch[512];
+  char *buffer = scratch;
+  if (size > sizeof(scratch)) {
+    buffer = malloc(size);
+    if (buffer == NULL) {
+      ERROR("utils_match: match_apply: malloc failed.");
+      return -1;
     }
   }
 
+  char *ptr = buffer;
   for (size_t i = 0; i < matches_num; i++) {
-    sfree(matches[i]);
+    size_t len = (size_t)(re_match[i].rm_eo - re_match[i].rm_so);
+    memcpy(ptr, str + re_match[i].rm_so, len);
+    ptr[len] = 0;
+    matches[i] = ptr;
+    ptr += len + 1;
   }
 
+  status = obj->callback(str, matches, matches_num, obj->user_data);
+  if (status != 0) {
+    ERROR("utils_match: match_apply: callback failed.");
+  }
+
+  if (buffer != scratch)
+    sfree(buffer);
+
   return status;
 } /* int match_apply */
 
@@ -374,3 +547,142 @@ void *match_get_user_data(cu_match_t *obj) {
     return NULL;
   return obj->user_data;
 } /* void *match_get_user_data */
+
+void match_prefilter_destroy(cu_match_prefilter_t *pf) {
+  if (pf == NULL)
+    return;
+
+  for (size_t i = 0; i < pf->states_num; i++)
+    sfree(pf->outputs[i]);
+  sfree(pf->outputs);
+  sfree(pf->outputs_num);
+  sfree(pf->next);
+  sfree(pf->always);
+  sfree(pf);
+} /* void match_prefilter_destroy */
+
+static int match_prefilter_add_output(cu_match_prefilter_t *pf, size_t state,
+                                      size_t match) {
+  size_t *tmp = realloc(pf->outputs[state],
+                        (pf->outputs_num[state] + 1) * sizeof(*tmp));
+  if (tmp == NULL)
+    return ENOMEM;
+  pf->outputs[state] = tmp;
+  pf->outputs[state][pf->outputs_num[state]] = match;
+  pf->outputs_num[state]++;
+  return 0;
+} /* int match_prefilter_add_output */
+
+cu_match_prefilter_t *match_prefilter_create(cu_match_t *const *matches,
+                                             size_t matches_num) {
+  cu_match_prefilter_t *pf = calloc(1, sizeof(*pf));
+  if (pf == NULL)
+    return NULL;
+  pf->matches_num = matches_num;
+
+  /* The trie has at most one state per literal character, plus the root. */
+  size_t states_max = 1;
+  for (size_t i = 0; i < matches_num; i++)
+    if (matches[i]->literal != NULL)
+      states_max += strlen(matches[i]->literal);
+
+  pf->next = calloc(states_max * 256, sizeof(*pf->next));
+  pf->outputs = calloc(states_max, sizeof(*pf->outputs));
+  pf->outputs_num = calloc(states_max, sizeof(*pf->outputs_num));
+  pf->always = calloc(matches_num + 1, sizeof(*pf->always));
+  uint32_t *fail = calloc(states_max, sizeof(*fail));
+  uint32_t *queue = calloc(states_max, sizeof(*queue));
+  if ((pf->next == NULL) || (pf->outputs == NULL) ||
+      (pf->outputs_num == NULL) || (pf->always == NULL) || (fail == NULL) ||
+      (queue == NULL))
+    goto error;
+  pf->states_num = 1;
+
+  /* Build the trie. Zero means "no transition", since no edge leads back to
+   * the root. */
+  for (size_t i = 0; i < matches_num; i++) {
+    char const *literal = matches[i]->literal;
+    if (literal == NULL) {
+      pf->always[pf->always_num++] = i;
+      continue;
+    }
+
+    uint32_t state = 0;
+    for (size_t j = 0; literal[j] != 0; j++) {
+      unsigned char c = (unsigned char)literal[j];
+      if (pf->next[state * 256 + c] == 0)
+        pf->next[state * 256 + c] = (uint32_t)pf->states_num++;
+      state = pf->next[state * 256 + c];
+    }
+    if (match_prefilter_add_output(pf, state, i) != 0)
+      goto error;
+  }
+
+  /* Compute the failure links breadth-first and turn the trie into a
+   * complete transition table. */
+  size_t head = 0, tail = 0;
+  for (size_t c = 0; c < 256; c++) {
+    uint32_t s = pf->next[c];
+    if (s != 0) {
+      fail[s] = 0;
+      queue[tail++] = s;
+    }
+  }
+  while (head < tail) {
+    uint32_t state = queue[head++];
+
+    for (size_t i = 0; i < pf->outputs_num[fail[state]]; i++)
+      if (match_prefilter_add_output(pf, state,
+                                     pf->outputs[fail[state]][i]) != 0)
+        goto error;
+
+    for (size_t c = 0; c < 256; c++) {
+      uint32_t s = pf->next[state * 256 + c];
+      if (s == 0) {
+        pf->next[state * 256 + c] = pf->next[fail[state] * 256 + c];
+        continue;
+      }
+      fail[s] = pf->next[fail[state] * 256 + c];
+      queue[tail++] = s;
+    }
+  }
+
+  sfree(fail);
+  sfree(queue);
+  return pf;
+
+error:
+  ERROR("utils_match: match_prefilter_create: allocation failed.");
+  sfree(fail);
+  sfree(queue);
+  match_prefilter_destroy(pf);
+  return NULL;
+} /* cu_match_prefilter_t *match_prefilter_create */
+
+size_t match_prefilter_apply(cu_match_prefilter_t const *pf, const char *str,
+                             bool *candidates) {
+  if ((pf == NULL) || (str == NULL) || (candidates == NULL))
+    return 0;
+
+  memset(candidates, 0, pf->matches_num * sizeof(*candidates));
+  for (size_t i = 0; i < pf->always_num; i++)
+    candidates[pf->always[i]] = true;
+  size_t candidates_num = pf->always_num;
+
+  uint32_t state = 0;
+  for (unsigned char const *ptr = (unsigned char const *)str; *ptr != 0;
+       ptr++) {
+    state = pf->next[state * 256 + *ptr];
+    for (size_t i = 0; i < pf->outputs_num[state]; i++) {
+      size_t m = pf->outputs[state][i];
+      if (!candidates[m]) {
+        candidates[m] = true;
+        candidates_num++;
+      }
+    }
+    if (candidates_num == pf->matches_num)
+      break;
+  }
+
+  return candidates_num;
+} /* size_t match_prefilter_apply */
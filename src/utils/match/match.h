@@ -68,6 +68,9 @@
 struct cu_match_s;
 typedef struct cu_match_s cu_match_t;
 
+struct cu_match_prefilter_s;
+typedef struct cu_match_prefilter_s cu_match_prefilter_t;
+
 struct cu_match_value_s {
   int ds_type;
   value_t value;
@@ -176,4 +179,48 @@ int match_apply(cu_match_t *obj, const char *str);
  */
 void *match_get_user_data(cu_match_t *obj);
 
+/*
+ * NAME
+ *  match_prefilter_create
+ *
+ * DESCRIPTION
+ *  Creates a prefilter for a set of matches: For each regular expression, the
+ *  longest string every matching line must contain is determined when the
+ *  match is created. The prefilter searches for all of these strings in one
+ *  pass, using the Aho-Corasick algorithm, so that only lines which may match
+ *  are handed to regexec(3). Matches whose regular expressions do not require
+ *  a literal string, e.g. because of alternations, are always candidates.
+ *
+ *  The matches must not be destroyed before the prefilter.
+ *
+ * RETURN VALUE
+ *  A cu_match_prefilter_t-pointer upon success or NULL upon failure.
+ */
+cu_match_prefilter_t *match_prefilter_create(cu_match_t *const *matches,
+                                             size_t matches_num);
+
+/*
+ * NAME
+ *  match_prefilter_destroy
+ *
+ * DESCRIPTION
+ *  Destroys the prefilter. Passing NULL is a no-op.
+ */
+void match_prefilter_destroy(cu_match_prefilter_t *pf);
+
+/*
+ * NAME
+ *  match_prefilter_apply
+ *
+ * DESCRIPTION
+ *  Sets `candidates[i]' to true if the i-th match passed to
+ *  `match_prefilter_create' may match `str' and to false if it cannot.
+ *  `candidates' must have room for as many elements as there are matches.
+ *
+ * RETURN VALUE
+ *  The number of candidates.
+ */
+size_t match_prefilter_apply(cu_match_prefilter_t const *pf, const char *str,
+                             bool *candidates);
+
 #endif /* UTILS_MATCH_H */
@@ -0,0 +1,138 @@
+/**
+ * collectd - src/utils/match/match_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/match/match.h"
+
+static int last_matches_num;
+static char last_matches[4][64];
+
+static int test_callback(const char *str, char *const *matches,
+                         size_t matches_num, void *user_data) {
+  last_matches_num = (int)matches_num;
+  for (size_t i = 0; (i < matches_num) && (i < STATIC_ARRAY_SIZE(last_matches));
+       i++)
+    sstrncpy(last_matches[i], matches[i], sizeof(last_matches[i]));
+  return 0;
+}
+
+static int apply(cu_match_t *m, char const *str) {
+  last_matches_num = 0;
+  CHECK_ZERO(match_apply(m, str));
+  return last_matches_num;
+}
+
+DEF_TEST(apply) {
+  cu_match_t *m;
+  CHECK_NOT_NULL(m = match_create_callback("GET ([^ ]+) took ([0-9]+)ms", NULL,
+                                           test_callback, NULL, NULL));
+
+  EXPECT_EQ_INT(3, apply(m, "GET /index.html took 42ms"));
+  EXPECT_EQ_STR("GET /index.html took 42ms", last_matches[0]);
+  EXPECT_EQ_STR("/index.html", last_matches[1]);
+  EXPECT_EQ_STR("42", last_matches[2]);
+
+  EXPECT_EQ_INT(0, apply(m, "POST /index.html took 42ms"));
+  EXPECT_EQ_INT(0, apply(m, "GET /index.html took ms"));
+
+  /* Captures longer than the internal scratch buffer. */
+  char line[2048] = "GET /";
+  memset(line + 5, 'a', 1500);
+  strcpy(line + 1505, " took 7ms");
+  EXPECT_EQ_INT(3, apply(m, line));
+  EXPECT_EQ_STR("7", last_matches[2]);
+
+  match_destroy(m);
+
+  CHECK_NOT_NULL(m = match_create_callback("error", "ignored", test_callback,
+                                           NULL, NULL));
+  EXPECT_EQ_INT(1, apply(m, "an error occurred"));
+  EXPECT_EQ_INT(0, apply(m, "an ignored error occurred"));
+  match_destroy(m);
+
+  return 0;
+}
+
+DEF_TEST(prefilter) {
+  struct {
+    char const *regex;
+    char const *str;
+    bool want;
+  } cases[] = {
+      {"foo", "xfoox", true},
+      {"foo", "xfox", false},
+      /* "b" is optional, so the literal is "a" or "c". */
+      {"ab?c", "ac", true},
+      {"ab*c", "ac", true},
+      {"ab{0,2}c", "ac", true},
+      {"ab+c", "abbbc", true},
+      {"ab+c", "xyz", false},
+      {"a\\.b", "a.b", true},
+      {"a\\.b", "axb", false},
+      /* Alternations are always candidates. */
+      {"foo|bar", "baz", true},
+      {"(foo|bar)baz", "barbaz", true},
+      {"(foo|bar)baz", "foobar", false},
+      {"[a-z]+ level=(warn|error) code=[0-9]+", "x level=error code=1", true},
+      {"[a-z]+ level=(warn|error) code=[0-9]+", "x code=1", false},
+      {"^.*$", "", true},
+      {"x[]]y", "x]y", true},
+      {"x[]]y", "-", false},
+  };
+
+  cu_match_t *matches[STATIC_ARRAY_SIZE(cases)];
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    CHECK_NOT_NULL(matches[i] = match_create_callback(
+                       cases[i].regex, NULL, test_callback, NULL, NULL));
+
+  cu_match_prefilter_t *pf;
+  CHECK_NOT_NULL(
+      pf = match_prefilter_create(matches, STATIC_ARRAY_SIZE(cases)));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    bool candidates[STATIC_ARRAY_SIZE(cases)];
+    match_prefilter_apply(pf, cases[i].str, candidates);
+    printf("regex \"%s\", string \"%s\"\n", cases[i].regex, cases[i].str);
+    EXPECT_EQ_INT(cases[i].want, candidates[i]);
+
+    /* A string the regex matches must never be filtered out. */
+    if (apply(matches[i], cases[i].str) > 0)
+      OK(candidates[i]);
+  }
+
+  match_prefilter_destroy(pf);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    match_destroy(matches[i]);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(apply);
+  RUN_TEST(prefilter);
+
+  END_TEST;
+}
@@ -0,0 +1,234 @@
+/**
+ * collectd - src/utils/match_cache/match_cache.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/match_cache/match_cache.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of entries a key may be stored in. */
+#define MATCH_CACHE_WAYS 4
+
+struct c_match_cache_entry_s {
+  uint64_t hash;
+  /* The key, a null byte and the value are stored in one allocation. */
+  char *key;
+  size_t key_len;
+  size_t value_len;
+  int result;
+  /* Value of `clock' when the entry has been used last; zero if unused. */
+  uint64_t used;
+};
+typedef struct c_match_cache_entry_s c_match_cache_entry_t;
+
+struct c_match_cache_s {
+  pthread_mutex_t lock;
+  c_match_cache_entry_t *entries;
+  size_t sets_num;
+  uint64_t clock;
+};
+
+/* FNV-1a */
+static uint64_t match_cache_hash(void const *key, size_t key_len) /* {{{ */
+{
+  uint8_t const *ptr = key;
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < key_len; i++) {
+    hash ^= ptr[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* }}} uint64_t match_cache_hash */
+
+/* Must hold `mc->lock'. */
+static c_match_cache_entry_t *match_cache_set(c_match_cache_t *mc, /* {{{ */
+                                              uint64_t hash) {
+  return mc->entries + (size_t)(hash % mc->sets_num) * MATCH_CACHE_WAYS;
+} /* }}} c_match_cache_entry_t *match_cache_set */
+
+c_match_cache_t *c_match_cache_create(size_t size) /* {{{ */
+{
+  c_match_cache_t *mc;
+
+  if (size == 0)
+    return NULL;
+
+  mc = calloc(1, sizeof(*mc));
+  if (mc == NULL)
+    return NULL;
+
+  mc->sets_num = (size + MATCH_CACHE_WAYS - 1) / MATCH_CACHE_WAYS;
+  mc->entries = calloc(mc->sets_num * MATCH_CACHE_WAYS, sizeof(*mc->entries));
+  if (mc->entries == NULL) {
+    free(mc);
+    return NULL;
+  }
+  pthread_mutex_init(&mc->lock, /* attr = */ NULL);
+
+  return mc;
+} /* }}} c_match_cache_t *c_match_cache_create */
+
+void c_match_cache_destroy(c_match_cache_t *mc) /* {{{ */
+{
+  if (mc == NULL)
+    return;
+
+  c_match_cache_clear(mc);
+  pthread_mutex_destroy(&mc->lock);
+  free(mc->entries);
+  free(mc);
+} /* }}} void c_match_cache_destroy */
+
+/* Must hold `mc->lock'. */
+static c_match_cache_entry_t *match_cache_find(c_match_cache_t *mc, /* {{{ */
+                                               uint64_t hash, void const *key,
+                                               size_t key_len) {
+  c_match_cache_entry_t *set = match_cache_set(mc, hash);
+  for (size_t i = 0; i < MATCH_CACHE_WAYS; i++) {
+    c_match_cache_entry_t *e = set + i;
+
+    if ((e->used != 0) && (e->hash == hash) && (e->key_len == key_len) &&
+        (memcmp(e->key, key, key_len) == 0))
+      return e;
+  }
+
+  return NULL;
+} /* }}} c_match_cache_entry_t *match_cache_find */
+
+int c_match_cache_get(c_match_cache_t *mc, void const *key, /* {{{ */
+                      size_t key_len, int *ret_result) {
+  if ((mc == NULL) || (key == NULL) || (ret_result == NULL))
+    return EINVAL;
+
+  uint64_t hash = match_cache_hash(key, key_len);
+  int status = ENOENT;
+
+  pthread_mutex_lock(&mc->lock);
+  c_match_cache_entry_t *e = match_cache_find(mc, hash, key, key_len);
+  if (e != NULL) {
+    e->used = ++mc->clock;
+    *ret_result = e->result;
+    status = 0;
+  }
+  pthread_mutex_unlock(&mc->lock);
+
+  return status;
+} /* }}} int c_match_cache_get */
+
+int c_match_cache_get_value(c_match_cache_t *mc, void const *key, /* {{{ */
+                            size_t key_len, void *ret_value,
+                            size_t *ret_value_len) {
+  if ((mc == NULL) || (key == NULL) || (ret_value == NULL) ||
+      (ret_value_len == NULL))
+    return EINVAL;
+
+  uint64_t hash = match_cache_hash(key, key_len);
+  int status = ENOENT;
+
+  pthread_mutex_lock(&mc->lock);
+  c_match_cache_entry_t *e = match_cache_find(mc, hash, key, key_len);
+  if ((e != NULL) && (e->value_len > *ret_value_len)) {
+    status = ENOSPC;
+  } else if (e != NULL) {
+    e->used = ++mc->clock;
+    memcpy(ret_value, e->key + e->key_len + 1, e->value_len);
+    *ret_value_len = e->value_len;
+    status = 0;
+  }
+  pthread_mutex_unlock(&mc->lock);
+
+  return status;
+} /* }}} int c_match_cache_get_value */
+
+static void match_cache_put(c_match_cache_t *mc, void const *key, /* {{{ */
+                            size_t key_len, int result, void const *value,
+                            size_t value_len) {
+  if ((mc == NULL) || (key == NULL))
+    return;
+
+  uint64_t hash = match_cache_hash(key, key_len);
+
+  /* Copy the key outside of the lock. */
+  char *copy = malloc(key_len + 1 + value_len);
+  if (copy == NULL)
+    return;
+  memcpy(copy, key, key_len);
+  copy[key_len] = 0;
+  if (value_len > 0)
+    memcpy(copy + key_len + 1, value, value_len);
+
+  pthread_mutex_lock(&mc->lock);
+  /* Another thread may have stored the key in the meantime. */
+  c_match_cache_entry_t *victim = match_cache_find(mc, hash, key, key_len);
+  if (victim == NULL) {
+    c_match_cache_entry_t *set = match_cache_set(mc, hash);
+    victim = set;
+    for (size_t i = 1; i < MATCH_CACHE_WAYS; i++)
+      if (set[i].used < victim->used)
+        victim = set + i;
+  }
+
+  char *old = victim->key;
+  victim->hash = hash;
+  victim->key = copy;
+  victim->key_len = key_len;
+  victim->value_len = value_len;
+  victim->result = result;
+  victim->used = ++mc->clock;
+  pthread_mutex_unlock(&mc->lock);
+
+  free(old);
+} /* }}} void match_cache_put */
+
+void c_match_cache_put(c_match_cache_t *mc, void const *key, /* {{{ */
+                       size_t key_len, int result) {
+  match_cache_put(mc, key, key_len, result, NULL, 0);
+} /* }}} void c_match_cache_put */
+
+void c_match_cache_put_value(c_match_cache_t *mc, void const *key, /* {{{ */
+                             size_t key_len, void const *value,
+                             size_t value_len) {
+  if ((value == NULL) && (value_len > 0))
+    return;
+  match_cache_put(mc, key, key_len, 0, value, value_len);
+} /* }}} void c_match_cache_put_value */
+
+void c_match_cache_clear(c_match_cache_t *mc) /* {{{ */
+{
+  if (mc == NULL)
+    return;
+
+  pthread_mutex_lock(&mc->lock);
+  for (size_t i = 0; i < mc->sets_num * MATCH_CACHE_WAYS; i++) {
+    free(mc->entries[i].key);
+    mc->entries[i] = (c_match_cache_entry_t){0};
+  }
+  mc->clock = 0;
+  pthread_mutex_unlock(&mc->lock);
+} /* }}} void c_match_cache_clear */
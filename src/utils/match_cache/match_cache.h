@@ -0,0 +1,136 @@
+/**
+ * collectd - src/utils/match_cache/match_cache.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_MATCH_CACHE_H
+#define UTILS_MATCH_CACHE_H 1
+
+#include <stddef.h>
+
+struct c_match_cache_s;
+typedef struct c_match_cache_s c_match_cache_t;
+
+/*
+ * NAME
+ *   c_match_cache_create
+ *
+ * DESCRIPTION
+ *   Allocates a cache mapping keys, for example the strings an ignorelist or a
+ *   regular expression has been matched against, to the result of that match.
+ *   The cache has a fixed number of entries; when it is full, the least
+ *   recently used entry among the few a key may be stored in is replaced.
+ *
+ *   The cache is thread-safe.
+ *
+ * PARAMETERS
+ *   `size'  Maximum number of entries. Rounded up to a multiple of four.
+ *
+ * RETURN VALUE
+ *   A c_match_cache_t-pointer upon success or NULL upon failure.
+ */
+c_match_cache_t *c_match_cache_create(size_t size);
+
+/*
+ * NAME
+ *   c_match_cache_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a cache and all its entries.
+ */
+void c_match_cache_destroy(c_match_cache_t *mc);
+
+/*
+ * NAME
+ *   c_match_cache_get
+ *
+ * DESCRIPTION
+ *   Looks up the result stored for `key'.
+ *
+ * PARAMETERS
+ *   `key'         The key, which may contain null bytes.
+ *   `key_len'     Length of `key' in bytes.
+ *   `ret_result'  Set to the stored result if the key has been found.
+ *
+ * RETURN VALUE
+ *   Zero if the key has been found, ENOENT if it has not.
+ */
+int c_match_cache_get(c_match_cache_t *mc, void const *key, size_t key_len,
+                      int *ret_result);
+
+/*
+ * NAME
+ *   c_match_cache_put
+ *
+ * DESCRIPTION
+ *   Stores `result' for `key', possibly evicting another entry. Failing to
+ *   store an entry is not an error, since it only means that the next lookup
+ *   misses.
+ */
+void c_match_cache_put(c_match_cache_t *mc, void const *key, size_t key_len,
+                       int result);
+
+/*
+ * NAME
+ *   c_match_cache_get_value
+ *
+ * DESCRIPTION
+ *   Looks up the value stored for `key' with `c_match_cache_put_value', for
+ *   example a string the key has been rewritten to.
+ *
+ * PARAMETERS
+ *   `key'            The key, which may contain null bytes.
+ *   `key_len'        Length of `key' in bytes.
+ *   `ret_value'      Buffer the value is copied to.
+ *   `ret_value_len'  Size of `ret_value' on input, length of the value on
+ *                    output.
+ *
+ * RETURN VALUE
+ *   Zero if the key has been found, ENOENT if it has not and ENOSPC if the
+ *   value doesn't fit into `ret_value'.
+ */
+int c_match_cache_get_value(c_match_cache_t *mc, void const *key,
+                            size_t key_len, void *ret_value,
+                            size_t *ret_value_len);
+
+/*
+ * NAME
+ *   c_match_cache_put_value
+ *
+ * DESCRIPTION
+ *   Like `c_match_cache_put', but stores a copy of `value_len' bytes at
+ *   `value' instead of an integer.
+ */
+void c_match_cache_put_value(c_match_cache_t *mc, void const *key,
+                             size_t key_len, void const *value,
+                             size_t value_len);
+
+/*
+ * NAME
+ *   c_match_cache_clear
+ *
+ * DESCRIPTION
+ *   Removes all entries. Has to be called whenever whatever the results
+ *   depend on, e.g. the configuration, changes.
+ */
+void c_match_cache_clear(c_match_cache_t *mc);
+
+#endif /* UTILS_MATCH_CACHE_H */
@@ -0,0 +1,148 @@
+/**
+ * collectd - src/utils/match_cache/match_cache_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/match_cache/match_cache.h"
+
+DEF_TEST(get_put) {
+  c_match_cache_t *mc;
+  int result = -1;
+
+  CHECK_NOT_NULL(mc = c_match_cache_create(16));
+
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "eth0", 4, &result));
+  c_match_cache_put(mc, "eth0", 4, 1);
+  c_match_cache_put(mc, "lo", 2, 0);
+
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "eth0", 4, &result));
+  EXPECT_EQ_INT(1, result);
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "lo", 2, &result));
+  EXPECT_EQ_INT(0, result);
+
+  /* Keys are compared by length, too. */
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "eth", 3, &result));
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "lo\0x", 4, &result));
+
+  /* Storing a key again replaces its result. */
+  c_match_cache_put(mc, "eth0", 4, 0);
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "eth0", 4, &result));
+  EXPECT_EQ_INT(0, result);
+
+  c_match_cache_clear(mc);
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "eth0", 4, &result));
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "lo", 2, &result));
+
+  c_match_cache_destroy(mc);
+  return 0;
+}
+
+DEF_TEST(bounded) {
+  c_match_cache_t *mc;
+  char key[32];
+  int result;
+  int found = 0;
+
+  /* A single set: the least recently used key is evicted. */
+  CHECK_NOT_NULL(mc = c_match_cache_create(4));
+
+  for (int i = 0; i < 4; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    c_match_cache_put(mc, key, strlen(key), i);
+  }
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "key0", 4, &result));
+  EXPECT_EQ_INT(0, result);
+
+  c_match_cache_put(mc, "key4", 4, 4);
+  EXPECT_EQ_INT(ENOENT, c_match_cache_get(mc, "key1", 4, &result));
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "key0", 4, &result));
+  EXPECT_EQ_INT(0, c_match_cache_get(mc, "key4", 4, &result));
+  EXPECT_EQ_INT(4, result);
+
+  c_match_cache_destroy(mc);
+
+  /* Never more entries than the size. */
+  CHECK_NOT_NULL(mc = c_match_cache_create(64));
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    c_match_cache_put(mc, key, strlen(key), i);
+  }
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    if (c_match_cache_get(mc, key, strlen(key), &result) == 0) {
+      EXPECT_EQ_INT(i, result);
+      found++;
+    }
+  }
+  OK(found > 0);
+  OK(found <= 64);
+
+  c_match_cache_destroy(mc);
+  return 0;
+}
+
+DEF_TEST(value) {
+  c_match_cache_t *mc;
+  char value[16];
+  size_t value_len;
+
+  CHECK_NOT_NULL(mc = c_match_cache_create(16));
+
+  value_len = sizeof(value);
+  EXPECT_EQ_INT(ENOENT,
+                c_match_cache_get_value(mc, "eth0", 4, value, &value_len));
+
+  c_match_cache_put_value(mc, "eth0", 4, "net\0eth0", 9);
+  value_len = sizeof(value);
+  EXPECT_EQ_INT(0, c_match_cache_get_value(mc, "eth0", 4, value, &value_len));
+  EXPECT_EQ_INT(9, (int)value_len);
+  OK(memcmp("net\0eth0", value, 9) == 0);
+
+  /* The buffer has to be large enough. */
+  value_len = 4;
+  EXPECT_EQ_INT(ENOSPC,
+                c_match_cache_get_value(mc, "eth0", 4, value, &value_len));
+
+  /* Empty values are values, too. */
+  c_match_cache_put_value(mc, "lo", 2, NULL, 0);
+  value_len = sizeof(value);
+  EXPECT_EQ_INT(0, c_match_cache_get_value(mc, "lo", 2, value, &value_len));
+  EXPECT_EQ_INT(0, (int)value_len);
+
+  c_match_cache_clear(mc);
+  value_len = sizeof(value);
+  EXPECT_EQ_INT(ENOENT,
+                c_match_cache_get_value(mc, "eth0", 4, value, &value_len));
+
+  c_match_cache_destroy(mc);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(get_put);
+  RUN_TEST(bounded);
+  RUN_TEST(value);
+
+  END_TEST;
+}
@@ -29,9 +29,17 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
+#include "utils/pool/pool.h"
 
 #define MD_MAX_NONSTRING_CHARS 128
 
+/* Number of entries a store is created with. Values received from the network
+ * usually carry fewer than ten entries. */
+#define MD_STORE_MIN 8
+
+/* Number of free objects each thread keeps in the pools. */
+#define MD_POOL_CACHE_MAX 1024
+
 /*
  * Data types
  */
@@ -48,19 +56,49 @@ struct meta_entry_s;
 typedef struct meta_entry_s meta_entry_t;
 struct meta_entry_s {
   char *key;
-  meta_value_t value;
+  uint32_t hash; /* md_hash (key) */
   int type;
-  meta_entry_t *next;
+  meta_value_t value;
+};
+
+/* The entries are shared between a meta_data_t and its clones. A store with
+ * more than one reference is never modified; it is copied by the first
+ * meta_data_t that needs to change it. */
+struct meta_store_s;
+typedef struct meta_store_s meta_store_t;
+struct meta_store_s {
+  pthread_mutex_t lock; /* protects `refs' */
+  size_t refs;
+
+  size_t entries_num;
+  size_t entries_size;
+  meta_entry_t entries[];
 };
 
 struct meta_data_s {
-  meta_entry_t *head;
+  meta_store_t *store; /* NULL if empty */
   pthread_mutex_t lock;
 };
 
+/* Meta data is cloned for every value list in the write queue, so handles and
+ * default sized stores are taken from per-thread pools. */
+static c_pool_t *md_pool;
+static c_pool_t *md_store_pool;
+static pthread_once_t md_pool_once = PTHREAD_ONCE_INIT;
+
 /*
  * Private functions
  */
+static void md_pool_init(void) /* {{{ */
+{
+  md_pool = c_pool_create(sizeof(meta_data_t), MD_POOL_CACHE_MAX);
+  md_store_pool = c_pool_create(
+      sizeof(meta_store_t) + MD_STORE_MIN * sizeof(meta_entry_t),
+      MD_POOL_CACHE_MAX);
+  if ((md_pool == NULL) || (md_store_pool == NULL))
+    ERROR("meta_data: c_pool_create failed.");
+} /* }}} void md_pool_init */
+
 static char *md_strdup(const char *orig) /* {{{ */
 {
   size_t sz;
@@ -79,205 +117,227 @@ static char *md_strdup(const char *orig) /* {{{ */
   return dest;
 } /* }}} char *md_strdup */
 
-static meta_entry_t *md_entry_alloc(const char *key) /* {{{ */
+/* FNV-1a. Keys are case insensitive, so is the hash. */
+static uint32_t md_hash(const char *key) /* {{{ */
 {
-  meta_entry_t *e;
+  uint32_t hash = 2166136261u;
 
-  e = calloc(1, sizeof(*e));
-  if (e == NULL) {
-    ERROR("md_entry_alloc: calloc failed.");
-    return NULL;
+  for (const char *c = key; *c != 0; c++) {
+    hash ^= (uint8_t)tolower((unsigned char)*c);
+    hash *= 16777619u;
   }
 
+  return hash;
+} /* }}} uint32_t md_hash */
+
+static int md_entry_init(meta_entry_t *e, const char *key) /* {{{ */
+{
+  memset(e, 0, sizeof(*e));
+
   e->key = md_strdup(key);
   if (e->key == NULL) {
-    free(e);
-    ERROR("md_entry_alloc: md_strdup failed.");
-    return NULL;
+    ERROR("md_entry_init: md_strdup failed.");
+    return -ENOMEM;
   }
+  e->hash = md_hash(key);
 
-  e->type = 0;
-  e->next = NULL;
+  return 0;
+} /* }}} int md_entry_init */
 
-  return e;
-} /* }}} meta_entry_t *md_entry_alloc */
+static void md_entry_free_contents(meta_entry_t *e) /* {{{ */
+{
+  free(e->key);
 
-/* XXX: The lock on md must be held while calling this function! */
-static meta_entry_t *md_entry_clone_contents(const meta_entry_t *orig) /* {{{ */
+  if (e->type == MD_TYPE_STRING)
+    free(e->value.mv_string);
+} /* }}} void md_entry_free_contents */
+
+static int md_entry_copy(meta_entry_t *dest, const meta_entry_t *src) /* {{{ */
 {
-  meta_entry_t *copy;
+  *dest = *src;
 
-  /* WARNINGS :
-   *  - we do not check that orig != NULL here. You should have done it before.
-   *  - we do not set copy->next. DO NOT FORGET TO SET copy->next IN YOUR
-   * FUNCTION
-   */
+  dest->key = md_strdup(src->key);
+  if (dest->key == NULL)
+    return -ENOMEM;
 
-  copy = md_entry_alloc(orig->key);
-  if (copy == NULL)
-    return NULL;
-  copy->type = orig->type;
-  if (copy->type == MD_TYPE_STRING)
-    copy->value.mv_string = strdup(orig->value.mv_string);
-  else
-    copy->value = orig->value;
+  if (src->type == MD_TYPE_STRING) {
+    dest->value.mv_string = md_strdup(src->value.mv_string);
+    if (dest->value.mv_string == NULL) {
+      free(dest->key);
+      return -ENOMEM;
+    }
+  }
 
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone_contents */
+  return 0;
+} /* }}} int md_entry_copy */
 
-static meta_entry_t *md_entry_clone(const meta_entry_t *orig) /* {{{ */
+static meta_store_t *md_store_alloc(size_t entries_size) /* {{{ */
 {
-  meta_entry_t *copy;
+  meta_store_t *s;
 
-  if (orig == NULL)
+  if (entries_size == MD_STORE_MIN) {
+    pthread_once(&md_pool_once, md_pool_init);
+    s = c_pool_alloc(md_store_pool);
+  } else {
+    s = malloc(sizeof(*s) + entries_size * sizeof(s->entries[0]));
+  }
+  if (s == NULL)
     return NULL;
 
-  copy = md_entry_clone_contents(orig);
+  pthread_mutex_init(&s->lock, /* attr = */ NULL);
+  s->refs = 1;
+  s->entries_num = 0;
+  s->entries_size = entries_size;
 
-  copy->next = md_entry_clone(orig->next);
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone */
+  return s;
+} /* }}} meta_store_t *md_store_alloc */
 
-static void md_entry_free(meta_entry_t *e) /* {{{ */
+static void md_store_free(meta_store_t *s) /* {{{ */
 {
-  if (e == NULL)
+  if (s == NULL)
     return;
 
-  free(e->key);
-
-  if (e->type == MD_TYPE_STRING)
-    free(e->value.mv_string);
+  for (size_t i = 0; i < s->entries_num; i++)
+    md_entry_free_contents(s->entries + i);
 
-  if (e->next != NULL)
-    md_entry_free(e->next);
-
-  free(e);
-} /* }}} void md_entry_free */
+  pthread_mutex_destroy(&s->lock);
+  if (s->entries_size == MD_STORE_MIN)
+    c_pool_free(md_store_pool, s);
+  else
+    free(s);
+} /* }}} void md_store_free */
 
-static int md_entry_insert(meta_data_t *md, meta_entry_t *e) /* {{{ */
+static meta_store_t *md_store_ref(meta_store_t *s) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
+  if (s == NULL)
+    return NULL;
 
-  if ((md == NULL) || (e == NULL))
-    return -EINVAL;
+  pthread_mutex_lock(&s->lock);
+  s->refs++;
+  pthread_mutex_unlock(&s->lock);
 
-  pthread_mutex_lock(&md->lock);
+  return s;
+} /* }}} meta_store_t *md_store_ref */
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
+static void md_store_unref(meta_store_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
 
-    prev = this;
-    this = this->next;
-  }
+  pthread_mutex_lock(&s->lock);
+  size_t refs = --s->refs;
+  pthread_mutex_unlock(&s->lock);
 
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
-    }
+  if (refs == 0)
+    md_store_free(s);
+} /* }}} void md_store_unref */
 
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+/* Makes sure `md' is the only user of its store and the store has room for
+ * `need' more entries. The lock on md must be held. */
+static int md_store_writable(meta_data_t *md, size_t need) /* {{{ */
+{
+  meta_store_t *s = md->store;
 
-    e->next = this->next;
+  if (s == NULL) {
+    md->store = md_store_alloc(MD_STORE_MIN);
+    return (md->store == NULL) ? -ENOMEM : 0;
   }
 
-  pthread_mutex_unlock(&md->lock);
+  pthread_mutex_lock(&s->lock);
+  bool shared = (s->refs > 1);
+  pthread_mutex_unlock(&s->lock);
 
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
-  }
+  size_t size = s->entries_size;
+  while (s->entries_num + need > size)
+    size *= 2;
 
-  return 0;
-} /* }}} int md_entry_insert */
-
-/* XXX: The lock on md must be held while calling this function! */
-static int md_entry_insert_clone(meta_data_t *md, meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *e;
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  /* WARNINGS :
-   *  - we do not check that md and e != NULL here. You should have done it
-   * before.
-   *  - we do not use the lock. You should have set it before.
-   */
-
-  e = md_entry_clone_contents(orig);
-
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
-  }
-
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
-    }
+  if (!shared && (size == s->entries_size))
+    return 0;
 
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+  meta_store_t *copy = md_store_alloc(size);
+  if (copy == NULL)
+    return -ENOMEM;
 
-    e->next = this->next;
+  if (!shared) {
+    /* Only grow: move the entries over. */
+    memcpy(copy->entries, s->entries, s->entries_num * sizeof(s->entries[0]));
+    copy->entries_num = s->entries_num;
+    s->entries_num = 0;
+    md_store_free(s);
+    md->store = copy;
+    return 0;
   }
 
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
+  for (size_t i = 0; i < s->entries_num; i++) {
+    if (md_entry_copy(copy->entries + i, s->entries + i) != 0) {
+      md_store_free(copy);
+      return -ENOMEM;
+    }
+    copy->entries_num++;
   }
 
+  md_store_unref(s);
+  md->store = copy;
   return 0;
-} /* }}} int md_entry_insert_clone */
+} /* }}} int md_store_writable */
 
 /* XXX: The lock on md must be held while calling this function! */
 static meta_entry_t *md_entry_lookup(meta_data_t *md, /* {{{ */
                                      const char *key) {
-  meta_entry_t *e;
-
-  if ((md == NULL) || (key == NULL))
+  if ((md == NULL) || (md->store == NULL) || (key == NULL))
     return NULL;
 
-  for (e = md->head; e != NULL; e = e->next)
-    if (strcasecmp(key, e->key) == 0)
-      break;
+  meta_store_t *s = md->store;
+  uint32_t hash = md_hash(key);
 
-  return e;
+  for (size_t i = 0; i < s->entries_num; i++) {
+    meta_entry_t *e = s->entries + i;
+    if ((e->hash == hash) && (strcasecmp(key, e->key) == 0))
+      return e;
+  }
+
+  return NULL;
 } /* }}} meta_entry_t *md_entry_lookup */
 
+/* Inserts `e', replacing an existing entry with the same key. The contents of
+ * `e' are owned by `md' afterwards, even if the insert fails. */
+static int md_entry_insert(meta_data_t *md, meta_entry_t *e) /* {{{ */
+{
+  if ((md == NULL) || (e == NULL))
+    return -EINVAL;
+
+  pthread_mutex_lock(&md->lock);
+
+  int status = md_store_writable(md, 1);
+  if (status != 0) {
+    pthread_mutex_unlock(&md->lock);
+    md_entry_free_contents(e);
+    return status;
+  }
+
+  meta_entry_t *this = md_entry_lookup(md, e->key);
+  if (this != NULL) {
+    md_entry_free_contents(this);
+    *this = *e;
+  } else {
+    meta_store_t *s = md->store;
+    s->entries[s->entries_num] = *e;
+    s->entries_num++;
+  }
+
+  pthread_mutex_unlock(&md->lock);
+  return 0;
+} /* }}} int md_entry_insert */
+
 /*
  * Each value_list_t*, as it is going through the system, is handled by exactly
  * one thread. Plugins which pass a value_list_t* to another thread, e.g. the
  * rrdtool plugin, must create a copy first. The meta data within a
  * value_list_t* is not thread safe and doesn't need to be.
  *
+ * Copies are cheap: meta_data_clone only takes a reference to the entries of
+ * the original. The first of them to be modified gets its own copy.
+ *
  * The meta data associated with cache entries are a different story. There, we
  * need to ensure exclusive locking to prevent leaks and other funky business.
  * This is ensured by the uc_meta_data_get_*() functions.
@@ -290,11 +350,13 @@ meta_data_t *meta_data_create(void) /* {{{ */
 {
   meta_data_t *md;
 
-  md = calloc(1, sizeof(*md));
+  pthread_once(&md_pool_once, md_pool_init);
+  md = c_pool_alloc(md_pool);
   if (md == NULL) {
-    ERROR("meta_data_create: calloc failed.");
+    ERROR("meta_data_create: c_pool_alloc failed.");
     return NULL;
   }
+  memset(md, 0, sizeof(*md));
 
   pthread_mutex_init(&md->lock, /* attr = */ NULL);
 
@@ -313,7 +375,7 @@ meta_data_t *meta_data_clone(meta_data_t *orig) /* {{{ */
     return NULL;
 
   pthread_mutex_lock(&orig->lock);
-  copy->head = md_entry_clone(orig->head);
+  copy->store = md_store_ref(orig->store);
   pthread_mutex_unlock(&orig->lock);
 
   return copy;
@@ -329,12 +391,26 @@ int meta_data_clone_merge(meta_data_t **dest, meta_data_t *orig) /* {{{ */
     return 0;
   }
 
+  /* Holding a reference keeps the entries from being modified, so the lock on
+   * orig doesn't need to be held while inserting into dest. */
   pthread_mutex_lock(&orig->lock);
-  for (meta_entry_t *e = orig->head; e != NULL; e = e->next) {
-    md_entry_insert_clone((*dest), e);
-  }
+  meta_store_t *s = md_store_ref(orig->store);
   pthread_mutex_unlock(&orig->lock);
 
+  if (s == NULL)
+    return 0;
+
+  for (size_t i = 0; i < s->entries_num; i++) {
+    meta_entry_t e;
+
+    if (md_entry_copy(&e, s->entries + i) != 0) {
+      ERROR("meta_data_clone_merge: md_entry_copy failed.");
+      continue;
+    }
+    md_entry_insert(*dest, &e);
+  }
+
+  md_store_unref(s);
   return 0;
 } /* }}} int meta_data_clone_merge */
 
@@ -343,27 +419,35 @@ void meta_data_destroy(meta_data_t *md) /* {{{ */
   if (md == NULL)
     return;
 
-  md_entry_free(md->head);
+  md_store_unref(md->store);
   pthread_mutex_destroy(&md->lock);
-  free(md);
+  c_pool_free(md_pool, md);
 } /* }}} void meta_data_destroy */
 
+void meta_data_pool_stats(uint64_t *ret_hits, uint64_t *ret_misses) /* {{{ */
+{
+  uint64_t hits[2] = {0};
+  uint64_t misses[2] = {0};
+
+  c_pool_stats(md_pool, &hits[0], &misses[0]);
+  c_pool_stats(md_store_pool, &hits[1], &misses[1]);
+
+  if (ret_hits != NULL)
+    *ret_hits = hits[0] + hits[1];
+  if (ret_misses != NULL)
+    *ret_misses = misses[0] + misses[1];
+} /* }}} void meta_data_pool_stats */
+
 int meta_data_exists(meta_data_t *md, const char *key) /* {{{ */
 {
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
   pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return 1;
-    }
-  }
-
+  bool exists = (md_entry_lookup(md, key) != NULL);
   pthread_mutex_unlock(&md->lock);
-  return 0;
+
+  return exists ? 1 : 0;
 } /* }}} int meta_data_exists */
 
 int meta_data_type(meta_data_t *md, const char *key) /* {{{ */
@@ -372,29 +456,24 @@ int meta_data_type(meta_data_t *md, const char *key) /* {{{ */
     return -EINVAL;
 
   pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return e->type;
-    }
-  }
-
+  meta_entry_t *e = md_entry_lookup(md, key);
+  int type = (e != NULL) ? e->type : 0;
   pthread_mutex_unlock(&md->lock);
-  return 0;
+
+  return type;
 } /* }}} int meta_data_type */
 
 int meta_data_toc(meta_data_t *md, char ***toc) /* {{{ */
 {
-  int i = 0, count = 0;
+  int count = 0;
 
   if ((md == NULL) || (toc == NULL))
     return -EINVAL;
 
   pthread_mutex_lock(&md->lock);
 
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    ++count;
+  if (md->store != NULL)
+    count = (int)md->store->entries_num;
 
   if (count == 0) {
     pthread_mutex_unlock(&md->lock);
@@ -402,48 +481,60 @@ int meta_data_toc(meta_data_t *md, char ***toc) /* {{{ */
   }
 
   *toc = calloc(count, sizeof(**toc));
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    (*toc)[i++] = strdup(e->key);
+  for (int i = 0; i < count; i++)
+    (*toc)[i] = strdup(md->store->entries[i].key);
 
   pthread_mutex_unlock(&md->lock);
   return count;
 } /* }}} int meta_data_toc */
 
+int meta_data_foreach(meta_data_t *md, /* {{{ */
+                      meta_data_foreach_cb callback, void *user_data) {
+  int status = 0;
+
+  if ((md == NULL) || (callback == NULL))
+    return -EINVAL;
+
+  pthread_mutex_lock(&md->lock);
+
+  size_t entries_num = (md->store != NULL) ? md->store->entries_num : 0;
+  for (size_t i = 0; (i < entries_num) && (status == 0); i++) {
+    meta_entry_t *e = md->store->entries + i;
+    status = (*callback)(e->key, e->type, &e->value, user_data);
+  }
+
+  pthread_mutex_unlock(&md->lock);
+  return status;
+} /* }}} int meta_data_foreach */
+
 int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
   pthread_mutex_lock(&md->lock);
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
+  meta_entry_t *e = md_entry_lookup(md, key);
+  if (e == NULL) {
+    pthread_mutex_unlock(&md->lock);
+    return -ENOENT;
   }
 
-  if (this == NULL) {
+  /* The index is preserved if the store has to be copied. */
+  size_t index = (size_t)(e - md->store->entries);
+  int status = md_store_writable(md, 0);
+  if (status != 0) {
     pthread_mutex_unlock(&md->lock);
-    return -ENOENT;
+    return status;
   }
 
-  if (prev == NULL)
-    md->head = this->next;
-  else
-    prev->next = this->next;
+  meta_store_t *s = md->store;
+  md_entry_free_contents(s->entries + index);
+  memmove(s->entries + index, s->entries + index + 1,
+          (s->entries_num - index - 1) * sizeof(s->entries[0]));
+  s->entries_num--;
 
   pthread_mutex_unlock(&md->lock);
-
-  this->next = NULL;
-  md_entry_free(this);
-
   return 0;
 } /* }}} int meta_data_delete */
 
@@ -452,92 +543,87 @@ int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
  */
 int meta_data_add_string(meta_data_t *md, /* {{{ */
                          const char *key, const char *value) {
-  meta_entry_t *e;
+  meta_entry_t e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
+  if (md_entry_init(&e, key) != 0)
     return -ENOMEM;
 
-  e->value.mv_string = md_strdup(value);
-  if (e->value.mv_string == NULL) {
+  e.value.mv_string = md_strdup(value);
+  if (e.value.mv_string == NULL) {
     ERROR("meta_data_add_string: md_strdup failed.");
-    md_entry_free(e);
+    md_entry_free_contents(&e);
     return -ENOMEM;
   }
-  e->type = MD_TYPE_STRING;
+  e.type = MD_TYPE_STRING;
 
-  return md_entry_insert(md, e);
+  return md_entry_insert(md, &e);
 } /* }}} int meta_data_add_string */
 
 int meta_data_add_signed_int(meta_data_t *md, /* {{{ */
                              const char *key, int64_t value) {
-  meta_entry_t *e;
+  meta_entry_t e;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
+  if (md_entry_init(&e, key) != 0)
     return -ENOMEM;
 
-  e->value.mv_signed_int = value;
-  e->type = MD_TYPE_SIGNED_INT;
+  e.value.mv_signed_int = value;
+  e.type = MD_TYPE_SIGNED_INT;
 
-  return md_entry_insert(md, e);
+  return md_entry_insert(md, &e);
 } /* }}} int meta_data_add_signed_int */
 
 int meta_data_add_unsigned_int(meta_data_t *md, /* {{{ */
                                const char *key, uint64_t value) {
-  meta_entry_t *e;
+  meta_entry_t e;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
+  if (md_entry_init(&e, key) != 0)
     return -ENOMEM;
 
-  e->value.mv_unsigned_int = value;
-  e->type = MD_TYPE_UNSIGNED_INT;
+  e.value.mv_unsigned_int = value;
+  e.type = MD_TYPE_UNSIGNED_INT;
 
-  return md_entry_insert(md, e);
+  return md_entry_insert(md, &e);
 } /* }}} int meta_data_add_unsigned_int */
 
 int meta_data_add_double(meta_data_t *md, /* {{{ */
                          const char *key, double value) {
-  meta_entry_t *e;
+  meta_entry_t e;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
+  if (md_entry_init(&e, key) != 0)
     return -ENOMEM;
 
-  e->value.mv_double = value;
-  e->type = MD_TYPE_DOUBLE;
+  e.value.mv_double = value;
+  e.type = MD_TYPE_DOUBLE;
 
-  return md_entry_insert(md, e);
+  return md_entry_insert(md, &e);
 } /* }}} int meta_data_add_double */
 
 int meta_data_add_boolean(meta_data_t *md, /* {{{ */
                           const char *key, bool value) {
-  meta_entry_t *e;
+  meta_entry_t e;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
+  if (md_entry_init(&e, key) != 0)
     return -ENOMEM;
 
-  e->value.mv_boolean = value;
-  e->type = MD_TYPE_BOOLEAN;
+  e.value.mv_boolean = value;
+  e.type = MD_TYPE_BOOLEAN;
 
-  return md_entry_insert(md, e);
+  return md_entry_insert(md, &e);
 } /* }}} int meta_data_add_boolean */
 
 /*
@@ -46,9 +46,23 @@ meta_data_t *meta_data_clone(meta_data_t *orig);
 int meta_data_clone_merge(meta_data_t **dest, meta_data_t *orig);
 void meta_data_destroy(meta_data_t *md);
 
+/* Returns the hit and miss counters of the allocator pools used for meta
+ * data. */
+void meta_data_pool_stats(uint64_t *ret_hits, uint64_t *ret_misses);
+
 int meta_data_exists(meta_data_t *md, const char *key);
 int meta_data_type(meta_data_t *md, const char *key);
 int meta_data_toc(meta_data_t *md, char ***toc);
+
+/* Calls "callback" for each entry, in insertion order, without copying keys or
+ * values. Depending on "type", "value" points to a "char *", "int64_t",
+ * "uint64_t", "double" or "bool". The lock of "md" is held while iterating,
+ * so the callback must not use "md". Iteration stops when the callback
+ * returns non-zero; that value is returned. */
+typedef int (*meta_data_foreach_cb)(char const *key, int type,
+                                    void const *value, void *user_data);
+int meta_data_foreach(meta_data_t *md, meta_data_foreach_cb callback,
+                      void *user_data);
 int meta_data_delete(meta_data_t *md, const char *key);
 
 int meta_data_add_string(meta_data_t *md, const char *key, const char *value);
@@ -0,0 +1,123 @@
+/**
+ * collectd - src/utils/metadata/meta_data_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Microbenchmarks of the meta data functions. Build with
+ * "make bench_meta_data"; the optional argument is the number of
+ * operations, 1000000 by default. */
+
+#include "collectd.h"
+
+#include "benchmark.h"
+#include "utils/metadata/meta_data.h"
+
+/* A typical set of meta data, as added by the network and write plugins. */
+static meta_data_t *create_meta_data(void) {
+  meta_data_t *md = meta_data_create();
+  if (md == NULL)
+    return NULL;
+
+  meta_data_add_string(md, "network:received", "192.0.2.1");
+  meta_data_add_string(md, "network:username", "collectd");
+  meta_data_add_boolean(md, "network:encrypted", true);
+  meta_data_add_signed_int(md, "csv:offset", -42);
+  meta_data_add_unsigned_int(md, "rrdtool:heartbeat", 20);
+  meta_data_add_double(md, "threshold:hysteresis", 0.5);
+  return md;
+}
+
+DEF_BENCH(meta_data_clone) {
+  meta_data_t *md = create_meta_data();
+  if (md == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    meta_data_t *copy = meta_data_clone(md);
+    if (copy == NULL)
+      return -1;
+    meta_data_destroy(copy);
+  }
+  BENCH_STOP;
+
+  meta_data_destroy(md);
+  return 0;
+}
+
+DEF_BENCH(meta_data_create) {
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    meta_data_t *md = create_meta_data();
+    if (md == NULL)
+      return -1;
+    meta_data_destroy(md);
+  }
+  BENCH_STOP;
+
+  return 0;
+}
+
+DEF_BENCH(meta_data_get_string) {
+  meta_data_t *md = create_meta_data();
+  if (md == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    char *value = NULL;
+    if (meta_data_get_string(md, "network:username", &value) != 0)
+      return -1;
+    free(value);
+  }
+  BENCH_STOP;
+
+  meta_data_destroy(md);
+  return 0;
+}
+
+DEF_BENCH(meta_data_get_double) {
+  meta_data_t *md = create_meta_data();
+  if (md == NULL)
+    return -1;
+
+  BENCH_START;
+  for (size_t i = 0; i < ops; i++) {
+    double value;
+    if (meta_data_get_double(md, "threshold:hysteresis", &value) != 0)
+      return -1;
+  }
+  BENCH_STOP;
+
+  meta_data_destroy(md);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t ops = BENCH_OPS(argc, argv, 1000000);
+
+  RUN_BENCH(meta_data_clone, ops);
+  RUN_BENCH(meta_data_create, ops);
+  RUN_BENCH(meta_data_get_string, ops);
+  RUN_BENCH(meta_data_get_double, ops);
+
+  END_BENCH;
+}
@@ -110,8 +110,119 @@ DEF_TEST(base) {
   return 0;
 }
 
+DEF_TEST(clone) {
+  meta_data_t *m;
+  meta_data_t *c;
+  char **toc = NULL;
+  char *s;
+  int64_t si;
+
+  CHECK_NOT_NULL(m = meta_data_create());
+  CHECK_ZERO(meta_data_add_string(m, "string", "foobar"));
+  CHECK_ZERO(meta_data_add_signed_int(m, "signed_int", -1));
+
+  /* modifying the clone doesn't affect the original and vice versa */
+  CHECK_NOT_NULL(c = meta_data_clone(m));
+  CHECK_ZERO(meta_data_add_string(c, "string", "barfoo"));
+  CHECK_ZERO(meta_data_delete(c, "signed_int"));
+  CHECK_ZERO(meta_data_add_signed_int(m, "other_int", 42));
+
+  CHECK_ZERO(meta_data_get_string(m, "string", &s));
+  EXPECT_EQ_STR("foobar", s);
+  sfree(s);
+  CHECK_ZERO(meta_data_get_string(c, "string", &s));
+  EXPECT_EQ_STR("barfoo", s);
+  sfree(s);
+  OK(meta_data_exists(m, "signed_int"));
+  OK(!meta_data_exists(c, "signed_int"));
+  OK(!meta_data_exists(c, "other_int"));
+
+  /* keys are case insensitive */
+  CHECK_ZERO(meta_data_get_signed_int(m, "Signed_Int", &si));
+  EXPECT_EQ_INT(-1, (int)si);
+
+  /* the clone outlives the original */
+  meta_data_destroy(m);
+  CHECK_ZERO(meta_data_get_string(c, "string", &s));
+  EXPECT_EQ_STR("barfoo", s);
+  sfree(s);
+
+  /* growing beyond the initial size keeps the insertion order */
+  for (int i = 0; i < 20; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "key%02d", i);
+    CHECK_ZERO(meta_data_add_signed_int(c, key, i));
+  }
+  CHECK_ZERO(meta_data_delete(c, "key00"));
+  EXPECT_EQ_INT(20, meta_data_toc(c, &toc));
+  EXPECT_EQ_STR("string", toc[0]);
+  EXPECT_EQ_STR("key01", toc[1]);
+  EXPECT_EQ_STR("key19", toc[19]);
+  strarray_free(toc, 20);
+
+  /* merging overwrites existing keys */
+  CHECK_NOT_NULL(m = meta_data_create());
+  CHECK_ZERO(meta_data_add_signed_int(m, "key05", 555));
+  CHECK_ZERO(meta_data_add_signed_int(m, "new", 1));
+  CHECK_ZERO(meta_data_clone_merge(&c, m));
+  CHECK_ZERO(meta_data_get_signed_int(c, "key05", &si));
+  EXPECT_EQ_INT(555, (int)si);
+  OK(meta_data_exists(c, "new"));
+  CHECK_ZERO(meta_data_get_signed_int(m, "key05", &si));
+  EXPECT_EQ_INT(555, (int)si);
+
+  meta_data_destroy(m);
+  meta_data_destroy(c);
+  return 0;
+}
+
+static int foreach_cb(char const *key, int type, void const *value,
+                      void *user_data) {
+  char *out = user_data;
+  char tmp[64] = "";
+
+  if (type == MD_TYPE_STRING)
+    snprintf(tmp, sizeof(tmp), "%s=%s;", key, *((char *const *)value));
+  else if (type == MD_TYPE_SIGNED_INT)
+    snprintf(tmp, sizeof(tmp), "%s=%" PRIi64 ";", key,
+             *((int64_t const *)value));
+  else if (type == MD_TYPE_BOOLEAN)
+    snprintf(tmp, sizeof(tmp), "%s=%s;", key,
+             *((bool const *)value) ? "true" : "false");
+
+  strncat(out, tmp, 255 - strlen(out));
+  return (strcmp(key, "stop") == 0) ? 42 : 0;
+}
+
+DEF_TEST(foreach) {
+  meta_data_t *m;
+  char out[256] = "";
+
+  CHECK_NOT_NULL(m = meta_data_create());
+  CHECK_ZERO(meta_data_foreach(m, foreach_cb, out));
+  EXPECT_EQ_STR("", out);
+
+  CHECK_ZERO(meta_data_add_string(m, "s", "foo"));
+  CHECK_ZERO(meta_data_add_signed_int(m, "i", -3));
+  CHECK_ZERO(meta_data_add_boolean(m, "b", true));
+  CHECK_ZERO(meta_data_foreach(m, foreach_cb, out));
+  EXPECT_EQ_STR("s=foo;i=-3;b=true;", out);
+
+  /* a non-zero return value stops the iteration */
+  out[0] = 0;
+  CHECK_ZERO(meta_data_add_boolean(m, "stop", false));
+  CHECK_ZERO(meta_data_add_boolean(m, "after", false));
+  EXPECT_EQ_INT(42, meta_data_foreach(m, foreach_cb, out));
+  EXPECT_EQ_STR("s=foo;i=-3;b=true;stop=false;", out);
+
+  meta_data_destroy(m);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(base);
+  RUN_TEST(clone);
+  RUN_TEST(foreach);
 
   END_TEST;
 }
@@ -581,8 +581,10 @@ static int ovs_db_json_data_process(ovs_db_t *pdb, const char *data,
       /* echo request from the server */
       if (ovs_db_table_echo_cb(pdb, jnode) < 0)
         OVS_ERROR("handle echo request failed");
-    } else if (strcmp("update", method) == 0) {
-      /* update notification */
+    } else if ((strcmp("update", method) == 0) ||
+               (strcmp("update2", method) == 0)) {
+      /* update notification, with the same params for "monitor" and
+       * "monitor_cond" */
       if (ovs_db_table_update_cb(pdb, jnode) < 0)
         OVS_ERROR("handle update notification failed");
     }
@@ -1255,7 +1257,9 @@ int ovs_db_table_cb_register(ovs_db_t *pdb, const char *tb_name,
   /* make a request to subscribe to given table */
   OVS_YAJL_CALL(yajl_gen_get_buf, jgen, (const unsigned char **)&params,
                 &params_len);
-  if (ovs_db_send_request(pdb, "monitor", params, result_cb) < 0) {
+  const char *method =
+      (flags & OVS_DB_TABLE_CB_FLAG_UPDATE2) ? "monitor_cond" : "monitor";
+  if (ovs_db_send_request(pdb, method, params, result_cb) < 0) {
     OVS_ERROR("Failed to subscribe to \"%s\" table", tb_name);
     ovs_db_ret = (-1);
   }
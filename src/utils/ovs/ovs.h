@@ -161,6 +161,8 @@ int ovs_db_send_request(ovs_db_t *pdb, const char *method, const char *params,
 #define OVS_DB_TABLE_CB_FLAG_DELETE 0x04U
 #define OVS_DB_TABLE_CB_FLAG_MODIFY 0x08U
 #define OVS_DB_TABLE_CB_FLAG_ALL 0x0FU
+/* request flags */
+#define OVS_DB_TABLE_CB_FLAG_UPDATE2 0x10U
 
 /*
  * NAME
@@ -188,6 +190,15 @@ int ovs_db_send_request(ovs_db_t *pdb, const char *method, const char *params,
  *                   OVS_DB_TABLE_CB_FLAG_DELETE  Receive table remove events.
  *                   OVS_DB_TABLE_CB_FLAG_MODIFY  Receive table update events.
  *                   OVS_DB_TABLE_CB_FLAG_ALL     Receive all events.
+ *                 and optionally:
+ *                   OVS_DB_TABLE_CB_FLAG_UPDATE2 Subscribe with "monitor_cond"
+ *                                               and receive <table-updates2>
+ *                                               (see ovsdb-server(7)): only
+ *                                               the changed columns of
+ *                                               modified rows, with sets and
+ *                                               maps as differences. Servers
+ *                                               older than OVS 2.6 reply with
+ *                                               an error to `cb'.
  *
  * RETURN VALUE
  *   Zero upon success or non-zero if an error occurred.
@@ -0,0 +1,258 @@
+/**
+ * collectd - src/utils/pool/pool.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "utils/pool/pool.h"
+
+struct c_pool_cache_s;
+typedef struct c_pool_cache_s c_pool_cache_t;
+
+/* Every object is preceded by this header. While the object is in use, it
+ * points to the cache the object has been allocated from; while it is in a
+ * cache, it links the cache's free list. */
+union c_pool_header_u {
+  c_pool_cache_t *owner;
+  union c_pool_header_u *next;
+
+  /* for alignment only */
+  long double ld;
+  uint64_t u64;
+  void *ptr;
+};
+typedef union c_pool_header_u c_pool_header_t;
+
+struct c_pool_cache_s {
+  pthread_mutex_t lock;
+  c_pool_header_t *free;
+  size_t free_num;
+
+  uint64_t hits;
+  uint64_t misses;
+
+  /* Set when the owning thread exits. An orphaned cache is handed to the
+   * next thread that needs a cache. */
+  bool orphaned;
+
+  c_pool_cache_t *next;
+};
+
+struct c_pool_s {
+  size_t size;
+  size_t cache_max;
+
+  pthread_key_t key;
+
+  /* Protects `caches' and the caches' `orphaned' flags. */
+  pthread_mutex_t lock;
+  c_pool_cache_t *caches;
+};
+
+static void pool_cache_free_all(c_pool_cache_t *c) /* {{{ */
+{
+  while (c->free != NULL) {
+    c_pool_header_t *h = c->free;
+    c->free = h->next;
+    free(h);
+  }
+  c->free_num = 0;
+} /* }}} void pool_cache_free_all */
+
+/* pthread_key destructor. The cache can not be freed here because objects
+ * allocated from it may still be in use by other threads. */
+static void pool_cache_orphan(void *arg) /* {{{ */
+{
+  c_pool_cache_t *c = arg;
+
+  pthread_mutex_lock(&c->lock);
+  c->orphaned = true;
+  pthread_mutex_unlock(&c->lock);
+} /* }}} void pool_cache_orphan */
+
+static c_pool_cache_t *pool_cache_get(c_pool_t *p) /* {{{ */
+{
+  c_pool_cache_t *c = pthread_getspecific(p->key);
+  if (c != NULL)
+    return c;
+
+  pthread_mutex_lock(&p->lock);
+
+  for (c_pool_cache_t *o = p->caches; o != NULL; o = o->next) {
+    pthread_mutex_lock(&o->lock);
+    bool adopt = o->orphaned;
+    o->orphaned = false;
+    pthread_mutex_unlock(&o->lock);
+
+    if (adopt) {
+      c = o;
+      break;
+    }
+  }
+
+  if (c == NULL) {
+    c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+      pthread_mutex_unlock(&p->lock);
+      return NULL;
+    }
+    pthread_mutex_init(&c->lock, /* attr = */ NULL);
+    c->next = p->caches;
+    p->caches = c;
+  }
+
+  pthread_mutex_unlock(&p->lock);
+
+  pthread_setspecific(p->key, c);
+  return c;
+} /* }}} c_pool_cache_t *pool_cache_get */
+
+c_pool_t *c_pool_create(size_t size, size_t cache_max) /* {{{ */
+{
+  c_pool_t *p;
+
+  if (size == 0)
+    return NULL;
+
+  p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    return NULL;
+
+  p->size = size;
+  p->cache_max = cache_max;
+
+  if (pthread_key_create(&p->key, pool_cache_orphan) != 0) {
+    free(p);
+    return NULL;
+  }
+  pthread_mutex_init(&p->lock, /* attr = */ NULL);
+
+  return p;
+} /* }}} c_pool_t *c_pool_create */
+
+void c_pool_destroy(c_pool_t *p) /* {{{ */
+{
+  if (p == NULL)
+    return;
+
+  pthread_key_delete(p->key);
+
+  while (p->caches != NULL) {
+    c_pool_cache_t *c = p->caches;
+    p->caches = c->next;
+
+    pool_cache_free_all(c);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+  }
+
+  pthread_mutex_destroy(&p->lock);
+  free(p);
+} /* }}} void c_pool_destroy */
+
+void *c_pool_alloc(c_pool_t *p) /* {{{ */
+{
+  c_pool_header_t *h = NULL;
+
+  if (p == NULL)
+    return NULL;
+
+  c_pool_cache_t *c = pool_cache_get(p);
+  if (c == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&c->lock);
+  if (c->free != NULL) {
+    h = c->free;
+    c->free = h->next;
+    c->free_num--;
+    c->hits++;
+  } else {
+    c->misses++;
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  if (h == NULL) {
+    h = malloc(sizeof(*h) + p->size);
+    if (h == NULL)
+      return NULL;
+  }
+
+  h->owner = c;
+  return h + 1;
+} /* }}} void *c_pool_alloc */
+
+void c_pool_free(c_pool_t *p, void *ptr) /* {{{ */
+{
+  if ((p == NULL) || (ptr == NULL))
+    return;
+
+  c_pool_header_t *h = ((c_pool_header_t *)ptr) - 1;
+  c_pool_cache_t *c = h->owner;
+
+  pthread_mutex_lock(&c->lock);
+  if (c->free_num < p->cache_max) {
+    h->next = c->free;
+    c->free = h;
+    c->free_num++;
+    h = NULL;
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  free(h);
+} /* }}} void c_pool_free */
+
+void c_pool_stats(c_pool_t *p, uint64_t *ret_hits, /* {{{ */
+                  uint64_t *ret_misses) {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  if (p != NULL) {
+    pthread_mutex_lock(&p->lock);
+    for (c_pool_cache_t *c = p->caches; c != NULL; c = c->next) {
+      pthread_mutex_lock(&c->lock);
+      hits += c->hits;
+      misses += c->misses;
+      pthread_mutex_unlock(&c->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+
+  if (ret_hits != NULL)
+    *ret_hits = hits;
+  if (ret_misses != NULL)
+    *ret_misses = misses;
+} /* }}} void c_pool_stats */
+
+uint64_t c_pool_thread_misses(c_pool_t *p) /* {{{ */
+{
+  if (p == NULL)
+    return 0;
+
+  /* Only the owning thread modifies the counter. */
+  c_pool_cache_t *c = pthread_getspecific(p->key);
+  return (c != NULL) ? c->misses : 0;
+} /* }}} uint64_t c_pool_thread_misses */
@@ -0,0 +1,110 @@
+/**
+ * collectd - src/utils/pool/pool.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_POOL_H
+#define UTILS_POOL_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct c_pool_s;
+typedef struct c_pool_s c_pool_t;
+
+/*
+ * NAME
+ *   c_pool_create
+ *
+ * DESCRIPTION
+ *   Allocates a new pool of fixed size objects. Each thread allocating from
+ *   the pool gets its own cache of free objects. Objects are always returned
+ *   to the cache of the thread that allocated them, regardless of which
+ *   thread frees them, so that memory handed from a producer to a consumer
+ *   thread flows back to the producer. Caches of threads that have exited are
+ *   taken over by new threads.
+ *
+ * PARAMETERS
+ *   `size'       Size of the objects in bytes.
+ *   `cache_max'  Maximum number of free objects kept per thread. Objects
+ *                freed beyond that are returned to the system.
+ *
+ * RETURN VALUE
+ *   A c_pool_t-pointer upon success or NULL upon failure.
+ */
+c_pool_t *c_pool_create(size_t size, size_t cache_max);
+
+/*
+ * NAME
+ *   c_pool_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a pool and all free objects. All objects allocated from the
+ *   pool must have been freed before.
+ */
+void c_pool_destroy(c_pool_t *p);
+
+/*
+ * NAME
+ *   c_pool_alloc
+ *
+ * DESCRIPTION
+ *   Returns an object from the calling thread's cache, or allocates a new one
+ *   if the cache is empty. Like malloc(3), the memory is not initialized.
+ *
+ * RETURN VALUE
+ *   A pointer to the object or NULL upon failure.
+ */
+void *c_pool_alloc(c_pool_t *p);
+
+/*
+ * NAME
+ *   c_pool_free
+ *
+ * DESCRIPTION
+ *   Returns an object allocated with `c_pool_alloc' to its pool. Passing NULL
+ *   is a no-op.
+ */
+void c_pool_free(c_pool_t *p, void *ptr);
+
+/*
+ * NAME
+ *   c_pool_stats
+ *
+ * DESCRIPTION
+ *   Returns the number of allocations served from a cache (`ret_hits') and
+ *   the number of allocations that had to fall back to malloc
+ *   (`ret_misses'). Either pointer may be NULL.
+ */
+void c_pool_stats(c_pool_t *p, uint64_t *ret_hits, uint64_t *ret_misses);
+
+/*
+ * NAME
+ *   c_pool_thread_misses
+ *
+ * DESCRIPTION
+ *   Returns the number of allocations of the calling thread that had to fall
+ *   back to malloc. Unlike `c_pool_stats' this doesn't take any locks, so it
+ *   is cheap enough to be called around every allocation.
+ */
+uint64_t c_pool_thread_misses(c_pool_t *p);
+
+#endif /* UTILS_POOL_H */
@@ -0,0 +1,121 @@
+/**
+ * collectd - src/utils/pool/pool_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include <pthread.h>
+
+#include "testing.h"
+#include "utils/pool/pool.h"
+
+#define OBJECTS_NUM 16
+
+DEF_TEST(simple) {
+  c_pool_t *p;
+  void *objects[OBJECTS_NUM];
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  CHECK_NOT_NULL(p = c_pool_create(sizeof(double), /* cache_max = */ 8));
+  EXPECT_EQ_UINT64(0, c_pool_thread_misses(p));
+
+  for (size_t i = 0; i < OBJECTS_NUM; i++) {
+    CHECK_NOT_NULL(objects[i] = c_pool_alloc(p));
+    *((double *)objects[i]) = (double)i;
+  }
+  c_pool_stats(p, &hits, &misses);
+  EXPECT_EQ_UINT64(0, hits);
+  EXPECT_EQ_UINT64(OBJECTS_NUM, misses);
+
+  /* Only `cache_max' objects are kept. */
+  for (size_t i = 0; i < OBJECTS_NUM; i++)
+    c_pool_free(p, objects[i]);
+
+  for (size_t i = 0; i < OBJECTS_NUM; i++)
+    CHECK_NOT_NULL(objects[i] = c_pool_alloc(p));
+  c_pool_stats(p, &hits, &misses);
+  EXPECT_EQ_UINT64(8, hits);
+  EXPECT_EQ_UINT64(OBJECTS_NUM + 8, misses);
+  EXPECT_EQ_UINT64(OBJECTS_NUM + 8, c_pool_thread_misses(p));
+
+  for (size_t i = 0; i < OBJECTS_NUM; i++)
+    c_pool_free(p, objects[i]);
+  c_pool_free(p, NULL);
+
+  c_pool_destroy(p);
+  return 0;
+}
+
+typedef struct {
+  c_pool_t *pool;
+  void *objects[OBJECTS_NUM];
+} thread_data_t;
+
+static void *alloc_thread(void *arg) {
+  thread_data_t *data = arg;
+
+  for (size_t i = 0; i < OBJECTS_NUM; i++)
+    data->objects[i] = c_pool_alloc(data->pool);
+
+  return NULL;
+}
+
+DEF_TEST(threads) {
+  thread_data_t data = {0};
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  pthread_t t;
+
+  CHECK_NOT_NULL(data.pool = c_pool_create(sizeof(int), /* cache_max = */ 64));
+
+  /* Objects allocated by the (exited) thread are freed here and go back to
+   * that thread's cache ... */
+  CHECK_ZERO(pthread_create(&t, NULL, alloc_thread, &data));
+  CHECK_ZERO(pthread_join(t, NULL));
+  for (size_t i = 0; i < OBJECTS_NUM; i++) {
+    OK(data.objects[i] != NULL);
+    c_pool_free(data.pool, data.objects[i]);
+  }
+
+  /* ... which is taken over by the next thread. */
+  CHECK_ZERO(pthread_create(&t, NULL, alloc_thread, &data));
+  CHECK_ZERO(pthread_join(t, NULL));
+  c_pool_stats(data.pool, &hits, &misses);
+  EXPECT_EQ_UINT64(OBJECTS_NUM, hits);
+  EXPECT_EQ_UINT64(OBJECTS_NUM, misses);
+  /* This thread has not allocated anything. */
+  EXPECT_EQ_UINT64(0, c_pool_thread_misses(data.pool));
+
+  for (size_t i = 0; i < OBJECTS_NUM; i++)
+    c_pool_free(data.pool, data.objects[i]);
+
+  c_pool_destroy(data.pool);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(simple);
+  RUN_TEST(threads);
+
+  END_TEST;
+}
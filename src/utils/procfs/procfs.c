@@ -0,0 +1,144 @@
+/**
+ * collectd - src/utils/procfs/procfs.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/procfs/procfs.h"
+
+/* Most files below /proc are smaller than this; larger ones, e.g.
+ * /proc/interrupts on machines with many CPUs, make the buffer grow. */
+#define PROCFS_BUFFER_SIZE_INIT 4096
+
+/* The descriptors are kept open all the time, so don't leak them into
+ * programs started by the exec plugin. */
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+struct procfs_file_s {
+  int fd;
+  char *path;
+
+  char *buffer;
+  size_t buffer_size;
+  /* Length of the content, excluding the terminating null byte. */
+  size_t len;
+  /* Start of the next line returned by procfs_next_line. */
+  size_t pos;
+};
+
+procfs_file_t *procfs_open(char const *path) /* {{{ */
+{
+  procfs_file_t *pf = calloc(1, sizeof(*pf));
+  if (pf == NULL)
+    return NULL;
+
+  pf->path = strdup(path);
+  pf->buffer_size = PROCFS_BUFFER_SIZE_INIT;
+  pf->buffer = malloc(pf->buffer_size);
+  if ((pf->path == NULL) || (pf->buffer == NULL)) {
+    free(pf->path);
+    free(pf->buffer);
+    free(pf);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  pf->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (pf->fd < 0) {
+    int err = errno;
+    free(pf->path);
+    free(pf->buffer);
+    free(pf);
+    errno = err;
+    return NULL;
+  }
+
+  return pf;
+} /* }}} procfs_file_t *procfs_open */
+
+void procfs_close(procfs_file_t *pf) /* {{{ */
+{
+  if (pf == NULL)
+    return;
+
+  close(pf->fd);
+  free(pf->path);
+  free(pf->buffer);
+  free(pf);
+} /* }}} void procfs_close */
+
+int procfs_read(procfs_file_t *pf) /* {{{ */
+{
+  if (pf == NULL)
+    return EINVAL;
+
+  pf->len = 0;
+  pf->pos = 0;
+  pf->buffer[0] = 0;
+
+  while (42) {
+    /* Keep one byte for the terminating null byte. */
+    if ((pf->buffer_size - pf->len) < 2) {
+      char *tmp = realloc(pf->buffer, 2 * pf->buffer_size);
+      if (tmp == NULL)
+        return ENOMEM;
+      pf->buffer = tmp;
+      pf->buffer_size *= 2;
+    }
+
+    ssize_t status = pread(pf->fd, pf->buffer + pf->len,
+                           pf->buffer_size - pf->len - 1, (off_t)pf->len);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      int err = errno;
+      pf->len = 0;
+      pf->buffer[0] = 0;
+      return err;
+    } else if (status == 0) {
+      break;
+    }
+    pf->len += (size_t)status;
+  }
+
+  pf->buffer[pf->len] = 0;
+  return 0;
+} /* }}} int procfs_read */
+
+char *procfs_next_line(procfs_file_t *pf) /* {{{ */
+{
+  if ((pf == NULL) || (pf->pos >= pf->len))
+    return NULL;
+
+  char *line = pf->buffer + pf->pos;
+  char *end = memchr(line, '\n', pf->len - pf->pos);
+  if (end == NULL) {
+    pf->pos = pf->len;
+  } else {
+    *end = 0;
+    pf->pos = (size_t)(end - pf->buffer) + 1;
+  }
+
+  return line;
+} /* }}} char *procfs_next_line */
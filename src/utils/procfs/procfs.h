@@ -0,0 +1,84 @@
+/**
+ * collectd - src/utils/procfs/procfs.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_PROCFS_H
+#define UTILS_PROCFS_H 1
+
+#include <stddef.h>
+
+struct procfs_file_s;
+typedef struct procfs_file_s procfs_file_t;
+
+/*
+ * NAME
+ *   procfs_open
+ *
+ * DESCRIPTION
+ *   Opens a file, typically one below /proc, that is read again and again.
+ *   The file descriptor is kept open and every `procfs_read' re-reads the file
+ *   from offset zero with pread(2) into a buffer that is reused, so that
+ *   reading the file does not open it or allocate memory.
+ *
+ * RETURN VALUE
+ *   A procfs_file_t-pointer upon success or NULL upon failure, with errno
+ *   set.
+ */
+procfs_file_t *procfs_open(char const *path);
+
+/*
+ * NAME
+ *   procfs_close
+ *
+ * DESCRIPTION
+ *   Closes the file and frees the buffer. Passing NULL is a no-op.
+ */
+void procfs_close(procfs_file_t *pf);
+
+/*
+ * NAME
+ *   procfs_read
+ *
+ * DESCRIPTION
+ *   Reads the whole file into the buffer, growing it if necessary, and
+ *   rewinds the line iterator. Lines returned before are invalidated.
+ *
+ * RETURN VALUE
+ *   Zero upon success or an errno value upon failure.
+ */
+int procfs_read(procfs_file_t *pf);
+
+/*
+ * NAME
+ *   procfs_next_line
+ *
+ * DESCRIPTION
+ *   Returns the next line of the content read by `procfs_read', without the
+ *   trailing newline. The line is part of the buffer and may be modified,
+ *   e.g. split into fields with strsplit(), until the next `procfs_read'.
+ *
+ * RETURN VALUE
+ *   The line or NULL after the last line.
+ */
+char *procfs_next_line(procfs_file_t *pf);
+
+#endif /* UTILS_PROCFS_H */
@@ -0,0 +1,117 @@
+/**
+ * collectd - src/utils/procfs/procfs_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/procfs/procfs.h"
+
+static char path[] = "/tmp/collectd_procfs_test.XXXXXX";
+
+static int write_file(char const *content) {
+  FILE *fh = fopen(path, "w");
+  if (fh == NULL)
+    return -1;
+  fputs(content, fh);
+  return fclose(fh);
+}
+
+DEF_TEST(lines) {
+  procfs_file_t *pf;
+  char *line;
+
+  CHECK_ZERO(write_file("cpu  1 2 3\ncpu0 4 5 6\nintr 7"));
+  CHECK_NOT_NULL(pf = procfs_open(path));
+
+  for (int i = 0; i < 2; i++) {
+    CHECK_ZERO(procfs_read(pf));
+    CHECK_NOT_NULL(line = procfs_next_line(pf));
+    EXPECT_EQ_STR("cpu  1 2 3", line);
+    CHECK_NOT_NULL(line = procfs_next_line(pf));
+    EXPECT_EQ_STR("cpu0 4 5 6", line);
+    /* The last line doesn't end with a newline. */
+    CHECK_NOT_NULL(line = procfs_next_line(pf));
+    EXPECT_EQ_STR("intr 7", line);
+    OK(procfs_next_line(pf) == NULL);
+  }
+
+  procfs_close(pf);
+  return 0;
+}
+
+DEF_TEST(reread) {
+  procfs_file_t *pf;
+  char *line;
+  char big[3 * 4096 + 1];
+
+  CHECK_ZERO(write_file("first\n"));
+  CHECK_NOT_NULL(pf = procfs_open(path));
+  CHECK_ZERO(procfs_read(pf));
+  CHECK_NOT_NULL(line = procfs_next_line(pf));
+  EXPECT_EQ_STR("first", line);
+
+  /* The file is re-read through the same descriptor; the buffer grows. */
+  memset(big, 'x', sizeof(big) - 2);
+  big[sizeof(big) - 2] = '\n';
+  big[sizeof(big) - 1] = 0;
+  CHECK_ZERO(write_file(big));
+  CHECK_ZERO(procfs_read(pf));
+  CHECK_NOT_NULL(line = procfs_next_line(pf));
+  EXPECT_EQ_UINT64(sizeof(big) - 2, strlen(line));
+  OK(procfs_next_line(pf) == NULL);
+
+  CHECK_ZERO(write_file(""));
+  CHECK_ZERO(procfs_read(pf));
+  OK(procfs_next_line(pf) == NULL);
+
+  procfs_close(pf);
+  return 0;
+}
+
+DEF_TEST(errors) {
+  errno = 0;
+  OK(procfs_open("/nonexistent/collectd/procfs/test") == NULL);
+  EXPECT_EQ_INT(ENOENT, errno);
+
+  EXPECT_EQ_INT(EINVAL, procfs_read(NULL));
+  OK(procfs_next_line(NULL) == NULL);
+  procfs_close(NULL);
+
+  return 0;
+}
+
+int main(void) {
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    fprintf(stderr, "mkstemp failed: %s\n", strerror(errno));
+    return 1;
+  }
+  close(fd);
+
+  RUN_TEST(lines);
+  RUN_TEST(reread);
+  RUN_TEST(errors);
+
+  unlink(path);
+  END_TEST;
+}
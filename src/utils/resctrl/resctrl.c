@@ -0,0 +1,239 @@
+/**
+ * collectd - src/utils/resctrl/resctrl.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/resctrl/resctrl.h"
+
+#include <dirent.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/* Files below mon_data/mon_L3_XX, in the order of the RESCTRL_* flags. */
+static char const *const resctrl_events[] = {
+    "llc_occupancy",
+    "mbm_local_bytes",
+    "mbm_total_bytes",
+};
+#define RESCTRL_EVENTS_NUM                                                     \
+  (sizeof(resctrl_events) / sizeof(resctrl_events[0]))
+
+struct resctrl_group_s {
+  char *path;
+  int is_default;
+  int tasks_fd;
+
+  /* RESCTRL_EVENTS_NUM descriptors per domain, -1 if the event is not
+   * supported. */
+  int *fds;
+  size_t domains_num;
+};
+
+static int resctrl_open_domain(resctrl_group_t *g, char const *dir) /* {{{ */
+{
+  int *tmp = realloc(g->fds, (g->domains_num + 1) * RESCTRL_EVENTS_NUM *
+                                 sizeof(*g->fds));
+  if (tmp == NULL)
+    return ENOMEM;
+  g->fds = tmp;
+
+  int *fds = g->fds + g->domains_num * RESCTRL_EVENTS_NUM;
+  for (size_t i = 0; i < RESCTRL_EVENTS_NUM; i++) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/mon_data/%s/%s", g->path, dir,
+             resctrl_events[i]);
+    fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+  }
+
+  g->domains_num++;
+  return 0;
+} /* }}} int resctrl_open_domain */
+
+resctrl_group_t *resctrl_group_open(char const *root, /* {{{ */
+                                    char const *name) {
+  char path[PATH_MAX];
+  int status;
+
+  if (name == NULL)
+    status = snprintf(path, sizeof(path), "%s", root);
+  else
+    status = snprintf(path, sizeof(path), "%s/mon_groups/%s", root, name);
+  if ((status < 0) || ((size_t)status >= sizeof(path))) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+
+  /* A group left behind by a previous instance is reused. */
+  int created = 0;
+  if (name != NULL) {
+    if (mkdir(path, 0755) == 0)
+      created = 1;
+    else if (errno != EEXIST)
+      return NULL;
+  }
+
+  resctrl_group_t *g = calloc(1, sizeof(*g));
+  if (g == NULL) {
+    if (created)
+      rmdir(path);
+    return NULL;
+  }
+  g->is_default = (name == NULL);
+  g->tasks_fd = -1;
+
+  g->path = strdup(path);
+  if (g->path == NULL) {
+    if (created)
+      rmdir(path);
+    resctrl_group_close(g, /* remove = */ 0);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  char tasks[PATH_MAX];
+  status = snprintf(tasks, sizeof(tasks), "%s/tasks", path);
+  if ((status < 0) || ((size_t)status >= sizeof(tasks))) {
+    resctrl_group_close(g, created);
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  g->tasks_fd = open(tasks, O_WRONLY | O_CLOEXEC);
+  if (g->tasks_fd < 0) {
+    int err = errno;
+    resctrl_group_close(g, created);
+    errno = err;
+    return NULL;
+  }
+
+  /* One directory per L3 cache domain, i.e. usually per socket. */
+  char mon_data[PATH_MAX];
+  status = snprintf(mon_data, sizeof(mon_data), "%s/mon_data", path);
+  if ((status < 0) || ((size_t)status >= sizeof(mon_data))) {
+    resctrl_group_close(g, created);
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  DIR *dh = opendir(mon_data);
+  if (dh != NULL) {
+    struct dirent *de;
+    status = 0;
+    while ((status == 0) && ((de = readdir(dh)) != NULL))
+      if (strncmp("mon_L3_", de->d_name, strlen("mon_L3_")) == 0)
+        status = resctrl_open_domain(g, de->d_name);
+    closedir(dh);
+
+    if (status != 0) {
+      resctrl_group_close(g, created);
+      errno = status;
+      return NULL;
+    }
+  }
+
+  return g;
+} /* }}} resctrl_group_t *resctrl_group_open */
+
+void resctrl_group_close(resctrl_group_t *g, int remove) /* {{{ */
+{
+  if (g == NULL)
+    return;
+
+  for (size_t i = 0; i < g->domains_num * RESCTRL_EVENTS_NUM; i++)
+    if (g->fds[i] >= 0)
+      close(g->fds[i]);
+  free(g->fds);
+  if (g->tasks_fd >= 0)
+    close(g->tasks_fd);
+
+  if (remove && !g->is_default && (g->path != NULL))
+    rmdir(g->path);
+
+  free(g->path);
+  free(g);
+} /* }}} void resctrl_group_close */
+
+int resctrl_group_add_task(resctrl_group_t *g, pid_t tid) /* {{{ */
+{
+  char buffer[32];
+
+  if (g == NULL)
+    return EINVAL;
+
+  int len = snprintf(buffer, sizeof(buffer), "%d\n", (int)tid);
+  while (write(g->tasks_fd, buffer, (size_t)len) < 0) {
+    if (errno != EINTR)
+      return errno;
+  }
+
+  return 0;
+} /* }}} int resctrl_group_add_task */
+
+/* The files contain a decimal number, or "Unavailable" if the hardware has
+ * no value for the group yet. */
+static int resctrl_read_value(int fd, uint64_t *ret) /* {{{ */
+{
+  char buffer[32];
+  ssize_t len;
+
+  while ((len = pread(fd, buffer, sizeof(buffer) - 1, 0)) < 0) {
+    if (errno != EINTR)
+      return errno;
+  }
+  buffer[len] = 0;
+
+  char *endptr = NULL;
+  errno = 0;
+  unsigned long long value = strtoull(buffer, &endptr, 10);
+  if ((errno != 0) || (endptr == buffer) ||
+      ((*endptr != 0) && (*endptr != '\n')))
+    return EINVAL;
+
+  *ret = (uint64_t)value;
+  return 0;
+} /* }}} int resctrl_read_value */
+
+int resctrl_group_read(resctrl_group_t *g, resctrl_values_t *ret) /* {{{ */
+{
+  uint64_t sums[RESCTRL_EVENTS_NUM] = {0};
+
+  if ((g == NULL) || (ret == NULL))
+    return EINVAL;
+
+  ret->valid = (g->domains_num > 0) ? ((1u << RESCTRL_EVENTS_NUM) - 1) : 0;
+  for (size_t d = 0; d < g->domains_num; d++) {
+    int *fds = g->fds + d * RESCTRL_EVENTS_NUM;
+    for (size_t i = 0; i < RESCTRL_EVENTS_NUM; i++) {
+      uint64_t value = 0;
+      if ((fds[i] < 0) || (resctrl_read_value(fds[i], &value) != 0))
+        ret->valid &= ~(1u << i);
+      else
+        sums[i] += value;
+    }
+  }
+
+  ret->llc_occupancy = sums[0];
+  ret->mbm_local_bytes = sums[1];
+  ret->mbm_total_bytes = sums[2];
+  return 0;
+} /* }}} int resctrl_group_read */
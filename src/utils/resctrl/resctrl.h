@@ -0,0 +1,103 @@
+/**
+ * collectd - src/utils/resctrl/resctrl.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_RESCTRL_H
+#define UTILS_RESCTRL_H 1
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Flags of the values returned by `resctrl_group_read'. */
+#define RESCTRL_LLC_OCCUPANCY 0x01
+#define RESCTRL_MBM_LOCAL_BYTES 0x02
+#define RESCTRL_MBM_TOTAL_BYTES 0x04
+
+typedef struct {
+  /* Bitwise or of the RESCTRL_* flags of the values that are available. */
+  unsigned int valid;
+  /* The values are summed over all L3 cache domains. */
+  uint64_t llc_occupancy;
+  uint64_t mbm_local_bytes;
+  uint64_t mbm_total_bytes;
+} resctrl_values_t;
+
+struct resctrl_group_s;
+typedef struct resctrl_group_s resctrl_group_t;
+
+/*
+ * NAME
+ *   resctrl_group_open
+ *
+ * DESCRIPTION
+ *   Opens the monitoring group "name" below "mon_groups" of the resctrl file
+ *   system mounted at "root", creating it if necessary. If "name" is NULL,
+ *   the default group, i.e. "root" itself, is opened.
+ *   The "tasks" file and the monitoring data files of all L3 cache domains
+ *   are kept open, so that adding tasks and reading the values does not open
+ *   any files.
+ *
+ * RETURN VALUE
+ *   A resctrl_group_t-pointer upon success or NULL upon failure, with errno
+ *   set.
+ */
+resctrl_group_t *resctrl_group_open(char const *root, char const *name);
+
+/*
+ * NAME
+ *   resctrl_group_close
+ *
+ * DESCRIPTION
+ *   Closes the files of the group. If "remove" is non-zero, the group is also
+ *   removed; the kernel moves its tasks back to the parent group. The default
+ *   group is never removed. Passing NULL is a no-op.
+ */
+void resctrl_group_close(resctrl_group_t *g, int remove);
+
+/*
+ * NAME
+ *   resctrl_group_add_task
+ *
+ * DESCRIPTION
+ *   Moves the task (thread) "tid" to the group. Threads and processes it
+ *   creates afterwards belong to the group, too.
+ *
+ * RETURN VALUE
+ *   Zero upon success or an errno value upon failure, e.g. ESRCH if the task
+ *   has exited.
+ */
+int resctrl_group_add_task(resctrl_group_t *g, pid_t tid);
+
+/*
+ * NAME
+ *   resctrl_group_read
+ *
+ * DESCRIPTION
+ *   Reads the LLC occupancy and the memory bandwidth counters of the group.
+ *   A value is only flagged as valid if it could be read for all domains.
+ *
+ * RETURN VALUE
+ *   Zero upon success or an errno value upon failure.
+ */
+int resctrl_group_read(resctrl_group_t *g, resctrl_values_t *ret);
+
+#endif /* UTILS_RESCTRL_H */
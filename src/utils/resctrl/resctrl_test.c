@@ -0,0 +1,160 @@
+/**
+ * collectd - src/utils/resctrl/resctrl_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/resctrl/resctrl.h"
+
+#include <dirent.h>
+
+static char root[] = "/tmp/collectd_resctrl_test.XXXXXX";
+
+static int write_file(char const *name, char const *content) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", root, name);
+
+  FILE *fh = fopen(path, "w");
+  if (fh == NULL)
+    return -1;
+  fputs(content, fh);
+  return fclose(fh);
+}
+
+static int read_file(char const *name, char *buffer, size_t buffer_size) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", root, name);
+
+  FILE *fh = fopen(path, "r");
+  if (fh == NULL)
+    return -1;
+  size_t len = fread(buffer, 1, buffer_size - 1, fh);
+  buffer[len] = 0;
+  return fclose(fh);
+}
+
+static void remove_tree(char const *path) {
+  DIR *dh = opendir(path);
+  if (dh != NULL) {
+    struct dirent *de;
+    while ((de = readdir(dh)) != NULL) {
+      if ((strcmp(".", de->d_name) == 0) || (strcmp("..", de->d_name) == 0))
+        continue;
+      char child[PATH_MAX];
+      snprintf(child, sizeof(child), "%s/%s", path, de->d_name);
+      remove_tree(child);
+    }
+    closedir(dh);
+  }
+  remove(path);
+}
+
+static int make_dir(char const *name) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", root, name);
+  return mkdir(path, 0755);
+}
+
+DEF_TEST(default_group) {
+  resctrl_group_t *g;
+  resctrl_values_t v;
+  char buffer[64];
+
+  CHECK_ZERO(make_dir("mon_data"));
+  CHECK_ZERO(make_dir("mon_data/mon_L3_00"));
+  CHECK_ZERO(make_dir("mon_data/mon_L3_01"));
+  CHECK_ZERO(write_file("tasks", ""));
+  CHECK_ZERO(write_file("mon_data/mon_L3_00/llc_occupancy", "1000\n"));
+  CHECK_ZERO(write_file("mon_data/mon_L3_00/mbm_local_bytes", "20\n"));
+  CHECK_ZERO(write_file("mon_data/mon_L3_00/mbm_total_bytes", "30\n"));
+  CHECK_ZERO(write_file("mon_data/mon_L3_01/llc_occupancy", "2000\n"));
+  CHECK_ZERO(write_file("mon_data/mon_L3_01/mbm_local_bytes", "5\n"));
+  /* mbm_total_bytes is missing in the second domain. */
+
+  CHECK_NOT_NULL(g = resctrl_group_open(root, NULL));
+  CHECK_ZERO(resctrl_group_read(g, &v));
+  EXPECT_EQ_INT(RESCTRL_LLC_OCCUPANCY | RESCTRL_MBM_LOCAL_BYTES, v.valid);
+  EXPECT_EQ_UINT64(3000, v.llc_occupancy);
+  EXPECT_EQ_UINT64(25, v.mbm_local_bytes);
+
+  /* The files are re-read through the descriptors opened before. */
+  CHECK_ZERO(write_file("mon_data/mon_L3_01/llc_occupancy", "Unavailable\n"));
+  CHECK_ZERO(write_file("mon_data/mon_L3_01/mbm_local_bytes", "12345\n"));
+  CHECK_ZERO(resctrl_group_read(g, &v));
+  EXPECT_EQ_INT(RESCTRL_MBM_LOCAL_BYTES, v.valid);
+  EXPECT_EQ_UINT64(12365, v.mbm_local_bytes);
+
+  CHECK_ZERO(resctrl_group_add_task(g, 4711));
+  CHECK_ZERO(read_file("tasks", buffer, sizeof(buffer)));
+  EXPECT_EQ_STR("4711\n", buffer);
+
+  /* The default group is never removed. */
+  resctrl_group_close(g, /* remove = */ 1);
+  CHECK_ZERO(access(root, F_OK));
+
+  return 0;
+}
+
+DEF_TEST(mon_group) {
+  resctrl_group_t *g;
+  resctrl_values_t v;
+  char path[PATH_MAX];
+
+  /* The kernel creates the files of a new group; the test has to provide
+   * "tasks", so the group is created in advance and then reused. A group
+   * without "tasks" is removed again. */
+  CHECK_ZERO(make_dir("mon_groups"));
+  OK(resctrl_group_open(root, "missing") == NULL);
+  snprintf(path, sizeof(path), "%s/mon_groups/missing", root);
+  EXPECT_EQ_INT(-1, access(path, F_OK));
+
+  CHECK_ZERO(make_dir("mon_groups/test"));
+  CHECK_ZERO(write_file("mon_groups/test/tasks", ""));
+  CHECK_NOT_NULL(g = resctrl_group_open(root, "test"));
+
+  /* Without monitoring data, no value is valid. */
+  CHECK_ZERO(resctrl_group_read(g, &v));
+  EXPECT_EQ_INT(0, v.valid);
+
+  snprintf(path, sizeof(path), "%s/mon_groups/test/tasks", root);
+  CHECK_ZERO(unlink(path));
+  resctrl_group_close(g, /* remove = */ 1);
+  snprintf(path, sizeof(path), "%s/mon_groups/test", root);
+  EXPECT_EQ_INT(-1, access(path, F_OK));
+
+  return 0;
+}
+
+int main(void) {
+  if (mkdtemp(root) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  RUN_TEST(default_group);
+  RUN_TEST(mon_group);
+
+  remove_tree(root);
+
+  END_TEST;
+}
@@ -0,0 +1,930 @@
+/**
+ * collectd - src/utils/segment/segment.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/avltree/avltree.h"
+#include "utils/crc32/crc32.h"
+#include "utils/segment/segment.h"
+#include "utils/tsz/tsz.h"
+
+/* A file starts with SEGMENT_MAGIC, followed by the blocks, the index and
+ * the trailer:
+ *
+ *   block:      segment_block_t, segment_column_t[columns_num], the
+ *               definitions of the series new in the block (defs_size
+ *               bytes), then the data of the columns (data_size bytes).
+ *   definition: segment_def_t, the name, then for each data source its
+ *               DS_TYPE_* and the length of its name as one byte each,
+ *               followed by the name.
+ *   index:      segment_index_t, the definitions of all series (defs_size
+ *               bytes), segment_index_entry_t[blocks_num].
+ *   trailer:    segment_trailer_t.
+ *
+ * The columns of a block are ordered by the number of their series. The
+ * checksum of a block covers its columns and definitions, that of a column
+ * its data and that of the index everything after its header. */
+#define SEGMENT_MAGIC "cdseg001"
+#define SEGMENT_MAGIC_SIZE 8
+#define SEGMENT_BLOCK_MAGIC 0x6b6c4273 /* "sBlk" */
+#define SEGMENT_INDEX_MAGIC 0x78644973 /* "sIdx" */
+#define SEGMENT_TRAILER_MAGIC "cdsegend"
+
+/* The largest gap between two points of a column, see c_tsz_encode(). */
+#define SEGMENT_MAX_GAP_MS ((int64_t)INT32_MAX)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint32_t columns_num;
+  uint32_t series_num;
+  uint64_t defs_size;
+  uint64_t data_size;
+  uint64_t first;
+  uint64_t last;
+} segment_block_t;
+
+typedef struct {
+  uint32_t id;
+  uint32_t points;
+  /* Relative to the start of the data of the block. */
+  uint64_t offset;
+  uint32_t size;
+  uint32_t crc;
+} segment_column_t;
+
+typedef struct {
+  uint32_t id;
+  uint16_t name_len;
+  uint16_t ds_num;
+} segment_def_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint32_t series_num;
+  uint32_t blocks_num;
+  uint64_t defs_size;
+} segment_index_t;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t first;
+  uint64_t last;
+} segment_index_entry_t;
+
+typedef struct {
+  uint64_t index_offset;
+  char magic[8];
+} segment_trailer_t;
+
+/* A series of a writer and the points kept in memory. */
+typedef struct {
+  segment_series_t series;
+  uint32_t id;
+  /* Set once the series has been defined in a block. */
+  bool defined;
+  bool have_last;
+  int64_t last_ms;
+
+  cdtime_t *times;
+  gauge_t *values;
+  size_t points;
+  size_t size;
+} segment_wseries_t;
+
+struct segment_writer_s {
+  int fd;
+  uint64_t offset;
+
+  c_avl_tree_t *by_name;
+  segment_wseries_t **series;
+  size_t series_num;
+  size_t series_size;
+
+  /* The series with points kept in memory. */
+  segment_wseries_t **pending;
+  size_t pending_num;
+  size_t pending_size;
+  size_t pending_points;
+
+  segment_index_entry_t *blocks;
+  size_t blocks_num;
+  size_t blocks_size;
+};
+
+struct segment_reader_s {
+  int fd;
+  uint64_t file_size;
+
+  segment_series_t *series;
+  size_t series_num;
+  size_t series_size;
+
+  segment_index_entry_t *blocks;
+  size_t blocks_num;
+  size_t blocks_size;
+};
+
+/* Makes room for one more element in the array `*ptr' of `*size' elements,
+ * `num' of which are in use. */
+static int segment_grow(void **ptr, size_t *size, size_t num,
+                        size_t elem_size) {
+  if (num < *size)
+    return 0;
+
+  size_t new_size = (*size > 0) ? 2 * *size : 16;
+  void *tmp = realloc(*ptr, new_size * elem_size);
+  if (tmp == NULL)
+    return ENOMEM;
+  *ptr = tmp;
+  *size = new_size;
+  return 0;
+} /* int segment_grow */
+
+static int segment_write(int fd, void const *buf, size_t size) {
+  char const *ptr = buf;
+  while (size > 0) {
+    ssize_t n = write(fd, ptr, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    ptr += n;
+    size -= (size_t)n;
+  }
+  return 0;
+} /* int segment_write */
+
+static int segment_pread(int fd, void *buf, size_t size, uint64_t offset) {
+  char *ptr = buf;
+  while (size > 0) {
+    ssize_t n = pread(fd, ptr, size, (off_t)offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    } else if (n == 0) {
+      return EILSEQ;
+    }
+    ptr += n;
+    size -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+  return 0;
+} /* int segment_pread */
+
+static void segment_series_free(segment_series_t *s) {
+  if (s->ds_names != NULL)
+    for (size_t i = 0; i < s->values_num; i++)
+      free(s->ds_names[i]);
+  free(s->ds_names);
+  free(s->ds_types);
+  free(s->name);
+} /* void segment_series_free */
+
+static size_t segment_def_size(segment_series_t const *s) {
+  size_t size = sizeof(segment_def_t) + strlen(s->name);
+  for (size_t i = 0; i < s->values_num; i++)
+    size += 2 + strlen(s->ds_names[i]);
+  return size;
+} /* size_t segment_def_size */
+
+/* Writes the definition of a series to `buf', which has room for
+ * segment_def_size() bytes, and returns the number of bytes written. */
+static size_t segment_def_encode(segment_series_t const *s, uint32_t id,
+                                 char *buf) {
+  segment_def_t def = {
+      .id = id,
+      .name_len = (uint16_t)strlen(s->name),
+      .ds_num = (uint16_t)s->values_num,
+  };
+  char *ptr = buf;
+  memcpy(ptr, &def, sizeof(def));
+  ptr += sizeof(def);
+  memcpy(ptr, s->name, def.name_len);
+  ptr += def.name_len;
+
+  for (size_t i = 0; i < s->values_num; i++) {
+    size_t len = strlen(s->ds_names[i]);
+    *ptr++ = (char)(uint8_t)s->ds_types[i];
+    *ptr++ = (char)(uint8_t)len;
+    memcpy(ptr, s->ds_names[i], len);
+    ptr += len;
+  }
+
+  return (size_t)(ptr - buf);
+} /* size_t segment_def_encode */
+
+/* Adds the `num' definitions in the `size' bytes at `buf' to the series of
+ * the reader. The series have to be defined in the order of their numbers.
+ */
+static int segment_defs_parse(segment_reader_t *r, char const *buf,
+                              size_t size, size_t num) {
+  char const *ptr = buf;
+  char const *end = buf + size;
+
+  for (size_t n = 0; n < num; n++) {
+    segment_def_t def;
+    if ((size_t)(end - ptr) < sizeof(def))
+      return EILSEQ;
+    memcpy(&def, ptr, sizeof(def));
+    ptr += sizeof(def);
+    if ((def.id != r->series_num) || (def.ds_num == 0) ||
+        ((size_t)(end - ptr) < def.name_len))
+      return EILSEQ;
+
+    if (segment_grow((void **)&r->series, &r->series_size, r->series_num,
+                     sizeof(*r->series)) != 0)
+      return ENOMEM;
+
+    segment_series_t s = {
+        .name = strndup(ptr, def.name_len),
+        .values_num = def.ds_num,
+        .ds_names = calloc(def.ds_num, sizeof(*s.ds_names)),
+        .ds_types = calloc(def.ds_num, sizeof(*s.ds_types)),
+    };
+    ptr += def.name_len;
+    if ((s.name == NULL) || (s.ds_names == NULL) || (s.ds_types == NULL)) {
+      segment_series_free(&s);
+      return ENOMEM;
+    }
+
+    for (size_t i = 0; i < s.values_num; i++) {
+      if (end - ptr < 2) {
+        segment_series_free(&s);
+        return EILSEQ;
+      }
+      s.ds_types[i] = (uint8_t)ptr[0];
+      size_t len = (uint8_t)ptr[1];
+      ptr += 2;
+      if ((size_t)(end - ptr) < len) {
+        segment_series_free(&s);
+        return EILSEQ;
+      }
+      s.ds_names[i] = strndup(ptr, len);
+      ptr += len;
+      if (s.ds_names[i] == NULL) {
+        segment_series_free(&s);
+        return ENOMEM;
+      }
+    }
+
+    r->series[r->series_num++] = s;
+  }
+
+  return (ptr == end) ? 0 : EILSEQ;
+} /* int segment_defs_parse */
+
+segment_writer_t *segment_writer_open(char const *path) {
+  segment_writer_t *w = calloc(1, sizeof(*w));
+  if (w == NULL)
+    return NULL;
+
+  w->by_name = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (w->by_name == NULL) {
+    free(w);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  w->fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (w->fd < 0) {
+    int status = errno;
+    c_avl_destroy(w->by_name);
+    free(w);
+    errno = status;
+    return NULL;
+  }
+
+  int status = segment_write(w->fd, SEGMENT_MAGIC, SEGMENT_MAGIC_SIZE);
+  if (status != 0) {
+    close(w->fd);
+    unlink(path);
+    c_avl_destroy(w->by_name);
+    free(w);
+    errno = status;
+    return NULL;
+  }
+  w->offset = SEGMENT_MAGIC_SIZE;
+
+  return w;
+} /* segment_writer_t *segment_writer_open */
+
+/* Returns the series `name', adding it if necessary. */
+static segment_wseries_t *segment_writer_series(segment_writer_t *w,
+                                                char const *name,
+                                                data_set_t const *ds) {
+  segment_wseries_t *ws = NULL;
+  if (c_avl_get(w->by_name, name, (void *)&ws) == 0)
+    return ws;
+
+  if ((ds->ds_num == 0) || (ds->ds_num > UINT16_MAX) ||
+      (strlen(name) > UINT16_MAX) || (w->series_num >= UINT32_MAX)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (segment_grow((void **)&w->series, &w->series_size, w->series_num,
+                   sizeof(*w->series)) != 0) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  ws = calloc(1, sizeof(*ws));
+  if (ws == NULL)
+    return NULL;
+  ws->id = (uint32_t)w->series_num;
+  ws->series = (segment_series_t){
+      .name = strdup(name),
+      .values_num = ds->ds_num,
+      .ds_names = calloc(ds->ds_num, sizeof(*ws->series.ds_names)),
+      .ds_types = calloc(ds->ds_num, sizeof(*ws->series.ds_types)),
+  };
+
+  bool ok = (ws->series.name != NULL) && (ws->series.ds_names != NULL) &&
+            (ws->series.ds_types != NULL);
+  for (size_t i = 0; ok && (i < ds->ds_num); i++) {
+    ws->series.ds_names[i] = strdup(ds->ds[i].name);
+    ws->series.ds_types[i] = ds->ds[i].type;
+    ok = (ws->series.ds_names[i] != NULL);
+  }
+  if (!ok || (c_avl_insert(w->by_name, ws->series.name, ws) != 0)) {
+    segment_series_free(&ws->series);
+    free(ws);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  w->series[w->series_num++] = ws;
+  return ws;
+} /* segment_wseries_t *segment_writer_series */
+
+int segment_writer_append(segment_writer_t *w, char const *name,
+                          data_set_t const *ds, cdtime_t time,
+                          gauge_t const *values) {
+  if ((w == NULL) || (name == NULL) || (ds == NULL) || (values == NULL))
+    return EINVAL;
+
+  segment_wseries_t *ws = segment_writer_series(w, name, ds);
+  if (ws == NULL)
+    return errno;
+  if (ws->series.values_num != ds->ds_num)
+    return EINVAL;
+
+  int64_t ms = (int64_t)CDTIME_T_TO_MS(time);
+  if (ws->have_last && (ms <= ws->last_ms))
+    return ERANGE;
+  if ((ws->points > 0) && (ms - ws->last_ms > SEGMENT_MAX_GAP_MS))
+    return ERANGE;
+
+  if (ws->points == 0) {
+    if (segment_grow((void **)&w->pending, &w->pending_size, w->pending_num,
+                     sizeof(*w->pending)) != 0)
+      return ENOMEM;
+  }
+  if (ws->points >= ws->size) {
+    size_t size = (ws->size > 0) ? 2 * ws->size : 4;
+    cdtime_t *times = realloc(ws->times, size * sizeof(*times));
+    if (times == NULL)
+      return ENOMEM;
+    ws->times = times;
+    gauge_t *v = realloc(ws->values, size * ds->ds_num * sizeof(*v));
+    if (v == NULL)
+      return ENOMEM;
+    ws->values = v;
+    ws->size = size;
+  }
+
+  if (ws->points == 0)
+    w->pending[w->pending_num++] = ws;
+  ws->times[ws->points] = time;
+  memcpy(ws->values + ws->points * ds->ds_num, values,
+         ds->ds_num * sizeof(*values));
+  ws->points++;
+  w->pending_points++;
+  ws->have_last = true;
+  ws->last_ms = ms;
+
+  return 0;
+} /* int segment_writer_append */
+
+size_t segment_writer_pending(segment_writer_t const *w) {
+  return (w != NULL) ? w->pending_points : 0;
+} /* size_t segment_writer_pending */
+
+static int segment_compare_id(void const *a, void const *b) {
+  segment_wseries_t const *sa = *(segment_wseries_t *const *)a;
+  segment_wseries_t const *sb = *(segment_wseries_t *const *)b;
+  return (sa->id > sb->id) - (sa->id < sb->id);
+} /* int segment_compare_id */
+
+/* Encodes the columns and lays out the block in a newly allocated buffer. */
+static int segment_block_encode(segment_writer_t *w, char **ret_buf,
+                                size_t *ret_size, segment_block_t *ret_hdr) {
+  size_t columns_num = w->pending_num;
+  segment_column_t *columns = calloc(columns_num, sizeof(*columns));
+  uint8_t **data = calloc(columns_num, sizeof(*data));
+  if ((columns == NULL) || (data == NULL)) {
+    free(columns);
+    free(data);
+    return ENOMEM;
+  }
+
+  segment_block_t hdr = {
+      .magic = SEGMENT_BLOCK_MAGIC, .columns_num = (uint32_t)columns_num,
+  };
+  int status = 0;
+  for (size_t i = 0; i < columns_num; i++) {
+    segment_wseries_t *ws = w->pending[i];
+    size_t size = 0;
+    size_t points = 0;
+    status = c_tsz_encode(ws->series.values_num, ws->times, ws->values,
+                          ws->points, data + i, &size, &points);
+    if (status != 0)
+      break;
+    if (size > UINT32_MAX) {
+      status = EOVERFLOW;
+      break;
+    }
+
+    columns[i] = (segment_column_t){
+        .id = ws->id,
+        .points = (uint32_t)points,
+        .offset = hdr.data_size,
+        .size = (uint32_t)size,
+        .crc = crc32_buffer(data[i], size),
+    };
+    hdr.data_size += size;
+
+    if (!ws->defined) {
+      hdr.series_num++;
+      hdr.defs_size += segment_def_size(&ws->series);
+    }
+    cdtime_t first = ws->times[0];
+    cdtime_t last = ws->times[ws->points - 1];
+    if ((i == 0) || (first < hdr.first))
+      hdr.first = first;
+    if ((i == 0) || (last > hdr.last))
+      hdr.last = last;
+  }
+
+  size_t size = sizeof(hdr) + columns_num * sizeof(*columns) + hdr.defs_size +
+                hdr.data_size;
+  char *buf = (status == 0) ? malloc(size) : NULL;
+  if ((status == 0) && (buf == NULL))
+    status = ENOMEM;
+
+  if (status == 0) {
+    char *ptr = buf + sizeof(hdr);
+    memcpy(ptr, columns, columns_num * sizeof(*columns));
+    ptr += columns_num * sizeof(*columns);
+    for (size_t i = 0; i < columns_num; i++) {
+      segment_wseries_t *ws = w->pending[i];
+      if (!ws->defined)
+        ptr += segment_def_encode(&ws->series, ws->id, ptr);
+    }
+    hdr.crc = crc32_buffer((unsigned char *)buf + sizeof(hdr),
+                           (size_t)(ptr - buf) - sizeof(hdr));
+    memcpy(buf, &hdr, sizeof(hdr));
+    for (size_t i = 0; i < columns_num; i++) {
+      memcpy(ptr, data[i], columns[i].size);
+      ptr += columns[i].size;
+    }
+  }
+
+  for (size_t i = 0; i < columns_num; i++)
+    free(data[i]);
+  free(data);
+  free(columns);
+
+  if (status != 0)
+    return status;
+
+  *ret_buf = buf;
+  *ret_size = size;
+  *ret_hdr = hdr;
+  return 0;
+} /* int segment_block_encode */
+
+int segment_writer_flush(segment_writer_t *w) {
+  if (w == NULL)
+    return EINVAL;
+  if (w->pending_num == 0)
+    return 0;
+
+  if (segment_grow((void **)&w->blocks, &w->blocks_size, w->blocks_num,
+                   sizeof(*w->blocks)) != 0)
+    return ENOMEM;
+
+  qsort(w->pending, w->pending_num, sizeof(*w->pending), segment_compare_id);
+
+  char *buf = NULL;
+  size_t size = 0;
+  segment_block_t hdr;
+  int status = segment_block_encode(w, &buf, &size, &hdr);
+  if (status == 0) {
+    status = segment_write(w->fd, buf, size);
+    free(buf);
+  }
+
+  if (status == 0) {
+    w->blocks[w->blocks_num++] = (segment_index_entry_t){
+        .offset = w->offset, .first = hdr.first, .last = hdr.last,
+    };
+    w->offset += size;
+  } else if (status != ENOMEM) {
+    /* Don't leave a partial block behind, so that later blocks can still be
+     * found without the index. */
+    if (ftruncate(w->fd, (off_t)w->offset) != 0 ||
+        lseek(w->fd, (off_t)w->offset, SEEK_SET) < 0)
+      status = EIO;
+  }
+
+  /* The points are dropped even if they couldn't be written, so that a
+   * failing disk doesn't grow the memory without bounds. */
+  for (size_t i = 0; i < w->pending_num; i++) {
+    segment_wseries_t *ws = w->pending[i];
+    if (status == 0)
+      ws->defined = true;
+    ws->points = 0;
+  }
+  w->pending_num = 0;
+  w->pending_points = 0;
+
+  return status;
+} /* int segment_writer_flush */
+
+static int segment_write_index(segment_writer_t *w) {
+  segment_index_t idx = {
+      .magic = SEGMENT_INDEX_MAGIC,
+      .series_num = (uint32_t)w->series_num,
+      .blocks_num = (uint32_t)w->blocks_num,
+  };
+  for (size_t i = 0; i < w->series_num; i++)
+    idx.defs_size += segment_def_size(&w->series[i]->series);
+
+  size_t size = sizeof(idx) + idx.defs_size +
+                w->blocks_num * sizeof(*w->blocks) +
+                sizeof(segment_trailer_t);
+  char *buf = malloc(size);
+  if (buf == NULL)
+    return ENOMEM;
+
+  char *ptr = buf + sizeof(idx);
+  for (size_t i = 0; i < w->series_num; i++)
+    ptr += segment_def_encode(&w->series[i]->series, w->series[i]->id, ptr);
+  memcpy(ptr, w->blocks, w->blocks_num * sizeof(*w->blocks));
+  ptr += w->blocks_num * sizeof(*w->blocks);
+  idx.crc = crc32_buffer((unsigned char *)buf + sizeof(idx),
+                         (size_t)(ptr - buf) - sizeof(idx));
+  memcpy(buf, &idx, sizeof(idx));
+
+  segment_trailer_t trailer = {.index_offset = w->offset};
+  memcpy(trailer.magic, SEGMENT_TRAILER_MAGIC, sizeof(trailer.magic));
+  memcpy(ptr, &trailer, sizeof(trailer));
+
+  int status = segment_write(w->fd, buf, size);
+  free(buf);
+  return status;
+} /* int segment_write_index */
+
+int segment_writer_close(segment_writer_t *w) {
+  if (w == NULL)
+    return EINVAL;
+
+  int status = segment_writer_flush(w);
+  if (status == 0)
+    status = segment_write_index(w);
+  if ((status == 0) && (fsync(w->fd) != 0))
+    status = errno;
+  if ((close(w->fd) != 0) && (status == 0))
+    status = errno;
+
+  for (size_t i = 0; i < w->series_num; i++) {
+    segment_wseries_t *ws = w->series[i];
+    segment_series_free(&ws->series);
+    free(ws->times);
+    free(ws->values);
+    free(ws);
+  }
+  c_avl_destroy(w->by_name);
+  free(w->series);
+  free(w->pending);
+  free(w->blocks);
+  free(w);
+
+  return status;
+} /* int segment_writer_close */
+
+static void segment_reader_reset(segment_reader_t *r) {
+  for (size_t i = 0; i < r->series_num; i++)
+    segment_series_free(r->series + i);
+  r->series_num = 0;
+  r->blocks_num = 0;
+} /* void segment_reader_reset */
+
+/* Reads the series and blocks from the index. */
+static int segment_read_index(segment_reader_t *r) {
+  segment_trailer_t trailer;
+  if (r->file_size < SEGMENT_MAGIC_SIZE + sizeof(trailer))
+    return ENOENT;
+  int status = segment_pread(r->fd, &trailer, sizeof(trailer),
+                             r->file_size - sizeof(trailer));
+  if (status != 0)
+    return status;
+  if ((memcmp(trailer.magic, SEGMENT_TRAILER_MAGIC, sizeof(trailer.magic)) !=
+       0) ||
+      (trailer.index_offset < SEGMENT_MAGIC_SIZE) ||
+      (trailer.index_offset >
+       r->file_size - sizeof(trailer) - sizeof(segment_index_t)))
+    return ENOENT;
+
+  segment_index_t idx;
+  status = segment_pread(r->fd, &idx, sizeof(idx), trailer.index_offset);
+  if (status != 0)
+    return status;
+  uint64_t size = r->file_size - sizeof(trailer) - trailer.index_offset -
+                  sizeof(idx);
+  if ((idx.magic != SEGMENT_INDEX_MAGIC) || (idx.defs_size > size) ||
+      ((size - idx.defs_size) !=
+       (uint64_t)idx.blocks_num * sizeof(segment_index_entry_t)))
+    return EILSEQ;
+
+  char *buf = malloc(size + 1);
+  if (buf == NULL)
+    return ENOMEM;
+  status = segment_pread(r->fd, buf, size, trailer.index_offset + sizeof(idx));
+  if ((status == 0) && (crc32_buffer((unsigned char *)buf, size) != idx.crc))
+    status = EILSEQ;
+  if (status == 0)
+    status = segment_defs_parse(r, buf, idx.defs_size, idx.series_num);
+  if (status == 0) {
+    r->blocks = malloc((idx.blocks_num + 1) * sizeof(*r->blocks));
+    if (r->blocks == NULL)
+      status = ENOMEM;
+  }
+  if (status == 0) {
+    memcpy(r->blocks, buf + idx.defs_size,
+           idx.blocks_num * sizeof(*r->blocks));
+    r->blocks_num = idx.blocks_num;
+    r->blocks_size = idx.blocks_num + 1;
+  }
+
+  free(buf);
+  return status;
+} /* int segment_read_index */
+
+/* Reads the series and blocks from the blocks themselves, up to the first
+ * block that is incomplete. */
+static int segment_scan(segment_reader_t *r) {
+  uint64_t offset = SEGMENT_MAGIC_SIZE;
+
+  while (offset + sizeof(segment_block_t) <= r->file_size) {
+    segment_block_t hdr;
+    int status = segment_pread(r->fd, &hdr, sizeof(hdr), offset);
+    if (status != 0)
+      return status;
+    if (hdr.magic != SEGMENT_BLOCK_MAGIC)
+      break;
+
+    uint64_t meta_size =
+        (uint64_t)hdr.columns_num * sizeof(segment_column_t) + hdr.defs_size;
+    uint64_t avail = r->file_size - offset - sizeof(hdr);
+    if ((meta_size > avail) || (hdr.data_size > avail - meta_size))
+      break;
+
+    char *buf = malloc(meta_size + 1);
+    if (buf == NULL)
+      return ENOMEM;
+    status = segment_pread(r->fd, buf, meta_size, offset + sizeof(hdr));
+    if ((status == 0) &&
+        (crc32_buffer((unsigned char *)buf, meta_size) != hdr.crc))
+      status = EILSEQ;
+    if (status == 0)
+      status = segment_defs_parse(
+          r, buf + hdr.columns_num * sizeof(segment_column_t), hdr.defs_size,
+          hdr.series_num);
+    free(buf);
+    if (status == EILSEQ)
+      break;
+    else if (status != 0)
+      return status;
+
+    if (segment_grow((void **)&r->blocks, &r->blocks_size, r->blocks_num,
+                     sizeof(*r->blocks)) != 0)
+      return ENOMEM;
+    r->blocks[r->blocks_num++] = (segment_index_entry_t){
+        .offset = offset, .first = hdr.first, .last = hdr.last,
+    };
+    offset += sizeof(hdr) + meta_size + hdr.data_size;
+  }
+
+  return 0;
+} /* int segment_scan */
+
+segment_reader_t *segment_reader_open(char const *path) {
+  segment_reader_t *r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    return NULL;
+
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) {
+    free(r);
+    return NULL;
+  }
+
+  int status = 0;
+  struct stat st;
+  char magic[SEGMENT_MAGIC_SIZE];
+  if (fstat(r->fd, &st) != 0)
+    status = errno;
+  else if ((segment_pread(r->fd, magic, sizeof(magic), 0) != 0) ||
+           (memcmp(magic, SEGMENT_MAGIC, sizeof(magic)) != 0))
+    status = EILSEQ;
+
+  if (status == 0) {
+    r->file_size = (uint64_t)st.st_size;
+    status = segment_read_index(r);
+    if ((status != 0) && (status != ENOMEM)) {
+      segment_reader_reset(r);
+      status = segment_scan(r);
+    }
+  }
+
+  if (status != 0) {
+    segment_reader_close(r);
+    errno = status;
+    return NULL;
+  }
+
+  return r;
+} /* segment_reader_t *segment_reader_open */
+
+void segment_reader_close(segment_reader_t *r) {
+  if (r == NULL)
+    return;
+
+  segment_reader_reset(r);
+  close(r->fd);
+  free(r->series);
+  free(r->blocks);
+  free(r);
+} /* void segment_reader_close */
+
+size_t segment_reader_series_num(segment_reader_t const *r) {
+  return (r != NULL) ? r->series_num : 0;
+} /* size_t segment_reader_series_num */
+
+segment_series_t const *segment_reader_series(segment_reader_t const *r,
+                                              size_t id) {
+  if ((r == NULL) || (id >= r->series_num))
+    return NULL;
+  return r->series + id;
+} /* segment_series_t const *segment_reader_series */
+
+/* Looks up the column of series `id' in the block at `offset' with a binary
+ * search, reading one column at a time. Returns ENOENT if the series has no
+ * points in the block. */
+static int segment_find_column(segment_reader_t *r, uint64_t offset,
+                               uint32_t id, segment_column_t *ret_column,
+                               uint64_t *ret_data_offset) {
+  segment_block_t hdr;
+  int status = segment_pread(r->fd, &hdr, sizeof(hdr), offset);
+  if (status != 0)
+    return status;
+  if (hdr.magic != SEGMENT_BLOCK_MAGIC)
+    return EILSEQ;
+
+  uint64_t columns_offset = offset + sizeof(hdr);
+  size_t lo = 0;
+  size_t hi = hdr.columns_num;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    segment_column_t c;
+    status = segment_pread(r->fd, &c, sizeof(c),
+                           columns_offset + mid * sizeof(c));
+    if (status != 0)
+      return status;
+
+    if (c.id < id) {
+      lo = mid + 1;
+    } else if (c.id > id) {
+      hi = mid;
+    } else {
+      *ret_column = c;
+      *ret_data_offset = columns_offset +
+                         hdr.columns_num * sizeof(segment_column_t) +
+                         hdr.defs_size;
+      return 0;
+    }
+  }
+
+  return ENOENT;
+} /* int segment_find_column */
+
+int segment_reader_read(segment_reader_t *r, size_t id, cdtime_t start,
+                        cdtime_t end, cdtime_t **ret_times,
+                        gauge_t **ret_values, size_t *ret_num) {
+  if ((r == NULL) || (id >= r->series_num) || (ret_times == NULL) ||
+      (ret_values == NULL) || (ret_num == NULL))
+    return EINVAL;
+
+  size_t values_num = r->series[id].values_num;
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  size_t size = 0;
+  int status = 0;
+
+  for (size_t b = 0; (status == 0) && (b < r->blocks_num); b++) {
+    segment_index_entry_t const *e = r->blocks + b;
+    if ((e->last < start) || (e->first > end))
+      continue;
+
+    segment_column_t c;
+    uint64_t data_offset = 0;
+    status = segment_find_column(r, e->offset, (uint32_t)id, &c, &data_offset);
+    if (status == ENOENT) {
+      status = 0;
+      continue;
+    } else if (status != 0) {
+      break;
+    }
+
+    uint8_t *data = malloc((size_t)c.size + 1);
+    if (data == NULL) {
+      status = ENOMEM;
+      break;
+    }
+    status = segment_pread(r->fd, data, c.size, data_offset + c.offset);
+    if ((status == 0) && (crc32_buffer(data, c.size) != c.crc))
+      status = EILSEQ;
+
+    if ((status == 0) && (num + c.points > size)) {
+      size_t new_size = num + c.points;
+      cdtime_t *t = realloc(times, new_size * sizeof(*t));
+      if (t != NULL)
+        times = t;
+      gauge_t *v = realloc(values, new_size * values_num * sizeof(*v));
+      if (v != NULL)
+        values = v;
+      if ((t == NULL) || (v == NULL))
+        status = ENOMEM;
+      else
+        size = new_size;
+    }
+    if (status == 0)
+      status = c_tsz_decode(values_num, data, c.size, c.points, times + num,
+                            values + num * values_num);
+    free(data);
+    if (status == EINVAL)
+      status = EILSEQ;
+    if (status != 0)
+      break;
+
+    /* Only keep the points within the range. */
+    size_t base = num;
+    for (size_t i = base; i < base + c.points; i++) {
+      if ((times[i] < start) || (times[i] > end))
+        continue;
+      times[num] = times[i];
+      memmove(values + num * values_num, values + i * values_num,
+              values_num * sizeof(*values));
+      num++;
+    }
+  }
+
+  if ((status != 0) || (num == 0)) {
+    free(times);
+    free(values);
+    times = NULL;
+    values = NULL;
+    num = 0;
+  }
+
+  *ret_times = times;
+  *ret_values = values;
+  *ret_num = num;
+  return status;
+} /* int segment_reader_read */
@@ -0,0 +1,146 @@
+/**
+ * collectd - src/utils/segment/segment.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SEGMENT_H
+#define UTILS_SEGMENT_H 1
+
+#include "collectd.h"
+
+#include "plugin.h"
+
+/*
+ * Segment files
+ *
+ * A segment file holds the points of many series, written sequentially in
+ * blocks. A block holds the points added to all series since the block
+ * before it, one column per series, each compressed with c_tsz_encode() (see
+ * utils/tsz/tsz.h). Series are numbered in the order they are added to a
+ * file, and every block defines the series that appear in a file for the first
+ * time, so that a file whose index is missing, e.g. after a crash, can still
+ * be read. The index, written when the file is closed, defines all series
+ * again and lists the blocks with the range of their times. Integers are
+ * stored in the byte order of the host.
+ */
+
+typedef struct {
+  /* The identifier, "host/plugin[-instance]/type[-instance]". */
+  char *name;
+  size_t values_num;
+  /* The names and DS_TYPE_* types of the data sources. */
+  char **ds_names;
+  int *ds_types;
+} segment_series_t;
+
+struct segment_writer_s;
+typedef struct segment_writer_s segment_writer_t;
+
+struct segment_reader_s;
+typedef struct segment_reader_s segment_reader_t;
+
+/*
+ * NAME
+ *   segment_writer_open
+ *
+ * DESCRIPTION
+ *   Creates the segment file `path', which must not exist yet.
+ *
+ * RETURN VALUE
+ *   A segment_writer_t-pointer upon success or NULL upon failure, with errno
+ *   set.
+ */
+segment_writer_t *segment_writer_open(char const *path);
+
+/*
+ * NAME
+ *   segment_writer_append
+ *
+ * DESCRIPTION
+ *   Adds a point to the series `name', which is added to the file if it's
+ *   not part of it yet. The point is kept in memory until the next call to
+ *   `segment_writer_flush'.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise: EINVAL if the data set
+ *   doesn't match the one the series was added with and ERANGE if the point
+ *   is not later than the series' last point by at least a millisecond.
+ */
+int segment_writer_append(segment_writer_t *w, char const *name,
+                          data_set_t const *ds, cdtime_t time,
+                          gauge_t const *values);
+
+/* Writes the points kept in memory as one block. Returns zero upon success,
+ * an errno value otherwise. */
+int segment_writer_flush(segment_writer_t *w);
+
+/* Returns the number of points kept in memory. */
+size_t segment_writer_pending(segment_writer_t const *w);
+
+/* Flushes the points, writes the index and closes the file. Frees `w' even
+ * if writing fails. Returns zero upon success, an errno value otherwise. */
+int segment_writer_close(segment_writer_t *w);
+
+/*
+ * NAME
+ *   segment_reader_open
+ *
+ * DESCRIPTION
+ *   Opens the segment file `path' for reading. If the file has no index, its
+ *   blocks are read one after the other up to the first one that is
+ *   incomplete.
+ *
+ * RETURN VALUE
+ *   A segment_reader_t-pointer upon success or NULL upon failure, with errno
+ *   set: EILSEQ if the file is not a segment file.
+ */
+segment_reader_t *segment_reader_open(char const *path);
+
+void segment_reader_close(segment_reader_t *r);
+
+/* Returns the number of series in the file. */
+size_t segment_reader_series_num(segment_reader_t const *r);
+
+/* Returns the series with the number `id', which has to be less than the
+ * number of series. */
+segment_series_t const *segment_reader_series(segment_reader_t const *r,
+                                              size_t id);
+
+/*
+ * NAME
+ *   segment_reader_read
+ *
+ * DESCRIPTION
+ *   Reads the points of series `id' with a time within [start, end] into
+ *   newly allocated arrays, like c_tsz_read() does: one time per point in
+ *   `ret_times' and `values_num' values per point in `ret_values'. Both have
+ *   to be freed by the caller. Only the blocks whose times overlap with the
+ *   range are read.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise: EILSEQ if a column is
+ *   corrupt.
+ */
+int segment_reader_read(segment_reader_t *r, size_t id, cdtime_t start,
+                        cdtime_t end, cdtime_t **ret_times,
+                        gauge_t **ret_values, size_t *ret_num);
+
+#endif /* UTILS_SEGMENT_H */
@@ -0,0 +1,174 @@
+/**
+ * collectd - src/utils/segment/segment_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/segment/segment.h"
+
+#include <sys/stat.h>
+
+#define T(ms) MS_TO_CDTIME_T(1792000000000ull + (ms))
+
+static data_source_t dsrc_one[] = {{"value", DS_TYPE_GAUGE, NAN, NAN}};
+static data_set_t ds_one = {"gauge", 1, dsrc_one};
+
+static data_source_t dsrc_two[] = {{"rx", DS_TYPE_DERIVE, 0, NAN},
+                                   {"tx", DS_TYPE_DERIVE, 0, NAN}};
+static data_set_t ds_two = {"if_octets", 2, dsrc_two};
+
+static off_t file_size(char const *path) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return -1;
+  return st.st_size;
+}
+
+/* Appends points 0 to 9 of the first two series and, from point 5 on, of the
+ * third one. The file is flushed after the fifth point. */
+static int write_file(char const *path, off_t *ret_first_block) {
+  segment_writer_t *w;
+  CHECK_NOT_NULL(w = segment_writer_open(path));
+  EXPECT_EQ_PTR(NULL, segment_writer_open(path));
+
+  for (int i = 0; i < 10; i++) {
+    gauge_t one = (gauge_t)i;
+    gauge_t two[] = {(gauge_t)(100 * i), (gauge_t)(200 * i)};
+    CHECK_ZERO(segment_writer_append(w, "host/a/gauge", &ds_one,
+                                     T(10000 * i), &one));
+    CHECK_ZERO(segment_writer_append(w, "host/b/if_octets", &ds_two,
+                                     T(10000 * i + 1), two));
+    if (i >= 5)
+      CHECK_ZERO(segment_writer_append(w, "host/c/gauge", &ds_one,
+                                       T(10000 * i + 2), &one));
+    if (i == 4) {
+      EXPECT_EQ_UINT64(10, segment_writer_pending(w));
+      CHECK_ZERO(segment_writer_flush(w));
+      EXPECT_EQ_UINT64(0, segment_writer_pending(w));
+      *ret_first_block = file_size(path);
+    }
+  }
+
+  /* Points must be later than the last one and the data set must not
+   * change. */
+  gauge_t v = 0.0;
+  EXPECT_EQ_INT(ERANGE, segment_writer_append(w, "host/a/gauge", &ds_one,
+                                              T(90000), &v));
+  EXPECT_EQ_INT(EINVAL, segment_writer_append(w, "host/a/gauge", &ds_two,
+                                              T(100000), &v));
+
+  CHECK_ZERO(segment_writer_close(w));
+  return 0;
+}
+
+static int check_series(segment_reader_t *r, size_t id, char const *name,
+                        size_t values_num, size_t want_num) {
+  segment_series_t const *s;
+  s = segment_reader_series(r, id);
+  OK(s != NULL);
+  EXPECT_EQ_STR(name, s->name);
+  EXPECT_EQ_UINT64(values_num, s->values_num);
+
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  CHECK_ZERO(segment_reader_read(r, id, 0, UINT64_MAX, &times, &values, &num));
+  EXPECT_EQ_UINT64(want_num, num);
+  for (size_t i = 0; i < num; i++) {
+    size_t point = (id == 2) ? i + 5 : i;
+    EXPECT_EQ_UINT64(T(10000 * point + id), times[i]);
+    EXPECT_EQ_DOUBLE((id == 1) ? 100.0 * point : (gauge_t)point,
+                     values[i * values_num]);
+  }
+  free(times);
+  free(values);
+  return 0;
+}
+
+DEF_TEST(round_trip) {
+  char dir[] = "/tmp/collectd_segment_test.XXXXXX";
+  CHECK_NOT_NULL(mkdtemp(dir));
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/test.seg", dir);
+
+  off_t first_block = 0;
+  CHECK_ZERO(write_file(path, &first_block));
+
+  segment_reader_t *r;
+  CHECK_NOT_NULL(r = segment_reader_open(path));
+  EXPECT_EQ_UINT64(3, segment_reader_series_num(r));
+  CHECK_ZERO(check_series(r, 0, "host/a/gauge", 1, 10));
+  CHECK_ZERO(check_series(r, 1, "host/b/if_octets", 2, 10));
+  CHECK_ZERO(check_series(r, 2, "host/c/gauge", 1, 5));
+  EXPECT_EQ_STR("tx", segment_reader_series(r, 1)->ds_names[1]);
+  EXPECT_EQ_INT(DS_TYPE_DERIVE, segment_reader_series(r, 1)->ds_types[1]);
+  OK(segment_reader_series(r, 3) == NULL);
+
+  /* Reading a range. */
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  CHECK_ZERO(segment_reader_read(r, 1, T(30000), T(60001), &times, &values,
+                                 &num));
+  EXPECT_EQ_UINT64(4, num);
+  EXPECT_EQ_UINT64(T(30001), times[0]);
+  EXPECT_EQ_DOUBLE(1200.0, values[7]);
+  free(times);
+  free(values);
+
+  CHECK_ZERO(segment_reader_read(r, 2, 0, T(40000), &times, &values, &num));
+  EXPECT_EQ_UINT64(0, num);
+  EXPECT_EQ_PTR(NULL, times);
+  segment_reader_close(r);
+
+  /* Without the index, the blocks are read one after the other. */
+  CHECK_ZERO(truncate(path, file_size(path) - 1));
+  CHECK_NOT_NULL(r = segment_reader_open(path));
+  EXPECT_EQ_UINT64(3, segment_reader_series_num(r));
+  CHECK_ZERO(check_series(r, 2, "host/c/gauge", 1, 5));
+  segment_reader_close(r);
+
+  /* An incomplete block is ignored. */
+  CHECK_ZERO(truncate(path, first_block + 16));
+  CHECK_NOT_NULL(r = segment_reader_open(path));
+  EXPECT_EQ_UINT64(2, segment_reader_series_num(r));
+  CHECK_ZERO(check_series(r, 0, "host/a/gauge", 1, 5));
+  CHECK_ZERO(check_series(r, 1, "host/b/if_octets", 2, 5));
+  segment_reader_close(r);
+
+  /* Other files are rejected. */
+  FILE *fh;
+  CHECK_NOT_NULL(fh = fopen(path, "w"));
+  fputs("time,value\n", fh);
+  fclose(fh);
+  EXPECT_EQ_PTR(NULL, segment_reader_open(path));
+  EXPECT_EQ_INT(EILSEQ, errno);
+
+  unlink(path);
+  rmdir(dir);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(round_trip);
+
+  END_TEST;
+}
@@ -0,0 +1,189 @@
+/**
+ * collectd - src/utils/server_pool/server_pool.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/server_pool/server_pool.h"
+
+typedef struct {
+  char *name;
+  uint64_t seed;
+
+  /* Number of failures in a row, zero if the member is up. */
+  unsigned int failures;
+  cdtime_t retry;
+} server_pool_member_t;
+
+struct server_pool_s {
+  pthread_mutex_t lock;
+  cdtime_t retry_interval;
+
+  server_pool_member_t *members;
+  size_t members_num;
+};
+
+/* The finalizer of SplitMix64, which spreads the weights of all members over
+ * the whole range even if the identifier hashes are similar. */
+static uint64_t server_pool_mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+} /* uint64_t server_pool_mix */
+
+/* FNV-1a */
+static uint64_t server_pool_name_hash(char const *name) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char const *c = (unsigned char const *)name; *c != 0; c++) {
+    h ^= *c;
+    h *= 0x100000001b3ULL;
+  }
+  return server_pool_mix(h);
+} /* uint64_t server_pool_name_hash */
+
+server_pool_t *server_pool_create(cdtime_t retry_interval) {
+  server_pool_t *p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    return NULL;
+
+  p->retry_interval =
+      (retry_interval > 0) ? retry_interval : SERVER_POOL_RETRY_INTERVAL;
+  pthread_mutex_init(&p->lock, NULL);
+
+  return p;
+} /* server_pool_t *server_pool_create */
+
+void server_pool_destroy(server_pool_t *p) {
+  if (p == NULL)
+    return;
+
+  for (size_t i = 0; i < p->members_num; i++)
+    free(p->members[i].name);
+  free(p->members);
+  pthread_mutex_destroy(&p->lock);
+  free(p);
+} /* void server_pool_destroy */
+
+int server_pool_add(server_pool_t *p, char const *name) {
+  if ((p == NULL) || (name == NULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&p->lock);
+  for (size_t i = 0; i < p->members_num; i++) {
+    if (strcmp(p->members[i].name, name) == 0) {
+      pthread_mutex_unlock(&p->lock);
+      errno = EEXIST;
+      return -1;
+    }
+  }
+
+  server_pool_member_t *tmp =
+      realloc(p->members, (p->members_num + 1) * sizeof(*tmp));
+  if (tmp == NULL) {
+    pthread_mutex_unlock(&p->lock);
+    return -1;
+  }
+  p->members = tmp;
+
+  server_pool_member_t *m = p->members + p->members_num;
+  *m = (server_pool_member_t){
+      .name = strdup(name), .seed = server_pool_name_hash(name),
+  };
+  if (m->name == NULL) {
+    pthread_mutex_unlock(&p->lock);
+    return -1;
+  }
+
+  int index = (int)p->members_num;
+  p->members_num++;
+  pthread_mutex_unlock(&p->lock);
+
+  return index;
+} /* int server_pool_add */
+
+size_t server_pool_num(server_pool_t const *p) {
+  return (p != NULL) ? p->members_num : 0;
+} /* size_t server_pool_num */
+
+int server_pool_select(server_pool_t *p, uint64_t hash, cdtime_t now) {
+  if (p == NULL)
+    return -1;
+
+  int best = -1;
+  uint64_t best_weight = 0;
+
+  pthread_mutex_lock(&p->lock);
+  for (size_t i = 0; i < p->members_num; i++) {
+    server_pool_member_t const *m = p->members + i;
+    if ((m->failures > 0) && (now < m->retry))
+      continue;
+
+    uint64_t weight = server_pool_mix(hash ^ m->seed);
+    if ((best < 0) || (weight > best_weight)) {
+      best = (int)i;
+      best_weight = weight;
+    }
+  }
+  pthread_mutex_unlock(&p->lock);
+
+  return best;
+} /* int server_pool_select */
+
+void server_pool_report(server_pool_t *p, size_t index, bool ok,
+                        cdtime_t now) {
+  if ((p == NULL) || (index >= p->members_num))
+    return;
+
+  pthread_mutex_lock(&p->lock);
+  server_pool_member_t *m = p->members + index;
+  if (ok) {
+    m->failures = 0;
+  } else if ((m->failures == 0) || (now >= m->retry)) {
+    /* Failures of packets that were sent before the retry time, e.g. from a
+     * queue, don't extend it. */
+    unsigned int factor = 1;
+    for (unsigned int i = 0; (i < m->failures) &&
+                             (factor < SERVER_POOL_BACKOFF_MAX);
+         i++)
+      factor *= 2;
+
+    m->failures++;
+    m->retry = now + factor * p->retry_interval;
+  }
+  pthread_mutex_unlock(&p->lock);
+} /* void server_pool_report */
+
+bool server_pool_is_up(server_pool_t *p, size_t index) {
+  if ((p == NULL) || (index >= p->members_num))
+    return false;
+
+  pthread_mutex_lock(&p->lock);
+  bool up = (p->members[index].failures == 0);
+  pthread_mutex_unlock(&p->lock);
+
+  return up;
+} /* bool server_pool_is_up */
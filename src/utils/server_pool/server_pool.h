@@ -0,0 +1,106 @@
+/**
+ * collectd - src/utils/server_pool/server_pool.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SERVER_POOL_H
+#define UTILS_SERVER_POOL_H 1
+
+#include "plugin.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A server pool shards series among its members: each identifier hash is
+ * mapped to exactly one member with rendezvous hashing, i.e. to the member
+ * with the highest weight for this hash. The weights only depend on the hash
+ * and the member's name, so all senders with the same members agree on the
+ * mapping, regardless of the order the members were added in. If a member
+ * fails, only the series mapped to it move to other members, and they move
+ * back once it has recovered.
+ *
+ * Members are taken out of the pool when a send to them fails and are tried
+ * again after the retry interval, which doubles with every failure in a row
+ * up to `SERVER_POOL_BACKOFF_MAX' times the configured interval. All
+ * functions are thread-safe. */
+
+#define SERVER_POOL_RETRY_INTERVAL TIME_T_TO_CDTIME_T(10)
+#define SERVER_POOL_BACKOFF_MAX 16
+
+struct server_pool_s;
+typedef struct server_pool_s server_pool_t;
+
+/*
+ * NAME
+ *   server_pool_create
+ *
+ * DESCRIPTION
+ *   Creates an empty pool. A failed member is tried again after
+ *   `retry_interval', or after `SERVER_POOL_RETRY_INTERVAL' if it is zero.
+ *
+ * RETURN VALUE
+ *   A server_pool_t-pointer upon success or NULL upon failure.
+ */
+server_pool_t *server_pool_create(cdtime_t retry_interval);
+
+/* Frees the pool. Passing NULL is a no-op. */
+void server_pool_destroy(server_pool_t *p);
+
+/*
+ * NAME
+ *   server_pool_add
+ *
+ * DESCRIPTION
+ *   Adds a member. Its weights are derived from "name", e.g. "host:port",
+ *   which should therefore be the same on all senders.
+ *
+ * RETURN VALUE
+ *   The index of the member or -1 upon failure, with errno set. Adding a
+ *   name twice fails with EEXIST.
+ */
+int server_pool_add(server_pool_t *p, char const *name);
+
+/* Returns the number of members. */
+size_t server_pool_num(server_pool_t const *p);
+
+/*
+ * NAME
+ *   server_pool_select
+ *
+ * DESCRIPTION
+ *   Returns the member the series with the identifier hash "hash" is sent
+ *   to: the member with the highest weight among those that are up or due
+ *   for another try at "now".
+ *
+ * RETURN VALUE
+ *   The index of the member, or -1 if the pool is empty or all members are
+ *   down.
+ */
+int server_pool_select(server_pool_t *p, uint64_t hash, cdtime_t now);
+
+/* Reports whether sending to member "index" succeeded. A failure takes the
+ * member out of the pool until its retry time; a success puts it back. */
+void server_pool_report(server_pool_t *p, size_t index, bool ok, cdtime_t now);
+
+/* Returns whether member "index" is up, i.e. its last send succeeded. */
+bool server_pool_is_up(server_pool_t *p, size_t index);
+
+#endif /* UTILS_SERVER_POOL_H */
@@ -0,0 +1,167 @@
+/**
+ * collectd - src/utils/server_pool/server_pool_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/server_pool/server_pool.h"
+
+#define NUM_HASHES 10000
+
+static uint64_t test_hash(int i) {
+  /* Similar hashes, as a poor identifier hash would produce. */
+  return (uint64_t)i;
+}
+
+static server_pool_t *create_pool(int num) {
+  server_pool_t *p = server_pool_create(TIME_T_TO_CDTIME_T(10));
+  char name[32];
+
+  for (int i = 0; i < num; i++) {
+    snprintf(name, sizeof(name), "10.0.0.%d:25826", i + 1);
+    if (server_pool_add(p, name) != i)
+      return NULL;
+  }
+  return p;
+}
+
+DEF_TEST(add) {
+  server_pool_t *p;
+
+  CHECK_NOT_NULL(p = server_pool_create(0));
+  EXPECT_EQ_INT(-1, server_pool_select(p, 42, 0));
+  EXPECT_EQ_INT(0, server_pool_add(p, "a"));
+  EXPECT_EQ_INT(1, server_pool_add(p, "b"));
+  EXPECT_EQ_INT(-1, server_pool_add(p, "a"));
+  EXPECT_EQ_INT(EEXIST, errno);
+  EXPECT_EQ_UINT64(2, server_pool_num(p));
+  server_pool_destroy(p);
+
+  return 0;
+}
+
+DEF_TEST(balance) {
+  server_pool_t *p;
+  int counts[4] = {0};
+
+  CHECK_NOT_NULL(p = create_pool(4));
+  for (int i = 0; i < NUM_HASHES; i++) {
+    int m = server_pool_select(p, test_hash(i), 0);
+    CHECK_ZERO(m < 0);
+    counts[m]++;
+  }
+
+  /* Each member gets roughly a quarter. */
+  for (int i = 0; i < 4; i++) {
+    OK(counts[i] > NUM_HASHES / 5);
+    OK(counts[i] < NUM_HASHES / 3);
+  }
+  server_pool_destroy(p);
+
+  return 0;
+}
+
+DEF_TEST(order) {
+  server_pool_t *p;
+  server_pool_t *q;
+
+  /* The mapping doesn't depend on the order the members were added in. */
+  CHECK_NOT_NULL(p = server_pool_create(0));
+  CHECK_NOT_NULL(q = server_pool_create(0));
+  char const *names[] = {"a:1", "b:1", "c:1"};
+  for (int i = 0; i < 3; i++) {
+    server_pool_add(p, names[i]);
+    server_pool_add(q, names[2 - i]);
+  }
+
+  for (int i = 0; i < NUM_HASHES; i++)
+    EXPECT_EQ_INT(server_pool_select(p, test_hash(i), 0),
+                  2 - server_pool_select(q, test_hash(i), 0));
+
+  server_pool_destroy(p);
+  server_pool_destroy(q);
+  return 0;
+}
+
+DEF_TEST(failover) {
+  server_pool_t *p;
+  int before[NUM_HASHES];
+  cdtime_t now = TIME_T_TO_CDTIME_T(1000);
+
+  CHECK_NOT_NULL(p = create_pool(4));
+  for (int i = 0; i < NUM_HASHES; i++)
+    before[i] = server_pool_select(p, test_hash(i), now);
+
+  /* Only the series of the failed member move. */
+  server_pool_report(p, 2, false, now);
+  EXPECT_EQ_INT(0, server_pool_is_up(p, 2));
+  for (int i = 0; i < NUM_HASHES; i++) {
+    int m = server_pool_select(p, test_hash(i), now);
+    if (before[i] == 2)
+      OK(m != 2);
+    else
+      EXPECT_EQ_INT(before[i], m);
+  }
+
+  /* The member is tried again after the retry interval. A failure before
+   * that doesn't extend it. */
+  server_pool_report(p, 2, false, now + TIME_T_TO_CDTIME_T(5));
+  for (int i = 0; i < NUM_HASHES; i++)
+    EXPECT_EQ_INT(before[i],
+                  server_pool_select(p, test_hash(i),
+                                     now + TIME_T_TO_CDTIME_T(10)));
+
+  /* Another failure doubles the interval. */
+  now += TIME_T_TO_CDTIME_T(10);
+  server_pool_report(p, 2, false, now);
+  for (int i = 0; i < NUM_HASHES; i++)
+    if (before[i] == 2) {
+      OK(server_pool_select(p, test_hash(i), now + TIME_T_TO_CDTIME_T(19)) !=
+         2);
+      EXPECT_EQ_INT(2, server_pool_select(p, test_hash(i),
+                                          now + TIME_T_TO_CDTIME_T(20)));
+    }
+
+  /* A success puts the member back right away. */
+  server_pool_report(p, 2, true, now);
+  OK(server_pool_is_up(p, 2));
+  for (int i = 0; i < NUM_HASHES; i++)
+    EXPECT_EQ_INT(before[i], server_pool_select(p, test_hash(i), now));
+
+  /* Without any member up, nothing is selected. */
+  for (size_t i = 0; i < 4; i++)
+    server_pool_report(p, i, false, now);
+  EXPECT_EQ_INT(-1, server_pool_select(p, 42, now));
+
+  server_pool_destroy(p);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(add);
+  RUN_TEST(balance);
+  RUN_TEST(order);
+  RUN_TEST(failover);
+
+  END_TEST;
+}
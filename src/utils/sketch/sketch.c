@@ -0,0 +1,228 @@
+/**
+ * collectd - src/utils/sketch/sketch.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/sketch/sketch.h"
+
+#include <math.h>
+
+struct c_hll_s {
+  unsigned int precision;
+  size_t registers_num;
+  uint8_t registers[];
+};
+
+struct c_topk_s {
+  c_topk_entry_t *entries;
+  size_t entries_num;
+  size_t k;
+  uint64_t total;
+};
+
+/* The finalizer of SplitMix64. The identifier hashes are FNV-1a, whose high
+ * bits, which select the register, are poorly distributed for short keys. */
+static uint64_t mix(uint64_t h) {
+  h ^= h >> 30;
+  h *= UINT64_C(0xbf58476d1ce4e5b9);
+  h ^= h >> 27;
+  h *= UINT64_C(0x94d049bb133111eb);
+  h ^= h >> 31;
+  return h;
+} /* uint64_t mix */
+
+c_hll_t *c_hll_create(unsigned int precision) /* {{{ */
+{
+  if ((precision < C_HLL_PRECISION_MIN) || (precision > C_HLL_PRECISION_MAX))
+    return NULL;
+
+  size_t registers_num = ((size_t)1) << precision;
+  c_hll_t *h = calloc(1, sizeof(*h) + registers_num);
+  if (h == NULL)
+    return NULL;
+
+  h->precision = precision;
+  h->registers_num = registers_num;
+  return h;
+} /* }}} c_hll_t *c_hll_create */
+
+void c_hll_destroy(c_hll_t *h) { free(h); }
+
+void c_hll_add(c_hll_t *h, uint64_t hash) /* {{{ */
+{
+  hash = mix(hash);
+
+  size_t idx = (size_t)(hash >> (64 - h->precision));
+  /* The position of the first set bit among the remaining ones. The added bit
+   * bounds the rank for hashes whose remaining bits are all zero. */
+  uint64_t w = (hash << h->precision) | (UINT64_C(1) << (h->precision - 1));
+  uint8_t rank = 1;
+  while ((w & (UINT64_C(1) << 63)) == 0) {
+    w <<= 1;
+    rank++;
+  }
+
+  if (h->registers[idx] < rank)
+    h->registers[idx] = rank;
+} /* }}} void c_hll_add */
+
+double c_hll_estimate(c_hll_t const *h) /* {{{ */
+{
+  double m = (double)h->registers_num;
+  double sum = 0.0;
+  size_t zeros = 0;
+
+  for (size_t i = 0; i < h->registers_num; i++) {
+    sum += ldexp(1.0, -(int)h->registers[i]);
+    if (h->registers[i] == 0)
+      zeros++;
+  }
+
+  double alpha;
+  if (h->registers_num == 16)
+    alpha = 0.673;
+  else if (h->registers_num == 32)
+    alpha = 0.697;
+  else if (h->registers_num == 64)
+    alpha = 0.709;
+  else
+    alpha = 0.7213 / (1.0 + 1.079 / m);
+
+  double estimate = alpha * m * m / sum;
+
+  /* Linear counting is more accurate for small cardinalities. */
+  if ((estimate <= 2.5 * m) && (zeros > 0))
+    estimate = m * log(m / (double)zeros);
+
+  return estimate;
+} /* }}} double c_hll_estimate */
+
+void c_hll_clear(c_hll_t *h) {
+  memset(h->registers, 0, h->registers_num);
+}
+
+int c_hll_merge(c_hll_t *dst, c_hll_t const *src) /* {{{ */
+{
+  if (dst->precision != src->precision)
+    return EINVAL;
+
+  for (size_t i = 0; i < dst->registers_num; i++)
+    if (dst->registers[i] < src->registers[i])
+      dst->registers[i] = src->registers[i];
+
+  return 0;
+} /* }}} int c_hll_merge */
+
+c_topk_t *c_topk_create(size_t k) /* {{{ */
+{
+  if (k == 0)
+    return NULL;
+
+  c_topk_t *t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    return NULL;
+
+  t->entries = calloc(k, sizeof(*t->entries));
+  if (t->entries == NULL) {
+    free(t);
+    return NULL;
+  }
+  t->k = k;
+
+  return t;
+} /* }}} c_topk_t *c_topk_create */
+
+void c_topk_destroy(c_topk_t *t) /* {{{ */
+{
+  if (t == NULL)
+    return;
+
+  c_topk_clear(t);
+  free(t->entries);
+  free(t);
+} /* }}} void c_topk_destroy */
+
+int c_topk_add(c_topk_t *t, char const *key) /* {{{ */
+{
+  size_t min = 0;
+  for (size_t i = 0; i < t->entries_num; i++) {
+    if (strcmp(t->entries[i].key, key) == 0) {
+      t->entries[i].count++;
+      t->total++;
+      return 0;
+    }
+    if (t->entries[i].count < t->entries[min].count)
+      min = i;
+  }
+
+  char *copy = strdup(key);
+  if (copy == NULL)
+    return ENOMEM;
+
+  c_topk_entry_t *e;
+  uint64_t error = 0;
+  if (t->entries_num < t->k) {
+    e = t->entries + t->entries_num;
+    t->entries_num++;
+  } else {
+    /* The new key may have occurred as often as the key it replaces. */
+    e = t->entries + min;
+    error = e->count;
+    free(e->key);
+  }
+
+  e->key = copy;
+  e->count = error + 1;
+  e->error = error;
+  t->total++;
+
+  return 0;
+} /* }}} int c_topk_add */
+
+static int topk_compare(void const *a, void const *b) /* {{{ */
+{
+  c_topk_entry_t const *ea = a;
+  c_topk_entry_t const *eb = b;
+
+  if (ea->count != eb->count)
+    return (ea->count > eb->count) ? -1 : 1;
+  return strcmp(ea->key, eb->key);
+} /* }}} int topk_compare */
+
+c_topk_entry_t const *c_topk_get(c_topk_t *t, size_t *ret_num) /* {{{ */
+{
+  qsort(t->entries, t->entries_num, sizeof(*t->entries), topk_compare);
+  *ret_num = t->entries_num;
+  return t->entries;
+} /* }}} c_topk_entry_t const *c_topk_get */
+
+uint64_t c_topk_total(c_topk_t const *t) { return t->total; }
+
+void c_topk_clear(c_topk_t *t) /* {{{ */
+{
+  for (size_t i = 0; i < t->entries_num; i++)
+    free(t->entries[i].key);
+  memset(t->entries, 0, t->k * sizeof(*t->entries));
+  t->entries_num = 0;
+  t->total = 0;
+} /* }}} void c_topk_clear */
@@ -0,0 +1,90 @@
+/**
+ * collectd - src/utils/sketch/sketch.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SKETCH_H
+#define UTILS_SKETCH_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * HyperLogLog
+ *
+ * Estimates the number of distinct elements added to it, using 2^precision
+ * bytes of memory no matter how many elements there are. The standard error
+ * is about 1.04 / sqrt(2^precision), i.e. 3% with a precision of 10. Elements
+ * are added by their 64 bit hash; the hash doesn't need to be well mixed.
+ */
+struct c_hll_s;
+typedef struct c_hll_s c_hll_t;
+
+#define C_HLL_PRECISION_MIN 4
+#define C_HLL_PRECISION_MAX 16
+
+/* Returns NULL upon failure or if `precision' is out of range. */
+c_hll_t *c_hll_create(unsigned int precision);
+void c_hll_destroy(c_hll_t *h);
+
+void c_hll_add(c_hll_t *h, uint64_t hash);
+double c_hll_estimate(c_hll_t const *h);
+void c_hll_clear(c_hll_t *h);
+
+/* Merges the registers of `src' into `dst', which then estimates the number
+ * of distinct elements added to either of them. Returns EINVAL if the
+ * precisions differ. */
+int c_hll_merge(c_hll_t *dst, c_hll_t const *src);
+
+/*
+ * Top-K
+ *
+ * Finds the most frequent keys with the Space-Saving algorithm: `k' counters
+ * are kept, and a key without a counter takes over the one with the smallest
+ * count. A key that has been added more often than total / k times is
+ * guaranteed to have a counter, and its count overestimates the true count
+ * by at most `error'.
+ */
+struct c_topk_s;
+typedef struct c_topk_s c_topk_t;
+
+typedef struct {
+  char *key;
+  uint64_t count;
+  uint64_t error;
+} c_topk_entry_t;
+
+c_topk_t *c_topk_create(size_t k);
+void c_topk_destroy(c_topk_t *t);
+
+/* Counts one occurrence of `key'. Returns zero upon success. */
+int c_topk_add(c_topk_t *t, char const *key);
+
+/* Sorts the entries by descending count and returns them. The array is owned
+ * by `t' and valid until the next call to any other c_topk function. */
+c_topk_entry_t const *c_topk_get(c_topk_t *t, size_t *ret_num);
+
+/* Returns the number of occurrences counted since the last clear. */
+uint64_t c_topk_total(c_topk_t const *t);
+
+void c_topk_clear(c_topk_t *t);
+
+#endif /* UTILS_SKETCH_H */
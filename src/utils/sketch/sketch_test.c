@@ -0,0 +1,163 @@
+/**
+ * collectd - src/utils/sketch/sketch_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/sketch/sketch.h"
+
+/* The hash of identifiers, see ident_hash(). */
+static uint64_t fnv1a(char const *s) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (; *s != 0; s++) {
+    hash ^= (uint8_t)*s;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void add_names(c_hll_t *h, int first, int num) {
+  char name[64];
+  for (int i = first; i < first + num; i++) {
+    snprintf(name, sizeof(name), "localhost/tail-foo/counter-line%d", i);
+    c_hll_add(h, fnv1a(name));
+  }
+}
+
+DEF_TEST(hll) {
+  c_hll_t *h;
+
+  OK(c_hll_create(C_HLL_PRECISION_MIN - 1) == NULL);
+  OK(c_hll_create(C_HLL_PRECISION_MAX + 1) == NULL);
+
+  CHECK_NOT_NULL(h = c_hll_create(10));
+  EXPECT_EQ_DOUBLE(0.0, c_hll_estimate(h));
+
+  add_names(h, 0, 100);
+  double estimate = c_hll_estimate(h);
+  OK1((estimate > 95.0) && (estimate < 105.0), "small cardinality");
+
+  /* Adding the same elements again doesn't change the estimate. */
+  add_names(h, 0, 100);
+  EXPECT_EQ_DOUBLE(estimate, c_hll_estimate(h));
+
+  add_names(h, 100, 99900);
+  estimate = c_hll_estimate(h);
+  /* Three times the standard error. */
+  OK1((estimate > 90000.0) && (estimate < 110000.0), "large cardinality");
+
+  c_hll_clear(h);
+  EXPECT_EQ_DOUBLE(0.0, c_hll_estimate(h));
+
+  c_hll_destroy(h);
+  return 0;
+}
+
+DEF_TEST(hll_merge) {
+  c_hll_t *a;
+  c_hll_t *b;
+  c_hll_t *c;
+
+  CHECK_NOT_NULL(a = c_hll_create(12));
+  CHECK_NOT_NULL(b = c_hll_create(12));
+  CHECK_NOT_NULL(c = c_hll_create(10));
+
+  /* Overlapping halves: 0 to 6000 and 4000 to 10000. */
+  add_names(a, 0, 6000);
+  add_names(b, 4000, 6000);
+  CHECK_ZERO(c_hll_merge(a, b));
+  double estimate = c_hll_estimate(a);
+  OK1((estimate > 9000.0) && (estimate < 11000.0), "union cardinality");
+
+  /* Merging is idempotent. */
+  CHECK_ZERO(c_hll_merge(a, b));
+  EXPECT_EQ_DOUBLE(estimate, c_hll_estimate(a));
+
+  EXPECT_EQ_INT(EINVAL, c_hll_merge(a, c));
+
+  c_hll_destroy(a);
+  c_hll_destroy(b);
+  c_hll_destroy(c);
+  return 0;
+}
+
+DEF_TEST(topk) {
+  c_topk_t *t;
+  char key[64];
+
+  OK(c_topk_create(0) == NULL);
+  CHECK_NOT_NULL(t = c_topk_create(8));
+
+  /* Two heavy hitters hidden among many keys that occur once. Both occur
+   * more often than total / k times. */
+  int failed = 0;
+  for (int i = 0; i < 3000; i++) {
+    if ((i % 3) == 0)
+      snprintf(key, sizeof(key), "heavy");
+    else if ((i % 6) == 1)
+      snprintf(key, sizeof(key), "medium");
+    else
+      snprintf(key, sizeof(key), "key%d", i);
+    if (c_topk_add(t, key) != 0)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_UINT64(3000, c_topk_total(t));
+
+  size_t num = 0;
+  c_topk_entry_t const *entries = c_topk_get(t, &num);
+  EXPECT_EQ_INT(8, (int)num);
+  EXPECT_EQ_STR("heavy", entries[0].key);
+  EXPECT_EQ_STR("medium", entries[1].key);
+  /* The counts are upper bounds that are off by at most the error. */
+  OK(entries[0].count >= 1000);
+  OK(entries[0].count - entries[0].error <= 1000);
+  OK(entries[1].count >= 500);
+  OK(entries[1].count - entries[1].error <= 500);
+
+  c_topk_clear(t);
+  entries = c_topk_get(t, &num);
+  EXPECT_EQ_INT(0, (int)num);
+  EXPECT_EQ_UINT64(0, c_topk_total(t));
+
+  CHECK_ZERO(c_topk_add(t, "b"));
+  CHECK_ZERO(c_topk_add(t, "a"));
+  CHECK_ZERO(c_topk_add(t, "b"));
+  entries = c_topk_get(t, &num);
+  EXPECT_EQ_INT(2, (int)num);
+  EXPECT_EQ_STR("b", entries[0].key);
+  EXPECT_EQ_UINT64(2, entries[0].count);
+  EXPECT_EQ_UINT64(0, entries[0].error);
+  EXPECT_EQ_STR("a", entries[1].key);
+
+  c_topk_destroy(t);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(hll);
+  RUN_TEST(hll_merge);
+  RUN_TEST(topk);
+
+  END_TEST;
+}
@@ -0,0 +1,286 @@
+/**
+ * collectd - src/utils/snappy/snappy.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/snappy/snappy.h"
+
+#define SNAPPY_BLOCK_SIZE 65536
+#define SNAPPY_HASH_BITS 14
+/* Blocks shorter than this are stored as a single literal. */
+#define SNAPPY_MIN_MATCH_BLOCK 16
+
+#define SNAPPY_TAG_LITERAL 0
+#define SNAPPY_TAG_COPY_1 1
+#define SNAPPY_TAG_COPY_2 2
+#define SNAPPY_TAG_COPY_4 3
+
+static uint32_t load32(uint8_t const *p) /* {{{ */
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+} /* }}} uint32_t load32 */
+
+static uint32_t snappy_hash(uint32_t v) /* {{{ */
+{
+  return (v * 0x1e35a7bd) >> (32 - SNAPPY_HASH_BITS);
+} /* }}} uint32_t snappy_hash */
+
+size_t snappy_max_compressed_length(size_t len) /* {{{ */
+{
+  /* The worst case is incompressible data, stored as literals with a tag of up
+   * to five bytes each, plus the varint with the length. */
+  return 32 + len + len / 6;
+} /* }}} size_t snappy_max_compressed_length */
+
+static uint8_t *emit_varint(uint8_t *out, size_t v) /* {{{ */
+{
+  while (v >= 0x80) {
+    *out++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *out++ = (uint8_t)v;
+  return out;
+} /* }}} uint8_t *emit_varint */
+
+static uint8_t *emit_literal(uint8_t *out, uint8_t const *data, /* {{{ */
+                             size_t len) {
+  size_t n = len - 1;
+
+  if (n < 60) {
+    *out++ = (uint8_t)((n << 2) | SNAPPY_TAG_LITERAL);
+  } else {
+    /* Tags 60 to 63 are followed by the length in one to four bytes. */
+    uint8_t *tag = out++;
+    size_t bytes = 0;
+    while (n > 0) {
+      *out++ = (uint8_t)n;
+      n >>= 8;
+      bytes++;
+    }
+    *tag = (uint8_t)(((59 + bytes) << 2) | SNAPPY_TAG_LITERAL);
+  }
+
+  memcpy(out, data, len);
+  return out + len;
+} /* }}} uint8_t *emit_literal */
+
+/* emit_copy_upto64 emits a back reference of 4 to 64 bytes. */
+static uint8_t *emit_copy_upto64(uint8_t *out, size_t offset, /* {{{ */
+                                 size_t len) {
+  if ((len < 12) && (offset < 2048)) {
+    *out++ = (uint8_t)(SNAPPY_TAG_COPY_1 | ((len - 4) << 2) |
+                       ((offset >> 8) << 5));
+    *out++ = (uint8_t)offset;
+  } else {
+    *out++ = (uint8_t)(SNAPPY_TAG_COPY_2 | ((len - 1) << 2));
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+  }
+  return out;
+} /* }}} uint8_t *emit_copy_upto64 */
+
+static uint8_t *emit_copy(uint8_t *out, size_t offset, size_t len) /* {{{ */
+{
+  /* Split long matches so that no piece is shorter than four bytes. */
+  while (len >= 68) {
+    out = emit_copy_upto64(out, offset, 64);
+    len -= 64;
+  }
+  if (len > 64) {
+    out = emit_copy_upto64(out, offset, 60);
+    len -= 60;
+  }
+  return emit_copy_upto64(out, offset, len);
+} /* }}} uint8_t *emit_copy */
+
+static uint8_t *compress_block(uint8_t const *in, size_t len, /* {{{ */
+                               uint8_t *out, uint16_t *table) {
+  if (len < SNAPPY_MIN_MATCH_BLOCK)
+    return emit_literal(out, in, len);
+
+  memset(table, 0, sizeof(*table) << SNAPPY_HASH_BITS);
+
+  size_t next_emit = 0;
+  size_t ip = 1;
+  /* Advance faster the longer no match has been found, so that
+   * incompressible data is skipped quickly. */
+  uint32_t skip = 32;
+
+  while (ip + 4 <= len) {
+    uint32_t v = load32(in + ip);
+    uint32_t h = snappy_hash(v);
+    size_t candidate = table[h];
+    table[h] = (uint16_t)ip;
+
+    if (load32(in + candidate) != v) {
+      ip += skip >> 5;
+      skip++;
+      continue;
+    }
+
+    if (ip > next_emit)
+      out = emit_literal(out, in + next_emit, ip - next_emit);
+
+    size_t match = 4;
+    while ((ip + match < len) && (in[candidate + match] == in[ip + match]))
+      match++;
+
+    out = emit_copy(out, ip - candidate, match);
+    ip += match;
+    next_emit = ip;
+    skip = 32;
+
+    /* Remember the position before the next one, so that runs are found. */
+    if (ip + 3 <= len)
+      table[snappy_hash(load32(in + ip - 1))] = (uint16_t)(ip - 1);
+  }
+
+  if (next_emit < len)
+    out = emit_literal(out, in + next_emit, len - next_emit);
+  return out;
+} /* }}} uint8_t *compress_block */
+
+size_t snappy_compress(void const *in, size_t len, void *out) /* {{{ */
+{
+  uint16_t table[1 << SNAPPY_HASH_BITS];
+  uint8_t const *ip = in;
+  uint8_t *op = emit_varint(out, len);
+
+  while (len > 0) {
+    size_t block = (len < SNAPPY_BLOCK_SIZE) ? len : SNAPPY_BLOCK_SIZE;
+    op = compress_block(ip, block, op, table);
+    ip += block;
+    len -= block;
+  }
+
+  return (size_t)(op - (uint8_t *)out);
+} /* }}} size_t snappy_compress */
+
+static int read_varint(uint8_t const **in, uint8_t const *end, /* {{{ */
+                       size_t *ret) {
+  uint64_t v = 0;
+
+  for (unsigned shift = 0; shift < 35; shift += 7) {
+    if (*in >= end)
+      return EINVAL;
+    uint8_t b = *(*in)++;
+    v |= ((uint64_t)(b & 0x7f)) << shift;
+    if ((b & 0x80) == 0) {
+      /* The length is limited to 32 bits by the format. */
+      if (v > UINT32_MAX)
+        return EINVAL;
+      *ret = (size_t)v;
+      return 0;
+    }
+  }
+  return EINVAL;
+} /* }}} int read_varint */
+
+int snappy_uncompressed_length(void const *in, size_t len, /* {{{ */
+                               size_t *ret) {
+  uint8_t const *ip = in;
+  return read_varint(&ip, ip + len, ret);
+} /* }}} int snappy_uncompressed_length */
+
+int snappy_uncompress(void const *in, size_t len, void *out, /* {{{ */
+                      size_t out_size) {
+  uint8_t const *ip = in;
+  uint8_t const *end = ip + len;
+  size_t want;
+
+  if (read_varint(&ip, end, &want) != 0)
+    return EINVAL;
+  if (want > out_size)
+    return EINVAL;
+
+  uint8_t *base = out;
+  uint8_t *op = base;
+  uint8_t *op_end = base + want;
+
+  while (ip < end) {
+    uint8_t tag = *ip++;
+    size_t n;
+    size_t offset;
+
+    switch (tag & 0x03) {
+    case SNAPPY_TAG_LITERAL:
+      n = tag >> 2;
+      if (n >= 60) {
+        size_t bytes = n - 59;
+        if ((size_t)(end - ip) < bytes)
+          return EINVAL;
+        n = 0;
+        for (size_t i = 0; i < bytes; i++)
+          n |= ((size_t)ip[i]) << (8 * i);
+        ip += bytes;
+      }
+      n++;
+      if (((size_t)(end - ip) < n) || ((size_t)(op_end - op) < n))
+        return EINVAL;
+      memcpy(op, ip, n);
+      ip += n;
+      op += n;
+      continue;
+
+    case SNAPPY_TAG_COPY_1:
+      if (end - ip < 1)
+        return EINVAL;
+      n = 4 + ((tag >> 2) & 0x07);
+      offset = (((size_t)(tag >> 5)) << 8) | ip[0];
+      ip += 1;
+      break;
+
+    case SNAPPY_TAG_COPY_2:
+      if (end - ip < 2)
+        return EINVAL;
+      n = 1 + (tag >> 2);
+      offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+      ip += 2;
+      break;
+
+    default: /* SNAPPY_TAG_COPY_4 */
+      if (end - ip < 4)
+        return EINVAL;
+      n = 1 + (tag >> 2);
+      offset = (size_t)ip[0] | ((size_t)ip[1] << 8) | ((size_t)ip[2] << 16) |
+               ((size_t)ip[3] << 24);
+      ip += 4;
+      break;
+    }
+
+    if ((offset == 0) || (offset > (size_t)(op - base)) ||
+        ((size_t)(op_end - op) < n))
+      return EINVAL;
+
+    /* The source and destination overlap if offset < n, which repeats the
+     * last offset bytes. Copy byte by byte so that this works. */
+    uint8_t const *src = op - offset;
+    for (size_t i = 0; i < n; i++)
+      op[i] = src[i];
+    op += n;
+  }
+
+  return (op == op_end) ? 0 : EINVAL;
+} /* }}} int snappy_uncompress */
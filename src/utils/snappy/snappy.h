@@ -0,0 +1,56 @@
+/**
+ * collectd - src/utils/snappy/snappy.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SNAPPY_H
+#define UTILS_SNAPPY_H 1
+
+#include "collectd.h"
+
+/*
+ * Snappy block format
+ *
+ * Compresses and uncompresses data in the raw (unframed) format of the Snappy
+ * library, as expected e.g. by Prometheus' remote write protocol: the
+ * uncompressed length as a varint, followed by literals and back references.
+ * The compressor matches four byte sequences found through a hash table,
+ * independently within blocks of 64 KiB, and trades compression ratio for
+ * speed like the reference implementation does.
+ */
+
+/* Returns the size of the buffer snappy_compress() needs for `len' bytes. */
+size_t snappy_max_compressed_length(size_t len);
+
+/* Compresses `len' bytes at `in' into `out', which has to hold
+ * snappy_max_compressed_length(len) bytes. Returns the compressed size. */
+size_t snappy_compress(void const *in, size_t len, void *out);
+
+/* Reads the uncompressed size of the compressed data at `in' into `ret'.
+ * Returns EINVAL if the data is malformed. */
+int snappy_uncompressed_length(void const *in, size_t len, size_t *ret);
+
+/* Uncompresses `len' bytes at `in' into `out', which has to hold at least
+ * the size returned by snappy_uncompressed_length(). Returns zero upon
+ * success and EINVAL if the data is malformed or `out' is too small. */
+int snappy_uncompress(void const *in, size_t len, void *out, size_t out_size);
+
+#endif /* UTILS_SNAPPY_H */
@@ -0,0 +1,139 @@
+/**
+ * collectd - src/utils/snappy/snappy_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/snappy/snappy.h"
+
+static int round_trip(uint8_t const *data, size_t len) /* {{{ */
+{
+  uint8_t *compressed = malloc(snappy_max_compressed_length(len));
+  CHECK_NOT_NULL(compressed);
+  uint8_t *uncompressed = malloc(len + 1);
+  CHECK_NOT_NULL(uncompressed);
+
+  size_t compressed_len = snappy_compress(data, len, compressed);
+  OK(compressed_len <= snappy_max_compressed_length(len));
+
+  size_t uncompressed_len = 0;
+  CHECK_ZERO(snappy_uncompressed_length(compressed, compressed_len,
+                                        &uncompressed_len));
+  EXPECT_EQ_UINT64(len, uncompressed_len);
+  CHECK_ZERO(
+      snappy_uncompress(compressed, compressed_len, uncompressed, len + 1));
+  OK(memcmp(data, uncompressed, len) == 0);
+
+  /* One byte short is an error, not an overflow. */
+  if (len > 0)
+    EXPECT_EQ_INT(EINVAL, snappy_uncompress(compressed, compressed_len,
+                                            uncompressed, len - 1));
+
+  free(compressed);
+  free(uncompressed);
+  return 0;
+} /* }}} int round_trip */
+
+DEF_TEST(round_trip) {
+  enum { N = 200000 };
+  static uint8_t data[N];
+
+  CHECK_ZERO(round_trip((uint8_t const *)"", 0));
+  CHECK_ZERO(round_trip((uint8_t const *)"a", 1));
+  CHECK_ZERO(round_trip((uint8_t const *)"abcabcabcabcabcabcabc", 21));
+
+  /* Repetitive data, as remote write requests are, spanning several blocks. */
+  char const *text = "collectd_cpu_total instance=\"host.example.com\" ";
+  for (size_t i = 0; i < N; i++)
+    data[i] = (uint8_t)text[i % strlen(text)];
+  CHECK_ZERO(round_trip(data, N));
+
+  static uint8_t compressed[2 * N];
+  OK(snappy_compress(data, N, compressed) < N / 10);
+
+  /* Incompressible data makes long literals. */
+  uint32_t seed = 1;
+  for (size_t i = 0; i < N; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint8_t)(seed >> 24);
+  }
+  CHECK_ZERO(round_trip(data, N));
+  CHECK_ZERO(round_trip(data, 61));
+  CHECK_ZERO(round_trip(data, 300));
+  CHECK_ZERO(round_trip(data, 70000));
+
+  /* A mix of both, with matches of every length. */
+  for (size_t i = 0; i < N; i++) {
+    seed = seed * 1103515245 + 12345;
+    if ((seed >> 28) < 4)
+      data[i] = (uint8_t)(seed >> 16);
+    else if (i >= 128)
+      data[i] = data[i - 1 - (seed >> 25)];
+  }
+  CHECK_ZERO(round_trip(data, N));
+
+  return 0;
+}
+
+DEF_TEST(uncompress) {
+  /* "abc" followed by a back reference of 7 bytes with an offset of 3, which
+   * overlaps the bytes it produces. */
+  uint8_t const valid[] = {10, 0x08, 'a', 'b', 'c', 0x0d, 0x03};
+  char out[16] = {0};
+
+  CHECK_ZERO(snappy_uncompress(valid, sizeof(valid), out, sizeof(out)));
+  EXPECT_EQ_STR("abcabcabca", out);
+
+  struct {
+    uint8_t data[8];
+    size_t len;
+  } malformed[] = {
+      /* Truncated literal. */
+      {{10, 0x08, 'a', 'b'}, 4},
+      /* Offset before the start. */
+      {{10, 0x08, 'a', 'b', 'c', 0x0d, 0x04}, 7},
+      /* Offset zero. */
+      {{10, 0x08, 'a', 'b', 'c', 0x0d, 0x00}, 7},
+      /* Less data than announced. */
+      {{11, 0x08, 'a', 'b', 'c', 0x0d, 0x03}, 7},
+      /* More data than announced. */
+      {{9, 0x08, 'a', 'b', 'c', 0x0d, 0x03}, 7},
+      /* Unterminated length. */
+      {{0x80, 0x80}, 2},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(malformed); i++) {
+    printf("## Case %" PRIsz "\n", i);
+    EXPECT_EQ_INT(EINVAL, snappy_uncompress(malformed[i].data,
+                                            malformed[i].len, out,
+                                            sizeof(out)));
+  }
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(round_trip);
+  RUN_TEST(uncompress);
+
+  END_TEST;
+}
@@ -0,0 +1,457 @@
+/**
+ * collectd - src/utils/spool/spool.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/crc32/crc32.h"
+#include "utils/spool/spool.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* A segment starts with SPOOL_MAGIC, followed by the records. Every record is
+ * a spool_record_t, followed by the data and padded to a multiple of eight
+ * bytes. The first record with a size of zero, or whose checksum doesn't
+ * match, ends the segment: segments are created filled with zeros, and a
+ * record that was being written during a crash is not complete. Segments are
+ * named after their sequence number, "<seq>.seg". The file "position" holds
+ * the sequence number and offset of the oldest record. */
+#define SPOOL_MAGIC "cdspool1"
+#define SPOOL_HEADER_SIZE 8
+#define SPOOL_POSITION_FILE "position"
+#define SPOOL_ALIGN(n) (((n) + 7) & ~((size_t)7))
+
+typedef struct {
+  uint32_t size;
+  uint32_t crc;
+} spool_record_t;
+
+typedef struct {
+  uint64_t seq;
+  uint64_t offset;
+} spool_position_t;
+
+struct spool_s {
+  pthread_mutex_t lock;
+  char *dir;
+  spool_options_t opts;
+
+  /* The segment records are read from, mapped once it exists. */
+  uint64_t read_seq;
+  size_t read_offset;
+  char *read_map;
+  /* Size of the record returned by spool_peek, including its padding. */
+  size_t peeked;
+
+  /* The segment records are appended to. Not opened until the first record
+   * is appended. Segments from before spool_open are never appended to. */
+  uint64_t write_seq;
+  size_t write_offset;
+  int write_fd;
+
+  int position_fd;
+  uint64_t records_num;
+};
+
+static void spool_segment_name(spool_t const *s, uint64_t seq, char *buffer,
+                               size_t buffer_size) {
+  snprintf(buffer, buffer_size, "%s/%020" PRIu64 ".seg", s->dir, seq);
+} /* void spool_segment_name */
+
+/* Returns the size of the record at `offset' of the mapped segment, including
+ * the padding, or zero if the segment ends there. */
+static size_t spool_record_at(spool_t const *s, char const *map,
+                              size_t offset) {
+  spool_record_t r;
+
+  if (s->opts.segment_size - offset < sizeof(r))
+    return 0;
+  memcpy(&r, map + offset, sizeof(r));
+
+  if ((r.size == 0) ||
+      (r.size > s->opts.segment_size - offset - sizeof(r)) ||
+      (crc32_buffer((unsigned char const *)map + offset + sizeof(r),
+                    r.size) != r.crc))
+    return 0;
+
+  return SPOOL_ALIGN(sizeof(r) + r.size);
+} /* size_t spool_record_at */
+
+static char *spool_map(spool_t const *s, uint64_t seq) {
+  char file[PATH_MAX];
+  spool_segment_name(s, seq, file, sizeof(file));
+
+  int fd = open(file, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  /* Segments written by a process with another segment size are not read. */
+  struct stat statbuf;
+  if ((fstat(fd, &statbuf) != 0) ||
+      ((size_t)statbuf.st_size != s->opts.segment_size)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  char *map = mmap(NULL, s->opts.segment_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  if (memcmp(map, SPOOL_MAGIC, SPOOL_HEADER_SIZE) != 0) {
+    munmap(map, s->opts.segment_size);
+    errno = EINVAL;
+    return NULL;
+  }
+  return map;
+} /* char *spool_map */
+
+static void spool_unmap(spool_t *s) {
+  if (s->read_map == NULL)
+    return;
+  munmap(s->read_map, s->opts.segment_size);
+  s->read_map = NULL;
+} /* void spool_unmap */
+
+static void spool_remove_segment(spool_t const *s, uint64_t seq) {
+  char file[PATH_MAX];
+  spool_segment_name(s, seq, file, sizeof(file));
+  unlink(file);
+} /* void spool_remove_segment */
+
+static void spool_write_position(spool_t *s) {
+  spool_position_t pos = {.seq = s->read_seq, .offset = s->read_offset};
+
+  if (s->position_fd < 0)
+    return;
+  if (pwrite(s->position_fd, &pos, sizeof(pos), 0) != (ssize_t)sizeof(pos))
+    return;
+  if (s->opts.sync == SPOOL_SYNC_ALWAYS)
+    fsync(s->position_fd);
+} /* void spool_write_position */
+
+/* Finds the first and last segment in the directory. Returns ENOENT if there
+ * are none. */
+static int spool_scan(spool_t const *s, uint64_t *ret_first,
+                      uint64_t *ret_last) {
+  DIR *dh = opendir(s->dir);
+  if (dh == NULL)
+    return errno;
+
+  bool found = false;
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    char *end = NULL;
+    uint64_t seq = (uint64_t)strtoull(de->d_name, &end, 10);
+    if ((end == de->d_name) || (strcmp(end, ".seg") != 0))
+      continue;
+
+    if (!found || (seq < *ret_first))
+      *ret_first = seq;
+    if (!found || (seq > *ret_last))
+      *ret_last = seq;
+    found = true;
+  }
+  closedir(dh);
+
+  return found ? 0 : ENOENT;
+} /* int spool_scan */
+
+/* Counts the records from the read position through segment `last'. */
+static uint64_t spool_count(spool_t const *s, uint64_t last) {
+  uint64_t num = 0;
+
+  for (uint64_t seq = s->read_seq; seq <= last; seq++) {
+    char *map = spool_map(s, seq);
+    if (map == NULL)
+      continue;
+
+    size_t offset = (seq == s->read_seq) ? s->read_offset : SPOOL_HEADER_SIZE;
+    size_t size;
+    while ((size = spool_record_at(s, map, offset)) != 0) {
+      num++;
+      offset += size;
+    }
+    munmap(map, s->opts.segment_size);
+  }
+
+  return num;
+} /* uint64_t spool_count */
+
+/* Restores the read position from the last run and removes the segments that
+ * have been consumed. */
+static void spool_recover(spool_t *s) {
+  uint64_t first = 0;
+  uint64_t last = 0;
+
+  if (spool_scan(s, &first, &last) != 0)
+    return;
+
+  spool_position_t pos = {0};
+  if ((pread(s->position_fd, &pos, sizeof(pos), 0) != (ssize_t)sizeof(pos)) ||
+      (pos.seq < first) || (pos.seq > last) ||
+      (pos.offset < SPOOL_HEADER_SIZE) ||
+      (pos.offset > s->opts.segment_size) || ((pos.offset % 8) != 0)) {
+    pos.seq = first;
+    pos.offset = SPOOL_HEADER_SIZE;
+  }
+
+  for (uint64_t seq = first; seq < pos.seq; seq++)
+    spool_remove_segment(s, seq);
+
+  s->read_seq = pos.seq;
+  s->read_offset = (size_t)pos.offset;
+  s->write_seq = last + 1;
+  s->records_num = spool_count(s, last);
+} /* void spool_recover */
+
+spool_t *spool_open(char const *dir, spool_options_t const *opts) {
+  if ((dir == NULL) || (opts == NULL) ||
+      (opts->segment_size < SPOOL_HEADER_SIZE + 2 * sizeof(spool_record_t))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((mkdir(dir, 0755) != 0) && (errno != EEXIST))
+    return NULL;
+
+  spool_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->dir = strdup(dir);
+  if (s->dir == NULL) {
+    free(s);
+    errno = ENOMEM;
+    return NULL;
+  }
+  s->opts = *opts;
+  s->opts.segment_size = SPOOL_ALIGN(s->opts.segment_size);
+  s->write_fd = -1;
+
+  char file[PATH_MAX];
+  snprintf(file, sizeof(file), "%s/" SPOOL_POSITION_FILE, dir);
+  s->position_fd = open(file, O_RDWR | O_CREAT, 0644);
+  if (s->position_fd < 0) {
+    int status = errno;
+    free(s->dir);
+    free(s);
+    errno = status;
+    return NULL;
+  }
+
+  s->read_seq = 1;
+  s->read_offset = SPOOL_HEADER_SIZE;
+  s->write_seq = 1;
+  spool_recover(s);
+  s->write_offset = SPOOL_HEADER_SIZE;
+  /* A position left behind with the last segments must not apply to the
+   * segments created from now on. */
+  spool_write_position(s);
+
+  pthread_mutex_init(&s->lock, NULL);
+  return s;
+} /* spool_t *spool_open */
+
+static void spool_close_segment(spool_t *s) {
+  if (s->write_fd < 0)
+    return;
+
+  if (s->opts.sync != SPOOL_SYNC_NONE)
+    fsync(s->write_fd);
+  close(s->write_fd);
+  s->write_fd = -1;
+} /* void spool_close_segment */
+
+void spool_close(spool_t *s) {
+  if (s == NULL)
+    return;
+
+  spool_close_segment(s);
+  spool_unmap(s);
+
+  if (s->records_num == 0) {
+    for (uint64_t seq = s->read_seq; seq <= s->write_seq; seq++)
+      spool_remove_segment(s, seq);
+    s->read_seq = s->write_seq + 1;
+    s->read_offset = SPOOL_HEADER_SIZE;
+  }
+  spool_write_position(s);
+  close(s->position_fd);
+
+  pthread_mutex_destroy(&s->lock);
+  free(s->dir);
+  free(s);
+} /* void spool_close */
+
+/* Creates segment `write_seq' and opens it for appending. */
+static int spool_create_segment(spool_t *s) {
+  char file[PATH_MAX];
+  spool_segment_name(s, s->write_seq, file, sizeof(file));
+
+  int fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return errno;
+
+  if ((ftruncate(fd, (off_t)s->opts.segment_size) != 0) ||
+      (pwrite(fd, SPOOL_MAGIC, SPOOL_HEADER_SIZE, 0) != SPOOL_HEADER_SIZE)) {
+    int status = errno ? errno : EIO;
+    close(fd);
+    unlink(file);
+    return status;
+  }
+
+  s->write_fd = fd;
+  s->write_offset = SPOOL_HEADER_SIZE;
+  return 0;
+} /* int spool_create_segment */
+
+int spool_append(spool_t *s, void const *data, size_t size) {
+  if ((s == NULL) || (data == NULL) || (size == 0))
+    return EINVAL;
+
+  size_t record_size = SPOOL_ALIGN(sizeof(spool_record_t) + size);
+  if ((size > UINT32_MAX) ||
+      (record_size > s->opts.segment_size - SPOOL_HEADER_SIZE))
+    return EMSGSIZE;
+
+  pthread_mutex_lock(&s->lock);
+
+  if ((s->write_fd >= 0) &&
+      (record_size > s->opts.segment_size - s->write_offset)) {
+    spool_close_segment(s);
+    s->write_seq++;
+  }
+
+  if (s->write_fd < 0) {
+    uint64_t segments_num = s->write_seq - s->read_seq + 1;
+    if ((s->opts.max_size != 0) &&
+        (segments_num * s->opts.segment_size > s->opts.max_size)) {
+      pthread_mutex_unlock(&s->lock);
+      return ENOSPC;
+    }
+
+    int status = spool_create_segment(s);
+    if (status != 0) {
+      pthread_mutex_unlock(&s->lock);
+      return status;
+    }
+  }
+
+  spool_record_t r = {
+      .size = (uint32_t)size, .crc = crc32_buffer(data, size),
+  };
+  off_t offset = (off_t)s->write_offset;
+  if ((pwrite(s->write_fd, &r, sizeof(r), offset) != (ssize_t)sizeof(r)) ||
+      (pwrite(s->write_fd, data, size, offset + (off_t)sizeof(r)) !=
+       (ssize_t)size)) {
+    int status = errno ? errno : EIO;
+    pthread_mutex_unlock(&s->lock);
+    return status;
+  }
+  if (s->opts.sync == SPOOL_SYNC_ALWAYS)
+    fsync(s->write_fd);
+
+  s->write_offset += record_size;
+  s->records_num++;
+
+  pthread_mutex_unlock(&s->lock);
+  return 0;
+} /* int spool_append */
+
+int spool_peek(spool_t *s, void const **ret_data, size_t *ret_size) {
+  if ((s == NULL) || (ret_data == NULL) || (ret_size == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&s->lock);
+
+  while (42) {
+    bool writing = (s->read_seq == s->write_seq);
+    if (writing && ((s->write_fd < 0) || (s->read_offset >= s->write_offset))) {
+      pthread_mutex_unlock(&s->lock);
+      return ENOENT;
+    }
+
+    if (s->read_map == NULL)
+      s->read_map = spool_map(s, s->read_seq);
+    if ((s->read_map == NULL) && writing) {
+      int status = errno ? errno : EIO;
+      pthread_mutex_unlock(&s->lock);
+      return status;
+    }
+
+    size_t size = 0;
+    if (s->read_map != NULL)
+      size = spool_record_at(s, s->read_map, s->read_offset);
+
+    if (size != 0) {
+      spool_record_t r;
+      memcpy(&r, s->read_map + s->read_offset, sizeof(r));
+      *ret_data = s->read_map + s->read_offset + sizeof(r);
+      *ret_size = r.size;
+      s->peeked = size;
+      pthread_mutex_unlock(&s->lock);
+      return 0;
+    }
+
+    if (writing) {
+      /* Only corrupted data can end the segment that is being written. */
+      s->read_offset = s->write_offset;
+      continue;
+    }
+
+    /* This segment has been read completely. */
+    spool_unmap(s);
+    spool_remove_segment(s, s->read_seq);
+    s->read_seq++;
+    s->read_offset = SPOOL_HEADER_SIZE;
+    spool_write_position(s);
+  }
+} /* int spool_peek */
+
+void spool_consume(spool_t *s) {
+  if (s == NULL)
+    return;
+
+  pthread_mutex_lock(&s->lock);
+  if (s->peeked != 0) {
+    s->read_offset += s->peeked;
+    s->peeked = 0;
+    if (s->records_num > 0)
+      s->records_num--;
+    spool_write_position(s);
+  }
+  pthread_mutex_unlock(&s->lock);
+} /* void spool_consume */
+
+uint64_t spool_records(spool_t *s) {
+  if (s == NULL)
+    return 0;
+
+  pthread_mutex_lock(&s->lock);
+  uint64_t num = s->records_num;
+  pthread_mutex_unlock(&s->lock);
+  return num;
+} /* uint64_t spool_records */
@@ -0,0 +1,130 @@
+/**
+ * collectd - src/utils/spool/spool.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SPOOL_H
+#define UTILS_SPOOL_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A queue of records on disk. Records are appended to segment files of a
+ * fixed size in a directory. The segments are created with their full size,
+ * so they can be mapped while they are being written, and the records are
+ * read straight from the mapping. A segment is removed once all of its
+ * records have been consumed. The position of the oldest unconsumed record is
+ * kept in the directory, too, so that the spool can be opened again after a
+ * restart. A record consumed right before a crash may be returned again. */
+
+struct spool_s;
+typedef struct spool_s spool_t;
+
+typedef enum {
+  /* Leave writing the data to the operating system. */
+  SPOOL_SYNC_NONE = 0,
+  /* Sync every segment when it is full and when the spool is closed. */
+  SPOOL_SYNC_SEGMENT,
+  /* Sync after every record. */
+  SPOOL_SYNC_ALWAYS,
+} spool_sync_t;
+
+typedef struct {
+  /* The size of the segments in bytes. Also the limit for the size of one
+   * record. */
+  size_t segment_size;
+  /* The maximum size of all segments in bytes, zero for no limit. */
+  uint64_t max_size;
+  spool_sync_t sync;
+} spool_options_t;
+
+/*
+ * NAME
+ *   spool_open
+ *
+ * DESCRIPTION
+ *   Opens the spool in the directory `dir', creating the directory if it
+ *   doesn't exist. Records left in it by a previous process are returned by
+ *   `spool_peek' before the new ones.
+ *
+ * RETURN VALUE
+ *   A spool_t-pointer upon success or NULL upon failure, with errno set.
+ */
+spool_t *spool_open(char const *dir, spool_options_t const *opts);
+
+/*
+ * NAME
+ *   spool_close
+ *
+ * DESCRIPTION
+ *   Closes the spool. Unconsumed records stay on disk; if there are none, the
+ *   segments are removed.
+ */
+void spool_close(spool_t *s);
+
+/*
+ * NAME
+ *   spool_append
+ *
+ * DESCRIPTION
+ *   Appends a copy of the `size' bytes at `data' to the spool.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise: ENOSPC if the spool would
+ *   exceed `max_size', EMSGSIZE if the record doesn't fit into a segment.
+ */
+int spool_append(spool_t *s, void const *data, size_t size);
+
+/*
+ * NAME
+ *   spool_peek
+ *
+ * DESCRIPTION
+ *   Returns the oldest record in `*ret_data' and its size in `*ret_size'
+ *   without removing it. The record may not be aligned. It stays valid until
+ *   the next call to `spool_consume' or `spool_close'. Only one thread may
+ *   consume records, but records may be appended concurrently.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOENT if the spool is empty, another errno value if
+ *   a segment can't be read.
+ */
+int spool_peek(spool_t *s, void const **ret_data, size_t *ret_size);
+
+/*
+ * NAME
+ *   spool_consume
+ *
+ * DESCRIPTION
+ *   Removes the record returned by the last call to `spool_peek'.
+ */
+void spool_consume(spool_t *s);
+
+/*
+ * NAME
+ *   spool_records
+ *
+ * DESCRIPTION
+ *   Returns the number of records in the spool.
+ */
+uint64_t spool_records(spool_t *s);
+
+#endif /* UTILS_SPOOL_H */
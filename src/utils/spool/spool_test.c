@@ -0,0 +1,213 @@
+/**
+ * collectd - src/utils/spool/spool_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/spool/spool.h"
+
+#include <dirent.h>
+
+/* Room for five records of "record-NNN" per segment. */
+static spool_options_t const opts = {
+    .segment_size = 8 + 5 * 24, .sync = SPOOL_SYNC_SEGMENT,
+};
+
+static char dir[] = "/tmp/collectd_spool_test.XXXXXX";
+
+static int count_segments(void) {
+  DIR *dh = opendir(dir);
+  if (dh == NULL)
+    return -1;
+
+  int num = 0;
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL)
+    if (strstr(de->d_name, ".seg") != NULL)
+      num++;
+  closedir(dh);
+  return num;
+}
+
+static int append(spool_t *s, int i) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "record-%03d", i);
+  return spool_append(s, buffer, strlen(buffer));
+}
+
+/* Returns the number of the oldest record and consumes it, or -1. */
+static int consume(spool_t *s) {
+  void const *data;
+  size_t size;
+
+  if (spool_peek(s, &data, &size) != 0)
+    return -1;
+
+  char buffer[16] = {0};
+  if (size >= sizeof(buffer))
+    return -1;
+  memcpy(buffer, data, size);
+  spool_consume(s);
+
+  if (strncmp(buffer, "record-", strlen("record-")) != 0)
+    return -1;
+  return atoi(buffer + strlen("record-"));
+}
+
+DEF_TEST(append_consume) {
+  spool_t *s;
+
+  CHECK_NOT_NULL(s = spool_open(dir, &opts));
+  EXPECT_EQ_INT(-1, consume(s));
+
+  for (int i = 0; i < 12; i++)
+    CHECK_ZERO(append(s, i));
+  EXPECT_EQ_UINT64(12, spool_records(s));
+  EXPECT_EQ_INT(3, count_segments());
+
+  /* Peeking twice returns the same record. */
+  void const *data;
+  size_t size;
+  CHECK_ZERO(spool_peek(s, &data, &size));
+  CHECK_ZERO(spool_peek(s, &data, &size));
+  EXPECT_EQ_UINT64(strlen("record-000"), size);
+
+  /* Reading and writing the same segment. */
+  int errors = 0;
+  int next = 12;
+  for (int i = 0; i < 12; i++) {
+    if (consume(s) != i)
+      errors++;
+    if ((i % 3) == 0)
+      CHECK_ZERO(append(s, next++));
+  }
+  for (int i = 12; i < next; i++)
+    if (consume(s) != i)
+      errors++;
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(-1, consume(s));
+  EXPECT_EQ_UINT64(0, spool_records(s));
+
+  /* Consumed segments are removed, all of them once the spool is closed. */
+  EXPECT_EQ_INT(1, count_segments());
+  spool_close(s);
+  EXPECT_EQ_INT(0, count_segments());
+
+  return 0;
+}
+
+DEF_TEST(reopen) {
+  spool_t *s;
+
+  CHECK_NOT_NULL(s = spool_open(dir, &opts));
+  for (int i = 0; i < 12; i++)
+    CHECK_ZERO(append(s, i));
+  for (int i = 0; i < 7; i++)
+    EXPECT_EQ_INT(i, consume(s));
+  spool_close(s);
+
+  /* New records go after the old ones. */
+  CHECK_NOT_NULL(s = spool_open(dir, &opts));
+  EXPECT_EQ_UINT64(5, spool_records(s));
+  CHECK_ZERO(append(s, 12));
+  for (int i = 7; i <= 12; i++)
+    EXPECT_EQ_INT(i, consume(s));
+  EXPECT_EQ_INT(-1, consume(s));
+  spool_close(s);
+  EXPECT_EQ_INT(0, count_segments());
+
+  return 0;
+}
+
+DEF_TEST(limits) {
+  spool_options_t limited = opts;
+  limited.max_size = 2 * opts.segment_size;
+  spool_t *s;
+
+  CHECK_NOT_NULL(s = spool_open(dir, &limited));
+  for (int i = 0; i < 10; i++)
+    CHECK_ZERO(append(s, i));
+  EXPECT_EQ_INT(ENOSPC, append(s, 10));
+
+  /* Consuming a segment makes room for another one. */
+  for (int i = 0; i < 6; i++)
+    EXPECT_EQ_INT(i, consume(s));
+  CHECK_ZERO(append(s, 10));
+
+  char big[256] = {0};
+  EXPECT_EQ_INT(EMSGSIZE, spool_append(s, big, sizeof(big)));
+
+  for (int i = 6; i <= 10; i++)
+    EXPECT_EQ_INT(i, consume(s));
+  spool_close(s);
+
+  return 0;
+}
+
+DEF_TEST(torn_record) {
+  spool_t *s;
+
+  CHECK_NOT_NULL(s = spool_open(dir, &opts));
+  for (int i = 0; i < 8; i++)
+    CHECK_ZERO(append(s, i));
+  spool_close(s);
+
+  /* Damage the data of the second record of the first segment, as if the
+   * process had crashed while writing it. */
+  char file[PATH_MAX];
+  snprintf(file, sizeof(file), "%s/%020d.seg", dir, 1);
+  int fd = open(file, O_WRONLY);
+  CHECK_NOT_NULL(fd >= 0 ? file : NULL);
+  EXPECT_EQ_INT(1, (int)pwrite(fd, "X", 1, 8 + 24 + 8));
+  close(fd);
+
+  /* The rest of the first segment is lost, the second one is not. */
+  CHECK_NOT_NULL(s = spool_open(dir, &opts));
+  EXPECT_EQ_UINT64(4, spool_records(s));
+  EXPECT_EQ_INT(0, consume(s));
+  for (int i = 5; i < 8; i++)
+    EXPECT_EQ_INT(i, consume(s));
+  EXPECT_EQ_INT(-1, consume(s));
+  spool_close(s);
+
+  return 0;
+}
+
+int main(void) {
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  RUN_TEST(append_consume);
+  RUN_TEST(reopen);
+  RUN_TEST(limits);
+  RUN_TEST(torn_record);
+
+  char file[PATH_MAX];
+  snprintf(file, sizeof(file), "%s/position", dir);
+  unlink(file);
+  rmdir(dir);
+
+  END_TEST;
+}
@@ -0,0 +1,334 @@
+/**
+ * collectd - src/utils/sysfs/sysfs.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/sysfs/sysfs.h"
+
+#if KERNEL_LINUX
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#endif
+
+/* Most attributes are a single number; the buffer grows for longer ones. */
+#define SYSFS_BUFFER_SIZE_INIT 32
+
+#define SYSFS_UEVENT_BUFFER_SIZE 8192
+
+/* The descriptors are kept open all the time, so don't leak them into
+ * programs started by the exec plugin. */
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+typedef struct {
+  int fd;
+  char *buffer;
+  size_t buffer_size;
+  size_t len;
+  bool ok;
+} sysfs_file_t;
+
+struct sysfs_set_s {
+  int dir_fd;
+  sysfs_file_t *files;
+  size_t files_num;
+};
+
+sysfs_set_t *sysfs_set_create(char const *dir) /* {{{ */
+{
+  sysfs_set_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (s->dir_fd < 0) {
+    int err = errno;
+    free(s);
+    errno = err;
+    return NULL;
+  }
+
+  return s;
+} /* }}} sysfs_set_t *sysfs_set_create */
+
+void sysfs_set_clear(sysfs_set_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  for (size_t i = 0; i < s->files_num; i++) {
+    close(s->files[i].fd);
+    free(s->files[i].buffer);
+  }
+  free(s->files);
+  s->files = NULL;
+  s->files_num = 0;
+} /* }}} void sysfs_set_clear */
+
+void sysfs_set_destroy(sysfs_set_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  sysfs_set_clear(s);
+  close(s->dir_fd);
+  free(s);
+} /* }}} void sysfs_set_destroy */
+
+int sysfs_set_add(sysfs_set_t *s, char const *path) /* {{{ */
+{
+  if ((s == NULL) || (path == NULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  sysfs_file_t f = {
+      .buffer_size = SYSFS_BUFFER_SIZE_INIT,
+  };
+
+  f.fd = openat(s->dir_fd, path, O_RDONLY | O_CLOEXEC);
+  if (f.fd < 0)
+    return -1;
+
+  f.buffer = malloc(f.buffer_size);
+  sysfs_file_t *tmp =
+      realloc(s->files, (s->files_num + 1) * sizeof(*s->files));
+  if ((f.buffer == NULL) || (tmp == NULL)) {
+    close(f.fd);
+    free(f.buffer);
+    if (tmp != NULL)
+      s->files = tmp;
+    errno = ENOMEM;
+    return -1;
+  }
+  f.buffer[0] = 0;
+  s->files = tmp;
+  s->files[s->files_num] = f;
+  s->files_num++;
+
+  return (int)(s->files_num - 1);
+} /* }}} int sysfs_set_add */
+
+size_t sysfs_set_num(sysfs_set_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->files_num : 0;
+} /* }}} size_t sysfs_set_num */
+
+static int sysfs_file_read(sysfs_file_t *f) /* {{{ */
+{
+  f->len = 0;
+  f->buffer[0] = 0;
+
+  while (42) {
+    /* Keep one byte for the terminating null byte. */
+    if ((f->buffer_size - f->len) < 2) {
+      char *tmp = realloc(f->buffer, 2 * f->buffer_size);
+      if (tmp == NULL)
+        return ENOMEM;
+      f->buffer = tmp;
+      f->buffer_size *= 2;
+    }
+
+    ssize_t status = pread(f->fd, f->buffer + f->len,
+                           f->buffer_size - f->len - 1, (off_t)f->len);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      int err = errno;
+      f->len = 0;
+      f->buffer[0] = 0;
+      return err;
+    } else if (status == 0) {
+      break;
+    }
+    f->len += (size_t)status;
+  }
+
+  f->buffer[f->len] = 0;
+  return 0;
+} /* }}} int sysfs_file_read */
+
+size_t sysfs_set_read(sysfs_set_t *s) /* {{{ */
+{
+  size_t failed = 0;
+
+  if (s == NULL)
+    return 0;
+
+  for (size_t i = 0; i < s->files_num; i++) {
+    sysfs_file_t *f = s->files + i;
+    f->ok = (sysfs_file_read(f) == 0);
+    if (!f->ok)
+      failed++;
+  }
+
+  return failed;
+} /* }}} size_t sysfs_set_read */
+
+char *sysfs_set_content(sysfs_set_t *s, int idx) /* {{{ */
+{
+  if ((s == NULL) || (idx < 0) || ((size_t)idx >= s->files_num))
+    return NULL;
+
+  sysfs_file_t *f = s->files + idx;
+  return f->ok ? f->buffer : NULL;
+} /* }}} char *sysfs_set_content */
+
+int sysfs_set_value(sysfs_set_t *s, int idx, value_t *ret_value,
+                    int ds_type) /* {{{ */
+{
+  char *content = sysfs_set_content(s, idx);
+  if (content == NULL)
+    return -1;
+
+  /* Like parse_value_file(), only the first line counts. */
+  char *end = strchr(content, '\n');
+  if (end != NULL)
+    *end = 0;
+
+  return parse_value(content, ret_value, ds_type);
+} /* }}} int sysfs_set_value */
+
+struct sysfs_monitor_s {
+  int fd;
+  char *devpath;
+  size_t devpath_len;
+};
+
+#if KERNEL_LINUX
+sysfs_monitor_t *sysfs_monitor_open(char const *devpath) /* {{{ */
+{
+  sysfs_monitor_t *m = calloc(1, sizeof(*m));
+  if (m == NULL)
+    return NULL;
+
+  m->devpath = strdup(devpath);
+  if (m->devpath == NULL) {
+    free(m);
+    errno = ENOMEM;
+    return NULL;
+  }
+  m->devpath_len = strlen(m->devpath);
+  while ((m->devpath_len > 1) && (m->devpath[m->devpath_len - 1] == '/'))
+    m->devpath[--m->devpath_len] = 0;
+
+  m->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                 NETLINK_KOBJECT_UEVENT);
+  if (m->fd < 0) {
+    int err = errno;
+    free(m->devpath);
+    free(m);
+    errno = err;
+    return NULL;
+  }
+
+  /* Group 1 carries the kernel's events. */
+  struct sockaddr_nl sa = {
+      .nl_family = AF_NETLINK, .nl_groups = 1,
+  };
+  if (bind(m->fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    int err = errno;
+    close(m->fd);
+    free(m->devpath);
+    free(m);
+    errno = err;
+    return NULL;
+  }
+
+  return m;
+} /* }}} sysfs_monitor_t *sysfs_monitor_open */
+
+void sysfs_monitor_close(sysfs_monitor_t *m) /* {{{ */
+{
+  if (m == NULL)
+    return;
+
+  close(m->fd);
+  free(m->devpath);
+  free(m);
+} /* }}} void sysfs_monitor_close */
+
+bool sysfs_monitor_changed(sysfs_monitor_t *m) /* {{{ */
+{
+  char buffer[SYSFS_UEVENT_BUFFER_SIZE];
+  bool changed = false;
+
+  if (m == NULL)
+    return false;
+
+  while (42) {
+    struct sockaddr_nl sa = {0};
+    socklen_t sa_len = sizeof(sa);
+    ssize_t len = recvfrom(m->fd, buffer, sizeof(buffer) - 1, MSG_DONTWAIT,
+                           (struct sockaddr *)&sa, &sa_len);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      /* The socket buffer overflowed, so events may have been lost. */
+      if (errno == ENOBUFS) {
+        changed = true;
+        continue;
+      }
+      break;
+    }
+
+    /* Only trust the kernel. */
+    if (sa.nl_pid != 0)
+      continue;
+    buffer[len] = 0;
+
+    /* The message starts with "<action>@<devpath>". */
+    char *devpath = strchr(buffer, '@');
+    if (devpath == NULL)
+      continue;
+    devpath++;
+
+    if ((strncmp(devpath, m->devpath, m->devpath_len) == 0) &&
+        ((devpath[m->devpath_len] == '/') || (devpath[m->devpath_len] == 0)))
+      changed = true;
+  }
+
+  return changed;
+} /* }}} bool sysfs_monitor_changed */
+#else  /* !KERNEL_LINUX */
+sysfs_monitor_t *sysfs_monitor_open(char const *devpath) /* {{{ */
+{
+  errno = ENOTSUP;
+  return NULL;
+} /* }}} sysfs_monitor_t *sysfs_monitor_open */
+
+void sysfs_monitor_close(sysfs_monitor_t *m) /* {{{ */
+{
+  free(m);
+} /* }}} void sysfs_monitor_close */
+
+bool sysfs_monitor_changed(sysfs_monitor_t *m) /* {{{ */
+{
+  return false;
+} /* }}} bool sysfs_monitor_changed */
+#endif /* KERNEL_LINUX */
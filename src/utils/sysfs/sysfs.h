@@ -0,0 +1,118 @@
+/**
+ * collectd - src/utils/sysfs/sysfs.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SYSFS_H
+#define UTILS_SYSFS_H 1
+
+#include "plugin.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A sysfs set is a group of small files below one directory, e.g. an
+ * attribute per CPU below /sys/devices/system/cpu, that are read together.
+ * The files are opened once, relative to the directory, and every
+ * `sysfs_set_read' re-reads them from offset zero with pread(2) into buffers
+ * that are reused, so that sampling them doesn't open, close or allocate. */
+
+struct sysfs_set_s;
+typedef struct sysfs_set_s sysfs_set_t;
+
+/*
+ * NAME
+ *   sysfs_set_create
+ *
+ * DESCRIPTION
+ *   Creates an empty set of files below the directory "dir".
+ *
+ * RETURN VALUE
+ *   A sysfs_set_t-pointer upon success or NULL upon failure, with errno set.
+ */
+sysfs_set_t *sysfs_set_create(char const *dir);
+
+/* Closes all files and the directory and frees the set. Passing NULL is a
+ * no-op. */
+void sysfs_set_destroy(sysfs_set_t *s);
+
+/*
+ * NAME
+ *   sysfs_set_add
+ *
+ * DESCRIPTION
+ *   Opens "path", relative to the directory of the set, and adds it.
+ *
+ * RETURN VALUE
+ *   The index of the file, to be passed to `sysfs_set_content' and
+ *   `sysfs_set_value', or -1 upon failure, with errno set.
+ */
+int sysfs_set_add(sysfs_set_t *s, char const *path);
+
+/* Closes and removes all files, e.g. to add the files again after a CPU has
+ * been added or removed. */
+void sysfs_set_clear(sysfs_set_t *s);
+
+/* Returns the number of files in the set. */
+size_t sysfs_set_num(sysfs_set_t const *s);
+
+/*
+ * NAME
+ *   sysfs_set_read
+ *
+ * DESCRIPTION
+ *   Reads all files of the set.
+ *
+ * RETURN VALUE
+ *   The number of files that could not be read, e.g. because the device
+ *   disappeared.
+ */
+size_t sysfs_set_read(sysfs_set_t *s);
+
+/* Returns the content of a file as read by the last `sysfs_set_read', or
+ * NULL if reading it failed. The content may be modified, e.g. split into
+ * fields, until the next `sysfs_set_read'. */
+char *sysfs_set_content(sysfs_set_t *s, int idx);
+
+/* Parses the content of a file holding a single value, like
+ * parse_value_file(). Returns zero upon success. */
+int sysfs_set_value(sysfs_set_t *s, int idx, value_t *ret_value, int ds_type);
+
+/* A sysfs monitor watches the kernel's uevents for devices being added,
+ * removed, brought online or taken offline below a sysfs path, e.g.
+ * "/devices/system/cpu", so that a plugin finds out when to look for devices
+ * again instead of walking the directory every interval. */
+
+struct sysfs_monitor_s;
+typedef struct sysfs_monitor_s sysfs_monitor_t;
+
+/* Returns a monitor for the devices below "devpath", which is relative to
+ * /sys, or NULL with errno set if uevents can't be received. */
+sysfs_monitor_t *sysfs_monitor_open(char const *devpath);
+
+void sysfs_monitor_close(sysfs_monitor_t *m);
+
+/* Consumes the pending uevents and returns true if one of them was for a
+ * device below the path of the monitor, or if events have been lost. Never
+ * blocks. */
+bool sysfs_monitor_changed(sysfs_monitor_t *m);
+
+#endif /* UTILS_SYSFS_H */
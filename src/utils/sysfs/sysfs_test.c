@@ -0,0 +1,119 @@
+/**
+ * collectd - src/utils/sysfs/sysfs_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+
+#include "collectd.h"
+#include "utils/sysfs/sysfs.h"
+
+static char dir[] = "/tmp/collectd_sysfs_test.XXXXXX";
+
+static int write_file(char const *name, char const *content) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *fh = fopen(path, "w");
+  if (fh == NULL)
+    return -1;
+  fputs(content, fh);
+  fclose(fh);
+  return 0;
+}
+
+static void remove_file(char const *name) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  unlink(path);
+}
+
+DEF_TEST(set) {
+  CHECK_NOT_NULL(mkdtemp(dir));
+  CHECK_ZERO(write_file("freq", "1200000\n"));
+  CHECK_ZERO(write_file("state", "800000 10\n1200000 20\n"));
+
+  sysfs_set_t *s;
+  CHECK_NOT_NULL(s = sysfs_set_create(dir));
+  EXPECT_EQ_INT(0, sysfs_set_add(s, "freq"));
+  EXPECT_EQ_INT(1, sysfs_set_add(s, "state"));
+  EXPECT_EQ_INT(-1, sysfs_set_add(s, "missing"));
+  EXPECT_EQ_INT(ENOENT, errno);
+  EXPECT_EQ_UINT64(2, sysfs_set_num(s));
+
+  /* Nothing has been read yet. */
+  OK(sysfs_set_content(s, 0) == NULL);
+
+  EXPECT_EQ_UINT64(0, sysfs_set_read(s));
+  value_t v;
+  CHECK_ZERO(sysfs_set_value(s, 0, &v, DS_TYPE_GAUGE));
+  EXPECT_EQ_DOUBLE(1200000, v.gauge);
+  EXPECT_EQ_STR("800000 10\n1200000 20\n", sysfs_set_content(s, 1));
+  OK(sysfs_set_content(s, 2) == NULL);
+
+  /* Files are read again from the start; longer content grows the buffer. */
+  CHECK_ZERO(write_file("freq", "2400000\n"));
+  char state[256] = "";
+  for (int i = 0; i < 16; i++) {
+    size_t len = strlen(state);
+    snprintf(state + len, sizeof(state) - len, "%d %d\n", 100000 * i, i);
+  }
+  CHECK_ZERO(write_file("state", state));
+  EXPECT_EQ_UINT64(0, sysfs_set_read(s));
+  CHECK_ZERO(sysfs_set_value(s, 0, &v, DS_TYPE_DERIVE));
+  EXPECT_EQ_INT(2400000, v.derive);
+  EXPECT_EQ_STR(state, sysfs_set_content(s, 1));
+
+  /* After clearing, the files are added again. */
+  sysfs_set_clear(s);
+  EXPECT_EQ_UINT64(0, sysfs_set_num(s));
+  EXPECT_EQ_INT(0, sysfs_set_add(s, "state"));
+  EXPECT_EQ_UINT64(0, sysfs_set_read(s));
+  EXPECT_EQ_STR(state, sysfs_set_content(s, 0));
+
+  sysfs_set_destroy(s);
+  remove_file("freq");
+  remove_file("state");
+  rmdir(dir);
+
+  OK(sysfs_set_create(dir) == NULL);
+  return 0;
+}
+
+DEF_TEST(monitor) {
+  sysfs_monitor_t *m = sysfs_monitor_open("/devices/collectd-test/");
+  if (m == NULL) {
+    printf("uevents are not available: %s\n", strerror(errno));
+    return 0;
+  }
+
+  /* Doesn't block if there are no events. */
+  OK(!sysfs_monitor_changed(m));
+  sysfs_monitor_close(m);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(set);
+  RUN_TEST(monitor);
+
+  END_TEST;
+}
@@ -32,13 +32,39 @@
 
 #include "collectd.h"
 
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/tail/tail.h"
 
+#include <fnmatch.h>
+#include <glob.h>
+
+#if HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+/* Size of the buffer cu_tail_read reads whole blocks into. */
+#define CU_TAIL_BUFFER_SIZE 65536
+
 struct cu_tail_s {
   char *file;
   FILE *fh;
   struct stat stat;
+
+  /* Used by cu_tail_read: the buffer holds the incomplete last line read,
+   * "fill" bytes long. */
+  char *buffer;
+  size_t buffer_size;
+  size_t fill;
+  /* Set when the file has been truncated or replaced, so that an incomplete
+   * line is not joined with data of the new file. */
+  bool restarted;
+
+  /* Used by tail sets: a file that appeared after the set was created is
+   * read from its beginning. A detached file has been removed; the open
+   * handle is read to its end but the file is never reopened. */
+  bool from_start;
+  bool detached;
 };
 
 static int cu_tail_reopen(cu_tail_t *obj) {
@@ -63,6 +89,7 @@ static int cu_tail_reopen(cu_tail_t *obj) {
         obj->fh = NULL;
         return -1;
       }
+      obj->restarted = true;
     }
     memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
     return 1;
@@ -70,7 +97,8 @@ static int cu_tail_reopen(cu_tail_t *obj) {
 
   /* Seek to the end if we re-open the same file again or the file opened
    * is the first at all or the first after an error */
-  if ((obj->stat.st_ino == 0) || (obj->stat.st_ino == stat_buf.st_ino))
+  if (((obj->stat.st_ino == 0) && !obj->from_start) ||
+      (obj->stat.st_ino == stat_buf.st_ino))
     seek_end = 1;
 
   FILE *fh = fopen(obj->file, "r");
@@ -92,6 +120,7 @@ static int cu_tail_reopen(cu_tail_t *obj) {
     fclose(obj->fh);
   obj->fh = fh;
   memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
+  obj->restarted = true;
 
   return 0;
 } /* int cu_tail_reopen */
@@ -117,6 +146,7 @@ cu_tail_t *cu_tail_create(const char *file) {
 int cu_tail_destroy(cu_tail_t *obj) {
   if (obj->fh != NULL)
     fclose(obj->fh);
+  free(obj->buffer);
   free(obj->file);
   free(obj);
 
@@ -185,40 +215,597 @@ int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen) {
   return 0;
 } /* int cu_tail_readline */
 
+/* cu_tail_fill appends data to obj->buffer. Returns the number of bytes
+ * read, zero if there is nothing more to read, or a negative value upon
+ * error. If the file has been reopened, returns zero with "ret_again" set
+ * before reading from the new file. */
+static ssize_t cu_tail_fill(cu_tail_t *obj, bool *ret_again) {
+  *ret_again = false;
+
+  if (obj->fh == NULL) {
+    if (obj->detached)
+      return 0;
+    int status = cu_tail_reopen(obj);
+    if (status < 0)
+      return status;
+  }
+  assert(obj->fh != NULL);
+
+  size_t avail = obj->buffer_size - obj->fill;
+  if (obj->restarted) {
+    if (obj->fill > 0) {
+      *ret_again = true;
+      return 0;
+    }
+    obj->restarted = false;
+  }
+
+  clearerr(obj->fh);
+  size_t n = fread(obj->buffer + obj->fill, 1, avail, obj->fh);
+  if (n > 0)
+    return (ssize_t)n;
+
+  if (ferror(obj->fh) != 0) {
+    /* Force `cu_tail_reopen' to reopen the file.. */
+    fclose(obj->fh);
+    obj->fh = NULL;
+  }
+
+  if (obj->detached)
+    return 0;
+
+  /* eof -> check if the file was moved away and reopen the new file if so.. */
+  int status = cu_tail_reopen(obj);
+  if (status < 0)
+    return status;
+  /* file end reached and file not reopened -> nothing more to read */
+  if (status > 0)
+    return 0;
+
+  *ret_again = true;
+  return 0;
+} /* ssize_t cu_tail_fill */
+
+/* cu_tail_submit hands one line to the callback. Lines longer than "buflen"
+ * minus one are split, like cu_tail_readline does. */
+static int cu_tail_submit(char *line, size_t len, char *buf, int buflen,
+                          tailfunc_t *callback, void *data) {
+  size_t max = (size_t)buflen - 1;
+
+  while (len > max) {
+    memcpy(buf, line, max);
+    buf[max] = 0;
+    int status = callback(data, buf, buflen);
+    if (status != 0)
+      return status;
+    line += max;
+    len -= max;
+  }
+
+  line[len] = 0;
+  return callback(data, line, (int)(len + 1));
+} /* int cu_tail_submit */
+
 int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
                  void *data) {
-  int status;
+  if (buflen < 2) {
+    ERROR("utils_tail: cu_tail_read: buflen too small: %i bytes.", buflen);
+    return -1;
+  }
 
-  while (42) {
-    size_t len;
+  if (obj->buffer == NULL) {
+    obj->buffer_size = CU_TAIL_BUFFER_SIZE;
+    if (obj->buffer_size < (size_t)buflen)
+      obj->buffer_size = (size_t)buflen;
+    obj->buffer = malloc(obj->buffer_size);
+    if (obj->buffer == NULL) {
+      ERROR("utils_tail: cu_tail_read: malloc failed.");
+      return -1;
+    }
+    obj->fill = 0;
+  }
 
-    status = cu_tail_readline(obj, buf, buflen);
-    if (status != 0) {
-      ERROR("utils_tail: cu_tail_read: cu_tail_readline "
-            "failed.");
+  int status = 0;
+  while (42) {
+    bool again = false;
+    ssize_t n = cu_tail_fill(obj, &again);
+    if (n < 0) {
+      ERROR("utils_tail: cu_tail_read: reading %s failed.", obj->file);
+      status = -1;
       break;
     }
 
-    /* check for EOF */
-    if (buf[0] == 0)
-      break;
+    if (n == 0) {
+      if (!again)
+        break;
+
+      /* The file has been truncated or replaced: the incomplete line is all
+       * there is going to be. */
+      if (obj->fill > 0) {
+        size_t len = obj->fill;
+        obj->fill = 0;
+        status = cu_tail_submit(obj->buffer, len, buf, buflen, callback, data);
+        if (status != 0) {
+          ERROR("utils_tail: cu_tail_read: callback returned "
+                "status %i.",
+                status);
+          break;
+        }
+      }
+      continue;
+    }
+
+    /* The incomplete line does not contain a newline. */
+    char *begin = obj->buffer;
+    char *ptr = obj->buffer + obj->fill;
+    char *end = ptr + n;
+    char *newline;
 
-    len = strlen(buf);
-    while (len > 0) {
-      if (buf[len - 1] != '\n')
+    while ((newline = memchr(ptr, '\n', (size_t)(end - ptr))) != NULL) {
+      status = cu_tail_submit(begin, (size_t)(newline - begin), buf, buflen,
+                              callback, data);
+      if (status != 0)
         break;
-      buf[len - 1] = '\0';
-      len--;
+      begin = newline + 1;
+      ptr = begin;
+    }
+
+    /* An incomplete line that fills "buf" is handed over, like
+     * cu_tail_readline does. */
+    size_t max = (size_t)buflen - 1;
+    while ((status == 0) && ((size_t)(end - begin) >= max)) {
+      memcpy(buf, begin, max);
+      buf[max] = 0;
+      status = callback(data, buf, buflen);
+      begin += max;
     }
 
-    status = callback(data, buf, buflen);
     if (status != 0) {
       ERROR("utils_tail: cu_tail_read: callback returned "
             "status %i.",
             status);
+      obj->fill = 0;
       break;
     }
+
+    obj->fill = (size_t)(end - begin);
+    memmove(obj->buffer, begin, obj->fill);
   }
 
   return status;
 } /* int cu_tail_read */
+
+/*
+ * Tail sets
+ *
+ * A tail set follows all files matching a glob pattern. On Linux, the
+ * directories are watched with inotify and only files that have been
+ * modified, created, moved or removed since the last read are read. Without
+ * inotify, the directories are scanned and all files are read every time.
+ */
+#if HAVE_SYS_INOTIFY_H
+#define CU_TAIL_SET_EVENTS                                                     \
+  (IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+#endif
+
+struct cu_tail_set_file_s {
+  cu_tail_t *tail;
+  /* Set if the file has to be read. */
+  bool dirty;
+  /* Scan in which the file was last seen. */
+  unsigned int generation;
+};
+typedef struct cu_tail_set_file_s cu_tail_set_file_t;
+
+struct cu_tail_set_dir_s {
+  char *path;
+  int wd;
+};
+typedef struct cu_tail_set_dir_s cu_tail_set_dir_t;
+
+struct cu_tail_set_s {
+  char *dir_pattern;
+  char *file_pattern;
+  /* If the directory part contains wildcards, it is expanded on every read
+   * to find new directories. */
+  bool dir_is_glob;
+
+  /* The watched directories. Only used with inotify. */
+  cu_tail_set_dir_t *dirs;
+  size_t dirs_num;
+
+  /* Maps the path of a file to its cu_tail_set_file_t. */
+  c_avl_tree_t *files;
+  unsigned int generation;
+  /* Set if all directories have to be scanned again. */
+  bool rescan;
+
+  /* -1 if the directories are scanned on every read. */
+  int inotify_fd;
+};
+
+static cu_tail_set_file_t *cu_tail_set_add_file(cu_tail_set_t *set,
+                                                char const *path,
+                                                bool from_start) {
+  cu_tail_set_file_t *f = NULL;
+
+  if (c_avl_get(set->files, path, (void *)&f) == 0) {
+    f->generation = set->generation;
+    return f;
+  }
+
+  f = calloc(1, sizeof(*f));
+  if (f == NULL)
+    return NULL;
+
+  f->tail = cu_tail_create(path);
+  if (f->tail == NULL) {
+    free(f);
+    return NULL;
+  }
+  f->tail->from_start = from_start;
+  /* Files found by the first scan are opened, and positioned at their end, by
+   * the first read. */
+  f->dirty = true;
+  f->generation = set->generation;
+
+  if (c_avl_insert(set->files, f->tail->file, f) != 0) {
+    cu_tail_destroy(f->tail);
+    free(f);
+    return NULL;
+  }
+
+  return f;
+} /* cu_tail_set_file_t *cu_tail_set_add_file */
+
+static void cu_tail_set_scan_dir(cu_tail_set_t *set, char const *dir,
+                                 bool from_start) {
+  DIR *dh = opendir(dir);
+  if (dh == NULL) {
+    P_WARNING("utils_tail: opendir (%s) failed: %s", dir, STRERRNO);
+    return;
+  }
+
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    char path[PATH_MAX];
+    struct stat statbuf;
+
+    if (fnmatch(set->file_pattern, de->d_name, FNM_PERIOD) != 0)
+      continue;
+
+    int status = snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+    if ((status < 0) || ((size_t)status >= sizeof(path)))
+      continue;
+
+    if ((stat(path, &statbuf) != 0) || !S_ISREG(statbuf.st_mode))
+      continue;
+
+    cu_tail_set_add_file(set, path, from_start);
+  }
+
+  closedir(dh);
+} /* void cu_tail_set_scan_dir */
+
+#if HAVE_SYS_INOTIFY_H
+static cu_tail_set_dir_t *cu_tail_set_find_dir(cu_tail_set_t *set,
+                                               char const *path, int wd) {
+  for (size_t i = 0; i < set->dirs_num; i++) {
+    cu_tail_set_dir_t *d = set->dirs + i;
+    if ((path != NULL) ? (strcmp(path, d->path) == 0) : (wd == d->wd))
+      return d;
+  }
+  return NULL;
+} /* cu_tail_set_dir_t *cu_tail_set_find_dir */
+
+static int cu_tail_set_watch_dir(cu_tail_set_t *set, char const *path) {
+  cu_tail_set_dir_t *tmp =
+      realloc(set->dirs, sizeof(*set->dirs) * (set->dirs_num + 1));
+  if (tmp == NULL)
+    return ENOMEM;
+  set->dirs = tmp;
+
+  cu_tail_set_dir_t *d = set->dirs + set->dirs_num;
+  d->path = strdup(path);
+  if (d->path == NULL)
+    return ENOMEM;
+
+  d->wd = inotify_add_watch(set->inotify_fd, path, CU_TAIL_SET_EVENTS);
+  if (d->wd < 0) {
+    int status = errno;
+    free(d->path);
+    return status;
+  }
+
+  set->dirs_num++;
+  return 0;
+} /* int cu_tail_set_watch_dir */
+
+/* Falls back to scanning the directories on every read. */
+static void cu_tail_set_unwatch(cu_tail_set_t *set) {
+  for (size_t i = 0; i < set->dirs_num; i++)
+    free(set->dirs[i].path);
+  sfree(set->dirs);
+  set->dirs_num = 0;
+
+  if (set->inotify_fd >= 0)
+    close(set->inotify_fd);
+  set->inotify_fd = -1;
+} /* void cu_tail_set_unwatch */
+
+static void cu_tail_set_mark_all(cu_tail_set_t *set) {
+  c_avl_iterator_t *iter = c_avl_get_iterator(set->files);
+  cu_tail_set_file_t *f;
+  char *path;
+
+  while (c_avl_iterator_next(iter, (void *)&path, (void *)&f) == 0)
+    f->dirty = true;
+  c_avl_iterator_destroy(iter);
+} /* void cu_tail_set_mark_all */
+
+static void cu_tail_set_handle_event(cu_tail_set_t *set,
+                                     struct inotify_event const *ev) {
+  if (ev->mask & IN_Q_OVERFLOW) {
+    cu_tail_set_mark_all(set);
+    set->rescan = true;
+    return;
+  }
+
+  cu_tail_set_dir_t *d = cu_tail_set_find_dir(set, NULL, ev->wd);
+  if (d == NULL)
+    return;
+
+  /* The directory has been removed. Files that are still known were moved
+   * away with it. */
+  if (ev->mask & IN_IGNORED) {
+    size_t len = strlen(d->path);
+    c_avl_iterator_t *iter = c_avl_get_iterator(set->files);
+    cu_tail_set_file_t *f;
+    char *path;
+    while (c_avl_iterator_next(iter, (void *)&path, (void *)&f) == 0) {
+      if ((strncmp(path, d->path, len) == 0) && (path[len] == '/') &&
+          (strchr(path + len + 1, '/') == NULL)) {
+        f->tail->detached = true;
+        f->dirty = true;
+      }
+    }
+    c_avl_iterator_destroy(iter);
+
+    free(d->path);
+    set->dirs_num--;
+    memmove(d, d + 1, (set->dirs_num - (size_t)(d - set->dirs)) * sizeof(*d));
+    return;
+  }
+
+  if ((ev->len == 0) || (ev->mask & IN_ISDIR) ||
+      (fnmatch(set->file_pattern, ev->name, FNM_PERIOD) != 0))
+    return;
+
+  char path[PATH_MAX];
+  int status = snprintf(path, sizeof(path), "%s/%s", d->path, ev->name);
+  if ((status < 0) || ((size_t)status >= sizeof(path)))
+    return;
+
+  cu_tail_set_file_t *f = NULL;
+  if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+    /* A file replacing a removed one is reopened once the old handle has been
+     * read to its end. */
+    f = cu_tail_set_add_file(set, path, /* from_start = */ true);
+    if (f != NULL)
+      f->tail->detached = false;
+  } else if (c_avl_get(set->files, path, (void *)&f) == 0) {
+    if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+      f->tail->detached = true;
+  }
+
+  if (f != NULL)
+    f->dirty = true;
+} /* void cu_tail_set_handle_event */
+
+/* cu_tail_set_check_events drains the inotify queue. */
+static void cu_tail_set_check_events(cu_tail_set_t *set) {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (42) {
+    ssize_t status = read(set->inotify_fd, buffer, sizeof(buffer));
+    if ((status < 0) && (errno == EINTR))
+      continue;
+    if (status <= 0) {
+      if ((status < 0) && (errno != EAGAIN)) {
+        P_WARNING("utils_tail: Reading inotify events failed: %s", STRERRNO);
+        cu_tail_set_mark_all(set);
+        set->rescan = true;
+      }
+      break;
+    }
+
+    char *ptr = buffer;
+    while (ptr < buffer + status) {
+      struct inotify_event const *ev = (void *)ptr;
+      cu_tail_set_handle_event(set, ev);
+      ptr += sizeof(*ev) + ev->len;
+    }
+  }
+} /* void cu_tail_set_check_events */
+#endif /* HAVE_SYS_INOTIFY_H */
+
+/* Handles one directory matching the directory part of the pattern. With
+ * inotify, only new directories and, after an overflow of the event queue,
+ * all directories are scanned. */
+static void cu_tail_set_scan_one(cu_tail_set_t *set, char const *dir,
+                                 bool from_start) {
+#if HAVE_SYS_INOTIFY_H
+  if (set->inotify_fd >= 0) {
+    if (cu_tail_set_find_dir(set, dir, -1) == NULL) {
+      /* The watch is added before the directory is read so that no file
+       * created in between is missed. */
+      int status = cu_tail_set_watch_dir(set, dir);
+      if (status != 0) {
+        P_WARNING("utils_tail: Watching %s failed: %s. Files are polled from "
+                  "now on. You may want to increase "
+                  "fs.inotify.max_user_watches.",
+                  dir, STRERROR(status));
+        cu_tail_set_unwatch(set);
+      }
+    } else if (!set->rescan) {
+      return;
+    }
+  }
+#endif
+
+  cu_tail_set_scan_dir(set, dir, from_start);
+} /* void cu_tail_set_scan_one */
+
+static void cu_tail_set_scan(cu_tail_set_t *set) {
+  /* Files found by the first scan are read from their end, like a single
+   * tailed file. */
+  bool from_start = (set->generation != 0);
+  set->generation++;
+
+  if (!set->dir_is_glob) {
+    cu_tail_set_scan_one(set, set->dir_pattern, from_start);
+  } else {
+    glob_t g = {0};
+    int status = glob(set->dir_pattern, GLOB_NOSORT, NULL, &g);
+    if (status == 0) {
+      for (size_t i = 0; i < g.gl_pathc; i++) {
+        struct stat statbuf;
+        if ((stat(g.gl_pathv[i], &statbuf) == 0) && S_ISDIR(statbuf.st_mode))
+          cu_tail_set_scan_one(set, g.gl_pathv[i], from_start);
+      }
+    }
+    globfree(&g);
+  }
+  set->rescan = false;
+
+  if (set->inotify_fd >= 0)
+    return;
+
+  /* Without inotify, every file is read and files that have not been seen
+   * by this scan have been removed. */
+  c_avl_iterator_t *iter = c_avl_get_iterator(set->files);
+  cu_tail_set_file_t *f;
+  char *path;
+  while (c_avl_iterator_next(iter, (void *)&path, (void *)&f) == 0) {
+    f->dirty = true;
+    if (f->generation != set->generation)
+      f->tail->detached = true;
+  }
+  c_avl_iterator_destroy(iter);
+} /* void cu_tail_set_scan */
+
+cu_tail_set_t *cu_tail_set_create(const char *pattern) {
+  char const *slash = strrchr(pattern, '/');
+  char const *file_pattern = (slash != NULL) ? slash + 1 : pattern;
+
+  if (file_pattern[0] == 0) {
+    P_ERROR("utils_tail: cu_tail_set_create: `%s' does not name files.",
+            pattern);
+    return NULL;
+  }
+
+  cu_tail_set_t *set = calloc(1, sizeof(*set));
+  if (set == NULL)
+    return NULL;
+  set->inotify_fd = -1;
+
+  if (slash == NULL)
+    set->dir_pattern = strdup(".");
+  else if (slash == pattern)
+    set->dir_pattern = strdup("/");
+  else
+    set->dir_pattern = strndup(pattern, (size_t)(slash - pattern));
+  set->file_pattern = strdup(file_pattern);
+  set->files = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if ((set->dir_pattern == NULL) || (set->file_pattern == NULL) ||
+      (set->files == NULL)) {
+    cu_tail_set_destroy(set);
+    return NULL;
+  }
+  set->dir_is_glob = (strpbrk(set->dir_pattern, "*?[") != NULL);
+
+#if HAVE_SYS_INOTIFY_H
+  set->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (set->inotify_fd < 0)
+    P_WARNING("utils_tail: inotify_init1 failed: %s. The files matching `%s' "
+              "are polled.",
+              STRERRNO, pattern);
+#endif
+
+  return set;
+} /* cu_tail_set_t *cu_tail_set_create */
+
+int cu_tail_set_destroy(cu_tail_set_t *set) {
+  if (set == NULL)
+    return 0;
+
+  if (set->files != NULL) {
+    cu_tail_set_file_t *f;
+    char *path;
+    while (c_avl_pick(set->files, (void *)&path, (void *)&f) == 0) {
+      cu_tail_destroy(f->tail);
+      free(f);
+    }
+    c_avl_destroy(set->files);
+  }
+
+#if HAVE_SYS_INOTIFY_H
+  cu_tail_set_unwatch(set);
+#endif
+  free(set->dir_pattern);
+  free(set->file_pattern);
+  free(set);
+
+  return 0;
+} /* int cu_tail_set_destroy */
+
+int cu_tail_set_read(cu_tail_set_t *set, char *buf, int buflen,
+                     tailfunc_t *callback, void *data) {
+#if HAVE_SYS_INOTIFY_H
+  if (set->inotify_fd >= 0)
+    cu_tail_set_check_events(set);
+#endif
+
+  if ((set->generation == 0) || set->rescan || set->dir_is_glob ||
+      (set->inotify_fd < 0))
+    cu_tail_set_scan(set);
+
+  cu_tail_t **detached = NULL;
+  size_t detached_num = 0;
+  int status = 0;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(set->files);
+  cu_tail_set_file_t *f;
+  char *path;
+  while (c_avl_iterator_next(iter, (void *)&path, (void *)&f) == 0) {
+    if (!f->dirty)
+      continue;
+    f->dirty = false;
+
+    if (cu_tail_read(f->tail, buf, buflen, callback, data) != 0)
+      status = -1;
+
+    if (!f->tail->detached)
+      continue;
+
+    cu_tail_t **tmp =
+        realloc(detached, sizeof(*detached) * (detached_num + 1));
+    if (tmp == NULL)
+      continue;
+    detached = tmp;
+    detached[detached_num++] = f->tail;
+  }
+  c_avl_iterator_destroy(iter);
+
+  /* Removed files are forgotten once they have been read to their end. */
+  for (size_t i = 0; i < detached_num; i++) {
+    if (c_avl_remove(set->files, detached[i]->file, NULL, (void *)&f) != 0)
+      continue;
+    cu_tail_destroy(f->tail);
+    free(f);
+  }
+  free(detached);
+
+  return status;
+} /* int cu_tail_set_read */
@@ -76,13 +76,58 @@ int cu_tail_destroy(cu_tail_t *obj);
 int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen);
 
 /*
- * cu_tail_readline
+ * cu_tail_read
  *
- * Reads from the file until eof condition or an error is encountered.
+ * Reads from the file until eof condition or an error is encountered and
+ * calls `callback' for each line, without the trailing newline. The file is
+ * read in large blocks; the lines passed to the callback point into the
+ * object's buffer and are only valid until the callback returns. Lines longer
+ * than `buflen' minus one bytes are copied to `buf' and passed in pieces. An
+ * incomplete last line is kept until the rest of it has been written, or
+ * until the file is truncated or replaced.
  *
  * Returns 0 when successful and non-zero otherwise.
  */
 int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
                  void *data);
 
+struct cu_tail_set_s;
+typedef struct cu_tail_set_s cu_tail_set_t;
+
+/*
+ * cu_tail_set_create
+ *
+ * Allocates a tail set following all regular files matching `pattern', a
+ * glob(7) pattern. The directory part may contain wildcards, too; it is
+ * expanded on every read to find new directories. Files that exist when the set is first read are
+ * read from their end; files appearing later are read from their beginning.
+ *
+ * On Linux, the directories are watched with inotify and only files that
+ * have been changed are read. Otherwise, all files are read every time.
+ */
+cu_tail_set_t *cu_tail_set_create(const char *pattern);
+
+/*
+ * cu_tail_set_destroy
+ *
+ * Takes a tail set returned by `cu_tail_set_create' and destroys it, closing
+ * all files.
+ *
+ * Returns 0 when successful and non-zero otherwise.
+ */
+int cu_tail_set_destroy(cu_tail_set_t *set);
+
+/*
+ * cu_tail_set_read
+ *
+ * Like `cu_tail_read', for every file of the set that may have new data. The
+ * lines of all files are passed to the same callback. Rotated or truncated
+ * files are handled like by `cu_tail_read'; removed files are read to their
+ * end and then forgotten.
+ *
+ * Returns 0 when successful and non-zero if reading any file failed.
+ */
+int cu_tail_set_read(cu_tail_set_t *set, char *buf, int buflen,
+                     tailfunc_t *callback, void *data);
+
 #endif /* UTILS_TAIL_H */
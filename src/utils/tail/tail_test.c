@@ -0,0 +1,190 @@
+/**
+ * collectd - src/utils/tail/tail_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/tail/tail.h"
+
+static char path[] = "/tmp/collectd_tail_test.XXXXXX";
+
+static char lines[8][64];
+static int lines_num;
+
+static int test_callback(void *data, char *buf, int buflen) {
+  if (lines_num < (int)STATIC_ARRAY_SIZE(lines))
+    sstrncpy(lines[lines_num], buf, sizeof(lines[lines_num]));
+  lines_num++;
+  return 0;
+}
+
+static int append(char const *str) {
+  FILE *fh = fopen(path, "a");
+  if (fh == NULL)
+    return -1;
+  fputs(str, fh);
+  return fclose(fh);
+}
+
+static int read_lines(cu_tail_t *t) {
+  char buf[8];
+  lines_num = 0;
+  CHECK_ZERO(cu_tail_read(t, buf, sizeof(buf), test_callback, NULL));
+  return lines_num;
+}
+
+DEF_TEST(read) {
+  cu_tail_t *t;
+  CHECK_NOT_NULL(t = cu_tail_create(path));
+
+  /* The file is read from its end when opened the first time. */
+  CHECK_ZERO(append("old\n"));
+  EXPECT_EQ_INT(0, read_lines(t));
+
+  CHECK_ZERO(append("one\n\ntwo\nthr"));
+  EXPECT_EQ_INT(3, read_lines(t));
+  EXPECT_EQ_STR("one", lines[0]);
+  EXPECT_EQ_STR("", lines[1]);
+  EXPECT_EQ_STR("two", lines[2]);
+
+  /* The incomplete line is kept until it is complete. */
+  CHECK_ZERO(append("ee\n"));
+  EXPECT_EQ_INT(1, read_lines(t));
+  EXPECT_EQ_STR("three", lines[0]);
+
+  /* Lines that do not fit into the buffer are split. */
+  CHECK_ZERO(append("0123456789abcdef\n"));
+  EXPECT_EQ_INT(3, read_lines(t));
+  EXPECT_EQ_STR("0123456", lines[0]);
+  EXPECT_EQ_STR("789abcd", lines[1]);
+  EXPECT_EQ_STR("ef", lines[2]);
+
+  /* After truncation, the file is read from its beginning and the incomplete
+   * line is handed over on its own. */
+  CHECK_ZERO(append("part"));
+  EXPECT_EQ_INT(0, read_lines(t));
+  FILE *fh = fopen(path, "w");
+  CHECK_NOT_NULL(fh);
+  fputs("new\n", fh);
+  fclose(fh);
+  EXPECT_EQ_INT(0, read_lines(t));
+  EXPECT_EQ_INT(2, read_lines(t));
+  EXPECT_EQ_STR("part", lines[0]);
+  EXPECT_EQ_STR("new", lines[1]);
+
+  cu_tail_destroy(t);
+  return 0;
+}
+
+static char dir[] = "/tmp/collectd_tail_test_dir.XXXXXX";
+
+static int write_file(char const *name, char const *mode, char const *str) {
+  char file[PATH_MAX];
+  snprintf(file, sizeof(file), "%s/%s", dir, name);
+  FILE *fh = fopen(file, mode);
+  if (fh == NULL)
+    return -1;
+  fputs(str, fh);
+  return fclose(fh);
+}
+
+static int read_set_lines(cu_tail_set_t *set) {
+  char buf[8];
+  lines_num = 0;
+  CHECK_ZERO(cu_tail_set_read(set, buf, sizeof(buf), test_callback, NULL));
+  return lines_num;
+}
+
+DEF_TEST(set) {
+  char pattern[PATH_MAX];
+  char from[PATH_MAX];
+  char to[PATH_MAX];
+  cu_tail_set_t *set;
+
+  snprintf(pattern, sizeof(pattern), "%s/*.log", dir);
+  CHECK_NOT_NULL(set = cu_tail_set_create(pattern));
+
+  /* Files existing when the set is first read are read from their end. */
+  CHECK_ZERO(write_file("a.log", "w", "old\n"));
+  EXPECT_EQ_INT(0, read_set_lines(set));
+  EXPECT_EQ_INT(0, read_set_lines(set));
+
+  CHECK_ZERO(write_file("a.log", "a", "one\n"));
+  EXPECT_EQ_INT(1, read_set_lines(set));
+  EXPECT_EQ_STR("one", lines[0]);
+
+  /* New files are read from their beginning, other files are ignored. */
+  CHECK_ZERO(write_file("b.log", "w", "two\n"));
+  CHECK_ZERO(write_file("c.txt", "w", "ignored\n"));
+  EXPECT_EQ_INT(1, read_set_lines(set));
+  EXPECT_EQ_STR("two", lines[0]);
+
+  /* After rotation, the old file is read to its end before the new one. */
+  snprintf(from, sizeof(from), "%s/a.log", dir);
+  snprintf(to, sizeof(to), "%s/a.log.1", dir);
+  CHECK_ZERO(rename(from, to));
+  CHECK_ZERO(write_file("a.log.1", "a", "three\n"));
+  CHECK_ZERO(write_file("a.log", "w", "four\n"));
+  EXPECT_EQ_INT(2, read_set_lines(set));
+  EXPECT_EQ_STR("three", lines[0]);
+  EXPECT_EQ_STR("four", lines[1]);
+
+  /* Removed files are read to their end. */
+  CHECK_ZERO(write_file("b.log", "a", "five\n"));
+  snprintf(from, sizeof(from), "%s/b.log", dir);
+  CHECK_ZERO(unlink(from));
+  EXPECT_EQ_INT(1, read_set_lines(set));
+  EXPECT_EQ_STR("five", lines[0]);
+  EXPECT_EQ_INT(0, read_set_lines(set));
+
+  cu_tail_set_destroy(set);
+
+  unlink(to);
+  snprintf(from, sizeof(from), "%s/a.log", dir);
+  unlink(from);
+  snprintf(from, sizeof(from), "%s/c.txt", dir);
+  unlink(from);
+  return 0;
+}
+
+int main(void) {
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    fprintf(stderr, "mkstemp failed: %s\n", strerror(errno));
+    return 1;
+  }
+  close(fd);
+
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  RUN_TEST(read);
+  RUN_TEST(set);
+
+  unlink(path);
+  rmdir(dir);
+  END_TEST;
+}
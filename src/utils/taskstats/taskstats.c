@@ -32,6 +32,8 @@
 #include <linux/taskstats.h>
 
 struct ts_s {
+  /* lock serializes requests, so that the handle can be shared by threads. */
+  pthread_mutex_t lock;
   struct mnl_socket *nl;
   pid_t pid;
   uint32_t seq;
@@ -249,6 +251,7 @@ void ts_destroy(ts_t *ts) {
     ts->nl = NULL;
   }
 
+  pthread_mutex_destroy(&ts->lock);
   sfree(ts);
 }
 
@@ -258,6 +261,7 @@ ts_t *ts_create(void) {
     ERROR("utils_taskstats: calloc failed: %s", STRERRNO);
     return NULL;
   }
+  pthread_mutex_init(&ts->lock, /* attr = */ NULL);
 
   if ((ts->nl = mnl_socket_open(NETLINK_GENERIC)) == NULL) {
     ERROR("utils_taskstats: mnl_socket_open(NETLINK_GENERIC) = %s", STRERRNO);
@@ -291,7 +295,9 @@ int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
 
   struct taskstats raw = {0};
 
+  pthread_mutex_lock(&ts->lock);
   int status = get_taskstats(ts, tgid, &raw);
+  pthread_mutex_unlock(&ts->lock);
   if (status != 0) {
     return status;
   }
@@ -41,7 +41,8 @@ ts_t *ts_create(void);
 void ts_destroy(ts_t *);
 
 /* ts_delay_by_tgid returns Linux delay accounting information for the task
- * identified by tgid. Returns zero on success and an errno otherwise. */
+ * identified by tgid. Returns zero on success and an errno otherwise. May be
+ * called by several threads using the same handle. */
 int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out);
 
 #endif /* UTILS_TASKSTATS_H */
@@ -0,0 +1,564 @@
+/**
+ * collectd - src/utils/tsz/tsz.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/tsz/tsz.h"
+
+/* A chunk is closed after this many points or after a quarter of the span,
+ * whichever comes first, so that at most a quarter of the span more than
+ * requested is kept. */
+#define C_TSZ_CHUNK_POINTS 256
+#define C_TSZ_CHUNKS_PER_SPAN 4
+
+/* No leading and trailing zeros have been stored for the data source yet. */
+#define C_TSZ_NO_WINDOW 0xff
+
+typedef struct c_tsz_chunk_s c_tsz_chunk_t;
+struct c_tsz_chunk_s {
+  c_tsz_chunk_t *next;
+
+  /* Times in milliseconds. */
+  int64_t first;
+  int64_t last;
+  size_t points;
+
+  /* The bit stream, most significant bit first. */
+  uint64_t *words;
+  size_t words_size;
+  size_t bits;
+};
+
+/* The state of the XOR encoding of one data source. */
+typedef struct {
+  uint64_t prev;
+  uint8_t leading;
+  uint8_t trailing;
+} c_tsz_value_state_t;
+
+struct c_tsz_s {
+  size_t values_num;
+  int64_t span;
+  size_t points;
+
+  /* Oldest first. Points are appended to the last chunk. */
+  c_tsz_chunk_t *head;
+  c_tsz_chunk_t *tail;
+
+  /* The state of the encoding of the last chunk. */
+  int64_t last_delta;
+  c_tsz_value_state_t state[];
+};
+
+typedef struct {
+  uint64_t const *words;
+  size_t pos;
+} c_tsz_reader_t;
+
+static uint64_t gauge_bits(gauge_t g) {
+  uint64_t u;
+  memcpy(&u, &g, sizeof(u));
+  return u;
+} /* uint64_t gauge_bits */
+
+static gauge_t bits_gauge(uint64_t u) {
+  gauge_t g;
+  memcpy(&g, &u, sizeof(g));
+  return g;
+} /* gauge_t bits_gauge */
+
+/* Makes room for `n' more bits. */
+static int chunk_reserve(c_tsz_chunk_t *c, size_t n) {
+  if (c->bits + n <= 64 * c->words_size)
+    return 0;
+
+  size_t words_size = (c->words_size > 0) ? 2 * c->words_size : 4;
+  while (c->bits + n > 64 * words_size)
+    words_size *= 2;
+
+  uint64_t *tmp = realloc(c->words, words_size * sizeof(*tmp));
+  if (tmp == NULL)
+    return ENOMEM;
+  memset(tmp + c->words_size, 0, (words_size - c->words_size) * sizeof(*tmp));
+  c->words = tmp;
+  c->words_size = words_size;
+
+  return 0;
+} /* int chunk_reserve */
+
+/* Appends the `n' lowest bits of `value', 1 <= n <= 64. The room has to be
+ * reserved. */
+static void chunk_write(c_tsz_chunk_t *c, uint64_t value, unsigned n) {
+  if (n < 64)
+    value &= (UINT64_C(1) << n) - 1;
+
+  size_t idx = c->bits / 64;
+  unsigned space = 64 - (unsigned)(c->bits % 64);
+  if (n <= space) {
+    c->words[idx] |= (n == 64) ? value : value << (space - n);
+  } else {
+    c->words[idx] |= value >> (n - space);
+    c->words[idx + 1] |= value << (64 - (n - space));
+  }
+  c->bits += n;
+} /* void chunk_write */
+
+static uint64_t reader_read(c_tsz_reader_t *r, unsigned n) {
+  if (n == 0)
+    return 0;
+
+  size_t idx = r->pos / 64;
+  unsigned off = (unsigned)(r->pos % 64);
+  unsigned space = 64 - off;
+  r->pos += n;
+
+  uint64_t hi = r->words[idx] << off;
+  if (n <= space)
+    return hi >> (64 - n);
+
+  return (hi >> (64 - n)) | (r->words[idx + 1] >> (64 - (n - space)));
+} /* uint64_t reader_read */
+
+static void chunk_free(c_tsz_chunk_t *c) {
+  if (c == NULL)
+    return;
+  free(c->words);
+  free(c);
+} /* void chunk_free */
+
+/* Starts a chunk with a point whose values are stored as they are. */
+static int tsz_start_chunk(c_tsz_t *t, int64_t time, gauge_t const *values) {
+  c_tsz_chunk_t *c = calloc(1, sizeof(*c));
+  if (c == NULL)
+    return ENOMEM;
+  if (chunk_reserve(c, 64 * t->values_num) != 0) {
+    chunk_free(c);
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < t->values_num; i++) {
+    uint64_t u = gauge_bits(values[i]);
+    chunk_write(c, u, 64);
+    t->state[i] = (c_tsz_value_state_t){
+        .prev = u, .leading = C_TSZ_NO_WINDOW,
+    };
+  }
+  c->first = time;
+  c->last = time;
+  c->points = 1;
+
+  /* The closed chunk doesn't grow anymore. */
+  c_tsz_chunk_t *prev = t->tail;
+  if ((prev != NULL) && (prev->words_size > (prev->bits + 63) / 64)) {
+    size_t words_size = (prev->bits + 63) / 64;
+    uint64_t *tmp = realloc(prev->words, words_size * sizeof(*tmp));
+    if (tmp != NULL) {
+      prev->words = tmp;
+      prev->words_size = words_size;
+    }
+  }
+
+  if (t->tail == NULL)
+    t->head = c;
+  else
+    t->tail->next = c;
+  t->tail = c;
+  t->last_delta = 0;
+
+  return 0;
+} /* int tsz_start_chunk */
+
+/* The most bits a point takes: the time, and a control, window and the
+ * value for each data source. */
+#define C_TSZ_TIME_BITS_MAX (4 + 32)
+#define C_TSZ_VALUE_BITS_MAX (2 + 5 + 6 + 64)
+
+/* Encodes the difference of the deltas of a point's time. */
+static void tsz_write_time(c_tsz_chunk_t *c, int64_t dod) {
+  if (dod == 0) {
+    chunk_write(c, 0x0, 1);
+  } else if ((dod >= -63) && (dod <= 64)) {
+    chunk_write(c, 0x2, 2);
+    chunk_write(c, (uint64_t)(dod + 63), 7);
+  } else if ((dod >= -255) && (dod <= 256)) {
+    chunk_write(c, 0x6, 3);
+    chunk_write(c, (uint64_t)(dod + 255), 9);
+  } else if ((dod >= -2047) && (dod <= 2048)) {
+    chunk_write(c, 0xe, 4);
+    chunk_write(c, (uint64_t)(dod + 2047), 12);
+  } else {
+    chunk_write(c, 0xf, 4);
+    chunk_write(c, (uint64_t)(uint32_t)(int32_t)dod, 32);
+  }
+} /* void tsz_write_time */
+
+static void tsz_write_value(c_tsz_chunk_t *c, c_tsz_value_state_t *s,
+                            uint64_t u) {
+  uint64_t x = u ^ s->prev;
+  s->prev = u;
+
+  if (x == 0) {
+    chunk_write(c, 0x0, 1);
+    return;
+  }
+
+  unsigned leading = (unsigned)__builtin_clzll(x);
+  unsigned trailing = (unsigned)__builtin_ctzll(x);
+  /* The number of leading zeros is stored in 5 bits. */
+  if (leading > 31)
+    leading = 31;
+
+  /* The bits that differ fit into the window of the previous value. */
+  if ((s->leading != C_TSZ_NO_WINDOW) && (leading >= s->leading) &&
+      (trailing >= s->trailing)) {
+    chunk_write(c, 0x2, 2);
+    chunk_write(c, x >> s->trailing, 64 - s->leading - s->trailing);
+    return;
+  }
+
+  unsigned len = 64 - leading - trailing;
+  s->leading = (uint8_t)leading;
+  s->trailing = (uint8_t)trailing;
+  chunk_write(c, 0x3, 2);
+  chunk_write(c, leading, 5);
+  chunk_write(c, len - 1, 6);
+  chunk_write(c, x >> trailing, len);
+} /* void tsz_write_value */
+
+/* Drops the chunks whose points are all older than the span. */
+static void tsz_expire(c_tsz_t *t, int64_t now) {
+  while ((t->head != t->tail) && (t->head->next->first <= now - t->span)) {
+    c_tsz_chunk_t *c = t->head;
+    t->head = c->next;
+    t->points -= c->points;
+    chunk_free(c);
+  }
+} /* void tsz_expire */
+
+c_tsz_t *c_tsz_create(size_t values_num, cdtime_t span) {
+  int64_t span_ms = (int64_t)CDTIME_T_TO_MS(span);
+  if ((values_num == 0) || (span_ms <= 0))
+    return NULL;
+
+  c_tsz_t *t = calloc(1, sizeof(*t) + values_num * sizeof(t->state[0]));
+  if (t == NULL)
+    return NULL;
+
+  t->values_num = values_num;
+  t->span = span_ms;
+  return t;
+} /* c_tsz_t *c_tsz_create */
+
+void c_tsz_destroy(c_tsz_t *t) {
+  if (t == NULL)
+    return;
+
+  while (t->head != NULL) {
+    c_tsz_chunk_t *c = t->head;
+    t->head = c->next;
+    chunk_free(c);
+  }
+  free(t);
+} /* void c_tsz_destroy */
+
+int c_tsz_append(c_tsz_t *t, cdtime_t time, gauge_t const *values) {
+  if ((t == NULL) || (values == NULL))
+    return EINVAL;
+
+  int64_t ms = (int64_t)CDTIME_T_TO_MS(time);
+  c_tsz_chunk_t *c = t->tail;
+  if ((c != NULL) && (ms <= c->last))
+    return EINVAL;
+
+  int64_t delta = (c != NULL) ? ms - c->last : 0;
+  int64_t dod = delta - t->last_delta;
+  if ((c == NULL) || (c->points >= C_TSZ_CHUNK_POINTS) ||
+      (C_TSZ_CHUNKS_PER_SPAN * (ms - c->first) >= t->span) ||
+      (dod < INT32_MIN) || (dod > INT32_MAX)) {
+    int status = tsz_start_chunk(t, ms, values);
+    if (status != 0)
+      return status;
+  } else {
+    if (chunk_reserve(c, C_TSZ_TIME_BITS_MAX +
+                             t->values_num * C_TSZ_VALUE_BITS_MAX) != 0)
+      return ENOMEM;
+
+    tsz_write_time(c, dod);
+    for (size_t i = 0; i < t->values_num; i++)
+      tsz_write_value(c, t->state + i, gauge_bits(values[i]));
+
+    c->last = ms;
+    c->points++;
+    t->last_delta = delta;
+  }
+
+  t->points++;
+  tsz_expire(t, ms);
+  return 0;
+} /* int c_tsz_append */
+
+static int64_t tsz_read_dod(c_tsz_reader_t *r) {
+  if (reader_read(r, 1) == 0)
+    return 0;
+  if (reader_read(r, 1) == 0)
+    return (int64_t)reader_read(r, 7) - 63;
+  if (reader_read(r, 1) == 0)
+    return (int64_t)reader_read(r, 9) - 255;
+  if (reader_read(r, 1) == 0)
+    return (int64_t)reader_read(r, 12) - 2047;
+  return (int64_t)(int32_t)(uint32_t)reader_read(r, 32);
+} /* int64_t tsz_read_dod */
+
+static uint64_t tsz_read_value(c_tsz_reader_t *r, c_tsz_value_state_t *s) {
+  if (reader_read(r, 1) == 0)
+    return s->prev;
+
+  if (reader_read(r, 1) != 0) {
+    s->leading = (uint8_t)reader_read(r, 5);
+    unsigned len = (unsigned)reader_read(r, 6) + 1;
+    s->trailing = (uint8_t)(64 - s->leading - len);
+  }
+
+  unsigned len = 64 - s->leading - s->trailing;
+  s->prev ^= reader_read(r, len) << s->trailing;
+  return s->prev;
+} /* uint64_t tsz_read_value */
+
+int c_tsz_read(c_tsz_t const *t, cdtime_t start, cdtime_t end,
+               cdtime_t **ret_times, gauge_t **ret_values, size_t *ret_num) {
+  if ((t == NULL) || (ret_times == NULL) || (ret_values == NULL) ||
+      (ret_num == NULL))
+    return EINVAL;
+
+  /* Only used to skip chunks, so rounded outwards. */
+  int64_t start_ms = (int64_t)CDTIME_T_TO_MS(start) - 1;
+  int64_t end_ms = (int64_t)CDTIME_T_TO_MS(end) + 1;
+
+  size_t max = 0;
+  for (c_tsz_chunk_t const *c = t->head; c != NULL; c = c->next)
+    if ((c->last >= start_ms) && (c->first <= end_ms))
+      max += c->points;
+
+  *ret_times = NULL;
+  *ret_values = NULL;
+  *ret_num = 0;
+  if (max == 0)
+    return 0;
+
+  cdtime_t *times = malloc(max * sizeof(*times));
+  gauge_t *values = malloc(max * t->values_num * sizeof(*values));
+  c_tsz_value_state_t *state = calloc(t->values_num, sizeof(*state));
+  if ((times == NULL) || (values == NULL) || (state == NULL)) {
+    free(times);
+    free(values);
+    free(state);
+    return ENOMEM;
+  }
+
+  size_t num = 0;
+  for (c_tsz_chunk_t const *c = t->head; c != NULL; c = c->next) {
+    if ((c->last < start_ms) || (c->first > end_ms))
+      continue;
+
+    c_tsz_reader_t r = {.words = c->words};
+    int64_t time = c->first;
+    int64_t delta = 0;
+    for (size_t i = 0; i < t->values_num; i++)
+      state[i] = (c_tsz_value_state_t){.prev = reader_read(&r, 64)};
+
+    for (size_t p = 0; p < c->points; p++) {
+      if (p > 0) {
+        delta += tsz_read_dod(&r);
+        time += delta;
+        for (size_t i = 0; i < t->values_num; i++)
+          tsz_read_value(&r, state + i);
+      }
+
+      cdtime_t t_point = MS_TO_CDTIME_T(time);
+      if ((t_point < start) || (t_point > end))
+        continue;
+
+      times[num] = t_point;
+      for (size_t i = 0; i < t->values_num; i++)
+        values[num * t->values_num + i] = bits_gauge(state[i].prev);
+      num++;
+    }
+  }
+  free(state);
+
+  if (num == 0) {
+    free(times);
+    free(values);
+    return 0;
+  }
+
+  *ret_times = times;
+  *ret_values = values;
+  *ret_num = num;
+  return 0;
+} /* int c_tsz_read */
+
+int c_tsz_encode(size_t values_num, cdtime_t const *times,
+                 gauge_t const *values, size_t num, uint8_t **ret_buf,
+                 size_t *ret_size, size_t *ret_num) {
+  if ((values_num == 0) || (num == 0) || (times == NULL) || (values == NULL) ||
+      (ret_buf == NULL) || (ret_size == NULL) || (ret_num == NULL))
+    return EINVAL;
+
+  c_tsz_value_state_t state[values_num];
+  c_tsz_chunk_t c = {0};
+  int status = 0;
+
+  if (chunk_reserve(&c, 64 + 64 * values_num) != 0)
+    return ENOMEM;
+  int64_t last = (int64_t)CDTIME_T_TO_MS(times[0]);
+  int64_t last_delta = 0;
+  size_t points = 1;
+  chunk_write(&c, (uint64_t)last, 64);
+  for (size_t i = 0; i < values_num; i++) {
+    uint64_t u = gauge_bits(values[i]);
+    chunk_write(&c, u, 64);
+    state[i] = (c_tsz_value_state_t){.prev = u, .leading = C_TSZ_NO_WINDOW};
+  }
+
+  for (size_t p = 1; p < num; p++) {
+    int64_t ms = (int64_t)CDTIME_T_TO_MS(times[p]);
+    if (ms < last) {
+      status = ERANGE;
+      break;
+    } else if (ms == last) {
+      continue;
+    }
+
+    int64_t delta = ms - last;
+    int64_t dod = delta - last_delta;
+    if ((dod < INT32_MIN) || (dod > INT32_MAX)) {
+      status = ERANGE;
+      break;
+    }
+    if (chunk_reserve(&c, C_TSZ_TIME_BITS_MAX +
+                              values_num * C_TSZ_VALUE_BITS_MAX) != 0) {
+      status = ENOMEM;
+      break;
+    }
+
+    tsz_write_time(&c, dod);
+    for (size_t i = 0; i < values_num; i++)
+      tsz_write_value(&c, state + i, gauge_bits(values[p * values_num + i]));
+    last = ms;
+    last_delta = delta;
+    points++;
+  }
+
+  if (status != 0) {
+    free(c.words);
+    return status;
+  }
+
+  /* The words are written most significant byte first, independent of the
+   * byte order of the host, and the block is truncated to the last byte with
+   * bits. */
+  size_t size = (c.bits + 7) / 8;
+  uint8_t *buf = malloc(size);
+  if (buf == NULL) {
+    free(c.words);
+    return ENOMEM;
+  }
+  for (size_t i = 0; i < size; i++)
+    buf[i] = (uint8_t)(c.words[i / 8] >> (56 - 8 * (i % 8)));
+  free(c.words);
+
+  *ret_buf = buf;
+  *ret_size = size;
+  *ret_num = points;
+  return 0;
+} /* int c_tsz_encode */
+
+int c_tsz_decode(size_t values_num, uint8_t const *buf, size_t size,
+                 size_t num, cdtime_t *times, gauge_t *values) {
+  if ((values_num == 0) || (buf == NULL) || (times == NULL) ||
+      (values == NULL))
+    return EINVAL;
+  if (num == 0)
+    return 0;
+
+  /* The words are padded with room for one more point, so that a block that
+   * is too short is only noticed after the point has been read. */
+  size_t bits = 8 * size;
+  size_t words_num = (size + 7) / 8 +
+                     (C_TSZ_TIME_BITS_MAX + values_num * C_TSZ_VALUE_BITS_MAX +
+                      64 + 64 * values_num) /
+                         64 +
+                     1;
+  uint64_t *words = calloc(words_num, sizeof(*words));
+  c_tsz_value_state_t *state = calloc(values_num, sizeof(*state));
+  if ((words == NULL) || (state == NULL)) {
+    free(words);
+    free(state);
+    return ENOMEM;
+  }
+  for (size_t i = 0; i < size; i++)
+    words[i / 8] |= (uint64_t)buf[i] << (56 - 8 * (i % 8));
+
+  c_tsz_reader_t r = {.words = words};
+  int64_t time = (int64_t)reader_read(&r, 64);
+  int64_t delta = 0;
+  for (size_t i = 0; i < values_num; i++)
+    state[i] = (c_tsz_value_state_t){.prev = reader_read(&r, 64)};
+
+  int status = 0;
+  for (size_t p = 0; p < num; p++) {
+    if (p > 0) {
+      delta += tsz_read_dod(&r);
+      time += delta;
+      for (size_t i = 0; i < values_num; i++)
+        tsz_read_value(&r, state + i);
+    }
+    if (r.pos > bits) {
+      status = EINVAL;
+      break;
+    }
+
+    times[p] = MS_TO_CDTIME_T(time);
+    for (size_t i = 0; i < values_num; i++)
+      values[p * values_num + i] = bits_gauge(state[i].prev);
+  }
+
+  free(words);
+  free(state);
+  return status;
+} /* int c_tsz_decode */
+
+size_t c_tsz_points(c_tsz_t const *t) {
+  return (t != NULL) ? t->points : 0;
+} /* size_t c_tsz_points */
+
+size_t c_tsz_memory(c_tsz_t const *t) {
+  if (t == NULL)
+    return 0;
+
+  size_t size = sizeof(*t) + t->values_num * sizeof(t->state[0]);
+  for (c_tsz_chunk_t const *c = t->head; c != NULL; c = c->next)
+    size += sizeof(*c) + c->words_size * sizeof(*c->words);
+  return size;
+} /* size_t c_tsz_memory */
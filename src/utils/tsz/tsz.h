@@ -0,0 +1,105 @@
+/**
+ * collectd - src/utils/tsz/tsz.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_TSZ_H
+#define UTILS_TSZ_H 1
+
+#include "collectd.h"
+
+#include "plugin.h"
+
+/*
+ * Compressed time series
+ *
+ * Keeps the points of one series, each a time and one gauge per data source,
+ * for a limited time span, compressed as described in "Gorilla: A Fast,
+ * Scalable, In-Memory Time Series Database" (Pelkonen et al., VLDB 2015):
+ * times are stored as the difference of consecutive deltas, which is zero for
+ * regular intervals, and values as the XOR with the previous value of the same
+ * data source, of which only the bits that differ are stored. A point with
+ * unchanged values collected at a regular interval takes one bit per data
+ * source plus one bit. Times are kept with millisecond precision.
+ *
+ * The points are stored in chunks, and whole chunks are dropped once all of
+ * their points are older than the span.
+ */
+struct c_tsz_s;
+typedef struct c_tsz_s c_tsz_t;
+
+/* Returns NULL upon failure or if `values_num' or `span' are zero. */
+c_tsz_t *c_tsz_create(size_t values_num, cdtime_t span);
+void c_tsz_destroy(c_tsz_t *t);
+
+/* Appends a point. `time' must be later than the time of the last point,
+ * otherwise EINVAL is returned. Returns zero upon success. */
+int c_tsz_append(c_tsz_t *t, cdtime_t time, gauge_t const *values);
+
+/*
+ * NAME
+ *   c_tsz_read
+ *
+ * DESCRIPTION
+ *   Decodes the points with a time within [start, end] into newly allocated
+ *   arrays: one time per point in `ret_times' and `values_num' values per
+ *   point, point after point, in `ret_values'. Both have to be freed by the
+ *   caller. If there are no such points, both are set to NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise.
+ */
+int c_tsz_read(c_tsz_t const *t, cdtime_t start, cdtime_t end,
+               cdtime_t **ret_times, gauge_t **ret_values, size_t *ret_num);
+
+/*
+ * NAME
+ *   c_tsz_encode
+ *
+ * DESCRIPTION
+ *   Encodes `num' points, given like `c_tsz_read' returns them, into a
+ *   self-contained block of `*ret_size' bytes, which has to be freed by the
+ *   caller. Unlike a series, the block doesn't depend on the byte order of
+ *   the host. Points whose time is within the millisecond of the point before
+ *   them are skipped, so the number of points in the block, `*ret_num', may
+ *   be less than `num'.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise: ERANGE if the times are not
+ *   ordered or two consecutive points are more than 24 days apart.
+ */
+int c_tsz_encode(size_t values_num, cdtime_t const *times,
+                 gauge_t const *values, size_t num, uint8_t **ret_buf,
+                 size_t *ret_size, size_t *ret_num);
+
+/* Decodes the `num' points of a block written by `c_tsz_encode' into `times'
+ * and `values', which have room for `num' points. Returns EINVAL if the block
+ * is shorter than the points require. */
+int c_tsz_decode(size_t values_num, uint8_t const *buf, size_t size,
+                 size_t num, cdtime_t *times, gauge_t *values);
+
+/* Returns the number of points kept. */
+size_t c_tsz_points(c_tsz_t const *t);
+
+/* Returns the memory used by `t' in bytes. */
+size_t c_tsz_memory(c_tsz_t const *t);
+
+#endif /* UTILS_TSZ_H */
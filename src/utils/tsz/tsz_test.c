@@ -0,0 +1,201 @@
+/**
+ * collectd - src/utils/tsz/tsz_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/tsz/tsz.h"
+
+#define T(ms) MS_TO_CDTIME_T(1792000000000ull + (ms))
+
+static bool same_gauge(gauge_t a, gauge_t b) {
+  return (memcmp(&a, &b, sizeof(a)) == 0);
+}
+
+DEF_TEST(round_trip) {
+  c_tsz_t *t;
+  CHECK_NOT_NULL(t = c_tsz_create(3, TIME_T_TO_CDTIME_T(86400 * 365)));
+
+  enum { N = 2000 };
+  static cdtime_t times[N];
+  static gauge_t values[3 * N];
+
+  uint64_t ms = 0;
+  uint32_t seed = 1;
+  for (size_t i = 0; i < N; i++) {
+    seed = seed * 1103515245 + 12345;
+    /* Mostly regular, with jitter, the occasional gap, and one gap that
+     * doesn't fit the time encoding. */
+    ms += 1000 + (seed >> 28);
+    if (i % 97 == 0)
+      ms += 5000 * (seed >> 24);
+    if (i == 1500)
+      ms += 30ull * 86400 * 1000;
+    times[i] = T(ms);
+
+    values[3 * i] = 42.0;
+    values[3 * i + 1] = (gauge_t)i * 0.1;
+    values[3 * i + 2] =
+        (i % 13 == 0) ? NAN : (gauge_t)(int32_t)seed / 3.0 * ((i % 7) - 3);
+    if (i % 101 == 0)
+      values[3 * i + 2] = INFINITY;
+
+    EXPECT_EQ_INT(0, c_tsz_append(t, times[i], values + 3 * i));
+  }
+  EXPECT_EQ_UINT64(N, c_tsz_points(t));
+
+  /* Times must increase. */
+  EXPECT_EQ_INT(EINVAL, c_tsz_append(t, times[N - 1], values));
+
+  cdtime_t *ret_times = NULL;
+  gauge_t *ret_values = NULL;
+  size_t num = 0;
+  CHECK_ZERO(c_tsz_read(t, 0, UINT64_MAX, &ret_times, &ret_values, &num));
+  EXPECT_EQ_UINT64(N, num);
+  for (size_t i = 0; (i < num) && (i < N); i++) {
+    EXPECT_EQ_UINT64(times[i], ret_times[i]);
+    for (size_t j = 0; j < 3; j++)
+      OK1(same_gauge(values[3 * i + j], ret_values[3 * i + j]),
+          "value decodes to the same bits");
+  }
+  free(ret_times);
+  free(ret_values);
+
+  /* A range in the middle, including its end points. */
+  CHECK_ZERO(
+      c_tsz_read(t, times[700], times[899], &ret_times, &ret_values, &num));
+  EXPECT_EQ_UINT64(200, num);
+  EXPECT_EQ_UINT64(times[700], ret_times[0]);
+  EXPECT_EQ_UINT64(times[899], ret_times[num - 1]);
+  EXPECT_EQ_DOUBLE(values[3 * 750 + 1], ret_values[3 * 50 + 1]);
+  free(ret_times);
+  free(ret_values);
+
+  /* No points. */
+  CHECK_ZERO(c_tsz_read(t, times[N - 1] + 1, UINT64_MAX, &ret_times,
+                        &ret_values, &num));
+  EXPECT_EQ_UINT64(0, num);
+  EXPECT_EQ_PTR(NULL, ret_times);
+
+  c_tsz_destroy(t);
+  return 0;
+}
+
+DEF_TEST(expire) {
+  c_tsz_t *t;
+  CHECK_NOT_NULL(t = c_tsz_create(1, TIME_T_TO_CDTIME_T(60)));
+
+  gauge_t v = 1.0;
+  for (uint64_t i = 0; i < 1000; i++)
+    CHECK_ZERO(c_tsz_append(t, T(1000 * i), &v));
+
+  /* The last minute is kept, plus at most a quarter of it. */
+  size_t points = c_tsz_points(t);
+  OK1((points >= 60) && (points <= 76), "points of the last 75 seconds");
+
+  cdtime_t *times = NULL;
+  gauge_t *values = NULL;
+  size_t num = 0;
+  CHECK_ZERO(c_tsz_read(t, T(1000 * 939), UINT64_MAX, &times, &values, &num));
+  EXPECT_EQ_UINT64(61, num);
+  free(times);
+  free(values);
+
+  c_tsz_destroy(t);
+  return 0;
+}
+
+DEF_TEST(compression) {
+  c_tsz_t *t;
+  CHECK_NOT_NULL(t = c_tsz_create(1, TIME_T_TO_CDTIME_T(900)));
+
+  /* A gauge collected every second that rarely changes: about two bits per
+   * point. */
+  for (uint64_t i = 0; i < 900; i++) {
+    gauge_t v = (gauge_t)(i / 100);
+    CHECK_ZERO(c_tsz_append(t, T(1000 * i), &v));
+  }
+  EXPECT_EQ_UINT64(900, c_tsz_points(t));
+  OK1(c_tsz_memory(t) < 900, "less than a byte per point");
+
+  c_tsz_destroy(t);
+  return 0;
+}
+
+DEF_TEST(encode) {
+  enum { N = 500 };
+  static cdtime_t times[N];
+  static gauge_t values[2 * N];
+  static cdtime_t got_times[N];
+  static gauge_t got_values[2 * N];
+
+  for (size_t i = 0; i < N; i++) {
+    times[i] = T(10000 * i + (i % 3));
+    values[2 * i] = (gauge_t)(i / 10);
+    values[2 * i + 1] = (i % 17 == 0) ? NAN : 1.0 / (gauge_t)(i + 1);
+  }
+
+  uint8_t *buf = NULL;
+  size_t size = 0;
+  size_t num = 0;
+  CHECK_ZERO(c_tsz_encode(2, times, values, N, &buf, &size, &num));
+  EXPECT_EQ_UINT64(N, num);
+  OK1(size < N * 2 * sizeof(gauge_t), "smaller than the raw values");
+
+  CHECK_ZERO(c_tsz_decode(2, buf, size, N, got_times, got_values));
+  for (size_t i = 0; i < N; i++) {
+    EXPECT_EQ_UINT64(times[i], got_times[i]);
+    OK(same_gauge(values[2 * i], got_values[2 * i]));
+    OK(same_gauge(values[2 * i + 1], got_values[2 * i + 1]));
+  }
+
+  /* A truncated block is noticed. */
+  EXPECT_EQ_INT(EINVAL, c_tsz_decode(2, buf, size / 2, N, got_times,
+                                     got_values));
+  free(buf);
+
+  /* Points within the same millisecond are skipped, unordered points and
+   * gaps that don't fit the encoding are rejected. */
+  cdtime_t same[] = {T(0), T(0) + 1, T(1000)};
+  CHECK_ZERO(c_tsz_encode(1, same, values, 3, &buf, &size, &num));
+  EXPECT_EQ_UINT64(2, num);
+  CHECK_ZERO(c_tsz_decode(1, buf, size, num, got_times, got_values));
+  EXPECT_EQ_UINT64(T(1000), got_times[1]);
+  free(buf);
+
+  cdtime_t unordered[] = {T(1000), T(0)};
+  EXPECT_EQ_INT(ERANGE,
+                c_tsz_encode(1, unordered, values, 2, &buf, &size, &num));
+  cdtime_t gap[] = {T(0), T(30ull * 86400 * 1000)};
+  EXPECT_EQ_INT(ERANGE,
+                c_tsz_encode(1, gap, values, 2, &buf, &size, &num));
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(round_trip);
+  RUN_TEST(expire);
+  RUN_TEST(compression);
+  RUN_TEST(encode);
+
+  END_TEST;
+}
@@ -103,11 +103,10 @@ static int luaC_pushvalues(lua_State *L, const data_set_t *ds,
 {
   assert(vl->values_len == ds->ds_num);
 
-  lua_newtable(L);
+  lua_createtable(L, /* narr = */ (int)vl->values_len, /* nrec = */ 0);
   for (size_t i = 0; i < vl->values_len; i++) {
-    lua_pushinteger(L, (lua_Integer)i + 1);
     luaC_pushvalue(L, vl->values[i], ds->ds[i].type);
-    lua_settable(L, -3);
+    lua_rawseti(L, -2, (int)i + 1);
   }
 
   return 0;
@@ -137,6 +136,44 @@ static int luaC_pushdsnames(lua_State *L, const data_set_t *ds) /* {{{ */
   return 0;
 } /* }}} int luaC_pushdsnames */
 
+/* Registry key of the table caching the "dstypes" and "dsnames" tables. */
+static char ds_cache_key;
+
+/* Pushes the "dstypes" and "dsnames" tables of "ds". They only depend on the
+ * data set, so each state builds them once per type and passes the same
+ * tables to all write callbacks. */
+static int luaC_pushdsinfo(lua_State *L, const data_set_t *ds) /* {{{ */
+{
+  lua_pushlightuserdata(L, &ds_cache_key);
+  lua_rawget(L, LUA_REGISTRYINDEX); /* +1 = 1 */
+  if (!lua_istable(L, -1)) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushlightuserdata(L, &ds_cache_key);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+  }
+
+  lua_getfield(L, -1, ds->type); /* +1 = 2 */
+  if (!lua_istable(L, -1)) {
+    lua_pop(L, 1);
+    lua_createtable(L, /* narr = */ 2, /* nrec = */ 0);
+    luaC_pushdstypes(L, ds);
+    lua_rawseti(L, -2, 1);
+    luaC_pushdsnames(L, ds);
+    lua_rawseti(L, -2, 2);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -3, ds->type);
+  }
+
+  lua_rawgeti(L, -1, 1); /* +1 = 3 */
+  lua_rawgeti(L, -2, 2); /* +1 = 4 */
+  lua_remove(L, -3);
+  lua_remove(L, -3); /* -2 = 2 */
+
+  return 0;
+} /* }}} int luaC_pushdsinfo */
+
 /*
  * Public functions
  */
@@ -281,7 +318,7 @@ int luaC_pushvalue(lua_State *L, value_t v, int ds_type) /* {{{ */
 int luaC_pushvaluelist(lua_State *L, const data_set_t *ds,
                        const value_list_t *vl) /* {{{ */
 {
-  lua_newtable(L);
+  lua_createtable(L, /* narr = */ 0, /* nrec = */ 10);
 
   lua_pushstring(L, vl->host);
   lua_setfield(L, -2, "host");
@@ -299,12 +336,10 @@ int luaC_pushvaluelist(lua_State *L, const data_set_t *ds,
   luaC_pushvalues(L, ds, vl);
   lua_setfield(L, -2, "values");
 
-  luaC_pushdstypes(L, ds);
+  luaC_pushdsinfo(L, ds);
+  lua_setfield(L, -3, "dsnames");
   lua_setfield(L, -2, "dstypes");
 
-  luaC_pushdsnames(L, ds);
-  lua_setfield(L, -2, "dsnames");
-
   luaC_pushcdtime(L, vl->time);
   lua_setfield(L, -2, "time");
 
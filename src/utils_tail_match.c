@@ -56,9 +56,15 @@ struct cu_tail_match_match_s {
 typedef struct cu_tail_match_match_s cu_tail_match_match_t;
 
 struct cu_tail_match_s {
+  /* Exactly one of "tail" and "set" is used. */
   cu_tail_t *tail;
+  cu_tail_set_t *set;
   cu_tail_match_match_t *matches;
   size_t matches_num;
+
+  /* Built by the first read after a match has been added. */
+  cu_match_prefilter_t *prefilter;
+  bool *candidates;
 };
 
 /*
@@ -171,12 +177,52 @@ static int tail_callback(void *data, char *buf,
                          int __attribute__((unused)) buflen) {
   cu_tail_match_t *obj = (cu_tail_match_t *)data;
 
+  if (obj->prefilter == NULL) {
+    for (size_t i = 0; i < obj->matches_num; i++)
+      match_apply(obj->matches[i].match, buf);
+    return 0;
+  }
+
+  /* Only lines containing the literals of a match are handed to regexec. */
+  if (match_prefilter_apply(obj->prefilter, buf, obj->candidates) == 0)
+    return 0;
+
   for (size_t i = 0; i < obj->matches_num; i++)
-    match_apply(obj->matches[i].match, buf);
+    if (obj->candidates[i])
+      match_apply(obj->matches[i].match, buf);
 
   return 0;
 } /* int tail_callback */
 
+static void tail_match_prefilter_free(cu_tail_match_t *obj) {
+  match_prefilter_destroy(obj->prefilter);
+  obj->prefilter = NULL;
+  sfree(obj->candidates);
+} /* void tail_match_prefilter_free */
+
+/* Failing to build the prefilter only means that every line is matched
+ * against every regex. */
+static void tail_match_prefilter_build(cu_tail_match_t *obj) {
+  if ((obj->prefilter != NULL) || (obj->matches_num == 0))
+    return;
+
+  cu_match_t **matches = calloc(obj->matches_num, sizeof(*matches));
+  obj->candidates = calloc(obj->matches_num, sizeof(*obj->candidates));
+  if ((matches == NULL) || (obj->candidates == NULL)) {
+    sfree(matches);
+    sfree(obj->candidates);
+    return;
+  }
+
+  for (size_t i = 0; i < obj->matches_num; i++)
+    matches[i] = obj->matches[i].match;
+  obj->prefilter = match_prefilter_create(matches, obj->matches_num);
+  sfree(matches);
+
+  if (obj->prefilter == NULL)
+    sfree(obj->candidates);
+} /* void tail_match_prefilter_build */
+
 static void tail_match_simple_free(void *data) {
   cu_tail_match_simple_t *user_data = (cu_tail_match_simple_t *)data;
   latency_config_free(user_data->latency_config);
@@ -193,8 +239,13 @@ cu_tail_match_t *tail_match_create(const char *filename) {
   if (obj == NULL)
     return NULL;
 
-  obj->tail = cu_tail_create(filename);
-  if (obj->tail == NULL) {
+  /* A file name with wildcards follows all matching files. Their lines are
+   * matched against the same matches. */
+  if (strpbrk(filename, "*?[") != NULL)
+    obj->set = cu_tail_set_create(filename);
+  else
+    obj->tail = cu_tail_create(filename);
+  if ((obj->tail == NULL) && (obj->set == NULL)) {
     sfree(obj);
     return NULL;
   }
@@ -210,6 +261,12 @@ void tail_match_destroy(cu_tail_match_t *obj) {
     cu_tail_destroy(obj->tail);
     obj->tail = NULL;
   }
+  if (obj->set != NULL) {
+    cu_tail_set_destroy(obj->set);
+    obj->set = NULL;
+  }
+
+  tail_match_prefilter_free(obj);
 
   for (size_t i = 0; i < obj->matches_num; i++) {
     cu_tail_match_match_t *match = obj->matches + i;
@@ -234,6 +291,8 @@ int tail_match_add_match(cu_tail_match_t *obj, cu_match_t *match,
                          void (*free_user_data)(void *user_data)) {
   cu_tail_match_match_t *temp;
 
+  tail_match_prefilter_free(obj);
+
   temp = realloc(obj->matches,
                  sizeof(cu_tail_match_match_t) * (obj->matches_num + 1));
   if (temp == NULL)
@@ -310,8 +369,14 @@ int tail_match_read(cu_tail_match_t *obj) {
   char buffer[4096];
   int status;
 
-  status = cu_tail_read(obj->tail, buffer, sizeof(buffer), tail_callback,
-                        (void *)obj);
+  tail_match_prefilter_build(obj);
+
+  if (obj->set != NULL)
+    status = cu_tail_set_read(obj->set, buffer, sizeof(buffer), tail_callback,
+                              (void *)obj);
+  else
+    status = cu_tail_read(obj->tail, buffer, sizeof(buffer), tail_callback,
+                          (void *)obj);
   if (status != 0) {
     ERROR("tail_match: cu_tail_read failed.");
     return status;
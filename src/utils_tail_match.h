@@ -47,7 +47,8 @@ typedef struct cu_tail_match_s cu_tail_match_t;
  *   Allocates, initializes and returns a new `cu_tail_match_t' object.
  *
  * PARAMETERS
- *   `filename'  The name to read data from.
+ *   `filename'  The name to read data from. If it contains wildcards, all
+ *               matching files are read, see `cu_tail_set_create'.
  *
  * RETURN VALUE
  *   Returns NULL upon failure, non-NULL otherwise.
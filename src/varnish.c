@@ -46,6 +46,24 @@ typedef struct VSC_C_main c_varnish_stats_t;
 typedef struct varnish_stats c_varnish_stats_t;
 #endif
 
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+typedef struct {
+  size_t flag;
+  const char *name;
+  const char *category;
+  const char *type;
+  const char *type_instance;
+  int ds_type;
+} varnish_field_t;
+#endif
+
+#if HAVE_VARNISH_V5
+typedef struct {
+  const volatile uint64_t *ptr;
+  const varnish_field_t *field;
+} varnish_point_t;
+#endif
+
 /* {{{ user_config_s */
 struct user_config_s {
   char *instance;
@@ -90,6 +108,24 @@ struct user_config_s {
   bool collect_vbe;
   bool collect_mse;
 #endif
+
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+  /* Counters selected by the options above, sorted by name. */
+  const varnish_field_t **fields;
+  size_t fields_num;
+#endif
+#if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+  const char *stevedore_category;
+#endif
+#if HAVE_VARNISH_V5
+  struct vsm *vd;
+  struct vsc *vsc;
+  /* Points found by the last VSC_Iter, valid while "points_valid" is set. */
+  varnish_point_t *points;
+  size_t points_num;
+  size_t points_size;
+  bool points_valid;
+#endif
 };
 typedef struct user_config_s user_config_t; /* }}} */
 
@@ -139,853 +175,649 @@ static int varnish_submit_derive(const char *plugin_instance, /* {{{ */
 } /* }}} int varnish_submit_derive */
 
 #if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-static int varnish_monitor(void *priv,
-                           const struct VSC_point *const pt) /* {{{ */
-{
-  uint64_t val;
-  const user_config_t *conf;
-  const char *name;
-
-  if (pt == NULL)
-    return 0;
-
-  conf = priv;
-
-#if HAVE_VARNISH_V5
-  char namebuff[DATA_MAX_NAME_LEN];
-
-  char const *c = strrchr(pt->name, '.');
-  if (c == NULL) {
-    return EINVAL;
-  }
-  sstrncpy(namebuff, c + 1, sizeof(namebuff));
-  name = namebuff;
-
-#elif HAVE_VARNISH_V4
-  if (strcmp(pt->section->fantom->type, "MAIN") != 0)
-    return 0;
-
-  name = pt->desc->name;
-#elif HAVE_VARNISH_V3
-  if (strcmp(pt->class, "") != 0)
-    return 0;
-
-  name = pt->name;
-#endif
-
-  val = *(const volatile uint64_t *)pt->ptr;
-
-  if (conf->collect_cache) {
-    if (strcmp(name, "cache_hit") == 0)
-      return varnish_submit_derive(conf->instance, "cache", "cache_result",
-                                   "hit", val);
-    else if (strcmp(name, "cache_miss") == 0)
-      return varnish_submit_derive(conf->instance, "cache", "cache_result",
-                                   "miss", val);
-    else if (strcmp(name, "cache_hitpass") == 0)
-      return varnish_submit_derive(conf->instance, "cache", "cache_result",
-                                   "hitpass", val);
-  }
-
-  if (conf->collect_connections) {
-    if (strcmp(name, "client_conn") == 0)
-      return varnish_submit_derive(conf->instance, "connections", "connections",
-                                   "accepted", val);
-    else if (strcmp(name, "client_drop") == 0)
-      return varnish_submit_derive(conf->instance, "connections", "connections",
-                                   "dropped", val);
-    else if (strcmp(name, "client_req") == 0)
-      return varnish_submit_derive(conf->instance, "connections", "connections",
-                                   "received", val);
+#define VARNISH_FLAG(f) offsetof(user_config_t, collect_##f)
+
+/* varnish_fields maps the names of the counters to the values they are
+ * submitted as. "flag" is the offset of the "collect_*" member enabling the
+ * counter. If a name appears more than once, the first enabled entry is used.
+ * Entries without a category are the counters shared by all stevedores, which
+ * are reported in the category of the first enabled stevedore. */
+static const varnish_field_t varnish_fields[] = {
+    {VARNISH_FLAG(cache), "cache_hit", "cache", "cache_result", "hit",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(cache), "cache_miss", "cache", "cache_result", "miss",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(cache), "cache_hitpass", "cache", "cache_result", "hitpass",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(connections), "client_conn", "connections", "connections",
+     "accepted", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(connections), "client_drop", "connections", "connections",
+     "dropped", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(connections), "client_req", "connections", "connections",
+     "received", DS_TYPE_DERIVE},
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-    else if (strcmp(name, "client_req_400") == 0)
-      return varnish_submit_derive(conf->instance, "connections", "connections",
-                                   "error_400", val);
-    else if (strcmp(name, "client_req_417") == 0)
-      return varnish_submit_derive(conf->instance, "connections", "connections",
-                                   "error_417", val);
+    {VARNISH_FLAG(connections), "client_req_400", "connections", "connections",
+     "error_400", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(connections), "client_req_417", "connections", "connections",
+     "error_417", DS_TYPE_DERIVE},
 #endif
-  }
-
 #ifdef HAVE_VARNISH_V3
-  if (conf->collect_dirdns) {
-    if (strcmp(name, "dir_dns_lookups") == 0)
-      return varnish_submit_derive(conf->instance, "dirdns", "cache_operation",
-                                   "lookups", val);
-    else if (strcmp(name, "dir_dns_failed") == 0)
-      return varnish_submit_derive(conf->instance, "dirdns", "cache_result",
-                                   "failed", val);
-    else if (strcmp(name, "dir_dns_hit") == 0)
-      return varnish_submit_derive(conf->instance, "dirdns", "cache_result",
-                                   "hits", val);
-    else if (strcmp(name, "dir_dns_cache_full") == 0)
-      return varnish_submit_derive(conf->instance, "dirdns", "cache_result",
-                                   "cache_full", val);
-  }
+    {VARNISH_FLAG(dirdns), "dir_dns_lookups", "dirdns", "cache_operation",
+     "lookups", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(dirdns), "dir_dns_failed", "dirdns", "cache_result", "failed",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(dirdns), "dir_dns_hit", "dirdns", "cache_result", "hits",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(dirdns), "dir_dns_cache_full", "dirdns", "cache_result",
+     "cache_full", DS_TYPE_DERIVE},
 #endif
-
-  if (conf->collect_esi) {
-    if (strcmp(name, "esi_errors") == 0)
-      return varnish_submit_derive(conf->instance, "esi", "total_operations",
-                                   "error", val);
-    else if (strcmp(name, "esi_parse") == 0)
-      return varnish_submit_derive(conf->instance, "esi", "total_operations",
-                                   "parsed", val);
-    else if (strcmp(name, "esi_warnings") == 0)
-      return varnish_submit_derive(conf->instance, "esi", "total_operations",
-                                   "warning", val);
-    else if (strcmp(name, "esi_maxdepth") == 0)
-      return varnish_submit_derive(conf->instance, "esi", "total_operations",
-                                   "max_depth", val);
-  }
-
-  if (conf->collect_backend) {
-    if (strcmp(name, "backend_conn") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "success", val);
-    else if (strcmp(name, "backend_unhealthy") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "not-attempted", val);
-    else if (strcmp(name, "backend_busy") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "too-many", val);
-    else if (strcmp(name, "backend_fail") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "failures", val);
-    else if (strcmp(name, "backend_reuse") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "reuses", val);
-    else if (strcmp(name, "backend_toolate") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "was-closed", val);
-    else if (strcmp(name, "backend_recycle") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "recycled", val);
-    else if (strcmp(name, "backend_unused") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "unused", val);
-    else if (strcmp(name, "backend_retry") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "connections",
-                                   "retries", val);
-    else if (strcmp(name, "backend_req") == 0)
-      return varnish_submit_derive(conf->instance, "backend", "http_requests",
-                                   "requests", val);
-    else if (strcmp(name, "n_backend") == 0)
-      return varnish_submit_gauge(conf->instance, "backend", "backends",
-                                  "n_backends", val);
-  }
-
-  if (conf->collect_fetch) {
-    if (strcmp(name, "fetch_head") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "head", val);
-    else if (strcmp(name, "fetch_length") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "length", val);
-    else if (strcmp(name, "fetch_chunked") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "chunked", val);
-    else if (strcmp(name, "fetch_eof") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "eof", val);
-    else if (strcmp(name, "fetch_bad") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "bad_headers", val);
-    else if (strcmp(name, "fetch_close") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "close", val);
-    else if (strcmp(name, "fetch_oldhttp") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "oldhttp", val);
-    else if (strcmp(name, "fetch_zero") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "zero", val);
-    else if (strcmp(name, "fetch_failed") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "failed", val);
-    else if (strcmp(name, "fetch_1xx") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "no_body_1xx", val);
-    else if (strcmp(name, "fetch_204") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "no_body_204", val);
-    else if (strcmp(name, "fetch_304") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "no_body_304", val);
+    {VARNISH_FLAG(esi), "esi_errors", "esi", "total_operations", "error",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(esi), "esi_parse", "esi", "total_operations", "parsed",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(esi), "esi_warnings", "esi", "total_operations", "warning",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(esi), "esi_maxdepth", "esi", "total_operations", "max_depth",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_conn", "backend", "connections", "success",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_unhealthy", "backend", "connections",
+     "not-attempted", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_busy", "backend", "connections",
+     "too-many", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_fail", "backend", "connections",
+     "failures", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_reuse", "backend", "connections", "reuses",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_toolate", "backend", "connections",
+     "was-closed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_recycle", "backend", "connections",
+     "recycled", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_unused", "backend", "connections",
+     "unused", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_retry", "backend", "connections",
+     "retries", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "backend_req", "backend", "http_requests",
+     "requests", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(backend), "n_backend", "backend", "backends", "n_backends",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(fetch), "fetch_head", "fetch", "http_requests", "head",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_length", "fetch", "http_requests", "length",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_chunked", "fetch", "http_requests", "chunked",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_eof", "fetch", "http_requests", "eof",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_bad", "fetch", "http_requests", "bad_headers",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_close", "fetch", "http_requests", "close",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_oldhttp", "fetch", "http_requests", "oldhttp",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_zero", "fetch", "http_requests", "zero",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_failed", "fetch", "http_requests", "failed",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_1xx", "fetch", "http_requests", "no_body_1xx",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_204", "fetch", "http_requests", "no_body_204",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_304", "fetch", "http_requests", "no_body_304",
+     DS_TYPE_DERIVE},
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-    else if (strcmp(name, "fetch_no_thread") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "no_thread", val);
-    else if (strcmp(name, "fetch_none") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "none", val);
-    else if (strcmp(name, "busy_sleep") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "busy_sleep", val);
-    else if (strcmp(name, "busy_wakeup") == 0)
-      return varnish_submit_derive(conf->instance, "fetch", "http_requests",
-                                   "busy_wakeup", val);
+    {VARNISH_FLAG(fetch), "fetch_no_thread", "fetch", "http_requests",
+     "no_thread", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "fetch_none", "fetch", "http_requests", "none",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "busy_sleep", "fetch", "http_requests", "busy_sleep",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(fetch), "busy_wakeup", "fetch", "http_requests",
+     "busy_wakeup", DS_TYPE_DERIVE},
 #endif
-  }
-
-  if (conf->collect_hcb) {
-    if (strcmp(name, "hcb_nolock") == 0)
-      return varnish_submit_derive(conf->instance, "hcb", "cache_operation",
-                                   "lookup_nolock", val);
-    else if (strcmp(name, "hcb_lock") == 0)
-      return varnish_submit_derive(conf->instance, "hcb", "cache_operation",
-                                   "lookup_lock", val);
-    else if (strcmp(name, "hcb_insert") == 0)
-      return varnish_submit_derive(conf->instance, "hcb", "cache_operation",
-                                   "insert", val);
-  }
-
-  if (conf->collect_objects) {
-    if (strcmp(name, "n_expired") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "expired", val);
-    else if (strcmp(name, "n_lru_nuked") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "lru_nuked", val);
-    else if (strcmp(name, "n_lru_saved") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "lru_saved", val);
-    else if (strcmp(name, "n_lru_moved") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "lru_moved", val);
-    else if (strcmp(name, "n_deathrow") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "deathrow", val);
-    else if (strcmp(name, "losthdr") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "header_overflow", val);
-    else if (strcmp(name, "n_obj_purged") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "purged", val);
-    else if (strcmp(name, "n_objsendfile") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "sent_sendfile", val);
-    else if (strcmp(name, "n_objwrite") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "sent_write", val);
-    else if (strcmp(name, "n_objoverflow") == 0)
-      return varnish_submit_derive(conf->instance, "objects", "total_objects",
-                                   "workspace_overflow", val);
+    {VARNISH_FLAG(hcb), "hcb_nolock", "hcb", "cache_operation", "lookup_nolock",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(hcb), "hcb_lock", "hcb", "cache_operation", "lookup_lock",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(hcb), "hcb_insert", "hcb", "cache_operation", "insert",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_expired", "objects", "total_objects", "expired",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_lru_nuked", "objects", "total_objects",
+     "lru_nuked", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_lru_saved", "objects", "total_objects",
+     "lru_saved", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_lru_moved", "objects", "total_objects",
+     "lru_moved", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_deathrow", "objects", "total_objects",
+     "deathrow", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "losthdr", "objects", "total_objects",
+     "header_overflow", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_obj_purged", "objects", "total_objects",
+     "purged", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_objsendfile", "objects", "total_objects",
+     "sent_sendfile", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_objwrite", "objects", "total_objects",
+     "sent_write", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(objects), "n_objoverflow", "objects", "total_objects",
+     "workspace_overflow", DS_TYPE_DERIVE},
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-    else if (strcmp(name, "exp_mailed") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "exp_mailed", val);
-    else if (strcmp(name, "exp_received") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "exp_received", val);
+    {VARNISH_FLAG(objects), "exp_mailed", "struct", "objects", "exp_mailed",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(objects), "exp_received", "struct", "objects", "exp_received",
+     DS_TYPE_GAUGE},
 #endif
-  }
-
 #if HAVE_VARNISH_V3
-  if (conf->collect_ban) {
-    if (strcmp(name, "n_ban") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "total", val);
-    else if (strcmp(name, "n_ban_add") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "added", val);
-    else if (strcmp(name, "n_ban_retire") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "deleted", val);
-    else if (strcmp(name, "n_ban_obj_test") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "objects_tested", val);
-    else if (strcmp(name, "n_ban_re_test") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "regexps_tested", val);
-    else if (strcmp(name, "n_ban_dups") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "duplicate", val);
-  }
+    {VARNISH_FLAG(ban), "n_ban", "ban", "total_operations", "total",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "n_ban_add", "ban", "total_operations", "added",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "n_ban_retire", "ban", "total_operations", "deleted",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "n_ban_obj_test", "ban", "total_operations",
+     "objects_tested", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "n_ban_re_test", "ban", "total_operations",
+     "regexps_tested", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "n_ban_dups", "ban", "total_operations", "duplicate",
+     DS_TYPE_DERIVE},
 #endif
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-  if (conf->collect_ban) {
-    if (strcmp(name, "bans") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "total", val);
-    else if (strcmp(name, "bans_added") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "added", val);
-    else if (strcmp(name, "bans_obj") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "obj", val);
-    else if (strcmp(name, "bans_req") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "req", val);
-    else if (strcmp(name, "bans_completed") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "completed", val);
-    else if (strcmp(name, "bans_deleted") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "deleted", val);
-    else if (strcmp(name, "bans_tested") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "tested", val);
-    else if (strcmp(name, "bans_dups") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "duplicate", val);
-    else if (strcmp(name, "bans_tested") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "tested", val);
-    else if (strcmp(name, "bans_lurker_contention") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "lurker_contention", val);
-    else if (strcmp(name, "bans_lurker_obj_killed") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "lurker_obj_killed", val);
-    else if (strcmp(name, "bans_lurker_tested") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "lurker_tested", val);
-    else if (strcmp(name, "bans_lurker_tests_tested") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "lurker_tests_tested", val);
-    else if (strcmp(name, "bans_obj_killed") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "obj_killed", val);
-    else if (strcmp(name, "bans_persisted_bytes") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_bytes",
-                                   "persisted_bytes", val);
-    else if (strcmp(name, "bans_persisted_fragmentation") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_bytes",
-                                   "persisted_fragmentation", val);
-    else if (strcmp(name, "bans_tests_tested") == 0)
-      return varnish_submit_derive(conf->instance, "ban", "total_operations",
-                                   "tests_tested", val);
-  }
+    {VARNISH_FLAG(ban), "bans", "ban", "total_operations", "total",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_added", "ban", "total_operations", "added",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_obj", "ban", "total_operations", "obj",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_req", "ban", "total_operations", "req",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_completed", "ban", "total_operations",
+     "completed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_deleted", "ban", "total_operations", "deleted",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_tested", "ban", "total_operations", "tested",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_dups", "ban", "total_operations", "duplicate",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_tested", "ban", "total_operations", "tested",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_lurker_contention", "ban", "total_operations",
+     "lurker_contention", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_lurker_obj_killed", "ban", "total_operations",
+     "lurker_obj_killed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_lurker_tested", "ban", "total_operations",
+     "lurker_tested", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_lurker_tests_tested", "ban", "total_operations",
+     "lurker_tests_tested", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_obj_killed", "ban", "total_operations",
+     "obj_killed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_persisted_bytes", "ban", "total_bytes",
+     "persisted_bytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_persisted_fragmentation", "ban", "total_bytes",
+     "persisted_fragmentation", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(ban), "bans_tests_tested", "ban", "total_operations",
+     "tests_tested", DS_TYPE_DERIVE},
 #endif
+    {VARNISH_FLAG(session), "sess_closed", "session", "total_operations",
+     "closed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_pipeline", "session", "total_operations",
+     "pipeline", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_readahead", "session", "total_operations",
+     "readahead", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_conn", "session", "total_operations",
+     "accepted", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_drop", "session", "total_operations",
+     "dropped", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_fail", "session", "total_operations",
+     "failed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_pipe_overflow", "session", "total_operations",
+     "overflow", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_queued", "session", "total_operations",
+     "queued", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_linger", "session", "total_operations",
+     "linger", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_herd", "session", "total_operations", "herd",
+     DS_TYPE_DERIVE},
+#if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+    {VARNISH_FLAG(session), "sess_closed_err", "session", "total_operations",
+     "closed_err", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(session), "sess_dropped", "session", "total_operations",
+     "dropped_for_thread", DS_TYPE_DERIVE},
+#endif
+    {VARNISH_FLAG(shm), "shm_records", "shm", "total_operations", "records",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(shm), "shm_writes", "shm", "total_operations", "writes",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(shm), "shm_flushes", "shm", "total_operations", "flushes",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(shm), "shm_cont", "shm", "total_operations", "contention",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(shm), "shm_cycles", "shm", "total_operations", "cycles",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sms), "sms_nreq", "sms", "total_requests", "allocator",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sms), "sms_nobj", "sms", "requests", "outstanding",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(sms), "sms_nbytes", "sms", "bytes", "outstanding",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(sms), "sms_balloc", "sms", "total_bytes", "allocated",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sms), "sms_bfree", "sms", "total_bytes", "free",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(struct), "n_sess_mem", "struct", "current_sessions",
+     "sess_mem", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_sess", "struct", "current_sessions", "sess",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_object", "struct", "objects", "object",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_vampireobject", "struct", "objects",
+     "vampireobject", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_objectcore", "struct", "objects", "objectcore",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_waitinglist", "struct", "objects", "waitinglist",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_objecthead", "struct", "objects", "objecthead",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_smf", "struct", "objects", "smf", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_smf_frag", "struct", "objects", "smf_frag",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_smf_large", "struct", "objects", "smf_large",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(struct), "n_vbe_conn", "struct", "objects", "vbe_conn",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(totals), "s_sess", "totals", "total_sessions", "sessions",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_req", "totals", "total_requests", "requests",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_pipe", "totals", "total_operations", "pipe",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_pass", "totals", "total_operations", "pass",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_fetch", "totals", "total_operations", "fetches",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_synth", "totals", "total_bytes", "synth",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_req_hdrbytes", "totals", "total_bytes",
+     "req_header", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_req_bodybytes", "totals", "total_bytes",
+     "req_body", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_req_protobytes", "totals", "total_bytes",
+     "req_proto", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_resp_hdrbytes", "totals", "total_bytes",
+     "resp_header", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_resp_bodybytes", "totals", "total_bytes",
+     "resp_body", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_resp_protobytes", "totals", "total_bytes",
+     "resp_proto", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_pipe_hdrbytes", "totals", "total_bytes",
+     "pipe_header", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_pipe_in", "totals", "total_bytes", "pipe_in",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_pipe_out", "totals", "total_bytes", "pipe_out",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "n_purges", "totals", "total_operations", "purges",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_hdrbytes", "totals", "total_bytes",
+     "header-bytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "s_bodybytes", "totals", "total_bytes", "body-bytes",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "n_gzip", "totals", "total_operations", "gzip",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(totals), "n_gunzip", "totals", "total_operations", "gunzip",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(uptime), "uptime", "uptime", "uptime", "client_uptime",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vcl), "n_vcl", "vcl", "vcl", "total_vcl", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vcl), "n_vcl_avail", "vcl", "vcl", "avail_vcl",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vcl), "n_vcl_discard", "vcl", "vcl", "discarded_vcl",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vcl), "vmods", "vcl", "objects", "vmod", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(workers), "threads", "workers", "threads", "worker",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(workers), "threads_created", "workers", "total_threads",
+     "created", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "threads_failed", "workers", "total_threads",
+     "failed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "threads_limited", "workers", "total_threads",
+     "limited", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "threads_destroyed", "workers", "total_threads",
+     "dropped", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "thread_queue_len", "workers", "queue_length",
+     "threads", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(workers), "n_wrk", "workers", "threads", "worker",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(workers), "n_wrk_create", "workers", "total_threads",
+     "created", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_failed", "workers", "total_threads",
+     "failed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_max", "workers", "total_threads", "limited",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_drop", "workers", "total_threads", "dropped",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_queue", "workers", "total_requests",
+     "queued", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_overflow", "workers", "total_requests",
+     "overflowed", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_queued", "workers", "total_requests",
+     "queued", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(workers), "n_wrk_lqueue", "workers", "total_requests",
+     "queue_length", DS_TYPE_DERIVE},
+#if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+    {VARNISH_FLAG(workers), "pools", "workers", "pools", "pools",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(workers), "busy_killed", "workers", "http_requests",
+     "busy_killed", DS_TYPE_DERIVE},
+#endif
+#if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+    {VARNISH_FLAG(vsm), "vsm_free", "vsm", "bytes", "free", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vsm), "vsm_used", "vsm", "bytes", "used", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vsm), "vsm_cooling", "vsm", "bytes", "cooling",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vsm), "vsm_overflow", "vsm", "bytes", "overflow",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(vsm), "vsm_overflowed", "vsm", "total_bytes", "overflowed",
+     DS_TYPE_DERIVE},
+    /* @TODO figure out the collectd type for bitmap: "happy" */
+    {VARNISH_FLAG(vbe), "bereq_hdrbytes", "vbe", "total_bytes",
+     "bereq_hdrbytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "bereq_bodybytes", "vbe", "total_bytes",
+     "bereq_bodybytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "bereq_protobytes", "vbe", "total_bytes",
+     "bereq_protobytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "beresp_hdrbytes", "vbe", "total_bytes",
+     "beresp_hdrbytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "beresp_bodybytes", "vbe", "total_bytes",
+     "beresp_bodybytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "beresp_protobytes", "vbe", "total_bytes",
+     "beresp_protobytes", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "pipe_hdrbytes", "vbe", "total_bytes", "pipe_hdrbytes",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "pipe_out", "vbe", "total_bytes", "pipe_out",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "pipe_in", "vbe", "total_bytes", "pipe_in",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "conn", "vbe", "connections", "c_conns",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(vbe), "req", "vbe", "http_requests", "b_reqs",
+     DS_TYPE_DERIVE},
+    /* All Stevedores support these counters */
+    {VARNISH_FLAG(sma), "c_req", NULL, "total_operations", "alloc_req",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sma), "c_fail", NULL, "total_operations", "alloc_fail",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sma), "c_bytes", NULL, "total_bytes", "bytes_allocated",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sma), "c_freed", NULL, "total_bytes", "bytes_freed",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sma), "g_alloc", NULL, "total_operations",
+     "alloc_outstanding", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(sma), "g_bytes", NULL, "bytes", "bytes_outstanding",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(sma), "g_space", NULL, "bytes", "bytes_available",
+     DS_TYPE_GAUGE},
+    /* No SMA specific counters */
+    {VARNISH_FLAG(smf), "g_smf", "smf", "objects", "n_struct_smf",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(smf), "g_smf_frag", "smf", "objects", "n_small_free_smf",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(smf), "g_smf_large", "smf", "objects", "n_large_free_smf",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mgt), "uptime", "mgt", "uptime", "mgt_proc_uptime",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mgt), "child_start", "mgt", "total_operations", "child_start",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mgt), "child_exit", "mgt", "total_operations", "child_exit",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mgt), "child_stop", "mgt", "total_operations", "child_stop",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mgt), "child_died", "mgt", "total_operations", "child_died",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mgt), "child_dump", "mgt", "total_operations", "child_dump",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mgt), "child_panic", "mgt", "total_operations", "child_panic",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(lck), "creat", "lck", "objects", "created", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(lck), "destroy", "lck", "objects", "destroyed",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(lck), "locks", "lck", "total_operations", "lock_ops",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mempool), "live", "mempool", "objects", "in_use",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "pool", "mempool", "objects", "in_pool",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "sz_wanted", "mempool", "bytes", "size_requested",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "sz_actual", "mempool", "bytes", "size_allocated",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "allocs", "mempool", "total_operations",
+     "allocations", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mempool), "frees", "mempool", "total_operations", "frees",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mempool), "recycle", "mempool", "objects", "recycled",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "timeout", "mempool", "objects", "timed_out",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "toosmall", "mempool", "objects", "too_small",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "surplus", "mempool", "objects", "surplus",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mempool), "randry", "mempool", "objects", "ran_dry",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "c_full", "mse", "total_operations", "full_allocs",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_truncated", "mse", "total_operations",
+     "truncated_allocs", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_expanded", "mse", "total_operations",
+     "expanded_allocs", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_failed", "mse", "total_operations", "failed_allocs",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_bytes", "mse", "total_bytes", "bytes_allocated",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_freed", "mse", "total_bytes", "bytes_freed",
+     DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "g_fo_alloc", "mse", "total_operations",
+     "fo_allocs_outstanding", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "g_fo_bytes", "mse", "bytes", "fo_bytes_outstanding",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_membuf_alloc", "mse", "objects", "membufs_allocated",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_membuf_inuse", "mse", "objects", "membufs_inuse",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_bans_bytes", "mse", "bytes",
+     "persisted_banspace_used", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_bans_space", "mse", "bytes",
+     "persisted_banspace_available", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_bans_persisted", "mse", "total_operations",
+     "bans_persisted", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "g_bans_lost", "mse", "total_operations", "bans_lost",
+     DS_TYPE_DERIVE},
+    /* mse seg */
+    {VARNISH_FLAG(mse), "g_journal_bytes", "mse_reg", "bytes",
+     "journal_bytes_used", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_journal_space", "mse_reg", "bytes",
+     "journal_bytes_free", DS_TYPE_GAUGE},
+    /* mse segagg */
+    {VARNISH_FLAG(mse), "g_bigspace", "mse_segagg", "bytes",
+     "big_extents_bytes_available", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_extfree", "mse_segagg", "objects", "free_extents",
+     DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_sparenode", "mse_segagg", "objects",
+     "spare_nodes_available", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_objnode", "mse_segagg", "objects",
+     "object_nodes_in_use", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_extnode", "mse_segagg", "objects",
+     "extent_nodes_in_use", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "g_bigextfree", "mse_segagg", "objects",
+     "free_big_extents", DS_TYPE_GAUGE},
+    {VARNISH_FLAG(mse), "c_pruneloop", "mse_segagg", "total_operations",
+     "prune_loops", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_pruned", "mse_segagg", "total_objects",
+     "pruned_objects", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_spared", "mse_segagg", "total_operations",
+     "spared_objects", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_skipped", "mse_segagg", "total_operations",
+     "missed_objects", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_nuked", "mse_segagg", "total_operations",
+     "nuked_objects", DS_TYPE_DERIVE},
+    {VARNISH_FLAG(mse), "c_sniped", "mse_segagg", "total_operations",
+     "sniped_objects", DS_TYPE_DERIVE},
+#endif
+};
 
-  if (conf->collect_session) {
-    if (strcmp(name, "sess_closed") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "closed", val);
-    else if (strcmp(name, "sess_pipeline") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "pipeline", val);
-    else if (strcmp(name, "sess_readahead") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "readahead", val);
-    else if (strcmp(name, "sess_conn") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "accepted", val);
-    else if (strcmp(name, "sess_drop") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "dropped", val);
-    else if (strcmp(name, "sess_fail") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "failed", val);
-    else if (strcmp(name, "sess_pipe_overflow") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "overflow", val);
-    else if (strcmp(name, "sess_queued") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "queued", val);
-    else if (strcmp(name, "sess_linger") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "linger", val);
-    else if (strcmp(name, "sess_herd") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "herd", val);
+static bool varnish_field_enabled(const user_config_t *conf, /* {{{ */
+                                  const varnish_field_t *field) {
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-    else if (strcmp(name, "sess_closed_err") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "closed_err", val);
-    else if (strcmp(name, "sess_dropped") == 0)
-      return varnish_submit_derive(conf->instance, "session",
-                                   "total_operations", "dropped_for_thread",
-                                   val);
+  if (field->category == NULL)
+    return conf->collect_sma || conf->collect_smf || conf->collect_mse;
 #endif
-  }
 
-  if (conf->collect_shm) {
-    if (strcmp(name, "shm_records") == 0)
-      return varnish_submit_derive(conf->instance, "shm", "total_operations",
-                                   "records", val);
-    else if (strcmp(name, "shm_writes") == 0)
-      return varnish_submit_derive(conf->instance, "shm", "total_operations",
-                                   "writes", val);
-    else if (strcmp(name, "shm_flushes") == 0)
-      return varnish_submit_derive(conf->instance, "shm", "total_operations",
-                                   "flushes", val);
-    else if (strcmp(name, "shm_cont") == 0)
-      return varnish_submit_derive(conf->instance, "shm", "total_operations",
-                                   "contention", val);
-    else if (strcmp(name, "shm_cycles") == 0)
-      return varnish_submit_derive(conf->instance, "shm", "total_operations",
-                                   "cycles", val);
-  }
+  return *(const bool *)((const char *)conf + field->flag);
+} /* }}} bool varnish_field_enabled */
 
-  if (conf->collect_sms) {
-    if (strcmp(name, "sms_nreq") == 0)
-      return varnish_submit_derive(conf->instance, "sms", "total_requests",
-                                   "allocator", val);
-    else if (strcmp(name, "sms_nobj") == 0)
-      return varnish_submit_gauge(conf->instance, "sms", "requests",
-                                  "outstanding", val);
-    else if (strcmp(name, "sms_nbytes") == 0)
-      return varnish_submit_gauge(conf->instance, "sms", "bytes", "outstanding",
-                                  val);
-    else if (strcmp(name, "sms_balloc") == 0)
-      return varnish_submit_derive(conf->instance, "sms", "total_bytes",
-                                   "allocated", val);
-    else if (strcmp(name, "sms_bfree") == 0)
-      return varnish_submit_derive(conf->instance, "sms", "total_bytes", "free",
-                                   val);
-  }
+static int varnish_field_compare(const void *a, const void *b) /* {{{ */
+{
+  const varnish_field_t *fa = *(const varnish_field_t *const *)a;
+  const varnish_field_t *fb = *(const varnish_field_t *const *)b;
 
-  if (conf->collect_struct) {
-    if (strcmp(name, "n_sess_mem") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "current_sessions",
-                                  "sess_mem", val);
-    else if (strcmp(name, "n_sess") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "current_sessions",
-                                  "sess", val);
-    else if (strcmp(name, "n_object") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects", "object",
-                                  val);
-    else if (strcmp(name, "n_vampireobject") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "vampireobject", val);
-    else if (strcmp(name, "n_objectcore") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "objectcore", val);
-    else if (strcmp(name, "n_waitinglist") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "waitinglist", val);
-    else if (strcmp(name, "n_objecthead") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "objecthead", val);
-    else if (strcmp(name, "n_smf") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects", "smf",
-                                  val);
-    else if (strcmp(name, "n_smf_frag") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "smf_frag", val);
-    else if (strcmp(name, "n_smf_large") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "smf_large", val);
-    else if (strcmp(name, "n_vbe_conn") == 0)
-      return varnish_submit_gauge(conf->instance, "struct", "objects",
-                                  "vbe_conn", val);
-  }
+  int status = strcmp(fa->name, fb->name);
+  if (status != 0)
+    return status;
 
-  if (conf->collect_totals) {
-    if (strcmp(name, "s_sess") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_sessions",
-                                   "sessions", val);
-    else if (strcmp(name, "s_req") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_requests",
-                                   "requests", val);
-    else if (strcmp(name, "s_pipe") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "pipe", val);
-    else if (strcmp(name, "s_pass") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "pass", val);
-    else if (strcmp(name, "s_fetch") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "fetches", val);
-    else if (strcmp(name, "s_synth") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "synth", val);
-    else if (strcmp(name, "s_req_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "req_header", val);
-    else if (strcmp(name, "s_req_bodybytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "req_body", val);
-    else if (strcmp(name, "s_req_protobytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "req_proto", val);
-    else if (strcmp(name, "s_resp_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "resp_header", val);
-    else if (strcmp(name, "s_resp_bodybytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "resp_body", val);
-    else if (strcmp(name, "s_resp_protobytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "resp_proto", val);
-    else if (strcmp(name, "s_pipe_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "pipe_header", val);
-    else if (strcmp(name, "s_pipe_in") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "pipe_in", val);
-    else if (strcmp(name, "s_pipe_out") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "pipe_out", val);
-    else if (strcmp(name, "n_purges") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "purges", val);
-    else if (strcmp(name, "s_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "header-bytes", val);
-    else if (strcmp(name, "s_bodybytes") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_bytes",
-                                   "body-bytes", val);
-    else if (strcmp(name, "n_gzip") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "gzip", val);
-    else if (strcmp(name, "n_gunzip") == 0)
-      return varnish_submit_derive(conf->instance, "totals", "total_operations",
-                                   "gunzip", val);
-  }
+  /* Keep the order of the table for equal names. */
+  return (fa < fb) ? -1 : (fa > fb);
+} /* }}} int varnish_field_compare */
+
+static int varnish_field_search(const void *key, const void *m) /* {{{ */
+{
+  return strcmp(key, (*(const varnish_field_t *const *)m)->name);
+} /* }}} int varnish_field_search */
 
-  if (conf->collect_uptime) {
-    if (strcmp(name, "uptime") == 0)
-      return varnish_submit_gauge(conf->instance, "uptime", "uptime",
-                                  "client_uptime", val);
+/* varnish_config_build_index builds the sorted list of counters selected by
+ * the "Collect*" options, so that varnish_monitor only has to look up the
+ * name of each point. */
+static int varnish_config_build_index(user_config_t *conf) /* {{{ */
+{
+  conf->fields = calloc(STATIC_ARRAY_SIZE(varnish_fields),
+                        sizeof(*conf->fields));
+  if (conf->fields == NULL) {
+    ERROR("varnish plugin: calloc failed.");
+    return ENOMEM;
   }
 
-  if (conf->collect_vcl) {
-    if (strcmp(name, "n_vcl") == 0)
-      return varnish_submit_gauge(conf->instance, "vcl", "vcl", "total_vcl",
-                                  val);
-    else if (strcmp(name, "n_vcl_avail") == 0)
-      return varnish_submit_gauge(conf->instance, "vcl", "vcl", "avail_vcl",
-                                  val);
-    else if (strcmp(name, "n_vcl_discard") == 0)
-      return varnish_submit_gauge(conf->instance, "vcl", "vcl", "discarded_vcl",
-                                  val);
-    else if (strcmp(name, "vmods") == 0)
-      return varnish_submit_gauge(conf->instance, "vcl", "objects", "vmod",
-                                  val);
+  size_t num = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(varnish_fields); i++)
+    if (varnish_field_enabled(conf, varnish_fields + i))
+      conf->fields[num++] = varnish_fields + i;
+
+  if (num > 0)
+    qsort(conf->fields, num, sizeof(*conf->fields), varnish_field_compare);
+
+  conf->fields_num = 0;
+  for (size_t i = 0; i < num; i++) {
+    if ((conf->fields_num > 0) &&
+        (strcmp(conf->fields[conf->fields_num - 1]->name,
+                conf->fields[i]->name) == 0))
+      continue;
+    conf->fields[conf->fields_num++] = conf->fields[i];
   }
 
-  if (conf->collect_workers) {
-    if (strcmp(name, "threads") == 0)
-      return varnish_submit_gauge(conf->instance, "workers", "threads",
-                                  "worker", val);
-    else if (strcmp(name, "threads_created") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "created", val);
-    else if (strcmp(name, "threads_failed") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "failed", val);
-    else if (strcmp(name, "threads_limited") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "limited", val);
-    else if (strcmp(name, "threads_destroyed") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "dropped", val);
-    else if (strcmp(name, "thread_queue_len") == 0)
-      return varnish_submit_gauge(conf->instance, "workers", "queue_length",
-                                  "threads", val);
-    else if (strcmp(name, "n_wrk") == 0)
-      return varnish_submit_gauge(conf->instance, "workers", "threads",
-                                  "worker", val);
-    else if (strcmp(name, "n_wrk_create") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "created", val);
-    else if (strcmp(name, "n_wrk_failed") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "failed", val);
-    else if (strcmp(name, "n_wrk_max") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "limited", val);
-    else if (strcmp(name, "n_wrk_drop") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_threads",
-                                   "dropped", val);
-    else if (strcmp(name, "n_wrk_queue") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_requests",
-                                   "queued", val);
-    else if (strcmp(name, "n_wrk_overflow") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_requests",
-                                   "overflowed", val);
-    else if (strcmp(name, "n_wrk_queued") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_requests",
-                                   "queued", val);
-    else if (strcmp(name, "n_wrk_lqueue") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "total_requests",
-                                   "queue_length", val);
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-    else if (strcmp(name, "pools") == 0)
-      return varnish_submit_gauge(conf->instance, "workers", "pools", "pools",
-                                  val);
-    else if (strcmp(name, "busy_killed") == 0)
-      return varnish_submit_derive(conf->instance, "workers", "http_requests",
-                                   "busy_killed", val);
+  if (conf->collect_sma)
+    conf->stevedore_category = "sma";
+  else if (conf->collect_smf)
+    conf->stevedore_category = "smf";
+  else
+    conf->stevedore_category = "mse";
 #endif
-  }
 
+  return 0;
+} /* }}} int varnish_config_build_index */
+
+static int varnish_submit_field(const user_config_t *conf, /* {{{ */
+                                const varnish_field_t *field, uint64_t val) {
+  const char *category = field->category;
 #if HAVE_VARNISH_V4 || HAVE_VARNISH_V5
-  if (conf->collect_vsm) {
-    if (strcmp(name, "vsm_free") == 0)
-      return varnish_submit_gauge(conf->instance, "vsm", "bytes", "free", val);
-    else if (strcmp(name, "vsm_used") == 0)
-      return varnish_submit_gauge(conf->instance, "vsm", "bytes", "used", val);
-    else if (strcmp(name, "vsm_cooling") == 0)
-      return varnish_submit_gauge(conf->instance, "vsm", "bytes", "cooling",
-                                  val);
-    else if (strcmp(name, "vsm_overflow") == 0)
-      return varnish_submit_gauge(conf->instance, "vsm", "bytes", "overflow",
-                                  val);
-    else if (strcmp(name, "vsm_overflowed") == 0)
-      return varnish_submit_derive(conf->instance, "vsm", "total_bytes",
-                                   "overflowed", val);
-  }
+  if (category == NULL)
+    category = conf->stevedore_category;
+#endif
 
-  if (conf->collect_vbe) {
-    /* @TODO figure out the collectd type for bitmap
-    if (strcmp(name, "happy") == 0)
-      return varnish_submit_derive(conf->instance, "vbe",
-                                   "bitmap", "happy_hprobes", val);
-    */
-    if (strcmp(name, "bereq_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "bereq_hdrbytes", val);
-    else if (strcmp(name, "bereq_bodybytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "bereq_bodybytes", val);
-    else if (strcmp(name, "bereq_protobytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "bereq_protobytes", val);
-    else if (strcmp(name, "beresp_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "beresp_hdrbytes", val);
-    else if (strcmp(name, "beresp_bodybytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "beresp_bodybytes", val);
-    else if (strcmp(name, "beresp_protobytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "beresp_protobytes", val);
-    else if (strcmp(name, "pipe_hdrbytes") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "pipe_hdrbytes", val);
-    else if (strcmp(name, "pipe_out") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "pipe_out", val);
-    else if (strcmp(name, "pipe_in") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "total_bytes",
-                                   "pipe_in", val);
-    else if (strcmp(name, "conn") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "connections",
-                                   "c_conns", val);
-    else if (strcmp(name, "req") == 0)
-      return varnish_submit_derive(conf->instance, "vbe", "http_requests",
-                                   "b_reqs", val);
-  }
+  if (field->ds_type == DS_TYPE_GAUGE)
+    return varnish_submit_gauge(conf->instance, category, field->type,
+                                field->type_instance, val);
+  return varnish_submit_derive(conf->instance, category, field->type,
+                               field->type_instance, val);
+} /* }}} int varnish_submit_field */
 
-  /* All Stevedores support these counters */
-  if (conf->collect_sma || conf->collect_smf || conf->collect_mse) {
-
-    char category[4];
-    if (conf->collect_sma)
-      strncpy(category, "sma", 4);
-    else if (conf->collect_smf)
-      strncpy(category, "smf", 4);
-    else
-      strncpy(category, "mse", 4);
-
-    if (strcmp(name, "c_req") == 0)
-      return varnish_submit_derive(conf->instance, category, "total_operations",
-                                   "alloc_req", val);
-    else if (strcmp(name, "c_fail") == 0)
-      return varnish_submit_derive(conf->instance, category, "total_operations",
-                                   "alloc_fail", val);
-    else if (strcmp(name, "c_bytes") == 0)
-      return varnish_submit_derive(conf->instance, category, "total_bytes",
-                                   "bytes_allocated", val);
-    else if (strcmp(name, "c_freed") == 0)
-      return varnish_submit_derive(conf->instance, category, "total_bytes",
-                                   "bytes_freed", val);
-    else if (strcmp(name, "g_alloc") == 0)
-      return varnish_submit_derive(conf->instance, category, "total_operations",
-                                   "alloc_outstanding", val);
-    else if (strcmp(name, "g_bytes") == 0)
-      return varnish_submit_gauge(conf->instance, category, "bytes",
-                                  "bytes_outstanding", val);
-    else if (strcmp(name, "g_space") == 0)
-      return varnish_submit_gauge(conf->instance, category, "bytes",
-                                  "bytes_available", val);
-  }
+#if HAVE_VARNISH_V5
+static void varnish_points_add(user_config_t *conf, /* {{{ */
+                               const volatile uint64_t *ptr,
+                               const varnish_field_t *field) {
+  if (!conf->points_valid)
+    return;
 
-  /* No SMA specific counters */
-
-  if (conf->collect_smf) {
-    if (strcmp(name, "g_smf") == 0)
-      return varnish_submit_gauge(conf->instance, "smf", "objects",
-                                  "n_struct_smf", val);
-    else if (strcmp(name, "g_smf_frag") == 0)
-      return varnish_submit_gauge(conf->instance, "smf", "objects",
-                                  "n_small_free_smf", val);
-    else if (strcmp(name, "g_smf_large") == 0)
-      return varnish_submit_gauge(conf->instance, "smf", "objects",
-                                  "n_large_free_smf", val);
+  if (conf->points_num >= conf->points_size) {
+    size_t size = (conf->points_size == 0) ? 64 : 2 * conf->points_size;
+    varnish_point_t *tmp = realloc(conf->points, size * sizeof(*tmp));
+    if (tmp == NULL) {
+      ERROR("varnish plugin: realloc failed.");
+      conf->points_valid = false;
+      return;
+    }
+    conf->points = tmp;
+    conf->points_size = size;
   }
 
-  if (conf->collect_mgt) {
-    if (strcmp(name, "uptime") == 0)
-      return varnish_submit_gauge(conf->instance, "mgt", "uptime",
-                                  "mgt_proc_uptime", val);
-    else if (strcmp(name, "child_start") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_start", val);
-    else if (strcmp(name, "child_exit") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_exit", val);
-    else if (strcmp(name, "child_stop") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_stop", val);
-    else if (strcmp(name, "child_died") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_died", val);
-    else if (strcmp(name, "child_dump") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_dump", val);
-    else if (strcmp(name, "child_panic") == 0)
-      return varnish_submit_derive(conf->instance, "mgt", "total_operations",
-                                   "child_panic", val);
-  }
+  conf->points[conf->points_num++] = (varnish_point_t){
+      .ptr = ptr, .field = field,
+  };
+} /* }}} void varnish_points_add */
+#endif
 
-  if (conf->collect_lck) {
-    if (strcmp(name, "creat") == 0)
-      return varnish_submit_gauge(conf->instance, "lck", "objects", "created",
-                                  val);
-    else if (strcmp(name, "destroy") == 0)
-      return varnish_submit_gauge(conf->instance, "lck", "objects", "destroyed",
-                                  val);
-    else if (strcmp(name, "locks") == 0)
-      return varnish_submit_derive(conf->instance, "lck", "total_operations",
-                                   "lock_ops", val);
-  }
+static int varnish_monitor(void *priv,
+                           const struct VSC_point *const pt) /* {{{ */
+{
+  uint64_t val;
+  user_config_t *conf;
+  const char *name;
+
+  if (pt == NULL)
+    return 0;
 
-  if (conf->collect_mempool) {
-    if (strcmp(name, "live") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "in_use", val);
-    else if (strcmp(name, "pool") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "in_pool", val);
-    else if (strcmp(name, "sz_wanted") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "bytes",
-                                  "size_requested", val);
-    else if (strcmp(name, "sz_actual") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "bytes",
-                                  "size_allocated", val);
-    else if (strcmp(name, "allocs") == 0)
-      return varnish_submit_derive(conf->instance, "mempool",
-                                   "total_operations", "allocations", val);
-    else if (strcmp(name, "frees") == 0)
-      return varnish_submit_derive(conf->instance, "mempool",
-                                   "total_operations", "frees", val);
-    else if (strcmp(name, "recycle") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "recycled", val);
-    else if (strcmp(name, "timeout") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "timed_out", val);
-    else if (strcmp(name, "toosmall") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "too_small", val);
-    else if (strcmp(name, "surplus") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "surplus", val);
-    else if (strcmp(name, "randry") == 0)
-      return varnish_submit_gauge(conf->instance, "mempool", "objects",
-                                  "ran_dry", val);
+  conf = priv;
+
+#if HAVE_VARNISH_V5
+  char const *c = strrchr(pt->name, '.');
+  if (c == NULL) {
+    return EINVAL;
   }
+  name = c + 1;
 
-  if (conf->collect_mse) {
-    if (strcmp(name, "c_full") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "full_allocs", val);
-    else if (strcmp(name, "c_truncated") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "truncated_allocs", val);
-    else if (strcmp(name, "c_expanded") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "expanded_allocs", val);
-    else if (strcmp(name, "c_failed") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "failed_allocs", val);
-    else if (strcmp(name, "c_bytes") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_bytes",
-                                   "bytes_allocated", val);
-    else if (strcmp(name, "c_freed") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_bytes",
-                                   "bytes_freed", val);
-    else if (strcmp(name, "g_fo_alloc") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "fo_allocs_outstanding", val);
-    else if (strcmp(name, "g_fo_bytes") == 0)
-      return varnish_submit_gauge(conf->instance, "mse", "bytes",
-                                  "fo_bytes_outstanding", val);
-    else if (strcmp(name, "g_membuf_alloc") == 0)
-      return varnish_submit_gauge(conf->instance, "mse", "objects",
-                                  "membufs_allocated", val);
-    else if (strcmp(name, "g_membuf_inuse") == 0)
-      return varnish_submit_gauge(conf->instance, "mse", "objects",
-                                  "membufs_inuse", val);
-    else if (strcmp(name, "g_bans_bytes") == 0)
-      return varnish_submit_gauge(conf->instance, "mse", "bytes",
-                                  "persisted_banspace_used", val);
-    else if (strcmp(name, "g_bans_space") == 0)
-      return varnish_submit_gauge(conf->instance, "mse", "bytes",
-                                  "persisted_banspace_available", val);
-    else if (strcmp(name, "g_bans_persisted") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "bans_persisted", val);
-    else if (strcmp(name, "g_bans_lost") == 0)
-      return varnish_submit_derive(conf->instance, "mse", "total_operations",
-                                   "bans_lost", val);
+#elif HAVE_VARNISH_V4
+  if (strcmp(pt->section->fantom->type, "MAIN") != 0)
+    return 0;
 
-    /* mse seg */
-    else if (strcmp(name, "g_journal_bytes") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_reg", "bytes",
-                                  "journal_bytes_used", val);
-    else if (strcmp(name, "g_journal_space") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_reg", "bytes",
-                                  "journal_bytes_free", val);
+  name = pt->desc->name;
+#elif HAVE_VARNISH_V3
+  if (strcmp(pt->class, "") != 0)
+    return 0;
 
-    /* mse segagg */
-    else if (strcmp(name, "g_bigspace") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "bytes",
-                                  "big_extents_bytes_available", val);
-    else if (strcmp(name, "g_extfree") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "objects",
-                                  "free_extents", val);
-    else if (strcmp(name, "g_sparenode") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "objects",
-                                  "spare_nodes_available", val);
-    else if (strcmp(name, "g_objnode") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "objects",
-                                  "object_nodes_in_use", val);
-    else if (strcmp(name, "g_extnode") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "objects",
-                                  "extent_nodes_in_use", val);
-    else if (strcmp(name, "g_bigextfree") == 0)
-      return varnish_submit_gauge(conf->instance, "mse_segagg", "objects",
-                                  "free_big_extents", val);
-    else if (strcmp(name, "c_pruneloop") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_operations", "prune_loops", val);
-    else if (strcmp(name, "c_pruned") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_objects", "pruned_objects", val);
-    else if (strcmp(name, "c_spared") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_operations", "spared_objects", val);
-    else if (strcmp(name, "c_skipped") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_operations", "missed_objects", val);
-    else if (strcmp(name, "c_nuked") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_operations", "nuked_objects", val);
-    else if (strcmp(name, "c_sniped") == 0)
-      return varnish_submit_derive(conf->instance, "mse_segagg",
-                                   "total_operations", "sniped_objects", val);
-  }
+  name = pt->name;
+#endif
 
+  const varnish_field_t *const *field =
+      bsearch(name, conf->fields, conf->fields_num, sizeof(*conf->fields),
+              varnish_field_search);
+  if (field == NULL)
+    return 0;
+
+  val = *(const volatile uint64_t *)pt->ptr;
+
+#if HAVE_VARNISH_V5
+  varnish_points_add(conf, pt->ptr, *field);
 #endif
 
+  varnish_submit_field(conf, *field, val);
   return 0;
-
 } /* }}} static int varnish_monitor */
 #else /* if HAVE_VARNISH_V2 */
 static void varnish_monitor(const user_config_t *conf, /* {{{ */
@@ -1326,18 +1158,12 @@ static void varnish_monitor(const user_config_t *conf, /* {{{ */
 } /* }}} void varnish_monitor */
 #endif
 
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
 static int varnish_read(user_data_t *ud) /* {{{ */
 {
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
   struct VSM_data *vd;
   bool ok;
   const c_varnish_stats_t *stats;
-#elif HAVE_VARNISH_V5
-  struct vsm *vd;
-  struct vsc *vsc;
-  int vsm_status;
-#endif
 
   user_config_t *conf;
 
@@ -1348,10 +1174,6 @@ static int varnish_read(user_data_t *ud) /* {{{ */
 
   vd = VSM_New();
 
-#if HAVE_VARNISH_V5
-  vsc = VSC_New();
-#endif
-
 #if HAVE_VARNISH_V3
   VSC_Setup(vd);
 #endif
@@ -1359,19 +1181,9 @@ static int varnish_read(user_data_t *ud) /* {{{ */
   if (conf->instance != NULL) {
     int status;
 
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
     status = VSM_n_Arg(vd, conf->instance);
-#elif HAVE_VARNISH_V5
-    status = VSM_Arg(vd, 'n', conf->instance);
-#endif
-
     if (status < 0) {
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
       VSM_Delete(vd);
-#elif HAVE_VARNISH_V5
-      VSC_Destroy(&vsc, vd);
-      VSM_Destroy(&vd);
-#endif
       ERROR("varnish plugin: VSM_Arg (\"%s\") failed "
             "with status %i.",
             conf->instance, status);
@@ -1384,58 +1196,114 @@ static int varnish_read(user_data_t *ud) /* {{{ */
 #elif HAVE_VARNISH_V4
   ok = (VSM_Open(vd) == 0);
 #endif
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
   if (!ok) {
     VSM_Delete(vd);
     ERROR("varnish plugin: Unable to open connection.");
     return -1;
   }
-#endif
 
 #if HAVE_VARNISH_V3
   stats = VSC_Main(vd);
 #elif HAVE_VARNISH_V4
   stats = VSC_Main(vd, NULL);
 #endif
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
   if (!stats) {
     VSM_Delete(vd);
     ERROR("varnish plugin: Unable to get statistics.");
     return -1;
   }
+
+#if HAVE_VARNISH_V3
+  VSC_Iter(vd, varnish_monitor, conf);
+#elif HAVE_VARNISH_V4
+  VSC_Iter(vd, NULL, varnish_monitor, conf);
 #endif
 
-#if HAVE_VARNISH_V5
-  if (VSM_Attach(vd, STDERR_FILENO)) {
-    ERROR("varnish plugin: Cannot attach to varnish. %s", VSM_Error(vd));
-    VSC_Destroy(&vsc, vd);
-    VSM_Destroy(&vd);
+  VSM_Delete(vd);
+
+  return 0;
+} /* }}} */
+#elif HAVE_VARNISH_V5
+static void varnish_detach(user_config_t *conf) /* {{{ */
+{
+  if (conf->vsc != NULL)
+    VSC_Destroy(&conf->vsc, conf->vd);
+  if (conf->vd != NULL)
+    VSM_Destroy(&conf->vd);
+
+  conf->points_num = 0;
+  conf->points_valid = false;
+} /* }}} void varnish_detach */
+
+static int varnish_attach(user_config_t *conf) /* {{{ */
+{
+  conf->vd = VSM_New();
+  conf->vsc = VSC_New();
+  if ((conf->vd == NULL) || (conf->vsc == NULL)) {
+    ERROR("varnish plugin: Allocating the VSM/VSC handles failed.");
+    varnish_detach(conf);
     return -1;
   }
 
-  vsm_status = VSM_Status(vd);
-  if (vsm_status & ~(VSM_MGT_RUNNING | VSM_WRK_RUNNING)) {
+  if (conf->instance != NULL) {
+    int status = VSM_Arg(conf->vd, 'n', conf->instance);
+    if (status < 0) {
+      ERROR("varnish plugin: VSM_Arg (\"%s\") failed "
+            "with status %i.",
+            conf->instance, status);
+      varnish_detach(conf);
+      return -1;
+    }
+  }
+
+  if (VSM_Attach(conf->vd, STDERR_FILENO)) {
+    ERROR("varnish plugin: Cannot attach to varnish. %s", VSM_Error(conf->vd));
+    varnish_detach(conf);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int varnish_attach */
+
+/* The VSM and VSC handles are kept between reads. The points found by
+ * VSC_Iter point into the mapped segments, which stay mapped until VSC_Iter
+ * notices that they are gone. As long as VSM_Status does not report a change,
+ * the counters are therefore read directly from the cached points. */
+static int varnish_read(user_data_t *ud) /* {{{ */
+{
+  user_config_t *conf;
+  int vsm_status;
+
+  if ((ud == NULL) || (ud->data == NULL))
+    return EINVAL;
+
+  conf = ud->data;
+
+  if ((conf->vd == NULL) && (varnish_attach(conf) != 0))
+    return -1;
+
+  vsm_status = VSM_Status(conf->vd);
+  if (!(vsm_status & VSM_MGT_RUNNING)) {
     ERROR("varnish plugin: Unable to get statistics.");
-    VSC_Destroy(&vsc, vd);
-    VSM_Destroy(&vd);
+    varnish_detach(conf);
     return -1;
   }
-#endif
 
-#if HAVE_VARNISH_V3
-  VSC_Iter(vd, varnish_monitor, conf);
-#elif HAVE_VARNISH_V4
-  VSC_Iter(vd, NULL, varnish_monitor, conf);
-#elif HAVE_VARNISH_V5
-  VSC_Iter(vsc, vd, varnish_monitor, conf);
-#endif
+  if (vsm_status & (VSM_MGT_CHANGED | VSM_MGT_RESTARTED | VSM_WRK_CHANGED |
+                    VSM_WRK_RESTARTED))
+    conf->points_valid = false;
 
-#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4
-  VSM_Delete(vd);
-#elif HAVE_VARNISH_V5
-  VSC_Destroy(&vsc, vd);
-  VSM_Destroy(&vd);
-#endif
+  if (conf->points_valid) {
+    for (size_t i = 0; i < conf->points_num; i++)
+      varnish_submit_field(conf, conf->points[i].field,
+                           *conf->points[i].ptr);
+    return 0;
+  }
+
+  conf->points_num = 0;
+  conf->points_valid = true;
+  if (VSC_Iter(conf->vsc, conf->vd, varnish_monitor, conf) != 0)
+    conf->points_valid = false;
 
   return 0;
 } /* }}} */
@@ -1471,6 +1339,13 @@ static void varnish_config_free(void *ptr) /* {{{ */
   if (conf == NULL)
     return;
 
+#if HAVE_VARNISH_V5
+  varnish_detach(conf);
+  sfree(conf->points);
+#endif
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+  sfree(conf->fields);
+#endif
   sfree(conf->instance);
   sfree(conf);
 } /* }}} */
@@ -1540,6 +1415,14 @@ static int varnish_init(void) /* {{{ */
 
   varnish_config_apply_default(conf);
 
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+  int status = varnish_config_build_index(conf);
+  if (status != 0) {
+    varnish_config_free(conf);
+    return status;
+  }
+#endif
+
   plugin_register_complex_read(
       /* group = */ "varnish",
       /* name      = */ "varnish/localhost",
@@ -1759,6 +1642,14 @@ static int varnish_config_instance(const oconfig_item_t *ci) /* {{{ */
     return EINVAL;
   }
 
+#if HAVE_VARNISH_V3 || HAVE_VARNISH_V4 || HAVE_VARNISH_V5
+  int status = varnish_config_build_index(conf);
+  if (status != 0) {
+    varnish_config_free(conf);
+    return status;
+  }
+#endif
+
   snprintf(callback_name, sizeof(callback_name), "varnish/%s",
            (conf->instance == NULL) ? "localhost" : conf->instance);
 
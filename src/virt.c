@@ -84,10 +84,12 @@
 
 #if LIBVIR_CHECK_VERSION(1, 1, 1)
 #define HAVE_DOM_REASON_PAUSED_CRASHED 1
+#define HAVE_DEVICE_REMOVED_EVENT 1
 #endif
 
 #if LIBVIR_CHECK_VERSION(1, 2, 9)
 #define HAVE_JOB_STATS 1
+#define HAVE_BULK_STATS 1
 #endif
 
 #if LIBVIR_CHECK_VERSION(1, 2, 10)
@@ -100,6 +102,7 @@
 
 #if LIBVIR_CHECK_VERSION(1, 2, 15)
 #define HAVE_DOM_REASON_PAUSED_STARTING_UP 1
+#define HAVE_DEVICE_ADDED_EVENT 1
 #endif
 
 #if LIBVIR_CHECK_VERSION(1, 3, 3)
@@ -113,6 +116,8 @@
 typedef struct virt_notif_thread_s {
   pthread_t event_loop_tid;
   int domain_event_cb_id;
+  int device_added_cb_id;
+  int device_removed_cb_id;
   pthread_mutex_t active_mutex; /* protects 'is_active' member access*/
   bool is_active;
 } virt_notif_thread_t;
@@ -141,6 +146,8 @@ static const char *config_keys[] = {"Connection",
 
                                     "ReportBlockDevices",
                                     "ReportNetworkInterfaces",
+
+                                    "BulkStats",
                                     NULL};
 
 /* PersistentNotification is false by default */
@@ -149,6 +156,10 @@ static bool persistent_notification = false;
 static bool report_block_devices = true;
 static bool report_network_interfaces = true;
 
+/* BulkStats: get the statistics of all domains of a read instance with a
+ * single virDomainListGetStats() call. */
+static bool bulk_stats = false;
+
 /* Thread used for handling libvirt notifications events */
 static virt_notif_thread_t notif_thread;
 
@@ -552,8 +563,19 @@ struct lv_read_instance {
   struct lv_read_state read_state;
   char tag[PARTITION_TAG_MAX_LEN];
   size_t id;
+
+  /* UUIDs of the domains that changed since the last read, as reported by
+   * lifecycle and device events. Protected by changed_lock. */
+  unsigned char (*changed)[VIR_UUID_BUFLEN];
+  size_t changed_num;
+  bool changed_overflow;
 };
 
+/* If more domains than this change between two reads, the lists are
+ * refreshed completely instead. */
+#define CHANGED_DOMAINS_MAX 256
+static pthread_mutex_t changed_lock = PTHREAD_MUTEX_INITIALIZER;
+
 struct lv_user_data {
   struct lv_read_instance inst;
   user_data_t ud;
@@ -655,6 +677,8 @@ static enum if_field interface_format = if_name;
 static time_t last_refresh = (time_t)0;
 
 static int refresh_lists(struct lv_read_instance *inst);
+static void lv_domain_changed(virDomainPtr dom);
+static int lv_update_lists(struct lv_read_instance *inst);
 
 struct lv_block_info {
   virDomainBlockStatsStruct bi;
@@ -1384,6 +1408,17 @@ static int lv_config(const char *key, const char *value) {
     return 0;
   }
 
+  if (strcasecmp(key, "BulkStats") == 0) {
+#ifdef HAVE_BULK_STATS
+    bulk_stats = IS_TRUE(value);
+#else
+    if (IS_TRUE(value))
+      WARNING(PLUGIN_NAME " plugin: BulkStats requires libvirt 1.2.9 or "
+                          "later and is ignored.");
+#endif
+    return 0;
+  }
+
   /* Unrecognised option. */
   return -1;
 }
@@ -1918,15 +1953,10 @@ static int get_domain_metrics(domain_t *domain) {
   return 0;
 }
 
-static int get_if_dev_stats(struct interface_device *if_dev) {
-  virDomainInterfaceStatsStruct stats = {0};
+static void if_stats_submit(const struct interface_device *if_dev,
+                            const virDomainInterfaceStatsStruct *stats) {
   char *display_name = NULL;
 
-  if (!if_dev) {
-    ERROR(PLUGIN_NAME " plugin: get_if_dev_stats: NULL pointer");
-    return -1;
-  }
-
   switch (interface_format) {
   case if_address:
     display_name = if_dev->address;
@@ -1939,29 +1969,411 @@ static int get_if_dev_stats(struct interface_device *if_dev) {
     display_name = if_dev->path;
   }
 
+  if ((stats->rx_bytes != -1) && (stats->tx_bytes != -1))
+    submit_derive2("if_octets", (derive_t)stats->rx_bytes,
+                   (derive_t)stats->tx_bytes, if_dev->dom, display_name);
+
+  if ((stats->rx_packets != -1) && (stats->tx_packets != -1))
+    submit_derive2("if_packets", (derive_t)stats->rx_packets,
+                   (derive_t)stats->tx_packets, if_dev->dom, display_name);
+
+  if ((stats->rx_errs != -1) && (stats->tx_errs != -1))
+    submit_derive2("if_errors", (derive_t)stats->rx_errs,
+                   (derive_t)stats->tx_errs, if_dev->dom, display_name);
+
+  if ((stats->rx_drop != -1) && (stats->tx_drop != -1))
+    submit_derive2("if_dropped", (derive_t)stats->rx_drop,
+                   (derive_t)stats->tx_drop, if_dev->dom, display_name);
+}
+
+static int get_if_dev_stats(struct interface_device *if_dev) {
+  virDomainInterfaceStatsStruct stats = {0};
+
+  if (!if_dev) {
+    ERROR(PLUGIN_NAME " plugin: get_if_dev_stats: NULL pointer");
+    return -1;
+  }
+
   if (virDomainInterfaceStats(if_dev->dom, if_dev->path, &stats,
                               sizeof(stats)) != 0) {
     ERROR(PLUGIN_NAME " plugin: virDomainInterfaceStats failed");
     return -1;
   }
 
-  if ((stats.rx_bytes != -1) && (stats.tx_bytes != -1))
-    submit_derive2("if_octets", (derive_t)stats.rx_bytes,
-                   (derive_t)stats.tx_bytes, if_dev->dom, display_name);
+  if_stats_submit(if_dev, &stats);
+  return 0;
+}
+
+#ifdef HAVE_BULK_STATS
+static bool bulk_param_value(const virTypedParameter *param,
+                             unsigned long long *ret) {
+  switch (param->type) {
+  case VIR_TYPED_PARAM_INT:
+    *ret = (unsigned long long)param->value.i;
+    return true;
+  case VIR_TYPED_PARAM_UINT:
+    *ret = param->value.ui;
+    return true;
+  case VIR_TYPED_PARAM_LLONG:
+    *ret = (unsigned long long)param->value.l;
+    return true;
+  case VIR_TYPED_PARAM_ULLONG:
+    *ret = param->value.ul;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* Parses a "<prefix>.<n>.<field>" parameter name. Returns <n> and sets "field"
+ * or returns -1 if the name does not match. */
+static int bulk_param_index(const char *name, const char *prefix,
+                            const char **field) {
+  size_t len = strlen(prefix);
+  if ((strncmp(name, prefix, len) != 0) || (name[len] != '.') ||
+      !isdigit((unsigned char)name[len + 1]))
+    return -1;
+
+  char *endptr = NULL;
+  unsigned long index = strtoul(name + len + 1, &endptr, 10);
+  if ((*endptr != '.') || (index > INT_MAX))
+    return -1;
+
+  *field = endptr + 1;
+  return (int)index;
+}
+
+struct bulk_interface {
+  const char *name;
+  virDomainInterfaceStatsStruct stats;
+};
+
+struct bulk_block {
+  const char *name;
+  const char *path;
+  struct lv_block_info binfo;
+};
+
+static void bulk_interface_set(struct bulk_interface *iface, const char *field,
+                               const virTypedParameter *param) {
+  unsigned long long value;
+
+  if (strcmp(field, "name") == 0) {
+    if (param->type == VIR_TYPED_PARAM_STRING)
+      iface->name = param->value.s;
+    return;
+  }
+
+  if (!bulk_param_value(param, &value))
+    return;
+
+  if (strcmp(field, "rx.bytes") == 0)
+    iface->stats.rx_bytes = (long long)value;
+  else if (strcmp(field, "rx.pkts") == 0)
+    iface->stats.rx_packets = (long long)value;
+  else if (strcmp(field, "rx.errs") == 0)
+    iface->stats.rx_errs = (long long)value;
+  else if (strcmp(field, "rx.drop") == 0)
+    iface->stats.rx_drop = (long long)value;
+  else if (strcmp(field, "tx.bytes") == 0)
+    iface->stats.tx_bytes = (long long)value;
+  else if (strcmp(field, "tx.pkts") == 0)
+    iface->stats.tx_packets = (long long)value;
+  else if (strcmp(field, "tx.errs") == 0)
+    iface->stats.tx_errs = (long long)value;
+  else if (strcmp(field, "tx.drop") == 0)
+    iface->stats.tx_drop = (long long)value;
+}
+
+static void bulk_block_set(struct bulk_block *block, const char *field,
+                           const virTypedParameter *param) {
+  unsigned long long value;
+
+  if ((strcmp(field, "name") == 0) || (strcmp(field, "path") == 0)) {
+    if (param->type != VIR_TYPED_PARAM_STRING)
+      return;
+    if (field[0] == 'n')
+      block->name = param->value.s;
+    else
+      block->path = param->value.s;
+    return;
+  }
+
+  if (!bulk_param_value(param, &value))
+    return;
+
+  if (strcmp(field, "rd.reqs") == 0)
+    block->binfo.bi.rd_req = (long long)value;
+  else if (strcmp(field, "rd.bytes") == 0)
+    block->binfo.bi.rd_bytes = (long long)value;
+  else if (strcmp(field, "rd.times") == 0)
+    block->binfo.rd_total_times = (long long)value;
+  else if (strcmp(field, "wr.reqs") == 0)
+    block->binfo.bi.wr_req = (long long)value;
+  else if (strcmp(field, "wr.bytes") == 0)
+    block->binfo.bi.wr_bytes = (long long)value;
+  else if (strcmp(field, "wr.times") == 0)
+    block->binfo.wr_total_times = (long long)value;
+  else if (strcmp(field, "fl.reqs") == 0)
+    block->binfo.fl_req = (long long)value;
+  else if (strcmp(field, "fl.times") == 0)
+    block->binfo.fl_total_times = (long long)value;
+}
+
+/* Submits the statistics of one domain returned by virDomainListGetStats,
+ * the same values as get_domain_metrics(), get_block_stats() and
+ * get_if_dev_stats() submit. */
+static int bulk_record_submit(struct lv_read_state *state, domain_t *domain,
+                              virDomainStatsRecordPtr record) {
+  int dom_state = -1;
+  int dom_reason = 0;
+  int nr_interfaces = 0;
+  int nr_blocks = 0;
+  unsigned long long value;
+  int status;
+
+  for (int i = 0; i < record->nparams; ++i) {
+    const virTypedParameter *param = &record->params[i];
+
+    if (!bulk_param_value(param, &value))
+      continue;
+    if (strcmp(param->field, "state.state") == 0)
+      dom_state = (int)value;
+    else if (strcmp(param->field, "state.reason") == 0)
+      dom_reason = (int)value;
+    else if (strcmp(param->field, "net.count") == 0)
+      nr_interfaces = (int)value;
+    else if (strcmp(param->field, "block.count") == 0)
+      nr_blocks = (int)value;
+  }
+
+  if ((dom_state >= 0) &&
+      (!domain->active || (extra_stats & ex_stats_domain_state)))
+    domain_state_submit(domain->ptr, dom_state, dom_reason);
+
+  /* Gather remaining stats only for running domains */
+  if (!domain->active || (dom_state != VIR_DOMAIN_RUNNING))
+    return 0;
+
+  struct bulk_interface *interfaces = NULL;
+  if ((nr_interfaces > 0) && (state->nr_interface_devices > 0)) {
+    interfaces = calloc(nr_interfaces, sizeof(*interfaces));
+    if (interfaces == NULL)
+      nr_interfaces = 0;
+    for (int i = 0; i < nr_interfaces; ++i)
+      interfaces[i].stats = (virDomainInterfaceStatsStruct){
+          .rx_bytes = -1,
+          .rx_packets = -1,
+          .rx_errs = -1,
+          .rx_drop = -1,
+          .tx_bytes = -1,
+          .tx_packets = -1,
+          .tx_errs = -1,
+          .tx_drop = -1,
+      };
+  } else {
+    nr_interfaces = 0;
+  }
+
+  struct bulk_block *blocks = NULL;
+  if ((nr_blocks > 0) && (state->nr_block_devices > 0)) {
+    blocks = calloc(nr_blocks, sizeof(*blocks));
+    if (blocks == NULL)
+      nr_blocks = 0;
+    for (int i = 0; i < nr_blocks; ++i)
+      init_block_info(&blocks[i].binfo);
+  } else {
+    nr_blocks = 0;
+  }
+
+  static const char *memory_fields[] = {
+      "balloon.swap_in",     "balloon.swap_out", "balloon.major_fault",
+      "balloon.minor_fault", "balloon.unused",   "balloon.available",
+      "balloon.current",     "balloon.rss",      "balloon.usable",
+      "balloon.last-update"};
+  unsigned long long cpu_time = 0;
+  unsigned long long user_time = 0;
+  unsigned long long system_time = 0;
+  unsigned short nr_vcpus = 0;
+
+  for (int i = 0; i < record->nparams; ++i) {
+    const virTypedParameter *param = &record->params[i];
+    const char *field = NULL;
+    int index;
+
+    if ((index = bulk_param_index(param->field, "net", &field)) >= 0) {
+      if (index < nr_interfaces)
+        bulk_interface_set(&interfaces[index], field, param);
+      continue;
+    }
+
+    if ((index = bulk_param_index(param->field, "block", &field)) >= 0) {
+      if (index < nr_blocks)
+        bulk_block_set(&blocks[index], field, param);
+      continue;
+    }
+
+    if (!bulk_param_value(param, &value))
+      continue;
+
+    if ((index = bulk_param_index(param->field, "vcpu", &field)) >= 0) {
+      if (!(extra_stats & ex_stats_vcpupin) && (strcmp(field, "time") == 0))
+        vcpu_submit((derive_t)value, domain->ptr, index, "virt_vcpu");
+    } else if (strcmp(param->field, "vcpu.current") == 0) {
+      nr_vcpus = (unsigned short)value;
+    } else if (strcmp(param->field, "cpu.time") == 0) {
+      cpu_time = value;
+    } else if (strcmp(param->field, "cpu.user") == 0) {
+      user_time = value;
+    } else if (strcmp(param->field, "cpu.system") == 0) {
+      system_time = value;
+    } else if (strncmp(param->field, "balloon.", strlen("balloon.")) == 0) {
+      if (strcmp(param->field, "balloon.current") == 0)
+        memory_submit(domain->ptr, (gauge_t)value * 1024);
+      for (size_t j = 0; j < STATIC_ARRAY_SIZE(memory_fields); ++j)
+        if (strcmp(param->field, memory_fields[j]) == 0)
+          memory_stats_submit((gauge_t)value * 1024, domain->ptr, (int)j);
+#ifdef HAVE_PERF_STATS
+    } else if (strncmp(param->field, "perf.", strlen("perf.")) == 0) {
+      /* Same naming as perf_submit() */
+      char type_instance[DATA_MAX_NAME_LEN];
+      snprintf(type_instance, sizeof(type_instance), "perf_%s",
+               param->field + strlen("perf."));
+      submit(domain->ptr, "perf", type_instance,
+             &(value_t){.derive = (derive_t)value}, 1);
+#endif
+    }
+  }
+
+#ifdef HAVE_CPU_STATS
+  if ((extra_stats & ex_stats_pcpu) && (user_time > 0 || system_time > 0))
+    submit_derive2("ps_cputime", user_time, system_time, domain->ptr, NULL);
+#endif
+
+  cpu_submit(domain, cpu_time);
+  domain->info.cpuTime = cpu_time;
+
+  /* The CPU affinity is not part of the bulk statistics. */
+  if (extra_stats & ex_stats_vcpupin)
+    GET_STATS(get_vcpu_stats, "vcpu stats", domain->ptr, nr_vcpus);
+
+#ifdef HAVE_FS_INFO
+  if (extra_stats & ex_stats_fs_info)
+    GET_STATS(get_fs_info, "file system info", domain->ptr);
+#endif
+
+#ifdef HAVE_DISK_ERR
+  if (extra_stats & ex_stats_disk_err)
+    GET_STATS(get_disk_err, "disk errors", domain->ptr);
+#endif
+
+#ifdef HAVE_JOB_STATS
+  if (extra_stats &
+      (ex_stats_job_stats_completed | ex_stats_job_stats_background))
+    GET_STATS(get_job_stats, "job stats", domain->ptr);
+#endif
+
+  /* Only the devices found on the last refresh are reported. */
+  for (int i = 0; i < state->nr_block_devices; ++i) {
+    struct block_device *block_dev = &state->block_devices[i];
+    if (block_dev->dom != domain->ptr)
+      continue;
+
+    for (int j = 0; j < nr_blocks; ++j) {
+      const char *name =
+          (blockdevice_format == source) ? blocks[j].path : blocks[j].name;
+      if ((name != NULL) && (strcmp(name, block_dev->path) == 0)) {
+        disk_submit(&blocks[j].binfo, block_dev->dom, block_dev->path);
+        break;
+      }
+    }
+  }
+
+  for (int i = 0; i < state->nr_interface_devices; ++i) {
+    struct interface_device *if_dev = &state->interface_devices[i];
+    if (if_dev->dom != domain->ptr)
+      continue;
+
+    for (int j = 0; j < nr_interfaces; ++j) {
+      if ((interfaces[j].name != NULL) &&
+          (strcmp(interfaces[j].name, if_dev->path) == 0)) {
+        if_stats_submit(if_dev, &interfaces[j].stats);
+        break;
+      }
+    }
+  }
+
+  sfree(interfaces);
+  sfree(blocks);
+  return 0;
+}
+
+/* Gets the statistics of all domains of the instance with a single call,
+ * instead of several calls per domain and device. */
+static int lv_read_bulk(struct lv_read_state *state) {
+  if (state->nr_domains == 0)
+    return 0;
+
+  unsigned int stats = VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_CPU_TOTAL |
+                       VIR_DOMAIN_STATS_BALLOON | VIR_DOMAIN_STATS_VCPU;
+  if (state->nr_interface_devices > 0)
+    stats |= VIR_DOMAIN_STATS_INTERFACE;
+  if (state->nr_block_devices > 0)
+    stats |= VIR_DOMAIN_STATS_BLOCK;
+#ifdef HAVE_PERF_STATS
+  if (extra_stats & ex_stats_perf)
+    stats |= VIR_DOMAIN_STATS_PERF;
+#endif
+
+  /* virDomainListGetStats requires a NULL terminated list of domains */
+  virDomainPtr *domain_array =
+      calloc(state->nr_domains + 1, sizeof(*domain_array));
+  if (domain_array == NULL) {
+    ERROR(PLUGIN_NAME " plugin: calloc failed.");
+    return -1;
+  }
+  for (int i = 0; i < state->nr_domains; ++i)
+    domain_array[i] = state->domains[i].ptr;
+
+  virDomainStatsRecordPtr *records = NULL;
+  int n = virDomainListGetStats(domain_array, stats, &records, 0);
+  sfree(domain_array);
+  if (n < 0) {
+    VIRT_ERROR(conn, "getting the statistics of all domains");
+    return -1;
+  }
 
-  if ((stats.rx_packets != -1) && (stats.tx_packets != -1))
-    submit_derive2("if_packets", (derive_t)stats.rx_packets,
-                   (derive_t)stats.tx_packets, if_dev->dom, display_name);
+  /* The records are usually in the order of the domains, so the search for
+   * the domain of a record starts after the previous one. */
+  int next = 0;
+  for (int i = 0; i < n; ++i) {
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(records[i]->dom, uuid) != 0)
+      continue;
 
-  if ((stats.rx_errs != -1) && (stats.tx_errs != -1))
-    submit_derive2("if_errors", (derive_t)stats.rx_errs,
-                   (derive_t)stats.tx_errs, if_dev->dom, display_name);
+    domain_t *domain = NULL;
+    for (int j = 0; j < state->nr_domains; ++j) {
+      int k = (next + j) % state->nr_domains;
+      unsigned char dom_uuid[VIR_UUID_BUFLEN];
+      if ((virDomainGetUUID(state->domains[k].ptr, dom_uuid) == 0) &&
+          (memcmp(uuid, dom_uuid, sizeof(uuid)) == 0)) {
+        domain = &state->domains[k];
+        next = k + 1;
+        break;
+      }
+    }
+    if (domain == NULL)
+      continue;
 
-  if ((stats.rx_drop != -1) && (stats.tx_drop != -1))
-    submit_derive2("if_dropped", (derive_t)stats.rx_drop,
-                   (derive_t)stats.tx_drop, if_dev->dom, display_name);
+    if (bulk_record_submit(state, domain, records[i]) != 0)
+      ERROR(PLUGIN_NAME " plugin: failed to get metrics for domain=%s",
+            virDomainGetName(domain->ptr));
+  }
+
+  virDomainStatsRecordListFree(records);
   return 0;
 }
+#endif /* HAVE_BULK_STATS */
 
 static int domain_lifecycle_event_cb(__attribute__((unused)) virConnectPtr con_,
                                      virDomainPtr dom, int event, int detail,
@@ -1972,10 +2384,18 @@ static int domain_lifecycle_event_cb(__attribute__((unused)) virConnectPtr con_,
   domain_reason = map_domain_event_detail_to_reason(event, detail);
 #endif
   domain_state_submit_notif(dom, domain_state, domain_reason);
+  lv_domain_changed(dom);
 
   return 0;
 }
 
+static void domain_device_event_cb(__attribute__((unused)) virConnectPtr con_,
+                                   virDomainPtr dom,
+                                   __attribute__((unused)) const char *alias,
+                                   __attribute__((unused)) void *opaque) {
+  lv_domain_changed(dom);
+}
+
 static int register_event_impl(void) {
   if (virEventRegisterDefaultImpl() < 0) {
     virErrorPtr err = virGetLastError();
@@ -2037,6 +2457,8 @@ static int virt_notif_thread_init(virt_notif_thread_t *thread_data) {
    * domain_event_cb_id to '-1'
    */
   thread_data->domain_event_cb_id = -1;
+  thread_data->device_added_cb_id = -1;
+  thread_data->device_removed_cb_id = -1;
   pthread_mutex_lock(&thread_data->active_mutex);
   thread_data->is_active = false;
   pthread_mutex_unlock(&thread_data->active_mutex);
@@ -2055,11 +2477,29 @@ static int start_event_loop(virt_notif_thread_t *thread_data) {
     return -1;
   }
 
+  /* Hot-plugged devices update the device lists. Without these events, they
+   * are only found on the next refresh. */
+#ifdef HAVE_DEVICE_ADDED_EVENT
+  thread_data->device_added_cb_id = virConnectDomainEventRegisterAny(
+      conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_ADDED,
+      VIR_DOMAIN_EVENT_CALLBACK(domain_device_event_cb), NULL, NULL);
+#endif
+#ifdef HAVE_DEVICE_REMOVED_EVENT
+  thread_data->device_removed_cb_id = virConnectDomainEventRegisterAny(
+      conn, NULL, VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED,
+      VIR_DOMAIN_EVENT_CALLBACK(domain_device_event_cb), NULL, NULL);
+#endif
+
   virt_notif_thread_set_active(thread_data, 1);
   if (pthread_create(&thread_data->event_loop_tid, NULL, event_loop_worker,
                      thread_data)) {
     ERROR(PLUGIN_NAME " plugin: failed event loop thread creation");
     virConnectDomainEventDeregisterAny(conn, thread_data->domain_event_cb_id);
+    if (thread_data->device_added_cb_id != -1)
+      virConnectDomainEventDeregisterAny(conn, thread_data->device_added_cb_id);
+    if (thread_data->device_removed_cb_id != -1)
+      virConnectDomainEventDeregisterAny(conn,
+                                         thread_data->device_removed_cb_id);
     return -1;
   }
 
@@ -2072,6 +2512,10 @@ static void stop_event_loop(virt_notif_thread_t *thread_data) {
   virt_notif_thread_set_active(thread_data, 0);
   if (conn != NULL && thread_data->domain_event_cb_id != -1)
     virConnectDomainEventDeregisterAny(conn, thread_data->domain_event_cb_id);
+  if (conn != NULL && thread_data->device_added_cb_id != -1)
+    virConnectDomainEventDeregisterAny(conn, thread_data->device_added_cb_id);
+  if (conn != NULL && thread_data->device_removed_cb_id != -1)
+    virConnectDomainEventDeregisterAny(conn, thread_data->device_removed_cb_id);
 
   if (pthread_join(notif_thread.event_loop_tid, NULL) != 0)
     ERROR(PLUGIN_NAME " plugin: stopping notification thread failed");
@@ -2179,9 +2623,11 @@ static int lv_read(user_data_t *ud) {
 
   time(&t);
 
-  /* Need to refresh domain or device lists? */
+  /* Need to refresh domain or device lists? In between, the domains reported
+   * by lifecycle and device events are updated. */
   if ((last_refresh == (time_t)0) ||
-      ((interval > 0) && ((last_refresh + interval) <= t))) {
+      ((interval > 0) && ((last_refresh + interval) <= t)) ||
+      (lv_update_lists(inst) != 0)) {
     if (refresh_lists(inst) != 0) {
       if (inst->id == 0) {
         if (!persistent_notification)
@@ -2216,6 +2662,11 @@ static int lv_read(user_data_t *ud) {
           state->interface_devices[i].path);
 #endif
 
+#ifdef HAVE_BULK_STATS
+  if (bulk_stats)
+    return lv_read_bulk(state);
+#endif
+
   /* Get domains' metrics */
   for (int i = 0; i < state->nr_domains; ++i) {
     domain_t *dom = &state->domains[i];
@@ -2286,6 +2737,11 @@ static void lv_fini_instance(size_t i) {
 
   lv_clean_read_state(state);
 
+  pthread_mutex_lock(&changed_lock);
+  sfree(inst->changed);
+  inst->changed_num = 0;
+  pthread_mutex_unlock(&changed_lock);
+
   INFO(PLUGIN_NAME " plugin: reader %s finalized", inst->tag);
 }
 
@@ -2504,10 +2960,88 @@ static void lv_add_network_interfaces(struct lv_read_state *state,
   xmlXPathFreeObject(xpath_obj);
 }
 
+/* Adds the devices of a running domain to the lists of the instance, unless
+ * the domain is ignored or belongs to another instance. */
+static void lv_add_domain_devices(struct lv_read_instance *inst,
+                                  virDomainPtr dom) {
+  struct lv_read_state *state = &inst->read_state;
+
+  const char *domname = virDomainGetName(dom);
+  if (domname == NULL) {
+    VIRT_ERROR(conn, "virDomainGetName");
+    return;
+  }
+
+  virDomainInfo info;
+  int status = virDomainGetInfo(dom, &info);
+  if (status != 0) {
+    ERROR(PLUGIN_NAME " plugin: virDomainGetInfo failed with status %i.",
+          status);
+    return;
+  }
+
+  if (info.state != VIR_DOMAIN_RUNNING) {
+    DEBUG(PLUGIN_NAME " plugin: skipping inactive domain %s", domname);
+    return;
+  }
+
+  if (ignorelist_match(il_domains, domname) != 0)
+    return;
+
+  /* Get a list of devices for this domain. */
+  xmlDocPtr xml_doc = NULL;
+  xmlXPathContextPtr xpath_ctx = NULL;
+
+  char *xml = virDomainGetXMLDesc(dom, 0);
+  if (!xml) {
+    VIRT_ERROR(conn, "virDomainGetXMLDesc");
+    goto cont;
+  }
+
+  /* Yuck, XML.  Parse out the devices. */
+  xml_doc = xmlReadDoc((xmlChar *)xml, NULL, NULL, XML_PARSE_NONET);
+  if (xml_doc == NULL) {
+    VIRT_ERROR(conn, "xmlReadDoc");
+    goto cont;
+  }
+
+  xpath_ctx = xmlXPathNewContext(xml_doc);
+
+  char tag[PARTITION_TAG_MAX_LEN] = {'\0'};
+  if (lv_domain_get_tag(xpath_ctx, domname, tag) < 0) {
+    ERROR(PLUGIN_NAME " plugin: lv_domain_get_tag failed.");
+    goto cont;
+  }
+
+  if (!lv_instance_include_domain(inst, domname, tag))
+    goto cont;
+
+  /* Block devices. */
+  if (report_block_devices)
+    lv_add_block_devices(state, dom, domname, xpath_ctx);
+
+  /* Network interfaces. */
+  if (report_network_interfaces)
+    lv_add_network_interfaces(state, dom, domname, xpath_ctx);
+
+cont:
+  if (xpath_ctx)
+    xmlXPathFreeContext(xpath_ctx);
+  if (xml_doc)
+    xmlFreeDoc(xml_doc);
+  sfree(xml);
+}
+
 static int refresh_lists(struct lv_read_instance *inst) {
   struct lv_read_state *state = &inst->read_state;
   int n;
 
+  /* The lists are rebuilt, so the changes reported so far are obsolete. */
+  pthread_mutex_lock(&changed_lock);
+  inst->changed_num = 0;
+  inst->changed_overflow = false;
+  pthread_mutex_unlock(&changed_lock);
+
 #ifndef HAVE_LIST_ALL_DOMAINS
   n = virConnectNumOfDomains(conn);
   if (n < 0) {
@@ -2589,70 +3123,7 @@ static int refresh_lists(struct lv_read_instance *inst) {
       continue;
     }
 
-    const char *domname = virDomainGetName(dom);
-    if (domname == NULL) {
-      VIRT_ERROR(conn, "virDomainGetName");
-      continue;
-    }
-
-    virDomainInfo info;
-    int status = virDomainGetInfo(dom, &info);
-    if (status != 0) {
-      ERROR(PLUGIN_NAME " plugin: virDomainGetInfo failed with status %i.",
-            status);
-      continue;
-    }
-
-    if (info.state != VIR_DOMAIN_RUNNING) {
-      DEBUG(PLUGIN_NAME " plugin: skipping inactive domain %s", domname);
-      continue;
-    }
-
-    if (ignorelist_match(il_domains, domname) != 0)
-      continue;
-
-    /* Get a list of devices for this domain. */
-    xmlDocPtr xml_doc = NULL;
-    xmlXPathContextPtr xpath_ctx = NULL;
-
-    char *xml = virDomainGetXMLDesc(dom, 0);
-    if (!xml) {
-      VIRT_ERROR(conn, "virDomainGetXMLDesc");
-      goto cont;
-    }
-
-    /* Yuck, XML.  Parse out the devices. */
-    xml_doc = xmlReadDoc((xmlChar *)xml, NULL, NULL, XML_PARSE_NONET);
-    if (xml_doc == NULL) {
-      VIRT_ERROR(conn, "xmlReadDoc");
-      goto cont;
-    }
-
-    xpath_ctx = xmlXPathNewContext(xml_doc);
-
-    char tag[PARTITION_TAG_MAX_LEN] = {'\0'};
-    if (lv_domain_get_tag(xpath_ctx, domname, tag) < 0) {
-      ERROR(PLUGIN_NAME " plugin: lv_domain_get_tag failed.");
-      goto cont;
-    }
-
-    if (!lv_instance_include_domain(inst, domname, tag))
-      goto cont;
-
-    /* Block devices. */
-    if (report_block_devices)
-      lv_add_block_devices(state, dom, domname, xpath_ctx);
-
-    /* Network interfaces. */
-    if (report_network_interfaces)
-      lv_add_network_interfaces(state, dom, domname, xpath_ctx);
-
-  cont:
-    if (xpath_ctx)
-      xmlXPathFreeContext(xpath_ctx);
-    if (xml_doc)
-      xmlFreeDoc(xml_doc);
-    sfree(xml);
+    lv_add_domain_devices(inst, dom);
   }
 
 #ifdef HAVE_LIST_ALL_DOMAINS
@@ -2793,6 +3264,137 @@ static int add_interface_device(struct lv_read_state *state, virDomainPtr dom,
   return state->nr_interface_devices++;
 }
 
+/* Removes a domain and its devices from the lists. */
+static void remove_domain(struct lv_read_state *state,
+                          const unsigned char *uuid) {
+  for (int i = 0; i < state->nr_domains; ++i) {
+    virDomainPtr dom = state->domains[i].ptr;
+    unsigned char dom_uuid[VIR_UUID_BUFLEN];
+    if ((virDomainGetUUID(dom, dom_uuid) != 0) ||
+        (memcmp(dom_uuid, uuid, sizeof(dom_uuid)) != 0))
+      continue;
+
+    int n = 0;
+    for (int j = 0; j < state->nr_block_devices; ++j) {
+      if (state->block_devices[j].dom == dom) {
+        sfree(state->block_devices[j].path);
+        continue;
+      }
+      state->block_devices[n++] = state->block_devices[j];
+    }
+    state->nr_block_devices = n;
+
+    n = 0;
+    for (int j = 0; j < state->nr_interface_devices; ++j) {
+      if (state->interface_devices[j].dom == dom) {
+        sfree(state->interface_devices[j].path);
+        sfree(state->interface_devices[j].address);
+        sfree(state->interface_devices[j].number);
+        continue;
+      }
+      state->interface_devices[n++] = state->interface_devices[j];
+    }
+    state->nr_interface_devices = n;
+
+    virDomainFree(dom);
+    memmove(state->domains + i, state->domains + i + 1,
+            (state->nr_domains - i - 1) * sizeof(state->domains[0]));
+    state->nr_domains--;
+    return;
+  }
+}
+
+/* Re-reads a single domain after an event, like refresh_lists() does for all
+ * domains. */
+static void refresh_domain(struct lv_read_instance *inst,
+                           const unsigned char *uuid) {
+  struct lv_read_state *state = &inst->read_state;
+
+  remove_domain(state, uuid);
+
+  virDomainPtr dom = virDomainLookupByUUID(conn, uuid);
+  if (dom == NULL)
+    /* The domain has been undefined. */
+    return;
+
+  int active = virDomainIsActive(dom);
+  if (active < 0) {
+    VIRT_ERROR(conn, "virDomainIsActive");
+    virDomainFree(dom);
+    return;
+  }
+
+  if (add_domain(state, dom, active == 1) < 0) {
+    ERROR(PLUGIN_NAME " plugin: malloc failed.");
+    virDomainFree(dom);
+    return;
+  }
+
+  if (active == 1)
+    lv_add_domain_devices(inst, dom);
+}
+
+/* Called from the event loop: marks a domain to be updated by the next read
+ * of every instance. */
+static void lv_domain_changed(virDomainPtr dom) {
+  unsigned char uuid[VIR_UUID_BUFLEN];
+  if (virDomainGetUUID(dom, uuid) != 0)
+    return;
+
+  pthread_mutex_lock(&changed_lock);
+  for (int i = 0; i < nr_instances; ++i) {
+    struct lv_read_instance *inst = &(lv_read_user_data[i].inst);
+    if (inst->changed_overflow)
+      continue;
+
+    bool known = false;
+    for (size_t j = 0; (j < inst->changed_num) && !known; ++j)
+      known = (memcmp(inst->changed[j], uuid, sizeof(uuid)) == 0);
+    if (known)
+      continue;
+
+    if (inst->changed_num >= CHANGED_DOMAINS_MAX) {
+      inst->changed_overflow = true;
+      continue;
+    }
+
+    unsigned char(*tmp)[VIR_UUID_BUFLEN] = realloc(
+        inst->changed, (inst->changed_num + 1) * sizeof(inst->changed[0]));
+    if (tmp == NULL) {
+      inst->changed_overflow = true;
+      continue;
+    }
+    inst->changed = tmp;
+    memcpy(inst->changed[inst->changed_num], uuid, sizeof(uuid));
+    inst->changed_num++;
+  }
+  pthread_mutex_unlock(&changed_lock);
+}
+
+/* Updates the domains that changed since the last read. Returns non-zero if
+ * the lists have to be refreshed completely instead. */
+static int lv_update_lists(struct lv_read_instance *inst) {
+  pthread_mutex_lock(&changed_lock);
+  unsigned char(*changed)[VIR_UUID_BUFLEN] = inst->changed;
+  size_t changed_num = inst->changed_num;
+  bool overflow = inst->changed_overflow;
+  inst->changed = NULL;
+  inst->changed_num = 0;
+  inst->changed_overflow = false;
+  pthread_mutex_unlock(&changed_lock);
+
+  if (!overflow)
+    for (size_t i = 0; i < changed_num; ++i)
+      refresh_domain(inst, changed[i]);
+
+  if (changed_num > 0)
+    DEBUG(PLUGIN_NAME " plugin#%s: updated %" PRIsz " changed domains",
+          inst->tag, changed_num);
+
+  sfree(changed);
+  return overflow ? 1 : 0;
+}
+
 static int ignore_device_match(ignorelist_t *il, const char *domname,
                                const char *devpath) {
   if ((domname == NULL) || (devpath == NULL))
@@ -30,10 +30,13 @@
 #include "utils/common/common.h"
 
 #if KERNEL_LINUX
+#include "utils/procfs/procfs.h"
+
 static const char *config_keys[] = {"Verbose"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int verbose_output;
+static procfs_file_t *proc_vmstat;
 /* #endif KERNEL_LINUX */
 
 #else
@@ -99,16 +102,23 @@ static int vmem_read(void) {
   derive_t pgmajfault = 0;
   int pgfaultvalid = 0;
 
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
+
+  if (proc_vmstat == NULL) {
+    proc_vmstat = procfs_open("/proc/vmstat");
+    if (proc_vmstat == NULL) {
+      ERROR("vmem plugin: open (/proc/vmstat) failed: %s", STRERRNO);
+      return -1;
+    }
+  }
 
-  fh = fopen("/proc/vmstat", "r");
-  if (fh == NULL) {
-    ERROR("vmem plugin: fopen (/proc/vmstat) failed: %s", STRERRNO);
+  int status = procfs_read(proc_vmstat);
+  if (status != 0) {
+    ERROR("vmem plugin: reading /proc/vmstat failed: %s", STRERROR(status));
     return -1;
   }
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  while ((buffer = procfs_next_line(proc_vmstat)) != NULL) {
     char *fields[4];
     int fields_num;
     char *key;
@@ -236,10 +246,7 @@ static int vmem_read(void) {
       value_t value = {.derive = counter};
       submit_one(NULL, "vmpage_action", "deactivate", value);
     }
-  } /* while (fgets) */
-
-  fclose(fh);
-  fh = NULL;
+  } /* while (procfs_next_line) */
 
   if (pgfaultvalid == 0x03)
     submit_two(NULL, "vmpage_faults", NULL, pgfault, pgmajfault);
@@ -254,7 +261,14 @@ static int vmem_read(void) {
   return 0;
 } /* int vmem_read */
 
+static int vmem_shutdown(void) {
+  procfs_close(proc_vmstat);
+  proc_vmstat = NULL;
+  return 0;
+} /* int vmem_shutdown */
+
 void module_register(void) {
   plugin_register_config("vmem", vmem_config, config_keys, config_keys_num);
   plugin_register_read("vmem", vmem_read);
+  plugin_register_shutdown("vmem", vmem_shutdown);
 } /* void module_register */
@@ -49,9 +49,12 @@
 #include "utils/common/common.h"
 
 #include "utils/format_graphite/format_graphite.h"
+#include "utils/format_memo/format_memo.h"
 #include "utils_complain.h"
 
 #include <netdb.h>
+#include <poll.h>
+#include <sys/uio.h>
 
 #ifndef WG_DEFAULT_NODE
 #define WG_DEFAULT_NODE "localhost"
@@ -82,6 +85,26 @@
 #define WG_MIN_RECONNECT_INTERVAL TIME_T_TO_CDTIME_T(1)
 #endif
 
+#ifndef WG_DEFAULT_ASYNC_QUEUE_SIZE
+#define WG_DEFAULT_ASYNC_QUEUE_SIZE (1024 * 1024)
+#endif
+
+/* Size of the chunks the asynchronous mode hands to its sending thread. UDP
+ * uses WG_SEND_BUF_SIZE, so that each chunk fits into one datagram. */
+#define WG_ASYNC_CHUNK_SIZE 16384
+#define WG_ASYNC_IOV_MAX 64
+#define WG_ASYNC_POLL_TIMEOUT_MS 1000
+#define WG_ASYNC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(2)
+#define WG_ASYNC_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+typedef struct wg_chunk_s wg_chunk_t;
+struct wg_chunk_s {
+  wg_chunk_t *next;
+  size_t len;
+  size_t lines;
+  char data[];
+};
+
 /*
  * Private variables
  */
@@ -99,6 +122,8 @@ struct wg_callback {
   char escape_char;
 
   unsigned int format_flags;
+  /* Shared with the nodes using the same format options. */
+  format_memo_t *memo;
 
   char send_buf[WG_SEND_BUF_SIZE];
   size_t send_buf_free;
@@ -113,10 +138,28 @@ struct wg_callback {
   cdtime_t last_reconnect_time;
   cdtime_t reconnect_interval;
   bool reconnect_interval_reached;
+
+  /* Asynchronous mode. The socket is only used by "async_thread". */
+  bool async;
+  size_t async_queue_size;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
+
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  wg_chunk_t *queue_head;
+  wg_chunk_t *queue_tail;
+  size_t queue_bytes;
+  /* Bytes of queue_head that have already been sent. */
+  size_t queue_offset;
+  uint64_t dropped;
+  uint64_t dropped_reported;
 };
 
 /* wg_force_reconnect_check closes cb->sock_fd when it was open for longer
- * than cb->reconnect_interval. Must hold cb->send_lock when calling. */
+ * than cb->reconnect_interval. Must hold cb->send_lock when calling, or be
+ * called from the sending thread in asynchronous mode. */
 static void wg_force_reconnect_check(struct wg_callback *cb) {
   cdtime_t now;
 
@@ -280,6 +323,299 @@ static int wg_callback_init(struct wg_callback *cb) {
   return 0;
 }
 
+static void *wg_async_thread(void *arg);
+
+/*
+ * Asynchronous mode: the write threads format value lists into chunks and
+ * append them to "queue". A separate thread per node sends the queue, so that
+ * a slow receiver only delays that node and never blocks the write threads.
+ */
+
+/* Adds "chunk" to the queue of "cb", or drops it if the queue is full. The
+ * sending thread is started by the first write, because the daemon may fork
+ * after reading the configuration. */
+static void wg_async_enqueue(struct wg_callback *cb, wg_chunk_t *chunk) {
+  pthread_mutex_lock(&cb->queue_lock);
+
+  if (!cb->async_thread_running && !cb->async_shutdown) {
+    int status = plugin_thread_create(&cb->async_thread, /* attr = */ NULL,
+                                      wg_async_thread, cb, "write_graphite");
+    if (status != 0)
+      ERROR("write_graphite plugin: plugin_thread_create failed: %s",
+            STRERROR(status));
+    else
+      cb->async_thread_running = true;
+  }
+
+  if (!cb->async_thread_running ||
+      ((cb->queue_bytes + chunk->len) > cb->async_queue_size)) {
+    cb->dropped += chunk->lines;
+    pthread_mutex_unlock(&cb->queue_lock);
+    sfree(chunk);
+    return;
+  }
+
+  if (cb->queue_tail == NULL)
+    cb->queue_head = chunk;
+  else
+    cb->queue_tail->next = chunk;
+  cb->queue_tail = chunk;
+  cb->queue_bytes += chunk->len;
+
+  pthread_cond_signal(&cb->queue_cond);
+  pthread_mutex_unlock(&cb->queue_lock);
+} /* void wg_async_enqueue */
+
+/* Removes "sent" bytes from the front of the queue. queue_lock must be held. */
+static void wg_async_consume(struct wg_callback *cb, size_t sent) {
+  while ((sent > 0) && (cb->queue_head != NULL)) {
+    wg_chunk_t *chunk = cb->queue_head;
+    size_t remaining = chunk->len - cb->queue_offset;
+
+    if (sent < remaining) {
+      cb->queue_offset += sent;
+      return;
+    }
+
+    sent -= remaining;
+    cb->queue_head = chunk->next;
+    if (cb->queue_head == NULL)
+      cb->queue_tail = NULL;
+    cb->queue_bytes -= chunk->len;
+    cb->queue_offset = 0;
+    sfree(chunk);
+  }
+} /* void wg_async_consume */
+
+/* Sends "iov" on the (non-blocking) socket of "cb", connecting first if
+ * necessary. Returns the number of bytes sent, zero if the socket is not
+ * writable, or less than zero if the connection is not usable. */
+static ssize_t wg_async_send(struct wg_callback *cb, struct iovec *iov,
+                             int iov_num, bool at_boundary) {
+  /* Only reconnect between chunks, so that no line is split between two
+   * connections. */
+  if (at_boundary)
+    wg_force_reconnect_check(cb);
+
+  if (cb->sock_fd < 0) {
+    if (wg_callback_init(cb) != 0)
+      return -1;
+
+    int flags = fcntl(cb->sock_fd, F_GETFL);
+    if ((flags == -1) || (fcntl(cb->sock_fd, F_SETFL, flags | O_NONBLOCK) != 0))
+      WARNING("write_graphite plugin: Setting O_NONBLOCK failed: %s",
+              STRERRNO);
+  }
+
+  ssize_t n = writev(cb->sock_fd, iov, iov_num);
+  if (n >= 0)
+    return n;
+
+  if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+    struct pollfd pfd = {.fd = cb->sock_fd, .events = POLLOUT};
+    poll(&pfd, 1, WG_ASYNC_POLL_TIMEOUT_MS);
+    return 0;
+  }
+
+  if (cb->log_send_errors) {
+    ERROR("write_graphite plugin: send to %s:%s (%s) failed: %s", cb->node,
+          cb->service, cb->protocol, STRERRNO);
+  }
+  close(cb->sock_fd);
+  cb->sock_fd = -1;
+  return -1;
+} /* ssize_t wg_async_send */
+
+static void *wg_async_thread(void *arg) {
+  struct wg_callback *cb = arg;
+  cdtime_t shutdown_deadline = 0;
+  cdtime_t last_report = 0;
+
+  bool is_udp = (strcasecmp("udp", cb->protocol) == 0);
+
+  pthread_mutex_lock(&cb->queue_lock);
+  while (42) {
+    while ((cb->queue_head == NULL) && !cb->async_shutdown)
+      pthread_cond_wait(&cb->queue_cond, &cb->queue_lock);
+
+    if (cb->queue_head == NULL)
+      break;
+
+    cdtime_t now = cdtime();
+    if (cb->async_shutdown) {
+      if (shutdown_deadline == 0)
+        shutdown_deadline = now + WG_ASYNC_SHUTDOWN_TIMEOUT;
+      else if (now > shutdown_deadline)
+        break;
+    }
+
+    uint64_t dropped = 0;
+    if ((cb->dropped != cb->dropped_reported) &&
+        ((now - last_report) >= WG_ASYNC_REPORT_INTERVAL)) {
+      dropped = cb->dropped - cb->dropped_reported;
+      cb->dropped_reported = cb->dropped;
+      last_report = now;
+    }
+
+    /* Chunks are only appended by other threads, so the part of the list
+     * collected here does not change while the lock is released. Each UDP
+     * chunk is sent as a separate datagram. */
+    struct iovec iov[WG_ASYNC_IOV_MAX];
+    int iov_num = 0;
+    size_t offset = cb->queue_offset;
+    for (wg_chunk_t *c = cb->queue_head;
+         (c != NULL) && (iov_num < (is_udp ? 1 : WG_ASYNC_IOV_MAX));
+         c = c->next) {
+      iov[iov_num] = (struct iovec){
+          .iov_base = c->data + offset,
+          .iov_len = c->len - offset,
+      };
+      iov_num++;
+      offset = 0;
+    }
+    bool at_boundary = (cb->queue_offset == 0);
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    if (dropped > 0)
+      WARNING("write_graphite plugin: [%s]:%s (%s): The send queue is full. "
+              "%" PRIu64 " lines have been dropped since the last report.",
+              cb->node, cb->service, cb->protocol, dropped);
+
+    ssize_t n = wg_async_send(cb, iov, iov_num, at_boundary);
+
+    pthread_mutex_lock(&cb->queue_lock);
+    if (n > 0) {
+      wg_async_consume(cb, (size_t)n);
+    } else if (n < 0) {
+      if (cb->async_shutdown)
+        break;
+      /* The queue is kept while the node is not reachable. It is bounded by
+       * "AsyncQueueSize"; newer chunks are dropped when it is full. */
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(cdtime() +
+                                                WG_MIN_RECONNECT_INTERVAL);
+      pthread_cond_timedwait(&cb->queue_cond, &cb->queue_lock, &ts);
+    }
+  } /* while (42) */
+
+  uint64_t lost = 0;
+  while (cb->queue_head != NULL) {
+    wg_chunk_t *chunk = cb->queue_head;
+    cb->queue_head = chunk->next;
+    lost += chunk->lines;
+    sfree(chunk);
+  }
+  cb->queue_tail = NULL;
+  cb->queue_bytes = 0;
+  cb->queue_offset = 0;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_graphite plugin: [%s]:%s (%s): %" PRIu64 " lines have not "
+            "been sent when shutting down.",
+            cb->node, cb->service, cb->protocol, lost);
+
+  return NULL;
+} /* void *wg_async_thread */
+
+static void wg_async_stop(struct wg_callback *cb) {
+  pthread_mutex_lock(&cb->queue_lock);
+  cb->async_shutdown = true;
+  pthread_cond_signal(&cb->queue_cond);
+  bool running = cb->async_thread_running;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (running) {
+    pthread_join(cb->async_thread, NULL);
+    cb->async_thread_running = false;
+  }
+} /* void wg_async_stop */
+
+static wg_chunk_t *wg_chunk_create(size_t size) {
+  wg_chunk_t *chunk = malloc(sizeof(*chunk) + size);
+  if (chunk == NULL)
+    return NULL;
+
+  chunk->next = NULL;
+  chunk->len = 0;
+  chunk->lines = 0;
+  return chunk;
+} /* wg_chunk_t *wg_chunk_create */
+
+/* Formats "vl" like format_graphite(), copying it from the memo if another
+ * node has formatted it the same way already. */
+static int wg_format(char *buffer, size_t buffer_size, data_set_t const *ds,
+                     value_list_t const *vl, struct wg_callback *cb) {
+  size_t len = 0;
+  char const *data = format_memo_get(cb->memo, vl, &len);
+  if ((data != NULL) && (len < buffer_size)) {
+    memcpy(buffer, data, len);
+    buffer[len] = 0;
+    return 0;
+  }
+
+  int status = format_graphite(buffer, buffer_size, ds, vl, cb->prefix,
+                               cb->postfix, cb->escape_char, cb->format_flags);
+  if (status == 0)
+    format_memo_put(cb->memo, vl, buffer, strlen(buffer));
+  return status;
+}
+
+/* Formats value lists for the asynchronous mode. No lock is held while
+ * formatting; chunks are handed to the sending thread as they fill up. */
+static int wg_write_async(data_set_t const *const *ds,
+                          value_list_t const *const *vl, size_t num,
+                          struct wg_callback *cb) {
+  /* UDP chunks must fit into a single datagram. */
+  size_t chunk_size = (strcasecmp("udp", cb->protocol) == 0)
+                          ? WG_SEND_BUF_SIZE
+                          : WG_ASYNC_CHUNK_SIZE;
+  if (chunk_size > cb->async_queue_size)
+    chunk_size = cb->async_queue_size;
+  wg_chunk_t *chunk = NULL;
+  int failure = 0;
+
+  for (size_t i = 0; i < num; i++) {
+    char buffer[WG_SEND_BUF_SIZE] = {0};
+
+    if (strcmp(ds[i]->type, vl[i]->type) != 0) {
+      ERROR("write_graphite plugin: DS type does not match "
+            "value list type");
+      failure++;
+      continue;
+    }
+
+    if (wg_format(buffer, sizeof(buffer), ds[i], vl[i], cb) != 0) {
+      failure++;
+      continue;
+    }
+
+    size_t len = strlen(buffer);
+    if ((chunk != NULL) && ((chunk->len + len) > chunk_size)) {
+      wg_async_enqueue(cb, chunk);
+      chunk = NULL;
+    }
+    if (chunk == NULL) {
+      chunk = wg_chunk_create(chunk_size);
+      if (chunk == NULL) {
+        ERROR("write_graphite plugin: malloc failed.");
+        failure++;
+        continue;
+      }
+    }
+
+    memcpy(chunk->data + chunk->len, buffer, len);
+    chunk->len += len;
+    for (size_t j = 0; j < len; j++)
+      if (buffer[j] == '\n')
+        chunk->lines++;
+  }
+
+  if (chunk != NULL)
+    wg_async_enqueue(cb, chunk);
+
+  return (failure == (int)num) ? -1 : 0;
+} /* int wg_write_async */
+
 static void wg_callback_free(void *data) {
   struct wg_callback *cb;
 
@@ -288,6 +624,9 @@ static void wg_callback_free(void *data) {
 
   cb = data;
 
+  if (cb->async)
+    wg_async_stop(cb);
+
   pthread_mutex_lock(&cb->send_lock);
 
   wg_flush_nolock(/* timeout = */ 0, cb);
@@ -303,9 +642,12 @@ static void wg_callback_free(void *data) {
   sfree(cb->service);
   sfree(cb->prefix);
   sfree(cb->postfix);
+  format_memo_release(cb->memo);
 
   pthread_mutex_unlock(&cb->send_lock);
   pthread_mutex_destroy(&cb->send_lock);
+  pthread_cond_destroy(&cb->queue_cond);
+  pthread_mutex_destroy(&cb->queue_lock);
 
   sfree(cb);
 }
@@ -321,6 +663,10 @@ static int wg_flush(cdtime_t timeout,
 
   cb = user_data->data;
 
+  /* The sending thread sends chunks as soon as they are queued. */
+  if (cb->async)
+    return 0;
+
   pthread_mutex_lock(&cb->send_lock);
 
   if (cb->sock_fd < 0) {
@@ -338,31 +684,27 @@ static int wg_flush(cdtime_t timeout,
   return status;
 }
 
-static int wg_send_message(char const *message, struct wg_callback *cb) {
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_send_message_nolock(char const *message, struct wg_callback *cb) {
   int status;
   size_t message_len;
 
   message_len = strlen(message);
 
-  pthread_mutex_lock(&cb->send_lock);
-
   wg_force_reconnect_check(cb);
 
   if (cb->sock_fd < 0) {
     status = wg_callback_init(cb);
     if (status != 0) {
       /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
       return -1;
     }
   }
 
   if (message_len >= cb->send_buf_free) {
     status = wg_flush_nolock(/* timeout = */ 0, cb);
-    if (status != 0) {
-      pthread_mutex_unlock(&cb->send_lock);
+    if (status != 0)
       return status;
-    }
   }
 
   /* Assert that we have enough space for this message. */
@@ -381,11 +723,10 @@ static int wg_send_message(char const *message, struct wg_callback *cb) {
         100.0 * ((double)cb->send_buf_fill) / ((double)sizeof(cb->send_buf)),
         message);
 
-  pthread_mutex_unlock(&cb->send_lock);
-
   return 0;
 }
 
+/* NOTE: You must hold cb->send_lock when calling this function! */
 static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
                              struct wg_callback *cb) {
   char buffer[WG_SEND_BUF_SIZE] = {0};
@@ -397,32 +738,39 @@ static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  status = format_graphite(buffer, sizeof(buffer), ds, vl, cb->prefix,
-                           cb->postfix, cb->escape_char, cb->format_flags);
+  status = wg_format(buffer, sizeof(buffer), ds, vl, cb);
   if (status != 0) /* error message has been printed already. */
     return status;
 
   /* Send the message to graphite */
-  status = wg_send_message(buffer, cb);
+  status = wg_send_message_nolock(buffer, cb);
   if (status != 0) /* error message has been printed already. */
     return status;
 
   return 0;
 } /* int wg_write_messages */
 
-static int wg_write(const data_set_t *ds, const value_list_t *vl,
-                    user_data_t *user_data) {
+static int wg_write(data_set_t const *const *ds, value_list_t const *const *vl,
+                    size_t num, user_data_t *user_data) {
   struct wg_callback *cb;
-  int status;
+  int failure = 0;
 
   if (user_data == NULL)
     return EINVAL;
 
   cb = user_data->data;
 
-  status = wg_write_messages(ds, vl, cb);
+  if (cb->async)
+    return wg_write_async(ds, vl, num, cb);
 
-  return status;
+  /* Format and buffer the whole batch while holding the lock once. */
+  pthread_mutex_lock(&cb->send_lock);
+  for (size_t i = 0; i < num; i++)
+    if (wg_write_messages(ds[i], vl[i], cb) != 0)
+      failure++;
+  pthread_mutex_unlock(&cb->send_lock);
+
+  return (failure == (int)num) ? -1 : 0;
 }
 
 static int config_set_char(char *dest, oconfig_item_t *ci) {
@@ -473,6 +821,8 @@ static int wg_config_node(oconfig_item_t *ci) {
   cb->postfix = NULL;
   cb->escape_char = WG_DEFAULT_ESCAPE;
   cb->format_flags = GRAPHITE_STORE_RATES;
+  cb->async = false;
+  cb->async_queue_size = WG_DEFAULT_ASYNC_QUEUE_SIZE;
 
   /* FIXME: Legacy configuration syntax. */
   if (strcasecmp("Carbon", ci->key) != 0) {
@@ -484,6 +834,8 @@ static int wg_config_node(oconfig_item_t *ci) {
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->queue_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->queue_cond, /* attr = */ NULL);
   C_COMPLAIN_INIT(&cb->init_complaint);
 
   for (int i = 0; i < ci->children_num; i++) {
@@ -523,6 +875,20 @@ static int wg_config_node(oconfig_item_t *ci) {
       cf_util_get_flag(child, &cb->format_flags, GRAPHITE_USE_TAGS);
     else if (strcasecmp("EscapeCharacter", child->key) == 0)
       config_set_char(&cb->escape_char, child);
+    else if (strcasecmp("Asynchronous", child->key) == 0)
+      cf_util_get_boolean(child, &cb->async);
+    else if (strcasecmp("AsyncQueueSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < WG_SEND_BUF_SIZE)) {
+        ERROR("write_graphite plugin: \"AsyncQueueSize\" must be at least "
+              "%d.",
+              WG_SEND_BUF_SIZE);
+        status = -1;
+      }
+      if (status == 0)
+        cb->async_queue_size = (size_t)tmp;
+    }
     else {
       ERROR("write_graphite plugin: Invalid configuration "
             "option: %s.",
@@ -539,6 +905,15 @@ static int wg_config_node(oconfig_item_t *ci) {
     return status;
   }
 
+  /* Nodes formatting the same way share the formatted value lists. */
+  char options[1024];
+  int options_len = snprintf(options, sizeof(options), "%s%c%s%c%c%u",
+                             (cb->prefix != NULL) ? cb->prefix : "", 0,
+                             (cb->postfix != NULL) ? cb->postfix : "", 0,
+                             cb->escape_char, cb->format_flags);
+  if ((options_len > 0) && ((size_t)options_len < sizeof(options)))
+    cb->memo = format_memo_acquire("graphite", options, (size_t)options_len);
+
   /* FIXME: Legacy configuration syntax. */
   if (cb->name == NULL)
     snprintf(callback_name, sizeof(callback_name), "write_graphite/%s/%s/%s",
@@ -547,10 +922,10 @@ static int wg_config_node(oconfig_item_t *ci) {
     snprintf(callback_name, sizeof(callback_name), "write_graphite/%s",
              cb->name);
 
-  plugin_register_write(callback_name, wg_write,
-                        &(user_data_t){
-                            .data = cb, .free_func = wg_callback_free,
-                        });
+  plugin_register_write_batch(callback_name, wg_write,
+                              &(user_data_t){
+                                  .data = cb, .free_func = wg_callback_free,
+                              });
 
   plugin_register_flush(callback_name, wg_flush, &(user_data_t){.data = cb});
 
@@ -27,11 +27,17 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
 #include "utils/format_json/format_json.h"
 #include "utils/format_kairosdb/format_kairosdb.h"
+#include "utils_complain.h"
 
 #include <curl/curl.h>
 
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #ifndef WRITE_HTTP_DEFAULT_BUFFER_SIZE
 #define WRITE_HTTP_DEFAULT_BUFFER_SIZE 4096
 #endif
@@ -40,6 +46,30 @@
 #define WRITE_HTTP_DEFAULT_PREFIX "collectd"
 #endif
 
+#define WH_ASYNC_DEFAULT_MAX_CONNECTIONS 4
+#define WH_ASYNC_DEFAULT_MAX_PENDING_BYTES (8 * 1024 * 1024)
+#define WH_ASYNC_POLL_TIMEOUT_MS 100
+#define WH_ASYNC_BACKOFF_MIN TIME_T_TO_CDTIME_T(1)
+#define WH_ASYNC_BACKOFF_MAX TIME_T_TO_CDTIME_T(60)
+#define WH_ASYNC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(5)
+#define WH_ASYNC_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+/* A request body waiting to be sent by the asynchronous sender. */
+typedef struct wh_request_s wh_request_t;
+struct wh_request_s {
+  wh_request_t *next;
+  size_t len;
+  char data[];
+};
+
+/* An easy handle of the asynchronous sender and the request it is sending,
+ * if any. The handles are reused, so that connections are kept alive. */
+typedef struct {
+  CURL *curl;
+  wh_request_t *req;
+  char errbuf[CURL_ERROR_SIZE];
+} wh_transfer_t;
+
 /*
  * Private variables
  */
@@ -70,10 +100,12 @@ struct wh_callback_s {
   int format;
   bool send_metrics;
   bool send_notifications;
+  bool compress;
 
   CURL *curl;
   struct curl_slist *headers;
   char curl_errbuf[CURL_ERROR_SIZE];
+  curl_stats_t *stats;
 
   char *send_buffer;
   size_t send_buffer_size;
@@ -81,23 +113,48 @@ struct wh_callback_s {
   size_t send_buffer_fill;
   cdtime_t send_buffer_init_time;
 
+  /* The JSON format uses "json_buffer" instead of "send_buffer". It grows as
+   * needed and is sent once it holds "send_buffer_size" bytes. */
+  format_json_buffer_t json_buffer;
+
   pthread_mutex_t send_lock;
 
   int data_ttl;
   char *metrics_prefix;
+
+  /* In asynchronous mode, request bodies are queued and sent by
+   * "async_thread" using up to "max_connections" concurrent transfers.
+   * "queue_bytes" counts queued and in-flight bodies; new ones are dropped
+   * when it would exceed "max_pending_bytes". */
+  bool async;
+  int max_connections;
+  size_t max_pending_bytes;
+  CURLM *multi;
+  wh_transfer_t *transfers;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  wh_request_t *queue_head;
+  wh_request_t *queue_tail;
+  size_t queue_bytes;
+  uint64_t dropped;
+  cdtime_t dropped_reported;
+  c_complain_t retry_complaint;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
 };
 typedef struct wh_callback_s wh_callback_t;
 
 static char **http_attrs;
 static size_t http_attrs_num;
 
-static void wh_log_http_error(wh_callback_t *cb) {
+static void wh_log_http_error(wh_callback_t *cb, CURL *curl) {
   if (!cb->log_http_error)
     return;
 
   long http_code = 0;
 
-  curl_easy_getinfo(cb->curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
   if (http_code != 200)
     INFO("write_http plugin: HTTP Error code: %lu", http_code);
@@ -105,7 +162,16 @@ static void wh_log_http_error(wh_callback_t *cb) {
 
 static void wh_reset_buffer(wh_callback_t *cb) /* {{{ */
 {
-  if ((cb == NULL) || (cb->send_buffer == NULL))
+  if (cb == NULL)
+    return;
+
+  if (cb->format == WH_FORMAT_JSON) {
+    format_json_buffer_reset(&cb->json_buffer);
+    cb->send_buffer_init_time = cdtime();
+    return;
+  }
+
+  if (cb->send_buffer == NULL)
     return;
 
   memset(cb->send_buffer, 0, cb->send_buffer_size);
@@ -113,30 +179,81 @@ static void wh_reset_buffer(wh_callback_t *cb) /* {{{ */
   cb->send_buffer_fill = 0;
   cb->send_buffer_init_time = cdtime();
 
-  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
+  if (cb->format == WH_FORMAT_KAIROSDB) {
     format_json_initialize(cb->send_buffer, &cb->send_buffer_fill,
                            &cb->send_buffer_free);
   }
 } /* }}} wh_reset_buffer */
 
-/* must hold cb->send_lock when calling */
-static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
-{
-  int status = 0;
+/* wh_curl_setup sets the options of an easy handle. "cb->headers" must be
+ * complete at this point. */
+static int wh_curl_setup(wh_callback_t *cb, CURL *curl, /* {{{ */
+                         char *errbuf) {
+  if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
+                     (long)(cb->low_speed_limit * cb->low_speed_time));
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)cb->low_speed_time);
+  }
 
-  curl_easy_setopt(cb->curl, CURLOPT_URL, cb->location);
-  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDS, data);
-  status = curl_easy_perform(cb->curl);
+#ifdef HAVE_CURLOPT_TIMEOUT_MS
+  if (cb->timeout > 0)
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+#endif
 
-  wh_log_http_error(cb);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
 
-  if (status != CURLE_OK) {
-    ERROR("write_http plugin: curl_easy_perform failed with "
-          "status %i: %s",
-          status, cb->curl_errbuf);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, cb->headers);
+
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 50L);
+
+  if (cb->user != NULL) {
+#ifdef HAVE_CURLOPT_USERNAME
+    curl_easy_setopt(curl, CURLOPT_USERNAME, cb->user);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD,
+                     (cb->pass == NULL) ? "" : cb->pass);
+#else
+    if (cb->credentials == NULL) {
+      size_t credentials_size;
+
+      credentials_size = strlen(cb->user) + 2;
+      if (cb->pass != NULL)
+        credentials_size += strlen(cb->pass);
+
+      cb->credentials = malloc(credentials_size);
+      if (cb->credentials == NULL) {
+        ERROR("curl plugin: malloc failed.");
+        return -1;
+      }
+
+      snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
+               (cb->pass == NULL) ? "" : cb->pass);
+    }
+    curl_easy_setopt(curl, CURLOPT_USERPWD, cb->credentials);
+#endif
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
   }
-  return status;
-} /* }}} wh_post_nolock */
+
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, cb->sslversion);
+  if (cb->cacert != NULL)
+    curl_easy_setopt(curl, CURLOPT_CAINFO, cb->cacert);
+  if (cb->capath != NULL)
+    curl_easy_setopt(curl, CURLOPT_CAPATH, cb->capath);
+
+  if (cb->clientkey != NULL && cb->clientcert != NULL) {
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, cb->clientkey);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, cb->clientcert);
+
+    if (cb->clientkeypass != NULL)
+      curl_easy_setopt(curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  }
+
+  return 0;
+} /* }}} int wh_curl_setup */
 
 static int wh_callback_init(wh_callback_t *cb) /* {{{ */
 {
@@ -149,21 +266,6 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
     return -1;
   }
 
-  if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_LIMIT,
-                     (long)(cb->low_speed_limit * cb->low_speed_time));
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_TIME,
-                     (long)cb->low_speed_time);
-  }
-
-#ifdef HAVE_CURLOPT_TIMEOUT_MS
-  if (cb->timeout > 0)
-    curl_easy_setopt(cb->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
-#endif
-
-  curl_easy_setopt(cb->curl, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
-
   cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
   if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
     cb->headers =
@@ -171,57 +273,461 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
   else
     cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
   cb->headers = curl_slist_append(cb->headers, "Expect:");
-  curl_easy_setopt(cb->curl, CURLOPT_HTTPHEADER, cb->headers);
+  if (cb->compress)
+    cb->headers = curl_slist_append(cb->headers, "Content-Encoding: gzip");
 
-  curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  curl_easy_setopt(cb->curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_MAXREDIRS, 50L);
+  if (wh_curl_setup(cb, cb->curl, cb->curl_errbuf) != 0)
+    return -1;
 
-  if (cb->user != NULL) {
-#ifdef HAVE_CURLOPT_USERNAME
-    curl_easy_setopt(cb->curl, CURLOPT_USERNAME, cb->user);
-    curl_easy_setopt(cb->curl, CURLOPT_PASSWORD,
-                     (cb->pass == NULL) ? "" : cb->pass);
-#else
-    size_t credentials_size;
+  wh_reset_buffer(cb);
 
-    credentials_size = strlen(cb->user) + 2;
-    if (cb->pass != NULL)
-      credentials_size += strlen(cb->pass);
+  return 0;
+} /* }}} int wh_callback_init */
 
-    cb->credentials = malloc(credentials_size);
-    if (cb->credentials == NULL) {
-      ERROR("curl plugin: malloc failed.");
+#if HAVE_LIBZ
+/* wh_gzip compresses "*len" bytes at "data" into a newly allocated buffer,
+ * "offset" bytes after its start, and sets "*len" to the compressed size. */
+static void *wh_gzip(char const *data, size_t *len, size_t offset) /* {{{ */
+{
+  z_stream z = {0};
+
+  /* windowBits + 16 selects the gzip format. */
+  int status = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                            /* windowBits = */ 15 + 16, /* memLevel = */ 8,
+                            Z_DEFAULT_STRATEGY);
+  if (status != Z_OK) {
+    ERROR("write_http plugin: deflateInit2 failed with status %d.", status);
+    return NULL;
+  }
+
+  size_t bound = (size_t)deflateBound(&z, (uLong)*len);
+  char *buffer = malloc(offset + bound);
+  if (buffer == NULL) {
+    ERROR("write_http plugin: malloc failed.");
+    deflateEnd(&z);
+    return NULL;
+  }
+
+  z.next_in = (Bytef *)data;
+  z.avail_in = (uInt)*len;
+  z.next_out = (Bytef *)buffer + offset;
+  z.avail_out = (uInt)bound;
+
+  status = deflate(&z, Z_FINISH);
+  deflateEnd(&z);
+  if (status != Z_STREAM_END) {
+    ERROR("write_http plugin: deflate failed with status %d.", status);
+    sfree(buffer);
+    return NULL;
+  }
+
+  *len = (size_t)z.total_out;
+  return buffer;
+} /* }}} void *wh_gzip */
+#endif /* HAVE_LIBZ */
+
+/* must hold cb->queue_lock when calling */
+static void wh_async_report_drops(wh_callback_t *cb, cdtime_t now) /* {{{ */
+{
+  if ((cb->dropped == 0) ||
+      ((now - cb->dropped_reported) < WH_ASYNC_REPORT_INTERVAL))
+    return;
+
+  WARNING("write_http plugin: <%s>: The send queue is full. %" PRIu64
+          " requests have been dropped since the last report.",
+          cb->location, cb->dropped);
+  cb->dropped = 0;
+  cb->dropped_reported = now;
+} /* }}} void wh_async_report_drops */
+
+/* wh_async_retryable returns true if a transfer that failed should be sent
+ * again later, because the server could not be reached or asked us to slow
+ * down. */
+static bool wh_async_retryable(CURLcode result, long http_code) /* {{{ */
+{
+  switch (result) {
+  case CURLE_OK:
+    return (http_code == 429) || (http_code == 503);
+  case CURLE_COULDNT_RESOLVE_HOST:
+  case CURLE_COULDNT_CONNECT:
+  case CURLE_OPERATION_TIMEDOUT:
+  case CURLE_SEND_ERROR:
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+    return true;
+  default:
+    return false;
+  }
+} /* }}} bool wh_async_retryable */
+
+/* wh_async_complete handles a finished transfer. It returns true if the
+ * request has to be sent again, in which case "*backoff" is set to the time
+ * to wait before doing so. Otherwise the request is done with. */
+static bool wh_async_complete(wh_callback_t *cb, /* {{{ */
+                              wh_transfer_t *t, CURLcode result,
+                              cdtime_t *backoff) {
+  long http_code = 0;
+  curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  if ((result == CURLE_OK) && (http_code >= 200) && (http_code < 300)) {
+    c_release(LOG_INFO, &cb->retry_complaint,
+              "write_http plugin: <%s>: Sending succeeded again.",
+              cb->location);
+    *backoff = 0;
+    return false;
+  }
+
+  if (!wh_async_retryable(result, http_code)) {
+    if (result != CURLE_OK)
+      ERROR("write_http plugin: <%s>: Sending failed with status %i: %s",
+            cb->location, result, t->errbuf);
+    else
+      wh_log_http_error(cb, t->curl);
+    return false;
+  }
+
+  /* Double the time to wait with every failure in a row. */
+  *backoff *= 2;
+  if (*backoff < WH_ASYNC_BACKOFF_MIN)
+    *backoff = WH_ASYNC_BACKOFF_MIN;
+
+#if LIBCURL_VERSION_NUM >= 0x074200
+  curl_off_t retry_after = 0;
+  if ((curl_easy_getinfo(t->curl, CURLINFO_RETRY_AFTER, &retry_after) ==
+       CURLE_OK) &&
+      (retry_after > 0))
+    *backoff = TIME_T_TO_CDTIME_T((time_t)retry_after);
+#endif
+
+  if (*backoff > WH_ASYNC_BACKOFF_MAX)
+    *backoff = WH_ASYNC_BACKOFF_MAX;
+
+  if (result != CURLE_OK)
+    c_complain(LOG_WARNING, &cb->retry_complaint,
+               "write_http plugin: <%s>: Sending failed with status %i: %s. "
+               "Retrying in %.3f seconds.",
+               cb->location, result, t->errbuf, CDTIME_T_TO_DOUBLE(*backoff));
+  else
+    c_complain(LOG_WARNING, &cb->retry_complaint,
+               "write_http plugin: <%s>: The server responded with HTTP "
+               "status %ld. Retrying in %.3f seconds.",
+               cb->location, http_code, CDTIME_T_TO_DOUBLE(*backoff));
+  return true;
+} /* }}} bool wh_async_complete */
+
+/* wh_async_thread sends the queued requests of "cb". Up to "max_connections"
+ * transfers are in flight at a time. When the server cannot be reached or
+ * responds with 429 or 503, failed requests are put back at the head of the
+ * queue and no new request is started until the back-off time has passed. */
+static void *wh_async_thread(void *arg) /* {{{ */
+{
+  wh_callback_t *cb = arg;
+  size_t transfers_num = (size_t)cb->max_connections;
+  size_t in_flight = 0;
+  cdtime_t backoff = 0;
+  cdtime_t retry_at = 0;
+  cdtime_t deadline = 0;
+
+  pthread_mutex_lock(&cb->queue_lock);
+  while (42) {
+    cdtime_t now = cdtime();
+    wh_async_report_drops(cb, now);
+
+    /* When shutting down, keep sending for a while. */
+    if (cb->async_shutdown) {
+      if (deadline == 0)
+        deadline = now + WH_ASYNC_SHUTDOWN_TIMEOUT;
+      if (((in_flight == 0) && (cb->queue_head == NULL)) || (now >= deadline))
+        break;
+    }
+
+    bool may_send = (now >= retry_at);
+    if ((in_flight == 0) && ((cb->queue_head == NULL) || !may_send)) {
+      if (cb->queue_head == NULL) {
+        pthread_cond_wait(&cb->queue_cond, &cb->queue_lock);
+      } else {
+        cdtime_t until = retry_at;
+        if ((deadline != 0) && (deadline < until))
+          until = deadline;
+        struct timespec ts = CDTIME_T_TO_TIMESPEC(until);
+        pthread_cond_timedwait(&cb->queue_cond, &cb->queue_lock, &ts);
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < transfers_num; i++) {
+      wh_transfer_t *t = cb->transfers + i;
+      if (!may_send || (cb->queue_head == NULL))
+        break;
+      if (t->req != NULL)
+        continue;
+
+      t->req = cb->queue_head;
+      cb->queue_head = t->req->next;
+      if (cb->queue_head == NULL)
+        cb->queue_tail = NULL;
+      t->req->next = NULL;
+
+      curl_easy_setopt(t->curl, CURLOPT_POSTFIELDSIZE, (long)t->req->len);
+      curl_easy_setopt(t->curl, CURLOPT_POSTFIELDS, (char *)t->req->data);
+      curl_multi_add_handle(cb->multi, t->curl);
+      in_flight++;
+    }
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    int running = 0;
+    curl_multi_perform(cb->multi, &running);
+    if (running > 0) {
+      curl_multi_wait(cb->multi, /* extra_fds = */ NULL, /* extra_nfds = */ 0,
+                      WH_ASYNC_POLL_TIMEOUT_MS, /* numfds = */ NULL);
+      curl_multi_perform(cb->multi, &running);
+    }
+
+    wh_request_t *retry_head = NULL;
+    wh_request_t *retry_tail = NULL;
+    size_t done_bytes = 0;
+
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(cb->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      CURLcode result = msg->data.result;
+      char *priv = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+      wh_transfer_t *t = (wh_transfer_t *)priv;
+
+      curl_multi_remove_handle(cb->multi, t->curl);
+      in_flight--;
+      curl_stats_dispatch(cb->stats, t->curl, NULL, "write_http", cb->name);
+
+      wh_request_t *req = t->req;
+      t->req = NULL;
+
+      if (wh_async_complete(cb, t, result, &backoff)) {
+        retry_at = cdtime() + backoff;
+        if (retry_tail == NULL)
+          retry_head = req;
+        else
+          retry_tail->next = req;
+        retry_tail = req;
+      } else {
+        done_bytes += req->len;
+        sfree(req);
+      }
+    }
+
+    pthread_mutex_lock(&cb->queue_lock);
+    if (retry_head != NULL) {
+      retry_tail->next = cb->queue_head;
+      cb->queue_head = retry_head;
+      if (cb->queue_tail == NULL)
+        cb->queue_tail = retry_tail;
+    }
+    cb->queue_bytes -= done_bytes;
+  }
+
+  /* Give up on what has not been sent. */
+  size_t lost = 0;
+  for (size_t i = 0; i < transfers_num; i++) {
+    wh_transfer_t *t = cb->transfers + i;
+    if (t->req == NULL)
+      continue;
+
+    curl_multi_remove_handle(cb->multi, t->curl);
+    sfree(t->req);
+    lost++;
+  }
+  while (cb->queue_head != NULL) {
+    wh_request_t *req = cb->queue_head;
+    cb->queue_head = req->next;
+    sfree(req);
+    lost++;
+  }
+  cb->queue_tail = NULL;
+  cb->queue_bytes = 0;
+
+  /* Report the remaining drops, too. */
+  cb->dropped_reported = 0;
+  wh_async_report_drops(cb, cdtime());
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_http plugin: <%s>: %" PRIsz " requests have not been sent "
+            "when shutting down.",
+            cb->location, lost);
+
+  return NULL;
+} /* }}} void *wh_async_thread */
+
+/* wh_async_start sets up the easy handles and starts the sending thread.
+ * This is done on the first request, because the daemon may fork after
+ * reading the configuration. Must hold cb->queue_lock when calling. */
+static int wh_async_start(wh_callback_t *cb) /* {{{ */
+{
+  size_t transfers_num = (size_t)cb->max_connections;
+
+  cb->multi = curl_multi_init();
+  if (cb->multi == NULL) {
+    ERROR("write_http plugin: curl_multi_init failed.");
+    return -1;
+  }
+
+  cb->transfers = calloc(transfers_num, sizeof(*cb->transfers));
+  if (cb->transfers == NULL) {
+    ERROR("write_http plugin: calloc failed.");
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
+    return -1;
+  }
+  /* Keep one connection per transfer alive. */
+  curl_multi_setopt(cb->multi, CURLMOPT_MAXCONNECTS,
+                    (long)cb->max_connections);
+
+  for (size_t i = 0; i < transfers_num; i++) {
+    wh_transfer_t *t = cb->transfers + i;
+
+    t->curl = curl_easy_init();
+    if (t->curl == NULL) {
+      ERROR("write_http plugin: curl_easy_init failed.");
       return -1;
     }
+    if (wh_curl_setup(cb, t->curl, t->errbuf) != 0)
+      return -1;
+    curl_easy_setopt(t->curl, CURLOPT_URL, cb->location);
+    curl_easy_setopt(t->curl, CURLOPT_PRIVATE, (char *)t);
+  }
 
-    snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
-             (cb->pass == NULL) ? "" : cb->pass);
-    curl_easy_setopt(cb->curl, CURLOPT_USERPWD, cb->credentials);
+  int status = plugin_thread_create(&cb->async_thread, /* attr = */ NULL,
+                                    wh_async_thread, cb, "write_http");
+  if (status != 0) {
+    ERROR("write_http plugin: plugin_thread_create failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+
+  cb->async_thread_running = true;
+  return 0;
+} /* }}} int wh_async_start */
+
+/* wh_async_stop lets the sending thread send what is queued and waits for it
+ * to exit. */
+static void wh_async_stop(wh_callback_t *cb) /* {{{ */
+{
+  pthread_mutex_lock(&cb->queue_lock);
+  cb->async_shutdown = true;
+  pthread_cond_signal(&cb->queue_cond);
+  bool running = cb->async_thread_running;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (running) {
+    pthread_join(cb->async_thread, NULL);
+    cb->async_thread_running = false;
+  }
+
+  if (cb->transfers != NULL) {
+    for (int i = 0; i < cb->max_connections; i++)
+      if (cb->transfers[i].curl != NULL)
+        curl_easy_cleanup(cb->transfers[i].curl);
+    sfree(cb->transfers);
+  }
+  if (cb->multi != NULL) {
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
+  }
+} /* }}} void wh_async_stop */
+
+/* wh_async_post queues a copy of "data" for the sending thread, or drops it
+ * if "MaxPendingBytes" would be exceeded. */
+static int wh_async_post(wh_callback_t *cb, char const *data, /* {{{ */
+                         size_t len) {
+  wh_request_t *req;
+
+#if HAVE_LIBZ
+  if (cb->compress)
+    req = wh_gzip(data, &len, sizeof(*req));
+  else
 #endif
-    curl_easy_setopt(cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+  {
+    req = malloc(sizeof(*req) + len);
+    if (req != NULL)
+      memcpy(req->data, data, len);
   }
+  if (req == NULL) {
+    ERROR("write_http plugin: Allocating a request failed.");
+    return ENOMEM;
+  }
+  req->next = NULL;
+  req->len = len;
 
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
-  curl_easy_setopt(cb->curl, CURLOPT_SSLVERSION, cb->sslversion);
-  if (cb->cacert != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAINFO, cb->cacert);
-  if (cb->capath != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAPATH, cb->capath);
+  pthread_mutex_lock(&cb->queue_lock);
 
-  if (cb->clientkey != NULL && cb->clientcert != NULL) {
-    curl_easy_setopt(cb->curl, CURLOPT_SSLKEY, cb->clientkey);
-    curl_easy_setopt(cb->curl, CURLOPT_SSLCERT, cb->clientcert);
+  if (!cb->async_thread_running && !cb->async_shutdown &&
+      (cb->transfers == NULL))
+    wh_async_start(cb);
 
-    if (cb->clientkeypass != NULL)
-      curl_easy_setopt(cb->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  if (!cb->async_thread_running) {
+    pthread_mutex_unlock(&cb->queue_lock);
+    sfree(req);
+    return -1;
   }
 
-  wh_reset_buffer(cb);
+  if ((cb->queue_bytes + req->len) > cb->max_pending_bytes) {
+    cb->dropped++;
+    wh_async_report_drops(cb, cdtime());
+    pthread_mutex_unlock(&cb->queue_lock);
+    sfree(req);
+    return 0;
+  }
 
+  if (cb->queue_tail == NULL)
+    cb->queue_head = req;
+  else
+    cb->queue_tail->next = req;
+  cb->queue_tail = req;
+  cb->queue_bytes += req->len;
+
+  pthread_cond_signal(&cb->queue_cond);
+  pthread_mutex_unlock(&cb->queue_lock);
   return 0;
-} /* }}} int wh_callback_init */
+} /* }}} int wh_async_post */
+
+/* must hold cb->send_lock when calling */
+static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
+{
+  size_t len = strlen(data);
+  int status = 0;
+
+  if (cb->async)
+    return wh_async_post(cb, data, len);
+
+  char *compressed = NULL;
+#if HAVE_LIBZ
+  if (cb->compress) {
+    compressed = wh_gzip(data, &len, /* offset = */ 0);
+    if (compressed == NULL)
+      return -1;
+    data = compressed;
+  }
+#endif
+
+  curl_easy_setopt(cb->curl, CURLOPT_URL, cb->location);
+  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDSIZE, (long)len);
+  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDS, data);
+  status = curl_easy_perform(cb->curl);
+  sfree(compressed);
+
+  wh_log_http_error(cb, cb->curl);
+  curl_stats_dispatch(cb->stats, cb->curl, NULL, "write_http", cb->name);
+
+  if (status != CURLE_OK) {
+    ERROR("write_http plugin: curl_easy_perform failed with "
+          "status %i: %s",
+          status, cb->curl_errbuf);
+  }
+  return status;
+} /* }}} wh_post_nolock */
 
 static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
 {
@@ -248,7 +754,23 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
 
     status = wh_post_nolock(cb, cb->send_buffer);
     wh_reset_buffer(cb);
-  } else if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
+  } else if (cb->format == WH_FORMAT_JSON) {
+    if (cb->json_buffer.values_num == 0) {
+      cb->send_buffer_init_time = cdtime();
+      return 0;
+    }
+
+    status = format_json_buffer_finalize(&cb->json_buffer);
+    if (status != 0) {
+      ERROR("write_http: wh_flush_nolock: "
+            "format_json_buffer_finalize failed.");
+      wh_reset_buffer(cb);
+      return status;
+    }
+
+    status = wh_post_nolock(cb, cb->json_buffer.data);
+    wh_reset_buffer(cb);
+  } else if (cb->format == WH_FORMAT_KAIROSDB) {
     if (cb->send_buffer_fill <= 2) {
       cb->send_buffer_init_time = cdtime();
       return 0;
@@ -309,9 +831,12 @@ static void wh_callback_free(void *data) /* {{{ */
 
   cb = data;
 
-  if (cb->send_buffer != NULL)
+  if ((cb->send_buffer != NULL) || (cb->json_buffer.values_num > 0))
     wh_flush_nolock(/* timeout = */ 0, cb);
 
+  if (cb->async)
+    wh_async_stop(cb);
+
   if (cb->curl != NULL) {
     curl_easy_cleanup(cb->curl);
     cb->curl = NULL;
@@ -322,6 +847,7 @@ static void wh_callback_free(void *data) /* {{{ */
     cb->headers = NULL;
   }
 
+  curl_stats_destroy(cb->stats);
   sfree(cb->name);
   sfree(cb->location);
   sfree(cb->user);
@@ -333,8 +859,14 @@ static void wh_callback_free(void *data) /* {{{ */
   sfree(cb->clientcert);
   sfree(cb->clientkeypass);
   sfree(cb->send_buffer);
+  format_memo_release(cb->json_buffer.memo);
+  format_json_buffer_free(&cb->json_buffer);
   sfree(cb->metrics_prefix);
 
+  pthread_mutex_destroy(&cb->send_lock);
+  pthread_mutex_destroy(&cb->queue_lock);
+  pthread_cond_destroy(&cb->queue_cond);
+
   sfree(cb);
 } /* }}} void wh_callback_free */
 
@@ -421,9 +953,38 @@ static int wh_write_command(const data_set_t *ds,
   return 0;
 } /* }}} int wh_write_command */
 
-static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
-                         wh_callback_t *cb) {
-  int status;
+/* must hold cb->send_lock when calling */
+static int wh_write_json_nolock(const data_set_t *ds, /* {{{ */
+                                const value_list_t *vl, wh_callback_t *cb) {
+  int status =
+      format_json_buffer_add(&cb->json_buffer, ds, vl, cb->store_rates);
+  if (status != 0) {
+    ERROR("write_http plugin: format_json_buffer_add failed with status %i.",
+          status);
+    return status;
+  }
+
+  DEBUG("write_http plugin: <%s> buffer %" PRIsz "/%" PRIsz " (%g%%)",
+        cb->location, cb->json_buffer.len, cb->send_buffer_size,
+        100.0 * ((double)cb->json_buffer.len) /
+            ((double)cb->send_buffer_size));
+
+  return 0;
+} /* }}} int wh_write_json_nolock */
+
+/* wh_write_json_batch adds all value lists to the JSON buffer and sends it
+ * once it has reached "BufferSize", so that a batch is sent in one request. */
+static int wh_write_json_batch(data_set_t const *const *ds, /* {{{ */
+                               value_list_t const *const *vl, size_t num,
+                               user_data_t *user_data) {
+  wh_callback_t *cb;
+  size_t failure = 0;
+
+  if (user_data == NULL)
+    return -EINVAL;
+
+  cb = user_data->data;
+  assert(cb->send_metrics);
 
   pthread_mutex_lock(&cb->send_lock);
   if (wh_callback_init(cb) != 0) {
@@ -432,36 +993,19 @@ static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     return -1;
   }
 
-  status =
-      format_json_value_list(cb->send_buffer, &cb->send_buffer_fill,
-                             &cb->send_buffer_free, ds, vl, cb->store_rates);
-  if (status == -ENOMEM) {
-    status = wh_flush_nolock(/* timeout = */ 0, cb);
-    if (status != 0) {
-      wh_reset_buffer(cb);
-      pthread_mutex_unlock(&cb->send_lock);
-      return status;
-    }
-
-    status =
-        format_json_value_list(cb->send_buffer, &cb->send_buffer_fill,
-                               &cb->send_buffer_free, ds, vl, cb->store_rates);
-  }
-  if (status != 0) {
-    pthread_mutex_unlock(&cb->send_lock);
-    return status;
-  }
-
-  DEBUG("write_http plugin: <%s> buffer %" PRIsz "/%" PRIsz " (%g%%)",
-        cb->location, cb->send_buffer_fill, cb->send_buffer_size,
-        100.0 * ((double)cb->send_buffer_fill) /
-            ((double)cb->send_buffer_size));
+  for (size_t i = 0; i < num; i++)
+    if (wh_write_json_nolock(ds[i], vl[i], cb) != 0)
+      failure++;
 
-  /* Check if we have enough space for this command. */
+  int status = 0;
+  if (cb->json_buffer.len >= cb->send_buffer_size)
+    status = wh_flush_nolock(/* timeout = */ 0, cb);
   pthread_mutex_unlock(&cb->send_lock);
 
-  return 0;
-} /* }}} int wh_write_json */
+  if ((num > 0) && (failure == num))
+    return -1;
+  return status;
+} /* }}} int wh_write_json_batch */
 
 static int wh_write_kairosdb(const data_set_t *ds,
                              const value_list_t *vl, /* {{{ */
@@ -524,9 +1068,6 @@ static int wh_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   assert(cb->send_metrics);
 
   switch (cb->format) {
-  case WH_FORMAT_JSON:
-    status = wh_write_json(ds, vl, cb);
-    break;
   case WH_FORMAT_KAIROSDB:
     status = wh_write_kairosdb(ds, vl, cb);
     break;
@@ -636,6 +1177,9 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   cb->send_notifications = false;
   cb->data_ttl = 0;
   cb->metrics_prefix = strdup(WRITE_HTTP_DEFAULT_PREFIX);
+  cb->json_buffer = (format_json_buffer_t)FORMAT_JSON_BUFFER_INIT;
+  cb->max_connections = WH_ASYNC_DEFAULT_MAX_CONNECTIONS;
+  cb->max_pending_bytes = WH_ASYNC_DEFAULT_MAX_PENDING_BYTES;
 
   if (cb->metrics_prefix == NULL) {
     ERROR("write_http plugin: strdup failed.");
@@ -644,6 +1188,8 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->queue_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->queue_cond, /* attr = */ NULL);
 
   cf_util_get_string(ci, &cb->name);
 
@@ -755,6 +1301,38 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &cb->data_ttl);
     } else if (strcasecmp("Prefix", child->key) == 0) {
       status = cf_util_get_string(child, &cb->metrics_prefix);
+    } else if (strcasecmp("Compress", child->key) == 0) {
+      status = cf_util_get_boolean(child, &cb->compress);
+#if !HAVE_LIBZ
+      if (cb->compress) {
+        WARNING("write_http plugin: \"Compress\" is not supported because "
+                "collectd has been built without zlib.");
+        cb->compress = false;
+      }
+#endif
+    } else if (strcasecmp("Statistics", child->key) == 0) {
+      curl_stats_destroy(cb->stats);
+      cb->stats = curl_stats_from_config(child);
+      if (cb->stats == NULL)
+        status = -1;
+    } else if (strcasecmp("Asynchronous", child->key) == 0) {
+      status = cf_util_get_boolean(child, &cb->async);
+    } else if (strcasecmp("MaxConnections", child->key) == 0) {
+      status = cf_util_get_int(child, &cb->max_connections);
+      if ((status == 0) && (cb->max_connections < 1)) {
+        ERROR("write_http plugin: \"MaxConnections\" must be at least 1.");
+        status = -1;
+      }
+    } else if (strcasecmp("MaxPendingBytes", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1024)) {
+        ERROR("write_http plugin: \"MaxPendingBytes\" must be at least "
+              "1024.");
+        status = -1;
+      }
+      if (status == 0)
+        cb->max_pending_bytes = (size_t)tmp;
     } else {
       ERROR("write_http plugin: Invalid configuration "
             "option: %s.",
@@ -799,13 +1377,20 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
     ERROR("write_http plugin: Ignoring invalid BufferSize setting (%d).",
           buffer_size);
 
-  /* Allocate the buffer. */
-  cb->send_buffer = malloc(cb->send_buffer_size);
-  if (cb->send_buffer == NULL) {
-    ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
-          cb->send_buffer_size);
-    wh_callback_free(cb);
-    return -1;
+  /* Nodes sending the same JSON render each value list once. */
+  if (cb->format == WH_FORMAT_JSON)
+    cb->json_buffer.memo =
+        format_memo_acquire("json", &cb->store_rates, sizeof(cb->store_rates));
+
+  /* Allocate the buffer. The JSON buffer is allocated when needed. */
+  if (cb->format != WH_FORMAT_JSON) {
+    cb->send_buffer = malloc(cb->send_buffer_size);
+    if (cb->send_buffer == NULL) {
+      ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
+            cb->send_buffer_size);
+      wh_callback_free(cb);
+      return -1;
+    }
   }
   /* Nulls the buffer and sets ..._free and ..._fill. */
   wh_reset_buffer(cb);
@@ -819,7 +1404,11 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   };
 
   if (cb->send_metrics) {
-    plugin_register_write(callback_name, wh_write, &user_data);
+    if (cb->format == WH_FORMAT_JSON)
+      plugin_register_write_batch(callback_name, wh_write_json_batch,
+                                  &user_data);
+    else
+      plugin_register_write(callback_name, wh_write, &user_data);
     user_data.free_func = NULL;
 
     plugin_register_flush(callback_name, wh_flush, &user_data);
@@ -31,6 +31,7 @@
 #include "utils/common/common.h"
 #include "utils/format_graphite/format_graphite.h"
 #include "utils/format_json/format_json.h"
+#include "utils_ident.h"
 #include "utils_random.h"
 
 #include <errno.h>
@@ -49,15 +50,40 @@ struct kafka_topic_context {
   rd_kafka_conf_t *kafka_conf;
   rd_kafka_t *kafka;
   char *key;
+  uint32_t key_hash;
   char *prefix;
   char *postfix;
   char escape_char;
   char *topic_name;
+  /* If non-zero, the value lists of a write batch are packed into messages
+   * of about "batch_size" bytes. */
+  size_t batch_size;
+  /* The number of partitions, as last seen by the partitioner. */
+  int32_t partitions_num;
   pthread_mutex_t lock;
 };
 
+/* The partitioner gets the hash of the key or of the identifier as the
+ * message opaque, so that it doesn't have to hash strings itself. Zero means
+ * "no hash" and is never used. */
+#define KAFKA_HASH_MASK 0x7fffffff
+#define KAFKA_HASH_TO_OPAQUE(h) ((void *)(uintptr_t)(((h)&KAFKA_HASH_MASK) + 1))
+#define KAFKA_OPAQUE_TO_HASH(p) ((uint32_t)((uintptr_t)(p)-1))
+
+/* A message that is being assembled from several value lists. The JSON format
+ * uses "json", the other formats use "data". */
+typedef struct {
+  format_json_buffer_t json;
+  char *data;
+  size_t len;
+  size_t size;
+} kafka_message_t;
+
 static int kafka_handle(struct kafka_topic_context *);
 static int kafka_write(const data_set_t *, const value_list_t *, user_data_t *);
+static int kafka_write_batch(data_set_t const *const *,
+                             value_list_t const *const *, size_t,
+                             user_data_t *);
 static int32_t kafka_partition(const rd_kafka_topic_t *, const void *, size_t,
                                int32_t, void *, void *);
 
@@ -101,13 +127,38 @@ static char *kafka_random_key(char buffer[static KAFKA_RANDOM_KEY_SIZE]) {
   return buffer;
 }
 
+/* kafka_series_hash returns the hash that selects the partition for "vl": the
+ * hash of the configured key, if any, or of the identifier otherwise. This way
+ * a series is always written to the same partition. */
+static uint32_t kafka_series_hash(struct kafka_topic_context const *ctx,
+                                  value_list_t const *vl) {
+  if (ctx->key != NULL)
+    return ctx->key_hash;
+  if (vl->ident != NULL)
+    return (uint32_t)vl->ident->hash;
+
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return cdrand_u();
+  return (uint32_t)ident_hash(name);
+}
+
 static int32_t kafka_partition(const rd_kafka_topic_t *rkt, const void *keydata,
                                size_t keylen, int32_t partition_cnt, void *p,
                                void *m) {
-  uint32_t key = kafka_hash(keydata, keylen);
+  struct kafka_topic_context *ctx = p;
+  uint32_t key = (m != NULL) ? KAFKA_OPAQUE_TO_HASH(m)
+                             : kafka_hash(keydata, keylen) & KAFKA_HASH_MASK;
   uint32_t target = key % partition_cnt;
   int32_t i = partition_cnt;
 
+  /* Batches are grouped by partition, see kafka_write_batch(). */
+  if (ctx != NULL) {
+    pthread_mutex_lock(&ctx->lock);
+    ctx->partitions_num = partition_cnt;
+    pthread_mutex_unlock(&ctx->lock);
+  }
+
   while (--i > 0 && !rd_kafka_topic_partition_available(rkt, target)) {
     target = (target + 1) % partition_cnt;
   }
@@ -170,70 +221,241 @@ static int kafka_handle(struct kafka_topic_context *ctx) /* {{{ */
 
 } /* }}} int kafka_handle */
 
-static int kafka_write(const data_set_t *ds, /* {{{ */
-                       const value_list_t *vl, user_data_t *ud) {
-  int status = 0;
-  void *key;
-  size_t keylen = 0;
-  char buffer[8192];
-  size_t bfree = sizeof(buffer);
+/* kafka_format formats a single value list into "buffer". */
+static int kafka_format(struct kafka_topic_context *ctx, /* {{{ */
+                        const data_set_t *ds, const value_list_t *vl,
+                        char *buffer, size_t buffer_size) {
+  size_t bfree = buffer_size;
   size_t bfill = 0;
-  size_t blen = 0;
-  struct kafka_topic_context *ctx = ud->data;
-
-  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
-    return EINVAL;
-
-  pthread_mutex_lock(&ctx->lock);
-  status = kafka_handle(ctx);
-  pthread_mutex_unlock(&ctx->lock);
-  if (status != 0)
-    return status;
+  int status;
 
-  bzero(buffer, sizeof(buffer));
+  memset(buffer, 0, buffer_size);
 
   switch (ctx->format) {
   case KAFKA_FORMAT_COMMAND:
-    status = cmd_create_putval(buffer, sizeof(buffer), ds, vl);
+    status = cmd_create_putval(buffer, buffer_size, ds, vl);
     if (status != 0) {
       ERROR("write_kafka plugin: cmd_create_putval failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
     break;
   case KAFKA_FORMAT_JSON:
     format_json_initialize(buffer, &bfill, &bfree);
     format_json_value_list(buffer, &bfill, &bfree, ds, vl, ctx->store_rates);
     format_json_finalize(buffer, &bfill, &bfree);
-    blen = strlen(buffer);
     break;
   case KAFKA_FORMAT_GRAPHITE:
     status =
-        format_graphite(buffer, sizeof(buffer), ds, vl, ctx->prefix,
-                        ctx->postfix, ctx->escape_char, ctx->graphite_flags);
+        format_graphite(buffer, buffer_size, ds, vl, ctx->prefix, ctx->postfix,
+                        ctx->escape_char, ctx->graphite_flags);
     if (status != 0) {
       ERROR("write_kafka plugin: format_graphite failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
     break;
   default:
     ERROR("write_kafka plugin: invalid format %i.", ctx->format);
     return -1;
   }
 
-  key =
+  return 0;
+} /* }}} int kafka_format */
+
+/* kafka_produce hands a message to librdkafka, which copies it. "hash"
+ * selects the partition, see kafka_partition(). */
+static int kafka_produce(struct kafka_topic_context *ctx, /* {{{ */
+                         void *payload, size_t len, uint32_t hash) {
+  char *key =
       (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
-  keylen = strlen(key);
 
-  rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
-                   buffer, blen, key, keylen, NULL);
+  if (rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
+                       payload, len, key, strlen(key),
+                       KAFKA_HASH_TO_OPAQUE(hash)) != 0) {
+    ERROR("write_kafka plugin: rd_kafka_produce failed: %s",
+          rd_kafka_err2str(kafka_error()));
+    return -1;
+  }
 
-  return status;
+  return 0;
+} /* }}} int kafka_produce */
+
+static int kafka_write(const data_set_t *ds, /* {{{ */
+                       const value_list_t *vl, user_data_t *ud) {
+  int status = 0;
+  char buffer[8192];
+  struct kafka_topic_context *ctx = ud->data;
+
+  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_handle(ctx);
+  pthread_mutex_unlock(&ctx->lock);
+  if (status != 0)
+    return status;
+
+  status = kafka_format(ctx, ds, vl, buffer, sizeof(buffer));
+  if (status != 0)
+    return status;
+
+  return kafka_produce(ctx, buffer, strlen(buffer),
+                       kafka_series_hash(ctx, vl));
 } /* }}} int kafka_write */
 
+/* kafka_message_add appends a value list to "msg". */
+static int kafka_message_add(struct kafka_topic_context *ctx, /* {{{ */
+                             kafka_message_t *msg, const data_set_t *ds,
+                             const value_list_t *vl) {
+  char line[8192];
+  int status;
+
+  if (ctx->format == KAFKA_FORMAT_JSON) {
+    status = format_json_buffer_add(&msg->json, ds, vl, ctx->store_rates);
+    if (status != 0)
+      ERROR("write_kafka plugin: format_json_buffer_add failed with status %i.",
+            status);
+    return status;
+  }
+
+  status = kafka_format(ctx, ds, vl, line, sizeof(line));
+  if (status != 0)
+    return status;
+
+  /* PUTVAL commands are separated by newlines. Graphite lines already end in
+   * one. */
+  size_t len = strlen(line);
+  size_t need = msg->len + len + 1;
+  if (need > msg->size) {
+    size_t size = (msg->size == 0) ? sizeof(line) : msg->size;
+    while (size < need)
+      size *= 2;
+
+    char *tmp = realloc(msg->data, size);
+    if (tmp == NULL) {
+      ERROR("write_kafka plugin: realloc failed.");
+      return ENOMEM;
+    }
+    msg->data = tmp;
+    msg->size = size;
+  }
+
+  memcpy(msg->data + msg->len, line, len);
+  msg->len += len;
+  if (ctx->format == KAFKA_FORMAT_COMMAND)
+    msg->data[msg->len++] = '\n';
+
+  return 0;
+} /* }}} int kafka_message_add */
+
+static size_t kafka_message_len(struct kafka_topic_context const *ctx,
+                                kafka_message_t const *msg) {
+  return (ctx->format == KAFKA_FORMAT_JSON) ? msg->json.len : msg->len;
+}
+
+/* kafka_message_send produces "msg", if it is not empty, and empties it. */
+static int kafka_message_send(struct kafka_topic_context *ctx, /* {{{ */
+                              kafka_message_t *msg, uint32_t hash) {
+  int status = 0;
+
+  if (ctx->format == KAFKA_FORMAT_JSON) {
+    if (msg->json.values_num == 0)
+      return 0;
+
+    status = format_json_buffer_finalize(&msg->json);
+    if (status == 0)
+      status = kafka_produce(ctx, msg->json.data, msg->json.len, hash);
+    format_json_buffer_reset(&msg->json);
+    return status;
+  }
+
+  if (msg->len == 0)
+    return 0;
+
+  status = kafka_produce(ctx, msg->data, msg->len, hash);
+  msg->len = 0;
+  return status;
+} /* }}} int kafka_message_send */
+
+typedef struct {
+  uint32_t group;
+  size_t index;
+} kafka_batch_entry_t;
+
+static int kafka_batch_entry_compare(void const *a, void const *b) {
+  kafka_batch_entry_t const *ea = a;
+  kafka_batch_entry_t const *eb = b;
+
+  if (ea->group != eb->group)
+    return (ea->group < eb->group) ? -1 : 1;
+  if (ea->index != eb->index)
+    return (ea->index < eb->index) ? -1 : 1;
+  return 0;
+}
+
+/* kafka_write_batch packs the value lists of a write batch into messages of
+ * about "BatchSize" bytes. Value lists are grouped by the partition they would
+ * be written to individually, so that a series always ends up in the same
+ * partition once the number of partitions is known. */
+static int kafka_write_batch(data_set_t const *const *ds, /* {{{ */
+                             value_list_t const *const *vl, size_t num,
+                             user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+  int status;
+
+  if (ctx == NULL)
+    return EINVAL;
+  if (num == 0)
+    return 0;
+
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_handle(ctx);
+  uint32_t groups = 1;
+  if ((ctx->key == NULL) && (ctx->partitions_num > 0))
+    groups = (uint32_t)ctx->partitions_num;
+  pthread_mutex_unlock(&ctx->lock);
+  if (status != 0)
+    return status;
+
+  kafka_batch_entry_t *entries = calloc(num, sizeof(*entries));
+  if (entries == NULL) {
+    ERROR("write_kafka plugin: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    uint32_t hash = kafka_series_hash(ctx, vl[i]) & KAFKA_HASH_MASK;
+    entries[i] = (kafka_batch_entry_t){.group = hash % groups, .index = i};
+  }
+  if (groups > 1)
+    qsort(entries, num, sizeof(*entries), kafka_batch_entry_compare);
+
+  kafka_message_t msg = {.json = FORMAT_JSON_BUFFER_INIT};
+  size_t failure = 0;
+  for (size_t i = 0; i < num; i++) {
+    kafka_batch_entry_t const *e = entries + i;
+
+    if (kafka_message_add(ctx, &msg, ds[e->index], vl[e->index]) != 0)
+      failure++;
+
+    bool group_done = ((i + 1) == num) || (entries[i + 1].group != e->group);
+    if (group_done || (kafka_message_len(ctx, &msg) >= ctx->batch_size)) {
+      /* kafka_partition() maps the group the same way it maps the hash. */
+      if (kafka_message_send(ctx, &msg, e->group) != 0)
+        status = -1;
+    }
+  }
+
+  format_json_buffer_free(&msg.json);
+  sfree(msg.data);
+  sfree(entries);
+
+  if (failure == num)
+    return -1;
+  return status;
+} /* }}} int kafka_write_batch */
+
 static void kafka_topic_context_free(void *p) /* {{{ */
 {
   struct kafka_topic_context *ctx = p;
@@ -391,6 +613,44 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
       status = cf_util_get_string(child, &tctx->prefix);
     } else if (strcasecmp("GraphitePostfix", child->key) == 0) {
       status = cf_util_get_string(child, &tctx->postfix);
+    } else if (strcasecmp("BatchSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 0)) {
+        WARNING("write_kafka plugin: \"BatchSize\" must not be negative.");
+        status = -1;
+      }
+      if (status == 0)
+        tctx->batch_size = (size_t)tmp;
+    } else if (strcasecmp("LingerMs", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if (status != 0)
+        goto errout;
+
+      char value[32];
+      snprintf(value, sizeof(value), "%d", tmp);
+      ret = rd_kafka_conf_set(tctx->kafka_conf, "queue.buffering.max.ms",
+                              value, errbuf, sizeof(errbuf));
+      if (ret != RD_KAFKA_CONF_OK) {
+        WARNING("write_kafka plugin: cannot set \"LingerMs\" to %s: %s.",
+                value, errbuf);
+        goto errout;
+      }
+    } else if (strcasecmp("Compression", child->key) == 0) {
+      status = cf_util_get_string(child, &key);
+      if (status != 0)
+        goto errout;
+
+      ret = rd_kafka_conf_set(tctx->kafka_conf, "compression.codec", key,
+                              errbuf, sizeof(errbuf));
+      if (ret != RD_KAFKA_CONF_OK) {
+        WARNING("write_kafka plugin: cannot set \"Compression\" to %s: %s.",
+                key, errbuf);
+        sfree(key);
+        goto errout;
+      }
+      sfree(key);
     } else if (strcasecmp("GraphiteEscapeChar", child->key) == 0) {
       char *tmp_buff = NULL;
       status = cf_util_get_string(child, &tmp_buff);
@@ -407,17 +667,23 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
       break;
   }
 
+  if (tctx->key != NULL)
+    tctx->key_hash = kafka_hash(tctx->key, strlen(tctx->key));
+
   rd_kafka_topic_conf_set_partitioner_cb(tctx->conf, kafka_partition);
   rd_kafka_topic_conf_set_opaque(tctx->conf, tctx);
 
   snprintf(callback_name, sizeof(callback_name), "write_kafka/%s",
            tctx->topic_name);
 
-  status = plugin_register_write(
-      callback_name, kafka_write,
-      &(user_data_t){
-          .data = tctx, .free_func = kafka_topic_context_free,
-      });
+  user_data_t user_data = {
+      .data = tctx, .free_func = kafka_topic_context_free,
+  };
+  if (tctx->batch_size > 0)
+    status = plugin_register_write_batch(callback_name, kafka_write_batch,
+                                         &user_data);
+  else
+    status = plugin_register_write(callback_name, kafka_write, &user_data);
   if (status != 0) {
     WARNING("write_kafka plugin: plugin_register_write (\"%s\") "
             "failed with status %i.",
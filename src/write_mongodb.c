@@ -38,6 +38,20 @@
 
 #include <mongoc.h>
 
+#define WM_DEFAULT_BATCH_SIZE 1
+#define WM_DEFAULT_MAX_IN_FLIGHT 4
+
+/* Documents destined for one collection, i.e. one plugin. "docs" is a BSON
+ * array of the documents, so that a full batch is handed to the sending
+ * thread by swapping a single pointer. */
+struct wm_batch_s {
+  char collection[DATA_MAX_NAME_LEN];
+  bson_t *docs;
+  uint32_t count;
+  cdtime_t init_time;
+};
+typedef struct wm_batch_s wm_batch_t;
+
 struct wm_node_s {
   char name[DATA_MAX_NAME_LEN];
 
@@ -51,10 +65,18 @@ struct wm_node_s {
   char *passwd;
 
   bool store_rates;
-  bool connected;
-
-  mongoc_client_t *client;
-  mongoc_database_t *database;
+  int batch_size;
+  int max_in_flight;
+
+  mongoc_client_pool_t *pool;
+
+  wm_batch_t **batches;
+  size_t batches_num;
+  /* sent batch buffers, kept for reuse */
+  bson_t **spare;
+  size_t spare_num;
+  /* scratch document for formatting a value list */
+  bson_t *doc;
   pthread_mutex_t lock;
 };
 typedef struct wm_node_s wm_node_t;
@@ -62,24 +84,18 @@ typedef struct wm_node_s wm_node_t;
 /*
  * Functions
  */
-static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
-                              const value_list_t *vl, bool store_rates) {
-  bson_t *ret;
+static int wm_format_bson(bson_t *ret, const data_set_t *ds, /* {{{ */
+                          const value_list_t *vl, bool store_rates) {
   bson_t subarray;
   gauge_t *rates;
 
-  ret = bson_new();
-  if (!ret) {
-    ERROR("write_mongodb plugin: bson_new failed.");
-    return NULL;
-  }
+  bson_reinit(ret);
 
   if (store_rates) {
     rates = uc_get_rate(ds, vl);
     if (rates == NULL) {
       ERROR("write_mongodb plugin: uc_get_rate() failed.");
-      bson_destroy(ret);
-      return NULL;
+      return -1;
     }
   } else {
     rates = NULL;
@@ -111,8 +127,8 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
     else {
       ERROR("write_mongodb plugin: Unknown ds_type %d for index %" PRIsz,
             ds->ds[i].type, i);
-      bson_destroy(ret);
-      return NULL;
+      sfree(rates);
+      return -1;
     }
   }
   bson_append_array_end(ret, &subarray); /* }}} values */
@@ -146,140 +162,272 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
     ERROR("write_mongodb plugin: Error in generated BSON document "
           "at byte %" PRIsz,
           error_location);
-    bson_destroy(ret);
-    return NULL;
+    return -1;
   }
 
-  return ret;
-} /* }}} bson *wm_create_bson */
+  return 0;
+} /* }}} int wm_format_bson */
 
 static int wm_initialize(wm_node_t *node) /* {{{ */
 {
   char *uri;
 
-  if (node->connected)
+  if (node->pool != NULL)
     return 0;
 
   INFO("write_mongodb plugin: Connecting to [%s]:%d", node->host, node->port);
 
-  if ((node->db != NULL) && (node->user != NULL) && (node->passwd != NULL)) {
+  if ((node->db != NULL) && (node->user != NULL) && (node->passwd != NULL))
     uri = ssnprintf_alloc("mongodb://%s:%s@%s:%d/?authSource=%s", node->user,
                           node->passwd, node->host, node->port, node->db);
-    if (uri == NULL) {
-      ERROR("write_mongodb plugin: Not enough memory to assemble "
-            "authentication string.");
-      mongoc_client_destroy(node->client);
-      node->client = NULL;
-      node->connected = false;
-      return -1;
-    }
-
-    node->client = mongoc_client_new(uri);
-    if (!node->client) {
-      ERROR("write_mongodb plugin: Authenticating to [%s]:%d for database "
-            "\"%s\" as user \"%s\" failed.",
-            node->host, node->port, node->db, node->user);
-      node->connected = false;
-      sfree(uri);
-      return -1;
-    }
-  } else {
+  else
     uri = ssnprintf_alloc("mongodb://%s:%d", node->host, node->port);
-    if (uri == NULL) {
-      ERROR("write_mongodb plugin: Not enough memory to assemble "
-            "authentication string.");
-      mongoc_client_destroy(node->client);
-      node->client = NULL;
-      node->connected = false;
-      return -1;
-    }
+  if (uri == NULL) {
+    ERROR("write_mongodb plugin: Not enough memory to assemble "
+          "authentication string.");
+    return -1;
+  }
 
-    node->client = mongoc_client_new(uri);
-    if (!node->client) {
-      ERROR("write_mongodb plugin: Connecting to [%s]:%d failed.", node->host,
-            node->port);
-      node->connected = false;
-      sfree(uri);
-      return -1;
-    }
-    sfree(uri);
+  mongoc_uri_t *mongoc_uri = mongoc_uri_new(uri);
+  sfree(uri);
+  if (mongoc_uri == NULL) {
+    ERROR("write_mongodb plugin: Parsing the URI of [%s]:%d failed.",
+          node->host, node->port);
+    return -1;
   }
 
-  node->database = mongoc_client_get_database(node->client, "collectd");
-  if (!node->database) {
-    ERROR("write_mongodb plugin: error creating/getting database");
-    mongoc_client_destroy(node->client);
-    node->client = NULL;
-    node->connected = false;
+  /* The pool is thread-safe, so that batches can be sent without holding
+   * node->lock. Each bulk operation in flight uses one client of the pool. */
+  node->pool = mongoc_client_pool_new(mongoc_uri);
+  mongoc_uri_destroy(mongoc_uri);
+  if (node->pool == NULL) {
+    ERROR("write_mongodb plugin: Connecting to [%s]:%d failed.", node->host,
+          node->port);
     return -1;
   }
+  mongoc_client_pool_max_size(node->pool, (uint32_t)node->max_in_flight);
 
-  node->connected = true;
   return 0;
 } /* }}} int wm_initialize */
 
+/* wm_batch_get returns the batch of a collection, creating it if necessary.
+ * Must hold node->lock when calling. */
+static wm_batch_t *wm_batch_get(wm_node_t *node, /* {{{ */
+                                char const *collection) {
+  for (size_t i = 0; i < node->batches_num; i++)
+    if (strcmp(node->batches[i]->collection, collection) == 0)
+      return node->batches[i];
+
+  wm_batch_t **tmp =
+      realloc(node->batches, (node->batches_num + 1) * sizeof(*node->batches));
+  if (tmp == NULL)
+    return NULL;
+  node->batches = tmp;
+
+  wm_batch_t *batch = calloc(1, sizeof(*batch));
+  if (batch == NULL)
+    return NULL;
+  sstrncpy(batch->collection, collection, sizeof(batch->collection));
+
+  node->batches[node->batches_num] = batch;
+  node->batches_num++;
+  return batch;
+} /* }}} wm_batch_t *wm_batch_get */
+
+/* wm_batch_add appends node->doc to a batch. Must hold node->lock when
+ * calling. */
+static int wm_batch_add(wm_node_t *node, wm_batch_t *batch) /* {{{ */
+{
+  if (batch->docs == NULL) {
+    if (node->spare_num > 0) {
+      node->spare_num--;
+      batch->docs = node->spare[node->spare_num];
+    } else {
+      batch->docs = bson_new();
+      if (batch->docs == NULL) {
+        ERROR("write_mongodb plugin: bson_new failed.");
+        return ENOMEM;
+      }
+    }
+    batch->init_time = cdtime();
+  }
+
+  char key[16];
+  snprintf(key, sizeof(key), "%" PRIu32, batch->count);
+  if (!BSON_APPEND_DOCUMENT(batch->docs, key, node->doc)) {
+    ERROR("write_mongodb plugin: Adding a document to the batch for "
+          "collection \"%s\" failed.",
+          batch->collection);
+    return -1;
+  }
+
+  batch->count++;
+  return 0;
+} /* }}} int wm_batch_add */
+
+/* wm_batch_take moves the documents of "batch" to "ret", so that they can be
+ * sent after releasing node->lock. Must hold node->lock when calling. */
+static void wm_batch_take(wm_batch_t *batch, wm_batch_t *ret) /* {{{ */
+{
+  *ret = *batch;
+  batch->docs = NULL;
+  batch->count = 0;
+} /* }}} void wm_batch_take */
+
+/* wm_batch_release keeps the buffer of a batch that has been sent for reuse. */
+static void wm_batch_release(wm_node_t *node, wm_batch_t *batch) /* {{{ */
+{
+  pthread_mutex_lock(&node->lock);
+  bson_t **tmp =
+      realloc(node->spare, (node->spare_num + 1) * sizeof(*node->spare));
+  if (tmp != NULL) {
+    node->spare = tmp;
+    bson_reinit(batch->docs);
+    node->spare[node->spare_num] = batch->docs;
+    node->spare_num++;
+  } else {
+    bson_destroy(batch->docs);
+  }
+  pthread_mutex_unlock(&node->lock);
+
+  batch->docs = NULL;
+} /* }}} void wm_batch_release */
+
+/* wm_batch_send inserts the documents of a batch taken with wm_batch_take
+ * using an unordered bulk operation: a document that cannot be inserted does
+ * not prevent the others from being inserted. Blocks while "MaxInFlight" bulk
+ * operations are in flight. */
+static int wm_batch_send(wm_node_t *node, wm_batch_t *batch) /* {{{ */
+{
+  mongoc_client_t *client = mongoc_client_pool_pop(node->pool);
+  if (client == NULL) {
+    ERROR("write_mongodb plugin: mongoc_client_pool_pop failed.");
+    wm_batch_release(node, batch);
+    return -1;
+  }
+
+  mongoc_collection_t *collection =
+      mongoc_client_get_collection(client, "collectd", batch->collection);
+  mongoc_bulk_operation_t *bulk;
+#if MONGOC_CHECK_VERSION(1, 9, 0)
+  bson_t opts = BSON_INITIALIZER;
+  BSON_APPEND_BOOL(&opts, "ordered", false);
+  bulk = mongoc_collection_create_bulk_operation_with_opts(collection, &opts);
+  bson_destroy(&opts);
+#else
+  bulk = mongoc_collection_create_bulk_operation(collection,
+                                                 /* ordered = */ false,
+                                                 /* write_concern = */ NULL);
+#endif
+
+  bson_iter_t iter;
+  if (bson_iter_init(&iter, batch->docs)) {
+    while (bson_iter_next(&iter)) {
+      uint32_t len = 0;
+      uint8_t const *data = NULL;
+      bson_t doc;
+
+      bson_iter_document(&iter, &len, &data);
+      if ((data != NULL) && bson_init_static(&doc, data, len))
+        mongoc_bulk_operation_insert(bulk, &doc);
+    }
+  }
+
+  bson_t reply;
+  bson_error_t error;
+  int status = 0;
+  if (!mongoc_bulk_operation_execute(bulk, &reply, &error)) {
+    int32_t inserted = 0;
+    if (bson_iter_init_find(&iter, &reply, "nInserted") &&
+        BSON_ITER_HOLDS_INT32(&iter))
+      inserted = bson_iter_int32(&iter);
+    ERROR("write_mongodb plugin: error inserting records into collection "
+          "\"%s\": %s. %" PRIi32 " of %" PRIu32 " records have been inserted.",
+          batch->collection, error.message, inserted, batch->count);
+    status = -1;
+  }
+
+  bson_destroy(&reply);
+  mongoc_bulk_operation_destroy(bulk);
+  mongoc_collection_destroy(collection);
+  mongoc_client_pool_push(node->pool, client);
+
+  wm_batch_release(node, batch);
+  return status;
+} /* }}} int wm_batch_send */
+
 static int wm_write(const data_set_t *ds, /* {{{ */
                     const value_list_t *vl, user_data_t *ud) {
   wm_node_t *node = ud->data;
-  mongoc_collection_t *collection = NULL;
-  bson_t *bson_record;
-  bson_error_t error;
+  wm_batch_t full = {.docs = NULL};
   int status;
 
-  bson_record = wm_create_bson(ds, vl, node->store_rates);
-  if (!bson_record) {
-    ERROR("write_mongodb plugin: error making insert bson");
-    return -1;
-  }
-
   pthread_mutex_lock(&node->lock);
   if (wm_initialize(node) < 0) {
     ERROR("write_mongodb plugin: error making connection to server");
     pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
     return -1;
   }
 
-  collection =
-      mongoc_client_get_collection(node->client, "collectd", vl->plugin);
-  if (!collection) {
-    ERROR("write_mongodb plugin: error creating/getting collection");
-    mongoc_database_destroy(node->database);
-    mongoc_client_destroy(node->client);
-    node->database = NULL;
-    node->client = NULL;
-    node->connected = false;
+  if (wm_format_bson(node->doc, ds, vl, node->store_rates) != 0) {
+    ERROR("write_mongodb plugin: error making insert bson");
     pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
     return -1;
   }
 
-  status = mongoc_collection_insert(collection, MONGOC_INSERT_NONE, bson_record,
-                                    NULL, &error);
-
-  if (!status) {
-    ERROR("write_mongodb plugin: error inserting record: %s", error.message);
-    mongoc_database_destroy(node->database);
-    mongoc_client_destroy(node->client);
-    node->database = NULL;
-    node->client = NULL;
-    node->connected = false;
+  wm_batch_t *batch = wm_batch_get(node, vl->plugin);
+  if (batch == NULL) {
+    ERROR("write_mongodb plugin: Allocating a batch failed.");
     pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
-    mongoc_collection_destroy(collection);
-    return -1;
+    return ENOMEM;
   }
 
-  /* free our resource as not to leak memory */
-  mongoc_collection_destroy(collection);
+  /* A batch is sent when it is full or older than the interval. */
+  status = wm_batch_add(node, batch);
+  if ((status == 0) &&
+      ((batch->count >= (uint32_t)node->batch_size) ||
+       ((cdtime() - batch->init_time) >= plugin_get_interval())))
+    wm_batch_take(batch, &full);
 
   pthread_mutex_unlock(&node->lock);
 
-  bson_destroy(bson_record);
+  if (full.docs != NULL)
+    status = wm_batch_send(node, &full);
 
-  return 0;
+  return status;
 } /* }}} int wm_write */
 
+static int wm_flush(cdtime_t timeout, /* {{{ */
+                    const char *identifier __attribute__((unused)),
+                    user_data_t *ud) {
+  wm_node_t *node = ud->data;
+  cdtime_t now = cdtime();
+  int status = 0;
+
+  /* Take one batch at a time, so that node->lock is not held while sending. */
+  for (size_t i = 0;; i++) {
+    wm_batch_t full = {.docs = NULL};
+
+    pthread_mutex_lock(&node->lock);
+    if (i >= node->batches_num) {
+      pthread_mutex_unlock(&node->lock);
+      break;
+    }
+
+    wm_batch_t *batch = node->batches[i];
+    /* timeout == 0  => flush unconditionally */
+    if ((batch->count > 0) &&
+        ((timeout == 0) || ((batch->init_time + timeout) <= now)))
+      wm_batch_take(batch, &full);
+    pthread_mutex_unlock(&node->lock);
+
+    if ((full.docs != NULL) && (wm_batch_send(node, &full) != 0))
+      status = -1;
+  }
+
+  return status;
+} /* }}} int wm_flush */
+
 static void wm_config_free(void *ptr) /* {{{ */
 {
   wm_node_t *node = ptr;
@@ -287,13 +435,32 @@ static void wm_config_free(void *ptr) /* {{{ */
   if (node == NULL)
     return;
 
-  mongoc_database_destroy(node->database);
-  mongoc_client_destroy(node->client);
-  node->database = NULL;
-  node->client = NULL;
-  node->connected = false;
+  if (node->pool != NULL)
+    wm_flush(/* timeout = */ 0, /* identifier = */ NULL,
+             &(user_data_t){.data = node});
+
+  for (size_t i = 0; i < node->batches_num; i++) {
+    if (node->batches[i]->docs != NULL)
+      bson_destroy(node->batches[i]->docs);
+    sfree(node->batches[i]);
+  }
+  sfree(node->batches);
+  for (size_t i = 0; i < node->spare_num; i++)
+    bson_destroy(node->spare[i]);
+  sfree(node->spare);
+  if (node->doc != NULL)
+    bson_destroy(node->doc);
+
+  if (node->pool != NULL)
+    mongoc_client_pool_destroy(node->pool);
+  node->pool = NULL;
+
+  pthread_mutex_destroy(&node->lock);
 
   sfree(node->host);
+  sfree(node->db);
+  sfree(node->user);
+  sfree(node->passwd);
   sfree(node);
 } /* }}} void wm_config_free */
 
@@ -313,13 +480,14 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
   }
   node->port = MONGOC_DEFAULT_PORT;
   node->store_rates = true;
+  node->batch_size = WM_DEFAULT_BATCH_SIZE;
+  node->max_in_flight = WM_DEFAULT_MAX_IN_FLIGHT;
   pthread_mutex_init(&node->lock, /* attr = */ NULL);
 
   status = cf_util_get_string_buffer(ci, node->name, sizeof(node->name));
 
   if (status != 0) {
-    sfree(node->host);
-    sfree(node);
+    wm_config_free(node);
     return status;
   }
 
@@ -344,7 +512,19 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_string(child, &node->user);
     else if (strcasecmp("Password", child->key) == 0)
       status = cf_util_get_string(child, &node->passwd);
-    else
+    else if (strcasecmp("BatchSize", child->key) == 0) {
+      status = cf_util_get_int(child, &node->batch_size);
+      if ((status == 0) && (node->batch_size < 1)) {
+        ERROR("write_mongodb plugin: \"BatchSize\" must be at least 1.");
+        status = EINVAL;
+      }
+    } else if (strcasecmp("MaxInFlight", child->key) == 0) {
+      status = cf_util_get_int(child, &node->max_in_flight);
+      if ((status == 0) && (node->max_in_flight < 1)) {
+        ERROR("write_mongodb plugin: \"MaxInFlight\" must be at least 1.");
+        status = EINVAL;
+      }
+    } else
       WARNING("write_mongodb plugin: Ignoring unknown config option \"%s\".",
               child->key);
 
@@ -365,6 +545,14 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
     }
   }
 
+  if (status == 0) {
+    node->doc = bson_new();
+    if (node->doc == NULL) {
+      ERROR("write_mongodb plugin: bson_new failed.");
+      status = ENOMEM;
+    }
+  }
+
   if (status == 0) {
     char cb_name[sizeof("write_mongodb/") + DATA_MAX_NAME_LEN];
 
@@ -375,6 +563,8 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
                               &(user_data_t){
                                   .data = node, .free_func = wm_config_free,
                               });
+    if (status == 0)
+      plugin_register_flush(cb_name, wm_flush, &(user_data_t){.data = node});
     INFO("write_mongodb plugin: registered write plugin %s %d", cb_name,
          status);
   }
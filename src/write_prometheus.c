@@ -27,7 +27,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils_complain.h"
 #include "utils_time.h"
@@ -36,6 +36,10 @@
 
 #include <microhttpd.h>
 
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -51,9 +55,82 @@
   "encoding=delimited"
 #define CONTENT_TYPE_TEXT "text/plain; version=0.0.4"
 
-static c_avl_tree_t *metrics;
+#ifndef MHD_SIZE_UNKNOWN
+#define MHD_SIZE_UNKNOWN ((uint64_t)-1LL)
+#endif
+#ifndef MHD_CONTENT_READER_END_OF_STREAM
+#define MHD_CONTENT_READER_END_OF_STREAM ((ssize_t)-1)
+#endif
+#ifndef MHD_CONTENT_READER_END_WITH_ERROR
+#define MHD_CONTENT_READER_END_WITH_ERROR ((ssize_t)-2)
+#endif
+#ifndef MHD_HTTP_HEADER_ACCEPT_ENCODING
+#define MHD_HTTP_HEADER_ACCEPT_ENCODING "Accept-Encoding"
+#endif
+#ifndef MHD_HTTP_HEADER_CONTENT_ENCODING
+#define MHD_HTTP_HEADER_CONTENT_ENCODING "Content-Encoding"
+#endif
+#ifndef MHD_HTTP_HEADER_VARY
+#define MHD_HTTP_HEADER_VARY "Vary"
+#endif
+
+/* Size of the blocks handed to libmicrohttpd when streaming a response. */
+#define RESPONSE_BLOCK_SIZE 32768
+
+/* A metric and its labels, escaped and formatted once when the metric is
+ * created. Metrics removed by prom_missing() are only marked "stale" and freed
+ * when the family is rendered next. */
+typedef struct {
+  Io__Prometheus__Client__Metric *m;
+  uint64_t hash;
+  char *labels;
+  bool stale;
+} prom_metric_t;
+
+/* A metric family and its rendered exposition. The "metrics" tree maps family
+ * names to prom_family_t. "metrics_lock" only protects the tree itself; the
+ * family, its cache and the reference count are protected by the family's own
+ * lock. Writers look up a family under "metrics_lock", lock the family and
+ * release "metrics_lock" before updating it. Scrapes take a reference to each
+ * family under "metrics_lock" and render the families afterwards, so that only
+ * writers of the family being rendered have to wait. The lock order is
+ * "metrics_lock" before the family's lock. */
+typedef struct {
+  Io__Prometheus__Client__MetricFamily *fam;
+  pthread_mutex_t lock;
+
+  /* "metrics[i]->m" is "fam->metric[i]". "index" is an open addressing hash
+   * table of the same metrics, with "index_size" being a power of two. */
+  prom_metric_t **metrics;
+  size_t metrics_num;
+  size_t metrics_size;
+  size_t stale_num;
+  prom_metric_t **index;
+  size_t index_size;
+
+  /* Incremented with every change of "fam". */
+  uint64_t generation;
+
+  /* Rendered text and protobuf exposition of "fam", and the generation they
+   * have been rendered from. Unchanged families are not rendered again. */
+  char *text;
+  size_t text_len;
+  uint64_t text_generation;
+  uint8_t *proto;
+  size_t proto_len;
+  uint64_t proto_generation;
+
+  /* Number of scrapes holding a reference. A family removed from "metrics"
+   * while referenced is destroyed by the last scrape releasing it. */
+  size_t refs;
+  bool deleted;
+} prom_family_t;
+
+static c_btree_t *metrics;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
+static void prom_family_destroy(prom_family_t *pf);
+
 static char *httpd_host = NULL;
 static unsigned short httpd_port = 9103;
 static struct MHD_Daemon *httpd;
@@ -77,62 +154,53 @@ static size_t varint(uint8_t buffer[static VARINT_UINT32_BYTES],
   return 0;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in ProtoBuf format. It prefixes each protobuf with its encoded
- * size, the so called "delimited" format. */
-static void format_protobuf(ProtobufCBuffer *buffer) {
-  pthread_mutex_lock(&metrics_lock);
-
-  char *unused_name;
-  Io__Prometheus__Client__MetricFamily *fam;
-  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
-    /* Prometheus uses a message length prefix to determine where one
-     * MetricFamily ends and the next begins. This delimiter is encoded as a
-     * "varint", which is common in Protobufs. */
-    uint8_t delim[VARINT_UINT32_BYTES] = {0};
-    size_t delim_len = varint(
-        delim,
-        (uint32_t)io__prometheus__client__metric_family__get_packed_size(fam));
-    buffer->append(buffer, delim_len, delim);
-
-    io__prometheus__client__metric_family__pack_to_buffer(fam, buffer);
-  }
-  c_avl_iterator_destroy(iter);
-
-  pthread_mutex_unlock(&metrics_lock);
+/* format_family_protobuf adds a metric family to a buffer in ProtoBuf format.
+ * It prefixes the protobuf with its encoded size, the so called "delimited"
+ * format. */
+static void
+format_family_protobuf(ProtobufCBuffer *buffer,
+                       Io__Prometheus__Client__MetricFamily const *fam) {
+  /* Prometheus uses a message length prefix to determine where one
+   * MetricFamily ends and the next begins. This delimiter is encoded as a
+   * "varint", which is common in Protobufs. */
+  uint8_t delim[VARINT_UINT32_BYTES] = {0};
+  size_t delim_len = varint(
+      delim,
+      (uint32_t)io__prometheus__client__metric_family__get_packed_size(fam));
+  buffer->append(buffer, delim_len, delim);
+
+  io__prometheus__client__metric_family__pack_to_buffer(fam, buffer);
 }
 
 static char const *escape_label_value(char *buffer, size_t buffer_size,
                                       char const *value) {
+  size_t value_len = strlen(value);
+  size_t plain = strspan_plain(value, value_len, "\n\"\\", false);
+
   /* shortcut for values that don't need escaping. */
-  if (strpbrk(value, "\n\"\\") == NULL)
+  if (plain == value_len)
     return value;
 
-  size_t value_len = strlen(value);
   size_t buffer_len = 0;
+  size_t i = 0;
+  while (i < value_len) {
+    /* Copy as much of the plain part as fits. */
+    size_t n = buffer_size - buffer_len - 1;
+    if (n > plain)
+      n = plain;
+    memcpy(buffer + buffer_len, value + i, n);
+    buffer_len += n;
+    i += plain;
+    if (i >= value_len)
+      break;
 
-  for (size_t i = 0; i < value_len; i++) {
-    switch (value[i]) {
-    case '\n':
-    case '"':
-    case '\\':
-      if ((buffer_size - buffer_len) < 3) {
-        break;
-      }
+    if ((buffer_size - buffer_len) >= 3) {
       buffer[buffer_len] = '\\';
       buffer[buffer_len + 1] = (value[i] == '\n') ? 'n' : value[i];
       buffer_len += 2;
-      break;
-
-    default:
-      if ((buffer_size - buffer_len) < 2) {
-        break;
-      }
-      buffer[buffer_len] = value[i];
-      buffer_len++;
-      break;
     }
+    i++;
+    plain = strspan_plain(value + i, value_len - i, "\n\"\\", false);
   }
 
   assert(buffer_len < buffer_size);
@@ -172,60 +240,372 @@ static char *format_labels(char *buffer, size_t buffer_size,
   return buffer;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in plain text format. */
-static void format_text(ProtobufCBuffer *buffer) {
-  pthread_mutex_lock(&metrics_lock);
-
-  char *unused_name;
-  Io__Prometheus__Client__MetricFamily *fam;
-  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
-    char line[1024]; /* 4x DATA_MAX_NAME_LEN? */
+/* format_family_text adds a metric family to a buffer in plain text format.
+ * Stale metrics must have been removed by prom_family_compact(). */
+static void format_family_text(ProtobufCBuffer *buffer,
+                               prom_family_t const *pf) {
+  Io__Prometheus__Client__MetricFamily const *fam = pf->fam;
+  char line[1024]; /* 4x DATA_MAX_NAME_LEN? */
+
+  snprintf(line, sizeof(line), "# HELP %s %s\n", fam->name, fam->help);
+  buffer->append(buffer, strlen(line), (uint8_t *)line);
+
+  snprintf(line, sizeof(line), "# TYPE %s %s\n", fam->name,
+           (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
+               ? "gauge"
+               : "counter");
+  buffer->append(buffer, strlen(line), (uint8_t *)line);
+
+  for (size_t i = 0; i < pf->metrics_num; i++) {
+    Io__Prometheus__Client__Metric const *m = pf->metrics[i]->m;
+
+    char timestamp_ms[24] = "";
+    if (m->has_timestamp_ms)
+      snprintf(timestamp_ms, sizeof(timestamp_ms), " %" PRIi64,
+               m->timestamp_ms);
+
+    if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
+      snprintf(line, sizeof(line), "%s{%s} " GAUGE_FORMAT "%s\n", fam->name,
+               pf->metrics[i]->labels, m->gauge->value, timestamp_ms);
+    else /* if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__COUNTER) */
+      snprintf(line, sizeof(line), "%s{%s} %.0f%s\n", fam->name,
+               pf->metrics[i]->labels, m->counter->value, timestamp_ms);
 
-    snprintf(line, sizeof(line), "# HELP %s %s\n", fam->name, fam->help);
     buffer->append(buffer, strlen(line), (uint8_t *)line);
+  }
+}
 
-    snprintf(line, sizeof(line), "# TYPE %s %s\n", fam->name,
-             (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
-                 ? "gauge"
-                 : "counter");
-    buffer->append(buffer, strlen(line), (uint8_t *)line);
+static void prom_family_compact(prom_family_t *pf);
+
+/* prom_family_render renders a family into its cache unless the cache is up
+ * to date. The family's lock must be held. */
+static int prom_family_render(prom_family_t *pf, bool want_proto) {
+  uint64_t *generation = want_proto ? &pf->proto_generation
+                                    : &pf->text_generation;
+  if (*generation == pf->generation)
+    return 0;
+
+  if (pf->stale_num > 0)
+    prom_family_compact(pf);
+
+  uint8_t scratch[4096];
+  ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(scratch);
+  ProtobufCBuffer *buffer = (ProtobufCBuffer *)&simple;
+
+  if (want_proto)
+    format_family_protobuf(buffer, pf->fam);
+  else
+    format_family_text(buffer, pf);
+
+  uint8_t *data = malloc(simple.len);
+  if (data == NULL) {
+    PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
+    return ENOMEM;
+  }
+  memcpy(data, simple.data, simple.len);
+
+  if (want_proto) {
+    sfree(pf->proto);
+    pf->proto = data;
+    pf->proto_len = simple.len;
+  } else {
+    sfree(pf->text);
+    pf->text = (char *)data;
+    pf->text_len = simple.len;
+  }
+  *generation = pf->generation;
 
-    for (size_t i = 0; i < fam->n_metric; i++) {
-      Io__Prometheus__Client__Metric *m = fam->metric[i];
+  PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
+  return 0;
+}
+
+/* A scrape renders a snapshot of the families in "metrics" one family at a
+ * time, so that a response can be sent while it is being rendered. */
+typedef struct {
+  prom_family_t **families;
+  size_t families_num;
+  size_t next;
+  bool want_proto;
+} prom_scrape_t;
+
+/* prom_scrape_init takes a reference to each family in "metrics".
+ * "metrics_lock" is only held while doing so. */
+static int prom_scrape_init(prom_scrape_t *scrape, bool want_proto) {
+  *scrape = (prom_scrape_t){.want_proto = want_proto};
+
+  pthread_mutex_lock(&metrics_lock);
+
+  int families_num = c_btree_size(metrics);
+  if (families_num > 0) {
+    scrape->families = calloc((size_t)families_num, sizeof(*scrape->families));
+    if (scrape->families == NULL) {
+      pthread_mutex_unlock(&metrics_lock);
+      return ENOMEM;
+    }
+  }
+
+  char *unused_name;
+  prom_family_t *pf;
+  c_btree_iterator_t *iter = c_btree_get_iterator(metrics);
+  while ((scrape->families_num < (size_t)families_num) &&
+         (c_btree_iterator_next(iter, (void *)&unused_name, (void *)&pf) ==
+          0)) {
+    pthread_mutex_lock(&pf->lock);
+    pf->refs++;
+    pthread_mutex_unlock(&pf->lock);
+    scrape->families[scrape->families_num] = pf;
+    scrape->families_num++;
+  }
+  c_btree_iterator_destroy(iter);
 
-      char labels[1024];
+  pthread_mutex_unlock(&metrics_lock);
+  return 0;
+}
 
-      char timestamp_ms[24] = "";
-      if (m->has_timestamp_ms)
-        snprintf(timestamp_ms, sizeof(timestamp_ms), " %" PRIi64,
-                 m->timestamp_ms);
+/* prom_family_release drops a reference taken by prom_scrape_init. The
+ * family's lock must be held and is released. */
+static void prom_family_release(prom_family_t *pf) {
+  pf->refs--;
+  bool destroy = pf->deleted && (pf->refs == 0);
+  pthread_mutex_unlock(&pf->lock);
 
-      if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
-        snprintf(line, sizeof(line), "%s{%s} " GAUGE_FORMAT "%s\n", fam->name,
-                 format_labels(labels, sizeof(labels), m), m->gauge->value,
-                 timestamp_ms);
-      else /* if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__COUNTER) */
-        snprintf(line, sizeof(line), "%s{%s} %.0f%s\n", fam->name,
-                 format_labels(labels, sizeof(labels), m), m->counter->value,
-                 timestamp_ms);
+  if (destroy)
+    prom_family_destroy(pf);
+}
 
-      buffer->append(buffer, strlen(line), (uint8_t *)line);
+/* prom_scrape_next adds the next family of the scrape to a buffer. Families
+ * deleted since the scrape has started are skipped. Returns false once all
+ * families have been added. */
+static bool prom_scrape_next(prom_scrape_t *scrape, ProtobufCBuffer *buffer) {
+  while (scrape->next < scrape->families_num) {
+    prom_family_t *pf = scrape->families[scrape->next];
+    scrape->next++;
+
+    pthread_mutex_lock(&pf->lock);
+    bool ok = !pf->deleted && (prom_family_render(pf, scrape->want_proto) == 0);
+    if (ok) {
+      if (scrape->want_proto)
+        buffer->append(buffer, pf->proto_len, pf->proto);
+      else
+        buffer->append(buffer, pf->text_len, (uint8_t *)pf->text);
     }
+    prom_family_release(pf);
+
+    if (ok)
+      return true;
   }
-  c_avl_iterator_destroy(iter);
+
+  return false;
+}
+
+/* prom_scrape_finish adds the trailer to a buffer, if any. */
+static void prom_scrape_finish(prom_scrape_t const *scrape,
+                               ProtobufCBuffer *buffer) {
+  if (scrape->want_proto)
+    return;
 
   char server[1024];
   snprintf(server, sizeof(server), "\n# collectd/write_prometheus %s at %s\n",
            PACKAGE_VERSION, hostname_g);
   buffer->append(buffer, strlen(server), (uint8_t *)server);
+}
 
-  pthread_mutex_unlock(&metrics_lock);
+/* prom_scrape_destroy releases the families that have not been rendered, e.g.
+ * because the client went away. */
+static void prom_scrape_destroy(prom_scrape_t *scrape) {
+  for (; scrape->next < scrape->families_num; scrape->next++) {
+    prom_family_t *pf = scrape->families[scrape->next];
+    pthread_mutex_lock(&pf->lock);
+    prom_family_release(pf);
+  }
+  sfree(scrape->families);
+  scrape->families_num = 0;
+}
+
+/* format_metrics adds all metric families in "metrics" to a buffer, in
+ * ProtoBuf or plain text format. */
+static void format_metrics(ProtobufCBuffer *buffer, bool want_proto) {
+  prom_scrape_t scrape;
+  if (prom_scrape_init(&scrape, want_proto) != 0)
+    return;
+
+  while (prom_scrape_next(&scrape, buffer))
+    ; /* nop */
+
+  prom_scrape_finish(&scrape, buffer);
+  prom_scrape_destroy(&scrape);
+}
+
+#if HAVE_LIBZ
+/* A ProtobufCBuffer that compresses everything appended to it and appends the
+ * compressed data to "out". */
+typedef struct {
+  ProtobufCBuffer base;
+  z_stream z;
+  ProtobufCBuffer *out;
+  int status;
+} prom_gzip_buffer_t;
+
+static void prom_gzip_deflate(prom_gzip_buffer_t *gz, int flush) {
+  uint8_t chunk[16384];
+
+  do {
+    gz->z.next_out = chunk;
+    gz->z.avail_out = sizeof(chunk);
+
+    int status = deflate(&gz->z, flush);
+    if ((status != Z_OK) && (status != Z_STREAM_END) &&
+        (status != Z_BUF_ERROR)) {
+      gz->status = status;
+      return;
+    }
+
+    gz->out->append(gz->out, sizeof(chunk) - gz->z.avail_out, chunk);
+  } while (gz->z.avail_out == 0);
+}
+
+static void prom_gzip_append(ProtobufCBuffer *buffer, size_t len,
+                             uint8_t const *data) {
+  prom_gzip_buffer_t *gz = (prom_gzip_buffer_t *)buffer;
+  if ((gz->status != Z_OK) || (len == 0))
+    return;
+
+  gz->z.next_in = (Bytef *)data;
+  gz->z.avail_in = (uInt)len;
+  prom_gzip_deflate(gz, Z_NO_FLUSH);
+}
+
+static int prom_gzip_init(prom_gzip_buffer_t *gz, ProtobufCBuffer *out) {
+  *gz = (prom_gzip_buffer_t){
+      .base = {.append = prom_gzip_append},
+      .out = out,
+  };
+
+  /* windowBits + 16 selects the gzip format. */
+  gz->status = deflateInit2(&gz->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                            /* windowBits = */ 15 + 16, /* memLevel = */ 8,
+                            Z_DEFAULT_STRATEGY);
+  return gz->status;
+}
+
+static void prom_gzip_finish(prom_gzip_buffer_t *gz) {
+  if (gz->status != Z_OK)
+    return;
+
+  gz->z.next_in = NULL;
+  gz->z.avail_in = 0;
+  prom_gzip_deflate(gz, Z_FINISH);
+}
+
+/* accept_gzip returns true if the "Accept-Encoding" header lists "gzip" with
+ * a non-zero quality. */
+static bool accept_gzip(char const *accept_encoding) {
+  if (accept_encoding == NULL)
+    return false;
+
+  char const *ptr = accept_encoding;
+  while (*ptr != 0) {
+    ptr += strspn(ptr, " \t,");
+    size_t len = strcspn(ptr, " \t,;");
+    bool match = ((len == 4) && (strncasecmp(ptr, "gzip", 4) == 0)) ||
+                 ((len == 6) && (strncasecmp(ptr, "x-gzip", 6) == 0));
+    ptr += len;
+
+    size_t param_len = strcspn(ptr, ",");
+    if (match) {
+      char const *q = memchr(ptr, ';', param_len);
+      if (q == NULL)
+        return true;
+      q += 1 + strspn(q + 1, " \t");
+      if ((strncasecmp(q, "q=", 2) != 0) || (strtod(q + 2, NULL) > 0.0))
+        return true;
+    }
+    ptr += param_len;
+  }
+
+  return false;
+}
+#endif /* HAVE_LIBZ */
+
+/* A response that is being streamed to a client. "pending" holds the part of
+ * the (possibly compressed) exposition that has not been sent yet; at most
+ * one family is rendered at a time. */
+typedef struct {
+  prom_scrape_t scrape;
+  ProtobufCBufferSimple pending;
+  size_t pending_pos;
+  bool done;
+#if HAVE_LIBZ
+  bool gzip;
+  prom_gzip_buffer_t gz;
+#endif
+} prom_response_t;
+
+static void prom_response_destroy(void *arg) {
+  prom_response_t *r = arg;
+  if (r == NULL)
+    return;
+
+#if HAVE_LIBZ
+  if (r->gzip)
+    deflateEnd(&r->gz.z);
+#endif
+  prom_scrape_destroy(&r->scrape);
+  PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&r->pending);
+  sfree(r);
+}
+
+/* prom_response_read is the content reader callback of a streamed response. It
+ * is called by libmicrohttpd whenever the connection can take more data. */
+static ssize_t prom_response_read(void *cls,
+                                  __attribute__((unused)) uint64_t pos,
+                                  char *buf, size_t max) {
+  prom_response_t *r = cls;
+
+  while (r->pending_pos >= r->pending.len) {
+    if (r->done)
+      return MHD_CONTENT_READER_END_OF_STREAM;
+
+    r->pending.len = 0;
+    r->pending_pos = 0;
+
+    ProtobufCBuffer *buffer = (ProtobufCBuffer *)&r->pending;
+#if HAVE_LIBZ
+    if (r->gzip)
+      buffer = (ProtobufCBuffer *)&r->gz;
+#endif
+
+    if (!prom_scrape_next(&r->scrape, buffer)) {
+      prom_scrape_finish(&r->scrape, buffer);
+#if HAVE_LIBZ
+      if (r->gzip)
+        prom_gzip_finish(&r->gz);
+#endif
+      r->done = true;
+    }
+
+#if HAVE_LIBZ
+    if (r->gzip && (r->gz.status != Z_OK)) {
+      ERROR("write_prometheus plugin: deflate failed with status %d.",
+            r->gz.status);
+      return MHD_CONTENT_READER_END_WITH_ERROR;
+    }
+#endif
+  }
+
+  size_t len = r->pending.len - r->pending_pos;
+  if (len > max)
+    len = max;
+  memcpy(buf, r->pending.data + r->pending_pos, len);
+  r->pending_pos += len;
+
+  return (ssize_t)len;
 }
 
 /* http_handler is the callback called by the microhttpd library. It essentially
- * handles all HTTP request aspects and creates an HTTP response. */
+ * handles all HTTP request aspects and creates an HTTP response. The response
+ * is streamed, and compressed if the client accepts gzip, so that the whole
+ * exposition is never held in memory at once. */
 static int http_handler(void *cls, struct MHD_Connection *connection,
                         const char *url, const char *method,
                         const char *version, const char *upload_data,
@@ -248,29 +628,48 @@ static int http_handler(void *cls, struct MHD_Connection *connection,
   bool want_proto = (accept != NULL) &&
                     (strstr(accept, "application/vnd.google.protobuf") != NULL);
 
-  uint8_t scratch[4096] = {0};
-  ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(scratch);
-  ProtobufCBuffer *buffer = (ProtobufCBuffer *)&simple;
+  prom_response_t *r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    return MHD_NO;
+  r->pending = (ProtobufCBufferSimple)PROTOBUF_C_BUFFER_SIMPLE_INIT(NULL);
 
-  if (want_proto)
-    format_protobuf(buffer);
-  else
-    format_text(buffer);
+  if (prom_scrape_init(&r->scrape, want_proto) != 0) {
+    sfree(r);
+    return MHD_NO;
+  }
 
-#if defined(MHD_VERSION) && MHD_VERSION >= 0x00090500
-  struct MHD_Response *res = MHD_create_response_from_buffer(
-      simple.len, simple.data, MHD_RESPMEM_MUST_COPY);
-#else
-  struct MHD_Response *res = MHD_create_response_from_data(
-      simple.len, simple.data, /* must_free = */ 0, /* must_copy = */ 1);
+#if HAVE_LIBZ
+  char const *accept_encoding = MHD_lookup_connection_value(
+      connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  if (accept_gzip(accept_encoding)) {
+    int status = prom_gzip_init(&r->gz, (ProtobufCBuffer *)&r->pending);
+    if (status == Z_OK)
+      r->gzip = true;
+    else
+      ERROR("write_prometheus plugin: deflateInit2 failed with status %d.",
+            status);
+  }
 #endif
+
+  struct MHD_Response *res = MHD_create_response_from_callback(
+      MHD_SIZE_UNKNOWN, RESPONSE_BLOCK_SIZE, prom_response_read, r,
+      prom_response_destroy);
+  if (res == NULL) {
+    prom_response_destroy(r);
+    return MHD_NO;
+  }
+
   MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_TYPE,
                           want_proto ? CONTENT_TYPE_PROTO : CONTENT_TYPE_TEXT);
+#if HAVE_LIBZ
+  MHD_add_response_header(res, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
+  if (r->gzip)
+    MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+#endif
 
   int status = MHD_queue_response(connection, MHD_HTTP_OK, res);
 
   MHD_destroy_response(res);
-  PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
   return status;
 }
 
@@ -336,7 +735,7 @@ static void metric_destroy(Io__Prometheus__Client__Metric *msg) {
 }
 
 /* metric_cmp compares two metrics. It's prototype makes it easy to use with
- * qsort(3) and bsearch(3). */
+ * qsort(3) and bsearch(3). Only the label values are compared. */
 static int metric_cmp(void const *a, void const *b) {
   Io__Prometheus__Client__Metric const *m_a =
       *((Io__Prometheus__Client__Metric **)a);
@@ -509,97 +908,203 @@ static int metric_update(Io__Prometheus__Client__Metric *m, value_t value,
   return 0;
 }
 
-/* metric_family_add_metric adds m to the metric list of fam. */
-static int metric_family_add_metric(Io__Prometheus__Client__MetricFamily *fam,
-                                    Io__Prometheus__Client__Metric *m) {
-  Io__Prometheus__Client__Metric **tmp =
-      realloc(fam->metric, (fam->n_metric + 1) * sizeof(*fam->metric));
-  if (tmp == NULL)
+/* metric_hash hashes the label values of a metric. Like metric_cmp(), it
+ * ignores the label names, which are the same for all metrics of a family. */
+static uint64_t metric_hash(Io__Prometheus__Client__Metric const *m) {
+  /* FNV-1a */
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < m->n_label; i++) {
+    for (char const *c = m->label[i]->value; *c != 0; c++)
+      hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    hash = (hash ^ 0xff) * 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+static void prom_metric_destroy(prom_metric_t *pm) {
+  if (pm == NULL)
+    return;
+
+  metric_destroy(pm->m);
+  sfree(pm->labels);
+  sfree(pm);
+}
+
+/* prom_family_index_insert adds a metric to the family's hash table, which
+ * must have room for it. */
+static void prom_family_index_insert(prom_family_t *pf, prom_metric_t *pm) {
+  size_t mask = pf->index_size - 1;
+
+  for (size_t i = (size_t)pm->hash & mask;; i = (i + 1) & mask) {
+    if (pf->index[i] == NULL) {
+      pf->index[i] = pm;
+      return;
+    }
+  }
+}
+
+/* prom_family_index_rebuild resizes the hash table so that it is at most half
+ * full with "metrics_size" metrics and reinserts all metrics. */
+static int prom_family_index_rebuild(prom_family_t *pf) {
+  size_t size = 16;
+  while (size < 2 * pf->metrics_size)
+    size *= 2;
+
+  prom_metric_t **index = calloc(size, sizeof(*index));
+  if (index == NULL)
     return ENOMEM;
-  fam->metric = tmp;
 
-  fam->metric[fam->n_metric] = m;
-  fam->n_metric++;
+  sfree(pf->index);
+  pf->index = index;
+  pf->index_size = size;
 
-  /* Sort the metrics so that lookup is fast. */
-  qsort(fam->metric, fam->n_metric, sizeof(*fam->metric), metric_cmp);
+  for (size_t i = 0; i < pf->metrics_num; i++)
+    prom_family_index_insert(pf, pf->metrics[i]);
 
   return 0;
 }
 
-/* metric_family_delete_metric looks up and deletes the metric corresponding to
- * vl. */
-static int
-metric_family_delete_metric(Io__Prometheus__Client__MetricFamily *fam,
-                            value_list_t const *vl) {
-  Io__Prometheus__Client__Metric *key = METRIC_INIT;
-  METRIC_ADD_LABELS(key, vl);
+/* prom_family_find returns the metric with the same labels as "key",
+ * including stale ones, or NULL. */
+static prom_metric_t *prom_family_find(prom_family_t const *pf,
+                                       Io__Prometheus__Client__Metric *key,
+                                       uint64_t hash) {
+  if (pf->index_size == 0)
+    return NULL;
 
-  size_t i;
-  for (i = 0; i < fam->n_metric; i++) {
-    if (metric_cmp(&key, &fam->metric[i]) == 0)
-      break;
+  size_t mask = pf->index_size - 1;
+  for (size_t i = (size_t)hash & mask; pf->index[i] != NULL;
+       i = (i + 1) & mask) {
+    prom_metric_t *pm = pf->index[i];
+    if ((pm->hash == hash) && (metric_cmp(&key, &pm->m) == 0))
+      return pm;
   }
 
-  if (i >= fam->n_metric)
-    return ENOENT;
+  return NULL;
+}
 
-  metric_destroy(fam->metric[i]);
-  if ((fam->n_metric - 1) > i)
-    memmove(&fam->metric[i], &fam->metric[i + 1],
-            ((fam->n_metric - 1) - i) * sizeof(fam->metric[i]));
-  fam->n_metric--;
+/* prom_family_add_metric adds m to the metric list of the family. */
+static int prom_family_add_metric(prom_family_t *pf, prom_metric_t *pm) {
+  if (pf->metrics_num >= pf->metrics_size) {
+    size_t size = (pf->metrics_size > 0) ? (2 * pf->metrics_size) : 4;
+
+    prom_metric_t **metrics =
+        realloc(pf->metrics, size * sizeof(*pf->metrics));
+    if (metrics == NULL)
+      return ENOMEM;
+    pf->metrics = metrics;
+
+    Io__Prometheus__Client__Metric **tmp =
+        realloc(pf->fam->metric, size * sizeof(*pf->fam->metric));
+    if (tmp == NULL)
+      return ENOMEM;
+    pf->fam->metric = tmp;
+
+    pf->metrics_size = size;
+    if (prom_family_index_rebuild(pf) != 0)
+      return ENOMEM;
+  }
 
-  if (fam->n_metric == 0) {
-    sfree(fam->metric);
-    return 0;
+  pf->metrics[pf->metrics_num] = pm;
+  pf->fam->metric[pf->metrics_num] = pm->m;
+  pf->metrics_num++;
+  pf->fam->n_metric = pf->metrics_num;
+
+  prom_family_index_insert(pf, pm);
+  return 0;
+}
+
+/* prom_family_compact frees the stale metrics of a family and rebuilds its
+ * hash table. */
+static void prom_family_compact(prom_family_t *pf) {
+  size_t num = 0;
+
+  for (size_t i = 0; i < pf->metrics_num; i++) {
+    prom_metric_t *pm = pf->metrics[i];
+    if (pm->stale) {
+      prom_metric_destroy(pm);
+      continue;
+    }
+    pf->metrics[num] = pm;
+    pf->fam->metric[num] = pm->m;
+    num++;
   }
+  pf->metrics_num = num;
+  pf->fam->n_metric = num;
+  pf->stale_num = 0;
+
+  /* Stale metrics are still referenced by the hash table. If it can't be
+   * rebuilt, clear it in place and reinsert the remaining metrics. */
+  if (prom_family_index_rebuild(pf) != 0) {
+    memset(pf->index, 0, pf->index_size * sizeof(*pf->index));
+    for (size_t i = 0; i < pf->metrics_num; i++)
+      prom_family_index_insert(pf, pf->metrics[i]);
+  }
+}
+
+/* prom_family_delete_metric looks up the metric corresponding to vl and marks
+ * it as stale. */
+static int prom_family_delete_metric(prom_family_t *pf,
+                                     value_list_t const *vl) {
+  Io__Prometheus__Client__Metric *key = METRIC_INIT;
+  METRIC_ADD_LABELS(key, vl);
 
-  Io__Prometheus__Client__Metric **tmp =
-      realloc(fam->metric, fam->n_metric * sizeof(*fam->metric));
-  if (tmp != NULL)
-    fam->metric = tmp;
+  prom_metric_t *pm = prom_family_find(pf, key, metric_hash(key));
+  if ((pm == NULL) || pm->stale)
+    return ENOENT;
 
+  pm->stale = true;
+  pf->stale_num++;
   return 0;
 }
 
-/* metric_family_get_metric looks up the matching metric in a metric family,
+/* prom_family_get_metric looks up the matching metric in a metric family,
  * allocating it if necessary. */
 static Io__Prometheus__Client__Metric *
-metric_family_get_metric(Io__Prometheus__Client__MetricFamily *fam,
-                         value_list_t const *vl) {
+prom_family_get_metric(prom_family_t *pf, value_list_t const *vl) {
   Io__Prometheus__Client__Metric *key = METRIC_INIT;
   METRIC_ADD_LABELS(key, vl);
+  uint64_t hash = metric_hash(key);
 
-  /* Metrics are sorted in metric_family_add_metric() so that we can do a binary
-   * search here. */
-  Io__Prometheus__Client__Metric **m = bsearch(
-      &key, fam->metric, fam->n_metric, sizeof(*fam->metric), metric_cmp);
-
-  if (m != NULL) {
-    return *m;
+  prom_metric_t *pm = prom_family_find(pf, key, hash);
+  if (pm != NULL) {
+    if (pm->stale) {
+      pm->stale = false;
+      pf->stale_num--;
+    }
+    return pm->m;
   }
 
-  Io__Prometheus__Client__Metric *new_metric = metric_clone(key);
-  if (new_metric == NULL)
+  pm = calloc(1, sizeof(*pm));
+  if (pm == NULL)
+    return NULL;
+  pm->hash = hash;
+
+  char labels[1024];
+  pm->m = metric_clone(key);
+  pm->labels = strdup(format_labels(labels, sizeof(labels), key));
+  if ((pm->m == NULL) || (pm->labels == NULL)) {
+    prom_metric_destroy(pm);
     return NULL;
+  }
 
   DEBUG("write_prometheus plugin: created new metric in family");
-  int status = metric_family_add_metric(fam, new_metric);
+  int status = prom_family_add_metric(pf, pm);
   if (status != 0) {
-    metric_destroy(new_metric);
+    prom_metric_destroy(pm);
     return NULL;
   }
 
-  return new_metric;
+  return pm->m;
 }
 
-/* metric_family_update looks up the matching metric in a metric family,
+/* prom_family_update looks up the matching metric in a metric family,
  * allocating it if necessary, and updates the metric to the latest value. */
-static int metric_family_update(Io__Prometheus__Client__MetricFamily *fam,
-                                data_set_t const *ds, value_list_t const *vl,
-                                size_t ds_index) {
-  Io__Prometheus__Client__Metric *m = metric_family_get_metric(fam, vl);
+static int prom_family_update(prom_family_t *pf, data_set_t const *ds,
+                              value_list_t const *vl, size_t ds_index) {
+  Io__Prometheus__Client__Metric *m = prom_family_get_metric(pf, vl);
   if (m == NULL)
     return -1;
 
@@ -685,22 +1190,41 @@ static char *metric_family_name(data_set_t const *ds, value_list_t const *vl,
   return strdup(name);
 }
 
+/* prom_family_destroy frees a family and its cache. */
+static void prom_family_destroy(prom_family_t *pf) {
+  if (pf == NULL)
+    return;
+
+  /* The metrics are owned by "pf->metrics". */
+  for (size_t i = 0; i < pf->metrics_num; i++)
+    prom_metric_destroy(pf->metrics[i]);
+  pf->fam->n_metric = 0;
+  sfree(pf->metrics);
+  sfree(pf->index);
+
+  metric_family_destroy(pf->fam);
+  pthread_mutex_destroy(&pf->lock);
+  sfree(pf->text);
+  sfree(pf->proto);
+  sfree(pf);
+}
+
 /* metric_family_get looks up the matching metric family, allocating it if
- * necessary. */
-static Io__Prometheus__Client__MetricFamily *
-metric_family_get(data_set_t const *ds, value_list_t const *vl, size_t ds_index,
-                  bool allocate) {
+ * necessary. "metrics_lock" must be held. */
+static prom_family_t *metric_family_get(data_set_t const *ds,
+                                        value_list_t const *vl,
+                                        size_t ds_index, bool allocate) {
   char *name = metric_family_name(ds, vl, ds_index);
   if (name == NULL) {
     ERROR("write_prometheus plugin: Allocating metric family name failed.");
     return NULL;
   }
 
-  Io__Prometheus__Client__MetricFamily *fam = NULL;
-  if (c_avl_get(metrics, name, (void *)&fam) == 0) {
+  prom_family_t *pf = NULL;
+  if (c_btree_get(metrics, name, (void *)&pf) == 0) {
     sfree(name);
-    assert(fam != NULL);
-    return fam;
+    assert(pf != NULL);
+    return pf;
   }
 
   if (!allocate) {
@@ -708,26 +1232,36 @@ metric_family_get(data_set_t const *ds, value_list_t const *vl, size_t ds_index,
     return NULL;
   }
 
-  fam = metric_family_create(name, ds, vl, ds_index);
-  if (fam == NULL) {
+  pf = calloc(1, sizeof(*pf));
+  if (pf == NULL) {
+    ERROR("write_prometheus plugin: Allocating metric family failed.");
+    sfree(name);
+    return NULL;
+  }
+
+  pf->fam = metric_family_create(name, ds, vl, ds_index);
+  if (pf->fam == NULL) {
     ERROR("write_prometheus plugin: Allocating metric family failed.");
     sfree(name);
+    sfree(pf);
     return NULL;
   }
+  pthread_mutex_init(&pf->lock, /* attr = */ NULL);
+  pf->generation = 1;
 
-  /* If successful, "name" is owned by "fam", i.e. don't free it here. */
+  /* If successful, "name" is owned by "pf->fam", i.e. don't free it here. */
   DEBUG("write_prometheus plugin: metric family \"%s\" has been created.",
         name);
   name = NULL;
 
-  int status = c_avl_insert(metrics, fam->name, fam);
+  int status = c_btree_insert(metrics, pf->fam->name, pf);
   if (status != 0) {
-    ERROR("write_prometheus plugin: Adding \"%s\" failed.", name);
-    metric_family_destroy(fam);
+    ERROR("write_prometheus plugin: Adding \"%s\" failed.", pf->fam->name);
+    prom_family_destroy(pf);
     return NULL;
   }
 
-  return fam;
+  return pf;
 }
 /* }}} */
 
@@ -887,9 +1421,9 @@ static int prom_config(oconfig_item_t *ci) {
 
 static int prom_init() {
   if (metrics == NULL) {
-    metrics = c_avl_create((void *)strcmp);
+    metrics = c_btree_create((void *)strcmp);
     if (metrics == NULL) {
-      ERROR("write_prometheus plugin: c_avl_create() failed.");
+      ERROR("write_prometheus plugin: c_btree_create() failed.");
       return -1;
     }
   }
@@ -908,24 +1442,26 @@ static int prom_init() {
 
 static int prom_write(data_set_t const *ds, value_list_t const *vl,
                       __attribute__((unused)) user_data_t *ud) {
-  pthread_mutex_lock(&metrics_lock);
-
   for (size_t i = 0; i < ds->ds_num; i++) {
-    Io__Prometheus__Client__MetricFamily *fam =
-        metric_family_get(ds, vl, i, /* allocate = */ true);
-    if (fam == NULL)
+    pthread_mutex_lock(&metrics_lock);
+    prom_family_t *pf = metric_family_get(ds, vl, i, /* allocate = */ true);
+    if (pf == NULL) {
+      pthread_mutex_unlock(&metrics_lock);
       continue;
+    }
+    pthread_mutex_lock(&pf->lock);
+    pthread_mutex_unlock(&metrics_lock);
 
-    int status = metric_family_update(fam, ds, vl, i);
-    if (status != 0) {
+    int status = prom_family_update(pf, ds, vl, i);
+    pf->generation++;
+    if (status != 0)
       ERROR("write_prometheus plugin: Updating metric \"%s\" failed with "
             "status %d",
-            fam->name, status);
-      continue;
-    }
+            pf->fam->name, status);
+
+    pthread_mutex_unlock(&pf->lock);
   }
 
-  pthread_mutex_unlock(&metrics_lock);
   return 0;
 }
 
@@ -938,30 +1474,38 @@ static int prom_missing(value_list_t const *vl,
   pthread_mutex_lock(&metrics_lock);
 
   for (size_t i = 0; i < ds->ds_num; i++) {
-    Io__Prometheus__Client__MetricFamily *fam =
-        metric_family_get(ds, vl, i, /* allocate = */ false);
-    if (fam == NULL)
+    prom_family_t *pf = metric_family_get(ds, vl, i, /* allocate = */ false);
+    if (pf == NULL)
       continue;
 
-    int status = metric_family_delete_metric(fam, vl);
+    pthread_mutex_lock(&pf->lock);
+
+    int status = prom_family_delete_metric(pf, vl);
     if (status != 0) {
       ERROR("write_prometheus plugin: Deleting a metric in family \"%s\" "
             "failed with status %d",
-            fam->name, status);
-
+            pf->fam->name, status);
+      pthread_mutex_unlock(&pf->lock);
       continue;
     }
+    pf->generation++;
 
-    if (fam->n_metric == 0) {
-      int status = c_avl_remove(metrics, fam->name, NULL, NULL);
+    bool destroy = false;
+    if (pf->metrics_num == pf->stale_num) {
+      status = c_btree_remove(metrics, pf->fam->name, NULL, NULL);
       if (status != 0) {
         ERROR("write_prometheus plugin: Deleting metric family \"%s\" failed "
               "with status %d",
-              fam->name, status);
-        continue;
+              pf->fam->name, status);
+      } else {
+        pf->deleted = true;
+        destroy = (pf->refs == 0);
       }
-      metric_family_destroy(fam);
     }
+
+    pthread_mutex_unlock(&pf->lock);
+    if (destroy)
+      prom_family_destroy(pf);
   }
 
   pthread_mutex_unlock(&metrics_lock);
@@ -977,14 +1521,14 @@ static int prom_shutdown() {
   pthread_mutex_lock(&metrics_lock);
   if (metrics != NULL) {
     char *name;
-    Io__Prometheus__Client__MetricFamily *fam;
-    while (c_avl_pick(metrics, (void *)&name, (void *)&fam) == 0) {
-      assert(name == fam->name);
+    prom_family_t *pf;
+    while (c_btree_pick(metrics, (void *)&name, (void *)&pf) == 0) {
+      assert(name == pf->fam->name);
       name = NULL;
 
-      metric_family_destroy(fam);
+      prom_family_destroy(pf);
     }
-    c_avl_destroy(metrics);
+    c_btree_destroy(metrics);
     metrics = NULL;
   }
   pthread_mutex_unlock(&metrics_lock);
@@ -36,6 +36,18 @@
 #define REDIS_DEFAULT_PREFIX "collectd/"
 #endif
 
+#ifndef REDIS_DEFAULT_MAX_IN_FLIGHT
+#define REDIS_DEFAULT_MAX_IN_FLIGHT 1024
+#endif
+
+/* A connection of the pool of a node. "lock" is held while a write batch is
+ * sent over the connection. */
+struct wr_conn_s {
+  redisContext *conn;
+  pthread_mutex_t lock;
+};
+typedef struct wr_conn_s wr_conn_t;
+
 struct wr_node_s {
   char name[DATA_MAX_NAME_LEN];
 
@@ -47,8 +59,11 @@ struct wr_node_s {
   int max_set_size;
   int max_set_duration;
   bool store_rates;
+  int max_in_flight;
 
-  redisContext *conn;
+  wr_conn_t *conns;
+  size_t conns_num;
+  size_t conns_next;
   pthread_mutex_t lock;
 };
 typedef struct wr_node_s wr_node_t;
@@ -56,74 +71,90 @@ typedef struct wr_node_s wr_node_t;
 /*
  * Functions
  */
-static int wr_write(const data_set_t *ds, /* {{{ */
-                    const value_list_t *vl, user_data_t *ud) {
-  wr_node_t *node = ud->data;
+static int wr_connect(wr_node_t *node, wr_conn_t *c) /* {{{ */
+{
+  redisReply *rr;
+
+  c->conn =
+      redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
+  if (c->conn == NULL) {
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
+          "Unknown reason",
+          (node->host != NULL) ? node->host : "localhost",
+          (node->port != 0) ? node->port : 6379);
+    return -1;
+  } else if (c->conn->err) {
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
+          (node->host != NULL) ? node->host : "localhost",
+          (node->port != 0) ? node->port : 6379, c->conn->errstr);
+    redisFree(c->conn);
+    c->conn = NULL;
+    return -1;
+  }
+
+  rr = redisCommand(c->conn, "SELECT %d", node->database);
+  if (rr == NULL)
+    WARNING("SELECT command error. database:%d message:%s", node->database,
+            c->conn->errstr);
+  else
+    freeReplyObject(rr);
+
+  return 0;
+} /* }}} int wr_connect */
+
+/* wr_conn_acquire returns a locked connection of the pool, preferring one
+ * that is not used by another write thread. */
+static wr_conn_t *wr_conn_acquire(wr_node_t *node) /* {{{ */
+{
+  pthread_mutex_lock(&node->lock);
+  size_t start = node->conns_next;
+  node->conns_next = (node->conns_next + 1) % node->conns_num;
+  pthread_mutex_unlock(&node->lock);
+
+  for (size_t i = 0; i < node->conns_num; i++) {
+    wr_conn_t *c = node->conns + ((start + i) % node->conns_num);
+    if (pthread_mutex_trylock(&c->lock) == 0)
+      return c;
+  }
+
+  wr_conn_t *c = node->conns + start;
+  pthread_mutex_lock(&c->lock);
+  return c;
+} /* }}} wr_conn_t *wr_conn_acquire */
+
+/* wr_append appends the commands for one value list to the output buffer of
+ * the connection, without waiting for replies. "pending" is incremented for
+ * each command. */
+static int wr_append(wr_node_t *node, redisContext *conn, /* {{{ */
+                     const data_set_t *ds, const value_list_t *vl,
+                     int *pending) {
+  char const *prefix =
+      (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX;
   char ident[512];
   char key[512];
   char value[512] = {0};
   char time[24];
-  size_t value_size;
-  char *value_ptr;
   int status;
-  redisReply *rr;
 
   status = FORMAT_VL(ident, sizeof(ident), vl);
   if (status != 0)
     return status;
-  snprintf(key, sizeof(key), "%s%s",
-           (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX, ident);
+  snprintf(key, sizeof(key), "%s%s", prefix, ident);
   snprintf(time, sizeof(time), "%.9f", CDTIME_T_TO_DOUBLE(vl->time));
 
-  value_size = sizeof(value);
-  value_ptr = &value[0];
-  status = format_values(value_ptr, value_size, ds, vl, node->store_rates);
+  status = format_values(value, sizeof(value), ds, vl, node->store_rates);
   if (status != 0)
     return status;
 
-  pthread_mutex_lock(&node->lock);
-
-  if (node->conn == NULL) {
-    node->conn =
-        redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
-    if (node->conn == NULL) {
-      ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
-            "Unknown reason",
-            (node->host != NULL) ? node->host : "localhost",
-            (node->port != 0) ? node->port : 6379);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    } else if (node->conn->err) {
-      ERROR(
-          "write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
-          (node->host != NULL) ? node->host : "localhost",
-          (node->port != 0) ? node->port : 6379, node->conn->errstr);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    }
-
-    rr = redisCommand(node->conn, "SELECT %d", node->database);
-    if (rr == NULL)
-      WARNING("SELECT command error. database:%d message:%s", node->database,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
-  }
-
-  rr = redisCommand(node->conn, "ZADD %s %s %s", key, time, value);
-  if (rr == NULL)
-    WARNING("ZADD command error. key:%s message:%s", key, node->conn->errstr);
-  else
-    freeReplyObject(rr);
+  if (redisAppendCommand(conn, "ZADD %s %s %s", key, time, value) != REDIS_OK)
+    return -1;
+  (*pending)++;
 
   if (node->max_set_size >= 0) {
-    rr = redisCommand(node->conn, "ZREMRANGEBYRANK %s %d %d", key, 0,
-                      (-1 * node->max_set_size) - 1);
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYRANK command error. key:%s message:%s", key,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+    if (redisAppendCommand(conn, "ZREMRANGEBYRANK %s %d %d", key, 0,
+                           (-1 * node->max_set_size) - 1) != REDIS_OK)
+      return -1;
+    (*pending)++;
   }
 
   if (node->max_set_duration > 0) {
@@ -131,31 +162,85 @@ static int wr_write(const data_set_t *ds, /* {{{ */
      * remove element, scored less than 'current-max_set_duration'
      * '(...' indicates 'less than' in redis CLI.
      */
-    rr = redisCommand(node->conn, "ZREMRANGEBYSCORE %s -1 (%.9f", key,
-                      (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration));
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYSCORE command error. key:%s message:%s", key,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+    if (redisAppendCommand(
+            conn, "ZREMRANGEBYSCORE %s -1 (%.9f", key,
+            (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration)) !=
+        REDIS_OK)
+      return -1;
+    (*pending)++;
   }
 
   /* TODO(octo): This is more overhead than necessary. Use the cache and
    * metadata to determine if it is a new metric and call SADD only once for
    * each metric. */
-  rr = redisCommand(
-      node->conn, "SADD %svalues %s",
-      (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX, ident);
-  if (rr == NULL)
-    WARNING("SADD command error. ident:%s message:%s", ident,
-            node->conn->errstr);
-  else
-    freeReplyObject(rr);
+  if (redisAppendCommand(conn, "SADD %svalues %s", prefix, ident) != REDIS_OK)
+    return -1;
+  (*pending)++;
 
-  pthread_mutex_unlock(&node->lock);
+  return 0;
+} /* }}} int wr_append */
+
+/* wr_read_replies sends the output buffer of the connection, if necessary,
+ * and reads "pending" replies. If the connection fails, it is closed so that
+ * the next batch reconnects. */
+static int wr_read_replies(wr_conn_t *c, int pending) /* {{{ */
+{
+  for (int i = 0; i < pending; i++) {
+    redisReply *rr = NULL;
+
+    if (redisGetReply(c->conn, (void **)&rr) != REDIS_OK) {
+      WARNING("write_redis plugin: Sending commands failed: %s. "
+              "%d commands have been lost.",
+              c->conn->errstr, pending - i);
+      redisFree(c->conn);
+      c->conn = NULL;
+      return -1;
+    }
+
+    if ((rr != NULL) && (rr->type == REDIS_REPLY_ERROR))
+      WARNING("write_redis plugin: Command failed: %s", rr->str);
+    if (rr != NULL)
+      freeReplyObject(rr);
+  }
 
   return 0;
-} /* }}} int wr_write */
+} /* }}} int wr_read_replies */
+
+/* wr_write_batch pipelines the commands of a write batch: they are sent
+ * together and the replies are read afterwards, at most "MaxInFlight"
+ * commands at a time. */
+static int wr_write_batch(data_set_t const *const *ds, /* {{{ */
+                          value_list_t const *const *vl, size_t num,
+                          user_data_t *ud) {
+  wr_node_t *node = ud->data;
+  size_t failure = 0;
+  int pending = 0;
+  int status = 0;
+
+  wr_conn_t *c = wr_conn_acquire(node);
+  if ((c->conn == NULL) && (wr_connect(node, c) != 0)) {
+    pthread_mutex_unlock(&c->lock);
+    return -1;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    if (wr_append(node, c->conn, ds[i], vl[i], &pending) != 0)
+      failure++;
+
+    if ((pending >= node->max_in_flight) || ((i + 1) == num)) {
+      status = wr_read_replies(c, pending);
+      pending = 0;
+      if (status != 0)
+        break;
+    }
+  }
+
+  pthread_mutex_unlock(&c->lock);
+
+  if ((status == 0) && (num > 0) && (failure == num))
+    status = -1;
+  return status;
+} /* }}} int wr_write_batch */
 
 static void wr_config_free(void *ptr) /* {{{ */
 {
@@ -164,10 +249,13 @@ static void wr_config_free(void *ptr) /* {{{ */
   if (node == NULL)
     return;
 
-  if (node->conn != NULL) {
-    redisFree(node->conn);
-    node->conn = NULL;
+  for (size_t i = 0; i < node->conns_num; i++) {
+    if (node->conns[i].conn != NULL)
+      redisFree(node->conns[i].conn);
+    pthread_mutex_destroy(&node->conns[i].lock);
   }
+  sfree(node->conns);
+  pthread_mutex_destroy(&node->lock);
 
   sfree(node->host);
   sfree(node);
@@ -186,13 +274,14 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
   node->port = 0;
   node->timeout.tv_sec = 1;
   node->timeout.tv_usec = 0;
-  node->conn = NULL;
   node->prefix = NULL;
   node->database = 0;
   node->max_set_size = -1;
   node->max_set_duration = -1;
   node->store_rates = true;
+  node->max_in_flight = REDIS_DEFAULT_MAX_IN_FLIGHT;
   pthread_mutex_init(&node->lock, /* attr = */ NULL);
+  int conns_num = 1;
 
   status = cf_util_get_string_buffer(ci, node->name, sizeof(node->name));
   if (status != 0) {
@@ -228,6 +317,18 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &node->max_set_duration);
     } else if (strcasecmp("StoreRates", child->key) == 0) {
       status = cf_util_get_boolean(child, &node->store_rates);
+    } else if (strcasecmp("Connections", child->key) == 0) {
+      status = cf_util_get_int(child, &conns_num);
+      if ((status == 0) && (conns_num < 1)) {
+        ERROR("write_redis plugin: \"Connections\" must be at least 1.");
+        status = EINVAL;
+      }
+    } else if (strcasecmp("MaxInFlight", child->key) == 0) {
+      status = cf_util_get_int(child, &node->max_in_flight);
+      if ((status == 0) && (node->max_in_flight < 1)) {
+        ERROR("write_redis plugin: \"MaxInFlight\" must be at least 1.");
+        status = EINVAL;
+      }
     } else
       WARNING("write_redis plugin: Ignoring unknown config option \"%s\".",
               child->key);
@@ -236,16 +337,28 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
       break;
   } /* for (i = 0; i < ci->children_num; i++) */
 
+  if (status == 0) {
+    node->conns = calloc((size_t)conns_num, sizeof(*node->conns));
+    if (node->conns == NULL) {
+      ERROR("write_redis plugin: calloc failed.");
+      status = ENOMEM;
+    } else {
+      node->conns_num = (size_t)conns_num;
+      for (size_t i = 0; i < node->conns_num; i++)
+        pthread_mutex_init(&node->conns[i].lock, /* attr = */ NULL);
+    }
+  }
+
   if (status == 0) {
     char cb_name[sizeof("write_redis/") + DATA_MAX_NAME_LEN];
 
     snprintf(cb_name, sizeof(cb_name), "write_redis/%s", node->name);
 
-    status =
-        plugin_register_write(cb_name, wr_write,
-                              &(user_data_t){
-                                  .data = node, .free_func = wr_config_free,
-                              });
+    status = plugin_register_write_batch(
+        cb_name, wr_write_batch,
+        &(user_data_t){
+            .data = node, .free_func = wr_config_free,
+        });
   }
 
   if (status != 0)
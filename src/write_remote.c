@@ -0,0 +1,958 @@
+/**
+ * collectd - src/write_remote.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
+#include "utils/format_remote_write/format_remote_write.h"
+#include "utils/snappy/snappy.h"
+#include "utils_cache.h"
+#include "utils_complain.h"
+#include "utils_ident.h"
+
+#include <curl/curl.h>
+
+#define RW_DEFAULT_SHARDS 4
+#define RW_DEFAULT_MAX_IN_FLIGHT 1
+#define RW_DEFAULT_MAX_SAMPLES_PER_SEND 2000
+#define RW_DEFAULT_CAPACITY 10000
+#define RW_DEFAULT_BATCH_SEND_DEADLINE TIME_T_TO_CDTIME_T_STATIC(5)
+#define RW_DEFAULT_MIN_BACKOFF MS_TO_CDTIME_T(30)
+#define RW_DEFAULT_MAX_BACKOFF TIME_T_TO_CDTIME_T_STATIC(5)
+#define RW_POLL_TIMEOUT_MS 100
+#define RW_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T_STATIC(5)
+#define RW_REPORT_INTERVAL TIME_T_TO_CDTIME_T_STATIC(10)
+
+/* A packed series with one sample, see format_remote_write.h. */
+typedef struct rw_series_s rw_series_t;
+struct rw_series_s {
+  rw_series_t *next;
+  cdtime_t time; /* when it was queued */
+  size_t len;
+  uint8_t data[];
+};
+
+/* A snappy compressed WriteRequest. */
+typedef struct rw_request_s rw_request_t;
+struct rw_request_s {
+  rw_request_t *next;
+  size_t samples;
+  size_t len;
+  uint8_t data[];
+};
+
+/* An easy handle and the request it is sending, if any. The handles are
+ * reused, so that connections are kept alive. */
+typedef struct {
+  CURL *curl;
+  rw_request_t *req;
+  char errbuf[CURL_ERROR_SIZE];
+} rw_transfer_t;
+
+typedef struct rw_node_s rw_node_t;
+
+/* Value lists are assigned to shards by their identifier, so that the samples
+ * of a series are sent in order. Every shard has a thread sending its queue
+ * with up to "max_in_flight" concurrent requests. */
+typedef struct {
+  rw_node_t *node;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  rw_series_t *head;
+  rw_series_t *tail;
+  size_t queued;
+  bool flush;
+  bool shutdown;
+  uint64_t dropped;
+  cdtime_t dropped_reported;
+  pthread_t thread;
+  bool thread_running;
+
+  /* Only used by the shard's thread. */
+  CURLM *multi;
+  rw_transfer_t *transfers;
+  uint8_t *body;
+  size_t body_size;
+  c_complain_t retry_complaint;
+  c_complain_t error_complaint;
+} rw_shard_t;
+
+struct rw_node_s {
+  char *name;
+  char *url;
+  char *user;
+  char *pass;
+  char *credentials;
+  bool verify_peer;
+  bool verify_host;
+  char *cacert;
+  int timeout;
+  bool store_rates;
+  struct curl_slist *headers;
+  curl_stats_t *stats;
+
+  int shards_num;
+  int max_in_flight;
+  int max_samples_per_send;
+  int capacity;
+  cdtime_t batch_send_deadline;
+  cdtime_t min_backoff;
+  cdtime_t max_backoff;
+
+  rw_shard_t *shards;
+};
+
+static size_t rw_curl_discard(void __attribute__((unused)) * buf, /* {{{ */
+                              size_t size, size_t nmemb,
+                              void __attribute__((unused)) * user_data) {
+  return size * nmemb;
+} /* }}} size_t rw_curl_discard */
+
+/* must hold s->lock when calling */
+static void rw_report_drops(rw_shard_t *s, cdtime_t now) /* {{{ */
+{
+  if ((s->dropped == 0) || ((now - s->dropped_reported) < RW_REPORT_INTERVAL))
+    return;
+
+  WARNING("write_remote plugin: <%s>: The send queue is full. %" PRIu64
+          " samples have been dropped since the last report.",
+          s->node->name, s->dropped);
+  s->dropped = 0;
+  s->dropped_reported = now;
+} /* }}} void rw_report_drops */
+
+/* rw_shard_due returns true if a batch is to be sent: once it is full, its
+ * oldest sample has waited for "BatchSendDeadline", or when flushing. Must hold
+ * s->lock when calling. */
+static bool rw_shard_due(rw_shard_t *s, cdtime_t now) /* {{{ */
+{
+  if (s->head == NULL) {
+    s->flush = false;
+    return false;
+  }
+
+  return (s->queued >= (size_t)s->node->max_samples_per_send) || s->flush ||
+         s->shutdown ||
+         ((now - s->head->time) >= s->node->batch_send_deadline);
+} /* }}} bool rw_shard_due */
+
+/* rw_shard_take removes up to "MaxSamplesPerSend" series from the queue. Must
+ * hold s->lock when calling. */
+static rw_series_t *rw_shard_take(rw_shard_t *s, size_t *ret_num, /* {{{ */
+                                  size_t *ret_len) {
+  rw_series_t *last = NULL;
+  size_t num = 0;
+  size_t len = 0;
+
+  for (rw_series_t *series = s->head;
+       (series != NULL) && (num < (size_t)s->node->max_samples_per_send);
+       series = series->next) {
+    last = series;
+    num++;
+    len += series->len;
+  }
+  if (last == NULL)
+    return NULL;
+
+  rw_series_t *batch = s->head;
+  s->head = last->next;
+  if (s->head == NULL)
+    s->tail = NULL;
+  last->next = NULL;
+  s->queued -= num;
+
+  *ret_num = num;
+  *ret_len = len;
+  return batch;
+} /* }}} rw_series_t *rw_shard_take */
+
+/* rw_request_create concatenates the series of a batch, which makes a
+ * WriteRequest, and compresses it. The series are freed. */
+static rw_request_t *rw_request_create(rw_shard_t *s, /* {{{ */
+                                       rw_series_t *batch, size_t num,
+                                       size_t len) {
+  if (s->body_size < len) {
+    uint8_t *tmp = realloc(s->body, len);
+    if (tmp == NULL) {
+      ERROR("write_remote plugin: realloc failed.");
+      while (batch != NULL) {
+        rw_series_t *next = batch->next;
+        sfree(batch);
+        batch = next;
+      }
+      return NULL;
+    }
+    s->body = tmp;
+    s->body_size = len;
+  }
+
+  size_t offset = 0;
+  while (batch != NULL) {
+    rw_series_t *next = batch->next;
+    memcpy(s->body + offset, batch->data, batch->len);
+    offset += batch->len;
+    sfree(batch);
+    batch = next;
+  }
+
+  rw_request_t *req = malloc(sizeof(*req) + snappy_max_compressed_length(len));
+  if (req == NULL) {
+    ERROR("write_remote plugin: malloc failed.");
+    return NULL;
+  }
+  req->next = NULL;
+  req->samples = num;
+  req->len = snappy_compress(s->body, len, req->data);
+  return req;
+} /* }}} rw_request_t *rw_request_create */
+
+/* rw_retryable returns true if a request that failed should be sent again
+ * later: the server could not be reached, failed, or asked us to slow down.
+ * Other client errors are permanent, the request is dropped. */
+static bool rw_retryable(CURLcode result, long http_code) /* {{{ */
+{
+  switch (result) {
+  case CURLE_OK:
+    return (http_code == 429) || (http_code >= 500);
+  case CURLE_COULDNT_RESOLVE_HOST:
+  case CURLE_COULDNT_CONNECT:
+  case CURLE_OPERATION_TIMEDOUT:
+  case CURLE_SEND_ERROR:
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+    return true;
+  default:
+    return false;
+  }
+} /* }}} bool rw_retryable */
+
+/* rw_complete handles a finished transfer. It returns true if the request has
+ * to be sent again, in which case "*backoff" is set to the time to wait before
+ * doing so. Otherwise the request is done with. */
+static bool rw_complete(rw_shard_t *s, rw_transfer_t *t, /* {{{ */
+                        CURLcode result, cdtime_t *backoff) {
+  rw_node_t *node = s->node;
+  long http_code = 0;
+  curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  if ((result == CURLE_OK) && (http_code >= 200) && (http_code < 300)) {
+    c_release(LOG_INFO, &s->retry_complaint,
+              "write_remote plugin: <%s>: Sending succeeded again.",
+              node->name);
+    c_release(LOG_INFO, &s->error_complaint,
+              "write_remote plugin: <%s>: Sending succeeded again.",
+              node->name);
+    *backoff = 0;
+    return false;
+  }
+
+  if (!rw_retryable(result, http_code)) {
+    if (result != CURLE_OK)
+      c_complain(LOG_ERR, &s->error_complaint,
+                 "write_remote plugin: <%s>: Sending failed with status %i: "
+                 "%s. Dropped %" PRIsz " samples.",
+                 node->name, result, t->errbuf, t->req->samples);
+    else
+      c_complain(LOG_ERR, &s->error_complaint,
+                 "write_remote plugin: <%s>: The server responded with HTTP "
+                 "status %ld. Dropped %" PRIsz " samples.",
+                 node->name, http_code, t->req->samples);
+    return false;
+  }
+
+  /* Double the time to wait with every failure in a row. */
+  *backoff *= 2;
+  if (*backoff < node->min_backoff)
+    *backoff = node->min_backoff;
+
+#if LIBCURL_VERSION_NUM >= 0x074200
+  curl_off_t retry_after = 0;
+  if ((curl_easy_getinfo(t->curl, CURLINFO_RETRY_AFTER, &retry_after) ==
+       CURLE_OK) &&
+      (retry_after > 0))
+    *backoff = TIME_T_TO_CDTIME_T((time_t)retry_after);
+#endif
+
+  if (*backoff > node->max_backoff)
+    *backoff = node->max_backoff;
+
+  if (result != CURLE_OK)
+    c_complain(LOG_WARNING, &s->retry_complaint,
+               "write_remote plugin: <%s>: Sending failed with status %i: %s. "
+               "Retrying in %.3f seconds.",
+               node->name, result, t->errbuf, CDTIME_T_TO_DOUBLE(*backoff));
+  else
+    c_complain(LOG_WARNING, &s->retry_complaint,
+               "write_remote plugin: <%s>: The server responded with HTTP "
+               "status %ld. Retrying in %.3f seconds.",
+               node->name, http_code, CDTIME_T_TO_DOUBLE(*backoff));
+  return true;
+} /* }}} bool rw_complete */
+
+/* rw_shard_thread sends the queue of a shard. Failed requests are retried
+ * before new batches are sent, and no request is started until the back-off
+ * time has passed, so that the samples of a series arrive in order as long as
+ * "MaxInFlight" is one. */
+static void *rw_shard_thread(void *arg) /* {{{ */
+{
+  rw_shard_t *s = arg;
+  rw_node_t *node = s->node;
+  size_t transfers_num = (size_t)node->max_in_flight;
+  size_t in_flight = 0;
+  rw_request_t *retry_head = NULL;
+  rw_request_t *retry_tail = NULL;
+  cdtime_t backoff = 0;
+  cdtime_t retry_at = 0;
+  cdtime_t deadline = 0;
+
+  pthread_mutex_lock(&s->lock);
+  while (42) {
+    cdtime_t now = cdtime();
+    rw_report_drops(s, now);
+
+    /* When shutting down, keep sending for a while. */
+    if (s->shutdown) {
+      if (deadline == 0)
+        deadline = now + RW_SHUTDOWN_TIMEOUT;
+      if (((in_flight == 0) && (s->head == NULL) && (retry_head == NULL)) ||
+          (now >= deadline))
+        break;
+    }
+
+    bool may_send = (now >= retry_at);
+    bool due = rw_shard_due(s, now);
+    if ((in_flight == 0) && (!may_send || (!due && (retry_head == NULL)))) {
+      cdtime_t until = 0;
+      if (!may_send)
+        until = retry_at;
+      else if (s->head != NULL)
+        until = s->head->time + node->batch_send_deadline;
+      if ((deadline != 0) && ((until == 0) || (deadline < until)))
+        until = deadline;
+
+      if (until == 0) {
+        pthread_cond_wait(&s->cond, &s->lock);
+      } else {
+        struct timespec ts = CDTIME_T_TO_TIMESPEC(until);
+        pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+      }
+      continue;
+    }
+
+    for (size_t i = 0; may_send && (i < transfers_num); i++) {
+      rw_transfer_t *t = s->transfers + i;
+      if (t->req != NULL)
+        continue;
+
+      rw_request_t *req = NULL;
+      if (retry_head != NULL) {
+        req = retry_head;
+        retry_head = req->next;
+        if (retry_head == NULL)
+          retry_tail = NULL;
+        req->next = NULL;
+      } else if (rw_shard_due(s, now)) {
+        size_t num = 0;
+        size_t len = 0;
+        rw_series_t *batch = rw_shard_take(s, &num, &len);
+
+        /* Compress without blocking the write callback. */
+        pthread_mutex_unlock(&s->lock);
+        req = rw_request_create(s, batch, num, len);
+        pthread_mutex_lock(&s->lock);
+        if (req == NULL) {
+          s->dropped += num;
+          continue;
+        }
+      } else {
+        break;
+      }
+
+      t->req = req;
+      curl_easy_setopt(t->curl, CURLOPT_POSTFIELDSIZE, (long)req->len);
+      curl_easy_setopt(t->curl, CURLOPT_POSTFIELDS, (char *)req->data);
+      curl_multi_add_handle(s->multi, t->curl);
+      in_flight++;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    int running = 0;
+    curl_multi_perform(s->multi, &running);
+    if (running > 0) {
+      curl_multi_wait(s->multi, /* extra_fds = */ NULL, /* extra_nfds = */ 0,
+                      RW_POLL_TIMEOUT_MS, /* numfds = */ NULL);
+      curl_multi_perform(s->multi, &running);
+    }
+
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(s->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      CURLcode result = msg->data.result;
+      char *priv = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+      rw_transfer_t *t = (rw_transfer_t *)priv;
+
+      curl_multi_remove_handle(s->multi, t->curl);
+      in_flight--;
+      curl_stats_dispatch(s->node->stats, t->curl, NULL, "write_remote",
+                          s->node->name);
+
+      rw_request_t *req = t->req;
+      if (rw_complete(s, t, result, &backoff)) {
+        retry_at = cdtime() + backoff;
+        if (retry_tail == NULL)
+          retry_head = req;
+        else
+          retry_tail->next = req;
+        retry_tail = req;
+      } else {
+        sfree(req);
+      }
+      t->req = NULL;
+    }
+
+    pthread_mutex_lock(&s->lock);
+  }
+
+  /* Give up on what has not been sent. */
+  size_t lost = 0;
+  for (size_t i = 0; i < transfers_num; i++) {
+    rw_transfer_t *t = s->transfers + i;
+    if (t->req == NULL)
+      continue;
+
+    curl_multi_remove_handle(s->multi, t->curl);
+    lost += t->req->samples;
+    sfree(t->req);
+  }
+  while (retry_head != NULL) {
+    rw_request_t *req = retry_head;
+    retry_head = req->next;
+    lost += req->samples;
+    sfree(req);
+  }
+  while (s->head != NULL) {
+    rw_series_t *series = s->head;
+    s->head = series->next;
+    sfree(series);
+    lost++;
+  }
+  s->tail = NULL;
+  s->queued = 0;
+
+  /* Report the remaining drops, too. */
+  s->dropped_reported = 0;
+  rw_report_drops(s, cdtime());
+  pthread_mutex_unlock(&s->lock);
+
+  if (lost > 0)
+    WARNING("write_remote plugin: <%s>: %" PRIsz " samples have not been sent "
+            "when shutting down.",
+            node->name, lost);
+
+  return NULL;
+} /* }}} void *rw_shard_thread */
+
+static int rw_curl_setup(rw_node_t *node, rw_transfer_t *t) /* {{{ */
+{
+  CURL *curl = t->curl;
+
+  curl_easy_setopt(curl, CURLOPT_URL, node->url);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, node->headers);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, t->errbuf);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, rw_curl_discard);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (char *)t);
+
+#ifdef HAVE_CURLOPT_TIMEOUT_MS
+  if (node->timeout > 0)
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)node->timeout);
+#endif
+
+  if (node->credentials != NULL) {
+    curl_easy_setopt(curl, CURLOPT_USERPWD, node->credentials);
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+  }
+
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, (long)node->verify_peer);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, node->verify_host ? 2L : 0L);
+  if (node->cacert != NULL)
+    curl_easy_setopt(curl, CURLOPT_CAINFO, node->cacert);
+
+  return 0;
+} /* }}} int rw_curl_setup */
+
+/* rw_shard_start sets up the easy handles and starts the shard's thread. This
+ * is done on the first value list, because the daemon may fork after reading
+ * the configuration. Must hold s->lock when calling. */
+static int rw_shard_start(rw_shard_t *s) /* {{{ */
+{
+  rw_node_t *node = s->node;
+  size_t transfers_num = (size_t)node->max_in_flight;
+
+  s->multi = curl_multi_init();
+  if (s->multi == NULL) {
+    ERROR("write_remote plugin: curl_multi_init failed.");
+    return -1;
+  }
+  /* Keep one connection per transfer alive. */
+  curl_multi_setopt(s->multi, CURLMOPT_MAXCONNECTS, (long)node->max_in_flight);
+
+  s->transfers = calloc(transfers_num, sizeof(*s->transfers));
+  if (s->transfers == NULL) {
+    ERROR("write_remote plugin: calloc failed.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < transfers_num; i++) {
+    rw_transfer_t *t = s->transfers + i;
+
+    t->curl = curl_easy_init();
+    if (t->curl == NULL) {
+      ERROR("write_remote plugin: curl_easy_init failed.");
+      return -1;
+    }
+    rw_curl_setup(node, t);
+  }
+
+  int status = plugin_thread_create(&s->thread, /* attr = */ NULL,
+                                    rw_shard_thread, s, "write_remote");
+  if (status != 0) {
+    ERROR("write_remote plugin: plugin_thread_create failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+
+  s->thread_running = true;
+  return 0;
+} /* }}} int rw_shard_start */
+
+static uint64_t rw_identifier_hash(value_list_t const *vl) /* {{{ */
+{
+  if (vl->ident != NULL)
+    return vl->ident->hash;
+
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return 0;
+  return ident_hash(name);
+} /* }}} uint64_t rw_identifier_hash */
+
+static void rw_series_free(rw_series_t *series) /* {{{ */
+{
+  while (series != NULL) {
+    rw_series_t *next = series->next;
+    sfree(series);
+    series = next;
+  }
+} /* }}} void rw_series_free */
+
+static int rw_write(data_set_t const *ds, value_list_t const *vl, /* {{{ */
+                    user_data_t *ud) {
+  if ((ud == NULL) || (ud->data == NULL))
+    return EINVAL;
+
+  rw_node_t *node = ud->data;
+
+  gauge_t *rates = NULL;
+  if (node->store_rates) {
+    rates = uc_get_rate(ds, vl);
+    if (rates == NULL) {
+      ERROR("write_remote plugin: uc_get_rate failed.");
+      return -1;
+    }
+  }
+
+  /* Pack the series before taking the shard's lock. */
+  rw_series_t *head = NULL;
+  rw_series_t *tail = NULL;
+  size_t num = 0;
+  cdtime_t now = cdtime();
+  int status = 0;
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    uint8_t buffer[FORMAT_REMOTE_WRITE_SERIES_SIZE];
+    size_t len = 0;
+
+    status = format_remote_write_series(buffer, sizeof(buffer), &len, ds, vl,
+                                        i, rates);
+    if (status != 0) {
+      ERROR("write_remote plugin: format_remote_write_series failed: %s",
+            STRERROR(status));
+      break;
+    }
+
+    rw_series_t *series = malloc(sizeof(*series) + len);
+    if (series == NULL) {
+      ERROR("write_remote plugin: malloc failed.");
+      status = ENOMEM;
+      break;
+    }
+    series->next = NULL;
+    series->time = now;
+    series->len = len;
+    memcpy(series->data, buffer, len);
+
+    if (tail == NULL)
+      head = series;
+    else
+      tail->next = series;
+    tail = series;
+    num++;
+  }
+  sfree(rates);
+
+  if (status != 0) {
+    rw_series_free(head);
+    return status;
+  }
+  if (head == NULL)
+    return 0;
+
+  rw_shard_t *s =
+      node->shards + (rw_identifier_hash(vl) % (uint64_t)node->shards_num);
+
+  pthread_mutex_lock(&s->lock);
+
+  if (!s->thread_running && !s->shutdown && (s->multi == NULL))
+    rw_shard_start(s);
+
+  if (!s->thread_running) {
+    pthread_mutex_unlock(&s->lock);
+    rw_series_free(head);
+    return -1;
+  }
+
+  /* Drop new samples rather than old ones, which keeps the series in order. */
+  if ((s->queued + num) > (size_t)node->capacity) {
+    s->dropped += num;
+    rw_report_drops(s, now);
+    pthread_mutex_unlock(&s->lock);
+    rw_series_free(head);
+    return 0;
+  }
+
+  bool was_empty = (s->head == NULL);
+  if (s->tail == NULL)
+    s->head = head;
+  else
+    s->tail->next = head;
+  s->tail = tail;
+  s->queued += num;
+
+  /* The thread sleeps until the oldest sample is due, unless the queue was
+   * empty, and needs to be woken up when a batch is complete. */
+  if (was_empty ||
+      ((s->queued >= (size_t)node->max_samples_per_send) &&
+       ((s->queued - num) < (size_t)node->max_samples_per_send)))
+    pthread_cond_signal(&s->cond);
+
+  pthread_mutex_unlock(&s->lock);
+  return 0;
+} /* }}} int rw_write */
+
+static int rw_flush(cdtime_t __attribute__((unused)) timeout, /* {{{ */
+                    char const __attribute__((unused)) * identifier,
+                    user_data_t *ud) {
+  if ((ud == NULL) || (ud->data == NULL))
+    return EINVAL;
+
+  rw_node_t *node = ud->data;
+
+  for (int i = 0; i < node->shards_num; i++) {
+    rw_shard_t *s = node->shards + i;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->head != NULL) {
+      s->flush = true;
+      pthread_cond_signal(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+  }
+
+  return 0;
+} /* }}} int rw_flush */
+
+static void rw_node_free(void *arg) /* {{{ */
+{
+  rw_node_t *node = arg;
+  if (node == NULL)
+    return;
+
+  /* Let all shards send what is queued, then wait for them. */
+  for (int i = 0; (node->shards != NULL) && (i < node->shards_num); i++) {
+    rw_shard_t *s = node->shards + i;
+
+    pthread_mutex_lock(&s->lock);
+    s->shutdown = true;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+  }
+
+  for (int i = 0; (node->shards != NULL) && (i < node->shards_num); i++) {
+    rw_shard_t *s = node->shards + i;
+
+    if (s->thread_running) {
+      pthread_join(s->thread, NULL);
+      s->thread_running = false;
+    }
+
+    if (s->transfers != NULL) {
+      for (int j = 0; j < node->max_in_flight; j++)
+        if (s->transfers[j].curl != NULL)
+          curl_easy_cleanup(s->transfers[j].curl);
+      sfree(s->transfers);
+    }
+    if (s->multi != NULL)
+      curl_multi_cleanup(s->multi);
+
+    rw_series_free(s->head);
+    sfree(s->body);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+  }
+  sfree(node->shards);
+
+  if (node->headers != NULL)
+    curl_slist_free_all(node->headers);
+  curl_stats_destroy(node->stats);
+
+  sfree(node->name);
+  sfree(node->url);
+  sfree(node->user);
+  sfree(node->pass);
+  sfree(node->credentials);
+  sfree(node->cacert);
+  sfree(node);
+} /* }}} void rw_node_free */
+
+static int rw_config_header(oconfig_item_t *ci, /* {{{ */
+                            struct curl_slist **headers) {
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
+    ERROR("write_remote plugin: `%s' needs exactly one string argument.",
+          ci->key);
+    return -1;
+  }
+
+  struct curl_slist *tmp =
+      curl_slist_append(*headers, ci->values[0].value.string);
+  if (tmp == NULL)
+    return -1;
+
+  *headers = tmp;
+  return 0;
+} /* }}} int rw_config_header */
+
+static int rw_config_positive(oconfig_item_t *ci, int *ret) /* {{{ */
+{
+  int status = cf_util_get_int(ci, ret);
+  if (status != 0)
+    return status;
+
+  if (*ret < 1) {
+    ERROR("write_remote plugin: \"%s\" must be at least 1.", ci->key);
+    return -1;
+  }
+  return 0;
+} /* }}} int rw_config_positive */
+
+static int rw_config_node(oconfig_item_t *ci) /* {{{ */
+{
+  rw_node_t *node = calloc(1, sizeof(*node));
+  if (node == NULL) {
+    ERROR("write_remote plugin: calloc failed.");
+    return -1;
+  }
+  node->verify_peer = true;
+  node->verify_host = true;
+  node->shards_num = RW_DEFAULT_SHARDS;
+  node->max_in_flight = RW_DEFAULT_MAX_IN_FLIGHT;
+  node->max_samples_per_send = RW_DEFAULT_MAX_SAMPLES_PER_SEND;
+  node->capacity = RW_DEFAULT_CAPACITY;
+  node->batch_send_deadline = RW_DEFAULT_BATCH_SEND_DEADLINE;
+  node->min_backoff = RW_DEFAULT_MIN_BACKOFF;
+  node->max_backoff = RW_DEFAULT_MAX_BACKOFF;
+
+  int status = cf_util_get_string(ci, &node->name);
+  if (status != 0) {
+    sfree(node);
+    return status;
+  }
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("URL", child->key) == 0)
+      status = cf_util_get_string(child, &node->url);
+    else if (strcasecmp("User", child->key) == 0)
+      status = cf_util_get_string(child, &node->user);
+    else if (strcasecmp("Password", child->key) == 0)
+      status = cf_util_get_string(child, &node->pass);
+    else if (strcasecmp("Header", child->key) == 0)
+      status = rw_config_header(child, &node->headers);
+    else if (strcasecmp("VerifyPeer", child->key) == 0)
+      status = cf_util_get_boolean(child, &node->verify_peer);
+    else if (strcasecmp("VerifyHost", child->key) == 0)
+      status = cf_util_get_boolean(child, &node->verify_host);
+    else if (strcasecmp("CACert", child->key) == 0)
+      status = cf_util_get_string(child, &node->cacert);
+    else if (strcasecmp("Timeout", child->key) == 0)
+      status = cf_util_get_int(child, &node->timeout);
+    else if (strcasecmp("StoreRates", child->key) == 0)
+      status = cf_util_get_boolean(child, &node->store_rates);
+    else if (strcasecmp("Shards", child->key) == 0)
+      status = rw_config_positive(child, &node->shards_num);
+    else if (strcasecmp("MaxInFlight", child->key) == 0)
+      status = rw_config_positive(child, &node->max_in_flight);
+    else if (strcasecmp("MaxSamplesPerSend", child->key) == 0)
+      status = rw_config_positive(child, &node->max_samples_per_send);
+    else if (strcasecmp("Capacity", child->key) == 0)
+      status = rw_config_positive(child, &node->capacity);
+    else if (strcasecmp("BatchSendDeadline", child->key) == 0)
+      status = cf_util_get_cdtime(child, &node->batch_send_deadline);
+    else if (strcasecmp("MinBackoff", child->key) == 0)
+      status = cf_util_get_cdtime(child, &node->min_backoff);
+    else if (strcasecmp("MaxBackoff", child->key) == 0)
+      status = cf_util_get_cdtime(child, &node->max_backoff);
+    else if (strcasecmp("Statistics", child->key) == 0) {
+      curl_stats_destroy(node->stats);
+      node->stats = curl_stats_from_config(child);
+      if (node->stats == NULL)
+        status = EINVAL;
+    } else {
+      ERROR("write_remote plugin: Invalid configuration option: %s.",
+            child->key);
+      status = EINVAL;
+    }
+
+    if (status != 0)
+      break;
+  }
+
+  if ((status == 0) && (node->url == NULL)) {
+    ERROR("write_remote plugin: No URL defined for node \"%s\".", node->name);
+    status = EINVAL;
+  }
+
+  if (status != 0) {
+    rw_node_free(node);
+    return status;
+  }
+
+  if (node->capacity < node->max_samples_per_send) {
+    WARNING("write_remote plugin: <%s>: \"Capacity\" is less than "
+            "\"MaxSamplesPerSend\". Raising it to %d.",
+            node->name, node->max_samples_per_send);
+    node->capacity = node->max_samples_per_send;
+  }
+  if (node->min_backoff == 0)
+    node->min_backoff = RW_DEFAULT_MIN_BACKOFF;
+  if (node->max_backoff < node->min_backoff)
+    node->max_backoff = node->min_backoff;
+
+  if (node->user != NULL) {
+    size_t size = strlen(node->user) + 2;
+    if (node->pass != NULL)
+      size += strlen(node->pass);
+
+    node->credentials = malloc(size);
+    if (node->credentials == NULL) {
+      ERROR("write_remote plugin: malloc failed.");
+      rw_node_free(node);
+      return ENOMEM;
+    }
+    snprintf(node->credentials, size, "%s:%s", node->user,
+             (node->pass == NULL) ? "" : node->pass);
+  }
+
+  node->headers = curl_slist_append(node->headers, "Content-Encoding: snappy");
+  node->headers =
+      curl_slist_append(node->headers, "Content-Type: application/x-protobuf");
+  node->headers = curl_slist_append(node->headers,
+                                    "X-Prometheus-Remote-Write-Version: 0.1.0");
+  node->headers = curl_slist_append(node->headers, "Expect:");
+
+  node->shards = calloc((size_t)node->shards_num, sizeof(*node->shards));
+  if (node->shards == NULL) {
+    ERROR("write_remote plugin: calloc failed.");
+    rw_node_free(node);
+    return ENOMEM;
+  }
+  for (int i = 0; i < node->shards_num; i++) {
+    rw_shard_t *s = node->shards + i;
+
+    s->node = node;
+    pthread_mutex_init(&s->lock, /* attr = */ NULL);
+    pthread_cond_init(&s->cond, /* attr = */ NULL);
+  }
+
+  char callback_name[DATA_MAX_NAME_LEN];
+  snprintf(callback_name, sizeof(callback_name), "write_remote/%s",
+           node->name);
+
+  user_data_t user_data = {
+      .data = node,
+      .free_func = rw_node_free,
+  };
+  plugin_register_write(callback_name, rw_write, &user_data);
+  user_data.free_func = NULL;
+  plugin_register_flush(callback_name, rw_flush, &user_data);
+
+  return 0;
+} /* }}} int rw_config_node */
+
+static int rw_config(oconfig_item_t *ci) /* {{{ */
+{
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Node", child->key) == 0)
+      rw_config_node(child);
+    else
+      ERROR("write_remote plugin: Invalid configuration option: %s.",
+            child->key);
+  }
+
+  return 0;
+} /* }}} int rw_config */
+
+static int rw_init(void) /* {{{ */
+{
+  /* Call this while collectd is still single-threaded to avoid
+   * initialization issues in libgcrypt. */
+  curl_global_init(CURL_GLOBAL_SSL);
+  return 0;
+} /* }}} int rw_init */
+
+void module_register(void) /* {{{ */
+{
+  plugin_register_complex_config("write_remote", rw_config);
+  plugin_register_init("write_remote", rw_init);
+} /* }}} void module_register */
@@ -43,6 +43,19 @@
 #define RIEMANN_TTL_FACTOR 2.0
 #define RIEMANN_BATCH_MAX 8192
 
+#define RIEMANN_ASYNC_DEFAULT_QUEUE_SIZE (1024 * 1024)
+#define RIEMANN_ASYNC_RETRY_MIN TIME_T_TO_CDTIME_T(1)
+#define RIEMANN_ASYNC_RETRY_MAX TIME_T_TO_CDTIME_T(60)
+#define RIEMANN_ASYNC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(2)
+#define RIEMANN_ASYNC_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+/* A message queued for the sending thread in asynchronous mode. */
+struct wrr_msg {
+  struct wrr_msg *next;
+  riemann_message_t *msg;
+  size_t size;
+};
+
 struct riemann_host {
   c_complain_t init_complaint;
   char *name;
@@ -67,6 +80,22 @@ struct riemann_host {
   char *tls_cert_file;
   char *tls_key_file;
   struct timeval timeout;
+
+  /* Asynchronous mode: messages are queued for "async_thread", which is then
+   * the only thread using "client". The queue holds at most
+   * "async_queue_size" bytes of packed messages. */
+  bool async;
+  size_t async_queue_size;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  struct wrr_msg *queue_head;
+  struct wrr_msg *queue_tail;
+  size_t queue_bytes;
+  uint64_t dropped;
+  uint64_t dropped_reported;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
 };
 
 static char **riemann_tags;
@@ -74,7 +103,8 @@ static size_t riemann_tags_num;
 static char **riemann_attrs;
 static size_t riemann_attrs_num;
 
-/* host->lock must be held when calling this function. */
+/* host->lock must be held when calling this function. In asynchronous mode,
+ * only the sending thread calls it. */
 static int wrr_connect(struct riemann_host *host) /* {{{ */
 {
   char const *node;
@@ -121,7 +151,8 @@ static int wrr_connect(struct riemann_host *host) /* {{{ */
   return 0;
 } /* }}} int wrr_connect */
 
-/* host->lock must be held when calling this function. */
+/* host->lock must be held when calling this function. In asynchronous mode,
+ * only the sending thread calls it. */
 static int wrr_disconnect(struct riemann_host *host) /* {{{ */
 {
   if (!host->client)
@@ -181,6 +212,172 @@ static int wrr_send(struct riemann_host *host, riemann_message_t *msg) {
   return status;
 }
 
+static void *wrr_async_thread(void *arg);
+
+/* Queues "msg" for the sending thread, or drops it if the queue is full.
+ * Takes ownership of "msg". The thread is started with the first message,
+ * because the daemon may fork after reading the configuration. */
+static int wrr_async_enqueue(struct riemann_host *host, /* {{{ */
+                             riemann_message_t *msg) {
+  struct wrr_msg *m = malloc(sizeof(*m));
+  if (m == NULL) {
+    ERROR("write_riemann plugin: malloc failed.");
+    riemann_message_free(msg);
+    return ENOMEM;
+  }
+  m->next = NULL;
+  m->msg = msg;
+  m->size = riemann_message_get_packed_size(msg);
+
+  pthread_mutex_lock(&host->queue_lock);
+
+  if (!host->async_thread_running && !host->async_shutdown) {
+    int status = plugin_thread_create(&host->async_thread, /* attr = */ NULL,
+                                      wrr_async_thread, host, "write_riemann");
+    if (status != 0)
+      ERROR("write_riemann plugin: plugin_thread_create failed: %s",
+            STRERROR(status));
+    else
+      host->async_thread_running = true;
+  }
+
+  if (!host->async_thread_running ||
+      ((host->queue_bytes + m->size) > host->async_queue_size)) {
+    host->dropped += msg->n_events;
+    pthread_mutex_unlock(&host->queue_lock);
+    riemann_message_free(msg);
+    free(m);
+    return 0;
+  }
+
+  if (host->queue_tail == NULL)
+    host->queue_head = m;
+  else
+    host->queue_tail->next = m;
+  host->queue_tail = m;
+  host->queue_bytes += m->size;
+
+  pthread_cond_signal(&host->queue_cond);
+  pthread_mutex_unlock(&host->queue_lock);
+  return 0;
+} /* }}} int wrr_async_enqueue */
+
+/* Sends the queue of "host". While Riemann is not reachable, the queue is kept
+ * and the time between attempts doubles up to RIEMANN_ASYNC_RETRY_MAX. */
+static void *wrr_async_thread(void *arg) /* {{{ */
+{
+  struct riemann_host *host = arg;
+  cdtime_t shutdown_deadline = 0;
+  cdtime_t last_report = 0;
+  cdtime_t retry_interval = 0;
+
+  pthread_mutex_lock(&host->queue_lock);
+  while (42) {
+    while ((host->queue_head == NULL) && !host->async_shutdown)
+      pthread_cond_wait(&host->queue_cond, &host->queue_lock);
+
+    if (host->queue_head == NULL)
+      break;
+
+    cdtime_t now = cdtime();
+    if (host->async_shutdown) {
+      if (shutdown_deadline == 0)
+        shutdown_deadline = now + RIEMANN_ASYNC_SHUTDOWN_TIMEOUT;
+      else if (now > shutdown_deadline)
+        break;
+    }
+
+    uint64_t dropped = 0;
+    if ((host->dropped != host->dropped_reported) &&
+        ((now - last_report) >= RIEMANN_ASYNC_REPORT_INTERVAL)) {
+      dropped = host->dropped - host->dropped_reported;
+      host->dropped_reported = host->dropped;
+      last_report = now;
+    }
+
+    /* Messages are only appended by other threads, so the head does not
+     * change while the lock is released. */
+    struct wrr_msg *m = host->queue_head;
+    pthread_mutex_unlock(&host->queue_lock);
+
+    if (dropped > 0)
+      WARNING("write_riemann plugin: Node \"%s\": The send queue is full. "
+              "%" PRIu64 " events have been dropped since the last report.",
+              host->name, dropped);
+
+    int status = wrr_send_nolock(host, m->msg);
+    if (status != 0)
+      c_complain(
+          LOG_ERR, &host->init_complaint,
+          "write_riemann plugin: riemann_client_send failed with status %i",
+          status);
+    else
+      c_release(LOG_INFO, &host->init_complaint,
+                "write_riemann plugin: riemann_client_send succeeded again");
+
+    pthread_mutex_lock(&host->queue_lock);
+    if (status == 0) {
+      host->queue_head = m->next;
+      if (host->queue_head == NULL)
+        host->queue_tail = NULL;
+      host->queue_bytes -= m->size;
+      riemann_message_free(m->msg);
+      free(m);
+      retry_interval = 0;
+      continue;
+    }
+
+    if (host->async_shutdown)
+      break;
+
+    if (retry_interval == 0)
+      retry_interval = RIEMANN_ASYNC_RETRY_MIN;
+    else if (retry_interval < RIEMANN_ASYNC_RETRY_MAX / 2)
+      retry_interval *= 2;
+    else
+      retry_interval = RIEMANN_ASYNC_RETRY_MAX;
+
+    cdtime_t next_attempt = cdtime() + retry_interval;
+    struct timespec ts = CDTIME_T_TO_TIMESPEC(next_attempt);
+    while (!host->async_shutdown && (cdtime() < next_attempt))
+      pthread_cond_timedwait(&host->queue_cond, &host->queue_lock, &ts);
+  } /* while (42) */
+
+  uint64_t lost = 0;
+  while (host->queue_head != NULL) {
+    struct wrr_msg *m = host->queue_head;
+    host->queue_head = m->next;
+    lost += m->msg->n_events;
+    riemann_message_free(m->msg);
+    free(m);
+  }
+  host->queue_tail = NULL;
+  host->queue_bytes = 0;
+  pthread_mutex_unlock(&host->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_riemann plugin: Node \"%s\": %" PRIu64 " events have not "
+            "been sent when shutting down.",
+            host->name, lost);
+
+  return NULL;
+} /* }}} void *wrr_async_thread */
+
+/* Lets the sending thread send what is queued and waits for it to exit. */
+static void wrr_async_stop(struct riemann_host *host) /* {{{ */
+{
+  pthread_mutex_lock(&host->queue_lock);
+  host->async_shutdown = true;
+  pthread_cond_signal(&host->queue_cond);
+  bool running = host->async_thread_running;
+  pthread_mutex_unlock(&host->queue_lock);
+
+  if (running) {
+    pthread_join(host->async_thread, NULL);
+    host->async_thread_running = false;
+  }
+} /* }}} void wrr_async_stop */
+
 static riemann_message_t *wrr_notification_to_message(notification_t const *n) {
   riemann_message_t *msg;
   riemann_event_t *event;
@@ -451,8 +648,15 @@ static int wrr_batch_flush_nolock(cdtime_t timeout, struct riemann_host *host) {
       return status;
     }
   }
-  wrr_send_nolock(host, host->batch_msg);
-  riemann_message_free(host->batch_msg);
+  if (host->batch_msg == NULL)
+    return status;
+
+  if (host->async) {
+    wrr_async_enqueue(host, host->batch_msg);
+  } else {
+    wrr_send_nolock(host, host->batch_msg);
+    riemann_message_free(host->batch_msg);
+  }
 
   host->batch_init = now;
   host->batch_msg = NULL;
@@ -548,6 +752,9 @@ static int wrr_notification(const notification_t *n, user_data_t *ud) /* {{{ */
   if (msg == NULL)
     return -1;
 
+  if (host->async)
+    return wrr_async_enqueue(host, msg);
+
   status = wrr_send(host, msg);
   if (status != 0)
     c_complain(
@@ -584,6 +791,9 @@ static int wrr_write(const data_set_t *ds, /* {{{ */
     if (msg == NULL)
       return -1;
 
+    if (host->async)
+      return wrr_async_enqueue(host, msg);
+
     status = wrr_send(host, msg);
 
     riemann_message_free(msg);
@@ -606,10 +816,17 @@ static void wrr_free(void *p) /* {{{ */
     return;
   }
 
+  /* Send what is left of the batch, then wait for the queue to be sent. */
+  wrr_batch_flush_nolock(/* timeout = */ 0, host);
+  if (host->async)
+    wrr_async_stop(host);
+
   wrr_disconnect(host);
 
-  pthread_mutex_lock(&host->lock);
+  pthread_mutex_unlock(&host->lock);
   pthread_mutex_destroy(&host->lock);
+  pthread_mutex_destroy(&host->queue_lock);
+  pthread_cond_destroy(&host->queue_cond);
   sfree(host);
 } /* }}} void wrr_free */
 
@@ -626,6 +843,8 @@ static int wrr_config_node(oconfig_item_t *ci) /* {{{ */
     return ENOMEM;
   }
   pthread_mutex_init(&host->lock, NULL);
+  pthread_mutex_init(&host->queue_lock, NULL);
+  pthread_cond_init(&host->queue_cond, NULL);
   C_COMPLAIN_INIT(&host->init_complaint);
   host->reference_count = 1;
   host->node = NULL;
@@ -643,6 +862,8 @@ static int wrr_config_node(oconfig_item_t *ci) /* {{{ */
   host->client_type = RIEMANN_CLIENT_TCP;
   host->timeout.tv_sec = 0;
   host->timeout.tv_usec = 0;
+  host->async = false;
+  host->async_queue_size = RIEMANN_ASYNC_DEFAULT_QUEUE_SIZE;
 
   status = cf_util_get_string(ci, &host->name);
   if (status != 0) {
@@ -696,6 +917,21 @@ static int wrr_config_node(oconfig_item_t *ci) /* {{{ */
       WARNING("write_riemann plugin: The Timeout option is not supported. "
               "Please upgrade the Riemann client to at least 1.8.0.");
 #endif
+    } else if (strcasecmp("Asynchronous", child->key) == 0) {
+      status = cf_util_get_boolean(child, &host->async);
+      if (status != 0)
+        break;
+    } else if (strcasecmp("AsyncQueueSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if (status != 0)
+        break;
+      if (tmp <= 0) {
+        ERROR("write_riemann plugin: \"AsyncQueueSize\" must be positive.");
+        status = EINVAL;
+        break;
+      }
+      host->async_queue_size = (size_t)tmp;
     } else if (strcasecmp("Port", child->key) == 0) {
       host->port = cf_util_get_port_number(child);
       if (host->port == -1) {
@@ -0,0 +1,268 @@
+/**
+ * collectd - src/write_segment.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/segment/segment.h"
+#include "utils_cache.h"
+#include "utils_complain.h"
+
+/* The points of a column must be less than 24 days apart, see
+ * c_tsz_encode(), so the segments are limited to a week. */
+#define WS_MAX_SEGMENT_INTERVAL TIME_T_TO_CDTIME_T_STATIC(7 * 86400)
+
+static char *datadir;
+static cdtime_t segment_interval = TIME_T_TO_CDTIME_T_STATIC(3600);
+static cdtime_t block_interval = TIME_T_TO_CDTIME_T_STATIC(60);
+static bool store_rates;
+
+static pthread_mutex_t ws_lock = PTHREAD_MUTEX_INITIALIZER;
+/* The file of the latest segment, named after its start. Values from before
+ * the start are added to it, too. */
+static segment_writer_t *ws_writer;
+static cdtime_t ws_segment_start;
+static cdtime_t ws_last_flush;
+static c_complain_t ws_complaint = C_COMPLAIN_INIT_STATIC;
+
+/* Writes the points kept in memory as a block. Requires the lock. */
+static int ws_flush_locked(void) {
+  ws_last_flush = cdtime();
+  if ((ws_writer == NULL) || (segment_writer_pending(ws_writer) == 0))
+    return 0;
+
+  int status = segment_writer_flush(ws_writer);
+  if (status != 0) {
+    ERROR("write_segment plugin: Writing a block failed: %s", STRERROR(status));
+    return -1;
+  }
+  return 0;
+} /* int ws_flush_locked */
+
+static void ws_close_locked(void) {
+  if (ws_writer == NULL)
+    return;
+
+  int status = segment_writer_close(ws_writer);
+  ws_writer = NULL;
+  if (status != 0)
+    ERROR("write_segment plugin: Closing the segment failed: %s",
+          STRERROR(status));
+} /* void ws_close_locked */
+
+/* Opens the file of the segment starting at `start'. If the file exists,
+ * e.g. after a restart, a number is appended to the name. */
+static int ws_open_locked(cdtime_t start) {
+  time_t t = CDTIME_T_TO_TIME_T(start);
+  struct tm tm;
+  char timestamp[32];
+  if ((gmtime_r(&t, &tm) == NULL) ||
+      (strftime(timestamp, sizeof(timestamp), "%Y%m%dT%H%M%SZ", &tm) == 0)) {
+    ERROR("write_segment plugin: Formatting the time failed.");
+    return -1;
+  }
+
+  for (int i = 0; i < 100; i++) {
+    char path[PATH_MAX];
+    if (i == 0)
+      snprintf(path, sizeof(path), "%s/%s.seg", datadir, timestamp);
+    else
+      snprintf(path, sizeof(path), "%s/%s-%d.seg", datadir, timestamp, i);
+
+    ws_writer = segment_writer_open(path);
+    if (ws_writer != NULL) {
+      c_release(LOG_INFO, &ws_complaint,
+                "write_segment plugin: Writing to \"%s\" again.", path);
+      ws_segment_start = start;
+      ws_last_flush = cdtime();
+      return 0;
+    } else if (errno != EEXIST) {
+      c_complain(LOG_ERR, &ws_complaint,
+                 "write_segment plugin: Creating \"%s\" failed: %s", path,
+                 STRERRNO);
+      return -1;
+    }
+  }
+
+  c_complain(LOG_ERR, &ws_complaint,
+             "write_segment plugin: Too many files for the segment %s.",
+             timestamp);
+  return -1;
+} /* int ws_open_locked */
+
+static int ws_write(data_set_t const *ds, value_list_t const *vl,
+                    __attribute__((unused)) user_data_t *ud) {
+  if (strcmp(ds->type, vl->type) != 0) {
+    ERROR("write_segment plugin: DS type does not match value list type");
+    return -1;
+  }
+
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return -1;
+
+  gauge_t values[ds->ds_num];
+  gauge_t *rates = NULL;
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    int type = ds->ds[i].type;
+    if (type == DS_TYPE_GAUGE) {
+      values[i] = vl->values[i].gauge;
+    } else if (store_rates) {
+      if (rates == NULL)
+        rates = uc_get_rate(ds, vl);
+      if (rates == NULL) {
+        WARNING("write_segment plugin: uc_get_rate failed.");
+        return -1;
+      }
+      values[i] = rates[i];
+    } else if (type == DS_TYPE_COUNTER) {
+      values[i] = (gauge_t)vl->values[i].counter;
+    } else if (type == DS_TYPE_DERIVE) {
+      values[i] = (gauge_t)vl->values[i].derive;
+    } else if (type == DS_TYPE_ABSOLUTE) {
+      values[i] = (gauge_t)vl->values[i].absolute;
+    } else {
+      ERROR("write_segment plugin: Unknown data source type: %i", type);
+      sfree(rates);
+      return -1;
+    }
+  }
+  sfree(rates);
+
+  cdtime_t start = vl->time - (vl->time % segment_interval);
+
+  pthread_mutex_lock(&ws_lock);
+  if ((ws_writer == NULL) || (start > ws_segment_start)) {
+    ws_close_locked();
+    if (ws_open_locked(start) != 0) {
+      pthread_mutex_unlock(&ws_lock);
+      return -1;
+    }
+  }
+
+  int status = segment_writer_append(ws_writer, name, ds, vl->time, values);
+  if (status == ERANGE) {
+    /* Not later than the last value of the series, e.g. because it's been
+     * sent twice. */
+    DEBUG("write_segment plugin: Dropping a value of %s at %.3f.", name,
+          CDTIME_T_TO_DOUBLE(vl->time));
+    status = 0;
+  } else if (status != 0) {
+    ERROR("write_segment plugin: Adding a value of %s failed: %s", name,
+          STRERROR(status));
+    status = -1;
+  }
+
+  if (cdtime() - ws_last_flush >= block_interval)
+    ws_flush_locked();
+  pthread_mutex_unlock(&ws_lock);
+
+  return status;
+} /* int ws_write */
+
+static int ws_flush(__attribute__((unused)) cdtime_t timeout,
+                    __attribute__((unused)) char const *identifier,
+                    __attribute__((unused)) user_data_t *ud) {
+  pthread_mutex_lock(&ws_lock);
+  int status = ws_flush_locked();
+  pthread_mutex_unlock(&ws_lock);
+  return status;
+} /* int ws_flush */
+
+static int ws_shutdown(void) {
+  pthread_mutex_lock(&ws_lock);
+  ws_close_locked();
+  pthread_mutex_unlock(&ws_lock);
+
+  sfree(datadir);
+  return 0;
+} /* int ws_shutdown */
+
+static int ws_init(void) {
+  if (datadir == NULL) {
+    datadir = strdup(PKGLOCALSTATEDIR "/segments");
+    if (datadir == NULL)
+      return -1;
+  }
+
+  /* With the trailing slash, the last component is created, too. */
+  char dir[PATH_MAX];
+  snprintf(dir, sizeof(dir), "%s/", datadir);
+  if (check_create_dir(dir) != 0) {
+    ERROR("write_segment plugin: Creating the directory \"%s\" failed.",
+          datadir);
+    return -1;
+  }
+
+  return 0;
+} /* int ws_init */
+
+static int ws_config(oconfig_item_t *ci) {
+  int status = 0;
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("DataDir", child->key) == 0)
+      status = cf_util_get_string(child, &datadir);
+    else if (strcasecmp("SegmentInterval", child->key) == 0)
+      status = cf_util_get_cdtime(child, &segment_interval);
+    else if (strcasecmp("BlockInterval", child->key) == 0)
+      status = cf_util_get_cdtime(child, &block_interval);
+    else if (strcasecmp("StoreRates", child->key) == 0)
+      status = cf_util_get_boolean(child, &store_rates);
+    else {
+      ERROR("write_segment plugin: Unknown config option: %s", child->key);
+      status = -1;
+    }
+
+    if (status != 0)
+      return -1;
+  }
+
+  if ((segment_interval == 0) ||
+      (segment_interval > WS_MAX_SEGMENT_INTERVAL)) {
+    ERROR("write_segment plugin: SegmentInterval must be between 1 and "
+          "%.0f seconds.",
+          CDTIME_T_TO_DOUBLE(WS_MAX_SEGMENT_INTERVAL));
+    return -1;
+  }
+
+  /* Trailing slashes make the file names harder to read. */
+  if (datadir != NULL) {
+    size_t len = strlen(datadir);
+    while ((len > 1) && (datadir[len - 1] == '/'))
+      datadir[--len] = 0;
+  }
+
+  return 0;
+} /* int ws_config */
+
+void module_register(void) {
+  plugin_register_complex_config("write_segment", ws_config);
+  plugin_register_init("write_segment", ws_init);
+  plugin_register_write("write_segment", ws_write, /* user_data = */ NULL);
+  plugin_register_flush("write_segment", ws_flush, /* user_data = */ NULL);
+  plugin_register_shutdown("write_segment", ws_shutdown);
+} /* void module_register */
@@ -33,72 +33,46 @@
 #include "utils_cache.h"
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stddef.h>
 
 #include <stdlib.h>
 #define SENSU_HOST "localhost"
 #define SENSU_PORT "3030"
 
-#ifdef HAVE_ASPRINTF
-#define my_asprintf asprintf
-#define my_vasprintf vasprintf
-#else
-/*
- * asprintf() is available from Solaris 10 update 11.
- * For older versions, use asprintf() portable implementation from
- * https://github.com/littlstar/asprintf.c/blob/master/
- * copyright (c) 2014 joseph werle <joseph.werle@gmail.com> under MIT license.
- */
-
-static int my_vasprintf(char **str, const char *fmt, va_list args) {
-  int size = 0;
-  va_list tmpa;
-  // copy
-  va_copy(tmpa, args);
-  // apply variadic arguments to
-  // sprintf with format to get size
-  size = vsnprintf(NULL, size, fmt, tmpa);
-  // toss args
-  va_end(tmpa);
-  // return -1 to be compliant if
-  // size is less than 0
-  if (size < 0) {
-    return -1;
-  }
-  // alloc with size plus 1 for `\0'
-  *str = (char *)malloc(size + 1);
-  // return -1 to be compliant
-  // if pointer is `NULL'
-  if (NULL == *str) {
-    return -1;
-  }
-  // format string with original
-  // variadic arguments and set new size
-  size = vsprintf(*str, fmt, args);
-  return size;
-}
-
-static int my_asprintf(char **str, const char *fmt, ...) {
-  int size = 0;
-  va_list args;
-  // init variadic argumens
-  va_start(args, fmt);
-  // format and get size
-  size = my_vasprintf(str, fmt, args);
-  // toss args
-  va_end(args);
-  return size;
-}
+#define SENSU_BUF_INIT_SIZE 1024
 
-#endif
+#define SENSU_ASYNC_DEFAULT_QUEUE_SIZE (1024 * 1024)
+#define SENSU_ASYNC_CONNECT_TIMEOUT_MS 1000
+#define SENSU_ASYNC_RETRY_MIN TIME_T_TO_CDTIME_T(1)
+#define SENSU_ASYNC_RETRY_MAX TIME_T_TO_CDTIME_T(60)
+#define SENSU_ASYNC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(2)
+#define SENSU_ASYNC_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
 
 struct str_list {
   int nb_strs;
   char **strs;
 };
 
+/* JSON messages are written into a growable buffer in a single pass. Once an
+ * allocation has failed, further writes are ignored. */
+struct sensu_buf {
+  char *data;
+  size_t len;
+  size_t size;
+  bool failed;
+};
+
+/* A message queued for the sending thread in asynchronous mode. */
+struct sensu_msg {
+  struct sensu_msg *next;
+  char *data;
+  size_t len;
+};
+
 struct sensu_host {
   char *name;
   char *event_service_prefix;
@@ -117,6 +91,22 @@ struct sensu_host {
   int s;
   struct addrinfo *res;
   int reference_count;
+
+  /* Asynchronous mode: messages are queued for "async_thread", which is then
+   * the only thread using the socket. The queue holds at most
+   * "async_queue_size" bytes. */
+  bool async;
+  size_t async_queue_size;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  struct sensu_msg *queue_head;
+  struct sensu_msg *queue_tail;
+  size_t queue_bytes;
+  uint64_t dropped;
+  uint64_t dropped_reported;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
 };
 
 static char *sensu_tags;
@@ -132,7 +122,7 @@ static int add_str_to_list(struct str_list *strs,
     ERROR("write_sensu plugin: Unable to alloc memory");
     return -1;
   }
-  strs->strs = realloc(strs->strs, strs->nb_strs + 1);
+  strs->strs = realloc(strs->strs, (strs->nb_strs + 1) * sizeof(*strs->strs));
   if (strs->strs == NULL) {
     strs->strs = old_strs_ptr;
     free(newstr);
@@ -153,6 +143,36 @@ static void free_str_list(struct str_list *strs) /* {{{ */
 }
 /* }}} void free_str_list */
 
+/* Connects "fd" like connect(2). In asynchronous mode, gives up after
+ * SENSU_ASYNC_CONNECT_TIMEOUT_MS, so that an unreachable Sensu client does not
+ * delay shutting down for long. */
+static int sensu_connect_fd(struct sensu_host const *host, int fd, /* {{{ */
+                            struct addrinfo const *ai) {
+  if (!host->async)
+    return connect(fd, ai->ai_addr, ai->ai_addrlen);
+
+  int flags = fcntl(fd, F_GETFL);
+  if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0))
+    return -1;
+
+  int status = connect(fd, ai->ai_addr, ai->ai_addrlen);
+  if ((status != 0) && (errno == EINPROGRESS)) {
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+
+    if ((poll(&pfd, 1, SENSU_ASYNC_CONNECT_TIMEOUT_MS) == 1) &&
+        (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0) &&
+        (err == 0))
+      status = 0;
+  }
+  if (status != 0)
+    return -1;
+
+  /* Messages are small, so that writing blocks hardly ever. */
+  return fcntl(fd, F_SETFL, flags);
+} /* }}} int sensu_connect_fd */
+
 static int sensu_connect(struct sensu_host *host) /* {{{ */
 {
   int e;
@@ -200,7 +220,7 @@ static int sensu_connect(struct sensu_host *host) /* {{{ */
     set_sock_opts(host->s);
 
     // connect the socket
-    if (connect(host->s, ai->ai_addr, ai->ai_addrlen) != 0) {
+    if (sensu_connect_fd(host, host->s, ai) != 0) {
       close(host->s);
       host->s = -1;
       continue;
@@ -224,44 +244,146 @@ static void sensu_close_socket(struct sensu_host *host) /* {{{ */
 
 } /* }}} void sensu_close_socket */
 
-static char *build_json_str_list(const char *tag,
-                                 struct str_list const *list) /* {{{ */
+static void sensu_buf_init(struct sensu_buf *b) /* {{{ */
 {
-  int res;
-  char *ret_str = NULL;
-  char *temp_str;
-  if (list->nb_strs == 0) {
-    ret_str = malloc(1);
-    if (ret_str == NULL) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str[0] = '\0';
+  b->len = 0;
+  b->size = SENSU_BUF_INIT_SIZE;
+  b->data = malloc(b->size);
+  b->failed = (b->data == NULL);
+  if (b->data != NULL)
+    b->data[0] = 0;
+} /* }}} void sensu_buf_init */
+
+/* Makes room for "n" more bytes and the terminating null byte. */
+static int sensu_buf_reserve(struct sensu_buf *b, size_t n) /* {{{ */
+{
+  if (b->failed)
+    return ENOMEM;
+  if ((b->len + n) < b->size)
+    return 0;
+
+  size_t size = b->size;
+  while ((b->len + n) >= size)
+    size *= 2;
+
+  char *tmp = realloc(b->data, size);
+  if (tmp == NULL) {
+    b->failed = true;
+    return ENOMEM;
   }
+  b->data = tmp;
+  b->size = size;
+  return 0;
+} /* }}} int sensu_buf_reserve */
 
-  res = my_asprintf(&temp_str, "\"%s\": [\"%s\"", tag, list->strs[0]);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    free(ret_str);
-    return NULL;
+static void sensu_buf_printf(struct sensu_buf *b, /* {{{ */
+                             const char *format, ...) {
+  va_list ap;
+
+  if (b->failed)
+    return;
+
+  va_start(ap, format);
+  int n = vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+  va_end(ap);
+  if (n < 0) {
+    b->failed = true;
+    return;
   }
-  for (int i = 1; i < list->nb_strs; i++) {
-    res = my_asprintf(&ret_str, "%s, \"%s\"", temp_str, list->strs[i]);
-    free(temp_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
+
+  if ((size_t)n >= (b->size - b->len)) {
+    if (sensu_buf_reserve(b, (size_t)n) != 0)
+      return;
+    va_start(ap, format);
+    vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+    va_end(ap);
+  }
+  b->len += (size_t)n;
+} /* }}} void sensu_buf_printf */
+
+/* Appends "str" escaped for use in a JSON string. */
+static void sensu_buf_escape(struct sensu_buf *b, const char *str) /* {{{ */
+{
+  /* A character takes at most six bytes, "\u001f", when escaped. */
+  if (sensu_buf_reserve(b, 6 * strlen(str)) != 0)
+    return;
+
+  char *ptr = b->data + b->len;
+  for (const char *s = str; *s != 0; s++) {
+    unsigned char c = (unsigned char)*s;
+
+    switch (c) {
+    case '"':
+    case '\\':
+      *ptr++ = '\\';
+      *ptr++ = (char)c;
+      break;
+    case '\n':
+      *ptr++ = '\\';
+      *ptr++ = 'n';
+      break;
+    case '\r':
+      *ptr++ = '\\';
+      *ptr++ = 'r';
+      break;
+    case '\t':
+      *ptr++ = '\\';
+      *ptr++ = 't';
+      break;
+    default:
+      if (c < 0x20)
+        ptr += sprintf(ptr, "\\u%04x", (unsigned int)c);
+      else
+        *ptr++ = (char)c;
     }
-    temp_str = ret_str;
   }
-  res = my_asprintf(&ret_str, "%s]", temp_str);
-  free(temp_str);
-  if (res == -1) {
+  *ptr = 0;
+  b->len = (size_t)(ptr - b->data);
+} /* }}} void sensu_buf_escape */
+
+/* Appends the member ', "key": "value"' to an object. */
+static void sensu_buf_string(struct sensu_buf *b, const char *key, /* {{{ */
+                             const char *value) {
+  sensu_buf_printf(b, ", \"");
+  sensu_buf_escape(b, key);
+  sensu_buf_printf(b, "\": \"");
+  sensu_buf_escape(b, value);
+  sensu_buf_printf(b, "\"");
+} /* }}} void sensu_buf_string */
+
+static void sensu_buf_str_list(struct sensu_buf *b, const char *tag, /* {{{ */
+                               struct str_list const *list) {
+  sensu_buf_printf(b, "\"%s\": [", tag);
+  for (int i = 0; i < list->nb_strs; i++) {
+    sensu_buf_printf(b, (i == 0) ? "\"" : ", \"");
+    sensu_buf_escape(b, list->strs[i]);
+    sensu_buf_printf(b, "\"");
+  }
+  sensu_buf_printf(b, "]");
+} /* }}} void sensu_buf_str_list */
+
+/* Returns the message, which the caller must free, or NULL if an allocation
+ * failed. */
+static char *sensu_buf_finish(struct sensu_buf *b) /* {{{ */
+{
+  if (b->failed) {
     ERROR("write_sensu plugin: Unable to alloc memory");
+    sfree(b->data);
     return NULL;
   }
+  return b->data;
+} /* }}} char *sensu_buf_finish */
 
-  return ret_str;
+static char *build_json_str_list(const char *tag,
+                                 struct str_list const *list) /* {{{ */
+{
+  struct sensu_buf b;
+
+  sensu_buf_init(&b);
+  if (list->nb_strs > 0)
+    sensu_buf_str_list(&b, tag, list);
+
+  return sensu_buf_finish(&b);
 } /* }}} char *build_json_str_list*/
 
 static int sensu_format_name2(char *ret, int ret_len, const char *hostname,
@@ -340,193 +462,52 @@ static char *sensu_value_to_json(struct sensu_host const *host, /* {{{ */
                                  size_t index, gauge_t const *rates) {
   char name_buffer[5 * DATA_MAX_NAME_LEN];
   char service_buffer[6 * DATA_MAX_NAME_LEN];
-  char *ret_str;
-  char *temp_str;
-  char *value_str;
-  int res;
-  // First part of the JSON string
-  const char *part1 = "{\"name\": \"collectd\", \"type\": \"metric\"";
-
-  char *handlers_str =
-      build_json_str_list("handlers", &(host->metric_handlers));
-  if (handlers_str == NULL) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
+  struct sensu_buf b;
+
+  sensu_buf_init(&b);
+  sensu_buf_printf(&b, "{\"name\": \"collectd\", \"type\": \"metric\"");
 
   // incorporate the handlers
-  if (strlen(handlers_str) == 0) {
-    free(handlers_str);
-    ret_str = strdup(part1);
-    if (ret_str == NULL) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-  } else {
-    res = my_asprintf(&ret_str, "%s, %s", part1, handlers_str);
-    free(handlers_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
+  if (host->metric_handlers.nb_strs > 0) {
+    sensu_buf_printf(&b, ", ");
+    sensu_buf_str_list(&b, "handlers", &host->metric_handlers);
   }
 
   // incorporate the plugin name information
-  res = my_asprintf(&temp_str, "%s, \"collectd_plugin\": \"%s\"", ret_str,
-                    vl->plugin);
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+  sensu_buf_string(&b, "collectd_plugin", vl->plugin);
 
   // incorporate the plugin type
-  res = my_asprintf(&temp_str, "%s, \"collectd_plugin_type\": \"%s\"", ret_str,
-                    vl->type);
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+  sensu_buf_string(&b, "collectd_plugin_type", vl->type);
 
   // incorporate the plugin instance if any
-  if (vl->plugin_instance[0] != 0) {
-    res = my_asprintf(&temp_str, "%s, \"collectd_plugin_instance\": \"%s\"",
-                      ret_str, vl->plugin_instance);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (vl->plugin_instance[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin_instance", vl->plugin_instance);
 
   // incorporate the plugin type instance if any
-  if (vl->type_instance[0] != 0) {
-    res =
-        my_asprintf(&temp_str, "%s, \"collectd_plugin_type_instance\": \"%s\"",
-                    ret_str, vl->type_instance);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (vl->type_instance[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin_type_instance", vl->type_instance);
 
   // incorporate the data source type
-  if ((ds->ds[index].type != DS_TYPE_GAUGE) && (rates != NULL)) {
-    char ds_type[DATA_MAX_NAME_LEN];
-    snprintf(ds_type, sizeof(ds_type), "%s:rate",
-             DS_TYPE_TO_STRING(ds->ds[index].type));
-    res = my_asprintf(&temp_str, "%s, \"collectd_data_source_type\": \"%s\"",
-                      ret_str, ds_type);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  } else {
-    res = my_asprintf(&temp_str, "%s, \"collectd_data_source_type\": \"%s\"",
-                      ret_str, DS_TYPE_TO_STRING(ds->ds[index].type));
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if ((ds->ds[index].type != DS_TYPE_GAUGE) && (rates != NULL))
+    sensu_buf_printf(&b, ", \"collectd_data_source_type\": \"%s:rate\"",
+                     DS_TYPE_TO_STRING(ds->ds[index].type));
+  else
+    sensu_buf_printf(&b, ", \"collectd_data_source_type\": \"%s\"",
+                     DS_TYPE_TO_STRING(ds->ds[index].type));
 
   // incorporate the data source name
-  res = my_asprintf(&temp_str, "%s, \"collectd_data_source_name\": \"%s\"",
-                    ret_str, ds->ds[index].name);
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+  sensu_buf_string(&b, "collectd_data_source_name", ds->ds[index].name);
 
   // incorporate the data source index
-  {
-    char ds_index[DATA_MAX_NAME_LEN];
-    snprintf(ds_index, sizeof(ds_index), "%" PRIsz, index);
-    res = my_asprintf(&temp_str, "%s, \"collectd_data_source_index\": %s",
-                      ret_str, ds_index);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  sensu_buf_printf(&b, ", \"collectd_data_source_index\": %" PRIsz, index);
 
   // add key value attributes from config if any
-  for (size_t i = 0; i < sensu_attrs_num; i += 2) {
-    res = my_asprintf(&temp_str, "%s, \"%s\": \"%s\"", ret_str, sensu_attrs[i],
-                      sensu_attrs[i + 1]);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  for (size_t i = 0; i < sensu_attrs_num; i += 2)
+    sensu_buf_string(&b, sensu_attrs[i], sensu_attrs[i + 1]);
 
   // incorporate sensu tags from config if any
-  if ((sensu_tags != NULL) && (strlen(sensu_tags) != 0)) {
-    res = my_asprintf(&temp_str, "%s, %s", ret_str, sensu_tags);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
-
-  // calculate the value and set to a string
-  if (ds->ds[index].type == DS_TYPE_GAUGE) {
-    res = my_asprintf(&value_str, GAUGE_FORMAT, vl->values[index].gauge);
-    if (res == -1) {
-      free(ret_str);
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-  } else if (rates != NULL) {
-    res = my_asprintf(&value_str, GAUGE_FORMAT, rates[index]);
-    if (res == -1) {
-      free(ret_str);
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-  } else {
-    if (ds->ds[index].type == DS_TYPE_DERIVE) {
-      res = my_asprintf(&value_str, "%" PRIi64, vl->values[index].derive);
-      if (res == -1) {
-        free(ret_str);
-        ERROR("write_sensu plugin: Unable to alloc memory");
-        return NULL;
-      }
-    } else if (ds->ds[index].type == DS_TYPE_ABSOLUTE) {
-      res = my_asprintf(&value_str, "%" PRIu64, vl->values[index].absolute);
-      if (res == -1) {
-        free(ret_str);
-        ERROR("write_sensu plugin: Unable to alloc memory");
-        return NULL;
-      }
-    } else {
-      res = my_asprintf(&value_str, "%" PRIu64,
-                        (uint64_t)vl->values[index].counter);
-      if (res == -1) {
-        free(ret_str);
-        ERROR("write_sensu plugin: Unable to alloc memory");
-        return NULL;
-      }
-    }
-  }
+  if ((sensu_tags != NULL) && (sensu_tags[0] != 0))
+    sensu_buf_printf(&b, ", %s", sensu_tags);
 
   // Generate the full service name
   sensu_format_name2(name_buffer, sizeof(name_buffer), vl->host, vl->plugin,
@@ -551,17 +532,26 @@ static char *sensu_value_to_json(struct sensu_host const *host, /* {{{ */
   // happy
   in_place_replace_sensu_name_reserved(service_buffer);
 
-  // finalize the buffer by setting the output and closing curly bracket
-  res = my_asprintf(&temp_str, "%s, \"output\": \"%s %s %lld\"}\n", ret_str,
-                    service_buffer, value_str,
-                    (long long)CDTIME_T_TO_TIME_T(vl->time));
-  free(ret_str);
-  free(value_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
+  // the output is the service name, the value and the time
+  sensu_buf_printf(&b, ", \"output\": \"");
+  sensu_buf_escape(&b, service_buffer);
+  if (ds->ds[index].type == DS_TYPE_GAUGE)
+    sensu_buf_printf(&b, " " GAUGE_FORMAT, vl->values[index].gauge);
+  else if (rates != NULL)
+    sensu_buf_printf(&b, " " GAUGE_FORMAT, rates[index]);
+  else if (ds->ds[index].type == DS_TYPE_DERIVE)
+    sensu_buf_printf(&b, " %" PRIi64, vl->values[index].derive);
+  else if (ds->ds[index].type == DS_TYPE_ABSOLUTE)
+    sensu_buf_printf(&b, " %" PRIu64, vl->values[index].absolute);
+  else
+    sensu_buf_printf(&b, " %" PRIu64, (uint64_t)vl->values[index].counter);
+
+  // finalize the buffer by setting the time and closing curly bracket
+  sensu_buf_printf(&b, " %lld\"}\n", (long long)CDTIME_T_TO_TIME_T(vl->time));
+
+  char *ret_str = sensu_buf_finish(&b);
+  if (ret_str == NULL)
     return NULL;
-  }
-  ret_str = temp_str;
 
   DEBUG("write_sensu plugin: Successfully created json for metric: "
         "host = \"%s\", service = \"%s\"",
@@ -569,99 +559,13 @@ static char *sensu_value_to_json(struct sensu_host const *host, /* {{{ */
   return ret_str;
 } /* }}} char *sensu_value_to_json */
 
-/*
- * Uses replace_str2() implementation from
- * http://creativeandcritical.net/str-replace-c/
- * copyright (c) Laird Shaw, under public domain.
- */
-static char *replace_str(const char *str, const char *old, /* {{{ */
-                         const char *new) {
-  char *ret, *r;
-  const char *p, *q;
-  size_t oldlen = strlen(old);
-  size_t count = strlen(new);
-  size_t retlen;
-  size_t newlen = count;
-  int samesize = (oldlen == newlen);
-
-  if (!samesize) {
-    for (count = 0, p = str; (q = strstr(p, old)) != NULL; p = q + oldlen)
-      count++;
-    /* This is undefined if p - str > PTRDIFF_MAX */
-    retlen = p - str + strlen(p) + count * (newlen - oldlen);
-  } else
-    retlen = strlen(str);
-
-  ret = calloc(1, retlen + 1);
-  if (ret == NULL)
-    return NULL;
-  // added to original: not optimized, but keeps valgrind happy.
-
-  r = ret;
-  p = str;
-  while (1) {
-    /* If the old and new strings are different lengths - in other
-     * words we have already iterated through with strstr above,
-     * and thus we know how many times we need to call it - then we
-     * can avoid the final (potentially lengthy) call to strstr,
-     * which we already know is going to return NULL, by
-     * decrementing and checking count.
-     */
-    if (!samesize && !count--)
-      break;
-    /* Otherwise i.e. when the old and new strings are the same
-     * length, and we don't know how many times to call strstr,
-     * we must check for a NULL return here (we check it in any
-     * event, to avoid further conditions, and because there's
-     * no harm done with the check even when the old and new
-     * strings are different lengths).
-     */
-    if ((q = strstr(p, old)) == NULL)
-      break;
-    /* This is undefined if q - p > PTRDIFF_MAX */
-    ptrdiff_t l = q - p;
-    memcpy(r, p, l);
-    r += l;
-    memcpy(r, new, newlen);
-    r += newlen;
-    p = q + oldlen;
-  }
-  sstrncpy(r, p, retlen + 1);
-
-  return ret;
-} /* }}} char *replace_str */
-
-static char *replace_json_reserved(const char *message) /* {{{ */
-{
-  char *msg = replace_str(message, "\\", "\\\\");
-  if (msg == NULL) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  char *tmp = replace_str(msg, "\"", "\\\"");
-  free(msg);
-  if (tmp == NULL) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  msg = replace_str(tmp, "\n", "\\\n");
-  free(tmp);
-  if (msg == NULL) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  return msg;
-} /* }}} char *replace_json_reserved */
-
 static char *sensu_notification_to_json(struct sensu_host *host, /* {{{ */
                                         notification_t const *n) {
   char service_buffer[6 * DATA_MAX_NAME_LEN];
   char const *severity;
-  char *ret_str;
-  char *temp_str;
+  struct sensu_buf b;
   int status;
-  size_t i;
-  int res;
+
   // add the severity/status
   switch (n->severity) {
   case NOTIF_OKAY:
@@ -680,115 +584,43 @@ static char *sensu_notification_to_json(struct sensu_host *host, /* {{{ */
     severity = "UNKNOWN";
     status = 3;
   }
-  res = my_asprintf(&temp_str, "{\"status\": %d", status);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+
+  sensu_buf_init(&b);
+  sensu_buf_printf(&b, "{\"status\": %d", status);
 
   // incorporate the timestamp
-  res = my_asprintf(&temp_str, "%s, \"timestamp\": %lld", ret_str,
-                    (long long)CDTIME_T_TO_TIME_T(n->time));
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+  sensu_buf_printf(&b, ", \"timestamp\": %lld",
+                   (long long)CDTIME_T_TO_TIME_T(n->time));
 
-  char *handlers_str =
-      build_json_str_list("handlers", &(host->notification_handlers));
-  if (handlers_str == NULL) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    free(ret_str);
-    return NULL;
-  }
   // incorporate the handlers
-  if (strlen(handlers_str) != 0) {
-    res = my_asprintf(&temp_str, "%s, %s", ret_str, handlers_str);
-    free(ret_str);
-    free(handlers_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  } else {
-    free(handlers_str);
+  if (host->notification_handlers.nb_strs > 0) {
+    sensu_buf_printf(&b, ", ");
+    sensu_buf_str_list(&b, "handlers", &host->notification_handlers);
   }
 
   // incorporate the plugin name information if any
-  if (n->plugin[0] != 0) {
-    res = my_asprintf(&temp_str, "%s, \"collectd_plugin\": \"%s\"", ret_str,
-                      n->plugin);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (n->plugin[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin", n->plugin);
 
   // incorporate the plugin type if any
-  if (n->type[0] != 0) {
-    res = my_asprintf(&temp_str, "%s, \"collectd_plugin_type\": \"%s\"",
-                      ret_str, n->type);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (n->type[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin_type", n->type);
 
   // incorporate the plugin instance if any
-  if (n->plugin_instance[0] != 0) {
-    res = my_asprintf(&temp_str, "%s, \"collectd_plugin_instance\": \"%s\"",
-                      ret_str, n->plugin_instance);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (n->plugin_instance[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin_instance", n->plugin_instance);
 
   // incorporate the plugin type instance if any
-  if (n->type_instance[0] != 0) {
-    res =
-        my_asprintf(&temp_str, "%s, \"collectd_plugin_type_instance\": \"%s\"",
-                    ret_str, n->type_instance);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if (n->type_instance[0] != 0)
+    sensu_buf_string(&b, "collectd_plugin_type_instance", n->type_instance);
 
   // add key value attributes from config if any
-  for (i = 0; i < sensu_attrs_num; i += 2) {
-    res = my_asprintf(&temp_str, "%s, \"%s\": \"%s\"", ret_str, sensu_attrs[i],
-                      sensu_attrs[i + 1]);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  for (size_t i = 0; i < sensu_attrs_num; i += 2)
+    sensu_buf_string(&b, sensu_attrs[i], sensu_attrs[i + 1]);
 
   // incorporate sensu tags from config if any
-  if ((sensu_tags != NULL) && (strlen(sensu_tags) != 0)) {
-    res = my_asprintf(&temp_str, "%s, %s", ret_str, sensu_tags);
-    free(ret_str);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
-  }
+  if ((sensu_tags != NULL) && (sensu_tags[0] != 0))
+    sensu_buf_printf(&b, ", %s", sensu_tags);
 
   // incorporate the service name
   sensu_format_name2(service_buffer, sizeof(service_buffer),
@@ -796,67 +628,31 @@ static char *sensu_notification_to_json(struct sensu_host *host, /* {{{ */
                      n->type_instance, host->separator);
   // replace sensu event name chars that are considered illegal
   in_place_replace_sensu_name_reserved(service_buffer);
-  res = my_asprintf(&temp_str, "%s, \"name\": \"%s\"", ret_str,
-                    &service_buffer[1]);
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
-    return NULL;
-  }
-  ret_str = temp_str;
+  sensu_buf_string(&b, "name", &service_buffer[1]);
 
   // incorporate the check output
   if (n->message[0] != 0) {
-    char *msg = replace_json_reserved(n->message);
-    if (msg == NULL) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      free(ret_str);
-      return NULL;
-    }
-    res = my_asprintf(&temp_str, "%s, \"output\": \"%s - %s\"", ret_str,
-                      severity, msg);
-    free(ret_str);
-    free(msg);
-    if (res == -1) {
-      ERROR("write_sensu plugin: Unable to alloc memory");
-      return NULL;
-    }
-    ret_str = temp_str;
+    sensu_buf_printf(&b, ", \"output\": \"%s - ", severity);
+    sensu_buf_escape(&b, n->message);
+    sensu_buf_printf(&b, "\"");
   }
 
   // Pull in values from threshold and add extra attributes
   for (notification_meta_t *meta = n->meta; meta != NULL; meta = meta->next) {
     if (strcasecmp("CurrentValue", meta->name) == 0 &&
-        meta->type == NM_TYPE_DOUBLE) {
-      res = my_asprintf(&temp_str, "%s, \"current_value\": \"%.8f\"", ret_str,
-                        meta->nm_value.nm_double);
-      free(ret_str);
-      if (res == -1) {
-        ERROR("write_sensu plugin: Unable to alloc memory");
-        return NULL;
-      }
-      ret_str = temp_str;
-    }
-    if (meta->type == NM_TYPE_STRING) {
-      res = my_asprintf(&temp_str, "%s, \"%s\": \"%s\"", ret_str, meta->name,
-                        meta->nm_value.nm_string);
-      free(ret_str);
-      if (res == -1) {
-        ERROR("write_sensu plugin: Unable to alloc memory");
-        return NULL;
-      }
-      ret_str = temp_str;
-    }
+        meta->type == NM_TYPE_DOUBLE)
+      sensu_buf_printf(&b, ", \"current_value\": \"%.8f\"",
+                       meta->nm_value.nm_double);
+    if (meta->type == NM_TYPE_STRING)
+      sensu_buf_string(&b, meta->name, meta->nm_value.nm_string);
   }
 
   // close the curly bracket
-  res = my_asprintf(&temp_str, "%s}\n", ret_str);
-  free(ret_str);
-  if (res == -1) {
-    ERROR("write_sensu plugin: Unable to alloc memory");
+  sensu_buf_printf(&b, "}\n");
+
+  char *ret_str = sensu_buf_finish(&b);
+  if (ret_str == NULL)
     return NULL;
-  }
-  ret_str = temp_str;
 
   DEBUG("write_sensu plugin: Successfully created JSON for notification: "
         "host = \"%s\", service = \"%s\", state = \"%s\"",
@@ -905,68 +701,220 @@ static int sensu_send(struct sensu_host *host, char const *msg) /* {{{ */
   return 0;
 } /* }}} int sensu_send */
 
+static void *sensu_async_thread(void *arg);
+
+/* Queues "msg" for the sending thread, or drops it if the queue is full.
+ * Takes ownership of "msg". The thread is started with the first message,
+ * because the daemon may fork after reading the configuration. */
+static int sensu_async_enqueue(struct sensu_host *host, char *msg) /* {{{ */
+{
+  struct sensu_msg *m = malloc(sizeof(*m));
+  if (m == NULL) {
+    ERROR("write_sensu plugin: malloc failed.");
+    free(msg);
+    return ENOMEM;
+  }
+  m->next = NULL;
+  m->data = msg;
+  m->len = strlen(msg);
+
+  pthread_mutex_lock(&host->queue_lock);
+
+  if (!host->async_thread_running && !host->async_shutdown) {
+    int status = plugin_thread_create(&host->async_thread, /* attr = */ NULL,
+                                      sensu_async_thread, host, "write_sensu");
+    if (status != 0)
+      ERROR("write_sensu plugin: plugin_thread_create failed: %s",
+            STRERROR(status));
+    else
+      host->async_thread_running = true;
+  }
+
+  if (!host->async_thread_running ||
+      ((host->queue_bytes + m->len) > host->async_queue_size)) {
+    host->dropped++;
+    pthread_mutex_unlock(&host->queue_lock);
+    free(m->data);
+    free(m);
+    return 0;
+  }
+
+  if (host->queue_tail == NULL)
+    host->queue_head = m;
+  else
+    host->queue_tail->next = m;
+  host->queue_tail = m;
+  host->queue_bytes += m->len;
+
+  pthread_cond_signal(&host->queue_cond);
+  pthread_mutex_unlock(&host->queue_lock);
+  return 0;
+} /* }}} int sensu_async_enqueue */
+
+/* Sends the queue of "host" one message per connection, as the Sensu client
+ * expects. While Sensu is not reachable, the queue is kept and the time
+ * between attempts doubles up to SENSU_ASYNC_RETRY_MAX. */
+static void *sensu_async_thread(void *arg) /* {{{ */
+{
+  struct sensu_host *host = arg;
+  cdtime_t shutdown_deadline = 0;
+  cdtime_t last_report = 0;
+  cdtime_t retry_interval = 0;
+
+  pthread_mutex_lock(&host->queue_lock);
+  while (42) {
+    while ((host->queue_head == NULL) && !host->async_shutdown)
+      pthread_cond_wait(&host->queue_cond, &host->queue_lock);
+
+    if (host->queue_head == NULL)
+      break;
+
+    cdtime_t now = cdtime();
+    if (host->async_shutdown) {
+      if (shutdown_deadline == 0)
+        shutdown_deadline = now + SENSU_ASYNC_SHUTDOWN_TIMEOUT;
+      else if (now > shutdown_deadline)
+        break;
+    }
+
+    uint64_t dropped = 0;
+    if ((host->dropped != host->dropped_reported) &&
+        ((now - last_report) >= SENSU_ASYNC_REPORT_INTERVAL)) {
+      dropped = host->dropped - host->dropped_reported;
+      host->dropped_reported = host->dropped;
+      last_report = now;
+    }
+
+    /* Messages are only appended by other threads, so the head does not
+     * change while the lock is released. */
+    struct sensu_msg *m = host->queue_head;
+    pthread_mutex_unlock(&host->queue_lock);
+
+    if (dropped > 0)
+      WARNING("write_sensu plugin: Node \"%s\": The send queue is full. "
+              "%" PRIu64 " messages have been dropped since the last report.",
+              host->name, dropped);
+
+    int status = sensu_send(host, m->data);
+
+    pthread_mutex_lock(&host->queue_lock);
+    if (status == 0) {
+      host->queue_head = m->next;
+      if (host->queue_head == NULL)
+        host->queue_tail = NULL;
+      host->queue_bytes -= m->len;
+      free(m->data);
+      free(m);
+      retry_interval = 0;
+      continue;
+    }
+
+    if (host->async_shutdown)
+      break;
+
+    if (retry_interval == 0)
+      retry_interval = SENSU_ASYNC_RETRY_MIN;
+    else if (retry_interval < SENSU_ASYNC_RETRY_MAX / 2)
+      retry_interval *= 2;
+    else
+      retry_interval = SENSU_ASYNC_RETRY_MAX;
+
+    cdtime_t next_attempt = cdtime() + retry_interval;
+    struct timespec ts = CDTIME_T_TO_TIMESPEC(next_attempt);
+    while (!host->async_shutdown && (cdtime() < next_attempt))
+      pthread_cond_timedwait(&host->queue_cond, &host->queue_lock, &ts);
+  } /* while (42) */
+
+  uint64_t lost = 0;
+  while (host->queue_head != NULL) {
+    struct sensu_msg *m = host->queue_head;
+    host->queue_head = m->next;
+    free(m->data);
+    free(m);
+    lost++;
+  }
+  host->queue_tail = NULL;
+  host->queue_bytes = 0;
+  pthread_mutex_unlock(&host->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_sensu plugin: Node \"%s\": %" PRIu64 " messages have not "
+            "been sent when shutting down.",
+            host->name, lost);
+
+  return NULL;
+} /* }}} void *sensu_async_thread */
+
+/* Lets the sending thread send what is queued and waits for it to exit. */
+static void sensu_async_stop(struct sensu_host *host) /* {{{ */
+{
+  pthread_mutex_lock(&host->queue_lock);
+  host->async_shutdown = true;
+  pthread_cond_signal(&host->queue_cond);
+  bool running = host->async_thread_running;
+  pthread_mutex_unlock(&host->queue_lock);
+
+  if (running) {
+    pthread_join(host->async_thread, NULL);
+    host->async_thread_running = false;
+  }
+} /* }}} void sensu_async_stop */
+
+/* Sends "msg" or, in asynchronous mode, queues it. Frees "msg". */
+static int sensu_submit(struct sensu_host *host, char *msg) /* {{{ */
+{
+  if (host->async)
+    return sensu_async_enqueue(host, msg);
+
+  pthread_mutex_lock(&host->lock);
+  int status = sensu_send(host, msg);
+  pthread_mutex_unlock(&host->lock);
+  free(msg);
+
+  if (status != 0)
+    ERROR("write_sensu plugin: sensu_send failed with status %i", status);
+  return status;
+} /* }}} int sensu_submit */
+
 static int sensu_write(const data_set_t *ds, /* {{{ */
                        const value_list_t *vl, user_data_t *ud) {
   int status = 0;
-  int statuses[vl->values_len];
   struct sensu_host *host = ud->data;
   gauge_t *rates = NULL;
   char *msg;
 
-  pthread_mutex_lock(&host->lock);
-  memset(statuses, 0, vl->values_len * sizeof(*statuses));
-
   if (host->store_rates) {
     rates = uc_get_rate(ds, vl);
     if (rates == NULL) {
       ERROR("write_sensu plugin: uc_get_rate failed.");
-      pthread_mutex_unlock(&host->lock);
       return -1;
     }
   }
   for (size_t i = 0; i < vl->values_len; i++) {
-    msg = sensu_value_to_json(host, ds, vl, (int)i, rates);
+    msg = sensu_value_to_json(host, ds, vl, i, rates);
     if (msg == NULL) {
       sfree(rates);
-      pthread_mutex_unlock(&host->lock);
       return -1;
     }
-    status = sensu_send(host, msg);
-    free(msg);
-    if (status != 0) {
-      ERROR("write_sensu plugin: sensu_send failed with status %i", status);
-      pthread_mutex_unlock(&host->lock);
-      sfree(rates);
-      return status;
-    }
+    status = sensu_submit(host, msg);
+    if (status != 0)
+      break;
   }
   sfree(rates);
-  pthread_mutex_unlock(&host->lock);
   return status;
 } /* }}} int sensu_write */
 
 static int sensu_notification(const notification_t *n,
                               user_data_t *ud) /* {{{ */
 {
-  int status;
   struct sensu_host *host = ud->data;
   char *msg;
 
-  pthread_mutex_lock(&host->lock);
-
   msg = sensu_notification_to_json(host, n);
-  if (msg == NULL) {
-    pthread_mutex_unlock(&host->lock);
+  if (msg == NULL)
     return -1;
-  }
-
-  status = sensu_send(host, msg);
-  free(msg);
-  if (status != 0)
-    ERROR("write_sensu plugin: sensu_send failed with status %i", status);
-  pthread_mutex_unlock(&host->lock);
 
-  return status;
+  return sensu_submit(host, msg);
 } /* }}} int sensu_notification */
 
 static void sensu_free(void *p) /* {{{ */
@@ -984,6 +932,9 @@ static void sensu_free(void *p) /* {{{ */
     return;
   }
 
+  if (host->async)
+    sensu_async_stop(host);
+
   sensu_close_socket(host);
   if (host->res != NULL) {
     freeaddrinfo(host->res);
@@ -999,6 +950,8 @@ static void sensu_free(void *p) /* {{{ */
 
   pthread_mutex_unlock(&host->lock);
   pthread_mutex_destroy(&host->lock);
+  pthread_mutex_destroy(&host->queue_lock);
+  pthread_cond_destroy(&host->queue_cond);
 
   sfree(host);
 } /* }}} void sensu_free */
@@ -1015,7 +968,11 @@ static int sensu_config_node(oconfig_item_t *ci) /* {{{ */
     return ENOMEM;
   }
   pthread_mutex_init(&host->lock, NULL);
+  pthread_mutex_init(&host->queue_lock, NULL);
+  pthread_cond_init(&host->queue_cond, NULL);
   host->reference_count = 1;
+  host->s = -1;
+  host->async_queue_size = SENSU_ASYNC_DEFAULT_QUEUE_SIZE;
   host->node = NULL;
   host->service = NULL;
   host->notifications = false;
@@ -1094,6 +1051,21 @@ static int sensu_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_boolean(child, &host->always_append_ds);
       if (status != 0)
         break;
+    } else if (strcasecmp("Asynchronous", child->key) == 0) {
+      status = cf_util_get_boolean(child, &host->async);
+      if (status != 0)
+        break;
+    } else if (strcasecmp("AsyncQueueSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if (status != 0)
+        break;
+      if (tmp <= 0) {
+        ERROR("write_sensu plugin: \"AsyncQueueSize\" must be positive.");
+        status = EINVAL;
+        break;
+      }
+      host->async_queue_size = (size_t)tmp;
     } else {
       WARNING("write_sensu plugin: ignoring unknown config "
               "option: \"%s\"",
@@ -25,9 +25,12 @@
 #include "configfile.h"
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_stats/curl_stats.h"
 #include "utils/format_stackdriver/format_stackdriver.h"
 #include "utils/gce/gce.h"
 #include "utils/oauth/oauth.h"
+#include "utils_complain.h"
+#include "utils_ident.h"
 
 #include <curl/curl.h>
 #include <pthread.h>
@@ -44,31 +47,86 @@
 #define MONITORING_SCOPE "https://www.googleapis.com/auth/monitoring"
 #endif
 
+#ifndef WG_DEFAULT_SHARDS
+#define WG_DEFAULT_SHARDS 4
+#endif
+
+#define WG_MAX_QUEUED_REQUESTS 16
+#define WG_POLL_TIMEOUT_MS 100
+#define WG_BACKOFF_MIN TIME_T_TO_CDTIME_T(1)
+#define WG_BACKOFF_MAX TIME_T_TO_CDTIME_T(60)
+#define WG_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(5)
+#define WG_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
+/* The OAuth token is renewed 30 seconds before it expires. */
+#define WG_TOKEN_CHECK_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+struct wg_memory_s {
+  char *memory;
+  size_t size;
+};
+typedef struct wg_memory_s wg_memory_t;
+
+/* A timeSeries.create request queued for the sending thread. */
+struct wg_request_s {
+  struct wg_request_s *next;
+  sd_payload_t *payload;
+};
+typedef struct wg_request_s wg_request_t;
+
+/* A shard buffers the time series of a part of the metrics, chosen by the hash
+ * of the identifier. Each shard has at most one request in flight, so that
+ * the points of a time series are written in order. */
+struct wg_shard_s {
+  /* protected by the callback's "lock" */
+  sd_output_t *formatter;
+  size_t timeseries_count;
+  cdtime_t send_buffer_init_time;
+
+  /* protected by the callback's "queue_lock" */
+  wg_request_t *queue_head;
+  wg_request_t *queue_tail;
+  size_t queue_len;
+  wg_request_t *req;
+
+  /* used by the sending thread only */
+  CURL *curl;
+  struct curl_slist *headers;
+  wg_memory_t response;
+  char errbuf[CURL_ERROR_SIZE];
+};
+typedef struct wg_shard_s wg_shard_t;
+
 struct wg_callback_s {
   /* config */
   char *email;
   char *project;
   char *url;
   sd_resource_t *resource;
+  int shards_num;
+  curl_stats_t *stats;
 
   /* runtime */
   oauth_t *auth;
-  sd_output_t *formatter;
+  pthread_mutex_t token_lock;
   CURL *curl;
   char curl_errbuf[CURL_ERROR_SIZE];
-  /* used by flush */
-  size_t timeseries_count;
-  cdtime_t send_buffer_init_time;
+  wg_shard_t *shards;
 
   pthread_mutex_t lock;
-};
-typedef struct wg_callback_s wg_callback_t;
 
-struct wg_memory_s {
-  char *memory;
-  size_t size;
+  /* sending thread */
+  char *timeseries_url;
+  CURLM *multi;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  uint64_t dropped;
+  cdtime_t dropped_reported;
+  c_complain_t retry_complaint;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
 };
-typedef struct wg_memory_s wg_memory_t;
+typedef struct wg_callback_s wg_callback_t;
 
 static size_t wg_write_memory_cb(void *contents, size_t size,
                                  size_t nmemb, /* {{{ */
@@ -99,11 +157,15 @@ static char *wg_get_authorization_header(wg_callback_t *cb) { /* {{{ */
   char access_token[256];
   char authorization_header[256];
 
+  /* The token is renewed by the sending thread, but also used by the write
+   * threads for creating metric descriptors. */
+  pthread_mutex_lock(&cb->token_lock);
   assert((cb->auth != NULL) || gce_check());
   if (cb->auth != NULL)
     status = oauth_access_token(cb->auth, access_token, sizeof(access_token));
   else
     status = gce_access_token(cb->email, access_token, sizeof(access_token));
+  pthread_mutex_unlock(&cb->token_lock);
   if (status != 0) {
     ERROR("write_stackdriver plugin: Failed to get access token");
     return NULL;
@@ -152,9 +214,18 @@ static api_error_t *parse_api_error(char const *body) {
     }
   }
 
+  yajl_tree_free(root);
   return err;
 }
 
+static void api_error_destroy(api_error_t *err) {
+  if (err == NULL)
+    return;
+
+  sfree(err->message);
+  sfree(err);
+}
+
 static char *api_error_string(api_error_t *err, char *buffer,
                               size_t buffer_size) {
   if (err == NULL) {
@@ -215,6 +286,7 @@ static int do_post(wg_callback_t *cb, char const *url, void const *payload,
   curl_easy_setopt(cb->curl, CURLOPT_WRITEDATA, ret_content);
 
   int status = curl_easy_perform(cb->curl);
+  curl_stats_dispatch(cb->stats, cb->curl, NULL, "write_stackdriver", NULL);
 
   /* clean up that has to happen in any case */
   curl_slist_free_all(headers);
@@ -237,8 +309,10 @@ static int do_post(wg_callback_t *cb, char const *url, void const *payload,
 
   if (ret_content != NULL) {
     if ((http_code >= 400) && (http_code < 500)) {
+      api_error_t *err = parse_api_error(ret_content->memory);
       ERROR("write_stackdriver plugin: POST %s: %s", url,
-            API_ERROR_STRING(parse_api_error(ret_content->memory)));
+            API_ERROR_STRING(err));
+      api_error_destroy(err);
     } else if (http_code >= 500) {
       WARNING("write_stackdriver plugin: POST %s: %s", url,
               ret_content->memory);
@@ -271,42 +345,480 @@ static int wg_call_metricdescriptor_create(wg_callback_t *cb,
   return 0;
 } /* int wg_call_metricdescriptor_create */
 
-static int wg_call_timeseries_write(wg_callback_t *cb, char const *payload) {
-  char url[1024];
-  snprintf(url, sizeof(url), "%s/projects/%s/timeSeries", cb->url, cb->project);
-  wg_memory_t response = {0};
+static void wg_reset_buffer(wg_shard_t *shard) /* {{{ */
+{
+  shard->timeseries_count = 0;
+  shard->send_buffer_init_time = cdtime();
+} /* }}} wg_reset_buffer */
 
-  int status = do_post(cb, url, payload, &response);
-  if (status == -1) {
-    ERROR("write_stackdriver plugin: POST %s failed", url);
+/* must hold cb->queue_lock when calling */
+static void wg_async_report_drops(wg_callback_t *cb, cdtime_t now) /* {{{ */
+{
+  if ((cb->dropped == 0) || ((now - cb->dropped_reported) < WG_REPORT_INTERVAL))
+    return;
+
+  WARNING("write_stackdriver plugin: The send queue is full. %" PRIu64
+          " time series have been dropped since the last report.",
+          cb->dropped);
+  cb->dropped = 0;
+  cb->dropped_reported = now;
+} /* }}} void wg_async_report_drops */
+
+/* wg_async_requeue puts the request of "shard" back at the head of its queue,
+ * so that it is sent before requests queued later. Must hold cb->queue_lock
+ * when calling. */
+static void wg_async_requeue(wg_shard_t *shard) /* {{{ */
+{
+  wg_request_t *req = shard->req;
+  shard->req = NULL;
+
+  req->next = shard->queue_head;
+  shard->queue_head = req;
+  if (shard->queue_tail == NULL)
+    shard->queue_tail = req;
+  shard->queue_len++;
+} /* }}} void wg_async_requeue */
+
+static void wg_request_free(wg_request_t *req) /* {{{ */
+{
+  if (req == NULL)
+    return;
+
+  sd_payload_destroy(req->payload);
+  sfree(req);
+} /* }}} void wg_request_free */
+
+/* wg_async_backoff doubles the time to wait with every failure in a row. */
+static cdtime_t wg_async_backoff(cdtime_t backoff) /* {{{ */
+{
+  backoff *= 2;
+  if (backoff < WG_BACKOFF_MIN)
+    backoff = WG_BACKOFF_MIN;
+  if (backoff > WG_BACKOFF_MAX)
+    backoff = WG_BACKOFF_MAX;
+  return backoff;
+} /* }}} cdtime_t wg_async_backoff */
+
+/* wg_async_retryable returns true if a request that failed should be sent
+ * again later, because the API could not be reached or asked us to slow
+ * down. */
+static bool wg_async_retryable(CURLcode result, long http_code) /* {{{ */
+{
+  switch (result) {
+  case CURLE_OK:
+    return (http_code == 429) || (http_code == 503);
+  case CURLE_COULDNT_RESOLVE_HOST:
+  case CURLE_COULDNT_CONNECT:
+  case CURLE_OPERATION_TIMEDOUT:
+  case CURLE_SEND_ERROR:
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+    return true;
+  default:
+    return false;
+  }
+} /* }}} bool wg_async_retryable */
+
+/* wg_async_complete handles a finished timeSeries.create call. It returns true
+ * if the request has to be sent again, in which case "*backoff" is set to the
+ * time to wait before doing so. */
+static bool wg_async_complete(wg_callback_t *cb, /* {{{ */
+                              wg_shard_t *shard, CURLcode result,
+                              cdtime_t *backoff) {
+  long http_code = 0;
+  curl_easy_getinfo(shard->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  if ((result == CURLE_OK) && (http_code == 200)) {
+    c_release(LOG_INFO, &cb->retry_complaint,
+              "write_stackdriver plugin: POST %s succeeded again.",
+              cb->timeseries_url);
+    *backoff = 0;
+    return false;
+  }
+
+  if (!wg_async_retryable(result, http_code)) {
+    size_t lost = sd_payload_time_series(shard->req->payload);
+    if (result != CURLE_OK) {
+      ERROR("write_stackdriver plugin: POST %s failed: %s. %" PRIsz
+            " time series have been lost.",
+            cb->timeseries_url, shard->errbuf, lost);
+    } else {
+      api_error_t *err = (shard->response.memory != NULL)
+                             ? parse_api_error(shard->response.memory)
+                             : NULL;
+      ERROR("write_stackdriver plugin: POST %s: HTTP status %ld: %s. %" PRIsz
+            " time series have been lost.",
+            cb->timeseries_url, http_code, API_ERROR_STRING(err), lost);
+      api_error_destroy(err);
+    }
+    return false;
+  }
+
+  *backoff = wg_async_backoff(*backoff);
+  if (result != CURLE_OK)
+    c_complain(LOG_WARNING, &cb->retry_complaint,
+               "write_stackdriver plugin: POST %s failed: %s. Retrying in "
+               "%.3f seconds.",
+               cb->timeseries_url, shard->errbuf,
+               CDTIME_T_TO_DOUBLE(*backoff));
+  else
+    c_complain(LOG_WARNING, &cb->retry_complaint,
+               "write_stackdriver plugin: POST %s: HTTP status %ld. Retrying "
+               "in %.3f seconds.",
+               cb->timeseries_url, http_code, CDTIME_T_TO_DOUBLE(*backoff));
+  return true;
+} /* }}} bool wg_async_complete */
+
+/* wg_async_pending returns true if a request is queued or in flight. Must
+ * hold cb->queue_lock when calling. */
+static bool wg_async_pending(wg_callback_t *cb) /* {{{ */
+{
+  for (int i = 0; i < cb->shards_num; i++)
+    if ((cb->shards[i].queue_head != NULL) || (cb->shards[i].req != NULL))
+      return true;
+  return false;
+} /* }}} bool wg_async_pending */
+
+/* wg_async_thread sends the queued requests. Every shard has at most one
+ * request in flight, but the shards are sent concurrently. When the API cannot
+ * be reached or responds with 429 or 503, no new request is started until the
+ * back-off time has passed. The thread also renews the access token before it
+ * expires, so that sending does not have to wait for it. */
+static void *wg_async_thread(void *arg) /* {{{ */
+{
+  wg_callback_t *cb = arg;
+  size_t in_flight = 0;
+  cdtime_t backoff = 0;
+  cdtime_t retry_at = 0;
+  cdtime_t deadline = 0;
+  cdtime_t token_checked = 0;
+
+  pthread_mutex_lock(&cb->queue_lock);
+  while (42) {
+    cdtime_t now = cdtime();
+    wg_async_report_drops(cb, now);
+
+    /* When shutting down, keep sending for a while. */
+    if (cb->async_shutdown) {
+      if (deadline == 0)
+        deadline = now + WG_SHUTDOWN_TIMEOUT;
+      if (!wg_async_pending(cb) || (now >= deadline))
+        break;
+    }
+
+    if ((now - token_checked) >= WG_TOKEN_CHECK_INTERVAL) {
+      pthread_mutex_unlock(&cb->queue_lock);
+      free(wg_get_authorization_header(cb));
+      token_checked = cdtime();
+      pthread_mutex_lock(&cb->queue_lock);
+      continue;
+    }
+
+    /* Take the next request of every idle shard. */
+    size_t started = 0;
+    for (int i = 0; (now >= retry_at) && (i < cb->shards_num); i++) {
+      wg_shard_t *shard = cb->shards + i;
+      if ((shard->req != NULL) || (shard->queue_head == NULL))
+        continue;
+
+      shard->req = shard->queue_head;
+      shard->queue_head = shard->req->next;
+      if (shard->queue_head == NULL)
+        shard->queue_tail = NULL;
+      shard->queue_len--;
+      shard->req->next = NULL;
+      started++;
+    }
+
+    if ((in_flight == 0) && (started == 0)) {
+      cdtime_t until = token_checked + WG_TOKEN_CHECK_INTERVAL;
+      if (wg_async_pending(cb) && (retry_at < until))
+        until = retry_at;
+      if ((deadline != 0) && (deadline < until))
+        until = deadline;
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(until);
+      pthread_cond_timedwait(&cb->queue_cond, &cb->queue_lock, &ts);
+      continue;
+    }
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    char *auth_header = (started > 0) ? wg_get_authorization_header(cb) : NULL;
+    if ((started > 0) && (auth_header == NULL)) {
+      backoff = wg_async_backoff(backoff);
+      retry_at = cdtime() + backoff;
+    }
+
+    for (int i = 0; (started > 0) && (i < cb->shards_num); i++) {
+      wg_shard_t *shard = cb->shards + i;
+      if ((shard->req == NULL) || (shard->headers != NULL))
+        continue;
+
+      if (auth_header == NULL) {
+        pthread_mutex_lock(&cb->queue_lock);
+        wg_async_requeue(shard);
+        pthread_mutex_unlock(&cb->queue_lock);
+        continue;
+      }
+
+      size_t len = 0;
+      char const *data = sd_payload_data(shard->req->payload, &len);
+
+      shard->headers =
+          curl_slist_append(NULL, "Content-Type: application/json");
+      shard->headers = curl_slist_append(shard->headers, auth_header);
+      curl_easy_setopt(shard->curl, CURLOPT_HTTPHEADER, shard->headers);
+      curl_easy_setopt(shard->curl, CURLOPT_POSTFIELDSIZE, (long)len);
+      curl_easy_setopt(shard->curl, CURLOPT_POSTFIELDS, (char *)data);
+      curl_multi_add_handle(cb->multi, shard->curl);
+      in_flight++;
+    }
+    sfree(auth_header);
+
+    int running = 0;
+    if (in_flight > 0) {
+      curl_multi_perform(cb->multi, &running);
+      if (running > 0) {
+        curl_multi_wait(cb->multi, /* extra_fds = */ NULL,
+                        /* extra_nfds = */ 0, WG_POLL_TIMEOUT_MS,
+                        /* numfds = */ NULL);
+        curl_multi_perform(cb->multi, &running);
+      }
+    }
+
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(cb->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      CURLcode result = msg->data.result;
+      char *priv = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+      wg_shard_t *shard = (wg_shard_t *)priv;
+
+      curl_multi_remove_handle(cb->multi, shard->curl);
+      in_flight--;
+      curl_stats_dispatch(cb->stats, shard->curl, NULL, "write_stackdriver",
+                          NULL);
+
+      bool retry = wg_async_complete(cb, shard, result, &backoff);
+
+      curl_slist_free_all(shard->headers);
+      shard->headers = NULL;
+      sfree(shard->response.memory);
+      shard->response.size = 0;
+
+      if (retry) {
+        retry_at = cdtime() + backoff;
+        pthread_mutex_lock(&cb->queue_lock);
+        wg_async_requeue(shard);
+        pthread_mutex_unlock(&cb->queue_lock);
+      } else {
+        wg_request_free(shard->req);
+        shard->req = NULL;
+      }
+    }
+
+    pthread_mutex_lock(&cb->queue_lock);
+  }
+
+  /* Give up on what has not been sent. */
+  size_t lost = 0;
+  for (int i = 0; i < cb->shards_num; i++) {
+    wg_shard_t *shard = cb->shards + i;
+
+    if (shard->req != NULL) {
+      if (shard->headers != NULL)
+        curl_multi_remove_handle(cb->multi, shard->curl);
+      lost += sd_payload_time_series(shard->req->payload);
+      wg_request_free(shard->req);
+      shard->req = NULL;
+    }
+    curl_slist_free_all(shard->headers);
+    shard->headers = NULL;
+    sfree(shard->response.memory);
+    shard->response.size = 0;
+
+    while (shard->queue_head != NULL) {
+      wg_request_t *req = shard->queue_head;
+      shard->queue_head = req->next;
+      lost += sd_payload_time_series(req->payload);
+      wg_request_free(req);
+    }
+    shard->queue_tail = NULL;
+    shard->queue_len = 0;
+  }
+
+  /* Report the remaining drops, too. */
+  cb->dropped_reported = 0;
+  wg_async_report_drops(cb, cdtime());
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_stackdriver plugin: %" PRIsz " time series have not been "
+            "sent when shutting down.",
+            lost);
+
+  return NULL;
+} /* }}} void *wg_async_thread */
+
+/* wg_async_start sets up one easy handle per shard and starts the sending
+ * thread. This is done on the first request, because the daemon may fork after
+ * reading the configuration. Must hold cb->queue_lock when calling. */
+static int wg_async_start(wg_callback_t *cb) /* {{{ */
+{
+  cb->timeseries_url =
+      ssnprintf_alloc("%s/projects/%s/timeSeries", cb->url, cb->project);
+  if (cb->timeseries_url == NULL) {
+    ERROR("write_stackdriver plugin: ssnprintf_alloc failed.");
     return -1;
   }
-  sfree(response.memory);
 
-  if (status != 200) {
-    ERROR("write_stackdriver plugin: POST %s: unexpected response code: got "
-          "%d, want 200",
-          url, status);
+  cb->multi = curl_multi_init();
+  if (cb->multi == NULL) {
+    ERROR("write_stackdriver plugin: curl_multi_init failed.");
+    return -1;
+  }
+  /* Keep one connection per shard alive. */
+  curl_multi_setopt(cb->multi, CURLMOPT_MAXCONNECTS, (long)cb->shards_num);
+
+  long timeout_ms = 2 * CDTIME_T_TO_MS(plugin_get_interval());
+  if (timeout_ms < 10000) {
+    timeout_ms = 10000;
+  }
+
+  for (int i = 0; i < cb->shards_num; i++) {
+    wg_shard_t *shard = cb->shards + i;
+
+    shard->curl = curl_easy_init();
+    if (shard->curl == NULL) {
+      ERROR("write_stackdriver plugin: curl_easy_init failed.");
+      return -1;
+    }
+
+    curl_easy_setopt(shard->curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(shard->curl, CURLOPT_USERAGENT,
+                     PACKAGE_NAME "/" PACKAGE_VERSION);
+    curl_easy_setopt(shard->curl, CURLOPT_ERRORBUFFER, shard->errbuf);
+    curl_easy_setopt(shard->curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(shard->curl, CURLOPT_URL, cb->timeseries_url);
+    curl_easy_setopt(shard->curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(shard->curl, CURLOPT_WRITEFUNCTION, wg_write_memory_cb);
+    curl_easy_setopt(shard->curl, CURLOPT_WRITEDATA, &shard->response);
+    curl_easy_setopt(shard->curl, CURLOPT_PRIVATE, (char *)shard);
+  }
+
+  int status = plugin_thread_create(&cb->async_thread, /* attr = */ NULL,
+                                    wg_async_thread, cb, "write_stackdriver");
+  if (status != 0) {
+    ERROR("write_stackdriver plugin: plugin_thread_create failed: %s",
+          STRERROR(status));
     return -1;
   }
+
+  cb->async_thread_running = true;
   return 0;
-} /* int wg_call_timeseries_write */
+} /* }}} int wg_async_start */
 
-static void wg_reset_buffer(wg_callback_t *cb) /* {{{ */
+/* wg_async_stop lets the sending thread send what is queued and waits for it
+ * to exit. */
+static void wg_async_stop(wg_callback_t *cb) /* {{{ */
 {
-  cb->timeseries_count = 0;
-  cb->send_buffer_init_time = cdtime();
-} /* }}} wg_reset_buffer */
+  pthread_mutex_lock(&cb->queue_lock);
+  cb->async_shutdown = true;
+  pthread_cond_signal(&cb->queue_cond);
+  bool running = cb->async_thread_running;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (running) {
+    pthread_join(cb->async_thread, NULL);
+    cb->async_thread_running = false;
+  }
+
+  for (int i = 0; (cb->shards != NULL) && (i < cb->shards_num); i++) {
+    if (cb->shards[i].curl != NULL) {
+      curl_easy_cleanup(cb->shards[i].curl);
+      cb->shards[i].curl = NULL;
+    }
+  }
+  if (cb->multi != NULL) {
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
+  }
+  sfree(cb->timeseries_url);
+} /* }}} void wg_async_stop */
+
+/* wg_async_enqueue queues "payload" for the sending thread, or drops it if
+ * the shard's queue is full. */
+static int wg_async_enqueue(wg_callback_t *cb, wg_shard_t *shard, /* {{{ */
+                            sd_payload_t *payload) {
+  wg_request_t *req = calloc(1, sizeof(*req));
+  if (req == NULL) {
+    ERROR("write_stackdriver plugin: calloc failed.");
+    sd_payload_destroy(payload);
+    return ENOMEM;
+  }
+  req->payload = payload;
+
+  pthread_mutex_lock(&cb->queue_lock);
+
+  if (!cb->async_thread_running && !cb->async_shutdown && (cb->multi == NULL))
+    wg_async_start(cb);
+
+  if (!cb->async_thread_running) {
+    pthread_mutex_unlock(&cb->queue_lock);
+    wg_request_free(req);
+    return -1;
+  }
+
+  if (shard->queue_len >= WG_MAX_QUEUED_REQUESTS) {
+    cb->dropped += sd_payload_time_series(payload);
+    wg_async_report_drops(cb, cdtime());
+    pthread_mutex_unlock(&cb->queue_lock);
+    wg_request_free(req);
+    return 0;
+  }
+
+  if (shard->queue_tail == NULL)
+    shard->queue_head = req;
+  else
+    shard->queue_tail->next = req;
+  shard->queue_tail = req;
+  shard->queue_len++;
+
+  pthread_cond_signal(&cb->queue_cond);
+  pthread_mutex_unlock(&cb->queue_lock);
+  return 0;
+} /* }}} int wg_async_enqueue */
 
 static int wg_callback_init(wg_callback_t *cb) /* {{{ */
 {
   if (cb->curl != NULL)
     return 0;
 
-  cb->formatter = sd_output_create(cb->resource);
-  if (cb->formatter == NULL) {
-    ERROR("write_stackdriver plugin: sd_output_create failed.");
-    return -1;
+  if (cb->shards == NULL) {
+    cb->shards = calloc((size_t)cb->shards_num, sizeof(*cb->shards));
+    if (cb->shards == NULL) {
+      ERROR("write_stackdriver plugin: calloc failed.");
+      return -1;
+    }
+  }
+
+  for (int i = 0; i < cb->shards_num; i++) {
+    wg_shard_t *shard = cb->shards + i;
+    if (shard->formatter != NULL)
+      continue;
+
+    /* sd_output_destroy frees the resource, so every shard gets a copy. */
+    sd_resource_t *res = sd_resource_clone(cb->resource);
+    if (res != NULL)
+      shard->formatter = sd_output_create(res);
+    if (shard->formatter == NULL) {
+      ERROR("write_stackdriver plugin: sd_output_create failed.");
+      sd_resource_destroy(res);
+      return -1;
+    }
+    wg_reset_buffer(shard);
   }
 
   cb->curl = curl_easy_init();
@@ -319,37 +831,41 @@ static int wg_callback_init(wg_callback_t *cb) /* {{{ */
   curl_easy_setopt(cb->curl, CURLOPT_USERAGENT,
                    PACKAGE_NAME "/" PACKAGE_VERSION);
   curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  wg_reset_buffer(cb);
 
   return 0;
 } /* }}} int wg_callback_init */
 
-static int wg_flush_nolock(cdtime_t timeout, wg_callback_t *cb) /* {{{ */
+/* wg_flush_nolock hands the content of a shard to the sending thread. Only the
+ * request body is finalized while holding cb->lock; it is neither copied nor
+ * sent. Must hold cb->lock when calling. */
+static int wg_flush_nolock(wg_callback_t *cb, wg_shard_t *shard) /* {{{ */
 {
-  if (cb->timeseries_count == 0) {
-    cb->send_buffer_init_time = cdtime();
+  if (shard->timeseries_count == 0) {
+    shard->send_buffer_init_time = cdtime();
     return 0;
   }
 
-  /* timeout == 0  => flush unconditionally */
-  if (timeout > 0) {
-    cdtime_t now = cdtime();
+  sd_payload_t *payload = sd_output_take(shard->formatter);
+  wg_reset_buffer(shard);
+  if (payload == NULL) {
+    ERROR("write_stackdriver plugin: sd_output_take failed.");
+    return ENOMEM;
+  }
 
-    if ((cb->send_buffer_init_time + timeout) > now)
-      return 0;
+  /* E.g. only first values of cumulative metrics, which are not sent. */
+  if (sd_payload_time_series(payload) == 0) {
+    sd_payload_destroy(payload);
+    return 0;
   }
 
-  char *payload = sd_output_reset(cb->formatter);
-  int status = wg_call_timeseries_write(cb, payload);
-  wg_reset_buffer(cb);
-  return status;
+  return wg_async_enqueue(cb, shard, payload);
 } /* }}} wg_flush_nolock */
 
 static int wg_flush(cdtime_t timeout, /* {{{ */
                     const char *identifier __attribute__((unused)),
                     user_data_t *user_data) {
   wg_callback_t *cb;
-  int status;
+  int status = 0;
 
   if (user_data == NULL)
     return -EINVAL;
@@ -367,7 +883,19 @@ static int wg_flush(cdtime_t timeout, /* {{{ */
     }
   }
 
-  status = wg_flush_nolock(timeout, cb);
+  cdtime_t now = cdtime();
+  for (int i = 0; i < cb->shards_num; i++) {
+    wg_shard_t *shard = cb->shards + i;
+
+    /* timeout == 0  => flush unconditionally */
+    if ((timeout > 0) && (shard->timeseries_count > 0) &&
+        ((shard->send_buffer_init_time + timeout) > now))
+      continue;
+
+    int shard_status = wg_flush_nolock(cb, shard);
+    if (shard_status != 0)
+      status = shard_status;
+  }
   pthread_mutex_unlock(&cb->lock);
 
   return status;
@@ -379,18 +907,32 @@ static void wg_callback_free(void *data) /* {{{ */
   if (cb == NULL)
     return;
 
-  sd_output_destroy(cb->formatter);
-  cb->formatter = NULL;
+  for (int i = 0; (cb->shards != NULL) && (i < cb->shards_num); i++)
+    if (cb->shards[i].formatter != NULL)
+      wg_flush_nolock(cb, cb->shards + i);
+
+  wg_async_stop(cb);
+
+  for (int i = 0; (cb->shards != NULL) && (i < cb->shards_num); i++)
+    sd_output_destroy(cb->shards[i].formatter);
+  sfree(cb->shards);
+  sd_resource_destroy(cb->resource);
 
   sfree(cb->email);
   sfree(cb->project);
   sfree(cb->url);
+  curl_stats_destroy(cb->stats);
 
   oauth_destroy(cb->auth);
   if (cb->curl) {
     curl_easy_cleanup(cb->curl);
   }
 
+  pthread_mutex_destroy(&cb->lock);
+  pthread_mutex_destroy(&cb->token_lock);
+  pthread_mutex_destroy(&cb->queue_lock);
+  pthread_cond_destroy(&cb->queue_cond);
+
   sfree(cb);
 } /* }}} void wg_callback_free */
 
@@ -419,9 +961,34 @@ static int wg_metric_descriptors_create(wg_callback_t *cb, const data_set_t *ds,
     }
   }
 
-  return sd_output_register_metric(cb->formatter, ds, vl);
+  /* The descriptor is known to every shard, so that it is created once. */
+  for (int i = 0; i < cb->shards_num; i++) {
+    int status = sd_output_register_metric(cb->shards[i].formatter, ds, vl);
+    if (status != 0)
+      return status;
+  }
+  return 0;
 } /* }}} int wg_metric_descriptors_create */
 
+/* wg_shard_get returns the shard the time series of "vl" are buffered in. */
+static wg_shard_t *wg_shard_get(wg_callback_t *cb, /* {{{ */
+                                value_list_t const *vl) {
+  if (cb->shards_num == 1)
+    return cb->shards;
+
+  uint64_t hash;
+  if (vl->ident != NULL) {
+    hash = vl->ident->hash;
+  } else {
+    char name[6 * DATA_MAX_NAME_LEN];
+    if (FORMAT_VL(name, sizeof(name), vl) != 0)
+      return cb->shards;
+    hash = ident_hash(name);
+  }
+
+  return cb->shards + (hash % (uint64_t)cb->shards_num);
+} /* }}} wg_shard_t *wg_shard_get */
+
 static int wg_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
                     user_data_t *user_data) {
   wg_callback_t *cb = user_data->data;
@@ -439,18 +1006,22 @@ static int wg_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     }
   }
 
+  wg_shard_t *shard = wg_shard_get(cb, vl);
+
   int status;
   while (42) {
-    status = sd_output_add(cb->formatter, ds, vl);
+    status = sd_output_add(shard->formatter, ds, vl);
     if (status == 0) { /* success */
+      shard->timeseries_count++;
       break;
     } else if (status == ENOBUFS) { /* success, flush */
-      wg_flush_nolock(0, cb);
+      shard->timeseries_count++;
+      wg_flush_nolock(cb, shard);
       status = 0;
       break;
-    } else if (status == EEXIST) {
-      /* metric already in the buffer; flush and retry */
-      wg_flush_nolock(0, cb);
+    } else if ((status == EEXIST) || (status == ENOSPC)) {
+      /* metric already in the buffer or buffer full; flush and retry */
+      wg_flush_nolock(cb, shard);
       continue;
     } else if (status == ENOENT) {
       /* new metric, create metric descriptor first */
@@ -464,10 +1035,6 @@ static int wg_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     }
   }
 
-  if (status == 0) {
-    cb->timeseries_count++;
-  }
-
   pthread_mutex_unlock(&cb->lock);
   return status;
 } /* }}} int wg_write */
@@ -555,7 +1122,11 @@ static int wg_config(oconfig_item_t *ci) /* {{{ */
     return ENOMEM;
   }
   cb->url = strdup(GCM_API_URL);
+  cb->shards_num = WG_DEFAULT_SHARDS;
   pthread_mutex_init(&cb->lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->token_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->queue_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->queue_cond, /* attr = */ NULL);
 
   char *credential_file = NULL;
 
@@ -571,7 +1142,22 @@ static int wg_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_string(child, &credential_file);
     else if (strcasecmp("Resource", child->key) == 0)
       wg_config_resource(child, cb);
-    else {
+    else if (strcasecmp("Shards", child->key) == 0) {
+      if ((cf_util_get_int(child, &cb->shards_num) != 0) ||
+          (cb->shards_num < 1)) {
+        ERROR("write_stackdriver plugin: \"Shards\" must be a positive "
+              "integer.");
+        wg_callback_free(cb);
+        return EINVAL;
+      }
+    } else if (strcasecmp("Statistics", child->key) == 0) {
+      curl_stats_destroy(cb->stats);
+      cb->stats = curl_stats_from_config(child);
+      if (cb->stats == NULL) {
+        wg_callback_free(cb);
+        return EINVAL;
+      }
+    } else {
       ERROR("write_stackdriver plugin: Invalid configuration option: %s.",
             child->key);
       wg_callback_free(cb);
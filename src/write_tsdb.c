@@ -49,6 +49,7 @@
 #include "utils_random.h"
 
 #include <netdb.h>
+#include <sys/uio.h>
 
 #ifndef WT_DEFAULT_NODE
 #define WT_DEFAULT_NODE "localhost"
@@ -67,6 +68,25 @@
 #define WT_SEND_BUF_SIZE 1428
 #endif
 
+#ifndef WT_ASYNC_CHUNK_SIZE
+#define WT_ASYNC_CHUNK_SIZE 16384
+#endif
+
+#define WT_ASYNC_DEFAULT_QUEUE_SIZE (1024 * 1024)
+#define WT_ASYNC_IOV_MAX 64
+#define WT_ASYNC_RETRY_INTERVAL TIME_T_TO_CDTIME_T(1)
+#define WT_ASYNC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(2)
+#define WT_ASYNC_REPORT_INTERVAL TIME_T_TO_CDTIME_T(10)
+
+/* A chunk of "put" lines waiting to be sent by the asynchronous sender. */
+typedef struct wt_chunk_s wt_chunk_t;
+struct wt_chunk_s {
+  wt_chunk_t *next;
+  size_t len;
+  size_t lines;
+  char data[WT_ASYNC_CHUNK_SIZE];
+};
+
 /*
  * Private variables
  */
@@ -92,6 +112,25 @@ struct wt_callback {
   bool connect_failed_log_enabled;
   int connect_dns_failed_attempts_remaining;
   cdtime_t next_random_ttl;
+
+  /* Asynchronous mode: "put" lines are collected in "chunk" (under send_lock)
+   * rather than "send_buf", and full chunks are queued for "async_thread".
+   * The socket is then only used by that thread. The queue holds at most
+   * "async_queue_size" bytes. */
+  bool async;
+  size_t async_queue_size;
+  wt_chunk_t *chunk;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  wt_chunk_t *queue_head;
+  wt_chunk_t *queue_tail;
+  size_t queue_bytes;
+  size_t queue_offset;
+  uint64_t dropped;
+  uint64_t dropped_reported;
+  pthread_t async_thread;
+  bool async_thread_running;
+  bool async_shutdown;
 };
 
 static cdtime_t resolve_interval;
@@ -124,6 +163,8 @@ static int wt_send_buffer(struct wt_callback *cb) {
   return 0;
 }
 
+static void wt_async_enqueue_nolock(struct wt_callback *cb);
+
 /* NOTE: You must hold cb->send_lock when calling this function! */
 static int wt_flush_nolock(cdtime_t timeout, struct wt_callback *cb) {
   int status;
@@ -141,6 +182,11 @@ static int wt_flush_nolock(cdtime_t timeout, struct wt_callback *cb) {
       return 0;
   }
 
+  if (cb->async) {
+    wt_async_enqueue_nolock(cb);
+    return 0;
+  }
+
   if (cb->send_buf_fill == 0) {
     cb->send_buf_init_time = cdtime();
     return 0;
@@ -253,11 +299,235 @@ static int wt_callback_init(struct wt_callback *cb) {
   }
   cb->connect_dns_failed_attempts_remaining = 1;
 
-  wt_reset_buffer(cb);
+  /* In asynchronous mode, the sending thread connects without holding
+   * send_lock, and "send_buf" is not used. */
+  if (!cb->async)
+    wt_reset_buffer(cb);
+
+  return 0;
+}
+
+static void *wt_async_thread(void *arg);
+
+/* Queues the current chunk of "cb", or drops it if the queue is full. The
+ * sending thread is started with the first chunk, because the daemon may fork
+ * after reading the configuration. You must hold cb->send_lock. */
+static void wt_async_enqueue_nolock(struct wt_callback *cb) {
+  wt_chunk_t *chunk = cb->chunk;
+  if ((chunk == NULL) || (chunk->len == 0))
+    return;
+  cb->chunk = NULL;
+
+  pthread_mutex_lock(&cb->queue_lock);
+
+  if (!cb->async_thread_running && !cb->async_shutdown) {
+    int status = plugin_thread_create(&cb->async_thread, /* attr = */ NULL,
+                                      wt_async_thread, cb, "write_tsdb");
+    if (status != 0)
+      ERROR("write_tsdb plugin: plugin_thread_create failed: %s",
+            STRERROR(status));
+    else
+      cb->async_thread_running = true;
+  }
+
+  if (!cb->async_thread_running ||
+      ((cb->queue_bytes + chunk->len) > cb->async_queue_size)) {
+    cb->dropped += chunk->lines;
+    pthread_mutex_unlock(&cb->queue_lock);
+    sfree(chunk);
+    return;
+  }
+
+  if (cb->queue_tail == NULL)
+    cb->queue_head = chunk;
+  else
+    cb->queue_tail->next = chunk;
+  cb->queue_tail = chunk;
+  cb->queue_bytes += chunk->len;
+
+  pthread_cond_signal(&cb->queue_cond);
+  pthread_mutex_unlock(&cb->queue_lock);
+}
+
+/* Appends a "put" line to the current chunk. You must hold cb->send_lock. */
+static int wt_async_add_nolock(struct wt_callback *cb, char const *message,
+                               size_t message_len) {
+  if ((cb->chunk != NULL) &&
+      ((cb->chunk->len + message_len) > sizeof(cb->chunk->data)))
+    wt_async_enqueue_nolock(cb);
+
+  if (cb->chunk == NULL) {
+    cb->chunk = malloc(sizeof(*cb->chunk));
+    if (cb->chunk == NULL) {
+      ERROR("write_tsdb plugin: malloc failed.");
+      return ENOMEM;
+    }
+    cb->chunk->next = NULL;
+    cb->chunk->len = 0;
+    cb->chunk->lines = 0;
+    cb->send_buf_init_time = cdtime();
+  }
+
+  memcpy(cb->chunk->data + cb->chunk->len, message, message_len);
+  cb->chunk->len += message_len;
+  cb->chunk->lines++;
 
   return 0;
 }
 
+/* Removes "sent" bytes from the front of the queue. queue_lock must be held. */
+static void wt_async_consume(struct wt_callback *cb, size_t sent) {
+  while ((sent > 0) && (cb->queue_head != NULL)) {
+    wt_chunk_t *chunk = cb->queue_head;
+    size_t remaining = chunk->len - cb->queue_offset;
+
+    if (sent < remaining) {
+      cb->queue_offset += sent;
+      return;
+    }
+
+    sent -= remaining;
+    cb->queue_head = chunk->next;
+    if (cb->queue_head == NULL)
+      cb->queue_tail = NULL;
+    cb->queue_bytes -= chunk->len;
+    cb->queue_offset = 0;
+    sfree(chunk);
+  }
+}
+
+/* Sends "iov" to the TSD, connecting first if necessary. Returns the number of
+ * bytes sent, zero if the send timed out, or less than zero if the connection
+ * is not usable. */
+static ssize_t wt_async_send(struct wt_callback *cb, struct iovec *iov,
+                             int iov_num) {
+  if (cb->sock_fd < 0) {
+    if (wt_callback_init(cb) != 0)
+      return -1;
+
+    /* Don't block for long, so that shutting down is not delayed. */
+    struct timeval tv = {.tv_sec = 1};
+    if (setsockopt(cb->sock_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0)
+      WARNING("write_tsdb plugin: setsockopt(SO_SNDTIMEO) failed: %s",
+              STRERRNO);
+  }
+
+  ssize_t n = writev(cb->sock_fd, iov, iov_num);
+  if (n >= 0)
+    return n;
+
+  if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+    return 0;
+
+  ERROR("write_tsdb plugin: send failed: %s", STRERRNO);
+  close(cb->sock_fd);
+  cb->sock_fd = -1;
+  return -1;
+}
+
+/* Sends the queue of "cb". Up to WT_ASYNC_IOV_MAX chunks are sent with one
+ * system call. While the TSD is not reachable the queue is kept; it is
+ * bounded by "AsyncQueueSize". */
+static void *wt_async_thread(void *arg) {
+  struct wt_callback *cb = arg;
+  cdtime_t shutdown_deadline = 0;
+  cdtime_t last_report = 0;
+
+  pthread_mutex_lock(&cb->queue_lock);
+  while (42) {
+    while ((cb->queue_head == NULL) && !cb->async_shutdown)
+      pthread_cond_wait(&cb->queue_cond, &cb->queue_lock);
+
+    if (cb->queue_head == NULL)
+      break;
+
+    cdtime_t now = cdtime();
+    if (cb->async_shutdown) {
+      if (shutdown_deadline == 0)
+        shutdown_deadline = now + WT_ASYNC_SHUTDOWN_TIMEOUT;
+      else if (now > shutdown_deadline)
+        break;
+    }
+
+    uint64_t dropped = 0;
+    if ((cb->dropped != cb->dropped_reported) &&
+        ((now - last_report) >= WT_ASYNC_REPORT_INTERVAL)) {
+      dropped = cb->dropped - cb->dropped_reported;
+      cb->dropped_reported = cb->dropped;
+      last_report = now;
+    }
+
+    /* Chunks are only appended by other threads, so the part of the list
+     * collected here does not change while the lock is released. */
+    struct iovec iov[WT_ASYNC_IOV_MAX];
+    int iov_num = 0;
+    size_t offset = cb->queue_offset;
+    for (wt_chunk_t *c = cb->queue_head;
+         (c != NULL) && (iov_num < WT_ASYNC_IOV_MAX); c = c->next) {
+      iov[iov_num] = (struct iovec){
+          .iov_base = c->data + offset,
+          .iov_len = c->len - offset,
+      };
+      iov_num++;
+      offset = 0;
+    }
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    if (dropped > 0)
+      WARNING("write_tsdb plugin: [%s]:%s: The send queue is full. "
+              "%" PRIu64 " lines have been dropped since the last report.",
+              cb->node != NULL ? cb->node : WT_DEFAULT_NODE,
+              cb->service != NULL ? cb->service : WT_DEFAULT_SERVICE, dropped);
+
+    ssize_t n = wt_async_send(cb, iov, iov_num);
+
+    pthread_mutex_lock(&cb->queue_lock);
+    if (n > 0) {
+      wt_async_consume(cb, (size_t)n);
+    } else if (n < 0) {
+      if (cb->async_shutdown)
+        break;
+      struct timespec ts =
+          CDTIME_T_TO_TIMESPEC(cdtime() + WT_ASYNC_RETRY_INTERVAL);
+      pthread_cond_timedwait(&cb->queue_cond, &cb->queue_lock, &ts);
+    }
+  } /* while (42) */
+
+  uint64_t lost = 0;
+  while (cb->queue_head != NULL) {
+    wt_chunk_t *chunk = cb->queue_head;
+    cb->queue_head = chunk->next;
+    lost += chunk->lines;
+    sfree(chunk);
+  }
+  cb->queue_tail = NULL;
+  cb->queue_bytes = 0;
+  cb->queue_offset = 0;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (lost > 0)
+    WARNING("write_tsdb plugin: [%s]:%s: %" PRIu64 " lines have not been sent "
+            "when shutting down.",
+            cb->node != NULL ? cb->node : WT_DEFAULT_NODE,
+            cb->service != NULL ? cb->service : WT_DEFAULT_SERVICE, lost);
+
+  return NULL;
+}
+
+/* Lets the sending thread send what is queued and waits for it to exit. */
+static void wt_async_stop(struct wt_callback *cb) {
+  pthread_mutex_lock(&cb->queue_lock);
+  cb->async_shutdown = true;
+  pthread_cond_signal(&cb->queue_cond);
+  bool running = cb->async_thread_running;
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  if (running) {
+    pthread_join(cb->async_thread, NULL);
+    cb->async_thread_running = false;
+  }
+}
+
 static void wt_callback_free(void *data) {
   struct wt_callback *cb;
 
@@ -270,6 +540,11 @@ static void wt_callback_free(void *data) {
 
   wt_flush_nolock(0, cb);
 
+  if (cb->async) {
+    wt_async_stop(cb);
+    sfree(cb->chunk);
+  }
+
   close(cb->sock_fd);
   cb->sock_fd = -1;
 
@@ -279,6 +554,8 @@ static void wt_callback_free(void *data) {
 
   pthread_mutex_unlock(&cb->send_lock);
   pthread_mutex_destroy(&cb->send_lock);
+  pthread_mutex_destroy(&cb->queue_lock);
+  pthread_cond_destroy(&cb->queue_cond);
 
   sfree(cb);
 }
@@ -296,7 +573,7 @@ static int wt_flush(cdtime_t timeout,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->sock_fd < 0) {
+  if (!cb->async && (cb->sock_fd < 0)) {
     status = wt_callback_init(cb);
     if (status != 0) {
       ERROR("write_tsdb plugin: wt_callback_init failed.");
@@ -471,6 +748,12 @@ static int wt_send_message(const char *key, const char *value, cdtime_t time,
 
   pthread_mutex_lock(&cb->send_lock);
 
+  if (cb->async) {
+    status = wt_async_add_nolock(cb, message, message_len);
+    pthread_mutex_unlock(&cb->send_lock);
+    return status;
+  }
+
   if (cb->sock_fd < 0) {
     status = wt_callback_init(cb);
     if (status != 0) {
@@ -571,6 +854,32 @@ static int wt_write(const data_set_t *ds, const value_list_t *vl,
   return status;
 }
 
+/* In asynchronous mode, the lines of a write batch are queued once the whole
+ * batch has been formatted, so that they are sent together. */
+static int wt_write_batch(data_set_t const *const *ds,
+                          value_list_t const *const *vl, size_t num,
+                          user_data_t *user_data) {
+  struct wt_callback *cb;
+  size_t failure = 0;
+
+  if (user_data == NULL)
+    return EINVAL;
+
+  cb = user_data->data;
+
+  for (size_t i = 0; i < num; i++)
+    if (wt_write_messages(ds[i], vl[i], cb) != 0)
+      failure++;
+
+  pthread_mutex_lock(&cb->send_lock);
+  wt_async_enqueue_nolock(cb);
+  pthread_mutex_unlock(&cb->send_lock);
+
+  if ((num > 0) && (failure == num))
+    return -1;
+  return 0;
+}
+
 static int wt_config_tsd(oconfig_item_t *ci) {
   struct wt_callback *cb;
   char callback_name[DATA_MAX_NAME_LEN];
@@ -583,8 +892,11 @@ static int wt_config_tsd(oconfig_item_t *ci) {
   cb->sock_fd = -1;
   cb->connect_failed_log_enabled = 1;
   cb->next_random_ttl = new_random_ttl();
+  cb->async_queue_size = WT_ASYNC_DEFAULT_QUEUE_SIZE;
 
   pthread_mutex_init(&cb->send_lock, NULL);
+  pthread_mutex_init(&cb->queue_lock, NULL);
+  pthread_cond_init(&cb->queue_cond, NULL);
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -599,7 +911,18 @@ static int wt_config_tsd(oconfig_item_t *ci) {
       cf_util_get_boolean(child, &cb->store_rates);
     else if (strcasecmp("AlwaysAppendDS", child->key) == 0)
       cf_util_get_boolean(child, &cb->always_append_ds);
-    else {
+    else if (strcasecmp("Asynchronous", child->key) == 0)
+      cf_util_get_boolean(child, &cb->async);
+    else if (strcasecmp("AsyncQueueSize", child->key) == 0) {
+      int tmp = 0;
+      if (cf_util_get_int(child, &tmp) != 0)
+        continue;
+      if (tmp < WT_ASYNC_CHUNK_SIZE)
+        ERROR("write_tsdb plugin: \"AsyncQueueSize\" must be at least %d.",
+              WT_ASYNC_CHUNK_SIZE);
+      else
+        cb->async_queue_size = (size_t)tmp;
+    } else {
       ERROR("write_tsdb plugin: Invalid configuration "
             "option: %s.",
             child->key);
@@ -612,7 +935,10 @@ static int wt_config_tsd(oconfig_item_t *ci) {
 
   user_data_t user_data = {.data = cb, .free_func = wt_callback_free};
 
-  plugin_register_write(callback_name, wt_write, &user_data);
+  if (cb->async)
+    plugin_register_write_batch(callback_name, wt_write_batch, &user_data);
+  else
+    plugin_register_write(callback_name, wt_write, &user_data);
 
   user_data.free_func = NULL;
   plugin_register_flush(callback_name, wt_flush, &user_data);